@@ -28,14 +28,19 @@
       'sources': [
         'benchmark.cc',
         'benchmark.h',
+        'benchmarkcomparison.cc',
+        'benchmarkcomparison.h',
         'benchmarkutils.cc',
         'benchmarkutils.h',
         'discrepancy.h',
         'gpuperformance.cc',
         'gpuperformance.h',
+        'gpuperformancesampler.cc',
+        'gpuperformancesampler.h',
       ],
       'dependencies': [
         '../base/base.gyp:ionbase',
+        '../external/external.gyp:ionjsoncpp',
         '../gfx/gfx.gyp:iongfx',
         '<(ion_dir)/port/port.gyp:ionport',
       ],
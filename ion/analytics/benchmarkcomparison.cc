@@ -0,0 +1,402 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/analytics/benchmarkcomparison.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include "ion/analytics/discrepancy.h"
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace analytics {
+
+namespace {
+
+// The maximum number of iterations and the precision of the continued
+// fraction used to compute the incomplete beta function.
+static const int kMaxBetaIterations = 200;
+static const double kBetaEpsilon = 1e-12;
+
+// Evaluates the continued fraction of the incomplete beta function with
+// Lentz's method.
+static double BetaContinuedFraction(double a, double b, double x) {
+  static const double kTiny = 1e-300;
+  double c = 1.0;
+  double d = 1.0 - (a + b) * x / (a + 1.0);
+  if (std::fabs(d) < kTiny)
+    d = kTiny;
+  d = 1.0 / d;
+  double result = d;
+  for (int m = 1; m <= kMaxBetaIterations; ++m) {
+    const double m2 = 2.0 * m;
+    // The even step.
+    double aa = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+    d = 1.0 + aa * d;
+    if (std::fabs(d) < kTiny)
+      d = kTiny;
+    c = 1.0 + aa / c;
+    if (std::fabs(c) < kTiny)
+      c = kTiny;
+    d = 1.0 / d;
+    result *= d * c;
+    // The odd step.
+    aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+    d = 1.0 + aa * d;
+    if (std::fabs(d) < kTiny)
+      d = kTiny;
+    c = 1.0 + aa / c;
+    if (std::fabs(c) < kTiny)
+      c = kTiny;
+    d = 1.0 / d;
+    const double delta = d * c;
+    result *= delta;
+    if (std::fabs(delta - 1.0) < kBetaEpsilon)
+      break;
+  }
+  return result;
+}
+
+// Returns the regularized incomplete beta function I_x(a, b).
+static double RegularizedIncompleteBeta(double a, double b, double x) {
+  if (x <= 0.0)
+    return 0.0;
+  if (x >= 1.0)
+    return 1.0;
+  const double front = std::exp(std::lgamma(a + b) - std::lgamma(a) -
+                                std::lgamma(b) + a * std::log(x) +
+                                b * std::log(1.0 - x));
+  // The continued fraction converges quickly only on one side of the mean.
+  if (x < (a + 1.0) / (a + b + 2.0))
+    return front * BetaContinuedFraction(a, b, x) / a;
+  return 1.0 - front * BetaContinuedFraction(b, a, 1.0 - x) / b;
+}
+
+// Returns the absolute discrepancy of the timestamps of the variable's
+// samples, or 0 if there are too few distinct timestamps.
+static double GetTimestampDiscrepancy(
+    const Benchmark::SampledVariable& variable) {
+  std::vector<double> timestamps;
+  timestamps.reserve(variable.samples.size());
+  for (size_t i = 0; i < variable.samples.size(); ++i)
+    timestamps.push_back(variable.samples[i].time_offset_ms);
+  if (timestamps.size() < 2U ||
+      *std::min_element(timestamps.begin(), timestamps.end()) ==
+          *std::max_element(timestamps.begin(), timestamps.end()))
+    return 0.0;
+  return AbsoluteTimestampDiscrepancy(timestamps).discrepancy;
+}
+
+static std::vector<double> GetSampleValues(
+    const Benchmark::SampledVariable& variable) {
+  std::vector<double> values;
+  values.reserve(variable.samples.size());
+  for (size_t i = 0; i < variable.samples.size(); ++i)
+    values.push_back(variable.samples[i].value);
+  return values;
+}
+
+// The measurements of a Benchmark with the same id. At most one of constant,
+// sampled, and accumulated is set, unless the Benchmark reuses ids.
+struct Measurement {
+  Measurement() : constant(NULL), sampled(NULL), accumulated(NULL) {}
+  const Benchmark::Constant* constant;
+  const Benchmark::SampledVariable* sampled;
+  const Benchmark::AccumulatedVariable* accumulated;
+};
+
+typedef std::map<std::string, Measurement> MeasurementMap;
+
+// Adds the measurements of benchmark to map, and their ids to ids in the order
+// they appear in benchmark.
+static void GetMeasurements(const Benchmark& benchmark, MeasurementMap* map,
+                            std::vector<std::string>* ids) {
+  for (const auto& c : benchmark.GetConstants()) {
+    Measurement& m = (*map)[c.descriptor.id];
+    if (!m.constant && !m.sampled && !m.accumulated)
+      ids->push_back(c.descriptor.id);
+    m.constant = &c;
+  }
+  for (const auto& v : benchmark.GetSampledVariables()) {
+    Measurement& m = (*map)[v.descriptor.id];
+    if (!m.constant && !m.sampled && !m.accumulated)
+      ids->push_back(v.descriptor.id);
+    m.sampled = &v;
+  }
+  for (const auto& v : benchmark.GetAccumulatedVariables()) {
+    Measurement& m = (*map)[v.descriptor.id];
+    if (!m.constant && !m.sampled && !m.accumulated)
+      ids->push_back(v.descriptor.id);
+    m.accumulated = &v;
+  }
+}
+
+static const Benchmark::Descriptor& GetDescriptor(const Measurement& m) {
+  if (m.constant)
+    return m.constant->descriptor;
+  if (m.sampled)
+    return m.sampled->descriptor;
+  return m.accumulated->descriptor;
+}
+
+static BenchmarkDelta::Kind GetKind(const Measurement& m) {
+  if (m.constant)
+    return BenchmarkDelta::kConstant;
+  if (m.sampled)
+    return BenchmarkDelta::kSampledVariable;
+  return BenchmarkDelta::kAccumulatedVariable;
+}
+
+// Returns the accumulated form of a variable measurement.
+static Benchmark::AccumulatedVariable GetAccumulated(const Measurement& m) {
+  if (m.sampled)
+    return Benchmark::AccumulateSampledVariable(*m.sampled);
+  DCHECK(m.accumulated);
+  return *m.accumulated;
+}
+
+// Fills in the values and statistics of delta by comparing the two
+// measurements.
+static void CompareMeasurements(const Measurement& baseline,
+                                const Measurement& candidate,
+                                BenchmarkDelta* delta) {
+  if (baseline.constant || candidate.constant) {
+    if (!baseline.constant || !candidate.constant) {
+      LOG(WARNING) << "Cannot compare constant " << delta->descriptor.id
+                   << " with a variable.";
+      return;
+    }
+    delta->baseline = baseline.constant->value;
+    delta->candidate = candidate.constant->value;
+    // Constants have no spread, so any change is significant.
+    delta->p_value = 0.0;
+  } else if (baseline.sampled && candidate.sampled) {
+    const Benchmark::AccumulatedVariable a =
+        Benchmark::AccumulateSampledVariable(*baseline.sampled);
+    const Benchmark::AccumulatedVariable b =
+        Benchmark::AccumulateSampledVariable(*candidate.sampled);
+    delta->baseline = a.mean;
+    delta->candidate = b.mean;
+    delta->p_value = MannWhitneyUTest(GetSampleValues(*baseline.sampled),
+                                      GetSampleValues(*candidate.sampled));
+    delta->baseline_discrepancy = GetTimestampDiscrepancy(*baseline.sampled);
+    delta->candidate_discrepancy = GetTimestampDiscrepancy(*candidate.sampled);
+  } else {
+    // At least one side only has accumulated values.
+    delta->kind = BenchmarkDelta::kAccumulatedVariable;
+    const Benchmark::AccumulatedVariable a = GetAccumulated(baseline);
+    const Benchmark::AccumulatedVariable b = GetAccumulated(candidate);
+    delta->baseline = a.mean;
+    delta->candidate = b.mean;
+    delta->p_value = WelchTTest(a.samples, a.mean, a.standard_deviation,
+                                b.samples, b.mean, b.standard_deviation);
+  }
+  if (delta->baseline != 0.0) {
+    delta->relative_change =
+        (delta->candidate - delta->baseline) / std::fabs(delta->baseline);
+  }
+}
+
+static const char* GetVerdictString(BenchmarkDelta::Verdict verdict) {
+  switch (verdict) {
+    case BenchmarkDelta::kImproved:
+      return "improved";
+    case BenchmarkDelta::kRegressed:
+      return "regressed";
+    case BenchmarkDelta::kMissing:
+      return "missing";
+    case BenchmarkDelta::kAdded:
+      return "added";
+    case BenchmarkDelta::kUnchanged:
+    default:
+      return "unchanged";
+  }
+}
+
+}  // anonymous namespace
+
+BenchmarkComparison CompareBenchmarks(
+    const Benchmark& baseline, const Benchmark& candidate,
+    const BenchmarkComparisonOptions& options) {
+  MeasurementMap baseline_map;
+  MeasurementMap candidate_map;
+  std::vector<std::string> baseline_ids;
+  std::vector<std::string> candidate_ids;
+  GetMeasurements(baseline, &baseline_map, &baseline_ids);
+  GetMeasurements(candidate, &candidate_map, &candidate_ids);
+
+  BenchmarkComparison comparison;
+  for (const std::string& id : baseline_ids) {
+    const Measurement& b = baseline_map[id];
+    BenchmarkDelta delta(GetDescriptor(b), GetKind(b));
+    MeasurementMap::const_iterator it = candidate_map.find(id);
+    if (it == candidate_map.end()) {
+      delta.verdict = BenchmarkDelta::kMissing;
+      ++comparison.regression_count;
+      comparison.deltas.push_back(delta);
+      continue;
+    }
+    CompareMeasurements(b, it->second, &delta);
+
+    const bool significant = delta.p_value < options.significance_level;
+    const double change =
+        options.larger_is_better.count(id) ? -delta.relative_change
+                                           : delta.relative_change;
+    if (significant && change > options.regression_threshold) {
+      delta.verdict = BenchmarkDelta::kRegressed;
+    } else if (delta.baseline_discrepancy > 0.0 &&
+               delta.candidate_discrepancy >
+                   delta.baseline_discrepancy *
+                       (1.0 + options.discrepancy_threshold)) {
+      // The samples got less uniform even if their values did not change.
+      delta.verdict = BenchmarkDelta::kRegressed;
+    } else if (significant && change < -options.regression_threshold) {
+      delta.verdict = BenchmarkDelta::kImproved;
+    }
+    if (delta.verdict == BenchmarkDelta::kRegressed)
+      ++comparison.regression_count;
+    else if (delta.verdict == BenchmarkDelta::kImproved)
+      ++comparison.improvement_count;
+    comparison.deltas.push_back(delta);
+  }
+  for (const std::string& id : candidate_ids) {
+    if (baseline_map.count(id))
+      continue;
+    const Measurement& c = candidate_map[id];
+    BenchmarkDelta delta(GetDescriptor(c), GetKind(c));
+    delta.verdict = BenchmarkDelta::kAdded;
+    comparison.deltas.push_back(delta);
+  }
+  return comparison;
+}
+
+double MannWhitneyUTest(const std::vector<double>& a,
+                        const std::vector<double>& b) {
+  const size_t n1 = a.size();
+  const size_t n2 = b.size();
+  if (n1 < 2U || n2 < 2U)
+    return 1.0;
+
+  // Rank all values together, giving tied values their average rank.
+  std::vector<std::pair<double, bool>> values;
+  values.reserve(n1 + n2);
+  for (size_t i = 0; i < n1; ++i)
+    values.push_back(std::make_pair(a[i], true));
+  for (size_t i = 0; i < n2; ++i)
+    values.push_back(std::make_pair(b[i], false));
+  std::sort(values.begin(), values.end());
+  const double n = static_cast<double>(n1 + n2);
+  double rank_sum_a = 0.0;
+  double tie_sum = 0.0;
+  for (size_t i = 0; i < values.size();) {
+    size_t j = i + 1U;
+    while (j < values.size() && values[j].first == values[i].first)
+      ++j;
+    // Ranks are 1-based.
+    const double rank = 0.5 * static_cast<double>(i + j + 1U);
+    for (size_t k = i; k < j; ++k) {
+      if (values[k].second)
+        rank_sum_a += rank;
+    }
+    const double ties = static_cast<double>(j - i);
+    tie_sum += ties * ties * ties - ties;
+    i = j;
+  }
+
+  const double dn1 = static_cast<double>(n1);
+  const double dn2 = static_cast<double>(n2);
+  const double u = rank_sum_a - dn1 * (dn1 + 1.0) * 0.5;
+  const double mean_u = dn1 * dn2 * 0.5;
+  const double variance_u =
+      dn1 * dn2 / 12.0 * ((n + 1.0) - tie_sum / (n * (n - 1.0)));
+  if (variance_u <= 0.0)
+    return 1.0;
+  // Use a continuity correction, since U is discrete.
+  const double z = std::max(std::fabs(u - mean_u) - 0.5, 0.0) /
+                   std::sqrt(variance_u);
+  return std::erfc(z / std::sqrt(2.0));
+}
+
+double WelchTTest(size_t count_a, double mean_a, double stddev_a,
+                  size_t count_b, double mean_b, double stddev_b) {
+  if (count_a < 2U || count_b < 2U)
+    return 1.0;
+  const double var_a = stddev_a * stddev_a / static_cast<double>(count_a);
+  const double var_b = stddev_b * stddev_b / static_cast<double>(count_b);
+  const double variance = var_a + var_b;
+  if (variance <= 0.0)
+    return mean_a == mean_b ? 1.0 : 0.0;
+  const double t = (mean_b - mean_a) / std::sqrt(variance);
+  // The Welch-Satterthwaite approximation of the degrees of freedom.
+  const double dof =
+      variance * variance /
+      (var_a * var_a / static_cast<double>(count_a - 1U) +
+       var_b * var_b / static_cast<double>(count_b - 1U));
+  // The two-sided tail probability of Student's t distribution.
+  return RegularizedIncompleteBeta(0.5 * dof, 0.5, dof / (dof + t * t));
+}
+
+void OutputBenchmarkComparisonAsJson(const BenchmarkComparison& comparison,
+                                     bool include_unchanged,
+                                     std::ostream& out) {  // NOLINT
+  out << "{" << std::endl
+      << "  \"verdict\": \""
+      << (comparison.HasRegressions() ? "fail" : "pass") << "\"," << std::endl
+      << "  \"regressions\": " << comparison.regression_count << ","
+      << std::endl
+      << "  \"improvements\": " << comparison.improvement_count << ","
+      << std::endl
+      << "  \"deltas\": [";
+  bool first = true;
+  for (const BenchmarkDelta& delta : comparison.deltas) {
+    if (!include_unchanged && delta.verdict == BenchmarkDelta::kUnchanged)
+      continue;
+    out << (first ? "" : ",") << std::endl;
+    first = false;
+    out << "    {" << std::endl
+        << "      \"id\": \"" << delta.descriptor.id << "\"," << std::endl
+        << "      \"group\": \"" << delta.descriptor.group << "\","
+        << std::endl
+        << "      \"units\": \"" << delta.descriptor.units << "\","
+        << std::endl
+        << "      \"verdict\": \"" << GetVerdictString(delta.verdict) << "\"";
+    if (delta.verdict != BenchmarkDelta::kMissing &&
+        delta.verdict != BenchmarkDelta::kAdded) {
+      out << "," << std::endl
+          << "      \"baseline\": " << delta.baseline << "," << std::endl
+          << "      \"candidate\": " << delta.candidate << "," << std::endl
+          << "      \"relative_change\": " << delta.relative_change << ","
+          << std::endl
+          << "      \"p_value\": " << delta.p_value;
+      if (delta.kind == BenchmarkDelta::kSampledVariable) {
+        out << "," << std::endl
+            << "      \"baseline_discrepancy\": " << delta.baseline_discrepancy
+            << "," << std::endl
+            << "      \"candidate_discrepancy\": "
+            << delta.candidate_discrepancy;
+      }
+    }
+    out << std::endl << "    }";
+  }
+  out << (first ? "]" : "\n  ]") << std::endl << "}" << std::endl;
+}
+
+}  // namespace analytics
+}  // namespace ion
@@ -0,0 +1,165 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_ANALYTICS_BENCHMARKCOMPARISON_H_
+#define ION_ANALYTICS_BENCHMARKCOMPARISON_H_
+
+#include <iostream>  // NOLINT
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ion/analytics/benchmark.h"
+
+namespace ion {
+namespace analytics {
+
+// Options that control how CompareBenchmarks() decides whether a change is a
+// regression.
+struct BenchmarkComparisonOptions {
+  BenchmarkComparisonOptions()
+      : regression_threshold(0.05),
+        significance_level(0.05),
+        discrepancy_threshold(0.2) {}
+
+  // The smallest relative change of a mean or constant that counts as a
+  // regression or improvement, e.g., 0.05 for 5%.
+  double regression_threshold;
+  // A change of a variable only counts if the probability that it is due to
+  // chance is below this level.
+  double significance_level;
+  // The smallest relative increase of the timestamp discrepancy of a sampled
+  // variable that counts as a regression.
+  double discrepancy_threshold;
+  // Ids of measurements for which larger values are better, such as frames
+  // per second. Smaller values are better for all others, such as times.
+  std::set<std::string> larger_is_better;
+};
+
+// The comparison of a single constant or variable between two Benchmarks.
+struct BenchmarkDelta {
+  enum Kind {
+    kConstant,
+    kSampledVariable,
+    kAccumulatedVariable,
+  };
+
+  enum Verdict {
+    kUnchanged,
+    kImproved,
+    kRegressed,
+    // The measurement only exists in one of the Benchmarks.
+    kMissing,
+    kAdded,
+  };
+
+  BenchmarkDelta(const Benchmark::Descriptor& descriptor_in, Kind kind_in)
+      : descriptor(descriptor_in),
+        kind(kind_in),
+        baseline(0.0),
+        candidate(0.0),
+        relative_change(0.0),
+        p_value(1.0),
+        baseline_discrepancy(0.0),
+        candidate_discrepancy(0.0),
+        verdict(kUnchanged) {}
+
+  Benchmark::Descriptor descriptor;
+  Kind kind;
+  // The constant values or variable means.
+  double baseline;
+  double candidate;
+  // (candidate - baseline) / |baseline|, or 0 if baseline is 0.
+  double relative_change;
+  // The two-sided probability of a difference at least this large if both
+  // runs come from the same distribution. This is the Mann-Whitney U test for
+  // sampled variables, Welch's t-test for accumulated variables, and 0 for
+  // constants, which have no spread.
+  double p_value;
+  // The absolute discrepancy of the sample timestamps of sampled variables, in
+  // milliseconds, which grows when samples are unevenly spaced (see
+  // discrepancy.h). These are 0 for other kinds.
+  double baseline_discrepancy;
+  double candidate_discrepancy;
+  Verdict verdict;
+};
+
+// The result of CompareBenchmarks().
+struct BenchmarkComparison {
+  BenchmarkComparison() : regression_count(0U), improvement_count(0U) {}
+
+  // Returns whether any measurement regressed or went missing.
+  bool HasRegressions() const { return regression_count > 0U; }
+
+  // One entry per constant or variable id in either Benchmark, with the
+  // baseline's measurements first.
+  std::vector<BenchmarkDelta> deltas;
+  // The number of deltas that regressed or are missing from the candidate.
+  size_t regression_count;
+  size_t improvement_count;
+};
+
+// Compares the candidate Benchmark with the baseline, matching measurements by
+// id. A measurement regresses if it changes by more than the options'
+// regression_threshold in the bad direction with significance, if the
+// discrepancy of a sampled variable grows beyond the discrepancy_threshold, or
+// if it is missing from the candidate.
+ION_API BenchmarkComparison CompareBenchmarks(
+    const Benchmark& baseline, const Benchmark& candidate,
+    const BenchmarkComparisonOptions& options);
+
+// Returns the two-sided p-value of the Mann-Whitney U test for the two sets of
+// values, using the normal approximation with a tie correction. Returns 1 if
+// either set has fewer than two values.
+ION_API double MannWhitneyUTest(const std::vector<double>& a,
+                                const std::vector<double>& b);
+
+// Returns the two-sided p-value of Welch's t-test given the sizes, means and
+// standard deviations of two samples. Returns 1 if either has fewer than two
+// values.
+ION_API double WelchTTest(size_t count_a, double mean_a, double stddev_a,
+                          size_t count_b, double mean_b, double stddev_b);
+
+// Outputs the comparison as JSON, for use by continuous integration. The
+// output is an object with a "verdict" of "pass" or "fail", the regression and
+// improvement counts, and a "deltas" list of the changed measurements, or of
+// all of them if include_unchanged is true. For example:
+//   {
+//     "verdict": "fail",
+//     "regressions": 1,
+//     "improvements": 0,
+//     "deltas": [
+//       {
+//         "id": "frame_time",
+//         "group": "FrameTimeMetric",
+//         "units": "ms",
+//         "verdict": "regressed",
+//         "baseline": 16.1,
+//         "candidate": 18.4,
+//         "relative_change": 0.142857,
+//         "p_value": 0.0001
+//       }
+//     ]
+//   }
+ION_API void OutputBenchmarkComparisonAsJson(
+    const BenchmarkComparison& comparison, bool include_unchanged,
+    std::ostream& out);  // NOLINT
+
+}  // namespace analytics
+}  // namespace ion
+
+#endif  // ION_ANALYTICS_BENCHMARKCOMPARISON_H_
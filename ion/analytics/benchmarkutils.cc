@@ -21,9 +21,13 @@ limitations under the License.
 #include <iomanip>
 #include <set>
 
+#include "base/macros.h"
 #include "ion/base/logging.h"
+#include "ion/base/setting.h"
+#include "ion/base/settingmanager.h"
 #include "ion/math/utils.h"
 #include "ion/port/override/base/port.h"
+#include "third_party/jsoncpp/include/json/json.h"
 
 namespace ion {
 namespace analytics {
@@ -276,7 +280,9 @@ void OutputAccumulatedVariableAsJson(const Benchmark::AccumulatedVariable& v,
       << std::endl
       << indent << "  \"group\": \"" << v.descriptor.group << "\"," << std::endl
       << indent << "  \"mean\": " << v.mean << "," << std::endl
-      << indent << "  \"units\": \"" << v.descriptor.units << "\"";
+      << indent << "  \"units\": \"" << v.descriptor.units << "\","
+      << std::endl
+      << indent << "  \"samples\": " << v.samples;
 
   // Output min/max only if they differ.
   if (v.minimum != v.maximum) {
@@ -354,6 +360,48 @@ void OutputBenchmarkAsJson(const Benchmark& benchmark,
   out << std::endl << indent_in << "}" << std::endl;
 }
 
+bool ReadBenchmarkFromJson(const std::string& json, Benchmark* benchmark) {
+  DCHECK(benchmark);
+  Json::Value root;
+  Json::Reader reader;
+  if (!reader.parse(json, root, false) || !root.isObject()) {
+    LOG(ERROR) << "Failed to parse benchmark JSON: "
+               << reader.getFormattedErrorMessages();
+    return false;
+  }
+
+  const Json::Value& constants = root["constants"];
+  for (Json::ArrayIndex i = 0; i < constants.size(); ++i) {
+    const Json::Value& c = constants[i];
+    benchmark->AddConstant(Benchmark::Constant(
+        Benchmark::Descriptor(c["id"].asString(), c["group"].asString(),
+                              c["description"].asString(),
+                              c["units"].asString()),
+        c["value"].asDouble()));
+  }
+
+  // Sampled variables are written in accumulated form.
+  static const char* kVariableKeys[] = { "sampled_variables",
+                                         "accumulated_variables" };
+  for (size_t k = 0; k < arraysize(kVariableKeys); ++k) {
+    const Json::Value& variables = root[kVariableKeys[k]];
+    for (Json::ArrayIndex i = 0; i < variables.size(); ++i) {
+      const Json::Value& v = variables[i];
+      // Fields that OutputAccumulatedVariableAsJson() skips are implied by the
+      // mean.
+      const double mean = v["mean"].asDouble();
+      benchmark->AddAccumulatedVariable(Benchmark::AccumulatedVariable(
+          Benchmark::Descriptor(v["id"].asString(), v["group"].asString(),
+                                v["description"].asString(),
+                                v["units"].asString()),
+          v["samples"].asUInt(), v.get("minimum", mean).asDouble(),
+          v.get("maximum", mean).asDouble(), mean,
+          v.get("standard_deviation", 0.0).asDouble()));
+    }
+  }
+  return true;
+}
+
 // Outputs benchmark results in pretty format.
 void OutputBenchmarkPretty(const std::string& id_string,
                            bool print_descriptions,
@@ -442,5 +490,40 @@ void OutputBenchmarkPretty(const std::string& id_string,
   out << kSeparator << std::endl;
 }
 
+bool ParseSettingArguments(const std::string& prefix, int argc,
+                           char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg(argv[i]);
+    if (arg.compare(0, 2, "--") != 0) {
+      LOG(ERROR) << "Invalid argument '" << arg << "'";
+      return false;
+    }
+    const size_t equals = arg.find('=');
+    const std::string name = arg.substr(2, equals - 2);
+    const std::string value =
+        equals == std::string::npos ? "true" : arg.substr(equals + 1);
+    base::SettingBase* setting =
+        base::SettingManager::GetSetting(prefix + name);
+    if (!setting || !setting->FromString(value)) {
+      LOG(ERROR) << "Invalid argument '" << arg << "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+void PrintSettingUsage(const std::string& prefix, const char* program,
+                       std::ostream& out) {  // NOLINT
+  out << "Usage: " << program << " [--setting=value]...\n";
+  const base::SettingManager::SettingMap& all_settings =
+      base::SettingManager::GetAllSettings();
+  for (auto it = all_settings.begin(); it != all_settings.end(); ++it) {
+    if (it->first.compare(0, prefix.length(), prefix) == 0)
+      out << "  --" << it->first.substr(prefix.length()) << " ("
+          << it->second->ToString() << "): " << it->second->GetDocString()
+          << "\n";
+  }
+}
+
 }  // namespace analytics
 }  // namespace ion
@@ -70,6 +70,7 @@ ION_API void OutputAccumulatedVariableAsJson(
 //         "group": "Group2",
 //         "mean": 200,
 //         "units": "Units2",
+//         "samples": 3,
 //         "minimum": 100,
 //         "maximum": 300,
 //         "standard_deviation": 20000,
@@ -82,7 +83,8 @@ ION_API void OutputAccumulatedVariableAsJson(
 //         "description": "AVDesc3",
 //         "group": "Group3",
 //         "mean": 2000,
-//         "units": "Units3"
+//         "units": "Units3",
+//         "samples": 18
 //       }
 //     ]
 //   }
@@ -90,6 +92,13 @@ ION_API void OutputBenchmarkAsJson(const Benchmark& benchmark,
                                    const std::string& indent,
                                    std::ostream& out);  // NOLINT
 
+// Reads benchmark results written by OutputBenchmarkAsJson() into benchmark,
+// e.g., to compare them with the results of another run. Since the JSON only
+// holds accumulated values, sampled variables are read as
+// AccumulatedVariables. Returns false and logs an error if json is not valid.
+ION_API bool ReadBenchmarkFromJson(const std::string& json,
+                                   Benchmark* benchmark);
+
 // Outputs benchmark results in a pretty format. Note that SampledVariables are
 // converted to AccumulatedVariables for pretty output.
 ION_API void OutputBenchmarkPretty(const std::string& header_string,
@@ -97,6 +106,20 @@ ION_API void OutputBenchmarkPretty(const std::string& header_string,
                                    const Benchmark& benchmark,
                                    std::ostream& out);  // NOLINT
 
+// Parses the command-line arguments of a benchmark executable that is
+// configured through Settings. Each argument has the form --name=value and
+// sets the Setting named prefix + name; a bare --name sets a bool Setting to
+// true. Returns false and logs an error if an argument is not a known Setting
+// or its value is invalid.
+ION_API bool ParseSettingArguments(const std::string& prefix, int argc,
+                                   char* argv[]);
+
+// Outputs the usage of a benchmark executable whose arguments are parsed by
+// ParseSettingArguments(), listing each Setting whose name starts with prefix
+// with its current value and doc string.
+ION_API void PrintSettingUsage(const std::string& prefix, const char* program,
+                               std::ostream& out);  // NOLINT
+
 }  // namespace analytics
 }  // namespace ion
 
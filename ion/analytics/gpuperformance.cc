@@ -587,15 +587,15 @@ void GpuPerformanceTester::AccumulateMeasurements(
     // replicating the logic here ion::gfx::testing::TraceVerifier
     // trace_verifier(&(*graphics_manager));
 
-    // Acquire tracing stream
-    std::ostream* prev_stream = graphics_manager->GetTracingStream();
-    std::ostringstream trace_stream;
-    graphics_manager->SetTracingStream(&trace_stream);
+    // Record the calls in a binary trace, which avoids formatting them.
+    const gfx::BinaryTracePtr prev_trace = graphics_manager->GetBinaryTrace();
+    gfx::BinaryTracePtr trace(new gfx::BinaryTrace);
+    graphics_manager->SetBinaryTrace(trace);
     renderer->gfx::Renderer::DrawScene(scene);
-    graphics_manager->SetTracingStream(prev_stream);
+    graphics_manager->SetBinaryTrace(prev_trace);
 
-    // Parse tracing stream for counts
-    gfx::TraceCallExtractor extractor(trace_stream.str());
+    // Count the recorded calls.
+    gfx::TraceCallExtractor extractor(*trace);
     num_bind_shader_ += extractor.GetCountOf(kUseProgramString);
     num_bind_texture_ += extractor.GetCountOf(kBindTextureString);
     num_set_uniform_ += extractor.GetCountOf(kUniformString);
@@ -0,0 +1,211 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/analytics/gpuperformancesampler.h"
+
+#include <algorithm>
+
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace analytics {
+
+namespace {
+
+static const uint32 kDefaultSampleInterval = 30U;
+
+static const double kToMega = 1e-6;
+static const double kNanoToMilli = 1e-6;
+static const double kNanoToUnit = 1e-9;
+
+static const char kSampledSceneGroup[] = "Sampled scene";
+
+static const Benchmark::Descriptor kDrawCallsPerFrameDescriptor(
+    "Draw Calls Per Frame", kSampledSceneGroup,
+    "Draw calls issued in a sampled frame", "draw calls");
+
+static const Benchmark::Descriptor kPrimitivesPerFrameDescriptor(
+    "Primitives Per Frame", kSampledSceneGroup,
+    "Primitives drawn in a sampled frame: Triangles; lines; points",
+    "primitives");
+
+static const Benchmark::Descriptor kGpuFrameTimeDescriptor(
+    "GPU Frame Time", kSampledSceneGroup,
+    "GPU time spent on a sampled frame", "ms");
+
+static const Benchmark::Descriptor kPrimitivesPerSecondDescriptor(
+    "Primitives Per Second", kSampledSceneGroup,
+    "Primitives drawn per second of GPU time", "Mprims/s");
+
+static const Benchmark::Descriptor kPixelsPerSecondDescriptor(
+    "Pixels Per Second", kSampledSceneGroup,
+    "Viewport pixels filled per second of GPU time", "Mpixels/s");
+
+}  // anonymous namespace
+
+const size_t GpuPerformanceSampler::kMaxPendingSamples;
+
+GpuPerformanceSampler::GpuPerformanceSampler(
+    const gfx::GraphicsManagerPtr& graphics_manager, uint32 width,
+    uint32 height)
+    : graphics_manager_(graphics_manager),
+      width_(width),
+      height_(height),
+      sample_interval_(kDefaultSampleInterval),
+      has_timer_queries_(
+          graphics_manager->IsExtensionSupported("disjoint_timer_query") ||
+          graphics_manager->IsExtensionSupported("timer_query")),
+      has_disjoint_status_(
+          graphics_manager->IsExtensionSupported("disjoint_timer_query")),
+      frames_since_sample_(kDefaultSampleInterval),
+      is_sampling_(false),
+      prev_call_statistics_enabled_(false),
+      current_query_(0U),
+      sample_count_(0U),
+      draw_calls_(kDrawCallsPerFrameDescriptor),
+      primitives_(kPrimitivesPerFrameDescriptor),
+      gpu_time_(kGpuFrameTimeDescriptor),
+      primitive_rate_(kPrimitivesPerSecondDescriptor),
+      pixel_rate_(kPixelsPerSecondDescriptor) {
+  DCHECK(graphics_manager_.Get());
+}
+
+GpuPerformanceSampler::~GpuPerformanceSampler() {
+  if (is_sampling_)
+    EndFrame();
+  for (std::deque<PendingSample>::const_iterator it = pending_.begin();
+       it != pending_.end(); ++it)
+    free_queries_.push_back(it->query);
+  if (!free_queries_.empty())
+    graphics_manager_->DeleteQueries(static_cast<GLsizei>(free_queries_.size()),
+                                     &free_queries_[0]);
+}
+
+void GpuPerformanceSampler::SetSampleInterval(uint32 frames) {
+  DCHECK_GT(frames, 0U);
+  sample_interval_ = frames > 0U ? frames : 1U;
+}
+
+void GpuPerformanceSampler::BeginFrame() {
+  DCHECK(!is_sampling_) << "BeginFrame() called twice without EndFrame()";
+  ProcessPendingSamples();
+  if (++frames_since_sample_ < sample_interval_ ||
+      pending_.size() >= kMaxPendingSamples)
+    return;
+
+  frames_since_sample_ = 0U;
+  is_sampling_ = true;
+  gfx::GraphicsManager* gm = graphics_manager_.Get();
+  prev_call_statistics_enabled_ = gm->IsCallStatisticsEnabled();
+  gm->ResetCallStatistics();
+  gm->EnableCallStatistics(true);
+  if (has_timer_queries_) {
+    if (free_queries_.empty()) {
+      gm->GenQueries(1, &current_query_);
+    } else {
+      current_query_ = free_queries_.back();
+      free_queries_.pop_back();
+    }
+    if (current_query_)
+      gm->BeginQuery(GL_TIME_ELAPSED_EXT, current_query_);
+  }
+}
+
+void GpuPerformanceSampler::EndFrame() {
+  if (!is_sampling_)
+    return;
+  is_sampling_ = false;
+  gfx::GraphicsManager* gm = graphics_manager_.Get();
+  if (current_query_)
+    gm->EndQuery(GL_TIME_ELAPSED_EXT);
+  PendingSample sample;
+  sample.query = current_query_;
+  sample.statistics = gm->GetCallStatistics();
+  gm->EnableCallStatistics(prev_call_statistics_enabled_);
+  current_query_ = 0U;
+  if (sample.query)
+    pending_.push_back(sample);
+  else if (!has_timer_queries_)
+    AddSample(sample.statistics, 0.0);
+}
+
+const Benchmark GpuPerformanceSampler::GetResults() {
+  Benchmark benchmark;
+  benchmark.AddSampledVariable(draw_calls_.Get());
+  benchmark.AddSampledVariable(primitives_.Get());
+  if (has_timer_queries_) {
+    benchmark.AddSampledVariable(gpu_time_.Get());
+    benchmark.AddSampledVariable(primitive_rate_.Get());
+    benchmark.AddSampledVariable(pixel_rate_.Get());
+  }
+  ResetSamplers();
+  return benchmark;
+}
+
+void GpuPerformanceSampler::ProcessPendingSamples() {
+  gfx::GraphicsManager* gm = graphics_manager_.Get();
+  while (!pending_.empty()) {
+    const PendingSample& sample = pending_.front();
+    GLuint available = 0U;
+    gm->GetQueryObjectuiv(sample.query, GL_QUERY_RESULT_AVAILABLE_EXT,
+                          &available);
+    if (!available)
+      break;
+    GLuint64 elapsed_ns = 0U;
+    gm->GetQueryObjectui64v(sample.query, GL_QUERY_RESULT_EXT, &elapsed_ns);
+    // A disjoint event, such as the GPU changing its frequency, makes the
+    // elapsed time meaningless.
+    GLint disjoint = 0;
+    if (has_disjoint_status_)
+      gm->GetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint)
+      LOG(WARNING) << "***ION: Skipping disjoint GPU performance sample";
+    else
+      AddSample(sample.statistics, static_cast<double>(elapsed_ns));
+    free_queries_.push_back(sample.query);
+    pending_.pop_front();
+  }
+}
+
+void GpuPerformanceSampler::AddSample(
+    const gfx::GraphicsManager::CallStatistics& statistics,
+    double gpu_time_ns) {
+  ++sample_count_;
+  draw_calls_.AddSample(static_cast<double>(statistics.draw_call_count));
+  primitives_.AddSample(static_cast<double>(statistics.primitive_count));
+  if (has_timer_queries_) {
+    // Avoid infinite rates for frames that took no measurable time.
+    const double seconds = std::max(gpu_time_ns, 1.0) * kNanoToUnit;
+    gpu_time_.AddSample(gpu_time_ns * kNanoToMilli);
+    primitive_rate_.AddSample(
+        static_cast<double>(statistics.primitive_count) * kToMega / seconds);
+    pixel_rate_.AddSample(static_cast<double>(width_) *
+                          static_cast<double>(height_) * kToMega / seconds);
+  }
+}
+
+void GpuPerformanceSampler::ResetSamplers() {
+  sample_count_ = 0U;
+  draw_calls_ = Benchmark::VariableSampler(kDrawCallsPerFrameDescriptor);
+  primitives_ = Benchmark::VariableSampler(kPrimitivesPerFrameDescriptor);
+  gpu_time_ = Benchmark::VariableSampler(kGpuFrameTimeDescriptor);
+  primitive_rate_ = Benchmark::VariableSampler(kPrimitivesPerSecondDescriptor);
+  pixel_rate_ = Benchmark::VariableSampler(kPixelsPerSecondDescriptor);
+}
+
+}  // namespace analytics
+}  // namespace ion
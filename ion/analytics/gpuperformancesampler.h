@@ -0,0 +1,157 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_ANALYTICS_GPUPERFORMANCESAMPLER_H_
+#define ION_ANALYTICS_GPUPERFORMANCESAMPLER_H_
+
+#include <deque>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/analytics/benchmark.h"
+#include "ion/gfx/graphicsmanager.h"
+
+namespace ion {
+namespace analytics {
+
+// GpuPerformanceSampler measures the throughput of a live scene while it is
+// rendered as usual, complementing the GpuPerformanceTester, which measures
+// nodes in isolation. Every few frames it samples a single frame: it counts
+// the draw calls and primitives issued through the GraphicsManager and
+// measures the GPU time of the frame with a GL_TIME_ELAPSED query. Queries are
+// read in later frames once their results are available, so sampling never
+// stalls the pipeline, and a sample is skipped if too many are still pending.
+// The overhead is thus bounded by the sample interval.
+//
+// Samples are timestamped, so that the results show how the performance of a
+// scene changes over time. Typical usage:
+//
+//   GpuPerformanceSampler sampler(graphics_manager, width, height);
+//   // For each frame:
+//   sampler.BeginFrame();
+//   renderer->DrawScene(scene);
+//   sampler.EndFrame();
+//   // Once enough frames were rendered:
+//   const Benchmark benchmark = sampler.GetResults();
+//
+// The results contain these sampled variables:
+// - GPU time per frame (if timer queries are supported)
+// - Draw calls per frame
+// - Primitives per frame
+// - Millions of primitives per second (if timer queries are supported)
+// - Millions of pixels per second (if timer queries are supported)
+class ION_API GpuPerformanceSampler {
+ public:
+  // Named indices of the sampled variables in the Benchmark returned by
+  // GetResults(). If timer queries are not supported only the first two are
+  // present.
+  enum VariableIndices {
+    kDrawCallsPerFrame,
+    kPrimitivesPerFrame,
+    kGpuFrameTime,
+    kPrimitivesPerSecond,
+    kPixelsPerSecond
+  };
+
+  // Width and height should be the dimensions of the rendered viewport, and
+  // are used to compute the fill rate.
+  GpuPerformanceSampler(const gfx::GraphicsManagerPtr& graphics_manager,
+                        uint32 width, uint32 height);
+  // The destructor deletes the queries, so the GraphicsManager's OpenGL
+  // context must be current.
+  ~GpuPerformanceSampler();
+
+  // Sets/returns the number of frames between two samples. The default is
+  // 30. An interval of 1 samples every frame.
+  void SetSampleInterval(uint32 frames);
+  uint32 GetSampleInterval() const { return sample_interval_; }
+
+  // Sets/returns the dimensions of the viewport.
+  void SetViewportSize(uint32 width, uint32 height) {
+    width_ = width;
+    height_ = height;
+  }
+  uint32 GetViewportWidth() const { return width_; }
+  uint32 GetViewportHeight() const { return height_; }
+
+  // These must be called around the rendering of each frame. BeginFrame()
+  // also records the samples whose query results have become available.
+  void BeginFrame();
+  void EndFrame();
+
+  // Returns the number of complete samples since the last call to
+  // GetResults().
+  size_t GetSampleCount() const { return sample_count_; }
+
+  // Returns the samples recorded since the last call to GetResults() and
+  // starts over.
+  const Benchmark GetResults();
+
+ private:
+  // A sampled frame whose GPU time is not known yet.
+  struct PendingSample {
+    GLuint query;
+    gfx::GraphicsManager::CallStatistics statistics;
+  };
+
+  // At most this many samples wait for their queries.
+  static const size_t kMaxPendingSamples = 2U;
+
+  // Records the pending samples whose queries have finished.
+  void ProcessPendingSamples();
+  // Adds a sample to the samplers.
+  void AddSample(const gfx::GraphicsManager::CallStatistics& statistics,
+                 double gpu_time_ns);
+  // Creates the samplers for a new set of results.
+  void ResetSamplers();
+
+  gfx::GraphicsManagerPtr graphics_manager_;
+  uint32 width_;
+  uint32 height_;
+  uint32 sample_interval_;
+  // Whether GL_TIME_ELAPSED queries are supported.
+  const bool has_timer_queries_;
+  // Whether GL_GPU_DISJOINT_EXT can be queried.
+  const bool has_disjoint_status_;
+
+  // The number of frames begun since the last sample.
+  uint32 frames_since_sample_;
+  // Whether the current frame is sampled.
+  bool is_sampling_;
+  // Whether call statistics were enabled before the current sample.
+  bool prev_call_statistics_enabled_;
+  // The query of the current sample, or 0.
+  GLuint current_query_;
+
+  std::deque<PendingSample> pending_;
+  std::vector<GLuint> free_queries_;
+
+  size_t sample_count_;
+  Benchmark::VariableSampler draw_calls_;
+  Benchmark::VariableSampler primitives_;
+  Benchmark::VariableSampler gpu_time_;
+  Benchmark::VariableSampler primitive_rate_;
+  Benchmark::VariableSampler pixel_rate_;
+
+  DISALLOW_COPY_AND_ASSIGN(GpuPerformanceSampler);
+};
+
+}  // namespace analytics
+}  // namespace ion
+
+#endif  // ION_ANALYTICS_GPUPERFORMANCESAMPLER_H_
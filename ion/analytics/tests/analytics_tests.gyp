@@ -24,9 +24,11 @@
       'includes': [ '../../dev/test_target.gypi' ],
       'sources' : [
         'benchmark_test.cc',
+        'benchmarkcomparison_test.cc',
         'benchmarkutils_test.cc',
         'discrepancy_test.cc',
         'gpuperformance_test.cc',
+        'gpuperformancesampler_test.cc',
       ],
       'dependencies' : [
         '<(ion_dir)/analytics/analytics.gyp:ionanalytics',
@@ -0,0 +1,269 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/analytics/benchmarkcomparison.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ion/analytics/benchmarkutils.h"
+#include "ion/base/logchecker.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+using ion::analytics::Benchmark;
+using ion::analytics::BenchmarkComparison;
+using ion::analytics::BenchmarkComparisonOptions;
+using ion::analytics::BenchmarkDelta;
+using ion::analytics::CompareBenchmarks;
+using ion::analytics::MannWhitneyUTest;
+using ion::analytics::WelchTTest;
+
+namespace {
+
+// Returns a sampled variable with one sample per value, spaced 10 ms apart.
+Benchmark::SampledVariable MakeSampled(const std::string& id,
+                                       const std::vector<double>& values) {
+  Benchmark::SampledVariable v(
+      Benchmark::Descriptor(id, "Group", "Desc", "ms"));
+  for (size_t i = 0; i < values.size(); ++i)
+    v.samples.push_back(
+        Benchmark::Sample(static_cast<uint32>(i * 10U), values[i]));
+  return v;
+}
+
+// Returns the delta with the passed id.
+const BenchmarkDelta& GetDelta(const BenchmarkComparison& comparison,
+                               const std::string& id) {
+  for (const BenchmarkDelta& delta : comparison.deltas) {
+    if (delta.descriptor.id == id)
+      return delta;
+  }
+  ADD_FAILURE() << "No delta " << id;
+  return comparison.deltas[0];
+}
+
+}  // anonymous namespace
+
+TEST(BenchmarkComparison, MannWhitneyUTest) {
+  const std::vector<double> low = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+  const std::vector<double> high = { 6.0, 7.0, 8.0, 9.0, 10.0 };
+  EXPECT_NEAR(0.012186, MannWhitneyUTest(low, high), 1e-6);
+  EXPECT_NEAR(0.012186, MannWhitneyUTest(high, low), 1e-6);
+  EXPECT_NEAR(1.0, MannWhitneyUTest(low, low), 1e-9);
+  // Identical values have no spread.
+  EXPECT_EQ(1.0, MannWhitneyUTest(std::vector<double>(3, 2.0),
+                                  std::vector<double>(4, 2.0)));
+  // Too few values.
+  EXPECT_EQ(1.0, MannWhitneyUTest(std::vector<double>(1, 1.0), high));
+}
+
+TEST(BenchmarkComparison, WelchTTest) {
+  EXPECT_NEAR(0.038249, WelchTTest(10U, 0.0, 1.0, 10U, 1.0, 1.0), 1e-5);
+  EXPECT_NEAR(0.486269, WelchTTest(5U, 10.0, 2.0, 8U, 11.0, 3.0), 1e-5);
+  EXPECT_NEAR(1.0, WelchTTest(5U, 10.0, 2.0, 8U, 10.0, 3.0), 1e-9);
+  // Without spread, any difference is significant.
+  EXPECT_EQ(0.0, WelchTTest(5U, 10.0, 0.0, 5U, 11.0, 0.0));
+  EXPECT_EQ(1.0, WelchTTest(5U, 10.0, 0.0, 5U, 10.0, 0.0));
+  EXPECT_EQ(1.0, WelchTTest(1U, 10.0, 2.0, 8U, 11.0, 3.0));
+}
+
+TEST(BenchmarkComparison, CompareBenchmarks) {
+  Benchmark baseline;
+  Benchmark candidate;
+  const Benchmark::Descriptor fps("fps", "Group", "Frames per second", "fps");
+  baseline.AddConstant(Benchmark::Constant(fps, 60.0));
+  candidate.AddConstant(Benchmark::Constant(fps, 50.0));
+  const Benchmark::Descriptor count("count", "Group", "Desc", "count");
+  baseline.AddConstant(Benchmark::Constant(count, 100.0));
+  candidate.AddConstant(Benchmark::Constant(count, 80.0));
+  const Benchmark::Descriptor gone("gone", "Group", "Desc", "count");
+  baseline.AddConstant(Benchmark::Constant(gone, 1.0));
+  const Benchmark::Descriptor added("added", "Group", "Desc", "count");
+  candidate.AddConstant(Benchmark::Constant(added, 1.0));
+
+  // A slower frame time, and a noisy one that does not change significantly.
+  baseline.AddSampledVariable(MakeSampled(
+      "frame_time", { 16.0, 16.2, 15.9, 16.1, 16.0, 16.3, 15.8, 16.1 }));
+  candidate.AddSampledVariable(MakeSampled(
+      "frame_time", { 18.0, 18.3, 17.9, 18.1, 18.2, 18.0, 17.8, 18.4 }));
+  baseline.AddSampledVariable(MakeSampled(
+      "noisy", { 10.0, 20.0, 5.0, 30.0, 12.0, 25.0 }));
+  candidate.AddSampledVariable(MakeSampled(
+      "noisy", { 11.0, 21.0, 6.0, 31.0, 13.0, 26.0 }));
+  // An accumulated variable that got faster.
+  const Benchmark::Descriptor draw("draw", "Group", "Desc", "ms");
+  baseline.AddAccumulatedVariable(Benchmark::AccumulatedVariable(
+      draw, 100U, 4.0, 6.0, 5.0, 0.5));
+  candidate.AddAccumulatedVariable(Benchmark::AccumulatedVariable(
+      draw, 100U, 3.0, 5.0, 4.0, 0.5));
+
+  BenchmarkComparisonOptions options;
+  options.larger_is_better.insert("fps");
+  const BenchmarkComparison comparison =
+      CompareBenchmarks(baseline, candidate, options);
+  ASSERT_EQ(7U, comparison.deltas.size());
+  // Baseline measurements come first, in order.
+  EXPECT_EQ("fps", comparison.deltas[0].descriptor.id);
+  EXPECT_EQ("added", comparison.deltas[6].descriptor.id);
+
+  const BenchmarkDelta& fps_delta = GetDelta(comparison, "fps");
+  EXPECT_EQ(BenchmarkDelta::kConstant, fps_delta.kind);
+  EXPECT_EQ(BenchmarkDelta::kRegressed, fps_delta.verdict);
+  EXPECT_EQ(60.0, fps_delta.baseline);
+  EXPECT_EQ(50.0, fps_delta.candidate);
+  EXPECT_NEAR(-1.0 / 6.0, fps_delta.relative_change, 1e-9);
+  // Fewer counts are better by default.
+  EXPECT_EQ(BenchmarkDelta::kImproved, GetDelta(comparison, "count").verdict);
+  EXPECT_EQ(BenchmarkDelta::kMissing, GetDelta(comparison, "gone").verdict);
+  EXPECT_EQ(BenchmarkDelta::kAdded, GetDelta(comparison, "added").verdict);
+
+  const BenchmarkDelta& frame_time = GetDelta(comparison, "frame_time");
+  EXPECT_EQ(BenchmarkDelta::kSampledVariable, frame_time.kind);
+  EXPECT_EQ(BenchmarkDelta::kRegressed, frame_time.verdict);
+  EXPECT_LT(frame_time.p_value, 0.01);
+  EXPECT_GT(frame_time.baseline_discrepancy, 0.0);
+  EXPECT_EQ(frame_time.baseline_discrepancy, frame_time.candidate_discrepancy);
+  const BenchmarkDelta& noisy = GetDelta(comparison, "noisy");
+  EXPECT_GT(noisy.relative_change, options.regression_threshold);
+  EXPECT_GT(noisy.p_value, 0.5);
+  EXPECT_EQ(BenchmarkDelta::kUnchanged, noisy.verdict);
+
+  const BenchmarkDelta& draw_delta = GetDelta(comparison, "draw");
+  EXPECT_EQ(BenchmarkDelta::kAccumulatedVariable, draw_delta.kind);
+  EXPECT_EQ(BenchmarkDelta::kImproved, draw_delta.verdict);
+  EXPECT_LT(draw_delta.p_value, 1e-6);
+
+  // fps, frame_time and the missing constant.
+  EXPECT_EQ(3U, comparison.regression_count);
+  EXPECT_EQ(2U, comparison.improvement_count);
+  EXPECT_TRUE(comparison.HasRegressions());
+
+  // With a large enough threshold only the missing constant is a regression.
+  options.regression_threshold = 0.5;
+  EXPECT_EQ(1U, CompareBenchmarks(baseline, candidate, options)
+                    .regression_count);
+  // Comparing a run with itself never fails.
+  EXPECT_FALSE(CompareBenchmarks(baseline, baseline, options).HasRegressions());
+}
+
+TEST(BenchmarkComparison, Discrepancy) {
+  // The same values, but the candidate's samples arrive in bursts.
+  Benchmark::SampledVariable uneven = MakeSampled(
+      "frame_time", { 16.0, 16.0, 16.0, 16.0, 16.0, 16.0, 16.0, 16.0 });
+  for (size_t i = 4; i < uneven.samples.size(); ++i)
+    uneven.samples[i].time_offset_ms += 100U;
+  Benchmark baseline;
+  Benchmark candidate;
+  baseline.AddSampledVariable(MakeSampled(
+      "frame_time", { 16.0, 16.0, 16.0, 16.0, 16.0, 16.0, 16.0, 16.0 }));
+  candidate.AddSampledVariable(uneven);
+  const BenchmarkComparison comparison =
+      CompareBenchmarks(baseline, candidate, BenchmarkComparisonOptions());
+  ASSERT_EQ(1U, comparison.deltas.size());
+  EXPECT_EQ(0.0, comparison.deltas[0].relative_change);
+  EXPECT_GT(comparison.deltas[0].candidate_discrepancy,
+            comparison.deltas[0].baseline_discrepancy);
+  EXPECT_EQ(BenchmarkDelta::kRegressed, comparison.deltas[0].verdict);
+}
+
+TEST(BenchmarkComparison, CompareWithJson) {
+  // A baseline read back from JSON is compared using its accumulated values.
+  Benchmark run;
+  run.AddSampledVariable(MakeSampled(
+      "frame_time", { 16.0, 16.2, 15.9, 16.1, 16.0, 16.3, 15.8, 16.1 }));
+  run.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("fps", "Group", "Desc", "fps"), 60.0));
+  std::ostringstream s;
+  ion::analytics::OutputBenchmarkAsJson(run, "", s);
+  Benchmark baseline;
+  ASSERT_TRUE(ion::analytics::ReadBenchmarkFromJson(s.str(), &baseline));
+  ASSERT_EQ(1U, baseline.GetConstants().size());
+  ASSERT_EQ(1U, baseline.GetAccumulatedVariables().size());
+  EXPECT_EQ(8U, baseline.GetAccumulatedVariables()[0].samples);
+
+  Benchmark candidate;
+  candidate.AddSampledVariable(MakeSampled(
+      "frame_time", { 18.0, 18.3, 17.9, 18.1, 18.2, 18.0, 17.8, 18.4 }));
+  candidate.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("fps", "Group", "Desc", "fps"), 60.0));
+  const BenchmarkComparison comparison =
+      CompareBenchmarks(baseline, candidate, BenchmarkComparisonOptions());
+  const BenchmarkDelta& frame_time = GetDelta(comparison, "frame_time");
+  EXPECT_EQ(BenchmarkDelta::kAccumulatedVariable, frame_time.kind);
+  EXPECT_EQ(BenchmarkDelta::kRegressed, frame_time.verdict);
+  EXPECT_EQ(BenchmarkDelta::kUnchanged, GetDelta(comparison, "fps").verdict);
+
+  // Invalid JSON is an error.
+  ion::base::LogChecker log_checker;
+  Benchmark invalid;
+  EXPECT_FALSE(ion::analytics::ReadBenchmarkFromJson("{ oops", &invalid));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Failed to parse"));
+}
+
+TEST(BenchmarkComparison, OutputAsJson) {
+  Benchmark baseline;
+  Benchmark candidate;
+  const Benchmark::Descriptor a("a", "Group", "Desc", "ms");
+  const Benchmark::Descriptor b("b", "Group", "Desc", "ms");
+  baseline.AddConstant(Benchmark::Constant(a, 2.0));
+  candidate.AddConstant(Benchmark::Constant(a, 3.0));
+  baseline.AddConstant(Benchmark::Constant(b, 1.0));
+  candidate.AddConstant(Benchmark::Constant(b, 1.0));
+  const BenchmarkComparison comparison =
+      CompareBenchmarks(baseline, candidate, BenchmarkComparisonOptions());
+
+  std::ostringstream s;
+  ion::analytics::OutputBenchmarkComparisonAsJson(comparison, false, s);
+  EXPECT_EQ(
+      "{\n"
+      "  \"verdict\": \"fail\",\n"
+      "  \"regressions\": 1,\n"
+      "  \"improvements\": 0,\n"
+      "  \"deltas\": [\n"
+      "    {\n"
+      "      \"id\": \"a\",\n"
+      "      \"group\": \"Group\",\n"
+      "      \"units\": \"ms\",\n"
+      "      \"verdict\": \"regressed\",\n"
+      "      \"baseline\": 2,\n"
+      "      \"candidate\": 3,\n"
+      "      \"relative_change\": 0.5,\n"
+      "      \"p_value\": 0\n"
+      "    }\n"
+      "  ]\n"
+      "}\n", s.str());
+
+  // A run compared with itself passes.
+  s.str("");
+  ion::analytics::OutputBenchmarkComparisonAsJson(
+      CompareBenchmarks(baseline, baseline, BenchmarkComparisonOptions()),
+      false, s);
+  EXPECT_EQ(
+      "{\n"
+      "  \"verdict\": \"pass\",\n"
+      "  \"regressions\": 0,\n"
+      "  \"improvements\": 0,\n"
+      "  \"deltas\": []\n"
+      "}\n", s.str());
+
+  // Unchanged measurements can be included too.
+  s.str("");
+  ion::analytics::OutputBenchmarkComparisonAsJson(comparison, true, s);
+  EXPECT_NE(std::string::npos, s.str().find("\"id\": \"b\""));
+  EXPECT_NE(std::string::npos, s.str().find("\"verdict\": \"unchanged\""));
+}
@@ -22,6 +22,7 @@ limitations under the License.
 #include <vector>
 
 #include "ion/base/logchecker.h"
+#include "ion/base/setting.h"
 #include "ion/base/tests/multilinestringsequal.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -423,6 +424,7 @@ TEST(BenchmarkUtils, OutputBenchmarkAsJson) {
       "        \"group\": \"Group1\",\n"
       "        \"mean\": 20,\n"
       "        \"units\": \"Units1\",\n"
+      "        \"samples\": 3,\n"
       "        \"minimum\": 10,\n"
       "        \"maximum\": 30,\n"
       "        \"standard_deviation\": 10,\n"
@@ -434,6 +436,7 @@ TEST(BenchmarkUtils, OutputBenchmarkAsJson) {
       "        \"group\": \"Group2\",\n"
       "        \"mean\": 500,\n"
       "        \"units\": \"Units2\",\n"
+      "        \"samples\": 3,\n"
       "        \"minimum\": 100,\n"
       "        \"maximum\": 900,\n"
       "        \"standard_deviation\": 400,\n"
@@ -447,6 +450,7 @@ TEST(BenchmarkUtils, OutputBenchmarkAsJson) {
       "        \"group\": \"Group1\",\n"
       "        \"mean\": 100,\n"
       "        \"units\": \"Units1\",\n"
+      "        \"samples\": 4,\n"
       "        \"minimum\": 99,\n"
       "        \"maximum\": 101,\n"
       "        \"standard_deviation\": 2,\n"
@@ -458,6 +462,7 @@ TEST(BenchmarkUtils, OutputBenchmarkAsJson) {
       "        \"group\": \"Group2\",\n"
       "        \"mean\": 1000,\n"
       "        \"units\": \"Units2\",\n"
+      "        \"samples\": 10,\n"
       "        \"minimum\": 999,\n"
       "        \"maximum\": 1001,\n"
       "        \"standard_deviation\": 2,\n"
@@ -468,14 +473,16 @@ TEST(BenchmarkUtils, OutputBenchmarkAsJson) {
       "        \"description\": \"AVDesc3\",\n"
       "        \"group\": \"Group3\",\n"
       "        \"mean\": 2000,\n"
-      "        \"units\": \"Units3\"\n"
+      "        \"units\": \"Units3\",\n"
+      "        \"samples\": 18\n"
       "      },\n"
       "      {\n"
       "        \"id\": \"AVar4\",\n"
       "        \"description\": \"AVDesc4\",\n"
       "        \"group\": \"Group4\",\n"
       "        \"mean\": 4000,\n"
-      "        \"units\": \"Units4\"\n"
+      "        \"units\": \"Units4\",\n"
+      "        \"samples\": 18\n"
       "      }\n"
       "    ]\n"
       "  }\n";
@@ -555,3 +562,45 @@ TEST(BenchmarkUtils, OutputBenchmarkPretty) {
   EXPECT_TRUE(ion::base::testing::MultiLineStringsEqual(
       kExpectedNoDescriptions, s_no_descriptions.str()));
 }
+
+TEST(BenchmarkUtils, ParseSettingArguments) {
+  LogChecker log_checker;
+  ion::base::Setting<int> count("benchmarkutils_test/count", 1, "Count doc");
+  ion::base::Setting<bool> flag("benchmarkutils_test/flag", false,
+                                "Flag doc");
+
+  char program[] = "program";
+  char count_arg[] = "--count=5";
+  char flag_arg[] = "--flag";
+  char* args[] = {program, count_arg, flag_arg};
+  EXPECT_TRUE(ion::analytics::ParseSettingArguments("benchmarkutils_test/", 3,
+                                                    args));
+  EXPECT_EQ(5, count.GetValue());
+  EXPECT_TRUE(flag.GetValue());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Unknown settings, invalid values and arguments that are not settings
+  // are rejected.
+  char unknown_arg[] = "--unknown=1";
+  char invalid_arg[] = "--count=five";
+  char bare_arg[] = "count=5";
+  char* bad_args[] = {unknown_arg, invalid_arg, bare_arg};
+  for (int i = 0; i < 3; ++i) {
+    char* argv[] = {program, bad_args[i]};
+    EXPECT_FALSE(ion::analytics::ParseSettingArguments("benchmarkutils_test/",
+                                                       2, argv));
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "Invalid argument"));
+  }
+  // Settings are only found with the passed prefix.
+  char* prefixed_args[] = {program, count_arg};
+  EXPECT_FALSE(
+      ion::analytics::ParseSettingArguments("other/", 2, prefixed_args));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Invalid argument"));
+
+  std::ostringstream s;
+  ion::analytics::PrintSettingUsage("benchmarkutils_test/", "program", s);
+  EXPECT_EQ("Usage: program [--setting=value]...\n"
+            "  --count (5): Count doc\n"
+            "  --flag (true): Flag doc\n",
+            s.str());
+}
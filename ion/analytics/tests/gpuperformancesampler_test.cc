@@ -0,0 +1,141 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/analytics/gpuperformancesampler.h"
+
+#include <memory>
+#include <vector>
+
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace analytics {
+
+namespace {
+
+class GpuPerformanceSamplerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    visual_.reset(new gfx::testing::MockVisual(64, 32));
+    gm_.Reset(new gfx::testing::MockGraphicsManager());
+  }
+  void TearDown() override {
+    gm_.Reset(NULL);
+    visual_.reset();
+  }
+
+  // Renders a frame of a triangle pair per draw call.
+  void RenderFrame(GpuPerformanceSampler* sampler, int draw_calls) {
+    sampler->BeginFrame();
+    for (int i = 0; i < draw_calls; ++i)
+      gm_->DrawArrays(GL_TRIANGLES, 0, 6);
+    sampler->EndFrame();
+    // There is no program bound.
+    gm_->SetErrorCode(GL_NO_ERROR);
+  }
+
+  std::unique_ptr<gfx::testing::MockVisual> visual_;
+  gfx::testing::MockGraphicsManagerPtr gm_;
+};
+
+}  // anonymous namespace
+
+TEST_F(GpuPerformanceSamplerTest, SamplesFrames) {
+  GpuPerformanceSampler sampler(gm_, 64U, 32U);
+  EXPECT_EQ(30U, sampler.GetSampleInterval());
+  EXPECT_EQ(64U, sampler.GetViewportWidth());
+  EXPECT_EQ(32U, sampler.GetViewportHeight());
+  sampler.SetSampleInterval(2U);
+  EXPECT_EQ(2U, sampler.GetSampleInterval());
+
+  // Frames 0, 2 and 4 are sampled, and each sample is complete once its query
+  // has been read at the start of the next frame.
+  for (int i = 0; i < 6; ++i)
+    RenderFrame(&sampler, i + 1);
+  EXPECT_EQ(3U, sampler.GetSampleCount());
+  // Statistics are only enabled during sampled frames.
+  EXPECT_FALSE(gm_->IsCallStatisticsEnabled());
+
+  const Benchmark benchmark = sampler.GetResults();
+  EXPECT_EQ(0U, sampler.GetSampleCount());
+  EXPECT_TRUE(benchmark.GetConstants().empty());
+  const std::vector<Benchmark::SampledVariable>& variables =
+      benchmark.GetSampledVariables();
+  ASSERT_EQ(5U, variables.size());
+  EXPECT_EQ("Draw Calls Per Frame",
+            variables[GpuPerformanceSampler::kDrawCallsPerFrame].descriptor.id);
+  EXPECT_EQ("GPU Frame Time",
+            variables[GpuPerformanceSampler::kGpuFrameTime].descriptor.id);
+  for (size_t i = 0; i < variables.size(); ++i) {
+    SCOPED_TRACE(variables[i].descriptor.id);
+    ASSERT_EQ(3U, variables[i].samples.size());
+    EXPECT_FALSE(variables[i].descriptor.units.empty());
+    EXPECT_FALSE(variables[i].descriptor.group.empty());
+  }
+  const std::vector<Benchmark::Sample>& draw_calls =
+      variables[GpuPerformanceSampler::kDrawCallsPerFrame].samples;
+  EXPECT_EQ(1.0, draw_calls[0].value);
+  EXPECT_EQ(3.0, draw_calls[1].value);
+  EXPECT_EQ(5.0, draw_calls[2].value);
+  EXPECT_LE(draw_calls[0].time_offset_ms, draw_calls[2].time_offset_ms);
+  EXPECT_EQ(
+      10.0,
+      variables[GpuPerformanceSampler::kPrimitivesPerFrame].samples[2].value);
+  // The mock reports a GPU time of 1 ns for every query.
+  EXPECT_DOUBLE_EQ(
+      1e-6, variables[GpuPerformanceSampler::kGpuFrameTime].samples[0].value);
+  EXPECT_DOUBLE_EQ(
+      2e3,
+      variables[GpuPerformanceSampler::kPrimitivesPerSecond].samples[0].value);
+  EXPECT_DOUBLE_EQ(
+      64.0 * 32.0 * 1e3,
+      variables[GpuPerformanceSampler::kPixelsPerSecond].samples[1].value);
+
+  // The results start over.
+  RenderFrame(&sampler, 1);
+  RenderFrame(&sampler, 1);
+  EXPECT_EQ(1U, sampler.GetSampleCount());
+  EXPECT_EQ(1U, sampler.GetResults().GetSampledVariables()[0].samples.size());
+}
+
+TEST_F(GpuPerformanceSamplerTest, PreservesCallStatistics) {
+  GpuPerformanceSampler sampler(gm_, 64U, 32U);
+  sampler.SetSampleInterval(1U);
+  gm_->EnableCallStatistics(true);
+  RenderFrame(&sampler, 2);
+  EXPECT_TRUE(gm_->IsCallStatisticsEnabled());
+  gm_->EnableCallStatistics(false);
+}
+
+TEST_F(GpuPerformanceSamplerTest, NoTimerQueries) {
+  gm_->SetExtensionsString("");
+  GpuPerformanceSampler sampler(gm_, 64U, 32U);
+  sampler.SetSampleInterval(1U);
+  RenderFrame(&sampler, 2);
+  // Without queries a sample is complete right away.
+  EXPECT_EQ(1U, sampler.GetSampleCount());
+  const Benchmark benchmark = sampler.GetResults();
+  ASSERT_EQ(2U, benchmark.GetSampledVariables().size());
+  EXPECT_EQ(
+      4.0, benchmark.GetSampledVariables()
+               [GpuPerformanceSampler::kPrimitivesPerFrame].samples[0].value);
+}
+
+}  // namespace analytics
+}  // namespace ion
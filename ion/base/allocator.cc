@@ -17,7 +17,10 @@ limitations under the License.
 
 #include "ion/base/allocator.h"
 
+#include <algorithm>
+
 #include "ion/base/allocationmanager.h"
+#include "ion/port/memory.h"
 
 namespace ion {
 namespace base {
@@ -42,5 +45,48 @@ void Allocator::DeallocateMemory(void* p) {
   Deallocate(p);
 }
 
+void* Allocator::AllocateAlignedMemory(size_t size, size_t alignment) {
+  DCHECK(alignment && !(alignment & (alignment - 1U)))
+      << "Alignment " << alignment << " is not a power of 2";
+  DCHECK_LE(alignment, port::GetPageSize());
+  void* ptr = AllocateAligned(size, alignment);
+  if (!ptr)
+    return NULL;
+  DCHECK_EQ(0U, reinterpret_cast<size_t>(ptr) % alignment);
+  // Huge pages only help blocks that span at least one of them.
+  const size_t huge_page_size = port::GetHugePageSize();
+  if (huge_page_size && size >= huge_page_size)
+    port::AdviseHugePages(ptr, size);
+  if (AllocationTracker* tracker = tracker_.Get())
+    tracker->TrackAllocation(*this, size, ptr);
+  return ptr;
+}
+
+void Allocator::DeallocateAlignedMemory(void* p) {
+  if (AllocationTracker* tracker = tracker_.Get())
+    tracker->TrackDeallocation(*this, p);
+  DeallocateAligned(p);
+}
+
+void* Allocator::AllocateAligned(size_t size, size_t alignment) {
+  // Leave room for the address of the block and for the offset needed to
+  // align the memory after it.
+  alignment = std::max(alignment, sizeof(void*));
+  uint8* block =
+      static_cast<uint8*>(Allocate(size + sizeof(void*) + alignment - 1U));
+  if (!block)
+    return NULL;
+  const size_t start = reinterpret_cast<size_t>(block + sizeof(void*));
+  uint8* ptr = block + sizeof(void*) + (alignment - start % alignment) %
+      alignment;
+  reinterpret_cast<void**>(ptr)[-1] = block;
+  return ptr;
+}
+
+void Allocator::DeallocateAligned(void* p) {
+  if (p)
+    Deallocate(static_cast<void**>(p)[-1]);
+}
+
 }  // namespace base
 }  // namespace ion
@@ -66,6 +66,19 @@ class ION_API Allocator : public Shareable {
   // Deallocates a previously-allocated memory block.
   void DeallocateMemory(void* p);
 
+  // Allocates memory of the given size whose address is a multiple of
+  // alignment, which must be a power of 2 no larger than the page size, e.g.,
+  // kCacheLineAlignment for aligned SIMD loads. Blocks of at least the huge
+  // page size are backed by huge pages where the OS supports them. The memory
+  // must be freed with DeallocateAlignedMemory().
+  void* AllocateAlignedMemory(size_t size, size_t alignment);
+
+  // Deallocates a memory block returned by AllocateAlignedMemory().
+  void DeallocateAlignedMemory(void* p);
+
+  // The size of a cache line on all supported platforms.
+  static const size_t kCacheLineAlignment = 64U;
+
   // Returns the correct Allocator to use to allocate memory with a specific
   // lifetime. The base class implements this to return the default Allocator
   // for the lifetime from the AllocationManager. Derived classes may override
@@ -98,6 +111,12 @@ class ION_API Allocator : public Shareable {
   // a call to Allocate().
   virtual void Deallocate(void* p) = 0;
 
+  // Derived classes may define these to allocate aligned memory more
+  // efficiently. The base class over-allocates a block with Allocate() and
+  // stores its address just before the aligned memory.
+  virtual void* AllocateAligned(size_t size, size_t alignment);
+  virtual void DeallocateAligned(void* p);
+
  private:
   AllocationTrackerPtr tracker_;
 
@@ -0,0 +1,138 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/arenaallocator.h"
+
+#include <cstdlib>  // For malloc() and free()
+
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// Every allocation is preceded by a header recording the arena it came from,
+// or NULL if it came from the heap. The header is as large as the alignment
+// that malloc() guarantees, so that the memory following it is as well
+// aligned.
+union Header {
+  void* arena;
+  long double max_align_ld;
+  void* max_align_p;
+  uint64 max_align_i;
+};
+static const size_t kHeaderSize = sizeof(Header);
+
+// Rounds the passed size up to a multiple of the header size.
+static size_t AlignSize(size_t size) {
+  return (size + kHeaderSize - 1U) / kHeaderSize * kHeaderSize;
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// ArenaAllocator::Arena struct definition.
+//
+//-----------------------------------------------------------------------------
+
+struct ArenaAllocator::Arena {
+  Arena() : memory(NULL), offset(0U), frame(0U), live_count(0U) {}
+  ~Arena() { free(memory); }
+
+  // The arena memory, which is allocated on first use.
+  char* memory;
+  // The offset of the next allocation within memory.
+  size_t offset;
+  // The frame in which the arena was last rewound.
+  uint64 frame;
+  // The number of allocations that have not been deallocated. Memory may be
+  // deallocated in a thread other than the one that allocated it.
+  std::atomic<size_t> live_count;
+};
+
+//-----------------------------------------------------------------------------
+//
+// ArenaAllocator class functions.
+//
+//-----------------------------------------------------------------------------
+
+const size_t ArenaAllocator::kDefaultArenaSize;
+
+ArenaAllocator::ArenaAllocator()
+    : arena_size_(kDefaultArenaSize), frame_(0U), heap_allocation_count_(0U) {}
+
+ArenaAllocator::ArenaAllocator(size_t arena_size)
+    : arena_size_(AlignSize(arena_size)),
+      frame_(0U),
+      heap_allocation_count_(0U) {}
+
+ArenaAllocator::~ArenaAllocator() {}
+
+size_t ArenaAllocator::GetArenaBytesUsed() {
+  return GetArena()->offset;
+}
+
+ArenaAllocator::Arena* ArenaAllocator::GetArena() {
+  Arena* arena = arenas_.Get();
+  const uint64 frame = frame_;
+  if (arena->frame != frame && !arena->live_count) {
+    arena->offset = 0U;
+    arena->frame = frame;
+  }
+  return arena;
+}
+
+void* ArenaAllocator::Allocate(size_t size) {
+  const size_t total_size = kHeaderSize + AlignSize(size);
+  Arena* arena = GetArena();
+  Header* header = NULL;
+  if (arena->offset + total_size <= arena_size_) {
+    if (!arena->memory)
+      arena->memory = static_cast<char*>(malloc(arena_size_));
+    if (arena->memory) {
+      header = reinterpret_cast<Header*>(arena->memory + arena->offset);
+      header->arena = arena;
+      arena->offset += total_size;
+      ++arena->live_count;
+    }
+  }
+  if (!header) {
+    header = static_cast<Header*>(malloc(total_size));
+    if (!header)
+      return NULL;
+    header->arena = NULL;
+    ++heap_allocation_count_;
+  }
+  return header + 1;
+}
+
+void ArenaAllocator::Deallocate(void* p) {
+  if (!p)
+    return;
+  Header* header = static_cast<Header*>(p) - 1;
+  if (Arena* arena = static_cast<Arena*>(header->arena)) {
+    DCHECK_GT(arena->live_count, 0U);
+    --arena->live_count;
+  } else {
+    free(header);
+  }
+}
+
+}  // namespace base
+}  // namespace ion
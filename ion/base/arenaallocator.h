@@ -0,0 +1,104 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_ARENAALLOCATOR_H_
+#define ION_BASE_ARENAALLOCATOR_H_
+
+#include <atomic>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/threadlocalobject.h"
+
+namespace ion {
+namespace base {
+
+// ArenaAllocator is an Allocator for transient memory, intended to be
+// installed as the default Allocator for kShortTerm allocations:
+//
+//   base::AllocationManager::SetDefaultAllocatorForLifetime(
+//       base::kShortTerm, new base::ArenaAllocator);
+//
+// Each thread allocates from its own fixed-size arena by advancing an offset,
+// so allocation needs neither malloc() nor a lock. Deallocating arena memory
+// does nothing; instead, the application calls EndFrame() at a frame
+// boundary, after which each thread's arena is rewound the next time that
+// thread allocates. Allocations that do not fit in the remainder of an arena
+// fall back to malloc().
+//
+// Memory should therefore be deallocated in the frame it was allocated in. An
+// arena that still holds live memory when a frame ends is not rewound; it
+// keeps filling up, and then falls back to the heap, until all of its memory
+// has been deallocated.
+class ION_API ArenaAllocator : public Allocator {
+ public:
+  // The default size of each thread's arena.
+  static const size_t kDefaultArenaSize = 1024U * 1024U;
+
+  // The passed size is that of the arena of each thread that uses this.
+  ArenaAllocator();
+  explicit ArenaAllocator(size_t arena_size);
+
+  // Ends the current frame. Memory allocated by any thread in this frame
+  // should have been deallocated; arenas are rewound lazily.
+  void EndFrame() { ++frame_; }
+
+  // Returns the size of each thread's arena.
+  size_t GetArenaSize() const { return arena_size_; }
+
+  // Returns the number of bytes that the calling thread has allocated from its
+  // arena since it was last rewound.
+  size_t GetArenaBytesUsed();
+
+  // Returns the number of allocations that did not fit in an arena and were
+  // made with malloc() instead.
+  uint64 GetHeapAllocationCount() const { return heap_allocation_count_; }
+
+ protected:
+  // The destructor is protected because all instances should be managed
+  // through SharedPtr.
+  ~ArenaAllocator() override;
+
+  // Allocator interface.
+  void* Allocate(size_t size) override;
+  void Deallocate(void* p) override;
+
+ private:
+  // The memory of a single thread.
+  struct Arena;
+
+  // Returns the calling thread's arena, rewinding it if a frame has ended
+  // since it was last used and all of its memory has been deallocated.
+  Arena* GetArena();
+
+  const size_t arena_size_;
+  ThreadLocalObject<Arena> arenas_;
+  // The current frame, which arenas compare with the frame they were last
+  // rewound in.
+  std::atomic<uint64> frame_;
+  std::atomic<uint64> heap_allocation_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(ArenaAllocator);
+};
+
+typedef SharedPtr<ArenaAllocator> ArenaAllocatorPtr;
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_ARENAALLOCATOR_H_
@@ -0,0 +1,163 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/asynclogentrywriter.h"
+
+#include <cstring>
+#include <functional>
+#include <sstream>
+
+#include "ion/base/lockguards.h"
+#include "ion/port/threadutils.h"
+
+namespace ion {
+namespace base {
+
+AsyncLogEntryWriter::AsyncLogEntryWriter()
+    : AsyncLogEntryWriter(kDefaultCapacity) {}
+
+AsyncLogEntryWriter::AsyncLogEntryWriter(size_t capacity)
+    : previous_writer_(GetLogEntryWriter()),
+      queue_(AllocatorPtr(), capacity),
+      stop_(false),
+      queued_count_(0U),
+      written_count_(0U),
+      dropped_count_(0U),
+      reported_dropped_count_(0U),
+      max_entries_per_second_(0U) {
+  for (size_t i = 0; i < kRateLimitSiteCount; ++i)
+    site_counts_[i] = 0U;
+  thread_.reset(new ThreadSpawner(
+      "AsyncLogEntryWriter",
+      std::bind(&AsyncLogEntryWriter::WriteEntries, this)));
+  SetLogEntryWriter(this);
+}
+
+AsyncLogEntryWriter::~AsyncLogEntryWriter() {
+  SetLogEntryWriter(previous_writer_);
+  stop_ = true;
+  entries_available_.Post();
+  thread_.reset();
+  // Write anything queued by a thread that was logging when this was
+  // uninstalled.
+  Entry entry;
+  while (queue_.TryPop(&entry))
+    WriteEntry(&entry);
+}
+
+void AsyncLogEntryWriter::Write(port::LogSeverity severity,
+                                const std::string& message) {
+  if (severity == port::FATAL || severity == port::DFATAL) {
+    Flush();
+    LockGuard guard(&write_mutex_);
+    previous_writer_->Write(severity, message);
+    return;
+  }
+  if (!IsWithinRateLimit(message)) {
+    ++dropped_count_;
+    return;
+  }
+
+  Entry entry;
+  entry.severity = severity;
+  entry.length = static_cast<uint32>(message.size());
+  if (message.size() < Entry::kInlineSize) {
+    entry.overflow = NULL;
+    memcpy(entry.text, message.data(), message.size());
+  } else {
+    entry.overflow = new char[message.size()];
+    memcpy(entry.overflow, message.data(), message.size());
+  }
+  if (queue_.TryPush(entry)) {
+    ++queued_count_;
+    entries_available_.Post();
+  } else {
+    delete [] entry.overflow;
+    ++dropped_count_;
+  }
+}
+
+void AsyncLogEntryWriter::Flush() {
+  const uint64 queued_count = queued_count_;
+  while (written_count_ < queued_count)
+    port::YieldThread();
+}
+
+bool AsyncLogEntryWriter::IsWithinRateLimit(const std::string& message) {
+  const uint32 max_count = max_entries_per_second_;
+  if (!max_count)
+    return true;
+
+  // Identify the call site by an FNV-1a hash of the "[file:line]" prefix.
+  uint32 hash = 2166136261U;
+  if (!message.empty() && message[0] == '[') {
+    for (size_t i = 1; i < message.size() && message[i] != ']'; ++i) {
+      hash ^= static_cast<uint8>(message[i]);
+      hash *= 16777619U;
+    }
+  }
+  std::atomic<uint64>& site = site_counts_[hash % kRateLimitSiteCount];
+  const uint64 second = static_cast<uint64>(timer_.GetInS());
+  uint64 state = site.load(std::memory_order_relaxed);
+  for (;;) {
+    uint64 new_state;
+    if ((state >> 32) != second)
+      new_state = (second << 32) | 1U;
+    else if ((state & 0xffffffffU) >= max_count)
+      return false;
+    else
+      new_state = state + 1U;
+    if (site.compare_exchange_weak(state, new_state,
+                                   std::memory_order_relaxed))
+      return true;
+  }
+}
+
+void AsyncLogEntryWriter::WriteEntry(Entry* entry) {
+  const std::string message(entry->overflow ? entry->overflow : entry->text,
+                            entry->length);
+  delete [] entry->overflow;
+  {
+    LockGuard guard(&write_mutex_);
+    previous_writer_->Write(entry->severity, message);
+  }
+  ++written_count_;
+}
+
+bool AsyncLogEntryWriter::WriteEntries() {
+  Entry entry;
+  for (;;) {
+    entries_available_.Wait();
+    while (queue_.TryPop(&entry))
+      WriteEntry(&entry);
+
+    const uint64 dropped_count = dropped_count_;
+    if (dropped_count != reported_dropped_count_) {
+      std::ostringstream str;
+      str << "[" << __FILE__ << ":" << __LINE__ << "] Dropped "
+          << dropped_count - reported_dropped_count_ << " log messages";
+      reported_dropped_count_ = dropped_count;
+      LockGuard guard(&write_mutex_);
+      previous_writer_->Write(port::WARNING, str.str());
+    }
+    if (stop_)
+      return true;
+  }
+}
+
+}  // namespace base
+}  // namespace ion
@@ -0,0 +1,139 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_ASYNCLOGENTRYWRITER_H_
+#define ION_BASE_ASYNCLOGENTRYWRITER_H_
+
+#include <memory>
+#include <string>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/logging.h"
+#include "ion/base/mpscqueue.h"
+#include "ion/base/threadspawner.h"
+#include "ion/port/atomic.h"
+#include "ion/port/mutex.h"
+#include "ion/port/semaphore.h"
+#include "ion/port/timer.h"
+
+namespace ion {
+namespace base {
+
+// An AsyncLogEntryWriter moves the cost of writing log messages off the
+// threads that log them. While it exists it is installed as the log-writer,
+// and it passes every message to the writer that was installed before it
+// (which may be the platform default or a custom writer) from a background
+// thread. Logging threads only copy the message into a preallocated entry of a
+// lock-free queue, so they never block on stderr, logcat, or a slow custom
+// writer.
+//
+// Like NullLogEntryWriter, its lifetime controls when it is used:
+//   {
+//     AsyncLogEntryWriter async_writer;
+//     ...  // Log without blocking.
+//   }  // Queued messages are written and the old writer is restored.
+//
+// Messages that do not fit in an entry are copied to the heap. If the queue is
+// full, or a call site exceeds the rate limit (see SetMaxEntriesPerSecond()),
+// the message is dropped, and the number of dropped messages is reported in a
+// warning once the queue drains. FATAL and DFATAL messages are written
+// synchronously after all queued messages, so that they are visible before the
+// break handler runs.
+class ION_API AsyncLogEntryWriter : public port::LogEntryWriter {
+ public:
+  // The default number of entries the queue holds.
+  static const size_t kDefaultCapacity = 1024U;
+
+  // Installs the writer with a queue holding at least |capacity| entries.
+  AsyncLogEntryWriter();
+  explicit AsyncLogEntryWriter(size_t capacity);
+
+  // Writes all queued messages, stops the background thread, and restores the
+  // previous log-writer.
+  ~AsyncLogEntryWriter() override;
+
+  // LogEntryWriter impl.
+  void Write(port::LogSeverity severity, const std::string& message) override;
+
+  // Blocks until all messages queued before the call have been written.
+  void Flush();
+
+  // Limits each call site, identified by the "[file:line]" prefix that LOG()
+  // adds, to |count| messages per second; further messages in the same second
+  // are dropped. A count of 0, the default, disables the limit. Sites are
+  // tracked in a small fixed table, so sites that share a table entry share a
+  // limit, and messages without the prefix share one limit.
+  void SetMaxEntriesPerSecond(uint32 count) { max_entries_per_second_ = count; }
+  uint32 GetMaxEntriesPerSecond() const { return max_entries_per_second_; }
+
+  // Returns the total number of messages dropped because the queue was full or
+  // a call site exceeded its rate limit.
+  uint64 GetDroppedCount() const { return dropped_count_; }
+
+ private:
+  // A queued message. Short messages are stored inline, so queuing them does
+  // not allocate.
+  struct Entry {
+    static const size_t kInlineSize = 240U;
+    port::LogSeverity severity;
+    // The length of the message, which is in |text| if it is less than
+    // kInlineSize and in the heap block |overflow| otherwise.
+    uint32 length;
+    char* overflow;
+    char text[kInlineSize];
+  };
+
+  // The number of call sites tracked for rate limiting.
+  static const size_t kRateLimitSiteCount = 64U;
+
+  // Returns whether the call site of |message| may log another message.
+  bool IsWithinRateLimit(const std::string& message);
+
+  // Writes |entry| to the previous writer and frees any heap block.
+  void WriteEntry(Entry* entry);
+
+  // The background thread's function.
+  bool WriteEntries();
+
+  port::LogEntryWriter* previous_writer_;
+  MpscQueue<Entry> queue_;
+  // Posted once for every queued entry, and to stop the thread.
+  port::Semaphore entries_available_;
+  std::atomic<bool> stop_;
+  // The number of entries queued and written, used by Flush().
+  std::atomic<uint64> queued_count_;
+  std::atomic<uint64> written_count_;
+  std::atomic<uint64> dropped_count_;
+  // The dropped count last reported by the background thread.
+  uint64 reported_dropped_count_;
+  std::atomic<uint32> max_entries_per_second_;
+  // For each tracked call site, the second since construction in the high 32
+  // bits and the number of messages logged in that second in the low 32.
+  std::atomic<uint64> site_counts_[kRateLimitSiteCount];
+  port::Timer timer_;
+  // Serializes synchronous writes with the background thread.
+  port::Mutex write_mutex_;
+  std::unique_ptr<ThreadSpawner> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncLogEntryWriter);
+};
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_ASYNCLOGENTRYWRITER_H_
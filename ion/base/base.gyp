@@ -37,8 +37,12 @@
         'allocationtracker.h',
         'allocator.cc',
         'allocator.h',
+        'arenaallocator.cc',
+        'arenaallocator.h',
         'argcount.h',
         'array2.h',
+        'asynclogentrywriter.cc',
+        'asynclogentrywriter.h',
         'circularbuffer.h',
         'calllist.cc',
         'calllist.h',
@@ -60,13 +64,18 @@
         'logging.h',
         'memoryzipstream.cc',
         'memoryzipstream.h',
+        'mpscqueue.h',
         'notifier.cc',
         'notifier.h',
+        'poolallocator.cc',
+        'poolallocator.h',
         'nulllogentrywriter.h',
         'once.h',
         'readwritelock.cc',
         'readwritelock.h',
         'referent.h',
+        'samplingallocationtracker.cc',
+        'samplingallocationtracker.h',
         'scopedallocation.h',
         'serialize.h',
         'setting.cc',
@@ -78,10 +87,16 @@
         'spinmutex.cc',
         'spinmutex.h',
         'static_assert.h',
+        'staticprewarmer.cc',
+        'staticprewarmer.h',
         'staticsafedeclare.cc',
         'staticsafedeclare.h',
         'stringutils.cc',
         'stringutils.h',
+        'taskscheduler.cc',
+        'taskscheduler.h',
+        'threadlocalobject.cc',
+        'threadlocalobject.h',
         'threadspawner.cc',
         'threadspawner.h',
         'type_structs.h',
@@ -96,6 +111,8 @@
         'zipassetmanager.cc',
         'zipassetmanager.h',
         'zipassetmanagermacros.h',
+        'zipstream.cc',
+        'zipstream.h',
       ],
       'dependencies': [
         '<(ion_dir)/port/port.gyp:ionport',
@@ -71,6 +71,12 @@ class CircularBuffer : public ion::base::Allocatable {
   // Get the total capacity of the buffer.
   size_t GetCapacity() const { return capacity_; }
 
+  // Remove all items from the buffer, keeping any memory already allocated.
+  void Clear() {
+    buffer_.clear();
+    next_pos_ = 0;
+  }
+
  private:
   // Maximum buffer capacity.
   const size_t capacity_;
@@ -20,6 +20,7 @@ limitations under the License.
 #include "ion/base/allocationmanager.h"
 #include "ion/base/lockguards.h"
 #include "ion/base/staticsafedeclare.h"
+#include "ion/port/memorymappedfile.h"
 #include "ion/port/mutex.h"
 
 namespace ion {
@@ -28,6 +29,7 @@ namespace base {
 DataContainer::DataContainer(const Deleter& deleter, bool is_wipeable)
     : data_(NULL),
       is_wipeable_(is_wipeable),
+      is_read_only_(false),
       deleter_(deleter) {
 }
 
@@ -42,6 +44,87 @@ void DataContainer::WipeData() {
     InternalWipeData();
 }
 
+DataContainerPtr DataContainer::CreateAndCopyBytes(
+    const void* data, size_t size, bool is_wipeable,
+    const AllocatorPtr& container_and_data_allocator, size_t alignment) {
+  DataContainer* container =
+      Allocate(0, kNullFunction, is_wipeable, container_and_data_allocator);
+  // If the data is wipeable then the allocation should be short term,
+  // otherwise it should have the same lifetime as this.
+  if (is_wipeable) {
+    container->data_allocator_ =
+        container->GetAllocator().Get()
+            ? container->GetAllocator()->GetAllocatorForLifetime(kShortTerm)
+            : AllocationManager::GetDefaultAllocatorForLifetime(kShortTerm);
+  } else {
+    container->data_allocator_ = container->GetAllocator();
+  }
+  if (alignment) {
+    container->deleter_ =
+        std::bind(DataContainer::AlignedAllocatorDeleter,
+                  container->data_allocator_, std::placeholders::_1);
+    container->data_ =
+        container->data_allocator_->AllocateAlignedMemory(size, alignment);
+  } else {
+    container->deleter_ =
+        std::bind(DataContainer::AllocatorDeleter, container->data_allocator_,
+                  std::placeholders::_1);
+    container->data_ = container->data_allocator_->AllocateMemory(size);
+  }
+  // Copy the input data to the container.
+  if (data)
+    memcpy(container->data_, data, size);
+  return DataContainerPtr(container);
+}
+
+DataContainerPtr DataContainer::CreateFromMappedFile(
+    const MappedFilePtr& file, size_t offset, size_t length, bool is_wipeable,
+    const AllocatorPtr& container_allocator) {
+  if (!file || !file->GetData()) {
+    LOG(ERROR) << "Unable to create a DataContainer from an unmapped file.";
+    return DataContainerPtr(NULL);
+  }
+  if (offset > file->GetLength() || length > file->GetLength() - offset) {
+    LOG(ERROR) << "Unable to create a DataContainer for " << length
+               << " bytes at offset " << offset << " of a mapped file of "
+               << file->GetLength() << " bytes.";
+    return DataContainerPtr(NULL);
+  }
+  // The deleter holds the reference to the mapping.
+  DataContainer* container = Allocate(
+      0, [file](void*) {}, is_wipeable, container_allocator);
+  container->data_ = const_cast<uint8*>(
+      static_cast<const uint8*>(file->GetData()) + offset);
+  container->is_read_only_ = true;
+  return DataContainerPtr(container);
+}
+
+bool DataContainer::ReloadData() {
+  if (GetDataPtr())
+    return true;
+  if (!reloader_)
+    return false;
+  const DataContainerPtr source = reloader_();
+  if (!source.Get() || !source->GetData()) {
+    LOG(ERROR) << "Unable to reload the data of a wiped DataContainer.";
+    return false;
+  }
+  // The deleter holds the reference to the source, which is released when the
+  // data is wiped again.
+  data_ = const_cast<void*>(source->GetData());
+  deleter_ = [source](void*) {};
+  is_read_only_ = source->IsReadOnly();
+  return true;
+}
+
+DataContainer::Reloader DataContainer::MappedFileReloader(
+    const std::string& path, size_t offset, size_t length) {
+  return [path, offset, length]() {
+    const MappedFilePtr file(new port::MemoryMappedFile(path));
+    return CreateFromMappedFile(file, offset, length, true, AllocatorPtr());
+  };
+}
+
 DataContainer* DataContainer::Allocate(
     size_t extra_bytes, const Deleter& deleter, bool is_wipeable,
     const AllocatorPtr& allocator) {
@@ -86,6 +169,8 @@ void DataContainer::InternalWipeData() {
   if (data_ != NULL && deleter_) {
     deleter_(data_);
     data_ = NULL;
+    // Release anything the deleter holds, such as a mapped file.
+    deleter_ = kNullFunction;
   }
 }
 
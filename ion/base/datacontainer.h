@@ -20,6 +20,8 @@ limitations under the License.
 
 #include <cstring>
 #include <functional>
+#include <memory>
+#include <string>
 
 #if ION_DEBUG
 #include <set>
@@ -32,6 +34,10 @@ limitations under the License.
 #include "ion/port/nullptr.h"  // For kNullFunction.
 
 namespace ion {
+namespace port {
+class MemoryMappedFile;
+}  // namespace port
+
 namespace base {
 
 // Convenience typedefs for shared pointers to a DataContainer.
@@ -71,6 +77,29 @@ typedef base::WeakReferentPtr<DataContainer> DataContainerWeakPtr;
 //   data into the DataContainer's data if data is non-NULL. The memory is
 //   allocated using the passed Allocator. The new data is destroyed only when
 //   the DataContainer is destroyed.
+//
+// CreateAndCopy() and CreateOverAllocated() also take an optional alignment in
+// bytes for the data, which must be a power of 2 no larger than the page size;
+// e.g., Allocator::kCacheLineAlignment allows aligned SIMD loads. Without it,
+// CreateAndCopy() data has the Allocator's default alignment and
+// CreateOverAllocated() data is 16-byte aligned. Large aligned CreateAndCopy()
+// data is backed by huge pages where the OS supports them.
+//
+// CreateFromMappedFile(const MappedFilePtr& file, size_t offset,
+//                      size_t length, bool is_wipeable,
+//                      const AllocatorPtr& container_allocator)
+//   The internal data pointer is set to the byte at offset within the mapped
+//   file, without copying. The DataContainer holds a reference to the mapping
+//   until it is destroyed, or until WipeData() is called if is_wipeable is set,
+//   so that several DataContainers can share one mapping of an asset pack.
+//   Since mappings are read-only, GetMutableData() returns NULL.
+//
+// Wiping normally discards the data for good, so a wipeable DataContainer
+// cannot be uploaded again when its OpenGL object is evicted or the context is
+// lost. SetReloader() gives it a function that provides the data again, e.g.,
+// by decompressing an asset or mapping a range of a file, so that client
+// memory can be released right after each upload. The Renderer calls
+// ReloadData() whenever it needs the data of a wiped DataContainer.
 class ION_API DataContainer : public base::Notifier {
  public:
   // Generic delete function.
@@ -95,10 +124,27 @@ class ION_API DataContainer : public base::Notifier {
     DCHECK(allocator.Get());
     allocator->DeallocateMemory(data_to_delete);
   }
+  // As above, for data allocated by Allocator::AllocateAlignedMemory().
+  static void AlignedAllocatorDeleter(AllocatorPtr allocator,
+                                      void* data_to_delete) {
+    DCHECK(allocator.Get());
+    allocator->DeallocateAlignedMemory(data_to_delete);
+  }
+
+  // A shared, read-only mapping of a file.
+  typedef std::shared_ptr<const port::MemoryMappedFile> MappedFilePtr;
+
+  // A function that returns a new DataContainer holding the same data as a
+  // wiped one, or a NULL DataContainerPtr if it is unavailable.
+  typedef std::function<DataContainerPtr()> Reloader;
 
   // Returns the is_wipeable setting passed to the constructor.
   bool IsWipeable() const { return is_wipeable_; }
 
+  // Returns whether the data may not be modified, which is the case for data
+  // in a mapped file.
+  bool IsReadOnly() const { return is_read_only_; }
+
   // Returns a const data pointer.
   template <typename T>
   const T* GetData() const {
@@ -113,6 +159,10 @@ class ION_API DataContainer : public base::Notifier {
   // Returns a non-const data pointer.
   template <typename T>
   T* GetMutableData() const {
+    if (is_read_only_) {
+      LOG(ERROR) << "GetMutableData() called on a read-only DataContainer.";
+      return NULL;
+    }
     T* data = reinterpret_cast<T*>(GetDataPtr());
     if (data)
       this->Notify();
@@ -142,51 +192,73 @@ class ION_API DataContainer : public base::Notifier {
   static DataContainerPtr CreateAndCopy(
       const T* data, size_t count, bool is_wipeable,
       const AllocatorPtr& container_and_data_allocator) {
-    DataContainer* container =
-        Allocate(0, kNullFunction, is_wipeable, container_and_data_allocator);
-    // If the data is wipeable then the allocation should be short term,
-    // otherwise it should have the same lifetime as this.
-    if (is_wipeable) {
-      container->data_allocator_ =
-          container->GetAllocator().Get()
-              ? container->GetAllocator()->GetAllocatorForLifetime(kShortTerm)
-              : AllocationManager::GetDefaultAllocatorForLifetime(kShortTerm);
-    } else {
-      container->data_allocator_ = container->GetAllocator();
-    }
-    container->deleter_ =
-        std::bind(DataContainer::AllocatorDeleter, container->data_allocator_,
-                  std::placeholders::_1);
-    container->data_ =
-        container->data_allocator_->AllocateMemory(sizeof(T) * count);
-    // Copy the input data to the container.
-    if (data)
-      memcpy(container->data_, data, sizeof(T) * count);
-    return DataContainerPtr(container);
+    return CreateAndCopyBytes(data, sizeof(T) * count, is_wipeable,
+                              container_and_data_allocator, 0U);
+  }
+  template <typename T>
+  static DataContainerPtr CreateAndCopy(
+      const T* data, size_t count, bool is_wipeable,
+      const AllocatorPtr& container_and_data_allocator, size_t alignment) {
+    return CreateAndCopyBytes(data, sizeof(T) * count, is_wipeable,
+                              container_and_data_allocator, alignment);
   }
 
   // See class comment for documentation.
   template <typename T>
   static DataContainerPtr CreateOverAllocated(
       size_t count, const T* data, const AllocatorPtr& container_allocator) {
-    // Allocate an additional 16 bytes to ensure that the data pointer can be
-    // 16-byte aligned.
-    DataContainer* container = Allocate(sizeof(T) * count + 16, kNullFunction,
-                                        false, container_allocator);
+    return CreateOverAllocated(count, data, container_allocator, 16U);
+  }
+  template <typename T>
+  static DataContainerPtr CreateOverAllocated(
+      size_t count, const T* data, const AllocatorPtr& container_allocator,
+      size_t alignment) {
+    DCHECK(alignment && !(alignment & (alignment - 1U)))
+        << "Alignment " << alignment << " is not a power of 2";
+    // Allocate an additional alignment bytes to ensure that the data pointer
+    // can be aligned.
+    DataContainer* container = Allocate(
+        sizeof(T) * count + alignment, kNullFunction, false,
+        container_allocator);
     uint8* ptr = reinterpret_cast<uint8*>(container) + sizeof(DataContainer);
-    // Offset the pointer by the right amount to make it 16-byte aligned.
-    container->data_ = ptr + 16 - (reinterpret_cast<size_t>(ptr) % 16);
+    // Offset the pointer by the right amount to make it aligned.
+    container->data_ =
+        ptr + alignment - (reinterpret_cast<size_t>(ptr) % alignment);
     // Copy the input data to the container.
     if (data)
       memcpy(container->data_, data, sizeof(T) * count);
     return DataContainerPtr(container);
   }
 
+  // See class comment for documentation. Returns a NULL DataContainerPtr if
+  // the file is not mapped or the range does not fit within it.
+  static DataContainerPtr CreateFromMappedFile(
+      const MappedFilePtr& file, size_t offset, size_t length,
+      bool is_wipeable, const AllocatorPtr& container_allocator);
+
   // Informs the DataContainer that the data is no longer needed and can be
   // deleted. It does this only if is_wipeable=true was passed to the
   // constructor and there is a non-NULL deleter; otherwise, it has no effect.
   void WipeData();
 
+  // Sets/returns the function that provides the data again after it has been
+  // wiped. The data it returns is only borrowed until the next WipeData(), and
+  // is read-only if the returned DataContainer is.
+  void SetReloader(const Reloader& reloader) { reloader_ = reloader; }
+  const Reloader& GetReloader() const { return reloader_; }
+
+  // If the data has been wiped and there is a reloader, calls it to restore the
+  // data, logging an error if it fails. Returns whether there is data.
+  bool ReloadData();
+
+  // Returns whether there is data, or it has been wiped but can be reloaded.
+  bool IsDataAvailable() const { return GetDataPtr() || reloader_; }
+
+  // Returns a Reloader that maps length bytes at offset within the file at
+  // path, for data that was originally read from that range.
+  static Reloader MappedFileReloader(const std::string& path, size_t offset,
+                                     size_t length);
+
  protected:
   // The destructor is protected because all base::Referent classes must have
   // protected or private destructors.
@@ -203,6 +275,12 @@ class ION_API DataContainer : public base::Notifier {
                                  bool is_wipeable,
                                  const AllocatorPtr& allocator);
 
+  // Implements CreateAndCopy() for size bytes of data. An alignment of 0 means
+  // the default alignment of the data allocator.
+  static DataContainerPtr CreateAndCopyBytes(
+      const void* data, size_t size, bool is_wipeable,
+      const AllocatorPtr& container_and_data_allocator, size_t alignment);
+
   // In debug mode, adds or removes data to or from a set of client-passed
   // pointers that are used by DataContainers. An error message is printed if
   // if the same pointer is passed to Create() before destroying the
@@ -220,9 +298,13 @@ class ION_API DataContainer : public base::Notifier {
   // Whether the data should be destroyed when WipeData() is called and there
   // is a deleter available.
   bool is_wipeable_;
+  // Whether the data may not be modified.
+  bool is_read_only_;
   // Function to use to destroy data_. NULL if the DataContainer does not own
   // the pointer.
   Deleter deleter_;
+  // Function that provides the data again after it is wiped.
+  Reloader reloader_;
 
   // The allocator used to allocate data when CreateAndCopy() is used.
   base::AllocatorPtr data_allocator_;
@@ -201,6 +201,9 @@ typedef GenericTryLockGuard<SpinMutex> SpinTryLockGuard;
 // Convenient typedefs for ReadWriteLock.
 typedef GenericLockGuard<ReadLock> ReadGuard;
 typedef GenericLockGuard<WriteLock> WriteGuard;
+// Convenient typedefs for BigReaderLock.
+typedef GenericLockGuard<BigReaderReadLock> BigReaderReadGuard;
+typedef GenericLockGuard<BigReaderWriteLock> BigReaderWriteGuard;
 
 }  // namespace base
 }  // namespace ion
@@ -0,0 +1,163 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_MPSCQUEUE_H_
+#define ION_BASE_MPSCQUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "base/macros.h"
+#include "ion/base/allocationmanager.h"
+#include "ion/base/allocator.h"
+#include "ion/base/logging.h"
+#include "ion/port/atomic.h"
+
+namespace ion {
+namespace base {
+
+// MpscQueue is a bounded, lock-free FIFO queue that any number of threads may
+// push values onto, but only a single thread may pop values from. It never
+// allocates after construction: TryPush() returns false when the queue is
+// full, and the caller decides whether to drop the value, retry, or fall back
+// to a slower path.
+//
+// Each slot holds a sequence number that tells producers and the consumer
+// whether the slot is free or holds a value, so that producers only contend
+// on a single atomic index and the consumer does not write to it at all.
+template <typename T>
+class MpscQueue {
+ public:
+  // Creates a queue holding at least capacity values, with storage allocated
+  // from allocator. The capacity is rounded up to a power of two.
+  MpscQueue(const AllocatorPtr& allocator, size_t capacity)
+      : allocator_(AllocationManager::GetNonNullAllocator(allocator)),
+        mask_(RoundUpToPowerOfTwo(capacity) - 1U),
+        cells_(static_cast<Cell*>(
+            allocator_->AllocateMemory(sizeof(Cell) * (mask_ + 1U)))),
+        head_(0U),
+        tail_(0U) {
+    for (size_t i = 0; i <= mask_; ++i)
+      new (&cells_[i]) Cell(i);
+  }
+
+  ~MpscQueue() {
+    // Destroy any values that were never popped.
+    for (size_t i = 0; i <= mask_; ++i) {
+      if (cells_[i].sequence.load(std::memory_order_acquire) ==
+          head_ + ((i - head_) & mask_) + 1U)
+        reinterpret_cast<T*>(&cells_[i].storage)->~T();
+      cells_[i].~Cell();
+    }
+    allocator_->DeallocateMemory(cells_);
+  }
+
+  // Returns the number of values the queue can hold.
+  size_t GetCapacity() const { return mask_ + 1U; }
+
+  // Returns whether the queue appears to be empty. This is only reliable on
+  // the consumer thread, and only in the sense that a concurrent push may
+  // complete right after it returns.
+  bool IsEmpty() const {
+    const Cell& cell = cells_[head_ & mask_];
+    return cell.sequence.load(std::memory_order_acquire) != head_ + 1U;
+  }
+
+  // Copies value onto the queue and returns true, or returns false if the
+  // queue is full. May be called from any thread.
+  bool TryPush(const T& value) {
+    Cell* cell;
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff =
+          static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        // The slot is free; claim it.
+        if (tail_.compare_exchange_weak(pos, pos + 1U,
+                                        std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        // The slot still holds a value from the previous lap.
+        return false;
+      } else {
+        // Another producer claimed the slot first.
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    new (&cell->storage) T(value);
+    cell->sequence.store(pos + 1U, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the oldest value in the queue into value and returns true, or
+  // returns false if the queue is empty. Must only be called from the single
+  // consumer thread.
+  bool TryPop(T* value) {
+    DCHECK(value);
+    Cell* cell = &cells_[head_ & mask_];
+    if (cell->sequence.load(std::memory_order_acquire) != head_ + 1U)
+      return false;
+    T* stored = reinterpret_cast<T*>(&cell->storage);
+    *value = std::move(*stored);
+    stored->~T();
+    // Free the slot for the producer that reaches it on the next lap.
+    cell->sequence.store(head_ + mask_ + 1U, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+ private:
+  // The size of the padding that keeps the consumer and producer indices in
+  // separate cache lines.
+  static const size_t kCacheLineSize = 64U;
+
+  struct Cell {
+    explicit Cell(size_t initial_sequence) : sequence(initial_sequence) {}
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    DCHECK_GT(n, 0U);
+    size_t power = 1U;
+    while (power < n)
+      power <<= 1;
+    return power;
+  }
+
+  const AllocatorPtr allocator_;
+  const size_t mask_;
+  Cell* const cells_;
+  // The index of the next slot to pop, only touched by the consumer.
+  size_t head_;
+  char padding_[kCacheLineSize];
+  // The index of the next slot to push, shared by the producers.
+  std::atomic<size_t> tail_;
+
+  DISALLOW_COPY_AND_ASSIGN(MpscQueue);
+};
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_MPSCQUEUE_H_
@@ -17,28 +17,122 @@ limitations under the License.
 
 #include "ion/base/notifier.h"
 
+#include <unordered_set>
+#include <vector>
+
+#include "ion/base/staticsafedeclare.h"
+#include "ion/base/threadlocalobject.h"
+
+
 namespace ion {
 namespace base {
 
-Notifier::~Notifier() {}
+struct Notifier::ReceiverSnapshot : public Allocatable {
+  explicit ReceiverSnapshot(const NotifierPtrVector& receivers_in)
+      : receivers(*this, receivers_in) {}
+  ~ReceiverSnapshot() override {}
+
+  const NotifierPtrVector receivers;
+};
+
+//-----------------------------------------------------------------------------
+//
+// ScopedNotificationBatch.
+//
+//-----------------------------------------------------------------------------
+
+struct ScopedNotificationBatch::State {
+  State() : depth(0) {}
+
+  // The number of batches that exist in the thread.
+  int depth;
+  // The Notifiers whose receivers are to be notified, in the order in which
+  // they first called Notify(), and the set of the same Notifiers.
+  std::vector<WeakReferentPtr<Notifier> > pending;
+  std::unordered_set<const Notifier*> pending_set;
+};
+
+ScopedNotificationBatch::ScopedNotificationBatch() { ++GetState()->depth; }
+
+ScopedNotificationBatch::~ScopedNotificationBatch() {
+  State* state = GetState();
+  DCHECK_GT(state->depth, 0);
+  if (state->depth == 1) {
+    // Deliver the notifications while still batching, so that notifications
+    // sent by the receivers are coalesced into the next round.
+    std::vector<WeakReferentPtr<Notifier> > notifiers;
+    while (!state->pending.empty()) {
+      notifiers.swap(state->pending);
+      state->pending_set.clear();
+      for (size_t i = 0; i < notifiers.size(); ++i) {
+        ReferentPtr<Notifier>::Type notifier = notifiers[i].Acquire();
+        if (notifier.Get())
+          notifier->NotifyReceivers();
+      }
+      notifiers.clear();
+    }
+  }
+  --state->depth;
+}
+
+bool ScopedNotificationBatch::IsBatching() { return GetState()->depth > 0; }
+
+ScopedNotificationBatch::State* ScopedNotificationBatch::GetState() {
+  ION_DECLARE_SAFE_STATIC_POINTER(ThreadLocalObject<State>, s_states);
+  return s_states->Get();
+}
+
+bool ScopedNotificationBatch::Defer(const Notifier* notifier) {
+  // A Notifier that is not yet referenced cannot be weakly referenced.
+  State* state = GetState();
+  if (!state->depth || !notifier->GetRefCount())
+    return false;
+  if (state->pending_set.insert(notifier).second) {
+    state->pending.push_back(
+        WeakReferentPtr<Notifier>(const_cast<Notifier*>(notifier)));
+  }
+  return true;
+}
+
+void ScopedNotificationBatch::Forget(const Notifier* notifier) {
+  // The weak reference to the Notifier in pending will be NULL, but the
+  // Notifier's address may be reused by another Notifier.
+  State* state = GetState();
+  if (state->depth)
+    state->pending_set.erase(notifier);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Notifier.
+//
+//-----------------------------------------------------------------------------
+
+Notifier::~Notifier() {
+  if (snapshot_.load())
+    ScopedNotificationBatch::Forget(this);
+  // No Notify() can be in progress while this is destroyed.
+  delete snapshot_.load();
+  for (size_t i = 0; i < retired_snapshots_.size(); ++i)
+    delete retired_snapshots_[i];
+}
 
 void Notifier::AddReceiver(Notifier* receiver) {
   if (receiver) {
     NotifierPtr ptr(receiver);
-    WriteLock lock(&mutex_);
-    WriteGuard guard(&lock);
+    LockGuard guard(&mutex_);
     const size_t count = receivers_.size();
     for (size_t i = 0; i < count; ++i)
       if (ptr == receivers_[i])
         return;
     receivers_.push_back(ptr);
+    PublishReceiversLocked();
   }
 }
 
 void Notifier::RemoveReceiver(Notifier* receiver) {
   if (receiver) {
-    WriteLock lock(&mutex_);
-    WriteGuard guard(&lock);
+    LockGuard guard(&mutex_);
     const size_t count = receivers_.size();
     if (receiver->GetRefCount()) {
       NotifierPtr ptr(receiver);
@@ -46,6 +140,7 @@ void Notifier::RemoveReceiver(Notifier* receiver) {
         if (receivers_[i] == ptr) {
           receivers_[i] = receivers_[receivers_.size() - 1U];
           receivers_.pop_back();
+          PublishReceiversLocked();
           break;
         }
       }
@@ -61,6 +156,7 @@ void Notifier::RemoveReceiver(Notifier* receiver) {
         } else {
           receivers_[i] = receivers_[receivers_.size() - 1U];
           receivers_.pop_back();
+          PublishReceiversLocked();
           break;
         }
       }
@@ -69,8 +165,7 @@ void Notifier::RemoveReceiver(Notifier* receiver) {
 }
 
 size_t Notifier::GetReceiverCount() const {
-  ReadLock lock(&mutex_);
-  ReadGuard guard(&lock);
+  LockGuard guard(&mutex_);
   return receivers_.size();
 }
 
@@ -79,21 +174,74 @@ const Notifier::NotifierPtrVector& Notifier::GetReceivers() const {
 }
 
 void Notifier::Notify() const {
-  ReadLock lock(&mutex_);
-  ReadGuard guard(&lock);
+  // There is nothing to batch if there are no receivers.
+  if (snapshot_.load() && !ScopedNotificationBatch::Defer(this))
+    NotifyReceivers();
+}
+
+void Notifier::NotifyReceivers() const {
+  // Counting this call before reading the snapshot keeps the snapshot from
+  // being freed until the count is decremented.
+  ++notify_count_;
+  bool found_destroyed_receiver = false;
+  if (const ReceiverSnapshot* snapshot = snapshot_.load()) {
+    const NotifierPtrVector& receivers = snapshot->receivers;
+    const size_t count = receivers.size();
+    for (size_t i = 0; i < count; ++i) {
+      ReferentPtr<Notifier>::Type receiver = receivers[i].Acquire();
+      if (receiver.Get())
+        receiver->OnNotify(this);
+      else
+        found_destroyed_receiver = true;
+    }
+  }
+  if (--notify_count_ == 0 && has_retired_snapshots_) {
+    LockGuard guard(&mutex_);
+    FreeRetiredSnapshotsLocked();
+  }
+  if (found_destroyed_receiver)
+    RemoveDestroyedReceivers();
+}
+
+void Notifier::OnNotify(const Notifier* notifier) {}
+
+void Notifier::PublishReceiversLocked() const {
+  ReceiverSnapshot* snapshot =
+      receivers_.empty() ? nullptr
+                         : new (GetAllocator()) ReceiverSnapshot(receivers_);
+  if (ReceiverSnapshot* old_snapshot = snapshot_.exchange(snapshot)) {
+    retired_snapshots_.push_back(old_snapshot);
+    has_retired_snapshots_ = true;
+    FreeRetiredSnapshotsLocked();
+  }
+}
+
+void Notifier::FreeRetiredSnapshotsLocked() const {
+  // A Notify() that starts after this check reads the current snapshot, which
+  // is never retired.
+  if (notify_count_ == 0) {
+    for (size_t i = 0; i < retired_snapshots_.size(); ++i)
+      delete retired_snapshots_[i];
+    retired_snapshots_.clear();
+    has_retired_snapshots_ = false;
+  }
+}
+
+void Notifier::RemoveDestroyedReceivers() const {
+  LockGuard guard(&mutex_);
+  bool removed = false;
   for (size_t i = 0; i < receivers_.size();) {
-    ReferentPtr<Notifier>::Type receiver = receivers_[i].Acquire();
-    if (receiver.Get()) {
-      receiver->OnNotify(this);
+    if (receivers_[i].Acquire().Get()) {
       ++i;
     } else {
       receivers_[i] = receivers_[receivers_.size() - 1U];
       receivers_.pop_back();
+      removed = true;
     }
   }
+  if (removed)
+    PublishReceiversLocked();
 }
 
-void Notifier::OnNotify(const Notifier* notifier) {}
-
 }  // namespace base
 }  // namespace ion
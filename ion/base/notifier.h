@@ -19,9 +19,10 @@ limitations under the License.
 #define ION_BASE_NOTIFIER_H_
 
 #include <algorithm>
+#include <atomic>
 
+#include "base/macros.h"
 #include "ion/base/lockguards.h"
-#include "ion/base/readwritelock.h"
 #include "ion/base/stlalloc/allocvector.h"
 #include "ion/base/weakreferent.h"
 #include "ion/port/mutex.h"
@@ -32,6 +33,10 @@ namespace base {
 // A Notifier both sends notifications to and receives notifications from other
 // Notifiers. This is accomplished through the Notify() function, which calls
 // OnNotify() on all held Notifiers.
+//
+// Notify() takes no lock. It reads an immutable snapshot of the receivers,
+// which AddReceiver() and RemoveReceiver() replace when they change the
+// receivers. A replaced snapshot is freed once no Notify() can be reading it.
 class ION_API Notifier : public WeakReferent {
  public:
   // Adds a Notifier to be notified. Does nothing if the receiver is NULL or is
@@ -51,7 +56,12 @@ class ION_API Notifier : public WeakReferent {
 
   // The constructor is protected because this is a base class and should not be
   // created on its own.
-  Notifier() : receivers_(*this) {}
+  Notifier()
+      : receivers_(*this),
+        snapshot_(nullptr),
+        retired_snapshots_(*this),
+        has_retired_snapshots_(false),
+        notify_count_(0) {}
   // The destructor is protected because this is derived from Referent.
   ~Notifier() override;
 
@@ -59,17 +69,82 @@ class ION_API Notifier : public WeakReferent {
   const NotifierPtrVector& GetReceivers() const;
 
   // Notifies all contained Notifiers by calling their OnNotify(). Any receivers
-  // that have been destroyed will be removed from the vector of receivers.
+  // that have been destroyed will be removed from the vector of receivers. If a
+  // ScopedNotificationBatch exists in the calling thread then the receivers are
+  // instead notified when the outermost batch is destroyed.
   void Notify() const;
 
   // Subclasses can override this to provide custom behavior on notifications.
   virtual void OnNotify(const Notifier* notifier);
 
  private:
-  // This is mutable so that Notify() can be called even on const instances.
+  // An immutable copy of the receivers.
+  struct ReceiverSnapshot;
+
+  // Replaces the snapshot read by Notify() with a copy of receivers_. Must be
+  // called with mutex_ locked.
+  void PublishReceiversLocked() const;
+  // Frees the retired snapshots if no Notify() is in progress. Must be called
+  // with mutex_ locked.
+  void FreeRetiredSnapshotsLocked() const;
+  // Removes any receivers that have been destroyed.
+  void RemoveDestroyedReceivers() const;
+  // Notifies the receivers immediately.
+  void NotifyReceivers() const;
+
+  // These are mutable so that Notify() can be called even on const instances.
+  // The receivers, which are only accessed with mutex_ locked.
   mutable NotifierPtrVector receivers_;
-  // Protect access to receivers_.
-  mutable base::ReadWriteLock mutex_;
+  // The snapshot of receivers_ that Notify() reads, or NULL if there are no
+  // receivers.
+  mutable std::atomic<ReceiverSnapshot*> snapshot_;
+  // Replaced snapshots that a Notify() in progress may still be reading.
+  mutable AllocVector<ReceiverSnapshot*> retired_snapshots_;
+  mutable std::atomic<bool> has_retired_snapshots_;
+  // The number of Notify() calls in progress.
+  mutable std::atomic<int> notify_count_;
+  // Protects receivers_ and retired_snapshots_.
+  mutable port::Mutex mutex_;
+
+  friend class ScopedNotificationBatch;
+};
+
+// A ScopedNotificationBatch coalesces the notifications sent in the current
+// thread while it exists. A Notifier that calls Notify() any number of times
+// during the batch notifies its receivers only once, when the outermost batch
+// in the thread is destroyed. Notifications sent while the batch delivers its
+// notifications are batched as well, so a chain of Notifiers is also notified
+// once per link. Batches in other threads are independent. For example:
+//
+//   {
+//     ScopedNotificationBatch batch;
+//     for (size_t i = 0; i < count; ++i)
+//       uniform_holder->SetUniformValue(i, values[i]);
+//   }  // The uniform holder's receivers are notified once here.
+class ION_API ScopedNotificationBatch {
+ public:
+  ScopedNotificationBatch();
+  ~ScopedNotificationBatch();
+
+  // Returns whether a batch exists in the calling thread.
+  static bool IsBatching();
+
+ private:
+  // The batching state of a thread.
+  struct State;
+
+  // Returns the calling thread's state.
+  static State* GetState();
+  // Adds the passed Notifier to the calling thread's batch if there is one,
+  // returning whether it was added or already present.
+  static bool Defer(const Notifier* notifier);
+  // Removes the passed Notifier, which is being destroyed, from the calling
+  // thread's batch.
+  static void Forget(const Notifier* notifier);
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedNotificationBatch);
+
+  friend class Notifier;
 };
 
 }  // namespace base
@@ -0,0 +1,201 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/poolallocator.h"
+
+#include <algorithm>
+#include <cstdlib>  // For malloc() and free()
+
+#include "base/integral_types.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// Every block is preceded by a header recording its size class. The header is
+// as large as the alignment that malloc() guarantees, so that the memory
+// following it is as well aligned.
+union Header {
+  size_t size_class;
+  long double max_align_ld;
+  void* max_align_p;
+  uint64 max_align_i;
+};
+static const size_t kHeaderSize = sizeof(Header);
+
+// The number of blocks that a thread cache exchanges with the shared free
+// lists at a time. A cache holding twice this many free blocks of a size class
+// returns a batch of them.
+static const size_t kBatchSize = 32U;
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// PoolAllocator helper structs.
+//
+//-----------------------------------------------------------------------------
+
+struct PoolAllocator::FreeBlock {
+  FreeBlock* next;
+};
+
+struct PoolAllocator::ThreadCache {
+  FreeList lists[kNumSizeClasses];
+};
+
+//-----------------------------------------------------------------------------
+//
+// PoolAllocator class functions.
+//
+//-----------------------------------------------------------------------------
+
+const size_t PoolAllocator::kMaxPooledSize;
+const size_t PoolAllocator::kSlabSize;
+
+PoolAllocator::PoolAllocator() {}
+
+PoolAllocator::~PoolAllocator() {
+  const size_t count = slabs_.size();
+  for (size_t i = 0; i < count; ++i) {
+    if (AllocationTracker* tracker = slab_tracker_.Get())
+      tracker->TrackDeallocation(*this, slabs_[i]);
+    free(slabs_[i]);
+  }
+}
+
+size_t PoolAllocator::GetSlabCount() {
+  LockGuard guard(&mutex_);
+  return slabs_.size();
+}
+
+size_t PoolAllocator::GetSizeClass(size_t size) {
+  // Classes are 16 bytes apart up to 256 bytes, then 64 bytes apart up to 512,
+  // then 128 bytes apart up to kMaxPooledSize.
+  DCHECK_LE(size, kMaxPooledSize);
+  if (size <= 256U)
+    return size ? (size - 1U) / 16U : 0U;
+  else if (size <= 512U)
+    return 16U + (size - 257U) / 64U;
+  else
+    return 20U + (size - 513U) / 128U;
+}
+
+size_t PoolAllocator::GetClassSize(size_t size_class) {
+  DCHECK_LT(size_class, kNumSizeClasses);
+  if (size_class < 16U)
+    return 16U * (size_class + 1U);
+  else if (size_class < 20U)
+    return 256U + 64U * (size_class - 15U);
+  else
+    return 512U + 128U * (size_class - 19U);
+}
+
+void* PoolAllocator::Allocate(size_t size) {
+  Header* header = NULL;
+  if (size <= kMaxPooledSize) {
+    const size_t size_class = GetSizeClass(size);
+    FreeList& list = thread_caches_.Get()->lists[size_class];
+    if (!list.head)
+      Refill(size_class, &list);
+    if (FreeBlock* block = list.head) {
+      list.head = block->next;
+      --list.count;
+      header = reinterpret_cast<Header*>(block);
+      header->size_class = size_class;
+    }
+  } else if ((header = static_cast<Header*>(malloc(kHeaderSize + size)))) {
+    header->size_class = kNumSizeClasses;
+  }
+  return header ? header + 1 : NULL;
+}
+
+void PoolAllocator::Deallocate(void* p) {
+  if (!p)
+    return;
+  Header* header = static_cast<Header*>(p) - 1;
+  const size_t size_class = header->size_class;
+  if (size_class == kNumSizeClasses) {
+    free(header);
+    return;
+  }
+  DCHECK_LT(size_class, kNumSizeClasses);
+  FreeList& list = thread_caches_.Get()->lists[size_class];
+  FreeBlock* block = reinterpret_cast<FreeBlock*>(header);
+  block->next = list.head;
+  list.head = block;
+  if (++list.count >= 2U * kBatchSize)
+    Return(size_class, kBatchSize, &list);
+}
+
+void PoolAllocator::Refill(size_t size_class, FreeList* list) {
+  DCHECK(!list->head);
+  LockGuard guard(&mutex_);
+  FreeList& shared = free_lists_[size_class];
+  if (!shared.head) {
+    // Divide a new slab into blocks.
+    char* slab = static_cast<char*>(malloc(kSlabSize));
+    if (!slab)
+      return;
+    slabs_.push_back(slab);
+    if (AllocationTracker* tracker = slab_tracker_.Get())
+      tracker->TrackAllocation(*this, kSlabSize, slab);
+    const size_t block_size = kHeaderSize + GetClassSize(size_class);
+    for (size_t offset = 0; offset + block_size <= kSlabSize;
+         offset += block_size) {
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + offset);
+      block->next = shared.head;
+      shared.head = block;
+      ++shared.count;
+    }
+  }
+  // Move the first blocks of the shared list to the thread's list.
+  const size_t count = std::min(kBatchSize, shared.count);
+  FreeBlock* last = shared.head;
+  for (size_t i = 1U; i < count; ++i)
+    last = last->next;
+  list->head = shared.head;
+  list->count = count;
+  shared.head = last->next;
+  shared.count -= count;
+  last->next = NULL;
+}
+
+void PoolAllocator::Return(size_t size_class, size_t count, FreeList* list) {
+  // Unlink the first blocks of the thread's list.
+  count = std::min(count, list->count);
+  if (!count)
+    return;
+  FreeBlock* first = list->head;
+  FreeBlock* last = first;
+  for (size_t i = 1U; i < count; ++i)
+    last = last->next;
+  list->head = last->next;
+  list->count -= count;
+
+  LockGuard guard(&mutex_);
+  FreeList& shared = free_lists_[size_class];
+  last->next = shared.head;
+  shared.head = first;
+  shared.count += count;
+}
+
+}  // namespace base
+}  // namespace ion
@@ -0,0 +1,124 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_POOLALLOCATOR_H_
+#define ION_BASE_POOLALLOCATOR_H_
+
+#include <vector>
+
+#include "base/macros.h"
+#include "ion/base/allocationtracker.h"
+#include "ion/base/allocator.h"
+#include "ion/base/threadlocalobject.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace base {
+
+// PoolAllocator is an Allocator that serves small allocations from slabs of
+// fixed-size blocks, keeping one free list per size class. It suits the many
+// small, similarly sized objects of a scene, such as Nodes, Shapes and
+// AttributeArrays, which would otherwise each be a separate malloc() block. It
+// can be installed for any lifetime:
+//
+//   base::AllocationManager::SetDefaultAllocatorForLifetime(
+//       base::kMediumTerm, new base::PoolAllocator);
+//
+// Each thread keeps a cache of free blocks of each size class, so most
+// allocations and deallocations take no lock; the caches exchange blocks with
+// the shared free lists in batches. Allocations larger than kMaxPooledSize are
+// made with malloc(). Slab memory is only returned to the system when the
+// PoolAllocator is destroyed.
+//
+// The tracker set with SetTracker() sees the requested allocations, as it
+// does for any Allocator. The tracker set with SetSlabTracker() sees each slab
+// as an allocation of kSlabSize bytes, so comparing the active bytes of the
+// two trackers shows how much of the pooled memory is in use.
+class ION_API PoolAllocator : public Allocator {
+ public:
+  // Allocations of up to this many bytes are pooled.
+  static const size_t kMaxPooledSize = 1024U;
+  // The size of each slab of blocks.
+  static const size_t kSlabSize = 64U * 1024U;
+
+  PoolAllocator();
+
+  // Sets/returns an AllocationTracker that tracks slab allocations. It is NULL
+  // by default. As with SetTracker(), the tracker should not be changed while
+  // slabs are allocated.
+  void SetSlabTracker(const AllocationTrackerPtr& tracker) {
+    slab_tracker_ = tracker;
+  }
+  const AllocationTrackerPtr& GetSlabTracker() const { return slab_tracker_; }
+
+  // Returns the number of slabs allocated.
+  size_t GetSlabCount();
+
+ protected:
+  // The destructor is protected because all instances should be managed
+  // through SharedPtr.
+  ~PoolAllocator() override;
+
+  // Allocator interface.
+  void* Allocate(size_t size) override;
+  void Deallocate(void* p) override;
+
+ private:
+  // A free block, which links to the next free block in its list.
+  struct FreeBlock;
+  // A list of free blocks.
+  struct FreeList {
+    FreeList() : head(NULL), count(0U) {}
+    FreeBlock* head;
+    size_t count;
+  };
+  // The free lists of a single thread.
+  struct ThreadCache;
+
+  // The number of size classes.
+  static const size_t kNumSizeClasses = 24U;
+
+  // Returns the size class that holds allocations of the passed size.
+  static size_t GetSizeClass(size_t size);
+  // Returns the size of the blocks of the passed size class, not including
+  // their headers.
+  static size_t GetClassSize(size_t size_class);
+
+  // Moves free blocks of the passed size class from the shared free lists to
+  // the passed list, which must be empty, allocating a new slab if needed.
+  void Refill(size_t size_class, FreeList* list);
+  // Moves up to count blocks from the passed list to the shared free list of
+  // the passed size class.
+  void Return(size_t size_class, size_t count, FreeList* list);
+
+  // The shared free lists, the slabs, and the mutex protecting them.
+  FreeList free_lists_[kNumSizeClasses];
+  std::vector<void*> slabs_;
+  port::Mutex mutex_;
+
+  ThreadLocalObject<ThreadCache> thread_caches_;
+  AllocationTrackerPtr slab_tracker_;
+
+  DISALLOW_COPY_AND_ASSIGN(PoolAllocator);
+};
+
+typedef SharedPtr<PoolAllocator> PoolAllocatorPtr;
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_POOLALLOCATOR_H_
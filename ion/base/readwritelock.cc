@@ -17,6 +17,10 @@ limitations under the License.
 
 #include "ion/base/readwritelock.h"
 
+#include "ion/base/lockguards.h"
+#include "ion/port/macros.h"
+#include "ion/port/threadutils.h"
+
 namespace ion {
 namespace base {
 
@@ -33,10 +37,27 @@ void ReadWriteLock::LockForRead() {
     turnstile_.Lock();
     turnstile_.Unlock();
   }
+  // If other readers are already in the lock, just join them.
+  int count = reader_count_;
+  while (count > 0) {
+    if (reader_count_.compare_exchange_weak(count, count + 1))
+      return;
+  }
   // The first reader prevents writers from obtaining the lock, or blocks until
-  // a writer has finished.
-  if (++reader_count_ == 1)
-    room_empty_.Wait();
+  // a writer has finished. The count is only incremented once the reader is
+  // in the lock, so that no other reader can join it while it is blocked.
+  // Readers may have entered, or the last of them left, since the check
+  // above, so the count is checked again: a reader may only join others while
+  // the count is nonzero, since the last reader posts the semaphore when it
+  // drops to zero.
+  LockGuard guard(&first_reader_mutex_);
+  count = reader_count_;
+  while (count > 0) {
+    if (reader_count_.compare_exchange_weak(count, count + 1))
+      return;
+  }
+  room_empty_.Wait();
+  ++reader_count_;
 }
 
 void ReadWriteLock::UnlockForRead() {
@@ -58,5 +79,72 @@ void ReadWriteLock::UnlockForWrite() {
   --writer_count_;
 }
 
+//-----------------------------------------------------------------------------
+//
+// BigReaderLock.
+//
+//-----------------------------------------------------------------------------
+
+// Returns the reader slot used by the calling thread. Threads are assigned
+// slots in turn the first time they need one, so that the first
+// kReaderSlotCount threads never share a slot.
+static size_t GetReaderSlot() {
+#if ION_HAS_NATIVE_THREAD_LOCAL
+  static std::atomic<size_t> s_next_slot(0U);
+  static thread_local size_t slot = s_next_slot++;
+  return slot % BigReaderLock::kReaderSlotCount;
+#else
+  return std::hash<port::ThreadId>()(port::GetCurrentThreadId()) %
+         BigReaderLock::kReaderSlotCount;
+#endif
+}
+
+BigReaderLock::BigReaderLock() : writer_active_(false), writer_count_(0) {}
+
+BigReaderLock::~BigReaderLock() {}
+
+void BigReaderLock::LockForRead() {
+  std::atomic<int>& count = reader_slots_[GetReaderSlot()].count;
+  while (true) {
+    // A writer sets writer_active_ before checking the slots, and a reader
+    // increments its slot before checking writer_active_, so at least one of
+    // them sees the other.
+    ++count;
+    if (!writer_active_)
+      return;
+    // Back off and wait for the writer to finish.
+    --count;
+    writer_mutex_.Lock();
+    writer_mutex_.Unlock();
+  }
+}
+
+void BigReaderLock::UnlockForRead() {
+  --reader_slots_[GetReaderSlot()].count;
+}
+
+void BigReaderLock::LockForWrite() {
+  ++writer_count_;
+  writer_mutex_.Lock();
+  writer_active_ = true;
+  for (size_t i = 0; i < kReaderSlotCount; ++i) {
+    while (reader_slots_[i].count)
+      port::YieldThread();
+  }
+}
+
+void BigReaderLock::UnlockForWrite() {
+  writer_active_ = false;
+  writer_mutex_.Unlock();
+  --writer_count_;
+}
+
+int BigReaderLock::GetReaderCount() const {
+  int count = 0;
+  for (size_t i = 0; i < kReaderSlotCount; ++i)
+    count += reader_slots_[i].count;
+  return count;
+}
+
 }  // namespace base
 }  // namespace ion
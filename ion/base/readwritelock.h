@@ -40,7 +40,8 @@ namespace base {
 //
 // This particular implementation has the following behaviors:
 // - If there are no writers, then only the first reader to obtain the read lock
-//   Wait()s on a Semaphore.
+//   Wait()s on a Semaphore. Readers arriving while the first reader is blocked
+//   wait behind it on a Mutex.
 // - If there are no writers, then only the last reader to unlock the read lock
 //   actually Post()s a Semaphore.
 // - Writers cannot obtain a lock until all readers have exited, but while
@@ -77,17 +78,80 @@ class ION_API ReadWriteLock {
   std::atomic<int> writer_count_;
   port::Semaphore room_empty_;
   port::Mutex turnstile_;
+  // Serializes readers entering an empty lock.
+  port::Mutex first_reader_mutex_;
 
   DISALLOW_COPY_AND_ASSIGN(ReadWriteLock);
 };
 
-// A ReadLock obtains a read lock, but has a similar interface to a Mutex and
-// can be used with a ReadGuard.
-class ION_API ReadLock {
+// The BigReaderLock class defines a reader-biased lock with the same interface
+// as ReadWriteLock, for locks that are read very often from many threads and
+// written rarely. A ReadWriteLock counts its readers in a single atomic, so
+// readers on different cores contend for the same cache line even when there
+// are no writers. A BigReaderLock instead spreads its readers over
+// kReaderSlotCount counters, each in its own cache line, chosen by the calling
+// thread, so that uncontended readers on different threads usually touch
+// different cache lines. Writers are correspondingly slower: a writer must
+// check every slot, and waits for all readers to exit. A BigReaderLock also
+// uses kReaderSlotCount cache lines of memory, so it is best suited to a few
+// long-lived, shared locks rather than a lock per object.
+//
+// As with ReadWriteLock, the lock is non-promotable, and a thread that already
+// holds a read lock must not take another one while a writer may be waiting.
+class ION_API BigReaderLock {
+ public:
+  static const size_t kReaderSlotCount = 16U;
+
+  BigReaderLock();
+  ~BigReaderLock();
+
+  // Locks the BigReaderLock for reading. This blocks only while a writer holds
+  // or is waiting for the lock.
+  void LockForRead();
+  // Unlocks the BigReaderLock for reading. This must be called on the thread
+  // that locked it.
+  void UnlockForRead();
+  // Locks the BigReaderLock for writing. New readers are blocked, and the
+  // caller waits until all current readers have exited.
+  void LockForWrite();
+  // Unlocks the BigReaderLock for writing.
+  void UnlockForWrite();
+
+  // Returns the number of readers in this lock. This may transiently include
+  // readers that are backing off from a writer.
+  int GetReaderCount() const;
+  // Returns the number of writers in this lock.
+  int GetWriterCount() const { return writer_count_; }
+
+ private:
+  // A reader counter, padded to fill a cache line so that readers using
+  // different slots do not contend.
+  struct ReaderSlot {
+    ReaderSlot() : count(0) {}
+    std::atomic<int> count;
+    char padding[64U - sizeof(std::atomic<int>)];
+  };
+
+  ReaderSlot reader_slots_[kReaderSlotCount];
+  // Whether a writer holds or is waiting for the lock.
+  std::atomic<bool> writer_active_;
+  std::atomic<int> writer_count_;
+  // Serializes writers, and blocks readers while a writer is active.
+  port::Mutex writer_mutex_;
+
+  DISALLOW_COPY_AND_ASSIGN(BigReaderLock);
+};
+
+// A GenericReadLock obtains a read lock on a ReadWriteLock or BigReaderLock,
+// but has a similar interface to a Mutex and can be used with a
+// GenericLockGuard. ReadLock and BigReaderReadLock are the usual
+// instantiations.
+template <typename LockType>
+class GenericReadLock {
  public:
   // The passed pointer must be non-NULL.
-  explicit ReadLock(ReadWriteLock* lock) : lock_(*lock) {}
-  ~ReadLock() {}
+  explicit GenericReadLock(LockType* lock) : lock_(*lock) {}
+  ~GenericReadLock() {}
   // "Locks" the lock for reading, which may or may not block. See the comments
   // for ReadWriteLock.
   void Lock() { lock_.LockForRead(); }
@@ -101,18 +165,21 @@ class ION_API ReadLock {
   bool IsLocked() const { return lock_.GetReaderCount() > 0; }
 
  private:
-  ReadWriteLock& lock_;
+  LockType& lock_;
 
-  DISALLOW_IMPLICIT_CONSTRUCTORS(ReadLock);
+  DISALLOW_IMPLICIT_CONSTRUCTORS(GenericReadLock);
 };
 
-// A WriteLock obtains a write lock, but has a similar interface to a Mutex and
-// can be used with a WriteGuard.
-class ION_API WriteLock {
+// A GenericWriteLock obtains a write lock on a ReadWriteLock or BigReaderLock,
+// but has a similar interface to a Mutex and can be used with a
+// GenericLockGuard. WriteLock and BigReaderWriteLock are the usual
+// instantiations.
+template <typename LockType>
+class GenericWriteLock {
  public:
   // The passed pointer must be non-NULL.
-  explicit WriteLock(ReadWriteLock* lock) : lock_(*lock) {}
-  ~WriteLock() {}
+  explicit GenericWriteLock(LockType* lock) : lock_(*lock) {}
+  ~GenericWriteLock() {}
   // "Locks" the lock for writing, which blocks if there are any readers or
   // writers holding the lock. See the comments for ReadWriteLock.
   void Lock() { lock_.LockForWrite(); }
@@ -124,11 +191,16 @@ class ION_API WriteLock {
   bool IsLocked() const { return lock_.GetWriterCount() > 0; }
 
  private:
-  ReadWriteLock& lock_;
+  LockType& lock_;
 
-  DISALLOW_IMPLICIT_CONSTRUCTORS(WriteLock);
+  DISALLOW_IMPLICIT_CONSTRUCTORS(GenericWriteLock);
 };
 
+typedef GenericReadLock<ReadWriteLock> ReadLock;
+typedef GenericWriteLock<ReadWriteLock> WriteLock;
+typedef GenericReadLock<BigReaderLock> BigReaderReadLock;
+typedef GenericWriteLock<BigReaderLock> BigReaderWriteLock;
+
 }  // namespace base
 }  // namespace ion
 
@@ -0,0 +1,421 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/samplingallocationtracker.h"
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/base/staticsafedeclare.h"
+#include "ion/port/mutex.h"
+#include "ion/port/stacktrace.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// The tag of allocations made outside of any ScopedTag.
+static const char kUntagged[] = "untagged";
+
+// The innermost tag of a thread.
+struct TagState {
+  TagState() : tag(kUntagged) {}
+  const char* tag;
+};
+
+static TagState* GetTagState() {
+  ION_DECLARE_SAFE_STATIC_POINTER(ThreadLocalObject<TagState>, s_states);
+  return s_states->Get();
+}
+
+// Returns the lifetime that the passed Allocator is the default Allocator
+// for, or kNumAllocationLifetimes.
+static int GetLifetime(const Allocator& allocator) {
+  for (int i = 0; i < kNumAllocationLifetimes; ++i) {
+    if (AllocationManager::GetDefaultAllocatorForLifetime(
+            static_cast<AllocationLifetime>(i)).Get() == &allocator)
+      return i;
+  }
+  return kNumAllocationLifetimes;
+}
+
+static const char* GetLifetimeName(int lifetime) {
+  switch (lifetime) {
+    case kShortTerm: return "kShortTerm";
+    case kMediumTerm: return "kMediumTerm";
+    case kLongTerm: return "kLongTerm";
+    default: return "unknown";
+  }
+}
+
+// Writes a string as a quoted JSON string.
+static void WriteJsonString(const std::string& str, std::ostream* out) {
+  *out << '"';
+  for (size_t i = 0; i < str.length(); ++i) {
+    const char c = str[i];
+    if (c == '"' || c == '\\')
+      *out << '\\' << c;
+    else if (c == '\n')
+      *out << "\\n";
+    else if (static_cast<unsigned char>(c) < 0x20)
+      *out << ' ';
+    else
+      *out << c;
+  }
+  *out << '"';
+}
+
+// Writes the Stats fields as JSON object members.
+static void WriteJsonStats(const SamplingAllocationTracker::Stats& stats,
+                           std::ostream* out) {
+  *out << "\"live_bytes\": " << stats.live_bytes
+       << ", \"allocated_bytes\": " << stats.allocated_bytes
+       << ", \"live_samples\": " << stats.live_samples;
+}
+
+// Orders Stats by decreasing live bytes, then by decreasing allocated bytes.
+static bool IsLarger(const SamplingAllocationTracker::Stats& a,
+                     const SamplingAllocationTracker::Stats& b) {
+  return a.live_bytes != b.live_bytes ? a.live_bytes > b.live_bytes
+                                      : a.allocated_bytes > b.allocated_bytes;
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// SamplingAllocationTracker::Helper class.
+//
+//-----------------------------------------------------------------------------
+
+// The Helper uses only std containers so that it never allocates through the
+// Allocators it may be tracking.
+class SamplingAllocationTracker::Helper {
+ public:
+  Helper() : live_bytes_(0U) {}
+
+  // Adds a live sample for memory.
+  void AddSample(const void* memory, uint64 weight, const char* tag,
+                 int lifetime, const port::StackTrace& trace) {
+    Sample sample;
+    sample.weight = weight;
+    {
+      LockGuard lock(&stats_mutex_);
+      const TagKey key(tag, lifetime);
+      TagMap::iterator tag_it = tag_indices_.find(key);
+      if (tag_it == tag_indices_.end()) {
+        tag_it = tag_indices_.insert(
+            std::make_pair(key, tag_stats_.size())).first;
+        TagStats stats;
+        stats.tag = tag;
+        stats.lifetime = lifetime;
+        tag_stats_.push_back(stats);
+      }
+      sample.tag_index = tag_it->second;
+
+      const std::vector<void*>& addresses = trace.GetAddresses();
+      StackMap::iterator stack_it = stack_indices_.find(addresses);
+      if (stack_it == stack_indices_.end()) {
+        stack_it = stack_indices_.insert(
+            std::make_pair(addresses, stacks_.size())).first;
+        stacks_.push_back(Stack(trace));
+      }
+      sample.stack_index = stack_it->second;
+
+      Update(&tag_stats_[sample.tag_index], weight, true);
+      Update(&stacks_[sample.stack_index].stats, weight, true);
+      live_bytes_ += weight;
+    }
+    Shard* shard = GetShard(memory);
+    LockGuard lock(&shard->mutex);
+    shard->samples[memory] = sample;
+  }
+
+  // Removes the sample for memory, if there is one. Returns whether there
+  // was.
+  bool RemoveSample(const void* memory) {
+    Sample sample;
+    {
+      Shard* shard = GetShard(memory);
+      LockGuard lock(&shard->mutex);
+      SampleMap::iterator it = shard->samples.find(memory);
+      if (it == shard->samples.end())
+        return false;
+      sample = it->second;
+      shard->samples.erase(it);
+    }
+    LockGuard lock(&stats_mutex_);
+    Update(&tag_stats_[sample.tag_index], sample.weight, false);
+    Update(&stacks_[sample.stack_index].stats, sample.weight, false);
+    DCHECK_GE(live_bytes_, sample.weight);
+    live_bytes_ -= sample.weight;
+    return true;
+  }
+
+  uint64 GetLiveBytes() const {
+    LockGuard lock(&stats_mutex_);
+    return live_bytes_;
+  }
+
+  void GetStats(bool include_stacks, Snapshot* snapshot) const {
+    std::vector<Stack> stacks;
+    {
+      LockGuard lock(&stats_mutex_);
+      snapshot->tags = tag_stats_;
+      if (include_stacks)
+        stacks = stacks_;
+    }
+    std::sort(snapshot->tags.begin(), snapshot->tags.end(), IsLarger);
+    // Symbolize the stacks outside of the lock, since it is slow.
+    snapshot->stacks.resize(stacks.size());
+    for (size_t i = 0; i < stacks.size(); ++i) {
+      StackStats& stats = snapshot->stacks[i];
+      static_cast<Stats&>(stats) = stacks[i].stats;
+      stats.stack = stacks[i].trace.GetSymbolString();
+    }
+    std::sort(snapshot->stacks.begin(), snapshot->stacks.end(), IsLarger);
+  }
+
+ private:
+  // A live sampled allocation.
+  struct Sample {
+    uint64 weight;
+    size_t tag_index;
+    size_t stack_index;
+  };
+  typedef std::unordered_map<const void*, Sample> SampleMap;
+
+  // Samples are spread over several maps so that concurrent deallocations
+  // rarely contend for a lock.
+  static const size_t kNumShards = 16U;
+  struct Shard {
+    port::Mutex mutex;
+    SampleMap samples;
+  };
+
+  // A sampled call stack.
+  struct Stack {
+    explicit Stack(const port::StackTrace& trace_in) : trace(trace_in) {}
+    port::StackTrace trace;
+    Stats stats;
+  };
+
+  typedef std::pair<std::string, int> TagKey;
+  typedef std::map<TagKey, size_t> TagMap;
+  typedef std::map<std::vector<void*>, size_t> StackMap;
+
+  Shard* GetShard(const void* memory) {
+    // Allocations are usually 16-byte aligned, so skip the low bits.
+    return &shards_[(reinterpret_cast<uintptr_t>(memory) >> 4) % kNumShards];
+  }
+
+  static void Update(Stats* stats, uint64 weight, bool is_allocation) {
+    if (is_allocation) {
+      stats->live_bytes += weight;
+      stats->allocated_bytes += weight;
+      ++stats->live_samples;
+    } else {
+      DCHECK_GE(stats->live_bytes, weight);
+      DCHECK_LT(0U, stats->live_samples);
+      stats->live_bytes -= weight;
+      --stats->live_samples;
+    }
+  }
+
+  Shard shards_[kNumShards];
+
+  // Protects everything below.
+  mutable port::Mutex stats_mutex_;
+  TagMap tag_indices_;
+  std::vector<TagStats> tag_stats_;
+  StackMap stack_indices_;
+  std::vector<Stack> stacks_;
+  uint64 live_bytes_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// SamplingAllocationTracker::ScopedTag class.
+//
+//-----------------------------------------------------------------------------
+
+SamplingAllocationTracker::ScopedTag::ScopedTag(const char* tag) {
+  TagState* state = GetTagState();
+  previous_tag_ = state->tag;
+  state->tag = tag ? tag : kUntagged;
+}
+
+SamplingAllocationTracker::ScopedTag::~ScopedTag() {
+  GetTagState()->tag = previous_tag_;
+}
+
+//-----------------------------------------------------------------------------
+//
+// SamplingAllocationTracker class.
+//
+//-----------------------------------------------------------------------------
+
+const size_t SamplingAllocationTracker::kDefaultSampleInterval;
+
+SamplingAllocationTracker::SamplingAllocationTracker()
+    : sample_interval_(kDefaultSampleInterval),
+      allocation_count_(0U),
+      deallocation_count_(0U),
+      allocated_bytes_(0U),
+      live_sample_count_(0U),
+      helper_(new Helper) {}
+
+SamplingAllocationTracker::SamplingAllocationTracker(size_t sample_interval)
+    : sample_interval_(sample_interval),
+      allocation_count_(0U),
+      deallocation_count_(0U),
+      allocated_bytes_(0U),
+      live_sample_count_(0U),
+      helper_(new Helper) {}
+
+SamplingAllocationTracker::~SamplingAllocationTracker() {}
+
+void SamplingAllocationTracker::InstallOnDefaultAllocators(
+    const SamplingAllocationTrackerPtr& tracker) {
+  for (int i = 0; i < kNumAllocationLifetimes; ++i) {
+    const AllocatorPtr& allocator =
+        AllocationManager::GetDefaultAllocatorForLifetime(
+            static_cast<AllocationLifetime>(i));
+    if (allocator.Get() && !allocator->GetTracker().Get())
+      allocator->SetTracker(tracker);
+  }
+}
+
+void SamplingAllocationTracker::TrackAllocation(const Allocator& allocator,
+                                                size_t requested_size,
+                                                const void* memory) {
+  allocation_count_.fetch_add(1U, std::memory_order_relaxed);
+  allocated_bytes_.fetch_add(requested_size, std::memory_order_relaxed);
+  if (!memory)
+    return;
+
+  // Each sample stands for all of the bytes the thread allocated since its
+  // previous sample.
+  Countdown* countdown = countdowns_.Get();
+  countdown->bytes += requested_size;
+  if (countdown->bytes >= sample_interval_) {
+    const uint64 weight = countdown->bytes;
+    countdown->bytes = 0U;
+    AddSample(allocator, memory, weight);
+  }
+}
+
+void SamplingAllocationTracker::TrackDeallocation(const Allocator& allocator,
+                                                  const void* memory) {
+  deallocation_count_.fetch_add(1U, std::memory_order_relaxed);
+  if (memory && live_sample_count_.load(std::memory_order_acquire) &&
+      helper_->RemoveSample(memory))
+    live_sample_count_.fetch_sub(1U, std::memory_order_release);
+}
+
+void SamplingAllocationTracker::AddSample(const Allocator& allocator,
+                                          const void* memory, uint64 weight) {
+  const port::StackTrace trace;
+  // Count the sample first so that a racing deallocation looks it up.
+  live_sample_count_.fetch_add(1U, std::memory_order_acq_rel);
+  helper_->AddSample(memory, weight, GetTagState()->tag,
+                     GetLifetime(allocator), trace);
+}
+
+size_t SamplingAllocationTracker::GetLiveSampleCount() const {
+  return live_sample_count_.load(std::memory_order_acquire);
+}
+
+const SamplingAllocationTracker::Snapshot
+SamplingAllocationTracker::GetSnapshot(bool include_stacks) const {
+  Snapshot snapshot;
+  snapshot.sample_interval = sample_interval_;
+  snapshot.allocation_count = allocation_count_.load();
+  snapshot.allocated_bytes = allocated_bytes_.load();
+  helper_->GetStats(include_stacks, &snapshot);
+  return snapshot;
+}
+
+const std::string SamplingAllocationTracker::GetSnapshotJson(
+    bool include_stacks) const {
+  const Snapshot snapshot = GetSnapshot(include_stacks);
+  std::ostringstream out;
+  out << "{ \"sample_interval\": " << snapshot.sample_interval
+      << ", \"allocation_count\": " << snapshot.allocation_count
+      << ", \"allocated_bytes\": " << snapshot.allocated_bytes
+      << ", \"tags\": [";
+  for (size_t i = 0; i < snapshot.tags.size(); ++i) {
+    const TagStats& stats = snapshot.tags[i];
+    out << (i ? ", " : " ") << "{ \"tag\": ";
+    WriteJsonString(stats.tag, &out);
+    out << ", \"lifetime\": \"" << GetLifetimeName(stats.lifetime) << "\", ";
+    WriteJsonStats(stats, &out);
+    out << " }";
+  }
+  out << " ], \"stacks\": [";
+  for (size_t i = 0; i < snapshot.stacks.size(); ++i) {
+    const StackStats& stats = snapshot.stacks[i];
+    out << (i ? ", " : " ") << "{ \"stack\": ";
+    WriteJsonString(stats.stack, &out);
+    out << ", ";
+    WriteJsonStats(stats, &out);
+    out << " }";
+  }
+  out << " ] }";
+  return out.str();
+}
+
+size_t SamplingAllocationTracker::GetAllocationCount() {
+  return allocation_count_.load();
+}
+
+size_t SamplingAllocationTracker::GetDeallocationCount() {
+  return deallocation_count_.load();
+}
+
+size_t SamplingAllocationTracker::GetAllocatedBytesCount() {
+  return allocated_bytes_.load();
+}
+
+size_t SamplingAllocationTracker::GetDeallocatedBytesCount() { return 0U; }
+
+size_t SamplingAllocationTracker::GetActiveAllocationCount() { return 0U; }
+
+size_t SamplingAllocationTracker::GetActiveAllocationBytesCount() {
+  return static_cast<size_t>(helper_->GetLiveBytes());
+}
+
+void SamplingAllocationTracker::SetGpuTracker(
+    const AllocationSizeTrackerPtr& gpu_tracker) {
+  gpu_tracker_ = gpu_tracker;
+}
+
+AllocationSizeTrackerPtr SamplingAllocationTracker::GetGpuTracker() {
+  return gpu_tracker_;
+}
+
+}  // namespace base
+}  // namespace ion
@@ -0,0 +1,190 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_SAMPLINGALLOCATIONTRACKER_H_
+#define ION_BASE_SAMPLINGALLOCATIONTRACKER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocationtracker.h"
+#include "ion/base/allocator.h"
+#include "ion/base/threadlocalobject.h"
+
+namespace ion {
+namespace base {
+
+// SamplingAllocationTracker is a derived AllocationTracker class that is cheap
+// enough to leave installed in production builds. Instead of recording every
+// allocation as FullAllocationTracker does, it records roughly one allocation
+// for every GetSampleInterval() bytes allocated by each thread, along with a
+// stack trace of the allocation. Each sample stands for the bytes allocated
+// since the previous sample, so GetSnapshot() estimates how much live memory
+// each subsystem, AllocationLifetime, and call stack is responsible for.
+//
+// Allocations are attributed to the innermost ScopedTag active in the
+// allocating thread, e.g.:
+//
+//   {
+//     SamplingAllocationTracker::ScopedTag tag("text");
+//     ... build some text ...
+//   }
+//
+// and to the lifetime of the default Allocator (see AllocationManager) that
+// made them. Use a distinct Allocator per lifetime to tell lifetimes apart;
+// allocations made by an Allocator that is the default for several lifetimes
+// are attributed to the shortest of them, and those made by any other
+// Allocator to kNumAllocationLifetimes.
+//
+// The tracker does not allocate memory through Ion Allocators, so it may track
+// the default Allocators; InstallOnDefaultAllocators() does exactly that.
+class ION_API SamplingAllocationTracker : public AllocationTracker {
+ public:
+  // The default number of bytes between samples.
+  static const size_t kDefaultSampleInterval = 512U * 1024U;
+
+  // Aggregated statistics for one (tag, lifetime) pair or one call stack. Byte
+  // counts are estimates computed from the samples.
+  struct Stats {
+    Stats() : live_bytes(0U), allocated_bytes(0U), live_samples(0U) {}
+    uint64 live_bytes;
+    uint64 allocated_bytes;
+    size_t live_samples;
+  };
+  struct TagStats : Stats {
+    std::string tag;
+    // The lifetime, or kNumAllocationLifetimes if it is not known.
+    int lifetime;
+  };
+  struct StackStats : Stats {
+    // The symbolized stack of the allocation, one frame per line.
+    std::string stack;
+  };
+  // A snapshot of the samples, sorted by decreasing live bytes.
+  struct Snapshot {
+    Snapshot() : sample_interval(0U), allocation_count(0U),
+                 allocated_bytes(0U) {}
+    size_t sample_interval;
+    // Exact totals for all tracked allocations.
+    size_t allocation_count;
+    size_t allocated_bytes;
+    std::vector<TagStats> tags;
+    std::vector<StackStats> stacks;
+  };
+
+  // Sets the tag of allocations made by the calling thread while the instance
+  // exists. The passed string must outlive the instance, and is usually a
+  // string literal.
+  class ION_API ScopedTag {
+   public:
+    explicit ScopedTag(const char* tag);
+    ~ScopedTag();
+
+   private:
+    const char* previous_tag_;
+    DISALLOW_COPY_AND_ASSIGN(ScopedTag);
+  };
+
+  // A sample interval of 0 samples every allocation.
+  SamplingAllocationTracker();
+  explicit SamplingAllocationTracker(size_t sample_interval);
+
+  // Returns the number of bytes between samples.
+  size_t GetSampleInterval() const { return sample_interval_; }
+
+  // Returns the number of sampled allocations that are still live.
+  size_t GetLiveSampleCount() const;
+
+  // Returns the current statistics. If include_stacks is false the (slow)
+  // symbolization of the sampled stacks is skipped and stacks is empty.
+  const Snapshot GetSnapshot(bool include_stacks) const;
+  // Returns GetSnapshot(include_stacks) as a JSON object, e.g.:
+  //   { "sample_interval": 524288, "allocation_count": 120,
+  //     "allocated_bytes": 1048576,
+  //     "tags": [ { "tag": "text", "lifetime": "kMediumTerm",
+  //                 "live_bytes": 524288, "allocated_bytes": 1048576,
+  //                 "live_samples": 1 } ],
+  //     "stacks": [ { "stack": "...", "live_bytes": 524288, ... } ] }
+  const std::string GetSnapshotJson(bool include_stacks) const;
+
+  // Installs the passed tracker on each default Allocator of the
+  // AllocationManager that does not already have a tracker.
+  static void InstallOnDefaultAllocators(
+      const SharedPtr<SamplingAllocationTracker>& tracker);
+
+  // AllocationTracker interface implementations. GetDeallocatedBytesCount()
+  // and GetActiveAllocationCount() are not supported and return 0, and
+  // GetActiveAllocationBytesCount() returns an estimate.
+  void TrackAllocation(const Allocator& allocator,
+                       size_t requested_size, const void* memory) override;
+  void TrackDeallocation(const Allocator& allocator,
+                         const void* memory) override;
+  size_t GetAllocationCount() override;
+  size_t GetDeallocationCount() override;
+  size_t GetAllocatedBytesCount() override;
+  size_t GetDeallocatedBytesCount() override;
+  size_t GetActiveAllocationCount() override;
+  size_t GetActiveAllocationBytesCount() override;
+
+  void SetGpuTracker(const AllocationSizeTrackerPtr& gpu_tracker) override;
+  AllocationSizeTrackerPtr GetGpuTracker() override;
+
+ protected:
+  // The destructor is protected because all instances should be managed
+  // through SharedPtr.
+  ~SamplingAllocationTracker() override;
+
+ private:
+  // Per-thread sampling state.
+  struct Countdown {
+    Countdown() : bytes(0U) {}
+    // The number of bytes allocated since the last sample.
+    uint64 bytes;
+  };
+
+  // Helper class that holds the samples.
+  class Helper;
+
+  // Records a sample of the passed weight for memory.
+  void AddSample(const Allocator& allocator, const void* memory,
+                 uint64 weight);
+
+  const size_t sample_interval_;
+  ThreadLocalObject<Countdown> countdowns_;
+  std::atomic<size_t> allocation_count_;
+  std::atomic<size_t> deallocation_count_;
+  std::atomic<size_t> allocated_bytes_;
+  // The number of live samples. Deallocations skip the sample lookup while it
+  // is zero.
+  std::atomic<size_t> live_sample_count_;
+  std::unique_ptr<Helper> helper_;
+  AllocationSizeTrackerPtr gpu_tracker_;
+
+  DISALLOW_COPY_AND_ASSIGN(SamplingAllocationTracker);
+};
+
+// Convenience typedef for shared pointer to a SamplingAllocationTracker.
+typedef SharedPtr<SamplingAllocationTracker> SamplingAllocationTrackerPtr;
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_SAMPLINGALLOCATIONTRACKER_H_
@@ -48,6 +48,12 @@ void SettingBase::UnregisterListener(const std::string& key) {
 }
 
 void SettingBase::NotifyListeners() {
+  UpdateSnapshot();
+  if (!SettingManager::DeferNotification(this))
+    CallListeners();
+}
+
+void SettingBase::CallListeners() {
   for (ListenerMap::const_iterator it = listeners_.begin();
        it != listeners_.end(); ++it) {
     if (it->second.enabled)
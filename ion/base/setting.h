@@ -22,6 +22,7 @@ limitations under the License.
 #include <map>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 #include "base/macros.h"
 #include "ion/base/serialize.h"
@@ -74,7 +75,10 @@ class ION_API SettingBase {
   // Removes the listener identified by key, if one exists.
   void UnregisterListener(const std::string& key);
 
-  // Notify listeners that this setting has changed.
+  // Notify listeners that this setting has changed. If notifications are
+  // deferred (see SettingManager::EnableDeferredNotifications()), the
+  // listeners are instead called by the next call to
+  // SettingManager::DeliverDeferredNotifications().
   void NotifyListeners();
 
   // Returns a string version of this setting. The same string may be passed to
@@ -91,9 +95,16 @@ class ION_API SettingBase {
   SettingBase(const std::string& name, const std::string& doc_string);
   virtual ~SettingBase();
 
+  // Called by NotifyListeners() before any listeners so that derived classes
+  // can update copies of the value.
+  virtual void UpdateSnapshot() {}
+
  private:
   typedef std::map<std::string, ListenerInfo> ListenerMap;
 
+  // Calls the enabled listeners.
+  void CallListeners();
+
   std::string name_;
   std::string doc_string_;
   std::string type_descriptor_;
@@ -134,6 +145,27 @@ class ION_API SettingGroup {
   std::string group_;
 };
 
+// Holds a copy of the value of a Setting of a scalar type that can be read from
+// any thread with a single relaxed atomic load, e.g., in rendering code that
+// checks a setting for every draw. Settings of other types have no copy.
+template <typename T, bool IsScalar = std::is_scalar<T>::value>
+class SettingSnapshot {
+ public:
+  explicit SettingSnapshot(const T& value) : value_(value) {}
+  void Store(const T& value) { value_.store(value, std::memory_order_relaxed); }
+  T Load() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<T> value_;
+};
+
+template <typename T>
+class SettingSnapshot<T, false> {
+ public:
+  explicit SettingSnapshot(const T& value) {}
+  void Store(const T& value) {}
+};
+
 // Forward references.
 template <typename T> class Setting;
 template <typename SettingType>
@@ -158,7 +190,7 @@ class Setting : public SettingBase {
   // documentation string.
   Setting(const std::string& name, const T& value,
           const std::string& doc_string)
-      : SettingBase(name, doc_string), value_(value) {
+      : SettingBase(name, doc_string), value_(value), snapshot_(value) {
     SetTypeDescriptorForType(this);
   }
 
@@ -166,20 +198,22 @@ class Setting : public SettingBase {
   Setting(const SettingGroup* group, const std::string& name, const T& value,
           const std::string& doc_string)
       : SettingBase(group->GetGroupName() + '/' + name, doc_string),
-        value_(value) {
+        value_(value),
+        snapshot_(value) {
     SetTypeDescriptorForType(this);
   }
 
   // Convenience constructor that does not require a documentation string.
   Setting(const std::string& name, const T& value)
-      : SettingBase(name, std::string()), value_(value) {
+      : SettingBase(name, std::string()), value_(value), snapshot_(value) {
     SetTypeDescriptorForType(this);
   }
 
   // Same as above, but places the setting in the passed group.
   Setting(const SettingGroup* group, const std::string& name, const T& value)
       : SettingBase(group->GetGroupName()  + '/' + name, std::string()),
-        value_(value) {
+        value_(value),
+        snapshot_(value) {
     SetTypeDescriptorForType(this);
   }
 
@@ -197,9 +231,14 @@ class Setting : public SettingBase {
     return false;
   }
 
-  // Direct value mutators.
+  // Direct value mutators. Changes made through GetMutableValue() are not
+  // seen by GetSnapshot() until NotifyListeners() is called.
   T* GetMutableValue() { return &value_; }
   const T& GetValue() const { return value_; }
+  // Returns the value as of the last change, which for settings of scalar
+  // types can be read from any thread with one relaxed atomic load. This is
+  // only available for scalar types.
+  T GetSnapshot() const { return snapshot_.Load(); }
   void SetValue(const T& value) {
     value_ = value;
     NotifyListeners();
@@ -216,8 +255,12 @@ class Setting : public SettingBase {
     return setting.value_ == value;
   }
 
+ protected:
+  void UpdateSnapshot() override { snapshot_.Store(value_); }
+
  private:
   T value_;
+  SettingSnapshot<T> snapshot_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(Setting<T>);
 };
@@ -274,6 +317,9 @@ class Setting<std::atomic<T> > : public SettingBase {
   // Direct value mutators.
   std::atomic<T>* GetMutableValue() { return &value_; }
   const std::atomic<T>& GetValue() const { return value_; }
+  // Returns the value with a relaxed load, which is the cheapest way to read
+  // it from any thread.
+  T GetSnapshot() const { return value_.load(std::memory_order_relaxed); }
   void SetValue(const T& value) {
     value_ = value;
     NotifyListeners();
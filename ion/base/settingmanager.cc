@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "ion/base/settingmanager.h"
 
+#include <algorithm>
 #include <set>
 #include <vector>
 
@@ -26,6 +27,7 @@ limitations under the License.
 #include "ion/base/shareable.h"
 #include "ion/base/staticsafedeclare.h"
 #include "ion/base/stringutils.h"
+#include "ion/port/atomic.h"
 #include "ion/port/mutex.h"
 
 namespace ion {
@@ -39,6 +41,8 @@ static const char kListenerKey[] = "SettingManager";
 
 class SettingManager::SettingData : public Shareable {
  public:
+  SettingData() : defer_notifications_(false) {}
+
   // Listener function that notifies all listeners for a setting's groups that
   // the setting has changed.
   void SettingListener(SettingBase* setting);
@@ -57,6 +61,16 @@ class SettingManager::SettingData : public Shareable {
 
   const SettingMap& GetAllSettings() { return settings_; }
 
+  // These implement deferred notifications.
+  void EnableDeferredNotifications(bool enable) {
+    defer_notifications_.store(enable, std::memory_order_release);
+  }
+  bool AreNotificationsDeferred() const {
+    return defer_notifications_.load(std::memory_order_acquire);
+  }
+  bool DeferNotification(SettingBase* setting);
+  void DeliverDeferredNotifications();
+
   // The body of UnregisterSetting that must be called while mutex_ is locked.
   // This is to allow unregistration of old settings when a duplicate one is
   // registered.
@@ -85,6 +99,13 @@ class SettingManager::SettingData : public Shareable {
   SettingMap settings_;
   GroupMap setting_groups_;
   SettingGroupMap groups_;
+
+  // Settings whose listeners have not yet been notified of a change, in the
+  // order they first changed. This has its own mutex since settings may change
+  // on any thread.
+  std::atomic<bool> defer_notifications_;
+  port::Mutex pending_mutex_;
+  std::vector<SettingBase*> pending_settings_;
 };
 
 //-----------------------------------------------------------------------------
@@ -182,6 +203,34 @@ void SettingManager::SettingData::UnregisterSettingLocked(
     settings_.erase(it);
   }
   setting->UnregisterListener(kListenerKey);
+
+  // The setting's listeners can no longer be called.
+  LockGuard lock(&pending_mutex_);
+  pending_settings_.erase(std::remove(pending_settings_.begin(),
+                                      pending_settings_.end(), setting),
+                          pending_settings_.end());
+}
+
+bool SettingManager::SettingData::DeferNotification(SettingBase* setting) {
+  if (!AreNotificationsDeferred())
+    return false;
+  LockGuard lock(&pending_mutex_);
+  if (std::find(pending_settings_.begin(), pending_settings_.end(), setting) ==
+      pending_settings_.end())
+    pending_settings_.push_back(setting);
+  return true;
+}
+
+void SettingManager::SettingData::DeliverDeferredNotifications() {
+  // Listeners may change settings again, which queues them for the next call.
+  std::vector<SettingBase*> settings;
+  {
+    LockGuard lock(&pending_mutex_);
+    settings.swap(pending_settings_);
+  }
+  const size_t count = settings.size();
+  for (size_t i = 0; i < count; ++i)
+    settings[i]->CallListeners();
 }
 
 void SettingManager::SettingData::RegisterGroupListener(
@@ -259,6 +308,24 @@ void SettingManager::UnregisterGroupListener(const std::string& group,
   GetInstance()->data_->UnregisterGroupListener(group, key);
 }
 
+void SettingManager::EnableDeferredNotifications(bool enable) {
+  GetInstance()->data_->EnableDeferredNotifications(enable);
+}
+
+bool SettingManager::AreNotificationsDeferred() {
+  return GetInstance()->data_->AreNotificationsDeferred();
+}
+
+void SettingManager::DeliverDeferredNotifications() {
+  GetInstance()->data_->DeliverDeferredNotifications();
+}
+
+bool SettingManager::DeferNotification(SettingBase* setting) {
+  // As in UnregisterSetting(), use the SettingData the setting refers to.
+  SettingData* data = static_cast<SettingData*>(setting->data_ref_.Get());
+  return data && data->DeferNotification(setting);
+}
+
 SettingManager* SettingManager::GetInstance() {
   ION_DECLARE_SAFE_STATIC_POINTER(SettingManager, manager);
   return manager;
@@ -67,8 +67,26 @@ class ION_API SettingManager {
   static void UnregisterGroupListener(const std::string& group,
                                       const std::string& key);
 
+  // Sets/returns whether the listeners of settings, including group
+  // listeners, are called when a setting changes, the default, or only when
+  // DeliverDeferredNotifications() is called. Deferring notifications lets
+  // settings be changed from any thread, e.g., by a remote SettingHandler,
+  // while all listeners run on the thread that delivers them, such as the
+  // rendering thread between frames. Settings of scalar types should then be
+  // read with Setting::GetSnapshot(), which reflects changes immediately.
+  static void EnableDeferredNotifications(bool enable);
+  static bool AreNotificationsDeferred();
+  // Calls the listeners of each setting that has changed since the last call
+  // while notifications were deferred, once per setting, on the calling
+  // thread. Settings must not be destroyed while this is running.
+  static void DeliverDeferredNotifications();
+
  private:
   class SettingData;
+
+  // Queues a notification that the setting has changed if notifications are
+  // deferred, and returns whether it did.
+  static bool DeferNotification(SettingBase* setting);
   SharedPtr<SettingData> data_;
 
   // The constructor is private since this is a singleton class.
@@ -77,6 +95,8 @@ class ION_API SettingManager {
   // Returns the singleton instance.
   static SettingManager* GetInstance();
 
+  friend class SettingBase;
+
   DISALLOW_COPY_AND_ASSIGN(SettingManager);
 };
 
@@ -28,13 +28,38 @@ namespace base {
 // Shareable is an abstract base class for any object that can be shared via
 // the SharedPtr class. It supports the reference counting interface required
 // by SharedPtr.
+//
+// By default the reference count is updated with atomic read-modify-write
+// operations so that SharedPtrs to an instance may be copied and destroyed in
+// any thread. Instances that are known to be referenced from only a single
+// thread, such as scene graph objects owned by a render thread, may instead
+// use kSingleThreadRefCount, which updates the count with plain loads and
+// stores and avoids the cost of atomic operations.
 class Shareable {
  public:
+  // Policies for updating the reference count.
+  enum RefCountPolicy {
+    kThreadSafeRefCount,    // Atomic updates (the default).
+    kSingleThreadRefCount,  // Non-atomic updates; see the class comment.
+  };
+
   // GetRefCount() is part of the interface necessary for SharedPtr.
   int GetRefCount() const { return ref_count_; }
 
+  // Sets/returns the policy used to update the reference count. The policy
+  // must not be changed while SharedPtrs to this instance are being copied or
+  // destroyed in another thread, and kSingleThreadRefCount may only be used
+  // while all SharedPtrs (and WeakReferentPtrs) to this instance are accessed
+  // from a single thread.
+  void SetRefCountPolicy(RefCountPolicy policy) {
+    is_single_thread_ = policy == kSingleThreadRefCount;
+  }
+  RefCountPolicy GetRefCountPolicy() const {
+    return is_single_thread_ ? kSingleThreadRefCount : kThreadSafeRefCount;
+  }
+
  protected:
-  Shareable(): ref_count_(0) {}
+  Shareable() : ref_count_(0), is_single_thread_(false) {}
 
   // The destructor is protected because all instances should be managed
   // through SharedPtr.
@@ -43,9 +68,21 @@ class Shareable {
  private:
   // These are part of the interface necessary for SharedPtr. They are private
   // to prevent anyone messing with the reference count.
-  void IncrementRefCount() const { ++ref_count_; }
+  void IncrementRefCount() const {
+    if (is_single_thread_)
+      ref_count_.store(ref_count_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+    else
+      ++ref_count_;
+  }
   void DecrementRefCount() const {
-    const int new_count = --ref_count_;
+    int new_count;
+    if (is_single_thread_) {
+      new_count = ref_count_.load(std::memory_order_relaxed) - 1;
+      ref_count_.store(new_count, std::memory_order_relaxed);
+    } else {
+      new_count = --ref_count_;
+    }
     DCHECK_GE(new_count, 0);
     if (new_count == 0) {
       OnZeroRefCount();
@@ -57,6 +94,8 @@ class Shareable {
   // The reference count is atomic to provide thread safety. It is mutable so
   // that const instances can be managed.
   mutable std::atomic<int> ref_count_;
+  // Whether the reference count uses kSingleThreadRefCount.
+  bool is_single_thread_;
 
   // Allow SharedPtr to modify the reference count.
   template <typename T> friend class SharedPtr;
@@ -18,34 +18,137 @@ limitations under the License.
 #include "ion/base/spinmutex.h"
 
 #include "ion/base/logging.h"
+#include "ion/port/futex.h"
 #include "ion/port/threadutils.h"
 
 namespace ion {
 namespace base {
 
+namespace {
+
+// The number of times a contended Lock() retries before waiting in the OS,
+// and the most CPU pauses between retries. The pauses double with each retry,
+// so this spins for a few microseconds at most.
+static const int kMaxSpinRounds = 10;
+static const int kMaxPauseCount = 64;
+
+// Shared contention counters. Each is only updated while statistics are
+// enabled.
+static std::atomic<bool> s_statistics_enabled(false);
+static std::atomic<uint64> s_acquisition_count(0U);
+static std::atomic<uint64> s_spin_count(0U);
+static std::atomic<uint64> s_wait_count(0U);
+
+static void CountAcquisition(uint64 spins, uint64 waits) {
+  if (s_statistics_enabled.load(std::memory_order_relaxed)) {
+    s_acquisition_count.fetch_add(1U, std::memory_order_relaxed);
+    if (spins)
+      s_spin_count.fetch_add(spins, std::memory_order_relaxed);
+    if (waits)
+      s_wait_count.fetch_add(waits, std::memory_order_relaxed);
+  }
+}
+
+}  // anonymous namespace
+
 SpinMutex::~SpinMutex() { DCHECK(!IsLocked()); }
 
 void SpinMutex::Lock() {
-  unsigned int try_count = 0;
-  bool already_locked = false;
-  while (!locked_.compare_exchange_weak(
-             already_locked, true, std::memory_order_acquire)) {
-    already_locked = false;
-    if (++try_count > 1000) {
-      port::YieldThread();
+  int32 state = kUnlocked;
+  if (state_.compare_exchange_strong(state, kLocked,
+                                     std::memory_order_acquire)) {
+    CountAcquisition(0U, 0U);
+  } else {
+    LockContended();
+  }
+}
+
+void SpinMutex::LockContended() {
+  uint64 spins = 0U;
+  uint64 waits = 0U;
+
+  // Spin while the owner is likely to be running and about to unlock. Only
+  // try to take the mutex when it looks unlocked, so that waiters do not keep
+  // stealing the cache line from the owner.
+  int pause_count = 1;
+  for (int round = 0; round < kMaxSpinRounds; ++round) {
+    for (int i = 0; i < pause_count; ++i)
+      port::PauseCpu();
+    ++spins;
+    if (pause_count < kMaxPauseCount)
+      pause_count *= 2;
+    int32 state = state_.load(std::memory_order_relaxed);
+    if (state == kUnlocked &&
+        state_.compare_exchange_weak(state, kLocked,
+                                     std::memory_order_acquire)) {
+      CountAcquisition(spins, waits);
+      return;
     }
   }
+
+  // The owner has probably been descheduled, so stop burning the CPU it needs.
+#if ION_PORT_HAS_FUTEX
+  // Mark the mutex as having waiters so that Unlock() wakes one. This may
+  // wake a thread needlessly if this thread takes the mutex right away, which
+  // is harmless.
+  while (state_.exchange(kLockedWithWaiters, std::memory_order_acquire) !=
+         kUnlocked) {
+    ++waits;
+    port::futex::Wait(&state_, kLockedWithWaiters, NULL);
+  }
+#else
+  int32 state = kUnlocked;
+  while (!state_.compare_exchange_weak(state, kLocked,
+                                       std::memory_order_acquire)) {
+    state = kUnlocked;
+    ++waits;
+    port::YieldThread();
+  }
+#endif
+  CountAcquisition(spins, waits);
 }
 
 bool SpinMutex::TryLock() {
-  bool already_locked = false;
-  return locked_.compare_exchange_strong(
-      already_locked, true, std::memory_order_acquire);
+  int32 state = kUnlocked;
+  if (state_.compare_exchange_strong(state, kLocked,
+                                     std::memory_order_acquire)) {
+    CountAcquisition(0U, 0U);
+    return true;
+  }
+  return false;
 }
 
 void SpinMutex::Unlock() {
   DCHECK(IsLocked());
-  locked_.store(false, std::memory_order_release);
+#if ION_PORT_HAS_FUTEX
+  if (state_.exchange(kUnlocked, std::memory_order_release) ==
+      kLockedWithWaiters)
+    port::futex::Wake(&state_, 1);
+#else
+  state_.store(kUnlocked, std::memory_order_release);
+#endif
+}
+
+void SpinMutex::EnableContentionStatistics(bool enable) {
+  s_statistics_enabled = enable;
+}
+
+bool SpinMutex::AreContentionStatisticsEnabled() {
+  return s_statistics_enabled;
+}
+
+const SpinMutex::ContentionStatistics SpinMutex::GetContentionStatistics() {
+  ContentionStatistics stats;
+  stats.acquisition_count = s_acquisition_count;
+  stats.spin_count = s_spin_count;
+  stats.wait_count = s_wait_count;
+  return stats;
+}
+
+void SpinMutex::ResetContentionStatistics() {
+  s_acquisition_count = 0U;
+  s_spin_count = 0U;
+  s_wait_count = 0U;
 }
 
 }  // namespace base
@@ -18,6 +18,7 @@ limitations under the License.
 #ifndef ION_BASE_SPINMUTEX_H_
 #define ION_BASE_SPINMUTEX_H_
 
+#include "base/integral_types.h"
 #include "ion/port/atomic.h"
 
 namespace ion {
@@ -27,7 +28,14 @@ namespace base {
 // locking via a simple atomic CAS.  This gives it two advantages:
 //   - higher performance (when used in appropriate situations)
 //   - smaller memory footprint
-// The downside is that waiters continue to consume CPU cycles as they wait.
+// The downside is that waiters consume CPU cycles while they spin.
+//
+// A contended Lock() spins with exponential backoff, pausing the CPU for twice
+// as long after each failed attempt, for a bounded number of attempts. If the
+// mutex is still locked after that, its owner has most likely been descheduled,
+// so the waiter stops spinning and waits in the OS: on Linux and Android it
+// sleeps on a futex until the mutex is unlocked, and elsewhere it yields the
+// CPU between attempts.
 //
 // This implementation is extremely simple, and makes no attempt at fairness.
 // Starvation is possible; when the mutex is already locked, there is no
@@ -35,11 +43,24 @@ namespace base {
 // unblocked before subsequent blocking threads.
 class ION_API SpinMutex {
  public:
-  SpinMutex() : locked_(false) {}
+  // Counts of the work done by all SpinMutex instances while contention
+  // statistics are enabled.
+  struct ContentionStatistics {
+    ContentionStatistics()
+        : acquisition_count(0U), spin_count(0U), wait_count(0U) {}
+    // The number of times a mutex was locked.
+    uint64 acquisition_count;
+    // The number of backoff rounds spent spinning on a locked mutex.
+    uint64 spin_count;
+    // The number of times a thread waited in the OS for a locked mutex.
+    uint64 wait_count;
+  };
+
+  SpinMutex() : state_(kUnlocked) {}
   ~SpinMutex();
 
   // Returns whether the Mutex is currently locked. Does not block.
-  bool IsLocked() const { return locked_; }
+  bool IsLocked() const { return state_ != kUnlocked; }
 
   // Locks the Mutex. Blocks the calling thread or process until the lock is
   // available; no thread or process can return from Lock() until the lock owner
@@ -55,8 +76,29 @@ class ION_API SpinMutex {
   // not block.
   void Unlock();
 
+  // Enables or disables counting ContentionStatistics, which is disabled by
+  // default. Counting adds atomic increments of shared counters to each lock,
+  // so it should only be enabled while investigating contention.
+  static void EnableContentionStatistics(bool enable);
+  static bool AreContentionStatisticsEnabled();
+
+  // Returns the statistics counted since they were last reset, or resets them
+  // to zero.
+  static const ContentionStatistics GetContentionStatistics();
+  static void ResetContentionStatistics();
+
  private:
-  std::atomic<bool> locked_;
+  enum State {
+    kUnlocked,
+    kLocked,
+    // Locked, and there may be threads waiting in the OS for the mutex.
+    kLockedWithWaiters
+  };
+
+  // Handles a Lock() that found the mutex already locked.
+  void LockContended();
+
+  std::atomic<int32> state_;
 };
 
 }  // namespace base
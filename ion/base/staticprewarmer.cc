@@ -0,0 +1,45 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/staticprewarmer.h"
+
+namespace ion {
+namespace base {
+
+StaticPrewarmer::StaticPrewarmer(
+    const std::vector<std::function<void()>>& funcs)
+    : funcs_(funcs),
+      done_(false),
+      thread_(new ThreadSpawner(
+          "StaticPrewarmer", std::bind(&StaticPrewarmer::CallFunctions, this))) {
+}
+
+StaticPrewarmer::~StaticPrewarmer() { Wait(); }
+
+void StaticPrewarmer::Wait() {
+  thread_->Join();
+}
+
+bool StaticPrewarmer::CallFunctions() {
+  for (size_t i = 0; i < funcs_.size(); ++i)
+    funcs_[i]();
+  done_ = true;
+  return true;
+}
+
+}  // namespace base
+}  // namespace ion
@@ -0,0 +1,76 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_STATICPREWARMER_H_
+#define ION_BASE_STATICPREWARMER_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "base/macros.h"
+#include "ion/base/threadspawner.h"
+#include "ion/port/atomic.h"
+
+namespace ion {
+namespace base {
+
+// A StaticPrewarmer constructs singletons ahead of time on a background
+// thread, so that the cost of constructing them does not land on the thread
+// that first needs them, such as during startup before the first frame. Each
+// function passed to it should call a function that returns a static declared
+// with the ION_DECLARE_SAFE_STATIC_* macros or a C++11 function-local static,
+// for example:
+//
+//   StaticPrewarmer prewarmer({
+//       []() { gfx::ShaderInputRegistry::GetGlobalRegistry(); },
+//       []() { profile::GetCallTraceManager(); } });
+//   ...  // Other startup work.
+//   prewarmer.Wait();  // Optional; the destructor also waits.
+//
+// Those statics are safe to construct concurrently, so a thread that needs one
+// before the prewarmer gets to it simply constructs it itself. Use
+// profile::RecordStaticInitializations() to find the statics worth prewarming.
+class ION_API StaticPrewarmer {
+ public:
+  // Starts calling |funcs| in order on a background thread.
+  explicit StaticPrewarmer(const std::vector<std::function<void()>>& funcs);
+
+  // Waits for all functions to return.
+  ~StaticPrewarmer();
+
+  // Returns whether all functions have returned.
+  bool IsDone() const { return done_; }
+
+  // Blocks until all functions have returned.
+  void Wait();
+
+ private:
+  // The background thread's function.
+  bool CallFunctions();
+
+  const std::vector<std::function<void()>> funcs_;
+  std::atomic<bool> done_;
+  std::unique_ptr<ThreadSpawner> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(StaticPrewarmer);
+};
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_STATICPREWARMER_H_
@@ -39,7 +39,7 @@ StaticDeleterDeleter::~StaticDeleterDeleter() {
 }
 
 void StaticDeleterDeleter::SetInstancePtr(
-  const std::string&, StaticDeleterDeleter* instance) {
+  const std::string&, StaticDeleterDeleter* instance, uint64_t) {
   // This static will be destroyed at exit, and will trigger deleting the held
   // StaticDeleters.
   // We need this in a separate function because static local initialization is
@@ -58,6 +58,17 @@ StaticDeleterDeleter* StaticDeleterDeleter::GetInstance() {
   return singleton_ptr;
 }
 
+const std::vector<std::pair<std::string, uint64_t>>
+StaticDeleterDeleter::GetConstructionTimes() {
+  LockGuard locker(&mutex_);
+  std::vector<std::pair<std::string, uint64_t>> times;
+  times.reserve(deleters_.size());
+  for (size_t i = 0; i < deleters_.size(); ++i)
+    times.push_back(std::make_pair(deleters_[i]->GetTypeName(),
+                                   deleters_[i]->GetConstructionTimeUs()));
+  return times;
+}
+
 void StaticDeleterDeleter::DestroyInstance() {
   SetInstancePtr("StaticDeleterDeleter", NULL);
 }
@@ -20,7 +20,9 @@ limitations under the License.
 
 #include <stdint.h>
 
+#include <chrono>  // NOLINT
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "ion/base/lockguards.h"
@@ -29,6 +31,7 @@ limitations under the License.
 #include "ion/base/static_assert.h"
 #include "ion/port/atomic.h"
 #include "ion/port/mutex.h"
+#include "ion/port/timer.h"
 
 // Use the below ION_DECLARE_STATIC_* macros to safely initialize a local static
 // pointer variable with 4- or 8-byte size. These macros will not work for
@@ -64,16 +67,22 @@ limitations under the License.
 // destroyed as the program exits it cleans up any pointers that were added to
 // it in the reverse order they were created. This ensures proper dependency
 // handling.
+//
+// The deleters also record how long each constructor took, so that the
+// StaticDeleterDeleter holds an inventory of the statics that have been
+// constructed, in order (see ion::profile::RecordStaticInitializations()). To
+// move that cost off a critical path, the functions that return the statics
+// can be called ahead of time on another thread with a StaticPrewarmer.
 
 // Uses AtomicCompareAndSwap to uniquely set the value of variable with
 // new_variable. If the swap fails then destroys new_variable.
-#define ION_SAFE_ASSIGN_STATIC_POINTER(                          \
-    type, variable, new_variable, add_func, destroyer) \
-  type null = NULL;                                              \
-  if (variable.compare_exchange_strong(null, new_variable)) {    \
-    add_func(#type, new_variable);                               \
-  } else {                                                       \
-    destroyer new_variable;                                      \
+#define ION_SAFE_ASSIGN_STATIC_POINTER(                                  \
+    type, variable, new_variable, add_func, destroyer, construction_us)  \
+  type null = NULL;                                                      \
+  if (variable.compare_exchange_strong(null, new_variable)) {            \
+    add_func(#type, new_variable, construction_us);                      \
+  } else {                                                               \
+    destroyer new_variable;                                              \
   }
 
 // Declares and thread-safely assigns the value of a static variable.
@@ -84,9 +93,13 @@ limitations under the License.
                     "static variables must be of pointer type");         \
   type variable = atomic_##variable.load(std::memory_order_acquire);     \
   if (variable == 0) {                                                   \
+    const ion::port::Timer::steady_clock::time_point start_##variable =  \
+        ion::port::Timer::steady_clock::now();                           \
     type new_##variable = constructor;                                   \
     ION_SAFE_ASSIGN_STATIC_POINTER(                                      \
-        type, atomic_##variable, new_##variable, add_func, destroyer);   \
+        type, atomic_##variable, new_##variable, add_func, destroyer,    \
+        ion::base::StaticDeleterBase::GetMicrosecondsSince(              \
+            start_##variable));                                          \
     variable = atomic_##variable.load(std::memory_order_acquire);        \
   }
 
@@ -131,14 +144,28 @@ namespace base {
 
 class StaticDeleterBase {
  public:
-  explicit StaticDeleterBase(const std::string& name) : type_name_(name) {}
+  StaticDeleterBase(const std::string& name, uint64_t construction_us)
+      : type_name_(name), construction_us_(construction_us) {}
   virtual ~StaticDeleterBase() {}
 
   // Returns the name of the type this deleter deletes.
   const std::string& GetTypeName() const { return type_name_; }
 
+  // Returns the time the constructor of the static took in microseconds,
+  // including any statics it constructed.
+  uint64_t GetConstructionTimeUs() const { return construction_us_; }
+
+  // Returns the number of microseconds elapsed since |start|.
+  static uint64_t GetMicrosecondsSince(
+      const port::Timer::steady_clock::time_point& start) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            port::Timer::steady_clock::now() - start).count());
+  }
+
  protected:
   std::string type_name_;
+  uint64_t construction_us_;
 };
 
 // This class should not be used directly. Only use it through one of the above
@@ -148,8 +175,9 @@ class StaticDeleterBase {
 // to be deleted at shutdown.
 template <typename T> class StaticDeleter : public StaticDeleterBase {
  public:
-  StaticDeleter(const std::string& name, T* pointer_to_delete)
-      : StaticDeleterBase(name),
+  StaticDeleter(const std::string& name, T* pointer_to_delete,
+                uint64_t construction_us)
+      : StaticDeleterBase(name, construction_us),
         pointer_to_delete_(pointer_to_delete) {}
 
  private:
@@ -166,8 +194,9 @@ template <typename T> class StaticDeleter : public StaticDeleterBase {
 // Specialization for arrays.
 template <typename T> class StaticDeleter<T[]> : public StaticDeleterBase {
  public:
-  StaticDeleter(const std::string& name, T* pointer_to_delete)
-      : StaticDeleterBase(name),
+  StaticDeleter(const std::string& name, T* pointer_to_delete,
+                uint64_t construction_us)
+      : StaticDeleterBase(name, construction_us),
         pointer_to_delete_(pointer_to_delete) {}
 
  private:
@@ -193,27 +222,31 @@ class ION_API StaticDeleterDeleter : public Shareable {
   ~StaticDeleterDeleter() override;
 
   // Adds a regular pointer to be deleted when this class is destroyed.
+  // |construction_us| is the time its constructor took.
   template <typename T>
-  void AddPointerToDelete(const std::string& name, T* ptr) {
+  void AddPointerToDelete(const std::string& name, T* ptr,
+                          uint64_t construction_us = 0U) {
     LockGuard locker(&mutex_);
-    deleters_.push_back(new StaticDeleter<T>(name, ptr));
+    deleters_.push_back(new StaticDeleter<T>(name, ptr, construction_us));
   }
   // Adds an array pointer to be deleted when this class is destroyed.
   template <typename T>
-  void AddArrayToDelete(const std::string& name, T* ptr) {
+  void AddArrayToDelete(const std::string& name, T* ptr,
+                        uint64_t construction_us = 0U) {
     LockGuard locker(&mutex_);
-    deleters_.push_back(new StaticDeleter<T[]>(name, ptr));
+    deleters_.push_back(new StaticDeleter<T[]>(name, ptr, construction_us));
   }
   // Does nothing, but simplifies the above macros for static non-pointer
   // instances.
   template <typename T>
-  void IgnoreInstance(const std::string& name, const T& ptr) {}
+  void IgnoreInstance(const std::string& name, const T& ptr,
+                      uint64_t construction_us = 0U) {}
 
   // Returns a pointer to the global instance.
   static StaticDeleterDeleter* GetInstance();
 
   // Returns the deleter at the passed index. Returns NULL if the index is
-  // invalid.
+  // invalid. Deleters are in the order their statics were constructed.
   const StaticDeleterBase* GetDeleterAt(size_t index) const {
     return index < deleters_.size() ? deleters_[index] : NULL;
   }
@@ -221,6 +254,11 @@ class ION_API StaticDeleterDeleter : public Shareable {
   // Returns the number of deleters in this.
   size_t GetDeleterCount() const { return deleters_.size(); }
 
+  // Returns the type name and construction time of each static constructed so
+  // far, in construction order. Unlike GetDeleterAt(), this may be called
+  // while other threads construct statics.
+  const std::vector<std::pair<std::string, uint64_t>> GetConstructionTimes();
+
   // Call this function once, and only once, at the end of a program, to
   // explicitly destroy all StaticDeleters (including the StaticDeleterDeleter
   // instance). Any attempt to access pointers declared with the macros in this
@@ -235,7 +273,8 @@ class ION_API StaticDeleterDeleter : public Shareable {
   // Must only be called from GetInstance(). The string parameter is
   // ignored but needed for consistency with AddPointerToDelete.
   static void SetInstancePtr(const std::string&,
-                             StaticDeleterDeleter* instance);
+                             StaticDeleterDeleter* instance,
+                             uint64_t construction_us = 0U);
 
   std::vector<StaticDeleterBase*> deleters_;
 
@@ -0,0 +1,245 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/taskscheduler.h"
+
+#include <algorithm>
+
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/base/serialize.h"
+#include "ion/port/threadutils.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// The number of ranges per thread ParallelFor() aims for when picking a grain
+// size, so that threads that finish early can steal some.
+static const size_t kRangesPerThread = 4U;
+
+}  // anonymous namespace
+
+const size_t TaskScheduler::kInvalidIndex;
+
+//-----------------------------------------------------------------------------
+//
+// TaskScheduler::TaskGroup.
+//
+//-----------------------------------------------------------------------------
+
+TaskScheduler::TaskGroup::TaskGroup() : pending_count_(0U) {}
+
+TaskScheduler::TaskGroup::~TaskGroup() {
+  DCHECK(IsDone()) << "TaskGroup destroyed with pending tasks";
+}
+
+bool TaskScheduler::TaskGroup::IsDone() const {
+  LockGuard lock(&mutex_);
+  return pending_count_ == 0U;
+}
+
+//-----------------------------------------------------------------------------
+//
+// TaskScheduler.
+//
+//-----------------------------------------------------------------------------
+
+TaskScheduler::TaskScheduler(const std::string& name, size_t thread_count)
+    : name_(name),
+      deques_(GetNonNullAllocator()),
+      threads_(GetNonNullAllocator()),
+      next_deque_(0U),
+      stopping_(false) {
+  const size_t deque_count = std::max(thread_count, static_cast<size_t>(1U));
+  for (size_t i = 0; i < deque_count; ++i)
+    deques_.push_back(std::unique_ptr<TaskDeque>(
+        new TaskDeque(GetNonNullAllocator())));
+  // Spawn the threads only once all deques exist, since they may steal from
+  // any of them.
+  for (size_t i = 0; i < thread_count; ++i) {
+    threads_.push_back(std::unique_ptr<ThreadSpawner>(new ThreadSpawner(
+        thread_count == 1U ? name : name + " " + ValueToString(i),
+        std::bind(&TaskScheduler::ThreadLoop, this, i))));
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  stopping_ = true;
+  for (size_t i = 0; i < threads_.size(); ++i)
+    work_sema_.Post();
+  threads_.clear();
+  // Run whatever is left if there were no threads to do so.
+  Entry entry;
+  while (FindTask(&entry))
+    Run(entry);
+}
+
+void TaskScheduler::Submit(const Task& task, TaskGroup* group) {
+  DCHECK(task);
+  if (group) {
+    LockGuard lock(&group->mutex_);
+    ++group->pending_count_;
+  }
+  Entry entry;
+  entry.task = task;
+  entry.group = group;
+  Push(entry);
+}
+
+void TaskScheduler::SubmitAfter(TaskGroup* dependency, const Task& task,
+                                TaskGroup* group) {
+  DCHECK(dependency);
+  DCHECK_NE(dependency, group);
+  if (group) {
+    LockGuard lock(&group->mutex_);
+    ++group->pending_count_;
+  }
+  Entry entry;
+  entry.task = task;
+  entry.group = group;
+  {
+    LockGuard lock(&dependency->mutex_);
+    if (dependency->pending_count_ != 0U) {
+      TaskGroup::Continuation continuation;
+      continuation.task = task;
+      continuation.group = group;
+      dependency->continuations_.push_back(continuation);
+      return;
+    }
+  }
+  Push(entry);
+}
+
+void TaskScheduler::Wait(TaskGroup* group) {
+  DCHECK(group);
+  while (!group->IsDone()) {
+    Entry entry;
+    if (FindTask(&entry))
+      Run(entry);
+    else
+      port::YieldThread();
+  }
+}
+
+void TaskScheduler::ParallelFor(size_t begin, size_t end, size_t grain_size,
+                                const RangeFunction& func) {
+  if (begin >= end)
+    return;
+  const size_t count = end - begin;
+  if (grain_size == 0U) {
+    const size_t range_count =
+        std::max(threads_.size(), static_cast<size_t>(1U)) * kRangesPerThread;
+    grain_size = std::max((count + range_count - 1U) / range_count,
+                          static_cast<size_t>(1U));
+  }
+  // Run a single range directly rather than through a deque.
+  if (count <= grain_size) {
+    func(begin, end);
+    return;
+  }
+  TaskGroup group;
+  for (size_t start = begin; start < end; start += grain_size) {
+    const size_t stop = std::min(end, start + grain_size);
+    Submit([&func, start, stop]() { func(start, stop); }, &group);
+  }
+  Wait(&group);
+}
+
+void TaskScheduler::Push(const Entry& entry) {
+  // Workers push onto their own deque; other threads spread their tasks.
+  size_t index = thread_index_.Get()->index;
+  if (index == kInvalidIndex)
+    index = next_deque_++ % deques_.size();
+  {
+    TaskDeque* deque = deques_[index].get();
+    LockGuard lock(&deque->mutex);
+    deque->entries.push_back(entry);
+  }
+  work_sema_.Post();
+}
+
+bool TaskScheduler::FindTask(Entry* entry) {
+  const size_t count = deques_.size();
+  const size_t own = thread_index_.Get()->index;
+  // A worker runs its newest task first, since its data is likely to still be
+  // in the cache.
+  if (own != kInvalidIndex) {
+    TaskDeque* deque = deques_[own].get();
+    LockGuard lock(&deque->mutex);
+    if (!deque->entries.empty()) {
+      *entry = deque->entries.back();
+      deque->entries.pop_back();
+      return true;
+    }
+  }
+  // Steal the oldest task of another deque, starting after our own so that
+  // thieves do not all contend on the first deque.
+  const size_t start = own == kInvalidIndex ? 0U : own + 1U;
+  for (size_t i = 0; i < count; ++i) {
+    TaskDeque* deque = deques_[(start + i) % count].get();
+    LockGuard lock(&deque->mutex);
+    if (!deque->entries.empty()) {
+      *entry = deque->entries.front();
+      deque->entries.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void TaskScheduler::Run(const Entry& entry) {
+  entry.task();
+  if (entry.group)
+    Finish(entry.group);
+}
+
+void TaskScheduler::Finish(TaskGroup* group) {
+  std::vector<TaskGroup::Continuation> continuations;
+  {
+    LockGuard lock(&group->mutex_);
+    DCHECK_GT(group->pending_count_, 0U);
+    if (--group->pending_count_ == 0U)
+      continuations.swap(group->continuations_);
+  }
+  // The group may be destroyed as soon as the lock is released, so only the
+  // local copy of its continuations is used from here on.
+  for (size_t i = 0; i < continuations.size(); ++i) {
+    Entry entry;
+    entry.task = continuations[i].task;
+    entry.group = continuations[i].group;
+    Push(entry);
+  }
+}
+
+bool TaskScheduler::ThreadLoop(size_t index) {
+  thread_index_.Get()->index = index;
+  while (true) {
+    // Run tasks until none are left, then wait for more.
+    Entry entry;
+    while (FindTask(&entry))
+      Run(entry);
+    if (stopping_)
+      break;
+    work_sema_.Wait();
+  }
+  return true;
+}
+
+}  // namespace base
+}  // namespace ion
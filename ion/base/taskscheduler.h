@@ -0,0 +1,167 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_TASKSCHEDULER_H_
+#define ION_BASE_TASKSCHEDULER_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/macros.h"
+#include "ion/base/allocatable.h"
+#include "ion/base/stlalloc/allocdeque.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/threadlocalobject.h"
+#include "ion/base/threadspawner.h"
+#include "ion/port/mutex.h"
+#include "ion/port/semaphore.h"
+
+namespace ion {
+namespace base {
+
+// TaskScheduler runs tasks on a fixed set of worker threads. Each thread has
+// its own deque of tasks: tasks submitted by a worker are pushed onto and
+// popped from the back of its own deque, so that related work stays on one
+// thread, while idle workers steal tasks from the front of the other deques.
+//
+// Tasks can be collected in a TaskGroup, which can be waited on and which
+// other tasks can depend on. A thread that waits on a group runs pending tasks
+// until the group is done, so waiting from inside a task never deadlocks, and
+// a scheduler with no threads runs everything in Wait(). For example:
+//
+//   TaskScheduler scheduler("loader", 4U);
+//   TaskScheduler::TaskGroup decode;
+//   for (size_t i = 0; i < images.size(); ++i)
+//     scheduler.Submit([&images, i]() { Decode(&images[i]); }, &decode);
+//   TaskScheduler::TaskGroup upload;
+//   scheduler.SubmitAfter(&decode, [&images]() { Upload(images); }, &upload);
+//   scheduler.Wait(&upload);
+class ION_API TaskScheduler : public Allocatable {
+ public:
+  typedef std::function<void()> Task;
+  // A function that handles the index range [begin, end).
+  typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+  // A set of submitted tasks. A TaskGroup must not be destroyed while any of
+  // its tasks is pending, which Wait() guarantees.
+  class ION_API TaskGroup {
+   public:
+    TaskGroup();
+    ~TaskGroup();
+
+    // Returns whether all tasks added to the group have finished.
+    bool IsDone() const;
+
+   private:
+    // A task to submit once the group is done.
+    struct Continuation {
+      Task task;
+      TaskGroup* group;
+    };
+
+    mutable port::Mutex mutex_;
+    size_t pending_count_;
+    std::vector<Continuation> continuations_;
+
+    friend class TaskScheduler;
+    DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+  };
+
+  // Creates a scheduler with thread_count worker threads. Threads are named
+  // after name if thread naming is supported.
+  TaskScheduler(const std::string& name, size_t thread_count);
+  // The destructor runs any pending tasks and then joins the threads.
+  ~TaskScheduler() override;
+
+  // Returns the name passed to the constructor.
+  const std::string& GetName() const { return name_; }
+  // Returns the number of worker threads.
+  size_t GetThreadCount() const { return threads_.size(); }
+
+  // Schedules task to run on some thread. If group is non-NULL the task is
+  // added to it.
+  void Submit(const Task& task, TaskGroup* group);
+  // Schedules task to run once all tasks in dependency are done, which may be
+  // immediately. If group is non-NULL the task is added to it right away, so
+  // waiting on group also waits for dependency.
+  void SubmitAfter(TaskGroup* dependency, const Task& task, TaskGroup* group);
+  // Runs pending tasks on the calling thread until all tasks in group are
+  // done.
+  void Wait(TaskGroup* group);
+
+  // Splits [begin, end) into ranges of at most grain_size indices, calls func
+  // for each of them in parallel, and waits for all of them to finish. A
+  // grain_size of 0 picks one that gives each thread a few ranges.
+  void ParallelFor(size_t begin, size_t end, size_t grain_size,
+                   const RangeFunction& func);
+
+ private:
+  struct Entry {
+    Task task;
+    TaskGroup* group;
+  };
+
+  // A deque of tasks owned by one thread.
+  struct TaskDeque {
+    explicit TaskDeque(const AllocatorPtr& allocator) : entries(allocator) {}
+    port::Mutex mutex;
+    AllocDeque<Entry> entries;
+  };
+
+  // The index of the worker thread that is running, if any.
+  struct ThreadIndex {
+    ThreadIndex() : index(kInvalidIndex) {}
+    size_t index;
+  };
+
+  static const size_t kInvalidIndex = static_cast<size_t>(-1);
+
+  // Adds the task to a deque and wakes up a thread, without touching groups.
+  void Push(const Entry& entry);
+  // Pops a task from the calling thread's deque, or steals one from another
+  // deque. Returns false if there are no tasks.
+  bool FindTask(Entry* entry);
+  // Runs the entry's task and marks it done in its group.
+  void Run(const Entry& entry);
+  // Marks one task of group as done, submitting the group's continuations if
+  // it was the last one.
+  void Finish(TaskGroup* group);
+  // The loop run by each worker thread.
+  bool ThreadLoop(size_t index);
+
+  const std::string name_;
+  // There is one deque per thread, or a single deque if there are no threads.
+  // Tasks submitted by other threads are spread over the deques.
+  AllocVector<std::unique_ptr<TaskDeque> > deques_;
+  AllocVector<std::unique_ptr<ThreadSpawner> > threads_;
+  ThreadLocalObject<ThreadIndex> thread_index_;
+  // Posted once per pushed task.
+  port::Semaphore work_sema_;
+  // Picks the deque for tasks submitted by non-worker threads.
+  std::atomic<size_t> next_deque_;
+  std::atomic<bool> stopping_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskScheduler);
+};
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_TASKSCHEDULER_H_
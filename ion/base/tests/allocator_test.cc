@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/base/allocator.h"
 
+#include <cstring>
+
 #include "ion/base/allocationmanager.h"
 #include "ion/base/logchecker.h"
 #include "ion/base/tests/testallocator.h"
@@ -108,3 +110,35 @@ TEST(Allocator, Tracker) {
   al->SetTracker(ion::base::AllocationTrackerPtr());
   EXPECT_TRUE(al->GetTracker().Get() == NULL);
 }
+
+TEST(Allocator, AlignedMemory) {
+  using ion::base::testing::TestAllocator;
+  using ion::base::testing::TestAllocatorPtr;
+
+  TestAllocatorPtr al(new TestAllocator);
+  ion::base::AllocationTrackerPtr tr(new ion::base::FullAllocationTracker);
+  al->SetTracker(tr);
+  for (size_t alignment = 1U; alignment <= 4096U; alignment *= 2U) {
+    SCOPED_TRACE(::testing::Message() << "Alignment " << alignment);
+    void* p = al->AllocateAlignedMemory(100U, alignment);
+    ASSERT_TRUE(p != NULL);
+    EXPECT_EQ(0U, reinterpret_cast<size_t>(p) % alignment);
+    // The whole block must be usable.
+    memset(p, 0xff, 100U);
+    EXPECT_EQ(1U, tr->GetActiveAllocationCount());
+    EXPECT_EQ(100U, tr->GetActiveAllocationBytesCount());
+    al->DeallocateAlignedMemory(p);
+    EXPECT_EQ(0U, tr->GetActiveAllocationCount());
+  }
+  EXPECT_EQ(al->GetNumAllocated(), al->GetNumDeallocated());
+  al->SetTracker(ion::base::AllocationTrackerPtr());
+
+  // A block spanning huge pages is still aligned.
+  static const size_t kLargeSize = 8U * 1024U * 1024U;
+  static const size_t kAlignment = ion::base::Allocator::kCacheLineAlignment;
+  void* p = al->AllocateAlignedMemory(kLargeSize, kAlignment);
+  ASSERT_TRUE(p != NULL);
+  EXPECT_EQ(0U, reinterpret_cast<size_t>(p) % kAlignment);
+  memset(p, 0, kLargeSize);
+  al->DeallocateAlignedMemory(p);
+}
@@ -0,0 +1,147 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/arenaallocator.h"
+
+#include <stdint.h>
+#include <string.h>  // For memset().
+
+#include <functional>
+
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/threadspawner.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// Allocates and deallocates a block from the passed allocator, returning
+// whether it came from the calling thread's arena.
+static bool AllocateFromArena(const ArenaAllocatorPtr& allocator) {
+  const size_t used = allocator->GetArenaBytesUsed();
+  void* p = allocator->AllocateMemory(64U);
+  const bool from_arena = allocator->GetArenaBytesUsed() > used;
+  allocator->DeallocateMemory(p);
+  return from_arena;
+}
+
+}  // anonymous namespace
+
+TEST(ArenaAllocatorTest, AllocateAndRewind) {
+  ArenaAllocatorPtr allocator(new ArenaAllocator(1024U));
+  EXPECT_EQ(1024U, allocator->GetArenaSize());
+  EXPECT_EQ(0U, allocator->GetArenaBytesUsed());
+
+  // Allocations are consecutive and aligned as malloc() would align them.
+  void* p0 = allocator->AllocateMemory(1U);
+  void* p1 = allocator->AllocateMemory(100U);
+  ASSERT_TRUE(p0);
+  ASSERT_TRUE(p1);
+  EXPECT_LT(p0, p1);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(p0) % alignof(long double));
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(p1) % alignof(long double));
+  const size_t used = allocator->GetArenaBytesUsed();
+  EXPECT_GT(used, 101U);
+
+  // Deallocation does not reclaim anything until the frame ends.
+  allocator->DeallocateMemory(p0);
+  allocator->DeallocateMemory(p1);
+  EXPECT_EQ(used, allocator->GetArenaBytesUsed());
+  allocator->EndFrame();
+  EXPECT_EQ(0U, allocator->GetArenaBytesUsed());
+  void* p2 = allocator->AllocateMemory(8U);
+  EXPECT_EQ(p0, p2);
+
+  // An arena holding live memory is not rewound until the memory is
+  // deallocated.
+  allocator->EndFrame();
+  EXPECT_LT(0U, allocator->GetArenaBytesUsed());
+  void* p3 = allocator->AllocateMemory(8U);
+  EXPECT_LT(p2, p3);
+  allocator->DeallocateMemory(p2);
+  EXPECT_LT(0U, allocator->GetArenaBytesUsed());
+  allocator->DeallocateMemory(p3);
+  EXPECT_EQ(0U, allocator->GetArenaBytesUsed());
+  EXPECT_EQ(0U, allocator->GetHeapAllocationCount());
+
+  // Deallocating NULL does nothing.
+  allocator->DeallocateMemory(NULL);
+}
+
+TEST(ArenaAllocatorTest, HeapFallback) {
+  ArenaAllocatorPtr allocator(new ArenaAllocator(256U));
+  // Allocations that do not fit come from the heap.
+  void* big = allocator->AllocateMemory(1024U);
+  ASSERT_TRUE(big);
+  EXPECT_EQ(1U, allocator->GetHeapAllocationCount());
+  EXPECT_EQ(0U, allocator->GetArenaBytesUsed());
+
+  void* small = allocator->AllocateMemory(128U);
+  EXPECT_EQ(1U, allocator->GetHeapAllocationCount());
+  void* overflow = allocator->AllocateMemory(128U);
+  EXPECT_EQ(2U, allocator->GetHeapAllocationCount());
+  memset(big, 0, 1024U);
+  memset(overflow, 0, 128U);
+  allocator->DeallocateMemory(big);
+  allocator->DeallocateMemory(small);
+  allocator->DeallocateMemory(overflow);
+
+  // An arena size of zero sends everything to the heap.
+  ArenaAllocatorPtr heap_allocator(new ArenaAllocator(0U));
+  heap_allocator->DeallocateMemory(heap_allocator->AllocateMemory(8U));
+  EXPECT_EQ(1U, heap_allocator->GetHeapAllocationCount());
+}
+
+TEST(ArenaAllocatorTest, StlContainers) {
+  ArenaAllocatorPtr allocator(new ArenaAllocator);
+  EXPECT_EQ(ArenaAllocator::kDefaultArenaSize, allocator->GetArenaSize());
+  {
+    AllocVector<int> v(allocator);
+    for (int i = 0; i < 1000; ++i)
+      v.push_back(i);
+    EXPECT_EQ(999, v.back());
+    EXPECT_LT(1000U * sizeof(int), allocator->GetArenaBytesUsed());
+  }
+  allocator->EndFrame();
+  EXPECT_EQ(0U, allocator->GetArenaBytesUsed());
+  EXPECT_EQ(0U, allocator->GetHeapAllocationCount());
+}
+
+TEST(ArenaAllocatorTest, ThreadsHaveSeparateArenas) {
+  ArenaAllocatorPtr allocator(new ArenaAllocator(1024U));
+  void* p = allocator->AllocateMemory(64U);
+  const size_t used = allocator->GetArenaBytesUsed();
+  {
+    ThreadSpawner t("arena", std::bind(AllocateFromArena, allocator));
+  }
+  EXPECT_EQ(used, allocator->GetArenaBytesUsed());
+
+  // Memory may be deallocated in another thread.
+  allocator->EndFrame();
+  {
+    ThreadSpawner t("arena", [allocator, p]() {
+      allocator->DeallocateMemory(p);
+      return true;
+    });
+  }
+  EXPECT_EQ(0U, allocator->GetArenaBytesUsed());
+}
+
+}  // namespace base
+}  // namespace ion
@@ -0,0 +1,168 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/asynclogentrywriter.h"
+
+#include <string>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/port/threadutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// Records the messages it is passed and the thread that passed them.
+class RecordingLogEntryWriter : public port::LogEntryWriter {
+ public:
+  RecordingLogEntryWriter() : previous_writer_(GetLogEntryWriter()) {
+    SetLogEntryWriter(this);
+  }
+  ~RecordingLogEntryWriter() override { SetLogEntryWriter(previous_writer_); }
+
+  void Write(port::LogSeverity severity, const std::string& message) override {
+    severities_.push_back(severity);
+    messages_.push_back(message);
+    thread_id_ = port::GetCurrentThreadId();
+  }
+
+  const std::vector<port::LogSeverity>& GetSeverities() const {
+    return severities_;
+  }
+  const std::vector<std::string>& GetMessages() const { return messages_; }
+  port::ThreadId GetThreadId() const { return thread_id_; }
+
+ private:
+  port::LogEntryWriter* previous_writer_;
+  std::vector<port::LogSeverity> severities_;
+  std::vector<std::string> messages_;
+  port::ThreadId thread_id_;
+};
+
+}  // anonymous namespace
+
+TEST(AsyncLogEntryWriter, WritesFromBackgroundThread) {
+  RecordingLogEntryWriter recorder;
+  {
+    AsyncLogEntryWriter writer;
+    EXPECT_EQ(&writer, GetLogEntryWriter());
+
+    writer.Write(port::INFO, "[file.cc:1] First");
+    writer.Write(port::WARNING, "[file.cc:2] Second");
+    // Long messages do not fit in a queue entry.
+    const std::string long_message(1000U, 'x');
+    writer.Write(port::ERROR, long_message);
+    writer.Flush();
+
+    ASSERT_EQ(3U, recorder.GetMessages().size());
+    EXPECT_EQ("[file.cc:1] First", recorder.GetMessages()[0]);
+    EXPECT_EQ("[file.cc:2] Second", recorder.GetMessages()[1]);
+    EXPECT_EQ(long_message, recorder.GetMessages()[2]);
+    EXPECT_EQ(port::INFO, recorder.GetSeverities()[0]);
+    EXPECT_EQ(port::WARNING, recorder.GetSeverities()[1]);
+    EXPECT_EQ(port::ERROR, recorder.GetSeverities()[2]);
+    EXPECT_NE(port::GetCurrentThreadId(), recorder.GetThreadId());
+    EXPECT_EQ(0U, writer.GetDroppedCount());
+
+    // Messages still queued are written when the writer is destroyed.
+    writer.Write(port::INFO, "[file.cc:3] Last");
+  }
+  EXPECT_EQ(&recorder, GetLogEntryWriter());
+  ASSERT_EQ(4U, recorder.GetMessages().size());
+  EXPECT_EQ("[file.cc:3] Last", recorder.GetMessages()[3]);
+}
+
+TEST(AsyncLogEntryWriter, FatalMessagesAreSynchronous) {
+  RecordingLogEntryWriter recorder;
+  AsyncLogEntryWriter writer;
+  writer.Write(port::INFO, "[file.cc:1] Queued");
+  writer.Write(port::FATAL, "[file.cc:2] Fatal");
+  // The fatal message was written on this thread, after the queued one.
+  ASSERT_EQ(2U, recorder.GetMessages().size());
+  EXPECT_EQ("[file.cc:1] Queued", recorder.GetMessages()[0]);
+  EXPECT_EQ("[file.cc:2] Fatal", recorder.GetMessages()[1]);
+  EXPECT_EQ(port::GetCurrentThreadId(), recorder.GetThreadId());
+}
+
+TEST(AsyncLogEntryWriter, RateLimit) {
+  RecordingLogEntryWriter recorder;
+  AsyncLogEntryWriter writer;
+  EXPECT_EQ(0U, writer.GetMaxEntriesPerSecond());
+  writer.SetMaxEntriesPerSecond(2U);
+  EXPECT_EQ(2U, writer.GetMaxEntriesPerSecond());
+
+  // Unless a second boundary passes in between, only two messages from each
+  // site are written.
+  for (int i = 0; i < 5; ++i) {
+    writer.Write(port::INFO, "[file.cc:1] Spam");
+    writer.Write(port::INFO, "[file.cc:200] Other spam");
+  }
+  writer.Flush();
+  EXPECT_GE(6U, writer.GetDroppedCount());
+  size_t written_count = 0;
+  for (size_t i = 0; i < recorder.GetSeverities().size(); ++i) {
+    // Skip the warnings that report dropped messages.
+    if (recorder.GetSeverities()[i] == port::INFO)
+      ++written_count;
+  }
+  EXPECT_EQ(10U, written_count + writer.GetDroppedCount());
+
+  writer.SetMaxEntriesPerSecond(0U);
+  const uint64 dropped_count = writer.GetDroppedCount();
+  for (int i = 0; i < 5; ++i)
+    writer.Write(port::INFO, "[file.cc:1] Spam");
+  writer.Flush();
+  EXPECT_EQ(dropped_count, writer.GetDroppedCount());
+}
+
+TEST(AsyncLogEntryWriter, ReportsDroppedMessages) {
+  RecordingLogEntryWriter recorder;
+  {
+    AsyncLogEntryWriter writer(4U);
+    writer.SetMaxEntriesPerSecond(1U);
+    writer.Write(port::INFO, "[file.cc:1] Spam");
+    writer.Write(port::INFO, "[file.cc:1] Spam");
+  }
+  ASSERT_LE(1U, recorder.GetMessages().size());
+  EXPECT_EQ("[file.cc:1] Spam", recorder.GetMessages()[0]);
+  // Unless a second boundary passed, the second message was dropped and
+  // reported.
+  if (recorder.GetMessages().size() == 2U) {
+    EXPECT_EQ(port::WARNING, recorder.GetSeverities()[1]);
+    EXPECT_NE(std::string::npos,
+              recorder.GetMessages()[1].find("Dropped 1 log messages"));
+  }
+}
+
+#if !ION_PRODUCTION
+TEST(AsyncLogEntryWriter, CapturesLogMacros) {
+  LogChecker log_checker;
+  {
+    AsyncLogEntryWriter writer;
+    LOG(WARNING) << "Logged asynchronously";
+    writer.Flush();
+  }
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Logged asynchronously"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+#endif
+
+}  // namespace base
+}  // namespace ion
@@ -28,7 +28,9 @@
         'allocatable_test.cc',
         'allocationmanager_test.cc',
         'allocator_test.cc',
+        'arenaallocator_test.cc',
         'array2_test.cc',
+        'asynclogentrywriter_test.cc',
         'calllist_test.cc',
         'circularbuffer_test.cc',
         'datacontainer_test.cc',
@@ -44,19 +46,24 @@
         'logchecker_test.cc',
         'logging_test.cc',
         'memoryzipstream_test.cc',
+        'mpscqueue_test.cc',
         'notifier_test.cc',
         'nulllogentrywriter_test.cc',
         'once_test.cc',
+        'poolallocator_test.cc',
         'readwritelock_test.cc',
+        'samplingallocationtracker_test.cc',
         'scopedallocation_test.cc',
         'serialize_test.cc',
         'setting_test.cc',
         'settingmanager_test.cc',
         'sharedptr_test.cc',
         'spinmutex_test.cc',
+        'staticprewarmer_test.cc',
         'staticsafedeclare_test.cc',
         'stlallocator_test.cc',
         'stringutils_test.cc',
+        'taskscheduler_test.cc',
         'threadlocalobject_test.cc',
         'threadspawner_test.cc',
         'type_structs_test.cc',
@@ -67,12 +74,17 @@
         'weakreferent_test.cc',
         'workerpool_test.cc',
         'zipassetmanager_test.cc',
+        'zipstream_test.cc',
       ],
       'conditions': [
         # Threads don't exist in asmjs, so remove those tests.
         ['OS == "asmjs"', {
           'sources!': [
+            'asynclogentrywriter_test.cc',
+            'mpscqueue_test.cc',
             'readwritelock_test.cc',
+            'staticprewarmer_test.cc',
+            'taskscheduler_test.cc',
             'threadlocalobject_test.cc',
             'threadspawner_test.cc',
             'workerpool_test.cc',
@@ -88,5 +88,21 @@ TEST(CircularBuffer, Filled2) {
   EXPECT_EQ(6, buffer.GetItem(4));
 }
 
+TEST(CircularBuffer, Clear) {
+  CircularBuffer<int> buffer(3, ion::base::AllocatorPtr(), false);
+  buffer.AddItem(1);
+  buffer.AddItem(2);
+  buffer.AddItem(3);
+  buffer.AddItem(4);
+  buffer.Clear();
+  EXPECT_EQ(0U, buffer.GetSize());
+
+  buffer.AddItem(5);
+  buffer.AddItem(6);
+  EXPECT_EQ(2U, buffer.GetSize());
+  EXPECT_EQ(5, buffer.GetItem(0));
+  EXPECT_EQ(6, buffer.GetItem(1));
+}
+
 }  // namespace base
 }  // namespace ion
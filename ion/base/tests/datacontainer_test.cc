@@ -21,6 +21,8 @@ limitations under the License.
 
 #include "ion/base/logchecker.h"
 #include "ion/base/tests/testallocator.h"
+#include "ion/port/fileutils.h"
+#include "ion/port/memorymappedfile.h"
 #include "ion/port/nullptr.h"  // For kNullFunction.
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
@@ -305,6 +307,35 @@ TEST(DataContainerTest, CreateOverAllocated) {
   EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
+TEST(DataContainerTest, Alignment) {
+  base::LogChecker log_checker;
+  static const size_t kAlignments[] = {
+      16U, base::Allocator::kCacheLineAlignment, 4096U };
+  for (size_t i = 0; i < ARRAYSIZE(kAlignments); ++i) {
+    const size_t alignment = kAlignments[i];
+    SCOPED_TRACE(::testing::Message() << "Alignment " << alignment);
+    TestAllocatorPtr allocator(new TestAllocator);
+    Data* data = InitData();
+    {
+      DataContainerPtr container(DataContainer::CreateAndCopy<Data>(
+          data, kDataCount, true, allocator, alignment));
+      EXPECT_EQ(0U, reinterpret_cast<size_t>(container->GetData()) % alignment);
+      CheckData(data, container->GetData<Data>());
+      container->WipeData();
+      EXPECT_TRUE(container->GetData() == NULL);
+
+      container = DataContainer::CreateOverAllocated<Data>(
+          kDataCount, data, allocator, alignment);
+      EXPECT_EQ(0U, reinterpret_cast<size_t>(container->GetData()) % alignment);
+      CheckData(data, container->GetData<Data>());
+    }
+    delete[] data;
+    // The TestAllocator checks that every allocation was matched.
+    EXPECT_EQ(allocator->GetNumAllocated(), allocator->GetNumDeallocated());
+  }
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
 TEST(DataContainerTest, DefaultDestructors) {
   // These tests are primarily to improve code coverage.
   s_num_destroys = 0;
@@ -397,5 +428,118 @@ TEST(DataContainerTest, Notifications) {
   EXPECT_EQ(3U, n->GetNotificationCount());
 }
 
+TEST(DataContainerTest, CreateFromMappedFile) {
+  base::LogChecker log_checker;
+  const std::string filename = port::GetTemporaryFilename();
+  ASSERT_FALSE(filename.empty());
+  const std::string contents("0123456789abcdef");
+  FILE* fp = port::OpenFile(filename, "wb");
+  ASSERT_TRUE(fp);
+  fwrite(contents.c_str(), 1U, contents.length(), fp);
+  fclose(fp);
+
+  DataContainer::MappedFilePtr file(new port::MemoryMappedFile(filename));
+  ASSERT_TRUE(file->GetData());
+
+  // Containers point into the mapping without copying and share it.
+  DataContainerPtr container = DataContainer::CreateFromMappedFile(
+      file, 4U, 8U, true, AllocatorPtr());
+  ASSERT_TRUE(container.Get());
+  DataContainerPtr container2 = DataContainer::CreateFromMappedFile(
+      file, 0U, contents.length(), false, AllocatorPtr());
+  ASSERT_TRUE(container2.Get());
+  EXPECT_EQ(static_cast<const uint8*>(file->GetData()) + 4U,
+            container->GetData<uint8>());
+  EXPECT_EQ(0, memcmp("456789ab", container->GetData(), 8U));
+  EXPECT_EQ(3, file.use_count());
+  EXPECT_TRUE(container->IsReadOnly());
+  EXPECT_TRUE(container->IsWipeable());
+  EXPECT_FALSE(container2->IsWipeable());
+
+  // Mapped data cannot be modified.
+  EXPECT_TRUE(container->GetMutableData<uint8>() == NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "read-only"));
+
+  // Wiping or destroying a container releases its reference to the mapping.
+  container->WipeData();
+  EXPECT_TRUE(container->GetData() == NULL);
+  EXPECT_EQ(2, file.use_count());
+  container2->WipeData();
+  EXPECT_TRUE(container2->GetData() != NULL);
+  container2.Reset();
+  EXPECT_EQ(1, file.use_count());
+
+  // Ranges outside the file and unmapped files are rejected.
+  EXPECT_FALSE(DataContainer::CreateFromMappedFile(
+      file, 8U, 9U, false, AllocatorPtr()).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "offset 8"));
+  EXPECT_FALSE(DataContainer::CreateFromMappedFile(
+      file, 17U, 0U, false, AllocatorPtr()).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "offset 17"));
+  EXPECT_FALSE(DataContainer::CreateFromMappedFile(
+      DataContainer::MappedFilePtr(), 0U, 0U, false, AllocatorPtr()).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "unmapped file"));
+
+  file.reset();
+  EXPECT_TRUE(port::RemoveFile(filename));
+}
+
+TEST(DataContainerTest, ReloadData) {
+  base::LogChecker log_checker;
+  const std::string contents("0123456789abcdef");
+  DataContainerPtr container = DataContainer::CreateAndCopy<char>(
+      contents.c_str(), contents.length(), true, AllocatorPtr());
+  EXPECT_TRUE(container->ReloadData());
+
+  // Without a reloader wiped data is gone.
+  container->WipeData();
+  EXPECT_FALSE(container->IsDataAvailable());
+  EXPECT_FALSE(container->ReloadData());
+  EXPECT_TRUE(container->GetData() == NULL);
+
+  int reload_count = 0;
+  container->SetReloader([&reload_count, &contents]() {
+    ++reload_count;
+    return DataContainer::CreateAndCopy<char>(
+        contents.c_str(), contents.length(), false, AllocatorPtr());
+  });
+  EXPECT_TRUE(container->GetReloader());
+  EXPECT_TRUE(container->IsDataAvailable());
+  EXPECT_TRUE(container->GetData() == NULL);
+  EXPECT_TRUE(container->ReloadData());
+  EXPECT_EQ(0, memcmp(contents.c_str(), container->GetData(), 16U));
+  // Data that is present is not reloaded.
+  EXPECT_TRUE(container->ReloadData());
+  EXPECT_EQ(1, reload_count);
+  // Reloaded data is wiped again.
+  container->WipeData();
+  EXPECT_TRUE(container->GetData() == NULL);
+  EXPECT_TRUE(container->ReloadData());
+  EXPECT_EQ(2, reload_count);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // A reloader that fails leaves the data wiped.
+  container->WipeData();
+  container->SetReloader([]() { return DataContainerPtr(); });
+  EXPECT_FALSE(container->ReloadData());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Unable to reload"));
+
+  // Data can be mapped again from a file.
+  const std::string filename = port::GetTemporaryFilename();
+  ASSERT_FALSE(filename.empty());
+  FILE* fp = port::OpenFile(filename, "wb");
+  ASSERT_TRUE(fp);
+  fwrite(contents.c_str(), 1U, contents.length(), fp);
+  fclose(fp);
+  container->SetReloader(DataContainer::MappedFileReloader(filename, 4U, 8U));
+  EXPECT_TRUE(container->ReloadData());
+  EXPECT_EQ(0, memcmp("456789ab", container->GetData(), 8U));
+  EXPECT_TRUE(container->IsReadOnly());
+  container->WipeData();
+  EXPECT_TRUE(port::RemoveFile(filename));
+  EXPECT_FALSE(container->ReloadData());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Unable to reload"));
+}
+
 }  // namespace base
 }  // namespace ion
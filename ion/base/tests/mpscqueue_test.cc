@@ -0,0 +1,122 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/mpscqueue.h"
+
+#include <memory>
+#include <vector>
+
+#include "ion/base/tests/testallocator.h"
+#include "ion/base/threadspawner.h"
+#include "ion/port/threadutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+TEST(MpscQueueTest, PushAndPop) {
+  testing::TestAllocatorPtr allocator(new testing::TestAllocator);
+  {
+    MpscQueue<int> queue(allocator, 3U);
+    // The capacity is rounded up to a power of two.
+    EXPECT_EQ(4U, queue.GetCapacity());
+    EXPECT_EQ(1U, allocator->GetNumAllocated());
+    EXPECT_TRUE(queue.IsEmpty());
+
+    int value = 0;
+    EXPECT_FALSE(queue.TryPop(&value));
+    for (int i = 0; i < 4; ++i)
+      EXPECT_TRUE(queue.TryPush(i));
+    EXPECT_FALSE(queue.IsEmpty());
+    // The queue is full.
+    EXPECT_FALSE(queue.TryPush(4));
+
+    // Values are popped in order, and popping frees slots.
+    EXPECT_TRUE(queue.TryPop(&value));
+    EXPECT_EQ(0, value);
+    EXPECT_TRUE(queue.TryPush(4));
+    for (int i = 1; i <= 4; ++i) {
+      EXPECT_TRUE(queue.TryPop(&value));
+      EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(queue.TryPop(&value));
+    EXPECT_TRUE(queue.IsEmpty());
+    // Pushing never allocates.
+    EXPECT_EQ(1U, allocator->GetNumAllocated());
+  }
+  EXPECT_EQ(1U, allocator->GetNumDeallocated());
+}
+
+TEST(MpscQueueTest, DestroysUnpoppedValues) {
+  std::shared_ptr<int> counted(new int(0));
+  {
+    MpscQueue<std::shared_ptr<int> > queue(AllocatorPtr(), 4U);
+    // Wrap around so that the remaining values do not start at slot 0.
+    std::shared_ptr<int> value;
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(queue.TryPush(counted));
+      EXPECT_TRUE(queue.TryPop(&value));
+    }
+    value.reset();
+    EXPECT_TRUE(queue.TryPush(counted));
+    EXPECT_TRUE(queue.TryPush(counted));
+    EXPECT_EQ(3, counted.use_count());
+  }
+  EXPECT_EQ(1, counted.use_count());
+}
+
+TEST(MpscQueueTest, MultipleProducers) {
+  static const int kProducerCount = 4;
+  static const int kValuesPerProducer = 10000;
+  MpscQueue<int> queue(AllocatorPtr(), 64U);
+
+  std::vector<std::unique_ptr<ThreadSpawner> > producers;
+  for (int p = 0; p < kProducerCount; ++p) {
+    producers.push_back(std::unique_ptr<ThreadSpawner>(new ThreadSpawner(
+        "producer", [&queue, p]() {
+          for (int i = 0; i < kValuesPerProducer; ++i) {
+            while (!queue.TryPush(p * kValuesPerProducer + i))
+              port::YieldThread();
+          }
+          return true;
+        })));
+  }
+
+  // Each producer's values arrive in the order they were pushed.
+  std::vector<int> next(kProducerCount, 0);
+  int popped = 0;
+  while (popped < kProducerCount * kValuesPerProducer) {
+    int value;
+    if (queue.TryPop(&value)) {
+      const int p = value / kValuesPerProducer;
+      ASSERT_LE(0, p);
+      ASSERT_GT(kProducerCount, p);
+      EXPECT_EQ(next[p], value % kValuesPerProducer);
+      next[p] = value % kValuesPerProducer + 1;
+      ++popped;
+    } else {
+      port::YieldThread();
+    }
+  }
+  producers.clear();
+  for (int p = 0; p < kProducerCount; ++p)
+    EXPECT_EQ(kValuesPerProducer, next[p]);
+  EXPECT_TRUE(queue.IsEmpty());
+}
+
+}  // namespace base
+}  // namespace ion
@@ -17,6 +17,13 @@ limitations under the License.
 
 #include "ion/base/notifier.h"
 
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "ion/base/logging.h"
+#include "ion/base/threadspawner.h"
+#include "ion/port/timer.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 namespace ion {
@@ -40,12 +47,37 @@ class MyNotifier : public Notifier {
   using Notifier::GetReceivers;
   using Notifier::Notify;
 
- private:
+ protected:
   ~MyNotifier() override {}
+
+ private:
   size_t notifications_;
 };
 typedef base::ReferentPtr<MyNotifier>::Type MyNotifierPtr;
 
+// A Notifier that counts notifications from any number of threads.
+class CountingNotifier : public Notifier {
+ public:
+  CountingNotifier() : notifications_(0U) {}
+  void OnNotify(const Notifier* notifier) override { ++notifications_; }
+  size_t GetNotificationCount() const { return notifications_; }
+
+  using Notifier::Notify;
+
+ private:
+  ~CountingNotifier() override {}
+  std::atomic<size_t> notifications_;
+};
+typedef base::ReferentPtr<CountingNotifier>::Type CountingNotifierPtr;
+
+// Calls Notify() on the passed notifier the passed number of times.
+static bool NotifyRepeatedly(const CountingNotifierPtr& notifier,
+                             int iterations) {
+  for (int i = 0; i < iterations; ++i)
+    notifier->Notify();
+  return true;
+}
+
 }  // anonymous namespace
 
 TEST(Notifier, AddRemoveReceivers) {
@@ -144,5 +176,126 @@ TEST(Notifier, NotifiersCalled) {
   EXPECT_EQ(2U, n2->GetNotificationCount());
 }
 
+// A Notifier that passes on each notification it receives.
+class RelayNotifier : public MyNotifier {
+ public:
+  void OnNotify(const Notifier* notifier) override {
+    MyNotifier::OnNotify(notifier);
+    Notify();
+  }
+
+ private:
+  ~RelayNotifier() override {}
+};
+
+TEST(Notifier, ScopedNotificationBatch) {
+  MyNotifierPtr n(new MyNotifier);
+  MyNotifierPtr n2(new MyNotifier);
+  MyNotifierPtr receiver(new MyNotifier);
+  n->AddReceiver(receiver.Get());
+  n2->AddReceiver(receiver.Get());
+  EXPECT_FALSE(ScopedNotificationBatch::IsBatching());
+  {
+    ScopedNotificationBatch batch;
+    EXPECT_TRUE(ScopedNotificationBatch::IsBatching());
+    for (int i = 0; i < 10; ++i) {
+      n->Notify();
+      n2->Notify();
+    }
+    {
+      // Nested batches are delivered with the outermost one.
+      ScopedNotificationBatch inner_batch;
+      n->Notify();
+    }
+    EXPECT_EQ(0U, receiver->GetNotificationCount());
+  }
+  // Each Notifier notified its receivers once.
+  EXPECT_FALSE(ScopedNotificationBatch::IsBatching());
+  EXPECT_EQ(2U, receiver->GetNotificationCount());
+  n->Notify();
+  EXPECT_EQ(3U, receiver->GetNotificationCount());
+
+  // Notifications sent by receivers are coalesced as well.
+  base::ReferentPtr<RelayNotifier>::Type relay(new RelayNotifier);
+  MyNotifierPtr end(new MyNotifier);
+  n->AddReceiver(relay.Get());
+  n2->AddReceiver(relay.Get());
+  relay->AddReceiver(end.Get());
+  {
+    ScopedNotificationBatch batch;
+    n->Notify();
+    n2->Notify();
+  }
+  EXPECT_EQ(2U, relay->GetNotificationCount());
+  EXPECT_EQ(1U, end->GetNotificationCount());
+
+  // A Notifier destroyed during a batch is skipped.
+  {
+    ScopedNotificationBatch batch;
+    MyNotifierPtr temp(new MyNotifier);
+    temp->AddReceiver(end.Get());
+    temp->Notify();
+    temp.Reset();
+  }
+  EXPECT_EQ(1U, end->GetNotificationCount());
+}
+
+TEST(Notifier, ScopedNotificationBatchIsPerThread) {
+  CountingNotifierPtr n(new CountingNotifier);
+  CountingNotifierPtr receiver(new CountingNotifier);
+  n->AddReceiver(receiver.Get());
+  {
+    ScopedNotificationBatch batch;
+    // Notifications from another thread are not batched.
+    {
+      ThreadSpawner t("notify", std::bind(NotifyRepeatedly, n, 3));
+    }
+    EXPECT_EQ(3U, receiver->GetNotificationCount());
+    n->Notify();
+    n->Notify();
+    EXPECT_EQ(3U, receiver->GetNotificationCount());
+  }
+  EXPECT_EQ(4U, receiver->GetNotificationCount());
+}
+
+TEST(Notifier, ConcurrentNotifyPerfTest) {
+#if defined(ION_PLATFORM_ANDROID)
+  static const int kIterations = 500;
+#else
+  static const int kIterations = 20000;
+#endif
+  static const int kThreadCount = 4;
+  CountingNotifierPtr n(new CountingNotifier);
+  CountingNotifierPtr stable(new CountingNotifier);
+  n->AddReceiver(stable.Get());
+
+  // Notify from several threads while this thread keeps changing the other
+  // receivers.
+  port::Timer timer;
+  std::vector<CountingNotifierPtr> receivers;
+  {
+    std::vector<ThreadSpawner*> threads;
+    for (int i = 0; i < kThreadCount; ++i)
+      threads.push_back(new ThreadSpawner(
+          "notify", std::bind(NotifyRepeatedly, n, kIterations)));
+    for (int i = 0; i < 100; ++i) {
+      receivers.push_back(CountingNotifierPtr(new CountingNotifier));
+      n->AddReceiver(receivers.back().Get());
+      if (i % 2)
+        n->RemoveReceiver(receivers[i - 1].Get());
+    }
+    for (int i = 0; i < kThreadCount; ++i)
+      delete threads[i];
+  }
+  const double ms = timer.GetInMs();
+  LOG(INFO) << "Time per contended Notify(): "
+            << ms * 1000 / (kThreadCount * kIterations) << "us";
+
+  // Every notification reached the receiver that was never removed.
+  EXPECT_EQ(static_cast<size_t>(kThreadCount * kIterations),
+            stable->GetNotificationCount());
+  EXPECT_EQ(51U, n->GetReceiverCount());
+}
+
 }  // namespace base
 }  // namespace ion
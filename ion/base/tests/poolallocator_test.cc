@@ -0,0 +1,154 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/poolallocator.h"
+
+#include <stdint.h>
+#include <string.h>  // For memset().
+
+#include <set>
+
+#include "ion/base/allocatable.h"
+#include "ion/base/fullallocationtracker.h"
+#include "ion/base/stlalloc/allocmap.h"
+#include "ion/base/threadspawner.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+class Pooled : public Allocatable {
+ public:
+  Pooled() : value(0) {}
+  ~Pooled() override {}
+  int value;
+};
+
+}  // anonymous namespace
+
+TEST(PoolAllocatorTest, AllocateAndReuse) {
+  PoolAllocatorPtr allocator(new PoolAllocator);
+  EXPECT_EQ(0U, allocator->GetSlabCount());
+
+  // Allocations are aligned as malloc() would align them, and come from a
+  // slab.
+  std::set<void*> blocks;
+  for (size_t size = 0; size <= PoolAllocator::kMaxPooledSize; size += 7U) {
+    void* p = allocator->AllocateMemory(size);
+    ASSERT_TRUE(p);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(p) % alignof(long double));
+    memset(p, 0xff, size);
+    EXPECT_TRUE(blocks.insert(p).second);
+  }
+  const size_t slab_count = allocator->GetSlabCount();
+  EXPECT_LT(0U, slab_count);
+
+  // Freed blocks are reused for allocations of the same size class.
+  void* p = allocator->AllocateMemory(40U);
+  allocator->DeallocateMemory(p);
+  EXPECT_EQ(p, allocator->AllocateMemory(33U));
+  allocator->DeallocateMemory(p);
+  for (std::set<void*>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+    allocator->DeallocateMemory(*it);
+  EXPECT_EQ(slab_count, allocator->GetSlabCount());
+
+  // Large allocations do not use slabs.
+  void* large = allocator->AllocateMemory(PoolAllocator::kMaxPooledSize + 1U);
+  ASSERT_TRUE(large);
+  memset(large, 0, PoolAllocator::kMaxPooledSize + 1U);
+  allocator->DeallocateMemory(large);
+  EXPECT_EQ(slab_count, allocator->GetSlabCount());
+
+  // Deallocating NULL does nothing.
+  allocator->DeallocateMemory(NULL);
+}
+
+TEST(PoolAllocatorTest, ManyAllocations) {
+  PoolAllocatorPtr allocator(new PoolAllocator);
+  std::vector<void*> blocks;
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int i = 0; i < 10000; ++i)
+      blocks.push_back(allocator->AllocateMemory(64U));
+    // The second pass reuses the blocks of the first.
+    const size_t slab_count = allocator->GetSlabCount();
+    EXPECT_EQ(static_cast<size_t>(10000U * 80U / PoolAllocator::kSlabSize + 1U),
+              slab_count);
+    for (size_t i = 0; i < blocks.size(); ++i)
+      allocator->DeallocateMemory(blocks[i]);
+    blocks.clear();
+  }
+}
+
+TEST(PoolAllocatorTest, Trackers) {
+  PoolAllocatorPtr allocator(new PoolAllocator);
+  FullAllocationTrackerPtr tracker(new FullAllocationTracker);
+  FullAllocationTrackerPtr slab_tracker(new FullAllocationTracker);
+  allocator->SetTracker(tracker);
+  allocator->SetSlabTracker(slab_tracker);
+  EXPECT_EQ(slab_tracker.Get(), allocator->GetSlabTracker().Get());
+
+  Pooled* pooled = new(allocator) Pooled;
+  EXPECT_EQ(allocator.Get(), pooled->GetAllocator().Get());
+  EXPECT_EQ(1U, tracker->GetActiveAllocationCount());
+  EXPECT_EQ(1U, slab_tracker->GetActiveAllocationCount());
+  EXPECT_EQ(PoolAllocator::kSlabSize,
+            slab_tracker->GetActiveAllocationBytesCount());
+  delete pooled;
+  EXPECT_EQ(0U, tracker->GetActiveAllocationCount());
+  // The slab stays allocated until the allocator is destroyed.
+  EXPECT_EQ(1U, slab_tracker->GetActiveAllocationCount());
+
+  allocator->SetTracker(AllocationTrackerPtr());
+  allocator.Reset(NULL);
+  EXPECT_EQ(0U, slab_tracker->GetActiveAllocationCount());
+}
+
+TEST(PoolAllocatorTest, StlContainers) {
+  PoolAllocatorPtr allocator(new PoolAllocator);
+  {
+    AllocMap<int, int> m(allocator);
+    for (int i = 0; i < 1000; ++i)
+      m[i] = i * 2;
+    EXPECT_EQ(1998, m[999]);
+  }
+  EXPECT_LT(0U, allocator->GetSlabCount());
+}
+
+TEST(PoolAllocatorTest, Threads) {
+  PoolAllocatorPtr allocator(new PoolAllocator);
+  // Memory allocated in one thread may be deallocated in another.
+  std::vector<void*> blocks;
+  for (int i = 0; i < 100; ++i)
+    blocks.push_back(allocator->AllocateMemory(24U));
+  {
+    ThreadSpawner t("pool", [allocator, &blocks]() {
+      for (size_t i = 0; i < blocks.size(); ++i)
+        allocator->DeallocateMemory(blocks[i]);
+      for (int i = 0; i < 100; ++i)
+        blocks[i] = allocator->AllocateMemory(24U);
+      return true;
+    });
+  }
+  for (size_t i = 0; i < blocks.size(); ++i)
+    allocator->DeallocateMemory(blocks[i]);
+  EXPECT_EQ(1U, allocator->GetSlabCount());
+}
+
+}  // namespace base
+}  // namespace ion
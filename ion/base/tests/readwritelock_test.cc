@@ -17,6 +17,9 @@ limitations under the License.
 
 #include "ion/base/readwritelock.h"
 
+#include <memory>
+#include <vector>
+
 #include "ion/base/lockguards.h"
 #include "ion/base/logging.h"
 #include "ion/base/threadspawner.h"
@@ -29,7 +32,8 @@ namespace base {
 
 namespace {
 
-// Helper struct for testing a ReadWriteLock under contention.
+// Helper struct for testing a ReadWriteLock or BigReaderLock under contention.
+template <typename LockType>
 struct ReadWriteHelper {
   ReadWriteHelper()
       : read_lock(&lock),
@@ -43,7 +47,7 @@ struct ReadWriteHelper {
   bool DoRead() {
     read_barrier.Wait();
     {
-      ReadGuard reader(&read_lock);
+      GenericLockGuard<GenericReadLock<LockType>> reader(&read_lock);
       EXPECT_EQ(test_writer_count, writer_count);
       ++reader_count;
       read_barrier.Wait();
@@ -62,7 +66,7 @@ struct ReadWriteHelper {
 
   bool DoWriteInner() {
     {
-      WriteGuard writer(&write_lock);
+      GenericLockGuard<GenericWriteLock<LockType>> writer(&write_lock);
       ++writer_count;
       write_barrier.Wait();
       write_barrier.Wait();
@@ -70,9 +74,9 @@ struct ReadWriteHelper {
     return true;
   }
 
-  ReadWriteLock lock;
-  ReadLock read_lock;
-  WriteLock write_lock;
+  LockType lock;
+  GenericReadLock<LockType> read_lock;
+  GenericWriteLock<LockType> write_lock;
   port::Barrier read_barrier;
   port::Barrier write_barrier;
   std::atomic<int> reader_count;
@@ -80,6 +84,149 @@ struct ReadWriteHelper {
   int test_writer_count;
 };
 
+template <typename LockType>
+static void TestReadersBlockWriters() {
+  // Test that readers block a writer from entering, but that readers don't
+  // block other readers.
+  typedef ReadWriteHelper<LockType> Helper;
+  Helper helper;
+  ThreadSpawner r1("Reader 1", std::bind(&Helper::DoRead, &helper));
+  ThreadSpawner r2("Reader 2", std::bind(&Helper::DoRead, &helper));
+
+  // Pause readers inside their locks.
+  helper.read_barrier.Wait();
+  helper.read_barrier.Wait();
+  // At this point both readers should have obtained their locks.
+  EXPECT_EQ(2, helper.lock.GetReaderCount());
+
+  // Start the writer and let it try to obtain a lock.
+  ThreadSpawner w1("Writer 1", std::bind(&Helper::DoWrite, &helper));
+  helper.write_barrier.Wait();
+  // Give the writer thread ample chances to proceed.
+  port::Timer::SleepNSeconds(1);
+  // Since the readers are still holding the lock, the writer can't enter.
+  EXPECT_EQ(0, helper.writer_count);
+
+  // Let the readers exit, which should allow the writer to obtain the lock
+  // and write its string.
+  helper.read_barrier.Wait();
+  helper.read_barrier.Wait();
+  // Give the writer thread ample chances to proceed.
+  port::Timer::SleepNSeconds(1);
+  EXPECT_EQ(1, helper.writer_count);
+
+  // Let the writer exit.
+  helper.write_barrier.Wait();
+  helper.write_barrier.Wait();
+  helper.write_barrier.Wait();
+}
+
+template <typename LockType>
+static void TestWritersBlockReaders() {
+  // Test that writers block readers from entering.
+  typedef ReadWriteHelper<LockType> Helper;
+  Helper helper;
+  helper.test_writer_count = 1;
+
+  // Start the writer and let obtain the lock.
+  ThreadSpawner w1("Writer 1", std::bind(&Helper::DoWrite, &helper));
+  helper.write_barrier.Wait();
+  helper.write_barrier.Wait();
+  EXPECT_EQ(1, helper.writer_count);
+
+  // Now spawn readers and let them try to lock
+  ThreadSpawner r1("Reader 1", std::bind(&Helper::DoRead, &helper));
+  ThreadSpawner r2("Reader 2", std::bind(&Helper::DoRead, &helper));
+  helper.read_barrier.Wait();
+  // Give the reader threads ample chances to proceed.
+  port::Timer::SleepNSeconds(1);
+  EXPECT_EQ(0, helper.reader_count);
+
+  // Let the writer continue.
+  helper.write_barrier.Wait();
+  helper.write_barrier.Wait();
+
+  // Give the reader threads ample chances to proceed.
+  port::Timer::SleepNSeconds(1);
+  // Both readers should have their locks.
+  EXPECT_EQ(2, helper.reader_count);
+
+  helper.read_barrier.Wait();
+  helper.read_barrier.Wait();
+  helper.read_barrier.Wait();
+}
+
+template <typename LockType>
+static void TestWritersBlockWriters() {
+  // Test that writers block each other from entering.
+  typedef ReadWriteHelper<LockType> Helper;
+  Helper helper;
+
+  // Start the writer and let obtain the lock.
+  ThreadSpawner w1("Writer 1",
+                   std::bind(&Helper::DoWriteInner, &helper));
+  ThreadSpawner w2("Writer 2",
+                   std::bind(&Helper::DoWriteInner, &helper));
+  helper.write_barrier.Wait();
+  // Give the writer threads ample chances to proceed.
+  port::Timer::SleepNSeconds(1);
+  // Only one thread should have succeeded in obtaining the lock.
+  EXPECT_EQ(1, helper.writer_count);
+  // Let the first thread exit.
+  helper.write_barrier.Wait();
+
+  // Give the writer threads ample chances to proceed.
+  port::Timer::SleepNSeconds(1);
+  // The second thread should have obtained the lock.
+  EXPECT_EQ(2, helper.writer_count);
+
+  helper.write_barrier.Wait();
+  helper.write_barrier.Wait();
+}
+
+// Simulates the load of change notifications: thread_count threads each take
+// many short read locks on lock, while the calling thread occasionally takes
+// a write lock and modifies the protected values. Readers verify that they
+// never see a partial modification. Returns the time in ms the readers took.
+template <typename LockType>
+static double RunNotificationLoad(int thread_count) {
+  static const int kReadsPerThread = 200000;
+  LockType lock;
+  GenericReadLock<LockType> read_lock(&lock);
+  GenericWriteLock<LockType> write_lock(&lock);
+  int values[2] = {0, 0};
+  std::atomic<int> running(thread_count);
+  std::atomic<int> mismatch_count(0);
+  auto reader = [&]() {
+    for (int i = 0; i < kReadsPerThread; ++i) {
+      GenericLockGuard<GenericReadLock<LockType>> guard(&read_lock);
+      if (values[0] != values[1])
+        ++mismatch_count;
+    }
+    --running;
+    return true;
+  };
+
+  port::Timer timer;
+  {
+    std::vector<std::unique_ptr<ThreadSpawner>> threads;
+    for (int i = 0; i < thread_count; ++i)
+      threads.emplace_back(new ThreadSpawner("Reader", reader));
+    while (running) {
+      {
+        GenericLockGuard<GenericWriteLock<LockType>> guard(&write_lock);
+        ++values[0];
+        ++values[1];
+      }
+      port::Timer::SleepNMilliseconds(1);
+    }
+  }
+  EXPECT_EQ(0, mismatch_count);
+  EXPECT_EQ(0, lock.GetReaderCount());
+  EXPECT_EQ(0, lock.GetWriterCount());
+  return timer.GetInMs();
+}
+
 }  // anonymous namespace
 
 TEST(ReadWriteLock, BasicUsage) {
@@ -163,97 +310,139 @@ TEST(ReadWriteLock, WriteLock) {
 }
 
 TEST(ReadWriteLock, ReadersBlockWriters) {
-  // Test that readers block a writer from entering, but that readers don't
-  // block other readers.
-  ReadWriteHelper helper;
-  ThreadSpawner r1("Reader 1", std::bind(&ReadWriteHelper::DoRead, &helper));
-  ThreadSpawner r2("Reader 2", std::bind(&ReadWriteHelper::DoRead, &helper));
-
-  // Pause readers inside their locks.
-  helper.read_barrier.Wait();
-  helper.read_barrier.Wait();
-  // At this point both readers should have obtained their locks.
-  EXPECT_EQ(2, helper.lock.GetReaderCount());
-
-  // Start the writer and let it try to obtain a lock.
-  ThreadSpawner w1("Writer 1", std::bind(&ReadWriteHelper::DoWrite, &helper));
-  helper.write_barrier.Wait();
-  // Give the writer thread ample chances to proceed.
-  port::Timer::SleepNSeconds(1);
-  // Since the readers are still holding the lock, the writer can't enter.
-  EXPECT_EQ(0, helper.writer_count);
+  TestReadersBlockWriters<ReadWriteLock>();
+}
 
-  // Let the readers exit, which should allow the writer to obtain the lock
-  // and write its string.
-  helper.read_barrier.Wait();
-  helper.read_barrier.Wait();
-  // Give the writer thread ample chances to proceed.
-  port::Timer::SleepNSeconds(1);
-  EXPECT_EQ(1, helper.writer_count);
+TEST(ReadWriteLock, WritersBlockReaders) {
+  TestWritersBlockReaders<ReadWriteLock>();
+}
 
-  // Let the writer exit.
-  helper.write_barrier.Wait();
-  helper.write_barrier.Wait();
-  helper.write_barrier.Wait();
+TEST(ReadWriteLock, WritersBlockWriters) {
+  TestWritersBlockWriters<ReadWriteLock>();
 }
 
-TEST(ReadWriteLock, WritersBlockReaders) {
-  // Test that writers block readers from entering.
-  ReadWriteHelper helper;
-  helper.test_writer_count = 1;
+TEST(ReadWriteLock, FirstReadersRaceLastReader) {
+  // Stress readers that enter the lock as the last reader leaves it: short
+  // read locks on several threads keep the count dropping to zero while other
+  // readers are queued as first readers, and a writer repeatedly enters. No
+  // reader may ever be in the lock together with the writer.
+  static const int kThreadCount = 8;
+  static const int kReadsPerThread = 20000;
+  ReadWriteLock lock;
+  std::atomic<int> readers_inside(0);
+  std::atomic<bool> writer_inside(false);
+  std::atomic<int> running(kThreadCount);
+  std::atomic<int> overlap_count(0);
+  auto reader = [&]() {
+    for (int i = 0; i < kReadsPerThread; ++i) {
+      lock.LockForRead();
+      ++readers_inside;
+      if (writer_inside)
+        ++overlap_count;
+      port::YieldThread();
+      if (writer_inside)
+        ++overlap_count;
+      --readers_inside;
+      lock.UnlockForRead();
+    }
+    --running;
+    return true;
+  };
 
-  // Start the writer and let obtain the lock.
-  ThreadSpawner w1("Writer 1", std::bind(&ReadWriteHelper::DoWrite, &helper));
-  helper.write_barrier.Wait();
-  helper.write_barrier.Wait();
-  EXPECT_EQ(1, helper.writer_count);
+  {
+    std::vector<std::unique_ptr<ThreadSpawner>> threads;
+    for (int i = 0; i < kThreadCount; ++i)
+      threads.emplace_back(new ThreadSpawner("Reader", reader));
+    while (running) {
+      lock.LockForWrite();
+      writer_inside = true;
+      if (readers_inside)
+        ++overlap_count;
+      port::YieldThread();
+      if (readers_inside)
+        ++overlap_count;
+      writer_inside = false;
+      lock.UnlockForWrite();
+      port::YieldThread();
+    }
+  }
+  EXPECT_EQ(0, overlap_count);
+  EXPECT_EQ(0, lock.GetReaderCount());
+  EXPECT_EQ(0, lock.GetWriterCount());
 
-  // Now spawn readers and let them try to lock
-  ThreadSpawner r1("Reader 1", std::bind(&ReadWriteHelper::DoRead, &helper));
-  ThreadSpawner r2("Reader 2", std::bind(&ReadWriteHelper::DoRead, &helper));
-  helper.read_barrier.Wait();
-  // Give the reader threads ample chances to proceed.
-  port::Timer::SleepNSeconds(1);
-  EXPECT_EQ(0, helper.reader_count);
+  // A reader that joined without waiting on the room semaphore leaves it
+  // posted once too often, which would let a writer in with a reader.
+  std::atomic<bool> writer_entered(false);
+  lock.LockForRead();
+  {
+    ThreadSpawner writer("Writer", [&]() {
+      lock.LockForWrite();
+      writer_entered = true;
+      lock.UnlockForWrite();
+      return true;
+    });
+    port::Timer::SleepNMilliseconds(100);
+    EXPECT_FALSE(writer_entered);
+    lock.UnlockForRead();
+  }
+  EXPECT_TRUE(writer_entered);
+}
 
-  // Let the writer continue.
-  helper.write_barrier.Wait();
-  helper.write_barrier.Wait();
+TEST(BigReaderLock, BasicUsage) {
+  BigReaderLock lock;
+  EXPECT_EQ(0, lock.GetReaderCount());
+  EXPECT_EQ(0, lock.GetWriterCount());
 
-  // Give the reader threads ample chances to proceed.
-  port::Timer::SleepNSeconds(1);
-  // Both readers should have their locks.
-  EXPECT_EQ(2, helper.reader_count);
+  lock.LockForRead();
+  EXPECT_EQ(1, lock.GetReaderCount());
+  lock.LockForRead();
+  EXPECT_EQ(2, lock.GetReaderCount());
+  lock.UnlockForRead();
+  lock.UnlockForRead();
+  EXPECT_EQ(0, lock.GetReaderCount());
 
-  helper.read_barrier.Wait();
-  helper.read_barrier.Wait();
-  helper.read_barrier.Wait();
+  lock.LockForWrite();
+  EXPECT_EQ(1, lock.GetWriterCount());
+  lock.UnlockForWrite();
+  EXPECT_EQ(0, lock.GetWriterCount());
+
+  BigReaderReadLock reader(&lock);
+  BigReaderWriteLock writer(&lock);
+  {
+    BigReaderReadGuard guard(&reader);
+    EXPECT_TRUE(reader.IsLocked());
+    EXPECT_FALSE(writer.IsLocked());
+  }
+  {
+    BigReaderWriteGuard guard(&writer);
+    EXPECT_FALSE(reader.IsLocked());
+    EXPECT_TRUE(writer.IsLocked());
+  }
+  EXPECT_FALSE(reader.IsLocked());
+  EXPECT_FALSE(writer.IsLocked());
 }
 
-TEST(ReadWriteLock, WritersBlockWriters) {
-  // Test that writers block each other from entering.
-  ReadWriteHelper helper;
+TEST(BigReaderLock, ReadersBlockWriters) {
+  TestReadersBlockWriters<BigReaderLock>();
+}
 
-  // Start the writer and let obtain the lock.
-  ThreadSpawner w1("Writer 1",
-                   std::bind(&ReadWriteHelper::DoWriteInner, &helper));
-  ThreadSpawner w2("Writer 2",
-                   std::bind(&ReadWriteHelper::DoWriteInner, &helper));
-  helper.write_barrier.Wait();
-  // Give the writer threads ample chances to proceed.
-  port::Timer::SleepNSeconds(1);
-  // Only one thread should have succeeded in obtaining the lock.
-  EXPECT_EQ(1, helper.writer_count);
-  // Let the first thread exit.
-  helper.write_barrier.Wait();
+TEST(BigReaderLock, WritersBlockReaders) {
+  TestWritersBlockReaders<BigReaderLock>();
+}
 
-  // Give the writer threads ample chances to proceed.
-  port::Timer::SleepNSeconds(1);
-  // The second thread should have obtained the lock.
-  EXPECT_EQ(2, helper.writer_count);
+TEST(BigReaderLock, WritersBlockWriters) {
+  TestWritersBlockWriters<BigReaderLock>();
+}
 
-  helper.write_barrier.Wait();
-  helper.write_barrier.Wait();
+TEST(BigReaderLock, NotificationLoad) {
+  // Compare both kinds of lock under the same read-mostly load. The times are
+  // only logged, since they depend on the machine.
+  for (int threads = 1; threads <= 8; threads *= 2) {
+    const double rw_time = RunNotificationLoad<ReadWriteLock>(threads);
+    const double br_time = RunNotificationLoad<BigReaderLock>(threads);
+    LOG(INFO) << threads << " reader threads: ReadWriteLock " << rw_time
+              << " ms, BigReaderLock " << br_time << " ms";
+  }
 }
 
 }  // namespace base
@@ -0,0 +1,179 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/samplingallocationtracker.h"
+
+#include <functional>
+#include <string>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/threadspawner.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// A derived Allocator class used only to create dummy instances.
+class DummyAllocator : public Allocator {
+ public:
+  // Implementations don't matter - they will never be called.
+  void* Allocate(size_t size) override { return NULL; }
+  void Deallocate(void* p) override {}
+};
+
+// Handy function to cast a pointer.
+static const void* Pointer(size_t address) {
+  return reinterpret_cast<const void*>(address);
+}
+
+}  // anonymous namespace
+
+TEST(SamplingAllocationTracker, SampleEveryAllocation) {
+  SamplingAllocationTrackerPtr sat(new SamplingAllocationTracker(0U));
+  AllocatorPtr da(new DummyAllocator);
+  EXPECT_EQ(0U, sat->GetSampleInterval());
+  EXPECT_EQ(0U, sat->GetLiveSampleCount());
+
+  sat->TrackAllocation(*da, 100U, Pointer(0x100));
+  {
+    SamplingAllocationTracker::ScopedTag tag("gfx");
+    sat->TrackAllocation(*da, 20U, Pointer(0x200));
+    {
+      SamplingAllocationTracker::ScopedTag tag2("text");
+      sat->TrackAllocation(*da, 30U, Pointer(0x300));
+    }
+    sat->TrackAllocation(*da, 40U, Pointer(0x400));
+  }
+  // Failed allocations are counted but not sampled.
+  sat->TrackAllocation(*da, 50U, NULL);
+  EXPECT_EQ(5U, sat->GetAllocationCount());
+  EXPECT_EQ(240U, sat->GetAllocatedBytesCount());
+  EXPECT_EQ(4U, sat->GetLiveSampleCount());
+  EXPECT_EQ(190U, sat->GetActiveAllocationBytesCount());
+
+  SamplingAllocationTracker::Snapshot snapshot = sat->GetSnapshot(false);
+  EXPECT_EQ(5U, snapshot.allocation_count);
+  EXPECT_EQ(240U, snapshot.allocated_bytes);
+  EXPECT_TRUE(snapshot.stacks.empty());
+  ASSERT_EQ(3U, snapshot.tags.size());
+  EXPECT_EQ("untagged", snapshot.tags[0].tag);
+  EXPECT_EQ(100U, snapshot.tags[0].live_bytes);
+  EXPECT_EQ("gfx", snapshot.tags[1].tag);
+  EXPECT_EQ(60U, snapshot.tags[1].live_bytes);
+  EXPECT_EQ(2U, snapshot.tags[1].live_samples);
+  EXPECT_EQ("text", snapshot.tags[2].tag);
+  EXPECT_EQ(30U, snapshot.tags[2].live_bytes);
+  // DummyAllocator is not a default Allocator.
+  EXPECT_EQ(kNumAllocationLifetimes, snapshot.tags[0].lifetime);
+
+  // Deallocations remove the samples, but allocated bytes remain.
+  sat->TrackDeallocation(*da, Pointer(0x100));
+  sat->TrackDeallocation(*da, Pointer(0x200));
+  sat->TrackDeallocation(*da, Pointer(0x999));
+  EXPECT_EQ(3U, sat->GetDeallocationCount());
+  EXPECT_EQ(2U, sat->GetLiveSampleCount());
+  EXPECT_EQ(70U, sat->GetActiveAllocationBytesCount());
+  snapshot = sat->GetSnapshot(true);
+  ASSERT_EQ(3U, snapshot.tags.size());
+  EXPECT_EQ("gfx", snapshot.tags[0].tag);
+  EXPECT_EQ(40U, snapshot.tags[0].live_bytes);
+  EXPECT_EQ(60U, snapshot.tags[0].allocated_bytes);
+  EXPECT_EQ("untagged", snapshot.tags[2].tag);
+  EXPECT_EQ(0U, snapshot.tags[2].live_bytes);
+  EXPECT_EQ(100U, snapshot.tags[2].allocated_bytes);
+  EXPECT_FALSE(snapshot.stacks.empty());
+
+  // Unsupported counts.
+  EXPECT_EQ(0U, sat->GetDeallocatedBytesCount());
+  EXPECT_EQ(0U, sat->GetActiveAllocationCount());
+}
+
+TEST(SamplingAllocationTracker, SampleInterval) {
+  SamplingAllocationTrackerPtr sat(new SamplingAllocationTracker(100U));
+  AllocatorPtr da(new DummyAllocator);
+  // Every fourth allocation is sampled and stands for 120 bytes.
+  for (size_t i = 1; i <= 10U; ++i)
+    sat->TrackAllocation(*da, 30U, Pointer(i * 16U));
+  EXPECT_EQ(2U, sat->GetLiveSampleCount());
+  EXPECT_EQ(240U, sat->GetActiveAllocationBytesCount());
+  sat->TrackDeallocation(*da, Pointer(4U * 16U));
+  EXPECT_EQ(1U, sat->GetLiveSampleCount());
+  EXPECT_EQ(120U, sat->GetActiveAllocationBytesCount());
+
+  // Allocations larger than the interval are always sampled.
+  sat->TrackAllocation(*da, 1000U, Pointer(0x1000));
+  EXPECT_EQ(2U, sat->GetLiveSampleCount());
+  EXPECT_EQ(1180U, sat->GetActiveAllocationBytesCount());
+
+  // Each thread counts its own bytes.
+  std::function<bool()> func = [sat, da]() {
+    sat->TrackAllocation(*da, 90U, Pointer(0x2000));
+    return true;
+  };
+  {
+    ThreadSpawner t("sampler", func);
+  }
+  EXPECT_EQ(2U, sat->GetLiveSampleCount());
+  SamplingAllocationTracker::Snapshot snapshot = sat->GetSnapshot(false);
+  EXPECT_EQ(12U, snapshot.allocation_count);
+  EXPECT_EQ(1390U, snapshot.allocated_bytes);
+  EXPECT_EQ(SamplingAllocationTracker::kDefaultSampleInterval,
+            SamplingAllocationTrackerPtr(new SamplingAllocationTracker)
+                ->GetSampleInterval());
+}
+
+TEST(SamplingAllocationTracker, InstallOnDefaultAllocators) {
+  SamplingAllocationTrackerPtr sat(new SamplingAllocationTracker(0U));
+  const AllocatorPtr& allocator =
+      AllocationManager::GetDefaultAllocatorForLifetime(kShortTerm);
+  ASSERT_FALSE(allocator->GetTracker().Get());
+  SamplingAllocationTracker::InstallOnDefaultAllocators(sat);
+  EXPECT_EQ(sat.Get(), allocator->GetTracker().Get());
+
+  void* p;
+  {
+    SamplingAllocationTracker::ScopedTag tag("image");
+    p = allocator->AllocateMemory(64U);
+  }
+  SamplingAllocationTracker::Snapshot snapshot = sat->GetSnapshot(false);
+  ASSERT_FALSE(snapshot.tags.empty());
+  EXPECT_EQ("image", snapshot.tags[0].tag);
+  EXPECT_EQ(kShortTerm, snapshot.tags[0].lifetime);
+  EXPECT_EQ(64U, snapshot.tags[0].live_bytes);
+
+  // The JSON snapshot holds the same values.
+  const std::string json = sat->GetSnapshotJson(true);
+  EXPECT_EQ(0U, json.find("{ \"sample_interval\": 0, "));
+  EXPECT_NE(std::string::npos,
+            json.find("{ \"tag\": \"image\", \"lifetime\": \"kShortTerm\", "
+                      "\"live_bytes\": 64, \"allocated_bytes\": 64, "
+                      "\"live_samples\": 1 }"));
+  EXPECT_NE(std::string::npos, json.find("\"stacks\": [ { \"stack\": \""));
+
+  allocator->DeallocateMemory(p);
+  for (int i = 0; i < kNumAllocationLifetimes; ++i) {
+    AllocationManager::GetDefaultAllocatorForLifetime(
+        static_cast<AllocationLifetime>(i))->SetTracker(
+            AllocationTrackerPtr());
+  }
+  EXPECT_EQ(0U, sat->GetLiveSampleCount());
+}
+
+}  // namespace base
+}  // namespace ion
@@ -250,6 +250,53 @@ TEST(Setting, AtomicSettings) {
   EXPECT_TRUE(static_cast<bool>(bool_setting));
 }
 
+TEST(Setting, Snapshots) {
+  // Scalar settings keep a copy of their value that is updated by every
+  // change.
+  Setting<int> int_setting("snapshot_int", 12, "an int");
+  EXPECT_EQ(12, int_setting.GetSnapshot());
+  int_setting = 21;
+  EXPECT_EQ(21, int_setting.GetSnapshot());
+  int_setting.SetValue(42);
+  EXPECT_EQ(42, int_setting.GetSnapshot());
+  EXPECT_TRUE(int_setting.FromString("123"));
+  EXPECT_EQ(123, int_setting.GetSnapshot());
+
+  // Changes made through the mutable value are only seen once listeners are
+  // notified.
+  *int_setting.GetMutableValue() = 7;
+  EXPECT_EQ(123, int_setting.GetSnapshot());
+  int_setting.NotifyListeners();
+  EXPECT_EQ(7, int_setting.GetSnapshot());
+
+  Setting<bool> bool_setting("snapshot_bool", false, "a bool");
+  EXPECT_FALSE(bool_setting.GetSnapshot());
+  bool_setting = true;
+  EXPECT_TRUE(bool_setting.GetSnapshot());
+
+  // Atomic settings read their value directly.
+  Setting<std::atomic<int> > atomic_setting("snapshot_atomic", 1, "an int");
+  EXPECT_EQ(1, atomic_setting.GetSnapshot());
+  atomic_setting = 2;
+  EXPECT_EQ(2, atomic_setting.GetSnapshot());
+
+  // Snapshots can be read from other threads while the value changes.
+  std::atomic<bool> done(false);
+  ThreadSpawner reader("snapshot_reader", [&int_setting, &done]() {
+    int last = 0;
+    while (!done.load()) {
+      const int value = int_setting.GetSnapshot();
+      EXPECT_LE(last, value);
+      last = value;
+    }
+    return true;
+  });
+  for (int i = 8; i < 1000; ++i)
+    int_setting = i;
+  done = true;
+  reader.Join();
+}
+
 TEST(Setting, TypeDescriptor) {
   Setting<double> double_setting("double", 12.34, "a double");
   EXPECT_TRUE(double_setting.GetTypeDescriptor().empty());
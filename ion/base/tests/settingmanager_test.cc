@@ -22,6 +22,7 @@ limitations under the License.
 #include "ion/base/logchecker.h"
 #include "ion/base/logging.h"
 #include "ion/base/staticsafedeclare.h"
+#include "ion/base/threadspawner.h"
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -226,5 +227,74 @@ TEST(SettingManager, RegisterSameBeforeUnregisterSettingsAndGroupListeners) {
   EXPECT_TRUE(listener2.WasCalled());
 }
 
+TEST(SettingManager, DeferredNotifications) {
+  Setting<int> setting1("deferred/int1", 1, "");
+  Setting<int> setting2("deferred/int2", 2, "");
+  Listener listener1, group_listener;
+  setting1.RegisterListener(
+      "listener1",
+      std::bind(&Listener::Callback, &listener1, std::placeholders::_1));
+  SettingManager::RegisterGroupListener(
+      "deferred", "group_listener",
+      std::bind(&Listener::Callback, &group_listener, std::placeholders::_1));
+  EXPECT_FALSE(SettingManager::AreNotificationsDeferred());
+
+  SettingManager::EnableDeferredNotifications(true);
+  EXPECT_TRUE(SettingManager::AreNotificationsDeferred());
+
+  // Changes made on another thread are seen immediately through snapshots,
+  // but listeners are only called when notifications are delivered.
+  {
+    ThreadSpawner spawner("deferred_setting", [&setting1]() {
+      setting1 = 10;
+      setting1 = 11;
+      return true;
+    });
+  }
+  EXPECT_EQ(11, setting1.GetSnapshot());
+  EXPECT_FALSE(listener1.WasCalled());
+  EXPECT_FALSE(group_listener.WasCalled());
+  SettingManager::DeliverDeferredNotifications();
+  EXPECT_TRUE(listener1.WasCalled());
+  EXPECT_TRUE(group_listener.WasCalled());
+  SettingManager::DeliverDeferredNotifications();
+  EXPECT_FALSE(listener1.WasCalled());
+  EXPECT_FALSE(group_listener.WasCalled());
+
+  // Each setting is only notified once per delivery.
+  int group_count = 0;
+  SettingManager::RegisterGroupListener(
+      "deferred", "counter",
+      [&group_count](SettingBase* setting) { ++group_count; });
+  setting1 = 12;
+  setting2 = 20;
+  setting1 = 13;
+  SettingManager::DeliverDeferredNotifications();
+  EXPECT_EQ(2, group_count);
+
+  // Destroyed settings are not notified.
+  {
+    Setting<int> setting3("deferred/int3", 3, "");
+    setting3 = 30;
+  }
+  group_count = 0;
+  SettingManager::DeliverDeferredNotifications();
+  EXPECT_EQ(0, group_count);
+
+  // Pending notifications are still delivered after deferring stops, and later
+  // changes are notified immediately.
+  setting2 = 21;
+  SettingManager::EnableDeferredNotifications(false);
+  EXPECT_EQ(0, group_count);
+  SettingManager::DeliverDeferredNotifications();
+  EXPECT_EQ(1, group_count);
+  setting1 = 14;
+  EXPECT_TRUE(listener1.WasCalled());
+  EXPECT_EQ(2, group_count);
+
+  SettingManager::UnregisterGroupListener("deferred", "group_listener");
+  SettingManager::UnregisterGroupListener("deferred", "counter");
+}
+
 }  // namespace base
 }  // namespace ion
@@ -333,6 +333,33 @@ TEST(SharedPtr, IncompleteType) {
   // And finally, destruction of all ptrs should work.
 }
 
+TEST(SharedPtr, SingleThreadRefCount) {
+  TestCounter::ClearNumDeletions();
+  TestCounter* t = new TestCounter;
+  EXPECT_EQ(TestCounter::kThreadSafeRefCount, t->GetRefCountPolicy());
+  t->SetRefCountPolicy(TestCounter::kSingleThreadRefCount);
+  EXPECT_EQ(TestCounter::kSingleThreadRefCount, t->GetRefCountPolicy());
+  {
+    TestCounterPtr p1(t);
+    {
+      TestCounterPtr p2(p1);
+      TestCounterPtr p3;
+      p3 = p2;
+      EXPECT_EQ(3, t->GetRefCount());
+    }
+    EXPECT_EQ(1, t->GetRefCount());
+    EXPECT_EQ(0U, TestCounter::GetNumDeletions());
+
+    // The policy may be changed back while the instance is referenced.
+    t->SetRefCountPolicy(TestCounter::kThreadSafeRefCount);
+    TestCounterPtr p4(p1);
+    EXPECT_EQ(2, t->GetRefCount());
+    t->SetRefCountPolicy(TestCounter::kSingleThreadRefCount);
+  }
+  // The instance is still deleted when the last reference goes away.
+  EXPECT_EQ(1U, TestCounter::GetNumDeletions());
+}
+
 TEST(SharedPtr, ConstructionPerfTest) {
   ion::port::Timer tmr;
   const unsigned iterations = 100000;
@@ -364,6 +391,18 @@ TEST(SharedPtr, AssignmentPerfTest) {
             << tmr.GetInMs() * 1000 / iterations << "us";
 }
 
+TEST(SharedPtr, SingleThreadAssignmentPerfTest) {
+  ion::port::Timer tmr;
+  const unsigned iterations = 100000;
+  TestCounterPtr ptr(new TestCounter);
+  ptr->SetRefCountPolicy(TestCounter::kSingleThreadRefCount);
+  for (unsigned i = 0; i < iterations; ++i) {
+    TestCounterPtr ptr2 = ptr;
+  }
+  LOG(INFO) << "Time per single-thread SharedPtr increment/decrement: "
+            << tmr.GetInMs() * 1000 / iterations << "us";
+}
+
 TEST(stdshared_ptr, AssignmentPerfTest) {
   ion::port::Timer tmr;
   const unsigned iterations = 100000;
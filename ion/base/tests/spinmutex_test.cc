@@ -100,6 +100,57 @@ TEST_F(PortMutexTest, Exclusion) {
   TestExclusion(100);  // iterations
 }
 
+TEST(SpinMutex, ContentionStatistics) {
+  static const int kThreadCount = 4;
+  static const int kIterations = 10000;
+  SpinMutex mutex;
+  int counter = 0;
+
+  EXPECT_FALSE(SpinMutex::AreContentionStatisticsEnabled());
+  mutex.Lock();
+  mutex.Unlock();
+  EXPECT_EQ(0U, SpinMutex::GetContentionStatistics().acquisition_count);
+
+  SpinMutex::EnableContentionStatistics(true);
+  EXPECT_TRUE(SpinMutex::AreContentionStatisticsEnabled());
+  EXPECT_TRUE(mutex.TryLock());
+  EXPECT_FALSE(mutex.TryLock());
+  mutex.Unlock();
+  EXPECT_EQ(1U, SpinMutex::GetContentionStatistics().acquisition_count);
+  SpinMutex::ResetContentionStatistics();
+
+  // Hammer the mutex from several threads. The owner often holds it long
+  // enough to make the others spin or wait.
+  std::function<bool()> thread_func = [&]() {
+    for (int i = 0; i < kIterations; ++i) {
+      mutex.Lock();
+      ++counter;
+      if (i % 1000 == 0)
+        port::YieldThread();
+      mutex.Unlock();
+    }
+    return true;
+  };
+  port::ThreadId threads[kThreadCount];
+  for (int i = 0; i < kThreadCount; ++i)
+    threads[i] = port::SpawnThreadStd(&thread_func);
+  for (int i = 0; i < kThreadCount; ++i)
+    port::JoinThread(threads[i]);
+  EXPECT_EQ(kThreadCount * kIterations, counter);
+  EXPECT_FALSE(mutex.IsLocked());
+
+  const SpinMutex::ContentionStatistics stats =
+      SpinMutex::GetContentionStatistics();
+  EXPECT_EQ(static_cast<uint64>(kThreadCount * kIterations),
+            stats.acquisition_count);
+  // Each wait follows a full spin budget.
+  EXPECT_LE(stats.wait_count, stats.spin_count);
+
+  SpinMutex::ResetContentionStatistics();
+  SpinMutex::EnableContentionStatistics(false);
+  EXPECT_EQ(0U, SpinMutex::GetContentionStatistics().acquisition_count);
+}
+
 #endif  // !ION_PLATFORM_ASMJS
 
 }  // namespace base
@@ -0,0 +1,71 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/staticprewarmer.h"
+
+#include "ion/base/staticsafedeclare.h"
+#include "ion/port/threadutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// The thread that constructed the static returned by GetPrewarmedValue().
+static port::ThreadId s_constructing_thread = port::kInvalidThreadId;
+
+struct PrewarmedValue {
+  PrewarmedValue() : value(42) {
+    s_constructing_thread = port::GetCurrentThreadId();
+  }
+  int value;
+};
+
+static PrewarmedValue* GetPrewarmedValue() {
+  ION_DECLARE_SAFE_STATIC_POINTER(PrewarmedValue, prewarmed_value);
+  return prewarmed_value;
+}
+
+}  // anonymous namespace
+
+TEST(StaticPrewarmer, ConstructsStaticsInBackground) {
+  int call_count = 0;
+  {
+    std::vector<std::function<void()>> funcs;
+    funcs.push_back([]() { GetPrewarmedValue(); });
+    funcs.push_back([&call_count]() { ++call_count; });
+    StaticPrewarmer prewarmer(funcs);
+    prewarmer.Wait();
+    EXPECT_TRUE(prewarmer.IsDone());
+    EXPECT_EQ(1, call_count);
+  }
+  EXPECT_NE(port::kInvalidThreadId, s_constructing_thread);
+  EXPECT_NE(port::GetCurrentThreadId(), s_constructing_thread);
+  EXPECT_EQ(42, GetPrewarmedValue()->value);
+
+  // The destructor waits for the functions.
+  {
+    std::vector<std::function<void()>> funcs;
+    funcs.push_back([&call_count]() { ++call_count; });
+    StaticPrewarmer prewarmer(funcs);
+  }
+  EXPECT_EQ(2, call_count);
+}
+
+}  // namespace base
+}  // namespace ion
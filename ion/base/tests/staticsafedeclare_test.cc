@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "ion/base/logging.h"
 #include "ion/base/threadspawner.h"
+#include "ion/port/timer.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 namespace {
@@ -71,6 +72,13 @@ struct B : Base {
   Base* a;
 };
 
+// A type whose constructor sleeps for the passed number of milliseconds.
+struct SlowStruct {
+  explicit SlowStruct(unsigned int ms) {
+    ion::port::Timer::SleepNMilliseconds(ms);
+  }
+};
+
 // A numeric type that increments its value each time it is default-construted.
 // Used to verify that ION_DECLARE_SAFE_STATIC_ARRAY is creating valid objects.
 static int default_int_val = 0;
@@ -146,6 +154,28 @@ TEST(StaticInitialize, InitializeVariables) {
               NULL);
 }
 
+TEST(StaticInitialize, ConstructionTimes) {
+  using ion::base::StaticDeleterBase;
+  using ion::base::StaticDeleterDeleter;
+  const size_t offset = StaticDeleterDeleter::GetInstance()->GetDeleterCount();
+
+  ION_DECLARE_SAFE_STATIC_POINTER_WITH_CONSTRUCTOR(
+      SlowStruct, slow_struct, (new SlowStruct(20)));
+  EXPECT_TRUE(slow_struct != NULL);
+
+  const StaticDeleterBase* deleter =
+      StaticDeleterDeleter::GetInstance()->GetDeleterAt(offset);
+  ASSERT_TRUE(deleter != NULL);
+  EXPECT_EQ("SlowStruct*", deleter->GetTypeName());
+  EXPECT_LE(20000U, deleter->GetConstructionTimeUs());
+
+  const std::vector<std::pair<std::string, uint64_t>> times =
+      StaticDeleterDeleter::GetInstance()->GetConstructionTimes();
+  ASSERT_EQ(offset + 1U, times.size());
+  EXPECT_EQ("SlowStruct*", times.back().first);
+  EXPECT_EQ(deleter->GetConstructionTimeUs(), times.back().second);
+}
+
 TEST(StaticInitialize, Interdependencies) {
   // Declare a dicey situation, where b depends on a1, while a2 depends on b. If
   // StaticDeleters are tied to a particular type, rather than a pointer, one of
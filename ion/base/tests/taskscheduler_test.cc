@@ -0,0 +1,132 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/taskscheduler.h"
+
+#include <vector>
+
+#include "ion/port/atomic.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+TEST(TaskSchedulerTest, SubmitAndWait) {
+  TaskScheduler scheduler("tasks", 3U);
+  EXPECT_EQ("tasks", scheduler.GetName());
+  EXPECT_EQ(3U, scheduler.GetThreadCount());
+
+  std::atomic<int> count(0);
+  TaskScheduler::TaskGroup group;
+  EXPECT_TRUE(group.IsDone());
+  for (int i = 0; i < 100; ++i)
+    scheduler.Submit([&count]() { ++count; }, &group);
+  scheduler.Wait(&group);
+  EXPECT_TRUE(group.IsDone());
+  EXPECT_EQ(100, count.load());
+
+  // Tasks may submit and wait for more tasks.
+  scheduler.Submit([&scheduler, &count]() {
+    TaskScheduler::TaskGroup inner;
+    for (int i = 0; i < 10; ++i)
+      scheduler.Submit([&count]() { ++count; }, &inner);
+    scheduler.Wait(&inner);
+  }, &group);
+  scheduler.Wait(&group);
+  EXPECT_EQ(110, count.load());
+}
+
+TEST(TaskSchedulerTest, NoThreads) {
+  // Tasks run on the waiting thread.
+  TaskScheduler scheduler("tasks", 0U);
+  EXPECT_EQ(0U, scheduler.GetThreadCount());
+  int count = 0;
+  TaskScheduler::TaskGroup group;
+  scheduler.Submit([&count]() { ++count; }, &group);
+  EXPECT_EQ(0, count);
+  EXPECT_FALSE(group.IsDone());
+  scheduler.Wait(&group);
+  EXPECT_EQ(1, count);
+
+  // The destructor runs tasks that nobody waited for.
+  {
+    TaskScheduler scheduler2("tasks", 0U);
+    scheduler2.Submit([&count]() { ++count; }, NULL);
+  }
+  EXPECT_EQ(2, count);
+}
+
+TEST(TaskSchedulerTest, Dependencies) {
+  TaskScheduler scheduler("tasks", 2U);
+  std::atomic<int> first_count(0);
+  std::atomic<int> seen_by_second(-1);
+  TaskScheduler::TaskGroup first;
+  for (int i = 0; i < 20; ++i)
+    scheduler.Submit([&first_count]() { ++first_count; }, &first);
+  TaskScheduler::TaskGroup second;
+  scheduler.SubmitAfter(&first, [&first_count, &seen_by_second]() {
+    seen_by_second = first_count.load();
+  }, &second);
+  // Waiting on the second group also waits for the first.
+  EXPECT_FALSE(second.IsDone());
+  scheduler.Wait(&second);
+  EXPECT_TRUE(first.IsDone());
+  EXPECT_EQ(20, seen_by_second.load());
+
+  // A dependency that is already done runs the task right away.
+  scheduler.SubmitAfter(&first, [&seen_by_second]() { seen_by_second = 0; },
+                        &second);
+  scheduler.Wait(&second);
+  EXPECT_EQ(0, seen_by_second.load());
+}
+
+TEST(TaskSchedulerTest, ParallelFor) {
+  TaskScheduler scheduler("tasks", 4U);
+  std::vector<int> values(1000, 0);
+  std::atomic<int> range_count(0);
+  scheduler.ParallelFor(0U, values.size(), 64U,
+                        [&values, &range_count](size_t begin, size_t end) {
+    EXPECT_LE(end - begin, 64U);
+    for (size_t i = begin; i < end; ++i)
+      values[i] += static_cast<int>(i);
+    ++range_count;
+  });
+  EXPECT_EQ(16, range_count.load());
+  for (size_t i = 0; i < values.size(); ++i)
+    EXPECT_EQ(static_cast<int>(i), values[i]);
+
+  // A grain size of 0 picks one.
+  range_count = 0;
+  scheduler.ParallelFor(0U, values.size(), 0U,
+                        [&values, &range_count](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      values[i] -= static_cast<int>(i);
+    ++range_count;
+  });
+  EXPECT_EQ(16, range_count.load());
+  for (size_t i = 0; i < values.size(); ++i)
+    EXPECT_EQ(0, values[i]);
+
+  // Empty ranges do nothing.
+  scheduler.ParallelFor(5U, 5U, 1U, [&range_count](size_t, size_t) {
+    ++range_count;
+  });
+  EXPECT_EQ(16, range_count.load());
+}
+
+}  // namespace base
+}  // namespace ion
@@ -17,6 +17,9 @@ limitations under the License.
 
 #include "ion/base/threadlocalobject.h"
 
+#include <memory>
+#include <vector>
+
 #include "base/integral_types.h"
 #include "ion/base/tests/testallocator.h"
 #include "ion/base/threadspawner.h"
@@ -152,5 +155,26 @@ TEST(ThreadLocalObject, NullAllocator) {
   EXPECT_EQ(da, tl.Get());
 }
 
+TEST(ThreadLocalObject, ManyObjects) {
+  // Create more ThreadLocalObjects than there are thread_local slots, so that
+  // some use only the key, and recreate some of them so that their slots are
+  // reused. Every object must keep returning its own instance.
+  static const size_t kCount = 2U * internal::kThreadLocalSlotCount;
+  std::vector<std::unique_ptr<ThreadLocalObject<PerThread>>> objects(kCount);
+  std::vector<int32> ids(kCount);
+  for (int pass = 0; pass < 2; ++pass) {
+    for (size_t i = pass == 0 ? 0U : 1U; i < kCount; i += pass + 1U) {
+      objects[i].reset(new ThreadLocalObject<PerThread>);
+      ids[i] = objects[i]->Get()->GetId();
+    }
+    for (size_t i = 0; i < kCount; ++i) {
+      EXPECT_EQ(ids[i], objects[i]->Get()->GetId());
+      EXPECT_EQ(objects[i]->Get(), objects[i]->Get());
+    }
+  }
+  objects.clear();
+  EXPECT_EQ(0, PerThread::GetInstanceCount());
+}
+
 }  // namespace base
 }  // namespace ion
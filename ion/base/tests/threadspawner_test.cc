@@ -113,6 +113,19 @@ TEST(ThreadSpawner, SpawnStd) {
   }
 }
 
+TEST(ThreadSpawner, SpawnWithOptions) {
+  ThreadCallbackHelper tch;
+  port::ThreadOptions options;
+  options.priority = port::kThreadPriorityLow;
+  {
+    ThreadSpawner ts("Low priority",
+                     std::bind(&ThreadCallbackHelper::Run, &tch), options);
+    EXPECT_EQ("Low priority", ts.GetName());
+    tch.GetBarrier2()->Wait();
+    EXPECT_EQ(tch.GetId(), ts.GetId());
+  }
+}
+
 TEST(ThreadSpawner, Join) {
   // Same as above test, but call Join() before the thread goes away.
   ThreadCallbackHelper tch;
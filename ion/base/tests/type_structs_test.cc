@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/base/type_structs.h"
 
+#include <string>
+
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 struct BaseType {};
@@ -91,3 +93,12 @@ TEST(TypeStructs, HasTrivialDestructor) {
   EXPECT_TRUE(HasTrivialDestructor<DerivedType1>::value);
   EXPECT_FALSE(HasTrivialDestructor<NonTrivialDestructor>::value);
 }
+
+TEST(TypeStructs, IsTriviallyCopyable) {
+  using ion::base::IsTriviallyCopyable;
+  EXPECT_TRUE(IsTriviallyCopyable<int>::value);
+  EXPECT_TRUE(IsTriviallyCopyable<BaseType>::value);
+  EXPECT_TRUE(IsTriviallyCopyable<DerivedType1>::value);
+  EXPECT_FALSE(IsTriviallyCopyable<NonTrivialDestructor>::value);
+  EXPECT_FALSE(IsTriviallyCopyable<std::string>::value);
+}
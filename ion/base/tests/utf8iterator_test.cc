@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/base/utf8iterator.h"
 
+#include <vector>
+
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 namespace ion {
@@ -61,6 +63,24 @@ static void TestInvalidString(const std::string& what, const std::string& s) {
 
   // All invalid strings should result in a character count of 0.
   EXPECT_EQ(0U, it.ComputeCharCount());
+
+  // Decoding the string keeps only the space.
+  std::vector<uint32> code_points;
+  EXPECT_FALSE(Utf8Iterator::Decode(s, &code_points));
+  ASSERT_EQ(1U, code_points.size());
+  EXPECT_EQ(ToUnicode(' '), code_points[0]);
+}
+
+// Returns the Unicode indices of the characters in a valid string, computed
+// with Next().
+static const std::vector<uint32> IterateString(const std::string& s) {
+  std::vector<uint32> code_points;
+  Utf8Iterator it(s);
+  uint32 c;
+  while ((c = it.Next()) != Utf8Iterator::kInvalidCharIndex)
+    code_points.push_back(c);
+  EXPECT_EQ(Utf8Iterator::kEndOfString, it.GetState());
+  return code_points;
 }
 
 }  // anonymous namespace
@@ -161,6 +181,42 @@ TEST(Utf8Iterator, NulInString) {
   EXPECT_EQ(Utf8Iterator::kInvalidCharIndex, it.Next());
 }
 
+TEST(Utf8Iterator, Decode) {
+  std::vector<uint32> code_points(3U, 0U);
+  EXPECT_TRUE(Utf8Iterator::Decode("", &code_points));
+  EXPECT_TRUE(code_points.empty());
+
+  // Long Ascii strings are widened in blocks, with the rest of the string
+  // handled one byte at a time.
+  const std::string ascii = "The quick brown fox jumps over the lazy dog.";
+  EXPECT_TRUE(Utf8Iterator::Decode(ascii, &code_points));
+  ASSERT_EQ(ascii.size(), code_points.size());
+  for (size_t i = 0; i < ascii.size(); ++i)
+    EXPECT_EQ(ToUnicode(ascii[i]), code_points[i]);
+
+  // Multi-byte characters at the start, in the middle of a block, at a block
+  // boundary, and at the end of the string.
+  std::string mixed = "\xc3\xa9";
+  mixed += "abcdefgh\xe2\x82\xa1ijklmnopqrstuvwxyz";
+  mixed.push_back(0);
+  mixed += "0123456789ABCDE\xf0\x9f\x98\x80";
+  mixed += "FGHIJKLMNOPQRSTUVWXYZ\xdf\xbf";
+  EXPECT_TRUE(Utf8Iterator::Decode(mixed, &code_points));
+  EXPECT_EQ(IterateString(mixed), code_points);
+  EXPECT_EQ(Utf8Iterator(mixed).ComputeCharCount(), code_points.size());
+  EXPECT_EQ(0xe9U, code_points[0]);
+  EXPECT_EQ(0x20a1U, code_points[9]);
+  EXPECT_EQ(0x1f600U, code_points[44]);
+  EXPECT_EQ(0x07ffU, code_points.back());
+
+  // Decoding stops at an invalid byte found inside a block.
+  std::string invalid = ascii;
+  invalid[20] = '\x80';
+  EXPECT_FALSE(Utf8Iterator::Decode(invalid, &code_points));
+  ASSERT_EQ(20U, code_points.size());
+  EXPECT_EQ(ToUnicode('f'), code_points[16]);
+}
+
 TEST(Utf8Iterator, Invalid) {
   TestInvalidString("Continuation byte as 1st byte",
                     " \x80  ");
@@ -391,6 +391,50 @@ TEST(Variant, CopyAndAssign) {
   EXPECT_EQ(2, v5.GetValueAt<int>(1));
 }
 
+TEST(Variant, CopyTrivialAndNonTrivialTypes) {
+  typedef Variant<int, BaseType, RefTypePtr> TestVariant;
+  RefType::ClearNumDeletions();
+  TestVariant scalar;
+  BaseType b;
+  b.x = 21;
+  scalar.Set(b);
+
+  // Copying a trivially copyable value over a ReferentPtr releases it.
+  {
+    TestVariant v;
+    v.Set(RefTypePtr(new RefType));
+    v = scalar;
+    EXPECT_EQ(1U, RefType::GetNumDeletions());
+    EXPECT_TRUE(v.Is<BaseType>());
+    EXPECT_EQ(21, v.Get<BaseType>().x);
+
+    // Copying a ReferentPtr over a trivially copyable value adds a reference.
+    RefTypePtr ptr(new RefType);
+    TestVariant v2;
+    v2.Set(ptr);
+    v = v2;
+    EXPECT_EQ(3, ptr->GetRefCount());
+    v = scalar;
+    EXPECT_EQ(2, ptr->GetRefCount());
+  }
+  EXPECT_EQ(2U, RefType::GetNumDeletions());
+  RefType::ClearNumDeletions();
+
+  // Arrays of trivially copyable values are copied as a block.
+  TestVariant array;
+  array.InitArray<BaseType>(ion::base::AllocatorPtr(), 3);
+  for (int i = 0; i < 3; ++i) {
+    b.x = i + 10;
+    array.SetValueAt(i, b);
+  }
+  TestVariant copy(array);
+  EXPECT_TRUE(copy.IsArrayOf<BaseType>());
+  for (int i = 0; i < 3; ++i)
+    EXPECT_EQ(i + 10, copy.GetValueAt<BaseType>(i).x);
+  copy = scalar;
+  EXPECT_EQ(21, copy.Get<BaseType>().x);
+}
+
 TEST(Variant, Referent) {
   // Verify that a ReferentPtr can be stored in a Variant with no ill effects.
   typedef Variant<int, RefTypePtr, StructWithReferentPtr> TestVariant;
@@ -148,6 +148,29 @@ TEST(WorkerPoolTest, SuspendWithNoWorkToDo) {
   pool.Suspend();
 }
 
+// Verify that threads started with scheduling options still do work.
+TEST(WorkerPoolTest, ThreadOptions) {
+  TestWorker worker;
+  WorkerPool pool(&worker);
+  worker.SetWorkSemaphore(pool.GetWorkSemaphore());
+  EXPECT_EQ(port::kThreadPriorityNormal, pool.GetThreadOptions().priority);
+
+  port::ThreadOptions options;
+  options.priority = port::kThreadPriorityLow;
+  options.core_type = port::kEfficiencyCores;
+  pool.SetThreadOptions(options);
+  EXPECT_EQ(port::kThreadPriorityLow, pool.GetThreadOptions().priority);
+  EXPECT_EQ(port::kEfficiencyCores, pool.GetThreadOptions().core_type);
+
+  pool.ResizeThreadPool(2);
+  pool.Resume();
+  worker.AddWork();
+  worker.WaitUntilDoneWithBarriers();
+  EXPECT_EQ(1, worker.GetTotalWorkCount());
+  pool.Suspend();
+  pool.ResizeThreadPool(0);
+}
+
 // Verify that growing the number of threads in the pool allows more work
 // to be done simultaneously.
 TEST(WorkerPoolTest, GrowThreadPool) {
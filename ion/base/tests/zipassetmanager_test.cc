@@ -18,9 +18,12 @@ limitations under the License.
 #include "ion/base/zipassetmanager.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <string>
+#include <vector>
 
+#include "base/integral_types.h"
 #include "ion/base/invalid.h"
 #include "ion/base/logchecker.h"
 #include "ion/base/logging.h"
@@ -31,6 +34,7 @@ limitations under the License.
 #include "ion/port/timer.h"
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
+#include "third_party/zlib/src/zlib.h"
 
 ION_REGISTER_ASSETS(ZipAssetTest);
 
@@ -50,6 +54,67 @@ static const std::string GetFileContents(const std::string& filename) {
   return buffer;
 }
 
+// Appends a little-endian value of |size| bytes to |data|.
+static void AppendValue(uint32 value, size_t size, std::string* data) {
+  for (size_t i = 0; i < size; ++i)
+    data->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+// Returns zip data containing the passed file stored without compression.
+static const std::string BuildStoredZip(const std::string& filename,
+                                        const std::string& contents) {
+  const uint32 crc = static_cast<uint32>(crc32(
+      0, reinterpret_cast<const Bytef*>(contents.data()),
+      static_cast<uInt>(contents.size())));
+  const uint32 size = static_cast<uint32>(contents.size());
+  const uint32 name_length = static_cast<uint32>(filename.size());
+
+  std::string zip;
+  AppendValue(0x04034b50, 4, &zip);  // Local header signature.
+  AppendValue(10, 2, &zip);          // Version needed.
+  AppendValue(0, 2, &zip);           // Flags.
+  AppendValue(0, 2, &zip);           // Stored.
+  AppendValue(0, 4, &zip);           // Time and date.
+  AppendValue(crc, 4, &zip);
+  AppendValue(size, 4, &zip);
+  AppendValue(size, 4, &zip);
+  AppendValue(name_length, 2, &zip);
+  AppendValue(0, 2, &zip);  // Extra field length.
+  zip += filename + contents;
+
+  const uint32 directory_offset = static_cast<uint32>(zip.size());
+  AppendValue(0x02014b50, 4, &zip);  // Central directory signature.
+  AppendValue(10, 2, &zip);          // Version made by.
+  AppendValue(10, 2, &zip);          // Version needed.
+  AppendValue(0, 2, &zip);           // Flags.
+  AppendValue(0, 2, &zip);           // Stored.
+  AppendValue(0, 4, &zip);           // Time and date.
+  AppendValue(crc, 4, &zip);
+  AppendValue(size, 4, &zip);
+  AppendValue(size, 4, &zip);
+  AppendValue(name_length, 2, &zip);
+  AppendValue(0, 2, &zip);  // Extra field length.
+  AppendValue(0, 2, &zip);  // Comment length.
+  AppendValue(0, 2, &zip);  // Disk number.
+  AppendValue(0, 2, &zip);  // Internal attributes.
+  AppendValue(0, 4, &zip);  // External attributes.
+  AppendValue(0, 4, &zip);  // Local header offset.
+  zip += filename;
+  const uint32 directory_size =
+      static_cast<uint32>(zip.size()) - directory_offset;
+
+  AppendValue(0x06054b50, 4, &zip);  // End of central directory signature.
+  AppendValue(0, 4, &zip);           // Disk numbers.
+  AppendValue(1, 2, &zip);           // Entries on this disk.
+  AppendValue(1, 2, &zip);           // Total entries.
+  AppendValue(directory_size, 4, &zip);
+  AppendValue(directory_offset, 4, &zip);
+  AppendValue(0, 2, &zip);  // Comment length.
+  // Asset data is padded after the zip.
+  zip.append(3, '\0');
+  return zip;
+}
+
 }  // anonymous namespace
 
 TEST(ZipAssetManager, InvalidData) {
@@ -286,6 +351,145 @@ TEST(ZipAssetManager, GetRegisteredFileNames) {
   EXPECT_EQ(empty_list, ZipAssetManager::GetRegisteredFileNames());
 }
 
+TEST(ZipAssetManager, GetFileView) {
+  ZipAssetTest::RegisterAssets();
+  const std::string f1_data("This is\nFile 1");
+  const std::string f2_data("This is\nFile\n2");
+
+  ZipAssetManager::FileView view =
+      ZipAssetManager::GetFileView("zipasset_file1.txt");
+  EXPECT_TRUE(view.IsValid());
+  EXPECT_EQ(f1_data, view.ToString());
+  EXPECT_EQ(f2_data, ZipAssetManager::GetFileView("path/file2.txt").ToString());
+  // Views do not fill the cache of GetFileData().
+  EXPECT_FALSE(ZipAssetManager::IsFileCached("zipasset_file1.txt"));
+  EXPECT_EQ(f1_data, ZipAssetManager::GetFileData("zipasset_file1.txt"));
+
+  // Decompressed data is cached.
+  EXPECT_LT(0U, ZipAssetManager::GetDecompressedCacheSize());
+  EXPECT_EQ(view.GetData(),
+            ZipAssetManager::GetFileView("zipasset_file1.txt").GetData());
+
+  // The manifest is not a registered file.
+  EXPECT_FALSE(ZipAssetManager::GetFileView("does_not_exist").IsValid());
+  EXPECT_FALSE(
+      ZipAssetManager::GetFileView("__asset_manifest__.txt").IsValid());
+  EXPECT_TRUE(ZipAssetManager::GetFileView("does_not_exist").ToString()
+                  .empty());
+
+  // Views return changed data, while existing views keep the old data.
+  const std::string new_data("This is some new data for file 1.");
+  EXPECT_TRUE(ZipAssetManager::SetFileData("zipasset_file1.txt", new_data));
+  EXPECT_EQ(new_data,
+            ZipAssetManager::GetFileView("zipasset_file1.txt").ToString());
+  EXPECT_EQ(f1_data, view.ToString());
+  EXPECT_EQ(f2_data, ZipAssetManager::GetFileView("path/file2.txt").ToString());
+
+  // Registering the file again replaces the changed data.
+  ZipAssetTest::RegisterAssets();
+  EXPECT_EQ(f1_data,
+            ZipAssetManager::GetFileView("zipasset_file1.txt").ToString());
+
+  ZipAssetManager::Reset();
+  EXPECT_FALSE(ZipAssetManager::GetFileView("zipasset_file1.txt").IsValid());
+  EXPECT_EQ(0U, ZipAssetManager::GetDecompressedCacheSize());
+  // Views remain valid after the manager is reset.
+  EXPECT_EQ(f1_data, view.ToString());
+}
+
+TEST(ZipAssetManager, GetFileViewOfStoredFile) {
+  const std::string contents("Stored without compression");
+  const std::string zip = BuildStoredZip("stored.txt", contents);
+  EXPECT_TRUE(ZipAssetManager::RegisterAssetData(zip.data(), zip.size()));
+  EXPECT_TRUE(ZipAssetManager::ContainsFile("stored.txt"));
+  EXPECT_EQ(contents, ZipAssetManager::GetFileData("stored.txt"));
+
+  // The view points into the registered data.
+  const ZipAssetManager::FileView view =
+      ZipAssetManager::GetFileView("stored.txt");
+  EXPECT_EQ(contents.size(), view.GetSize());
+  EXPECT_EQ(zip.data() + zip.find(contents), view.GetData());
+  EXPECT_EQ(0U, ZipAssetManager::GetDecompressedCacheSize());
+  ZipAssetManager::Reset();
+}
+
+TEST(ZipAssetManager, DecompressedCacheBudget) {
+  const size_t default_budget = ZipAssetManager::GetDecompressedCacheBudget();
+  MemoryZipStream zipstream;
+  const std::string data1(4096, 'a');
+  const std::string data2(4096, 'b');
+  zipstream.AddFile("file1.txt", data1);
+  zipstream.AddFile("file2.txt", data2);
+  ZipAssetManager::RegisterAssetData(zipstream.GetData().data(),
+                                     zipstream.GetData().size());
+
+  EXPECT_EQ(data1, ZipAssetManager::GetFileView("file1.txt").ToString());
+  EXPECT_EQ(data2, ZipAssetManager::GetFileView("file2.txt").ToString());
+  EXPECT_EQ(8192U, ZipAssetManager::GetDecompressedCacheSize());
+
+  // Lowering the budget evicts data, but views remain valid.
+  const ZipAssetManager::FileView view =
+      ZipAssetManager::GetFileView("file1.txt");
+  ZipAssetManager::SetDecompressedCacheBudget(0U);
+  EXPECT_EQ(0U, ZipAssetManager::GetDecompressedCacheBudget());
+  EXPECT_EQ(0U, ZipAssetManager::GetDecompressedCacheSize());
+  EXPECT_EQ(data1, view.ToString());
+
+  // Files that do not fit are decompressed for each view.
+  EXPECT_EQ(data2, ZipAssetManager::GetFileView("file2.txt").ToString());
+  EXPECT_EQ(0U, ZipAssetManager::GetDecompressedCacheSize());
+
+  ZipAssetManager::SetDecompressedCacheBudget(default_budget);
+  ZipAssetManager::Reset();
+}
+
+TEST(ZipAssetManager, PrefetchFiles) {
+  ZipAssetTest::RegisterAssets();
+  const std::string contents("Stored without compression");
+  const std::string zip = BuildStoredZip("stored.txt", contents);
+  EXPECT_TRUE(ZipAssetManager::RegisterAssetData(zip.data(), zip.size()));
+
+  std::vector<std::string> filenames;
+  filenames.push_back("zipasset_file1.txt");
+  filenames.push_back("dir/file2.txt");
+  filenames.push_back("stored.txt");
+  filenames.push_back("does_not_exist");
+  std::atomic<int> found_count(0);
+  std::atomic<int> missing_count(0);
+  ZipAssetManager::PrefetchPtr prefetch = ZipAssetManager::PrefetchFiles(
+      filenames, [&](const std::string& filename, bool found) {
+        ++(found ? found_count : missing_count);
+      });
+  prefetch->Wait();
+  EXPECT_TRUE(prefetch->IsDone());
+  EXPECT_EQ(3, found_count.load());
+  EXPECT_EQ(1, missing_count.load());
+
+  // The files are cached for GetFileData().
+  EXPECT_TRUE(ZipAssetManager::IsFileCached("zipasset_file1.txt"));
+  EXPECT_TRUE(ZipAssetManager::IsFileCached("dir/file2.txt"));
+  EXPECT_TRUE(ZipAssetManager::IsFileCached("stored.txt"));
+  EXPECT_FALSE(ZipAssetManager::IsFileCached("dir/file1.txt"));
+  EXPECT_EQ("This is\nFile 1",
+            ZipAssetManager::GetFileData("zipasset_file1.txt"));
+  EXPECT_EQ("This is\nFile\n2", ZipAssetManager::GetFileData("dir/file2.txt"));
+  EXPECT_EQ(contents, ZipAssetManager::GetFileData("stored.txt"));
+
+  // Prefetching does not replace data that was set.
+  EXPECT_TRUE(ZipAssetManager::SetFileData("zipasset_file1.txt", "new data"));
+  ZipAssetManager::SetPrefetchThreadCount(1U);
+  ZipAssetManager::PrefetchFiles(filenames, nullptr)->Wait();
+  EXPECT_EQ("new data", ZipAssetManager::GetFileData("zipasset_file1.txt"));
+  ZipAssetManager::SetPrefetchThreadCount(2U);
+
+  // An empty prefetch is done immediately.
+  prefetch =
+      ZipAssetManager::PrefetchFiles(std::vector<std::string>(), nullptr);
+  EXPECT_TRUE(prefetch->IsDone());
+  prefetch->Wait();
+  ZipAssetManager::Reset();
+}
+
 #if ION_DEBUG
 TEST(ZipAssetManager, DuplicateRegister) {
   LogChecker checker;
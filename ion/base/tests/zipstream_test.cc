@@ -0,0 +1,222 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/zipstream.h"
+
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/base/memoryzipstream.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// Returns a sink that appends to archive.
+static const ZipStreamWriter::Sink BuildSink(std::string* archive) {
+  return [archive](const uint8* data, size_t size) {
+    archive->append(reinterpret_cast<const char*>(data), size);
+    return true;
+  };
+}
+
+// Returns a source that reads archive in chunks of at most chunk_size bytes,
+// to exercise records that straddle reads.
+static const ZipStreamReader::Source BuildSource(const std::string& archive,
+                                                 size_t chunk_size) {
+  std::shared_ptr<size_t> position(new size_t(0U));
+  return [archive, chunk_size, position](uint8* data, size_t size) {
+    const size_t count =
+        std::min(std::min(size, chunk_size), archive.size() - *position);
+    memcpy(data, archive.data() + *position, count);
+    *position += count;
+    return count;
+  };
+}
+
+// Returns size bytes of compressible data that differs between blocks.
+static const std::string BuildData(size_t size) {
+  std::string data(size, '\0');
+  uint32 value = 1U;
+  for (size_t i = 0; i < size; ++i) {
+    value = value * 1103515245U + 12345U;
+    data[i] = static_cast<char>('a' + ((value >> 16) % 8U));
+  }
+  return data;
+}
+
+}  // anonymous namespace
+
+TEST(ZipStream, WriteAndRead) {
+  base::LogChecker log_checker;
+  std::vector<std::pair<std::string, std::string>> files;
+  files.push_back(std::make_pair("small.txt", std::string("Some file data")));
+  files.push_back(std::make_pair("empty.txt", std::string()));
+  files.push_back(std::make_pair("dir/block.bin",
+                                 BuildData(ZipStreamWriter::kBlockSize)));
+  files.push_back(std::make_pair(
+      "dir/large.bin", BuildData(ZipStreamWriter::kBlockSize * 5U + 123U)));
+
+  std::string archives[2];
+  for (size_t thread_count = 0; thread_count < 2U; ++thread_count) {
+    SCOPED_TRACE(thread_count);
+    std::string& archive = archives[thread_count];
+    ZipStreamWriter writer(BuildSink(&archive), thread_count * 4U);
+    for (size_t i = 0; i < files.size(); ++i) {
+      // Write the files in uneven pieces.
+      const std::string& data = files[i].second;
+      EXPECT_TRUE(writer.BeginFile(files[i].first));
+      for (size_t pos = 0; pos < data.size(); pos += 1000U) {
+        EXPECT_TRUE(writer.Write(data.data() + pos,
+                                 std::min(data.size() - pos, size_t(1000U))));
+      }
+      EXPECT_TRUE(writer.EndFile());
+    }
+    EXPECT_TRUE(writer.Finish());
+    EXPECT_EQ(archive.size(), writer.GetBytesWritten());
+    // The data compresses.
+    EXPECT_LT(archive.size(), files.back().second.size());
+
+    ZipStreamReader reader(BuildSource(archive, 1000U));
+    for (size_t i = 0; i < files.size(); ++i) {
+      EXPECT_TRUE(reader.NextFile());
+      EXPECT_EQ(files[i].first, reader.GetFilename());
+      std::string data;
+      EXPECT_TRUE(reader.ReadFile(&data));
+      EXPECT_TRUE(data == files[i].second);
+    }
+    EXPECT_FALSE(reader.NextFile());
+    EXPECT_FALSE(reader.HasError());
+
+    // Skipping files leaves the reader in the right place.
+    ZipStreamReader skipping_reader(BuildSource(archive, archive.size()));
+    EXPECT_TRUE(skipping_reader.NextFile());
+    EXPECT_TRUE(skipping_reader.NextFile());
+    EXPECT_TRUE(skipping_reader.NextFile());
+    uint8 byte = 0;
+    EXPECT_EQ(1U, skipping_reader.Read(&byte, 1U));
+    EXPECT_EQ(static_cast<uint8>(files[2].second[0]), byte);
+    EXPECT_TRUE(skipping_reader.NextFile());
+    EXPECT_EQ("dir/large.bin", skipping_reader.GetFilename());
+    EXPECT_FALSE(skipping_reader.NextFile());
+    EXPECT_FALSE(skipping_reader.HasError());
+
+    // The archive can be read through the central directory as well.
+    MemoryZipStream::DataVector vec(AllocatorPtr(), archive.begin(),
+                                    archive.end());
+    MemoryZipStream stream(&vec);
+    for (size_t i = 0; i < files.size(); ++i) {
+      const MemoryZipStream::DataVector data =
+          stream.GetFileData(files[i].first);
+      EXPECT_TRUE(std::string(data.begin(), data.end()) == files[i].second);
+    }
+  }
+  // Compressing on threads produces the same archive.
+  EXPECT_TRUE(archives[0] == archives[1]);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(ZipStream, ReadMemoryZipStream) {
+  base::LogChecker log_checker;
+  MemoryZipStream stream;
+  stream.AddFile("foo.txt", "Some file\ndata\n\nin a string.");
+  stream.AddFile("bar/baz.txt", BuildData(100000U));
+  const MemoryZipStream::DataVector& vec = stream.GetData();
+  const std::string archive(vec.begin(), vec.end());
+
+  ZipStreamReader reader(BuildSource(archive, 333U));
+  std::string data;
+  EXPECT_TRUE(reader.NextFile());
+  EXPECT_EQ("foo.txt", reader.GetFilename());
+  EXPECT_TRUE(reader.ReadFile(&data));
+  EXPECT_EQ("Some file\ndata\n\nin a string.", data);
+  EXPECT_TRUE(reader.NextFile());
+  EXPECT_EQ("bar/baz.txt", reader.GetFilename());
+  EXPECT_TRUE(reader.ReadFile(&data));
+  EXPECT_TRUE(data == BuildData(100000U));
+  EXPECT_FALSE(reader.NextFile());
+  EXPECT_FALSE(reader.HasError());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(ZipStream, Errors) {
+  base::LogChecker log_checker;
+  std::string archive;
+  {
+    ZipStreamWriter writer(BuildSink(&archive), 2U);
+    EXPECT_FALSE(writer.Write("abc", 3U));
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "without a file"));
+    EXPECT_FALSE(writer.EndFile());
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "without a file"));
+    EXPECT_FALSE(writer.BeginFile(""));
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid filename"));
+  }
+  {
+    archive.clear();
+    ZipStreamWriter writer(BuildSink(&archive), 2U);
+    EXPECT_TRUE(writer.AddFile("a.txt", BuildData(1000U)));
+    EXPECT_TRUE(writer.Finish());
+    EXPECT_FALSE(writer.BeginFile("b.txt"));
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "after Finish"));
+  }
+  {
+    // The sink fails.
+    ZipStreamWriter writer(
+        [](const uint8* data, size_t size) { return false; }, 0U);
+    EXPECT_FALSE(writer.BeginFile("a.txt"));
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "failed to write"));
+    EXPECT_FALSE(writer.Finish());
+  }
+
+  // Nothing to read.
+  ZipStreamReader empty_reader(BuildSource("", 10U));
+  EXPECT_FALSE(empty_reader.NextFile());
+  EXPECT_FALSE(empty_reader.HasError());
+
+  ZipStreamReader garbage_reader(BuildSource("This is not a zip file", 10U));
+  EXPECT_FALSE(garbage_reader.NextFile());
+  EXPECT_TRUE(garbage_reader.HasError());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid local file header"));
+
+  // Corrupt the data.
+  std::string corrupt = archive;
+  corrupt[40] = static_cast<char>(corrupt[40] ^ 0x55);
+  ZipStreamReader corrupt_reader(BuildSource(corrupt, corrupt.size()));
+  std::string data;
+  EXPECT_TRUE(corrupt_reader.NextFile());
+  EXPECT_FALSE(corrupt_reader.ReadFile(&data));
+  EXPECT_TRUE(corrupt_reader.HasError());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "ZipStreamReader"));
+
+  // Truncate the data.
+  ZipStreamReader truncated_reader(
+      BuildSource(archive.substr(0U, archive.size() / 2U), 100U));
+  EXPECT_TRUE(truncated_reader.NextFile());
+  EXPECT_FALSE(truncated_reader.ReadFile(&data));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "truncated"));
+}
+
+}  // namespace base
+}  // namespace ion
@@ -0,0 +1,63 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/threadlocalobject.h"
+
+#include <atomic>
+
+namespace ion {
+namespace base {
+namespace internal {
+
+namespace {
+
+static_assert(kThreadLocalSlotCount == 64U,
+              "The free slots must fit in a 64-bit mask");
+
+// A mask of the slots that are not owned by a ThreadLocalObject, and the next
+// generation number. These are plain atomics rather than safe statics so that
+// ThreadLocalObjects can be destroyed at any point during static destruction.
+static std::atomic<uint64> s_free_slot_mask(~static_cast<uint64>(0));
+static std::atomic<uint64> s_next_generation(1U);
+
+}  // anonymous namespace
+
+size_t AcquireThreadLocalSlot(uint64* generation) {
+  *generation = 0U;
+#if ION_HAS_NATIVE_THREAD_LOCAL
+  uint64 mask = s_free_slot_mask.load(std::memory_order_relaxed);
+  while (mask) {
+    size_t slot = 0U;
+    while (!(mask & (static_cast<uint64>(1) << slot)))
+      ++slot;
+    const uint64 claimed = mask & ~(static_cast<uint64>(1) << slot);
+    if (s_free_slot_mask.compare_exchange_weak(mask, claimed)) {
+      *generation = s_next_generation++;
+      return slot;
+    }
+  }
+#endif
+  return kInvalidThreadLocalSlot;
+}
+
+void ReleaseThreadLocalSlot(size_t slot) {
+  s_free_slot_mask |= static_cast<uint64>(1) << slot;
+}
+
+}  // namespace internal
+}  // namespace base
+}  // namespace ion
@@ -20,16 +20,50 @@ limitations under the License.
 
 #include <vector>
 
+#include "base/integral_types.h"
 #include "ion/base/allocatable.h"
 #include "ion/base/allocator.h"
 #include "ion/base/lockguards.h"
 #include "ion/base/type_structs.h"
+#include "ion/port/macros.h"
 #include "ion/port/mutex.h"
 #include "ion/port/threadutils.h"
 
 namespace ion {
 namespace base {
 
+namespace internal {
+
+// Native thread_local storage for the instances of ThreadLocalObjects. Each
+// ThreadLocalObject acquires one of kThreadLocalSlotCount slots, which is
+// shared by all threads, together with a generation number that is unique over
+// the lifetime of the program. A thread's entry in the slot is valid only if it
+// holds the generation of the slot's current owner, so entries left behind by
+// destroyed ThreadLocalObjects are never returned.
+struct ThreadLocalSlot {
+  uint64 generation;
+  void* instance;
+};
+static const size_t kThreadLocalSlotCount = 64U;
+static const size_t kInvalidThreadLocalSlot = static_cast<size_t>(-1);
+
+// Returns a free slot and sets generation to a new generation number, or
+// returns kInvalidThreadLocalSlot if all slots are in use.
+ION_API size_t AcquireThreadLocalSlot(uint64* generation);
+// Returns a slot returned by AcquireThreadLocalSlot() to the free slots.
+ION_API void ReleaseThreadLocalSlot(size_t slot);
+
+#if ION_HAS_NATIVE_THREAD_LOCAL
+// Returns the calling thread's slots. The array is zero-initialized, and
+// generation numbers are never zero.
+inline ThreadLocalSlot* GetThreadLocalSlots() {
+  static thread_local ThreadLocalSlot slots[kThreadLocalSlotCount];
+  return slots;
+}
+#endif
+
+}  // namespace internal
+
 // This templated class makes it easy to create an instance of an object in
 // thread-local storage. It obtains and manages a TLS key that can be used in
 // all threads and sets the TLS pointer in each thread to the object using that
@@ -68,17 +102,25 @@ namespace base {
 //     return s_helper->Get();
 //   }
 //
+// Where the toolchain supports C++11 thread_local variables (see
+// ION_HAS_NATIVE_THREAD_LOCAL), Get() first looks up the instance in a
+// thread_local slot, which is a single load and compare rather than a call
+// into the TLS key functions. Only the first call on each thread, and calls on
+// ThreadLocalObjects that did not get one of the limited number of slots, use
+// the key.
 template <typename T> class ThreadLocalObject {
  public:
   // The default constructor will use global operator new() to construct T
   // instances.
   ThreadLocalObject()
-      : key_(port::CreateThreadLocalStorageKey()) {}
+      : key_(port::CreateThreadLocalStorageKey()),
+        slot_(internal::AcquireThreadLocalSlot(&generation_)) {}
 
   // This constructor uses the given Allocator to construct T instances. This
   // will compile only if T is derived from Allocatable.
   explicit ThreadLocalObject(const AllocatorPtr& allocator)
       : key_(port::CreateThreadLocalStorageKey()),
+        slot_(internal::AcquireThreadLocalSlot(&generation_)),
         allocator_(allocator) {}
 
   ~ThreadLocalObject() {
@@ -87,6 +129,8 @@ template <typename T> class ThreadLocalObject {
     // Delete the key, which also invalidates all thread-local storage pointers
     // associated with it.
     port::DeleteThreadLocalStorageKey(key_);
+    if (slot_ != internal::kInvalidThreadLocalSlot)
+      internal::ReleaseThreadLocalSlot(slot_);
   }
 
   // Returns the ThreadLocalStorageKey created by the instance. This will be
@@ -97,10 +141,25 @@ template <typename T> class ThreadLocalObject {
   // necessary. All subsequent calls on the same thread will return the same
   // instance.
   T* Get() {
-    if (void* ptr = port::GetThreadLocalStorage(key_))
-      return static_cast<T*>(ptr);
-    else
-      return CreateAndStoreInstance();
+#if ION_HAS_NATIVE_THREAD_LOCAL
+    if (slot_ != internal::kInvalidThreadLocalSlot) {
+      const internal::ThreadLocalSlot& slot =
+          internal::GetThreadLocalSlots()[slot_];
+      if (slot.generation == generation_)
+        return static_cast<T*>(slot.instance);
+    }
+#endif
+    T* instance = static_cast<T*>(port::GetThreadLocalStorage(key_));
+    if (!instance)
+      instance = CreateAndStoreInstance();
+#if ION_HAS_NATIVE_THREAD_LOCAL
+    if (instance && slot_ != internal::kInvalidThreadLocalSlot) {
+      internal::ThreadLocalSlot& slot = internal::GetThreadLocalSlots()[slot_];
+      slot.generation = generation_;
+      slot.instance = instance;
+    }
+#endif
+    return instance;
   }
 
  private:
@@ -149,6 +208,10 @@ template <typename T> class ThreadLocalObject {
 
   // Key used to associate the storage with all threads.
   port::ThreadLocalStorageKey key_;
+  // The thread_local slot caching the instances, or kInvalidThreadLocalSlot,
+  // and the generation number identifying this as its owner.
+  uint64 generation_;
+  size_t slot_;
   // Allocator used to create instances (if T is derived from Allocatable).
   AllocatorPtr allocator_;
   // Vector of all T instances created by this.
@@ -32,6 +32,15 @@ static bool NamingThreadFunc(const std::string& name,
   return user_func();
 }
 
+// Like NamingThreadFunc(), but also applies scheduling options, which likewise
+// only apply to the current thread.
+static bool SchedulingThreadFunc(const std::string& name,
+                                 const port::ThreadOptions& options,
+                                 const port::ThreadStdFunc& user_func) {
+  port::SetThreadOptions(options);
+  return NamingThreadFunc(name, user_func);
+}
+
 }  // anonymous namespace
 
 ThreadSpawner::ThreadSpawner(const std::string& name,
@@ -50,6 +59,14 @@ ThreadSpawner::ThreadSpawner(const std::string& name,
       id_(Spawn()) {
 }
 
+ThreadSpawner::ThreadSpawner(const std::string& name,
+                             const port::ThreadStdFunc& func,
+                             const port::ThreadOptions& options)
+    : name_(name),
+      func_(std::bind(SchedulingThreadFunc, name, options, func)),
+      id_(Spawn()) {
+}
+
 ThreadSpawner::~ThreadSpawner() {
   Join();
 }
@@ -33,6 +33,10 @@ class ThreadSpawner {
   // is given the specified name if thread naming is supported.
   ThreadSpawner(const std::string& name, port::ThreadFuncPtr func_ptr);
   ThreadSpawner(const std::string& name, const port::ThreadStdFunc& func);
+  // Creates a ThreadSpawner instance whose thread applies the passed scheduling
+  // options before it runs the function.
+  ThreadSpawner(const std::string& name, const port::ThreadStdFunc& func,
+                const port::ThreadOptions& options);
 
   // The destructor calls Join() to wait for the thread to finish.
   ~ThreadSpawner();
@@ -86,6 +86,18 @@ template <typename T> struct HasTrivialDestructor {
 template <typename T>
 const bool HasTrivialDestructor<T>::value;
 
+// IsTriviallyCopyable is similar to std::is_trivially_copyable: its value is
+// true if instances of T can be copied with memcpy() and destroyed without
+// running any code. Like HasTrivialDestructor it uses builtins, since not all
+// STL implementations provide the standard trait.
+template <typename T> struct IsTriviallyCopyable {
+  static const bool value =
+      __has_trivial_copy(T) && __has_trivial_assign(T) &&
+      __has_trivial_destructor(T);
+};
+template <typename T>
+const bool IsTriviallyCopyable<T>::value;
+
 }  // namespace base
 }  // namespace ion
 
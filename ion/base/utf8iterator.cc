@@ -17,6 +17,16 @@ limitations under the License.
 
 #include "ion/base/utf8iterator.h"
 
+#include "ion/base/logging.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define ION_UTF8_ITERATOR_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define ION_UTF8_ITERATOR_NEON 1
+#endif
+
 namespace ion {
 namespace base {
 
@@ -73,6 +83,85 @@ static uint32 Compute4ByteUnicode(uint8 byte1, uint8 byte2,
       static_cast<uint32>(byte4 & 0x3f);
 }
 
+// The maximum valid Unicode index.
+static const uint32 kMaxValidIndex = 0x10ffff;
+
+// Decodes the multi-byte sequence at the start of the count bytes in bytes,
+// storing its Unicode index in code_point. Returns the length of the sequence,
+// or 0 if it is invalid or truncated.
+static size_t DecodeSequence(const uint8* bytes, size_t count,
+                             uint32* code_point) {
+  const uint8 byte1 = bytes[0];
+  if (Is2ByteSequence(byte1)) {
+    if (count >= 2U && IsContinuationByte(bytes[1])) {
+      *code_point = Compute2ByteUnicode(byte1, bytes[1]);
+      return 2U;
+    }
+  } else if (Is3ByteSequence(byte1)) {
+    if (count >= 3U && IsContinuationByte(bytes[1]) &&
+        IsContinuationByte(bytes[2])) {
+      *code_point = Compute3ByteUnicode(byte1, bytes[1], bytes[2]);
+      return 3U;
+    }
+  } else if (Is4ByteSequence(byte1)) {
+    if (count >= 4U && IsContinuationByte(bytes[1]) &&
+        IsContinuationByte(bytes[2]) && IsContinuationByte(bytes[3])) {
+      *code_point = Compute4ByteUnicode(byte1, bytes[1], bytes[2], bytes[3]);
+      if (*code_point <= kMaxValidIndex)
+        return 4U;
+    }
+  }
+  return 0U;
+}
+
+// Widens the run of Ascii bytes at the start of the count bytes in bytes into
+// code_points, which must have room for count values. Returns the length of
+// the run.
+static size_t DecodeAsciiRun(const uint8* bytes, size_t count,
+                             uint32* code_points) {
+  size_t i = 0;
+#if ION_UTF8_ITERATOR_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16U <= count; i += 16U) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    // Stop at any block containing a byte with its high-order bit set.
+    if (_mm_movemask_epi8(v))
+      break;
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128i* out = reinterpret_cast<__m128i*>(code_points + i);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+  }
+#elif ION_UTF8_ITERATOR_NEON
+  for (; i + 16U <= count; i += 16U) {
+    const uint8x16_t v = vld1q_u8(bytes + i);
+    // Stop at any block containing a byte with its high-order bit set.
+#  if defined(__aarch64__)
+    if (vmaxvq_u8(v) & 0x80)
+      break;
+#  else
+    const uint8x8_t any = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    if (vget_lane_u64(vreinterpret_u64_u8(any), 0) & 0x8080808080808080ULL)
+      break;
+#  endif
+    const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    vst1q_u32(code_points + i, vmovl_u16(vget_low_u16(lo)));
+    vst1q_u32(code_points + i + 4U, vmovl_u16(vget_high_u16(lo)));
+    vst1q_u32(code_points + i + 8U, vmovl_u16(vget_low_u16(hi)));
+    vst1q_u32(code_points + i + 12U, vmovl_u16(vget_high_u16(hi)));
+  }
+#endif
+  // Finish the run one byte at a time.
+  for (; i < count && Is1ByteSequence(bytes[i]); ++i)
+    code_points[i] = bytes[i];
+  return i;
+}
+
 }  // anonymous namespace
 
 const uint32 Utf8Iterator::kInvalidCharIndex = 0x110000;
@@ -115,7 +204,6 @@ uint32 Utf8Iterator::Next() {
           IsContinuationByte(byte4))
         unicode_index = Compute4ByteUnicode(byte1, byte2, byte3, byte4);
       // Verify that the index does not exceed the maximum.
-      static const uint32 kMaxValidIndex = 0x10ffff;
       if (unicode_index > kMaxValidIndex)
         unicode_index = kInvalidCharIndex;
     }
@@ -136,6 +224,40 @@ size_t Utf8Iterator::ComputeCharCount() const {
   return it.GetState() == kEndOfString ? count : 0;
 }
 
+bool Utf8Iterator::Decode(const std::string& utf8_string,
+                          std::vector<uint32>* code_points) {
+  DCHECK(code_points);
+  const size_t byte_count = utf8_string.size();
+  // There are never more characters than bytes.
+  code_points->resize(byte_count);
+  if (!byte_count)
+    return true;
+
+  const uint8* bytes = reinterpret_cast<const uint8*>(utf8_string.data());
+  uint32* out = &(*code_points)[0];
+  size_t byte_index = 0;
+  size_t char_count = 0;
+  bool is_valid = true;
+  while (byte_index < byte_count) {
+    const size_t ascii_count = DecodeAsciiRun(
+        bytes + byte_index, byte_count - byte_index, out + char_count);
+    byte_index += ascii_count;
+    char_count += ascii_count;
+    if (byte_index == byte_count)
+      break;
+    const size_t length = DecodeSequence(
+        bytes + byte_index, byte_count - byte_index, out + char_count);
+    if (!length) {
+      is_valid = false;
+      break;
+    }
+    byte_index += length;
+    ++char_count;
+  }
+  code_points->resize(char_count);
+  return is_valid;
+}
+
 uint8 Utf8Iterator::GetNextByte() {
   if (state_ == kInString) {
     const uint8 next_byte = string_[cur_index_];
@@ -19,6 +19,7 @@ limitations under the License.
 #define ION_BASE_UTF8ITERATOR_H_
 
 #include <string>
+#include <vector>
 
 #include "base/integral_types.h"
 
@@ -75,6 +76,15 @@ class ION_API Utf8Iterator {
   // any encoding errors in the string.
   size_t ComputeCharCount() const;
 
+  // Decodes all characters in utf8_string at once, replacing the contents of
+  // code_points with their Unicode indices. This is much faster than calling
+  // Next() for each character, especially for Ascii text, which is widened 16
+  // bytes at a time with SIMD instructions where they are available. Decoding
+  // stops at the first invalid or truncated sequence; the characters before it
+  // are kept and false is returned.
+  static bool Decode(const std::string& utf8_string,
+                     std::vector<uint32>* code_points);
+
  private:
   // Returns the next byte in the string, incrementing cur_index_ and setting
   // the state to kEndOfString if this is the last byte. Sets the state to
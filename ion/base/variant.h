@@ -18,13 +18,16 @@ limitations under the License.
 #ifndef ION_BASE_VARIANT_H_
 #define ION_BASE_VARIANT_H_
 
-#include <cstring>  // For memset().
+#include <cstring>  // For memcpy() and memset().
+
+#include "base/integral_types.h"
 
 #include "ion/base/allocationmanager.h"
 #include "ion/base/allocator.h"
 #include "ion/base/invalid.h"
 #include "ion/base/logging.h"
 #include "ion/base/static_assert.h"
+#include "ion/base/type_structs.h"
 #include "ion/port/align.h"
 
 namespace ion {
@@ -73,10 +76,10 @@ class ManualConstructor {
     Type* array = static_cast<Type*>(allocator->AllocateMemory(size));
     const Type* other_array =
         *reinterpret_cast<const Type*const*>(other.space_);
-    // We can't use a memcpy since some types (e.g., ReferentPtrs) have side
-    // effects on assignment.
-    for (size_t i = 0; i < count; ++i)
-      new(&array[i]) Type(other_array[i]);
+    // Types that are not trivially copyable (e.g., ReferentPtrs) have side
+    // effects on copying, so they can't use a memcpy.
+    CopyArray(array, other_array, count,
+              BoolType<IsTriviallyCopyable<Type>::value>());
     *reinterpret_cast<void**>(space_) = array;
 #if ION_DEBUG
     val_ = static_cast<Type*>(array);
@@ -109,6 +112,19 @@ class ManualConstructor {
   }
 
  private:
+  // Copies count values from other_array into the uninitialized array. The
+  // overload is chosen at compile time, so that memcpy() is only used for
+  // trivially copyable types.
+  static void CopyArray(Type* array, const Type* other_array, size_t count,
+                        BoolType<true>) {
+    memcpy(array, other_array, count * sizeof(Type));
+  }
+  static void CopyArray(Type* array, const Type* other_array, size_t count,
+                        BoolType<false>) {
+    for (size_t i = 0; i < count; ++i)
+      new(&array[i]) Type(other_array[i]);
+  }
+
   ION_ALIGN(16) char space_[sizeof(Type)];
 #if ION_DEBUG
   Type* val_;  // Allows examination of actual value in a debugger.
@@ -304,9 +320,18 @@ class Variant {
     MakeArray(static_cast<const T*>(NULL), count);
   }
 
-  // Copies the variant's type and value from another instance.
+  // Copies the variant's type and value from another instance. Scalars of
+  // trivially copyable types are copied without dispatching on their types.
   void CopyFrom(const Variant& from) {
     if (&from != this) {
+      if (!count_ && !from.count_ && IsTriviallyCopyableTag(tag_) &&
+          IsTriviallyCopyableTag(from.tag_)) {
+        alloc_ = from.alloc_;
+        tag_ = from.tag_;
+        if (tag_ >= 0)
+          memcpy(&values_, &from.values_, sizeof(values_));
+        return;
+      }
       Destroy();
       alloc_ = from.alloc_;
       count_ = from.count_;
@@ -546,8 +571,64 @@ class Variant {
         sizeof(GetSizedArrayForExactTag(ExactMatch<T>()).array);
   };
 
+  // The bit for tag N in kTriviallyCopyableTags, which is set if the type
+  // for the tag is trivially copyable.
+  template <typename T, int N> struct TrivialTagBit {
+    static const uint64 kValue =
+        IsTriviallyCopyable<T>::value ? static_cast<uint64>(1) << N : 0;
+  };
+  static const uint64 kTriviallyCopyableTags =
+      TrivialTagBit<T1, 1>::kValue |
+      TrivialTagBit<T2, 2>::kValue |
+      TrivialTagBit<T3, 3>::kValue |
+      TrivialTagBit<T4, 4>::kValue |
+      TrivialTagBit<T5, 5>::kValue |
+      TrivialTagBit<T6, 6>::kValue |
+      TrivialTagBit<T7, 7>::kValue |
+      TrivialTagBit<T8, 8>::kValue |
+      TrivialTagBit<T9, 9>::kValue |
+      TrivialTagBit<T10, 10>::kValue |
+      TrivialTagBit<T11, 11>::kValue |
+      TrivialTagBit<T12, 12>::kValue |
+      TrivialTagBit<T13, 13>::kValue |
+      TrivialTagBit<T14, 14>::kValue |
+      TrivialTagBit<T15, 15>::kValue |
+      TrivialTagBit<T16, 16>::kValue |
+      TrivialTagBit<T17, 17>::kValue |
+      TrivialTagBit<T18, 18>::kValue |
+      TrivialTagBit<T19, 19>::kValue |
+      TrivialTagBit<T20, 20>::kValue |
+      TrivialTagBit<T21, 21>::kValue |
+      TrivialTagBit<T22, 22>::kValue |
+      TrivialTagBit<T23, 23>::kValue |
+      TrivialTagBit<T24, 24>::kValue |
+      TrivialTagBit<T25, 25>::kValue |
+      TrivialTagBit<T26, 26>::kValue |
+      TrivialTagBit<T27, 27>::kValue |
+      TrivialTagBit<T28, 28>::kValue |
+      TrivialTagBit<T29, 29>::kValue |
+      TrivialTagBit<T30, 30>::kValue |
+      TrivialTagBit<T31, 31>::kValue |
+      TrivialTagBit<T32, 32>::kValue |
+      TrivialTagBit<T33, 33>::kValue |
+      TrivialTagBit<T34, 34>::kValue |
+      TrivialTagBit<T35, 35>::kValue |
+      TrivialTagBit<T36, 36>::kValue |
+      TrivialTagBit<T37, 37>::kValue |
+      TrivialTagBit<T38, 38>::kValue |
+      TrivialTagBit<T39, 39>::kValue |
+      TrivialTagBit<T40, 40>::kValue;
+
+  // Returns whether a scalar with the passed tag can be copied with memcpy()
+  // and needs no destruction. The invalid tag holds no value, so it qualifies.
+  static bool IsTriviallyCopyableTag(int tag) {
+    return tag < 0 || ((kTriviallyCopyableTags >> tag) & 1U);
+  }
+
   // Destroys any stored object.
   void Destroy() {
+    if (!count_ && IsTriviallyCopyableTag(tag_))
+      return;
     switch (tag_) {
       case Tag<T1>::kValue: values_.t1.Destroy(alloc_, count_); break;
       case Tag<T2>::kValue: values_.t2.Destroy(alloc_, count_); break;
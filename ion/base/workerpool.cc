@@ -84,9 +84,20 @@ bool WorkerPool::IsSuspended() const {
   return suspended_;
 }
 
+void WorkerPool::SetThreadOptions(const port::ThreadOptions& options) {
+  ion::base::LockGuard lock(&thread_options_mutex_);
+  thread_options_ = options;
+}
+
+const port::ThreadOptions WorkerPool::GetThreadOptions() const {
+  ion::base::LockGuard lock(&thread_options_mutex_);
+  return thread_options_;
+}
+
 void WorkerPool::ThreadEntryPoint() {
   if (port::IsThreadNamingSupported())
     port::SetThreadName(GetName());
+  port::SetThreadOptions(GetThreadOptions());
 
   while (true) {
     while (slow_path_) {
@@ -89,6 +89,13 @@ class WorkerPool : public ion::base::Allocatable {
   // Changes the number of theads in the pool.
   void ResizeThreadPool(size_t thread_count);
 
+  // Sets/returns the scheduling options that the pool's threads apply when they
+  // start, such as their priority or the cores they run on. Since threads can
+  // only change their own options, this only affects threads started by later
+  // calls to ResizeThreadPool().
+  void SetThreadOptions(const port::ThreadOptions& options);
+  const port::ThreadOptions GetThreadOptions() const;
+
   // Returns the semaphore that is used to signal that a unit of work is
   // available to process.
   port::Semaphore* GetWorkSemaphore() { return &work_sema_; }
@@ -125,6 +132,10 @@ class WorkerPool : public ion::base::Allocatable {
   std::atomic<bool> slow_path_;
   std::function<bool()> spawn_func_;
   mutable ion::port::Mutex mutex_;
+  // The options for new threads. These have their own mutex because threads
+  // read them when they start, while |mutex_| may be held to join them.
+  port::ThreadOptions thread_options_;
+  mutable ion::port::Mutex thread_options_mutex_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(WorkerPool);
 };
@@ -17,20 +17,30 @@ limitations under the License.
 
 #include "ion/base/zipassetmanager.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "base/integral_types.h"
 #include "ion/base/invalid.h"
 #include "ion/base/lockguards.h"
 #include "ion/base/logging.h"
 #include "ion/base/scopedallocation.h"
 #include "ion/base/staticsafedeclare.h"
 #include "ion/base/stringutils.h"
+#include "ion/base/workerpool.h"
 #include "ion/port/fileutils.h"
 
 #include "third_party/unzip/unzip.h"
 // unzip.h must be included before ioapi.h for types to be defined correctly.
 #include "third_party/zlib/src/contrib/minizip/ioapi.h"
+#include "third_party/zlib/src/zlib.h"
 
 namespace ion {
 namespace base {
@@ -39,11 +49,246 @@ namespace {
 
 static const char kManifestFilename[] = "__asset_manifest__.txt";
 
+// Signatures and sizes of the zip records that are read to index zip data.
+static const uint32 kEndOfCentralDirectorySignature = 0x06054b50;
+static const uint32 kCentralDirectoryEntrySignature = 0x02014b50;
+static const uint32 kLocalHeaderSignature = 0x04034b50;
+static const size_t kEndOfCentralDirectorySize = 22U;
+static const size_t kCentralDirectoryEntrySize = 46U;
+static const size_t kLocalHeaderSize = 30U;
+static const size_t kMaxZipCommentSize = 0xffff;
+
+// Compression methods of zip entries.
+static const uint16 kStoredMethod = 0;
+static const uint16 kDeflatedMethod = 8;
+
+// The default budget of the cache of decompressed data.
+static const size_t kDefaultDecompressedCacheBudget = 8U * 1024U * 1024U;
+
+// The default number of threads that prefetch files.
+static const size_t kDefaultPrefetchThreadCount = 2U;
+
+// Reads little-endian values from zip records.
+static uint16 ReadUint16(const uint8* data) {
+  return static_cast<uint16>(data[0] | (data[1] << 8));
+}
+static uint32 ReadUint32(const uint8* data) {
+  return static_cast<uint32>(data[0]) | (static_cast<uint32>(data[1]) << 8) |
+      (static_cast<uint32>(data[2]) << 16) |
+      (static_cast<uint32>(data[3]) << 24);
+}
+
+// Inflates the raw deflated |data| into |out|, which must already have the
+// size of the decompressed data. Returns whether the data decompressed to
+// exactly that size.
+static bool InflateData(const char* data, size_t size, std::string* out) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Negative window bits select raw deflate data, as stored in zip files.
+  if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+    return false;
+  // The empty output string still needs a valid buffer.
+  char empty;
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream.avail_in = static_cast<uInt>(size);
+  stream.next_out =
+      reinterpret_cast<Bytef*>(out->empty() ? &empty : &(*out)[0]);
+  stream.avail_out = static_cast<uInt>(out->size());
+  const int result = inflate(&stream, Z_FINISH);
+  const bool succeeded =
+      result == Z_STREAM_END && stream.total_out == out->size();
+  inflateEnd(&stream);
+  return succeeded;
+}
+
 }  // anonymous namespace
 
-ZipAssetManager::ZipAssetManager() {}
+// The cache of decompressed data keys data by the address of its compressed
+// bytes, and spreads it across shards that each have their own lock and an
+// equal share of the budget, so that threads fetching different files rarely
+// contend. Each shard evicts its least recently used data first.
+class ZipAssetManager::DecompressedCache {
+ public:
+  DecompressedCache() : budget_(kDefaultDecompressedCacheBudget) {}
+
+  // Returns the cached data for |key|, or an empty pointer.
+  std::shared_ptr<const std::string> Get(const void* key) {
+    Shard& shard = GetShard(key);
+    LockGuard guard(&shard.mutex);
+    Shard::EntryMap::iterator it = shard.map.find(key);
+    if (it == shard.map.end())
+      return std::shared_ptr<const std::string>();
+    // Move the data to the front of the list.
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    return it->second->second;
+  }
+
+  // Adds |data| for |key| unless it is already cached, evicting other data if
+  // the shard exceeds its budget. Data that is larger than the budget of a
+  // shard is not cached.
+  void Add(const void* key, const std::shared_ptr<const std::string>& data) {
+    const size_t shard_budget = GetShardBudget();
+    if (data->size() > shard_budget)
+      return;
+    Shard& shard = GetShard(key);
+    LockGuard guard(&shard.mutex);
+    if (shard.map.count(key))
+      return;
+    shard.entries.push_front(std::make_pair(key, data));
+    shard.map[key] = shard.entries.begin();
+    shard.size += data->size();
+    Trim(&shard, shard_budget);
+  }
+
+  void SetBudget(size_t budget) {
+    budget_ = budget;
+    const size_t shard_budget = GetShardBudget();
+    for (size_t i = 0; i < kShardCount; ++i) {
+      LockGuard guard(&shards_[i].mutex);
+      Trim(&shards_[i], shard_budget);
+    }
+  }
+  size_t GetBudget() const { return budget_; }
+
+  // Returns the number of bytes of cached data.
+  size_t GetSize() {
+    size_t size = 0U;
+    for (size_t i = 0; i < kShardCount; ++i) {
+      LockGuard guard(&shards_[i].mutex);
+      size += shards_[i].size;
+    }
+    return size;
+  }
+
+  void Clear() {
+    for (size_t i = 0; i < kShardCount; ++i) {
+      LockGuard guard(&shards_[i].mutex);
+      Trim(&shards_[i], 0U);
+    }
+  }
+
+ private:
+  static const size_t kShardCount = 8U;
+
+  struct Shard {
+    Shard() : size(0U) {}
+    typedef std::list<
+        std::pair<const void*, std::shared_ptr<const std::string>>> EntryList;
+    typedef std::unordered_map<const void*, EntryList::iterator> EntryMap;
+    port::Mutex mutex;
+    // Cached data, most recently used first.
+    EntryList entries;
+    EntryMap map;
+    // The number of bytes of cached data.
+    size_t size;
+  };
+
+  Shard& GetShard(const void* key) {
+    // Zip entries are at least a local header apart, so the low bits of their
+    // addresses vary little.
+    return shards_[(reinterpret_cast<uintptr_t>(key) >> 4) % kShardCount];
+  }
+  size_t GetShardBudget() const { return budget_ / kShardCount; }
+
+  // Evicts the least recently used data from |shard| until it is within
+  // |shard_budget|. The shard's mutex must be locked.
+  static void Trim(Shard* shard, size_t shard_budget) {
+    while (shard->size > shard_budget) {
+      shard->size -= shard->entries.back().second->size();
+      shard->map.erase(shard->entries.back().first);
+      shard->entries.pop_back();
+    }
+  }
+
+  std::atomic<size_t> budget_;
+  Shard shards_[kShardCount];
+};
+
+// The PrefetchWorker prefetches queued files, one per call to DoWork().
+class ZipAssetManager::PrefetchWorker : public WorkerPool::Worker {
+ public:
+  explicit PrefetchWorker(size_t thread_count) : pool_(this) {
+    pool_.ResizeThreadPool(thread_count);
+    pool_.Resume();
+  }
+  ~PrefetchWorker() override {
+    pool_.Suspend();
+    pool_.ResizeThreadPool(0U);
+  }
+
+  void SetThreadCount(size_t thread_count) {
+    pool_.ResizeThreadPool(thread_count);
+  }
+
+  // Queues the passed files to be prefetched for |prefetch|.
+  void AddFiles(const std::vector<std::string>& filenames,
+                const PrefetchPtr& prefetch) {
+    {
+      LockGuard guard(&mutex_);
+      for (const std::string& filename : filenames)
+        tasks_.push_back(Task(filename, prefetch));
+    }
+    for (size_t i = 0; i < filenames.size(); ++i)
+      pool_.GetWorkSemaphore()->Post();
+  }
+
+  // WorkerPool::Worker implementation.
+  void DoWork() override {
+    Task task;
+    {
+      LockGuard guard(&mutex_);
+      if (tasks_.empty())
+        return;
+      task = tasks_.front();
+      tasks_.pop_front();
+    }
+    task.second->FinishFile(task.first, PrefetchFile(task.first));
+  }
+  const std::string& GetName() const override {
+    static const std::string kName("Ion zip asset prefetch worker");
+    return kName;
+  }
+
+ private:
+  typedef std::pair<std::string, PrefetchPtr> Task;
+
+  port::Mutex mutex_;
+  std::deque<Task> tasks_;
+  // This must be last so that its threads stop before anything else is
+  // destroyed.
+  WorkerPool pool_;
+};
+
+ZipAssetManager::Prefetch::Prefetch(size_t count,
+                                    const PrefetchCallback& callback)
+    : callback_(callback), remaining_count_(count) {
+  if (!count)
+    done_.Post();
+}
+
+void ZipAssetManager::Prefetch::Wait() {
+  // Post again so that other waiters are released as well.
+  done_.Wait();
+  done_.Post();
+}
+
+void ZipAssetManager::Prefetch::FinishFile(const std::string& filename,
+                                           bool found) {
+  if (callback_)
+    callback_(filename, found);
+  if (--remaining_count_ == 0U)
+    done_.Post();
+}
+
+ZipAssetManager::ZipAssetManager()
+    : index_(NULL),
+      decompressed_cache_(new DecompressedCache),
+      has_changed_files_(false),
+      prefetch_thread_count_(kDefaultPrefetchThreadCount) {}
 
 ZipAssetManager::~ZipAssetManager() {
+  // Stop prefetching before anything it uses is destroyed.
+  prefetch_worker_.reset();
   Reset();
 }
 
@@ -80,12 +325,42 @@ bool ZipAssetManager::RegisterAssetData(const void* data, size_t data_size) {
 #endif
           manager->file_cache_[buf.Get()] = file_info;
           manager->file_cache_[buf.Get()].data_ptr.reset(new std::string());
+          manager->changed_files_.erase(buf.Get());
           if (strcmp(kManifestFilename, buf.Get()) == 0)
             contains_manifest = true;
         }
       } while (unzGoToNextFile(zipfile) == UNZ_OK);
     }
 
+    // Publish a new index in which the files of this data replace any files
+    // with the same names that were registered before. Lookups may still be
+    // using the old index, so it is kept until Reset().
+    {
+      FileIndex added;
+      IndexZipData(data, data_size, &added);
+      const auto compare = [](const IndexEntry& a, const IndexEntry& b) {
+        return a.name < b.name;
+      };
+      // Like unzLocateFile(), use the first of several files with a name.
+      std::stable_sort(added.begin(), added.end(), compare);
+      added.erase(std::unique(added.begin(), added.end(),
+                              [](const IndexEntry& a, const IndexEntry& b) {
+                                return a.name == b.name;
+                              }),
+                  added.end());
+      std::unique_ptr<FileIndex> index(new FileIndex);
+      if (const FileIndex* old_index = manager->index_.load()) {
+        // std::set_union() takes matching entries from the first range.
+        index->reserve(old_index->size() + added.size());
+        std::set_union(added.begin(), added.end(), old_index->begin(),
+                       old_index->end(), std::back_inserter(*index), compare);
+      } else {
+        index->swap(added);
+      }
+      manager->index_.store(index.get(), std::memory_order_release);
+      manager->indices_.push_back(std::move(index));
+    }
+
     // Save the manifest mappings from local filenames to zip names.
     if (contains_manifest) {
       // Must not release the lock before erasing the manifest or another
@@ -119,6 +394,9 @@ bool ZipAssetManager::RegisterAssetData(const void* data, size_t data_size) {
 
 bool ZipAssetManager::ContainsFile(const std::string& filename) {
   ZipAssetManager* manager = GetManager();
+  // Indexed files are found without locking.
+  if (manager->FindIndexEntry(filename))
+    return true;
   LockGuard guard(&manager->mutex_);
   return manager->ContainsFileLocked(filename);
 }
@@ -168,6 +446,136 @@ bool ZipAssetManager::GetFileDataNoCache(const std::string& filename,
   return !IsInvalidReference(manager->GetFileDataLocked(filename, out));
 }
 
+ZipAssetManager::FileView ZipAssetManager::GetFileView(
+    const std::string& filename) {
+  ZipAssetManager* manager = GetManager();
+  // Files whose data was changed are returned from a copy of the changed data,
+  // since the cached data may change again.
+  if (manager->has_changed_files_.load(std::memory_order_acquire)) {
+    LockGuard guard(&manager->mutex_);
+    if (manager->changed_files_.count(filename)) {
+      FileCache::const_iterator it = manager->file_cache_.find(filename);
+      if (it == manager->file_cache_.end())
+        return FileView();
+      std::shared_ptr<const std::string> data(
+          new std::string(*it->second.data_ptr));
+      return FileView(data->data(), data->size(), data);
+    }
+  }
+
+  const IndexEntry* entry = manager->FindIndexEntry(filename);
+  if (!entry) {
+    // Files that could not be indexed are extracted as usual.
+    std::shared_ptr<const std::string> data = GetFileDataPtr(filename);
+    return data ? FileView(data->data(), data->size(), data) : FileView();
+  }
+  if (!entry->is_compressed) {
+    return FileView(entry->data, entry->uncompressed_size,
+                    std::shared_ptr<const std::string>());
+  }
+
+  DecompressedCache* cache = manager->decompressed_cache_.get();
+  std::shared_ptr<const std::string> data = cache->Get(entry->data);
+  if (!data) {
+    // Threads that miss the cache for the same file at the same time each
+    // decompress it, which is cheaper than making them wait for one another.
+    std::shared_ptr<std::string> inflated(
+        new std::string(entry->uncompressed_size, '\0'));
+    if (!InflateData(entry->data, entry->compressed_size, inflated.get())) {
+      LOG(ERROR) << "Unable to decompress zip asset " << filename;
+      return FileView();
+    }
+    data = inflated;
+    cache->Add(entry->data, data);
+  }
+  return FileView(data->data(), data->size(), data);
+}
+
+ZipAssetManager::PrefetchPtr ZipAssetManager::PrefetchFiles(
+    const std::vector<std::string>& filenames,
+    const PrefetchCallback& callback) {
+  PrefetchPtr prefetch(new Prefetch(filenames.size(), callback));
+  if (filenames.empty())
+    return prefetch;
+  ZipAssetManager* manager = GetManager();
+  PrefetchWorker* worker;
+  {
+    LockGuard guard(&manager->mutex_);
+    if (!manager->prefetch_worker_) {
+      manager->prefetch_worker_.reset(
+          new PrefetchWorker(manager->prefetch_thread_count_));
+    }
+    worker = manager->prefetch_worker_.get();
+  }
+  worker->AddFiles(filenames, prefetch);
+  return prefetch;
+}
+
+void ZipAssetManager::SetPrefetchThreadCount(size_t thread_count) {
+  ZipAssetManager* manager = GetManager();
+  PrefetchWorker* worker;
+  {
+    LockGuard guard(&manager->mutex_);
+    manager->prefetch_thread_count_ = thread_count;
+    worker = manager->prefetch_worker_.get();
+  }
+  // Resizing waits for the threads, which may be waiting for the mutex.
+  if (worker)
+    worker->SetThreadCount(thread_count);
+}
+
+bool ZipAssetManager::PrefetchFile(const std::string& filename) {
+  ZipAssetManager* manager = GetManager();
+  void* zip_handle;
+  IndexEntry entry;
+  {
+    LockGuard guard(&manager->mutex_);
+    FileCache::iterator it = manager->file_cache_.find(filename);
+    if (it == manager->file_cache_.end())
+      return false;
+    if (FileIsCached(it->second))
+      return true;
+    const IndexEntry* index_entry = manager->FindIndexEntry(filename);
+    if (!index_entry) {
+      // Files that could not be indexed are extracted as usual.
+      return !IsInvalidReference(manager->GetFileDataLocked(filename, NULL));
+    }
+    zip_handle = it->second.zip_handle;
+    entry = *index_entry;
+  }
+
+  // Decompress the file without holding the mutex, so that other files are
+  // decompressed at the same time.
+  std::string data(entry.uncompressed_size, '\0');
+  if (!entry.is_compressed) {
+    data.assign(entry.data, entry.uncompressed_size);
+  } else if (!InflateData(entry.data, entry.compressed_size, &data)) {
+    LOG(ERROR) << "Unable to decompress zip asset " << filename;
+    return true;
+  }
+
+  // Keep data that was set or registered for the file in the meantime.
+  LockGuard guard(&manager->mutex_);
+  FileCache::iterator it = manager->file_cache_.find(filename);
+  if (it == manager->file_cache_.end())
+    return false;
+  if (it->second.zip_handle == zip_handle && !FileIsCached(it->second))
+    it->second.data_ptr->swap(data);
+  return true;
+}
+
+void ZipAssetManager::SetDecompressedCacheBudget(size_t bytes) {
+  GetManager()->decompressed_cache_->SetBudget(bytes);
+}
+
+size_t ZipAssetManager::GetDecompressedCacheBudget() {
+  return GetManager()->decompressed_cache_->GetBudget();
+}
+
+size_t ZipAssetManager::GetDecompressedCacheSize() {
+  return GetManager()->decompressed_cache_->GetSize();
+}
+
 const std::string& ZipAssetManager::GetFileDataLocked(
     const std::string& filename, std::string* out) {
   if (!ContainsFileLocked(filename)) {
@@ -216,6 +624,8 @@ bool ZipAssetManager::SetFileData(const std::string& filename,
     FileCache::iterator it = manager->file_cache_.find(filename);
     *it->second.data_ptr = source;
     it->second.timestamp = std::chrono::system_clock::now();
+    manager->changed_files_.insert(filename);
+    manager->has_changed_files_.store(true, std::memory_order_release);
     return true;
   }
 }
@@ -247,6 +657,11 @@ void ZipAssetManager::Reset() {
     unzClose(*it);
   manager->file_cache_.clear();
   manager->zipfiles_.clear();
+  manager->index_.store(NULL);
+  manager->indices_.clear();
+  manager->decompressed_cache_->Clear();
+  manager->changed_files_.clear();
+  manager->has_changed_files_.store(false);
 }
 
 bool ZipAssetManager::UpdateFileIfChanged(
@@ -272,6 +687,8 @@ bool ZipAssetManager::UpdateFileIfChanged(
         it->second.data_ptr->resize(length);
         fread(&((*it->second.data_ptr)[0]), sizeof(char), length, fp);
         fclose(fp);
+        manager->changed_files_.insert(filename);
+        manager->has_changed_files_.store(true, std::memory_order_release);
       }
       *timestamp = new_timestamp;
       return true;
@@ -281,6 +698,101 @@ bool ZipAssetManager::UpdateFileIfChanged(
   return false;
 }
 
+void ZipAssetManager::IndexZipData(const void* data, size_t data_size,
+                                   FileIndex* index) {
+  const uint8* bytes = static_cast<const uint8*>(data);
+  if (data_size < kEndOfCentralDirectorySize)
+    return;
+
+  // Find the end of central directory record, which is followed by a comment
+  // and possibly by padding, by searching backwards for its signature.
+  const size_t last_start = data_size - kEndOfCentralDirectorySize;
+  const size_t first_start =
+      last_start > kMaxZipCommentSize + 4U ? last_start - kMaxZipCommentSize - 4U
+                                           : 0U;
+  const uint8* end_record = NULL;
+  for (size_t start = last_start + 1U; start-- > first_start;) {
+    if (ReadUint32(bytes + start) == kEndOfCentralDirectorySignature) {
+      end_record = bytes + start;
+      break;
+    }
+  }
+  if (!end_record)
+    return;
+
+  const size_t entry_count = ReadUint16(end_record + 10);
+  const size_t directory_size = ReadUint32(end_record + 12);
+  const size_t directory_offset = ReadUint32(end_record + 16);
+  if (directory_offset > data_size ||
+      directory_size > data_size - directory_offset)
+    return;
+
+  const uint8* entry = bytes + directory_offset;
+  const uint8* directory_end = entry + directory_size;
+  for (size_t i = 0; i < entry_count; ++i) {
+    if (static_cast<size_t>(directory_end - entry) <
+            kCentralDirectoryEntrySize ||
+        ReadUint32(entry) != kCentralDirectoryEntrySignature)
+      return;
+    const uint16 flags = ReadUint16(entry + 8);
+    const uint16 method = ReadUint16(entry + 10);
+    const uint32 compressed_size = ReadUint32(entry + 20);
+    const uint32 uncompressed_size = ReadUint32(entry + 24);
+    const size_t name_length = ReadUint16(entry + 28);
+    const size_t record_size = kCentralDirectoryEntrySize + name_length +
+        ReadUint16(entry + 30) + ReadUint16(entry + 32);
+    const size_t local_offset = ReadUint32(entry + 42);
+    if (static_cast<size_t>(directory_end - entry) < record_size)
+      return;
+    const std::string name(
+        reinterpret_cast<const char*>(entry + kCentralDirectoryEntrySize),
+        name_length);
+    entry += record_size;
+
+    // Skip encrypted and zip64 files, files with unsupported compression, and
+    // the manifest, which is not a registered file.
+    if ((flags & 1) || compressed_size == 0xffffffff ||
+        uncompressed_size == 0xffffffff || local_offset == 0xffffffff ||
+        (method != kStoredMethod && method != kDeflatedMethod) ||
+        (method == kStoredMethod && compressed_size != uncompressed_size) ||
+        name == kManifestFilename)
+      continue;
+
+    // The file data follows its local header, whose extra field may differ
+    // from the one in the central directory.
+    if (local_offset > data_size ||
+        data_size - local_offset < kLocalHeaderSize ||
+        ReadUint32(bytes + local_offset) != kLocalHeaderSignature)
+      continue;
+    const uint8* local_header = bytes + local_offset;
+    const size_t data_offset = local_offset + kLocalHeaderSize +
+        ReadUint16(local_header + 26) + ReadUint16(local_header + 28);
+    if (data_offset > data_size || compressed_size > data_size - data_offset)
+      continue;
+
+    IndexEntry index_entry;
+    index_entry.name = name;
+    index_entry.data = reinterpret_cast<const char*>(bytes + data_offset);
+    index_entry.compressed_size = compressed_size;
+    index_entry.uncompressed_size = uncompressed_size;
+    index_entry.is_compressed = method == kDeflatedMethod;
+    index->push_back(index_entry);
+  }
+}
+
+const ZipAssetManager::IndexEntry* ZipAssetManager::FindIndexEntry(
+    const std::string& filename) const {
+  const FileIndex* index = index_.load(std::memory_order_acquire);
+  if (!index)
+    return NULL;
+  FileIndex::const_iterator it = std::lower_bound(
+      index->begin(), index->end(), filename,
+      [](const IndexEntry& entry, const std::string& name) {
+        return entry.name < name;
+      });
+  return it != index->end() && it->name == filename ? &*it : NULL;
+}
+
 ZipAssetManager* ZipAssetManager::GetManager() {
   // This ensures that the manager will be safely destroyed when the program
   // exits.
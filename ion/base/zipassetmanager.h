@@ -18,7 +18,9 @@ limitations under the License.
 #ifndef ION_BASE_ZIPASSETMANAGER_H_
 #define ION_BASE_ZIPASSETMANAGER_H_
 
+#include <atomic>
 #include <chrono>  // NOLINT
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
@@ -27,6 +29,7 @@ limitations under the License.
 
 #include "base/macros.h"
 #include "ion/port/mutex.h"
+#include "ion/port/semaphore.h"
 
 namespace ion {
 namespace base {
@@ -37,10 +40,80 @@ namespace base {
 // Files are only extracted the first time they are requested through
 // GetFileData(); file contents are cached internally after extraction.
 //
+// Files can also be fetched as FileViews with GetFileView(), which does not
+// keep a decompressed copy of every file alive. Registered data is indexed
+// once, so that views are found without locking. Files stored in the zip
+// without compression are returned without copying, while compressed files are
+// decompressed by the calling thread into a cache that is bounded by a byte
+// budget, evicting the least recently used data first.
+//
+// Files that will be needed soon can be prefetched with PrefetchFiles(), which
+// decompresses them on worker threads into the cache used by GetFileData(), so
+// that decompression overlaps with other work.
+//
 // Note that zip assets must be explicitly registered through
 // RegisterAssetData().
 class ION_API ZipAssetManager {
  public:
+  // A read-only view of the data of a file returned by GetFileView(). A view
+  // shares ownership of decompressed data, so it remains valid after the data
+  // is evicted from the cache. Views of files stored without compression point
+  // into the registered data, which must therefore outlive them.
+  class FileView {
+   public:
+    // Constructs an invalid view.
+    FileView() : data_(NULL), size_(0U) {}
+
+    // Returns whether the view refers to the data of a file.
+    bool IsValid() const { return data_ != NULL; }
+    // Returns the data of the file and its size in bytes.
+    const char* GetData() const { return data_; }
+    size_t GetSize() const { return size_; }
+    // Returns a copy of the data, or an empty string if the view is invalid.
+    const std::string ToString() const {
+      return data_ ? std::string(data_, size_) : std::string();
+    }
+
+   private:
+    FileView(const char* data, size_t size,
+             const std::shared_ptr<const std::string>& owner)
+        : data_(data), size_(size), owner_(owner) {}
+
+    const char* data_;
+    size_t size_;
+    // The decompressed data that the view points into, if any.
+    std::shared_ptr<const std::string> owner_;
+
+    friend class ZipAssetManager;
+  };
+
+  // A function called by PrefetchFiles() with the name of each prefetched file
+  // and whether the manager contains it.
+  typedef std::function<void(const std::string& filename, bool found)>
+      PrefetchCallback;
+
+  // Tracks the progress of the files requested by a call to PrefetchFiles().
+  class Prefetch {
+   public:
+    // Returns whether all of the files have been prefetched.
+    bool IsDone() const { return remaining_count_ == 0U; }
+    // Blocks until all of the files have been prefetched.
+    void Wait();
+
+   private:
+    Prefetch(size_t count, const PrefetchCallback& callback);
+    // Calls the callback for a prefetched file and counts it.
+    void FinishFile(const std::string& filename, bool found);
+
+    const PrefetchCallback callback_;
+    std::atomic<size_t> remaining_count_;
+    // Posted once all files have been prefetched.
+    port::Semaphore done_;
+
+    friend class ZipAssetManager;
+  };
+  typedef std::shared_ptr<Prefetch> PrefetchPtr;
+
   // The destructor is public so that the StaticDeleter that destroys the
   // manager can access it.
   ~ZipAssetManager();
@@ -82,6 +155,36 @@ class ION_API ZipAssetManager {
   // for |filename| then this method will clear that cached data.
   static bool GetFileDataNoCache(const std::string& filename, std::string* out);
 
+  // Returns a view of the data of the passed filename, or an invalid view if
+  // the manager does not contain it or it cannot be decompressed. This does
+  // not use or fill the cache of GetFileData(), but returns the data set by
+  // SetFileData() or UpdateFileIfChanged() for files that they changed. It is
+  // lock-free for files stored without compression and for compressed files
+  // that are in the cache of decompressed data, and may be called from many
+  // threads at once.
+  static FileView GetFileView(const std::string& filename);
+
+  // Decompresses the passed files into the cache used by GetFileData() and
+  // GetFileDataPtr() on worker threads, so that later calls to them for the
+  // files return without decompressing. Indexed files are decompressed
+  // concurrently without holding the manager mutex. If |callback| is set, it is
+  // called on a worker thread for each file once it is cached, or once it is
+  // known that the manager does not contain it. Returns a Prefetch that
+  // reports when all of the files are done.
+  static PrefetchPtr PrefetchFiles(const std::vector<std::string>& filenames,
+                                   const PrefetchCallback& callback);
+  // Sets the number of worker threads used by PrefetchFiles(). The default is
+  // 2.
+  static void SetPrefetchThreadCount(size_t thread_count);
+
+  // Sets/returns the maximum number of bytes of decompressed data that the
+  // cache used by GetFileView() keeps. Setting a lower budget evicts data
+  // immediately. The default is 8 MB.
+  static void SetDecompressedCacheBudget(size_t bytes);
+  static size_t GetDecompressedCacheBudget();
+  // Returns the number of bytes of decompressed data in the cache.
+  static size_t GetDecompressedCacheSize();
+
   // If the source file of a zipped file is available on disk (based on the
   // file's manifest), this function updates the cached unzipped data from the
   // source file if it has changed since the data was registered and the source
@@ -128,6 +231,24 @@ class ION_API ZipAssetManager {
   };
   typedef std::map<std::string, FileInfo> FileCache;
 
+  // An entry in the index of registered files used by GetFileView().
+  struct IndexEntry {
+    std::string name;
+    // The file data in the registered zip data, which is deflated if
+    // |is_compressed| is set.
+    const char* data;
+    size_t compressed_size;
+    size_t uncompressed_size;
+    bool is_compressed;
+  };
+  // An index is sorted by name.
+  typedef std::vector<IndexEntry> FileIndex;
+
+  // Cache of decompressed data used by GetFileView().
+  class DecompressedCache;
+  // Runs the tasks of PrefetchFiles() on a WorkerPool.
+  class PrefetchWorker;
+
   // The constructor is private since this is a singleton class.
   ZipAssetManager();
 
@@ -143,6 +264,20 @@ class ION_API ZipAssetManager {
   // manager mutex is already held.
   bool ContainsFileLocked(const std::string& filename);
 
+  // Appends entries for the files in the passed zip data to |index|, reading
+  // its central directory. Files that cannot be read directly, such as
+  // encrypted or zip64 files, are left out.
+  static void IndexZipData(const void* data, size_t data_size,
+                           FileIndex* index);
+
+  // Returns the index entry of the passed filename, or NULL if it is not
+  // indexed. This does not lock the manager mutex.
+  const IndexEntry* FindIndexEntry(const std::string& filename) const;
+
+  // Caches the data of the passed filename for GetFileData() if it is not
+  // cached yet, and returns whether the manager contains the file.
+  static bool PrefetchFile(const std::string& filename);
+
   // Returns a pointer to the manager instance.
   static ZipAssetManager* GetManager();
 
@@ -155,6 +290,22 @@ class ION_API ZipAssetManager {
   // Set of zipfiles that have been registered with the manager.
   std::set<void*> zipfiles_;
 
+  // The current index of registered files, which is replaced by a new index
+  // when data is registered.
+  std::atomic<const FileIndex*> index_;
+  // All indices that have been current, which are kept until Reset() so that
+  // lookups that race with a registration remain valid.
+  std::vector<std::unique_ptr<const FileIndex>> indices_;
+  std::unique_ptr<DecompressedCache> decompressed_cache_;
+  // Files whose data was changed by SetFileData() or UpdateFileIfChanged(),
+  // and whether there are any.
+  std::set<std::string> changed_files_;
+  std::atomic<bool> has_changed_files_;
+  // The worker for PrefetchFiles(), which is created when it is first needed,
+  // and the number of threads it uses.
+  std::unique_ptr<PrefetchWorker> prefetch_worker_;
+  size_t prefetch_thread_count_;
+
   // Mutex to guard access to asset data.
   port::Mutex mutex_;
 
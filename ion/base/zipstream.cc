@@ -0,0 +1,705 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/base/zipstream.h"
+
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/base/workerpool.h"
+#include "ion/port/mutex.h"
+#include "ion/port/semaphore.h"
+#include "third_party/zlib/src/zlib.h"
+
+namespace ion {
+namespace base {
+
+namespace {
+
+// Signatures of the ZIP records.
+static const uint32 kLocalFileHeaderSignature = 0x04034b50;
+static const uint32 kDataDescriptorSignature = 0x08074b50;
+static const uint32 kCentralFileHeaderSignature = 0x02014b50;
+static const uint32 kEndOfCentralDirectorySignature = 0x06054b50;
+
+// The size of a local file header without its filename and extra field.
+static const size_t kLocalFileHeaderSize = 30U;
+// The size of a data descriptor without its optional signature.
+static const size_t kDataDescriptorSize = 12U;
+
+// Version 2.0 of the format is needed to read deflated files.
+static const uint16 kVersionNeeded = 20U;
+// The general purpose flag set when sizes and checksums follow the data.
+static const uint16 kDataDescriptorFlag = 0x0008;
+static const uint16 kStoredMethod = 0U;
+static const uint16 kDeflatedMethod = 8U;
+// The MS-DOS date of January 1, 1980, the earliest that can be represented.
+static const uint16 kDosDate = 0x0021;
+// The largest size or offset that fits in a ZIP record without ZIP64.
+static const uint64 kMaxZipSize = 0xffffffffU;
+
+// The size of the buffer that the reader reads the source into.
+static const size_t kReadBufferSize = 64U * 1024U;
+
+static void AppendUint16(uint16 value, std::vector<uint8>* out) {
+  out->push_back(static_cast<uint8>(value & 0xff));
+  out->push_back(static_cast<uint8>(value >> 8));
+}
+
+static void AppendUint32(uint32 value, std::vector<uint8>* out) {
+  AppendUint16(static_cast<uint16>(value & 0xffff), out);
+  AppendUint16(static_cast<uint16>(value >> 16), out);
+}
+
+static uint16 GetUint16(const uint8* data) {
+  return static_cast<uint16>(data[0] | (data[1] << 8));
+}
+
+static uint32 GetUint32(const uint8* data) {
+  return static_cast<uint32>(GetUint16(data)) |
+      (static_cast<uint32>(GetUint16(data + 2)) << 16);
+}
+
+// A block of a file that is compressed independently of the others.
+struct Block {
+  Block() : crc(0U), is_last(false), is_compressed(false) {}
+  std::vector<uint8> input;
+  std::vector<uint8> output;
+  uint32 crc;
+  bool is_last;
+  bool is_compressed;
+  // Posted once the block has been compressed.
+  port::Semaphore done;
+};
+
+// Compresses the input of block into raw deflate data and computes its
+// checksum. All blocks but the last end with a sync flush, which pads them to
+// a byte boundary with an empty stored block, so that the compressed blocks of
+// a file can simply be concatenated.
+static void CompressBlock(Block* block) {
+  // Blocks are at most ZipStreamWriter::kBlockSize bytes, so the size fits in
+  // a uInt.
+  const uInt input_size = static_cast<uInt>(block->input.size());
+  uint8* input = block->input.empty() ? Z_NULL : &block->input[0];
+  block->crc = static_cast<uint32>(crc32(0L, input, input_size));
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    return;
+  // The bound assumes a finished stream; a sync flush adds up to 6 bytes.
+  block->output.resize(deflateBound(&stream, input_size) + 6U);
+  stream.next_in = input;
+  stream.avail_in = input_size;
+  stream.next_out = &block->output[0];
+  stream.avail_out = static_cast<uInt>(block->output.size());
+  if (block->is_last) {
+    block->is_compressed = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+  } else {
+    block->is_compressed = deflate(&stream, Z_SYNC_FLUSH) == Z_OK &&
+                           !stream.avail_in && stream.avail_out;
+  }
+  block->output.resize(stream.total_out);
+  deflateEnd(&stream);
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// ZipStreamWriter::Impl class.
+//
+//-----------------------------------------------------------------------------
+
+class ZipStreamWriter::Impl : public WorkerPool::Worker {
+ public:
+  Impl(const Sink& sink, size_t thread_count)
+      : sink_(sink),
+        thread_count_(thread_count),
+        bytes_written_(0U),
+        entry_count_(0U),
+        local_header_offset_(0U),
+        file_crc_(0U),
+        compressed_size_(0U),
+        uncompressed_size_(0U),
+        is_in_file_(false),
+        is_finished_(false),
+        has_error_(false),
+        pool_(this) {
+    pool_.ResizeThreadPool(thread_count_);
+    pool_.Resume();
+  }
+  ~Impl() override {
+    pool_.Suspend();
+    pool_.ResizeThreadPool(0U);
+  }
+
+  bool BeginFile(const std::string& filename) {
+    if (is_finished_) {
+      LOG(ERROR) << "ZipStreamWriter: cannot add files after Finish()";
+      return false;
+    }
+    if (is_in_file_)
+      EndFile();
+    if (has_error_)
+      return false;
+    if (filename.empty() || filename.size() > 0xffff)
+      return SetError("invalid filename '" + filename + "'");
+    if (bytes_written_ > kMaxZipSize)
+      return SetError("archive exceeds 4 GB");
+
+    filename_ = filename;
+    local_header_offset_ = bytes_written_;
+    file_crc_ = 0U;
+    compressed_size_ = 0U;
+    uncompressed_size_ = 0U;
+    is_in_file_ = true;
+    current_block_.reset(new Block);
+    current_block_->input.reserve(kBlockSize);
+
+    // The checksum and sizes are written in the data descriptor.
+    std::vector<uint8> header;
+    AppendUint32(kLocalFileHeaderSignature, &header);
+    AppendFileInfo(0U, 0U, 0U, &header);
+    AppendUint16(0U, &header);  // Extra field length.
+    header.insert(header.end(), filename.begin(), filename.end());
+    return WriteData(header);
+  }
+
+  bool Write(const void* data, size_t size) {
+    if (!is_in_file_) {
+      LOG(ERROR) << "ZipStreamWriter: Write() called without a file";
+      return false;
+    }
+    const uint8* bytes = static_cast<const uint8*>(data);
+    while (size && !has_error_) {
+      std::vector<uint8>& input = current_block_->input;
+      const size_t count = std::min(size, kBlockSize - input.size());
+      input.insert(input.end(), bytes, bytes + count);
+      bytes += count;
+      size -= count;
+      if (input.size() == kBlockSize) {
+        SubmitBlock(false);
+        current_block_.reset(new Block);
+        current_block_->input.reserve(kBlockSize);
+      }
+    }
+    return !has_error_;
+  }
+
+  bool EndFile() {
+    if (!is_in_file_) {
+      LOG(ERROR) << "ZipStreamWriter: EndFile() called without a file";
+      return false;
+    }
+    is_in_file_ = false;
+    SubmitBlock(true);
+    while (!blocks_.empty())
+      WriteFirstBlock();
+    if (compressed_size_ > kMaxZipSize || uncompressed_size_ > kMaxZipSize)
+      SetError("file '" + filename_ + "' exceeds 4 GB");
+    if (has_error_)
+      return false;
+
+    std::vector<uint8> descriptor;
+    AppendUint32(kDataDescriptorSignature, &descriptor);
+    AppendUint32(file_crc_, &descriptor);
+    AppendUint32(static_cast<uint32>(compressed_size_), &descriptor);
+    AppendUint32(static_cast<uint32>(uncompressed_size_), &descriptor);
+
+    std::vector<uint8>& entry = central_directory_;
+    AppendUint32(kCentralFileHeaderSignature, &entry);
+    AppendUint16(kVersionNeeded, &entry);  // Version made by.
+    AppendFileInfo(file_crc_, static_cast<uint32>(compressed_size_),
+                   static_cast<uint32>(uncompressed_size_), &entry);
+    AppendUint16(0U, &entry);  // Extra field length.
+    AppendUint16(0U, &entry);  // File comment length.
+    AppendUint16(0U, &entry);  // Disk number start.
+    AppendUint16(0U, &entry);  // Internal file attributes.
+    AppendUint32(0U, &entry);  // External file attributes.
+    AppendUint32(static_cast<uint32>(local_header_offset_), &entry);
+    entry.insert(entry.end(), filename_.begin(), filename_.end());
+    ++entry_count_;
+    return WriteData(descriptor);
+  }
+
+  bool Finish() {
+    if (is_finished_)
+      return !has_error_;
+    if (is_in_file_)
+      EndFile();
+    is_finished_ = true;
+    if (has_error_)
+      return false;
+    if (entry_count_ > 0xffff)
+      return SetError("archive has more than 65535 files");
+    const uint64 directory_offset = bytes_written_;
+    if (directory_offset + central_directory_.size() > kMaxZipSize)
+      return SetError("archive exceeds 4 GB");
+
+    std::vector<uint8> end;
+    AppendUint32(kEndOfCentralDirectorySignature, &end);
+    AppendUint16(0U, &end);  // Number of this disk.
+    AppendUint16(0U, &end);  // Disk where the central directory starts.
+    AppendUint16(static_cast<uint16>(entry_count_), &end);
+    AppendUint16(static_cast<uint16>(entry_count_), &end);
+    AppendUint32(static_cast<uint32>(central_directory_.size()), &end);
+    AppendUint32(static_cast<uint32>(directory_offset), &end);
+    AppendUint16(0U, &end);  // Comment length.
+    return WriteData(central_directory_) && WriteData(end);
+  }
+
+  uint64 GetBytesWritten() const { return bytes_written_; }
+
+  // WorkerPool::Worker implementation.
+  void DoWork() override {
+    Block* block = NULL;
+    {
+      LockGuard guard(&mutex_);
+      if (queue_.empty())
+        return;
+      block = queue_.front();
+      queue_.pop_front();
+    }
+    CompressBlock(block);
+    block->done.Post();
+  }
+  const std::string& GetName() const override {
+    static const std::string kName("Ion zip stream compression worker");
+    return kName;
+  }
+
+ private:
+  // Appends the fields of a file header that are shared by local and central
+  // headers, from the version needed to extract through the filename length.
+  void AppendFileInfo(uint32 crc, uint32 compressed_size,
+                      uint32 uncompressed_size, std::vector<uint8>* out) {
+    AppendUint16(kVersionNeeded, out);
+    AppendUint16(kDataDescriptorFlag, out);
+    AppendUint16(kDeflatedMethod, out);
+    AppendUint16(0U, out);  // Last modification time.
+    AppendUint16(kDosDate, out);
+    AppendUint32(crc, out);
+    AppendUint32(compressed_size, out);
+    AppendUint32(uncompressed_size, out);
+    AppendUint16(static_cast<uint16>(filename_.size()), out);
+  }
+
+  // Queues the current block for compression. To bound the memory used,
+  // compressed blocks are written once there are more than two per thread
+  // waiting.
+  void SubmitBlock(bool is_last) {
+    Block* block = current_block_.get();
+    block->is_last = is_last;
+    blocks_.push_back(std::move(current_block_));
+    if (thread_count_) {
+      {
+        LockGuard guard(&mutex_);
+        queue_.push_back(block);
+      }
+      pool_.GetWorkSemaphore()->Post();
+    } else {
+      CompressBlock(block);
+      block->done.Post();
+    }
+    const size_t max_block_count = std::max(thread_count_ * 2U, size_t(1U));
+    while (blocks_.size() > max_block_count)
+      WriteFirstBlock();
+  }
+
+  // Waits for the first queued block to be compressed and writes it.
+  void WriteFirstBlock() {
+    std::unique_ptr<Block> block(std::move(blocks_.front()));
+    blocks_.pop_front();
+    block->done.Wait();
+    if (!block->is_compressed) {
+      SetError("failed to compress file '" + filename_ + "'");
+      return;
+    }
+    const uLong input_size = static_cast<uLong>(block->input.size());
+    file_crc_ = static_cast<uint32>(
+        crc32_combine(file_crc_, block->crc, input_size));
+    uncompressed_size_ += input_size;
+    compressed_size_ += block->output.size();
+    WriteData(block->output);
+  }
+
+  // Passes data to the sink unless an error has occurred.
+  bool WriteData(const std::vector<uint8>& data) {
+    if (has_error_)
+      return false;
+    if (data.empty())
+      return true;
+    if (!sink_(&data[0], data.size()))
+      return SetError("failed to write to the sink");
+    bytes_written_ += data.size();
+    return true;
+  }
+
+  // Logs an error and puts the writer in the error state. Returns false.
+  bool SetError(const std::string& message) {
+    LOG(ERROR) << "ZipStreamWriter: " << message;
+    has_error_ = true;
+    return false;
+  }
+
+  const Sink sink_;
+  const size_t thread_count_;
+  uint64 bytes_written_;
+  // Central directory entries of the files written so far.
+  std::vector<uint8> central_directory_;
+  size_t entry_count_;
+
+  // State of the current file.
+  std::string filename_;
+  uint64 local_header_offset_;
+  uint32 file_crc_;
+  uint64 compressed_size_;
+  uint64 uncompressed_size_;
+  // The block being filled by Write().
+  std::unique_ptr<Block> current_block_;
+  // Blocks submitted for compression, in file order.
+  std::deque<std::unique_ptr<Block>> blocks_;
+
+  bool is_in_file_;
+  bool is_finished_;
+  bool has_error_;
+
+  // Blocks waiting for a worker thread.
+  port::Mutex mutex_;
+  std::deque<Block*> queue_;
+  // This must be last so that its threads stop before anything else is
+  // destroyed.
+  WorkerPool pool_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// ZipStreamReader::Impl class.
+//
+//-----------------------------------------------------------------------------
+
+class ZipStreamReader::Impl {
+ public:
+  explicit Impl(const Source& source)
+      : source_(source),
+        buffer_(kReadBufferSize),
+        position_(0U),
+        end_(0U),
+        flags_(0U),
+        method_(0U),
+        expected_crc_(0U),
+        expected_size_(0U),
+        stored_remaining_(0U),
+        crc_(0U),
+        size_(0U),
+        is_in_file_(false),
+        is_at_end_(false),
+        has_error_(false) {
+    memset(&stream_, 0, sizeof(stream_));
+    is_stream_valid_ = inflateInit2(&stream_, -MAX_WBITS) == Z_OK;
+  }
+  ~Impl() {
+    if (is_stream_valid_)
+      inflateEnd(&stream_);
+  }
+
+  bool NextFile() {
+    // Skip the rest of the current file.
+    if (is_in_file_) {
+      uint8 scratch[4096];
+      while (Read(scratch, sizeof(scratch))) {}
+    }
+    filename_.clear();
+    if (has_error_ || is_at_end_)
+      return false;
+
+    if (!Fill(4U)) {
+      // An empty source holds no files.
+      is_at_end_ = true;
+      return GetAvailable() ? SetError("truncated archive") : false;
+    }
+    const uint32 signature = GetUint32(&buffer_[position_]);
+    if (signature == kCentralFileHeaderSignature ||
+        signature == kEndOfCentralDirectorySignature) {
+      is_at_end_ = true;
+      return false;
+    }
+    if (signature != kLocalFileHeaderSignature)
+      return SetError("invalid local file header");
+    if (!Fill(kLocalFileHeaderSize))
+      return SetError("truncated local file header");
+
+    const uint8* header = &buffer_[position_];
+    flags_ = GetUint16(header + 6);
+    method_ = GetUint16(header + 8);
+    expected_crc_ = GetUint32(header + 14);
+    const uint32 compressed_size = GetUint32(header + 18);
+    expected_size_ = GetUint32(header + 22);
+    const size_t filename_length = GetUint16(header + 26);
+    const size_t extra_length = GetUint16(header + 28);
+    position_ += kLocalFileHeaderSize;
+    if (!Consume(filename_length, &filename_) || !Consume(extra_length, NULL))
+      return SetError("truncated local file header");
+
+    if (method_ == kStoredMethod) {
+      // The end of stored data can only be found from its size.
+      if (flags_ & kDataDescriptorFlag)
+        return SetError("stored file '" + filename_ +
+                        "' has no size in its local header");
+      stored_remaining_ = compressed_size;
+    } else if (method_ == kDeflatedMethod) {
+      if (!is_stream_valid_ || inflateReset(&stream_) != Z_OK)
+        return SetError("failed to initialize decompression");
+    } else {
+      return SetError("unsupported compression method for file '" +
+                      filename_ + "'");
+    }
+    crc_ = 0U;
+    size_ = 0U;
+    is_in_file_ = true;
+    return true;
+  }
+
+  const std::string& GetFilename() const { return filename_; }
+
+  size_t Read(void* data, size_t size) {
+    if (!is_in_file_ || has_error_ || !size)
+      return 0U;
+    uint8* out = static_cast<uint8*>(data);
+    size_t count = 0U;
+    bool is_file_done = false;
+    if (method_ == kStoredMethod) {
+      while (count < size && stored_remaining_) {
+        if (!GetAvailable() && !Refill()) {
+          SetError("truncated data for file '" + filename_ + "'");
+          break;
+        }
+        const size_t chunk_size = static_cast<size_t>(std::min<uint64>(
+            std::min(size - count, GetAvailable()), stored_remaining_));
+        memcpy(out + count, &buffer_[position_], chunk_size);
+        position_ += chunk_size;
+        stored_remaining_ -= chunk_size;
+        count += chunk_size;
+      }
+      is_file_done = !stored_remaining_;
+    } else {
+      stream_.next_out = out;
+      stream_.avail_out = static_cast<uInt>(size);
+      while (stream_.avail_out) {
+        if (!GetAvailable() && !Refill()) {
+          SetError("truncated data for file '" + filename_ + "'");
+          break;
+        }
+        stream_.next_in = &buffer_[position_];
+        stream_.avail_in = static_cast<uInt>(GetAvailable());
+        const int result = inflate(&stream_, Z_NO_FLUSH);
+        position_ = end_ - stream_.avail_in;
+        if (result == Z_STREAM_END) {
+          is_file_done = true;
+          break;
+        } else if (result != Z_OK) {
+          SetError("invalid compressed data in file '" + filename_ + "'");
+          break;
+        }
+      }
+      count = size - stream_.avail_out;
+    }
+    crc_ = static_cast<uint32>(crc32(crc_, out, static_cast<uInt>(count)));
+    size_ += count;
+    if (is_file_done)
+      FinishFile();
+    return has_error_ ? 0U : count;
+  }
+
+  bool ReadFile(std::string* data) {
+    data->clear();
+    char chunk[4096];
+    while (const size_t count = Read(chunk, sizeof(chunk)))
+      data->append(chunk, count);
+    return !has_error_;
+  }
+
+  bool HasError() const { return has_error_; }
+
+ private:
+  size_t GetAvailable() const { return end_ - position_; }
+
+  // Moves any unread data to the start of the buffer and reads more from the
+  // source after it. Returns whether any data was read.
+  bool Refill() {
+    const size_t available = GetAvailable();
+    if (available && position_)
+      memmove(&buffer_[0], &buffer_[position_], available);
+    position_ = 0U;
+    end_ = available;
+    const size_t count = source_(&buffer_[end_], buffer_.size() - end_);
+    end_ += count;
+    return count > 0U;
+  }
+
+  // Reads until at least count bytes are available. Returns false if the
+  // source ends first.
+  bool Fill(size_t count) {
+    DCHECK_LE(count, buffer_.size());
+    while (GetAvailable() < count) {
+      if (!Refill())
+        return false;
+    }
+    return true;
+  }
+
+  // Consumes count bytes, appending them to out if it is not NULL. Returns
+  // false if the source ends first.
+  bool Consume(size_t count, std::string* out) {
+    if (out)
+      out->clear();
+    while (count) {
+      if (!GetAvailable() && !Refill())
+        return false;
+      const size_t chunk_size = std::min(count, GetAvailable());
+      if (out) {
+        out->append(reinterpret_cast<const char*>(&buffer_[position_]),
+                    chunk_size);
+      }
+      position_ += chunk_size;
+      count -= chunk_size;
+    }
+    return true;
+  }
+
+  // Reads the data descriptor of the current file, if it has one, and
+  // verifies the checksum and size of the data read.
+  void FinishFile() {
+    is_in_file_ = false;
+    if (flags_ & kDataDescriptorFlag) {
+      // The signature of the data descriptor is optional.
+      if (Fill(4U) &&
+          GetUint32(&buffer_[position_]) == kDataDescriptorSignature)
+        position_ += 4U;
+      if (!Fill(kDataDescriptorSize)) {
+        SetError("truncated data descriptor for file '" + filename_ + "'");
+        return;
+      }
+      expected_crc_ = GetUint32(&buffer_[position_]);
+      expected_size_ = GetUint32(&buffer_[position_ + 8U]);
+      position_ += kDataDescriptorSize;
+    }
+    if (crc_ != expected_crc_ || size_ != expected_size_)
+      SetError("checksum mismatch in file '" + filename_ + "'");
+  }
+
+  // Logs an error and puts the reader in the error state. Returns false.
+  bool SetError(const std::string& message) {
+    LOG(ERROR) << "ZipStreamReader: " << message;
+    has_error_ = true;
+    is_in_file_ = false;
+    return false;
+  }
+
+  const Source source_;
+  // Data read from the source; the unread part is [position_, end_).
+  std::vector<uint8> buffer_;
+  size_t position_;
+  size_t end_;
+  z_stream stream_;
+  bool is_stream_valid_;
+
+  // State of the current file.
+  std::string filename_;
+  uint16 flags_;
+  uint16 method_;
+  uint32 expected_crc_;
+  uint64 expected_size_;
+  uint64 stored_remaining_;
+  uint32 crc_;
+  uint64 size_;
+
+  bool is_in_file_;
+  bool is_at_end_;
+  bool has_error_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// ZipStreamWriter functions.
+//
+//-----------------------------------------------------------------------------
+
+const size_t ZipStreamWriter::kBlockSize = 128U * 1024U;
+
+ZipStreamWriter::ZipStreamWriter(const Sink& sink, size_t thread_count)
+    : impl_(new Impl(sink, thread_count)) {}
+
+ZipStreamWriter::~ZipStreamWriter() { impl_->Finish(); }
+
+bool ZipStreamWriter::BeginFile(const std::string& filename) {
+  return impl_->BeginFile(filename);
+}
+
+bool ZipStreamWriter::Write(const void* data, size_t size) {
+  return impl_->Write(data, size);
+}
+
+bool ZipStreamWriter::EndFile() { return impl_->EndFile(); }
+
+bool ZipStreamWriter::AddFile(const std::string& filename,
+                              const std::string& data) {
+  return BeginFile(filename) && Write(data.data(), data.size()) && EndFile();
+}
+
+bool ZipStreamWriter::Finish() { return impl_->Finish(); }
+
+uint64 ZipStreamWriter::GetBytesWritten() const {
+  return impl_->GetBytesWritten();
+}
+
+//-----------------------------------------------------------------------------
+//
+// ZipStreamReader functions.
+//
+//-----------------------------------------------------------------------------
+
+ZipStreamReader::ZipStreamReader(const Source& source)
+    : impl_(new Impl(source)) {}
+
+ZipStreamReader::~ZipStreamReader() {}
+
+bool ZipStreamReader::NextFile() { return impl_->NextFile(); }
+
+const std::string& ZipStreamReader::GetFilename() const {
+  return impl_->GetFilename();
+}
+
+size_t ZipStreamReader::Read(void* data, size_t size) {
+  return impl_->Read(data, size);
+}
+
+bool ZipStreamReader::ReadFile(std::string* data) {
+  return impl_->ReadFile(data);
+}
+
+bool ZipStreamReader::HasError() const { return impl_->HasError(); }
+
+}  // namespace base
+}  // namespace ion
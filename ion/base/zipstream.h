@@ -0,0 +1,149 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_BASE_ZIPSTREAM_H_
+#define ION_BASE_ZIPSTREAM_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+
+namespace ion {
+namespace base {
+
+// A ZipStreamWriter writes a ZIP archive sequentially to a sink function as
+// files are added, so that archives of traces or captures hundreds of MB in
+// size never have to be held in memory; only the blocks being compressed and
+// the central directory are kept. Each file is split into blocks that are
+// compressed in parallel on a pool of threads and written in order, in the
+// same way as pigz. Since sizes and checksums are only known once a file has
+// been written, they follow its data in a data descriptor.
+//
+// Typical usage:
+//   ZipStreamWriter writer(
+//       [&out](const uint8* data, size_t size) {
+//         return out.write(reinterpret_cast<const char*>(data), size).good();
+//       }, 4U);
+//   writer.BeginFile("trace.json");
+//   while (...)
+//     writer.Write(chunk.data(), chunk.size());
+//   writer.EndFile();
+//   writer.Finish();
+//
+// Archives are limited to 4 GB, since ZIP64 is not supported.
+class ZipStreamWriter {
+ public:
+  // A function that writes size bytes of the archive, returning whether it
+  // succeeded.
+  typedef std::function<bool(const uint8* data, size_t size)> Sink;
+
+  // The size of the blocks that files are split into.
+  static const size_t kBlockSize;
+
+  // Constructs a writer that writes to sink, compressing blocks on
+  // thread_count threads. If thread_count is 0, blocks are compressed on the
+  // calling thread.
+  ZipStreamWriter(const Sink& sink, size_t thread_count);
+  // The destructor calls Finish() if it has not been called.
+  ~ZipStreamWriter();
+
+  // Starts a new file in the archive, ending any file in progress. The
+  // filename may be any relative path, e.g., "foo/bar/bat.ext". Returns false
+  // if an error has occurred or Finish() has been called.
+  bool BeginFile(const std::string& filename);
+  // Appends size bytes of data to the current file. Returns false if there is
+  // no current file or an error has occurred.
+  bool Write(const void* data, size_t size);
+  // Ends the current file, waiting for all of its blocks to be compressed and
+  // written. Returns false if there is no current file or an error occurred.
+  bool EndFile();
+  // Convenience function that adds a file holding data.
+  bool AddFile(const std::string& filename, const std::string& data);
+
+  // Ends any file in progress and writes the central directory, completing
+  // the archive. Returns whether the whole archive was written successfully.
+  // Nothing can be written after this is called.
+  bool Finish();
+
+  // Returns the number of bytes passed to the sink so far.
+  uint64 GetBytesWritten() const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZipStreamWriter);
+};
+
+// A ZipStreamReader reads the files of a ZIP archive sequentially from a
+// source function, decompressing them as they are read, without seeking or
+// holding the archive in memory. It reads the local file headers rather than
+// the central directory, and handles files with and without data descriptors,
+// such as those written by ZipStreamWriter and MemoryZipStream. Stored
+// (uncompressed) files must have their sizes in their local header.
+//
+// Typical usage:
+//   ZipStreamReader reader(source);
+//   while (reader.NextFile()) {
+//     const std::string& name = reader.GetFilename();
+//     while (size_t size = reader.Read(buffer, sizeof(buffer)))
+//       ...
+//   }
+//   if (reader.HasError())
+//     ...
+class ZipStreamReader {
+ public:
+  // A function that reads up to size bytes of the archive into data, returning
+  // the number of bytes read, or 0 at the end of the archive.
+  typedef std::function<size_t(uint8* data, size_t size)> Source;
+
+  explicit ZipStreamReader(const Source& source);
+  ~ZipStreamReader();
+
+  // Advances to the next file in the archive, skipping any unread data of the
+  // current file. Returns false when there are no more files or an error
+  // occurred.
+  bool NextFile();
+  // Returns the name of the current file.
+  const std::string& GetFilename() const;
+
+  // Reads up to size bytes of the current file's uncompressed data into data,
+  // returning the number of bytes read, or 0 at the end of the file. The
+  // checksum of the file is verified when its end is reached.
+  size_t Read(void* data, size_t size);
+  // Convenience function that reads the rest of the current file into data.
+  // Returns false if an error occurred.
+  bool ReadFile(std::string* data);
+
+  // Returns whether an error occurred, such as malformed data, a checksum
+  // mismatch, or an unsupported compression method. Errors are also logged.
+  bool HasError() const;
+
+ private:
+  class Impl;
+  std::unique_ptr<Impl> impl_;
+
+  DISALLOW_COPY_AND_ASSIGN(ZipStreamReader);
+};
+
+}  // namespace base
+}  // namespace ion
+
+#endif  // ION_BASE_ZIPSTREAM_H_
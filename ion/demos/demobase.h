@@ -31,6 +31,9 @@ limitations under the License.
 //-----------------------------------------------------------------------------
 
 namespace ion {
+namespace gfx {
+class GraphicsManager;
+}  // namespace gfx
 namespace remote {
 class RemoteServer;
 }  // namespace remote
@@ -59,6 +62,12 @@ class DemoBase {
     return name;
   }
 
+  // Returns the GraphicsManager the demo renders with, or NULL if it does not
+  // expose one. The benchmark driver uses it to count OpenGL calls.
+  virtual ion::gfx::GraphicsManager* GetDemoGraphicsManager() const {
+    return NULL;
+  }
+
 #if !ION_PRODUCTION
   static ion::remote::RemoteServer* GetRemoteServer() {
     return remote_.get();
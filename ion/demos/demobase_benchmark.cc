@@ -0,0 +1,300 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// This driver runs a demo headlessly as a benchmark. Rather than responding to
+// a window system, it renders into an offscreen Visual and drives the demo
+// with a deterministic script, so that every run of a demo performs exactly the
+// same work frame for frame:
+//
+//  - The camera is dragged around a circle, completing one revolution every
+//    --orbit_frames frames, while the zoom oscillates with the same period.
+//  - Every --key_interval frames the next character of --keys is pressed and
+//    released, which mutates the scene through the demo's own keyboard
+//    handling.
+//
+// The benchmark runs for a fixed number of --frames, or for --duration seconds
+// if that is positive; a timed run executes a prefix of the same script. The
+// first --warmup_frames frames are not measured. The results are reported
+// through an analytics::Benchmark, printed either in the pretty format or as
+// JSON: the distribution of frame times, the CPU time spent in each stage of a
+// frame, and the number of OpenGL calls made per frame if the demo exposes its
+// GraphicsManager. For example:
+//
+//   particles_benchmark --frames=1000 --keys=pt --key_interval=100 --json
+//
+// The offscreen Visual's default framebuffer may be smaller than the demo's
+// viewport, so fill-rate costs are not representative; the driver measures
+// the CPU cost of the demo and the OpenGL work it submits.
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>  // NOLINT
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/analytics/benchmark.h"
+#include "ion/analytics/benchmarkutils.h"
+#include "ion/base/logging.h"
+#include "ion/base/serialize.h"
+#include "ion/base/setting.h"
+#include "ion/demos/demobase.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/port/timer.h"
+#include "ion/portgfx/visual.h"
+
+namespace {
+
+using ion::analytics::Benchmark;
+
+static const char kGroup[] = "Demo";
+static const char kSettingPrefix[] = "demo_benchmark/";
+
+// The length of the run and the parameters of the script.
+struct BenchmarkSettings {
+  BenchmarkSettings()
+      : frames("demo_benchmark/frames", 600,
+               "Number of measured frames, if duration is not positive"),
+        duration("demo_benchmark/duration", 0.0,
+                 "Length of the measured run in seconds, if positive"),
+        warmup_frames("demo_benchmark/warmup_frames", 30,
+                      "Number of frames run before measuring starts"),
+        width("demo_benchmark/width", 800, "Width of the viewport"),
+        height("demo_benchmark/height", 800, "Height of the viewport"),
+        orbit_frames("demo_benchmark/orbit_frames", 240,
+                     "Number of frames for one revolution of the camera"),
+        keys("demo_benchmark/keys", "",
+             "Keys pressed in turn to mutate the scene"),
+        key_interval("demo_benchmark/key_interval", 60,
+                     "Number of frames between key presses"),
+        json("demo_benchmark/json", false,
+             "Whether to print the results as JSON") {}
+
+  ion::base::Setting<int> frames;
+  ion::base::Setting<double> duration;
+  ion::base::Setting<int> warmup_frames;
+  ion::base::Setting<int> width;
+  ion::base::Setting<int> height;
+  ion::base::Setting<int> orbit_frames;
+  ion::base::Setting<std::string> keys;
+  ion::base::Setting<int> key_interval;
+  ion::base::Setting<bool> json;
+};
+
+// The times spent in each stage of the measured frames, in milliseconds.
+struct FrameTimes {
+  std::vector<double> update;
+  std::vector<double> render;
+  std::vector<double> finish;
+  std::vector<double> frame;
+};
+
+// Applies the scripted input for the passed frame index to demo.
+static void RunScript(const BenchmarkSettings& settings, int frame,
+                      DemoBase* demo) {
+  // The camera is dragged around a circle centered in the viewport.
+  const float center_x = static_cast<float>(settings.width) * 0.5f;
+  const float center_y = static_cast<float>(settings.height) * 0.5f;
+  const float radius = std::min(center_x, center_y) * 0.5f;
+  const float angle = static_cast<float>(2.0 * M_PI) *
+                      static_cast<float>(frame % settings.orbit_frames) /
+                      static_cast<float>(settings.orbit_frames);
+  demo->ProcessMotion(center_x + radius * std::cos(angle),
+                      center_y + radius * std::sin(angle), frame == 0);
+  demo->ProcessScale(1.f + 0.5f * std::sin(angle));
+
+  const std::string& keys = settings.keys;
+  if (!keys.empty() && frame > 0 && frame % settings.key_interval == 0) {
+    const size_t index =
+        static_cast<size_t>(frame / settings.key_interval - 1) % keys.size();
+    const int key = keys[index];
+    demo->Keyboard(key, 0, 0, true);
+    demo->Keyboard(key, 0, 0, false);
+  }
+}
+
+// Runs one frame of demo, adding the time spent in each stage to times if it
+// is not NULL.
+static void RunFrame(DemoBase* demo, ion::gfx::GraphicsManager* gm,
+                     FrameTimes* times) {
+  ion::port::Timer frame_timer;
+  ion::port::Timer timer;
+  demo->Update();
+  const double update_time = timer.GetInMs();
+  timer.Reset();
+  demo->Render();
+  const double render_time = timer.GetInMs();
+  // Waiting for OpenGL to finish keeps frames from overlapping, so that each
+  // frame's time includes the work it submitted.
+  timer.Reset();
+  if (gm)
+    gm->Finish();
+  const double finish_time = timer.GetInMs();
+  if (times) {
+    times->update.push_back(update_time);
+    times->render.push_back(render_time);
+    times->finish.push_back(finish_time);
+    times->frame.push_back(frame_timer.GetInMs());
+  }
+}
+
+// Adds a per-frame time distribution to benchmark.
+static void AddTime(const std::string& id, const std::string& description,
+                    const std::vector<double>& times, Benchmark* benchmark) {
+  Benchmark::VariableAccumulator accumulator(
+      Benchmark::Descriptor(id, kGroup, description, "ms/frame"));
+  for (size_t i = 0; i < times.size(); ++i)
+    accumulator.AddSample(times[i]);
+  benchmark->AddAccumulatedVariable(accumulator.Get());
+}
+
+// Adds the given percentile of the sorted frame times to benchmark.
+static void AddPercentile(int percentile, const std::vector<double>& sorted,
+                          Benchmark* benchmark) {
+  const size_t index = std::min(
+      sorted.size() - 1U, sorted.size() * static_cast<size_t>(percentile) /
+                              100U);
+  const std::string name = ion::base::ValueToString(percentile);
+  benchmark->AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("frame_p" + name, kGroup,
+                            "Frame time at the " + name + "th percentile",
+                            "ms"),
+      sorted[index]));
+}
+
+// Adds a count accumulated over frame_count frames to benchmark as a
+// per-frame average.
+static void AddPerFrame(const std::string& id, const std::string& description,
+                        const std::string& units, uint64 count,
+                        size_t frame_count, Benchmark* benchmark) {
+  benchmark->AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor(id, kGroup, description, units),
+      static_cast<double>(count) / static_cast<double>(frame_count)));
+}
+
+}  // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkSettings settings;
+  if (!ion::analytics::ParseSettingArguments(kSettingPrefix, argc, argv) ||
+      settings.frames < 1 ||
+      settings.warmup_frames < 0 || settings.width < 1 ||
+      settings.height < 1 || settings.orbit_frames < 1 ||
+      settings.key_interval < 1) {
+    ion::analytics::PrintSettingUsage(kSettingPrefix, argv[0], std::cerr);
+    return 1;
+  }
+
+  std::unique_ptr<ion::portgfx::Visual> visual =
+      ion::portgfx::Visual::CreateVisual();
+  if (!visual || !visual->IsValid() ||
+      !ion::portgfx::Visual::MakeCurrent(visual.get())) {
+    LOG(ERROR) << "Unable to create an OpenGL context";
+    return 1;
+  }
+
+  Benchmark benchmark;
+  std::unique_ptr<DemoBase> demo;
+  ion::gfx::GraphicsManager* gm = NULL;
+  {
+    // The first frame usually creates most resources, so it is reported
+    // together with the demo's setup.
+    ion::port::Timer timer;
+    demo.reset(CreateDemo(settings.width, settings.height));
+    demo->Resize(settings.width, settings.height);
+    gm = demo->GetDemoGraphicsManager();
+    RunFrame(demo.get(), gm, NULL);
+    benchmark.AddConstant(Benchmark::Constant(
+        Benchmark::Descriptor("startup", kGroup,
+                              "Time to create the demo and draw the first "
+                              "frame", "ms"),
+        timer.GetInMs()));
+  }
+
+  int frame = 0;
+  for (int i = 0; i < settings.warmup_frames; ++i, ++frame) {
+    RunScript(settings, frame, demo.get());
+    RunFrame(demo.get(), gm, NULL);
+  }
+
+  if (gm) {
+    gm->ResetCallStatistics();
+    gm->EnableCallStatistics(true);
+  }
+  FrameTimes times;
+  const double duration_ms = settings.duration * 1000.0;
+  ion::port::Timer run_timer;
+  while (duration_ms > 0.0 ? run_timer.GetInMs() < duration_ms
+                           : static_cast<int>(times.frame.size()) <
+                                 settings.frames) {
+    RunScript(settings, frame++, demo.get());
+    RunFrame(demo.get(), gm, &times);
+  }
+  const double run_time = run_timer.GetInMs();
+  const size_t frame_count = times.frame.size();
+
+  benchmark.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("frames", kGroup, "Measured frames", "frames"),
+      static_cast<double>(frame_count)));
+  benchmark.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("fps", kGroup, "Measured frames per second",
+                            "frames/s"),
+      static_cast<double>(frame_count) * 1000.0 / run_time));
+  AddTime("frame", "Time for a whole frame", times.frame, &benchmark);
+  AddTime("update", "CPU time spent in the demo's Update()", times.update,
+          &benchmark);
+  AddTime("render", "CPU time spent in the demo's Render()", times.render,
+          &benchmark);
+  AddTime("finish", "Time spent waiting for OpenGL to finish the frame",
+          times.finish, &benchmark);
+  std::vector<double> sorted(times.frame);
+  std::sort(sorted.begin(), sorted.end());
+  AddPercentile(50, sorted, &benchmark);
+  AddPercentile(90, sorted, &benchmark);
+  AddPercentile(99, sorted, &benchmark);
+
+  if (gm) {
+    gm->EnableCallStatistics(false);
+    const ion::gfx::GraphicsManager::CallStatistics stats =
+        gm->GetCallStatistics();
+    AddPerFrame("gl_calls", "OpenGL calls made per frame", "calls/frame",
+                stats.call_count, frame_count, &benchmark);
+    AddPerFrame("draw_calls", "OpenGL draw calls made per frame",
+                "calls/frame", stats.draw_call_count, frame_count, &benchmark);
+    AddPerFrame("primitives", "Primitives drawn per frame",
+                "primitives/frame", stats.primitive_count, frame_count,
+                &benchmark);
+    AddPerFrame("buffer_uploads", "Bytes of buffer data uploaded per frame",
+                "bytes/frame", stats.buffer_upload_bytes, frame_count,
+                &benchmark);
+    AddPerFrame("texture_uploads", "Bytes of texture data uploaded per frame",
+                "bytes/frame", stats.texture_upload_bytes, frame_count,
+                &benchmark);
+  } else {
+    LOG(WARNING) << demo->GetDemoClassName() << " does not expose its "
+                 << "GraphicsManager; OpenGL calls are not counted";
+  }
+
+  if (settings.json) {
+    ion::analytics::OutputBenchmarkAsJson(benchmark, "", std::cout);
+  } else {
+    ion::analytics::OutputBenchmarkPretty(
+        demo->GetDemoClassName() + " benchmark", true, benchmark, std::cout);
+  }
+  demo.reset();
+  return 0;
+}
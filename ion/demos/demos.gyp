@@ -341,5 +341,118 @@
       ],
     },
 
+
+    # Headless benchmark variants of the demos. These are plain executables on
+    # every platform, so they can also be copied to and run on a device.
+    {
+      'target_name': 'particles_benchmark',
+      'includes': [ 'demobenchmark.gypi', ],
+      'variables': {
+        'demo_class_name': 'Particles'
+      },
+      'sources': [
+        'particles.cc',
+      ],
+      'dependencies': [
+        ':particles_assets',
+        '<(ion_dir)/external/freetype2.gyp:ionfreetype2',
+      ],
+    },
+
+    {
+      'target_name': 'shapedemo_benchmark',
+      'includes': [ 'demobenchmark.gypi', ],
+      'variables': {
+        'demo_class_name': 'ShapeDemo'
+      },
+      'sources': [
+        'shapedemo.cc',
+      ],
+      'dependencies': [
+        'shapedemo_assets',
+      ],
+    },
+
+    {
+      'target_name': 'textdemo_benchmark',
+      'includes': [ 'demobenchmark.gypi', ],
+      'variables': {
+        'demo_class_name': 'TextDemo'
+      },
+      'sources': [
+        'textdemo.cc',
+      ],
+      'dependencies': [
+        ':textdemo_assets',
+        '<(ion_dir)/external/freetype2.gyp:ionfreetype2',
+        '<(ion_dir)/external/icu.gyp:ionicu',
+      ],
+    },
+
+    {
+      'target_name': 'threadingdemo_benchmark',
+      'includes': [ 'demobenchmark.gypi', ],
+      'variables': {
+        'demo_class_name': 'ThreadingDemo'
+      },
+      'sources': [
+        'threadingdemo.cc',
+      ],
+      'dependencies': [
+        ':threadingdemo_assets',
+      ],
+    },
+
+    {
+      'target_name': 'volatilescene_benchmark',
+      'includes': [ 'demobenchmark.gypi', ],
+      'variables': {
+        'demo_class_name': 'VolatileScene'
+      },
+      'sources': [
+        'volatilescene.cc',
+      ],
+    },
+
+    {
+      # Measures the time to start up and draw the first frame of a scene with
+      # text, textures and composed shaders, cold and with warm caches; see the
+      # comment at the top of startup_benchmark.cc for its phases.
+      'target_name': 'startup_benchmark',
+      'type': 'executable',
+      'product_dir': '<(PRODUCT_DIR)/demos',
+      'sources': [
+        'startup_benchmark.cc',
+      ],
+      'dependencies': [
+        ':shapedemo_assets',
+        ':textdemo_assets',
+        '<(ion_dir)/analytics/analytics.gyp:ionanalytics',
+        '<(ion_dir)/base/base.gyp:ionbase',
+        '<(ion_dir)/demos/demolib.gyp:iondemo',
+        '<(ion_dir)/external/external.gyp:ionstblib',
+        '<(ion_dir)/external/external.gyp:ionzlib',
+        '<(ion_dir)/external/freetype2.gyp:ionfreetype2',
+        '<(ion_dir)/external/icu.gyp:ionicu',
+        '<(ion_dir)/external/imagecompression.gyp:ionimagecompression',
+        '<(ion_dir)/gfx/gfx.gyp:iongfx',
+        '<(ion_dir)/gfxutils/gfxutils.gyp:iongfxutils',
+        '<(ion_dir)/image/image.gyp:ionimage',
+        '<(ion_dir)/math/math.gyp:ionmath',
+        '<(ion_dir)/port/port.gyp:ionport',
+        '<(ion_dir)/portgfx/portgfx.gyp:ionportgfx',
+        '<(ion_dir)/profile/profile.gyp:ionprofile',
+        '<(ion_dir)/text/text.gyp:iontext',
+      ],
+      'conditions' : [
+        ['OS == "windows"', {
+          'libraries': [
+            '-ladvapi32',
+            '-lwinmm',
+          ],
+        }],
+      ],
+    },
+
   ],
 }
@@ -134,6 +134,9 @@ class IonSimpleDraw : public DemoBase {
   void ProcessMotion(float x, float y, bool is_press) override {}
   void ProcessScale(float scale) override {}
   std::string GetDemoClassName() const override { return "IonSimpleDraw"; }
+  ion::gfx::GraphicsManager* GetDemoGraphicsManager() const override {
+    return graphics_manager_.Get();
+  }
 
  private:
   ion::gfx::GraphicsManagerPtr graphics_manager_;
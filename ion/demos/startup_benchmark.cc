@@ -0,0 +1,425 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// This program measures how long Ion takes to start up and draw its first
+// frame, broken down into the phases of a typical application's startup:
+//
+//  - graphics_manager: creating the GraphicsManager, which looks up all
+//    OpenGL functions and queries the capabilities of the platform.
+//  - shader_input_registry: creating the global ShaderInputRegistry.
+//  - renderer: creating the Renderer and ShaderManager and setting the
+//    program binary cache.
+//  - zip_assets: registering the zipassets holding the font, shaders and
+//    images.
+//  - fonts: loading a font, its glyph cache and a StaticFontImage, and
+//    building a text Node.
+//  - scene: decoding the images and building the shapes, textures and
+//    composed shaders of the rest of the scene.
+//  - create_resources: creating the OpenGL objects of the scene, which
+//    compiles and links its shaders or loads their binaries.
+//  - pipeline_warm_up: warming up the pipelines of the scene with
+//    Renderer::WarmUpPipelines().
+//  - first_frame: drawing the scene and waiting for OpenGL to finish.
+//
+// Each phase is recorded as a scope of a CallTraceManager, and a
+// TimelineMetric turns the scopes into an analytics::Benchmark, printed either
+// in the pretty format or as JSON. The first run is cold: the program binary
+// cache and the glyph cache are empty, so shaders are compiled, glyphs are
+// rasterized and all pipelines are warmed up. It is followed by --warm_runs
+// warm runs that start from scratch with the caches the cold run stored, as
+// an application that is launched again would. Process-wide work, such as
+// registering zipassets and creating the global ShaderInputRegistry, is only
+// done by the cold run, so its phases show what that costs. For example:
+//
+//   startup_benchmark --warm_runs=10 --json
+
+#include <iostream>  // NOLINT
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/analytics/benchmark.h"
+#include "ion/analytics/benchmarkutils.h"
+#include "ion/base/logging.h"
+#include "ion/base/setting.h"
+#include "ion/base/zipassetmanagermacros.h"
+#include "ion/demos/utils.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/programbinarycache.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfxutils/shadermanager.h"
+#include "ion/gfxutils/shadersourcecomposer.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+#include "ion/port/fileutils.h"
+#include "ion/portgfx/visual.h"
+#include "ion/profile/calltracemanager.h"
+#include "ion/profile/timeline.h"
+#include "ion/profile/timelinemetric.h"
+#include "ion/profile/timelinesearch.h"
+#include "ion/text/basicbuilder.h"
+#include "ion/text/fontimage.h"
+#include "ion/text/fontmanager.h"
+#include "ion/text/layout.h"
+
+ION_REGISTER_ASSETS(IonShapeDemoResources);
+ION_REGISTER_ASSETS(TextDemoAssets);
+
+namespace {
+
+using ion::analytics::Benchmark;
+
+static const char kSettingPrefix[] = "startup_benchmark/";
+
+// The names of the scopes of the runs, which are also the groups of their
+// results.
+static const char kColdRun[] = "Cold start";
+static const char kWarmRun[] = "Warm start";
+
+// The phases of a run, in order. The names are those of their scopes and the
+// ids of their results.
+static const char kGraphicsManagerPhase[] = "graphics_manager";
+static const char kShaderInputRegistryPhase[] = "shader_input_registry";
+static const char kRendererPhase[] = "renderer";
+static const char kZipAssetsPhase[] = "zip_assets";
+static const char kFontsPhase[] = "fonts";
+static const char kScenePhase[] = "scene";
+static const char kCreateResourcesPhase[] = "create_resources";
+static const char kPipelineWarmUpPhase[] = "pipeline_warm_up";
+static const char kFirstFramePhase[] = "first_frame";
+
+struct Phase {
+  const char* name;
+  const char* description;
+};
+static const Phase kPhases[] = {
+    {kGraphicsManagerPhase, "Time to create the GraphicsManager"},
+    {kShaderInputRegistryPhase,
+     "Time to create the global ShaderInputRegistry"},
+    {kRendererPhase, "Time to create the Renderer and ShaderManager"},
+    {kZipAssetsPhase, "Time to register the zipassets"},
+    {kFontsPhase, "Time to load the font and build the text"},
+    {kScenePhase, "Time to build the rest of the scene"},
+    {kCreateResourcesPhase, "Time to create the OpenGL resources of the scene"},
+    {kPipelineWarmUpPhase, "Time to warm up the pipelines of the scene"},
+    {kFirstFramePhase, "Time to draw and finish the first frame"},
+};
+
+static const char kFontName[] = "Tuffy";
+static const char kText[] = "Time to first frame";
+
+// The number of runs and the size of the scene.
+struct BenchmarkSettings {
+  BenchmarkSettings()
+      : warm_runs("startup_benchmark/warm_runs", 5,
+                  "Number of warm runs after the cold run"),
+        width("startup_benchmark/width", 512, "Width of the viewport"),
+        height("startup_benchmark/height", 512, "Height of the viewport"),
+        font_size("startup_benchmark/font_size", 32,
+                  "Size of the font in pixels"),
+        json("startup_benchmark/json", false,
+             "Whether to print the results as JSON") {}
+
+  ion::base::Setting<int> warm_runs;
+  ion::base::Setting<int> width;
+  ion::base::Setting<int> height;
+  ion::base::Setting<int> font_size;
+  ion::base::Setting<bool> json;
+};
+
+// Keeps program binaries in memory, so that the cold run starts without any
+// and the warm runs do not depend on a writable directory.
+class MemoryStorage : public ion::gfx::ProgramBinaryCache::Storage {
+ public:
+  bool Read(const std::string& key, std::string* data) override {
+    const auto it = entries_.find(key);
+    if (it == entries_.end())
+      return false;
+    *data = it->second;
+    return true;
+  }
+  void Write(const std::string& key, const std::string& data) override {
+    entries_[key] = data;
+  }
+
+ protected:
+  ~MemoryStorage() override {}
+
+ private:
+  std::map<std::string, std::string> entries_;
+};
+
+// The caches that the cold run stores and the warm runs load.
+struct Caches {
+  ion::gfx::ProgramBinaryCache::StoragePtr program_binaries;
+  std::string glyph_cache_path;
+};
+
+// Reports the duration of each run and of each of its phases, grouped by the
+// kind of run.
+class StartupMetric : public ion::profile::TimelineMetric {
+ public:
+  void Run(const Timeline& timeline, Benchmark* benchmark) const override {
+    AddRuns(timeline, kColdRun, "cold_", benchmark);
+    AddRuns(timeline, kWarmRun, "warm_", benchmark);
+  }
+
+ private:
+  static void AddRuns(const Timeline& timeline, const char* run_name,
+                      const std::string& id_prefix, Benchmark* benchmark) {
+    std::vector<double> totals;
+    std::map<std::string, std::vector<double>> phase_times;
+    TimelineSearch runs(timeline, TimelineNode::Type::kScope, run_name);
+    for (const TimelineNode* run : runs) {
+      totals.push_back(run->GetDurationMs());
+      for (const auto& child : run->GetChildren()) {
+        if (child->GetType() == TimelineNode::Type::kScope)
+          phase_times[child->GetName()].push_back(child->GetDurationMs());
+      }
+    }
+    if (totals.empty())
+      return;
+    AddTimes(Benchmark::Descriptor(id_prefix + "time_to_first_frame",
+                                   run_name,
+                                   "Time from startup until the first frame "
+                                   "is finished", "ms"),
+             totals, benchmark);
+    for (const Phase& phase : kPhases) {
+      AddTimes(Benchmark::Descriptor(id_prefix + phase.name, run_name,
+                                     phase.description, "ms"),
+               phase_times[phase.name], benchmark);
+    }
+  }
+
+  static void AddTimes(const Benchmark::Descriptor& descriptor,
+                       const std::vector<double>& times,
+                       Benchmark* benchmark) {
+    Benchmark::VariableAccumulator accumulator(descriptor);
+    for (size_t i = 0; i < times.size(); ++i)
+      accumulator.AddSample(times[i]);
+    benchmark->AddAccumulatedVariable(accumulator.Get());
+  }
+};
+
+// Records a scope for a phase or run in the calling thread's trace.
+class PhaseTracer {
+ public:
+  PhaseTracer(ion::profile::CallTraceManager* manager, const char* name)
+      : tracer_(manager->GetTraceRecorder(),
+                manager->GetScopeEnterEvent(name)) {}
+
+ private:
+  ion::profile::ScopedTracer tracer_;
+};
+
+// Builds the textured shapes of the scene under root, using the shaders of the
+// shape demo.
+static void BuildShapes(const BenchmarkSettings& settings,
+                        const ion::gfxutils::ShaderManagerPtr& shader_manager,
+                        const ion::gfx::NodePtr& root) {
+  using ion::gfx::ShaderInputRegistry;
+  using ion::gfx::ShaderInputRegistryPtr;
+  ion::gfx::StateTablePtr state_table(
+      new ion::gfx::StateTable(settings.width, settings.height));
+  state_table->SetViewport(ion::math::Range2i::BuildWithSize(
+      ion::math::Point2i(0, 0),
+      ion::math::Vector2i(settings.width, settings.height)));
+  state_table->SetClearColor(ion::math::Vector4f(0.3f, 0.3f, 0.5f, 1.0f));
+  state_table->SetClearDepthValue(1.f);
+  state_table->Enable(ion::gfx::StateTable::kDepthTest, true);
+  root->SetStateTable(state_table);
+
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec(
+      "uTexture", ion::gfx::kTextureUniform, "Texture"));
+  reg->Add(ShaderInputRegistry::UniformSpec(
+      "uCubeMap", ion::gfx::kCubeMapTextureUniform, "CubeMapTexture"));
+  reg->Add(ShaderInputRegistry::UniformSpec(
+      "uUseCubeMap", ion::gfx::kIntUniform,
+      "Whether to use cubemap or regular texture"));
+
+  ion::gfx::NodePtr node(new ion::gfx::Node);
+  node->SetShaderProgram(shader_manager->CreateShaderProgram(
+      "Startup shapes shader", reg,
+      ion::gfxutils::ShaderSourceComposerPtr(
+          new ion::gfxutils::ZipAssetComposer("shapes.vp", false)),
+      ion::gfxutils::ShaderSourceComposerPtr(
+          new ion::gfxutils::ZipAssetComposer("shapes.fp", false))));
+  demoutils::AddUniformToNode(
+      reg, "uTexture", demoutils::LoadTextureAsset("shapes_texture_image.jpg"),
+      node);
+  demoutils::AddUniformToNode(
+      reg, "uCubeMap",
+      demoutils::LoadCubeMapAsset("shapes_cubemap_image", ".jpg"), node);
+  demoutils::AddUniformToNode(reg, "uUseCubeMap", 0, node);
+
+  ion::gfxutils::BoxSpec box_spec;
+  box_spec.translation.Set(-0.5f, 0.f, 0.f);
+  node->AddShape(ion::gfxutils::BuildBoxShape(box_spec));
+  ion::gfxutils::EllipsoidSpec ellipsoid_spec;
+  ellipsoid_spec.translation.Set(0.5f, 0.f, 0.f);
+  ellipsoid_spec.band_count = 32U;
+  ellipsoid_spec.sector_count = 32U;
+  node->AddShape(ion::gfxutils::BuildEllipsoidShape(ellipsoid_spec));
+  root->AddChild(node);
+}
+
+// Performs one startup, recording its phases with manager, and returns whether
+// it succeeded. The cold run stores the caches for the warm runs.
+static bool RunStartup(const BenchmarkSettings& settings, bool is_cold,
+                       Caches* caches,
+                       ion::profile::CallTraceManager* manager) {
+  ion::gfx::GraphicsManagerPtr gm;
+  ion::gfx::RendererPtr renderer;
+  ion::text::FontManagerPtr font_manager;
+  ion::text::FontPtr font;
+  ion::gfx::NodePtr root;
+  {
+    PhaseTracer run_tracer(manager, is_cold ? kColdRun : kWarmRun);
+    {
+      PhaseTracer tracer(manager, kGraphicsManagerPhase);
+      gm.Reset(new ion::gfx::GraphicsManager);
+    }
+    {
+      PhaseTracer tracer(manager, kShaderInputRegistryPhase);
+      ion::gfx::ShaderInputRegistry::GetGlobalRegistry();
+    }
+    ion::gfxutils::ShaderManagerPtr shader_manager;
+    {
+      PhaseTracer tracer(manager, kRendererPhase);
+      renderer.Reset(new ion::gfx::Renderer(gm));
+      renderer->SetProgramBinaryCache(ion::gfx::ProgramBinaryCachePtr(
+          new ion::gfx::ProgramBinaryCache(caches->program_binaries)));
+      shader_manager.Reset(new ion::gfxutils::ShaderManager);
+    }
+    {
+      PhaseTracer tracer(manager, kZipAssetsPhase);
+      IonShapeDemoResources::RegisterAssetsOnce();
+      TextDemoAssets::RegisterAssetsOnce();
+    }
+    root.Reset(new ion::gfx::Node);
+    {
+      PhaseTracer tracer(manager, kFontsPhase);
+      font_manager.Reset(new ion::text::FontManager);
+      font = demoutils::InitFont(font_manager, kFontName, settings.font_size,
+                                 4U);
+      if (!font.Get())
+        return false;
+      font_manager->LoadGlyphCache(font, caches->glyph_cache_path);
+      ion::text::GlyphSet glyph_set(ion::base::AllocatorPtr(NULL));
+      font->AddGlyphsForAsciiCharacterRange(32, 126, &glyph_set);
+      ion::text::StaticFontImagePtr font_image(
+          new ion::text::StaticFontImage(font, 1024U, glyph_set));
+      ion::text::BasicBuilderPtr builder(new ion::text::BasicBuilder(
+          font_image, shader_manager, ion::base::AllocatorPtr()));
+      ion::text::LayoutOptions options;
+      options.target_size.Set(0.f, 0.2f);
+      options.horizontal_alignment = ion::text::kAlignHCenter;
+      if (!builder->Build(font->BuildLayout(kText, options),
+                          ion::gfx::BufferObject::kStreamDraw))
+        return false;
+      root->AddChild(builder->GetNode());
+    }
+    {
+      PhaseTracer tracer(manager, kScenePhase);
+      BuildShapes(settings, shader_manager, root);
+      const ion::gfx::ShaderInputRegistryPtr& global_reg =
+          ion::gfx::ShaderInputRegistry::GetGlobalRegistry();
+      demoutils::AddUniformToNode(global_reg, "uProjectionMatrix",
+                                  ion::math::Matrix4f::Identity(), root);
+      demoutils::AddUniformToNode(global_reg, "uModelviewMatrix",
+                                  ion::math::Matrix4f::Identity(), root);
+    }
+    {
+      PhaseTracer tracer(manager, kCreateResourcesPhase);
+      renderer->CreateOrUpdateResources(root);
+    }
+    {
+      PhaseTracer tracer(manager, kPipelineWarmUpPhase);
+      renderer->WarmUpPipelines(root);
+    }
+    {
+      PhaseTracer tracer(manager, kFirstFramePhase);
+      renderer->DrawScene(root);
+      gm->Finish();
+    }
+  }
+
+  // Store the caches, as an application would once it has started.
+  if (is_cold) {
+    renderer->StoreRecordedPipelines();
+    font_manager->SaveGlyphCache(font, caches->glyph_cache_path);
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char* argv[]) {
+  BenchmarkSettings settings;
+  if (!ion::analytics::ParseSettingArguments(kSettingPrefix, argc, argv) ||
+      settings.warm_runs < 0 || settings.width < 1 || settings.height < 1 ||
+      settings.font_size < 1) {
+    ion::analytics::PrintSettingUsage(kSettingPrefix, argv[0], std::cerr);
+    return 1;
+  }
+
+  std::unique_ptr<ion::portgfx::Visual> visual =
+      ion::portgfx::Visual::CreateVisual();
+  if (!visual || !visual->IsValid() ||
+      !ion::portgfx::Visual::MakeCurrent(visual.get())) {
+    LOG(ERROR) << "Unable to create an OpenGL context";
+    return 1;
+  }
+
+  Caches caches;
+  caches.program_binaries = new MemoryStorage;
+  caches.glyph_cache_path = ion::port::GetTemporaryFilename();
+  ion::port::RemoveFile(caches.glyph_cache_path);
+
+  // The metric is run directly rather than registered with the manager, which
+  // would print its results again when the manager is destroyed.
+  ion::profile::CallTraceManager manager;
+  for (int i = 0; i <= settings.warm_runs; ++i) {
+    if (!RunStartup(settings, i == 0, &caches, &manager)) {
+      LOG(ERROR) << "Unable to start up";
+      ion::port::RemoveFile(caches.glyph_cache_path);
+      return 1;
+    }
+  }
+  ion::port::RemoveFile(caches.glyph_cache_path);
+
+  Benchmark benchmark;
+  benchmark.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("warm_runs", kWarmRun, "Number of warm runs",
+                            "runs"),
+      static_cast<double>(settings.warm_runs)));
+  StartupMetric().Run(manager.BuildTimeline(), &benchmark);
+  if (settings.json) {
+    ion::analytics::OutputBenchmarkAsJson(benchmark, "", std::cout);
+  } else {
+    ion::analytics::OutputBenchmarkPretty("Startup benchmark", true, benchmark,
+                                          std::cout);
+  }
+  return 0;
+}
@@ -57,6 +57,10 @@ class ViewerDemoBase : public DemoBase {
   // DoRender().
   void Render() override;
 
+  ion::gfx::GraphicsManager* GetDemoGraphicsManager() const override {
+    return graphics_manager_.Get();
+  }
+
  protected:
   // The constructor is passed the initial width and height of the viewport.
   ViewerDemoBase(int viewport_width, int viewport_height);
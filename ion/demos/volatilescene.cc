@@ -127,6 +127,9 @@ class VolatileScene : public DemoBase {
   void ProcessMotion(float x, float y, bool is_press) override {}
   void ProcessScale(float scale) override {}
   std::string GetDemoClassName() const override { return "VolatileScene"; }
+  ion::gfx::GraphicsManager* GetDemoGraphicsManager() const override {
+    return graphics_manager_.Get();
+  }
 
  private:
   ion::gfx::GraphicsManagerPtr graphics_manager_;
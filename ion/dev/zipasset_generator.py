@@ -55,8 +55,10 @@ of the file that it was sourced from on the local disk of the machine that runs
 this script. This is useful for editing files inside of the zip in an external
 source tree.
 
-The files are zipped up using python's zip compression and saved in a memory
-array; they are not written to a zip file. Instead, the zip data is written to
+The files are zipped up using python's zip compression, except for files whose
+formats are already compressed, such as PNG and JPEG images, which are stored
+as is so that ZipAssetManager::GetFileView() can return them without copying.
+The zip is saved in a memory array; they are not written to a zip file. Instead, the zip data is written to
 a .cc file that contins a single, namespace-wrapped static function called
 RegisterAssets(). This function registers the zip data with Ion's
 ZipAssetManager. The namespace containing the function is the name passed to
@@ -79,6 +81,12 @@ import xml.etree.ElementTree as ET
 import zipfile
 
 
+# Extensions of files that are stored without compression, since compressing
+# them again gains little.
+_STORED_EXTENSIONS = frozenset(['.gif', '.jpeg', '.jpg', '.ktx', '.pkm', '.png',
+                                '.webp', '.zip'])
+
+
 class Error(Exception):
   """Base class for errors."""
 
@@ -197,7 +205,10 @@ def BuildAssetZip(asset_file, search_paths):
   original_size = 0
   for (local_name, zip_name) in manifest:
     original_size += os.path.getsize(local_name)
-    zip_file.write(local_name, zip_name)
+    if os.path.splitext(local_name)[1].lower() in _STORED_EXTENSIONS:
+      zip_file.write(local_name, zip_name, zipfile.ZIP_STORED)
+    else:
+      zip_file.write(local_name, zip_name)
     manifest_file.write('%s|%s\n' % (zip_name, local_name))
 
   # Write the special manifest file.
@@ -0,0 +1,458 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/binarytrace.h"
+
+#include <ctype.h>
+
+#include <algorithm>
+
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/base/stringutils.h"
+#include "ion/gfx/tracinghelper.h"
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+// Each record starts with a header word holding its size in words, its type,
+// and, for calls, the depth of the tracing prefix. A call record continues
+// with the address of its Function, the kinds of its arguments in 4-bit
+// fields, the value of each argument, and then the data copied for the
+// arguments that point to strings or arrays. A text record continues with the
+// size of the text in bytes and the text.
+enum RecordType {
+  kCallRecord,
+  kTextRecord,
+};
+
+// The maximum number of arguments of a call, limited by the kinds word.
+static const size_t kMaxArgCount = 16U;
+
+static uint64 MakeHeader(size_t size, RecordType type, size_t depth) {
+  return static_cast<uint64>(size) | (static_cast<uint64>(type) << 32) |
+         (static_cast<uint64>(depth) << 40);
+}
+
+static size_t GetRecordSize(uint64 header) {
+  return static_cast<size_t>(header & 0xffffffffU);
+}
+
+static RecordType GetRecordType(uint64 header) {
+  return static_cast<RecordType>((header >> 32) & 0xffU);
+}
+
+static size_t GetRecordDepth(uint64 header) {
+  return static_cast<size_t>(header >> 40);
+}
+
+// Returns the number of words needed to hold |count| bytes.
+static size_t GetWordCount(size_t count) {
+  return (count + sizeof(uint64) - 1U) / sizeof(uint64);
+}
+
+// Returns the number of words needed to store a possibly NULL string.
+static size_t GetStringWordCount(const char* s) {
+  return 1U + (s ? GetWordCount(strlen(s)) : 0U);
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// BinaryTrace::Reader reads the records in the ring buffer in order. The
+// BinaryTrace's mutex must be locked while it is used.
+//
+//-----------------------------------------------------------------------------
+
+class BinaryTrace::Reader {
+ public:
+  explicit Reader(const BinaryTrace& trace)
+      : trace_(trace), position_(0U), record_end_(0U) {}
+
+  // Moves to the next record and returns its header, or returns false if
+  // there are no more records.
+  bool NextRecord(uint64* header) {
+    position_ = record_end_;
+    if (position_ >= trace_.size_)
+      return false;
+    *header = ReadWord();
+    record_end_ = position_ - 1U + GetRecordSize(*header);
+    return true;
+  }
+
+  uint64 ReadWord() {
+    return trace_.ring_[(trace_.begin_ + position_++) % trace_.capacity_];
+  }
+
+  void ReadBytes(void* bytes, size_t count) {
+    uint8* out = static_cast<uint8*>(bytes);
+    while (count) {
+      const uint64 word = ReadWord();
+      const size_t n = std::min(count, sizeof(word));
+      memcpy(out, &word, n);
+      out += n;
+      count -= n;
+    }
+  }
+
+  // Reads a string stored with WriteString(). Returns false if it was NULL.
+  bool ReadString(std::string* s) {
+    const size_t size = static_cast<size_t>(ReadWord());
+    if (!size)
+      return false;
+    s->resize(size - 1U);
+    if (size > 1U)
+      ReadBytes(&(*s)[0], size - 1U);
+    return true;
+  }
+
+ private:
+  const BinaryTrace& trace_;
+  // The word being read and the end of the current record, relative to the
+  // oldest record.
+  size_t position_;
+  size_t record_end_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// BinaryTrace::Function.
+//
+//-----------------------------------------------------------------------------
+
+BinaryTrace::Function::Function(const char* name, const char* parameter_list)
+    : name_(name) {
+  std::string params(parameter_list);
+  if (!params.empty() && params[0] == '(')
+    params = params.substr(1U);
+  if (!params.empty() && params[params.length() - 1U] == ')')
+    params.resize(params.length() - 1U);
+  const std::vector<std::string> args = base::SplitString(params, ",");
+  for (size_t i = 0; i < args.size(); ++i) {
+    const std::string arg = base::TrimEndWhitespace(
+        base::TrimStartWhitespace(args[i]));
+    if (arg.empty() || arg == "void")
+      continue;
+    // The name is the identifier at the end of the declaration.
+    size_t pos = arg.length();
+    while (pos && (isalnum(arg[pos - 1U]) || arg[pos - 1U] == '_'))
+      --pos;
+    const std::string type = base::TrimEndWhitespace(arg.substr(0, pos));
+    // TracingHelper prints the values of int and float arrays with a count
+    // suffix, and the rows of square matrices.
+    size_t count = 0U;
+    if (type.length() >= 2U && isdigit(type[type.length() - 2U])) {
+      count = type[type.length() - 2U] - '0';
+      if (type.find("matrix") != std::string::npos)
+        count *= count;
+    }
+    arg_types_.push_back(type);
+    arg_names_.push_back(arg.substr(pos));
+    array_counts_.push_back(count);
+  }
+  DCHECK_LE(arg_types_.size(), kMaxArgCount) << name_;
+}
+
+//-----------------------------------------------------------------------------
+//
+// BinaryTrace.
+//
+//-----------------------------------------------------------------------------
+
+BinaryTrace::BinaryTrace(size_t capacity)
+    : capacity_(capacity),
+      begin_(0U),
+      size_(0U),
+      record_count_(0U),
+      dropped_count_(0U) {}
+
+BinaryTrace::BinaryTrace()
+    : capacity_(kDefaultCapacity),
+      begin_(0U),
+      size_(0U),
+      record_count_(0U),
+      dropped_count_(0U) {}
+
+BinaryTrace::~BinaryTrace() {}
+
+void BinaryTrace::Clear() {
+  base::LockGuard guard(&mutex_);
+  begin_ = size_ = 0U;
+  record_count_ = dropped_count_ = 0U;
+}
+
+size_t BinaryTrace::GetRecordCount() const {
+  base::LockGuard guard(&mutex_);
+  return record_count_;
+}
+
+size_t BinaryTrace::GetDroppedRecordCount() const {
+  base::LockGuard guard(&mutex_);
+  return dropped_count_;
+}
+
+void BinaryTrace::AddCall(const Function& function, size_t depth,
+                          const Arg* args, size_t arg_count) {
+  DCHECK_EQ(arg_count, function.GetArgCount()) << function.GetName();
+  arg_count = std::min(arg_count, function.GetArgCount());
+
+  // Find the size of the record and the data to copy.
+  const char* strings[kMaxArgCount];
+  size_t array_counts[kMaxArgCount];
+  size_t size = 3U + arg_count;
+  uint64 kinds = 0U;
+  for (size_t i = 0; i < arg_count; ++i) {
+    const Arg& arg = args[i];
+    kinds |= static_cast<uint64>(arg.kind) << (4U * i);
+    strings[i] = NULL;
+    array_counts[i] = 0U;
+    const void* pointer =
+        reinterpret_cast<const void*>(static_cast<uintptr_t>(arg.value));
+    if (!pointer)
+      continue;
+    if (arg.kind == kString) {
+      strings[i] = static_cast<const char*>(pointer);
+      size += GetStringWordCount(strings[i]);
+    } else if (arg.kind == kStringArray) {
+      strings[i] = *static_cast<const char* const*>(pointer);
+      size += GetStringWordCount(strings[i]);
+    } else if (arg.kind == kIntArray || arg.kind == kFloatArray) {
+      array_counts[i] = function.GetArrayValueCount(i);
+      size += GetWordCount(array_counts[i] * 4U);
+    }
+  }
+
+  base::LockGuard guard(&mutex_);
+  if (!Reserve(size))
+    return;
+  WriteWord(MakeHeader(size, kCallRecord, depth));
+  WriteWord(reinterpret_cast<uintptr_t>(&function));
+  WriteWord(kinds);
+  for (size_t i = 0; i < arg_count; ++i)
+    WriteWord(args[i].value);
+  for (size_t i = 0; i < arg_count; ++i) {
+    const Arg& arg = args[i];
+    if (!arg.value)
+      continue;
+    if (arg.kind == kString || arg.kind == kStringArray) {
+      const size_t length = strings[i] ? strlen(strings[i]) : 0U;
+      WriteWord(strings[i] ? length + 1U : 0U);
+      WriteBytes(strings[i], length);
+    } else if (array_counts[i]) {
+      WriteBytes(reinterpret_cast<const void*>(
+                     static_cast<uintptr_t>(arg.value)),
+                 array_counts[i] * 4U);
+    }
+  }
+}
+
+void BinaryTrace::RecordText(const std::string& text) {
+  const size_t size = 2U + GetWordCount(text.length());
+  base::LockGuard guard(&mutex_);
+  if (!Reserve(size))
+    return;
+  WriteWord(MakeHeader(size, kTextRecord, 0U));
+  WriteWord(text.length());
+  WriteBytes(text.data(), text.length());
+}
+
+bool BinaryTrace::Reserve(size_t size) {
+  if (size > capacity_) {
+    ++dropped_count_;
+    return false;
+  }
+  if (ring_.empty())
+    ring_.resize(capacity_);
+  while (size_ + size > capacity_) {
+    const size_t oldest_size = GetRecordSize(ring_[begin_]);
+    begin_ = (begin_ + oldest_size) % capacity_;
+    size_ -= oldest_size;
+    --record_count_;
+    ++dropped_count_;
+  }
+  ++record_count_;
+  return true;
+}
+
+void BinaryTrace::WriteWord(uint64 word) {
+  ring_[(begin_ + size_++) % capacity_] = word;
+}
+
+void BinaryTrace::WriteBytes(const void* bytes, size_t count) {
+  const uint8* in = static_cast<const uint8*>(bytes);
+  while (count) {
+    uint64 word = 0U;
+    const size_t n = std::min(count, sizeof(word));
+    memcpy(&word, in, n);
+    WriteWord(word);
+    in += n;
+    count -= n;
+  }
+}
+
+void BinaryTrace::FormatArgs(Reader* reader, TracingHelper* helper,
+                             const Function& function,
+                             std::vector<std::string>* values) {
+  const size_t arg_count = function.GetArgCount();
+  const uint64 kinds = reader->ReadWord();
+  uint64 args[kMaxArgCount];
+  for (size_t i = 0; i < arg_count; ++i)
+    args[i] = reader->ReadWord();
+
+  values->resize(arg_count);
+  for (size_t i = 0; i < arg_count; ++i) {
+    const char* type = function.GetArgType(i).c_str();
+    const uint64 value = args[i];
+    const ArgKind kind = static_cast<ArgKind>((kinds >> (4U * i)) & 0xfU);
+    std::string& out = (*values)[i];
+    switch (kind) {
+      case kInt:
+        out = helper->ToString(type, static_cast<int>(value));
+        break;
+      case kUnsignedInt:
+        out = helper->ToString(type, static_cast<unsigned int>(value));
+        break;
+      case kBoolean:
+        out = helper->ToString(type, static_cast<unsigned char>(value));
+        break;
+      case kLong:
+        out = helper->ToString(type, static_cast<long>(value));  // NOLINT
+        break;
+      case kUnsignedLong:
+        out = helper->ToString(type,
+                               static_cast<unsigned long>(value));  // NOLINT
+        break;
+      case kLongLong:
+        out = helper->ToString(type, static_cast<long long>(value));  // NOLINT
+        break;
+      case kUnsignedLongLong:
+        out = helper->ToString(
+            type, static_cast<unsigned long long>(value));  // NOLINT
+        break;
+      case kFloat: {
+        const uint32 bits = static_cast<uint32>(value);
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        out = helper->ToString(type, f);
+        break;
+      }
+      case kPointer:
+        out = helper->PointerToString(type, static_cast<size_t>(value),
+                                      static_cast<const void*>(NULL));
+        break;
+      case kString: {
+        std::string s;
+        if (value && reader->ReadString(&s))
+          out = helper->ToString(type, s.c_str());
+        else
+          out = "NULL";
+        break;
+      }
+      case kStringArray: {
+        std::string s;
+        if (value && reader->ReadString(&s)) {
+          const char* strings[] = { s.c_str() };
+          out = helper->ToString(type, static_cast<const char**>(strings));
+        } else {
+          out = value ? "[NULL, ...]" : "NULL";
+        }
+        break;
+      }
+      case kIntArray:
+      case kFloatArray: {
+        const size_t count = value ? function.GetArrayValueCount(i) : 0U;
+        std::vector<uint32> data(count);
+        if (count)
+          reader->ReadBytes(&data[0], count * 4U);
+        if (kind == kIntArray) {
+          out = helper->PointerToString(
+              type, static_cast<size_t>(value),
+              count ? reinterpret_cast<const int*>(&data[0]) : NULL);
+        } else {
+          out = helper->PointerToString(
+              type, static_cast<size_t>(value),
+              count ? reinterpret_cast<const float*>(&data[0]) : NULL);
+        }
+        break;
+      }
+    }
+  }
+}
+
+const std::string BinaryTrace::Format() const {
+  TracingHelper helper;
+  std::string text;
+  std::vector<std::string> values;
+  base::LockGuard guard(&mutex_);
+  Reader reader(*this);
+  uint64 header;
+  while (reader.NextRecord(&header)) {
+    if (GetRecordType(header) == kTextRecord) {
+      std::string line(static_cast<size_t>(reader.ReadWord()), '\0');
+      if (!line.empty())
+        reader.ReadBytes(&line[0], line.length());
+      text += line;
+      continue;
+    }
+    const Function& function = *reinterpret_cast<const Function*>(
+        static_cast<uintptr_t>(reader.ReadWord()));
+    FormatArgs(&reader, &helper, function, &values);
+    text += std::string(GetRecordDepth(header), ' ');
+    text += function.GetName();
+    text += '(';
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i)
+        text += ", ";
+      text += function.GetArgName(i) + " = " + values[i];
+    }
+    text += ")\n";
+  }
+  return text;
+}
+
+const std::vector<std::string> BinaryTrace::GetCalls() const {
+  TracingHelper helper;
+  std::vector<std::string> calls;
+  std::vector<std::string> values;
+  base::LockGuard guard(&mutex_);
+  calls.reserve(record_count_);
+  Reader reader(*this);
+  uint64 header;
+  while (reader.NextRecord(&header)) {
+    if (GetRecordType(header) != kCallRecord)
+      continue;
+    const Function& function = *reinterpret_cast<const Function*>(
+        static_cast<uintptr_t>(reader.ReadWord()));
+    FormatArgs(&reader, &helper, function, &values);
+    std::string call = function.GetName();
+    call += '(';
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i)
+        call += ", ";
+      call += values[i];
+    }
+    call += ')';
+    calls.push_back(call);
+  }
+  return calls;
+}
+
+}  // namespace gfx
+}  // namespace ion
@@ -0,0 +1,215 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFX_BINARYTRACE_H_
+#define ION_GFX_BINARYTRACE_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/referent.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace gfx {
+
+class TracingHelper;
+
+// A BinaryTrace records the OpenGL calls made through a GraphicsManager that it
+// is installed in as raw argument values, and formats them into the same text
+// as the GraphicsManager's tracing stream only when the text is needed. This
+// makes tracing cheap enough to leave on for every frame: recording a call
+// copies a few words into a ring buffer, and only the strings and the int and
+// float arrays that the text shows are copied. Text lines, such as the markers
+// written by the Renderer and the errors found by error checking, can be
+// recorded as well.
+//
+// The records are kept in a ring buffer of fixed capacity; when it is full the
+// oldest records are dropped to make room for new ones. The tracing prefix of
+// the GraphicsManager is recorded as its length, so formatted calls are
+// indented with spaces. Like tracing, calls are only recorded in
+// non-production builds.
+class ION_API BinaryTrace : public base::Referent {
+ public:
+  // Describes the arguments of a traced function. The GraphicsManager creates
+  // one static instance per function from the function's name and parameter
+  // list, e.g., "(GLenum target, GLuint buffer)".
+  class ION_API Function {
+   public:
+    Function(const char* name, const char* parameter_list);
+
+    const char* GetName() const { return name_; }
+    size_t GetArgCount() const { return arg_types_.size(); }
+    const std::string& GetArgType(size_t i) const { return arg_types_[i]; }
+    const std::string& GetArgName(size_t i) const { return arg_names_[i]; }
+    // Returns the number of values that the tracing text shows for the ith
+    // argument if it points to ints or floats, e.g., 4 for a const GLfloat4*
+    // and 9 for a const GLmatrix3*, or 0 if it shows none.
+    size_t GetArrayValueCount(size_t i) const { return array_counts_[i]; }
+
+   private:
+    const char* name_;
+    std::vector<std::string> arg_types_;
+    std::vector<std::string> arg_names_;
+    std::vector<size_t> array_counts_;
+
+    DISALLOW_COPY_AND_ASSIGN(Function);
+  };
+
+  // The default capacity of the ring buffer, in 8-byte words.
+  static const size_t kDefaultCapacity = 256U * 1024U;
+
+  // The ring buffer holds |capacity| 8-byte words. It is allocated when the
+  // first record is added.
+  explicit BinaryTrace(size_t capacity);
+  BinaryTrace();
+
+  // Removes all records and resets the count of dropped records.
+  void Clear();
+
+  // Records a call to |function| with the passed arguments, indented by
+  // |depth| spaces. This is called by the GraphicsManager before making each
+  // call, and may be called from any thread.
+  template <typename... Args>
+  void RecordCall(const Function& function, size_t depth, Args... args) {
+    // The leading Arg allows functions without arguments.
+    const Arg encoded[] = { Arg(), EncodeArg(args)... };
+    AddCall(function, depth, encoded + 1, sizeof...(Args));
+  }
+
+  // Records a line of text, which is output as is.
+  void RecordText(const std::string& text);
+
+  // Returns the number of records in the buffer and the number of records that
+  // were dropped to make room for newer ones since the last Clear().
+  size_t GetRecordCount() const;
+  size_t GetDroppedRecordCount() const;
+
+  // Returns the records as text, in the same format as the GraphicsManager's
+  // tracing stream.
+  const std::string Format() const;
+
+  // Returns the recorded calls in the format produced by TraceCallExtractor,
+  // e.g., "Clear(GL_COLOR_BUFFER_BIT)", skipping text records.
+  const std::vector<std::string> GetCalls() const;
+
+ private:
+  // The kind of a recorded argument, which determines how its value is
+  // formatted and what data is copied with it.
+  enum ArgKind {
+    kInt,
+    kUnsignedInt,
+    kBoolean,
+    kLong,
+    kUnsignedLong,
+    kLongLong,
+    kUnsignedLongLong,
+    kFloat,
+    kPointer,
+    kString,
+    kStringArray,
+    kIntArray,
+    kFloatArray,
+  };
+  struct Arg {
+    Arg() : kind(kInt), value(0U) {}
+    Arg(ArgKind kind_in, uint64 value_in) : kind(kind_in), value(value_in) {}
+    ArgKind kind;
+    uint64 value;
+  };
+  class Reader;
+
+  // The destructor is private because this is derived from Referent.
+  ~BinaryTrace() override;
+
+  // Arguments are encoded according to their C++ types, which are those that
+  // TracingHelper::ToString() is called with.
+  static Arg EncodeArg(int value) { return Arg(kInt, value); }
+  static Arg EncodeArg(unsigned int value) { return Arg(kUnsignedInt, value); }
+  static Arg EncodeArg(unsigned char value) { return Arg(kBoolean, value); }
+  static Arg EncodeArg(long value) { return Arg(kLong, value); }  // NOLINT
+  static Arg EncodeArg(unsigned long value) {  // NOLINT
+    return Arg(kUnsignedLong, value);
+  }
+  static Arg EncodeArg(long long value) {  // NOLINT
+    return Arg(kLongLong, value);
+  }
+  static Arg EncodeArg(unsigned long long value) {  // NOLINT
+    return Arg(kUnsignedLongLong, value);
+  }
+  static Arg EncodeArg(float value) {
+    uint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return Arg(kFloat, bits);
+  }
+  static Arg EncodeArg(const char* value) {
+    return Arg(kString, reinterpret_cast<uintptr_t>(value));
+  }
+  static Arg EncodeArg(char* value) {
+    return Arg(kString, reinterpret_cast<uintptr_t>(value));
+  }
+  static Arg EncodeArg(const char** value) {
+    return Arg(kStringArray, reinterpret_cast<uintptr_t>(value));
+  }
+  static Arg EncodeArg(const int* value) {
+    return Arg(kIntArray, reinterpret_cast<uintptr_t>(value));
+  }
+  static Arg EncodeArg(const float* value) {
+    return Arg(kFloatArray, reinterpret_cast<uintptr_t>(value));
+  }
+  template <typename T>
+  static Arg EncodeArg(T* value) {
+    return Arg(kPointer, reinterpret_cast<uintptr_t>(value));
+  }
+
+  // Reads the arguments of the call record that |reader| is at, after its
+  // Function, and formats each with |helper|.
+  static void FormatArgs(Reader* reader, TracingHelper* helper,
+                         const Function& function,
+                         std::vector<std::string>* values);
+  // Adds a record for a call, copying the data that the arguments point to.
+  void AddCall(const Function& function, size_t depth, const Arg* args,
+               size_t arg_count);
+  // Makes room for a record of |size| words by dropping the oldest records.
+  // Returns false if the record can never fit.
+  bool Reserve(size_t size);
+  // Appends a word or bytes, padded to a whole word, to the ring buffer.
+  void WriteWord(uint64 word);
+  void WriteBytes(const void* bytes, size_t count);
+
+  mutable port::Mutex mutex_;
+  const size_t capacity_;
+  std::vector<uint64> ring_;
+  // The index of the first word of the oldest record, and the number of words
+  // used.
+  size_t begin_;
+  size_t size_;
+  size_t record_count_;
+  size_t dropped_count_;
+};
+
+// Convenience typedef for shared pointer to a BinaryTrace.
+typedef base::ReferentPtr<BinaryTrace>::Type BinaryTracePtr;
+
+}  // namespace gfx
+}  // namespace ion
+
+#endif  // ION_GFX_BINARYTRACE_H_
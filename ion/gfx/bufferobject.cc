@@ -30,14 +30,18 @@ BufferObject::BufferObject()
       data_(kDataChanged, BufferData(), this),
       target_(kArrayBuffer),
       sub_data_(*this),
-      sub_data_changed_(kSubDataChanged, false, this) {}
+      sub_data_changed_(kSubDataChanged, false, this),
+      sub_data_merge_gap_(0U),
+      sub_data_replace_fraction_(1.f) {}
 
 BufferObject::BufferObject(Target target)
     : specs_(*this),
       data_(kDataChanged, BufferData(), this),
       target_(target),
       sub_data_(*this),
-      sub_data_changed_(kSubDataChanged, false, this) {}
+      sub_data_changed_(kSubDataChanged, false, this),
+      sub_data_merge_gap_(0U),
+      sub_data_replace_fraction_(1.f) {}
 
 BufferObject::~BufferObject() {
   if (base::DataContainer* data = GetData().Get()) data->RemoveReceiver(this);
@@ -115,8 +119,12 @@ EnumHelper::GetEnumData() {
 // Specialize for BufferObject::Target.
 template <> ION_API const EnumHelper::EnumData<BufferObject::Target>
 EnumHelper::GetEnumData() {
-  static const GLenum kValues[] = { GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER };
-  static const char* kStrings[] = { "ArrayBuffer", "Elementbuffer" };
+  static const GLenum kValues[] = {
+    GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_UNIFORM_BUFFER
+  };
+  static const char* kStrings[] = {
+    "ArrayBuffer", "Elementbuffer", "UniformBuffer"
+  };
   ION_STATIC_ASSERT(ARRAYSIZE(kValues) == ARRAYSIZE(kStrings),
                     "EnumHelper size mismatch");
   return EnumData<BufferObject::Target>(
@@ -50,12 +50,13 @@ namespace gfx {
 //  - kStreamDraw: The data store contents will be modified once and used at
 //                 most a few times.
 //
-// A BufferObject can be bound to two possible targets: a kElementBuffer or a
-// kArrayBuffer. kElementBuffer means the data will be used as an element array
-// defining indices, while kArrayBuffer means the data will be used for array
-// data, such as vertices. BufferObjects are by default kArrayBuffers; see
-// the IndexBuffer class for creating types of kElementBuffer to be used as
-// index arrays.
+// A BufferObject can be bound to three possible targets: a kElementBuffer, a
+// kArrayBuffer, or a kUniformBuffer. kElementBuffer means the data will be used
+// as an element array defining indices, kArrayBuffer means the data will be
+// used for array data, such as vertices, and kUniformBuffer means the data
+// holds the values of a uniform block. BufferObjects are by default
+// kArrayBuffers; see the IndexBuffer class for creating types of kElementBuffer
+// to be used as index arrays, and UniformBlock for uniform buffers.
 //
 // After a buffer's data has been set through SetData(), callers can modify
 // sub-ranges of data through SetSubData(), or update the entire buffer's data
@@ -89,6 +90,7 @@ class ION_API BufferObject : public ResourceHolder {
   enum Target {
     kArrayBuffer,
     kElementBuffer,
+    kUniformBuffer,
   };
 
   enum UsageMode {
@@ -203,6 +205,30 @@ class ION_API BufferObject : public ResourceHolder {
     return sub_data_;
   }
 
+  // Sets/returns the largest gap, in bytes, between two sub-data ranges that
+  // the Renderer bridges so that both are uploaded with a single call. The
+  // bytes in the gap are copied from the DataContainer passed to SetData(), so
+  // a gap should only be set if that DataContainer is not wiped and is kept up
+  // to date with the sub-data; gaps are never bridged once it has been wiped.
+  // The default is 0, which merges only overlapping and adjacent ranges.
+  void SetSubDataMergeGap(size_t bytes) { sub_data_merge_gap_ = bytes; }
+  size_t GetSubDataMergeGap() const { return sub_data_merge_gap_; }
+
+  // Sets/returns the fraction of the buffer's data that, once covered by the
+  // pending sub-data ranges, makes the Renderer replace all of the data with a
+  // single upload instead, which allows OpenGL to orphan the old storage
+  // rather than wait for draws that still read it. As with merge gaps, the
+  // bytes not covered by sub-data are copied from the DataContainer passed to
+  // SetData(); if it has been wiped, the data is only replaced when the
+  // sub-data covers all of it. The default is 1, and values above 1 disable
+  // replacement.
+  void SetSubDataReplaceFraction(float fraction) {
+    sub_data_replace_fraction_ = fraction;
+  }
+  float GetSubDataReplaceFraction() const {
+    return sub_data_replace_fraction_;
+  }
+
   // Returns the mapped data pointer of the buffer, which will be NULL if the
   // buffer has not been mapped with Renderer::MapBufferObjectData(Range)().
   void* GetMappedPointer() const {
@@ -306,6 +332,9 @@ class ION_API BufferObject : public ResourceHolder {
   // to the above vector, is a Field so that clearing the sub-data does not
   // trigger a change bit.
   Field<bool> sub_data_changed_;
+  // Controls how the Renderer coalesces the sub-data before uploading it.
+  size_t sub_data_merge_gap_;
+  float sub_data_replace_fraction_;
 
   // Buffer data that has been mapped from the graphics hardware or a
   // client-side pointer if the platform does not support mapped buffers. The
@@ -0,0 +1,52 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfx/commandbuffer.h"
+
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace gfx {
+
+CommandBuffer::CommandBuffer() : call_count_(0U) {}
+
+CommandBuffer::~CommandBuffer() {}
+
+void CommandBuffer::Replay(GraphicsManager* gm) const {
+  const uint32* words = words_.data();
+  const uint32* end = words + words_.size();
+  while (words < end) {
+    Replayer replayer;
+    memcpy(&replayer, words, sizeof(replayer));
+    words = replayer(gm, words + GetWordCount(sizeof(replayer)));
+  }
+  DCHECK_EQ(end, words);
+}
+
+void CommandBuffer::Clear() {
+  words_.clear();
+  call_count_ = 0U;
+}
+
+void CommandBuffer::AppendBytes(const void* data, size_t byte_count) {
+  const size_t offset = words_.size();
+  words_.resize(offset + GetWordCount(byte_count), 0U);
+  if (byte_count)
+    memcpy(&words_[offset], data, byte_count);
+}
+
+}  // namespace gfx
+}  // namespace ion
@@ -0,0 +1,249 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef ION_GFX_COMMANDBUFFER_H_
+#define ION_GFX_COMMANDBUFFER_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/referent.h"
+#include "ion/gfx/graphicsmanager.h"
+
+namespace ion {
+namespace gfx {
+
+// A CommandBuffer records calls to the OpenGL functions of a GraphicsManager in
+// a compact binary form so that they can be made later. This separates
+// deciding what to draw from issuing the calls: one or more worker threads can
+// record the bind, uniform, and draw calls for parts of a scene, and the
+// thread that owns the OpenGL context replays the buffers in order. Each call
+// is stored as a pointer to a function that decodes its arguments and makes
+// it, followed by the arguments packed into 32-bit words, so replaying a
+// buffer is a single loop without any lookups or type dispatch.
+//
+// Calls are recorded with the ION_RECORD_GL_CALL macro below, which takes the
+// name of a GraphicsManager function. Arguments are encoded as follows:
+//  - Values are converted to the types of the function's parameters.
+//  - Pointers are recorded as values, which suits offsets into bound buffers,
+//    such as the indices passed to glDrawElements().
+//  - Data that the call reads through a pointer, such as the values passed to
+//    glUniform*v(), must be wrapped with Data() so that it is copied into the
+//    buffer.
+// Only functions that return nothing can be recorded, since a result would not
+// be available until the buffer is replayed; objects must therefore be created
+// on the OpenGL thread beforehand.
+//
+// A CommandBuffer is not thread-safe, so each recording thread should use its
+// own. Clear() keeps the storage of the buffer, so a buffer that is recorded
+// every frame stops allocating memory once it has grown to its working size.
+//
+// Example:
+//   CommandBufferPtr commands(new CommandBuffer);
+//   ION_RECORD_GL_CALL(commands, UseProgram, program);
+//   ION_RECORD_GL_CALL(commands, Uniform4fv, location, 1,
+//                      CommandBuffer::Data(color, 4));
+//   ION_RECORD_GL_CALL(commands, DrawArrays, GL_TRIANGLES, 0, 3);
+//   ...
+//   commands->Replay(gm.Get());  // On the OpenGL thread.
+class ION_API CommandBuffer : public base::Referent {
+ public:
+  // Data that a recorded call reads through a pointer.
+  template <typename T>
+  struct DataArg {
+    const T* values;
+    size_t count;
+  };
+
+  CommandBuffer();
+
+  // Wraps |count| elements starting at |values| so that they are copied into
+  // the buffer when a call is recorded.
+  template <typename T>
+  static DataArg<T> Data(const T* values, size_t count) {
+    const DataArg<T> data = { values, count };
+    return data;
+  }
+
+  // Appends a call to |Func| with the passed arguments. This is usually
+  // invoked through ION_RECORD_GL_CALL, which supplies the template arguments.
+  template <typename FunctionType, FunctionType Func, typename... Args>
+  void Record(Args... args) {
+    Caller<FunctionType>::template Function<Func>::Record(this, args...);
+    ++call_count_;
+  }
+
+  // Makes the recorded calls through |gm|, in the order they were recorded.
+  void Replay(GraphicsManager* gm) const;
+
+  // Removes all recorded calls, keeping the allocated storage.
+  void Clear();
+
+  // Returns the number of recorded calls.
+  size_t GetCallCount() const { return call_count_; }
+  // Returns the number of bytes used by the recorded calls.
+  size_t GetSize() const { return words_.size() * sizeof(words_[0]); }
+
+ private:
+  // Makes a call whose encoding starts at |words| and returns a pointer past
+  // the end of the encoding.
+  typedef const uint32* (*Replayer)(GraphicsManager* gm, const uint32* words);
+
+  // Pointer arguments are preceded by one of these.
+  enum PointerKind { kPointerValue, kPointerData };
+
+  // Compile-time lists of argument indices.
+  template <size_t... Indices> struct IndexList {};
+  template <size_t N, size_t... Indices>
+  struct MakeIndexList : MakeIndexList<N - 1, N - 1, Indices...> {};
+  template <size_t... Indices>
+  struct MakeIndexList<0, Indices...> {
+    typedef IndexList<Indices...> Type;
+  };
+
+  // Reads arguments from an encoded call.
+  class Decoder {
+   public:
+    explicit Decoder(const uint32* words) : words_(words) {}
+    const uint32* GetPosition() const { return words_; }
+
+    template <typename T>
+    typename std::enable_if<!std::is_pointer<T>::value, T>::type Next() {
+      T value;
+      memcpy(&value, words_, sizeof(value));
+      words_ += GetWordCount(sizeof(value));
+      return value;
+    }
+    template <typename T>
+    typename std::enable_if<std::is_pointer<T>::value, T>::type Next() {
+      const uint32 kind = *words_++;
+      if (kind == kPointerData) {
+        const uint32 word_count = *words_++;
+        const uint32* data = words_;
+        words_ += word_count;
+        return reinterpret_cast<T>(data);
+      }
+      return reinterpret_cast<T>(static_cast<uintptr_t>(Next<uint64>()));
+    }
+
+   private:
+    const uint32* words_;
+  };
+
+  // Records and replays calls to functions of type |FunctionType|; only
+  // functions that return nothing are supported.
+  template <typename FunctionType> struct Caller;
+  template <typename... Params>
+  struct Caller<void (GraphicsManager::*)(Params...)> {
+    template <void (GraphicsManager::*Func)(Params...)>
+    struct Function {
+      template <typename... Args>
+      static void Record(CommandBuffer* buffer, Args... args) {
+        static_assert(sizeof...(Args) == sizeof...(Params),
+                      "Wrong number of arguments for recorded call");
+        buffer->AppendReplayer(&Replay);
+        // The leading element allows functions without parameters, and the
+        // initializer list ensures the arguments are encoded in order.
+        const int unused[] = { 0, (buffer->Encode<Params>(args), 0)... };
+        (void)unused;
+      }
+
+      static const uint32* Replay(GraphicsManager* gm, const uint32* words) {
+        Decoder decoder(words);
+        std::tuple<Params...> args;
+        DecodeAll(&decoder, &args,
+                  typename MakeIndexList<sizeof...(Params)>::Type());
+        Call(gm, args, typename MakeIndexList<sizeof...(Params)>::Type());
+        return decoder.GetPosition();
+      }
+
+     private:
+      template <size_t... Indices>
+      static void DecodeAll(Decoder* decoder, std::tuple<Params...>* args,
+                            IndexList<Indices...>) {
+        const int unused[] = {
+          0, (std::get<Indices>(*args) = decoder->template Next<Params>(),
+              0)... };
+        (void)unused;
+      }
+      template <size_t... Indices>
+      static void Call(GraphicsManager* gm, const std::tuple<Params...>& args,
+                       IndexList<Indices...>) {
+        (gm->*Func)(std::get<Indices>(args)...);
+      }
+    };
+  };
+
+  // The destructor is private because this is derived from Referent.
+  ~CommandBuffer() override;
+
+  // Returns the number of words needed to hold |byte_count| bytes.
+  static size_t GetWordCount(size_t byte_count) {
+    return (byte_count + sizeof(uint32) - 1) / sizeof(uint32);
+  }
+
+  // Appends |byte_count| bytes at |data| to the buffer, padded to whole words.
+  void AppendBytes(const void* data, size_t byte_count);
+  void AppendReplayer(Replayer replayer) {
+    AppendBytes(&replayer, sizeof(replayer));
+  }
+
+  // Encodes |arg| as a parameter of type |Param|.
+  template <typename Param, typename Arg>
+  typename std::enable_if<!std::is_pointer<Param>::value>::type Encode(
+      Arg arg) {
+    const Param value = static_cast<Param>(arg);
+    AppendBytes(&value, sizeof(value));
+  }
+  template <typename Param, typename Arg>
+  typename std::enable_if<std::is_pointer<Param>::value>::type Encode(
+      Arg arg) {
+    const Param pointer = arg;
+    const uint64 value = reinterpret_cast<uintptr_t>(pointer);
+    words_.push_back(kPointerValue);
+    AppendBytes(&value, sizeof(value));
+  }
+  template <typename Param, typename T>
+  void Encode(const DataArg<T>& data) {
+    static_assert(std::is_pointer<Param>::value,
+                  "Data can only be passed for pointer parameters");
+    const size_t byte_count = data.count * sizeof(T);
+    words_.push_back(kPointerData);
+    words_.push_back(static_cast<uint32>(GetWordCount(byte_count)));
+    AppendBytes(data.values, byte_count);
+  }
+
+  std::vector<uint32> words_;
+  size_t call_count_;
+};
+
+// Convenience typedef for shared pointer to a CommandBuffer.
+typedef base::ReferentPtr<CommandBuffer>::Type CommandBufferPtr;
+
+}  // namespace gfx
+}  // namespace ion
+
+// Records a call to the GraphicsManager function |name| (without the "gl"
+// prefix) in |buffer|, which may be a CommandBuffer pointer or CommandBufferPtr.
+#define ION_RECORD_GL_CALL(buffer, name, ...)                       \
+  (buffer)->Record<decltype(&::ion::gfx::GraphicsManager::name),    \
+                   &::ion::gfx::GraphicsManager::name>(__VA_ARGS__)
+
+#endif  // ION_GFX_COMMANDBUFFER_H_
@@ -120,6 +120,26 @@ ION_API FramebufferObject::Attachment::Attachment(
   Construct(cubemap_.Get() ? kCubeMapTexture : kUnbound, mip_level, face);
 }
 
+ION_API FramebufferObject::Attachment::Attachment(
+    const TexturePtr& texture_in, size_t mip_level, uint32 base_view_index,
+    uint32 num_views) : texture_(texture_in) {
+  Construct(texture_.Get() && num_views ? kMultiviewTexture : kUnbound,
+            mip_level, kInvalidFace);
+  if (binding_ == kMultiviewTexture) {
+    base_view_index_ = base_view_index;
+    num_views_ = num_views;
+  }
+}
+
+ION_API FramebufferObject::Attachment
+FramebufferObject::Attachment::CreateMultisampledTexture(
+    const TexturePtr& texture_in, size_t samples) {
+  Attachment attachment(texture_in);
+  if (attachment.binding_ == kTexture)
+    attachment.samples_ = samples;
+  return attachment;
+}
+
 ION_API void FramebufferObject::Attachment::Construct(
     AttachmentBinding binding,
     size_t mip_level,
@@ -129,6 +149,8 @@ ION_API void FramebufferObject::Attachment::Construct(
   face_ = face;
   format_ = static_cast<Image::Format>(base::kInvalidIndex);
   samples_ = 0;
+  base_view_index_ = 0;
+  num_views_ = 0;
 }
 
 ION_API Image::Format FramebufferObject::Attachment::GetFormat() const {
@@ -65,6 +65,7 @@ class ION_API FramebufferObject : public ResourceHolder {
   // The type of binding for an Attachment.
   enum AttachmentBinding {
     kCubeMapTexture,
+    kMultiviewTexture,
     kRenderbuffer,
     kTexture,
     kUnbound,
@@ -104,6 +105,26 @@ class ION_API FramebufferObject : public ResourceHolder {
     Attachment(const CubeMapTexturePtr& texture_in,
                CubeMapTexture::CubeFace face,
                size_t mip_level);
+    // Creates a multiview Attachment that renders to |num_views| layers of the
+    // passed array texture starting at |base_view_index|, using OVR_multiview.
+    // Each draw call is then executed once for every view, so a scene can be
+    // rendered for both eyes of a stereo display in a single traversal, with
+    // shaders selecting per-view values from uniform arrays by gl_ViewID_OVR.
+    // If the texture has no image, an array image with enough layers is
+    // created for it.
+    Attachment(const TexturePtr& texture_in, size_t mip_level,
+               uint32 base_view_index, uint32 num_views);
+    // Returns a texture Attachment that is rendered to with |samples|
+    // samples using EXT_multisampled_render_to_texture. The samples are kept
+    // in tile memory and resolved into the texture implicitly when the tiles
+    // are flushed, so no separate multisampled framebuffer or blit is needed.
+    // Multisampled renderbuffer Attachments of the same FramebufferObject,
+    // e.g., Attachment(Image::kRenderbufferDepth24, 4), are then implicitly
+    // resolved as well; they are best invalidated after the pass with
+    // Renderer::InvalidateFramebuffer(). If the extension is not available,
+    // the texture and renderbuffers are rendered to without multisampling.
+    static Attachment CreateMultisampledTexture(const TexturePtr& texture_in,
+                                                size_t samples);
 
     // Gets the format of the attachment, which is the texture format if it is a
     // texture attachment.
@@ -122,14 +143,20 @@ class ION_API FramebufferObject : public ResourceHolder {
     size_t GetMipLevel() const { return mip_level_; }
     // Returns the number of samples for multisampling.
     size_t GetSamples() const { return samples_; }
+    // Returns the first texture layer and the number of layers rendered to by a
+    // multiview attachment. The number of views is 0 for other attachments.
+    uint32 GetBaseViewIndex() const { return base_view_index_; }
+    uint32 GetNumViews() const { return num_views_; }
 
     // Needed for Field::Set().
     inline bool operator !=(const Attachment& other) const {
       return binding_ != other.binding_ || format_ != other.format_ ||
              texture_.Get() != other.texture_.Get() ||
              image_.Get() != other.image_.Get() ||
-             cubemap_.Get() != other.cubemap_.Get() ||
-             mip_level_ != other.mip_level_ || samples_ != other.samples_;
+             cubemap_.Get() != other.cubemap_.Get() || face_ != other.face_ ||
+             mip_level_ != other.mip_level_ || samples_ != other.samples_ ||
+             base_view_index_ != other.base_view_index_ ||
+             num_views_ != other.num_views_;
     }
 
    private:
@@ -144,6 +171,8 @@ class ION_API FramebufferObject : public ResourceHolder {
     Image::Format format_;
     size_t mip_level_;
     size_t samples_;
+    uint32 base_view_index_;
+    uint32 num_views_;
   };
 
   // Creates a FramebufferObject with the passed dimensions and unbound
@@ -0,0 +1,593 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/framecapture.h"
+
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+
+#include "ion/base/lockguards.h"
+#include "ion/base/staticsafedeclare.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/port/timer.h"
+
+#ifndef GL_TEXTURE_BORDER_COLOR
+#  define GL_TEXTURE_BORDER_COLOR 0x1004
+#endif
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+typedef FrameCapture::Arg Arg;
+typedef FrameCapture::Call Call;
+
+// Serialized captures start with this tag, which includes the format version.
+// The tag is followed by the number of calls and then the calls. Each call is
+// its name length and name, its argument count, and its arguments. Each
+// argument is its kind and value, followed by the size of its data and the
+// data if it has any. Numbers are stored in host byte order.
+static const char kCaptureTag[] = "IONFCAP1";
+
+// The scratch memory handed to calls for outputs of unknown size.
+static const size_t kDefaultOutputSize = 64U * 1024U;
+
+//-----------------------------------------------------------------------------
+//
+// Capture helpers.
+//
+//-----------------------------------------------------------------------------
+
+// Returns the pointer that was recorded in |arg|.
+static const uint8* GetRecordedPointer(const Arg& arg) {
+  return reinterpret_cast<const uint8*>(static_cast<uintptr_t>(arg.value));
+}
+
+// Copies |size| bytes from the pointer recorded in |arg| into its data. NULL
+// pointers are left as values.
+static void CaptureData(Arg* arg, int64 size) {
+  if (const uint8* data = GetRecordedPointer(*arg)) {
+    arg->kind = Arg::kData;
+    arg->value = 0U;
+    if (size > 0)
+      arg->data.assign(data, data + size);
+  }
+}
+
+// Copies the |count| strings in the array recorded in |arg|, using |lengths|
+// if it is non-NULL.
+static void CaptureStrings(Arg* arg, GLsizei count, const GLint* lengths) {
+  const GLchar* const* strings =
+      reinterpret_cast<const GLchar* const*>(GetRecordedPointer(*arg));
+  arg->kind = Arg::kStringArray;
+  arg->value = 0U;
+  if (!strings)
+    return;
+  for (GLsizei i = 0; i < count; ++i) {
+    const size_t length = lengths && lengths[i] >= 0
+                              ? static_cast<size_t>(lengths[i])
+                              : strlen(strings[i]);
+    arg->data.insert(arg->data.end(), strings[i], strings[i] + length);
+    arg->data.push_back(0U);
+  }
+  arg->value = static_cast<uint64>(count);
+}
+
+// Returns the signed value of an integer argument.
+static int64 GetInt(const Arg& arg) {
+  return static_cast<int64>(static_cast<int32>(arg.value));
+}
+
+// Returns the number of bytes of pixel data with the passed format, type and
+// dimensions, in rows aligned to |alignment| bytes, or 0 if the format or type
+// is not known.
+static int64 GetPixelDataSize(GLenum format, GLenum type, int64 width,
+                              int64 height, int64 depth, int64 alignment) {
+  int64 components = 0;
+  switch (format) {
+    case GL_ALPHA:
+    case GL_DEPTH_COMPONENT:
+    case GL_LUMINANCE:
+    case GL_RED:
+    case GL_RED_INTEGER:
+      components = 1;
+      break;
+    case GL_DEPTH_STENCIL:
+    case GL_LUMINANCE_ALPHA:
+    case GL_RG:
+    case GL_RG_INTEGER:
+      components = 2;
+      break;
+    case GL_RGB:
+    case GL_RGB_INTEGER:
+      components = 3;
+      break;
+    case GL_RGBA:
+    case GL_RGBA_INTEGER:
+      components = 4;
+      break;
+    default:
+      return 0;
+  }
+  int64 pixel_size = 0;
+  switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+      pixel_size = components;
+      break;
+    case GL_HALF_FLOAT:
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+      pixel_size = components * 2;
+      break;
+    case GL_FLOAT:
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+      pixel_size = components * 4;
+      break;
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+    case GL_UNSIGNED_SHORT_5_6_5:
+      pixel_size = 2;
+      break;
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_24_8:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+      pixel_size = 4;
+      break;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+      pixel_size = 8;
+      break;
+    default:
+      return 0;
+  }
+  if (width <= 0 || height <= 0 || depth <= 0)
+    return 0;
+  alignment = std::max<int64>(alignment, 1);
+  const int64 row_size = width * pixel_size;
+  const int64 stride = (row_size + alignment - 1) / alignment * alignment;
+  // The last row is not padded.
+  return stride * (height * depth - 1) + row_size;
+}
+
+// Returns the number of values read by a glTexParameter*v() or
+// glSamplerParameter*v() call with |pname|.
+static int64 GetParameterCount(GLenum pname) {
+  return pname == GL_TEXTURE_BORDER_COLOR ? 4 : 1;
+}
+
+// Returns the number of values in each element of the array read by the
+// function named |name|, which is the digit at |digit_index| of the name,
+// squared if the function sets matrices.
+static int64 GetVectorSize(const std::string& name, size_t digit_index,
+                           bool is_matrix) {
+  const int64 n = name[digit_index] - '0';
+  return is_matrix ? n * n : n;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Serialization helpers.
+//
+//-----------------------------------------------------------------------------
+
+template <typename T>
+static void Append(const T& value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Reads data from a serialized capture, failing once any read runs past its
+// end.
+class Reader {
+ public:
+  explicit Reader(const std::string& data) : data_(data), pos_(0U) {}
+
+  template <typename T>
+  bool Read(T* value) {
+    if (data_.size() - pos_ < sizeof(T))
+      return false;
+    memcpy(value, &data_[pos_], sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  bool ReadBytes(size_t size, std::vector<uint8>* bytes) {
+    if (data_.size() - pos_ < size)
+      return false;
+    const uint8* start = reinterpret_cast<const uint8*>(&data_[pos_]);
+    bytes->assign(start, start + size);
+    pos_ += size;
+    return true;
+  }
+
+  bool AtEnd() const { return pos_ == data_.size(); }
+
+ private:
+  const std::string& data_;
+  size_t pos_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// Replay helpers.
+//
+//-----------------------------------------------------------------------------
+
+// Memory handed to a replayed call for arguments that it writes or that need
+// to be rebuilt.
+struct ReplayScratch {
+  std::vector<uint8> output;
+  std::vector<const GLchar*> strings;
+};
+
+// Returns the pointer that a replayed call is passed for |arg|.
+static const void* GetReplayPointer(const Arg& arg, ReplayScratch* scratch) {
+  switch (arg.kind) {
+    case Arg::kData:
+      return arg.data.empty() ? NULL : &arg.data[0];
+    case Arg::kStringArray: {
+      scratch->strings.clear();
+      const GLchar* start = reinterpret_cast<const GLchar*>(
+          arg.data.empty() ? NULL : &arg.data[0]);
+      for (uint64 i = 0, pos = 0; i < arg.value; ++i) {
+        scratch->strings.push_back(start + pos);
+        pos += strlen(start + pos) + 1U;
+      }
+      return scratch->strings.empty() ? NULL : &scratch->strings[0];
+    }
+    case Arg::kOutput:
+      return &scratch->output[0];
+    case Arg::kValue:
+    default:
+      return reinterpret_cast<const void*>(static_cast<uintptr_t>(arg.value));
+  }
+}
+
+// Converts a captured argument back to the type of the parameter it was
+// passed as.
+template <typename T, typename Enable = void>
+struct ArgDecoder {
+  static T Decode(const Arg& arg, ReplayScratch* scratch) {
+    T value;
+    memcpy(&value, &arg.value, sizeof(value));
+    return value;
+  }
+};
+template <typename T>
+struct ArgDecoder<
+    T*, typename std::enable_if<!std::is_function<T>::value>::type> {
+  static T* Decode(const Arg& arg, ReplayScratch* scratch) {
+    return static_cast<T*>(const_cast<void*>(GetReplayPointer(arg, scratch)));
+  }
+};
+// Callbacks are not replayed.
+template <typename T>
+struct ArgDecoder<
+    T*, typename std::enable_if<std::is_function<T>::value>::type> {
+  static T* Decode(const Arg& arg, ReplayScratch* scratch) { return NULL; }
+};
+
+// Compile-time lists of types and indices, used to pair the parameters of a
+// function with the captured arguments.
+template <typename... Types> struct TypeList {};
+template <size_t... Indices> struct IndexList {};
+template <size_t N, size_t... Indices>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, Indices...> {};
+template <size_t... Indices>
+struct MakeIndexList<0, Indices...> {
+  typedef IndexList<Indices...> Type;
+};
+
+template <typename F, typename... Params, size_t... Indices>
+static void InvokeWithIndices(const F& function, const Call& call,
+                              ReplayScratch* scratch, TypeList<Params...>,
+                              IndexList<Indices...>) {
+  function(ArgDecoder<Params>::Decode(call.args[Indices], scratch)...);
+}
+
+// Calls |function| with the arguments of |call| converted to its parameter
+// types. Returns false without calling it if the call cannot be replayed.
+template <typename F, typename R, typename... Params>
+static bool InvokeWithCapturedArgs(const F& function,
+                                   R (F::*)(Params...) const, const Call& call,
+                                   ReplayScratch* scratch) {
+  if (call.args.size() != sizeof...(Params))
+    return false;
+  const bool uses_sync[] = { false, std::is_same<Params, GLsync>::value... };
+  size_t output_size = kDefaultOutputSize;
+  for (size_t i = 0; i < call.args.size(); ++i) {
+    if (uses_sync[i + 1])
+      return false;
+    if (call.args[i].kind == Arg::kOutput)
+      output_size =
+          std::max(output_size, static_cast<size_t>(call.args[i].value));
+  }
+  if (scratch->output.size() < output_size)
+    scratch->output.resize(output_size);
+  InvokeWithIndices(function, call, scratch, TypeList<Params...>(),
+                    typename MakeIndexList<sizeof...(Params)>::Type());
+  return true;
+}
+
+// Replays a call through a GraphicsManager, returning whether it could.
+typedef bool (*ReplayFunction)(GraphicsManager* gm, const Call& call,
+                               ReplayScratch* scratch);
+typedef std::map<std::string, ReplayFunction> ReplayFunctionMap;
+
+// Returns a map from each wrapped function name to a function that replays it.
+static ReplayFunctionMap* CreateReplayFunctions() {
+  ReplayFunctionMap* functions = new ReplayFunctionMap;
+#define ION_WRAP_GL_FUNC(group, name, return_type, typed_args, args, trace) \
+  (*functions)[#name] = [](GraphicsManager* gm, const Call& call,           \
+                           ReplayScratch* scratch) {                        \
+    auto invoke = [gm] typed_args -> return_type { return gm->name args; }; \
+    return InvokeWithCapturedArgs(invoke, &decltype(invoke)::operator(),   \
+                                  call, scratch);                           \
+  };
+#include "ion/gfx/glfunctions.inc"
+  return functions;
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// FrameCapture functions.
+//
+//-----------------------------------------------------------------------------
+
+FrameCapture::FrameCapture()
+    : is_pixel_unpack_buffer_bound_(false),
+      unpack_alignment_(4) {}
+
+FrameCapture::~FrameCapture() {}
+
+void FrameCapture::Clear() {
+  base::LockGuard guard(&mutex_);
+  calls_.clear();
+  is_pixel_unpack_buffer_bound_ = false;
+  unpack_alignment_ = 4;
+}
+
+FrameCapture::Arg FrameCapture::EncodeArg(const GLchar* value) {
+  Arg arg;
+  if (value) {
+    arg.kind = Arg::kData;
+    arg.data.assign(value, value + strlen(value) + 1U);
+  }
+  return arg;
+}
+
+FrameCapture::Arg FrameCapture::EncodeArg(GLsync value) {
+  Arg arg;
+  arg.value = reinterpret_cast<uint64>(value);
+  return arg;
+}
+
+void FrameCapture::AddCall(Call* call) {
+  base::LockGuard guard(&mutex_);
+  const std::string& name = call->name;
+  std::vector<Arg>& args = call->args;
+
+  // Track the state that determines what pixel data pointers mean.
+  if (name == "BindBuffer" && args[0].value == GL_PIXEL_UNPACK_BUFFER)
+    is_pixel_unpack_buffer_bound_ = args[1].value != 0U;
+  else if (name == "PixelStorei" && args[0].value == GL_UNPACK_ALIGNMENT)
+    unpack_alignment_ = static_cast<GLint>(GetInt(args[1]));
+
+  // Copy the data read by the call.
+  const bool pixels_are_offsets = is_pixel_unpack_buffer_bound_;
+  if (name == "BufferData" || name == "BufferStorage") {
+    CaptureData(&args[2], GetInt(args[1]));
+  } else if (name == "BufferSubData") {
+    CaptureData(&args[3], GetInt(args[2]));
+  } else if (name == "TexImage2D") {
+    if (!pixels_are_offsets)
+      CaptureData(&args[8], GetPixelDataSize(
+          static_cast<GLenum>(args[6].value), static_cast<GLenum>(args[7].value),
+          GetInt(args[3]), GetInt(args[4]), 1, unpack_alignment_));
+  } else if (name == "TexSubImage2D") {
+    if (!pixels_are_offsets)
+      CaptureData(&args[8], GetPixelDataSize(
+          static_cast<GLenum>(args[6].value), static_cast<GLenum>(args[7].value),
+          GetInt(args[4]), GetInt(args[5]), 1, unpack_alignment_));
+  } else if (name == "TexImage3D") {
+    if (!pixels_are_offsets)
+      CaptureData(&args[9], GetPixelDataSize(
+          static_cast<GLenum>(args[7].value), static_cast<GLenum>(args[8].value),
+          GetInt(args[3]), GetInt(args[4]), GetInt(args[5]),
+          unpack_alignment_));
+  } else if (name == "TexSubImage3D") {
+    if (!pixels_are_offsets)
+      CaptureData(&args[10], GetPixelDataSize(
+          static_cast<GLenum>(args[8].value), static_cast<GLenum>(args[9].value),
+          GetInt(args[5]), GetInt(args[6]), GetInt(args[7]),
+          unpack_alignment_));
+  } else if (name == "CompressedTexImage2D") {
+    if (!pixels_are_offsets)
+      CaptureData(&args[7], GetInt(args[6]));
+  } else if (name == "CompressedTexSubImage2D" ||
+             name == "CompressedTexImage3D") {
+    if (!pixels_are_offsets)
+      CaptureData(&args[8], GetInt(args[7]));
+  } else if (name == "CompressedTexSubImage3D") {
+    if (!pixels_are_offsets)
+      CaptureData(&args[10], GetInt(args[9]));
+  } else if (name.compare(0, 13, "UniformMatrix") == 0) {
+    CaptureData(&args[3], GetInt(args[1]) * GetVectorSize(name, 13, true) *
+                              static_cast<int64>(sizeof(GLfloat)));
+  } else if (name.compare(0, 7, "Uniform") == 0 && name.size() > 8 &&
+             name[name.size() - 1] == 'v') {
+    // glUniform{1234}{f,i,ui}v().
+    CaptureData(&args[2], GetInt(args[1]) * GetVectorSize(name, 7, false) *
+                              static_cast<int64>(sizeof(GLint)));
+  } else if (name.compare(0, 12, "VertexAttrib") == 0 && name.size() == 15 &&
+             name[14] == 'v') {
+    CaptureData(&args[1], GetVectorSize(name, 12, false) *
+                              static_cast<int64>(sizeof(GLfloat)));
+  } else if (name == "TexParameterfv" || name == "TexParameteriv" ||
+             name == "SamplerParameterfv" || name == "SamplerParameteriv") {
+    CaptureData(&args[2], GetParameterCount(static_cast<GLenum>(args[1].value)) *
+                              static_cast<int64>(sizeof(GLint)));
+  } else if (name.compare(0, 6, "Delete") == 0 && args.size() == 2U &&
+             args[1].kind == Arg::kValue) {
+    // glDelete*s(n, names).
+    CaptureData(&args[1], GetInt(args[0]) * static_cast<int64>(sizeof(GLuint)));
+  } else if (name == "InvalidateFramebuffer") {
+    CaptureData(&args[2], GetInt(args[1]) * static_cast<int64>(sizeof(GLenum)));
+  } else if (name == "MultiDrawArrays") {
+    const int64 count = GetInt(args[3]);
+    CaptureData(&args[1], count * static_cast<int64>(sizeof(GLint)));
+    CaptureData(&args[2], count * static_cast<int64>(sizeof(GLsizei)));
+  } else if (name == "MultiDrawElements") {
+    // The index pointers are offsets into the bound element array buffer.
+    const int64 count = GetInt(args[4]);
+    CaptureData(&args[1], count * static_cast<int64>(sizeof(GLsizei)));
+    CaptureData(&args[3], count * static_cast<int64>(sizeof(GLvoid*)));
+  } else if (name == "ProgramBinary") {
+    CaptureData(&args[2], GetInt(args[3]));
+  } else if (name == "ShaderBinary") {
+    CaptureData(&args[1], GetInt(args[0]) * static_cast<int64>(sizeof(GLuint)));
+    CaptureData(&args[3], GetInt(args[4]));
+  } else if (name == "ShaderSource") {
+    CaptureStrings(&args[2], static_cast<GLsizei>(GetInt(args[1])),
+                   reinterpret_cast<const GLint*>(GetRecordedPointer(args[3])));
+    // The strings are NUL-terminated, so the lengths are not needed.
+    args[3].value = 0U;
+  } else if (name == "TransformFeedbackVaryings") {
+    CaptureStrings(&args[2], static_cast<GLsizei>(GetInt(args[1])), NULL);
+  }
+
+  // Record how much memory outputs need instead of where they were written.
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (args[i].kind == Arg::kOutput)
+      args[i].value = 0U;
+  }
+  if (name == "ReadPixels") {
+    args[6].value = static_cast<uint64>(std::max<int64>(GetPixelDataSize(
+        static_cast<GLenum>(args[4].value), static_cast<GLenum>(args[5].value),
+        GetInt(args[2]), GetInt(args[3]), 1, 8), 0));
+  } else if (name == "GetProgramBinary") {
+    args[4].value = static_cast<uint64>(std::max<int64>(GetInt(args[1]), 0));
+  }
+
+  calls_.push_back(*call);
+}
+
+const std::string FrameCapture::Serialize() const {
+  std::string out(kCaptureTag, sizeof(kCaptureTag) - 1U);
+  Append(static_cast<uint32>(calls_.size()), &out);
+  for (size_t i = 0; i < calls_.size(); ++i) {
+    const Call& call = calls_[i];
+    Append(static_cast<uint16>(call.name.size()), &out);
+    out.append(call.name);
+    Append(static_cast<uint8>(call.args.size()), &out);
+    for (size_t j = 0; j < call.args.size(); ++j) {
+      const Arg& arg = call.args[j];
+      Append(static_cast<uint8>(arg.kind), &out);
+      Append(arg.value, &out);
+      if (arg.kind == Arg::kData || arg.kind == Arg::kStringArray) {
+        Append(static_cast<uint32>(arg.data.size()), &out);
+        if (!arg.data.empty())
+          out.append(reinterpret_cast<const char*>(&arg.data[0]),
+                     arg.data.size());
+      }
+    }
+  }
+  return out;
+}
+
+bool FrameCapture::Deserialize(const std::string& data) {
+  base::LockGuard guard(&mutex_);
+  calls_.clear();
+  const size_t tag_size = sizeof(kCaptureTag) - 1U;
+  if (data.compare(0, tag_size, kCaptureTag) != 0)
+    return false;
+
+  Reader reader(data);
+  std::vector<uint8> bytes;
+  std::vector<Call> calls;
+  uint32 call_count = 0;
+  bool ok = reader.ReadBytes(tag_size, &bytes) && reader.Read(&call_count);
+  for (uint32 i = 0; ok && i < call_count; ++i) {
+    Call call;
+    uint16 name_size = 0;
+    uint8 arg_count = 0;
+    ok = reader.Read(&name_size) && reader.ReadBytes(name_size, &bytes) &&
+         reader.Read(&arg_count);
+    if (ok)
+      call.name.assign(bytes.begin(), bytes.end());
+    for (uint8 j = 0; ok && j < arg_count; ++j) {
+      Arg arg;
+      uint8 kind = 0;
+      ok = reader.Read(&kind) && kind <= Arg::kOutput &&
+           reader.Read(&arg.value);
+      arg.kind = static_cast<Arg::Kind>(kind);
+      if (ok && (arg.kind == Arg::kData || arg.kind == Arg::kStringArray)) {
+        uint32 size = 0;
+        ok = reader.Read(&size) && reader.ReadBytes(size, &arg.data);
+      }
+      call.args.push_back(arg);
+    }
+    calls.push_back(call);
+  }
+  if (!ok || !reader.AtEnd())
+    return false;
+  calls_.swap(calls);
+  return true;
+}
+
+const FrameCapture::ReplayTimings FrameCapture::Replay(
+    GraphicsManager* gm, int iteration_count, bool finish_each_call) const {
+  ION_DECLARE_SAFE_STATIC_POINTER_WITH_CONSTRUCTOR(
+      const ReplayFunctionMap, functions, CreateReplayFunctions());
+  ReplayTimings timings;
+  timings.call_ms.resize(calls_.size(), 0.0);
+  ReplayScratch scratch;
+  const size_t call_count = calls_.size();
+  std::vector<ReplayFunction> replay_functions(call_count, NULL);
+  for (size_t i = 0; i < call_count; ++i) {
+    ReplayFunctionMap::const_iterator it = functions->find(calls_[i].name);
+    if (it != functions->end())
+      replay_functions[i] = it->second;
+  }
+
+  port::Timer total_timer;
+  for (int iteration = 0; iteration < iteration_count; ++iteration) {
+    size_t skipped_count = 0U;
+    for (size_t i = 0; i < call_count; ++i) {
+      port::Timer call_timer;
+      const bool was_replayed =
+          replay_functions[i] && replay_functions[i](gm, calls_[i], &scratch);
+      if (was_replayed && finish_each_call)
+        gm->Finish();
+      timings.call_ms[i] += call_timer.GetInMs();
+      if (!was_replayed)
+        ++skipped_count;
+    }
+    timings.skipped_count = skipped_count;
+    ++timings.iteration_count;
+  }
+  timings.total_ms = total_timer.GetInMs();
+  return timings;
+}
+
+}  // namespace gfx
+}  // namespace ion
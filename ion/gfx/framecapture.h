@@ -0,0 +1,174 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFX_FRAMECAPTURE_H_
+#define ION_GFX_FRAMECAPTURE_H_
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/referent.h"
+#include "ion/port/mutex.h"
+#include "ion/portgfx/glheaders.h"
+
+namespace ion {
+namespace gfx {
+
+class GraphicsManager;
+
+// A FrameCapture records the OpenGL calls made through a GraphicsManager that
+// it is installed in, together with the data the calls read through pointers,
+// such as buffer and texture uploads, uniform values, and shader sources. A
+// capture can be serialized to a compact binary string and deserialized again,
+// and replayed against another GraphicsManager with per-call timings, which
+// makes it possible to reproduce the GPU cost of a frame on another machine.
+//
+// Calls are recorded only in non-production builds, like tracing. Arguments
+// are captured according to their types and, for calls that read data, the
+// functions they are passed to:
+//  - Values, including pointers that are offsets into bound buffers (e.g., the
+//    indices passed to glDrawElements()), are recorded as is.
+//  - Data read by the call is copied. This includes strings, data passed to
+//    glBufferData(), glTexImage2D() and similar functions, and the arrays
+//    passed to glUniform*v() and glDelete*(). Pixel data is treated as an
+//    offset while a pixel unpack buffer is bound.
+//  - Pointers the call writes through, as for glGet*() and glGen*(), are
+//    replaced by scratch memory when replaying.
+// Data written through mapped buffer pointers is not captured, and calls that
+// use sync objects are not replayed. Replay does not translate object names,
+// so it expects OpenGL to hand out the same names it did when the calls were
+// captured, as a new context does when the capture includes the creation of
+// every object it uses.
+class ION_API FrameCapture : public base::Referent {
+ public:
+  // An argument of a captured call.
+  struct Arg {
+    enum Kind {
+      kValue,        // |value| holds the argument.
+      kData,         // |data| holds what the pointer points to.
+      kStringArray,  // |data| holds |value| NUL-terminated strings.
+      kOutput,       // The call writes through the pointer; |value| is the
+                     // number of bytes it writes, or 0 if unknown.
+    };
+    Arg() : kind(kValue), value(0U) {}
+    Kind kind;
+    uint64 value;
+    std::vector<uint8> data;
+  };
+
+  // A captured call of an OpenGL function, named without the "gl" prefix.
+  struct Call {
+    std::string name;
+    std::vector<Arg> args;
+  };
+
+  // Timings of replayed calls. The times of each call are summed over all
+  // iterations.
+  struct ReplayTimings {
+    ReplayTimings() : iteration_count(0), total_ms(0.0), skipped_count(0U) {}
+    int iteration_count;
+    double total_ms;
+    // The time spent in each call, indexed like GetCalls().
+    std::vector<double> call_ms;
+    // The number of calls per iteration that could not be replayed.
+    size_t skipped_count;
+  };
+
+  FrameCapture();
+
+  // Removes all captured calls.
+  void Clear();
+
+  // Returns the captured calls. This must not be called while calls are being
+  // recorded.
+  const std::vector<Call>& GetCalls() const { return calls_; }
+
+  // Adds a call to the passed function with the passed arguments. This is
+  // called by the GraphicsManager before making each call, and may be called
+  // from any thread.
+  template <typename... Args>
+  void RecordCall(const char* name, Args... args) {
+    Call call;
+    call.name = name;
+    // The leading Arg allows functions without arguments.
+    const Arg encoded[] = { Arg(), EncodeArg(args)... };
+    call.args.assign(encoded + 1, encoded + 1 + sizeof...(Args));
+    AddCall(&call);
+  }
+
+  // Returns the captured calls in a binary format, or parses the format and
+  // replaces the captured calls with the result. Deserialize() returns false
+  // and leaves the instance empty if the data is not a valid capture.
+  const std::string Serialize() const;
+  bool Deserialize(const std::string& data);
+
+  // Makes the captured calls through |gm| |iteration_count| times, timing each
+  // call. If |finish_each_call| is set, each timed call is followed by
+  // glFinish(), so that the times include the GPU work of the calls rather
+  // than just the cost of issuing them.
+  const ReplayTimings Replay(GraphicsManager* gm, int iteration_count,
+                             bool finish_each_call) const;
+
+ private:
+  // The destructor is private because this is derived from Referent.
+  ~FrameCapture() override;
+
+  // Arguments are encoded according to their types; see the class comment.
+  template <typename T>
+  static typename std::enable_if<std::is_arithmetic<T>::value, Arg>::type
+  EncodeArg(T value) {
+    Arg arg;
+    memcpy(&arg.value, &value, sizeof(value));
+    return arg;
+  }
+  template <typename T>
+  static Arg EncodeArg(const T* value) {
+    Arg arg;
+    arg.value = reinterpret_cast<uint64>(value);
+    return arg;
+  }
+  template <typename T>
+  static Arg EncodeArg(T* value) {
+    Arg arg;
+    arg.kind = Arg::kOutput;
+    arg.value = reinterpret_cast<uint64>(value);
+    return arg;
+  }
+  static Arg EncodeArg(const GLchar* value);
+  static Arg EncodeArg(GLsync value);
+
+  // Copies the data that |call| reads, tracks the state that affects it, and
+  // appends |call| to the captured calls.
+  void AddCall(Call* call);
+
+  port::Mutex mutex_;
+  std::vector<Call> calls_;
+  // State that determines how pixel data pointers are interpreted.
+  bool is_pixel_unpack_buffer_bound_;
+  GLint unpack_alignment_;
+};
+
+// Convenience typedef for shared pointer to a FrameCapture.
+typedef base::ReferentPtr<FrameCapture>::Type FrameCapturePtr;
+
+}  // namespace gfx
+}  // namespace ion
+
+#endif  // ION_GFX_FRAMECAPTURE_H_
@@ -84,6 +84,10 @@
       'target_name' : 'graphicsmanager',
       'type': 'static_library',
       'sources' : [
+        'commandbuffer.cc',
+        'commandbuffer.h',
+        'framecapture.cc',
+        'framecapture.h',
         'glfunctions.inc',
         'graphicsmanager.cc',
         'graphicsmanager.h',
@@ -116,6 +120,7 @@
       'dependencies': [
         ':statetable',
         ':tracinghelper',
+        '../port/port.gyp:ionport',
         '../portgfx/portgfx.gyp:ionportgfx',
         '<(ion_dir)/math/math.gyp:ionmath',
       ],
@@ -129,6 +134,8 @@
         'attribute.h',
         'attributearray.cc',
         'attributearray.h',
+        'binarytrace.cc',
+        'binarytrace.h',
         'bufferobject.cc',
         'bufferobject.h',
         'cubemaptexture.cc',
@@ -143,6 +150,10 @@
         'node.cc',
         'node.h',
         'openglobjects.h',
+        'programbinarycache.cc',
+        'programbinarycache.h',
+        'query.cc',
+        'query.h',
         'renderer.cc',
         'renderer.h',
         'resourceholder.cc',
@@ -167,6 +178,8 @@
         'texturemanager.h',
         'tracecallextractor.cc',
         'tracecallextractor.h',
+        'transformfeedback.cc',
+        'transformfeedback.h',
         'uniform.cc',
         'uniform.h',
         'uniformblock.cc',
@@ -212,6 +225,8 @@
         'tests/mockgraphicsmanager.h',
         'tests/mockvisual.cc',
         'tests/mockvisual.h',
+        'tests/nullgraphicsmanager.cc',
+        'tests/nullgraphicsmanager.h',
         'tests/testscene.cc',
         'tests/testscene.h',
         'tests/traceverifier.cc',
@@ -19,9 +19,13 @@ limitations under the License.
 
 #include <string.h>  // For strcmp().
 
+#include <algorithm>
+#include <iterator>
+#include <map>
 #include <vector>
 
 #include "ion/base/allocationmanager.h"
+#include "ion/base/lockguards.h"
 #include "ion/base/logging.h"
 #include "ion/base/once.h"
 #include "ion/base/staticsafedeclare.h"
@@ -34,6 +38,106 @@ limitations under the License.
 namespace ion {
 namespace gfx {
 
+namespace {
+
+// The requirements for enabling a function group, as passed to
+// GraphicsManager::EnableFunctionGroupIfAvailable().
+struct FunctionGroupRequirements {
+  GraphicsManager::FunctionGroupId group;
+  GLuint desktop_version;
+  GLuint es_version;
+  GLuint web_version;
+  const char* extensions;
+  const char* disabled_renderers;
+};
+
+// Function groups whose availability depends on the GL version and
+// extensions.
+static const FunctionGroupRequirements kFunctionGroupRequirements[] = {
+  { GraphicsManager::kBufferStorage, 44U, 0U, 0U, "buffer_storage", "" },
+  { GraphicsManager::kComputeShader, 43U, 31U, 0U, "compute_shader", "" },
+  { GraphicsManager::kConditionalRender, 30U, 0U, 0U, "conditional_render",
+    "" },
+  { GraphicsManager::kDebugLabel, 0U, 0U, 0U, "debug_label", "" },
+  { GraphicsManager::kDebugMarker, 0U, 0U, 0U, "debug_marker", "" },
+  { GraphicsManager::kDebugOutput, 0U, 0U, 0U, "debug_output,debug", "" },
+  { GraphicsManager::kDrawIndirect, 40U, 31U, 0U, "draw_indirect", "" },
+  { GraphicsManager::kFramebufferBlit, 20U, 30U, 0U, "framebuffer_blit", "" },
+  { GraphicsManager::kFramebufferMultisample, 20U, 30U, 0U,
+    "framebuffer_multisample", "" },
+  { GraphicsManager::kGpuShader4, 30U, 30U, 0U, "gpu_shader4", "" },
+  { GraphicsManager::kEglImage, 0U, 0U, 0U, "EGL_image", "" },
+  { GraphicsManager::kGetString, 30U, 30U, 0U, "", "" },
+  { GraphicsManager::kInvalidateFramebuffer, 43U, 30U, 2U,
+    "invalidate_subdata", "" },
+  { GraphicsManager::kMapBuffer, 15U, 30U, 0U,
+    "mapbuffer,vertex_buffer_object", "Vivante GC1000,VideoCore IV HW" },
+  { GraphicsManager::kMapBufferRange, 30U, 30U, 0U, "map_buffer_range",
+    "Vivante GC1000,VideoCore IV HW" },
+  { GraphicsManager::kMultiDraw, 14U, 0U, 0U, "multi_draw_arrays", "" },
+  { GraphicsManager::kMultisampledRenderToTexture, 0U, 0U, 0U,
+    "multisampled_render_to_texture", "" },
+  { GraphicsManager::kMultiview, 0U, 0U, 0U, "multiview", "" },
+  { GraphicsManager::kParallelShaderCompile, 0U, 0U, 0U,
+    "parallel_shader_compile", "" },
+  { GraphicsManager::kProgramBinary, 41U, 30U, 0U, "get_program_binary", "" },
+  { GraphicsManager::kProgramInterfaceQuery, 43U, 31U, 0U,
+    "program_interface_query", "" },
+  { GraphicsManager::kSamplerObjects, 33U, 30U, 0U, "sampler_objects",
+    "Mali ,Mali-" },
+  { GraphicsManager::kTexture3d, 13U, 30U, 0U, "texture_3d", "" },
+  { GraphicsManager::kTextureMultisample, 32U, 30U, 0U, "texture_multisample",
+    "" },
+  { GraphicsManager::kTextureStorage, 42U, 30U, 0U, "texture_storage", "" },
+  { GraphicsManager::kTextureStorageMultisample, 42U, 30U, 0U,
+    "texture_storage_multisample", "" },
+  { GraphicsManager::kVertexArrays, 30U, 30U, 0U, "vertex_array_object",
+    "Internet Explorer" },
+  { GraphicsManager::kInstancedDrawing, 33U, 30U, 0U, "instanced_drawing",
+    "" },
+  { GraphicsManager::kSync, 32U, 30U, 2U, "sync", "" },
+  { GraphicsManager::kRaw, 0U, 0U, 0U, "", "" },
+  { GraphicsManager::kTransformFeedback, 40U, 30U, 0U, "transform_feedback",
+    "" },
+  { GraphicsManager::kUniformBufferObjects, 31U, 30U, 2U,
+    "uniform_buffer_object", "" },
+};
+
+// Returns whether the functions of the passed group are rarely used, so that
+// looking them up can be deferred until they are needed. Groups that affect
+// the valid state table capabilities or that InitGlInfo() calls are never
+// deferred. Nothing is deferred when functions are called directly, since
+// direct calls do not resolve deferred functions.
+static bool IsDeferredFunctionGroup(GraphicsManager::FunctionGroupId group) {
+  switch (group) {
+    case GraphicsManager::kBufferStorage:
+    case GraphicsManager::kComputeShader:
+    case GraphicsManager::kConditionalRender:
+    case GraphicsManager::kDebugLabel:
+    case GraphicsManager::kDebugMarker:
+    case GraphicsManager::kDrawIndirect:
+    case GraphicsManager::kEglImage:
+    case GraphicsManager::kGpuShader4:
+    case GraphicsManager::kMultisampleFramebufferResolve:
+    case GraphicsManager::kParallelShaderCompile:
+    case GraphicsManager::kProgramBinary:
+    case GraphicsManager::kProgramInterfaceQuery:
+    case GraphicsManager::kRaw:
+    case GraphicsManager::kTextureMultisample:
+    case GraphicsManager::kTextureStorageMultisample:
+    case GraphicsManager::kTransformFeedback:
+#if ION_PRODUCTION && defined(ION_GFX_DIRECT_GL_CALLS)
+      return false;
+#else
+      return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+}  // anonymous namespace
+
 //-----------------------------------------------------------------------------
 //
 // Capability queries.
@@ -169,6 +273,8 @@ class GraphicsManager::CapabilityHelper {
                    GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS, GetInt);
     ION_SINGLE_CAP(kMaxTransformFeedbackSeparateComponents,
                    GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS, GetInt);
+    ION_SINGLE_CAP(kMaxUniformBufferBindings, GL_MAX_UNIFORM_BUFFER_BINDINGS,
+                   GetInt);
     ION_SINGLE_CAP(kMaxVaryingVectors, GL_MAX_VARYING_VECTORS, GetInt);
     ION_SINGLE_CAP(kMaxVertexAttribs, GL_MAX_VERTEX_ATTRIBS, GetInt);
     ION_SINGLE_CAP(kMaxVertexTextureImageUnits,
@@ -185,6 +291,7 @@ class GraphicsManager::CapabilityHelper {
     ION_SINGLE_CAP(kMaxDebugLoggedMessages, GL_MAX_DEBUG_LOGGED_MESSAGES,
                    GetInt);
     ION_SINGLE_CAP(kMaxDebugMessageLength, GL_MAX_DEBUG_MESSAGE_LENGTH, GetInt);
+    ION_SINGLE_CAP(kMaxViews, GL_MAX_VIEWS_OVR, GetInt);
     ION_DOUBLE_CAP(kFragmentShaderHighFloatPrecisionFormat, GL_FRAGMENT_SHADER,
                    GL_HIGH_FLOAT, GetShaderPrecision);
     ION_DOUBLE_CAP(kFragmentShaderHighIntPrecisionFormat, GL_FRAGMENT_SHADER,
@@ -267,6 +374,47 @@ class GraphicsManager::FunctionGroup {
   std::vector<std::string> missing_functions_;
 };
 
+//-----------------------------------------------------------------------------
+//
+// GraphicsManager::SharedInfo holds the function pointers and OpenGL
+// information of an OpenGL driver, so that GraphicsManagers created for the
+// same driver do not have to look them up again.
+//
+//-----------------------------------------------------------------------------
+
+struct GraphicsManager::SharedInfo {
+  explicit SharedInfo(size_t wrapper_count)
+      : functions(wrapper_count, NULL),
+        has_gl_info(false),
+        gl_version(0U),
+        gl_api_standard(kEs),
+        gl_profile_type(kCompatibilityProfile),
+        capability_helper(new CapabilityHelper) {}
+
+  // Protects all of the fields except |capability_helper|, which is
+  // thread-safe.
+  port::Mutex mutex;
+
+  // The function pointers, indexed like GraphicsManager::wrappers_, and the
+  // groups whose functions have been looked up.
+  std::vector<void*> functions;
+  std::bitset<kNumFunctionGroupIds> resolved_groups;
+
+  // The information set by InitGlInfo(), which is valid once |has_gl_info| is
+  // set. |enabled_groups| only applies to groups that are not deferred.
+  bool has_gl_info;
+  std::string extensions;
+  std::string gl_renderer;
+  std::string gl_version_string;
+  GLuint gl_version;
+  GlApi gl_api_standard;
+  GlProfile gl_profile_type;
+  std::bitset<StateTable::kNumCapabilities> valid_statetable_caps;
+  std::bitset<kNumFunctionGroupIds> enabled_groups;
+
+  std::shared_ptr<CapabilityHelper> capability_helper;
+};
+
 //-----------------------------------------------------------------------------
 //
 // Thread local wrapper collection for GraphicsManager.
@@ -298,9 +446,14 @@ GraphicsManager::GraphicsManager()
     : wrappers_(GetAllocator()),
       function_groups_(GetAllocator()),
       capability_helper_(new CapabilityHelper),
+      deferred_groups_(0U),
       wrapped_function_names_(*this),
       is_error_checking_enabled_(false),
+      is_deferred_error_checking_enabled_(false),
+      deferred_error_check_batch_(kCheckErrorsPerFrame),
+      recent_call_count_(0U),
       tracing_ostream_(NULL),
+      is_call_statistics_enabled_(false),
       gl_version_(20),
       gl_api_standard_(kEs),
       gl_profile_type_(kCompatibilityProfile) {
@@ -311,9 +464,14 @@ GraphicsManager::GraphicsManager(GraphicsManager* gm)
     : wrappers_(GetAllocator()),
       function_groups_(GetAllocator()),
       capability_helper_(new CapabilityHelper),
+      deferred_groups_(0U),
       wrapped_function_names_(*this),
       is_error_checking_enabled_(false),
+      is_deferred_error_checking_enabled_(false),
+      deferred_error_check_batch_(kCheckErrorsPerFrame),
+      recent_call_count_(0U),
       tracing_ostream_(NULL),
+      is_call_statistics_enabled_(false),
       gl_version_(20),
       gl_api_standard_(kEs),
       gl_profile_type_(kCompatibilityProfile) {
@@ -337,7 +495,7 @@ void GraphicsManager::Init(bool init_functions_from_gl) {
   thread_wrappers.reserve(0U);
 
   if (init_functions_from_gl) {
-    InitFunctions();
+    InitSharedFunctions();
 
 #if !defined(ION_COVERAGE)  // COV_NF_START
     if (!function_groups_[kCore].IsComplete()) {
@@ -379,7 +537,21 @@ template const GraphicsManager::ShaderPrecision
 template const std::vector<int>
     GraphicsManager::GetCapabilityValue<std::vector<int> >(Capability cap);
 
+bool GraphicsManager::IsFunctionAvailable(
+    const std::string& function_name) const {
+  // The names of deferred functions are only known once their groups have been
+  // resolved.
+  for (int group = 0; group < kNumFunctionGroupIds; ++group)
+    ResolveFunctionGroup(static_cast<FunctionGroupId>(group));
+  return wrapped_function_names_.count(function_name) > 0;
+}
+
 bool GraphicsManager::IsFunctionGroupAvailable(FunctionGroupId group) const {
+  ResolveFunctionGroup(group);
+  return IsFunctionGroupComplete(group);
+}
+
+bool GraphicsManager::IsFunctionGroupComplete(FunctionGroupId group) const {
   return function_groups_.size() > 0 && function_groups_[group].IsComplete();
 }
 
@@ -387,6 +559,347 @@ bool GraphicsManager::IsExtensionSupported(const std::string& name) const {
   return portgfx::IsExtensionSupported(name, extensions_);
 }
 
+bool GraphicsManager::IsCompressedTextureFormatSupported(
+    GLenum internal_format) const {
+  switch (internal_format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+      return IsExtensionSupported("texture_compression_s3tc") ||
+             IsExtensionSupported("texture_compression_dxt1");
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+      return IsExtensionSupported("texture_compression_s3tc") ||
+             IsExtensionSupported("texture_compression_dxt5");
+    case GL_ETC1_RGB8_OES:
+      return IsExtensionSupported("compressed_ETC1_RGB8_texture");
+    case GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG:
+    case GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG:
+    case GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG:
+    case GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG:
+      return IsExtensionSupported("texture_compression_pvrtc");
+    case GL_COMPRESSED_R11_EAC:
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+      // ETC2 and EAC are core in OpenGL ES 3.0 and OpenGL 4.3.
+      return (gl_api_standard_ == kEs && gl_version_ >= 30) ||
+             (gl_api_standard_ == kDesktop && gl_version_ >= 43) ||
+             IsExtensionSupported("ES3_compatibility");
+    case GL_COMPRESSED_RGBA_ASTC_4x4_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_5x4_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_5x5_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_6x5_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_6x6_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_8x5_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_8x6_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_8x8_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_10x5_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_10x6_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_10x8_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_10x10_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_12x10_KHR:
+    case GL_COMPRESSED_RGBA_ASTC_12x12_KHR:
+      // The HDR extension includes the LDR profile.
+      return IsExtensionSupported("texture_compression_astc_ldr") ||
+             IsExtensionSupported("texture_compression_astc_hdr");
+    default:
+      return true;
+  }
+}
+
+const GraphicsManager::CallStatistics GraphicsManager::GetCallStatistics()
+    const {
+  CallStatistics statistics = call_statistics_;
+  const size_t count = wrappers_.size();
+  for (size_t i = 0; i < count; ++i)
+    statistics.call_count += wrappers_[i]->GetCallCount();
+  return statistics;
+}
+
+uint64 GraphicsManager::GetFunctionCallCount(
+    const std::string& function_name) const {
+  const size_t count = wrappers_.size();
+  for (size_t i = 0; i < count; ++i) {
+    if (function_name == wrappers_[i]->GetFuncName())
+      return wrappers_[i]->GetCallCount();
+  }
+  return 0U;
+}
+
+const std::map<std::string, uint64> GraphicsManager::GetFunctionCallCounts()
+    const {
+  std::map<std::string, uint64> counts;
+  const size_t count = wrappers_.size();
+  for (size_t i = 0; i < count; ++i) {
+    if (const uint64 call_count = wrappers_[i]->GetCallCount())
+      counts[wrappers_[i]->GetFuncName()] = call_count;
+  }
+  return counts;
+}
+
+void GraphicsManager::ResetCallStatistics() {
+  const size_t count = wrappers_.size();
+  for (size_t i = 0; i < count; ++i)
+    wrappers_[i]->ResetCallCount();
+  call_statistics_ = CallStatistics();
+}
+
+//-----------------------------------------------------------------------------
+//
+// Call statistics details.
+//
+//-----------------------------------------------------------------------------
+
+namespace {
+
+// Returns the number of primitives drawn from count vertices in mode.
+static uint64 GetPrimitiveCount(GLenum mode, GLsizei count) {
+  if (count <= 0)
+    return 0U;
+  const uint64 vertex_count = static_cast<uint64>(count);
+  switch (mode) {
+    case GL_POINTS:
+      return vertex_count;
+    case GL_LINES:
+      return vertex_count / 2U;
+    case GL_LINE_LOOP:
+      return vertex_count >= 2U ? vertex_count : 0U;
+    case GL_LINE_STRIP:
+      return vertex_count - 1U;
+    case GL_TRIANGLES:
+      return vertex_count / 3U;
+    case GL_TRIANGLE_FAN:
+    case GL_TRIANGLE_STRIP:
+      return vertex_count >= 3U ? vertex_count - 2U : 0U;
+    default:
+      return 0U;
+  }
+}
+
+// Returns the size in bytes of a pixel with the passed format and type, or 0
+// if either is unknown.
+static uint64 GetPixelSize(GLenum format, GLenum type) {
+  // Packed types hold all components.
+  switch (type) {
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+    case GL_UNSIGNED_SHORT_5_6_5:
+      return 2U;
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_24_8:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+      return 4U;
+    case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+      return 8U;
+    default:
+      break;
+  }
+  uint64 component_size = 0U;
+  switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+      component_size = 1U;
+      break;
+    case GL_HALF_FLOAT:
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+      component_size = 2U;
+      break;
+    case GL_FLOAT:
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+      component_size = 4U;
+      break;
+    default:
+      return 0U;
+  }
+  switch (format) {
+    case GL_ALPHA:
+    case GL_DEPTH_COMPONENT:
+    case GL_LUMINANCE:
+    case GL_RED:
+    case GL_RED_INTEGER:
+      return component_size;
+    case GL_DEPTH_STENCIL:
+    case GL_LUMINANCE_ALPHA:
+    case GL_RG:
+    case GL_RG_INTEGER:
+      return 2U * component_size;
+    case GL_RGB:
+    case GL_RGB_INTEGER:
+      return 3U * component_size;
+    case GL_RGBA:
+    case GL_RGBA_INTEGER:
+      return 4U * component_size;
+    default:
+      return 0U;
+  }
+}
+
+// Returns the size in bytes of an image with the passed dimensions, format,
+// and type.
+static uint64 GetImageSize(GLsizei width, GLsizei height, GLsizei depth,
+                           GLenum format, GLenum type) {
+  if (width <= 0 || height <= 0 || depth <= 0)
+    return 0U;
+  return static_cast<uint64>(width) * static_cast<uint64>(height) *
+         static_cast<uint64>(depth) * GetPixelSize(format, type);
+}
+
+// Returns a non-negative size as a uint64.
+static uint64 ToByteCount(GLsizeiptr size) {
+  return size > 0 ? static_cast<uint64>(size) : 0U;
+}
+
+}  // anonymous namespace
+
+void GraphicsManager::RecordCallDetails(const BufferData_Wrapper* wrapper,
+                                        GLenum target, GLsizeiptr size,
+                                        const GLvoid* data, GLenum usage) {
+  // A NULL pointer only allocates storage.
+  if (data)
+    call_statistics_.buffer_upload_bytes += ToByteCount(size);
+}
+
+void GraphicsManager::RecordCallDetails(const BufferSubData_Wrapper* wrapper,
+                                        GLenum target, GLintptr offset,
+                                        GLsizeiptr size, const GLvoid* data) {
+  call_statistics_.buffer_upload_bytes += ToByteCount(size);
+}
+
+void GraphicsManager::RecordCallDetails(
+    const CompressedTexImage2D_Wrapper* wrapper, GLenum target, GLint level,
+    GLenum internal_format, GLsizei width, GLsizei height, GLint border,
+    GLsizei image_size, const GLvoid* data) {
+  if (data)
+    call_statistics_.texture_upload_bytes += ToByteCount(image_size);
+}
+
+void GraphicsManager::RecordCallDetails(
+    const CompressedTexImage3D_Wrapper* wrapper, GLenum target, GLint level,
+    GLenum internal_format, GLsizei width, GLsizei height, GLsizei depth,
+    GLint border, GLsizei image_size, const GLvoid* data) {
+  if (data)
+    call_statistics_.texture_upload_bytes += ToByteCount(image_size);
+}
+
+void GraphicsManager::RecordCallDetails(
+    const CompressedTexSubImage2D_Wrapper* wrapper, GLenum target, GLint level,
+    GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format,
+    GLsizei image_size, const GLvoid* data) {
+  call_statistics_.texture_upload_bytes += ToByteCount(image_size);
+}
+
+void GraphicsManager::RecordCallDetails(
+    const CompressedTexSubImage3D_Wrapper* wrapper, GLenum target, GLint level,
+    GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height,
+    GLsizei depth, GLenum format, GLsizei image_size, const GLvoid* data) {
+  call_statistics_.texture_upload_bytes += ToByteCount(image_size);
+}
+
+void GraphicsManager::RecordCallDetails(const DrawArrays_Wrapper* wrapper,
+                                        GLenum mode, GLint first,
+                                        GLsizei count) {
+  ++call_statistics_.draw_call_count;
+  call_statistics_.primitive_count += GetPrimitiveCount(mode, count);
+}
+
+void GraphicsManager::RecordCallDetails(
+    const DrawArraysInstanced_Wrapper* wrapper, GLenum mode, GLint first,
+    GLsizei count, GLsizei instance_count) {
+  ++call_statistics_.draw_call_count;
+  if (instance_count > 0) {
+    call_statistics_.primitive_count +=
+        GetPrimitiveCount(mode, count) * static_cast<uint64>(instance_count);
+  }
+}
+
+void GraphicsManager::RecordCallDetails(const DrawElements_Wrapper* wrapper,
+                                        GLenum mode, GLsizei count,
+                                        GLenum type, const GLvoid* indices) {
+  ++call_statistics_.draw_call_count;
+  call_statistics_.primitive_count += GetPrimitiveCount(mode, count);
+}
+
+void GraphicsManager::RecordCallDetails(
+    const DrawElementsInstanced_Wrapper* wrapper, GLenum mode, GLsizei count,
+    GLenum type, const GLvoid* indices, GLsizei instance_count) {
+  ++call_statistics_.draw_call_count;
+  if (instance_count > 0) {
+    call_statistics_.primitive_count +=
+        GetPrimitiveCount(mode, count) * static_cast<uint64>(instance_count);
+  }
+}
+
+void GraphicsManager::RecordCallDetails(const MultiDrawArrays_Wrapper* wrapper,
+                                        GLenum mode, const GLint* first,
+                                        const GLsizei* count,
+                                        GLsizei draw_count) {
+  // Each of the draws counts as a draw call, since that is what a multi-draw
+  // replaces.
+  for (GLsizei i = 0; i < draw_count; ++i) {
+    ++call_statistics_.draw_call_count;
+    call_statistics_.primitive_count += GetPrimitiveCount(mode, count[i]);
+  }
+}
+
+void GraphicsManager::RecordCallDetails(
+    const MultiDrawElements_Wrapper* wrapper, GLenum mode,
+    const GLsizei* count, GLenum type, const GLvoid* const* indices,
+    GLsizei draw_count) {
+  for (GLsizei i = 0; i < draw_count; ++i) {
+    ++call_statistics_.draw_call_count;
+    call_statistics_.primitive_count += GetPrimitiveCount(mode, count[i]);
+  }
+}
+
+void GraphicsManager::RecordCallDetails(const TexImage2D_Wrapper* wrapper,
+                                        GLint target, GLint level,
+                                        GLenum internal_format, GLsizei width,
+                                        GLsizei height, GLint border,
+                                        GLenum format, GLenum type,
+                                        const GLvoid* pixels) {
+  // A NULL pointer only allocates storage. Data read from the start of a
+  // bound pixel unpack buffer is therefore not counted.
+  if (pixels) {
+    call_statistics_.texture_upload_bytes +=
+        GetImageSize(width, height, 1, format, type);
+  }
+}
+
+void GraphicsManager::RecordCallDetails(const TexImage3D_Wrapper* wrapper,
+                                        GLint target, GLint level,
+                                        GLenum internal_format, GLsizei width,
+                                        GLsizei height, GLsizei depth,
+                                        GLint border, GLenum format,
+                                        GLenum type, const GLvoid* pixels) {
+  if (pixels) {
+    call_statistics_.texture_upload_bytes +=
+        GetImageSize(width, height, depth, format, type);
+  }
+}
+
+void GraphicsManager::RecordCallDetails(const TexSubImage2D_Wrapper* wrapper,
+                                        GLenum target, GLint level,
+                                        GLint xoffset, GLint yoffset,
+                                        GLsizei width, GLsizei height,
+                                        GLenum format, GLenum type,
+                                        const GLvoid* data) {
+  call_statistics_.texture_upload_bytes +=
+      GetImageSize(width, height, 1, format, type);
+}
+
+void GraphicsManager::RecordCallDetails(const TexSubImage3D_Wrapper* wrapper,
+                                        GLenum target, GLint level,
+                                        GLint xoffset, GLint yoffset,
+                                        GLint zoffset, GLsizei width,
+                                        GLsizei height, GLsizei depth,
+                                        GLenum format, GLenum type,
+                                        const GLvoid* data) {
+  call_statistics_.texture_upload_bytes +=
+      GetImageSize(width, height, depth, format, type);
+}
+
 void GraphicsManager::AddWrapper(WrapperBase* wrapper) {
   WrapperVecHolder* holder = GetWrapperVecHolder();
   WrapperVec& thread_wrappers = holder->GetWrappers();
@@ -407,6 +920,14 @@ void GraphicsManager::AddFunctionToGroup(FunctionGroupId group,
 
 void GraphicsManager::EnableFunctionGroup(
     FunctionGroupId group, bool enable) {
+  // Resolve a deferred group first so that resolving it later does not
+  // override the passed setting.
+  ResolveFunctionGroup(group);
+  SetFunctionGroupEnabled(group, enable);
+}
+
+void GraphicsManager::SetFunctionGroupEnabled(
+    FunctionGroupId group, bool enable) {
   if (function_groups_.size() > 0)
     function_groups_[group].SetEnabled(enable);
 
@@ -433,6 +954,178 @@ void GraphicsManager::InitFunctions() {
   InitGlInfo();
 }
 
+void GraphicsManager::InitSharedFunctions() {
+  // The functions that identify the driver have to be looked up before
+  // anything can be shared.
+  WrapperBase* const driver_wrappers[] = {
+    &GetString_wrapper_, &GetIntegerv_wrapper_, &GetError_wrapper_
+  };
+  for (WrapperBase* wrapper : driver_wrappers) {
+    if (wrapper->Init(this))
+      AddWrappedFunctionName(wrapper->GetFuncName());
+  }
+  const std::string key = GetDriverKey();
+  if (key.empty()) {
+    // Without a context there is nothing to share, so look up everything.
+    ReinitFunctions();
+    return;
+  }
+  shared_info_ = GetSharedInfo(key, wrappers_.size());
+
+  uint64 deferred_groups = 0U;
+  {
+    base::LockGuard guard(&shared_info_->mutex);
+    const size_t num_wrappers = wrappers_.size();
+    for (size_t i = 0; i < num_wrappers; ++i) {
+      WrapperBase* wrapper = wrappers_[i];
+      const FunctionGroupId group = wrapper->GetGroup();
+      if (IsDeferredFunctionGroup(group)) {
+        wrapper->Defer(this);
+        deferred_groups |= static_cast<uint64>(1) << group;
+        continue;
+      }
+      void* function = NULL;
+      if (std::find(std::begin(driver_wrappers), std::end(driver_wrappers),
+                    wrapper) != std::end(driver_wrappers)) {
+        function = wrapper->GetPointer();
+      } else {
+        function = shared_info_->resolved_groups.test(group) ?
+            shared_info_->functions[i] : wrapper->Lookup(this);
+        wrapper->SetPointer(this, function);
+        if (function)
+          AddWrappedFunctionName(wrapper->GetFuncName());
+      }
+      shared_info_->functions[i] = function;
+    }
+    for (int group = 0; group < kNumFunctionGroupIds; ++group) {
+      if (!IsDeferredFunctionGroup(static_cast<FunctionGroupId>(group)))
+        shared_info_->resolved_groups.set(group);
+    }
+  }
+  deferred_groups_.store(deferred_groups, std::memory_order_release);
+
+  if (!LoadSharedGlInfo()) {
+    InitGlInfo();
+    SaveSharedGlInfo();
+  }
+  capability_helper_ = shared_info_->capability_helper;
+}
+
+const std::string GraphicsManager::GetDriverKey() {
+  if (!GetString_wrapper_.GetPointer() || !GetIntegerv_wrapper_.GetPointer() ||
+      !GetError_wrapper_.GetPointer())
+    return std::string();
+  const char* vendor = reinterpret_cast<const char*>(GetString(GL_VENDOR));
+  const char* renderer = reinterpret_cast<const char*>(GetString(GL_RENDERER));
+  const char* version = reinterpret_cast<const char*>(GetString(GL_VERSION));
+  if (!vendor || !renderer || !version)
+    return std::string();
+  GLint mask = 0;
+  GetIntegerv(GL_CONTEXT_PROFILE_MASK, &mask);
+  // As in InitGlInfo(), eat the error that non-core contexts generate.
+  GetError();
+  // The address of glGetString() distinguishes OpenGL libraries that report
+  // the same strings.
+  std::ostringstream key;
+  key << vendor << '\n' << renderer << '\n' << version << '\n' << mask << '\n'
+      << GetString_wrapper_.GetPointer();
+  return key.str();
+}
+
+std::shared_ptr<GraphicsManager::SharedInfo> GraphicsManager::GetSharedInfo(
+    const std::string& key, size_t wrapper_count) {
+  typedef std::map<std::string, std::shared_ptr<SharedInfo> > SharedInfoMap;
+  ION_DECLARE_SAFE_STATIC_POINTER(port::Mutex, s_mutex);
+  ION_DECLARE_SAFE_STATIC_POINTER(SharedInfoMap, s_shared_infos);
+  base::LockGuard guard(s_mutex);
+  std::shared_ptr<SharedInfo>& info = (*s_shared_infos)[key];
+  if (!info)
+    info.reset(new SharedInfo(wrapper_count));
+  DCHECK_EQ(wrapper_count, info->functions.size());
+  return info;
+}
+
+void GraphicsManager::SaveSharedGlInfo() {
+  base::LockGuard guard(&shared_info_->mutex);
+  shared_info_->extensions = extensions_;
+  shared_info_->gl_renderer = gl_renderer_;
+  shared_info_->gl_version_string = gl_version_string_;
+  shared_info_->gl_version = gl_version_;
+  shared_info_->gl_api_standard = gl_api_standard_;
+  shared_info_->gl_profile_type = gl_profile_type_;
+  shared_info_->valid_statetable_caps = valid_statetable_caps_;
+  for (int group = 0; group < kNumFunctionGroupIds; ++group) {
+    shared_info_->enabled_groups.set(
+        group, function_groups_.size() > 0 &&
+                   function_groups_[group].IsEnabled());
+  }
+  shared_info_->has_gl_info = true;
+}
+
+bool GraphicsManager::LoadSharedGlInfo() {
+  base::LockGuard guard(&shared_info_->mutex);
+  if (!shared_info_->has_gl_info)
+    return false;
+  extensions_ = shared_info_->extensions;
+  gl_renderer_ = shared_info_->gl_renderer;
+  gl_version_string_ = shared_info_->gl_version_string;
+  gl_version_ = shared_info_->gl_version;
+  gl_api_standard_ = shared_info_->gl_api_standard;
+  gl_profile_type_ = shared_info_->gl_profile_type;
+  for (int group = 0; group < kNumFunctionGroupIds; ++group) {
+    const FunctionGroupId id = static_cast<FunctionGroupId>(group);
+    if (!IsFunctionGroupDeferred(id))
+      SetFunctionGroupEnabled(id, shared_info_->enabled_groups.test(group));
+  }
+  // Set these last, since SetFunctionGroupEnabled() changes some of them.
+  valid_statetable_caps_ = shared_info_->valid_statetable_caps;
+  return true;
+}
+
+void GraphicsManager::ResolveFunctionGroup(FunctionGroupId group) const {
+  static_assert(kNumFunctionGroupIds <= 64,
+                "Function groups do not fit into deferred_groups_");
+  if (!IsFunctionGroupDeferred(group))
+    return;
+  // Resolving a group only completes the construction of this, so it is
+  // allowed for const instances.
+  GraphicsManager* gm = const_cast<GraphicsManager*>(this);
+  base::LockGuard guard(&deferred_mutex_);
+  // Another thread may have resolved the group while this one waited.
+  if (!IsFunctionGroupDeferred(group))
+    return;
+  {
+    base::LockGuard shared_guard(&shared_info_->mutex);
+    const bool is_resolved = shared_info_->resolved_groups.test(group);
+    const size_t num_wrappers = wrappers_.size();
+    for (size_t i = 0; i < num_wrappers; ++i) {
+      WrapperBase* wrapper = wrappers_[i];
+      if (wrapper->GetGroup() != group)
+        continue;
+      void* function =
+          is_resolved ? shared_info_->functions[i] : wrapper->Lookup(gm);
+      wrapper->SetPointer(gm, function);
+      if (function)
+        gm->AddWrappedFunctionName(wrapper->GetFuncName());
+      shared_info_->functions[i] = function;
+    }
+    shared_info_->resolved_groups.set(group);
+  }
+  // This does not make any OpenGL calls, so no context is needed. It also does
+  // not try to resolve the group again, which would deadlock.
+  for (const FunctionGroupRequirements& requirements :
+       kFunctionGroupRequirements) {
+    if (requirements.group == group) {
+      gm->EnableFunctionGroupIfAvailable(
+          group, GlVersions(requirements.desktop_version,
+                            requirements.es_version, requirements.web_version),
+          requirements.extensions, requirements.disabled_renderers);
+    }
+  }
+  gm->deferred_groups_.fetch_and(~(static_cast<uint64>(1) << group),
+                                 std::memory_order_release);
+}
+
 void GraphicsManager::InitGlInfo() {
   // glGetIntegerv(GL_MAJOR_VERSION) is (surprisingly) not supported on all
   // platforms (e.g. mac), so we use the GL_VERSION string instead.
@@ -485,48 +1178,18 @@ void GraphicsManager::InitGlInfo() {
   valid_statetable_caps_.reset();
   valid_statetable_caps_.flip();
 
-  // Ensure that extension function groups are really supported.
-  EnableFunctionGroupIfAvailable(kDebugLabel, GlVersions(0U, 0U, 0U),
-                                 "debug_label", "");
-  EnableFunctionGroupIfAvailable(kDebugMarker, GlVersions(0U, 0U, 0U),
-                                 "debug_marker", "");
-  EnableFunctionGroupIfAvailable(kDebugOutput, GlVersions(0U, 0U, 0U),
-                                 "debug_output,debug", "");
-  EnableFunctionGroupIfAvailable(kFramebufferBlit, GlVersions(20U, 30U, 0U),
-                                 "framebuffer_blit", "");
-  EnableFunctionGroupIfAvailable(kFramebufferMultisample,
-                                 GlVersions(20U, 30U, 0U),
-                                 "framebuffer_multisample", "");
-  EnableFunctionGroupIfAvailable(kGpuShader4, GlVersions(30U, 30U, 0U),
-                                 "gpu_shader4", "");
-  EnableFunctionGroupIfAvailable(kEglImage, GlVersions(0U, 0U, 0U), "EGL_image",
-                                 "");
-  EnableFunctionGroupIfAvailable(kGetString, GlVersions(30U, 30U, 0U), "", "");
-  EnableFunctionGroupIfAvailable(kMapBuffer, GlVersions(15U, 30U, 0U),
-                                 "mapbuffer,vertex_buffer_object",
-                                 "Vivante GC1000,VideoCore IV HW");
-  EnableFunctionGroupIfAvailable(kMapBufferRange, GlVersions(30U, 30U, 0U),
-                                 "map_buffer_range",
-                                 "Vivante GC1000,VideoCore IV HW");
-  EnableFunctionGroupIfAvailable(kSamplerObjects, GlVersions(33U, 30U, 0U),
-                                 "sampler_objects", "Mali ,Mali-");
-  EnableFunctionGroupIfAvailable(kTexture3d, GlVersions(13U, 30U, 0U),
-                                 "texture_3d", "");
-  EnableFunctionGroupIfAvailable(kTextureMultisample, GlVersions(32U, 30U, 0U),
-                                 "texture_multisample", "");
-  EnableFunctionGroupIfAvailable(kTextureStorage, GlVersions(42U, 30U, 0U),
-                                 "texture_storage", "");
-  EnableFunctionGroupIfAvailable(kTextureStorageMultisample,
-                                 GlVersions(42U, 30U, 0U),
-                                 "texture_storage_multisample", "");
-  EnableFunctionGroupIfAvailable(kVertexArrays, GlVersions(30U, 30U, 0U),
-                                 "vertex_array_object", "Internet Explorer");
-  EnableFunctionGroupIfAvailable(kInstancedDrawing, GlVersions(33U, 30U, 0U),
-                                 "instanced_drawing", "");
-  EnableFunctionGroupIfAvailable(kSync, GlVersions(32U, 30U, 2U), "sync", "");
-  EnableFunctionGroupIfAvailable(kRaw, GlVersions(0U, 0U, 0U), "", "");
-  EnableFunctionGroupIfAvailable(kTransformFeedback, GlVersions(40U, 30U, 0U),
-                                 "transform_feedback", "");
+  // Ensure that extension function groups are really supported. Deferred
+  // groups are checked when they are resolved.
+  for (const FunctionGroupRequirements& requirements :
+       kFunctionGroupRequirements) {
+    if (!IsFunctionGroupDeferred(requirements.group)) {
+      EnableFunctionGroupIfAvailable(
+          requirements.group,
+          GlVersions(requirements.desktop_version, requirements.es_version,
+                     requirements.web_version),
+          requirements.extensions, requirements.disabled_renderers);
+    }
+  }
 
   if (extensions_.empty() && IsFunctionGroupAvailable(kGetString)) {
     GLint count = 0;
@@ -577,6 +1240,8 @@ void GraphicsManager::ReinitFunctions() {
   for (size_t i = 0; i < num_wrappers; ++i)
     wrappers_[i]->Reset();
   wrapped_function_names_.clear();
+  deferred_groups_.store(0U, std::memory_order_release);
+  shared_info_.reset();
   if (function_groups_.size() > 0) {
     function_groups_.clear();
     function_groups_.resize(kNumFunctionGroupIds);
@@ -591,16 +1256,46 @@ void GraphicsManager::CheckForErrors(const char* when,
   if (func_call.find("GetError") == std::string::npos) {
     GLenum error = this->GetError();
     if (error != GL_NO_ERROR) {
-      if (tracing_ostream_) {
-        *tracing_ostream_ << "*** GL error " << when << " call to "
-                          << func_call << ": " << ErrorString(error) << "\n";
-      }
-      LOG(ERROR) << "*** GL error " << when << " call to "
-                 << func_call << ": " << ErrorString(error) << "\n";
+      std::ostringstream message;
+      message << "*** GL error " << when << " call to " << func_call << ": "
+              << ErrorString(error) << "\n";
+      if (tracing_ostream_)
+        *tracing_ostream_ << message.str();
+      if (binary_trace_.Get())
+        binary_trace_->RecordText(message.str());
+      LOG(ERROR) << message.str();
     }
   }
 }
 
+void GraphicsManager::CheckForBatchErrors(ErrorCheckBatch batch,
+                                          const std::string& label) {
+  const GLenum error = this->GetError();
+  if (error != GL_NO_ERROR) {
+    static const char* kBatchNames[] = { "drawing Shape", "drawing Node",
+                                         "drawing frame" };
+    std::ostringstream message;
+    message << "*** GL error while " << kBatchNames[batch];
+    if (!label.empty())
+      message << " '" << label << "'";
+    message << ": " << ErrorString(error) << "; most recent calls:";
+    const size_t count = recent_call_count_ < kDeferredErrorCallCount
+                             ? recent_call_count_
+                             : kDeferredErrorCallCount;
+    if (count < recent_call_count_)
+      message << " ...";
+    for (size_t i = recent_call_count_ - count; i < recent_call_count_; ++i)
+      message << " " << recent_calls_[i % kDeferredErrorCallCount];
+    message << "\n";
+    if (tracing_ostream_)
+      *tracing_ostream_ << message.str();
+    if (binary_trace_.Get())
+      binary_trace_->RecordText(message.str());
+    LOG(ERROR) << message.str();
+  }
+  recent_call_count_ = 0U;
+}
+
 void* GraphicsManager::Lookup(const char* name, bool is_core) {
   return portgfx::GetGlProcAddress(name, is_core);
 }
@@ -608,15 +1303,15 @@ void* GraphicsManager::Lookup(const char* name, bool is_core) {
 void GraphicsManager::EnableFunctionGroupIfAvailable(
     GraphicsManager::FunctionGroupId group, const GlVersions& versions,
     const std::string& extensions, const std::string& disabled_renderers) {
-  EnableFunctionGroup(group, true);
-  if (IsFunctionGroupAvailable(group)) {
+  SetFunctionGroupEnabled(group, true);
+  if (IsFunctionGroupComplete(group)) {
     const std::vector<std::string> renderers =
         base::SplitString(disabled_renderers, ",");
     const size_t renderer_count = renderers.size();
     // Disable the group if platform's renderer is in the disabled set.
     for (size_t i = 0; i < renderer_count; ++i) {
       if (gl_renderer_.find(renderers[i]) != std::string::npos) {
-        EnableFunctionGroup(group, false);
+        SetFunctionGroupEnabled(group, false);
         return;
       }
     }
@@ -627,7 +1322,7 @@ void GraphicsManager::EnableFunctionGroupIfAvailable(
     // incomplete.
     for (size_t i = 0; i < count; ++i) {
       if (portgfx::IsExtensionIncomplete(names[i].c_str())) {
-        EnableFunctionGroup(group, false);
+        SetFunctionGroupEnabled(group, false);
         return;
       }
     }
@@ -641,7 +1336,7 @@ void GraphicsManager::EnableFunctionGroupIfAvailable(
         return;
     }
   }
-  EnableFunctionGroup(group, false);
+  SetFunctionGroupEnabled(group, false);
 }
 
 }  // namespace gfx
@@ -18,21 +18,27 @@ limitations under the License.
 #ifndef ION_GFX_GRAPHICSMANAGER_H_
 #define ION_GFX_GRAPHICSMANAGER_H_
 
+#include <atomic>
 #include <bitset>
 #include <cstring>
 #include <iostream>  // NOLINT
+#include <map>
 #include <memory>
 #include <sstream>
 #include <string>
 
+#include "base/integral_types.h"
 #include "ion/base/logging.h"
 #include "ion/base/referent.h"
 #include "ion/base/stlalloc/allocset.h"
 #include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/binarytrace.h"
+#include "ion/gfx/framecapture.h"
 #include "ion/gfx/graphicsmanagermacrodefs.h"
 #include "ion/gfx/statetable.h"
 #include "ion/gfx/tracinghelper.h"
 #include "ion/math/range.h"
+#include "ion/port/mutex.h"
 #include "ion/portgfx/glheaders.h"
 
 namespace ion {
@@ -51,6 +57,14 @@ namespace gfx {
 // the thread safety of the OpenGL subsystem.
 // Extension/function/function group/glversion/glapi checks are always
 // thread-safe.
+//
+// To make creating a GraphicsManager cheap, the functions of rarely used
+// function groups (such as kTransformFeedback or kProgramBinary) are only
+// looked up when one of them is first called or their group is first queried.
+// GraphicsManagers created for the same OpenGL driver also share the functions
+// that have been looked up, the OpenGL version and extension information, and
+// the cached capability values, so only the first of them has to query
+// OpenGL for them.
 class ION_API GraphicsManager : public base::Referent {
  public:
   // Information about shader precision, see below.
@@ -92,6 +106,7 @@ class ION_API GraphicsManager : public base::Referent {
     kMaxTransformFeedbackInterleavedComponents,  // int
     kMaxTransformFeedbackSeparateAttribs,        // int
     kMaxTransformFeedbackSeparateComponents,     // int
+    kMaxUniformBufferBindings,                   // int
     kMaxVaryingVectors,                          // int
     kMaxVertexAttribs,                           // int
     kMaxVertexTextureImageUnits,                 // int
@@ -102,6 +117,7 @@ class ION_API GraphicsManager : public base::Referent {
     kTransformFeedbackVaryingMaxLength,          // int
     kMaxDebugLoggedMessages,                     // int
     kMaxDebugMessageLength,                      // int
+    kMaxViews,                                   // int
     // The below are returned as a ShaderPrecision struct. A particular
     // precision is unsupported if the precision range is [0:0].
     kFragmentShaderHighFloatPrecisionFormat,
@@ -121,10 +137,19 @@ class ION_API GraphicsManager : public base::Referent {
 
   enum FunctionGroupId {
     kCore,  // Core OpenGL ES2 functions.
+    // See https://www.opengl.org/registry/specs/ARB/buffer_storage.txt.
+    kBufferStorage,
     kDebugLabel,
     kDebugMarker,
     kDebugOutput,
     kChooseBuffer,
+    // See https://www.opengl.org/registry/specs/ARB/compute_shader.txt.
+    kComputeShader,
+    // See https://www.khronos.org/registry/OpenGL/extensions/NV/
+    // NV_conditional_render.txt.
+    kConditionalRender,
+    // See https://www.opengl.org/registry/specs/ARB/draw_indirect.txt.
+    kDrawIndirect,
     kFramebufferBlit,
     kFramebufferMultisample,
     // This is used for Apple devices running pre-es-3.0 device with the
@@ -132,15 +157,33 @@ class ION_API GraphicsManager : public base::Referent {
     // See https://www.khronos.org/registry/gles/extensions/APPLE/
     // APPLE_framebuffer_multisample.txt.
     kMultisampleFramebufferResolve,
+    // See https://www.khronos.org/registry/OpenGL/extensions/EXT/
+    // EXT_multisampled_render_to_texture.txt.
+    kMultisampledRenderToTexture,
     // This covers both OES_EGL_image and OES_EGL_image_external.
     kEglImage,
     kGetString,
     // See https://www.opengl.org/registry/specs/EXT/gpu_shader4.txt.
     kGpuShader4,
+    // See https://www.opengl.org/registry/specs/ARB/invalidate_subdata.txt.
+    kInvalidateFramebuffer,
     kMapBuffer,
     kMapBufferBase,
     kMapBufferRange,
+    // See https://www.khronos.org/registry/gles/extensions/EXT/
+    // EXT_multi_draw_arrays.txt.
+    kMultiDraw,
+    // See https://www.khronos.org/registry/OpenGL/extensions/OVR/
+    // OVR_multiview.txt.
+    kMultiview,
+    // See https://www.khronos.org/registry/OpenGL/extensions/KHR/
+    // KHR_parallel_shader_compile.txt.
+    kParallelShaderCompile,
     kPointSize,
+    kProgramBinary,
+    // See https://www.opengl.org/registry/specs/ARB/
+    // program_interface_query.txt.
+    kProgramInterfaceQuery,
     kRaw,
     kSamplerObjects,
     kTexture3d,
@@ -150,6 +193,7 @@ class ION_API GraphicsManager : public base::Referent {
     kInstancedDrawing,
     kSync,
     kTransformFeedback,
+    kUniformBufferObjects,
     kVertexArrays,
     kNumFunctionGroupIds,
   };
@@ -169,6 +213,26 @@ class ION_API GraphicsManager : public base::Referent {
     kCoreProfile,
   };
 
+  // Statistics about the OpenGL calls made through a GraphicsManager while
+  // call statistics are enabled. Upload sizes count the bytes of data passed
+  // to the buffer and texture data functions; texture data sizes ignore
+  // unpack row alignment, and data written through mapped buffers is not
+  // counted. Primitives are the points, lines, or triangles drawn, counting
+  // each instance.
+  struct CallStatistics {
+    CallStatistics()
+        : call_count(0U),
+          draw_call_count(0U),
+          primitive_count(0U),
+          buffer_upload_bytes(0U),
+          texture_upload_bytes(0U) {}
+    uint64 call_count;
+    uint64 draw_call_count;
+    uint64 primitive_count;
+    uint64 buffer_upload_bytes;
+    uint64 texture_upload_bytes;
+  };
+
  private:
   class FunctionGroup;
 
@@ -178,27 +242,100 @@ class ION_API GraphicsManager : public base::Referent {
    public:
     WrapperBase(const char* func_name, FunctionGroupId group)
         : ptr_(NULL),
+          gm_(NULL),
           func_name_(func_name),
-          group_(group) {
+          group_(group),
+          call_count_(0U) {
       // Add this to the vector of all known wrappers.
       GraphicsManager::AddWrapper(this);
     }
     const char* GetFuncName() const { return func_name_; }
+    FunctionGroupId GetGroup() const { return group_; }
     bool Init(GraphicsManager* gm) {
+      void* ptr = Lookup(gm);
+      SetPointer(gm, ptr);
+      return ptr != NULL;
+    }
+    // Looks up the function through the passed GraphicsManager.
+    void* Lookup(GraphicsManager* gm) const {
       const std::string gl_name = "gl" + std::string(func_name_);
-      ptr_ = gm->Lookup(gl_name.c_str(), group_ == kCore);
-      // Add the function to its group.
-      gm->AddFunctionToGroup(group_, func_name_, ptr_);
-      return ptr_ != NULL;
+      return gm->Lookup(gl_name.c_str(), group_ == kCore);
+    }
+    // Sets the function pointer and adds the function to its group.
+    void SetPointer(GraphicsManager* gm, void* ptr) {
+      ptr_.store(ptr, std::memory_order_relaxed);
+      gm->AddFunctionToGroup(group_, func_name_, ptr);
+    }
+    // Defers setting the function pointer until the function is first called
+    // or its group is resolved by the passed GraphicsManager.
+    void Defer(GraphicsManager* gm) { gm_ = gm; }
+    void Reset() {
+      ptr_.store(NULL, std::memory_order_relaxed);
+      gm_ = NULL;
     }
-    void Reset() { ptr_ = NULL; }
 
-   protected:
-    void* ptr_;
+    // Counts calls made while call statistics are enabled.
+    void CountCall() { ++call_count_; }
+    uint64 GetCallCount() const { return call_count_; }
+    void ResetCallCount() { call_count_ = 0U; }
+
+    // Returns the function pointer, resolving the function's group first if
+    // it was deferred.
+    void* GetPointer() {
+      void* ptr = ptr_.load(std::memory_order_relaxed);
+      if (!ptr && gm_) {
+        gm_->ResolveFunctionGroup(group_);
+        ptr = ptr_.load(std::memory_order_relaxed);
+      }
+      return ptr;
+    }
+    // Returns the function pointer as it is, which is only valid for functions
+    // that are not deferred.
+    void* GetLoadedPointer() const {
+      return ptr_.load(std::memory_order_relaxed);
+    }
 
    private:
+    std::atomic<void*> ptr_;
+    // The GraphicsManager that resolves the function if it was deferred.
+    GraphicsManager* gm_;
     const char* func_name_;
     FunctionGroupId group_;
+    uint64 call_count_;
+  };
+
+  // Passes the arguments of a call through the function wrapped by Wrapper to
+  // the matching RecordCallDetails() overload. This lets the wrapping macros
+  // record details of a few functions without knowing which ones they are.
+  template <typename Wrapper>
+  struct CallDetailsRecorder {
+    template <typename... Args>
+    void operator()(Args... args) const {
+      gm->RecordCallDetails(static_cast<const Wrapper*>(NULL), args...);
+    }
+    GraphicsManager* gm;
+  };
+
+  // Passes the arguments of a call to a FrameCapture, like
+  // CallDetailsRecorder.
+  struct CallCaptureRecorder {
+    template <typename... Args>
+    void operator()(Args... args) const {
+      capture->RecordCall(name, args...);
+    }
+    FrameCapture* capture;
+    const char* name;
+  };
+
+  // Passes the arguments of a call to a BinaryTrace, like CallDetailsRecorder.
+  struct BinaryTraceRecorder {
+    template <typename... Args>
+    void operator()(Args... args) const {
+      trace->RecordCall(*function, depth, args...);
+    }
+    BinaryTrace* trace;
+    const BinaryTrace::Function* function;
+    size_t depth;
   };
 
  public:
@@ -215,9 +352,7 @@ class ION_API GraphicsManager : public base::Referent {
 
   // Returns true if the named function is available. This is used primarily
   // for testing. Thread-safe.
-  bool IsFunctionAvailable(const std::string& function_name) const {
-    return wrapped_function_names_.count(function_name) > 0;
-  }
+  bool IsFunctionAvailable(const std::string& function_name) const;
 
   // Returns true if the named function group is available. Thread-safe.
   bool IsFunctionGroupAvailable(FunctionGroupId group) const;
@@ -229,11 +364,54 @@ class ION_API GraphicsManager : public base::Referent {
   // does not require a GL context to be bound, and is thread-safe.
   bool IsExtensionSupported(const std::string& name) const;
 
+  // Returns true if textures with the compressed |internal_format| can be
+  // uploaded, based on the GL version and extensions. It returns true for
+  // formats that are not compressed. Thread-safe.
+  bool IsCompressedTextureFormatSupported(GLenum internal_format) const;
+
   // Sets/returns a flag indicating whether glGetError() should be called after
   // every OpenGL call to check for errors. The default is false.
   void EnableErrorChecking(bool enable) { is_error_checking_enabled_ = enable; }
   bool IsErrorCheckingEnabled() const { return is_error_checking_enabled_; }
 
+  // The batches of OpenGL calls after which deferred error checking calls
+  // glGetError(), from the smallest to the largest. Checking per Node also
+  // checks at the end of each frame.
+  enum ErrorCheckBatch {
+    kCheckErrorsPerDraw,
+    kCheckErrorsPerNode,
+    kCheckErrorsPerFrame,
+  };
+  // The number of most recent calls remembered by deferred error checking.
+  static const size_t kDeferredErrorCallCount = 16U;
+
+  // Sets/returns whether glGetError() should only be called once per batch of
+  // OpenGL calls, which avoids most of the round trips to the driver of
+  // EnableErrorChecking(). The names of the calls of the current batch are
+  // recorded in a small ring, and when an error is found it is logged with
+  // the last kDeferredErrorCallCount of them, since any of them may have
+  // caused it. The Renderer ends batches with CheckForDeferredErrors(). The
+  // default is disabled, with a batch of kCheckErrorsPerFrame.
+  void EnableDeferredErrorChecking(bool enable, ErrorCheckBatch batch) {
+    is_deferred_error_checking_enabled_ = enable;
+    deferred_error_check_batch_ = batch;
+    recent_call_count_ = 0U;
+  }
+  bool IsDeferredErrorCheckingEnabled() const {
+    return is_deferred_error_checking_enabled_;
+  }
+  ErrorCheckBatch GetDeferredErrorCheckBatch() const {
+    return deferred_error_check_batch_;
+  }
+  // Ends a batch of OpenGL calls of the passed kind, checking for an error if
+  // deferred error checking is enabled with the same or a smaller batch. The
+  // label of the Shape or Node that was drawn, if any, identifies the batch.
+  void CheckForDeferredErrors(ErrorCheckBatch batch, const std::string& label) {
+    if (is_deferred_error_checking_enabled_ &&
+        batch >= deferred_error_check_batch_)
+      CheckForBatchErrors(batch, label);
+  }
+
   // Sets an output stream to use for tracing OpenGL calls. If the stream is
   // non-NULL, tracing is enabled, and a message is printed to the stream for
   // each OpenGL call. The default is a NULL stream.
@@ -244,6 +422,44 @@ class ION_API GraphicsManager : public base::Referent {
   void SetTracingPrefix(const std::string& s) { tracing_prefix_ = s; }
   const std::string& GetTracingPrefix() const { return tracing_prefix_; }
 
+  // Sets a BinaryTrace that records each traced OpenGL call made through this,
+  // and the errors found when error checking is enabled. This is much cheaper
+  // than a tracing stream, since the calls are only formatted when the trace is
+  // read, and can be used together with one. Passing a NULL pointer stops
+  // recording, which is the default. Recording is disabled in production
+  // builds.
+  void SetBinaryTrace(const BinaryTracePtr& trace) { binary_trace_ = trace; }
+  const BinaryTracePtr& GetBinaryTrace() const { return binary_trace_; }
+
+  // Sets a FrameCapture that records each OpenGL call made through this, except
+  // those that are not traced. Passing a NULL pointer stops capturing, which is
+  // the default. Like tracing, capturing is disabled in production builds.
+  void SetFrameCapture(const FrameCapturePtr& capture) {
+    frame_capture_ = capture;
+  }
+  const FrameCapturePtr& GetFrameCapture() const { return frame_capture_; }
+
+  // Sets/returns whether statistics about OpenGL calls are gathered. Unlike
+  // tracing, this is cheap enough to be left on, including in production
+  // builds. Statistics are kept until ResetCallStatistics() is called,
+  // typically once per frame. The default is false. Production builds with
+  // ION_GFX_DIRECT_GL_CALLS defined do not count calls, so all counts stay 0.
+  void EnableCallStatistics(bool enable) {
+    is_call_statistics_enabled_ = enable;
+  }
+  bool IsCallStatisticsEnabled() const { return is_call_statistics_enabled_; }
+  // Returns the statistics gathered since the last reset. The call count is
+  // computed by summing the counts of all functions.
+  const CallStatistics GetCallStatistics() const;
+  // Returns the number of calls made to the named function, without the "gl"
+  // prefix, since the last reset.
+  uint64 GetFunctionCallCount(const std::string& function_name) const;
+  // Returns the number of calls made to each function that has been called
+  // since the last reset, keyed by function name without the "gl" prefix.
+  const std::map<std::string, uint64> GetFunctionCallCounts() const;
+  // Resets all call statistics to zero.
+  void ResetCallStatistics();
+
   // Returns the GL version as an integer. Thread-safe.
   GLuint GetGlVersion() const { return gl_version_; }
   // Returns the GL version string. Thread-safe.
@@ -263,6 +479,67 @@ class ION_API GraphicsManager : public base::Referent {
 
 #include "ion/gfx/glfunctions.inc"
 
+ private:
+  // Records the details of calls to functions for which call statistics count
+  // more than calls. Calls to other functions are ignored.
+  template <typename Wrapper, typename... Args>
+  void RecordCallDetails(const Wrapper* wrapper, Args... args) {}
+  void RecordCallDetails(const BufferData_Wrapper* wrapper, GLenum target,
+                         GLsizeiptr size, const GLvoid* data, GLenum usage);
+  void RecordCallDetails(const BufferSubData_Wrapper* wrapper, GLenum target,
+                         GLintptr offset, GLsizeiptr size, const GLvoid* data);
+  void RecordCallDetails(const CompressedTexImage2D_Wrapper* wrapper,
+                         GLenum target, GLint level, GLenum internal_format,
+                         GLsizei width, GLsizei height, GLint border,
+                         GLsizei image_size, const GLvoid* data);
+  void RecordCallDetails(const CompressedTexImage3D_Wrapper* wrapper,
+                         GLenum target, GLint level, GLenum internal_format,
+                         GLsizei width, GLsizei height, GLsizei depth,
+                         GLint border, GLsizei image_size, const GLvoid* data);
+  void RecordCallDetails(const CompressedTexSubImage2D_Wrapper* wrapper,
+                         GLenum target, GLint level, GLint xoffset,
+                         GLint yoffset, GLsizei width, GLsizei height,
+                         GLenum format, GLsizei image_size,
+                         const GLvoid* data);
+  void RecordCallDetails(const CompressedTexSubImage3D_Wrapper* wrapper,
+                         GLenum target, GLint level, GLint xoffset,
+                         GLint yoffset, GLint zoffset, GLsizei width,
+                         GLsizei height, GLsizei depth, GLenum format,
+                         GLsizei image_size, const GLvoid* data);
+  void RecordCallDetails(const DrawArrays_Wrapper* wrapper, GLenum mode,
+                         GLint first, GLsizei count);
+  void RecordCallDetails(const DrawArraysInstanced_Wrapper* wrapper,
+                         GLenum mode, GLint first, GLsizei count,
+                         GLsizei instance_count);
+  void RecordCallDetails(const DrawElements_Wrapper* wrapper, GLenum mode,
+                         GLsizei count, GLenum type, const GLvoid* indices);
+  void RecordCallDetails(const DrawElementsInstanced_Wrapper* wrapper,
+                         GLenum mode, GLsizei count, GLenum type,
+                         const GLvoid* indices, GLsizei instance_count);
+  void RecordCallDetails(const MultiDrawArrays_Wrapper* wrapper, GLenum mode,
+                         const GLint* first, const GLsizei* count,
+                         GLsizei draw_count);
+  void RecordCallDetails(const MultiDrawElements_Wrapper* wrapper,
+                         GLenum mode, const GLsizei* count, GLenum type,
+                         const GLvoid* const* indices, GLsizei draw_count);
+  void RecordCallDetails(const TexImage2D_Wrapper* wrapper, GLint target,
+                         GLint level, GLenum internal_format, GLsizei width,
+                         GLsizei height, GLint border, GLenum format,
+                         GLenum type, const GLvoid* pixels);
+  void RecordCallDetails(const TexImage3D_Wrapper* wrapper, GLint target,
+                         GLint level, GLenum internal_format, GLsizei width,
+                         GLsizei height, GLsizei depth, GLint border,
+                         GLenum format, GLenum type, const GLvoid* pixels);
+  void RecordCallDetails(const TexSubImage2D_Wrapper* wrapper, GLenum target,
+                         GLint level, GLint xoffset, GLint yoffset,
+                         GLsizei width, GLsizei height, GLenum format,
+                         GLenum type, const GLvoid* data);
+  void RecordCallDetails(const TexSubImage3D_Wrapper* wrapper, GLenum target,
+                         GLint level, GLint xoffset, GLint yoffset,
+                         GLint zoffset, GLsizei width, GLsizei height,
+                         GLsizei depth, GLenum format, GLenum type,
+                         const GLvoid* data);
+
  public:
   // Returns a terse string description of an OpenGL error code.
   static const char* ErrorString(GLenum error_code);
@@ -325,6 +602,10 @@ class ION_API GraphicsManager : public base::Referent {
   // An internal class that helps track capability values.
   class CapabilityHelper;
 
+  // Function pointers and OpenGL information shared by all GraphicsManagers
+  // created for the same OpenGL driver.
+  struct SharedInfo;
+
   // This nested class is used to check for errors after invoking an OpenGL
   // function. The check is called from the destructor, so instance should be
   // created in the scope in which the OpenGL call is made. It is necessary to
@@ -366,6 +647,43 @@ class ION_API GraphicsManager : public base::Referent {
   // error if any of the necessary functions is not available.
   void InitFunctions();
 
+  // Initializes the functions and OpenGL information like InitFunctions(), but
+  // takes them from the SharedInfo of the current OpenGL driver when another
+  // GraphicsManager has already looked them up, and defers looking up the
+  // functions of rarely used groups.
+  void InitSharedFunctions();
+
+  // Returns a string that identifies the OpenGL driver of the current context,
+  // or an empty string if it cannot be determined. This requires the
+  // GetString(), GetIntegerv() and GetError() wrappers to be initialized.
+  const std::string GetDriverKey();
+
+  // Returns the SharedInfo for the passed driver key, creating it if needed.
+  static std::shared_ptr<SharedInfo> GetSharedInfo(const std::string& key,
+                                                   size_t wrapper_count);
+
+  // Copies the OpenGL information that InitGlInfo() sets to or from
+  // |shared_info_|.
+  // LoadSharedGlInfo() returns false if the information has not been saved.
+  void SaveSharedGlInfo();
+  bool LoadSharedGlInfo();
+
+  // Looks up the functions of a deferred group and enables the group if it is
+  // available. Does nothing if the group is not deferred. Thread-safe.
+  void ResolveFunctionGroup(FunctionGroupId group) const;
+
+  // Returns whether the functions of the passed group have been deferred and
+  // not resolved yet.
+  bool IsFunctionGroupDeferred(FunctionGroupId group) const {
+    return (deferred_groups_.load(std::memory_order_acquire) &
+            (static_cast<uint64>(1) << group)) != 0;
+  }
+
+  // Returns whether the passed group is complete and enabled, or enables or
+  // disables it, without resolving it if it was deferred.
+  bool IsFunctionGroupComplete(FunctionGroupId group) const;
+  void SetFunctionGroupEnabled(FunctionGroupId group, bool enable);
+
   // Adds to the set of wrapped function names.
   void AddWrappedFunctionName(const std::string& function_name) {
     wrapped_function_names_.insert(function_name);
@@ -374,6 +692,15 @@ class ION_API GraphicsManager : public base::Referent {
   // Calls glGetError() to check for errors, logging a message if one is found.
   void CheckForErrors(const char* when, const std::string& func_call);
 
+  // Remembers a call for deferred error checking.
+  void RecordDeferredErrorCall(const char* func_name) {
+    recent_calls_[recent_call_count_ % kDeferredErrorCallCount] = func_name;
+    ++recent_call_count_;
+  }
+  // Calls glGetError() at the end of a batch, logging a message with the
+  // recent calls if an error is found, and starts a new batch.
+  void CheckForBatchErrors(ErrorCheckBatch batch, const std::string& label);
+
   // Looks up a function by name and whether the function is core. Returns NULL
   // if not found. This is virtual so it can be redefined in
   // MockGraphicsManager.
@@ -386,8 +713,18 @@ class ION_API GraphicsManager : public base::Referent {
   // Map of groups of OpenGL functions.
   FunctionGroupVector function_groups_;
 
-  // Helper class for tracking capability values.
-  std::unique_ptr<CapabilityHelper> capability_helper_;
+  // Helper class for tracking capability values. This is shared with other
+  // GraphicsManagers for the same OpenGL driver.
+  std::shared_ptr<CapabilityHelper> capability_helper_;
+
+  // The information shared with other GraphicsManagers for the same OpenGL
+  // driver, or NULL if nothing is shared.
+  std::shared_ptr<SharedInfo> shared_info_;
+
+  // A bit for each function group whose functions have not been looked up
+  // yet. Resolving the groups is protected by |deferred_mutex_|.
+  std::atomic<uint64> deferred_groups_;
+  mutable port::Mutex deferred_mutex_;
 
   // Maintains a set of the names of functions that are wrapped by the manager,
   // primarily for testing.
@@ -399,12 +736,30 @@ class ION_API GraphicsManager : public base::Referent {
   // Set to true when checking for errors after all OpenGL calls.
   bool is_error_checking_enabled_;
 
+  // Deferred error checking state. The names of the calls of the current
+  // batch are stored in a ring indexed by the number of calls recorded.
+  bool is_deferred_error_checking_enabled_;
+  ErrorCheckBatch deferred_error_check_batch_;
+  const char* recent_calls_[kDeferredErrorCallCount];
+  size_t recent_call_count_;
+
   // Output stream for tracing. NULL when tracing is disabled.
   std::ostream* tracing_ostream_;
 
+  // Set to true when gathering call statistics. The per-function counts are
+  // kept in the wrappers.
+  bool is_call_statistics_enabled_;
+  CallStatistics call_statistics_;
+
   // A prefix that is printed out in front of all tracing messages.
   std::string tracing_prefix_;
 
+  // Records calls when it is non-NULL.
+  FrameCapturePtr frame_capture_;
+
+  // Records calls for tracing when it is non-NULL.
+  BinaryTracePtr binary_trace_;
+
   // Helper for printing values when tracing.
   TracingHelper tracing_helper_;
 
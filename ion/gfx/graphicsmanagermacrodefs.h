@@ -28,12 +28,22 @@ limitations under the License.
 #  define ION_PROFILE_GL_FUNC(name)
 #endif
 
+// Updates the call statistics for a call to the wrapped function if they are
+// enabled. This is cheap enough to be left in production builds.
+#define ION_COUNT_GL_FUNC(name, args)                                   \
+  if (is_call_statistics_enabled_) {                                    \
+    name##_wrapper_.CountCall();                                        \
+    const CallDetailsRecorder<name##_Wrapper> recorder = { this };      \
+    recorder args;                                                      \
+  }
+
 #define ION_WRAP_NON_PROD_GL_FUNC(name, return_type, typed_args, args, trace) \
  public:                                                                      \
   /* Invokes the wrapped function. */                                         \
   return_type name typed_args {                                               \
     ION_PROFILE_GL_FUNC(name);                                                \
     DCHECK(name##_wrapper_.Get());                                            \
+    ION_COUNT_GL_FUNC(name, args);                                            \
     /* Don't trace calls to glGetError(). */                                  \
     static const bool do_trace = strcmp(#name, "GetError") &&                 \
                                  strcmp(#name, "PushGroupMarker") &&          \
@@ -42,6 +52,19 @@ limitations under the License.
       *tracing_ostream_ << tracing_prefix_ << name##_wrapper_.GetFuncName()   \
                         << "(" << trace << ")\n";                             \
     }                                                                         \
+    if (binary_trace_.Get() && do_trace) {                                    \
+      static const BinaryTrace::Function function(#name, #typed_args);        \
+      const BinaryTraceRecorder recorder = {                                  \
+          binary_trace_.Get(), &function, tracing_prefix_.length() };         \
+      recorder args;                                                          \
+    }                                                                         \
+    if (frame_capture_.Get() && do_trace) {                                   \
+      const CallCaptureRecorder recorder = {                                  \
+          frame_capture_.Get(), name##_wrapper_.GetFuncName() };              \
+      recorder args;                                                          \
+    }                                                                         \
+    if (is_deferred_error_checking_enabled_ && do_trace)                      \
+      RecordDeferredErrorCall(name##_wrapper_.GetFuncName());                 \
     if (is_error_checking_enabled_) {                                         \
       /* See ErrorChecker class doc for why it is needed here. */             \
       std::ostringstream call;                                                \
@@ -61,9 +84,23 @@ limitations under the License.
   /* Invokes the wrapped function. */                                     \
   return_type name typed_args {                                           \
     ION_PROFILE_GL_FUNC(name);                                            \
+    ION_COUNT_GL_FUNC(name, args);                                        \
+    if (is_deferred_error_checking_enabled_)                              \
+      RecordDeferredErrorCall(name ## _wrapper_.GetFuncName());           \
     return (*name ## _wrapper_.Get())args;                                \
   }
 
+// With ION_GFX_DIRECT_GL_CALLS, production builds call the function pointer
+// directly, without counting calls or checking whether the function was
+// deferred; see GraphicsManager::EnableCallStatistics().
+#define ION_WRAP_DIRECT_GL_FUNC(name, return_type, typed_args, args, trace) \
+ public:                                                                    \
+  /* Invokes the wrapped function. */                                       \
+  return_type name typed_args {                                             \
+    ION_PROFILE_GL_FUNC(name);                                              \
+    return (*name ## _wrapper_.GetDirect())args;                            \
+  }
+
 #define ION_DECLARE_GL_WRAPPER(group, name, return_type, typed_args, args) \
  private:                                                                  \
   /* Typedef for a pointer to the function. */                             \
@@ -73,13 +110,22 @@ limitations under the License.
   class name ## _Wrapper : public WrapperBase {                            \
    public:                                                                 \
     name ## _Wrapper() : WrapperBase(#name, k ## group) {}                 \
-    name ## _Type Get() { return reinterpret_cast<name ## _Type>(ptr_); }  \
+    name ## _Type Get() {                                                  \
+      return reinterpret_cast<name ## _Type>(GetPointer());                \
+    }                                                                      \
+    name ## _Type GetDirect() const {                                      \
+      return reinterpret_cast<name ## _Type>(GetLoadedPointer());          \
+    }                                                                      \
   };                                                                       \
                                                                            \
   /* Instance of the wrapper class. */                                     \
   name ## _Wrapper name ## _wrapper_
 
-#if ION_PRODUCTION
+#if ION_PRODUCTION && defined(ION_GFX_DIRECT_GL_CALLS)
+#define ION_WRAP_GL_FUNC(group, name, return_type, typed_args, args, trace) \
+  ION_WRAP_DIRECT_GL_FUNC(name, return_type, typed_args, args, trace)       \
+  ION_DECLARE_GL_WRAPPER(group, name, return_type, typed_args, args)
+#elif ION_PRODUCTION
 #define ION_WRAP_GL_FUNC(group, name, return_type, typed_args, args, trace) \
   ION_WRAP_PROD_GL_FUNC(name, return_type, typed_args, args, trace)         \
   ION_DECLARE_GL_WRAPPER(group, name, return_type, typed_args, args)
@@ -18,6 +18,7 @@ limitations under the License.
 #ifndef ION_GFX_GRAPHICSMANAGERMACROUNDEFS_H_
 #define ION_GFX_GRAPHICSMANAGERMACROUNDEFS_H_
 
+#undef ION_COUNT_GL_FUNC
 #undef ION_DECLARE_GL_WRAPPER
 #undef ION_PROFILE_GL_FUNC
 #undef ION_WRAP_PROD_GL_FUNC
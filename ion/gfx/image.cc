@@ -190,6 +190,45 @@ const Image::PixelFormat& Image::GetPixelFormat(Format format) {
       /* kPvrtc1Rgba4             */ {GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG,
                                       GL_RGBA,
                                       GL_UNSIGNED_BYTE},
+      /* kEtc2Rgb                 */ {GL_COMPRESSED_RGB8_ETC2, GL_RGB,
+                                      GL_UNSIGNED_BYTE},
+      /* kEtc2Rgba1               */ {
+          GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, GL_RGBA,
+          GL_UNSIGNED_BYTE},
+      /* kEtc2Rgba                */ {GL_COMPRESSED_RGBA8_ETC2_EAC, GL_RGBA,
+                                      GL_UNSIGNED_BYTE},
+      /* kEacR11                  */ {GL_COMPRESSED_R11_EAC, GL_RED,
+                                      GL_UNSIGNED_BYTE},
+      /* kEacRg11                 */ {GL_COMPRESSED_RG11_EAC, GL_RG,
+                                      GL_UNSIGNED_BYTE},
+      /* kAstc4x4Rgba             */ {GL_COMPRESSED_RGBA_ASTC_4x4_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc5x4Rgba             */ {GL_COMPRESSED_RGBA_ASTC_5x4_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc5x5Rgba             */ {GL_COMPRESSED_RGBA_ASTC_5x5_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc6x5Rgba             */ {GL_COMPRESSED_RGBA_ASTC_6x5_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc6x6Rgba             */ {GL_COMPRESSED_RGBA_ASTC_6x6_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc8x5Rgba             */ {GL_COMPRESSED_RGBA_ASTC_8x5_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc8x6Rgba             */ {GL_COMPRESSED_RGBA_ASTC_8x6_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc8x8Rgba             */ {GL_COMPRESSED_RGBA_ASTC_8x8_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc10x5Rgba            */ {GL_COMPRESSED_RGBA_ASTC_10x5_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc10x6Rgba            */ {GL_COMPRESSED_RGBA_ASTC_10x6_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc10x8Rgba            */ {GL_COMPRESSED_RGBA_ASTC_10x8_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc10x10Rgba           */ {GL_COMPRESSED_RGBA_ASTC_10x10_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc12x10Rgba           */ {GL_COMPRESSED_RGBA_ASTC_12x10_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
+      /* kAstc12x12Rgba           */ {GL_COMPRESSED_RGBA_ASTC_12x12_KHR,
+                                      GL_RGBA, GL_UNSIGNED_BYTE},
       /* kSrgb8                   */ {GL_SRGB8, GL_RGB, GL_UNSIGNED_BYTE},
       /* kSrgba8                  */ {GL_SRGB8_ALPHA8, GL_RGBA,
                                       GL_UNSIGNED_BYTE},
@@ -291,6 +330,25 @@ const char* Image::GetFormatString(Format format) {
       "Pvrtc1Rgb4",
       "Pvrtc1Rgba2",
       "Pvrtc1Rgba4",
+      "Etc2Rgb",
+      "Etc2Rgba1",
+      "Etc2Rgba",
+      "EacR11",
+      "EacRg11",
+      "Astc4x4Rgba",
+      "Astc5x4Rgba",
+      "Astc5x5Rgba",
+      "Astc6x5Rgba",
+      "Astc6x6Rgba",
+      "Astc8x5Rgba",
+      "Astc8x6Rgba",
+      "Astc8x8Rgba",
+      "Astc10x5Rgba",
+      "Astc10x6Rgba",
+      "Astc10x8Rgba",
+      "Astc10x10Rgba",
+      "Astc12x10Rgba",
+      "Astc12x12Rgba",
       "Srgb8",
       "Srgba8",
       "Rgb11f_11f_10f_Rev",
@@ -333,6 +391,7 @@ int Image::GetNumComponentsForFormat(Format format) {
     case kR32f:
     case kR32i:
     case kR32ui:
+    case kEacR11:
       return 1;
 
     case kRenderbufferDepth24Stencil8:
@@ -349,12 +408,14 @@ int Image::GetNumComponentsForFormat(Format format) {
     case kRg32f:
     case kRg32i:
     case kRg32ui:
+    case kEacRg11:
       return 2;
 
     case kDxt1:
     case kEtc1:
     case kPvrtc1Rgb2:
     case kPvrtc1Rgb4:
+    case kEtc2Rgb:
     case kRgb565:
     case kRgb888:
     case kRgb8:
@@ -383,6 +444,22 @@ int Image::GetNumComponentsForFormat(Format format) {
     case kDxt5:
     case kPvrtc1Rgba2:
     case kPvrtc1Rgba4:
+    case kEtc2Rgba1:
+    case kEtc2Rgba:
+    case kAstc4x4Rgba:
+    case kAstc5x4Rgba:
+    case kAstc5x5Rgba:
+    case kAstc6x5Rgba:
+    case kAstc6x6Rgba:
+    case kAstc8x5Rgba:
+    case kAstc8x6Rgba:
+    case kAstc8x8Rgba:
+    case kAstc10x5Rgba:
+    case kAstc10x6Rgba:
+    case kAstc10x8Rgba:
+    case kAstc10x10Rgba:
+    case kAstc12x10Rgba:
+    case kAstc12x12Rgba:
     case kRgb10a2:
     case kRgb10a2ui:
     case kRgba4444:
@@ -432,13 +509,43 @@ size_t Image::ComputeDataSize(Format format, uint32 width, uint32 height) {
     case kDxt1:
     case kDxt1Rgba:
     case kEtc1:
+    case kEtc2Rgb:
+    case kEtc2Rgba1:
+    case kEacR11:
       // Each 4x4 block of pixels requires 8 bytes.
       return 8 * ((width + 3) / 4) * ((height + 3) / 4);
 
     case kDxt5:
+    case kEtc2Rgba:
+    case kEacRg11:
       // Each 4x4 block of pixels requires 16 bytes.
       return 16 * ((width + 3) / 4) * ((height + 3) / 4);
 
+    case kAstc4x4Rgba:
+    case kAstc5x4Rgba:
+    case kAstc5x5Rgba:
+    case kAstc6x5Rgba:
+    case kAstc6x6Rgba:
+    case kAstc8x5Rgba:
+    case kAstc8x6Rgba:
+    case kAstc8x8Rgba:
+    case kAstc10x5Rgba:
+    case kAstc10x6Rgba:
+    case kAstc10x8Rgba:
+    case kAstc10x10Rgba:
+    case kAstc12x10Rgba:
+    case kAstc12x12Rgba:
+    {
+      // Each block of pixels requires 16 bytes, whatever its size. The block
+      // sizes are ordered like the formats.
+      static const uint32 kAstcBlockSizes[][2] = {
+          {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+          {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+      const uint32* block = kAstcBlockSizes[format - kAstc4x4Rgba];
+      return 16 * ((width + block[0] - 1) / block[0]) *
+             ((height + block[1] - 1) / block[1]);
+    }
+
     case kRenderbufferDepth16:
     case kTextureDepth16Int:
     case kTextureDepth16Short:
@@ -130,6 +130,28 @@ class ION_API Image : public base::Notifier {
                         //   alpha).
     kPvrtc1Rgba4,       // PVRTC1-compressed image (4 bits per pixel, with
                         //   alpha).
+    kEtc2Rgb,           // ETC2-compressed image (no alpha).
+    kEtc2Rgba1,         // ETC2-compressed image (1 bit alpha).
+    kEtc2Rgba,          // ETC2-compressed image with EAC alpha.
+    kEacR11,            // EAC-compressed image, 11-bits red.
+    kEacRg11,           // EAC-compressed image, 11-bits red and green.
+    kAstc4x4Rgba,       // ASTC-compressed image (4x4 blocks, 8 bits per
+                        //   pixel, with alpha).
+    kAstc5x4Rgba,       // ASTC-compressed image (5x4 blocks, with alpha).
+    kAstc5x5Rgba,       // ASTC-compressed image (5x5 blocks, with alpha).
+    kAstc6x5Rgba,       // ASTC-compressed image (6x5 blocks, with alpha).
+    kAstc6x6Rgba,       // ASTC-compressed image (6x6 blocks, with alpha).
+    kAstc8x5Rgba,       // ASTC-compressed image (8x5 blocks, with alpha).
+    kAstc8x6Rgba,       // ASTC-compressed image (8x6 blocks, with alpha).
+    kAstc8x8Rgba,       // ASTC-compressed image (8x8 blocks, 2 bits per
+                        //   pixel, with alpha).
+    kAstc10x5Rgba,      // ASTC-compressed image (10x5 blocks, with alpha).
+    kAstc10x6Rgba,      // ASTC-compressed image (10x6 blocks, with alpha).
+    kAstc10x8Rgba,      // ASTC-compressed image (10x8 blocks, with alpha).
+    kAstc10x10Rgba,     // ASTC-compressed image (10x10 blocks, with alpha).
+    kAstc12x10Rgba,     // ASTC-compressed image (12x10 blocks, with alpha).
+    kAstc12x12Rgba,     // ASTC-compressed image (12x12 blocks, 0.89 bits per
+                        //   pixel, with alpha).
 
     // SRGB(A) images.
     kSrgb8,             // Float image, 8-bits each component.
@@ -295,9 +317,8 @@ class ION_API Image : public base::Notifier {
 };
 
 inline bool Image::IsCompressedFormat(Image::Format format) {
-  return format == kDxt1 || format == kDxt1Rgba || format == kDxt5 ||
-         format == kEtc1 || format == kPvrtc1Rgb2 || format == kPvrtc1Rgb4 ||
-         format == kPvrtc1Rgba2 || format == kPvrtc1Rgba4;
+  // The compressed formats are contiguous.
+  return format >= kDxt1 && format <= kAstc12x12Rgba;
 }
 
 inline bool Image::Is8BitPerChannelFormat(Image::Format format) {
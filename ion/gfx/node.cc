@@ -24,10 +24,119 @@ Node::Node()
     : UniformHolder(GetAllocator()),
       shapes_(*this),
       children_(*this),
-      uniform_blocks_(*this) {}
+      uniform_blocks_(*this),
+      is_draw_order_preserved_(false),
+      render_pass_(kInheritedPass),
+      has_bounds_(false),
+      has_lod_range_(false),
+      subgraph_bounds_state_(kSubgraphBoundsUnknown) {}
 
 Node::~Node() {
 }
 
+size_t Node::AddChild(const NodePtr& child) {
+  size_t index = base::kInvalidIndex;
+  if (child.Get()) {
+    index = children_.size();
+    children_.push_back(child);
+    child->AddReceiver(this);
+    Notify();
+  }
+  return index;
+}
+
+void Node::ReplaceChild(size_t index, const NodePtr& child) {
+  if (index < children_.size() && child.Get()) {
+    NodePtr old_child = children_[index];
+    children_[index] = child;
+    child->AddReceiver(this);
+    RemoveChildReceiver(old_child.Get());
+    Notify();
+  }
+}
+
+void Node::RemoveChild(const NodePtr& child) {
+  bool removed = false;
+  for (auto it = children_.begin(); it != children_.end();) {
+    if (*it == child) {
+      it = children_.erase(it);
+      removed = true;
+    } else {
+      ++it;
+    }
+  }
+  if (removed) {
+    child->RemoveReceiver(this);
+    Notify();
+  }
+}
+
+void Node::RemoveChildAt(size_t index) {
+  if (index < children_.size()) {
+    NodePtr old_child = children_[index];
+    auto it = children_.begin() + index;
+    children_.erase(it);
+    RemoveChildReceiver(old_child.Get());
+    Notify();
+  }
+}
+
+void Node::ClearChildren() {
+  const size_t num_children = children_.size();
+  for (size_t i = 0; i < num_children; ++i)
+    children_[i]->RemoveReceiver(this);
+  children_.clear();
+  Notify();
+}
+
+bool Node::GetSubgraphBounds(math::Range3f* bounds) const {
+  if (subgraph_bounds_state_ == kSubgraphBoundsUnknown) {
+    subgraph_bounds_.MakeEmpty();
+    bool is_bounded = has_bounds_ || shapes_.empty();
+    if (has_bounds_)
+      subgraph_bounds_.ExtendByRange(bounds_);
+    const size_t num_children = children_.size();
+    math::Range3f child_bounds;
+    // Visit all children even once the subgraph is known to be unbounded, so
+    // that their results are cached as well.
+    for (size_t i = 0; i < num_children; ++i) {
+      if (children_[i]->IsEnabled()) {
+        if (children_[i]->GetSubgraphBounds(&child_bounds))
+          subgraph_bounds_.ExtendByRange(child_bounds);
+        else
+          is_bounded = false;
+      }
+    }
+    subgraph_bounds_state_ =
+        is_bounded ? kSubgraphBounded : kSubgraphUnbounded;
+  }
+  if (subgraph_bounds_state_ != kSubgraphBounded)
+    return false;
+  *bounds = subgraph_bounds_;
+  return true;
+}
+
+void Node::Notify() const {
+  subgraph_bounds_state_ = kSubgraphBoundsUnknown;
+  base::Notifier::Notify();
+}
+
+void Node::OnNotify(const base::Notifier* notifier) {
+  Notify();
+}
+
+void Node::OnEnabledChanged() {
+  Notify();
+}
+
+void Node::RemoveChildReceiver(Node* child) {
+  const size_t num_children = children_.size();
+  for (size_t i = 0; i < num_children; ++i) {
+    if (children_[i].Get() == child)
+      return;
+  }
+  child->RemoveReceiver(this);
+}
+
 }  // namespace gfx
 }  // namespace ion
@@ -19,12 +19,14 @@ limitations under the License.
 #define ION_GFX_NODE_H_
 
 #include "ion/base/invalid.h"
-#include "ion/base/referent.h"
+#include "ion/base/notifier.h"
 #include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/query.h"
 #include "ion/gfx/shaderprogram.h"
 #include "ion/gfx/shape.h"
 #include "ion/gfx/statetable.h"
 #include "ion/gfx/uniformblock.h"
+#include "ion/math/range.h"
 
 namespace ion {
 namespace gfx {
@@ -42,8 +44,31 @@ typedef base::ReferentPtr<Node>::Type NodePtr;
 //   - UniformBlocks containing Uniforms. These are sent _after_ the uniforms
 //     above.
 //   - Child nodes.
-class ION_API Node : public base::Referent, public UniformHolder {
+//
+// A Node is a Notifier that notifies its receivers whenever the structure of
+// its subgraph changes, i.e., when children, Shapes, UniformBlocks, the
+// StateTable, or the shader program of it or any of its descendants are
+// added, removed, or replaced, when one of them is enabled or disabled, or when
+// their bounds or render passes change. Changes to the values of Uniforms,
+// Shapes, or StateTables do not cause notifications.
+class ION_API Node : public base::Notifier, public UniformHolder {
  public:
+  // Containers for the Shapes, children, and UniformBlocks of a Node. Most
+  // Nodes have at most one of each, so the first element is stored inline in
+  // the Node instead of in a separate allocation.
+  typedef base::InlinedAllocVector<ShapePtr, 1> ShapeVector;
+  typedef base::InlinedAllocVector<NodePtr, 1> NodeVector;
+  typedef base::InlinedAllocVector<UniformBlockPtr, 1> UniformBlockVector;
+
+  // The passes that a Renderer with the kSortDrawsByRenderPass flag draws
+  // Shapes in; see SetRenderPass().
+  enum RenderPass {
+    kInheritedPass,    // The pass of the parent Node.
+    kOpaquePass,       // Drawn front to back, optionally after a prepass.
+    kTransparentPass,  // Drawn back to front after the opaque pass.
+    kOverlayPass,      // Drawn last, e.g., for user interfaces.
+  };
+
   Node();
 
   // Returns/sets the label of this.
@@ -53,27 +78,138 @@ class ION_API Node : public base::Referent, public UniformHolder {
   // StateTable management.
   void SetStateTable(const StateTablePtr& state_table) {
     state_table_ = state_table;
+    Notify();
   }
   const StateTablePtr& GetStateTable() const { return state_table_; }
 
   // Shader program management.
   void SetShaderProgram(const ShaderProgramPtr& shader_program) {
     shader_program_ = shader_program;
+    Notify();
   }
   const ShaderProgramPtr& GetShaderProgram() const { return shader_program_; }
 
+  // Returns/sets whether the Shapes in this Node's subtree must be drawn in
+  // tree order. This only has an effect when the Renderer's kSortDrawsByState
+  // flag is set, in which case the subtree's draws are not reordered and are
+  // emitted after all sortable draws. This is useful, for example, for
+  // transparent geometry. The default is false.
+  void SetDrawOrderPreserved(bool preserved) {
+    if (preserved != is_draw_order_preserved_) {
+      is_draw_order_preserved_ = preserved;
+      Notify();
+    }
+  }
+  bool IsDrawOrderPreserved() const { return is_draw_order_preserved_; }
+
+  // Returns/sets the render pass that the Shapes in this Node's subtree are
+  // drawn in, unless a descendant sets another one. This only has an effect
+  // when the Renderer's kSortDrawsByRenderPass flag is set; see that flag for
+  // how each pass is ordered. Shapes whose Nodes all inherit their pass are
+  // drawn before any pass. The default is kInheritedPass.
+  void SetRenderPass(RenderPass pass) {
+    if (pass != render_pass_) {
+      render_pass_ = pass;
+      Notify();
+    }
+  }
+  RenderPass GetRenderPass() const { return render_pass_; }
+
+  // Returns/sets the bounds of this Node's own Shapes, which a Renderer uses to
+  // cull Nodes outside of its view (see Renderer::SetCullingMatrix()). Bounds
+  // are in the scene's coordinate system; since Nodes have no transforms, this
+  // is the same for all Nodes. A Node has no bounds until they are set.
+  void SetBounds(const math::Range3f& bounds) {
+    bounds_ = bounds;
+    has_bounds_ = true;
+    Notify();
+  }
+  void ClearBounds() {
+    if (has_bounds_) {
+      bounds_.MakeEmpty();
+      has_bounds_ = false;
+      Notify();
+    }
+  }
+  bool HasBounds() const { return has_bounds_; }
+  const math::Range3f& GetBounds() const { return bounds_; }
+
+  // Returns/sets the range of projected sizes for which this Node and its
+  // subgraph are drawn, which selects between Nodes holding different levels
+  // of detail of the same object. The projected size is that of the Node's
+  // subgraph bounds (see GetSubgraphBounds()) after transformation by the
+  // Renderer's culling matrix (see Renderer::SetCullingMatrix()): the larger
+  // of the width and height of the screen rectangle enclosing them, as a
+  // fraction of the view, so that 1 fills it. The Node is drawn if the size
+  // is at least the minimum and less than the maximum of the range. The size
+  // is infinite for subgraphs without bounds, for bounds reaching behind the
+  // eye, and while the Renderer has no culling matrix, so that only Nodes whose
+  // range has an infinite maximum are drawn then. Until a range is
+  // set, the Node is drawn at any size.
+  void SetLodRange(const math::Range1f& range) {
+    lod_range_ = range;
+    has_lod_range_ = true;
+    Notify();
+  }
+  void ClearLodRange() {
+    if (has_lod_range_) {
+      has_lod_range_ = false;
+      Notify();
+    }
+  }
+  bool HasLodRange() const { return has_lod_range_; }
+  const math::Range1f& GetLodRange() const { return lod_range_; }
+
+  // Sets/returns a Query counting samples, typically of type
+  // Query::kAnySamplesPassed, that a Renderer uses for coarse occlusion
+  // culling of this Node and its subgraph, and a proxy Node that is drawn in
+  // their place while they are hidden. The Renderer measures each draw of the
+  // Node with the query, unless its previous result is still pending. When a
+  // result finds that nothing was visible, the proxy is drawn and measured
+  // instead, until a later result finds it visible again. The proxy is
+  // typically a bounding box drawn with color and depth writes disabled, so
+  // that it is cheap to test. Without a proxy, the Node is always drawn and
+  // the query only measures it. Since results arrive a frame or more late,
+  // objects may appear a little late when they become visible.
+  //
+  // Queries of the same type cannot be nested, so the query of a Node in the
+  // subgraph of another Node being measured is not used. Occlusion queries
+  // only apply when Shapes are drawn in tree order, i.e., without the
+  // Renderer's kSortDrawsByState, kSortDrawsByRenderPass, or kRetainDrawList
+  // flags.
+  void SetOcclusionQuery(const QueryPtr& query, const NodePtr& proxy) {
+    occlusion_query_ = query;
+    occlusion_proxy_ = proxy;
+    Notify();
+  }
+  const QueryPtr& GetOcclusionQuery() const { return occlusion_query_; }
+  const NodePtr& GetOcclusionProxy() const { return occlusion_proxy_; }
+
+  // Returns whether every enabled Node with Shapes in the subgraph rooted at
+  // this Node has bounds, and if so sets |bounds| to their union. The result
+  // is computed lazily and cached until the subgraph changes. Note that
+  // computing it is not thread-safe.
+  bool GetSubgraphBounds(math::Range3f* bounds) const;
+
   // UniformBlock management. NULL blocks are not added, and
   // ReplaceUniformBlock() does nothing if the index is invalid.
   void AddUniformBlock(const UniformBlockPtr& block) {
-    if (block.Get())
+    if (block.Get()) {
       uniform_blocks_.push_back(block);
+      Notify();
+    }
   }
   void ReplaceUniformBlock(size_t index, const UniformBlockPtr& block) {
-    if (index < uniform_blocks_.size() && block.Get())
+    if (index < uniform_blocks_.size() && block.Get()) {
       uniform_blocks_[index] = block;
+      Notify();
+    }
+  }
+  void ClearUniformBlocks() {
+    uniform_blocks_.clear();
+    Notify();
   }
-  void ClearUniformBlocks() { uniform_blocks_.clear(); }
-  const base::AllocVector<UniformBlockPtr>& GetUniformBlocks() const {
+  const UniformBlockVector& GetUniformBlocks() const {
     return uniform_blocks_;
   }
 
@@ -87,12 +223,15 @@ class ION_API Node : public base::Referent, public UniformHolder {
     if (shape.Get()) {
       index = shapes_.size();
       shapes_.push_back(shape);
+      Notify();
     }
     return index;
   }
   void ReplaceShape(size_t index, const ShapePtr& shape) {
-    if (index < shapes_.size() && shape.Get())
+    if (index < shapes_.size() && shape.Get()) {
       shapes_[index] = shape;
+      Notify();
+    }
   }
   // Removes all instances of the shape if it is contained in this' shapes. Note
   // that this is not an efficient operation if this contains many Shapes.
@@ -103,6 +242,7 @@ class ION_API Node : public base::Referent, public UniformHolder {
       else
         ++it;
     }
+    Notify();
   }
   // Removes the Shape at the passed index if the index is valid. Note that this
   // is not an efficient operation if this contains many Shapes.
@@ -110,60 +250,80 @@ class ION_API Node : public base::Referent, public UniformHolder {
     if (index < shapes_.size()) {
       auto it = shapes_.begin() + index;
       shapes_.erase(it);
+      Notify();
     }
   }
-  void ClearShapes() { shapes_.clear(); }
-  const base::AllocVector<ShapePtr>& GetShapes() const { return shapes_; }
+  void ClearShapes() {
+    shapes_.clear();
+    Notify();
+  }
+  const ShapeVector& GetShapes() const { return shapes_; }
 
   // Child node management.  NULL children are not added, and ReplaceChild()
   // does nothing if the index is invalid. AddChild() returns the index of the
   // child added, or base::kInvalidIndex if the child is NULL. Note that the
   // index may change after a call to RemoveChild[At]().
-  size_t AddChild(const NodePtr& child) {
-    size_t index = base::kInvalidIndex;
-    if (child.Get()) {
-      index = children_.size();
-      children_.push_back(child);
-    }
-    return index;
-  }
-  void ReplaceChild(size_t index, const NodePtr& child) {
-    if (index < children_.size() && child.Get())
-      children_[index] = child;
-  }
+  size_t AddChild(const NodePtr& child);
+  void ReplaceChild(size_t index, const NodePtr& child);
   // Removes all instances of child from this' children if it is actually a
   // child of this. Note that this is not an efficient operation if there are
   // many children.
-  void RemoveChild(const NodePtr& child) {
-    for (auto it = children_.begin(); it != children_.end();) {
-      if (*it == child)
-        it = children_.erase(it);
-      else
-        ++it;
-    }
-  }
+  void RemoveChild(const NodePtr& child);
   // Removes the child Node at the passed index if the index is valid. Note that
   // this is not an efficient operation if there are many children.
-  void RemoveChildAt(size_t index) {
-    if (index < children_.size()) {
-      auto it = children_.begin() + index;
-      children_.erase(it);
-    }
-  }
-  void ClearChildren() { children_.clear(); }
-  const base::AllocVector<NodePtr>& GetChildren() const { return children_; }
+  void RemoveChildAt(size_t index);
+  void ClearChildren();
+  const NodeVector& GetChildren() const { return children_; }
 
  protected:
   // The destructor is protected because all base::Referent classes must have
   // protected or private destructors.
   ~Node() override;
 
+  // Forwards notifications from children to this' receivers.
+  void OnNotify(const base::Notifier* notifier) override;
+
+  // Notifies receivers when the Node is enabled or disabled with
+  // UniformHolder::Enable(). Disabled Nodes and their subgraphs are skipped
+  // during rendering.
+  void OnEnabledChanged() override;
+
  private:
+  // Stops receiving notifications from the passed child if it is no longer
+  // one of this' children.
+  void RemoveChildReceiver(Node* child);
+  // Invalidates the cached subgraph bounds before notifying receivers. This
+  // hides base::Notifier::Notify().
+  void Notify() const;
+
+  // The state of the cached subgraph bounds.
+  enum SubgraphBoundsState {
+    kSubgraphBoundsUnknown,
+    kSubgraphBounded,
+    kSubgraphUnbounded,
+  };
+
   StateTablePtr state_table_;
   ShaderProgramPtr shader_program_;
-  base::AllocVector<ShapePtr> shapes_;
-  base::AllocVector<NodePtr> children_;
-  base::AllocVector<UniformBlockPtr> uniform_blocks_;
+  ShapeVector shapes_;
+  NodeVector children_;
+  UniformBlockVector uniform_blocks_;
+  // Whether the subtree must be drawn in tree order when sorting draws.
+  bool is_draw_order_preserved_;
+  // The render pass of the subtree, if not inherited.
+  RenderPass render_pass_;
+  // The bounds of this Node's Shapes, if has_bounds_ is set.
+  math::Range3f bounds_;
+  bool has_bounds_;
+  // The projected sizes this Node is drawn at, if has_lod_range_ is set.
+  math::Range1f lod_range_;
+  bool has_lod_range_;
+  // The occlusion query of this Node, and the Node drawn while it is hidden.
+  QueryPtr occlusion_query_;
+  NodePtr occlusion_proxy_;
+  // The cached union of the bounds in this Node's subgraph.
+  mutable math::Range3f subgraph_bounds_;
+  mutable SubgraphBoundsState subgraph_bounds_state_;
   // An identifying name for this Node that can appear in debug streams and
   // printouts of a scene.
   std::string label_;
@@ -100,7 +100,14 @@ struct BufferInfo : T {
 template <typename T>
 struct FramebufferInfo : T {
   struct Attachment {
-    Attachment() : type(GL_NONE), value(0), level(0), cube_face(0) {}
+    Attachment()
+        : type(GL_NONE),
+          value(0),
+          level(0),
+          cube_face(0),
+          base_view_index(0),
+          num_views(0),
+          samples(0) {}
     // The type of the attachment, one of GL_RENDERBUFFER, GL_TEXTURE, or if no
     // image is attached, GL_NONE.
     GLenum type;
@@ -112,6 +119,13 @@ struct FramebufferInfo : T {
     // The cube map face of the texture if the attachment is a cube map texture
     // object.
     GLenum cube_face;
+    // The first layer and number of layers of an array texture that are
+    // rendered to as views with OVR_multiview, or 0 views otherwise.
+    GLint base_view_index;
+    GLsizei num_views;
+    // The number of samples of a texture rendered to with
+    // EXT_multisampled_render_to_texture, or 0.
+    GLsizei samples;
   };
   FramebufferInfo() {}
   // Attachments.
@@ -304,14 +318,12 @@ template <typename T>
 struct TransformFeedbackInfo : T {
   TransformFeedbackInfo()
       : target(GL_TRANSFORM_FEEDBACK_BUFFER),
-        varyings(nullptr),
         status(static_cast<GLenum>(-1)),
         primitive_count(0) {}
   // The generic buffer binding target GL_TRANSFORM_FEEDBACK_BUFFER.
   GLenum target;
-  // An array of count zero-terminated strings specifying the names of the
-  // varying variables to use for transform feedback.
-  const char** varyings;
+  // The names of the varying variables to use for transform feedback.
+  std::vector<std::string> varyings;
   // The status of transform feedback: Whether it is active or paused.
   GLenum status;
   // The count of primitives and so forth recorded by the current feedback
@@ -379,6 +391,7 @@ struct TimerInfo : T {
       : mode(kNone),
         timestamp(0),
         duration(0),
+        draw_count(0),
         deleted(false),
         is_data_available(false) {}
   enum Mode {
@@ -393,8 +406,11 @@ struct TimerInfo : T {
   Mode mode;
   // Timestamp data, if used as a query counter or begin query.
   uint64 timestamp;
-  // Duration data, if used as a begin/end query pair.
+  // Duration data, if used as a begin/end query pair, or the result of a
+  // begin/end query of another target.
   uint64 duration;
+  // The number of draws made when a begin query started.
+  uint64 draw_count;
   // Was deleted.
   bool deleted;
   // Is timestamp or duration available.
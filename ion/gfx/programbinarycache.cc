@@ -0,0 +1,165 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/programbinarycache.h"
+
+#include <stdio.h>
+#include <string.h>  // For memcpy().
+
+#include "base/integral_types.h"
+#include "ion/base/logging.h"
+#include "ion/port/fileutils.h"
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+// FNV-1a parameters for ComputeKey().
+static const uint64 kHashSeed = 14695981039346656037ULL;
+static const uint64 kHashPrime = 1099511628211ULL;
+
+// Folds a string, followed by a separator, into a hash.
+static uint64 HashString(uint64 hash, const std::string& str) {
+  const size_t length = str.length();
+  for (size_t i = 0; i < length; ++i)
+    hash = (hash ^ static_cast<uint8>(str[i])) * kHashPrime;
+  // The separator keeps e.g. ("ab", "c") and ("a", "bc") apart.
+  return (hash ^ 0xffU) * kHashPrime;
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// ProgramBinaryCache::FileStorage.
+//
+//-----------------------------------------------------------------------------
+
+ProgramBinaryCache::FileStorage::FileStorage(const std::string& directory)
+    : directory_(directory) {}
+
+ProgramBinaryCache::FileStorage::~FileStorage() {}
+
+bool ProgramBinaryCache::FileStorage::Read(const std::string& key,
+                                           std::string* data) {
+  return port::ReadDataFromFile(GetPath(key), data);
+}
+
+void ProgramBinaryCache::FileStorage::Write(const std::string& key,
+                                            const std::string& data) {
+  const std::string path = GetPath(key);
+  bool ok = false;
+  if (FILE* fp = port::OpenFile(path, "wb")) {
+    ok = fwrite(data.c_str(), sizeof(data[0]), data.length(), fp) ==
+         data.length();
+    ok = fclose(fp) == 0 && ok;
+  }
+  if (!ok) {
+    LOG(WARNING) << "***ION: Unable to write program binary to '" << path
+                 << "'";
+    // Do not leave a truncated binary behind.
+    port::RemoveFile(path);
+  }
+}
+
+const std::string ProgramBinaryCache::FileStorage::GetPath(
+    const std::string& key) const {
+  if (directory_.empty())
+    return key;
+  const char last = directory_[directory_.length() - 1];
+  return last == '/' || last == '\\' ? directory_ + key
+                                     : directory_ + '/' + key;
+}
+
+//-----------------------------------------------------------------------------
+//
+// ProgramBinaryCache.
+//
+//-----------------------------------------------------------------------------
+
+const char ProgramBinaryCache::kPipelineKeysEntry[] = "pipelines";
+
+ProgramBinaryCache::ProgramBinaryCache(const std::string& directory)
+    : storage_(new FileStorage(directory)) {}
+
+ProgramBinaryCache::ProgramBinaryCache(const StoragePtr& storage)
+    : storage_(storage) {
+  DCHECK(storage_.Get());
+}
+
+ProgramBinaryCache::~ProgramBinaryCache() {}
+
+const std::string ProgramBinaryCache::ComputeKey(
+    const std::string& vertex_source, const std::string& fragment_source,
+    const std::string& gl_renderer, const std::string& gl_version) {
+  uint64 hash = kHashSeed;
+  hash = HashString(hash, vertex_source);
+  hash = HashString(hash, fragment_source);
+  hash = HashString(hash, gl_renderer);
+  hash = HashString(hash, gl_version);
+
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string key(16U, '0');
+  for (int i = 15; i >= 0; --i, hash >>= 4)
+    key[i] = kHexDigits[hash & 0xfU];
+  return key;
+}
+
+bool ProgramBinaryCache::ReadBinary(const std::string& key, GLenum* format,
+                                    std::string* binary) const {
+  // Each entry holds the binary format followed by the binary.
+  std::string data;
+  if (!storage_->Read(key, &data) || data.length() <= sizeof(uint32))
+    return false;
+  uint32 stored_format;
+  memcpy(&stored_format, data.c_str(), sizeof(stored_format));
+  *format = static_cast<GLenum>(stored_format);
+  binary->assign(data, sizeof(stored_format), std::string::npos);
+  return true;
+}
+
+void ProgramBinaryCache::WriteBinary(const std::string& key, GLenum format,
+                                     const std::string& binary) {
+  const uint32 stored_format = static_cast<uint32>(format);
+  std::string data(reinterpret_cast<const char*>(&stored_format),
+                   sizeof(stored_format));
+  data += binary;
+  storage_->Write(key, data);
+}
+
+bool ProgramBinaryCache::ReadPipelineKeys(std::vector<uint64>* keys) const {
+  // The entry holds the keys back to back.
+  std::string data;
+  if (!storage_->Read(kPipelineKeysEntry, &data) || data.empty() ||
+      data.length() % sizeof(uint64))
+    return false;
+  keys->resize(data.length() / sizeof(uint64));
+  memcpy(&(*keys)[0], data.c_str(), data.length());
+  return true;
+}
+
+void ProgramBinaryCache::WritePipelineKeys(const std::vector<uint64>& keys) {
+  if (keys.empty())
+    return;
+  storage_->Write(kPipelineKeysEntry,
+                  std::string(reinterpret_cast<const char*>(&keys[0]),
+                              keys.size() * sizeof(uint64)));
+}
+
+}  // namespace gfx
+}  // namespace ion
@@ -0,0 +1,133 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFX_PROGRAMBINARYCACHE_H_
+#define ION_GFX_PROGRAMBINARYCACHE_H_
+
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/referent.h"
+#include "ion/portgfx/glheaders.h"
+
+namespace ion {
+namespace gfx {
+
+// A ProgramBinaryCache stores the binaries of linked shader programs so that
+// a Renderer can load them with glProgramBinary() instead of compiling and
+// linking the programs' shaders again, for example the next time an
+// application is launched. Binaries are identified by keys returned by
+// ComputeKey(), and are kept in a Storage, which by default is a FileStorage.
+//
+// Typical usage:
+//   renderer->SetProgramBinaryCache(ProgramBinaryCachePtr(
+//       new ProgramBinaryCache(cache_directory)));
+class ION_API ProgramBinaryCache : public base::Referent {
+ public:
+  // Storage is the interface for reading and writing cache entries. Entries
+  // are opaque strings of bytes. Implementations must be safe to call from
+  // any thread that renders with a Renderer using the cache.
+  class ION_API Storage : public base::Referent {
+   public:
+    // Reads the entry with the passed key into data, returning false if there
+    // is no such entry.
+    virtual bool Read(const std::string& key, std::string* data) = 0;
+    // Writes an entry with the passed key, replacing any existing one.
+    virtual void Write(const std::string& key, const std::string& data) = 0;
+
+   protected:
+    // The destructor is protected because all base::Referent classes must
+    // have protected or private destructors.
+    ~Storage() override {}
+  };
+  typedef base::ReferentPtr<Storage>::Type StoragePtr;
+
+  // FileStorage stores each entry in a file named after its key in a
+  // directory, which must already exist.
+  class ION_API FileStorage : public Storage {
+   public:
+    explicit FileStorage(const std::string& directory);
+
+    bool Read(const std::string& key, std::string* data) override;
+    void Write(const std::string& key, const std::string& data) override;
+
+    // Returns the directory holding the files.
+    const std::string& GetDirectory() const { return directory_; }
+
+   protected:
+    ~FileStorage() override;
+
+   private:
+    // Returns the path to the file for the passed key.
+    const std::string GetPath(const std::string& key) const;
+
+    const std::string directory_;
+  };
+
+  // Creates a cache that stores binaries in files in the passed directory.
+  explicit ProgramBinaryCache(const std::string& directory);
+  // Creates a cache that stores binaries in the passed storage, which must not
+  // be NULL.
+  explicit ProgramBinaryCache(const StoragePtr& storage);
+
+  // Returns the storage of the cache.
+  const StoragePtr& GetStorage() const { return storage_; }
+
+  // Returns a key identifying the binary of a program with the passed shader
+  // sources, linked by the OpenGL implementation with the passed renderer and
+  // version strings. The key is a hexadecimal hash of all of them, so that
+  // binaries from other drivers are never loaded.
+  static const std::string ComputeKey(const std::string& vertex_source,
+                                      const std::string& fragment_source,
+                                      const std::string& gl_renderer,
+                                      const std::string& gl_version);
+
+  // Reads the binary for the passed key and its format, returning false if
+  // there is no such binary.
+  bool ReadBinary(const std::string& key, GLenum* format,
+                  std::string* binary) const;
+  // Writes the binary for the passed key and its format.
+  void WriteBinary(const std::string& key, GLenum format,
+                   const std::string& binary);
+
+  // Reads the keys of the pipelines stored by
+  // Renderer::StoreRecordedPipelines(), returning false if there are none.
+  // See Renderer::WarmUpPipelines().
+  bool ReadPipelineKeys(std::vector<uint64>* keys) const;
+  // Writes the keys of recorded pipelines, replacing any stored ones.
+  void WritePipelineKeys(const std::vector<uint64>& keys);
+
+  // The key of the storage entry holding the pipeline keys.
+  static const char kPipelineKeysEntry[];
+
+ protected:
+  // The destructor is protected because all base::Referent classes must have
+  // protected or private destructors.
+  ~ProgramBinaryCache() override;
+
+ private:
+  StoragePtr storage_;
+};
+
+// Convenience typedef for shared pointer to a ProgramBinaryCache.
+typedef base::ReferentPtr<ProgramBinaryCache>::Type ProgramBinaryCachePtr;
+
+}  // namespace gfx
+}  // namespace ion
+
+#endif  // ION_GFX_PROGRAMBINARYCACHE_H_
@@ -0,0 +1,31 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/query.h"
+
+namespace ion {
+namespace gfx {
+
+const int Query::kNumTypes;
+
+Query::Query(Type type)
+    : type_(type), is_pending_(false), result_(0U), result_count_(0U) {}
+
+Query::~Query() {}
+
+}  // namespace gfx
+}  // namespace ion
@@ -0,0 +1,110 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFX_QUERY_H_
+#define ION_GFX_QUERY_H_
+
+#include <string>
+
+#include "base/integral_types.h"
+#include "ion/base/referent.h"
+
+namespace ion {
+namespace gfx {
+
+// Convenience typedef for shared pointer to a Query.
+class Query;
+typedef base::ReferentPtr<Query>::Type QueryPtr;
+
+// A Query measures something about the draws made while it is active, such as
+// whether any of their samples passed the depth test, without stalling the
+// CPU: the result is delivered asynchronously, typically a frame or two later.
+// Queries are started and ended with Renderer::BeginQuery() and
+// Renderer::EndQuery(), or by the Renderer for a Node with an occlusion query
+// (see Node::SetOcclusionQuery()). The Renderer checks, without waiting,
+// whether results have arrived at the end of each call to DrawScene() and in
+// Renderer::ProcessQueries(). A Query should only be used on the thread that
+// renders with the Renderer.
+//
+// The Renderer keeps a pool of OpenGL query objects, so a Query does not hold
+// any OpenGL resources and can be created and dropped freely.
+class ION_API Query : public base::Referent {
+ public:
+  // What a Query measures. Not all types are supported on all platforms; see
+  // Renderer::IsQuerySupported().
+  enum Type {
+    // 1 if any samples passed the depth and stencil tests, otherwise 0.
+    kAnySamplesPassed,
+    // Like kAnySamplesPassed, but possibly computed faster at the cost of
+    // sometimes returning 1 when no samples passed.
+    kAnySamplesPassedConservative,
+    // The number of samples that passed the depth and stencil tests. This is
+    // only supported by desktop OpenGL.
+    kSamplesPassed,
+    // The number of primitives sent to the rasterizer.
+    kPrimitivesGenerated,
+    // The GPU time taken by the draws, in nanoseconds.
+    kTimeElapsed,
+  };
+  static const int kNumTypes = kTimeElapsed + 1;
+
+  explicit Query(Type type);
+
+  // Returns the type of the Query.
+  Type GetType() const { return type_; }
+
+  // Sets/returns a label for identifying the Query in errors.
+  void SetLabel(const std::string& label) { label_ = label; }
+  const std::string& GetLabel() const { return label_; }
+
+  // Returns whether the Query is being measured or waiting for its result. A
+  // pending Query cannot be started again.
+  bool IsPending() const { return is_pending_; }
+  // Returns whether any result has been delivered.
+  bool HasResult() const { return result_count_ != 0U; }
+  // Returns the most recently delivered result, or 0 if there is none.
+  uint64 GetResult() const { return result_; }
+  // Returns the number of results that have been delivered.
+  uint64 GetResultCount() const { return result_count_; }
+
+ protected:
+  // The destructor is protected because all base::Referent classes must have
+  // protected or private destructors.
+  ~Query() override;
+
+ private:
+  void SetPending() { is_pending_ = true; }
+  void SetResult(uint64 result) {
+    result_ = result;
+    ++result_count_;
+    is_pending_ = false;
+  }
+  void ClearPending() { is_pending_ = false; }
+
+  const Type type_;
+  std::string label_;
+  bool is_pending_;
+  uint64 result_;
+  uint64 result_count_;
+
+  friend class Renderer;
+};
+
+}  // namespace gfx
+}  // namespace ion
+
+#endif  // ION_GFX_QUERY_H_
@@ -15,10 +15,19 @@ limitations under the License.
 
 */
 
+#include <string.h>  // For memcpy().
+
 #include <algorithm>
 #include <bitset>
+#include <chrono>  // NOLINT
+#include <functional>
 #include <limits>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "base/integral_types.h"
@@ -29,11 +38,15 @@ limitations under the License.
 #include "ion/base/lockguards.h"
 #include "ion/base/logging.h"
 #include "ion/base/readwritelock.h"
+#include "ion/base/samplingallocationtracker.h"
 #include "ion/base/serialize.h"
 #include "ion/base/staticsafedeclare.h"
+#include "ion/base/stlalloc/allocdeque.h"
+#include "ion/base/stlalloc/allocmap.h"
 #include "ion/base/stlalloc/allocset.h"
 #include "ion/base/stlalloc/allocunorderedset.h"
 #include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/workerpool.h"
 #include "ion/gfx/attribute.h"
 #include "ion/gfx/attributearray.h"
 #include "ion/gfx/bufferobject.h"
@@ -55,6 +68,8 @@ limitations under the License.
 #include "ion/math/vector.h"
 #include "ion/port/atomic.h"
 #include "ion/port/mutex.h"
+#include "ion/port/semaphore.h"
+#include "ion/port/timer.h"
 #include "ion/portgfx/glheaders.h"
 #include "ion/portgfx/visual.h"
 
@@ -80,9 +95,12 @@ typedef size_t ResourceKey;
 //
 //-----------------------------------------------------------------------------
 
-// Returns a ReadWriteLock for protecting access to the map of ResourceBinders.
-static base::ReadWriteLock* GetResourceBinderLock() {
-  ION_DECLARE_SAFE_STATIC_POINTER(base::ReadWriteLock, lock);
+// Returns a lock for protecting access to the map of ResourceBinders. The map
+// is read by every Renderer on every frame, from any number of threads, but
+// only written when a Visual is first used or destroyed, so it uses a
+// BigReaderLock.
+static base::BigReaderLock* GetResourceBinderLock() {
+  ION_DECLARE_SAFE_STATIC_POINTER(base::BigReaderLock, lock);
   return lock;
 }
 
@@ -137,9 +155,21 @@ static const char* GetShaderTypeString(GLenum shader_type) {
     type = "vertex";
   else if (shader_type == GL_FRAGMENT_SHADER)
     type = "fragment";
+  else if (shader_type == GL_COMPUTE_SHADER)
+    type = "compute";
   return type;
 }
 
+// Returns whether compute shaders are supported, logging an error that the
+// passed action is not possible if they are not.
+static bool IsComputeShaderSupported(GraphicsManager* gm, const char* action) {
+  if (gm->IsFunctionGroupAvailable(GraphicsManager::kComputeShader))
+    return true;
+  LOG(ERROR) << "***ION: Unable to " << action
+             << ": Compute shaders are not supported on this platform";
+  return false;
+}
+
 // Sets the label of an object if GL supports the operation.
 static void SetObjectLabel(GraphicsManager* gm, GLenum type, GLuint id,
                            const std::string& label) {
@@ -239,55 +269,113 @@ static bool ValidateUniformType(const char* name,
   return types_equal;
 }
 
-// Compiles an OpenGL shader, returning the shader id. Logs a message and
-// returns 0 on error.
-static GLuint CompileShader(const std::string& id_string, GLenum shader_type,
-                            const std::string& source, std::string* info_log,
-                            GraphicsManager* gm) {
-  // Clear the info log. When this function returns it will either be empty,
-  // indicating success, or non-empty, signaling an error.
-  info_log->clear();
-  GLuint id = gm->CreateShader(shader_type);
+// Returns a pointer to the packed values of a Uniform of type T.
+template <typename T>
+static const uint8* GetUniformValues(const Uniform& uniform) {
+  return reinterpret_cast<const uint8*>(uniform.GetCount()
+                                            ? &uniform.GetValueAt<T>(0)
+                                            : &uniform.GetValue<T>());
+}
+
+// Returns a pointer to the packed values of a Uniform, setting |value_size| to
+// the size in bytes of each value. Returns NULL for texture Uniforms, whose
+// values are not sent to OpenGL directly.
+static const uint8* GetUniformValues(const Uniform& uniform,
+                                     size_t* value_size) {
+#define GET_UNIFORM_VALUES(uniform_type, type) \
+  case uniform_type:                           \
+    *value_size = sizeof(type);                \
+    return GetUniformValues<type>(uniform)
+
+  switch (uniform.GetType()) {
+    GET_UNIFORM_VALUES(kIntUniform, int);
+    GET_UNIFORM_VALUES(kFloatUniform, float);
+    GET_UNIFORM_VALUES(kUnsignedIntUniform, uint32);
+    GET_UNIFORM_VALUES(kFloatVector2Uniform, math::VectorBase2f);
+    GET_UNIFORM_VALUES(kFloatVector3Uniform, math::VectorBase3f);
+    GET_UNIFORM_VALUES(kFloatVector4Uniform, math::VectorBase4f);
+    GET_UNIFORM_VALUES(kIntVector2Uniform, math::VectorBase2i);
+    GET_UNIFORM_VALUES(kIntVector3Uniform, math::VectorBase3i);
+    GET_UNIFORM_VALUES(kIntVector4Uniform, math::VectorBase4i);
+    GET_UNIFORM_VALUES(kUnsignedIntVector2Uniform, math::VectorBase2ui);
+    GET_UNIFORM_VALUES(kUnsignedIntVector3Uniform, math::VectorBase3ui);
+    GET_UNIFORM_VALUES(kUnsignedIntVector4Uniform, math::VectorBase4ui);
+    GET_UNIFORM_VALUES(kMatrix2x2Uniform, math::Matrix2f);
+    GET_UNIFORM_VALUES(kMatrix3x3Uniform, math::Matrix3f);
+    GET_UNIFORM_VALUES(kMatrix4x4Uniform, math::Matrix4f);
+    default:
+      break;
+  }
+#undef GET_UNIFORM_VALUES
 
+  *value_size = 0U;
+  return NULL;
+}
+
+// Creates an OpenGL shader and starts compiling it, returning the shader id.
+// The result of the compilation must be checked with
+// CheckShaderCompileStatus(). Logs a message and returns 0 on error.
+static GLuint StartCompilingShader(GLenum shader_type,
+                                   const std::string& source,
+                                   GraphicsManager* gm) {
+  GLuint id = gm->CreateShader(shader_type);
   if (id) {
     // Send the source to OpenGL and compile the shader.
     const char* source_string = source.c_str();
     gm->ShaderSource(id, 1, &source_string, NULL);
     gm->CompileShader(id);
-
-    // Test for problems.
-    GLint ok = GL_FALSE;
-    gm->GetShaderiv(id, GL_COMPILE_STATUS, &ok);
-    if (!ok) {
-      char log[2048];
-      log[0] = 0;
-      gm->GetShaderInfoLog(id, 2047, NULL, log);
-      *info_log = log;
-      LOG(ERROR) << "***ION: Unable to compile "
-                 << GetShaderTypeString(shader_type) << " shader for '"
-                 << id_string << "': " << log;
-      gm->DeleteShader(id);
-      id = 0;
-    }
   } else {
     LOG(ERROR) << "***ION: Unable to create shader object";
   }
   return id;
 }
 
-// Links an OpenGL shader program, returning the program id. Logs a message and
-// returns 0 on error.
-static GLuint RelinkShaderProgram(const std::string& id_string,
-                                  GLuint program_id, GLuint vertex_shader_id,
-                                  GLuint fragment_shader_id,
-                                  std::string* info_log, GraphicsManager* gm) {
+// Returns whether an OpenGL shader compiled successfully, waiting for the
+// compilation to finish if necessary. Logs a message, sets info_log, and
+// deletes the shader on error; otherwise clears info_log.
+static bool CheckShaderCompileStatus(const std::string& id_string,
+                                     GLenum shader_type, GLuint id,
+                                     std::string* info_log,
+                                     GraphicsManager* gm) {
   // Clear the info log. When this function returns it will either be empty,
   // indicating success, or non-empty, signaling an error.
   info_log->clear();
-  // Link the program object.
-  gm->LinkProgram(program_id);
+  GLint ok = GL_FALSE;
+  gm->GetShaderiv(id, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    char log[2048];
+    log[0] = 0;
+    gm->GetShaderInfoLog(id, 2047, NULL, log);
+    *info_log = log;
+    LOG(ERROR) << "***ION: Unable to compile "
+               << GetShaderTypeString(shader_type) << " shader for '"
+               << id_string << "': " << log;
+    gm->DeleteShader(id);
+  }
+  return ok != GL_FALSE;
+}
 
-  // Test for problems.
+// Compiles an OpenGL shader, returning the shader id. Logs a message and
+// returns 0 on error.
+static GLuint CompileShader(const std::string& id_string, GLenum shader_type,
+                            const std::string& source, std::string* info_log,
+                            GraphicsManager* gm) {
+  info_log->clear();
+  GLuint id = StartCompilingShader(shader_type, source, gm);
+  if (id && !CheckShaderCompileStatus(id_string, shader_type, id, info_log, gm))
+    id = 0;
+  return id;
+}
+
+// Returns whether an OpenGL program linked successfully, waiting for the link
+// to finish if necessary. Logs a message, sets info_log, and deletes the
+// program on error; otherwise clears info_log.
+static bool CheckProgramLinkStatus(const std::string& id_string,
+                                   GLuint program_id, std::string* info_log,
+                                   GraphicsManager* gm) {
+  // Clear the info log. When this function returns it will either be empty,
+  // indicating success, or non-empty, signaling an error.
+  info_log->clear();
   GLint ok = GL_FALSE;
   gm->GetProgramiv(program_id, GL_LINK_STATUS, &ok);
   if (!ok) {
@@ -298,9 +386,33 @@ static GLuint RelinkShaderProgram(const std::string& id_string,
     LOG(ERROR) << "***ION: Unable to link shader program for '" << id_string
                << "': " << log;
     gm->DeleteProgram(program_id);
-    program_id = 0;
   }
+  return ok != GL_FALSE;
+}
+
+// Returns whether OpenGL has finished linking a program, without waiting for
+// it. Links are always finished if KHR_parallel_shader_compile is not
+// supported, since there is then no way to tell; checking the link status
+// waits for them instead.
+static bool IsProgramLinkComplete(GLuint program_id, GraphicsManager* gm) {
+  if (!gm->IsFunctionGroupAvailable(GraphicsManager::kParallelShaderCompile))
+    return true;
+  GLint complete = GL_TRUE;
+  gm->GetProgramiv(program_id, GL_COMPLETION_STATUS_KHR, &complete);
+  return complete != GL_FALSE;
+}
 
+// Links an OpenGL shader program, returning the program id. Logs a message and
+// returns 0 on error.
+static GLuint RelinkShaderProgram(const std::string& id_string,
+                                  GLuint program_id, GLuint vertex_shader_id,
+                                  GLuint fragment_shader_id,
+                                  std::string* info_log, GraphicsManager* gm) {
+  // Link the program object.
+  gm->LinkProgram(program_id);
+  // Test for problems.
+  if (!CheckProgramLinkStatus(id_string, program_id, info_log, gm))
+    program_id = 0;
   return program_id;
 }
 
@@ -326,6 +438,125 @@ static GLuint LinkShaderProgram(const std::string& id_string,
   return program_id;
 }
 
+// Creates an OpenGL shader program from the binary stored in a cache under
+// the passed key, returning the program id. Returns 0 if there is no binary or
+// OpenGL rejects it, which happens when the driver has changed since the
+// binary was stored.
+static GLuint LoadShaderProgramBinary(ProgramBinaryCache* cache,
+                                      const std::string& key,
+                                      GraphicsManager* gm) {
+  GLenum format = GL_NONE;
+  std::string binary;
+  if (!cache->ReadBinary(key, &format, &binary))
+    return 0;
+
+  GLuint program_id = gm->CreateProgram();
+  if (program_id) {
+    gm->ProgramBinary(program_id, format, binary.c_str(),
+                      static_cast<GLsizei>(binary.length()));
+    GLint ok = GL_FALSE;
+    gm->GetProgramiv(program_id, GL_LINK_STATUS, &ok);
+    if (!ok) {
+      gm->DeleteProgram(program_id);
+      program_id = 0;
+    }
+  }
+  return program_id;
+}
+
+// Writes the binary of a linked OpenGL shader program to a cache under the
+// passed key. Nothing is written if OpenGL does not return a binary.
+static void StoreShaderProgramBinary(ProgramBinaryCache* cache,
+                                     const std::string& key, GLuint program_id,
+                                     GraphicsManager* gm) {
+  GLint length = 0;
+  gm->GetProgramiv(program_id, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length > 0) {
+    std::string binary(static_cast<size_t>(length), '\0');
+    GLsizei binary_length = 0;
+    GLenum format = GL_NONE;
+    gm->GetProgramBinary(program_id, length, &binary_length, &format,
+                         &binary[0]);
+    if (binary_length > 0) {
+      binary.resize(static_cast<size_t>(binary_length));
+      cache->WriteBinary(key, format, binary);
+    }
+  }
+}
+
+// FNV-1a parameters for ComputePipelineKey().
+static const uint64 kPipelineHashSeed = 14695981039346656037ULL;
+static const uint64 kPipelineHashPrime = 1099511628211ULL;
+
+// Folds a value into a pipeline key.
+static uint64 HashPipelineValue(uint64 hash, uint64 value) {
+  for (int i = 0; i < 8; ++i, value >>= 8)
+    hash = (hash ^ (value & 0xffU)) * kPipelineHashPrime;
+  return hash;
+}
+
+// Folds a string, followed by a separator, into a pipeline key.
+static uint64 HashPipelineString(uint64 hash, const std::string& str) {
+  const size_t length = str.length();
+  for (size_t i = 0; i < length; ++i)
+    hash = (hash ^ static_cast<uint8>(str[i])) * kPipelineHashPrime;
+  return (hash ^ 0xffU) * kPipelineHashPrime;
+}
+
+// Returns a key identifying the pipeline a driver may compile for drawing the
+// enabled buffer attributes of an AttributeArray as primitives of the passed
+// type with a program and OpenGL state. The key only depends on the values
+// drivers specialize shaders for, such as the blend and write masks and the
+// vertex layout, so that it is the same in every session.
+static uint64 ComputePipelineKey(const ShaderProgram& program,
+                                 const StateTable& st,
+                                 const AttributeArray& aa,
+                                 GLenum primitive_type) {
+  uint64 hash = kPipelineHashSeed;
+  if (const Shader* shader = program.GetVertexShader().Get())
+    hash = HashPipelineString(hash, shader->GetSource());
+  if (const Shader* shader = program.GetFragmentShader().Get())
+    hash = HashPipelineString(hash, shader->GetSource());
+
+  for (int i = 0; i < StateTable::GetCapabilityCount(); ++i)
+    hash = HashPipelineValue(
+        hash, st.IsEnabled(static_cast<StateTable::Capability>(i)));
+  hash = HashPipelineValue(hash, st.GetRgbBlendEquation());
+  hash = HashPipelineValue(hash, st.GetAlphaBlendEquation());
+  hash = HashPipelineValue(hash, st.GetRgbBlendFunctionSourceFactor());
+  hash = HashPipelineValue(hash, st.GetRgbBlendFunctionDestinationFactor());
+  hash = HashPipelineValue(hash, st.GetAlphaBlendFunctionSourceFactor());
+  hash = HashPipelineValue(hash, st.GetAlphaBlendFunctionDestinationFactor());
+  hash = HashPipelineValue(hash, (st.GetRedColorWriteMask() ? 1U : 0U) |
+                                     (st.GetGreenColorWriteMask() ? 2U : 0U) |
+                                     (st.GetBlueColorWriteMask() ? 4U : 0U) |
+                                     (st.GetAlphaColorWriteMask() ? 8U : 0U));
+  hash = HashPipelineValue(hash, st.GetDepthWriteMask());
+  hash = HashPipelineValue(hash, st.GetDepthFunction());
+  hash = HashPipelineValue(hash, st.GetCullFaceMode());
+  hash = HashPipelineValue(hash, st.GetFrontFaceMode());
+
+  const size_t count = aa.GetBufferAttributeCount();
+  for (size_t i = 0; i < count; ++i) {
+    if (!aa.IsBufferAttributeEnabled(i))
+      continue;
+    const Attribute& a = aa.GetBufferAttribute(i);
+    const BufferObjectElement& element = a.GetValue<BufferObjectElement>();
+    hash = HashPipelineString(hash, ShaderInputRegistry::GetSpec(a)->name);
+    if (const BufferObject* bo = element.buffer_object.Get()) {
+      const BufferObject::Spec& spec = bo->GetSpec(element.spec_index);
+      if (!base::IsInvalidReference(spec)) {
+        hash = HashPipelineValue(hash, spec.type);
+        hash = HashPipelineValue(hash, spec.component_count);
+      }
+      hash = HashPipelineValue(hash, bo->GetStructSize());
+    }
+    hash = HashPipelineValue(hash, a.IsFixedPointNormalized());
+    hash = HashPipelineValue(hash, a.GetDivisor());
+  }
+  return HashPipelineValue(hash, primitive_type);
+}
+
 // The following two functions return an Image from a CubeMapTexture or a
 // Texture, returning a NULL pointer if there is no valid Image.
 const ImagePtr GetCubeMapTextureImageOrMipmap(const CubeMapTexture& tex,
@@ -390,6 +621,984 @@ static Image::PixelFormat GetCompatiblePixelFormat(Image::PixelFormat pf,
   return pf;
 }
 
+// Combines a key used for sorting draws by state with the passed pointer. The
+// actual values are unimportant as long as equal inputs produce equal keys.
+static size_t CombineSortKey(size_t key, const void* pointer) {
+  const size_t value = reinterpret_cast<size_t>(pointer);
+  return key ^ (value + 0x9e3779b9U + (key << 6) + (key >> 2));
+}
+
+// Combines a key used for sorting draws by state with all of the textures
+// contained in the passed Uniforms.
+static size_t CombineTextureSortKey(
+    size_t key, const base::AllocVector<Uniform>& uniforms) {
+  const size_t num_uniforms = uniforms.size();
+  for (size_t i = 0; i < num_uniforms; ++i) {
+    const Uniform& u = uniforms[i];
+    if (!u.IsValid())
+      continue;
+    if (u.GetType() == kTextureUniform) {
+      if (const size_t count = u.GetCount()) {
+        for (size_t j = 0; j < count; ++j)
+          key = CombineSortKey(key, u.GetValueAt<TexturePtr>(j).Get());
+      } else {
+        key = CombineSortKey(key, u.GetValue<TexturePtr>().Get());
+      }
+    } else if (u.GetType() == kCubeMapTextureUniform) {
+      if (const size_t count = u.GetCount()) {
+        for (size_t j = 0; j < count; ++j)
+          key = CombineSortKey(key, u.GetValueAt<CubeMapTexturePtr>(j).Get());
+      } else {
+        key = CombineSortKey(key, u.GetValue<CubeMapTexturePtr>().Get());
+      }
+    }
+  }
+  return key;
+}
+
+// Returns whether the passed StateTable contains clears or enforced settings,
+// which must be applied in tree order when drawing from a DrawList.
+static bool IsBarrierStateTable(const StateTable& st) {
+  return st.AreSettingsEnforced() ||
+         st.IsValueSet(StateTable::kClearColorValue) ||
+         st.IsValueSet(StateTable::kClearDepthValue) ||
+         st.IsValueSet(StateTable::kClearStencilValue);
+}
+
+// Returns whether the passed Image still has data that can be uploaded to
+// OpenGL, i.e., it is not an EGL image and its data has not been wiped, or can
+// be reloaded.
+static bool IsImageDataAvailable(const Image& image) {
+  return image.GetType() != Image::kEgl &&
+         image.GetType() != Image::kExternalEgl && image.GetData().Get() &&
+         image.GetData()->IsDataAvailable();
+}
+
+// Returns whether the passed non-empty box lies entirely outside of the clip
+// volume after being transformed by the passed matrix, i.e., whether all of its
+// corners are outside of the same clip plane.
+static bool IsRangeOutsideClipVolume(const math::Range3f& range,
+                                     const math::Matrix4f& clip_from_scene) {
+  const math::Point3f& min_point = range.GetMinPoint();
+  const math::Point3f& max_point = range.GetMaxPoint();
+  // Bit 2i is set if a corner is outside the negative plane of axis i, and bit
+  // 2i + 1 if it is outside the positive plane.
+  int outside_all = 0x3f;
+  for (int i = 0; i < 8 && outside_all; ++i) {
+    const math::Point4f corner = clip_from_scene *
+        math::Point4f(i & 1 ? max_point[0] : min_point[0],
+                      i & 2 ? max_point[1] : min_point[1],
+                      i & 4 ? max_point[2] : min_point[2], 1.f);
+    const float w = corner[3];
+    int outside = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+      if (corner[axis] < -w)
+        outside |= 1 << (2 * axis);
+      if (corner[axis] > w)
+        outside |= 2 << (2 * axis);
+    }
+    outside_all &= outside;
+  }
+  return outside_all != 0;
+}
+
+// Returns the size of the passed non-empty box on screen after being
+// transformed by the passed matrix: the larger of the width and height of the
+// rectangle enclosing its projected corners, as a fraction of the view.
+// Returns infinity if any corner is at or behind the eye.
+static float GetProjectedSize(const math::Range3f& range,
+                              const math::Matrix4f& clip_from_scene) {
+  const math::Point3f& min_point = range.GetMinPoint();
+  const math::Point3f& max_point = range.GetMaxPoint();
+  math::Range2f screen_range;
+  for (int i = 0; i < 8; ++i) {
+    const math::Point4f corner = clip_from_scene *
+        math::Point4f(i & 1 ? max_point[0] : min_point[0],
+                      i & 2 ? max_point[1] : min_point[1],
+                      i & 4 ? max_point[2] : min_point[2], 1.f);
+    const float w = corner[3];
+    if (w <= 0.f)
+      return std::numeric_limits<float>::infinity();
+    screen_range.ExtendByPoint(math::Point2f(corner[0] / w, corner[1] / w));
+  }
+  // Normalized device coordinates span 2 units across the view.
+  const math::Vector2f size = screen_range.GetSize();
+  return 0.5f * std::max(size[0], size[1]);
+}
+
+// Returns whether the passed Node is drawn at its projected size, i.e., whether
+// it has no LOD range or the size is within the range. The size is infinite if
+// clip_from_scene is NULL. See Node::SetLodRange().
+static bool IsLodSelected(const Node& node,
+                          const math::Matrix4f* clip_from_scene) {
+  if (!node.HasLodRange())
+    return true;
+  float size = std::numeric_limits<float>::infinity();
+  math::Range3f bounds;
+  if (clip_from_scene && node.GetSubgraphBounds(&bounds) && !bounds.IsEmpty())
+    size = GetProjectedSize(bounds, *clip_from_scene);
+  const math::Range1f& range = node.GetLodRange();
+  return size >= range.GetMinPoint()[0] &&
+      (size < range.GetMaxPoint()[0] ||
+       range.GetMaxPoint()[0] == std::numeric_limits<float>::infinity());
+}
+
+// Returns the depth of the center of the passed Node's bounds after being
+// transformed by the passed matrix, or infinity if the Node has no bounds.
+// The clip-space z coordinate grows with the distance from the eye for both
+// perspective and orthographic projections, so no division is needed.
+static float GetNodeDepth(const Node& node,
+                          const math::Matrix4f& clip_from_scene) {
+  if (!node.HasBounds() || node.GetBounds().IsEmpty())
+    return std::numeric_limits<float>::infinity();
+  const math::Point3f center = node.GetBounds().GetCenter();
+  return clip_from_scene(2, 0) * center[0] + clip_from_scene(2, 1) * center[1] +
+         clip_from_scene(2, 2) * center[2] + clip_from_scene(2, 3);
+}
+
+// How a client state is changed in a scene drawn with a depth prepass.
+enum DepthPrepassState {
+  // Values that the prepass changes are reset to their defaults unless the
+  // state sets them, so that they do not leak into later draws.
+  kOutsideDepthPrepass,
+  // Only depth is written.
+  kInDepthPrepass,
+  // Fragments are tested against the depth written by the prepass, which is
+  // not written again.
+  kAfterDepthPrepass,
+};
+
+// Changes the passed client state as the passed DepthPrepassState requires.
+static void ApplyDepthPrepassState(DepthPrepassState prepass_state,
+                                   StateTable* state) {
+  switch (prepass_state) {
+    case kOutsideDepthPrepass:
+      if (!state->IsCapabilitySet(StateTable::kDepthTest))
+        state->Enable(StateTable::kDepthTest, false);
+      if (!state->IsValueSet(StateTable::kColorWriteMasksValue))
+        state->SetColorWriteMasks(true, true, true, true);
+      if (!state->IsValueSet(StateTable::kDepthFunctionValue))
+        state->SetDepthFunction(StateTable::kDepthLess);
+      if (!state->IsValueSet(StateTable::kDepthWriteMaskValue))
+        state->SetDepthWriteMask(true);
+      break;
+    case kInDepthPrepass:
+      state->Enable(StateTable::kDepthTest, true);
+      state->SetColorWriteMasks(false, false, false, false);
+      state->SetDepthWriteMask(true);
+      break;
+    case kAfterDepthPrepass:
+      state->Enable(StateTable::kDepthTest, true);
+      if (!state->IsValueSet(StateTable::kColorWriteMasksValue))
+        state->SetColorWriteMasks(true, true, true, true);
+      state->SetDepthFunction(StateTable::kDepthLessOrEqual);
+      state->SetDepthWriteMask(false);
+      break;
+  }
+}
+
+// How a client state is changed in a scene whose transparent pass is drawn
+// with order-independent transparency, and which transparency pass a draw
+// belongs to.
+enum TransparencyPassState {
+  // Values that the transparency passes change are reset to their defaults
+  // unless the state sets them, so that they do not leak into later draws.
+  kOutsideTransparencyPasses,
+  // Weighted premultiplied colors and alphas are summed.
+  kInAccumulationPass,
+  // The product of one minus each alpha is computed.
+  kInRevealagePass,
+};
+
+// Changes the passed client state as the passed TransparencyPassState
+// requires.
+static void ApplyTransparencyPassState(TransparencyPassState pass_state,
+                                       StateTable* state) {
+  switch (pass_state) {
+    case kOutsideTransparencyPasses:
+      if (!state->IsCapabilitySet(StateTable::kBlend))
+        state->Enable(StateTable::kBlend, false);
+      if (!state->IsValueSet(StateTable::kBlendEquationsValue))
+        state->SetBlendEquations(StateTable::kAdd, StateTable::kAdd);
+      if (!state->IsValueSet(StateTable::kBlendFunctionsValue))
+        state->SetBlendFunctions(StateTable::kOne, StateTable::kZero,
+                                 StateTable::kOne, StateTable::kZero);
+      if (!state->IsValueSet(StateTable::kDepthWriteMaskValue))
+        state->SetDepthWriteMask(true);
+      break;
+    case kInAccumulationPass:
+      state->Enable(StateTable::kBlend, true);
+      state->SetBlendEquations(StateTable::kAdd, StateTable::kAdd);
+      state->SetBlendFunctions(StateTable::kOne, StateTable::kOne,
+                               StateTable::kOne, StateTable::kOne);
+      state->SetDepthWriteMask(false);
+      break;
+    case kInRevealagePass:
+      state->Enable(StateTable::kBlend, true);
+      state->SetBlendEquations(StateTable::kAdd, StateTable::kAdd);
+      state->SetBlendFunctions(
+          StateTable::kZero, StateTable::kOneMinusSrcAlpha,
+          StateTable::kZero, StateTable::kOneMinusSrcAlpha);
+      state->SetDepthWriteMask(false);
+      break;
+  }
+}
+
+// Culls Nodes whose subgraph bounds are outside of a view frustum, and then
+// applies a client visibility function, if any.
+struct FrustumCuller {
+  FrustumCuller(const math::Matrix4f& clip_from_scene_in,
+                const Renderer::NodeVisibilityFunction* function_in)
+      : clip_from_scene(clip_from_scene_in), function(function_in) {}
+
+  bool operator()(const Node& node) const {
+    math::Range3f bounds;
+    if (node.GetSubgraphBounds(&bounds) && !bounds.IsEmpty() &&
+        IsRangeOutsideClipVolume(bounds, clip_from_scene))
+      return false;
+    return !function || (*function)(node);
+  }
+
+  math::Matrix4f clip_from_scene;
+  const Renderer::NodeVisibilityFunction* function;
+};
+
+// A ring of pixel unpack buffers through which texture image data is streamed.
+// Cycling through several buffers lets OpenGL keep transferring data from one
+// while the next is being filled. The ring is locked from the time data is
+// copied into a buffer until the buffer is unbound, so that uploads from
+// different threads never share a buffer.
+class PixelUnpackBufferRing : public base::Allocatable {
+ public:
+  PixelUnpackBufferRing() : next_(0U) {
+    for (size_t i = 0; i < kRingSize; ++i) {
+      buffers_[i].id = 0U;
+      buffers_[i].size = 0U;
+    }
+  }
+  ~PixelUnpackBufferRing() override {}
+
+  // Copies the passed data into the next buffer in the ring and leaves it
+  // bound to GL_PIXEL_UNPACK_BUFFER, so that pixel data pointers passed to
+  // OpenGL are offsets into the buffer. Returns false, leaving no buffer bound
+  // and the ring unlocked, if the data could not be copied. Otherwise, the
+  // ring stays locked until Unbind() is called.
+  bool BindData(const void* data, size_t size, GraphicsManager* gm) {
+    mutex_.Lock();
+    Buffer& buffer = buffers_[next_];
+    next_ = (next_ + 1U) % kRingSize;
+    if (!buffer.id)
+      gm->GenBuffers(1, &buffer.id);
+    if (buffer.id) {
+      gm->BindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+      if (buffer.size < size) {
+        gm->BufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(size),
+                       NULL, GL_STREAM_DRAW);
+        buffer.size = size;
+      }
+      // Invalidating the buffer lets OpenGL hand back fresh storage instead of
+      // waiting for any transfer still reading from it.
+      if (void* mapped = gm->MapBufferRange(
+              GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size),
+              GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) {
+        memcpy(mapped, data, size);
+        gm->UnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        return true;
+      }
+      LOG(WARNING) << "***ION: Unable to stream texture data through a pixel "
+                      "unpack buffer, uploading it directly instead.";
+    }
+    Unbind(gm);
+    return false;
+  }
+
+  // Unbinds the buffer bound by a successful call to BindData() and unlocks
+  // the ring.
+  void Unbind(GraphicsManager* gm) {
+    gm->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0U);
+    mutex_.Unlock();
+  }
+
+  // Releases all of the buffers in the ring.
+  void Release(bool can_make_gl_calls, GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    for (size_t i = 0; i < kRingSize; ++i) {
+      if (buffers_[i].id && can_make_gl_calls)
+        gm->DeleteBuffers(1, &buffers_[i].id);
+      buffers_[i].id = 0U;
+      buffers_[i].size = 0U;
+    }
+  }
+
+ private:
+  static const size_t kRingSize = 4U;
+
+  struct Buffer {
+    GLuint id;
+    size_t size;
+  };
+
+  Buffer buffers_[kRingSize];
+  // The index of the buffer to use for the next upload.
+  size_t next_;
+  port::Mutex mutex_;
+};
+
+// A queue of fences marking the ends of the frames in which persistently
+// mapped buffer storage was used. Frames are numbered from 1; frame 0 means
+// never used. Only frames that used the storage get a fence and a new number.
+class FrameFenceQueue : public base::Allocatable {
+ public:
+  FrameFenceQueue() : fences_(*this), frame_(1U), fence_needed_(false) {}
+  ~FrameFenceQueue() override {}
+
+  // Returns the number of the current frame and marks it as needing a fence.
+  uint64 UseFrame() {
+    base::LockGuard guard(&mutex_);
+    fence_needed_ = true;
+    return frame_;
+  }
+
+  // Ends the current frame, inserting a fence after its commands if it was
+  // used.
+  void EndFrame(GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    EndFrameLocked(gm);
+  }
+
+  // Waits until OpenGL has finished the commands of the passed frame. If it
+  // is the current frame then it is ended first.
+  void WaitForFrame(uint64 frame, GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    if (!frame)
+      return;
+    if (frame >= frame_)
+      EndFrameLocked(gm);
+    while (!fences_.empty() && fences_.front().frame <= frame) {
+      WaitForSync(fences_.front().sync, gm);
+      fences_.pop_front();
+    }
+  }
+
+  // Deletes all outstanding fences.
+  void Release(bool can_make_gl_calls, GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    if (can_make_gl_calls) {
+      for (size_t i = 0; i < fences_.size(); ++i)
+        gm->DeleteSync(fences_[i].sync);
+    }
+    fences_.clear();
+    fence_needed_ = false;
+  }
+
+ private:
+  // The most fences that are kept outstanding; older ones are waited for.
+  static const size_t kMaxFences = 8U;
+
+  struct Fence {
+    uint64 frame;
+    GLsync sync;
+  };
+
+  void EndFrameLocked(GraphicsManager* gm) {
+    if (!fence_needed_)
+      return;
+    if (GLsync sync = gm->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)) {
+      Fence fence;
+      fence.frame = frame_;
+      fence.sync = sync;
+      fences_.push_back(fence);
+    } else {
+      gm->Finish();
+    }
+    fence_needed_ = false;
+    ++frame_;
+    while (fences_.size() > kMaxFences) {
+      WaitForSync(fences_.front().sync, gm);
+      fences_.pop_front();
+    }
+  }
+
+  // Waits for and deletes the passed fence.
+  static void WaitForSync(GLsync sync, GraphicsManager* gm) {
+    // Wait in one second intervals, in nanoseconds.
+    static const GLuint64 kTimeout = 1000000000U;
+    while (gm->ClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, kTimeout) ==
+           GL_TIMEOUT_EXPIRED) {}
+    gm->DeleteSync(sync);
+  }
+
+  base::AllocDeque<Fence> fences_;
+  uint64 frame_;
+  bool fence_needed_;
+  port::Mutex mutex_;
+};
+
+// Generates the names of OpenGL buffers and textures in batches, keeping the
+// unused ones for later, and optionally queues the objects to delete so that
+// they are deleted in batches at the end of a frame, possibly spread over
+// several frames. Loading or dropping a large scene otherwise makes a call
+// for each object. Names are generated on upload threads too, so all access
+// is locked.
+class ObjectNameCache : public base::Allocatable {
+ public:
+  enum Kind { kBufferNames, kTextureNames, kNumKinds };
+
+  ObjectNameCache()
+      : batch_size_(1U), defer_deletion_(false), deletions_per_frame_(0U) {}
+  ~ObjectNameCache() override {}
+
+  void SetBatchSize(size_t size) {
+    base::LockGuard guard(&mutex_);
+    batch_size_ = std::max(size, static_cast<size_t>(1U));
+  }
+  size_t GetBatchSize() {
+    base::LockGuard guard(&mutex_);
+    return batch_size_;
+  }
+  void SetDeferredDeletion(bool defer, size_t deletions_per_frame) {
+    base::LockGuard guard(&mutex_);
+    defer_deletion_ = defer;
+    deletions_per_frame_ = deletions_per_frame;
+  }
+  bool IsDeletionDeferred() {
+    base::LockGuard guard(&mutex_);
+    return defer_deletion_;
+  }
+
+  // Returns the number of objects waiting to be deleted.
+  size_t GetPendingDeletionCount() {
+    base::LockGuard guard(&mutex_);
+    return pending_deletions_[kBufferNames].size() +
+           pending_deletions_[kTextureNames].size();
+  }
+
+  // Returns an unused name of the passed kind, generating a batch of them if
+  // there are none left. Returns 0 if OpenGL could not generate any.
+  GLuint Generate(Kind kind, GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    std::vector<GLuint>& names = free_names_[kind];
+    if (names.empty()) {
+      names.resize(batch_size_, 0U);
+      const GLsizei count = static_cast<GLsizei>(names.size());
+      if (kind == kBufferNames)
+        gm->GenBuffers(count, &names[0]);
+      else
+        gm->GenTextures(count, &names[0]);
+      // Hand out the names in the order OpenGL generated them.
+      std::reverse(names.begin(), names.end());
+      names.erase(std::remove(names.begin(), names.end(), 0U), names.end());
+      if (names.empty())
+        return 0U;
+    }
+    const GLuint name = names.back();
+    names.pop_back();
+    return name;
+  }
+
+  // Deletes the object with the passed name, or queues it to be deleted by
+  // EndFrame() if deletion is deferred.
+  void Delete(Kind kind, GLuint name, GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    if (defer_deletion_)
+      pending_deletions_[kind].push_back(name);
+    else
+      DeleteNames(kind, &name, 1U, gm);
+  }
+
+  // Deletes the queued objects, at most the number per frame if it is
+  // non-zero.
+  void EndFrame(GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    size_t budget =
+        deletions_per_frame_ ? deletions_per_frame_ : static_cast<size_t>(-1);
+    for (int i = 0; i < kNumKinds; ++i) {
+      std::vector<GLuint>& names = pending_deletions_[i];
+      const size_t count = std::min(budget, names.size());
+      if (count) {
+        DeleteNames(static_cast<Kind>(i), &names[0], count, gm);
+        names.erase(names.begin(), names.begin() + count);
+        budget -= count;
+      }
+    }
+  }
+
+  // Deletes all queued objects and unused names.
+  void Release(bool can_make_gl_calls, GraphicsManager* gm) {
+    base::LockGuard guard(&mutex_);
+    for (int i = 0; i < kNumKinds; ++i) {
+      const Kind kind = static_cast<Kind>(i);
+      if (can_make_gl_calls) {
+        DeleteNames(kind, pending_deletions_[i].data(),
+                    pending_deletions_[i].size(), gm);
+        DeleteNames(kind, free_names_[i].data(), free_names_[i].size(), gm);
+      }
+      pending_deletions_[i].clear();
+      free_names_[i].clear();
+    }
+  }
+
+ private:
+  static void DeleteNames(Kind kind, const GLuint* names, size_t count,
+                          GraphicsManager* gm) {
+    if (!count)
+      return;
+    if (kind == kBufferNames)
+      gm->DeleteBuffers(static_cast<GLsizei>(count), names);
+    else
+      gm->DeleteTextures(static_cast<GLsizei>(count), names);
+  }
+
+  size_t batch_size_;
+  bool defer_deletion_;
+  size_t deletions_per_frame_;
+  // Generated names that have not been handed out, in reverse order.
+  std::vector<GLuint> free_names_[kNumKinds];
+  // The names of the objects waiting to be deleted.
+  std::vector<GLuint> pending_deletions_[kNumKinds];
+  port::Mutex mutex_;
+};
+
+// The active uniforms of linked programs, keyed by the ProgramBinaryCache key
+// of their sources, so that a program identical to one already linked does
+// not have to query OpenGL for its uniforms again. Programs are linked on
+// upload threads too, so all access is locked.
+class UniformLayoutCache : public base::Allocatable {
+ public:
+  // An active uniform, with any array subscript removed from its name.
+  struct ActiveUniform {
+    std::string name;
+    GLenum type;
+    GLint size;
+    GLint location;
+  };
+  typedef std::vector<ActiveUniform> Layout;
+
+  UniformLayoutCache() {}
+  ~UniformLayoutCache() override {}
+
+  // Copies the layout stored under the passed key into layout, returning
+  // false if there is none.
+  bool Find(const std::string& key, Layout* layout) {
+    base::LockGuard guard(&mutex_);
+    std::map<std::string, Layout>::const_iterator it = layouts_.find(key);
+    if (it == layouts_.end())
+      return false;
+    *layout = it->second;
+    return true;
+  }
+
+  // Stores the layout under the passed key.
+  void Add(const std::string& key, const Layout& layout) {
+    base::LockGuard guard(&mutex_);
+    layouts_[key] = layout;
+  }
+
+  // Removes all layouts, since they are only valid for the programs of a
+  // single OpenGL context.
+  void Clear() {
+    base::LockGuard guard(&mutex_);
+    layouts_.clear();
+  }
+
+ private:
+  std::map<std::string, Layout> layouts_;
+  port::Mutex mutex_;
+};
+
+// Vertex arrays shared by AttributeArrays whose buffer attributes have
+// identical layouts. A layout is a sequence of values holding the
+// ResourceBinder that owns the vertex array, since vertex arrays cannot be
+// shared between OpenGL contexts, followed by kValuesPerSlot values for each
+// enabled attribute slot. The arrays are reference counted. An array whose
+// layout uses a buffer that is deleted or recreated is removed from the cache,
+// since OpenGL may reuse the buffer's name, and is deleted when its last user
+// releases it.
+class SharedVertexArrayCache : public base::Allocatable {
+ public:
+  typedef base::AllocVector<uint64> Layout;
+
+  // Each attribute slot is described by its index, buffer, component count,
+  // type, normalization, stride, offset, and divisor.
+  static const size_t kValuesPerSlot = 8U;
+  // The position of the buffer within the values of a slot.
+  static const size_t kBufferValue = 1U;
+
+  struct Array : public base::Allocatable {
+    GLuint id;
+    size_t ref_count;
+    bool is_cached;
+  };
+
+  SharedVertexArrayCache() : arrays_(*this) {}
+  ~SharedVertexArrayCache() override {
+    for (ArrayMap::iterator it = arrays_.begin(); it != arrays_.end(); ++it)
+      delete it->second;
+  }
+
+  // Returns the array with the passed layout after adding a reference to it,
+  // or NULL if there is none.
+  Array* Acquire(const Layout& layout) {
+    base::LockGuard guard(&mutex_);
+    ArrayMap::iterator it = arrays_.find(layout);
+    if (it == arrays_.end())
+      return nullptr;
+    ++it->second->ref_count;
+    return it->second;
+  }
+
+  // Adds an array with the passed layout and vertex array id, holding a single
+  // reference.
+  Array* Add(const Layout& layout, GLuint id) {
+    base::LockGuard guard(&mutex_);
+    Array* array = new (GetAllocator()) Array;
+    array->id = id;
+    array->ref_count = 1U;
+    array->is_cached = true;
+    Array*& entry = arrays_[layout];
+    // A concurrent Add() of the same layout leaves the older array uncached.
+    if (entry)
+      entry->is_cached = false;
+    entry = array;
+    return array;
+  }
+
+  // Removes a reference to the passed array. Returns the id of the vertex
+  // array to delete if that was the last reference, and 0 otherwise.
+  GLuint Release(Array* array) {
+    base::LockGuard guard(&mutex_);
+    DCHECK_GT(array->ref_count, 0U);
+    if (--array->ref_count)
+      return 0U;
+    if (array->is_cached) {
+      for (ArrayMap::iterator it = arrays_.begin(); it != arrays_.end(); ++it) {
+        if (it->second == array) {
+          arrays_.erase(it);
+          break;
+        }
+      }
+    }
+    const GLuint id = array->id;
+    delete array;
+    return id;
+  }
+
+  // Removes the arrays whose layouts use the passed buffer from the cache.
+  void RemoveArraysUsingBuffer(GLuint buffer) {
+    base::LockGuard guard(&mutex_);
+    for (ArrayMap::iterator it = arrays_.begin(); it != arrays_.end();) {
+      const Layout& layout = it->first;
+      bool uses_buffer = false;
+      for (size_t i = 1U + kBufferValue; i < layout.size();
+           i += kValuesPerSlot) {
+        if (layout[i] == buffer) {
+          uses_buffer = true;
+          break;
+        }
+      }
+      if (uses_buffer) {
+        it->second->is_cached = false;
+        arrays_.erase(it++);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  // Returns the number of cached arrays.
+  size_t GetArrayCount() {
+    base::LockGuard guard(&mutex_);
+    return arrays_.size();
+  }
+
+ private:
+  typedef base::AllocMap<Layout, Array*> ArrayMap;
+  ArrayMap arrays_;
+  port::Mutex mutex_;
+};
+
+// Sampler objects shared by Samplers with identical effective state, i.e.,
+// the same filters, wrap modes, comparison, level of detail range, and
+// anisotropy after clamping to what OpenGL supports. The state is a sequence
+// of values, with floats stored as their bits. Samplers are reference
+// counted, and are deleted when their last user releases them.
+class SharedSamplerCache : public base::Allocatable {
+ public:
+  typedef base::AllocVector<uint32> State;
+
+  struct Sampler : public base::Allocatable {
+    GLuint id;
+    size_t ref_count;
+  };
+
+  SharedSamplerCache() : samplers_(*this) {}
+  ~SharedSamplerCache() override {
+    for (SamplerMap::iterator it = samplers_.begin(); it != samplers_.end();
+         ++it)
+      delete it->second;
+  }
+
+  // Returns the sampler with the passed state after adding a reference to it,
+  // or NULL if there is none.
+  Sampler* Acquire(const State& state) {
+    base::LockGuard guard(&mutex_);
+    SamplerMap::iterator it = samplers_.find(state);
+    if (it == samplers_.end())
+      return nullptr;
+    ++it->second->ref_count;
+    return it->second;
+  }
+
+  // Adds a sampler with the passed state and sampler object id, holding a
+  // single reference. If a sampler with the same state was added
+  // concurrently, that one is returned instead, and the passed id is returned
+  // in |unused_id| so that it can be deleted; otherwise |unused_id| is 0.
+  Sampler* Add(const State& state, GLuint id, GLuint* unused_id) {
+    base::LockGuard guard(&mutex_);
+    Sampler*& entry = samplers_[state];
+    if (entry) {
+      ++entry->ref_count;
+      *unused_id = id;
+      return entry;
+    }
+    entry = new (GetAllocator()) Sampler;
+    entry->id = id;
+    entry->ref_count = 1U;
+    *unused_id = 0U;
+    return entry;
+  }
+
+  // Removes a reference to the passed sampler. Returns the id of the sampler
+  // object to delete if that was the last reference, and 0 otherwise.
+  GLuint Release(Sampler* sampler) {
+    base::LockGuard guard(&mutex_);
+    DCHECK_GT(sampler->ref_count, 0U);
+    if (--sampler->ref_count)
+      return 0U;
+    for (SamplerMap::iterator it = samplers_.begin(); it != samplers_.end();
+         ++it) {
+      if (it->second == sampler) {
+        samplers_.erase(it);
+        break;
+      }
+    }
+    const GLuint id = sampler->id;
+    delete sampler;
+    return id;
+  }
+
+  // Returns the number of shared sampler objects.
+  size_t GetSamplerCount() {
+    base::LockGuard guard(&mutex_);
+    return samplers_.size();
+  }
+
+ private:
+  typedef base::AllocMap<State, Sampler*> SamplerMap;
+  SamplerMap samplers_;
+  port::Mutex mutex_;
+};
+
+// Shaders that composite the targets of the transparency passes over the
+// framebuffer that the scene is drawn into. The targets cover the framebuffer
+// from its origin, so they are sampled at the window coordinates of each
+// fragment.
+static const char kTransparencyCompositeVertexShader[] =
+    "attribute vec3 aVertex;\n"
+    "\n"
+    "void main(void) {\n"
+    "  gl_Position = vec4(aVertex, 1.);\n"
+    "}\n";
+
+static const char kTransparencyCompositeFragmentShader[] =
+    "#ifdef GL_ES\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#endif\n"
+    "\n"
+    "uniform sampler2D uAccumulation;\n"
+    "uniform sampler2D uRevealage;\n"
+    "uniform vec2 uTargetSize;\n"
+    "\n"
+    "void main(void) {\n"
+    "  vec2 coords = gl_FragCoord.xy / uTargetSize;\n"
+    "  vec4 accumulation = texture2D(uAccumulation, coords);\n"
+    "  float revealage = texture2D(uRevealage, coords).r;\n"
+    "  gl_FragColor = vec4(\n"
+    "      accumulation.rgb / clamp(accumulation.a, 1e-4, 5e4),\n"
+    "      1. - revealage);\n"
+    "}\n";
+
+// The render targets of weighted blended order-independent transparency (see
+// Renderer::kOrderIndependentTransparency), and a Node that composites them.
+class TransparencyTargets : public base::Allocatable {
+ public:
+  // The targets, in the order they are drawn into.
+  enum Target {
+    kAccumulationTarget,
+    kRevealageTarget,
+    kNumTargets
+  };
+
+  TransparencyTargets()
+      : accumulation_index_(0U), revealage_index_(0U), size_index_(0U) {}
+
+  // Makes the targets width x height pixels, with depth attachments that
+  // match the passed one of the framebuffer that the scene is drawn into, or
+  // that of a default framebuffer if it is NULL. A depth texture is shared
+  // with the targets; returns whether a depth renderbuffer was used instead,
+  // into which the depth of the framebuffer must be copied.
+  bool Prepare(uint32 width, uint32 height,
+               const FramebufferObject::Attachment* depth) {
+    if (!fbos_[0].Get() || fbos_[0]->GetWidth() != width ||
+        fbos_[0]->GetHeight() != height)
+      CreateTargets(width, height);
+
+    FramebufferObject::Attachment target_depth;
+    if (!depth)
+      target_depth = FramebufferObject::Attachment(
+          Image::kRenderbufferDepth24Stencil8);
+    else if (depth->GetBinding() == FramebufferObject::kRenderbuffer)
+      target_depth = FramebufferObject::Attachment(depth->GetFormat());
+    else if (depth->GetBinding() == FramebufferObject::kTexture)
+      target_depth = *depth;
+    for (int i = 0; i < kNumTargets; ++i) {
+      if (fbos_[i]->GetDepthAttachment() != target_depth)
+        fbos_[i]->SetDepthAttachment(target_depth);
+    }
+    composite_node_->SetUniformValue(
+        size_index_, math::Vector2f(static_cast<float>(width),
+                                    static_cast<float>(height)));
+    return target_depth.GetBinding() == FramebufferObject::kRenderbuffer;
+  }
+
+  // Returns the framebuffer of the passed target.
+  FramebufferObject* GetFramebuffer(Target target) const {
+    return fbos_[target].Get();
+  }
+
+  // Returns a StateTable that clears the passed target.
+  const StateTable& GetClearState(Target target) const {
+    return *clear_states_[target];
+  }
+
+  // Returns the Node that composites the targets over the passed viewport.
+  const Node& GetCompositeNode(const math::Range2i& viewport) const {
+    composite_node_->GetStateTable()->SetViewport(viewport);
+    return *composite_node_;
+  }
+
+ private:
+  // Creates the targets and, the first time, the composite Node.
+  void CreateTargets(uint32 width, uint32 height) {
+    static const Image::Format kFormats[kNumTargets] = {Image::kRgba16fHalf,
+                                                        Image::kR8};
+    static const float kClearValues[kNumTargets] = {0.f, 1.f};
+    const base::AllocatorPtr& al = GetAllocator();
+    for (int i = 0; i < kNumTargets; ++i) {
+      ImagePtr image(new (al) Image);
+      image->Set(kFormats[i], width, height, DataContainerPtr());
+      SamplerPtr sampler(new (al) Sampler);
+      sampler->SetMinFilter(Sampler::kNearest);
+      sampler->SetMagFilter(Sampler::kNearest);
+      sampler->SetWrapS(Sampler::kClampToEdge);
+      sampler->SetWrapT(Sampler::kClampToEdge);
+      textures_[i] = new (al) Texture;
+      textures_[i]->SetImage(0U, image);
+      textures_[i]->SetSampler(sampler);
+      fbos_[i] = new (al) FramebufferObject(width, height);
+      fbos_[i]->SetLabel(i == kAccumulationTarget
+                             ? "Ion transparency accumulation"
+                             : "Ion transparency revealage");
+      fbos_[i]->SetColorAttachment(
+          0U, FramebufferObject::Attachment(textures_[i]));
+      clear_states_[i] = new (al) StateTable;
+      clear_states_[i]->Enable(StateTable::kScissorTest, false);
+      clear_states_[i]->SetColorWriteMasks(true, true, true, true);
+      clear_states_[i]->SetClearColor(
+          math::Vector4f(kClearValues[i], kClearValues[i], kClearValues[i],
+                         kClearValues[i]));
+    }
+
+    if (!composite_node_.Get())
+      CreateCompositeNode();
+    composite_node_->SetUniformValue(accumulation_index_,
+                                     textures_[kAccumulationTarget]);
+    composite_node_->SetUniformValue(revealage_index_,
+                                     textures_[kRevealageTarget]);
+  }
+
+  // Creates the Node that draws a rectangle covering the viewport with the
+  // composite shaders, blending the average transparent color over the
+  // framebuffer by one minus the revealage.
+  void CreateCompositeNode() {
+    const base::AllocatorPtr& al = GetAllocator();
+    ShaderInputRegistryPtr reg(new (al) ShaderInputRegistry);
+    reg->IncludeGlobalRegistry();
+    typedef ShaderInputRegistry::UniformSpec Spec;
+    reg->Add(Spec("uAccumulation", kTextureUniform,
+                  "Summed weighted premultiplied colors"));
+    reg->Add(Spec("uRevealage", kTextureUniform,
+                  "Product of one minus each alpha"));
+    reg->Add(Spec("uTargetSize", kFloatVector2Uniform,
+                  "Size of the targets in pixels"));
+
+    static const math::Point3f kCorners[4] = {
+        math::Point3f(-1.f, -1.f, 0.f), math::Point3f(1.f, -1.f, 0.f),
+        math::Point3f(-1.f, 1.f, 0.f), math::Point3f(1.f, 1.f, 0.f)};
+    BufferObjectPtr buffer(new (al) BufferObject);
+    buffer->SetData(
+        DataContainer::CreateAndCopy<math::Point3f>(kCorners, 4U, false, al),
+        sizeof(kCorners[0]), 4U, BufferObject::kStaticDraw);
+    AttributeArrayPtr attribute_array(new (al) AttributeArray);
+    attribute_array->AddAttribute(reg->Create<Attribute>(
+        "aVertex", BufferObjectElement(buffer, buffer->AddSpec(
+                                                   BufferObject::kFloat, 3U,
+                                                   0U))));
+    ShapePtr shape(new (al) Shape);
+    shape->SetLabel("Ion transparency composite");
+    shape->SetPrimitiveType(Shape::kTriangleStrip);
+    shape->SetAttributeArray(attribute_array);
+
+    StateTablePtr state(new (al) StateTable);
+    state->Enable(StateTable::kBlend, true);
+    state->SetBlendEquations(StateTable::kAdd, StateTable::kAdd);
+    state->SetBlendFunctions(StateTable::kSrcAlpha,
+                             StateTable::kOneMinusSrcAlpha, StateTable::kOne,
+                             StateTable::kOneMinusSrcAlpha);
+    state->Enable(StateTable::kCullFace, false);
+    state->Enable(StateTable::kDepthTest, false);
+    state->Enable(StateTable::kScissorTest, false);
+    state->SetColorWriteMasks(true, true, true, true);
+    state->SetDepthWriteMask(false);
+
+    composite_node_ = new (al) Node;
+    composite_node_->SetLabel("Ion transparency composite");
+    composite_node_->SetStateTable(state);
+    composite_node_->SetShaderProgram(ShaderProgram::BuildFromStrings(
+        "Ion transparency composite", reg, kTransparencyCompositeVertexShader,
+        kTransparencyCompositeFragmentShader, al));
+    accumulation_index_ = composite_node_->AddUniform(
+        reg->Create<Uniform>("uAccumulation", TexturePtr()));
+    revealage_index_ = composite_node_->AddUniform(
+        reg->Create<Uniform>("uRevealage", TexturePtr()));
+    size_index_ = composite_node_->AddUniform(
+        reg->Create<Uniform>("uTargetSize", math::Vector2f::Zero()));
+    composite_node_->AddShape(shape);
+  }
+
+  FramebufferObjectPtr fbos_[kNumTargets];
+  TexturePtr textures_[kNumTargets];
+  StateTablePtr clear_states_[kNumTargets];
+  NodePtr composite_node_;
+  size_t accumulation_index_;
+  size_t revealage_index_;
+  size_t size_index_;
+};
+
 }  // anonymous namespace
 
 
@@ -474,13 +1683,29 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
     // Returns the amount of memory used by this resource.
     size_t GetGpuMemoryUsed() const override { return gpu_memory_used_.load(); }
 
+    // Records that this Resource is used in the current frame, and returns
+    // the frame it was last used in.
+    void MarkUsed() { last_used_frame_ = resource_manager_->GetFrame(); }
+    uint64 GetLastUsedFrame() const { return last_used_frame_.load(); }
+
+    // Returns whether this Resource may be evicted to keep GPU memory usage
+    // within the budget, which is only the case when its OpenGL object can be
+    // recreated from the client data of its holder.
+    virtual bool IsEvictable() const { return false; }
+
+    // Returns the label of the holder of this Resource, used to break down
+    // GPU memory usage by label.
+    virtual std::string GetHolderLabel() const { return std::string(); }
+
    protected:
     explicit Resource(ResourceManager* rm)
         : index_(0),
           key_(0),
           group_(NULL),
           resource_manager_(rm),
-          gpu_memory_used_(0U) {}
+          gpu_memory_used_(0U),
+          last_used_frame_(rm->GetFrame()),
+          is_dirty_(false) {}
 
     // Each derived class must define these to update and release its
     // resource. It must be safe to call these multiple times.
@@ -536,8 +1761,8 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
 
     void UnbindAll() {
       // Remove this from all ResourceBinders.
-      base::ReadLock read_lock(GetResourceBinderLock());
-      base::ReadGuard read_guard(&read_lock);
+      base::BigReaderReadLock read_lock(GetResourceBinderLock());
+      base::BigReaderReadGuard read_guard(&read_lock);
       ResourceBinderMap& binders = GetResourceBinderMap();
       for (ResourceBinderMap::iterator it = binders.begin();
            it != binders.end();
@@ -580,12 +1805,26 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
     // The amount of GPU memory this Resource uses.
     std::atomic<size_t> gpu_memory_used_;
 
+    // The frame in which this Resource was created or last used.
+    std::atomic<uint64> last_used_frame_;
+
+    // Whether this Resource is in the manager's list of dirty resources. This
+    // is only accessed while the manager's dirty_mutex_ is locked.
+    bool is_dirty_;
+
     friend class ResourceBinder;
     friend class Renderer::ResourceManager;
   };
 
   typedef base::AllocVector<Resource*> ResourceVector;
 
+  // Orders Resources from least to most recently used.
+  struct LeastRecentlyUsed {
+    bool operator()(const Resource* a, const Resource* b) const {
+      return a->GetLastUsedFrame() < b->GetLastUsedFrame();
+    }
+  };
+
   class ResourceAccessor;
   // Container for holding resources. It contains a ResourceVector and a Mutex
   // for locking access to it.
@@ -732,12 +1971,25 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
   };
 
   // The constructor is passed a GraphicsManager to use for querying resource
-  // information.
-  explicit ResourceManager(const GraphicsManagerPtr& gm)
+  // information and the flags of the owning Renderer.
+  ResourceManager(const GraphicsManagerPtr& gm, const Flags& flags)
       : gfx::ResourceManager(gm),
+        flags_(flags),
         resource_index_(AcquireOrReleaseResourceIndex(false, 0U)),
         memory_usage_(*this),
-        resources_to_release_(*this) {
+        resources_to_release_(*this),
+        dirty_resources_(*this),
+        gpu_memory_budget_(0U),
+        frame_(1U),
+        info_request_budget_(0U),
+        pending_info_requests_(*this),
+        sent_uniform_count_(0U),
+        skipped_uniform_count_(0U),
+        program_binary_hit_count_(0U),
+        program_binary_miss_count_(0U),
+        pipeline_keys_(*this),
+        are_pipeline_keys_stored_(true),
+        is_recording_pipelines_(false) {
     memory_usage_.resize(kNumResourceTypes);
     ResourceAccessor(resources_[kAttributeArray]).GetResources().reserve(128U);
     ResourceAccessor(resources_[kBufferObject]).GetResources().reserve(128U);
@@ -758,6 +2010,80 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
   // ResourceHolders.
   size_t GetResourceIndex() const { return resource_index_; }
 
+  // Returns whether image data for the passed texture should be streamed
+  // through the ring of pixel unpack buffers.
+  bool ShouldStreamTexture(const TextureBase& texture, GraphicsManager* gm) {
+    return (flags_.test(kStreamTexturesThroughPixelBuffers) ||
+            texture.IsPixelBufferStreamingEnabled()) &&
+           gm->IsFunctionGroupAvailable(GraphicsManager::kMapBufferRange) &&
+           (gm->GetGlApiStandard() != GraphicsManager::kEs ||
+            gm->GetGlVersion() >= 30);
+  }
+
+  // Returns whether the storage of Textures should be allocated immutably.
+  bool ShouldUseImmutableTextureStorage(GraphicsManager* gm) const {
+    return flags_.test(kUseImmutableTextureStorage) &&
+           gm->IsFunctionGroupAvailable(GraphicsManager::kTextureStorage);
+  }
+
+  // Returns whether the mipmap levels of Textures with immutable storage
+  // should be uploaded one per frame, starting with the smallest.
+  bool ShouldStreamMipmaps(GraphicsManager* gm) const {
+    return flags_.test(kStreamMipmapsLowestResolutionFirst) &&
+           gm->GetGlVersion() > 20;
+  }
+
+  // Returns the ring of pixel unpack buffers used to stream texture data.
+  PixelUnpackBufferRing* GetPixelUnpackBufferRing() {
+    return &pixel_unpack_buffers_;
+  }
+
+  // Returns whether shader programs should be compiled and linked
+  // asynchronously.
+  bool ShouldCompileShadersAsynchronously() const {
+    return flags_.test(kCompileShadersAsynchronously);
+  }
+
+  // Returns whether AttributeArrays with identical layouts should share
+  // vertex arrays.
+  bool ShouldShareVertexArrays() const {
+    return flags_.test(kShareVertexArrays);
+  }
+
+  // Returns whether Samplers with identical state should share sampler
+  // objects.
+  bool ShouldShareSamplers() const { return flags_.test(kShareSamplers); }
+
+  // Returns whether the data of the passed BufferObject should be kept in
+  // persistently mapped storage.
+  bool ShouldPersistentlyMapBuffer(const BufferObject& bo,
+                                   GraphicsManager* gm) {
+    return flags_.test(kPersistentlyMapStreamBuffers) &&
+           bo.GetTarget() == BufferObject::kArrayBuffer &&
+           bo.GetUsageMode() == BufferObject::kStreamDraw &&
+           gm->IsFunctionGroupAvailable(GraphicsManager::kBufferStorage) &&
+           gm->IsFunctionGroupAvailable(GraphicsManager::kMapBufferRange) &&
+           gm->IsFunctionGroupAvailable(GraphicsManager::kSync);
+  }
+
+  // Returns the fences marking the frames that used persistently mapped
+  // buffer storage.
+  FrameFenceQueue* GetFrameFenceQueue() { return &frame_fences_; }
+
+  // Returns the cache that generates and deletes buffer and texture names.
+  ObjectNameCache* GetObjectNameCache() { return &object_names_; }
+
+  // Returns the active uniforms of linked programs.
+  UniformLayoutCache* GetUniformLayoutCache() { return &uniform_layouts_; }
+
+  // Returns the vertex arrays shared by AttributeArrays.
+  SharedVertexArrayCache* GetSharedVertexArrayCache() {
+    return &shared_vertex_arrays_;
+  }
+
+  // Returns the sampler objects shared by Samplers.
+  SharedSamplerCache* GetSharedSamplerCache() { return &shared_samplers_; }
+
   // Returns a ResourceAccessor for the Resources of the specified type.
   ResourceAccessor AccessResources(ResourceType type) {
     ResourceAccessor accessor(resources_[type]);
@@ -808,6 +2134,96 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
     return memory_usage_[type].value.load();
   }
 
+  // Sets/returns the budget for the GPU memory used by textures and buffer
+  // objects, or 0 if there is no budget.
+  void SetGpuMemoryBudget(size_t budget) { gpu_memory_budget_ = budget; }
+  size_t GetGpuMemoryBudget() const { return gpu_memory_budget_.load(); }
+
+  // Returns the current frame, which Resources record when they are used.
+  uint64 GetFrame() const { return frame_.load(); }
+
+  // Sets/returns the time, in microseconds, that DrawScene() may spend
+  // processing info requests, or 0 if there is no budget.
+  void SetInfoRequestBudget(uint64 budget) { info_request_budget_ = budget; }
+  uint64 GetInfoRequestBudget() const { return info_request_budget_.load(); }
+
+  // Returns the number of info requests that have been received but not yet
+  // processed because the budget ran out.
+  size_t GetPendingInfoRequestCount() const {
+    return pending_info_requests_.size();
+  }
+
+  // Adds to/returns/resets the numbers of uniform values sent to OpenGL and
+  // skipped because they had not changed.
+  void CountUniformValues(size_t sent, size_t skipped) {
+    sent_uniform_count_ += sent;
+    skipped_uniform_count_ += skipped;
+  }
+  size_t GetSentUniformCount() const { return sent_uniform_count_.load(); }
+  size_t GetSkippedUniformCount() const {
+    return skipped_uniform_count_.load();
+  }
+  void ResetUniformCounts() {
+    sent_uniform_count_ = 0U;
+    skipped_uniform_count_ = 0U;
+  }
+
+  // Sets/returns the cache for program binaries, which may be NULL.
+  // Setting a cache also loads the keys of the pipelines stored in it.
+  void SetProgramBinaryCache(const ProgramBinaryCachePtr& cache) {
+    base::LockGuard guard(&program_binary_cache_mutex_);
+    program_binary_cache_ = cache;
+    pipeline_keys_.clear();
+    are_pipeline_keys_stored_ = true;
+    std::vector<uint64> keys;
+    if (cache.Get() && cache->ReadPipelineKeys(&keys))
+      pipeline_keys_.insert(keys.begin(), keys.end());
+    is_recording_pipelines_ = cache.Get() != NULL;
+  }
+  const ProgramBinaryCachePtr GetProgramBinaryCache() {
+    base::LockGuard guard(&program_binary_cache_mutex_);
+    return program_binary_cache_;
+  }
+
+  // Returns whether pipelines that are drawn should be recorded, which is the
+  // case when there is a program binary cache to store them in.
+  bool IsRecordingPipelines() const { return is_recording_pipelines_; }
+  // Records that a pipeline with the passed key was drawn.
+  void RecordPipeline(uint64 key) {
+    base::LockGuard guard(&program_binary_cache_mutex_);
+    if (pipeline_keys_.insert(key).second)
+      are_pipeline_keys_stored_ = false;
+  }
+  // Returns the keys of the pipelines loaded from the cache or recorded since.
+  const std::set<uint64> GetPipelineKeys() {
+    base::LockGuard guard(&program_binary_cache_mutex_);
+    return std::set<uint64>(pipeline_keys_.begin(), pipeline_keys_.end());
+  }
+  // Writes the pipeline keys to the cache if any have been recorded since
+  // they were loaded or last written.
+  void StorePipelineKeys() {
+    base::LockGuard guard(&program_binary_cache_mutex_);
+    if (program_binary_cache_.Get() && !are_pipeline_keys_stored_) {
+      program_binary_cache_->WritePipelineKeys(
+          std::vector<uint64>(pipeline_keys_.begin(), pipeline_keys_.end()));
+      are_pipeline_keys_stored_ = true;
+    }
+  }
+
+  // Counts a lookup of a program binary in the cache, which is a hit if the
+  // binary was found and accepted by OpenGL.
+  void CountProgramBinaryLookup(bool is_hit) {
+    if (is_hit)
+      ++program_binary_hit_count_;
+    else
+      ++program_binary_miss_count_;
+  }
+
+  // Ends the current frame. If textures and buffer objects use more GPU memory
+  // than the budget, this first evicts the least recently used ones that were
+  // not used in the frame until they fit, if possible.
+  void EndFrame(ResourceBinder* resource_binder);
+
   // Disassociates the passed resource from any VertexArrayResources that use
   // it. This is necessary to prevent the binding of an already deleted element
   // array.
@@ -823,11 +2239,61 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
 
   // Marks a resource to release at the next convenient time.
   void MarkForRelease(Resource* resource) {
-    base::LockGuard locker(&release_mutex_);
     DCHECK(resource);
+    RemoveDirtyResource(resource);
+    base::LockGuard locker(&release_mutex_);
     resources_to_release_.push_back(resource);
   }
 
+  // Adds a resource whose holder has changed to the list of resources to
+  // update at the start of the next frame, if kBatchResourceUpdates is set,
+  // the resource is of a type that can be updated outside of drawing, and it
+  // is not already in the list.
+  void MarkDirty(Resource* resource) {
+    if (!flags_.test(kBatchResourceUpdates))
+      return;
+    // Updating buffers and programs binds them, which can change the state
+    // of the bound vertex array, so only objects that Update() binds to an
+    // image unit of their own are batched.
+    const ResourceType type = resource->GetType();
+    if (type != kTexture && type != kSampler)
+      return;
+    base::LockGuard locker(&dirty_mutex_);
+    if (!resource->is_dirty_) {
+      resource->is_dirty_ = true;
+      dirty_resources_.push_back(resource);
+    }
+  }
+
+  // Updates all resources in the list of dirty resources, in the order they
+  // first changed, and empties the list.
+  void UpdateDirtyResources(ResourceBinder* resource_binder) {
+    ResourceVector resources(*this);
+    {
+      base::LockGuard locker(&dirty_mutex_);
+      resources.swap(dirty_resources_);
+      const size_t count = resources.size();
+      for (size_t i = 0; i < count; ++i)
+        resources[i]->is_dirty_ = false;
+    }
+    // A resource changed while this runs is added to the new list, and is
+    // updated again in the next frame if this update missed the change.
+    const size_t count = resources.size();
+    for (size_t i = 0; i < count; ++i)
+      resources[i]->Update(resource_binder);
+  }
+
+  // Removes a resource from the list of dirty resources, if it is there. This
+  // must be called before the resource is deleted.
+  void RemoveDirtyResource(Resource* resource) {
+    base::LockGuard locker(&dirty_mutex_);
+    if (resource->is_dirty_) {
+      resource->is_dirty_ = false;
+      dirty_resources_.erase(std::find(dirty_resources_.begin(),
+                                       dirty_resources_.end(), resource));
+    }
+  }
+
   // Marks a resource to destroy at the next convenient time.
   void DestroyResource(Resource* resource) {
     DCHECK(resource);
@@ -875,10 +2341,12 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
 
   // Releases all resources waiting to be released, then deletes them.
   void ReleaseAll(ResourceBinder* resource_binder) {
+    ReleaseAll(resource_binder, portgfx::Visual::GetCurrent() != nullptr);
+  }
+  void ReleaseAll(ResourceBinder* resource_binder, bool can_make_gl_calls) {
     // This can't be strictly 2-pass because deleting items may cause a resource
     // holder to be ready for release.  Loop until we have no more items to
     // release.
-    const bool can_make_gl_calls = portgfx::Visual::GetCurrent() != nullptr;
     while (true) {
       ResourceVector resources_to_destroy(*this);
       {
@@ -917,6 +2385,19 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
     }
   }
 
+  // Forgets all resources and cached OpenGL objects without deleting them, for
+  // when the OpenGL context that owned them has been lost. The holders of the
+  // resources keep their data, so the resources are recreated when they are
+  // next used.
+  void AbandonAllResources(ResourceBinder* resource_binder) {
+    for (int i = 0; i < kNumResourceTypes; ++i)
+      ReleaseTypedResources(static_cast<ResourceType>(i));
+    ReleaseAll(resource_binder, false);
+    pixel_unpack_buffers_.Release(false, GetGraphicsManager().Get());
+    frame_fences_.Release(false, GetGraphicsManager().Get());
+    object_names_.Release(false, GetGraphicsManager().Get());
+  }
+
   // This should only be called right before this instance is destroyed.
   void DestroyAllResources() {
     const bool can_make_gl_calls = portgfx::Visual::GetCurrent() != nullptr;
@@ -934,39 +2415,48 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
       }
       resources.clear();
     }
+    dirty_resources_.clear();
+    pixel_unpack_buffers_.Release(can_make_gl_calls,
+                                  GetGraphicsManager().Get());
+    frame_fences_.Release(can_make_gl_calls, GetGraphicsManager().Get());
+    object_names_.Release(can_make_gl_calls, GetGraphicsManager().Get());
+    uniform_layouts_.Clear();
     AcquireOrReleaseResourceIndex(true, resource_index_);
   }
 
-  // Process any outstanding requests for data, e.g., PlatformInfo and
-  // TextureImageInfo requests.
-  template <typename T> void ProcessDataRequests()  {
-    base::LockGuard guard(&this->request_mutex_);
-    std::vector<DataRequest<T> >& requests = *GetDataRequestVector<T>();
+  // Moves any outstanding requests for data, e.g., PlatformInfo and
+  // TextureImageInfo requests, to the end of the pending requests.
+  template <typename T> void QueueDataRequests() {
+    std::vector<DataRequest<T> > requests;
+    GetDataRequestQueue<T>()->PopAll(&requests);
     const size_t request_count = requests.size();
-    std::vector<T> infos(1);
-    for (size_t i = 0; i < request_count; ++i) {
-      T info;
-      FillDataFromRenderer(requests[i].id, &info);
-      FillInfoFromOpenGL(&info);
-      infos[0] = info;
-      // Execute the callback.
-      requests[i].callback(infos);
-    }
-    requests.clear();
+    for (size_t i = 0; i < request_count; ++i)
+      pending_info_requests_.push_back(
+          std::bind(&ResourceManager::ProcessDataRequest<T>, this,
+                    requests[i]));
+  }
+
+  // Process a single request for data.
+  template <typename T> void ProcessDataRequest(const DataRequest<T>& request) {
+    T info;
+    FillDataFromRenderer(request.id, &info);
+    FillInfoFromOpenGL(&info);
+    std::vector<T> infos(1, info);
+    // Execute the callback.
+    request.callback(infos);
   }
 
-  // Process any outstanding requests for a particular Resource type.
+  // Moves any outstanding requests for a particular Resource type to the end
+  // of the pending requests.
   template <typename HolderType, typename InfoType>
-  void ProcessInfoRequests(ResourceContainer* resource_container,
-                           ResourceBinder* resource_binder) {
-    base::LockGuard guard(&this->request_mutex_);
-    std::vector<ResourceRequest<HolderType, InfoType> >& requests =
-        *GetResourceRequestVector<HolderType, InfoType>();
+  void QueueInfoRequests(ResourceContainer* resource_container) {
+    std::vector<ResourceRequest<HolderType, InfoType> > requests;
+    GetResourceRequestQueue<HolderType, InfoType>()->PopAll(&requests);
     const size_t request_count = requests.size();
     for (size_t i = 0; i < request_count; ++i)
-      ProcessInfoRequest<HolderType, InfoType>(requests[i], resource_container,
-                                               resource_binder);
-    requests.clear();
+      pending_info_requests_.push_back(std::bind(
+          &ResourceManager::ProcessInfoRequest<HolderType, InfoType>, this,
+          requests[i], resource_container, std::placeholders::_1));
   }
 
   // Process a single request for information about a particular Resource.
@@ -1028,8 +2518,12 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
   template <typename InfoType>
   void FillDataFromRenderer(GLuint id, InfoType* info);
 
-  // Process any outstanding requests for information about Resources.
-  void ProcessResourceInfoRequests(ResourceBinder* resource_binder);
+  // Process any outstanding requests for information about Resources. If
+  // |use_budget| is true and there is an info request budget, requests that
+  // do not fit in it are kept in order for the next call. At least one
+  // request is always processed so that all of them eventually are.
+  void ProcessResourceInfoRequests(ResourceBinder* resource_binder,
+                                   bool use_budget);
 
  private:
   // Wrapper struct for std::atomic<size_t> that is copy-constructable. This
@@ -1077,6 +2571,9 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
       const HolderType* holder, ResourceBinder* binder, ResourceKey key,
       GLuint gl_id);
 
+  // The flags of the owning Renderer.
+  const Flags& flags_;
+
   // The unique index of this.
   size_t resource_index_;
 
@@ -1095,189 +2592,1421 @@ class Renderer::ResourceManager : public gfx::ResourceManager {
   // For locking access to resources_to_release_. This is needed since multiple
   // threads may destroy resources at the same time as holders are destroyed.
   port::Mutex release_mutex_;
+
+  // Resources that have changed since they were last updated, when
+  // kBatchResourceUpdates is set, and the mutex that protects the list and
+  // the is_dirty_ flags of its resources, since holders may change in any
+  // thread.
+  ResourceVector dirty_resources_;
+  port::Mutex dirty_mutex_;
+
+  // Pixel unpack buffers shared by all streamed texture uploads.
+  PixelUnpackBufferRing pixel_unpack_buffers_;
+
+  // Fences for persistently mapped buffer storage.
+  FrameFenceQueue frame_fences_;
+
+  // Batched generation and deletion of buffer and texture names.
+  ObjectNameCache object_names_;
+
+  // The active uniforms of linked programs.
+  UniformLayoutCache uniform_layouts_;
+
+  // Vertex arrays shared by AttributeArrays with identical layouts.
+  SharedVertexArrayCache shared_vertex_arrays_;
+
+  // Sampler objects shared by Samplers with identical state.
+  SharedSamplerCache shared_samplers_;
+
+  // The GPU memory budget and the current frame.
+  std::atomic<size_t> gpu_memory_budget_;
+  std::atomic<uint64> frame_;
+
+  // The info request budget in microseconds, and the requests that have been
+  // received but not processed yet. Each pending request is only accessed
+  // from the thread that processes requests.
+  std::atomic<uint64> info_request_budget_;
+  base::AllocDeque<std::function<void(ResourceBinder*)> >
+      pending_info_requests_;
+
+  // The numbers of uniform values sent and skipped.
+  std::atomic<size_t> sent_uniform_count_;
+  std::atomic<size_t> skipped_uniform_count_;
+
+  // The cache for program binaries and the numbers of hits and misses in it.
+  port::Mutex program_binary_cache_mutex_;
+  ProgramBinaryCachePtr program_binary_cache_;
+  std::atomic<size_t> program_binary_hit_count_;
+  std::atomic<size_t> program_binary_miss_count_;
+
+  // The keys of pipelines loaded from the program binary cache or recorded
+  // since, whether they have all been written to the cache, and whether new
+  // ones are recorded. These are protected by program_binary_cache_mutex_.
+  base::AllocSet<uint64> pipeline_keys_;
+  bool are_pipeline_keys_stored_;
+  std::atomic<bool> is_recording_pipelines_;
 };
 
 //-----------------------------------------------------------------------------
 //
-// The Renderer::ResourceBinder manages the binding state of all OpenGL
-// resources for a particular OpenGL context. Only a single thread should be
-// working with one ResourceBinder at one time.
+// The Renderer::DrawListWorker runs batches of tasks that flatten parts of a
+// scene into draw lists on a WorkerPool. The thread requesting the work also
+// runs tasks until all of them are finished.
 //
 //-----------------------------------------------------------------------------
 
-class Renderer::ResourceBinder : public Allocatable {
+class Renderer::DrawListWorker : public base::WorkerPool::Worker {
  public:
-  typedef base::AllocVector<Uniform> UniformStack;
+  explicit DrawListWorker(size_t thread_count)
+      : thread_count_(thread_count),
+        task_function_(NULL),
+        task_count_(0U),
+        next_task_(0U),
+        remaining_task_count_(0U),
+        pool_(this) {
+    pool_.ResizeThreadPool(thread_count_);
+    pool_.Resume();
+  }
+  ~DrawListWorker() override {
+    pool_.Suspend();
+    pool_.ResizeThreadPool(0U);
+  }
+
+  // Returns the number of worker threads.
+  size_t GetThreadCount() const { return thread_count_; }
+
+  // Calls task_function(i) for each i in [0, count) on the worker threads and
+  // the calling thread, returning once all of the calls have finished.
+  void Run(size_t count, const std::function<void(size_t)>& task_function) {
+    if (!count)
+      return;
+    {
+      base::LockGuard guard(&mutex_);
+      task_function_ = &task_function;
+      task_count_ = count;
+      next_task_ = 0U;
+      remaining_task_count_ = count;
+    }
+    const size_t num_posts = std::min(count, thread_count_);
+    for (size_t i = 0; i < num_posts; ++i)
+      pool_.GetWorkSemaphore()->Post();
+    while (RunNextTask()) {}
+    done_.Wait();
+  }
 
-  // Tracks which buffers have been bound.
-  struct BufferBinding {
-    BufferBinding() : buffer(0U), resource(NULL) {}
-    GLuint buffer;
-    BufferResource* resource;
-  };
+  // WorkerPool::Worker implementation.
+  void DoWork() override {
+    while (RunNextTask()) {}
+  }
+  const std::string& GetName() const override {
+    static const std::string kName("Ion DrawList worker");
+    return kName;
+  }
 
-  // An ImageUnit represents an OpenGL image unit.
-  struct ImageUnit {
-    ImageUnit() : sampler(0U), resource(NULL) {}
-    GLuint sampler;
-    TextureResource* resource;
-  };
+ private:
+  // Runs the next task of the current batch, if any. Returns false if there
+  // are none left to start.
+  bool RunNextTask() {
+    const std::function<void(size_t)>* task_function;
+    size_t index;
+    {
+      base::LockGuard guard(&mutex_);
+      if (next_task_ >= task_count_)
+        return false;
+      task_function = task_function_;
+      index = next_task_++;
+    }
+    (*task_function)(index);
+    base::LockGuard guard(&mutex_);
+    if (--remaining_task_count_ == 0U)
+      done_.Post();
+    return true;
+  }
 
-  // A StreamAnnotator annotates the Renderer's GraphicsManager's tracing stream
-  // output using passed labels to help identify what resources lead to what
-  // OpenGL calls. In production builds it should optimize away to nothing.
-#if ION_PRODUCTION
-  class StreamAnnotator : public base::Allocatable {
-   public:
-    explicit StreamAnnotator(const GraphicsManagerPtr& gm) {}
-    void Push(const std::string& label) {}
-    void Pop() {}
-  };
-#else
-  class StreamAnnotator : public base::Allocatable {
-   public:
-    explicit StreamAnnotator(const GraphicsManagerPtr& gm)
-        : gm_(gm),
-          gl_supports_markers_(
-              gm_->IsFunctionGroupAvailable(GraphicsManager::kDebugMarker)) {}
+  const size_t thread_count_;
+  // The current batch of tasks.
+  const std::function<void(size_t)>* task_function_;
+  size_t task_count_;
+  size_t next_task_;
+  size_t remaining_task_count_;
+  // Protects the batch.
+  port::Mutex mutex_;
+  // Signaled when the last task of a batch finishes.
+  port::Semaphore done_;
+  // This must be last so that its threads stop before anything else is
+  // destroyed.
+  base::WorkerPool pool_;
+};
 
-    // Pushes a label onto the tracing stack and outputs it if the contained
-    // GraphicsManager has a tracing stream.
-    void Push(const std::string& marker) {
-      if (std::ostream* out = gm_->GetTracingStream())
-        *out << std::string(indent_.length(), '-') << ">" << marker << ":\n";
-      indent_ += "  ";
-      gm_->SetTracingPrefix(indent_);
-      if (gl_supports_markers_)
-        gm_->PushGroupMarker(static_cast<GLsizei>(marker.length()),
-                             marker.c_str());
-    }
+//-----------------------------------------------------------------------------
+//
+// The Renderer::UploadWorker creates and updates the resources of queued
+// ResourceHolders on its own thread, with a Visual that shares resources with
+// the Visuals the Renderer draws with. Holders remain pending until OpenGL has
+// finished executing their uploads.
+//
+//-----------------------------------------------------------------------------
 
-    // Pops the last label (if there is one) off of the tracing stack.
-    void Pop() {
-      if (const size_t length = indent_.length()) {
-        if (gl_supports_markers_)
-          gm_->PopGroupMarker();
-        indent_ = indent_.substr(0, length - 2U);
-        gm_->SetTracingPrefix(indent_);
-      }
+class Renderer::UploadWorker : public base::WorkerPool::Worker {
+ public:
+  explicit UploadWorker(Renderer* renderer)
+      : renderer_(renderer),
+        visual_(NULL),
+        queue_(renderer->GetAllocator()),
+        pending_holders_(renderer->GetAllocator()),
+        pending_count_(0U),
+        waiter_count_(0U),
+        pool_(this) {
+    pool_.ResizeThreadPool(1U);
+  }
+  ~UploadWorker() override {
+    pool_.Suspend();
+    pool_.ResizeThreadPool(0U);
+  }
+
+  // Starts or stops uploading queued holders with the passed Visual.
+  void Start(const portgfx::Visual* visual) {
+    DCHECK(visual);
+    if (!pool_.IsSuspended())
+      pool_.Suspend();
+    size_t queue_size;
+    {
+      base::LockGuard guard(&mutex_);
+      visual_ = visual;
+      queue_size = queue_.size();
+    }
+    pool_.Resume();
+    for (size_t i = 0; i < queue_size; ++i)
+      pool_.GetWorkSemaphore()->Post();
+  }
+  void Stop() {
+    if (!pool_.IsSuspended())
+      pool_.Suspend();
+    base::LockGuard guard(&mutex_);
+    visual_ = NULL;
+  }
+  bool IsRunning() const { return !pool_.IsSuspended(); }
+
+  // Queues a holder to be uploaded, unless it is already pending.
+  template <typename T>
+  void Add(T* holder) {
+    {
+      base::LockGuard guard(&mutex_);
+      if (!pending_holders_.insert(holder).second)
+        return;
+      Upload upload;
+      upload.holder = holder;
+      upload.function = UploadHolder<T>;
+      queue_.push_back(upload);
+      ++pending_count_;
     }
+    if (IsRunning())
+      pool_.GetWorkSemaphore()->Post();
+  }
 
-   private:
-    GraphicsManagerPtr gm_;
-    std::string indent_;
-    const bool gl_supports_markers_;
-  };
-#endif
+  // Returns whether any holder, or the passed holder, has an upload pending.
+  bool HasPendingUploads() const { return pending_count_ != 0U; }
+  bool IsPending(const ResourceHolder* holder) const {
+    if (!pending_count_)
+      return false;
+    base::LockGuard guard(&mutex_);
+    return pending_holders_.count(holder) != 0U;
+  }
 
-  class InfoRequestGuard {
-   public:
-    explicit InfoRequestGuard(ResourceBinder* rb)
-      : rb_(rb) {
-      rb_->processing_info_requests_ = true;
-    }
-    ~InfoRequestGuard() {
-      rb_->processing_info_requests_ = false;
+  // Blocks until there are no pending uploads.
+  void Wait() {
+    {
+      base::LockGuard guard(&mutex_);
+      if (!pending_count_)
+        return;
+      ++waiter_count_;
     }
+    idle_.Wait();
+  }
 
-   private:
-    ResourceBinder* rb_;
-  };
-
-  // The constructor is passed a GraphicsManager for updating GL object state.
-  explicit ResourceBinder(const GraphicsManagerPtr& gm)
-      : graphics_manager_(gm),
-        stream_annotator_(new (GetAllocator()) StreamAnnotator(gm)),
-        image_units_(*this),
-        texture_last_bindings_(*this),
-        active_image_unit_(kInvalidGluint),
-        active_framebuffer_(kInvalidGluint),
-        active_framebuffer_resource_(NULL),
-        active_shader_id_(0U),
-        active_shader_resource_(NULL),
-        active_vertex_array_(0U),
-        active_vertex_array_resource_(NULL),
-        current_shader_program_(NULL),
-        vertex_array_keys_(*this),
-        gl_state_table_(new (GetAllocator()) StateTable(0, 0)),
-        client_state_table_(new (GetAllocator()) StateTable(0, 0)),
-        traversal_state_tables_(*this),
-        current_traversal_index_(0U),
-        processing_info_requests_(false) {
-    memset(saved_ids_, 0, sizeof(saved_ids_));
-    saved_state_table_ = new (GetAllocator()) StateTable();
+  // WorkerPool::Worker implementation.
+  void DoWork() override {
+    Upload upload;
+    const portgfx::Visual* visual;
+    {
+      base::LockGuard guard(&mutex_);
+      if (queue_.empty() || !visual_)
+        return;
+      upload = queue_.front();
+      queue_.pop_front();
+      visual = visual_;
+    }
+    if (!visual->IsCurrent())
+      portgfx::Visual::MakeCurrent(visual);
+    upload.function(renderer_, upload.holder.Get());
+
+    // The holder is only ready once OpenGL has finished the upload.
+    GraphicsManager* gm = renderer_->GetGraphicsManager().Get();
+    if (gm->IsFunctionGroupAvailable(GraphicsManager::kSync)) {
+      if (GLsync sync = gm->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)) {
+        // Wait in one second intervals, in nanoseconds.
+        static const GLuint64 kTimeout = 1000000000U;
+        while (gm->ClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  kTimeout) == GL_TIMEOUT_EXPIRED) {}
+        gm->DeleteSync(sync);
+      } else {
+        gm->Finish();
+      }
+    } else {
+      gm->Finish();
+    }
 
-    // Enable program point sizes if the platform needs it.
-    if (gm->GetGlApiStandard() == GraphicsManager::kDesktop) {
-      // Point sprites are always on in OpenGL 3.2+ core profiles.
-      if (gm->GetGlProfileType() != GraphicsManager::kCoreProfile)
-        gm->Enable(GL_POINT_SPRITE);
-      gm->Enable(GL_PROGRAM_POINT_SIZE);
+    base::LockGuard guard(&mutex_);
+    pending_holders_.erase(upload.holder.Get());
+    if (--pending_count_ == 0U) {
+      for (; waiter_count_; --waiter_count_)
+        idle_.Post();
     }
+  }
+  const std::string& GetName() const override {
+    static const std::string kName("Ion upload worker");
+    return kName;
+  }
 
-    // Save the default framebuffer.
-    UpdateDefaultFramebufferFromOpenGL();
+ private:
+  // Creates or updates the resource of a holder of type T.
+  template <typename T>
+  static void UploadHolder(Renderer* renderer, ResourceHolder* holder) {
+    renderer->CreateOrUpdateResource(static_cast<T*>(holder));
+  }
 
-    // Get the number of image units and resize the TextureManager.
-    const int max_image_units = GetGraphicsManager()->GetCapabilityValue<int>(
-        GraphicsManager::kMaxTextureImageUnits);
-    image_units_.resize(max_image_units);
-    texture_manager_.reset(new (GetAllocator())
-                               TextureManager(max_image_units));
-    DCHECK(texture_manager_.get());
+  // A queued holder and the function that uploads it.
+  struct Upload {
+    Upload() : function(NULL) {}
+    base::SharedPtr<ResourceHolder> holder;
+    void (*function)(Renderer* renderer, ResourceHolder* holder);
+  };
 
-    traversal_state_tables_.resize(16);
-    for (size_t i = 0; i < 16U; ++i)
-      traversal_state_tables_[i] = new(GetAllocator()) StateTable;
-  }
+  Renderer* renderer_;
+  const portgfx::Visual* visual_;
+  base::AllocDeque<Upload> queue_;
+  base::AllocUnorderedSet<const ResourceHolder*> pending_holders_;
+  std::atomic<size_t> pending_count_;
+  // The number of threads blocked in Wait(), and the semaphore they wait on.
+  size_t waiter_count_;
+  port::Semaphore idle_;
+  // Protects everything above except pending_count_.
+  mutable port::Mutex mutex_;
+  // This must be last so that its thread stops before anything else is
+  // destroyed.
+  base::WorkerPool pool_;
+};
 
-  ~ResourceBinder() override {}
+//-----------------------------------------------------------------------------
+//
+// The Renderer::TransientFramebufferPool holds the FramebufferObjects returned
+// by Renderer::AcquireTransientFramebuffer(). Each one is reserved from the
+// time it is acquired until the pool is recycled, after which it can be
+// acquired again by a request with the same formats, size, and samples.
+//
+//-----------------------------------------------------------------------------
 
-  // Saves the currently bound GL framebuffer as the default framebuffer.
-  void UpdateDefaultFramebufferFromOpenGL() {
-    GetGraphicsManager()->GetIntegerv(GL_FRAMEBUFFER_BINDING,
-                                      GetSavedId(Renderer::kSaveFramebuffer));
+class Renderer::TransientFramebufferPool : public Allocatable {
+ public:
+  TransientFramebufferPool() : entries_(*this) {}
+
+  // Reserves and returns a free framebuffer matching the passed description,
+  // creating one if there is none.
+  const FramebufferObjectPtr Acquire(uint32 width, uint32 height,
+                                     Image::Format color_format,
+                                     Image::Format depth_format,
+                                     size_t samples) {
+    const size_t count = entries_.size();
+    for (size_t i = 0; i < count; ++i) {
+      Entry& entry = entries_[i];
+      if (!entry.is_acquired && entry.fbo->GetWidth() == width &&
+          entry.fbo->GetHeight() == height &&
+          entry.color_format == color_format &&
+          entry.depth_format == depth_format && entry.samples == samples) {
+        entry.is_acquired = true;
+        entry.is_bound = false;
+        return entry.fbo;
+      }
+    }
+
+    Entry entry;
+    entry.fbo = new (GetAllocator()) FramebufferObject(width, height);
+    entry.color_format = color_format;
+    entry.depth_format = depth_format;
+    entry.samples = samples;
+    entry.is_acquired = true;
+    // A new framebuffer has no contents to invalidate.
+    entry.is_bound = true;
+    if (samples) {
+      entry.fbo->SetColorAttachment(
+          0U, FramebufferObject::Attachment(color_format, samples));
+    } else {
+      ImagePtr image(new (GetAllocator()) Image);
+      image->Set(color_format, width, height, DataContainerPtr());
+      SamplerPtr sampler(new (GetAllocator()) Sampler);
+      sampler->SetMinFilter(Sampler::kLinear);
+      sampler->SetMagFilter(Sampler::kLinear);
+      sampler->SetWrapS(Sampler::kClampToEdge);
+      sampler->SetWrapT(Sampler::kClampToEdge);
+      TexturePtr texture(new (GetAllocator()) Texture);
+      texture->SetImage(0U, image);
+      texture->SetSampler(sampler);
+      entry.fbo->SetColorAttachment(0U, FramebufferObject::Attachment(texture));
+    }
+    if (depth_format != Image::kInvalid) {
+      entry.fbo->SetDepthAttachment(
+          FramebufferObject::Attachment(depth_format, samples));
+    }
+    entries_.push_back(entry);
+    return entry.fbo;
+  }
+
+  // Returns whether the passed framebuffer is reserved but has not been bound
+  // since it was acquired, and marks it as bound.
+  bool MarkBound(const FramebufferObject* fbo) {
+    const size_t count = entries_.size();
+    for (size_t i = 0; i < count; ++i) {
+      if (entries_[i].fbo.Get() == fbo) {
+        const bool was_bound = entries_[i].is_bound;
+        entries_[i].is_bound = true;
+        return !was_bound;
+      }
+    }
+    return false;
   }
 
-  // Returns the GraphicsManager used for the instance.
-  const GraphicsManagerPtr& GetGraphicsManager() const {
-    return graphics_manager_;
+  // Frees all reserved framebuffers, and destroys those that were not
+  // reserved since the last call.
+  void Recycle() {
+    size_t kept = 0;
+    const size_t count = entries_.size();
+    for (size_t i = 0; i < count; ++i) {
+      if (entries_[i].is_acquired) {
+        entries_[i].is_acquired = false;
+        entries_[kept++] = entries_[i];
+      }
+    }
+    entries_.resize(kept, Entry());
   }
 
-  // Returns the TextureManager that manages image units for the passed texture
-  // target.
-  TextureManager* GetTextureManager() const { return texture_manager_.get(); }
+  size_t GetCount() const { return entries_.size(); }
 
-  // Gets/sets the current ResourceManager, which must remain valid as long as
-  // this is operating on its resources.
-  ResourceManager* GetResourceManager() const { return resource_manager_; }
-  void SetResourceManager(ResourceManager* manager) {
-    resource_manager_ = manager;
-  }
+ private:
+  struct Entry {
+    Entry()
+        : color_format(Image::kInvalid),
+          depth_format(Image::kInvalid),
+          samples(0U),
+          is_acquired(false),
+          is_bound(false) {}
+    FramebufferObjectPtr fbo;
+    Image::Format color_format;
+    Image::Format depth_format;
+    size_t samples;
+    // Whether the framebuffer is reserved until the next call to Recycle().
+    bool is_acquired;
+    // Whether the framebuffer has been bound since it was acquired.
+    bool is_bound;
+  };
 
-  // Returns the stream annotator for debug tracing.
-  StreamAnnotator* GetStreamAnnotator() const {
-    return stream_annotator_.get();
-  }
+  base::AllocVector<Entry> entries_;
+};
 
-  // Returns the last bound FramebufferObject.
-  const FramebufferObjectPtr GetCurrentFramebuffer() const {
-    return current_fbo_.Acquire();
-  }
+//-----------------------------------------------------------------------------
+//
+// The Renderer::ImageReadbackQueue holds the reads started by
+// Renderer::ReadImageAsync(). Each read copies pixels into a pixel pack buffer
+// and is followed by a fence; the buffer is only mapped once the fence has
+// signaled, so that reading never stalls the pipeline. Buffers are reused by
+// later reads.
+//
+//-----------------------------------------------------------------------------
 
-  // Stores a weak reference to the currently bound FramebufferObject.
-  void SetCurrentFramebuffer(const FramebufferObjectPtr& fbo) {
-    current_fbo_ = base::WeakReferentPtr<FramebufferObject>(fbo);
+class Renderer::ImageReadbackQueue : public Allocatable {
+ public:
+  ImageReadbackQueue() : pending_(*this), free_buffers_(*this) {}
+
+  // Returns whether OpenGL supports reading pixels asynchronously.
+  static bool IsSupported(GraphicsManager* gm) {
+    return gm->IsFunctionGroupAvailable(GraphicsManager::kMapBufferRange) &&
+           gm->IsFunctionGroupAvailable(GraphicsManager::kSync) &&
+           (gm->GetGlApiStandard() != GraphicsManager::kEs ||
+            gm->GetGlVersion() >= 30);
+  }
+
+  // Starts reading the passed range of the bound framebuffer into a pixel
+  // pack buffer. Returns false if no buffer could be created.
+  bool Start(const ImageReadbackPtr& readback, const math::Range2i& range,
+             Image::Format format, const base::AllocatorPtr& allocator,
+             GraphicsManager* gm) {
+    const int width = range.GetSize()[0];
+    const int height = range.GetSize()[1];
+    const size_t data_size = Image::ComputeDataSize(format, width, height);
+
+    Read read;
+    read.buffer = AcquireBuffer(data_size, gm);
+    if (!read.buffer.id)
+      return false;
+    read.readback = readback;
+    read.allocator = allocator;
+    read.format = format;
+    read.width = width;
+    read.height = height;
+
+    const Image::PixelFormat pf =
+        GetCompatiblePixelFormat(Image::GetPixelFormat(format), gm);
+    gm->BindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer.id);
+    gm->PixelStorei(GL_PACK_ALIGNMENT, 1);
+    // The data pointer is an offset into the bound pack buffer.
+    gm->ReadPixels(range.GetMinPoint()[0], range.GetMinPoint()[1], width,
+                   height, pf.format, pf.type, NULL);
+    gm->BindBuffer(GL_PIXEL_PACK_BUFFER, 0U);
+    read.sync = gm->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pending_.push_back(read);
+    return true;
   }
 
-  // Returns the currently active shader program resource.
-  ShaderProgramResource* GetActiveShaderProgram() const {
-    return active_shader_resource_;
+  // Delivers the images of reads whose fences have signaled, or of all reads
+  // if wait is true. Reads finish in order, so this stops at the first one
+  // that has not.
+  void Process(bool wait, GraphicsManager* gm) {
+    // Wait in one second intervals, in nanoseconds.
+    static const GLuint64 kTimeout = 1000000000U;
+    while (!pending_.empty()) {
+      Read& read = pending_.front();
+      if (read.sync) {
+        GLenum status;
+        do {
+          status = gm->ClientWaitSync(read.sync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                      wait ? kTimeout : 0U);
+        } while (wait && status == GL_TIMEOUT_EXPIRED);
+        if (status == GL_TIMEOUT_EXPIRED)
+          break;
+        gm->DeleteSync(read.sync);
+      }
+      Deliver(read, gm);
+      free_buffers_.push_back(read.buffer);
+      pending_.pop_front();
+    }
   }
 
-  // Returns the currently active framebuffer resource.
-  FramebufferResource* GetActiveFramebuffer() const {
-    return active_framebuffer_resource_;
+  // Deletes all buffers and fences. Pending reads are never delivered.
+  void Release(bool can_make_gl_calls, GraphicsManager* gm) {
+    if (can_make_gl_calls) {
+      for (size_t i = 0; i < pending_.size(); ++i) {
+        gm->DeleteSync(pending_[i].sync);
+        gm->DeleteBuffers(1, &pending_[i].buffer.id);
+      }
+      for (size_t i = 0; i < free_buffers_.size(); ++i)
+        gm->DeleteBuffers(1, &free_buffers_[i].id);
+    }
+    pending_.clear();
+    free_buffers_.clear();
+  }
+
+ private:
+  struct Buffer {
+    GLuint id;
+    size_t size;
+  };
+
+  struct Read {
+    Read() : sync(NULL), format(Image::kInvalid), width(0), height(0) {
+      buffer.id = 0U;
+      buffer.size = 0U;
+    }
+    ImageReadbackPtr readback;
+    base::AllocatorPtr allocator;
+    Buffer buffer;
+    GLsync sync;
+    Image::Format format;
+    int width;
+    int height;
+  };
+
+  // Returns a free buffer with room for size bytes. If there is none then a
+  // free buffer is grown, or a new one is created if there are no free ones.
+  Buffer AcquireBuffer(size_t size, GraphicsManager* gm) {
+    Buffer buffer;
+    buffer.id = 0U;
+    buffer.size = 0U;
+    const size_t count = free_buffers_.size();
+    size_t index = 0;
+    while (index < count && free_buffers_[index].size < size)
+      ++index;
+    if (index == count && count)
+      index = count - 1U;
+    if (index < count) {
+      buffer = free_buffers_[index];
+      free_buffers_.erase(free_buffers_.begin() + index);
+    } else {
+      gm->GenBuffers(1, &buffer.id);
+    }
+    if (buffer.id && buffer.size < size) {
+      gm->BindBuffer(GL_PIXEL_PACK_BUFFER, buffer.id);
+      gm->BufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size),
+                     NULL, GL_STREAM_READ);
+      gm->BindBuffer(GL_PIXEL_PACK_BUFFER, 0U);
+      buffer.size = size;
+    }
+    return buffer;
+  }
+
+  // Copies the pixels of a finished read into a new Image and delivers it.
+  static void Deliver(const Read& read, GraphicsManager* gm) {
+    ImagePtr image(new (read.allocator) Image());
+    const size_t data_size =
+        Image::ComputeDataSize(read.format, read.width, read.height);
+    DataContainerPtr data = DataContainer::CreateOverAllocated<uint8>(
+        data_size, NULL, image->GetAllocator());
+    uint8* pixels = data->GetMutableData<uint8>();
+    gm->BindBuffer(GL_PIXEL_PACK_BUFFER, read.buffer.id);
+    if (const void* mapped = gm->MapBufferRange(
+            GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(data_size),
+            GL_MAP_READ_BIT)) {
+      memcpy(pixels, mapped, data_size);
+      gm->UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+      LOG(WARNING) << "***ION: Unable to map pixel pack buffer, the read "
+                      "image will be empty.";
+      memset(pixels, 0, data_size);
+    }
+    gm->BindBuffer(GL_PIXEL_PACK_BUFFER, 0U);
+    image->Set(read.format, read.width, read.height, data);
+    read.readback->SetImage(image);
+  }
+
+  base::AllocDeque<Read> pending_;
+  base::AllocVector<Buffer> free_buffers_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// The Renderer::NodeGpuTimer measures the GPU time spent drawing labeled Nodes
+// when kProfileLabeledNodeGpuTime is set. A timestamp query is written before
+// and after drawing each labeled Node and its subtree. Queries finish in order,
+// so the queries of a frame are only read once the last one is available,
+// which never stalls the pipeline. Query objects are reused by later frames.
+//
+//-----------------------------------------------------------------------------
+
+class Renderer::NodeGpuTimer : public Allocatable {
+ public:
+  explicit NodeGpuTimer(GraphicsManager* gm)
+      : pending_(*this),
+        free_queries_(*this),
+        open_scopes_(*this),
+        has_disjoint_status_(gm->IsExtensionSupported("disjoint_timer_query")),
+        frame_count_(0U),
+        is_measuring_(false) {}
+
+  // Returns whether OpenGL supports timestamp queries.
+  static bool IsSupported(GraphicsManager* gm) {
+    return gm->IsExtensionSupported("disjoint_timer_query") ||
+           gm->IsExtensionSupported("timer_query");
+  }
+
+  // Delivers the times of the pending frames whose queries have finished to
+  // times and callback, then starts measuring a new frame unless too many are
+  // still pending. Returns whether the new frame is measured.
+  bool BeginFrame(NodeGpuTimes* times, const NodeGpuTimesCallback& callback,
+                  GraphicsManager* gm) {
+    DCHECK(!is_measuring_);
+    Process(times, callback, gm);
+    ++frame_count_;
+    if (pending_.size() >= kMaxPendingFrames)
+      return false;
+    pending_.push_back(Frame(GetAllocator()));
+    pending_.back().number = frame_count_;
+    is_measuring_ = true;
+    return true;
+  }
+
+  // Ends the frame started by a successful BeginFrame().
+  void EndFrame() {
+    DCHECK(is_measuring_);
+    DCHECK(open_scopes_.empty());
+    is_measuring_ = false;
+  }
+
+  // Writes the timestamp at which drawing a Node with the passed label starts.
+  void EnterNode(const std::string& label, GraphicsManager* gm) {
+    DCHECK(is_measuring_);
+    Frame& frame = pending_.back();
+    TimedScope scope;
+    scope.times.path = open_scopes_.empty()
+        ? label
+        : frame.scopes[open_scopes_.back()].times.path + "/" + label;
+    scope.times.depth = open_scopes_.size();
+    scope.begin_query = WriteTimestamp(&frame, gm);
+    open_scopes_.push_back(frame.scopes.size());
+    frame.scopes.push_back(scope);
+  }
+
+  // Writes the timestamp at which drawing the Node passed to the matching
+  // EnterNode() and its subtree ends.
+  void LeaveNode(GraphicsManager* gm) {
+    DCHECK(!open_scopes_.empty());
+    Frame& frame = pending_.back();
+    frame.scopes[open_scopes_.back()].end_query = WriteTimestamp(&frame, gm);
+    open_scopes_.pop_back();
+  }
+
+  // Deletes all queries. Pending times are never delivered.
+  void Release(bool can_make_gl_calls, GraphicsManager* gm) {
+    if (can_make_gl_calls) {
+      for (size_t i = 0; i < pending_.size(); ++i)
+        RecycleQueries(&pending_[i]);
+      if (!free_queries_.empty()) {
+        gm->DeleteQueries(static_cast<GLsizei>(free_queries_.size()),
+                          &free_queries_[0]);
+      }
+    }
+    pending_.clear();
+    free_queries_.clear();
+    open_scopes_.clear();
+    is_measuring_ = false;
+  }
+
+ private:
+  // Frames are double-buffered, so that OpenGL has a frame's worth of time to
+  // finish the queries of the previous one.
+  static const size_t kMaxPendingFrames = 2U;
+
+  struct TimedScope {
+    TimedScope() : begin_query(0U), end_query(0U) {}
+    NodeGpuTimes::Scope times;
+    GLuint begin_query;
+    GLuint end_query;
+  };
+
+  struct Frame {
+    explicit Frame(const base::AllocatorPtr& allocator)
+        : number(0U), last_query(0U), scopes(allocator) {}
+    uint64 number;
+    // The query written last, which finishes after all the others.
+    GLuint last_query;
+    base::AllocVector<TimedScope> scopes;
+  };
+
+  // Writes a timestamp into a free query, returning it, or 0 if no query
+  // could be created.
+  GLuint WriteTimestamp(Frame* frame, GraphicsManager* gm) {
+    GLuint query = 0U;
+    if (free_queries_.empty()) {
+      gm->GenQueries(1, &query);
+    } else {
+      query = free_queries_.back();
+      free_queries_.pop_back();
+    }
+    if (query) {
+      gm->QueryCounter(query, GL_TIMESTAMP_EXT);
+      frame->last_query = query;
+    }
+    return query;
+  }
+
+  // Returns the timestamp written into query, which must have finished.
+  static uint64 ReadTimestamp(GLuint query, GraphicsManager* gm) {
+    GLuint64 timestamp = 0U;
+    if (query)
+      gm->GetQueryObjectui64v(query, GL_QUERY_RESULT_EXT, &timestamp);
+    return static_cast<uint64>(timestamp);
+  }
+
+  // Makes the queries of frame available to later frames.
+  void RecycleQueries(Frame* frame) {
+    const size_t count = frame->scopes.size();
+    for (size_t i = 0; i < count; ++i) {
+      if (frame->scopes[i].begin_query)
+        free_queries_.push_back(frame->scopes[i].begin_query);
+      if (frame->scopes[i].end_query)
+        free_queries_.push_back(frame->scopes[i].end_query);
+    }
+    frame->scopes.clear();
+  }
+
+  // Delivers the times of the pending frames whose queries have finished.
+  void Process(NodeGpuTimes* times, const NodeGpuTimesCallback& callback,
+               GraphicsManager* gm) {
+    while (!pending_.empty()) {
+      Frame& frame = pending_.front();
+      if (frame.last_query) {
+        GLint available = 0;
+        gm->GetQueryObjectiv(frame.last_query, GL_QUERY_RESULT_AVAILABLE_EXT,
+                             &available);
+        if (!available)
+          break;
+      }
+
+      // A disjoint event, such as the GPU changing its frequency, makes the
+      // timestamps meaningless.
+      GLint disjoint = 0;
+      if (has_disjoint_status_)
+        gm->GetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+      if (disjoint) {
+        LOG(WARNING) << "***ION: Skipping disjoint GPU times of labeled Nodes";
+      } else {
+        NodeGpuTimes frame_times;
+        frame_times.frame = frame.number;
+        const size_t count = frame.scopes.size();
+        frame_times.scopes.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+          TimedScope& scope = frame.scopes[i];
+          scope.times.begin_ns = ReadTimestamp(scope.begin_query, gm);
+          scope.times.end_ns =
+              std::max(scope.times.begin_ns,
+                       ReadTimestamp(scope.end_query, gm));
+          frame_times.total_ns[scope.times.path] +=
+              scope.times.end_ns - scope.times.begin_ns;
+          frame_times.scopes.push_back(scope.times);
+        }
+        *times = frame_times;
+        if (callback)
+          callback(*times);
+      }
+      RecycleQueries(&frame);
+      pending_.pop_front();
+    }
+  }
+
+  base::AllocDeque<Frame> pending_;
+  base::AllocVector<GLuint> free_queries_;
+  // The indices of the scopes of the frame being measured that have been
+  // entered but not left.
+  base::AllocVector<size_t> open_scopes_;
+  // Whether OpenGL reports disjoint timer events.
+  const bool has_disjoint_status_;
+  uint64 frame_count_;
+  bool is_measuring_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// The Renderer::NodeCpuTimer measures the CPU time spent drawing labeled Nodes
+// when kProfileLabeledNodeCpuTime is set, and counts the work done for them.
+// The ResourceBinder reports the work as it is done; each scope stores the
+// totals when it is entered and subtracts them from those when it is left.
+//
+//-----------------------------------------------------------------------------
+
+class Renderer::NodeCpuTimer : public Allocatable {
+ public:
+  NodeCpuTimer() : scopes_(*this), open_scopes_(*this), frame_count_(0U) {}
+
+  // Starts measuring a new frame.
+  void BeginFrame() {
+    DCHECK(open_scopes_.empty());
+    ++frame_count_;
+    scopes_.clear();
+    counts_ = NodeCpuTimes::Counts();
+  }
+
+  // Delivers the times of the frame started by BeginFrame() to times and
+  // callback.
+  void EndFrame(NodeCpuTimes* times, const NodeCpuTimesCallback& callback) {
+    DCHECK(open_scopes_.empty());
+    NodeCpuTimes frame_times;
+    frame_times.frame = frame_count_;
+    frame_times.scopes.assign(scopes_.begin(), scopes_.end());
+    for (size_t i = 0; i < scopes_.size(); ++i) {
+      const NodeCpuTimes::Scope& scope = scopes_[i];
+      frame_times.total_ns[scope.path] += scope.end_ns - scope.begin_ns;
+      frame_times.total_counts[scope.path] += scope.counts;
+    }
+    *times = frame_times;
+    if (callback)
+      callback(*times);
+  }
+
+  // Records the time at which drawing a Node with the passed label starts.
+  void EnterNode(const std::string& label) {
+    NodeCpuTimes::Scope scope;
+    scope.path = open_scopes_.empty()
+        ? label
+        : scopes_[open_scopes_.back()].path + "/" + label;
+    scope.depth = open_scopes_.size();
+    // The counts of an open scope hold the totals when it was entered.
+    scope.counts = counts_;
+    open_scopes_.push_back(scopes_.size());
+    scopes_.push_back(scope);
+    scopes_.back().begin_ns = GetTimeInNs();
+  }
+
+  // Records the time at which drawing the Node passed to the matching
+  // EnterNode() and its subtree ends.
+  void LeaveNode() {
+    const uint64 end_ns = GetTimeInNs();
+    DCHECK(!open_scopes_.empty());
+    NodeCpuTimes::Scope& scope = scopes_[open_scopes_.back()];
+    scope.end_ns = end_ns;
+    NodeCpuTimes::Counts& counts = scope.counts;
+    counts.uniforms = counts_.uniforms - counts.uniforms;
+    counts.state_changes = counts_.state_changes - counts.state_changes;
+    counts.draws = counts_.draws - counts.draws;
+    counts.resource_updates =
+        counts_.resource_updates - counts.resource_updates;
+    open_scopes_.pop_back();
+  }
+
+  // Counts work done while drawing.
+  void CountUniforms(size_t count) { counts_.uniforms += count; }
+  void CountStateChange() { ++counts_.state_changes; }
+  void CountDraw() { ++counts_.draws; }
+  void CountResourceUpdate() { ++counts_.resource_updates; }
+
+ private:
+  static uint64 GetTimeInNs() {
+    return static_cast<uint64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            port::Timer::Clock::now().time_since_epoch()).count());
+  }
+
+  base::AllocVector<NodeCpuTimes::Scope> scopes_;
+  // The indices of the scopes that have been entered but not left.
+  base::AllocVector<size_t> open_scopes_;
+  // The work done since the frame began.
+  NodeCpuTimes::Counts counts_;
+  uint64 frame_count_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// The Renderer::QueryQueue measures the Queries started by
+// Renderer::BeginQuery() and by Nodes with occlusion queries. Results are only
+// read once OpenGL reports that they are available, which never stalls the
+// pipeline. OpenGL fixes the target of a query object when it is first used,
+// so query objects are reused by later Queries of the same type.
+//
+//-----------------------------------------------------------------------------
+
+class Renderer::QueryQueue : public Allocatable {
+ public:
+  explicit QueryQueue(GraphicsManager* gm)
+      : pending_(*this),
+        conditional_id_(0U),
+        conditional_type_(Query::kAnySamplesPassed),
+        is_conditional_id_free_(false) {
+    for (int i = 0; i < Query::kNumTypes; ++i)
+      is_supported_[i] = IsSupported(static_cast<Query::Type>(i), gm);
+  }
+
+  // Returns whether OpenGL supports queries of the passed type.
+  static bool IsSupported(Query::Type type, GraphicsManager* gm) {
+    const GraphicsManager::GlApi api = gm->GetGlApiStandard();
+    const GLuint version = gm->GetGlVersion();
+    switch (type) {
+      case Query::kAnySamplesPassed:
+      case Query::kAnySamplesPassedConservative:
+        return (api == GraphicsManager::kDesktop && version >= 33) ||
+               (api == GraphicsManager::kEs && version >= 30) ||
+               (api == GraphicsManager::kWeb && version >= 20) ||
+               gm->IsExtensionSupported("occlusion_query_boolean");
+      case Query::kSamplesPassed:
+        return api == GraphicsManager::kDesktop;
+      case Query::kPrimitivesGenerated:
+        return (api == GraphicsManager::kDesktop && version >= 30) ||
+               (api == GraphicsManager::kEs && version >= 32);
+      case Query::kTimeElapsed:
+        return gm->IsExtensionSupported("disjoint_timer_query") ||
+               gm->IsExtensionSupported("timer_query");
+    }
+    return false;
+  }
+
+  // Returns whether queries of the passed type are supported, as computed
+  // when the QueryQueue was created.
+  bool IsSupported(Query::Type type) const { return is_supported_[type]; }
+
+  // Returns the Query of the passed type being measured, if any.
+  const QueryPtr& GetActive(Query::Type type) const {
+    return active_[type].query;
+  }
+
+  // Starts measuring query, which must not be pending, and whose type must
+  // be supported and not active. Returns false if no query object could be
+  // created.
+  bool Begin(const QueryPtr& query, GraphicsManager* gm) {
+    const Query::Type type = query->GetType();
+    DCHECK(!query->IsPending());
+    DCHECK(!active_[type].query.Get());
+    std::vector<GLuint>& free_ids = free_ids_[type];
+    GLuint id = 0U;
+    if (free_ids.empty()) {
+      gm->GenQueries(1, &id);
+    } else {
+      id = free_ids.back();
+      free_ids.pop_back();
+    }
+    if (!id)
+      return false;
+    gm->BeginQuery(GetTarget(type), id);
+    active_[type].query = query;
+    active_[type].id = id;
+    query->SetPending();
+    return true;
+  }
+
+  // Stops measuring the active Query of the passed type, whose result then
+  // becomes pending.
+  void End(Query::Type type, GraphicsManager* gm) {
+    DCHECK(active_[type].query.Get());
+    gm->EndQuery(GetTarget(type));
+    pending_.push_back(active_[type]);
+    active_[type] = Entry();
+  }
+
+  // Starts conditional rendering on the result of query, if it has ended but
+  // its result has not been delivered yet. Returns false if it has not.
+  bool BeginConditionalRender(const QueryPtr& query, bool wait,
+                              GraphicsManager* gm) {
+    DCHECK(!conditional_id_);
+    const size_t count = pending_.size();
+    for (size_t i = 0; i < count; ++i) {
+      if (pending_[i].query.Get() == query.Get()) {
+        conditional_id_ = pending_[i].id;
+        conditional_type_ = query->GetType();
+        gm->BeginConditionalRender(conditional_id_,
+                                   wait ? GL_QUERY_WAIT : GL_QUERY_NO_WAIT);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Returns whether conditional rendering is active.
+  bool IsConditionalRenderActive() const { return conditional_id_ != 0U; }
+
+  // Stops conditional rendering, which must be active.
+  void EndConditionalRender(GraphicsManager* gm) {
+    DCHECK(conditional_id_);
+    gm->EndConditionalRender();
+    if (is_conditional_id_free_)
+      free_ids_[conditional_type_].push_back(conditional_id_);
+    conditional_id_ = 0U;
+    is_conditional_id_free_ = false;
+  }
+
+  // Delivers the results of the pending Queries that OpenGL has finished, or
+  // of all of them if wait is true.
+  void Process(bool wait, GraphicsManager* gm) {
+    size_t kept = 0U;
+    const size_t count = pending_.size();
+    for (size_t i = 0; i < count; ++i) {
+      Entry& entry = pending_[i];
+      GLuint available = 0U;
+      if (!wait)
+        gm->GetQueryObjectuiv(entry.id, GL_QUERY_RESULT_AVAILABLE_EXT,
+                              &available);
+      if (!wait && !available) {
+        pending_[kept++] = entry;
+        continue;
+      }
+      const Query::Type type = entry.query->GetType();
+      uint64 result = 0U;
+      if (type == Query::kTimeElapsed) {
+        GLuint64 time = 0U;
+        gm->GetQueryObjectui64v(entry.id, GL_QUERY_RESULT_EXT, &time);
+        result = static_cast<uint64>(time);
+      } else {
+        GLuint value = 0U;
+        gm->GetQueryObjectuiv(entry.id, GL_QUERY_RESULT_EXT, &value);
+        result = static_cast<uint64>(value);
+      }
+      entry.query->SetResult(result);
+      // The query object used by conditional rendering cannot be reused until
+      // it ends.
+      if (entry.id == conditional_id_) {
+        is_conditional_id_free_ = true;
+      } else {
+        free_ids_[type].push_back(entry.id);
+      }
+    }
+    pending_.resize(kept);
+  }
+
+  // Deletes all query objects. Pending results are never delivered.
+  void Release(bool can_make_gl_calls, GraphicsManager* gm) {
+    if (conditional_id_) {
+      if (can_make_gl_calls)
+        gm->EndConditionalRender();
+      if (is_conditional_id_free_)
+        free_ids_[conditional_type_].push_back(conditional_id_);
+      conditional_id_ = 0U;
+      is_conditional_id_free_ = false;
+    }
+    for (int i = 0; i < Query::kNumTypes; ++i) {
+      if (active_[i].query.Get()) {
+        if (can_make_gl_calls)
+          gm->EndQuery(GetTarget(static_cast<Query::Type>(i)));
+        pending_.push_back(active_[i]);
+        active_[i] = Entry();
+      }
+    }
+    for (size_t i = 0; i < pending_.size(); ++i) {
+      pending_[i].query->ClearPending();
+      free_ids_[pending_[i].query->GetType()].push_back(pending_[i].id);
+    }
+    pending_.clear();
+    for (int i = 0; i < Query::kNumTypes; ++i) {
+      if (can_make_gl_calls && !free_ids_[i].empty()) {
+        gm->DeleteQueries(static_cast<GLsizei>(free_ids_[i].size()),
+                          &free_ids_[i][0]);
+      }
+      free_ids_[i].clear();
+    }
+  }
+
+ private:
+  struct Entry {
+    Entry() : id(0U) {}
+    QueryPtr query;
+    GLuint id;
+  };
+
+  // Returns the OpenGL target of queries of the passed type.
+  static GLenum GetTarget(Query::Type type) {
+    static const GLenum kTargets[Query::kNumTypes] = {
+        GL_ANY_SAMPLES_PASSED, GL_ANY_SAMPLES_PASSED_CONSERVATIVE,
+        GL_SAMPLES_PASSED, GL_PRIMITIVES_GENERATED, GL_TIME_ELAPSED_EXT};
+    return kTargets[type];
+  }
+
+  bool is_supported_[Query::kNumTypes];
+  Entry active_[Query::kNumTypes];
+  base::AllocVector<Entry> pending_;
+  std::vector<GLuint> free_ids_[Query::kNumTypes];
+  // The query object used by conditional rendering, if it is active, its
+  // type, and whether its result has been delivered.
+  GLuint conditional_id_;
+  Query::Type conditional_type_;
+  bool is_conditional_id_free_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// The Renderer::ResourceBinder manages the binding state of all OpenGL
+// resources for a particular OpenGL context. Only a single thread should be
+// working with one ResourceBinder at one time.
+//
+//-----------------------------------------------------------------------------
+
+class Renderer::ResourceBinder : public Allocatable {
+ public:
+  typedef base::AllocVector<Uniform> UniformStack;
+
+  // The sizes of the uniform stack and of the used temporary Uniforms before
+  // the Uniforms of a Node were pushed.
+  struct UniformStackMark {
+    UniformStackMark() : stack_size(0U), temp_count(0U) {}
+    size_t stack_size;
+    size_t temp_count;
+  };
+
+  // Tracks which buffers have been bound.
+  struct BufferBinding {
+    BufferBinding() : buffer(0U), resource(NULL) {}
+    GLuint buffer;
+    BufferResource* resource;
+  };
+
+  // The range of a buffer bound to an indexed uniform buffer binding point.
+  struct UniformBufferBinding {
+    UniformBufferBinding() : buffer(0U), size(0) {}
+    GLuint buffer;
+    GLsizeiptr size;
+  };
+
+  // An ImageUnit represents an OpenGL image unit.
+  struct ImageUnit {
+    ImageUnit() : sampler(0U), resource(NULL) {}
+    GLuint sampler;
+    TextureResource* resource;
+  };
+
+  // A StreamAnnotator annotates the Renderer's GraphicsManager's tracing stream
+  // output using passed labels to help identify what resources lead to what
+  // OpenGL calls. In production builds it should optimize away to nothing.
+#if ION_PRODUCTION
+  class StreamAnnotator : public base::Allocatable {
+   public:
+    explicit StreamAnnotator(const GraphicsManagerPtr& gm) {}
+    void Push(const std::string& label) {}
+    void Pop() {}
+  };
+#else
+  class StreamAnnotator : public base::Allocatable {
+   public:
+    explicit StreamAnnotator(const GraphicsManagerPtr& gm)
+        : gm_(gm),
+          gl_supports_markers_(
+              gm_->IsFunctionGroupAvailable(GraphicsManager::kDebugMarker)) {}
+
+    // Pushes a label onto the tracing stack and outputs it if the contained
+    // GraphicsManager has a tracing stream or a BinaryTrace.
+    void Push(const std::string& marker) {
+      std::ostream* out = gm_->GetTracingStream();
+      BinaryTrace* trace = gm_->GetBinaryTrace().Get();
+      if (out || trace) {
+        const std::string line =
+            std::string(indent_.length(), '-') + ">" + marker + ":\n";
+        if (out)
+          *out << line;
+        if (trace)
+          trace->RecordText(line);
+      }
+      indent_ += "  ";
+      gm_->SetTracingPrefix(indent_);
+      if (gl_supports_markers_)
+        gm_->PushGroupMarker(static_cast<GLsizei>(marker.length()),
+                             marker.c_str());
+    }
+
+    // Pops the last label (if there is one) off of the tracing stack.
+    void Pop() {
+      if (const size_t length = indent_.length()) {
+        if (gl_supports_markers_)
+          gm_->PopGroupMarker();
+        indent_ = indent_.substr(0, length - 2U);
+        gm_->SetTracingPrefix(indent_);
+      }
+    }
+
+   private:
+    GraphicsManagerPtr gm_;
+    std::string indent_;
+    const bool gl_supports_markers_;
+  };
+#endif
+
+  class InfoRequestGuard {
+   public:
+    explicit InfoRequestGuard(ResourceBinder* rb)
+      : rb_(rb) {
+      rb_->processing_info_requests_ = true;
+    }
+    ~InfoRequestGuard() {
+      rb_->processing_info_requests_ = false;
+    }
+
+   private:
+    ResourceBinder* rb_;
+  };
+
+  // The constructor is passed a GraphicsManager for updating GL object state.
+  explicit ResourceBinder(const GraphicsManagerPtr& gm)
+      : graphics_manager_(gm),
+        stream_annotator_(new (GetAllocator()) StreamAnnotator(gm)),
+        image_units_(*this),
+        texture_last_bindings_(*this),
+        active_image_unit_(kInvalidGluint),
+        active_indirect_buffer_(0U),
+        active_framebuffer_(kInvalidGluint),
+        active_framebuffer_resource_(NULL),
+        active_shader_id_(0U),
+        active_shader_resource_(NULL),
+        active_vertex_array_(0U),
+        active_vertex_array_resource_(NULL),
+        emulated_attribs_(*this),
+        known_vertex_attrib_values_(0U),
+        uniform_buffer_blocks_(*this),
+        uniform_buffer_bindings_(*this),
+        uniform_stack_registries_(*this),
+        uniform_stack_indices_(*this),
+        uniform_stack_previous_(*this),
+        uniform_stack_marks_(*this),
+        temp_uniforms_(*this),
+        temp_uniform_count_(0U),
+        current_shader_program_(NULL),
+        vertex_array_keys_(*this),
+        are_compiler_threads_requested_(false),
+        gl_state_table_(new (GetAllocator()) StateTable(0, 0)),
+        client_state_table_(new (GetAllocator()) StateTable(0, 0)),
+        synced_client_state_table_(new (GetAllocator()) StateTable(0, 0)),
+        synced_gl_state_table_(new (GetAllocator()) StateTable(0, 0)),
+        is_state_sync_valid_(false),
+        traversal_state_tables_(*this),
+        current_traversal_index_(0U),
+        draw_list_(new (GetAllocator()) DrawList),
+        retained_draw_lists_(*this),
+        last_draw_list_(NULL),
+        shared_draw_list_(NULL),
+        draw_list_builder_(*this),
+        draw_list_subgraphs_(*this),
+        draw_list_parts_(*this),
+        retained_subgraph_lists_(*this),
+        draw_list_worker_(NULL),
+        visibility_function_(NULL),
+        clip_from_scene_(NULL),
+        upload_worker_(NULL),
+        node_gpu_timer_(NULL),
+        node_cpu_timer_(NULL),
+        query_queue_(NULL),
+        draw_list_state_tables_(*this),
+        draw_list_scratch_state_(new (GetAllocator()) StateTable(0, 0)),
+        transparency_framebuffer_(0U),
+        transparency_framebuffer_resource_(NULL),
+        transparency_size_(0U, 0U),
+        has_transparency_targets_(false),
+        copy_transparency_depth_(false),
+        multi_draw_batch_(*this),
+        is_transform_feedback_active_(false),
+        transform_feedback_primitive_type_(GL_NONE),
+        transform_feedback_program_(0U),
+        recorded_pipelines_(*this),
+        pipeline_warm_up_(NULL),
+        storage_buffers_(*this),
+        compute_images_(*this),
+        pending_barriers_(0U),
+        processing_info_requests_(false) {
+    memset(saved_ids_, 0, sizeof(saved_ids_));
+    saved_state_table_ = new (GetAllocator()) StateTable();
+    prior_state_.state_table = new (GetAllocator()) StateTable();
+
+    // Enable program point sizes if the platform needs it.
+    if (gm->GetGlApiStandard() == GraphicsManager::kDesktop) {
+      // Point sprites are always on in OpenGL 3.2+ core profiles.
+      if (gm->GetGlProfileType() != GraphicsManager::kCoreProfile)
+        gm->Enable(GL_POINT_SPRITE);
+      gm->Enable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    // Save the default framebuffer.
+    UpdateDefaultFramebufferFromOpenGL();
+
+    // Get the number of image units and resize the TextureManager.
+    const int max_image_units = GetGraphicsManager()->GetCapabilityValue<int>(
+        GraphicsManager::kMaxTextureImageUnits);
+    image_units_.resize(max_image_units);
+    texture_manager_.reset(new (GetAllocator())
+                               TextureManager(max_image_units));
+    DCHECK(texture_manager_.get());
+
+    traversal_state_tables_.resize(16);
+    for (size_t i = 0; i < 16U; ++i)
+      traversal_state_tables_[i] = new(GetAllocator()) StateTable;
+  }
+
+  ~ResourceBinder() override {}
+
+  // Saves the currently bound GL framebuffer as the default framebuffer.
+  void UpdateDefaultFramebufferFromOpenGL() {
+    GetGraphicsManager()->GetIntegerv(GL_FRAMEBUFFER_BINDING,
+                                      GetSavedId(Renderer::kSaveFramebuffer));
+  }
+
+  // Returns the GraphicsManager used for the instance.
+  const GraphicsManagerPtr& GetGraphicsManager() const {
+    return graphics_manager_;
+  }
+
+  // Returns the TextureManager that manages image units for the passed texture
+  // target.
+  TextureManager* GetTextureManager() const { return texture_manager_.get(); }
+
+  // Gets/sets the current ResourceManager, which must remain valid as long as
+  // this is operating on its resources.
+  ResourceManager* GetResourceManager() const { return resource_manager_; }
+  void SetResourceManager(ResourceManager* manager) {
+    resource_manager_ = manager;
+  }
+
+  // Returns the stream annotator for debug tracing.
+  StreamAnnotator* GetStreamAnnotator() const {
+    return stream_annotator_.get();
+  }
+
+  // Gets/sets the timer that measures labeled Nodes on the CPU during the
+  // next call to DrawScene(), or NULL if they are not measured.
+  NodeCpuTimer* GetNodeCpuTimer() const { return node_cpu_timer_; }
+  void SetNodeCpuTimer(NodeCpuTimer* timer) { node_cpu_timer_ = timer; }
+  // Counts an OpenGL object created or updated for the Node being drawn.
+  void CountResourceUpdate() {
+    if (node_cpu_timer_)
+      node_cpu_timer_->CountResourceUpdate();
+  }
+
+  // Returns the last bound FramebufferObject.
+  const FramebufferObjectPtr GetCurrentFramebuffer() const {
+    return current_fbo_.Acquire();
+  }
+
+  // Stores a weak reference to the currently bound FramebufferObject.
+  void SetCurrentFramebuffer(const FramebufferObjectPtr& fbo) {
+    current_fbo_ = base::WeakReferentPtr<FramebufferObject>(fbo);
+  }
+
+  // Sets/returns the TransformFeedback that Shapes are being captured into, if
+  // any. The OpenGL capture begins with the first Shape drawn.
+  void SetTransformFeedback(const TransformFeedbackPtr& feedback) {
+    transform_feedback_ = feedback;
+  }
+  const TransformFeedbackPtr& GetTransformFeedback() const {
+    return transform_feedback_;
+  }
+
+  // The state of a pass of Renderer::WarmUpPipelines(), during which each
+  // Shape is drawn as a single primitive, and only if its pipeline is one of
+  // keys, or any pipeline if keys is NULL, and has not been drawn yet.
+  struct PipelineWarmUp {
+    explicit PipelineWarmUp(const std::set<uint64>* keys_in)
+        : keys(keys_in), draw_count(0U) {}
+    const std::set<uint64>* keys;
+    std::set<uint64> drawn;
+    size_t draw_count;
+  };
+  // Sets the warm-up pass in progress, or ends it if warm_up is NULL.
+  void SetPipelineWarmUp(PipelineWarmUp* warm_up) {
+    pipeline_warm_up_ = warm_up;
+  }
+  // Begins the OpenGL capture into transform_feedback_ for a Shape drawn with
+  // the passed primitive type, unless it has already begun. Returns false if
+  // the Shape cannot be captured, because its base primitive type or the
+  // program differs from those of the capture in progress.
+  bool BeginTransformFeedbackCapture(const Shape& shape, GraphicsManager* gm);
+  // Ends the OpenGL capture, if it has begun. Pending draws must have been
+  // flushed.
+  void EndTransformFeedbackCapture(GraphicsManager* gm);
+
+  // Binds the passed BufferObject to a shader storage buffer binding point,
+  // or the passed level of the passed Texture to an image unit, for compute
+  // programs; see Renderer::BindShaderStorageBuffer() and
+  // Renderer::BindImageTexture().
+  void BindShaderStorageBuffer(GLuint index, const BufferObjectPtr& buffer);
+  void BindImageTexture(GLuint unit, const TexturePtr& texture, GLint level,
+                        GLenum access);
+  // Runs the compute program of the passed Node, reading the numbers of work
+  // groups from the passed BufferObject at the passed offset if it is not
+  // NULL.
+  void DispatchCompute(const Node& node, const BufferObject* indirect,
+                       size_t indirect_offset, GLuint num_groups_x,
+                       GLuint num_groups_y, GLuint num_groups_z);
+  // Issues a single memory barrier for everything written by dispatches
+  // since the last one, if anything.
+  void IssuePendingBarriers(GraphicsManager* gm) {
+    if (pending_barriers_) {
+      gm->MemoryBarrier(pending_barriers_);
+      pending_barriers_ = 0U;
+    }
+  }
+
+  // Returns the currently active shader program resource.
+  ShaderProgramResource* GetActiveShaderProgram() const {
+    return active_shader_resource_;
+  }
+
+  // Asks OpenGL to use as many threads as it can to compile shaders, the
+  // first time this is called, if KHR_parallel_shader_compile is supported.
+  void RequestShaderCompilerThreads(GraphicsManager* gm) {
+    if (!are_compiler_threads_requested_ &&
+        gm->IsFunctionGroupAvailable(GraphicsManager::kParallelShaderCompile))
+      gm->MaxShaderCompilerThreadsKHR(0xFFFFFFFFU);
+    are_compiler_threads_requested_ = true;
+  }
+
+  // Returns the currently active framebuffer resource.
+  FramebufferResource* GetActiveFramebuffer() const {
+    return active_framebuffer_resource_;
   }
 
   // Returns the currently active vertex array resource.
@@ -1356,7 +4085,73 @@ class Renderer::ResourceBinder : public Allocatable {
       active_buffers_[target].buffer = 0;
       active_buffers_[target].resource = NULL;
     }
+    // Any buffer may be bound as the source of indirect draws.
+    if (!id || id == active_indirect_buffer_)
+      active_indirect_buffer_ = 0;
+    // Deleting a buffer also unbinds it from any indexed binding points.
+    if (target == BufferObject::kUniformBuffer) {
+      const size_t count = uniform_buffer_bindings_.size();
+      for (size_t i = 0; i < count; ++i) {
+        if (!id || id == uniform_buffer_bindings_[i].buffer)
+          uniform_buffer_bindings_[i] = UniformBufferBinding();
+      }
+    }
+    // Attribute pointers into a deleted buffer must be sent again, since the
+    // buffer's name may be reused.
+    if (target == BufferObject::kArrayBuffer)
+      ClearEmulatedVertexAttribs(id);
+  }
+
+  // Sets the pointer and divisor of an attribute slot of an emulated vertex
+  // array, unless they were already set to the same values through this.
+  // The buffer is the one bound to GL_ARRAY_BUFFER.
+  void SetEmulatedVertexAttribPointer(GLuint index, GLuint buffer, GLint size,
+                                      GLenum type, GLboolean normalized,
+                                      GLsizei stride, const void* pointer,
+                                      GLuint divisor);
+  // Enables or disables an attribute slot of an emulated vertex array, unless
+  // it is already in that state.
+  void SetEmulatedVertexAttribEnabled(GLuint index, bool enabled);
+  // Sends the constant value of a generic attribute slot, a vector of size
+  // floats, unless the same value was already sent through this. Constant
+  // values are not part of vertex arrays, so they remain known across vertex
+  // array binds.
+  void SetVertexAttribValue(GLuint index, int size, const float* values);
+  // Forgets the constant value of the passed attribute slot, or of all slots
+  // if index is kInvalidGluint. The value of a slot must be forgotten when it
+  // is enabled as an array, since it is then undefined in OpenGL ES 2.0.
+  void ClearVertexAttribValues(GLuint index) {
+    if (index == kInvalidGluint)
+      known_vertex_attrib_values_ = 0U;
+    else if (index < kTrackedVertexAttribCount)
+      known_vertex_attrib_values_ &= ~(static_cast<uint64>(1U) << index);
+  }
+  // Forgets the attribute slot state of emulated vertex arrays set through
+  // this that uses the passed buffer, or all of it if the id is 0.
+  void ClearEmulatedVertexAttribs(GLuint buffer) {
+    const size_t count = emulated_attribs_.size();
+    for (size_t i = 0; i < count; ++i) {
+      if (!buffer || emulated_attribs_[i].buffer == buffer)
+        emulated_attribs_[i] = EmulatedVertexAttrib();
+    }
+  }
+
+  // A buffer-backed UniformBlock of a Node that is being drawn, and the
+  // resource of its buffer.
+  struct UniformBufferBlock {
+    UniformBufferBlock() : block(NULL), resource(NULL) {}
+    const UniformBlock* block;
+    BufferResource* resource;
+  };
+  // Returns the buffer-backed UniformBlocks of the Nodes being drawn, in the
+  // order they were pushed. The index of each block is the uniform buffer
+  // binding point its buffer is bound to.
+  const base::AllocVector<UniformBufferBlock>& GetUniformBufferBlocks() const {
+    return uniform_buffer_blocks_;
   }
+  // Binds the buffer of the passed resource to the passed uniform buffer
+  // binding point, if it is not already bound there.
+  void BindUniformBuffer(GLuint binding, BufferResource* resource);
 
   // Clears the framebuffer binding if it is already bound.
   void ClearFramebufferBinding(GLuint id) {
@@ -1392,6 +4187,16 @@ class Renderer::ResourceBinder : public Allocatable {
   // Clears all non-framebuffer cached bindings.
   void ClearNonFramebufferCachedBindings();
 
+  // Sets the cached state and bindings to those of the passed HostState
+  // without making any OpenGL calls.
+  void SetHostState(const Renderer::HostState& state);
+  // Stores the cached state and bindings in the passed HostState, which must
+  // have a StateTable.
+  void GetHostState(Renderer::HostState* state) const;
+  // Restores the state and bindings of the passed HostState, making OpenGL
+  // calls only for those that differ from the cached ones.
+  void RestoreHostState(const Renderer::HostState& state, GraphicsManager* gm);
+
   template <typename HolderType>
   void BindResource(const HolderType* holder) {
     if (holder) {
@@ -1494,13 +4299,17 @@ class Renderer::ResourceBinder : public Allocatable {
   // Generic function that performs an operation on all holders in a node
   // graph. The actual operation performed is determined by the specialization
   // of the Process() function for the Operation type. The recursive part
-  // of the function is defined in Visit().
+  // of the function is defined in Visit(). The traversal only borrows the
+  // Nodes and Shapes, so no reference counts are modified.
   template <typename Operation>
-  void Traverse(const NodePtr& node, ShaderProgram* default_shader);
+  void Traverse(const Node& node, ShaderProgram* default_shader);
 
   // Generic function for processing the resources associated with a shape.
   template <typename Operation>
-  void VisitShape(const ShapePtr& shape);
+  void VisitShape(const Shape& shape);
+  // Creates or updates the resources of a Shape drawn with the passed program,
+  // on which its vertex arrays depend.
+  void CreateOrUpdateShapeResources(const Shape& shape, ShaderProgram* program);
 
   // Makes the passed StateTable the active tracked state by making the proper
   // OpenGL calls.
@@ -1514,15 +4323,19 @@ class Renderer::ResourceBinder : public Allocatable {
                            const base::AllocatorPtr& allocator);
 
   // Sends a uniform value to OpenGL.
-  void SendUniform(const Uniform& uniform, int location, GraphicsManager* gm);
+  void SendUniform(const Uniform& uniform, int location, GraphicsManager* gm) {
+    SendUniformRange(uniform, location, 0U, uniform.GetCount(), gm);
+  }
+  // Sends |count| values of an array uniform to OpenGL, starting with the
+  // value at index |first|. Texture uniforms and non-array uniforms are always
+  // sent entirely.
+  void SendUniformRange(const Uniform& uniform, int location, size_t first,
+                        size_t count, GraphicsManager* gm);
 
-  // Pushes the uniforms in the passed list, associating them with the passed
-  // Node pointer.
+  // Pushes the uniforms in the passed list onto the shadow state, associating
+  // them with the passed Node pointer. They are popped by PopNodeUniforms().
   void PushUniforms(const Node* node,
                     const base::AllocVector<Uniform>& uniforms);
-  // Pops the uniforms in the passed list, restoring their values in the shadow
-  // state.
-  void PopUniforms(const base::AllocVector<Uniform>& uniforms);
 
   // Returns a pointer to the saved framebuffer.
   GLint* GetSavedId(Renderer::Flag flag) {
@@ -1546,9 +4359,23 @@ class Renderer::ResourceBinder : public Allocatable {
     texture_manager_->SetUnitRange(units);
   }
 
-  // Draws the scene rooted at node.
+  // Draws the scene rooted at node. Levels of detail are selected with
+  // clip_from_scene, if it is not NULL.
   void DrawScene(const NodePtr& node, const Flags& flags,
-                 ShaderProgram* default_shader);
+                 ShaderProgram* default_shader,
+                 const NodeVisibilityFunction& visibility_function,
+                 const math::Matrix4f* clip_from_scene,
+                 DrawListWorker* draw_list_worker,
+                 const UploadWorker* upload_worker,
+                 NodeGpuTimer* node_gpu_timer, QueryQueue* query_queue);
+
+  // Makes the next call to DrawScene() draw from the DrawList that the passed
+  // ResourceBinder last drew from, instead of traversing the scene again, or
+  // stops doing so if it is NULL. The other binder must have drawn the same
+  // scene with the same flags, and must not draw again before this does.
+  void ShareDrawListFrom(const ResourceBinder* other) {
+    shared_draw_list_ = other ? other->last_draw_list_ : NULL;
+  }
 
   // Returns whether this is currently processing info requests. This is used to
   // prevent spurious errors from being generated.
@@ -1584,16 +4411,447 @@ class Renderer::ResourceBinder : public Allocatable {
   // Gets the hash key for Resource types. By default this is just the
   // ResourceBinder.
 
+  // A flattened list of all of the Shapes in a scene and the Nodes leading to
+  // them, in the order they are to be drawn. A DrawList only references the
+  // scene's Nodes, Shapes, and StateTables; Uniform and StateTable values are
+  // read from them each time the list is drawn. The list is invalidated when
+  // the structure of the scene changes, which the root Node notifies it of.
+  // A retained list also keeps a list for the subgraph of each child of the
+  // root, which its child invalidates, so that rebuilding the list only
+  // collects the subgraphs that changed.
+  class DrawList : public base::Notifier {
+   public:
+    // A range of entries in path_nodes.
+    struct Path {
+      size_t start;
+      size_t length;
+    };
+
+    // A Shape to draw, along with everything needed to draw it.
+    struct Draw {
+      // The sort key, in order of decreasing state change cost.
+      ShaderProgram* shader_program;
+      size_t state_key;
+      size_t texture_key;
+      const AttributeArray* attribute_array;
+      // The Shape to draw.
+      const Shape* shape;
+      // The Nodes from the root to the Shape's Node, whose Uniforms must be
+      // pushed before drawing.
+      Path path;
+      // The index of the entry in states to draw with.
+      size_t state_index;
+      // Whether the draw must be emitted in tree order.
+      bool preserve_order;
+      // The render pass of the Shape's Node, and the depth of the Node from
+      // the culling matrix, used when sorting by render pass.
+      Node::RenderPass render_pass;
+      float depth;
+      // Whether this is a depth prepass copy of an opaque draw, which draws
+      // with the depth-only variant of its shader program.
+      bool is_depth_only;
+      // The transparency pass that this copy of a transparent draw belongs
+      // to, if the transparent pass is drawn with order-independent
+      // transparency.
+      TransparencyPassState transparency_pass;
+
+      // Returns whether the passed draw may be reordered.
+      static bool IsReorderable(const Draw& draw) {
+        return !draw.preserve_order;
+      }
+    };
+
+    // Orders Draws by render pass.
+    struct RenderPassLess {
+      bool operator()(const Draw& a, const Draw& b) const {
+        return a.render_pass < b.render_pass;
+      }
+    };
+
+    // Orders Draws front to back.
+    struct DepthLess {
+      bool operator()(const Draw& a, const Draw& b) const {
+        return a.depth < b.depth;
+      }
+    };
+
+    // Orders Draws back to front.
+    struct DepthGreater {
+      bool operator()(const Draw& a, const Draw& b) const {
+        return a.depth > b.depth;
+      }
+    };
+
+    // Orders Draws by their sort keys.
+    struct DrawLess {
+      bool operator()(const Draw& a, const Draw& b) const {
+        if (a.shader_program != b.shader_program)
+          return a.shader_program < b.shader_program;
+        if (a.state_key != b.state_key)
+          return a.state_key < b.state_key;
+        if (a.texture_key != b.texture_key)
+          return a.texture_key < b.texture_key;
+        return a.attribute_array < b.attribute_array;
+      }
+    };
+
+    // Orders the indices of Draws in an array by their sort keys, and draws
+    // with equal keys by index. When the indices are in tree order this is
+    // the same order as a stable sort with DrawLess.
+    struct DrawIndexLess {
+      explicit DrawIndexLess(const Draw* draws_in) : draws(draws_in) {}
+      bool operator()(size_t a, size_t b) const {
+        const Draw& x = draws[a];
+        const Draw& y = draws[b];
+        return std::tie(x.shader_program, x.state_key, x.texture_key,
+                        x.attribute_array, a) <
+               std::tie(y.shader_program, y.state_key, y.texture_key,
+                        y.attribute_array, b);
+      }
+      const Draw* draws;
+    };
+
+    // A Node whose StateTable contains clears or enforced settings, which must
+    // be applied in tree order before the draw at draw_index.
+    struct Barrier {
+      size_t draw_index;
+      // The Nodes from the root to the barrier Node, inclusive.
+      Path path;
+    };
+
+    // A Node that had a StateTable when the list was built, and whether the
+    // StateTable was a barrier at that time.
+    struct StateNode {
+      const Node* node;
+      bool is_barrier;
+    };
+
+    DrawList()
+        : draws(*this),
+          path_nodes(*this),
+          states(*this),
+          barriers(*this),
+          state_nodes(*this),
+          prepass_states(*this),
+          transparency_states(*this),
+          previous_ranks(*this),
+          next_ranks(*this),
+          seeded_draws(*this),
+          rank_slots(*this),
+          previous_order(*this),
+          kept_draws(*this),
+          changed_draws(*this),
+          merged_draws(*this),
+          sorted_draws(*this),
+          subgraph_lists(*this),
+          default_shader(NULL),
+          state_key(0U),
+          texture_key(0U),
+          preserve_order(false),
+          render_pass(Node::kInheritedPass),
+          is_sorted(false),
+          is_sorted_by_render_pass(false),
+          has_depth_prepass(false),
+          has_transparency_passes(false),
+          is_valid_(false) {}
+
+    // Returns whether the structure of the scene has not changed since the
+    // list was built.
+    bool IsValid() const { return is_valid_; }
+    // Marks the list as valid. This is called after the list is built.
+    void SetValid() { is_valid_ = true; }
+    // Clears the contents of the list and invalidates it, keeping capacity.
+    void Clear() {
+      draws.clear();
+      path_nodes.clear();
+      states.clear();
+      barriers.clear();
+      state_nodes.clear();
+      prepass_states.clear();
+      transparency_states.clear();
+      is_valid_ = false;
+    }
+
+    // Sorts the reorderable draws in [start, end), which must be in tree
+    // order, into the same order as a stable sort with DrawLess. Scenes
+    // usually change little between builds, so the draws are first put in the
+    // order they had the last time the list was sorted; only the draws that
+    // are new or whose keys moved are then sorted, and merged into the rest.
+    // The cost is thus mostly linear in the number of draws. The new order is
+    // recorded for the next build, and takes effect after FinishSort().
+    void SortByState(size_t start, size_t end);
+    // Makes the order recorded by SortByState() seed the next build's sort.
+    void FinishSort() {
+      previous_ranks.swap(next_ranks);
+      next_ranks.clear();
+    }
+
+    base::AllocVector<Draw> draws;
+    base::AllocVector<const Node*> path_nodes;
+    // The paths whose StateTables are merged to produce each client state.
+    base::AllocVector<Path> states;
+    // Barriers, in increasing order of draw_index.
+    base::AllocVector<Barrier> barriers;
+    base::AllocVector<StateNode> state_nodes;
+    // How each entry in states is changed for the depth prepass, if there is
+    // one; otherwise this is empty.
+    base::AllocVector<DepthPrepassState> prepass_states;
+    // How each entry in states is changed for order-independent
+    // transparency, if it is used; otherwise this is empty.
+    base::AllocVector<TransparencyPassState> transparency_states;
+    // The position of each draw in the sorted order of the last build, keyed
+    // by GetDrawId(), and the positions being recorded by the current build.
+    // These outlive Clear().
+    base::AllocUnorderedMap<size_t, size_t> previous_ranks;
+    base::AllocUnorderedMap<size_t, size_t> next_ranks;
+    // Scratch space for SortByState(), kept to avoid reallocating it.
+    base::AllocVector<std::pair<size_t, size_t> > seeded_draws;
+    base::AllocVector<size_t> rank_slots;
+    base::AllocVector<size_t> previous_order;
+    base::AllocVector<size_t> kept_draws;
+    base::AllocVector<size_t> changed_draws;
+    base::AllocVector<size_t> merged_draws;
+    base::AllocVector<Draw> sorted_draws;
+    // The lists of the subgraphs of the children of the root, in tree order,
+    // if the list is retained. These outlive Clear().
+    base::AllocVector<base::SharedPtr<DrawList> > subgraph_lists;
+    // The root Node and default shader the list was built with, whether draws
+    // between barriers were sorted by state and by render pass, and whether
+    // a depth prepass and transparency passes were added.
+    base::WeakReferentPtr<Node> root;
+    ShaderProgram* default_shader;
+    // The keys, draw order, and render pass that the root of a subgraph list
+    // inherits from its parent.
+    size_t state_key;
+    size_t texture_key;
+    bool preserve_order;
+    Node::RenderPass render_pass;
+    bool is_sorted;
+    bool is_sorted_by_render_pass;
+    bool has_depth_prepass;
+    bool has_transparency_passes;
+
+   protected:
+    ~DrawList() override {}
+
+   private:
+    // Invalidates the list whenever the scene structure changes.
+    void OnNotify(const base::Notifier* notifier) override {
+      is_valid_ = false;
+    }
+
+    // Returns a value that identifies the passed draw across builds, formed
+    // from its Shape and the Node that contains it. Draws that share an id
+    // are simply sorted from scratch.
+    size_t GetDrawId(const Draw& draw) const {
+      return CombineSortKey(
+          reinterpret_cast<size_t>(draw.shape),
+          path_nodes[draw.path.start + draw.path.length - 1U]);
+    }
+
+    std::atomic<bool> is_valid_;
+  };
+  typedef base::SharedPtr<DrawList> DrawListPtr;
+
+  struct DrawListSubgraph;
+
+  // The state of a traversal that collects Nodes into a DrawList. Each thread
+  // collecting Nodes uses its own.
+  struct DrawListBuilder {
+    explicit DrawListBuilder(const Allocatable& owner)
+        : traversal_path(owner),
+          state_changed(true),
+          shader_program(NULL),
+          visibility_function(NULL),
+          clip_from_scene(NULL),
+          upload_worker(NULL),
+          subgraphs(NULL) {}
+    // The path to the Node currently being collected.
+    base::AllocVector<const Node*> traversal_path;
+    // Whether the client state has changed since the last DrawList state.
+    bool state_changed;
+    // The shader program that applies to the Node being collected.
+    ShaderProgram* shader_program;
+    // The function that decides whether Nodes are visible, if any.
+    const NodeVisibilityFunction* visibility_function;
+    // The matrix that selects levels of detail, if any.
+    const math::Matrix4f* clip_from_scene;
+    // The worker uploading resources that Nodes may not use yet, if any.
+    const UploadWorker* upload_worker;
+    // If not NULL, the children of the Node being collected are added to this
+    // instead of being collected.
+    base::AllocVector<DrawListSubgraph>* subgraphs;
+  };
+
+  // A subgraph that is collected into its own DrawList, possibly on another
+  // thread, which is then appended to the DrawList of the whole scene.
+  struct DrawListSubgraph {
+    explicit DrawListSubgraph(const Allocatable& owner)
+        : builder(owner),
+          node(NULL),
+          state_key(0U),
+          texture_key(0U),
+          preserve_order(false),
+          render_pass(Node::kInheritedPass) {}
+    // The builder, which begins with the path to the subgraph's parent.
+    DrawListBuilder builder;
+    const Node* node;
+    size_t state_key;
+    size_t texture_key;
+    bool preserve_order;
+    Node::RenderPass render_pass;
+  };
+
+  // Collects the subgraph at an index in draw_list_subgraphs_ into the
+  // DrawList at the same index in parts.
+  struct CollectSubgraphTask {
+    CollectSubgraphTask(ResourceBinder* binder_in, const DrawListPtr* parts_in)
+        : binder(binder_in), parts(parts_in) {}
+    void operator()(size_t index) const {
+      binder->CollectSubgraph(index, parts[index].Get());
+    }
+    ResourceBinder* binder;
+    const DrawListPtr* parts;
+  };
+
+  // Returns whether the passed Node may be drawn, i.e., whether it is enabled,
+  // visible, at a selected level of detail, and not using any textures with
+  // pending uploads.
+  static bool IsNodeDrawable(const Node& node,
+                             const NodeVisibilityFunction* visibility_function,
+                             const math::Matrix4f* clip_from_scene,
+                             const UploadWorker* upload_worker);
+  // Returns whether any of the textures in the passed Uniforms has an upload
+  // pending in the passed worker.
+  static bool HasPendingTextures(const base::AllocVector<Uniform>& uniforms,
+                                 const UploadWorker& upload_worker);
+  // Returns whether any of the buffers of the passed Shape has an upload
+  // pending.
+  bool HasPendingBuffers(const Shape& shape) const;
   // Draws a single Node.
   void DrawNode(const Node& node, GraphicsManager* gm);
-  // Draws a single Shape.
+  // Returns a DrawList for drawing the passed root Node with the passed flags,
+  // either a retained one from a previous frame that is still valid or a newly
+  // built one.
+  DrawList* GetDrawList(const NodePtr& root, const Flags& flags,
+                        ShaderProgram* default_shader);
+  // Returns whether the passed DrawList may be used to draw the passed root
+  // with the passed flags.
+  bool IsDrawListCurrent(const DrawList& list, const Node* root,
+                         ShaderProgram* default_shader,
+                         const Flags& flags) const;
+  // Returns whether none of the StateTables of the passed DrawList started or
+  // stopped being a barrier since it was built.
+  static bool AreStateNodesCurrent(const DrawList& list);
+  // Replaces the subgraph lists of the passed DrawList with one for each
+  // subgraph in draw_list_subgraphs_. Lists retained from the last build are
+  // reused if their subgraphs have not changed; the others are empty.
+  void RetainSubgraphLists(DrawList* list);
+  // Builds the passed DrawList from the scene rooted at the passed Node,
+  // sorting it as the passed flags request. If there is a DrawListWorker, the
+  // children of the root are collected in parallel.
+  void BuildDrawList(const Node& root, ShaderProgram* default_shader,
+                     const Flags& flags, DrawList* list);
+  // Sorts the draws in the passed range, which contains no barriers, by
+  // render pass if by_render_pass is set, and within each pass by state if
+  // sort is set.
+  void SortDraws(bool sort, bool by_render_pass, size_t start, size_t end,
+                 DrawList* list) const;
+  // Inserts a depth prepass copy of each run of opaque draws before it.
+  static void AddDepthPrepass(DrawList* list);
+  // Returns whether the transparent pass should be drawn with
+  // order-independent transparency with the passed flags.
+  bool UsesTransparencyPasses(const Flags& flags) const;
+  // Replaces each run of transparent draws with an accumulation pass copy and
+  // a revealage pass copy of it.
+  static void AddTransparencyPasses(DrawList* list);
+  // Binds and clears the target of the passed transparency pass, copying the
+  // depth of the framebuffer that the scene is drawn into. The first pass
+  // remembers that framebuffer, and sizes the targets to it or, for a default
+  // framebuffer, to the viewport of the passed state. Returns whether the
+  // target can be drawn into.
+  bool BeginTransparencyPass(TransparencyPassState pass,
+                             const StateTable& state, GraphicsManager* gm);
+  // Binds the framebuffer that the scene is drawn into again, and composites
+  // the transparency targets over it.
+  void EndTransparencyPasses(GraphicsManager* gm);
+  // See CollectSubgraphTask. Does nothing if the DrawList is still valid.
+  void CollectSubgraph(size_t index, DrawList* part);
+  // Traverses a single Node, collecting its Shapes into the passed DrawList
+  // instead of drawing them. This does not access the ResourceBinder, so it
+  // may be called from any thread.
+  static void CollectNode(const Node& node, size_t state_key,
+                          size_t texture_key, bool preserve_order,
+                          Node::RenderPass render_pass,
+                          DrawListBuilder* builder, DrawList* list);
+  // Appends the contents of a DrawList built from a subgraph to another one.
+  static void AppendDrawList(const DrawList& part, DrawList* list);
+  // Returns whether the paths in the passed DrawLists pass through the same
+  // Nodes with StateTables, and so have the same client state.
+  static bool HaveSameStateNodes(const DrawList& a,
+                                 const DrawList::Path& a_path,
+                                 const DrawList& b,
+                                 const DrawList::Path& b_path);
+  // Draws the contents of the passed DrawList.
+  void DrawDrawList(const DrawList& list, GraphicsManager* gm);
+  // Sets the passed StateTable to the current client state merged with the
+  // StateTables of the first |length| Nodes in the passed path.
+  void ComputeDrawListState(const DrawList& list, const DrawList::Path& path,
+                            size_t length, StateTable* state);
+  // Updates the Uniform shadow state when switching from drawing the Shape in
+  // |from| (which may be NULL) to the one in |to| (which may also be NULL),
+  // popping and pushing only the Nodes that differ in their paths. Returns
+  // whether any Uniforms changed.
+  bool SwitchDrawListPath(const DrawList& list, const DrawList::Draw* from,
+                          const DrawList::Draw* to);
+  // Pushes or pops the Uniforms and enabled UniformBlocks of the passed Node.
+  void PushNodeUniforms(const Node& node);
+  void PopNodeUniforms(const Node& node);
+  // Returns whether the values of the passed UniformBlock are sent through a
+  // uniform buffer object rather than as individual Uniforms.
+  bool IsBufferBacked(const UniformBlock& block);
+  // Pushes a Uniform onto the shadow state of its registry, combining or
+  // merging it with the current value as necessary, and pushes any Uniforms
+  // that its spec generates.
+  void PushUniform(ShaderInputRegistryResource* sirr, const Uniform& u);
+  // Makes |u| the current value of the Uniform at |index| in the shadow state
+  // of |sirr|, recording the previous value on the uniform stack.
+  void PushUniformEntry(ShaderInputRegistryResource* sirr, size_t index,
+                        const Uniform* u);
+  // Returns an unused temporary Uniform for combined, merged, or generated
+  // values, which remains in use until the Node being pushed is popped.
+  Uniform* AcquireTempUniform();
+  // Draws a single Shape. Draws that are not instanced are added to
+  // multi_draw_batch_ instead of being sent to OpenGL immediately, so that
+  // consecutive Shapes with the same AttributeArray and IndexBuffer are drawn
+  // with as few calls as possible; FlushMultiDraw() must be called before
+  // anything else is sent to OpenGL.
   void DrawShape(const Shape& shape, GraphicsManager* gm);
+  // Draws a single Shape with the command in its indirect BufferObject, which
+  // must be set. Returns false if indirect draws are not supported, in which
+  // case the Shape must be drawn normally.
+  bool DrawIndirectShape(const Shape& shape, GraphicsManager* gm);
   // Draws a single Shape that has an IndexBuffer.
   void DrawIndexedShape(const Shape& shape, const IndexBuffer& ib,
                         GraphicsManager* gm);
+  // Records the pipeline used to draw a Shape with the bound program and
+  // OpenGL state with the ResourceManager, unless this combination has already
+  // been seen. During a warm-up pass, instead draws the first primitive of the
+  // Shape if its pipeline should be warmed up. Returns whether the Shape has
+  // been handled by the warm-up pass and must not be drawn normally.
+  bool RecordOrWarmUpPipeline(const Shape& shape, size_t vertex_count,
+                              GraphicsManager* gm);
   // Draws a single Shape that has no IndexBuffer.
   void DrawNonindexedShape(const Shape& shape, size_t vertex_count,
                            GraphicsManager* gm);
+  // Adds a range of vertices (if index_type is GL_NONE) or indices to
+  // multi_draw_batch_, flushing it first if it uses a different primitive or
+  // index type. For indexed draws, first is the byte offset of the first index.
+  void AddToMultiDraw(GLenum primitive_type, GLenum index_type, GLint first,
+                      GLsizei count, GraphicsManager* gm);
+  // Sends all ranges in multi_draw_batch_ to OpenGL, using a single
+  // glMultiDraw*() call if there are several and the platform supports it.
+  void FlushMultiDraw(GraphicsManager* gm);
 
   // Marks the passed attachment's texture targets, if any, as having been
   // implicitly changed by a draw into a framebuffer.
@@ -1603,7 +4861,7 @@ class Renderer::ResourceBinder : public Allocatable {
   // Generic function that recursively processes all holders in a node graph.
   // Private, since it depends on setup done by the Traverse() function.
   template <typename Operation>
-  void Visit(const NodePtr& node);
+  void Visit(const Node& node);
 
   // The GraphicsManager used for this instance.
   GraphicsManagerPtr graphics_manager_;
@@ -1626,7 +4884,9 @@ class Renderer::ResourceBinder : public Allocatable {
   GLuint active_image_unit_;
 
   // Tracks which buffer objects are currently bound.
-  BufferBinding active_buffers_[2];
+  BufferBinding active_buffers_[3];
+  // Tracks which buffer object is bound to GL_DRAW_INDIRECT_BUFFER.
+  GLuint active_indirect_buffer_;
 
   // Tracks which framebuffer is currently bound.
   // Please note that if active_framebuffer_ equals
@@ -1642,11 +4902,70 @@ class Renderer::ResourceBinder : public Allocatable {
   GLuint active_vertex_array_;
   VertexArrayResource* active_vertex_array_resource_;
 
+  // The state of an attribute slot as last set by an emulated vertex array.
+  // The pointer and enabled state are only known when they are valid.
+  struct EmulatedVertexAttrib {
+    EmulatedVertexAttrib()
+        : is_valid(false),
+          is_enabled_valid(false),
+          is_enabled(false),
+          buffer(0U),
+          size(0),
+          type(GL_NONE),
+          normalized(GL_FALSE),
+          stride(0),
+          pointer(nullptr),
+          divisor(0U) {}
+    bool is_valid;
+    bool is_enabled_valid;
+    bool is_enabled;
+    GLuint buffer;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    GLsizei stride;
+    const void* pointer;
+    GLuint divisor;
+  };
+  base::AllocVector<EmulatedVertexAttrib> emulated_attribs_;
+
+  // The constant values last sent to the first kTrackedVertexAttribCount
+  // attribute slots, and a mask of the slots whose values are known.
+  static const GLuint kTrackedVertexAttribCount = 64U;
+  struct VertexAttribValue {
+    int size;
+    float values[4];
+  };
+  VertexAttribValue vertex_attrib_values_[kTrackedVertexAttribCount];
+  uint64 known_vertex_attrib_values_;
+
+  // The buffer-backed UniformBlocks being drawn, and the buffer bound to each
+  // uniform buffer binding point.
+  base::AllocVector<UniformBufferBlock> uniform_buffer_blocks_;
+  base::AllocVector<UniformBufferBinding> uniform_buffer_bindings_;
+
+  // The stack of all Uniforms pushed during a traversal, as parallel arrays.
+  // Each entry holds the registry resource and index of a pushed Uniform and
+  // the value it replaced, which is restored when the entry is popped. The
+  // marks record where the entries of each pushed Node begin, so that popping
+  // a Node only needs to unwind the stack to its mark.
+  base::AllocVector<ShaderInputRegistryResource*> uniform_stack_registries_;
+  base::AllocVector<size_t> uniform_stack_indices_;
+  base::AllocVector<const Uniform*> uniform_stack_previous_;
+  base::AllocVector<UniformStackMark> uniform_stack_marks_;
+  // Storage for combined, merged, and generated Uniforms. The first
+  // temp_uniform_count_ are in use; the others are reused by later pushes. A
+  // deque is used so that pointers to the Uniforms remain valid as it grows.
+  base::AllocDeque<Uniform> temp_uniforms_;
+  size_t temp_uniform_count_;
+
   // Storage for GL object IDs that are saved when kSave* flags are set, and
   // restored when kRestore* flags are set.
   GLint
       saved_ids_[Renderer::kSaveVertexArray - Renderer::kSaveActiveTexture + 1];
   StateTablePtr saved_state_table_;
+  // The state before DrawScene() when kRestoreChangedState is set.
+  Renderer::HostState prior_state_;
 
   // The ResourceManager that owns the Resources this is operating on. This must
   // be set using SetResourceManager().
@@ -1661,15 +4980,122 @@ class Renderer::ResourceBinder : public Allocatable {
   // in the set. std::set is used instead of std::unordered_set, since
   // iterators into the latter can be invalidated by insertions.
   base::AllocSet<ShaderProgramResource*> vertex_array_keys_;
+  // Whether RequestShaderCompilerThreads() has been called.
+  bool are_compiler_threads_requested_;
 
   // StateTable representing the global OpenGL state.
   StateTablePtr gl_state_table_;
   // StateTable representing the client traversal state.
   StateTablePtr client_state_table_;
+  // Copies of the client state last sent to OpenGL by DrawNode() and of the
+  // resulting OpenGL state, which are only meaningful once
+  // |is_state_sync_valid_| is set. While both still match, the client state
+  // does not need to be sent again.
+  StateTablePtr synced_client_state_table_;
+  StateTablePtr synced_gl_state_table_;
+  bool is_state_sync_valid_;
   // Storage for saving StateTables encountered during traversal.
   base::AllocVector<StateTablePtr> traversal_state_tables_;
   size_t current_traversal_index_;
 
+  // The DrawList rebuilt each frame when draws are sorted but not retained,
+  // and the DrawLists retained across frames, keyed by their root Nodes.
+  DrawListPtr draw_list_;
+  base::AllocUnorderedMap<const Node*, DrawListPtr> retained_draw_lists_;
+  // The DrawList the last call to DrawScene() drew from, if any, and the
+  // DrawList of another binder that the next call should draw from.
+  DrawList* last_draw_list_;
+  DrawList* shared_draw_list_;
+  // The builder used for collecting Nodes on this thread, and the subgraphs
+  // and their DrawLists when collecting in parallel.
+  DrawListBuilder draw_list_builder_;
+  base::AllocVector<DrawListSubgraph> draw_list_subgraphs_;
+  base::AllocVector<DrawListPtr> draw_list_parts_;
+  // The subgraph lists of a retained DrawList being rebuilt, keyed by the
+  // roots of their subgraphs.
+  base::AllocUnorderedMap<const Node*, DrawListPtr> retained_subgraph_lists_;
+  // The worker and node visibility function of the Renderer whose
+  // DrawScene() is being executed, if any.
+  DrawListWorker* draw_list_worker_;
+  const NodeVisibilityFunction* visibility_function_;
+  // The matrix selecting levels of detail in the Renderer whose DrawScene() is
+  // being executed, if it has a culling matrix.
+  const math::Matrix4f* clip_from_scene_;
+  // The upload worker of the Renderer whose DrawScene() is being executed, if
+  // it had pending uploads when drawing began.
+  const UploadWorker* upload_worker_;
+  // The timer of the Renderer whose DrawScene() is being executed, if it
+  // measures labeled Nodes in this call.
+  NodeGpuTimer* node_gpu_timer_;
+  // The CPU timer of the Renderer whose DrawScene() is being executed, if it
+  // measures labeled Nodes in this call.
+  NodeCpuTimer* node_cpu_timer_;
+  // The queries of the Renderer whose DrawScene() is being executed, which
+  // measure Nodes with occlusion queries.
+  QueryQueue* query_queue_;
+  // The client states of the DrawList being drawn, and a scratch StateTable.
+  // These keep their capacity across frames.
+  base::AllocVector<StateTablePtr> draw_list_state_tables_;
+  StateTablePtr draw_list_scratch_state_;
+  // The targets of order-independent transparency, created when first used.
+  std::unique_ptr<TransparencyTargets> transparency_targets_;
+  // While transparency passes are drawn, the framebuffer that the scene is
+  // drawn into, the size of the targets, the viewport to composite them
+  // over, whether they could be prepared, and whether depth must be copied
+  // into them.
+  GLuint transparency_framebuffer_;
+  FramebufferResource* transparency_framebuffer_resource_;
+  math::Vector2ui transparency_size_;
+  math::Range2i transparency_viewport_;
+  bool has_transparency_targets_;
+  bool copy_transparency_depth_;
+
+  // Ranges to draw with the currently bound AttributeArray and IndexBuffer
+  // that have not yet been sent to OpenGL.
+  struct MultiDrawBatch {
+    explicit MultiDrawBatch(const Allocatable& owner)
+        : attribute_array(NULL),
+          index_buffer(NULL),
+          primitive_type(GL_NONE),
+          index_type(GL_NONE),
+          firsts(owner),
+          counts(owner),
+          offsets(owner) {}
+    const AttributeArray* attribute_array;
+    const IndexBuffer* index_buffer;
+    GLenum primitive_type;
+    GLenum index_type;
+    base::AllocVector<GLint> firsts;
+    base::AllocVector<GLsizei> counts;
+    base::AllocVector<const GLvoid*> offsets;
+  };
+  MultiDrawBatch multi_draw_batch_;
+
+  // The TransformFeedback being captured into, whether the OpenGL capture has
+  // begun, and the base primitive type and program of the capture.
+  TransformFeedbackPtr transform_feedback_;
+  bool is_transform_feedback_active_;
+  GLenum transform_feedback_primitive_type_;
+  GLuint transform_feedback_program_;
+
+  // Combinations of program, OpenGL state, AttributeArray, and primitive type
+  // whose pipelines have been recorded, and the warm-up pass in progress.
+  base::AllocUnorderedSet<size_t> recorded_pipelines_;
+  PipelineWarmUp* pipeline_warm_up_;
+
+  // The BufferObjects bound to shader storage buffer binding points and the
+  // Textures bound to image units for compute programs, with whether each
+  // Texture may be written. The memory barriers needed to read what
+  // dispatches have written are issued before the next dispatch or draw.
+  struct ComputeImage {
+    ComputeImage() : is_written(false) {}
+    TexturePtr texture;
+    bool is_written;
+  };
+  base::AllocVector<BufferObjectPtr> storage_buffers_;
+  base::AllocVector<ComputeImage> compute_images_;
+  GLbitfield pending_barriers_;
+
   // Whether this is currently processing info requests.
   bool processing_info_requests_;
 
@@ -1741,26 +5167,37 @@ std::vector<ResourceKey> Renderer::ResourceManager::GetAllResourceKeys<
 }
 
 void Renderer::ResourceManager::ProcessResourceInfoRequests(
-    ResourceBinder* resource_binder) {
+    ResourceBinder* resource_binder, bool use_budget) {
   ResourceBinder::InfoRequestGuard guard(resource_binder);
 
-  // Process all requests for each Resource type.
-  ProcessInfoRequests<AttributeArray, ArrayInfo>(&resources_[kAttributeArray],
-                                                 resource_binder);
-  ProcessInfoRequests<BufferObject, BufferInfo>(&resources_[kBufferObject],
-                                                resource_binder);
-  ProcessInfoRequests<FramebufferObject, FramebufferInfo>(
-      &resources_[kFramebufferObject], resource_binder);
-  ProcessInfoRequests<Sampler, SamplerInfo>(&resources_[kSampler],
-                                            resource_binder);
-  ProcessInfoRequests<ShaderProgram, ProgramInfo>(&resources_[kShaderProgram],
-                                                  resource_binder);
-  ProcessInfoRequests<Shader, ShaderInfo>(&resources_[kShader],
-                                          resource_binder);
-  ProcessInfoRequests<TextureBase, TextureInfo>(&resources_[kTexture],
-                                                resource_binder);
-  ProcessDataRequests<PlatformInfo>();
-  ProcessDataRequests<TextureImageInfo>();
+  // Queue all new requests for each Resource type after the ones left over
+  // from earlier calls.
+  QueueInfoRequests<AttributeArray, ArrayInfo>(&resources_[kAttributeArray]);
+  QueueInfoRequests<BufferObject, BufferInfo>(&resources_[kBufferObject]);
+  QueueInfoRequests<FramebufferObject, FramebufferInfo>(
+      &resources_[kFramebufferObject]);
+  QueueInfoRequests<Sampler, SamplerInfo>(&resources_[kSampler]);
+  QueueInfoRequests<ShaderProgram, ProgramInfo>(&resources_[kShaderProgram]);
+  QueueInfoRequests<Shader, ShaderInfo>(&resources_[kShader]);
+  QueueInfoRequests<TextureBase, TextureInfo>(&resources_[kTexture]);
+  QueueDataRequests<GpuMemoryInfo>();
+  QueueDataRequests<PlatformInfo>();
+  QueueDataRequests<TextureImageInfo>();
+
+  // Callbacks run without any lock held, so they may make new requests;
+  // those are processed at the next call.
+  const uint64 budget = use_budget ? info_request_budget_.load() : 0U;
+  const port::Timer timer;
+  while (!pending_info_requests_.empty()) {
+    const std::function<void(ResourceBinder*)> request =
+        pending_info_requests_.front();
+    pending_info_requests_.pop_front();
+    request(resource_binder);
+    if (budget &&
+        std::chrono::duration_cast<std::chrono::microseconds>(timer.Get())
+                .count() >= static_cast<int64>(budget))
+      break;
+  }
 }
 
 // Helper class that wraps a push and pop of a marker onto a stream annotator.
@@ -1778,7 +5215,9 @@ class Renderer::ScopedLabel {
               const std::string& label)
       : annotator_(rb->GetStreamAnnotator()),
         needs_pop_(false) {
-    if (rb->GetGraphicsManager()->GetTracingStream() && label.length()) {
+    const GraphicsManagerPtr& gm = rb->GetGraphicsManager();
+    if ((gm->GetTracingStream() || gm->GetBinaryTrace().Get()) &&
+        label.length()) {
       annotator_->Push(label + " [" + base::ValueToString(address) + "]");
       needs_pop_ = true;
     }
@@ -1832,6 +5271,10 @@ class Renderer::Resource : public Renderer::ResourceManager::Resource {
   // Returns the OpenGL object ID for this Resource.
   GLuint GetId() const { return id_; }
 
+  std::string GetHolderLabel() const override {
+    return holder_ ? holder_->GetLabel() : std::string();
+  }
+
  protected:
   typedef Renderer::Resource<NumModifiedBits> BaseResourceType;
 
@@ -1857,8 +5300,12 @@ class Renderer::Resource : public Renderer::ResourceManager::Resource {
 
   void Release(bool can_make_gl_calls) override { DetachFromHolder(); }
 
-  // Modified bit accessors.
-  void OnChanged(const int bit) override { modified_bits_.set(bit); }
+  // Modified bit accessors. A changed resource is also added to the manager's
+  // list of resources to update before drawing, if it keeps one.
+  void OnChanged(const int bit) override {
+    modified_bits_.set(bit);
+    if (ResourceManager* rm = GetResourceManager()) rm->MarkDirty(this);
+  }
 
   void ResetModifiedBit(int bit) { modified_bits_.reset(bit); }
 
@@ -1927,7 +5374,8 @@ class Renderer::SamplerResource : public Resource<Sampler::kNumChanges> {
  public:
   SamplerResource(ResourceBinder* rb, ResourceManager* rm,
                   const Sampler& sampler, GLuint id)
-      : Renderer::Resource<Sampler::kNumChanges>(rm, sampler, id) {}
+      : Renderer::Resource<Sampler::kNumChanges>(rm, sampler, id),
+        shared_sampler_(nullptr) {}
 
   ~SamplerResource() override {
     DCHECK(id_ == 0U || !portgfx::Visual::GetCurrent());
@@ -1948,72 +5396,175 @@ class Renderer::SamplerResource : public Resource<Sampler::kNumChanges> {
   const Sampler& GetSampler() const {
     return static_cast<const Sampler&>(GetHolder());
   }
+
+ private:
+  // Returns the anisotropy to set, clamped to what OpenGL supports, or 0 if
+  // anisotropic filtering is not supported.
+  float GetEffectiveMaxAnisotropy() const;
+  // Sets the parameters of the sampler object whose modified bits are set,
+  // or all of them if |all| is true.
+  void SetParameters(bool all);
+  // Makes this use the shared sampler object for the current state of the
+  // Sampler, creating it if necessary. Returns false if it cannot be created.
+  bool UpdateSharedSampler();
+  // Removes a reference to the passed shared sampler, deleting its sampler
+  // object if that was the last one.
+  void ReleaseSharedSampler(SharedSamplerCache::Sampler* sampler,
+                            bool can_make_gl_calls);
+
+  // The sampler object shared with other Samplers, if any.
+  SharedSamplerCache::Sampler* shared_sampler_;
 };
 
+float Renderer::SamplerResource::GetEffectiveMaxAnisotropy() const {
+  GraphicsManager* gm = GetGraphicsManager();
+  if (!gm->IsExtensionSupported("texture_filter_anisotropic"))
+    return 0.f;
+  return std::min(GetSampler().GetMaxAnisotropy(),
+                  gm->GetCapabilityValue<float>(
+                      GraphicsManager::kMaxTextureMaxAnisotropy));
+}
+
+void Renderer::SamplerResource::SetParameters(bool all) {
+  const Sampler& sampler = GetSampler();
+  GraphicsManager* gm = GetGraphicsManager();
+  if ((all || TestModifiedBit(Sampler::kMaxAnisotropyChanged)) &&
+      gm->IsExtensionSupported("texture_filter_anisotropic"))
+    gm->SamplerParameterf(id_, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                          GetEffectiveMaxAnisotropy());
+  if (all || TestModifiedBit(Sampler::kMinFilterChanged))
+    gm->SamplerParameteri(
+        id_, GL_TEXTURE_MIN_FILTER,
+        base::EnumHelper::GetConstant(sampler.GetMinFilter()));
+  if (all || TestModifiedBit(Sampler::kMagFilterChanged))
+    gm->SamplerParameteri(
+        id_, GL_TEXTURE_MAG_FILTER,
+        base::EnumHelper::GetConstant(sampler.GetMagFilter()));
+  if (all || TestModifiedBit(Sampler::kWrapSChanged))
+    gm->SamplerParameteri(
+        id_, GL_TEXTURE_WRAP_S,
+        base::EnumHelper::GetConstant(sampler.GetWrapS()));
+  if (all || TestModifiedBit(Sampler::kWrapTChanged))
+    gm->SamplerParameteri(
+        id_, GL_TEXTURE_WRAP_T,
+        base::EnumHelper::GetConstant(sampler.GetWrapT()));
+  if (all || TestModifiedBit(Sampler::kCompareFunctionChanged))
+    gm->SamplerParameteri(
+        id_, GL_TEXTURE_COMPARE_FUNC,
+        base::EnumHelper::GetConstant(sampler.GetCompareFunction()));
+  if (all || TestModifiedBit(Sampler::kCompareModeChanged))
+    gm->SamplerParameteri(
+        id_, GL_TEXTURE_COMPARE_MODE,
+        sampler.GetCompareMode() == Sampler::kCompareToTexture
+            ? GL_COMPARE_REF_TO_TEXTURE
+            : GL_NONE);
+  if (all || TestModifiedBit(Sampler::kMaxLodChanged))
+    gm->SamplerParameterf(id_, GL_TEXTURE_MAX_LOD, sampler.GetMaxLod());
+  if (all || TestModifiedBit(Sampler::kMinLodChanged))
+    gm->SamplerParameterf(id_, GL_TEXTURE_MIN_LOD, sampler.GetMinLod());
+  if (all || TestModifiedBit(Sampler::kWrapRChanged))
+    gm->SamplerParameteri(
+        id_, GL_TEXTURE_WRAP_R,
+        base::EnumHelper::GetConstant(sampler.GetWrapR()));
+}
+
+bool Renderer::SamplerResource::UpdateSharedSampler() {
+  const Sampler& sampler = GetSampler();
+  SharedSamplerCache* cache = GetResourceManager()->GetSharedSamplerCache();
+  SharedSamplerCache::State state(*cache);
+  const float values[] = {GetEffectiveMaxAnisotropy(), sampler.GetMinLod(),
+                          sampler.GetMaxLod()};
+  for (size_t i = 0; i < ARRAYSIZE(values); ++i) {
+    uint32 bits;
+    memcpy(&bits, &values[i], sizeof(bits));
+    state.push_back(bits);
+  }
+  state.push_back(sampler.GetMinFilter());
+  state.push_back(sampler.GetMagFilter());
+  state.push_back(sampler.GetWrapS());
+  state.push_back(sampler.GetWrapT());
+  state.push_back(sampler.GetWrapR());
+  state.push_back(sampler.GetCompareFunction());
+  state.push_back(sampler.GetCompareMode());
+
+  // The new sampler is acquired before the previous one is released so that
+  // an unchanged state does not delete its sampler object.
+  SharedSamplerCache::Sampler* previous = shared_sampler_;
+  shared_sampler_ = cache->Acquire(state);
+  if (!shared_sampler_ || shared_sampler_->id != id_)
+    UnbindAll();
+  if (shared_sampler_) {
+    id_ = shared_sampler_->id;
+  } else {
+    GLuint id = 0U;
+    GetGraphicsManager()->GenSamplers(1, &id);
+    if (!id) {
+      shared_sampler_ = previous;
+      return false;
+    }
+    id_ = id;
+    SetParameters(true);
+    GLuint unused_id = 0U;
+    shared_sampler_ = cache->Add(state, id, &unused_id);
+    if (unused_id) {
+      id_ = shared_sampler_->id;
+      GetGraphicsManager()->DeleteSamplers(1, &unused_id);
+    }
+  }
+  ReleaseSharedSampler(previous, true);
+  return true;
+}
+
+void Renderer::SamplerResource::ReleaseSharedSampler(
+    SharedSamplerCache::Sampler* sampler, bool can_make_gl_calls) {
+  if (sampler) {
+    const GLuint id =
+        GetResourceManager()->GetSharedSamplerCache()->Release(sampler);
+    if (id && can_make_gl_calls)
+      GetGraphicsManager()->DeleteSamplers(1, &id);
+  }
+}
+
 void Renderer::SamplerResource::Update(ResourceBinder* rb) {
-  if (GetGraphicsManager()->IsFunctionGroupAvailable(
-          GraphicsManager::kSamplerObjects)) {
-    const Sampler& sampler = GetSampler();
+  if (!GetGraphicsManager()->IsFunctionGroupAvailable(
+          GraphicsManager::kSamplerObjects))
+    return;
+  const bool share =
+      resource_owns_gl_id_ && GetResourceManager()->ShouldShareSamplers();
+  if (shared_sampler_ && !share) {
+    // Sharing was turned off, so this needs a sampler object of its own.
+    UnbindAll();
+    ReleaseSharedSampler(shared_sampler_, true);
+    shared_sampler_ = nullptr;
+    id_ = 0U;
+    SetModifiedBits();
+  }
+  if (!AnyModifiedBitsSet())
+    return;
 
-    if (AnyModifiedBitsSet()) {
-      ScopedResourceLabel label(this, rb);
-      // Generate the sampler object.
-      GraphicsManager* gm = GetGraphicsManager();
-      DCHECK(gm);
-      if (!id_) gm->GenSamplers(1, &id_);
-      if (id_) {
-        // Note that we explicitly do not label sampler objects as many GL
-        // drivers do not support the GL_SAMPLER label.
-
-        // Make any changes to the sampler.
-        if (TestModifiedBit(Sampler::kMaxAnisotropyChanged) &&
-            gm->IsExtensionSupported("texture_filter_anisotropic")) {
-          const float aniso =
-              std::min(sampler.GetMaxAnisotropy(),
-                       gm->GetCapabilityValue<float>(
-                           GraphicsManager::kMaxTextureMaxAnisotropy));
-          gm->SamplerParameterf(id_, GL_TEXTURE_MAX_ANISOTROPY_EXT, aniso);
-        }
-        if (TestModifiedBit(Sampler::kMinFilterChanged))
-          gm->SamplerParameteri(
-              id_, GL_TEXTURE_MIN_FILTER,
-              base::EnumHelper::GetConstant(sampler.GetMinFilter()));
-        if (TestModifiedBit(Sampler::kMagFilterChanged))
-          gm->SamplerParameteri(
-              id_, GL_TEXTURE_MAG_FILTER,
-              base::EnumHelper::GetConstant(sampler.GetMagFilter()));
-        if (TestModifiedBit(Sampler::kWrapSChanged))
-          gm->SamplerParameteri(
-              id_, GL_TEXTURE_WRAP_S,
-              base::EnumHelper::GetConstant(sampler.GetWrapS()));
-        if (TestModifiedBit(Sampler::kWrapTChanged))
-          gm->SamplerParameteri(
-              id_, GL_TEXTURE_WRAP_T,
-              base::EnumHelper::GetConstant(sampler.GetWrapT()));
-        if (TestModifiedBit(Sampler::kCompareFunctionChanged))
-          gm->SamplerParameteri(
-              id_, GL_TEXTURE_COMPARE_FUNC,
-              base::EnumHelper::GetConstant(sampler.GetCompareFunction()));
-        if (TestModifiedBit(Sampler::kCompareModeChanged))
-          gm->SamplerParameteri(
-              id_, GL_TEXTURE_COMPARE_MODE,
-              sampler.GetCompareMode() == Sampler::kCompareToTexture
-                  ? GL_COMPARE_REF_TO_TEXTURE
-                  : GL_NONE);
-        if (TestModifiedBit(Sampler::kMaxLodChanged))
-          gm->SamplerParameterf(id_, GL_TEXTURE_MAX_LOD, sampler.GetMaxLod());
-        if (TestModifiedBit(Sampler::kMinLodChanged))
-          gm->SamplerParameterf(id_, GL_TEXTURE_MIN_LOD, sampler.GetMinLod());
-        if (TestModifiedBit(Sampler::kWrapRChanged))
-          gm->SamplerParameteri(
-              id_, GL_TEXTURE_WRAP_R,
-              base::EnumHelper::GetConstant(sampler.GetWrapR()));
-
-        ResetModifiedBits();
-      } else {
-        LOG(ERROR) << "***ION: Unable to create sampler object";
-      }
+  ScopedResourceLabel label(this, rb);
+  rb->CountResourceUpdate();
+  // Note that we explicitly do not label sampler objects as many GL drivers do
+  // not support the GL_SAMPLER label.
+  if (share) {
+    if (!UpdateSharedSampler()) {
+      LOG(ERROR) << "***ION: Unable to create sampler object";
+      return;
     }
+    ResetModifiedBits();
+    return;
+  }
+
+  // Generate the sampler object.
+  GraphicsManager* gm = GetGraphicsManager();
+  DCHECK(gm);
+  if (!id_) gm->GenSamplers(1, &id_);
+  if (id_) {
+    // Make any changes to the sampler.
+    SetParameters(false);
+    ResetModifiedBits();
+  } else {
+    LOG(ERROR) << "***ION: Unable to create sampler object";
   }
 }
 
@@ -2030,7 +5581,12 @@ void Renderer::SamplerResource::Unbind(ResourceBinder* rb) {
 
 void Renderer::SamplerResource::Release(bool can_make_gl_calls) {
   BaseResourceType::Release(can_make_gl_calls);
-  if (id_) {
+  if (shared_sampler_) {
+    UnbindAll();
+    ReleaseSharedSampler(shared_sampler_, can_make_gl_calls);
+    shared_sampler_ = nullptr;
+    id_ = 0;
+  } else if (id_) {
     UnbindAll();
     if (resource_owns_gl_id_ && can_make_gl_calls)
       GetGraphicsManager()->DeleteSamplers(1, &id_);
@@ -2064,7 +5620,12 @@ class Renderer::TextureResource : public Resource<CubeMapTexture::kNumChanges> {
         wrap_r_(base::InvalidEnumValue<Sampler::WrapMode>()),
         wrap_s_(base::InvalidEnumValue<Sampler::WrapMode>()),
         wrap_t_(base::InvalidEnumValue<Sampler::WrapMode>()),
-        multisample_enabled_by_renderer_(false) {
+        multisample_enabled_by_renderer_(false),
+        contents_modified_(false),
+        storage_format_(Image::kRgba8888),
+        storage_levels_(0U),
+        streamed_base_level_(0U),
+        last_streamed_frame_(0U) {
     DCHECK_GE(static_cast<int>(CubeMapTexture::kNumChanges),
               static_cast<int>(Texture::kNumChanges));
   }
@@ -2097,6 +5658,15 @@ class Renderer::TextureResource : public Resource<CubeMapTexture::kNumChanges> {
     UnbindAll();
   }
 
+  void OnChanged(const int bit) override {
+    // Rendering into the texture changes its contents on the GPU only.
+    if (bit == TextureBase::kContentsImplicitlyChanged)
+      contents_modified_ = true;
+    Renderer::Resource<CubeMapTexture::kNumChanges>::OnChanged(bit);
+  }
+
+  bool IsEvictable() const override;
+
   // Determines an image unit number to use to bind this.
   GLuint ObtainImageUnit(ResourceBinder* rb, const void* assoc, int old_unit) {
     // If the image isn't updated a warning will be logged in IsComplete()
@@ -2120,7 +5690,24 @@ class Renderer::TextureResource : public Resource<CubeMapTexture::kNumChanges> {
   // Updates the texture's image data.
   void UpdateCubeMapImageState(GraphicsManager* gm);
   void UpdateTextureImageState(GraphicsManager* gm, bool multisample,
-                               bool multisample_changed);
+                               bool multisample_changed,
+                               bool storage_allocated);
+
+  // Returns the number of mipmap levels to allocate for the passed Texture
+  // with immutable storage, or 0 if its storage should not be immutable.
+  size_t GetRequiredStorageLevels(const TextureBase& texture,
+                                  bool multisample, GraphicsManager* gm) const;
+  // Allocates immutable storage with the passed number of levels if it is
+  // not 0, first replacing the texture object if the storage it already has
+  // does not match. Returns whether new storage was allocated.
+  bool UpdateImmutableStorage(const TextureBase& texture, size_t levels,
+                              ResourceBinder* rb, GLuint unit,
+                              GraphicsManager* gm);
+  // Uploads the next mipmap level of a Texture whose levels are streamed
+  // lowest resolution first, at most once per frame, as well as any changed
+  // levels that have already been streamed.
+  void StreamMipmaps(const Texture& texture, bool storage_allocated,
+                     GraphicsManager* gm);
 
   // Creates an immutable texture with TexStorage?D().
   void CreateImmutableTexture(const Image& image, const bool multisample,
@@ -2133,7 +5720,7 @@ class Renderer::TextureResource : public Resource<CubeMapTexture::kNumChanges> {
                    int samples, bool fixed_sample_locations,
                    bool is_full_image, const Point3ui& offset,
                    GraphicsManager* gm);
-  void UpdateMemoryUsage(TextureBase::TextureType type);
+  void UpdateMemoryUsage(TextureBase::TextureType type, bool multisample);
   void UpdateMipmapGeneration(const Sampler& sampler, bool image_has_changed,
                               GraphicsManager* gm);
   bool UpdateMipmap0Image(const Image& image, const TextureBase& texture,
@@ -2168,6 +5755,22 @@ class Renderer::TextureResource : public Resource<CubeMapTexture::kNumChanges> {
   // Tracking whether multisampling has been enabled by the renderer.
   bool multisample_enabled_by_renderer_;
 
+  // Whether the texture contents differ from its images, because of sub-image
+  // updates or rendering.
+  bool contents_modified_;
+
+  // The format and dimensions of the level 0 image and the number of levels
+  // that immutable storage was allocated for with kUseImmutableTextureStorage,
+  // or 0 levels if it was not.
+  Image::Format storage_format_;
+  math::Vector3ui storage_size_;
+  size_t storage_levels_;
+  // The finest mipmap level uploaded so far while levels are streamed lowest
+  // resolution first, or 0 if all levels have been uploaded, and the frame in
+  // which the last level was uploaded.
+  size_t streamed_base_level_;
+  uint64 last_streamed_frame_;
+
  private:
   // Updates this TextureResource and binds it to the passed unit.
   void UpdateWithUnit(ResourceBinder* rb, GLuint unit);
@@ -2247,12 +5850,47 @@ class Renderer::TextureResource : public Resource<CubeMapTexture::kNumChanges> {
   }
 };
 
+bool Renderer::TextureResource::IsEvictable() const {
+  if (!HasHolder() || !resource_owns_gl_id_ || !id_ || contents_modified_)
+    return false;
+  // Every image must still have its data so that it can be uploaded again.
+  const TextureBase& base = GetTexture<TextureBase>();
+  if (const Image* image = base.GetImmutableImage().Get())
+    return IsImageDataAvailable(*image);
+  size_t image_count = 0U;
+  if (base.GetTextureType() == TextureBase::kCubeMapTexture) {
+    const CubeMapTexture& texture = GetTexture<CubeMapTexture>();
+    for (int i = 0; i < 6; ++i) {
+      const CubeMapTexture::CubeFace face =
+          static_cast<CubeMapTexture::CubeFace>(i);
+      for (size_t level = 0; level < kMipmapSlotCount; ++level) {
+        if (texture.HasImage(face, level)) {
+          if (!IsImageDataAvailable(*texture.GetImage(face, level)))
+            return false;
+          ++image_count;
+        }
+      }
+    }
+  } else {
+    const Texture& texture = GetTexture<Texture>();
+    for (size_t level = 0; level < kMipmapSlotCount; ++level) {
+      if (texture.HasImage(level)) {
+        if (!IsImageDataAvailable(*texture.GetImage(level)))
+          return false;
+        ++image_count;
+      }
+    }
+  }
+  return image_count > 0U;
+}
+
 void Renderer::TextureResource::Bind(ResourceBinder* rb) {
   const GLuint unit = ObtainImageUnit(rb, this, rb->GetLastBoundUnit(this));
   BindToUnit(rb, unit);
 }
 
 void Renderer::TextureResource::BindToUnit(ResourceBinder* rb, GLuint unit) {
+  MarkUsed();
   UpdateWithUnit(rb, unit);
   if (id_) {
     ScopedResourceLabel label(this, rb);
@@ -2333,7 +5971,8 @@ void Renderer::TextureResource::UploadImage(const Image& image, GLenum target,
   last_uploaded_components_ = component_count;
 
   const DataContainerPtr& container = image.GetData();
-  const void* data = container.Get() ? container->GetData() : NULL;
+  const void* data =
+      container.Get() && container->ReloadData() ? container->GetData() : NULL;
   gm->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
   const bool multisample = (samples > 0) &&
@@ -2353,19 +5992,37 @@ void Renderer::TextureResource::UploadImage(const Image& image, GLenum target,
     // Don't actually call a TexImage function if the dimensions of the texture
     // are zero. Even if data is NULL we will still set the texture size and
     // format.
-    if (image.IsCompressed() && data) {
+    // When streaming, the data is copied into a pixel unpack buffer and
+    // OpenGL reads it from offset 0 of the buffer.
+    PixelUnpackBufferRing* ring =
+        data && GetResourceManager()->ShouldStreamTexture(
+                    GetTexture<TextureBase>(), gm)
+            ? GetResourceManager()->GetPixelUnpackBufferRing()
+            : NULL;
+    if (ring && !ring->BindData(data, image.GetDataSize(), gm))
+      ring = NULL;
+    const void* pixels = ring ? NULL : data;
+    if (image.IsCompressed() && data &&
+        !gm->IsCompressedTextureFormatSupported(pf.internal_format)) {
+      LOG(ERROR) << "***ION: Texture \""
+                 << GetTexture<TextureBase>().GetLabel()
+                 << "\" contains an Image in compressed format "
+                 << Image::GetFormatString(image.GetFormat())
+                 << ", which is not supported by the local OpenGL "
+                 << "implementation; it will not be uploaded.";
+    } else if (image.IsCompressed() && data) {
       if (image.GetDimensions() == Image::k2d) {
         const size_t data_size = Image::ComputeDataSize(
             image.GetFormat(), image.GetWidth(), image.GetHeight());
         if (is_full_image) {
           gm->CompressedTexImage2D(target, level, pf.internal_format,
                                    image.GetWidth(), image.GetHeight(), 0,
-                                   static_cast<GLsizei>(data_size), data);
+                                   static_cast<GLsizei>(data_size), pixels);
         } else {
           gm->CompressedTexSubImage2D(target, level, offset[0], offset[1],
                                       image.GetWidth(), image.GetHeight(),
                                       pf.internal_format,
-                                      static_cast<GLsizei>(data_size), data);
+                                      static_cast<GLsizei>(data_size), pixels);
         }
       } else if (image.GetDimensions() == Image::k3d) {
         const size_t data_size =
@@ -2376,12 +6033,12 @@ void Renderer::TextureResource::UploadImage(const Image& image, GLenum target,
             gm->CompressedTexImage3D(target, level, pf.internal_format,
                                      image.GetWidth(), image.GetHeight(),
                                      image.GetDepth(), 0,
-                                     static_cast<GLsizei>(data_size), data);
+                                     static_cast<GLsizei>(data_size), pixels);
           } else {
             gm->CompressedTexSubImage3D(
                 target, level, offset[0], offset[1], offset[2],
                 image.GetWidth(), image.GetHeight(), image.GetDepth(),
-                pf.internal_format, static_cast<GLsizei>(data_size), data);
+                pf.internal_format, static_cast<GLsizei>(data_size), pixels);
           }
         } else {
           LOG(ERROR) << "***ION: 3D texturing is not supported by the local "
@@ -2399,12 +6056,12 @@ void Renderer::TextureResource::UploadImage(const Image& image, GLenum target,
                                       fixed_sample_locations);
           } else {
             gm->TexImage2D(target, level, pf.internal_format, image.GetWidth(),
-                           image.GetHeight(), 0, pf.format, pf.type, data);
+                           image.GetHeight(), 0, pf.format, pf.type, pixels);
           }
         } else {
           gm->TexSubImage2D(target, level, offset[0], offset[1],
                             image.GetWidth(), image.GetHeight(), pf.format,
-                            pf.type, data);
+                            pf.type, pixels);
         }
       } else if (image.GetDimensions() == Image::k3d) {
         if (gm->IsFunctionGroupAvailable(GraphicsManager::kTexture3d)) {
@@ -2416,12 +6073,12 @@ void Renderer::TextureResource::UploadImage(const Image& image, GLenum target,
             } else {
               gm->TexImage3D(target, level, pf.internal_format,
                              image.GetWidth(), image.GetHeight(),
-                             image.GetDepth(), 0, pf.format, pf.type, data);
+                             image.GetDepth(), 0, pf.format, pf.type, pixels);
             }
           } else {
             gm->TexSubImage3D(target, level, offset[0], offset[1], offset[2],
                               image.GetWidth(), image.GetHeight(),
-                              image.GetDepth(), pf.format, pf.type, data);
+                              image.GetDepth(), pf.format, pf.type, pixels);
           }
         } else {
           LOG(ERROR) << "***ION: 3D texturing is not supported by the local "
@@ -2431,6 +6088,8 @@ void Renderer::TextureResource::UploadImage(const Image& image, GLenum target,
         }
       }
     }
+    if (ring)
+      ring->Unbind(gm);
   }
   if (data)
     container->WipeData();
@@ -2465,8 +6124,11 @@ void Renderer::TextureResource::UpdateState(const TextureBase& texture,
 
   if (!id_ || AnyModifiedBitsSet()) {
     ScopedResourceLabel label(this, rb);
-    if (!id_)
-      gm->GenTextures(1, &id_);
+    rb->CountResourceUpdate();
+    if (!id_) {
+      id_ = GetResourceManager()->GetObjectNameCache()->Generate(
+          ObjectNameCache::kTextureNames, gm);
+    }
     if (id_) {
       UpdateTextureTarget(gm, multisample);
 
@@ -2487,11 +6149,15 @@ void Renderer::TextureResource::UpdateState(const TextureBase& texture,
                                  texture.IsMultisampleFixedSampleLocations(),
                                  texture.GetImmutableLevels(), gm);
       }
+      const bool storage_allocated = UpdateImmutableStorage(
+          texture, GetRequiredStorageLevels(texture, multisample, gm), rb,
+          unit, gm);
       if (texture.GetTextureType() == TextureBase::kCubeMapTexture)
         UpdateCubeMapImageState(gm);
       else
-        UpdateTextureImageState(gm, multisample, multisample_changed);
-      UpdateMemoryUsage(texture.GetTextureType());
+        UpdateTextureImageState(gm, multisample, multisample_changed,
+                                storage_allocated);
+      UpdateMemoryUsage(texture.GetTextureType(), multisample);
       if (TestModifiedBit(TextureBase::kSamplerChanged) &&
           !GetGraphicsManager()->IsFunctionGroupAvailable(
               GraphicsManager::kSamplerObjects))
@@ -2500,6 +6166,11 @@ void Renderer::TextureResource::UpdateState(const TextureBase& texture,
       UpdateTextureState(texture, gm);
       SetObjectLabel(gm, GL_TEXTURE, id_, texture.GetLabel());
       ResetModifiedBits();
+      // Keep the next streamed mipmap level pending so that it is uploaded in
+      // a later frame.
+      if (streamed_base_level_)
+        OnChanged(Texture::kMipmapChanged +
+                  static_cast<int>(streamed_base_level_) - 1);
     } else {
       LOG(ERROR) << "***ION: Unable to create texture object";
     }
@@ -2571,9 +6242,11 @@ void Renderer::TextureResource::UpdateSamplerState(const Sampler& sampler,
 void Renderer::TextureResource::UpdateTextureState(const TextureBase& texture,
                                                    GraphicsManager* gm) {
   if (gm->GetGlVersion() > 20) {
+    // Levels finer than those streamed so far must not be used.
     if (TestModifiedBit(TextureBase::kBaseLevelChanged))
       gm->TexParameteri(gl_target_, GL_TEXTURE_BASE_LEVEL,
-                        texture.GetBaseLevel());
+                        std::max(texture.GetBaseLevel(),
+                                 static_cast<int>(streamed_base_level_)));
     if (TestModifiedBit(TextureBase::kMaxLevelChanged))
       gm->TexParameteri(gl_target_, GL_TEXTURE_MAX_LEVEL,
                         texture.GetMaxLevel());
@@ -2615,8 +6288,8 @@ void Renderer::TextureResource::Release(bool can_make_gl_calls) {
   BaseResourceType::Release(can_make_gl_calls);
   if (id_) {
     // Unbind all bindings and remove key from unit mapping.
-    base::ReadLock read_lock(GetResourceBinderLock());
-    base::ReadGuard read_guard(&read_lock);
+    base::BigReaderReadLock read_lock(GetResourceBinderLock());
+    base::BigReaderReadGuard read_guard(&read_lock);
     ResourceBinderMap& binders = GetResourceBinderMap();
     for (ResourceBinderMap::iterator it = binders.begin();
          it != binders.end();
@@ -2625,8 +6298,10 @@ void Renderer::TextureResource::Release(bool can_make_gl_calls) {
       it->second->ClearAssignedImageUnit(this);
     }
 
-    if (resource_owns_gl_id_ && can_make_gl_calls)
-      GetGraphicsManager()->DeleteTextures(1, &id_);
+    if (resource_owns_gl_id_ && can_make_gl_calls) {
+      GetResourceManager()->GetObjectNameCache()->Delete(
+          ObjectNameCache::kTextureNames, id_, GetGraphicsManager());
+    }
     SetUsedGpuMemory(0U);
     id_ = 0;
   }
@@ -2683,13 +6358,14 @@ bool Renderer::TextureResource::UpdateMipmap0Image(
 
   const bool mipmap_changed = TestModifiedBit(mipmap_changed_bit);
 
-  // Update the 0th level image if necessary.
+  // Update the 0th level image if necessary. Images are uploaded into
+  // immutable storage rather than respecifying it.
   if ((mipmap_changed || multisample_changed) && CheckImage(image, texture)) {
     const int samples = texture.GetMultisampleSamples();
     const bool fixed_sample_locations =
         texture.IsMultisampleFixedSampleLocations();
-    UploadImage(image, target, 0, samples, fixed_sample_locations, true,
-                Point3ui(), gm);
+    UploadImage(image, target, 0, samples, fixed_sample_locations,
+                !storage_levels_, Point3ui(), gm);
   }
 
   // The number of levels (including the 0th level) required for a full
@@ -2723,7 +6399,8 @@ bool Renderer::TextureResource::UpdateImage(const Image& image0,
                                                   &expected_width,
                                                   &expected_height)) {
     // We can assume not multisampling.
-    UploadImage(mipmap, target, level, 0, false, true, Point3ui(), gm);
+    UploadImage(mipmap, target, level, 0, false, !storage_levels_, Point3ui(),
+                gm);
     return true;
   }
   return false;
@@ -2738,59 +6415,108 @@ void Renderer::TextureResource::UpdateSubImages(
     // We can assume not multisampling.
     UploadImage(image, target, static_cast<GLint>(images[i].level), 0, false,
                 false, images[i].offset, gm);
+    contents_modified_ = true;
+  }
+}
+
+// Returns the number of levels in a full mipmap chain for the passed Image.
+// The depth of an Image only shrinks with each level of a 3D texture, and the
+// height not at all for a 1D array texture.
+static size_t GetMipmapChainLevels(const Image& image, GLenum target) {
+  uint32 size = image.GetWidth();
+  if (target != GL_TEXTURE_1D_ARRAY)
+    size = std::max(size, image.GetHeight());
+  if (target == GL_TEXTURE_3D)
+    size = std::max(size, image.GetDepth());
+  return size ? math::Log2(size) + 1U : 0U;
+}
+
+// Returns the number of bytes in the first levels mipmap levels of a texture
+// with the passed target whose level 0 has the dimensions of image.
+static size_t ComputeMipmapChainSize(const Image& image, GLenum target,
+                                     size_t levels) {
+  uint32 width = image.GetWidth();
+  uint32 height = image.GetHeight();
+  uint32 depth =
+      image.GetDimensions() == Image::k3d ? image.GetDepth() : 1U;
+  size_t data_size = 0U;
+  for (size_t i = 0; i < levels; ++i) {
+    data_size +=
+        Image::ComputeDataSize(image.GetFormat(), width, height, depth);
+    width = std::max(1U, width / 2U);
+    if (target != GL_TEXTURE_1D_ARRAY)
+      height = std::max(1U, height / 2U);
+    if (target == GL_TEXTURE_3D)
+      depth = std::max(1U, depth / 2U);
   }
+  return data_size;
 }
 
 void Renderer::TextureResource::UpdateMemoryUsage(
-    TextureBase::TextureType type) {
-  size_t data_size = 0U;
-  if (type == TextureBase::kTexture) {
-    const Texture& tex = GetTexture<Texture>();
-    if (tex.HasImage(0)) {
-      const Image& image = *tex.GetImage(0);
-      const Sampler* samp = tex.GetSampler().Get();
-      const bool auto_mipmap = samp && samp->IsAutogenerateMipmapsEnabled();
-      if (tex.GetImageCount() > 1 || auto_mipmap) {
-        data_size = Image::ComputeDataSize(image.GetFormat(), image.GetWidth(),
-                                           image.GetHeight());
-        // Account for the mipmap hierarchy, where we have a geometric series:
-        // x + x/4 + x/16 + x/64 + ... = x / (1 - 1/4) = 4 x / 3.
-        data_size = (data_size * 4) / 3;
-      } else {
-        data_size = Image::ComputeDataSize(image.GetFormat(), image.GetWidth(),
-                                                 image.GetHeight());
+    TextureBase::TextureType type, bool multisample) {
+  const TextureBase& base = GetTexture<TextureBase>();
+  const Sampler* samp = base.GetSampler().Get();
+  const bool auto_mipmap = samp && samp->IsAutogenerateMipmapsEnabled();
+  const Image* image = base.GetImmutableImage().Get();
+  size_t levels = base.GetImmutableLevels();
+  if (!image) {
+    // Setting any mipmap besides level 0 makes OpenGL generate the rest.
+    size_t image_count = 0U;
+    if (type == TextureBase::kTexture) {
+      const Texture& tex = GetTexture<Texture>();
+      if (tex.HasImage(0)) {
+        image = tex.GetImage(0).Get();
+        image_count = tex.GetImageCount();
       }
-    }
-  } else {  // kCubeMapTexture.
-    const CubeMapTexture& tex = GetTexture<CubeMapTexture>();
-    if (tex.HasImage(CubeMapTexture::kNegativeX, 0)) {
-      const Image& image = *tex.GetImage(CubeMapTexture::kNegativeX, 0);
-      const Sampler* samp = tex.GetSampler().Get();
-      const bool auto_mipmap = samp && samp->IsAutogenerateMipmapsEnabled();
-      if (tex.GetImageCount(CubeMapTexture::kNegativeX) > 1 || auto_mipmap) {
-        data_size = Image::ComputeDataSize(image.GetFormat(), image.GetWidth(),
-                                           image.GetHeight());
-        // Account for all faces and mipmaps.
-        data_size = data_size * 8;
-      } else {
-        data_size = Image::ComputeDataSize(image.GetFormat(), image.GetWidth(),
-                                           image.GetHeight());
-        data_size *= 6;
+    } else {  // kCubeMapTexture.
+      const CubeMapTexture& tex = GetTexture<CubeMapTexture>();
+      if (tex.HasImage(CubeMapTexture::kNegativeX, 0)) {
+        image = tex.GetImage(CubeMapTexture::kNegativeX, 0).Get();
+        image_count = tex.GetImageCount(CubeMapTexture::kNegativeX);
       }
     }
+    levels = 1U;
+    if (image && !multisample && (image_count > 1U || auto_mipmap))
+      levels = GetMipmapChainLevels(*image, gl_target_);
   }
 
+  size_t data_size = 0U;
+  if (image) {
+    data_size = ComputeMipmapChainSize(*image, gl_target_, levels);
+    // Each sample of a multisampled texture is stored separately.
+    if (multisample)
+      data_size *= std::max(1, base.GetMultisampleSamples());
+    if (type == TextureBase::kCubeMapTexture)
+      data_size *= 6U;
+  }
   SetUsedGpuMemory(data_size);
 }
 
 void Renderer::TextureResource::UpdateTextureImageState(
     GraphicsManager* gm, const bool multisample,
-    const bool multisample_changed) {
+    const bool multisample_changed, const bool storage_allocated) {
   const Texture& texture = GetTexture<Texture>();
   const bool mipmap_changed = TestModifiedBitRange(
       Texture::kMipmapChanged, Texture::kMipmapChanged + kMipmapSlotCount);
+  // All images must be uploaded again into newly allocated storage.
+  const bool images_reset = multisample_changed || storage_allocated;
 
-  if ((mipmap_changed || multisample_changed) && texture.HasImage(0)) {
+  // Stream the levels of a full pyramid into new storage if requested.
+  if (storage_allocated) {
+    streamed_base_level_ = 0U;
+    if (storage_levels_ > 1U &&
+        GetResourceManager()->ShouldStreamMipmaps(gm)) {
+      size_t level = 0U;
+      while (level < storage_levels_ && texture.HasImage(level))
+        ++level;
+      if (level == storage_levels_)
+        streamed_base_level_ = storage_levels_;
+    }
+  }
+
+  if (streamed_base_level_) {
+    StreamMipmaps(texture, storage_allocated, gm);
+  } else if ((mipmap_changed || images_reset) && texture.HasImage(0)) {
     if (multisample) {
       const Image& image0 = *texture.GetImage(0);
       size_t required_levels = 0U;
@@ -2804,14 +6530,14 @@ void Renderer::TextureResource::UpdateTextureImageState(
       size_t required_levels = 0U;
       const bool generate_mipmaps = UpdateMipmap0Image(
           image0, texture, texture.GetImageCount(), gl_target_,
-          Texture::kMipmapChanged, gm, &required_levels, multisample_changed);
+          Texture::kMipmapChanged, gm, &required_levels, images_reset);
       if (generate_mipmaps || multisample_changed)
         gm->GenerateMipmap(gl_target_);
 
       for (size_t i = 1; i < required_levels; ++i) {
         if (texture.HasImage(i) &&
             CheckImage(*texture.GetImage(i), texture) &&
-            (generate_mipmaps || multisample_changed ||
+            (generate_mipmaps || images_reset ||
                 TestModifiedBit(static_cast<Texture::Changes>(
                     Texture::kMipmapChanged + i)))) {
           UpdateImage(image0, *texture.GetImage(i), texture, gl_target_,
@@ -2822,15 +6548,16 @@ void Renderer::TextureResource::UpdateTextureImageState(
   }
 
   if (!multisample) {
-    if (multisample_changed || TestModifiedBit(Texture::kSubImageChanged)) {
+    if (images_reset || TestModifiedBit(Texture::kSubImageChanged)) {
       UpdateSubImages(texture.GetSubImages(), gl_target_, gm);
       texture.ClearSubImages();
     }
 
     // Generate mipmaps if requested and not using client-supplied mipmaps.
+    // Levels that are still being streamed are not generated.
     if (Sampler* sampler = texture.GetSampler().Get()) {
-      if (texture.HasImage(0U))
-        UpdateMipmapGeneration(*sampler, multisample_changed ||
+      if (texture.HasImage(0U) && !streamed_base_level_)
+        UpdateMipmapGeneration(*sampler, images_reset ||
                                TestModifiedBit(Texture::kMipmapChanged), gm);
     }
   }
@@ -2869,6 +6596,111 @@ void Renderer::TextureResource::CreateImmutableTexture(
   }
 }
 
+size_t Renderer::TextureResource::GetRequiredStorageLevels(
+    const TextureBase& base, bool multisample, GraphicsManager* gm) const {
+  if (multisample || !resource_owns_gl_id_ ||
+      base.GetTextureType() != TextureBase::kTexture ||
+      base.GetImmutableImage().Get() ||
+      !GetResourceManager()->ShouldUseImmutableTextureStorage(gm))
+    return 0U;
+  const Texture& texture = static_cast<const Texture&>(base);
+  if (!texture.HasImage(0U))
+    return 0U;
+  const Image& image = *texture.GetImage(0U);
+  if ((image.GetType() != Image::kDense && image.GetType() != Image::kArray) ||
+      !image.GetWidth() || !image.GetHeight() || !image.GetDepth())
+    return 0U;
+  const Sampler* sampler = texture.GetSampler().Get();
+  if (texture.GetImageCount() > 1U ||
+      (sampler && sampler->IsAutogenerateMipmapsEnabled()))
+    return std::max(math::Log2(image.GetWidth()),
+                    math::Log2(image.GetHeight())) + 1U;
+  return 1U;
+}
+
+bool Renderer::TextureResource::UpdateImmutableStorage(
+    const TextureBase& base, size_t levels, ResourceBinder* rb, GLuint unit,
+    GraphicsManager* gm) {
+  const Image* image =
+      levels ? static_cast<const Texture&>(base).GetImage(0U).Get() : NULL;
+  if (storage_levels_) {
+    if (image && storage_levels_ == levels &&
+        storage_format_ == image->GetFormat() &&
+        storage_size_ == math::Vector3ui(image->GetWidth(), image->GetHeight(),
+                                         image->GetDepth()))
+      return false;
+    // Immutable storage cannot be respecified, so replace the texture object
+    // with a new one, which needs all of its state to be sent again.
+    {
+      base::BigReaderReadLock read_lock(GetResourceBinderLock());
+      base::BigReaderReadGuard read_guard(&read_lock);
+      ResourceBinderMap& binders = GetResourceBinderMap();
+      for (ResourceBinderMap::iterator it = binders.begin();
+           it != binders.end(); ++it)
+        Unbind(it->second.get());
+    }
+    gm->DeleteTextures(1, &id_);
+    id_ = GetResourceManager()->GetObjectNameCache()->Generate(
+        ObjectNameCache::kTextureNames, gm);
+    rb->BindTextureToUnit(this, unit);
+    storage_levels_ = 0U;
+    streamed_base_level_ = 0U;
+    auto_mipmapping_enabled_ = false;
+    max_anisotropy_ = min_lod_ = max_lod_ = 0.f;
+    compare_function_ = base::InvalidEnumValue<Sampler::CompareFunction>();
+    compare_mode_ = base::InvalidEnumValue<Sampler::CompareMode>();
+    min_filter_ = mag_filter_ = base::InvalidEnumValue<Sampler::FilterMode>();
+    wrap_r_ = wrap_s_ = wrap_t_ = base::InvalidEnumValue<Sampler::WrapMode>();
+    last_uploaded_components_ = 0;
+    contents_modified_ = false;
+    SetModifiedBits();
+  }
+  if (!image)
+    return false;
+
+  CreateImmutableTexture(*image, false, 0U, false, levels, gm);
+  storage_format_ = image->GetFormat();
+  storage_size_.Set(image->GetWidth(), image->GetHeight(), image->GetDepth());
+  storage_levels_ = levels;
+  return true;
+}
+
+void Renderer::TextureResource::StreamMipmaps(const Texture& texture,
+                                              bool storage_allocated,
+                                              GraphicsManager* gm) {
+  // Levels that have already been streamed are updated if they change.
+  const Image& image0 = *texture.GetImage(0U);
+  for (size_t i = streamed_base_level_; i < storage_levels_; ++i) {
+    if (TestModifiedBit(static_cast<int>(Texture::kMipmapChanged + i)) &&
+        CheckImage(*texture.GetImage(i), texture)) {
+      if (i)
+        UpdateImage(image0, *texture.GetImage(i), texture, gl_target_,
+                    static_cast<int>(i), gm);
+      else
+        UploadImage(image0, gl_target_, 0, 0, false, false, Point3ui(), gm);
+    }
+  }
+
+  // Upload the next finer level, unless one was already uploaded in this
+  // frame. The smallest level is always uploaded at once so that the texture
+  // can be drawn.
+  const uint64 frame = GetResourceManager()->GetFrame();
+  if (storage_allocated || frame != last_streamed_frame_) {
+    --streamed_base_level_;
+    const size_t level = streamed_base_level_;
+    if (CheckImage(*texture.GetImage(level), texture)) {
+      if (level)
+        UpdateImage(image0, *texture.GetImage(level), texture, gl_target_,
+                    static_cast<int>(level), gm);
+      else
+        UploadImage(image0, gl_target_, 0, 0, false, false, Point3ui(), gm);
+    }
+    last_streamed_frame_ = frame;
+    // UpdateTextureState() lowers the base level to the new level.
+    SetModifiedBit(TextureBase::kBaseLevelChanged);
+  }
+}
+
 void Renderer::TextureResource::UpdateCubeMapImageState(GraphicsManager* gm) {
   // Note that this function is only entered if the cubemap is complete, meaning
   // that all faces have images or mipmaps.
@@ -2963,14 +6795,32 @@ class Renderer::ShaderResource : public Resource<Shader::kNumChanges> {
   ShaderResource(ResourceBinder* rb, ResourceManager* rm, const Shader& shader,
                  GLuint id)
       : Renderer::Resource<Shader::kNumChanges>(rm, shader, id),
-        shader_type_(GL_INVALID_ENUM) {}
+        shader_type_(GL_INVALID_ENUM),
+        is_compile_deferred_(false),
+        pending_id_(0U) {}
 
   ~ShaderResource() override {
     DCHECK(id_ == 0U || !portgfx::Visual::GetCurrent());
   }
 
-  // Updates the resource and returns whether anything changed.
-  virtual bool UpdateShader(ResourceBinder* rb);
+  // Updates the resource and returns whether anything changed. If
+  // defer_compile is true, a changed source is not compiled until
+  // CompileIfDeferred() is called, since it may not be needed if the program
+  // using the shader is loaded from a binary.
+  virtual bool UpdateShader(ResourceBinder* rb, bool defer_compile);
+  // Compiles the source if its compilation was deferred by UpdateShader().
+  // Otherwise finishes any compilation started by StartCompileIfDeferred().
+  void CompileIfDeferred(ResourceBinder* rb);
+  // Starts compiling the source without waiting for the result if its
+  // compilation was deferred by UpdateShader(). FinishCompile() must be called
+  // once a program linked with the shader has finished linking.
+  void StartCompileIfDeferred();
+  // Sends the result of a compilation started by StartCompileIfDeferred() to
+  // the holder, and uses the new shader object if it compiled successfully.
+  void FinishCompile(ResourceBinder* rb);
+  // Returns the id of the shader object to attach to a program, which is that
+  // of the compilation in progress, if any.
+  GLuint GetIdToAttach() const { return pending_id_ ? pending_id_ : id_; }
   void Release(bool can_make_gl_calls) override;
   ResourceType GetType() const override { return kShader; }
 
@@ -2986,37 +6836,40 @@ class Renderer::ShaderResource : public Resource<Shader::kNumChanges> {
   void Update(ResourceBinder* rb) override {}
 
  private:
+  // Compiles the source of the shader, sending the info log to the holder.
+  // Returns whether the compilation was successful.
+  bool Compile();
+  // Deletes the shader object of the compilation in progress, if any.
+  void DeletePendingShader();
+
   // The type of shader.
   GLenum shader_type_;
+  // Whether the source has changed but has not been compiled.
+  bool is_compile_deferred_;
+  // The shader object being compiled by StartCompileIfDeferred(), or 0.
+  GLuint pending_id_;
 };
 
-bool Renderer::ShaderResource::UpdateShader(ResourceBinder* rb) {
+bool Renderer::ShaderResource::UpdateShader(ResourceBinder* rb,
+                                            bool defer_compile) {
   if (AnyModifiedBitsSet()) {
     ScopedResourceLabel label(this, rb);
+    rb->CountResourceUpdate();
     // For coverage.
     Update(rb);
 
-    const Shader& shader = GetShader();
-    const std::string& id_string = shader.GetLabel();
-    GraphicsManager* gm = GetGraphicsManager();
-
-    std::string info_log = shader.GetInfoLog();
     bool need_to_update_label = TestModifiedBit(ResourceHolder::kLabelChanged);
     if (TestModifiedBit(Shader::kSourceChanged)) {
-      GLuint id = CompileShader(id_string, shader_type_, shader.GetSource(),
-                                &info_log, gm);
-      // Only update the id if the compilation was successful.
-      if (id) {
-        id_ = id;
+      if (defer_compile)
+        is_compile_deferred_ = true;
+      else if (Compile())
         need_to_update_label = true;
-      }
     }
 
-    if (need_to_update_label)
-      SetObjectLabel(gm, GL_SHADER_OBJECT, id_, id_string);
-
-    // Send the info log to the holder.
-    shader.SetInfoLog(info_log);
+    // A shader whose compilation is deferred is labeled once it is compiled.
+    if (need_to_update_label && id_)
+      SetObjectLabel(GetGraphicsManager(), GL_SHADER_OBJECT, id_,
+                     GetShader().GetLabel());
     ResetModifiedBits();
 
     return true;
@@ -3025,9 +6878,74 @@ bool Renderer::ShaderResource::UpdateShader(ResourceBinder* rb) {
   }
 }
 
+void Renderer::ShaderResource::CompileIfDeferred(ResourceBinder* rb) {
+  if (is_compile_deferred_) {
+    ScopedResourceLabel label(this, rb);
+    // Any compilation in progress is of an older source.
+    DeletePendingShader();
+    if (Compile())
+      SetObjectLabel(GetGraphicsManager(), GL_SHADER_OBJECT, id_,
+                     GetShader().GetLabel());
+  } else {
+    FinishCompile(rb);
+  }
+}
+
+void Renderer::ShaderResource::StartCompileIfDeferred() {
+  if (is_compile_deferred_) {
+    DeletePendingShader();
+    pending_id_ = StartCompilingShader(shader_type_, GetShader().GetSource(),
+                                       GetGraphicsManager());
+    is_compile_deferred_ = false;
+  }
+}
+
+void Renderer::ShaderResource::FinishCompile(ResourceBinder* rb) {
+  if (pending_id_) {
+    ScopedResourceLabel label(this, rb);
+    const Shader& shader = GetShader();
+    GraphicsManager* gm = GetGraphicsManager();
+    std::string info_log;
+    if (CheckShaderCompileStatus(shader.GetLabel(), shader_type_, pending_id_,
+                                 &info_log, gm)) {
+      id_ = pending_id_;
+      SetObjectLabel(gm, GL_SHADER_OBJECT, id_, shader.GetLabel());
+    }
+    pending_id_ = 0U;
+    shader.SetInfoLog(info_log);
+  }
+}
+
+void Renderer::ShaderResource::DeletePendingShader() {
+  if (pending_id_) {
+    GetGraphicsManager()->DeleteShader(pending_id_);
+    pending_id_ = 0U;
+  }
+}
+
+bool Renderer::ShaderResource::Compile() {
+  const Shader& shader = GetShader();
+  std::string info_log = shader.GetInfoLog();
+  GLuint id = CompileShader(shader.GetLabel(), shader_type_, shader.GetSource(),
+                            &info_log, GetGraphicsManager());
+  is_compile_deferred_ = false;
+  // Only update the id if the compilation was successful.
+  if (id)
+    id_ = id;
+
+  // Send the info log to the holder.
+  shader.SetInfoLog(info_log);
+  return id != 0;
+}
+
 void Renderer::ShaderResource::Release(bool can_make_gl_calls) {
   BaseResourceType::Release(can_make_gl_calls);
   GraphicsManager* gm = GetGraphicsManager();
+  if (pending_id_) {
+    if (can_make_gl_calls)
+      gm->DeleteShader(pending_id_);
+    pending_id_ = 0U;
+  }
   if (id_) {
     if (resource_owns_gl_id_ && can_make_gl_calls)
       gm->DeleteShader(id_);
@@ -3050,83 +6968,51 @@ class Renderer::ShaderInputRegistryResource
   ShaderInputRegistryResource(ResourceBinder* rb, ResourceManager* rm,
                               const ShaderInputRegistry& reg, GLuint id)
       : Renderer::Resource<ShaderInputRegistry::kNumChanges>(rm, reg, id),
-        uniform_stacks_(reg.GetAllocator()) {
-    uniform_stacks_.reserve(reg.GetSpecs<Uniform>().size());
+        initial_values_(reg.GetAllocator()),
+        tops_(reg.GetAllocator()),
+        pristine_(true) {
+    tops_.reserve(reg.GetSpecs<Uniform>().size());
   }
 
   ~ShaderInputRegistryResource() override {}
   ResourceType GetType() const override { return kShaderInputRegistry; }
 
   void Unbind(ResourceBinder* rb) override {
-    // Clear the uniform cache. Do not leave stacks in an invalid state
-    // (e.g. too few stacks, invalid state of a stack), since unbinding
-    // does not mark a resource as modified.
-    for (auto& stack : uniform_stacks_)
-      stack->Clear();
+    // Clear the uniform cache. Do not leave the state invalid (e.g. too few
+    // entries), since unbinding does not mark a resource as modified.
+    if (!pristine_) {
+      const size_t count = tops_.size();
+      for (size_t i = 0; i < count; ++i) {
+        initial_values_[i] = Uniform();
+        tops_[i] = &initial_values_[i];
+      }
+      pristine_ = true;
+    }
   }
 
   // Returns the latest uniform stored at the passed index.
   const Uniform& GetUniform(size_t index) const {
-    DCHECK_LT(index, uniform_stacks_.size());
-    return *uniform_stacks_[index]->GetTop();
+    DCHECK_LT(index, tops_.size());
+    return *tops_[index];
   }
 
   // Sets the initial value of a Uniform. The Uniform must be valid.
   void SetInitialValue(const Uniform& u) {
     DCHECK_EQ(&u.GetRegistry(), &GetRegistry());
-    DCHECK_LT(u.GetIndexInRegistry(), uniform_stacks_.size());
-    UniformStack& uis = *uniform_stacks_[u.GetIndexInRegistry()];
-    uis.SetBottom(u);
-  }
-
-  // Pushes a Uniform onto the shadow state.
-  void PushUniform(const Uniform& u) {
-    DCHECK_EQ(&u.GetRegistry(), &GetRegistry());
-    DCHECK_LT(u.GetIndexInRegistry(), uniform_stacks_.size());
-    DCHECK(u.IsValid());
-    UniformStack& uis = *uniform_stacks_[u.GetIndexInRegistry()];
-    const ShaderInputRegistry::CombineFunction<Uniform>::Type& combine_func =
-        ShaderInputRegistry::GetSpec(u)->combine_function;
-    const ShaderInputRegistry::GenerateFunction<Uniform>::Type& generate_func =
-        ShaderInputRegistry::GetSpec(u)->generate_function;
-    const Uniform& top = *uis.GetTop();
-    // Grab a temp Uniform to potentially be used for combining or merging.
-    Uniform* temp = uis.GetTopTempUniform();
-    if (combine_func && top.IsValid()) {
-      // Combine with the previous uniform on top of the stack.
-      *temp = combine_func(top, u);
-      uis.PushTempUniform(temp);
-    } else if (Uniform::GetMerged(top, u, temp)) {
-      // Merge with the previous uniform on top of the stack - for arrays.
-      uis.PushTempUniform(temp);
-    } else {
-      // No need to combine or merge so this is the fast path.
-      uis.Push(&u);
-    }
-    if (generate_func) {
-      // Generate the new Uniform.
-      std::vector<Uniform> generated = generate_func(*uis.GetTop());
-      const size_t count = generated.size();
-      for (size_t i = 0; i < count; ++i) {
-        const Uniform& gen = generated[i];
-        if (gen.IsValid()) {
-          // Get the stack for the generated uniform.
-          DCHECK_EQ(&u.GetRegistry(), &GetRegistry());
-          DCHECK_LT(gen.GetIndexInRegistry(), uniform_stacks_.size());
-          UniformStack& uis = *uniform_stacks_[gen.GetIndexInRegistry()];
-          Uniform* temp = uis.GetTopTempUniform();
-          *temp = gen;
-          uis.PushTempUniform(temp);
-        }
-      }
-    }
+    DCHECK_LT(u.GetIndexInRegistry(), tops_.size());
+    initial_values_[u.GetIndexInRegistry()] = u;
+    pristine_ = false;
   }
 
-  // Pops a Uniform off of the shadow state.
-  void PopUniform(const Uniform& u) {
-    DCHECK_EQ(&u.GetRegistry(), &GetRegistry());
-    DCHECK_LT(u.GetIndexInRegistry(), uniform_stacks_.size());
-    uniform_stacks_[u.GetIndexInRegistry()]->Pop();
+  // Makes the passed Uniform the latest one at the passed index, returning the
+  // previous one. The Uniform must remain valid until it is replaced. This is
+  // used by the ResourceBinder to push and pop Uniforms.
+  const Uniform* SetTop(size_t index, const Uniform* u) {
+    DCHECK_LT(index, tops_.size());
+    const Uniform* previous = tops_[index];
+    tops_[index] = u;
+    pristine_ = false;
+    return previous;
   }
 
   void Update(ResourceBinder* rb) override {
@@ -3134,108 +7020,28 @@ class Renderer::ShaderInputRegistryResource
       // Ensure that we have enough space for the uniforms of the associated
       // registry.
       const size_t size = GetRegistry().GetSpecs<Uniform>().size();
-      for (size_t i = uniform_stacks_.size(); i < size; ++i) {
-        uniform_stacks_.push_back(std::unique_ptr<UniformStack>(
-            new(uniform_stacks_.get_allocator().GetAllocator()) UniformStack));
+      for (size_t i = tops_.size(); i < size; ++i) {
+        initial_values_.push_back(Uniform());
+        tops_.push_back(&initial_values_.back());
       }
       ResetModifiedBits();
     }
   }
 
  private:
-  // This class is needed to properly construct the stack of AllocVectors with
-  // an allocator and wraps access to the stack. Note that we normally keep
-  // pointers to Uniforms for performance and only copy combined or merged
-  // Uniforms.
-  class UniformStack : public Allocatable {
-   public:
-    UniformStack()
-        : uniform_stack_(
-            base::AllocationManager::GetDefaultAllocatorForLifetime(
-                base::kShortTerm)),
-          temp_stack_(base::AllocationManager::GetDefaultAllocatorForLifetime(
-              base::kShortTerm)),
-          pristine_(true) {
-      Init();
-    }
-    Uniform* GetTopTempUniform() {
-      DCHECK_GT(temp_stack_.size(), 1U);
-      return &temp_stack_.back();
-    }
-    const Uniform* GetTop() const {
-      DCHECK(!uniform_stack_.empty());
-      return uniform_stack_.back();
-    }
-    void Pop() {
-      DCHECK(!temp_stack_.empty());
-      DCHECK(!uniform_stack_.empty());
-      if (IsTopATempUniform())
-        temp_stack_.pop_back();
-      uniform_stack_.pop_back();
-      pristine_ = false;
-    }
-    void PushTempUniform(Uniform* temp) {
-      DCHECK(!uniform_stack_.empty());
-      DCHECK(!temp_stack_.empty());
-      DCHECK(temp == GetTopTempUniform());
-      // Add new temp uniform so GetTopTempUniform has a fresh one.
-      temp_stack_.push_back(Uniform());
-      uniform_stack_.push_back(temp);
-      pristine_ = false;
-    }
-    void Push(const Uniform* uniform) {
-      DCHECK(!uniform_stack_.empty());
-      DCHECK(uniform != GetTopTempUniform());
-      uniform_stack_.push_back(uniform);
-      pristine_ = false;
-    }
-    void SetBottom(const Uniform& uniform) {
-      DCHECK(!uniform_stack_.empty());
-      DCHECK(!temp_stack_.empty());
-      temp_stack_[0] = uniform;
-      uniform_stack_[0] = &temp_stack_[0];
-      pristine_ = false;
-    }
-    void Clear() {
-      if (!pristine_) {
-        uniform_stack_.clear();
-        temp_stack_.clear();
-        Init();
-        pristine_ = true;
-      }
-    }
-    size_t Size() const { return uniform_stack_.size(); }
-
-   private:
-    void Init() {
-      // There needs to be at least one entry in the stack for SetBottom().
-      temp_stack_.push_back(Uniform());
-      uniform_stack_.push_back(&temp_stack_.back());
-      // Add another temp Uniform for GetTopTempUniform().
-      temp_stack_.push_back(Uniform());
-    }
-    bool IsTopATempUniform() {
-      // Check [size - 2] because [size - 1] is an extra used for
-      // GetTopTempUniform().
-      const size_t size = temp_stack_.size();
-      return (size > 1U &&
-              uniform_stack_.back() == &temp_stack_[size - 2]);
-    }
-    base::AllocVector<const Uniform*> uniform_stack_;
-    // Temporary storage needed to hold Uniforms that have been combined or
-    // merged during traversal. Otherwise we just keep pointers to Uniforms to
-    // avoid expensive copying. Use a deque-like UniformStack to ensure that
-    // pointers to Uniforms in the deque remain valid.
-    base::AllocDeque<Uniform> temp_stack_;
-    // Whether the stack is in default state.
-    bool pristine_;
-  };
-
   const ShaderInputRegistry& GetRegistry() const {
     return static_cast<const ShaderInputRegistry&>(GetHolder());
   }
 
-  base::AllocVector<std::unique_ptr<UniformStack>> uniform_stacks_;
+  // The initial value of each uniform in the registry, which is invalid unless
+  // it has been set with SetInitialValue(). A deque is used so that pointers
+  // to the values remain valid as it grows.
+  base::AllocDeque<Uniform> initial_values_;
+  // The latest value of each uniform, which is either its initial value or a
+  // Uniform pushed by a ResourceBinder.
+  base::AllocVector<const Uniform*> tops_;
+  // Whether the state is the default state.
+  bool pristine_;
 };
 
 //-----------------------------------------------------------------------------
@@ -3252,8 +7058,12 @@ class Renderer::ShaderProgramResource
       : Renderer::Resource<ShaderProgram::kNumChanges>(rm, shader_program, id),
         attribute_index_map_(shader_program.GetAllocator()),
         uniforms_(shader_program.GetAllocator()),
+        uniform_shadow_(shader_program.GetAllocator()),
+        uniform_blocks_(shader_program.GetAllocator()),
         vertex_resource_(NULL),
-        fragment_resource_(NULL) {}
+        fragment_resource_(NULL),
+        link_stage_(kLinkIdle),
+        pending_id_(0U) {}
 
   GLint GetAttributeIndex(
       const ShaderInputRegistry::AttributeSpec* spec) const {
@@ -3277,16 +7087,32 @@ class Renderer::ShaderProgramResource
     return static_cast<const ShaderProgram&>(GetHolder());
   }
 
-  // Return the resources of the shader stages.
+  // Return the resources of the shader stages. The compute shader of a
+  // compute program takes the place of the vertex shader.
   ShaderResource* GetVertexResource() const { return vertex_resource_; }
   ShaderResource* GetFragmentResource() const { return fragment_resource_; }
 
+  // Returns whether shapes can be drawn with the program, which is not the
+  // case while it is being linked asynchronously for the first time. Once it
+  // has been linked, the previous program is used until a new link finishes.
+  bool IsDrawable() const { return id_ != 0U || link_stage_ == kLinkIdle; }
+
  private:
+  // The stages of an asynchronous link of the program, which is used when
+  // Renderer::kCompileShadersAsynchronously is set.
+  enum LinkStage {
+    kLinkIdle,        // No link is in progress.
+    kLinkCompiling,   // The shaders are compiling and the program is linking.
+    kLinkRelinking,   // The program is relinking with its attribute bindings.
+  };
+
   struct UniformCacheEntry {
     UniformCacheEntry()
         : location(-1),
           spec(NULL),
           uniform_stamp(base::kInvalidIndex),
+          shadow_offset(0U),
+          shadow_size(0U),
           unit_associations(
               base::AllocationManager::GetDefaultAllocatorForLifetime(
                   base::kMediumTerm)) {}
@@ -3295,6 +7121,8 @@ class Renderer::ShaderProgramResource
         : location(location_in),
           spec(spec_in),
           uniform_stamp(base::kInvalidIndex),
+          shadow_offset(0U),
+          shadow_size(0U),
           unit_associations(
               base::AllocationManager::GetDefaultAllocatorForLifetime(
                   base::kMediumTerm),
@@ -3312,6 +7140,10 @@ class Renderer::ShaderProgramResource
     GLint location;  // If location is -1 then the value is not valid.
     const ShaderInputRegistry::UniformSpec* spec;
     uint64 uniform_stamp;
+    // The range of the program's uniform shadow holding the values last sent
+    // for non-texture uniforms. The size is 0 if no values have been sent.
+    size_t shadow_offset;
+    size_t shadow_size;
     // The last units sent for texture uniforms.
     base::AllocVector<int> unit_associations;
   };
@@ -3325,14 +7157,53 @@ class Renderer::ShaderProgramResource
                               const ShaderInputRegistryPtr& reg,
                               GraphicsManager* gm);
 
-  // Gets the active uniforms for this shader from OpenGL and sets up their
-  // uniform locations in the cache. If any uniforms are missing from the
-  // registry warning messages are logged.
-  void PopulateUniformCache();
+  // Gets the active uniforms for this shader and sets up their uniform
+  // locations in the cache. The uniforms are taken from the ResourceManager's
+  // UniformLayoutCache if layout_key is not empty and an identical program
+  // has already been linked, and are queried from OpenGL otherwise. If any
+  // uniforms are missing from the registry warning messages are logged.
+  void PopulateUniformCache(const std::string& layout_key);
+  // Queries OpenGL for the active uniforms of the program, with program
+  // interface queries if they are available.
+  void QueryActiveUniforms(UniformLayoutCache::Layout* layout);
+
+  // Returns the cache to load and store the program's binary with, if any.
+  const ProgramBinaryCachePtr GetBinaryCache();
+  // Binds the attributes of the linked program with the passed id to their
+  // indices, which take effect when it is relinked, along with the captured
+  // varyings. If request_binary is true, the program is also asked to keep its
+  // binary when relinked.
+  void BindAttributes(GLuint id, bool request_binary);
+  // Makes the linked program with the passed id, if not 0, the one used by
+  // the resource, and sets up its uniforms. The uniforms of a new program are
+  // shared with identical programs if binary_key is not empty.
+  void UseLinkedProgram(GLuint id, bool need_to_update_label,
+                        const std::string& binary_key);
+
+  // Starts compiling the shaders and linking the program without waiting for
+  // either to finish. The binary is stored under binary_key if it is not
+  // empty.
+  void StartAsyncLink(ResourceBinder* rb, const std::string& binary_key);
+  // Moves an asynchronous link through the stages that OpenGL has finished.
+  void ContinueAsyncLink(ResourceBinder* rb);
+  // Abandons any asynchronous link in progress.
+  void CancelAsyncLink();
 
   // Gets the latest uniform values from the resource binder's cache.
   void UpdateUniformValues(ResourceBinder* rb);
 
+  // Compares the values of a non-texture uniform with those last sent for the
+  // entry, and sends only the values that differ. Consecutive changed values
+  // of an array uniform are sent together. Adds the numbers of values sent
+  // and skipped to |sent| and |skipped|.
+  void SendChangedValues(UniformCacheEntry* entry, const Uniform& uniform,
+                         ResourceBinder* rb, GraphicsManager* gm,
+                         size_t* sent, size_t* skipped);
+
+  // Binds the buffers of the buffer-backed UniformBlocks being drawn to the
+  // program's uniform blocks of the same names.
+  void BindUniformBuffers(ResourceBinder* rb);
+
   // Updates the image unit associations of textures. Returns whether any units
   // have changed from the old uniform value to the new one.
   bool UpdateUnitAssociations(UniformCacheEntry* entry,
@@ -3356,9 +7227,30 @@ class Renderer::ShaderProgramResource
   // Vector of uniforms that this program uses.
   base::AllocVector<UniformCacheEntry> uniforms_;
 
+  // Packed copies of the values last sent to OpenGL for the program's
+  // non-texture uniforms, indexed by the shadow ranges of the entries.
+  base::AllocVector<uint8> uniform_shadow_;
+
+  // The index and uniform buffer binding point of each uniform block that has
+  // been used with the program. The index is GL_INVALID_INDEX if the program
+  // does not declare the block.
+  struct UniformBlockEntry {
+    UniformBlockEntry() : index(GL_INVALID_INDEX), binding(kInvalidGluint) {}
+    std::string name;
+    GLuint index;
+    GLuint binding;
+  };
+  base::AllocVector<UniformBlockEntry> uniform_blocks_;
+
   // Shader stage resources.
   ShaderResource* vertex_resource_;
   ShaderResource* fragment_resource_;
+
+  // The stage of the asynchronous link in progress, the program being linked,
+  // and the key to store its binary under.
+  LinkStage link_stage_;
+  GLuint pending_id_;
+  std::string pending_binary_key_;
 };
 
 void Renderer::ShaderProgramResource::PopulateAttributeCache(
@@ -3438,64 +7330,114 @@ void Renderer::ShaderProgramResource::PopulateAttributeCache(
   }
 }
 
-void Renderer::ShaderProgramResource::PopulateUniformCache() {
+void Renderer::ShaderProgramResource::PopulateUniformCache(
+    const std::string& layout_key) {
   const ShaderProgram& shader_program = GetShaderProgram();
   const ShaderInputRegistryPtr& reg = shader_program.GetRegistry();
+
+  UniformLayoutCache* layouts = GetResourceManager()->GetUniformLayoutCache();
+  UniformLayoutCache::Layout layout;
+  if (layout_key.empty() || !layouts->Find(layout_key, &layout)) {
+    QueryActiveUniforms(&layout);
+    if (!layout_key.empty())
+      layouts->Add(layout_key, layout);
+  }
+
+  uniforms_.clear();
+  uniform_shadow_.clear();
+  uniforms_.reserve(layout.size());
+  for (size_t i = 0; i < layout.size(); ++i) {
+    const UniformLayoutCache::ActiveUniform& active = layout[i];
+    const std::string& name = active.name;
+    // Find this uniform in the registry.
+    if (const ShaderInputRegistry::UniformSpec* spec =
+            reg->Find<Uniform>(name)) {
+      // Validate the type with the registry entry.
+      if (!ValidateUniformType(name.c_str(), spec->value_type, active.type)) {
+        TracingHelper helper;
+        LOG(WARNING) << "***ION: Uniform '" << name << "' has a"
+                     << " different type from its spec: spec type: "
+                     << spec->value_type << ", uniform type: "
+                     << helper.ToString("GLenum", active.type);
+      }
+
+      // Add this uniform's spec to the vector of uniforms for this shader
+      // so that the shader can check for updated values when bound.
+      uniforms_.push_back(
+          UniformCacheEntry(active.location, active.size, spec));
+    } else {
+      // The registry does not define this uniform.
+      LOG(WARNING) << "***ION: Uniform '" << name << "' used in shader '"
+                   << shader_program.GetLabel()
+                   << "' does not have a registry entry";
+    }
+  }
+}
+
+void Renderer::ShaderProgramResource::QueryActiveUniforms(
+    UniformLayoutCache::Layout* layout) {
   GraphicsManager* gm = GetGraphicsManager();
+  // Program interface queries return the type, size, and location of a
+  // uniform with a single call, and do not look the uniform up by name.
+  const bool use_interface_queries =
+      gm->IsFunctionGroupAvailable(GraphicsManager::kProgramInterfaceQuery);
 
   GLint max_length = 0;
-  GLuint uniform_count = 0;
+  GLint uniform_count = 0;
   // Ask OpenGL for the number of uniforms.
-  gm->GetProgramiv(id_, GL_ACTIVE_UNIFORMS,
-                   reinterpret_cast<GLint*>(&uniform_count));
-  uniforms_.clear();
-  if (uniform_count) {
+  if (use_interface_queries) {
+    gm->GetProgramInterfaceiv(id_, GL_UNIFORM, GL_ACTIVE_RESOURCES,
+                              &uniform_count);
+  } else {
+    gm->GetProgramiv(id_, GL_ACTIVE_UNIFORMS, &uniform_count);
+  }
+  if (uniform_count <= 0)
+    return;
+
+  if (use_interface_queries)
+    gm->GetProgramInterfaceiv(id_, GL_UNIFORM, GL_MAX_NAME_LENGTH, &max_length);
+  else
     gm->GetProgramiv(id_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
-    static const GLint kMaxNameLength = 4096;
-    char name[kMaxNameLength];
-    // Some platforms (asm.js) return zero for the max length.
-    max_length =
-        std::min(kMaxNameLength, max_length == 0 ? kMaxNameLength : max_length);
+  static const GLint kMaxNameLength = 4096;
+  char name[kMaxNameLength];
+  // Some platforms (asm.js) return zero for the max length.
+  max_length =
+      std::min(kMaxNameLength, max_length == 0 ? kMaxNameLength : max_length);
+  static const GLsizei kPropertyCount = 3;
+  static const GLenum kProperties[kPropertyCount] = {GL_TYPE, GL_ARRAY_SIZE,
+                                                     GL_LOCATION};
+
+  layout->reserve(uniform_count);
+  for (GLuint i = 0; i < static_cast<GLuint>(uniform_count); ++i) {
+    // Get the uniform information from OpenGL.
+    name[0] = 0;
     GLsizei length;
-    GLint size;
-    uniforms_.reserve(uniform_count);
-    for (GLuint i = 0; i < uniform_count; ++i) {
-      // Get the uniform information from OpenGL.
-      name[0] = 0;
-      GLenum type;
-      gm->GetActiveUniform(id_, i, max_length, &length, &size, &type, name);
-
-      // We want the base name, so cut off the name at '[' if it exists.
-      for (int i = 0; i < kMaxNameLength; i++) {
-        if (name[i] == '[' || name[i] == 0) {
-          name[i] = 0;
-          break;
-        }
-      }
-
-      // Find this uniform in the registry.
-      if (const ShaderInputRegistry::UniformSpec* spec =
-              reg->Find<Uniform>(name)) {
-        // Validate the type with the registry entry.
-        if (!ValidateUniformType(name, spec->value_type, type)) {
-          TracingHelper helper;
-          LOG(WARNING) << "***ION: Uniform '" << name << "' has a"
-                       << " different type from its spec: spec type: "
-                       << spec->value_type
-                       << ", uniform type: " << helper.ToString("GLenum", type);
-        }
+    UniformLayoutCache::ActiveUniform active;
+    if (use_interface_queries) {
+      GLint values[kPropertyCount] = {GL_NONE, 0, -1};
+      gm->GetProgramResourceName(id_, GL_UNIFORM, i, max_length, &length,
+                                 name);
+      gm->GetProgramResourceiv(id_, GL_UNIFORM, i, kPropertyCount,
+                               kProperties, kPropertyCount, &length, values);
+      active.type = static_cast<GLenum>(values[0]);
+      active.size = values[1];
+      active.location = values[2];
+    } else {
+      gm->GetActiveUniform(id_, i, max_length, &length, &active.size,
+                           &active.type, name);
+    }
 
-        const int location = gm->GetUniformLocation(id_, name);
-        // Add this uniform's spec to the vector of uniforms for this shader
-        // so that the shader can check for updated values when bound.
-        uniforms_.push_back(UniformCacheEntry(location, size, spec));
-      } else {
-        // The registry does not define this uniform.
-        LOG(WARNING) << "***ION: Uniform '" << name << "' used in shader '"
-                     << shader_program.GetLabel()
-                     << "' does not have a registry entry";
+    // We want the base name, so cut off the name at '[' if it exists.
+    for (int j = 0; j < kMaxNameLength; j++) {
+      if (name[j] == '[' || name[j] == 0) {
+        name[j] = 0;
+        break;
       }
     }
+    active.name = name;
+    if (!use_interface_queries)
+      active.location = gm->GetUniformLocation(id_, name);
+    layout->push_back(active);
   }
 }
 
@@ -3590,9 +7532,64 @@ bool Renderer::ShaderProgramResource::UpdateUnitAssociationAndBind(
   return cached_unit != last_unit_sent;
 }
 
+void Renderer::ShaderProgramResource::SendChangedValues(
+    UniformCacheEntry* entry, const Uniform& uniform, ResourceBinder* rb,
+    GraphicsManager* gm, size_t* sent, size_t* skipped) {
+  size_t value_size = 0U;
+  const uint8* values = GetUniformValues(uniform, &value_size);
+  DCHECK(values);
+  const size_t array_count = uniform.GetCount();
+  const size_t count = std::max(array_count, static_cast<size_t>(1U));
+  const size_t size = value_size * count;
+
+  if (entry->shadow_size != size) {
+    // The values have never been sent, or the size of the array has changed,
+    // so send them all and make room for them in the shadow.
+    entry->shadow_offset = uniform_shadow_.size();
+    entry->shadow_size = size;
+    uniform_shadow_.resize(entry->shadow_offset + size);
+    memcpy(&uniform_shadow_[entry->shadow_offset], values, size);
+    rb->SendUniform(uniform, entry->location, gm);
+    *sent += count;
+    return;
+  }
+
+  uint8* shadow = &uniform_shadow_[entry->shadow_offset];
+  if (memcmp(shadow, values, size) == 0) {
+    // The stamp changed but the values did not.
+    *skipped += count;
+  } else if (!array_count) {
+    memcpy(shadow, values, size);
+    rb->SendUniform(uniform, entry->location, gm);
+    ++*sent;
+  } else {
+    // Send each run of changed values.
+    size_t i = 0;
+    while (i < count) {
+      if (memcmp(shadow + i * value_size, values + i * value_size,
+                 value_size) == 0) {
+        ++*skipped;
+        ++i;
+        continue;
+      }
+      size_t end = i + 1U;
+      while (end < count && memcmp(shadow + end * value_size,
+                                   values + end * value_size, value_size))
+        ++end;
+      memcpy(shadow + i * value_size, values + i * value_size,
+             (end - i) * value_size);
+      rb->SendUniformRange(uniform, entry->location, i, end - i, gm);
+      *sent += end - i;
+      i = end;
+    }
+  }
+}
+
 void Renderer::ShaderProgramResource::UpdateUniformValues(ResourceBinder* rb) {
   GraphicsManager* gm = GetGraphicsManager();
 
+  size_t sent = 0U;
+  size_t skipped = 0U;
   const size_t uniform_count = uniforms_.size();
   for (size_t i = 0; i < uniform_count; ++i) {
     UniformCacheEntry& entry = uniforms_[i];
@@ -3609,7 +7606,7 @@ void Renderer::ShaderProgramResource::UpdateUniformValues(ResourceBinder* rb) {
                      << GetShaderProgram().GetLabel() << "', rendering"
                      << " results may be unexpected";
       }
-      return;
+      break;
     }
     // A Uniform needs to be sent if any of the following are true:
     // - The entry Uniform is invalid (i.e., the Uniform has never been sent)
@@ -3619,8 +7616,11 @@ void Renderer::ShaderProgramResource::UpdateUniformValues(ResourceBinder* rb) {
     //   been evicted from its image unit.
     bool skip_sending_uniform = false;
     bool unit_changed = false;
-    if (uniform.GetType() == kTextureUniform ||
-        uniform.GetType() == kCubeMapTextureUniform) {
+    const bool is_texture = uniform.GetType() == kTextureUniform ||
+                            uniform.GetType() == kCubeMapTextureUniform;
+    const size_t count =
+        std::max(uniform.GetCount(), static_cast<size_t>(1U));
+    if (is_texture) {
       // Update unit associations and check if any units have changed.
       unit_changed = UpdateUnitAssociations(&entry, rb, uniform);
       skip_sending_uniform = !unit_changed;
@@ -3636,97 +7636,296 @@ void Renderer::ShaderProgramResource::UpdateUniformValues(ResourceBinder* rb) {
       entry.uniform_stamp = uniform.GetStamp();
       // Emit tracing label even if we don't send uniform.
       ScopedLabel label(rb, &uniform, entry.spec->name);
-      if (!skip_sending_uniform) {
+      if (skip_sending_uniform) {
+        skipped += count;
+      } else if (is_texture) {
         // Send the value to OpenGL.
         rb->SendUniform(uniform, entry.location, gm);
+        sent += count;
+      } else {
+        // Send only the values that differ from those last sent.
+        SendChangedValues(&entry, uniform, rb, gm, &sent, &skipped);
+      }
+    } else {
+      skipped += count;
+    }
+  }
+  rb->GetResourceManager()->CountUniformValues(sent, skipped);
+  if (NodeCpuTimer* timer = rb->GetNodeCpuTimer())
+    timer->CountUniforms(sent);
+}
+
+const ProgramBinaryCachePtr Renderer::ShaderProgramResource::GetBinaryCache() {
+  return GetGraphicsManager()->IsFunctionGroupAvailable(
+             GraphicsManager::kProgramBinary)
+             ? GetResourceManager()->GetProgramBinaryCache()
+             : ProgramBinaryCachePtr();
+}
+
+void Renderer::ShaderProgramResource::BindAttributes(GLuint id,
+                                                     bool request_binary) {
+  // Bind each attribute to its name in the shader, using its order in the
+  // registry.
+  const ShaderProgram& shader_program = GetShaderProgram();
+  const ShaderInputRegistryPtr& reg = shader_program.GetRegistry();
+  // Check that all inputs are unique in the registry.
+  if (!reg->CheckInputsAreUnique()) {
+    LOG(WARNING) << "***ION: Registry '" << reg->GetId() << " contains"
+                 << " multiple definitions of some inputs, rendering"
+                 << " results may be unexpected";
+  }
+
+  // Set up the attribute cache.
+  GraphicsManager* gm = GetGraphicsManager();
+  PopulateAttributeCache(id, shader_program.GetLabel(), reg, gm);
+
+  // Name the vertex shader outputs to capture with transform feedback.
+  const std::vector<std::string>& varyings =
+      shader_program.GetCapturedVaryings();
+  if (!varyings.empty() &&
+      gm->IsFunctionGroupAvailable(GraphicsManager::kTransformFeedback)) {
+    std::vector<const GLchar*> names(varyings.size());
+    for (size_t i = 0; i < varyings.size(); ++i)
+      names[i] = varyings[i].c_str();
+    gm->TransformFeedbackVaryings(id, static_cast<GLsizei>(names.size()),
+                                  &names[0], GL_INTERLEAVED_ATTRIBS);
+  }
+
+  // The binary must be requested before linking for some drivers to return
+  // it.
+  if (request_binary)
+    gm->ProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void Renderer::ShaderProgramResource::UseLinkedProgram(
+    GLuint id, bool need_to_update_label, const std::string& binary_key) {
+  if (id != 0) {
+    id_ = id;
+    need_to_update_label = true;
+  }
+
+  // Get all of the uniforms for this shader and set up their uniform
+  // locations in the cache. The key does not describe the previous program.
+  PopulateUniformCache(id != 0 ? binary_key : std::string());
+  // Linking resets the bindings of the program's uniform blocks.
+  uniform_blocks_.clear();
+
+  // We need to update the label if it has changed or either of the sources
+  // have since a new program object will be generated.
+  if (need_to_update_label)
+    SetObjectLabel(GetGraphicsManager(), GL_PROGRAM_OBJECT, id_,
+                   GetShaderProgram().GetLabel());
+}
+
+void Renderer::ShaderProgramResource::StartAsyncLink(
+    ResourceBinder* rb, const std::string& binary_key) {
+  GraphicsManager* gm = GetGraphicsManager();
+  rb->RequestShaderCompilerThreads(gm);
+
+  // Start the compilations; OpenGL links the program once they finish.
+  GLuint vertex_shader_id = 0;
+  GLuint fragment_shader_id = 0;
+  if (vertex_resource_) {
+    vertex_resource_->StartCompileIfDeferred();
+    vertex_shader_id = vertex_resource_->GetIdToAttach();
+  }
+  if (fragment_resource_) {
+    fragment_resource_->StartCompileIfDeferred();
+    fragment_shader_id = fragment_resource_->GetIdToAttach();
+  }
+
+  pending_id_ = gm->CreateProgram();
+  if (pending_id_) {
+    if (vertex_shader_id)
+      gm->AttachShader(pending_id_, vertex_shader_id);
+    if (fragment_shader_id)
+      gm->AttachShader(pending_id_, fragment_shader_id);
+    gm->LinkProgram(pending_id_);
+    link_stage_ = kLinkCompiling;
+    pending_binary_key_ = binary_key;
+  } else {
+    LOG(ERROR) << "***ION: Unable to create shader program object";
+  }
+}
+
+void Renderer::ShaderProgramResource::ContinueAsyncLink(ResourceBinder* rb) {
+  GraphicsManager* gm = GetGraphicsManager();
+  // Move through as many stages as OpenGL has already finished.
+  while (link_stage_ != kLinkIdle && IsProgramLinkComplete(pending_id_, gm)) {
+    ScopedResourceLabel label(this, rb);
+    const ShaderProgram& shader_program = GetShaderProgram();
+    const std::string& id_string = shader_program.GetLabel();
+    const ProgramBinaryCachePtr cache =
+        pending_binary_key_.empty() ? ProgramBinaryCachePtr()
+                                    : GetBinaryCache();
+    std::string info_log;
+    bool is_finished = true;
+    if (link_stage_ == kLinkCompiling) {
+      // The shaders have finished compiling since the program has linked.
+      if (vertex_resource_)
+        vertex_resource_->FinishCompile(rb);
+      if (fragment_resource_)
+        fragment_resource_->FinishCompile(rb);
+      if (CheckProgramLinkStatus(id_string, pending_id_, &info_log, gm)) {
+        // Relink the program for the attribute bindings to take effect.
+        BindAttributes(pending_id_, cache.Get() != NULL);
+        gm->LinkProgram(pending_id_);
+        link_stage_ = kLinkRelinking;
+        is_finished = false;
       }
+    } else if (CheckProgramLinkStatus(id_string, pending_id_, &info_log, gm)) {
+      if (cache.Get())
+        StoreShaderProgramBinary(cache.Get(), pending_binary_key_, pending_id_,
+                                 gm);
+      UseLinkedProgram(pending_id_, true, pending_binary_key_);
+    }
+
+    if (is_finished) {
+      // The program has been deleted if it failed to link.
+      pending_id_ = 0U;
+      link_stage_ = kLinkIdle;
+      pending_binary_key_.clear();
+      // Send the info log to the holder.
+      shader_program.SetInfoLog(info_log);
     }
   }
 }
 
+void Renderer::ShaderProgramResource::CancelAsyncLink() {
+  if (pending_id_)
+    GetGraphicsManager()->DeleteProgram(pending_id_);
+  pending_id_ = 0U;
+  link_stage_ = kLinkIdle;
+  pending_binary_key_.clear();
+}
+
 void Renderer::ShaderProgramResource::Update(ResourceBinder* rb) {
   // If shaders have changed then we need to reset their cached resources.
-  if (TestModifiedBit(ShaderProgram::kVertexShaderChanged))
+  if (TestModifiedBit(ShaderProgram::kVertexShaderChanged) ||
+      TestModifiedBit(ShaderProgram::kComputeShaderChanged))
     vertex_resource_ = NULL;
-  if (TestModifiedBit(ShaderProgram::kFragmentShaderChanged))
+  if (TestModifiedBit(ShaderProgram::kFragmentShaderChanged) ||
+      TestModifiedBit(ShaderProgram::kComputeShaderChanged))
     fragment_resource_ = NULL;
+  // Shaders are only compiled when needed if the program may be loaded from a
+  // cached binary, and are compiled along with the program if it is linked
+  // asynchronously. The cache is only looked up if something has changed,
+  // since this is called every time the program is bound.
+  GraphicsManager* gm = GetGraphicsManager();
+  ProgramBinaryCachePtr cache;
+  bool link_async = false;
+  if (AnyModifiedBitsSet() ||
+      (vertex_resource_ && vertex_resource_->AnyModifiedBitsSet()) ||
+      (fragment_resource_ && fragment_resource_->AnyModifiedBitsSet())) {
+    cache = GetBinaryCache();
+    link_async = GetResourceManager()->ShouldCompileShadersAsynchronously();
+  }
+  const bool defer_compile = cache.Get() != NULL || link_async;
   // Allow shaders to Update().
   const bool vertex_updated =
-      vertex_resource_ && vertex_resource_->UpdateShader(rb);
+      vertex_resource_ && vertex_resource_->UpdateShader(rb, defer_compile);
   const bool fragment_updated =
-      fragment_resource_ && fragment_resource_->UpdateShader(rb);
+      fragment_resource_ &&
+      fragment_resource_->UpdateShader(rb, defer_compile);
   if (vertex_updated || fragment_updated || AnyModifiedBitsSet()) {
     ScopedResourceLabel label(this, rb);
+    rb->CountResourceUpdate();
     const ShaderProgram& shader_program = GetShaderProgram();
+    // Any link in progress is of the previous shaders.
+    CancelAsyncLink();
 
     if (!vertex_resource_) {
-      if (Shader* shader = shader_program.GetVertexShader().Get()) {
+      const bool is_compute = shader_program.IsCompute();
+      if (Shader* shader = is_compute
+                               ? shader_program.GetComputeShader().Get()
+                               : shader_program.GetVertexShader().Get()) {
         if ((vertex_resource_ = GetResource(shader, rb), rb)) {
-          vertex_resource_->SetShaderType(GL_VERTEX_SHADER);
-          vertex_resource_->UpdateShader(rb);
+          vertex_resource_->SetShaderType(is_compute ? GL_COMPUTE_SHADER
+                                                     : GL_VERTEX_SHADER);
+          vertex_resource_->UpdateShader(rb, defer_compile);
         }
       }
     }
-    if (!fragment_resource_) {
+    if (!fragment_resource_ && !shader_program.IsCompute()) {
       if (Shader* shader = shader_program.GetFragmentShader().Get()) {
         if ((fragment_resource_ = GetResource(shader, rb))) {
           fragment_resource_->SetShaderType(GL_FRAGMENT_SHADER);
-          fragment_resource_->UpdateShader(rb);
+          fragment_resource_->UpdateShader(rb, defer_compile);
         }
       }
     }
 
-    const GLuint vertex_shader_id =
-        vertex_resource_ ? vertex_resource_->GetId() : 0;
-    const GLuint fragment_shader_id =
-        fragment_resource_ ? fragment_resource_->GetId() : 0;
-
-    // Create a program object and attach the two compiled shaders.
     const std::string& id_string = shader_program.GetLabel();
-    GraphicsManager* gm = GetGraphicsManager();
-
     std::string info_log = shader_program.GetInfoLog();
-    GLuint id = LinkShaderProgram(id_string, vertex_shader_id,
-                                  fragment_shader_id, &info_log, gm);
-
-    if (id != 0) {
-      // Bind each attribute to its name in the shader, using its order in
-      // the registry.
-      const ShaderInputRegistryPtr& reg = shader_program.GetRegistry();
-      // Check that all inputs are unique in the registry.
-      if (!reg->CheckInputsAreUnique()) {
-        LOG(WARNING) << "***ION: Registry '" << reg->GetId() << " contains"
-                     << " multiple definitions of some inputs, rendering"
-                     << " results may be unexpected";
-      }
 
-      // Set up the attribute cache.
-      PopulateAttributeCache(id, id_string, reg, gm);
+    // Try to load the program from its cached binary.
+    GLuint id = 0;
+    std::string binary_key;
+    if (cache.Get()) {
+      // The captured varyings are linked into the binary, so they are part
+      // of the key.
+      std::string vertex_source =
+          vertex_resource_ ? vertex_resource_->GetShader().GetSource() : "";
+      const std::vector<std::string>& varyings =
+          shader_program.GetCapturedVaryings();
+      for (size_t i = 0; i < varyings.size(); ++i)
+        vertex_source += '\0' + varyings[i];
+      binary_key = ProgramBinaryCache::ComputeKey(
+          vertex_source,
+          fragment_resource_ ? fragment_resource_->GetShader().GetSource()
+                             : "",
+          gm->GetGlRenderer(), gm->GetGlVersionString());
+      id = LoadShaderProgramBinary(cache.Get(), binary_key, gm);
+      GetResourceManager()->CountProgramBinaryLookup(id != 0);
+      if (id)
+        info_log.clear();
+    }
+    const bool is_binary_loaded = id != 0;
+
+    if (!is_binary_loaded && link_async) {
+      // The previous program, if any, is used until the link finishes.
+      StartAsyncLink(rb, binary_key);
+    } else {
+      GLuint vertex_shader_id = 0;
+      GLuint fragment_shader_id = 0;
+      if (!is_binary_loaded) {
+        if (vertex_resource_) {
+          vertex_resource_->CompileIfDeferred(rb);
+          vertex_shader_id = vertex_resource_->GetId();
+        }
+        if (fragment_resource_) {
+          fragment_resource_->CompileIfDeferred(rb);
+          fragment_shader_id = fragment_resource_->GetId();
+        }
 
-      // Relink the program for the bindings to take effect.
-      id = RelinkShaderProgram(id_string, id, vertex_shader_id,
+        // Create a program object and attach the two compiled shaders.
+        id = LinkShaderProgram(id_string, vertex_shader_id,
                                fragment_shader_id, &info_log, gm);
-      bool need_to_update_label =
-          vertex_updated || fragment_updated ||
-          TestModifiedBit(ResourceHolder::kLabelChanged);
-      if (id != 0) {
-        id_ = id;
-        need_to_update_label = true;
       }
 
-      // Get all of the uniforms for this shader from OpenGL and set up their
-      // uniform locations in the cache.
-      PopulateUniformCache();
+      if (id != 0) {
+        // A binary already contains the attribute bindings, since it was
+        // linked with them.
+        BindAttributes(id, !is_binary_loaded && cache.Get());
+        if (!is_binary_loaded) {
+          // Relink the program for the bindings to take effect.
+          id = RelinkShaderProgram(id_string, id, vertex_shader_id,
+                                   fragment_shader_id, &info_log, gm);
+          if (id != 0 && cache.Get())
+            StoreShaderProgramBinary(cache.Get(), binary_key, id, gm);
+        }
+        const bool need_to_update_label =
+            vertex_updated || fragment_updated ||
+            TestModifiedBit(ResourceHolder::kLabelChanged);
+        UseLinkedProgram(id, need_to_update_label, binary_key);
+      }
 
-      // We need to update the label if it has changed or either of the sources
-      // have since a new program object will be generated.
-      if (need_to_update_label)
-        SetObjectLabel(gm, GL_PROGRAM_OBJECT, id_, shader_program.GetLabel());
+      // Send the info logs to the holder.
+      shader_program.SetInfoLog(info_log);
     }
-
-    // Send the info logs to the holder.
-    shader_program.SetInfoLog(info_log);
     ResetModifiedBits();
+  } else if (link_stage_ != kLinkIdle) {
+    ContinueAsyncLink(rb);
   }
 }
 
@@ -3737,6 +7936,45 @@ void Renderer::ShaderProgramResource::Bind(ResourceBinder* rb) {
     rb->BindProgram(id_, this);
     // Ensure that the latest uniform values are sent to OpenGL.
     UpdateUniformValues(rb);
+    BindUniformBuffers(rb);
+  }
+}
+
+void Renderer::ShaderProgramResource::BindUniformBuffers(ResourceBinder* rb) {
+  const base::AllocVector<ResourceBinder::UniformBufferBlock>& blocks =
+      rb->GetUniformBufferBlocks();
+  const size_t num_blocks = blocks.size();
+  GraphicsManager* gm = GetGraphicsManager();
+  for (size_t i = 0; i < num_blocks; ++i) {
+    // Find the index of the block in the program, querying OpenGL the first
+    // time the block is used with the program.
+    const std::string& name = blocks[i].block->GetBlockName();
+    UniformBlockEntry* entry = NULL;
+    const size_t num_entries = uniform_blocks_.size();
+    for (size_t j = 0; j < num_entries; ++j) {
+      if (uniform_blocks_[j].name == name) {
+        entry = &uniform_blocks_[j];
+        break;
+      }
+    }
+    if (!entry) {
+      uniform_blocks_.push_back(UniformBlockEntry());
+      entry = &uniform_blocks_.back();
+      entry->name = name;
+      entry->index = gm->GetUniformBlockIndex(id_, name.c_str());
+    }
+    // Programs that do not declare the block do not use its values.
+    if (entry->index == GL_INVALID_INDEX)
+      continue;
+
+    // Each block is bound to the binding point of its position in the stack,
+    // so that buffers are shared by all programs that use the block.
+    const GLuint binding = static_cast<GLuint>(i);
+    if (entry->binding != binding) {
+      gm->UniformBlockBinding(id_, entry->index, binding);
+      entry->binding = binding;
+    }
+    rb->BindUniformBuffer(binding, blocks[i].resource);
   }
 }
 
@@ -3747,10 +7985,16 @@ void Renderer::ShaderProgramResource::Unbind(ResourceBinder* rb) {
 
 void Renderer::ShaderProgramResource::Release(bool can_make_gl_calls) {
   BaseResourceType::Release(can_make_gl_calls);
+  if (pending_id_) {
+    if (can_make_gl_calls)
+      GetGraphicsManager()->DeleteProgram(pending_id_);
+    pending_id_ = 0U;
+    link_stage_ = kLinkIdle;
+  }
   if (id_) {
     // unbind all and remove vertex array keys from all binders
-    base::ReadLock read_lock(GetResourceBinderLock());
-    base::ReadGuard read_guard(&read_lock);
+    base::BigReaderReadLock read_lock(GetResourceBinderLock());
+    base::BigReaderReadGuard read_guard(&read_lock);
     ResourceBinderMap& binders = GetResourceBinderMap();
     for (ResourceBinderMap::iterator it = binders.begin();
          it != binders.end();
@@ -3777,7 +8021,14 @@ class Renderer::BufferResource : public Resource<BufferObject::kNumChanges> {
                  const BufferObject& buffer_object, GLuint id)
       : Renderer::Resource<BufferObject::kNumChanges>(rm, buffer_object, id),
         target_(buffer_object.GetTarget()),
-        gl_target_(base::EnumHelper::GetConstant(target_)) {}
+        gl_target_(base::EnumHelper::GetConstant(target_)),
+        mapped_storage_(NULL),
+        region_size_(0U),
+        region_(0U),
+        contents_modified_(false) {
+    for (size_t i = 0; i < kRegionCount; ++i)
+      region_frames_[i] = 0U;
+  }
 
   ~BufferResource() override {
     DCHECK(id_ == 0U || !portgfx::Visual::GetCurrent());
@@ -3793,8 +8044,27 @@ class Renderer::BufferResource : public Resource<BufferObject::kNumChanges> {
 
   GLuint GetGlTarget() const { return gl_target_; }
 
+  // Returns whether the data is kept in persistently mapped storage.
+  bool IsPersistentlyMapped() const { return mapped_storage_ != NULL; }
+  // Returns the offset of the current data within the OpenGL buffer.
+  size_t GetDataOffset() const { return region_ * region_size_; }
+  // Returns the size of the BufferObject's data in bytes.
+  size_t GetDataSize() const {
+    const BufferObject& bo = GetBufferObject();
+    return bo.GetStructSize() * bo.GetCount();
+  }
+
   void UploadData(const void* data);
   void UploadSubData(const Range1ui& range, const void* data) const;
+  // Uploads all of the BufferObject's pending sub-data, sorting the ranges and
+  // merging those that overlap or are close enough together into single
+  // uploads, or replacing all of the data if enough of it has changed.
+  void UploadCoalescedSubData();
+
+  // Records that the buffer contents were changed in a way that cannot be
+  // recreated from the BufferObject's data.
+  void MarkContentsModified() { contents_modified_ = true; }
+  bool IsEvictable() const override;
 
   void OnDestroyed() override {
     Renderer::Resource<BufferObject::kNumChanges>::OnDestroyed();
@@ -3808,11 +8078,47 @@ class Renderer::BufferResource : public Resource<BufferObject::kNumChanges> {
     return static_cast<const BufferObject&>(GetHolder());
   }
 
+  // Copies the passed data into the next region of the persistently mapped
+  // storage, creating the storage if needed. Returns false if the storage
+  // could not be created.
+  bool WriteMappedData(const void* data, size_t size, ResourceBinder* rb);
+  // Replaces the OpenGL buffer with a new one, since the storage of a buffer
+  // created with BufferStorage() cannot be changed.
+  void RecreateBuffer(ResourceBinder* rb);
+  // Releases any persistently mapped storage.
+  void ReleaseMappedStorage(ResourceBinder* rb);
+
+  // The number of copies of the data kept in persistently mapped storage, and
+  // the alignment of each.
+  static const size_t kRegionCount = 3U;
+  static const size_t kRegionAlignment = 64U;
+
   BufferObject::Target target_;
   GLuint gl_target_;
+
+  // The persistently mapped storage, if any, the size of each of its
+  // regions, the region holding the current data, and the frame in which
+  // each region was last used.
+  uint8* mapped_storage_;
+  size_t region_size_;
+  size_t region_;
+  uint64 region_frames_[kRegionCount];
+
+  // Whether the buffer contents differ from the BufferObject's data, because
+  // of sub-data updates or writes through a mapping.
+  bool contents_modified_;
 };
 
+bool Renderer::BufferResource::IsEvictable() const {
+  if (!HasHolder() || !resource_owns_gl_id_ || !id_ || contents_modified_)
+    return false;
+  const BufferObject& bo = GetBufferObject();
+  return !bo.GetMappedPointer() && bo.GetData().Get() &&
+         bo.GetData()->IsDataAvailable();
+}
+
 void Renderer::BufferResource::Bind(ResourceBinder* rb) {
+  MarkUsed();
   Update(rb);
   if (id_) {
     ScopedResourceLabel label(this, rb);
@@ -3825,25 +8131,185 @@ void Renderer::BufferResource::UploadData(const void* data) {
   const size_t size = bo.GetStructSize() * bo.GetCount();
   SetUsedGpuMemory(size);
   GetGraphicsManager()->BufferData(
-      gl_target_, size, bo.GetData()->GetData(),
+      gl_target_, size, data,
       base::EnumHelper::GetConstant(bo.GetUsageMode()));
 }
 
 void Renderer::BufferResource::UploadSubData(const Range1ui& range,
                                              const void* data) const {
-  GetGraphicsManager()->BufferSubData(gl_target_, range.GetMinPoint(),
+  GetGraphicsManager()->BufferSubData(gl_target_,
+                                      GetDataOffset() + range.GetMinPoint(),
                                       range.GetSize(), data);
 }
 
+void Renderer::BufferResource::UploadCoalescedSubData() {
+  const BufferObject& bo = GetBufferObject();
+  const base::AllocVector<BufferObject::BufferSubData>& sub_data =
+      bo.GetSubData();
+  const size_t data_size = GetDataSize();
+  const base::DataContainer* container = bo.GetData().Get();
+  const uint8* base_data =
+      container ? static_cast<const uint8*>(container->GetData()) : NULL;
+
+  // Ranges that lie outside the data are uploaded unchanged, so that OpenGL
+  // reports the error.
+  std::vector<size_t> order;
+  order.reserve(sub_data.size());
+  for (size_t i = 0; i < sub_data.size(); ++i) {
+    const BufferObject::BufferSubData& sd = sub_data[i];
+    if (!sd.data.Get() || !sd.data->GetData())
+      continue;
+    if (sd.range.GetMaxPoint() <= data_size)
+      order.push_back(i);
+    else
+      UploadSubData(sd.range, sd.data->GetData());
+  }
+  std::stable_sort(order.begin(), order.end(), [&sub_data](size_t a,
+                                                           size_t b) {
+    return sub_data[a].range.GetMinPoint() < sub_data[b].range.GetMinPoint();
+  });
+
+  // Merge the sorted ranges into spans, each covering order[begin, end).
+  struct Span {
+    size_t begin;
+    size_t end;
+    size_t min;
+    size_t max;
+  };
+  const size_t gap = base_data ? bo.GetSubDataMergeGap() : 0U;
+  std::vector<Span> spans;
+  size_t dirty_size = 0U;
+  for (size_t i = 0; i < order.size(); ++i) {
+    const Range1ui& range = sub_data[order[i]].range;
+    if (!spans.empty() && range.GetMinPoint() <= spans.back().max + gap) {
+      spans.back().end = i + 1U;
+      spans.back().max =
+          std::max(spans.back().max, static_cast<size_t>(range.GetMaxPoint()));
+    } else {
+      const Span span = {i, i + 1U, range.GetMinPoint(), range.GetMaxPoint()};
+      spans.push_back(span);
+    }
+  }
+  for (size_t i = 0; i < spans.size(); ++i)
+    dirty_size += spans[i].max - spans[i].min;
+
+  // Copies the sub-data of order[begin, end) into storage that starts at byte
+  // offset origin of the data. Later sub-data overwrites earlier sub-data.
+  const auto copy_sub_data = [&sub_data, &order](size_t begin, size_t end,
+                                                 size_t origin,
+                                                 uint8* storage) {
+    std::vector<size_t> indices(order.begin() + begin, order.begin() + end);
+    std::sort(indices.begin(), indices.end());
+    for (size_t i = 0; i < indices.size(); ++i) {
+      const BufferObject::BufferSubData& sd = sub_data[indices[i]];
+      memcpy(storage + sd.range.GetMinPoint() - origin, sd.data->GetData(),
+             sd.range.GetSize());
+    }
+  };
+
+  // Persistently mapped storage is immutable, so it cannot be replaced.
+  const float fraction = bo.GetSubDataReplaceFraction();
+  if (!mapped_storage_ && dirty_size && fraction <= 1.f &&
+      static_cast<float>(dirty_size) >=
+          fraction * static_cast<float>(data_size) &&
+      (base_data || dirty_size == data_size)) {
+    std::vector<uint8> storage(data_size);
+    if (base_data)
+      memcpy(&storage[0], base_data, data_size);
+    copy_sub_data(0U, order.size(), 0U, &storage[0]);
+    UploadData(&storage[0]);
+  } else {
+    for (size_t i = 0; i < spans.size(); ++i) {
+      const Span& span = spans[i];
+      const BufferObject::BufferSubData& first = sub_data[order[span.begin]];
+      if (span.end == span.begin + 1U) {
+        UploadSubData(first.range, first.data->GetData());
+      } else {
+        std::vector<uint8> storage(span.max - span.min);
+        if (base_data)
+          memcpy(&storage[0], base_data + span.min, storage.size());
+        copy_sub_data(span.begin, span.end, span.min, &storage[0]);
+        UploadSubData(Range1ui(static_cast<uint32>(span.min),
+                               static_cast<uint32>(span.max)),
+                      &storage[0]);
+      }
+    }
+  }
+}
+
+bool Renderer::BufferResource::WriteMappedData(const void* data, size_t size,
+                                               ResourceBinder* rb) {
+  GraphicsManager* gm = GetGraphicsManager();
+  FrameFenceQueue* fences = GetResourceManager()->GetFrameFenceQueue();
+  if (mapped_storage_ && size <= region_size_) {
+    // Move on to the next region, waiting until OpenGL has finished any
+    // commands that read it.
+    region_frames_[region_] = fences->UseFrame();
+    region_ = (region_ + 1U) % kRegionCount;
+    fences->WaitForFrame(region_frames_[region_], gm);
+  } else {
+    if (mapped_storage_)
+      ReleaseMappedStorage(rb);
+    const size_t region_size =
+        (size + kRegionAlignment - 1U) / kRegionAlignment * kRegionAlignment;
+    const size_t storage_size = region_size * kRegionCount;
+    static const GLbitfield kMapBits =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    // Sub-data updates use BufferSubData(), which requires dynamic storage.
+    gm->BufferStorage(gl_target_, static_cast<GLsizeiptr>(storage_size), NULL,
+                      kMapBits | GL_DYNAMIC_STORAGE_BIT);
+    mapped_storage_ = static_cast<uint8*>(gm->MapBufferRange(
+        gl_target_, 0, static_cast<GLsizeiptr>(storage_size), kMapBits));
+    if (!mapped_storage_) {
+      LOG(WARNING) << "***ION: Unable to persistently map buffer object \""
+                   << GetBufferObject().GetLabel()
+                   << "\", uploading its data directly instead.";
+      // The buffer's storage may now be immutable.
+      RecreateBuffer(rb);
+      return false;
+    }
+    region_size_ = region_size;
+    region_ = 0U;
+    for (size_t i = 0; i < kRegionCount; ++i)
+      region_frames_[i] = 0U;
+    SetUsedGpuMemory(storage_size);
+  }
+  memcpy(mapped_storage_ + GetDataOffset(), data, size);
+  return true;
+}
+
+void Renderer::BufferResource::RecreateBuffer(ResourceBinder* rb) {
+  GraphicsManager* gm = GetGraphicsManager();
+  rb->ClearBufferBinding(target_, id_);
+  GetResourceManager()->GetSharedVertexArrayCache()->RemoveArraysUsingBuffer(
+      id_);
+  // The buffer is deleted immediately, since that unmaps it.
+  gm->DeleteBuffers(1, &id_);
+  id_ = GetResourceManager()->GetObjectNameCache()->Generate(
+      ObjectNameCache::kBufferNames, gm);
+  rb->BindBuffer(target_, id_, this);
+}
+
+void Renderer::BufferResource::ReleaseMappedStorage(ResourceBinder* rb) {
+  // Deleting the buffer also unmaps it.
+  RecreateBuffer(rb);
+  mapped_storage_ = NULL;
+  region_size_ = 0U;
+  region_ = 0U;
+}
+
 void Renderer::BufferResource::Update(ResourceBinder* rb) {
   if (AnyModifiedBitsSet()) {
     ScopedResourceLabel label(this, rb);
+    rb->CountResourceUpdate();
 
     // Generate the VBO.
     GraphicsManager* gm = GetGraphicsManager();
     DCHECK(gm);
-    if (!id_)
-      gm->GenBuffers(1, &id_);
+    if (!id_) {
+      id_ = GetResourceManager()->GetObjectNameCache()->Generate(
+          ObjectNameCache::kBufferNames, gm);
+    }
     if (id_) {
       // If the resource was changed elsewhere then we need to ensure that it is
       // bound again.
@@ -3869,7 +8335,15 @@ void Renderer::BufferResource::Update(ResourceBinder* rb) {
 
       if (TestModifiedBit(BufferObject::kDataChanged)) {
         if (bo.GetData().Get()) {
-          UploadData(bo.GetData()->GetData());
+          bo.GetData()->ReloadData();
+          const void* data = bo.GetData()->GetData();
+          if (!resource_owns_gl_id_ ||
+              !GetResourceManager()->ShouldPersistentlyMapBuffer(bo, gm) ||
+              !WriteMappedData(data, bo.GetStructSize() * bo.GetCount(), rb)) {
+            if (mapped_storage_)
+              ReleaseMappedStorage(rb);
+            UploadData(data);
+          }
           // Notify the data container that the data has been used and can be
           // deleted if requested.
           bo.GetData()->WipeData();
@@ -3882,10 +8356,11 @@ void Renderer::BufferResource::Update(ResourceBinder* rb) {
       if (TestModifiedBit(BufferObject::kSubDataChanged)) {
         const base::AllocVector<BufferObject::BufferSubData>& sub_data =
             bo.GetSubData();
+        UploadCoalescedSubData();
         const size_t count = sub_data.size();
         for (size_t i = 0; i < count; ++i) {
           if (sub_data[i].data.Get() && sub_data[i].data->GetData()) {
-            UploadSubData(sub_data[i].range, sub_data[i].data->GetData());
+            contents_modified_ = true;
             // Notify the data container that the data has been used and can
             // be deleted if requested.
             sub_data[i].data->WipeData();
@@ -3915,11 +8390,18 @@ void Renderer::BufferResource::Release(bool can_make_gl_calls) {
   BaseResourceType::Release(can_make_gl_calls);
   if (id_) {
     UnbindAll();
-    if (resource_owns_gl_id_ && can_make_gl_calls)
-      GetGraphicsManager()->DeleteBuffers(1, &id_);
+    GetResourceManager()->GetSharedVertexArrayCache()->RemoveArraysUsingBuffer(
+        id_);
+    if (resource_owns_gl_id_ && can_make_gl_calls) {
+      GetResourceManager()->GetObjectNameCache()->Delete(
+          ObjectNameCache::kBufferNames, id_, GetGraphicsManager());
+    }
     SetUsedGpuMemory(0U);
     id_ = 0;
   }
+  mapped_storage_ = NULL;
+  region_size_ = 0U;
+  region_ = 0U;
 }
 
 //-----------------------------------------------------------------------------
@@ -3967,6 +8449,15 @@ class Renderer::FramebufferResource
 
   void UpdateMemoryUsage(const FramebufferObject& fbo);
 
+  // Returns whether the color attachment of the passed FramebufferObject is a
+  // texture rendered to with EXT_multisampled_render_to_texture, in which
+  // case its multisampled renderbuffers must be implicitly resolved as well.
+  static bool HasMultisampledTexture(const FramebufferObject& fbo) {
+    const FramebufferObject::Attachment& color = fbo.GetColorAttachment(0U);
+    return color.GetBinding() == FramebufferObject::kTexture &&
+           color.GetSamples() > 0;
+  }
+
   // Renderbuffer attachment ids.
   GLuint color0_id_;
   GLuint depth_id_;
@@ -3994,7 +8485,23 @@ void Renderer::FramebufferResource::UpdateAttachment(
     if (*id) {
       // Bind the renderbuffer to set its format.
       gm->BindRenderbuffer(GL_RENDERBUFFER, *id);
-      if (attachment.GetSamples() > 0) {
+      if (attachment.GetSamples() > 0 && HasMultisampledTexture(fbo)) {
+        // The renderbuffer must be resolved implicitly like the texture, or
+        // be single-sampled like it if that is not supported.
+        if (gm->IsFunctionGroupAvailable(
+                GraphicsManager::kMultisampledRenderToTexture)) {
+          gm->RenderbufferStorageMultisampleEXT(
+              GL_RENDERBUFFER,
+              static_cast<GLsizei>(attachment.GetSamples()),
+              Image::GetPixelFormat(attachment.GetFormat()).internal_format,
+              fbo.GetWidth(), fbo.GetHeight());
+        } else {
+          gm->RenderbufferStorage(
+              GL_RENDERBUFFER,
+              Image::GetPixelFormat(attachment.GetFormat()).internal_format,
+              fbo.GetWidth(), fbo.GetHeight());
+        }
+      } else if (attachment.GetSamples() > 0) {
         gm->RenderbufferStorageMultisample(
             GL_RENDERBUFFER,
             static_cast<GLsizei>(attachment.GetSamples()),
@@ -4062,6 +8569,46 @@ void Renderer::FramebufferResource::UpdateAttachment(
     gm->FramebufferTexture2D(GL_FRAMEBUFFER, target,
                              base::EnumHelper::GetConstant(face), tr->GetId(),
                              static_cast<GLint>(mip_level));
+  } else if (attachment.GetBinding() ==
+             FramebufferObject::kMultiviewTexture) {
+    DCHECK(attachment.GetTexture().Get());
+
+    // Ensure the texture is an array with a layer for each view that has the
+    // same dimensions as the framebuffer.
+    Texture* tex = attachment.GetTexture().Get();
+    TextureResource* tr = GetResource(tex, rb);
+    DCHECK(tr);
+    const size_t mip_level = attachment.GetMipLevel();
+    const uint32 layer_count =
+        attachment.GetBaseViewIndex() + attachment.GetNumViews();
+    ImagePtr image = tex->GetImage(mip_level);
+    if (image.Get()) {
+      if (image->GetDimensions() != Image::k3d ||
+          image->GetType() != Image::kArray ||
+          image->GetWidth() != fbo.GetWidth() ||
+          image->GetHeight() != fbo.GetHeight() ||
+          image->GetDepth() < layer_count) {
+        LOG(ERROR) << "***ION: Multiview Texture must be an array of at least "
+                   << layer_count << " layers of " << fbo.GetWidth() << " x "
+                   << fbo.GetHeight();
+      }
+    } else {
+      image = new(GetAllocatorForLifetime(base::kMediumTerm)) Image;
+      image->SetArray(Image::kRgba8888, fbo.GetWidth(), fbo.GetHeight(),
+                      layer_count, DataContainerPtr(NULL));
+      tex->SetImage(mip_level, image);
+    }
+    tr->Bind(rb);
+    if (gm->IsFunctionGroupAvailable(GraphicsManager::kMultiview)) {
+      gm->FramebufferTextureMultiviewOVR(
+          GL_FRAMEBUFFER, target, tr->GetId(), static_cast<GLint>(mip_level),
+          static_cast<GLint>(attachment.GetBaseViewIndex()),
+          static_cast<GLsizei>(attachment.GetNumViews()));
+    } else {
+      LOG(ERROR) << "***ION: Multiview attachments require OVR_multiview; "
+                 << "views must be drawn separately on this platform.";
+      gm->FramebufferRenderbuffer(GL_FRAMEBUFFER, target, GL_RENDERBUFFER, 0);
+    }
   } else {
     DCHECK_EQ(FramebufferObject::kTexture, attachment.GetBinding());
     DCHECK(attachment.GetTexture().Get());
@@ -4097,29 +8644,50 @@ void Renderer::FramebufferResource::UpdateAttachment(
     }
     tr->Bind(rb);
     // Bind the texture to the attachment.
-    gm->FramebufferTexture2D(GL_FRAMEBUFFER, target, tr->GetGlTarget(),
-                             tr->GetId(), static_cast<GLint>(mip_level));
+    const size_t samples = attachment.GetSamples();
+    if (samples && gm->IsFunctionGroupAvailable(
+                       GraphicsManager::kMultisampledRenderToTexture)) {
+      gm->FramebufferTexture2DMultisampleEXT(
+          GL_FRAMEBUFFER, target, tr->GetGlTarget(), tr->GetId(),
+          static_cast<GLint>(mip_level), static_cast<GLsizei>(samples));
+    } else {
+      if (samples) {
+        LOG_ONCE(WARNING) << "***ION: EXT_multisampled_render_to_texture is "
+                          << "not supported; rendering to Texture \""
+                          << tex->GetLabel() << "\" without multisampling.";
+      }
+      gm->FramebufferTexture2D(GL_FRAMEBUFFER, target, tr->GetGlTarget(),
+                               tr->GetId(), static_cast<GLint>(mip_level));
+    }
   }
 }
 
+// Returns the number of bytes in a renderbuffer for the passed attachment of
+// fbo, which stores each of its samples separately.
+static size_t ComputeRenderbufferSize(
+    const FramebufferObject& fbo,
+    const FramebufferObject::Attachment& attachment) {
+  return Image::ComputeDataSize(attachment.GetFormat(), fbo.GetWidth(),
+                                fbo.GetHeight()) *
+         std::max<size_t>(1U, attachment.GetSamples());
+}
+
 void Renderer::FramebufferResource::UpdateMemoryUsage(
     const FramebufferObject& fbo) {
   size_t data_size = 0U;
   if (color0_id_)
-    data_size += Image::ComputeDataSize(fbo.GetColorAttachment(0U).GetFormat(),
-                                        fbo.GetWidth(), fbo.GetHeight());
+    data_size += ComputeRenderbufferSize(fbo, fbo.GetColorAttachment(0U));
   if (depth_id_)
-    data_size += Image::ComputeDataSize(fbo.GetDepthAttachment().GetFormat(),
-                                        fbo.GetWidth(), fbo.GetHeight());
+    data_size += ComputeRenderbufferSize(fbo, fbo.GetDepthAttachment());
   if (stencil_id_)
-    data_size += Image::ComputeDataSize(fbo.GetStencilAttachment().GetFormat(),
-                                        fbo.GetWidth(), fbo.GetHeight());
+    data_size += ComputeRenderbufferSize(fbo, fbo.GetStencilAttachment());
   SetUsedGpuMemory(data_size);
 }
 
 void Renderer::FramebufferResource::Update(ResourceBinder* rb) {
   if (AnyModifiedBitsSet()) {
     ScopedResourceLabel label(this, rb);
+    rb->CountResourceUpdate();
 
     // Generate the FBO if necessary.
     GraphicsManager* gm = GetGraphicsManager();
@@ -4135,12 +8703,18 @@ void Renderer::FramebufferResource::Update(ResourceBinder* rb) {
           TestModifiedBit(FramebufferObject::kDimensionsChanged))
         UpdateAttachment(gm, rb, &color0_id_, GL_COLOR_ATTACHMENT0, fbo,
                          fbo.GetColorAttachment(0U));
+      // Multisampled renderbuffers also depend on the color attachment; see
+      // UpdateAttachment().
+      const bool color_changed =
+          TestModifiedBit(FramebufferObject::kColorAttachmentChanged);
       if (TestModifiedBit(FramebufferObject::kDepthAttachmentChanged) ||
-          TestModifiedBit(FramebufferObject::kDimensionsChanged))
+          TestModifiedBit(FramebufferObject::kDimensionsChanged) ||
+          (color_changed && fbo.GetDepthAttachment().GetSamples() > 0))
         UpdateAttachment(gm, rb, &depth_id_, GL_DEPTH_ATTACHMENT, fbo,
                          fbo.GetDepthAttachment());
       if (TestModifiedBit(FramebufferObject::kStencilAttachmentChanged) ||
-          TestModifiedBit(FramebufferObject::kDimensionsChanged))
+          TestModifiedBit(FramebufferObject::kDimensionsChanged) ||
+          (color_changed && fbo.GetStencilAttachment().GetSamples() > 0))
         UpdateAttachment(gm, rb, &stencil_id_, GL_STENCIL_ATTACHMENT, fbo,
                          fbo.GetStencilAttachment());
       UpdateMemoryUsage(fbo);
@@ -4210,7 +8784,8 @@ class Renderer::VertexArrayResource
                                                         id),
         buffer_attribute_infos_(attribute_array.GetAllocator()),
         simple_attribute_indices_(attribute_array.GetAllocator()),
-        vertex_count_(0U) {
+        vertex_count_(0U),
+        shared_array_(nullptr) {
     PopulateAttributeIndices(rb);
   }
 
@@ -4240,6 +8815,11 @@ class Renderer::VertexArrayResource
     element_array_binding_.resource = resource;
   }
 
+  // Marks this and the BufferResources of its attributes as used in the
+  // current frame. Since the VAO holds the buffer bindings, the buffers are
+  // not bound again for each draw.
+  void MarkBuffersUsed(ResourceBinder* rb);
+
  protected:
   const AttributeArray& GetAttributeArray() const {
     return static_cast<const AttributeArray&>(GetHolder());
@@ -4247,17 +8827,26 @@ class Renderer::VertexArrayResource
 
   virtual bool UpdateAndCheckBuffers(ResourceBinder* rb);
 
-  // Binds all single-valued attributes from the associated AttributeArray.
-  void BindSimpleAttributes();
+  // Binds all single-valued attributes from the associated AttributeArray,
+  // skipping values that rb already sent to the same attribute slots.
+  void BindSimpleAttributes(ResourceBinder* rb);
 
   // Binds a BufferObjectElement attribute. Returns if the binding was
   // successful. Binding might fail if a buffer object contained in an Attribute
   // or its data container are NULL, or if a resource cannot be created by
   // OpenGL. The number of slots that the attribute requires is also assigned
-  // if the binding is successful.
-  bool BindBufferObjectElementAttribute(GLuint attribute_index,
-                                        const Attribute& a, GLuint* slots,
-                                        ResourceBinder* rb);
+  // if the binding is successful. If layout is non-NULL then the attribute's
+  // buffer is only bound and the values describing its slots are appended to
+  // layout instead of being sent to OpenGL.
+  bool BindBufferObjectElementAttribute(
+      GLuint attribute_index, const Attribute& a, GLuint* slots,
+      ResourceBinder* rb, SharedVertexArrayCache::Layout* layout = nullptr);
+
+  // Sets the pointer and divisor of an attribute slot to the passed values.
+  virtual void SetAttributePointer(GLuint index, GLuint buffer, GLint size,
+                                   GLenum type, GLboolean normalized,
+                                   GLsizei stride, const void* pointer,
+                                   GLuint divisor, ResourceBinder* rb);
 
   // Clears the vertex count. It will be updated as attributes are bound.
   void ResetVertexCount() {
@@ -4301,16 +8890,26 @@ class Renderer::VertexArrayResource
   // Populates the vectors of indices of buffer and simple attributes.
   void PopulateAttributeIndices(ResourceBinder* rb);
 
+  // Makes id_ a vertex array shared with other AttributeArrays that have the
+  // same layout, creating it if there is none. Returns whether the attributes
+  // could be bound.
+  bool UpdateSharedArray(ResourceBinder* rb);
+  // Releases a reference to the passed shared vertex array, if it is not NULL,
+  // deleting the array if that was its last user.
+  void ReleaseSharedArray(SharedVertexArrayCache::Array* array,
+                          bool can_make_gl_calls);
+
   size_t vertex_count_;
   ResourceBinder::BufferBinding element_array_binding_;
+  // The vertex array shared with other AttributeArrays, if any.
+  SharedVertexArrayCache::Array* shared_array_;
 
   // Allow the resource binder and manager to bind the array.
   friend class ResourceBinder;
   friend class ResourceManager;
 };
 
-void Renderer::VertexArrayResource::BindSimpleAttributes() {
-  GraphicsManager* gm = GetGraphicsManager();
+void Renderer::VertexArrayResource::BindSimpleAttributes(ResourceBinder* rb) {
   const AttributeArray& aa = GetAttributeArray();
   const size_t attribute_count = aa.GetSimpleAttributeCount();
   DCHECK_EQ(attribute_count, simple_attribute_indices_.size());
@@ -4321,43 +8920,43 @@ void Renderer::VertexArrayResource::BindSimpleAttributes() {
     if (attribute_index != static_cast<GLuint>(base::kInvalidIndex)) {
       switch (a.GetType()) {
         case kFloatAttribute:
-          gm->VertexAttrib1fv(attribute_index, &a.GetValue<float>());
+          rb->SetVertexAttribValue(attribute_index, 1, &a.GetValue<float>());
           break;
         case kFloatVector2Attribute:
-          gm->VertexAttrib2fv(attribute_index,
-                              a.GetValue<math::VectorBase2f>().Data());
+          rb->SetVertexAttribValue(attribute_index, 2,
+                                   a.GetValue<math::VectorBase2f>().Data());
           break;
         case kFloatVector3Attribute:
-          gm->VertexAttrib3fv(attribute_index,
-                              a.GetValue<math::VectorBase3f>().Data());
+          rb->SetVertexAttribValue(attribute_index, 3,
+                                   a.GetValue<math::VectorBase3f>().Data());
           break;
         case kFloatVector4Attribute:
-          gm->VertexAttrib4fv(attribute_index,
-                              a.GetValue<math::VectorBase4f>().Data());
+          rb->SetVertexAttribValue(attribute_index, 4,
+                                   a.GetValue<math::VectorBase4f>().Data());
           break;
         // Each column of matrix attributes must be sent separately.
         case kFloatMatrix2x2Attribute: {
           const math::Matrix2f mat =
               math::Transpose(a.GetValue<math::Matrix2f>());
-          gm->VertexAttrib2fv(attribute_index, mat.Data());
-          gm->VertexAttrib2fv(attribute_index + 1, &mat.Data()[2]);
+          rb->SetVertexAttribValue(attribute_index, 2, mat.Data());
+          rb->SetVertexAttribValue(attribute_index + 1, 2, &mat.Data()[2]);
           break;
         }
         case kFloatMatrix3x3Attribute: {
           const math::Matrix3f mat =
               math::Transpose(a.GetValue<math::Matrix3f>());
-          gm->VertexAttrib3fv(attribute_index, mat.Data());
-          gm->VertexAttrib3fv(attribute_index + 1, &mat.Data()[3]);
-          gm->VertexAttrib3fv(attribute_index + 2, &mat.Data()[6]);
+          rb->SetVertexAttribValue(attribute_index, 3, mat.Data());
+          rb->SetVertexAttribValue(attribute_index + 1, 3, &mat.Data()[3]);
+          rb->SetVertexAttribValue(attribute_index + 2, 3, &mat.Data()[6]);
           break;
         }
         case kFloatMatrix4x4Attribute: {
           const math::Matrix4f mat =
               math::Transpose(a.GetValue<math::Matrix4f>());
-          gm->VertexAttrib4fv(attribute_index, mat.Data());
-          gm->VertexAttrib4fv(attribute_index + 1, &mat.Data()[4]);
-          gm->VertexAttrib4fv(attribute_index + 2, &mat.Data()[8]);
-          gm->VertexAttrib4fv(attribute_index + 3, &mat.Data()[12]);
+          rb->SetVertexAttribValue(attribute_index, 4, mat.Data());
+          rb->SetVertexAttribValue(attribute_index + 1, 4, &mat.Data()[4]);
+          rb->SetVertexAttribValue(attribute_index + 2, 4, &mat.Data()[8]);
+          rb->SetVertexAttribValue(attribute_index + 3, 4, &mat.Data()[12]);
           break;
         }
         default:
@@ -4369,7 +8968,7 @@ void Renderer::VertexArrayResource::BindSimpleAttributes() {
 
 bool Renderer::VertexArrayResource::BindBufferObjectElementAttribute(
     GLuint attribute_index, const Attribute& a, GLuint* slots,
-    ResourceBinder* rb) {
+    ResourceBinder* rb, SharedVertexArrayCache::Layout* layout) {
   DCHECK(a.IsValid());
   GraphicsManager* gm = GetGraphicsManager();
   DCHECK(gm);
@@ -4399,19 +8998,40 @@ bool Renderer::VertexArrayResource::BindBufferObjectElementAttribute(
   // complete matrix is stored contiguously.
   GLuint stride = 0U;
   GetAttributeSlotCountAndStride(spec.type, &stride, slots);
+  const GLboolean normalized = a.IsFixedPointNormalized() ? GL_TRUE : GL_FALSE;
+  const GLsizei struct_size = static_cast<GLsizei>(bo->GetStructSize());
   for (GLuint i = 0; i < *slots; ++i) {
-    gm->VertexAttribPointer(
-        attribute_index + i, static_cast<GLuint>(spec.component_count), type,
-        a.IsFixedPointNormalized() ? GL_TRUE : GL_FALSE,
-        static_cast<GLuint>(bo->GetStructSize()),
-        reinterpret_cast<const void*>(spec.byte_offset + i * stride));
-    if (gm->IsFunctionGroupAvailable(GraphicsManager::kInstancedDrawing)) {
-      gm->VertexAttribDivisor(attribute_index + i, a.GetDivisor());
+    const size_t offset = vbo->GetDataOffset() + spec.byte_offset + i * stride;
+    if (layout) {
+      // These must match SharedVertexArrayCache::kValuesPerSlot.
+      layout->push_back(attribute_index + i);
+      layout->push_back(vbo->GetId());
+      layout->push_back(spec.component_count);
+      layout->push_back(type);
+      layout->push_back(normalized);
+      layout->push_back(struct_size);
+      layout->push_back(offset);
+      layout->push_back(a.GetDivisor());
+    } else {
+      SetAttributePointer(attribute_index + i, vbo->GetId(),
+                          static_cast<GLint>(spec.component_count), type,
+                          normalized, struct_size,
+                          reinterpret_cast<const void*>(offset),
+                          a.GetDivisor(), rb);
     }
   }
   return true;
 }
 
+void Renderer::VertexArrayResource::SetAttributePointer(
+    GLuint index, GLuint buffer, GLint size, GLenum type, GLboolean normalized,
+    GLsizei stride, const void* pointer, GLuint divisor, ResourceBinder* rb) {
+  GraphicsManager* gm = GetGraphicsManager();
+  gm->VertexAttribPointer(index, size, type, normalized, stride, pointer);
+  if (gm->IsFunctionGroupAvailable(GraphicsManager::kInstancedDrawing))
+    gm->VertexAttribDivisor(index, divisor);
+}
+
 void Renderer::VertexArrayResource::PopulateAttributeIndices(
     ResourceBinder* rb) {
   // Retrieve the attribute indices from the currently bound shader. Since
@@ -4462,8 +9082,22 @@ void Renderer::VertexArrayResource::PopulateAttributeIndices(
 }
 
 bool Renderer::VertexArrayResource::UpdateAndCheckBuffers(ResourceBinder* rb) {
+  const bool share =
+      resource_owns_gl_id_ && GetResourceManager()->ShouldShareVertexArrays();
+  if (shared_array_ && !share) {
+    // Sharing was turned off, so this needs a vertex array of its own.
+    UnbindAll();
+    ReleaseSharedArray(shared_array_, true);
+    shared_array_ = nullptr;
+    id_ = 0U;
+    SetModifiedBits();
+  }
+  if (share && AnyModifiedBitsSet() && !UpdateSharedArray(rb))
+    return false;
+
   if (AnyModifiedBitsSet()) {
     ScopedResourceLabel label(this, rb);
+    rb->CountResourceUpdate();
     // Generate the VAO.
     GraphicsManager* gm = GetGraphicsManager();
     DCHECK(gm);
@@ -4499,8 +9133,10 @@ bool Renderer::VertexArrayResource::UpdateAndCheckBuffers(ResourceBinder* rb) {
                   AttributeArray::kAttributeEnabledChanged + i))) {
             DCHECK_GT(info.slots, 0U);
             if (aa.IsBufferAttributeEnabled(i)) {
-              for (GLuint j = 0; j < info.slots; ++j)
+              for (GLuint j = 0; j < info.slots; ++j) {
                 gm->EnableVertexAttribArray(info.index + j);
+                rb->ClearVertexAttribValues(info.index + j);
+              }
               info.enabled = true;
             } else {
               for (GLuint j = 0; j < info.slots; ++j)
@@ -4523,10 +9159,85 @@ bool Renderer::VertexArrayResource::UpdateAndCheckBuffers(ResourceBinder* rb) {
   // Simple attributes must always be bound since their state is not saved
   // in the VAO.
   rb->BindVertexArray(id_, this);
-  BindSimpleAttributes();
+  BindSimpleAttributes(rb);
+  return true;
+}
+
+bool Renderer::VertexArrayResource::UpdateSharedArray(ResourceBinder* rb) {
+  ScopedResourceLabel label(this, rb);
+  rb->CountResourceUpdate();
+  GraphicsManager* gm = GetGraphicsManager();
+  const AttributeArray& aa = GetAttributeArray();
+  const size_t buffer_attribute_count = aa.GetBufferAttributeCount();
+  DCHECK_EQ(buffer_attribute_count, buffer_attribute_infos_.size());
+
+  // Upload the buffers and determine the layout of the enabled attributes.
+  // Since vertex arrays are only shared within a context, the layout starts
+  // with the ResourceBinder.
+  SharedVertexArrayCache::Layout layout(*this);
+  layout.push_back(reinterpret_cast<uintptr_t>(rb));
+  ResetVertexCount();
+  for (size_t i = 0; i < buffer_attribute_count; ++i) {
+    const Attribute& a = aa.GetBufferAttribute(i);
+    UpdateVertexCount(a);
+    BufferAttributeInfo& info = buffer_attribute_infos_[i];
+    info.enabled = false;
+    if (info.index != kInvalidGluint && aa.IsBufferAttributeEnabled(i)) {
+      if (!BindBufferObjectElementAttribute(info.index, a, &info.slots, rb,
+                                            &layout))
+        return false;
+      info.enabled = true;
+    }
+  }
+
+  // The new array is acquired before the previous one is released so that an
+  // unchanged layout does not delete its array.
+  SharedVertexArrayCache* cache =
+      GetResourceManager()->GetSharedVertexArrayCache();
+  SharedVertexArrayCache::Array* previous = shared_array_;
+  shared_array_ = cache->Acquire(layout);
+  if (!shared_array_ || shared_array_->id != id_)
+    UnbindAll();
+  if (shared_array_) {
+    id_ = shared_array_->id;
+  } else {
+    GLuint id = 0U;
+    gm->GenVertexArrays(1, &id);
+    if (!id) {
+      LOG(ERROR) << "***ION: Unable to create vertex array";
+      shared_array_ = previous;
+      return false;
+    }
+    id_ = id;
+    rb->BindVertexArray(id_, this);
+    for (size_t i = 0; i < buffer_attribute_count; ++i) {
+      BufferAttributeInfo& info = buffer_attribute_infos_[i];
+      if (info.enabled) {
+        BindBufferObjectElementAttribute(info.index, aa.GetBufferAttribute(i),
+                                         &info.slots, rb);
+        for (GLuint j = 0; j < info.slots; ++j)
+          gm->EnableVertexAttribArray(info.index + j);
+      }
+    }
+    if (!aa.GetLabel().empty())
+      SetObjectLabel(gm, GL_VERTEX_ARRAY_OBJECT, id_, aa.GetLabel());
+    shared_array_ = cache->Add(layout, id_);
+  }
+  ReleaseSharedArray(previous, true);
+  ResetModifiedBits();
   return true;
 }
 
+void Renderer::VertexArrayResource::ReleaseSharedArray(
+    SharedVertexArrayCache::Array* array, bool can_make_gl_calls) {
+  if (array) {
+    const GLuint id =
+        GetResourceManager()->GetSharedVertexArrayCache()->Release(array);
+    if (id && can_make_gl_calls)
+      GetGraphicsManager()->DeleteVertexArrays(1, &id);
+  }
+}
+
 bool Renderer::VertexArrayResource::BindAndCheckBuffers(bool force_bind,
                                                         ResourceBinder* rb) {
   // Since UpdateAndCheckBuffers() has side-effects (it may bind the VAO and
@@ -4544,9 +9255,28 @@ void Renderer::VertexArrayResource::Unbind(ResourceBinder* rb) {
     rb->ClearVertexArrayBinding(id_);
 }
 
+void Renderer::VertexArrayResource::MarkBuffersUsed(ResourceBinder* rb) {
+  if (GetLastUsedFrame() == GetResourceManager()->GetFrame())
+    return;
+  MarkUsed();
+  const AttributeArray& aa = GetAttributeArray();
+  const size_t buffer_attribute_count = aa.GetBufferAttributeCount();
+  for (size_t i = 0; i < buffer_attribute_count; ++i) {
+    const Attribute& a = aa.GetBufferAttribute(i);
+    if (BufferObject* bo =
+            a.GetValue<BufferObjectElement>().buffer_object.Get())
+      GetResource(bo, rb)->MarkUsed();
+  }
+}
+
 void Renderer::VertexArrayResource::Release(bool can_make_gl_calls) {
   BaseResourceType::Release(can_make_gl_calls);
-  if (id_) {
+  if (shared_array_) {
+    UnbindAll();
+    ReleaseSharedArray(shared_array_, can_make_gl_calls);
+    shared_array_ = nullptr;
+    id_ = 0;
+  } else if (id_) {
     // This is a no-op, only here for coverage.
     UnbindAll();
     if (resource_owns_gl_id_ && can_make_gl_calls)
@@ -4575,10 +9305,50 @@ class Renderer::VertexArrayEmulatorResource
   // See comments in VertexArrayResource.
   bool BindAndCheckBuffers(bool force_bind, ResourceBinder* rb) override;
   void Unbind(ResourceBinder* rb) override;
+
+ protected:
+  // When vertex arrays are shared the ResourceBinder skips sending attribute
+  // state that another emulated array already set.
+  void SetAttributePointer(GLuint index, GLuint buffer, GLint size,
+                           GLenum type, GLboolean normalized, GLsizei stride,
+                           const void* pointer, GLuint divisor,
+                           ResourceBinder* rb) override;
+
+ private:
+  // Enables or disables an attribute slot.
+  void SetAttributeEnabled(GLuint index, bool enabled, ResourceBinder* rb);
 };
 
+void Renderer::VertexArrayEmulatorResource::SetAttributePointer(
+    GLuint index, GLuint buffer, GLint size, GLenum type, GLboolean normalized,
+    GLsizei stride, const void* pointer, GLuint divisor, ResourceBinder* rb) {
+  if (GetResourceManager()->ShouldShareVertexArrays()) {
+    rb->SetEmulatedVertexAttribPointer(index, buffer, size, type, normalized,
+                                       stride, pointer, divisor);
+  } else {
+    VertexArrayResource::SetAttributePointer(index, buffer, size, type,
+                                             normalized, stride, pointer,
+                                             divisor, rb);
+  }
+}
+
+void Renderer::VertexArrayEmulatorResource::SetAttributeEnabled(
+    GLuint index, bool enabled, ResourceBinder* rb) {
+  if (GetResourceManager()->ShouldShareVertexArrays()) {
+    rb->SetEmulatedVertexAttribEnabled(index, enabled);
+  } else if (enabled) {
+    GetGraphicsManager()->EnableVertexAttribArray(index);
+    rb->ClearVertexAttribValues(index);
+  } else {
+    GetGraphicsManager()->DisableVertexAttribArray(index);
+  }
+}
+
 bool Renderer::VertexArrayEmulatorResource::UpdateAndCheckBuffers(
     ResourceBinder* rb) {
+  // Simple attributes are not tracked by the modified bits, but values that
+  // have already been sent are skipped by the ResourceBinder.
+  BindSimpleAttributes(rb);
   // Only resend the vertex array state if this is not the currently bound
   // resource.
   if (rb->GetActiveVertexArray() != this || AnyModifiedBitsSet()) {
@@ -4586,10 +9356,12 @@ bool Renderer::VertexArrayEmulatorResource::UpdateAndCheckBuffers(
 
     ScopedResourceLabel label(this, rb);
     rb->SetActiveVertexArray(this);
-    BindSimpleAttributes();
     ResetVertexCount();
+    // State sent without the ResourceBinder's knowledge makes its record of
+    // the attribute slots stale.
+    if (!GetResourceManager()->ShouldShareVertexArrays())
+      rb->ClearEmulatedVertexAttribs(0U);
 
-    GraphicsManager* gm = GetGraphicsManager();
     const AttributeArray& aa = GetAttributeArray();
     // Since we don't actually have real vertex arrays, we have to bind each
     // attribute pointer every time.
@@ -4606,7 +9378,7 @@ bool Renderer::VertexArrayEmulatorResource::UpdateAndCheckBuffers(
           // Enable the attribute.
           DCHECK_GT(info.slots, 0U);
           for (GLuint j = 0; j < info.slots; ++j)
-            gm->EnableVertexAttribArray(info.index);
+            SetAttributeEnabled(info.index + j, true, rb);
           info.enabled = true;
         }
       }
@@ -4624,7 +9396,6 @@ void Renderer::VertexArrayEmulatorResource::Unbind(ResourceBinder* rb) {
   // We check the current Visual to ensure that there is a valid GL context.
   const bool can_make_gl_calls = portgfx::Visual::GetCurrent() != nullptr;
   if (rb && rb->GetActiveVertexArray() == this) {
-    GraphicsManager* gm = GetGraphicsManager();
     // Since we don't actually have real vertex arrays, we have to disable each
     // attribute pointer every time so that we don't pollute the global state.
     const size_t buffer_attribute_count = buffer_attribute_infos_.size();
@@ -4634,7 +9405,7 @@ void Renderer::VertexArrayEmulatorResource::Unbind(ResourceBinder* rb) {
           info.index != static_cast<GLuint>(base::kInvalidIndex)) {
         if (can_make_gl_calls) {
           for (GLuint j = 0; j < info.slots; ++j)
-            gm->DisableVertexAttribArray(info.index);
+            SetAttributeEnabled(info.index + j, false, rb);
         }
 
         info.enabled = false;
@@ -4657,7 +9428,10 @@ void Renderer::VertexArrayEmulatorResource::Release(bool can_make_gl_calls) {
 
 Renderer::Renderer(const GraphicsManagerPtr& gm)
     : flags_(AllProcessFlags()),
-      resource_manager_(new (GetAllocator()) ResourceManager(gm)) {
+      resource_manager_(new (GetAllocator()) ResourceManager(gm, flags_)),
+      has_culling_matrix_(false),
+      preparation_time_budget_(0U),
+      preparation_byte_budget_(0U) {
   DCHECK(gm.Get());
 
   // Create the default shader program and default global uniform settings.
@@ -4666,6 +9440,9 @@ Renderer::Renderer(const GraphicsManagerPtr& gm)
 }
 
 Renderer::~Renderer() {
+  // Stop uploading before any resources are destroyed.
+  upload_worker_.reset();
+  resource_preparer_.reset();
   size_t visual_id;
   ResourceBinder* resource_binder = GetInternalResourceBinder(&visual_id);
   if (visual_id == 0) {
@@ -4673,13 +9450,94 @@ Renderer::~Renderer() {
                  << ": No Visual ID (invalid GL Context?)";
   }
   resource_manager_->DestroyAllResources();
+  if (image_readbacks_.get()) {
+    image_readbacks_->Release(portgfx::Visual::GetCurrent() != nullptr,
+                              GetGraphicsManager().Get());
+  }
+  if (node_gpu_timer_.get()) {
+    node_gpu_timer_->Release(portgfx::Visual::GetCurrent() != nullptr,
+                             GetGraphicsManager().Get());
+  }
+  if (queries_.get()) {
+    queries_->Release(portgfx::Visual::GetCurrent() != nullptr,
+                      GetGraphicsManager().Get());
+  }
   if (resource_binder)
     resource_binder->SetCurrentFramebuffer(FramebufferObjectPtr());
 }
 
+void Renderer::StartAsyncUploads(const portgfx::Visual* upload_visual) {
+  if (!upload_visual) {
+    LOG(ERROR) << "***ION: StartAsyncUploads() requires a Visual";
+    return;
+  }
+  if (!upload_worker_.get())
+    upload_worker_.reset(new UploadWorker(this));
+  upload_worker_->Start(upload_visual);
+}
+
+void Renderer::StopAsyncUploads() {
+  if (upload_worker_.get())
+    upload_worker_->Stop();
+}
+
+template <typename T>
+void Renderer::UploadResourceAsync(T* holder) {
+  if (!holder)
+    return;
+  if (!upload_worker_.get())
+    upload_worker_.reset(new UploadWorker(this));
+  upload_worker_->Add(holder);
+}
+
+// Explicitly instantiate.
+template ION_API void Renderer::UploadResourceAsync<BufferObject>(
+    BufferObject*);
+template ION_API void Renderer::UploadResourceAsync<CubeMapTexture>(
+    CubeMapTexture*);
+template ION_API void Renderer::UploadResourceAsync<IndexBuffer>(
+    IndexBuffer*);
+template ION_API void Renderer::UploadResourceAsync<Texture>(Texture*);
+
+bool Renderer::IsUploadPending(const ResourceHolder* holder) const {
+  return upload_worker_.get() && upload_worker_->IsPending(holder);
+}
+
+void Renderer::WaitForAsyncUploads() {
+  if (upload_worker_.get() && upload_worker_->IsRunning())
+    upload_worker_->Wait();
+}
+
+void Renderer::SetDrawListThreadCount(size_t count) {
+  if (!count)
+    draw_list_worker_.reset();
+  else if (count != GetDrawListThreadCount())
+    draw_list_worker_.reset(new DrawListWorker(count));
+}
+
+size_t Renderer::GetDrawListThreadCount() const {
+  return draw_list_worker_ ? draw_list_worker_->GetThreadCount() : 0U;
+}
+
 const Renderer::Flags& Renderer::AllFlags() {
   static const Flags flags(AllClearFlags() | AllProcessFlags() |
-                           AllRestoreFlags() | AllSaveFlags());
+                           AllRestoreFlags() | AllSaveFlags() |
+                           Flags()
+                               .set(kSortDrawsByState)
+                               .set(kRetainDrawList)
+                               .set(kStreamTexturesThroughPixelBuffers)
+                               .set(kPersistentlyMapStreamBuffers)
+                               .set(kCompileShadersAsynchronously)
+                               .set(kShareVertexArrays)
+                               .set(kProfileLabeledNodeGpuTime)
+                               .set(kBatchResourceUpdates)
+                               .set(kUseImmutableTextureStorage)
+                               .set(kStreamMipmapsLowestResolutionFirst)
+                               .set(kSortDrawsByRenderPass)
+                               .set(kDepthPrepass)
+                               .set(kShareSamplers)
+                               .set(kProfileLabeledNodeCpuTime)
+                               .set(kOrderIndependentTransparency));
   return flags;
 }
 
@@ -4745,8 +9603,8 @@ void Renderer::DestroyStateCache(const portgfx::Visual* visual) {
   if (visual) {
     const size_t id = visual->GetId();
     ResourceBinderMap& binders = GetResourceBinderMap();
-    base::WriteLock write_lock(GetResourceBinderLock());
-    base::WriteGuard write_guard(&write_lock);
+    base::BigReaderWriteLock write_lock(GetResourceBinderLock());
+    base::BigReaderWriteGuard write_guard(&write_lock);
     binders.erase(id);
   }
 }
@@ -4754,15 +9612,15 @@ void Renderer::DestroyStateCache(const portgfx::Visual* visual) {
 void Renderer::DestroyCurrentStateCache() {
   const size_t id = portgfx::Visual::GetCurrentId();
   ResourceBinderMap& binders = GetResourceBinderMap();
-  base::WriteLock write_lock(GetResourceBinderLock());
-  base::WriteGuard write_guard(&write_lock);
+  base::BigReaderWriteLock write_lock(GetResourceBinderLock());
+  base::BigReaderWriteGuard write_guard(&write_lock);
   binders.erase(id);
 }
 
 Renderer::ResourceBinder* Renderer::GetInternalResourceBinder(
     size_t* visual_id) const {
-  base::ReadLock read_lock(GetResourceBinderLock());
-  base::ReadGuard read_guard(&read_lock);
+  base::BigReaderReadLock read_lock(GetResourceBinderLock());
+  base::BigReaderReadGuard read_guard(&read_lock);
   *visual_id = portgfx::Visual::GetCurrentId();
   ResourceBinderMap& binders = GetResourceBinderMap();
   ResourceBinderMap::iterator it = binders.find(*visual_id);
@@ -4789,8 +9647,8 @@ Renderer::GetOrCreateInternalResourceBinder(int line) const {
   if (!rb) {
     ResourceBinderMap& binders = GetResourceBinderMap();
     rb = new(GetAllocator()) ResourceBinder(GetGraphicsManager());
-    base::WriteLock write_lock(GetResourceBinderLock());
-    base::WriteGuard write_guard(&write_lock);
+    base::BigReaderWriteLock write_lock(GetResourceBinderLock());
+    base::BigReaderWriteGuard write_guard(&write_lock);
     DCHECK(binders.find(visual_id) == binders.end())
         << "Two threads tried to create ResourceBinders for the same Visual!";
     binders[visual_id].reset(rb);
@@ -4815,6 +9673,83 @@ void Renderer::BindFramebuffer(const FramebufferObjectPtr& fbo) {
       fbr->Bind(resource_binder);
     }
     resource_binder->SetCurrentFramebuffer(fbo);
+    // The old contents of a newly acquired transient framebuffer are not
+    // needed, so tiled GPUs need not load them.
+    if (fbo.Get() && transient_framebuffers_.get() &&
+        transient_framebuffers_->MarkBound(fbo.Get())) {
+      InvalidateFramebuffer(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                            GL_STENCIL_BUFFER_BIT);
+    }
+  }
+}
+
+void Renderer::BeginTransformFeedback(const TransformFeedbackPtr& feedback) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (!resource_binder || !feedback.Get())
+    return;
+  GraphicsManager* gm = resource_binder->GetGraphicsManager().Get();
+  if (!gm->IsFunctionGroupAvailable(GraphicsManager::kTransformFeedback)) {
+    LOG(ERROR) << "***ION: Unable to begin transform feedback: It is not"
+               << " supported on this platform";
+    return;
+  }
+  // Any capture in progress ends here.
+  resource_binder->EndTransformFeedbackCapture(gm);
+  resource_binder->SetTransformFeedback(feedback);
+}
+
+void Renderer::EndTransformFeedback() {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder && resource_binder->GetTransformFeedback().Get()) {
+    resource_binder->EndTransformFeedbackCapture(
+        resource_binder->GetGraphicsManager().Get());
+    resource_binder->SetTransformFeedback(TransformFeedbackPtr());
+  }
+}
+
+void Renderer::DispatchCompute(const NodePtr& node, uint32 num_groups_x,
+                               uint32 num_groups_y, uint32 num_groups_z) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder && node.Get() &&
+      IsComputeShaderSupported(resource_binder->GetGraphicsManager().Get(),
+                               "dispatch compute shader")) {
+    resource_binder->DispatchCompute(*node, NULL, 0U, num_groups_x,
+                                     num_groups_y, num_groups_z);
+  }
+}
+
+void Renderer::DispatchComputeIndirect(const NodePtr& node,
+                                       const BufferObjectPtr& buffer,
+                                       size_t offset) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder && node.Get() && buffer.Get() &&
+      IsComputeShaderSupported(resource_binder->GetGraphicsManager().Get(),
+                               "dispatch compute shader")) {
+    resource_binder->DispatchCompute(*node, buffer.Get(), offset, 0U, 0U, 0U);
+  }
+}
+
+void Renderer::BindShaderStorageBuffer(uint32 index,
+                                       const BufferObjectPtr& buffer) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder &&
+      IsComputeShaderSupported(resource_binder->GetGraphicsManager().Get(),
+                               "bind shader storage buffer"))
+    resource_binder->BindShaderStorageBuffer(index, buffer);
+}
+
+void Renderer::BindImageTexture(uint32 unit, const TexturePtr& texture,
+                                int level, BufferObjectDataMapMode access) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder &&
+      IsComputeShaderSupported(resource_binder->GetGraphicsManager().Get(),
+                               "bind image texture")) {
+    GLenum gl_access = GL_READ_WRITE;
+    if (access == kReadOnly)
+      gl_access = GL_READ_ONLY;
+    else if (access == kWriteOnly)
+      gl_access = GL_WRITE_ONLY;
+    resource_binder->BindImageTexture(unit, texture, level, gl_access);
   }
 }
 
@@ -4926,9 +9861,287 @@ ION_API void Renderer::CreateResourceWithExternallyManagedId<CubeMapTexture>(
     resource_binder->Process<ResourceBinder::CreateOrUpdateOp>(holder, gl_id);
 }
 
+//-----------------------------------------------------------------------------
+//
+// The Renderer::ResourcePreparer holds the scenes queued by
+// Renderer::PrepareResources(). Each scene is flattened when it is queued into
+// the list of holders whose resources it needs, in the order a traversal would
+// create them, so that preparing it can stop and resume between any two.
+//
+//-----------------------------------------------------------------------------
+
+class Renderer::ResourcePreparer : public Allocatable {
+ public:
+  ResourcePreparer() : scenes_(*this) {}
+
+  // Queues the scene rooted by node, whose Nodes use default_shader if they
+  // set no ShaderProgram. If visible is not NULL, the items of the Nodes it
+  // accepts come first, followed by those of the subgraphs it rejects.
+  void Add(const NodePtr& node, int priority,
+           const ResourcesPreparedCallback& callback,
+           ShaderProgram* default_shader,
+           const NodeVisibilityFunction* visible) {
+    Scene scene;
+    scene.node = node;
+    scene.priority = priority;
+    scene.callback = callback;
+    std::set<const void*> added;
+    std::vector<HiddenNode> hidden;
+    AddNode(*node, default_shader, visible, &hidden, &added, &scene.items);
+    for (size_t i = 0; i < hidden.size(); ++i) {
+      AddNode(*hidden[i].first, hidden[i].second, NULL, NULL, &added,
+              &scene.items);
+    }
+    // Keep scenes sorted by decreasing priority, and in the order they were
+    // queued within each priority.
+    base::AllocVector<Scene>::iterator it = scenes_.begin();
+    while (it != scenes_.end() && it->priority >= priority)
+      ++it;
+    scenes_.insert(it, scene);
+  }
+
+  // Removes the scene rooted by node, if it is queued.
+  void Remove(const Node* node) {
+    for (base::AllocVector<Scene>::iterator it = scenes_.begin();
+         it != scenes_.end(); ++it) {
+      if (it->node.Get() == node) {
+        scenes_.erase(it);
+        return;
+      }
+    }
+  }
+
+  // Returns the number of queued scenes.
+  size_t GetCount() const { return scenes_.size(); }
+
+  // Makes every queued scene create all of its resources again, after they
+  // have been abandoned.
+  void Rewind() {
+    for (size_t i = 0; i < scenes_.size(); ++i)
+      scenes_[i].next = 0U;
+  }
+
+  // Creates the resources of queued scenes with resource_binder until a budget
+  // is used up, calling the callbacks of the scenes that become prepared. The
+  // bytes uploaded are measured as the growth of the GPU memory used by
+  // resource_manager.
+  void Process(uint64 time_budget, size_t byte_budget,
+               ResourceBinder* resource_binder,
+               ResourceManager* resource_manager) {
+    const port::Timer timer;
+    const size_t start_usage = GetUploadedBytes(resource_manager);
+    std::vector<Scene> prepared;
+    while (!scenes_.empty()) {
+      Scene& scene = scenes_.front();
+      if (scene.next < scene.items.size()) {
+        CreateItem(scene.items[scene.next++], resource_binder);
+      }
+      if (scene.next == scene.items.size()) {
+        prepared.push_back(scene);
+        scenes_.erase(scenes_.begin());
+      }
+      if ((time_budget &&
+           std::chrono::duration_cast<std::chrono::microseconds>(timer.Get())
+                   .count() >= static_cast<int64>(time_budget)) ||
+          (byte_budget &&
+           GetUploadedBytes(resource_manager) - start_usage >= byte_budget))
+        break;
+    }
+    // Callbacks run last, so they may queue more scenes.
+    for (size_t i = 0; i < prepared.size(); ++i) {
+      if (prepared[i].callback)
+        prepared[i].callback(prepared[i].node);
+    }
+  }
+
+ private:
+  // A holder whose resources a scene needs. Only one of the holders is set,
+  // except that a Shape also has the ShaderProgram it is drawn with.
+  struct Item {
+    ShaderProgramPtr program;
+    TexturePtr texture;
+    CubeMapTexturePtr cube_map;
+    ShapePtr shape;
+  };
+
+  struct Scene {
+    Scene() : priority(0), next(0U) {}
+    NodePtr node;
+    int priority;
+    ResourcesPreparedCallback callback;
+    std::vector<Item> items;
+    // The index of the next item to create.
+    size_t next;
+  };
+
+  // A Node rejected by a visibility function, and the ShaderProgram that its
+  // Shapes are drawn with if it sets none.
+  typedef std::pair<const Node*, ShaderProgram*> HiddenNode;
+
+  // Adds the items of the enabled Nodes rooted by node to items, following
+  // the same order as ResourceBinder::Visit(), skipping holders that have
+  // already been added. If visible is not NULL, the Nodes that it rejects are
+  // added to hidden instead, without visiting their subgraphs.
+  static void AddNode(const Node& node, ShaderProgram* program,
+                      const NodeVisibilityFunction* visible,
+                      std::vector<HiddenNode>* hidden,
+                      std::set<const void*>* added, std::vector<Item>* items) {
+    if (!node.IsEnabled())
+      return;
+    if (visible && !(*visible)(node)) {
+      hidden->push_back(HiddenNode(&node, program));
+      return;
+    }
+    if (ShaderProgram* shader = node.GetShaderProgram().Get()) {
+      program = shader;
+      if (added->insert(shader).second) {
+        items->push_back(Item());
+        items->back().program = shader;
+      }
+    }
+    AddUniforms(node.GetUniforms(), added, items);
+    const Node::UniformBlockVector& blocks = node.GetUniformBlocks();
+    for (size_t i = 0; i < blocks.size(); ++i) {
+      if (blocks[i]->IsEnabled())
+        AddUniforms(blocks[i]->GetUniforms(), added, items);
+    }
+    const Node::ShapeVector& shapes = node.GetShapes();
+    for (size_t i = 0; i < shapes.size(); ++i) {
+      items->push_back(Item());
+      items->back().program = program;
+      items->back().shape = shapes[i];
+    }
+    const Node::NodeVector& children = node.GetChildren();
+    for (size_t i = 0; i < children.size(); ++i)
+      AddNode(*children[i], program, visible, hidden, added, items);
+  }
+
+  // Adds the textures in uniforms to items.
+  static void AddUniforms(const base::AllocVector<Uniform>& uniforms,
+                          std::set<const void*>* added,
+                          std::vector<Item>* items) {
+    for (size_t i = 0; i < uniforms.size(); ++i) {
+      if (uniforms[i].GetType() == kTextureUniform) {
+        const TexturePtr& texture = uniforms[i].GetValue<TexturePtr>();
+        if (texture.Get() && added->insert(texture.Get()).second) {
+          items->push_back(Item());
+          items->back().texture = texture;
+        }
+      } else if (uniforms[i].GetType() == kCubeMapTextureUniform) {
+        const CubeMapTexturePtr& cube_map =
+            uniforms[i].GetValue<CubeMapTexturePtr>();
+        if (cube_map.Get() && added->insert(cube_map.Get()).second) {
+          items->push_back(Item());
+          items->back().cube_map = cube_map;
+        }
+      }
+    }
+  }
+
+  // Creates or updates the resources of item.
+  static void CreateItem(const Item& item, ResourceBinder* resource_binder) {
+    if (item.shape.Get()) {
+      resource_binder->CreateOrUpdateShapeResources(*item.shape,
+                                                    item.program.Get());
+    } else if (item.texture.Get()) {
+      resource_binder->Process<ResourceBinder::CreateOrUpdateOp>(
+          item.texture.Get(), 0U);
+    } else if (item.cube_map.Get()) {
+      resource_binder->Process<ResourceBinder::CreateOrUpdateOp>(
+          item.cube_map.Get(), 0U);
+    } else {
+      resource_binder->Process<ResourceBinder::CreateOrUpdateOp>(
+          item.program.Get(), 0U);
+    }
+  }
+
+  // Returns the GPU memory used by buffers and textures.
+  static size_t GetUploadedBytes(ResourceManager* resource_manager) {
+    return resource_manager->GetGpuMemoryUsage(kBufferObject) +
+           resource_manager->GetGpuMemoryUsage(kTexture);
+  }
+
+  base::AllocVector<Scene> scenes_;
+};
+
+void Renderer::PrepareResources(const NodePtr& node, int priority,
+                                const ResourcesPreparedCallback& callback) {
+  if (!node.Get())
+    return;
+  if (!resource_preparer_.get())
+    resource_preparer_.reset(new (GetAllocator()) ResourcePreparer);
+  resource_preparer_->Add(node, priority, callback, default_shader_.Get(),
+                          NULL);
+}
+
+void Renderer::RestoreResources(const NodePtr& node, int priority,
+                                const ResourcesPreparedCallback& callback) {
+  if (!node.Get())
+    return;
+  if (!resource_preparer_.get())
+    resource_preparer_.reset(new (GetAllocator()) ResourcePreparer);
+  // Nodes are visible if DrawScene() would draw them.
+  if (has_culling_matrix_) {
+    const NodeVisibilityFunction culler(FrustumCuller(
+        culling_matrix_, visibility_function_ ? &visibility_function_ : NULL));
+    resource_preparer_->Add(node, priority, callback, default_shader_.Get(),
+                            &culler);
+  } else {
+    resource_preparer_->Add(
+        node, priority, callback, default_shader_.Get(),
+        visibility_function_ ? &visibility_function_ : NULL);
+  }
+}
+
+void Renderer::CancelResourcePreparation(const NodePtr& node) {
+  if (resource_preparer_.get())
+    resource_preparer_->Remove(node.Get());
+}
+
+void Renderer::ProcessResourcePreparation() {
+  if (!resource_preparer_.get() || !resource_preparer_->GetCount())
+    return;
+  base::SamplingAllocationTracker::ScopedTag tag("gfx");
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder)
+    ProcessResourcePreparation(resource_binder);
+}
+
+void Renderer::ProcessResourcePreparation(ResourceBinder* resource_binder) {
+  if (resource_preparer_.get() && resource_preparer_->GetCount()) {
+    resource_preparer_->Process(preparation_time_budget_,
+                                preparation_byte_budget_, resource_binder,
+                                resource_manager_.get());
+  }
+}
+
+size_t Renderer::GetPendingResourcePreparationCount() const {
+  return resource_preparer_.get() ? resource_preparer_->GetCount() : 0U;
+}
+
+void Renderer::SetResourcePreparationBudget(uint64 microseconds,
+                                            size_t bytes) {
+  preparation_time_budget_ = microseconds;
+  preparation_byte_budget_ = bytes;
+}
+
+uint64 Renderer::GetResourcePreparationTimeBudget() const {
+  return preparation_time_budget_;
+}
+
+size_t Renderer::GetResourcePreparationByteBudget() const {
+  return preparation_byte_budget_;
+}
+
 void Renderer::CreateOrUpdateResources(const NodePtr& node) {
-  if (!node.Get() || !node->IsEnabled())
+  if (node.Get())
+    CreateOrUpdateResources(*node);
+}
+
+void Renderer::CreateOrUpdateResources(const Node& node) {
+  if (!node.IsEnabled())
     return;
+  base::SamplingAllocationTracker::ScopedTag tag("gfx");
 
   ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
   if (resource_binder)
@@ -4937,7 +10150,7 @@ void Renderer::CreateOrUpdateResources(const NodePtr& node) {
 }
 
 template <typename Operation>
-void Renderer::ResourceBinder::Traverse(const NodePtr& node,
+void Renderer::ResourceBinder::Traverse(const Node& node,
                                         ShaderProgram* default_shader) {
   // We need to keep track of the active shader program in this method,
   // since the GetResourceKey method of vertex array resources depends
@@ -4953,12 +10166,12 @@ void Renderer::ResourceBinder::Traverse(const NodePtr& node,
 }
 
 template <typename Operation>
-void Renderer::ResourceBinder::Visit(const NodePtr& node) {
-  if (!node.Get() || !node->IsEnabled())
+void Renderer::ResourceBinder::Visit(const Node& node) {
+  if (!node.IsEnabled())
     return;
 
   // Get the Node's shader, if any, and update it.
-  if (ShaderProgram* shader = node->GetShaderProgram().Get()) {
+  if (ShaderProgram* shader = node.GetShaderProgram().Get()) {
     Process<Operation>(shader, 0U);
     current_shader_program_ = shader;
   }
@@ -4967,7 +10180,7 @@ void Renderer::ResourceBinder::Visit(const NodePtr& node) {
       current_shader_program_, this);
 
   // Upload any textures in the node.
-  const base::AllocVector<Uniform>& uniforms = node->GetUniforms();
+  const base::AllocVector<Uniform>& uniforms = node.GetUniforms();
   const size_t num_uniforms = uniforms.size();
   for (size_t i = 0; i < num_uniforms; ++i) {
     Process<Operation>(&uniforms[i].GetRegistry(), 0U);
@@ -4978,8 +10191,8 @@ void Renderer::ResourceBinder::Visit(const NodePtr& node) {
   }
 
   // Textures might be in Uniforms in a UniformBlock.
-  const base::AllocVector<UniformBlockPtr>& uniform_blocks =
-      node->GetUniformBlocks();
+  const Node::UniformBlockVector& uniform_blocks =
+      node.GetUniformBlocks();
   const size_t num_uniform_blocks = uniform_blocks.size();
   for (size_t i = 0; i < num_uniform_blocks; ++i) {
     if (uniform_blocks[i]->IsEnabled()) {
@@ -4998,35 +10211,48 @@ void Renderer::ResourceBinder::Visit(const NodePtr& node) {
   }
 
   // Draw shapes.
-  const base::AllocVector<ShapePtr>& shapes = node->GetShapes();
+  const Node::ShapeVector& shapes = node.GetShapes();
   const size_t num_shapes = shapes.size();
   for (size_t i = 0; i < num_shapes; ++i)
-    VisitShape<Operation>(shapes[i]);
+    VisitShape<Operation>(*shapes[i]);
 
   ShaderProgram* saved_program = current_shader_program_;
 
   // Process any children.
-  const base::AllocVector<NodePtr>& children = node->GetChildren();
+  const Node::NodeVector& children = node.GetChildren();
   const size_t num_children = children.size();
   for (size_t i = 0; i < num_children; ++i) {
-    Visit<Operation>(children[i]);
+    Visit<Operation>(*children[i]);
     current_shader_program_ = saved_program;
   }
 }
 
 template <typename Operation>
-void Renderer::ResourceBinder::VisitShape(const ShapePtr& shape) {
-  Process<Operation>(shape->GetIndexBuffer().Get(), 0U);
-  Process<Operation>(shape->GetAttributeArray().Get(), 0U);
+void Renderer::ResourceBinder::VisitShape(const Shape& shape) {
+  Process<Operation>(shape.GetIndexBuffer().Get(), 0U);
+  Process<Operation>(shape.GetAttributeArray().Get(), 0U);
+}
+
+void Renderer::ResourceBinder::CreateOrUpdateShapeResources(
+    const Shape& shape, ShaderProgram* program) {
+  ShaderProgram* saved_current_program = current_shader_program_;
+  ShaderProgramResource* saved_active_resource = active_shader_resource_;
+  current_shader_program_ = program;
+  active_shader_resource_ = resource_manager_->GetResource(program, this);
+  VisitShape<CreateOrUpdateOp>(shape);
+  current_shader_program_ = saved_current_program;
+  active_shader_resource_ = saved_active_resource;
 }
 
 void Renderer::CreateOrUpdateShapeResources(const ShapePtr& shape) {
-  if (shape.Get()) {
-    ResourceBinder* resource_binder =
-        GetOrCreateInternalResourceBinder(__LINE__);
-    if (resource_binder)
-      resource_binder->VisitShape<ResourceBinder::CreateOrUpdateOp>(shape);
-  }
+  if (shape.Get())
+    CreateOrUpdateShapeResources(*shape);
+}
+
+void Renderer::CreateOrUpdateShapeResources(const Shape& shape) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder)
+    resource_binder->VisitShape<ResourceBinder::CreateOrUpdateOp>(shape);
 }
 
 template <typename T>
@@ -5057,7 +10283,12 @@ template ION_API void Renderer::RequestForcedUpdate<Texture>(
     Texture*);  // NOLINT
 
 void Renderer::RequestForcedUpdates(const NodePtr& node) {
-  if (!node.Get() || !node->IsEnabled())
+  if (node.Get())
+    RequestForcedUpdates(*node);
+}
+
+void Renderer::RequestForcedUpdates(const Node& node) {
+  if (!node.IsEnabled())
     return;
 
   ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
@@ -5067,13 +10298,14 @@ void Renderer::RequestForcedUpdates(const NodePtr& node) {
 }
 
 void Renderer::RequestForcedShapeUpdates(const ShapePtr& shape) {
-  if (shape.Get()) {
-    ResourceBinder* resource_binder =
-        GetOrCreateInternalResourceBinder(__LINE__);
-    if (resource_binder) {
-      resource_binder->VisitShape<ResourceBinder::RequestUpdateOp>(shape);
-    }
-  }
+  if (shape.Get())
+    RequestForcedShapeUpdates(*shape);
+}
+
+void Renderer::RequestForcedShapeUpdates(const Shape& shape) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder)
+    resource_binder->VisitShape<ResourceBinder::RequestUpdateOp>(shape);
 }
 
 void Renderer::ResourceBinder::ProcessStateTable(
@@ -5143,13 +10375,116 @@ void Renderer::ResolveMultisampleFramebuffer(
 }
 
 void Renderer::DrawScene(const NodePtr& node) {
+  base::SamplingAllocationTracker::ScopedTag tag("gfx");
   ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
   if (resource_binder) {
-    resource_binder->DrawScene(node, flags_, default_shader_.Get());
-    // Process any info requests.
-    if (flags_.test(kProcessInfoRequests))
-      resource_manager_->ProcessResourceInfoRequests(resource_binder);
+    // Measure labeled Nodes if requested and the scene is drawn in tree order.
+    NodeGpuTimer* node_gpu_timer = NULL;
+    if (flags_.test(kProfileLabeledNodeGpuTime) && node.Get() &&
+        !flags_.test(kSortDrawsByState) && !flags_.test(kRetainDrawList) &&
+        !flags_.test(kSortDrawsByRenderPass)) {
+      GraphicsManager* gm = GetGraphicsManager().Get();
+      if (!node_gpu_timer_.get() && NodeGpuTimer::IsSupported(gm))
+        node_gpu_timer_.reset(new (GetAllocator()) NodeGpuTimer(gm));
+      if (node_gpu_timer_.get() &&
+          node_gpu_timer_->BeginFrame(&node_gpu_times_,
+                                      node_gpu_times_callback_, gm))
+        node_gpu_timer = node_gpu_timer_.get();
+    }
+    NodeCpuTimer* node_cpu_timer = NULL;
+    if (flags_.test(kProfileLabeledNodeCpuTime) && node.Get() &&
+        !flags_.test(kSortDrawsByState) && !flags_.test(kRetainDrawList) &&
+        !flags_.test(kSortDrawsByRenderPass)) {
+      if (!node_cpu_timer_.get())
+        node_cpu_timer_.reset(new (GetAllocator()) NodeCpuTimer);
+      node_cpu_timer = node_cpu_timer_.get();
+      node_cpu_timer->BeginFrame();
+    }
+    resource_binder->SetNodeCpuTimer(node_cpu_timer);
+    DrawSceneWithBinder(node, flags_, node_gpu_timer, resource_binder);
+    resource_binder->SetNodeCpuTimer(NULL);
+    if (node_gpu_timer)
+      node_gpu_timer->EndFrame();
+    if (node_cpu_timer)
+      node_cpu_timer->EndFrame(&node_cpu_times_, node_cpu_times_callback_);
+    EndSceneFrame(resource_binder);
+  }
+}
+
+void Renderer::DrawSceneInVisuals(
+    const NodePtr& node, const std::vector<const portgfx::Visual*>& visuals,
+    const ViewFunction& before_view) {
+  base::SamplingAllocationTracker::ScopedTag tag("gfx");
+  const portgfx::Visual* previous_visual = portgfx::Visual::GetCurrent();
+  // Every view is drawn from the DrawList built for the first one.
+  Flags flags = flags_;
+  flags.set(kRetainDrawList);
+  ResourceBinder* first_binder = NULL;
+  ResourceBinder* resource_binder = NULL;
+  const size_t count = visuals.size();
+  for (size_t i = 0; i < count; ++i) {
+    if (!visuals[i] || !portgfx::Visual::MakeCurrent(visuals[i])) {
+      LOG(WARNING) << "***ION: Unable to make the Visual for view " << i
+                   << " current, skipping it";
+      continue;
+    }
+    ResourceBinder* binder = GetOrCreateInternalResourceBinder(__LINE__);
+    if (!binder)
+      continue;
+    resource_binder = binder;
+    if (before_view)
+      before_view(i);
+    resource_binder->ShareDrawListFrom(first_binder);
+    DrawSceneWithBinder(node, flags, NULL, resource_binder);
+    resource_binder->ShareDrawListFrom(NULL);
+    if (!first_binder)
+      first_binder = resource_binder;
   }
+  if (resource_binder)
+    EndSceneFrame(resource_binder);
+  if (previous_visual)
+    portgfx::Visual::MakeCurrent(previous_visual);
+}
+
+void Renderer::DrawSceneWithBinder(const NodePtr& node, const Flags& flags,
+                                   NodeGpuTimer* node_gpu_timer,
+                                   ResourceBinder* resource_binder) {
+  if (has_culling_matrix_ && node.Get()) {
+    // Compute the subgraph bounds on this thread, since the culler may be
+    // called from several threads.
+    math::Range3f bounds;
+    node->GetSubgraphBounds(&bounds);
+    const NodeVisibilityFunction culler(FrustumCuller(
+        culling_matrix_, visibility_function_ ? &visibility_function_ : NULL));
+    resource_binder->DrawScene(node, flags, default_shader_.Get(), culler,
+                               &culling_matrix_, draw_list_worker_.get(),
+                               upload_worker_.get(), node_gpu_timer,
+                               GetQueryQueue());
+  } else {
+    resource_binder->DrawScene(node, flags, default_shader_.Get(),
+                               visibility_function_, NULL,
+                               draw_list_worker_.get(), upload_worker_.get(),
+                               node_gpu_timer, GetQueryQueue());
+  }
+}
+
+void Renderer::EndSceneFrame(ResourceBinder* resource_binder) {
+  // Fence the frame if it used any persistently mapped storage.
+  resource_manager_->GetFrameFenceQueue()->EndFrame(
+      GetGraphicsManager().Get());
+  // Evict resources if they exceed the GPU memory budget.
+  resource_manager_->EndFrame(resource_binder);
+  // Deliver any images that have been read asynchronously, and any query
+  // results.
+  ProcessImageReadbacks(false);
+  ProcessQueries(false);
+  // Create queued resources that fit in the preparation budgets.
+  ProcessResourcePreparation(resource_binder);
+  // Process any info requests that fit in the budget.
+  if (flags_.test(kProcessInfoRequests))
+    resource_manager_->ProcessResourceInfoRequests(resource_binder, true);
+  GetGraphicsManager()->CheckForDeferredErrors(
+      GraphicsManager::kCheckErrorsPerFrame, std::string());
 }
 
 void Renderer::ResourceBinder::MarkAttachmentImplicitlyChanged(
@@ -5163,12 +10498,19 @@ void Renderer::ResourceBinder::MarkAttachmentImplicitlyChanged(
   }
 }
 
-void Renderer::ResourceBinder::DrawScene(const NodePtr& node,
-                                         const Flags& flags,
-                                         ShaderProgram* default_shader) {
+void Renderer::ResourceBinder::DrawScene(
+    const NodePtr& node, const Flags& flags, ShaderProgram* default_shader,
+    const NodeVisibilityFunction& visibility_function,
+    const math::Matrix4f* clip_from_scene, DrawListWorker* draw_list_worker,
+    const UploadWorker* upload_worker, NodeGpuTimer* node_gpu_timer,
+    QueryQueue* query_queue) {
   GraphicsManager* gm = GetGraphicsManager().Get();
   DCHECK(gm);
 
+  // Remembering the prior state makes no OpenGL calls.
+  if (flags.test(kRestoreChangedState))
+    GetHostState(&prior_state_);
+
   if ((flags & AllSaveFlags()).any()) {
     // Possibly save existing state.
     if (flags.test(kSaveActiveTexture))
@@ -5204,17 +10546,43 @@ void Renderer::ResourceBinder::DrawScene(const NodePtr& node,
   // Make sure the active framebuffer is up to date.
   if (FramebufferResource* fbr = GetActiveFramebuffer()) fbr->Bind(this);
 
+  // Make what earlier dispatches wrote visible to the draws.
+  IssuePendingBarriers(gm);
+
   // Release any resources waiting to be released or destroyed.
   if (flags.test(kProcessReleases)) resource_manager_->ReleaseAll(this);
 
+  // Update changed textures and samplers before drawing, unless some may be
+  // uploaded asynchronously, in which case they are updated when drawn.
+  if (flags.test(kBatchResourceUpdates) &&
+      !(upload_worker && upload_worker->HasPendingUploads()))
+    resource_manager_->UpdateDirtyResources(this);
+
   // If there are no shaders before the next draw call then we will bind a
   // default one.
   current_shader_program_ = default_shader;
 
   // Draw.
   current_traversal_index_ = 0;
+  visibility_function_ = visibility_function ? &visibility_function : NULL;
+  clip_from_scene_ = clip_from_scene;
+  draw_list_worker_ = draw_list_worker;
+  upload_worker_ = upload_worker && upload_worker->HasPendingUploads()
+                       ? upload_worker
+                       : NULL;
+  node_gpu_timer_ = node_gpu_timer;
+  query_queue_ = query_queue;
+  last_draw_list_ = NULL;
   if (node.Get()) {
-    DrawNode(*node, gm);
+    if (flags.test(kSortDrawsByState) || flags.test(kRetainDrawList) ||
+        flags.test(kSortDrawsByRenderPass)) {
+      last_draw_list_ = shared_draw_list_
+                            ? shared_draw_list_
+                            : GetDrawList(node, flags, default_shader);
+      DrawDrawList(*last_draw_list_, gm);
+    } else {
+      DrawNode(*node, gm);
+    }
     // If we have a framebuffer bound, then after the frame is drawn any
     // textures bound to the framebuffer's attachment need to be notified that
     // their contents have changed (and maybe update mipmaps).
@@ -5224,6 +10592,12 @@ void Renderer::ResourceBinder::DrawScene(const NodePtr& node,
       MarkAttachmentImplicitlyChanged(fbo->GetStencilAttachment());
     }
   }
+  visibility_function_ = NULL;
+  clip_from_scene_ = NULL;
+  draw_list_worker_ = NULL;
+  upload_worker_ = NULL;
+  node_gpu_timer_ = NULL;
+  query_queue_ = NULL;
 
   // Possibly restore state.
   if ((flags & (AllRestoreFlags() | AllClearFlags())).any()) {
@@ -5306,12 +10680,87 @@ void Renderer::ResourceBinder::DrawScene(const NodePtr& node,
     else if (flags.test(kClearActiveTexture))
       ActivateUnit(0U);
   }
+
+  if (flags.test(kRestoreChangedState))
+    RestoreHostState(prior_state_, gm);
+}
+
+void Renderer::ResourceBinder::SetHostState(const Renderer::HostState& state) {
+  if (state.state_table.Get())
+    gl_state_table_->CopyFrom(*state.state_table);
+  // The resources of bindings that change are unknown; they may not even be
+  // Ion's.
+  const GLuint unit = state.active_texture - GL_TEXTURE0;
+  active_image_unit_ = unit < image_units_.size() ? unit : kInvalidGluint;
+  const BufferObject::Target targets[] = {BufferObject::kArrayBuffer,
+                                          BufferObject::kElementBuffer};
+  const GLuint buffers[] = {state.array_buffer, state.element_array_buffer};
+  for (int i = 0; i < 2; ++i) {
+    if (active_buffers_[targets[i]].buffer != buffers[i]) {
+      active_buffers_[targets[i]].buffer = buffers[i];
+      active_buffers_[targets[i]].resource = NULL;
+    }
+  }
+  if (active_framebuffer_ != state.framebuffer) {
+    active_framebuffer_ = state.framebuffer;
+    active_framebuffer_resource_ = NULL;
+  }
+  if (active_shader_id_ != state.shader_program) {
+    active_shader_id_ = state.shader_program;
+    active_shader_resource_ = NULL;
+  }
+  if (active_vertex_array_ != state.vertex_array) {
+    active_vertex_array_ = state.vertex_array;
+    active_vertex_array_resource_ = NULL;
+  }
+  if (state.textures_changed) {
+    const GLuint count = static_cast<GLuint>(GetImageUnitCount());
+    for (GLuint i = 0U; i < count; ++i) {
+      ClearTextureBinding(0U, i);
+      image_units_[i].sampler = 0;
+    }
+  }
+}
+
+void Renderer::ResourceBinder::GetHostState(Renderer::HostState* state) const {
+  DCHECK(state->state_table.Get());
+  state->state_table->CopyFrom(*gl_state_table_);
+  // Every item must be restored if it changes.
+  state->state_table->MarkAllSet();
+  state->active_texture = GL_TEXTURE0 + active_image_unit_;
+  state->array_buffer = active_buffers_[BufferObject::kArrayBuffer].buffer;
+  state->element_array_buffer =
+      active_buffers_[BufferObject::kElementBuffer].buffer;
+  state->framebuffer = active_framebuffer_;
+  state->shader_program = active_shader_id_;
+  state->vertex_array = active_vertex_array_;
+  state->textures_changed = false;
+}
+
+void Renderer::ResourceBinder::RestoreHostState(
+    const Renderer::HostState& state, GraphicsManager* gm) {
+  // The Bind*() functions do nothing if the binding does not change.
+  BindBuffer(BufferObject::kArrayBuffer, state.array_buffer, NULL);
+  if (state.framebuffer != kInvalidGluint)
+    BindFramebuffer(state.framebuffer, NULL);
+  BindProgram(state.shader_program, NULL);
+  if (gm->IsFunctionGroupAvailable(GraphicsManager::kVertexArrays))
+    BindVertexArray(state.vertex_array, NULL);
+  // The element array buffer binding is part of the vertex array state.
+  BindBuffer(BufferObject::kElementBuffer, state.element_array_buffer, NULL);
+  UpdateFromStateTable(*state.state_table, gl_state_table_.Get(), gm);
+  gl_state_table_->MergeNonClearValuesFrom(*state.state_table,
+                                           *state.state_table);
+  // The active unit is unknown if it is out of range.
+  const GLuint unit = state.active_texture - GL_TEXTURE0;
+  if (unit < image_units_.size())
+    ActivateUnit(unit);
 }
 
 void Renderer::ProcessResourceInfoRequests() {
   ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
   if (resource_binder)
-    resource_manager_->ProcessResourceInfoRequests(resource_binder);
+    resource_manager_->ProcessResourceInfoRequests(resource_binder, false);
 }
 
 void Renderer::UpdateStateFromOpenGL(int window_width, int window_height) {
@@ -5321,6 +10770,12 @@ void Renderer::UpdateStateFromOpenGL(int window_width, int window_height) {
                      resource_binder->GetStateTable());
 }
 
+void Renderer::SetHostState(const HostState& state) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (resource_binder)
+    resource_binder->SetHostState(state);
+}
+
 void Renderer::UpdateStateFromStateTable(const StateTablePtr& state_table) {
   ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
   if (resource_binder)
@@ -5368,18 +10823,26 @@ void Renderer::MapBufferObjectDataRange(const BufferObjectPtr& buffer,
         ResourceBinder* resource_binder =
             GetOrCreateInternalResourceBinder(__LINE__);
         if (resource_binder) {
-          BufferResource* br =
-              resource_manager_->GetResource(bo, resource_binder);
-          br->Bind(resource_binder);
-          GLenum access_mode;
-          if (mode == kReadOnly)
-            access_mode = GL_MAP_READ_BIT;
-          else if (mode == kWriteOnly)
-            access_mode = GL_MAP_WRITE_BIT;
-          else
-            access_mode = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
-          data = gm->MapBufferRange(br->GetGlTarget(), range.GetMinPoint(),
-                                    range.GetSize(), access_mode);
+          BufferResource* br =
+              resource_manager_->GetResource(bo, resource_binder);
+          resource_binder->IssuePendingBarriers(gm);
+          br->Bind(resource_binder);
+          if (br->IsPersistentlyMapped()) {
+            // The buffer is already mapped, so map client memory instead and
+            // send it to the buffer when it is unmapped.
+            gpu_mapped = false;
+            data = bo->GetAllocator()->AllocateMemory(range.GetSize());
+          } else {
+            GLenum access_mode;
+            if (mode == kReadOnly)
+              access_mode = GL_MAP_READ_BIT;
+            else if (mode == kWriteOnly)
+              access_mode = GL_MAP_WRITE_BIT;
+            else
+              access_mode = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
+            data = gm->MapBufferRange(br->GetGlTarget(), range.GetMinPoint(),
+                                      range.GetSize(), access_mode);
+          }
         }
       } else if (gm->IsFunctionGroupAvailable(GraphicsManager::kMapBuffer) &&
                  range == entire_range) {
@@ -5388,6 +10851,7 @@ void Renderer::MapBufferObjectDataRange(const BufferObjectPtr& buffer,
         if (resource_binder) {
           BufferResource* br =
             resource_manager_->GetResource(bo, resource_binder);
+          resource_binder->IssuePendingBarriers(gm);
           br->Bind(resource_binder);
           GLenum access_mode;
           if (mode == kReadOnly)
@@ -5424,6 +10888,9 @@ void Renderer::UnmapBufferObjectData(const BufferObjectPtr& buffer) {
         BufferResource* br =
             resource_manager_->GetResource(bo, resource_binder);
         br->Bind(resource_binder);
+        // The mapped data may have been written to, so the buffer can no
+        // longer be recreated from the BufferObject's data.
+        br->MarkContentsModified();
         if (bo->GetMappedData().gpu_mapped &&
             GetGraphicsManager()->IsFunctionGroupAvailable(
                 GraphicsManager::kMapBufferBase)) {
@@ -5452,6 +10919,102 @@ const ImagePtr Renderer::ReadImage(const math::Range2i& range,
       resource_binder->ReadImage(range, format, allocator) : ImagePtr();
 }
 
+const Renderer::ImageReadbackPtr Renderer::ReadImageAsync(
+    const math::Range2i& range, Image::Format format,
+    const base::AllocatorPtr& allocator) {
+  ImageReadbackPtr readback(new (GetAllocator()) ImageReadback);
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  if (ImageReadbackQueue::IsSupported(gm)) {
+    if (!image_readbacks_.get())
+      image_readbacks_.reset(new (GetAllocator()) ImageReadbackQueue());
+    if (image_readbacks_->Start(readback, range, format, allocator, gm))
+      return readback;
+  }
+  // Fall back to a synchronous read.
+  readback->SetImage(ReadImage(range, format, allocator));
+  return readback;
+}
+
+void Renderer::ProcessImageReadbacks(bool wait) {
+  if (image_readbacks_.get())
+    image_readbacks_->Process(wait, GetGraphicsManager().Get());
+}
+
+bool Renderer::IsQuerySupported(Query::Type type) const {
+  return QueryQueue::IsSupported(type, GetGraphicsManager().Get());
+}
+
+void Renderer::BeginQuery(const QueryPtr& query) {
+  if (!query.Get()) {
+    LOG(ERROR) << "***ION: Renderer::BeginQuery() called with a NULL Query";
+    return;
+  }
+  QueryQueue* queue = GetQueryQueue();
+  const Query::Type type = query->GetType();
+  if (!IsQuerySupported(type)) {
+    LOG(ERROR) << "***ION: Query \"" << query->GetLabel()
+               << "\" has a type that is not supported on this platform";
+  } else if (query->IsPending()) {
+    LOG(ERROR) << "***ION: Query \"" << query->GetLabel()
+               << "\" is already pending";
+  } else if (queue->GetActive(type).Get()) {
+    LOG(ERROR) << "***ION: Unable to begin Query \"" << query->GetLabel()
+               << "\" while another Query of the same type is active";
+  } else {
+    queue->Begin(query, GetGraphicsManager().Get());
+  }
+}
+
+void Renderer::EndQuery(const QueryPtr& query) {
+  if (!query.Get() || !queries_.get() ||
+      queries_->GetActive(query->GetType()).Get() != query.Get()) {
+    LOG(ERROR) << "***ION: Renderer::EndQuery() called with a Query that is"
+               << " not active";
+    return;
+  }
+  queries_->End(query->GetType(), GetGraphicsManager().Get());
+}
+
+bool Renderer::BeginConditionalRender(const QueryPtr& query, bool wait) {
+  if (!query.Get() || query->GetType() == Query::kPrimitivesGenerated ||
+      query->GetType() == Query::kTimeElapsed) {
+    LOG(ERROR) << "***ION: Conditional rendering requires a Query that counts"
+               << " samples";
+    return true;
+  }
+  QueryQueue* queue = GetQueryQueue();
+  if (queue->IsConditionalRenderActive()) {
+    LOG(ERROR) << "***ION: Unable to begin conditional rendering on Query \""
+               << query->GetLabel() << "\" while it is already active";
+    return true;
+  }
+  // A delivered result decides without OpenGL's help.
+  if (!query->IsPending())
+    return !query->HasResult() || query->GetResult() != 0U;
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  if (gm->IsFunctionGroupAvailable(GraphicsManager::kConditionalRender))
+    queue->BeginConditionalRender(query, wait, gm);
+  return true;
+}
+
+void Renderer::EndConditionalRender() {
+  if (queries_.get() && queries_->IsConditionalRenderActive())
+    queries_->EndConditionalRender(GetGraphicsManager().Get());
+}
+
+void Renderer::ProcessQueries(bool wait) {
+  if (queries_.get())
+    queries_->Process(wait, GetGraphicsManager().Get());
+}
+
+Renderer::QueryQueue* Renderer::GetQueryQueue() {
+  if (!queries_.get()) {
+    queries_.reset(new (GetAllocator())
+                       QueryQueue(GetGraphicsManager().Get()));
+  }
+  return queries_.get();
+}
+
 #if ION_PRODUCTION
 void Renderer::PushDebugMarker(const std::string& label) {}
 void Renderer::PopDebugMarker() {}
@@ -5534,6 +11097,29 @@ void Renderer::ClearAllResources() {
   ReleaseResources();
 }
 
+void Renderer::AbandonAllResources() {
+  // The upload thread's context shares objects with the lost one.
+  StopAsyncUploads();
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  size_t visual_id;
+  ResourceBinder* resource_binder = GetInternalResourceBinder(&visual_id);
+  resource_manager_->AbandonAllResources(resource_binder);
+  if (image_readbacks_.get())
+    image_readbacks_->Release(false, gm);
+  if (node_gpu_timer_.get())
+    node_gpu_timer_->Release(false, gm);
+  if (queries_.get())
+    queries_->Release(false, gm);
+  // A new context starts with nothing bound and the default state.
+  if (resource_binder) {
+    resource_binder->ClearNonFramebufferCachedBindings();
+    resource_binder->ClearFramebufferBinding(0U);
+    resource_binder->GetStateTable()->Reset();
+  }
+  if (resource_preparer_.get())
+    resource_preparer_->Rewind();
+}
+
 void Renderer::ClearTypedResources(ResourceType type) {
   resource_manager_->ReleaseTypedResources(type);
   ReleaseResources();
@@ -5549,6 +11135,153 @@ size_t Renderer::GetGpuMemoryUsage(ResourceType type) const {
   return resource_manager_->GetGpuMemoryUsage(type);
 }
 
+void Renderer::SetGpuMemoryBudget(size_t budget) {
+  resource_manager_->SetGpuMemoryBudget(budget);
+}
+
+size_t Renderer::GetGpuMemoryBudget() const {
+  return resource_manager_->GetGpuMemoryBudget();
+}
+
+void Renderer::SetObjectNameBatchSize(size_t count) {
+  resource_manager_->GetObjectNameCache()->SetBatchSize(count);
+}
+
+size_t Renderer::GetObjectNameBatchSize() const {
+  return resource_manager_->GetObjectNameCache()->GetBatchSize();
+}
+
+void Renderer::SetDeferredObjectDeletion(bool defer,
+                                         size_t deletions_per_frame) {
+  resource_manager_->GetObjectNameCache()->SetDeferredDeletion(
+      defer, deletions_per_frame);
+}
+
+bool Renderer::IsObjectDeletionDeferred() const {
+  return resource_manager_->GetObjectNameCache()->IsDeletionDeferred();
+}
+
+size_t Renderer::GetPendingObjectDeletionCount() const {
+  return resource_manager_->GetObjectNameCache()->GetPendingDeletionCount();
+}
+
+void Renderer::SetInfoRequestBudget(uint64 microseconds) {
+  resource_manager_->SetInfoRequestBudget(microseconds);
+}
+
+uint64 Renderer::GetInfoRequestBudget() const {
+  return resource_manager_->GetInfoRequestBudget();
+}
+
+size_t Renderer::GetPendingInfoRequestCount() const {
+  return resource_manager_->GetPendingInfoRequestCount();
+}
+
+size_t Renderer::GetSentUniformCount() const {
+  return resource_manager_->GetSentUniformCount();
+}
+
+size_t Renderer::GetSkippedUniformCount() const {
+  return resource_manager_->GetSkippedUniformCount();
+}
+
+void Renderer::ResetUniformCounts() {
+  resource_manager_->ResetUniformCounts();
+}
+
+void Renderer::SetProgramBinaryCache(const ProgramBinaryCachePtr& cache) {
+  resource_manager_->SetProgramBinaryCache(cache);
+}
+
+const ProgramBinaryCachePtr Renderer::GetProgramBinaryCache() const {
+  return resource_manager_->GetProgramBinaryCache();
+}
+
+size_t Renderer::WarmUpPipelines(const NodePtr& node) {
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (!node.Get() || !resource_binder)
+    return 0U;
+
+  FramebufferObjectPtr fbo(new (GetAllocator()) FramebufferObject(1U, 1U));
+  fbo->SetLabel("Pipeline warm-up");
+  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba8));
+  fbo->SetDepthAttachment(
+      FramebufferObject::Attachment(Image::kRenderbufferDepth16));
+  const FramebufferObjectPtr previous_fbo = GetCurrentFramebuffer();
+  BindFramebuffer(fbo);
+
+  // Every Shape is visited, since culling depends on the current view.
+  const std::set<uint64> keys = resource_manager_->GetPipelineKeys();
+  ResourceBinder::PipelineWarmUp warm_up(keys.empty() ? NULL : &keys);
+  resource_binder->SetPipelineWarmUp(&warm_up);
+  Flags flags = flags_;
+  flags.reset(kSortDrawsByState);
+  flags.reset(kRetainDrawList);
+  flags.reset(kSortDrawsByRenderPass);
+  resource_binder->DrawScene(node, flags, default_shader_.Get(),
+                             NodeVisibilityFunction(), NULL, NULL, NULL, NULL,
+                             NULL);
+  resource_binder->SetPipelineWarmUp(NULL);
+
+  BindFramebuffer(previous_fbo);
+  return warm_up.draw_count;
+}
+
+void Renderer::StoreRecordedPipelines() {
+  resource_manager_->StorePipelineKeys();
+}
+
+const FramebufferObjectPtr Renderer::AcquireTransientFramebuffer(
+    uint32 width, uint32 height, Image::Format color_format,
+    Image::Format depth_format, size_t samples) {
+  if (!transient_framebuffers_.get()) {
+    transient_framebuffers_.reset(
+        new (GetAllocator()) TransientFramebufferPool());
+  }
+  return transient_framebuffers_->Acquire(width, height, color_format,
+                                          depth_format, samples);
+}
+
+void Renderer::RecycleTransientFramebuffers() {
+  if (transient_framebuffers_.get())
+    transient_framebuffers_->Recycle();
+}
+
+size_t Renderer::GetTransientFramebufferCount() const {
+  return transient_framebuffers_.get() ? transient_framebuffers_->GetCount()
+                                       : 0U;
+}
+
+void Renderer::InvalidateFramebuffer(GLbitfield mask) {
+  const GraphicsManagerPtr& gm = GetGraphicsManager();
+  if (!gm->IsFunctionGroupAvailable(GraphicsManager::kInvalidateFramebuffer))
+    return;
+  ResourceBinder* resource_binder = GetOrCreateInternalResourceBinder(__LINE__);
+  if (!resource_binder)
+    return;
+
+  // The window-system framebuffer names its buffers rather than attachments.
+  const FramebufferObjectPtr fbo = resource_binder->GetCurrentFramebuffer();
+  const bool is_default_framebuffer =
+      (!fbo.Get() || fbo->GetWidth() == 0 || fbo->GetHeight() == 0) &&
+      *resource_binder->GetSavedId(kSaveFramebuffer) == 0;
+  static const GLbitfield kBufferBits[] = {
+      GL_COLOR_BUFFER_BIT, GL_DEPTH_BUFFER_BIT, GL_STENCIL_BUFFER_BIT};
+  static const GLenum kDefaultBuffers[] = {GL_COLOR, GL_DEPTH, GL_STENCIL};
+  static const GLenum kAttachments[] = {
+      GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT, GL_STENCIL_ATTACHMENT};
+  const GLenum* names =
+      is_default_framebuffer ? kDefaultBuffers : kAttachments;
+  GLenum attachments[3];
+  GLsizei count = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (mask & kBufferBits[i])
+      attachments[count++] = names[i];
+  }
+  if (count)
+    gm->InvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments);
+}
+
 const ShaderProgramPtr Renderer::CreateDefaultShaderProgram(
     const base::AllocatorPtr& allocator) {
   static const char* kDefaultVertexShaderString =
@@ -5592,89 +11325,1161 @@ void Renderer::SetResourceHolderBit(const ResourceHolder* holder, int bit) {
   holder->OnChanged(bit);
 }
 
-void Renderer::ResourceBinder::DrawNode(const Node& node, GraphicsManager* gm) {
-  if (!node.IsEnabled())
+bool Renderer::ResourceBinder::IsNodeDrawable(
+    const Node& node, const NodeVisibilityFunction* visibility_function,
+    const math::Matrix4f* clip_from_scene, const UploadWorker* upload_worker) {
+  if (!node.IsEnabled() || !IsLodSelected(node, clip_from_scene) ||
+      (visibility_function && !(*visibility_function)(node)))
+    return false;
+  if (upload_worker) {
+    if (HasPendingTextures(node.GetUniforms(), *upload_worker))
+      return false;
+    const Node::UniformBlockVector& uniform_blocks =
+        node.GetUniformBlocks();
+    const size_t num_uniform_blocks = uniform_blocks.size();
+    for (size_t i = 0; i < num_uniform_blocks; ++i) {
+      if (uniform_blocks[i]->IsEnabled() &&
+          HasPendingTextures(uniform_blocks[i]->GetUniforms(), *upload_worker))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool Renderer::ResourceBinder::HasPendingTextures(
+    const base::AllocVector<Uniform>& uniforms,
+    const UploadWorker& upload_worker) {
+  const size_t num_uniforms = uniforms.size();
+  for (size_t i = 0; i < num_uniforms; ++i) {
+    const Uniform& u = uniforms[i];
+    if (!u.IsValid())
+      continue;
+    if (u.GetType() == kTextureUniform) {
+      if (const size_t count = u.GetCount()) {
+        for (size_t j = 0; j < count; ++j)
+          if (upload_worker.IsPending(u.GetValueAt<TexturePtr>(j).Get()))
+            return true;
+      } else if (upload_worker.IsPending(u.GetValue<TexturePtr>().Get())) {
+        return true;
+      }
+    } else if (u.GetType() == kCubeMapTextureUniform) {
+      if (const size_t count = u.GetCount()) {
+        for (size_t j = 0; j < count; ++j)
+          if (upload_worker.IsPending(
+                  u.GetValueAt<CubeMapTexturePtr>(j).Get()))
+            return true;
+      } else if (upload_worker.IsPending(
+                     u.GetValue<CubeMapTexturePtr>().Get())) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool Renderer::ResourceBinder::HasPendingBuffers(const Shape& shape) const {
+  DCHECK(upload_worker_);
+  if (upload_worker_->IsPending(shape.GetIndexBuffer().Get()))
+    return true;
+  const AttributeArray& attribute_array = *shape.GetAttributeArray();
+  const size_t num_buffer_attributes =
+      attribute_array.GetBufferAttributeCount();
+  for (size_t i = 0; i < num_buffer_attributes; ++i) {
+    if (upload_worker_->IsPending(attribute_array.GetBufferAttribute(i)
+                                      .GetValue<BufferObjectElement>()
+                                      .buffer_object.Get()))
+      return true;
+  }
+  return false;
+}
+
+void Renderer::ResourceBinder::DrawNode(const Node& node, GraphicsManager* gm) {
+  if (!IsNodeDrawable(node, visibility_function_, clip_from_scene_,
+                      upload_worker_))
+    return;
+
+  ScopedLabel label(this, &node, node.GetLabel());
+
+  // Measure the Node with its occlusion query, unless the previous result is
+  // pending or another Node is being measured, and draw its proxy instead if
+  // the latest result found it hidden.
+  const Query* occlusion_query = node.GetOcclusionQuery().Get();
+  bool is_occlusion_measured = false;
+  if (occlusion_query && query_queue_) {
+    const Query::Type type = occlusion_query->GetType();
+    if (!occlusion_query->IsPending() && query_queue_->IsSupported(type) &&
+        !query_queue_->GetActive(type).Get())
+      is_occlusion_measured = query_queue_->Begin(node.GetOcclusionQuery(), gm);
+    const Node* proxy = node.GetOcclusionProxy().Get();
+    if (proxy && occlusion_query->HasResult() &&
+        !occlusion_query->GetResult()) {
+      DrawNode(*proxy, gm);
+      if (is_occlusion_measured)
+        query_queue_->End(type, gm);
+      return;
+    }
+  }
+
+  // Measure the GPU time of the Node's subtree if it is labeled.
+  const bool is_timed = node_gpu_timer_ && !node.GetLabel().empty();
+  if (is_timed)
+    node_gpu_timer_->EnterNode(node.GetLabel(), gm);
+  // Measure its CPU time and the work done for it as well.
+  const bool is_cpu_timed = node_cpu_timer_ && !node.GetLabel().empty();
+  if (is_cpu_timed)
+    node_cpu_timer_->EnterNode(node.GetLabel());
+
+  if (const StateTable* st = node.GetStateTable().Get()) {
+    // Store the current client state; it will be restored after drawing and
+    // processing any children.
+    traversal_state_tables_[current_traversal_index_]->CopyFrom(
+        *client_state_table_.Get());
+    // Point child nodes at the next entry in the StateTable shadow vector.
+    if (++current_traversal_index_ >= traversal_state_tables_.size())
+      traversal_state_tables_.push_back(StateTablePtr(new StateTable));
+
+    // Merge the node's state table into the client state.
+    client_state_table_->MergeValuesFrom(*st, *st);
+    ClearFromStateTable(*st, gl_state_table_.Get(), gm);
+    if (st->AreSettingsEnforced()) {
+      UpdateFromStateTable(*st, gl_state_table_.Get(), gm);
+      // Update our copy of OpenGL's state.
+      gl_state_table_->MergeNonClearValuesFrom(*st, *st);
+      if (node_cpu_timer_)
+        node_cpu_timer_->CountStateChange();
+    }
+  }
+
+  // Get the Node's shader, if any.
+  if (ShaderProgram* shader = node.GetShaderProgram().Get())
+    current_shader_program_ = shader;
+  DCHECK(current_shader_program_);
+
+  // Process all Uniforms.
+  PushNodeUniforms(node);
+
+  // See if there are any shapes to draw.
+  const Node::ShapeVector& shapes = node.GetShapes();
+  if (const size_t num_shapes = shapes.size()) {
+    // Send global state changes relative to current GL state to OpenGL. This
+    // is unnecessary if the same client state was the last one sent and the
+    // OpenGL state has not changed since, which is common since many Nodes
+    // typically share a few distinct StateTables. AreSetItemsSame() rejects
+    // most mismatches by their cached hashes, but unlike a hash comparison it
+    // never mistakes a collision for a match.
+    const bool is_state_synced =
+        is_state_sync_valid_ && !client_state_table_->AreSettingsEnforced() &&
+        StateTable::AreSetItemsSame(*client_state_table_,
+                                    *synced_client_state_table_) &&
+        StateTable::AreSetItemsSame(*gl_state_table_, *synced_gl_state_table_);
+    if (!is_state_synced) {
+      UpdateFromStateTable(*client_state_table_, gl_state_table_.Get(), gm);
+      // Update our copy of OpenGL's state.
+      gl_state_table_->MergeNonClearValuesFrom(*client_state_table_,
+                                               *client_state_table_);
+      synced_client_state_table_->CopyFrom(*client_state_table_);
+      synced_gl_state_table_->CopyFrom(*gl_state_table_);
+      is_state_sync_valid_ = true;
+      if (node_cpu_timer_)
+        node_cpu_timer_->CountStateChange();
+    }
+
+    // Bind the shader program to use. Note that it may already be bound in
+    // OpenGL, but we still need to update the resource.
+    ShaderProgramResource* spr =
+        resource_manager_->GetResource(current_shader_program_, this);
+    spr->Bind(this);
+
+    // Draw shapes, unless the program is still being linked.
+    if (spr->IsDrawable()) {
+      for (size_t i = 0; i < num_shapes; ++i)
+        DrawShape(*shapes[i], gm);
+      FlushMultiDraw(gm);
+    }
+    gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerNode,
+                               node.GetLabel());
+  }
+
+  // Store the current shader since it needs to be restored after drawing
+  // children.
+  ShaderProgram* saved_shader_program = current_shader_program_;
+
+  // Recurse on children.
+  const Node::NodeVector& children = node.GetChildren();
+  const size_t num_children = children.size();
+  for (size_t i = 0; i < num_children; ++i) {
+    DrawNode(*children[i], gm);
+    // Restore the previous shader as the next one to use.
+    current_shader_program_ = saved_shader_program;
+  }
+
+  if (is_cpu_timed)
+    node_cpu_timer_->LeaveNode();
+  if (is_timed)
+    node_gpu_timer_->LeaveNode(gm);
+  if (is_occlusion_measured)
+    query_queue_->End(occlusion_query->GetType(), gm);
+
+  // Reverse the changes made by the local StateTable.
+  if (const StateTable* st = node.GetStateTable().Get()) {
+    --current_traversal_index_;
+    client_state_table_->MergeNonClearValuesFrom(
+        *traversal_state_tables_[current_traversal_index_].Get(), *st);
+  }
+
+  // Restore uniform values.
+  PopNodeUniforms(node);
+}
+
+Renderer::ResourceBinder::DrawList* Renderer::ResourceBinder::GetDrawList(
+    const NodePtr& root, const Flags& flags, ShaderProgram* default_shader) {
+  if (!flags.test(kRetainDrawList)) {
+    BuildDrawList(*root, default_shader, flags, draw_list_.Get());
+    return draw_list_.Get();
+  }
+
+  DrawListPtr& list = retained_draw_lists_[root.Get()];
+  if (!list.Get()) {
+    // Drop any lists whose roots have been destroyed.
+    for (auto it = retained_draw_lists_.begin();
+         it != retained_draw_lists_.end();) {
+      if (it->second.Get() && !it->second->root.Acquire().Get())
+        it = retained_draw_lists_.erase(it);
+      else
+        ++it;
+    }
+    list = new (GetAllocator()) DrawList;
+  }
+  if (!IsDrawListCurrent(*list, root.Get(), default_shader, flags)) {
+    BuildDrawList(*root, default_shader, flags, list.Get());
+    root->AddReceiver(list.Get());
+    // A list culled by a visibility function, levels of detail, or pending
+    // uploads is only good for this frame.
+    if (!visibility_function_ && !clip_from_scene_ && !upload_worker_)
+      list->SetValid();
+  }
+  return list.Get();
+}
+
+bool Renderer::ResourceBinder::IsDrawListCurrent(
+    const DrawList& list, const Node* root, ShaderProgram* default_shader,
+    const Flags& flags) const {
+  // Visibility usually changes from frame to frame, so lists are never reused
+  // when there is a visibility function. Lists are also rebuilt while uploads
+  // are pending, since they may reference the resources being uploaded.
+  if (visibility_function_ || clip_from_scene_ || upload_worker_ ||
+      !list.IsValid() ||
+      list.root.Acquire().Get() != root ||
+      list.default_shader != default_shader ||
+      list.is_sorted != flags.test(kSortDrawsByState) ||
+      list.is_sorted_by_render_pass != flags.test(kSortDrawsByRenderPass) ||
+      list.has_depth_prepass != (flags.test(kSortDrawsByRenderPass) &&
+                                 flags.test(kDepthPrepass)) ||
+      list.has_transparency_passes != UsesTransparencyPasses(flags))
+    return false;
+  return AreStateNodesCurrent(list);
+}
+
+bool Renderer::ResourceBinder::AreStateNodesCurrent(const DrawList& list) {
+  // Changing StateTable values does not invalidate the list, but a StateTable
+  // that starts or stops being a barrier changes how the list is built.
+  const size_t num_state_nodes = list.state_nodes.size();
+  for (size_t i = 0; i < num_state_nodes; ++i) {
+    const DrawList::StateNode& state_node = list.state_nodes[i];
+    const StateTable* st = state_node.node->GetStateTable().Get();
+    if (!st || IsBarrierStateTable(*st) != state_node.is_barrier)
+      return false;
+  }
+  return true;
+}
+
+void Renderer::ResourceBinder::BuildDrawList(const Node& root,
+                                             ShaderProgram* default_shader,
+                                             const Flags& flags,
+                                             DrawList* list) {
+  const bool sort = flags.test(kSortDrawsByState);
+  const bool by_render_pass = flags.test(kSortDrawsByRenderPass);
+  list->Clear();
+  list->root = base::WeakReferentPtr<Node>(const_cast<Node*>(&root));
+  list->default_shader = default_shader;
+  list->is_sorted = sort;
+  list->is_sorted_by_render_pass = by_render_pass;
+  list->has_depth_prepass = by_render_pass && flags.test(kDepthPrepass);
+  list->has_transparency_passes = UsesTransparencyPasses(flags);
+  // A list culled by a visibility function, levels of detail, or pending
+  // uploads is only good for this frame, so its subgraphs are not retained.
+  const bool retain_subgraphs = flags.test(kRetainDrawList) &&
+                                !visibility_function_ && !clip_from_scene_ &&
+                                !upload_worker_;
+
+  // Collect the root on this thread. If there is a worker, its children are
+  // only recorded as subgraphs, which are then collected in parallel. The
+  // children of the root of a retained list are always subgraphs, so that
+  // only the ones that changed need to be collected again.
+  DrawListBuilder& builder = draw_list_builder_;
+  builder.state_changed = true;
+  builder.shader_program = default_shader;
+  builder.visibility_function = visibility_function_;
+  builder.clip_from_scene = clip_from_scene_;
+  builder.upload_worker = upload_worker_;
+  draw_list_subgraphs_.clear();
+  builder.subgraphs =
+      retain_subgraphs ||
+              (draw_list_worker_ && root.GetChildren().size() > 1U)
+          ? &draw_list_subgraphs_
+          : NULL;
+  CollectNode(root, 0U, 0U, false, Node::kInheritedPass, &builder, list);
+  builder.subgraphs = NULL;
+  DCHECK(builder.traversal_path.empty());
+
+  if (const size_t num_subgraphs = draw_list_subgraphs_.size()) {
+    base::AllocVector<DrawListPtr>* parts = &draw_list_parts_;
+    if (retain_subgraphs) {
+      RetainSubgraphLists(list);
+      parts = &list->subgraph_lists;
+    } else {
+      while (draw_list_parts_.size() < num_subgraphs)
+        draw_list_parts_.push_back(DrawListPtr(new (GetAllocator()) DrawList));
+    }
+    const CollectSubgraphTask task(this, parts->data());
+    if (draw_list_worker_) {
+      draw_list_worker_->Run(num_subgraphs, task);
+    } else {
+      for (size_t i = 0; i < num_subgraphs; ++i)
+        task(i);
+    }
+    // Append the subgraphs in tree order.
+    for (size_t i = 0; i < num_subgraphs; ++i) {
+      DrawList* part = (*parts)[i].Get();
+      AppendDrawList(*part, list);
+      if (!retain_subgraphs) {
+        part->Clear();
+      } else if (!part->IsValid()) {
+        // The root of the subgraph invalidates the list when its structure
+        // changes.
+        const_cast<Node*>(draw_list_subgraphs_[i].node)->AddReceiver(part);
+        part->SetValid();
+      }
+    }
+    draw_list_subgraphs_.clear();
+  }
+  if (!retain_subgraphs)
+    list->subgraph_lists.clear();
+
+  if (!sort && !by_render_pass)
+    return;
+
+  // Sort the draws between each pair of barriers.
+  const size_t num_barriers = list->barriers.size();
+  size_t start = 0U;
+  for (size_t i = 0; i <= num_barriers; ++i) {
+    const size_t end =
+        i < num_barriers ? list->barriers[i].draw_index : list->draws.size();
+    if (end > start + 1U)
+      SortDraws(sort, by_render_pass, start, end, list);
+    start = end;
+  }
+  if (sort)
+    list->FinishSort();
+  if (list->has_depth_prepass)
+    AddDepthPrepass(list);
+  if (list->has_transparency_passes)
+    AddTransparencyPasses(list);
+}
+
+void Renderer::ResourceBinder::SortDraws(bool sort, bool by_render_pass,
+                                         size_t start, size_t end,
+                                         DrawList* list) const {
+  typedef base::AllocVector<DrawList::Draw>::iterator DrawIterator;
+  const DrawIterator begin = list->draws.begin() + start;
+  const DrawIterator range_end = list->draws.begin() + end;
+  if (!by_render_pass) {
+    // Move the draws that must stay in tree order to the end.
+    const DrawIterator sortable_end =
+        std::stable_partition(begin, range_end, DrawList::Draw::IsReorderable);
+    list->SortByState(start, start + (sortable_end - begin));
+    return;
+  }
+
+  std::stable_sort(begin, range_end, DrawList::RenderPassLess());
+  for (DrawIterator pass_begin = begin; pass_begin != range_end;) {
+    const Node::RenderPass pass = pass_begin->render_pass;
+    DrawIterator pass_end = pass_begin;
+    while (pass_end != range_end && pass_end->render_pass == pass)
+      ++pass_end;
+    if (sort) {
+      const DrawIterator sortable_end = std::stable_partition(
+          pass_begin, pass_end, DrawList::Draw::IsReorderable);
+      list->SortByState(pass_begin - list->draws.begin(),
+                        sortable_end - list->draws.begin());
+    }
+    // Sort by depth last, so that draws at equal depths stay sorted by state.
+    // Order-independent transparency needs no sorting.
+    if (clip_from_scene_ &&
+        (pass == Node::kOpaquePass ||
+         (pass == Node::kTransparentPass && !list->has_transparency_passes))) {
+      for (DrawIterator it = pass_begin; it != pass_end; ++it)
+        it->depth = GetNodeDepth(
+            *list->path_nodes[it->path.start + it->path.length - 1U],
+            *clip_from_scene_);
+      if (pass == Node::kOpaquePass)
+        std::stable_sort(pass_begin, pass_end, DrawList::DepthLess());
+      else
+        std::stable_sort(pass_begin, pass_end, DrawList::DepthGreater());
+    }
+    pass_begin = pass_end;
+  }
+}
+
+void Renderer::ResourceBinder::DrawList::SortByState(size_t start,
+                                                     size_t end) {
+  const size_t count = end - start;
+  const Draw* range = &draws[start];
+  const DrawIndexLess less(range);
+
+  // Find the position of each draw in the last sorted order. Draws that were
+  // not in it are sorted from scratch.
+  seeded_draws.clear();
+  changed_draws.clear();
+  size_t min_rank = base::kInvalidIndex;
+  size_t max_rank = 0U;
+  for (size_t i = 0; i < count; ++i) {
+    const auto it = previous_ranks.find(GetDrawId(range[i]));
+    if (it == previous_ranks.end()) {
+      changed_draws.push_back(i);
+    } else {
+      seeded_draws.push_back(std::make_pair(it->second, i));
+      min_rank = std::min(min_rank, it->second);
+      max_rank = std::max(max_rank, it->second);
+    }
+  }
+
+  // Put the other draws in their last order. They usually have a compact
+  // range of positions, so they can be bucketed instead of sorted. If several
+  // draws have the same position, all but the first are sorted from scratch.
+  previous_order.clear();
+  const size_t num_seeded = seeded_draws.size();
+  if (num_seeded && max_rank - min_rank < 2U * count) {
+    rank_slots.assign(max_rank - min_rank + 1U, base::kInvalidIndex);
+    for (size_t i = 0; i < num_seeded; ++i) {
+      size_t& slot = rank_slots[seeded_draws[i].first - min_rank];
+      if (slot == base::kInvalidIndex)
+        slot = seeded_draws[i].second;
+      else
+        changed_draws.push_back(seeded_draws[i].second);
+    }
+    const size_t num_slots = rank_slots.size();
+    for (size_t i = 0; i < num_slots; ++i) {
+      if (rank_slots[i] != base::kInvalidIndex)
+        previous_order.push_back(rank_slots[i]);
+    }
+  } else {
+    std::sort(seeded_draws.begin(), seeded_draws.end());
+    for (size_t i = 0; i < num_seeded; ++i) {
+      if (i && seeded_draws[i].first == seeded_draws[i - 1U].first)
+        changed_draws.push_back(seeded_draws[i].second);
+      else
+        previous_order.push_back(seeded_draws[i].second);
+    }
+  }
+
+  // Keep the draws that are still in order. A draw that is ordered after its
+  // successor is also moved, since its key probably changed, and keeping it
+  // would force all the draws after it to be moved instead.
+  kept_draws.clear();
+  const size_t num_previous = previous_order.size();
+  for (size_t i = 0; i < num_previous; ++i) {
+    const size_t index = previous_order[i];
+    if ((!kept_draws.empty() && less(index, kept_draws.back())) ||
+        (i + 1U < num_previous && less(previous_order[i + 1U], index)))
+      changed_draws.push_back(index);
+    else
+      kept_draws.push_back(index);
+  }
+
+  // Sort the moved draws and merge them with the kept ones. Since no two
+  // indices are equal, the result does not depend on the seed order.
+  std::sort(changed_draws.begin(), changed_draws.end(), less);
+  merged_draws.resize(count);
+  std::merge(kept_draws.begin(), kept_draws.end(), changed_draws.begin(),
+             changed_draws.end(), merged_draws.begin(), less);
+
+  // Reorder the draws, recording their positions for the next build.
+  sorted_draws.clear();
+  for (size_t i = 0; i < count; ++i) {
+    sorted_draws.push_back(range[merged_draws[i]]);
+    next_ranks.insert(
+        std::make_pair(GetDrawId(sorted_draws.back()), next_ranks.size()));
+  }
+  std::copy(sorted_draws.begin(), sorted_draws.end(), draws.begin() + start);
+}
+
+void Renderer::ResourceBinder::AddDepthPrepass(DrawList* list) {
+  // Each client state used by opaque draws gets a copy for the prepass and
+  // one for drawing after it.
+  const size_t num_states = list->states.size();
+  list->prepass_states.assign(num_states, kOutsideDepthPrepass);
+  base::AllocVector<size_t> in_prepass_states(*list, num_states,
+                                              base::kInvalidIndex);
+  base::AllocVector<size_t> after_prepass_states(*list, num_states,
+                                                 base::kInvalidIndex);
+
+  base::AllocVector<DrawList::Draw> draws(*list);
+  draws.reserve(list->draws.size());
+  const size_t num_draws = list->draws.size();
+  const size_t num_barriers = list->barriers.size();
+  size_t barrier_index = 0U;
+  for (size_t i = 0; i < num_draws;) {
+    // Barriers before this draw stay before any prepass inserted here.
+    for (; barrier_index < num_barriers &&
+           list->barriers[barrier_index].draw_index == i; ++barrier_index)
+      list->barriers[barrier_index].draw_index = draws.size();
+    if (list->draws[i].render_pass != Node::kOpaquePass) {
+      draws.push_back(list->draws[i++]);
+      continue;
+    }
+
+    // Find the end of the run of opaque draws, which no barrier precedes.
+    const size_t next_barrier = barrier_index < num_barriers
+                                    ? list->barriers[barrier_index].draw_index
+                                    : num_draws;
+    size_t run_end = i;
+    while (run_end < next_barrier &&
+           list->draws[run_end].render_pass == Node::kOpaquePass)
+      ++run_end;
+    for (size_t pass = 0; pass < 2U; ++pass) {
+      const bool is_prepass = pass == 0U;
+      base::AllocVector<size_t>& states =
+          is_prepass ? in_prepass_states : after_prepass_states;
+      for (size_t j = i; j < run_end; ++j) {
+        DrawList::Draw draw = list->draws[j];
+        size_t& state_index = states[draw.state_index];
+        if (state_index == base::kInvalidIndex) {
+          state_index = list->states.size();
+          list->states.push_back(list->states[draw.state_index]);
+          list->prepass_states.push_back(is_prepass ? kInDepthPrepass
+                                                    : kAfterDepthPrepass);
+        }
+        draw.state_index = state_index;
+        draw.is_depth_only = is_prepass;
+        draws.push_back(draw);
+      }
+    }
+    i = run_end;
+  }
+  for (; barrier_index < num_barriers; ++barrier_index)
+    list->barriers[barrier_index].draw_index = draws.size();
+  list->draws.swap(draws);
+}
+
+bool Renderer::ResourceBinder::UsesTransparencyPasses(
+    const Flags& flags) const {
+  if (!flags.test(kSortDrawsByRenderPass) ||
+      !flags.test(kOrderIndependentTransparency))
+    return false;
+  const GraphicsManagerPtr& gm = GetGraphicsManager();
+  if (!gm->IsFunctionGroupAvailable(GraphicsManager::kFramebufferBlit)) {
+    LOG_ONCE(WARNING) << "***ION: Order-independent transparency requires "
+                         "framebuffer blits, which are not available; "
+                         "drawing the transparent pass back to front.";
+    return false;
+  }
+  // The accumulation target is a half-float texture, which desktop OpenGL can
+  // render into from version 3.0, and OpenGL ES from version 3.2. Otherwise
+  // an extension is needed, or the target framebuffer would be incomplete.
+  const GLuint min_version =
+      gm->GetGlApiStandard() == GraphicsManager::kDesktop ? 30U : 32U;
+  if (gm->GetGlVersion() < min_version &&
+      !gm->IsExtensionSupported("color_buffer_half_float") &&
+      !gm->IsExtensionSupported("color_buffer_float")) {
+    LOG_ONCE(WARNING) << "***ION: Order-independent transparency requires "
+                         "half-float color buffers, which are not available; "
+                         "drawing the transparent pass back to front.";
+    return false;
+  }
+  return true;
+}
+
+void Renderer::ResourceBinder::AddTransparencyPasses(DrawList* list) {
+  // Each client state used by transparent draws gets a copy for each pass.
+  // If there is a depth prepass, the copies keep the prepass state of the
+  // original.
+  const size_t num_states = list->states.size();
+  const bool has_prepass_states = !list->prepass_states.empty();
+  list->transparency_states.assign(num_states, kOutsideTransparencyPasses);
+  base::AllocVector<size_t> accumulation_states(*list, num_states,
+                                                base::kInvalidIndex);
+  base::AllocVector<size_t> revealage_states(*list, num_states,
+                                             base::kInvalidIndex);
+
+  base::AllocVector<DrawList::Draw> draws(*list);
+  draws.reserve(list->draws.size());
+  const size_t num_draws = list->draws.size();
+  const size_t num_barriers = list->barriers.size();
+  size_t barrier_index = 0U;
+  for (size_t i = 0; i < num_draws;) {
+    for (; barrier_index < num_barriers &&
+           list->barriers[barrier_index].draw_index == i; ++barrier_index)
+      list->barriers[barrier_index].draw_index = draws.size();
+    if (list->draws[i].render_pass != Node::kTransparentPass) {
+      draws.push_back(list->draws[i++]);
+      continue;
+    }
+
+    // Find the end of the run of transparent draws, which no barrier
+    // precedes.
+    const size_t next_barrier = barrier_index < num_barriers
+                                    ? list->barriers[barrier_index].draw_index
+                                    : num_draws;
+    size_t run_end = i;
+    while (run_end < next_barrier &&
+           list->draws[run_end].render_pass == Node::kTransparentPass)
+      ++run_end;
+    for (size_t pass = 0; pass < 2U; ++pass) {
+      const TransparencyPassState pass_state =
+          pass == 0U ? kInAccumulationPass : kInRevealagePass;
+      base::AllocVector<size_t>& states =
+          pass == 0U ? accumulation_states : revealage_states;
+      for (size_t j = i; j < run_end; ++j) {
+        DrawList::Draw draw = list->draws[j];
+        size_t& state_index = states[draw.state_index];
+        if (state_index == base::kInvalidIndex) {
+          state_index = list->states.size();
+          list->states.push_back(list->states[draw.state_index]);
+          list->transparency_states.push_back(pass_state);
+          if (has_prepass_states)
+            list->prepass_states.push_back(
+                list->prepass_states[draw.state_index]);
+        }
+        draw.state_index = state_index;
+        draw.transparency_pass = pass_state;
+        draws.push_back(draw);
+      }
+    }
+    i = run_end;
+  }
+  for (; barrier_index < num_barriers; ++barrier_index)
+    list->barriers[barrier_index].draw_index = draws.size();
+  list->draws.swap(draws);
+}
+
+void Renderer::ResourceBinder::RetainSubgraphLists(DrawList* list) {
+  base::AllocUnorderedMap<const Node*, DrawListPtr>& retained =
+      retained_subgraph_lists_;
+  const size_t num_lists = list->subgraph_lists.size();
+  for (size_t i = 0; i < num_lists; ++i) {
+    const DrawListPtr& part = list->subgraph_lists[i];
+    // Lists whose roots have been destroyed are dropped.
+    if (const Node* node = part->root.Acquire().Get())
+      retained.insert(std::make_pair(node, part));
+  }
+  list->subgraph_lists.clear();
+
+  const size_t num_subgraphs = draw_list_subgraphs_.size();
+  for (size_t i = 0; i < num_subgraphs; ++i) {
+    const DrawListSubgraph& subgraph = draw_list_subgraphs_[i];
+    DrawListPtr part;
+    auto it = retained.find(subgraph.node);
+    if (it != retained.end()) {
+      // A Node that is a child more than once gets a new list the next time.
+      part = it->second;
+      retained.erase(it);
+      // The list is also stale if what the subgraph inherits has changed.
+      if (part->IsValid() &&
+          (part->default_shader != subgraph.builder.shader_program ||
+           part->state_key != subgraph.state_key ||
+           part->texture_key != subgraph.texture_key ||
+           part->preserve_order != subgraph.preserve_order ||
+           part->render_pass != subgraph.render_pass ||
+           !AreStateNodesCurrent(*part)))
+        part->Clear();
+    } else {
+      part = new (GetAllocator()) DrawList;
+      part->root =
+          base::WeakReferentPtr<Node>(const_cast<Node*>(subgraph.node));
+    }
+    part->default_shader = subgraph.builder.shader_program;
+    part->state_key = subgraph.state_key;
+    part->texture_key = subgraph.texture_key;
+    part->preserve_order = subgraph.preserve_order;
+    part->render_pass = subgraph.render_pass;
+    list->subgraph_lists.push_back(part);
+  }
+  retained.clear();
+}
+
+void Renderer::ResourceBinder::CollectSubgraph(size_t index, DrawList* part) {
+  if (part->IsValid())
+    return;
+  part->Clear();
+  DrawListSubgraph& subgraph = draw_list_subgraphs_[index];
+  CollectNode(*subgraph.node, subgraph.state_key, subgraph.texture_key,
+              subgraph.preserve_order, subgraph.render_pass,
+              &subgraph.builder, part);
+}
+
+void Renderer::ResourceBinder::CollectNode(const Node& node, size_t state_key,
+                                           size_t texture_key,
+                                           bool preserve_order,
+                                           Node::RenderPass render_pass,
+                                           DrawListBuilder* builder,
+                                           DrawList* list) {
+  if (!IsNodeDrawable(node, builder->visibility_function,
+                      builder->clip_from_scene, builder->upload_worker))
     return;
 
-  ScopedLabel label(this, &node, node.GetLabel());
-
-  if (const StateTable* st = node.GetStateTable().Get()) {
-    // Store the current client state; it will be restored after drawing and
-    // processing any children.
-    traversal_state_tables_[current_traversal_index_]->CopyFrom(
-        *client_state_table_.Get());
-    // Point child nodes at the next entry in the StateTable shadow vector.
-    if (++current_traversal_index_ >= traversal_state_tables_.size())
-      traversal_state_tables_.push_back(StateTablePtr(new StateTable));
-
-    // Merge the node's state table into the client state.
-    client_state_table_->MergeValuesFrom(*st, *st);
-    ClearFromStateTable(*st, gl_state_table_.Get(), gm);
-    if (st->AreSettingsEnforced()) {
-      UpdateFromStateTable(*st, gl_state_table_.Get(), gm);
-      // Update our copy of OpenGL's state.
-      gl_state_table_->MergeNonClearValuesFrom(*st, *st);
-    }
+  base::AllocVector<const Node*>& traversal_path = builder->traversal_path;
+  traversal_path.push_back(&node);
+
+  const StateTable* st = node.GetStateTable().Get();
+  if (st) {
+    // Clears and enforced settings must happen in tree order, so draws are
+    // never sorted across them.
+    DrawList::StateNode state_node;
+    state_node.node = &node;
+    state_node.is_barrier = IsBarrierStateTable(*st);
+    list->state_nodes.push_back(state_node);
+    if (state_node.is_barrier) {
+      DrawList::Barrier barrier;
+      barrier.draw_index = list->draws.size();
+      barrier.path.start = list->path_nodes.size();
+      barrier.path.length = traversal_path.size();
+      list->path_nodes.insert(list->path_nodes.end(), traversal_path.begin(),
+                              traversal_path.end());
+      list->barriers.push_back(barrier);
+    }
+    state_key = CombineSortKey(state_key, st);
+    builder->state_changed = true;
   }
 
-  // Get the Node's shader, if any.
   if (ShaderProgram* shader = node.GetShaderProgram().Get())
-    current_shader_program_ = shader;
-  DCHECK(current_shader_program_);
-
-  // Process all Uniforms.
-  PushUniforms(&node, node.GetUniforms());
-  const base::AllocVector<UniformBlockPtr>& uniform_blocks =
+    builder->shader_program = shader;
+  DCHECK(builder->shader_program);
+  preserve_order = preserve_order || node.IsDrawOrderPreserved();
+  if (node.GetRenderPass() != Node::kInheritedPass)
+    render_pass = node.GetRenderPass();
+
+  // Fold any textures into the key; their actual values are resolved when the
+  // Uniforms are pushed before drawing.
+  texture_key = CombineTextureSortKey(texture_key, node.GetUniforms());
+  const Node::UniformBlockVector& uniform_blocks =
       node.GetUniformBlocks();
   const size_t num_uniform_blocks = uniform_blocks.size();
   for (size_t i = 0; i < num_uniform_blocks; ++i)
     if (uniform_blocks[i]->IsEnabled())
-      PushUniforms(&node, uniform_blocks[i]->GetUniforms());
+      texture_key = CombineTextureSortKey(texture_key,
+                                          uniform_blocks[i]->GetUniforms());
 
-  // See if there are any shapes to draw.
-  const base::AllocVector<ShapePtr>& shapes = node.GetShapes();
+  const Node::ShapeVector& shapes = node.GetShapes();
   if (const size_t num_shapes = shapes.size()) {
-    // Send global state changes relative to current GL state to OpenGL.
-    UpdateFromStateTable(*client_state_table_, gl_state_table_.Get(), gm);
+    DrawList::Draw draw;
+    draw.shader_program = builder->shader_program;
+    draw.state_key = state_key;
+    draw.texture_key = texture_key;
+    draw.path.start = list->path_nodes.size();
+    draw.path.length = traversal_path.size();
+    draw.preserve_order = preserve_order;
+    draw.render_pass = render_pass;
+    draw.depth = 0.f;
+    draw.is_depth_only = false;
+    draw.transparency_pass = kOutsideTransparencyPasses;
+    list->path_nodes.insert(list->path_nodes.end(), traversal_path.begin(),
+                            traversal_path.end());
+    // Add a new client state if it has changed since the last one.
+    if (builder->state_changed) {
+      list->states.push_back(draw.path);
+      builder->state_changed = false;
+    }
+    draw.state_index = list->states.size() - 1U;
+    for (size_t i = 0; i < num_shapes; ++i) {
+      draw.shape = shapes[i].Get();
+      draw.attribute_array = draw.shape->GetAttributeArray().Get();
+      list->draws.push_back(draw);
+    }
+  }
+
+  // Recurse on children, restoring the shader after each as in DrawNode().
+  ShaderProgram* saved_shader_program = builder->shader_program;
+  const Node::NodeVector& children = node.GetChildren();
+  const size_t num_children = children.size();
+  if (base::AllocVector<DrawListSubgraph>* subgraphs = builder->subgraphs) {
+    // Only the children of this Node may become subgraphs.
+    builder->subgraphs = NULL;
+    for (size_t i = 0; i < num_children; ++i) {
+      DrawListSubgraph subgraph(*list);
+      subgraph.builder.traversal_path = traversal_path;
+      subgraph.builder.shader_program = saved_shader_program;
+      subgraph.builder.visibility_function = builder->visibility_function;
+      subgraph.builder.clip_from_scene = builder->clip_from_scene;
+      subgraph.builder.upload_worker = builder->upload_worker;
+      subgraph.node = children[i].Get();
+      subgraph.state_key = state_key;
+      subgraph.texture_key = texture_key;
+      subgraph.preserve_order = preserve_order;
+      subgraph.render_pass = render_pass;
+      subgraphs->push_back(subgraph);
+    }
+  } else {
+    for (size_t i = 0; i < num_children; ++i) {
+      CollectNode(*children[i], state_key, texture_key, preserve_order,
+                  render_pass, builder, list);
+      builder->shader_program = saved_shader_program;
+    }
+  }
+
+  if (st)
+    builder->state_changed = true;
+  traversal_path.pop_back();
+}
+
+void Renderer::ResourceBinder::AppendDrawList(const DrawList& part,
+                                              DrawList* list) {
+  // A part begins with a new client state, which the list may already end
+  // with. Sharing it avoids needlessly sending state between the parts.
+  const size_t first_state =
+      !part.states.empty() && !list->states.empty() &&
+              HaveSameStateNodes(*list, list->states.back(), part,
+                                 part.states[0])
+          ? 1U
+          : 0U;
+  const size_t path_offset = list->path_nodes.size();
+  const size_t draw_offset = list->draws.size();
+  const size_t state_offset = list->states.size() - first_state;
+  list->path_nodes.insert(list->path_nodes.end(), part.path_nodes.begin(),
+                          part.path_nodes.end());
+
+  const size_t num_draws = part.draws.size();
+  for (size_t i = 0; i < num_draws; ++i) {
+    DrawList::Draw draw = part.draws[i];
+    draw.path.start += path_offset;
+    draw.state_index += state_offset;
+    list->draws.push_back(draw);
+  }
+  const size_t num_states = part.states.size();
+  for (size_t i = first_state; i < num_states; ++i) {
+    DrawList::Path path = part.states[i];
+    path.start += path_offset;
+    list->states.push_back(path);
+  }
+  const size_t num_barriers = part.barriers.size();
+  for (size_t i = 0; i < num_barriers; ++i) {
+    DrawList::Barrier barrier = part.barriers[i];
+    barrier.draw_index += draw_offset;
+    barrier.path.start += path_offset;
+    list->barriers.push_back(barrier);
+  }
+  list->state_nodes.insert(list->state_nodes.end(), part.state_nodes.begin(),
+                           part.state_nodes.end());
+}
+
+bool Renderer::ResourceBinder::HaveSameStateNodes(
+    const DrawList& a, const DrawList::Path& a_path, const DrawList& b,
+    const DrawList::Path& b_path) {
+  size_t i = 0U;
+  size_t j = 0U;
+  while (true) {
+    while (i < a_path.length &&
+           !a.path_nodes[a_path.start + i]->GetStateTable().Get())
+      ++i;
+    while (j < b_path.length &&
+           !b.path_nodes[b_path.start + j]->GetStateTable().Get())
+      ++j;
+    if (i == a_path.length || j == b_path.length)
+      return i == a_path.length && j == b_path.length;
+    if (a.path_nodes[a_path.start + i] != b.path_nodes[b_path.start + j])
+      return false;
+    ++i;
+    ++j;
+  }
+}
 
-    // Bind the shader program to use. Note that it may already be bound in
-    // OpenGL, but we still need to update the resource.
-    resource_manager_->GetResource(current_shader_program_, this)->Bind(this);
+void Renderer::ResourceBinder::DrawDrawList(const DrawList& list,
+                                            GraphicsManager* gm) {
+  // Compute the client states from the current values of the StateTables.
+  const size_t num_states = list.states.size();
+  while (draw_list_state_tables_.size() < num_states)
+    draw_list_state_tables_.push_back(
+        StateTablePtr(new (GetAllocator()) StateTable(0, 0)));
+  const bool has_prepass_states = !list.prepass_states.empty();
+  const bool has_transparency_states = !list.transparency_states.empty();
+  for (size_t i = 0; i < num_states; ++i) {
+    StateTable* state = draw_list_state_tables_[i].Get();
+    ComputeDrawListState(list, list.states[i], list.states[i].length, state);
+    if (has_prepass_states)
+      ApplyDepthPrepassState(list.prepass_states[i], state);
+    if (has_transparency_states)
+      ApplyTransparencyPassState(list.transparency_states[i], state);
+  }
+
+  ShaderProgram* saved_shader_program = current_shader_program_;
+  const size_t count = list.draws.size();
+  const size_t num_barriers = list.barriers.size();
+  size_t barrier_index = 0U;
+  const DrawList::Draw* previous = NULL;
+  bool state_changed = true;
+  bool is_program_drawable = true;
+  TransparencyPassState transparency_pass = kOutsideTransparencyPasses;
+  bool is_pass_drawable = true;
+  for (size_t i = 0; i <= count; ++i) {
+    // Composite the transparency passes before anything that is not in them,
+    // including barriers.
+    if (transparency_pass != kOutsideTransparencyPasses &&
+        (i == count ||
+         (barrier_index < num_barriers &&
+          list.barriers[barrier_index].draw_index == i) ||
+         list.draws[i].transparency_pass == kOutsideTransparencyPasses)) {
+      FlushMultiDraw(gm);
+      SwitchDrawListPath(list, previous, NULL);
+      previous = NULL;
+      EndTransparencyPasses(gm);
+      transparency_pass = kOutsideTransparencyPasses;
+      is_pass_drawable = true;
+      state_changed = true;
+    }
+
+    // Apply any clears and enforced settings that precede this draw. These
+    // are affected by the enclosing state as they would be in tree order.
+    for (; barrier_index < num_barriers &&
+           list.barriers[barrier_index].draw_index == i; ++barrier_index) {
+      FlushMultiDraw(gm);
+      const DrawList::Path& path = list.barriers[barrier_index].path;
+      ComputeDrawListState(list, path, path.length - 1U,
+                           draw_list_scratch_state_.Get());
+      UpdateFromStateTable(*draw_list_scratch_state_, gl_state_table_.Get(),
+                           gm);
+      gl_state_table_->MergeNonClearValuesFrom(*draw_list_scratch_state_,
+                                               *draw_list_scratch_state_);
+      const StateTable& st =
+          *list.path_nodes[path.start + path.length - 1U]->GetStateTable();
+      ClearFromStateTable(st, gl_state_table_.Get(), gm);
+      if (st.AreSettingsEnforced()) {
+        UpdateFromStateTable(st, gl_state_table_.Get(), gm);
+        gl_state_table_->MergeNonClearValuesFrom(st, st);
+      }
+      state_changed = true;
+    }
+    if (i == count)
+      break;
 
-    // Draw shapes.
-    for (size_t i = 0; i < num_shapes; ++i)
-      DrawShape(*shapes[i], gm);
+    const DrawList::Draw& draw = list.draws[i];
+    if (draw.transparency_pass != transparency_pass) {
+      FlushMultiDraw(gm);
+      transparency_pass = draw.transparency_pass;
+      is_pass_drawable = BeginTransparencyPass(
+          transparency_pass, *draw_list_state_tables_[draw.state_index], gm);
+      state_changed = true;
+    }
+    const bool uniforms_changed = SwitchDrawListPath(list, previous, &draw);
 
-    // Update our copy of OpenGL's state.
-    gl_state_table_->MergeNonClearValuesFrom(*client_state_table_,
-                                             *client_state_table_);
+    // Send global state changes relative to current GL state to OpenGL.
+    if (state_changed || previous->state_index != draw.state_index) {
+      FlushMultiDraw(gm);
+      const StateTable& st = *draw_list_state_tables_[draw.state_index];
+      UpdateFromStateTable(st, gl_state_table_.Get(), gm);
+      gl_state_table_->MergeNonClearValuesFrom(st, st);
+      state_changed = false;
+    }
+
+    // Bind the shader program and send its uniforms, unless nothing has
+    // changed since the last draw.
+    ShaderProgram* shader_program = draw.shader_program;
+    if (draw.is_depth_only) {
+      if (ShaderProgram* variant =
+              shader_program->GetDepthOnlyVariant().Get())
+        shader_program = variant;
+    } else if (draw.transparency_pass == kInRevealagePass) {
+      if (ShaderProgram* variant =
+              shader_program->GetRevealageVariant().Get())
+        shader_program = variant;
+    }
+    if (uniforms_changed || current_shader_program_ != shader_program) {
+      FlushMultiDraw(gm);
+      current_shader_program_ = shader_program;
+      ShaderProgramResource* spr =
+          resource_manager_->GetResource(current_shader_program_, this);
+      spr->Bind(this);
+      is_program_drawable = spr->IsDrawable();
+    }
+
+    // Skip the draw if its program is still being linked, or if it belongs
+    // to a transparency pass whose target could not be prepared.
+    if (is_program_drawable && is_pass_drawable)
+      DrawShape(*draw.shape, gm);
+    previous = &draw;
+  }
+  FlushMultiDraw(gm);
+  SwitchDrawListPath(list, previous, NULL);
+  current_shader_program_ = saved_shader_program;
+}
+
+bool Renderer::ResourceBinder::BeginTransparencyPass(
+    TransparencyPassState pass, const StateTable& state,
+    GraphicsManager* gm) {
+  if (pass == kInAccumulationPass) {
+    transparency_framebuffer_ = active_framebuffer_;
+    transparency_framebuffer_resource_ = active_framebuffer_resource_;
+    if (transparency_framebuffer_ == kInvalidGluint) {
+      // The binding is not known, for example when the default framebuffer
+      // was bound outside of Ion.
+      GLint id = 0;
+      gm->GetIntegerv(GL_FRAMEBUFFER_BINDING, &id);
+      transparency_framebuffer_ = static_cast<GLuint>(id);
+    }
+    transparency_viewport_ = state.GetViewport();
+    const FramebufferObjectPtr fbo = GetCurrentFramebuffer();
+    if (fbo.Get()) {
+      transparency_size_.Set(fbo->GetWidth(), fbo->GetHeight());
+    } else {
+      const math::Point2i corner = transparency_viewport_.GetMaxPoint();
+      transparency_size_.Set(static_cast<uint32>(std::max(0, corner[0])),
+                             static_cast<uint32>(std::max(0, corner[1])));
+    }
+    has_transparency_targets_ =
+        transparency_size_[0] > 0U && transparency_size_[1] > 0U;
+    if (!has_transparency_targets_) {
+      LOG_ONCE(WARNING) << "***ION: Unable to draw order-independent "
+                           "transparency without a viewport or framebuffer "
+                           "size; transparent draws are skipped.";
+      return false;
+    }
+    if (!transparency_targets_)
+      transparency_targets_.reset(new (GetAllocator()) TransparencyTargets);
+    copy_transparency_depth_ = transparency_targets_->Prepare(
+        transparency_size_[0], transparency_size_[1],
+        fbo.Get() ? &fbo->GetDepthAttachment() : NULL);
   }
+  if (!has_transparency_targets_)
+    return false;
 
-  // Store the current shader since it needs to be restored after drawing
-  // children.
-  ShaderProgram* saved_shader_program = current_shader_program_;
+  const TransparencyTargets::Target target =
+      pass == kInAccumulationPass ? TransparencyTargets::kAccumulationTarget
+                                  : TransparencyTargets::kRevealageTarget;
+  FramebufferResource* fbr = resource_manager_->GetResource(
+      transparency_targets_->GetFramebuffer(target), this);
+  fbr->Bind(this);
+  if (copy_transparency_depth_) {
+    const GLint width = static_cast<GLint>(transparency_size_[0]);
+    const GLint height = static_cast<GLint>(transparency_size_[1]);
+    gm->BindFramebuffer(GL_READ_FRAMEBUFFER, transparency_framebuffer_);
+    gm->BlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+                        GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    gm->BindFramebuffer(GL_READ_FRAMEBUFFER, fbr->GetId());
+  }
+  ClearFromStateTable(transparency_targets_->GetClearState(target),
+                      gl_state_table_.Get(), gm);
+  return true;
+}
 
-  // Recurse on children.
-  const base::AllocVector<NodePtr>& children = node.GetChildren();
-  const size_t num_children = children.size();
-  for (size_t i = 0; i < num_children; ++i) {
-    DrawNode(*children[i], gm);
-    // Restore the previous shader as the next one to use.
-    current_shader_program_ = saved_shader_program;
+void Renderer::ResourceBinder::EndTransparencyPasses(GraphicsManager* gm) {
+  if (!has_transparency_targets_)
+    return;
+  has_transparency_targets_ = false;
+  BindFramebuffer(transparency_framebuffer_,
+                  transparency_framebuffer_resource_);
+  DrawNode(transparency_targets_->GetCompositeNode(transparency_viewport_),
+           gm);
+}
+
+void Renderer::ResourceBinder::ComputeDrawListState(
+    const DrawList& list, const DrawList::Path& path, size_t length,
+    StateTable* state) {
+  DCHECK_LE(length, path.length);
+  state->CopyFrom(*client_state_table_);
+  for (size_t i = 0; i < length; ++i) {
+    if (const StateTable* st =
+            list.path_nodes[path.start + i]->GetStateTable().Get())
+      state->MergeValuesFrom(*st, *st);
+  }
+}
+
+bool Renderer::ResourceBinder::SwitchDrawListPath(const DrawList& list,
+                                                  const DrawList::Draw* from,
+                                                  const DrawList::Draw* to) {
+  const Node* const* from_path =
+      from ? &list.path_nodes[from->path.start] : NULL;
+  const Node* const* to_path = to ? &list.path_nodes[to->path.start] : NULL;
+  const size_t from_length = from ? from->path.length : 0U;
+  const size_t to_length = to ? to->path.length : 0U;
+  if (from_path == to_path && from_length == to_length)
+    return from == NULL;
+
+  // Only the Nodes after the common prefix of the two paths need to be popped
+  // and pushed.
+  size_t common = 0U;
+  while (common < from_length && common < to_length &&
+         from_path[common] == to_path[common])
+    ++common;
+  for (size_t i = from_length; i > common; --i)
+    PopNodeUniforms(*from_path[i - 1U]);
+  for (size_t i = common; i < to_length; ++i)
+    PushNodeUniforms(*to_path[i]);
+  return true;
+}
+
+void Renderer::ResourceBinder::PushNodeUniforms(const Node& node) {
+  UniformStackMark mark;
+  mark.stack_size = uniform_stack_registries_.size();
+  mark.temp_count = temp_uniform_count_;
+  uniform_stack_marks_.push_back(mark);
+  PushUniforms(&node, node.GetUniforms());
+  const Node::UniformBlockVector& uniform_blocks =
+      node.GetUniformBlocks();
+  const size_t num_uniform_blocks = uniform_blocks.size();
+  for (size_t i = 0; i < num_uniform_blocks; ++i) {
+    UniformBlock* block = uniform_blocks[i].Get();
+    if (!block->IsEnabled())
+      continue;
+    if (IsBufferBacked(*block)) {
+      // Upload any changed values of the block; its buffer is bound to each
+      // program that declares the block when the program is bound.
+      UniformBufferBlock entry;
+      entry.block = block;
+      const BufferObjectPtr bo = block->UpdateBuffer();
+      entry.resource = resource_manager_->GetResource(bo.Get(), this);
+      entry.resource->MarkUsed();
+      entry.resource->Update(this);
+      uniform_buffer_blocks_.push_back(entry);
+    } else {
+      PushUniforms(&node, block->GetUniforms());
+    }
   }
+}
 
-  // Reverse the changes made by the local StateTable.
-  if (const StateTable* st = node.GetStateTable().Get()) {
-    --current_traversal_index_;
-    client_state_table_->MergeNonClearValuesFrom(
-        *traversal_state_tables_[current_traversal_index_].Get(), *st);
+void Renderer::ResourceBinder::PopNodeUniforms(const Node& node) {
+  // Restore the values replaced by the Node's Uniforms, including those of its
+  // UniformBlocks and any generated Uniforms, in reverse order.
+  DCHECK(!uniform_stack_marks_.empty());
+  const UniformStackMark& mark = uniform_stack_marks_.back();
+  for (size_t i = uniform_stack_registries_.size(); i > mark.stack_size; --i)
+    uniform_stack_registries_[i - 1U]->SetTop(uniform_stack_indices_[i - 1U],
+                                              uniform_stack_previous_[i - 1U]);
+  uniform_stack_registries_.resize(mark.stack_size);
+  uniform_stack_indices_.resize(mark.stack_size);
+  uniform_stack_previous_.resize(mark.stack_size);
+  // Release the values of the temporary Uniforms, which may hold Textures.
+  for (size_t i = mark.temp_count; i < temp_uniform_count_; ++i)
+    temp_uniforms_[i] = Uniform();
+  temp_uniform_count_ = mark.temp_count;
+  uniform_stack_marks_.pop_back();
+
+  const Node::UniformBlockVector& uniform_blocks =
+      node.GetUniformBlocks();
+  const size_t num_uniform_blocks = uniform_blocks.size();
+  for (size_t i = 0; i < num_uniform_blocks; ++i) {
+    const UniformBlock& block = *uniform_blocks[i];
+    if (!block.IsEnabled())
+      continue;
+    if (IsBufferBacked(block)) {
+      DCHECK(!uniform_buffer_blocks_.empty());
+      uniform_buffer_blocks_.pop_back();
+    }
   }
+}
 
-  // Restore uniform values.
-  PopUniforms(node.GetUniforms());
-  for (size_t i = 0; i < num_uniform_blocks; ++i)
-    if (uniform_blocks[i]->IsEnabled())
-      PopUniforms(uniform_blocks[i]->GetUniforms());
+bool Renderer::ResourceBinder::IsBufferBacked(const UniformBlock& block) {
+  return !block.GetBlockName().empty() &&
+         GetGraphicsManager()->IsFunctionGroupAvailable(
+             GraphicsManager::kUniformBufferObjects);
 }
 
 void Renderer::ResourceBinder::DrawShape(const Shape& shape,
@@ -5683,9 +12488,16 @@ void Renderer::ResourceBinder::DrawShape(const Shape& shape,
     return;
   const AttributeArray& attribute_array = *shape.GetAttributeArray();
   if (attribute_array.GetAttributeCount() == 0U ||
-      (shape.GetIndexBuffer().Get() && !shape.GetIndexBuffer()->GetCount()))
+      (shape.GetIndexBuffer().Get() && !shape.GetIndexBuffer()->GetCount()) ||
+      (upload_worker_ && HasPendingBuffers(shape)))
     return;
 
+  // Pending draws can only be combined with this Shape's if they use the same
+  // vertex and index data.
+  if (multi_draw_batch_.attribute_array != &attribute_array ||
+      multi_draw_batch_.index_buffer != shape.GetIndexBuffer().Get())
+    FlushMultiDraw(gm);
+
   ScopedLabel label(this, &shape, shape.GetLabel());
 
   // Bind the vertex array. We can only use vertex arrays if they are available
@@ -5701,13 +12513,68 @@ void Renderer::ResourceBinder::DrawShape(const Shape& shape,
   DCHECK(var);
   if (var && !var->BindAndCheckBuffers(false, this))
     return;
+  if (resource_manager_->GetGpuMemoryBudget())
+    var->MarkBuffersUsed(this);
+  if (transform_feedback_.Get() && !BeginTransformFeedbackCapture(shape, gm))
+    return;
+  if ((pipeline_warm_up_ || resource_manager_->IsRecordingPipelines()) &&
+      RecordOrWarmUpPipeline(shape, var->GetVertexCount(), gm))
+    return;
 
   // Draw the shape.
+  if (node_cpu_timer_)
+    node_cpu_timer_->CountDraw();
+  multi_draw_batch_.attribute_array = &attribute_array;
+  multi_draw_batch_.index_buffer = shape.GetIndexBuffer().Get();
+  if (!shape.GetIndirectBuffer().Get() || !DrawIndirectShape(shape, gm)) {
+    if (IndexBuffer* ib = shape.GetIndexBuffer().Get()) {
+      DrawIndexedShape(shape, *ib, gm);
+    } else {
+      DrawNonindexedShape(shape, var->GetVertexCount(), gm);
+    }
+  }
+  gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerDraw,
+                             shape.GetLabel());
+}
+
+bool Renderer::ResourceBinder::DrawIndirectShape(const Shape& shape,
+                                                 GraphicsManager* gm) {
+  if (!gm->IsFunctionGroupAvailable(GraphicsManager::kDrawIndirect)) {
+    LOG_ONCE(WARNING) << "***ION: Indirect drawing is not available. Shape: "
+                      << shape.GetLabel()
+                      << " will be drawn with its own ranges and instances.";
+    return false;
+  }
+  BufferResource* indirect =
+      resource_manager_->GetResource(shape.GetIndirectBuffer().Get(), this);
+  DCHECK(indirect);
+  indirect->Update(this);
+  indirect->MarkUsed();
+  const GLuint id = indirect->GetId();
+  if (!id)
+    return false;
+
+  // The command may have been written by the GPU, so it cannot be batched.
+  FlushMultiDraw(gm);
+  if (id != active_indirect_buffer_) {
+    gm->BindBuffer(GL_DRAW_INDIRECT_BUFFER, id);
+    active_indirect_buffer_ = id;
+  }
+  const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+      indirect->GetDataOffset() + shape.GetIndirectOffset());
+  const GLenum prim_type =
+      base::EnumHelper::GetConstant(shape.GetPrimitiveType());
   if (IndexBuffer* ib = shape.GetIndexBuffer().Get()) {
-    DrawIndexedShape(shape, *ib, gm);
+    BufferResource* br = resource_manager_->GetResource(ib, this);
+    DCHECK(br);
+    br->Bind(this);
+    gm->DrawElementsIndirect(
+        prim_type, base::EnumHelper::GetConstant(ib->GetSpec(0).type),
+        offset);
   } else {
-    DrawNonindexedShape(shape, var->GetVertexCount(), gm);
+    gm->DrawArraysIndirect(prim_type, offset);
   }
+  return true;
 }
 
 void Renderer::ResourceBinder::DrawIndexedShape(const Shape& shape,
@@ -5747,6 +12614,7 @@ void Renderer::ResourceBinder::DrawIndexedShape(const Shape& shape,
           if (instance_count &&
               gm->IsFunctionGroupAvailable(
                   GraphicsManager::kInstancedDrawing)) {
+            FlushMultiDraw(gm);
             gm->DrawElementsInstanced(prim_type, count, data_type,
                                       reinterpret_cast<const GLvoid*>(
                                           start_index * ib.GetStructSize()),
@@ -5758,9 +12626,10 @@ void Renderer::ResourceBinder::DrawIndexedShape(const Shape& shape,
                                 << shape.GetLabel()
                                 << " will be drawn only once.";
             }
-            gm->DrawElements(prim_type, count, data_type,
-                             reinterpret_cast<const GLvoid*>(
-                                 start_index * ib.GetStructSize()));
+            AddToMultiDraw(
+                prim_type, data_type,
+                static_cast<GLint>(start_index * ib.GetStructSize()), count,
+                gm);
           }
         }
       }
@@ -5769,6 +12638,7 @@ void Renderer::ResourceBinder::DrawIndexedShape(const Shape& shape,
       const int instance_count = shape.GetInstanceCount();
       if (instance_count &&
           gm->IsFunctionGroupAvailable(GraphicsManager::kInstancedDrawing)) {
+        FlushMultiDraw(gm);
         gm->DrawElementsInstanced(
             prim_type, static_cast<GLsizei>(ib.GetCount()), data_type,
             reinterpret_cast<const GLvoid*>(0), instance_count);
@@ -5778,8 +12648,8 @@ void Renderer::ResourceBinder::DrawIndexedShape(const Shape& shape,
               << "***ION: Instanced drawing is not available. Shape: "
               << shape.GetLabel() << " will be drawn only once.";
         }
-        gm->DrawElements(prim_type, static_cast<GLsizei>(ib.GetCount()),
-                         data_type, reinterpret_cast<const GLvoid*>(0));
+        AddToMultiDraw(prim_type, data_type, 0,
+                       static_cast<GLsizei>(ib.GetCount()), gm);
       }
     }
   } else {
@@ -5789,6 +12659,63 @@ void Renderer::ResourceBinder::DrawIndexedShape(const Shape& shape,
   }
 }
 
+bool Renderer::ResourceBinder::RecordOrWarmUpPipeline(const Shape& shape,
+                                                      size_t vertex_count,
+                                                      GraphicsManager* gm) {
+  DCHECK(current_shader_program_);
+  const AttributeArray& attribute_array = *shape.GetAttributeArray();
+  const GLenum prim_type =
+      base::EnumHelper::GetConstant(shape.GetPrimitiveType());
+  if (!pipeline_warm_up_) {
+    // Computing the key is only worth it the first time a combination is
+    // drawn.
+    size_t seen_key = CombineSortKey(gl_state_table_->GetHash(),
+                                     current_shader_program_);
+    seen_key = CombineSortKey(seen_key, &attribute_array);
+    seen_key = CombineSortKey(seen_key, reinterpret_cast<const void*>(
+                                            static_cast<size_t>(prim_type)));
+    if (recorded_pipelines_.insert(seen_key).second)
+      resource_manager_->RecordPipeline(ComputePipelineKey(
+          *current_shader_program_, *gl_state_table_, attribute_array,
+          prim_type));
+    return false;
+  }
+
+  const uint64 key = ComputePipelineKey(
+      *current_shader_program_, *gl_state_table_, attribute_array, prim_type);
+  if ((pipeline_warm_up_->keys && !pipeline_warm_up_->keys->count(key)) ||
+      !pipeline_warm_up_->drawn.insert(key).second)
+    return true;
+
+  // A single primitive is enough for the driver to build the pipeline.
+  GLsizei count = 3;
+  if (shape.GetPrimitiveType() == Shape::kPoints)
+    count = 1;
+  else if (shape.GetPrimitiveType() == Shape::kLines ||
+           shape.GetPrimitiveType() == Shape::kLineLoop ||
+           shape.GetPrimitiveType() == Shape::kLineStrip)
+    count = 2;
+  FlushMultiDraw(gm);
+  if (const IndexBuffer* ib = shape.GetIndexBuffer().Get()) {
+    if (!ib->GetData().Get())
+      return true;
+    BufferResource* br = resource_manager_->GetResource(ib, this);
+    DCHECK(br);
+    br->Bind(this);
+    count = std::min(count, static_cast<GLsizei>(ib->GetCount()));
+    gm->DrawElements(prim_type, count,
+                     base::EnumHelper::GetConstant(ib->GetSpec(0).type),
+                     reinterpret_cast<const GLvoid*>(0));
+  } else {
+    count = std::min(count, static_cast<GLsizei>(vertex_count));
+    if (!count)
+      return true;
+    gm->DrawArrays(prim_type, 0, count);
+  }
+  ++pipeline_warm_up_->draw_count;
+  return true;
+}
+
 void Renderer::ResourceBinder::DrawNonindexedShape(const Shape& shape,
                                                    size_t vertex_count,
                                                    GraphicsManager* gm) {
@@ -5805,6 +12732,7 @@ void Renderer::ResourceBinder::DrawNonindexedShape(const Shape& shape,
         const int instance_count = shape.GetVertexRangeInstanceCount(i);
         if (instance_count &&
             gm->IsFunctionGroupAvailable(GraphicsManager::kInstancedDrawing)) {
+          FlushMultiDraw(gm);
           gm->DrawArraysInstanced(prim_type, start_index, count,
                                   instance_count);
         } else {
@@ -5814,7 +12742,7 @@ void Renderer::ResourceBinder::DrawNonindexedShape(const Shape& shape,
                               << shape.GetLabel()
                               << " will be drawn only once.";
           }
-          gm->DrawArrays(prim_type, start_index, count);
+          AddToMultiDraw(prim_type, GL_NONE, start_index, count, gm);
         }
       }
     }
@@ -5823,6 +12751,7 @@ void Renderer::ResourceBinder::DrawNonindexedShape(const Shape& shape,
     const int instance_count = shape.GetInstanceCount();
     if (instance_count &&
         gm->IsFunctionGroupAvailable(GraphicsManager::kInstancedDrawing)) {
+      FlushMultiDraw(gm);
       gm->DrawArraysInstanced(prim_type, 0, static_cast<GLsizei>(vertex_count),
                               instance_count);
     } else {
@@ -5831,9 +12760,241 @@ void Renderer::ResourceBinder::DrawNonindexedShape(const Shape& shape,
             << "***ION: Instanced drawing is not available. Shape: "
             << shape.GetLabel() << " will be drawn only once.";
       }
-      gm->DrawArrays(prim_type, 0, static_cast<GLsizei>(vertex_count));
+      AddToMultiDraw(prim_type, GL_NONE, 0,
+                     static_cast<GLsizei>(vertex_count), gm);
+    }
+  }
+}
+
+void Renderer::ResourceBinder::AddToMultiDraw(GLenum primitive_type,
+                                              GLenum index_type, GLint first,
+                                              GLsizei count,
+                                              GraphicsManager* gm) {
+  MultiDrawBatch& batch = multi_draw_batch_;
+  if (batch.primitive_type != primitive_type ||
+      batch.index_type != index_type) {
+    FlushMultiDraw(gm);
+    batch.primitive_type = primitive_type;
+    batch.index_type = index_type;
+  }
+  if (index_type == GL_NONE)
+    batch.firsts.push_back(first);
+  else
+    batch.offsets.push_back(reinterpret_cast<const GLvoid*>(
+        static_cast<intptr_t>(first)));
+  batch.counts.push_back(count);
+}
+
+void Renderer::ResourceBinder::FlushMultiDraw(GraphicsManager* gm) {
+  MultiDrawBatch& batch = multi_draw_batch_;
+  const GLsizei draw_count = static_cast<GLsizei>(batch.counts.size());
+  if (!draw_count)
+    return;
+
+  const bool is_indexed = batch.index_type != GL_NONE;
+  if (draw_count > 1 &&
+      gm->IsFunctionGroupAvailable(GraphicsManager::kMultiDraw)) {
+    if (is_indexed)
+      gm->MultiDrawElements(batch.primitive_type, &batch.counts[0],
+                            batch.index_type, &batch.offsets[0], draw_count);
+    else
+      gm->MultiDrawArrays(batch.primitive_type, &batch.firsts[0],
+                          &batch.counts[0], draw_count);
+  } else {
+    for (GLsizei i = 0; i < draw_count; ++i) {
+      if (is_indexed)
+        gm->DrawElements(batch.primitive_type, batch.counts[i],
+                         batch.index_type, batch.offsets[i]);
+      else
+        gm->DrawArrays(batch.primitive_type, batch.firsts[i], batch.counts[i]);
+    }
+  }
+  batch.firsts.clear();
+  batch.counts.clear();
+  batch.offsets.clear();
+}
+
+bool Renderer::ResourceBinder::BeginTransformFeedbackCapture(
+    const Shape& shape, GraphicsManager* gm) {
+  // Transform feedback captures whole points, lines, or triangles.
+  GLenum primitive_type = GL_TRIANGLES;
+  switch (shape.GetPrimitiveType()) {
+    case Shape::kPoints:
+      primitive_type = GL_POINTS;
+      break;
+    case Shape::kLines:
+    case Shape::kLineLoop:
+    case Shape::kLineStrip:
+      primitive_type = GL_LINES;
+      break;
+    default:
+      break;
+  }
+  if (is_transform_feedback_active_) {
+    if (primitive_type != transform_feedback_primitive_type_ ||
+        active_shader_id_ != transform_feedback_program_) {
+      LOG(ERROR) << "***ION: Unable to capture shape " << shape.GetLabel()
+                 << " with transform feedback: All shapes in a capture must"
+                 << " use the same shader program and base primitive type";
+      return false;
+    }
+    return true;
+  }
+
+  BufferObject* buffer = transform_feedback_->GetCaptureBuffer().Get();
+  if (!buffer) {
+    LOG(ERROR) << "***ION: Unable to begin transform feedback: The"
+               << " TransformFeedback has no capture buffer";
+    return false;
+  }
+  BufferResource* br = resource_manager_->GetResource(buffer, this);
+  DCHECK(br);
+  br->Update(this);
+  if (!br->GetId())
+    return false;
+  // The captured data cannot be recreated from the BufferObject's.
+  br->MarkContentsModified();
+  gm->BindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, br->GetId(),
+                      static_cast<GLintptr>(br->GetDataOffset()),
+                      static_cast<GLsizeiptr>(br->GetDataSize()));
+  if (transform_feedback_->IsRasterizerDiscardEnabled())
+    gm->Enable(GL_RASTERIZER_DISCARD);
+  gm->BeginTransformFeedback(primitive_type);
+  is_transform_feedback_active_ = true;
+  transform_feedback_primitive_type_ = primitive_type;
+  transform_feedback_program_ = active_shader_id_;
+  return true;
+}
+
+void Renderer::ResourceBinder::EndTransformFeedbackCapture(
+    GraphicsManager* gm) {
+  if (!is_transform_feedback_active_)
+    return;
+  gm->EndTransformFeedback();
+  if (transform_feedback_->IsRasterizerDiscardEnabled())
+    gm->Disable(GL_RASTERIZER_DISCARD);
+  is_transform_feedback_active_ = false;
+}
+
+void Renderer::ResourceBinder::BindShaderStorageBuffer(
+    GLuint index, const BufferObjectPtr& buffer) {
+  BufferResource* br = NULL;
+  GLuint id = 0U;
+  if (buffer.Get()) {
+    br = resource_manager_->GetResource(buffer.Get(), this);
+    DCHECK(br);
+    br->Update(this);
+    br->MarkUsed();
+    id = br->GetId();
+  }
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  if (id) {
+    gm->BindBufferRange(GL_SHADER_STORAGE_BUFFER, index, id,
+                        static_cast<GLintptr>(br->GetDataOffset()),
+                        static_cast<GLsizeiptr>(br->GetDataSize()));
+  } else {
+    gm->BindBufferBase(GL_SHADER_STORAGE_BUFFER, index, 0U);
+  }
+  if (index >= storage_buffers_.size())
+    storage_buffers_.resize(index + 1U);
+  storage_buffers_[index] = id ? buffer : BufferObjectPtr();
+}
+
+void Renderer::ResourceBinder::BindImageTexture(GLuint unit,
+                                                const TexturePtr& texture,
+                                                GLint level, GLenum access) {
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  GLuint id = 0U;
+  GLenum format = GL_RGBA8;
+  GLboolean layered = GL_FALSE;
+  if (Texture* tex = texture.Get()) {
+    const Image* image = tex->GetImmutableImage().Get();
+    if (!image && tex->HasImage(0U))
+      image = tex->GetImage(0U).Get();
+    if (!image) {
+      LOG(ERROR) << "***ION: Unable to bind texture \"" << tex->GetLabel()
+                 << "\" to image unit " << unit << ": It has no image";
+      return;
+    }
+    format = GetCompatiblePixelFormat(Image::GetPixelFormat(image->GetFormat()),
+                                      gm).internal_format;
+    // All layers of array and 3D textures are bound.
+    layered = image->GetDimensions() == Image::k3d ? GL_TRUE : GL_FALSE;
+    TextureResource* tr = resource_manager_->GetResource(tex, this);
+    DCHECK(tr);
+    tr->Bind(this);
+    id = tr->GetId();
+  }
+  gm->BindImageTexture(unit, id, level, layered, 0, access, format);
+  if (unit >= compute_images_.size())
+    compute_images_.resize(unit + 1U);
+  compute_images_[unit].texture = id ? texture : TexturePtr();
+  compute_images_[unit].is_written = id && access != GL_READ_ONLY;
+}
+
+void Renderer::ResourceBinder::DispatchCompute(
+    const Node& node, const BufferObject* indirect, size_t indirect_offset,
+    GLuint num_groups_x, GLuint num_groups_y, GLuint num_groups_z) {
+  ShaderProgram* program = node.GetShaderProgram().Get();
+  if (!program || !program->IsCompute()) {
+    LOG(ERROR) << "***ION: Unable to dispatch node \"" << node.GetLabel()
+               << "\": It has no compute shader program";
+    return;
+  }
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  // The program may read what earlier dispatches wrote.
+  IssuePendingBarriers(gm);
+
+  PushNodeUniforms(node);
+  ShaderProgramResource* spr = resource_manager_->GetResource(program, this);
+  spr->Bind(this);
+  if (spr->IsDrawable() && spr->GetId()) {
+    bool is_dispatched = true;
+    if (indirect) {
+      BufferResource* br = resource_manager_->GetResource(indirect, this);
+      DCHECK(br);
+      br->Update(this);
+      br->MarkUsed();
+      if (const GLuint id = br->GetId()) {
+        gm->BindBuffer(GL_DISPATCH_INDIRECT_BUFFER, id);
+        gm->DispatchComputeIndirect(
+            static_cast<GLintptr>(br->GetDataOffset() + indirect_offset));
+      } else {
+        is_dispatched = false;
+      }
+    } else {
+      gm->DispatchCompute(num_groups_x, num_groups_y, num_groups_z);
+    }
+
+    if (is_dispatched) {
+      // Storage buffers may be written and then used as any kind of buffer,
+      // and written images may be sampled, rendered into, or read back.
+      static const GLbitfield kStorageBufferBarriers =
+          GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+          GL_ELEMENT_ARRAY_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT |
+          GL_COMMAND_BARRIER_BIT | GL_PIXEL_BUFFER_BARRIER_BIT |
+          GL_BUFFER_UPDATE_BARRIER_BIT;
+      static const GLbitfield kImageBarriers =
+          GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+          GL_TEXTURE_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT;
+      const size_t num_buffers = storage_buffers_.size();
+      for (size_t i = 0; i < num_buffers; ++i) {
+        if (storage_buffers_[i].Get()) {
+          pending_barriers_ |= kStorageBufferBarriers;
+          break;
+        }
+      }
+      const size_t num_images = compute_images_.size();
+      for (size_t i = 0; i < num_images; ++i) {
+        if (compute_images_[i].is_written) {
+          pending_barriers_ |= kImageBarriers;
+          Renderer::SetResourceHolderBit(compute_images_[i].texture.Get(),
+                                         Texture::kContentsImplicitlyChanged);
+        }
+      }
     }
   }
+  PopNodeUniforms(node);
 }
 
 void Renderer::ResourceBinder::BindBuffer(BufferObject::Target target,
@@ -5847,6 +13008,36 @@ void Renderer::ResourceBinder::BindBuffer(BufferObject::Target target,
   }
 }
 
+void Renderer::ResourceBinder::BindUniformBuffer(GLuint binding,
+                                                 BufferResource* resource) {
+  const GLuint id = resource->GetId();
+  if (!id)
+    return;
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  if (binding >= uniform_buffer_bindings_.size()) {
+    const int max_bindings = gm->GetCapabilityValue<int>(
+        GraphicsManager::kMaxUniformBufferBindings);
+    if (binding >= static_cast<GLuint>(std::max(0, max_bindings))) {
+      LOG(ERROR) << "***ION: Unable to bind the buffer of uniform block "
+                 << binding << ", only " << max_bindings
+                 << " uniform buffer bindings are supported";
+      return;
+    }
+    uniform_buffer_bindings_.resize(max_bindings);
+  }
+  const GLsizeiptr size = static_cast<GLsizeiptr>(resource->GetDataSize());
+  UniformBufferBinding& bound = uniform_buffer_bindings_[binding];
+  if (bound.buffer != id || bound.size != size) {
+    bound.buffer = id;
+    bound.size = size;
+    gm->BindBufferRange(GL_UNIFORM_BUFFER, binding, id,
+                        static_cast<GLintptr>(resource->GetDataOffset()), size);
+    // This also binds the buffer to the generic uniform buffer binding point.
+    active_buffers_[BufferObject::kUniformBuffer].buffer = id;
+    active_buffers_[BufferObject::kUniformBuffer].resource = resource;
+  }
+}
+
 void Renderer::ResourceBinder::BindFramebuffer(GLuint id,
                                                FramebufferResource* fbo) {
   if (id != active_framebuffer_) {
@@ -5862,8 +13053,17 @@ bool Renderer::ResourceBinder::BindProgram(GLuint id,
   if (id != active_shader_id_) {
     DCHECK(!resource || id == resource->GetId());
     active_shader_id_ = id;
-    GetGraphicsManager()->UseProgram(id);
     active_shader_resource_ = resource;
+    // OpenGL does not allow calling glUseProgram() during a capture, even
+    // with the program of the capture, which is still in use.
+    if (is_transform_feedback_active_) {
+      if (id == transform_feedback_program_)
+        return true;
+      LOG(ERROR) << "***ION: Ending transform feedback since the shader"
+                 << " program changed";
+      EndTransformFeedbackCapture(GetGraphicsManager().Get());
+    }
+    GetGraphicsManager()->UseProgram(id);
     return true;
   } else {
     return false;
@@ -5885,6 +13085,86 @@ void Renderer::ResourceBinder::BindVertexArray(GLuint id,
   }
 }
 
+void Renderer::ResourceBinder::SetEmulatedVertexAttribPointer(
+    GLuint index, GLuint buffer, GLint size, GLenum type, GLboolean normalized,
+    GLsizei stride, const void* pointer, GLuint divisor) {
+  if (index >= emulated_attribs_.size())
+    emulated_attribs_.resize(index + 1U);
+  EmulatedVertexAttrib& attrib = emulated_attribs_[index];
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  const bool has_divisor =
+      gm->IsFunctionGroupAvailable(GraphicsManager::kInstancedDrawing);
+  if (!attrib.is_valid || attrib.buffer != buffer || attrib.size != size ||
+      attrib.type != type || attrib.normalized != normalized ||
+      attrib.stride != stride || attrib.pointer != pointer) {
+    gm->VertexAttribPointer(index, size, type, normalized, stride, pointer);
+    if (has_divisor)
+      gm->VertexAttribDivisor(index, divisor);
+    attrib.is_valid = true;
+    attrib.buffer = buffer;
+    attrib.size = size;
+    attrib.type = type;
+    attrib.normalized = normalized;
+    attrib.stride = stride;
+    attrib.pointer = pointer;
+    attrib.divisor = divisor;
+  } else if (attrib.divisor != divisor) {
+    if (has_divisor)
+      gm->VertexAttribDivisor(index, divisor);
+    attrib.divisor = divisor;
+  }
+}
+
+void Renderer::ResourceBinder::SetVertexAttribValue(GLuint index, int size,
+                                                   const float* values) {
+  DCHECK_GE(size, 1);
+  DCHECK_LE(size, 4);
+  if (index < kTrackedVertexAttribCount) {
+    const uint64 bit = static_cast<uint64>(1U) << index;
+    VertexAttribValue& value = vertex_attrib_values_[index];
+    const size_t byte_count = static_cast<size_t>(size) * sizeof(float);
+    if ((known_vertex_attrib_values_ & bit) && value.size == size &&
+        !memcmp(value.values, values, byte_count))
+      return;
+    value.size = size;
+    memcpy(value.values, values, byte_count);
+    known_vertex_attrib_values_ |= bit;
+  }
+  GraphicsManager* gm = GetGraphicsManager().Get();
+  switch (size) {
+    case 1:
+      gm->VertexAttrib1fv(index, values);
+      break;
+    case 2:
+      gm->VertexAttrib2fv(index, values);
+      break;
+    case 3:
+      gm->VertexAttrib3fv(index, values);
+      break;
+    default:
+      gm->VertexAttrib4fv(index, values);
+      break;
+  }
+}
+
+void Renderer::ResourceBinder::SetEmulatedVertexAttribEnabled(GLuint index,
+                                                              bool enabled) {
+  if (index >= emulated_attribs_.size())
+    emulated_attribs_.resize(index + 1U);
+  EmulatedVertexAttrib& attrib = emulated_attribs_[index];
+  if (!attrib.is_enabled_valid || attrib.is_enabled != enabled) {
+    GraphicsManager* gm = GetGraphicsManager().Get();
+    if (enabled) {
+      gm->EnableVertexAttribArray(index);
+      ClearVertexAttribValues(index);
+    } else {
+      gm->DisableVertexAttribArray(index);
+    }
+    attrib.is_enabled_valid = true;
+    attrib.is_enabled = enabled;
+  }
+}
+
 void Renderer::ResourceBinder::ActivateUnit(GLuint unit) {
   DCHECK_LT(unit, static_cast<GLuint>(image_units_.size()));
   if (unit != active_image_unit_) {
@@ -5941,6 +13221,7 @@ void Renderer::ResourceBinder::ClearNonFramebufferCachedBindings() {
   }
   active_image_unit_ = static_cast<GLuint>(image_units_.size() + 1U);
   ClearVertexArrayBinding(0U);
+  ClearVertexAttribValues(kInvalidGluint);
 }
 
 const ImagePtr Renderer::ResourceBinder::ReadImage(
@@ -5968,8 +13249,11 @@ const ImagePtr Renderer::ResourceBinder::ReadImage(
   return image;
 }
 
-void Renderer::ResourceBinder::SendUniform(const Uniform& uniform, int location,
-                                           GraphicsManager* gm) {
+void Renderer::ResourceBinder::SendUniformRange(const Uniform& uniform,
+                                                int location, size_t first,
+                                                size_t count,
+                                                GraphicsManager* gm) {
+  DCHECK_LE(first + count, uniform.GetCount());
 #define SEND_VECTOR_UNIFORM(type, elem_type, num_elements, setter)             \
   if (uniform.IsArrayOf<type>()) {                                             \
     /* Check that the values are packed in the uniform data. */                \
@@ -5980,8 +13264,8 @@ void Renderer::ResourceBinder::SendUniform(const Uniform& uniform, int location,
               num_elements);                                                   \
     }                                                                          \
     gm->setter(                                                                \
-        location, static_cast<GLsizei>(uniform.GetCount()),                    \
-        reinterpret_cast<const elem_type*>(&uniform.GetValueAt<type>(0)));     \
+        location + static_cast<GLint>(first), static_cast<GLsizei>(count),     \
+        reinterpret_cast<const elem_type*>(&uniform.GetValueAt<type>(first))); \
   } else {                                                                     \
     gm->setter(location, 1,                                                    \
                reinterpret_cast<const elem_type*>(&uniform.GetValue<type>())); \
@@ -5990,18 +13274,19 @@ void Renderer::ResourceBinder::SendUniform(const Uniform& uniform, int location,
 #define SEND_TEXTURE_UNIFORM(type)                                  \
   /* Get the texture resource from each holder. */                  \
   if (uniform.IsArrayOf<type##Ptr>()) {                             \
-    const size_t count = uniform.GetCount();                        \
+    const size_t num_textures = uniform.GetCount();                 \
     const base::AllocatorPtr& allocator =                           \
         base::AllocationManager::GetDefaultAllocatorForLifetime(    \
             base::kShortTerm);                                      \
     base::AllocVector<GLint> ids(allocator);                        \
-    ids.reserve(count);                                             \
+    ids.reserve(num_textures);                                      \
     /* Each resource holds its own id. */                           \
-    for (size_t i = 0; i < count; ++i)                              \
+    for (size_t i = 0; i < num_textures; ++i)                       \
       if (TextureResource* txr = resource_manager_->GetResource(    \
               uniform.GetValueAt<type##Ptr>(i).Get(), this))        \
         ids.push_back(GetLastBoundUnit(txr));                       \
-    gm->Uniform1iv(location, static_cast<GLsizei>(count), &ids[0]); \
+    gm->Uniform1iv(location, static_cast<GLsizei>(num_textures),    \
+                   &ids[0]);                                        \
   } else if (TextureResource* txr = resource_manager_->GetResource( \
                  uniform.GetValue<type##Ptr>().Get(), this)) {      \
     gm->Uniform1i(location, GetLastBoundUnit(txr));                 \
@@ -6010,8 +13295,8 @@ void Renderer::ResourceBinder::SendUniform(const Uniform& uniform, int location,
 #define SEND_MATRIX_UNIFORM(type, setter)                              \
   if (uniform.IsArrayOf<type>()) {                                     \
     /* We have to transpose each matrix. */                            \
-    const GLint count = static_cast<GLint>(uniform.GetCount());        \
-    for (GLint i = 0; i < count; ++i)                                  \
+    const GLint end = static_cast<GLint>(first + count);               \
+    for (GLint i = static_cast<GLint>(first); i < end; ++i)            \
       gm->setter(location + i, 1, GL_FALSE,                            \
                  math::Transpose(uniform.GetValueAt<type>(i)).Data()); \
   } else {                                                             \
@@ -6105,18 +13390,61 @@ void Renderer::ResourceBinder::PushUniforms(
     ShaderInputRegistryResource* sirr =
         resource_manager_->GetResource(&uniforms[i].GetRegistry(), this);
     sirr->Update(this);
-    sirr->PushUniform(uniforms[i]);
+    PushUniform(sirr, uniforms[i]);
+  }
+}
+
+void Renderer::ResourceBinder::PushUniform(ShaderInputRegistryResource* sirr,
+                                           const Uniform& u) {
+  DCHECK(u.IsValid());
+  const ShaderInputRegistry::UniformSpec* spec =
+      ShaderInputRegistry::GetSpec(u);
+  const size_t index = u.GetIndexInRegistry();
+  const Uniform& top = sirr->GetUniform(index);
+  if (spec->combine_function && top.IsValid()) {
+    // Combine with the previous uniform on top of the stack.
+    Uniform* temp = AcquireTempUniform();
+    *temp = spec->combine_function(top, u);
+    PushUniformEntry(sirr, index, temp);
+  } else {
+    // Merge with the previous uniform on top of the stack - for arrays.
+    Uniform* temp = AcquireTempUniform();
+    if (Uniform::GetMerged(top, u, temp)) {
+      PushUniformEntry(sirr, index, temp);
+    } else {
+      // No need to combine or merge so this is the fast path.
+      --temp_uniform_count_;
+      PushUniformEntry(sirr, index, &u);
+    }
+  }
+  if (spec->generate_function) {
+    // Generate the new Uniforms.
+    std::vector<Uniform> generated =
+        spec->generate_function(sirr->GetUniform(index));
+    const size_t count = generated.size();
+    for (size_t i = 0; i < count; ++i) {
+      const Uniform& gen = generated[i];
+      if (gen.IsValid()) {
+        DCHECK_EQ(&gen.GetRegistry(), &u.GetRegistry());
+        Uniform* temp = AcquireTempUniform();
+        *temp = gen;
+        PushUniformEntry(sirr, gen.GetIndexInRegistry(), temp);
+      }
+    }
   }
 }
 
-void Renderer::ResourceBinder::PopUniforms(
-    const base::AllocVector<Uniform>& uniforms) {
-  const size_t num_uniforms = uniforms.size();
-  for (size_t i = 0; i < num_uniforms; ++i) {
-    ShaderInputRegistryResource* sirr =
-        resource_manager_->GetResource(&uniforms[i].GetRegistry(), this);
-    sirr->PopUniform(uniforms[i]);
-  }
+void Renderer::ResourceBinder::PushUniformEntry(
+    ShaderInputRegistryResource* sirr, size_t index, const Uniform* u) {
+  uniform_stack_registries_.push_back(sirr);
+  uniform_stack_indices_.push_back(index);
+  uniform_stack_previous_.push_back(sirr->SetTop(index, u));
+}
+
+Uniform* Renderer::ResourceBinder::AcquireTempUniform() {
+  if (temp_uniform_count_ == temp_uniforms_.size())
+    temp_uniforms_.push_back(Uniform());
+  return &temp_uniforms_[temp_uniform_count_++];
 }
 
 template <typename HolderType>
@@ -6204,7 +13532,26 @@ Renderer::ResourceManager::GetResource(
 // Specializations to fill data infos with information.
 template <>
 void Renderer::ResourceManager::FillDataFromRenderer(GLuint id,
-                                                     PlatformInfo* info) {}
+                                                     GpuMemoryInfo* info) {
+  for (int i = 0; i < kNumResourceTypes; ++i) {
+    ResourceAccessor accessor(resources_[i]);
+    ResourceVector& resources = accessor.GetResources();
+    const size_t count = resources.size();
+    for (size_t j = 0; j < count; ++j) {
+      if (const size_t used = resources[j]->GetGpuMemoryUsed()) {
+        info->used += used;
+        info->used_by_label[resources[j]->GetHolderLabel()] += used;
+      }
+    }
+  }
+}
+
+template <>
+void Renderer::ResourceManager::FillDataFromRenderer(GLuint id,
+                                                     PlatformInfo* info) {
+  info->program_binary_cache_hits = program_binary_hit_count_.load();
+  info->program_binary_cache_misses = program_binary_miss_count_.load();
+}
 
 template <>
 void Renderer::ResourceManager::FillDataFromRenderer(GLuint id,
@@ -6310,6 +13657,47 @@ template Renderer::TextureResource* Renderer::ResourceManager::GetResource(
 template Renderer::VertexArrayResource* Renderer::ResourceManager::GetResource(
     const AttributeArray*, Renderer::ResourceBinder*, GLuint);
 
+void Renderer::ResourceManager::EndFrame(ResourceBinder* resource_binder) {
+  const size_t budget = gpu_memory_budget_.load();
+  size_t used = GetGpuMemoryUsage(kBufferObject) + GetGpuMemoryUsage(kTexture);
+  if (budget && used > budget) {
+    // Gather the Resources that were not used in this frame and can be
+    // recreated, least recently used first.
+    const uint64 frame = frame_.load();
+    ResourceVector candidates(*this);
+    static const ResourceType kEvictableTypes[] = { kBufferObject, kTexture };
+    for (size_t i = 0; i < ARRAYSIZE(kEvictableTypes); ++i) {
+      ResourceAccessor accessor(resources_[kEvictableTypes[i]]);
+      ResourceVector& resources = accessor.GetResources();
+      const size_t num_resources = resources.size();
+      for (size_t j = 0; j < num_resources; ++j) {
+        Resource* resource = resources[j];
+        if (resource->GetGpuMemoryUsed() &&
+            resource->GetLastUsedFrame() < frame && resource->IsEvictable())
+          candidates.push_back(resource);
+      }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), LeastRecentlyUsed());
+
+    // Evicting a Resource detaches it from its holder, so a new one is
+    // created the next time the holder is used.
+    const size_t num_candidates = candidates.size();
+    for (size_t i = 0; i < num_candidates && used > budget; ++i) {
+      Resource* resource = candidates[i];
+      used -= std::min(used, resource->GetGpuMemoryUsed());
+      if (ResourceGroup* group = resource->GetGroup())
+        group->RemoveResource(resource->GetKey(), resource);
+      DCHECK(resource->GetGroup() == NULL);
+      resource->OnDestroyed();
+    }
+    if (num_candidates)
+      ReleaseAll(resource_binder);
+  }
+  // Delete any objects whose deletion was deferred, including those evicted.
+  object_names_.EndFrame(GetGraphicsManager().Get());
+  ++frame_;
+}
+
 template <typename HolderType>
 void Renderer::ResourceManager::ReleaseResources(
     const HolderType* holder, Renderer::ResourceBinder* binder) {
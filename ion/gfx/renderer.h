@@ -19,7 +19,11 @@ limitations under the License.
 #define ION_GFX_RENDERER_H_
 
 #include <bitset>
+#include <functional>
+#include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "base/integral_types.h"
 #include "ion/base/referent.h"
@@ -29,10 +33,14 @@ limitations under the License.
 #include "ion/gfx/graphicsmanager.h"
 #include "ion/gfx/image.h"
 #include "ion/gfx/node.h"
+#include "ion/gfx/programbinarycache.h"
+#include "ion/gfx/query.h"
 #include "ion/gfx/resourcemanager.h"
 #include "ion/gfx/shaderprogram.h"
 #include "ion/gfx/statetable.h"
+#include "ion/gfx/transformfeedback.h"
 #include "ion/gfx/uniform.h"
+#include "ion/math/matrix.h"
 #include "ion/math/range.h"
 
 namespace ion {
@@ -93,8 +101,184 @@ class ION_API Renderer : public base::Referent {
     kSaveShaderProgram,
     kSaveStateTable,
     kSaveVertexArray,
+
+    // Whether DrawScene() should restore the OpenGL state that it changed, and
+    // only that, when drawing is finished. Unlike the kSave* and kRestore*
+    // flags, nothing is queried from OpenGL: the state before the call is the
+    // state that the Renderer believes OpenGL is in, i.e., its StateTable and
+    // the objects it last bound, and only the settings and bindings that
+    // differ from it afterwards are sent to OpenGL. An application that draws
+    // with Ion inside its own renderer, and so changes the state between
+    // calls, should describe its state with SetHostState() before each call.
+    // As with the kRestore* flags, texture bindings are not restored.
+    kRestoreChangedState,
+
+    // Whether DrawScene() should first flatten the scene into a list of draws
+    // and sort them by shader program, StateTable, textures, and vertex array
+    // before sending them to OpenGL. This can greatly reduce the number of
+    // state changes in scenes that interleave shader programs or textures.
+    // Nodes that need their subtrees drawn in tree order (e.g., for
+    // transparency) can call Node::SetDrawOrderPreserved(); such draws are
+    // emitted after the sorted ones. Clears and enforced StateTables act as
+    // barriers that draws are never sorted across. Each sort starts from the
+    // order of the previous frame, so its cost depends mostly on how many
+    // draws were added or changed rather than on the size of the scene.
+    kSortDrawsByState,
+    // Whether DrawScene() should keep the flattened list of draws for each
+    // root Node across frames and reuse it as long as the structure of the
+    // scene does not change. Uniform and StateTable values are still read from
+    // the Nodes in each frame, so changing them does not require the list to
+    // be rebuilt; adding, removing, replacing, or enabling Nodes, Shapes,
+    // StateTables, shader programs, or UniformBlocks does. This may be
+    // combined with kSortDrawsByState so that sorting is only done when the
+    // list is rebuilt. A rebuild only traverses the subtrees of the children
+    // of the root Node that changed; the draws of the others are reused,
+    // though the whole list is still merged and sorted again. Note that the
+    // list stores only the draws and their Nodes: the Uniforms of each draw's
+    // Nodes are still pushed and resolved when it is drawn, as in tree order,
+    // so this saves the traversal but not the per-draw uniform work.
+    kRetainDrawList,
+    // Whether all Texture and CubeMapTexture image data should be uploaded
+    // through a ring of pixel unpack buffers owned by the Renderer instead of
+    // directly from client memory. This can also be enabled for individual
+    // textures with TextureBase::SetPixelBufferStreamingEnabled(). It has no
+    // effect if pixel buffer objects are not supported.
+    kStreamTexturesThroughPixelBuffers,
+    // Whether the data of array BufferObjects with kStreamDraw usage should be
+    // kept in persistently mapped storage holding several copies of the data.
+    // Each time the data changes it is copied into the next copy instead of
+    // reallocating the OpenGL buffer, waiting on a fence only if OpenGL may
+    // still be reading that copy from a recent frame; a fence is inserted at
+    // the end of each DrawScene() that used the storage. This requires buffer
+    // storage, MapBufferRange, and sync object support, and has no effect
+    // otherwise.
+    kPersistentlyMapStreamBuffers,
+    // Whether changed shader programs should be compiled and linked without
+    // waiting for OpenGL to finish, so that introducing or editing many
+    // programs does not stall a frame. Compilation of all programs drawn in a
+    // frame starts at once, and is checked for completion each time they are
+    // drawn again, without blocking if KHR_parallel_shader_compile is
+    // supported. Shapes are not drawn with a program until it has first been
+    // linked; after that, the previous version is drawn with until a new one
+    // has been linked.
+    kCompileShadersAsynchronously,
+    // Whether AttributeArrays whose enabled buffer attributes have identical
+    // layouts, i.e., the same buffers, formats, strides, offsets, divisors,
+    // and attribute indices, should share a single vertex array object, so
+    // that many small Shapes drawn from the same buffers do not each create
+    // and bind their own. Changing an AttributeArray moves it to the vertex
+    // array for its new layout. When vertex arrays are emulated, attribute
+    // pointers that are already set as needed are not sent again.
+    kShareVertexArrays,
+    // Whether the GPU time spent drawing each Node that has a label, together
+    // with its subtree, should be measured with OpenGL timestamp queries. The
+    // queries of a call to DrawScene() are only read by a later call, once
+    // OpenGL has finished them, so measuring never stalls. At most two calls
+    // are measured at a time; calls made while both are still pending are not
+    // measured. The times are returned by GetNodeGpuTimes(). This requires
+    // timer query support and has no effect on scenes that are drawn from a
+    // draw list, i.e., with kSortDrawsByState, kRetainDrawList, or
+    // kSortDrawsByRenderPass.
+    kProfileLabeledNodeGpuTime,
+    // Whether Textures, CubeMapTextures, and Samplers that have changed since
+    // they were last updated should be updated together at the start of
+    // DrawScene(), from a list that each one is added to when it first
+    // changes, rather than when each is found to have changed while drawing.
+    // This keeps uploads out of the draw traversal and updates changed objects
+    // even if they are not drawn in the frame. Changed objects are still
+    // updated while drawing if the list is not processed, e.g., while
+    // asynchronous uploads are pending.
+    kBatchResourceUpdates,
+    // Whether the storage of each Texture that has a dense or array image
+    // should be allocated for all of its mipmap levels at once with
+    // TexStorage, with the images then uploaded into it, instead of being
+    // allocated level by level with TexImage, which makes some drivers
+    // reallocate the texture as each level arrives. A full mipmap pyramid is
+    // allocated if the Texture has more than one image or its Sampler
+    // generates mipmaps, and level 0 alone otherwise. Since immutable storage
+    // cannot change, the OpenGL texture object is replaced when the size or
+    // format of the level 0 image or the number of levels changes, discarding
+    // any sub-images. This has no effect on CubeMapTextures, multisampled
+    // Textures, Textures that already have an immutable image, or if texture
+    // storage is not supported.
+    kUseImmutableTextureStorage,
+    // Whether Textures that use immutable storage (see above) and have images
+    // for their full mipmap pyramid should upload one level per frame,
+    // starting with the smallest, instead of all levels at once. The base
+    // level of the texture is raised to the finest level uploaded so far, so
+    // the texture can be drawn as soon as its smallest level is uploaded and
+    // becomes sharper over the following frames. This requires OpenGL ES 3.0
+    // or desktop OpenGL 3.0 and has no effect otherwise.
+    kStreamMipmapsLowestResolutionFirst,
+    // Whether DrawScene() should flatten the scene into a list of draws and
+    // group them by the render passes of their Nodes (see
+    // Node::SetRenderPass()). Between each pair of barriers (see
+    // kSortDrawsByState), draws whose Nodes inherit their pass come first,
+    // followed by the opaque, transparent, and overlay passes. Opaque draws
+    // are sorted front to back, so that the depth test rejects the hidden
+    // fragments of later draws, and transparent draws back to front, so that
+    // they blend correctly. Their depth is that of the center of their Node's
+    // bounds (see Node::SetBounds()) under the culling matrix (see
+    // SetCullingMatrix()); draws of Nodes without bounds are treated as
+    // infinitely far away. Without a culling matrix, and in the other passes,
+    // draws keep their tree order, or are sorted by state if
+    // kSortDrawsByState is also set.
+    kSortDrawsByRenderPass,
+    // Whether the draws of the opaque pass should first be drawn into the
+    // depth buffer alone, with color writes disabled and with the depth-only
+    // variants of their shader programs (see
+    // ShaderProgram::SetDepthOnlyVariant()). The opaque pass is then drawn
+    // with depth writes disabled and a less-or-equal depth test, so that each
+    // pixel is shaded only once, which reduces overdraw in fill-bound scenes.
+    // Both draws enable the depth test, overriding the depth test, depth
+    // function, and depth write settings of the opaque Nodes, so the
+    // framebuffer must have a depth buffer. Other draws that do not set these
+    // values get their OpenGL defaults. This only has an effect when
+    // kSortDrawsByRenderPass is set.
+    kDepthPrepass,
+    // Whether Samplers with identical effective state, i.e., the same
+    // filters, wrap modes, comparison, level of detail range, and anisotropy
+    // after clamping to what OpenGL supports, should share a single sampler
+    // object, so that many Samplers with the same settings do not each create
+    // their own, and binding a texture whose Sampler has the same state as
+    // the one already bound to its image unit does not rebind it. Changing a
+    // Sampler moves it to the sampler object for its new state. This only has
+    // an effect if sampler objects are supported.
+    kShareSamplers,
+    // Whether the CPU time spent traversing each Node that has a label,
+    // together with its subtree, should be measured, along with counts of the
+    // work done for it: Uniform values sent, state changes, draws, and
+    // resource updates. Unlike GPU times, these are available as soon as
+    // DrawScene() returns and are returned by GetNodeCpuTimes(). This has no
+    // effect on scenes that are drawn from a draw list, i.e., with
+    // kSortDrawsByState, kRetainDrawList, or kSortDrawsByRenderPass.
+    kProfileLabeledNodeCpuTime,
+    // Whether the transparent pass (see kSortDrawsByRenderPass) should be
+    // drawn with weighted blended order-independent transparency instead of
+    // back to front. Its draws are then not sorted by depth, and are sorted by
+    // state if kSortDrawsByState is set. Each run of transparent draws is
+    // drawn twice, since a FramebufferObject has a single color attachment:
+    // first into an RGBA16F accumulation target with additive blending, and
+    // then with the revealage variants of the shader programs (see
+    // ShaderProgram::SetRevealageVariant()) into an R8 revealage target that
+    // multiplies by one minus the source alpha. The targets are then
+    // composited over the framebuffer being drawn into. The shader programs of
+    // transparent draws must therefore write their weighted, premultiplied
+    // color, i.e., vec4(color.rgb * color.a, color.a) * weight, where the
+    // weight typically decreases with depth. The depth buffer of the
+    // framebuffer is copied into the targets so that transparent draws are
+    // occluded by opaque ones; a default framebuffer must have a 24-bit depth
+    // and 8-bit stencil buffer, and a FramebufferObject with a depth texture
+    // shares it with the targets instead. Depth writes are disabled and
+    // blending is enabled for transparent draws, overriding their settings;
+    // other draws that do not set these values get their OpenGL defaults.
+    // Drawing into the targets requires support for framebuffer blits and
+    // half float color buffers; without either, the transparent pass is
+    // drawn back to front as usual. This has no effect unless
+    // kSortDrawsByRenderPass is set.
+    kOrderIndependentTransparency,
   };
-  static const int kNumFlags = kSaveVertexArray + 1;
+  static const int kNumFlags = kOrderIndependentTransparency + 1;
   typedef std::bitset<kNumFlags> Flags;
 
   // The types of resources created by the renderer.
@@ -120,6 +304,128 @@ class ION_API Renderer : public base::Referent {
     kWriteOnly
   };
 
+  // An ImageReadback is returned by ReadImageAsync(). Its image becomes
+  // available once OpenGL has finished reading the pixels, which the Renderer
+  // checks, without waiting, at the end of each call to DrawScene() and in
+  // ProcessImageReadbacks(). It should only be used on the thread that renders
+  // with the Renderer.
+  class ION_API ImageReadback : public base::Referent {
+   public:
+    ImageReadback() : is_ready_(false) {}
+
+    // Returns whether the image is available.
+    bool IsReady() const { return is_ready_; }
+    // Returns the image, or a NULL pointer if it is not yet available.
+    const ImagePtr& GetImage() const { return image_; }
+
+   protected:
+    // The destructor is protected because all base::Referent classes must
+    // have protected or private destructors.
+    ~ImageReadback() override {}
+
+   private:
+    void SetImage(const ImagePtr& image) {
+      image_ = image;
+      is_ready_ = true;
+    }
+
+    ImagePtr image_;
+    bool is_ready_;
+
+    friend class Renderer;
+  };
+  typedef base::ReferentPtr<ImageReadback>::Type ImageReadbackPtr;
+
+  // The GPU times measured for the labeled Nodes drawn by one call to
+  // DrawScene() when kProfileLabeledNodeGpuTime is set.
+  struct NodeGpuTimes {
+    // A labeled Node that was drawn.
+    struct Scope {
+      Scope() : depth(0U), begin_ns(0U), end_ns(0U) {}
+      // The labels of the Node's labeled ancestors and of the Node itself,
+      // separated by '/'.
+      std::string path;
+      // The number of labeled ancestors of the Node.
+      size_t depth;
+      // The GPU timestamps, in nanoseconds, at which drawing the Node and its
+      // subtree started and ended.
+      uint64 begin_ns;
+      uint64 end_ns;
+    };
+
+    NodeGpuTimes() : frame(0U) {}
+
+    // The number of the call to DrawScene() the times were measured in,
+    // counting the calls made with kProfileLabeledNodeGpuTime set from 1.
+    uint64 frame;
+    // The drawn Nodes in the order they were drawn, so that a Scope is
+    // followed by those of its labeled descendants.
+    std::vector<Scope> scopes;
+    // The total time spent drawing the Nodes with each path, which may have
+    // been drawn more than once.
+    std::map<std::string, uint64> total_ns;
+  };
+  // A function that is called with the times of each measured call to
+  // DrawScene() once they are available.
+  typedef std::function<void(const NodeGpuTimes& times)> NodeGpuTimesCallback;
+
+  // The CPU times and work counts measured for the labeled Nodes drawn by one
+  // call to DrawScene() when kProfileLabeledNodeCpuTime is set.
+  struct NodeCpuTimes {
+    // The work done while drawing a Node and its subtree.
+    struct Counts {
+      Counts()
+          : uniforms(0U), state_changes(0U), draws(0U), resource_updates(0U) {}
+      Counts& operator+=(const Counts& other) {
+        uniforms += other.uniforms;
+        state_changes += other.state_changes;
+        draws += other.draws;
+        resource_updates += other.resource_updates;
+        return *this;
+      }
+      // The number of Uniform values sent to OpenGL.
+      uint64 uniforms;
+      // The number of times the OpenGL state was updated from a StateTable.
+      uint64 state_changes;
+      // The number of Shapes drawn.
+      uint64 draws;
+      // The number of OpenGL objects created or updated, such as buffer
+      // uploads, texture uploads, and shader compiles.
+      uint64 resource_updates;
+    };
+    // A labeled Node that was drawn.
+    struct Scope {
+      Scope() : depth(0U), begin_ns(0U), end_ns(0U) {}
+      // The labels of the Node's labeled ancestors and of the Node itself,
+      // separated by '/'.
+      std::string path;
+      // The number of labeled ancestors of the Node.
+      size_t depth;
+      // The times, in nanoseconds of port::Timer::Clock, at which drawing the
+      // Node and its subtree started and ended.
+      uint64 begin_ns;
+      uint64 end_ns;
+      // The work done for the Node and its subtree.
+      Counts counts;
+    };
+
+    NodeCpuTimes() : frame(0U) {}
+
+    // The number of the call to DrawScene() the times were measured in,
+    // counting the calls made with kProfileLabeledNodeCpuTime set from 1.
+    uint64 frame;
+    // The drawn Nodes in the order they were drawn, so that a Scope is
+    // followed by those of its labeled descendants.
+    std::vector<Scope> scopes;
+    // The total time spent and work done drawing the Nodes with each path,
+    // which may have been drawn more than once.
+    std::map<std::string, uint64> total_ns;
+    std::map<std::string, Counts> total_counts;
+  };
+  // A function that is called with the times of each measured call to
+  // DrawScene() before it returns.
+  typedef std::function<void(const NodeCpuTimes& times)> NodeCpuTimesCallback;
+
   // The constructor is passed a GraphicsManager instance to use for rendering.
   explicit Renderer(const GraphicsManagerPtr& gm);
 
@@ -151,6 +457,53 @@ class ION_API Renderer : public base::Referent {
   // store a strong reference to the framebuffer.
   void BindFramebuffer(const FramebufferObjectPtr& fbo);
 
+  // Starts capturing the vertex shader outputs of the Shapes drawn by later
+  // calls to DrawScene() into the capture buffer of the passed
+  // TransformFeedback, until EndTransformFeedback() is called. The shader
+  // programs drawn with must name the outputs with
+  // ShaderProgram::SetCapturedVaryings(). All Shapes drawn during a capture
+  // must use the same ShaderProgram and the same base primitive type (points,
+  // lines, or triangles); others are not drawn. OpenGL ES 3.0 also does not
+  // allow drawing Shapes with an IndexBuffer during a capture. A later draw
+  // that reads the buffer, such as the next step of a simulation that
+  // alternates between two buffers, sees the captured vertices. Logs an error
+  // if transform feedback is not supported. Like BindFramebuffer(), this
+  // applies to the current Visual or GL context.
+  void BeginTransformFeedback(const TransformFeedbackPtr& feedback);
+  // Ends the capture started by BeginTransformFeedback(), if any.
+  void EndTransformFeedback();
+
+  // Runs the compute ShaderProgram of the passed Node (see
+  // ShaderProgram::SetComputeShader()) in a grid of the passed numbers of
+  // work groups, with the Uniforms and UniformBlocks of the Node. The Node's
+  // Shapes and children are ignored. The program reads and writes the
+  // BufferObjects and Textures bound with BindShaderStorageBuffer() and
+  // BindImageTexture(); the memory barriers that later dispatches, draws and
+  // buffer mappings need to see what it wrote are issued before they are
+  // made. Logs an error if compute shaders are not supported or the Node has
+  // no compute program. Like BindFramebuffer(), this applies to the current
+  // Visual or GL context.
+  void DispatchCompute(const NodePtr& node, uint32 num_groups_x,
+                       uint32 num_groups_y, uint32 num_groups_z);
+  // Like DispatchCompute(), but reads the three numbers of work groups from
+  // the passed BufferObject at the passed byte offset, so that they can be
+  // computed by an earlier dispatch.
+  void DispatchComputeIndirect(const NodePtr& node,
+                               const BufferObjectPtr& buffer, size_t offset);
+  // Binds the passed BufferObject, uploading it first if needed, to the
+  // passed shader storage buffer binding point for the compute programs run
+  // by later dispatches. A NULL BufferObject unbinds the binding point. The
+  // Renderer keeps a reference to the BufferObject while it is bound.
+  void BindShaderStorageBuffer(uint32 index, const BufferObjectPtr& buffer);
+  // Binds the passed mipmap level of the passed Texture, which should have
+  // an immutable image with a sized format such as Image::kRgba8, to the
+  // passed image unit for the compute programs run by later dispatches, which
+  // access it as for mapped buffers. Textures bound with write access are
+  // marked as implicitly changed by each dispatch. A NULL Texture unbinds the
+  // image unit.
+  void BindImageTexture(uint32 unit, const TexturePtr& texture, int level,
+                        BufferObjectDataMapMode access);
+
   // Returns the currently bound FramebufferObject. Note that this is related to
   // the currently bound Visual or GL context, not simply the Renderer instance
   // the function is called on. A return value of NULL indicates that either no
@@ -194,10 +547,67 @@ class ION_API Renderer : public base::Referent {
   // Traverses the scene rooted by the given node and creates or updates
   // resources for ShaderPrograms, Textures, and Shapes that require it. Any
   // disabled subtrees are skipped.
+  //
+  // The overloads taking a Node or Shape reference only borrow the passed
+  // object, which avoids touching its reference count; the caller must keep
+  // it alive during the call.
   void CreateOrUpdateResources(const NodePtr& node);
+  void CreateOrUpdateResources(const Node& node);
   // Creates or updates any resources necessary to draw the passed Shape, i.e.,
   // buffer data is uploaded.
   void CreateOrUpdateShapeResources(const ShapePtr& shape);
+  void CreateOrUpdateShapeResources(const Shape& shape);
+
+  // A function called when all resources of a scene passed to
+  // PrepareResources() have been created.
+  typedef std::function<void(const NodePtr& node)> ResourcesPreparedCallback;
+  // Queues the scene rooted by node for the creation of the same resources as
+  // CreateOrUpdateResources(), but spread over several frames so that a newly
+  // loaded scene does not cause a hitch the first time it is drawn. Each call
+  // to DrawScene() and to ProcessResourcePreparation() creates resources within
+  // the preparation budgets, from the scenes with the highest priority first,
+  // and those with equal priorities in the order they were queued. Once all
+  // resources of a scene have been created, callback, which may be empty, is
+  // called on the rendering thread with node, after which the scene can be
+  // revealed. The Nodes, Shapes, and resources to create are collected when
+  // the scene is queued, and are kept alive until they are prepared.
+  void PrepareResources(const NodePtr& node, int priority,
+                        const ResourcesPreparedCallback& callback);
+  // Like PrepareResources(), but creates the resources of the Nodes that
+  // DrawScene() would draw, i.e., those accepted by the NodeVisibilityFunction
+  // and inside the culling frustum, before those of the rest of the scene. This
+  // is meant for restoring a scene after AbandonAllResources() without
+  // stalling on recreating every resource in the first DrawScene(); what is
+  // in view is ready first, and the rest follows within the preparation
+  // budgets. Resources are recreated from the data
+  // kept by their holders, and programs from the ProgramBinaryCache, if one is
+  // set. Holders whose data was wiped after uploading cannot be restored, and
+  // must have their data set again. It can be canceled with
+  // CancelResourcePreparation().
+  void RestoreResources(const NodePtr& node, int priority,
+                        const ResourcesPreparedCallback& callback);
+  // Removes a scene queued with PrepareResources(), for example if it is no
+  // longer needed. Its callback is not called. Does nothing if node is not
+  // queued.
+  void CancelResourcePreparation(const NodePtr& node);
+  // Creates queued resources within the preparation budgets. This is called at
+  // the end of each DrawScene(), and only needs to be called directly in frames
+  // where nothing is drawn.
+  void ProcessResourcePreparation();
+  // Returns the number of scenes queued with PrepareResources() that are not
+  // fully prepared.
+  size_t GetPendingResourcePreparationCount() const;
+  // Sets/returns the budgets for each call to ProcessResourcePreparation(): the
+  // time in microseconds spent creating resources, and the number of bytes of
+  // buffer and texture data uploaded. Resources are created one at a time
+  // until either budget is used up, so the last one may exceed it; at least
+  // one is created per call. Note that compiling shaders uploads no data, so
+  // only the time budget limits it. A budget of 0, the default for both,
+  // disables that limit; with no limits, all queued resources are created in
+  // one call.
+  void SetResourcePreparationBudget(uint64 microseconds, size_t bytes);
+  uint64 GetResourcePreparationTimeBudget() const;
+  size_t GetResourcePreparationByteBudget() const;
 
   // Mark an object for a forced update of GL resources. Calling this function
   // is equivalent to modifying the object and then reverting it back to the
@@ -208,9 +618,11 @@ class ION_API Renderer : public base::Referent {
   // Mark the passed object and its descendants for a forced resource update
   // the next time CreateOrUpdateResources or DrawScene is called.
   void RequestForcedUpdates(const NodePtr& node);
+  void RequestForcedUpdates(const Node& node);
   // Mark a shape's resources for a forced update the next time
   // CreateOrUpdateResources or DrawScene is called.
   void RequestForcedShapeUpdates(const ShapePtr& shape);
+  void RequestForcedShapeUpdates(const Shape& shape);
 
   // Immediately updates OpenGL state with the settings in the passed
   // StateTable. Note that if the passed StateTable has a clear color, depth, or
@@ -234,15 +646,104 @@ class ION_API Renderer : public base::Referent {
 
   // Resolve a multisampled framebuffer 'ms_fbo' into a single sampled
   // framebuffer 'dest_fbo'. Caller is responsible to make sure ms_fbo and
-  // dest_fbo are compatible for resolving.
+  // dest_fbo are compatible for resolving. On tile-based GPUs it is cheaper to
+  // render to a texture Attachment created with
+  // FramebufferObject::Attachment::CreateMultisampledTexture(), which needs no
+  // separate multisampled framebuffer or resolve.
   void ResolveMultisampleFramebuffer(const FramebufferObjectPtr& ms_fbo,
                                      const FramebufferObjectPtr& dest_fbo);
 
   // Draws the scene rooted by the given node into the currently bound
   // framebuffer.
   virtual void DrawScene(const NodePtr& node);
+
+  // A function called with the index of a view before the scene is drawn into
+  // it by DrawSceneInVisuals().
+  typedef std::function<void(size_t view_index)> ViewFunction;
+  // Draws the scene rooted by the given node into the currently bound
+  // framebuffer of each of the passed Visuals in turn, for example the windows
+  // of several views of the same scene. The Visuals must share resources with
+  // the Visual the Renderer was created in. Each Visual keeps its own binding
+  // state, but the scene is traversed only once, into a DrawList retained as
+  // with kRetainDrawList that every view is drawn from, and resources are
+  // released, created, and updated only once. If before_view is set it is
+  // called before each view is drawn, while its Visual is current, which
+  // allows setting per-view Uniform values such as projection matrices. The
+  // Visual that was current before the call is made current again. The GPU
+  // times of labeled Nodes are not measured.
+  void DrawSceneInVisuals(const NodePtr& node,
+                          const std::vector<const portgfx::Visual*>& visuals,
+                          const ViewFunction& before_view);
+
+  // A function that returns whether a Node and its subgraph should be drawn.
+  typedef std::function<bool(const Node& node)> NodeVisibilityFunction;
+  // Sets a function that DrawScene() calls for each enabled Node to determine
+  // whether to draw it, e.g., to cull Nodes against a view frustum. When the
+  // scene is flattened into a draw list (see kSortDrawsByState) the function
+  // may be called from several threads at once (see SetDrawListThreadCount()),
+  // so it must be thread-safe and must not modify the scene. Since visibility
+  // usually changes every frame, draw lists are not retained across frames
+  // while a visibility function is set. Pass an empty function to clear it.
+  void SetNodeVisibilityFunction(const NodeVisibilityFunction& func) {
+    visibility_function_ = func;
+  }
+  const NodeVisibilityFunction& GetNodeVisibilityFunction() const {
+    return visibility_function_;
+  }
+
+  // Sets a matrix that transforms the scene's coordinate system into clip
+  // coordinates, usually the product of the projection and view matrices.
+  // While it is set, DrawScene() skips any Node whose subgraph bounds (see
+  // Node::GetSubgraphBounds()) lie entirely outside of the resulting view
+  // frustum, in addition to any Nodes rejected by the visibility function.
+  // Nodes whose subgraphs are unbounded or empty are never culled. The matrix
+  // also selects which Nodes with a level-of-detail range are drawn (see
+  // Node::SetLodRange()). It is usually set before each call to DrawScene().
+  void SetCullingMatrix(const math::Matrix4f& clip_from_scene) {
+    culling_matrix_ = clip_from_scene;
+    has_culling_matrix_ = true;
+  }
+  void ClearCullingMatrix() { has_culling_matrix_ = false; }
+  bool HasCullingMatrix() const { return has_culling_matrix_; }
+  const math::Matrix4f& GetCullingMatrix() const { return culling_matrix_; }
+
+  // Sets the number of worker threads used to flatten the scene into a draw
+  // list (see kSortDrawsByState and kRetainDrawList). The subgraphs of the
+  // children of the root Node are distributed among the workers and the
+  // thread calling DrawScene(); Uniforms are still resolved and all OpenGL
+  // calls are still made on the calling thread. The scene must not be modified
+  // during DrawScene(). The default of 0 flattens the scene on the calling
+  // thread only.
+  void SetDrawListThreadCount(size_t count);
+  size_t GetDrawListThreadCount() const;
+
+  // Starts a thread that uploads the resources passed to UploadResourceAsync()
+  // using the passed Visual, which must share resources with the Visuals this
+  // Renderer draws with (see Visual::CreateVisualInCurrentShareGroup()) and
+  // must outlive the uploads. Uploads queued before this is called wait until
+  // it is.
+  void StartAsyncUploads(const portgfx::Visual* upload_visual);
+  // Stops the upload thread once the upload in progress, if any, finishes.
+  // Queued uploads remain pending until StartAsyncUploads() is called again.
+  void StopAsyncUploads();
+  // Queues the resource of the passed holder to be created or updated on the
+  // upload thread. T must be BufferObject, IndexBuffer, Texture, or
+  // CubeMapTexture. Until the upload is finished, including on the GPU,
+  // DrawScene() skips Shapes that use a pending buffer and Nodes (and their
+  // subgraphs) whose Uniforms reference a pending texture. This must be called
+  // on the thread that calls DrawScene(), and the holder must not be modified
+  // while its upload is pending.
+  template <typename T>
+  void UploadResourceAsync(T* holder);
+  // Returns whether the passed holder has an upload pending.
+  bool IsUploadPending(const ResourceHolder* holder) const;
+  // Blocks until all queued uploads have finished. This returns immediately
+  // if the upload thread is not running.
+  void WaitForAsyncUploads();
+
   // Process any outstanding requests for information about internal resources
-  // that have been made through this Renderer's ResourceManager.
+  // that have been made through this Renderer's ResourceManager. This
+  // processes all of them regardless of the info request budget.
   void ProcessResourceInfoRequests();
 
   // Returns the OpenGL ID for the passed resource. A new resource will be
@@ -319,6 +820,40 @@ class ION_API Renderer : public base::Referent {
   // state of OpenGL.
   const StateTable& GetStateTable() const;
 
+  // The OpenGL state of an application that draws with Ion inside its own
+  // renderer, as tracked by the application; see SetHostState().
+  struct HostState {
+    HostState()
+        : active_texture(GL_TEXTURE0),
+          array_buffer(0U),
+          element_array_buffer(0U),
+          framebuffer(0U),
+          shader_program(0U),
+          vertex_array(0U),
+          textures_changed(true) {}
+    // The capabilities and values. If this is NULL, the Renderer's
+    // StateTable is kept.
+    StateTablePtr state_table;
+    // The active image unit, e.g., GL_TEXTURE0.
+    GLenum active_texture;
+    // The ids of the bound objects.
+    GLuint array_buffer;
+    GLuint element_array_buffer;
+    GLuint framebuffer;
+    GLuint shader_program;
+    GLuint vertex_array;
+    // Whether textures or samplers may have been bound since Ion last drew,
+    // in which case all of them are rebound when they are next used.
+    bool textures_changed;
+  };
+
+  // Tells the Renderer what the current OpenGL state is without querying
+  // OpenGL, e.g., from the snapshot that a host renderer keeps of its own
+  // state. This is much cheaper than UpdateStateFromOpenGL() or the kSave*
+  // flags. With kRestoreChangedState, DrawScene() then restores exactly this
+  // state when it is finished.
+  void SetHostState(const HostState& state);
+
   // Updates the system default framebuffer to whatever framebuffer is currently
   // bound. This allows applications to create new system framebuffers as needed
   // and notify Ion that the default framebuffer has changed.
@@ -337,6 +872,64 @@ class ION_API Renderer : public base::Referent {
   // Allocator is used when creating the Image.
   const ImagePtr ReadImage(const math::Range2i& range, Image::Format format,
                            const base::AllocatorPtr& allocator);
+  // Like ReadImage(), but does not wait for OpenGL to finish rendering. The
+  // pixels are read into a pixel pack buffer, and the image is delivered
+  // through the returned ImageReadback, typically a frame or two later. If
+  // OpenGL does not support pixel pack buffers and fences, the pixels are
+  // read immediately and the returned ImageReadback is already ready.
+  const ImageReadbackPtr ReadImageAsync(const math::Range2i& range,
+                                        Image::Format format,
+                                        const base::AllocatorPtr& allocator);
+  // Delivers the images of all asynchronous reads that OpenGL has finished.
+  // If wait is true, this first waits for all of them to finish.
+  void ProcessImageReadbacks(bool wait);
+
+  // Returns whether Queries of the passed type are supported on this
+  // platform.
+  bool IsQuerySupported(Query::Type type) const;
+  // Starts measuring the draws made until the matching call to EndQuery()
+  // with query. Only one Query of each type can be active at a time, and a
+  // pending Query cannot be started again; these and unsupported types log an
+  // error and are ignored. Note that Nodes with occlusion queries are not
+  // measured while a Query of the same type is active.
+  void BeginQuery(const QueryPtr& query);
+  // Stops measuring query, whose result is delivered once OpenGL has computed
+  // it. Logs an error if query is not active.
+  void EndQuery(const QueryPtr& query);
+  // Delivers the results of all Queries that OpenGL has finished. If wait is
+  // true, this first waits for all of them to finish.
+  void ProcessQueries(bool wait);
+  // Makes the draws until the matching call to EndConditionalRender() depend
+  // on the result of query, which must count samples, so that an object whose
+  // bounding box was hidden last frame can be skipped. Returns false if the
+  // draws should be skipped entirely because the delivered result is 0. If
+  // the result is still pending, OpenGL discards the draws itself when no
+  // samples passed, waiting for the result first if wait is true; on
+  // platforms without conditional rendering the draws are always made.
+  bool BeginConditionalRender(const QueryPtr& query, bool wait);
+  // Ends conditional rendering. Does nothing if it is not active.
+  void EndConditionalRender();
+
+  // Returns the GPU times of the labeled Nodes drawn by the most recent call
+  // to DrawScene() whose timer queries have finished, when
+  // kProfileLabeledNodeGpuTime is set. The times are empty until the first
+  // ones are available.
+  const NodeGpuTimes& GetNodeGpuTimes() const { return node_gpu_times_; }
+  // Sets a function that is called from DrawScene() with the times of each
+  // earlier call once they are available, for example to add them to a
+  // trace. The default is an empty function.
+  void SetNodeGpuTimesCallback(const NodeGpuTimesCallback& callback) {
+    node_gpu_times_callback_ = callback;
+  }
+  // Returns the CPU times of the labeled Nodes drawn by the most recent call
+  // to DrawScene() that measured them, when kProfileLabeledNodeCpuTime is set.
+  const NodeCpuTimes& GetNodeCpuTimes() const { return node_cpu_times_; }
+  // Sets a function that is called at the end of each call to DrawScene()
+  // that measured CPU times, with those times. The default is an empty
+  // function.
+  void SetNodeCpuTimesCallback(const NodeCpuTimesCallback& callback) {
+    node_cpu_times_callback_ = callback;
+  }
 
   // In non-production builds, pushes |marker| onto the Renderer's tracing
   // stream marker stack, outputting the marker and indenting all calls until
@@ -354,6 +947,17 @@ class ION_API Renderer : public base::Referent {
   // Immediately clears all internal resources of the Renderer.
   void ClearAllResources();
 
+  // Forgets all internal resources of the Renderer without making any OpenGL
+  // calls, for use after the OpenGL context has been lost, e.g., when an
+  // Android app returns from the background. Unlike ClearAllResources(), this
+  // does not try to delete objects that no longer exist. Asynchronous uploads
+  // are stopped, and must be started again with a Visual sharing the new
+  // context. The Renderer assumes that the new context has the default state
+  // and nothing bound. Scenes queued with PrepareResources() or
+  // RestoreResources() start over, and other scenes can be queued with
+  // RestoreResources() to recreate their resources over several frames.
+  void AbandonAllResources();
+
   // Immediately releases all internal resources of the Renderer which are
   // pending release.
   void ReleaseResources();
@@ -375,6 +979,112 @@ class ION_API Renderer : public base::Referent {
   // considered to use GPU memory.
   size_t GetGpuMemoryUsage(ResourceType type) const;
 
+  // Sets/returns a budget, in bytes, for the GPU memory used by BufferObjects
+  // and (CubeMap)Textures. When they use more than the budget at the end of a
+  // call to DrawScene(), the least recently used ones that the call did not
+  // draw with are evicted until the rest fit. Evicting releases the OpenGL
+  // object but keeps the holder's data, so the resource is recreated the next
+  // time it is used. Only resources whose data is still available can be
+  // evicted; those with wiped DataContainers, or whose contents were changed
+  // by sub-data or sub-image updates, mapping, or rendering, are kept. A
+  // budget of 0, the default, disables eviction.
+  void SetGpuMemoryBudget(size_t budget);
+  size_t GetGpuMemoryBudget() const;
+
+  // Sets/returns the number of OpenGL buffer and texture names generated by
+  // each glGenBuffers() or glGenTextures() call. The names that are not used
+  // right away are kept for later resources, which saves calls when many are
+  // created at once, such as when a large scene is loaded. The default is 1.
+  void SetObjectNameBatchSize(size_t count);
+  size_t GetObjectNameBatchSize() const;
+  // Sets whether the OpenGL buffers and textures of released resources are
+  // deleted with batched glDeleteBuffers() and glDeleteTextures() calls at
+  // the end of the next call to DrawScene() rather than one at a time as they
+  // are released, and the most objects deleted by each DrawScene(); the rest
+  // are kept for later calls. This spreads the cost of dropping a large scene
+  // over several frames. A limit of 0 deletes all queued objects in each call.
+  // All queued objects are deleted when the Renderer is destroyed. Deletion
+  // is not deferred by default.
+  void SetDeferredObjectDeletion(bool defer, size_t deletions_per_frame);
+  bool IsObjectDeletionDeferred() const;
+  // Returns the number of objects waiting to be deleted.
+  size_t GetPendingObjectDeletionCount() const;
+
+  // Sets/returns a budget, in microseconds, for the time each call to
+  // DrawScene() spends processing info requests, such as those made by remote
+  // handlers. Requests are processed in order until the budget is used up, and
+  // the rest are kept for later frames; at least one request is processed per
+  // call. A budget of 0, the default, processes all requests in each call.
+  void SetInfoRequestBudget(uint64 microseconds);
+  uint64 GetInfoRequestBudget() const;
+  // Returns the number of info requests left over from earlier calls because
+  // they did not fit in the budget.
+  size_t GetPendingInfoRequestCount() const;
+
+  // Returns the number of uniform values that have been sent to OpenGL, and
+  // the number that were skipped because they had not changed since they were
+  // last sent to the same shader program, since the Renderer was created or
+  // ResetUniformCounts() was last called. Each element of an array uniform
+  // counts as a separate value. Only the changed elements of array uniforms
+  // are sent.
+  size_t GetSentUniformCount() const;
+  size_t GetSkippedUniformCount() const;
+  void ResetUniformCounts();
+
+  // Sets/returns the cache of program binaries. When a cache is set and
+  // OpenGL supports program binaries, a ShaderProgram whose binary is in the
+  // cache is loaded from it instead of compiling and linking its shaders, and
+  // the binary of each program that is linked is written to it. Binaries that
+  // OpenGL rejects, such as those from an earlier driver, cause the program to
+  // be compiled as usual. The numbers of hits and misses are reported in the
+  // ResourceManager's PlatformInfo. The default is a NULL cache.
+  void SetProgramBinaryCache(const ProgramBinaryCachePtr& cache);
+  const ProgramBinaryCachePtr GetProgramBinaryCache() const;
+
+  // While a program binary cache is set, the Renderer records each pipeline it
+  // draws with, a combination of ShaderProgram, the parts of the OpenGL state
+  // that drivers specialize shaders for, the vertex layout, and the primitive
+  // type. Many drivers only build such a pipeline the first time it is drawn,
+  // causing a hitch in the middle of a frame. WarmUpPipelines() avoids this by
+  // drawing the first primitive of every Shape in the scene rooted at node
+  // whose pipeline was recorded, including in earlier sessions, into a 1x1
+  // offscreen framebuffer, typically while loading. Each pipeline is drawn
+  // once. If no pipelines have been recorded, all of those in the scene are
+  // drawn. Returns the number of draws. Pipelines that depend on the format of
+  // the framebuffer they are drawn into may still be built when first drawn.
+  size_t WarmUpPipelines(const NodePtr& node);
+  // Writes the pipelines recorded since the cache was set or this was last
+  // called to the program binary cache, so that later sessions can warm them
+  // up. Nothing is written automatically.
+  void StoreRecordedPipelines();
+
+  // Returns a FramebufferObject with the passed dimensions from a pool of
+  // transient render targets, such as those of a post-processing chain, so
+  // that they are not reallocated every frame. The color attachment is a
+  // Texture with color_format, or a renderbuffer if samples is nonzero, and
+  // the depth attachment is a renderbuffer with depth_format, or unbound if
+  // depth_format is Image::kInvalid. The framebuffer is reserved for the
+  // caller until the next call to RecycleTransientFramebuffers(), after which
+  // a request for the same formats, size, and samples may return it again.
+  // Since its previous contents are not meant to be kept, they are
+  // invalidated the first time the framebuffer is bound after being acquired.
+  const FramebufferObjectPtr AcquireTransientFramebuffer(
+      uint32 width, uint32 height, Image::Format color_format,
+      Image::Format depth_format, size_t samples);
+  // Returns all transient framebuffers to the pool, typically at the end of a
+  // frame. Framebuffers that were not acquired since the previous call are
+  // destroyed, since they are likely no longer needed.
+  void RecycleTransientFramebuffers();
+  // Returns the number of framebuffers in the transient pool.
+  size_t GetTransientFramebufferCount() const;
+
+  // Tells OpenGL that the contents of the buffers in mask, a combination of
+  // GL_COLOR_BUFFER_BIT, GL_DEPTH_BUFFER_BIT, and GL_STENCIL_BUFFER_BIT, of the
+  // currently bound framebuffer are no longer needed, for example the depth
+  // buffer once a pass is done. This lets tiled GPUs skip writing them back to
+  // memory. Does nothing if glInvalidateFramebuffer() is not available.
+  void InvalidateFramebuffer(GLbitfield mask);
+
  protected:
   // The destructor is protected because all base::Referent classes must have
   // protected or private destructors.
@@ -384,15 +1094,23 @@ class ION_API Renderer : public base::Referent {
   // Internal nested classes that define and manage resources for the Renderer.
   template <int NumModifiedBits> class Resource;
   class BufferResource;
+  class DrawListWorker;
+  class UploadWorker;
   class FramebufferResource;
+  class ImageReadbackQueue;
+  class NodeCpuTimer;
+  class NodeGpuTimer;
+  class QueryQueue;
   class ResourceBinder;
   class ResourceManager;
+  class ResourcePreparer;
   class SamplerResource;
   class ScopedLabel;
   class ShaderInputRegistryResource;
   class ShaderProgramResource;
   class ShaderResource;
   class TextureResource;
+  class TransientFramebufferPool;
   class VertexArrayResource;
   class VertexArrayEmulatorResource;
 
@@ -409,6 +1127,21 @@ class ION_API Renderer : public base::Referent {
   ResourceBinder* GetOrCreateInternalResourceBinder(int line) const;
   ResourceBinder* GetInternalResourceBinder(size_t* visual_id) const;
 
+  // Draws the scene rooted by the given node with the passed flags and binder,
+  // culling it if there is a culling matrix.
+  void DrawSceneWithBinder(const NodePtr& node, const Flags& flags,
+                           NodeGpuTimer* node_gpu_timer,
+                           ResourceBinder* resource_binder);
+  // Performs the work that follows drawing a frame: fencing persistently
+  // mapped storage, evicting resources over the budget, processing image
+  // readbacks, query results, and info requests, and preparing resources.
+  void EndSceneFrame(ResourceBinder* resource_binder);
+  // Returns the queue of Queries, creating it if necessary.
+  QueryQueue* GetQueryQueue();
+  // Creates queued resources within the preparation budgets using the passed
+  // binder.
+  void ProcessResourcePreparation(ResourceBinder* resource_binder);
+
   static const ShaderProgramPtr CreateDefaultShaderProgram(
       const base::AllocatorPtr& allocator);
   static void SetResourceHolderBit(const ResourceHolder* holder, int bit);
@@ -421,6 +1154,48 @@ class ION_API Renderer : public base::Referent {
 
   // The default shader program.
   ShaderProgramPtr default_shader_;
+
+  // Decides which Nodes are drawn, if set.
+  NodeVisibilityFunction visibility_function_;
+
+  // The matrix used to cull Nodes against the view frustum, if set.
+  math::Matrix4f culling_matrix_;
+  bool has_culling_matrix_;
+
+  // Asynchronous reads of framebuffer pixels, created when the first one is
+  // started.
+  std::unique_ptr<ImageReadbackQueue> image_readbacks_;
+
+  // Timer queries for labeled Nodes, created when kProfileLabeledNodeGpuTime
+  // is first used, and the latest times they measured.
+  std::unique_ptr<NodeGpuTimer> node_gpu_timer_;
+  NodeGpuTimes node_gpu_times_;
+  NodeGpuTimesCallback node_gpu_times_callback_;
+  // Measures labeled Nodes on the CPU, created when kProfileLabeledNodeCpuTime
+  // is first used, and the latest times it measured.
+  std::unique_ptr<NodeCpuTimer> node_cpu_timer_;
+  NodeCpuTimes node_cpu_times_;
+  NodeCpuTimesCallback node_cpu_times_callback_;
+
+  // Queries started by BeginQuery() and by Nodes with occlusion queries,
+  // created when the first one is used.
+  std::unique_ptr<QueryQueue> queries_;
+
+  // Scenes queued by PrepareResources(), created when the first one is queued,
+  // and the budgets for preparing them.
+  std::unique_ptr<ResourcePreparer> resource_preparer_;
+  uint64 preparation_time_budget_;
+  size_t preparation_byte_budget_;
+
+  // Transient render targets, created when the first one is acquired.
+  std::unique_ptr<TransientFramebufferPool> transient_framebuffers_;
+
+  // Flattens scenes into draw lists in parallel, if there are worker threads.
+  std::unique_ptr<DrawListWorker> draw_list_worker_;
+
+  // Uploads resources on another thread, once any uploads are requested. This
+  // is last so that its thread stops before anything else is destroyed.
+  std::unique_ptr<UploadWorker> upload_worker_;
 };
 
 // Convenience typedef for shared pointer to a Renderer.
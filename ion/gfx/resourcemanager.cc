@@ -183,6 +183,31 @@ static void FillFramebufferInfo(const GraphicsManagerPtr& gm,
       gm, &info->stencil, &info->stencil_renderbuffer, GL_STENCIL_ATTACHMENT);
 }
 
+//---------------------------------------------------------------------------
+//
+// GpuMemoryInfo helper function.
+//
+//---------------------------------------------------------------------------
+static void FillGpuMemoryInfo(const GraphicsManagerPtr& gm,
+                              ResourceManager::GpuMemoryInfo* info) {
+  // Both extensions report kilobytes.
+  if (gm->IsExtensionSupported("gpu_memory_info")) {
+    GLint total = 0;
+    GLint available = 0;
+    gm->GetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total);
+    gm->GetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX,
+                    &available);
+    info->device_total = static_cast<uint64>(total) * 1024U;
+    info->device_available = static_cast<uint64>(available) * 1024U;
+  } else if (gm->IsExtensionSupported("meminfo")) {
+    // The free memory and largest free block in the texture pool, and the
+    // same for auxiliary memory.
+    GLint values[4] = {0, 0, 0, 0};
+    gm->GetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, values);
+    info->device_available = static_cast<uint64>(values[0]) * 1024U;
+  }
+}
+
 //---------------------------------------------------------------------------
 //
 // SamplerInfo helper function.
@@ -745,91 +770,121 @@ static void FillTextureInfo(const GraphicsManagerPtr& gm,
 }  // anonymous namespace
 
 ResourceManager::ResourceManager(const GraphicsManagerPtr& gm)
-    : graphics_manager_(gm) {
+    : graphics_manager_(gm),
+      array_requests_(GetAllocator()),
+      buffer_requests_(GetAllocator()),
+      framebuffer_requests_(GetAllocator()),
+      gpu_memory_requests_(GetAllocator()),
+      platform_requests_(GetAllocator()),
+      program_requests_(GetAllocator()),
+      sampler_requests_(GetAllocator()),
+      shader_requests_(GetAllocator()),
+      texture_image_requests_(GetAllocator()),
+      texture_requests_(GetAllocator()) {
 }
 
 ResourceManager::~ResourceManager() {
 }
 
 template <> ION_API
-std::vector<ResourceManager::ResourceRequest<AttributeArray,
-                                             ResourceManager::ArrayInfo> >*
-ResourceManager::GetResourceRequestVector<AttributeArray,
-                                          ResourceManager::ArrayInfo>() {
+ResourceManager::RequestQueue<
+    ResourceManager::ResourceRequest<AttributeArray,
+                                     ResourceManager::ArrayInfo> >*
+ResourceManager::GetResourceRequestQueue<AttributeArray,
+                                         ResourceManager::ArrayInfo>() {
   return &array_requests_;
 }
 
 template <> ION_API
-std::vector<ResourceManager::ResourceRequest<BufferObject,
-                                             ResourceManager::BufferInfo> >*
-ResourceManager::GetResourceRequestVector<BufferObject,
-                                          ResourceManager::BufferInfo>() {
+ResourceManager::RequestQueue<
+    ResourceManager::ResourceRequest<BufferObject,
+                                     ResourceManager::BufferInfo> >*
+ResourceManager::GetResourceRequestQueue<BufferObject,
+                                         ResourceManager::BufferInfo>() {
   return &buffer_requests_;
 }
 
-template <> ION_API std::vector<
+template <> ION_API
+ResourceManager::RequestQueue<
     ResourceManager::ResourceRequest<FramebufferObject,
                                      ResourceManager::FramebufferInfo> >*
-ResourceManager::GetResourceRequestVector<FramebufferObject,
-                                          ResourceManager::FramebufferInfo>() {
+ResourceManager::GetResourceRequestQueue<FramebufferObject,
+                                         ResourceManager::FramebufferInfo>() {
   return &framebuffer_requests_;
 }
 
-template <> ION_API
-std::vector<ResourceManager::DataRequest<ResourceManager::PlatformInfo> >*
-ResourceManager::GetDataRequestVector<ResourceManager::PlatformInfo>() {
+template <> ION_API ResourceManager::RequestQueue<
+    ResourceManager::DataRequest<ResourceManager::GpuMemoryInfo> >*
+ResourceManager::GetDataRequestQueue<ResourceManager::GpuMemoryInfo>() {
+  return &gpu_memory_requests_;
+}
+
+template <> ION_API ResourceManager::RequestQueue<
+    ResourceManager::DataRequest<ResourceManager::PlatformInfo> >*
+ResourceManager::GetDataRequestQueue<ResourceManager::PlatformInfo>() {
   return &platform_requests_;
 }
 
 template <> ION_API
-std::vector<ResourceManager::ResourceRequest<ShaderProgram,
-                                             ResourceManager::ProgramInfo> >*
-ResourceManager::GetResourceRequestVector<ShaderProgram,
-                                          ResourceManager::ProgramInfo>() {
+ResourceManager::RequestQueue<
+    ResourceManager::ResourceRequest<ShaderProgram,
+                                     ResourceManager::ProgramInfo> >*
+ResourceManager::GetResourceRequestQueue<ShaderProgram,
+                                         ResourceManager::ProgramInfo>() {
   return &program_requests_;
 }
 
-template <> ION_API std::vector<
-    ResourceManager::ResourceRequest<Sampler, ResourceManager::SamplerInfo> >*
-ResourceManager::GetResourceRequestVector<Sampler,
-                                          ResourceManager::SamplerInfo>() {
+template <> ION_API
+ResourceManager::RequestQueue<
+    ResourceManager::ResourceRequest<Sampler,
+                                     ResourceManager::SamplerInfo> >*
+ResourceManager::GetResourceRequestQueue<Sampler,
+                                         ResourceManager::SamplerInfo>() {
   return &sampler_requests_;
 }
 
-template <> ION_API std::vector<
-    ResourceManager::ResourceRequest<Shader, ResourceManager::ShaderInfo> >*
-ResourceManager::GetResourceRequestVector<Shader,
-                                          ResourceManager::ShaderInfo>() {
+template <> ION_API
+ResourceManager::RequestQueue<
+    ResourceManager::ResourceRequest<Shader,
+                                     ResourceManager::ShaderInfo> >*
+ResourceManager::GetResourceRequestQueue<Shader,
+                                         ResourceManager::ShaderInfo>() {
   return &shader_requests_;
 }
 
 template <> ION_API
-std::vector<ResourceManager::ResourceRequest<TextureBase,
-                                             ResourceManager::TextureInfo> >*
-ResourceManager::GetResourceRequestVector<TextureBase,
-                                          ResourceManager::TextureInfo>() {
+ResourceManager::RequestQueue<
+    ResourceManager::ResourceRequest<TextureBase,
+                                     ResourceManager::TextureInfo> >*
+ResourceManager::GetResourceRequestQueue<TextureBase,
+                                         ResourceManager::TextureInfo>() {
   return &texture_requests_;
 }
 
-template <> ION_API
-std::vector<ResourceManager::DataRequest<ResourceManager::TextureImageInfo> >*
-ResourceManager::GetDataRequestVector<ResourceManager::TextureImageInfo>() {
+template <> ION_API ResourceManager::RequestQueue<
+    ResourceManager::DataRequest<ResourceManager::TextureImageInfo> >*
+ResourceManager::GetDataRequestQueue<ResourceManager::TextureImageInfo>() {
   return &texture_image_requests_;
 }
 
 void ResourceManager::RequestPlatformInfo(
     const InfoCallback<PlatformInfo>::Type& callback) {
-  base::LockGuard lock_guard(&this->request_mutex_);
-  GetDataRequestVector<PlatformInfo>()->push_back(
+  GetDataRequestQueue<PlatformInfo>()->Push(
       DataRequest<PlatformInfo>(0, callback));
 }
 
 void ResourceManager::RequestTextureImage(
     GLuint id, const InfoCallback<TextureImageInfo>::Type& callback) {
-  GetDataRequestVector<TextureImageInfo>()->push_back(
+  GetDataRequestQueue<TextureImageInfo>()->Push(
       DataRequest<TextureImageInfo>(id, callback));
 }
 
+void ResourceManager::RequestGpuMemoryInfo(
+    const InfoCallback<GpuMemoryInfo>::Type& callback) {
+  GetDataRequestQueue<GpuMemoryInfo>()->Push(
+      DataRequest<GpuMemoryInfo>(0, callback));
+}
+
 template <>
 void ResourceManager::FillInfoFromOpenGL(ResourceManager::ArrayInfo* info) {
   FillArrayInfo(graphics_manager_, info);
@@ -846,6 +901,12 @@ void ResourceManager::FillInfoFromOpenGL(
   FillFramebufferInfo(graphics_manager_, info);
 }
 
+template <>
+void ResourceManager::FillInfoFromOpenGL(
+    ResourceManager::GpuMemoryInfo* info) {
+  FillGpuMemoryInfo(graphics_manager_, info);
+}
+
 template <>
 void ResourceManager::FillInfoFromOpenGL(ResourceManager::ProgramInfo* info) {
   FillProgramInfo(graphics_manager_, info);
@@ -19,14 +19,17 @@ limitations under the License.
 #define ION_GFX_RESOURCEMANAGER_H_
 
 #include <functional>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "ion/base/allocatable.h"
 #include "ion/base/lockguards.h"
+#include "ion/base/mpscqueue.h"
 #include "ion/base/referent.h"
 #include "ion/gfx/image.h"
 #include "ion/gfx/openglobjects.h"
+#include "ion/port/atomic.h"
 #include "ion/port/mutex.h"
 
 namespace ion {
@@ -127,7 +130,12 @@ class ION_API ResourceManager : public base::Allocatable {
 
   // Struct for getting information about the local OpenGL platform.
   struct PlatformInfo {
-    PlatformInfo() : major_version(-1), minor_version(-1), glsl_version(-1) {}
+    PlatformInfo()
+        : major_version(-1),
+          minor_version(-1),
+          glsl_version(-1),
+          program_binary_cache_hits(0U),
+          program_binary_cache_misses(0U) {}
     // Versions.
     GLuint major_version;
     GLuint minor_version;
@@ -164,6 +172,12 @@ class ION_API ResourceManager : public base::Allocatable {
     std::string renderer;
     std::string vendor;
     std::string version_string;
+
+    // The numbers of shader programs that were loaded from the Renderer's
+    // ProgramBinaryCache, and that had to be compiled because their binary was
+    // not in the cache or was rejected.
+    size_t program_binary_cache_hits;
+    size_t program_binary_cache_misses;
   };
 
   // Struct containing information about a texture and its image(s). There will
@@ -177,6 +191,23 @@ class ION_API ResourceManager : public base::Allocatable {
     base::AllocVector<ImagePtr> images;
   };
 
+  // Struct containing the GPU memory used by the Renderer's resources, as
+  // estimated by the Renderer, and the device memory reported by the driver.
+  struct GpuMemoryInfo {
+    GpuMemoryInfo() : used(0U), device_total(0U), device_available(0U) {}
+    // The total bytes used by all resources, which is the sum of what
+    // Renderer::GetGpuMemoryUsage() returns for each resource type.
+    size_t used;
+    // The bytes used by the resources of the holders with each label. Holders
+    // without a label are counted under the empty label.
+    std::map<std::string, size_t> used_by_label;
+    // The total and currently available bytes of device memory, from the
+    // NVX_gpu_memory_info or ATI_meminfo extension. These are 0 if the driver
+    // supports neither; ATI_meminfo only reports the available memory.
+    uint64 device_total;
+    uint64 device_available;
+  };
+
   // Callbacks called when requested resource information is available. If info
   // about a specific resource was requested then the vector will have size 1.
   template <typename T> struct InfoCallback {
@@ -204,8 +235,7 @@ class ION_API ResourceManager : public base::Allocatable {
       const typename base::ReferentPtr<HolderType>::Type& holder,
       const typename InfoCallback<InfoType>::Type& callback) {
     if (holder.Get()) {
-      base::LockGuard lock_guard(&this->request_mutex_);
-      GetResourceRequestVector<HolderType, InfoType>()->push_back(
+      GetResourceRequestQueue<HolderType, InfoType>()->Push(
           ResourceRequest<HolderType, InfoType>(holder, callback));
     }
   }
@@ -215,8 +245,7 @@ class ION_API ResourceManager : public base::Allocatable {
   template <typename HolderType, typename InfoType>
   void RequestAllResourceInfos(
       const typename InfoCallback<InfoType>::Type& callback) {
-    base::LockGuard lock_guard(&this->request_mutex_);
-    GetResourceRequestVector<HolderType, InfoType>()->push_back(
+    GetResourceRequestQueue<HolderType, InfoType>()->Push(
         ResourceRequest<HolderType, InfoType>(
             typename base::ReferentPtr<HolderType>::Type(), callback));
   }
@@ -234,10 +263,15 @@ class ION_API ResourceManager : public base::Allocatable {
   void RequestTextureImage(
       GLuint id, const InfoCallback<TextureImageInfo>::Type& callback);
 
+  // Requests a GpuMemoryInfo. See the comment for RequestInfoForResource() for
+  // details about the callback.
+  void RequestGpuMemoryInfo(const InfoCallback<GpuMemoryInfo>::Type& callback);
+
  protected:
   // Wrapper struct for data requests.
   template <typename InfoType>
   struct DataRequest {
+    DataRequest() : id(0) {}
     DataRequest(
         GLuint id_in,
         const typename InfoCallback<InfoType>::Type& callback_in)
@@ -249,6 +283,7 @@ class ION_API ResourceManager : public base::Allocatable {
   // Wrapper struct for resource info requests.
   template <typename HolderType, typename InfoType>
   struct ResourceRequest {
+    ResourceRequest() {}
     ResourceRequest(
         const typename base::ReferentPtr<HolderType>::Type& holder_in,
         const typename InfoCallback<InfoType>::Type& callback_in)
@@ -257,22 +292,68 @@ class ION_API ResourceManager : public base::Allocatable {
     typename InfoCallback<InfoType>::Type callback;
   };
 
+  // A queue of requests that may be made from any thread and are processed on
+  // the thread of the owning Renderer. Requests are normally pushed onto a
+  // lock-free queue; if more than its capacity are made between two calls to
+  // PopAll(), the rest are appended to an overflow vector under a lock.
+  template <typename RequestType>
+  class RequestQueue {
+   public:
+    explicit RequestQueue(const base::AllocatorPtr& allocator)
+        : queue_(allocator, kRequestQueueCapacity), has_overflow_(false) {}
+
+    void Push(const RequestType& request) {
+      // Once the queue has overflowed, keep appending to the overflow vector
+      // so that requests stay in order.
+      if (has_overflow_.load(std::memory_order_acquire) ||
+          !queue_.TryPush(request)) {
+        base::LockGuard lock_guard(&overflow_mutex_);
+        overflow_.push_back(request);
+        has_overflow_.store(true, std::memory_order_release);
+      }
+    }
+
+    // Moves all pending requests to the end of requests. Must only be called
+    // from the thread that processes the requests.
+    void PopAll(std::vector<RequestType>* requests) {
+      RequestType request;
+      while (queue_.TryPop(&request))
+        requests->push_back(request);
+      if (has_overflow_.load(std::memory_order_acquire)) {
+        base::LockGuard lock_guard(&overflow_mutex_);
+        requests->insert(requests->end(), overflow_.begin(), overflow_.end());
+        overflow_.clear();
+        has_overflow_.store(false, std::memory_order_release);
+      }
+    }
+
+   private:
+    // The number of requests of each type that can be made between two
+    // frames without taking a lock.
+    static const size_t kRequestQueueCapacity = 16U;
+
+    base::MpscQueue<RequestType> queue_;
+    std::atomic<bool> has_overflow_;
+    port::Mutex overflow_mutex_;
+    std::vector<RequestType> overflow_;
+  };
+
   // A valid GraphicsManagerPtr must be passed to the constructor. The
   // constructor and destructor are protected since this is an abstract base
   // class.
   explicit ResourceManager(const GraphicsManagerPtr& gm);
   ~ResourceManager() override;
 
-  // Returns a pointer to the vector of requests for the templated holder and
+  // Returns a pointer to the queue of requests for the templated holder and
   // info types.
   template <typename HolderType, typename InfoType>
-  std::vector<ResourceRequest<HolderType, InfoType> >*
-      GetResourceRequestVector();
+  RequestQueue<ResourceRequest<HolderType, InfoType> >*
+      GetResourceRequestQueue();
 
-  // Returns a pointer to the vector of data requests for the templated info
+  // Returns a pointer to the queue of data requests for the templated info
   // type.
   template <typename InfoType>
-  std::vector<DataRequest<InfoType> >* GetDataRequestVector();
+  RequestQueue<DataRequest<InfoType> >* GetDataRequestQueue();
 
   // Performs OpenGL calls to fill in info details, specialized for each
   // type derived from ResourceInfo. Should only be called on the same thread
@@ -281,24 +362,22 @@ class ION_API ResourceManager : public base::Allocatable {
   template <typename InfoType>
   void FillInfoFromOpenGL(InfoType* info);
 
-  // For locking access to request vectors.
-  port::Mutex request_mutex_;
-
  private:
   GraphicsManagerPtr graphics_manager_;
 
   // Queues for resource info requests.
-  std::vector<ResourceRequest<AttributeArray, ArrayInfo> > array_requests_;
-  std::vector<ResourceRequest<BufferObject, BufferInfo> > buffer_requests_;
-  std::vector<ResourceRequest<FramebufferObject, FramebufferInfo> >
+  RequestQueue<ResourceRequest<AttributeArray, ArrayInfo> > array_requests_;
+  RequestQueue<ResourceRequest<BufferObject, BufferInfo> > buffer_requests_;
+  RequestQueue<ResourceRequest<FramebufferObject, FramebufferInfo> >
       framebuffer_requests_;
-  std::vector<DataRequest<PlatformInfo> > platform_requests_;
-  std::vector<ResourceRequest<ShaderProgram, ProgramInfo> >
+  RequestQueue<DataRequest<GpuMemoryInfo> > gpu_memory_requests_;
+  RequestQueue<DataRequest<PlatformInfo> > platform_requests_;
+  RequestQueue<ResourceRequest<ShaderProgram, ProgramInfo> >
       program_requests_;
-  std::vector<ResourceRequest<Sampler, SamplerInfo> > sampler_requests_;
-  std::vector<ResourceRequest<Shader, ShaderInfo> > shader_requests_;
-  std::vector<DataRequest<TextureImageInfo> > texture_image_requests_;
-  std::vector<ResourceRequest<TextureBase, TextureInfo> > texture_requests_;
+  RequestQueue<ResourceRequest<Sampler, SamplerInfo> > sampler_requests_;
+  RequestQueue<ResourceRequest<Shader, ShaderInfo> > shader_requests_;
+  RequestQueue<DataRequest<TextureImageInfo> > texture_image_requests_;
+  RequestQueue<ResourceRequest<TextureBase, TextureInfo> > texture_requests_;
 };
 
 }  // namespace gfx
@@ -20,6 +20,7 @@ limitations under the License.
 #include <stdint.h>
 
 #include <algorithm>
+#include <unordered_map>
 
 #include "ion/base/lockguards.h"
 #include "ion/base/staticsafedeclare.h"
@@ -65,7 +66,7 @@ class ShaderInputRegistry::StaticData {
  public:
   // Only one instance of this class should be created using this constructor.
   StaticData()
-      : registry_count_(0), largest_registry_size_(0) {}
+      : registry_count_(0), largest_registry_size_(0), generation_(1U) {}
 
   // Gets the number of registries created.
   int32_t GetRegistryCount() const {
@@ -97,12 +98,40 @@ class ShaderInputRegistry::StaticData {
     }
   }
 
+  // Returns the id of name, interning it if create is true. Returns
+  // base::kInvalidIndex if the name is not interned and create is false.
+  size_t GetNameId(const std::string& name, bool create) {
+    base::LockGuard guard(&name_mutex_);
+    const auto it = name_ids_.find(name);
+    if (it != name_ids_.end())
+      return it->second;
+    if (!create)
+      return base::kInvalidIndex;
+    const size_t id = name_ids_.size();
+    name_ids_[name] = id;
+    return id;
+  }
+
+  // Returns the generation of all registries, which changes whenever a Spec
+  // or an include is added to any of them.
+  uint64 GetGeneration() const { return generation_.load(); }
+
+  // Starts a new generation.
+  void IncrementGeneration() { ++generation_; }
+
  private:
   // The number of registries that have been created.
   mutable std::atomic<int32_t> registry_count_;
 
   // The number of entries in the largest registry.
   mutable std::atomic<int32_t> largest_registry_size_;
+
+  // The current generation of the registries.
+  std::atomic<uint64> generation_;
+
+  // Interned names and the mutex protecting them.
+  std::unordered_map<std::string, size_t> name_ids_;
+  port::Mutex name_mutex_;
 };
 
 //-----------------------------------------------------------------------------
@@ -159,27 +188,26 @@ ShaderInputRegistry::ShaderInputRegistry()
                      this),
       attribute_specs_(*this),
       includes_(*this),
-      spec_map_(*this) {
+      spec_map_(*this),
+      flat_index_(*this),
+      flat_index_generation_(0U) {
   id_ = GetStaticData()->GetUniqueId();
 }
 
 ShaderInputRegistry::~ShaderInputRegistry() {
 }
 
+size_t ShaderInputRegistry::GetNameId(const std::string& name) {
+  return GetStaticData()->GetNameId(name, true);
+}
+
+size_t ShaderInputRegistry::FindNameId(const std::string& name) {
+  return GetStaticData()->GetNameId(name, false);
+}
+
 bool ShaderInputRegistry::Contains(const std::string& name) const {
-  const SpecMapType::const_iterator it = spec_map_.find(name);
-  if (it == spec_map_.end()) {
-    // A spec with the name is not in this registry; search includes.
-    const size_t num_includes = includes_.size();
-    for (size_t i = 0; i < num_includes; ++i)
-      if (includes_[i]->Contains(name))
-        return true;
-    return false;
-  } else {
-    // A spec with the same name but different type already exists, or this
-    // registry has a spec of the right type.
-    return true;
-  }
+  // There is an entry for every name with a spec of either type.
+  return FindFlatEntry(FindNameId(name)) != NULL;
 }
 
 bool ShaderInputRegistry::Include(const ShaderInputRegistryPtr& reg) {
@@ -207,6 +235,7 @@ bool ShaderInputRegistry::Include(const ShaderInputRegistryPtr& reg) {
   }
 
   includes_.push_back(reg);
+  InvalidateFlatIndices();
   return true;
 }
 
@@ -269,6 +298,57 @@ ShaderInputRegistry::GetSpecs() const {
   return uniform_specs_.Get();
 }
 
+void ShaderInputRegistry::InvalidateFlatIndices() {
+  GetStaticData()->IncrementGeneration();
+}
+
+const ShaderInputRegistry::FlatEntry* ShaderInputRegistry::FindFlatEntry(
+    size_t name_id) const {
+  if (name_id == base::kInvalidIndex)
+    return NULL;
+  if (flat_index_generation_.load() != GetStaticData()->GetGeneration())
+    UpdateFlatIndex();
+  const FlatIndexType::const_iterator it = flat_index_.find(name_id);
+  return it == flat_index_.end() ? NULL : &it->second;
+}
+
+void ShaderInputRegistry::UpdateFlatIndex() const {
+  base::LockGuard guard(&flat_index_mutex_);
+  const uint64 generation = GetStaticData()->GetGeneration();
+  if (flat_index_generation_.load() == generation)
+    return;
+  flat_index_.clear();
+  // Specs are found in the includes first, in order, and then in this
+  // registry, so the first spec of each type for a name is kept.
+  const size_t num_includes = includes_.size();
+  for (size_t i = 0; i < num_includes; ++i) {
+    const ShaderInputRegistry& include = *includes_[i];
+    include.UpdateFlatIndex();
+    for (FlatIndexType::const_iterator it = include.flat_index_.begin();
+         it != include.flat_index_.end(); ++it) {
+      FlatEntry& entry = flat_index_[it->first];
+      for (int tag = 0; tag < 2; ++tag) {
+        if (!entry.specs[tag].registry)
+          entry.specs[tag] = it->second.specs[tag];
+      }
+    }
+  }
+  for (SpecMapType::const_iterator it = spec_map_.begin();
+       it != spec_map_.end(); ++it) {
+    const SpecMapEntry& map_entry = it->second;
+    const size_t name_id =
+        map_entry.tag == ShaderInputBase::kUniform
+            ? GetSpecs<Uniform>()[map_entry.index].name_id
+            : GetSpecs<Attribute>()[map_entry.index].name_id;
+    FlatSpec& flat_spec = flat_index_[name_id].specs[map_entry.tag];
+    if (!flat_spec.registry) {
+      flat_spec.registry = this;
+      flat_spec.index = map_entry.index;
+    }
+  }
+  flat_index_generation_ = generation;
+}
+
 const ShaderInputRegistryPtr& ShaderInputRegistry::GetGlobalRegistry() {
   return GetStaticGlobalRegistryData()->GetGlobalRegistry();
 }
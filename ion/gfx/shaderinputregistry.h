@@ -23,18 +23,23 @@ limitations under the License.
 #include <string>
 #include <vector>
 
+#include "base/integral_types.h"
 #include "base/macros.h"
 #include "ion/base/allocator.h"
+#include "ion/base/invalid.h"
 #include "ion/base/logging.h"
 #include "ion/base/referent.h"
 #include "ion/base/stlalloc/allocdeque.h"
 #include "ion/base/stlalloc/allocmap.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
 #include "ion/base/stlalloc/allocvector.h"
 #include "ion/base/stringutils.h"
 #include "ion/base/varianttyperesolver.h"
 #include "ion/gfx/attribute.h"
 #include "ion/gfx/resourceholder.h"
 #include "ion/gfx/uniform.h"
+#include "ion/port/atomic.h"
+#include "ion/port/mutex.h"
 
 namespace ion {
 namespace gfx {
@@ -84,6 +89,11 @@ typedef base::ReferentPtr<ShaderInputRegistry>::Type ShaderInputRegistryPtr;
 //           Replaces the base color for shapes.
 //           Default Value:  (1,1,1,1)
 //
+// Input names are interned: each distinct name has a small integer id, shared
+// by all registries, that is returned by GetNameId(). Each registry keeps a
+// flattened index from name id to the Spec found in it or its includes, which
+// is rebuilt lazily after any registry adds a Spec or an include, so lookups
+// do not search the include chain.
 //
 class ION_API ShaderInputRegistry : public ResourceHolder {
  public:
@@ -140,6 +150,7 @@ class ION_API ShaderInputRegistry : public ResourceHolder {
           doc_string(doc_string_in),
           index(0),
           registry_id(0),
+          name_id(base::kInvalidIndex),
           registry(NULL),
           combine_function(combine_function_in),
           generate_function(generate_function_in) {}
@@ -149,6 +160,7 @@ class ION_API ShaderInputRegistry : public ResourceHolder {
     std::string doc_string;            // String describing its use.
     size_t index;                      // Unique index within registry.
     size_t registry_id;                // Id of the owning registry.
+    size_t name_id;                    // Interned id of the name.
     // The registry that created this spec. This is a raw pointer since when the
     // registry is destroyed, the spec will be as well.
     ShaderInputRegistry* registry;
@@ -180,6 +192,14 @@ class ION_API ShaderInputRegistry : public ResourceHolder {
   // included.
   bool IncludeGlobalRegistry();
 
+  // Returns the interned id of |name|, which is the same in all registries,
+  // interning it if necessary. Ids are consecutive integers starting from 0.
+  static size_t GetNameId(const std::string& name);
+
+  // Returns the interned id of |name|, or base::kInvalidIndex if it has not
+  // been interned, in which case no registry has an input with that name.
+  static size_t FindNameId(const std::string& name);
+
   // Returns the vector of included registries.
   const base::AllocVector<ShaderInputRegistryPtr>& GetIncludes() const {
     return includes_;
@@ -210,10 +230,12 @@ class ION_API ShaderInputRegistry : public ResourceHolder {
       specs.push_back(spec);
       specs.back().index = index;
       specs.back().registry_id = id_;
+      specs.back().name_id = GetNameId(spec.name);
       specs.back().registry = this;
       UpdateLargestRegistrySize(specs.size());
       // Store in map.
       spec_map_[spec.name] = SpecMapEntry(T::GetTag(), index, id_);
+      InvalidateFlatIndices();
       return true;
     }
   }
@@ -224,26 +246,22 @@ class ION_API ShaderInputRegistry : public ResourceHolder {
 
   // Returns the Spec for an input, or NULL if there isn't yet one. The returned
   // pointer is not guaranteed to be persistent if Add() is called again.
+  // Includes are searched before this registry, in the order they were
+  // included.
   template <typename T> const Spec<T>* Find(const std::string& name) const {
-    const size_t num_includes = includes_.size();
-    for (size_t i = 0; i < num_includes; ++i) {
-      const Spec<T>* spec = includes_[i]->Find<T>(name);
-      if (spec)
-        return spec;
-    }
-    const SpecMapType::const_iterator it = spec_map_.find(name);
-    if (it == spec_map_.end()) {
-      // Neither this regisry nor its includes contains a spec with the right
-      // name.
-      return NULL;
-    } else if (it->second.tag != T::GetTag()) {
-      // A spec with the same name but different type already exists in this
-      // registry.
+    return FindById<T>(FindNameId(name));
+  }
+
+  // Returns the Spec for an input with the interned name id |name_id| like
+  // Find(), without any string operations.
+  template <typename T> const Spec<T>* FindById(size_t name_id) const {
+    const FlatEntry* entry = FindFlatEntry(name_id);
+    if (!entry)
       return NULL;
-    } else {
-      // This registry has a spec of the right type. Return it.
-      return &GetSpecs<T>()[it->second.index];
-    }
+    const FlatSpec& flat_spec = entry->specs[T::GetTag()];
+    return flat_spec.registry
+               ? &flat_spec.registry->GetSpecs<T>()[flat_spec.index]
+               : NULL;
   }
 
   // Returns a vector of all Specs of type T added to this registry.
@@ -399,6 +417,32 @@ class ION_API ShaderInputRegistry : public ResourceHolder {
   };
   typedef base::AllocMap<const std::string, SpecMapEntry> SpecMapType;
 
+  // The Spec of one type that a name refers to in the flattened index.
+  struct FlatSpec {
+    FlatSpec() : registry(NULL), index(0) {}
+
+    // The registry holding the Spec, or NULL if there is no Spec of the type.
+    const ShaderInputRegistry* registry;
+    size_t index;
+  };
+  // The Specs of each type, indexed by ShaderInputBase::Tag, that a name
+  // refers to in this registry or its includes.
+  struct FlatEntry {
+    FlatSpec specs[2];
+  };
+  typedef base::AllocUnorderedMap<size_t, FlatEntry> FlatIndexType;
+
+  // Marks the flattened indices of all registries as out of date, since any
+  // of them may include this one.
+  static void InvalidateFlatIndices();
+
+  // Returns the entry for |name_id| in the flattened index, rebuilding the
+  // index first if it is out of date, or NULL if there is no such entry.
+  const FlatEntry* FindFlatEntry(size_t name_id) const;
+
+  // Rebuilds the flattened index if it is out of date.
+  void UpdateFlatIndex() const;
+
   // Returns a map of all Specs added to the registry and its includes.
   const SpecMapType GetAllSpecEntries() const;
 
@@ -473,6 +517,13 @@ class ION_API ShaderInputRegistry : public ResourceHolder {
   // Maps shader input name to the index of the Spec within the vector.
   SpecMapType spec_map_;
 
+  // Maps interned names to the Specs found for them in this registry and its
+  // includes, with the generation of the registries it was built in. The
+  // index is rebuilt under the mutex when the generation changes.
+  mutable FlatIndexType flat_index_;
+  mutable std::atomic<uint64> flat_index_generation_;
+  mutable port::Mutex flat_index_mutex_;
+
   // Unique registry ID.
   size_t id_;
 
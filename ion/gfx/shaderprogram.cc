@@ -25,6 +25,9 @@ namespace gfx {
 ShaderProgram::ShaderProgram(const ShaderInputRegistryPtr& registry)
     : vertex_shader_(kVertexShaderChanged, ShaderPtr(), this),
       fragment_shader_(kFragmentShaderChanged, ShaderPtr(), this),
+      compute_shader_(kComputeShaderChanged, ShaderPtr(), this),
+      captured_varyings_(kCapturedVaryingsChanged, std::vector<std::string>(),
+                         this),
       registry_(registry),
       concurrent_(false),
       concurrent_set_(false) {
@@ -36,6 +39,8 @@ ShaderProgram::~ShaderProgram() {
     shader->RemoveReceiver(this);
   if (Shader* shader = fragment_shader_.Get().Get())
     shader->RemoveReceiver(this);
+  if (Shader* shader = compute_shader_.Get().Get())
+    shader->RemoveReceiver(this);
 }
 
 const ShaderProgramPtr ShaderProgram::BuildFromStrings(
@@ -55,12 +60,27 @@ const ShaderProgramPtr ShaderProgram::BuildFromStrings(
   return program;
 }
 
+const ShaderProgramPtr ShaderProgram::BuildComputeFromString(
+    const std::string& id_string,
+    const ShaderInputRegistryPtr& registry_ptr,
+    const std::string& compute_shader_string,
+    const base::AllocatorPtr& allocator) {
+  ShaderProgramPtr program(new(allocator) ShaderProgram(registry_ptr));
+  program->SetLabel(id_string);
+  program->SetComputeShader(
+      ShaderPtr(new(allocator) Shader(compute_shader_string)));
+  program->GetComputeShader()->SetLabel(id_string + " compute shader");
+  return program;
+}
+
 void ShaderProgram::OnNotify(const base::Notifier* notifier) {
   if (GetResourceCount()) {
     if (notifier == vertex_shader_.Get().Get())
       OnChanged(kVertexShaderChanged);
     else if (notifier == fragment_shader_.Get().Get())
       OnChanged(kFragmentShaderChanged);
+    else if (notifier == compute_shader_.Get().Get())
+      OnChanged(kComputeShaderChanged);
   }
 }
 
@@ -18,6 +18,9 @@ limitations under the License.
 #ifndef ION_GFX_SHADERPROGRAM_H_
 #define ION_GFX_SHADERPROGRAM_H_
 
+#include <string>
+#include <vector>
+
 #include "ion/base/referent.h"
 #include "ion/gfx/resourceholder.h"
 #include "ion/gfx/shader.h"
@@ -34,13 +37,17 @@ typedef base::ReferentPtr<ShaderProgram>::Type ShaderProgramPtr;
 typedef base::WeakReferentPtr<ShaderProgram> ShaderProgramWeakPtr;
 
 // A ShaderProgram represents an OpenGL shader program that can be applied to
-// shapes. It contains vertex and fragments shaders.
+// shapes. It contains vertex and fragments shaders. Alternatively it can
+// contain only a compute shader, in which case it is run with
+// Renderer::DispatchCompute() instead of being drawn.
 class ION_API ShaderProgram : public ShaderBase {
  public:
   // Changes that affect the resource.
   enum Changes {
     kVertexShaderChanged = kNumBaseChanges,
     kFragmentShaderChanged,
+    kCapturedVaryingsChanged,
+    kComputeShaderChanged,
     kNumChanges
   };
 
@@ -74,6 +81,60 @@ class ION_API ShaderProgram : public ShaderBase {
     return fragment_shader_.Get();
   }
 
+  // Sets/returns the compute shader stage. A program with a compute shader
+  // must not have vertex or fragment shaders. Compute shaders require OpenGL
+  // ES 3.1 or desktop OpenGL 4.3; see GraphicsManager::kComputeShader.
+  void SetComputeShader(const ShaderPtr& shader) {
+    if (Shader* old_shader = compute_shader_.Get().Get())
+      old_shader->RemoveReceiver(this);
+    compute_shader_.Set(shader);
+    if (shader.Get())
+      shader->AddReceiver(this);
+  }
+  const ShaderPtr& GetComputeShader() const {
+    return compute_shader_.Get();
+  }
+  // Returns whether this is a compute program.
+  bool IsCompute() const { return compute_shader_.Get().Get() != NULL; }
+
+  // Sets/returns the names of the vertex shader outputs that are written into
+  // the capture buffer while transform feedback is active; see
+  // TransformFeedback. The outputs are interleaved in the order of the names.
+  // They are bound when the program is linked, so changing them relinks it.
+  // Names are ignored if the platform does not support transform feedback.
+  void SetCapturedVaryings(const std::vector<std::string>& names) {
+    captured_varyings_.Set(names);
+  }
+  const std::vector<std::string>& GetCapturedVaryings() const {
+    return captured_varyings_.Get();
+  }
+
+  // Sets/returns a cheaper program that the Renderer draws with instead of
+  // this one in a depth prepass (see Renderer::kDepthPrepass), typically one
+  // whose fragment shader does nothing. It must accept the same attributes
+  // and Uniforms as this program, and must not be this program itself. If no
+  // variant is set, the prepass draws with this program.
+  void SetDepthOnlyVariant(const ShaderProgramPtr& program) {
+    depth_only_variant_ = program;
+  }
+  const ShaderProgramPtr& GetDepthOnlyVariant() const {
+    return depth_only_variant_;
+  }
+
+  // Sets/returns the program that the Renderer draws with instead of this one
+  // when it draws the revealage of the transparent pass with order-independent
+  // transparency (see Renderer::kOrderIndependentTransparency). It must
+  // accept the same attributes and Uniforms as this program, and write the
+  // unweighted alpha of each fragment to the alpha of its output. If no
+  // variant is set, this program is used, which is only correct if the weight
+  // that it multiplies its output by is 1.
+  void SetRevealageVariant(const ShaderProgramPtr& program) {
+    revealage_variant_ = program;
+  }
+  const ShaderProgramPtr& GetRevealageVariant() const {
+    return revealage_variant_;
+  }
+
   // Sets/returns whether this shader program should have per-thread state.
   // When this is enabled, it is possible to simultaneously set different
   // uniform values and attribute bindings in each thread, allowing one
@@ -102,6 +163,15 @@ class ION_API ShaderProgram : public ShaderBase {
     const std::string& fragment_shader_string,
     const base::AllocatorPtr& allocator);
 
+  // Convenience function that builds and returns a new compute ShaderProgram
+  // instance like BuildFromStrings(). The compute Shader's label is set to
+  // id_string + " compute shader".
+  static const ShaderProgramPtr BuildComputeFromString(
+    const std::string& id_string,
+    const ShaderInputRegistryPtr& registry_ptr,
+    const std::string& compute_shader_string,
+    const base::AllocatorPtr& allocator);
+
  protected:
   // The destructor is protected because all base::Referent classes must have
   // protected or private destructors.
@@ -113,7 +183,11 @@ class ION_API ShaderProgram : public ShaderBase {
 
   Field<ShaderPtr> vertex_shader_;
   Field<ShaderPtr> fragment_shader_;
+  Field<ShaderPtr> compute_shader_;
+  Field<std::vector<std::string> > captured_varyings_;
   ShaderInputRegistryPtr registry_;
+  ShaderProgramPtr depth_only_variant_;
+  ShaderProgramPtr revealage_variant_;
   // True if each thread should have its own copy of this program object.
   bool concurrent_;
   // True if SetConcurrent was already called on this instance.
@@ -26,7 +26,10 @@ namespace ion {
 namespace gfx {
 
 Shape::Shape()
-    : primitive_type_(kTriangles), vertex_ranges_(*this), instance_count_(0) {}
+    : primitive_type_(kTriangles),
+      vertex_ranges_(*this),
+      instance_count_(0),
+      indirect_offset_(0U) {}
 
 Shape::~Shape() {
 }
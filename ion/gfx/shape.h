@@ -20,8 +20,10 @@ limitations under the License.
 
 #include <string>
 
+#include "base/integral_types.h"
 #include "ion/base/referent.h"
 #include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
 #include "ion/gfx/indexbuffer.h"
 #include "ion/math/range.h"
 
@@ -114,6 +116,38 @@ class ION_API Shape : public base::Referent {
   // Returns the instance count that the vertex range is set to.
   int GetVertexRangeInstanceCount(size_t i) const;
 
+  // The layouts of the draw arguments read from an indirect buffer, as defined
+  // by OpenGL. base_instance must be 0 in OpenGL ES.
+  struct DrawArraysIndirectCommand {
+    uint32 count;
+    uint32 instance_count;
+    uint32 first;
+    uint32 base_instance;
+  };
+  struct DrawElementsIndirectCommand {
+    uint32 count;
+    uint32 instance_count;
+    uint32 first_index;
+    int32 base_vertex;
+    uint32 base_instance;
+  };
+
+  // Sets/returns a BufferObject holding the arguments of the draw, which the
+  // GPU reads when the Shape is drawn, starting at offset bytes into the
+  // buffer: a DrawElementsIndirectCommand if the Shape has an IndexBuffer, and
+  // a DrawArraysIndirectCommand otherwise. The vertex ranges and instance
+  // counts of the Shape are then ignored. The arguments may be written on the
+  // GPU, for example by transform feedback, so that a culling pass can decide
+  // how many instances are drawn without a round trip to the CPU. Indirect
+  // drawing requires OpenGL 4.0, OpenGL ES 3.1, or ARB_draw_indirect; without
+  // it, the Shape is drawn with its own vertex ranges and instance counts.
+  void SetIndirectBuffer(const BufferObjectPtr& buffer, size_t offset) {
+    indirect_buffer_ = buffer;
+    indirect_offset_ = offset;
+  }
+  const BufferObjectPtr& GetIndirectBuffer() const { return indirect_buffer_; }
+  size_t GetIndirectOffset() const { return indirect_offset_; }
+
  protected:
   // The destructor is protected because all base::Referent classes must have
   // protected or private destructors.
@@ -158,6 +192,9 @@ class ION_API Shape : public base::Referent {
   // the shape is drawn with regular functions. Note that this value will be
   // ignored if vertex range is enabled.
   int instance_count_;
+  // The buffer holding the draw arguments, if any, and their byte offset.
+  BufferObjectPtr indirect_buffer_;
+  size_t indirect_offset_;
   // An identifying name for this Shape that can appear in debug streams and
   // printouts of a scene.
   std::string label_;
@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/gfx/statetable.h"
 
+#include <cstring>  // For memcmp().
+
 #include "ion/base/argcount.h"
 #include "ion/base/enumhelper.h"
 #include "ion/base/logging.h"
@@ -26,10 +28,35 @@ limitations under the License.
 namespace ion {
 namespace gfx {
 
+namespace {
+
+// FNV-1a parameters for GetHash().
+static const uint64 kHashSeed = 14695981039346656037ULL;
+static const uint64 kHashPrime = 1099511628211ULL;
+
+// Folds the bytes of a value into a hash.
+template <typename T>
+static uint64 HashBytes(uint64 hash, const T& value) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(&value);
+  for (size_t i = 0; i < sizeof(value); ++i)
+    hash = (hash ^ bytes[i]) * kHashPrime;
+  return hash;
+}
+
+// Returns whether two values have identical bytes, which is the same test
+// that GetHash() uses to distinguish values.
+template <typename T>
+static bool AreBytesEqual(const T& value0, const T& value1) {
+  return memcmp(&value0, &value1, sizeof(value0)) == 0;
+}
+
+}  // anonymous namespace
+
 StateTable::~StateTable() {
 }
 
 void StateTable::Reset() {
+  InvalidateHash();
   // Copy the default Data instance into this.
   data_ = GetDefaultData();
 
@@ -43,6 +70,7 @@ void StateTable::CopyFrom(const StateTable& other) {
   default_width_ = other.default_width_;
   default_height_ = other.default_height_;
   data_ = other.data_;
+  hash_ = other.hash_;
 }
 
 // Definitions for each number of arguments.
@@ -77,6 +105,7 @@ void StateTable::CopyFrom(const StateTable& other) {
 
 void StateTable::MergeValuesFrom(const StateTable& other,
                                  const StateTable& state_to_test) {
+  InvalidateHash();
   MergeNonClearValuesFrom(other, state_to_test);
 
   // If any values are set in the other state, set their values here.
@@ -89,6 +118,7 @@ void StateTable::MergeValuesFrom(const StateTable& other,
 
 void StateTable::MergeNonClearValuesFrom(const StateTable& other,
                                          const StateTable& state_to_test) {
+  InvalidateHash();
   // If any capability settings are set in the other state then set them here.
   if (state_to_test.GetSetCapabilityCount() &&
       (!AreCapabilitiesSame(*this, other) ||
@@ -164,6 +194,194 @@ void StateTable::MergeNonClearValuesFrom(const StateTable& other,
 #undef ION_UPDATE_VALUE5
 #undef ION_UPDATE_VALUE6
 
+// Definitions for each number of arguments.
+#define ION_HASH_VALUE1(n) hash = HashBytes(hash, data_.n)
+#define ION_HASH_VALUE2(n1, n2) \
+  ION_HASH_VALUE1(n1);          \
+  ION_HASH_VALUE1(n2)
+#define ION_HASH_VALUE3(n1, n2, n3) \
+  ION_HASH_VALUE2(n1, n2);          \
+  ION_HASH_VALUE1(n3)
+#define ION_HASH_VALUE4(n1, n2, n3, n4) \
+  ION_HASH_VALUE3(n1, n2, n3);          \
+  ION_HASH_VALUE1(n4)
+#define ION_HASH_VALUE6(n1, n2, n3, n4, n5, n6) \
+  ION_HASH_VALUE4(n1, n2, n3, n4);              \
+  ION_HASH_VALUE2(n5, n6)
+#define ION_HASH_VALUE_(HASH_VALUE_MACRO, ...) HASH_VALUE_MACRO(__VA_ARGS__)
+
+// Hashes the passed members of data_ only if the value is set.
+#define ION_HASH_VALUE(enum_name, ...)                                   \
+  if (data_.values_set.test(enum_name)) {                                \
+    ION_HASH_VALUE_(                                                     \
+        ION_ARGCOUNT_XCONCAT(ION_HASH_VALUE, ION_ARGCOUNT(__VA_ARGS__)), \
+        __VA_ARGS__);                                                    \
+  }
+
+size_t StateTable::GetHash() const {
+  if (hash_)
+    return hash_;
+
+  // Unset capabilities and values do not contribute to the hash.
+  const std::bitset<kNumCapabilities> enabled =
+      data_.capabilities & data_.capabilities_set;
+  uint64 hash = kHashSeed;
+  hash = HashBytes(hash, data_.capabilities_set.to_ulong());
+  hash = HashBytes(hash, enabled.to_ulong());
+  hash = HashBytes(hash, data_.values_set.to_ulong());
+  hash = HashBytes(hash, data_.is_enforced);
+  ION_HASH_VALUE(kBlendColorValue, blend_color)
+  ION_HASH_VALUE(kBlendEquationsValue, rgb_blend_equation,
+                 alpha_blend_equation)
+  ION_HASH_VALUE(kBlendFunctionsValue,
+                 rgb_blend_source_factor,
+                 rgb_blend_destination_factor,
+                 alpha_blend_source_factor,
+                 alpha_blend_destination_factor)
+  ION_HASH_VALUE(kClearColorValue, clear_color)
+  ION_HASH_VALUE(kClearDepthValue, clear_depth_value)
+  ION_HASH_VALUE(kClearStencilValue, clear_stencil_value)
+  ION_HASH_VALUE(kColorWriteMasksValue, color_write_masks)
+  ION_HASH_VALUE(kCullFaceModeValue, cull_face_mode)
+  ION_HASH_VALUE(kDepthWriteMaskValue, depth_write_mask)
+  ION_HASH_VALUE(kFrontFaceModeValue, front_face_mode)
+  ION_HASH_VALUE(kDepthFunctionValue, depth_function)
+  ION_HASH_VALUE(kDepthRangeValue, depth_range)
+  ION_HASH_VALUE(kDrawBufferValue, draw_buffer)
+  ION_HASH_VALUE(kHintsValue, hints)
+  ION_HASH_VALUE(kLineWidthValue, line_width)
+  ION_HASH_VALUE(
+      kPolygonOffsetValue, polygon_offset_factor, polygon_offset_units)
+  ION_HASH_VALUE(
+      kSampleCoverageValue, sample_coverage_value, sample_coverage_inverted)
+  ION_HASH_VALUE(kScissorBoxValue, scissor_box)
+  ION_HASH_VALUE(kStencilFunctionsValue,
+                 front_stencil_function,
+                 back_stencil_function,
+                 front_stencil_reference_value,
+                 back_stencil_reference_value,
+                 front_stencil_mask,
+                 back_stencil_mask)
+  ION_HASH_VALUE(kStencilOperationsValue,
+                 front_stencil_fail_op,
+                 front_stencil_depth_fail_op,
+                 front_stencil_pass_op,
+                 back_stencil_fail_op,
+                 back_stencil_depth_fail_op,
+                 back_stencil_pass_op)
+  ION_HASH_VALUE(kStencilWriteMasksValue,
+                 front_stencil_write_mask,
+                 back_stencil_write_mask)
+  ION_HASH_VALUE(kViewportValue, viewport)
+
+  // Zero indicates that the hash has not been computed.
+  hash_ = static_cast<size_t>(hash) ? static_cast<size_t>(hash) : 1U;
+  return hash_;
+}
+
+#undef ION_HASH_VALUE
+#undef ION_HASH_VALUE_
+#undef ION_HASH_VALUE1
+#undef ION_HASH_VALUE2
+#undef ION_HASH_VALUE3
+#undef ION_HASH_VALUE4
+#undef ION_HASH_VALUE6
+
+// Definitions for each number of arguments.
+#define ION_COMPARE_VALUE1(n) \
+  if (!AreBytesEqual(st0.data_.n, st1.data_.n)) return false
+#define ION_COMPARE_VALUE2(n1, n2) \
+  ION_COMPARE_VALUE1(n1);          \
+  ION_COMPARE_VALUE1(n2)
+#define ION_COMPARE_VALUE3(n1, n2, n3) \
+  ION_COMPARE_VALUE2(n1, n2);          \
+  ION_COMPARE_VALUE1(n3)
+#define ION_COMPARE_VALUE4(n1, n2, n3, n4) \
+  ION_COMPARE_VALUE3(n1, n2, n3);          \
+  ION_COMPARE_VALUE1(n4)
+#define ION_COMPARE_VALUE6(n1, n2, n3, n4, n5, n6) \
+  ION_COMPARE_VALUE4(n1, n2, n3, n4);              \
+  ION_COMPARE_VALUE2(n5, n6)
+#define ION_COMPARE_VALUE_(COMPARE_VALUE_MACRO, ...) \
+  COMPARE_VALUE_MACRO(__VA_ARGS__)
+
+// Compares the passed members of the two Data instances only if the value is
+// set. Both instances have the same values set when this is used.
+#define ION_COMPARE_VALUE(enum_name, ...)                                   \
+  if (st0.data_.values_set.test(enum_name)) {                               \
+    ION_COMPARE_VALUE_(                                                     \
+        ION_ARGCOUNT_XCONCAT(ION_COMPARE_VALUE, ION_ARGCOUNT(__VA_ARGS__)), \
+        __VA_ARGS__);                                                       \
+  }
+
+bool StateTable::AreSetItemsSame(const StateTable& st0,
+                                 const StateTable& st1) {
+  if (&st0 == &st1)
+    return true;
+  // Differing hashes always mean differing items, and are cheap to compare
+  // once cached.
+  if (st0.GetHash() != st1.GetHash() ||
+      st0.data_.capabilities_set != st1.data_.capabilities_set ||
+      st0.data_.values_set != st1.data_.values_set ||
+      st0.data_.is_enforced != st1.data_.is_enforced ||
+      (st0.data_.capabilities & st0.data_.capabilities_set) !=
+          (st1.data_.capabilities & st1.data_.capabilities_set))
+    return false;
+
+  ION_COMPARE_VALUE(kBlendColorValue, blend_color)
+  ION_COMPARE_VALUE(kBlendEquationsValue, rgb_blend_equation,
+                    alpha_blend_equation)
+  ION_COMPARE_VALUE(kBlendFunctionsValue,
+                    rgb_blend_source_factor,
+                    rgb_blend_destination_factor,
+                    alpha_blend_source_factor,
+                    alpha_blend_destination_factor)
+  ION_COMPARE_VALUE(kClearColorValue, clear_color)
+  ION_COMPARE_VALUE(kClearDepthValue, clear_depth_value)
+  ION_COMPARE_VALUE(kClearStencilValue, clear_stencil_value)
+  ION_COMPARE_VALUE(kColorWriteMasksValue, color_write_masks)
+  ION_COMPARE_VALUE(kCullFaceModeValue, cull_face_mode)
+  ION_COMPARE_VALUE(kDepthWriteMaskValue, depth_write_mask)
+  ION_COMPARE_VALUE(kFrontFaceModeValue, front_face_mode)
+  ION_COMPARE_VALUE(kDepthFunctionValue, depth_function)
+  ION_COMPARE_VALUE(kDepthRangeValue, depth_range)
+  ION_COMPARE_VALUE(kDrawBufferValue, draw_buffer)
+  ION_COMPARE_VALUE(kHintsValue, hints)
+  ION_COMPARE_VALUE(kLineWidthValue, line_width)
+  ION_COMPARE_VALUE(
+      kPolygonOffsetValue, polygon_offset_factor, polygon_offset_units)
+  ION_COMPARE_VALUE(
+      kSampleCoverageValue, sample_coverage_value, sample_coverage_inverted)
+  ION_COMPARE_VALUE(kScissorBoxValue, scissor_box)
+  ION_COMPARE_VALUE(kStencilFunctionsValue,
+                    front_stencil_function,
+                    back_stencil_function,
+                    front_stencil_reference_value,
+                    back_stencil_reference_value,
+                    front_stencil_mask,
+                    back_stencil_mask)
+  ION_COMPARE_VALUE(kStencilOperationsValue,
+                    front_stencil_fail_op,
+                    front_stencil_depth_fail_op,
+                    front_stencil_pass_op,
+                    back_stencil_fail_op,
+                    back_stencil_depth_fail_op,
+                    back_stencil_pass_op)
+  ION_COMPARE_VALUE(kStencilWriteMasksValue,
+                    front_stencil_write_mask,
+                    back_stencil_write_mask)
+  ION_COMPARE_VALUE(kViewportValue, viewport)
+  return true;
+}
+
+#undef ION_COMPARE_VALUE
+#undef ION_COMPARE_VALUE_
+#undef ION_COMPARE_VALUE1
+#undef ION_COMPARE_VALUE2
+#undef ION_COMPARE_VALUE3
+#undef ION_COMPARE_VALUE4
+#undef ION_COMPARE_VALUE6
+
 //---------------------------------------------------------------------------
 // Generic value item functions.
 void StateTable::ResetValue(Value value) {
@@ -270,6 +488,7 @@ void StateTable::ResetValue(Value value) {
   }
 
   // Indicate that the value is no longer set in the instance.
+  InvalidateHash();
   data_.values_set.reset(value);
 
 #undef ION_COPY_VAL
@@ -280,6 +499,7 @@ void StateTable::ResetValue(Value value) {
 
 void StateTable::SetBlendColor(const math::Vector4f& color) {
   data_.blend_color = color;
+  InvalidateHash();
   data_.values_set.set(kBlendColorValue);
 }
 
@@ -287,6 +507,7 @@ void StateTable::SetBlendEquations(BlendEquation rgb_eq,
                                    BlendEquation alpha_eq) {
   data_.rgb_blend_equation = rgb_eq;
   data_.alpha_blend_equation = alpha_eq;
+  InvalidateHash();
   data_.values_set.set(kBlendEquationsValue);
 }
 
@@ -299,6 +520,7 @@ void StateTable::SetBlendFunctions(
   data_.rgb_blend_destination_factor = rgb_destination_factor;
   data_.alpha_blend_source_factor = alpha_source_factor;
   data_.alpha_blend_destination_factor = alpha_destination_factor;
+  InvalidateHash();
   data_.values_set.set(kBlendFunctionsValue);
 }
 
@@ -307,6 +529,7 @@ void StateTable::SetBlendFunctions(
 
 void StateTable::SetClearColor(const math::Vector4f& color) {
   data_.clear_color = color;
+  InvalidateHash();
   data_.values_set.set(kClearColorValue);
 }
 
@@ -316,6 +539,7 @@ void StateTable::SetColorWriteMasks(bool red, bool green,
   data_.color_write_masks[1] = green;
   data_.color_write_masks[2] = blue;
   data_.color_write_masks[3] = alpha;
+  InvalidateHash();
   data_.values_set.set(kColorWriteMasksValue);
 }
 
@@ -324,6 +548,7 @@ void StateTable::SetColorWriteMasks(bool red, bool green,
 
 void StateTable::SetCullFaceMode(CullFaceMode mode) {
   data_.cull_face_mode = mode;
+  InvalidateHash();
   data_.values_set.set(kCullFaceModeValue);
 }
 
@@ -331,6 +556,7 @@ void StateTable::SetCullFaceMode(CullFaceMode mode) {
 // kCounterClockwise.
 void StateTable::SetFrontFaceMode(FrontFaceMode mode) {
   data_.front_face_mode = mode;
+  InvalidateHash();
   data_.values_set.set(kFrontFaceModeValue);
 }
 
@@ -339,21 +565,25 @@ void StateTable::SetFrontFaceMode(FrontFaceMode mode) {
 
 void StateTable::SetClearDepthValue(float value) {
   data_.clear_depth_value = value;
+  InvalidateHash();
   data_.values_set.set(kClearDepthValue);
 }
 
 void StateTable::SetDepthFunction(DepthFunction func) {
   data_.depth_function = func;
+  InvalidateHash();
   data_.values_set.set(kDepthFunctionValue);
 }
 
 void StateTable::SetDepthRange(const math::Range1f& range) {
   data_.depth_range = range;
+  InvalidateHash();
   data_.values_set.set(kDepthRangeValue);
 }
 
 void StateTable::SetDepthWriteMask(bool mask) {
   data_.depth_write_mask = mask;
+  InvalidateHash();
   data_.values_set.set(kDepthWriteMaskValue);
 }
 
@@ -362,6 +592,7 @@ void StateTable::SetDepthWriteMask(bool mask) {
 
 void StateTable::SetDrawBuffer(DrawBuffer draw_buffer) {
   data_.draw_buffer = draw_buffer;
+  InvalidateHash();
   data_.values_set.set(kDrawBufferValue);
 }
 
@@ -370,6 +601,7 @@ void StateTable::SetDrawBuffer(DrawBuffer draw_buffer) {
 
 void StateTable::SetHint(HintTarget target, HintMode mode) {
   data_.hints[target] = mode;
+  InvalidateHash();
   data_.values_set.set(kHintsValue);
 }
 
@@ -378,6 +610,7 @@ void StateTable::SetHint(HintTarget target, HintMode mode) {
 
 void StateTable::SetLineWidth(float width) {
   data_.line_width = width;
+  InvalidateHash();
   data_.values_set.set(kLineWidthValue);
 }
 
@@ -387,6 +620,7 @@ void StateTable::SetLineWidth(float width) {
 void StateTable::SetPolygonOffset(float factor, float units) {
   data_.polygon_offset_factor = factor;
   data_.polygon_offset_units = units;
+  InvalidateHash();
   data_.values_set.set(kPolygonOffsetValue);
 }
 
@@ -396,6 +630,7 @@ void StateTable::SetPolygonOffset(float factor, float units) {
 void StateTable::SetSampleCoverage(float value, bool is_inverted) {
   data_.sample_coverage_value = value;
   data_.sample_coverage_inverted = is_inverted;
+  InvalidateHash();
   data_.values_set.set(kSampleCoverageValue);
 }
 
@@ -404,6 +639,7 @@ void StateTable::SetSampleCoverage(float value, bool is_inverted) {
 
 void StateTable::SetScissorBox(const math::Range2i& box) {
   data_.scissor_box = box;
+  InvalidateHash();
   data_.values_set.set(kScissorBoxValue);
 }
 
@@ -419,6 +655,7 @@ void StateTable::SetStencilFunctions(
   data_.back_stencil_function = back_func;
   data_.back_stencil_reference_value = back_reference_value;
   data_.back_stencil_mask = back_mask;
+  InvalidateHash();
   data_.values_set.set(kStencilFunctionsValue);
 }
 
@@ -434,18 +671,21 @@ void StateTable::SetStencilOperations(StencilOperation front_stencil_fail,
   data_.back_stencil_fail_op = back_stencil_fail;
   data_.back_stencil_depth_fail_op = back_depth_fail;
   data_.back_stencil_pass_op = back_pass;
+  InvalidateHash();
   data_.values_set.set(kStencilOperationsValue);
 }
 
 // Sets/returns the value to clear stencil buffers to. The default is 0.
 void StateTable::SetClearStencilValue(int value) {
   data_.clear_stencil_value = value;
+  InvalidateHash();
   data_.values_set.set(kClearStencilValue);
 }
 
 void StateTable::SetStencilWriteMasks(uint32 front_mask, uint32 back_mask) {
   data_.front_stencil_write_mask = front_mask;
   data_.back_stencil_write_mask = back_mask;
+  InvalidateHash();
   data_.values_set.set(kStencilWriteMasksValue);
 }
 
@@ -454,6 +694,7 @@ void StateTable::SetStencilWriteMasks(uint32 front_mask, uint32 back_mask) {
 
 void StateTable::SetViewport(const math::Range2i& rect) {
   data_.viewport = rect;
+  InvalidateHash();
   data_.values_set.set(kViewportValue);
 }
 
@@ -213,12 +213,14 @@ class ION_API StateTable : public base::Referent {
   // default width and height are initialized to zero.
   StateTable()
       : default_width_(0),
-        default_height_(0) {
+        default_height_(0),
+        hash_(0) {
     Reset();
   }
   StateTable(int default_width, int default_height)
       : default_width_(default_width),
-        default_height_(default_height) {
+        default_height_(default_height),
+        hash_(0) {
     Reset();
   }
 
@@ -231,6 +233,7 @@ class ION_API StateTable : public base::Referent {
   // Resets the "set" state of the StateTable; future calls to IsValueSet() or
   // IsCapabilitySet() will return false until another setting is changed.
   void ResetSetState() {
+    InvalidateHash();
     data_.capabilities_set.reset();
     data_.values_set.reset();
   }
@@ -239,6 +242,7 @@ class ION_API StateTable : public base::Referent {
   // StateTable; future calls to IsValueSet() or IsCapabilitySet() will return
   // true until another setting is changed.
   void MarkAllSet() {
+    InvalidateHash();
     data_.capabilities_set.set();
     data_.values_set.set();
   }
@@ -266,12 +270,27 @@ class ION_API StateTable : public base::Referent {
   void MergeNonClearValuesFrom(const StateTable& other,
                                const StateTable& state_to_test);
 
+  // Returns a hash of the items that are set in the instance: which
+  // capabilities and values are set, their settings, and whether settings are
+  // enforced. Instances whose set items are identical have the same hash
+  // regardless of the contents of their unset items, so the Renderer can use
+  // it to detect that a StateTable would not change any OpenGL state. The hash
+  // is computed on demand and cached until the instance is next modified.
+  size_t GetHash() const;
+
+  // Returns true if two instances have the same items set to the same
+  // settings, with the same enforcement. Unset items are ignored, so the
+  // instances would make the same changes to OpenGL state. This is an exact
+  // test, unlike comparing the results of GetHash().
+  static bool AreSetItemsSame(const StateTable& st0, const StateTable& st1);
+
 
   //---------------------------------------------------------------------------
   // Capability item functions.
 
   // Sets a flag indicating whether a capability is enabled.
   void Enable(Capability capability, bool is_enabled) {
+    InvalidateHash();
     data_.capabilities.set(capability, is_enabled);
     data_.capabilities_set.set(capability);
   }
@@ -288,6 +307,7 @@ class ION_API StateTable : public base::Referent {
 
   // Resets a capability flag to its default state.
   void ResetCapability(Capability capability) {
+    InvalidateHash();
     if (capability == kDither)
       data_.capabilities.set(capability);
     else
@@ -340,7 +360,10 @@ class ION_API StateTable : public base::Referent {
   // Sets/returns whether enforcement is enabled. When enforcement is enabled,
   // the capabilities/values that are set in the statetable will be forced
   // applied regardless of what the original settings are.
-  void SetEnforceSettings(bool enforced) { data_.is_enforced = enforced; }
+  void SetEnforceSettings(bool enforced) {
+    InvalidateHash();
+    data_.is_enforced = enforced;
+  }
   bool AreSettingsEnforced() const { return data_.is_enforced; }
 
   //---------------------------------------------------------------------------
@@ -673,12 +696,19 @@ class ION_API StateTable : public base::Referent {
   // size into account; they are all zeroes.
   static const Data& GetDefaultData();
 
+  // Marks the cached hash returned by GetHash() as out of date. This must be
+  // called by every function that modifies data_.
+  void InvalidateHash() { hash_ = 0; }
+
   // Default width and height passed to the constructor.
   int default_width_;
   int default_height_;
 
   // Data for this instance.
   Data data_;
+
+  // Cached result of GetHash(), or 0 if it must be recomputed.
+  mutable size_t hash_;
 };
 
 // Convenience typedef for shared pointer to a StateTable.
@@ -0,0 +1,228 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/binarytrace.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ion/base/invalid.h"
+#include "ion/base/logchecker.h"
+#include "ion/base/stringutils.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/nullgraphicsmanager.h"
+#include "ion/gfx/tracecallextractor.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+// Makes calls through |gm| with arguments of every kind that a BinaryTrace
+// records.
+static void MakeCalls(GraphicsManager* gm) {
+  gm->Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  gm->Enable(GL_BLEND);
+  gm->BlendFunc(GL_ONE, GL_ZERO);
+  gm->ClearColor(0.25f, 0.5f, 0.75f, 1.f);
+  gm->DepthMask(GL_FALSE);
+  GLuint buffer = 0U;
+  gm->GenBuffers(1, &buffer);
+  gm->BindBuffer(GL_ARRAY_BUFFER, buffer);
+  gm->BufferData(GL_ARRAY_BUFFER, 12, NULL, GL_STATIC_DRAW);
+  gm->VertexAttribPointer(0U, 3, GL_FLOAT, GL_FALSE, 12,
+                          reinterpret_cast<const GLvoid*>(4));
+  gm->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  gm->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 3);
+
+  const GLuint shader = gm->CreateShader(GL_VERTEX_SHADER);
+  const GLchar* sources[1] = { "void main() {}" };
+  gm->ShaderSource(shader, 1, sources, NULL);
+  const GLuint program = gm->CreateProgram();
+  gm->GetUniformLocation(program, "uColor");
+
+  const GLfloat values[4] = { 1.f, 2.5f, 3.f, 4.f };
+  gm->Uniform4fv(0, 1, values);
+  const GLint ints[2] = { 7, -8 };
+  gm->Uniform2iv(1, 1, ints);
+  const GLfloat matrix[9] = { 1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 1.f };
+  gm->UniformMatrix3fv(2, 1, GL_FALSE, matrix);
+  gm->DrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+}  // anonymous namespace
+
+TEST(BinaryTraceTest, Function) {
+  BinaryTrace::Function none("Finish", "()");
+  EXPECT_STREQ("Finish", none.GetName());
+  EXPECT_EQ(0U, none.GetArgCount());
+
+  BinaryTrace::Function uniform(
+      "UniformMatrix3fv",
+      "(GLint location, GLsizei count, GLboolean transpose, "
+      "const GLmatrix3* value)");
+  ASSERT_EQ(4U, uniform.GetArgCount());
+  EXPECT_EQ("GLint", uniform.GetArgType(0));
+  EXPECT_EQ("location", uniform.GetArgName(0));
+  EXPECT_EQ("const GLmatrix3*", uniform.GetArgType(3));
+  EXPECT_EQ("value", uniform.GetArgName(3));
+  EXPECT_EQ(0U, uniform.GetArrayValueCount(0));
+  EXPECT_EQ(9U, uniform.GetArrayValueCount(3));
+
+  BinaryTrace::Function vector("Uniform4fv",
+                               "(GLint location, GLsizei count, "
+                               "const GLfloat4* value)");
+  ASSERT_EQ(3U, vector.GetArgCount());
+  EXPECT_EQ("const GLfloat4*", vector.GetArgType(2));
+  EXPECT_EQ("value", vector.GetArgName(2));
+  EXPECT_EQ(4U, vector.GetArrayValueCount(2));
+}
+
+TEST(BinaryTraceTest, FormatMatchesTracingStream) {
+#if !ION_PRODUCTION
+  testing::NullGraphicsManagerPtr gm(new testing::NullGraphicsManager);
+  std::ostringstream stream;
+  BinaryTracePtr trace(new BinaryTrace);
+  gm->SetTracingStream(&stream);
+  gm->SetBinaryTrace(trace);
+  EXPECT_EQ(trace.Get(), gm->GetBinaryTrace().Get());
+
+  MakeCalls(gm.Get());
+  gm->SetTracingPrefix("    ");
+  MakeCalls(gm.Get());
+  gm->SetTracingPrefix("");
+  // Calls to glGetError() are not traced.
+  gm->GetError();
+
+  gm->SetBinaryTrace(BinaryTracePtr());
+  gm->SetTracingStream(NULL);
+  gm->DrawArrays(GL_TRIANGLES, 0, 3);
+
+  EXPECT_EQ(stream.str(), trace->Format());
+  EXPECT_EQ(0U, trace->GetDroppedRecordCount());
+  EXPECT_NE(std::string::npos,
+            trace->Format().find(
+                "    Uniform4fv(location = 0, count = 1, value = 0x"));
+  EXPECT_NE(std::string::npos, trace->Format().find("-> [1; 2.5; 3; 4]"));
+#endif
+}
+
+TEST(BinaryTraceTest, Errors) {
+#if !ION_PRODUCTION
+  base::LogChecker log_checker;
+  testing::MockVisual visual(32, 32);
+  testing::MockGraphicsManagerPtr gm(new testing::MockGraphicsManager);
+  std::ostringstream stream;
+  BinaryTracePtr trace(new BinaryTrace);
+  gm->SetTracingStream(&stream);
+  gm->SetBinaryTrace(trace);
+
+  // Errors found by error checking are recorded as text.
+  gm->EnableErrorChecking(true);
+  gm->SetErrorCode(GL_INVALID_ENUM);
+  gm->Flush();
+  gm->EnableErrorChecking(false);
+  EXPECT_TRUE(
+      log_checker.HasMessage("ERROR", "GL error before call to Flush"));
+  EXPECT_EQ(stream.str(), trace->Format());
+  EXPECT_EQ(2U, trace->GetRecordCount());
+  EXPECT_EQ("Flush()\n"
+            "*** GL error before call to Flush(): invalid enumerant\n",
+            trace->Format());
+  EXPECT_EQ(1U, trace->GetCalls().size());
+#endif
+}
+
+TEST(BinaryTraceTest, GetCalls) {
+#if !ION_PRODUCTION
+  testing::NullGraphicsManagerPtr gm(new testing::NullGraphicsManager);
+  std::ostringstream stream;
+  BinaryTracePtr trace(new BinaryTrace);
+  gm->SetTracingStream(&stream);
+  gm->SetBinaryTrace(trace);
+  MakeCalls(gm.Get());
+  trace->RecordText(">Label:\n");
+
+  // The calls match those parsed from the text, and text is skipped. Unlike
+  // parsing, formatting the calls directly leaves strings intact.
+  const std::vector<std::string> calls = trace->GetCalls();
+  TraceCallExtractor text_extractor(stream.str());
+  const std::vector<std::string>& text_calls = text_extractor.GetCalls();
+  ASSERT_EQ(text_calls.size(), calls.size());
+  for (size_t i = 0; i < calls.size(); ++i) {
+    if (!base::StartsWith(calls[i], "ShaderSource")) {
+      EXPECT_EQ(text_calls[i], calls[i]);
+    }
+  }
+  EXPECT_EQ("Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)", calls[0]);
+  const size_t index = text_extractor.GetNthIndexOf(0U, "ShaderSource");
+  ASSERT_NE(base::kInvalidIndex, index);
+  EXPECT_TRUE(base::EndsWith(text_calls[index],
+                             "1, [\"void main,  {}\",  ...], NULL)"));
+  EXPECT_TRUE(
+      base::EndsWith(calls[index], "1, [\"void main() {}\", ...], NULL)"));
+
+  TraceCallExtractor extractor(*trace);
+  EXPECT_EQ(calls, extractor.GetCalls());
+  EXPECT_EQ(2U, extractor.GetCountOf("TexParameteri(GL_TEXTURE_2D"));
+  EXPECT_EQ(1U, extractor.GetCountOf("DrawArrays(GL_TRIANGLES, 0, 3)"));
+  extractor.SetTrace(stream.str());
+  EXPECT_EQ(text_calls, extractor.GetCalls());
+#endif
+}
+
+TEST(BinaryTraceTest, RingBuffer) {
+  // Each of these text records takes three words.
+  BinaryTracePtr trace(new BinaryTrace(10U));
+  EXPECT_EQ(0U, trace->GetRecordCount());
+  EXPECT_EQ("", trace->Format());
+  trace->RecordText("first\n");
+  trace->RecordText("second\n");
+  trace->RecordText("third\n");
+  EXPECT_EQ(3U, trace->GetRecordCount());
+  EXPECT_EQ(0U, trace->GetDroppedRecordCount());
+  EXPECT_EQ("first\nsecond\nthird\n", trace->Format());
+
+  // The oldest records are dropped to make room for new ones.
+  trace->RecordText("fourth\n");
+  EXPECT_EQ(3U, trace->GetRecordCount());
+  EXPECT_EQ(1U, trace->GetDroppedRecordCount());
+  EXPECT_EQ("second\nthird\nfourth\n", trace->Format());
+  trace->RecordText("a much longer line\n");
+  EXPECT_EQ(2U, trace->GetRecordCount());
+  EXPECT_EQ(3U, trace->GetDroppedRecordCount());
+  EXPECT_EQ("fourth\na much longer line\n", trace->Format());
+
+  // Records that never fit are dropped.
+  trace->RecordText(std::string(100U, 'x'));
+  EXPECT_EQ(2U, trace->GetRecordCount());
+  EXPECT_EQ(4U, trace->GetDroppedRecordCount());
+  EXPECT_TRUE(trace->GetCalls().empty());
+
+  trace->Clear();
+  EXPECT_EQ(0U, trace->GetRecordCount());
+  EXPECT_EQ(0U, trace->GetDroppedRecordCount());
+  EXPECT_EQ("", trace->Format());
+  trace->RecordText("again\n");
+  EXPECT_EQ("again\n", trace->Format());
+}
+
+}  // namespace gfx
+}  // namespace ion
@@ -261,6 +261,15 @@ TEST_F(BufferObjectTest, ModifyRanges) {
   EXPECT_FALSE(resource_->AnyModifiedBitsSet());
   bo_->SetSubData(math::Range1ui(0, 10), data_null);
   EXPECT_FALSE(resource_->AnyModifiedBitsSet());
+
+  // Coalescing settings do not set a bit.
+  EXPECT_EQ(0U, bo_->GetSubDataMergeGap());
+  EXPECT_EQ(1.f, bo_->GetSubDataReplaceFraction());
+  bo_->SetSubDataMergeGap(64U);
+  bo_->SetSubDataReplaceFraction(0.25f);
+  EXPECT_EQ(64U, bo_->GetSubDataMergeGap());
+  EXPECT_EQ(0.25f, bo_->GetSubDataReplaceFraction());
+  EXPECT_FALSE(resource_->AnyModifiedBitsSet());
 }
 
 TEST_F(BufferObjectTest, MappedData) {
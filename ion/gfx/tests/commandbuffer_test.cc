@@ -0,0 +1,159 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfx/commandbuffer.h"
+
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "ion/gfx/framecapture.h"
+#include "ion/gfx/tests/nullgraphicsmanager.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+typedef FrameCapture::Arg Arg;
+typedef FrameCapture::Call Call;
+
+// Records the calls that draw something with the passed program and color.
+static void RecordDraw(CommandBuffer* commands, GLuint program, GLfloat red) {
+  const GLfloat color[4] = { red, 0.5f, 0.25f, 1.f };
+  ION_RECORD_GL_CALL(commands, UseProgram, program);
+  ION_RECORD_GL_CALL(commands, Uniform4fv, 2, 1,
+                     CommandBuffer::Data(color, 4));
+  ION_RECORD_GL_CALL(commands, DrawElements, GL_TRIANGLES, 6,
+                     GL_UNSIGNED_SHORT, reinterpret_cast<const GLvoid*>(12));
+}
+
+}  // anonymous namespace
+
+TEST(CommandBufferTest, RecordAndReplay) {
+  testing::NullGraphicsManagerPtr gm(new testing::NullGraphicsManager);
+  CommandBufferPtr commands(new CommandBuffer);
+  EXPECT_EQ(0U, commands->GetCallCount());
+  EXPECT_EQ(0U, commands->GetSize());
+
+  // Recording does not make any calls.
+  testing::NullGraphicsManager::ResetCallCounts();
+  ION_RECORD_GL_CALL(commands, Enable, GL_BLEND);
+  // Arguments are converted to the types of the parameters.
+  ION_RECORD_GL_CALL(commands, ClearColor, 1, 0.5, 0.f, 1);
+  ION_RECORD_GL_CALL(commands, Flush);
+  RecordDraw(commands.Get(), 3U, 1.f);
+  EXPECT_EQ(6U, commands->GetCallCount());
+  EXPECT_LT(0U, commands->GetSize());
+  EXPECT_EQ(0, testing::NullGraphicsManager::GetCallCount("DrawElements"));
+
+  commands->Replay(gm.Get());
+  commands->Replay(gm.Get());
+  EXPECT_EQ(2, testing::NullGraphicsManager::GetCallCount("Enable"));
+  EXPECT_EQ(2, testing::NullGraphicsManager::GetCallCount("ClearColor"));
+  EXPECT_EQ(2, testing::NullGraphicsManager::GetCallCount("Flush"));
+  EXPECT_EQ(2, testing::NullGraphicsManager::GetCallCount("UseProgram"));
+  EXPECT_EQ(2, testing::NullGraphicsManager::GetCallCount("Uniform4fv"));
+  EXPECT_EQ(2, testing::NullGraphicsManager::GetCallCount("DrawElements"));
+
+#if !ION_PRODUCTION
+  // Check the replayed arguments.
+  FrameCapturePtr capture(new FrameCapture);
+  gm->SetFrameCapture(capture);
+  commands->Replay(gm.Get());
+  gm->SetFrameCapture(FrameCapturePtr());
+  const std::vector<Call>& calls = capture->GetCalls();
+  ASSERT_EQ(6U, calls.size());
+  EXPECT_EQ("Enable", calls[0].name);
+  EXPECT_EQ(static_cast<uint64>(GL_BLEND), calls[0].args[0].value);
+  EXPECT_EQ("ClearColor", calls[1].name);
+  GLfloat value;
+  memcpy(&value, &calls[1].args[1].value, sizeof(value));
+  EXPECT_EQ(0.5f, value);
+  EXPECT_EQ("Flush", calls[2].name);
+  EXPECT_TRUE(calls[2].args.empty());
+  EXPECT_EQ("UseProgram", calls[3].name);
+  EXPECT_EQ(3U, calls[3].args[0].value);
+  EXPECT_EQ("Uniform4fv", calls[4].name);
+  EXPECT_EQ(2U, calls[4].args[0].value);
+  ASSERT_EQ(4U * sizeof(GLfloat), calls[4].args[2].data.size());
+  memcpy(&value, &calls[4].args[2].data[sizeof(value)], sizeof(value));
+  EXPECT_EQ(0.5f, value);
+  // The index pointer is an offset and is recorded as is.
+  EXPECT_EQ("DrawElements", calls[5].name);
+  EXPECT_EQ(Arg::kValue, calls[5].args[3].kind);
+  EXPECT_EQ(12U, calls[5].args[3].value);
+#endif
+
+  // Clearing keeps the storage, so recording the same calls again does not
+  // reallocate.
+  const size_t size = commands->GetSize();
+  commands->Clear();
+  EXPECT_EQ(0U, commands->GetCallCount());
+  EXPECT_EQ(0U, commands->GetSize());
+  testing::NullGraphicsManager::ResetCallCounts();
+  commands->Replay(gm.Get());
+  EXPECT_EQ(0, testing::NullGraphicsManager::GetCallCount("Enable"));
+  ION_RECORD_GL_CALL(commands, Enable, GL_BLEND);
+  EXPECT_EQ(1U, commands->GetCallCount());
+  EXPECT_GT(size, commands->GetSize());
+}
+
+TEST(CommandBufferTest, RecordOnWorkerThreads) {
+  // Each thread records a partition of the scene into its own buffer, and the
+  // buffers are replayed in order.
+  static const int kThreadCount = 4;
+  std::vector<CommandBufferPtr> buffers;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kThreadCount; ++i)
+    buffers.push_back(CommandBufferPtr(new CommandBuffer));
+  for (int i = 0; i < kThreadCount; ++i) {
+    CommandBuffer* commands = buffers[i].Get();
+    threads.push_back(std::thread([commands, i]() {
+      for (int j = 0; j < 100; ++j)
+        RecordDraw(commands, static_cast<GLuint>(i + 1),
+                   static_cast<GLfloat>(j));
+    }));
+  }
+  for (int i = 0; i < kThreadCount; ++i)
+    threads[i].join();
+
+  testing::NullGraphicsManagerPtr gm(new testing::NullGraphicsManager);
+#if !ION_PRODUCTION
+  FrameCapturePtr capture(new FrameCapture);
+  gm->SetFrameCapture(capture);
+#endif
+  testing::NullGraphicsManager::ResetCallCounts();
+  for (int i = 0; i < kThreadCount; ++i) {
+    EXPECT_EQ(300U, buffers[i]->GetCallCount());
+    buffers[i]->Replay(gm.Get());
+  }
+  EXPECT_EQ(400, testing::NullGraphicsManager::GetCallCount("DrawElements"));
+#if !ION_PRODUCTION
+  gm->SetFrameCapture(FrameCapturePtr());
+  const std::vector<Call>& calls = capture->GetCalls();
+  ASSERT_EQ(1200U, calls.size());
+  EXPECT_EQ(1U, calls[0].args[0].value);
+  EXPECT_EQ(2U, calls[300].args[0].value);
+  EXPECT_EQ(4U, calls[900].args[0].value);
+  GLfloat red;
+  memcpy(&red, &calls[304].args[2].data[0], sizeof(red));
+  EXPECT_EQ(1.f, red);
+#endif
+}
+
+}  // namespace gfx
+}  // namespace ion
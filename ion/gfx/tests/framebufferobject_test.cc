@@ -522,6 +522,14 @@ TEST_F(FramebufferObjectTest, Cubemaps) {
     EXPECT_TRUE(stencil.GetCubeMapTexture().Get() == nullptr);
   }
 
+  // Attaching another face of the same texture is a change.
+  fbo_->SetColorAttachment(
+      0U, FramebufferObject::Attachment(color_tex, CubeMapTexture::kPositiveX));
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      FramebufferObject::kColorAttachmentChanged));
+  fbo_->SetColorAttachment(0U, color);
+  resource_->ResetModifiedBit(FramebufferObject::kColorAttachmentChanged);
+
   fbo_->SetDepthAttachment(depth);
   EXPECT_TRUE(resource_->TestOnlyModifiedBit(
       FramebufferObject::kDepthAttachmentChanged));
@@ -774,6 +782,65 @@ TEST_F(FramebufferObjectTest, Textures) {
   EXPECT_FALSE(resource_->AnyModifiedBitsSet());
 }
 
+TEST_F(FramebufferObjectTest, MultiviewTextures) {
+  TexturePtr texture(new Texture);
+  FramebufferObject::Attachment stereo(texture, 0U, 0U, 2U);
+  FramebufferObject::Attachment right(texture, 1U, 1U, 1U);
+  EXPECT_EQ(FramebufferObject::kMultiviewTexture, stereo.GetBinding());
+  EXPECT_EQ(0U, stereo.GetBaseViewIndex());
+  EXPECT_EQ(2U, stereo.GetNumViews());
+  EXPECT_EQ(1U, right.GetMipLevel());
+  EXPECT_EQ(1U, right.GetBaseViewIndex());
+  EXPECT_EQ(1U, right.GetNumViews());
+  EXPECT_TRUE(stereo != right);
+  // Other attachments have no views, and an attachment without views or a
+  // texture is unbound.
+  EXPECT_EQ(0U, FramebufferObject::Attachment(texture).GetNumViews());
+  EXPECT_EQ(FramebufferObject::kUnbound,
+            FramebufferObject::Attachment(texture, 0U, 0U, 0U).GetBinding());
+  EXPECT_EQ(FramebufferObject::kUnbound,
+            FramebufferObject::Attachment(TexturePtr(), 0U, 0U, 2U)
+                .GetBinding());
+
+  fbo_->SetColorAttachment(0U, stereo);
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      FramebufferObject::kColorAttachmentChanged));
+  resource_->ResetModifiedBit(FramebufferObject::kColorAttachmentChanged);
+  EXPECT_EQ(2U, fbo_->GetColorAttachment(0U).GetNumViews());
+  fbo_->SetColorAttachment(0U, right);
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      FramebufferObject::kColorAttachmentChanged));
+  resource_->ResetModifiedBit(FramebufferObject::kColorAttachmentChanged);
+
+  // Changes to the texture propagate to the framebuffer.
+  texture->SetBaseLevel(1);
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      FramebufferObject::kColorAttachmentChanged));
+}
+
+TEST_F(FramebufferObjectTest, MultisampledTextures) {
+  TexturePtr texture(new Texture);
+  const FramebufferObject::Attachment multisampled =
+      FramebufferObject::Attachment::CreateMultisampledTexture(texture, 4U);
+  EXPECT_EQ(FramebufferObject::kTexture, multisampled.GetBinding());
+  EXPECT_EQ(texture.Get(), multisampled.GetTexture().Get());
+  EXPECT_EQ(4U, multisampled.GetSamples());
+  EXPECT_EQ(0U, multisampled.GetMipLevel());
+  EXPECT_TRUE(multisampled != FramebufferObject::Attachment(texture));
+  EXPECT_EQ(FramebufferObject::kUnbound,
+            FramebufferObject::Attachment::CreateMultisampledTexture(
+                TexturePtr(), 4U).GetBinding());
+  EXPECT_EQ(0U, FramebufferObject::Attachment::CreateMultisampledTexture(
+                    TexturePtr(), 4U).GetSamples());
+
+  fbo_->SetColorAttachment(0U, FramebufferObject::Attachment(texture));
+  resource_->ResetModifiedBit(FramebufferObject::kColorAttachmentChanged);
+  fbo_->SetColorAttachment(0U, multisampled);
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      FramebufferObject::kColorAttachmentChanged));
+  EXPECT_EQ(4U, fbo_->GetColorAttachment(0U).GetSamples());
+}
+
 TEST_F(FramebufferObjectTest, Notifications) {
   // Check that modifying a Texture sends notifications to an owning
   // FramebufferObject, ensuring that attachments are rebound.
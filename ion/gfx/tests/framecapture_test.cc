@@ -0,0 +1,191 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/framecapture.h"
+
+#include <string>
+#include <vector>
+
+#include "ion/gfx/tests/nullgraphicsmanager.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+typedef FrameCapture::Arg Arg;
+typedef FrameCapture::Call Call;
+
+// Makes some calls through |gm| that read data of different kinds.
+static void MakeCalls(GraphicsManager* gm) {
+  GLuint buffer = 0U;
+  gm->GenBuffers(1, &buffer);
+  gm->BindBuffer(GL_ARRAY_BUFFER, buffer);
+  const GLfloat vertices[3] = { 1.f, 2.f, 3.f };
+  gm->BufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+  // Rows of RGB pixels are padded to 4 bytes, except for the last.
+  const uint8 pixels[21] = { 0 };
+  gm->TexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 3, 2, 0, GL_RGB, GL_UNSIGNED_BYTE,
+                 pixels);
+
+  const GLuint shader = gm->CreateShader(GL_VERTEX_SHADER);
+  const GLchar* sources[2] = { "void main() {", "}" };
+  const GLint lengths[2] = { 13, -1 };
+  gm->ShaderSource(shader, 2, sources, lengths);
+
+  const GLfloat values[8] = { 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f };
+  gm->Uniform4fv(0, 2, values);
+  gm->DrawArrays(GL_TRIANGLES, 0, 3);
+  gm->GetError();
+}
+
+// Returns the data of |arg| as a string.
+static const std::string GetData(const Arg& arg) {
+  return std::string(arg.data.begin(), arg.data.end());
+}
+
+}  // anonymous namespace
+
+TEST(FrameCaptureTest, RecordCalls) {
+#if !ION_PRODUCTION
+  testing::NullGraphicsManagerPtr gm(new testing::NullGraphicsManager);
+  FrameCapturePtr capture(new FrameCapture);
+  gm->SetFrameCapture(capture);
+  EXPECT_EQ(capture.Get(), gm->GetFrameCapture().Get());
+  MakeCalls(gm.Get());
+  gm->SetFrameCapture(FrameCapturePtr());
+  gm->DrawArrays(GL_TRIANGLES, 0, 3);
+
+  // Calls to glGetError() and calls made after the capture was removed are not
+  // recorded.
+  const std::vector<Call>& calls = capture->GetCalls();
+  ASSERT_EQ(8U, calls.size());
+  EXPECT_EQ("GenBuffers", calls[0].name);
+  EXPECT_EQ(Arg::kOutput, calls[0].args[1].kind);
+  EXPECT_EQ("BindBuffer", calls[1].name);
+  EXPECT_EQ(static_cast<uint64>(GL_ARRAY_BUFFER), calls[1].args[0].value);
+
+  EXPECT_EQ("BufferData", calls[2].name);
+  ASSERT_EQ(4U, calls[2].args.size());
+  EXPECT_EQ(Arg::kData, calls[2].args[2].kind);
+  ASSERT_EQ(3U * sizeof(GLfloat), calls[2].args[2].data.size());
+  GLfloat vertex;
+  memcpy(&vertex, &calls[2].args[2].data[sizeof(vertex)], sizeof(vertex));
+  EXPECT_EQ(2.f, vertex);
+
+  EXPECT_EQ("TexImage2D", calls[3].name);
+  EXPECT_EQ(Arg::kData, calls[3].args[8].kind);
+  EXPECT_EQ(21U, calls[3].args[8].data.size());
+
+  EXPECT_EQ("CreateShader", calls[4].name);
+  EXPECT_EQ("ShaderSource", calls[5].name);
+  EXPECT_EQ(Arg::kStringArray, calls[5].args[2].kind);
+  EXPECT_EQ(2U, calls[5].args[2].value);
+  EXPECT_EQ(std::string("void main() {\0}\0", 16), GetData(calls[5].args[2]));
+  // The strings are terminated, so the lengths are dropped.
+  EXPECT_EQ(Arg::kValue, calls[5].args[3].kind);
+  EXPECT_EQ(0U, calls[5].args[3].value);
+
+  EXPECT_EQ("Uniform4fv", calls[6].name);
+  EXPECT_EQ(8U * sizeof(GLfloat), calls[6].args[2].data.size());
+  EXPECT_EQ("DrawArrays", calls[7].name);
+  EXPECT_EQ(3U, calls[7].args[2].value);
+
+  capture->Clear();
+  EXPECT_TRUE(capture->GetCalls().empty());
+#endif
+}
+
+TEST(FrameCaptureTest, SerializeAndDeserialize) {
+#if !ION_PRODUCTION
+  testing::NullGraphicsManagerPtr gm(new testing::NullGraphicsManager);
+  FrameCapturePtr capture(new FrameCapture);
+  gm->SetFrameCapture(capture);
+  MakeCalls(gm.Get());
+  gm->SetFrameCapture(FrameCapturePtr());
+
+  const std::string serialized = capture->Serialize();
+  FrameCapturePtr copy(new FrameCapture);
+  EXPECT_TRUE(copy->Deserialize(serialized));
+  const std::vector<Call>& calls = capture->GetCalls();
+  const std::vector<Call>& copied_calls = copy->GetCalls();
+  ASSERT_EQ(calls.size(), copied_calls.size());
+  for (size_t i = 0; i < calls.size(); ++i) {
+    SCOPED_TRACE(calls[i].name);
+    EXPECT_EQ(calls[i].name, copied_calls[i].name);
+    ASSERT_EQ(calls[i].args.size(), copied_calls[i].args.size());
+    for (size_t j = 0; j < calls[i].args.size(); ++j) {
+      EXPECT_EQ(calls[i].args[j].kind, copied_calls[i].args[j].kind);
+      EXPECT_EQ(calls[i].args[j].value, copied_calls[i].args[j].value);
+      EXPECT_EQ(calls[i].args[j].data, copied_calls[i].args[j].data);
+    }
+  }
+  EXPECT_EQ(serialized, copy->Serialize());
+
+  // Invalid and truncated data are rejected.
+  EXPECT_FALSE(copy->Deserialize("not a capture"));
+  EXPECT_TRUE(copy->GetCalls().empty());
+  EXPECT_FALSE(copy->Deserialize(serialized.substr(0, serialized.size() - 1)));
+  EXPECT_TRUE(copy->GetCalls().empty());
+  EXPECT_FALSE(copy->Deserialize(serialized + "x"));
+  EXPECT_TRUE(copy->Deserialize(FrameCapturePtr(new FrameCapture)->Serialize()));
+  EXPECT_TRUE(copy->GetCalls().empty());
+#endif
+}
+
+TEST(FrameCaptureTest, Replay) {
+#if !ION_PRODUCTION
+  testing::NullGraphicsManagerPtr gm(new testing::NullGraphicsManager);
+  FrameCapturePtr capture(new FrameCapture);
+  gm->SetFrameCapture(capture);
+  MakeCalls(gm.Get());
+  gm->SetFrameCapture(FrameCapturePtr());
+
+  // Replay a deserialized copy to make sure that it does not rely on pointers
+  // recorded during the capture.
+  FrameCapturePtr copy(new FrameCapture);
+  EXPECT_TRUE(copy->Deserialize(capture->Serialize()));
+  capture.Reset();
+
+  testing::NullGraphicsManager::ResetCallCounts();
+  const FrameCapture::ReplayTimings timings = copy->Replay(gm.Get(), 3, true);
+  EXPECT_EQ(3, timings.iteration_count);
+  EXPECT_EQ(0U, timings.skipped_count);
+  EXPECT_EQ(copy->GetCalls().size(), timings.call_ms.size());
+  EXPECT_LE(0.0, timings.total_ms);
+  EXPECT_EQ(3, testing::NullGraphicsManager::GetCallCount("GenBuffers"));
+  EXPECT_EQ(3, testing::NullGraphicsManager::GetCallCount("BufferData"));
+  EXPECT_EQ(3, testing::NullGraphicsManager::GetCallCount("ShaderSource"));
+  EXPECT_EQ(3, testing::NullGraphicsManager::GetCallCount("DrawArrays"));
+  // Each replayed call was followed by glFinish().
+  EXPECT_EQ(24, testing::NullGraphicsManager::GetCallCount("Finish"));
+
+  // Calls to unknown functions are skipped.
+  FrameCapturePtr unknown(new FrameCapture);
+  unknown->RecordCall("NotAFunction", 1);
+  unknown->RecordCall("DrawArrays", GL_TRIANGLES);
+  const FrameCapture::ReplayTimings skipped =
+      unknown->Replay(gm.Get(), 1, false);
+  EXPECT_EQ(1, skipped.iteration_count);
+  EXPECT_EQ(2U, skipped.skipped_count);
+#endif
+}
+
+}  // namespace gfx
+}  // namespace ion
@@ -25,9 +25,12 @@
       'sources' : [
         'attribute_test.cc',
         'attributearray_test.cc',
+        'binarytrace_test.cc',
         'bufferobject_test.cc',
+        'commandbuffer_test.cc',
         'cubemaptexture_test.cc',
         'framebufferobject_test.cc',
+        'framecapture_test.cc',
         'glplatformcaps.inc',
         'graphicsmanager_test.cc',
         'image_test.cc',
@@ -35,6 +38,9 @@
         'mockgraphicsmanager_test.cc',
         'mockresource_test.cc',
         'node_test.cc',
+        'nullgraphicsmanager_test.cc',
+        'programbinarycache_test.cc',
+        'query_test.cc',
         'renderer_test.cc',
         'resourcemanager_test.cc',
         'sampler_test.cc',
@@ -46,6 +52,7 @@
         'texture_test.cc',
         'texturemanager_test.cc',
         'tracecallextractor_test.cc',
+        'transformfeedback_test.cc',
         'uniform_test.cc',
         'uniformblock_test.cc',
         'uniformholder_test.cc',
@@ -75,5 +82,21 @@
         '<(ion_dir)/portgfx/portgfx.gyp:ionportgfx_for_tests',
       ],
     },
+    {
+      # Measures the CPU cost of rendering synthetic scenes; see the comment at
+      # the top of renderer_benchmark.cc for its arguments.
+      'target_name' : 'iongfx_benchmark',
+      'includes': [ '../../dev/target_type_executable.gypi' ],
+      'sources' : [
+        'renderer_benchmark.cc',
+      ],
+      'dependencies' : [
+        '<(ion_dir)/analytics/analytics.gyp:ionanalytics',
+        '<(ion_dir)/base/base.gyp:ionbase_for_tests',
+        '<(ion_dir)/gfx/gfx.gyp:iongfx_for_tests',
+        '<(ion_dir)/port/port.gyp:ionport',
+        '<(ion_dir)/portgfx/portgfx.gyp:ionportgfx_for_tests',
+      ],
+    },
   ],
 }
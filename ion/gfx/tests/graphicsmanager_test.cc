@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/gfx/graphicsmanager.h"
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include "ion/base/logchecker.h"
@@ -563,6 +565,14 @@ TEST_F(GraphicsManagerTest, IsFunctionAvailable) {
         mgr_->IsExtensionSupported("image_external"));
   }
 
+  if (mgr_->IsFunctionGroupAvailable(
+          GraphicsManager::kInvalidateFramebuffer)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("InvalidateFramebuffer"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("InvalidateFramebuffer") &&
+                 mgr_->IsExtensionSupported("invalidate_subdata"));
+  }
+
   if (mgr_->IsFunctionGroupAvailable(GraphicsManager::kMapBuffer)) {
     EXPECT_TRUE(mgr_->IsFunctionAvailable("MapBuffer"));
   } else {
@@ -693,6 +703,101 @@ TEST_F(GraphicsManagerTest, IsFunctionAvailable) {
                  mgr_->IsExtensionSupported("texture_storage_multisample"));
   }
 
+  if (mgr_->IsFunctionGroupAvailable(GraphicsManager::kBufferStorage)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("BufferStorage"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("BufferStorage") &&
+                 mgr_->IsExtensionSupported("buffer_storage"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(
+          GraphicsManager::kUniformBufferObjects)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("BindBufferBase"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("BindBufferRange"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("GetActiveUniformBlockiv"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("GetUniformBlockIndex"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("UniformBlockBinding"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("BindBufferBase") &&
+                 mgr_->IsFunctionAvailable("BindBufferRange") &&
+                 mgr_->IsFunctionAvailable("GetActiveUniformBlockiv") &&
+                 mgr_->IsFunctionAvailable("GetUniformBlockIndex") &&
+                 mgr_->IsFunctionAvailable("UniformBlockBinding") &&
+                 mgr_->IsExtensionSupported("uniform_buffer_object"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(
+          GraphicsManager::kParallelShaderCompile)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("MaxShaderCompilerThreadsKHR"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("MaxShaderCompilerThreadsKHR") &&
+                 mgr_->IsExtensionSupported("parallel_shader_compile"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(GraphicsManager::kProgramBinary)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("GetProgramBinary"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("ProgramBinary"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("ProgramParameteri"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("GetProgramBinary") &&
+                 mgr_->IsFunctionAvailable("ProgramBinary") &&
+                 mgr_->IsFunctionAvailable("ProgramParameteri") &&
+                 mgr_->IsExtensionSupported("get_program_binary"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(
+          GraphicsManager::kProgramInterfaceQuery)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("GetProgramInterfaceiv"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("GetProgramResourceName"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("GetProgramResourceiv"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("GetProgramInterfaceiv") &&
+                 mgr_->IsFunctionAvailable("GetProgramResourceName") &&
+                 mgr_->IsFunctionAvailable("GetProgramResourceiv") &&
+                 mgr_->IsExtensionSupported("program_interface_query"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(GraphicsManager::kMultiDraw)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("MultiDrawArrays"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("MultiDrawElements"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("MultiDrawArrays") &&
+                 mgr_->IsFunctionAvailable("MultiDrawElements") &&
+                 mgr_->IsExtensionSupported("multi_draw_arrays"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(GraphicsManager::kDrawIndirect)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("DrawArraysIndirect"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("DrawElementsIndirect"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("DrawArraysIndirect") &&
+                 mgr_->IsFunctionAvailable("DrawElementsIndirect") &&
+                 mgr_->IsExtensionSupported("draw_indirect"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(GraphicsManager::kComputeShader)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("BindImageTexture"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("DispatchCompute"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("DispatchComputeIndirect"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("MemoryBarrier"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("BindImageTexture") &&
+                 mgr_->IsFunctionAvailable("DispatchCompute") &&
+                 mgr_->IsFunctionAvailable("DispatchComputeIndirect") &&
+                 mgr_->IsFunctionAvailable("MemoryBarrier") &&
+                 mgr_->IsExtensionSupported("compute_shader"));
+  }
+
+  if (mgr_->IsFunctionGroupAvailable(
+          GraphicsManager::kConditionalRender)) {
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("BeginConditionalRender"));
+    EXPECT_TRUE(mgr_->IsFunctionAvailable("EndConditionalRender"));
+  } else {
+    EXPECT_FALSE(mgr_->IsFunctionAvailable("BeginConditionalRender") &&
+                 mgr_->IsFunctionAvailable("EndConditionalRender") &&
+                 mgr_->IsExtensionSupported("conditional_render"));
+  }
+
   if (mgr_->IsFunctionGroupAvailable(GraphicsManager::kInstancedDrawing)) {
     EXPECT_TRUE(mgr_->IsFunctionAvailable("DrawArraysInstanced"));
     EXPECT_TRUE(mgr_->IsFunctionAvailable("DrawElementsInstanced"));
@@ -778,6 +883,76 @@ TEST_F(GraphicsManagerTest, SetTracingPrefix) {
   EXPECT_EQ("prefix", mgr_->GetTracingPrefix());
 }
 
+TEST_F(GraphicsManagerTest, CallStatistics) {
+  // Calls are not counted when they are made directly.
+#if !ION_PRODUCTION || !defined(ION_GFX_DIRECT_GL_CALLS)
+  mock_visual_.reset(new testing::MockVisual(800, 800));
+  mgr_.Reset(new testing::MockGraphicsManager());
+  EXPECT_FALSE(mgr_->IsCallStatisticsEnabled());
+  GLuint buffer = 0U;
+  mgr_->GenBuffers(1, &buffer);
+  EXPECT_EQ(0U, mgr_->GetCallStatistics().call_count);
+  EXPECT_EQ(0U, mgr_->GetFunctionCallCount("GenBuffers"));
+
+  mgr_->EnableCallStatistics(true);
+  EXPECT_TRUE(mgr_->IsCallStatisticsEnabled());
+  const uint8 data[64] = { 0 };
+  mgr_->BindBuffer(GL_ARRAY_BUFFER, buffer);
+  mgr_->BufferData(GL_ARRAY_BUFFER, 64, data, GL_STATIC_DRAW);
+  mgr_->BufferData(GL_ARRAY_BUFFER, 128, NULL, GL_STATIC_DRAW);
+  mgr_->BufferSubData(GL_ARRAY_BUFFER, 16, 32, data);
+  GLuint texture = 0U;
+  mgr_->GenTextures(1, &texture);
+  mgr_->BindTexture(GL_TEXTURE_2D, texture);
+  mgr_->TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 4, 4, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, data);
+  mgr_->TexImage2D(GL_TEXTURE_2D, 1, GL_RGBA, 2, 2, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, NULL);
+  mgr_->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 2, 2, GL_RGB,
+                      GL_UNSIGNED_SHORT_5_6_5, data);
+  mgr_->DrawArrays(GL_TRIANGLES, 0, 6);
+  mgr_->DrawArrays(GL_TRIANGLE_STRIP, 0, 2);
+  mgr_->DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, 3);
+  mgr_->DrawElements(GL_LINES, 10, GL_UNSIGNED_SHORT, NULL);
+  const GLint firsts[] = { 0, 3 };
+  const GLsizei counts[] = { 3, 6 };
+  mgr_->MultiDrawArrays(GL_TRIANGLES, firsts, counts, 2);
+  // Clear any errors from drawing without a program.
+  mgr_->GetError();
+
+  GraphicsManager::CallStatistics statistics = mgr_->GetCallStatistics();
+  EXPECT_EQ(15U, statistics.call_count);
+  EXPECT_EQ(6U, statistics.draw_call_count);
+  // 2 + 0 + 2 * 3 + 5 + 1 + 2 primitives.
+  EXPECT_EQ(16U, statistics.primitive_count);
+  EXPECT_EQ(96U, statistics.buffer_upload_bytes);
+  EXPECT_EQ(72U, statistics.texture_upload_bytes);
+  EXPECT_EQ(2U, mgr_->GetFunctionCallCount("BufferData"));
+  EXPECT_EQ(2U, mgr_->GetFunctionCallCount("DrawArrays"));
+  EXPECT_EQ(0U, mgr_->GetFunctionCallCount("GenBuffers"));
+  EXPECT_EQ(0U, mgr_->GetFunctionCallCount("NoSuchFunction"));
+  const std::map<std::string, uint64> function_counts =
+      mgr_->GetFunctionCallCounts();
+  EXPECT_EQ(12U, function_counts.size());
+  EXPECT_EQ(1U, function_counts.at("GetError"));
+
+  // Resetting starts counting again, and nothing is counted while disabled.
+  mgr_->ResetCallStatistics();
+  statistics = mgr_->GetCallStatistics();
+  EXPECT_EQ(0U, statistics.call_count);
+  EXPECT_EQ(0U, statistics.draw_call_count);
+  EXPECT_EQ(0U, statistics.primitive_count);
+  EXPECT_EQ(0U, statistics.buffer_upload_bytes);
+  EXPECT_EQ(0U, statistics.texture_upload_bytes);
+  EXPECT_TRUE(mgr_->GetFunctionCallCounts().empty());
+  mgr_->EnableCallStatistics(false);
+  mgr_->BufferData(GL_ARRAY_BUFFER, 64, data, GL_STATIC_DRAW);
+  EXPECT_EQ(0U, mgr_->GetCallStatistics().call_count);
+  EXPECT_EQ(0U, mgr_->GetCallStatistics().buffer_upload_bytes);
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), mgr_->GetError());
+#endif
+}
+
 TEST_F(GraphicsManagerTest, DisabledFunctionGroups) {
   mock_visual_.reset(new testing::MockVisual(800, 800));
   DisablingGraphicsManager* disabling_manager = new DisablingGraphicsManager;
@@ -835,6 +1010,44 @@ TEST(MultipleGraphicsManagerTest, MultipleGraphicsManagers) {
   }
 }
 
+TEST_F(GraphicsManagerTest, SharedFunctionsAndInfo) {
+#if !defined(ION_PLATFORM_NACL) && !defined(ION_PLATFORM_ASMJS)
+  // A GraphicsManager for the same context shares what the first one looked
+  // up, and must end up in the same state as if it had looked it up itself.
+  // Query a deferred group through the first manager before creating the
+  // second, and another one only through the second.
+  const bool has_program_binary =
+      mgr_->IsFunctionGroupAvailable(GraphicsManager::kProgramBinary);
+  const GLint max_texture_size =
+      mgr_->GetCapabilityValue<int>(GraphicsManager::kMaxTextureSize);
+  GraphicsManagerPtr mgr2(new GraphicsManager);
+  EXPECT_EQ(mgr_->GetGlVersion(), mgr2->GetGlVersion());
+  EXPECT_EQ(mgr_->GetGlRenderer(), mgr2->GetGlRenderer());
+  EXPECT_EQ(mgr_->GetGlApiStandard(), mgr2->GetGlApiStandard());
+  EXPECT_EQ(mgr_->GetGlProfileType(), mgr2->GetGlProfileType());
+  EXPECT_EQ(mgr_->IsExtensionSupported("texture_storage"),
+            mgr2->IsExtensionSupported("texture_storage"));
+  EXPECT_EQ(has_program_binary,
+            mgr2->IsFunctionGroupAvailable(GraphicsManager::kProgramBinary));
+  EXPECT_EQ(max_texture_size,
+            mgr2->GetCapabilityValue<int>(GraphicsManager::kMaxTextureSize));
+  EXPECT_EQ(mgr2->IsFunctionAvailable("TransformFeedbackVaryings"),
+            mgr_->IsFunctionAvailable("TransformFeedbackVaryings"));
+  for (int i = 0; i < GraphicsManager::kNumFunctionGroupIds; ++i) {
+    const GraphicsManager::FunctionGroupId group =
+        static_cast<GraphicsManager::FunctionGroupId>(i);
+    SCOPED_TRACE(i);
+    EXPECT_EQ(mgr_->IsFunctionGroupAvailable(group),
+              mgr2->IsFunctionGroupAvailable(group));
+  }
+
+  // Disabling a deferred group before it is resolved sticks.
+  GraphicsManagerPtr mgr3(new GraphicsManager);
+  mgr3->EnableFunctionGroup(GraphicsManager::kDebugLabel, false);
+  EXPECT_FALSE(mgr3->IsFunctionGroupAvailable(GraphicsManager::kDebugLabel));
+#endif
+}
+
 #if !defined(ION_PLATFORM_ASMJS)
 
 TEST_F(ThreadedGraphicsManagerTest, ConcurrentExtensionsPositive) {
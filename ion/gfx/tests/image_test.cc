@@ -358,6 +358,18 @@ TEST(ImageTest, GetFormatString) {
             strcmp("Pvrtc1Rgba2", Image::GetFormatString(Image::kPvrtc1Rgba2)));
   EXPECT_EQ(0,
             strcmp("Pvrtc1Rgba4", Image::GetFormatString(Image::kPvrtc1Rgba4)));
+  EXPECT_EQ(0, strcmp("Etc2Rgb", Image::GetFormatString(Image::kEtc2Rgb)));
+  EXPECT_EQ(0,
+            strcmp("Etc2Rgba1", Image::GetFormatString(Image::kEtc2Rgba1)));
+  EXPECT_EQ(0, strcmp("Etc2Rgba", Image::GetFormatString(Image::kEtc2Rgba)));
+  EXPECT_EQ(0, strcmp("EacR11", Image::GetFormatString(Image::kEacR11)));
+  EXPECT_EQ(0, strcmp("EacRg11", Image::GetFormatString(Image::kEacRg11)));
+  EXPECT_EQ(0, strcmp("Astc4x4Rgba",
+                      Image::GetFormatString(Image::kAstc4x4Rgba)));
+  EXPECT_EQ(0, strcmp("Astc10x8Rgba",
+                      Image::GetFormatString(Image::kAstc10x8Rgba)));
+  EXPECT_EQ(0, strcmp("Astc12x12Rgba",
+                      Image::GetFormatString(Image::kAstc12x12Rgba)));
   EXPECT_EQ(0, strcmp("Srgb8", Image::GetFormatString(Image::kSrgb8)));
   EXPECT_EQ(0, strcmp("Srgba8", Image::GetFormatString(Image::kSrgba8)));
   EXPECT_EQ(0,
@@ -463,6 +475,13 @@ TEST(ImageTest, GetNumComponentsForFormat) {
   EXPECT_EQ(3, Image::GetNumComponentsForFormat(Image::kPvrtc1Rgb4));
   EXPECT_EQ(4, Image::GetNumComponentsForFormat(Image::kPvrtc1Rgba2));
   EXPECT_EQ(4, Image::GetNumComponentsForFormat(Image::kPvrtc1Rgba4));
+  EXPECT_EQ(3, Image::GetNumComponentsForFormat(Image::kEtc2Rgb));
+  EXPECT_EQ(4, Image::GetNumComponentsForFormat(Image::kEtc2Rgba1));
+  EXPECT_EQ(4, Image::GetNumComponentsForFormat(Image::kEtc2Rgba));
+  EXPECT_EQ(1, Image::GetNumComponentsForFormat(Image::kEacR11));
+  EXPECT_EQ(2, Image::GetNumComponentsForFormat(Image::kEacRg11));
+  EXPECT_EQ(4, Image::GetNumComponentsForFormat(Image::kAstc4x4Rgba));
+  EXPECT_EQ(4, Image::GetNumComponentsForFormat(Image::kAstc12x12Rgba));
   EXPECT_EQ(3, Image::GetNumComponentsForFormat(Image::kSrgb8));
   EXPECT_EQ(4, Image::GetNumComponentsForFormat(Image::kSrgba8));
   EXPECT_EQ(3, Image::GetNumComponentsForFormat(Image::kRgb11f_11f_10f_Rev));
@@ -562,6 +581,13 @@ TEST(ImageTest, IsCompressedFormat) {
   EXPECT_TRUE(Image::IsCompressedFormat(Image::kPvrtc1Rgb4));
   EXPECT_TRUE(Image::IsCompressedFormat(Image::kPvrtc1Rgba2));
   EXPECT_TRUE(Image::IsCompressedFormat(Image::kPvrtc1Rgba4));
+  EXPECT_TRUE(Image::IsCompressedFormat(Image::kEtc2Rgb));
+  EXPECT_TRUE(Image::IsCompressedFormat(Image::kEtc2Rgba1));
+  EXPECT_TRUE(Image::IsCompressedFormat(Image::kEtc2Rgba));
+  EXPECT_TRUE(Image::IsCompressedFormat(Image::kEacR11));
+  EXPECT_TRUE(Image::IsCompressedFormat(Image::kEacRg11));
+  EXPECT_TRUE(Image::IsCompressedFormat(Image::kAstc4x4Rgba));
+  EXPECT_TRUE(Image::IsCompressedFormat(Image::kAstc12x12Rgba));
   EXPECT_FALSE(Image::IsCompressedFormat(Image::kSrgb8));
   EXPECT_FALSE(Image::IsCompressedFormat(Image::kSrgba8));
   EXPECT_FALSE(Image::IsCompressedFormat(Image::kRgb11f_11f_10f_Rev));
@@ -790,6 +816,22 @@ TEST(ImageTest, ComputeDataSize) {
   EXPECT_EQ(0U, Image::ComputeDataSize(Image::kPvrtc1Rgba4, 20U, 0U));
   EXPECT_EQ(128U, Image::ComputeDataSize(Image::kPvrtc1Rgba4, 16U, 16U));
 
+  EXPECT_EQ(160U, Image::ComputeDataSize(Image::kEtc2Rgb, 20U, 16U));
+  EXPECT_EQ(160U, Image::ComputeDataSize(Image::kEtc2Rgba1, 20U, 16U));
+  EXPECT_EQ(160U, Image::ComputeDataSize(Image::kEacR11, 20U, 16U));
+  EXPECT_EQ(320U, Image::ComputeDataSize(Image::kEtc2Rgba, 20U, 16U));
+  EXPECT_EQ(320U, Image::ComputeDataSize(Image::kEacRg11, 20U, 16U));
+  EXPECT_EQ(8U, Image::ComputeDataSize(Image::kEacR11, 1U, 1U));
+
+  // ASTC blocks are always 16 bytes, and partial blocks are rounded up.
+  EXPECT_EQ(0U, Image::ComputeDataSize(Image::kAstc4x4Rgba, 0U, 16U));
+  EXPECT_EQ(320U, Image::ComputeDataSize(Image::kAstc4x4Rgba, 20U, 16U));
+  EXPECT_EQ(192U, Image::ComputeDataSize(Image::kAstc6x6Rgba, 20U, 16U));
+  EXPECT_EQ(192U, Image::ComputeDataSize(Image::kAstc8x5Rgba, 20U, 16U));
+  EXPECT_EQ(64U, Image::ComputeDataSize(Image::kAstc10x8Rgba, 20U, 16U));
+  EXPECT_EQ(64U, Image::ComputeDataSize(Image::kAstc12x12Rgba, 20U, 16U));
+  EXPECT_EQ(16U, Image::ComputeDataSize(Image::kAstc12x12Rgba, 1U, 1U));
+
   {
     base::LogChecker logchecker;
     base::SetBreakHandler(kNullFunction);
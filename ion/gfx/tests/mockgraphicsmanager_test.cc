@@ -2949,6 +2949,14 @@ TEST(MockGraphicsManagerTest, ArraysBuffersDrawFunctions) {
             static_cast<GLuint>(GetInt(gm, GL_ELEMENT_ARRAY_BUFFER_BINDING)));
   GM_CALL(BindVertexArray(0));
 
+  // Pixel unpack buffers are bound independently of VAOs.
+  GM_CALL(BindBuffer(GL_PIXEL_UNPACK_BUFFER, vbo));
+  EXPECT_EQ(vbo,
+            static_cast<GLuint>(GetInt(gm, GL_PIXEL_UNPACK_BUFFER_BINDING)));
+  EXPECT_EQ(0, GetInt(gm, GL_ARRAY_BUFFER_BINDING));
+  GM_CALL(BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0U));
+  EXPECT_EQ(0, GetInt(gm, GL_PIXEL_UNPACK_BUFFER_BINDING));
+
   // Bind valid buffers.
   GM_CALL(BindBuffer(GL_ARRAY_BUFFER, vbo));
   GM_CALL(BindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo2));
@@ -3061,6 +3069,277 @@ TEST(MockGraphicsManagerTest, DrawInstancedFunctions) {
   GM_CALL(DrawElementsInstanced(GL_POINTS, 2, GL_UNSIGNED_BYTE, NULL, 10));
 }
 
+TEST(MockGraphicsManagerTest, MultiDrawFunctions) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  const GLint firsts[2] = { 0, 10 };
+  const GLsizei counts[2] = { 10, 5 };
+  const GLsizei bad_counts[2] = { 10, -5 };
+  const GLvoid* const offsets[2] = { NULL, NULL };
+
+  // MultiDrawArrays.
+  // Draw mode error.
+  GM_ERROR_CALL(MultiDrawArrays(GL_NEVER, firsts, counts, 2), GL_INVALID_ENUM);
+  // Negative count.
+  GM_ERROR_CALL(MultiDrawArrays(GL_POINTS, firsts, bad_counts, 2),
+                GL_INVALID_VALUE);
+  // Negative drawcount.
+  GM_ERROR_CALL(MultiDrawArrays(GL_POINTS, firsts, counts, -1),
+                GL_INVALID_VALUE);
+  GM_CALL(MultiDrawArrays(GL_TRIANGLES, firsts, counts, 2));
+
+  // MultiDrawElements.
+  // Draw mode error.
+  GM_ERROR_CALL(
+      MultiDrawElements(GL_NEVER, counts, GL_UNSIGNED_BYTE, offsets, 2),
+      GL_INVALID_ENUM);
+  // Negative count.
+  GM_ERROR_CALL(
+      MultiDrawElements(GL_POINTS, bad_counts, GL_UNSIGNED_BYTE, offsets, 2),
+      GL_INVALID_VALUE);
+  // Bad type.
+  GM_ERROR_CALL(MultiDrawElements(GL_POINTS, counts, GL_FLOAT, offsets, 2),
+                GL_INVALID_ENUM);
+  GM_CALL(MultiDrawElements(GL_POINTS, counts, GL_UNSIGNED_SHORT, offsets, 2));
+}
+
+TEST(MockGraphicsManagerTest, IndirectDrawFunctions) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  // Room for one DrawElementsIndirectCommand.
+  const GLuint commands[5] = { 6U, 2U, 0U, 0U, 0U };
+  const GLvoid* second = reinterpret_cast<const GLvoid*>(sizeof(GLuint));
+  const GLvoid* misaligned = reinterpret_cast<const GLvoid*>(1);
+
+  // DrawArraysIndirect.
+  // No indirect buffer.
+  GM_ERROR_CALL(DrawArraysIndirect(GL_TRIANGLES, NULL), GL_INVALID_OPERATION);
+  GLuint buffer = 0U;
+  GM_CALL(GenBuffers(1, &buffer));
+  GM_CALL(BindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer));
+  GM_CALL(BufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(commands), commands,
+                     GL_STATIC_DRAW));
+  // Draw mode error.
+  GM_ERROR_CALL(DrawArraysIndirect(GL_NEVER, NULL), GL_INVALID_ENUM);
+  // Misaligned offset.
+  GM_ERROR_CALL(DrawArraysIndirect(GL_TRIANGLES, misaligned),
+                GL_INVALID_OPERATION);
+  GM_CALL(DrawArraysIndirect(GL_TRIANGLES, NULL));
+  GM_CALL(DrawArraysIndirect(GL_TRIANGLES, second));
+
+  // DrawElementsIndirect.
+  // No index buffer.
+  GM_ERROR_CALL(DrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL),
+                GL_INVALID_OPERATION);
+  GLuint indices = 0U;
+  GM_CALL(GenBuffers(1, &indices));
+  GM_CALL(BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices));
+  // Draw mode error.
+  GM_ERROR_CALL(DrawElementsIndirect(GL_NEVER, GL_UNSIGNED_SHORT, NULL),
+                GL_INVALID_ENUM);
+  // Bad type.
+  GM_ERROR_CALL(DrawElementsIndirect(GL_TRIANGLES, GL_FLOAT, NULL),
+                GL_INVALID_ENUM);
+  // The command would be read beyond the end of the buffer.
+  GM_ERROR_CALL(DrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, second),
+                GL_INVALID_OPERATION);
+  GM_CALL(DrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, NULL));
+
+  // Deleting the buffer unbinds it.
+  GM_CALL(DeleteBuffers(1, &buffer));
+  GM_ERROR_CALL(DrawArraysIndirect(GL_TRIANGLES, NULL), GL_INVALID_OPERATION);
+}
+
+TEST(MockGraphicsManagerTest, ConditionalRender) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  GLuint query = 0U;
+  GM_CALL(GenQueries(1, &query));
+  // Bad mode.
+  GM_ERROR_CALL(BeginConditionalRender(query, GL_QUERY_RESULT),
+                GL_INVALID_ENUM);
+  // Not a query.
+  GM_ERROR_CALL(BeginConditionalRender(query + 1U, GL_QUERY_WAIT),
+                GL_INVALID_VALUE);
+  // Not active.
+  GM_ERROR_CALL(EndConditionalRender(), GL_INVALID_OPERATION);
+
+  // The query cannot be active.
+  GM_CALL(BeginQuery(GL_ANY_SAMPLES_PASSED, query));
+  GM_ERROR_CALL(BeginConditionalRender(query, GL_QUERY_WAIT),
+                GL_INVALID_OPERATION);
+  GM_CALL(EndQuery(GL_ANY_SAMPLES_PASSED));
+
+  GM_CALL(BeginConditionalRender(query, GL_QUERY_NO_WAIT));
+  // Already active.
+  GM_ERROR_CALL(BeginConditionalRender(query, GL_QUERY_WAIT),
+                GL_INVALID_OPERATION);
+  GM_CALL(DrawArrays(GL_TRIANGLES, 0, 3));
+  GM_CALL(EndConditionalRender());
+  GM_CALL(BeginConditionalRender(query, GL_QUERY_WAIT));
+  GM_CALL(EndConditionalRender());
+}
+
+TEST(MockGraphicsManagerTest, ProgramInterfaceQuery) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  static const char kUniformSource[] =
+      "uniform float uFloat;\n"
+      "uniform vec4 uVectors[3];\n"
+      "attribute vec3 aVertex;\n";
+  GLuint vid = gm->CreateShader(GL_VERTEX_SHADER);
+  const char* ptr = kUniformSource;
+  GM_CALL(ShaderSource(vid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(vid));
+  GLuint fid = gm->CreateShader(GL_FRAGMENT_SHADER);
+  ptr = kFragmentSource;
+  GM_CALL(ShaderSource(fid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(fid));
+  GLuint pid = gm->CreateProgram();
+  GM_CALL(AttachShader(pid, vid));
+  GM_CALL(AttachShader(pid, fid));
+  GM_CALL(LinkProgram(pid));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid, GL_LINK_STATUS));
+
+  GLint count = 0;
+  GLint max_length = 0;
+  GM_CALL(GetProgramInterfaceiv(pid, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count));
+  EXPECT_EQ(GetProgramInt(gm, pid, GL_ACTIVE_UNIFORMS), count);
+  const GLuint uniform_count = static_cast<GLuint>(count);
+  EXPECT_LE(2U, uniform_count);
+  GM_CALL(GetProgramInterfaceiv(pid, GL_UNIFORM, GL_MAX_NAME_LENGTH,
+                                &max_length));
+  EXPECT_EQ(GetProgramInt(gm, pid, GL_ACTIVE_UNIFORM_MAX_LENGTH), max_length);
+  GM_ERROR_CALL(GetProgramInterfaceiv(pid, GL_UNIFORM_BLOCK,
+                                      GL_ACTIVE_RESOURCES, &count),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(GetProgramInterfaceiv(pid, GL_UNIFORM, GL_TYPE, &count),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(GetProgramInterfaceiv(pid + 1U, GL_UNIFORM,
+                                      GL_ACTIVE_RESOURCES, &count),
+                GL_INVALID_VALUE);
+
+  // The resources match the active uniforms.
+  static const GLenum kProps[] = {GL_TYPE, GL_ARRAY_SIZE, GL_LOCATION};
+  for (GLuint i = 0; i < uniform_count; ++i) {
+    char name[64];
+    char active_name[64];
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = GL_NONE;
+    GLint values[3] = {0, 0, 0};
+    GM_CALL(GetProgramResourceName(pid, GL_UNIFORM, i, 64, &length, name));
+    GM_CALL(GetActiveUniform(pid, i, 64, &length, &size, &type, active_name));
+    EXPECT_STREQ(active_name, name);
+    GM_CALL(GetProgramResourceiv(pid, GL_UNIFORM, i, 3, kProps, 3, &length,
+                                 values));
+    EXPECT_EQ(3, length);
+    EXPECT_EQ(static_cast<GLint>(type), values[0]);
+    EXPECT_EQ(size, values[1]);
+    EXPECT_EQ(gm->GetUniformLocation(pid, name), values[2]);
+  }
+  char name[64];
+  GLint value = 0;
+  GM_ERROR_CALL(GetProgramResourceName(pid, GL_UNIFORM, uniform_count, 64,
+                                       NULL, name),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(GetProgramResourceiv(pid, GL_UNIFORM, 0U, 0, kProps, 1, NULL,
+                                     &value),
+                GL_INVALID_VALUE);
+  static const GLenum kBadProp = GL_BUFFER_SIZE;
+  GM_ERROR_CALL(GetProgramResourceiv(pid, GL_UNIFORM, 0U, 1, &kBadProp, 1,
+                                     NULL, &value),
+                GL_INVALID_ENUM);
+}
+
+TEST(MockGraphicsManagerTest, ComputeShaders) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  static const char kComputeSource[] = "uniform float uScale;\n";
+  GLuint cid = gm->CreateShader(GL_COMPUTE_SHADER);
+  EXPECT_NE(0U, cid);
+  const char* ptr = kComputeSource;
+  GM_CALL(ShaderSource(cid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(cid));
+  GLuint pid = gm->CreateProgram();
+  GM_CALL(AttachShader(pid, cid));
+  EXPECT_EQ(1, GetProgramInt(gm, pid, GL_ATTACHED_SHADERS));
+
+  // No program is in use.
+  GM_ERROR_CALL(DispatchCompute(1U, 1U, 1U), GL_INVALID_OPERATION);
+  GM_CALL(LinkProgram(pid));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid, GL_LINK_STATUS));
+  EXPECT_NE(-1, gm->GetUniformLocation(pid, "uScale"));
+  GM_CALL(UseProgram(pid));
+  GM_CALL(DispatchCompute(16U, 8U, 1U));
+  // Too many work groups.
+  GM_ERROR_CALL(DispatchCompute(1U, 70000U, 1U), GL_INVALID_VALUE);
+
+  // DispatchComputeIndirect.
+  const GLuint groups[4] = { 4U, 4U, 1U, 0U };
+  // No indirect buffer.
+  GM_ERROR_CALL(DispatchComputeIndirect(0), GL_INVALID_OPERATION);
+  GLuint buffers[2] = { 0U, 0U };
+  GM_CALL(GenBuffers(2, buffers));
+  GM_CALL(BindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffers[0]));
+  GM_CALL(BufferData(GL_DISPATCH_INDIRECT_BUFFER, sizeof(groups), groups,
+                     GL_STATIC_DRAW));
+  GM_CALL(DispatchComputeIndirect(0));
+  GM_CALL(DispatchComputeIndirect(4));
+  // Misaligned or negative offset.
+  GM_ERROR_CALL(DispatchComputeIndirect(2), GL_INVALID_VALUE);
+  GM_ERROR_CALL(DispatchComputeIndirect(-4), GL_INVALID_VALUE);
+  // The command would be read beyond the end of the buffer.
+  GM_ERROR_CALL(DispatchComputeIndirect(8), GL_INVALID_OPERATION);
+
+  // Shader storage buffers.
+  GM_CALL(BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0U, buffers[1]));
+  GM_ERROR_CALL(BindBufferBase(GL_SHADER_STORAGE_BUFFER, 100U, buffers[1]),
+                GL_INVALID_VALUE);
+  GM_CALL(BufferData(GL_SHADER_STORAGE_BUFFER, 16, NULL, GL_DYNAMIC_DRAW));
+  GM_CALL(BindBufferRange(GL_SHADER_STORAGE_BUFFER, 1U, buffers[1], 0, 16));
+
+  // Images.
+  GLuint texture = 0U;
+  GM_CALL(GenTextures(1, &texture));
+  GM_CALL(BindImageTexture(0U, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                           GL_RGBA8));
+  GM_ERROR_CALL(BindImageTexture(100U, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY,
+                                 GL_RGBA8),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BindImageTexture(0U, texture + 1U, 0, GL_FALSE, 0,
+                                 GL_WRITE_ONLY, GL_RGBA8),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BindImageTexture(0U, texture, 0, GL_FALSE, 0, GL_NEVER,
+                                 GL_RGBA8),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(BindImageTexture(0U, texture, 0, GL_FALSE, 0, GL_READ_ONLY,
+                                 GL_RGB8),
+                GL_INVALID_ENUM);
+
+  // Memory barriers.
+  GM_CALL(MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT |
+                        GL_TEXTURE_FETCH_BARRIER_BIT));
+  GM_CALL(MemoryBarrier(GL_ALL_BARRIER_BITS));
+  GM_ERROR_CALL(MemoryBarrier(0x80000000U), GL_INVALID_VALUE);
+
+  // A compute shader cannot be linked with other stages.
+  GLuint vid = gm->CreateShader(GL_VERTEX_SHADER);
+  ptr = kVertexSource;
+  GM_CALL(ShaderSource(vid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(vid));
+  GM_CALL(AttachShader(pid, vid));
+  GM_CALL(LinkProgram(pid));
+  EXPECT_EQ(GL_FALSE, GetProgramInt(gm, pid, GL_LINK_STATUS));
+  GM_CALL(DetachShader(pid, cid));
+  EXPECT_EQ(1, GetProgramInt(gm, pid, GL_ATTACHED_SHADERS));
+}
+
 TEST(MockGraphicsManagerTest, MappedBuffers) {
   MockVisual visual(600, 500);
   MockGraphicsManagerPtr gm(new MockGraphicsManager());
@@ -3189,6 +3468,414 @@ TEST(MockGraphicsManagerTest, MappedBuffers) {
   GM_CALL(FlushMappedBufferRange(GL_ARRAY_BUFFER, 1, 2));
   GM_CALL(FlushMappedBufferRange(GL_ARRAY_BUFFER, 2, 2));
   GM_CALL(UnmapBuffer(GL_ARRAY_BUFFER));
+
+  // Buffers with mutable storage cannot be mapped persistently.
+  GM_ERROR_CALL(MapBufferRange(GL_ARRAY_BUFFER, 0, 4,
+                               GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT),
+                GL_INVALID_OPERATION);
+}
+
+TEST(MockGraphicsManagerTest, BufferStorage) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+  static const GLbitfield kMapBits =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  // Zero is bound.
+  GM_ERROR_CALL(BufferStorage(GL_ARRAY_BUFFER, 8, NULL, kMapBits),
+                GL_INVALID_OPERATION);
+
+  GLuint vbo = 0;
+  GM_CALL(GenBuffers(1, &vbo));
+  GM_CALL(BindBuffer(GL_ARRAY_BUFFER, vbo));
+  GM_ERROR_CALL(BufferStorage(GL_TEXTURE_2D, 8, NULL, kMapBits),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(BufferStorage(GL_ARRAY_BUFFER, 0, NULL, kMapBits),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BufferStorage(GL_ARRAY_BUFFER, 8, NULL, 0x8000),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BufferStorage(GL_ARRAY_BUFFER, 8, NULL, GL_MAP_PERSISTENT_BIT),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BufferStorage(GL_ARRAY_BUFFER, 8, NULL,
+                              GL_MAP_WRITE_BIT | GL_MAP_COHERENT_BIT),
+                GL_INVALID_VALUE);
+  const uint8 data[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+  GM_CALL(BufferStorage(GL_ARRAY_BUFFER, 8, data, kMapBits));
+  EXPECT_EQ(GL_TRUE, GetBufferInt(gm, GL_ARRAY_BUFFER,
+                                  GL_BUFFER_IMMUTABLE_STORAGE));
+  EXPECT_EQ(static_cast<GLint>(kMapBits),
+            GetBufferInt(gm, GL_ARRAY_BUFFER, GL_BUFFER_STORAGE_FLAGS));
+  EXPECT_EQ(8, GetBufferInt(gm, GL_ARRAY_BUFFER, GL_BUFFER_SIZE));
+
+  // The storage is immutable.
+  GM_ERROR_CALL(BufferStorage(GL_ARRAY_BUFFER, 8, NULL, kMapBits),
+                GL_INVALID_OPERATION);
+  GM_ERROR_CALL(BufferData(GL_ARRAY_BUFFER, 8, data, GL_STATIC_DRAW),
+                GL_INVALID_OPERATION);
+  // Without GL_DYNAMIC_STORAGE_BIT it cannot be updated with BufferSubData().
+  GM_ERROR_CALL(BufferSubData(GL_ARRAY_BUFFER, 0, 4, data),
+                GL_INVALID_OPERATION);
+
+  // Persistently map the whole buffer.
+  void* vptr = GM_CALL(MapBufferRange(GL_ARRAY_BUFFER, 0, 8, kMapBits));
+  uint8* ptr = reinterpret_cast<uint8*>(vptr);
+  ASSERT_TRUE(ptr != NULL);
+  for (int i = 0; i < 8; ++i) {
+    SCOPED_TRACE(i);
+    EXPECT_EQ(data[i], ptr[i]);
+  }
+  GM_CALL(UnmapBuffer(GL_ARRAY_BUFFER));
+
+  // Storage created without the persistent bit cannot be mapped persistently.
+  GLuint vbo2 = 0;
+  GM_CALL(GenBuffers(1, &vbo2));
+  GM_CALL(BindBuffer(GL_ARRAY_BUFFER, vbo2));
+  GM_CALL(BufferStorage(GL_ARRAY_BUFFER, 8, NULL,
+                        GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT));
+  GM_CALL(BufferSubData(GL_ARRAY_BUFFER, 4, 4, data));
+  GM_ERROR_CALL(MapBufferRange(GL_ARRAY_BUFFER, 0, 8, kMapBits),
+                GL_INVALID_OPERATION);
+  GM_CALL(MapBufferRange(GL_ARRAY_BUFFER, 0, 8, GL_MAP_WRITE_BIT));
+  GM_CALL(UnmapBuffer(GL_ARRAY_BUFFER));
+}
+
+TEST(MockGraphicsManagerTest, UniformBufferObjects) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  static const char kBlockSource[] =
+      "uniform Camera {\n"
+      "  mat4 uProjection;\n"
+      "  vec4 uEye;\n"
+      "};\n"
+      "uniform Lights {\n"
+      "  vec4 uLightPos;\n"
+      "};\n"
+      "attribute vec3 aVertex;\n";
+  GLuint vid = gm->CreateShader(GL_VERTEX_SHADER);
+  const char* ptr = kBlockSource;
+  GM_CALL(ShaderSource(vid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(vid));
+  GLuint fid = gm->CreateShader(GL_FRAGMENT_SHADER);
+  ptr = kFragmentSource;
+  GM_CALL(ShaderSource(fid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(fid));
+  GLuint pid = gm->CreateProgram();
+  GM_CALL(AttachShader(pid, vid));
+  GM_CALL(AttachShader(pid, fid));
+  GM_CALL(LinkProgram(pid));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid, GL_LINK_STATUS));
+
+  // Block indices.
+  EXPECT_EQ(0U, gm->GetUniformBlockIndex(pid, "Camera"));
+  EXPECT_EQ(1U, gm->GetUniformBlockIndex(pid, "Lights"));
+  EXPECT_EQ(GL_INVALID_INDEX, gm->GetUniformBlockIndex(pid, "uEye"));
+  GM_CHECK_NO_ERROR;
+  EXPECT_EQ(GL_INVALID_INDEX, gm->GetUniformBlockIndex(pid + 1U, "Camera"));
+  EXPECT_EQ(static_cast<GLenum>(GL_INVALID_VALUE), gm->GetError());
+
+  // Block bindings.
+  GLint value = -1;
+  GM_CALL(GetActiveUniformBlockiv(pid, 0U, GL_UNIFORM_BLOCK_NAME_LENGTH,
+                                  &value));
+  EXPECT_EQ(7, value);
+  GM_CALL(GetActiveUniformBlockiv(pid, 1U, GL_UNIFORM_BLOCK_BINDING, &value));
+  EXPECT_EQ(0, value);
+  GM_ERROR_CALL(GetActiveUniformBlockiv(pid, 2U, GL_UNIFORM_BLOCK_BINDING,
+                                        &value),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(GetActiveUniformBlockiv(pid, 0U, GL_BUFFER_SIZE, &value),
+                GL_INVALID_ENUM);
+  GM_CALL(UniformBlockBinding(pid, 1U, 3U));
+  GM_CALL(GetActiveUniformBlockiv(pid, 1U, GL_UNIFORM_BLOCK_BINDING, &value));
+  EXPECT_EQ(3, value);
+  GM_ERROR_CALL(UniformBlockBinding(pid, 2U, 0U), GL_INVALID_VALUE);
+  GM_ERROR_CALL(UniformBlockBinding(pid, 0U, 1000U), GL_INVALID_VALUE);
+
+  // Indexed buffer bindings.
+  GLuint ubo = 0;
+  GM_CALL(GenBuffers(1, &ubo));
+  GM_CALL(BindBuffer(GL_UNIFORM_BUFFER, ubo));
+  GM_CALL(BufferData(GL_UNIFORM_BUFFER, 512, NULL, GL_DYNAMIC_DRAW));
+  GM_CALL(BindBuffer(GL_UNIFORM_BUFFER, 0U));
+  GM_CALL(GetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &value));
+  EXPECT_EQ(256, value);
+  GM_ERROR_CALL(BindBufferRange(GL_ARRAY_BUFFER, 0U, ubo, 0, 64),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(BindBufferRange(GL_UNIFORM_BUFFER, 1000U, ubo, 0, 64),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BindBufferRange(GL_UNIFORM_BUFFER, 0U, ubo + 1U, 0, 64),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BindBufferRange(GL_UNIFORM_BUFFER, 0U, ubo, 16, 64),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(BindBufferRange(GL_UNIFORM_BUFFER, 0U, ubo, 0, 0),
+                GL_INVALID_VALUE);
+  GM_CALL(BindBufferRange(GL_UNIFORM_BUFFER, 3U, ubo, 256, 64));
+  GM_CALL(GetIntegerv(GL_UNIFORM_BUFFER_BINDING, &value));
+  EXPECT_EQ(static_cast<GLint>(ubo), value);
+  GM_ERROR_CALL(BindBufferBase(GL_UNIFORM_BUFFER, 1000U, ubo),
+                GL_INVALID_VALUE);
+  GM_CALL(BindBufferBase(GL_UNIFORM_BUFFER, 0U, 0U));
+  GM_CALL(GetIntegerv(GL_UNIFORM_BUFFER_BINDING, &value));
+  EXPECT_EQ(0, value);
+
+  // Deleting the buffer unbinds it.
+  GM_CALL(BindBufferBase(GL_UNIFORM_BUFFER, 0U, ubo));
+  GM_CALL(DeleteBuffers(1, &ubo));
+  GM_CALL(GetIntegerv(GL_UNIFORM_BUFFER_BINDING, &value));
+  EXPECT_EQ(0, value);
+}
+
+TEST(MockGraphicsManagerTest, InvalidateFramebuffer) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  // The default framebuffer uses buffer names rather than attachments.
+  const GLenum default_attachments[] = { GL_COLOR, GL_DEPTH, GL_STENCIL };
+  GM_CALL(InvalidateFramebuffer(GL_FRAMEBUFFER, 3, default_attachments));
+  const GLenum fbo_attachments[] = { GL_COLOR_ATTACHMENT0, GL_DEPTH_ATTACHMENT,
+                                     GL_STENCIL_ATTACHMENT };
+  GM_ERROR_CALL(InvalidateFramebuffer(GL_FRAMEBUFFER, 1, fbo_attachments),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(InvalidateFramebuffer(GL_TEXTURE_2D, 1, default_attachments),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(InvalidateFramebuffer(GL_FRAMEBUFFER, -1, default_attachments),
+                GL_INVALID_VALUE);
+
+  GLuint fbo;
+  GM_CALL(GenFramebuffers(1, &fbo));
+  GM_CALL(BindFramebuffer(GL_FRAMEBUFFER, fbo));
+  GM_CALL(InvalidateFramebuffer(GL_FRAMEBUFFER, 3, fbo_attachments));
+  GM_CALL(InvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, 0, NULL));
+  GM_ERROR_CALL(InvalidateFramebuffer(GL_FRAMEBUFFER, 2, default_attachments),
+                GL_INVALID_ENUM);
+  GM_CALL(DeleteFramebuffers(1, &fbo));
+}
+
+TEST(MockGraphicsManagerTest, Multiview) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+  EXPECT_TRUE(gm->IsFunctionGroupAvailable(GraphicsManager::kMultiview));
+  EXPECT_EQ(4, GetInt(gm, GL_MAX_VIEWS_OVR));
+
+  GLuint textures[2];
+  GM_CALL(GenTextures(2, textures));
+  GM_CALL(BindTexture(GL_TEXTURE_2D_ARRAY, textures[0]));
+  GM_CALL(TexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, 16, 16, 3, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, NULL));
+  GM_CALL(BindTexture(GL_TEXTURE_2D, textures[1]));
+  GM_CALL(TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 16, 16, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, NULL));
+  GLuint fbo;
+  GM_CALL(GenFramebuffers(1, &fbo));
+
+  // The default framebuffer cannot have multiview attachments.
+  GM_ERROR_CALL(FramebufferTextureMultiviewOVR(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[0], 0, 0, 2),
+                GL_INVALID_OPERATION);
+  GM_CALL(BindFramebuffer(GL_FRAMEBUFFER, fbo));
+  GM_ERROR_CALL(FramebufferTextureMultiviewOVR(
+      GL_TEXTURE_2D, GL_COLOR_ATTACHMENT0, textures[0], 0, 0, 2),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(FramebufferTextureMultiviewOVR(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[0], 0, 0, 0),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(FramebufferTextureMultiviewOVR(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[0], 0, 0, 5),
+                GL_INVALID_VALUE);
+  // Only array textures can be attached.
+  GM_ERROR_CALL(FramebufferTextureMultiviewOVR(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[1], 0, 0, 2),
+                GL_INVALID_OPERATION);
+
+  GM_CALL(FramebufferTextureMultiviewOVR(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textures[0], 0, 1, 2));
+  GLint value = 0;
+  GM_CALL(GetFramebufferAttachmentParameteriv(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_BASE_VIEW_INDEX_OVR, &value));
+  EXPECT_EQ(1, value);
+  GM_CALL(GetFramebufferAttachmentParameteriv(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR, &value));
+  EXPECT_EQ(2, value);
+
+  // Detaching the texture clears the views.
+  GM_CALL(FramebufferTextureMultiviewOVR(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0U, 0, 0, 0));
+  GM_CALL(GetFramebufferAttachmentParameteriv(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &value));
+  EXPECT_EQ(GL_NONE, value);
+  GM_CALL(DeleteFramebuffers(1, &fbo));
+  GM_CALL(DeleteTextures(2, textures));
+}
+
+TEST(MockGraphicsManagerTest, MultisampledRenderToTexture) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+  EXPECT_TRUE(gm->IsFunctionGroupAvailable(
+      GraphicsManager::kMultisampledRenderToTexture));
+
+  GLuint texture;
+  GM_CALL(GenTextures(1, &texture));
+  GM_CALL(BindTexture(GL_TEXTURE_2D, texture));
+  GM_CALL(TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 16, 16, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, NULL));
+  GLuint renderbuffer;
+  GM_CALL(GenRenderbuffers(1, &renderbuffer));
+  GLuint fbo;
+  GM_CALL(GenFramebuffers(1, &fbo));
+
+  // The default framebuffer cannot have attachments.
+  GM_ERROR_CALL(FramebufferTexture2DMultisampleEXT(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0, 4),
+                GL_INVALID_OPERATION);
+  GM_CALL(BindFramebuffer(GL_FRAMEBUFFER, fbo));
+  GM_ERROR_CALL(FramebufferTexture2DMultisampleEXT(
+      GL_TEXTURE_2D, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0, 4),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(FramebufferTexture2DMultisampleEXT(
+      GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, texture, 0, 4),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(FramebufferTexture2DMultisampleEXT(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 1, 4),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(FramebufferTexture2DMultisampleEXT(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0, 17),
+                GL_INVALID_VALUE);
+  GM_ERROR_CALL(FramebufferTexture2DMultisampleEXT(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture + 1U, 0,
+      4), GL_INVALID_OPERATION);
+
+  GM_CALL(FramebufferTexture2DMultisampleEXT(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0, 4));
+  GLint value = 0;
+  GM_CALL(GetFramebufferAttachmentParameteriv(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_SAMPLES_EXT, &value));
+  EXPECT_EQ(4, value);
+
+  // Renderbuffers are resolved implicitly in the same framebuffer.
+  GM_ERROR_CALL(RenderbufferStorageMultisampleEXT(
+      GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT16, 16, 16), GL_INVALID_OPERATION);
+  GM_CALL(BindRenderbuffer(GL_RENDERBUFFER, renderbuffer));
+  GM_ERROR_CALL(RenderbufferStorageMultisampleEXT(
+      GL_TEXTURE_2D, 4, GL_DEPTH_COMPONENT16, 16, 16), GL_INVALID_ENUM);
+  GM_ERROR_CALL(RenderbufferStorageMultisampleEXT(
+      GL_RENDERBUFFER, 17, GL_DEPTH_COMPONENT16, 16, 16), GL_INVALID_VALUE);
+  GM_CALL(RenderbufferStorageMultisampleEXT(
+      GL_RENDERBUFFER, 4, GL_DEPTH_COMPONENT16, 16, 16));
+  GM_CALL(FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                  GL_RENDERBUFFER, renderbuffer));
+  EXPECT_EQ(static_cast<GLenum>(GL_FRAMEBUFFER_COMPLETE),
+            gm->CheckFramebufferStatus(GL_FRAMEBUFFER));
+
+  // Attaching the texture normally clears the samples.
+  GM_CALL(FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, texture, 0));
+  GM_CALL(GetFramebufferAttachmentParameteriv(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_SAMPLES_EXT, &value));
+  EXPECT_EQ(0, value);
+  GM_CALL(DeleteFramebuffers(1, &fbo));
+  GM_CALL(DeleteRenderbuffers(1, &renderbuffer));
+  GM_CALL(DeleteTextures(1, &texture));
+}
+
+TEST(MockGraphicsManagerTest, ParallelShaderCompile) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  EXPECT_EQ(-1, GetInt(gm, GL_MAX_SHADER_COMPILER_THREADS_KHR));
+  GM_CALL(MaxShaderCompilerThreadsKHR(2U));
+  EXPECT_EQ(2, GetInt(gm, GL_MAX_SHADER_COMPILER_THREADS_KHR));
+
+  // Compiling and linking are complete once they have been reported as
+  // incomplete.
+  GLuint vid = gm->CreateShader(GL_VERTEX_SHADER);
+  const char* ptr = kVertexSource;
+  GM_CALL(ShaderSource(vid, 1, &ptr, NULL));
+  EXPECT_EQ(GL_TRUE, GetShaderInt(gm, vid, GL_COMPLETION_STATUS_KHR));
+  GM_CALL(CompileShader(vid));
+  EXPECT_EQ(GL_FALSE, GetShaderInt(gm, vid, GL_COMPLETION_STATUS_KHR));
+  EXPECT_EQ(GL_TRUE, GetShaderInt(gm, vid, GL_COMPLETION_STATUS_KHR));
+  GLuint fid = gm->CreateShader(GL_FRAGMENT_SHADER);
+  ptr = kFragmentSource;
+  GM_CALL(ShaderSource(fid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(fid));
+
+  GLuint pid = gm->CreateProgram();
+  GM_CALL(AttachShader(pid, vid));
+  GM_CALL(AttachShader(pid, fid));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid, GL_COMPLETION_STATUS_KHR));
+  GM_CALL(LinkProgram(pid));
+  EXPECT_EQ(GL_FALSE, GetProgramInt(gm, pid, GL_COMPLETION_STATUS_KHR));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid, GL_COMPLETION_STATUS_KHR));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid, GL_LINK_STATUS));
+}
+
+TEST(MockGraphicsManagerTest, ProgramBinary) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  GLuint vid = gm->CreateShader(GL_VERTEX_SHADER);
+  const char* ptr = kVertexSource;
+  GM_CALL(ShaderSource(vid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(vid));
+  GLuint fid = gm->CreateShader(GL_FRAGMENT_SHADER);
+  ptr = kFragmentSource;
+  GM_CALL(ShaderSource(fid, 1, &ptr, NULL));
+  GM_CALL(CompileShader(fid));
+  GLuint pid = gm->CreateProgram();
+
+  // An unlinked program has no binary.
+  EXPECT_EQ(0, GetProgramInt(gm, pid, GL_PROGRAM_BINARY_LENGTH));
+  GLenum format = GL_NONE;
+  GLsizei length = 0;
+  char data[4096];
+  GM_ERROR_CALL(GetProgramBinary(pid, 4096, &length, &format, data),
+                GL_INVALID_OPERATION);
+
+  GM_ERROR_CALL(ProgramParameteri(pid, GL_LINK_STATUS, GL_TRUE),
+                GL_INVALID_ENUM);
+  GM_ERROR_CALL(ProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, 2),
+                GL_INVALID_VALUE);
+  GM_CALL(ProgramParameteri(pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+  EXPECT_EQ(GL_TRUE,
+            GetProgramInt(gm, pid, GL_PROGRAM_BINARY_RETRIEVABLE_HINT));
+  GM_CALL(AttachShader(pid, vid));
+  GM_CALL(AttachShader(pid, fid));
+  GM_CALL(LinkProgram(pid));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid, GL_LINK_STATUS));
+  const GLint binary_length = GetProgramInt(gm, pid, GL_PROGRAM_BINARY_LENGTH);
+  EXPECT_LT(0, binary_length);
+  GM_ERROR_CALL(GetProgramBinary(pid, binary_length - 1, &length, &format,
+                                 data),
+                GL_INVALID_OPERATION);
+  GM_CALL(GetProgramBinary(pid, 4096, &length, &format, data));
+  EXPECT_EQ(binary_length, length);
+
+  // Loading the binary into another program gives it the same inputs.
+  GLuint pid2 = gm->CreateProgram();
+  GM_ERROR_CALL(ProgramBinary(pid2, GL_NONE, data, length), GL_INVALID_ENUM);
+  GM_ERROR_CALL(ProgramBinary(pid2 + 1U, format, data, length),
+                GL_INVALID_VALUE);
+  GM_CALL(ProgramBinary(pid2, format, data, length));
+  EXPECT_EQ(GL_TRUE, GetProgramInt(gm, pid2, GL_LINK_STATUS));
+  EXPECT_EQ(GetProgramInt(gm, pid, GL_ACTIVE_UNIFORMS),
+            GetProgramInt(gm, pid2, GL_ACTIVE_UNIFORMS));
+  EXPECT_EQ(GetProgramInt(gm, pid, GL_ACTIVE_ATTRIBUTES),
+            GetProgramInt(gm, pid2, GL_ACTIVE_ATTRIBUTES));
+  EXPECT_EQ(gm->GetUniformLocation(pid, "uni_v3f"),
+            gm->GetUniformLocation(pid2, "uni_v3f"));
+
+  // Corrupted binaries fail to link.
+  data[0] = 'X';
+  GM_CALL(ProgramBinary(pid2, format, data, length));
+  EXPECT_EQ(GL_FALSE, GetProgramInt(gm, pid2, GL_LINK_STATUS));
+  EXPECT_EQ(0, GetProgramInt(gm, pid2, GL_ACTIVE_UNIFORMS));
+  EXPECT_EQ(0, GetProgramInt(gm, pid2, GL_PROGRAM_BINARY_LENGTH));
 }
 
 TEST(MockGraphicsManagerTest, FrameAndRenderBuffers) {
@@ -3998,6 +4685,55 @@ TEST(MockGraphicsManagerTest, IsExtensionSupportedParsesUnprefixedExtension) {
   EXPECT_TRUE(gm->IsExtensionSupported("bar_BAZ"));
 }
 
+TEST(MockGraphicsManagerTest, IsCompressedTextureFormatSupported) {
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+
+  // The default mock is OpenGL ES 3.3 without ASTC.
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGB_S3TC_DXT1_EXT));
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(GL_ETC1_RGB8_OES));
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(GL_COMPRESSED_RGB8_ETC2));
+  EXPECT_FALSE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA_ASTC_8x8_KHR));
+  // Uncompressed formats are always supported.
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(GL_RGBA8));
+
+  gm->SetVersionString("2.0 Ion OpenGL ES");
+  gm->SetExtensionsString("GL_EXT_texture_compression_dxt1");
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGB_S3TC_DXT1_EXT));
+  EXPECT_FALSE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA_S3TC_DXT5_EXT));
+  EXPECT_FALSE(gm->IsCompressedTextureFormatSupported(GL_ETC1_RGB8_OES));
+  EXPECT_FALSE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG));
+  EXPECT_FALSE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA8_ETC2_EAC));
+  EXPECT_FALSE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA_ASTC_4x4_KHR));
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(GL_RGBA8));
+
+  // ETC2 and EAC are core in OpenGL ES 3.0 and OpenGL 4.3.
+  gm->SetVersionString("3.0 Ion OpenGL ES");
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(GL_COMPRESSED_R11_EAC));
+  gm->SetVersionString("3.3 Ion OpenGL");
+  EXPECT_FALSE(gm->IsCompressedTextureFormatSupported(GL_COMPRESSED_R11_EAC));
+  gm->SetVersionString("4.3 Ion OpenGL");
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(GL_COMPRESSED_R11_EAC));
+
+  gm->SetExtensionsString("GL_KHR_texture_compression_astc_ldr");
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA_ASTC_8x8_KHR));
+  gm->SetExtensionsString("GL_KHR_texture_compression_astc_hdr");
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA_ASTC_12x12_KHR));
+  gm->SetVersionString("3.3 Ion OpenGL");
+  gm->SetExtensionsString("GL_ARB_ES3_compatibility");
+  EXPECT_TRUE(gm->IsCompressedTextureFormatSupported(
+      GL_COMPRESSED_RGBA8_ETC2_EAC));
+}
+
 TEST(MockGraphicsManagerTest, FunctionGroupsAreDisabledByMissingExtensions) {
 #if defined(ION_PLATFORM_ANDROID) || defined(ION_PLATFORM_GENERIC_ARM)
   static const bool kHasVertexArrays = false;
@@ -4056,7 +4792,7 @@ TEST(MockGraphicsManagerTest, GetString) {
   EXPECT_EQ("GL_OES_blend_func_separate", GetStringi(gm, GL_EXTENSIONS, 0));
   EXPECT_EQ("GL_OES_blend_subtract", GetStringi(gm, GL_EXTENSIONS, 1));
   GLint count = GetInt(gm, GL_NUM_EXTENSIONS);
-  EXPECT_EQ(54, count);
+  EXPECT_EQ(66, count);
   GM_ERROR_CALL(GetStringi(GL_EXTENSIONS, count), GL_INVALID_VALUE);
 
   // These tests are to increase coverage.
@@ -5367,6 +6103,59 @@ TEST(MockGraphicsManagerTest, ErrorChecking) {
   EXPECT_TRUE(log_checker.HasMessage("ERROR", "unknown error"));
 }
 
+TEST(MockGraphicsManagerTest, DeferredErrorChecking) {
+  base::LogChecker log_checker;
+
+  MockVisual visual(600, 500);
+  MockGraphicsManagerPtr gm(new MockGraphicsManager());
+  EXPECT_FALSE(gm->IsDeferredErrorCheckingEnabled());
+  EXPECT_EQ(GraphicsManager::kCheckErrorsPerFrame,
+            gm->GetDeferredErrorCheckBatch());
+  gm->EnableDeferredErrorChecking(true, GraphicsManager::kCheckErrorsPerNode);
+  EXPECT_TRUE(gm->IsDeferredErrorCheckingEnabled());
+  EXPECT_EQ(GraphicsManager::kCheckErrorsPerNode,
+            gm->GetDeferredErrorCheckBatch());
+
+  // Errors are not reported by the calls themselves.
+  gm->CullFace(GL_BACK);
+  gm->CullFace(GL_TRIANGLES);
+  gm->Flush();
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Ending a smaller batch than the one being checked does not check.
+  gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerDraw, "shape");
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // The error is reported at the end of the batch with the calls made in it.
+  gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerNode, "roads");
+  const std::vector<std::string> messages = log_checker.GetAllMessages();
+  ASSERT_EQ(1U, messages.size());
+  EXPECT_NE(std::string::npos, messages[0].find("drawing Node 'roads'"));
+  EXPECT_NE(std::string::npos, messages[0].find("invalid enumerant"));
+  EXPECT_NE(std::string::npos,
+            messages[0].find("calls: CullFace CullFace Flush"));
+
+  // Each batch starts with no calls, and only the most recent ones are kept.
+  gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerFrame, "");
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  for (size_t i = 0; i < GraphicsManager::kDeferredErrorCallCount; ++i)
+    gm->Flush();
+  gm->CullFace(GL_TRIANGLES);
+  gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerFrame, "");
+  EXPECT_TRUE(
+      log_checker.HasMessage("ERROR", "drawing frame: invalid enumerant"));
+  gm->CullFace(GL_TRIANGLES);
+  gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerFrame, "");
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "calls: CullFace"));
+
+  // Nothing is checked once it is disabled.
+  gm->EnableDeferredErrorChecking(false, GraphicsManager::kCheckErrorsPerDraw);
+  gm->CullFace(GL_TRIANGLES);
+  gm->CheckForDeferredErrors(GraphicsManager::kCheckErrorsPerFrame, "");
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  gm->GetError();
+}
+
 TEST(MockGraphicsManagerTest, Tracing) {
   std::unique_ptr<MockVisual> visual(new MockVisual(600, 500));
   MockGraphicsManagerPtr gm(new MockGraphicsManager());
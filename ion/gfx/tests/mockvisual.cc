@@ -71,10 +71,28 @@ static const char kExtensionsString[] =
     "GL_EXT_gpu_shader4 GL_ARB_texture_multisample "
     "GL_EXT_framebuffer_multisample GL_EXT_framebuffer_blit "
     "GL_ARB_texture_storage_multisample GL_EXT_draw_instanced GL_ARB_sync "
-    "GL_EXT_disjoint_timer_query GL_NV_transform_feedback "
+    "GL_ARB_buffer_storage GL_ARB_uniform_buffer_object "
+    "GL_ARB_compute_shader "
+    "GL_NV_conditional_render GL_ARB_draw_indirect "
+    "GL_ARB_program_interface_query "
+    "GL_OES_get_program_binary GL_KHR_parallel_shader_compile "
+    "GL_ARB_invalidate_subdata "
+    "GL_EXT_disjoint_timer_query GL_EXT_multi_draw_arrays GL_OVR_multiview "
+    "GL_EXT_multisampled_render_to_texture "
+    "GL_NV_transform_feedback "
     "GL_ARB_transform_feedback2 GL_ARB_transform_feedback3 "
     "GL_EXT_transform_feedback GL_OES_EGL_image GL_OES_EGL_image_external";
 
+// The format of the program binaries returned by GetProgramBinary(), and the
+// header that starts each binary.
+static const GLenum kProgramBinaryFormat = 0x7FFF0001;
+static const char kProgramBinaryHeader[] = "MockProgramBinary:";
+
+// Compute shader limits; these are the minimums required by OpenGL ES 3.1.
+static const GLuint kMaxComputeWorkGroupCount = 65535U;
+static const GLuint kMaxImageUnits = 4U;
+static const GLuint kMaxShaderStorageBufferBindings = 4U;
+
 // Base struct for OpenGL object structs. See below comment.
 struct OpenGlObject {
   OpenGlObject() : deleted(false) {}
@@ -110,7 +128,8 @@ struct ArrayObjectData : OpenGlObject {
 typedef ArrayInfo<ArrayObjectData> ArrayObject;
 // Buffer data is only known when BindBuffer is called.
 struct BufferObjectData : OpenGlObject {
-  BufferObjectData() : data(NULL), access(0) {}
+  BufferObjectData()
+      : data(NULL), access(0), immutable_storage(false), storage_flags(0) {}
   ~BufferObjectData() { ClearData(); }
   void ClearData() {
     if (data)
@@ -122,17 +141,49 @@ struct BufferObjectData : OpenGlObject {
   math::Range1ui mapped_range;
   // The access mode used to map the data.
   GLbitfield access;
+  // Whether the data store was created with glBufferStorage(), and the flags
+  // passed to it.
+  bool immutable_storage;
+  GLbitfield storage_flags;
 };
 typedef BufferInfo<BufferObjectData> BufferObject;
 typedef FramebufferInfo<OpenGlObject> FramebufferObject;
 struct ProgramObjectData : OpenGlObject {
-  ProgramObjectData() : max_uniform_location(0) {}
+  ProgramObjectData()
+      : compute_shader(0U),
+        max_uniform_location(0),
+        binary_retrievable_hint(GL_FALSE),
+        is_link_pending(false) {}
+  // The attached compute shader, if any.
+  GLuint compute_shader;
   GLint max_uniform_location;
+  // The binary of the program returned by GetProgramBinary(), which holds the
+  // sources of the shaders the program was last successfully linked with.
+  std::string binary;
+  GLint binary_retrievable_hint;
+  // The uniform blocks declared in the program's shaders; the index of a block
+  // is its index in the vector.
+  struct UniformBlock {
+    UniformBlock() : binding(0U) {}
+    std::string name;
+    // The uniform buffer binding point of the block.
+    GLuint binding;
+  };
+  std::vector<UniformBlock> uniform_blocks;
+  // Whether a link has not yet been reported as complete; see
+  // GL_COMPLETION_STATUS_KHR in GetProgramiv().
+  bool is_link_pending;
 };
 typedef ProgramInfo<ProgramObjectData> ProgramObject;
 typedef RenderbufferInfo<OpenGlObject> RenderbufferObject;
 typedef SamplerInfo<OpenGlObject> SamplerObject;
-typedef ShaderInfo<OpenGlObject> ShaderObject;
+struct ShaderObjectData : OpenGlObject {
+  ShaderObjectData() : is_compile_pending(false) {}
+  // Whether a compilation has not yet been reported as complete; see
+  // GL_COMPLETION_STATUS_KHR in GetShaderiv().
+  bool is_compile_pending;
+};
+typedef ShaderInfo<ShaderObjectData> ShaderObject;
 typedef SyncInfo<OpenGlObject> SyncObject;
 struct TransformFeedbackObjectData : OpenGlObject {
   TransformFeedbackObjectData()
@@ -617,6 +668,36 @@ static void AddShaderInputs(ProgramObject* po,
         continue;
     }
 
+    // Detect uniform block declarations, which have the form
+    // [layout(...)] uniform <name> {. The members of the block are not added
+    // as uniforms, since they do not have locations.
+    // -------------------------------------------------------------------------
+    if (stripped.find("{") != std::string::npos) {
+      bool is_block = false;
+      for (size_t j = 0; j + 1U < words.size(); ++j) {
+        if (words[j].compare("uniform") == 0) {
+          const std::string block_name =
+              words[j + 1U].substr(0, words[j + 1U].find("{"));
+          bool exists = false;
+          for (size_t k = 0; k < po->uniform_blocks.size(); ++k) {
+            if (po->uniform_blocks[k].name == block_name) {
+              exists = true;
+              break;
+            }
+          }
+          if (!exists && !block_name.empty()) {
+            ProgramObject::UniformBlock block;
+            block.name = block_name;
+            po->uniform_blocks.push_back(block);
+          }
+          is_block = true;
+          break;
+        }
+      }
+      if (is_block)
+        continue;
+    }
+
     // Iterate through uniform and attribute declarations.
     // -------------------------------------------------------------------------
 
@@ -962,6 +1043,12 @@ class MockVisual::ShadowState {
           draw_framebuffer(0U),
           read_framebuffer(0U),
           index_buffer(0U),
+          indirect_buffer(0U),
+          dispatch_indirect_buffer(0U),
+          shader_storage_buffer(0U),
+          pixel_pack_buffer(0U),
+          pixel_unpack_buffer(0U),
+          uniform_buffer(0U),
           program(0U),
           renderbuffer(0U),
           transform_feedback(0U) {}
@@ -971,11 +1058,25 @@ class MockVisual::ShadowState {
     GLuint draw_framebuffer;
     GLuint read_framebuffer;
     GLuint index_buffer;
+    GLuint indirect_buffer;
+    GLuint dispatch_indirect_buffer;
+    GLuint shader_storage_buffer;
+    GLuint pixel_pack_buffer;
+    GLuint pixel_unpack_buffer;
+    GLuint uniform_buffer;
     GLuint program;
     GLuint renderbuffer;
     GLuint transform_feedback;
   };
 
+  // A buffer range bound to an indexed uniform buffer binding point.
+  struct UniformBufferBinding {
+    UniformBufferBinding() : buffer(0U), offset(0), size(0) {}
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+  };
+
   // An OpenGL image unit.
   struct ImageUnit {
     ImageUnit()
@@ -1166,13 +1267,30 @@ class MockVisual::ShadowState {
   }
   bool CheckBufferTarget(GLenum target) {
     return CheckGlEnum(target == GL_ARRAY_BUFFER ||
-                       target == GL_ELEMENT_ARRAY_BUFFER);
+                       target == GL_DISPATCH_INDIRECT_BUFFER ||
+                       target == GL_DRAW_INDIRECT_BUFFER ||
+                       target == GL_ELEMENT_ARRAY_BUFFER ||
+                       target == GL_PIXEL_PACK_BUFFER ||
+                       target == GL_PIXEL_UNPACK_BUFFER ||
+                       target == GL_SHADER_STORAGE_BUFFER ||
+                       target == GL_UNIFORM_BUFFER);
   }
   bool CheckBufferZeroNotBound(GLenum target) {
     return CheckGlOperation(
         (target == GL_ARRAY_BUFFER && active_objects_.buffer != 0U) ||
+        (target == GL_DISPATCH_INDIRECT_BUFFER &&
+         active_objects_.dispatch_indirect_buffer != 0U) ||
+        (target == GL_DRAW_INDIRECT_BUFFER &&
+         active_objects_.indirect_buffer != 0U) ||
         (target == GL_ELEMENT_ARRAY_BUFFER &&
-         active_objects_.index_buffer != 0U));
+         active_objects_.index_buffer != 0U) ||
+        (target == GL_PIXEL_PACK_BUFFER &&
+         active_objects_.pixel_pack_buffer != 0U) ||
+        (target == GL_PIXEL_UNPACK_BUFFER &&
+         active_objects_.pixel_unpack_buffer != 0U) ||
+        (target == GL_SHADER_STORAGE_BUFFER &&
+         active_objects_.shader_storage_buffer != 0U) ||
+        (target == GL_UNIFORM_BUFFER && active_objects_.uniform_buffer != 0U));
   }
   bool CheckColorChannelEnum(GLenum channel) {
     return CheckGlEnum(channel == GL_RED || channel == GL_GREEN ||
@@ -1185,7 +1303,13 @@ class MockVisual::ShadowState {
                        format == GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG ||
                        format == GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG ||
                        format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ||
-                       format == GL_ETC1_RGB8_OES);
+                       format == GL_ETC1_RGB8_OES ||
+                       (format >= GL_COMPRESSED_R11_EAC &&
+                        format <= GL_COMPRESSED_SIGNED_RG11_EAC) ||
+                       (format >= GL_COMPRESSED_RGB8_ETC2 &&
+                        format <= GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC) ||
+                       (format >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR &&
+                        format <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR));
   }
   bool CheckDrawMode(GLenum mode) {
     return CheckGlEnum(mode == GL_POINTS || mode == GL_LINE_STRIP ||
@@ -1193,6 +1317,13 @@ class MockVisual::ShadowState {
                        mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN ||
                        mode == GL_TRIANGLES);
   }
+  // Returns whether none of the first drawcount counts are negative.
+  static bool AreCountsNonNegative(const GLsizei* count, GLsizei drawcount) {
+    for (GLsizei i = 0; i < drawcount; ++i)
+      if (count[i] < 0)
+        return false;
+    return true;
+  }
   bool CheckDepthOrStencilFunc(GLenum func) {
     return CheckGlEnum(func == GL_NEVER || func == GL_LESS ||
                        func == GL_EQUAL || func == GL_LEQUAL ||
@@ -1371,6 +1502,18 @@ class MockVisual::ShadowState {
                        wrap == GL_MIRRORED_REPEAT);
   }
   GLuint GetBufferIndex(GLenum target) {
+    if (target == GL_DISPATCH_INDIRECT_BUFFER)
+      return active_objects_.dispatch_indirect_buffer;
+    if (target == GL_SHADER_STORAGE_BUFFER)
+      return active_objects_.shader_storage_buffer;
+    if (target == GL_DRAW_INDIRECT_BUFFER)
+      return active_objects_.indirect_buffer;
+    if (target == GL_PIXEL_PACK_BUFFER)
+      return active_objects_.pixel_pack_buffer;
+    if (target == GL_PIXEL_UNPACK_BUFFER)
+      return active_objects_.pixel_unpack_buffer;
+    if (target == GL_UNIFORM_BUFFER)
+      return active_objects_.uniform_buffer;
     return target == GL_ARRAY_BUFFER ? active_objects_.buffer
                                      : active_objects_.index_buffer;
   }
@@ -1698,9 +1841,12 @@ class MockVisual::ShadowState {
       // program.
       if (CheckGlOperation(!so.deleted && !po.deleted &&
                            po.vertex_shader != shader &&
-                           po.fragment_shader != shader)) {
+                           po.fragment_shader != shader &&
+                           po.compute_shader != shader)) {
         if (so.type == GL_VERTEX_SHADER)
           po.vertex_shader = shader;
+        else if (so.type == GL_COMPUTE_SHADER)
+          po.compute_shader = shader;
         else
           po.fragment_shader = shader;
       }
@@ -1743,6 +1889,18 @@ class MockVisual::ShadowState {
         CheckFunction("BindBuffer")) {
       if (target == GL_ARRAY_BUFFER) {
         active_objects_.buffer = buffer;
+      } else if (target == GL_DISPATCH_INDIRECT_BUFFER) {
+        active_objects_.dispatch_indirect_buffer = buffer;
+      } else if (target == GL_SHADER_STORAGE_BUFFER) {
+        active_objects_.shader_storage_buffer = buffer;
+      } else if (target == GL_DRAW_INDIRECT_BUFFER) {
+        active_objects_.indirect_buffer = buffer;
+      } else if (target == GL_PIXEL_PACK_BUFFER) {
+        active_objects_.pixel_pack_buffer = buffer;
+      } else if (target == GL_PIXEL_UNPACK_BUFFER) {
+        active_objects_.pixel_unpack_buffer = buffer;
+      } else if (target == GL_UNIFORM_BUFFER) {
+        active_objects_.uniform_buffer = buffer;
       } else {
         active_objects_.index_buffer = buffer;
         object_state_->arrays[active_objects_.array].element_array = buffer;
@@ -1856,16 +2014,21 @@ class MockVisual::ShadowState {
     // GL_INVALID_ENUM is generated if target is not one of the allowable
     // values.
     // GL_INVALID_ENUM is generated if usage is not GL_STREAM_DRAW,
-    // GL_STATIC_DRAW, or GL_DYNAMIC_DRAW.
+    // GL_STREAM_READ, GL_STATIC_DRAW, or GL_DYNAMIC_DRAW.
     // GL_INVALID_VALUE is generated if size is negative.
     // GL_INVALID_OPERATION is generated if the reserved buffer object name 0 is
     // bound to target.
     // GL_OUT_OF_MEMORY is generated if the GL is unable to create a data store
     // with the specified size.
+    // GL_INVALID_OPERATION is generated if the GL_BUFFER_IMMUTABLE_STORAGE
+    // flag of the buffer object is GL_TRUE.
     if (CheckBufferTarget(target) &&
-        CheckGlEnum(usage == GL_STREAM_DRAW || usage == GL_STATIC_DRAW ||
-                    usage == GL_DYNAMIC_DRAW) &&
+        CheckGlEnum(usage == GL_STREAM_DRAW || usage == GL_STREAM_READ ||
+                    usage == GL_STATIC_DRAW || usage == GL_DYNAMIC_DRAW) &&
         CheckGlValue(size >= 0) && CheckBufferZeroNotBound(target) &&
+        CheckGlOperation(
+            !object_state_->buffers[GetBufferIndex(target)]
+                 .immutable_storage) &&
         CheckGlMemory(size) && CheckFunction("BufferData")) {
       const GLuint index = GetBufferIndex(target);
       object_state_->buffers[index].size = size;
@@ -1889,10 +2052,15 @@ class MockVisual::ShadowState {
     // object's allocated data store.
     // GL_INVALID_OPERATION is generated if the reserved buffer object name 0 is
     // bound to target.
+    // GL_INVALID_OPERATION is generated if the buffer's data store is
+    // immutable and was not created with GL_DYNAMIC_STORAGE_BIT.
     if (CheckBufferTarget(target) && CheckGlValue(offset >= 0 && size >= 0) &&
         CheckBufferZeroNotBound(target)) {
       const GLuint index = GetBufferIndex(target);
-      if (CheckGlValue(object_state_->buffers[index].size > offset + size) &&
+      const BufferObject& bo = object_state_->buffers[index];
+      if (CheckGlValue(bo.size >= offset + size) &&
+          CheckGlOperation(!bo.immutable_storage ||
+                           (bo.storage_flags & GL_DYNAMIC_STORAGE_BIT)) &&
           CheckFunction("BufferSubData")) {
         // Copy the data.
         if (data) {
@@ -1990,6 +2158,7 @@ class MockVisual::ShadowState {
     if (CheckGlValue(object_state_->shaders.count(shader))) {
       ShaderObject& so = object_state_->shaders[shader];
       if (CheckGlOperation(!so.deleted)) {
+        so.is_compile_pending = true;
         if (CheckFunction("CompileShader")) {
           so.compile_status = GL_TRUE;
           so.info_log.clear();
@@ -2224,7 +2393,8 @@ class MockVisual::ShadowState {
   GLuint CreateShader(GLenum type) {
     GLuint id = 0U;
     // GL_INVALID_ENUM is generated if shaderType is not an accepted value.
-    if (CheckGlEnum(type == GL_VERTEX_SHADER || type == GL_FRAGMENT_SHADER) &&
+    if (CheckGlEnum(type == GL_VERTEX_SHADER || type == GL_FRAGMENT_SHADER ||
+                    type == GL_COMPUTE_SHADER) &&
         CheckFunction("CreateShader")) {
       ShaderObject so;
       so.type = type;
@@ -2259,6 +2429,22 @@ class MockVisual::ShadowState {
               active_objects_.buffer = 0U;
           if (buffers[i] == active_objects_.index_buffer)
             active_objects_.index_buffer = 0U;
+          if (buffers[i] == active_objects_.indirect_buffer)
+            active_objects_.indirect_buffer = 0U;
+          if (buffers[i] == active_objects_.dispatch_indirect_buffer)
+            active_objects_.dispatch_indirect_buffer = 0U;
+          if (buffers[i] == active_objects_.shader_storage_buffer)
+            active_objects_.shader_storage_buffer = 0U;
+          if (buffers[i] == active_objects_.pixel_pack_buffer)
+            active_objects_.pixel_pack_buffer = 0U;
+          if (buffers[i] == active_objects_.pixel_unpack_buffer)
+            active_objects_.pixel_unpack_buffer = 0U;
+          if (buffers[i] == active_objects_.uniform_buffer)
+            active_objects_.uniform_buffer = 0U;
+          for (size_t j = 0; j < uniform_buffer_bindings_.size(); ++j) {
+            if (buffers[i] == uniform_buffer_bindings_[j].buffer)
+              uniform_buffer_bindings_[j] = UniformBufferBinding();
+          }
         }
       }
     }
@@ -2395,9 +2581,12 @@ class MockVisual::ShadowState {
       // GL_INVALID_OPERATION is generated if shader is not attached to program.
       if (CheckGlOperation(
               !so.deleted && !po.deleted &&
-              (po.vertex_shader == shader || po.fragment_shader == shader))) {
+              (po.vertex_shader == shader || po.fragment_shader == shader ||
+               po.compute_shader == shader))) {
         if (po.vertex_shader == shader)
           po.vertex_shader = 0;
+        else if (po.compute_shader == shader)
+          po.compute_shader = 0;
         else
           po.fragment_shader = 0;
       }
@@ -2436,7 +2625,8 @@ class MockVisual::ShadowState {
         CheckGlOperation(tfo.status != GL_TRANSFORM_FEEDBACK_ACTIVE ||
                          tfo.primitive_mode == mode) &&
         CheckFunction("DrawArrays")) {
-      // There is nothing to do since we do not implement draw functions.
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
     }
   }
   void DrawElements(GLenum mode, GLsizei count, GLenum type,
@@ -2465,7 +2655,8 @@ class MockVisual::ShadowState {
                 ->transform_feedbacks[active_objects_.transform_feedback]
                 .status != GL_TRANSFORM_FEEDBACK_ACTIVE) &&
         CheckFunction("DrawElements")) {
-      // There is nothing to do since we do not implement draw functions.
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
     }
   }
   void Enable(GLenum cap) {
@@ -2587,6 +2778,9 @@ class MockVisual::ShadowState {
         a->cube_face = textarget;
       }
       a->value = texture;
+      a->base_view_index = 0;
+      a->num_views = 0;
+      a->samples = 0;
     }
   }
   void FrontFace(GLenum mode) {
@@ -2759,15 +2953,21 @@ class MockVisual::ShadowState {
       const ProgramObject& po = object_state_->programs[program];
       if (CheckGlOperation(!po.deleted)) {
         if (count)
-          *count =
-              (po.vertex_shader > 0 ? 1 : 0) + (po.fragment_shader > 0 ? 1 : 0);
+          *count = (po.vertex_shader > 0 ? 1 : 0) +
+                   (po.fragment_shader > 0 ? 1 : 0) +
+                   (po.compute_shader > 0 ? 1 : 0);
         if (maxCount > 0 && po.vertex_shader > 0) {
           *shaders = po.vertex_shader;
           shaders++;
           maxCount--;
         }
-        if (maxCount > 0 && po.fragment_shader > 0)
+        if (maxCount > 0 && po.fragment_shader > 0) {
           *shaders = po.fragment_shader;
+          shaders++;
+          maxCount--;
+        }
+        if (maxCount > 0 && po.compute_shader > 0)
+          *shaders = po.compute_shader;
       }
     }
   }
@@ -2802,12 +3002,19 @@ class MockVisual::ShadowState {
     // GL_INVALID_OPERATION is generated if the reserved buffer object name 0 is
     // bound to target.
     if (CheckBufferTarget(target) &&
-        CheckGlEnum(value == GL_BUFFER_SIZE || value == GL_BUFFER_USAGE) &&
+        CheckGlEnum(value == GL_BUFFER_SIZE || value == GL_BUFFER_USAGE ||
+                    value == GL_BUFFER_IMMUTABLE_STORAGE ||
+                    value == GL_BUFFER_STORAGE_FLAGS) &&
         CheckBufferZeroNotBound(target) &&
         CheckFunction("GetBufferParameteriv")) {
       const GLuint index = GetBufferIndex(target);
       if (value == GL_BUFFER_SIZE) {
         *data = static_cast<GLint>(object_state_->buffers[index].size);
+      } else if (value == GL_BUFFER_IMMUTABLE_STORAGE) {
+        *data = object_state_->buffers[index].immutable_storage ? GL_TRUE
+                                                                : GL_FALSE;
+      } else if (value == GL_BUFFER_STORAGE_FLAGS) {
+        *data = static_cast<GLint>(object_state_->buffers[index].storage_flags);
       } else {
         *data = object_state_->buffers[index].usage;
       }
@@ -2889,6 +3096,18 @@ class MockVisual::ShadowState {
               *params = a->cube_face;
           }
           break;
+        case GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_BASE_VIEW_INDEX_OVR:
+          if (CheckGlEnum(a->type == GL_TEXTURE))
+            *params = a->base_view_index;
+          break;
+        case GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR:
+          if (CheckGlEnum(a->type == GL_TEXTURE))
+            *params = a->num_views;
+          break;
+        case GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_SAMPLES_EXT:
+          if (CheckGlEnum(a->type == GL_TEXTURE))
+            *params = a->samples;
+          break;
         default:
           CheckGlEnum(false);
           break;
@@ -2932,8 +3151,14 @@ class MockVisual::ShadowState {
     // OpenGL.
     if (CheckGlValue(object_state_->programs.count(program)) &&
         CheckFunction("GetProgramiv")) {
-      const ProgramObject& po = object_state_->programs[program];
+      ProgramObject& po = object_state_->programs[program];
       switch (pname) {
+        case GL_COMPLETION_STATUS_KHR:
+          // Linking is reported as incomplete by the first query after it
+          // starts so that asynchronous linking can be tested.
+          *params = po.is_link_pending ? GL_FALSE : GL_TRUE;
+          po.is_link_pending = false;
+          break;
         case GL_DELETE_STATUS:
           *params = po.delete_status;
           break;
@@ -2948,8 +3173,9 @@ class MockVisual::ShadowState {
               po.info_log.length() ? po.info_log.length() + 1 : 0);
           break;
         case GL_ATTACHED_SHADERS: {
-          *params =
-              (po.vertex_shader > 0 ? 1 : 0) + (po.fragment_shader > 0 ? 1 : 0);
+          *params = (po.vertex_shader > 0 ? 1 : 0) +
+                    (po.fragment_shader > 0 ? 1 : 0) +
+                    (po.compute_shader > 0 ? 1 : 0);
           break;
         }
         case GL_ACTIVE_ATTRIBUTES: {
@@ -2974,6 +3200,14 @@ class MockVisual::ShadowState {
         case GL_ACTIVE_UNIFORMS:
           *params = static_cast<GLint>(po.uniforms.size());
           break;
+        case GL_PROGRAM_BINARY_LENGTH:
+          *params = po.link_status == GL_TRUE
+                        ? static_cast<GLint>(po.binary.length())
+                        : 0;
+          break;
+        case GL_PROGRAM_BINARY_RETRIEVABLE_HINT:
+          *params = po.binary_retrievable_hint;
+          break;
         case GL_ACTIVE_UNIFORM_MAX_LENGTH: {
           GLint length = 0;
           for (size_t i = 0; i < po.uniforms.size(); ++i) {
@@ -3136,8 +3370,14 @@ class MockVisual::ShadowState {
     // OpenGL.
     if (CheckGlValue(object_state_->shaders.count(shader)) &&
         CheckFunction("GetShaderiv")) {
-      const ShaderObject& so = object_state_->shaders[shader];
+      ShaderObject& so = object_state_->shaders[shader];
       switch (pname) {
+        case GL_COMPLETION_STATUS_KHR:
+          // Compilation is reported as incomplete by the first query after it
+          // starts so that asynchronous compilation can be tested.
+          *params = so.is_compile_pending ? GL_FALSE : GL_TRUE;
+          so.is_compile_pending = false;
+          break;
         case GL_SHADER_TYPE:
           *params = so.type;
           break;
@@ -3590,7 +3830,7 @@ class MockVisual::ShadowState {
       line_width_ = width;
   }
 
-  bool BindTransformFeedbackVaryings(const ProgramObject& po) {
+  bool BindTransformFeedbackVaryings(GLuint program, const ProgramObject& po) {
     // The program will fail to link if the following conditions are met:
     // (1) The count specified by TransformFeedbackVaryings is non-zero, but the
     // program object has no vertex or geometry shader.
@@ -3607,6 +3847,9 @@ class MockVisual::ShadowState {
     // mode is GL_INTERLEAVED_ATTRIBS.
     TransformFeedbackObject& tfo =
         object_state_->transform_feedbacks[active_objects_.transform_feedback];
+    // The varyings only apply to the program they were specified for.
+    if (tfo.program != program)
+      return true;
     if ((!tfo.binding_point_status.empty() &&
          object_state_->shaders[po.vertex_shader].compile_status != GL_TRUE) ||
         (tfo.buffer_mode == GL_SEPARATE_ATTRIBS &&
@@ -3626,13 +3869,13 @@ class MockVisual::ShadowState {
     }
     for (int i = 0; i < static_cast<int>(tfo.binding_point_status.size());
          ++i) {
-      if (varyings_name_map.find(*(tfo.varyings + i)) ==
+      if (varyings_name_map.find(tfo.varyings[i]) ==
           varyings_name_map.end()) {
         return false;
       }
       tfo.binding_point_status[i] =
-          varyings_name_map[*(tfo.varyings + i)]->index;
-      varyings_name_map.erase(*(tfo.varyings + i));
+          varyings_name_map[tfo.varyings[i]]->index;
+      varyings_name_map.erase(tfo.varyings[i]);
     }
     return true;
   }
@@ -3646,9 +3889,12 @@ class MockVisual::ShadowState {
       ProgramObject& po = object_state_->programs[program];
       // GL_INVALID_OPERATION is generated if program is not a program object.
       if (CheckGlOperation(!po.deleted)) {
+        po.is_link_pending = true;
         // The below tests do not handle all of the requirements for a
         // successful link but cover the most obvious cases.
-        if (po.vertex_shader && po.fragment_shader &&
+        if (po.compute_shader) {
+          LinkComputeProgram(&po);
+        } else if (po.vertex_shader && po.fragment_shader &&
             object_state_->shaders[po.vertex_shader].compile_status ==
                 GL_TRUE &&
             object_state_->shaders[po.fragment_shader].compile_status ==
@@ -3658,11 +3904,12 @@ class MockVisual::ShadowState {
             ProgramObject old_po(po);
             po.attributes.clear();
             po.uniforms.clear();
+            po.uniform_blocks.clear();
             po.varyings.clear();
             po.max_uniform_location = 0U;
             AddShaderInputs(&po,
                 object_state_->shaders[po.vertex_shader].source);
-            if (!BindTransformFeedbackVaryings(po)) {
+            if (!BindTransformFeedbackVaryings(program, po)) {
               po = old_po;
               po.link_status = GL_FALSE;
               po.info_log = "Cannot bind transform feedback varyings.";
@@ -3671,6 +3918,10 @@ class MockVisual::ShadowState {
                   &po, object_state_->shaders[po.fragment_shader].source);
               po.link_status = GL_TRUE;
               po.info_log.clear();
+              po.binary = std::string(kProgramBinaryHeader) +
+                          object_state_->shaders[po.vertex_shader].source +
+                          '\0' +
+                          object_state_->shaders[po.fragment_shader].source;
             }
           } else {
             po.link_status = GL_FALSE;
@@ -3680,6 +3931,30 @@ class MockVisual::ShadowState {
       }
     }
   }
+  // Links a program with a compute shader, which must have no other stages.
+  void LinkComputeProgram(ProgramObject* po) {
+    const ShaderObject& so = object_state_->shaders[po->compute_shader];
+    if (so.compile_status != GL_TRUE)
+      return;
+    if (po->vertex_shader || po->fragment_shader) {
+      // A compute shader cannot be linked with any other stage.
+      po->link_status = GL_FALSE;
+      po->info_log = "Compute shaders cannot be linked with other stages.";
+    } else if (CheckFunction("LinkProgram")) {
+      po->attributes.clear();
+      po->uniforms.clear();
+      po->uniform_blocks.clear();
+      po->varyings.clear();
+      po->max_uniform_location = 0U;
+      AddShaderInputs(po, so.source);
+      po->link_status = GL_TRUE;
+      po->info_log.clear();
+      po->binary = std::string(kProgramBinaryHeader) + so.source + '\0';
+    } else {
+      po->link_status = GL_FALSE;
+      po->info_log = "Program linking is set to always fail.";
+    }
+  }
   void PixelStorei(GLenum pname, GLint param) {
     // GL_INVALID_ENUM is generated if pname is not an accepted value.
     if (CheckGlEnum(pname == GL_PACK_ALIGNMENT ||
@@ -4861,6 +5136,50 @@ class MockVisual::ShadowState {
     }
   }
 
+  // BufferStorage group.
+  void BufferStorage(GLenum target, GLsizeiptr size, const GLvoid* data,
+                     GLbitfield flags) {
+    // GL_INVALID_ENUM is generated if target is not one of the accepted buffer
+    // targets.
+    // GL_INVALID_VALUE is generated if size is less than or equal to zero.
+    // GL_INVALID_VALUE is generated if flags has any bits set other than those
+    // defined above.
+    // GL_INVALID_VALUE is generated if flags contains GL_MAP_PERSISTENT_BIT
+    // but does not contain at least one of GL_MAP_READ_BIT or GL_MAP_WRITE_BIT.
+    // GL_INVALID_VALUE is generated if flags contains GL_MAP_COHERENT_BIT, but
+    // does not also contain GL_MAP_PERSISTENT_BIT.
+    // GL_INVALID_OPERATION is generated if the reserved buffer object name 0 is
+    // bound to target.
+    // GL_INVALID_OPERATION is generated if the GL_BUFFER_IMMUTABLE_STORAGE
+    // flag of the buffer bound to target is GL_TRUE.
+    // GL_OUT_OF_MEMORY is generated if the GL is unable to create a data store
+    // with the specified size.
+    static const GLbitfield kValidBits =
+        GL_DYNAMIC_STORAGE_BIT | GL_MAP_READ_BIT | GL_MAP_WRITE_BIT |
+        GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_CLIENT_STORAGE_BIT;
+    if (CheckBufferTarget(target) &&
+        CheckGlValue(size > 0 && (flags & ~kValidBits) == 0) &&
+        CheckGlValue(!(flags & GL_MAP_PERSISTENT_BIT) ||
+                     (flags & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT))) &&
+        CheckGlValue(!(flags & GL_MAP_COHERENT_BIT) ||
+                     (flags & GL_MAP_PERSISTENT_BIT)) &&
+        CheckBufferZeroNotBound(target) &&
+        CheckGlOperation(
+            !object_state_->buffers[GetBufferIndex(target)]
+                 .immutable_storage) &&
+        CheckGlMemory(size) && CheckFunction("BufferStorage")) {
+      BufferObject& bo = object_state_->buffers[GetBufferIndex(target)];
+      bo.ClearData();
+      bo.size = size;
+      bo.usage = GL_DYNAMIC_DRAW;
+      bo.data = reinterpret_cast<void*>(new uint8[size]);
+      if (data)
+        std::memcpy(bo.data, data, size);
+      bo.immutable_storage = true;
+      bo.storage_flags = flags;
+    }
+  }
+
   // ChooseBuffer group.
   void DrawBuffer(GLenum buffer) {
     if (CheckGlEnum(buffer == GL_NONE ||
@@ -4893,6 +5212,111 @@ class MockVisual::ShadowState {
     }
   }
 
+  // ComputeShader group.
+  void BindImageTexture(GLuint unit, GLuint texture, GLint level,
+                        GLboolean layered, GLint layer, GLenum access,
+                        GLenum format) {
+    // GL_INVALID_VALUE is generated if unit is greater than or equal to
+    // GL_MAX_IMAGE_UNITS, if texture is not the name of an existing texture
+    // object, or if level or layer is negative.
+    // GL_INVALID_ENUM is generated if access or format is not one of the
+    // accepted tokens.
+    if (CheckGlValue(unit < kMaxImageUnits && level >= 0 && layer >= 0 &&
+                     (texture == 0U ||
+                      object_state_->textures.count(texture))) &&
+        CheckGlEnum(access == GL_READ_ONLY || access == GL_WRITE_ONLY ||
+                    access == GL_READ_WRITE) &&
+        CheckGlEnum(format == GL_RGBA32F || format == GL_RGBA16F ||
+                    format == GL_R32F || format == GL_RGBA32UI ||
+                    format == GL_RGBA16UI || format == GL_RGBA8UI ||
+                    format == GL_R32UI || format == GL_RGBA32I ||
+                    format == GL_RGBA16I || format == GL_RGBA8I ||
+                    format == GL_R32I || format == GL_RGBA8 ||
+                    format == GL_RGBA8_SNORM) &&
+        CheckFunction("BindImageTexture")) {
+      if (texture)
+        object_state_->textures[texture].bindings.push_back(GetCallCount());
+    }
+  }
+  void DispatchCompute(GLuint num_groups_x, GLuint num_groups_y,
+                       GLuint num_groups_z) {
+    // GL_INVALID_OPERATION is generated if there is no active program for the
+    // compute shader stage.
+    // GL_INVALID_VALUE is generated if any of the group counts is greater
+    // than the corresponding GL_MAX_COMPUTE_WORK_GROUP_COUNT.
+    if (CheckGlOperation(IsComputeProgramActive()) &&
+        CheckGlValue(num_groups_x <= kMaxComputeWorkGroupCount &&
+                     num_groups_y <= kMaxComputeWorkGroupCount &&
+                     num_groups_z <= kMaxComputeWorkGroupCount) &&
+        CheckFunction("DispatchCompute")) {
+      // Dispatches are not implemented.
+    }
+  }
+  void DispatchComputeIndirect(GLintptr indirect) {
+    // GL_INVALID_VALUE is generated if indirect is less than zero or not a
+    // multiple of four.
+    // GL_INVALID_OPERATION is generated if there is no active program for the
+    // compute shader stage, if no buffer is bound to
+    // GL_DISPATCH_INDIRECT_BUFFER, or if the command would be read beyond the
+    // end of its data store.
+    const GLuint buffer = active_objects_.dispatch_indirect_buffer;
+    if (CheckGlValue(indirect >= 0 && indirect % 4 == 0) &&
+        CheckGlOperation(IsComputeProgramActive() && buffer != 0U) &&
+        CheckGlOperation(
+            static_cast<size_t>(indirect) + 3U * sizeof(GLuint) <=
+            static_cast<size_t>(object_state_->buffers[buffer].size)) &&
+        CheckFunction("DispatchComputeIndirect")) {
+      // Dispatches are not implemented.
+    }
+  }
+  void MemoryBarrier(GLbitfield barriers) {
+    // GL_INVALID_VALUE is generated if barriers is not GL_ALL_BARRIER_BITS
+    // and contains any unsupported bits.
+    static const GLbitfield kSupportedBarriers =
+        GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT |
+        GL_UNIFORM_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT |
+        GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_COMMAND_BARRIER_BIT |
+        GL_PIXEL_BUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT |
+        GL_BUFFER_UPDATE_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT |
+        GL_SHADER_STORAGE_BARRIER_BIT;
+    if (CheckGlValue(barriers == GL_ALL_BARRIER_BITS ||
+                     (barriers & ~kSupportedBarriers) == 0U) &&
+        CheckFunction("MemoryBarrier")) {
+      // Memory accesses are always coherent in the mock.
+    }
+  }
+  // Returns whether the active program is a linked compute program.
+  bool IsComputeProgramActive() {
+    if (!active_objects_.program)
+      return false;
+    const ProgramObject& po = object_state_->programs[active_objects_.program];
+    return po.compute_shader != 0U && po.link_status == GL_TRUE;
+  }
+
+  // ConditionalRender group.
+  void BeginConditionalRender(GLuint id, GLenum mode) {
+    // GL_INVALID_ENUM is generated if mode is not one of the accepted tokens.
+    // GL_INVALID_VALUE is generated if id is not the name of a query object.
+    // GL_INVALID_OPERATION is generated if conditional rendering is already
+    // active, or if id is the name of an active query object.
+    // Draws are never discarded, since they are not implemented.
+    if (CheckGlEnum(mode == GL_QUERY_WAIT || mode == GL_QUERY_NO_WAIT) &&
+        CheckGlValue(IsQuery(id)) &&
+        CheckGlOperation(conditional_render_query_ == 0U) &&
+        CheckGlOperation(!IsQueryActive(id)) &&
+        CheckFunction("BeginConditionalRender")) {
+      conditional_render_query_ = id;
+    }
+  }
+  void EndConditionalRender() {
+    // GL_INVALID_OPERATION is generated if conditional rendering is not
+    // active.
+    if (CheckGlOperation(conditional_render_query_ != 0U) &&
+        CheckFunction("EndConditionalRender")) {
+      conditional_render_query_ = 0U;
+    }
+  }
+
   // DebugMarker group.
   // These functions do nothing since the driver is supposed to expose stream
   // inspection. OpenGL does not provide any way of inspecting markers, stating
@@ -5035,6 +5459,72 @@ class MockVisual::ShadowState {
     }
   }
 
+  // MultisampledRenderToTexture group.
+  void FramebufferTexture2DMultisampleEXT(GLenum target, GLenum attachment,
+                                          GLenum textarget, GLuint texture,
+                                          GLint level, GLsizei samples) {
+    if (CheckGlEnum(
+            // GL_INVALID_ENUM is generated if target is not GL_FRAMEBUFFER,
+            // attachment is not GL_COLOR_ATTACHMENT0, or textarget is not
+            // GL_TEXTURE_2D or a cube map face and texture is not 0.
+            target == GL_FRAMEBUFFER &&
+            attachment == GL_COLOR_ATTACHMENT0 &&
+            (textarget == GL_TEXTURE_2D || IsCubeMapTarget(textarget) ||
+             texture == 0U)) &&
+        // GL_INVALID_VALUE is generated if samples is negative or greater
+        // than GL_MAX_SAMPLES_EXT, or if level is not 0.
+        CheckGlValue(samples >= 0 && samples <= kMaxSamples && level == 0) &&
+        CheckGlOperation(
+            // GL_INVALID_OPERATION is generated if the default framebuffer
+            // object name 0 is bound.
+            active_objects_.draw_framebuffer != 0U &&
+            // GL_INVALID_OPERATION is generated if texture is neither 0 nor
+            // the name of an existing texture of a matching target.
+            (texture == 0U ||
+             (object_state_->textures.count(texture) &&
+              ((textarget == GL_TEXTURE_2D &&
+                object_state_->textures[texture].target == GL_TEXTURE_2D) ||
+               (IsCubeMapTarget(textarget) &&
+                object_state_->textures[texture].target ==
+                    GL_TEXTURE_CUBE_MAP))))) &&
+        CheckFunction("FramebufferTexture2DMultisampleEXT")) {
+      FramebufferObject::Attachment* a =
+          &object_state_->framebuffers[active_objects_.draw_framebuffer].color0;
+      a->type = texture ? GL_TEXTURE : GL_NONE;
+      a->value = texture;
+      a->level = 0;
+      a->cube_face = texture ? textarget : 0;
+      a->base_view_index = 0;
+      a->num_views = 0;
+      a->samples = texture ? samples : 0;
+    }
+  }
+  void RenderbufferStorageMultisampleEXT(GLenum target, GLsizei samples,
+                                         GLenum internalformat, GLsizei width,
+                                         GLsizei height) {
+    // The errors are the same as for RenderbufferStorageMultisample(); the
+    // renderbuffer is only resolved implicitly.
+    if (CheckGlEnum(
+            target == GL_RENDERBUFFER &&
+            (gfx::FramebufferObject::IsColorRenderable(internalformat) ||
+             gfx::FramebufferObject::IsDepthRenderable(internalformat) ||
+             gfx::FramebufferObject::IsStencilRenderable(internalformat))) &&
+        CheckGlValue(samples >= 0 && samples <= kMaxSamples) &&
+        CheckGlValue(width >= 0 && width < kMaxRenderbufferSize &&
+                     height >= 0 && height < kMaxRenderbufferSize) &&
+        CheckGlOperation(active_objects_.renderbuffer != 0U) &&
+        CheckFunction("RenderbufferStorageMultisampleEXT")) {
+      RenderbufferObject& r =
+          object_state_->renderbuffers[active_objects_.renderbuffer];
+      r.width = width;
+      r.height = height;
+      r.internal_format = internalformat;
+      r.multisample_samples = samples;
+      SetColorsFromInternalFormat(internalformat, &r);
+      CheckGlMemory(ComputeRenderbufferObjectSize(r));
+    }
+  }
+
   // MapBuffer group.
   void* MapBuffer(GLenum target, GLenum access) {
     // GL_INVALID_ENUM is generated if target is not one of the accepted
@@ -5123,7 +5613,8 @@ class MockVisual::ShadowState {
         CheckGlOperation(tfo.status != GL_TRANSFORM_FEEDBACK_ACTIVE ||
                          tfo.primitive_mode == mode) &&
         CheckFunction("DrawArraysInstanced")) {
-      // There is nothing to do since we do not implement draw functions.
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
     }
   }
   void DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type,
@@ -5152,7 +5643,42 @@ class MockVisual::ShadowState {
                 ->transform_feedbacks[active_objects_.transform_feedback]
                 .status != GL_TRANSFORM_FEEDBACK_ACTIVE) &&
         CheckFunction("DrawElementsInstanced")) {
-      // There is nothing to do since we do not implement draw functions.
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
+    }
+  }
+
+  // InvalidateFramebuffer group.
+  void InvalidateFramebuffer(GLenum target, GLsizei num_attachments,
+                             const GLenum* attachments) {
+    // GL_INVALID_ENUM is generated if target is not GL_FRAMEBUFFER,
+    // GL_READ_FRAMEBUFFER, or GL_DRAW_FRAMEBUFFER.
+    // GL_INVALID_VALUE is generated if num_attachments is negative.
+    // GL_INVALID_ENUM is generated if any element of attachments is not an
+    // attachment of the bound framebuffer; the default framebuffer uses
+    // GL_COLOR, GL_DEPTH, and GL_STENCIL.
+    const GLuint framebuffer = target == GL_READ_FRAMEBUFFER
+                                   ? active_objects_.read_framebuffer
+                                   : active_objects_.draw_framebuffer;
+    bool attachments_valid = num_attachments <= 0 || attachments != NULL;
+    for (GLsizei i = 0; attachments_valid && i < num_attachments; ++i) {
+      if (framebuffer == 0U) {
+        attachments_valid = attachments[i] == GL_COLOR ||
+                            attachments[i] == GL_DEPTH ||
+                            attachments[i] == GL_STENCIL;
+      } else {
+        attachments_valid = attachments[i] == GL_COLOR_ATTACHMENT0 ||
+                            attachments[i] == GL_DEPTH_ATTACHMENT ||
+                            attachments[i] == GL_STENCIL_ATTACHMENT;
+      }
+    }
+    if (CheckGlEnum(target == GL_FRAMEBUFFER ||
+                    target == GL_READ_FRAMEBUFFER ||
+                    target == GL_DRAW_FRAMEBUFFER) &&
+        CheckGlValue(num_attachments >= 0) &&
+        CheckGlEnum(attachments_valid) &&
+        CheckFunction("InvalidateFramebuffer")) {
+      // There is nothing to do since we do not store framebuffer contents.
     }
   }
 
@@ -5232,9 +5758,14 @@ class MockVisual::ShadowState {
     // GL_OUT_OF_MEMORY is generated if glMapBufferRange fails because memory
     // for the mapping could not be obtained.
     static const GLuint kRequiredMask = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT;
+    //   GL_MAP_PERSISTENT_BIT or GL_MAP_COHERENT_BIT is set and the buffer's
+    //     data store was not created with the same bit.
     static const GLuint kOptionalMask =
         GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
-        GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+        GL_MAP_FLUSH_EXPLICIT_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+        GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    static const GLuint kStorageBits =
+        GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
     static const GLuint kAllBadBits = ~(kRequiredMask | kOptionalMask);
     static const GLuint kBadReadBits = GL_MAP_INVALIDATE_RANGE_BIT |
                                        GL_MAP_INVALIDATE_BUFFER_BIT |
@@ -5252,7 +5783,8 @@ class MockVisual::ShadowState {
       GLuint index = GetBufferIndex(target);
       BufferObject& bo = object_state_->buffers[index];
       if (CheckGlOperation(bo.mapped_data == NULL) &&
-          CheckGlValue(offset + length < bo.size)) {
+          CheckGlOperation((access & kStorageBits & ~bo.storage_flags) == 0) &&
+          CheckGlValue(offset + length <= bo.size)) {
         uint8* int_data = reinterpret_cast<uint8*>(bo.data);
         data = bo.mapped_data = &int_data[offset];
         bo.access = access;
@@ -5261,6 +5793,169 @@ class MockVisual::ShadowState {
     return data;
   }
 
+  // MultiDraw group.
+  void MultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count,
+                       GLsizei drawcount) {
+    TransformFeedbackObject& tfo =
+        object_state_->transform_feedbacks[active_objects_.transform_feedback];
+    // GL_INVALID_ENUM is generated if mode is not an accepted value.
+    // GL_INVALID_VALUE is generated if drawcount or any count is negative.
+    // GL_INVALID_OPERATION is generated if a non-zero buffer object name is
+    // bound to an enabled array and the buffer object's data store is currently
+    // mapped.
+    // GL_INVALID_OPERATION is generated if transform feedback is active and
+    // mode does not exactly match primitive_mode.
+    if (CheckDrawMode(mode) && CheckGlValue(drawcount >= 0) &&
+        CheckGlValue(AreCountsNonNegative(count, drawcount)) &&
+        (active_objects_.buffer == 0 ||
+         CheckGlOperation(object_state_->buffers[active_objects_.buffer].data !=
+                          NULL)) &&
+        CheckGlOperation(tfo.status != GL_TRANSFORM_FEEDBACK_ACTIVE ||
+                         tfo.primitive_mode == mode) &&
+        CheckFunction("MultiDrawArrays")) {
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
+    }
+  }
+  void MultiDrawElements(GLenum mode, const GLsizei* count, GLenum type,
+                         const GLvoid* const* indices, GLsizei drawcount) {
+    // GL_INVALID_ENUM is generated if mode is not an accepted value.
+    // GL_INVALID_ENUM is generated if type is not GL_UNSIGNED_BYTE,
+    // GL_UNSIGNED_INT or GL_UNSIGNED_SHORT.
+    // GL_INVALID_VALUE is generated if drawcount or any count is negative.
+    // GL_INVALID_OPERATION is generated if a non-zero buffer object name is
+    // bound to an enabled array or the element array and the buffer object's
+    // data store is currently mapped.
+    // GL_INVALID_OPERATION is generated if transform feedback is active and not
+    // paused.
+    if (CheckDrawMode(mode) && CheckGlValue(drawcount >= 0) &&
+        CheckGlValue(AreCountsNonNegative(count, drawcount)) &&
+        CheckGlEnum(type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_INT ||
+                    type == GL_UNSIGNED_SHORT) &&
+        (active_objects_.buffer == 0 ||
+         (CheckGlOperation(
+             object_state_->buffers[active_objects_.buffer].data != NULL))) &&
+        (active_objects_.index_buffer == 0 ||
+         (CheckGlOperation(
+             object_state_->buffers[active_objects_.index_buffer].data !=
+             NULL))) &&
+        CheckGlOperation(
+            object_state_
+                ->transform_feedbacks[active_objects_.transform_feedback]
+                .status != GL_TRANSFORM_FEEDBACK_ACTIVE) &&
+        CheckFunction("MultiDrawElements")) {
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
+    }
+  }
+
+  // DrawIndirect group.
+  void DrawArraysIndirect(GLenum mode, const GLvoid* indirect) {
+    // GL_INVALID_ENUM is generated if mode is not an accepted value.
+    // GL_INVALID_OPERATION is generated if no buffer is bound to
+    // GL_DRAW_INDIRECT_BUFFER, or if the command would be read beyond the end
+    // of its data store.
+    // GL_INVALID_OPERATION is generated if transform feedback is active and
+    // not paused.
+    if (CheckDrawMode(mode) && CheckIndirectCommand(indirect, 4U) &&
+        CheckGlOperation(
+            object_state_
+                ->transform_feedbacks[active_objects_.transform_feedback]
+                .status != GL_TRANSFORM_FEEDBACK_ACTIVE) &&
+        CheckFunction("DrawArraysIndirect")) {
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
+    }
+  }
+  void DrawElementsIndirect(GLenum mode, GLenum type, const GLvoid* indirect) {
+    // GL_INVALID_ENUM is generated if mode is not an accepted value.
+    // GL_INVALID_ENUM is generated if type is not GL_UNSIGNED_BYTE,
+    // GL_UNSIGNED_INT or GL_UNSIGNED_SHORT.
+    // GL_INVALID_OPERATION is generated if no buffer is bound to
+    // GL_DRAW_INDIRECT_BUFFER or GL_ELEMENT_ARRAY_BUFFER, or if the command
+    // would be read beyond the end of its data store.
+    // GL_INVALID_OPERATION is generated if transform feedback is active and
+    // not paused.
+    if (CheckDrawMode(mode) &&
+        CheckGlEnum(type == GL_UNSIGNED_BYTE || type == GL_UNSIGNED_INT ||
+                    type == GL_UNSIGNED_SHORT) &&
+        CheckGlOperation(active_objects_.index_buffer != 0U) &&
+        CheckIndirectCommand(indirect, 5U) &&
+        CheckGlOperation(
+            object_state_
+                ->transform_feedbacks[active_objects_.transform_feedback]
+                .status != GL_TRANSFORM_FEEDBACK_ACTIVE) &&
+        CheckFunction("DrawElementsIndirect")) {
+      // Draws are not implemented, but are counted for queries.
+      ++draw_count_;
+    }
+  }
+  // Returns whether a command of word_count GLuints can be read at the offset
+  // indirect into the bound GL_DRAW_INDIRECT_BUFFER.
+  bool CheckIndirectCommand(const GLvoid* indirect, size_t word_count) {
+    const GLuint buffer = active_objects_.indirect_buffer;
+    const size_t offset = reinterpret_cast<size_t>(indirect);
+    return CheckGlOperation(buffer != 0U) &&
+           CheckGlOperation(offset % sizeof(GLuint) == 0U) &&
+           CheckGlOperation(
+               offset + word_count * sizeof(GLuint) <=
+               static_cast<size_t>(object_state_->buffers[buffer].size));
+  }
+
+  // Multiview group.
+  void FramebufferTextureMultiviewOVR(GLenum target, GLenum attachment,
+                                      GLuint texture, GLint level,
+                                      GLint baseViewIndex, GLsizei numViews) {
+    if (CheckGlEnum(
+            // GL_INVALID_ENUM is generated if target is not a framebuffer
+            // target or attachment is not an accepted attachment point.
+            (target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER) &&
+            (attachment == GL_COLOR_ATTACHMENT0 ||
+             attachment == GL_DEPTH_ATTACHMENT ||
+             attachment == GL_STENCIL_ATTACHMENT)) &&
+        // GL_INVALID_VALUE is generated if numViews is less than 1 or greater
+        // than GL_MAX_VIEWS_OVR, or if the views exceed the layers of the
+        // texture.
+        CheckGlValue(texture == 0U ||
+                     (level >= 0 && baseViewIndex >= 0 && numViews >= 1 &&
+                      numViews <= kMaxViews &&
+                      baseViewIndex + numViews <= kMaxArrayTextureLayers)) &&
+        CheckGlOperation(
+            // GL_INVALID_OPERATION is generated if the default framebuffer
+            // object name 0 is bound.
+            active_objects_.draw_framebuffer != 0U &&
+            // GL_INVALID_OPERATION is generated if texture is neither 0 nor
+            // the name of an existing two-dimensional array texture.
+            (texture == 0U ||
+             (object_state_->textures.count(texture) &&
+              object_state_->textures[texture].target ==
+                  GL_TEXTURE_2D_ARRAY))) &&
+        CheckFunction("FramebufferTextureMultiviewOVR")) {
+      FramebufferObject::Attachment* a;
+      if (attachment == GL_COLOR_ATTACHMENT0)
+        a = &object_state_->
+            framebuffers[active_objects_.draw_framebuffer].color0;
+      else if (attachment == GL_DEPTH_ATTACHMENT)
+        a = &object_state_->
+            framebuffers[active_objects_.draw_framebuffer].depth;
+      else  // attachment == GL_STENCIL_ATTACHMENT
+        a = &object_state_->
+            framebuffers[active_objects_.draw_framebuffer].stencil;
+      a->type = texture ? GL_TEXTURE : GL_NONE;
+      a->value = texture;
+      a->level = texture ? level : 0;
+      a->base_view_index = texture ? baseViewIndex : 0;
+      a->num_views = texture ? numViews : 0;
+      a->samples = 0;
+    }
+  }
+
+  // ParallelShaderCompile group.
+  void MaxShaderCompilerThreadsKHR(GLuint count) {
+    if (CheckFunction("MaxShaderCompilerThreadsKHR"))
+      max_shader_compiler_threads_ = count;
+  }
+
   // PointSize group.
   void PointSize(GLfloat size) {
     // GL_INVALID_VALUE is generated if size is less than or equal to 0.
@@ -5268,6 +5963,171 @@ class MockVisual::ShadowState {
       point_size_ = size;
   }
 
+  // ProgramBinary group.
+  void GetProgramBinary(GLuint program, GLsizei buf_size, GLsizei* length,
+                        GLenum* binary_format, GLvoid* binary) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL.
+    // GL_INVALID_OPERATION is generated if buf_size is less than the size of
+    // GL_PROGRAM_BINARY_LENGTH for program, or if GL_LINK_STATUS for the
+    // program object is false.
+    if (CheckGlValue(object_state_->programs.count(program)) &&
+        CheckFunction("GetProgramBinary")) {
+      const ProgramObject& po = object_state_->programs[program];
+      if (CheckGlOperation(!po.deleted && po.link_status == GL_TRUE &&
+                           static_cast<size_t>(buf_size) >=
+                               po.binary.length())) {
+        memcpy(binary, po.binary.c_str(), po.binary.length());
+        if (length)
+          *length = static_cast<GLsizei>(po.binary.length());
+        *binary_format = kProgramBinaryFormat;
+      }
+    }
+  }
+  void ProgramBinary(GLuint program, GLenum binary_format,
+                     const GLvoid* binary, GLsizei length) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL.
+    // GL_INVALID_ENUM is generated if binary_format is not a value returned
+    // by GL_PROGRAM_BINARY_FORMATS.
+    if (CheckGlValue(object_state_->programs.count(program)) &&
+        CheckGlEnum(binary_format == kProgramBinaryFormat) &&
+        CheckFunction("ProgramBinary")) {
+      ProgramObject& po = object_state_->programs[program];
+      if (CheckGlOperation(!po.deleted)) {
+        // Binaries that were not returned by GetProgramBinary() are rejected
+        // by failing the link, as drivers do for binaries from other builds.
+        const std::string data(static_cast<const char*>(binary), length);
+        const size_t header_length = strlen(kProgramBinaryHeader);
+        const size_t separator = data.find('\0', header_length);
+        po.attributes.clear();
+        po.uniforms.clear();
+        po.uniform_blocks.clear();
+        po.varyings.clear();
+        po.max_uniform_location = 0U;
+        if (data.compare(0, header_length, kProgramBinaryHeader) == 0 &&
+            separator != std::string::npos) {
+          AddShaderInputs(&po,
+                          data.substr(header_length, separator - header_length));
+          AddShaderInputs(&po, data.substr(separator + 1U));
+          po.binary = data;
+          po.link_status = GL_TRUE;
+          po.info_log.clear();
+        } else {
+          po.binary.clear();
+          po.link_status = GL_FALSE;
+          po.info_log = "Invalid program binary.";
+        }
+      }
+    }
+  }
+  void ProgramParameteri(GLuint program, GLenum pname, GLint value) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL, or if value is not GL_FALSE or GL_TRUE.
+    // GL_INVALID_ENUM is generated if pname is not
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT.
+    if (CheckGlValue(object_state_->programs.count(program)) &&
+        CheckGlEnum(pname == GL_PROGRAM_BINARY_RETRIEVABLE_HINT) &&
+        CheckGlValue(value == GL_FALSE || value == GL_TRUE) &&
+        CheckFunction("ProgramParameteri")) {
+      ProgramObject& po = object_state_->programs[program];
+      if (CheckGlOperation(!po.deleted))
+        po.binary_retrievable_hint = value;
+    }
+  }
+
+  // ProgramInterfaceQuery group. Only the GL_UNIFORM interface is supported.
+  void GetProgramInterfaceiv(GLuint program, GLenum programInterface,
+                             GLenum pname, GLint* params) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL.
+    // GL_INVALID_ENUM is generated if programInterface or pname is not an
+    // accepted value.
+    if (CheckGlValue(object_state_->programs.count(program)) &&
+        CheckGlEnum(programInterface == GL_UNIFORM) &&
+        CheckGlEnum(pname == GL_ACTIVE_RESOURCES ||
+                    pname == GL_MAX_NAME_LENGTH) &&
+        CheckFunction("GetProgramInterfaceiv")) {
+      const ProgramObject& po = object_state_->programs[program];
+      // GL_INVALID_OPERATION is generated if program is not a program object.
+      if (CheckGlOperation(!po.deleted)) {
+        if (pname == GL_ACTIVE_RESOURCES) {
+          *params = static_cast<GLint>(po.uniforms.size());
+        } else {
+          size_t max_length = 0U;
+          for (size_t i = 0; i < po.uniforms.size(); ++i)
+            max_length = std::max(max_length, po.uniforms[i].name.length());
+          *params =
+              po.uniforms.empty() ? 0 : static_cast<GLint>(max_length + 1);
+        }
+      }
+    }
+  }
+  void GetProgramResourceName(GLuint program, GLenum programInterface,
+                              GLuint index, GLsizei bufSize, GLsizei* length,
+                              GLchar* name) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL, if index is not the index of an active resource, or if bufSize
+    // is less than 0.
+    // GL_INVALID_ENUM is generated if programInterface is not an accepted
+    // value.
+    if (CheckGlValue(
+            object_state_->programs.count(program) && bufSize >= 0 &&
+            index < object_state_->programs[program].uniforms.size()) &&
+        CheckGlEnum(programInterface == GL_UNIFORM) &&
+        CheckGlOperation(!object_state_->programs[program].deleted) &&
+        CheckFunction("GetProgramResourceName")) {
+      const ProgramObject::Uniform& u =
+          object_state_->programs[program].uniforms[index];
+      if (bufSize > 0) {
+        const size_t to_copy = std::min(static_cast<size_t>(bufSize - 1),
+                                        u.name.length());
+        if (length)
+          *length = static_cast<GLsizei>(to_copy);
+        if (name) {
+          std::memcpy(name, u.name.data(), to_copy);
+          name[to_copy] = '\0';
+        }
+      }
+    }
+  }
+  void GetProgramResourceiv(GLuint program, GLenum programInterface,
+                            GLuint index, GLsizei propCount,
+                            const GLenum* props, GLsizei bufSize,
+                            GLsizei* length, GLint* params) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL, if index is not the index of an active resource, or if
+    // propCount is not positive.
+    // GL_INVALID_ENUM is generated if programInterface or any of props is not
+    // an accepted value.
+    bool props_valid = true;
+    for (GLsizei i = 0; i < propCount; ++i) {
+      props_valid = props_valid &&
+                    (props[i] == GL_TYPE || props[i] == GL_ARRAY_SIZE ||
+                     props[i] == GL_LOCATION);
+    }
+    if (CheckGlValue(
+            object_state_->programs.count(program) && propCount > 0 &&
+            index < object_state_->programs[program].uniforms.size()) &&
+        CheckGlEnum(programInterface == GL_UNIFORM && props_valid) &&
+        CheckGlOperation(!object_state_->programs[program].deleted) &&
+        CheckFunction("GetProgramResourceiv")) {
+      const ProgramObject::Uniform& u =
+          object_state_->programs[program].uniforms[index];
+      const GLsizei count = std::min(propCount, bufSize);
+      for (GLsizei i = 0; i < count; ++i) {
+        if (props[i] == GL_TYPE)
+          params[i] = static_cast<GLint>(u.type);
+        else if (props[i] == GL_ARRAY_SIZE)
+          params[i] = u.size;
+        else
+          params[i] = u.index;
+      }
+      if (length)
+        *length = count;
+    }
+  }
+
   // SamplerObjects group.
   void BindSampler(GLuint unit, GLuint sampler) {
     // GL_INVALID_VALUE is generated if unit is greater than or equal to the
@@ -6094,7 +6954,7 @@ class MockVisual::ShadowState {
         CheckAllBindingPointsBound(tfo.binding_point_status) &&
         CheckGlOperation(
             tfo.program != 0 && tfo.binding_point_status.size() != 0 &&
-            tfo.varyings != nullptr && *(tfo.varyings) != nullptr) &&
+            !tfo.varyings.empty()) &&
         CheckFunction("BeginTransformFeedback")) {
       tfo.status = GL_TRANSFORM_FEEDBACK_ACTIVE;
       tfo.primitive_mode = primitive_mode;
@@ -6161,7 +7021,7 @@ class MockVisual::ShadowState {
           object_state_
               ->transform_feedbacks[active_objects_.transform_feedback];
       tfo.program = program;
-      tfo.varyings = varyings;
+      tfo.varyings.assign(varyings, varyings + count);
       tfo.buffer_mode = buffer_mode;
       tfo.binding_point_status.clear();
       tfo.binding_point_status.resize(count, -1);
@@ -6239,6 +7099,165 @@ class MockVisual::ShadowState {
     }
   }
 
+  // UniformBufferObjects group.
+  // Binds a buffer to an indexed transform feedback binding point for
+  // BindBufferBase() or BindBufferRange().
+  void BindTransformFeedbackBuffer(GLuint index, GLuint buffer,
+                                   GLintptr offset, const char* func_name) {
+    // GL_INVALID_OPERATION is generated if transform feedback is active.
+    const TransformFeedbackObject& tfo =
+        object_state_->transform_feedbacks[active_objects_.transform_feedback];
+    if (CheckGlValue(kMaxTransformFeedbackSeparateAttribs == -1 ||
+                     static_cast<GLint>(index) <
+                         kMaxTransformFeedbackSeparateAttribs) &&
+        CheckGlValue(object_state_->buffers.count(buffer)) &&
+        CheckGlOperation(tfo.status != GL_TRANSFORM_FEEDBACK_ACTIVE) &&
+        CheckFunction(func_name)) {
+      object_state_->buffers[buffer].bindings.push_back(GetCallCount());
+    }
+  }
+  void BindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    // GL_INVALID_ENUM is generated if target is not GL_UNIFORM_BUFFER,
+    // GL_SHADER_STORAGE_BUFFER or GL_TRANSFORM_FEEDBACK_BUFFER.
+    // GL_INVALID_VALUE is generated if index is greater than or equal to
+    // GL_MAX_UNIFORM_BUFFER_BINDINGS, or for transform feedback,
+    // GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS.
+    // GL_INVALID_VALUE is generated if buffer is not a name previously
+    // returned from a call to glGenBuffers.
+    if (target == GL_TRANSFORM_FEEDBACK_BUFFER) {
+      BindTransformFeedbackBuffer(index, buffer, 0, "BindBufferBase");
+      return;
+    }
+    if (target == GL_SHADER_STORAGE_BUFFER) {
+      // GL_INVALID_VALUE is generated if index is greater than or equal to
+      // GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS.
+      if (CheckGlValue(index < kMaxShaderStorageBufferBindings) &&
+          CheckGlValue(object_state_->buffers.count(buffer)) &&
+          CheckFunction("BindBufferBase")) {
+        // The buffer is also bound to the generic binding point.
+        active_objects_.shader_storage_buffer = buffer;
+        object_state_->buffers[buffer].bindings.push_back(GetCallCount());
+      }
+      return;
+    }
+    if (CheckGlEnum(target == GL_UNIFORM_BUFFER) &&
+        CheckGlValue(index < uniform_buffer_bindings_.size()) &&
+        CheckGlValue(object_state_->buffers.count(buffer)) &&
+        CheckFunction("BindBufferBase")) {
+      UniformBufferBinding& binding = uniform_buffer_bindings_[index];
+      binding.buffer = buffer;
+      binding.offset = 0;
+      binding.size = buffer ? object_state_->buffers[buffer].size : 0;
+      // The buffer is also bound to the generic binding point.
+      active_objects_.uniform_buffer = buffer;
+      object_state_->buffers[buffer].bindings.push_back(GetCallCount());
+    }
+  }
+  void BindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                       GLintptr offset, GLsizeiptr size) {
+    // GL_INVALID_ENUM is generated if target is not GL_UNIFORM_BUFFER,
+    // GL_SHADER_STORAGE_BUFFER or GL_TRANSFORM_FEEDBACK_BUFFER.
+    // GL_INVALID_VALUE is generated if index is greater than or equal to
+    // GL_MAX_UNIFORM_BUFFER_BINDINGS, or for transform feedback,
+    // GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS.
+    // GL_INVALID_VALUE is generated if buffer is not a name previously
+    // returned from a call to glGenBuffers.
+    // GL_INVALID_VALUE is generated if buffer is non-zero and size is less
+    // than or equal to zero, or if offset is not a multiple of
+    // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, or 4 for transform feedback.
+    if (target == GL_TRANSFORM_FEEDBACK_BUFFER) {
+      if (CheckGlValue(buffer == 0U || size > 0) &&
+          CheckGlValue(offset >= 0 && offset % 4 == 0))
+        BindTransformFeedbackBuffer(index, buffer, offset, "BindBufferRange");
+      return;
+    }
+    if (target == GL_SHADER_STORAGE_BUFFER) {
+      // GL_INVALID_VALUE is generated if index is greater than or equal to
+      // GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, or if offset is not a multiple
+      // of GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT.
+      if (CheckGlValue(index < kMaxShaderStorageBufferBindings) &&
+          CheckGlValue(object_state_->buffers.count(buffer)) &&
+          CheckGlValue(buffer == 0U || size > 0) &&
+          CheckGlValue(offset >= 0 &&
+                       offset % kUniformBufferOffsetAlignment == 0) &&
+          CheckFunction("BindBufferRange")) {
+        active_objects_.shader_storage_buffer = buffer;
+        object_state_->buffers[buffer].bindings.push_back(GetCallCount());
+      }
+      return;
+    }
+    if (CheckGlEnum(target == GL_UNIFORM_BUFFER) &&
+        CheckGlValue(index < uniform_buffer_bindings_.size()) &&
+        CheckGlValue(object_state_->buffers.count(buffer)) &&
+        CheckGlValue(buffer == 0U || size > 0) &&
+        CheckGlValue(offset >= 0 &&
+                     offset % kUniformBufferOffsetAlignment == 0) &&
+        CheckFunction("BindBufferRange")) {
+      UniformBufferBinding& binding = uniform_buffer_bindings_[index];
+      binding.buffer = buffer;
+      binding.offset = offset;
+      binding.size = size;
+      // The buffer is also bound to the generic binding point.
+      active_objects_.uniform_buffer = buffer;
+      object_state_->buffers[buffer].bindings.push_back(GetCallCount());
+    }
+  }
+  void GetActiveUniformBlockiv(GLuint program, GLuint index, GLenum pname,
+                               GLint* params) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL, or if index is greater than or equal to the number of active
+    // uniform blocks in program.
+    // GL_INVALID_ENUM is generated if pname is not an accepted value.
+    if (CheckGlValue(object_state_->programs.count(program)) &&
+        CheckFunction("GetActiveUniformBlockiv")) {
+      const ProgramObject& po = object_state_->programs[program];
+      if (CheckGlOperation(!po.deleted) &&
+          CheckGlValue(index < po.uniform_blocks.size())) {
+        switch (pname) {
+          case GL_UNIFORM_BLOCK_BINDING:
+            *params = static_cast<GLint>(po.uniform_blocks[index].binding);
+            break;
+          case GL_UNIFORM_BLOCK_NAME_LENGTH:
+            *params =
+                static_cast<GLint>(po.uniform_blocks[index].name.length() + 1U);
+            break;
+          default:
+            CheckGlEnum(false);
+            break;
+        }
+      }
+    }
+  }
+  GLuint GetUniformBlockIndex(GLuint program, const GLchar* name) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL.
+    // GL_INVALID_OPERATION is generated if program is not a program object.
+    if (CheckGlValue(object_state_->programs.count(program)) &&
+        CheckFunction("GetUniformBlockIndex")) {
+      const ProgramObject& po = object_state_->programs[program];
+      if (CheckGlOperation(!po.deleted)) {
+        for (size_t i = 0; i < po.uniform_blocks.size(); ++i) {
+          if (po.uniform_blocks[i].name == name)
+            return static_cast<GLuint>(i);
+        }
+      }
+    }
+    return GL_INVALID_INDEX;
+  }
+  void UniformBlockBinding(GLuint program, GLuint index, GLuint binding) {
+    // GL_INVALID_VALUE is generated if program is not a value generated by
+    // OpenGL, if index is not an active uniform block index of program, or if
+    // binding is greater than or equal to GL_MAX_UNIFORM_BUFFER_BINDINGS.
+    if (CheckGlValue(object_state_->programs.count(program)) &&
+        CheckFunction("UniformBlockBinding")) {
+      ProgramObject& po = object_state_->programs[program];
+      if (CheckGlOperation(!po.deleted) &&
+          CheckGlValue(index < po.uniform_blocks.size()) &&
+          CheckGlValue(binding < uniform_buffer_bindings_.size()))
+        po.uniform_blocks[index].binding = binding;
+    }
+  }
+
   // VertexArray group.
   void BindVertexArray(GLuint array) {
     // GL_INVALID_OPERATION is generated if array is not zero or the name of a
@@ -6309,17 +7328,23 @@ class MockVisual::ShadowState {
     // GL_INVALID_OPERATION is generated if glBeginQuery is called
     // when a query of the given <target> is already active.
     if (!CheckFunction("BeginQuery") ||
-        !CheckGlEnum(target == GL_TIME_ELAPSED_EXT) ||
+        !CheckGlEnum(target == GL_TIME_ELAPSED_EXT ||
+                     target == GL_ANY_SAMPLES_PASSED ||
+                     target == GL_ANY_SAMPLES_PASSED_CONSERVATIVE ||
+                     target == GL_SAMPLES_PASSED ||
+                     target == GL_PRIMITIVES_GENERATED) ||
         !CheckGlOperation(id != 0) ||
         !CheckGlOperation(object_state_->timers.count(id)) ||
         !CheckGlOperation(!object_state_->timers[id].deleted) ||
-        !CheckGlOperation(active_begin_query_ == 0)) {
+        !CheckGlOperation(!IsQueryActive(id)) ||
+        !CheckGlOperation(!active_queries_.count(target))) {
       return;
     }
     object_state_->timers[id].mode = TimerObject::kIsBeginEndQuery;
     // For testing we use fixed timestamps to avoid clock issues.
     object_state_->timers[id].timestamp = 1;
-    active_begin_query_ = id;
+    object_state_->timers[id].draw_count = draw_count_;
+    active_queries_[target] = id;
   }
   void DeleteQueries(GLsizei n, const GLuint* ids) {
     // GL_INVALID_VALUE is generated if n is negative.
@@ -6338,22 +7363,36 @@ class MockVisual::ShadowState {
     }
   }
   void EndQuery(GLenum target) {
-    GLuint id = active_begin_query_;
+    const GLuint id =
+        active_queries_.count(target) ? active_queries_[target] : 0U;
     // GL_INVALID_ENUM is generated if target is not one of the accepted
     // tokens.
     // GL_INVALID_OPERATION is generated if glEndQuery is executed when a query
     // object of the same target is not active.
     if (!CheckFunction("EndQuery") ||
-        !CheckGlEnum(target == GL_TIME_ELAPSED_EXT) ||
+        !CheckGlEnum(target == GL_TIME_ELAPSED_EXT ||
+                     target == GL_ANY_SAMPLES_PASSED ||
+                     target == GL_ANY_SAMPLES_PASSED_CONSERVATIVE ||
+                     target == GL_SAMPLES_PASSED ||
+                     target == GL_PRIMITIVES_GENERATED) ||
         !CheckGlOperation(id != 0) ||
         !CheckGlOperation(object_state_->timers.count(id)) ||
         !CheckGlOperation(!object_state_->timers[id].deleted)) {
       return;
     }
-    object_state_->timers[id].is_data_available = true;
-    // For testing we use fixed duration to avoid clock issues.
-    object_state_->timers[id].duration = 1;
-    active_begin_query_ = 0;
+    TimerObject& timer = object_state_->timers[id];
+    timer.is_data_available = true;
+    if (target == GL_TIME_ELAPSED_EXT) {
+      // For testing we use fixed duration to avoid clock issues.
+      timer.duration = 1;
+    } else {
+      // Every draw is assumed to pass a single sample and generate a single
+      // primitive.
+      timer.duration = draw_count_ - timer.draw_count;
+      if (target != GL_SAMPLES_PASSED && target != GL_PRIMITIVES_GENERATED)
+        timer.duration = std::min(timer.duration, static_cast<uint64>(1U));
+    }
+    active_queries_.erase(target);
   }
   void GenQueries(GLsizei n, GLuint *ids) {
     // GL_INVALID_VALUE is generated if n is negative.
@@ -6380,8 +7419,8 @@ class MockVisual::ShadowState {
       return;
     }
     if (pname == GL_CURRENT_QUERY_EXT) {
-      if (target == GL_TIME_ELAPSED_EXT) {
-        *params = active_begin_query_;
+      if (target == GL_TIME_ELAPSED_EXT && active_queries_.count(target)) {
+        *params = active_queries_[target];
       } else {
         *params = 0;
       }
@@ -6417,7 +7456,7 @@ class MockVisual::ShadowState {
         !CheckGlOperation(id != 0) ||
         !CheckGlOperation(object_state_->timers.count(id)) ||
         !CheckGlOperation(!object_state_->timers[id].deleted) ||
-        !CheckGlOperation(id != active_begin_query_)) {
+        !CheckGlOperation(!IsQueryActive(id))) {
       return;
     }
     if (pname == GL_QUERY_RESULT_EXT) {
@@ -6438,6 +7477,14 @@ class MockVisual::ShadowState {
     return (id == 0 || !object_state_->timers.count(id) ||
             object_state_->timers[id].deleted) ? GL_FALSE : GL_TRUE;
   }
+  // Returns whether id is the active query of any target.
+  bool IsQueryActive(GLuint id) const {
+    for (const auto& active : active_queries_) {
+      if (active.second == id)
+        return true;
+    }
+    return false;
+  }
   void QueryCounter(GLuint id, GLenum target) {
     // GL_INVALID_ENUM is generated if target is not one of the accepted
     // tokens.
@@ -6449,7 +7496,7 @@ class MockVisual::ShadowState {
         !CheckGlOperation(id != 0) ||
         !CheckGlOperation(object_state_->timers.count(id)) ||
         !CheckGlOperation(!object_state_->timers[id].deleted) ||
-        !CheckGlOperation(id != active_begin_query_)) {
+        !CheckGlOperation(!IsQueryActive(id))) {
       return;
     }
     object_state_->timers[id].mode = TimerObject::kIsQueryCounter;
@@ -6495,6 +7542,9 @@ class MockVisual::ShadowState {
   // Image unit state.
   std::vector<ImageUnit> image_units_;
 
+  // Indexed uniform buffer binding points.
+  std::vector<UniformBufferBinding> uniform_buffer_bindings_;
+
   // Set of calls that will always fail.
   std::set<std::string> fail_functions_;
 
@@ -6524,7 +7574,7 @@ class MockVisual::ShadowState {
   GLsizeiptr max_buffer_size_;
 
   // Enabled capability state.
-  static const int kNumCapabilities = 14;
+  static const int kNumCapabilities = 15;
   std::bitset<kNumCapabilities> enabled_state_;
 
   // Blending state.
@@ -6564,6 +7614,9 @@ class MockVisual::ShadowState {
   // Point size.
   GLfloat point_size_;
 
+  // The maximum number of threads to use for compiling shaders.
+  GLuint max_shader_compiler_threads_;
+
   // Polygon offset state.
   GLfloat polygon_offset_factor_;
   GLfloat polygon_offset_units_;
@@ -6608,8 +7661,12 @@ class MockVisual::ShadowState {
   GLenum draw_buffer_;
   GLenum read_buffer_;
 
-  // Timer state
-  GLuint active_begin_query_;
+  // Query state: the active query of each target, and the number of draws
+  // made, which determines the results of occlusion and primitive queries.
+  std::map<GLenum, GLuint> active_queries_;
+  uint64 draw_count_;
+  // The query that conditional rendering depends on, or 0 if it is inactive.
+  GLuint conditional_render_query_;
 
   // Debug state
   std::unique_ptr<DebugMessageState> debug_message_state_;
@@ -6672,6 +7729,7 @@ MockVisual::ShadowState::ShadowState(int window_width, int window_height)
   line_width_ = 1.f;
   pack_alignment_ = unpack_alignment_ = 4;
   point_size_ = 1.f;
+  max_shader_compiler_threads_ = 0xFFFFFFFFU;
   polygon_offset_factor_ = polygon_offset_units_ = 0.0f;
   sample_coverage_value_ = 1.0f;
   sample_coverage_inverted_ = false;
@@ -6692,7 +7750,8 @@ MockVisual::ShadowState::ShadowState(int window_width, int window_height)
   viewport_height_ = window_height_;
   draw_buffer_ = GL_BACK;  // Default is GL_FRONT for single-buffered contexts
   read_buffer_ = GL_NONE;
-  active_begin_query_ = 0;
+  draw_count_ = 0U;
+  conditional_render_query_ = 0U;
   debug_message_state_.reset(new DebugMessageState());
   debug_callback_function_ = nullptr;
   debug_callback_user_param_ = nullptr;
@@ -6729,20 +7788,26 @@ MockVisual::ShadowState::ShadowState(int window_width, int window_height)
   kMaxTransformFeedbackInterleavedComponents = -1;
   kMaxTransformFeedbackSeparateAttribs = -1;
   kMaxTransformFeedbackSeparateComponents = -1;
+  kMaxUniformBufferBindings = 36;
   kMaxVaryingVectors = 15;
   kMaxVertexAttribs = 32;
   kMaxVertexTextureImageUnits = kMaxCombinedTextureImageUnits;
   kMaxVertexUniformComponents = 512;
   kMaxVertexUniformVectors = 1024;
   kMaxViewportDims = 8192;
+  kMaxViews = 4;
+  kGpuMemoryTotalKb = 1048576;
+  kGpuMemoryAvailableKb = 786432;
   kNumCompressedTextureFormats = 7;
   kNumShaderBinaryFormats = 1;
   kTransformFeedbackVaryingMaxLength = -1;
+  kUniformBufferOffsetAlignment = 256;
   kMaxDebugLoggedMessages = 16;
   kMaxDebugMessageLength = 1024;
 
   object_state_->arrays[0].attributes.resize(kMaxVertexAttribs);
   image_units_.resize(kMaxCombinedTextureImageUnits);
+  uniform_buffer_bindings_.resize(kMaxUniformBufferBindings);
   sample_masks_.resize(kMaxSampleMaskWords);
 }
 
@@ -6874,6 +7939,14 @@ void MockVisual::ShadowState::Getv(GLenum pname, T* params) {
       ION_SET(draw_buffer_);
     case GL_ELEMENT_ARRAY_BUFFER_BINDING:
       ION_SET(active_objects_.index_buffer);
+    case GL_PIXEL_PACK_BUFFER_BINDING:
+      ION_SET(active_objects_.pixel_pack_buffer);
+    case GL_PIXEL_UNPACK_BUFFER_BINDING:
+      ION_SET(active_objects_.pixel_unpack_buffer);
+    case GL_UNIFORM_BUFFER_BINDING:
+      ION_SET(active_objects_.uniform_buffer);
+    case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+      ION_SET(kUniformBufferOffsetAlignment);
     case GL_FRAMEBUFFER_BINDING:
     // case GL_DRAW_FRAMEBUFFER_BINDING same value as GL_FRAMEBUFFER_BINDING
       ION_SET(active_objects_.draw_framebuffer);
@@ -6891,6 +7964,10 @@ void MockVisual::ShadowState::Getv(GLenum pname, T* params) {
             object_state_->framebuffers[active_objects_.draw_framebuffer];
         ION_SET(object_state_->renderbuffers[f.color0.value].green_size);
       }
+    case GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX:
+      ION_SET(kGpuMemoryAvailableKb);
+    case GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX:
+      ION_SET(kGpuMemoryTotalKb);
     case GL_IMPLEMENTATION_COLOR_READ_FORMAT:
       ION_SET(kImplementationColorReadFormat);
     case GL_IMPLEMENTATION_COLOR_READ_TYPE:
@@ -6919,12 +7996,16 @@ void MockVisual::ShadowState::Getv(GLenum pname, T* params) {
       ION_SET(kMaxSamples);
     case GL_MAX_SAMPLE_MASK_WORDS:
       ION_SET(kMaxSampleMaskWords);
+    case GL_MAX_SHADER_COMPILER_THREADS_KHR:
+      ION_SET(max_shader_compiler_threads_);
     case GL_MAX_TEXTURE_IMAGE_UNITS:
       ION_SET(kMaxTextureImageUnits);
     case GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT:
       ION_SET(kMaxTextureMaxAnisotropy);
     case GL_MAX_TEXTURE_SIZE:
       ION_SET(kMaxTextureSize);
+    case GL_MAX_UNIFORM_BUFFER_BINDINGS:
+      ION_SET(kMaxUniformBufferBindings);
     case GL_MAX_VARYING_VECTORS:
       ION_SET(kMaxVaryingVectors);
     case GL_MAX_VERTEX_ATTRIBS:
@@ -6939,6 +8020,8 @@ void MockVisual::ShadowState::Getv(GLenum pname, T* params) {
       ION_SET_INDEX(0, kMaxViewportDims);
       ION_SET_INDEX(1, kMaxViewportDims);
       break;
+    case GL_MAX_VIEWS_OVR:
+      ION_SET(kMaxViews);
     case GL_MULTISAMPLE:
       ION_SET(IsEnabled(GL_MULTISAMPLE));
     case GL_NUM_EXTENSIONS:
@@ -7048,6 +8131,14 @@ void MockVisual::ShadowState::Getv(GLenum pname, T* params) {
       ION_SET(image_units_[active_objects_.image_unit].cubemap_array);
     case GL_TEXTURE_BINDING_EXTERNAL_OES:
       ION_SET(image_units_[active_objects_.image_unit].texture_external);
+    case GL_TEXTURE_FREE_MEMORY_ATI:
+      // The free memory and largest free block in the pool, then the same for
+      // auxiliary memory.
+      ION_SET_INDEX(0, kGpuMemoryAvailableKb);
+      ION_SET_INDEX(1, kGpuMemoryAvailableKb);
+      ION_SET_INDEX(2, 0);
+      ION_SET_INDEX(3, 0);
+      break;
     case GL_TIMESTAMP_EXT:
       // For testing we use fixed timestamps to avoid clock issues.
       ION_SET(static_cast<T>(1));
@@ -7105,6 +8196,8 @@ int MockVisual::ShadowState::GetCapabilityIndex(GLenum cap) {
       return 12;
     case GL_PROGRAM_POINT_SIZE:
       return 13;
+    case GL_RASTERIZER_DISCARD:
+      return 14;
     default:
       return -1;
   }
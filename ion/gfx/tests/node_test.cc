@@ -18,12 +18,15 @@ limitations under the License.
 #include "ion/gfx/node.h"
 
 #include "ion/base/invalid.h"
+#include "ion/base/notifier.h"
+#include "ion/base/tests/testallocator.h"
 #include "ion/gfx/attribute.h"
 #include "ion/gfx/shaderinputregistry.h"
 #include "ion/gfx/shaderprogram.h"
 #include "ion/gfx/shape.h"
 #include "ion/gfx/statetable.h"
 #include "ion/gfx/uniform.h"
+#include "ion/math/range.h"
 #include "ion/math/vector.h"
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
@@ -31,6 +34,25 @@ limitations under the License.
 namespace ion {
 namespace gfx {
 
+namespace {
+
+// Counts the notifications it receives.
+class CountingReceiver : public base::Notifier {
+ public:
+  CountingReceiver() : notifications_(0U) {}
+  void OnNotify(const base::Notifier* notifier) override {
+    ++notifications_;
+  }
+  size_t GetNotificationCount() const { return notifications_; }
+
+ private:
+  ~CountingReceiver() override {}
+  size_t notifications_;
+};
+typedef base::SharedPtr<CountingReceiver> CountingReceiverPtr;
+
+}  // anonymous namespace
+
 TEST(NodeTest, SetLabel) {
   NodePtr node(new Node);
 
@@ -63,6 +85,36 @@ TEST(NodeTest, SetShaderProgram) {
   EXPECT_EQ(ptr.Get(), node->GetShaderProgram().Get());
 }
 
+TEST(NodeTest, SetDrawOrderPreserved) {
+  NodePtr node(new Node);
+
+  // Check that draw order is not preserved by default.
+  EXPECT_FALSE(node->IsDrawOrderPreserved());
+  node->SetDrawOrderPreserved(true);
+  EXPECT_TRUE(node->IsDrawOrderPreserved());
+  node->SetDrawOrderPreserved(false);
+  EXPECT_FALSE(node->IsDrawOrderPreserved());
+}
+
+TEST(NodeTest, SetRenderPass) {
+  NodePtr root(new Node);
+  NodePtr node(new Node);
+  root->AddChild(node);
+  CountingReceiverPtr receiver(new CountingReceiver);
+  root->AddReceiver(receiver.Get());
+
+  // Nodes inherit their pass by default, and changing it notifies receivers.
+  EXPECT_EQ(Node::kInheritedPass, node->GetRenderPass());
+  node->SetRenderPass(Node::kTransparentPass);
+  EXPECT_EQ(Node::kTransparentPass, node->GetRenderPass());
+  EXPECT_EQ(1U, receiver->GetNotificationCount());
+  node->SetRenderPass(Node::kTransparentPass);
+  EXPECT_EQ(1U, receiver->GetNotificationCount());
+  node->SetRenderPass(Node::kInheritedPass);
+  EXPECT_EQ(Node::kInheritedPass, node->GetRenderPass());
+  EXPECT_EQ(2U, receiver->GetNotificationCount());
+}
+
 TEST(NodeTest, AddClearUniformBlocks) {
   NodePtr node(new Node);
   UniformBlockPtr ptr1(new UniformBlock());
@@ -273,5 +325,165 @@ TEST(NodeTest, Children) {
   EXPECT_EQ(0U, node->GetChildren().size());
 }
 
+TEST(NodeTest, InlineStorage) {
+  base::testing::TestAllocatorPtr allocator(new base::testing::TestAllocator);
+  NodePtr node(new(allocator) Node);
+  NodePtr child1(new Node);
+  NodePtr child2(new Node);
+  ShapePtr shape(new Shape);
+  UniformBlockPtr block(new UniformBlock);
+
+  // The first Shape, child, and UniformBlock of a Node do not require any
+  // allocations. Create the Node's weak reference proxy up front, since
+  // children hold weak references to their parents.
+  const base::WeakReferentPtr<Node> weak_node(node);
+  const size_t num_allocated = allocator->GetNumAllocated();
+  node->AddShape(shape);
+  node->AddChild(child1);
+  node->AddUniformBlock(block);
+  EXPECT_EQ(num_allocated, allocator->GetNumAllocated());
+  EXPECT_EQ(shape.Get(), node->GetShapes()[0].Get());
+  EXPECT_EQ(child1.Get(), node->GetChildren()[0].Get());
+  EXPECT_EQ(block.Get(), node->GetUniformBlocks()[0].Get());
+
+  // More children spill into the Node's allocator.
+  node->AddChild(child2);
+  EXPECT_LT(num_allocated, allocator->GetNumAllocated());
+  EXPECT_EQ(2U, node->GetChildren().size());
+  EXPECT_EQ(child1.Get(), node->GetChildren()[0].Get());
+  EXPECT_EQ(child2.Get(), node->GetChildren()[1].Get());
+  node->RemoveChildAt(0U);
+  EXPECT_EQ(child2.Get(), node->GetChildren()[0].Get());
+  node->ClearChildren();
+  node->AddChild(child1);
+  EXPECT_EQ(child1.Get(), node->GetChildren()[0].Get());
+}
+
+TEST(NodeTest, Notifications) {
+  NodePtr root(new Node);
+  NodePtr child(new Node);
+  NodePtr grandchild(new Node);
+  CountingReceiverPtr receiver(new CountingReceiver);
+  root->AddReceiver(receiver.Get());
+
+  // Structural changes anywhere in the subgraph are forwarded.
+  root->AddChild(child);
+  EXPECT_EQ(1U, receiver->GetNotificationCount());
+  child->AddChild(grandchild);
+  EXPECT_EQ(2U, receiver->GetNotificationCount());
+  grandchild->AddShape(ShapePtr(new Shape));
+  EXPECT_EQ(3U, receiver->GetNotificationCount());
+  grandchild->SetStateTable(StateTablePtr(new StateTable));
+  EXPECT_EQ(4U, receiver->GetNotificationCount());
+  grandchild->Enable(false);
+  EXPECT_EQ(5U, receiver->GetNotificationCount());
+  // Enabling an enabled Node does nothing.
+  child->Enable(true);
+  EXPECT_EQ(5U, receiver->GetNotificationCount());
+  // Nodes also notify when enabled through their UniformHolder base.
+  UniformHolder* holder = grandchild.Get();
+  holder->Enable(true);
+  EXPECT_EQ(6U, receiver->GetNotificationCount());
+  holder->Enable(true);
+  EXPECT_EQ(6U, receiver->GetNotificationCount());
+
+  // Uniform values are not structural.
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->Add(ShaderInputRegistry::UniformSpec("uFloat", kFloatUniform, "."));
+  const size_t index = child->AddUniform(reg->Create<Uniform>("uFloat", 1.f));
+  EXPECT_EQ(6U, receiver->GetNotificationCount());
+  child->SetUniformValue(index, 2.f);
+  EXPECT_EQ(6U, receiver->GetNotificationCount());
+
+  // Removed children no longer notify.
+  root->RemoveChild(child);
+  EXPECT_EQ(7U, receiver->GetNotificationCount());
+  grandchild->ClearShapes();
+  EXPECT_EQ(7U, receiver->GetNotificationCount());
+
+  // A child added twice still notifies after one instance is removed.
+  root->AddChild(child);
+  root->AddChild(child);
+  root->RemoveChildAt(0U);
+  EXPECT_EQ(10U, receiver->GetNotificationCount());
+  grandchild->ClearShapes();
+  EXPECT_EQ(11U, receiver->GetNotificationCount());
+  root->ClearChildren();
+  EXPECT_EQ(12U, receiver->GetNotificationCount());
+  grandchild->ClearShapes();
+  EXPECT_EQ(12U, receiver->GetNotificationCount());
+}
+
+TEST(NodeTest, Bounds) {
+  NodePtr root(new Node);
+  NodePtr child(new Node);
+  NodePtr grandchild(new Node);
+  root->AddChild(child);
+  child->AddChild(grandchild);
+  CountingReceiverPtr receiver(new CountingReceiver);
+  root->AddReceiver(receiver.Get());
+
+  // A subgraph without Shapes is bounded but empty.
+  math::Range3f bounds;
+  EXPECT_FALSE(root->HasBounds());
+  EXPECT_TRUE(root->GetSubgraphBounds(&bounds));
+  EXPECT_TRUE(bounds.IsEmpty());
+
+  // A Node with Shapes but no bounds makes its ancestors unbounded.
+  grandchild->AddShape(ShapePtr(new Shape));
+  EXPECT_FALSE(root->GetSubgraphBounds(&bounds));
+  EXPECT_FALSE(child->GetSubgraphBounds(&bounds));
+  const math::Range3f grandchild_bounds(math::Point3f(0.f, 0.f, 0.f),
+                                        math::Point3f(1.f, 1.f, 1.f));
+  grandchild->SetBounds(grandchild_bounds);
+  EXPECT_EQ(2U, receiver->GetNotificationCount());
+  EXPECT_TRUE(grandchild->HasBounds());
+  EXPECT_EQ(grandchild_bounds, grandchild->GetBounds());
+  EXPECT_TRUE(root->GetSubgraphBounds(&bounds));
+  EXPECT_EQ(grandchild_bounds, bounds);
+
+  // Bounds are the union of the subgraph's, and are recomputed when any Node
+  // in the subgraph changes.
+  const math::Range3f child_bounds(math::Point3f(-2.f, 0.f, 0.f),
+                                   math::Point3f(0.f, 3.f, 0.5f));
+  child->SetBounds(child_bounds);
+  EXPECT_TRUE(root->GetSubgraphBounds(&bounds));
+  EXPECT_EQ(math::Range3f(math::Point3f(-2.f, 0.f, 0.f),
+                          math::Point3f(1.f, 3.f, 1.f)), bounds);
+  grandchild->Enable(false);
+  EXPECT_TRUE(root->GetSubgraphBounds(&bounds));
+  EXPECT_EQ(child_bounds, bounds);
+  grandchild->Enable(true);
+  grandchild->ClearBounds();
+  EXPECT_FALSE(grandchild->HasBounds());
+  // The passed bounds are not modified if the subgraph is unbounded.
+  EXPECT_FALSE(root->GetSubgraphBounds(&bounds));
+  EXPECT_EQ(child_bounds, bounds);
+  // Clearing bounds that are not set does nothing.
+  const size_t count = receiver->GetNotificationCount();
+  grandchild->ClearBounds();
+  EXPECT_EQ(count, receiver->GetNotificationCount());
+}
+
+TEST(NodeTest, LodRange) {
+  NodePtr node(new Node);
+  CountingReceiverPtr receiver(new CountingReceiver);
+  node->AddReceiver(receiver.Get());
+
+  EXPECT_FALSE(node->HasLodRange());
+  const math::Range1f range(0.25f, 0.5f);
+  node->SetLodRange(range);
+  EXPECT_EQ(1U, receiver->GetNotificationCount());
+  EXPECT_TRUE(node->HasLodRange());
+  EXPECT_EQ(range, node->GetLodRange());
+
+  node->ClearLodRange();
+  EXPECT_EQ(2U, receiver->GetNotificationCount());
+  EXPECT_FALSE(node->HasLodRange());
+  // Clearing a range that is not set does nothing.
+  node->ClearLodRange();
+  EXPECT_EQ(2U, receiver->GetNotificationCount());
+}
+
 }  // namespace gfx
 }  // namespace ion
@@ -0,0 +1,963 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/tests/nullgraphicsmanager.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/base/staticsafedeclare.h"
+#include "ion/base/stringutils.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace gfx {
+namespace testing {
+
+namespace {
+
+// A uniform or attribute declared in a shader.
+struct ShaderInput {
+  std::string name;
+  GLenum type;
+  GLint size;
+  GLint location;
+};
+
+struct ShaderObject {
+  GLenum type;
+  std::string source;
+};
+
+struct ProgramObject {
+  std::vector<GLuint> shaders;
+  std::vector<ShaderInput> uniforms;
+  std::vector<ShaderInput> attributes;
+};
+
+// The number of calls of each function. Since the wrapped functions are
+// declared as statements, each count is a named member rather than an array
+// element.
+struct CallCounts {
+#define ION_WRAP_GL_FUNC(group, name, return_type, typed_args, args, trace) \
+  std::atomic<int64> name
+#include "ion/gfx/glfunctions.inc"
+};
+
+// The name of each wrapped function and its member of CallCounts. The entries
+// are named members of CountEntries for the same reason, and are read as an
+// array of CountEntry.
+struct CountEntry {
+  const char* name;
+  std::atomic<int64> CallCounts::*count;
+};
+struct CountEntries {
+#define ION_WRAP_GL_FUNC(group, name, return_type, typed_args, args, trace) \
+  CountEntry name = {#name, &CallCounts::name}
+#include "ion/gfx/glfunctions.inc"
+};
+
+// The state shared by all NullGraphicsManagers.
+struct NullState {
+  NullState() : next_id(1U) {
+    const CountEntries entries;
+    const CountEntry* entry = reinterpret_cast<const CountEntry*>(&entries);
+    for (size_t i = 0; i < sizeof(entries) / sizeof(*entry); ++i) {
+      std::atomic<int64>* count = &(counts.*entry[i].count);
+      *count = 0;
+      counts_by_name[entry[i].name] = count;
+    }
+  }
+
+  CallCounts counts;
+  std::map<std::string, std::atomic<int64>*> counts_by_name;
+  std::atomic<GLuint> next_id;
+
+  // Protects the shader and program objects.
+  port::Mutex mutex;
+  std::map<GLuint, ShaderObject> shaders;
+  std::map<GLuint, ProgramObject> programs;
+};
+
+static NullState* GetState() {
+  ION_DECLARE_SAFE_STATIC_POINTER(NullState, s_state);
+  return s_state;
+}
+
+static void CountCall(std::atomic<int64>* count) {
+  count->fetch_add(1, std::memory_order_relaxed);
+}
+
+// Returns the value an OpenGL function returns when it otherwise does nothing:
+// 0, NULL, GL_FALSE, or GL_NO_ERROR.
+template <typename T> static T DefaultValue() { return T(); }
+
+//-----------------------------------------------------------------------------
+//
+// State queries.
+//
+//-----------------------------------------------------------------------------
+
+// Stores the value of pname in values, and returns the number of values, which
+// is at most 4. Implementation limits have reasonable values, and all other
+// state has its default value.
+static size_t GetStateValues(GLenum pname, double* values) {
+  values[0] = values[1] = values[2] = values[3] = 0.0;
+  switch (pname) {
+    case GL_ALIASED_LINE_WIDTH_RANGE:
+      values[0] = 1.0;
+      values[1] = 8.0;
+      return 2U;
+    case GL_ALIASED_POINT_SIZE_RANGE:
+    case GL_POINT_SIZE_RANGE:
+      values[0] = 1.0;
+      values[1] = 1024.0;
+      return 2U;
+    case GL_COMPRESSED_TEXTURE_FORMATS:
+    case GL_SHADER_BINARY_FORMATS:
+      return 0U;
+    case GL_IMPLEMENTATION_COLOR_READ_FORMAT:
+      values[0] = GL_RGBA;
+      return 1U;
+    case GL_IMPLEMENTATION_COLOR_READ_TYPE:
+      values[0] = GL_UNSIGNED_BYTE;
+      return 1U;
+    case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS:
+    case GL_MAX_UNIFORM_BUFFER_BINDINGS:
+      values[0] = 32.0;
+      return 1U;
+    case GL_MAX_CUBE_MAP_TEXTURE_SIZE:
+    case GL_MAX_RENDERBUFFER_SIZE:
+    case GL_MAX_TEXTURE_SIZE:
+    case GL_MAX_FRAGMENT_UNIFORM_COMPONENTS:
+    case GL_MAX_VERTEX_UNIFORM_COMPONENTS:
+      values[0] = 4096.0;
+      return 1U;
+    case GL_MAX_FRAGMENT_UNIFORM_VECTORS:
+    case GL_MAX_VERTEX_UNIFORM_VECTORS:
+      values[0] = 1024.0;
+      return 1U;
+    case GL_MAX_SAMPLE_MASK_WORDS:
+      values[0] = 1.0;
+      return 1U;
+    case GL_MAX_TEXTURE_IMAGE_UNITS:
+    case GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT:
+    case GL_MAX_VARYING_VECTORS:
+    case GL_MAX_VERTEX_ATTRIBS:
+    case GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS:
+      values[0] = 16.0;
+      return 1U;
+    case GL_MAX_TRANSFORM_FEEDBACK_BUFFERS:
+    case GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS:
+    case GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS:
+      values[0] = 4.0;
+      return 1U;
+    case GL_MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS:
+      values[0] = 64.0;
+      return 1U;
+    case GL_MAX_VIEWPORT_DIMS:
+      values[0] = values[1] = 4096.0;
+      return 2U;
+
+    case GL_ACTIVE_TEXTURE:
+      values[0] = GL_TEXTURE0;
+      return 1U;
+    case GL_BLEND_COLOR:
+    case GL_COLOR_CLEAR_VALUE:
+    case GL_SCISSOR_BOX:
+    case GL_VIEWPORT:
+      return 4U;
+    case GL_BLEND_DST_ALPHA:
+    case GL_BLEND_DST_RGB:
+      values[0] = GL_ZERO;
+      return 1U;
+    case GL_BLEND_EQUATION_ALPHA:
+    case GL_BLEND_EQUATION_RGB:
+      values[0] = GL_FUNC_ADD;
+      return 1U;
+    case GL_BLEND_SRC_ALPHA:
+    case GL_BLEND_SRC_RGB:
+      values[0] = GL_ONE;
+      return 1U;
+    case GL_COLOR_WRITEMASK:
+      values[0] = values[1] = values[2] = values[3] = 1.0;
+      return 4U;
+    case GL_CULL_FACE_MODE:
+    case GL_DRAW_BUFFER:
+      values[0] = GL_BACK;
+      return 1U;
+    case GL_DEPTH_CLEAR_VALUE:
+    case GL_DEPTH_WRITEMASK:
+    case GL_LINE_WIDTH:
+    case GL_SAMPLE_COVERAGE_VALUE:
+      values[0] = 1.0;
+      return 1U;
+    case GL_DEPTH_FUNC:
+      values[0] = GL_LESS;
+      return 1U;
+    case GL_DEPTH_RANGE:
+      values[1] = 1.0;
+      return 2U;
+    case GL_FRONT_FACE:
+      values[0] = GL_CCW;
+      return 1U;
+    case GL_GENERATE_MIPMAP_HINT:
+      values[0] = GL_DONT_CARE;
+      return 1U;
+    case GL_PACK_ALIGNMENT:
+    case GL_UNPACK_ALIGNMENT:
+      values[0] = 4.0;
+      return 1U;
+    case GL_STENCIL_BACK_FAIL:
+    case GL_STENCIL_BACK_PASS_DEPTH_FAIL:
+    case GL_STENCIL_BACK_PASS_DEPTH_PASS:
+    case GL_STENCIL_FAIL:
+    case GL_STENCIL_PASS_DEPTH_FAIL:
+    case GL_STENCIL_PASS_DEPTH_PASS:
+      values[0] = GL_KEEP;
+      return 1U;
+    case GL_STENCIL_BACK_FUNC:
+    case GL_STENCIL_FUNC:
+      values[0] = GL_ALWAYS;
+      return 1U;
+    case GL_STENCIL_BACK_VALUE_MASK:
+    case GL_STENCIL_BACK_WRITEMASK:
+    case GL_STENCIL_VALUE_MASK:
+    case GL_STENCIL_WRITEMASK:
+      // All bits are set, which is -1 as a GLint.
+      values[0] = -1.0;
+      return 1U;
+    default:
+      return 1U;
+  }
+}
+
+template <typename T>
+static void QueryState(GLenum pname, T* params) {
+  double values[4];
+  const size_t count = GetStateValues(pname, values);
+  for (size_t i = 0; i < count; ++i)
+    params[i] = static_cast<T>(values[i]);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Shader scanning.
+//
+//-----------------------------------------------------------------------------
+
+// Returns the OpenGL type of the named GLSL type, or GL_NONE if it is not a
+// type that a uniform or attribute can have.
+static GLenum GetTypeFromName(const std::string& name) {
+  static const struct {
+    const char* name;
+    GLenum type;
+  } kTypes[] = {
+    { "float", GL_FLOAT },
+    { "vec2", GL_FLOAT_VEC2 },
+    { "vec3", GL_FLOAT_VEC3 },
+    { "vec4", GL_FLOAT_VEC4 },
+    { "int", GL_INT },
+    { "ivec2", GL_INT_VEC2 },
+    { "ivec3", GL_INT_VEC3 },
+    { "ivec4", GL_INT_VEC4 },
+    { "uint", GL_UNSIGNED_INT },
+    { "uvec2", GL_UNSIGNED_INT_VEC2 },
+    { "uvec3", GL_UNSIGNED_INT_VEC3 },
+    { "uvec4", GL_UNSIGNED_INT_VEC4 },
+    { "mat2", GL_FLOAT_MAT2 },
+    { "mat3", GL_FLOAT_MAT3 },
+    { "mat4", GL_FLOAT_MAT4 },
+    { "sampler1D", GL_SAMPLER_1D },
+    { "sampler1DArray", GL_SAMPLER_1D_ARRAY },
+    { "sampler1DArrayShadow", GL_SAMPLER_1D_ARRAY_SHADOW },
+    { "sampler1DShadow", GL_SAMPLER_1D_SHADOW },
+    { "sampler2D", GL_SAMPLER_2D },
+    { "sampler2DArray", GL_SAMPLER_2D_ARRAY },
+    { "sampler2DArrayShadow", GL_SAMPLER_2D_ARRAY_SHADOW },
+    { "sampler2DMS", GL_SAMPLER_2D_MULTISAMPLE },
+    { "sampler2DMSArray", GL_SAMPLER_2D_MULTISAMPLE_ARRAY },
+    { "sampler2DShadow", GL_SAMPLER_2D_SHADOW },
+    { "sampler3D", GL_SAMPLER_3D },
+    { "samplerCube", GL_SAMPLER_CUBE },
+    { "samplerCubeArray", GL_SAMPLER_CUBE_MAP_ARRAY },
+    { "samplerCubeArrayShadow", GL_SAMPLER_CUBE_MAP_ARRAY_SHADOW },
+    { "samplerCubeShadow", GL_SAMPLER_CUBE_SHADOW },
+    { "samplerExternalOES", GL_SAMPLER_EXTERNAL_OES },
+    { "isampler1D", GL_INT_SAMPLER_1D },
+    { "isampler1DArray", GL_INT_SAMPLER_1D_ARRAY },
+    { "isampler2D", GL_INT_SAMPLER_2D },
+    { "isampler2DArray", GL_INT_SAMPLER_2D_ARRAY },
+    { "isampler3D", GL_INT_SAMPLER_3D },
+    { "isamplerCube", GL_INT_SAMPLER_CUBE },
+    { "isamplerCubeArray", GL_INT_SAMPLER_CUBE_MAP_ARRAY },
+    { "usampler1D", GL_UNSIGNED_INT_SAMPLER_1D },
+    { "usampler1DArray", GL_UNSIGNED_INT_SAMPLER_1D_ARRAY },
+    { "usampler2D", GL_UNSIGNED_INT_SAMPLER_2D },
+    { "usampler2DArray", GL_UNSIGNED_INT_SAMPLER_2D_ARRAY },
+    { "usampler3D", GL_UNSIGNED_INT_SAMPLER_3D },
+    { "usamplerCube", GL_UNSIGNED_INT_SAMPLER_CUBE },
+    { "usamplerCubeArray", GL_UNSIGNED_INT_SAMPLER_CUBE_MAP_ARRAY },
+  };
+  for (size_t i = 0; i < arraysize(kTypes); ++i) {
+    if (name == kTypes[i].name)
+      return kTypes[i].type;
+  }
+  return GL_NONE;
+}
+
+// Returns the number of attribute slots used by an attribute of type.
+static GLint GetSlotCount(GLenum type) {
+  return type == GL_FLOAT_MAT2 ? 2 :
+      type == GL_FLOAT_MAT3 ? 3 :
+      type == GL_FLOAT_MAT4 ? 4 : 1;
+}
+
+// Adds the input to inputs unless one with the same name exists.
+static void AddInput(const ShaderInput& input,
+                     std::vector<ShaderInput>* inputs) {
+  for (size_t i = 0; i < inputs->size(); ++i) {
+    if ((*inputs)[i].name == input.name)
+      return;
+  }
+  inputs->push_back(input);
+}
+
+// Adds the inputs declared in a single global statement, which has the form
+// [layout(...)] <uniform | attribute | in> [qualifiers] <type> <names>, where
+// names is a comma-separated list of names with optional array sizes.
+static void ScanStatement(GLenum shader_type, std::string statement,
+                          ProgramObject* po) {
+  // Remove a layout qualifier, if any.
+  const size_t layout = statement.find("layout");
+  if (layout != std::string::npos) {
+    const size_t end = statement.find(')', layout);
+    if (end == std::string::npos)
+      return;
+    statement.erase(layout, end + 1U - layout);
+  }
+  const std::vector<std::string> words =
+      base::SplitString(statement, " \t\r\n");
+  size_t index = 0;
+  while (index < words.size() &&
+         (words[index] == "flat" || words[index] == "smooth" ||
+          words[index] == "centroid" || words[index] == "invariant"))
+    ++index;
+  if (index >= words.size())
+    return;
+  std::vector<ShaderInput>* inputs = NULL;
+  if (words[index] == "uniform")
+    inputs = &po->uniforms;
+  else if (shader_type == GL_VERTEX_SHADER &&
+           (words[index] == "attribute" || words[index] == "in"))
+    inputs = &po->attributes;
+  else
+    return;
+  ++index;
+  if (index < words.size() &&
+      (words[index] == "lowp" || words[index] == "mediump" ||
+       words[index] == "highp"))
+    ++index;
+  if (index + 1U >= words.size())
+    return;
+  ShaderInput input;
+  input.type = GetTypeFromName(words[index]);
+  input.location = -1;
+  if (input.type == GL_NONE)
+    return;
+
+  // Join the rest of the words so that array sizes may be separated from the
+  // names by spaces.
+  std::string names;
+  for (size_t i = index + 1U; i < words.size(); ++i)
+    names += words[i];
+  const std::vector<std::string> decls = base::SplitString(names, ",");
+  for (size_t i = 0; i < decls.size(); ++i) {
+    const size_t bracket = decls[i].find('[');
+    input.name = decls[i].substr(0, bracket);
+    input.size = 1;
+    if (bracket != std::string::npos)
+      input.size = std::max(1, base::StringToInt32(decls[i].substr(
+                                   bracket + 1U,
+                                   decls[i].find(']') - bracket - 1U)));
+    if (!input.name.empty())
+      AddInput(input, inputs);
+  }
+}
+
+// Adds the uniforms and attributes declared at global scope in source to po.
+// This is not a GLSL parser: preprocessor directives are ignored, and members
+// of uniform blocks are not reported, just like in MockGraphicsManager.
+static void ScanShader(GLenum shader_type, const std::string& source,
+                       ProgramObject* po) {
+  std::string statement;
+  int depth = 0;
+  for (size_t i = 0; i < source.size(); ++i) {
+    const char c = source[i];
+    if (c == '/' && i + 1U < source.size() && source[i + 1U] == '/') {
+      // Skip to the end of a line comment.
+      i = source.find('\n', i);
+      if (i == std::string::npos)
+        break;
+    } else if (c == '/' && i + 1U < source.size() && source[i + 1U] == '*') {
+      i = source.find("*/", i + 2U);
+      if (i == std::string::npos)
+        break;
+      ++i;
+    } else if (c == '#' && statement.find_first_not_of(" \t\r\n") ==
+               std::string::npos) {
+      // Skip a preprocessor directive.
+      i = source.find('\n', i);
+      if (i == std::string::npos)
+        break;
+    } else if (c == '{') {
+      ++depth;
+      statement.clear();
+    } else if (c == '}') {
+      --depth;
+      statement.clear();
+    } else if (c == ';') {
+      if (depth == 0)
+        ScanStatement(shader_type, statement, po);
+      statement.clear();
+    } else {
+      statement += c;
+    }
+  }
+}
+
+// Copies str into buffer, which has room for buf_size characters, and returns
+// its length in length.
+static void CopyString(const std::string& str, GLsizei buf_size,
+                       GLsizei* length, GLchar* buffer) {
+  GLsizei count = 0;
+  if (buffer && buf_size > 0) {
+    count = std::min(static_cast<GLsizei>(str.size()), buf_size - 1);
+    memcpy(buffer, str.c_str(), count);
+    buffer[count] = 0;
+  }
+  if (length)
+    *length = count;
+}
+
+// Returns the location of the uniform or attribute named name in inputs,
+// which may refer to an element of an array, or -1 if there is none.
+static GLint GetLocation(const std::vector<ShaderInput>& inputs,
+                         const std::string& name) {
+  const size_t bracket = name.find('[');
+  const std::string base_name = name.substr(0, bracket);
+  const GLint element =
+      bracket == std::string::npos ?
+      0 : base::StringToInt32(name.substr(bracket + 1U));
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (inputs[i].name == base_name)
+      return element >= 0 && element < inputs[i].size ?
+          inputs[i].location + element : -1;
+  }
+  return -1;
+}
+
+// Reports the input at index of inputs, if inputs is non-NULL and index is
+// valid.
+static void GetActiveInput(const std::vector<ShaderInput>* inputs,
+                           GLuint index, GLsizei buf_size, GLsizei* length,
+                           GLint* size, GLenum* type, GLchar* name,
+                           bool is_uniform) {
+  if (!inputs || index >= inputs->size()) {
+    CopyString(std::string(), buf_size, length, name);
+    return;
+  }
+  const ShaderInput& input = (*inputs)[index];
+  // Like OpenGL, report uniform arrays by the name of their first element.
+  CopyString(is_uniform && input.size > 1 ? input.name + "[0]" : input.name,
+             buf_size, length, name);
+  if (size)
+    *size = input.size;
+  if (type)
+    *type = input.type;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Functions that do more than count their calls.
+//
+//-----------------------------------------------------------------------------
+
+static void GenIds(GLsizei n, GLuint* ids) {
+  NullState* state = GetState();
+  for (GLsizei i = 0; i < n; ++i)
+    ids[i] = state->next_id++;
+}
+
+#define ION_NULL_GEN_FUNC(name)                                    \
+  static void ION_APIENTRY Custom##name(GLsizei n, GLuint* ids) { \
+    CountCall(&GetState()->counts.name);                           \
+    GenIds(n, ids);                                                \
+  }
+ION_NULL_GEN_FUNC(GenBuffers)
+ION_NULL_GEN_FUNC(GenFramebuffers)
+ION_NULL_GEN_FUNC(GenQueries)
+ION_NULL_GEN_FUNC(GenRenderbuffers)
+ION_NULL_GEN_FUNC(GenSamplers)
+ION_NULL_GEN_FUNC(GenTextures)
+ION_NULL_GEN_FUNC(GenTransformFeedbacks)
+ION_NULL_GEN_FUNC(GenVertexArrays)
+#undef ION_NULL_GEN_FUNC
+
+static GLuint ION_APIENTRY CustomCreateShader(GLenum type) {
+  NullState* state = GetState();
+  CountCall(&state->counts.CreateShader);
+  const GLuint id = state->next_id++;
+  base::LockGuard lock(&state->mutex);
+  state->shaders[id].type = type;
+  return id;
+}
+
+static GLuint ION_APIENTRY CustomCreateProgram() {
+  NullState* state = GetState();
+  CountCall(&state->counts.CreateProgram);
+  const GLuint id = state->next_id++;
+  base::LockGuard lock(&state->mutex);
+  state->programs[id];
+  return id;
+}
+
+static void ION_APIENTRY CustomDeleteShader(GLuint shader) {
+  NullState* state = GetState();
+  CountCall(&state->counts.DeleteShader);
+  base::LockGuard lock(&state->mutex);
+  state->shaders.erase(shader);
+}
+
+static void ION_APIENTRY CustomDeleteProgram(GLuint program) {
+  NullState* state = GetState();
+  CountCall(&state->counts.DeleteProgram);
+  base::LockGuard lock(&state->mutex);
+  state->programs.erase(program);
+}
+
+static void ION_APIENTRY CustomShaderSource(GLuint shader, GLsizei count,
+                                            const GLchar** string,
+                                            const GLint* length) {
+  NullState* state = GetState();
+  CountCall(&state->counts.ShaderSource);
+  std::string source;
+  for (GLsizei i = 0; i < count; ++i) {
+    if (length && length[i] >= 0)
+      source.append(string[i], length[i]);
+    else
+      source.append(string[i]);
+  }
+  base::LockGuard lock(&state->mutex);
+  auto it = state->shaders.find(shader);
+  if (it != state->shaders.end())
+    it->second.source = source;
+}
+
+static void ION_APIENTRY CustomGetShaderSource(GLuint shader, GLsizei buf_size,
+                                               GLsizei* length,
+                                               GLchar* source) {
+  NullState* state = GetState();
+  CountCall(&state->counts.GetShaderSource);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->shaders.find(shader);
+  CopyString(it == state->shaders.end() ? std::string() : it->second.source,
+             buf_size, length, source);
+}
+
+static void ION_APIENTRY CustomAttachShader(GLuint program, GLuint shader) {
+  NullState* state = GetState();
+  CountCall(&state->counts.AttachShader);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  if (it != state->programs.end())
+    it->second.shaders.push_back(shader);
+}
+
+static void ION_APIENTRY CustomDetachShader(GLuint program, GLuint shader) {
+  NullState* state = GetState();
+  CountCall(&state->counts.DetachShader);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  if (it != state->programs.end()) {
+    std::vector<GLuint>& shaders = it->second.shaders;
+    shaders.erase(std::remove(shaders.begin(), shaders.end(), shader),
+                  shaders.end());
+  }
+}
+
+static void ION_APIENTRY CustomLinkProgram(GLuint program) {
+  NullState* state = GetState();
+  CountCall(&state->counts.LinkProgram);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  if (it == state->programs.end())
+    return;
+  ProgramObject* po = &it->second;
+  po->uniforms.clear();
+  po->attributes.clear();
+  for (size_t i = 0; i < po->shaders.size(); ++i) {
+    auto shader = state->shaders.find(po->shaders[i]);
+    if (shader != state->shaders.end())
+      ScanShader(shader->second.type, shader->second.source, po);
+  }
+  GLint location = 0;
+  for (size_t i = 0; i < po->uniforms.size(); ++i) {
+    po->uniforms[i].location = location;
+    location += po->uniforms[i].size;
+  }
+  location = 0;
+  for (size_t i = 0; i < po->attributes.size(); ++i) {
+    po->attributes[i].location = location;
+    location += po->attributes[i].size * GetSlotCount(po->attributes[i].type);
+  }
+}
+
+static void ION_APIENTRY CustomGetShaderiv(GLuint shader, GLenum pname,
+                                           GLint* params) {
+  NullState* state = GetState();
+  CountCall(&state->counts.GetShaderiv);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->shaders.find(shader);
+  switch (pname) {
+    case GL_COMPILE_STATUS:
+    case GL_COMPLETION_STATUS_KHR:
+      *params = it == state->shaders.end() ? GL_FALSE : GL_TRUE;
+      break;
+    case GL_SHADER_TYPE:
+      *params = it == state->shaders.end() ? 0 :
+          static_cast<GLint>(it->second.type);
+      break;
+    case GL_SHADER_SOURCE_LENGTH:
+      *params = it == state->shaders.end() ? 0 :
+          static_cast<GLint>(it->second.source.size() + 1U);
+      break;
+    default:
+      *params = 0;
+      break;
+  }
+}
+
+static void ION_APIENTRY CustomGetProgramiv(GLuint program, GLenum pname,
+                                            GLint* params) {
+  NullState* state = GetState();
+  CountCall(&state->counts.GetProgramiv);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  if (it == state->programs.end()) {
+    *params = 0;
+    return;
+  }
+  const ProgramObject& po = it->second;
+  switch (pname) {
+    case GL_COMPLETION_STATUS_KHR:
+    case GL_LINK_STATUS:
+    case GL_VALIDATE_STATUS:
+      *params = GL_TRUE;
+      break;
+    case GL_ACTIVE_ATTRIBUTES:
+      *params = static_cast<GLint>(po.attributes.size());
+      break;
+    case GL_ACTIVE_UNIFORMS:
+      *params = static_cast<GLint>(po.uniforms.size());
+      break;
+    case GL_ACTIVE_ATTRIBUTE_MAX_LENGTH:
+    case GL_ACTIVE_UNIFORM_MAX_LENGTH: {
+      const std::vector<ShaderInput>& inputs =
+          pname == GL_ACTIVE_UNIFORM_MAX_LENGTH ? po.uniforms : po.attributes;
+      size_t max_length = 0U;
+      for (size_t i = 0; i < inputs.size(); ++i)
+        // Leave room for "[0]" and the terminating NUL.
+        max_length = std::max(max_length, inputs[i].name.size() + 4U);
+      *params = static_cast<GLint>(max_length);
+      break;
+    }
+    case GL_ATTACHED_SHADERS:
+      *params = static_cast<GLint>(po.shaders.size());
+      break;
+    default:
+      *params = 0;
+      break;
+  }
+}
+
+static void ION_APIENTRY CustomGetActiveAttrib(GLuint program, GLuint index,
+                                               GLsizei buf_size,
+                                               GLsizei* length, GLint* size,
+                                               GLenum* type, GLchar* name) {
+  NullState* state = GetState();
+  CountCall(&state->counts.GetActiveAttrib);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  GetActiveInput(it == state->programs.end() ? NULL : &it->second.attributes,
+                 index, buf_size, length, size, type, name, false);
+}
+
+static void ION_APIENTRY CustomGetActiveUniform(GLuint program, GLuint index,
+                                                GLsizei buf_size,
+                                                GLsizei* length, GLint* size,
+                                                GLenum* type, GLchar* name) {
+  NullState* state = GetState();
+  CountCall(&state->counts.GetActiveUniform);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  GetActiveInput(it == state->programs.end() ? NULL : &it->second.uniforms,
+                 index, buf_size, length, size, type, name, true);
+}
+
+static GLint ION_APIENTRY CustomGetAttribLocation(GLuint program,
+                                                  const GLchar* name) {
+  NullState* state = GetState();
+  CountCall(&state->counts.GetAttribLocation);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  return it == state->programs.end() ?
+      -1 : GetLocation(it->second.attributes, name);
+}
+
+static GLint ION_APIENTRY CustomGetUniformLocation(GLuint program,
+                                                   const GLchar* name) {
+  NullState* state = GetState();
+  CountCall(&state->counts.GetUniformLocation);
+  base::LockGuard lock(&state->mutex);
+  auto it = state->programs.find(program);
+  return it == state->programs.end() ?
+      -1 : GetLocation(it->second.uniforms, name);
+}
+
+static GLuint ION_APIENTRY CustomGetUniformBlockIndex(GLuint program,
+                                                      const GLchar* name) {
+  CountCall(&GetState()->counts.GetUniformBlockIndex);
+  return GL_INVALID_INDEX;
+}
+
+static void ION_APIENTRY CustomGetProgramInfoLog(GLuint program,
+                                                 GLsizei buf_size,
+                                                 GLsizei* length,
+                                                 GLchar* info_log) {
+  CountCall(&GetState()->counts.GetProgramInfoLog);
+  CopyString(std::string(), buf_size, length, info_log);
+}
+
+static void ION_APIENTRY CustomGetShaderInfoLog(GLuint shader,
+                                                GLsizei buf_size,
+                                                GLsizei* length,
+                                                GLchar* info_log) {
+  CountCall(&GetState()->counts.GetShaderInfoLog);
+  CopyString(std::string(), buf_size, length, info_log);
+}
+
+static const GLubyte* ION_APIENTRY CustomGetString(GLenum name) {
+  CountCall(&GetState()->counts.GetString);
+  const char* str = "";
+  switch (name) {
+    case GL_RENDERER:
+      str = "Ion null renderer";
+      break;
+    case GL_SHADING_LANGUAGE_VERSION:
+      str = "OpenGL ES GLSL ES 3.00";
+      break;
+    case GL_VENDOR:
+      str = "Google";
+      break;
+    case GL_VERSION:
+      str = "OpenGL ES 3.0 Ion null";
+      break;
+    default:
+      break;
+  }
+  return reinterpret_cast<const GLubyte*>(str);
+}
+
+static const GLubyte* ION_APIENTRY CustomGetStringi(GLenum name,
+                                                    GLuint index) {
+  CountCall(&GetState()->counts.GetStringi);
+  return reinterpret_cast<const GLubyte*>("");
+}
+
+static void ION_APIENTRY CustomGetBooleanv(GLenum pname, GLboolean* params) {
+  CountCall(&GetState()->counts.GetBooleanv);
+  QueryState(pname, params);
+}
+
+static void ION_APIENTRY CustomGetFloatv(GLenum pname, GLfloat* params) {
+  CountCall(&GetState()->counts.GetFloatv);
+  QueryState(pname, params);
+}
+
+static void ION_APIENTRY CustomGetIntegerv(GLenum pname, GLint* params) {
+  CountCall(&GetState()->counts.GetIntegerv);
+  QueryState(pname, params);
+}
+
+static void ION_APIENTRY CustomGetInteger64v(GLenum pname, GLint64* params) {
+  CountCall(&GetState()->counts.GetInteger64v);
+  QueryState(pname, params);
+}
+
+static void ION_APIENTRY CustomGetShaderPrecisionFormat(GLenum shader_type,
+                                                        GLenum precision_type,
+                                                        GLint* range,
+                                                        GLint* precision) {
+  CountCall(&GetState()->counts.GetShaderPrecisionFormat);
+  // Report IEEE single precision for all types.
+  range[0] = range[1] = 127;
+  *precision = 23;
+}
+
+static GLenum ION_APIENTRY CustomCheckFramebufferStatus(GLenum target) {
+  CountCall(&GetState()->counts.CheckFramebufferStatus);
+  return GL_FRAMEBUFFER_COMPLETE;
+}
+
+static GLsync ION_APIENTRY CustomFenceSync(GLenum condition,
+                                           GLbitfield flags) {
+  NullState* state = GetState();
+  CountCall(&state->counts.FenceSync);
+  return reinterpret_cast<GLsync>(
+      static_cast<uintptr_t>(state->next_id++));
+}
+
+static GLenum ION_APIENTRY CustomClientWaitSync(GLsync sync, GLbitfield flags,
+                                                GLuint64 timeout) {
+  CountCall(&GetState()->counts.ClientWaitSync);
+  return GL_ALREADY_SIGNALED;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Functions that only count their calls.
+//
+//-----------------------------------------------------------------------------
+
+#define ION_WRAP_GL_FUNC(group, name, return_type, typed_args, args, trace) \
+  static return_type ION_APIENTRY Null##name typed_args {                 \
+    CountCall(&GetState()->counts.name);                                 \
+    return DefaultValue<return_type>();                                  \
+  }
+#include "ion/gfx/glfunctions.inc"
+
+// The name and address of each function above, read as an array of
+// FunctionEntry like CountEntries.
+struct FunctionEntry {
+  const char* name;
+  void* function;
+};
+struct NullFunctions {
+#define ION_WRAP_GL_FUNC(group, name, return_type, typed_args, args, trace) \
+  FunctionEntry name = {"gl" #name, reinterpret_cast<void*>(&Null##name)}
+#include "ion/gfx/glfunctions.inc"
+};
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// NullGraphicsManager class functions.
+//
+//-----------------------------------------------------------------------------
+
+NullGraphicsManager::NullGraphicsManager() : GraphicsManager(this) {
+  const NullFunctions functions;
+  const FunctionEntry* entry = reinterpret_cast<const FunctionEntry*>(
+      &functions);
+  for (size_t i = 0; i < sizeof(functions) / sizeof(*entry); ++i)
+    functions_[entry[i].name] = entry[i].function;
+
+#define ION_NULL_CUSTOM_FUNC(name) \
+  functions_["gl" #name] = reinterpret_cast<void*>(&Custom##name)
+  ION_NULL_CUSTOM_FUNC(AttachShader);
+  ION_NULL_CUSTOM_FUNC(CheckFramebufferStatus);
+  ION_NULL_CUSTOM_FUNC(ClientWaitSync);
+  ION_NULL_CUSTOM_FUNC(CreateProgram);
+  ION_NULL_CUSTOM_FUNC(CreateShader);
+  ION_NULL_CUSTOM_FUNC(DeleteProgram);
+  ION_NULL_CUSTOM_FUNC(DeleteShader);
+  ION_NULL_CUSTOM_FUNC(DetachShader);
+  ION_NULL_CUSTOM_FUNC(FenceSync);
+  ION_NULL_CUSTOM_FUNC(GenBuffers);
+  ION_NULL_CUSTOM_FUNC(GenFramebuffers);
+  ION_NULL_CUSTOM_FUNC(GenQueries);
+  ION_NULL_CUSTOM_FUNC(GenRenderbuffers);
+  ION_NULL_CUSTOM_FUNC(GenSamplers);
+  ION_NULL_CUSTOM_FUNC(GenTextures);
+  ION_NULL_CUSTOM_FUNC(GenTransformFeedbacks);
+  ION_NULL_CUSTOM_FUNC(GenVertexArrays);
+  ION_NULL_CUSTOM_FUNC(GetActiveAttrib);
+  ION_NULL_CUSTOM_FUNC(GetActiveUniform);
+  ION_NULL_CUSTOM_FUNC(GetAttribLocation);
+  ION_NULL_CUSTOM_FUNC(GetBooleanv);
+  ION_NULL_CUSTOM_FUNC(GetFloatv);
+  ION_NULL_CUSTOM_FUNC(GetInteger64v);
+  ION_NULL_CUSTOM_FUNC(GetIntegerv);
+  ION_NULL_CUSTOM_FUNC(GetProgramInfoLog);
+  ION_NULL_CUSTOM_FUNC(GetProgramiv);
+  ION_NULL_CUSTOM_FUNC(GetShaderInfoLog);
+  ION_NULL_CUSTOM_FUNC(GetShaderPrecisionFormat);
+  ION_NULL_CUSTOM_FUNC(GetShaderSource);
+  ION_NULL_CUSTOM_FUNC(GetShaderiv);
+  ION_NULL_CUSTOM_FUNC(GetString);
+  ION_NULL_CUSTOM_FUNC(GetStringi);
+  ION_NULL_CUSTOM_FUNC(GetUniformBlockIndex);
+  ION_NULL_CUSTOM_FUNC(GetUniformLocation);
+  ION_NULL_CUSTOM_FUNC(LinkProgram);
+  ION_NULL_CUSTOM_FUNC(ShaderSource);
+#undef ION_NULL_CUSTOM_FUNC
+
+  // Install the null versions of the OpenGL functions.
+  ReinitFunctions();
+}
+
+NullGraphicsManager::~NullGraphicsManager() {}
+
+int64 NullGraphicsManager::GetCallCount(const std::string& function_name) {
+  const NullState* state = GetState();
+  auto it = state->counts_by_name.find(function_name);
+  return it == state->counts_by_name.end() ? 0 : it->second->load();
+}
+
+int64 NullGraphicsManager::GetTotalCallCount() {
+  const NullState* state = GetState();
+  int64 total = 0;
+  for (auto it = state->counts_by_name.begin();
+       it != state->counts_by_name.end(); ++it)
+    total += it->second->load();
+  return total;
+}
+
+void NullGraphicsManager::ResetCallCounts() {
+  NullState* state = GetState();
+  for (auto it = state->counts_by_name.begin();
+       it != state->counts_by_name.end(); ++it)
+    *it->second = 0;
+}
+
+void* NullGraphicsManager::Lookup(const char* name, bool is_core) {
+  auto it = functions_.find(name);
+  return it == functions_.end() ? NULL : it->second;
+}
+
+}  // namespace testing
+}  // namespace gfx
+}  // namespace ion
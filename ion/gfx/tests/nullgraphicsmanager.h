@@ -0,0 +1,82 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFX_TESTS_NULLGRAPHICSMANAGER_H_
+#define ION_GFX_TESTS_NULLGRAPHICSMANAGER_H_
+
+#include <map>
+#include <string>
+
+#include "ion/gfx/graphicsmanager.h"
+
+namespace ion {
+namespace gfx {
+namespace testing {
+
+// NullGraphicsManager is a version of GraphicsManager whose OpenGL functions
+// do almost nothing, so that a Renderer using it measures only the CPU cost of
+// Ion itself. Unlike MockGraphicsManager, it does not simulate or validate
+// OpenGL state. Each function only counts its calls, except for the few that
+// the Renderer relies on to run as it would with a real context:
+//   - Gen*() and Create*() return unique object ids.
+//   - Shaders always compile and programs always link. A linked program
+//     reports the uniforms and attributes declared in its shaders' sources,
+//     which are found with a simple scan of the declarations, so that uniforms
+//     and attributes are sent as usual.
+//   - Queries of implementation limits return reasonable values, and queries
+//     of other state return OpenGL's default values.
+//   - The version string reports OpenGL ES 3.0, with no extensions.
+//
+// A NullGraphicsManager needs no OpenGL context and no MockVisual, but since a
+// Renderer only makes OpenGL calls when some portgfx::Visual is current, one
+// must still be made current, e.g., a MockVisual, to render.
+//
+// All NullGraphicsManagers share their objects and call counts, which may be
+// used from any thread.
+class NullGraphicsManager : public GraphicsManager {
+ public:
+  NullGraphicsManager();
+
+  // Returns the number of calls to the named OpenGL function, without its "gl"
+  // prefix (e.g., "DrawElements"), since the first NullGraphicsManager was
+  // constructed or ResetCallCounts() was last called. Returns 0 for unknown
+  // names.
+  static int64 GetCallCount(const std::string& function_name);
+  // Returns the number of calls to all OpenGL functions.
+  static int64 GetTotalCallCount();
+  // Resets all call counts to 0.
+  static void ResetCallCounts();
+
+ protected:
+  ~NullGraphicsManager() override;
+
+ private:
+  // Redefines this to use the null versions of the OpenGL functions.
+  void* Lookup(const char* name, bool is_core) override;
+
+  // Mapping from string names to function pointers.
+  std::map<std::string, void*> functions_;
+};
+
+// Convenience typedef for shared pointer to a NullGraphicsManager.
+typedef base::ReferentPtr<NullGraphicsManager>::Type NullGraphicsManagerPtr;
+
+}  // namespace testing
+}  // namespace gfx
+}  // namespace ion
+
+#endif  // ION_GFX_TESTS_NULLGRAPHICSMANAGER_H_
@@ -0,0 +1,235 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/tests/nullgraphicsmanager.h"
+
+#include <string.h>
+
+#include <string>
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/math/vector.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfx {
+namespace testing {
+
+TEST(NullGraphicsManagerTest, VersionAndCapabilities) {
+  NullGraphicsManagerPtr gm(new NullGraphicsManager);
+  EXPECT_EQ(30U, gm->GetGlVersion());
+  EXPECT_EQ(GraphicsManager::kEs, gm->GetGlApiStandard());
+  EXPECT_EQ("Ion null renderer", gm->GetGlRenderer());
+  EXPECT_TRUE(gm->IsFunctionGroupAvailable(GraphicsManager::kVertexArrays));
+  EXPECT_TRUE(gm->IsFunctionGroupAvailable(GraphicsManager::kSamplerObjects));
+  EXPECT_EQ(4096,
+            gm->GetCapabilityValue<int>(GraphicsManager::kMaxTextureSize));
+  EXPECT_EQ(16,
+            gm->GetCapabilityValue<int>(GraphicsManager::kMaxVertexAttribs));
+
+  // Other state has its default value.
+  GLint value = 0;
+  gm->GetIntegerv(GL_DEPTH_FUNC, &value);
+  EXPECT_EQ(GL_LESS, value);
+  GLfloat range[2] = { -1.f, -1.f };
+  gm->GetFloatv(GL_DEPTH_RANGE, range);
+  EXPECT_EQ(0.f, range[0]);
+  EXPECT_EQ(1.f, range[1]);
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm->GetError());
+  EXPECT_EQ(static_cast<GLenum>(GL_FRAMEBUFFER_COMPLETE),
+            gm->CheckFramebufferStatus(GL_FRAMEBUFFER));
+}
+
+TEST(NullGraphicsManagerTest, CallCountsAndIds) {
+  NullGraphicsManagerPtr gm(new NullGraphicsManager);
+  NullGraphicsManager::ResetCallCounts();
+  EXPECT_EQ(0, NullGraphicsManager::GetTotalCallCount());
+
+  GLuint ids[3] = { 0U, 0U, 0U };
+  gm->GenBuffers(2, ids);
+  gm->GenTextures(1, &ids[2]);
+  EXPECT_NE(0U, ids[0]);
+  EXPECT_NE(ids[0], ids[1]);
+  EXPECT_NE(ids[1], ids[2]);
+  gm->BindBuffer(GL_ARRAY_BUFFER, ids[0]);
+  gm->BindBuffer(GL_ARRAY_BUFFER, ids[1]);
+  gm->DrawArrays(GL_TRIANGLES, 0, 3);
+
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("GenBuffers"));
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("GenTextures"));
+  EXPECT_EQ(2, NullGraphicsManager::GetCallCount("BindBuffer"));
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("DrawArrays"));
+  EXPECT_EQ(0, NullGraphicsManager::GetCallCount("DrawElements"));
+  EXPECT_EQ(0, NullGraphicsManager::GetCallCount("NoSuchFunction"));
+  EXPECT_EQ(5, NullGraphicsManager::GetTotalCallCount());
+
+  NullGraphicsManager::ResetCallCounts();
+  EXPECT_EQ(0, NullGraphicsManager::GetCallCount("BindBuffer"));
+  EXPECT_EQ(0, NullGraphicsManager::GetTotalCallCount());
+}
+
+TEST(NullGraphicsManagerTest, ShaderInputs) {
+  NullGraphicsManagerPtr gm(new NullGraphicsManager);
+  static const char* kVertexSource =
+      "#version 100\n"
+      "// uniform float uCommented;\n"
+      "uniform highp mat4 uMatrix;\n"
+      "uniform vec4 uColors[3], uOffset;\n"
+      "/* attribute vec2 aCommented; */\n"
+      "attribute vec3 aVertex;\n"
+      "attribute mat2 aMat;\n"
+      "attribute vec2 aTexCoords;\n"
+      "uniform Block { vec4 uMember; };\n"
+      "void main() { float unused; }\n";
+  static const char* kFragmentSource =
+      "precision mediump float;\n"
+      "in vec2 vNotAnAttribute;\n"
+      "uniform sampler2D uTexture;\n"
+      "uniform mat4 uMatrix;\n";
+
+  const GLuint vertex = gm->CreateShader(GL_VERTEX_SHADER);
+  const GLuint fragment = gm->CreateShader(GL_FRAGMENT_SHADER);
+  gm->ShaderSource(vertex, 1, &kVertexSource, NULL);
+  gm->ShaderSource(fragment, 1, &kFragmentSource, NULL);
+  gm->CompileShader(vertex);
+  GLint value = GL_FALSE;
+  gm->GetShaderiv(vertex, GL_COMPILE_STATUS, &value);
+  EXPECT_EQ(GL_TRUE, value);
+
+  const GLuint program = gm->CreateProgram();
+  EXPECT_NE(0U, program);
+  gm->AttachShader(program, vertex);
+  gm->AttachShader(program, fragment);
+  gm->LinkProgram(program);
+  gm->GetProgramiv(program, GL_LINK_STATUS, &value);
+  EXPECT_EQ(GL_TRUE, value);
+
+  gm->GetProgramiv(program, GL_ACTIVE_UNIFORMS, &value);
+  EXPECT_EQ(4, value);
+  GLint max_length = 0;
+  gm->GetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+  EXPECT_LE(static_cast<GLint>(strlen("uColors[0]") + 1U), max_length);
+  char name[64];
+  GLsizei length = 0;
+  GLint size = 0;
+  GLenum type = GL_NONE;
+  gm->GetActiveUniform(program, 0U, 64, &length, &size, &type, name);
+  EXPECT_EQ("uMatrix", std::string(name));
+  EXPECT_EQ(7, length);
+  EXPECT_EQ(1, size);
+  EXPECT_EQ(static_cast<GLenum>(GL_FLOAT_MAT4), type);
+  gm->GetActiveUniform(program, 1U, 64, &length, &size, &type, name);
+  EXPECT_EQ("uColors[0]", std::string(name));
+  EXPECT_EQ(3, size);
+  EXPECT_EQ(static_cast<GLenum>(GL_FLOAT_VEC4), type);
+  gm->GetActiveUniform(program, 2U, 64, &length, &size, &type, name);
+  EXPECT_EQ("uOffset", std::string(name));
+  gm->GetActiveUniform(program, 3U, 64, &length, &size, &type, name);
+  EXPECT_EQ("uTexture", std::string(name));
+  EXPECT_EQ(static_cast<GLenum>(GL_SAMPLER_2D), type);
+
+  // Array elements have consecutive locations.
+  EXPECT_EQ(0, gm->GetUniformLocation(program, "uMatrix"));
+  EXPECT_EQ(1, gm->GetUniformLocation(program, "uColors"));
+  EXPECT_EQ(3, gm->GetUniformLocation(program, "uColors[2]"));
+  EXPECT_EQ(-1, gm->GetUniformLocation(program, "uColors[3]"));
+  EXPECT_EQ(4, gm->GetUniformLocation(program, "uOffset"));
+  EXPECT_EQ(-1, gm->GetUniformLocation(program, "uMember"));
+  EXPECT_EQ(-1, gm->GetUniformLocation(program, "uCommented"));
+
+  // Only the vertex shader declares attributes, and matrices use several
+  // slots.
+  gm->GetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &value);
+  EXPECT_EQ(3, value);
+  gm->GetActiveAttrib(program, 1U, 64, &length, &size, &type, name);
+  EXPECT_EQ("aMat", std::string(name));
+  EXPECT_EQ(static_cast<GLenum>(GL_FLOAT_MAT2), type);
+  EXPECT_EQ(0, gm->GetAttribLocation(program, "aVertex"));
+  EXPECT_EQ(1, gm->GetAttribLocation(program, "aMat"));
+  EXPECT_EQ(3, gm->GetAttribLocation(program, "aTexCoords"));
+  EXPECT_EQ(-1, gm->GetAttribLocation(program, "vNotAnAttribute"));
+
+  gm->DeleteProgram(program);
+  gm->GetProgramiv(program, GL_ACTIVE_UNIFORMS, &value);
+  EXPECT_EQ(0, value);
+  gm->DeleteShader(vertex);
+  gm->DeleteShader(fragment);
+}
+
+TEST(NullGraphicsManagerTest, DrawScene) {
+  base::LogChecker log_checker;
+  // The Renderer only makes OpenGL calls when a Visual is current.
+  MockVisual visual(100, 100);
+  NullGraphicsManagerPtr gm(new NullGraphicsManager);
+  RendererPtr renderer(new Renderer(gm));
+
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uColor", kFloatVector4Uniform));
+  NodePtr root(new Node);
+  root->SetShaderProgram(ShaderProgram::BuildFromStrings(
+      "Null shader", reg,
+      "attribute vec3 aVertex;\nuniform vec4 uColor;\n", "void main() {}\n",
+      base::AllocatorPtr()));
+  const size_t color_index = root->AddUniform(
+      reg->Create<Uniform>("uColor", math::Vector4f(1.f, 0.f, 0.f, 1.f)));
+
+  static const float kVertices[] = { 0.f, 0.f, 0.f, 1.f, 0.f, 0.f,
+                                     0.f, 1.f, 0.f };
+  BufferObjectPtr buffer(new BufferObject);
+  buffer->SetData(base::DataContainer::CreateAndCopy<float>(
+                      kVertices, arraysize(kVertices), false,
+                      buffer->GetAllocator()),
+                  sizeof(float) * 3U, 3U, BufferObject::kStaticDraw);
+  AttributeArrayPtr attribute_array(new AttributeArray);
+  attribute_array->AddAttribute(reg->Create<Attribute>(
+      "aVertex", BufferObjectElement(
+          buffer, buffer->AddSpec(BufferObject::kFloat, 3, 0))));
+  ShapePtr shape(new Shape);
+  shape->SetAttributeArray(attribute_array);
+  root->AddShape(shape);
+
+  NullGraphicsManager::ResetCallCounts();
+  renderer->DrawScene(root);
+  // The program is linked again for its attribute bindings to take effect.
+  EXPECT_EQ(2, NullGraphicsManager::GetCallCount("LinkProgram"));
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("BufferData"));
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("Uniform4fv"));
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("DrawArrays"));
+
+  // Only the changed uniform is sent again.
+  NullGraphicsManager::ResetCallCounts();
+  root->SetUniformValue(color_index, math::Vector4f(0.f, 1.f, 0.f, 1.f));
+  renderer->DrawScene(root);
+  EXPECT_EQ(0, NullGraphicsManager::GetCallCount("LinkProgram"));
+  EXPECT_EQ(0, NullGraphicsManager::GetCallCount("BufferData"));
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("Uniform4fv"));
+  EXPECT_EQ(1, NullGraphicsManager::GetCallCount("DrawArrays"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace testing
+}  // namespace gfx
+}  // namespace ion
@@ -0,0 +1,155 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/programbinarycache.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ion/port/fileutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+// Storage that keeps entries in memory.
+class MemoryStorage : public ProgramBinaryCache::Storage {
+ public:
+  bool Read(const std::string& key, std::string* data) override {
+    std::map<std::string, std::string>::const_iterator it = entries_.find(key);
+    if (it == entries_.end())
+      return false;
+    *data = it->second;
+    return true;
+  }
+  void Write(const std::string& key, const std::string& data) override {
+    entries_[key] = data;
+  }
+
+  std::map<std::string, std::string> entries_;
+
+ protected:
+  ~MemoryStorage() override {}
+};
+
+}  // anonymous namespace
+
+TEST(ProgramBinaryCacheTest, ComputeKey) {
+  const std::string key =
+      ProgramBinaryCache::ComputeKey("vertex", "fragment", "gpu", "3.0");
+  EXPECT_EQ(16U, key.length());
+  EXPECT_EQ(std::string::npos, key.find_first_not_of("0123456789abcdef"));
+  EXPECT_EQ(key,
+            ProgramBinaryCache::ComputeKey("vertex", "fragment", "gpu", "3.0"));
+
+  // Every input affects the key, including where the sources are split.
+  EXPECT_NE(key, ProgramBinaryCache::ComputeKey("vertex2", "fragment", "gpu",
+                                                "3.0"));
+  EXPECT_NE(key, ProgramBinaryCache::ComputeKey("vertex", "fragment2", "gpu",
+                                                "3.0"));
+  EXPECT_NE(key, ProgramBinaryCache::ComputeKey("vertex", "fragment", "gpu2",
+                                                "3.0"));
+  EXPECT_NE(key, ProgramBinaryCache::ComputeKey("vertex", "fragment", "gpu",
+                                                "3.1"));
+  EXPECT_NE(key, ProgramBinaryCache::ComputeKey("vertexf", "ragment", "gpu",
+                                                "3.0"));
+}
+
+TEST(ProgramBinaryCacheTest, ReadAndWriteBinaries) {
+  MemoryStorage* storage = new MemoryStorage;
+  ProgramBinaryCachePtr cache(
+      new ProgramBinaryCache(ProgramBinaryCache::StoragePtr(storage)));
+  EXPECT_EQ(storage, cache->GetStorage().Get());
+
+  GLenum format = GL_NONE;
+  std::string binary;
+  EXPECT_FALSE(cache->ReadBinary("key", &format, &binary));
+
+  const std::string data("binary\0data", 11U);
+  cache->WriteBinary("key", 0x1234, data);
+  EXPECT_EQ(1U, storage->entries_.size());
+  EXPECT_TRUE(cache->ReadBinary("key", &format, &binary));
+  EXPECT_EQ(0x1234U, format);
+  EXPECT_EQ(data, binary);
+
+  // Entries too short to hold a binary are ignored.
+  storage->entries_["short"] = "abc";
+  EXPECT_FALSE(cache->ReadBinary("short", &format, &binary));
+}
+
+TEST(ProgramBinaryCacheTest, ReadAndWritePipelineKeys) {
+  MemoryStorage* storage = new MemoryStorage;
+  ProgramBinaryCachePtr cache(
+      new ProgramBinaryCache(ProgramBinaryCache::StoragePtr(storage)));
+  std::vector<uint64> keys;
+  EXPECT_FALSE(cache->ReadPipelineKeys(&keys));
+
+  // Writing no keys stores nothing.
+  cache->WritePipelineKeys(keys);
+  EXPECT_TRUE(storage->entries_.empty());
+
+  keys.push_back(1U);
+  keys.push_back(0xfedcba9876543210ULL);
+  cache->WritePipelineKeys(keys);
+  EXPECT_EQ(1U,
+            storage->entries_.count(ProgramBinaryCache::kPipelineKeysEntry));
+  std::vector<uint64> read_keys;
+  EXPECT_TRUE(cache->ReadPipelineKeys(&read_keys));
+  EXPECT_EQ(keys, read_keys);
+
+  // A truncated entry is ignored.
+  storage->entries_[ProgramBinaryCache::kPipelineKeysEntry].resize(12U);
+  EXPECT_FALSE(cache->ReadPipelineKeys(&read_keys));
+}
+
+TEST(ProgramBinaryCacheTest, FileStorage) {
+  // Use the name of a new temporary file as the key so that it is unique.
+  const std::string path = port::GetTemporaryFilename();
+  ASSERT_FALSE(path.empty());
+  const std::string directory = path.substr(0, path.find_last_of('/'));
+  const std::string key = path.substr(directory.length() + 1U);
+
+  ProgramBinaryCachePtr cache(new ProgramBinaryCache(directory));
+  ProgramBinaryCache::FileStorage* storage =
+      static_cast<ProgramBinaryCache::FileStorage*>(cache->GetStorage().Get());
+  EXPECT_EQ(directory, storage->GetDirectory());
+
+  // There is no entry once the temporary file is removed.
+  EXPECT_TRUE(port::RemoveFile(path));
+  GLenum format = GL_NONE;
+  std::string binary;
+  EXPECT_FALSE(cache->ReadBinary(key, &format, &binary));
+
+  cache->WriteBinary(key, 0x5678, "program");
+  EXPECT_TRUE(cache->ReadBinary(key, &format, &binary));
+  EXPECT_EQ(0x5678U, format);
+  EXPECT_EQ("program", binary);
+
+  // A trailing separator in the directory is handled.
+  ProgramBinaryCachePtr cache2(new ProgramBinaryCache(directory + "/"));
+  EXPECT_TRUE(cache2->ReadBinary(key, &format, &binary));
+  EXPECT_EQ("program", binary);
+
+  EXPECT_TRUE(port::RemoveFile(path));
+  EXPECT_FALSE(cache->ReadBinary(key, &format, &binary));
+}
+
+}  // namespace gfx
+}  // namespace ion
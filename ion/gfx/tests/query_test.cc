@@ -0,0 +1,42 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/query.h"
+
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfx {
+
+TEST(QueryTest, TypeAndLabel) {
+  QueryPtr query(new Query(Query::kAnySamplesPassed));
+  EXPECT_EQ(Query::kAnySamplesPassed, query->GetType());
+  EXPECT_TRUE(query->GetLabel().empty());
+  EXPECT_FALSE(query->IsPending());
+  EXPECT_FALSE(query->HasResult());
+  EXPECT_EQ(0U, query->GetResult());
+  EXPECT_EQ(0U, query->GetResultCount());
+
+  query->SetLabel("occlusion");
+  EXPECT_EQ("occlusion", query->GetLabel());
+
+  QueryPtr timer(new Query(Query::kTimeElapsed));
+  EXPECT_EQ(Query::kTimeElapsed, timer->GetType());
+}
+
+}  // namespace gfx
+}  // namespace ion
@@ -0,0 +1,371 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// This program benchmarks the CPU cost of the Renderer's hot paths. It builds
+// a synthetic scene of configurable size and shape and renders it with a
+// NullGraphicsManager, so that the results measure only Ion's own work and not
+// that of a driver or GPU. The --mock_gl argument renders with a
+// MockGraphicsManager instead, which also includes the cost of simulating
+// OpenGL. Each benchmark reports per-frame and per-operation
+// times through an analytics::Benchmark, printed either in the pretty format
+// or as JSON that can be compared with the results of another run.
+//
+// The scene is a tree of Nodes with the given depth and fan-out. Each leaf has
+// a number of Shapes, each with its own BufferObject, and every Node has its
+// own StateTable and a number of vec4 Uniforms. The sizes are set with
+// command-line arguments named after the settings below, for example:
+//
+//   iongfx_benchmark --depth=4 --fan_out=4 --shapes=2 --frames=200 --json
+
+#include <algorithm>
+#include <iostream>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "ion/analytics/benchmark.h"
+#include "ion/analytics/benchmarkutils.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/serialize.h"
+#include "ion/base/setting.h"
+#include "ion/base/staticsafedeclare.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/nullgraphicsmanager.h"
+#include "ion/math/vector.h"
+#include "ion/port/timer.h"
+
+namespace ion {
+namespace gfx {
+
+namespace {
+
+using analytics::Benchmark;
+using math::Vector4f;
+
+static const int kWindowSize = 512;
+static const char kGroup[] = "Renderer";
+// The prefix of the names of the settings set by command-line arguments.
+static const char kSettingPrefix[] = "renderer_benchmark/";
+
+// The sizes of the scene and the number of iterations of each benchmark.
+struct BenchmarkSettings {
+  BenchmarkSettings()
+      : depth("renderer_benchmark/depth", 3,
+              "Depth of the Node tree; the root is at depth 1"),
+        fan_out("renderer_benchmark/fan_out", 4,
+                "Number of children of each non-leaf Node"),
+        shapes("renderer_benchmark/shapes", 2,
+               "Number of Shapes in each leaf Node"),
+        triangles("renderer_benchmark/triangles", 12,
+                  "Number of triangles in each Shape"),
+        uniforms("renderer_benchmark/uniforms", 4,
+                 "Number of vec4 Uniforms set in each Node"),
+        receivers("renderer_benchmark/receivers", 1000,
+                  "Number of receivers notified by the Notifier benchmark"),
+        frames("renderer_benchmark/frames", 100,
+               "Number of measured frames or iterations of each benchmark"),
+        json("renderer_benchmark/json", false,
+             "Whether to print the results as JSON"),
+        mock_gl("renderer_benchmark/mock_gl", false,
+                "Whether to render with a MockGraphicsManager rather than a "
+                "NullGraphicsManager") {}
+
+  base::Setting<int> depth;
+  base::Setting<int> fan_out;
+  base::Setting<int> shapes;
+  base::Setting<int> triangles;
+  base::Setting<int> uniforms;
+  base::Setting<int> receivers;
+  base::Setting<int> frames;
+  base::Setting<bool> json;
+  base::Setting<bool> mock_gl;
+};
+
+// The synthetic scene, with direct access to the objects the benchmarks
+// modify.
+struct Scene {
+  NodePtr root;
+  std::vector<NodePtr> nodes;
+  std::vector<StateTablePtr> state_tables;
+  std::vector<BufferObjectPtr> buffers;
+  size_t shape_count;
+  size_t uniform_count;
+};
+
+static const std::string GetUniformName(int index) {
+  return "uValue" + base::ValueToString(index);
+}
+
+// Returns a Shape with its own BufferObject holding a triangle list.
+static const ShapePtr BuildShape(const BenchmarkSettings& settings,
+                                 Scene* scene) {
+  const size_t vertex_count = static_cast<size_t>(settings.triangles) * 3U;
+  std::vector<float> coords(vertex_count * 3U);
+  for (size_t i = 0; i < coords.size(); ++i)
+    coords[i] = static_cast<float>(i % 7U) - 3.f;
+  BufferObjectPtr buffer(new BufferObject);
+  buffer->SetData(base::DataContainer::CreateAndCopy<float>(
+                      &coords[0], coords.size(), false, buffer->GetAllocator()),
+                  sizeof(float) * 3U, vertex_count, BufferObject::kDynamicDraw);
+  scene->buffers.push_back(buffer);
+
+  AttributeArrayPtr attribute_array(new AttributeArray);
+  attribute_array->AddAttribute(
+      ShaderInputRegistry::GetGlobalRegistry()->Create<Attribute>(
+          "aVertex", BufferObjectElement(
+              buffer, buffer->AddSpec(BufferObject::kFloat, 3, 0))));
+  ShapePtr shape(new Shape);
+  shape->SetPrimitiveType(Shape::kTriangles);
+  shape->SetAttributeArray(attribute_array);
+  ++scene->shape_count;
+  return shape;
+}
+
+// Adds the Uniforms, StateTable, and either children or Shapes to node.
+static void BuildNode(const BenchmarkSettings& settings,
+                      const ShaderInputRegistryPtr& registry, int depth,
+                      const NodePtr& node, Scene* scene) {
+  scene->nodes.push_back(node);
+  for (int i = 0; i < settings.uniforms; ++i) {
+    node->AddUniform(registry->Create<Uniform>(
+        GetUniformName(i), Vector4f(static_cast<float>(depth), 0.f, 0.f, 1.f)));
+    ++scene->uniform_count;
+  }
+  StateTablePtr state_table(new StateTable(kWindowSize, kWindowSize));
+  state_table->Enable(StateTable::kDepthTest, true);
+  state_table->Enable(StateTable::kCullFace, depth % 2 == 0);
+  node->SetStateTable(state_table);
+  scene->state_tables.push_back(state_table);
+
+  if (depth < settings.depth) {
+    for (int i = 0; i < settings.fan_out; ++i) {
+      NodePtr child(new Node);
+      BuildNode(settings, registry, depth + 1, child, scene);
+      node->AddChild(child);
+    }
+  } else {
+    for (int i = 0; i < settings.shapes; ++i)
+      node->AddShape(BuildShape(settings, scene));
+  }
+}
+
+static void BuildScene(const BenchmarkSettings& settings, Scene* scene) {
+  ShaderInputRegistryPtr registry(new ShaderInputRegistry);
+  registry->IncludeGlobalRegistry();
+  std::string vertex_source = "attribute vec3 aVertex;\n";
+  for (int i = 0; i < settings.uniforms; ++i) {
+    registry->Add(ShaderInputRegistry::UniformSpec(
+        GetUniformName(i), kFloatVector4Uniform, "Benchmark uniform"));
+    vertex_source += "uniform vec4 " + GetUniformName(i) + ";\n";
+  }
+  scene->shape_count = 0;
+  scene->uniform_count = 0;
+  scene->root = new Node;
+  scene->root->SetShaderProgram(ShaderProgram::BuildFromStrings(
+      "Benchmark shader", registry, vertex_source, "void main() {}\n",
+      base::AllocatorPtr()));
+  BuildNode(settings, registry, 1, scene->root, scene);
+}
+
+// Adds a per-frame or per-operation time, in the given units, to benchmark.
+static void AddTime(const std::string& id, const std::string& description,
+                    const std::string& units,
+                    const std::vector<double>& times, Benchmark* benchmark) {
+  Benchmark::VariableAccumulator accumulator(
+      Benchmark::Descriptor(id, kGroup, description, units));
+  for (size_t i = 0; i < times.size(); ++i)
+    accumulator.AddSample(times[i]);
+  benchmark->AddAccumulatedVariable(accumulator.Get());
+}
+
+// Draws the scene settings.frames times, calling update before each frame.
+// The time spent in update is reported per operation as update_id, if given,
+// and the time spent drawing is reported per frame as draw_id.
+template <typename UpdateFunc>
+static void BenchmarkFrames(const BenchmarkSettings& settings,
+                            const RendererPtr& renderer, const Scene& scene,
+                            size_t operations_per_frame,
+                            const std::string& update_id,
+                            const std::string& update_description,
+                            const std::string& draw_id,
+                            const std::string& draw_description,
+                            UpdateFunc update, Benchmark* benchmark) {
+  std::vector<double> update_times;
+  std::vector<double> draw_times;
+  for (int frame = 0; frame < settings.frames; ++frame) {
+    port::Timer timer;
+    update(frame);
+    update_times.push_back(timer.GetInMs() * 1000.0 /
+                           static_cast<double>(operations_per_frame));
+    timer.Reset();
+    renderer->DrawScene(scene.root);
+    draw_times.push_back(timer.GetInMs());
+  }
+  if (!update_id.empty())
+    AddTime(update_id, update_description, "us/op", update_times, benchmark);
+  AddTime(draw_id, draw_description, "ms/frame", draw_times, benchmark);
+}
+
+}  // anonymous namespace
+
+static int RunBenchmarks(int argc, char* argv[]) {
+  BenchmarkSettings settings;
+  if (!analytics::ParseSettingArguments(kSettingPrefix, argc, argv) ||
+      settings.depth < 1 || settings.fan_out < 1 || settings.triangles < 1 ||
+      settings.frames < 1 || settings.receivers < 1) {
+    analytics::PrintSettingUsage(kSettingPrefix, argv[0], std::cerr);
+    return 1;
+  }
+
+  // The Renderer only makes OpenGL calls when a Visual is current, even with a
+  // NullGraphicsManager.
+  testing::MockVisual visual(kWindowSize, kWindowSize);
+  GraphicsManagerPtr gm;
+  if (settings.mock_gl)
+    gm = new testing::MockGraphicsManager();
+  else
+    gm = new testing::NullGraphicsManager();
+  RendererPtr renderer(new Renderer(gm));
+
+  Scene scene;
+  BuildScene(settings, &scene);
+  Benchmark benchmark;
+  benchmark.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("nodes", kGroup, "Nodes in the scene", "nodes"),
+      static_cast<double>(scene.nodes.size())));
+  benchmark.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("shapes", kGroup, "Shapes in the scene", "shapes"),
+      static_cast<double>(scene.shape_count)));
+  benchmark.AddConstant(Benchmark::Constant(
+      Benchmark::Descriptor("uniforms", kGroup, "Uniforms in the scene",
+                            "uniforms"),
+      static_cast<double>(scene.uniform_count)));
+
+  // The first frame creates all resources; the benchmarks measure the steady
+  // state.
+  {
+    port::Timer timer;
+    renderer->DrawScene(scene.root);
+    benchmark.AddConstant(Benchmark::Constant(
+        Benchmark::Descriptor("first_frame", kGroup,
+                              "Time to draw the first frame, which creates "
+                              "all resources", "ms"),
+        timer.GetInMs()));
+  }
+
+  // The scene does not change.
+  BenchmarkFrames(settings, renderer, scene, 1U, std::string(), std::string(),
+                  "draw_scene", "Time to draw the unchanged scene",
+                  [](int) {}, &benchmark);
+  if (!settings.mock_gl) {
+    testing::NullGraphicsManager::ResetCallCounts();
+    renderer->DrawScene(scene.root);
+    benchmark.AddConstant(Benchmark::Constant(
+        Benchmark::Descriptor("gl_calls", kGroup,
+                              "OpenGL calls made to draw the unchanged scene",
+                              "calls/frame"),
+        static_cast<double>(
+            testing::NullGraphicsManager::GetTotalCallCount())));
+  }
+
+  // Every Uniform changes every frame.
+  BenchmarkFrames(
+      settings, renderer, scene, std::max(scene.uniform_count, size_t(1U)),
+      "uniform_update", "Time to set the value of a Uniform",
+      "draw_scene_uniforms", "Time to draw after changing all Uniforms",
+      [&scene, &settings](int frame) {
+        const Vector4f value(static_cast<float>(frame), 1.f, 2.f, 3.f);
+        for (size_t i = 0; i < scene.nodes.size(); ++i) {
+          for (int j = 0; j < settings.uniforms; ++j)
+            scene.nodes[i]->SetUniformValue(static_cast<size_t>(j), value);
+        }
+      }, &benchmark);
+
+  // Every StateTable changes every frame.
+  BenchmarkFrames(
+      settings, renderer, scene, scene.state_tables.size(),
+      "state_table_update", "Time to change a StateTable",
+      "draw_scene_state_tables", "Time to draw after changing all StateTables",
+      [&scene](int frame) {
+        for (size_t i = 0; i < scene.state_tables.size(); ++i) {
+          scene.state_tables[i]->Enable(StateTable::kBlend, frame % 2 == 0);
+          scene.state_tables[i]->SetDepthFunction(
+              frame % 2 == 0 ? StateTable::kDepthLess
+                             : StateTable::kDepthLessOrEqual);
+        }
+      }, &benchmark);
+
+  // Every BufferObject's data changes every frame, which notifies the
+  // BufferObject and requires uploading all of its data.
+  BenchmarkFrames(
+      settings, renderer, scene, scene.buffers.size(), "buffer_update",
+      "Time to modify the data of a BufferObject", "draw_scene_buffers",
+      "Time to draw after modifying all BufferObjects",
+      [&scene](int frame) {
+        for (size_t i = 0; i < scene.buffers.size(); ++i) {
+          float* coords =
+              scene.buffers[i]->GetData()->GetMutableData<float>();
+          coords[0] = static_cast<float>(frame);
+        }
+      }, &benchmark);
+
+  // A Node shared by many parents notifies all of them of each change.
+  {
+    NodePtr shared(new Node);
+    std::vector<NodePtr> parents(settings.receivers);
+    for (size_t i = 0; i < parents.size(); ++i) {
+      parents[i] = new Node;
+      parents[i]->AddChild(shared);
+    }
+    std::vector<double> times;
+    for (int i = 0; i < settings.frames; ++i) {
+      port::Timer timer;
+      shared->Enable(i % 2 != 0);
+      times.push_back(timer.GetInMs() * 1000.0 /
+                      static_cast<double>(parents.size()));
+    }
+    AddTime("notifier_fan_out", "Time to notify one receiver of a change",
+            "us/receiver", times, &benchmark);
+  }
+
+  if (settings.json) {
+    analytics::OutputBenchmarkAsJson(benchmark, "", std::cout);
+  } else {
+    analytics::OutputBenchmarkPretty("Renderer benchmark", true, benchmark,
+                                     std::cout);
+  }
+  renderer = NULL;
+  return 0;
+}
+
+}  // namespace gfx
+}  // namespace ion
+
+int main(int argc, char* argv[]) {
+  const int result = ion::gfx::RunBenchmarks(argc, argv);
+  ion::base::StaticDeleterDeleter::DestroyInstance();
+  return result;
+}
@@ -20,9 +20,13 @@ limitations under the License.
 
 #include "ion/gfx/renderer.h"
 
+#include <algorithm>
 #include <functional>
+#include <limits>
+#include <map>
 #include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "ion/base/datacontainer.h"
@@ -35,6 +39,7 @@ limitations under the License.
 #include "ion/gfx/attribute.h"
 #include "ion/gfx/cubemaptexture.h"
 #include "ion/gfx/framebufferobject.h"
+#include "ion/gfx/programbinarycache.h"
 #include "ion/gfx/resourcemanager.h"
 #include "ion/gfx/sampler.h"
 #include "ion/gfx/shaderinputregistry.h"
@@ -43,6 +48,7 @@ limitations under the License.
 #include "ion/gfx/tests/mockgraphicsmanager.h"
 #include "ion/gfx/tests/traceverifier.h"
 #include "ion/gfx/texture.h"
+#include "ion/gfx/transformfeedback.h"
 #include "ion/gfx/uniform.h"
 #include "ion/math/matrix.h"
 #include "ion/math/matrixutils.h"
@@ -1698,6 +1704,62 @@ TEST_F(RendererTest, ProcessStateTable) {
   EXPECT_EQ(1U, trace_verifier_->GetCountOf("CullFace(GL_FRONT"));
 }
 
+TEST_F(RendererTest, SharedStateTables) {
+  // Test that sibling Nodes sharing StateTable settings send them only once,
+  // and that changes to the OpenGL state in between cause them to be sent
+  // again.
+  RendererPtr renderer(new Renderer(gm_));
+  renderer->UpdateStateFromOpenGL(kWidth, kHeight);
+
+  StateTablePtr greater(new StateTable);
+  greater->SetDepthFunction(StateTable::kDepthGreater);
+  greater->Enable(StateTable::kBlend, true);
+  // A different instance with the same settings.
+  StateTablePtr greater_copy(new StateTable(kWidth, kHeight));
+  greater_copy->SetDepthFunction(StateTable::kDepthGreater);
+  greater_copy->Enable(StateTable::kBlend, true);
+  StateTablePtr less(new StateTable);
+  less->SetDepthFunction(StateTable::kDepthLess);
+
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  NodePtr children[3];
+  for (int i = 0; i < 3; ++i) {
+    children[i] = new Node;
+    children[i]->AddShape(shape);
+    root->AddChild(children[i]);
+  }
+  children[0]->SetStateTable(greater);
+  children[1]->SetStateTable(greater_copy);
+  children[2]->SetStateTable(less);
+
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DepthFunc(GL_GREATER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DepthFunc(GL_LESS"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_BLEND"));
+
+  // The same client state must be sent again after OpenGL's state changes.
+  children[2]->SetStateTable(greater);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DepthFunc(GL_GREATER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
+  renderer->ProcessStateTable(less);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DepthFunc(GL_GREATER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
+
+  // Enforced settings are always sent.
+  greater->SetEnforceSettings(true);
+  greater_copy->SetEnforceSettings(true);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("DepthFunc(GL_GREATER"));
+}
+
 TEST_F(RendererTest, DestroyStateCache) {
   // Doing something that requires internal resource access will trigger some
   // gets.
@@ -2253,6 +2315,263 @@ TEST_F(RendererTest, GpuMemoryUsage) {
   }
 }
 
+TEST_F(RendererTest, BatchedObjectNames) {
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  RendererPtr renderer(new Renderer(gm_));
+  EXPECT_EQ(1U, renderer->GetObjectNameBatchSize());
+  EXPECT_FALSE(renderer->IsObjectDeletionDeferred());
+
+  // Names are generated in batches.
+  renderer->SetObjectNameBatchSize(8U);
+  EXPECT_EQ(8U, renderer->GetObjectNameBatchSize());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenBuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenTextures"));
+
+  // Deferred deletions happen at the end of DrawScene(), one per frame here.
+  renderer->SetDeferredObjectDeletion(true, 1U);
+  EXPECT_TRUE(renderer->IsObjectDeletionDeferred());
+  Reset();
+  renderer->ClearTypedResources(Renderer::kTexture);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(2U, renderer->GetPendingObjectDeletionCount());
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenTextures"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(1U, renderer->GetPendingObjectDeletionCount());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, renderer->GetPendingObjectDeletionCount());
+
+  // Without a limit all queued objects are deleted in one call.
+  renderer->SetDeferredObjectDeletion(true, 0U);
+  renderer->ClearTypedResources(Renderer::kBufferObject);
+  EXPECT_EQ(2U, renderer->GetPendingObjectDeletionCount());
+  Reset();
+  renderer->DrawScene(NodePtr(new Node));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, renderer->GetPendingObjectDeletionCount());
+
+  // Otherwise objects are deleted when they are released.
+  renderer->SetDeferredObjectDeletion(false, 0U);
+  renderer->DrawScene(root);
+  Reset();
+  renderer->ClearTypedResources(Renderer::kBufferObject);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteBuffers"));
+
+  // The unused names are deleted with the Renderer, after the two textures.
+  Reset();
+  renderer.Reset(NULL);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("DeleteTextures"));
+}
+
+TEST_F(RendererTest, GpuMemoryBudget) {
+  base::LogChecker log_checker;
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  NodePtr empty(new Node);
+  RendererPtr renderer(new Renderer(gm_));
+  EXPECT_EQ(0U, renderer->GetGpuMemoryBudget());
+  renderer->DrawScene(root);
+  const size_t buffer_usage = 12U + kVboSize;
+  const size_t texture_usage = 28672U;
+  const size_t cubemap_usage = 24576U;
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, buffer_usage, 0U, texture_usage));
+
+  // Without a budget nothing is evicted.
+  Reset();
+  renderer->DrawScene(empty);
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, buffer_usage, 0U, texture_usage));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+
+  // Resources used by the frame are never evicted.
+  renderer->SetGpuMemoryBudget(1024U);
+  EXPECT_EQ(1024U, renderer->GetGpuMemoryBudget());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, buffer_usage, 0U, texture_usage));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+
+  // Resources that were not used are evicted, and recreated when they are
+  // used again.
+  Reset();
+  renderer->DrawScene(empty);
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 0U, 0U, 0U));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, s_data.vertex_buffer->GetGpuMemoryUsed());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, buffer_usage, 0U, texture_usage));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenTextures"));
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenBuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("VertexAttribPointer(0x0"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+
+  // The least recently used resources are evicted first.
+  CubeMapTexturePtr cubemap1(new CubeMapTexture);
+  CubeMapTexturePtr cubemap2(new CubeMapTexture);
+  for (int i = 0; i < 6; ++i) {
+    const CubeMapTexture::CubeFace face =
+        static_cast<CubeMapTexture::CubeFace>(i);
+    cubemap1->SetImage(face, 0U, s_data.image);
+    cubemap2->SetImage(face, 0U, s_data.image);
+  }
+  cubemap1->SetSampler(s_data.sampler);
+  cubemap2->SetSampler(s_data.sampler);
+  renderer->SetGpuMemoryBudget(0U);
+  EXPECT_TRUE(s_data.rect->SetUniformByName("uCubeMapTexture", cubemap1));
+  renderer->DrawScene(root);
+  EXPECT_TRUE(s_data.rect->SetUniformByName("uCubeMapTexture", cubemap2));
+  renderer->DrawScene(root);
+  EXPECT_EQ(texture_usage + 2U * cubemap_usage,
+            renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  // Evicting one of the unused cubemaps brings usage within the budget.
+  renderer->SetGpuMemoryBudget(buffer_usage + texture_usage +
+                               2U * cubemap_usage - 1U);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(cubemap_usage, cubemap1->GetGpuMemoryUsed());
+  EXPECT_EQ(cubemap_usage, cubemap2->GetGpuMemoryUsed());
+
+  // Buffers whose contents changed through sub-data updates cannot be
+  // recreated from their data, so they are not evicted.
+  EXPECT_TRUE(s_data.rect->SetUniformByName("uCubeMapTexture",
+                                            s_data.cubemap));
+  s_data.vertex_buffer->SetSubData(
+      math::Range1ui(0U, static_cast<uint32>(sizeof(Vertex))),
+      s_data.vertex_container);
+  renderer->SetGpuMemoryBudget(1U);
+  renderer->DrawScene(root);
+  Reset();
+  renderer->DrawScene(empty);
+  EXPECT_EQ(kVboSize, renderer->GetGpuMemoryUsage(Renderer::kBufferObject));
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST_F(RendererTest, GpuMemoryInfo) {
+  typedef ResourceManager::GpuMemoryInfo GpuMemoryInfo;
+  base::LogChecker log_checker;
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  RendererPtr renderer(new Renderer(gm_));
+  // Each sample of a multisampled renderbuffer is stored separately.
+  FramebufferObjectPtr fbo(new FramebufferObject(32, 32));
+  fbo->SetLabel("Offscreen");
+  fbo->SetColorAttachment(
+      0U, FramebufferObject::Attachment(Image::kRgba4Byte, 4U));
+  renderer->BindFramebuffer(fbo);
+  renderer->DrawScene(root);
+  renderer->BindFramebuffer(FramebufferObjectPtr());
+  const size_t buffer_usage = 12U + kVboSize;
+  EXPECT_TRUE(
+      VerifyGpuMemoryUsage(renderer, buffer_usage, 8192U, 28672U));
+
+  // Without a memory info extension only the Renderer's usage is known.
+  gm_->SetExtensionsString("");
+  CallbackHelper<GpuMemoryInfo> callback;
+  renderer->GetResourceManager()->RequestGpuMemoryInfo(
+      std::bind(&CallbackHelper<GpuMemoryInfo>::Callback, &callback,
+                std::placeholders::_1));
+  renderer->DrawScene(root);
+  ASSERT_EQ(1U, callback.infos.size());
+  const GpuMemoryInfo& info = callback.infos[0];
+  EXPECT_EQ(buffer_usage + 8192U + 28672U, info.used);
+  EXPECT_EQ(4U, info.used_by_label.size());
+  EXPECT_EQ(buffer_usage, info.used_by_label.at(""));
+  EXPECT_EQ(8192U, info.used_by_label.at("Offscreen"));
+  EXPECT_EQ(4096U, info.used_by_label.at("Texture"));
+  EXPECT_EQ(24576U, info.used_by_label.at("Cubemap Texture"));
+  EXPECT_EQ(0U, info.device_total);
+  EXPECT_EQ(0U, info.device_available);
+
+  // NVX_gpu_memory_info reports the total and available memory in KB.
+  gm_->SetExtensionsString("GL_NVX_gpu_memory_info");
+  callback.infos.clear();
+  renderer->GetResourceManager()->RequestGpuMemoryInfo(
+      std::bind(&CallbackHelper<GpuMemoryInfo>::Callback, &callback,
+                std::placeholders::_1));
+  renderer->DrawScene(root);
+  ASSERT_EQ(1U, callback.infos.size());
+  EXPECT_EQ(static_cast<uint64>(gm_->GetGpuMemoryTotalKb()) * 1024U,
+            callback.infos[0].device_total);
+  EXPECT_EQ(static_cast<uint64>(gm_->GetGpuMemoryAvailableKb()) * 1024U,
+            callback.infos[0].device_available);
+
+  // ATI_meminfo only reports the available memory.
+  gm_->SetExtensionsString("GL_ATI_meminfo");
+  callback.infos.clear();
+  renderer->GetResourceManager()->RequestGpuMemoryInfo(
+      std::bind(&CallbackHelper<GpuMemoryInfo>::Callback, &callback,
+                std::placeholders::_1));
+  renderer->DrawScene(root);
+  ASSERT_EQ(1U, callback.infos.size());
+  EXPECT_EQ(0U, callback.infos[0].device_total);
+  EXPECT_EQ(static_cast<uint64>(gm_->GetGpuMemoryAvailableKb()) * 1024U,
+            callback.infos[0].device_available);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST_F(RendererTest, ReloadWipedData) {
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  NodePtr empty(new Node);
+  RendererPtr renderer(new Renderer(gm_));
+  // Vertex data that is wiped after each upload, and reloaded from the
+  // original data.
+  const base::DataContainerPtr source = s_data.vertex_container;
+  int reload_count = 0;
+  base::DataContainerPtr vertices = base::DataContainer::CreateAndCopy<uint8>(
+      source->GetData<uint8>(), kVboSize, true, base::AllocatorPtr());
+  s_data.vertex_buffer->SetData(vertices, sizeof(Vertex), s_num_vertices,
+                                s_options.vertex_buffer_usage);
+  renderer->DrawScene(root);
+  EXPECT_TRUE(vertices->GetData() == NULL);
+
+  // Without a reloader the buffer cannot be evicted.
+  renderer->SetGpuMemoryBudget(1U);
+  Reset();
+  renderer->DrawScene(empty);
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+
+  vertices->SetReloader([&reload_count, source]() {
+    ++reload_count;
+    return base::DataContainer::CreateAndCopy<uint8>(
+        source->GetData<uint8>(), kVboSize, false, base::AllocatorPtr());
+  });
+  EXPECT_TRUE(vertices->IsDataAvailable());
+  Reset();
+  renderer->DrawScene(empty);
+  EXPECT_EQ(0U, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(0, reload_count);
+
+  // The data is reloaded when the buffer is recreated, and wiped again.
+  renderer->SetGpuMemoryBudget(0U);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1, reload_count);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                    "BufferData(GL_ARRAY_BUFFER, " +
+                    base::ValueToString(kVboSize)));
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_TRUE(vertices->GetData() == NULL);
+
+  // The same happens after the context is lost.
+  renderer->AbandonAllResources();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2, reload_count);
+  EXPECT_TRUE(vertices->GetData() == NULL);
+}
+
 TEST_F(RendererTest, BufferAttributeTypes) {
   RendererPtr renderer(new Renderer(gm_));
   TracingHelper helper;
@@ -2689,6 +3008,58 @@ TEST_F(RendererTest, NonBufferAttributes) {
   Reset();
 }
 
+
+TEST_F(RendererTest, NonBufferAttributeValuesAreCached) {
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec(
+      "uTexture", kTextureUniform, "Plane texture"));
+  reg->Add(ShaderInputRegistry::UniformSpec(
+      "uTexture2", kTextureUniform, "Plane texture"));
+  reg->Add(ShaderInputRegistry::AttributeSpec(
+      "aTestAttrib", kFloatVector4Attribute, "Testing attribute"));
+
+  for (int emulated = 0; emulated < 2; ++emulated) {
+    SCOPED_TRACE(emulated ? "Emulated vertex arrays" : "Vertex arrays");
+    gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, !emulated);
+    RendererPtr renderer(new Renderer(gm_));
+    NodePtr root = BuildGraph(kWidth, kHeight);
+    s_data.attribute_array = new AttributeArray;
+    s_data.attribute_array->AddAttribute(reg->Create<Attribute>(
+        "aTestAttrib", math::Vector4f(1.f, 2.f, 3.f, 4.f)));
+    s_data.shader = ShaderProgram::BuildFromStrings(
+        "Plane shader", reg, kPlaneVertexShaderString,
+        kPlaneFragmentShaderString, base::AllocatorPtr());
+    s_data.shape->SetAttributeArray(s_data.attribute_array);
+    s_data.rect->SetShaderProgram(s_data.shader);
+    s_data.rect->ClearUniforms();
+    AddPlaneShaderUniformsToNode(s_data.rect);
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("VertexAttrib4fv"));
+
+    // The value is not sent again while it is unchanged.
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("VertexAttrib4fv"));
+
+    // A new value is sent.
+    s_data.attribute_array->GetMutableAttribute(0U)->SetValue(
+        math::Vector4f(4.f, 3.f, 2.f, 1.f));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("VertexAttrib4fv"));
+
+    // Values are sent again after the cached state is cleared.
+    renderer->ClearCachedBindings();
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("VertexAttrib4fv"));
+  }
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
+  s_data.rect = NULL;
+  BuildRectangle();
+}
 TEST_F(RendererTest, MissingInputFromRegistry) {
   // Test that if a shader defines an attribute or uniform but there is no
   // registry entry for it, a warning message is logged.
@@ -3312,5521 +3683,8785 @@ TEST_F(RendererTest, UniformPushAndPop) {
   BuildRectangle();
 }
 
-TEST_F(RendererTest, UniformsShareTextureUnits) {
-  // Test that all textures that share the same uniform are bound to the same
-  // texture unit.
+TEST_F(RendererTest, SortDrawsByState) {
+  // Test that draws are grouped by shader program when kSortDrawsByState is
+  // set, that each draw still gets its own uniform values, and that Nodes can
+  // request that their subtrees are drawn in tree order.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  s_data.rect->ClearChildren();
-  s_data.rect->ClearUniforms();
-  s_data.rect->ClearShapes();
-
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uProjectionMatrix", math::Matrix4f::Identity()));
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uCubeMapTexture", s_data.cubemap));
+  base::LogChecker log_checker;
 
-  // Add many nodes with different textures bound to the same uniform; they
-  // should all share the same image unit.
-  static const int kNumNodes = 9;
-  for (int i = 0; i < kNumNodes; ++i) {
-    NodePtr node(new Node);
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr programs[2];
+  for (int i = 0; i < 2; ++i) {
+    programs[i] = new ShaderProgram(reg);
+    programs[i]->SetLabel("Dummy Shader");
+    programs[i]->SetVertexShader(ShaderPtr(
+        new Shader(i ? "uniform int uInt;\n" : "uniform int uInt;\n\n")));
+    programs[i]->SetFragmentShader(
+        ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  }
+
+  // Alternate the programs between the children of the root. Shapes without
+  // attribute arrays ensure that we only test binding and uniforms here.
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  NodePtr children[4];
+  for (int i = 0; i < 4; ++i) {
+    children[i] = new Node;
+    children[i]->SetShaderProgram(programs[i % 2]);
+    children[i]->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    children[i]->AddShape(shape);
+    root->AddChild(children[i]);
+  }
 
-    TexturePtr texture(new Texture);
-    texture->SetImage(0U, s_data.image);
-    texture->SetSampler(s_data.sampler);
-    node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-        "uTexture", texture));
+  // Without sorting the programs are bound in tree order.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("UseProgram"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
 
-    texture = new Texture;
-    texture->SetImage(0U, s_data.image);
-    texture->SetSampler(s_data.sampler);
-    node->AddUniform(
-        s_data.shader->GetRegistry()->Create<Uniform>("uTexture2", texture));
+  // With sorting each program should only be bound once, and the uniforms
+  // must still be sent with the right values.
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UseProgram"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
+  std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_LT(trace.find("[1])"), trace.find("[3])"));
+  EXPECT_LT(trace.find("[3])"), trace.find("[2])"));
+  EXPECT_LT(trace.find("[2])"), trace.find("[4])"));
 
-    s_data.rect->AddChild(node);
-  }
+  // A Node that preserves its draw order is drawn after all sorted draws.
+  children[0]->SetDrawOrderPreserved(true);
   Reset();
   renderer->DrawScene(root);
-  // Nothing should have happened since there are no shapes.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("UseProgram"));
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_LT(trace.find("[2])"), trace.find("[4])"));
+  EXPECT_LT(trace.find("[4])"), trace.find("[1])"));
 
-  // Add shapes.
-  for (int i = 0; i < kNumNodes; ++i)
-    s_data.rect->GetChildren()[i]->AddShape(s_data.shape);
+  // Clears are never reordered with respect to draws.
+  children[0]->SetDrawOrderPreserved(false);
+  StateTablePtr clear_state(new StateTable);
+  clear_state->SetClearColor(math::Vector4f(0.f, 0.f, 0.f, 1.f));
+  children[2]->SetStateTable(clear_state);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(24U, trace_verifier_->GetCountOf("TexImage2D"));
-  // There should be 19 calls to ActiveTexture: the units will ping-pong; there
-  // is also the cubemap which gets bound.
-  EXPECT_EQ(19U, trace_verifier_->GetCountOf("ActiveTexture"));
-  // The texture uniforms are only sent once.
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("Uniform1i"));
-  EXPECT_EQ(9U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
-  EXPECT_EQ(9U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear("));
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_LT(trace.find("[2])"), trace.find("Clear("));
+  EXPECT_GT(trace.find("[3])"), trace.find("Clear("));
 
-  // Reset data.
-  s_data.rect = NULL;
-  BuildRectangle();
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
-TEST_F(RendererTest, UniformAreSentCorrectly) {
+TEST_F(RendererTest, SortDrawsByStateIncrementally) {
+  // Test that sorting draws with the order of the last frame as a seed
+  // produces the same order as sorting from scratch as the scene changes.
+  RendererPtr renderer(new Renderer(gm_));
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  base::LogChecker log_checker;
+
   ShaderInputRegistryPtr reg(new ShaderInputRegistry);
   reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr programs[2];
+  for (int i = 0; i < 2; ++i) {
+    programs[i] = new ShaderProgram(reg);
+    programs[i]->SetLabel("Dummy Shader");
+    programs[i]->SetVertexShader(ShaderPtr(
+        new Shader(i ? "uniform int uInt;\n" : "uniform int uInt;\n\n")));
+    programs[i]->SetFragmentShader(
+        ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  }
 
-  // Dummy shader with the uniforms defined.
-  static const char* kVertexShaderString =
-      "uniform int uInt;\n"
-      "uniform float uFloat;\n"
-      "uniform vec2 uFV2;\n"
-      "uniform vec3 uFV3;\n"
-      "uniform vec4 uFV4;\n"
-      "uniform ivec2 uIV2;\n"
-      "uniform ivec3 uIV3;\n"
-      "uniform ivec4 uIV4;\n"
-      "uniform mat2 uMat2;\n"
-      "uniform mat3 uMat3;\n"
-      "uniform mat4 uMat4;\n";
-
-  // One of each uniform type.
-  RendererPtr renderer(new Renderer(gm_));
-
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  root->ClearUniforms();
-  root->ClearUniformBlocks();
-  UniformBlockPtr block1(new UniformBlock);
-  UniformBlockPtr block2(new UniformBlock);
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  for (int i = 0; i < 8; ++i) {
+    NodePtr child(new Node);
+    child->SetShaderProgram(programs[i % 3 ? 1 : 0]);
+    child->AddUniform(reg->Create<Uniform>("uInt", 0));
+    child->AddShape(shape);
+    root->AddChild(child);
+  }
+
+  // Each frame gives every child a new uniform value, so that each draw sends
+  // it, and checks that the draws are ordered by program and then tree order.
+  int frame = 0;
+  auto verify_order = [&]() {
+    ++frame;
+    const Node::NodeVector& children = root->GetChildren();
+    std::vector<std::pair<const ShaderProgram*, size_t>> expected;
+    for (size_t i = 0; i < children.size(); ++i) {
+      children[i]->SetUniformValue(0U, frame * 100 + static_cast<int>(i));
+      expected.push_back(
+          std::make_pair(children[i]->GetShaderProgram().Get(), i));
+    }
+    std::sort(expected.begin(), expected.end());
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(expected.size(), trace_verifier_->GetCountOf("Uniform1i"));
+    const std::string trace = trace_verifier_->GetTraceString();
+    size_t pos = 0U;
+    for (size_t i = 0; i < expected.size(); ++i) {
+      SCOPED_TRACE(::testing::Message() << "Frame " << frame << " draw " << i);
+      const int value =
+          children[expected[i].second]->GetUniforms()[0].GetValue<int>();
+      pos = trace.find("[" + base::ValueToString(value) + "])", pos);
+      ASSERT_NE(std::string::npos, pos);
+      ++pos;
+    }
+  };
+
+  // Sort from scratch, then seeded by an unchanged scene.
+  verify_order();
+  verify_order();
+
+  // Change the programs of some children.
+  root->GetChildren()[1]->SetShaderProgram(programs[0]);
+  root->GetChildren()[3]->SetShaderProgram(programs[1]);
+  verify_order();
+
+  // Add, replace, and remove children.
+  NodePtr added(new Node);
+  added->SetShaderProgram(programs[0]);
+  added->AddUniform(reg->Create<Uniform>("uInt", 0));
+  added->AddShape(shape);
+  root->AddChild(added);
+  verify_order();
+  NodePtr replaced(new Node);
+  replaced->SetShaderProgram(programs[1]);
+  replaced->AddUniform(reg->Create<Uniform>("uInt", 0));
+  replaced->AddShape(shape);
+  root->ReplaceChild(0U, replaced);
+  root->RemoveChildAt(4U);
+  verify_order();
+
+  // A child that is drawn twice still gets both draws.
+  root->AddChild(root->GetChildren()[2]);
+  verify_order();
 
-  PopulateUniformValues(s_data.rect, block1, block2, reg, 0);
-  s_data.rect->AddUniformBlock(block1);
-  s_data.rect->AddUniformBlock(block2);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  ShaderProgramPtr program(new ShaderProgram(reg));
-  program->SetLabel("Dummy Shader");
-  program->SetVertexShader(ShaderPtr(new Shader(kVertexShaderString)));
-  program->SetFragmentShader(
-      ShaderPtr(new Shader("Dummy Fragment Shader Source")));
-  s_data.rect->SetShaderProgram(program);
-  // Remove attribute array to prevent warnings; we are only testing uniforms
-  // here.
-  s_data.shape->SetAttributeArray(AttributeArrayPtr(NULL));
+TEST_F(RendererTest, SortDrawsByRenderPass) {
+  // Test that draws are grouped by the render passes of their Nodes, that the
+  // opaque and transparent passes are sorted by depth, and that a depth
+  // prepass draws the opaque pass with depth-only variants first.
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
 
-  {
-    // Verify that the uniforms were sent only once, since there is only one
-    // node.
-    Reset();
-    renderer->DrawScene(root);
-    SCOPED_TRACE(__LINE__);
-    VerifyUniformCounts(1U, trace_verifier_);
-  }
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr programs[2];
+  for (int i = 0; i < 2; ++i) {
+    programs[i] = new ShaderProgram(reg);
+    programs[i]->SetLabel(i ? "Depth Shader" : "Dummy Shader");
+    programs[i]->SetVertexShader(ShaderPtr(
+        new Shader(i ? "uniform int uInt;\n" : "uniform int uInt;\n\n")));
+    programs[i]->SetFragmentShader(
+        ShaderPtr(new Shader(i ? "Depth Fragment Shader Source"
+                               : "Dummy Fragment Shader Source")));
+  }
+  programs[0]->SetDepthOnlyVariant(programs[1]);
+
+  // The children are, in order: an unassigned Node, an overlay, a near and a
+  // far transparent Node, and a far and a near opaque Node. Shapes without
+  // attribute arrays ensure that we only test binding and uniforms here.
+  static const Node::RenderPass kPasses[6] = {
+      Node::kInheritedPass, Node::kOverlayPass, Node::kTransparentPass,
+      Node::kTransparentPass, Node::kOpaquePass, Node::kOpaquePass};
+  static const float kDepths[6] = { 0.f, 0.f, -0.5f, 0.5f, 0.5f, -0.5f };
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  root->SetShaderProgram(programs[0]);
+  NodePtr children[6];
+  for (int i = 0; i < 6; ++i) {
+    children[i] = new Node;
+    children[i]->SetRenderPass(kPasses[i]);
+    children[i]->SetBounds(math::Range3f(
+        math::Point3f(-0.1f, -0.1f, kDepths[i] - 0.1f),
+        math::Point3f(0.1f, 0.1f, kDepths[i] + 0.1f)));
+    children[i]->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    children[i]->AddShape(shape);
+    root->AddChild(children[i]);
+  }
+
+  // Without a culling matrix each pass is drawn in tree order.
+  renderer->SetFlag(Renderer::kSortDrawsByRenderPass);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("Uniform1i"));
+  std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_LT(trace.find("[1])"), trace.find("[5])"));
+  EXPECT_LT(trace.find("[5])"), trace.find("[6])"));
+  EXPECT_LT(trace.find("[6])"), trace.find("[3])"));
+  EXPECT_LT(trace.find("[3])"), trace.find("[4])"));
+  EXPECT_LT(trace.find("[4])"), trace.find("[2])"));
+
+  // With one, opaque draws are sorted front to back and transparent draws
+  // back to front.
+  renderer->SetCullingMatrix(math::Matrix4f::Identity());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("Uniform1i"));
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_LT(trace.find("[1])"), trace.find("[6])"));
+  EXPECT_LT(trace.find("[6])"), trace.find("[5])"));
+  EXPECT_LT(trace.find("[5])"), trace.find("[4])"));
+  EXPECT_LT(trace.find("[4])"), trace.find("[3])"));
+  EXPECT_LT(trace.find("[3])"), trace.find("[2])"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ColorMask"));
+
+  // The prepass draws the opaque Nodes into the depth buffer only, with the
+  // depth-only variant, and then draws them again testing against it.
+  renderer->SetFlag(Renderer::kDepthPrepass);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(8U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UseProgram"));
+  trace = trace_verifier_->GetTraceString();
+  const size_t prepass_start = trace.find("ColorMask(red = GL_FALSE");
+  const size_t prepass_end = trace.find("DepthFunc(func = GL_LEQUAL");
+  ASSERT_NE(std::string::npos, prepass_start);
+  ASSERT_NE(std::string::npos, prepass_end);
+  EXPECT_LT(trace.find("[1])"), prepass_start);
+  EXPECT_LT(prepass_start, trace.find("[6])"));
+  EXPECT_LT(trace.find("[6])"), trace.find("[5])"));
+  EXPECT_LT(trace.find("[5])"), prepass_end);
+  EXPECT_LT(prepass_end, trace.find("[6])", prepass_end));
+  EXPECT_LT(trace.find("[5])", prepass_end), trace.find("[4])"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DepthMask(GL_FALSE"));
+  // Color writes are enabled again for the opaque pass, and the defaults are
+  // restored for the transparent pass.
+  EXPECT_LT(trace.find("[5])"), trace.find("ColorMask(red = GL_TRUE"));
+  EXPECT_LT(trace.find("[5])", prepass_end),
+            trace.find("DepthMask(flag = GL_TRUE"));
+
+  // The prepass has no effect without sorting by render pass.
+  renderer->ClearFlag(Renderer::kSortDrawsByRenderPass);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ColorMask"));
+  renderer->ClearFlag(Renderer::kDepthPrepass);
+  renderer->ClearCullingMatrix();
 
-  // Add another identical node with the same shape and uniforms. Since the
-  // uniform values are the same no additional data should be sent to GL.
-  NodePtr node(new Node);
-  s_data.rect->AddChild(node);
-  node->AddShape(s_data.shape);
-  PopulateUniformValues(node, block1, block2, reg, 0);
-  // Add the same uniform blocks.
-  node->AddUniformBlock(block1);
-  node->AddUniformBlock(block2);
-  {
-    Reset();
-    renderer->DrawScene(root);
-    SCOPED_TRACE(__LINE__);
-    VerifyUniformCounts(0U, trace_verifier_);
-  }
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  // Use the same uniforms but with different values.
-  PopulateUniformValues(node, block1, block2, reg, 1);
-  {
-    Reset();
-    renderer->DrawScene(root);
-    SCOPED_TRACE(__LINE__);
-    // Verify that the uniforms were sent. Each should be sent once, when the
-    // child node is processed, since the initial values were cached already.
-    VerifyUniformCounts(1U, trace_verifier_);
-  }
+TEST_F(RendererTest, OrderIndependentTransparency) {
+  // Test that the transparent pass is drawn twice into offscreen targets, the
+  // second time with the revealage variant, and then composited, and that the
+  // other passes are drawn as usual.
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
 
-  // Set the same shader in the child node.
-  node->SetShaderProgram(program);
-  {
-    Reset();
-    renderer->DrawScene(root);
-    SCOPED_TRACE(__LINE__);
-    // The uniforms should have been sent twice since the child nodes blew away
-    // the cached values in the last pass; both values will have to be sent this
-    // time.
-    VerifyUniformCounts(2U, trace_verifier_);
-  }
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr programs[2];
+  for (int i = 0; i < 2; ++i) {
+    programs[i] = new ShaderProgram(reg);
+    programs[i]->SetLabel(i ? "Revealage Shader" : "Dummy Shader");
+    programs[i]->SetVertexShader(ShaderPtr(
+        new Shader(i ? "uniform int uInt;\n" : "uniform int uInt;\n\n")));
+    programs[i]->SetFragmentShader(
+        ShaderPtr(new Shader(i ? "Revealage Fragment Shader Source"
+                               : "Dummy Fragment Shader Source")));
+  }
+  programs[0]->SetRevealageVariant(programs[1]);
+
+  // The children are an opaque Node, two transparent Nodes, and an overlay.
+  static const Node::RenderPass kPasses[4] = {
+      Node::kOpaquePass, Node::kTransparentPass, Node::kTransparentPass,
+      Node::kOverlayPass};
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  StateTablePtr state_table(new StateTable(kWidth, kHeight));
+  state_table->SetViewport(0, 0, kWidth, kHeight);
+  root->SetStateTable(state_table);
+  root->SetShaderProgram(programs[0]);
+  for (int i = 0; i < 4; ++i) {
+    NodePtr child(new Node);
+    child->SetRenderPass(kPasses[i]);
+    child->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    child->AddShape(shape);
+    root->AddChild(child);
+  }
+
+  renderer->SetFlag(Renderer::kSortDrawsByRenderPass);
+  renderer->SetFlag(Renderer::kOrderIndependentTransparency);
+  Reset();
+  renderer->DrawScene(root);
+  std::string trace = trace_verifier_->GetTraceString();
+  // Each transparent Node is drawn once into each target, which are cleared
+  // first, and the depth buffer is copied into them.
+  const size_t accumulation = trace.find("[2])");
+  const size_t revealage = trace.find("[2])", accumulation + 1U);
+  ASSERT_NE(std::string::npos, accumulation);
+  ASSERT_NE(std::string::npos, revealage);
+  EXPECT_LT(trace.find("[1])"), accumulation);
+  EXPECT_LT(accumulation, trace.find("[3])"));
+  EXPECT_LT(trace.find("[3])"), revealage);
+  EXPECT_LT(revealage, trace.find("[3])", revealage));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("Clear("));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BlitFramebuffer"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DepthMask(GL_FALSE"));
+  EXPECT_LT(trace.find("BlendFunc"), accumulation);
+  EXPECT_LT(accumulation, trace.find("Revealage Shader"));
+  EXPECT_LT(trace.find("Revealage Shader"), revealage);
+  // The composite is drawn into the default framebuffer before the overlay.
+  const size_t composite = trace.find("DrawArrays(mode = GL_TRIANGLE_STRIP");
+  ASSERT_NE(std::string::npos, composite);
+  EXPECT_LT(revealage, composite);
+  EXPECT_LT(composite, trace.find("[4])"));
+  EXPECT_LT(trace.rfind("framebuffer = 0x0)", composite), composite);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  // Use a different shader for the child node.
-  ShaderProgramPtr program2(new ShaderProgram(reg));
-  program2->SetLabel("Dummy Shader");
-  program2->SetVertexShader(ShaderPtr(new Shader(kVertexShaderString)));
-  program2->SetFragmentShader(
-      ShaderPtr(new Shader("Dummy Fragment Shader Source")));
-  node->SetShaderProgram(program2);
-  {
-    Reset();
-    renderer->DrawScene(root);
-    SCOPED_TRACE(__LINE__);
-    // Uniforms will have to be sent twice, once for the first program using
-    // the first set of values, and then again for the second shader.
-    VerifyUniformCounts(2U, trace_verifier_);
-  }
+  // The targets are reused by later frames.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenTextures"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_TRIANGLE_STRIP"));
 
-  {
-    Reset();
-    renderer->DrawScene(root);
-    SCOPED_TRACE(__LINE__);
-    // Now that both caches are populated no uniforms should be sent.
-    VerifyUniformCounts(0U, trace_verifier_);
-  }
+  // Without framebuffer blits, the transparent pass is drawn once, back to
+  // front.
+  gm_->EnableFunctionGroup(GraphicsManager::kFramebufferBlit, false);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawArrays(GL_TRIANGLE_STRIP"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "requires framebuffer blits"));
+  gm_->EnableFunctionGroup(GraphicsManager::kFramebufferBlit, true);
 
-  // Reset.
-  s_data.rect = NULL;
-  s_data.shape->SetAttributeArray(s_data.attribute_array);
-  BuildRectangle();
+  // OpenGL ES 3.0 cannot render into the half-float accumulation target
+  // without an extension, so the transparent pass is also drawn back to front.
+  const std::string extensions(
+      reinterpret_cast<const char*>(gm_->GetString(GL_EXTENSIONS)));
+  gm_->SetVersionString("3.0 Ion OpenGL / ES");
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BlitFramebuffer"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawArrays(GL_TRIANGLE_STRIP"));
+  EXPECT_TRUE(
+      log_checker.HasMessage("WARNING", "requires half-float color buffers"));
+  gm_->SetExtensionsString(extensions + " GL_EXT_color_buffer_half_float");
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BlitFramebuffer"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_TRIANGLE_STRIP"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  renderer->ClearFlag(Renderer::kOrderIndependentTransparency);
+  renderer->ClearFlag(Renderer::kSortDrawsByRenderPass);
 }
 
-TEST_F(RendererTest, SetTextureImageUnitRange) {
-  // Test that all textures that share the same uniform are bound to the same
-  // texture unit.
+TEST_F(RendererTest, RetainDrawList) {
+  // Test that a retained DrawList picks up changes to Uniform and StateTable
+  // values, and is rebuilt when the structure of the scene changes.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  s_data.rect->ClearChildren();
-  s_data.rect->ClearUniforms();
-  s_data.rect->ClearShapes();
-
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uProjectionMatrix", math::Matrix4f::Identity()));
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uCubeMapTexture", s_data.cubemap));
+  base::LogChecker log_checker;
 
-  // Add many nodes with different textures bound to the same uniform; they
-  // should all share the same image unit.
-  static const int kNumNodes = 4;
-  for (int i = 0; i < kNumNodes; ++i) {
-    NodePtr node(new Node);
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr programs[2];
+  for (int i = 0; i < 2; ++i) {
+    programs[i] = new ShaderProgram(reg);
+    programs[i]->SetLabel("Dummy Shader");
+    programs[i]->SetVertexShader(ShaderPtr(
+        new Shader(i ? "uniform int uInt;\n" : "uniform int uInt;\n\n")));
+    programs[i]->SetFragmentShader(
+        ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  }
 
-    TexturePtr texture(new Texture);
-    texture->SetLabel("Texture_a " + base::ValueToString(i));
-    texture->SetImage(0U, s_data.image);
-    texture->SetSampler(s_data.sampler);
-    node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-        "uTexture", texture));
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  NodePtr children[3];
+  for (int i = 0; i < 3; ++i) {
+    children[i] = new Node;
+    children[i]->SetShaderProgram(programs[i % 2]);
+    children[i]->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    children[i]->AddShape(shape);
+  }
+  root->AddChild(children[0]);
+  root->AddChild(children[1]);
 
-    texture = new Texture;
-    texture->SetLabel("Texture_b " + base::ValueToString(i));
-    texture->SetImage(0U, s_data.image);
-    texture->SetSampler(s_data.sampler);
-    node->AddUniform(
-        s_data.shader->GetRegistry()->Create<Uniform>("uTexture2", texture));
+  renderer->SetFlag(Renderer::kRetainDrawList);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UseProgram"));
+  std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[2])"));
 
-    s_data.rect->AddChild(node);
-  }
+  // Uniform values are read when drawing.
+  children[0]->SetUniformValue(0U, 7);
   Reset();
+  renderer->DrawScene(root);
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[7])"));
+  EXPECT_EQ(std::string::npos, trace.find("[1])"));
 
-  // Add shapes to force GL calls.
-  for (int i = 0; i < kNumNodes; ++i)
-    s_data.rect->GetChildren()[i]->AddShape(s_data.shape);
+  // Adding a child rebuilds the list.
+  root->AddChild(children[2]);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_NE(std::string::npos, trace_verifier_->GetTraceString().find("[3])"));
 
-  // Use two texture units.
+  // So does disabling a Node.
+  children[2]->Enable(false);
+  children[0]->SetUniformValue(0U, 1);
   Reset();
-  renderer->SetTextureImageUnitRange(Range1i(0, 1));
   renderer->DrawScene(root);
-  EXPECT_EQ(14U, trace_verifier_->GetCountOf("TexImage2D"));
-  // There should be 12 calls to ActiveTexture since we ping pong back and forth
-  // between the two units for three textures. There are 12 binds, and we aren't
-  // starting from 0.
-  EXPECT_EQ(12U, trace_verifier_->GetCountOf("ActiveTexture"));
-  // The texture uniforms are sent exactly once.
-  EXPECT_EQ(12U, trace_verifier_->GetCountOf("Uniform1i"));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_EQ(std::string::npos, trace.find("[3])"));
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
 
-  // Use one texture unit.
+  // A StateTable that becomes a clear is drawn as one.
+  StateTablePtr state(new StateTable);
+  state->Enable(StateTable::kBlend, true);
+  children[1]->SetStateTable(state);
   Reset();
-  renderer->SetTextureImageUnitRange(Range1i(0, 0));
   renderer->DrawScene(root);
-  // The textures are already updated.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  // There should be only one call to ActiveTexture since there is only one
-  // unit.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture"));
-  // The texture uniforms are only sent once, and the first already has the
-  // right value.
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("Uniform1i"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Clear("));
+  state->SetClearColor(math::Vector4f(0.f, 0.f, 0.f, 1.f));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear("));
 
-  // Use three texture units.
+  // Lists are also rebuilt when sorting is toggled.
+  state->ResetValue(StateTable::kClearColorValue);
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  children[2]->Enable(true);
   Reset();
-  renderer->SetTextureImageUnitRange(Range1i(3, 5));
   renderer->DrawScene(root);
-  // The textures are already updated.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  // There should be 9 calls to ActiveTexture since we ping pong back and forth
-  // between the 3 units for 3 textures. The cubemap gets a single unit and
-  // reuses it, while the other textures each requre rebinding.
-  EXPECT_EQ(9U, trace_verifier_->GetCountOf("ActiveTexture"));
-  // The texture uniforms are only sent once since we have exactly the right
-  // number of units.
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("Uniform1i"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE3)"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE4)"));
-  // This is used for the cubemap.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE5)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE6)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Clear("));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UseProgram"));
+  EXPECT_NE(std::string::npos, trace_verifier_->GetTraceString().find("[3])"));
 
-  // Reset data.
-  s_data.rect = NULL;
-  BuildRectangle();
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
-TEST_F(RendererTest, ArrayUniforms) {
-  // Add array uniform types to a node and make sure the right functions are
-  // called in the renderer.
+TEST_F(RendererTest, RetainDrawListSubgraphs) {
+  // Test that a retained DrawList only collects the subgraphs of the root's
+  // children that changed, and that the others are reused correctly.
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
+
   ShaderInputRegistryPtr reg(new ShaderInputRegistry);
   reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr programs[2];
+  for (int i = 0; i < 2; ++i) {
+    programs[i] = new ShaderProgram(reg);
+    programs[i]->SetLabel("Dummy Shader");
+    programs[i]->SetVertexShader(ShaderPtr(
+        new Shader(i ? "uniform int uInt;\n" : "uniform int uInt;\n\n")));
+    programs[i]->SetFragmentShader(
+        ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  }
 
-  // Dummy shader with the uniforms defined.
-  static const char* kVertexShaderString =
-      "uniform int uInt;\n"
-      "uniform float uFloat;\n"
-      "uniform vec2 uFV2;\n"
-      "uniform vec3 uFV3;\n"
-      "uniform vec4 uFV4;\n"
-      "uniform ivec2 uIV2;\n"
-      "uniform ivec3 uIV3;\n"
-      "uniform ivec4 uIV4;\n"
-      "uniform mat2 uMat2;\n"
-      "uniform mat3 uMat3;\n"
-      "uniform mat4 uMat4;\n"
-      "uniform sampler2D sampler;\n"
-      "uniform samplerCube cubeSampler;\n"
-      "uniform int uIntArray[2];\n"
-      "uniform float uFloatArray[2];\n"
-      "uniform vec2 uFV2Array[2];\n"
-      "uniform vec3 uFV3Array[3];\n"
-      "uniform vec4 uFV4Array[4];\n"
-      "uniform ivec2 uIV2Array[2];\n"
-      "uniform ivec3 uIV3Array[3];\n"
-      "uniform ivec4 uIV4Array[4];\n"
-      "uniform mat2 uMat2Array[2];\n"
-      "uniform mat3 uMat3Array[3];\n"
-      "uniform mat4 uMat4Array[4];\n"
-      "uniform sampler2D samplerArray[2];\n"
-      "uniform samplerCube cubeSamplerArray[2];\n";
+  // Each child of the root has a grandchild with a Shape.
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  root->SetShaderProgram(programs[0]);
+  NodePtr children[2];
+  NodePtr grandchildren[3];
+  for (int i = 0; i < 3; ++i) {
+    grandchildren[i] = new Node;
+    grandchildren[i]->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    grandchildren[i]->AddShape(shape);
+  }
+  for (int i = 0; i < 2; ++i) {
+    children[i] = new Node;
+    children[i]->AddChild(grandchildren[i]);
+    root->AddChild(children[i]);
+  }
 
-  // One of each uniform type.
-  RendererPtr renderer(new Renderer(gm_));
+  renderer->SetFlag(Renderer::kRetainDrawList);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UseProgram"));
+  std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[2])"));
 
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  root->ClearUniforms();
-  root->ClearUniformBlocks();
-  s_data.rect->ClearUniforms();
-  s_data.rect->ClearUniformBlocks();
+  // Changes below a child are picked up, and the other child is still drawn.
+  children[1]->AddChild(grandchildren[2]);
+  grandchildren[0]->SetUniformValue(0U, 7);
+  Reset();
+  renderer->DrawScene(root);
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[7])"));
+  EXPECT_NE(std::string::npos, trace.find("[2])"));
+  EXPECT_NE(std::string::npos, trace.find("[3])"));
+  grandchildren[2]->Enable(false);
+  Reset();
+  renderer->DrawScene(root);
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[7])"));
+  EXPECT_EQ(std::string::npos, trace.find("[3])"));
 
-  // add all the uniforms here
+  // Reused subgraphs pick up what they inherit from the root. With a stale
+  // list the first child would still be drawn with the old program, so the
+  // programs would be switched twice.
+  children[1]->SetShaderProgram(programs[1]);
+  renderer->DrawScene(root);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UseProgram"));
+  root->SetShaderProgram(programs[1]);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UseProgram"));
+
+  // A StateTable below a child that becomes a clear is drawn as one.
+  StateTablePtr state(new StateTable);
+  state->Enable(StateTable::kBlend, true);
+  grandchildren[1]->SetStateTable(state);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Clear("));
+  state->SetClearColor(math::Vector4f(0.f, 0.f, 0.f, 1.f));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear("));
+  state->ResetValue(StateTable::kClearColorValue);
+
+  // A child may appear more than once, and children may be reordered or
+  // removed.
+  root->AddChild(children[0]);
+  grandchildren[0]->SetUniformValue(0U, 1);
+  Reset();
+  renderer->DrawScene(root);
+  trace = trace_verifier_->GetTraceString();
+  const size_t first = trace.find("[1])");
+  EXPECT_NE(std::string::npos, first);
+  EXPECT_NE(std::string::npos, trace.find("[1])", first + 1U));
+  root->ClearChildren();
+  root->AddChild(children[1]);
+  grandchildren[1]->SetUniformValue(0U, 5);
+  Reset();
+  renderer->DrawScene(root);
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_EQ(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[5])"));
+
+  // The same holds when the subgraphs are collected in parallel.
+  renderer->SetDrawListThreadCount(2U);
+  root->AddChild(children[0]);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_NE(std::string::npos, trace_verifier_->GetTraceString().find("[1])"));
+  grandchildren[2]->Enable(true);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_NE(std::string::npos, trace_verifier_->GetTraceString().find("[3])"));
+  renderer->SetDrawListThreadCount(0U);
+
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+static bool IsNotHidden(const Node& node) {
+  return node.GetLabel() != "hidden";
+}
+
+TEST_F(RendererTest, NodeVisibilityFunction) {
+  // Test that Nodes rejected by the visibility function are not drawn, both
+  // when drawing the tree directly and when flattening it into a draw list.
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
+
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
   ShaderProgramPtr program(new ShaderProgram(reg));
   program->SetLabel("Dummy Shader");
-  program->SetVertexShader(ShaderPtr(new Shader(kVertexShaderString)));
+  program->SetVertexShader(ShaderPtr(new Shader("uniform int uInt;\n")));
   program->SetFragmentShader(
       ShaderPtr(new Shader("Dummy Fragment Shader Source")));
-  s_data.rect->SetShaderProgram(program);
-  // Remove attribute array to prevent warnings; we are only testing uniforms
-  // here.
-  s_data.shape->SetAttributeArray(AttributeArrayPtr(NULL));
-
-  root->AddUniform(reg->Create<Uniform>("uInt", 13));
-  root->AddUniform(reg->Create<Uniform>("uFloat", 1.5f));
-  root->AddUniform(
-      reg->Create<Uniform>("uFV2", math::Vector2f(2.f, 3.f)));
-  root->AddUniform(
-      reg->Create<Uniform>("uFV3", math::Vector3f(4.f, 5.f, 6.f)));
-  root->AddUniform(reg->Create<Uniform>(
-      "uFV4", math::Vector4f(7.f, 8.f, 9.f, 10.f)));
-  root->AddUniform(reg->Create<Uniform>("uIV2",
-                                        math::Vector2i(2, 3)));
-  root->AddUniform(reg->Create<Uniform>("uIV3",
-                                        math::Vector3i(4, 5, 6)));
-  root->AddUniform(reg->Create<Uniform>("uIV4",
-                                        math::Vector4i(7, 8, 9, 10)));
-  root->AddUniform(reg->Create<Uniform>("uMat2",
-                                        math::Matrix2f(1.f, 2.f,
-                                                       3.f, 4.f)));
-  root->AddUniform(reg->Create<Uniform>("uMat3",
-                                        math::Matrix3f(1.f, 2.f, 3.f,
-                                                       4.f, 5.f, 6.f,
-                                                       7.f, 8.f, 9.f)));
-  root->AddUniform(reg->Create<Uniform>("uMat4",
-                                        math::Matrix4f(1.f, 2.f, 3.f, 4.f,
-                                                       5.f, 6.f, 7.f, 8.f,
-                                                       9.f, 1.f, 2.f, 3.f,
-                                                       4.f, 5.f, 6.f, 7.f)));
-  root->AddUniform(reg->Create<Uniform>("sampler", s_data.texture));
-  root->AddUniform(reg->Create<Uniform>("cubeSampler", s_data.cubemap));
 
-  TexturePtr texture1(new Texture);
-  texture1->SetImage(0U, s_data.image);
-  texture1->SetSampler(s_data.sampler);
-  TexturePtr texture2(new Texture);
-  texture2->SetImage(0U, s_data.image);
-  texture2->SetSampler(s_data.sampler);
-  CubeMapTexturePtr cubemap1(new CubeMapTexture);
-  cubemap1->SetSampler(s_data.sampler);
-  CubeMapTexturePtr cubemap2(new CubeMapTexture);
-  cubemap2->SetSampler(s_data.sampler);  for (int i = 0; i < 6; ++i) {
-    cubemap1->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
-                       s_data.image);
-    cubemap2->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
-                       s_data.image);
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  root->SetShaderProgram(program);
+  NodePtr children[2];
+  for (int i = 0; i < 2; ++i) {
+    children[i] = new Node;
+    children[i]->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    children[i]->AddShape(shape);
+    root->AddChild(children[i]);
   }
+  children[1]->SetLabel("hidden");
 
-  std::vector<int> ints;
-  ints.push_back(1);
-  ints.push_back(2);
-  std::vector<float> floats;
-  floats.push_back(1.f);
-  floats.push_back(2.f);
-  std::vector<TexturePtr> textures;
-  textures.push_back(texture1);
-  textures.push_back(texture2);
-  std::vector<CubeMapTexturePtr> cubemaps;
-  cubemaps.push_back(cubemap1);
-  cubemaps.push_back(cubemap2);
-  std::vector<math::Vector2i> vector2is;
-  vector2is.push_back(math::Vector2i(1, 2));
-  vector2is.push_back(math::Vector2i(3, 4));
-  std::vector<math::Vector3i> vector3is;
-  vector3is.push_back(math::Vector3i(1, 2, 3));
-  vector3is.push_back(math::Vector3i(4, 5, 6));
-  std::vector<math::Vector4i> vector4is;
-  vector4is.push_back(math::Vector4i(1, 2, 3, 4));
-  vector4is.push_back(math::Vector4i(5, 6, 7, 8));
-  std::vector<math::Vector2f> vector2fs;
-  vector2fs.push_back(math::Vector2f(1.f, 2.f));
-  vector2fs.push_back(math::Vector2f(3.f, 4.f));
-  std::vector<math::Vector3f> vector3fs;
-  vector3fs.push_back(math::Vector3f(1.f, 2.f, 3.f));
-  vector3fs.push_back(math::Vector3f(4.f, 5.f, 6.f));
-  std::vector<math::Vector4f> vector4fs;
-  vector4fs.push_back(math::Vector4f(1.f, 2.f, 3.f, 4.f));
-  vector4fs.push_back(math::Vector4f(5.f, 6.f, 7.f, 8.f));
-  std::vector<math::Matrix2f> matrix2fs;
-  matrix2fs.push_back(math::Matrix2f::Identity());
-  matrix2fs.push_back(math::Matrix2f::Identity());
-  std::vector<math::Matrix3f> matrix3fs;
-  matrix3fs.push_back(math::Matrix3f::Identity());
-  matrix3fs.push_back(math::Matrix3f::Identity());
-  std::vector<math::Matrix4f> matrix4fs;
-  matrix4fs.push_back(math::Matrix4f::Identity());
-  matrix4fs.push_back(math::Matrix4f::Identity());
+  EXPECT_FALSE(renderer->GetNodeVisibilityFunction());
+  renderer->SetNodeVisibilityFunction(IsNotHidden);
+  EXPECT_TRUE(renderer->GetNodeVisibilityFunction());
+  Reset();
+  renderer->DrawScene(root);
+  std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_EQ(std::string::npos, trace.find("[2])"));
 
-  root->AddUniform(CreateArrayUniform(reg, "uIntArray", ints));
-  root->AddUniform(CreateArrayUniform(reg, "uFloatArray", floats));
-  root->AddUniform(CreateArrayUniform(reg, "uIV2Array", vector2is));
-  root->AddUniform(CreateArrayUniform(reg, "uIV3Array", vector3is));
-  root->AddUniform(CreateArrayUniform(reg, "uIV4Array", vector4is));
-  root->AddUniform(CreateArrayUniform(reg, "uFV2Array", vector2fs));
-  root->AddUniform(CreateArrayUniform(reg, "uFV3Array", vector3fs));
-  root->AddUniform(CreateArrayUniform(reg, "uFV4Array", vector4fs));
-  root->AddUniform(CreateArrayUniform(reg, "uMat2Array", matrix2fs));
-  root->AddUniform(CreateArrayUniform(reg, "uMat3Array", matrix3fs));
-  root->AddUniform(CreateArrayUniform(reg, "uMat4Array", matrix4fs));
-  root->AddUniform(CreateArrayUniform(reg, "samplerArray", textures));
-  root->AddUniform(CreateArrayUniform(reg, "cubeSamplerArray", cubemaps));
+  // Draw lists are rebuilt when visibility changes, even if retained.
+  renderer->SetFlag(Renderer::kRetainDrawList);
+  children[0]->SetLabel("hidden");
+  children[1]->SetLabel("");
+  Reset();
+  renderer->DrawScene(root);
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[2])"));
+  EXPECT_EQ(std::string::npos, trace.find("[1])"));
 
+  renderer->SetNodeVisibilityFunction(Renderer::NodeVisibilityFunction());
+  EXPECT_FALSE(renderer->GetNodeVisibilityFunction());
   Reset();
   renderer->DrawScene(root);
-  // Verify all the uniform types were sent.
-  // 1i.
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("Uniform1i("));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1iv("));
-  EXPECT_TRUE(
-      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                        0U, "Uniform1i(")).HasArg(2, "0"));
-  EXPECT_TRUE(
-      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                        1U, "Uniform1i(")).HasArg(2, "1"));
-  // The int uniform.
-  EXPECT_TRUE(
-      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                        0U, "Uniform1iv(")).HasArg(2, "1"));
-  // The int array uniform.
-  EXPECT_TRUE(
-      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                        1U, "Uniform1iv(")).HasArg(2, "2"));
-  // Textures need to be unique.
+  EXPECT_NE(std::string::npos, trace_verifier_->GetTraceString().find("[1])"));
 
-  // The texture array uniform.
-  EXPECT_TRUE(
-      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                        2U, "Uniform1iv(")).HasArg(2, "2"));
-  // The cubemap array uniform.
-  EXPECT_TRUE(
-      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                        3U, "Uniform1iv(")).HasArg(2, "2"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  for (int i = 2; i < 4; ++i) {
-    const std::string f_name =
-        std::string("Uniform") + base::ValueToString(i) + "f";
-    const std::string i_name =
-        std::string("Uniform") + base::ValueToString(i) + "i";
-    const std::string mat_name =
-        std::string("UniformMatrix") + base::ValueToString(i) + "fv";
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf(f_name + "("));
-    EXPECT_EQ(2U, trace_verifier_->GetCountOf(f_name + "v("));
-    EXPECT_TRUE(
-        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                          0U, f_name + "v(")).HasArg(2, "1"));
-    EXPECT_TRUE(
-        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                          1U, f_name + "v(")).HasArg(2, "2"));
+TEST_F(RendererTest, FrustumCulling) {
+  // Test that Nodes whose bounds are outside of the culling frustum are not
+  // drawn.
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
 
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf(i_name + "("));
-    EXPECT_EQ(2U, trace_verifier_->GetCountOf(i_name + "v("));
-    EXPECT_TRUE(
-        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                          0U, i_name + "v(")).HasArg(2, "1"));
-    EXPECT_TRUE(
-        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                          1U, i_name + "v(")).HasArg(2, "2"));
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr program(new ShaderProgram(reg));
+  program->SetLabel("Dummy Shader");
+  program->SetVertexShader(ShaderPtr(new Shader("uniform int uInt;\n")));
+  program->SetFragmentShader(
+      ShaderPtr(new Shader("Dummy Fragment Shader Source")));
 
-    EXPECT_EQ(3U, trace_verifier_->GetCountOf(mat_name));
-    EXPECT_TRUE(
-        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                          0U, mat_name)).HasArg(2, "1"));
-    EXPECT_TRUE(
-        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                          1U, mat_name)).HasArg(2, "1"));
-    EXPECT_TRUE(
-        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                          2U, mat_name)).HasArg(2, "1"));
+  // The first child is inside the unit cube, the second is to its right, and
+  // the third has no bounds.
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  root->SetShaderProgram(program);
+  NodePtr children[3];
+  for (int i = 0; i < 3; ++i) {
+    children[i] = new Node;
+    children[i]->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    children[i]->AddShape(shape);
+    root->AddChild(children[i]);
   }
+  children[0]->SetBounds(math::Range3f(math::Point3f(-0.5f, -0.5f, -0.5f),
+                                       math::Point3f(0.5f, 0.5f, 0.5f)));
+  children[1]->SetBounds(math::Range3f(math::Point3f(2.f, -0.5f, -0.5f),
+                                       math::Point3f(3.f, 0.5f, 0.5f)));
 
+  EXPECT_FALSE(renderer->HasCullingMatrix());
+  renderer->SetCullingMatrix(math::Matrix4f::Identity());
+  EXPECT_TRUE(renderer->HasCullingMatrix());
+  EXPECT_EQ(math::Matrix4f::Identity(), renderer->GetCullingMatrix());
   Reset();
   renderer->DrawScene(root);
-  // Everything should be cached.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform"));
+  std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_EQ(std::string::npos, trace.find("[2])"));
+  EXPECT_NE(std::string::npos, trace.find("[3])"));
 
-  // Ensure that the array textures are evicted.
-  root->SetShaderProgram(program);
-  // Remove attribute array to prevent warnings; we are only testing uniforms
-  // here.
-  root->AddShape(s_data.shape);
+  // Moving the frustum changes which Nodes are culled, also when sorting.
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  renderer->SetCullingMatrix(math::TranslationMatrix(math::Vector3f(-2.f, 0.f,
+                                                                    0.f)));
+  Reset();
+  renderer->DrawScene(root);
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_EQ(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[2])"));
 
-  // These uniforms are the same as those contained by root.
-  s_data.rect->AddUniform(reg->Create<Uniform>("uInt", 13));
-  s_data.rect->AddUniform(reg->Create<Uniform>("uFloat", 1.5f));
-  s_data.rect->AddUniform(
-      reg->Create<Uniform>("uFV2", math::Vector2f(2.f, 3.f)));
-  s_data.rect->AddUniform(
-      reg->Create<Uniform>("uFV3", math::Vector3f(4.f, 5.f, 6.f)));
-  s_data.rect->AddUniform(reg->Create<Uniform>(
-      "uFV4", math::Vector4f(7.f, 8.f, 9.f, 10.f)));
-  s_data.rect->AddUniform(reg->Create<Uniform>("uIV2",
-                                        math::Vector2i(2, 3)));
-  s_data.rect->AddUniform(reg->Create<Uniform>("uIV3",
-                                        math::Vector3i(4, 5, 6)));
-  s_data.rect->AddUniform(reg->Create<Uniform>("uIV4",
-                                        math::Vector4i(7, 8, 9, 10)));
-  s_data.rect->AddUniform(reg->Create<Uniform>("uMat2",
-                                        math::Matrix2f(1.f, 2.f,
-                                                       3.f, 4.f)));
-  s_data.rect->AddUniform(reg->Create<Uniform>("uMat3",
-                                        math::Matrix3f(1.f, 2.f, 3.f,
-                                                       4.f, 5.f, 6.f,
-                                                       7.f, 8.f, 9.f)));
-  s_data.rect->AddUniform(reg->Create<Uniform>("uMat4",
-                                        math::Matrix4f(1.f, 2.f, 3.f, 4.f,
-                                                       5.f, 6.f, 7.f, 8.f,
-                                                       9.f, 1.f, 2.f, 3.f,
-                                                       4.f, 5.f, 6.f, 7.f)));
-  s_data.rect->AddUniform(reg->Create<Uniform>("sampler", s_data.texture));
-  s_data.rect->AddUniform(reg->Create<Uniform>("cubeSampler", s_data.cubemap));
-
-  // Reverse following uniform arrays so they are different than those in root.
-  std::reverse(ints.begin(), ints.end());
-  std::reverse(floats.begin(), floats.end());
-  std::reverse(textures.begin(), textures.end());
-  std::reverse(cubemaps.begin(), cubemaps.end());
-  std::reverse(vector2fs.begin(), vector2fs.end());
-  std::reverse(vector3fs.begin(), vector3fs.end());
-  std::reverse(vector4fs.begin(), vector4fs.end());
-  std::reverse(vector2is.begin(), vector2is.end());
-  std::reverse(vector3is.begin(), vector3is.end());
-  std::reverse(vector4is.begin(), vector4is.end());
-  std::reverse(matrix2fs.begin(), matrix2fs.end());
-  std::reverse(matrix3fs.begin(), matrix3fs.end());
-  std::reverse(matrix4fs.begin(), matrix4fs.end());
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIntArray", ints));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFloatArray", floats));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIV2Array", vector2is));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIV3Array", vector3is));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIV4Array", vector4is));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFV2Array", vector2fs));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFV3Array", vector3fs));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFV4Array", vector4fs));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uMat2Array", matrix2fs));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uMat3Array", matrix3fs));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "uMat4Array", matrix4fs));
-  s_data.rect->AddUniform(CreateArrayUniform(reg, "samplerArray", textures));
-  s_data.rect->AddUniform(
-      CreateArrayUniform(reg, "cubeSamplerArray", cubemaps));
+  // A visibility function is applied to Nodes that are not culled.
+  children[1]->SetLabel("hidden");
+  renderer->SetNodeVisibilityFunction(IsNotHidden);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(std::string::npos, trace_verifier_->GetTraceString().find("[2])"));
+  renderer->SetNodeVisibilityFunction(Renderer::NodeVisibilityFunction());
 
+  renderer->ClearCullingMatrix();
+  EXPECT_FALSE(renderer->HasCullingMatrix());
   Reset();
   renderer->DrawScene(root);
-  // Expect all uniforms to be sent because they have different ids because
-  // now s_data.rect uniforms replace those of root.
-  EXPECT_EQ(25U, trace_verifier_->GetCountOf("Uniform"));
-}
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[2])"));
 
-TEST_F(RendererTest, VertexArraysAndEmulator) {
-  // Test that vertex arrays are enabled and used. Each test needs a fresh
-  // renderer so that resources are initialized from scratch, otherwise
-  // a VertexArrayEmulatorResource will not be created, since the resource
-  // holder will already have a pointer to a VertexArrayResource.
-  NodePtr root;
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  root = BuildGraph(kWidth, kHeight);
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    Reset();
-    renderer->DrawScene(root);
-    // Vertex arrays should be bound. There is only one bind.
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindVertexArray"));
-  }
+TEST_F(RendererTest, LevelOfDetail) {
+  // Test that Nodes with an LOD range are drawn only when the projected size
+  // of their bounds is in the range.
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
 
-  // Use the emulator.
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
-  EXPECT_FALSE(gm_->IsFunctionGroupAvailable(GraphicsManager::kVertexArrays));
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    Reset();
-    renderer->DrawScene(root);
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindVertexArray"));
-    EXPECT_GT(trace_verifier_->GetCountOf("VertexAttribPointer"), 0U);
-  }
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr program(new ShaderProgram(reg));
+  program->SetLabel("Dummy Shader");
+  program->SetVertexShader(ShaderPtr(new Shader("uniform int uInt;\n")));
+  program->SetFragmentShader(
+      ShaderPtr(new Shader("Dummy Fragment Shader Source")));
 
-  // Use vertex arrays.
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    Reset();
-    renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindVertexArray"));
-    // We should not have to rebind the pointers.
-    EXPECT_GT(trace_verifier_->GetCountOf("VertexAttribPointer"), 0U);
+  // Three levels of detail of the same box, which fills half of the view.
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  root->SetShaderProgram(program);
+  const float thresholds[4] = {
+      std::numeric_limits<float>::infinity(), 0.4f, 0.1f, 0.f };
+  NodePtr children[3];
+  for (int i = 0; i < 3; ++i) {
+    children[i] = new Node;
+    children[i]->AddUniform(reg->Create<Uniform>("uInt", i + 1));
+    children[i]->AddShape(shape);
+    children[i]->SetBounds(math::Range3f(math::Point3f(-0.5f, -0.25f, -0.5f),
+                                         math::Point3f(0.5f, 0.25f, 0.5f)));
+    children[i]->SetLodRange(math::Range1f(thresholds[i + 1], thresholds[i]));
+    root->AddChild(children[i]);
   }
-}
-
-TEST_F(RendererTest, VertexArrayEmulatorReuse) {
-  // Test that when reusing the vertex array emulator, the bind calls are only
-  // sent to OpenGL once.
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
-
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  RendererPtr renderer(new Renderer(gm_));
-  Reset();
-  renderer->DrawScene(root);
-  // Vertex arrays are disabled.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindVertexArray"));
-  // There are two buffer attributes bound, 1 index buffer, and 1 data buffer.
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BindBuffer"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
 
-  // Drawing again should only draw the shape again, without rebinding or
-  // enabling the pointers again.
+  // Without a culling matrix only the most detailed level is drawn.
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("VertexAttribPointer"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+  std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_EQ(std::string::npos, trace.find("[2])"));
+  EXPECT_EQ(std::string::npos, trace.find("[3])"));
 
-  // If the same Shape is used in succession, we also shouldn't see rebinds
-  // happen.
-  NodePtr node(new Node);
-  s_data.rect->AddChild(node);
-  node->AddShape(s_data.shape);
+  // Shrinking the box on screen selects coarser levels, also when sorting.
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  renderer->SetCullingMatrix(math::ScaleMatrixH(math::Vector3f(0.5f, 0.5f,
+                                                               0.5f)));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("VertexAttribPointer"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements"));
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_EQ(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[2])"));
+  EXPECT_EQ(std::string::npos, trace.find("[3])"));
 
-  // If we modify an attribute then the entire state will be resent due to the
-  // notification.
-  Attribute* a = s_data.shape->GetAttributeArray()->GetMutableAttribute(0U);
-  a->SetFixedPointNormalized(true);
+  // A box reaching behind the eye has an infinite size.
+  math::Matrix4f behind_eye = math::Matrix4f::Identity();
+  behind_eye(3, 2) = 1.f;
+  behind_eye(3, 3) = 0.f;
+  renderer->SetCullingMatrix(behind_eye);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements"));
-  s_data.rect->RemoveChild(node);
-
-  // If a different Shape is used, then the new one will be sent on the first
-  // draw.
-  ShaderInputRegistryPtr global_reg = ShaderInputRegistry::GetGlobalRegistry();
-  AttributeArrayPtr aa(new AttributeArray);
-  aa->AddAttribute(global_reg->Create<Attribute>(
-      "aVertex", BufferObjectElement(s_data.vertex_buffer,
-                                     s_data.vertex_buffer->AddSpec(
-                                         BufferObject::kFloat, 3, 0))));
-  aa->AddAttribute(global_reg->Create<Attribute>(
-      "aTexCoords",
-      BufferObjectElement(s_data.vertex_buffer,
-                          s_data.vertex_buffer->AddSpec(BufferObject::kFloat, 2,
-                                                        sizeof(float) * 3))));
-  ShapePtr shape(new Shape);
-  shape->SetAttributeArray(aa);
-  s_data.rect->AddShape(shape);
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_EQ(std::string::npos, trace.find("[2])"));
 
+  // The smallest box selects the coarsest level.
+  renderer->ClearFlag(Renderer::kSortDrawsByState);
+  renderer->SetCullingMatrix(math::ScaleMatrixH(math::Vector3f(0.1f, 0.1f,
+                                                               0.1f)));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays"));
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_EQ(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[3])"));
 
-  // Drawing again should rebind both Shapes.
+  // A cleared range draws the Node at any size.
+  children[0]->ClearLodRange();
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("VertexAttribPointer"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays"));
-
-  s_data.rect->RemoveShape(shape);
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
-}
-
-TEST_F(RendererTest, VertexBufferUsage) {
-  // Test vertex buffer usage.
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root;
-  TracingHelper helper;
-
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<BufferObject::UsageMode> verify_data;
-  verify_data.update_func = BuildRectangleBufferObject;
-  verify_data.call_name = "BufferData";
-  verify_data.option = &s_options.vertex_buffer_usage;
-  verify_data.static_args.push_back(StaticArg(1, "GL_ARRAY_BUFFER"));
-  verify_data.static_args.push_back(
-      StaticArg(2, helper.ToString(
-          "GLsizei", static_cast<int>(sizeof(Vertex) * s_num_vertices))));
-  verify_data.static_args.push_back(
-      StaticArg(3, helper.ToString("void*",
-                                   s_data.vertex_container->GetData())));
-  verify_data.varying_arg_index = 4U;
-  verify_data.arg_tests.push_back(
-      VaryingArg<BufferObject::UsageMode>(
-          0, BufferObject::kDynamicDraw, "GL_DYNAMIC_DRAW"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<BufferObject::UsageMode>(
-          0, BufferObject::kStaticDraw, "GL_STATIC_DRAW"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<BufferObject::UsageMode>(
-          0, BufferObject::kStreamDraw, "GL_STREAM_DRAW"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  trace = trace_verifier_->GetTraceString();
+  EXPECT_NE(std::string::npos, trace.find("[1])"));
+  EXPECT_NE(std::string::npos, trace.find("[3])"));
 
-  Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
-TEST_F(RendererTest, VertexBufferNoData) {
-  // Test handling of NULL, nonexistent, or empty buffer object data containers.
+TEST_F(RendererTest, DrawListThreadCount) {
+  // Test that flattening the scene on worker threads draws the same thing as
+  // flattening it on the calling thread.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
   base::LogChecker log_checker;
 
-  Reset();
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec("uInt", kIntUniform, "."));
+  ShaderProgramPtr programs[2];
+  for (int i = 0; i < 2; ++i) {
+    programs[i] = new ShaderProgram(reg);
+    programs[i]->SetLabel("Dummy Shader");
+    programs[i]->SetVertexShader(ShaderPtr(
+        new Shader(i ? "uniform int uInt;\n" : "uniform int uInt;\n\n")));
+    programs[i]->SetFragmentShader(
+        ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  }
+
+  // Build children with grandchildren of alternating programs, and put a
+  // clear in the middle of the scene.
+  ShapePtr shape(new Shape);
+  NodePtr root(new Node);
+  root->SetShaderProgram(programs[0]);
+  root->AddUniform(reg->Create<Uniform>("uInt", 0));
+  root->AddShape(shape);
+  int value = 0;
+  for (int i = 0; i < 4; ++i) {
+    NodePtr child(new Node);
+    child->AddUniform(reg->Create<Uniform>("uInt", ++value));
+    child->AddShape(shape);
+    for (int j = 0; j < 3; ++j) {
+      NodePtr grandchild(new Node);
+      grandchild->SetShaderProgram(programs[j % 2]);
+      grandchild->AddUniform(reg->Create<Uniform>("uInt", ++value));
+      grandchild->AddShape(shape);
+      child->AddChild(grandchild);
+    }
+    root->AddChild(child);
+  }
+  StateTablePtr clear_state(new StateTable);
+  clear_state->SetClearColor(math::Vector4f(0.f, 0.f, 0.f, 1.f));
+  root->GetChildren()[2]->SetStateTable(clear_state);
+
+  EXPECT_EQ(0U, renderer->GetDrawListThreadCount());
+  renderer->SetFlag(Renderer::kSortDrawsByState);
   renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  s_data.vertex_buffer->SetData(base::DataContainerPtr(NULL), sizeof(Vertex),
-                                s_num_vertices, s_options.vertex_buffer_usage);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "DataContainer is NULL"));
+  const std::string serial_trace = trace_verifier_->GetTraceString();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear("));
 
-  Vertex* vertices = new Vertex[2];
-  vertices[0].point_coords.Set(-1, 0,  1);
-  vertices[0].tex_coords.Set(0.f, 1.f);
-  vertices[1].point_coords.Set(1, 0, 1);
-  vertices[1].tex_coords.Set(1.f, 1.f);
-  base::DataContainerPtr data =
-      base::DataContainer::Create<Vertex>(
-          vertices, base::DataContainer::ArrayDeleter<Vertex>, true,
-          s_data.vertex_buffer->GetAllocator());
-  s_data.vertex_buffer->SetData(data, 0U, s_num_vertices,
-                                s_options.vertex_buffer_usage);
+  renderer->SetDrawListThreadCount(3U);
+  EXPECT_EQ(3U, renderer->GetDrawListThreadCount());
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "struct size is 0"));
+  EXPECT_EQ(serial_trace, trace_verifier_->GetTraceString());
 
-  s_data.vertex_buffer->SetData(data, sizeof(vertices[0]), 0U,
-                                s_options.vertex_buffer_usage);
+  // The visibility function is also used by the workers.
+  root->GetChildren()[1]->SetLabel("hidden");
+  renderer->SetNodeVisibilityFunction(IsNotHidden);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "struct count is 0"));
+  const std::string trace = trace_verifier_->GetTraceString();
+  EXPECT_EQ(std::string::npos, trace.find("[6])"));
+  EXPECT_NE(std::string::npos, trace.find("[10])"));
 
-  // Reset data.
-  s_data.rect = NULL;
-  BuildRectangle();
+  renderer->SetDrawListThreadCount(0U);
+  EXPECT_EQ(0U, renderer->GetDrawListThreadCount());
+
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
-TEST_F(RendererTest, VertexBufferSubData) {
-  // Test handling of BufferObject sub-data.
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
+TEST_F(RendererTest, UniformsShareTextureUnits) {
+  // Test that all textures that share the same uniform are bound to the same
+  // texture unit.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  s_data.rect->ClearChildren();
+  s_data.rect->ClearUniforms();
+  s_data.rect->ClearShapes();
+
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uCubeMapTexture", s_data.cubemap));
+
+  // Add many nodes with different textures bound to the same uniform; they
+  // should all share the same image unit.
+  static const int kNumNodes = 9;
+  for (int i = 0; i < kNumNodes; ++i) {
+    NodePtr node(new Node);
+
+    TexturePtr texture(new Texture);
+    texture->SetImage(0U, s_data.image);
+    texture->SetSampler(s_data.sampler);
+    node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+        "uTexture", texture));
+
+    texture = new Texture;
+    texture->SetImage(0U, s_data.image);
+    texture->SetSampler(s_data.sampler);
+    node->AddUniform(
+        s_data.shader->GetRegistry()->Create<Uniform>("uTexture2", texture));
 
+    s_data.rect->AddChild(node);
+  }
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
-
-  Vertex* vertices = new Vertex[2];
-  vertices[0].point_coords.Set(-1, 0,  1);
-  vertices[0].tex_coords.Set(0.f, 1.f);
-  vertices[1].point_coords.Set(1, 0, 1);
-  vertices[1].tex_coords.Set(1.f, 1.f);
-  base::DataContainerPtr sub_data =
-      base::DataContainer::Create<Vertex>(
-          vertices, base::DataContainer::ArrayDeleter<Vertex>, true,
-          s_data.vertex_buffer->GetAllocator());
+  // Nothing should have happened since there are no shapes.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
 
-  math::Range1ui range(0, static_cast<unsigned int>(sizeof(vertices[0]) * 2));
-  s_data.vertex_buffer->SetSubData(range, sub_data);
+  // Add shapes.
+  for (int i = 0; i < kNumNodes; ++i)
+    s_data.rect->GetChildren()[i]->AddShape(s_data.shape);
   Reset();
   renderer->DrawScene(root);
-  // Buffer sub-data does not affect memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 0U, 28672U));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(24U, trace_verifier_->GetCountOf("TexImage2D"));
+  // There should be 19 calls to ActiveTexture: the units will ping-pong; there
+  // is also the cubemap which gets bound.
+  EXPECT_EQ(19U, trace_verifier_->GetCountOf("ActiveTexture"));
+  // The texture uniforms are only sent once.
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(9U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
+  EXPECT_EQ(9U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
 
   // Reset data.
   s_data.rect = NULL;
   BuildRectangle();
 }
 
-TEST_F(RendererTest, IndexBufferUsage) {
-  // Test index buffer usage.
+TEST_F(RendererTest, UniformAreSentCorrectly) {
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+
+  // Dummy shader with the uniforms defined.
+  static const char* kVertexShaderString =
+      "uniform int uInt;\n"
+      "uniform float uFloat;\n"
+      "uniform vec2 uFV2;\n"
+      "uniform vec3 uFV3;\n"
+      "uniform vec4 uFV4;\n"
+      "uniform ivec2 uIV2;\n"
+      "uniform ivec3 uIV3;\n"
+      "uniform ivec4 uIV4;\n"
+      "uniform mat2 uMat2;\n"
+      "uniform mat3 uMat3;\n"
+      "uniform mat4 uMat4;\n";
+
+  // One of each uniform type.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root;
-  TracingHelper helper;
 
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<BufferObject::UsageMode> verify_data;
-  verify_data.update_func = BuildRectangleShape<uint16>;
-  verify_data.call_name = "BufferData";
-  verify_data.option = &s_options.index_buffer_usage;
-  verify_data.static_args.push_back(StaticArg(1, "GL_ELEMENT_ARRAY_BUFFER"));
-  verify_data.static_args.push_back(
-      StaticArg(2, helper.ToString(
-          "GLsizei", static_cast<int>(sizeof(uint16) * s_num_indices))));
-  verify_data.static_args.push_back(
-      StaticArg(3, helper.ToString(
-          "void*", s_data.index_container->GetData())));
-  verify_data.varying_arg_index = 4U;
-  // It's the second call in this case because the vertex buffer is bound first
-  // since this is the initial draw.
-  verify_data.arg_tests.push_back(
-      VaryingArg<BufferObject::UsageMode>(
-          1, BufferObject::kDynamicDraw, "GL_DYNAMIC_DRAW"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<BufferObject::UsageMode>(
-          0, BufferObject::kStaticDraw, "GL_STATIC_DRAW"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<BufferObject::UsageMode>(
-          0, BufferObject::kStreamDraw, "GL_STREAM_DRAW"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  root->ClearUniforms();
+  root->ClearUniformBlocks();
+  UniformBlockPtr block1(new UniformBlock);
+  UniformBlockPtr block2(new UniformBlock);
 
-  Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
-}
+  PopulateUniformValues(s_data.rect, block1, block2, reg, 0);
+  s_data.rect->AddUniformBlock(block1);
+  s_data.rect->AddUniformBlock(block2);
+
+  ShaderProgramPtr program(new ShaderProgram(reg));
+  program->SetLabel("Dummy Shader");
+  program->SetVertexShader(ShaderPtr(new Shader(kVertexShaderString)));
+  program->SetFragmentShader(
+      ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  s_data.rect->SetShaderProgram(program);
+  // Remove attribute array to prevent warnings; we are only testing uniforms
+  // here.
+  s_data.shape->SetAttributeArray(AttributeArrayPtr(NULL));
 
-TEST_F(RendererTest, ProgramAndShaderInfoLogs) {
   {
-    RendererPtr renderer(new Renderer(gm_));
-    NodePtr root = BuildGraph(kWidth, kHeight);;
+    // Verify that the uniforms were sent only once, since there is only one
+    // node.
     Reset();
     renderer->DrawScene(root);
-    // Info logs are empty when there are no errors.
-    EXPECT_EQ("", s_data.shader->GetInfoLog());
-    EXPECT_EQ("", s_data.shader->GetFragmentShader()->GetInfoLog());
-    EXPECT_EQ("", s_data.shader->GetVertexShader()->GetInfoLog());
+    SCOPED_TRACE(__LINE__);
+    VerifyUniformCounts(1U, trace_verifier_);
   }
 
-  VerifyFunctionFailure(gm_, "CompileShader", "Unable to compile");
-  // Check that the info log was set.
-  EXPECT_EQ("Shader compilation is set to always fail.",
-            s_data.shader->GetVertexShader()->GetInfoLog());
-  EXPECT_EQ("Shader compilation is set to always fail.",
-            s_data.shader->GetFragmentShader()->GetInfoLog());
-  EXPECT_EQ("", s_data.shader->GetInfoLog());
-  // Reset data.
-  s_data.rect = NULL;
-  s_data.shader = NULL;
-  BuildRectangle();
+  // Add another identical node with the same shape and uniforms. Since the
+  // uniform values are the same no additional data should be sent to GL.
+  NodePtr node(new Node);
+  s_data.rect->AddChild(node);
+  node->AddShape(s_data.shape);
+  PopulateUniformValues(node, block1, block2, reg, 0);
+  // Add the same uniform blocks.
+  node->AddUniformBlock(block1);
+  node->AddUniformBlock(block2);
+  {
+    Reset();
+    renderer->DrawScene(root);
+    SCOPED_TRACE(__LINE__);
+    VerifyUniformCounts(0U, trace_verifier_);
+  }
 
-  Reset();
-  VerifyFunctionFailure(gm_, "LinkProgram", "Unable to link");
-  // Check that the info log was set.
-  EXPECT_EQ("", s_data.shader->GetVertexShader()->GetInfoLog());
-  EXPECT_EQ("", s_data.shader->GetFragmentShader()->GetInfoLog());
-  EXPECT_EQ("Program linking is set to always fail.",
-            s_data.shader->GetInfoLog());
-}
+  // Use the same uniforms but with different values.
+  PopulateUniformValues(node, block1, block2, reg, 1);
+  {
+    Reset();
+    renderer->DrawScene(root);
+    SCOPED_TRACE(__LINE__);
+    // Verify that the uniforms were sent. Each should be sent once, when the
+    // child node is processed, since the initial values were cached already.
+    VerifyUniformCounts(1U, trace_verifier_);
+  }
 
-TEST_F(RendererTest, FunctionFailures) {
-  // Misc tests for error handling when some functions fail.
-  base::LogChecker log_checker;
+  // Set the same shader in the child node.
+  node->SetShaderProgram(program);
   {
-    RendererPtr renderer(new Renderer(gm_));
-    NodePtr root = BuildGraph(kWidth, kHeight);;
     Reset();
     renderer->DrawScene(root);
+    SCOPED_TRACE(__LINE__);
+    // The uniforms should have been sent twice since the child nodes blew away
+    // the cached values in the last pass; both values will have to be sent this
+    // time.
+    VerifyUniformCounts(2U, trace_verifier_);
   }
-  EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  // Check that Renderer catches failed compilation.
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
-  Reset();
-  VerifyFunctionFailure(gm_, "CompileShader", "Unable to compile");
-  // Check that Renderer catches failed program creation.
-  Reset();
-  VerifyFunctionFailure(gm_, "CreateProgram",
-                        "Unable to create shader program object");
-  // Check that Renderer catches failed shader creation.
-  Reset();
-  VerifyFunctionFailure(gm_, "CreateShader", "Unable to create shader object");
-  // Check that Renderer catches failed linking.
-  Reset();
-  VerifyFunctionFailure(gm_, "LinkProgram", "Unable to link");
+  // Use a different shader for the child node.
+  ShaderProgramPtr program2(new ShaderProgram(reg));
+  program2->SetLabel("Dummy Shader");
+  program2->SetVertexShader(ShaderPtr(new Shader(kVertexShaderString)));
+  program2->SetFragmentShader(
+      ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  node->SetShaderProgram(program2);
+  {
+    Reset();
+    renderer->DrawScene(root);
+    SCOPED_TRACE(__LINE__);
+    // Uniforms will have to be sent twice, once for the first program using
+    // the first set of values, and then again for the second shader.
+    VerifyUniformCounts(2U, trace_verifier_);
+  }
 
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
-  Reset();
-  VerifyFunctionFailure(gm_, "CompileShader", "Unable to compile");
-  // Check that Renderer catches failed program creation.
+  {
+    Reset();
+    renderer->DrawScene(root);
+    SCOPED_TRACE(__LINE__);
+    // Now that both caches are populated no uniforms should be sent.
+    VerifyUniformCounts(0U, trace_verifier_);
+  }
 
-  Reset();
-  VerifyFunctionFailure(gm_, "CreateProgram",
-                        "Unable to create shader program object");
-  // Check that Renderer catches failed shader creation.
-  Reset();
-  VerifyFunctionFailure(gm_, "CreateShader", "Unable to create shader object");
-  // Check that Renderer catches failed linking.
-  Reset();
-  VerifyFunctionFailure(gm_, "LinkProgram", "Unable to link");
-
-  // Check that Renderer catches failed buffer id generation.
-  Reset();
-  VerifyFunctionFailure(gm_, "GenBuffers", "Unable to create buffer");
-  // Check that Renderer catches failed sampler id generation.
-  Reset();
-  VerifyFunctionFailure(gm_, "GenSamplers", "Unable to create sampler");
-  // Check that Renderer catches failed framebuffer id generation.
-  Reset();
-  VerifyFunctionFailure(gm_, "GenFramebuffers", "Unable to create framebuffer");
-  // Check that Renderer catches failed renderbuffer id generation.
-  Reset();
-  VerifyFunctionFailure(gm_, "GenRenderbuffers",
-                       "Unable to create renderbuffer");
-  // Check that Renderer catches failed texture id generation.
-  Reset();
-  VerifyFunctionFailure(gm_, "GenTextures", "Unable to create texture");
-  // Check that Renderer catches failed vertex array id generation.
-  Reset();
-  VerifyFunctionFailure(gm_, "GenVertexArrays",
-                        "Unable to create vertex array");
+  // Reset.
+  s_data.rect = NULL;
+  s_data.shape->SetAttributeArray(s_data.attribute_array);
+  BuildRectangle();
 }
 
-TEST_F(RendererTest, PrimitiveType) {
-  // Test primitive type.
-  NodePtr root;
-  TracingHelper helper;
-  base::LogChecker log_checker;
+TEST_F(RendererTest, SetTextureImageUnitRange) {
+  // Test that all textures that share the same uniform are bound to the same
+  // texture unit.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  s_data.rect->ClearChildren();
+  s_data.rect->ClearUniforms();
+  s_data.rect->ClearShapes();
 
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<Shape::PrimitiveType> verify_data;
-  verify_data.update_func = BuildRectangleShape<uint16>;
-  verify_data.call_name = "DrawElements";
-  verify_data.option = &s_options.primitive_type;
-  verify_data.static_args.push_back(
-      StaticArg(2, helper.ToString("GLsizei", s_num_indices)));
-  verify_data.static_args.push_back(StaticArg(3, "GL_UNSIGNED_SHORT"));
-  verify_data.static_args.push_back(StaticArg(4, "NULL"));
-  verify_data.varying_arg_index = 1U;
-  verify_data.arg_tests.push_back(
-      VaryingArg<Shape::PrimitiveType>(0, Shape::kLines, "GL_LINES"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Shape::PrimitiveType>(
-          0, Shape::kLineLoop, "GL_LINE_LOOP"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Shape::PrimitiveType>(
-          0, Shape::kLineStrip, "GL_LINE_STRIP"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Shape::PrimitiveType>(0, Shape::kPoints, "GL_POINTS"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Shape::PrimitiveType>(0, Shape::kTriangles, "GL_TRIANGLES"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Shape::PrimitiveType>(
-          0, Shape::kTriangleFan, "GL_TRIANGLE_FAN"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Shape::PrimitiveType>(
-          0, Shape::kTriangleStrip, "GL_TRIANGLE_STRIP"));
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    EXPECT_TRUE(
-        VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
-  }
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uCubeMapTexture", s_data.cubemap));
 
-  // Check some corner cases.
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    // Destroy the data in the datacontainer to get an error message.
-    s_data.vertex_container = NULL;
-    // The attribute_array must be destroyed as well to trigger a rebind.
-    s_data.attribute_array = NULL;
-    BuildRectangleAttributeArray();
-    s_data.vertex_buffer->SetData(
-        s_data.vertex_container, sizeof(Vertex), s_num_vertices,
-        s_options.vertex_buffer_usage);
-    Reset();
-    renderer->DrawScene(root);
-    // The buffer object should not be updated.
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
-    EXPECT_TRUE(log_checker.HasMessage("WARNING", "Unable to draw shape"));
-    // Restore the data.
-    BuildRectangleBufferObject();
-    BuildRectangleAttributeArray();
-  }
+  // Add many nodes with different textures bound to the same uniform; they
+  // should all share the same image unit.
+  static const int kNumNodes = 4;
+  for (int i = 0; i < kNumNodes; ++i) {
+    NodePtr node(new Node);
 
-  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
-  RendererPtr renderer(new Renderer(gm_));
-  // Destroy the data in the datacontainer to get an error message.
-  s_data.vertex_container = NULL;
-  // The attribute_array must be destroyed as well to trigger a rebind.
-  s_data.attribute_array = NULL;
-  BuildRectangleAttributeArray();
-  s_data.vertex_buffer->SetData(
-      s_data.vertex_container, sizeof(Vertex), s_num_vertices,
-      s_options.vertex_buffer_usage);
-  Reset();
-  renderer->DrawScene(root);
-  // The buffer object should not be updated.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Unable to draw shape"));
-  // Restore the data.
-  BuildRectangleBufferObject();
-  BuildRectangleAttributeArray();
+    TexturePtr texture(new Texture);
+    texture->SetLabel("Texture_a " + base::ValueToString(i));
+    texture->SetImage(0U, s_data.image);
+    texture->SetSampler(s_data.sampler);
+    node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+        "uTexture", texture));
 
-  // Do the same with the index buffer.
-  s_data.index_container = NULL;
-  s_data.index_buffer->SetData(s_data.index_container, sizeof(uint16),
-                               s_num_indices, s_options.index_buffer_usage);
-  Reset();
-  renderer->DrawScene(root);
-  // The index buffer object should not be updated.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf(
-      "BindBuffer(GL_ELEMENT_ARRAY_BUFFER"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf(
-      "BufferData(GL_ELEMENT_ARRAY_BUFFER"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Unable to draw shape"));
-  // Restore the data.
-  BuildRectangleShape<uint16>();
+    texture = new Texture;
+    texture->SetLabel("Texture_b " + base::ValueToString(i));
+    texture->SetImage(0U, s_data.image);
+    texture->SetSampler(s_data.sampler);
+    node->AddUniform(
+        s_data.shader->GetRegistry()->Create<Uniform>("uTexture2", texture));
 
-  // Check that the shape is not drawn if the IndexBuffer has no indices.
-  s_data.shape->SetIndexBuffer(IndexBufferPtr(new IndexBuffer));
+    s_data.rect->AddChild(node);
+  }
   Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
-  s_data.shape->SetIndexBuffer(s_data.index_buffer);
 
-  // Check that if there are no index buffers then DrawArrays is used. By
-  // default, all vertices should be used.
-  s_data.shape->SetPrimitiveType(Shape::kPoints);
-  s_data.shape->SetIndexBuffer(IndexBufferPtr(NULL));
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 0, 4)"));
-  // Try different vertex range settings.
-  s_data.shape->AddVertexRange(Range1i(1, 3));
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 1, 2)"));
-  s_data.shape->AddVertexRange(Range1i(3, 4));
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 1, 2)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 3, 1)"));
-  s_data.shape->EnableVertexRange(0, false);
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 3, 1)"));
-  s_data.shape->EnableVertexRange(0, true);
+  // Add shapes to force GL calls.
+  for (int i = 0; i < kNumNodes; ++i)
+    s_data.rect->GetChildren()[i]->AddShape(s_data.shape);
+
+  // Use two texture units.
   Reset();
+  renderer->SetTextureImageUnitRange(Range1i(0, 1));
   renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 1, 2)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 3, 1)"));
-  s_data.shape->ClearVertexRanges();
+  EXPECT_EQ(14U, trace_verifier_->GetCountOf("TexImage2D"));
+  // There should be 12 calls to ActiveTexture since we ping pong back and forth
+  // between the two units for three textures. There are 12 binds, and we aren't
+  // starting from 0.
+  EXPECT_EQ(12U, trace_verifier_->GetCountOf("ActiveTexture"));
+  // The texture uniforms are sent exactly once.
+  EXPECT_EQ(12U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
+
+  // Use one texture unit.
   Reset();
+  renderer->SetTextureImageUnitRange(Range1i(0, 0));
   renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 0, 4)"));
-  s_data.shape->SetIndexBuffer(s_data.index_buffer);
+  // The textures are already updated.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  // There should be only one call to ActiveTexture since there is only one
+  // unit.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture"));
+  // The texture uniforms are only sent once, and the first already has the
+  // right value.
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
 
-  // Check that if the shape has no attribute array that it is not drawn.
-  s_data.shape->SetAttributeArray(AttributeArrayPtr(NULL));
+  // Use three texture units.
   Reset();
+  renderer->SetTextureImageUnitRange(Range1i(3, 5));
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
-  s_data.shape->SetAttributeArray(s_data.attribute_array);
+  // The textures are already updated.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  // There should be 9 calls to ActiveTexture since we ping pong back and forth
+  // between the 3 units for 3 textures. The cubemap gets a single unit and
+  // reuses it, while the other textures each requre rebinding.
+  EXPECT_EQ(9U, trace_verifier_->GetCountOf("ActiveTexture"));
+  // The texture uniforms are only sent once since we have exactly the right
+  // number of units.
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE3)"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE4)"));
+  // This is used for the cubemap.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE5)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE6)"));
 
-  Reset();
-  renderer = NULL;
+  // Reset data.
+  s_data.rect = NULL;
+  BuildRectangle();
 }
 
-TEST_F(RendererTest, TextureWithZeroDimensionsAreNotAllocated) {
-  base::LogChecker log_checker;
+TEST_F(RendererTest, ArrayUniforms) {
+  // Add array uniform types to a node and make sure the right functions are
+  // called in the renderer.
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
 
-  // A default scene should render fine.
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    Reset();
-    renderer->DrawScene(root);
-    EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
-  }
+  // Dummy shader with the uniforms defined.
+  static const char* kVertexShaderString =
+      "uniform int uInt;\n"
+      "uniform float uFloat;\n"
+      "uniform vec2 uFV2;\n"
+      "uniform vec3 uFV3;\n"
+      "uniform vec4 uFV4;\n"
+      "uniform ivec2 uIV2;\n"
+      "uniform ivec3 uIV3;\n"
+      "uniform ivec4 uIV4;\n"
+      "uniform mat2 uMat2;\n"
+      "uniform mat3 uMat3;\n"
+      "uniform mat4 uMat4;\n"
+      "uniform sampler2D sampler;\n"
+      "uniform samplerCube cubeSampler;\n"
+      "uniform int uIntArray[2];\n"
+      "uniform float uFloatArray[2];\n"
+      "uniform vec2 uFV2Array[2];\n"
+      "uniform vec3 uFV3Array[3];\n"
+      "uniform vec4 uFV4Array[4];\n"
+      "uniform ivec2 uIV2Array[2];\n"
+      "uniform ivec3 uIV3Array[3];\n"
+      "uniform ivec4 uIV4Array[4];\n"
+      "uniform mat2 uMat2Array[2];\n"
+      "uniform mat3 uMat3Array[3];\n"
+      "uniform mat4 uMat4Array[4];\n"
+      "uniform sampler2D samplerArray[2];\n"
+      "uniform samplerCube cubeSamplerArray[2];\n";
 
-  s_data.image->Set(s_options.image_format, 0, 0, base::DataContainerPtr());
-  SetImages();
+  // One of each uniform type.
+  RendererPtr renderer(new Renderer(gm_));
 
-  Reset();
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    Reset();
-    renderer->DrawScene(root);
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  }
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  root->ClearUniforms();
+  root->ClearUniformBlocks();
+  s_data.rect->ClearUniforms();
+  s_data.rect->ClearUniformBlocks();
 
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  Build2dImage();
-}
+  // add all the uniforms here
+  ShaderProgramPtr program(new ShaderProgram(reg));
+  program->SetLabel("Dummy Shader");
+  program->SetVertexShader(ShaderPtr(new Shader(kVertexShaderString)));
+  program->SetFragmentShader(
+      ShaderPtr(new Shader("Dummy Fragment Shader Source")));
+  s_data.rect->SetShaderProgram(program);
+  // Remove attribute array to prevent warnings; we are only testing uniforms
+  // here.
+  s_data.shape->SetAttributeArray(AttributeArrayPtr(NULL));
 
-TEST_F(RendererTest, Texture3dWarningsWhenDisabled) {
-  RendererPtr renderer(new Renderer(gm_));
-  base::LogChecker log_checker;
+  root->AddUniform(reg->Create<Uniform>("uInt", 13));
+  root->AddUniform(reg->Create<Uniform>("uFloat", 1.5f));
+  root->AddUniform(
+      reg->Create<Uniform>("uFV2", math::Vector2f(2.f, 3.f)));
+  root->AddUniform(
+      reg->Create<Uniform>("uFV3", math::Vector3f(4.f, 5.f, 6.f)));
+  root->AddUniform(reg->Create<Uniform>(
+      "uFV4", math::Vector4f(7.f, 8.f, 9.f, 10.f)));
+  root->AddUniform(reg->Create<Uniform>("uIV2",
+                                        math::Vector2i(2, 3)));
+  root->AddUniform(reg->Create<Uniform>("uIV3",
+                                        math::Vector3i(4, 5, 6)));
+  root->AddUniform(reg->Create<Uniform>("uIV4",
+                                        math::Vector4i(7, 8, 9, 10)));
+  root->AddUniform(reg->Create<Uniform>("uMat2",
+                                        math::Matrix2f(1.f, 2.f,
+                                                       3.f, 4.f)));
+  root->AddUniform(reg->Create<Uniform>("uMat3",
+                                        math::Matrix3f(1.f, 2.f, 3.f,
+                                                       4.f, 5.f, 6.f,
+                                                       7.f, 8.f, 9.f)));
+  root->AddUniform(reg->Create<Uniform>("uMat4",
+                                        math::Matrix4f(1.f, 2.f, 3.f, 4.f,
+                                                       5.f, 6.f, 7.f, 8.f,
+                                                       9.f, 1.f, 2.f, 3.f,
+                                                       4.f, 5.f, 6.f, 7.f)));
+  root->AddUniform(reg->Create<Uniform>("sampler", s_data.texture));
+  root->AddUniform(reg->Create<Uniform>("cubeSampler", s_data.cubemap));
 
-  // A default scene should render fine.
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
+  TexturePtr texture1(new Texture);
+  texture1->SetImage(0U, s_data.image);
+  texture1->SetSampler(s_data.sampler);
+  TexturePtr texture2(new Texture);
+  texture2->SetImage(0U, s_data.image);
+  texture2->SetSampler(s_data.sampler);
+  CubeMapTexturePtr cubemap1(new CubeMapTexture);
+  cubemap1->SetSampler(s_data.sampler);
+  CubeMapTexturePtr cubemap2(new CubeMapTexture);
+  cubemap2->SetSampler(s_data.sampler);  for (int i = 0; i < 6; ++i) {
+    cubemap1->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
+                       s_data.image);
+    cubemap2->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
+                       s_data.image);
+  }
 
-  // Using a 3D image should be no problem if the function group is available.
-  Build3dImage();
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_LT(0U, trace_verifier_->GetCountOf("TexImage3D"));
+  std::vector<int> ints;
+  ints.push_back(1);
+  ints.push_back(2);
+  std::vector<float> floats;
+  floats.push_back(1.f);
+  floats.push_back(2.f);
+  std::vector<TexturePtr> textures;
+  textures.push_back(texture1);
+  textures.push_back(texture2);
+  std::vector<CubeMapTexturePtr> cubemaps;
+  cubemaps.push_back(cubemap1);
+  cubemaps.push_back(cubemap2);
+  std::vector<math::Vector2i> vector2is;
+  vector2is.push_back(math::Vector2i(1, 2));
+  vector2is.push_back(math::Vector2i(3, 4));
+  std::vector<math::Vector3i> vector3is;
+  vector3is.push_back(math::Vector3i(1, 2, 3));
+  vector3is.push_back(math::Vector3i(4, 5, 6));
+  std::vector<math::Vector4i> vector4is;
+  vector4is.push_back(math::Vector4i(1, 2, 3, 4));
+  vector4is.push_back(math::Vector4i(5, 6, 7, 8));
+  std::vector<math::Vector2f> vector2fs;
+  vector2fs.push_back(math::Vector2f(1.f, 2.f));
+  vector2fs.push_back(math::Vector2f(3.f, 4.f));
+  std::vector<math::Vector3f> vector3fs;
+  vector3fs.push_back(math::Vector3f(1.f, 2.f, 3.f));
+  vector3fs.push_back(math::Vector3f(4.f, 5.f, 6.f));
+  std::vector<math::Vector4f> vector4fs;
+  vector4fs.push_back(math::Vector4f(1.f, 2.f, 3.f, 4.f));
+  vector4fs.push_back(math::Vector4f(5.f, 6.f, 7.f, 8.f));
+  std::vector<math::Matrix2f> matrix2fs;
+  matrix2fs.push_back(math::Matrix2f::Identity());
+  matrix2fs.push_back(math::Matrix2f::Identity());
+  std::vector<math::Matrix3f> matrix3fs;
+  matrix3fs.push_back(math::Matrix3f::Identity());
+  matrix3fs.push_back(math::Matrix3f::Identity());
+  std::vector<math::Matrix4f> matrix4fs;
+  matrix4fs.push_back(math::Matrix4f::Identity());
+  matrix4fs.push_back(math::Matrix4f::Identity());
 
-  // Without the function group we get an error.
-  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, false);
-  Build3dImage();
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "3D texturing is not supported"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage3D"));
+  root->AddUniform(CreateArrayUniform(reg, "uIntArray", ints));
+  root->AddUniform(CreateArrayUniform(reg, "uFloatArray", floats));
+  root->AddUniform(CreateArrayUniform(reg, "uIV2Array", vector2is));
+  root->AddUniform(CreateArrayUniform(reg, "uIV3Array", vector3is));
+  root->AddUniform(CreateArrayUniform(reg, "uIV4Array", vector4is));
+  root->AddUniform(CreateArrayUniform(reg, "uFV2Array", vector2fs));
+  root->AddUniform(CreateArrayUniform(reg, "uFV3Array", vector3fs));
+  root->AddUniform(CreateArrayUniform(reg, "uFV4Array", vector4fs));
+  root->AddUniform(CreateArrayUniform(reg, "uMat2Array", matrix2fs));
+  root->AddUniform(CreateArrayUniform(reg, "uMat3Array", matrix3fs));
+  root->AddUniform(CreateArrayUniform(reg, "uMat4Array", matrix4fs));
+  root->AddUniform(CreateArrayUniform(reg, "samplerArray", textures));
+  root->AddUniform(CreateArrayUniform(reg, "cubeSamplerArray", cubemaps));
 
-  s_options.image_format = Image::kDxt5;
-  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, true);
-  Build3dImage();
   Reset();
   renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_LT(0U, trace_verifier_->GetCountOf("CompressedTexImage3D"));
+  // Verify all the uniform types were sent.
+  // 1i.
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("Uniform1i("));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1iv("));
+  EXPECT_TRUE(
+      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                        0U, "Uniform1i(")).HasArg(2, "0"));
+  EXPECT_TRUE(
+      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                        1U, "Uniform1i(")).HasArg(2, "1"));
+  // The int uniform.
+  EXPECT_TRUE(
+      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                        0U, "Uniform1iv(")).HasArg(2, "1"));
+  // The int array uniform.
+  EXPECT_TRUE(
+      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                        1U, "Uniform1iv(")).HasArg(2, "2"));
+  // Textures need to be unique.
 
-  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, false);
-  Build3dImage();
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "3D texturing is not supported"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("CompressedTexImage3D"));
+  // The texture array uniform.
+  EXPECT_TRUE(
+      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                        2U, "Uniform1iv(")).HasArg(2, "2"));
+  // The cubemap array uniform.
+  EXPECT_TRUE(
+      trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                        3U, "Uniform1iv(")).HasArg(2, "2"));
 
-  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, true);
-}
+  for (int i = 2; i < 4; ++i) {
+    const std::string f_name =
+        std::string("Uniform") + base::ValueToString(i) + "f";
+    const std::string i_name =
+        std::string("Uniform") + base::ValueToString(i) + "i";
+    const std::string mat_name =
+        std::string("UniformMatrix") + base::ValueToString(i) + "fv";
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf(f_name + "("));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf(f_name + "v("));
+    EXPECT_TRUE(
+        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                          0U, f_name + "v(")).HasArg(2, "1"));
+    EXPECT_TRUE(
+        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                          1U, f_name + "v(")).HasArg(2, "2"));
 
-TEST_F(RendererTest, TextureTargets) {
-  RendererPtr renderer(new Renderer(gm_));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf(i_name + "("));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf(i_name + "v("));
+    EXPECT_TRUE(
+        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                          0U, i_name + "v(")).HasArg(2, "1"));
+    EXPECT_TRUE(
+        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                          1U, i_name + "v(")).HasArg(2, "2"));
 
-  // Test usage of TexImage2D.
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  Reset();
-  renderer->DrawScene(root);
+    EXPECT_EQ(3U, trace_verifier_->GetCountOf(mat_name));
+    EXPECT_TRUE(
+        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                          0U, mat_name)).HasArg(2, "1"));
+    EXPECT_TRUE(
+        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                          1U, mat_name)).HasArg(2, "1"));
+    EXPECT_TRUE(
+        trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                          2U, mat_name)).HasArg(2, "1"));
+  }
 
-  Build1dArrayImage();
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_1D_ARRAY"));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE"));
+  // Everything should be cached.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform"));
 
-  Build2dImage();
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D, "));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE"));
+  // Ensure that the array textures are evicted.
+  root->SetShaderProgram(program);
+  // Remove attribute array to prevent warnings; we are only testing uniforms
+  // here.
+  root->AddShape(s_data.shape);
 
-  Build2dArrayImage();
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_2D_ARRAY"));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_CUBE"));
+  // These uniforms are the same as those contained by root.
+  s_data.rect->AddUniform(reg->Create<Uniform>("uInt", 13));
+  s_data.rect->AddUniform(reg->Create<Uniform>("uFloat", 1.5f));
+  s_data.rect->AddUniform(
+      reg->Create<Uniform>("uFV2", math::Vector2f(2.f, 3.f)));
+  s_data.rect->AddUniform(
+      reg->Create<Uniform>("uFV3", math::Vector3f(4.f, 5.f, 6.f)));
+  s_data.rect->AddUniform(reg->Create<Uniform>(
+      "uFV4", math::Vector4f(7.f, 8.f, 9.f, 10.f)));
+  s_data.rect->AddUniform(reg->Create<Uniform>("uIV2",
+                                        math::Vector2i(2, 3)));
+  s_data.rect->AddUniform(reg->Create<Uniform>("uIV3",
+                                        math::Vector3i(4, 5, 6)));
+  s_data.rect->AddUniform(reg->Create<Uniform>("uIV4",
+                                        math::Vector4i(7, 8, 9, 10)));
+  s_data.rect->AddUniform(reg->Create<Uniform>("uMat2",
+                                        math::Matrix2f(1.f, 2.f,
+                                                       3.f, 4.f)));
+  s_data.rect->AddUniform(reg->Create<Uniform>("uMat3",
+                                        math::Matrix3f(1.f, 2.f, 3.f,
+                                                       4.f, 5.f, 6.f,
+                                                       7.f, 8.f, 9.f)));
+  s_data.rect->AddUniform(reg->Create<Uniform>("uMat4",
+                                        math::Matrix4f(1.f, 2.f, 3.f, 4.f,
+                                                       5.f, 6.f, 7.f, 8.f,
+                                                       9.f, 1.f, 2.f, 3.f,
+                                                       4.f, 5.f, 6.f, 7.f)));
+  s_data.rect->AddUniform(reg->Create<Uniform>("sampler", s_data.texture));
+  s_data.rect->AddUniform(reg->Create<Uniform>("cubeSampler", s_data.cubemap));
+
+  // Reverse following uniform arrays so they are different than those in root.
+  std::reverse(ints.begin(), ints.end());
+  std::reverse(floats.begin(), floats.end());
+  std::reverse(textures.begin(), textures.end());
+  std::reverse(cubemaps.begin(), cubemaps.end());
+  std::reverse(vector2fs.begin(), vector2fs.end());
+  std::reverse(vector3fs.begin(), vector3fs.end());
+  std::reverse(vector4fs.begin(), vector4fs.end());
+  std::reverse(vector2is.begin(), vector2is.end());
+  std::reverse(vector3is.begin(), vector3is.end());
+  std::reverse(vector4is.begin(), vector4is.end());
+  std::reverse(matrix2fs.begin(), matrix2fs.end());
+  std::reverse(matrix3fs.begin(), matrix3fs.end());
+  std::reverse(matrix4fs.begin(), matrix4fs.end());
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIntArray", ints));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFloatArray", floats));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIV2Array", vector2is));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIV3Array", vector3is));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uIV4Array", vector4is));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFV2Array", vector2fs));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFV3Array", vector3fs));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uFV4Array", vector4fs));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uMat2Array", matrix2fs));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uMat3Array", matrix3fs));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "uMat4Array", matrix4fs));
+  s_data.rect->AddUniform(CreateArrayUniform(reg, "samplerArray", textures));
+  s_data.rect->AddUniform(
+      CreateArrayUniform(reg, "cubeSamplerArray", cubemaps));
 
-  Build3dImage();
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_3D, "));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_CUBE"));
+  // The s_data.rect uniforms replace those of root, but only those whose
+  // values differ are sent: the reversed arrays of distinct values. The
+  // matrix arrays are all identities, and the textures are in the same units.
+  EXPECT_EQ(8U, trace_verifier_->GetCountOf("Uniform"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UniformMatrix"));
+}
+
+TEST_F(RendererTest, VertexArraysAndEmulator) {
+  // Test that vertex arrays are enabled and used. Each test needs a fresh
+  // renderer so that resources are initialized from scratch, otherwise
+  // a VertexArrayEmulatorResource will not be created, since the resource
+  // holder will already have a pointer to a VertexArrayResource.
+  NodePtr root;
 
+  root = BuildGraph(kWidth, kHeight);
   {
-    base::LogChecker log_checker;
-    BuildExternalEglImage();
+    RendererPtr renderer(new Renderer(gm_));
     Reset();
     renderer->DrawScene(root);
-    EXPECT_EQ(7U, trace_verifier_->GetCountOf(
-                      "EGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, "));
-    EXPECT_TRUE(log_checker.HasMessage("WARNING", "number of components"));
+    // Vertex arrays should be bound. There is only one bind.
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindVertexArray"));
   }
 
-  BuildEglImage();
+  // Use the emulator.
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
+  EXPECT_FALSE(gm_->IsFunctionGroupAvailable(GraphicsManager::kVertexArrays));
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindVertexArray"));
+    EXPECT_GT(trace_verifier_->GetCountOf("VertexAttribPointer"), 0U);
+  }
+
+  // Use vertex arrays.
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindVertexArray"));
+    // We should not have to rebind the pointers.
+    EXPECT_GT(trace_verifier_->GetCountOf("VertexAttribPointer"), 0U);
+  }
+}
+
+TEST_F(RendererTest, VertexArrayEmulatorReuse) {
+  // Test that when reusing the vertex array emulator, the bind calls are only
+  // sent to OpenGL once.
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
+
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  RendererPtr renderer(new Renderer(gm_));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(7U, trace_verifier_->GetCountOf(
-                    "EGLImageTargetTexture2DOES(GL_TEXTURE_2D, "));
-  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, true);
+  // Vertex arrays are disabled.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindVertexArray"));
+  // There are two buffer attributes bound, 1 index buffer, and 1 data buffer.
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BindBuffer"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+
+  // Drawing again should only draw the shape again, without rebinding or
+  // enabling the pointers again.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+
+  // If the same Shape is used in succession, we also shouldn't see rebinds
+  // happen.
+  NodePtr node(new Node);
+  s_data.rect->AddChild(node);
+  node->AddShape(s_data.shape);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements"));
+
+  // If we modify an attribute then the entire state will be resent due to the
+  // notification.
+  Attribute* a = s_data.shape->GetAttributeArray()->GetMutableAttribute(0U);
+  a->SetFixedPointNormalized(true);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements"));
+  s_data.rect->RemoveChild(node);
+
+  // If a different Shape is used, then the new one will be sent on the first
+  // draw.
+  ShaderInputRegistryPtr global_reg = ShaderInputRegistry::GetGlobalRegistry();
+  AttributeArrayPtr aa(new AttributeArray);
+  aa->AddAttribute(global_reg->Create<Attribute>(
+      "aVertex", BufferObjectElement(s_data.vertex_buffer,
+                                     s_data.vertex_buffer->AddSpec(
+                                         BufferObject::kFloat, 3, 0))));
+  aa->AddAttribute(global_reg->Create<Attribute>(
+      "aTexCoords",
+      BufferObjectElement(s_data.vertex_buffer,
+                          s_data.vertex_buffer->AddSpec(BufferObject::kFloat, 2,
+                                                        sizeof(float) * 3))));
+  ShapePtr shape(new Shape);
+  shape->SetAttributeArray(aa);
+  s_data.rect->AddShape(shape);
+
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays"));
+
+  // Drawing again should rebind both Shapes.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays"));
+
+  s_data.rect->RemoveShape(shape);
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
 }
 
-TEST_F(RendererTest, ImageFormat) {
-  // Test image format usage.
+TEST_F(RendererTest, VertexBufferUsage) {
+  // Test vertex buffer usage.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
+  NodePtr root;
   TracingHelper helper;
-  base::LogChecker log_checker;
 
-  // Save image dimensions.
-  const uint32 width_2d = s_data.image->GetWidth();
-  const uint32 height_2d = s_data.image->GetHeight();
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<BufferObject::UsageMode> verify_data;
+  verify_data.update_func = BuildRectangleBufferObject;
+  verify_data.call_name = "BufferData";
+  verify_data.option = &s_options.vertex_buffer_usage;
+  verify_data.static_args.push_back(StaticArg(1, "GL_ARRAY_BUFFER"));
+  verify_data.static_args.push_back(
+      StaticArg(2, helper.ToString(
+          "GLsizei", static_cast<int>(sizeof(Vertex) * s_num_vertices))));
+  verify_data.static_args.push_back(
+      StaticArg(3, helper.ToString("void*",
+                                   s_data.vertex_container->GetData())));
+  verify_data.varying_arg_index = 4U;
+  verify_data.arg_tests.push_back(
+      VaryingArg<BufferObject::UsageMode>(
+          0, BufferObject::kDynamicDraw, "GL_DYNAMIC_DRAW"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<BufferObject::UsageMode>(
+          0, BufferObject::kStaticDraw, "GL_STATIC_DRAW"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<BufferObject::UsageMode>(
+          0, BufferObject::kStreamDraw, "GL_STREAM_DRAW"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
 
-  Build3dImage();
-  const uint32 width_3d = s_data.image->GetWidth();
-  const uint32 height_3d = s_data.image->GetHeight();
-  const uint32 depth_3d = s_data.image->GetDepth();
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
 
-  // Test usage of TexImage2D.
-  VerifyRenderData<Image::Format> verify_2d_data;
-  verify_2d_data.update_func = Build2dImage;
-  verify_2d_data.option = &s_options.image_format;
-  verify_2d_data.call_name = "TexImage2D";
-  verify_2d_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
-  verify_2d_data.static_args.push_back(StaticArg(2, "0"));
-  verify_2d_data.static_args.push_back(
-      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_2d))));
-  verify_2d_data.static_args.push_back(StaticArg(
-      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_2d))));
-  verify_2d_data.static_args.push_back(StaticArg(7, "0"));  // Format.
-  verify_2d_data.static_args.push_back(StaticArg(8, "0"));  // Type.
-  verify_2d_data.static_args.push_back(
-      StaticArg(9, helper.ToString(
-          "void*", s_data.image_container->GetData())));
-  verify_2d_data.varying_arg_index = 3U;
+TEST_F(RendererTest, VertexBufferNoData) {
+  // Test handling of NULL, nonexistent, or empty buffer object data containers.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
 
-  // Test usage of TexImage3D.
-  VerifyRenderData<Image::Format> verify_3d_data;
-  verify_3d_data.update_func = Build3dImage;
-  verify_3d_data.option = &s_options.image_format;
-  verify_3d_data.call_name = "TexImage3D";
-  verify_3d_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_3D"));
-  verify_3d_data.static_args.push_back(StaticArg(2, "0"));
-  verify_3d_data.static_args.push_back(
-      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_3d))));
-  verify_3d_data.static_args.push_back(StaticArg(
-      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_3d))));
-  verify_3d_data.static_args.push_back(
-      StaticArg(6, helper.ToString("GLsizei", static_cast<GLsizei>(depth_3d))));
-  verify_3d_data.static_args.push_back(StaticArg(8, "0"));  // Format.
-  verify_3d_data.static_args.push_back(StaticArg(9, "0"));  // Type.
-  verify_3d_data.static_args.push_back(
-      StaticArg(10, helper.ToString(
-          "void*", s_data.image_container->GetData())));
-  verify_3d_data.varying_arg_index = 3U;
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  s_data.vertex_buffer->SetData(base::DataContainerPtr(NULL), sizeof(Vertex),
+                                s_num_vertices, s_options.vertex_buffer_usage);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "DataContainer is NULL"));
 
-  int last_component_count = 0;
-  for (uint32 i = 0; i < Image::kNumFormats - 1U; ++i) {
-    const Image::Format format = static_cast<Image::Format>(i);
-    if (!Image::IsCompressedFormat(format)) {
-      const Image::PixelFormat& pf = Image::GetPixelFormat(format);
-      if (pf.internal_format != GL_STENCIL_INDEX8) {
-        verify_2d_data.static_args[4] =
-            StaticArg(7, helper.ToString("GLenum", pf.format));
-        verify_2d_data.static_args[5] =
-            StaticArg(8, helper.ToString("GLenum", pf.type));
-        verify_3d_data.static_args[5] =
-            StaticArg(8, helper.ToString("GLenum", pf.format));
-        verify_3d_data.static_args[6] =
-            StaticArg(9, helper.ToString("GLenum", pf.type));
-        verify_2d_data.arg_tests.clear();
-        verify_3d_data.arg_tests.clear();
-        VaryingArg<Image::Format> arg = VaryingArg<Image::Format>(
-            0, format, helper.ToString("GLenum", pf.internal_format));
-        verify_2d_data.arg_tests.push_back(arg);
-        verify_3d_data.arg_tests.push_back(arg);
-        EXPECT_TRUE(
-            VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
-        const int component_count = Image::GetNumComponentsForFormat(format);
-        if (last_component_count && component_count < last_component_count) {
-          EXPECT_TRUE(log_checker.HasMessage(
-              "WARNING", "the number of components for this upload is"));
-        } else {
-          EXPECT_FALSE(log_checker.HasAnyMessages());
-        }
-        EXPECT_TRUE(
-            VerifyRenderCalls(verify_3d_data, trace_verifier_, renderer, root));
-        EXPECT_FALSE(log_checker.HasAnyMessages());
-        last_component_count = component_count;
-      }
-    }
-  }
+  Vertex* vertices = new Vertex[2];
+  vertices[0].point_coords.Set(-1, 0,  1);
+  vertices[0].tex_coords.Set(0.f, 1.f);
+  vertices[1].point_coords.Set(1, 0, 1);
+  vertices[1].tex_coords.Set(1.f, 1.f);
+  base::DataContainerPtr data =
+      base::DataContainer::Create<Vertex>(
+          vertices, base::DataContainer::ArrayDeleter<Vertex>, true,
+          s_data.vertex_buffer->GetAllocator());
+  s_data.vertex_buffer->SetData(data, 0U, s_num_vertices,
+                                s_options.vertex_buffer_usage);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "struct size is 0"));
 
-  // Test deprecation of luminance and luminance-alpha textures on newer desktop
-  // GL. In the following paragraph, static_args[4] corresponds to the pixel
-  // format (the 7th arg to glTexImage2D), and arg_tests[0] corresponds to the
-  // internal format (the 3rd arg to glTexImage2D).
-  verify_2d_data.static_args[5] = StaticArg(8, "GL_UNSIGNED_BYTE");
+  s_data.vertex_buffer->SetData(data, sizeof(vertices[0]), 0U,
+                                s_options.vertex_buffer_usage);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "struct count is 0"));
 
-  // Luminance remains luminance in OpenGL 2.9.
-  gm_->SetVersionString("2.9 Ion OpenGL");
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(0, Image::kLuminance, "GL_LUMINANCE");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+  // Reset data.
+  s_data.rect = NULL;
+  BuildRectangle();
+}
 
-  // R8 becomes luminance in OpenGL 2.9.
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(0, Image::kR8, "GL_LUMINANCE");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+TEST_F(RendererTest, VertexBufferSubData) {
+  // Test handling of BufferObject sub-data.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
 
-  // Luminance becomes R8 in OpenGL 3.0.
-  gm_->SetVersionString("3.0 Ion OpenGL");
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(0, Image::kLuminance, "GL_R8");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_RED");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
 
-  // R8 remains R8 in OpenGL 3.0.
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(0, Image::kR8, "GL_R8");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_RED");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+  Vertex* vertices = new Vertex[2];
+  vertices[0].point_coords.Set(-1, 0,  1);
+  vertices[0].tex_coords.Set(0.f, 1.f);
+  vertices[1].point_coords.Set(1, 0, 1);
+  vertices[1].tex_coords.Set(1.f, 1.f);
+  base::DataContainerPtr sub_data =
+      base::DataContainer::Create<Vertex>(
+          vertices, base::DataContainer::ArrayDeleter<Vertex>, true,
+          s_data.vertex_buffer->GetAllocator());
 
-  // Luminance/alpha remains luminance/alpha in OpenGL 2.9.
-  gm_->SetVersionString("2.9 Ion OpenGL");
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(
-          0, Image::kLuminanceAlpha, "GL_LUMINANCE_ALPHA");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE_ALPHA");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+  math::Range1ui range(0, static_cast<unsigned int>(sizeof(vertices[0]) * 2));
+  s_data.vertex_buffer->SetSubData(range, sub_data);
+  Reset();
+  renderer->DrawScene(root);
+  // Buffer sub-data does not affect memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 0U, 28672U));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
 
-  // RG8 becomes luminance/alpha in OpenGL 2.9.
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(0, Image::kRg8, "GL_LUMINANCE_ALPHA");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE_ALPHA");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+  // Reset data.
+  s_data.rect = NULL;
+  BuildRectangle();
+}
 
-  // Luminance/alpha becomes RG8 in OpenGL 3.0.
-  gm_->SetVersionString("3.0 Ion OpenGL");
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(0, Image::kLuminanceAlpha, "GL_RG8");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_RG");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+TEST_F(RendererTest, CoalescedBufferSubData) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  renderer->DrawScene(root);
+  BufferObjectPtr vb = s_data.vertex_buffer;
+  const uint32 kSize = static_cast<uint32>(sizeof(Vertex));
+  const auto make_data = [&vb](uint8 value, size_t size) {
+    std::vector<uint8> bytes(size, value);
+    return base::DataContainer::CreateAndCopy<uint8>(
+        &bytes[0], size, true, vb->GetAllocator());
+  };
 
-  // RG8 remains RG8 in OpenGL 3.0.
-  verify_2d_data.arg_tests[0] =
-      VaryingArg<Image::Format>(0, Image::kRg8, "GL_RG8");
-  verify_2d_data.static_args[4] = StaticArg(7, "GL_RG");
-  EXPECT_TRUE(
-      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+  // Overlapping and adjacent ranges are uploaded with a single call, and later
+  // sub-data overwrites earlier sub-data.
+  vb->SetSubData(math::Range1ui(kSize, 2U * kSize), make_data(1U, kSize));
+  vb->SetSubData(math::Range1ui(0U, kSize), make_data(2U, kSize));
+  vb->SetSubData(math::Range1ui(kSize / 2U, kSize + kSize / 2U),
+                 make_data(3U, kSize));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "BufferSubData"))
+                  .HasArg(2, "0").HasArg(3, "40"));
+  EXPECT_TRUE(vb->GetSubData().empty());
+  gm_->BindBuffer(GL_ARRAY_BUFFER, renderer->GetResourceGlId(vb.Get()));
+  const uint8* contents =
+      static_cast<const uint8*>(gm_->MapBuffer(GL_ARRAY_BUFFER, GL_READ_ONLY));
+  ASSERT_TRUE(contents);
+  EXPECT_EQ(2U, contents[0]);
+  EXPECT_EQ(3U, contents[kSize / 2U]);
+  EXPECT_EQ(3U, contents[kSize + kSize / 2U - 1U]);
+  EXPECT_EQ(1U, contents[kSize + kSize / 2U]);
+  gm_->UnmapBuffer(GL_ARRAY_BUFFER);
+
+  // Separate ranges are uploaded separately unless the gap is bridged.
+  vb->SetSubData(math::Range1ui(0U, kSize), make_data(4U, kSize));
+  vb->SetSubData(math::Range1ui(2U * kSize, 3U * kSize), make_data(5U, kSize));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
+  vb->SetSubDataMergeGap(kSize);
+  EXPECT_EQ(kSize, vb->GetSubDataMergeGap());
+  vb->SetSubData(math::Range1ui(0U, kSize), make_data(4U, kSize));
+  vb->SetSubData(math::Range1ui(2U * kSize, 3U * kSize), make_data(5U, kSize));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "BufferSubData"))
+                  .HasArg(2, "0").HasArg(3, "60"));
+  vb->SetSubDataMergeGap(0U);
 
-  gm_->SetVersionString("3.3 Ion OpenGL / ES");
+  // Sub-data covering all of the data replaces it.
+  vb->SetSubData(math::Range1ui(0U, 2U * kSize), make_data(6U, 2U * kSize));
+  vb->SetSubData(math::Range1ui(2U * kSize, 4U * kSize),
+                 make_data(7U, 2U * kSize));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
 
-  // Test compressed formats.
-  Image::Format compressed_formats[] = {
-      Image::kDxt1, Image::kEtc1,        Image::kPvrtc1Rgb4,
-      Image::kDxt5, Image::kPvrtc1Rgba2, Image::kPvrtc1Rgba4};
-  const int num_compressed_formats =
-      static_cast<int>(arraysize(compressed_formats));
+  // A lower fraction replaces the data once enough of it has changed.
+  EXPECT_EQ(1.f, vb->GetSubDataReplaceFraction());
+  vb->SetSubDataReplaceFraction(0.5f);
+  vb->SetSubData(math::Range1ui(0U, kSize), make_data(8U, kSize));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  vb->SetSubData(math::Range1ui(0U, kSize), make_data(8U, kSize));
+  vb->SetSubData(math::Range1ui(3U * kSize, 4U * kSize), make_data(9U, kSize));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferSubData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  vb->SetSubDataReplaceFraction(1.f);
+}
 
-  verify_3d_data.arg_tests.clear();
-  verify_3d_data.static_args.clear();
-  verify_3d_data.update_func = Build3dImage;
-  verify_3d_data.call_name = "CompressedTexImage3D";
-  verify_3d_data.option = &s_options.image_format;
-  verify_3d_data.static_args.push_back(StaticArg(2, "0"));
-  verify_3d_data.static_args.push_back(
-      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_3d))));
-  verify_3d_data.static_args.push_back(StaticArg(
-      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_3d))));
-  verify_3d_data.static_args.push_back(
-      StaticArg(6, helper.ToString("GLsizei", static_cast<GLsizei>(depth_3d))));
-  verify_3d_data.static_args.push_back(StaticArg(7, "0"));
-  verify_3d_data.static_args.push_back(
-      StaticArg(9, helper.ToString(
-          "void*", s_data.image_container->GetData())));
-  verify_3d_data.varying_arg_index = 3U;
+TEST_F(RendererTest, IndexBufferUsage) {
+  // Test index buffer usage.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root;
+  TracingHelper helper;
 
-  verify_2d_data.update_func = Build2dImage;
-  verify_2d_data.arg_tests.clear();
-  verify_2d_data.static_args.clear();
-  verify_2d_data.call_name = "CompressedTexImage2D";
-  verify_2d_data.option = &s_options.image_format;
-  verify_2d_data.static_args.push_back(StaticArg(2, "0"));
-  verify_2d_data.static_args.push_back(
-      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_2d))));
-  verify_2d_data.static_args.push_back(StaticArg(
-      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_2d))));
-  verify_2d_data.static_args.push_back(StaticArg(6, "0"));
-  verify_2d_data.static_args.push_back(
-      StaticArg(8, helper.ToString(
-          "void*", s_data.image_container->GetData())));
-  verify_2d_data.varying_arg_index = 3U;
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<BufferObject::UsageMode> verify_data;
+  verify_data.update_func = BuildRectangleShape<uint16>;
+  verify_data.call_name = "BufferData";
+  verify_data.option = &s_options.index_buffer_usage;
+  verify_data.static_args.push_back(StaticArg(1, "GL_ELEMENT_ARRAY_BUFFER"));
+  verify_data.static_args.push_back(
+      StaticArg(2, helper.ToString(
+          "GLsizei", static_cast<int>(sizeof(uint16) * s_num_indices))));
+  verify_data.static_args.push_back(
+      StaticArg(3, helper.ToString(
+          "void*", s_data.index_container->GetData())));
+  verify_data.varying_arg_index = 4U;
+  // It's the second call in this case because the vertex buffer is bound first
+  // since this is the initial draw.
+  verify_data.arg_tests.push_back(
+      VaryingArg<BufferObject::UsageMode>(
+          1, BufferObject::kDynamicDraw, "GL_DYNAMIC_DRAW"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<BufferObject::UsageMode>(
+          0, BufferObject::kStaticDraw, "GL_STATIC_DRAW"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<BufferObject::UsageMode>(
+          0, BufferObject::kStreamDraw, "GL_STREAM_DRAW"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
 
-  verify_2d_data.arg_tests.push_back(
-      VaryingArg<Image::Format>(
-          0, Image::kDxt1, "GL_COMPRESSED_RGB_S3TC_DXT1_EXT"));
-  verify_2d_data.static_args.push_back(StaticArg(
-      7, helper.ToString("GLsizei", static_cast<GLsizei>(Image::ComputeDataSize(
-                                        Image::kDxt1, width_2d, height_2d)))));
-  verify_3d_data.arg_tests.push_back(verify_2d_data.arg_tests[0]);
-  verify_3d_data.static_args.push_back(StaticArg(
-      8, helper.ToString("GLsizei",
-                         static_cast<GLsizei>(Image::ComputeDataSize(
-                             Image::kDxt1, width_3d, height_3d, depth_3d)))));
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
 
-  for (int i = 0; i < num_compressed_formats; ++i) {
-    const Image::Format format = compressed_formats[i];
-    SCOPED_TRACE(Image::GetFormatString(format));
-    verify_3d_data.arg_tests[0] = verify_2d_data.arg_tests[0] =
-        VaryingArg<Image::Format>(
-            0, format,
-            helper.ToString("GLenum",
-                            Image::GetPixelFormat(format).internal_format));
-    verify_2d_data.static_args[5] = StaticArg(
-        7,
-        helper.ToString("GLsizei", static_cast<GLsizei>(Image::ComputeDataSize(
-                                       format, width_2d, height_2d))));
-    verify_3d_data.static_args[6] = StaticArg(
-        8, helper.ToString("GLsizei",
-                           static_cast<GLsizei>(Image::ComputeDataSize(
-                               format, width_3d, height_3d, depth_3d))));
-    EXPECT_TRUE(
-        VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
-    // The first time through there is a warning about having fewer components
-    // since the last image sent above was RGBA.
-    if (!i)
-      EXPECT_TRUE(log_checker.HasMessage(
-          "WARNING", "the number of components for this upload is"));
-    else
-      EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(
-        VerifyRenderCalls(verify_3d_data, trace_verifier_, renderer, root));
-    EXPECT_FALSE(log_checker.HasAnyMessages());
+TEST_F(RendererTest, ProgramAndShaderInfoLogs) {
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    NodePtr root = BuildGraph(kWidth, kHeight);;
+    Reset();
+    renderer->DrawScene(root);
+    // Info logs are empty when there are no errors.
+    EXPECT_EQ("", s_data.shader->GetInfoLog());
+    EXPECT_EQ("", s_data.shader->GetFragmentShader()->GetInfoLog());
+    EXPECT_EQ("", s_data.shader->GetVertexShader()->GetInfoLog());
   }
 
+  VerifyFunctionFailure(gm_, "CompileShader", "Unable to compile");
+  // Check that the info log was set.
+  EXPECT_EQ("Shader compilation is set to always fail.",
+            s_data.shader->GetVertexShader()->GetInfoLog());
+  EXPECT_EQ("Shader compilation is set to always fail.",
+            s_data.shader->GetFragmentShader()->GetInfoLog());
+  EXPECT_EQ("", s_data.shader->GetInfoLog());
+  // Reset data.
+  s_data.rect = NULL;
+  s_data.shader = NULL;
+  BuildRectangle();
+
   Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
+  VerifyFunctionFailure(gm_, "LinkProgram", "Unable to link");
+  // Check that the info log was set.
+  EXPECT_EQ("", s_data.shader->GetVertexShader()->GetInfoLog());
+  EXPECT_EQ("", s_data.shader->GetFragmentShader()->GetInfoLog());
+  EXPECT_EQ("Program linking is set to always fail.",
+            s_data.shader->GetInfoLog());
 }
 
-TEST_F(RendererTest, FramebufferObject) {
-  s_options.image_format = Image::kRgba8888;
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  base::LogChecker log_checker;
-  TracingHelper helper;
+namespace {
 
-  // Several images of different sizes.
-  static const uint32 kMaxImageSize = 32;
-  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
-  ImagePtr mipmaps[kNumMipmaps];
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
-                                 Image::kRgb888);
+// ProgramBinaryCache storage that keeps entries in memory.
+class MemoryProgramBinaryStorage : public ProgramBinaryCache::Storage {
+ public:
+  bool Read(const std::string& key, std::string* data) override {
+    std::map<std::string, std::string>::const_iterator it = entries_.find(key);
+    if (it == entries_.end())
+      return false;
+    *data = it->second;
+    return true;
+  }
+  void Write(const std::string& key, const std::string& data) override {
+    entries_[key] = data;
+  }
 
-  uint32 texture_width = s_data.texture->GetImage(0U)->GetWidth();
-  uint32 texture_height = s_data.texture->GetImage(0U)->GetHeight();
-  s_data.fbo = new FramebufferObject(0, texture_height);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "zero width or height"));
+  std::map<std::string, std::string> entries_;
 
-  s_data.fbo = new FramebufferObject(texture_width, 0);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "zero width or height"));
+ protected:
+  ~MemoryProgramBinaryStorage() override {}
+};
 
-  s_data.fbo = new FramebufferObject(texture_width, texture_height);
+// Returns the PlatformInfo of the passed renderer after drawing root.
+static const ResourceManager::PlatformInfo DrawAndGetPlatformInfo(
+    const RendererPtr& renderer, const NodePtr& root) {
+  CallbackHelper<ResourceManager::PlatformInfo> callback;
+  renderer->GetResourceManager()->RequestPlatformInfo(
+      std::bind(&CallbackHelper<ResourceManager::PlatformInfo>::Callback,
+                &callback, std::placeholders::_1));
+  renderer->DrawScene(root);
+  EXPECT_TRUE(callback.was_called);
+  EXPECT_EQ(1U, callback.infos.size());
+  return callback.infos.empty() ? ResourceManager::PlatformInfo()
+                                : callback.infos[0];
+}
+
+}  // anonymous namespace
+
+TEST_F(RendererTest, ProgramBinaryCache) {
+  MemoryProgramBinaryStorage* storage = new MemoryProgramBinaryStorage;
+  ProgramBinaryCachePtr cache(
+      new ProgramBinaryCache(ProgramBinaryCache::StoragePtr(storage)));
+  NodePtr root = BuildGraph(kWidth, kHeight);
 
+  // The first time a program is used it is compiled, linked, and its binary
+  // is stored in the cache.
   {
     RendererPtr renderer(new Renderer(gm_));
-    // Test an incomplete framebuffer.
-    Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-    renderer->DrawScene(root);
-    EXPECT_TRUE(log_checker.HasMessage("ERROR", "Framebuffer is not complete"));
-
-    // Check no calls are made if there is no node.
-    Reset();
-    renderer->DrawScene(NodePtr());
-    EXPECT_EQ(0U, trace_verifier_->GetCallCount());
+    renderer->SetProgramBinaryCache(cache);
+    EXPECT_EQ(cache.Get(), renderer->GetProgramBinaryCache().Get());
+    Reset();
+    const ResourceManager::PlatformInfo info =
+        DrawAndGetPlatformInfo(renderer, root);
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("CompileShader"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GetProgramBinary"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("ProgramBinary("));
+    EXPECT_EQ(1U, storage->entries_.size());
+    EXPECT_EQ(0U, info.program_binary_cache_hits);
+    EXPECT_EQ(1U, info.program_binary_cache_misses);
+    gm_->SetErrorCode(GL_NO_ERROR);
   }
 
+  // Another Renderer loads the binary instead of compiling the shaders.
   {
-    // Check a texture color attachment.
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.texture));
-    Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindFramebuffer"));
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("FramebufferTexture2D"));
+    renderer->SetProgramBinaryCache(cache);
+    Reset();
+    const ResourceManager::PlatformInfo info =
+        DrawAndGetPlatformInfo(renderer, root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("CompileShader"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("LinkProgram"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("ProgramBinary("));
+    EXPECT_EQ(1U, info.program_binary_cache_hits);
+    EXPECT_EQ(0U, info.program_binary_cache_misses);
+    EXPECT_EQ("", s_data.shader->GetInfoLog());
+    gm_->SetErrorCode(GL_NO_ERROR);
+  }
 
-    // Should not be multisampled.
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+  // A binary that the driver rejects falls back to compiling the shaders.
+  storage->entries_.begin()->second.replace(sizeof(uint32), std::string::npos,
+                                            "garbage");
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    renderer->SetProgramBinaryCache(cache);
+    Reset();
+    const ResourceManager::PlatformInfo info =
+        DrawAndGetPlatformInfo(renderer, root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("ProgramBinary("));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("CompileShader"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GetProgramBinary"));
+    EXPECT_EQ(0U, info.program_binary_cache_hits);
+    EXPECT_EQ(1U, info.program_binary_cache_misses);
+    gm_->SetErrorCode(GL_NO_ERROR);
+  }
 
-    // Check that the texture was generated and bound before being bound as
-    // the framebuffer's attachment.
-    EXPECT_LT(trace_verifier_->GetNthIndexOf(0U, "TexImage2D"),
-              trace_verifier_->GetNthIndexOf(
-                  0U, "FramebufferTexture2D(GL_RENDERBUFFER"));
+  // Without a cache programs are always compiled.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("CompileShader"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("ProgramBinary"));
+  }
+}
 
-    // Check args to FramebufferTexture2D.
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-          trace_verifier_->GetNthIndexOf(0U, "FramebufferTexture2D"))
-              .HasArg(3, "GL_TEXTURE_2D"));
+TEST_F(RendererTest, WarmUpPipelines) {
+  MemoryProgramBinaryStorage* storage = new MemoryProgramBinaryStorage;
+  ProgramBinaryCachePtr cache(
+      new ProgramBinaryCache(ProgramBinaryCache::StoragePtr(storage)));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  std::vector<uint64> keys;
 
+  // Pipelines drawn while a cache is set are only stored when requested.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    renderer->SetProgramBinaryCache(cache);
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_FALSE(cache->ReadPipelineKeys(&keys));
+    renderer->StoreRecordedPipelines();
+    EXPECT_TRUE(cache->ReadPipelineKeys(&keys));
+    EXPECT_EQ(1U, keys.size());
+    gm_->SetErrorCode(GL_NO_ERROR);
   }
 
+  // Another Renderer draws each stored pipeline once, with a single primitive
+  // into an offscreen framebuffer, and restores the framebuffer.
   {
-    // Check that the current fbo follows the current visual.
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.texture));
-    FramebufferObjectPtr fbo2(
-        new FramebufferObject(texture_width, texture_height));
-    fbo2->SetColorAttachment(0U, FramebufferObject::Attachment(s_data.texture));
-
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-
-    MockVisual share_visual(*visual_);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-    portgfx::Visual::MakeCurrent(&share_visual);
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(fbo2);
-    EXPECT_EQ(fbo2.Get(), renderer->GetCurrentFramebuffer().Get());
-
-    portgfx::Visual::MakeCurrent(visual_.get());
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->SetProgramBinaryCache(cache);
+    Reset();
+    EXPECT_EQ(1U, renderer->WarmUpPipelines(root));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements(GL_TRIANGLES, 3"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenFramebuffers"));
+    EXPECT_FALSE(renderer->GetCurrentFramebuffer().Get());
 
-    portgfx::Visual::MakeCurrent(&share_visual);
-    EXPECT_EQ(fbo2.Get(), renderer->GetCurrentFramebuffer().Get());
-    // Destroy the shared resource binder.
-    Renderer::DestroyCurrentStateCache();
-    portgfx::Visual::MakeCurrent(visual_.get());
+    // Drawing the same pipeline again records nothing new.
+    renderer->DrawScene(root);
+    keys.clear();
+    renderer->StoreRecordedPipelines();
+    EXPECT_TRUE(cache->ReadPipelineKeys(&keys));
+    EXPECT_EQ(1U, keys.size());
+    gm_->SetErrorCode(GL_NO_ERROR);
   }
 
+  // Pipelines that were not recorded are not drawn.
+  cache->WritePipelineKeys(std::vector<uint64>(1U, 1234U));
   {
-    // Check a texture color attachment that uses mipmaps.
-    // Set a full image pyramid.
-    for (uint32 i = 0; i < kNumMipmaps; ++i)
-      s_data.texture->SetImage(i, mipmaps[i]);
+    RendererPtr renderer(new Renderer(gm_));
+    renderer->SetProgramBinaryCache(cache);
+    Reset();
+    EXPECT_EQ(0U, renderer->WarmUpPipelines(root));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements"));
+  }
 
+  // Without recorded pipelines every pipeline in the scene is drawn.
+  {
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.texture));
     Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-    renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_EQ(1U, renderer->WarmUpPipelines(root));
+    EXPECT_EQ(0U, renderer->WarmUpPipelines(NodePtr()));
+  }
+}
 
-    // Set up fbo to draw into first mip level.
-    FramebufferObjectPtr mip_fbo(new FramebufferObject(
-        texture_width >> 1, texture_height >> 1));
-    mip_fbo->SetColorAttachment(0U,
-        FramebufferObject::Attachment(s_data.texture, 1));
+TEST_F(RendererTest, UniformQueries) {
+  NodePtr root = BuildGraph(kWidth, kHeight);
+
+  // The uniforms are queried with program interface queries when available.
+  {
+    RendererPtr renderer(new Renderer(gm_));
     Reset();
-    renderer->BindFramebuffer(mip_fbo);
-    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceiv"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetActiveUniform("));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetUniformLocation"));
+  }
 
-    // Expect mismatched dimensions error.
-    mip_fbo->SetColorAttachment(0U,
-        FramebufferObject::Attachment(s_data.texture, 0));
+  // Otherwise each uniform is looked up by name.
+  gm_->EnableFunctionGroup(GraphicsManager::kProgramInterfaceQuery, false);
+  {
+    RendererPtr renderer(new Renderer(gm_));
     Reset();
-    renderer->BindFramebuffer(mip_fbo);
-    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    s_msg_stream_ << "Mismatched Texture and FBO dimensions: 32 x 32 "
-        "vs. 16 x 16";
-    EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetActiveUniform("));
+    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetUniformLocation"));
   }
+  gm_->EnableFunctionGroup(GraphicsManager::kProgramInterfaceQuery, true);
 
+  // A program identical to one already linked, as identified by its binary
+  // cache key, reuses its uniforms without querying OpenGL.
   {
-    // Check a cubemap color attachment.
+    MemoryProgramBinaryStorage* storage = new MemoryProgramBinaryStorage;
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.cubemap,
-                                          CubeMapTexture::kPositiveX));
+    renderer->SetProgramBinaryCache(ProgramBinaryCachePtr(
+        new ProgramBinaryCache(ProgramBinaryCache::StoragePtr(storage))));
     Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-  }
-
-  {
-    // Check a cubemap color attachment that uses mipmaps.
-    // Set a full image pyramid for each face.
-    for (int j = 0; j < 6; ++j) {
-      for (uint32 i = 0; i < kNumMipmaps; ++i)
-        s_data.cubemap->SetImage(
-            static_cast<CubeMapTexture::CubeFace>(j), i, mipmaps[i]);
-    }
+    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceName"));
 
-    RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.cubemap,
-                                          CubeMapTexture::kPositiveZ));
+    ShaderProgramPtr copy = ShaderProgram::BuildFromStrings(
+        "Copy", s_data.shader->GetRegistry(),
+        s_data.shader->GetVertexShader()->GetSource(),
+        s_data.shader->GetFragmentShader()->GetSource(),
+        base::AllocatorPtr());
+    s_data.rect->SetShaderProgram(copy);
     Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("ProgramBinary("));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetActiveUniform("));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+    EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+    s_data.rect->SetShaderProgram(s_data.shader);
+  }
+}
 
-    // Set up fbo to draw into first mip level.
-    FramebufferObjectPtr mip_fbo(
-        new FramebufferObject(texture_width >> 1, texture_height >> 1));
-    mip_fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.cubemap,
-                                          CubeMapTexture::kPositiveZ, 1));
+// Returns the number of times str occurs in the calls traced by the passed
+// TraceVerifier, including in their arguments.
+static size_t CountInTrace(const testing::TraceVerifier& trace_verifier,
+                           const std::string& str) {
+  const std::string trace = trace_verifier.GetTraceString();
+  size_t count = 0;
+  for (size_t pos = trace.find(str); pos != std::string::npos;
+       pos = trace.find(str, pos + str.length()))
+    ++count;
+  return count;
+}
+
+TEST_F(RendererTest, CompileShadersAsynchronously) {
+  RendererPtr renderer(new Renderer(gm_));
+  renderer->SetFlag(Renderer::kCompileShadersAsynchronously);
+  NodePtr root = BuildGraph(kWidth, kHeight);
+
+  // The shaders start compiling and the program starts linking, without
+  // checking whether either succeeded, and nothing is drawn.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MaxShaderCompilerThreadsKHR"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("CompileShader"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("LinkProgram"));
+  EXPECT_EQ(0U, CountInTrace(*trace_verifier_, "GL_COMPILE_STATUS"));
+  EXPECT_EQ(0U, CountInTrace(*trace_verifier_, "GL_LINK_STATUS"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UseProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements("));
+
+  // The link is still in progress in the next frame.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, CountInTrace(*trace_verifier_, "GL_COMPLETION_STATUS_KHR"));
+  EXPECT_EQ(0U, CountInTrace(*trace_verifier_, "GL_LINK_STATUS"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements("));
+
+  // Once it finishes, the program is relinked with its attribute bindings.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, CountInTrace(*trace_verifier_, "GL_COMPLETION_STATUS_KHR"));
+  EXPECT_EQ(2U, CountInTrace(*trace_verifier_, "GL_COMPILE_STATUS"));
+  EXPECT_EQ(1U, CountInTrace(*trace_verifier_, "GL_LINK_STATUS"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("LinkProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements("));
+
+  // The program is drawn with once the relink finishes.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, CountInTrace(*trace_verifier_, "GL_LINK_STATUS"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UseProgram"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_EQ("", s_data.shader->GetInfoLog());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, CountInTrace(*trace_verifier_, "GL_COMPLETION_STATUS_KHR"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+
+  // The previous program is drawn with while an edited shader compiles.
+  const std::string source = s_data.shader->GetVertexShader()->GetSource();
+  s_data.shader->GetVertexShader()->SetSource(source + "\n");
+  for (int i = 0; i < 4; ++i) {
     Reset();
-    renderer->BindFramebuffer(mip_fbo);
-    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_EQ(i == 0 ? 1U : 0U, trace_verifier_->GetCountOf("CompileShader"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+    // The new program is used once it has been linked.
+    EXPECT_EQ(i == 3 ? 1U : 0U, trace_verifier_->GetCountOf("UseProgram"));
+  }
 
-    // Expect mismatched dimensions error.
-    mip_fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.cubemap,
-                                          CubeMapTexture::kPositiveZ, 0));
+  // A failed compilation is reported once the link finishes, and the
+  // previous program is kept.
+  gm_->SetForceFunctionFailure("CompileShader", true);
+  s_data.shader->GetVertexShader()->SetSource(source);
+  for (int i = 0; i < 3; ++i) {
     Reset();
-    renderer->BindFramebuffer(mip_fbo);
-    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    s_msg_stream_ << "Mismatched CubeMapTexture and FBO dimensions: 32 x 32 "
-        "vs. 16 x 16";
-    EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
   }
+  EXPECT_EQ("Shader compilation is set to always fail.",
+            s_data.shader->GetVertexShader()->GetInfoLog());
+  gm_->SetForceFunctionFailure("CompileShader", false);
+  gm_->SetErrorCode(GL_NO_ERROR);
+
+  // Without KHR_parallel_shader_compile the link finishes in the frame after
+  // it starts, since there is no way to tell whether it is still in
+  // progress.
+  gm_->EnableFunctionGroup(GraphicsManager::kParallelShaderCompile, false);
+  s_data.rect = NULL;
+  s_data.shader = NULL;
+  root = BuildGraph(kWidth, kHeight);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements("));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, CountInTrace(*trace_verifier_, "GL_COMPLETION_STATUS_KHR"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("LinkProgram"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+  gm_->EnableFunctionGroup(GraphicsManager::kParallelShaderCompile, true);
+}
+
+TEST_F(RendererTest, ShareVertexArrays) {
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  // A second shape draws the same vertices through its own AttributeArray.
+  AttributeArrayPtr attribute_array(new AttributeArray);
+  for (size_t i = 0; i < s_data.attribute_array->GetAttributeCount(); ++i)
+    attribute_array->AddAttribute(s_data.attribute_array->GetAttribute(i));
+  ShapePtr shape(new Shape);
+  shape->SetPrimitiveType(s_data.shape->GetPrimitiveType());
+  shape->SetIndexBuffer(s_data.shape->GetIndexBuffer());
+  shape->SetAttributeArray(attribute_array);
+  NodePtr node(new Node);
+  node->AddShape(shape);
+  root->AddChild(node);
 
+  // Each AttributeArray normally has its own vertex array.
   {
-    // Check renderbuffer types.
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(Image::kRgba4Byte));
     Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "FramebufferRenderbuffer(GL_FRAMEBUFFER"))
-                .HasArg(4, "0x1"));
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLenum", static_cast<GLenum>(GL_RGBA4))));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenVertexArrays"));
+    EXPECT_EQ(4U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
+  }
 
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(Image::kRgb565Byte));
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    renderer->SetFlag(Renderer::kShareVertexArrays);
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLenum", static_cast<GLenum>(GL_RGB565))));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenVertexArrays"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
+    EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
 
-    static uint8 kData[12] = {0x1, 0x2, 0x3, 0x4, 0x5, 0x6,
-                              0x7, 0x8, 0x9, 0xa, 0xb, 0xc};
-    ImagePtr egl_image(new Image);
-    egl_image->SetEglImage(base::DataContainer::Create<void>(
-        kData, kNullFunction, false, egl_image->GetAllocator()));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(egl_image));
+    // Nothing is resent once the arrays are set up.
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf(
-                      "EGLImageTargetRenderbufferStorageOES"));
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "FramebufferRenderbuffer(GL_FRAMEBUFFER"))
-                .HasArg(4, "0x1"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenVertexArrays"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
 
-    egl_image->SetEglImage(base::DataContainer::Create<void>(
-        nullptr, kNullFunction, false, egl_image->GetAllocator()));
+    // Changing the layout of one array gives it a vertex array of its own.
+    attribute_array->EnableBufferAttribute(1U, false);
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    // Since the buffer is nullptr nothing will be set.  This isn't an error
-    // since the caller could just set it manually through OpenGL directly.
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf(
-                      "EGLImageTargetRenderbufferStorageOES"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenVertexArrays"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
 
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(Image::kRgb5a1Byte));
+    // Restoring it shares the first array again, deleting the second.
+    attribute_array->EnableBufferAttribute(1U, true);
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLenum", static_cast<GLenum>(GL_RGB5_A1))));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenVertexArrays"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
 
-    s_data.fbo->SetDepthAttachment(
-        FramebufferObject::Attachment(Image::kRenderbufferDepth16));
+    // Turning sharing off gives each AttributeArray its own array again.
+    renderer->ClearFlag(Renderer::kShareVertexArrays);
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLenum", static_cast<GLenum>(GL_DEPTH_COMPONENT16))));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenVertexArrays"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
+    EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+  }
 
-    s_data.fbo->SetStencilAttachment(
-        FramebufferObject::Attachment(Image::kStencil8));
+  // Emulated vertex arrays skip attribute pointers that are already set.
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
+  {
+    RendererPtr renderer(new Renderer(gm_));
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLenum", static_cast<GLenum>(GL_STENCIL_INDEX8))));
+    EXPECT_EQ(4U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
   }
-
   {
-    // Check color render buffer for multisamping.
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(Image::kRgba8, 4));
+    renderer->SetFlag(Renderer::kShareVertexArrays);
     Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLsizei", static_cast<GLsizei>(4))));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
+    EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+  }
+}
 
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(Image::kRgba8, 2));
+TEST_F(RendererTest, ShareSamplers) {
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  // The cube map gets a Sampler of its own with the same state.
+  SamplerPtr sampler(new Sampler);
+  sampler->SetMinFilter(s_data.sampler->GetMinFilter());
+  sampler->SetMagFilter(s_data.sampler->GetMagFilter());
+  sampler->SetWrapS(s_data.sampler->GetWrapS());
+  sampler->SetWrapT(s_data.sampler->GetWrapT());
+  sampler->SetWrapR(s_data.sampler->GetWrapR());
+  sampler->SetCompareFunction(s_data.sampler->GetCompareFunction());
+  sampler->SetCompareMode(s_data.sampler->GetCompareMode());
+  sampler->SetMinLod(s_data.sampler->GetMinLod());
+  sampler->SetMaxLod(s_data.sampler->GetMaxLod());
+  sampler->SetMaxAnisotropy(s_data.sampler->GetMaxAnisotropy());
+  s_data.cubemap->SetSampler(sampler);
+
+  // Each Sampler normally has its own sampler object.
+  {
+    RendererPtr renderer(new Renderer(gm_));
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLsizei", static_cast<GLsizei>(2))));
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenSamplers"));
   }
 
   {
-    // Use a new fbo instead of the old one since we don't care about
-    // color buffer.
-    s_data.fbo = new FramebufferObject(texture_width, texture_height);
-    // Check depth render buffer for multisamping.
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetDepthAttachment(FramebufferObject::Attachment(
-        kDepthBufferFormat, 4));
+    renderer->SetFlag(Renderer::kShareSamplers);
     Reset();
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    renderer->BindFramebuffer(s_data.fbo);
-    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLsizei", static_cast<GLsizei>(4))));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenSamplers"));
+    EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
 
-     s_data.fbo->SetDepthAttachment(
-         FramebufferObject::Attachment(kDepthBufferFormat, 2));
+    // Nothing is resent once the samplers are set up.
     Reset();
     renderer->DrawScene(root);
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(
-            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
-                .HasArg(2, helper.ToString(
-                    "GLsizei", static_cast<GLsizei>(2))));
-  }
-}
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenSamplers"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("SamplerParameter"));
 
-TEST_F(RendererTest, FramebufferObjectMultisampleTextureAttachment) {
-  s_options.image_format = Image::kRgba8888;
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  base::LogChecker log_checker;
-  TracingHelper helper;
+    // Changing the state of one Sampler gives it a sampler object of its own.
+    sampler->SetWrapS(sampler->GetWrapS() == Sampler::kRepeat
+                          ? Sampler::kClampToEdge
+                          : Sampler::kRepeat);
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenSamplers"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
 
-  uint32 texture_width = s_data.texture->GetImage(0U)->GetWidth();
-  uint32 texture_height = s_data.texture->GetImage(0U)->GetHeight();
-  s_data.fbo = new FramebufferObject(texture_width, texture_height);
+    // Restoring it shares the first sampler object again, deleting the second.
+    sampler->SetWrapS(s_data.sampler->GetWrapS());
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenSamplers"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteSamplers"));
 
-  // Enable multisampling.
-  s_data.texture->SetMultisampling(8, true);
+    // Turning sharing off gives each Sampler its own sampler object again.
+    renderer->ClearFlag(Renderer::kShareSamplers);
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenSamplers"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteSamplers"));
+    EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+  }
+  s_data.cubemap->SetSampler(s_data.sampler);
+}
 
-  // Check a texture color attachment.
+TEST_F(RendererTest, TransientFramebuffers) {
   RendererPtr renderer(new Renderer(gm_));
-  s_data.fbo->SetColorAttachment(
-      0U, FramebufferObject::Attachment(s_data.texture));
+  EXPECT_EQ(0U, renderer->GetTransientFramebufferCount());
+
+  // Each request in a frame gets its own framebuffer.
+  FramebufferObjectPtr fbo1 = renderer->AcquireTransientFramebuffer(
+      64U, 32U, Image::kRgba8888, Image::kRenderbufferDepth16, 0U);
+  FramebufferObjectPtr fbo2 = renderer->AcquireTransientFramebuffer(
+      64U, 32U, Image::kRgba8888, Image::kRenderbufferDepth16, 0U);
+  FramebufferObjectPtr fbo3 = renderer->AcquireTransientFramebuffer(
+      16U, 16U, Image::kRgba8888, Image::kInvalid, 4U);
+  EXPECT_NE(fbo1.Get(), fbo2.Get());
+  EXPECT_NE(fbo1.Get(), fbo3.Get());
+  EXPECT_EQ(3U, renderer->GetTransientFramebufferCount());
+  EXPECT_EQ(64U, fbo1->GetWidth());
+  EXPECT_EQ(32U, fbo1->GetHeight());
+  EXPECT_EQ(FramebufferObject::kTexture,
+            fbo1->GetColorAttachment(0U).GetBinding());
+  EXPECT_EQ(Image::kRgba8888, fbo1->GetColorAttachment(0U).GetFormat());
+  EXPECT_EQ(Image::kRenderbufferDepth16,
+            fbo1->GetDepthAttachment().GetFormat());
+  EXPECT_EQ(FramebufferObject::kRenderbuffer,
+            fbo3->GetColorAttachment(0U).GetBinding());
+  EXPECT_EQ(4U, fbo3->GetColorAttachment(0U).GetSamples());
+  EXPECT_EQ(FramebufferObject::kUnbound,
+            fbo3->GetDepthAttachment().GetBinding());
+
+  // Binding a new framebuffer does not invalidate anything.
+  Reset();
+  renderer->BindFramebuffer(fbo1);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("InvalidateFramebuffer"));
+
+  // Framebuffers are reused once they are recycled, and their old contents
+  // are invalidated, using attachment names, the first time they are bound.
+  renderer->RecycleTransientFramebuffers();
+  FramebufferObjectPtr fbo4 = renderer->AcquireTransientFramebuffer(
+      64U, 32U, Image::kRgba8888, Image::kRenderbufferDepth16, 0U);
+  EXPECT_EQ(fbo1.Get(), fbo4.Get());
+  EXPECT_EQ(3U, renderer->GetTransientFramebufferCount());
+  Reset();
+  renderer->BindFramebuffer(fbo4);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("InvalidateFramebuffer"));
+  renderer->BindFramebuffer(FramebufferObjectPtr());
+  renderer->BindFramebuffer(fbo4);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("InvalidateFramebuffer"));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+
+  // Framebuffers that were not acquired in the previous frame are destroyed.
+  renderer->RecycleTransientFramebuffers();
+  EXPECT_EQ(1U, renderer->GetTransientFramebufferCount());
+  renderer->RecycleTransientFramebuffers();
+  EXPECT_EQ(0U, renderer->GetTransientFramebufferCount());
+
+  // Buffers of the default framebuffer are invalidated by name; the mock
+  // generates an error for attachment names.
+  renderer->BindFramebuffer(FramebufferObjectPtr());
   Reset();
-  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  renderer->BindFramebuffer(s_data.fbo);
-  EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindFramebuffer"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("FramebufferTexture2D"));
-
-  // Check args to TexImage2DMultisample.
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
-            .HasArg(1, "GL_TEXTURE_2D_MULTISAMPLE")
-            .HasArg(2, "8"));
-
-  // Check texture target arg to FramebufferTexture2D.
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(0U, "FramebufferTexture2D"))
-            .HasArg(3, "GL_TEXTURE_2D_MULTISAMPLE"));
-
-  renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
+  renderer->InvalidateFramebuffer(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("InvalidateFramebuffer"));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+  renderer->InvalidateFramebuffer(0);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("InvalidateFramebuffer"));
 }
 
-TEST_F(RendererTest, FramebufferObjectAttachmentsImplicitlyChangedByDraw) {
-  NodePtr root = BuildGraph(kWidth, kHeight);
+TEST_F(RendererTest, FunctionFailures) {
+  // Misc tests for error handling when some functions fail.
   base::LogChecker log_checker;
-  TracingHelper helper;
-
-  uint32 texture_width = s_data.texture->GetImage(0U)->GetWidth();
-  uint32 texture_height = s_data.texture->GetImage(0U)->GetHeight();
-  s_data.fbo = new FramebufferObject(texture_width, texture_height);
-
   {
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.texture));
-    s_data.sampler->SetAutogenerateMipmapsEnabled(true);
-    renderer->BindFramebuffer(s_data.fbo);
-    Reset();
-    renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-    Reset();
-    // Since the contents have changed, we should regenerate mipmaps.
-    renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+    NodePtr root = BuildGraph(kWidth, kHeight);;
     Reset();
-    // Same thing again.
     renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  }
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 
-    // Nothing should happen if mipmaps are disabled.
-    s_data.sampler->SetAutogenerateMipmapsEnabled(false);
-    Reset();
-    renderer->DrawScene(root);
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // Check that Renderer catches failed compilation.
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
+  Reset();
+  VerifyFunctionFailure(gm_, "CompileShader", "Unable to compile");
+  // Check that Renderer catches failed program creation.
+  Reset();
+  VerifyFunctionFailure(gm_, "CreateProgram",
+                        "Unable to create shader program object");
+  // Check that Renderer catches failed shader creation.
+  Reset();
+  VerifyFunctionFailure(gm_, "CreateShader", "Unable to create shader object");
+  // Check that Renderer catches failed linking.
+  Reset();
+  VerifyFunctionFailure(gm_, "LinkProgram", "Unable to link");
 
-    EXPECT_FALSE(log_checker.HasAnyMessages());
-  }
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
+  Reset();
+  VerifyFunctionFailure(gm_, "CompileShader", "Unable to compile");
+  // Check that Renderer catches failed program creation.
 
-  // Same thing with a cubemap face attachment.
+  Reset();
+  VerifyFunctionFailure(gm_, "CreateProgram",
+                        "Unable to create shader program object");
+  // Check that Renderer catches failed shader creation.
+  Reset();
+  VerifyFunctionFailure(gm_, "CreateShader", "Unable to create shader object");
+  // Check that Renderer catches failed linking.
+  Reset();
+  VerifyFunctionFailure(gm_, "LinkProgram", "Unable to link");
+
+  // Check that Renderer catches failed buffer id generation.
+  Reset();
+  VerifyFunctionFailure(gm_, "GenBuffers", "Unable to create buffer");
+  // Check that Renderer catches failed sampler id generation.
+  Reset();
+  VerifyFunctionFailure(gm_, "GenSamplers", "Unable to create sampler");
+  // Check that Renderer catches failed framebuffer id generation.
+  Reset();
+  VerifyFunctionFailure(gm_, "GenFramebuffers", "Unable to create framebuffer");
+  // Check that Renderer catches failed renderbuffer id generation.
+  Reset();
+  VerifyFunctionFailure(gm_, "GenRenderbuffers",
+                       "Unable to create renderbuffer");
+  // Check that Renderer catches failed texture id generation.
+  Reset();
+  VerifyFunctionFailure(gm_, "GenTextures", "Unable to create texture");
+  // Check that Renderer catches failed vertex array id generation.
+  Reset();
+  VerifyFunctionFailure(gm_, "GenVertexArrays",
+                        "Unable to create vertex array");
+}
+
+TEST_F(RendererTest, PrimitiveType) {
+  // Test primitive type.
+  NodePtr root;
+  TracingHelper helper;
+  base::LogChecker log_checker;
+
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<Shape::PrimitiveType> verify_data;
+  verify_data.update_func = BuildRectangleShape<uint16>;
+  verify_data.call_name = "DrawElements";
+  verify_data.option = &s_options.primitive_type;
+  verify_data.static_args.push_back(
+      StaticArg(2, helper.ToString("GLsizei", s_num_indices)));
+  verify_data.static_args.push_back(StaticArg(3, "GL_UNSIGNED_SHORT"));
+  verify_data.static_args.push_back(StaticArg(4, "NULL"));
+  verify_data.varying_arg_index = 1U;
+  verify_data.arg_tests.push_back(
+      VaryingArg<Shape::PrimitiveType>(0, Shape::kLines, "GL_LINES"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Shape::PrimitiveType>(
+          0, Shape::kLineLoop, "GL_LINE_LOOP"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Shape::PrimitiveType>(
+          0, Shape::kLineStrip, "GL_LINE_STRIP"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Shape::PrimitiveType>(0, Shape::kPoints, "GL_POINTS"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Shape::PrimitiveType>(0, Shape::kTriangles, "GL_TRIANGLES"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Shape::PrimitiveType>(
+          0, Shape::kTriangleFan, "GL_TRIANGLE_FAN"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Shape::PrimitiveType>(
+          0, Shape::kTriangleStrip, "GL_TRIANGLE_STRIP"));
   {
     RendererPtr renderer(new Renderer(gm_));
-    s_data.fbo->SetColorAttachment(
-        0U, FramebufferObject::Attachment(s_data.cubemap,
-                                          CubeMapTexture::kPositiveX));
-    s_data.sampler->SetAutogenerateMipmapsEnabled(true);
-    renderer->BindFramebuffer(s_data.fbo);
-    Reset();
-    renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-    Reset();
-    // Since the contents have changed, we should regenerate mipmaps.
-    renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-    Reset();
-    // Same thing again.
-    renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+    EXPECT_TRUE(
+        VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  }
 
-    // Nothing should happen if mipmaps are disabled.
-    s_data.sampler->SetAutogenerateMipmapsEnabled(false);
+  // Check some corner cases.
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, false);
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    // Destroy the data in the datacontainer to get an error message.
+    s_data.vertex_container = NULL;
+    // The attribute_array must be destroyed as well to trigger a rebind.
+    s_data.attribute_array = NULL;
+    BuildRectangleAttributeArray();
+    s_data.vertex_buffer->SetData(
+        s_data.vertex_container, sizeof(Vertex), s_num_vertices,
+        s_options.vertex_buffer_usage);
     Reset();
     renderer->DrawScene(root);
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-
-    EXPECT_FALSE(log_checker.HasAnyMessages());
+    // The buffer object should not be updated.
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
+    EXPECT_TRUE(log_checker.HasMessage("WARNING", "Unable to draw shape"));
+    // Restore the data.
+    BuildRectangleBufferObject();
+    BuildRectangleAttributeArray();
   }
-}
 
-TEST_F(RendererTest, CubeMapTextureMipmaps) {
+  gm_->EnableFunctionGroup(GraphicsManager::kVertexArrays, true);
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  base::LogChecker log_checker;
-  TracingHelper helper;
-
-  // Check that each face of a CubeMapTexture with an image is sent as mipmap
-  // level 0.
+  // Destroy the data in the datacontainer to get an error message.
+  s_data.vertex_container = NULL;
+  // The attribute_array must be destroyed as well to trigger a rebind.
+  s_data.attribute_array = NULL;
+  BuildRectangleAttributeArray();
+  s_data.vertex_buffer->SetData(
+      s_data.vertex_container, sizeof(Vertex), s_num_vertices,
+      s_options.vertex_buffer_usage);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 0U, 28672U));
-  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
-  for (int i = 0; i < 6; ++i) {
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(i + 1U, "TexImage2D"))
-            .HasArg(2, "0"));
-  }
-
-  // Several images of different sizes.
-  static const uint32 kMaxImageSize = 32;
-  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
-  ImagePtr mipmaps[kNumMipmaps];
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
-                                 Image::kRgba8888);
+  // The buffer object should not be updated.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Unable to draw shape"));
+  // Restore the data.
+  BuildRectangleBufferObject();
+  BuildRectangleAttributeArray();
 
-  // Set a full image pyramid for each face.
-  for (int j = 0; j < 6; ++j) {
-    for (uint32 i = 0; i < kNumMipmaps; ++i)
-      s_data.cubemap->SetImage(
-          static_cast<CubeMapTexture::CubeFace>(j), i, mipmaps[i]);
-  }
+  // Do the same with the index buffer.
+  s_data.index_container = NULL;
+  s_data.index_buffer->SetData(s_data.index_container, sizeof(uint16),
+                               s_num_indices, s_options.index_buffer_usage);
+  Reset();
+  renderer->DrawScene(root);
+  // The index buffer object should not be updated.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf(
+      "BindBuffer(GL_ELEMENT_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf(
+      "BufferData(GL_ELEMENT_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Unable to draw shape"));
+  // Restore the data.
+  BuildRectangleShape<uint16>();
 
-  // Check consistent dimensions.
-  EXPECT_FALSE(log_checker.HasAnyMessages());
+  // Check that the shape is not drawn if the IndexBuffer has no indices.
+  s_data.shape->SetIndexBuffer(IndexBufferPtr(new IndexBuffer));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_EQ(kNumMipmaps * 6U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  // The cubemap now has mipmaps, so it's usage has increased by 4/3.
-  EXPECT_EQ(36864U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(32768U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
+  s_data.shape->SetIndexBuffer(s_data.index_buffer);
 
-  // Check the right calls were made. First check the level 0 mipmaps.
-  for (uint32 j = 0; j < 6; ++j) {
-    SCOPED_TRACE(::testing::Message() << "Testing face " << j);
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(j, "TexImage2D"))
-            .HasArg(1, helper.ToString(
-                "GLenum", base::EnumHelper::GetConstant(
-                    static_cast<CubeMapTexture::CubeFace>(j))))
-            .HasArg(2, "0")
-            .HasArg(4, helper.ToString(
-                "GLsizei", static_cast<GLint>(mipmaps[0]->GetWidth())))
-            .HasArg(5, helper.ToString(
-                "GLsizei", static_cast<GLint>(mipmaps[0]->GetHeight()))));
-  }
-  // Now check the level 1+ mipmaps.
-  for (uint32 j = 0; j < 6; ++j) {
-  SCOPED_TRACE(::testing::Message() << "Testing face " << j);
-    for (uint32 i = 1; i < kNumMipmaps; ++i) {
-      SCOPED_TRACE(::testing::Message() << "Testing mipmap level " << i);
-      EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-          trace_verifier_->GetNthIndexOf(6U + j * (kNumMipmaps - 1U) + i - 1U,
-                                         "TexImage2D"))
-              .HasArg(1, helper.ToString(
-                  "GLenum", base::EnumHelper::GetConstant(
-                      static_cast<CubeMapTexture::CubeFace>(j))))
-              .HasArg(2, helper.ToString("GLint", static_cast<GLint>(i)))
-              .HasArg(4, helper.ToString(
-                  "GLsizei", static_cast<GLint>(mipmaps[i]->GetWidth())))
-              .HasArg(5, helper.ToString(
-                  "GLsizei", static_cast<GLint>(mipmaps[i]->GetHeight()))));
-    }
-  }
-
-  // Remove an image from a few faces and verify that GenerateMipmap is called
-  // only once for the entire texture.
-  s_data.cubemap->SetImage(CubeMapTexture::kNegativeZ, 1, ImagePtr(NULL));
-  s_data.cubemap->SetImage(CubeMapTexture::kPositiveY, 3, ImagePtr(NULL));
-  s_data.cubemap->SetImage(CubeMapTexture::kPositiveZ, 2, ImagePtr(NULL));
+  // Check that if there are no index buffers then DrawArrays is used. By
+  // default, all vertices should be used.
+  s_data.shape->SetPrimitiveType(Shape::kPoints);
+  s_data.shape->SetIndexBuffer(IndexBufferPtr(NULL));
   Reset();
   renderer->DrawScene(root);
-  // Overall memory usage should be unchanged.
-  EXPECT_EQ(36864U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(32768U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  // Since GenerateMipmap was called the override mipmaps were sent, but the
-  // 0th level mipmap doesn't have to be (GenerateMipmap won't override it).
-  // Only the mipmaps of the 3 modified faces are sent.
-  EXPECT_EQ((kNumMipmaps - 1U) * 3U - 3U,
-            trace_verifier_->GetCountOf("TexImage2D"));
-
-  // Set an invalid image dimension.
-  s_data.cubemap->SetImage(
-      CubeMapTexture::kPositiveY, 1,
-      CreateNullImage(mipmaps[1]->GetWidth() - 1, mipmaps[1]->GetHeight(),
-                      Image::kRgba8888));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 0, 4)"));
+  // Try different vertex range settings.
+  s_data.shape->AddVertexRange(Range1i(1, 3));
   Reset();
   renderer->DrawScene(root);
-  // Generate mipmap will be called since a mipmap has changed, but no
-  // overriding mipmaps will be set since one is invalid.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  s_msg_stream_ << "Mipmap width: " << (mipmaps[1]->GetWidth() - 1) <<
-      " is not a power of 2.";
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
-  // Overall memory usage should be unchanged since there was an error
-  EXPECT_EQ(36864U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(32768U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-
-  s_data.cubemap->SetImage(
-      CubeMapTexture::kPositiveY, 1,
-      CreateNullImage(mipmaps[1]->GetWidth(), mipmaps[1]->GetHeight() - 1,
-                      Image::kRgba8888));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 1, 2)"));
+  // Multiple ranges are drawn with a single call.
+  s_data.shape->AddVertexRange(Range1i(3, 4));
   Reset();
   renderer->DrawScene(root);
-  // Generate mipmap will be called since a mipmap has changed, but no
-  // overriding mipmaps will be set since one is invalid.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  s_msg_stream_ << "Mipmap height: " << (mipmaps[1]->GetWidth() - 1) <<
-      " is not a power of 2.";
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
-  // Overall memory usage should be unchanged since there was an error
-  EXPECT_EQ(36864U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(32768U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-
-  // Set an invalid image dimension.
-  s_data.cubemap->SetImage(
-      CubeMapTexture::kPositiveY, 1, CreateNullImage(
-          mipmaps[1]->GetWidth(), mipmaps[1]->GetHeight(), Image::kRgb888));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawArrays("));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MultiDrawArrays(GL_POINTS"));
+  s_data.shape->EnableVertexRange(0, false);
   Reset();
   renderer->DrawScene(root);
-  // Generate mipmap will be called since a mipmap has changed, but no
-  // overriding mipmaps will be set since one is invalid.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_TRUE(
-      log_checker.HasMessage("ERROR", "level 1 has different format"));
-  // Overall memory usage should be unchanged since there was an error
-  EXPECT_EQ(36864U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(32768U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-}
-
-TEST_F(RendererTest, CubeMapTextureSubImages) {
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  base::LogChecker log_checker;
-  TracingHelper helper;
-
-  // Check that a texture with an image is sent as mipmap level 0.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 3, 1)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MultiDrawArrays"));
+  s_data.shape->EnableVertexRange(0, true);
+  gm_->EnableFunctionGroup(GraphicsManager::kMultiDraw, false);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
-
-  // Now set a subimage on the CubeMapTexture.
-  s_data.cubemap->SetSubImage(
-      CubeMapTexture::kNegativeZ, 0U, math::Point2ui(12, 20), CreateNullImage(
-          4, 8, Image::kRgba8888));
-  // Check that the subimage is applied.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 1, 2)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 3, 1)"));
+  gm_->EnableFunctionGroup(GraphicsManager::kMultiDraw, true);
+  s_data.shape->ClearVertexRanges();
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "TexSubImage2D"))
-          .HasArg(2, "0")
-          .HasArg(3, "12")
-          .HasArg(4, "20")
-          .HasArg(5, "4")
-          .HasArg(6, "8")
-          .HasArg(7, "GL_RGB")
-          .HasArg(8, "GL_UNSIGNED_BYTE"));
-
-  // Several images of different sizes.
-  static const uint32 kMaxImageSize = 32;
-  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
-  ImagePtr mipmaps[kNumMipmaps];
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
-                                 Image::kRgba8888);
-
-  // Set a full image pyramid for each face.
-  for (int j = 0; j < 6; ++j) {
-    for (uint32 i = 0; i < kNumMipmaps; ++i)
-      s_data.cubemap->SetImage(
-          static_cast<CubeMapTexture::CubeFace>(j), i, mipmaps[i]);
-  }
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS, 0, 4)"));
+  s_data.shape->SetIndexBuffer(s_data.index_buffer);
 
-  // Check consistent dimensions.
-  EXPECT_FALSE(log_checker.HasAnyMessages());
+  // Check that if the shape has no attribute array that it is not drawn.
+  s_data.shape->SetAttributeArray(AttributeArrayPtr(NULL));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_EQ(kNumMipmaps * 6U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(36864U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(32768U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-
-  // Set a submipmap at level 3. Setting a compressed image requires non-NULL
-  // image data.
-  ImagePtr compressed_image(new Image);
-  compressed_image->Set(
-      Image::kDxt5, 4, 8,
-      base::DataContainerPtr(base::DataContainer::Create(
-          reinterpret_cast<void*>(1), kNullFunction, false,
-          compressed_image->GetAllocator())));
-  s_data.cubemap->SetSubImage(
-      CubeMapTexture::kNegativeZ, 3U, math::Point2ui(12, 8), compressed_image);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Draw"));
+  s_data.shape->SetAttributeArray(s_data.attribute_array);
 
-  // Check the right call was made.
   Reset();
-  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
-  renderer->DrawScene(root);
-  // Subimages do not resize textures.
-  EXPECT_EQ(36864U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(32768U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  // Technically there is an errors since the cubemap is not compressed, but
-  // this is just to test that the call is made.
-  gm_->SetErrorCode(GL_NO_ERROR);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CompressedTexSubImage2D"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "CompressedTexSubImage2D"))
-          .HasArg(2, "3")
-          .HasArg(3, "12")
-          .HasArg(4, "8")
-          .HasArg(5, "4")
-          .HasArg(6, "8")
-          .HasArg(7, "GL_COMPRESSED_RGBA_S3TC_DXT5_EXT"));
+  renderer = NULL;
 }
 
-TEST_F(RendererTest, CubeMapTextureMisc) {
-  // Test various texture corner cases.
+TEST_F(RendererTest, MultiDrawCombinesShapes) {
+  // Test that consecutive Shapes sharing vertex and index data are drawn with a
+  // single call, and that incompatible or instanced draws are not combined.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
   base::LogChecker log_checker;
+  NodePtr root = BuildGraph(kWidth, kHeight);
 
-  // Check that a texture with no image does not get sent.
-  for (int j = 0; j < 6; ++j)
-    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
-                             ImagePtr(NULL));
-  Reset();
-  renderer->DrawScene(root);
-  // The regular texture is still sent the first time.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING",
-                                     "texture face Negative X has no level"));
-  Reset();
-  s_data.cubemap->SetImage(CubeMapTexture::kNegativeX, 0U, s_data.image);
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING",
-                                     "texture face Negative Y has no level"));
   Reset();
-  s_data.cubemap->SetImage(CubeMapTexture::kNegativeY, 0U, s_data.image);
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING",
-                                     "texture face Negative Z has no level"));
-
-  // Make the texture valid.
-  for (int j = 0; j < 6; ++j)
-    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
-                             s_data.image);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MultiDrawElements("));
 
-  // Check that a GenerateMipmap is called if requested.
-  s_data.sampler->SetAutogenerateMipmapsEnabled(true);
-  Reset();
-  renderer->DrawScene(root);
-  // Both the cubemap and texture will generate mipmaps.
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  // Check that when disabled GenerateMipmap is not called.
-  s_data.sampler->SetAutogenerateMipmapsEnabled(false);
+  ShapePtr shape(new Shape);
+  shape->SetAttributeArray(s_data.attribute_array);
+  shape->SetIndexBuffer(s_data.index_buffer);
+  shape->SetPrimitiveType(s_data.shape->GetPrimitiveType());
+  s_data.rect->AddShape(shape);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MultiDrawElements("));
 
-  // Check error cases for equal cubemap sizes.
-  s_data.image->Set(s_options.image_format, 32, 33, s_data.image_container);
-  s_data.sampler->SetMinFilter(Sampler::kLinearMipmapNearest);
-  s_data.sampler->SetWrapS(Sampler::kClampToEdge);
+  // Without the function group the draws are sent separately.
+  gm_->EnableFunctionGroup(GraphicsManager::kMultiDraw, false);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(
-      log_checker.HasMessage("ERROR", "does not have square dimensions"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MultiDrawElements("));
+  gm_->EnableFunctionGroup(GraphicsManager::kMultiDraw, true);
 
-  // Check error cases for non-power-of-2 textures.
-  s_data.image->Set(s_options.image_format, 30, 30, s_data.image_container);
-  s_data.sampler->SetMinFilter(Sampler::kLinearMipmapNearest);
-  s_data.sampler->SetWrapS(Sampler::kClampToEdge);
+  // Different primitive types cannot be combined.
+  shape->SetPrimitiveType(Shape::kPoints);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MultiDrawElements("));
 
-  s_data.image->Set(s_options.image_format, 30, 30, s_data.image_container);
+  // Neither can instanced draws.
+  shape->SetPrimitiveType(s_data.shape->GetPrimitiveType());
+  shape->SetInstanceCount(2);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElementsInstanced("));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MultiDrawElements("));
 
-  s_data.image->Set(s_options.image_format, 30, 30, s_data.image_container);
-  s_data.sampler->SetWrapS(Sampler::kRepeat);
-  s_data.sampler->SetWrapT(Sampler::kClampToEdge);
+  // Sorted draw lists combine draws as well.
+  shape->SetInstanceCount(0);
+  renderer->SetFlag(Renderer::kSortDrawsByState);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MultiDrawElements("));
 
-  s_data.sampler->SetWrapT(Sampler::kRepeat);
-  Reset();
-  renderer->DrawScene(root);
+  s_data.rect->RemoveShape(shape);
   EXPECT_FALSE(log_checker.HasAnyMessages());
-
-  // Reset data.
-  BuildRectangle();
 }
 
-TEST_F(RendererTest, SamplersFollowTextures) {
-  // Test that a sampler follows a texture's binding when the texture's bind
-  // point changes. This can happen when a set of textures share a sampler and
-  // then the bind point changes for all of those textures (e.g., they are bound
-  // to a uniform and that uniform's bind point changes).
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  s_data.rect->ClearChildren();
-  s_data.rect->ClearUniforms();
-  s_data.rect->ClearShapes();
-
-  static const char* kFragmentShaderString = (
-      "uniform sampler2D uTexture1;\n"
-      "uniform sampler2D uTexture2;\n"
-      "varying vec2 vTexCoords;\n"
-      "\n"
-      "void main(void) {\n"
-      "  gl_FragColor = texture2D(uTexture, vTexCoords);\n"
-      "}\n");
-  static const char* kBaseShaderString = (
-      "varying vec2 vTexCoords;\n"
-      "\n"
-      "void main(void) {\n"
-      "  gl_FragColor = texture2D(uTexture, vTexCoords);\n"
-      "}\n");
+TEST_F(RendererTest, TextureWithZeroDimensionsAreNotAllocated) {
+  base::LogChecker log_checker;
 
-  // Create a shader that uses all of the image units.
-  GLuint num_textures = -1;
-  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
-                   reinterpret_cast<GLint*>(&num_textures));
-  std::ostringstream shader_string;
-  for (GLuint i = 0; i < num_textures; ++i) {
-    shader_string << "uniform sampler2D uTexture" << i << ";\n";
+  // A default scene should render fine.
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
   }
-  shader_string << kBaseShaderString;
-  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
-  reg->IncludeGlobalRegistry();
-  reg->Add(ShaderInputRegistry::AttributeSpec(
-      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
-  ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
-      "BigShader", reg, kPlaneVertexShaderString, shader_string.str(),
-      base::AllocatorPtr());
-
-  // Add a node with the full compliment of textures.
-  NodePtr node(new Node);
-  node->SetShaderProgram(shader);
-  node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uProjectionMatrix", math::Matrix4f::Identity()));
-  node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uModelviewMatrix", math::Matrix4f::Identity()));
 
-  SamplerPtr sampler(new Sampler());
-  s_data.sampler->SetLabel("Big Sampler");
-  for (GLuint j = 0; j < num_textures; ++j) {
-    // Make a unique name to create a new Uniform for each texture.
-    std::ostringstream str;
-    str << "uTexture" << j;
+  s_data.image->Set(s_options.image_format, 0, 0, base::DataContainerPtr());
+  SetImages();
 
-    TexturePtr texture(new Texture);
-    texture->SetImage(0U, s_data.image);
-    texture->SetSampler(sampler);
-    node->AddUniform(reg->Create<Uniform>(str.str(), texture));
+  Reset();
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
   }
-  node->AddShape(s_data.shape);
-
-  ShaderInputRegistryPtr reg1(new ShaderInputRegistry);
-  reg1->IncludeGlobalRegistry();
-  reg1->Add(ShaderInputRegistry::AttributeSpec(
-      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
-  ShaderInputRegistryPtr reg2(new ShaderInputRegistry);
-  reg2->IncludeGlobalRegistry();
-  reg2->Add(ShaderInputRegistry::AttributeSpec(
-      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
-  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
-      "Shader1", reg1, kPlaneVertexShaderString, kFragmentShaderString,
-      base::AllocatorPtr());
-  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
-      "Shader2", reg2, kPlaneVertexShaderString, kFragmentShaderString,
-      base::AllocatorPtr());
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uProjectionMatrix", math::Matrix4f::Identity()));
 
-  // Add two nodes that have both textures.
-  TexturePtr texture1(new Texture);
-  texture1->SetImage(0U, s_data.image);
-  texture1->SetSampler(s_data.sampler);
-  TexturePtr texture2(new Texture);
-  texture2->SetImage(0U, s_data.image);
-  texture2->SetSampler(s_data.sampler);
-  NodePtr node1(new Node);
-  node1->SetShaderProgram(shader1);
-  node1->AddUniform(reg1->Create<Uniform>("uTexture1", texture1));
-  node1->AddUniform(reg1->Create<Uniform>("uTexture2", texture2));
-  node1->AddShape(s_data.shape);
-  s_data.rect->AddChild(node1);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  Build2dImage();
+}
 
-  NodePtr node2(new Node);
-  node2->SetShaderProgram(shader2);
-  node2->AddUniform(reg2->Create<Uniform>("uTexture1", texture1));
-  node2->AddUniform(reg2->Create<Uniform>("uTexture2", texture2));
-  node2->AddShape(s_data.shape);
-  s_data.rect->AddChild(node2);
+TEST_F(RendererTest, Texture3dWarningsWhenDisabled) {
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
 
-  // Each texture should be bound once, and the sampler bound to each unit.
+  // A default scene should render fine.
+  NodePtr root = BuildGraph(kWidth, kHeight);
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture"));
-  // 4 image units will be used since there are 4 distinct uniforms.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE3)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE4)"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindSampler"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x0"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x1"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x2"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x3"));
-  // The image units should be sent.
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 
+  // Using a 3D image should be no problem if the function group is available.
+  Build3dImage();
   Reset();
   renderer->DrawScene(root);
-  // Nothing new should be sent.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindSampler"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
-
-  // Force the uniform -> image unit associations to change by rendering a big
-  // shader.
-  Reset();
-  renderer->DrawScene(node);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_LT(0U, trace_verifier_->GetCountOf("TexImage3D"));
 
-  // Check that the samplers were bound correctly.
+  // Without the function group we get an error.
+  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, false);
+  Build3dImage();
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindSampler"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x4"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x5"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x6"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x7"));
-  // The new image units should be sent again.
-  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
-}
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "3D texturing is not supported"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage3D"));
 
-TEST_F(RendererTest, MissingSamplerCausesWarning) {
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  base::LogChecker log_checker;
+  s_options.image_format = Image::kDxt5;
+  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, true);
+  Build3dImage();
   Reset();
   renderer->DrawScene(root);
   EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_LT(0U, trace_verifier_->GetCountOf("CompressedTexImage3D"));
 
-  s_data.texture->SetSampler(SamplerPtr());
+  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, false);
+  Build3dImage();
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "has no Sampler!"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "3D texturing is not supported"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("CompressedTexImage3D"));
 
-  s_data.texture->SetSampler(s_data.sampler);
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
+  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, true);
 }
 
-TEST_F(RendererTest, ImmutableTextures) {
+TEST_F(RendererTest, TextureTargets) {
   RendererPtr renderer(new Renderer(gm_));
+
+  // Test usage of TexImage2D.
   NodePtr root = BuildGraph(kWidth, kHeight);
+  Reset();
+  renderer->DrawScene(root);
 
-  // Create immutable textures and test the proper TexStorage calls are made.
   Build1dArrayImage();
   Reset();
-  EXPECT_TRUE(VerifyImmutableTexture<Texture>(
-      renderer, trace_verifier_, 3, "TexStorage2D(GL_TEXTURE_1D_ARRAY, "));
-  Reset();
-  // 1D cubemaps are illegal.
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_1D_ARRAY"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE"));
 
   Build2dImage();
   Reset();
-  EXPECT_TRUE(VerifyImmutableTexture<Texture>(renderer, trace_verifier_, 2,
-                                              "TexStorage2D(GL_TEXTURE_2D, "));
-  Reset();
-  EXPECT_TRUE(VerifyImmutableTexture<CubeMapTexture>(
-      renderer, trace_verifier_, 4, "TexStorage2D(GL_TEXTURE_CUBE_MAP, "));
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D, "));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE"));
 
   Build2dArrayImage();
   Reset();
-  EXPECT_TRUE(VerifyImmutableTexture<Texture>(
-      renderer, trace_verifier_, 4, "TexStorage3D(GL_TEXTURE_2D_ARRAY, "));
-  Reset();
-  EXPECT_TRUE(VerifyImmutableTexture<CubeMapTexture>(
-      renderer, trace_verifier_, 3,
-      "TexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, "));
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_2D_ARRAY"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_CUBE"));
 
   Build3dImage();
   Reset();
-  EXPECT_TRUE(VerifyImmutableTexture<Texture>(
-      renderer, trace_verifier_, 3, "TexStorage3D(GL_TEXTURE_3D, "));
-  // 3D cubemaps are illegal.
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_3D, "));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage3D(GL_TEXTURE_CUBE"));
 
-  s_data.image.Reset(NULL);
+  {
+    base::LogChecker log_checker;
+    BuildExternalEglImage();
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(7U, trace_verifier_->GetCountOf(
+                      "EGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, "));
+    EXPECT_TRUE(log_checker.HasMessage("WARNING", "number of components"));
+  }
+
+  BuildEglImage();
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf(
+                    "EGLImageTargetTexture2DOES(GL_TEXTURE_2D, "));
+  gm_->EnableFunctionGroup(GraphicsManager::kTexture3d, true);
 }
 
-TEST_F(RendererTest, ImmutableMultisampleTextures) {
+TEST_F(RendererTest, ImageFormat) {
+  // Test image format usage.
   RendererPtr renderer(new Renderer(gm_));
   NodePtr root = BuildGraph(kWidth, kHeight);
+  TracingHelper helper;
+  base::LogChecker log_checker;
 
-  Build2dImage();
-  Reset();
-  EXPECT_TRUE(VerifyImmutableMultisampledTexture<Texture>(
-      renderer, trace_verifier_, 8,
-      "TexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, "));
+  // Save image dimensions.
+  const uint32 width_2d = s_data.image->GetWidth();
+  const uint32 height_2d = s_data.image->GetHeight();
 
-  Build2dArrayImage();
-  Reset();
-  EXPECT_TRUE(VerifyImmutableMultisampledTexture<Texture>(
-      renderer, trace_verifier_, 8,
-      "TexStorage3DMultisample(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, "));
-
-  s_data.image.Reset(NULL);
-}
+  Build3dImage();
+  const uint32 width_3d = s_data.image->GetWidth();
+  const uint32 height_3d = s_data.image->GetHeight();
+  const uint32 depth_3d = s_data.image->GetDepth();
 
-TEST_F(RendererTest, TextureEvictionCausesRebind) {
-  // Test that when a texture is evicted from an image unit by a texture from a
-  // different uniform that the original texture will be rebound when drawn
-  // again.
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  s_data.rect->ClearChildren();
-  s_data.rect->ClearUniforms();
-  s_data.rect->ClearShapes();
+  // Test usage of TexImage2D.
+  VerifyRenderData<Image::Format> verify_2d_data;
+  verify_2d_data.update_func = Build2dImage;
+  verify_2d_data.option = &s_options.image_format;
+  verify_2d_data.call_name = "TexImage2D";
+  verify_2d_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
+  verify_2d_data.static_args.push_back(StaticArg(2, "0"));
+  verify_2d_data.static_args.push_back(
+      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_2d))));
+  verify_2d_data.static_args.push_back(StaticArg(
+      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_2d))));
+  verify_2d_data.static_args.push_back(StaticArg(7, "0"));  // Format.
+  verify_2d_data.static_args.push_back(StaticArg(8, "0"));  // Type.
+  verify_2d_data.static_args.push_back(
+      StaticArg(9, helper.ToString(
+          "void*", s_data.image_container->GetData())));
+  verify_2d_data.varying_arg_index = 3U;
 
-  // Add many nodes with different textures bound to different uniforms; they
-  // will eventually wrap image units.
-  GLuint num_textures = -1;
-  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
-                   reinterpret_cast<GLint*>(&num_textures));
+  // Test usage of TexImage3D.
+  VerifyRenderData<Image::Format> verify_3d_data;
+  verify_3d_data.update_func = Build3dImage;
+  verify_3d_data.option = &s_options.image_format;
+  verify_3d_data.call_name = "TexImage3D";
+  verify_3d_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_3D"));
+  verify_3d_data.static_args.push_back(StaticArg(2, "0"));
+  verify_3d_data.static_args.push_back(
+      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_3d))));
+  verify_3d_data.static_args.push_back(StaticArg(
+      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_3d))));
+  verify_3d_data.static_args.push_back(
+      StaticArg(6, helper.ToString("GLsizei", static_cast<GLsizei>(depth_3d))));
+  verify_3d_data.static_args.push_back(StaticArg(8, "0"));  // Format.
+  verify_3d_data.static_args.push_back(StaticArg(9, "0"));  // Type.
+  verify_3d_data.static_args.push_back(
+      StaticArg(10, helper.ToString(
+          "void*", s_data.image_container->GetData())));
+  verify_3d_data.varying_arg_index = 3U;
 
-  // Construct a shader with many textures.
-  static const char* kBaseShaderString = (
-      "varying vec2 vTexCoords;\n"
-      "\n"
-      "void main(void) {\n"
-      "  gl_FragColor = texture2D(uTexture, vTexCoords);\n"
-      "}\n");
-  std::ostringstream shader_string;
-  for (GLuint i = 0; i < num_textures; ++i) {
-    shader_string << "uniform sampler2D uTexture" << i << ";\n";
+  int last_component_count = 0;
+  for (uint32 i = 0; i < Image::kNumFormats - 1U; ++i) {
+    const Image::Format format = static_cast<Image::Format>(i);
+    if (!Image::IsCompressedFormat(format)) {
+      const Image::PixelFormat& pf = Image::GetPixelFormat(format);
+      if (pf.internal_format != GL_STENCIL_INDEX8) {
+        verify_2d_data.static_args[4] =
+            StaticArg(7, helper.ToString("GLenum", pf.format));
+        verify_2d_data.static_args[5] =
+            StaticArg(8, helper.ToString("GLenum", pf.type));
+        verify_3d_data.static_args[5] =
+            StaticArg(8, helper.ToString("GLenum", pf.format));
+        verify_3d_data.static_args[6] =
+            StaticArg(9, helper.ToString("GLenum", pf.type));
+        verify_2d_data.arg_tests.clear();
+        verify_3d_data.arg_tests.clear();
+        VaryingArg<Image::Format> arg = VaryingArg<Image::Format>(
+            0, format, helper.ToString("GLenum", pf.internal_format));
+        verify_2d_data.arg_tests.push_back(arg);
+        verify_3d_data.arg_tests.push_back(arg);
+        EXPECT_TRUE(
+            VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+        const int component_count = Image::GetNumComponentsForFormat(format);
+        if (last_component_count && component_count < last_component_count) {
+          EXPECT_TRUE(log_checker.HasMessage(
+              "WARNING", "the number of components for this upload is"));
+        } else {
+          EXPECT_FALSE(log_checker.HasAnyMessages());
+        }
+        EXPECT_TRUE(
+            VerifyRenderCalls(verify_3d_data, trace_verifier_, renderer, root));
+        EXPECT_FALSE(log_checker.HasAnyMessages());
+        last_component_count = component_count;
+      }
+    }
   }
-  shader_string << kBaseShaderString;
-  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
-  reg->IncludeGlobalRegistry();
-  reg->Add(ShaderInputRegistry::AttributeSpec(
-      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
-  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
-      "Shader1", reg, kPlaneVertexShaderString, shader_string.str(),
-      base::AllocatorPtr());
-  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
-      "Shader2", reg, kPlaneVertexShaderString, shader_string.str(),
-      base::AllocatorPtr());
-
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uProjectionMatrix", math::Matrix4f::Identity()));
 
-  // Add a node with the full compliment of textures.
-  NodePtr node(new Node);
-  node->SetShaderProgram(shader1);
-  for (GLuint j = 0; j < num_textures; ++j) {
-    // Make a unique name to create a new Uniform for each texture.
-    std::ostringstream str;
-    str << "uTexture" << j;
+  // Test deprecation of luminance and luminance-alpha textures on newer desktop
+  // GL. In the following paragraph, static_args[4] corresponds to the pixel
+  // format (the 7th arg to glTexImage2D), and arg_tests[0] corresponds to the
+  // internal format (the 3rd arg to glTexImage2D).
+  verify_2d_data.static_args[5] = StaticArg(8, "GL_UNSIGNED_BYTE");
 
-    TexturePtr texture(new Texture);
-    texture->SetImage(0U, s_data.image);
-    texture->SetSampler(s_data.sampler);
-    node->AddUniform(reg->Create<Uniform>(str.str(), texture));
-  }
-  node->AddShape(s_data.shape);
-  s_data.rect->AddChild(node);
+  // Luminance remains luminance in OpenGL 2.9.
+  gm_->SetVersionString("2.9 Ion OpenGL");
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(0, Image::kLuminance, "GL_LUMINANCE");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-  // Each texture should be bound once.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
-  for (GLuint i = 1; i < num_textures; ++i) {
-    std::ostringstream str;
-    str << "ActiveTexture(GL_TEXTURE" << i << ")";
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
-  }
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("BindSampler"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("Uniform1i"));
+  // R8 becomes luminance in OpenGL 2.9.
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(0, Image::kR8, "GL_LUMINANCE");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-  // Drawing again should do nothing, since everything is already bound.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+  // Luminance becomes R8 in OpenGL 3.0.
+  gm_->SetVersionString("3.0 Ion OpenGL");
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(0, Image::kLuminance, "GL_R8");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_RED");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-  // Drawing again with a framebuffer should rebind all textures, since they are
-  // all evicted when cleared.
-  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
-  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
-  Reset();
-  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  renderer->BindFramebuffer(fbo);
-  EXPECT_EQ(fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-  renderer->DrawScene(root);
-  renderer->BindFramebuffer(FramebufferObjectPtr());
-  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // Since all the sampler bindings were reset across the fbo bind, they will
-  // be bound again.
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("BindSampler"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+  // R8 remains R8 in OpenGL 3.0.
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(0, Image::kR8, "GL_R8");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_RED");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-  // Drawing again should rebind, since they are evicted when the framebuffer
-  // was changed.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("BindSampler"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+  // Luminance/alpha remains luminance/alpha in OpenGL 2.9.
+  gm_->SetVersionString("2.9 Ion OpenGL");
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(
+          0, Image::kLuminanceAlpha, "GL_LUMINANCE_ALPHA");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE_ALPHA");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-  // Add another node with the full compliment of textures.
-  node.Reset(new Node);
-  node->SetShaderProgram(shader2);
-  for (GLuint j = 0; j < num_textures; ++j) {
-    // Make a unique name to create a new Uniform for each texture.
-    std::ostringstream str;
-    str << "uTexture" << j;
+  // RG8 becomes luminance/alpha in OpenGL 2.9.
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(0, Image::kRg8, "GL_LUMINANCE_ALPHA");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_LUMINANCE_ALPHA");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-    TexturePtr texture(new Texture);
-    texture->SetImage(0U, s_data.image);
-    texture->SetSampler(s_data.sampler);
-    node->AddUniform(reg->Create<Uniform>(str.str(), texture));
-  }
-  node->AddShape(s_data.shape);
-  s_data.rect->AddChild(node);
+  // Luminance/alpha becomes RG8 in OpenGL 3.0.
+  gm_->SetVersionString("3.0 Ion OpenGL");
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(0, Image::kLuminanceAlpha, "GL_RG8");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_RG");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-  // Get the new resources created.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
-  for (GLuint i = 0; i < num_textures; ++i) {
-    std::ostringstream str;
-    str << "ActiveTexture(GL_TEXTURE" << i << ")";
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
-  }
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // The new texture uniforms should share the same units, but they have to be
-  // sent once for the new shader. The samplers, however, are already in the
-  // right place.
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("Uniform1i"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindSampler"));
+  // RG8 remains RG8 in OpenGL 3.0.
+  verify_2d_data.arg_tests[0] =
+      VaryingArg<Image::Format>(0, Image::kRg8, "GL_RG8");
+  verify_2d_data.static_args[4] = StaticArg(7, "GL_RG");
+  EXPECT_TRUE(
+      VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
 
-  // Drawing again should rebind everything, since all textures were evicted by
-  // the second node. The units should be consistent, however.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures * 2U,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures * 2U,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindSampler"));
+  gm_->SetVersionString("3.3 Ion OpenGL / ES");
 
-  // Reset data.
-  s_data.rect = NULL;
-  BuildRectangle();
-}
+  // Test compressed formats.
+  // The mock does not advertise ASTC support.
+  const std::string extensions(
+      reinterpret_cast<const char*>(gm_->GetString(GL_EXTENSIONS)));
+  gm_->SetExtensionsString(extensions + " GL_KHR_texture_compression_astc_ldr");
 
-TEST_F(RendererTest, ArrayTextureEvictionCausesRebind) {
-  // Similar to the above test but using array textures.
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  s_data.rect->ClearChildren();
-  s_data.rect->ClearUniforms();
-  s_data.rect->ClearShapes();
+  // The formats are ordered by number of components to avoid warnings.
+  Image::Format compressed_formats[] = {
+      Image::kDxt1,        Image::kEtc1,        Image::kPvrtc1Rgb4,
+      Image::kEtc2Rgb,     Image::kDxt5,        Image::kPvrtc1Rgba2,
+      Image::kPvrtc1Rgba4, Image::kEtc2Rgba,    Image::kAstc4x4Rgba,
+      Image::kAstc8x8Rgba, Image::kAstc12x12Rgba};
+  const int num_compressed_formats =
+      static_cast<int>(arraysize(compressed_formats));
 
-  // Add many nodes with different textures bound to different uniforms; they
-  // will eventually wrap image units.
-  GLuint num_textures = -1;
-  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
-                   reinterpret_cast<GLint*>(&num_textures));
+  verify_3d_data.arg_tests.clear();
+  verify_3d_data.static_args.clear();
+  verify_3d_data.update_func = Build3dImage;
+  verify_3d_data.call_name = "CompressedTexImage3D";
+  verify_3d_data.option = &s_options.image_format;
+  verify_3d_data.static_args.push_back(StaticArg(2, "0"));
+  verify_3d_data.static_args.push_back(
+      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_3d))));
+  verify_3d_data.static_args.push_back(StaticArg(
+      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_3d))));
+  verify_3d_data.static_args.push_back(
+      StaticArg(6, helper.ToString("GLsizei", static_cast<GLsizei>(depth_3d))));
+  verify_3d_data.static_args.push_back(StaticArg(7, "0"));
+  verify_3d_data.static_args.push_back(
+      StaticArg(9, helper.ToString(
+          "void*", s_data.image_container->GetData())));
+  verify_3d_data.varying_arg_index = 3U;
 
-  // Construct a shader with many textures.
-  static const char* kBaseShaderString = (
-      "varying vec2 vTexCoords;\n"
-      "\n"
-      "void main(void) {\n"
-      "  gl_FragColor = texture2D(uTextures[0], vTexCoords);\n"
-      "}\n");
-  std::ostringstream shader_string;
-  shader_string << "uniform sampler2D uTextures[" << num_textures << "];\n";
-  shader_string << kBaseShaderString;
-  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
-  reg->IncludeGlobalRegistry();
-  reg->Add(ShaderInputRegistry::AttributeSpec(
-      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
-  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
-      "Shader1", reg, kPlaneVertexShaderString, shader_string.str(),
-      base::AllocatorPtr());
-  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
-      "Shader2", reg, kPlaneVertexShaderString, shader_string.str(),
-      base::AllocatorPtr());
+  verify_2d_data.update_func = Build2dImage;
+  verify_2d_data.arg_tests.clear();
+  verify_2d_data.static_args.clear();
+  verify_2d_data.call_name = "CompressedTexImage2D";
+  verify_2d_data.option = &s_options.image_format;
+  verify_2d_data.static_args.push_back(StaticArg(2, "0"));
+  verify_2d_data.static_args.push_back(
+      StaticArg(4, helper.ToString("GLsizei", static_cast<GLsizei>(width_2d))));
+  verify_2d_data.static_args.push_back(StaticArg(
+      5, helper.ToString("GLsizei", static_cast<GLsizei>(height_2d))));
+  verify_2d_data.static_args.push_back(StaticArg(6, "0"));
+  verify_2d_data.static_args.push_back(
+      StaticArg(8, helper.ToString(
+          "void*", s_data.image_container->GetData())));
+  verify_2d_data.varying_arg_index = 3U;
 
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uProjectionMatrix", math::Matrix4f::Identity()));
+  verify_2d_data.arg_tests.push_back(
+      VaryingArg<Image::Format>(
+          0, Image::kDxt1, "GL_COMPRESSED_RGB_S3TC_DXT1_EXT"));
+  verify_2d_data.static_args.push_back(StaticArg(
+      7, helper.ToString("GLsizei", static_cast<GLsizei>(Image::ComputeDataSize(
+                                        Image::kDxt1, width_2d, height_2d)))));
+  verify_3d_data.arg_tests.push_back(verify_2d_data.arg_tests[0]);
+  verify_3d_data.static_args.push_back(StaticArg(
+      8, helper.ToString("GLsizei",
+                         static_cast<GLsizei>(Image::ComputeDataSize(
+                             Image::kDxt1, width_3d, height_3d, depth_3d)))));
 
-  // Add a node with the full compliment of textures.
-  NodePtr node(new Node);
-  std::vector<TexturePtr> textures(num_textures);
-  node->SetShaderProgram(shader1);
-  for (GLuint i = 0; i < num_textures; ++i) {
-    textures[i].Reset(new Texture);
-    textures[i]->SetImage(0U, s_data.image);
-    textures[i]->SetSampler(s_data.sampler);
+  for (int i = 0; i < num_compressed_formats; ++i) {
+    const Image::Format format = compressed_formats[i];
+    SCOPED_TRACE(Image::GetFormatString(format));
+    verify_3d_data.arg_tests[0] = verify_2d_data.arg_tests[0] =
+        VaryingArg<Image::Format>(
+            0, format,
+            helper.ToString("GLenum",
+                            Image::GetPixelFormat(format).internal_format));
+    verify_2d_data.static_args[5] = StaticArg(
+        7,
+        helper.ToString("GLsizei", static_cast<GLsizei>(Image::ComputeDataSize(
+                                       format, width_2d, height_2d))));
+    verify_3d_data.static_args[6] = StaticArg(
+        8, helper.ToString("GLsizei",
+                           static_cast<GLsizei>(Image::ComputeDataSize(
+                               format, width_3d, height_3d, depth_3d))));
+    EXPECT_TRUE(
+        VerifyRenderCalls(verify_2d_data, trace_verifier_, renderer, root));
+    // The first time through there is a warning about having fewer components
+    // since the last image sent above was RGBA.
+    if (!i)
+      EXPECT_TRUE(log_checker.HasMessage(
+          "WARNING", "the number of components for this upload is"));
+    else
+      EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(
+        VerifyRenderCalls(verify_3d_data, trace_verifier_, renderer, root));
+    EXPECT_FALSE(log_checker.HasAnyMessages());
   }
-  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
-  node->AddShape(s_data.shape);
-  s_data.rect->AddChild(node);
 
-  // Each texture should be bound once.
   Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
-  for (GLuint i = 0; i < num_textures; ++i) {
-    SCOPED_TRACE(i);
-    std::ostringstream str;
-    str << "ActiveTexture(GL_TEXTURE" << i << ")";
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
-  }
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
 
-  // Drawing again should do nothing, since everything is already bound.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+TEST_F(RendererTest, FramebufferObject) {
+  s_options.image_format = Image::kRgba8888;
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
 
-  // Drawing again with a framebuffer should rebind all textures, since they are
-  // all evicted when cleared.
-  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
-  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
-  Reset();
-  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  renderer->BindFramebuffer(fbo);
-  EXPECT_EQ(fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-  renderer->DrawScene(root);
-  renderer->BindFramebuffer(FramebufferObjectPtr());
-  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
+  // Several images of different sizes.
+  static const uint32 kMaxImageSize = 32;
+  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
+  ImagePtr mipmaps[kNumMipmaps];
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
+                                 Image::kRgb888);
 
-  // Drawing again should rebind, since they are evicted when the framebuffer
-  // was changed.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+  uint32 texture_width = s_data.texture->GetImage(0U)->GetWidth();
+  uint32 texture_height = s_data.texture->GetImage(0U)->GetHeight();
+  s_data.fbo = new FramebufferObject(0, texture_height);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "zero width or height"));
 
-  // Add another node with the full compliment of textures.
-  textures.clear();
-  textures.resize(num_textures);
-  node.Reset(new Node);
-  node->SetShaderProgram(shader2);
-  for (GLuint i = 0; i < num_textures; ++i) {
-    textures[i].Reset(new Texture);
-    textures[i]->SetImage(0U, s_data.image);
-    textures[i]->SetSampler(s_data.sampler);
-  }
-  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
-  node->AddShape(s_data.shape);
-  s_data.rect->AddChild(node);
+  s_data.fbo = new FramebufferObject(texture_width, 0);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "zero width or height"));
 
-  // Get the new resources created.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
-  for (GLuint i = 0; i < num_textures; ++i) {
-    std::ostringstream str;
-    str << "ActiveTexture(GL_TEXTURE" << i << ")";
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
-  }
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  // The texture uniforms for the new shader get their bindings.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
+  s_data.fbo = new FramebufferObject(texture_width, texture_height);
 
-  // Drawing again should rebind everything, since all textures were evicted by
-  // the second node.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures * 2U,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures * 2U,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    // Test an incomplete framebuffer.
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "Framebuffer is not complete"));
 
-  // Reset data.
-  s_data.rect = NULL;
-  BuildRectangle();
-}
+    // Check no calls are made if there is no node.
+    Reset();
+    renderer->DrawScene(NodePtr());
+    EXPECT_EQ(0U, trace_verifier_->GetCallCount());
+  }
 
-TEST_F(RendererTest, ArrayCubemapEvictionCausesRebind) {
-  // The same as the above test but using array cubemaps.
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  s_data.rect->ClearChildren();
-  s_data.rect->ClearUniforms();
-  s_data.rect->ClearShapes();
+  {
+    // Check a texture color attachment.
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.texture));
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindFramebuffer"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("FramebufferTexture2D"));
 
-  // Add many nodes with different textures bound to different uniforms; they
-  // will eventually wrap image units.
-  GLuint num_textures = -1;
-  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
-                   reinterpret_cast<GLint*>(&num_textures));
+    // Should not be multisampled.
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
 
-  // Construct a shader with many textures.
-  static const char* kBaseShaderString = (
-      "varying vec2 vTexCoords;\n"
-      "\n"
-      "void main(void) {\n"
-      "  gl_FragColor = texture2D(uTextures[0], vTexCoords);\n"
-      "}\n");
-  std::ostringstream shader_string;
-  shader_string << "uniform samplerCube uTextures[" << num_textures << "];\n";
-  shader_string << kBaseShaderString;
-  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
-  reg->IncludeGlobalRegistry();
-  reg->Add(ShaderInputRegistry::AttributeSpec(
-      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
-  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
-      "Shader1", reg, kPlaneVertexShaderString, shader_string.str(),
-      base::AllocatorPtr());
-  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
-      "Shader2", reg, kPlaneVertexShaderString, shader_string.str(),
-      base::AllocatorPtr());
+    // Check that the texture was generated and bound before being bound as
+    // the framebuffer's attachment.
+    EXPECT_LT(trace_verifier_->GetNthIndexOf(0U, "TexImage2D"),
+              trace_verifier_->GetNthIndexOf(
+                  0U, "FramebufferTexture2D(GL_RENDERBUFFER"));
 
-  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
-      "uProjectionMatrix", math::Matrix4f::Identity()));
+    // Check args to FramebufferTexture2D.
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+          trace_verifier_->GetNthIndexOf(0U, "FramebufferTexture2D"))
+              .HasArg(3, "GL_TEXTURE_2D"));
 
-  // Add a node with the full compliment of textures.
-  NodePtr node(new Node);
-  std::vector<CubeMapTexturePtr> textures(num_textures);
-  node->SetShaderProgram(shader1);
-  for (GLuint i = 0; i < num_textures; ++i) {
-    textures[i].Reset(new CubeMapTexture);
-    for (int j = 0; j < 6; ++j)
-      textures[i]->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
-                            s_data.image);
-    textures[i]->SetSampler(s_data.sampler);
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
   }
-  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
-  node->AddShape(s_data.shape);
-  s_data.rect->AddChild(node);
 
-  // Each texture should be bound once.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures * 6U, trace_verifier_->GetCountOf("TexImage2D"));
-  for (GLuint i = 0; i < num_textures; ++i) {
-    SCOPED_TRACE(i);
-    std::ostringstream str;
-    str << "ActiveTexture(GL_TEXTURE" << i << ")";
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
-  }
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
+  {
+    // Check that the current fbo follows the current visual.
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.texture));
+    FramebufferObjectPtr fbo2(
+        new FramebufferObject(texture_width, texture_height));
+    fbo2->SetColorAttachment(0U, FramebufferObject::Attachment(s_data.texture));
 
-  // Drawing again should do nothing, since everything is already bound.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
 
-  // Drawing again with a framebuffer should rebind all textures, since they are
-  // all evicted when cleared.
-  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
-  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
-  Reset();
-  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  renderer->BindFramebuffer(fbo);
-  EXPECT_EQ(fbo.Get(), renderer->GetCurrentFramebuffer().Get());
-  renderer->DrawScene(root);
-  renderer->BindFramebuffer(FramebufferObjectPtr());
-  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
+    MockVisual share_visual(*visual_);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    portgfx::Visual::MakeCurrent(&share_visual);
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(fbo2);
+    EXPECT_EQ(fbo2.Get(), renderer->GetCurrentFramebuffer().Get());
 
-  // Drawing again should rebind, since they are evicted when the framebuffer
-  // was changed.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  // The texture uniforms are sent the first draw.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+    portgfx::Visual::MakeCurrent(visual_.get());
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
 
-  // Add another node with the full compliment of textures.
-  textures.clear();
-  textures.resize(num_textures);
-  node.Reset(new Node);
-  node->SetShaderProgram(shader2);
-  for (GLuint i = 0; i < num_textures; ++i) {
-    textures[i].Reset(new CubeMapTexture);
-    for (int j = 0; j < 6; ++j)
-      textures[i]->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
-                            s_data.image);
-    textures[i]->SetSampler(s_data.sampler);
+    portgfx::Visual::MakeCurrent(&share_visual);
+    EXPECT_EQ(fbo2.Get(), renderer->GetCurrentFramebuffer().Get());
+    // Destroy the shared resource binder.
+    Renderer::DestroyCurrentStateCache();
+    portgfx::Visual::MakeCurrent(visual_.get());
   }
-  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
-  node->AddShape(s_data.shape);
-  s_data.rect->AddChild(node);
 
-  // Get the new resources created.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures * 6U, trace_verifier_->GetCountOf("TexImage2D"));
-  for (GLuint i = 0; i < num_textures; ++i) {
-    std::ostringstream str;
-    str << "ActiveTexture(GL_TEXTURE" << i << ")";
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
-  }
-  EXPECT_EQ(num_textures,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  // The texture uniforms for the new shader get their bindings.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
+  {
+    // Check a texture color attachment that uses mipmaps.
+    // Set a full image pyramid.
+    for (uint32 i = 0; i < kNumMipmaps; ++i)
+      s_data.texture->SetImage(i, mipmaps[i]);
 
-  // Drawing again should rebind everything, since all textures were evicted by
-  // the second node.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(num_textures * 2U,
-            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
-  EXPECT_EQ(num_textures * 2U,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.texture));
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  // Reset data.
-  s_data.rect = NULL;
-  BuildRectangle();
-}
+    // Set up fbo to draw into first mip level.
+    FramebufferObjectPtr mip_fbo(new FramebufferObject(
+        texture_width >> 1, texture_height >> 1));
+    mip_fbo->SetColorAttachment(0U,
+        FramebufferObject::Attachment(s_data.texture, 1));
+    Reset();
+    renderer->BindFramebuffer(mip_fbo);
+    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
 
-TEST_F(RendererTest, TextureMipmaps) {
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  base::LogChecker log_checker;
-  TracingHelper helper;
+    // Expect mismatched dimensions error.
+    mip_fbo->SetColorAttachment(0U,
+        FramebufferObject::Attachment(s_data.texture, 0));
+    Reset();
+    renderer->BindFramebuffer(mip_fbo);
+    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    s_msg_stream_ << "Mismatched Texture and FBO dimensions: 32 x 32 "
+        "vs. 16 x 16";
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
+  }
 
-  // Check that a texture with an image is sent as mipmap level 0.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(28672U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "TexImage2D"))
-          .HasArg(2, "0"));
+  {
+    // Check a cubemap color attachment.
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.cubemap,
+                                          CubeMapTexture::kPositiveX));
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+  }
 
-  // Several images of different sizes.
-  static const uint32 kMaxImageSize = 32;
-  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
-  ImagePtr mipmaps[kNumMipmaps];
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
-                                 Image::kRgba8888);
+  {
+    // Check a cubemap color attachment that uses mipmaps.
+    // Set a full image pyramid for each face.
+    for (int j = 0; j < 6; ++j) {
+      for (uint32 i = 0; i < kNumMipmaps; ++i)
+        s_data.cubemap->SetImage(
+            static_cast<CubeMapTexture::CubeFace>(j), i, mipmaps[i]);
+    }
 
-  // Set a full image pyramid.
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    s_data.texture->SetImage(i, mipmaps[i]);
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.cubemap,
+                                          CubeMapTexture::kPositiveZ));
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  // Check consistent dimensions.
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_EQ(kNumMipmaps, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  // Check that the texture memory increased properly.
-  EXPECT_EQ(30037U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
+    // Set up fbo to draw into first mip level.
+    FramebufferObjectPtr mip_fbo(
+        new FramebufferObject(texture_width >> 1, texture_height >> 1));
+    mip_fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.cubemap,
+                                          CubeMapTexture::kPositiveZ, 1));
+    Reset();
+    renderer->BindFramebuffer(mip_fbo);
+    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  // Check the right calls were made.
-  for (uint32 i = 0; i < kNumMipmaps; ++i) {
-    SCOPED_TRACE(::testing::Message() << "Testing mipmap level " << i);
-    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-        trace_verifier_->GetNthIndexOf(i, "TexImage2D"))
-            .HasArg(2, helper.ToString("GLint", static_cast<GLint>(i)))
-            .HasArg(4, helper.ToString(
-                "GLsizei", static_cast<GLint>(mipmaps[i]->GetWidth())))
-            .HasArg(5, helper.ToString(
-                "GLsizei", static_cast<GLint>(mipmaps[i]->GetHeight()))));
+    // Expect mismatched dimensions error.
+    mip_fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.cubemap,
+                                          CubeMapTexture::kPositiveZ, 0));
+    Reset();
+    renderer->BindFramebuffer(mip_fbo);
+    EXPECT_EQ(mip_fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    s_msg_stream_ << "Mismatched CubeMapTexture and FBO dimensions: 32 x 32 "
+        "vs. 16 x 16";
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
   }
 
-  // Remove a texture and verify that GenerateMipmap is called.
-  s_data.texture->SetImage(1U, ImagePtr(NULL));
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  // Since GenerateMipmap was called the override mipmaps were sent, but the
-  // 0th level mipmap doesn't have to be (GenerateMipmap won't override it).
-  EXPECT_EQ(kNumMipmaps - 2U, trace_verifier_->GetCountOf("TexImage2D"));
-  // Memory usage should not change.
-  EXPECT_EQ(30037U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
-
-  // Set an invalid image dimension.
-  s_data.texture->SetImage(
-      1U, CreateNullImage(mipmaps[1]->GetWidth() - 1, mipmaps[1]->GetHeight(),
-                          Image::kRgba8888));
-
-  Reset();
-  renderer->DrawScene(root);
-  // Nothing will be called since the texture has the right number of levels,
-  // just incorrect dimensions.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  s_msg_stream_ << "Mipmap width: " << (mipmaps[1]->GetWidth() - 1) <<
-      " is not a power of 2.";
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
-  // Memory usage should not change.
-  EXPECT_EQ(30037U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
-
-  s_data.texture->SetImage(
-      1U, CreateNullImage(mipmaps[1]->GetWidth(), mipmaps[1]->GetHeight() - 1,
-                          Image::kRgba8888));
+  {
+    // Check renderbuffer types.
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(Image::kRgba4Byte));
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "FramebufferRenderbuffer(GL_FRAMEBUFFER"))
+                .HasArg(4, "0x1"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLenum", static_cast<GLenum>(GL_RGBA4))));
 
-  Reset();
-  renderer->DrawScene(root);
-  // Nothing will be called since the texture has the right number of levels,
-  // just incorrect dimensions.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  s_msg_stream_ << "Mipmap height: " << (mipmaps[1]->GetWidth() - 1) <<
-      " is not a power of 2.";
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
-  // Memory usage should not change.
-  EXPECT_EQ(30037U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(Image::kRgb565Byte));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLenum", static_cast<GLenum>(GL_RGB565))));
 
-  // Set an invalid image dimension.
-  s_data.texture
-      ->SetImage(1U, CreateNullImage(mipmaps[1]->GetWidth(),
-                                     mipmaps[1]->GetHeight(), Image::kRgb888));
-  Reset();
-  renderer->DrawScene(root);
-  // Nothing will be called since the texture has the right number of levels,
-  // just incorrect dimensions.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_TRUE(
-      log_checker.HasMessage("ERROR", "level 1 has different format"));
-  // Memory usage should not change.
-  EXPECT_EQ(30037U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
-}
+    static uint8 kData[12] = {0x1, 0x2, 0x3, 0x4, 0x5, 0x6,
+                              0x7, 0x8, 0x9, 0xa, 0xb, 0xc};
+    ImagePtr egl_image(new Image);
+    egl_image->SetEglImage(base::DataContainer::Create<void>(
+        kData, kNullFunction, false, egl_image->GetAllocator()));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(egl_image));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                      "EGLImageTargetRenderbufferStorageOES"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "FramebufferRenderbuffer(GL_FRAMEBUFFER"))
+                .HasArg(4, "0x1"));
 
-TEST_F(RendererTest, TextureMultisamplingDisablesMipmapping) {
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  base::LogChecker log_checker;
-  TracingHelper helper;
+    egl_image->SetEglImage(base::DataContainer::Create<void>(
+        nullptr, kNullFunction, false, egl_image->GetAllocator()));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    // Since the buffer is nullptr nothing will be set.  This isn't an error
+    // since the caller could just set it manually through OpenGL directly.
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf(
+                      "EGLImageTargetRenderbufferStorageOES"));
 
-  Reset();
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(Image::kRgb5a1Byte));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLenum", static_cast<GLenum>(GL_RGB5_A1))));
 
-  EXPECT_TRUE(gm_->IsFunctionGroupAvailable(
-      GraphicsManager::kTextureMultisample));
+    s_data.fbo->SetDepthAttachment(
+        FramebufferObject::Attachment(Image::kRenderbufferDepth16));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLenum", static_cast<GLenum>(GL_DEPTH_COMPONENT16))));
 
-  // Set multisampling.
-  s_data.texture->SetMultisampling(4, true);
-  // Clear cubemap as we don't need it and it affects the number of times
-  // TexImage2D is invoked.
-  for (int i = 0; i < 6; ++i) {
-    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
-                             ImagePtr());
+    s_data.fbo->SetStencilAttachment(
+        FramebufferObject::Attachment(Image::kStencil8));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorage(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLenum", static_cast<GLenum>(GL_STENCIL_INDEX8))));
   }
 
-  renderer->DrawScene(root);
-  EXPECT_EQ(4096U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-
-  // Verify call to TexImage2DMultisample.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
-          .HasArg(1, "GL_TEXTURE_2D_MULTISAMPLE"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
-          .HasArg(2, "4"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
-          .HasArg(6, "GL_TRUE"));
-
-  // Verify calls to TexImage2D and GenerateMipmap. "TexImage2D" is a prefix
-  // of "TexImage2DMultisample" so it should appear once.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-
-  // Several images of different sizes.
-  static const uint32 kMaxImageSize = 32;
-  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
-  ImagePtr mipmaps[kNumMipmaps];
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
-                                 Image::kRgba8888);
-
-  // Set a full image pyramid.
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    s_data.texture->SetImage(i, mipmaps[i]);
-
-  // Mipmaps will be counted against memory but should still not be used.
-  // "TexImage2D" is a prefix of "TexImage2DMultisample" so it should appear
-  // once.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  // Check that the texture memory is as expected.
-  EXPECT_EQ(5461U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
+  {
+    // Check color render buffer for multisamping.
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(Image::kRgba8, 4));
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLsizei", static_cast<GLsizei>(4))));
 
-  // Unset multisampling.
-  s_data.texture->SetMultisampling(0, false);
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(Image::kRgba8, 2));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLsizei", static_cast<GLsizei>(2))));
+  }
 
-  // Mipmaps should now be used.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  // Check that the texture memory stayed the same.
-  EXPECT_EQ(5461U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
+  {
+    // Use a new fbo instead of the old one since we don't care about
+    // color buffer.
+    s_data.fbo = new FramebufferObject(texture_width, texture_height);
+    // Check depth render buffer for multisamping.
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetDepthAttachment(FramebufferObject::Attachment(
+        kDepthBufferFormat, 4));
+    Reset();
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    renderer->BindFramebuffer(s_data.fbo);
+    EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLsizei", static_cast<GLsizei>(4))));
 
-  // Clear warning from clearing the cubemap textures above.
-  EXPECT_TRUE(log_checker.HasMessage("WARNING",
-      "***ION: Cubemap texture face Negative X has no level 0 mipmap."));
+     s_data.fbo->SetDepthAttachment(
+         FramebufferObject::Attachment(kDepthBufferFormat, 2));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorageMultisample(GL_RENDERBUFFER"))
+                .HasArg(2, helper.ToString(
+                    "GLsizei", static_cast<GLsizei>(2))));
+  }
 }
 
-TEST_F(RendererTest, TextureMultisamplingDisablesSubImages) {
-  RendererPtr renderer(new Renderer(gm_));
+TEST_F(RendererTest, FramebufferObjectMultisampleTextureAttachment) {
+  s_options.image_format = Image::kRgba8888;
   NodePtr root = BuildGraph(kWidth, kHeight);
   base::LogChecker log_checker;
   TracingHelper helper;
 
-  Reset();
-
-  EXPECT_TRUE(gm_->IsFunctionGroupAvailable(
-      GraphicsManager::kTextureMultisample));
+  uint32 texture_width = s_data.texture->GetImage(0U)->GetWidth();
+  uint32 texture_height = s_data.texture->GetImage(0U)->GetHeight();
+  s_data.fbo = new FramebufferObject(texture_width, texture_height);
 
-  // Set multisampling.
-  s_data.texture->SetMultisampling(4, true);
-  // Clear cubemap as we don't need it and it affects the number of times
-  // TexImage2D is invoked.
-  for (int i = 0; i < 6; ++i) {
-    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
-                             ImagePtr());
-  }
+  // Enable multisampling.
+  s_data.texture->SetMultisampling(8, true);
 
-  renderer->DrawScene(root);
+  // Check a texture color attachment.
+  RendererPtr renderer(new Renderer(gm_));
+  s_data.fbo->SetColorAttachment(
+      0U, FramebufferObject::Attachment(s_data.texture));
+  Reset();
+  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+  renderer->BindFramebuffer(s_data.fbo);
+  EXPECT_EQ(s_data.fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindFramebuffer"));
   EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("FramebufferTexture2D"));
 
-  // Now set a subimage on the texture.
-  s_data.texture->SetSubImage(0U, math::Point2ui(4, 8),
-                              CreateNullImage(10, 12, Image::kRgba8888));
+  // Check args to TexImage2DMultisample.
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
+            .HasArg(1, "GL_TEXTURE_2D_MULTISAMPLE")
+            .HasArg(2, "8"));
+
+  // Check texture target arg to FramebufferTexture2D.
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(0U, "FramebufferTexture2D"))
+            .HasArg(3, "GL_TEXTURE_2D_MULTISAMPLE"));
 
-  // Check that the subimage is NOT applied.
-  Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  // Disable multisampling.
-  s_data.texture->SetMultisampling(0, false);
+TEST_F(RendererTest, FramebufferObjectMultiviewAttachment) {
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
 
-  // Check that the subimage is applied.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  // A texture without an image gets an array image with a layer per view.
+  TexturePtr texture(new Texture);
+  texture->SetSampler(s_data.sampler);
+  FramebufferObjectPtr fbo(new FramebufferObject(16, 16));
+  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(texture, 0U, 1U,
+                                                            2U));
+  fbo->SetDepthAttachment(
+      FramebufferObject::Attachment(Image::kRenderbufferDepth16));
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->BindFramebuffer(fbo);
+    ASSERT_TRUE(texture->HasImage(0U));
+    EXPECT_EQ(Image::kArray, texture->GetImage(0U)->GetType());
+    EXPECT_EQ(3U, texture->GetImage(0U)->GetDepth());
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage3D"));
+    ASSERT_EQ(1U,
+              trace_verifier_->GetCountOf("FramebufferTextureMultiviewOVR"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(0U, "FramebufferTextureMultiviewOVR"))
+            .HasArg(2, "GL_COLOR_ATTACHMENT0")
+            .HasArg(5, "1")
+            .HasArg(6, "2"));
+    GLint num_views = 0;
+    gm_->GetFramebufferAttachmentParameteriv(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR, &num_views);
+    EXPECT_EQ(2, num_views);
+    EXPECT_EQ(static_cast<GLenum>(GL_FRAMEBUFFER_COMPLETE),
+              gm_->CheckFramebufferStatus(GL_FRAMEBUFFER));
+
+    // The scene is drawn once for all views.
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U,
+              trace_verifier_->GetCountOf("FramebufferTextureMultiviewOVR"));
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+    renderer->BindFramebuffer(FramebufferObjectPtr());
+  }
 
-  // Clear warning from clearing the cubemap textures above.
-  EXPECT_TRUE(log_checker.HasMessage("WARNING",
-      "***ION: Cubemap texture face Negative X has no level 0 mipmap."));
+  // Without multiview support the attachment is left empty.
+  gm_->EnableFunctionGroup(GraphicsManager::kMultiview, false);
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->BindFramebuffer(fbo);
+    EXPECT_EQ(0U,
+              trace_verifier_->GetCountOf("FramebufferTextureMultiviewOVR"));
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "OVR_multiview"));
+    renderer->BindFramebuffer(FramebufferObjectPtr());
+  }
+  gm_->EnableFunctionGroup(GraphicsManager::kMultiview, true);
 }
 
-TEST_F(RendererTest, TextureSubImages) {
-  RendererPtr renderer(new Renderer(gm_));
+TEST_F(RendererTest, FramebufferObjectMultisampledTextureAttachment) {
   NodePtr root = BuildGraph(kWidth, kHeight);
   base::LogChecker log_checker;
-  TracingHelper helper;
 
-  // Check that a texture with an image is sent as mipmap level 0.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
+  TexturePtr texture(new Texture);
+  texture->SetSampler(s_data.sampler);
+  FramebufferObjectPtr fbo(new FramebufferObject(16, 16));
+  fbo->SetColorAttachment(
+      0U, FramebufferObject::Attachment::CreateMultisampledTexture(texture,
+                                                                   4U));
+  fbo->SetDepthAttachment(
+      FramebufferObject::Attachment(Image::kRenderbufferDepth16, 4U));
+  {
+    // The texture and the depth renderbuffer are both resolved implicitly, so
+    // no multisampled framebuffer or blit is needed.
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->BindFramebuffer(fbo);
+    ASSERT_EQ(1U, trace_verifier_->GetCountOf(
+                      "FramebufferTexture2DMultisampleEXT"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "FramebufferTexture2DMultisampleEXT"))
+            .HasArg(2, "GL_COLOR_ATTACHMENT0")
+            .HasArg(3, "GL_TEXTURE_2D")
+            .HasArg(6, "4"));
+    ASSERT_EQ(1U, trace_verifier_->GetCountOf(
+                      "RenderbufferStorageMultisampleEXT"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(
+            0U, "RenderbufferStorageMultisampleEXT"))
+            .HasArg(2, "4")
+            .HasArg(3, "GL_DEPTH_COMPONENT16"));
+    EXPECT_EQ(0U,
+              trace_verifier_->GetCountOf("RenderbufferStorageMultisample("));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("FramebufferTexture2D("));
+    GLint samples = 0;
+    gm_->GetFramebufferAttachmentParameteriv(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_SAMPLES_EXT, &samples);
+    EXPECT_EQ(4, samples);
+    EXPECT_EQ(static_cast<GLenum>(GL_FRAMEBUFFER_COMPLETE),
+              gm_->CheckFramebufferStatus(GL_FRAMEBUFFER));
+
+    // The depth samples need not be stored after the pass.
+    renderer->DrawScene(root);
+    Reset();
+    renderer->InvalidateFramebuffer(GL_DEPTH_BUFFER_BIT);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("InvalidateFramebuffer"));
+    EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  // Now set a subimage on the texture.
-  s_data.texture->SetSubImage(0U, math::Point2ui(4, 8),
-                              CreateNullImage(10, 12, Image::kRgba8888));
-  // Check that the subimage is applied.
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "TexSubImage2D"))
-          .HasArg(2, "0")
-          .HasArg(3, "4")
-          .HasArg(4, "8")
-          .HasArg(5, "10")
-          .HasArg(6, "12")
-          .HasArg(7, "GL_RGB")
-          .HasArg(8, "GL_UNSIGNED_BYTE"));
+    // Replacing the color attachment also reallocates the depth
+    // renderbuffer, which is now explicitly multisampled.
+    Reset();
+    fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(Image::kRgba8, 4U));
+    renderer->BindFramebuffer(fbo);
+    EXPECT_EQ(2U,
+              trace_verifier_->GetCountOf("RenderbufferStorageMultisample("));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf(
+                      "RenderbufferStorageMultisampleEXT"));
+    renderer->BindFramebuffer(FramebufferObjectPtr());
+  }
 
-  // Several images of different sizes.
-  static const uint32 kMaxImageSize = 32;
-  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
-  ImagePtr mipmaps[kNumMipmaps];
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
-                                 Image::kRgba8888);
+  // Without the extension the attachments are not multisampled.
+  fbo->SetColorAttachment(
+      0U, FramebufferObject::Attachment::CreateMultisampledTexture(texture,
+                                                                   4U));
+  gm_->EnableFunctionGroup(GraphicsManager::kMultisampledRenderToTexture,
+                           false);
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->BindFramebuffer(fbo);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("MultisampleEXT"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("FramebufferTexture2D("));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("RenderbufferStorage("));
+    EXPECT_EQ(static_cast<GLenum>(GL_FRAMEBUFFER_COMPLETE),
+              gm_->CheckFramebufferStatus(GL_FRAMEBUFFER));
+    EXPECT_TRUE(log_checker.HasMessage("WARNING", "without multisampling"));
+    renderer->BindFramebuffer(FramebufferObjectPtr());
+  }
+  gm_->EnableFunctionGroup(GraphicsManager::kMultisampledRenderToTexture,
+                           true);
+}
 
-  // Set a full image pyramid.
-  for (uint32 i = 0; i < kNumMipmaps; ++i)
-    s_data.texture->SetImage(i, mipmaps[i]);
+TEST_F(RendererTest, FramebufferObjectAttachmentsImplicitlyChangedByDraw) {
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
 
-  // Check consistent dimensions.
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_EQ(kNumMipmaps, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  EXPECT_EQ(30037U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
+  uint32 texture_width = s_data.texture->GetImage(0U)->GetWidth();
+  uint32 texture_height = s_data.texture->GetImage(0U)->GetHeight();
+  s_data.fbo = new FramebufferObject(texture_width, texture_height);
 
-  // Set a submipmap at level 3. Setting a compressed image requires non-NULL
-  // image data.
-  ImagePtr compressed_image(new Image);
-  compressed_image->Set(
-      Image::kDxt5, 4, 8,
-      base::DataContainerPtr(base::DataContainer::Create(
-          reinterpret_cast<void*>(1), kNullFunction, false,
-          compressed_image->GetAllocator())));
-  s_data.texture->SetSubImage(3U, math::Point2ui(2, 6), compressed_image);
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.texture));
+    s_data.sampler->SetAutogenerateMipmapsEnabled(true);
+    renderer->BindFramebuffer(s_data.fbo);
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+    Reset();
+    // Since the contents have changed, we should regenerate mipmaps.
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+    Reset();
+    // Same thing again.
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
 
-  // Check the right call was made.
-  Reset();
-  renderer->DrawScene(root);
-  // Technically there is an errors since the cubemap is not compressed, but
-  // this is just to test that the call is made.
-  gm_->SetErrorCode(GL_NO_ERROR);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CompressedTexSubImage2D"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "CompressedTexSubImage2D"))
-          .HasArg(2, "3")
-          .HasArg(3, "2")
-          .HasArg(4, "6")
-          .HasArg(5, "4")
-          .HasArg(6, "8")
-          .HasArg(7, "GL_COMPRESSED_RGBA_S3TC_DXT5_EXT"));
-  // Memory usage is not affected by sub images.
-  EXPECT_EQ(30037U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  EXPECT_EQ(5461U, s_data.texture->GetGpuMemoryUsed());
+    // Nothing should happen if mipmaps are disabled.
+    s_data.sampler->SetAutogenerateMipmapsEnabled(false);
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+  }
+
+  // Same thing with a cubemap face attachment.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    s_data.fbo->SetColorAttachment(
+        0U, FramebufferObject::Attachment(s_data.cubemap,
+                                          CubeMapTexture::kPositiveX));
+    s_data.sampler->SetAutogenerateMipmapsEnabled(true);
+    renderer->BindFramebuffer(s_data.fbo);
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+    Reset();
+    // Since the contents have changed, we should regenerate mipmaps.
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+    Reset();
+    // Same thing again.
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+
+    // Nothing should happen if mipmaps are disabled.
+    s_data.sampler->SetAutogenerateMipmapsEnabled(false);
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+
+    EXPECT_FALSE(log_checker.HasAnyMessages());
+  }
 }
 
-TEST_F(RendererTest, TextureMisc) {
-  // Test various texture corner cases.
+TEST_F(RendererTest, CubeMapTextureMipmaps) {
   RendererPtr renderer(new Renderer(gm_));
   NodePtr root = BuildGraph(kWidth, kHeight);
   base::LogChecker log_checker;
+  TracingHelper helper;
 
-  // Check that a texture with no image does not get sent.
-  s_data.texture->SetImage(0U, ImagePtr(NULL));
-  s_data.texture->SetLabel("texture");
+  // Check that each face of a CubeMapTexture with an image is sent as mipmap
+  // level 0.
   Reset();
   renderer->DrawScene(root);
-  // The cubemap is still sent.
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D"));
-  s_data.texture->SetImage(0U, s_data.image);
-  EXPECT_TRUE(
-      log_checker.HasMessage("WARNING", "Texture \"texture\" has no level 0"));
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 0U, 28672U));
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(i + 1U, "TexImage2D"))
+            .HasArg(2, "0"));
+  }
 
-  // Check that a GenerateMipmap is called if requested.
-  s_data.sampler->SetAutogenerateMipmapsEnabled(true);
-  Reset();
-  renderer->DrawScene(root);
-  // Both the cubemap and texture will generate mipmaps.
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenerateMipmap"));
-  // Check that when disabled GenerateMipmap is not called.
-  s_data.sampler->SetAutogenerateMipmapsEnabled(false);
+  // Several images of different sizes.
+  static const uint32 kMaxImageSize = 32;
+  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
+  ImagePtr mipmaps[kNumMipmaps];
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
+                                 Image::kRgba8888);
+
+  // Set a full image pyramid for each face.
+  for (int j = 0; j < 6; ++j) {
+    for (uint32 i = 0; i < kNumMipmaps; ++i)
+      s_data.cubemap->SetImage(
+          static_cast<CubeMapTexture::CubeFace>(j), i, mipmaps[i]);
+  }
+
+  // Check consistent dimensions.
+  EXPECT_FALSE(log_checker.HasAnyMessages());
   Reset();
   renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_EQ(kNumMipmaps * 6U, trace_verifier_->GetCountOf("TexImage2D"));
   EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // The cubemap now has mipmaps, so its usage includes every level.
+  EXPECT_EQ(36856U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(32760U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
 
-  // Check error cases for non-power-of-2 textures.
-  s_data.image->Set(s_options.image_format, 32, 33, s_data.image_container);
-  s_data.sampler->SetMinFilter(Sampler::kLinearMipmapNearest);
-  s_data.sampler->SetWrapS(Sampler::kClampToEdge);
+  // Check the right calls were made. First check the level 0 mipmaps.
+  for (uint32 j = 0; j < 6; ++j) {
+    SCOPED_TRACE(::testing::Message() << "Testing face " << j);
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(j, "TexImage2D"))
+            .HasArg(1, helper.ToString(
+                "GLenum", base::EnumHelper::GetConstant(
+                    static_cast<CubeMapTexture::CubeFace>(j))))
+            .HasArg(2, "0")
+            .HasArg(4, helper.ToString(
+                "GLsizei", static_cast<GLint>(mipmaps[0]->GetWidth())))
+            .HasArg(5, helper.ToString(
+                "GLsizei", static_cast<GLint>(mipmaps[0]->GetHeight()))));
+  }
+  // Now check the level 1+ mipmaps.
+  for (uint32 j = 0; j < 6; ++j) {
+  SCOPED_TRACE(::testing::Message() << "Testing face " << j);
+    for (uint32 i = 1; i < kNumMipmaps; ++i) {
+      SCOPED_TRACE(::testing::Message() << "Testing mipmap level " << i);
+      EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+          trace_verifier_->GetNthIndexOf(6U + j * (kNumMipmaps - 1U) + i - 1U,
+                                         "TexImage2D"))
+              .HasArg(1, helper.ToString(
+                  "GLenum", base::EnumHelper::GetConstant(
+                      static_cast<CubeMapTexture::CubeFace>(j))))
+              .HasArg(2, helper.ToString("GLint", static_cast<GLint>(i)))
+              .HasArg(4, helper.ToString(
+                  "GLsizei", static_cast<GLint>(mipmaps[i]->GetWidth())))
+              .HasArg(5, helper.ToString(
+                  "GLsizei", static_cast<GLint>(mipmaps[i]->GetHeight()))));
+    }
+  }
+
+  // Remove an image from a few faces and verify that GenerateMipmap is called
+  // only once for the entire texture.
+  s_data.cubemap->SetImage(CubeMapTexture::kNegativeZ, 1, ImagePtr(NULL));
+  s_data.cubemap->SetImage(CubeMapTexture::kPositiveY, 3, ImagePtr(NULL));
+  s_data.cubemap->SetImage(CubeMapTexture::kPositiveZ, 2, ImagePtr(NULL));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+  // Overall memory usage should be unchanged.
+  EXPECT_EQ(36856U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(32760U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // Since GenerateMipmap was called the override mipmaps were sent, but the
+  // 0th level mipmap doesn't have to be (GenerateMipmap won't override it).
+  // Only the mipmaps of the 3 modified faces are sent.
+  EXPECT_EQ((kNumMipmaps - 1U) * 3U - 3U,
+            trace_verifier_->GetCountOf("TexImage2D"));
 
-  s_data.image->Set(s_options.image_format, 33, 32, s_data.image_container);
+  // Set an invalid image dimension.
+  s_data.cubemap->SetImage(
+      CubeMapTexture::kPositiveY, 1,
+      CreateNullImage(mipmaps[1]->GetWidth() - 1, mipmaps[1]->GetHeight(),
+                      Image::kRgba8888));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+  // Generate mipmap will be called since a mipmap has changed, but no
+  // overriding mipmaps will be set since one is invalid.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  s_msg_stream_ << "Mipmap width: " << (mipmaps[1]->GetWidth() - 1) <<
+      " is not a power of 2.";
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
+  // Overall memory usage should be unchanged since there was an error
+  EXPECT_EQ(36856U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(32760U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
 
-  s_data.image->Set(s_options.image_format, 32, 33, s_data.image_container);
-  s_data.sampler->SetWrapS(Sampler::kRepeat);
-  s_data.sampler->SetWrapT(Sampler::kClampToEdge);
+  s_data.cubemap->SetImage(
+      CubeMapTexture::kPositiveY, 1,
+      CreateNullImage(mipmaps[1]->GetWidth(), mipmaps[1]->GetHeight() - 1,
+                      Image::kRgba8888));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+  // Generate mipmap will be called since a mipmap has changed, but no
+  // overriding mipmaps will be set since one is invalid.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  s_msg_stream_ << "Mipmap height: " << (mipmaps[1]->GetWidth() - 1) <<
+      " is not a power of 2.";
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
+  // Overall memory usage should be unchanged since there was an error
+  EXPECT_EQ(36856U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(32760U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
 
-  s_data.sampler->SetWrapT(Sampler::kRepeat);
+  // Set an invalid image dimension.
+  s_data.cubemap->SetImage(
+      CubeMapTexture::kPositiveY, 1, CreateNullImage(
+          mipmaps[1]->GetWidth(), mipmaps[1]->GetHeight(), Image::kRgb888));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-
-  // Reset data.
-  BuildRectangle();
+  // Generate mipmap will be called since a mipmap has changed, but no
+  // overriding mipmaps will be set since one is invalid.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_TRUE(
+      log_checker.HasMessage("ERROR", "level 1 has different format"));
+  // Overall memory usage should be unchanged since there was an error
+  EXPECT_EQ(36856U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(32760U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
 }
 
-TEST_F(RendererTest, TextureCompareFunction) {
-  VerifyRenderData<Sampler::CompareFunction> verify_data;
-  verify_data.option = &s_options.compare_func;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_COMPARE_FUNC"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            4, Sampler::kAlways, "GL_ALWAYS"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            0, Sampler::kEqual, "GL_EQUAL"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            0, Sampler::kGreater, "GL_GREATER"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            0, Sampler::kGreaterOrEqual, "GL_GEQUAL"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            0, Sampler::kLess, "GL_LESS"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            0, Sampler::kLessOrEqual, "GL_LEQUAL"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            0, Sampler::kNever, "GL_NEVER"));
-  verify_data.arg_tests.push_back(
-        VaryingArg<Sampler::CompareFunction>(
-            0, Sampler::kNotEqual, "GL_NOTEQUAL"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
-
-TEST_F(RendererTest, TextureCompareMode) {
-  VerifyRenderData<Sampler::CompareMode> verify_data;
-  verify_data.option = &s_options.compare_mode;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_COMPARE_MODE"));
-  verify_data.arg_tests.push_back(VaryingArg<Sampler::CompareMode>(
-      5, Sampler::kCompareToTexture, "GL_COMPARE_REF_TO_TEXTURE"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::CompareMode>(0, Sampler::kNone, "GL_NONE"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
-
-TEST_F(RendererTest, TextureMaxAnisotropy) {
-  VerifyRenderData<float> verify_data;
-  verify_data.option = &s_options.max_anisotropy;
-  verify_data.static_args.push_back(
-      StaticArg(2, "GL_TEXTURE_MAX_ANISOTROPY_EXT"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(0, 10.f, "10"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(0, 4.f, "4"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(0, 1.f, "1"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+TEST_F(RendererTest, CubeMapTextureSubImages) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
 
-  // Check that max anisotropy is bounded.
+  // Check that a texture with an image is sent as mipmap level 0.
   Reset();
-  s_options.max_anisotropy = 32.f;
-  NodePtr root = BuildGraph(800, 800);
-  RendererPtr renderer(new Renderer(gm_));
   renderer->DrawScene(root);
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "SamplerParameterf"))
-          .HasArg(2, "GL_TEXTURE_MAX_ANISOTROPY_EXT")
-          .HasArg(3, "16"));
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
 
-  // Disable anisotropy and make no anisotropy call is made.
-  gm_->SetExtensionsString("");
+  // Now set a subimage on the CubeMapTexture.
+  s_data.cubemap->SetSubImage(
+      CubeMapTexture::kNegativeZ, 0U, math::Point2ui(12, 20), CreateNullImage(
+          4, 8, Image::kRgba8888));
+  // Check that the subimage is applied.
   Reset();
-  root = BuildGraph(800, 800);
   renderer->DrawScene(root);
-  EXPECT_EQ(std::string::npos, trace_verifier_->GetTraceString().find(
-                                   "GL_TEXTURE_MAX_ANISOTROPY_EXT"));
-  s_options.max_anisotropy = 1.f;
-}
-
-TEST_F(RendererTest, TextureMagFilter) {
-  VerifyRenderData<Sampler::FilterMode> verify_data;
-  verify_data.option = &s_options.mag_filter;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MAG_FILTER"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(1, Sampler::kLinear, "GL_LINEAR"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(0, Sampler::kNearest, "GL_NEAREST"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
-
-TEST_F(RendererTest, TextureMaxLod) {
-  VerifyRenderData<float> verify_data;
-  verify_data.option = &s_options.max_lod;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MAX_LOD"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(1, 100.f, "100"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(0, -2.1f, "-2.1"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(0, 23.45f, "23.45"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
-
-TEST_F(RendererTest, TextureMinFilter) {
-  VerifyRenderData<Sampler::FilterMode> verify_data;
-  verify_data.option = &s_options.min_filter;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MIN_FILTER"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(
-          0, Sampler::kLinear, "GL_LINEAR"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(
-          0, Sampler::kNearest, "GL_NEAREST"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(
-          0, Sampler::kNearestMipmapNearest, "GL_NEAREST_MIPMAP_NEAREST"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(
-          0, Sampler::kNearestMipmapLinear, "GL_NEAREST_MIPMAP_LINEAR"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(
-          0, Sampler::kLinearMipmapNearest, "GL_LINEAR_MIPMAP_NEAREST"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::FilterMode>(
-          0, Sampler::kLinearMipmapLinear, "GL_LINEAR_MIPMAP_LINEAR"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
-
-TEST_F(RendererTest, TextureMinLod) {
-  VerifyRenderData<float> verify_data;
-  verify_data.option = &s_options.min_lod;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MIN_LOD"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(2, 10.f, "10"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(0, -3.1f, "-3.1"));
-  verify_data.arg_tests.push_back(VaryingArg<float>(0, 12.34f, "12.34"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
-
-TEST_F(RendererTest, TextureWrapR) {
-  VerifyRenderData<Sampler::WrapMode> verify_data;
-  verify_data.option = &s_options.wrap_r;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_WRAP_R"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          6, Sampler::kClampToEdge, "GL_CLAMP_TO_EDGE"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          0, Sampler::kRepeat, "GL_REPEAT"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          0, Sampler::kMirroredRepeat, "GL_MIRRORED_REPEAT"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexSubImage2D"))
+          .HasArg(2, "0")
+          .HasArg(3, "12")
+          .HasArg(4, "20")
+          .HasArg(5, "4")
+          .HasArg(6, "8")
+          .HasArg(7, "GL_RGB")
+          .HasArg(8, "GL_UNSIGNED_BYTE"));
 
-TEST_F(RendererTest, TextureWrapS) {
-  VerifyRenderData<Sampler::WrapMode> verify_data;
-  verify_data.option = &s_options.wrap_s;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_WRAP_S"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          2, Sampler::kClampToEdge, "GL_CLAMP_TO_EDGE"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          0, Sampler::kRepeat, "GL_REPEAT"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          0, Sampler::kMirroredRepeat, "GL_MIRRORED_REPEAT"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
+  // Several images of different sizes.
+  static const uint32 kMaxImageSize = 32;
+  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
+  ImagePtr mipmaps[kNumMipmaps];
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
+                                 Image::kRgba8888);
 
-TEST_F(RendererTest, TextureWrapT) {
-  VerifyRenderData<Sampler::WrapMode> verify_data;
-  verify_data.option = &s_options.wrap_t;
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_WRAP_T"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          3, Sampler::kClampToEdge, "GL_CLAMP_TO_EDGE"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          0, Sampler::kRepeat, "GL_REPEAT"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Sampler::WrapMode>(
-          0, Sampler::kMirroredRepeat, "GL_MIRRORED_REPEAT"));
-  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
-}
+  // Set a full image pyramid for each face.
+  for (int j = 0; j < 6; ++j) {
+    for (uint32 i = 0; i < kNumMipmaps; ++i)
+      s_data.cubemap->SetImage(
+          static_cast<CubeMapTexture::CubeFace>(j), i, mipmaps[i]);
+  }
 
-TEST_F(RendererTest, TextureBaseLevel) {
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root;
+  // Check consistent dimensions.
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_EQ(kNumMipmaps * 6U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(36856U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(32760U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
 
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<int> verify_data;
-  verify_data.update_func = BuildRectangle;
-  verify_data.call_name = "TexParameteri";
-  verify_data.option = &s_options.base_level;
-  verify_data.varying_arg_index = 3U;
-  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_BASE_LEVEL"));
-  verify_data.arg_tests.push_back(VaryingArg<int>(0, 10, "10"));
-  verify_data.arg_tests.push_back(VaryingArg<int>(0, 3, "3"));
-  verify_data.arg_tests.push_back(VaryingArg<int>(0, 123, "123"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  // Set a submipmap at level 3. Setting a compressed image requires non-NULL
+  // image data.
+  ImagePtr compressed_image(new Image);
+  compressed_image->Set(
+      Image::kDxt5, 4, 8,
+      base::DataContainerPtr(base::DataContainer::Create(
+          reinterpret_cast<void*>(1), kNullFunction, false,
+          compressed_image->GetAllocator())));
+  s_data.cubemap->SetSubImage(
+      CubeMapTexture::kNegativeZ, 3U, math::Point2ui(12, 8), compressed_image);
 
+  // Check the right call was made.
   Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+  renderer->DrawScene(root);
+  // Subimages do not resize textures.
+  EXPECT_EQ(36856U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(32760U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  // Technically there is an errors since the cubemap is not compressed, but
+  // this is just to test that the call is made.
+  gm_->SetErrorCode(GL_NO_ERROR);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CompressedTexSubImage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "CompressedTexSubImage2D"))
+          .HasArg(2, "3")
+          .HasArg(3, "12")
+          .HasArg(4, "8")
+          .HasArg(5, "4")
+          .HasArg(6, "8")
+          .HasArg(7, "GL_COMPRESSED_RGBA_S3TC_DXT5_EXT"));
 }
 
-TEST_F(RendererTest, TextureMaxLevel) {
+TEST_F(RendererTest, CubeMapTextureMisc) {
+  // Test various texture corner cases.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root;
-
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<int> verify_data;
-  verify_data.update_func = BuildRectangle;
-  verify_data.call_name = "TexParameteri";
-  verify_data.option = &s_options.max_level;
-  verify_data.varying_arg_index = 3U;
-  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
-  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MAX_LEVEL"));
-  verify_data.arg_tests.push_back(VaryingArg<int>(1, 100, "100"));
-  verify_data.arg_tests.push_back(VaryingArg<int>(0, 33, "33"));
-  verify_data.arg_tests.push_back(VaryingArg<int>(0, 1234, "1234"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
 
+  // Check that a texture with no image does not get sent.
+  for (int j = 0; j < 6; ++j)
+    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
+                             ImagePtr(NULL));
   Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
-}
-
-TEST_F(RendererTest, TextureSwizzleRed) {
-  RendererPtr renderer(new Renderer(gm_));
-  TracingHelper helper;
-  NodePtr root;
+  renderer->DrawScene(root);
+  // The regular texture is still sent the first time.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING",
+                                     "texture face Negative X has no level"));
+  Reset();
+  s_data.cubemap->SetImage(CubeMapTexture::kNegativeX, 0U, s_data.image);
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING",
+                                     "texture face Negative Y has no level"));
+  Reset();
+  s_data.cubemap->SetImage(CubeMapTexture::kNegativeY, 0U, s_data.image);
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING",
+                                     "texture face Negative Z has no level"));
 
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<Texture::Swizzle> verify_data;
-  verify_data.update_func = BuildRectangle;
-  verify_data.call_name = "TexParameteri";
-  verify_data.option = &s_options.swizzle_r;
-  verify_data.varying_arg_index = 3U;
-  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
-  verify_data.static_args.push_back(
-      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_R)));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(2, Texture::kGreen, "GL_GREEN"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kBlue, "GL_BLUE"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kAlpha, "GL_ALPHA"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kRed, "GL_RED"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  // Make the texture valid.
+  for (int j = 0; j < 6; ++j)
+    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
+                             s_data.image);
 
+  // Check that a GenerateMipmap is called if requested.
+  s_data.sampler->SetAutogenerateMipmapsEnabled(true);
   Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
-}
-
-TEST_F(RendererTest, TextureSwizzleGreen) {
-  RendererPtr renderer(new Renderer(gm_));
-  TracingHelper helper;
-  NodePtr root;
+  renderer->DrawScene(root);
+  // Both the cubemap and texture will generate mipmaps.
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  // Check that when disabled GenerateMipmap is not called.
+  s_data.sampler->SetAutogenerateMipmapsEnabled(false);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<Texture::Swizzle> verify_data;
-  verify_data.update_func = BuildRectangle;
-  verify_data.call_name = "TexParameteri";
-  verify_data.option = &s_options.swizzle_g;
-  verify_data.varying_arg_index = 3U;
-  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
-  verify_data.static_args.push_back(
-      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_G)));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(3, Texture::kBlue, "GL_BLUE"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kAlpha, "GL_ALPHA"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kRed, "GL_RED"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kGreen, "GL_GREEN"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  // Check error cases for equal cubemap sizes.
+  s_data.image->Set(s_options.image_format, 32, 33, s_data.image_container);
+  s_data.sampler->SetMinFilter(Sampler::kLinearMipmapNearest);
+  s_data.sampler->SetWrapS(Sampler::kClampToEdge);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(
+      log_checker.HasMessage("ERROR", "does not have square dimensions"));
 
+  // Check error cases for non-power-of-2 textures.
+  s_data.image->Set(s_options.image_format, 30, 30, s_data.image_container);
+  s_data.sampler->SetMinFilter(Sampler::kLinearMipmapNearest);
+  s_data.sampler->SetWrapS(Sampler::kClampToEdge);
   Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
-}
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
 
-TEST_F(RendererTest, TextureSwizzleBlue) {
-  RendererPtr renderer(new Renderer(gm_));
-  TracingHelper helper;
-  NodePtr root;
+  s_data.image->Set(s_options.image_format, 30, 30, s_data.image_container);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
 
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<Texture::Swizzle> verify_data;
-  verify_data.update_func = BuildRectangle;
-  verify_data.call_name = "TexParameteri";
-  verify_data.option = &s_options.swizzle_b;
-  verify_data.varying_arg_index = 3U;
-  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
-  verify_data.static_args.push_back(
-      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_B)));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(4, Texture::kAlpha, "GL_ALPHA"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kRed, "GL_RED"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kGreen, "GL_GREEN"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kBlue, "GL_BLUE"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  s_data.image->Set(s_options.image_format, 30, 30, s_data.image_container);
+  s_data.sampler->SetWrapS(Sampler::kRepeat);
+  s_data.sampler->SetWrapT(Sampler::kClampToEdge);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
 
+  s_data.sampler->SetWrapT(Sampler::kRepeat);
   Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Reset data.
+  BuildRectangle();
 }
 
-TEST_F(RendererTest, TextureSwizzleAlpha) {
+TEST_F(RendererTest, SamplersFollowTextures) {
+  // Test that a sampler follows a texture's binding when the texture's bind
+  // point changes. This can happen when a set of textures share a sampler and
+  // then the bind point changes for all of those textures (e.g., they are bound
+  // to a uniform and that uniform's bind point changes).
   RendererPtr renderer(new Renderer(gm_));
-  TracingHelper helper;
-  NodePtr root;
-
-  root = BuildGraph(kWidth, kHeight);
-  VerifyRenderData<Texture::Swizzle> verify_data;
-  verify_data.update_func = BuildRectangle;
-  verify_data.call_name = "TexParameteri";
-  verify_data.option = &s_options.swizzle_a;
-  verify_data.varying_arg_index = 3U;
-  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
-  verify_data.static_args.push_back(
-      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_A)));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(5, Texture::kRed, "GL_RED"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kGreen, "GL_GREEN"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kBlue, "GL_BLUE"));
-  verify_data.arg_tests.push_back(
-      VaryingArg<Texture::Swizzle>(0, Texture::kAlpha, "GL_ALPHA"));
-  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  s_data.rect->ClearChildren();
+  s_data.rect->ClearUniforms();
+  s_data.rect->ClearShapes();
 
-  Reset();
-  renderer = NULL;
-  EXPECT_TRUE(VerifyReleases(1));
-}
+  static const char* kFragmentShaderString = (
+      "uniform sampler2D uTexture1;\n"
+      "uniform sampler2D uTexture2;\n"
+      "varying vec2 vTexCoords;\n"
+      "\n"
+      "void main(void) {\n"
+      "  gl_FragColor = texture2D(uTexture, vTexCoords);\n"
+      "}\n");
+  static const char* kBaseShaderString = (
+      "varying vec2 vTexCoords;\n"
+      "\n"
+      "void main(void) {\n"
+      "  gl_FragColor = texture2D(uTexture, vTexCoords);\n"
+      "}\n");
 
-TEST_F(RendererTest, MultipleRenderers) {
-  // Multiple Renderers create multiple instances of the same resources.
-  // There isn't (yet) a way to get at the internal state of the
-  // ResourceManager, but this at least will create ResourceGroups.
-  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, false);
-  {
-    RendererPtr renderer1(new Renderer(gm_));
-    RendererPtr renderer2(new Renderer(gm_));
+  // Create a shader that uses all of the image units.
+  GLuint num_textures = -1;
+  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
+                   reinterpret_cast<GLint*>(&num_textures));
+  std::ostringstream shader_string;
+  for (GLuint i = 0; i < num_textures; ++i) {
+    shader_string << "uniform sampler2D uTexture" << i << ";\n";
+  }
+  shader_string << kBaseShaderString;
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::AttributeSpec(
+      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
+  ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
+      "BigShader", reg, kPlaneVertexShaderString, shader_string.str(),
+      base::AllocatorPtr());
 
-    // Draw the simplest possible scene.
-    NodePtr root = BuildGraph(800, 800);
-    // Drawing will create resources.
-    renderer1->DrawScene(root);
-    renderer2->DrawScene(root);
-    // Improve coverage by changing a group bit.
-    s_data.sampler->SetWrapS(Sampler::kMirroredRepeat);
-    renderer1->DrawScene(root);
-    renderer2->DrawScene(root);
+  // Add a node with the full compliment of textures.
+  NodePtr node(new Node);
+  node->SetShaderProgram(shader);
+  node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
+  node->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uModelviewMatrix", math::Matrix4f::Identity()));
 
-    // Each renderer has its own resources and memory counts.
-    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer1, 12U + kVboSize, 0U, 28672U));
-    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer2, 12U + kVboSize, 0U, 28672U));
-    // Memory usage per holder should be doubled; one resource per renderer.
-    EXPECT_EQ(24U, s_data.index_buffer->GetGpuMemoryUsed());
-    EXPECT_EQ(8U * sizeof(Vertex), s_data.vertex_buffer->GetGpuMemoryUsed());
-    EXPECT_EQ(8192U, s_data.texture->GetGpuMemoryUsed());
-    EXPECT_EQ(49152U, s_data.cubemap->GetGpuMemoryUsed());
+  SamplerPtr sampler(new Sampler());
+  s_data.sampler->SetLabel("Big Sampler");
+  for (GLuint j = 0; j < num_textures; ++j) {
+    // Make a unique name to create a new Uniform for each texture.
+    std::ostringstream str;
+    str << "uTexture" << j;
 
-    Reset();
-    // Force calls to OnDestroyed().
-    s_data.attribute_array = NULL;
-    s_data.vertex_buffer = NULL;
-    s_data.index_buffer = NULL;
-    s_data.shader = NULL;
-    s_data.shape = NULL;
-    s_data.texture = NULL;
-    s_data.cubemap = NULL;
-    s_data.rect = NULL;
-    root->ClearChildren();
-    root->ClearUniforms();
-    root->SetShaderProgram(ShaderProgramPtr(NULL));
-    // Force calls to ReleaseAll().
-    renderer1->DrawScene(root);
-    renderer2->DrawScene(root);
-    // It can take two calls to free up all resources because some may be added
-    // to the release queue during traversal.
-    renderer1->DrawScene(root);
-    renderer2->DrawScene(root);
-    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer1, 0U, 0U, 0U));
-    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer2, 0U, 0U, 0U));
-    // Everything will be destroyed since the resources go away.
-    std::vector<std::string> call_strings;
-    call_strings.push_back("Clear");
-    call_strings.push_back("Clear");
-    call_strings.push_back("Clear");
-    call_strings.push_back("Clear");
-    call_strings.push_back("DeleteBuffers");
-    call_strings.push_back("DeleteBuffers");
-    call_strings.push_back("DeleteBuffers");
-    call_strings.push_back("DeleteBuffers");
-    call_strings.push_back("DeleteProgram");
-    call_strings.push_back("DeleteProgram");
-    call_strings.push_back("DeleteShader");
-    call_strings.push_back("DeleteShader");
-    call_strings.push_back("DeleteShader");
-    call_strings.push_back("DeleteShader");
-    call_strings.push_back("DeleteTextures");
-    call_strings.push_back("DeleteTextures");
-    call_strings.push_back("DeleteTextures");
-    call_strings.push_back("DeleteTextures");
-    call_strings.push_back("DeleteVertexArrays");
-    call_strings.push_back("DeleteVertexArrays");
-    EXPECT_TRUE(trace_verifier_->VerifySortedCalls(call_strings));
-    Reset();
-    root = NULL;
-    renderer1 = NULL;
-    renderer2 = NULL;
-    EXPECT_EQ(0U, trace_verifier_->GetCallCount());
+    TexturePtr texture(new Texture);
+    texture->SetImage(0U, s_data.image);
+    texture->SetSampler(sampler);
+    node->AddUniform(reg->Create<Uniform>(str.str(), texture));
   }
-  // Reset data.
-  BuildRectangle();
+  node->AddShape(s_data.shape);
 
-  {
-    RendererPtr renderer1(new Renderer(gm_));
-    RendererPtr renderer2(new Renderer(gm_));
-    RendererPtr renderer3(new Renderer(gm_));
+  ShaderInputRegistryPtr reg1(new ShaderInputRegistry);
+  reg1->IncludeGlobalRegistry();
+  reg1->Add(ShaderInputRegistry::AttributeSpec(
+      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
+  ShaderInputRegistryPtr reg2(new ShaderInputRegistry);
+  reg2->IncludeGlobalRegistry();
+  reg2->Add(ShaderInputRegistry::AttributeSpec(
+      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
+  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
+      "Shader1", reg1, kPlaneVertexShaderString, kFragmentShaderString,
+      base::AllocatorPtr());
+  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
+      "Shader2", reg2, kPlaneVertexShaderString, kFragmentShaderString,
+      base::AllocatorPtr());
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
 
-    // Draw the simplest possible scene.
-    NodePtr root = BuildGraph(800, 800);
-    renderer1->DrawScene(root);
-    renderer2->DrawScene(root);
-    renderer3->DrawScene(root);
-    Reset();
-    // Force resource deletion from a renderer.
-    renderer1 = NULL;
-    // Force calls to OnDestroyed().
-    root = NULL;
-    s_data.shape = NULL;
-    s_data.rect = NULL;
-    renderer2 = NULL;
-    renderer3 = NULL;
-    EXPECT_TRUE(VerifyReleases(3));
-  }
+  // Add two nodes that have both textures.
+  TexturePtr texture1(new Texture);
+  texture1->SetImage(0U, s_data.image);
+  texture1->SetSampler(s_data.sampler);
+  TexturePtr texture2(new Texture);
+  texture2->SetImage(0U, s_data.image);
+  texture2->SetSampler(s_data.sampler);
+  NodePtr node1(new Node);
+  node1->SetShaderProgram(shader1);
+  node1->AddUniform(reg1->Create<Uniform>("uTexture1", texture1));
+  node1->AddUniform(reg1->Create<Uniform>("uTexture2", texture2));
+  node1->AddShape(s_data.shape);
+  s_data.rect->AddChild(node1);
 
-  {
-    RendererPtr renderer1(new Renderer(gm_));
-    RendererPtr renderer2(new Renderer(gm_));
-    RendererPtr renderer3(new Renderer(gm_));
+  NodePtr node2(new Node);
+  node2->SetShaderProgram(shader2);
+  node2->AddUniform(reg2->Create<Uniform>("uTexture1", texture1));
+  node2->AddUniform(reg2->Create<Uniform>("uTexture2", texture2));
+  node2->AddShape(s_data.shape);
+  s_data.rect->AddChild(node2);
 
-    // Draw the simplest possible scene.
-    NodePtr root = BuildGraph(800, 800);
-    renderer1->DrawScene(root);
-    renderer2->DrawScene(root);
-    renderer3->DrawScene(root);
-    Reset();
+  // Each texture should be bound once, and the sampler bound to each unit.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture"));
+  // 4 image units will be used since there are 4 distinct uniforms.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE0)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE1)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE2)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE3)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE4)"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindSampler"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x0"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x2"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x3"));
+  // The image units should be sent.
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
 
-    // Clear resources to improve coverage.
-    renderer3->ClearAllResources();
-    EXPECT_TRUE(VerifyReleases(1));
-    Reset();
-    renderer1->ClearResources(s_data.attribute_array.Get());
-    renderer2->ClearTypedResources(Renderer::kTexture);
-    renderer1 = NULL;
-    // Force calls to OnDestroyed().
-    root = NULL;
-    s_data.shape = NULL;
-    s_data.rect = NULL;
-    renderer2 = NULL;
-    EXPECT_TRUE(VerifyReleases(2));
-  }
+  Reset();
+  renderer->DrawScene(root);
+  // Nothing new should be sent.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindSampler"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
 
-  // Reset data.
-  BuildRectangle();
+  // Force the uniform -> image unit associations to change by rendering a big
+  // shader.
+  Reset();
+  renderer->DrawScene(node);
 
-  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, true);
+  // Check that the samplers were bound correctly.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("ActiveTexture"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("BindSampler"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x4"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x5"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x6"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindSampler(0x7"));
+  // The new image units should be sent again.
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("Uniform1i"));
 }
 
-TEST_F(RendererTest, Clearing) {
-  NodePtr node(new Node);
-  StateTablePtr state_table;
+TEST_F(RendererTest, MissingSamplerCausesWarning) {
   RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  state_table = new StateTable();
-  state_table->SetClearDepthValue(0.5f);
-  node->SetStateTable(state_table);
+  s_data.texture->SetSampler(SamplerPtr());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "has no Sampler!"));
 
+  s_data.texture->SetSampler(s_data.sampler);
   Reset();
-  renderer->DrawScene(node);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearDepthf(0.5)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_DEPTH_BUFFER_BIT)"));
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  state_table = new StateTable();
-  state_table->SetClearColor(math::Vector4f(0.3f, 0.3f, 0.5f, 1.0f));
-  state_table->SetClearDepthValue(0.25f);
-  node->SetStateTable(state_table);
+TEST_F(RendererTest, UnsupportedCompressedFormatsAreNotUploaded) {
+  base::LogChecker log_checker;
+  gm_->SetVersionString("2.0 Ion OpenGL ES");
+  gm_->SetExtensionsString("GL_EXT_texture_compression_dxt1");
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
 
-  Reset();
-  renderer->DrawScene(node);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0.3, 0.3, 0.5, 1)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearDepthf(0.25)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
-      "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)"));
+  s_options.image_format = Image::kAstc4x4Rgba;
+  Build2dImage();
+  TexturePtr texture(new Texture);
+  texture->SetImage(0U, s_data.image);
+  texture->SetSampler(s_data.sampler);
+  trace_verifier_->Reset();
+  renderer->CreateOrUpdateResource(texture.Get());
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("CompressedTexImage2D"));
+  EXPECT_TRUE(log_checker.HasMessage(
+      "ERROR", "Astc4x4Rgba, which is not supported"));
 
-  state_table = new StateTable();
-  state_table->SetClearStencilValue(27);
-  node->SetStateTable(state_table);
+  // DXT1 is supported by the extension.
+  s_options.image_format = Image::kDxt1;
+  Build2dImage();
+  texture = new Texture;
+  texture->SetImage(0U, s_data.image);
+  texture->SetSampler(s_data.sampler);
+  trace_verifier_->Reset();
+  renderer->CreateOrUpdateResource(texture.Get());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CompressedTexImage2D"));
+  EXPECT_FALSE(log_checker.HasMessage("ERROR", "which is not supported"));
+}
 
-  Reset();
-  renderer->DrawScene(node);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearStencil(27)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_STENCIL_BUFFER_BIT)"));
+TEST_F(RendererTest, ImmutableTextures) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
 
-  state_table = new StateTable();
-  state_table->SetClearDepthValue(0.15f);
-  state_table->SetClearColor(math::Vector4f(0.2f, 0.1f, 0.5f, 0.3f));
-  state_table->SetClearStencilValue(123);
-  node->SetStateTable(state_table);
+  // Create immutable textures and test the proper TexStorage calls are made.
+  Build1dArrayImage();
+  Reset();
+  EXPECT_TRUE(VerifyImmutableTexture<Texture>(
+      renderer, trace_verifier_, 3, "TexStorage2D(GL_TEXTURE_1D_ARRAY, "));
+  Reset();
+  // 1D cubemaps are illegal.
 
+  Build2dImage();
   Reset();
-  renderer->DrawScene(node);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0.2, 0.1, 0.5, 0.3)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearDepthf(0.15)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearStencil(123)"));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf(
-                "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | "
-                "GL_STENCIL_BUFFER_BIT)"));
-
-  // In a simple hierarchy with the clears at the root, no other nodes should
-  // trigger a clear.
-  NodePtr child1(new Node);
-  NodePtr child2(new Node);
-  node->AddChild(child1);
-  node->AddChild(child2);
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kBlend, true);
-  child1->SetStateTable(state_table);
+  EXPECT_TRUE(VerifyImmutableTexture<Texture>(renderer, trace_verifier_, 2,
+                                              "TexStorage2D(GL_TEXTURE_2D, "));
+  Reset();
+  EXPECT_TRUE(VerifyImmutableTexture<CubeMapTexture>(
+      renderer, trace_verifier_, 4, "TexStorage2D(GL_TEXTURE_CUBE_MAP, "));
 
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kCullFace, true);
-  child2->SetStateTable(state_table);
+  Build2dArrayImage();
+  Reset();
+  EXPECT_TRUE(VerifyImmutableTexture<Texture>(
+      renderer, trace_verifier_, 4, "TexStorage3D(GL_TEXTURE_2D_ARRAY, "));
+  Reset();
+  EXPECT_TRUE(VerifyImmutableTexture<CubeMapTexture>(
+      renderer, trace_verifier_, 3,
+      "TexStorage3D(GL_TEXTURE_CUBE_MAP_ARRAY, "));
 
+  Build3dImage();
   Reset();
-  renderer->DrawScene(node);
-  // The particular values are already set.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearColor"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearDepthf"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearStencil"));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf(
-                "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | "
-                "GL_STENCIL_BUFFER_BIT)"));
+  EXPECT_TRUE(VerifyImmutableTexture<Texture>(
+      renderer, trace_verifier_, 3, "TexStorage3D(GL_TEXTURE_3D, "));
+  // 3D cubemaps are illegal.
 
-  // If an internal node clears, only it should be cleared.
-  NodePtr parent(new Node);
-  parent->AddChild(node);
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kStencilTest, true);
-  parent->SetStateTable(state_table);
+  s_data.image.Reset(NULL);
+}
+
+TEST_F(RendererTest, ImmutableMultisampleTextures) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
 
+  Build2dImage();
   Reset();
-  renderer->DrawScene(node);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearColor"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearDepthf"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearStencil"));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf(
-                "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | "
-                "GL_STENCIL_BUFFER_BIT)"));
+  EXPECT_TRUE(VerifyImmutableMultisampledTexture<Texture>(
+      renderer, trace_verifier_, 8,
+      "TexStorage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, "));
 
-  // Test that clear colors are propagated correctly.
-  NodePtr clear_node_blue(new Node);
-  state_table = new StateTable();
-  state_table->SetClearColor(math::Vector4f(0.0f, 0.0f, 1.0f, 1.0f));
-  clear_node_blue->SetStateTable(state_table);
+  Build2dArrayImage();
+  Reset();
+  EXPECT_TRUE(VerifyImmutableMultisampledTexture<Texture>(
+      renderer, trace_verifier_, 8,
+      "TexStorage3DMultisample(GL_TEXTURE_2D_MULTISAMPLE_ARRAY, "));
 
-  NodePtr clear_node_black(new Node);
-  state_table = new StateTable();
-  state_table->SetClearColor(math::Vector4f(0.0f, 0.0f, 0.0f, 0.0f));
-  clear_node_black->SetStateTable(state_table);
+  s_data.image.Reset(NULL);
+}
 
-  BuildGraph(kWidth, kHeight);
-  NodePtr shape_node(new Node);
-  shape_node->SetShaderProgram(s_data.shader);
-  AddPlaneShaderUniformsToNode(shape_node);
-  shape_node->AddShape(s_data.shape);
-  shape_node->AddChild(clear_node_black);
+TEST_F(RendererTest, TextureEvictionCausesRebind) {
+  // Test that when a texture is evicted from an image unit by a texture from a
+  // different uniform that the original texture will be rebound when drawn
+  // again.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  s_data.rect->ClearChildren();
+  s_data.rect->ClearUniforms();
+  s_data.rect->ClearShapes();
+
+  // Add many nodes with different textures bound to different uniforms; they
+  // will eventually wrap image units.
+  GLuint num_textures = -1;
+  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
+                   reinterpret_cast<GLint*>(&num_textures));
+
+  // Construct a shader with many textures.
+  static const char* kBaseShaderString = (
+      "varying vec2 vTexCoords;\n"
+      "\n"
+      "void main(void) {\n"
+      "  gl_FragColor = texture2D(uTexture, vTexCoords);\n"
+      "}\n");
+  std::ostringstream shader_string;
+  for (GLuint i = 0; i < num_textures; ++i) {
+    shader_string << "uniform sampler2D uTexture" << i << ";\n";
+  }
+  shader_string << kBaseShaderString;
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::AttributeSpec(
+      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
+  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
+      "Shader1", reg, kPlaneVertexShaderString, shader_string.str(),
+      base::AllocatorPtr());
+  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
+      "Shader2", reg, kPlaneVertexShaderString, shader_string.str(),
+      base::AllocatorPtr());
+
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
+
+  // Add a node with the full compliment of textures.
+  NodePtr node(new Node);
+  node->SetShaderProgram(shader1);
+  for (GLuint j = 0; j < num_textures; ++j) {
+    // Make a unique name to create a new Uniform for each texture.
+    std::ostringstream str;
+    str << "uTexture" << j;
+
+    TexturePtr texture(new Texture);
+    texture->SetImage(0U, s_data.image);
+    texture->SetSampler(s_data.sampler);
+    node->AddUniform(reg->Create<Uniform>(str.str(), texture));
+  }
+  node->AddShape(s_data.shape);
+  s_data.rect->AddChild(node);
 
+  // Each texture should be bound once.
   Reset();
-  renderer->DrawScene(clear_node_blue);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0, 0, 1, 1)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_COLOR_BUFFER_BIT)"));
+  renderer->DrawScene(root);
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
+  for (GLuint i = 1; i < num_textures; ++i) {
+    std::ostringstream str;
+    str << "ActiveTexture(GL_TEXTURE" << i << ")";
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
+  }
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("BindSampler"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("Uniform1i"));
 
+  // Drawing again should do nothing, since everything is already bound.
   Reset();
-  renderer->DrawScene(shape_node);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0, 0, 0, 0)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_COLOR_BUFFER_BIT)"));
-}
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
 
-TEST_F(RendererTest, ClearingResources) {
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(800, 800);
+  // Drawing again with a framebuffer should rebind all textures, since they are
+  // all evicted when cleared.
   FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
   fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
+  Reset();
+  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
   renderer->BindFramebuffer(fbo);
+  EXPECT_EQ(fbo.Get(), renderer->GetCurrentFramebuffer().Get());
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  renderer->BindFramebuffer(FramebufferObjectPtr());
+  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // Since all the sampler bindings were reset across the fbo bind, they will
+  // be bound again.
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("BindSampler"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+
+  // Drawing again should rebind, since they are evicted when the framebuffer
+  // was changed.
   Reset();
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("BindSampler"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
 
-  // Clear an entire scene at once.
+  // Add another node with the full compliment of textures.
+  node.Reset(new Node);
+  node->SetShaderProgram(shader2);
+  for (GLuint j = 0; j < num_textures; ++j) {
+    // Make a unique name to create a new Uniform for each texture.
+    std::ostringstream str;
+    str << "uTexture" << j;
+
+    TexturePtr texture(new Texture);
+    texture->SetImage(0U, s_data.image);
+    texture->SetSampler(s_data.sampler);
+    node->AddUniform(reg->Create<Uniform>(str.str(), texture));
+  }
+  node->AddShape(s_data.shape);
+  s_data.rect->AddChild(node);
+
+  // Get the new resources created.
   Reset();
-  renderer->ClearAllResources();
-  // Check that all memory was released.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 0U, 0U, 0U));
-  EXPECT_EQ(0U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
-  renderer->BindFramebuffer(fbo);
   renderer->DrawScene(root);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteTexture"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenVertexArrays(1"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenBuffers(1"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenFramebuffers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenRenderbuffers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenTextures(1, "));
-  // The texture is bound twice, once for the framebuffer, and again when it is
-  // used.
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_2D"));
-  EXPECT_EQ(
-      7U, trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf(
-                "TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 32, 32, 0, GL_RGBA, "
-                "GL_UNSIGNED_BYTE"));
-  EXPECT_EQ(7U, trace_verifier_->GetCountOf("SamplerParameteri"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("SamplerParameterf"));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  EXPECT_EQ(6U,
-            trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_CUBE_MAP"));
-  EXPECT_EQ(6U,
-            trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE_MAP"));
-  EXPECT_EQ(
-      1U,
-      trace_verifier_->GetCountOf("BindBuffer(GL_ELEMENT_ARRAY_BUFFER"));
-  EXPECT_EQ(
-      1U,
-      trace_verifier_->GetCountOf("BufferData(GL_ELEMENT_ARRAY_BUFFER, 12"));
-  // Everything should be recreated.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
+  for (GLuint i = 0; i < num_textures; ++i) {
+    std::ostringstream str;
+    str << "ActiveTexture(GL_TEXTURE" << i << ")";
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
+  }
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // The new texture uniforms should share the same units, but they have to be
+  // sent once for the new shader. The samplers, however, are already in the
+  // right place.
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindSampler"));
 
-  // AttributeArray.
+  // Drawing again should rebind everything, since all textures were evicted by
+  // the second node. The units should be consistent, however.
   Reset();
-  renderer->ClearResources(s_data.attribute_array.Get());
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenVertexArrays(1"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindVertexArray"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(num_textures * 2U,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures * 2U,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindSampler"));
 
-  // BufferObject.
+  // Reset data.
+  s_data.rect = NULL;
+  BuildRectangle();
+}
+
+TEST_F(RendererTest, ArrayTextureEvictionCausesRebind) {
+  // Similar to the above test but using array textures.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  s_data.rect->ClearChildren();
+  s_data.rect->ClearUniforms();
+  s_data.rect->ClearShapes();
+
+  // Add many nodes with different textures bound to different uniforms; they
+  // will eventually wrap image units.
+  GLuint num_textures = -1;
+  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
+                   reinterpret_cast<GLint*>(&num_textures));
+
+  // Construct a shader with many textures.
+  static const char* kBaseShaderString = (
+      "varying vec2 vTexCoords;\n"
+      "\n"
+      "void main(void) {\n"
+      "  gl_FragColor = texture2D(uTextures[0], vTexCoords);\n"
+      "}\n");
+  std::ostringstream shader_string;
+  shader_string << "uniform sampler2D uTextures[" << num_textures << "];\n";
+  shader_string << kBaseShaderString;
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::AttributeSpec(
+      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
+  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
+      "Shader1", reg, kPlaneVertexShaderString, shader_string.str(),
+      base::AllocatorPtr());
+  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
+      "Shader2", reg, kPlaneVertexShaderString, shader_string.str(),
+      base::AllocatorPtr());
+
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
+
+  // Add a node with the full compliment of textures.
+  NodePtr node(new Node);
+  std::vector<TexturePtr> textures(num_textures);
+  node->SetShaderProgram(shader1);
+  for (GLuint i = 0; i < num_textures; ++i) {
+    textures[i].Reset(new Texture);
+    textures[i]->SetImage(0U, s_data.image);
+    textures[i]->SetSampler(s_data.sampler);
+  }
+  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
+  node->AddShape(s_data.shape);
+  s_data.rect->AddChild(node);
+
+  // Each texture should be bound once.
   Reset();
-  renderer->ClearResources(s_data.vertex_buffer.Get());
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U, 32768U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
   renderer->DrawScene(root);
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  // Check calls.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenBuffers(1"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
+  for (GLuint i = 0; i < num_textures; ++i) {
+    SCOPED_TRACE(i);
+    std::ostringstream str;
+    str << "ActiveTexture(GL_TEXTURE" << i << ")";
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
+  }
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  // CubeMapTexture.
+  // Drawing again should do nothing, since everything is already bound.
   Reset();
-  renderer->ClearResources(s_data.cubemap.Get());
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 4096U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
   renderer->DrawScene(root);
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  // Check calls.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenTextures(1, "));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
-  EXPECT_EQ(6U,
-            trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_CUBE_MAP"));
-  EXPECT_EQ(
-      6U, trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
-  EXPECT_EQ(6U,
-            trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE_MAP"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
 
-  // Framebuffer.
+  // Drawing again with a framebuffer should rebind all textures, since they are
+  // all evicted when cleared.
+  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
+  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
   Reset();
-  renderer->ClearResources(fbo.Get());
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 0U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
   renderer->BindFramebuffer(fbo);
+  EXPECT_EQ(fbo.Get(), renderer->GetCurrentFramebuffer().Get());
   renderer->DrawScene(root);
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  // Check calls.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenSamplers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenFramebuffers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenRenderbuffers"));
+  renderer->BindFramebuffer(FramebufferObjectPtr());
+  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  // Sampler.
+  // Drawing again should rebind, since they are evicted when the framebuffer
+  // was changed.
   Reset();
-  renderer->ClearResources(s_data.sampler.Get());
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenSamplers"));
-  // The sampler should be bound for both the texture and cubemap. The texture
-  // is bound twice, once when it is created, and again after it is bound to a
-  // uniform.
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindSampler"));
-  EXPECT_EQ(7U, trace_verifier_->GetCountOf("SamplerParameteri"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("SamplerParameterf"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
 
-  // Shader.
-  Reset();
-  renderer->ClearResources(s_data.shader->GetFragmentShader().Get());
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ShaderSource"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("AttachShader"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetActiveUniform"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetUniformLocation"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
+  // Add another node with the full compliment of textures.
+  textures.clear();
+  textures.resize(num_textures);
+  node.Reset(new Node);
+  node->SetShaderProgram(shader2);
+  for (GLuint i = 0; i < num_textures; ++i) {
+    textures[i].Reset(new Texture);
+    textures[i]->SetImage(0U, s_data.image);
+    textures[i]->SetSampler(s_data.sampler);
+  }
+  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
+  node->AddShape(s_data.shape);
+  s_data.rect->AddChild(node);
 
-  // ShaderProgram.
+  // Get the new resources created.
   Reset();
-  renderer->ClearResources(s_data.shader.Get());
   renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("AttachShader"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetActiveUniform"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetUniformLocation"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
+  EXPECT_EQ(num_textures, trace_verifier_->GetCountOf("TexImage2D"));
+  for (GLuint i = 0; i < num_textures; ++i) {
+    std::ostringstream str;
+    str << "ActiveTexture(GL_TEXTURE" << i << ")";
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
+  }
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  // The texture uniforms for the new shader get their bindings.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  // Texture.
+  // Drawing again should rebind everything, since all textures were evicted by
+  // the second node.
   Reset();
-  renderer->ClearResources(s_data.texture.Get());
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 24576U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(0U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
   renderer->DrawScene(root);
-  // Check memory usage.
-  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U,
-                                   28672U));
-  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
-  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
-  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
-  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
-  // Check calls.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenTextures(1, "));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
-  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_2D"));
-  EXPECT_EQ(
-      1U, trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf(
-                "TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 32, 32, 0, GL_RGBA, "
-                "GL_UNSIGNED_BYTE"));
+  EXPECT_EQ(num_textures * 2U,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures * 2U,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  // Clear all Shaders.
-  Reset();
-  renderer->ClearTypedResources(Renderer::kShader);
-  renderer->DrawScene(root);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteShader"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("ShaderSource"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("AttachShader"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetActiveUniform"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetUniformLocation"));
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
+  // Reset data.
+  s_data.rect = NULL;
+  BuildRectangle();
 }
 
-TEST_F(RendererTest, DisabledNodes) {
-  // Build a graph with multiple nodes, each with a StateTable that enables
-  // a different capability.
-  // The graph looks like this:
-  //        a
-  //     b     c
-  //          d e
-  NodePtr a(new Node);
-  NodePtr b(new Node);
-  NodePtr c(new Node);
-  NodePtr d(new Node);
-  NodePtr e(new Node);
-
-  StateTablePtr state_table;
-
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kBlend, true);
-  a->SetStateTable(state_table);
-
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kCullFace, true);
-  b->SetStateTable(state_table);
-
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kDepthTest, true);
-  c->SetStateTable(state_table);
-
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kScissorTest, true);
-  d->SetStateTable(state_table);
+TEST_F(RendererTest, ArrayCubemapEvictionCausesRebind) {
+  // The same as the above test but using array cubemaps.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  s_data.rect->ClearChildren();
+  s_data.rect->ClearUniforms();
+  s_data.rect->ClearShapes();
 
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kStencilTest, true);
-  e->SetStateTable(state_table);
+  // Add many nodes with different textures bound to different uniforms; they
+  // will eventually wrap image units.
+  GLuint num_textures = -1;
+  gm_->GetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS,
+                   reinterpret_cast<GLint*>(&num_textures));
 
-  BuildRectangleShape<uint16>();
-  a->AddShape(s_data.shape);
-  b->AddShape(s_data.shape);
-  c->AddShape(s_data.shape);
-  d->AddShape(s_data.shape);
-  e->AddShape(s_data.shape);
+  // Construct a shader with many textures.
+  static const char* kBaseShaderString = (
+      "varying vec2 vTexCoords;\n"
+      "\n"
+      "void main(void) {\n"
+      "  gl_FragColor = texture2D(uTextures[0], vTexCoords);\n"
+      "}\n");
+  std::ostringstream shader_string;
+  shader_string << "uniform samplerCube uTextures[" << num_textures << "];\n";
+  shader_string << kBaseShaderString;
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::AttributeSpec(
+      "aTestAttrib", kBufferObjectElementAttribute, "Testing attribute"));
+  ShaderProgramPtr shader1 = ShaderProgram::BuildFromStrings(
+      "Shader1", reg, kPlaneVertexShaderString, shader_string.str(),
+      base::AllocatorPtr());
+  ShaderProgramPtr shader2 = ShaderProgram::BuildFromStrings(
+      "Shader2", reg, kPlaneVertexShaderString, shader_string.str(),
+      base::AllocatorPtr());
 
-  a->AddChild(b);
-  a->AddChild(c);
-  c->AddChild(d);
-  c->AddChild(e);
+  s_data.rect->AddUniform(s_data.shader->GetRegistry()->Create<Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
 
-  AddDefaultUniformsToNode(a);
+  // Add a node with the full compliment of textures.
+  NodePtr node(new Node);
+  std::vector<CubeMapTexturePtr> textures(num_textures);
+  node->SetShaderProgram(shader1);
+  for (GLuint i = 0; i < num_textures; ++i) {
+    textures[i].Reset(new CubeMapTexture);
+    for (int j = 0; j < 6; ++j)
+      textures[i]->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
+                            s_data.image);
+    textures[i]->SetSampler(s_data.sampler);
+  }
+  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
+  node->AddShape(s_data.shape);
+  s_data.rect->AddChild(node);
 
-  // Draw the scene.
-  RendererPtr renderer(new Renderer(gm_));
-  renderer->DrawScene(a);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
+  // Each texture should be bound once.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(num_textures * 6U, trace_verifier_->GetCountOf("TexImage2D"));
+  for (GLuint i = 0; i < num_textures; ++i) {
+    SCOPED_TRACE(i);
+    std::ostringstream str;
+    str << "ActiveTexture(GL_TEXTURE" << i << ")";
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
+  }
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  // Disable node b and render again.
+  // Drawing again should do nothing, since everything is already bound.
   Reset();
-  b->Enable(false);
-  a->GetStateTable()->Enable(StateTable::kBlend, false);
-  renderer->DrawScene(a);
-  // The blend state won't be sent again because it is already enabled from the
-  // first draw call.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
 
-  // Disable node c and render again.
+  // Drawing again with a framebuffer should rebind all textures, since they are
+  // all evicted when cleared.
+  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
+  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
   Reset();
-  c->Enable(false);
-  renderer->DrawScene(a);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
-}
-
-TEST_F(RendererTest, StateCompression) {
-  NodePtr a(new Node);
-  NodePtr b(new Node);
-  NodePtr c(new Node);
-  NodePtr d(new Node);
-  NodePtr e(new Node);
+  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+  renderer->BindFramebuffer(fbo);
+  EXPECT_EQ(fbo.Get(), renderer->GetCurrentFramebuffer().Get());
+  renderer->DrawScene(root);
+  renderer->BindFramebuffer(FramebufferObjectPtr());
+  EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  StateTablePtr state_table;
+  // Drawing again should rebind, since they are evicted when the framebuffer
+  // was changed.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  // The texture uniforms are sent the first draw.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1i"));
 
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kBlend, true);
-  a->SetStateTable(state_table);
+  // Add another node with the full compliment of textures.
+  textures.clear();
+  textures.resize(num_textures);
+  node.Reset(new Node);
+  node->SetShaderProgram(shader2);
+  for (GLuint i = 0; i < num_textures; ++i) {
+    textures[i].Reset(new CubeMapTexture);
+    for (int j = 0; j < 6; ++j)
+      textures[i]->SetImage(static_cast<CubeMapTexture::CubeFace>(j), 0U,
+                            s_data.image);
+    textures[i]->SetSampler(s_data.sampler);
+  }
+  node->AddUniform(CreateArrayUniform(reg, "uTextures", textures));
+  node->AddShape(s_data.shape);
+  s_data.rect->AddChild(node);
 
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kCullFace, true);
-  b->SetStateTable(state_table);
+  // Get the new resources created.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(num_textures * 6U, trace_verifier_->GetCountOf("TexImage2D"));
+  for (GLuint i = 0; i < num_textures; ++i) {
+    std::ostringstream str;
+    str << "ActiveTexture(GL_TEXTURE" << i << ")";
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(str.str()));
+  }
+  EXPECT_EQ(num_textures,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  // The texture uniforms for the new shader get their bindings.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kBlend, true);
-  state_table->Enable(StateTable::kDepthTest, true);
-  c->SetStateTable(state_table);
+  // Drawing again should rebind everything, since all textures were evicted by
+  // the second node.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(num_textures * 2U,
+            trace_verifier_->GetCountOf("ActiveTexture(GL_TEXTURE"));
+  EXPECT_EQ(num_textures * 2U,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1iv"));
 
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kScissorTest, true);
-  d->SetStateTable(state_table);
+  // Reset data.
+  s_data.rect = NULL;
+  BuildRectangle();
+}
 
-  state_table = new StateTable();
-  state_table->Enable(StateTable::kStencilTest, true);
-  e->SetStateTable(state_table);
+TEST_F(RendererTest, TextureMipmaps) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
 
-  BuildRectangleShape<uint16>();
-  a->AddShape(s_data.shape);
-  b->AddShape(s_data.shape);
-  c->AddShape(s_data.shape);
-  d->AddShape(s_data.shape);
-  e->AddShape(s_data.shape);
+  // Check that a texture with an image is sent as mipmap level 0.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(28672U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexImage2D"))
+          .HasArg(2, "0"));
 
-  AddDefaultUniformsToNode(a);
-  AddDefaultUniformsToNode(b);
-  AddDefaultUniformsToNode(c);
+  // Several images of different sizes.
+  static const uint32 kMaxImageSize = 32;
+  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
+  ImagePtr mipmaps[kNumMipmaps];
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
+                                 Image::kRgba8888);
 
-  // Draw a, which should set blend and nothing else.
-  RendererPtr renderer(new Renderer(gm_));
-  renderer->DrawScene(a);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  // Set a full image pyramid.
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    s_data.texture->SetImage(i, mipmaps[i]);
 
+  // Check consistent dimensions.
+  EXPECT_FALSE(log_checker.HasAnyMessages());
   Reset();
-  renderer->DrawScene(c);
-  // Drawing c should just enable depth test, since blending is already enabled.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_EQ(kNumMipmaps, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // Check that the texture memory increased properly.
+  EXPECT_EQ(30036U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
 
-  Reset();
-  renderer->DrawScene(b);
-  // Drawing b should disable blending and depth test but enable cull face.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_CULL_FACE)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
+  // Check the right calls were made.
+  for (uint32 i = 0; i < kNumMipmaps; ++i) {
+    SCOPED_TRACE(::testing::Message() << "Testing mipmap level " << i);
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(i, "TexImage2D"))
+            .HasArg(2, helper.ToString("GLint", static_cast<GLint>(i)))
+            .HasArg(4, helper.ToString(
+                "GLsizei", static_cast<GLint>(mipmaps[i]->GetWidth())))
+            .HasArg(5, helper.ToString(
+                "GLsizei", static_cast<GLint>(mipmaps[i]->GetHeight()))));
+  }
 
-  // Try hierarchies of nodes; the graphs look like this:
-  //     a     c
-  //     b    d e
-  a->AddChild(b);
+  // Remove a texture and verify that GenerateMipmap is called.
+  s_data.texture->SetImage(1U, ImagePtr(NULL));
   Reset();
-  renderer->DrawScene(a);
-  // When a is drawn cull face is disabled but blending enabled, and then
-  // the cull face re-enabled when b is drawn. Depth testing should not be
-  // modified since it is currently disabled.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_CULL_FACE)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST)"));
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // Since GenerateMipmap was called the override mipmaps were sent, but the
+  // 0th level mipmap doesn't have to be (GenerateMipmap won't override it).
+  EXPECT_EQ(kNumMipmaps - 2U, trace_verifier_->GetCountOf("TexImage2D"));
+  // Memory usage should not change.
+  EXPECT_EQ(30036U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
+
+  // Set an invalid image dimension.
+  s_data.texture->SetImage(
+      1U, CreateNullImage(mipmaps[1]->GetWidth() - 1, mipmaps[1]->GetHeight(),
+                          Image::kRgba8888));
 
-  c->AddChild(d);
-  c->AddChild(e);
   Reset();
-  renderer->DrawScene(c);
-  // First cull face is disabled since none of the nodes use it, then depth test
-  // is enabled (blending is already enabled!), and will stay so through
-  // inheritance.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_CULL_FACE)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST)"));
+  renderer->DrawScene(root);
+  // Nothing will be called since the texture has the right number of levels,
+  // just incorrect dimensions.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  s_msg_stream_ << "Mipmap width: " << (mipmaps[1]->GetWidth() - 1) <<
+      " is not a power of 2.";
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
+  // Memory usage should not change.
+  EXPECT_EQ(30036U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
 
-  // Drawing d will enable scissor test, while drawing e will disable it and
-  // enable stencil test.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_SCISSOR_TEST)"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_STENCIL_TEST)"));
+  s_data.texture->SetImage(
+      1U, CreateNullImage(mipmaps[1]->GetWidth(), mipmaps[1]->GetHeight() - 1,
+                          Image::kRgba8888));
 
-  // Create a scene that is very deep (> 16) and ensure state changes happen.
-  renderer.Reset(NULL);
-  Renderer::DestroyCurrentStateCache();
-  renderer.Reset(new Renderer(gm_));
   Reset();
-  NodePtr root(new Node);
-  AddDefaultUniformsToNode(root);
-  NodePtr last_node = root;
-  // Flip each cap in a new child node.
-  for (int i = 0; i < StateTable::GetCapabilityCount(); ++i) {
-    NodePtr node(new Node);
-    StateTablePtr state_table(new StateTable);
-    const StateTable::Capability cap = static_cast<StateTable::Capability>(i);
-    if (cap == StateTable::kDither)
-      state_table->Enable(cap, false);
-    else
-      state_table->Enable(cap, true);
-    node->SetStateTable(state_table);
-    node->AddShape(s_data.shape);
-    last_node->AddChild(node);
-    last_node = node;
+  renderer->DrawScene(root);
+  // Nothing will be called since the texture has the right number of levels,
+  // just incorrect dimensions.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  s_msg_stream_ << "Mipmap height: " << (mipmaps[1]->GetWidth() - 1) <<
+      " is not a power of 2.";
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", s_msg_stream_.str()));
+  // Memory usage should not change.
+  EXPECT_EQ(30036U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
+
+  // Set an invalid image dimension.
+  s_data.texture
+      ->SetImage(1U, CreateNullImage(mipmaps[1]->GetWidth(),
+                                     mipmaps[1]->GetHeight(), Image::kRgb888));
+  Reset();
+  renderer->DrawScene(root);
+  // Nothing will be called since the texture has the right number of levels,
+  // just incorrect dimensions.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_TRUE(
+      log_checker.HasMessage("ERROR", "level 1 has different format"));
+  // Memory usage should not change.
+  EXPECT_EQ(30036U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
+}
+
+TEST_F(RendererTest, ImmutableTextureStorage) {
+  RendererPtr renderer(new Renderer(gm_));
+  renderer->SetFlag(Renderer::kUseImmutableTextureStorage);
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
+
+  // A texture with a single image gets a single level of storage, which the
+  // image is uploaded into. The cube map is not affected.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexStorage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexStorage2D"))
+          .HasArg(1, "GL_TEXTURE_2D")
+          .HasArg(2, "1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+
+  // Nothing is allocated again if nothing changes.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexStorage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
+
+  static const uint32 kMaxImageSize = 32;
+  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
+  ImagePtr mipmaps[kNumMipmaps];
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
+                                 Image::kRgba8888);
+
+  // A full pyramid needs more levels, so the texture object is replaced.
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    s_data.texture->SetImage(i, mipmaps[i]);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenTextures"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexStorage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexStorage2D"))
+          .HasArg(2, "6")
+          .HasArg(4, "32")
+          .HasArg(5, "32"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(kNumMipmaps, trace_verifier_->GetCountOf("TexSubImage2D"));
+  for (uint32 i = 0; i < kNumMipmaps; ++i) {
+    SCOPED_TRACE(::testing::Message() << "Testing mipmap level " << i);
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(i, "TexSubImage2D"))
+            .HasArg(2, helper.ToString("GLint", static_cast<GLint>(i))));
   }
-  // Flip them back...
-  for (int i = 0; i < StateTable::GetCapabilityCount(); ++i) {
-    NodePtr node(new Node);
-    StateTablePtr state_table(new StateTable);
-    const StateTable::Capability cap = static_cast<StateTable::Capability>(i);
-    if (cap == StateTable::kDither)
-      state_table->Enable(cap, true);
-    else
-      state_table->Enable(cap, false);
-    node->SetStateTable(state_table);
-    node->AddShape(s_data.shape);
-    last_node->AddChild(node);
-    last_node = node;
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
+
+  // Changing one level only uploads that level into the existing storage.
+  s_data.texture->SetImage(2U, CreateNullImage(8, 8, Image::kRgba8888));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexStorage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexSubImage2D"))
+          .HasArg(2, "2"));
+
+  // When streaming, the levels are uploaded one per frame starting with the
+  // smallest, and the base level follows the finest uploaded level.
+  renderer->SetFlag(Renderer::kStreamMipmapsLowestResolutionFirst);
+  static const uint32 kNumStreamedMipmaps = 5U;
+  for (uint32 i = 0; i < kNumStreamedMipmaps; ++i)
+    s_data.texture->SetImage(
+        i, CreateNullImage(16 >> i, 16 >> i, Image::kRgba8888));
+  s_data.texture->SetImage(5U, ImagePtr());
+  for (uint32 i = 0; i < kNumStreamedMipmaps; ++i) {
+    SCOPED_TRACE(::testing::Message() << "Streaming frame " << i);
+    const std::string level = helper.ToString(
+        "GLint", static_cast<GLint>(kNumStreamedMipmaps - 1U - i));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(i == 0U ? 1U : 0U, trace_verifier_->GetCountOf("TexStorage2D"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(0U, "TexSubImage2D"))
+            .HasArg(2, level));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+    // The tracer prints a base level of 0 as GL_NONE.
+    ASSERT_EQ(1U, trace_verifier_->GetCountOf(
+        "TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+        0U, "TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL"))
+            .HasArg(3, i + 1U == kNumStreamedMipmaps ? "GL_NONE" : level));
   }
-  // ... and back again.
-  for (int i = 0; i < StateTable::GetCapabilityCount(); ++i) {
-    NodePtr node(new Node);
-    StateTablePtr state_table(new StateTable);
-    const StateTable::Capability cap = static_cast<StateTable::Capability>(i);
-    if (cap == StateTable::kDither)
-      state_table->Enable(cap, false);
-    else
-      state_table->Enable(cap, true);
-    node->SetStateTable(state_table);
-    node->AddShape(s_data.shape);
-    last_node->AddChild(node);
-    last_node = node;
+
+  // Once all levels are uploaded nothing else happens.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GL_TEXTURE_BASE_LEVEL"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST_F(RendererTest, TextureMultisamplingDisablesMipmapping) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
+
+  Reset();
+
+  EXPECT_TRUE(gm_->IsFunctionGroupAvailable(
+      GraphicsManager::kTextureMultisample));
+
+  // Set multisampling.
+  s_data.texture->SetMultisampling(4, true);
+  // Clear cubemap as we don't need it and it affects the number of times
+  // TexImage2D is invoked.
+  for (int i = 0; i < 6; ++i) {
+    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
+                             ImagePtr());
   }
+
   renderer->DrawScene(root);
-  EXPECT_EQ(StateTable::GetCapabilityCount() * 2 - 1,
-            static_cast<int>(trace_verifier_->GetCountOf("Enable")));
-  EXPECT_EQ(StateTable::GetCapabilityCount() + 1,
-            static_cast<int>(trace_verifier_->GetCountOf("Disable")));
+  // Each of the 4 samples is stored separately.
+  EXPECT_EQ(16384U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(16384U, s_data.texture->GetGpuMemoryUsed());
+
+  // Verify call to TexImage2DMultisample.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
+          .HasArg(1, "GL_TEXTURE_2D_MULTISAMPLE"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
+          .HasArg(2, "4"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexImage2DMultisample"))
+          .HasArg(6, "GL_TRUE"));
+
+  // Verify calls to TexImage2D and GenerateMipmap. "TexImage2D" is a prefix
+  // of "TexImage2DMultisample" so it should appear once.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+
+  // Several images of different sizes.
+  static const uint32 kMaxImageSize = 32;
+  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
+  ImagePtr mipmaps[kNumMipmaps];
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
+                                 Image::kRgba8888);
+
+  // Set a full image pyramid.
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    s_data.texture->SetImage(i, mipmaps[i]);
+
+  // Mipmaps should still not be used, so they are not counted against memory.
+  // "TexImage2D" is a prefix of "TexImage2DMultisample" so it should appear
+  // once.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // Check that the texture memory is as expected.
+  EXPECT_EQ(16384U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(16384U, s_data.texture->GetGpuMemoryUsed());
+
+  // Unset multisampling.
+  s_data.texture->SetMultisampling(0, false);
+
+  // Mipmaps should now be used.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // Check that the texture memory now includes the mipmaps.
+  EXPECT_EQ(5460U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
+
+  // Clear warning from clearing the cubemap textures above.
+  EXPECT_TRUE(log_checker.HasMessage("WARNING",
+      "***ION: Cubemap texture face Negative X has no level 0 mipmap."));
 }
 
-TEST_F(RendererTest, ReadImage) {
-  ImagePtr image;
+TEST_F(RendererTest, TextureMultisamplingDisablesSubImages) {
   RendererPtr renderer(new Renderer(gm_));
-  base::AllocatorPtr al;
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
+
+  Reset();
+
+  EXPECT_TRUE(gm_->IsFunctionGroupAvailable(
+      GraphicsManager::kTextureMultisample));
+
+  // Set multisampling.
+  s_data.texture->SetMultisampling(4, true);
+  // Clear cubemap as we don't need it and it affects the number of times
+  // TexImage2D is invoked.
+  for (int i = 0; i < 6; ++i) {
+    s_data.cubemap->SetImage(static_cast<CubeMapTexture::CubeFace>(i), 0U,
+                             ImagePtr());
+  }
+
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+
+  // Now set a subimage on the texture.
+  s_data.texture->SetSubImage(0U, math::Point2ui(4, 8),
+                              CreateNullImage(10, 12, Image::kRgba8888));
+
+  // Check that the subimage is NOT applied.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
+
+  // Disable multisampling.
+  s_data.texture->SetMultisampling(0, false);
+
+  // Check that the subimage is applied.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2DMultisample"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
+
+  // Clear warning from clearing the cubemap textures above.
+  EXPECT_TRUE(log_checker.HasMessage("WARNING",
+      "***ION: Cubemap texture face Negative X has no level 0 mipmap."));
+}
+
+TEST_F(RendererTest, TextureSubImages) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+  TracingHelper helper;
+
+  // Check that a texture with an image is sent as mipmap level 0.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf("TexImage2D"));
+
+  // Now set a subimage on the texture.
+  s_data.texture->SetSubImage(0U, math::Point2ui(4, 8),
+                              CreateNullImage(10, 12, Image::kRgba8888));
+  // Check that the subimage is applied.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "TexSubImage2D"))
+          .HasArg(2, "0")
+          .HasArg(3, "4")
+          .HasArg(4, "8")
+          .HasArg(5, "10")
+          .HasArg(6, "12")
+          .HasArg(7, "GL_RGB")
+          .HasArg(8, "GL_UNSIGNED_BYTE"));
+
+  // Several images of different sizes.
+  static const uint32 kMaxImageSize = 32;
+  static const uint32 kNumMipmaps = 6U;  // log2(kMaxImageSize) + 1U;
+  ImagePtr mipmaps[kNumMipmaps];
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    mipmaps[i] = CreateNullImage(kMaxImageSize >> i, kMaxImageSize >> i,
+                                 Image::kRgba8888);
+
+  // Set a full image pyramid.
+  for (uint32 i = 0; i < kNumMipmaps; ++i)
+    s_data.texture->SetImage(i, mipmaps[i]);
+
+  // Check consistent dimensions.
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_EQ(kNumMipmaps, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  EXPECT_EQ(30036U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
+
+  // Set a submipmap at level 3. Setting a compressed image requires non-NULL
+  // image data.
+  ImagePtr compressed_image(new Image);
+  compressed_image->Set(
+      Image::kDxt5, 4, 8,
+      base::DataContainerPtr(base::DataContainer::Create(
+          reinterpret_cast<void*>(1), kNullFunction, false,
+          compressed_image->GetAllocator())));
+  s_data.texture->SetSubImage(3U, math::Point2ui(2, 6), compressed_image);
+
+  // Check the right call was made.
+  Reset();
+  renderer->DrawScene(root);
+  // Technically there is an errors since the cubemap is not compressed, but
+  // this is just to test that the call is made.
+  gm_->SetErrorCode(GL_NO_ERROR);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexSubImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CompressedTexSubImage2D"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "CompressedTexSubImage2D"))
+          .HasArg(2, "3")
+          .HasArg(3, "2")
+          .HasArg(4, "6")
+          .HasArg(5, "4")
+          .HasArg(6, "8")
+          .HasArg(7, "GL_COMPRESSED_RGBA_S3TC_DXT5_EXT"));
+  // Memory usage is not affected by sub images.
+  EXPECT_EQ(30036U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  EXPECT_EQ(5460U, s_data.texture->GetGpuMemoryUsed());
+}
+
+TEST_F(RendererTest, TextureMisc) {
+  // Test various texture corner cases.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  base::LogChecker log_checker;
+
+  // Check that a texture with no image does not get sent.
+  s_data.texture->SetImage(0U, ImagePtr(NULL));
+  s_data.texture->SetLabel("texture");
+  Reset();
+  renderer->DrawScene(root);
+  // The cubemap is still sent.
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D"));
+  s_data.texture->SetImage(0U, s_data.image);
+  EXPECT_TRUE(
+      log_checker.HasMessage("WARNING", "Texture \"texture\" has no level 0"));
+
+  // Check that a GenerateMipmap is called if requested.
+  s_data.sampler->SetAutogenerateMipmapsEnabled(true);
+  Reset();
+  renderer->DrawScene(root);
+  // Both the cubemap and texture will generate mipmaps.
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenerateMipmap"));
+  // Check that when disabled GenerateMipmap is not called.
+  s_data.sampler->SetAutogenerateMipmapsEnabled(false);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenerateMipmap"));
+
+  // Check error cases for non-power-of-2 textures.
+  s_data.image->Set(s_options.image_format, 32, 33, s_data.image_container);
+  s_data.sampler->SetMinFilter(Sampler::kLinearMipmapNearest);
+  s_data.sampler->SetWrapS(Sampler::kClampToEdge);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+
+  s_data.image->Set(s_options.image_format, 33, 32, s_data.image_container);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+
+  s_data.image->Set(s_options.image_format, 32, 33, s_data.image_container);
+  s_data.sampler->SetWrapS(Sampler::kRepeat);
+  s_data.sampler->SetWrapT(Sampler::kClampToEdge);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Non-power-of-two textures"));
+
+  s_data.sampler->SetWrapT(Sampler::kRepeat);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Reset data.
+  BuildRectangle();
+}
+
+TEST_F(RendererTest, TextureCompareFunction) {
+  VerifyRenderData<Sampler::CompareFunction> verify_data;
+  verify_data.option = &s_options.compare_func;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_COMPARE_FUNC"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            4, Sampler::kAlways, "GL_ALWAYS"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            0, Sampler::kEqual, "GL_EQUAL"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            0, Sampler::kGreater, "GL_GREATER"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            0, Sampler::kGreaterOrEqual, "GL_GEQUAL"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            0, Sampler::kLess, "GL_LESS"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            0, Sampler::kLessOrEqual, "GL_LEQUAL"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            0, Sampler::kNever, "GL_NEVER"));
+  verify_data.arg_tests.push_back(
+        VaryingArg<Sampler::CompareFunction>(
+            0, Sampler::kNotEqual, "GL_NOTEQUAL"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureCompareMode) {
+  VerifyRenderData<Sampler::CompareMode> verify_data;
+  verify_data.option = &s_options.compare_mode;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_COMPARE_MODE"));
+  verify_data.arg_tests.push_back(VaryingArg<Sampler::CompareMode>(
+      5, Sampler::kCompareToTexture, "GL_COMPARE_REF_TO_TEXTURE"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::CompareMode>(0, Sampler::kNone, "GL_NONE"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureMaxAnisotropy) {
+  VerifyRenderData<float> verify_data;
+  verify_data.option = &s_options.max_anisotropy;
+  verify_data.static_args.push_back(
+      StaticArg(2, "GL_TEXTURE_MAX_ANISOTROPY_EXT"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(0, 10.f, "10"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(0, 4.f, "4"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(0, 1.f, "1"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+
+  // Check that max anisotropy is bounded.
+  Reset();
+  s_options.max_anisotropy = 32.f;
+  NodePtr root = BuildGraph(800, 800);
+  RendererPtr renderer(new Renderer(gm_));
+  renderer->DrawScene(root);
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "SamplerParameterf"))
+          .HasArg(2, "GL_TEXTURE_MAX_ANISOTROPY_EXT")
+          .HasArg(3, "16"));
+
+  // Disable anisotropy and make no anisotropy call is made.
+  gm_->SetExtensionsString("");
+  Reset();
+  root = BuildGraph(800, 800);
+  renderer->DrawScene(root);
+  EXPECT_EQ(std::string::npos, trace_verifier_->GetTraceString().find(
+                                   "GL_TEXTURE_MAX_ANISOTROPY_EXT"));
+  s_options.max_anisotropy = 1.f;
+}
+
+TEST_F(RendererTest, TextureMagFilter) {
+  VerifyRenderData<Sampler::FilterMode> verify_data;
+  verify_data.option = &s_options.mag_filter;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MAG_FILTER"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(1, Sampler::kLinear, "GL_LINEAR"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(0, Sampler::kNearest, "GL_NEAREST"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureMaxLod) {
+  VerifyRenderData<float> verify_data;
+  verify_data.option = &s_options.max_lod;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MAX_LOD"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(1, 100.f, "100"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(0, -2.1f, "-2.1"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(0, 23.45f, "23.45"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureMinFilter) {
+  VerifyRenderData<Sampler::FilterMode> verify_data;
+  verify_data.option = &s_options.min_filter;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MIN_FILTER"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(
+          0, Sampler::kLinear, "GL_LINEAR"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(
+          0, Sampler::kNearest, "GL_NEAREST"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(
+          0, Sampler::kNearestMipmapNearest, "GL_NEAREST_MIPMAP_NEAREST"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(
+          0, Sampler::kNearestMipmapLinear, "GL_NEAREST_MIPMAP_LINEAR"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(
+          0, Sampler::kLinearMipmapNearest, "GL_LINEAR_MIPMAP_NEAREST"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::FilterMode>(
+          0, Sampler::kLinearMipmapLinear, "GL_LINEAR_MIPMAP_LINEAR"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureMinLod) {
+  VerifyRenderData<float> verify_data;
+  verify_data.option = &s_options.min_lod;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MIN_LOD"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(2, 10.f, "10"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(0, -3.1f, "-3.1"));
+  verify_data.arg_tests.push_back(VaryingArg<float>(0, 12.34f, "12.34"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureWrapR) {
+  VerifyRenderData<Sampler::WrapMode> verify_data;
+  verify_data.option = &s_options.wrap_r;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_WRAP_R"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          6, Sampler::kClampToEdge, "GL_CLAMP_TO_EDGE"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          0, Sampler::kRepeat, "GL_REPEAT"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          0, Sampler::kMirroredRepeat, "GL_MIRRORED_REPEAT"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureWrapS) {
+  VerifyRenderData<Sampler::WrapMode> verify_data;
+  verify_data.option = &s_options.wrap_s;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_WRAP_S"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          2, Sampler::kClampToEdge, "GL_CLAMP_TO_EDGE"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          0, Sampler::kRepeat, "GL_REPEAT"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          0, Sampler::kMirroredRepeat, "GL_MIRRORED_REPEAT"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureWrapT) {
+  VerifyRenderData<Sampler::WrapMode> verify_data;
+  verify_data.option = &s_options.wrap_t;
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_WRAP_T"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          3, Sampler::kClampToEdge, "GL_CLAMP_TO_EDGE"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          0, Sampler::kRepeat, "GL_REPEAT"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Sampler::WrapMode>(
+          0, Sampler::kMirroredRepeat, "GL_MIRRORED_REPEAT"));
+  EXPECT_TRUE(VerifySamplerAndTextureCalls(this, &verify_data));
+}
+
+TEST_F(RendererTest, TextureBaseLevel) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root;
+
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<int> verify_data;
+  verify_data.update_func = BuildRectangle;
+  verify_data.call_name = "TexParameteri";
+  verify_data.option = &s_options.base_level;
+  verify_data.varying_arg_index = 3U;
+  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_BASE_LEVEL"));
+  verify_data.arg_tests.push_back(VaryingArg<int>(0, 10, "10"));
+  verify_data.arg_tests.push_back(VaryingArg<int>(0, 3, "3"));
+  verify_data.arg_tests.push_back(VaryingArg<int>(0, 123, "123"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
+
+TEST_F(RendererTest, TextureMaxLevel) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root;
+
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<int> verify_data;
+  verify_data.update_func = BuildRectangle;
+  verify_data.call_name = "TexParameteri";
+  verify_data.option = &s_options.max_level;
+  verify_data.varying_arg_index = 3U;
+  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
+  verify_data.static_args.push_back(StaticArg(2, "GL_TEXTURE_MAX_LEVEL"));
+  verify_data.arg_tests.push_back(VaryingArg<int>(1, 100, "100"));
+  verify_data.arg_tests.push_back(VaryingArg<int>(0, 33, "33"));
+  verify_data.arg_tests.push_back(VaryingArg<int>(0, 1234, "1234"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
+
+TEST_F(RendererTest, TextureSwizzleRed) {
+  RendererPtr renderer(new Renderer(gm_));
+  TracingHelper helper;
+  NodePtr root;
+
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<Texture::Swizzle> verify_data;
+  verify_data.update_func = BuildRectangle;
+  verify_data.call_name = "TexParameteri";
+  verify_data.option = &s_options.swizzle_r;
+  verify_data.varying_arg_index = 3U;
+  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
+  verify_data.static_args.push_back(
+      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_R)));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(2, Texture::kGreen, "GL_GREEN"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kBlue, "GL_BLUE"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kAlpha, "GL_ALPHA"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kRed, "GL_RED"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
+
+TEST_F(RendererTest, TextureSwizzleGreen) {
+  RendererPtr renderer(new Renderer(gm_));
+  TracingHelper helper;
+  NodePtr root;
+
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<Texture::Swizzle> verify_data;
+  verify_data.update_func = BuildRectangle;
+  verify_data.call_name = "TexParameteri";
+  verify_data.option = &s_options.swizzle_g;
+  verify_data.varying_arg_index = 3U;
+  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
+  verify_data.static_args.push_back(
+      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_G)));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(3, Texture::kBlue, "GL_BLUE"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kAlpha, "GL_ALPHA"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kRed, "GL_RED"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kGreen, "GL_GREEN"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
+
+TEST_F(RendererTest, TextureSwizzleBlue) {
+  RendererPtr renderer(new Renderer(gm_));
+  TracingHelper helper;
+  NodePtr root;
+
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<Texture::Swizzle> verify_data;
+  verify_data.update_func = BuildRectangle;
+  verify_data.call_name = "TexParameteri";
+  verify_data.option = &s_options.swizzle_b;
+  verify_data.varying_arg_index = 3U;
+  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
+  verify_data.static_args.push_back(
+      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_B)));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(4, Texture::kAlpha, "GL_ALPHA"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kRed, "GL_RED"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kGreen, "GL_GREEN"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kBlue, "GL_BLUE"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
+
+TEST_F(RendererTest, TextureSwizzleAlpha) {
+  RendererPtr renderer(new Renderer(gm_));
+  TracingHelper helper;
+  NodePtr root;
+
+  root = BuildGraph(kWidth, kHeight);
+  VerifyRenderData<Texture::Swizzle> verify_data;
+  verify_data.update_func = BuildRectangle;
+  verify_data.call_name = "TexParameteri";
+  verify_data.option = &s_options.swizzle_a;
+  verify_data.varying_arg_index = 3U;
+  verify_data.static_args.push_back(StaticArg(1, "GL_TEXTURE_2D"));
+  verify_data.static_args.push_back(
+      StaticArg(2, helper.ToString("GLtextureenum", GL_TEXTURE_SWIZZLE_A)));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(5, Texture::kRed, "GL_RED"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kGreen, "GL_GREEN"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kBlue, "GL_BLUE"));
+  verify_data.arg_tests.push_back(
+      VaryingArg<Texture::Swizzle>(0, Texture::kAlpha, "GL_ALPHA"));
+  EXPECT_TRUE(VerifyRenderCalls(verify_data, trace_verifier_, renderer, root));
+
+  Reset();
+  renderer = NULL;
+  EXPECT_TRUE(VerifyReleases(1));
+}
+
+TEST_F(RendererTest, MultipleRenderers) {
+  // Multiple Renderers create multiple instances of the same resources.
+  // There isn't (yet) a way to get at the internal state of the
+  // ResourceManager, but this at least will create ResourceGroups.
+  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, false);
+  {
+    RendererPtr renderer1(new Renderer(gm_));
+    RendererPtr renderer2(new Renderer(gm_));
+
+    // Draw the simplest possible scene.
+    NodePtr root = BuildGraph(800, 800);
+    // Drawing will create resources.
+    renderer1->DrawScene(root);
+    renderer2->DrawScene(root);
+    // Improve coverage by changing a group bit.
+    s_data.sampler->SetWrapS(Sampler::kMirroredRepeat);
+    renderer1->DrawScene(root);
+    renderer2->DrawScene(root);
+
+    // Each renderer has its own resources and memory counts.
+    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer1, 12U + kVboSize, 0U, 28672U));
+    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer2, 12U + kVboSize, 0U, 28672U));
+    // Memory usage per holder should be doubled; one resource per renderer.
+    EXPECT_EQ(24U, s_data.index_buffer->GetGpuMemoryUsed());
+    EXPECT_EQ(8U * sizeof(Vertex), s_data.vertex_buffer->GetGpuMemoryUsed());
+    EXPECT_EQ(8192U, s_data.texture->GetGpuMemoryUsed());
+    EXPECT_EQ(49152U, s_data.cubemap->GetGpuMemoryUsed());
+
+    Reset();
+    // Force calls to OnDestroyed().
+    s_data.attribute_array = NULL;
+    s_data.vertex_buffer = NULL;
+    s_data.index_buffer = NULL;
+    s_data.shader = NULL;
+    s_data.shape = NULL;
+    s_data.texture = NULL;
+    s_data.cubemap = NULL;
+    s_data.rect = NULL;
+    root->ClearChildren();
+    root->ClearUniforms();
+    root->SetShaderProgram(ShaderProgramPtr(NULL));
+    // Force calls to ReleaseAll().
+    renderer1->DrawScene(root);
+    renderer2->DrawScene(root);
+    // It can take two calls to free up all resources because some may be added
+    // to the release queue during traversal.
+    renderer1->DrawScene(root);
+    renderer2->DrawScene(root);
+    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer1, 0U, 0U, 0U));
+    EXPECT_TRUE(VerifyGpuMemoryUsage(renderer2, 0U, 0U, 0U));
+    // Everything will be destroyed since the resources go away.
+    std::vector<std::string> call_strings;
+    call_strings.push_back("Clear");
+    call_strings.push_back("Clear");
+    call_strings.push_back("Clear");
+    call_strings.push_back("Clear");
+    call_strings.push_back("DeleteBuffers");
+    call_strings.push_back("DeleteBuffers");
+    call_strings.push_back("DeleteBuffers");
+    call_strings.push_back("DeleteBuffers");
+    call_strings.push_back("DeleteProgram");
+    call_strings.push_back("DeleteProgram");
+    call_strings.push_back("DeleteShader");
+    call_strings.push_back("DeleteShader");
+    call_strings.push_back("DeleteShader");
+    call_strings.push_back("DeleteShader");
+    call_strings.push_back("DeleteTextures");
+    call_strings.push_back("DeleteTextures");
+    call_strings.push_back("DeleteTextures");
+    call_strings.push_back("DeleteTextures");
+    call_strings.push_back("DeleteVertexArrays");
+    call_strings.push_back("DeleteVertexArrays");
+    EXPECT_TRUE(trace_verifier_->VerifySortedCalls(call_strings));
+    Reset();
+    root = NULL;
+    renderer1 = NULL;
+    renderer2 = NULL;
+    EXPECT_EQ(0U, trace_verifier_->GetCallCount());
+  }
+  // Reset data.
+  BuildRectangle();
+
+  {
+    RendererPtr renderer1(new Renderer(gm_));
+    RendererPtr renderer2(new Renderer(gm_));
+    RendererPtr renderer3(new Renderer(gm_));
+
+    // Draw the simplest possible scene.
+    NodePtr root = BuildGraph(800, 800);
+    renderer1->DrawScene(root);
+    renderer2->DrawScene(root);
+    renderer3->DrawScene(root);
+    Reset();
+    // Force resource deletion from a renderer.
+    renderer1 = NULL;
+    // Force calls to OnDestroyed().
+    root = NULL;
+    s_data.shape = NULL;
+    s_data.rect = NULL;
+    renderer2 = NULL;
+    renderer3 = NULL;
+    EXPECT_TRUE(VerifyReleases(3));
+  }
+
+  {
+    RendererPtr renderer1(new Renderer(gm_));
+    RendererPtr renderer2(new Renderer(gm_));
+    RendererPtr renderer3(new Renderer(gm_));
+
+    // Draw the simplest possible scene.
+    NodePtr root = BuildGraph(800, 800);
+    renderer1->DrawScene(root);
+    renderer2->DrawScene(root);
+    renderer3->DrawScene(root);
+    Reset();
+
+    // Clear resources to improve coverage.
+    renderer3->ClearAllResources();
+    EXPECT_TRUE(VerifyReleases(1));
+    Reset();
+    renderer1->ClearResources(s_data.attribute_array.Get());
+    renderer2->ClearTypedResources(Renderer::kTexture);
+    renderer1 = NULL;
+    // Force calls to OnDestroyed().
+    root = NULL;
+    s_data.shape = NULL;
+    s_data.rect = NULL;
+    renderer2 = NULL;
+    EXPECT_TRUE(VerifyReleases(2));
+  }
+
+  // Reset data.
+  BuildRectangle();
+
+  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, true);
+}
+
+TEST_F(RendererTest, Clearing) {
+  NodePtr node(new Node);
+  StateTablePtr state_table;
+  RendererPtr renderer(new Renderer(gm_));
+
+  state_table = new StateTable();
+  state_table->SetClearDepthValue(0.5f);
+  node->SetStateTable(state_table);
+
+  Reset();
+  renderer->DrawScene(node);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearDepthf(0.5)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_DEPTH_BUFFER_BIT)"));
+
+  state_table = new StateTable();
+  state_table->SetClearColor(math::Vector4f(0.3f, 0.3f, 0.5f, 1.0f));
+  state_table->SetClearDepthValue(0.25f);
+  node->SetStateTable(state_table);
+
+  Reset();
+  renderer->DrawScene(node);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0.3, 0.3, 0.5, 1)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearDepthf(0.25)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+      "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT)"));
+
+  state_table = new StateTable();
+  state_table->SetClearStencilValue(27);
+  node->SetStateTable(state_table);
+
+  Reset();
+  renderer->DrawScene(node);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearStencil(27)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_STENCIL_BUFFER_BIT)"));
+
+  state_table = new StateTable();
+  state_table->SetClearDepthValue(0.15f);
+  state_table->SetClearColor(math::Vector4f(0.2f, 0.1f, 0.5f, 0.3f));
+  state_table->SetClearStencilValue(123);
+  node->SetStateTable(state_table);
+
+  Reset();
+  renderer->DrawScene(node);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0.2, 0.1, 0.5, 0.3)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearDepthf(0.15)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearStencil(123)"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf(
+                "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | "
+                "GL_STENCIL_BUFFER_BIT)"));
+
+  // In a simple hierarchy with the clears at the root, no other nodes should
+  // trigger a clear.
+  NodePtr child1(new Node);
+  NodePtr child2(new Node);
+  node->AddChild(child1);
+  node->AddChild(child2);
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kBlend, true);
+  child1->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kCullFace, true);
+  child2->SetStateTable(state_table);
+
+  Reset();
+  renderer->DrawScene(node);
+  // The particular values are already set.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearColor"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearDepthf"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearStencil"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf(
+                "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | "
+                "GL_STENCIL_BUFFER_BIT)"));
+
+  // If an internal node clears, only it should be cleared.
+  NodePtr parent(new Node);
+  parent->AddChild(node);
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kStencilTest, true);
+  parent->SetStateTable(state_table);
+
+  Reset();
+  renderer->DrawScene(node);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearColor"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearDepthf"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClearStencil"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf(
+                "Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | "
+                "GL_STENCIL_BUFFER_BIT)"));
+
+  // Test that clear colors are propagated correctly.
+  NodePtr clear_node_blue(new Node);
+  state_table = new StateTable();
+  state_table->SetClearColor(math::Vector4f(0.0f, 0.0f, 1.0f, 1.0f));
+  clear_node_blue->SetStateTable(state_table);
+
+  NodePtr clear_node_black(new Node);
+  state_table = new StateTable();
+  state_table->SetClearColor(math::Vector4f(0.0f, 0.0f, 0.0f, 0.0f));
+  clear_node_black->SetStateTable(state_table);
+
+  BuildGraph(kWidth, kHeight);
+  NodePtr shape_node(new Node);
+  shape_node->SetShaderProgram(s_data.shader);
+  AddPlaneShaderUniformsToNode(shape_node);
+  shape_node->AddShape(s_data.shape);
+  shape_node->AddChild(clear_node_black);
+
+  Reset();
+  renderer->DrawScene(clear_node_blue);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0, 0, 1, 1)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_COLOR_BUFFER_BIT)"));
+
+  Reset();
+  renderer->DrawScene(shape_node);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClearColor(0, 0, 0, 0)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Clear(GL_COLOR_BUFFER_BIT)"));
+}
+
+TEST_F(RendererTest, ClearingResources) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(800, 800);
+  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
+  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
+  renderer->BindFramebuffer(fbo);
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  Reset();
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+
+  // Clear an entire scene at once.
+  Reset();
+  renderer->ClearAllResources();
+  // Check that all memory was released.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 0U, 0U, 0U));
+  EXPECT_EQ(0U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
+  renderer->BindFramebuffer(fbo);
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteTexture"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenVertexArrays(1"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenBuffers(1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenFramebuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenRenderbuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenTextures(1, "));
+  // The texture is bound twice, once for the framebuffer, and again when it is
+  // used.
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_2D"));
+  EXPECT_EQ(
+      7U, trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf(
+                "TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 32, 32, 0, GL_RGBA, "
+                "GL_UNSIGNED_BYTE"));
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf("SamplerParameteri"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("SamplerParameterf"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  EXPECT_EQ(6U,
+            trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_CUBE_MAP"));
+  EXPECT_EQ(6U,
+            trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE_MAP"));
+  EXPECT_EQ(
+      1U,
+      trace_verifier_->GetCountOf("BindBuffer(GL_ELEMENT_ARRAY_BUFFER"));
+  EXPECT_EQ(
+      1U,
+      trace_verifier_->GetCountOf("BufferData(GL_ELEMENT_ARRAY_BUFFER, 12"));
+  // Everything should be recreated.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+
+  // AttributeArray.
+  Reset();
+  renderer->ClearResources(s_data.attribute_array.Get());
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenVertexArrays(1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindVertexArray"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EnableVertexAttribArray"));
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+
+  // BufferObject.
+  Reset();
+  renderer->ClearResources(s_data.vertex_buffer.Get());
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U, 32768U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  renderer->DrawScene(root);
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  // Check calls.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenBuffers(1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+
+  // CubeMapTexture.
+  Reset();
+  renderer->ClearResources(s_data.cubemap.Get());
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 4096U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, s_data.cubemap->GetGpuMemoryUsed());
+  renderer->DrawScene(root);
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  // Check calls.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenTextures(1, "));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_CUBE_MAP"));
+  EXPECT_EQ(6U,
+            trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_CUBE_MAP"));
+  EXPECT_EQ(
+      6U, trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
+  EXPECT_EQ(6U,
+            trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_CUBE_MAP"));
+
+  // Framebuffer.
+  Reset();
+  renderer->ClearResources(fbo.Get());
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 0U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  renderer->BindFramebuffer(fbo);
+  renderer->DrawScene(root);
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  // Check calls.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenSamplers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenFramebuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenRenderbuffers"));
+
+  // Sampler.
+  Reset();
+  renderer->ClearResources(s_data.sampler.Get());
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenSamplers"));
+  // The sampler should be bound for both the texture and cubemap. The texture
+  // is bound twice, once when it is created, and again after it is bound to a
+  // uniform.
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindSampler"));
+  EXPECT_EQ(7U, trace_verifier_->GetCountOf("SamplerParameteri"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("SamplerParameterf"));
+
+  // Shader.
+  Reset();
+  renderer->ClearResources(s_data.shader->GetFragmentShader().Get());
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ShaderSource"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("AttachShader"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceiv"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
+
+  // ShaderProgram.
+  Reset();
+  renderer->ClearResources(s_data.shader.Get());
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("AttachShader"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceiv"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
+
+  // Texture.
+  Reset();
+  renderer->ClearResources(s_data.texture.Get());
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U, 24576U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(0U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  renderer->DrawScene(root);
+  // Check memory usage.
+  EXPECT_TRUE(VerifyGpuMemoryUsage(renderer, 12U + kVboSize, 32768U,
+                                   28672U));
+  EXPECT_EQ(12U, s_data.index_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(kVboSize, s_data.vertex_buffer->GetGpuMemoryUsed());
+  EXPECT_EQ(32768U, fbo->GetGpuMemoryUsed());
+  EXPECT_EQ(4096U, s_data.texture->GetGpuMemoryUsed());
+  EXPECT_EQ(24576U, s_data.cubemap->GetGpuMemoryUsed());
+  // Check calls.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenTextures(1, "));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_2D"));
+  EXPECT_EQ(
+      1U, trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf(
+                "TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 32, 32, 0, GL_RGBA, "
+                "GL_UNSIGNED_BYTE"));
+
+  // Clear all Shaders.
+  Reset();
+  renderer->ClearTypedResources(Renderer::kShader);
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteFramebuffers"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteSamplers"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteShader"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteTextures"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("ShaderSource"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("AttachShader"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceiv"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
+}
+
+TEST_F(RendererTest, DisabledNodes) {
+  // Build a graph with multiple nodes, each with a StateTable that enables
+  // a different capability.
+  // The graph looks like this:
+  //        a
+  //     b     c
+  //          d e
+  NodePtr a(new Node);
+  NodePtr b(new Node);
+  NodePtr c(new Node);
+  NodePtr d(new Node);
+  NodePtr e(new Node);
+
+  StateTablePtr state_table;
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kBlend, true);
+  a->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kCullFace, true);
+  b->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kDepthTest, true);
+  c->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kScissorTest, true);
+  d->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kStencilTest, true);
+  e->SetStateTable(state_table);
+
+  BuildRectangleShape<uint16>();
+  a->AddShape(s_data.shape);
+  b->AddShape(s_data.shape);
+  c->AddShape(s_data.shape);
+  d->AddShape(s_data.shape);
+  e->AddShape(s_data.shape);
+
+  a->AddChild(b);
+  a->AddChild(c);
+  c->AddChild(d);
+  c->AddChild(e);
+
+  AddDefaultUniformsToNode(a);
+
+  // Draw the scene.
+  RendererPtr renderer(new Renderer(gm_));
+  renderer->DrawScene(a);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
+
+  // Disable node b and render again.
+  Reset();
+  b->Enable(false);
+  a->GetStateTable()->Enable(StateTable::kBlend, false);
+  renderer->DrawScene(a);
+  // The blend state won't be sent again because it is already enabled from the
+  // first draw call.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
+
+  // Disable node c and render again.
+  Reset();
+  c->Enable(false);
+  renderer->DrawScene(a);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
+}
+
+TEST_F(RendererTest, StateCompression) {
+  NodePtr a(new Node);
+  NodePtr b(new Node);
+  NodePtr c(new Node);
+  NodePtr d(new Node);
+  NodePtr e(new Node);
+
+  StateTablePtr state_table;
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kBlend, true);
+  a->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kCullFace, true);
+  b->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kBlend, true);
+  state_table->Enable(StateTable::kDepthTest, true);
+  c->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kScissorTest, true);
+  d->SetStateTable(state_table);
+
+  state_table = new StateTable();
+  state_table->Enable(StateTable::kStencilTest, true);
+  e->SetStateTable(state_table);
+
+  BuildRectangleShape<uint16>();
+  a->AddShape(s_data.shape);
+  b->AddShape(s_data.shape);
+  c->AddShape(s_data.shape);
+  d->AddShape(s_data.shape);
+  e->AddShape(s_data.shape);
+
+  AddDefaultUniformsToNode(a);
+  AddDefaultUniformsToNode(b);
+  AddDefaultUniformsToNode(c);
+
+  // Draw a, which should set blend and nothing else.
+  RendererPtr renderer(new Renderer(gm_));
+  renderer->DrawScene(a);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+
+  Reset();
+  renderer->DrawScene(c);
+  // Drawing c should just enable depth test, since blending is already enabled.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+
+  Reset();
+  renderer->DrawScene(b);
+  // Drawing b should disable blending and depth test but enable cull face.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_CULL_FACE)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
+
+  // Try hierarchies of nodes; the graphs look like this:
+  //     a     c
+  //     b    d e
+  a->AddChild(b);
+  Reset();
+  renderer->DrawScene(a);
+  // When a is drawn cull face is disabled but blending enabled, and then
+  // the cull face re-enabled when b is drawn. Depth testing should not be
+  // modified since it is currently disabled.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_CULL_FACE)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_CULL_FACE)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST)"));
+
+  c->AddChild(d);
+  c->AddChild(e);
+  Reset();
+  renderer->DrawScene(c);
+  // First cull face is disabled since none of the nodes use it, then depth test
+  // is enabled (blending is already enabled!), and will stay so through
+  // inheritance.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_CULL_FACE)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST)"));
+
+  // Drawing d will enable scissor test, while drawing e will disable it and
+  // enable stencil test.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_SCISSOR_TEST)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_STENCIL_TEST)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_SCISSOR_TEST)"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_STENCIL_TEST)"));
+
+  // Create a scene that is very deep (> 16) and ensure state changes happen.
+  renderer.Reset(NULL);
+  Renderer::DestroyCurrentStateCache();
+  renderer.Reset(new Renderer(gm_));
+  Reset();
+  NodePtr root(new Node);
+  AddDefaultUniformsToNode(root);
+  NodePtr last_node = root;
+  // Flip each cap in a new child node.
+  for (int i = 0; i < StateTable::GetCapabilityCount(); ++i) {
+    NodePtr node(new Node);
+    StateTablePtr state_table(new StateTable);
+    const StateTable::Capability cap = static_cast<StateTable::Capability>(i);
+    if (cap == StateTable::kDither)
+      state_table->Enable(cap, false);
+    else
+      state_table->Enable(cap, true);
+    node->SetStateTable(state_table);
+    node->AddShape(s_data.shape);
+    last_node->AddChild(node);
+    last_node = node;
+  }
+  // Flip them back...
+  for (int i = 0; i < StateTable::GetCapabilityCount(); ++i) {
+    NodePtr node(new Node);
+    StateTablePtr state_table(new StateTable);
+    const StateTable::Capability cap = static_cast<StateTable::Capability>(i);
+    if (cap == StateTable::kDither)
+      state_table->Enable(cap, true);
+    else
+      state_table->Enable(cap, false);
+    node->SetStateTable(state_table);
+    node->AddShape(s_data.shape);
+    last_node->AddChild(node);
+    last_node = node;
+  }
+  // ... and back again.
+  for (int i = 0; i < StateTable::GetCapabilityCount(); ++i) {
+    NodePtr node(new Node);
+    StateTablePtr state_table(new StateTable);
+    const StateTable::Capability cap = static_cast<StateTable::Capability>(i);
+    if (cap == StateTable::kDither)
+      state_table->Enable(cap, false);
+    else
+      state_table->Enable(cap, true);
+    node->SetStateTable(state_table);
+    node->AddShape(s_data.shape);
+    last_node->AddChild(node);
+    last_node = node;
+  }
+  renderer->DrawScene(root);
+  EXPECT_EQ(StateTable::GetCapabilityCount() * 2 - 1,
+            static_cast<int>(trace_verifier_->GetCountOf("Enable")));
+  EXPECT_EQ(StateTable::GetCapabilityCount() + 1,
+            static_cast<int>(trace_verifier_->GetCountOf("Disable")));
+}
+
+TEST_F(RendererTest, ReadImage) {
+  ImagePtr image;
+  RendererPtr renderer(new Renderer(gm_));
+  base::AllocatorPtr al;
+
+  image = renderer->ReadImage(
+      Range2i::BuildWithSize(Point2i(0, 0), Vector2i(50U, 80U)),
+      Image::kRgb565, al);
+  EXPECT_TRUE(image->GetData()->GetData() != NULL);
+  EXPECT_EQ(Image::kRgb565, image->GetFormat());
+  EXPECT_EQ(50U, image->GetWidth());
+  EXPECT_EQ(80U, image->GetHeight());
+
+  image = renderer->ReadImage(
+      Range2i::BuildWithSize(Point2i(20, 10), Vector2i(50U, 80U)),
+      Image::kRgba8888, al);
+  EXPECT_TRUE(image->GetData()->GetData() != NULL);
+  EXPECT_EQ(Image::kRgba8888, image->GetFormat());
+  EXPECT_EQ(50U, image->GetWidth());
+  EXPECT_EQ(80U, image->GetHeight());
+
+  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
+  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
+  renderer->BindFramebuffer(fbo);
+  image = renderer->ReadImage(
+      Range2i::BuildWithSize(Point2i(0, 0), Vector2i(128U, 128U)),
+      Image::kRgb888, al);
+  EXPECT_TRUE(image->GetData()->GetData() != NULL);
+  EXPECT_EQ(Image::kRgb888, image->GetFormat());
+  EXPECT_EQ(128U, image->GetWidth());
+  EXPECT_EQ(128U, image->GetHeight());
+  renderer->BindFramebuffer(FramebufferObjectPtr());
+
+  image = renderer->ReadImage(
+      Range2i::BuildWithSize(Point2i(20, 10), Vector2i(50U, 80U)),
+      Image::kRgba8888, al);
+  EXPECT_TRUE(image->GetData()->GetData() != NULL);
+  EXPECT_EQ(Image::kRgba8888, image->GetFormat());
+  EXPECT_EQ(50U, image->GetWidth());
+  EXPECT_EQ(80U, image->GetHeight());
+}
+
+TEST_F(RendererTest, ReadImageAsync) {
+  RendererPtr renderer(new Renderer(gm_));
+  base::AllocatorPtr al;
+  NodePtr root = BuildGraph(kWidth, kHeight);
+
+  // The pixels are read into a pack buffer and delivered after the next
+  // frame, once its fence has signaled.
+  Reset();
+  Renderer::ImageReadbackPtr readback = renderer->ReadImageAsync(
+      Range2i::BuildWithSize(Point2i(20, 10), Vector2i(50U, 80U)),
+      Image::kRgba8888, al);
+  EXPECT_FALSE(readback->IsReady());
+  EXPECT_FALSE(readback->GetImage().Get());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ReadPixels"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("FenceSync"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+      "BufferData(GL_PIXEL_PACK_BUFFER, 16000"));
+  renderer->DrawScene(root);
+  EXPECT_TRUE(readback->IsReady());
+  ImagePtr image = readback->GetImage();
+  ASSERT_TRUE(image.Get());
+  EXPECT_TRUE(image->GetData()->GetData() != NULL);
+  EXPECT_EQ(Image::kRgba8888, image->GetFormat());
+  EXPECT_EQ(50U, image->GetWidth());
+  EXPECT_EQ(80U, image->GetHeight());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+
+  // The buffer is reused by later reads that fit, and waiting delivers the
+  // images immediately.
+  Reset();
+  Renderer::ImageReadbackPtr readback2 = renderer->ReadImageAsync(
+      Range2i::BuildWithSize(Point2i(0, 0), Vector2i(10U, 10U)),
+      Image::kRgb888, al);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenBuffers"));
+  EXPECT_FALSE(readback2->IsReady());
+  renderer->ProcessImageReadbacks(true);
+  EXPECT_TRUE(readback2->IsReady());
+  EXPECT_EQ(Image::kRgb888, readback2->GetImage()->GetFormat());
+  EXPECT_EQ(10U, readback2->GetImage()->GetWidth());
+
+  // Without fences the pixels are read immediately.
+  gm_->EnableFunctionGroup(GraphicsManager::kSync, false);
+  Reset();
+  Renderer::ImageReadbackPtr readback3 = renderer->ReadImageAsync(
+      Range2i::BuildWithSize(Point2i(0, 0), Vector2i(10U, 10U)),
+      Image::kRgba8888, al);
+  EXPECT_TRUE(readback3->IsReady());
+  EXPECT_TRUE(readback3->GetImage().Get());
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("FenceSync"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer"));
+  gm_->EnableFunctionGroup(GraphicsManager::kSync, true);
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+}
+
+TEST_F(RendererTest, ProfileLabeledNodeGpuTime) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  root->SetLabel("map");
+  s_data.rect->SetLabel("roads");
+  NodePtr overlay(new Node);
+  overlay->SetLabel("overlay");
+  overlay->AddChild(s_data.rect);
+  root->AddChild(overlay);
+  std::vector<Renderer::NodeGpuTimes> delivered;
+  renderer->SetNodeGpuTimesCallback(
+      [&delivered](const Renderer::NodeGpuTimes& times) {
+        delivered.push_back(times);
+      });
+
+  // Nothing is measured by default.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("QueryCounter"));
+  EXPECT_EQ(0U, renderer->GetNodeGpuTimes().frame);
+
+  // Each labeled Node writes a timestamp before and after its subtree. The
+  // times are delivered by the next frame, once the queries have finished.
+  renderer->SetFlag(Renderer::kProfileLabeledNodeGpuTime);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(8U, trace_verifier_->GetCountOf("QueryCounter"));
+  EXPECT_EQ(8U, trace_verifier_->GetCountOf("GenQueries"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetQueryObjectui64v"));
+  EXPECT_TRUE(delivered.empty());
+  EXPECT_EQ(0U, renderer->GetNodeGpuTimes().frame);
+
+  // The queries are reused once they have been read.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(8U, trace_verifier_->GetCountOf("QueryCounter"));
+  EXPECT_EQ(8U, trace_verifier_->GetCountOf("GetQueryObjectui64v"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenQueries"));
+  ASSERT_EQ(1U, delivered.size());
+  const Renderer::NodeGpuTimes& times = renderer->GetNodeGpuTimes();
+  EXPECT_EQ(1U, times.frame);
+  ASSERT_EQ(4U, times.scopes.size());
+  EXPECT_EQ("map", times.scopes[0].path);
+  EXPECT_EQ(0U, times.scopes[0].depth);
+  EXPECT_EQ("map/roads", times.scopes[1].path);
+  EXPECT_EQ(1U, times.scopes[1].depth);
+  EXPECT_EQ("map/overlay", times.scopes[2].path);
+  EXPECT_EQ(1U, times.scopes[2].depth);
+  EXPECT_EQ("map/overlay/roads", times.scopes[3].path);
+  EXPECT_EQ(2U, times.scopes[3].depth);
+  for (size_t i = 0; i < times.scopes.size(); ++i)
+    EXPECT_LE(times.scopes[i].begin_ns, times.scopes[i].end_ns);
+  EXPECT_EQ(4U, times.total_ns.size());
+  EXPECT_EQ(1U, times.total_ns.count("map/overlay/roads"));
+  EXPECT_EQ(1U, delivered[0].frame);
+  EXPECT_EQ(4U, delivered[0].scopes.size());
+
+  // Scenes drawn from a draw list are not measured.
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("QueryCounter"));
+  renderer->ClearFlag(Renderer::kSortDrawsByState);
+
+  // Nothing is measured without timer queries.
+  RendererPtr renderer2(new Renderer(gm_));
+  renderer2->SetFlag(Renderer::kProfileLabeledNodeGpuTime);
+  gm_->SetExtensionsString("");
+  Reset();
+  renderer2->DrawScene(root);
+  renderer2->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("QueryCounter"));
+  EXPECT_EQ(0U, renderer2->GetNodeGpuTimes().scopes.size());
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+}
+
+TEST_F(RendererTest, ProfileLabeledNodeCpuTime) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  root->SetLabel("map");
+  s_data.rect->SetLabel("roads");
+  NodePtr overlay(new Node);
+  overlay->SetLabel("overlay");
+  overlay->AddChild(s_data.rect);
+  root->AddChild(overlay);
+  // The overlay changes the state of each frame.
+  StateTablePtr overlay_state(new StateTable(kWidth, kHeight));
+  overlay_state->SetLineWidth(3.f);
+  overlay->SetStateTable(overlay_state);
+  std::vector<Renderer::NodeCpuTimes> delivered;
+  renderer->SetNodeCpuTimesCallback(
+      [&delivered](const Renderer::NodeCpuTimes& times) {
+        delivered.push_back(times);
+      });
+
+  // Nothing is measured by default.
+  renderer->DrawScene(root);
+  EXPECT_TRUE(delivered.empty());
+  EXPECT_EQ(0U, renderer->GetNodeCpuTimes().frame);
+
+  // The times are delivered as soon as the scene has been drawn. Resources
+  // are only created by the first frame that draws them.
+  renderer = new Renderer(gm_);
+  renderer->SetNodeCpuTimesCallback(
+      [&delivered](const Renderer::NodeCpuTimes& times) {
+        delivered.push_back(times);
+      });
+  renderer->SetFlag(Renderer::kProfileLabeledNodeCpuTime);
+  renderer->DrawScene(root);
+  ASSERT_EQ(1U, delivered.size());
+  {
+    const Renderer::NodeCpuTimes& times = renderer->GetNodeCpuTimes();
+    EXPECT_EQ(1U, times.frame);
+    ASSERT_EQ(4U, times.scopes.size());
+    EXPECT_EQ("map", times.scopes[0].path);
+    EXPECT_EQ(0U, times.scopes[0].depth);
+    EXPECT_EQ("map/roads", times.scopes[1].path);
+    EXPECT_EQ(1U, times.scopes[1].depth);
+    EXPECT_EQ("map/overlay", times.scopes[2].path);
+    EXPECT_EQ(1U, times.scopes[2].depth);
+    EXPECT_EQ("map/overlay/roads", times.scopes[3].path);
+    EXPECT_EQ(2U, times.scopes[3].depth);
+    for (size_t i = 0; i < times.scopes.size(); ++i)
+      EXPECT_LE(times.scopes[i].begin_ns, times.scopes[i].end_ns);
+    // A Node's counts include those of its labeled descendants.
+    const Renderer::NodeCpuTimes::Counts& map = times.scopes[0].counts;
+    const Renderer::NodeCpuTimes::Counts& roads = times.scopes[1].counts;
+    const Renderer::NodeCpuTimes::Counts& nested = times.scopes[3].counts;
+    EXPECT_EQ(1U, roads.draws);
+    EXPECT_EQ(1U, times.scopes[2].counts.draws);
+    EXPECT_EQ(1U, nested.draws);
+    EXPECT_LE(roads.draws + nested.draws, map.draws);
+    EXPECT_LT(0U, map.uniforms);
+    EXPECT_LT(0U, map.state_changes);
+    EXPECT_LT(0U, times.scopes[2].counts.state_changes);
+    EXPECT_LT(0U, map.resource_updates);
+    EXPECT_LT(0U, roads.resource_updates);
+    EXPECT_EQ(4U, times.total_ns.size());
+    EXPECT_EQ(4U, times.total_counts.size());
+    EXPECT_EQ(map.draws, times.total_counts.find("map")->second.draws);
+  }
+
+  renderer->DrawScene(root);
+  ASSERT_EQ(2U, delivered.size());
+  {
+    const Renderer::NodeCpuTimes& times = renderer->GetNodeCpuTimes();
+    EXPECT_EQ(2U, times.frame);
+    ASSERT_EQ(4U, times.scopes.size());
+    EXPECT_EQ(0U, times.scopes[0].counts.resource_updates);
+    EXPECT_EQ(1U, times.scopes[1].counts.draws);
+  }
+
+  // Scenes drawn from a draw list are not measured.
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, delivered.size());
+  EXPECT_EQ(2U, renderer->GetNodeCpuTimes().frame);
+  renderer->ClearFlag(Renderer::kSortDrawsByState);
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+}
+
+TEST_F(RendererTest, DeferredErrorChecking) {
+  base::LogChecker log_checker;
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  s_data.rect->SetLabel("map");
+  s_data.shape->SetLabel("roads");
+
+  // An error is reported at the end of the Shape whose draw found it.
+  renderer->DrawScene(root);
+  gm_->EnableDeferredErrorChecking(true, GraphicsManager::kCheckErrorsPerDraw);
+  gm_->SetErrorCode(GL_INVALID_OPERATION);
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "drawing Shape 'roads'"));
+
+  // Per Node, it is reported by the Node that drew the Shape.
+  gm_->EnableDeferredErrorChecking(true, GraphicsManager::kCheckErrorsPerNode);
+  gm_->SetErrorCode(GL_INVALID_OPERATION);
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "drawing Node 'map'"));
+
+  // Per frame, it is reported once the frame ends.
+  gm_->EnableDeferredErrorChecking(true, GraphicsManager::kCheckErrorsPerFrame);
+  gm_->SetErrorCode(GL_INVALID_OPERATION);
+  renderer->DrawScene(root);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "drawing frame: invalid"));
+  gm_->EnableDeferredErrorChecking(false,
+                                   GraphicsManager::kCheckErrorsPerFrame);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST_F(RendererTest, Queries) {
+  base::LogChecker log_checker;
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  // The mock platform is OpenGL ES 3.3 with timer queries.
+  EXPECT_TRUE(renderer->IsQuerySupported(Query::kAnySamplesPassed));
+  EXPECT_TRUE(
+      renderer->IsQuerySupported(Query::kAnySamplesPassedConservative));
+  EXPECT_FALSE(renderer->IsQuerySupported(Query::kSamplesPassed));
+  EXPECT_TRUE(renderer->IsQuerySupported(Query::kPrimitivesGenerated));
+  EXPECT_TRUE(renderer->IsQuerySupported(Query::kTimeElapsed));
+
+  // Results are delivered at the end of the next frame, or when processed.
+  QueryPtr primitives(new Query(Query::kPrimitivesGenerated));
+  QueryPtr time(new Query(Query::kTimeElapsed));
+  Reset();
+  renderer->BeginQuery(primitives);
+  renderer->BeginQuery(time);
+  EXPECT_TRUE(primitives->IsPending());
+  renderer->DrawScene(root);
+  renderer->DrawScene(root);
+  renderer->EndQuery(primitives);
+  renderer->EndQuery(time);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenQueries"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BeginQuery"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("EndQuery"));
+  EXPECT_TRUE(primitives->IsPending());
+  EXPECT_FALSE(primitives->HasResult());
+  renderer->ProcessQueries(false);
+  EXPECT_FALSE(primitives->IsPending());
+  EXPECT_TRUE(primitives->HasResult());
+  EXPECT_EQ(2U, primitives->GetResult());
+  EXPECT_EQ(1U, time->GetResult());
+
+  // Query objects are reused.
+  Reset();
+  renderer->BeginQuery(primitives);
+  renderer->EndQuery(primitives);
+  renderer->ProcessQueries(true);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenQueries"));
+  EXPECT_EQ(0U, primitives->GetResult());
+  EXPECT_EQ(2U, primitives->GetResultCount());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  renderer->BeginQuery(QueryPtr());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "NULL Query"));
+  renderer->EndQuery(primitives);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "not active"));
+  QueryPtr primitives2(new Query(Query::kPrimitivesGenerated));
+  primitives2->SetLabel("second");
+  renderer->BeginQuery(primitives);
+  renderer->BeginQuery(primitives2);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "same type is active"));
+  renderer->EndQuery(primitives);
+  renderer->BeginQuery(primitives);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "already pending"));
+  renderer->ProcessQueries(true);
+
+  // Queries need support for their type.
+  gm_->SetExtensionsString("");
+  renderer->BeginQuery(QueryPtr(new Query(Query::kTimeElapsed)));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "not supported"));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+}
+
+TEST_F(RendererTest, OcclusionQuery) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  NodePtr hidden(new Node);
+  NodePtr proxy(new Node);
+  proxy->AddShape(s_data.rect->GetShapes()[0]);
+  QueryPtr query(new Query(Query::kAnySamplesPassed));
+  hidden->SetOcclusionQuery(query, proxy);
+  EXPECT_EQ(query.Get(), hidden->GetOcclusionQuery().Get());
+  EXPECT_EQ(proxy.Get(), hidden->GetOcclusionProxy().Get());
+  root->AddChild(hidden);
+
+  // Nothing is drawn by the Node, so its proxy is drawn in the next frame.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BeginQuery"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+  EXPECT_TRUE(query->HasResult());
+  EXPECT_EQ(0U, query->GetResult());
+
+  // The proxy is visible, so the Node is drawn again in the next frame.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BeginQuery"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, query->GetResult());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(0U, query->GetResult());
+
+  // A Node without a proxy is always drawn.
+  QueryPtr rect_query(new Query(Query::kAnySamplesPassed));
+  s_data.rect->SetOcclusionQuery(rect_query, NodePtr());
+  hidden->SetOcclusionQuery(QueryPtr(), NodePtr());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, rect_query->GetResult());
+
+  // Nodes are not measured while a Query of the same type is active.
+  QueryPtr outer(new Query(Query::kAnySamplesPassed));
+  Reset();
+  renderer->BeginQuery(outer);
+  renderer->DrawScene(root);
+  renderer->EndQuery(outer);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BeginQuery"));
+  EXPECT_EQ(1U, rect_query->GetResultCount());
+
+  // Scenes drawn from a draw list are not measured.
+  renderer->SetFlag(Renderer::kSortDrawsByState);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BeginQuery"));
+  renderer->ClearFlag(Renderer::kSortDrawsByState);
+  s_data.rect->SetOcclusionQuery(QueryPtr(), NodePtr());
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+}
+
+TEST_F(RendererTest, PrepareResources) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  std::vector<Node*> prepared;
+  const Renderer::ResourcesPreparedCallback callback =
+      [&prepared](const NodePtr& node) { prepared.push_back(node.Get()); };
+  EXPECT_EQ(0U, renderer->GetResourcePreparationTimeBudget());
+  EXPECT_EQ(0U, renderer->GetResourcePreparationByteBudget());
+
+  // With a tiny byte budget, each call stops after the first upload.
+  renderer->SetResourcePreparationBudget(0U, 1U);
+  EXPECT_EQ(1U, renderer->GetResourcePreparationByteBudget());
+  renderer->PrepareResources(root, 0, callback);
+  EXPECT_EQ(1U, renderer->GetPendingResourcePreparationCount());
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData"));
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData"));
+  EXPECT_TRUE(prepared.empty());
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BufferData"));
+  ASSERT_EQ(1U, prepared.size());
+  EXPECT_EQ(root.Get(), prepared[0]);
+  EXPECT_EQ(0U, renderer->GetPendingResourcePreparationCount());
+
+  // Nothing is created again when the scene is drawn.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData"));
+
+  // Without budgets, scenes are prepared by priority in one call, which
+  // DrawScene() makes.
+  renderer->SetResourcePreparationBudget(0U, 0U);
+  NodePtr low(new Node);
+  NodePtr high(new Node);
+  NodePtr cancelled(new Node);
+  prepared.clear();
+  renderer->PrepareResources(low, 0, callback);
+  renderer->PrepareResources(cancelled, 2, callback);
+  renderer->PrepareResources(high, 1, callback);
+  renderer->PrepareResources(NodePtr(), 1, callback);
+  EXPECT_EQ(3U, renderer->GetPendingResourcePreparationCount());
+  renderer->CancelResourcePreparation(cancelled);
+  EXPECT_EQ(2U, renderer->GetPendingResourcePreparationCount());
+  renderer->DrawScene(root);
+  ASSERT_EQ(2U, prepared.size());
+  EXPECT_EQ(high.Get(), prepared[0]);
+  EXPECT_EQ(low.Get(), prepared[1]);
+  EXPECT_EQ(0U, renderer->GetPendingResourcePreparationCount());
+}
+
+TEST_F(RendererTest, AbandonAndRestoreResources) {
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  // A Node that is not visible, but comes first in the scene.
+  TexturePtr texture(new Texture);
+  texture->SetImage(0U, CreateNullImage(4U, 4U, Image::kRgba8888));
+  texture->SetSampler(SamplerPtr(new Sampler));
+  NodePtr hidden(new Node);
+  hidden->AddUniform(
+      s_data.shader->GetRegistry()->Create<Uniform>("uTexture", texture));
+  NodePtr scene(new Node);
+  scene->AddChild(hidden);
+  scene->AddChild(root);
+  renderer->DrawScene(scene);
+  EXPECT_TRUE(renderer->GetStateTable().IsEnabled(StateTable::kDepthTest));
+
+  // Nothing is deleted, and the Renderer assumes the default state.
+  Reset();
+  renderer->AbandonAllResources();
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Delete"));
+  EXPECT_EQ(0U, renderer->GetGpuMemoryUsage(Renderer::kTexture));
+  EXPECT_FALSE(renderer->GetStateTable().IsEnabled(StateTable::kDepthTest));
+
+  std::vector<Node*> prepared;
+  const Renderer::ResourcesPreparedCallback callback =
+      [&prepared](const NodePtr& node) { prepared.push_back(node.Get()); };
+  renderer->SetNodeVisibilityFunction(
+      [&hidden](const Node& node) { return &node != hidden.Get(); });
+  renderer->SetResourcePreparationBudget(0U, 1U);
+  renderer->RestoreResources(scene, 0, callback);
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+
+  // Abandoning resources again starts the restoration over.
+  renderer->AbandonAllResources();
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(6U, trace_verifier_->GetCountOf("TexImage2D"));
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("BufferData"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_TRUE(prepared.empty());
+
+  // The hidden Node's texture is restored last.
+  Reset();
+  renderer->ProcessResourcePreparation();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  ASSERT_EQ(1U, prepared.size());
+  EXPECT_EQ(scene.Get(), prepared[0]);
+  EXPECT_EQ(0U, renderer->GetPendingResourcePreparationCount());
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+}
+
+TEST_F(RendererTest, ConditionalRender) {
+  base::LogChecker log_checker;
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  QueryPtr query(new Query(Query::kAnySamplesPassed));
+
+  // A Query without a result never skips the draws.
+  Reset();
+  EXPECT_TRUE(renderer->BeginConditionalRender(query, false));
+  renderer->EndConditionalRender();
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ConditionalRender"));
+
+  // OpenGL decides while the result is pending. The query object is only
+  // reused once conditional rendering ends, even though the result is
+  // delivered by the DrawScene() in between.
+  renderer->BeginQuery(query);
+  renderer->DrawScene(root);
+  renderer->EndQuery(query);
+  Reset();
+  EXPECT_TRUE(renderer->BeginConditionalRender(query, true));
+  renderer->DrawScene(root);
+  renderer->EndConditionalRender();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BeginConditionalRender"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                0U, "BeginConditionalRender"))
+                  .HasArg(2, "GL_QUERY_WAIT"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("EndConditionalRender"));
+  EXPECT_EQ(1U, query->GetResult());
+  Reset();
+  renderer->BeginQuery(query);
+  renderer->EndQuery(query);
+  renderer->ProcessQueries(true);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenQueries"));
+
+  // A delivered result decides without OpenGL.
+  EXPECT_EQ(0U, query->GetResult());
+  Reset();
+  EXPECT_FALSE(renderer->BeginConditionalRender(query, false));
+  renderer->EndConditionalRender();
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ConditionalRender"));
+
+  // Without support the draws are always made.
+  gm_->EnableFunctionGroup(GraphicsManager::kConditionalRender, false);
+  renderer->BeginQuery(query);
+  renderer->EndQuery(query);
+  Reset();
+  EXPECT_TRUE(renderer->BeginConditionalRender(query, false));
+  renderer->EndConditionalRender();
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ConditionalRender"));
+  gm_->EnableFunctionGroup(GraphicsManager::kConditionalRender, true);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  EXPECT_TRUE(renderer->BeginConditionalRender(
+      QueryPtr(new Query(Query::kTimeElapsed)), false));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "counts samples"));
+  EXPECT_TRUE(renderer->BeginConditionalRender(query, false));
+  EXPECT_TRUE(renderer->BeginConditionalRender(query, false));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "already active"));
+  renderer->EndConditionalRender();
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+}
+
+TEST_F(RendererTest, IndirectDraws) {
+  base::LogChecker log_checker;
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(kWidth, kHeight);
+
+  // The commands would usually be written on the GPU.
+  const Shape::DrawElementsIndirectCommand commands[2] = {
+      {6U, 2U, 0U, 0, 0U}, {3U, 1U, 3U, 0, 0U}};
+  BufferObjectPtr buffer(new BufferObject);
+  buffer->SetData(base::DataContainer::CreateAndCopy(
+                      commands, 2U, false, base::AllocatorPtr()),
+                  sizeof(commands[0]), 2U, BufferObject::kStaticDraw);
+  s_data.shape->SetIndirectBuffer(buffer, sizeof(commands[0]));
+  EXPECT_EQ(buffer.Get(), s_data.shape->GetIndirectBuffer().Get());
+  EXPECT_EQ(sizeof(commands[0]), s_data.shape->GetIndirectOffset());
+
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_DRAW_INDIRECT"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElementsIndirect"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                0U, "DrawElementsIndirect"))
+                  .HasArg(3, "0x14"));
+
+  // The binding is cached.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBuffer(GL_DRAW_INDIRECT"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElementsIndirect"));
+
+  // Shapes without indices use DrawArraysIndirect().
+  s_data.shape->SetIndexBuffer(IndexBufferPtr());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArraysIndirect"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawArrays("));
+  s_data.shape->SetIndexBuffer(s_data.index_buffer);
+
+  // Without support the Shape is drawn normally.
+  gm_->EnableFunctionGroup(GraphicsManager::kDrawIndirect, false);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElementsIndirect"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements("));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Indirect drawing"));
+  s_data.shape->SetIndirectBuffer(BufferObjectPtr(), 0U);
+}
+
+TEST_F(RendererTest, MappedBuffer) {
+  base::LogChecker log_checker;
+  RendererPtr renderer(new Renderer(gm_));
+  // Ensure static data is available.
+  NodePtr root = BuildGraph(kWidth, kHeight);
+  Reset();
+
+  const BufferObject::MappedBufferData& mbd =
+      s_data.vertex_buffer->GetMappedData();
+  const Range1ui full_range(
+      0U, static_cast<uint32>(s_data.vertex_buffer->GetStructSize() *
+                              s_data.vertex_buffer->GetCount()));
+
+  // The buffer should not have any mapped data by default.
+  EXPECT_TRUE(mbd.range.IsEmpty());
+  EXPECT_TRUE(mbd.pointer == NULL);
+
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBuffer, false);
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, false);
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferRange, false);
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // The data should have been mapped with a client-side pointer.
+  EXPECT_EQ(full_range, mbd.range);
+  EXPECT_FALSE(mbd.pointer == NULL);
+
+  // Trying to map again should log a warning.
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
+  EXPECT_TRUE(log_checker.HasMessage(
+      "WARNING", "buffer that is already mapped was passed"));
+
+  // Unmapping the buffer should free the pointer.
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_TRUE(mbd.range.IsEmpty());
+  EXPECT_TRUE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Unmapping again should log a warning.
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_TRUE(
+      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBuffer"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UnmapBuffer"));
+
+  // Now use the GL functions.
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBuffer, true);
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, true);
+
+  // Simulate a failed GL call.
+  gm_->SetForceFunctionFailure("MapBuffer", true);
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
+  gm_->SetErrorCode(GL_NO_ERROR);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Failed to allocate data for"));
+  gm_->SetForceFunctionFailure("MapBuffer", false);
+
+  Reset();
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
+          .HasArg(2, "GL_WRITE_ONLY"));
+
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
+  EXPECT_TRUE(log_checker.HasMessage(
+      "WARNING", "buffer that is already mapped was passed"));
+
+  // Check that the mapped data changed.
+  EXPECT_EQ(full_range, mbd.range);
+  EXPECT_FALSE(mbd.pointer == NULL);
+  EXPECT_TRUE(mbd.gpu_mapped);
+
+  Reset();
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  EXPECT_TRUE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_TRUE(
+      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
+  // An additional call should not have been made.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+
+  // Map using different access modes.
+  Reset();
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kReadOnly);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
+          .HasArg(2, "GL_READ_ONLY"));
+  EXPECT_TRUE(mbd.gpu_mapped);
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_FALSE(mbd.gpu_mapped);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  Reset();
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kReadWrite);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
+  EXPECT_TRUE(mbd.gpu_mapped);
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
+          .HasArg(2, "GL_READ_WRITE"));
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_FALSE(mbd.gpu_mapped);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+
+  // Check that when the range is the entire buffer and MapBufferRange() is not
+  // supported that we fall back to MapBuffer().
+  Reset();
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, full_range);
+  // Despite the call to MapBufferObjectDataRange(), MapBuffer() should have
+  // been called.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
+          .HasArg(2, "GL_WRITE_ONLY"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_TRUE(mbd.gpu_mapped);
+
+  // The entire buffer should be mapped.
+  EXPECT_EQ(full_range, mbd.range);
+  EXPECT_FALSE(mbd.pointer == NULL);
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Check that platforms that do not support MapBufferRange() fall back to
+  // a client-side pointer.
+  Range1ui range(4U, 8U);
+  Reset();
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, range);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBuffer"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // The range should be mapped.
+  EXPECT_EQ(range, mbd.range);
+  EXPECT_FALSE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  EXPECT_TRUE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Map a range of data using a client side pointer.
+  Reset();
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBuffer, false);
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, false);
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferRange, false);
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Ignoring empty range"));
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, range);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  // Check that the mapped data changed.
+  EXPECT_EQ(range, mbd.range);
+  EXPECT_FALSE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Trying to map again should log a warning.
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
+  EXPECT_TRUE(log_checker.HasMessage(
+      "WARNING", "buffer that is already mapped was passed"));
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Unmapping the buffer should free the pointer.
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_TRUE(mbd.range.IsEmpty());
+  EXPECT_TRUE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_TRUE(
+      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UnmapBuffer"));
+
+  // Now use the GL function.
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferRange, true);
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, true);
+
+  // Simulate a failed GL call.
+  gm_->SetForceFunctionFailure("MapBufferRange", true);
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, range);
+  gm_->SetErrorCode(GL_NO_ERROR);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Failed to allocate data for"));
+  gm_->SetForceFunctionFailure("MapBufferRange", false);
+
+  Reset();
+  // An empty range should only log a warning message.
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Ignoring empty range"));
+  EXPECT_TRUE(mbd.range.IsEmpty());
+  EXPECT_TRUE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Try a range that is too large.
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui(0, 16384U));
+  gm_->SetErrorCode(GL_NO_ERROR);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Failed to allocate data for"));
+  EXPECT_TRUE(mbd.range.IsEmpty());
+  EXPECT_TRUE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  Reset();
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, range);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_TRUE(mbd.gpu_mapped);
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
+          .HasArg(4, "GL_MAP_WRITE_BIT"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Check that the mapped data changed.
+  Reset();
+  EXPECT_EQ(range, mbd.range);
+  EXPECT_FALSE(mbd.pointer == NULL);
+
+  // Try again to get a warning.
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
+  EXPECT_TRUE(log_checker.HasMessage(
+      "WARNING", "buffer that is already mapped was passed"));
+  EXPECT_TRUE(mbd.gpu_mapped);
+
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  EXPECT_TRUE(mbd.range.IsEmpty());
+  EXPECT_TRUE(mbd.pointer == NULL);
+  EXPECT_FALSE(mbd.gpu_mapped);
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  // An additional call should not have been made.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  EXPECT_TRUE(
+      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Map using different access modes.
+  Reset();
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kReadOnly, range);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_TRUE(mbd.gpu_mapped);
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
+          .HasArg(4, "GL_MAP_READ_BIT"));
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  EXPECT_FALSE(mbd.gpu_mapped);
+  Reset();
+  renderer->MapBufferObjectDataRange(
+      s_data.vertex_buffer, Renderer::kReadWrite, range);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_TRUE(mbd.gpu_mapped);
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
+          .HasArg(4, "GL_MAP_READ_BIT | GL_MAP_WRITE_BIT"));
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  EXPECT_FALSE(mbd.gpu_mapped);
+
+  // Reset data.
+  s_data.rect = NULL;
+  s_data.vertex_container = NULL;
+  BuildRectangle();
+}
+
+TEST_F(RendererTest, Flags) {
+  // Test that flags can be set properly.
+  RendererPtr renderer(new Renderer(gm_));
+  // By default all process flags are set.
+  Renderer::Flags flags = Renderer::AllProcessFlags();
+  EXPECT_EQ(flags, renderer->GetFlags());
+
+  flags.reset(Renderer::kProcessReleases);
+  renderer->ClearFlag(Renderer::kProcessReleases);
+  EXPECT_EQ(flags, renderer->GetFlags());
+
+  flags.set(Renderer::kRestoreShaderProgram);
+  renderer->SetFlag(Renderer::kRestoreShaderProgram);
+  EXPECT_EQ(flags, renderer->GetFlags());
+
+  flags.set(Renderer::kProcessInfoRequests);
+  renderer->SetFlag(Renderer::kProcessInfoRequests);
+  EXPECT_EQ(flags, renderer->GetFlags());
+
+  flags.reset(Renderer::kProcessInfoRequests);
+  renderer->ClearFlag(Renderer::kProcessInfoRequests);
+  EXPECT_EQ(flags, renderer->GetFlags());
+
+  // Setting no flags should do nothing.
+  renderer->ClearFlags(Renderer::AllFlags());
+  renderer->SetFlags(Renderer::Flags());
+  EXPECT_EQ(0U, renderer->GetFlags().count());
+
+  // Multiple flags.
+  flags.reset();
+  flags.set(Renderer::kProcessInfoRequests);
+  flags.set(Renderer::kProcessReleases);
+  flags.set(Renderer::kRestoreShaderProgram);
+  flags.set(Renderer::kRestoreVertexArray);
+  renderer->SetFlags(flags);
+  EXPECT_EQ(4U, flags.count());
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+
+  // Clearing no flags should do nothing.
+  flags.reset();
+  renderer->ClearFlags(flags);
+  EXPECT_EQ(4U, renderer->GetFlags().count());
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+
+  // Setting no flags should do nothing.
+  flags.reset();
+  renderer->SetFlags(flags);
+  EXPECT_EQ(4U, renderer->GetFlags().count());
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+
+  // Try to reset some unset flags.
+  flags.reset();
+  renderer->ClearFlags(flags);
+  EXPECT_EQ(4U, renderer->GetFlags().count());
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+
+  // Nothing should have changed.
+  renderer->ClearFlags(flags);
+  EXPECT_EQ(4U, renderer->GetFlags().count());
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+
+  // Reset some set flags.
+  flags.reset();
+  flags.set(Renderer::kProcessReleases);
+  flags.set(Renderer::kRestoreShaderProgram);
+  renderer->ClearFlags(flags);
+  EXPECT_EQ(2U, renderer->GetFlags().count());
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
+  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+}
+
+TEST_F(RendererTest, FlagsBehavior) {
+  // Test the behavior of the Renderer when different flags are set.
+
+  // Test kProcessInfoRequests.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    ResourceManager* manager = renderer->GetResourceManager();
+    CallbackHelper<ResourceManager::PlatformInfo> callback;
+
+    manager->RequestPlatformInfo(
+        std::bind(&CallbackHelper<ResourceManager::PlatformInfo>::Callback,
+                  &callback, std::placeholders::_1));
+
+    renderer->ClearFlag(Renderer::kProcessInfoRequests);
+    renderer->DrawScene(NodePtr());
+    EXPECT_FALSE(callback.was_called);
+
+    renderer->SetFlag(Renderer::kProcessInfoRequests);
+    renderer->DrawScene(NodePtr());
+    EXPECT_TRUE(callback.was_called);
+
+    // It is possible that in our test platform, we cannot grab some of the
+    // capabilities and it will generate an error.
+    gm_->SetErrorCode(GL_NO_ERROR);
+  }
+
+  // Test kProcessReleases.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    NodePtr root = BuildGraph(800, 800);
+    // Drawing will create resources.
+    renderer->DrawScene(root);
+    Reset();
+    // These will trigger resources to be released.
+    s_data.attribute_array = NULL;
+    s_data.vertex_buffer = NULL;
+    s_data.index_buffer = NULL;
+    s_data.shader = NULL;
+    s_data.shape = NULL;
+    s_data.rect = NULL;
+    root->ClearChildren();
+    root->SetShaderProgram(ShaderProgramPtr(NULL));
+    // Tell the renderer not to process releases.
+    renderer->ClearFlag(Renderer::kProcessReleases);
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
+
+    // Tell the renderer to process releases.
+    renderer->SetFlag(Renderer::kProcessReleases);
+    Reset();
+    renderer->DrawScene(root);
+    // Most objects will be destroyed since the resources go away.
+    std::vector<std::string> call_strings;
+    call_strings.push_back("Clear");
+    call_strings.push_back("DeleteBuffers");
+    call_strings.push_back("DeleteBuffers");
+    call_strings.push_back("DeleteProgram");
+    call_strings.push_back("DeleteShader");
+    call_strings.push_back("DeleteShader");
+    call_strings.push_back("DeleteVertexArrays");
+    EXPECT_TRUE(trace_verifier_->VerifySortedCalls(call_strings));
+
+    // Reset data.
+    s_data.rect = NULL;
+    BuildRectangle();
+  }
+
+  // Test k(Restore|Save)*.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    EXPECT_TRUE(VerifySaveAndRestoreFlag(
+        gm_, renderer, trace_verifier_, Renderer::kSaveActiveTexture,
+        Renderer::kRestoreActiveTexture, "GetIntegerv(GL_ACTIVE_TEXTURE",
+        "ActiveTexture"));
+  }
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    EXPECT_TRUE(VerifySaveAndRestoreFlag(
+        gm_, renderer, trace_verifier_, Renderer::kSaveArrayBuffer,
+        Renderer::kRestoreArrayBuffer, "GetIntegerv(GL_ARRAY_BUFFER_BINDING",
+        "BindBuffer(GL_ARRAY_BUFFER"));
+  }
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    EXPECT_TRUE(VerifySaveAndRestoreFlag(
+        gm_, renderer, trace_verifier_, Renderer::kSaveElementArrayBuffer,
+        Renderer::kRestoreElementArrayBuffer,
+        "GetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING",
+        "BindBuffer(GL_ELEMENT_ARRAY_BUFFER"));
+  }
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    FramebufferObjectPtr fbo(new FramebufferObject(
+        128, 128));
+    fbo->SetColorAttachment(0U,
+                            FramebufferObject::Attachment(Image::kRgba4Byte));
+    renderer->BindFramebuffer(fbo);
+    EXPECT_TRUE(VerifySaveAndRestoreFlag(
+        gm_, renderer, trace_verifier_, Renderer::kSaveFramebuffer,
+        Renderer::kRestoreFramebuffer, "GetIntegerv(GL_FRAMEBUFFER_BINDING",
+        "BindFramebuffer"));
+    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+  }
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    EXPECT_TRUE(VerifySaveAndRestoreFlag(
+        gm_, renderer, trace_verifier_, Renderer::kSaveShaderProgram,
+        Renderer::kRestoreShaderProgram, "GetIntegerv(GL_CURRENT_PROGRAM",
+        "UseProgram"));
+  }
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    EXPECT_TRUE(VerifySaveAndRestoreFlag(
+        gm_, renderer, trace_verifier_, Renderer::kSaveVertexArray,
+        Renderer::kRestoreVertexArray, "GetIntegerv(GL_VERTEX_ARRAY_BINDING",
+        "BindVertexArray"));
+  }
+  {
+    // Saving and restoring StateTables is a little more complicated.
+    RendererPtr renderer(new Renderer(gm_));
+
+    renderer->ClearFlag(Renderer::kRestoreStateTable);
+    renderer->SetFlag(Renderer::kSaveStateTable);
+    Reset();
+    renderer->DrawScene(NodePtr());
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsEnabled(GL_DEPTH_TEST"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsEnabled(GL_BLEND"));
+    renderer->ClearFlag(Renderer::kSaveStateTable);
+
+    // Now change a bunch of state.
+    Reset();
+    NodePtr root = BuildGraph(800, 800);
+    root->GetStateTable()->Enable(StateTable::kDepthTest, false);
+    root->GetStateTable()->Enable(StateTable::kBlend, true);
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
+
+    // Drawing again with no flags set should do nothing.
+    Reset();
+    renderer->DrawScene(NodePtr());
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable"));
+
+    Reset();
+    renderer->SetFlag(Renderer::kRestoreStateTable);
+    renderer->DrawScene(NodePtr());
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_BLEND"));
+  }
+
+  // Test all save/restore flags simultaneously.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    EXPECT_TRUE(VerifyAllSaveAndRestoreFlags(gm_, renderer));
+  }
 
-  image = renderer->ReadImage(
-      Range2i::BuildWithSize(Point2i(0, 0), Vector2i(50U, 80U)),
-      Image::kRgb565, al);
-  EXPECT_TRUE(image->GetData()->GetData() != NULL);
-  EXPECT_EQ(Image::kRgb565, image->GetFormat());
-  EXPECT_EQ(50U, image->GetWidth());
-  EXPECT_EQ(80U, image->GetHeight());
+  // Test kClear*.
+  {
+    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearActiveTexture,
+                                GL_ACTIVE_TEXTURE, GL_TEXTURE0));
+    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearArrayBuffer,
+                                GL_ARRAY_BUFFER_BINDING, 0));
+    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearElementArrayBuffer,
+                                GL_ELEMENT_ARRAY_BUFFER_BINDING, 0));
+    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearFramebuffer,
+                                GL_FRAMEBUFFER_BINDING, 0));
+    EXPECT_TRUE(VerifyClearImageUnitFlag(gm_, Renderer::kClearSamplers,
+                                         GL_SAMPLER_BINDING, 0));
+    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearShaderProgram,
+                                GL_CURRENT_PROGRAM, 0));
+    EXPECT_TRUE(VerifyClearImageUnitFlag(gm_, Renderer::kClearCubemaps,
+                                         GL_TEXTURE_BINDING_CUBE_MAP, 0));
+    EXPECT_TRUE(VerifyClearImageUnitFlag(gm_, Renderer::kClearTextures,
+                                         GL_TEXTURE_BINDING_2D, 0));
+    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearVertexArray,
+                                GL_VERTEX_ARRAY_BINDING, 0));
 
-  image = renderer->ReadImage(
-      Range2i::BuildWithSize(Point2i(20, 10), Vector2i(50U, 80U)),
-      Image::kRgba8888, al);
-  EXPECT_TRUE(image->GetData()->GetData() != NULL);
-  EXPECT_EQ(Image::kRgba8888, image->GetFormat());
-  EXPECT_EQ(50U, image->GetWidth());
-  EXPECT_EQ(80U, image->GetHeight());
+    // Check some corner cases. First, clearing the framebuffer should also
+    // clear the cached FramebufferPtr.
+    {
+      NodePtr root = BuildGraph(800, 800);
+      RendererPtr renderer(new Renderer(gm_));
+      FramebufferObjectPtr fbo(new FramebufferObject(
+          128, 128));
+      fbo->SetColorAttachment(0U,
+                              FramebufferObject::Attachment(Image::kRgba4Byte));
+      renderer->BindFramebuffer(fbo);
 
-  FramebufferObjectPtr fbo(new FramebufferObject(128, 128));
-  fbo->SetColorAttachment(0U, FramebufferObject::Attachment(Image::kRgba4Byte));
-  renderer->BindFramebuffer(fbo);
-  image = renderer->ReadImage(
-      Range2i::BuildWithSize(Point2i(0, 0), Vector2i(128U, 128U)),
-      Image::kRgb888, al);
-  EXPECT_TRUE(image->GetData()->GetData() != NULL);
-  EXPECT_EQ(Image::kRgb888, image->GetFormat());
-  EXPECT_EQ(128U, image->GetWidth());
-  EXPECT_EQ(128U, image->GetHeight());
-  renderer->BindFramebuffer(FramebufferObjectPtr());
+      renderer->SetFlag(Renderer::kClearFramebuffer);
+      renderer->DrawScene(root);
+      // The framebuffer should have been cleared.
+      EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
+    }
 
-  image = renderer->ReadImage(
-      Range2i::BuildWithSize(Point2i(20, 10), Vector2i(50U, 80U)),
-      Image::kRgba8888, al);
-  EXPECT_TRUE(image->GetData()->GetData() != NULL);
-  EXPECT_EQ(Image::kRgba8888, image->GetFormat());
-  EXPECT_EQ(50U, image->GetWidth());
-  EXPECT_EQ(80U, image->GetHeight());
+    // Restoring a program binding should override clearing it.
+    {
+      NodePtr root = BuildGraph(800, 800);
+      RendererPtr renderer(new Renderer(gm_));
+      renderer->DrawScene(root);
+      Reset();
+      renderer->SetFlag(Renderer::kClearShaderProgram);
+      renderer->SetFlag(Renderer::kRestoreShaderProgram);
+      renderer->SetFlag(Renderer::kSaveShaderProgram);
+      renderer->DrawScene(root);
+      EXPECT_EQ(0U, trace_verifier_->GetCountOf("UseProgram(0x0)"));
+    }
+
+    // Restoring a VAO binding should override clearing it.
+    {
+      NodePtr root = BuildGraph(800, 800);
+      RendererPtr renderer(new Renderer(gm_));
+      renderer->DrawScene(root);
+      Reset();
+      renderer->SetFlag(Renderer::kClearVertexArray);
+      renderer->SetFlag(Renderer::kRestoreVertexArray);
+      renderer->SetFlag(Renderer::kSaveVertexArray);
+      renderer->DrawScene(NodePtr());
+      EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindVertexArray(0x0)"));
+    }
+  }
 }
 
-TEST_F(RendererTest, MappedBuffer) {
+TEST_F(RendererTest, RestoreChangedState) {
   base::LogChecker log_checker;
   RendererPtr renderer(new Renderer(gm_));
-  // Ensure static data is available.
-  NodePtr root = BuildGraph(kWidth, kHeight);
-  Reset();
+  NodePtr root = BuildGraph(800, 800);
+  root->GetStateTable()->Enable(StateTable::kBlend, true);
+  // Create all resources first.
+  renderer->DrawScene(root);
 
-  const BufferObject::MappedBufferData& mbd =
-      s_data.vertex_buffer->GetMappedData();
-  const Range1ui full_range(
-      0U, static_cast<uint32>(s_data.vertex_buffer->GetStructSize() *
-                              s_data.vertex_buffer->GetCount()));
+  // Only the state changed by the scene is restored, without any queries.
+  renderer->SetFlag(Renderer::kRestoreChangedState);
+  Reset();
+  renderer->DrawScene(NodePtr());
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetIntegerv"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("IsEnabled"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UseProgram"));
 
-  // The buffer should not have any mapped data by default.
-  EXPECT_TRUE(mbd.range.IsEmpty());
-  EXPECT_TRUE(mbd.pointer == NULL);
+  // The Renderer believes blending is still enabled, so the prior state has
+  // it enabled.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetIntegerv"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("IsEnabled"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_BLEND"));
 
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBuffer, false);
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, false);
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferRange, false);
-  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
+  // Tell the Renderer what the host's state is. Blending is disabled and no
+  // program is used.
+  Renderer::HostState host;
+  host.state_table = new StateTable();
+  host.state_table->Enable(StateTable::kBlend, false);
+  host.state_table->Enable(StateTable::kDepthTest, true);
+  renderer->SetHostState(host);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetIntegerv"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("IsEnabled"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_BLEND"));
+  // The depth test is not changed by the scene, so it is not restored.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UseProgram"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(1U, "UseProgram")).HasArg(1, "0x0"));
+  GLint program = -1;
+  gm_->GetIntegerv(GL_CURRENT_PROGRAM, &program);
+  EXPECT_EQ(0, program);
+  GLboolean blend = GL_TRUE;
+  gm_->GetBooleanv(GL_BLEND, &blend);
+  EXPECT_EQ(GL_FALSE, blend);
   EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  // The data should have been mapped with a client-side pointer.
-  EXPECT_EQ(full_range, mbd.range);
-  EXPECT_FALSE(mbd.pointer == NULL);
+TEST_F(RendererTest, InitialUniformValue) {
+  // Check that it is possible to set initial Uniform values.
+  NodePtr node(new Node);
+  BuildRectangleShape<uint16>();
+  node->AddShape(s_data.shape);
 
-  // Trying to map again should log a warning.
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
-  EXPECT_TRUE(log_checker.HasMessage(
-      "WARNING", "buffer that is already mapped was passed"));
+  const math::Matrix4f mat1(1.f, 2.f, 3.f, 4.f,
+                           5.f, 6.f, 7.f, 8.f,
+                           9.f, 1.f, 2.f, 3.f,
+                           4.f, 5.f, 6.f, 7.f);
+  const math::Matrix4f mat2(1.f, 2.f, 3.f, 4.f,
+                           9.f, 1.f, 2.f, 3.f,
+                           5.f, 6.f, 7.f, 8.f,
+                           4.f, 5.f, 6.f, 7.f);
+  const math::Vector4f vec(1.f, 2.f, 3.f, 4.f);
 
-  // Unmapping the buffer should free the pointer.
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_TRUE(mbd.range.IsEmpty());
-  EXPECT_TRUE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
 
-  // Unmapping again should log a warning.
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_TRUE(
-      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBuffer"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  RendererPtr renderer(new Renderer(gm_));
 
-  // Now use the GL functions.
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBuffer, true);
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, true);
+  // Create some uniform values.
+  const ShaderInputRegistryPtr& reg = ShaderInputRegistry::GetGlobalRegistry();
+  const Uniform modelview_matrix =
+      reg->Create<Uniform>("uModelviewMatrix", mat1);
+  const Uniform projection_matrix =
+      reg->Create<Uniform>("uProjectionMatrix", mat2);
+  const Uniform color = reg->Create<Uniform>("uBaseColor", vec);
 
-  // Simulate a failed GL call.
-  gm_->SetForceFunctionFailure("MapBuffer", true);
-  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
-  gm_->SetErrorCode(GL_NO_ERROR);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Failed to allocate data for"));
-  gm_->SetForceFunctionFailure("MapBuffer", false);
+  renderer->SetInitialUniformValue(modelview_matrix);
+  renderer->SetInitialUniformValue(projection_matrix);
+  renderer->SetInitialUniformValue(color);
+
+  // Check that the values were set correctly.
+  ResourceManager* manager = renderer->GetResourceManager();
+  CallbackHelper<ResourceManager::ProgramInfo> callback;
+  manager->RequestAllResourceInfos<ShaderProgram, ResourceManager::ProgramInfo>(
+      std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
+                &callback, std::placeholders::_1));
+  renderer->DrawScene(node);
+  EXPECT_TRUE(callback.was_called);
+  EXPECT_EQ(1U, callback.infos.size());
+  EXPECT_EQ(3U, callback.infos[0].uniforms.size());
+  EXPECT_EQ("uProjectionMatrix", callback.infos[0].uniforms[0].name);
+  EXPECT_EQ(static_cast<GLuint>(GL_FLOAT_MAT4),
+            callback.infos[0].uniforms[0].type);
+  EXPECT_EQ(mat2, callback.infos[0].uniforms[0].value.Get<math::Matrix4f>());
+
+
+  EXPECT_EQ("uModelviewMatrix", callback.infos[0].uniforms[1].name);
+  EXPECT_EQ(static_cast<GLuint>(GL_FLOAT_MAT4),
+            callback.infos[0].uniforms[1].type);
+  EXPECT_EQ(mat1, callback.infos[0].uniforms[1].value.Get<math::Matrix4f>());
+
+  EXPECT_EQ("uBaseColor", callback.infos[0].uniforms[2].name);
+  EXPECT_EQ(static_cast<GLuint>(GL_FLOAT_VEC4),
+            callback.infos[0].uniforms[2].type);
+  EXPECT_TRUE(math::VectorBase4f::AreValuesEqual(
+      vec, callback.infos[0].uniforms[2].value.Get<math::VectorBase4f>()));
+}
 
+TEST_F(RendererTest, CombinedUniformsSent) {
+  // Check that combined uniforms that change are sent.
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root = BuildGraph(800, 800);
+  const ShaderInputRegistryPtr& global_reg =
+        ShaderInputRegistry::GetGlobalRegistry();
+  root->AddUniform(global_reg->Create<Uniform>("uModelviewMatrix",
+      math::TranslationMatrix(math::Vector3f(0.5f, 0.5f, 0.5f))));
   Reset();
-  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
-          .HasArg(2, "GL_WRITE_ONLY"));
+  renderer->DrawScene(root);
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+  Reset();
+  renderer->DrawScene(root);
+  // Combined uModelviewMatrix generates a new stamp, but it is not sent since
+  // its value has not changed.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+  s_data.rect->SetUniformValue(
+      s_data.rect->GetUniformIndex("uModelviewMatrix"),
+      math::TranslationMatrix(math::Vector3f(-0.5f, 0.5f, 0.0f)));
+  Reset();
+  renderer->DrawScene(root);
+  // The combined uniform is different, so it should have been sent.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+}
 
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
-  EXPECT_TRUE(log_checker.HasMessage(
-      "WARNING", "buffer that is already mapped was passed"));
+TEST_F(RendererTest, OnlyChangedUniformValuesSent) {
+  base::LogChecker log_checker;
+
+  static const char* kVertexShaderString =
+      "uniform mat4 uBones[8];\n"
+      "uniform vec4 uColors[4];\n"
+      "uniform float uScale;\n"
+      "attribute vec3 attribute;\n";
+  static const char* kFragmentShaderString = "void main() {}\n";
+
+  BuildRectangleBufferObject();
+
+  NodePtr root(new Node);
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  AttributeArrayPtr aa(new AttributeArray);
+  aa->AddAttribute(reg->Create<Attribute>(
+      "attribute", BufferObjectElement(
+          s_data.vertex_buffer, s_data.vertex_buffer->AddSpec(
+              BufferObject::kFloat, 3, 0))));
+  ShapePtr shape(new Shape);
+  shape->SetAttributeArray(aa);
+  root->SetShaderProgram(ShaderProgram::BuildFromStrings(
+      "Shader", reg, kVertexShaderString, kFragmentShaderString,
+      base::AllocatorPtr()));
+  root->AddShape(shape);
 
-  // Check that the mapped data changed.
-  EXPECT_EQ(full_range, mbd.range);
-  EXPECT_FALSE(mbd.pointer == NULL);
-  EXPECT_TRUE(mbd.gpu_mapped);
+  const std::vector<math::Matrix4f> bones(8U, math::Matrix4f::Identity());
+  const std::vector<math::Vector4f> colors(4U, math::Vector4f::Zero());
+  const size_t bones_index =
+      root->AddUniform(CreateArrayUniform(reg, "uBones", bones));
+  const size_t colors_index =
+      root->AddUniform(CreateArrayUniform(reg, "uColors", colors));
+  const size_t scale_index =
+      root->AddUniform(reg->Create<Uniform>("uScale", 1.f));
 
+  RendererPtr renderer(new Renderer(gm_));
   Reset();
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
-  EXPECT_TRUE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_TRUE(
-      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
-  // An additional call should not have been made.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  renderer->DrawScene(root);
+  EXPECT_EQ(8U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform4fv"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1fv"));
+  EXPECT_EQ(13U, renderer->GetSentUniformCount());
+  EXPECT_EQ(0U, renderer->GetSkippedUniformCount());
 
-  // Map using different access modes.
+  // Nothing is sent if nothing changes.
+  renderer->ResetUniformCounts();
+  EXPECT_EQ(0U, renderer->GetSentUniformCount());
   Reset();
-  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kReadOnly);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
-          .HasArg(2, "GL_READ_ONLY"));
-  EXPECT_TRUE(mbd.gpu_mapped);
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_FALSE(mbd.gpu_mapped);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform"));
+  EXPECT_EQ(0U, renderer->GetSentUniformCount());
+  EXPECT_EQ(13U, renderer->GetSkippedUniformCount());
+
+  // Only the changed elements of arrays are sent, and values that are set to
+  // the same value are not sent.
+  renderer->ResetUniformCounts();
+  EXPECT_TRUE(root->SetUniformValueAt(
+      bones_index, 3U,
+      math::TranslationMatrix(math::Vector3f(1.f, 2.f, 3.f))));
+  EXPECT_TRUE(root->SetUniformValueAt(colors_index, 1U,
+                                      math::Vector4f(1.f, 0.f, 0.f, 1.f)));
+  EXPECT_TRUE(root->SetUniformValueAt(colors_index, 2U,
+                                      math::Vector4f(0.f, 1.f, 0.f, 1.f)));
+  EXPECT_TRUE(root->SetUniformValue(scale_index, 1.f));
   Reset();
-  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kReadWrite);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
-  EXPECT_TRUE(mbd.gpu_mapped);
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
   EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
-          .HasArg(2, "GL_READ_WRITE"));
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_FALSE(mbd.gpu_mapped);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
-
-  // Check that when the range is the entire buffer and MapBufferRange() is not
-  // supported that we fall back to MapBuffer().
-  Reset();
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, full_range);
-  // Despite the call to MapBufferObjectDataRange(), MapBuffer() should have
-  // been called.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBuffer"));
+      trace_verifier_->GetNthIndexOf(0U, "UniformMatrix4fv"))
+                  .HasArg(1, "3"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform4fv"));
   EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
-          .HasArg(2, "GL_WRITE_ONLY"));
+      trace_verifier_->GetNthIndexOf(0U, "Uniform4fv"))
+                  .HasArg(1, "9")
+                  .HasArg(2, "2"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform1fv"));
+  EXPECT_EQ(3U, renderer->GetSentUniformCount());
+  EXPECT_EQ(10U, renderer->GetSkippedUniformCount());
   EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_TRUE(mbd.gpu_mapped);
+}
 
-  // The entire buffer should be mapped.
-  EXPECT_EQ(full_range, mbd.range);
-  EXPECT_FALSE(mbd.pointer == NULL);
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
-  EXPECT_FALSE(mbd.gpu_mapped);
+TEST_F(RendererTest, GeneratedUniformsSent) {
+  // Check that generated uniforms are properly created and sent.
+  TracingHelper helper;
 
-  // Check that platforms that do not support MapBufferRange() fall back to
-  // a client-side pointer.
-  Range1ui range(4U, 8U);
-  Reset();
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, range);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBuffer"));
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  EXPECT_FALSE(mbd.gpu_mapped);
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(ShaderInputRegistry::UniformSpec(
+      "uTranslationMatrix", kMatrix4x4Uniform, "", CombineMatrices,
+      ExtractTranslation));
+  // Add the spec for the generated uniform.
+  reg->Add(ShaderInputRegistry::UniformSpec("uTranslationX", kFloatUniform));
+  reg->Add(ShaderInputRegistry::UniformSpec("uTranslationY", kFloatUniform));
+  reg->Add(ShaderInputRegistry::UniformSpec("uTranslationZ", kFloatUniform));
+  BuildGraph(800, 800);
 
-  // The range should be mapped.
-  EXPECT_EQ(range, mbd.range);
-  EXPECT_FALSE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UnmapBuffer"));
-  EXPECT_TRUE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
+  static const char* kVertexShaderString =
+      "attribute vec3 aVertex;\n"
+      "attribute vec2 aTexCoords;\n"
+      "uniform mat4 uTranslationMatrix;\n";
 
-  // Map a range of data using a client side pointer.
-  Reset();
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBuffer, false);
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, false);
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferRange, false);
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Ignoring empty range"));
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, range);
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  // Check that the mapped data changed.
-  EXPECT_EQ(range, mbd.range);
-  EXPECT_FALSE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
+  static const char* kFragmentShaderString =
+      "uniform float uTranslationX;\n"
+      "uniform float uTranslationY;\n"
+      "uniform float uTranslationZ;\n";
 
-  // Trying to map again should log a warning.
-  EXPECT_FALSE(log_checker.HasAnyMessages());
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
-  EXPECT_TRUE(log_checker.HasMessage(
-      "WARNING", "buffer that is already mapped was passed"));
-  EXPECT_FALSE(mbd.gpu_mapped);
+  ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
+      "Shader", reg, kVertexShaderString, kFragmentShaderString,
+      base::AllocatorPtr());
+  s_data.shape->SetAttributeArray(s_data.attribute_array);
+  s_data.rect->SetShaderProgram(s_data.shader);
+  s_data.rect->ClearUniforms();
+  s_data.rect->AddUniform(
+      reg->Create<Uniform>("uniform1", math::Vector3f::Zero()));
+  s_data.rect->AddUniform(
+          reg->Create<Uniform>("uniform2", math::Vector3f::Zero()));
 
-  // Unmapping the buffer should free the pointer.
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_TRUE(mbd.range.IsEmpty());
-  EXPECT_TRUE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_TRUE(
-      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBufferRange"));
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UnmapBuffer"));
+  RendererPtr renderer(new Renderer(gm_));
+  NodePtr root(new Node);
+  root->AddUniform(reg->Create<Uniform>("uTranslationMatrix",
+      math::TranslationMatrix(math::Vector3f(0.5f, 0.5f, 0.5f))));
+  root->SetShaderProgram(shader);
 
-  // Now use the GL function.
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferRange, true);
-  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferBase, true);
+  NodePtr child1(new Node);
+  child1->AddUniform(reg->Create<Uniform>("uTranslationMatrix",
+      math::TranslationMatrix(math::Vector3f(2.0f, 4.0f, 6.0f))));
 
-  // Simulate a failed GL call.
-  gm_->SetForceFunctionFailure("MapBufferRange", true);
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, range);
-  gm_->SetErrorCode(GL_NO_ERROR);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Failed to allocate data for"));
-  gm_->SetForceFunctionFailure("MapBufferRange", false);
+  NodePtr child2(new Node);
+  child2->AddUniform(reg->Create<Uniform>("uTranslationMatrix",
+      math::TranslationMatrix(math::Vector3f(10.0f, 8.0f, 6.0f))));
+
+  root->AddChild(child1);
+  child1->AddChild(child2);
+  root->AddShape(s_data.shape);
+  child1->AddShape(s_data.shape);
+  child2->AddShape(s_data.shape);
 
   Reset();
-  // An empty range should only log a warning message.
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBufferRange"));
-  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Ignoring empty range"));
-  EXPECT_TRUE(mbd.range.IsEmpty());
-  EXPECT_TRUE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
+  renderer->DrawScene(root);
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+  EXPECT_EQ(9U, trace_verifier_->GetCountOf("Uniform1fv"));
+  math::Vector3f vec;
+  vec.Set(0.5f, 0.5f, 0.5f);
+  math::Matrix4f mat = math::Transpose(
+      math::TranslationMatrix(vec));
+  const float* mat_floats = &mat[0][0];
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                0U, "UniformMatrix4fv"))
+                  .HasArg(4, helper.ToString("GLmatrix4*", mat_floats)));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                0U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[0])));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                1U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[1])));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                2U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[2])));
+  vec.Set(2.5f, 4.5f, 6.5f);
+  mat = math::Transpose(math::TranslationMatrix(vec));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                1U, "UniformMatrix4fv"))
+                  .HasArg(4, helper.ToString("GLmatrix4*", mat_floats)));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                3U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[0])));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                4U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[1])));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                5U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[2])));
+  vec.Set(12.5f, 12.5f, 12.5f);
+  mat = math::Transpose(math::TranslationMatrix(vec));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                2U, "UniformMatrix4fv"))
+                  .HasArg(4, helper.ToString("GLmatrix4*", mat_floats)));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                6U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[0])));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                7U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[1])));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                8U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[2])));
 
-  // Try a range that is too large.
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui(0, 16384U));
-  gm_->SetErrorCode(GL_NO_ERROR);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
-  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Failed to allocate data for"));
-  EXPECT_TRUE(mbd.range.IsEmpty());
-  EXPECT_TRUE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
+  // The generated uniforms are popped along with the uniform that generated
+  // them, so a sibling of child1 gets the values generated by root.
+  NodePtr child3(new Node);
+  child3->AddShape(s_data.shape);
+  root->AddChild(child3);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(4U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+  EXPECT_EQ(12U, trace_verifier_->GetCountOf("Uniform1fv"));
+  vec.Set(0.5f, 0.5f, 0.5f);
+  mat = math::Transpose(math::TranslationMatrix(vec));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                3U, "UniformMatrix4fv"))
+                  .HasArg(4, helper.ToString("GLmatrix4*", mat_floats)));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                9U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[0])));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
+                                                11U, "Uniform1fv"))
+                  .HasArg(3, base::ValueToString(vec[2])));
+}
+
+TEST_F(RendererTest, ConcurrentShader) {
+  // Check that different threads can have different uniform values
+  // set on the same shader when per-thread uniforms are enabled.
+  static const char* kVertexShaderString =
+      "uniform float uFloat;\n"
+      "void main(){}\n";
+  static const char* kFragmentShaderString =
+      "void main(){}\n";
+
+  RendererPtr renderer(new Renderer(gm_));
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+
+  BuildRectangleShape<uint16>();
+  NodePtr root(new Node);
+  root->AddShape(s_data.shape);
+  size_t uindex = root->AddUniform(reg->Create<Uniform>("uFloat", 0.f));
 
-  Reset();
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, range);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
-  EXPECT_TRUE(mbd.gpu_mapped);
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
-          .HasArg(4, "GL_MAP_WRITE_BIT"));
-  EXPECT_FALSE(log_checker.HasAnyMessages());
+  ResourceManager* manager = renderer->GetResourceManager();
+  MockVisual share_visual(*visual_);
+  std::vector<ResourceManager::ProgramInfo> other_infos;
 
-  // Check that the mapped data changed.
-  Reset();
-  EXPECT_EQ(range, mbd.range);
-  EXPECT_FALSE(mbd.pointer == NULL);
+  {
+    // Default: shared uniforms
+    Reset();
+    ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
+        "Shader", reg, kVertexShaderString, kFragmentShaderString,
+        base::AllocatorPtr());
+    root->SetShaderProgram(shader);
+    root->SetUniformValue(uindex, -7.f);
+    CallbackHelper<ResourceManager::ProgramInfo> before, after;
+    manager->RequestAllResourceInfos<ShaderProgram,
+                                     ResourceManager::ProgramInfo>(
+        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
+                  &before, std::placeholders::_1));
+    renderer->DrawScene(root);
 
-  // Try again to get a warning.
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kWriteOnly, Range1ui());
-  EXPECT_TRUE(log_checker.HasMessage(
-      "WARNING", "buffer that is already mapped was passed"));
-  EXPECT_TRUE(mbd.gpu_mapped);
+    EXPECT_TRUE(before.was_called);
+    EXPECT_EQ(1U, before.infos.size());
+    EXPECT_EQ(1U, before.infos[0].uniforms.size());
+    EXPECT_EQ(-7.f, before.infos[0].uniforms[0].value.Get<float>());
 
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
-  EXPECT_TRUE(mbd.range.IsEmpty());
-  EXPECT_TRUE(mbd.pointer == NULL);
-  EXPECT_FALSE(mbd.gpu_mapped);
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  // An additional call should not have been made.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
-  EXPECT_TRUE(
-      log_checker.HasMessage("WARNING", "unmapped BufferObject was passed"));
-  EXPECT_FALSE(mbd.gpu_mapped);
+    std::function<bool()> thread_function = std::bind(UniformThread,
+        renderer, &share_visual, root, uindex, 2.f, &other_infos);
+    port::ThreadId tid = port::SpawnThreadStd(&thread_function);
+    port::JoinThread(tid);
 
-  // Map using different access modes.
-  Reset();
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kReadOnly, range);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
-  EXPECT_TRUE(mbd.gpu_mapped);
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
-          .HasArg(4, "GL_MAP_READ_BIT"));
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
-  EXPECT_FALSE(mbd.gpu_mapped);
-  Reset();
-  renderer->MapBufferObjectDataRange(
-      s_data.vertex_buffer, Renderer::kReadWrite, range);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange"));
-  EXPECT_TRUE(mbd.gpu_mapped);
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
-      trace_verifier_->GetNthIndexOf(0U, "MapBuffer"))
-          .HasArg(4, "GL_MAP_READ_BIT | GL_MAP_WRITE_BIT"));
-  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UnmapBuffer"));
-  EXPECT_FALSE(mbd.gpu_mapped);
+    EXPECT_EQ(1U, other_infos.size());
+    EXPECT_EQ(1U, other_infos[0].uniforms.size());
+    EXPECT_EQ(2.f, other_infos[0].uniforms[0].value.Get<float>());
 
-  // Reset data.
-  s_data.rect = NULL;
-  s_data.vertex_container = NULL;
-  BuildRectangle();
-}
+    manager->RequestAllResourceInfos<ShaderProgram,
+                                     ResourceManager::ProgramInfo>(
+        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
+                  &after, std::placeholders::_1));
+    renderer->ProcessResourceInfoRequests();
+    EXPECT_TRUE(after.was_called);
+    EXPECT_EQ(1U, after.infos.size());
+    EXPECT_EQ(1U, after.infos[0].uniforms.size());
+    EXPECT_EQ(2.f, after.infos[0].uniforms[0].value.Get<float>());
+  }
 
-TEST_F(RendererTest, Flags) {
-  // Test that flags can be set properly.
-  RendererPtr renderer(new Renderer(gm_));
-  // By default all process flags are set.
-  Renderer::Flags flags = Renderer::AllProcessFlags();
-  EXPECT_EQ(flags, renderer->GetFlags());
+  {
+    // Per-thread uniforms
+    Reset();
+    ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
+        "Shader", reg, kVertexShaderString, kFragmentShaderString,
+        base::AllocatorPtr());
+    shader->SetConcurrent(true);
+    root->SetShaderProgram(shader);
+    root->SetUniformValue(uindex, -7.f);
+    CallbackHelper<ResourceManager::ProgramInfo> before, after;
+    manager->RequestAllResourceInfos<ShaderProgram,
+                                     ResourceManager::ProgramInfo>(
+        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
+                  &before, std::placeholders::_1));
+    renderer->DrawScene(root);
 
-  flags.reset(Renderer::kProcessReleases);
-  renderer->ClearFlag(Renderer::kProcessReleases);
-  EXPECT_EQ(flags, renderer->GetFlags());
+    EXPECT_TRUE(before.was_called);
+    EXPECT_EQ(1U, before.infos.size());
+    EXPECT_EQ(1U, before.infos[0].uniforms.size());
+    EXPECT_EQ(-7.f, before.infos[0].uniforms[0].value.Get<float>());
 
-  flags.set(Renderer::kRestoreShaderProgram);
-  renderer->SetFlag(Renderer::kRestoreShaderProgram);
-  EXPECT_EQ(flags, renderer->GetFlags());
+    std::function<bool()> thread_function = std::bind(UniformThread,
+        renderer, &share_visual, root, uindex, 2.f, &other_infos);
+    port::ThreadId tid = port::SpawnThreadStd(&thread_function);
+    port::JoinThread(tid);
 
-  flags.set(Renderer::kProcessInfoRequests);
-  renderer->SetFlag(Renderer::kProcessInfoRequests);
-  EXPECT_EQ(flags, renderer->GetFlags());
+    EXPECT_EQ(1U, other_infos.size());
+    EXPECT_EQ(1U, other_infos[0].uniforms.size());
+    EXPECT_EQ(2.f, other_infos[0].uniforms[0].value.Get<float>());
 
-  flags.reset(Renderer::kProcessInfoRequests);
-  renderer->ClearFlag(Renderer::kProcessInfoRequests);
-  EXPECT_EQ(flags, renderer->GetFlags());
+    manager->RequestAllResourceInfos<ShaderProgram,
+                                     ResourceManager::ProgramInfo>(
+        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
+                  &after, std::placeholders::_1));
+    renderer->ProcessResourceInfoRequests();
+    EXPECT_TRUE(after.was_called);
+    EXPECT_EQ(1U, after.infos.size());
+    EXPECT_EQ(1U, after.infos[0].uniforms.size());
+    EXPECT_EQ(-7.f, after.infos[0].uniforms[0].value.Get<float>());
+  }
+}
 
-  // Setting no flags should do nothing.
-  renderer->ClearFlags(Renderer::AllFlags());
-  renderer->SetFlags(Renderer::Flags());
-  EXPECT_EQ(0U, renderer->GetFlags().count());
+TEST_F(RendererTest, CreateResourceWithExternallyManagedId) {
+  NodePtr root = BuildGraph(800, 800);
 
-  // Multiple flags.
-  flags.reset();
-  flags.set(Renderer::kProcessInfoRequests);
-  flags.set(Renderer::kProcessReleases);
-  flags.set(Renderer::kRestoreShaderProgram);
-  flags.set(Renderer::kRestoreVertexArray);
-  renderer->SetFlags(flags);
-  EXPECT_EQ(4U, flags.count());
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+  // Test out the individual resource creation functions.
+  RendererPtr renderer(new Renderer(gm_));
+  // Ensure a resource binder exists.
+  renderer->DrawScene(NodePtr());
 
-  // Clearing no flags should do nothing.
-  flags.reset();
-  renderer->ClearFlags(flags);
-  EXPECT_EQ(4U, renderer->GetFlags().count());
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+  // BufferObject.
+  GLuint id;
+  gm_->GenBuffers(1, &id);
+  Reset();
+  // An invalid ID does nothing.
+  renderer->CreateResourceWithExternallyManagedId(s_data.vertex_buffer.Get(),
+                                                  2345U);
+  EXPECT_EQ(1U, trace_verifier_->GetCallCount());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsBuffer"));
 
-  // Setting no flags should do nothing.
-  flags.reset();
-  renderer->SetFlags(flags);
-  EXPECT_EQ(4U, renderer->GetFlags().count());
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+  renderer->CreateResourceWithExternallyManagedId(s_data.vertex_buffer.Get(),
+                                                  id);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenBuffers(1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER, 0x" +
+                                            base::ValueToString(id)));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
 
-  // Try to reset some unset flags.
-  flags.reset();
-  renderer->ClearFlags(flags);
-  EXPECT_EQ(4U, renderer->GetFlags().count());
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+  // IndexBuffer.
+  gm_->GenBuffers(1, &id);
+  Reset();
+  // An invalid ID does nothing.
+  renderer->CreateResourceWithExternallyManagedId(
+      s_data.shape->GetIndexBuffer().Get(), 2345U);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsBuffer"));
 
-  // Nothing should have changed.
-  renderer->ClearFlags(flags);
-  EXPECT_EQ(4U, renderer->GetFlags().count());
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessReleases));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreShaderProgram));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+  renderer->CreateResourceWithExternallyManagedId(
+      s_data.shape->GetIndexBuffer().Get(), id);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenBuffers(1"));
+  EXPECT_EQ(
+      1U, trace_verifier_->GetCountOf("BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0x" +
+                                      base::ValueToString(id)));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf("BufferData(GL_ELEMENT_ARRAY_BUFFER"));
+
+  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, false);
+  // Texture.
+  gm_->GenTextures(1, &id);
+  Reset();
+  // An invalid ID does nothing.
+  renderer->CreateResourceWithExternallyManagedId(s_data.texture.Get(), 2345U);
+  EXPECT_EQ(1U, trace_verifier_->GetCallCount());
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsTexture"));
+
+  renderer->CreateResourceWithExternallyManagedId(s_data.texture.Get(), id);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenTextures(1, "));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D, 0x" +
+                                            base::ValueToString(id)));
+  EXPECT_EQ(13U, trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_2D"));
+  EXPECT_EQ(3U, trace_verifier_->GetCountOf("TexParameterf(GL_TEXTURE_2D"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                    "TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 32, 32, 0, GL_RGBA, "
+                    "GL_UNSIGNED_BYTE"));
+  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, true);
 
-  // Reset some set flags.
-  flags.reset();
-  flags.set(Renderer::kProcessReleases);
-  flags.set(Renderer::kRestoreShaderProgram);
-  renderer->ClearFlags(flags);
-  EXPECT_EQ(2U, renderer->GetFlags().count());
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kProcessInfoRequests));
-  EXPECT_TRUE(renderer->GetFlags().test(Renderer::kRestoreVertexArray));
+  Reset();
+  // Destroy all resources.
+  renderer.Reset(NULL);
+  s_data.attribute_array = NULL;
+  s_data.vertex_buffer = NULL;
+  s_data.index_buffer = NULL;
+  s_data.shader = NULL;
+  s_data.shape = NULL;
+  s_data.texture = NULL;
+  s_data.rect = NULL;
+  // Check that the managed resources were not deleted.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Delete"));
 }
 
-TEST_F(RendererTest, FlagsBehavior) {
-  // Test the behavior of the Renderer when different flags are set.
+TEST_F(RendererTest, AsyncUploads) {
+  NodePtr root = BuildGraph(800, 800);
+  RendererPtr renderer(new Renderer(gm_));
+  base::LogChecker log_checker;
 
-  // Test kProcessInfoRequests.
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    ResourceManager* manager = renderer->GetResourceManager();
-    CallbackHelper<ResourceManager::PlatformInfo> callback;
+  // Uploads queued before the upload thread is started stay pending, so
+  // nothing that uses them is drawn.
+  renderer->UploadResourceAsync(s_data.texture.Get());
+  renderer->UploadResourceAsync(s_data.vertex_buffer.Get());
+  EXPECT_TRUE(renderer->IsUploadPending(s_data.texture.Get()));
+  EXPECT_TRUE(renderer->IsUploadPending(s_data.vertex_buffer.Get()));
+  EXPECT_FALSE(renderer->IsUploadPending(s_data.shader.Get()));
+  renderer->WaitForAsyncUploads();
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DrawElements"));
 
-    manager->RequestPlatformInfo(
-        std::bind(&CallbackHelper<ResourceManager::PlatformInfo>::Callback,
-                  &callback, std::placeholders::_1));
+  // Upload on another thread with a shared Visual.
+  MockVisual share_visual(*visual_);
+  Reset();
+  renderer->StartAsyncUploads(&share_visual);
+  renderer->WaitForAsyncUploads();
+  EXPECT_FALSE(renderer->IsUploadPending(s_data.texture.Get()));
+  EXPECT_FALSE(renderer->IsUploadPending(s_data.vertex_buffer.Get()));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("FenceSync"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("DeleteSync"));
 
-    renderer->ClearFlag(Renderer::kProcessInfoRequests);
-    renderer->DrawScene(NodePtr());
-    EXPECT_FALSE(callback.was_called);
+  // The uploaded resources are used without uploading them again.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
 
-    renderer->SetFlag(Renderer::kProcessInfoRequests);
-    renderer->DrawScene(NodePtr());
-    EXPECT_TRUE(callback.was_called);
+  // Without sync objects the upload thread waits with glFinish().
+  gm_->EnableFunctionGroup(GraphicsManager::kSync, false);
+  ImagePtr image(new Image);
+  image->Set(Image::kRgba8888, 16, 16, s_data.image_container);
+  s_data.texture->SetImage(0U, image);
+  Reset();
+  renderer->UploadResourceAsync(s_data.texture.Get());
+  renderer->WaitForAsyncUploads();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Finish"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("FenceSync"));
 
-    // It is possible that in our test platform, we cannot grab some of the
-    // capabilities and it will generate an error.
-    gm_->SetErrorCode(GL_NO_ERROR);
-  }
+  renderer->StopAsyncUploads();
+  portgfx::Visual::MakeCurrent(&share_visual);
+  Renderer::DestroyCurrentStateCache();
+  portgfx::Visual::MakeCurrent(visual_.get());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  // Test kProcessReleases.
+TEST_F(RendererTest, PixelBufferStreaming) {
+  NodePtr root = BuildGraph(800, 800);
+  base::LogChecker log_checker;
+
+  // By default image data is uploaded directly.
   {
     RendererPtr renderer(new Renderer(gm_));
-    NodePtr root = BuildGraph(800, 800);
-    // Drawing will create resources.
-    renderer->DrawScene(root);
-    Reset();
-    // These will trigger resources to be released.
-    s_data.attribute_array = NULL;
-    s_data.vertex_buffer = NULL;
-    s_data.index_buffer = NULL;
-    s_data.shader = NULL;
-    s_data.shape = NULL;
-    s_data.rect = NULL;
-    root->ClearChildren();
-    root->SetShaderProgram(ShaderProgramPtr(NULL));
-    // Tell the renderer not to process releases.
-    renderer->ClearFlag(Renderer::kProcessReleases);
-    renderer->DrawScene(root);
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteBuffers"));
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteProgram"));
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteShader"));
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("DeleteVertexArrays"));
-
-    // Tell the renderer to process releases.
-    renderer->SetFlag(Renderer::kProcessReleases);
     Reset();
     renderer->DrawScene(root);
-    // Most objects will be destroyed since the resources go away.
-    std::vector<std::string> call_strings;
-    call_strings.push_back("Clear");
-    call_strings.push_back("DeleteBuffers");
-    call_strings.push_back("DeleteBuffers");
-    call_strings.push_back("DeleteProgram");
-    call_strings.push_back("DeleteShader");
-    call_strings.push_back("DeleteShader");
-    call_strings.push_back("DeleteVertexArrays");
-    EXPECT_TRUE(trace_verifier_->VerifySortedCalls(call_strings));
-
-    // Reset data.
-    s_data.rect = NULL;
-    BuildRectangle();
+    EXPECT_EQ(0U,
+              trace_verifier_->GetCountOf("BindBuffer(GL_PIXEL_UNPACK_BUFFER"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
   }
 
-  // Test k(Restore|Save)*.
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    EXPECT_TRUE(VerifySaveAndRestoreFlag(
-        gm_, renderer, trace_verifier_, Renderer::kSaveActiveTexture,
-        Renderer::kRestoreActiveTexture, "GetIntegerv(GL_ACTIVE_TEXTURE",
-        "ActiveTexture"));
-  }
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    EXPECT_TRUE(VerifySaveAndRestoreFlag(
-        gm_, renderer, trace_verifier_, Renderer::kSaveArrayBuffer,
-        Renderer::kRestoreArrayBuffer, "GetIntegerv(GL_ARRAY_BUFFER_BINDING",
-        "BindBuffer(GL_ARRAY_BUFFER"));
-  }
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    EXPECT_TRUE(VerifySaveAndRestoreFlag(
-        gm_, renderer, trace_verifier_, Renderer::kSaveElementArrayBuffer,
-        Renderer::kRestoreElementArrayBuffer,
-        "GetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING",
-        "BindBuffer(GL_ELEMENT_ARRAY_BUFFER"));
-  }
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    FramebufferObjectPtr fbo(new FramebufferObject(
-        128, 128));
-    fbo->SetColorAttachment(0U,
-                            FramebufferObject::Attachment(Image::kRgba4Byte));
-    renderer->BindFramebuffer(fbo);
-    EXPECT_TRUE(VerifySaveAndRestoreFlag(
-        gm_, renderer, trace_verifier_, Renderer::kSaveFramebuffer,
-        Renderer::kRestoreFramebuffer, "GetIntegerv(GL_FRAMEBUFFER_BINDING",
-        "BindFramebuffer"));
-    EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-  }
+  // With the flag set, all textures are streamed through the ring.
   {
     RendererPtr renderer(new Renderer(gm_));
-    EXPECT_TRUE(VerifySaveAndRestoreFlag(
-        gm_, renderer, trace_verifier_, Renderer::kSaveShaderProgram,
-        Renderer::kRestoreShaderProgram, "GetIntegerv(GL_CURRENT_PROGRAM",
-        "UseProgram"));
-  }
-  {
-    RendererPtr renderer(new Renderer(gm_));
-    EXPECT_TRUE(VerifySaveAndRestoreFlag(
-        gm_, renderer, trace_verifier_, Renderer::kSaveVertexArray,
-        Renderer::kRestoreVertexArray, "GetIntegerv(GL_VERTEX_ARRAY_BINDING",
-        "BindVertexArray"));
+    renderer->SetFlag(Renderer::kStreamTexturesThroughPixelBuffers);
+    Reset();
+    renderer->DrawScene(root);
+    // The 2D texture and the six cube map faces are streamed through the four
+    // buffers in the ring, in addition to the two vertex and index buffers.
+    EXPECT_EQ(6U, trace_verifier_->GetCountOf("GenBuffers(1"));
+    EXPECT_EQ(7U, trace_verifier_->GetCountOf(
+                      "MapBufferRange(GL_PIXEL_UNPACK_BUFFER"));
+    EXPECT_EQ(7U, trace_verifier_->GetCountOf(
+                      "UnmapBuffer(GL_PIXEL_UNPACK_BUFFER"));
+    EXPECT_EQ(7U, trace_verifier_->GetCountOf(
+                      "BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0x0)"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(0U, "TexImage2D(GL_TEXTURE_2D"))
+                    .HasArg(9, "NULL"));
   }
+
+  // Streaming can also be enabled for a single texture.
+  s_data.texture->SetPixelBufferStreamingEnabled(true);
+  EXPECT_TRUE(s_data.texture->IsPixelBufferStreamingEnabled());
   {
-    // Saving and restoring StateTables is a little more complicated.
     RendererPtr renderer(new Renderer(gm_));
-
-    renderer->ClearFlag(Renderer::kRestoreStateTable);
-    renderer->SetFlag(Renderer::kSaveStateTable);
-    Reset();
-    renderer->DrawScene(NodePtr());
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsEnabled(GL_DEPTH_TEST"));
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsEnabled(GL_BLEND"));
-    renderer->ClearFlag(Renderer::kSaveStateTable);
-
-    // Now change a bunch of state.
     Reset();
-    NodePtr root = BuildGraph(800, 800);
-    root->GetStateTable()->Enable(StateTable::kDepthTest, false);
-    root->GetStateTable()->Enable(StateTable::kBlend, true);
     renderer->DrawScene(root);
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST"));
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
-
-    // Drawing again with no flags set should do nothing.
-    Reset();
-    renderer->DrawScene(NodePtr());
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable"));
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                      "MapBufferRange(GL_PIXEL_UNPACK_BUFFER"));
+    EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+        trace_verifier_->GetNthIndexOf(0U, "TexImage2D(GL_TEXTURE_2D"))
+                    .HasArg(9, "NULL"));
 
+    // Subsequent uploads cycle through the buffers in the ring, creating each
+    // one the first time it is used.
+    ImagePtr image(new Image);
+    image->Set(Image::kRgba8888, 16, 16, s_data.image_container);
+    s_data.texture->SetImage(0U, image);
     Reset();
-    renderer->SetFlag(Renderer::kRestoreStateTable);
-    renderer->DrawScene(NodePtr());
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Disable(GL_DEPTH_TEST"));
-    EXPECT_EQ(0U, trace_verifier_->GetCountOf("Enable(GL_BLEND"));
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_DEPTH_TEST"));
-    EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_BLEND"));
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenBuffers"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                      "MapBufferRange(GL_PIXEL_UNPACK_BUFFER"));
   }
 
-  // Test all save/restore flags simultaneously.
+  // Nothing is streamed if buffers cannot be mapped.
+  gm_->EnableFunctionGroup(GraphicsManager::kMapBufferRange, false);
   {
     RendererPtr renderer(new Renderer(gm_));
-    EXPECT_TRUE(VerifyAllSaveAndRestoreFlags(gm_, renderer));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U,
+              trace_verifier_->GetCountOf("BindBuffer(GL_PIXEL_UNPACK_BUFFER"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
   }
+  s_data.texture->SetPixelBufferStreamingEnabled(false);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  // Test kClear*.
-  {
-    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearActiveTexture,
-                                GL_ACTIVE_TEXTURE, GL_TEXTURE0));
-    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearArrayBuffer,
-                                GL_ARRAY_BUFFER_BINDING, 0));
-    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearElementArrayBuffer,
-                                GL_ELEMENT_ARRAY_BUFFER_BINDING, 0));
-    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearFramebuffer,
-                                GL_FRAMEBUFFER_BINDING, 0));
-    EXPECT_TRUE(VerifyClearImageUnitFlag(gm_, Renderer::kClearSamplers,
-                                         GL_SAMPLER_BINDING, 0));
-    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearShaderProgram,
-                                GL_CURRENT_PROGRAM, 0));
-    EXPECT_TRUE(VerifyClearImageUnitFlag(gm_, Renderer::kClearCubemaps,
-                                         GL_TEXTURE_BINDING_CUBE_MAP, 0));
-    EXPECT_TRUE(VerifyClearImageUnitFlag(gm_, Renderer::kClearTextures,
-                                         GL_TEXTURE_BINDING_2D, 0));
-    EXPECT_TRUE(VerifyClearFlag(gm_, Renderer::kClearVertexArray,
-                                GL_VERTEX_ARRAY_BINDING, 0));
-
-    // Check some corner cases. First, clearing the framebuffer should also
-    // clear the cached FramebufferPtr.
-    {
-      NodePtr root = BuildGraph(800, 800);
-      RendererPtr renderer(new Renderer(gm_));
-      FramebufferObjectPtr fbo(new FramebufferObject(
-          128, 128));
-      fbo->SetColorAttachment(0U,
-                              FramebufferObject::Attachment(Image::kRgba4Byte));
-      renderer->BindFramebuffer(fbo);
-
-      renderer->SetFlag(Renderer::kClearFramebuffer);
-      renderer->DrawScene(root);
-      // The framebuffer should have been cleared.
-      EXPECT_TRUE(renderer->GetCurrentFramebuffer().Get() == NULL);
-    }
+TEST_F(RendererTest, BatchResourceUpdates) {
+  NodePtr root = BuildGraph(800, 800);
+  NodePtr empty(new Node);
+  base::LogChecker log_checker;
+  ImagePtr image(new Image);
+  image->Set(Image::kRgba8888, 16, 16, s_data.image_container);
 
-    // Restoring a program binding should override clearing it.
-    {
-      NodePtr root = BuildGraph(800, 800);
-      RendererPtr renderer(new Renderer(gm_));
-      renderer->DrawScene(root);
-      Reset();
-      renderer->SetFlag(Renderer::kClearShaderProgram);
-      renderer->SetFlag(Renderer::kRestoreShaderProgram);
-      renderer->SetFlag(Renderer::kSaveShaderProgram);
-      renderer->DrawScene(root);
-      EXPECT_EQ(0U, trace_verifier_->GetCountOf("UseProgram(0x0)"));
-    }
+  // By default a changed texture is only updated when it is drawn.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    renderer->DrawScene(root);
+    s_data.texture->SetImage(0U, image);
+    Reset();
+    renderer->DrawScene(empty);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
+  }
 
-    // Restoring a VAO binding should override clearing it.
+  // With the flag set, changed textures and samplers are updated at the start
+  // of the next frame whether they are drawn or not, and only once.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    renderer->SetFlag(Renderer::kBatchResourceUpdates);
+    renderer->DrawScene(root);
+    s_data.texture->SetImage(0U, image);
+    s_data.texture->SetImage(0U, s_data.image);
+    s_data.sampler->SetWrapS(Sampler::kMirroredRepeat);
+    Reset();
+    renderer->DrawScene(empty);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("SamplerParameteri"));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
+    s_data.sampler->SetWrapS(Sampler::kRepeat);
+
+    // A texture that changes and is then destroyed before the next frame is
+    // released without being updated.
     {
-      NodePtr root = BuildGraph(800, 800);
-      RendererPtr renderer(new Renderer(gm_));
-      renderer->DrawScene(root);
-      Reset();
-      renderer->SetFlag(Renderer::kClearVertexArray);
-      renderer->SetFlag(Renderer::kRestoreVertexArray);
-      renderer->SetFlag(Renderer::kSaveVertexArray);
-      renderer->DrawScene(NodePtr());
-      EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindVertexArray(0x0)"));
+      TexturePtr texture(new Texture);
+      texture->SetImage(0U, s_data.image);
+      texture->SetSampler(s_data.sampler);
+      renderer->CreateOrUpdateResource(texture.Get());
+      texture->SetImage(0U, image);
     }
+    Reset();
+    renderer->DrawScene(empty);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteTextures"));
   }
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
-TEST_F(RendererTest, InitialUniformValue) {
-  // Check that it is possible to set initial Uniform values.
-  NodePtr node(new Node);
-  BuildRectangleShape<uint16>();
-  node->AddShape(s_data.shape);
-
-  const math::Matrix4f mat1(1.f, 2.f, 3.f, 4.f,
-                           5.f, 6.f, 7.f, 8.f,
-                           9.f, 1.f, 2.f, 3.f,
-                           4.f, 5.f, 6.f, 7.f);
-  const math::Matrix4f mat2(1.f, 2.f, 3.f, 4.f,
-                           9.f, 1.f, 2.f, 3.f,
-                           5.f, 6.f, 7.f, 8.f,
-                           4.f, 5.f, 6.f, 7.f);
-  const math::Vector4f vec(1.f, 2.f, 3.f, 4.f);
+TEST_F(RendererTest, DrawSceneInVisuals) {
+  NodePtr root = BuildGraph(800, 800);
+  base::LogChecker log_checker;
+  size_t visible_count = 0;
+  const Renderer::NodeVisibilityFunction count_visible =
+      [&visible_count](const Node& node) {
+        ++visible_count;
+        return true;
+      };
 
+  // Find the number of draw calls and visited Nodes for a single view.
+  size_t draw_count = 0;
+  size_t single_visible_count = 0;
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    renderer->SetNodeVisibilityFunction(count_visible);
+    Reset();
+    renderer->DrawScene(root);
+    draw_count = trace_verifier_->GetCountOf("DrawElements(") +
+                 trace_verifier_->GetCountOf("DrawArrays(");
+    single_visible_count = visible_count;
+  }
+  EXPECT_LT(0U, draw_count);
 
+  // Each view is drawn in its own Visual, but the scene is only traversed and
+  // its resources only uploaded once.
+  MockVisual share_visual(*visual_);
+  std::vector<const portgfx::Visual*> visuals;
+  visuals.push_back(visual_.get());
+  visuals.push_back(&share_visual);
+  std::vector<const portgfx::Visual*> view_visuals;
   RendererPtr renderer(new Renderer(gm_));
+  renderer->SetNodeVisibilityFunction(count_visible);
+  visible_count = 0;
+  Reset();
+  renderer->DrawSceneInVisuals(
+      root, visuals, [&view_visuals](size_t view_index) {
+        EXPECT_EQ(view_visuals.size(), view_index);
+        view_visuals.push_back(portgfx::Visual::GetCurrent());
+      });
+  EXPECT_EQ(visuals, view_visuals);
+  EXPECT_EQ(visual_.get(), portgfx::Visual::GetCurrent());
+  EXPECT_EQ(2U * draw_count, trace_verifier_->GetCountOf("DrawElements(") +
+                                 trace_verifier_->GetCountOf("DrawArrays("));
+  EXPECT_EQ(single_visible_count, visible_count);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TexImage2D(GL_TEXTURE_2D"));
 
-  // Create some uniform values.
-  const ShaderInputRegistryPtr& reg = ShaderInputRegistry::GetGlobalRegistry();
-  const Uniform modelview_matrix =
-      reg->Create<Uniform>("uModelviewMatrix", mat1);
-  const Uniform projection_matrix =
-      reg->Create<Uniform>("uProjectionMatrix", mat2);
-  const Uniform color = reg->Create<Uniform>("uBaseColor", vec);
+  // Drawing again in a single Visual still works.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(draw_count, trace_verifier_->GetCountOf("DrawElements(") +
+                            trace_verifier_->GetCountOf("DrawArrays("));
+  renderer.Reset();
+  Renderer::DestroyStateCache(&share_visual);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
 
-  renderer->SetInitialUniformValue(modelview_matrix);
-  renderer->SetInitialUniformValue(projection_matrix);
-  renderer->SetInitialUniformValue(color);
+TEST_F(RendererTest, UniformBufferObjects) {
+  base::LogChecker log_checker;
 
-  // Check that the values were set correctly.
-  ResourceManager* manager = renderer->GetResourceManager();
-  CallbackHelper<ResourceManager::ProgramInfo> callback;
-  manager->RequestAllResourceInfos<ShaderProgram, ResourceManager::ProgramInfo>(
-      std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
-                &callback, std::placeholders::_1));
-  renderer->DrawScene(node);
-  EXPECT_TRUE(callback.was_called);
-  EXPECT_EQ(1U, callback.infos.size());
-  EXPECT_EQ(3U, callback.infos[0].uniforms.size());
-  EXPECT_EQ("uProjectionMatrix", callback.infos[0].uniforms[0].name);
-  EXPECT_EQ(static_cast<GLuint>(GL_FLOAT_MAT4),
-            callback.infos[0].uniforms[0].type);
-  EXPECT_EQ(mat2, callback.infos[0].uniforms[0].value.Get<math::Matrix4f>());
+  static const char* kVertexShaderString =
+      "layout(std140) uniform Camera {\n"
+      "  mat4 uProjection;\n"
+      "  vec4 uEye;\n"
+      "};\n"
+      "attribute vec3 attribute;\n";
+  static const char* kVertex2ShaderString =
+      "layout(std140) uniform Camera {\n"
+      "  mat4 uProjection;\n"
+      "  vec4 uEye;\n"
+      "};\n"
+      "attribute vec3 attribute;\n"
+      "attribute vec3 attribute2;\n";
+  static const char* kFragmentShaderString = "void main() {}\n";
 
+  BuildRectangleBufferObject();
 
-  EXPECT_EQ("uModelviewMatrix", callback.infos[0].uniforms[1].name);
-  EXPECT_EQ(static_cast<GLuint>(GL_FLOAT_MAT4),
-            callback.infos[0].uniforms[1].type);
-  EXPECT_EQ(mat1, callback.infos[0].uniforms[1].value.Get<math::Matrix4f>());
+  NodePtr root(new Node);
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  AttributeArrayPtr aa(new AttributeArray);
+  aa->AddAttribute(reg->Create<Attribute>(
+      "attribute", BufferObjectElement(
+          s_data.vertex_buffer, s_data.vertex_buffer->AddSpec(
+              BufferObject::kFloat, 3, 0))));
+  ShapePtr shape(new Shape);
+  shape->SetAttributeArray(aa);
+  root->SetShaderProgram(ShaderProgram::BuildFromStrings(
+      "Shader", reg, kVertexShaderString, kFragmentShaderString,
+      base::AllocatorPtr()));
+  root->AddShape(shape);
+  NodePtr child(new Node);
+  child->SetShaderProgram(ShaderProgram::BuildFromStrings(
+      "Shader2", reg, kVertex2ShaderString, kFragmentShaderString,
+      base::AllocatorPtr()));
+  child->AddShape(shape);
+  root->AddChild(child);
 
-  EXPECT_EQ("uBaseColor", callback.infos[0].uniforms[2].name);
-  EXPECT_EQ(static_cast<GLuint>(GL_FLOAT_VEC4),
-            callback.infos[0].uniforms[2].type);
-  EXPECT_TRUE(math::VectorBase4f::AreValuesEqual(
-      vec, callback.infos[0].uniforms[2].value.Get<math::VectorBase4f>()));
-}
+  UniformBlockPtr block(new UniformBlock);
+  block->SetBlockName("Camera");
+  block->AddUniform(
+      reg->Create<Uniform>("uProjection", math::Matrix4f::Identity()));
+  block->AddUniform(reg->Create<Uniform>("uEye", math::Vector4f::Zero()));
+  root->AddUniformBlock(block);
 
-TEST_F(RendererTest, CombinedUniformsSent) {
-  // Check that combined uniforms that change are sent.
   RendererPtr renderer(new Renderer(gm_));
-  NodePtr root = BuildGraph(800, 800);
-  const ShaderInputRegistryPtr& global_reg =
-        ShaderInputRegistry::GetGlobalRegistry();
-  root->AddUniform(global_reg->Create<Uniform>("uModelviewMatrix",
-      math::TranslationMatrix(math::Vector3f(0.5f, 0.5f, 0.5f))));
   Reset();
   renderer->DrawScene(root);
-  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+  // The values are uploaded once and bound to both programs, instead of being
+  // sent to each of them.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_UNIFORM_BUFFER"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("GetUniformBlockIndex"));
+  EXPECT_EQ(2U, trace_verifier_->GetCountOf("UniformBlockBinding"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBufferRange"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "BindBufferRange"))
+                  .HasArg(5, "80"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Uniform4f"));
+
+  // Nothing is sent if nothing changes.
   Reset();
   renderer->DrawScene(root);
-  // Combined uModelviewMatrix generates a new stamp so it is sent.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
-  s_data.rect->SetUniformValue(
-      s_data.rect->GetUniformIndex("uModelviewMatrix"),
-      math::TranslationMatrix(math::Vector3f(-0.5f, 0.5f, 0.0f)));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_UNIFORM_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferSubData"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UniformBlockBinding"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBufferRange"));
+
+  // A changed value is uploaded with a single glBufferSubData().
+  block->SetUniformValue(1U, math::Vector4f(1.f, 2.f, 3.f, 4.f));
   Reset();
   renderer->DrawScene(root);
-  // The combined uniform is different, so it should have been sent.
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
-}
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_UNIFORM_BUFFER"));
+  EXPECT_EQ(1U,
+            trace_verifier_->GetCountOf("BufferSubData(GL_UNIFORM_BUFFER"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "BufferSubData"))
+                  .HasArg(2, "64"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBufferRange"));
 
-TEST_F(RendererTest, GeneratedUniformsSent) {
-  // Check that generated uniforms are properly created and sent.
-  TracingHelper helper;
+  // Without uniform buffer objects the values are sent to each program.
+  gm_->EnableFunctionGroup(GraphicsManager::kUniformBufferObjects, false);
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBufferRange"));
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("GetUniformBlockIndex"));
+  }
+  gm_->EnableFunctionGroup(GraphicsManager::kUniformBufferObjects, true);
+  base::logging_internal::SingleLogger::ClearMessages();
+}
 
-  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
-  reg->IncludeGlobalRegistry();
-  reg->Add(ShaderInputRegistry::UniformSpec(
-      "uTranslationMatrix", kMatrix4x4Uniform, "", CombineMatrices,
-      ExtractTranslation));
-  // Add the spec for the generated uniform.
-  reg->Add(ShaderInputRegistry::UniformSpec("uTranslationX", kFloatUniform));
-  reg->Add(ShaderInputRegistry::UniformSpec("uTranslationY", kFloatUniform));
-  reg->Add(ShaderInputRegistry::UniformSpec("uTranslationZ", kFloatUniform));
-  BuildGraph(800, 800);
+TEST_F(RendererTest, TransformFeedback) {
+  base::LogChecker log_checker;
 
   static const char* kVertexShaderString =
-      "attribute vec3 aVertex;\n"
-      "attribute vec2 aTexCoords;\n"
-      "uniform mat4 uTranslationMatrix;\n";
-
-  static const char* kFragmentShaderString =
-      "uniform float uTranslationX;\n"
-      "uniform float uTranslationY;\n"
-      "uniform float uTranslationZ;\n";
-
-  ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
-      "Shader", reg, kVertexShaderString, kFragmentShaderString,
-      base::AllocatorPtr());
-  s_data.shape->SetAttributeArray(s_data.attribute_array);
-  s_data.rect->SetShaderProgram(s_data.shader);
-  s_data.rect->ClearUniforms();
-  s_data.rect->AddUniform(
-      reg->Create<Uniform>("uniform1", math::Vector3f::Zero()));
-  s_data.rect->AddUniform(
-          reg->Create<Uniform>("uniform2", math::Vector3f::Zero()));
-
-  RendererPtr renderer(new Renderer(gm_));
-  NodePtr root(new Node);
-  root->AddUniform(reg->Create<Uniform>("uTranslationMatrix",
-      math::TranslationMatrix(math::Vector3f(0.5f, 0.5f, 0.5f))));
-  root->SetShaderProgram(shader);
-
-  NodePtr child1(new Node);
-  child1->AddUniform(reg->Create<Uniform>("uTranslationMatrix",
-      math::TranslationMatrix(math::Vector3f(2.0f, 4.0f, 6.0f))));
-
-  NodePtr child2(new Node);
-  child2->AddUniform(reg->Create<Uniform>("uTranslationMatrix",
-      math::TranslationMatrix(math::Vector3f(10.0f, 8.0f, 6.0f))));
-
-  root->AddChild(child1);
-  child1->AddChild(child2);
-  root->AddShape(s_data.shape);
-  child1->AddShape(s_data.shape);
-  child2->AddShape(s_data.shape);
+      "attribute vec3 attribute;\n"
+      "varying vec3 vPosition;\n";
+  static const char* kFragmentShaderString = "void main() {}\n";
 
-  Reset();
-  renderer->DrawScene(root);
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("UniformMatrix4fv"));
-  EXPECT_EQ(9U, trace_verifier_->GetCountOf("Uniform1fv"));
-  math::Vector3f vec;
-  vec.Set(0.5f, 0.5f, 0.5f);
-  math::Matrix4f mat = math::Transpose(
-      math::TranslationMatrix(vec));
-  const float* mat_floats = &mat[0][0];
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                0U, "UniformMatrix4fv"))
-                  .HasArg(4, helper.ToString("GLmatrix4*", mat_floats)));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                0U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[0])));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                1U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[1])));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                2U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[2])));
-  vec.Set(2.5f, 4.5f, 6.5f);
-  mat = math::Transpose(math::TranslationMatrix(vec));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                1U, "UniformMatrix4fv"))
-                  .HasArg(4, helper.ToString("GLmatrix4*", mat_floats)));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                3U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[0])));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                4U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[1])));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                5U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[2])));
-  vec.Set(12.5f, 12.5f, 12.5f);
-  mat = math::Transpose(math::TranslationMatrix(vec));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                2U, "UniformMatrix4fv"))
-                  .HasArg(4, helper.ToString("GLmatrix4*", mat_floats)));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                6U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[0])));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                7U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[1])));
-  EXPECT_TRUE(trace_verifier_->VerifyCallAt(trace_verifier_->GetNthIndexOf(
-                                                8U, "Uniform1fv"))
-                  .HasArg(3, base::ValueToString(vec[2])));
-}
+  BuildRectangleBufferObject();
 
-TEST_F(RendererTest, ConcurrentShader) {
-  // Check that different threads can have different uniform values
-  // set on the same shader when per-thread uniforms are enabled.
-  static const char* kVertexShaderString =
-      "uniform float uFloat;\n"
-      "void main(){}\n";
-  static const char* kFragmentShaderString =
-      "void main(){}\n";
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  AttributeArrayPtr aa(new AttributeArray);
+  aa->AddAttribute(reg->Create<Attribute>(
+      "attribute", BufferObjectElement(
+          s_data.vertex_buffer, s_data.vertex_buffer->AddSpec(
+              BufferObject::kFloat, 3, 0))));
+  ShapePtr shape(new Shape);
+  shape->SetAttributeArray(aa);
+  shape->SetPrimitiveType(Shape::kPoints);
+  ShaderProgramPtr program = ShaderProgram::BuildFromStrings(
+      "Simulation", reg, kVertexShaderString, kFragmentShaderString,
+      base::AllocatorPtr());
+  program->SetCapturedVaryings(std::vector<std::string>(1, "vPosition"));
+  NodePtr root(new Node);
+  root->SetShaderProgram(program);
+  root->AddShape(shape);
 
+  // The capture buffer holds one position for each of the vertices.
+  const math::Point3f positions[4];
+  BufferObjectPtr capture_buffer(new BufferObject);
+  capture_buffer->SetData(
+      base::DataContainer::CreateAndCopy<math::Point3f>(
+          positions, 4U, false, capture_buffer->GetAllocator()),
+      sizeof(positions[0]), 4U, BufferObject::kStreamDraw);
+  TransformFeedbackPtr feedback(new TransformFeedback(capture_buffer));
+  feedback->SetRasterizerDiscardEnabled(true);
+
+  // The varyings are named before the program is linked, and the capture
+  // begins with the first draw.
   RendererPtr renderer(new Renderer(gm_));
-  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  Reset();
+  renderer->BeginTransformFeedback(feedback);
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("TransformFeedbackVaryings"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                    "BindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Enable(GL_RASTERIZER_DISCARD"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BeginTransformFeedback(GL_POINTS"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("EndTransformFeedback"));
+  EXPECT_LT(trace_verifier_->GetNthIndexOf(0U, "TransformFeedbackVaryings"),
+            trace_verifier_->GetNthIndexOf(1U, "LinkProgram"));
+  EXPECT_LT(trace_verifier_->GetNthIndexOf(0U, "BeginTransformFeedback"),
+            trace_verifier_->GetNthIndexOf(0U, "DrawArrays"));
 
-  BuildRectangleShape<uint16>();
-  NodePtr root(new Node);
-  root->AddShape(s_data.shape);
-  size_t uindex = root->AddUniform(reg->Create<Uniform>("uFloat", 0.f));
+  // The capture continues across scenes drawn with the same program.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BeginTransformFeedback"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UseProgram"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS"));
 
-  ResourceManager* manager = renderer->GetResourceManager();
-  MockVisual share_visual(*visual_);
-  std::vector<ResourceManager::ProgramInfo> other_infos;
+  Reset();
+  renderer->EndTransformFeedback();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("EndTransformFeedback"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Disable(GL_RASTERIZER_DISCARD"));
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BeginTransformFeedback"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 
-  {
-    // Default: shared uniforms
-    Reset();
-    ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
-        "Shader", reg, kVertexShaderString, kFragmentShaderString,
-        base::AllocatorPtr());
-    root->SetShaderProgram(shader);
-    root->SetUniformValue(uindex, -7.f);
-    CallbackHelper<ResourceManager::ProgramInfo> before, after;
-    manager->RequestAllResourceInfos<ShaderProgram,
-                                     ResourceManager::ProgramInfo>(
-        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
-                  &before, std::placeholders::_1));
-    renderer->DrawScene(root);
+  // Shapes with a different base primitive type are not captured.
+  ShapePtr lines(new Shape);
+  lines->SetAttributeArray(aa);
+  lines->SetPrimitiveType(Shape::kLineStrip);
+  root->AddShape(lines);
+  Reset();
+  renderer->BeginTransformFeedback(feedback);
+  renderer->DrawScene(root);
+  renderer->EndTransformFeedback();
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BeginTransformFeedback(GL_POINTS"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays"));
+  EXPECT_TRUE(log_checker.HasMessage(
+      "ERROR", "must use the same shader program and base primitive type"));
+  root->RemoveShape(lines);
 
-    EXPECT_TRUE(before.was_called);
-    EXPECT_EQ(1U, before.infos.size());
-    EXPECT_EQ(1U, before.infos[0].uniforms.size());
-    EXPECT_EQ(-7.f, before.infos[0].uniforms[0].value.Get<float>());
+  // Changing the varyings relinks the program.
+  program->SetCapturedVaryings(std::vector<std::string>());
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("TransformFeedbackVaryings"));
+  EXPECT_LT(0U, trace_verifier_->GetCountOf("LinkProgram"));
 
-    std::function<bool()> thread_function = std::bind(UniformThread,
-        renderer, &share_visual, root, uindex, 2.f, &other_infos);
-    port::ThreadId tid = port::SpawnThreadStd(&thread_function);
-    port::JoinThread(tid);
+  // Nothing is captured if transform feedback is not supported.
+  gm_->EnableFunctionGroup(GraphicsManager::kTransformFeedback, false);
+  Reset();
+  renderer->BeginTransformFeedback(feedback);
+  renderer->DrawScene(root);
+  renderer->EndTransformFeedback();
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BeginTransformFeedback"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawArrays(GL_POINTS"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "not supported"));
+  gm_->EnableFunctionGroup(GraphicsManager::kTransformFeedback, true);
+}
 
-    EXPECT_EQ(1U, other_infos.size());
-    EXPECT_EQ(1U, other_infos[0].uniforms.size());
-    EXPECT_EQ(2.f, other_infos[0].uniforms[0].value.Get<float>());
+TEST_F(RendererTest, ComputeShaders) {
+  base::LogChecker log_checker;
 
-    manager->RequestAllResourceInfos<ShaderProgram,
-                                     ResourceManager::ProgramInfo>(
-        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
-                  &after, std::placeholders::_1));
-    renderer->ProcessResourceInfoRequests();
-    EXPECT_TRUE(after.was_called);
-    EXPECT_EQ(1U, after.infos.size());
-    EXPECT_EQ(1U, after.infos[0].uniforms.size());
-    EXPECT_EQ(2.f, after.infos[0].uniforms[0].value.Get<float>());
-  }
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  reg->Add(ShaderInputRegistry::UniformSpec(
+      "uScale", kFloatUniform, "Scale factor"));
+  ShaderProgramPtr program = ShaderProgram::BuildComputeFromString(
+      "Simulation", reg, "uniform float uScale;\n", base::AllocatorPtr());
+  EXPECT_TRUE(program->IsCompute());
+  NodePtr node(new Node);
+  node->SetShaderProgram(program);
+  node->AddUniform(reg->Create<Uniform>("uScale", 2.f));
 
-  {
-    // Per-thread uniforms
-    Reset();
-    ShaderProgramPtr shader = ShaderProgram::BuildFromStrings(
-        "Shader", reg, kVertexShaderString, kFragmentShaderString,
-        base::AllocatorPtr());
-    shader->SetConcurrent(true);
-    root->SetShaderProgram(shader);
-    root->SetUniformValue(uindex, -7.f);
-    CallbackHelper<ResourceManager::ProgramInfo> before, after;
-    manager->RequestAllResourceInfos<ShaderProgram,
-                                     ResourceManager::ProgramInfo>(
-        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
-                  &before, std::placeholders::_1));
-    renderer->DrawScene(root);
+  const uint32 values[4] = { 2U, 1U, 1U, 0U };
+  BufferObjectPtr buffer(new BufferObject);
+  buffer->SetData(base::DataContainer::CreateAndCopy<uint32>(
+                      values, 4U, false, buffer->GetAllocator()),
+                  sizeof(values[0]), 4U, BufferObject::kDynamicDraw);
+  TexturePtr texture(new Texture);
+  texture->SetImage(0U, CreateNullImage(4, 4, Image::kRgba8));
+  texture->SetSampler(SamplerPtr(new Sampler));
 
-    EXPECT_TRUE(before.was_called);
-    EXPECT_EQ(1U, before.infos.size());
-    EXPECT_EQ(1U, before.infos[0].uniforms.size());
-    EXPECT_EQ(-7.f, before.infos[0].uniforms[0].value.Get<float>());
+  RendererPtr renderer(new Renderer(gm_));
+  Reset();
+  renderer->BindShaderStorageBuffer(1U, buffer);
+  renderer->BindImageTexture(0U, texture, 0, Renderer::kWriteOnly);
+  renderer->DispatchCompute(node, 8U, 4U, 1U);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateShader(GL_COMPUTE_SHADER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                    "BindBufferRange(GL_SHADER_STORAGE_BUFFER, 0x1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindImageTexture"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DispatchCompute("));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "DispatchCompute("))
+                  .HasArg(1, "0x8").HasArg(2, "0x4").HasArg(3, "0x1"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("Uniform1fv"));
+  EXPECT_LT(trace_verifier_->GetNthIndexOf(0U, "UseProgram"),
+            trace_verifier_->GetNthIndexOf(0U, "DispatchCompute("));
+  // Barriers are deferred until something uses what was written.
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MemoryBarrier"));
+
+  // A second dispatch first waits for the first one with a single barrier.
+  Reset();
+  renderer->DispatchComputeIndirect(node, buffer, 4U);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MemoryBarrier"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
+                    "BindBuffer(GL_DISPATCH_INDIRECT_BUFFER"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "DispatchComputeIndirect"))
+                  .HasArg(1, "4"));
+  EXPECT_LT(trace_verifier_->GetNthIndexOf(0U, "MemoryBarrier"),
+            trace_verifier_->GetNthIndexOf(0U, "DispatchComputeIndirect"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("UseProgram"));
 
-    std::function<bool()> thread_function = std::bind(UniformThread,
-        renderer, &share_visual, root, uindex, 2.f, &other_infos);
-    port::ThreadId tid = port::SpawnThreadStd(&thread_function);
-    port::JoinThread(tid);
+  // Drawing waits for the dispatches, and only once.
+  Reset();
+  renderer->DrawScene(NodePtr(new Node));
+  renderer->DrawScene(NodePtr(new Node));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MemoryBarrier"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 
-    EXPECT_EQ(1U, other_infos.size());
-    EXPECT_EQ(1U, other_infos[0].uniforms.size());
-    EXPECT_EQ(2.f, other_infos[0].uniforms[0].value.Get<float>());
+  // Without any bound storage, nothing needs to wait.
+  renderer->BindShaderStorageBuffer(1U, BufferObjectPtr());
+  renderer->BindImageTexture(0U, TexturePtr(), 0, Renderer::kWriteOnly);
+  Reset();
+  renderer->DispatchCompute(node, 1U, 1U, 1U);
+  renderer->DrawScene(NodePtr(new Node));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DispatchCompute("));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MemoryBarrier"));
 
-    manager->RequestAllResourceInfos<ShaderProgram,
-                                     ResourceManager::ProgramInfo>(
-        std::bind(&CallbackHelper<ResourceManager::ProgramInfo>::Callback,
-                  &after, std::placeholders::_1));
-    renderer->ProcessResourceInfoRequests();
-    EXPECT_TRUE(after.was_called);
-    EXPECT_EQ(1U, after.infos.size());
-    EXPECT_EQ(1U, after.infos[0].uniforms.size());
-    EXPECT_EQ(-7.f, after.infos[0].uniforms[0].value.Get<float>());
-  }
+  // Images need an image.
+  renderer->BindImageTexture(0U, TexturePtr(new Texture), 0,
+                             Renderer::kReadOnly);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "It has no image"));
+
+  // Only compute programs can be dispatched.
+  NodePtr draw_node(new Node);
+  draw_node->SetShaderProgram(ShaderProgram::BuildFromStrings(
+      "Draw", reg, kPlaneVertexShaderString, kPlaneFragmentShaderString,
+      base::AllocatorPtr()));
+  Reset();
+  renderer->DispatchCompute(draw_node, 1U, 1U, 1U);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DispatchCompute"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no compute shader program"));
+
+  // Nothing is dispatched if compute shaders are not supported.
+  gm_->EnableFunctionGroup(GraphicsManager::kComputeShader, false);
+  Reset();
+  renderer->DispatchCompute(node, 1U, 1U, 1U);
+  renderer->BindShaderStorageBuffer(0U, buffer);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("DispatchCompute"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BindBufferRange"));
+  EXPECT_TRUE(log_checker.HasMessage(
+      "ERROR", "Compute shaders are not supported"));
+  gm_->EnableFunctionGroup(GraphicsManager::kComputeShader, true);
 }
 
-TEST_F(RendererTest, CreateResourceWithExternallyManagedId) {
+TEST_F(RendererTest, PersistentlyMappedStreamBuffers) {
   NodePtr root = BuildGraph(800, 800);
+  s_data.vertex_buffer->SetData(s_data.vertex_container, sizeof(Vertex),
+                                s_num_vertices, BufferObject::kStreamDraw);
+  base::LogChecker log_checker;
+
+  // Without the flag the data is uploaded normally.
+  {
+    RendererPtr renderer(new Renderer(gm_));
+    Reset();
+    renderer->DrawScene(root);
+    EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferStorage"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  }
 
-  // Test out the individual resource creation functions.
   RendererPtr renderer(new Renderer(gm_));
-  // Ensure a resource binder exists.
-  renderer->DrawScene(NodePtr());
+  renderer->SetFlag(Renderer::kPersistentlyMapStreamBuffers);
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferStorage(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("MapBufferRange(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("FenceSync"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
 
-  // BufferObject.
-  GLuint id;
-  gm_->GenBuffers(1, &id);
+  // Each change is written into the next region of the storage, and the
+  // attribute pointers are respecified at its offset.
   Reset();
-  // An invalid ID does nothing.
-  renderer->CreateResourceWithExternallyManagedId(s_data.vertex_buffer.Get(),
-                                                  2345U);
-  EXPECT_EQ(1U, trace_verifier_->GetCallCount());
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsBuffer"));
+  s_data.vertex_buffer->SetData(s_data.vertex_container, sizeof(Vertex),
+                                s_num_vertices, BufferObject::kStreamDraw);
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferStorage"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  // The 20-byte vertices are stored in 128-byte regions.
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "VertexAttribPointer"))
+                  .HasArg(6, "0x80"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(1U, "VertexAttribPointer"))
+                  .HasArg(6, "0x8c"));
+  // The frame that stopped using the first region is fenced.
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("FenceSync"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClientWaitSync"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DrawElements"));
 
-  renderer->CreateResourceWithExternallyManagedId(s_data.vertex_buffer.Get(),
-                                                  id);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenBuffers(1"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER, 0x" +
-                                            base::ValueToString(id)));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  // Frames that do not change the data are not fenced.
+  Reset();
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("VertexAttribPointer"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("FenceSync"));
 
-  // IndexBuffer.
-  gm_->GenBuffers(1, &id);
+  // Sub-data is written into the current region.
   Reset();
-  // An invalid ID does nothing.
-  renderer->CreateResourceWithExternallyManagedId(
-      s_data.shape->GetIndexBuffer().Get(), 2345U);
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsBuffer"));
+  s_data.vertex_buffer->SetSubData(
+      math::Range1ui(0U, static_cast<uint32>(sizeof(Vertex))),
+      s_data.vertex_container);
+  renderer->DrawScene(root);
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "BufferSubData(GL_ARRAY_BUFFER"))
+                  .HasArg(2, "128"));
 
-  renderer->CreateResourceWithExternallyManagedId(
-      s_data.shape->GetIndexBuffer().Get(), id);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenBuffers(1"));
-  EXPECT_EQ(
-      1U, trace_verifier_->GetCountOf("BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0x" +
-                                      base::ValueToString(id)));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf("BufferData(GL_ELEMENT_ARRAY_BUFFER"));
+  // The third region is unused, but reusing the first one waits for the fence
+  // of the frame that last used it.
+  Reset();
+  s_data.vertex_buffer->SetData(s_data.vertex_container, sizeof(Vertex),
+                                s_num_vertices, BufferObject::kStreamDraw);
+  renderer->DrawScene(root);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("ClientWaitSync"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("FenceSync"));
+  Reset();
+  s_data.vertex_buffer->SetData(s_data.vertex_container, sizeof(Vertex),
+                                s_num_vertices, BufferObject::kStreamDraw);
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("ClientWaitSync"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteSync"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "VertexAttribPointer"))
+                  .HasArg(6, "NULL"));
 
-  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, false);
-  // Texture.
-  gm_->GenTextures(1, &id);
+  // Mapping the buffer through the Renderer maps client memory, which is sent
+  // to the current region when unmapped.
   Reset();
-  // An invalid ID does nothing.
-  renderer->CreateResourceWithExternallyManagedId(s_data.texture.Get(), 2345U);
-  EXPECT_EQ(1U, trace_verifier_->GetCallCount());
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("IsTexture"));
+  renderer->MapBufferObjectData(s_data.vertex_buffer, Renderer::kWriteOnly);
+  EXPECT_FALSE(s_data.vertex_buffer->GetMappedPointer() == NULL);
+  renderer->UnmapBufferObjectData(s_data.vertex_buffer);
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("MapBufferRange"));
+  EXPECT_TRUE(trace_verifier_->VerifyCallAt(
+      trace_verifier_->GetNthIndexOf(0U, "BufferSubData(GL_ARRAY_BUFFER"))
+                  .HasArg(2, "0"));
 
-  renderer->CreateResourceWithExternallyManagedId(s_data.texture.Get(), id);
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("GenTextures(1, "));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindTexture(GL_TEXTURE_2D, 0x" +
-                                            base::ValueToString(id)));
-  EXPECT_EQ(13U, trace_verifier_->GetCountOf("TexParameteri(GL_TEXTURE_2D"));
-  EXPECT_EQ(3U, trace_verifier_->GetCountOf("TexParameterf(GL_TEXTURE_2D"));
-  EXPECT_EQ(1U,
-            trace_verifier_->GetCountOf("PixelStorei(GL_UNPACK_ALIGNMENT, 1)"));
-  EXPECT_EQ(1U, trace_verifier_->GetCountOf(
-                    "TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 32, 32, 0, GL_RGBA, "
-                    "GL_UNSIGNED_BYTE"));
-  gm_->EnableFunctionGroup(GraphicsManager::kSamplerObjects, true);
+  // Larger data needs new storage, which requires a new buffer.
+  const Vertex vertices[s_num_vertices * 2] = {};
+  Reset();
+  s_data.vertex_buffer->SetData(
+      base::DataContainer::CreateAndCopy<Vertex>(
+          vertices, s_num_vertices * 2, false,
+          s_data.vertex_buffer->GetAllocator()),
+      sizeof(Vertex), s_num_vertices * 2, BufferObject::kStreamDraw);
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenBuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferStorage(GL_ARRAY_BUFFER"));
 
+  // Other usage modes go back to regular buffers.
   Reset();
-  // Destroy all resources.
-  renderer.Reset(NULL);
-  s_data.attribute_array = NULL;
-  s_data.vertex_buffer = NULL;
-  s_data.index_buffer = NULL;
-  s_data.shader = NULL;
-  s_data.shape = NULL;
-  s_data.texture = NULL;
-  s_data.rect = NULL;
-  // Check that the managed resources were not deleted.
-  EXPECT_EQ(0U, trace_verifier_->GetCountOf("Delete"));
+  s_data.vertex_buffer->SetData(s_data.vertex_container, sizeof(Vertex),
+                                s_num_vertices, BufferObject::kDynamicDraw);
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("DeleteBuffers"));
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferStorage"));
+
+  // Nothing is persistently mapped without buffer storage support.
+  gm_->EnableFunctionGroup(GraphicsManager::kBufferStorage, false);
+  Reset();
+  s_data.vertex_buffer->SetData(s_data.vertex_container, sizeof(Vertex),
+                                s_num_vertices, BufferObject::kStreamDraw);
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, trace_verifier_->GetCountOf("BufferData(GL_ARRAY_BUFFER"));
+  EXPECT_EQ(0U, trace_verifier_->GetCountOf("BufferStorage"));
+
+  s_data.vertex_buffer->SetData(s_data.vertex_container, sizeof(Vertex),
+                                s_num_vertices, s_options.vertex_buffer_usage);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
 TEST_F(RendererTest, CreateOrUpdateResources) {
@@ -8867,8 +12502,8 @@ TEST_F(RendererTest, CreateOrUpdateResources) {
     EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
     EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
     EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
-    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetActiveUniform"));
-    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetUniformLocation"));
+    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+    EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceiv"));
     EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
 
     // Texture.
@@ -9048,6 +12683,31 @@ TEST_F(RendererTest, CreateOrUpdateResources) {
     root->Enable(false);
     renderer->CreateOrUpdateResources(root);
     EXPECT_EQ(0U, trace_verifier_->GetCallCount());
+    renderer->CreateOrUpdateResources(*root);
+    EXPECT_EQ(0U, trace_verifier_->GetCallCount());
+    root->Enable(true);
+  }
+
+  {
+    // The borrowed overloads create the same resources without touching any
+    // reference counts.
+    RendererPtr renderer(new Renderer(gm_));
+    const int root_count = root->GetRefCount();
+    const int shape_count = s_data.shape->GetRefCount();
+    Reset();
+    renderer->CreateOrUpdateShapeResources(*s_data.shape);
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenBuffers(1"));
+    renderer->CreateOrUpdateResources(*root);
+    EXPECT_EQ(2U, trace_verifier_->GetCountOf("GenBuffers(1"));
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("GenTextures(1, "));
+    Reset();
+    renderer->RequestForcedShapeUpdates(*s_data.shape);
+    renderer->RequestForcedUpdates(*root);
+    EXPECT_EQ(0U, trace_verifier_->GetCallCount());
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, trace_verifier_->GetCountOf("BindBuffer(GL_ARRAY_BUFFER"));
+    EXPECT_EQ(root_count, root->GetRefCount());
+    EXPECT_EQ(shape_count, s_data.shape->GetRefCount());
   }
 }
 
@@ -9097,8 +12757,8 @@ TEST_F(RendererTest, BindResource) {
   EXPECT_EQ(1U, trace_verifier_->GetCountOf("CreateProgram"));
   EXPECT_EQ(3U, trace_verifier_->GetCountOf("BindAttribLocation"));
   EXPECT_EQ(3U, trace_verifier_->GetCountOf("GetActiveAttrib"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetActiveUniform"));
-  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetUniformLocation"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceName"));
+  EXPECT_EQ(5U, trace_verifier_->GetCountOf("GetProgramResourceiv"));
   EXPECT_EQ(2U, trace_verifier_->GetCountOf("LinkProgram"));
 
   // Texture.
@@ -9511,12 +13171,12 @@ TEST_F(RendererTest, DebugMarkers) {
     renderer->PopDebugMarker();
     renderer->DrawScene(root);
     // uModelviewMatrix uses a temporary Uniform when combining so we need to
-    // extract the string from the trace to get proper addresses.
+    // extract the string from the trace to get proper addresses. Since the
+    // combined matrix has not changed, only its label is emitted.
     const std::string actual = trace_verifier_->GetTraceString();
     size_t start =
         actual.find_first_of('\n', actual.find_first_of('\n') + 1) + 1;
-    size_t end =
-        actual.find_first_of('\n', actual.find_first_of('\n', start) + 1);
+    size_t end = actual.find_first_of('\n', start);
     modelview_markers = actual.substr(start, end - start + 1);
     // Check for a pop.
     const std::string expected(
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "ion/base/datacontainer.h"
 #include "ion/base/logchecker.h"
+#include "ion/base/threadspawner.h"
 #include "ion/gfx/attribute.h"
 #include "ion/gfx/bufferobject.h"
 #include "ion/gfx/framebufferobject.h"
@@ -33,6 +34,7 @@ limitations under the License.
 #include "ion/gfx/uniform.h"
 #include "ion/math/matrix.h"
 #include "ion/math/vector.h"
+#include "ion/port/timer.h"
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -96,6 +98,20 @@ struct CallbackHelper {
   bool was_called;
 };
 
+// Counts the calls to its callback, each of which takes at least
+// |sleep_ms| milliseconds.
+template <typename T>
+struct SlowCallbackHelper {
+  explicit SlowCallbackHelper(unsigned int sleep_ms_in)
+      : sleep_ms(sleep_ms_in), call_count(0) {}
+  void Callback(const std::vector<T>& infos) {
+    port::Timer::SleepNMilliseconds(sleep_ms);
+    ++call_count;
+  }
+  unsigned int sleep_ms;
+  int call_count;
+};
+
 // Verifies that no infos are returned when querying for all available
 // resources.
 template <typename HolderType, typename InfoType>
@@ -809,7 +825,7 @@ TEST_F(ResourceManagerTest, GetBufferInfo) {
   CallbackHelper<BufferInfo> callback;
 
   // Get the vertex buffer object info from the first buffer attribute.
-  const base::AllocVector<ShapePtr>& shapes =
+  const Node::ShapeVector& shapes =
       root->GetChildren()[0]->GetChildren()[0]->GetShapes();
   ASSERT_LT(0U, shapes.size());
   ASSERT_TRUE(shapes[0]->GetAttributeArray().Get() != NULL);
@@ -1016,6 +1032,45 @@ TEST_F(ResourceManagerTest, GetPlatformInfo) {
   }
 }
 
+TEST_F(ResourceManagerTest, RequestsFromOtherThreads) {
+  typedef ResourceManager::PlatformInfo PlatformInfo;
+  typedef ResourceManager::InfoCallback<PlatformInfo>::Type Callback;
+
+  ResourceManager* manager = renderer_->GetResourceManager();
+  std::vector<int> order;
+  // Make more requests than fit in the lock-free queue so that some overflow.
+  static const int kRequestCount = 50;
+  {
+    base::ThreadSpawner t("requests", [manager, &order]() {
+      for (int i = 0; i < kRequestCount; ++i) {
+        manager->RequestPlatformInfo(
+            [&order, i](const std::vector<PlatformInfo>&) {
+              order.push_back(i);
+            });
+      }
+      return true;
+    });
+  }
+  // A callback may make another request, which is processed next time.
+  bool rerequested = false;
+  const Callback second = [&rerequested](const std::vector<PlatformInfo>&) {
+    rerequested = true;
+  };
+  manager->RequestPlatformInfo(
+      [manager, &second](const std::vector<PlatformInfo>&) {
+        manager->RequestPlatformInfo(second);
+      });
+
+  renderer_->ProcessResourceInfoRequests();
+  ASSERT_EQ(static_cast<size_t>(kRequestCount), order.size());
+  for (int i = 0; i < kRequestCount; ++i)
+    EXPECT_EQ(i, order[i]);
+  EXPECT_FALSE(rerequested);
+  renderer_->ProcessResourceInfoRequests();
+  EXPECT_TRUE(rerequested);
+  EXPECT_EQ(static_cast<size_t>(kRequestCount), order.size());
+}
+
 TEST_F(ResourceManagerTest, GetProgramInfo) {
   typedef ResourceManager::ProgramInfo ProgramInfo;
 
@@ -1511,5 +1566,61 @@ TEST_F(ResourceManagerTest, GetTextureData) {
   callback.Reset();
 }
 
+TEST_F(ResourceManagerTest, InfoRequestBudget) {
+  typedef ResourceManager::PlatformInfo PlatformInfo;
+
+  ResourceManager* manager = renderer_->GetResourceManager();
+  EXPECT_EQ(0U, renderer_->GetInfoRequestBudget());
+  EXPECT_EQ(0U, renderer_->GetPendingInfoRequestCount());
+
+  // Without a budget all requests are processed in one frame.
+  SlowCallbackHelper<PlatformInfo> callback(2U);
+  for (int i = 0; i < 3; ++i)
+    manager->RequestPlatformInfo(
+        std::bind(&SlowCallbackHelper<PlatformInfo>::Callback, &callback,
+                  std::placeholders::_1));
+  renderer_->DrawScene(NodePtr());
+  EXPECT_EQ(3, callback.call_count);
+  EXPECT_EQ(0U, renderer_->GetPendingInfoRequestCount());
+
+  // Each request takes longer than the budget, so only one is processed per
+  // frame, in order.
+  renderer_->SetInfoRequestBudget(1000U);
+  EXPECT_EQ(1000U, renderer_->GetInfoRequestBudget());
+  callback.call_count = 0;
+  for (int i = 0; i < 3; ++i)
+    manager->RequestPlatformInfo(
+        std::bind(&SlowCallbackHelper<PlatformInfo>::Callback, &callback,
+                  std::placeholders::_1));
+  renderer_->DrawScene(NodePtr());
+  EXPECT_EQ(1, callback.call_count);
+  EXPECT_EQ(2U, renderer_->GetPendingInfoRequestCount());
+  renderer_->DrawScene(NodePtr());
+  EXPECT_EQ(2, callback.call_count);
+  EXPECT_EQ(1U, renderer_->GetPendingInfoRequestCount());
+
+  // Explicitly processing requests ignores the budget.
+  CallbackHelper<PlatformInfo> fast_callback;
+  manager->RequestPlatformInfo(
+      std::bind(&CallbackHelper<PlatformInfo>::Callback, &fast_callback,
+                std::placeholders::_1));
+  renderer_->ProcessResourceInfoRequests();
+  EXPECT_EQ(3, callback.call_count);
+  EXPECT_TRUE(fast_callback.was_called);
+  EXPECT_EQ(0U, renderer_->GetPendingInfoRequestCount());
+
+  // Without the flag nothing is processed, even with requests pending.
+  renderer_->SetInfoRequestBudget(0U);
+  renderer_->ClearFlag(Renderer::kProcessInfoRequests);
+  manager->RequestPlatformInfo(
+      std::bind(&SlowCallbackHelper<PlatformInfo>::Callback, &callback,
+                std::placeholders::_1));
+  renderer_->DrawScene(NodePtr());
+  EXPECT_EQ(3, callback.call_count);
+  renderer_->SetFlag(Renderer::kProcessInfoRequests);
+  renderer_->DrawScene(NodePtr());
+  EXPECT_EQ(4, callback.call_count);
+}
+
 }  // namespace gfx
 }  // namespace ion
@@ -21,6 +21,7 @@ limitations under the License.
 #include <vector>
 
 #include "ion/base/logchecker.h"
+#include "ion/gfx/node.h"
 #include "ion/math/angle.h"
 #include "ion/math/matrix.h"
 #include "ion/math/rotation.h"
@@ -541,5 +542,65 @@ TEST(ShaderInputRegistryTest, Include) {
   EXPECT_TRUE(reg4->CheckInputsAreUnique());
 }
 
+TEST(ShaderInputRegistryTest, NameIdsAndFlattenedIncludes) {
+  base::LogChecker log_checker;
+  ShaderInputRegistryPtr reg1(new ShaderInputRegistry);
+  ShaderInputRegistryPtr reg2(new ShaderInputRegistry);
+  ShaderInputRegistryPtr reg3(new ShaderInputRegistry);
+
+  // Names are interned when specs are added, with the same id everywhere.
+  EXPECT_EQ(base::kInvalidIndex,
+            ShaderInputRegistry::FindNameId("uNameIdTestUniform"));
+  EXPECT_TRUE(reg3->Add(ShaderInputRegistry::UniformSpec(
+      "uNameIdTestUniform", kFloatUniform, "doc")));
+  const size_t name_id = ShaderInputRegistry::FindNameId("uNameIdTestUniform");
+  EXPECT_NE(base::kInvalidIndex, name_id);
+  EXPECT_EQ(name_id, ShaderInputRegistry::GetNameId("uNameIdTestUniform"));
+  EXPECT_EQ(name_id, reg3->Find<Uniform>("uNameIdTestUniform")->name_id);
+  EXPECT_NE(name_id, ShaderInputRegistry::GetNameId("aNameIdTestAttribute"));
+  EXPECT_EQ(ShaderInputRegistry::GetNameId("uViewportSize"),
+            ShaderInputRegistry::GetGlobalRegistry()
+                ->Find<Uniform>("uViewportSize")
+                ->name_id);
+
+  // Lookups by id find the same specs as lookups by name, through includes.
+  EXPECT_TRUE(reg2->Include(reg3));
+  EXPECT_TRUE(reg1->Include(reg2));
+  EXPECT_TRUE(reg1->IncludeGlobalRegistry());
+  EXPECT_EQ(reg3->Find<Uniform>("uNameIdTestUniform"),
+            reg1->FindById<Uniform>(name_id));
+  EXPECT_EQ(reg3->Find<Uniform>("uNameIdTestUniform"),
+            reg1->Find<Uniform>("uNameIdTestUniform"));
+  EXPECT_TRUE(reg1->FindById<Attribute>(name_id) == NULL);
+  EXPECT_TRUE(reg1->FindById<Uniform>(base::kInvalidIndex) == NULL);
+  EXPECT_TRUE(reg1->Find<Attribute>("aVertex") != NULL);
+
+  // Specs added to an included registry later are found, and included
+  // registries are still searched first.
+  EXPECT_TRUE(reg1->Find<Attribute>("aNameIdTestAttribute") == NULL);
+  EXPECT_FALSE(reg1->Contains("aNameIdTestAttribute"));
+  EXPECT_TRUE(reg3->Add(ShaderInputRegistry::AttributeSpec(
+      "aNameIdTestAttribute", kFloatAttribute, "doc")));
+  EXPECT_TRUE(reg1->Contains("aNameIdTestAttribute"));
+  ASSERT_TRUE(reg1->Find<Attribute>("aNameIdTestAttribute") != NULL);
+  EXPECT_EQ(reg3->GetId(),
+            reg1->Find<Attribute>("aNameIdTestAttribute")->registry_id);
+  EXPECT_TRUE(reg1->Add(ShaderInputRegistry::UniformSpec(
+      "uNameIdTestInt", kIntUniform, "doc")));
+  EXPECT_TRUE(reg3->Add(ShaderInputRegistry::UniformSpec(
+      "uNameIdTestInt", kIntUniform, "doc")));
+  EXPECT_EQ(reg3->GetId(), reg1->Find<Uniform>("uNameIdTestInt")->registry_id);
+
+  // UniformHolders find uniforms by interned name.
+  NodePtr node(new Node);
+  node->AddUniform(reg1->Create<Uniform>("uNameIdTestUniform", 1.f));
+  EXPECT_EQ(0U, node->GetUniformIndex("uNameIdTestUniform"));
+  EXPECT_EQ(base::kInvalidIndex, node->GetUniformIndex("uNameIdTestInt"));
+  EXPECT_EQ(base::kInvalidIndex, node->GetUniformIndex("uNeverInterned"));
+  EXPECT_EQ(base::kInvalidIndex,
+            ShaderInputRegistry::FindNameId("uNeverInterned"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
 }  // namespace gfx
 }  // namespace ion
@@ -18,6 +18,8 @@ limitations under the License.
 #include "ion/gfx/shaderprogram.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include "ion/base/logchecker.h"
 #include "ion/gfx/shaderinputregistry.h"
@@ -155,6 +157,58 @@ TEST_F(ShaderProgramTest, SetFragmentShader) {
   EXPECT_EQ(0U, new_shader->GetReceiverCount());
 }
 
+TEST_F(ShaderProgramTest, SetComputeShader) {
+  // Check that the initial shader is NULL.
+  EXPECT_TRUE(program_->GetComputeShader().Get() == NULL);
+  EXPECT_FALSE(program_->IsCompute());
+
+  ShaderPtr compute(new Shader());
+  program_->SetComputeShader(compute);
+  EXPECT_TRUE(program_->IsCompute());
+  EXPECT_EQ(compute.Get(), program_->GetComputeShader().Get());
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      ShaderProgram::kComputeShaderChanged));
+  resource_->ResetModifiedBit(ShaderProgram::kComputeShaderChanged);
+
+  // Modifying the shader should also trigger a Notifier change.
+  compute->SetSource("new source");
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      ShaderProgram::kComputeShaderChanged));
+  resource_->ResetModifiedBit(ShaderProgram::kComputeShaderChanged);
+
+  // The program should remove itself as a receiver when it goes away.
+  EXPECT_EQ(1U, compute->GetReceiverCount());
+  program_.Reset();
+  EXPECT_EQ(0U, compute->GetReceiverCount());
+
+  program_ = ShaderProgram::BuildComputeFromString(
+      "Cull", registry_, "compute source", base::AllocatorPtr());
+  EXPECT_TRUE(program_->IsCompute());
+  EXPECT_EQ("Cull", program_->GetLabel());
+  EXPECT_EQ("compute source", program_->GetComputeShader()->GetSource());
+  EXPECT_EQ("Cull compute shader", program_->GetComputeShader()->GetLabel());
+  EXPECT_TRUE(program_->GetVertexShader().Get() == NULL);
+  EXPECT_TRUE(program_->GetFragmentShader().Get() == NULL);
+}
+
+TEST_F(ShaderProgramTest, SetCapturedVaryings) {
+  // Check that there are no captured varyings initially.
+  EXPECT_TRUE(program_->GetCapturedVaryings().empty());
+
+  std::vector<std::string> varyings;
+  varyings.push_back("vPosition");
+  varyings.push_back("vVelocity");
+  program_->SetCapturedVaryings(varyings);
+  EXPECT_EQ(varyings, program_->GetCapturedVaryings());
+  EXPECT_TRUE(resource_->TestOnlyModifiedBit(
+      ShaderProgram::kCapturedVaryingsChanged));
+  resource_->ResetModifiedBit(ShaderProgram::kCapturedVaryingsChanged);
+
+  // Setting the same names does not change anything.
+  program_->SetCapturedVaryings(varyings);
+  EXPECT_FALSE(resource_->AnyModifiedBitsSet());
+}
+
 TEST_F(ShaderProgramTest, SetPerThread) {
   base::LogChecker log_checker;
   program_->SetConcurrent(true);
@@ -967,6 +967,86 @@ TEST(StateTable, SetEnforceSettings) {
   EXPECT_FALSE(st->AreSettingsEnforced());
 }
 
+TEST(StateTable, GetHash) {
+  StateTablePtr st1(new StateTable(300, 200));
+  StateTablePtr st2(new StateTable(400, 100));
+  EXPECT_NE(0U, st1->GetHash());
+  // Unset items do not affect the hash.
+  EXPECT_EQ(st1->GetHash(), st2->GetHash());
+
+  st1->SetDepthFunction(StateTable::kDepthLess);
+  st1->Enable(StateTable::kBlend, true);
+  EXPECT_NE(st1->GetHash(), st2->GetHash());
+  st2->Enable(StateTable::kBlend, true);
+  EXPECT_NE(st1->GetHash(), st2->GetHash());
+  st2->SetDepthFunction(StateTable::kDepthGreater);
+  EXPECT_NE(st1->GetHash(), st2->GetHash());
+  st2->SetDepthFunction(StateTable::kDepthLess);
+  EXPECT_EQ(st1->GetHash(), st2->GetHash());
+
+  // Disabling a capability differs from leaving it unset.
+  st1->Enable(StateTable::kCullFace, false);
+  EXPECT_NE(st1->GetHash(), st2->GetHash());
+  st1->ResetCapability(StateTable::kCullFace);
+  EXPECT_EQ(st1->GetHash(), st2->GetHash());
+
+  st2->SetEnforceSettings(true);
+  EXPECT_NE(st1->GetHash(), st2->GetHash());
+  st2->SetEnforceSettings(false);
+  EXPECT_EQ(st1->GetHash(), st2->GetHash());
+
+  // Copying and merging keep the hash consistent with the contents.
+  StateTablePtr st3(new StateTable);
+  st3->CopyFrom(*st1);
+  EXPECT_EQ(st1->GetHash(), st3->GetHash());
+  st3->Reset();
+  EXPECT_NE(st1->GetHash(), st3->GetHash());
+  st3->MergeValuesFrom(*st1, *st1);
+  EXPECT_EQ(st1->GetHash(), st3->GetHash());
+  st3->ResetValue(StateTable::kDepthFunctionValue);
+  EXPECT_NE(st1->GetHash(), st3->GetHash());
+  st3->ResetSetState();
+  st2->Reset();
+  EXPECT_EQ(st2->GetHash(), st3->GetHash());
+  st3->MarkAllSet();
+  EXPECT_NE(st2->GetHash(), st3->GetHash());
+}
+
+TEST(StateTable, AreSetItemsSame) {
+  StateTablePtr st1(new StateTable(300, 200));
+  StateTablePtr st2(new StateTable(400, 100));
+  EXPECT_TRUE(StateTable::AreSetItemsSame(*st1, *st1));
+  // Unset items are ignored.
+  EXPECT_TRUE(StateTable::AreSetItemsSame(*st1, *st2));
+
+  st1->Enable(StateTable::kBlend, true);
+  st1->SetBlendColor(math::Vector4f(0.f, 0.5f, 1.f, 1.f));
+  EXPECT_FALSE(StateTable::AreSetItemsSame(*st1, *st2));
+  st2->Enable(StateTable::kBlend, true);
+  st2->SetBlendColor(math::Vector4f(0.f, 0.5f, 1.f, 0.5f));
+  EXPECT_FALSE(StateTable::AreSetItemsSame(*st1, *st2));
+  st2->SetBlendColor(math::Vector4f(0.f, 0.5f, 1.f, 1.f));
+  EXPECT_TRUE(StateTable::AreSetItemsSame(*st1, *st2));
+
+  // Array values are compared completely.
+  st1->SetColorWriteMasks(true, true, true, false);
+  st2->SetColorWriteMasks(true, true, true, true);
+  EXPECT_FALSE(StateTable::AreSetItemsSame(*st1, *st2));
+  st2->SetColorWriteMasks(true, true, true, false);
+  EXPECT_TRUE(StateTable::AreSetItemsSame(*st1, *st2));
+
+  // The size-dependent viewport only matters once it is set.
+  st1->SetViewport(math::Range2i::BuildWithSize(math::Point2i(0, 0),
+                                                math::Vector2i(300, 200)));
+  EXPECT_FALSE(StateTable::AreSetItemsSame(*st1, *st2));
+  st2->SetViewport(math::Range2i::BuildWithSize(math::Point2i(0, 0),
+                                                math::Vector2i(300, 200)));
+  EXPECT_TRUE(StateTable::AreSetItemsSame(*st1, *st2));
+
+  st2->SetEnforceSettings(true);
+  EXPECT_FALSE(StateTable::AreSetItemsSame(*st1, *st2));
+}
+
 //-----------------------------------------------------------------------------
 //
 // Some macros to make this much clearer and easier to read.
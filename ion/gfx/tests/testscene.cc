@@ -528,7 +528,7 @@ static const NodePtr BuildTestScene() {
   AddShapesToNode(node_with_shapes);
 
   // Add an AttributeArray with one of each attribute type to the first Shape.
-  const base::AllocVector<ShapePtr>& shapes = node_with_shapes->GetShapes();
+  const Node::ShapeVector& shapes = node_with_shapes->GetShapes();
   shapes[0]->SetAttributeArray(CreateAttributeArray(reg_ptr));
 
   // Add one IndexBuffer of each type to the Shapes.
@@ -0,0 +1,41 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfx/transformfeedback.h"
+
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfx {
+
+TEST(TransformFeedbackTest, SetCaptureBuffer) {
+  TransformFeedbackPtr feedback(new TransformFeedback);
+  EXPECT_TRUE(feedback->GetCaptureBuffer().Get() == NULL);
+  EXPECT_FALSE(feedback->IsRasterizerDiscardEnabled());
+
+  BufferObjectPtr buffer(new BufferObject);
+  feedback->SetCaptureBuffer(buffer);
+  EXPECT_EQ(buffer.Get(), feedback->GetCaptureBuffer().Get());
+  feedback->SetRasterizerDiscardEnabled(true);
+  EXPECT_TRUE(feedback->IsRasterizerDiscardEnabled());
+
+  TransformFeedbackPtr feedback2(new TransformFeedback(buffer));
+  EXPECT_EQ(buffer.Get(), feedback2->GetCaptureBuffer().Get());
+}
+
+}  // namespace gfx
+}  // namespace ion
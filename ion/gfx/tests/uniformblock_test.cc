@@ -17,6 +17,14 @@ limitations under the License.
 
 #include "ion/gfx/uniformblock.h"
 
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/texture.h"
+#include "ion/math/matrix.h"
+#include "ion/math/vector.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 namespace ion {
@@ -33,5 +41,109 @@ TEST(UniformBlockTest, SetLabel) {
   EXPECT_EQ("myLabel", block->GetLabel());
 }
 
+TEST(UniformBlockTest, Std140Layout) {
+  base::LogChecker log_checker;
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  UniformBlockPtr block(new UniformBlock);
+
+  // A block without a name has no buffer.
+  block->AddUniform(reg->Create<Uniform>("uFloat", 1.f));
+  EXPECT_FALSE(block->UpdateBuffer().Get());
+  EXPECT_EQ(0U, block->GetBufferSize());
+
+  block->SetBlockName("Block");
+  EXPECT_EQ("Block", block->GetBlockName());
+  block->AddUniform(
+      reg->Create<Uniform>("uVec3", math::Vector3f(2.f, 3.f, 4.f)));
+  block->AddUniform(reg->Create<Uniform>("uInt", 5));
+  block->AddUniform(reg->Create<Uniform>("uMat4", math::Matrix4f::Identity()));
+  const std::vector<float> floats(3U, 6.f);
+  block->AddUniform(reg->CreateArrayUniform("uFloatArray", &floats[0],
+                                            floats.size(),
+                                            base::AllocatorPtr()));
+  block->AddUniform(reg->Create<Uniform>("uVec2", math::Vector2f(7.f, 8.f)));
+  block->AddUniform(reg->Create<Uniform>("uTexture", TexturePtr(new Texture)));
+
+  BufferObjectPtr buffer = block->UpdateBuffer();
+  ASSERT_TRUE(buffer.Get());
+  EXPECT_EQ(BufferObject::kUniformBuffer, buffer->GetTarget());
+  EXPECT_TRUE(log_checker.HasMessage(
+      "WARNING", "'uTexture' cannot be a member of uniform block 'Block'"));
+  EXPECT_EQ(0U, block->GetUniformOffset(0U));
+  EXPECT_EQ(16U, block->GetUniformOffset(1U));
+  EXPECT_EQ(28U, block->GetUniformOffset(2U));
+  EXPECT_EQ(32U, block->GetUniformOffset(3U));
+  EXPECT_EQ(96U, block->GetUniformOffset(4U));
+  EXPECT_EQ(144U, block->GetUniformOffset(5U));
+  EXPECT_EQ(base::kInvalidIndex, block->GetUniformOffset(6U));
+  EXPECT_EQ(base::kInvalidIndex, block->GetUniformOffset(7U));
+  EXPECT_EQ(160U, block->GetBufferSize());
+  EXPECT_EQ(160U, buffer->GetStructSize() * buffer->GetCount());
+  EXPECT_TRUE(buffer->GetSubData().empty());
+
+  const float* data = buffer->GetData()->GetData<float>();
+  EXPECT_EQ(1.f, data[0]);
+  EXPECT_EQ(0.f, data[1]);
+  EXPECT_EQ(2.f, data[4]);
+  EXPECT_EQ(4.f, data[6]);
+  EXPECT_EQ(5, reinterpret_cast<const int*>(data)[7]);
+  // The matrix is stored in column-major order.
+  EXPECT_EQ(1.f, data[8]);
+  EXPECT_EQ(0.f, data[9]);
+  EXPECT_EQ(1.f, data[13]);
+  // Array elements have a stride of 16 bytes.
+  EXPECT_EQ(6.f, data[24]);
+  EXPECT_EQ(0.f, data[25]);
+  EXPECT_EQ(6.f, data[28]);
+  EXPECT_EQ(6.f, data[32]);
+  EXPECT_EQ(7.f, data[36]);
+  EXPECT_EQ(8.f, data[37]);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(UniformBlockTest, UpdateBuffer) {
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry);
+  UniformBlockPtr block(new UniformBlock);
+  block->SetBlockName("Block");
+  block->AddUniform(reg->Create<Uniform>("uFloat", 1.f));
+  block->AddUniform(reg->Create<Uniform>("uVec4", math::Vector4f::Zero()));
+  block->AddUniform(reg->Create<Uniform>("uInt", 2));
+
+  BufferObjectPtr buffer = block->UpdateBuffer();
+  ASSERT_TRUE(buffer.Get());
+  const base::DataContainerPtr container = buffer->GetData();
+  EXPECT_EQ(48U, block->GetBufferSize());
+
+  // Nothing has changed.
+  EXPECT_EQ(buffer, block->UpdateBuffer());
+  EXPECT_TRUE(buffer->GetSubData().empty());
+  EXPECT_EQ(container, buffer->GetData());
+
+  // Changed values are uploaded as a single range.
+  block->SetUniformValue(2U, 3);
+  block->SetUniformValue(1U, math::Vector4f(1.f, 2.f, 3.f, 4.f));
+  EXPECT_EQ(buffer, block->UpdateBuffer());
+  ASSERT_EQ(1U, buffer->GetSubData().size());
+  EXPECT_EQ(math::Range1ui(16U, 36U), buffer->GetSubData()[0].range);
+  const float* sub_data =
+      buffer->GetSubData()[0].data->GetData<float>();
+  EXPECT_EQ(1.f, sub_data[0]);
+  EXPECT_EQ(4.f, sub_data[3]);
+  EXPECT_EQ(3, reinterpret_cast<const int*>(sub_data)[4]);
+  // The buffer's data is kept up to date.
+  EXPECT_EQ(container, buffer->GetData());
+  EXPECT_EQ(3.f, container->GetData<float>()[6]);
+  buffer->ClearSubData();
+
+  // Changing the layout replaces the data.
+  block->AddUniform(reg->Create<Uniform>("uVec2", math::Vector2f(5.f, 6.f)));
+  EXPECT_EQ(buffer, block->UpdateBuffer());
+  EXPECT_TRUE(buffer->GetSubData().empty());
+  EXPECT_NE(container, buffer->GetData());
+  EXPECT_EQ(40U, block->GetUniformOffset(3U));
+  EXPECT_EQ(48U, block->GetBufferSize());
+  EXPECT_EQ(5.f, buffer->GetData()->GetData<float>()[10]);
+}
+
 }  // namespace gfx
 }  // namespace ion
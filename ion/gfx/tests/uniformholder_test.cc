@@ -216,5 +216,46 @@ TEST(UniformHolderTest, AddReplaceSetClearUniforms) {
   EXPECT_EQ(1U, holder.GetUniforms().size());
 }
 
+TEST(UniformHolderTest, UniformHandles) {
+  MyUniformHolder holder;
+  ShaderInputRegistryPtr reg(new ShaderInputRegistry());
+  std::vector<math::Vector3f> vec3fs(2U, math::Vector3f::Zero());
+  holder.AddUniform(reg->Create<Uniform>("myFloat", 1.f));
+  holder.AddUniform(reg->CreateArrayUniform(
+      "myVec3fs", &vec3fs[0], vec3fs.size(), base::AllocatorPtr()));
+
+  // Invalid handles.
+  UniformHandle<float> handle;
+  EXPECT_FALSE(handle.IsValid());
+  EXPECT_EQ(base::kInvalidIndex, handle.GetIndex());
+  EXPECT_FALSE(holder.SetUniformValue(handle, 2.f));
+  EXPECT_FALSE(holder.GetUniformHandle<float>("no_such_name").IsValid());
+  // The uniform holds a float, not an int.
+  EXPECT_FALSE(holder.GetUniformHandle<int>("myFloat").IsValid());
+
+  handle = holder.GetUniformHandle<float>("myFloat");
+  EXPECT_TRUE(handle.IsValid());
+  EXPECT_EQ(0U, handle.GetIndex());
+  EXPECT_TRUE(holder.SetUniformValue(handle, 2.f));
+  EXPECT_EQ(2.f, holder.GetUniforms()[0].GetValue<float>());
+
+  // Array elements.
+  const UniformHandle<math::Vector3f> vec_handle =
+      holder.GetUniformHandle<math::Vector3f>("myVec3fs");
+  EXPECT_TRUE(vec_handle.IsValid());
+  EXPECT_EQ(1U, vec_handle.GetIndex());
+  const math::Vector3f vec(1.f, 2.f, 3.f);
+  EXPECT_TRUE(holder.SetUniformValueAt(vec_handle, 1U, vec));
+  EXPECT_TRUE(math::VectorBase3f::AreValuesEqual(
+      vec, holder.GetUniforms()[1].GetValueAt<math::VectorBase3f>(1)));
+
+  // A handle whose uniform was replaced with one of a different type fails.
+  holder.ReplaceUniform(0U, reg->Create<Uniform>("myInt", 3));
+  EXPECT_FALSE(holder.SetUniformValue(handle, 4.f));
+  EXPECT_EQ(3, holder.GetUniforms()[0].GetValue<int>());
+  holder.ClearUniforms();
+  EXPECT_FALSE(holder.SetUniformValue(handle, 4.f));
+}
+
 }  // namespace gfx
 }  // namespace ion
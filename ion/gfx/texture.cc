@@ -90,7 +90,8 @@ TextureBase::TextureBase(TextureType type)
       immutable_image_(kImmutableImageChanged, ImagePtr(), this),
       immutable_levels_(0),
       multisample_samples_(kMultisampleChanged, 0, this),
-      multisample_fixed_sample_locations_(kMultisampleChanged, true, this) {}
+      multisample_fixed_sample_locations_(kMultisampleChanged, true, this),
+      pixel_buffer_streaming_enabled_(false) {}
 
 TextureBase::~TextureBase() {
   if (Sampler* sampler = sampler_.Get().Get())
@@ -158,6 +158,20 @@ class ION_API TextureBase : public ResourceHolder {
     return multisample_fixed_sample_locations_.Get();
   }
 
+  // Sets/returns whether image data is copied into a pixel unpack buffer and
+  // uploaded from there instead of directly from client memory, which lets
+  // OpenGL transfer it without stalling. This is useful for textures whose
+  // contents change frequently, e.g., video frames. It has no effect if pixel
+  // buffer objects are not supported. This only affects how data is uploaded,
+  // so changing it does not cause an upload. See also
+  // Renderer::kStreamTexturesThroughPixelBuffers. The default is false.
+  void SetPixelBufferStreamingEnabled(bool enabled) {
+    pixel_buffer_streaming_enabled_ = enabled;
+  }
+  bool IsPixelBufferStreamingEnabled() const {
+    return pixel_buffer_streaming_enabled_;
+  }
+
  protected:
   // Internal class that wraps texture data: a single image or a stack of
   // mipmaps, and any sub- or layered data.
@@ -256,6 +270,9 @@ class ION_API TextureBase : public ResourceHolder {
   Field<int> multisample_samples_;
   Field<bool> multisample_fixed_sample_locations_;
 
+  // Whether image data is uploaded through pixel unpack buffers.
+  bool pixel_buffer_streaming_enabled_;
+
   DISALLOW_IMPLICIT_CONSTRUCTORS(TextureBase);
 };
 
@@ -34,11 +34,20 @@ TraceCallExtractor::TraceCallExtractor(const std::string& trace) {
   SetTrace(trace);
 }
 
+TraceCallExtractor::TraceCallExtractor(const BinaryTrace& trace) {
+  SetTrace(trace);
+}
+
 void TraceCallExtractor::SetTrace(const std::string& trace) {
   trace_ = trace;
   CreateCallVector();
 }
 
+void TraceCallExtractor::SetTrace(const BinaryTrace& trace) {
+  trace_.clear();
+  calls_ = trace.GetCalls();
+}
+
 size_t TraceCallExtractor::GetCallCount() const {
   return calls_.size();
 }
@@ -21,6 +21,8 @@ limitations under the License.
 #include <string>
 #include <vector>
 
+#include "ion/gfx/binarytrace.h"
+
 namespace ion {
 namespace gfx {
 
@@ -35,10 +37,15 @@ class TraceCallExtractor {
   TraceCallExtractor();
   // Utility constructor also sets trace string and extracts vector of calls.
   explicit TraceCallExtractor(const std::string& trace);
+  // Utility constructor that extracts the calls recorded by a BinaryTrace.
+  explicit TraceCallExtractor(const BinaryTrace& trace);
   ~TraceCallExtractor() {}
 
   // Sets trace string and extracts vector of calls.
   void SetTrace(const std::string& trace);
+  // Extracts the calls recorded by a BinaryTrace directly, without formatting
+  // and parsing the trace text. The trace string is set to an empty string.
+  void SetTrace(const BinaryTrace& trace);
 
   const std::vector<std::string>& GetCalls() { return calls_; }
 
@@ -21,6 +21,7 @@ limitations under the License.
 
 #include <sstream>
 
+#include "base/macros.h"
 #include "ion/base/stringutils.h"
 #include "ion/portgfx/glheaders.h"
 
@@ -34,6 +35,10 @@ template <typename T>
 const std::string TracingHelper::ToString(const char*, T) {
   return std::string();
 }
+template <typename T>
+const std::string TracingHelper::PointerToString(const char*, size_t, T) {
+  return std::string();
+}
 
 // Specialize for all types.
 template ION_API const std::string TracingHelper::ToString(
@@ -88,10 +93,18 @@ template ION_API const std::string TracingHelper::ToString(
     const char*, void*);
 template ION_API const std::string TracingHelper::ToString(
     const char*, void**);
+template ION_API const std::string TracingHelper::ToString(
+    const char*, const void* const*);
 template ION_API const std::string TracingHelper::ToString(
     const char*, GLsync);
 template ION_API const std::string TracingHelper::ToString(const char*,
                                                            GLDEBUGPROC);
+template ION_API const std::string TracingHelper::PointerToString(
+    const char*, size_t, const float*);
+template ION_API const std::string TracingHelper::PointerToString(
+    const char*, size_t, const int*);
+template ION_API const std::string TracingHelper::PointerToString(
+    const char*, size_t, const void*);
 
 #else
 
@@ -160,6 +173,46 @@ static const std::string GetMapBitsString(GLbitfield mode) {
   return s;
 }
 
+// This is used to convert a GLbitfield used for the glMemoryBarrier() call to
+// a string naming the barriers. Unknown bits are printed in hexadecimal.
+static const std::string GetBarrierBitsString(GLbitfield barriers) {
+  if (barriers == GL_ALL_BARRIER_BITS)
+    return "GL_ALL_BARRIER_BITS";
+  static const struct {
+    GLbitfield bit;
+    const char* name;
+  } kBarrierBits[] = {
+    { GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT,
+      "GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT" },
+    { GL_ELEMENT_ARRAY_BARRIER_BIT, "GL_ELEMENT_ARRAY_BARRIER_BIT" },
+    { GL_UNIFORM_BARRIER_BIT, "GL_UNIFORM_BARRIER_BIT" },
+    { GL_TEXTURE_FETCH_BARRIER_BIT, "GL_TEXTURE_FETCH_BARRIER_BIT" },
+    { GL_SHADER_IMAGE_ACCESS_BARRIER_BIT,
+      "GL_SHADER_IMAGE_ACCESS_BARRIER_BIT" },
+    { GL_COMMAND_BARRIER_BIT, "GL_COMMAND_BARRIER_BIT" },
+    { GL_PIXEL_BUFFER_BARRIER_BIT, "GL_PIXEL_BUFFER_BARRIER_BIT" },
+    { GL_TEXTURE_UPDATE_BARRIER_BIT, "GL_TEXTURE_UPDATE_BARRIER_BIT" },
+    { GL_BUFFER_UPDATE_BARRIER_BIT, "GL_BUFFER_UPDATE_BARRIER_BIT" },
+    { GL_FRAMEBUFFER_BARRIER_BIT, "GL_FRAMEBUFFER_BARRIER_BIT" },
+    { GL_SHADER_STORAGE_BARRIER_BIT, "GL_SHADER_STORAGE_BARRIER_BIT" },
+  };
+  std::string s;
+  for (size_t i = 0; i < arraysize(kBarrierBits); ++i) {
+    if (barriers & kBarrierBits[i].bit) {
+      if (!s.empty())
+        s += " | ";
+      s += kBarrierBits[i].name;
+      barriers &= ~kBarrierBits[i].bit;
+    }
+  }
+  if (barriers) {
+    if (!s.empty())
+      s += " | ";
+    s += AnyToString(barriers);
+  }
+  return s;
+}
+
 // Helper function to print out values from an array-like type. By default this
 // does nothing.
 template <typename T>
@@ -213,6 +266,7 @@ static void IonAddConstantsAToF(
     std::unordered_map<int, std::string>* constants) {
   ION_ADD_CONSTANT(GL_ACTIVE_ATTRIBUTES);
   ION_ADD_CONSTANT(GL_ACTIVE_ATTRIBUTE_MAX_LENGTH);
+  ION_ADD_CONSTANT(GL_ACTIVE_RESOURCES);
   ION_ADD_CONSTANT(GL_ACTIVE_TEXTURE);
   ION_ADD_CONSTANT(GL_ACTIVE_UNIFORMS);
   ION_ADD_CONSTANT(GL_ACTIVE_UNIFORM_MAX_LENGTH);
@@ -222,8 +276,11 @@ static void IonAddConstantsAToF(
   ION_ADD_CONSTANT(GL_ALPHA_BITS);
   ION_ADD_CONSTANT(GL_ALREADY_SIGNALED);
   ION_ADD_CONSTANT(GL_ALWAYS);
+  ION_ADD_CONSTANT(GL_ANY_SAMPLES_PASSED);
+  ION_ADD_CONSTANT(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
   ION_ADD_CONSTANT(GL_ARRAY_BUFFER);
   ION_ADD_CONSTANT(GL_ARRAY_BUFFER_BINDING);
+  ION_ADD_CONSTANT(GL_ARRAY_SIZE);
   ION_ADD_CONSTANT(GL_ATTACHED_SHADERS);
   ION_ADD_CONSTANT(GL_BACK);
   ION_ADD_CONSTANT(GL_BACK_LEFT);
@@ -249,11 +306,13 @@ static void IonAddConstantsAToF(
   ION_ADD_CONSTANT(GL_BYTE);
   ION_ADD_CONSTANT(GL_CCW);
   ION_ADD_CONSTANT(GL_CLAMP_TO_EDGE);
+  ION_ADD_CONSTANT(GL_COLOR);
   ION_ADD_CONSTANT(GL_COLOR_ATTACHMENT0);
   ION_ADD_CONSTANT(GL_COLOR_CLEAR_VALUE);
   ION_ADD_CONSTANT(GL_COLOR_WRITEMASK);
   ION_ADD_CONSTANT(GL_COMPARE_REF_TO_TEXTURE);
   ION_ADD_CONSTANT(GL_COMPILE_STATUS);
+  ION_ADD_CONSTANT(GL_COMPLETION_STATUS_KHR);
   ION_ADD_CONSTANT(GL_COMPRESSED_R11_EAC);
   ION_ADD_CONSTANT(GL_COMPRESSED_RG11_EAC);
   ION_ADD_CONSTANT(GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
@@ -261,6 +320,20 @@ static void IonAddConstantsAToF(
   ION_ADD_CONSTANT(GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2);
   ION_ADD_CONSTANT(GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG);
   ION_ADD_CONSTANT(GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_4x4_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_5x4_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_5x5_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_6x5_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_6x6_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_8x5_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_8x6_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_8x8_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_10x5_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_10x6_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_10x8_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_10x10_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_12x10_KHR);
+  ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_ASTC_12x12_KHR);
   ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG);
   ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG);
   ION_ADD_CONSTANT(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
@@ -273,6 +346,7 @@ static void IonAddConstantsAToF(
   ION_ADD_CONSTANT(GL_COMPRESSED_SRGB8_ETC2);
   ION_ADD_CONSTANT(GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2);
   ION_ADD_CONSTANT(GL_COMPRESSED_TEXTURE_FORMATS);
+  ION_ADD_CONSTANT(GL_COMPUTE_SHADER);
   ION_ADD_CONSTANT(GL_CONDITION_SATISFIED);
   ION_ADD_CONSTANT(GL_CONSTANT_ALPHA);
   ION_ADD_CONSTANT(GL_CONSTANT_COLOR);
@@ -285,6 +359,7 @@ static void IonAddConstantsAToF(
   ION_ADD_CONSTANT(GL_DECR);
   ION_ADD_CONSTANT(GL_DECR_WRAP);
   ION_ADD_CONSTANT(GL_DELETE_STATUS);
+  ION_ADD_CONSTANT(GL_DEPTH);
   ION_ADD_CONSTANT(GL_DEPTH_ATTACHMENT);
   ION_ADD_CONSTANT(GL_DEPTH_BITS);
   ION_ADD_CONSTANT(GL_DEPTH_CLEAR_VALUE);
@@ -299,10 +374,12 @@ static void IonAddConstantsAToF(
   ION_ADD_CONSTANT(GL_DEPTH_WRITEMASK);
   ION_ADD_CONSTANT(GL_DEPTH24_STENCIL8);
   ION_ADD_CONSTANT(GL_DEPTH32F_STENCIL8);
+  ION_ADD_CONSTANT(GL_DISPATCH_INDIRECT_BUFFER);
   ION_ADD_CONSTANT(GL_DITHER);
   ION_ADD_CONSTANT(GL_DONT_CARE);
   ION_ADD_CONSTANT(GL_DRAW_BUFFER);
   ION_ADD_CONSTANT(GL_DRAW_FRAMEBUFFER);
+  ION_ADD_CONSTANT(GL_DRAW_INDIRECT_BUFFER);
   // GL_DRAW_FRAMEBUFFER_BINDING is the same was GL_FRAMEBUFFER_BINDING
   // ION_ADD_CONSTANT(GL_DRAW_FRAMEBUFFER_BINDING);
   ION_ADD_CONSTANT(GL_DST_ALPHA);
@@ -389,6 +466,7 @@ static void IonAddConstantsGToQ(
   ION_ADD_CONSTANT(GL_LINE_STRIP);
   ION_ADD_CONSTANT(GL_LINE_WIDTH);
   ION_ADD_CONSTANT(GL_LINK_STATUS);
+  ION_ADD_CONSTANT(GL_LOCATION);
   ION_ADD_CONSTANT(GL_LOW_FLOAT);
   ION_ADD_CONSTANT(GL_LOW_INT);
   ION_ADD_CONSTANT(GL_LUMINANCE);
@@ -396,9 +474,11 @@ static void IonAddConstantsGToQ(
   ION_ADD_CONSTANT(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS);
   ION_ADD_CONSTANT(GL_MAX_CUBE_MAP_TEXTURE_SIZE);
   ION_ADD_CONSTANT(GL_MAX_FRAGMENT_UNIFORM_VECTORS);
+  ION_ADD_CONSTANT(GL_MAX_NAME_LENGTH);
   ION_ADD_CONSTANT(GL_MAX_RENDERBUFFER_SIZE);
   ION_ADD_CONSTANT(GL_MAX_SAMPLE_MASK_WORDS);
   ION_ADD_CONSTANT(GL_MAX_SERVER_WAIT_TIMEOUT);
+  ION_ADD_CONSTANT(GL_MAX_SHADER_COMPILER_THREADS_KHR);
   ION_ADD_CONSTANT(GL_MAX_TEXTURE_IMAGE_UNITS);
   ION_ADD_CONSTANT(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT);
   ION_ADD_CONSTANT(GL_MAX_TEXTURE_SIZE);
@@ -406,6 +486,8 @@ static void IonAddConstantsGToQ(
   ION_ADD_CONSTANT(GL_MAX_TRANSFORM_FEEDBACK_INTERLEAVED_COMPONENTS);
   ION_ADD_CONSTANT(GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_ATTRIBS);
   ION_ADD_CONSTANT(GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS);
+  ION_ADD_CONSTANT(GL_MAX_UNIFORM_BLOCK_SIZE);
+  ION_ADD_CONSTANT(GL_MAX_UNIFORM_BUFFER_BINDINGS);
   ION_ADD_CONSTANT(GL_MAX_VARYING_VECTORS);
   ION_ADD_CONSTANT(GL_MAX_VERTEX_ATTRIBS);
   ION_ADD_CONSTANT(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS);
@@ -425,6 +507,7 @@ static void IonAddConstantsGToQ(
   ION_ADD_CONSTANT(GL_NO_ERROR);
   ION_ADD_CONSTANT(GL_NUM_COMPRESSED_TEXTURE_FORMATS);
   ION_ADD_CONSTANT(GL_NUM_EXTENSIONS);
+  ION_ADD_CONSTANT(GL_NUM_PROGRAM_BINARY_FORMATS);
   ION_ADD_CONSTANT(GL_NUM_SHADER_BINARY_FORMATS);
   ION_ADD_CONSTANT(GL_OBJECT_TYPE);
   // ION_ADD_CONSTANT(GL_ONE);
@@ -446,6 +529,10 @@ static void IonAddConstantsGToQ(
   ION_ADD_CONSTANT(GL_PALETTE8_RGB8_OES);
   ION_ADD_CONSTANT(GL_PALETTE8_RGBA4_OES);
   ION_ADD_CONSTANT(GL_PALETTE8_RGBA8_OES);
+  ION_ADD_CONSTANT(GL_PIXEL_PACK_BUFFER);
+  ION_ADD_CONSTANT(GL_PIXEL_PACK_BUFFER_BINDING);
+  ION_ADD_CONSTANT(GL_PIXEL_UNPACK_BUFFER);
+  ION_ADD_CONSTANT(GL_PIXEL_UNPACK_BUFFER_BINDING);
   ION_ADD_CONSTANT(GL_POINTS);
   ION_ADD_CONSTANT(GL_POINT_SIZE_RANGE);
   ION_ADD_CONSTANT(GL_POINT_SPRITE);
@@ -453,12 +540,17 @@ static void IonAddConstantsGToQ(
   ION_ADD_CONSTANT(GL_POLYGON_OFFSET_FILL);
   ION_ADD_CONSTANT(GL_POLYGON_OFFSET_UNITS);
   ION_ADD_CONSTANT(GL_PRIMITIVES_GENERATED);
+  ION_ADD_CONSTANT(GL_PROGRAM_BINARY_FORMATS);
+  ION_ADD_CONSTANT(GL_PROGRAM_BINARY_LENGTH);
+  ION_ADD_CONSTANT(GL_PROGRAM_BINARY_RETRIEVABLE_HINT);
   ION_ADD_CONSTANT(GL_PROGRAM_OBJECT);
   ION_ADD_CONSTANT(GL_PROGRAM_PIPELINE);
   ION_ADD_CONSTANT(GL_PROGRAM_PIPELINE_OBJECT);
   ION_ADD_CONSTANT(GL_PROGRAM_POINT_SIZE);
   ION_ADD_CONSTANT(GL_QUERY);
+  ION_ADD_CONSTANT(GL_QUERY_NO_WAIT);
   ION_ADD_CONSTANT(GL_QUERY_OBJECT);
+  ION_ADD_CONSTANT(GL_QUERY_WAIT);
 }
 
 static void IonAddConstantsRToS(
@@ -559,6 +651,7 @@ static void IonAddConstantsRToS(
   ION_ADD_CONSTANT(GL_SAMPLER_CUBE_SHADOW);
   ION_ADD_CONSTANT(GL_SAMPLER_EXTERNAL_OES);
   ION_ADD_CONSTANT(GL_SAMPLES);
+  ION_ADD_CONSTANT(GL_SAMPLES_PASSED);
   ION_ADD_CONSTANT(GL_SAMPLE_ALPHA_TO_COVERAGE);
   ION_ADD_CONSTANT(GL_SAMPLE_BUFFERS);
   ION_ADD_CONSTANT(GL_SAMPLE_COVERAGE);
@@ -572,6 +665,7 @@ static void IonAddConstantsRToS(
   ION_ADD_CONSTANT(GL_SHADER_COMPILER);
   ION_ADD_CONSTANT(GL_SHADER_OBJECT);
   ION_ADD_CONSTANT(GL_SHADER_SOURCE_LENGTH);
+  ION_ADD_CONSTANT(GL_SHADER_STORAGE_BUFFER);
   ION_ADD_CONSTANT(GL_SHADER_TYPE);
   ION_ADD_CONSTANT(GL_SHADING_LANGUAGE_VERSION);
   ION_ADD_CONSTANT(GL_SHORT);
@@ -603,6 +697,7 @@ static void IonAddConstantsRToS(
   ION_ADD_CONSTANT(GL_STENCIL_VALUE_MASK);
   ION_ADD_CONSTANT(GL_STENCIL_WRITEMASK);
   ION_ADD_CONSTANT(GL_STREAM_DRAW);
+  ION_ADD_CONSTANT(GL_STREAM_READ);
   ION_ADD_CONSTANT(GL_SUBPIXEL_BITS);
   ION_ADD_CONSTANT(GL_SYNC_CONDITION);
   ION_ADD_CONSTANT(GL_SYNC_FENCE);
@@ -706,6 +801,14 @@ static void IonAddConstantsTToZ(
   ION_ADD_CONSTANT(GL_TRIANGLES);
   ION_ADD_CONSTANT(GL_TRIANGLE_FAN);
   ION_ADD_CONSTANT(GL_TRIANGLE_STRIP);
+  ION_ADD_CONSTANT(GL_TYPE);
+  ION_ADD_CONSTANT(GL_UNIFORM);
+  ION_ADD_CONSTANT(GL_UNIFORM_BLOCK_BINDING);
+  ION_ADD_CONSTANT(GL_UNIFORM_BLOCK_DATA_SIZE);
+  ION_ADD_CONSTANT(GL_UNIFORM_BLOCK_NAME_LENGTH);
+  ION_ADD_CONSTANT(GL_UNIFORM_BUFFER);
+  ION_ADD_CONSTANT(GL_UNIFORM_BUFFER_BINDING);
+  ION_ADD_CONSTANT(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT);
   ION_ADD_CONSTANT(GL_UNPACK_ALIGNMENT);
   ION_ADD_CONSTANT(GL_UNSIGNALED);
   ION_ADD_CONSTANT(GL_UNSIGNED_BYTE);
@@ -765,21 +868,25 @@ const std::string TracingHelper::ToString(const char* arg_type, T arg) {
   const std::string arg_type_str(arg_type);
   if (arg_type_str.find('*') != std::string::npos ||
       arg_type_str.find("PROC") != std::string::npos) {
-    if (arg != static_cast<T>(0)) {
-      std::ostringstream out;
-      out << "0x" << std::hex << *reinterpret_cast<size_t*>(&arg);
-
-      // If the pointer type is a known type then we can print more deeply.
-      out << ArrayToString(arg_type, arg);
-      return out.str();
-    } else {
-      return "NULL";
-    }
+    return PointerToString(arg_type, *reinterpret_cast<size_t*>(&arg), arg);
   }
 
   return AnyToString(arg);
 }
 
+template <typename T>
+const std::string TracingHelper::PointerToString(const char* arg_type,
+                                                 size_t address, T values) {
+  if (!address)
+    return "NULL";
+  std::ostringstream out;
+  out << "0x" << std::hex << address;
+
+  // If the pointer type is a known type then we can print more deeply.
+  out << ArrayToString(arg_type, values);
+  return out.str();
+}
+
 // Specialize to add quotes around strings.
 template <> ION_API
 const std::string TracingHelper::ToString(const char* arg_type,
@@ -891,6 +998,11 @@ const std::string TracingHelper::ToString(const char* arg_type,
     const std::string s = GetClearBitsString(arg);
     if (!s.empty())
       return s;
+  } else if (!strcmp(arg_type, "GLbarrierbits")) {
+    // GLbarrierbits is used for glMemoryBarrier().
+    const std::string s = GetBarrierBitsString(arg);
+    if (!s.empty())
+      return s;
   } else if (!strcmp(arg_type, "GLmapaccess")) {
     // GLmapaccess is used for glMapBufferRange().
     const std::string s = GetMapBitsString(arg);
@@ -946,10 +1058,18 @@ template ION_API const std::string TracingHelper::ToString(
     const char*, void*);
 template ION_API const std::string TracingHelper::ToString(
     const char*, void**);
+template ION_API const std::string TracingHelper::ToString(
+    const char*, const void* const*);
 template ION_API const std::string TracingHelper::ToString(
     const char*, GLsync);
 template ION_API const std::string TracingHelper::ToString(const char*,
                                                            GLDEBUGPROC);
+template ION_API const std::string TracingHelper::PointerToString(
+    const char*, size_t, const float*);
+template ION_API const std::string TracingHelper::PointerToString(
+    const char*, size_t, const int*);
+template ION_API const std::string TracingHelper::PointerToString(
+    const char*, size_t, const void*);
 
 #endif  // ION_PRODUCTION
 
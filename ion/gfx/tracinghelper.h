@@ -38,6 +38,13 @@ class ION_API TracingHelper {
   // quoting strings, replacing numbers with names, etc..
   template <typename T> const std::string ToString(const char* arg_type, T arg);
 
+  // Returns what ToString() returns for a pointer of type T with the passed
+  // address, reading any values it prints from |values| instead. This lets a
+  // BinaryTrace format pointers whose data it copied when the call was made.
+  template <typename T>
+  const std::string PointerToString(const char* arg_type, size_t address,
+                                    T values);
+
  private:
   // Indexed vector mapping OpenGL constant values to constant names.
   std::unordered_map<int, std::string> constants_;
@@ -0,0 +1,77 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFX_TRANSFORMFEEDBACK_H_
+#define ION_GFX_TRANSFORMFEEDBACK_H_
+
+#include "ion/base/referent.h"
+#include "ion/gfx/bufferobject.h"
+
+namespace ion {
+namespace gfx {
+
+// Convenience typedef for shared pointer to a TransformFeedback.
+class TransformFeedback;
+typedef base::ReferentPtr<TransformFeedback>::Type TransformFeedbackPtr;
+
+// A TransformFeedback describes where the Renderer writes the outputs of the
+// vertex shader while transform feedback is active; see
+// Renderer::BeginTransformFeedback(). The outputs named by the ShaderProgram's
+// captured varyings are written interleaved, one struct per vertex, into the
+// capture BufferObject, which can then be used as the source of vertex
+// attributes without the data ever reaching the CPU. Simulations such as
+// particle systems typically keep two buffers and swap them every step, so
+// that each step reads the state written by the previous one.
+//
+// The capture buffer must have been given data (possibly uninitialized) large
+// enough for all captured vertices, since transform feedback never resizes it.
+class ION_API TransformFeedback : public base::Referent {
+ public:
+  TransformFeedback();
+  explicit TransformFeedback(const BufferObjectPtr& capture_buffer);
+
+  // Sets/returns the BufferObject that captured vertices are written into.
+  void SetCaptureBuffer(const BufferObjectPtr& buffer) {
+    capture_buffer_ = buffer;
+  }
+  const BufferObjectPtr& GetCaptureBuffer() const { return capture_buffer_; }
+
+  // Sets/returns whether primitives are discarded after their vertices are
+  // captured, so that nothing is drawn into the framebuffer. This is what a
+  // simulation step that only updates buffers wants. The default is false,
+  // mirroring OpenGL.
+  void SetRasterizerDiscardEnabled(bool enabled) {
+    rasterizer_discard_enabled_ = enabled;
+  }
+  bool IsRasterizerDiscardEnabled() const {
+    return rasterizer_discard_enabled_;
+  }
+
+ protected:
+  // The destructor is protected because all base::Referent classes must have
+  // protected or private destructors.
+  ~TransformFeedback() override;
+
+ private:
+  BufferObjectPtr capture_buffer_;
+  bool rasterizer_discard_enabled_;
+};
+
+}  // namespace gfx
+}  // namespace ion
+
+#endif  // ION_GFX_TRANSFORMFEEDBACK_H_
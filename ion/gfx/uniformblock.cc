@@ -17,12 +17,264 @@ limitations under the License.
 
 #include "ion/gfx/uniformblock.h"
 
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+
+#include "ion/base/invalid.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
 namespace ion {
 namespace gfx {
 
-UniformBlock::UniformBlock() : UniformHolder(GetAllocator()) {}
+namespace {
+
+// A BufferObject bound to the uniform buffer target.
+class UniformBufferObject : public BufferObject {
+ public:
+  UniformBufferObject() : BufferObject(kUniformBuffer) {}
+
+ protected:
+  ~UniformBufferObject() override {}
+};
+
+// The std140 base alignment of vec4s, array elements, and matrix columns.
+static const size_t kVec4Alignment = 16U;
+
+static size_t RoundUp(size_t value, size_t alignment) {
+  return (value + alignment - 1U) / alignment * alignment;
+}
+
+// Returns the std140 base alignment and size in bytes of a single value of the
+// passed type, or false if the type cannot be a block member.
+static bool GetStd140Layout(UniformType type, size_t* alignment,
+                            size_t* size) {
+  switch (type) {
+    case kFloatUniform:
+    case kIntUniform:
+    case kUnsignedIntUniform:
+      *alignment = *size = 4U;
+      return true;
+    case kFloatVector2Uniform:
+    case kIntVector2Uniform:
+    case kUnsignedIntVector2Uniform:
+      *alignment = *size = 8U;
+      return true;
+    case kFloatVector3Uniform:
+    case kIntVector3Uniform:
+    case kUnsignedIntVector3Uniform:
+      *alignment = kVec4Alignment;
+      *size = 12U;
+      return true;
+    case kFloatVector4Uniform:
+    case kIntVector4Uniform:
+    case kUnsignedIntVector4Uniform:
+      *alignment = *size = kVec4Alignment;
+      return true;
+    // Matrices are stored as arrays of column vectors.
+    case kMatrix2x2Uniform:
+      *alignment = kVec4Alignment;
+      *size = 2U * kVec4Alignment;
+      return true;
+    case kMatrix3x3Uniform:
+      *alignment = kVec4Alignment;
+      *size = 3U * kVec4Alignment;
+      return true;
+    case kMatrix4x4Uniform:
+      *alignment = kVec4Alignment;
+      *size = 4U * kVec4Alignment;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Writes a matrix in column-major order, with each column aligned to a vec4.
+template <int Dimension>
+static void WriteMatrix(const math::Matrix<Dimension, float>& m, uint8* data) {
+  for (int col = 0; col < Dimension; ++col) {
+    float* column = reinterpret_cast<float*>(data + col * kVec4Alignment);
+    for (int row = 0; row < Dimension; ++row)
+      column[row] = m(row, col);
+  }
+}
+
+// Writes the value of a uniform, or of an element of an array uniform, of type
+// T.
+template <typename T>
+static void WriteValue(const Uniform& uniform, size_t count, size_t stride,
+                       uint8* data) {
+  if (count) {
+    for (size_t i = 0; i < count; ++i)
+      memcpy(data + i * stride, &uniform.GetValueAt<T>(i), sizeof(T));
+  } else {
+    memcpy(data, &uniform.GetValue<T>(), sizeof(T));
+  }
+}
+
+template <int Dimension>
+static void WriteMatrixValue(const Uniform& uniform, size_t count,
+                             size_t stride, uint8* data) {
+  typedef math::Matrix<Dimension, float> MatrixType;
+  if (count) {
+    for (size_t i = 0; i < count; ++i)
+      WriteMatrix(uniform.GetValueAt<MatrixType>(i), data + i * stride);
+  } else {
+    WriteMatrix(uniform.GetValue<MatrixType>(), data);
+  }
+}
+
+// Writes the std140 representation of the passed uniform's value(s).
+static void WriteUniform(const Uniform& uniform, size_t stride, uint8* data) {
+  const size_t count = uniform.GetCount();
+  switch (uniform.GetType()) {
+    case kFloatUniform:
+      WriteValue<float>(uniform, count, stride, data);
+      break;
+    case kIntUniform:
+      WriteValue<int>(uniform, count, stride, data);
+      break;
+    case kUnsignedIntUniform:
+      WriteValue<uint32>(uniform, count, stride, data);
+      break;
+    case kFloatVector2Uniform:
+      WriteValue<math::VectorBase2f>(uniform, count, stride, data);
+      break;
+    case kFloatVector3Uniform:
+      WriteValue<math::VectorBase3f>(uniform, count, stride, data);
+      break;
+    case kFloatVector4Uniform:
+      WriteValue<math::VectorBase4f>(uniform, count, stride, data);
+      break;
+    case kIntVector2Uniform:
+      WriteValue<math::VectorBase2i>(uniform, count, stride, data);
+      break;
+    case kIntVector3Uniform:
+      WriteValue<math::VectorBase3i>(uniform, count, stride, data);
+      break;
+    case kIntVector4Uniform:
+      WriteValue<math::VectorBase4i>(uniform, count, stride, data);
+      break;
+    case kUnsignedIntVector2Uniform:
+      WriteValue<math::VectorBase2ui>(uniform, count, stride, data);
+      break;
+    case kUnsignedIntVector3Uniform:
+      WriteValue<math::VectorBase3ui>(uniform, count, stride, data);
+      break;
+    case kUnsignedIntVector4Uniform:
+      WriteValue<math::VectorBase4ui>(uniform, count, stride, data);
+      break;
+    case kMatrix2x2Uniform:
+      WriteMatrixValue<2>(uniform, count, stride, data);
+      break;
+    case kMatrix3x3Uniform:
+      WriteMatrixValue<3>(uniform, count, stride, data);
+      break;
+    case kMatrix4x4Uniform:
+      WriteMatrixValue<4>(uniform, count, stride, data);
+      break;
+    default:
+      break;
+  }
+}
+
+}  // anonymous namespace
+
+UniformBlock::UniformBlock()
+    : UniformHolder(GetAllocator()),
+      offsets_(*this),
+      stamps_(*this),
+      data_(NULL),
+      buffer_size_(0U) {}
 
 UniformBlock::~UniformBlock() {}
 
+BufferObjectPtr UniformBlock::UpdateBuffer() {
+  if (block_name_.empty())
+    return BufferObjectPtr();
+
+  // Compute the std140 layout of the block, finding the range of bytes whose
+  // values have changed. Since the layout is recomputed in order, any change
+  // to it invalidates all of the following offsets.
+  const base::AllocVector<Uniform>& uniforms = GetUniforms();
+  const size_t num_uniforms = uniforms.size();
+  bool layout_changed = offsets_.size() != num_uniforms;
+  offsets_.resize(num_uniforms, base::kInvalidIndex);
+  stamps_.resize(num_uniforms, 0U);
+  size_t offset = 0U;
+  size_t dirty_begin = base::kInvalidIndex;
+  size_t dirty_end = 0U;
+  for (size_t i = 0; i < num_uniforms; ++i) {
+    const Uniform& uniform = uniforms[i];
+    size_t alignment = 0U;
+    size_t size = 0U;
+    size_t member_offset = base::kInvalidIndex;
+    if (GetStd140Layout(uniform.GetType(), &alignment, &size)) {
+      // Array elements are aligned to vec4s.
+      if (const size_t count = uniform.GetCount()) {
+        alignment = kVec4Alignment;
+        size = RoundUp(size, kVec4Alignment) * count;
+      }
+      member_offset = offset = RoundUp(offset, alignment);
+    } else if (offsets_[i] != base::kInvalidIndex || layout_changed) {
+      LOG(WARNING) << "***ION: Uniform '"
+                   << ShaderInputRegistry::GetSpec(uniform)->name
+                   << "' cannot be a member of uniform block '" << block_name_
+                   << "'";
+    }
+    if (offsets_[i] != member_offset) {
+      offsets_[i] = member_offset;
+      layout_changed = true;
+    }
+    if (size && (layout_changed || stamps_[i] != uniform.GetStamp())) {
+      dirty_begin = std::min(dirty_begin, offset);
+      dirty_end = offset + size;
+    }
+    stamps_[i] = uniform.GetStamp();
+    offset += size;
+  }
+  const size_t buffer_size = RoundUp(offset, kVec4Alignment);
+
+  if (!buffer_.Get())
+    buffer_.Reset(new (GetAllocator()) UniformBufferObject);
+  if (layout_changed || buffer_size != buffer_size_ || !data_) {
+    // Replace the buffer's data with a new container that is updated in place.
+    buffer_size_ = buffer_size;
+    base::DataContainerPtr container =
+        base::DataContainer::CreateOverAllocated<uint8>(
+            std::max(buffer_size, kVec4Alignment), NULL, GetAllocator());
+    data_ = container->GetMutableData<uint8>();
+    memset(data_, 0, std::max(buffer_size, kVec4Alignment));
+    for (size_t i = 0; i < num_uniforms; ++i) {
+      if (offsets_[i] != base::kInvalidIndex)
+        WriteUniform(uniforms[i], kVec4Alignment, data_ + offsets_[i]);
+    }
+    buffer_->SetData(container, std::max(buffer_size, kVec4Alignment), 1U,
+                     BufferObject::kDynamicDraw);
+  } else if (dirty_begin < dirty_end) {
+    // Write the changed values and upload them as a single range.
+    for (size_t i = 0; i < num_uniforms; ++i) {
+      if (offsets_[i] != base::kInvalidIndex && offsets_[i] >= dirty_begin &&
+          offsets_[i] < dirty_end)
+        WriteUniform(uniforms[i], kVec4Alignment, data_ + offsets_[i]);
+    }
+    buffer_->SetSubData(
+        math::Range1ui(static_cast<uint32>(dirty_begin),
+                       static_cast<uint32>(dirty_end)),
+        base::DataContainer::CreateAndCopy<uint8>(
+            data_ + dirty_begin, dirty_end - dirty_begin, true,
+            GetAllocator()));
+  }
+  return buffer_;
+}
+
+size_t UniformBlock::GetUniformOffset(size_t index) const {
+  return index < offsets_.size() ? offsets_[index] : base::kInvalidIndex;
+}
+
 }  // namespace gfx
 }  // namespace ion
@@ -18,6 +18,11 @@ limitations under the License.
 #ifndef ION_GFX_UNIFORMBLOCK_H_
 #define ION_GFX_UNIFORMBLOCK_H_
 
+#include <string>
+
+#include "base/integral_types.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/bufferobject.h"
 #include "ion/gfx/resourceholder.h"
 #include "ion/gfx/uniformholder.h"
 
@@ -30,12 +35,12 @@ namespace gfx {
 // a _copy_ of the instance; to modify a uniform value use ReplaceUniform() or
 // SetUniformValue[At]().
 //
-// TODO(user): Actually support the following text in Ion. In OpenGL
-// 3.1+/ES3+, UniformBlocks also share the same storage buffer object, even
-// across multiple shader programs; simplifying the sending of uniform values to
-// GL for multiple programs. This can vastly increase the speed of switching
-// large sets of uniforms at once since the cost is only the const of a single
-// value change.
+// In OpenGL 3.1+/ES3+, a UniformBlock with a block name is backed by a uniform
+// buffer object that holds the values of all of its Uniforms, even across
+// multiple shader programs. The Renderer uploads only the values that have
+// changed since the block was last drawn, with a single glBufferSubData(), and
+// binds the buffer to each program's uniform block of the same name with
+// glBindBufferRange(), instead of sending each Uniform to each program.
 class ION_API UniformBlock : public ResourceHolder, public UniformHolder {
  public:
   // Changes that affect this resource.
@@ -43,15 +48,51 @@ class ION_API UniformBlock : public ResourceHolder, public UniformHolder {
     kNumChanges = kNumBaseChanges,
   };
 
-  // TODO(user): Support interface blocks and buffer-backed UniformBlocks;
-  // make UniformBlocks require a block name and possibly require a BufferObject
-  // in the constructor.
   UniformBlock();
 
+  // Sets/returns the name of the GLSL uniform block that this UniformBlock
+  // backs. If the name is empty (the default) or uniform buffer objects are
+  // not supported, the Renderer sends each of the block's Uniforms to each
+  // program as usual. Otherwise, the shaders must declare the block with
+  // layout(std140) and members in the order and of the types of the Uniforms
+  // that were added to this, and programs that do not declare the block do
+  // not receive its values. Texture Uniforms cannot be members of a uniform
+  // block and are ignored.
+  void SetBlockName(const std::string& name) { block_name_ = name; }
+  const std::string& GetBlockName() const { return block_name_; }
+
+  // Packs the values of the Uniforms into the block's BufferObject using the
+  // std140 layout, creating the buffer if necessary, and returns it. Only
+  // values that have changed since the last call are written, and are passed
+  // to the BufferObject as a single sub-data range. If the layout of the block
+  // has changed, the buffer's data is replaced instead. Returns a NULL pointer
+  // if the block has no name. This is called by the Renderer; it is normally
+  // not necessary to call it directly.
+  BufferObjectPtr UpdateBuffer();
+
+  // Returns the std140 byte offset of the Uniform at the passed index within
+  // the block as of the last call to UpdateBuffer(), or base::kInvalidIndex if
+  // the index is invalid or the Uniform has a texture type.
+  size_t GetUniformOffset(size_t index) const;
+  // Returns the size of the block in bytes as of the last call to
+  // UpdateBuffer().
+  size_t GetBufferSize() const { return buffer_size_; }
+
  protected:
   // The destructor is protected because all base::Referent classes must have
   // protected or private destructors.
   ~UniformBlock() override;
+
+ private:
+  std::string block_name_;
+  BufferObjectPtr buffer_;
+  // The std140 offsets and the stamps of the Uniforms when they were last
+  // packed.
+  base::AllocVector<size_t> offsets_;
+  base::AllocVector<uint64> stamps_;
+  // The data of the buffer's DataContainer, which is updated in place.
+  uint8* data_;
+  size_t buffer_size_;
 };
 
 // Convenience typedef for shared pointer to a UniformBlock.
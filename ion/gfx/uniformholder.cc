@@ -28,12 +28,17 @@ UniformHolder::UniformHolder(const base::AllocatorPtr& alloc)
 UniformHolder::~UniformHolder() {}
 
 size_t UniformHolder::GetUniformIndex(const std::string& name) const {
+  // Compare interned names rather than strings. A name that was never
+  // interned cannot be the name of any uniform.
+  const size_t name_id = ShaderInputRegistry::FindNameId(name);
+  if (name_id == base::kInvalidIndex)
+    return base::kInvalidIndex;
   const size_t uniform_count = uniforms_.size();
   for (size_t i = 0; i < uniform_count; ++i) {
     const Uniform& u = uniforms_[i];
     DCHECK(u.IsValid());
-    if (name ==
-        u.GetRegistry().GetSpecs<Uniform>()[u.GetIndexInRegistry()].name)
+    if (name_id ==
+        u.GetRegistry().GetSpecs<Uniform>()[u.GetIndexInRegistry()].name_id)
       return i;
   }
   return base::kInvalidIndex;
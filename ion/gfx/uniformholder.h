@@ -23,11 +23,39 @@ limitations under the License.
 #include "ion/base/allocatable.h"
 #include "ion/base/invalid.h"
 #include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/varianttyperesolver.h"
 #include "ion/gfx/uniform.h"
 
 namespace ion {
 namespace gfx {
 
+// A UniformHandle refers to a Uniform in a UniformHolder whose values have
+// type T. It is obtained by name from the holder once with GetUniformHandle(),
+// and then passed to the holder's SetUniformValue[At]() functions to set the
+// Uniform's value without looking up its name. Since the handle is typed,
+// passing a value of the wrong type fails to compile. Like the index returned
+// by UniformHolder::AddUniform(), a handle is invalid after ClearUniforms() or
+// RemoveUniformByName() is called on its holder.
+template <typename T> class UniformHandle {
+ public:
+  // The default constructor creates an invalid handle.
+  UniformHandle() : index_(base::kInvalidIndex) {}
+
+  // Returns whether the handle refers to a Uniform.
+  bool IsValid() const { return index_ != base::kInvalidIndex; }
+
+  // Returns the index of the Uniform in its holder, or base::kInvalidIndex if
+  // the handle is invalid.
+  size_t GetIndex() const { return index_; }
+
+ private:
+  explicit UniformHandle(size_t index) : index_(index) {}
+
+  size_t index_;
+
+  friend class UniformHolder;
+};
+
 // A UniformHolder is a base class for an object that holds Uniforms. Note that
 // adding a Uniform adds a _copy_ of the instance; to modify a uniform value use
 // ReplaceUniform() or SetUniformValue[At]().
@@ -100,6 +128,34 @@ class ION_API UniformHolder {
     return false;
   }
 
+  // Returns a handle to the uniform in this with the given name, for setting
+  // values of type T. The handle is invalid if there is no such uniform or
+  // the uniform does not hold values of type T. Since this looks up the name,
+  // it should be called once, and the handle reused to set values.
+  template <typename T>
+  const UniformHandle<T> GetUniformHandle(const std::string& name) const {
+    typedef typename base::VariantTypeResolver<UniformValueType, T>::Type
+        StoredType;
+    const size_t index = GetUniformIndex(name);
+    if (index != base::kInvalidIndex &&
+        uniforms_[index].GetType() == Uniform::GetTypeByValue<StoredType>())
+      return UniformHandle<T>(index);
+    return UniformHandle<T>();
+  }
+
+  // Sets the value or element value of the uniform referred to by a handle.
+  // Returns false if the handle is invalid, or if it no longer refers to a
+  // uniform holding values of type T.
+  template <typename T>
+  bool SetUniformValue(const UniformHandle<T>& handle, const T& value) {
+    return SetUniformValue<T>(handle.index_, value);
+  }
+  template <typename T>
+  bool SetUniformValueAt(const UniformHandle<T>& handle, size_t array_index,
+                         const T& value) {
+    return SetUniformValueAt<T>(handle.index_, array_index, value);
+  }
+
   // Returns the index of the uniform this with the given name, if it exists.
   // The Uniform must have been added with AddUniform() or ReplaceUniform(). If
   // no uniform with the name exists in this then returns
@@ -134,7 +190,12 @@ class ION_API UniformHolder {
   // Enables or disables the UniformHolder. Disabled holders are skipped over
   // during rendering; their values are not sent to OpenGL. UniformHolders are
   // enabled by default.
-  void Enable(bool enable) { is_enabled_ = enable; }
+  void Enable(bool enable) {
+    if (enable != is_enabled_) {
+      is_enabled_ = enable;
+      OnEnabledChanged();
+    }
+  }
   bool IsEnabled() const { return is_enabled_; }
 
  protected:
@@ -146,6 +207,10 @@ class ION_API UniformHolder {
   // protected or private destructors.
   virtual ~UniformHolder();
 
+  // Called by Enable() when the holder is enabled or disabled, so that derived
+  // classes can react to the change however the holder is accessed.
+  virtual void OnEnabledChanged() {}
+
  private:
   bool is_enabled_;
   base::AllocVector<Uniform> uniforms_;
@@ -32,13 +32,18 @@
       'sources': [
         'gpuprofiler.cc',
         'gpuprofiler.h',
+        'performancehud.cc',
+        'performancehud.h',
       ],
       'dependencies': [
         '<(ion_dir)/base/base.gyp:ionbase',
         '<(ion_dir)/port/port.gyp:ionport',
         '<(ion_dir)/profile/profile.gyp:ionprofile',
         '../gfx/gfx.gyp:graphicsmanager',
+        '../gfx/gfx.gyp:iongfx',  # For Renderer::NodeGpuTimes.
+        '../gfxutils/gfxutils.gyp:iongfxutils',
         '../portgfx/portgfx.gyp:ionportgfx',
+        '../text/text.gyp:iontext',
       ],
     },  # target: iongfxprofile
   ],
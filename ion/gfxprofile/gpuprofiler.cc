@@ -17,6 +17,12 @@ limitations under the License.
 
 #include "ion/gfxprofile/gpuprofiler.h"
 
+#include <chrono>  // NOLINT
+#include <string>
+
+#include "ion/base/serialize.h"
+#include "ion/base/stringutils.h"
+#include "ion/port/timer.h"
 #include "ion/profile/calltracemanager.h"
 #include "ion/profile/tracerecorder.h"
 
@@ -239,5 +245,81 @@ void GpuProfiler::PollGlTimerQueries() {
   }
 }
 
+void GpuProfiler::AddNodeGpuTimes(const gfx::Renderer::NodeGpuTimes& times) {
+  if (!GetGraphicsManagerOrNull()) {
+    return;
+  }
+
+  ion::profile::TraceRecorder* recorder = manager_->GetNamedTraceRecorder(
+     ion::profile::CallTraceManager::kRecorderGpu);
+  const int event_id = manager_->GetScopeEnterEvent("GPU_LabeledNode");
+
+  // The scopes are in drawing order, so each one ends before the next one
+  // that is not one of its descendants starts.
+  std::vector<uint64> open_end_times_ns;
+  for (size_t i = 0; i < times.scopes.size(); ++i) {
+    const gfx::Renderer::NodeGpuTimes::Scope& scope = times.scopes[i];
+    DCHECK_LE(scope.depth, open_end_times_ns.size());
+    while (open_end_times_ns.size() > scope.depth) {
+      recorder->LeaveScopeAtTime(GetTraceTimeUs(open_end_times_ns.back()));
+      open_end_times_ns.pop_back();
+    }
+    const uint32 begin_us = GetTraceTimeUs(scope.begin_ns);
+    recorder->EnterScopeAtTime(begin_us, event_id);
+    recorder->AnnotateCurrentScopeAtTime(
+        begin_us, "path", "\"" + base::EscapeString(scope.path) + "\"");
+    open_end_times_ns.push_back(scope.end_ns);
+  }
+  while (!open_end_times_ns.empty()) {
+    recorder->LeaveScopeAtTime(GetTraceTimeUs(open_end_times_ns.back()));
+    open_end_times_ns.pop_back();
+  }
+}
+
+void GpuProfiler::AddNodeCpuTimes(const gfx::Renderer::NodeCpuTimes& times) {
+  ion::profile::TraceRecorder* recorder = manager_->GetTraceRecorder();
+  const int event_id = manager_->GetScopeEnterEvent("CPU_LabeledNode");
+
+  // The times are read from port::Timer::Clock, which the CallTraceManager
+  // also uses, but relative to its own timebase.
+  const int64 now_ns = static_cast<int64>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          port::Timer::Clock::now().time_since_epoch()).count());
+  const int64 offset_ns = static_cast<int64>(manager_->GetTimeInNs()) - now_ns;
+  auto to_trace_us = [offset_ns](uint64 time_ns) {
+    return static_cast<uint32>(
+        (static_cast<int64>(time_ns) + offset_ns) / 1000ll);
+  };
+
+  std::vector<uint64> open_end_times_ns;
+  for (size_t i = 0; i < times.scopes.size(); ++i) {
+    const gfx::Renderer::NodeCpuTimes::Scope& scope = times.scopes[i];
+    DCHECK_LE(scope.depth, open_end_times_ns.size());
+    while (open_end_times_ns.size() > scope.depth) {
+      recorder->LeaveScopeAtTime(to_trace_us(open_end_times_ns.back()));
+      open_end_times_ns.pop_back();
+    }
+    const uint32 begin_us = to_trace_us(scope.begin_ns);
+    recorder->EnterScopeAtTime(begin_us, event_id);
+    recorder->AnnotateCurrentScopeAtTime(
+        begin_us, "path", "\"" + base::EscapeString(scope.path) + "\"");
+    recorder->AnnotateCurrentScopeAtTime(
+        begin_us, "uniforms", base::ValueToString(scope.counts.uniforms));
+    recorder->AnnotateCurrentScopeAtTime(
+        begin_us, "state_changes",
+        base::ValueToString(scope.counts.state_changes));
+    recorder->AnnotateCurrentScopeAtTime(
+        begin_us, "draws", base::ValueToString(scope.counts.draws));
+    recorder->AnnotateCurrentScopeAtTime(
+        begin_us, "resource_updates",
+        base::ValueToString(scope.counts.resource_updates));
+    open_end_times_ns.push_back(scope.end_ns);
+  }
+  while (!open_end_times_ns.empty()) {
+    recorder->LeaveScopeAtTime(to_trace_us(open_end_times_ns.back()));
+    open_end_times_ns.pop_back();
+  }
+}
+
 }  // namespace gfxprofile
 }  // namespace ion
@@ -28,6 +28,7 @@ limitations under the License.
 #include "base/integral_types.h"
 #include "ion/base/staticsafedeclare.h"
 #include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/renderer.h"
 #include "ion/profile/calltracemanager.h"
 #include "ion/profile/profiling.h"
 #include "ion/profile/tracerecorder.h"
@@ -78,7 +79,7 @@ class GpuProfiler {
   // Gets the GraphicsManager if GPU tracing is enabled. NULL is returned if
   // GPU tracing is not enabled.
   gfx::GraphicsManager* GetGraphicsManagerOrNull() const {
-    if (enable_gpu_tracing_) {
+    if (enable_gpu_tracing_.GetSnapshot()) {
       return graphics_manager_.Get();
     } else {
       return NULL;
@@ -95,6 +96,22 @@ class GpuProfiler {
   // Records the end of a scoped GL trace event.
   void LeaveGlScope();
 
+  // Adds the GPU times of labeled Nodes measured by a Renderer with the
+  // kProfileLabeledNodeGpuTime flag set to the trace buffer, as nested
+  // "GPU_LabeledNode" scopes annotated with the path of each Node. This is
+  // typically called from the Renderer's NodeGpuTimesCallback. It has no
+  // effect unless GPU tracing is enabled.
+  void AddNodeGpuTimes(const gfx::Renderer::NodeGpuTimes& times);
+
+  // Adds the CPU times of labeled Nodes measured by a Renderer with the
+  // kProfileLabeledNodeCpuTime flag set to the calling thread's trace buffer,
+  // as nested "CPU_LabeledNode" scopes annotated with the path of each Node
+  // and the work done for it. This is typically called from the Renderer's
+  // NodeCpuTimesCallback, so that the scopes nest inside those of the thread
+  // that drew them. Unlike AddNodeGpuTimes(), this does not require GPU
+  // tracing.
+  void AddNodeCpuTimes(const gfx::Renderer::NodeCpuTimes& times);
+
  private:
   // Data to queue the pending GPU timer queries that need to be polled
   // for completion.
@@ -131,6 +148,12 @@ class GpuProfiler {
   // Returns a GL timer query ID if possible. Otherwise returns 0.
   GLuint TryAllocateGlQueryId();
 
+  // Converts a GL timestamp to a CallTraceManager timestamp in microseconds.
+  uint32 GetTraceTimeUs(uint64 gl_timestamp_ns) const {
+    return static_cast<uint32>(
+        (static_cast<int64>(gl_timestamp_ns) + gl_timer_offset_ns_) / 1000ll);
+  }
+
   // Reference to the parent CallTraceManager, used to query time.
   ion::profile::CallTraceManager* manager_;
 
@@ -0,0 +1,415 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxprofile/performancehud.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/invalid.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/transformutils.h"
+#include "ion/text/layout.h"
+
+namespace ion {
+namespace gfxprofile {
+
+namespace {
+
+// The distance of the text and graph from the edges of the viewport.
+static const float kMarginPixels = 8.f;
+// The horizontal distance between frames in the graph, and its height.
+static const float kGraphStepPixels = 2.f;
+static const float kGraphHeightPixels = 64.f;
+// The number of glyphs reserved for the text.
+static const size_t kTextCapacity = 1024U;
+
+// Returns the increase from begin to end, or 0 if there is none, for example
+// because the counts were reset.
+template <typename T>
+static T GetIncrease(T begin, T end) {
+  return end > begin ? end - begin : 0;
+}
+
+// Returns a string representing a number of bytes.
+static const std::string FormatBytes(double bytes) {
+  static const char* kUnits[] = { "B", "KB", "MB", "GB" };
+  size_t unit = 0;
+  while (bytes >= 1024.0 && unit + 1U < arraysize(kUnits)) {
+    bytes /= 1024.0;
+    ++unit;
+  }
+  char s[32];
+  snprintf(s, sizeof(s), unit ? "%.1f %s" : "%.0f %s", bytes, kUnits[unit]);
+  return s;
+}
+
+// Returns the GPU memory used by the resources of a holder, which may be NULL.
+static size_t GetGpuMemoryUsed(const gfx::ResourceHolder* holder) {
+  return holder ? holder->GetGpuMemoryUsed() : 0U;
+}
+
+}  // anonymous namespace
+
+const size_t PerformanceHud::kGraphFrameCount;
+
+PerformanceHud::FrameStats::FrameStats()
+    : frame(0U),
+      frame_time_ms(0.0),
+      cpu_time_ms(0.0),
+      sent_uniform_count(0U),
+      allocation_count(0U),
+      allocated_bytes(0U) {
+  std::fill(gpu_memory, gpu_memory + gfx::Renderer::kNumResourceTypes, 0U);
+}
+
+PerformanceHud::PerformanceHud(
+    const gfx::RendererPtr& renderer, const text::FontPtr& font,
+    const gfxutils::ShaderManagerPtr& shader_manager,
+    const base::AllocatorPtr& allocator)
+    : renderer_(renderer),
+      allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      tracker_(renderer->GetAllocator().Get() ?
+               renderer->GetAllocator()->GetTracker() :
+               base::AllocationTrackerPtr()),
+      prev_call_statistics_enabled_(
+          renderer->GetGraphicsManager()->IsCallStatisticsEnabled()),
+      graph_max_time_ms_(1000.0 / 30.0),
+      text_update_interval_s_(0.25),
+      size_(0, 0),
+      in_frame_(false),
+      in_pass_(false),
+      has_previous_frame_(false),
+      frame_time_ms_(0.0),
+      pass_count_(0U),
+      graph_start_(0U),
+      root_(new (allocator_) gfx::Node),
+      projection_index_(base::kInvalidIndex),
+      has_text_node_(false) {
+  renderer_->GetGraphicsManager()->EnableCallStatistics(true);
+  std::fill(frame_times_, frame_times_ + kGraphFrameCount, 0.f);
+
+  // The HUD is drawn in pixel coordinates on top of everything else.
+  const gfx::ShaderInputRegistryPtr& reg =
+      gfx::ShaderInputRegistry::GetGlobalRegistry();
+  root_->SetLabel("Performance HUD");
+  projection_index_ = root_->AddUniform(reg->Create<gfx::Uniform>(
+      "uProjectionMatrix", math::Matrix4f::Identity()));
+  root_->AddUniform(reg->Create<gfx::Uniform>("uModelviewMatrix",
+                                              math::Matrix4f::Identity()));
+  gfx::StateTablePtr state_table(new (allocator_) gfx::StateTable);
+  state_table->Enable(gfx::StateTable::kDepthTest, false);
+  state_table->Enable(gfx::StateTable::kCullFace, false);
+  root_->SetStateTable(state_table);
+
+  // The graph is a line strip through one vertex per frame, drawn with the
+  // Renderer's default shader.
+  graph_buffer_ = new (allocator_) gfx::BufferObject;
+  graph_buffer_->SetData(
+      base::DataContainer::CreateAndCopy<math::Point3f>(
+          NULL, kGraphFrameCount, false, allocator_),
+      sizeof(math::Point3f), kGraphFrameCount, gfx::BufferObject::kStreamDraw);
+  gfx::AttributeArrayPtr attribute_array(new (allocator_) gfx::AttributeArray);
+  attribute_array->AddAttribute(reg->Create<gfx::Attribute>(
+      "aVertex", gfx::BufferObjectElement(
+                     graph_buffer_, graph_buffer_->AddSpec(
+                                        gfx::BufferObject::kFloat, 3, 0))));
+  gfx::ShapePtr graph_shape(new (allocator_) gfx::Shape);
+  graph_shape->SetLabel("Frame time graph");
+  graph_shape->SetPrimitiveType(gfx::Shape::kLineStrip);
+  graph_shape->SetAttributeArray(attribute_array);
+  gfx::NodePtr graph_node(new (allocator_) gfx::Node);
+  graph_node->AddUniform(reg->Create<gfx::Uniform>(
+      "uBaseColor", math::Vector4f(0.2f, 1.f, 0.2f, 1.f)));
+  graph_node->AddShape(graph_shape);
+  root_->AddChild(graph_node);
+  UpdateGraph();
+
+  // All of the text is a single label of one BatchBuilder. Its Node is added
+  // once the text is first built.
+  text::GlyphSet glyph_set(allocator_);
+  font->AddGlyphsForAsciiCharacterRange(' ', '~', &glyph_set);
+  font_image_ = new (allocator_) text::StaticFontImage(font, 512U, glyph_set);
+  if (!font_image_->GetImageData().texture.Get())
+    LOG(ERROR) << "PerformanceHud: unable to create the font image";
+  text_builder_ =
+      new (allocator_) text::BatchBuilder(font_image_, shader_manager,
+                                          allocator_);
+  text_builder_->AddLabel(text::Layout(), math::Matrix4f::Identity(),
+                          math::Vector4f(1.f, 1.f, 1.f, 1.f), kTextCapacity);
+}
+
+PerformanceHud::~PerformanceHud() {
+  renderer_->GetGraphicsManager()->EnableCallStatistics(
+      prev_call_statistics_enabled_);
+}
+
+void PerformanceHud::Resize(int width, int height) {
+  size_.Set(width, height);
+  root_->SetUniformValue(
+      projection_index_,
+      math::OrthographicMatrixFromFrustum(
+          0.f, static_cast<float>(width), 0.f, static_cast<float>(height),
+          -1.f, 1.f));
+  root_->GetStateTable()->SetViewport(math::Range2i::BuildWithSize(
+      math::Point2i(0, 0), math::Vector2i(width, height)));
+  // The text is anchored to the top of the viewport.
+  if (!text_.empty())
+    LayOutText();
+}
+
+void PerformanceHud::BeginFrame() {
+  if (in_frame_) {
+    LOG(ERROR) << "PerformanceHud: BeginFrame() called without EndFrame()";
+    return;
+  }
+  in_frame_ = true;
+  frame_time_ms_ = has_previous_frame_ ? interval_timer_.GetInMs() : 0.0;
+  has_previous_frame_ = true;
+  interval_timer_.Reset();
+  pass_count_ = 0U;
+  GetTotals(&begin_totals_);
+  frame_timer_.Reset();
+}
+
+void PerformanceHud::EndFrame() {
+  if (!in_frame_) {
+    LOG(ERROR) << "PerformanceHud: EndFrame() called without BeginFrame()";
+    return;
+  }
+  if (in_pass_) {
+    LOG(ERROR) << "PerformanceHud: EndFrame() called without EndPass()";
+    EndPass();
+  }
+  // Read everything before doing any work of the HUD's own.
+  const double cpu_time_ms = frame_timer_.GetInMs();
+  Totals end_totals;
+  GetTotals(&end_totals);
+  in_frame_ = false;
+
+  const gfx::GraphicsManager::CallStatistics& begin_calls =
+      begin_totals_.call_statistics;
+  const gfx::GraphicsManager::CallStatistics& end_calls =
+      end_totals.call_statistics;
+  gfx::GraphicsManager::CallStatistics& calls = stats_.call_statistics;
+  ++stats_.frame;
+  stats_.frame_time_ms = frame_time_ms_;
+  stats_.cpu_time_ms = cpu_time_ms;
+  calls.call_count = GetIncrease(begin_calls.call_count, end_calls.call_count);
+  calls.draw_call_count =
+      GetIncrease(begin_calls.draw_call_count, end_calls.draw_call_count);
+  calls.primitive_count =
+      GetIncrease(begin_calls.primitive_count, end_calls.primitive_count);
+  calls.buffer_upload_bytes = GetIncrease(begin_calls.buffer_upload_bytes,
+                                          end_calls.buffer_upload_bytes);
+  calls.texture_upload_bytes = GetIncrease(begin_calls.texture_upload_bytes,
+                                           end_calls.texture_upload_bytes);
+  stats_.sent_uniform_count = GetIncrease(begin_totals_.sent_uniform_count,
+                                          end_totals.sent_uniform_count);
+  stats_.allocation_count = GetIncrease(begin_totals_.allocation_count,
+                                        end_totals.allocation_count);
+  stats_.allocated_bytes = GetIncrease(begin_totals_.allocated_bytes,
+                                       end_totals.allocated_bytes);
+  for (int i = 0; i < gfx::Renderer::kNumResourceTypes; ++i) {
+    const gfx::Renderer::ResourceType type =
+        static_cast<gfx::Renderer::ResourceType>(i);
+    stats_.gpu_memory[i] = GetIncrease(GetOwnGpuMemory(type),
+                                       renderer_->GetGpuMemoryUsage(type));
+  }
+
+  // GPU times are those of the latest measured frame.
+  const std::map<std::string, uint64>& gpu_times =
+      renderer_->GetNodeGpuTimes().total_ns;
+  stats_.passes.assign(passes_.begin(), passes_.begin() + pass_count_);
+  for (size_t i = 0; i < pass_count_; ++i) {
+    PassStats& pass = stats_.passes[i];
+    const auto it = gpu_times.find(pass.name);
+    pass.gpu_time_ms =
+        it == gpu_times.end() ? -1.0 : static_cast<double>(it->second) * 1e-6;
+  }
+
+  if (stats_.frame_time_ms > 0.0) {
+    frame_times_[graph_start_] = static_cast<float>(stats_.frame_time_ms);
+    graph_start_ = (graph_start_ + 1U) % kGraphFrameCount;
+    UpdateGraph();
+  }
+  if (!has_text_node_ || text_timer_.GetInS() >= text_update_interval_s_) {
+    FormatText();
+    LayOutText();
+    text_timer_.Reset();
+  }
+}
+
+void PerformanceHud::BeginPass(const std::string& name) {
+  if (!in_frame_ || in_pass_) {
+    LOG(ERROR) << "PerformanceHud: pass '" << name
+               << "' must begin inside a frame and outside other passes";
+    return;
+  }
+  if (pass_count_ == passes_.size())
+    passes_.push_back(PassStats());
+  PassStats& pass = passes_[pass_count_];
+  if (pass.name != name)
+    pass.name = name;
+  in_pass_ = true;
+  pass_timer_.Reset();
+}
+
+void PerformanceHud::EndPass() {
+  if (!in_pass_) {
+    LOG(ERROR) << "PerformanceHud: EndPass() called without BeginPass()";
+    return;
+  }
+  passes_[pass_count_++].cpu_time_ms = pass_timer_.GetInMs();
+  in_pass_ = false;
+}
+
+void PerformanceHud::GetTotals(Totals* totals) const {
+  totals->call_statistics =
+      renderer_->GetGraphicsManager()->GetCallStatistics();
+  totals->sent_uniform_count = renderer_->GetSentUniformCount();
+  if (base::AllocationTracker* tracker = tracker_.Get()) {
+    totals->allocation_count = tracker->GetAllocationCount();
+    totals->allocated_bytes = tracker->GetAllocatedBytesCount();
+  }
+}
+
+size_t PerformanceHud::GetOwnGpuMemory(gfx::Renderer::ResourceType type) const {
+  size_t size = 0U;
+  if (type == gfx::Renderer::kBufferObject) {
+    size += GetGpuMemoryUsed(graph_buffer_.Get());
+    if (has_text_node_) {
+      const gfx::ShapePtr& shape = text_builder_->GetNode()->GetShapes()[0];
+      const gfx::AttributeArrayPtr& attribute_array =
+          shape->GetAttributeArray();
+      if (attribute_array.Get() &&
+          attribute_array->GetBufferAttributeCount()) {
+        size += GetGpuMemoryUsed(
+            attribute_array->GetBufferAttribute(0U)
+                .GetValue<gfx::BufferObjectElement>().buffer_object.Get());
+      }
+      size += GetGpuMemoryUsed(shape->GetIndexBuffer().Get());
+    }
+  } else if (type == gfx::Renderer::kTexture) {
+    size += GetGpuMemoryUsed(font_image_->GetImageData().texture.Get());
+  }
+  return size;
+}
+
+void PerformanceHud::UpdateGraph() {
+  math::Point3f* vertices =
+      graph_buffer_->GetData()->GetMutableData<math::Point3f>();
+  const float scale =
+      kGraphHeightPixels / static_cast<float>(graph_max_time_ms_);
+  // The oldest frame is at graph_start_.
+  for (size_t i = 0; i < kGraphFrameCount; ++i) {
+    const float time = frame_times_[(graph_start_ + i) % kGraphFrameCount];
+    vertices[i].Set(kMarginPixels + kGraphStepPixels * static_cast<float>(i),
+                    kMarginPixels + std::min(time * scale, kGraphHeightPixels),
+                    0.f);
+  }
+}
+
+void PerformanceHud::FormatText() {
+  static const char* kResourceTypeNames[gfx::Renderer::kNumResourceTypes] = {
+    "attribute arrays",          // Renderer::kAttributeArray,
+    "buffers",                   // Renderer::kBufferObject,
+    "framebuffers",              // Renderer::kFramebufferObject,
+    "samplers",                  // Renderer::kSampler,
+    "shader input registries",   // Renderer::kShaderInputRegistry,
+    "shader programs",           // Renderer::kShaderProgram,
+    "shaders",                   // Renderer::kShader,
+    "textures",                  // Renderer::kTexture,
+  };
+  const gfx::GraphicsManager::CallStatistics& calls = stats_.call_statistics;
+  char s[256];
+  snprintf(s, sizeof(s), "Frame %.2f ms  CPU %.2f ms\n", stats_.frame_time_ms,
+           stats_.cpu_time_ms);
+  text_ = s;
+  snprintf(s, sizeof(s), "Draws %llu  Primitives %llu  GL calls %llu\n",
+           static_cast<unsigned long long>(calls.draw_call_count),  // NOLINT
+           static_cast<unsigned long long>(calls.primitive_count),  // NOLINT
+           static_cast<unsigned long long>(calls.call_count));      // NOLINT
+  text_ += s;
+  const std::string buffer_bytes =
+      FormatBytes(static_cast<double>(calls.buffer_upload_bytes));
+  const std::string texture_bytes =
+      FormatBytes(static_cast<double>(calls.texture_upload_bytes));
+  snprintf(s, sizeof(s), "Uniforms %llu  Uploads %s buffers, %s textures\n",
+           static_cast<unsigned long long>(  // NOLINT
+               stats_.sent_uniform_count),
+           buffer_bytes.c_str(), texture_bytes.c_str());
+  text_ += s;
+  for (size_t i = 0; i < stats_.passes.size(); ++i) {
+    const PassStats& pass = stats_.passes[i];
+    if (pass.gpu_time_ms < 0.0) {
+      snprintf(s, sizeof(s), "%.64s  CPU %.2f ms  GPU -\n", pass.name.c_str(),
+               pass.cpu_time_ms);
+    } else {
+      snprintf(s, sizeof(s), "%.64s  CPU %.2f ms  GPU %.2f ms\n",
+               pass.name.c_str(), pass.cpu_time_ms, pass.gpu_time_ms);
+    }
+    text_ += s;
+  }
+  text_ += "GPU memory";
+  for (int i = 0; i < gfx::Renderer::kNumResourceTypes; ++i) {
+    if (stats_.gpu_memory[i]) {
+      text_ += " " + FormatBytes(static_cast<double>(stats_.gpu_memory[i])) +
+               " " + kResourceTypeNames[i];
+    }
+  }
+  snprintf(s, sizeof(s), "\nAllocations %llu (%s) per frame",
+           static_cast<unsigned long long>(stats_.allocation_count),  // NOLINT
+           FormatBytes(static_cast<double>(stats_.allocated_bytes)).c_str());
+  text_ += s;
+}
+
+void PerformanceHud::LayOutText() {
+  // Lay out the text at the font's pixel size, which is the height of each
+  // line since the line spacing is 1.
+  const text::FontPtr& font = font_image_->GetFont();
+  const size_t line_count =
+      1U + std::count(text_.begin(), text_.end(), '\n');
+  text::LayoutOptions options;
+  options.target_point.Set(kMarginPixels,
+                           static_cast<float>(size_[1]) - kMarginPixels);
+  options.target_size.Set(
+      0.f, static_cast<float>(font->GetSizeInPixels() * line_count));
+  options.vertical_alignment = text::kAlignTop;
+  text_builder_->SetLabelLayout(0U, font->BuildLayout(text_, options));
+  if (text_builder_->NeedsRebuild() &&
+      text_builder_->BuildBatch(gfx::BufferObject::kStreamDraw) &&
+      !has_text_node_) {
+    root_->AddChild(text_builder_->GetNode());
+    has_text_node_ = true;
+  }
+}
+
+}  // namespace gfxprofile
+}  // namespace ion
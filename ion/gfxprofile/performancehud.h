@@ -0,0 +1,240 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXPROFILE_PERFORMANCEHUD_H_
+#define ION_GFXPROFILE_PERFORMANCEHUD_H_
+
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocationtracker.h"
+#include "ion/base/allocator.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfxutils/shadermanager.h"
+#include "ion/math/vector.h"
+#include "ion/port/timer.h"
+#include "ion/text/batchbuilder.h"
+#include "ion/text/font.h"
+#include "ion/text/fontimage.h"
+
+namespace ion {
+namespace gfxprofile {
+
+// PerformanceHud is a low-overhead overlay that shows statistics about the
+// frames drawn by a Renderer: a graph of recent frame times, the CPU and GPU
+// time of each pass, the number of draw calls, primitives, and uniform values
+// sent, upload sizes, GPU memory by resource type, and the allocation rate.
+// All of the text is drawn from a single text::BatchBuilder buffer and the
+// graph is a single line-strip Shape, so drawing the HUD takes two draw calls.
+//
+// Typical usage:
+//   PerformanceHud hud(renderer, font, shader_manager, allocator);
+//   hud.Resize(width, height);
+//   ...
+//   // Every frame:
+//   hud.BeginFrame();
+//   hud.BeginPass("Shadows");
+//   renderer->DrawScene(shadow_root);
+//   hud.EndPass();
+//   hud.BeginPass("Scene");
+//   renderer->DrawScene(scene_root);
+//   hud.EndPass();
+//   hud.EndFrame();
+//   renderer->DrawScene(hud.GetRootNode());
+//
+// The statistics of a frame are the changes between BeginFrame() and
+// EndFrame(). EndFrame() reads them before updating the HUD, and the HUD is
+// drawn after EndFrame(), so neither its updates nor its own draw calls,
+// uniforms, uploads, and allocations are counted. The GPU memory used by the
+// HUD's buffers and font texture is subtracted from the reported usage.
+//
+// The GPU time of a pass is the time Renderer::GetNodeGpuTimes() reports for
+// the labeled Node whose label is the pass name, so it requires
+// Renderer::kProfileLabeledNodeGpuTime to be set and the root Node of the pass
+// to be labeled. GPU times lag a frame or two behind the CPU times.
+//
+// The HUD enables call statistics on the Renderer's GraphicsManager while it
+// exists. The allocation counters are read from the AllocationTracker of the
+// Renderer's allocator, if it has one, or from the tracker passed to
+// SetAllocationTracker().
+class ION_API PerformanceHud {
+ public:
+  // The number of frames shown in the frame time graph.
+  static const size_t kGraphFrameCount = 120U;
+
+  // The times of a pass of a frame.
+  struct PassStats {
+    PassStats() : cpu_time_ms(0.0), gpu_time_ms(-1.0) {}
+    std::string name;
+    // The time between BeginPass() and EndPass().
+    double cpu_time_ms;
+    // The GPU time of the labeled Node with the name of the pass, or -1 if no
+    // time has been measured for it.
+    double gpu_time_ms;
+  };
+
+  // The statistics of a frame.
+  struct FrameStats {
+    FrameStats();
+    // The number of the frame, counting from 1.
+    uint64 frame;
+    // The time between the last two calls to BeginFrame(), or 0 for the first
+    // frame.
+    double frame_time_ms;
+    // The time between BeginFrame() and EndFrame().
+    double cpu_time_ms;
+    // The increases in the GraphicsManager's call statistics.
+    gfx::GraphicsManager::CallStatistics call_statistics;
+    // The number of uniform values the Renderer sent to OpenGL.
+    size_t sent_uniform_count;
+    // The GPU memory used by each Renderer::ResourceType at the end of the
+    // frame.
+    size_t gpu_memory[gfx::Renderer::kNumResourceTypes];
+    // The number of allocations made and the bytes they allocated.
+    size_t allocation_count;
+    size_t allocated_bytes;
+    // The passes of the frame, in the order they began.
+    std::vector<PassStats> passes;
+  };
+
+  // The HUD's glyphs are taken from the printable Ascii characters of font.
+  // The shader manager is used to compose the text shader, and may be NULL.
+  // The passed allocator is used for all allocations; if it is NULL, the
+  // default allocator is used.
+  PerformanceHud(const gfx::RendererPtr& renderer, const text::FontPtr& font,
+                 const gfxutils::ShaderManagerPtr& shader_manager,
+                 const base::AllocatorPtr& allocator);
+  ~PerformanceHud();
+
+  // Sets the size of the viewport the HUD is drawn into, in pixels. The text
+  // is drawn at the font's pixel size in the top left corner, and the graph in
+  // the bottom left corner.
+  void Resize(int width, int height);
+
+  // Sets/returns the frame time at the top of the graph. Longer frames are
+  // clamped to the top. The default is 33.3 ms.
+  void SetGraphMaxTime(double max_time_ms) { graph_max_time_ms_ = max_time_ms; }
+  double GetGraphMaxTime() const { return graph_max_time_ms_; }
+
+  // Sets/returns the minimum time between updates of the text, which is
+  // otherwise rebuilt every frame. The graph is updated every frame. The
+  // default is 0.25 seconds.
+  void SetTextUpdateInterval(double interval_s) {
+    text_update_interval_s_ = interval_s;
+  }
+  double GetTextUpdateInterval() const { return text_update_interval_s_; }
+
+  // Sets/returns the AllocationTracker that the allocation counters are read
+  // from. If it is NULL, the counters are 0.
+  void SetAllocationTracker(const base::AllocationTrackerPtr& tracker) {
+    tracker_ = tracker;
+  }
+  const base::AllocationTrackerPtr& GetAllocationTracker() const {
+    return tracker_;
+  }
+
+  // Begins and ends gathering the statistics of a frame. EndFrame() updates
+  // the HUD with them.
+  void BeginFrame();
+  void EndFrame();
+
+  // Begins and ends a named pass of the current frame. Passes may not be
+  // nested.
+  void BeginPass(const std::string& name);
+  void EndPass();
+
+  // Returns the statistics of the last frame ended by EndFrame().
+  const FrameStats& GetFrameStats() const { return stats_; }
+  // Returns the text shown by the HUD.
+  const std::string& GetText() const { return text_; }
+
+  // Returns the root Node of the HUD, which should be drawn after EndFrame().
+  const gfx::NodePtr& GetRootNode() const { return root_; }
+
+ private:
+  // The totals that the statistics of a frame are computed from.
+  struct Totals {
+    Totals() : sent_uniform_count(0U), allocation_count(0U),
+               allocated_bytes(0U) {}
+    gfx::GraphicsManager::CallStatistics call_statistics;
+    size_t sent_uniform_count;
+    size_t allocation_count;
+    size_t allocated_bytes;
+  };
+
+  // Reads the current totals.
+  void GetTotals(Totals* totals) const;
+  // Returns the GPU memory used by the HUD's own resources of the passed type.
+  size_t GetOwnGpuMemory(gfx::Renderer::ResourceType type) const;
+  // Rewrites the vertices of the graph from the frame time history.
+  void UpdateGraph();
+  // Formats the statistics of the last frame into text_.
+  void FormatText();
+  // Lays out text_ in the text buffer.
+  void LayOutText();
+
+  gfx::RendererPtr renderer_;
+  base::AllocatorPtr allocator_;
+  base::AllocationTrackerPtr tracker_;
+  bool prev_call_statistics_enabled_;
+
+  // Graph and text settings.
+  double graph_max_time_ms_;
+  double text_update_interval_s_;
+  math::Vector2i size_;
+
+  // Frame state.
+  Totals begin_totals_;
+  port::Timer frame_timer_;
+  port::Timer interval_timer_;
+  port::Timer pass_timer_;
+  port::Timer text_timer_;
+  bool in_frame_;
+  bool in_pass_;
+  bool has_previous_frame_;
+  double frame_time_ms_;
+  // The passes of the current frame. Only the first pass_count_ are in use,
+  // so that the others keep their storage for later frames.
+  std::vector<PassStats> passes_;
+  size_t pass_count_;
+  FrameStats stats_;
+
+  // Frame times shown in the graph, in a ring starting at graph_start_.
+  float frame_times_[kGraphFrameCount];
+  size_t graph_start_;
+
+  // The Nodes of the HUD.
+  gfx::NodePtr root_;
+  size_t projection_index_;
+  gfx::BufferObjectPtr graph_buffer_;
+  text::StaticFontImagePtr font_image_;
+  text::BatchBuilderPtr text_builder_;
+  bool has_text_node_;
+  std::string text_;
+
+  DISALLOW_COPY_AND_ASSIGN(PerformanceHud);
+};
+
+}  // namespace gfxprofile
+}  // namespace ion
+
+#endif  // ION_GFXPROFILE_PERFORMANCEHUD_H_
@@ -24,6 +24,7 @@
       'includes': [ '../../dev/test_target.gypi' ],
       'sources' : [
         'gpuprofiler_test.cc',
+        'performancehud_test.cc',
       ],
       'dependencies' : [
         '<(ion_dir)/profile/profile.gyp:ionprofile',
@@ -31,6 +32,7 @@
         '<(ion_dir)/external/gtest.gyp:iongtest_vanilla',
         '<(ion_dir)/gfxprofile/gfxprofile.gyp:iongfxprofile',
         '<(ion_dir)/gfx/gfx.gyp:iongfx_for_tests',  # for mockgraphics
+        '<(ion_dir)/text/text.gyp:iontext_for_tests',
       ],
     },  # target: iongfxprofile_test
   ],
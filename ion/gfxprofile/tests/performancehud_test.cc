@@ -0,0 +1,213 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxprofile/performancehud.h"
+
+#include <memory>
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/matrix.h"
+#include "ion/math/vector.h"
+#include "ion/text/tests/testfont.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxprofile {
+
+namespace {
+
+// Returns a Node with a rectangle that is drawn with the default shader.
+static const gfx::NodePtr BuildSceneNode() {
+  const gfx::ShaderInputRegistryPtr& reg =
+      gfx::ShaderInputRegistry::GetGlobalRegistry();
+  gfx::NodePtr node(new gfx::Node);
+  node->SetLabel("Scene");
+  node->AddUniform(reg->Create<gfx::Uniform>("uProjectionMatrix",
+                                             math::Matrix4f::Identity()));
+  node->AddUniform(reg->Create<gfx::Uniform>("uModelviewMatrix",
+                                             math::Matrix4f::Identity()));
+  node->AddUniform(reg->Create<gfx::Uniform>(
+      "uBaseColor", math::Vector4f(1.f, 1.f, 1.f, 1.f)));
+  gfxutils::RectangleSpec spec;
+  spec.vertex_type = gfxutils::ShapeSpec::kPosition;
+  node->AddShape(gfxutils::BuildRectangleShape(spec));
+  return node;
+}
+
+}  // anonymous namespace
+
+class PerformanceHudTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    visual_.reset(new gfx::testing::MockVisual(64, 64));
+    gm_.Reset(new gfx::testing::MockGraphicsManager());
+    renderer_.Reset(new gfx::Renderer(gm_));
+    font_ = text::testing::BuildTestFreeTypeFont("Test", 16U, 2U);
+  }
+
+  void TearDown() override {
+    renderer_.Reset(NULL);
+    gm_.Reset(NULL);
+    visual_.reset();
+  }
+
+  std::unique_ptr<gfx::testing::MockVisual> visual_;
+  gfx::testing::MockGraphicsManagerPtr gm_;
+  gfx::RendererPtr renderer_;
+  text::FontPtr font_;
+};
+
+TEST_F(PerformanceHudTest, Nodes) {
+  base::LogChecker log_checker;
+  EXPECT_FALSE(gm_->IsCallStatisticsEnabled());
+  {
+    PerformanceHud hud(renderer_, font_, gfxutils::ShaderManagerPtr(),
+                       base::AllocatorPtr());
+    EXPECT_TRUE(gm_->IsCallStatisticsEnabled());
+    EXPECT_EQ(0.25, hud.GetTextUpdateInterval());
+    hud.Resize(800, 600);
+
+    // Only the graph exists until the first frame ends.
+    const gfx::NodePtr& root = hud.GetRootNode();
+    ASSERT_EQ(1U, root->GetChildren().size());
+    const gfx::ShapePtr& graph = root->GetChildren()[0]->GetShapes()[0];
+    EXPECT_EQ(gfx::Shape::kLineStrip, graph->GetPrimitiveType());
+    EXPECT_TRUE(hud.GetText().empty());
+
+    hud.BeginFrame();
+    hud.EndFrame();
+    EXPECT_EQ(2U, root->GetChildren().size());
+    EXPECT_NE(std::string::npos, hud.GetText().find("Draws 0"));
+
+    // The whole HUD is drawn with one call for the graph and one for the text.
+    gfx::testing::TraceVerifier verifier(gm_.Get());
+    renderer_->DrawScene(root);
+    EXPECT_EQ(1U, verifier.GetCountOf("DrawArrays(GL_LINE_STRIP, 0, 120"));
+    EXPECT_EQ(1U, verifier.GetCountOf("DrawElements(GL_TRIANGLES"));
+  }
+  // The call statistics setting is restored.
+  EXPECT_FALSE(gm_->IsCallStatisticsEnabled());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST_F(PerformanceHudTest, FrameStats) {
+  base::LogChecker log_checker;
+  PerformanceHud hud(renderer_, font_, gfxutils::ShaderManagerPtr(),
+                     base::AllocatorPtr());
+  hud.Resize(800, 600);
+  const gfx::NodePtr scene = BuildSceneNode();
+
+  hud.BeginFrame();
+  hud.BeginPass("Scene");
+  renderer_->DrawScene(scene);
+  hud.EndPass();
+  hud.EndFrame();
+  const PerformanceHud::FrameStats& stats = hud.GetFrameStats();
+  EXPECT_EQ(1U, stats.frame);
+  EXPECT_EQ(0.0, stats.frame_time_ms);
+  EXPECT_EQ(1U, stats.call_statistics.draw_call_count);
+  EXPECT_EQ(2U, stats.call_statistics.primitive_count);
+  EXPECT_LT(0U, stats.call_statistics.buffer_upload_bytes);
+  EXPECT_LT(0U, stats.sent_uniform_count);
+  EXPECT_LT(0U, stats.gpu_memory[gfx::Renderer::kBufferObject]);
+  ASSERT_EQ(1U, stats.passes.size());
+  EXPECT_EQ("Scene", stats.passes[0].name);
+  EXPECT_LE(0.0, stats.passes[0].cpu_time_ms);
+  // No GPU time is measured without kProfileLabeledNodeGpuTime.
+  EXPECT_EQ(-1.0, stats.passes[0].gpu_time_ms);
+  EXPECT_NE(std::string::npos, hud.GetText().find("Draws 1  Primitives 2"));
+  EXPECT_NE(std::string::npos, hud.GetText().find("Scene  CPU"));
+  const size_t scene_buffer_memory =
+      stats.gpu_memory[gfx::Renderer::kBufferObject];
+
+  // Drawing the HUD itself does not count towards any frame.
+  renderer_->DrawScene(hud.GetRootNode());
+  EXPECT_LT(0U, renderer_->GetGpuMemoryUsage(gfx::Renderer::kTexture));
+  hud.BeginFrame();
+  hud.EndFrame();
+  EXPECT_EQ(2U, stats.frame);
+  EXPECT_LT(0.0, stats.frame_time_ms);
+  EXPECT_EQ(0U, stats.call_statistics.call_count);
+  EXPECT_EQ(0U, stats.call_statistics.draw_call_count);
+  EXPECT_EQ(0U, stats.call_statistics.buffer_upload_bytes);
+  EXPECT_EQ(0U, stats.sent_uniform_count);
+  EXPECT_TRUE(stats.passes.empty());
+  EXPECT_EQ(scene_buffer_memory,
+            stats.gpu_memory[gfx::Renderer::kBufferObject]);
+  EXPECT_EQ(0U, stats.gpu_memory[gfx::Renderer::kTexture]);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST_F(PerformanceHudTest, Graph) {
+  PerformanceHud hud(renderer_, font_, gfxutils::ShaderManagerPtr(),
+                     base::AllocatorPtr());
+  EXPECT_NEAR(33.3, hud.GetGraphMaxTime(), 0.1);
+  hud.SetGraphMaxTime(1e-6);
+  EXPECT_EQ(1e-6, hud.GetGraphMaxTime());
+  const gfx::BufferObjectPtr& buffer =
+      hud.GetRootNode()->GetChildren()[0]->GetShapes()[0]
+          ->GetAttributeArray()->GetBufferAttribute(0U)
+          .GetValue<gfx::BufferObjectElement>().buffer_object;
+  ASSERT_EQ(PerformanceHud::kGraphFrameCount, buffer->GetCount());
+  const math::Point3f* vertices = buffer->GetData()->GetData<math::Point3f>();
+  const float bottom = vertices[0][1];
+  EXPECT_EQ(bottom, vertices[PerformanceHud::kGraphFrameCount - 1U][1]);
+  EXPECT_LT(vertices[0][0], vertices[1][0]);
+
+  // The first frame has no frame time, and the newest time is on the right,
+  // clamped to the top of the graph.
+  for (int i = 0; i < 2; ++i) {
+    hud.BeginFrame();
+    hud.EndFrame();
+  }
+  vertices = buffer->GetData()->GetData<math::Point3f>();
+  EXPECT_EQ(bottom, vertices[PerformanceHud::kGraphFrameCount - 2U][1]);
+  EXPECT_EQ(bottom + 64.f, vertices[PerformanceHud::kGraphFrameCount - 1U][1]);
+}
+
+TEST_F(PerformanceHudTest, Errors) {
+  base::LogChecker log_checker;
+  PerformanceHud hud(renderer_, font_, gfxutils::ShaderManagerPtr(),
+                     base::AllocatorPtr());
+  hud.EndFrame();
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "without BeginFrame"));
+  hud.BeginPass("Pass");
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must begin inside a frame"));
+  hud.EndPass();
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "without BeginPass"));
+
+  hud.BeginFrame();
+  hud.BeginFrame();
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "without EndFrame"));
+  hud.BeginPass("Pass");
+  hud.BeginPass("Nested");
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must begin inside a frame"));
+  // An unfinished pass is ended with the frame.
+  hud.EndFrame();
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "without EndPass"));
+  ASSERT_EQ(1U, hud.GetFrameStats().passes.size());
+  EXPECT_EQ("Pass", hud.GetFrameStats().passes[0].name);
+}
+
+}  // namespace gfxprofile
+}  // namespace ion
@@ -0,0 +1,249 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/attributelayout.h"
+
+#include <string.h>  // For memcpy() and memset().
+
+#include "base/integral_types.h"
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/base/scopedallocation.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/bufferobject.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// An element of a BufferObject read by per-vertex buffer Attributes, and the
+// element that replaces it.
+struct Element {
+  Element(const gfx::BufferObjectPtr& buffer_object_in, size_t spec_index_in)
+      : buffer_object(buffer_object_in),
+        spec_index(spec_index_in),
+        new_buffer_object(buffer_object_in),
+        new_spec_index(spec_index_in) {}
+  gfx::BufferObjectPtr buffer_object;
+  size_t spec_index;
+  gfx::BufferObjectPtr new_buffer_object;
+  size_t new_spec_index;
+};
+
+typedef base::AllocVector<Element> ElementVector;
+
+// Returns an allocator for temporary data.
+static const base::AllocatorPtr& GetTemporaryAllocator() {
+  return base::AllocationManager::GetDefaultAllocatorForLifetime(
+      base::kShortTerm);
+}
+
+// Returns the size in bytes of a component of the passed type. A component
+// of a matrix column type is a whole column.
+static size_t GetComponentSize(gfx::BufferObject::ComponentType type) {
+  switch (type) {
+    case gfx::BufferObject::kByte:
+    case gfx::BufferObject::kUnsignedByte:
+      return 1U;
+    case gfx::BufferObject::kShort:
+    case gfx::BufferObject::kUnsignedShort:
+      return 2U;
+    case gfx::BufferObject::kFloatMatrixColumn2:
+      return 2U * sizeof(float);
+    case gfx::BufferObject::kFloatMatrixColumn3:
+      return 3U * sizeof(float);
+    case gfx::BufferObject::kFloatMatrixColumn4:
+      return 4U * sizeof(float);
+    default:
+      return 4U;
+  }
+}
+
+// Returns the size in bytes of |element|, padded to a multiple of 4 bytes.
+static size_t GetPaddedSize(const Element& element) {
+  const gfx::BufferObject::Spec& spec =
+      element.buffer_object->GetSpec(element.spec_index);
+  const size_t size = spec.component_count * GetComponentSize(spec.type);
+  return (size + 3U) & ~static_cast<size_t>(3U);
+}
+
+// Returns whether |attribute| is a per-vertex buffer Attribute with a
+// BufferObject.
+static bool IsPerVertexBufferAttribute(const gfx::Attribute& attribute) {
+  return attribute.IsValid() &&
+         attribute.GetType() == gfx::kBufferObjectElementAttribute &&
+         !attribute.GetDivisor() &&
+         attribute.GetValue<gfx::BufferObjectElement>().buffer_object.Get();
+}
+
+// Returns the entry of |elements| for |value|, or NULL if there is none.
+static const Element* FindElement(const ElementVector& elements,
+                                  const gfx::BufferObjectElement& value) {
+  for (const Element& element : elements) {
+    if (element.buffer_object.Get() == value.buffer_object.Get() &&
+        element.spec_index == value.spec_index)
+      return &element;
+  }
+  return NULL;
+}
+
+// Adds to |elements| the distinct elements read by the per-vertex buffer
+// Attributes of |attribute_array|. Returns false and logs an error that
+// starts with |function_name| if there are none, or if any of their
+// BufferObjects has no data.
+static bool GetElements(const gfx::AttributeArrayPtr& attribute_array,
+                        const char* function_name, ElementVector* elements) {
+  if (!attribute_array.Get()) {
+    LOG(ERROR) << function_name << ": the AttributeArray is NULL";
+    return false;
+  }
+  const size_t count = attribute_array->GetBufferAttributeCount();
+  for (size_t i = 0; i < count; ++i) {
+    const gfx::Attribute& attribute = attribute_array->GetBufferAttribute(i);
+    if (!IsPerVertexBufferAttribute(attribute))
+      continue;
+    const gfx::BufferObjectElement& value =
+        attribute.GetValue<gfx::BufferObjectElement>();
+    const base::DataContainerPtr& data = value.buffer_object->GetData();
+    if (!data.Get() || !data->GetData()) {
+      LOG(ERROR) << function_name
+                 << ": the BufferObjects of the attributes must all have data";
+      return false;
+    }
+    if (!FindElement(*elements, value))
+      elements->push_back(Element(value.buffer_object, value.spec_index));
+  }
+  if (elements->empty()) {
+    LOG(ERROR) << function_name
+               << ": the AttributeArray has no per-vertex buffer attributes";
+    return false;
+  }
+  return true;
+}
+
+// Returns a new BufferObject for |count| structs of |stride| bytes, with
+// zeroed data and the allocator, usage mode, and wipeable setting of
+// |original|.
+static const gfx::BufferObjectPtr CreateBufferObject(
+    const gfx::BufferObject& original, size_t stride, size_t count) {
+  const base::AllocatorPtr& allocator = original.GetAllocator();
+  gfx::BufferObjectPtr buffer_object(new (allocator) gfx::BufferObject);
+  base::ScopedAllocation<uint8> sa(allocator, stride * count);
+  memset(sa.Get(), 0, stride * count);
+  buffer_object->SetData(
+      sa.TransferToDataContainer(original.GetData()->IsWipeable()), stride,
+      count, original.GetUsageMode());
+  return buffer_object;
+}
+
+// Copies the values of |element| into the data of its new BufferObject, at
+// |byte_offset| in each struct.
+static void CopyElement(const Element& element, size_t byte_offset) {
+  const gfx::BufferObject& source = *element.buffer_object;
+  const gfx::BufferObject::Spec& spec = source.GetSpec(element.spec_index);
+  const size_t size = spec.component_count * GetComponentSize(spec.type);
+  const size_t source_stride = source.GetStructSize();
+  const uint8* source_data =
+      source.GetData()->GetData<uint8>() + spec.byte_offset;
+  const size_t stride = element.new_buffer_object->GetStructSize();
+  uint8* data =
+      element.new_buffer_object->GetData()->GetMutableData<uint8>() +
+      byte_offset;
+  const size_t count = source.GetCount();
+  for (size_t i = 0; i < count; ++i)
+    memcpy(data + i * stride, source_data + i * source_stride, size);
+}
+
+// Replaces the values of the per-vertex buffer Attributes of
+// |attribute_array| with the new elements in |elements|.
+static void ReplaceElements(const ElementVector& elements,
+                            gfx::AttributeArray* attribute_array) {
+  const size_t count = attribute_array->GetAttributeCount();
+  for (size_t i = 0; i < count; ++i) {
+    gfx::Attribute attribute = attribute_array->GetAttribute(i);
+    if (!IsPerVertexBufferAttribute(attribute))
+      continue;
+    const Element* element =
+        FindElement(elements, attribute.GetValue<gfx::BufferObjectElement>());
+    DCHECK(element);
+    if (element->new_buffer_object.Get() == element->buffer_object.Get())
+      continue;
+    attribute.SetValue(gfx::BufferObjectElement(element->new_buffer_object,
+                                                element->new_spec_index));
+    attribute_array->ReplaceAttribute(i, attribute);
+  }
+}
+
+}  // anonymous namespace
+
+bool InterleaveAttributes(const gfx::AttributeArrayPtr& attribute_array) {
+  ElementVector elements(GetTemporaryAllocator());
+  if (!GetElements(attribute_array, "InterleaveAttributes", &elements))
+    return false;
+  const gfx::BufferObject& first = *elements[0].buffer_object;
+  const size_t count = first.GetCount();
+  size_t stride = 0;
+  for (const Element& element : elements) {
+    if (element.buffer_object->GetCount() != count) {
+      LOG(ERROR) << "InterleaveAttributes: the BufferObjects of the attributes"
+                 << " must all have the same count";
+      return false;
+    }
+    stride += GetPaddedSize(element);
+  }
+
+  const gfx::BufferObjectPtr buffer_object =
+      CreateBufferObject(first, stride, count);
+  size_t byte_offset = 0;
+  for (Element& element : elements) {
+    const gfx::BufferObject::Spec& spec =
+        element.buffer_object->GetSpec(element.spec_index);
+    element.new_buffer_object = buffer_object;
+    element.new_spec_index =
+        buffer_object->AddSpec(spec.type, spec.component_count, byte_offset);
+    CopyElement(element, byte_offset);
+    byte_offset += GetPaddedSize(element);
+  }
+  ReplaceElements(elements, attribute_array.Get());
+  return true;
+}
+
+bool DeinterleaveAttributes(const gfx::AttributeArrayPtr& attribute_array) {
+  ElementVector elements(GetTemporaryAllocator());
+  if (!GetElements(attribute_array, "DeinterleaveAttributes", &elements))
+    return false;
+  for (Element& element : elements) {
+    const gfx::BufferObject& source = *element.buffer_object;
+    const gfx::BufferObject::Spec& spec = source.GetSpec(element.spec_index);
+    const size_t stride = GetPaddedSize(element);
+    if (source.GetSpecCount() == 1U && !spec.byte_offset &&
+        source.GetStructSize() == stride)
+      continue;
+    element.new_buffer_object =
+        CreateBufferObject(source, stride, source.GetCount());
+    element.new_spec_index =
+        element.new_buffer_object->AddSpec(spec.type, spec.component_count, 0);
+    CopyElement(element, 0);
+  }
+  ReplaceElements(elements, attribute_array.Get());
+  return true;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,66 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef ION_GFXUTILS_ATTRIBUTELAYOUT_H_
+#define ION_GFXUTILS_ATTRIBUTELAYOUT_H_
+
+// This file contains functions that change how the vertex data of an
+// AttributeArray is laid out in BufferObjects, without changing what is drawn.
+// Meshes loaded as separate arrays are usually bound as one BufferObject per
+// attribute, which costs a buffer bind per attribute and scatters the fetches
+// of each vertex across memory. Interleaving the attributes into a single
+// BufferObject keeps each vertex in one place. The reverse is useful for
+// passes such as depth prepasses that only read positions, which are then
+// fetched from a tightly packed buffer without the other attributes.
+//
+// Both functions replace the values of the buffer Attributes in place, so
+// every Shape that uses the AttributeArray sees the new layout. The original
+// BufferObjects are not changed, and remain in use by any other
+// AttributeArray that refers to them. Attributes with a divisor, which are
+// read per instance rather than per vertex, are left unchanged.
+
+#include "ion/gfx/attributearray.h"
+
+namespace ion {
+namespace gfxutils {
+
+// Repacks the per-vertex buffer Attributes of |attribute_array| into a single
+// new interleaved BufferObject, in the order the Attributes were added. Each
+// element starts at an offset that is a multiple of 4 bytes, since many
+// vertex fetchers fall back to a slow path for unaligned elements, and only
+// the padding this needs is added. Elements that no Attribute uses are
+// dropped, and Attributes that share an element keep sharing it. The new
+// BufferObject uses the allocator, usage mode, and wipeable setting of the
+// first BufferObject. Every BufferObject must hold data, and they must all
+// have the same count.
+// Returns false and leaves the AttributeArray unchanged if any of these
+// requirements is not met, or if there are no per-vertex buffer Attributes.
+ION_API bool InterleaveAttributes(
+    const gfx::AttributeArrayPtr& attribute_array);
+
+// Moves each element used by the per-vertex buffer Attributes of
+// |attribute_array| into its own new tightly packed BufferObject, with a
+// stride padded to a multiple of 4 bytes. Elements that are already alone in
+// such a BufferObject are left where they are. Every BufferObject must hold
+// data. Returns false and leaves the AttributeArray unchanged if any of these
+// requirements is not met, or if there are no per-vertex buffer Attributes.
+ION_API bool DeinterleaveAttributes(
+    const gfx::AttributeArrayPtr& attribute_array);
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_ATTRIBUTELAYOUT_H_
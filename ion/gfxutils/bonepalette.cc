@@ -0,0 +1,260 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/bonepalette.h"
+
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+#include <sstream>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/sampler.h"
+#include "ion/math/transformkernels.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// The shader function that sums the weighted matrices of four bones.
+static const char kSkinningMatrixSource[] =
+    "mat4 GetSkinningMatrix(vec4 bones, vec4 weights) {\n"
+    "  return GetBoneMatrix(bones.x) * weights.x +\n"
+    "      GetBoneMatrix(bones.y) * weights.y +\n"
+    "      GetBoneMatrix(bones.z) * weights.z +\n"
+    "      GetBoneMatrix(bones.w) * weights.w;\n"
+    "}\n";
+
+// Builds the matrix whose top three rows are r0, r1 and r2.
+static const char kRowsToMatrixSource[] =
+    "  return mat4(r0.x, r1.x, r2.x, 0.0, r0.y, r1.y, r2.y, 0.0,\n"
+    "              r0.z, r1.z, r2.z, 0.0, r0.w, r1.w, r2.w, 1.0);\n"
+    "}\n";
+
+}  // anonymous namespace
+
+BonePalette::BonePalette(size_t bone_count, size_t instance_count,
+                         Storage storage,
+                         const gfx::ShaderInputRegistryPtr& registry,
+                         const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      registry_(registry),
+      bone_count_(bone_count),
+      instance_count_(instance_count),
+      storage_(storage),
+      rows_(allocator_, bone_count * instance_count * kRowsPerBone,
+            math::Vector4f::Zero()),
+      parents_(allocator_),
+      inverse_bind_matrices_(allocator_),
+      changed_begin_(0U),
+      changed_end_(instance_count) {
+  DCHECK(registry_.Get());
+  for (size_t i = 0; i < rows_.size(); i += kRowsPerBone) {
+    rows_[i][0] = 1.f;
+    rows_[i + 1U][1] = 1.f;
+    rows_[i + 2U][2] = 1.f;
+  }
+
+  if (storage_ == kTextureStorage) {
+    // Each instance is a row of the texture, with three texels per bone.
+    gfx::ImagePtr image(new (allocator_) gfx::Image);
+    image->Set(gfx::Image::kRgba32f,
+               static_cast<uint32>(bone_count_ * kRowsPerBone),
+               static_cast<uint32>(instance_count_), base::DataContainerPtr());
+    gfx::SamplerPtr sampler(new (allocator_) gfx::Sampler);
+    sampler->SetWrapS(gfx::Sampler::kClampToEdge);
+    sampler->SetWrapT(gfx::Sampler::kClampToEdge);
+    texture_.Reset(new (allocator_) gfx::Texture);
+    texture_->SetLabel("Bone palette");
+    texture_->SetImmutableImage(image, 1U);
+    texture_->SetSampler(sampler);
+  } else {
+    block_.Reset(new (allocator_) gfx::UniformBlock);
+    block_->SetLabel("Bone palette");
+    block_->SetBlockName("BonePalette");
+    block_->AddUniform(registry_->CreateArrayUniform(
+        "uBonePalette", rows_.data(), rows_.size(), allocator_));
+  }
+}
+
+BonePalette::~BonePalette() {}
+
+void BonePalette::SetSkeleton(const int* parents,
+                              const math::Matrix4f* inverse_bind_matrices) {
+  for (size_t i = 0; i < bone_count_; ++i) {
+    if (parents[i] < -1 || parents[i] >= static_cast<int>(i)) {
+      LOG(ERROR) << "BonePalette: the parent of bone " << i
+                 << " must precede it";
+      return;
+    }
+  }
+  parents_.assign(parents, parents + bone_count_);
+  inverse_bind_matrices_.assign(inverse_bind_matrices,
+                                inverse_bind_matrices + bone_count_);
+}
+
+void BonePalette::SetBoneMatrices(size_t instance,
+                                  const math::Matrix4f* matrices) {
+  if (instance >= instance_count_) {
+    LOG(ERROR) << "BonePalette: invalid instance " << instance;
+    return;
+  }
+  WriteInstance(instance, matrices);
+  MarkChanged(instance, instance + 1U);
+}
+
+const math::Matrix4f BonePalette::GetBoneMatrix(size_t instance,
+                                                size_t bone) const {
+  math::Matrix4f m = math::Matrix4f::Identity();
+  if (instance < instance_count_ && bone < bone_count_) {
+    const math::Vector4f* rows =
+        &rows_[(instance * bone_count_ + bone) * kRowsPerBone];
+    for (int row = 0; row < 3; ++row)
+      memcpy(m[row], rows[row].Data(), sizeof(rows[row]));
+  }
+  return m;
+}
+
+void BonePalette::SetPoses(size_t first_instance, size_t count,
+                           const math::Matrix4f* local_transforms,
+                           base::TaskScheduler* scheduler) {
+  if (first_instance + count > instance_count_) {
+    LOG(ERROR) << "BonePalette: invalid instances " << first_instance
+               << " to " << first_instance + count;
+    return;
+  }
+  if (parents_.size() != bone_count_) {
+    LOG(ERROR) << "BonePalette: a skeleton must be set before poses";
+    return;
+  }
+  const base::TaskScheduler::RangeFunction func = [&](size_t begin,
+                                                      size_t end) {
+    base::AllocVector<math::Matrix4f> matrices(allocator_, bone_count_,
+                                               math::Matrix4f::Identity());
+    for (size_t i = begin; i < end; ++i) {
+      // The parents precede their children, so each bone's transform in model
+      // space is computed after its parent's.
+      const math::Matrix4f* locals = &local_transforms[i * bone_count_];
+      for (size_t bone = 0; bone < bone_count_; ++bone) {
+        const int parent = parents_[bone];
+        matrices[bone] =
+            parent < 0 ? locals[bone] : matrices[parent] * locals[bone];
+      }
+      math::MultiplyMatrices(matrices.data(), inverse_bind_matrices_.data(),
+                             bone_count_, matrices.data(), NULL);
+      WriteInstance(first_instance + i, matrices.data());
+    }
+  };
+  if (scheduler && count > 1U)
+    scheduler->ParallelFor(0U, count, 0U, func);
+  else if (count)
+    func(0U, count);
+  MarkChanged(first_instance, first_instance + count);
+}
+
+void BonePalette::Update() {
+  if (changed_begin_ >= changed_end_)
+    return;
+  const size_t rows_per_instance = bone_count_ * kRowsPerBone;
+  if (texture_.Get()) {
+    const size_t count = changed_end_ - changed_begin_;
+    gfx::ImagePtr image(new (allocator_) gfx::Image);
+    image->Set(gfx::Image::kRgba32f, static_cast<uint32>(rows_per_instance),
+               static_cast<uint32>(count),
+               base::DataContainer::CreateAndCopy<math::Vector4f>(
+                   &rows_[changed_begin_ * rows_per_instance],
+                   count * rows_per_instance, true, allocator_));
+    texture_->SetSubImage(
+        0U, math::Point2ui(0U, static_cast<uint32>(changed_begin_)), image);
+  } else {
+    // The UniformBlock uploads the array with a single sub-data range.
+    const size_t end = changed_end_ * rows_per_instance;
+    for (size_t i = changed_begin_ * rows_per_instance; i < end; ++i)
+      block_->SetUniformValueAt<math::VectorBase4f>(0U, i, rows_[i]);
+  }
+  changed_begin_ = instance_count_;
+  changed_end_ = 0U;
+}
+
+void BonePalette::AddUniforms(const gfx::NodePtr& node) const {
+  if (texture_.Get()) {
+    node->AddUniform(registry_->Create<gfx::Uniform>("uBonePalette", texture_));
+    node->AddUniform(registry_->Create<gfx::Uniform>(
+        "uBonePaletteTexelSize",
+        math::Vector2f(1.f / static_cast<float>(bone_count_ * kRowsPerBone),
+                       1.f / static_cast<float>(instance_count_))));
+  } else {
+    node->AddUniformBlock(block_);
+  }
+}
+
+const gfx::Uniform BonePalette::CreateInstanceUniform(size_t instance) const {
+  return registry_->Create<gfx::Uniform>("uBoneInstance",
+                                         static_cast<float>(instance));
+}
+
+const std::string BonePalette::GetShaderSource() const {
+  std::ostringstream out;
+  if (texture_.Get()) {
+    out << "uniform sampler2D uBonePalette;\n"
+        << "uniform vec2 uBonePaletteTexelSize;\n"
+        << "uniform float uBoneInstance;\n\n"
+        << "mat4 GetBoneMatrix(float bone) {\n"
+        << "  vec2 uv = (vec2(bone * 3.0, uBoneInstance) + 0.5) *\n"
+        << "      uBonePaletteTexelSize;\n"
+        << "  vec2 step = vec2(uBonePaletteTexelSize.x, 0.0);\n"
+        << "  vec4 r0 = texture2D(uBonePalette, uv);\n"
+        << "  vec4 r1 = texture2D(uBonePalette, uv + step);\n"
+        << "  vec4 r2 = texture2D(uBonePalette, uv + 2.0 * step);\n";
+  } else {
+    out << "layout(std140) uniform BonePalette {\n"
+        << "  vec4 uBonePalette[" << rows_.size() << "];\n"
+        << "};\n"
+        << "uniform float uBoneInstance;\n\n"
+        << "mat4 GetBoneMatrix(float bone) {\n"
+        << "  int i = (int(uBoneInstance) * " << bone_count_
+        << " + int(bone)) * 3;\n"
+        << "  vec4 r0 = uBonePalette[i];\n"
+        << "  vec4 r1 = uBonePalette[i + 1];\n"
+        << "  vec4 r2 = uBonePalette[i + 2];\n";
+  }
+  out << kRowsToMatrixSource << "\n" << kSkinningMatrixSource;
+  return out.str();
+}
+
+void BonePalette::WriteInstance(size_t instance,
+                                const math::Matrix4f* matrices) {
+  math::Vector4f* rows = &rows_[instance * bone_count_ * kRowsPerBone];
+  for (size_t bone = 0; bone < bone_count_; ++bone) {
+    for (size_t row = 0; row < kRowsPerBone; ++row, ++rows)
+      memcpy(rows->Data(), matrices[bone][static_cast<int>(row)],
+             sizeof(*rows));
+  }
+}
+
+void BonePalette::MarkChanged(size_t begin, size_t end) {
+  changed_begin_ = std::min(changed_begin_, begin);
+  changed_end_ = std::max(changed_end_, end);
+}
+
+}  // namespace gfxutils
+}  // namespace ion
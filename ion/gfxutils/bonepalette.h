@@ -0,0 +1,174 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_BONEPALETTE_H_
+#define ION_GFXUTILS_BONEPALETTE_H_
+
+#include <string>
+
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/texture.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfx/uniformblock.h"
+#include "ion/math/matrix.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
+namespace gfxutils {
+
+// BonePalette holds the skinning matrices of many instances of a skinned mesh,
+// such as a crowd of characters sharing a skeleton, in a single float Texture
+// or uniform buffer. Instead of setting a Uniform array of matrices for each
+// instance, which is limited in size and sent to OpenGL one element at a time,
+// the matrices are written into the palette on the CPU and all of the changed
+// instances are uploaded once per frame by Update(), with a single sub-image or
+// sub-data upload. Each instance's Node only sets the index of its instance.
+//
+// The palette stores the top three rows of each affine skinning matrix, which
+// is the product of the bone's transform in model space and its inverse bind
+// matrix. SetPoses() computes them for many instances at once from the local
+// transforms of the bones, using the SIMD kernels in math/transformkernels.h
+// and optionally the threads of a TaskScheduler.
+//
+// Typical usage:
+//   BonePalette palette(bone_count, character_count,
+//                       BonePalette::kTextureStorage, reg, allocator);
+//   palette.SetSkeleton(parents, inverse_bind_matrices);
+//   palette.AddUniforms(crowd_root);
+//   // Prepend palette.GetShaderSource() to the vertex shader, which can then
+//   // call GetSkinningMatrix(aBoneIndices, aBoneWeights).
+//   for (size_t i = 0; i < character_count; ++i)
+//     character_nodes[i]->AddUniform(palette.CreateInstanceUniform(i));
+//   ...
+//   // Every frame:
+//   palette.SetPoses(0, character_count, local_transforms, scheduler);
+//   palette.Update();
+//   renderer->DrawScene(crowd_root);
+//
+// Texture storage needs float textures (OpenGL ES 3.0 or OES_texture_float)
+// and a maximum texture size of at least three texels per bone, and works for
+// any number of instances. Uniform buffer storage needs OpenGL ES 3.0 or
+// OpenGL 3.1, and the whole palette must fit in a uniform block, which may be
+// as small as 16KB, or about 340 bones in total.
+class ION_API BonePalette {
+ public:
+  enum Storage {
+    kTextureStorage,
+    kUniformBufferStorage,
+  };
+
+  // Creates a palette for instance_count instances of bone_count bones each,
+  // with all matrices set to the identity. The shader inputs of the palette
+  // are created in the passed registry. The passed allocator is used for all
+  // allocations; if it is NULL, the default allocator is used.
+  BonePalette(size_t bone_count, size_t instance_count, Storage storage,
+              const gfx::ShaderInputRegistryPtr& registry,
+              const base::AllocatorPtr& allocator);
+  ~BonePalette();
+
+  size_t GetBoneCount() const { return bone_count_; }
+  size_t GetInstanceCount() const { return instance_count_; }
+  Storage GetStorage() const { return storage_; }
+
+  // Sets the skeleton used by SetPoses(): the index of the parent of each of
+  // the bone_count bones, or -1 for root bones, and the inverse of the
+  // transform of each bone in model space in the bind pose. Parents must
+  // precede their children. Logs an error and leaves the skeleton unchanged if
+  // they do not.
+  void SetSkeleton(const int* parents,
+                   const math::Matrix4f* inverse_bind_matrices);
+
+  // Sets the skinning matrices of the bones of an instance, which must be
+  // affine. Logs an error if instance is out of range.
+  void SetBoneMatrices(size_t instance, const math::Matrix4f* matrices);
+  // Returns the skinning matrix of a bone of an instance, or the identity if
+  // either is out of range.
+  const math::Matrix4f GetBoneMatrix(size_t instance, size_t bone) const;
+
+  // Computes the skinning matrices of count instances starting at
+  // first_instance from the transforms of their bones relative to their
+  // parents, which are stored one instance after another in local_transforms.
+  // If scheduler is not NULL, the instances are split over its threads. Logs an
+  // error if the instances are out of range or no skeleton has been set.
+  void SetPoses(size_t first_instance, size_t count,
+                const math::Matrix4f* local_transforms,
+                base::TaskScheduler* scheduler);
+
+  // Uploads the matrices of all instances that have changed since the last
+  // call, as a single sub-image of the Texture or a single range of the
+  // uniform buffer. This should be called once per frame, before drawing.
+  void Update();
+
+  // Adds the Uniforms that the shaders need to access the palette to the
+  // passed Node, which should be an ancestor of the Nodes of all instances.
+  void AddUniforms(const gfx::NodePtr& node) const;
+  // Returns a Uniform selecting the passed instance of the palette, to be added
+  // to the Node that draws the instance.
+  const gfx::Uniform CreateInstanceUniform(size_t instance) const;
+  // Returns GLSL declarations of the palette's uniforms and of the functions
+  //   mat4 GetBoneMatrix(float bone);
+  //   mat4 GetSkinningMatrix(vec4 bones, vec4 weights);
+  // which return the skinning matrix of a bone of the current instance, and
+  // the weighted sum of the matrices of four bones. The source must be
+  // included in the vertex shaders of the instances.
+  const std::string GetShaderSource() const;
+
+  // Returns the Texture or UniformBlock holding the palette, depending on its
+  // storage; the other is NULL.
+  const gfx::TexturePtr& GetTexture() const { return texture_; }
+  const gfx::UniformBlockPtr& GetUniformBlock() const { return block_; }
+
+ private:
+  // The number of vec4 rows stored for each bone.
+  static const size_t kRowsPerBone = 3U;
+
+  // Writes the skinning matrices of an instance into the palette.
+  void WriteInstance(size_t instance, const math::Matrix4f* matrices);
+  // Marks the instances in [begin, end) as changed.
+  void MarkChanged(size_t begin, size_t end);
+
+  base::AllocatorPtr allocator_;
+  gfx::ShaderInputRegistryPtr registry_;
+  const size_t bone_count_;
+  const size_t instance_count_;
+  const Storage storage_;
+  // The rows of the skinning matrices of all instances.
+  base::AllocVector<math::Vector4f> rows_;
+  // The skeleton.
+  base::AllocVector<int> parents_;
+  base::AllocVector<math::Matrix4f> inverse_bind_matrices_;
+  // The range of instances that have changed since the last Update().
+  size_t changed_begin_;
+  size_t changed_end_;
+  gfx::TexturePtr texture_;
+  gfx::UniformBlockPtr block_;
+
+  DISALLOW_COPY_AND_ASSIGN(BonePalette);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_BONEPALETTE_H_
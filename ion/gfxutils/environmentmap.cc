@@ -0,0 +1,595 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/environmentmap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/sampler.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using gfx::CubeMapTexture;
+using gfx::CubeMapTexturePtr;
+using gfx::FramebufferObject;
+using gfx::FramebufferObjectPtr;
+using gfx::Image;
+using gfx::ImagePtr;
+using gfx::ShaderInputRegistry;
+using gfx::ShaderProgram;
+using gfx::ShaderProgramPtr;
+using gfx::Uniform;
+
+static const char kFaceMatrixUniformName[] = "uIonEnvFaceMatrix";
+static const char kEquirectangularUniformName[] = "uIonEnvEquirectangular";
+static const char kSourceUniformName[] = "uIonEnvSource";
+static const char kRoughnessUniformName[] = "uIonEnvRoughness";
+static const char kLodBiasUniformName[] = "uIonEnvLodBias";
+static const char kSourceSizeUniformName[] = "uIonEnvSourceSize";
+static const char kSampleCountUniformName[] = "uIonEnvSampleCount";
+static const char kGridSizeUniformName[] = "uIonEnvGridSize";
+
+// The quad covers the framebuffer, and vPosition holds the position of each
+// pixel in [-1, 1], which is also its position on a cube map face.
+static const char kVertexShader[] =
+    "attribute vec3 aVertex;\n"
+    "varying vec2 vPosition;\n"
+    "\n"
+    "void main(void) {\n"
+    "  vPosition = aVertex.xy;\n"
+    "  gl_Position = vec4(aVertex.xy, 0.0, 1.0);\n"
+    "}\n";
+
+static const char kEquirectangularFragmentShader[] =
+    "#ifdef GL_ES\n"
+    "precision highp float;\n"
+    "#endif\n"
+    "uniform sampler2D uIonEnvEquirectangular;\n"
+    "uniform mat3 uIonEnvFaceMatrix;\n"
+    "varying vec2 vPosition;\n"
+    "\n"
+    "void main(void) {\n"
+    "  vec3 dir = normalize(uIonEnvFaceMatrix * vec3(vPosition, 1.0));\n"
+    "  vec2 uv = vec2(atan(dir.z, dir.x) * 0.15915494 + 0.5,\n"
+    "                 asin(clamp(dir.y, -1.0, 1.0)) * 0.31830989 + 0.5);\n"
+    "  gl_FragColor = texture2D(uIonEnvEquirectangular, uv);\n"
+    "}\n";
+
+// Importance samples the GGX distribution with a Hammersley sequence, reading
+// each sample from the level of the environment whose texels cover the solid
+// angle of the sample (Colbert and Krivanek, GPU Gems 3, chapter 20). Since
+// the texture coordinates change by about one texel of the target per pixel,
+// uIonEnvLodBias makes the bias relative to the level of the environment at
+// the size of the target. The loop bound matches kMaxSampleCount.
+static const char kPrefilterFragmentShader[] =
+    "#ifdef GL_ES\n"
+    "precision highp float;\n"
+    "#endif\n"
+    "uniform samplerCube uIonEnvSource;\n"
+    "uniform mat3 uIonEnvFaceMatrix;\n"
+    "uniform float uIonEnvRoughness;\n"
+    "uniform float uIonEnvLodBias;\n"
+    "uniform float uIonEnvSourceSize;\n"
+    "uniform int uIonEnvSampleCount;\n"
+    "varying vec2 vPosition;\n"
+    "\n"
+    "const float kPi = 3.14159265;\n"
+    "\n"
+    "float RadicalInverse(float n) {\n"
+    "  float result = 0.0;\n"
+    "  float f = 0.5;\n"
+    "  for (int i = 0; i < 16; ++i) {\n"
+    "    if (n < 1.0)\n"
+    "      break;\n"
+    "    result += f * mod(n, 2.0);\n"
+    "    n = floor(n * 0.5);\n"
+    "    f *= 0.5;\n"
+    "  }\n"
+    "  return result;\n"
+    "}\n"
+    "\n"
+    "void main(void) {\n"
+    "  vec3 n = normalize(uIonEnvFaceMatrix * vec3(vPosition, 1.0));\n"
+    "  if (uIonEnvRoughness <= 0.0) {\n"
+    "    gl_FragColor = textureCube(uIonEnvSource, n);\n"
+    "    return;\n"
+    "  }\n"
+    "  vec3 up =\n"
+    "      abs(n.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);\n"
+    "  vec3 t = normalize(cross(up, n));\n"
+    "  vec3 b = cross(n, t);\n"
+    "  float a = uIonEnvRoughness * uIonEnvRoughness;\n"
+    "  float a2 = a * a;\n"
+    "  float count = float(uIonEnvSampleCount);\n"
+    "  float texel_solid_angle =\n"
+    "      4.0 * kPi / (6.0 * uIonEnvSourceSize * uIonEnvSourceSize);\n"
+    "  vec3 color = vec3(0.0);\n"
+    "  float weight = 0.0;\n"
+    "  for (int i = 0; i < 1024; ++i) {\n"
+    "    if (i >= uIonEnvSampleCount)\n"
+    "      break;\n"
+    "    float phi = 2.0 * kPi * float(i) / count;\n"
+    "    float v = RadicalInverse(float(i));\n"
+    "    float cos_theta = sqrt((1.0 - v) / (1.0 + (a2 - 1.0) * v));\n"
+    "    float sin_theta = sqrt(1.0 - cos_theta * cos_theta);\n"
+    "    vec3 h = t * (sin_theta * cos(phi)) + b * (sin_theta * sin(phi)) +\n"
+    "        n * cos_theta;\n"
+    "    vec3 l = 2.0 * dot(n, h) * h - n;\n"
+    "    float n_dot_l = dot(n, l);\n"
+    "    if (n_dot_l > 0.0) {\n"
+    "      float d = cos_theta * cos_theta * (a2 - 1.0) + 1.0;\n"
+    "      float pdf = a2 / (4.0 * kPi * d * d);\n"
+    "      float sample_solid_angle = 1.0 / (count * pdf + 0.0001);\n"
+    "      float lod = max(\n"
+    "          0.5 * log2(sample_solid_angle / texel_solid_angle) + 1.0,\n"
+    "          0.0);\n"
+    "      color += textureCube(uIonEnvSource, l, lod + uIonEnvLodBias).rgb *\n"
+    "          n_dot_l;\n"
+    "      weight += n_dot_l;\n"
+    "    }\n"
+    "  }\n"
+    "  gl_FragColor = vec4(color / max(weight, 0.0001), 1.0);\n"
+    "}\n";
+
+// Each pixel of a 9x1 framebuffer integrates the radiance of the environment
+// times one basis function over the sphere. The directions in the loops are
+// the same for all pixels, so OpenGL samples the base level. The loop bound
+// matches kMaxShGridSize.
+static const char kShFragmentShader[] =
+    "#ifdef GL_ES\n"
+    "precision highp float;\n"
+    "#endif\n"
+    "uniform samplerCube uIonEnvSource;\n"
+    "uniform int uIonEnvGridSize;\n"
+    "\n"
+    "vec3 FaceDirection(int face, vec2 p) {\n"
+    "  if (face == 0)\n"
+    "    return vec3(1.0, -p.y, -p.x);\n"
+    "  if (face == 1)\n"
+    "    return vec3(-1.0, -p.y, p.x);\n"
+    "  if (face == 2)\n"
+    "    return vec3(p.x, 1.0, p.y);\n"
+    "  if (face == 3)\n"
+    "    return vec3(p.x, -1.0, -p.y);\n"
+    "  if (face == 4)\n"
+    "    return vec3(p.x, -p.y, 1.0);\n"
+    "  return vec3(-p.x, -p.y, -1.0);\n"
+    "}\n"
+    "\n"
+    "float Basis(int index, vec3 d) {\n"
+    "  if (index == 0)\n"
+    "    return 0.282095;\n"
+    "  if (index == 1)\n"
+    "    return 0.488603 * d.y;\n"
+    "  if (index == 2)\n"
+    "    return 0.488603 * d.z;\n"
+    "  if (index == 3)\n"
+    "    return 0.488603 * d.x;\n"
+    "  if (index == 4)\n"
+    "    return 1.092548 * d.x * d.y;\n"
+    "  if (index == 5)\n"
+    "    return 1.092548 * d.y * d.z;\n"
+    "  if (index == 6)\n"
+    "    return 0.315392 * (3.0 * d.z * d.z - 1.0);\n"
+    "  if (index == 7)\n"
+    "    return 1.092548 * d.x * d.z;\n"
+    "  return 0.546274 * (d.x * d.x - d.y * d.y);\n"
+    "}\n"
+    "\n"
+    "void main(void) {\n"
+    "  int index = int(gl_FragCoord.x);\n"
+    "  float grid = float(uIonEnvGridSize);\n"
+    "  vec3 sum = vec3(0.0);\n"
+    "  for (int face = 0; face < 6; ++face) {\n"
+    "    for (int y = 0; y < 64; ++y) {\n"
+    "      if (y >= uIonEnvGridSize)\n"
+    "        break;\n"
+    "      for (int x = 0; x < 64; ++x) {\n"
+    "        if (x >= uIonEnvGridSize)\n"
+    "          break;\n"
+    "        vec2 p = (vec2(float(x), float(y)) + 0.5) * 2.0 / grid - 1.0;\n"
+    "        vec3 d = normalize(FaceDirection(face, p));\n"
+    "        float w = 1.0 / pow(1.0 + dot(p, p), 1.5);\n"
+    "        sum += textureCube(uIonEnvSource, d).rgb *\n"
+    "            (Basis(index, d) * w);\n"
+    "      }\n"
+    "    }\n"
+    "  }\n"
+    "  gl_FragColor = vec4(sum * 4.0 / (grid * grid), 1.0);\n"
+    "}\n";
+
+// Returns the matrix that maps (s, t, 1), where s and t are the coordinates of
+// a point on face in [-1, 1], to its direction from the center of the cube,
+// following the OpenGL cube map conventions.
+static const math::Matrix3f GetFaceMatrix(CubeMapTexture::CubeFace face) {
+  switch (face) {
+    case CubeMapTexture::kNegativeX:
+      return math::Matrix3f(0.f, 0.f, -1.f,
+                            0.f, -1.f, 0.f,
+                            1.f, 0.f, 0.f);
+    case CubeMapTexture::kNegativeY:
+      return math::Matrix3f(1.f, 0.f, 0.f,
+                            0.f, 0.f, -1.f,
+                            0.f, -1.f, 0.f);
+    case CubeMapTexture::kNegativeZ:
+      return math::Matrix3f(-1.f, 0.f, 0.f,
+                            0.f, -1.f, 0.f,
+                            0.f, 0.f, -1.f);
+    case CubeMapTexture::kPositiveX:
+      return math::Matrix3f(0.f, 0.f, 1.f,
+                            0.f, -1.f, 0.f,
+                            -1.f, 0.f, 0.f);
+    case CubeMapTexture::kPositiveY:
+      return math::Matrix3f(1.f, 0.f, 0.f,
+                            0.f, 0.f, 1.f,
+                            0.f, 1.f, 0.f);
+    case CubeMapTexture::kPositiveZ:
+    default:
+      return math::Matrix3f(1.f, 0.f, 0.f,
+                            0.f, -1.f, 0.f,
+                            0.f, 0.f, 1.f);
+  }
+}
+
+// Returns the number of levels in a full mipmap chain of size.
+static size_t CountLevels(uint32 size) {
+  size_t count = 1U;
+  while (size > 1U) {
+    size >>= 1;
+    ++count;
+  }
+  return count;
+}
+
+// Returns the size of the faces of texture, or 0 if it has no images.
+static uint32 GetFaceSize(const CubeMapTexture& texture) {
+  if (const Image* image = texture.GetImmutableImage().Get())
+    return image->GetWidth();
+  return texture.HasImage(CubeMapTexture::kPositiveX, 0U)
+             ? texture.GetImage(CubeMapTexture::kPositiveX, 0U)->GetWidth()
+             : 0U;
+}
+
+// Checks the arguments shared by the functions that create cube maps.
+static bool ValidateTarget(const char* function, gfx::Renderer* renderer,
+                           bool has_source, uint32 face_size,
+                           Image::Format format) {
+  if (!renderer || !has_source) {
+    LOG(ERROR) << "EnvironmentMapGenerator::" << function
+               << ": a Renderer and a source texture are required";
+    return false;
+  }
+  if (!face_size) {
+    LOG(ERROR) << "EnvironmentMapGenerator::" << function
+               << ": the face size must be positive";
+    return false;
+  }
+  if (static_cast<uint32>(format) >= Image::kNumFormats ||
+      Image::IsCompressedFormat(format) ||
+      !FramebufferObject::IsColorRenderable(
+          Image::GetPixelFormat(format).internal_format)) {
+    LOG(ERROR) << "EnvironmentMapGenerator::" << function << ": format "
+               << Image::GetFormatString(format) << " is not color renderable";
+    return false;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+const size_t EnvironmentMapGenerator::kShCoefficientCount;
+const uint32 EnvironmentMapGenerator::kMaxSampleCount;
+const uint32 EnvironmentMapGenerator::kMaxShGridSize;
+
+EnvironmentMapGenerator::EnvironmentMapGenerator(
+    const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      sample_count_(64U),
+      registry_(new (allocator_) ShaderInputRegistry),
+      fbo_(new (allocator_) FramebufferObject(1U, 1U)) {
+  registry_->IncludeGlobalRegistry();
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kFaceMatrixUniformName, gfx::kMatrix3x3Uniform,
+      "Maps a position on a cube map face to its direction"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kEquirectangularUniformName, gfx::kTextureUniform,
+      "Equirectangular environment"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kSourceUniformName, gfx::kCubeMapTextureUniform,
+      "Environment cube map"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kRoughnessUniformName, gfx::kFloatUniform,
+      "GGX roughness of a prefiltered level"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kLodBiasUniformName, gfx::kFloatUniform,
+      "Level of the environment at the size of the target"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kSourceSizeUniformName, gfx::kFloatUniform,
+      "Size of the faces of the environment"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kSampleCountUniformName, gfx::kIntUniform,
+      "Number of GGX samples of each texel"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kGridSizeUniformName, gfx::kIntUniform,
+      "Number of sampled directions along each side of a face"));
+
+  RectangleSpec spec;
+  spec.allocator = allocator_;
+  spec.vertex_type = ShapeSpec::kPosition;
+  spec.size.Set(2.f, 2.f);
+  quad_ = BuildRectangleShape(spec);
+  quad_->SetLabel("Environment map quad");
+  fbo_->SetLabel("Environment map");
+}
+
+EnvironmentMapGenerator::~EnvironmentMapGenerator() {}
+
+void EnvironmentMapGenerator::SetSampleCount(uint32 count) {
+  sample_count_ = std::min(std::max(count, 1U), kMaxSampleCount);
+}
+
+const CubeMapTexturePtr EnvironmentMapGenerator::ConvertEquirectangular(
+    gfx::Renderer* renderer, const gfx::TexturePtr& texture, uint32 face_size,
+    size_t level_count, Image::Format format) {
+  CubeMapTexturePtr cube_map;
+  if (!ValidateTarget("ConvertEquirectangular", renderer, texture.Get(),
+                      face_size, format))
+    return cube_map;
+  if (!equirectangular_program_.Get()) {
+    equirectangular_program_ = ShaderProgram::BuildFromStrings(
+        "Equirectangular to cube map", registry_, kVertexShader,
+        kEquirectangularFragmentShader, allocator_);
+  }
+  level_count = std::min(std::max(level_count, static_cast<size_t>(1U)),
+                         CountLevels(face_size));
+  cube_map = CreateCubeMap(face_size, level_count, format);
+
+  std::vector<Uniform> uniforms(2U);
+  uniforms[0] = registry_->Create<Uniform>(kEquirectangularUniformName,
+                                           texture);
+  const FramebufferObjectPtr previous_fbo = renderer->GetCurrentFramebuffer();
+  for (size_t level = 0; level < level_count; ++level) {
+    const uint32 size = std::max(face_size >> level, 1U);
+    for (int face = 0; face < 6; ++face) {
+      const CubeMapTexture::CubeFace cube_face =
+          static_cast<CubeMapTexture::CubeFace>(face);
+      uniforms[1] = registry_->Create<Uniform>(kFaceMatrixUniformName,
+                                               GetFaceMatrix(cube_face));
+      fbo_->Resize(size, size);
+      fbo_->SetColorAttachment(
+          0U, FramebufferObject::Attachment(cube_map, cube_face, level));
+      Draw(renderer, equirectangular_program_, uniforms, size, size);
+    }
+  }
+  renderer->BindFramebuffer(previous_fbo);
+  return cube_map;
+}
+
+const CubeMapTexturePtr EnvironmentMapGenerator::Prefilter(
+    gfx::Renderer* renderer, const CubeMapTexturePtr& environment,
+    uint32 face_size, size_t level_count, Image::Format format) {
+  CubeMapTexturePtr cube_map;
+  if (!ValidateTarget("Prefilter", renderer, environment.Get(), face_size,
+                      format))
+    return cube_map;
+  const uint32 source_size = GetFaceSize(*environment);
+  if (!source_size) {
+    LOG(ERROR) << "EnvironmentMapGenerator::Prefilter: the environment has no"
+               << " images";
+    return cube_map;
+  }
+  if (!prefilter_program_.Get()) {
+    prefilter_program_ = ShaderProgram::BuildFromStrings(
+        "GGX prefilter", registry_, kVertexShader, kPrefilterFragmentShader,
+        allocator_);
+  }
+  level_count = std::min(std::max(level_count, static_cast<size_t>(1U)),
+                         CountLevels(face_size));
+  cube_map = CreateCubeMap(face_size, level_count, format);
+
+  std::vector<Uniform> uniforms(6U);
+  uniforms[0] = registry_->Create<Uniform>(kSourceUniformName, environment);
+  uniforms[1] = registry_->Create<Uniform>(kSourceSizeUniformName,
+                                           static_cast<float>(source_size));
+  uniforms[2] = registry_->Create<Uniform>(
+      kSampleCountUniformName, static_cast<int>(sample_count_));
+  const FramebufferObjectPtr previous_fbo = renderer->GetCurrentFramebuffer();
+  for (size_t level = 0; level < level_count; ++level) {
+    const uint32 size = std::max(face_size >> level, 1U);
+    const float roughness =
+        level_count > 1U ? static_cast<float>(level) /
+                               static_cast<float>(level_count - 1U)
+                         : 0.f;
+    uniforms[3] = registry_->Create<Uniform>(kRoughnessUniformName, roughness);
+    uniforms[4] = registry_->Create<Uniform>(
+        kLodBiasUniformName,
+        -std::log2(static_cast<float>(source_size) / static_cast<float>(size)));
+    for (int face = 0; face < 6; ++face) {
+      const CubeMapTexture::CubeFace cube_face =
+          static_cast<CubeMapTexture::CubeFace>(face);
+      uniforms[5] = registry_->Create<Uniform>(kFaceMatrixUniformName,
+                                               GetFaceMatrix(cube_face));
+      fbo_->Resize(size, size);
+      fbo_->SetColorAttachment(
+          0U, FramebufferObject::Attachment(cube_map, cube_face, level));
+      Draw(renderer, prefilter_program_, uniforms, size, size);
+    }
+  }
+  renderer->BindFramebuffer(previous_fbo);
+  return cube_map;
+}
+
+bool EnvironmentMapGenerator::ComputeIrradianceSh(
+    gfx::Renderer* renderer, const CubeMapTexturePtr& environment,
+    math::Vector3f coefficients[kShCoefficientCount]) {
+  if (!renderer || !environment.Get() || !coefficients) {
+    LOG(ERROR) << "EnvironmentMapGenerator::ComputeIrradianceSh: a Renderer,"
+               << " an environment and coefficients are required";
+    return false;
+  }
+  const uint32 source_size = GetFaceSize(*environment);
+  if (!source_size) {
+    LOG(ERROR) << "EnvironmentMapGenerator::ComputeIrradianceSh: the"
+               << " environment has no images";
+    return false;
+  }
+  if (!sh_program_.Get()) {
+    sh_program_ = ShaderProgram::BuildFromStrings(
+        "Irradiance SH", registry_, kVertexShader, kShFragmentShader,
+        allocator_);
+  }
+
+  // The sums are drawn into a float texture, one coefficient per pixel.
+  const uint32 count = static_cast<uint32>(kShCoefficientCount);
+  ImagePtr image(new (allocator_) Image);
+  image->Set(Image::kRgba32f, count, 1U, base::DataContainerPtr());
+  gfx::TexturePtr target(new (allocator_) gfx::Texture);
+  gfx::SamplerPtr sampler(new (allocator_) gfx::Sampler);
+  sampler->SetMinFilter(gfx::Sampler::kNearest);
+  sampler->SetMagFilter(gfx::Sampler::kNearest);
+  target->SetLabel("Irradiance SH");
+  target->SetSampler(sampler);
+  target->SetImage(0U, image);
+
+  std::vector<Uniform> uniforms(2U);
+  uniforms[0] = registry_->Create<Uniform>(kSourceUniformName, environment);
+  uniforms[1] = registry_->Create<Uniform>(
+      kGridSizeUniformName,
+      static_cast<int>(std::min(source_size, kMaxShGridSize)));
+  const FramebufferObjectPtr previous_fbo = renderer->GetCurrentFramebuffer();
+  fbo_->Resize(count, 1U);
+  fbo_->SetColorAttachment(0U, FramebufferObject::Attachment(target));
+  Draw(renderer, sh_program_, uniforms, count, 1U);
+  const ImagePtr sums = renderer->ReadImage(
+      math::Range2i::BuildWithSize(math::Point2i(0, 0),
+                                   math::Vector2i(static_cast<int>(count), 1)),
+      Image::kRgba32f, allocator_);
+  renderer->BindFramebuffer(previous_fbo);
+  if (!sums.Get() || !sums->GetData().Get() || !sums->GetData()->GetData()) {
+    LOG(ERROR) << "EnvironmentMapGenerator::ComputeIrradianceSh: unable to"
+               << " read the coefficients";
+    return false;
+  }
+
+  // Convolving radiance with the clamped cosine scales each band by a
+  // constant (Ramamoorthi and Hanrahan, 2001).
+  static const float kBandScales[3] = {
+      3.14159265f, 2.09439510f, 0.78539816f};
+  const float* values = sums->GetData()->GetData<float>();
+  for (size_t i = 0; i < kShCoefficientCount; ++i) {
+    const float scale = kBandScales[i == 0U ? 0 : (i < 4U ? 1 : 2)];
+    coefficients[i].Set(values[i * 4U] * scale, values[i * 4U + 1U] * scale,
+                        values[i * 4U + 2U] * scale);
+  }
+  return true;
+}
+
+const std::vector<std::vector<ImagePtr>> EnvironmentMapGenerator::ReadCubeMap(
+    gfx::Renderer* renderer, const CubeMapTexturePtr& texture) {
+  std::vector<std::vector<ImagePtr>> faces;
+  if (!renderer || !texture.Get() || !GetFaceSize(*texture))
+    return faces;
+  const uint32 face_size = GetFaceSize(*texture);
+  const Image* immutable_image = texture->GetImmutableImage().Get();
+  faces.resize(6U);
+  const FramebufferObjectPtr previous_fbo = renderer->GetCurrentFramebuffer();
+  for (int face = 0; face < 6; ++face) {
+    const CubeMapTexture::CubeFace cube_face =
+        static_cast<CubeMapTexture::CubeFace>(face);
+    const size_t level_count = immutable_image
+                                   ? texture->GetImmutableLevels()
+                                   : texture->GetImageCount(cube_face);
+    for (size_t level = 0; level < level_count; ++level) {
+      const Image* image = immutable_image;
+      if (!image && texture->HasImage(cube_face, level))
+        image = texture->GetImage(cube_face, level).Get();
+      if (!image)
+        break;
+      const uint32 size = std::max(face_size >> level, 1U);
+      fbo_->Resize(size, size);
+      fbo_->SetColorAttachment(
+          0U, FramebufferObject::Attachment(texture, cube_face, level));
+      renderer->BindFramebuffer(fbo_);
+      faces[face].push_back(renderer->ReadImage(
+          math::Range2i::BuildWithSize(
+              math::Point2i(0, 0),
+              math::Vector2i(static_cast<int>(size), static_cast<int>(size))),
+          image->GetFormat(), allocator_));
+    }
+  }
+  renderer->BindFramebuffer(previous_fbo);
+  return faces;
+}
+
+const CubeMapTexturePtr EnvironmentMapGenerator::CreateCubeMap(
+    uint32 face_size, size_t level_count, Image::Format format) const {
+  CubeMapTexturePtr cube_map(new (allocator_) CubeMapTexture);
+  for (int face = 0; face < 6; ++face) {
+    for (size_t level = 0; level < level_count; ++level) {
+      const uint32 size = std::max(face_size >> level, 1U);
+      ImagePtr image(new (allocator_) Image);
+      image->Set(format, size, size, base::DataContainerPtr());
+      cube_map->SetImage(static_cast<CubeMapTexture::CubeFace>(face), level,
+                         image);
+    }
+  }
+  if (level_count < CountLevels(face_size))
+    cube_map->SetMaxLevel(static_cast<int>(level_count) - 1);
+  gfx::SamplerPtr sampler(new (allocator_) gfx::Sampler);
+  sampler->SetMinFilter(level_count > 1U ? gfx::Sampler::kLinearMipmapLinear
+                                         : gfx::Sampler::kLinear);
+  sampler->SetMagFilter(gfx::Sampler::kLinear);
+  sampler->SetWrapS(gfx::Sampler::kClampToEdge);
+  sampler->SetWrapT(gfx::Sampler::kClampToEdge);
+  sampler->SetWrapR(gfx::Sampler::kClampToEdge);
+  cube_map->SetSampler(sampler);
+  return cube_map;
+}
+
+void EnvironmentMapGenerator::Draw(gfx::Renderer* renderer,
+                                   const ShaderProgramPtr& program,
+                                   const std::vector<Uniform>& uniforms,
+                                   uint32 width, uint32 height) {
+  gfx::StateTablePtr state_table(
+      new (allocator_) gfx::StateTable(width, height));
+  state_table->SetViewport(0, 0, width, height);
+  state_table->Enable(gfx::StateTable::kBlend, false);
+  state_table->Enable(gfx::StateTable::kCullFace, false);
+  state_table->Enable(gfx::StateTable::kDepthTest, false);
+  gfx::NodePtr node(new (allocator_) gfx::Node);
+  node->SetLabel("Environment map");
+  node->SetStateTable(state_table);
+  node->SetShaderProgram(program);
+  for (size_t i = 0; i < uniforms.size(); ++i)
+    node->AddUniform(uniforms[i]);
+  node->AddShape(quad_);
+  renderer->BindFramebuffer(fbo_);
+  renderer->DrawScene(node);
+}
+
+}  // namespace gfxutils
+}  // namespace ion
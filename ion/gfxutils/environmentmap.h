@@ -0,0 +1,158 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef ION_GFXUTILS_ENVIRONMENTMAP_H_
+#define ION_GFXUTILS_ENVIRONMENTMAP_H_
+
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/gfx/cubemaptexture.h"
+#include "ion/gfx/framebufferobject.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/texture.h"
+#include "ion/gfx/uniform.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace gfxutils {
+
+// EnvironmentMapGenerator creates the textures used for image-based lighting
+// on the GPU, by drawing into the faces and mipmap levels of CubeMapTextures
+// through a FramebufferObject. This takes milliseconds where the equivalent
+// CPU code takes seconds, so environments can be updated at runtime. It can:
+//  - Convert an equirectangular (latitude-longitude) panorama into a cube map.
+//  - Prefilter an environment cube map with the GGX distribution, storing
+//    increasingly rough reflections in successive mipmap levels.
+//  - Project the irradiance of an environment onto spherical harmonics.
+// The cube maps can be read back with ReadCubeMap() and cached on disk with
+// image::WriteKtxContainer(), and loaded again with
+// image::ReadTextureContainer() and image::CreateCubeMapTextureFromContainer().
+//
+// Typical usage:
+//   EnvironmentMapGenerator generator(allocator);
+//   CubeMapTexturePtr environment = generator.ConvertEquirectangular(
+//       renderer.Get(), panorama, 256U, 9U, Image::kRgba16fHalf);
+//   CubeMapTexturePtr specular = generator.Prefilter(
+//       renderer.Get(), environment, 128U, 6U, Image::kRgba16fHalf);
+//   math::Vector3f sh[EnvironmentMapGenerator::kShCoefficientCount];
+//   generator.ComputeIrradianceSh(renderer.Get(), environment, sh);
+//
+// Each function draws immediately, restoring the framebuffer bound to the
+// Renderer afterwards. The formats of generated cube maps must be color
+// renderable; floating point formats need float render targets, e.g., through
+// GL_EXT_color_buffer_float, and ComputeIrradianceSh() always uses a float
+// render target. Shaders only use OpenGL ES 2.0 features, so mipmap levels of
+// the sampled environment are chosen with LOD biases rather than explicit
+// levels.
+class ION_API EnvironmentMapGenerator {
+ public:
+  // The number of coefficients computed by ComputeIrradianceSh().
+  static const size_t kShCoefficientCount = 9U;
+  // The maximum number of samples of each prefiltered texel.
+  static const uint32 kMaxSampleCount = 1024U;
+  // The maximum number of directions along each side of a face that are
+  // sampled by ComputeIrradianceSh().
+  static const uint32 kMaxShGridSize = 64U;
+
+  // The passed allocator is used for all allocations; if it is NULL, the
+  // default allocator is used.
+  explicit EnvironmentMapGenerator(const base::AllocatorPtr& allocator);
+  ~EnvironmentMapGenerator();
+
+  // Sets the number of GGX samples taken for each texel by Prefilter(), which
+  // is clamped to [1, kMaxSampleCount] and defaults to 64. The samples read
+  // coarser levels of the environment as roughness increases, so even few
+  // samples give smooth results if the environment has mipmaps.
+  void SetSampleCount(uint32 count);
+  uint32 GetSampleCount() const { return sample_count_; }
+
+  // Returns a cube map with faces of face_size in format, holding the
+  // equirectangular image of texture in level_count mipmap levels, each drawn
+  // from the texture at its own size. The longitude of the panorama increases
+  // with S from -X through -Z, +X and +Z, and its latitude with T from -Y to
+  // +Y. The
+  // level count is clamped to the full mipmap chain. Returns a NULL pointer,
+  // and logs an error, if any argument is invalid.
+  const gfx::CubeMapTexturePtr ConvertEquirectangular(
+      gfx::Renderer* renderer, const gfx::TexturePtr& texture,
+      uint32 face_size, size_t level_count, gfx::Image::Format format);
+
+  // Returns a cube map with faces of face_size in format, holding level_count
+  // mipmap levels of environment prefiltered with the GGX distribution for
+  // the split-sum approximation, assuming that the view direction equals the
+  // normal. Level l has a roughness of l / (level_count - 1), so level 0 is a
+  // copy of environment. Returns a NULL pointer, and logs an error, if any
+  // argument is invalid.
+  const gfx::CubeMapTexturePtr Prefilter(
+      gfx::Renderer* renderer, const gfx::CubeMapTexturePtr& environment,
+      uint32 face_size, size_t level_count, gfx::Image::Format format);
+
+  // Projects the irradiance of environment onto the first three bands of real
+  // spherical harmonics, sampling up to kMaxShGridSize directions along each
+  // side of its faces, and stores their coefficients in coefficients. The
+  // irradiance in direction n is then the sum of coefficients[i] * Y_i(n),
+  // where Y_0 = 0.282095, (Y_1, Y_2, Y_3) = 0.488603 * (y, z, x),
+  // (Y_4, Y_5, Y_7) = 1.092548 * (xy, yz, xz), Y_6 = 0.315392 * (3z^2 - 1)
+  // and Y_8 = 0.546274 * (x^2 - y^2); a diffuse surface reflects albedo / pi
+  // times the irradiance. Returns false, and logs an error, if any argument
+  // is invalid or the result cannot be read.
+  bool ComputeIrradianceSh(gfx::Renderer* renderer,
+                           const gfx::CubeMapTexturePtr& environment,
+                           math::Vector3f coefficients[kShCoefficientCount]);
+
+  // Reads all faces and mipmap levels of texture from OpenGL, e.g., to cache
+  // a generated cube map. The images are in the format of each level, indexed
+  // by gfx::CubeMapTexture::CubeFace and then level, as in
+  // image::TextureContainerImages. Returns an empty vector if texture is NULL
+  // or has no images.
+  const std::vector<std::vector<gfx::ImagePtr>> ReadCubeMap(
+      gfx::Renderer* renderer, const gfx::CubeMapTexturePtr& texture);
+
+ private:
+  // Returns a cube map with face_size faces and level_count levels in format
+  // whose images have no data, for drawing into.
+  const gfx::CubeMapTexturePtr CreateCubeMap(uint32 face_size,
+                                             size_t level_count,
+                                             gfx::Image::Format format) const;
+  // Draws program with uniforms into the current color attachment of the
+  // framebuffer, whose size is width x height.
+  void Draw(gfx::Renderer* renderer, const gfx::ShaderProgramPtr& program,
+            const std::vector<gfx::Uniform>& uniforms, uint32 width,
+            uint32 height);
+
+  base::AllocatorPtr allocator_;
+  uint32 sample_count_;
+  gfx::ShaderInputRegistryPtr registry_;
+  gfx::ShaderProgramPtr equirectangular_program_;
+  gfx::ShaderProgramPtr prefilter_program_;
+  gfx::ShaderProgramPtr sh_program_;
+  gfx::ShapePtr quad_;
+  gfx::FramebufferObjectPtr fbo_;
+
+  DISALLOW_COPY_AND_ASSIGN(EnvironmentMapGenerator);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_ENVIRONMENTMAP_H_
@@ -0,0 +1,111 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/externaltexture.h"
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/sampler.h"
+
+namespace ion {
+namespace gfxutils {
+
+ExternalTexture::ExternalTexture(const gfx::GraphicsManagerPtr& gm,
+                                 const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      gm_(gm),
+      texture_(new (allocator_) gfx::Texture),
+      image_(NULL),
+      pending_(allocator_) {
+  DCHECK(gm_.Get());
+  gfx::SamplerPtr sampler(new (allocator_) gfx::Sampler);
+  sampler->SetLabel("External texture sampler");
+  sampler->SetMinFilter(gfx::Sampler::kLinear);
+  sampler->SetMagFilter(gfx::Sampler::kLinear);
+  sampler->SetWrapS(gfx::Sampler::kClampToEdge);
+  sampler->SetWrapT(gfx::Sampler::kClampToEdge);
+  texture_->SetLabel("External texture");
+  texture_->SetSampler(sampler);
+  // The image determines that the texture target is GL_TEXTURE_EXTERNAL_OES
+  // even before the first image is set.
+  SetImage(NULL, ReleaseCallback());
+}
+
+ExternalTexture::~ExternalTexture() {
+  SetImage(NULL, ReleaseCallback());
+  ReleaseFinishedImages(true);
+}
+
+const char* ExternalTexture::GetShaderExtension() {
+  return "#extension GL_OES_EGL_image_external : require\n";
+}
+
+void ExternalTexture::SetImage(void* image, const ReleaseCallback& release) {
+  if (image_) {
+    // The fence follows all commands that may read from the replaced image.
+    PendingImage pending;
+    pending.image = image_;
+    pending.release = release_;
+    pending.fence =
+        gm_->IsFunctionGroupAvailable(gfx::GraphicsManager::kSync)
+            ? gm_->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)
+            : NULL;
+    if (!pending.fence)
+      gm_->Finish();
+    pending_.push_back(pending);
+  }
+  image_ = image;
+  release_ = release;
+
+  // The DataContainer only wraps the EGLImage; it never deletes it.
+  gfx::ImagePtr texture_image(new (allocator_) gfx::Image);
+  texture_image->SetExternalEglImage(
+      image ? base::DataContainer::Create<void>(
+                  image, kNullFunction, false, allocator_)
+            : base::DataContainerPtr());
+  texture_->SetImage(0U, texture_image);
+  ReleaseFinishedImages(false);
+}
+
+size_t ExternalTexture::ReleaseFinishedImages(bool wait) {
+  // Wait in one second intervals, in nanoseconds.
+  static const GLuint64 kTimeout = 1000000000U;
+  size_t count = 0;
+  while (!pending_.empty()) {
+    PendingImage& pending = pending_.front();
+    if (pending.fence) {
+      GLenum status;
+      do {
+        status = gm_->ClientWaitSync(pending.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     wait ? kTimeout : 0U);
+      } while (wait && status == GL_TIMEOUT_EXPIRED);
+      // Later images cannot have finished before this one.
+      if (status == GL_TIMEOUT_EXPIRED)
+        break;
+      gm_->DeleteSync(pending.fence);
+    }
+    if (pending.release)
+      pending.release(pending.image);
+    pending_.pop_front();
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,115 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_EXTERNALTEXTURE_H_
+#define ION_GFXUTILS_EXTERNALTEXTURE_H_
+
+#include <functional>
+
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocdeque.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/texture.h"
+
+namespace ion {
+namespace gfxutils {
+
+// ExternalTexture shows images produced outside of Ion, such as camera or
+// video frames, without copying them through the CPU. Each image is an
+// EGLImage created by the application from a platform buffer, e.g., with
+// eglCreateImageKHR() and EGL_NATIVE_BUFFER_ANDROID from an AHardwareBuffer;
+// the Texture returned by GetTexture() is bound to the current image with
+// glEGLImageTargetTexture2DOES() instead of being uploaded. Shaders sample it
+// with a samplerExternalOES uniform, declared after GetShaderExtension().
+//
+// The producer of the images must not reuse a buffer while OpenGL may still
+// read from it. When SetImage() replaces an image, a fence is inserted after
+// the commands that drew with it, and the image's release callback is invoked
+// only once the fence has been signaled, so the buffer can then be returned
+// to the camera or decoder.
+//
+// Typical usage:
+//   ExternalTexture external(gm, allocator);
+//   node->AddUniform(reg->Create<Uniform>("uCamera", external.GetTexture()));
+//   ...
+//   // Every frame:
+//   external.SetImage(egl_image, [](void* image) { ReturnToCamera(image); });
+//   renderer->DrawScene(node);
+//
+// Images are released in the order they were set. The GraphicsManager's
+// OpenGL context must be current when SetImage(), ReleaseFinishedImages() and
+// the destructor are called. Without sync objects, i.e., if the kSync
+// function group is not available, SetImage() calls glFinish() before
+// releasing the replaced image.
+class ION_API ExternalTexture {
+ public:
+  // Invoked with an image that OpenGL no longer reads from.
+  typedef std::function<void(void* image)> ReleaseCallback;
+
+  // The passed allocator is used for all allocations; if it is NULL, the
+  // default allocator is used.
+  ExternalTexture(const gfx::GraphicsManagerPtr& gm,
+                  const base::AllocatorPtr& allocator);
+  // Waits until OpenGL has finished with all images and releases them.
+  ~ExternalTexture();
+
+  // Returns the line that enables samplerExternalOES in a shader, which must
+  // be placed at the start of the shader source, after any #version line.
+  static const char* GetShaderExtension();
+
+  // Makes the texture show the passed EGLImage, invoking release with it once
+  // OpenGL no longer reads from it. Any previous image is released as
+  // described in the class comment. Passing NULL clears the texture.
+  void SetImage(void* image, const ReleaseCallback& release);
+  // Returns the current image, or NULL.
+  void* GetImage() const { return image_; }
+
+  // Releases the replaced images that OpenGL has finished with, returning how
+  // many were released. If wait is true, waits for all of them. SetImage()
+  // calls this without waiting.
+  size_t ReleaseFinishedImages(bool wait);
+  // Returns the number of replaced images that have not been released.
+  size_t GetPendingImageCount() const { return pending_.size(); }
+
+  // Returns the Texture showing the current image. Its Sampler clamps to the
+  // edges and filters linearly without mipmaps, which is all that external
+  // textures support.
+  const gfx::TexturePtr& GetTexture() const { return texture_; }
+
+ private:
+  // An image that was replaced, and the fence after its last use.
+  struct PendingImage {
+    void* image;
+    ReleaseCallback release;
+    GLsync fence;
+  };
+
+  base::AllocatorPtr allocator_;
+  gfx::GraphicsManagerPtr gm_;
+  gfx::TexturePtr texture_;
+  void* image_;
+  ReleaseCallback release_;
+  base::AllocDeque<PendingImage> pending_;
+
+  DISALLOW_COPY_AND_ASSIGN(ExternalTexture);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_EXTERNALTEXTURE_H_
@@ -20,6 +20,7 @@ limitations under the License.
 #include <algorithm>
 
 #include "ion/base/logging.h"
+#include "ion/profile/tracerecorder.h"
 
 namespace ion {
 namespace gfxutils {
@@ -28,14 +29,78 @@ Frame::Frame()
     : counter_(0),
       in_frame_(false),
       pre_frame_callbacks_(*this),
-      post_frame_callbacks_(*this) {}
+      post_frame_callbacks_(*this),
+      fences_(*this),
+      trace_recorder_(NULL),
+      last_wait_time_(0.0),
+      last_frame_time_(0.0) {}
+
+Frame::~Frame() {
+  if (!gm_.Get())
+    return;
+  for (size_t i = 0; i < fences_.size(); ++i) {
+    if (fences_[i])
+      gm_->DeleteSync(fences_[i]);
+  }
+}
+
+void Frame::SetGraphicsManager(const gfx::GraphicsManagerPtr& gm) {
+  if (gm.Get() != gm_.Get()) {
+    WaitForAllSlots();
+    gm_ = gm;
+  }
+}
+
+void Frame::SetMaxFramesInFlight(size_t count) {
+  if (count != fences_.size()) {
+    WaitForAllSlots();
+    fences_.assign(count, static_cast<GLsync>(NULL));
+  }
+}
 
-Frame::~Frame() {}
+bool Frame::IsPacing() const {
+  return !fences_.empty() && gm_.Get() &&
+         gm_->IsFunctionGroupAvailable(gfx::GraphicsManager::kSync);
+}
+
+void Frame::WaitForSlot(size_t slot) {
+  if (GLsync sync = fences_[slot]) {
+    // Wait in one second intervals, in nanoseconds.
+    static const GLuint64 kTimeout = 1000000000U;
+    while (gm_->ClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, kTimeout) ==
+           GL_TIMEOUT_EXPIRED) {}
+    gm_->DeleteSync(sync);
+    fences_[slot] = NULL;
+  }
+}
+
+void Frame::WaitForAllSlots() {
+  if (!gm_.Get())
+    return;
+  for (size_t i = 0; i < fences_.size(); ++i)
+    WaitForSlot(i);
+}
 
 void Frame::Begin() {
   if (in_frame_) {
     LOG(ERROR) << "Frame::Begin() called while already in a frame.";
   } else {
+    // Wait until OpenGL has finished the last frame that used this slot.
+    last_wait_time_ = 0.0;
+    if (IsPacing() && fences_[GetFrameSlot()]) {
+      uint32 range_id = 0U;
+      if (trace_recorder_)
+        range_id = trace_recorder_->EnterTimeRange("Frame GPU wait", NULL);
+      port::Timer wait_timer;
+      WaitForSlot(GetFrameSlot());
+      last_wait_time_ = wait_timer.GetInS();
+      if (trace_recorder_)
+        trace_recorder_->LeaveTimeRange(range_id);
+    }
+    if (trace_recorder_)
+      trace_recorder_->EnterFrame(static_cast<uint32>(counter_));
+    frame_timer_.Reset();
+
     // Invoke all pre-frame callbacks.
     for (CallbackMap::const_iterator it = pre_frame_callbacks_.begin();
          it != pre_frame_callbacks_.end(); ++it)
@@ -52,6 +117,17 @@ void Frame::End() {
     for (CallbackMap::const_iterator it = post_frame_callbacks_.begin();
          it != post_frame_callbacks_.end(); ++it)
       it->second(*this);
+
+    // Mark the end of the frame's commands so that a later Begin() can wait
+    // for them.
+    if (IsPacing()) {
+      const size_t slot = GetFrameSlot();
+      WaitForSlot(slot);
+      fences_[slot] = gm_->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    last_frame_time_ = frame_timer_.GetInS();
+    if (trace_recorder_)
+      trace_recorder_->LeaveFrame();
     in_frame_ = false;
     ++counter_;
   }
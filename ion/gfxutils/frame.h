@@ -24,12 +24,29 @@ limitations under the License.
 #include "base/integral_types.h"
 #include "ion/base/referent.h"
 #include "ion/base/stlalloc/allocmap.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/port/timer.h"
 
 namespace ion {
+namespace profile {
+class TraceRecorder;
+}  // namespace profile
+
 namespace gfxutils {
 
 // Frame manages an application-defined frame of execution. It can be used to
 // install pre- and post-frame callbacks for tracing, timing, and so on.
+//
+// A Frame can also pace rendering so that the CPU does not get too far ahead
+// of OpenGL, which keeps latency stable instead of depending on how many
+// frames the driver chooses to queue. When a GraphicsManager that supports
+// sync objects is set and the number of frames in flight is limited, End()
+// inserts a fence after the commands of the frame, and Begin() waits until
+// OpenGL has finished the frame that last used the same frame slot. Per-frame
+// ring buffers, e.g., of dynamic vertex or uniform data, can then be indexed
+// by GetFrameSlot(): the entry for the slot is no longer in use by OpenGL when
+// the pre-frame callbacks are invoked.
 class ION_API Frame : public base::Referent {
  public:
   // Callback that can be invoked at the beginning or end of a frame. It is
@@ -57,6 +74,46 @@ class ION_API Frame : public base::Referent {
   // Returns true if Begin() was called and End() was not.
   bool IsInFrame() const { return in_frame_; }
 
+  // Sets/returns the GraphicsManager used to pace frames; see
+  // SetMaxFramesInFlight(). Its OpenGL context must be current when Begin()
+  // and End() are called, and when the Frame is destroyed. Changing the
+  // GraphicsManager first waits for all frames in flight.
+  void SetGraphicsManager(const gfx::GraphicsManagerPtr& gm);
+  const gfx::GraphicsManagerPtr& GetGraphicsManager() const { return gm_; }
+
+  // Sets/returns the number of frames that OpenGL may still be processing
+  // when a new frame begins, which is also the number of frame slots. If this
+  // is 0, frames are not paced and GetFrameSlot() always returns 0. Changing
+  // it first waits for all frames in flight. The default is 0.
+  void SetMaxFramesInFlight(size_t count);
+  size_t GetMaxFramesInFlight() const { return fences_.size(); }
+
+  // Returns the slot of the current frame, or of the next one if the Frame
+  // is not in a frame. Frames use the slots in turn. The slot is only safe to
+  // reuse as described in the class comment if frames are actually paced,
+  // i.e., if the GraphicsManager supports the kSync function group.
+  size_t GetFrameSlot() const {
+    return fences_.empty() ? 0U : static_cast<size_t>(counter_ %
+                                                      fences_.size());
+  }
+
+  // Returns the time in seconds that the last call to Begin() waited for
+  // OpenGL to finish an earlier frame.
+  double GetLastWaitTime() const { return last_wait_time_; }
+
+  // Returns the time in seconds between the last matching calls to Begin()
+  // and End(), excluding the time spent waiting in Begin().
+  double GetLastFrameTime() const { return last_frame_time_; }
+
+  // Sets a TraceRecorder that records the frames, i.e., a frame event with
+  // the counter as its number between Begin() and End(), and a
+  // "Frame GPU wait" time range for each wait in Begin(). The recorder must
+  // outlive its use by the Frame; pass NULL to stop recording.
+  void SetTraceRecorder(profile::TraceRecorder* recorder) {
+    trace_recorder_ = recorder;
+  }
+  profile::TraceRecorder* GetTraceRecorder() const { return trace_recorder_; }
+
   // Adds a callback to be invoked when Begin() or End() is called. The
   // callback is identified by the passed key.
   void AddPreFrameCallback(const std::string& key, const Callback& callback);
@@ -74,10 +131,26 @@ class ION_API Frame : public base::Referent {
   // The destructor is private because this is derived from base::Referent.
   ~Frame() override;
 
+  // Returns whether frames are paced with fences.
+  bool IsPacing() const;
+  // Waits for the fence in |slot|, if any, and deletes it.
+  void WaitForSlot(size_t slot);
+  // Waits for the fences of all slots.
+  void WaitForAllSlots();
+
   uint64 counter_;
   bool in_frame_;
   CallbackMap pre_frame_callbacks_;
   CallbackMap post_frame_callbacks_;
+  gfx::GraphicsManagerPtr gm_;
+  // The fence inserted at the end of the last frame that used each slot, or
+  // NULL.
+  base::AllocVector<GLsync> fences_;
+  profile::TraceRecorder* trace_recorder_;
+  // Measures the time spent in the current frame.
+  port::Timer frame_timer_;
+  double last_wait_time_;
+  double last_frame_time_;
 };
 
 // Convenience typedef for shared pointer to a Frame.
@@ -30,24 +30,63 @@
       'target_name' : 'iongfxutils',
       'type': 'static_library',
       'sources': [
+        'attributelayout.cc',
+        'attributelayout.h',
+        'bonepalette.cc',
+        'bonepalette.h',
         'buffertoattributebinder.cc',
         'buffertoattributebinder.h',
+        'environmentmap.cc',
+        'environmentmap.h',
+        'externaltexture.cc',
+        'externaltexture.h',
         'frame.cc',
         'frame.h',
+        'idletaskscheduler.cc',
+        'idletaskscheduler.h',
+        'meshoptimizer.cc',
+        'meshoptimizer.h',
+        'meshsimplifier.cc',
+        'meshsimplifier.h',
+        'pagedscene.cc',
+        'pagedscene.h',
+        'particlesimulator.cc',
+        'particlesimulator.h',
+        'polygontriangulator.cc',
+        'polygontriangulator.h',
         'printer.cc',
         'printer.h',
         'resourcecallback.h',
+        'scenefile.cc',
+        'scenefile.h',
+        'sceneoptimizer.cc',
+        'sceneoptimizer.h',
+        'scenesnapshot.cc',
+        'scenesnapshot.h',
         'shadermanager.cc',
         'shadermanager.h',
         'shadersourcecomposer.cc',
         'shadersourcecomposer.h',
+        'shadervariants.cc',
+        'shadervariants.h',
         'shapeutils.cc',
         'shapeutils.h',
+        'texturearraypacker.cc',
+        'texturearraypacker.h',
+        'texturefeedback.cc',
+        'texturefeedback.h',
+        'transformhierarchy.cc',
+        'transformhierarchy.h',
+        'trianglepicker.cc',
+        'trianglepicker.h',
+        'virtualtexture.cc',
+        'virtualtexture.h',
       ],
       'dependencies': [
         '<(ion_dir)/port/port.gyp:ionport',
         '<(ion_dir)/base/base.gyp:ionbase',
         '<(ion_dir)/external/external.gyp:ionopenctm',
+        '<(ion_dir)/profile/profile.gyp:ionprofile',
         '../gfx/gfx.gyp:iongfx',
         '../portgfx/portgfx.gyp:ionportgfx',
       ],
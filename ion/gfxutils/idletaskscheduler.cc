@@ -0,0 +1,171 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/idletaskscheduler.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/lockguards.h"
+#include "ion/profile/tracerecorder.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns a key for the Frame callbacks of scheduler that differs from those
+// of other schedulers.
+static const std::string GetCallbackKey(const IdleTaskScheduler* scheduler) {
+  std::ostringstream out;
+  out << "IdleTaskScheduler " << scheduler;
+  return out.str();
+}
+
+}  // anonymous namespace
+
+IdleTaskScheduler::IdleTaskScheduler(const FramePtr& frame,
+                                     const base::AllocatorPtr& allocator)
+    : frame_(frame),
+      callback_key_(GetCallbackKey(this)),
+      frame_budget_(1.0 / 60.0),
+      reserved_time_(0.001),
+      last_slack_(0.0),
+      render_tasks_(allocator),
+      worker_tasks_(allocator),
+      scheduler_(NULL),
+      running_worker_count_(0U) {
+  if (frame_.Get()) {
+    frame_->AddPreFrameCallback(
+        callback_key_, std::bind(&IdleTaskScheduler::OnFrameBegin, this,
+                                 std::placeholders::_1));
+    frame_->AddPostFrameCallback(
+        callback_key_, std::bind(&IdleTaskScheduler::OnFrameEnd, this,
+                                 std::placeholders::_1));
+  }
+}
+
+IdleTaskScheduler::~IdleTaskScheduler() {
+  if (frame_.Get()) {
+    frame_->RemovePreFrameCallback(callback_key_);
+    frame_->RemovePostFrameCallback(callback_key_);
+  }
+  if (scheduler_)
+    scheduler_->Wait(&worker_group_);
+}
+
+void IdleTaskScheduler::SetTaskScheduler(base::TaskScheduler* scheduler) {
+  if (scheduler_)
+    scheduler_->Wait(&worker_group_);
+  scheduler_ = scheduler;
+}
+
+void IdleTaskScheduler::AddTask(const Task& task, Affinity affinity,
+                                int priority, double estimated_cost) {
+  if (!task)
+    return;
+  QueuedTask queued;
+  queued.task = task;
+  queued.priority = priority;
+  queued.estimated_cost = estimated_cost;
+  base::LockGuard guard(&mutex_);
+  TaskQueue& queue =
+      affinity == kRenderThread ? render_tasks_ : worker_tasks_;
+  // Insert after all tasks of the same or a higher priority.
+  const auto it = std::upper_bound(
+      queue.begin(), queue.end(), queued,
+      [](const QueuedTask& a, const QueuedTask& b) {
+        return a.priority > b.priority;
+      });
+  queue.insert(it, queued);
+}
+
+size_t IdleTaskScheduler::GetQueuedTaskCount(Affinity affinity) const {
+  base::LockGuard guard(&mutex_);
+  return affinity == kRenderThread ? render_tasks_.size()
+                                   : worker_tasks_.size();
+}
+
+size_t IdleTaskScheduler::RunTasks(double slack) {
+  size_t count = 0U;
+  port::Timer timer;
+  Task task;
+  if (scheduler_) {
+    const size_t max_running =
+        std::max(scheduler_->GetThreadCount(), static_cast<size_t>(1U));
+    while (running_worker_count_ < max_running &&
+           PopTask(&worker_tasks_, slack, &task)) {
+      SubmitWorkerTask(task);
+      ++count;
+    }
+  }
+  // The cost of each task is compared with the slack that is actually left,
+  // since earlier tasks may have taken longer than estimated.
+  for (;;) {
+    const double remaining = slack - timer.GetInS();
+    if (remaining <= 0.0)
+      break;
+    if (!PopTask(&render_tasks_, remaining, &task) &&
+        (scheduler_ || !PopTask(&worker_tasks_, remaining, &task)))
+      break;
+    task();
+    ++count;
+  }
+  return count;
+}
+
+bool IdleTaskScheduler::PopTask(TaskQueue* queue, double max_cost,
+                                Task* task) {
+  base::LockGuard guard(&mutex_);
+  for (auto it = queue->begin(); it != queue->end(); ++it) {
+    if (it->estimated_cost <= max_cost) {
+      *task = it->task;
+      queue->erase(it);
+      return true;
+    }
+  }
+  return false;
+}
+
+void IdleTaskScheduler::SubmitWorkerTask(const Task& task) {
+  ++running_worker_count_;
+  scheduler_->Submit(
+      [this, task]() {
+        task();
+        --running_worker_count_;
+      },
+      &worker_group_);
+}
+
+void IdleTaskScheduler::OnFrameBegin(const Frame& frame) {
+  frame_timer_.Reset();
+}
+
+void IdleTaskScheduler::OnFrameEnd(const Frame& frame) {
+  last_slack_ = frame_budget_ - reserved_time_ - frame_timer_.GetInS();
+  if (last_slack_ <= 0.0)
+    return;
+  profile::TraceRecorder* recorder = frame.GetTraceRecorder();
+  const uint32 range_id =
+      recorder ? recorder->EnterTimeRange("Idle tasks", NULL) : 0U;
+  RunTasks(last_slack_);
+  if (recorder)
+    recorder->LeaveTimeRange(range_id);
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,164 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef ION_GFXUTILS_IDLETASKSCHEDULER_H_
+#define ION_GFXUTILS_IDLETASKSCHEDULER_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocdeque.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/gfxutils/frame.h"
+#include "ion/port/mutex.h"
+#include "ion/port/timer.h"
+
+namespace ion {
+namespace gfxutils {
+
+// IdleTaskScheduler runs low-priority work, such as repacking atlases,
+// optimizing meshes, writing caches or destroying old resources, only when a
+// frame has time to spare, so that it never makes a frame miss its deadline.
+//
+// It installs pre- and post-frame callbacks in a Frame that measure how long
+// the frame took up to Frame::End(), which should be called right after the
+// frame has been drawn. The slack of the frame is what remains of the frame
+// budget after that time and a reserve for swapping buffers. Queued tasks are
+// then run in order of priority, and in the order they were added within the
+// same priority, as long as their estimated cost fits in the slack that is
+// left. Tasks that do not fit wait for a later frame, while smaller tasks
+// behind them may still run.
+//
+// Tasks have an affinity. Render thread tasks are run by Frame::End() on the
+// thread that draws, so they may use OpenGL. Worker tasks are handed to a
+// base::TaskScheduler while the frame has slack, if their estimated cost fits
+// in it so that they are likely to be done before the next frame starts, and
+// only one per worker thread at a time. Without a TaskScheduler, worker tasks
+// are run like render thread tasks.
+//
+// Typical usage:
+//   IdleTaskScheduler idle(frame, allocator);
+//   idle.SetTaskScheduler(scheduler);
+//   idle.AddTask(repack_atlas, IdleTaskScheduler::kRenderThread, 0, .002);
+//   ...
+//   // Every frame:
+//   frame->Begin();
+//   renderer->DrawScene(root);
+//   frame->End();
+//
+// The time spent in render thread tasks is traced as an "Idle tasks" time
+// range if the Frame has a TraceRecorder.
+class ION_API IdleTaskScheduler {
+ public:
+  typedef std::function<void()> Task;
+
+  enum Affinity {
+    kRenderThread,
+    kWorkerThread
+  };
+
+  // Creates a scheduler that runs tasks at the end of each frame of frame.
+  // If frame is NULL, tasks are only run by RunTasks(). The passed allocator
+  // is used for all allocations; if it is NULL, the default allocator is
+  // used.
+  IdleTaskScheduler(const FramePtr& frame, const base::AllocatorPtr& allocator);
+  // Removes the callbacks from the Frame and waits for all worker tasks
+  // handed to the TaskScheduler. Queued tasks are discarded.
+  ~IdleTaskScheduler();
+
+  // Sets/returns the time in seconds that a frame may take, which defaults to
+  // 1/60 second.
+  void SetFrameBudget(double seconds) { frame_budget_ = seconds; }
+  double GetFrameBudget() const { return frame_budget_; }
+  // Sets/returns the time in seconds at the end of each frame budget that is
+  // never used for tasks, to leave time for swapping buffers and timing
+  // jitter. The default is 1 millisecond.
+  void SetReservedTime(double seconds) { reserved_time_ = seconds; }
+  double GetReservedTime() const { return reserved_time_; }
+
+  // Sets the TaskScheduler that worker tasks are handed to, which must
+  // outlive this. Changing it first waits for the worker tasks handed to the
+  // previous one.
+  void SetTaskScheduler(base::TaskScheduler* scheduler);
+  base::TaskScheduler* GetTaskScheduler() const { return scheduler_; }
+
+  // Queues task to run with the passed affinity when a frame has at least
+  // estimated_cost seconds of slack. Tasks with a higher priority run first.
+  // This may be called from any thread, including from tasks.
+  void AddTask(const Task& task, Affinity affinity, int priority,
+               double estimated_cost);
+  // Returns the number of queued tasks with the passed affinity.
+  size_t GetQueuedTaskCount(Affinity affinity) const;
+  // Returns the number of worker tasks handed to the TaskScheduler that have
+  // not finished.
+  size_t GetRunningWorkerTaskCount() const { return running_worker_count_; }
+
+  // Runs and hands off the queued tasks that fit in slack seconds, as if a
+  // frame ended with that much slack. Returns the number of tasks run or
+  // handed off. This is called by Frame::End(), but may also be called
+  // directly, e.g., when no Frame is used.
+  size_t RunTasks(double slack);
+
+  // Returns the slack of the last frame that ended, which is negative if the
+  // frame took longer than its budget.
+  double GetLastSlack() const { return last_slack_; }
+
+ private:
+  struct QueuedTask {
+    Task task;
+    int priority;
+    double estimated_cost;
+  };
+  typedef base::AllocDeque<QueuedTask> TaskQueue;
+
+  // Removes and returns in task the first task in queue whose estimated cost
+  // is at most max_cost. Returns false if there is none.
+  bool PopTask(TaskQueue* queue, double max_cost, Task* task);
+  // Hands task to the TaskScheduler.
+  void SubmitWorkerTask(const Task& task);
+
+  // Frame callbacks.
+  void OnFrameBegin(const Frame& frame);
+  void OnFrameEnd(const Frame& frame);
+
+  FramePtr frame_;
+  // The key of the callbacks in frame_.
+  const std::string callback_key_;
+  double frame_budget_;
+  double reserved_time_;
+  double last_slack_;
+  // Measures the time since the current frame began.
+  port::Timer frame_timer_;
+
+  // The queued tasks of each affinity, protected by mutex_.
+  TaskQueue render_tasks_;
+  TaskQueue worker_tasks_;
+  mutable port::Mutex mutex_;
+
+  base::TaskScheduler* scheduler_;
+  base::TaskScheduler::TaskGroup worker_group_;
+  std::atomic<size_t> running_worker_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(IdleTaskScheduler);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_IDLETASKSCHEDULER_H_
@@ -0,0 +1,862 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/meshoptimizer.h"
+
+#include <string.h>  // For memcmp() and memcpy().
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/base/scopedallocation.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/math/vector.h"
+#include "ion/math/vectorutils.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using math::Point3f;
+using math::Vector3f;
+
+typedef base::AllocVector<uint32> IndexVector;
+
+// Marks vertices that have not been assigned a new index, and the end of the
+// triangle walk in ReorderTriangles().
+static const uint32 kNoVertex = static_cast<uint32>(-1);
+
+// The largest number of vertices that unsigned short indices can address.
+static const size_t kMaxShortVertexCount = 65536U;
+
+// Returns a short-term Allocator for temporary data.
+static const base::AllocatorPtr& GetTemporaryAllocator() {
+  return base::AllocationManager::GetDefaultAllocatorForLifetime(
+      base::kShortTerm);
+}
+
+// Copies |count| indices of type T from |data| into |indices|.
+template <typename T>
+static void ReadIndices(const void* data, size_t count, IndexVector* indices) {
+  const T* typed_data = static_cast<const T*>(data);
+  indices->assign(typed_data, typed_data + count);
+}
+
+// Returns a DataContainer holding |indices| as type T.
+template <typename T>
+static const base::DataContainerPtr WriteIndices(
+    const IndexVector& indices, bool is_wipeable,
+    const base::AllocatorPtr& allocator) {
+  base::ScopedAllocation<T> sa(allocator, indices.size());
+  T* data = sa.Get();
+  for (size_t i = 0; i < indices.size(); ++i)
+    data[i] = static_cast<T>(indices[i]);
+  return sa.TransferToDataContainer(is_wipeable);
+}
+
+// Returns a DataContainer holding |indices| as |type|, with the allocator of
+// |index_buffer| and the wipeable setting of its data.
+static const base::DataContainerPtr WriteIndexData(
+    const IndexVector& indices, gfx::BufferObject::ComponentType type,
+    const gfx::IndexBuffer& index_buffer) {
+  const bool is_wipeable = index_buffer.GetData()->IsWipeable();
+  const base::AllocatorPtr& allocator = index_buffer.GetAllocator();
+  if (type == gfx::BufferObject::kUnsignedByte)
+    return WriteIndices<uint8>(indices, is_wipeable, allocator);
+  else if (type == gfx::BufferObject::kUnsignedShort)
+    return WriteIndices<uint16>(indices, is_wipeable, allocator);
+  else
+    return WriteIndices<uint32>(indices, is_wipeable, allocator);
+}
+
+// Returns the number of vertices used by |indices|.
+static size_t GetUsedVertexCount(const IndexVector& indices) {
+  uint32 max_index = 0;
+  for (const uint32 index : indices)
+    max_index = std::max(max_index, index);
+  return indices.empty() ? 0U : static_cast<size_t>(max_index) + 1U;
+}
+
+// Gets the distinct BufferObjects bound to |attribute_array| and the vertex
+// count they share. Returns false if they do not all have data with the same
+// count, or there are none.
+static bool GetVertexBuffers(const gfx::AttributeArrayPtr& attribute_array,
+                             base::AllocVector<gfx::BufferObjectPtr>* buffers,
+                             size_t* vertex_count) {
+  const size_t attribute_count = attribute_array->GetBufferAttributeCount();
+  for (size_t i = 0; i < attribute_count; ++i) {
+    const gfx::BufferObjectPtr& buffer_object =
+        attribute_array->GetBufferAttribute(i)
+            .GetValue<gfx::BufferObjectElement>().buffer_object;
+    if (!buffer_object.Get())
+      return false;
+    if (std::find(buffers->begin(), buffers->end(), buffer_object) ==
+        buffers->end())
+      buffers->push_back(buffer_object);
+  }
+  if (buffers->empty())
+    return false;
+  *vertex_count = (*buffers)[0]->GetCount();
+  for (const gfx::BufferObjectPtr& buffer_object : *buffers) {
+    const base::DataContainerPtr& data = buffer_object->GetData();
+    if (buffer_object->GetCount() != *vertex_count || !data.Get() ||
+        !data->GetData())
+      return false;
+  }
+  return true;
+}
+
+// Reads the positions of the first |vertex_count| vertices from the
+// "aVertex" attribute of |attribute_array|. Returns false if there is no such
+// attribute with at least 3 float components, or its BufferObject has fewer
+// elements or no data.
+static bool GetPositions(const gfx::AttributeArrayPtr& attribute_array,
+                         size_t vertex_count,
+                         base::AllocVector<Point3f>* positions) {
+  const size_t attribute_count = attribute_array->GetBufferAttributeCount();
+  for (size_t i = 0; i < attribute_count; ++i) {
+    const gfx::Attribute& attribute = attribute_array->GetBufferAttribute(i);
+    if (attribute.GetRegistry().GetSpec(attribute)->name != "aVertex")
+      continue;
+    const gfx::BufferObjectElement& element =
+        attribute.GetValue<gfx::BufferObjectElement>();
+    const gfx::BufferObjectPtr& buffer_object = element.buffer_object;
+    const gfx::BufferObject::Spec& spec =
+        buffer_object->GetSpec(element.spec_index);
+    const base::DataContainerPtr& data_container = buffer_object->GetData();
+    if (spec.type != gfx::BufferObject::kFloat || spec.component_count < 3U ||
+        buffer_object->GetCount() < vertex_count || !data_container.Get() ||
+        !data_container->GetData())
+      return false;
+    const uint8* data = data_container->GetData<uint8>() + spec.byte_offset;
+    const size_t stride = buffer_object->GetStructSize();
+    positions->resize(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+      float xyz[3];
+      memcpy(xyz, data + v * stride, sizeof(xyz));
+      (*positions)[v].Set(xyz[0], xyz[1], xyz[2]);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Returns a hash of the data of vertex |v| in all |buffers|.
+static uint64 HashVertex(const base::AllocVector<gfx::BufferObjectPtr>& buffers,
+                         size_t v) {
+  uint64 hash = 14695981039346656037ULL;
+  for (const gfx::BufferObjectPtr& buffer_object : buffers) {
+    const size_t size = buffer_object->GetStructSize();
+    const uint8* data = buffer_object->GetData()->GetData<uint8>() + v * size;
+    for (size_t i = 0; i < size; ++i)
+      hash = (hash ^ data[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Returns whether vertices |a| and |b| have the same data in all |buffers|.
+static bool AreVerticesEqual(
+    const base::AllocVector<gfx::BufferObjectPtr>& buffers, size_t a,
+    size_t b) {
+  for (const gfx::BufferObjectPtr& buffer_object : buffers) {
+    const size_t size = buffer_object->GetStructSize();
+    const uint8* data = buffer_object->GetData()->GetData<uint8>();
+    if (memcmp(data + a * size, data + b * size, size) != 0)
+      return false;
+  }
+  return true;
+}
+
+// Replaces each index in |indices| that refers to a vertex with the same data
+// as an earlier vertex with the index of that vertex.
+static void MergeDuplicateVertices(
+    const base::AllocVector<gfx::BufferObjectPtr>& buffers,
+    size_t vertex_count, IndexVector* indices) {
+  IndexVector remap(GetTemporaryAllocator(), vertex_count, 0U);
+  base::AllocUnorderedMap<uint64, uint32> first_vertices(
+      GetTemporaryAllocator());
+  first_vertices.reserve(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v) {
+    const uint32 index = static_cast<uint32>(v);
+    const auto inserted =
+        first_vertices.insert(std::make_pair(HashVertex(buffers, v), index));
+    // Vertices whose hashes collide without being equal are not merged.
+    remap[v] = !inserted.second &&
+        AreVerticesEqual(buffers, inserted.first->second, v) ?
+        inserted.first->second : index;
+  }
+  for (uint32& index : *indices)
+    index = remap[index];
+}
+
+// Reorders the triangles of |indices| for a post-transform vertex cache of
+// |cache_size| vertices with the Tipsify algorithm, storing the result in
+// |reordered|. The index of the first triangle of each cluster of the new
+// order is stored in |cluster_starts|; a new cluster starts wherever the walk
+// over the mesh reaches a dead end.
+static void ReorderTriangles(const IndexVector& indices, size_t vertex_count,
+                             size_t cache_size, IndexVector* reordered,
+                             base::AllocVector<size_t>* cluster_starts) {
+  const base::AllocatorPtr& allocator = GetTemporaryAllocator();
+  const size_t triangle_count = indices.size() / 3U;
+
+  // Build the lists of triangles using each vertex, and count the triangles
+  // that still have to be emitted for each vertex.
+  IndexVector live_counts(allocator, vertex_count, 0U);
+  for (const uint32 index : indices)
+    ++live_counts[index];
+  IndexVector offsets(allocator, vertex_count + 1U, 0U);
+  for (size_t v = 0; v < vertex_count; ++v)
+    offsets[v + 1U] = offsets[v] + live_counts[v];
+  IndexVector adjacency(allocator, indices.size(), 0U);
+  {
+    IndexVector cursors(allocator, offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+      adjacency[cursors[indices[i]]++] = static_cast<uint32>(i / 3U);
+  }
+
+  // Vertex v is in the cache if time - cache_times[v] <= cache_size.
+  const uint32 cache = static_cast<uint32>(cache_size);
+  IndexVector cache_times(allocator, vertex_count, 0U);
+  uint32 time = cache + 1U;
+  base::AllocVector<char> emitted(allocator, triangle_count, 0);
+  IndexVector dead_ends(allocator);
+  IndexVector candidates(allocator);
+  size_t cursor = 0;
+
+  // Returns the next vertex to fan around when the candidates are exhausted,
+  // or kNoVertex when all triangles have been emitted.
+  const auto skip_dead_end = [&]() {
+    while (!dead_ends.empty()) {
+      const uint32 v = dead_ends.back();
+      dead_ends.pop_back();
+      if (live_counts[v])
+        return v;
+    }
+    for (; cursor < vertex_count; ++cursor) {
+      if (live_counts[cursor])
+        return static_cast<uint32>(cursor);
+    }
+    return kNoVertex;
+  };
+
+  reordered->clear();
+  reordered->reserve(indices.size());
+  cluster_starts->clear();
+  cluster_starts->push_back(0U);
+  uint32 fan = skip_dead_end();
+  while (fan != kNoVertex) {
+    // Emit all remaining triangles around the fanning vertex.
+    candidates.clear();
+    for (uint32 i = offsets[fan]; i < offsets[fan + 1U]; ++i) {
+      const uint32 triangle = adjacency[i];
+      if (emitted[triangle])
+        continue;
+      emitted[triangle] = 1;
+      for (size_t corner = 0; corner < 3U; ++corner) {
+        const uint32 v = indices[triangle * 3U + corner];
+        reordered->push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        --live_counts[v];
+        if (time - cache_times[v] > cache)
+          cache_times[v] = time++;
+      }
+    }
+
+    // Pick the candidate that is furthest back in the cache but will not have
+    // left it by the time its remaining triangles are emitted.
+    uint32 next = kNoVertex;
+    int64 best_priority = -1;
+    for (const uint32 v : candidates) {
+      if (!live_counts[v])
+        continue;
+      int64 priority = 0;
+      if (time - cache_times[v] + 2U * live_counts[v] <= cache)
+        priority = time - cache_times[v];
+      if (priority > best_priority) {
+        best_priority = priority;
+        next = v;
+      }
+    }
+    if (next == kNoVertex) {
+      next = skip_dead_end();
+      if (next != kNoVertex)
+        cluster_starts->push_back(reordered->size() / 3U);
+    }
+    fan = next;
+  }
+  DCHECK_EQ(indices.size(), reordered->size());
+}
+
+// Sorts the clusters of triangles in |indices| that start at |cluster_starts|
+// so that clusters that are further out along their average normal from the
+// center of the mesh are drawn first. These are the clusters that are most
+// likely to occlude others from any viewpoint.
+static void SortClusters(const IndexVector& indices,
+                         const base::AllocVector<size_t>& cluster_starts,
+                         const base::AllocVector<Point3f>& positions,
+                         IndexVector* sorted) {
+  const base::AllocatorPtr& allocator = GetTemporaryAllocator();
+  const size_t cluster_count = cluster_starts.size();
+  const size_t triangle_count = indices.size() / 3U;
+
+  // Compute the area-weighted centroid and normal of each cluster, and the
+  // centroid of the mesh.
+  base::AllocVector<Vector3f> centroids(allocator, cluster_count,
+                                        Vector3f::Zero());
+  base::AllocVector<Vector3f> normals(allocator, cluster_count,
+                                      Vector3f::Zero());
+  base::AllocVector<float> areas(allocator, cluster_count, 0.f);
+  Vector3f mesh_centroid = Vector3f::Zero();
+  float mesh_area = 0.f;
+  for (size_t c = 0; c < cluster_count; ++c) {
+    const size_t end =
+        c + 1U < cluster_count ? cluster_starts[c + 1U] : triangle_count;
+    for (size_t t = cluster_starts[c]; t < end; ++t) {
+      const Point3f& p0 = positions[indices[t * 3U]];
+      const Point3f& p1 = positions[indices[t * 3U + 1U]];
+      const Point3f& p2 = positions[indices[t * 3U + 2U]];
+      const Vector3f normal = math::Cross(p1 - p0, p2 - p0);
+      const float area = math::Length(normal);
+      centroids[c] += ((p0 - Point3f::Zero()) + (p1 - Point3f::Zero()) +
+                       (p2 - Point3f::Zero())) * (area / 3.f);
+      normals[c] += normal;
+      areas[c] += area;
+    }
+    mesh_centroid += centroids[c];
+    mesh_area += areas[c];
+  }
+  if (mesh_area > 0.f)
+    mesh_centroid /= mesh_area;
+
+  base::AllocVector<float> keys(allocator, cluster_count, 0.f);
+  for (size_t c = 0; c < cluster_count; ++c) {
+    const float normal_length = math::Length(normals[c]);
+    if (areas[c] > 0.f && normal_length > 0.f)
+      keys[c] = math::Dot(centroids[c] / areas[c] - mesh_centroid,
+                          normals[c] / normal_length);
+  }
+  base::AllocVector<size_t> order(allocator, cluster_count, 0U);
+  for (size_t c = 0; c < cluster_count; ++c)
+    order[c] = c;
+  std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+    return keys[a] > keys[b];
+  });
+
+  sorted->clear();
+  sorted->reserve(indices.size());
+  for (const size_t c : order) {
+    const size_t end =
+        c + 1U < cluster_count ? cluster_starts[c + 1U] : triangle_count;
+    sorted->insert(sorted->end(), indices.begin() + cluster_starts[c] * 3U,
+                   indices.begin() + end * 3U);
+  }
+}
+
+// Renumbers the vertices used by |indices|, either in the order in which they
+// are first used or, if |in_order_of_use| is false, in their original order.
+// Unused vertices are removed. The original index of each new vertex is
+// stored in |old_indices|.
+static void CompactVertices(size_t vertex_count, bool in_order_of_use,
+                            IndexVector* indices, IndexVector* old_indices) {
+  IndexVector new_indices(GetTemporaryAllocator(), vertex_count, kNoVertex);
+  old_indices->clear();
+  if (in_order_of_use) {
+    for (const uint32 index : *indices) {
+      if (new_indices[index] == kNoVertex) {
+        new_indices[index] = static_cast<uint32>(old_indices->size());
+        old_indices->push_back(index);
+      }
+    }
+  } else {
+    for (const uint32 index : *indices)
+      new_indices[index] = 0U;
+    for (size_t v = 0; v < vertex_count; ++v) {
+      if (new_indices[v] != kNoVertex) {
+        new_indices[v] = static_cast<uint32>(old_indices->size());
+        old_indices->push_back(static_cast<uint32>(v));
+      }
+    }
+  }
+  for (uint32& index : *indices)
+    index = new_indices[index];
+}
+
+// Replaces the data of |buffer_object| with the elements at |old_indices|.
+static void RemapBufferObject(const gfx::BufferObjectPtr& buffer_object,
+                              const IndexVector& old_indices) {
+  const base::DataContainerPtr& data = buffer_object->GetData();
+  const size_t size = buffer_object->GetStructSize();
+  const uint8* old_data = data->GetData<uint8>();
+  base::ScopedAllocation<uint8> sa(buffer_object->GetAllocator(),
+                                   old_indices.size() * size);
+  uint8* new_data = sa.Get();
+  for (size_t i = 0; i < old_indices.size(); ++i)
+    memcpy(new_data + i * size, old_data + old_indices[i] * size, size);
+  buffer_object->SetData(sa.TransferToDataContainer(data->IsWipeable()), size,
+                         old_indices.size(), buffer_object->GetUsageMode());
+}
+
+// Returns the third vertex of triangle |t| of |indices|, which contains the
+// directed edge from vertex |from| to vertex |to|.
+static uint32 GetThirdVertex(const IndexVector& indices, size_t t,
+                             uint32 from, uint32 to) {
+  for (size_t k = 0; k < 3U; ++k) {
+    if (indices[t * 3U + k] == from && indices[t * 3U + (k + 1U) % 3U] == to)
+      return indices[t * 3U + (k + 2U) % 3U];
+  }
+  DCHECK(false) << "Triangle does not contain the edge";
+  return kNoVertex;
+}
+
+// Returns an unused triangle in |edges|, which maps each directed edge of the
+// triangles to the triangle, sorted by edge, that contains the edge from
+// vertex |from| to vertex |to|, or kNoVertex if there is none.
+static uint32 FindUnusedTriangle(
+    const base::AllocVector<std::pair<uint64, uint32> >& edges,
+    const base::AllocVector<bool>& used, uint32 from, uint32 to) {
+  const uint64 key = (static_cast<uint64>(from) << 32) | to;
+  for (auto it = std::lower_bound(edges.begin(), edges.end(),
+                                  std::make_pair(key, 0U));
+       it != edges.end() && it->first == key; ++it) {
+    if (!used[it->second])
+      return it->second;
+  }
+  return kNoVertex;
+}
+
+// Converts the triangles of |indices| into a triangle strip in |strip|.
+// Triangles are added to the current strip while an unused triangle shares its
+// last edge with the right winding. Separate strips are joined with
+// |restart_index| if |use_restart| is set, and with degenerate triangles
+// otherwise.
+static void BuildTriangleStrip(const IndexVector& indices, bool use_restart,
+                               uint32 restart_index, IndexVector* strip) {
+  const size_t triangle_count = indices.size() / 3U;
+  base::AllocVector<std::pair<uint64, uint32> > edges(GetTemporaryAllocator());
+  edges.reserve(indices.size());
+  for (size_t t = 0; t < triangle_count; ++t) {
+    for (size_t k = 0; k < 3U; ++k) {
+      const uint64 from = indices[t * 3U + k];
+      const uint64 to = indices[t * 3U + (k + 1U) % 3U];
+      edges.push_back(std::make_pair((from << 32) | to,
+                                     static_cast<uint32>(t)));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+
+  base::AllocVector<bool> used(GetTemporaryAllocator(), triangle_count, false);
+  IndexVector current(GetTemporaryAllocator());
+  strip->clear();
+  for (size_t t = 0; t < triangle_count; ++t) {
+    if (used[t])
+      continue;
+    used[t] = true;
+    // Start with the rotation of the triangle whose last edge, reversed, is
+    // shared with another triangle, since the second triangle of a strip is
+    // drawn with reversed winding.
+    const uint32* v = &indices[t * 3U];
+    size_t rotation = 0;
+    for (size_t r = 0; r < 3U; ++r) {
+      if (FindUnusedTriangle(edges, used, v[(r + 2U) % 3U],
+                             v[(r + 1U) % 3U]) != kNoVertex) {
+        rotation = r;
+        break;
+      }
+    }
+    current.clear();
+    for (size_t k = 0; k < 3U; ++k)
+      current.push_back(v[(rotation + k) % 3U]);
+
+    // Triangle p of a strip is drawn from its last three vertices, with their
+    // first two swapped if p is odd, so the next triangle must contain the
+    // last edge in that direction.
+    for (;;) {
+      const size_t p = current.size() - 2U;
+      const uint32 x = current[current.size() - 2U];
+      const uint32 y = current.back();
+      const uint32 next = p % 2U ? FindUnusedTriangle(edges, used, y, x)
+                                 : FindUnusedTriangle(edges, used, x, y);
+      if (next == kNoVertex)
+        break;
+      used[next] = true;
+      current.push_back(p % 2U ? GetThirdVertex(indices, next, y, x)
+                               : GetThirdVertex(indices, next, x, y));
+    }
+
+    if (!strip->empty()) {
+      if (use_restart) {
+        strip->push_back(restart_index);
+      } else {
+        // Repeat the last and first vertices, adding another repetition if
+        // needed so that the new strip starts with an even triangle.
+        strip->push_back(strip->back());
+        strip->push_back(current[0]);
+        if (strip->size() % 2U)
+          strip->push_back(current[0]);
+      }
+    }
+    strip->insert(strip->end(), current.begin(), current.end());
+  }
+}
+
+// Returns a copy of |buffer_object| holding the elements at |old_indices|,
+// with the same specs.
+static const gfx::BufferObjectPtr CopyBufferObject(
+    const gfx::BufferObjectPtr& buffer_object, const IndexVector& old_indices) {
+  gfx::BufferObjectPtr copy(
+      new (buffer_object->GetAllocator()) gfx::BufferObject);
+  // Specs are unique, so they keep their indices.
+  const size_t spec_count = buffer_object->GetSpecCount();
+  for (size_t i = 0; i < spec_count; ++i) {
+    const gfx::BufferObject::Spec& spec = buffer_object->GetSpec(i);
+    copy->AddSpec(spec.type, spec.component_count, spec.byte_offset);
+  }
+  copy->SetData(buffer_object->GetData(), buffer_object->GetStructSize(),
+                buffer_object->GetCount(), buffer_object->GetUsageMode());
+  RemapBufferObject(copy, old_indices);
+  return copy;
+}
+
+// Adds to |shapes| a Shape like |shape| that draws |indices| from copies of the
+// vertices at |old_indices| in |buffers|.
+static void AddShapePiece(
+    const gfx::ShapePtr& shape,
+    const base::AllocVector<gfx::BufferObjectPtr>& buffers,
+    const IndexVector& old_indices, const IndexVector& indices,
+    std::vector<gfx::ShapePtr>* shapes) {
+  base::AllocVector<gfx::BufferObjectPtr> copies(GetTemporaryAllocator());
+  for (const gfx::BufferObjectPtr& buffer_object : buffers)
+    copies.push_back(CopyBufferObject(buffer_object, old_indices));
+
+  const gfx::AttributeArrayPtr& attribute_array = shape->GetAttributeArray();
+  gfx::AttributeArrayPtr new_array(
+      new (attribute_array->GetAllocator()) gfx::AttributeArray);
+  const size_t attribute_count = attribute_array->GetAttributeCount();
+  for (size_t i = 0; i < attribute_count; ++i) {
+    gfx::Attribute attribute = attribute_array->GetAttribute(i);
+    if (attribute.GetType() == gfx::kBufferObjectElementAttribute) {
+      const gfx::BufferObjectElement& element =
+          attribute.GetValue<gfx::BufferObjectElement>();
+      const size_t b = std::find(buffers.begin(), buffers.end(),
+                                 element.buffer_object) - buffers.begin();
+      attribute.SetValue(
+          gfx::BufferObjectElement(copies[b], element.spec_index));
+    }
+    const size_t index = new_array->AddAttribute(attribute);
+    new_array->EnableAttribute(index, attribute_array->IsAttributeEnabled(i));
+  }
+
+  gfx::ShapePtr piece(new (shape->GetAllocator()) gfx::Shape);
+  piece->SetLabel(shape->GetLabel());
+  piece->SetPrimitiveType(shape->GetPrimitiveType());
+  piece->SetInstanceCount(shape->GetInstanceCount());
+  piece->SetAttributeArray(new_array);
+  piece->SetIndexBuffer(BuildIndexBuffer(
+      indices, gfx::BufferObject::kUnsignedShort, *shape->GetIndexBuffer()));
+  shapes->push_back(piece);
+}
+
+}  // anonymous namespace
+
+bool ReadIndexBuffer(const gfx::IndexBuffer& index_buffer,
+                     base::AllocVector<uint32>* indices) {
+  const base::DataContainerPtr& index_data = index_buffer.GetData();
+  if (!index_data.Get() || !index_data->GetData())
+    return false;
+  const void* data = index_data->GetData();
+  switch (index_buffer.GetSpec(0).type) {
+    case gfx::BufferObject::kUnsignedByte:
+      ReadIndices<uint8>(data, index_buffer.GetCount(), indices);
+      return true;
+    case gfx::BufferObject::kUnsignedShort:
+      ReadIndices<uint16>(data, index_buffer.GetCount(), indices);
+      return true;
+    case gfx::BufferObject::kUnsignedInt:
+      ReadIndices<uint32>(data, index_buffer.GetCount(), indices);
+      return true;
+    default:
+      return false;
+  }
+}
+
+const gfx::IndexBufferPtr BuildIndexBuffer(
+    const base::AllocVector<uint32>& indices,
+    gfx::BufferObject::ComponentType type,
+    const gfx::IndexBuffer& index_buffer) {
+  gfx::IndexBufferPtr new_buffer(
+      new (index_buffer.GetAllocator()) gfx::IndexBuffer);
+  new_buffer->AddSpec(type, 1, 0);
+  const size_t size = type == gfx::BufferObject::kUnsignedByte ?
+      sizeof(uint8) : type == gfx::BufferObject::kUnsignedShort ?
+      sizeof(uint16) : sizeof(uint32);
+  new_buffer->SetData(WriteIndexData(indices, type, index_buffer), size,
+                      indices.size(), index_buffer.GetUsageMode());
+  return new_buffer;
+}
+
+bool OptimizeMesh(const gfx::ShapePtr& shape,
+                  const MeshOptimizationSpec& spec) {
+  if (!shape.Get() || shape->GetPrimitiveType() != gfx::Shape::kTriangles ||
+      shape->GetVertexRangeCount() || !shape->GetIndexBuffer().Get() ||
+      !shape->GetAttributeArray().Get()) {
+    LOG(ERROR) << "OptimizeMesh: only indexed triangle Shapes without vertex"
+               << " ranges can be optimized";
+    return false;
+  }
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  const base::DataContainerPtr& index_data = index_buffer->GetData();
+  if (!index_data.Get() || !index_data->GetData() ||
+      index_buffer->GetCount() % 3U) {
+    LOG(ERROR) << "OptimizeMesh: the IndexBuffer has no triangle data";
+    return false;
+  }
+  const gfx::BufferObject::ComponentType index_type =
+      index_buffer->GetSpec(0).type;
+  IndexVector indices(GetTemporaryAllocator());
+  if (!ReadIndexBuffer(*index_buffer, &indices)) {
+    LOG(ERROR) << "OptimizeMesh: unsupported index type";
+    return false;
+  }
+
+  base::AllocVector<gfx::BufferObjectPtr> buffers(GetTemporaryAllocator());
+  size_t vertex_count = GetUsedVertexCount(indices);
+  const bool change_vertices =
+      spec.reorder_vertices || spec.remove_duplicate_vertices;
+  if (change_vertices) {
+    size_t buffer_vertex_count = 0;
+    if (!GetVertexBuffers(shape->GetAttributeArray(), &buffers,
+                          &buffer_vertex_count) ||
+        buffer_vertex_count < vertex_count) {
+      LOG(ERROR) << "OptimizeMesh: the vertex BufferObjects must all have"
+                 << " data for every vertex";
+      return false;
+    }
+    vertex_count = buffer_vertex_count;
+  }
+
+  if (spec.remove_duplicate_vertices)
+    MergeDuplicateVertices(buffers, vertex_count, &indices);
+
+  if (spec.reorder_triangles && spec.cache_size) {
+    IndexVector reordered(GetTemporaryAllocator());
+    base::AllocVector<size_t> cluster_starts(GetTemporaryAllocator());
+    ReorderTriangles(indices, vertex_count, spec.cache_size, &reordered,
+                     &cluster_starts);
+    base::AllocVector<Point3f> positions(GetTemporaryAllocator());
+    if (spec.reduce_overdraw && cluster_starts.size() > 1U &&
+        GetPositions(shape->GetAttributeArray(), vertex_count, &positions))
+      SortClusters(reordered, cluster_starts, positions, &indices);
+    else
+      indices.swap(reordered);
+  }
+
+  if (change_vertices) {
+    IndexVector old_indices(GetTemporaryAllocator());
+    CompactVertices(vertex_count, spec.reorder_vertices, &indices,
+                    &old_indices);
+    for (const gfx::BufferObjectPtr& buffer_object : buffers)
+      RemapBufferObject(buffer_object, old_indices);
+  }
+
+  // Compacting vertices never increases indices, so they still fit.
+  index_buffer->SetData(WriteIndexData(indices, index_type, *index_buffer),
+                        index_buffer->GetStructSize(), indices.size(),
+                        index_buffer->GetUsageMode());
+  return true;
+}
+
+float ComputeAverageCacheMissRatio(const gfx::IndexBufferPtr& index_buffer,
+                                   size_t cache_size) {
+  if (!index_buffer.Get() || index_buffer->GetCount() < 3U)
+    return 0.f;
+  const base::DataContainerPtr& data = index_buffer->GetData();
+  if (!data.Get() || !data->GetData())
+    return 0.f;
+  IndexVector indices(GetTemporaryAllocator());
+  if (!ReadIndexBuffer(*index_buffer, &indices))
+    return 0.f;
+
+  // Vertex v is in the FIFO cache if it was added less than cache_size misses
+  // ago.
+  IndexVector added(GetTemporaryAllocator(), GetUsedVertexCount(indices),
+                    kNoVertex);
+  uint32 misses = 0;
+  for (const uint32 index : indices) {
+    if (added[index] == kNoVertex || misses - added[index] > cache_size) {
+      added[index] = misses;
+      ++misses;
+    }
+  }
+  return static_cast<float>(misses) /
+      static_cast<float>(indices.size() / 3U);
+}
+
+
+bool CompactIndices(const gfx::ShapePtr& shape) {
+  const gfx::IndexBufferPtr index_buffer =
+      shape.Get() ? shape->GetIndexBuffer() : gfx::IndexBufferPtr();
+  if (!index_buffer.Get() || !index_buffer->GetData().Get() ||
+      !index_buffer->GetData()->GetData()) {
+    LOG(ERROR) << "CompactIndices: the Shape has no IndexBuffer data";
+    return false;
+  }
+  IndexVector indices(GetTemporaryAllocator());
+  if (!ReadIndexBuffer(*index_buffer, &indices)) {
+    LOG(ERROR) << "CompactIndices: unsupported index type";
+    return false;
+  }
+  if (index_buffer->GetSpec(0).type == gfx::BufferObject::kUnsignedInt &&
+      GetUsedVertexCount(indices) <= kMaxShortVertexCount)
+    shape->SetIndexBuffer(BuildIndexBuffer(
+        indices, gfx::BufferObject::kUnsignedShort, *index_buffer));
+  return true;
+}
+
+std::vector<gfx::ShapePtr> SplitShapeForShortIndices(
+    const gfx::ShapePtr& shape) {
+  std::vector<gfx::ShapePtr> shapes;
+  if (!shape.Get() || shape->GetVertexRangeCount() ||
+      !shape->GetAttributeArray().Get() ||
+      (shape->GetPrimitiveType() != gfx::Shape::kPoints &&
+       shape->GetPrimitiveType() != gfx::Shape::kLines &&
+       shape->GetPrimitiveType() != gfx::Shape::kTriangles)) {
+    LOG(ERROR) << "SplitShapeForShortIndices: only point, line, and triangle"
+               << " Shapes without vertex ranges can be split";
+    return shapes;
+  }
+  IndexVector indices(GetTemporaryAllocator());
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  if (!CompactIndices(shape) || !ReadIndexBuffer(*index_buffer, &indices))
+    return shapes;
+  const size_t vertex_count = GetUsedVertexCount(indices);
+  if (vertex_count <= kMaxShortVertexCount) {
+    shapes.push_back(shape);
+    return shapes;
+  }
+
+  base::AllocVector<gfx::BufferObjectPtr> buffers(GetTemporaryAllocator());
+  size_t buffer_vertex_count = 0;
+  if (!GetVertexBuffers(shape->GetAttributeArray(), &buffers,
+                        &buffer_vertex_count) ||
+      buffer_vertex_count < vertex_count) {
+    LOG(ERROR) << "SplitShapeForShortIndices: the vertex BufferObjects must"
+               << " all have data for every vertex";
+    return shapes;
+  }
+
+  // Add primitives to the current piece until one has too many vertices.
+  const size_t primitive_size =
+      shape->GetPrimitiveType() == gfx::Shape::kPoints ? 1U :
+      shape->GetPrimitiveType() == gfx::Shape::kLines ? 2U : 3U;
+  IndexVector new_indices(GetTemporaryAllocator(), vertex_count, kNoVertex);
+  IndexVector old_indices(GetTemporaryAllocator());
+  IndexVector piece_indices(GetTemporaryAllocator());
+  for (size_t i = 0; i + primitive_size <= indices.size();
+       i += primitive_size) {
+    size_t added_count = 0;
+    for (size_t k = 0; k < primitive_size; ++k) {
+      if (new_indices[indices[i + k]] == kNoVertex &&
+          std::find(&indices[i], &indices[i + k], indices[i + k]) ==
+              &indices[i + k])
+        ++added_count;
+    }
+    if (old_indices.size() + added_count > kMaxShortVertexCount) {
+      AddShapePiece(shape, buffers, old_indices, piece_indices, &shapes);
+      for (const uint32 index : old_indices)
+        new_indices[index] = kNoVertex;
+      old_indices.clear();
+      piece_indices.clear();
+    }
+    for (size_t k = 0; k < primitive_size; ++k) {
+      const uint32 index = indices[i + k];
+      if (new_indices[index] == kNoVertex) {
+        new_indices[index] = static_cast<uint32>(old_indices.size());
+        old_indices.push_back(index);
+      }
+      piece_indices.push_back(new_indices[index]);
+    }
+  }
+  if (!piece_indices.empty())
+    AddShapePiece(shape, buffers, old_indices, piece_indices, &shapes);
+  return shapes;
+}
+
+bool ConvertToTriangleStrip(const gfx::ShapePtr& shape,
+                            bool use_primitive_restart) {
+  if (!shape.Get() || shape->GetPrimitiveType() != gfx::Shape::kTriangles ||
+      shape->GetVertexRangeCount() || !shape->GetIndexBuffer().Get()) {
+    LOG(ERROR) << "ConvertToTriangleStrip: only indexed triangle Shapes"
+               << " without vertex ranges can be converted";
+    return false;
+  }
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  const base::DataContainerPtr& index_data = index_buffer->GetData();
+  if (!index_data.Get() || !index_data->GetData() ||
+      index_buffer->GetCount() % 3U) {
+    LOG(ERROR) << "ConvertToTriangleStrip: the IndexBuffer has no triangle"
+               << " data";
+    return false;
+  }
+  IndexVector indices(GetTemporaryAllocator());
+  if (!ReadIndexBuffer(*index_buffer, &indices)) {
+    LOG(ERROR) << "ConvertToTriangleStrip: unsupported index type";
+    return false;
+  }
+
+  // The restart index is the largest value of the index type, which must not
+  // be a vertex index.
+  gfx::BufferObject::ComponentType index_type = index_buffer->GetSpec(0).type;
+  uint32 restart_index = 0U;
+  if (use_primitive_restart) {
+    const size_t vertex_count = GetUsedVertexCount(indices);
+    if (index_type == gfx::BufferObject::kUnsignedByte &&
+        vertex_count > 0xffU)
+      index_type = gfx::BufferObject::kUnsignedShort;
+    if (index_type == gfx::BufferObject::kUnsignedShort &&
+        vertex_count > 0xffffU)
+      index_type = gfx::BufferObject::kUnsignedInt;
+    restart_index = index_type == gfx::BufferObject::kUnsignedByte ? 0xffU :
+        index_type == gfx::BufferObject::kUnsignedShort ? 0xffffU :
+        0xffffffffU;
+  }
+
+  IndexVector strip(GetTemporaryAllocator());
+  BuildTriangleStrip(indices, use_primitive_restart, restart_index, &strip);
+  shape->SetPrimitiveType(gfx::Shape::kTriangleStrip);
+  if (index_type == index_buffer->GetSpec(0).type) {
+    index_buffer->SetData(WriteIndexData(strip, index_type, *index_buffer),
+                          index_buffer->GetStructSize(), strip.size(),
+                          index_buffer->GetUsageMode());
+  } else {
+    shape->SetIndexBuffer(BuildIndexBuffer(strip, index_type, *index_buffer));
+  }
+  return true;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,163 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_MESHOPTIMIZER_H_
+#define ION_GFXUTILS_MESHOPTIMIZER_H_
+
+// This file contains functions that reorder the triangles and vertices of
+// indexed triangle Shapes, such as those created by the functions in
+// shapeutils.h, so that the GPU can draw them more efficiently. None of them
+// change how the Shape looks, other than the order in which overlapping
+// triangles are drawn.
+//
+// Triangles are reordered with the Tipsify algorithm from "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw" by Sander, Nehab and
+// Barczak (SIGGRAPH 2007), which runs in linear time. It sorts triangles so
+// that most vertices are still in the post-transform vertex cache when they
+// are used again. Tipsify splits the mesh into clusters wherever it has to
+// jump to an unrelated part of it; sorting these clusters so that those
+// facing outward from the center are drawn first reduces overdraw from any
+// viewpoint without affecting cache efficiency.
+//
+// Vertices are then renumbered in the order in which the triangles first use
+// them, so that vertex fetches walk through memory sequentially.
+//
+// The remaining functions shrink index data, which matters most on mobile
+// GPUs. They narrow indices to 16 bits, split Shapes that are too large for
+// 16-bit indices, and convert triangles to strips.
+
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/indexbuffer.h"
+#include "ion/gfx/shape.h"
+
+namespace ion {
+namespace gfxutils {
+
+// This struct selects the optimizations done by OptimizeMesh(). Default
+// values are listed in parentheses in the member field comments.
+struct MeshOptimizationSpec {
+  MeshOptimizationSpec()
+      : cache_size(16U),
+        reorder_triangles(true),
+        reduce_overdraw(true),
+        reorder_vertices(true),
+        remove_duplicate_vertices(false) {}
+  // The number of vertices in the post-transform cache that triangles are
+  // ordered for. Most mobile GPUs behave like a cache of 16 to 32 vertices;
+  // sizes in that range give similar results on all of them. (16)
+  size_t cache_size;
+  // Whether to reorder triangles for the vertex cache. (true)
+  bool reorder_triangles;
+  // Whether to sort clusters of reordered triangles to reduce overdraw. This
+  // needs a 3-component float "aVertex" attribute, and is skipped for Shapes
+  // without one. It has no effect unless reorder_triangles is set. (true)
+  bool reduce_overdraw;
+  // Whether to renumber the vertices in the order they are first used, which
+  // also removes vertices that no triangle uses. (true)
+  bool reorder_vertices;
+  // Whether to merge vertices whose data is identical in all BufferObjects
+  // before reordering triangles, then remove the unused ones. Vertices that
+  // only differ in a normal or texture coordinate, e.g., along the seam of an
+  // ellipsoid, are not merged. (false)
+  bool remove_duplicate_vertices;
+};
+
+// Optimizes the triangles and vertices of |shape| in place as selected by
+// |spec|, replacing the DataContainers of its IndexBuffer and vertex
+// BufferObjects with ones that keep the original allocators and wipeable
+// settings. The Shape must have kTriangles primitives, no vertex ranges, and
+// an IndexBuffer with unsigned byte, short, or int indices. If vertices are
+// reordered or merged, every BufferObject of its AttributeArray must hold one
+// element per vertex and must not be used by other Shapes. The data of all
+// buffers must still be present, so Shapes with wipeable data must be
+// optimized before they are rendered. Returns false and leaves the Shape
+// unchanged if any of these requirements is not met.
+ION_API bool OptimizeMesh(const gfx::ShapePtr& shape,
+                          const MeshOptimizationSpec& spec);
+
+// Returns the average number of vertices that are transformed per triangle
+// when drawing the triangles of |index_buffer| with a FIFO post-transform
+// cache of |cache_size| vertices. This is 3 when no vertex is ever reused and
+// approaches 0.5 for large regular meshes with perfect orderings. Returns 0 if
+// the IndexBuffer has no triangles or its data has been wiped.
+ION_API float ComputeAverageCacheMissRatio(
+    const gfx::IndexBufferPtr& index_buffer, size_t cache_size);
+
+// Replaces the IndexBuffer of |shape| with one holding its indices as unsigned
+// shorts if they are unsigned ints that all fit, halving the memory and
+// bandwidth they use. OpenGL ES 2.0 cannot draw unsigned int indices at all.
+// Unsigned byte and short indices, and unsigned int indices that need 32
+// bits, are left unchanged. The new IndexBuffer keeps the allocator, usage
+// mode, and wipeable setting of the original. Returns false if the Shape has
+// no IndexBuffer with data of a supported index type.
+ION_API bool CompactIndices(const gfx::ShapePtr& shape);
+
+// Splits |shape| into Shapes whose vertices can all be addressed with
+// unsigned short indices, keeping its primitives in order. OpenGL ES cannot
+// offset the indices of a draw, so the pieces cannot be vertex ranges of a
+// single Shape. Instead, each piece gets new BufferObjects holding copies of
+// the vertices it uses. The pieces share the label, primitive type, and
+// instance count of |shape|, as well as the allocators, usage modes, and
+// wipeable settings of its buffers. The Shape must have kPoints, kLines, or
+// kTriangles primitives, no vertex ranges, and an IndexBuffer with data. If
+// it needs more than 65536 vertices, every BufferObject of its AttributeArray
+// must also hold data for one element per vertex. A Shape whose vertices
+// already fit is compacted with CompactIndices() and returned alone.
+// Returns an empty vector if any of these requirements is not met.
+ION_API std::vector<gfx::ShapePtr> SplitShapeForShortIndices(
+    const gfx::ShapePtr& shape);
+
+// Converts the indexed triangles of |shape| into a triangle strip in place,
+// which needs roughly one index per triangle instead of three. Triangles are
+// chained through shared edges with their winding preserved. Separate strips
+// are joined with degenerate triangles, which the GPU discards without
+// rasterizing. If |use_primitive_restart| is set, they are instead separated
+// by the largest value of the index type, and the type is widened if a vertex
+// index needs that value. Such strips only draw correctly if
+// GL_PRIMITIVE_RESTART_FIXED_INDEX is enabled, which requires OpenGL ES 3.0
+// or desktop OpenGL 4.3. StateTable does not manage this capability, so it
+// must be enabled through the GraphicsManager. Converting a mesh optimized
+// with OptimizeMesh() keeps most of its vertex cache locality. The Shape must
+// have kTriangles primitives, no vertex ranges, and an IndexBuffer with
+// unsigned byte, short, or int indices. Returns false and leaves the Shape
+// unchanged if any of these requirements is not met.
+ION_API bool ConvertToTriangleStrip(const gfx::ShapePtr& shape,
+                                    bool use_primitive_restart);
+
+// Copies the indices of |index_buffer| into |indices| as unsigned ints, so
+// that code working on meshes can treat all index types alike. Returns false
+// if the IndexBuffer has no data or its indices are not unsigned bytes,
+// shorts, or ints.
+ION_API bool ReadIndexBuffer(const gfx::IndexBuffer& index_buffer,
+                             base::AllocVector<uint32>* indices);
+
+// Returns a new IndexBuffer holding |indices| narrowed to |type|, which must
+// be an unsigned byte, short, or int type that can hold them all. The new
+// IndexBuffer has the allocator and usage mode of |index_buffer| and the
+// wipeable setting of its data.
+ION_API const gfx::IndexBufferPtr BuildIndexBuffer(
+    const base::AllocVector<uint32>& indices,
+    gfx::BufferObject::ComponentType type,
+    const gfx::IndexBuffer& index_buffer);
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_MESHOPTIMIZER_H_
@@ -0,0 +1,619 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/meshsimplifier.h"
+
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "base/integral_types.h"
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfxutils/meshoptimizer.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+#include "ion/math/vectorutils.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using math::Point3f;
+using math::Vector3f;
+
+typedef base::AllocVector<uint32> IndexVector;
+typedef base::AllocVector<Point3f> PositionVector;
+
+// Passed to MeshSimplifier::GetNormal() to leave all vertices in place.
+static const uint32 kNoVertex = static_cast<uint32>(-1);
+
+// Returns a short-term Allocator for temporary data.
+static const base::AllocatorPtr& GetTemporaryAllocator() {
+  return base::AllocationManager::GetDefaultAllocatorForLifetime(
+      base::kShortTerm);
+}
+
+// Reads the positions of the first |vertex_count| vertices from the
+// "aVertex" attribute of |attribute_array|. Returns false if there is no such
+// attribute with at least 3 float components, or its BufferObject has fewer
+// elements or no data.
+static bool GetPositions(const gfx::AttributeArrayPtr& attribute_array,
+                         size_t vertex_count, PositionVector* positions) {
+  const size_t attribute_count = attribute_array->GetBufferAttributeCount();
+  for (size_t i = 0; i < attribute_count; ++i) {
+    const gfx::Attribute& attribute = attribute_array->GetBufferAttribute(i);
+    if (attribute.GetRegistry().GetSpec(attribute)->name != "aVertex")
+      continue;
+    const gfx::BufferObjectElement& element =
+        attribute.GetValue<gfx::BufferObjectElement>();
+    const gfx::BufferObjectPtr& buffer_object = element.buffer_object;
+    if (!buffer_object.Get())
+      return false;
+    const gfx::BufferObject::Spec& spec =
+        buffer_object->GetSpec(element.spec_index);
+    const base::DataContainerPtr& data_container = buffer_object->GetData();
+    if (spec.type != gfx::BufferObject::kFloat || spec.component_count < 3U ||
+        buffer_object->GetCount() < vertex_count || !data_container.Get() ||
+        !data_container->GetData())
+      return false;
+    const uint8* data = data_container->GetData<uint8>() + spec.byte_offset;
+    const size_t stride = buffer_object->GetStructSize();
+    positions->resize(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+      float xyz[3];
+      memcpy(xyz, data + v * stride, sizeof(xyz));
+      (*positions)[v].Set(xyz[0], xyz[1], xyz[2]);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Reads the triangle indices and vertex positions of |shape| into |indices|
+// and |positions|. Logs an error that starts with |caller| and returns false
+// if the Shape does not meet the requirements of SimplifyMesh().
+static bool ReadMesh(const gfx::ShapePtr& shape, const char* caller,
+                     IndexVector* indices, PositionVector* positions) {
+  if (!shape.Get() || shape->GetPrimitiveType() != gfx::Shape::kTriangles ||
+      shape->GetVertexRangeCount() || !shape->GetIndexBuffer().Get() ||
+      !shape->GetAttributeArray().Get()) {
+    LOG(ERROR) << caller << ": only indexed triangle Shapes without vertex"
+               << " ranges can be simplified";
+    return false;
+  }
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  const base::DataContainerPtr& index_data = index_buffer->GetData();
+  if (!index_data.Get() || !index_data->GetData() ||
+      index_buffer->GetCount() % 3U) {
+    LOG(ERROR) << caller << ": the IndexBuffer has no triangle data";
+    return false;
+  }
+  if (!ReadIndexBuffer(*index_buffer, indices)) {
+    LOG(ERROR) << caller << ": unsupported index type";
+    return false;
+  }
+  uint32 max_index = 0;
+  for (const uint32 index : *indices)
+    max_index = std::max(max_index, index);
+  const size_t vertex_count =
+      indices->empty() ? 0U : static_cast<size_t>(max_index) + 1U;
+  if (!GetPositions(shape->GetAttributeArray(), vertex_count, positions)) {
+    LOG(ERROR) << caller << ": the Shape needs a 3-component float \"aVertex\""
+               << " attribute with data for every vertex";
+    return false;
+  }
+  return true;
+}
+
+// A symmetric 4x4 matrix that measures the sum of the squared distances of a
+// point to a set of planes.
+struct Quadric {
+  Quadric() {
+    for (double& value : q)
+      value = 0.0;
+  }
+
+  // Adds the plane through |point| with unit normal |normal|.
+  void AddPlane(const Vector3f& normal, const Point3f& point) {
+    const double a = normal[0];
+    const double b = normal[1];
+    const double c = normal[2];
+    const double d = -(a * point[0] + b * point[1] + c * point[2]);
+    q[0] += a * a;
+    q[1] += a * b;
+    q[2] += a * c;
+    q[3] += a * d;
+    q[4] += b * b;
+    q[5] += b * c;
+    q[6] += b * d;
+    q[7] += c * c;
+    q[8] += c * d;
+    q[9] += d * d;
+  }
+
+  void Add(const Quadric& other) {
+    for (int i = 0; i < 10; ++i)
+      q[i] += other.q[i];
+  }
+
+  // Returns the sum of the squared distances of |p| to the planes.
+  double Evaluate(const Point3f& p) const {
+    const double x = p[0];
+    const double y = p[1];
+    const double z = p[2];
+    return q[0] * x * x + 2.0 * (q[1] * x * y + q[2] * x * z + q[3] * x) +
+        q[4] * y * y + 2.0 * (q[5] * y * z + q[6] * y) +
+        q[7] * z * z + 2.0 * q[8] * z + q[9];
+  }
+
+  double q[10];
+};
+
+// A candidate collapse that moves vertex |from| onto vertex |to|.
+struct Collapse {
+  bool operator<(const Collapse& other) const { return cost < other.cost; }
+
+  double cost;
+  uint32 from;
+  uint32 to;
+};
+
+// Collapses the edges of a triangle mesh in order of increasing error. Each
+// call to Simplify() continues from the mesh left by the previous one, and
+// errors are always measured against the original planes.
+class MeshSimplifier {
+ public:
+  MeshSimplifier(const IndexVector& indices, const PositionVector& positions);
+
+  // Collapses edges until at most |target_index_count| indices are left or
+  // every remaining collapse costs more than |max_cost|. Returns the largest
+  // cost of any collapse done so far.
+  double Simplify(size_t target_index_count, double max_cost);
+
+  // Returns the indices of the remaining triangles.
+  void GetIndices(IndexVector* indices) const;
+
+ private:
+  // Returns a key for the undirected edge between vertices |a| and |b|.
+  static uint64 GetEdgeKey(uint32 a, uint32 b) {
+    return (static_cast<uint64>(std::min(a, b)) << 32) | std::max(a, b);
+  }
+
+  // Returns the normal of triangle |t| with vertex |v| moved to |p|. The
+  // length of the normal is twice the area of the triangle.
+  const Vector3f GetNormal(size_t t, uint32 v, const Point3f& p) const;
+
+  // Locks vertices that share a position with another vertex or that touch
+  // an edge of more than two triangles, marks vertices on the border of the
+  // mesh, and computes the initial quadrics.
+  void Classify();
+
+  // Rebuilds the lists of live triangles around each vertex.
+  void BuildAdjacency();
+
+  // Returns the number of live triangles that use both |a| and |b|.
+  size_t CountSharedTriangles(uint32 a, uint32 b) const;
+
+  // Adds the collapse of |from| onto |to| to collapses_ if it is allowed and
+  // costs no more than |max_cost|.
+  void AddCandidate(uint32 from, uint32 to, double max_cost);
+
+  // Returns whether collapsing |from| onto |to| keeps the mesh manifold and
+  // does not flip any triangle.
+  bool CanCollapse(uint32 from, uint32 to);
+
+  // Moves |from| onto |to|, marking all vertices whose triangles change.
+  // Returns the number of triangles removed.
+  size_t DoCollapse(uint32 from, uint32 to);
+
+  IndexVector triangles_;
+  base::AllocVector<uint8> live_;
+  const PositionVector& positions_;
+  base::AllocVector<Quadric> quadrics_;
+  base::AllocVector<uint8> locked_;
+  base::AllocVector<uint8> border_;
+  base::AllocVector<uint8> marked_;
+  // The live triangles around vertex v are adjacent_[offsets_[v]] up to
+  // adjacent_[offsets_[v + 1]].
+  IndexVector offsets_;
+  IndexVector adjacent_;
+  base::AllocVector<Collapse> collapses_;
+  IndexVector from_neighbors_;
+  IndexVector to_neighbors_;
+  size_t live_index_count_;
+  double max_cost_;
+};
+
+MeshSimplifier::MeshSimplifier(const IndexVector& indices,
+                               const PositionVector& positions)
+    : triangles_(GetTemporaryAllocator(), indices),
+      live_(GetTemporaryAllocator(), indices.size() / 3U, 1U),
+      positions_(positions),
+      quadrics_(GetTemporaryAllocator(), positions.size(), Quadric()),
+      locked_(GetTemporaryAllocator(), positions.size(), 0U),
+      border_(GetTemporaryAllocator(), positions.size(), 0U),
+      marked_(GetTemporaryAllocator(), positions.size(), 0U),
+      offsets_(GetTemporaryAllocator()),
+      adjacent_(GetTemporaryAllocator()),
+      collapses_(GetTemporaryAllocator()),
+      from_neighbors_(GetTemporaryAllocator()),
+      to_neighbors_(GetTemporaryAllocator()),
+      live_index_count_(0U),
+      max_cost_(0.0) {
+  // Degenerate triangles are dropped right away.
+  const size_t triangle_count = live_.size();
+  for (size_t t = 0; t < triangle_count; ++t) {
+    const uint32* tri = &triangles_[3U * t];
+    if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0])
+      live_[t] = 0U;
+    else
+      live_index_count_ += 3U;
+  }
+  Classify();
+}
+
+const Vector3f MeshSimplifier::GetNormal(size_t t, uint32 v,
+                                         const Point3f& p) const {
+  const uint32* tri = &triangles_[3U * t];
+  const Point3f& p0 = tri[0] == v ? p : positions_[tri[0]];
+  const Point3f& p1 = tri[1] == v ? p : positions_[tri[1]];
+  const Point3f& p2 = tri[2] == v ? p : positions_[tri[2]];
+  return math::Cross(p1 - p0, p2 - p0);
+}
+
+void MeshSimplifier::Classify() {
+  const size_t vertex_count = positions_.size();
+  const size_t triangle_count = live_.size();
+
+  // Sorting the used vertices by position puts duplicates next to each other.
+  IndexVector sorted(GetTemporaryAllocator());
+  base::AllocVector<uint8> used(GetTemporaryAllocator(), vertex_count, 0U);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    if (live_[t]) {
+      for (int i = 0; i < 3; ++i)
+        used[triangles_[3U * t + i]] = 1U;
+    }
+  }
+  for (uint32 v = 0; v < vertex_count; ++v) {
+    if (used[v])
+      sorted.push_back(v);
+  }
+  const PositionVector& positions = positions_;
+  std::sort(sorted.begin(), sorted.end(), [&positions](uint32 a, uint32 b) {
+    return std::lexicographical_compare(&positions[a][0], &positions[a][0] + 3,
+                                        &positions[b][0], &positions[b][0] + 3);
+  });
+  for (size_t i = 1; i < sorted.size(); ++i) {
+    if (positions_[sorted[i]] == positions_[sorted[i - 1]])
+      locked_[sorted[i]] = locked_[sorted[i - 1]] = 1U;
+  }
+
+  // Count the triangles around each edge, and add the plane of each triangle
+  // to the quadrics of its vertices.
+  base::AllocUnorderedMap<uint64, uint32> edge_counts(GetTemporaryAllocator());
+  for (size_t t = 0; t < triangle_count; ++t) {
+    if (!live_[t])
+      continue;
+    const uint32* tri = &triangles_[3U * t];
+    for (int i = 0; i < 3; ++i)
+      ++edge_counts[GetEdgeKey(tri[i], tri[(i + 1) % 3])];
+    const Vector3f normal = GetNormal(t, kNoVertex, Point3f::Zero());
+    const float length = math::Length(normal);
+    if (length == 0.f)
+      continue;
+    for (int i = 0; i < 3; ++i)
+      quadrics_[tri[i]].AddPlane(normal / length, positions_[tri[0]]);
+  }
+
+  // Border edges belong to a single triangle. Their vertices get the plane
+  // through the edge perpendicular to the triangle, which keeps the border in
+  // place.
+  for (size_t t = 0; t < triangle_count; ++t) {
+    if (!live_[t])
+      continue;
+    const uint32* tri = &triangles_[3U * t];
+    const Vector3f normal = GetNormal(t, kNoVertex, Point3f::Zero());
+    for (int i = 0; i < 3; ++i) {
+      const uint32 a = tri[i];
+      const uint32 b = tri[(i + 1) % 3];
+      const uint32 count = edge_counts[GetEdgeKey(a, b)];
+      if (count > 2U) {
+        locked_[a] = locked_[b] = 1U;
+      } else if (count == 1U) {
+        border_[a] = border_[b] = 1U;
+        const Vector3f border_normal =
+            math::Cross(positions_[b] - positions_[a], normal);
+        const float length = math::Length(border_normal);
+        if (length > 0.f) {
+          quadrics_[a].AddPlane(border_normal / length, positions_[a]);
+          quadrics_[b].AddPlane(border_normal / length, positions_[a]);
+        }
+      }
+    }
+  }
+}
+
+void MeshSimplifier::BuildAdjacency() {
+  const size_t vertex_count = positions_.size();
+  const size_t triangle_count = live_.size();
+  offsets_.assign(vertex_count + 1U, 0U);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    if (live_[t]) {
+      for (int i = 0; i < 3; ++i)
+        ++offsets_[triangles_[3U * t + i] + 1U];
+    }
+  }
+  for (size_t v = 0; v < vertex_count; ++v)
+    offsets_[v + 1U] += offsets_[v];
+  adjacent_.resize(offsets_[vertex_count]);
+  IndexVector next(GetTemporaryAllocator(), offsets_.begin(),
+                   offsets_.end() - 1);
+  for (uint32 t = 0; t < triangle_count; ++t) {
+    if (live_[t]) {
+      for (int i = 0; i < 3; ++i)
+        adjacent_[next[triangles_[3U * t + i]]++] = t;
+    }
+  }
+}
+
+size_t MeshSimplifier::CountSharedTriangles(uint32 a, uint32 b) const {
+  size_t count = 0;
+  for (uint32 i = offsets_[a]; i < offsets_[a + 1U]; ++i) {
+    const uint32* tri = &triangles_[3U * adjacent_[i]];
+    if (live_[adjacent_[i]] && (tri[0] == b || tri[1] == b || tri[2] == b))
+      ++count;
+  }
+  return count;
+}
+
+void MeshSimplifier::AddCandidate(uint32 from, uint32 to, double max_cost) {
+  // Border vertices may only move along the border.
+  if (locked_[from] || (border_[from] && CountSharedTriangles(from, to) != 1U))
+    return;
+  Quadric quadric = quadrics_[from];
+  quadric.Add(quadrics_[to]);
+  Collapse collapse;
+  collapse.cost = std::max(0.0, quadric.Evaluate(positions_[to]));
+  if (collapse.cost > max_cost)
+    return;
+  collapse.from = from;
+  collapse.to = to;
+  collapses_.push_back(collapse);
+}
+
+bool MeshSimplifier::CanCollapse(uint32 from, uint32 to) {
+  // The vertices that are adjacent to both ends of the edge must be exactly
+  // those of the triangles that share it, otherwise the collapse would join
+  // separate parts of the surface.
+  from_neighbors_.clear();
+  to_neighbors_.clear();
+  for (uint32 i = offsets_[from]; i < offsets_[from + 1U]; ++i) {
+    for (int k = 0; k < 3; ++k)
+      from_neighbors_.push_back(triangles_[3U * adjacent_[i] + k]);
+  }
+  for (uint32 i = offsets_[to]; i < offsets_[to + 1U]; ++i) {
+    for (int k = 0; k < 3; ++k)
+      to_neighbors_.push_back(triangles_[3U * adjacent_[i] + k]);
+  }
+  std::sort(from_neighbors_.begin(), from_neighbors_.end());
+  from_neighbors_.erase(
+      std::unique(from_neighbors_.begin(), from_neighbors_.end()),
+      from_neighbors_.end());
+  std::sort(to_neighbors_.begin(), to_neighbors_.end());
+  to_neighbors_.erase(std::unique(to_neighbors_.begin(), to_neighbors_.end()),
+                      to_neighbors_.end());
+  // Both lists contain |from| and |to|, which are not counted.
+  size_t common = 0;
+  for (const uint32 v : from_neighbors_) {
+    if (std::binary_search(to_neighbors_.begin(), to_neighbors_.end(), v))
+      ++common;
+  }
+  if (common - 2U != CountSharedTriangles(from, to))
+    return false;
+
+  // Reject the collapse if any remaining triangle would flip or vanish.
+  const Point3f& target = positions_[to];
+  for (uint32 i = offsets_[from]; i < offsets_[from + 1U]; ++i) {
+    const uint32 t = adjacent_[i];
+    const uint32* tri = &triangles_[3U * t];
+    if (tri[0] == to || tri[1] == to || tri[2] == to)
+      continue;
+    if (math::Dot(GetNormal(t, kNoVertex, target),
+                  GetNormal(t, from, target)) <= 0.f)
+      return false;
+  }
+  return true;
+}
+
+size_t MeshSimplifier::DoCollapse(uint32 from, uint32 to) {
+  size_t removed = 0;
+  for (uint32 i = offsets_[from]; i < offsets_[from + 1U]; ++i) {
+    const uint32 t = adjacent_[i];
+    uint32* tri = &triangles_[3U * t];
+    for (int k = 0; k < 3; ++k)
+      marked_[tri[k]] = 1U;
+    if (tri[0] == to || tri[1] == to || tri[2] == to) {
+      live_[t] = 0U;
+      ++removed;
+    } else {
+      for (int k = 0; k < 3; ++k) {
+        if (tri[k] == from)
+          tri[k] = to;
+      }
+    }
+  }
+  quadrics_[to].Add(quadrics_[from]);
+  return removed;
+}
+
+double MeshSimplifier::Simplify(size_t target_index_count, double max_cost) {
+  // Each pass does the cheapest collapses that do not touch the triangles
+  // changed by another one in the same pass, so that the adjacency and costs
+  // computed at the start of the pass stay valid.
+  while (live_index_count_ > target_index_count) {
+    BuildAdjacency();
+    collapses_.clear();
+    const size_t triangle_count = live_.size();
+    for (size_t t = 0; t < triangle_count; ++t) {
+      if (!live_[t])
+        continue;
+      const uint32* tri = &triangles_[3U * t];
+      for (int i = 0; i < 3; ++i) {
+        AddCandidate(tri[i], tri[(i + 1) % 3], max_cost);
+        AddCandidate(tri[(i + 1) % 3], tri[i], max_cost);
+      }
+    }
+    std::sort(collapses_.begin(), collapses_.end());
+    marked_.assign(marked_.size(), 0U);
+    bool collapsed = false;
+    for (const Collapse& collapse : collapses_) {
+      if (live_index_count_ <= target_index_count)
+        break;
+      if (marked_[collapse.from] || marked_[collapse.to] ||
+          !CanCollapse(collapse.from, collapse.to))
+        continue;
+      live_index_count_ -= 3U * DoCollapse(collapse.from, collapse.to);
+      max_cost_ = std::max(max_cost_, collapse.cost);
+      collapsed = true;
+    }
+    if (!collapsed)
+      break;
+  }
+  return max_cost_;
+}
+
+void MeshSimplifier::GetIndices(IndexVector* indices) const {
+  indices->clear();
+  const size_t triangle_count = live_.size();
+  for (size_t t = 0; t < triangle_count; ++t) {
+    if (live_[t])
+      indices->insert(indices->end(), &triangles_[3U * t],
+                      &triangles_[3U * t] + 3);
+  }
+}
+
+// Returns the bounds of the vertices used by |indices|.
+static const math::Range3f GetBounds(const IndexVector& indices,
+                                     const PositionVector& positions) {
+  math::Range3f bounds;
+  for (const uint32 index : indices)
+    bounds.ExtendByPoint(positions[index]);
+  return bounds;
+}
+
+// Returns the size of |bounds| that errors are relative to.
+static double GetExtent(const math::Range3f& bounds) {
+  if (bounds.IsEmpty())
+    return 1.0;
+  const Vector3f size = bounds.GetSize();
+  const double extent = std::max(size[0], std::max(size[1], size[2]));
+  return extent > 0.0 ? extent : 1.0;
+}
+
+}  // anonymous namespace
+
+const gfx::IndexBufferPtr SimplifyMesh(const gfx::ShapePtr& shape,
+                                       size_t target_index_count,
+                                       float max_error, float* error) {
+  IndexVector indices(GetTemporaryAllocator());
+  PositionVector positions(GetTemporaryAllocator());
+  if (!ReadMesh(shape, "SimplifyMesh", &indices, &positions))
+    return gfx::IndexBufferPtr();
+  const double extent = GetExtent(GetBounds(indices, positions));
+  const double max_distance = std::max(0.f, max_error) * extent;
+  MeshSimplifier simplifier(indices, positions);
+  const double cost = simplifier.Simplify(target_index_count,
+                                          max_distance * max_distance);
+  if (error)
+    *error = static_cast<float>(std::sqrt(cost) / extent);
+  simplifier.GetIndices(&indices);
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  return BuildIndexBuffer(indices, index_buffer->GetSpec(0).type,
+                          *index_buffer);
+}
+
+const gfx::NodePtr BuildLodNode(const gfx::ShapePtr& shape,
+                                const LodSpec& spec) {
+  IndexVector indices(GetTemporaryAllocator());
+  PositionVector positions(GetTemporaryAllocator());
+  if (!ReadMesh(shape, "BuildLodNode", &indices, &positions))
+    return gfx::NodePtr();
+  const math::Range3f bounds = GetBounds(indices, positions);
+  const double extent = GetExtent(bounds);
+  const double max_distance = std::max(0.f, spec.max_error) * extent;
+
+  // Each level continues simplifying the one before it, so errors never
+  // decrease from one level to the next.
+  base::AllocVector<gfx::ShapePtr> shapes(GetTemporaryAllocator());
+  base::AllocVector<float> errors(GetTemporaryAllocator());
+  shapes.push_back(shape);
+  errors.push_back(0.f);
+  MeshSimplifier simplifier(indices, positions);
+  const base::AllocatorPtr& allocator = shape->GetAllocator();
+  const gfx::IndexBuffer& index_buffer = *shape->GetIndexBuffer();
+  const gfx::BufferObject::ComponentType index_type =
+      index_buffer.GetSpec(0).type;
+  double target_index_count = static_cast<double>(indices.size());
+  size_t index_count = indices.size();
+  for (size_t i = 1; i < spec.level_count; ++i) {
+    target_index_count *= spec.reduction;
+    const double cost = simplifier.Simplify(
+        static_cast<size_t>(target_index_count), max_distance * max_distance);
+    simplifier.GetIndices(&indices);
+    if (indices.size() >= index_count)
+      break;
+    index_count = indices.size();
+    gfx::ShapePtr level(new (allocator) gfx::Shape);
+    level->SetLabel(shape->GetLabel());
+    level->SetPrimitiveType(gfx::Shape::kTriangles);
+    level->SetAttributeArray(shape->GetAttributeArray());
+    level->SetIndexBuffer(BuildIndexBuffer(indices, index_type, index_buffer));
+    shapes.push_back(level);
+    // Clamp tiny errors so that every level has a finite switching size.
+    errors.push_back(std::max(static_cast<float>(std::sqrt(cost) / extent),
+                              1e-6f));
+  }
+
+  // At a projected size s, level i is off by about errors[i] * s of the view,
+  // so it is drawn below the size where that reaches max_screen_error.
+  gfx::NodePtr node(new (allocator) gfx::Node);
+  const size_t level_count = shapes.size();
+  for (size_t i = 0; i < level_count; ++i) {
+    const float max_size = i ? spec.max_screen_error / errors[i] :
+        std::numeric_limits<float>::infinity();
+    const float min_size =
+        i + 1U < level_count ? spec.max_screen_error / errors[i + 1U] : 0.f;
+    gfx::NodePtr child(new (allocator) gfx::Node);
+    child->AddShape(shapes[i]);
+    child->SetBounds(bounds);
+    child->SetLodRange(math::Range1f(min_size, max_size));
+    node->AddChild(child);
+  }
+  return node;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,95 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_MESHSIMPLIFIER_H_
+#define ION_GFXUTILS_MESHSIMPLIFIER_H_
+
+// This file contains functions that simplify indexed triangle Shapes, such as
+// those created by the functions in shapeutils.h, and build level-of-detail
+// chains from them that the Renderer selects by their size on screen (see
+// gfx::Node::SetLodRange()).
+//
+// Simplification collapses edges by moving one vertex onto another, choosing
+// the collapses that change the surface least as measured by the quadric
+// error metric from "Surface Simplification Using Quadric Error Metrics" by
+// Garland and Heckbert (SIGGRAPH 1997). Since existing vertices are kept, all
+// levels of detail index the Shape's original vertex buffers, and only need
+// their own IndexBuffer. Vertices that have duplicate positions, e.g., along
+// texture seams or hard edges, and vertices where the mesh is not manifold
+// are never moved, and vertices on the border of the mesh only move along
+// it. Collapses that would flip triangles are rejected.
+
+#include "ion/gfx/indexbuffer.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shape.h"
+
+namespace ion {
+namespace gfxutils {
+
+// This struct describes the level-of-detail chain built by BuildLodNode().
+// Default values are listed in parentheses in the member field comments.
+struct LodSpec {
+  LodSpec()
+      : level_count(4U),
+        reduction(0.5f),
+        max_error(0.05f),
+        max_screen_error(0.005f) {}
+  // The number of levels of detail, including the original Shape. (4)
+  size_t level_count;
+  // The triangle count of each level relative to the one before it. (0.5)
+  float reduction;
+  // The largest error of any level, relative to the size of the Shape (the
+  // largest extent of its bounding box). Levels stop shrinking when further
+  // simplification would exceed it. (0.05)
+  float max_error;
+  // The largest error allowed on screen, as a fraction of the view, which
+  // sets the sizes at which the Renderer switches between levels. (0.005)
+  float max_screen_error;
+};
+
+// Returns a new IndexBuffer with at most |target_index_count| indices that
+// approximates the triangles of |shape| using its vertices, or as few as
+// possible without any vertex moving further than |max_error| from the
+// original surface, relative to the size of the Shape. Distances are measured
+// to the planes of the original triangles around each moved vertex. The
+// IndexBuffer has the same index type, allocator, usage mode and wipeable
+// setting as the Shape's. If |error| is not NULL, it is set to the error of
+// the simplified mesh, in the same units as |max_error|. The Shape must have
+// kTriangles primitives, no vertex ranges, an IndexBuffer with unsigned byte,
+// short, or int indices, and a 3-component float "aVertex" attribute whose
+// data is still present. Returns a NULL pointer if any of
+// these requirements is not met.
+ION_API const gfx::IndexBufferPtr SimplifyMesh(const gfx::ShapePtr& shape,
+                                               size_t target_index_count,
+                                               float max_error, float* error);
+
+// Returns a Node with one child per level of detail of |shape| as described
+// by |spec|. The first child contains |shape| itself; each following one
+// contains a Shape that shares its AttributeArray and has an IndexBuffer
+// created by SimplifyMesh(). Each child has the bounds of the Shape's
+// positions and an LOD range that draws it while its error on screen is
+// below spec.max_screen_error, so exactly one child is drawn at any size.
+// Levels that would not have fewer triangles than the one before them are
+// omitted. The Shape must meet the requirements of SimplifyMesh(); if it does
+// not, a NULL pointer is returned.
+ION_API const gfx::NodePtr BuildLodNode(const gfx::ShapePtr& shape,
+                                        const LodSpec& spec);
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_MESHSIMPLIFIER_H_
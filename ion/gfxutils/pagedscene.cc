@@ -0,0 +1,302 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/pagedscene.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/math/vectorutils.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns the distance from point to the nearest point of range, which is 0
+// if range contains point or is empty.
+static float DistanceToRange(const math::Point3f& point,
+                             const math::Range3f& range) {
+  if (range.IsEmpty())
+    return 0.f;
+  math::Vector3f offset;
+  for (int i = 0; i < 3; ++i) {
+    offset[i] = std::max(std::max(range.GetMinPoint()[i] - point[i], 0.f),
+                         point[i] - range.GetMaxPoint()[i]);
+  }
+  return math::Length(offset);
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// PagedNode.
+//
+//-----------------------------------------------------------------------------
+
+PagedNode::PagedNode(const ContentLoader& loader, const math::Range3f& bounds,
+                     size_t content_size)
+    : loader_(loader),
+      paging_bounds_(bounds),
+      content_size_(content_size),
+      priority_(0),
+      max_distance_(std::numeric_limits<float>::max()),
+      scene_(NULL),
+      state_(kUnloaded),
+      is_wanted_(false),
+      distance_(0.f) {}
+
+PagedNode::~PagedNode() {}
+
+//-----------------------------------------------------------------------------
+//
+// PagedScene.
+//
+//-----------------------------------------------------------------------------
+
+PagedScene::PagedScene(const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      nodes_(allocator_),
+      removed_(allocator_),
+      memory_budget_(std::numeric_limits<size_t>::max()),
+      loaded_size_(0U),
+      loader_thread_count_(1U),
+      max_attaches_per_frame_(4U),
+      max_releases_per_frame_(4U),
+      queue_(allocator_),
+      loaded_(allocator_),
+      pool_(this) {
+  pool_.ResizeThreadPool(loader_thread_count_);
+  pool_.Resume();
+}
+
+PagedScene::~PagedScene() {
+  pool_.Suspend();
+  pool_.ResizeThreadPool(0U);
+  // Loaded content stays in the scene graph.
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    PagedNode* node = nodes_[i].Get();
+    node->scene_ = NULL;
+    node->is_wanted_ = false;
+    if (node->state_ == PagedNode::kQueued ||
+        node->state_ == PagedNode::kLoading)
+      node->state_ = PagedNode::kUnloaded;
+  }
+}
+
+void PagedScene::AddNode(const PagedNodePtr& node) {
+  if (!node.Get()) {
+    LOG(ERROR) << "PagedScene: cannot add a NULL PagedNode";
+    return;
+  }
+  if (node->scene_) {
+    LOG(ERROR) << "PagedScene: PagedNode is already added to a PagedScene";
+    return;
+  }
+  node->scene_ = this;
+  nodes_.push_back(node);
+}
+
+void PagedScene::RemoveNode(const PagedNodePtr& node) {
+  const auto it = std::find(nodes_.begin(), nodes_.end(), node);
+  if (it == nodes_.end()) {
+    LOG(ERROR) << "PagedScene: PagedNode was not added to this PagedScene";
+    return;
+  }
+  if (node->state_ == PagedNode::kLoaded)
+    DetachContent(node.Get());
+  {
+    base::LockGuard guard(&mutex_);
+    // Content that is being loaded is released when it is done.
+    if (node->state_ == PagedNode::kQueued)
+      queue_.erase(std::find(queue_.begin(), queue_.end(), node));
+    node->state_ = PagedNode::kUnloaded;
+  }
+  node->scene_ = NULL;
+  node->is_wanted_ = false;
+  nodes_.erase(it);
+}
+
+void PagedScene::SetLoaderThreadCount(size_t count) {
+  loader_thread_count_ = count;
+  pool_.ResizeThreadPool(count);
+  // Resizing may have consumed the signals for queued content.
+  size_t queued;
+  {
+    base::LockGuard guard(&mutex_);
+    queued = queue_.size();
+  }
+  for (size_t i = 0; i < queued; ++i)
+    pool_.GetWorkSemaphore()->Post();
+}
+
+size_t PagedScene::Update(const math::Point3f& viewer_position) {
+  const size_t queued = RankNodes(viewer_position);
+  for (size_t i = 0; i < queued; ++i)
+    pool_.GetWorkSemaphore()->Post();
+  if (!loader_thread_count_) {
+    for (size_t i = 0; i < max_attaches_per_frame_ && LoadContent(); ++i) {}
+  }
+  const size_t attached = AttachLoadedContent();
+  for (size_t i = 0; i < max_releases_per_frame_ && !removed_.empty(); ++i)
+    removed_.pop_front();
+  return attached;
+}
+
+void PagedScene::ReleaseRemovedContent() {
+  removed_.clear();
+}
+
+size_t PagedScene::GetPendingCount() const {
+  base::LockGuard guard(&mutex_);
+  size_t count = 0U;
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    if (nodes_[i]->state_ == PagedNode::kQueued ||
+        nodes_[i]->state_ == PagedNode::kLoading)
+      ++count;
+  }
+  return count;
+}
+
+size_t PagedScene::RankNodes(const math::Point3f& viewer_position) {
+  base::AllocVector<PagedNode*> ranked(allocator_);
+  ranked.reserve(nodes_.size());
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    PagedNode* node = nodes_[i].Get();
+    node->distance_ = DistanceToRange(viewer_position, node->paging_bounds_);
+    ranked.push_back(node);
+  }
+  std::sort(ranked.begin(), ranked.end(),
+            [](const PagedNode* a, const PagedNode* b) {
+              return a->GetPriority() != b->GetPriority()
+                         ? a->GetPriority() > b->GetPriority()
+                         : a->distance_ < b->distance_;
+            });
+
+  // Content is wanted in rank order until the budget is used up. The queue
+  // is rebuilt in the same order, so that the most important content is
+  // loaded first.
+  size_t newly_queued = 0U;
+  size_t remaining_budget = memory_budget_;
+  bool is_full = false;
+  {
+    base::LockGuard guard(&mutex_);
+    queue_.clear();
+    for (size_t i = 0; i < ranked.size(); ++i) {
+      PagedNode* node = ranked[i];
+      bool is_wanted = node->state_ != PagedNode::kFailed &&
+                       node->distance_ <= node->max_distance_;
+      if (is_wanted) {
+        if (is_full || node->content_size_ > remaining_budget) {
+          is_full = true;
+          is_wanted = false;
+        } else {
+          remaining_budget -= node->content_size_;
+        }
+      }
+      node->is_wanted_ = is_wanted;
+      if (node->state_ == PagedNode::kUnloaded && is_wanted) {
+        node->state_ = PagedNode::kQueued;
+        ++newly_queued;
+      } else if (node->state_ == PagedNode::kQueued && !is_wanted) {
+        node->state_ = PagedNode::kUnloaded;
+      }
+      if (node->state_ == PagedNode::kQueued)
+        queue_.push_back(PagedNodePtr(node));
+    }
+  }
+
+  for (size_t i = 0; i < ranked.size(); ++i) {
+    if (ranked[i]->state_ == PagedNode::kLoaded && !ranked[i]->is_wanted_)
+      DetachContent(ranked[i]);
+  }
+  return newly_queued;
+}
+
+size_t PagedScene::AttachLoadedContent() {
+  base::AllocVector<LoadedContent> loaded(allocator_);
+  {
+    base::LockGuard guard(&mutex_);
+    const size_t count = std::min(loaded_.size(), max_attaches_per_frame_);
+    loaded.assign(loaded_.begin(), loaded_.begin() + count);
+    loaded_.erase(loaded_.begin(), loaded_.begin() + count);
+  }
+  size_t attached = 0U;
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    PagedNode* node = loaded[i].first.Get();
+    const gfx::NodePtr& content = loaded[i].second;
+    // The node may have been removed, or removed and added again, while its
+    // content was loading.
+    if (node->scene_ != this || node->state_ != PagedNode::kLoading) {
+      if (content.Get())
+        removed_.push_back(content);
+    } else if (!content.Get()) {
+      node->state_ = PagedNode::kFailed;
+    } else if (!node->is_wanted_) {
+      node->state_ = PagedNode::kUnloaded;
+      removed_.push_back(content);
+    } else {
+      node->content_ = content;
+      node->AddChild(content);
+      node->state_ = PagedNode::kLoaded;
+      loaded_size_ += node->content_size_;
+      ++attached;
+    }
+  }
+  return attached;
+}
+
+void PagedScene::DetachContent(PagedNode* node) {
+  DCHECK_EQ(PagedNode::kLoaded, node->state_);
+  node->RemoveChild(node->content_);
+  removed_.push_back(node->content_);
+  node->content_.Reset();
+  node->state_ = PagedNode::kUnloaded;
+  loaded_size_ -= node->content_size_;
+}
+
+bool PagedScene::LoadContent() {
+  PagedNodePtr node;
+  {
+    base::LockGuard guard(&mutex_);
+    if (queue_.empty())
+      return false;
+    node = queue_.front();
+    queue_.erase(queue_.begin());
+    node->state_ = PagedNode::kLoading;
+  }
+  const gfx::NodePtr content =
+      node->loader_ ? node->loader_(*node) : gfx::NodePtr();
+  base::LockGuard guard(&mutex_);
+  loaded_.push_back(LoadedContent(node, content));
+  return true;
+}
+
+void PagedScene::DoWork() {
+  LoadContent();
+}
+
+const std::string& PagedScene::GetName() const {
+  static const std::string kName("Ion paged scene loader");
+  return kName;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,240 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef ION_GFXUTILS_PAGEDSCENE_H_
+#define ION_GFXUTILS_PAGEDSCENE_H_
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocdeque.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/workerpool.h"
+#include "ion/gfx/node.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace gfxutils {
+
+class PagedScene;
+
+// A PagedNode is a placeholder in a scene graph for a subgraph that is loaded
+// on demand by a PagedScene. The subgraph, its content, is built by a
+// ContentLoader on a loader thread and added as a child of the PagedNode when
+// it is ready; when it is no longer wanted, it is removed again. A PagedNode
+// may have other children and Shapes, e.g., a coarse proxy to draw until the
+// content is loaded, which are not affected by paging.
+class ION_API PagedNode : public gfx::Node {
+ public:
+  // Builds and returns the content of a PagedNode, including any geometry,
+  // images or text it needs. It is called on the loader threads, so it must
+  // be thread-safe, and it must not modify the scene graph. Returning NULL
+  // means that the content cannot be loaded, and it is not requested again.
+  typedef std::function<gfx::NodePtr(const PagedNode& node)> ContentLoader;
+
+  enum State {
+    kUnloaded,  // The content is not loaded or wanted.
+    kQueued,    // The content is waiting to be loaded.
+    kLoading,   // The content is being loaded or waiting to be added.
+    kLoaded,    // The content is a child of the PagedNode.
+    kFailed     // The loader returned NULL.
+  };
+
+  // Creates a PagedNode whose content, loaded by loader, lies within bounds
+  // and uses about content_size bytes of memory.
+  PagedNode(const ContentLoader& loader, const math::Range3f& bounds,
+            size_t content_size);
+
+  // Returns the bounds passed to the constructor, which are used to find the
+  // distance of the content from the viewer. They are not the Node's bounds
+  // as returned by GetBounds().
+  const math::Range3f& GetPagingBounds() const { return paging_bounds_; }
+  // Returns the estimated memory size of the content.
+  size_t GetContentSize() const { return content_size_; }
+
+  // Sets the priority of the content. Content with a higher priority is
+  // loaded before, and unloaded after, content with a lower priority,
+  // whatever their distances. The default priority is 0.
+  void SetPriority(int priority) { priority_ = priority; }
+  int GetPriority() const { return priority_; }
+  // Sets the distance from the viewer beyond which the content is not
+  // wanted. The default is unlimited.
+  void SetMaxDistance(float distance) { max_distance_ = distance; }
+  float GetMaxDistance() const { return max_distance_; }
+
+  // Returns the paging state of the content. It only changes from kQueued to
+  // kLoading on a loader thread, and otherwise in PagedScene::Update().
+  State GetState() const { return state_; }
+  // Returns the content if it is loaded, and NULL otherwise.
+  const gfx::NodePtr& GetContent() const { return content_; }
+
+ protected:
+  ~PagedNode() override;
+
+ private:
+  const ContentLoader loader_;
+  const math::Range3f paging_bounds_;
+  const size_t content_size_;
+  int priority_;
+  float max_distance_;
+  // These are managed by the PagedScene the node was added to, if any.
+  PagedScene* scene_;
+  std::atomic<State> state_;
+  gfx::NodePtr content_;
+  // Whether the last PagedScene::Update() wanted the content, and the
+  // distance from the viewer it computed.
+  bool is_wanted_;
+  float distance_;
+
+  friend class PagedScene;
+  DISALLOW_COPY_AND_ASSIGN(PagedNode);
+};
+
+typedef base::SharedPtr<PagedNode> PagedNodePtr;
+
+// PagedScene streams the content of PagedNodes in and out of a scene graph
+// under a memory budget, so that applications do not have to build whole
+// scenes up front or tear them down on the drawing thread.
+//
+// Every Update() ranks the PagedNodes added to it by priority and then by
+// distance from the viewer, and wants the content of as many of them, in
+// that order, as fits in the memory budget. Content that is wanted is queued
+// for loading, nearest first, and content that is no longer wanted is
+// removed from its PagedNode. Loading happens on loader threads, and loaded
+// content is only added to the scene graph by Update(), so that the graph
+// never changes while a frame is drawn and a subgraph appears all at once.
+// The number of subgraphs added by each Update() is limited to bound the
+// cost of the first frame that draws them.
+//
+// Removed content is not destroyed right away. Destroying a large subgraph
+// frees many objects, and the Renderer then has to release all of their
+// OpenGL resources, so the references to removed subgraphs are dropped a few
+// at a time by later calls to Update(). The Renderer releases their resources
+// in batches when it next draws (see Renderer::kProcessReleases).
+//
+// Typical usage:
+//   PagedScene paged_scene(allocator);
+//   PagedNodePtr tile(new PagedNode(loader, tile_bounds, tile_size));
+//   paged_scene.AddNode(tile);
+//   root->AddChild(tile);
+//   ...
+//   // Every frame:
+//   paged_scene.Update(camera_position);
+//   renderer->DrawScene(root);
+class ION_API PagedScene : private base::WorkerPool::Worker {
+ public:
+  // The passed allocator is used for all allocations; if it is NULL, the
+  // default allocator is used.
+  explicit PagedScene(const base::AllocatorPtr& allocator);
+  ~PagedScene() override;
+
+  // Adds node to the PagedNodes managed by this. It does not add it to the
+  // scene graph. Logs an error if it is NULL or already added to a
+  // PagedScene.
+  void AddNode(const PagedNodePtr& node);
+  // Removes node from this, removing its content if it is loaded. Logs an
+  // error if it was not added to this.
+  void RemoveNode(const PagedNodePtr& node);
+  // Returns the number of PagedNodes added to this.
+  size_t GetNodeCount() const { return nodes_.size(); }
+
+  // Sets the total content size of the PagedNodes whose content may be
+  // loaded. The default is unlimited.
+  void SetMemoryBudget(size_t bytes) { memory_budget_ = bytes; }
+  size_t GetMemoryBudget() const { return memory_budget_; }
+  // Sets the number of threads that load content. The default is 1. With 0
+  // threads, content is loaded by Update() on the calling thread.
+  void SetLoaderThreadCount(size_t count);
+  size_t GetLoaderThreadCount() const { return loader_thread_count_; }
+  // Sets the maximum number of subgraphs added to the scene graph by each
+  // Update(). The default is 4.
+  void SetMaxAttachesPerFrame(size_t count) { max_attaches_per_frame_ = count; }
+  size_t GetMaxAttachesPerFrame() const { return max_attaches_per_frame_; }
+  // Sets the maximum number of removed subgraphs that each Update() drops
+  // its references to. The default is 4.
+  void SetMaxReleasesPerFrame(size_t count) {
+    max_releases_per_frame_ = count;
+  }
+  size_t GetMaxReleasesPerFrame() const { return max_releases_per_frame_; }
+
+  // Decides which content is wanted for a viewer at viewer_position, queues
+  // it for loading, adds loaded content to the scene graph, removes content
+  // that is no longer wanted, and drops some of the removed subgraphs. This
+  // must be called on the thread that draws, between frames. Returns the
+  // number of subgraphs added.
+  size_t Update(const math::Point3f& viewer_position);
+  // Drops the references to all removed subgraphs immediately, e.g., when
+  // the application is low on memory.
+  void ReleaseRemovedContent();
+
+  // Returns the total content size of the PagedNodes whose content is loaded.
+  size_t GetLoadedSize() const { return loaded_size_; }
+  // Returns the number of PagedNodes whose content is queued or loading.
+  size_t GetPendingCount() const;
+  // Returns the number of removed subgraphs that are still referenced.
+  size_t GetRemovedContentCount() const { return removed_.size(); }
+
+ private:
+  typedef std::pair<PagedNodePtr, gfx::NodePtr> LoadedContent;
+
+  // Ranks the nodes and sets the state of each to what Update() wants,
+  // queueing and unqueueing content. Returns the number of newly queued
+  // nodes.
+  size_t RankNodes(const math::Point3f& viewer_position);
+  // Adds up to GetMaxAttachesPerFrame() loaded subgraphs to their nodes.
+  size_t AttachLoadedContent();
+  // Removes the content of a node, deferring its release.
+  void DetachContent(PagedNode* node);
+  // Loads the first queued content, returning false if there is none.
+  bool LoadContent();
+
+  // WorkerPool::Worker implementation.
+  void DoWork() override;
+  const std::string& GetName() const override;
+
+  base::AllocatorPtr allocator_;
+  base::AllocVector<PagedNodePtr> nodes_;
+  // The removed subgraphs whose references have not been dropped.
+  base::AllocDeque<gfx::NodePtr> removed_;
+  size_t memory_budget_;
+  size_t loaded_size_;
+  size_t loader_thread_count_;
+  size_t max_attaches_per_frame_;
+  size_t max_releases_per_frame_;
+
+  // The nodes whose content is queued, in the order it is loaded, and the
+  // content that has been loaded but not yet added, protected by mutex_. The
+  // states of nodes are also changed under mutex_.
+  base::AllocVector<PagedNodePtr> queue_;
+  base::AllocVector<LoadedContent> loaded_;
+  mutable port::Mutex mutex_;
+  // This must be last so that its threads stop before anything else is
+  // destroyed.
+  base::WorkerPool pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(PagedScene);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_PAGEDSCENE_H_
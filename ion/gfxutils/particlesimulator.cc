@@ -0,0 +1,134 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/particlesimulator.h"
+
+#include <vector>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/shaderinputregistry.h"
+
+namespace ion {
+namespace gfxutils {
+
+ParticleSimulator::ParticleSimulator(
+    const gfx::ShaderProgramPtr& update_program,
+    const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      update_program_(update_program),
+      members_(allocator_),
+      particle_size_(0U),
+      particle_count_(0U),
+      current_(0U),
+      feedback_(new (allocator_) gfx::TransformFeedback),
+      update_node_(new (allocator_) gfx::Node),
+      shape_(new (allocator_) gfx::Shape) {
+  DCHECK(update_program_.Get());
+  // The update step only writes the buffers.
+  feedback_->SetRasterizerDiscardEnabled(true);
+  shape_->SetLabel("Particles");
+  shape_->SetPrimitiveType(gfx::Shape::kPoints);
+  update_node_->SetLabel("Particle update");
+  update_node_->SetShaderProgram(update_program_);
+  update_node_->AddShape(shape_);
+}
+
+ParticleSimulator::~ParticleSimulator() {}
+
+void ParticleSimulator::AddMember(const std::string& attribute_name,
+                                  const std::string& varying_name,
+                                  size_t component_count) {
+  if (component_count < 1U || component_count > 4U) {
+    LOG(ERROR) << "ParticleSimulator: member '" << attribute_name
+               << "' must have between 1 and 4 components";
+    return;
+  }
+  Member member;
+  member.attribute_name = attribute_name;
+  member.component_count = component_count;
+  member.byte_offset = particle_size_;
+  members_.push_back(member);
+  particle_size_ += component_count * sizeof(float);
+
+  std::vector<std::string> varyings = update_program_->GetCapturedVaryings();
+  varyings.push_back(varying_name);
+  update_program_->SetCapturedVaryings(varyings);
+}
+
+void ParticleSimulator::SetParticles(const base::DataContainerPtr& data,
+                                     size_t count) {
+  if (!data.Get() || !data->GetData()) {
+    LOG(ERROR) << "ParticleSimulator: cannot set particles without data";
+    return;
+  }
+  if (!particle_size_) {
+    LOG(ERROR) << "ParticleSimulator: members must be added before particles";
+    return;
+  }
+
+  const gfx::ShaderInputRegistryPtr& reg = update_program_->GetRegistry();
+  for (int i = 0; i < 2; ++i) {
+    // The first buffer holds the initial state, and the second only needs
+    // storage for the states written into it.
+    buffers_[i] = new (allocator_) gfx::BufferObject;
+    buffers_[i]->SetData(
+        i == 0 ? data
+               : base::DataContainer::CreateAndCopy<uint8>(
+                     NULL, particle_size_ * count, true, allocator_),
+        particle_size_, count, gfx::BufferObject::kDynamicDraw);
+    attribute_arrays_[i] = new (allocator_) gfx::AttributeArray;
+    for (size_t j = 0; j < members_.size(); ++j) {
+      const Member& member = members_[j];
+      attribute_arrays_[i]->AddAttribute(reg->Create<gfx::Attribute>(
+          member.attribute_name,
+          gfx::BufferObjectElement(
+              buffers_[i], buffers_[i]->AddSpec(gfx::BufferObject::kFloat,
+                                                member.component_count,
+                                                member.byte_offset))));
+    }
+  }
+  particle_count_ = count;
+  current_ = 0U;
+  shape_->SetAttributeArray(attribute_arrays_[current_]);
+}
+
+void ParticleSimulator::Step(gfx::Renderer* renderer) {
+  if (!particle_count_)
+    return;
+  // Without transform feedback the update program would draw the particles
+  // instead of updating them.
+  if (!renderer->GetGraphicsManager()->IsFunctionGroupAvailable(
+          gfx::GraphicsManager::kTransformFeedback)) {
+    LOG_ONCE(ERROR) << "ParticleSimulator: transform feedback is not"
+                    << " supported on this platform";
+    return;
+  }
+
+  const size_t next = 1U - current_;
+  feedback_->SetCaptureBuffer(buffers_[next]);
+  renderer->BeginTransformFeedback(feedback_);
+  renderer->DrawScene(update_node_);
+  renderer->EndTransformFeedback();
+  current_ = next;
+  shape_->SetAttributeArray(attribute_arrays_[current_]);
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,133 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_PARTICLESIMULATOR_H_
+#define ION_GFXUTILS_PARTICLESIMULATOR_H_
+
+#include <string>
+
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/transformfeedback.h"
+
+namespace ion {
+namespace gfxutils {
+
+// ParticleSimulator updates the state of a particle system entirely on the GPU
+// with transform feedback, so that the particles never need to be updated on
+// the CPU and uploaded again. The state is kept in two BufferObjects. Each
+// Step() draws the particles in the current buffer as points with an update
+// ShaderProgram that reads each member of the state from an attribute and
+// writes its new value to a varying, capturing the varyings into the other
+// buffer, and then swaps the buffers.
+//
+// Typical usage:
+//   ParticleSimulator simulator(update_program, allocator);
+//   simulator.AddMember("aPosition", "vPosition", 3);
+//   simulator.AddMember("aVelocity", "vVelocity", 3);
+//   simulator.SetParticles(initial_state, particle_count);
+//   draw_node->AddShape(simulator.GetShape());
+//   simulator.GetUpdateNode()->AddUniform(
+//       reg->Create<Uniform>("uTimeStep", 1.f / 60.f));
+//   ...
+//   // Every frame:
+//   simulator.Step(renderer.Get());
+//   renderer->DrawScene(draw_node);
+//
+// The members of the state are vectors of floats stored in the order they are
+// added, without padding, since that is how OpenGL writes interleaved
+// varyings. Transform feedback requires OpenGL ES 3.0 or desktop OpenGL 4.0;
+// without it, Step() logs an error and the state does not change.
+class ION_API ParticleSimulator {
+ public:
+  // The update program's captured varyings are set by AddMember(). The passed
+  // allocator is used for all allocations; if it is NULL, the default
+  // allocator is used.
+  ParticleSimulator(const gfx::ShaderProgramPtr& update_program,
+                    const base::AllocatorPtr& allocator);
+  ~ParticleSimulator();
+
+  // Adds a member of the particle state, a vector of component_count floats
+  // that the update program reads from the attribute attribute_name and writes
+  // to the varying varying_name. Members must be added before SetParticles().
+  // Logs an error if component_count is not between 1 and 4.
+  void AddMember(const std::string& attribute_name,
+                 const std::string& varying_name, size_t component_count);
+  // Returns the size in bytes of the state of each particle.
+  size_t GetParticleSize() const { return particle_size_; }
+
+  // Sets the initial state of count particles of GetParticleSize() bytes each,
+  // stored in data, replacing any previous particles. Logs an error if data
+  // holds no data.
+  void SetParticles(const base::DataContainerPtr& data, size_t count);
+  // Returns the number of particles.
+  size_t GetParticleCount() const { return particle_count_; }
+
+  // Advances the simulation by one step, running the update program once for
+  // each particle. Nothing is drawn into the framebuffer.
+  void Step(gfx::Renderer* renderer);
+
+  // Returns the Node drawn by Step(), to which Uniforms of the update program,
+  // such as the time step, can be added.
+  const gfx::NodePtr& GetUpdateNode() const { return update_node_; }
+  // Returns a Shape that draws the particles as points from their current
+  // state, with the members in the same attributes as the update program. Its
+  // AttributeArray is replaced by every Step().
+  const gfx::ShapePtr& GetShape() const { return shape_; }
+  // Returns the BufferObject holding the current state.
+  const gfx::BufferObjectPtr& GetCurrentBuffer() const {
+    return buffers_[current_];
+  }
+
+ private:
+  // A member of the particle state.
+  struct Member {
+    std::string attribute_name;
+    size_t component_count;
+    size_t byte_offset;
+  };
+
+  base::AllocatorPtr allocator_;
+  gfx::ShaderProgramPtr update_program_;
+  base::AllocVector<Member> members_;
+  size_t particle_size_;
+  size_t particle_count_;
+  // The buffers holding the current and next states, and an AttributeArray
+  // reading the members from each.
+  gfx::BufferObjectPtr buffers_[2];
+  gfx::AttributeArrayPtr attribute_arrays_[2];
+  // The index of the buffer holding the current state.
+  size_t current_;
+  gfx::TransformFeedbackPtr feedback_;
+  gfx::NodePtr update_node_;
+  gfx::ShapePtr shape_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParticleSimulator);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_PARTICLESIMULATOR_H_
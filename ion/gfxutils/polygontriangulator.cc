@@ -0,0 +1,818 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/polygontriangulator.h"
+
+#include <string.h>  // For memmove().
+
+#include <algorithm>
+#include <limits>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/arenaallocator.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/base/stlalloc/allocdeque.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/taskscheduler.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Rings with more vertices than this are sorted along a Z-order curve.
+static const size_t kMinHashedVertexCount = 80U;
+
+// The largest number of vertices that unsigned short indices can address.
+static const size_t kMaxShortVertexCount = 65536U;
+
+// A vertex in a doubly linked ring. Vertices that are also linked in Z-order
+// have a non-NULL prev_z or next_z.
+struct Node {
+  Node(uint32 index_in, double x_in, double y_in)
+      : index(index_in),
+        z(0U),
+        x(x_in),
+        y(y_in),
+        prev(NULL),
+        next(NULL),
+        prev_z(NULL),
+        next_z(NULL),
+        is_steiner(false) {}
+  // The index of the vertex in the polygon.
+  uint32 index;
+  // The Z-order curve value of the vertex.
+  uint32 z;
+  double x;
+  double y;
+  Node* prev;
+  Node* next;
+  Node* prev_z;
+  Node* next_z;
+  // Whether this is a hole consisting of a single vertex, which must not be
+  // filtered out.
+  bool is_steiner;
+};
+
+// Returns twice the signed area of triangle pqr, which is negative if it is
+// counterclockwise with +Y up.
+static double Area(const Node* p, const Node* q, const Node* r) {
+  return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+}
+
+static bool Equals(const Node* a, const Node* b) {
+  return a->x == b->x && a->y == b->y;
+}
+
+// Returns whether point p is inside triangle abc.
+static bool PointInTriangle(double ax, double ay, double bx, double by,
+                            double cx, double cy, double px, double py) {
+  return (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+         (ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+         (bx - px) * (cy - py) >= (cx - px) * (by - py);
+}
+
+static int Sign(double value) {
+  return value > 0.0 ? 1 : value < 0.0 ? -1 : 0;
+}
+
+// Returns whether q lies in the bounding box of collinear points p and r.
+static bool OnSegment(const Node* p, const Node* q, const Node* r) {
+  return q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) &&
+         q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+}
+
+// Returns whether segments p1q1 and p2q2 intersect.
+static bool Intersects(const Node* p1, const Node* q1, const Node* p2,
+                       const Node* q2) {
+  const int o1 = Sign(Area(p1, q1, p2));
+  const int o2 = Sign(Area(p1, q1, q2));
+  const int o3 = Sign(Area(p2, q2, p1));
+  const int o4 = Sign(Area(p2, q2, q1));
+  return (o1 != o2 && o3 != o4) ||
+         (o1 == 0 && OnSegment(p1, p2, q1)) ||
+         (o2 == 0 && OnSegment(p1, q2, q1)) ||
+         (o3 == 0 && OnSegment(p2, p1, q2)) ||
+         (o4 == 0 && OnSegment(p2, q1, q2));
+}
+
+// Returns whether diagonal ab intersects any edge of the ring of a that does
+// not share a vertex with it.
+static bool IntersectsRing(const Node* a, const Node* b) {
+  const Node* p = a;
+  do {
+    if (p->index != a->index && p->next->index != a->index &&
+        p->index != b->index && p->next->index != b->index &&
+        Intersects(p, p->next, a, b))
+      return true;
+    p = p->next;
+  } while (p != a);
+  return false;
+}
+
+// Returns whether diagonal ab starts into the interior of the ring at a.
+static bool LocallyInside(const Node* a, const Node* b) {
+  return Area(a->prev, a, a->next) < 0.0
+             ? Area(a, b, a->next) >= 0.0 && Area(a, a->prev, b) >= 0.0
+             : Area(a, b, a->prev) < 0.0 || Area(a, a->next, b) < 0.0;
+}
+
+// Returns whether the midpoint of diagonal ab is inside the ring of a.
+static bool MiddleInside(const Node* a, const Node* b) {
+  const double px = (a->x + b->x) / 2.0;
+  const double py = (a->y + b->y) / 2.0;
+  bool inside = false;
+  const Node* p = a;
+  do {
+    if ((p->y > py) != (p->next->y > py) && p->next->y != p->y &&
+        px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x)
+      inside = !inside;
+    p = p->next;
+  } while (p != a);
+  return inside;
+}
+
+// Returns whether ab is a diagonal along which the ring can be split.
+static bool IsValidDiagonal(const Node* a, const Node* b) {
+  if (a->next->index == b->index || a->prev->index == b->index ||
+      IntersectsRing(a, b))
+    return false;
+  if (LocallyInside(a, b) && LocallyInside(b, a) && MiddleInside(a, b) &&
+      (Area(a->prev, a, b->prev) != 0.0 || Area(a, b->prev, b) != 0.0))
+    return true;
+  // A zero-length diagonal between coincident vertices of convex corners.
+  return Equals(a, b) && Area(a->prev, a, a->next) > 0.0 &&
+         Area(b->prev, b, b->next) > 0.0;
+}
+
+// Returns whether the sector of the ring at m contains the sector at p,
+// which share a vertex position.
+static bool SectorContainsSector(const Node* m, const Node* p) {
+  return Area(m->prev, m, p->prev) < 0.0 && Area(p->next, m, m->next) < 0.0;
+}
+
+// Returns the leftmost vertex of a ring, the lowest one of those with equal
+// x.
+static Node* GetLeftmost(Node* start) {
+  Node* p = start;
+  Node* leftmost = start;
+  do {
+    if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y))
+      leftmost = p;
+    p = p->next;
+  } while (p != start);
+  return leftmost;
+}
+
+static void RemoveNode(Node* p) {
+  p->next->prev = p->prev;
+  p->prev->next = p->next;
+  if (p->prev_z)
+    p->prev_z->next_z = p->next_z;
+  if (p->next_z)
+    p->next_z->prev_z = p->prev_z;
+}
+
+// Returns the Z-order curve value of a point, given the minimum corner of the
+// bounding box and the factor mapping it to 15 bits.
+static uint32 ZOrder(double x, double y, double min_x, double min_y,
+                     double inv_size) {
+  uint32 ix = static_cast<uint32>((x - min_x) * inv_size);
+  uint32 iy = static_cast<uint32>((y - min_y) * inv_size);
+  ix = (ix | (ix << 8)) & 0x00FF00FF;
+  ix = (ix | (ix << 4)) & 0x0F0F0F0F;
+  ix = (ix | (ix << 2)) & 0x33333333;
+  ix = (ix | (ix << 1)) & 0x55555555;
+  iy = (iy | (iy << 8)) & 0x00FF00FF;
+  iy = (iy | (iy << 4)) & 0x0F0F0F0F;
+  iy = (iy | (iy << 2)) & 0x33333333;
+  iy = (iy | (iy << 1)) & 0x55555555;
+  return ix | (iy << 1);
+}
+
+// Sorts a list linked through next_z by z with a bottom-up merge sort, which
+// needs no extra memory.
+static void SortByZ(Node* list) {
+  size_t run_size = 1U;
+  size_t merge_count;
+  do {
+    Node* p = list;
+    Node* tail = NULL;
+    list = NULL;
+    merge_count = 0U;
+    while (p) {
+      ++merge_count;
+      Node* q = p;
+      size_t p_size = 0U;
+      for (size_t i = 0; i < run_size && q; ++i) {
+        ++p_size;
+        q = q->next_z;
+      }
+      size_t q_size = run_size;
+      while (p_size || (q_size && q)) {
+        Node* e;
+        if (p_size && (!q_size || !q || p->z <= q->z)) {
+          e = p;
+          p = p->next_z;
+          --p_size;
+        } else {
+          e = q;
+          q = q->next_z;
+          --q_size;
+        }
+        if (tail)
+          tail->next_z = e;
+        else
+          list = e;
+        e->prev_z = tail;
+        tail = e;
+      }
+      p = q;
+    }
+    tail->next_z = NULL;
+    run_size *= 2U;
+  } while (merge_count > 1U);
+}
+
+// Triangulates a single polygon, writing the indices of its triangles offset
+// by a base index as T.
+template <typename T>
+class Triangulator {
+ public:
+  Triangulator(const TriangulationPolygon& polygon, uint32 base_index,
+               const base::AllocatorPtr& allocator)
+      : polygon_(polygon),
+        base_index_(base_index),
+        nodes_(allocator),
+        holes_(allocator),
+        out_(NULL),
+        min_x_(0.0),
+        min_y_(0.0),
+        inv_size_(0.0) {}
+
+  // Writes the triangles of the polygon to out, which must have room for
+  // GetMaxTriangleCount() of them. Returns the number of triangles.
+  size_t Run(T* out);
+
+ private:
+  Node* AddNode(uint32 index, double x, double y, Node* last);
+  // Links the vertices [begin, end) into a ring, counterclockwise if
+  // counterclockwise is set and clockwise otherwise.
+  Node* LinkRing(size_t begin, size_t end, bool counterclockwise);
+  // Removes duplicate and collinear vertices between start and end. Returns
+  // the last vertex kept.
+  Node* FilterPoints(Node* start, Node* end);
+  // Joins all holes to the outer ring, returning a vertex of the result.
+  Node* EliminateHoles(Node* outer);
+  Node* EliminateHole(Node* hole, Node* outer);
+  // Returns the vertex of the outer ring that a hole's leftmost vertex can be
+  // connected to, or NULL if there is none.
+  Node* FindHoleBridge(Node* hole, Node* outer);
+  // Splits the ring of a and b along diagonal ab into two, duplicating a and
+  // b. Returns the copy of b.
+  Node* SplitRing(Node* a, Node* b);
+
+  void AddTriangle(const Node* a, const Node* b, const Node* c);
+  void ClipEars(Node* ear, int pass);
+  bool IsEar(const Node* ear) const;
+  bool IsEarHashed(const Node* ear) const;
+  void IndexCurve(Node* start);
+  // Clips the triangles of small self-intersections of the ring.
+  Node* CureLocalIntersections(Node* start);
+  // Splits the ring along a valid diagonal and triangulates both halves.
+  void SplitClipEars(Node* start);
+
+  const TriangulationPolygon& polygon_;
+  const uint32 base_index_;
+  // A deque keeps the nodes in place as it grows.
+  base::AllocDeque<Node> nodes_;
+  base::AllocVector<Node*> holes_;
+  T* out_;
+  // The bounding box and scale of the Z-order curve, if the ring is hashed.
+  double min_x_;
+  double min_y_;
+  double inv_size_;
+};
+
+template <typename T>
+size_t Triangulator<T>::Run(T* out) {
+  out_ = out;
+  const size_t outer_end =
+      polygon_.hole_count ? polygon_.hole_starts[0] : polygon_.vertex_count;
+  Node* outer = LinkRing(0U, outer_end, true);
+  if (!outer || outer->next == outer->prev)
+    return 0U;
+  if (polygon_.hole_count)
+    outer = EliminateHoles(outer);
+
+  if (polygon_.vertex_count > kMinHashedVertexCount) {
+    double max_x = -std::numeric_limits<double>::max();
+    double max_y = -std::numeric_limits<double>::max();
+    min_x_ = min_y_ = std::numeric_limits<double>::max();
+    for (size_t i = 0; i < outer_end; ++i) {
+      const math::Point2f& v = polygon_.vertices[i];
+      min_x_ = std::min(min_x_, static_cast<double>(v[0]));
+      min_y_ = std::min(min_y_, static_cast<double>(v[1]));
+      max_x = std::max(max_x, static_cast<double>(v[0]));
+      max_y = std::max(max_y, static_cast<double>(v[1]));
+    }
+    const double size = std::max(max_x - min_x_, max_y - min_y_);
+    inv_size_ = size != 0.0 ? 32767.0 / size : 0.0;
+  }
+  ClipEars(outer, 0);
+  return static_cast<size_t>(out_ - out) / 3U;
+}
+
+template <typename T>
+Node* Triangulator<T>::AddNode(uint32 index, double x, double y, Node* last) {
+  nodes_.push_back(Node(index, x, y));
+  Node* p = &nodes_.back();
+  if (last) {
+    p->next = last->next;
+    p->prev = last;
+    last->next->prev = p;
+    last->next = p;
+  } else {
+    p->prev = p;
+    p->next = p;
+  }
+  return p;
+}
+
+template <typename T>
+Node* Triangulator<T>::LinkRing(size_t begin, size_t end,
+                                bool counterclockwise) {
+  if (begin >= end)
+    return NULL;
+  const math::Point2f* v = polygon_.vertices;
+  double area = 0.0;
+  for (size_t i = begin, j = end - 1U; i < end; j = i++)
+    area += (static_cast<double>(v[j][0]) - v[i][0]) *
+            (static_cast<double>(v[i][1]) + v[j][1]);
+  Node* last = NULL;
+  if (counterclockwise == (area > 0.0)) {
+    for (size_t i = begin; i < end; ++i)
+      last = AddNode(static_cast<uint32>(i), v[i][0], v[i][1], last);
+  } else {
+    for (size_t i = end; i > begin; --i)
+      last = AddNode(static_cast<uint32>(i - 1U), v[i - 1U][0],
+                     v[i - 1U][1], last);
+  }
+  if (last && Equals(last, last->next)) {
+    RemoveNode(last);
+    last = last->next;
+  }
+  return last;
+}
+
+template <typename T>
+Node* Triangulator<T>::FilterPoints(Node* start, Node* end) {
+  if (!start)
+    return start;
+  if (!end)
+    end = start;
+  Node* p = start;
+  bool again;
+  do {
+    again = false;
+    if (!p->is_steiner &&
+        (Equals(p, p->next) || Area(p->prev, p, p->next) == 0.0)) {
+      RemoveNode(p);
+      p = end = p->prev;
+      if (p == p->next)
+        break;
+      again = true;
+    } else {
+      p = p->next;
+    }
+  } while (again || p != end);
+  return end;
+}
+
+template <typename T>
+Node* Triangulator<T>::EliminateHoles(Node* outer) {
+  holes_.clear();
+  for (size_t i = 0; i < polygon_.hole_count; ++i) {
+    const size_t begin = polygon_.hole_starts[i];
+    const size_t end = i + 1U < polygon_.hole_count
+                           ? polygon_.hole_starts[i + 1U]
+                           : polygon_.vertex_count;
+    if (Node* ring = LinkRing(begin, end, false)) {
+      if (ring == ring->next)
+        ring->is_steiner = true;
+      holes_.push_back(GetLeftmost(ring));
+    }
+  }
+  // Holes are joined from left to right, so that each bridge only has to
+  // avoid the holes already joined.
+  std::sort(holes_.begin(), holes_.end(),
+            [](const Node* a, const Node* b) { return a->x < b->x; });
+  for (size_t i = 0; i < holes_.size(); ++i)
+    outer = EliminateHole(holes_[i], outer);
+  return outer;
+}
+
+template <typename T>
+Node* Triangulator<T>::EliminateHole(Node* hole, Node* outer) {
+  Node* bridge = FindHoleBridge(hole, outer);
+  if (!bridge)
+    return outer;
+  Node* bridge_reverse = SplitRing(bridge, hole);
+  FilterPoints(bridge_reverse, bridge_reverse->next);
+  return FilterPoints(bridge, bridge->next);
+}
+
+template <typename T>
+Node* Triangulator<T>::FindHoleBridge(Node* hole, Node* outer) {
+  // Find the nearest segment of the outer ring to the left of the hole's
+  // leftmost vertex, and its endpoint with the larger x.
+  const double hx = hole->x;
+  const double hy = hole->y;
+  double qx = -std::numeric_limits<double>::max();
+  Node* m = NULL;
+  Node* p = outer;
+  do {
+    if (hy <= p->y && hy >= p->next->y && p->next->y != p->y) {
+      const double x =
+          p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+      if (x <= hx && x > qx) {
+        qx = x;
+        m = p->x < p->next->x ? p : p->next;
+        if (x == hx)
+          return m;
+      }
+    }
+    p = p->next;
+  } while (p != outer);
+  if (!m)
+    return NULL;
+
+  // If a reflex vertex of the outer ring lies inside the triangle between
+  // the hole vertex, the intersection and m, connect to the one of those
+  // that makes the smallest angle with the horizontal instead.
+  Node* stop = m;
+  const double mx = m->x;
+  const double my = m->y;
+  double tan_min = std::numeric_limits<double>::max();
+  p = m;
+  do {
+    if (hx >= p->x && p->x >= mx && hx != p->x &&
+        PointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy,
+                        p->x, p->y)) {
+      const double tan = std::abs(hy - p->y) / (hx - p->x);
+      if (LocallyInside(p, hole) &&
+          (tan < tan_min ||
+           (tan == tan_min &&
+            (p->x > m->x ||
+             (p->x == m->x && SectorContainsSector(m, p)))))) {
+        m = p;
+        tan_min = tan;
+      }
+    }
+    p = p->next;
+  } while (p != stop);
+  return m;
+}
+
+template <typename T>
+Node* Triangulator<T>::SplitRing(Node* a, Node* b) {
+  Node* a2 = AddNode(a->index, a->x, a->y, NULL);
+  Node* b2 = AddNode(b->index, b->x, b->y, NULL);
+  Node* an = a->next;
+  Node* bp = b->prev;
+  a->next = b;
+  b->prev = a;
+  a2->next = an;
+  an->prev = a2;
+  b2->next = a2;
+  a2->prev = b2;
+  bp->next = b2;
+  b2->prev = bp;
+  return b2;
+}
+
+template <typename T>
+void Triangulator<T>::AddTriangle(const Node* a, const Node* b,
+                                  const Node* c) {
+  *out_++ = static_cast<T>(base_index_ + a->index);
+  *out_++ = static_cast<T>(base_index_ + b->index);
+  *out_++ = static_cast<T>(base_index_ + c->index);
+}
+
+template <typename T>
+void Triangulator<T>::ClipEars(Node* ear, int pass) {
+  if (!ear)
+    return;
+  if (!pass && inv_size_ != 0.0)
+    IndexCurve(ear);
+
+  Node* stop = ear;
+  while (ear->prev != ear->next) {
+    Node* prev = ear->prev;
+    Node* next = ear->next;
+    if (inv_size_ != 0.0 ? IsEarHashed(ear) : IsEar(ear)) {
+      AddTriangle(prev, ear, next);
+      RemoveNode(ear);
+      // Skipping the next vertex leaves fewer sliver triangles.
+      ear = stop = next->next;
+      continue;
+    }
+    ear = next;
+    // If the whole ring has been walked without finding an ear, first remove
+    // degenerate vertices, then cure small self-intersections, and finally
+    // split the ring in two.
+    if (ear == stop) {
+      if (pass == 0) {
+        ClipEars(FilterPoints(ear, NULL), 1);
+      } else if (pass == 1) {
+        ClipEars(CureLocalIntersections(FilterPoints(ear, NULL)), 2);
+      } else {
+        SplitClipEars(ear);
+      }
+      break;
+    }
+  }
+}
+
+template <typename T>
+bool Triangulator<T>::IsEar(const Node* ear) const {
+  const Node* a = ear->prev;
+  const Node* b = ear;
+  const Node* c = ear->next;
+  // Reflex vertices are not ears.
+  if (Area(a, b, c) >= 0.0)
+    return false;
+  for (const Node* p = c->next; p != a; p = p->next) {
+    if (PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+        Area(p->prev, p, p->next) >= 0.0)
+      return false;
+  }
+  return true;
+}
+
+template <typename T>
+bool Triangulator<T>::IsEarHashed(const Node* ear) const {
+  const Node* a = ear->prev;
+  const Node* b = ear;
+  const Node* c = ear->next;
+  if (Area(a, b, c) >= 0.0)
+    return false;
+
+  // Only vertices whose Z-order values are within those of the triangle's
+  // bounding box can be inside it.
+  const uint32 min_z =
+      ZOrder(std::min(a->x, std::min(b->x, c->x)),
+             std::min(a->y, std::min(b->y, c->y)), min_x_, min_y_, inv_size_);
+  const uint32 max_z =
+      ZOrder(std::max(a->x, std::max(b->x, c->x)),
+             std::max(a->y, std::max(b->y, c->y)), min_x_, min_y_, inv_size_);
+  const auto blocks_ear = [a, b, c, ear](const Node* p) {
+    return p != ear->prev && p != ear->next &&
+           PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) &&
+           Area(p->prev, p, p->next) >= 0.0;
+  };
+  // Look in both directions from the ear at once.
+  const Node* p = ear->prev_z;
+  const Node* n = ear->next_z;
+  while (p && p->z >= min_z && n && n->z <= max_z) {
+    if (blocks_ear(p) || blocks_ear(n))
+      return false;
+    p = p->prev_z;
+    n = n->next_z;
+  }
+  for (; p && p->z >= min_z; p = p->prev_z) {
+    if (blocks_ear(p))
+      return false;
+  }
+  for (; n && n->z <= max_z; n = n->next_z) {
+    if (blocks_ear(n))
+      return false;
+  }
+  return true;
+}
+
+template <typename T>
+void Triangulator<T>::IndexCurve(Node* start) {
+  Node* p = start;
+  do {
+    p->z = ZOrder(p->x, p->y, min_x_, min_y_, inv_size_);
+    p->prev_z = p->prev;
+    p->next_z = p->next;
+    p = p->next;
+  } while (p != start);
+  p->prev_z->next_z = NULL;
+  p->prev_z = NULL;
+  SortByZ(p);
+}
+
+template <typename T>
+Node* Triangulator<T>::CureLocalIntersections(Node* start) {
+  Node* p = start;
+  do {
+    Node* a = p->prev;
+    Node* b = p->next->next;
+    if (!Equals(a, b) && Intersects(a, p, p->next, b) && LocallyInside(a, b) &&
+        LocallyInside(b, a)) {
+      AddTriangle(a, p, b);
+      RemoveNode(p);
+      RemoveNode(p->next);
+      p = start = b;
+    }
+    p = p->next;
+  } while (p != start);
+  return FilterPoints(p, NULL);
+}
+
+template <typename T>
+void Triangulator<T>::SplitClipEars(Node* start) {
+  Node* a = start;
+  do {
+    for (Node* b = a->next->next; b != a->prev; b = b->next) {
+      if (a->index != b->index && IsValidDiagonal(a, b)) {
+        Node* c = SplitRing(a, b);
+        a = FilterPoints(a, a->next);
+        c = FilterPoints(c, c->next);
+        ClipEars(a, 0);
+        ClipEars(c, 0);
+        return;
+      }
+    }
+    a = a->next;
+  } while (a != start);
+}
+
+// Returns whether the hole starts of polygon are valid, logging an error if
+// not.
+static bool ValidatePolygon(const TriangulationPolygon& polygon) {
+  for (size_t i = 0; i < polygon.hole_count; ++i) {
+    if (polygon.hole_starts[i] > polygon.vertex_count ||
+        (i && polygon.hole_starts[i] < polygon.hole_starts[i - 1U])) {
+      LOG(ERROR) << "Hole starts of polygon are out of order or out of range";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Triangulates the polygons [begin, end) into indices of type T, with the
+// vertex and index offsets of each polygon given in vertex_starts and
+// index_starts. index_counts holds the room for the indices of each polygon,
+// and is set to the number of indices written; polygons without room are
+// skipped.
+template <typename T>
+static void TriangulateRange(
+    const std::vector<TriangulationPolygon>& polygons,
+    const std::vector<size_t>& vertex_starts,
+    const std::vector<size_t>& index_starts,
+    const base::ArenaAllocatorPtr& arena, size_t begin, size_t end,
+    T* indices, std::vector<size_t>* index_counts) {
+  for (size_t i = begin; i < end; ++i) {
+    if (!(*index_counts)[i])
+      continue;
+    {
+      Triangulator<T> triangulator(
+          polygons[i], static_cast<uint32>(vertex_starts[i]), arena);
+      (*index_counts)[i] = 3U * triangulator.Run(indices + index_starts[i]);
+    }
+    // The nodes are gone, so the arena of this thread can be rewound for the
+    // next polygon.
+    arena->EndFrame();
+  }
+}
+
+}  // anonymous namespace
+
+size_t GetMaxTriangleCount(const TriangulationPolygon& polygon) {
+  return polygon.vertex_count < 3U
+             ? 0U
+             : polygon.vertex_count + 2U * polygon.hole_count - 2U;
+}
+
+size_t TriangulatePolygon(const TriangulationPolygon& polygon,
+                          std::vector<uint32>* indices) {
+  DCHECK(indices);
+  const size_t max_count = GetMaxTriangleCount(polygon);
+  if (!max_count || !ValidatePolygon(polygon))
+    return 0U;
+  const size_t start = indices->size();
+  indices->resize(start + 3U * max_count);
+  Triangulator<uint32> triangulator(
+      polygon, 0U,
+      base::AllocationManager::GetDefaultAllocatorForLifetime(
+          base::kShortTerm));
+  const size_t count = triangulator.Run(&(*indices)[start]);
+  indices->resize(start + 3U * count);
+  return count;
+}
+
+const TriangulatedPolygons TriangulatePolygons(
+    const std::vector<TriangulationPolygon>& polygons,
+    gfx::BufferObject::UsageMode usage_mode,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler) {
+  const base::AllocatorPtr& al =
+      base::AllocationManager::GetNonNullAllocator(allocator);
+  const size_t polygon_count = polygons.size();
+
+  // Each polygon gets room for its largest possible triangulation, so that
+  // the polygons can be written independently.
+  std::vector<size_t> vertex_starts(polygon_count);
+  std::vector<size_t> index_starts(polygon_count);
+  std::vector<size_t> index_counts(polygon_count);
+  size_t vertex_count = 0U;
+  size_t index_count = 0U;
+  size_t max_node_count = 0U;
+  for (size_t i = 0; i < polygon_count; ++i) {
+    const TriangulationPolygon& polygon = polygons[i];
+    vertex_starts[i] = vertex_count;
+    index_starts[i] = index_count;
+    vertex_count += polygon.vertex_count;
+    index_counts[i] = 0U;
+    if (ValidatePolygon(polygon)) {
+      index_counts[i] = 3U * GetMaxTriangleCount(polygon);
+      index_count += index_counts[i];
+      max_node_count = std::max(max_node_count,
+                                polygon.vertex_count + 2U * polygon.hole_count);
+    }
+  }
+
+  TriangulatedPolygons result;
+  base::DataContainerPtr vertex_data =
+      base::DataContainer::CreateAndCopy<math::Point2f>(NULL, vertex_count,
+                                                        false, al);
+  math::Point2f* vertices = vertex_data->GetMutableData<math::Point2f>();
+  const bool use_short_indices = vertex_count <= kMaxShortVertexCount;
+  const size_t index_size =
+      use_short_indices ? sizeof(uint16) : sizeof(uint32);
+  base::DataContainerPtr index_data =
+      base::DataContainer::CreateAndCopy<uint8>(NULL, index_count * index_size,
+                                                false, al);
+  uint8* indices = index_data->GetMutableData<uint8>();
+
+  // Splits of degenerate rings add a few nodes beyond the bridges of holes,
+  // and the deque allocates in blocks, so leave some slack.
+  base::ArenaAllocatorPtr arena(
+      new base::ArenaAllocator(2U * max_node_count * sizeof(Node) + 4096U));
+  const auto triangulate = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      if (polygons[i].vertex_count)
+        memcpy(vertices + vertex_starts[i], polygons[i].vertices,
+               polygons[i].vertex_count * sizeof(math::Point2f));
+    }
+    if (use_short_indices)
+      TriangulateRange(polygons, vertex_starts, index_starts, arena, begin,
+                       end, reinterpret_cast<uint16*>(indices),
+                       &index_counts);
+    else
+      TriangulateRange(polygons, vertex_starts, index_starts, arena, begin,
+                       end, reinterpret_cast<uint32*>(indices),
+                       &index_counts);
+  };
+  if (scheduler && polygon_count > 1U)
+    scheduler->ParallelFor(0U, polygon_count, 0U, triangulate);
+  else if (polygon_count)
+    triangulate(0U, polygon_count);
+
+  // Close the gaps left by polygons with degenerate vertices, which have
+  // fewer triangles than the room they were given.
+  size_t used_count = 0U;
+  result.index_ranges.resize(polygon_count);
+  for (size_t i = 0; i < polygon_count; ++i) {
+    if (used_count != index_starts[i] && index_counts[i])
+      memmove(indices + used_count * index_size,
+              indices + index_starts[i] * index_size,
+              index_counts[i] * index_size);
+    result.index_ranges[i].Set(static_cast<int>(used_count),
+                               static_cast<int>(used_count + index_counts[i]));
+    used_count += index_counts[i];
+  }
+
+  result.vertex_buffer = new (al) gfx::BufferObject;
+  result.vertex_buffer->AddSpec(gfx::BufferObject::kFloat, 2, 0);
+  result.vertex_buffer->SetData(vertex_data, sizeof(math::Point2f),
+                                vertex_count, usage_mode);
+  result.index_buffer = new (al) gfx::IndexBuffer;
+  result.index_buffer->AddSpec(use_short_indices
+                                   ? gfx::BufferObject::kUnsignedShort
+                                   : gfx::BufferObject::kUnsignedInt,
+                               1, 0);
+  result.index_buffer->SetData(index_data, index_size, used_count,
+                               usage_mode);
+  return result;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
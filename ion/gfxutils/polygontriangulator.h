@@ -0,0 +1,113 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef ION_GFXUTILS_POLYGONTRIANGULATOR_H_
+#define ION_GFXUTILS_POLYGONTRIANGULATOR_H_
+
+// This file contains functions that triangulate simple 2D polygons with
+// holes, such as the building footprints and water areas of vector map tiles.
+// They are much faster than the GLU tessellator in ion/external/tess, which
+// allocates several objects per vertex and goes through callbacks for every
+// vertex it emits, but they do not support its winding rules or
+// self-intersecting contours.
+//
+// Polygons are triangulated by ear clipping as in the earcut library: holes
+// are joined to the outer ring with bridge edges, and ears are then clipped
+// off the single resulting ring. Rings with more than 80 vertices are sorted
+// along a Z-order curve so that the vertices that could lie inside a
+// candidate ear are found without walking the whole ring. Degenerate input,
+// such as duplicate vertices or rings that touch themselves, is handled by
+// filtering the ring and then splitting it along valid diagonals, so that a
+// triangulation is produced for most real data. The triangles are always
+// counterclockwise with +Y up, whatever the orientation of the rings.
+
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/allocator.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/indexbuffer.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
+namespace gfxutils {
+
+// This struct describes a polygon to triangulate without owning its data, so
+// that polygons can be triangulated straight from the arrays they are decoded
+// into. The vertices of the outer ring come first, followed by those of each
+// hole. Rings do not repeat their first vertex at the end, and may be in
+// either orientation.
+struct TriangulationPolygon {
+  TriangulationPolygon()
+      : vertices(NULL), vertex_count(0U), hole_starts(NULL), hole_count(0U) {}
+  // The vertices of all rings.
+  const math::Point2f* vertices;
+  size_t vertex_count;
+  // The index in vertices of the first vertex of each hole, in increasing
+  // order.
+  const uint32* hole_starts;
+  size_t hole_count;
+};
+
+// The result of TriangulatePolygons().
+struct TriangulatedPolygons {
+  // The vertices of all polygons in order, as Point2f elements with a single
+  // float spec.
+  gfx::BufferObjectPtr vertex_buffer;
+  // The triangles of all polygons in order, as unsigned short indices if
+  // there are at most 65536 vertices, and unsigned int indices otherwise.
+  gfx::IndexBufferPtr index_buffer;
+  // The range of indices in index_buffer of each polygon, which can be passed
+  // to Shape::AddVertexRange() to draw polygons selectively. A polygon that
+  // could not be triangulated has a range of zero length.
+  std::vector<math::Range1i> index_ranges;
+};
+
+// Returns the largest number of triangles that the triangulation of
+// |polygon| can have, which is the number of vertices plus twice the number
+// of holes minus two. The triangulation of a polygon without degenerate
+// vertices has exactly this many.
+ION_API size_t GetMaxTriangleCount(const TriangulationPolygon& polygon);
+
+// Triangulates |polygon| and appends the indices of its triangles' vertices
+// in polygon.vertices to |indices|. Returns the number of triangles added.
+// Logs an error and adds nothing if the hole starts of the polygon are out of
+// order or out of range.
+ION_API size_t TriangulatePolygon(const TriangulationPolygon& polygon,
+                                  std::vector<uint32>* indices);
+
+// Triangulates all |polygons| and stores their vertices and triangles in new
+// buffers with the passed usage mode, which are allocated with |allocator|.
+// The temporary data of each polygon is allocated from a per-thread arena
+// (see base::ArenaAllocator), and each polygon's triangles are written
+// straight into the IndexBuffer's data, so that the batch needs only a few
+// allocations in total. If |scheduler| is not NULL, the polygons are
+// triangulated in parallel on its threads. Polygons with invalid hole starts
+// are logged and skipped.
+ION_API const TriangulatedPolygons TriangulatePolygons(
+    const std::vector<TriangulationPolygon>& polygons,
+    gfx::BufferObject::UsageMode usage_mode,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler);
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_POLYGONTRIANGULATOR_H_
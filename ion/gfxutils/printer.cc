@@ -549,9 +549,11 @@ static const Tree::Table GetIndexBufferTable(
 class TreeBuilder {
  public:
   TreeBuilder(bool address_printing_enabled,
-              bool full_shape_printing_enabled)
+              bool full_shape_printing_enabled,
+              bool child_printing_enabled)
       : address_printing_enabled_(address_printing_enabled),
-        full_shape_printing_enabled_(full_shape_printing_enabled) {}
+        full_shape_printing_enabled_(full_shape_printing_enabled),
+        child_printing_enabled_(child_printing_enabled) {}
   ~TreeBuilder() {}
 
   const Tree& BuildTree(const Node& node) {
@@ -624,6 +626,7 @@ class TreeBuilder {
   Tree tree_;
   bool address_printing_enabled_;
   bool full_shape_printing_enabled_;
+  bool child_printing_enabled_;
   std::set<const AttributeArray*> added_attribute_arrays_;
 };
 
@@ -646,20 +649,22 @@ void TreeBuilder::AddNode(const Node& node) {
     AddUniform(uniforms[i]);
 
   // Add all uniform blocks.
-  const base::AllocVector<UniformBlockPtr>& uniform_blocks =
+  const gfx::Node::UniformBlockVector& uniform_blocks =
       node.GetUniformBlocks();
   for (size_t i = 0; i < uniform_blocks.size(); ++i)
     AddUniformBlock(uniform_blocks[i].Get());
 
   // Add all shapes.
-  const base::AllocVector<ShapePtr>& shapes = node.GetShapes();
+  const gfx::Node::ShapeVector& shapes = node.GetShapes();
   for (size_t i = 0; i < shapes.size(); ++i)
     AddShape(*shapes[i]);
 
   // Recurse on children.
-  const base::AllocVector<NodePtr>& children = node.GetChildren();
-  for (size_t i = 0; i < children.size(); ++i)
-    AddNode(*children[i]);
+  if (child_printing_enabled_) {
+    const gfx::Node::NodeVector& children = node.GetChildren();
+    for (size_t i = 0; i < children.size(); ++i)
+      AddNode(*children[i]);
+  }
 }
 
 void TreeBuilder::AddStateTable(const StateTable& st) {
@@ -1528,7 +1533,8 @@ void HtmlTreePrinter::PrintTableField(const Tree::TableField& field) {
 Printer::Printer()
     : format_(kText),
       full_shape_printing_enabled_(false),
-      address_printing_enabled_(true) {
+      address_printing_enabled_(true),
+      child_printing_enabled_(true) {
 }
 
 Printer::~Printer() {
@@ -1537,7 +1543,8 @@ Printer::~Printer() {
 
 void Printer::PrintScene(const NodePtr& node, std::ostream& out) {  // NOLINT
   if (node.Get()) {
-    TreeBuilder tb(address_printing_enabled_, full_shape_printing_enabled_);
+    TreeBuilder tb(address_printing_enabled_, full_shape_printing_enabled_,
+                   child_printing_enabled_);
     const Tree tree = tb.BuildTree(*node);
 
     if (format_ == kText) {
@@ -61,6 +61,13 @@ class ION_API Printer {
     return address_printing_enabled_;
   }
 
+  // Sets/returns a flag indicating whether the children of Nodes should be
+  // written. Disabling this prints only the contents of the Node passed to
+  // PrintScene(), which is useful for examining large scenes one Node at a
+  // time. The default is true.
+  void EnableChildPrinting(bool enable) { child_printing_enabled_ = enable; }
+  bool IsChildPrintingEnabled() const { return child_printing_enabled_; }
+
   // Prints the scene graph rooted by the given node.
   void PrintScene(const gfx::NodePtr& node, std::ostream& out);  // NOLINT
 
@@ -68,6 +75,7 @@ class ION_API Printer {
   Format format_;
   bool full_shape_printing_enabled_;
   bool address_printing_enabled_;
+  bool child_printing_enabled_;
 };
 
 }  // namespace gfxutils
@@ -0,0 +1,1639 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/scenefile.h"
+
+#include <algorithm>
+#include <cstring>  // For memcpy().
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/cubemaptexture.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/indexbuffer.h"
+#include "ion/gfx/sampler.h"
+#include "ion/gfx/shader.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/texture.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfx/uniformblock.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+#include "ion/port/memorymappedfile.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// The types of the objects in scene data. Each record in the data starts with
+// the type of the object.
+enum ObjectType {
+  kRegistryObject,
+  kShaderObject,
+  kShaderProgramObject,
+  kImageObject,
+  kSamplerObject,
+  kTextureObject,
+  kCubeMapTextureObject,
+  kBufferObjectObject,
+  kIndexBufferObject,
+  kAttributeArrayObject,
+  kShapeObject,
+  kStateTableObject,
+  kUniformBlockObject,
+  kNodeObject,
+};
+
+// The header of scene data. The header is followed by |records_size| bytes
+// of object records and then, starting at the next multiple of
+// kPayloadAlignment, by |payload_size| bytes of data payloads. Records refer
+// to other objects by their index in the records, and to payloads by their
+// offset from the start of the payloads and their size.
+struct SceneHeader {
+  char magic[4];
+  uint32 version;
+  uint32 object_count;
+  uint32 root;
+  uint64 records_size;
+  uint64 payload_size;
+};
+
+static const char kSceneMagic[4] = { 'I', 'S', 'C', 'N' };
+static const uint32 kSceneVersion = 1U;
+
+// The index written for a NULL object.
+static const uint32 kNoObject = 0xffffffffU;
+
+// Each payload starts at a multiple of this many bytes from the start of the
+// data, so that the data of a mapped file is suitably aligned.
+static const size_t kPayloadAlignment = 16U;
+
+// Returns |size| rounded up to a multiple of kPayloadAlignment.
+static uint64 AlignPayloadSize(uint64 size) {
+  return (size + kPayloadAlignment - 1U) & ~(kPayloadAlignment - 1U);
+}
+
+// Returns the name of |input| with its array index, suitable for passing to
+// ShaderInputRegistry::Create().
+template <typename T>
+static const std::string GetInputName(const T& input) {
+  const std::string& name = gfx::ShaderInputRegistry::GetSpec(input)->name;
+  return input.GetArrayIndex() ?
+      name + "[" + std::to_string(input.GetArrayIndex()) + "]" : name;
+}
+
+//-----------------------------------------------------------------------------
+//
+// SceneWriter writes the records of a scene, adding the objects each object
+// refers to before the object itself.
+//
+//-----------------------------------------------------------------------------
+class SceneWriter {
+ public:
+  SceneWriter() : object_count_(0U), payload_size_(0U), is_valid_(true) {}
+
+  // Writes the scene rooted at |root| to |out|, returning false if it cannot
+  // be saved.
+  bool Write(const gfx::NodePtr& root, std::ostream& out);  // NOLINT
+
+ private:
+  // Each of these adds an object and the objects it refers to, unless it has
+  // already been added, and returns its index, or kNoObject if it is NULL.
+  uint32 AddRegistry(const gfx::ShaderInputRegistry* registry);
+  uint32 AddShader(const gfx::Shader* shader);
+  uint32 AddShaderProgram(const gfx::ShaderProgram* program);
+  uint32 AddImage(const gfx::Image* image);
+  uint32 AddSampler(const gfx::Sampler* sampler);
+  uint32 AddTexture(const gfx::Texture* texture);
+  uint32 AddTexture(const gfx::CubeMapTexture* texture);
+  uint32 AddBufferObject(const gfx::BufferObject* buffer_object);
+  uint32 AddIndexBuffer(const gfx::IndexBuffer* index_buffer);
+  uint32 AddAttributeArray(const gfx::AttributeArray* attribute_array);
+  uint32 AddShape(const gfx::Shape* shape);
+  uint32 AddStateTable(const gfx::StateTable* state_table);
+  uint32 AddUniformBlock(const gfx::UniformBlock* block);
+  uint32 AddNode(const gfx::Node* node);
+
+  // Adds the registry and textures that |uniform| refers to.
+  void AddUniformReferences(const gfx::Uniform& uniform);
+  template <typename T>
+  void AddUniformTextures(const gfx::Uniform& uniform);
+  // Adds the registry and textures used by |holder|.
+  void AddUniformHolderReferences(const gfx::UniformHolder& holder);
+
+  // Returns whether |object| is NULL or has already been added, setting
+  // |index| to its index or kNoObject.
+  bool IsAdded(const void* object, uint32* index) const;
+  // Starts the record of |object| and returns its index.
+  uint32 BeginRecord(ObjectType type, const void* object);
+
+  // Functions that write values to the current record.
+  void WriteBytes(const void* data, size_t size);
+  void WriteUint32(uint32 value) { WriteBytes(&value, sizeof(value)); }
+  void WriteBool(bool value) { WriteUint32(value ? 1U : 0U); }
+  void WriteString(const std::string& s);
+  void WriteIndex(const void* object);
+  template <typename T> void WriteValue(const T& value) {
+    WriteBytes(&value, sizeof(value));
+  }
+  void WriteValue(const gfx::TexturePtr& texture) {
+    WriteIndex(texture.Get());
+  }
+  void WriteValue(const gfx::CubeMapTexturePtr& texture) {
+    WriteIndex(texture.Get());
+  }
+  // Writes the offset and size of a payload of |size| bytes of |data|, which
+  // is written after the records.
+  void WritePayload(const void* data, size_t size);
+  void WriteTextureSettings(const gfx::TextureBase& texture);
+  void WriteUniform(const gfx::Uniform& uniform);
+  template <typename T>
+  void WriteUniformValues(const gfx::Uniform& uniform);
+  void WriteUniforms(const gfx::UniformHolder& holder);
+  void WriteAttribute(const gfx::Attribute& attribute, bool is_enabled);
+
+  std::unordered_map<const void*, uint32> indices_;
+  std::vector<char> records_;
+  // The data and size of each payload.
+  std::vector<std::pair<const void*, size_t> > payloads_;
+  uint32 object_count_;
+  uint64 payload_size_;
+  bool is_valid_;
+};
+
+bool SceneWriter::Write(const gfx::NodePtr& root,
+                        std::ostream& out) {  // NOLINT
+  SceneHeader header;
+  memcpy(header.magic, kSceneMagic, sizeof(kSceneMagic));
+  header.version = kSceneVersion;
+  header.root = AddNode(root.Get());
+  if (!is_valid_)
+    return false;
+  header.object_count = object_count_;
+  header.records_size = records_.size();
+  header.payload_size = payload_size_;
+
+  static const char kPadding[kPayloadAlignment] = { 0 };
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!records_.empty())
+    out.write(&records_[0], records_.size());
+  const uint64 records_end = sizeof(header) + records_.size();
+  out.write(kPadding, AlignPayloadSize(records_end) - records_end);
+  for (size_t i = 0; i < payloads_.size(); ++i) {
+    const size_t size = payloads_[i].second;
+    out.write(static_cast<const char*>(payloads_[i].first), size);
+    out.write(kPadding, AlignPayloadSize(size) - size);
+  }
+  return static_cast<bool>(out);
+}
+
+uint32 SceneWriter::AddRegistry(const gfx::ShaderInputRegistry* registry) {
+  uint32 index;
+  if (IsAdded(registry, &index))
+    return index;
+  const bool is_global =
+      registry == gfx::ShaderInputRegistry::GetGlobalRegistry().Get();
+  const base::AllocVector<gfx::ShaderInputRegistryPtr>& includes =
+      registry->GetIncludes();
+  if (!is_global) {
+    for (size_t i = 0; i < includes.size(); ++i)
+      AddRegistry(includes[i].Get());
+  }
+
+  index = BeginRecord(kRegistryObject, registry);
+  WriteBool(is_global);
+  if (!is_global) {
+    WriteUint32(static_cast<uint32>(includes.size()));
+    for (size_t i = 0; i < includes.size(); ++i)
+      WriteIndex(includes[i].Get());
+    const base::AllocDeque<gfx::ShaderInputRegistry::UniformSpec>&
+        uniform_specs = registry->GetSpecs<gfx::Uniform>();
+    WriteUint32(static_cast<uint32>(uniform_specs.size()));
+    for (size_t i = 0; i < uniform_specs.size(); ++i) {
+      WriteString(uniform_specs[i].name);
+      WriteUint32(uniform_specs[i].value_type);
+      WriteString(uniform_specs[i].doc_string);
+    }
+    const base::AllocDeque<gfx::ShaderInputRegistry::AttributeSpec>&
+        attribute_specs = registry->GetSpecs<gfx::Attribute>();
+    WriteUint32(static_cast<uint32>(attribute_specs.size()));
+    for (size_t i = 0; i < attribute_specs.size(); ++i) {
+      WriteString(attribute_specs[i].name);
+      WriteUint32(attribute_specs[i].value_type);
+      WriteString(attribute_specs[i].doc_string);
+    }
+  }
+  return index;
+}
+
+uint32 SceneWriter::AddShader(const gfx::Shader* shader) {
+  uint32 index;
+  if (IsAdded(shader, &index))
+    return index;
+  index = BeginRecord(kShaderObject, shader);
+  WriteString(shader->GetLabel());
+  WriteString(shader->GetDocString());
+  WriteString(shader->GetSource());
+  return index;
+}
+
+uint32 SceneWriter::AddShaderProgram(const gfx::ShaderProgram* program) {
+  uint32 index;
+  if (IsAdded(program, &index))
+    return index;
+  AddRegistry(program->GetRegistry().Get());
+  AddShader(program->GetVertexShader().Get());
+  AddShader(program->GetFragmentShader().Get());
+
+  index = BeginRecord(kShaderProgramObject, program);
+  WriteString(program->GetLabel());
+  WriteString(program->GetDocString());
+  WriteIndex(program->GetRegistry().Get());
+  WriteIndex(program->GetVertexShader().Get());
+  WriteIndex(program->GetFragmentShader().Get());
+  WriteBool(program->IsConcurrent());
+  return index;
+}
+
+uint32 SceneWriter::AddImage(const gfx::Image* image) {
+  uint32 index;
+  if (IsAdded(image, &index))
+    return index;
+  if (image->GetType() != gfx::Image::kArray &&
+      image->GetType() != gfx::Image::kDense) {
+    LOG(ERROR) << "EGL images cannot be saved.";
+    is_valid_ = false;
+  }
+  const base::DataContainerPtr& data = image->GetData();
+  index = BeginRecord(kImageObject, image);
+  WriteUint32(image->GetType());
+  WriteUint32(image->GetDimensions());
+  WriteUint32(image->GetFormat());
+  WriteUint32(image->GetWidth());
+  WriteUint32(image->GetHeight());
+  WriteUint32(image->GetDepth());
+  WritePayload(data.Get() ? data->GetData() : NULL, image->GetDataSize());
+  return index;
+}
+
+uint32 SceneWriter::AddSampler(const gfx::Sampler* sampler) {
+  uint32 index;
+  if (IsAdded(sampler, &index))
+    return index;
+  index = BeginRecord(kSamplerObject, sampler);
+  WriteString(sampler->GetLabel());
+  WriteBool(sampler->IsAutogenerateMipmapsEnabled());
+  WriteUint32(sampler->GetCompareMode());
+  WriteUint32(sampler->GetCompareFunction());
+  WriteValue(sampler->GetMaxAnisotropy());
+  WriteUint32(sampler->GetMinFilter());
+  WriteUint32(sampler->GetMagFilter());
+  WriteValue(sampler->GetMinLod());
+  WriteValue(sampler->GetMaxLod());
+  WriteUint32(sampler->GetWrapR());
+  WriteUint32(sampler->GetWrapS());
+  WriteUint32(sampler->GetWrapT());
+  return index;
+}
+
+uint32 SceneWriter::AddTexture(const gfx::Texture* texture) {
+  uint32 index;
+  if (IsAdded(texture, &index))
+    return index;
+  AddSampler(texture->GetSampler().Get());
+  AddImage(texture->GetImmutableImage().Get());
+  for (size_t i = 0; i < gfx::kMipmapSlotCount; ++i)
+    AddImage(texture->GetImage(i).Get());
+
+  index = BeginRecord(kTextureObject, texture);
+  WriteTextureSettings(*texture);
+  for (size_t i = 0; i < gfx::kMipmapSlotCount; ++i)
+    WriteIndex(texture->GetImage(i).Get());
+  return index;
+}
+
+uint32 SceneWriter::AddTexture(const gfx::CubeMapTexture* texture) {
+  uint32 index;
+  if (IsAdded(texture, &index))
+    return index;
+  AddSampler(texture->GetSampler().Get());
+  AddImage(texture->GetImmutableImage().Get());
+  for (int face = 0; face < 6; ++face) {
+    for (size_t i = 0; i < gfx::kMipmapSlotCount; ++i) {
+      AddImage(texture->GetImage(
+          static_cast<gfx::CubeMapTexture::CubeFace>(face), i).Get());
+    }
+  }
+
+  index = BeginRecord(kCubeMapTextureObject, texture);
+  WriteTextureSettings(*texture);
+  for (int face = 0; face < 6; ++face) {
+    for (size_t i = 0; i < gfx::kMipmapSlotCount; ++i) {
+      WriteIndex(texture->GetImage(
+          static_cast<gfx::CubeMapTexture::CubeFace>(face), i).Get());
+    }
+  }
+  return index;
+}
+
+uint32 SceneWriter::AddBufferObject(const gfx::BufferObject* buffer_object) {
+  uint32 index;
+  if (IsAdded(buffer_object, &index))
+    return index;
+  const ObjectType type =
+      buffer_object->GetTarget() == gfx::BufferObject::kElementBuffer ?
+      kIndexBufferObject : kBufferObjectObject;
+  const base::DataContainerPtr& data = buffer_object->GetData();
+  index = BeginRecord(type, buffer_object);
+  WriteString(buffer_object->GetLabel());
+  const size_t spec_count = buffer_object->GetSpecCount();
+  WriteUint32(static_cast<uint32>(spec_count));
+  for (size_t i = 0; i < spec_count; ++i) {
+    const gfx::BufferObject::Spec& spec = buffer_object->GetSpec(i);
+    WriteUint32(spec.type);
+    WriteUint32(static_cast<uint32>(spec.component_count));
+    WriteUint32(static_cast<uint32>(spec.byte_offset));
+  }
+  WriteUint32(static_cast<uint32>(buffer_object->GetStructSize()));
+  WriteUint32(static_cast<uint32>(buffer_object->GetCount()));
+  WriteUint32(buffer_object->GetUsageMode());
+  WritePayload(data.Get() ? data->GetData() : NULL,
+               buffer_object->GetStructSize() * buffer_object->GetCount());
+  return index;
+}
+
+uint32 SceneWriter::AddIndexBuffer(const gfx::IndexBuffer* index_buffer) {
+  return AddBufferObject(index_buffer);
+}
+
+uint32 SceneWriter::AddAttributeArray(
+    const gfx::AttributeArray* attribute_array) {
+  uint32 index;
+  if (IsAdded(attribute_array, &index))
+    return index;
+  const size_t count = attribute_array->GetAttributeCount();
+  for (size_t i = 0; i < count; ++i) {
+    const gfx::Attribute& attribute = attribute_array->GetAttribute(i);
+    AddRegistry(&attribute.GetRegistry());
+    if (attribute.GetType() == gfx::kBufferObjectElementAttribute) {
+      AddBufferObject(attribute.GetValue<gfx::BufferObjectElement>()
+                      .buffer_object.Get());
+    }
+  }
+
+  index = BeginRecord(kAttributeArrayObject, attribute_array);
+  WriteUint32(static_cast<uint32>(count));
+  for (size_t i = 0; i < count; ++i) {
+    WriteAttribute(attribute_array->GetAttribute(i),
+                   attribute_array->IsAttributeEnabled(i));
+  }
+  return index;
+}
+
+uint32 SceneWriter::AddShape(const gfx::Shape* shape) {
+  uint32 index;
+  if (IsAdded(shape, &index))
+    return index;
+  AddAttributeArray(shape->GetAttributeArray().Get());
+  AddIndexBuffer(shape->GetIndexBuffer().Get());
+
+  index = BeginRecord(kShapeObject, shape);
+  WriteString(shape->GetLabel());
+  WriteUint32(shape->GetPrimitiveType());
+  WriteIndex(shape->GetAttributeArray().Get());
+  WriteIndex(shape->GetIndexBuffer().Get());
+  WriteValue(static_cast<int32>(shape->GetInstanceCount()));
+  const size_t range_count = shape->GetVertexRangeCount();
+  WriteUint32(static_cast<uint32>(range_count));
+  for (size_t i = 0; i < range_count; ++i) {
+    WriteValue(shape->GetVertexRange(i));
+    WriteBool(shape->IsVertexRangeEnabled(i));
+    WriteValue(static_cast<int32>(shape->GetVertexRangeInstanceCount(i)));
+  }
+  return index;
+}
+
+uint32 SceneWriter::AddStateTable(const gfx::StateTable* state_table) {
+  typedef gfx::StateTable ST;
+  uint32 index;
+  if (IsAdded(state_table, &index))
+    return index;
+  index = BeginRecord(kStateTableObject, state_table);
+  WriteBool(state_table->AreSettingsEnforced());
+  for (int i = 0; i < ST::GetCapabilityCount(); ++i) {
+    const ST::Capability cap = static_cast<ST::Capability>(i);
+    WriteBool(state_table->IsCapabilitySet(cap));
+    WriteBool(state_table->IsEnabled(cap));
+  }
+  // Each set value is written as its Value followed by its settings, and the
+  // values end with kNumValues.
+  for (int i = 0; i < ST::GetValueCount(); ++i) {
+    const ST::Value value = static_cast<ST::Value>(i);
+    if (!state_table->IsValueSet(value))
+      continue;
+    WriteUint32(value);
+    switch (value) {
+      case ST::kBlendColorValue:
+        WriteValue(state_table->GetBlendColor());
+        break;
+      case ST::kBlendEquationsValue:
+        WriteUint32(state_table->GetRgbBlendEquation());
+        WriteUint32(state_table->GetAlphaBlendEquation());
+        break;
+      case ST::kBlendFunctionsValue:
+        WriteUint32(state_table->GetRgbBlendFunctionSourceFactor());
+        WriteUint32(state_table->GetRgbBlendFunctionDestinationFactor());
+        WriteUint32(state_table->GetAlphaBlendFunctionSourceFactor());
+        WriteUint32(state_table->GetAlphaBlendFunctionDestinationFactor());
+        break;
+      case ST::kClearColorValue:
+        WriteValue(state_table->GetClearColor());
+        break;
+      case ST::kClearDepthValue:
+        WriteValue(state_table->GetClearDepthValue());
+        break;
+      case ST::kClearStencilValue:
+        WriteValue(static_cast<int32>(state_table->GetClearStencilValue()));
+        break;
+      case ST::kColorWriteMasksValue:
+        WriteBool(state_table->GetRedColorWriteMask());
+        WriteBool(state_table->GetGreenColorWriteMask());
+        WriteBool(state_table->GetBlueColorWriteMask());
+        WriteBool(state_table->GetAlphaColorWriteMask());
+        break;
+      case ST::kCullFaceModeValue:
+        WriteUint32(state_table->GetCullFaceMode());
+        break;
+      case ST::kFrontFaceModeValue:
+        WriteUint32(state_table->GetFrontFaceMode());
+        break;
+      case ST::kDepthFunctionValue:
+        WriteUint32(state_table->GetDepthFunction());
+        break;
+      case ST::kDepthRangeValue:
+        WriteValue(state_table->GetDepthRange());
+        break;
+      case ST::kDepthWriteMaskValue:
+        WriteBool(state_table->GetDepthWriteMask());
+        break;
+      case ST::kDrawBufferValue:
+        WriteUint32(state_table->GetDrawBuffer());
+        break;
+      case ST::kHintsValue:
+        WriteUint32(state_table->GetHint(ST::kGenerateMipmapHint));
+        break;
+      case ST::kLineWidthValue:
+        WriteValue(state_table->GetLineWidth());
+        break;
+      case ST::kPolygonOffsetValue:
+        WriteValue(state_table->GetPolygonOffsetFactor());
+        WriteValue(state_table->GetPolygonOffsetUnits());
+        break;
+      case ST::kSampleCoverageValue:
+        WriteValue(state_table->GetSampleCoverageValue());
+        WriteBool(state_table->IsSampleCoverageInverted());
+        break;
+      case ST::kScissorBoxValue:
+        WriteValue(state_table->GetScissorBox());
+        break;
+      case ST::kStencilFunctionsValue:
+        WriteUint32(state_table->GetFrontStencilFunction());
+        WriteValue(
+            static_cast<int32>(state_table->GetFrontStencilReferenceValue()));
+        WriteUint32(state_table->GetFrontStencilMask());
+        WriteUint32(state_table->GetBackStencilFunction());
+        WriteValue(
+            static_cast<int32>(state_table->GetBackStencilReferenceValue()));
+        WriteUint32(state_table->GetBackStencilMask());
+        break;
+      case ST::kStencilOperationsValue:
+        WriteUint32(state_table->GetFrontStencilFailOperation());
+        WriteUint32(state_table->GetFrontStencilDepthFailOperation());
+        WriteUint32(state_table->GetFrontStencilPassOperation());
+        WriteUint32(state_table->GetBackStencilFailOperation());
+        WriteUint32(state_table->GetBackStencilDepthFailOperation());
+        WriteUint32(state_table->GetBackStencilPassOperation());
+        break;
+      case ST::kStencilWriteMasksValue:
+        WriteUint32(state_table->GetFrontStencilWriteMask());
+        WriteUint32(state_table->GetBackStencilWriteMask());
+        break;
+      case ST::kViewportValue:
+        WriteValue(state_table->GetViewport());
+        break;
+      default:
+        break;
+    }
+  }
+  WriteUint32(ST::kNumValues);
+  return index;
+}
+
+uint32 SceneWriter::AddUniformBlock(const gfx::UniformBlock* block) {
+  uint32 index;
+  if (IsAdded(block, &index))
+    return index;
+  AddUniformHolderReferences(*block);
+
+  index = BeginRecord(kUniformBlockObject, block);
+  WriteString(block->GetLabel());
+  WriteString(block->GetBlockName());
+  WriteBool(block->IsEnabled());
+  WriteUniforms(*block);
+  return index;
+}
+
+uint32 SceneWriter::AddNode(const gfx::Node* node) {
+  uint32 index;
+  if (IsAdded(node, &index))
+    return index;
+  const gfx::Node::UniformBlockVector& blocks = node->GetUniformBlocks();
+  const gfx::Node::ShapeVector& shapes = node->GetShapes();
+  const gfx::Node::NodeVector& children = node->GetChildren();
+  AddStateTable(node->GetStateTable().Get());
+  AddShaderProgram(node->GetShaderProgram().Get());
+  AddUniformHolderReferences(*node);
+  for (size_t i = 0; i < blocks.size(); ++i)
+    AddUniformBlock(blocks[i].Get());
+  for (size_t i = 0; i < shapes.size(); ++i)
+    AddShape(shapes[i].Get());
+  for (size_t i = 0; i < children.size(); ++i)
+    AddNode(children[i].Get());
+
+  index = BeginRecord(kNodeObject, node);
+  WriteString(node->GetLabel());
+  WriteBool(node->IsEnabled());
+  WriteIndex(node->GetStateTable().Get());
+  WriteIndex(node->GetShaderProgram().Get());
+  WriteUniforms(*node);
+  WriteUint32(static_cast<uint32>(blocks.size()));
+  for (size_t i = 0; i < blocks.size(); ++i)
+    WriteIndex(blocks[i].Get());
+  WriteUint32(static_cast<uint32>(shapes.size()));
+  for (size_t i = 0; i < shapes.size(); ++i)
+    WriteIndex(shapes[i].Get());
+  WriteUint32(static_cast<uint32>(children.size()));
+  for (size_t i = 0; i < children.size(); ++i)
+    WriteIndex(children[i].Get());
+  WriteBool(node->HasBounds());
+  WriteValue(node->GetBounds());
+  WriteBool(node->HasLodRange());
+  WriteValue(node->GetLodRange());
+  WriteBool(node->IsDrawOrderPreserved());
+  return index;
+}
+
+void SceneWriter::AddUniformReferences(const gfx::Uniform& uniform) {
+  AddRegistry(&uniform.GetRegistry());
+  if (uniform.GetType() == gfx::kTextureUniform)
+    AddUniformTextures<gfx::TexturePtr>(uniform);
+  else if (uniform.GetType() == gfx::kCubeMapTextureUniform)
+    AddUniformTextures<gfx::CubeMapTexturePtr>(uniform);
+}
+
+template <typename T>
+void SceneWriter::AddUniformTextures(const gfx::Uniform& uniform) {
+  const size_t count = uniform.GetCount();
+  if (!count) {
+    AddTexture(uniform.GetValue<T>().Get());
+  } else {
+    for (size_t i = 0; i < count; ++i)
+      AddTexture(uniform.GetValueAt<T>(i).Get());
+  }
+}
+
+void SceneWriter::AddUniformHolderReferences(
+    const gfx::UniformHolder& holder) {
+  const base::AllocVector<gfx::Uniform>& uniforms = holder.GetUniforms();
+  for (size_t i = 0; i < uniforms.size(); ++i)
+    AddUniformReferences(uniforms[i]);
+}
+
+bool SceneWriter::IsAdded(const void* object, uint32* index) const {
+  if (!object) {
+    *index = kNoObject;
+    return true;
+  }
+  const std::unordered_map<const void*, uint32>::const_iterator it =
+      indices_.find(object);
+  if (it == indices_.end())
+    return false;
+  *index = it->second;
+  return true;
+}
+
+uint32 SceneWriter::BeginRecord(ObjectType type, const void* object) {
+  const uint32 index = object_count_++;
+  indices_[object] = index;
+  WriteUint32(type);
+  return index;
+}
+
+void SceneWriter::WriteBytes(const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  records_.insert(records_.end(), bytes, bytes + size);
+}
+
+void SceneWriter::WriteString(const std::string& s) {
+  WriteUint32(static_cast<uint32>(s.size()));
+  WriteBytes(s.data(), s.size());
+}
+
+void SceneWriter::WriteIndex(const void* object) {
+  uint32 index;
+  if (!IsAdded(object, &index)) {
+    DCHECK(false) << "Object written before it was added";
+    is_valid_ = false;
+  }
+  WriteUint32(index);
+}
+
+void SceneWriter::WritePayload(const void* data, size_t size) {
+  if (size && !data) {
+    LOG(ERROR) << "Scene data is missing or has been wiped.";
+    is_valid_ = false;
+  }
+  const uint64 offset = payload_size_;
+  WriteValue(offset);
+  WriteValue(static_cast<uint64>(size));
+  payloads_.push_back(std::make_pair(data, size));
+  payload_size_ += AlignPayloadSize(size);
+}
+
+void SceneWriter::WriteTextureSettings(const gfx::TextureBase& texture) {
+  WriteString(texture.GetLabel());
+  WriteIndex(texture.GetSampler().Get());
+  WriteValue(static_cast<int32>(texture.GetBaseLevel()));
+  WriteValue(static_cast<int32>(texture.GetMaxLevel()));
+  WriteUint32(texture.GetSwizzleRed());
+  WriteUint32(texture.GetSwizzleGreen());
+  WriteUint32(texture.GetSwizzleBlue());
+  WriteUint32(texture.GetSwizzleAlpha());
+  WriteValue(static_cast<int32>(texture.GetMultisampleSamples()));
+  WriteBool(texture.IsMultisampleFixedSampleLocations());
+  WriteBool(texture.IsPixelBufferStreamingEnabled());
+  WriteIndex(texture.GetImmutableImage().Get());
+  WriteUint32(static_cast<uint32>(texture.GetImmutableLevels()));
+}
+
+void SceneWriter::WriteUniform(const gfx::Uniform& uniform) {
+  WriteIndex(&uniform.GetRegistry());
+  WriteString(GetInputName(uniform));
+  WriteUint32(uniform.GetType());
+  WriteUint32(static_cast<uint32>(uniform.GetCount()));
+  switch (uniform.GetType()) {
+    case gfx::kFloatUniform:
+      WriteUniformValues<float>(uniform);
+      break;
+    case gfx::kIntUniform:
+      WriteUniformValues<int>(uniform);
+      break;
+    case gfx::kUnsignedIntUniform:
+      WriteUniformValues<uint32>(uniform);
+      break;
+    case gfx::kCubeMapTextureUniform:
+      WriteUniformValues<gfx::CubeMapTexturePtr>(uniform);
+      break;
+    case gfx::kTextureUniform:
+      WriteUniformValues<gfx::TexturePtr>(uniform);
+      break;
+    case gfx::kFloatVector2Uniform:
+      WriteUniformValues<math::VectorBase2f>(uniform);
+      break;
+    case gfx::kFloatVector3Uniform:
+      WriteUniformValues<math::VectorBase3f>(uniform);
+      break;
+    case gfx::kFloatVector4Uniform:
+      WriteUniformValues<math::VectorBase4f>(uniform);
+      break;
+    case gfx::kIntVector2Uniform:
+      WriteUniformValues<math::VectorBase2i>(uniform);
+      break;
+    case gfx::kIntVector3Uniform:
+      WriteUniformValues<math::VectorBase3i>(uniform);
+      break;
+    case gfx::kIntVector4Uniform:
+      WriteUniformValues<math::VectorBase4i>(uniform);
+      break;
+    case gfx::kUnsignedIntVector2Uniform:
+      WriteUniformValues<math::VectorBase2ui>(uniform);
+      break;
+    case gfx::kUnsignedIntVector3Uniform:
+      WriteUniformValues<math::VectorBase3ui>(uniform);
+      break;
+    case gfx::kUnsignedIntVector4Uniform:
+      WriteUniformValues<math::VectorBase4ui>(uniform);
+      break;
+    case gfx::kMatrix2x2Uniform:
+      WriteUniformValues<math::Matrix2f>(uniform);
+      break;
+    case gfx::kMatrix3x3Uniform:
+      WriteUniformValues<math::Matrix3f>(uniform);
+      break;
+    case gfx::kMatrix4x4Uniform:
+      WriteUniformValues<math::Matrix4f>(uniform);
+      break;
+    default:
+      break;
+  }
+}
+
+template <typename T>
+void SceneWriter::WriteUniformValues(const gfx::Uniform& uniform) {
+  const size_t count = uniform.GetCount();
+  if (!count) {
+    WriteValue(uniform.GetValue<T>());
+  } else {
+    for (size_t i = 0; i < count; ++i)
+      WriteValue(uniform.GetValueAt<T>(i));
+  }
+}
+
+void SceneWriter::WriteUniforms(const gfx::UniformHolder& holder) {
+  const base::AllocVector<gfx::Uniform>& uniforms = holder.GetUniforms();
+  WriteUint32(static_cast<uint32>(uniforms.size()));
+  for (size_t i = 0; i < uniforms.size(); ++i)
+    WriteUniform(uniforms[i]);
+}
+
+void SceneWriter::WriteAttribute(const gfx::Attribute& attribute,
+                                 bool is_enabled) {
+  WriteIndex(&attribute.GetRegistry());
+  WriteString(GetInputName(attribute));
+  WriteUint32(attribute.GetType());
+  WriteBool(is_enabled);
+  WriteBool(attribute.IsFixedPointNormalized());
+  WriteUint32(attribute.GetDivisor());
+  switch (attribute.GetType()) {
+    case gfx::kFloatAttribute:
+      WriteValue(attribute.GetValue<float>());
+      break;
+    case gfx::kFloatVector2Attribute:
+      WriteValue(attribute.GetValue<math::VectorBase2f>());
+      break;
+    case gfx::kFloatVector3Attribute:
+      WriteValue(attribute.GetValue<math::VectorBase3f>());
+      break;
+    case gfx::kFloatVector4Attribute:
+      WriteValue(attribute.GetValue<math::VectorBase4f>());
+      break;
+    case gfx::kFloatMatrix2x2Attribute:
+      WriteValue(attribute.GetValue<math::Matrix2f>());
+      break;
+    case gfx::kFloatMatrix3x3Attribute:
+      WriteValue(attribute.GetValue<math::Matrix3f>());
+      break;
+    case gfx::kFloatMatrix4x4Attribute:
+      WriteValue(attribute.GetValue<math::Matrix4f>());
+      break;
+    case gfx::kBufferObjectElementAttribute: {
+      const gfx::BufferObjectElement& element =
+          attribute.GetValue<gfx::BufferObjectElement>();
+      WriteIndex(element.buffer_object.Get());
+      WriteUint32(static_cast<uint32>(element.spec_index));
+      break;
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//
+// SceneReader recreates the objects in scene data in the order of their
+// records, calling a function to create the DataContainers for payloads.
+//
+//-----------------------------------------------------------------------------
+class SceneReader {
+ public:
+  // Returns a DataContainer for |length| bytes at |offset| in the data.
+  typedef std::function<base::DataContainerPtr(size_t offset, size_t length)>
+      ContainerFunction;
+
+  SceneReader(const void* data, size_t size, const SceneLoadSpec& spec,
+              const ContainerFunction& create_container)
+      : data_(static_cast<const char*>(data)),
+        size_(size),
+        allocator_(spec.allocator),
+        create_container_(create_container),
+        position_(0U),
+        records_end_(0U),
+        payload_start_(0U),
+        payload_size_(0U),
+        is_valid_(true) {}
+
+  // Returns the root Node of the scene, or a NULL Node if the data is not
+  // valid.
+  const gfx::NodePtr Read();
+
+ private:
+  // An object that has been read, and the type of its record.
+  struct Object {
+    ObjectType type;
+    base::ReferentPtr<base::Referent>::Type object;
+  };
+
+  // Each of these reads the rest of a record of the corresponding type and
+  // returns the new object.
+  const base::ReferentPtr<base::Referent>::Type ReadRecord(ObjectType type);
+  const gfx::ShaderInputRegistryPtr ReadRegistry();
+  const gfx::ShaderPtr ReadShader();
+  const gfx::ShaderProgramPtr ReadShaderProgram();
+  const gfx::ImagePtr ReadImage();
+  const gfx::SamplerPtr ReadSampler();
+  const gfx::TexturePtr ReadTexture();
+  const gfx::CubeMapTexturePtr ReadCubeMapTexture();
+  void ReadBufferData(gfx::BufferObject* buffer_object);
+  const gfx::AttributeArrayPtr ReadAttributeArray();
+  const gfx::ShapePtr ReadShape();
+  const gfx::StateTablePtr ReadStateTable();
+  const gfx::UniformBlockPtr ReadUniformBlock();
+  const gfx::NodePtr ReadNode();
+
+  // Reads the settings written by SceneWriter::WriteTextureSettings().
+  void ReadTextureSettings(gfx::TextureBase* texture);
+  // Reads a Uniform, or its values, and adds it to |holder|.
+  void ReadUniforms(gfx::UniformHolder* holder);
+  const gfx::Uniform ReadUniform();
+  template <typename T>
+  const gfx::Uniform ReadUniformValues(
+      const gfx::ShaderInputRegistryPtr& registry, const std::string& name,
+      size_t count);
+  template <typename T>
+  const gfx::Attribute ReadAttributeValue(
+      const gfx::ShaderInputRegistryPtr& registry, const std::string& name);
+
+  // Functions that read values from the current record. If the record is too
+  // short, these mark the data as invalid and return zero values.
+  void ReadBytes(void* data, size_t size);
+  uint32 ReadUint32() { return ReadValue<uint32>(); }
+  bool ReadBool() { return ReadUint32() != 0U; }
+  int ReadInt() { return ReadValue<int32>(); }
+  const std::string ReadString();
+  template <typename T> const T ReadValue() {
+    T value;
+    ReadBytes(&value, sizeof(value));
+    return value;
+  }
+  // Reads a count of items that each take at least |item_size| bytes, marking
+  // the data as invalid if the rest of the records cannot hold them.
+  size_t ReadCount(size_t item_size);
+  // Reads the index of an object of |type| and sets |ptr| to it. An invalid
+  // index or an object of a different type marks the data as invalid.
+  template <typename T>
+  void ReadRef(ObjectType type, base::SharedPtr<T>* ptr);
+  void ReadValue(gfx::TexturePtr* texture) {
+    ReadRef(kTextureObject, texture);
+  }
+  void ReadValue(gfx::CubeMapTexturePtr* texture) {
+    ReadRef(kCubeMapTextureObject, texture);
+  }
+  template <typename T> void ReadValue(T* value) { *value = ReadValue<T>(); }
+  // Reads the offset and size of a payload and returns a DataContainer for
+  // it, setting |size| to its size.
+  const base::DataContainerPtr ReadPayload(size_t* size);
+
+  const char* data_;
+  const size_t size_;
+  const base::AllocatorPtr allocator_;
+  const ContainerFunction create_container_;
+  std::vector<Object> objects_;
+  size_t position_;
+  size_t records_end_;
+  size_t payload_start_;
+  uint64 payload_size_;
+  bool is_valid_;
+};
+
+const gfx::NodePtr SceneReader::Read() {
+  SceneHeader header;
+  if (size_ < sizeof(header)) {
+    LOG(ERROR) << "Scene data is too short.";
+    return gfx::NodePtr();
+  }
+  memcpy(&header, data_, sizeof(header));
+  const uint64 records_end = sizeof(header) + header.records_size;
+  if (memcmp(header.magic, kSceneMagic, sizeof(kSceneMagic)) != 0 ||
+      header.version != kSceneVersion || header.root >= header.object_count ||
+      header.records_size > size_ ||
+      AlignPayloadSize(records_end) + header.payload_size > size_) {
+    LOG(ERROR) << "Invalid scene header.";
+    return gfx::NodePtr();
+  }
+  position_ = sizeof(header);
+  records_end_ = static_cast<size_t>(records_end);
+  payload_start_ = static_cast<size_t>(AlignPayloadSize(records_end));
+  payload_size_ = header.payload_size;
+
+  // Each record holds at least its type.
+  objects_.reserve(
+      std::min<size_t>(header.object_count, header.records_size / 4U));
+  for (uint32 i = 0; i < header.object_count && is_valid_; ++i) {
+    Object object;
+    object.type = static_cast<ObjectType>(ReadUint32());
+    object.object = ReadRecord(object.type);
+    if (!object.object.Get())
+      is_valid_ = false;
+    objects_.push_back(object);
+  }
+  gfx::NodePtr root;
+  if (is_valid_) {
+    if (objects_[header.root].type == kNodeObject)
+      root.Reset(static_cast<gfx::Node*>(objects_[header.root].object.Get()));
+    else
+      is_valid_ = false;
+  }
+  if (!is_valid_) {
+    LOG(ERROR) << "Invalid scene data.";
+    return gfx::NodePtr();
+  }
+  return root;
+}
+
+const base::ReferentPtr<base::Referent>::Type SceneReader::ReadRecord(
+    ObjectType type) {
+  switch (type) {
+    case kRegistryObject:
+      return ReadRegistry();
+    case kShaderObject:
+      return ReadShader();
+    case kShaderProgramObject:
+      return ReadShaderProgram();
+    case kImageObject:
+      return ReadImage();
+    case kSamplerObject:
+      return ReadSampler();
+    case kTextureObject:
+      return ReadTexture();
+    case kCubeMapTextureObject:
+      return ReadCubeMapTexture();
+    case kBufferObjectObject: {
+      gfx::BufferObjectPtr buffer_object(new(allocator_) gfx::BufferObject);
+      ReadBufferData(buffer_object.Get());
+      return buffer_object;
+    }
+    case kIndexBufferObject: {
+      gfx::IndexBufferPtr index_buffer(new(allocator_) gfx::IndexBuffer);
+      ReadBufferData(index_buffer.Get());
+      return index_buffer;
+    }
+    case kAttributeArrayObject:
+      return ReadAttributeArray();
+    case kShapeObject:
+      return ReadShape();
+    case kStateTableObject:
+      return ReadStateTable();
+    case kUniformBlockObject:
+      return ReadUniformBlock();
+    case kNodeObject:
+      return ReadNode();
+  }
+  return base::ReferentPtr<base::Referent>::Type();
+}
+
+const gfx::ShaderInputRegistryPtr SceneReader::ReadRegistry() {
+  if (ReadBool())
+    return gfx::ShaderInputRegistry::GetGlobalRegistry();
+  gfx::ShaderInputRegistryPtr registry(
+      new(allocator_) gfx::ShaderInputRegistry);
+  const size_t include_count = ReadCount(sizeof(uint32));
+  for (size_t i = 0; i < include_count; ++i) {
+    gfx::ShaderInputRegistryPtr include;
+    ReadRef(kRegistryObject, &include);
+    if (include.Get())
+      registry->Include(include);
+  }
+  const size_t uniform_count = ReadCount(3U * sizeof(uint32));
+  for (size_t i = 0; i < uniform_count; ++i) {
+    const std::string name = ReadString();
+    const gfx::UniformType type = static_cast<gfx::UniformType>(ReadUint32());
+    registry->Add(gfx::ShaderInputRegistry::UniformSpec(name, type,
+                                                        ReadString()));
+  }
+  const size_t attribute_count = ReadCount(3U * sizeof(uint32));
+  for (size_t i = 0; i < attribute_count; ++i) {
+    const std::string name = ReadString();
+    const gfx::AttributeType type =
+        static_cast<gfx::AttributeType>(ReadUint32());
+    registry->Add(gfx::ShaderInputRegistry::AttributeSpec(name, type,
+                                                          ReadString()));
+  }
+  return registry;
+}
+
+const gfx::ShaderPtr SceneReader::ReadShader() {
+  gfx::ShaderPtr shader(new(allocator_) gfx::Shader);
+  shader->SetLabel(ReadString());
+  shader->SetDocString(ReadString());
+  shader->SetSource(ReadString());
+  return shader;
+}
+
+const gfx::ShaderProgramPtr SceneReader::ReadShaderProgram() {
+  const std::string label = ReadString();
+  const std::string doc_string = ReadString();
+  gfx::ShaderInputRegistryPtr registry;
+  ReadRef(kRegistryObject, &registry);
+  gfx::ShaderPtr vertex_shader;
+  ReadRef(kShaderObject, &vertex_shader);
+  gfx::ShaderPtr fragment_shader;
+  ReadRef(kShaderObject, &fragment_shader);
+  const bool is_concurrent = ReadBool();
+  if (!registry.Get())
+    return gfx::ShaderProgramPtr();
+  gfx::ShaderProgramPtr program(new(allocator_) gfx::ShaderProgram(registry));
+  program->SetLabel(label);
+  program->SetDocString(doc_string);
+  program->SetVertexShader(vertex_shader);
+  program->SetFragmentShader(fragment_shader);
+  program->SetConcurrent(is_concurrent);
+  return program;
+}
+
+const gfx::ImagePtr SceneReader::ReadImage() {
+  const gfx::Image::Type type = static_cast<gfx::Image::Type>(ReadUint32());
+  const gfx::Image::Dimensions dims =
+      static_cast<gfx::Image::Dimensions>(ReadUint32());
+  const gfx::Image::Format format =
+      static_cast<gfx::Image::Format>(ReadUint32());
+  const uint32 width = ReadUint32();
+  const uint32 height = ReadUint32();
+  const uint32 depth = ReadUint32();
+  size_t size;
+  const base::DataContainerPtr data = ReadPayload(&size);
+  if (!is_valid_ || format >= gfx::Image::kNumFormats ||
+      (type != gfx::Image::kArray && type != gfx::Image::kDense))
+    return gfx::ImagePtr();
+
+  gfx::ImagePtr image(new(allocator_) gfx::Image);
+  if (type == gfx::Image::kDense) {
+    if (dims == gfx::Image::k2d)
+      image->Set(format, width, height, data);
+    else
+      image->Set(format, width, height, depth, data);
+  } else {
+    if (dims == gfx::Image::k2d)
+      image->SetArray(format, width, height, data);
+    else
+      image->SetArray(format, width, height, depth, data);
+  }
+  if (image->GetDataSize() != size)
+    return gfx::ImagePtr();
+  return image;
+}
+
+const gfx::SamplerPtr SceneReader::ReadSampler() {
+  typedef gfx::Sampler S;
+  gfx::SamplerPtr sampler(new(allocator_) gfx::Sampler);
+  sampler->SetLabel(ReadString());
+  sampler->SetAutogenerateMipmapsEnabled(ReadBool());
+  sampler->SetCompareMode(static_cast<S::CompareMode>(ReadUint32()));
+  sampler->SetCompareFunction(static_cast<S::CompareFunction>(ReadUint32()));
+  sampler->SetMaxAnisotropy(ReadValue<float>());
+  sampler->SetMinFilter(static_cast<S::FilterMode>(ReadUint32()));
+  sampler->SetMagFilter(static_cast<S::FilterMode>(ReadUint32()));
+  sampler->SetMinLod(ReadValue<float>());
+  sampler->SetMaxLod(ReadValue<float>());
+  sampler->SetWrapR(static_cast<S::WrapMode>(ReadUint32()));
+  sampler->SetWrapS(static_cast<S::WrapMode>(ReadUint32()));
+  sampler->SetWrapT(static_cast<S::WrapMode>(ReadUint32()));
+  return sampler;
+}
+
+const gfx::TexturePtr SceneReader::ReadTexture() {
+  gfx::TexturePtr texture(new(allocator_) gfx::Texture);
+  ReadTextureSettings(texture.Get());
+  for (size_t i = 0; i < gfx::kMipmapSlotCount; ++i) {
+    gfx::ImagePtr image;
+    ReadRef(kImageObject, &image);
+    if (image.Get())
+      texture->SetImage(i, image);
+  }
+  return texture;
+}
+
+const gfx::CubeMapTexturePtr SceneReader::ReadCubeMapTexture() {
+  gfx::CubeMapTexturePtr texture(new(allocator_) gfx::CubeMapTexture);
+  ReadTextureSettings(texture.Get());
+  for (int face = 0; face < 6; ++face) {
+    for (size_t i = 0; i < gfx::kMipmapSlotCount; ++i) {
+      gfx::ImagePtr image;
+      ReadRef(kImageObject, &image);
+      if (image.Get()) {
+        texture->SetImage(static_cast<gfx::CubeMapTexture::CubeFace>(face), i,
+                          image);
+      }
+    }
+  }
+  return texture;
+}
+
+void SceneReader::ReadBufferData(gfx::BufferObject* buffer_object) {
+  buffer_object->SetLabel(ReadString());
+  const size_t spec_count = ReadCount(3U * sizeof(uint32));
+  for (size_t i = 0; i < spec_count; ++i) {
+    const gfx::BufferObject::ComponentType type =
+        static_cast<gfx::BufferObject::ComponentType>(ReadUint32());
+    const size_t component_count = ReadUint32();
+    buffer_object->AddSpec(type, component_count, ReadUint32());
+  }
+  const size_t struct_size = ReadUint32();
+  const size_t count = ReadUint32();
+  const gfx::BufferObject::UsageMode usage =
+      static_cast<gfx::BufferObject::UsageMode>(ReadUint32());
+  size_t size;
+  const base::DataContainerPtr data = ReadPayload(&size);
+  if (static_cast<uint64>(struct_size) * count != size)
+    is_valid_ = false;
+  else
+    buffer_object->SetData(data, struct_size, count, usage);
+}
+
+const gfx::AttributeArrayPtr SceneReader::ReadAttributeArray() {
+  gfx::AttributeArrayPtr attribute_array(
+      new(allocator_) gfx::AttributeArray);
+  const size_t count = ReadCount(6U * sizeof(uint32));
+  for (size_t i = 0; i < count && is_valid_; ++i) {
+    gfx::ShaderInputRegistryPtr registry;
+    ReadRef(kRegistryObject, &registry);
+    const std::string name = ReadString();
+    const gfx::AttributeType type =
+        static_cast<gfx::AttributeType>(ReadUint32());
+    const bool is_enabled = ReadBool();
+    const bool is_normalized = ReadBool();
+    const unsigned int divisor = ReadUint32();
+    if (!registry.Get()) {
+      is_valid_ = false;
+      break;
+    }
+    gfx::Attribute attribute;
+    switch (type) {
+      case gfx::kFloatAttribute:
+        attribute = ReadAttributeValue<float>(registry, name);
+        break;
+      case gfx::kFloatVector2Attribute:
+        attribute = ReadAttributeValue<math::Vector2f>(registry, name);
+        break;
+      case gfx::kFloatVector3Attribute:
+        attribute = ReadAttributeValue<math::Vector3f>(registry, name);
+        break;
+      case gfx::kFloatVector4Attribute:
+        attribute = ReadAttributeValue<math::Vector4f>(registry, name);
+        break;
+      case gfx::kFloatMatrix2x2Attribute:
+        attribute = ReadAttributeValue<math::Matrix2f>(registry, name);
+        break;
+      case gfx::kFloatMatrix3x3Attribute:
+        attribute = ReadAttributeValue<math::Matrix3f>(registry, name);
+        break;
+      case gfx::kFloatMatrix4x4Attribute:
+        attribute = ReadAttributeValue<math::Matrix4f>(registry, name);
+        break;
+      case gfx::kBufferObjectElementAttribute: {
+        gfx::BufferObjectPtr buffer_object;
+        ReadRef(kBufferObjectObject, &buffer_object);
+        const size_t spec_index = ReadUint32();
+        if (buffer_object.Get() &&
+            spec_index < buffer_object->GetSpecCount()) {
+          attribute = registry->Create<gfx::Attribute>(
+              name, gfx::BufferObjectElement(buffer_object, spec_index));
+        }
+        break;
+      }
+    }
+    if (!attribute.IsValid()) {
+      is_valid_ = false;
+      break;
+    }
+    attribute.SetFixedPointNormalized(is_normalized);
+    attribute.SetDivisor(divisor);
+    const size_t index = attribute_array->AddAttribute(attribute);
+    attribute_array->EnableAttribute(index, is_enabled);
+  }
+  return attribute_array;
+}
+
+const gfx::ShapePtr SceneReader::ReadShape() {
+  gfx::ShapePtr shape(new(allocator_) gfx::Shape);
+  shape->SetLabel(ReadString());
+  shape->SetPrimitiveType(static_cast<gfx::Shape::PrimitiveType>(ReadUint32()));
+  gfx::AttributeArrayPtr attribute_array;
+  ReadRef(kAttributeArrayObject, &attribute_array);
+  shape->SetAttributeArray(attribute_array);
+  gfx::IndexBufferPtr index_buffer;
+  ReadRef(kIndexBufferObject, &index_buffer);
+  shape->SetIndexBuffer(index_buffer);
+  shape->SetInstanceCount(ReadInt());
+  const size_t range_count =
+      ReadCount(sizeof(math::Range1i) + 2U * sizeof(uint32));
+  for (size_t i = 0; i < range_count; ++i) {
+    const size_t index = shape->AddVertexRange(ReadValue<math::Range1i>());
+    shape->EnableVertexRange(index, ReadBool());
+    shape->SetVertexRangeInstanceCount(index, ReadInt());
+  }
+  return shape;
+}
+
+const gfx::StateTablePtr SceneReader::ReadStateTable() {
+  typedef gfx::StateTable ST;
+  gfx::StateTablePtr state_table(new(allocator_) gfx::StateTable);
+  state_table->SetEnforceSettings(ReadBool());
+  for (int i = 0; i < ST::GetCapabilityCount(); ++i) {
+    const bool is_set = ReadBool();
+    const bool is_enabled = ReadBool();
+    if (is_set)
+      state_table->Enable(static_cast<ST::Capability>(i), is_enabled);
+  }
+  while (is_valid_) {
+    const ST::Value value = static_cast<ST::Value>(ReadUint32());
+    switch (value) {
+      case ST::kBlendColorValue:
+        state_table->SetBlendColor(ReadValue<math::Vector4f>());
+        break;
+      case ST::kBlendEquationsValue: {
+        const ST::BlendEquation rgb =
+            static_cast<ST::BlendEquation>(ReadUint32());
+        state_table->SetBlendEquations(
+            rgb, static_cast<ST::BlendEquation>(ReadUint32()));
+        break;
+      }
+      case ST::kBlendFunctionsValue: {
+        ST::BlendFunctionFactor factors[4];
+        for (int j = 0; j < 4; ++j)
+          factors[j] = static_cast<ST::BlendFunctionFactor>(ReadUint32());
+        state_table->SetBlendFunctions(factors[0], factors[1], factors[2],
+                                       factors[3]);
+        break;
+      }
+      case ST::kClearColorValue:
+        state_table->SetClearColor(ReadValue<math::Vector4f>());
+        break;
+      case ST::kClearDepthValue:
+        state_table->SetClearDepthValue(ReadValue<float>());
+        break;
+      case ST::kClearStencilValue:
+        state_table->SetClearStencilValue(ReadInt());
+        break;
+      case ST::kColorWriteMasksValue: {
+        bool masks[4];
+        for (int j = 0; j < 4; ++j)
+          masks[j] = ReadBool();
+        state_table->SetColorWriteMasks(masks[0], masks[1], masks[2],
+                                        masks[3]);
+        break;
+      }
+      case ST::kCullFaceModeValue:
+        state_table->SetCullFaceMode(
+            static_cast<ST::CullFaceMode>(ReadUint32()));
+        break;
+      case ST::kFrontFaceModeValue:
+        state_table->SetFrontFaceMode(
+            static_cast<ST::FrontFaceMode>(ReadUint32()));
+        break;
+      case ST::kDepthFunctionValue:
+        state_table->SetDepthFunction(
+            static_cast<ST::DepthFunction>(ReadUint32()));
+        break;
+      case ST::kDepthRangeValue:
+        state_table->SetDepthRange(ReadValue<math::Range1f>());
+        break;
+      case ST::kDepthWriteMaskValue:
+        state_table->SetDepthWriteMask(ReadBool());
+        break;
+      case ST::kDrawBufferValue:
+        state_table->SetDrawBuffer(static_cast<ST::DrawBuffer>(ReadUint32()));
+        break;
+      case ST::kHintsValue:
+        state_table->SetHint(ST::kGenerateMipmapHint,
+                             static_cast<ST::HintMode>(ReadUint32()));
+        break;
+      case ST::kLineWidthValue:
+        state_table->SetLineWidth(ReadValue<float>());
+        break;
+      case ST::kPolygonOffsetValue: {
+        const float factor = ReadValue<float>();
+        state_table->SetPolygonOffset(factor, ReadValue<float>());
+        break;
+      }
+      case ST::kSampleCoverageValue: {
+        const float coverage = ReadValue<float>();
+        state_table->SetSampleCoverage(coverage, ReadBool());
+        break;
+      }
+      case ST::kScissorBoxValue:
+        state_table->SetScissorBox(ReadValue<math::Range2i>());
+        break;
+      case ST::kStencilFunctionsValue: {
+        const ST::StencilFunction front_function =
+            static_cast<ST::StencilFunction>(ReadUint32());
+        const int front_reference = ReadInt();
+        const uint32 front_mask = ReadUint32();
+        const ST::StencilFunction back_function =
+            static_cast<ST::StencilFunction>(ReadUint32());
+        const int back_reference = ReadInt();
+        state_table->SetStencilFunctions(front_function, front_reference,
+                                         front_mask, back_function,
+                                         back_reference, ReadUint32());
+        break;
+      }
+      case ST::kStencilOperationsValue: {
+        ST::StencilOperation operations[6];
+        for (int j = 0; j < 6; ++j)
+          operations[j] = static_cast<ST::StencilOperation>(ReadUint32());
+        state_table->SetStencilOperations(operations[0], operations[1],
+                                          operations[2], operations[3],
+                                          operations[4], operations[5]);
+        break;
+      }
+      case ST::kStencilWriteMasksValue: {
+        const uint32 front_mask = ReadUint32();
+        state_table->SetStencilWriteMasks(front_mask, ReadUint32());
+        break;
+      }
+      case ST::kViewportValue:
+        state_table->SetViewport(ReadValue<math::Range2i>());
+        break;
+      case ST::kNumValues:
+        return state_table;
+      default:
+        is_valid_ = false;
+        break;
+    }
+  }
+  return state_table;
+}
+
+const gfx::UniformBlockPtr SceneReader::ReadUniformBlock() {
+  gfx::UniformBlockPtr block(new(allocator_) gfx::UniformBlock);
+  block->SetLabel(ReadString());
+  block->SetBlockName(ReadString());
+  block->Enable(ReadBool());
+  ReadUniforms(block.Get());
+  return block;
+}
+
+const gfx::NodePtr SceneReader::ReadNode() {
+  gfx::NodePtr node(new(allocator_) gfx::Node);
+  node->SetLabel(ReadString());
+  node->Enable(ReadBool());
+  gfx::StateTablePtr state_table;
+  ReadRef(kStateTableObject, &state_table);
+  node->SetStateTable(state_table);
+  gfx::ShaderProgramPtr program;
+  ReadRef(kShaderProgramObject, &program);
+  node->SetShaderProgram(program);
+  ReadUniforms(node.Get());
+  const size_t block_count = ReadCount(sizeof(uint32));
+  for (size_t i = 0; i < block_count; ++i) {
+    gfx::UniformBlockPtr block;
+    ReadRef(kUniformBlockObject, &block);
+    node->AddUniformBlock(block);
+  }
+  const size_t shape_count = ReadCount(sizeof(uint32));
+  for (size_t i = 0; i < shape_count; ++i) {
+    gfx::ShapePtr shape;
+    ReadRef(kShapeObject, &shape);
+    node->AddShape(shape);
+  }
+  const size_t child_count = ReadCount(sizeof(uint32));
+  for (size_t i = 0; i < child_count; ++i) {
+    gfx::NodePtr child;
+    ReadRef(kNodeObject, &child);
+    node->AddChild(child);
+  }
+  const bool has_bounds = ReadBool();
+  const math::Range3f bounds = ReadValue<math::Range3f>();
+  if (has_bounds)
+    node->SetBounds(bounds);
+  const bool has_lod_range = ReadBool();
+  const math::Range1f lod_range = ReadValue<math::Range1f>();
+  if (has_lod_range)
+    node->SetLodRange(lod_range);
+  node->SetDrawOrderPreserved(ReadBool());
+  return node;
+}
+
+void SceneReader::ReadTextureSettings(gfx::TextureBase* texture) {
+  typedef gfx::TextureBase T;
+  texture->SetLabel(ReadString());
+  gfx::SamplerPtr sampler;
+  ReadRef(kSamplerObject, &sampler);
+  texture->SetSampler(sampler);
+  texture->SetBaseLevel(ReadInt());
+  texture->SetMaxLevel(ReadInt());
+  T::Swizzle swizzles[4];
+  for (int i = 0; i < 4; ++i)
+    swizzles[i] = static_cast<T::Swizzle>(ReadUint32());
+  texture->SetSwizzles(swizzles[0], swizzles[1], swizzles[2], swizzles[3]);
+  const int samples = ReadInt();
+  texture->SetMultisampling(samples, ReadBool());
+  texture->SetPixelBufferStreamingEnabled(ReadBool());
+  gfx::ImagePtr immutable_image;
+  ReadRef(kImageObject, &immutable_image);
+  const size_t immutable_levels = ReadUint32();
+  if (immutable_image.Get())
+    texture->SetImmutableImage(immutable_image, immutable_levels);
+}
+
+void SceneReader::ReadUniforms(gfx::UniformHolder* holder) {
+  const size_t count = ReadCount(4U * sizeof(uint32));
+  for (size_t i = 0; i < count && is_valid_; ++i) {
+    const gfx::Uniform uniform = ReadUniform();
+    if (uniform.IsValid())
+      holder->AddUniform(uniform);
+    else
+      is_valid_ = false;
+  }
+}
+
+const gfx::Uniform SceneReader::ReadUniform() {
+  gfx::ShaderInputRegistryPtr registry;
+  ReadRef(kRegistryObject, &registry);
+  const std::string name = ReadString();
+  const gfx::UniformType type = static_cast<gfx::UniformType>(ReadUint32());
+  const size_t count = ReadCount(sizeof(uint32));
+  if (!registry.Get())
+    return gfx::Uniform();
+  switch (type) {
+    case gfx::kFloatUniform:
+      return ReadUniformValues<float>(registry, name, count);
+    case gfx::kIntUniform:
+      return ReadUniformValues<int>(registry, name, count);
+    case gfx::kUnsignedIntUniform:
+      return ReadUniformValues<uint32>(registry, name, count);
+    case gfx::kCubeMapTextureUniform:
+      return ReadUniformValues<gfx::CubeMapTexturePtr>(registry, name, count);
+    case gfx::kTextureUniform:
+      return ReadUniformValues<gfx::TexturePtr>(registry, name, count);
+    case gfx::kFloatVector2Uniform:
+      return ReadUniformValues<math::Vector2f>(registry, name, count);
+    case gfx::kFloatVector3Uniform:
+      return ReadUniformValues<math::Vector3f>(registry, name, count);
+    case gfx::kFloatVector4Uniform:
+      return ReadUniformValues<math::Vector4f>(registry, name, count);
+    case gfx::kIntVector2Uniform:
+      return ReadUniformValues<math::Vector2i>(registry, name, count);
+    case gfx::kIntVector3Uniform:
+      return ReadUniformValues<math::Vector3i>(registry, name, count);
+    case gfx::kIntVector4Uniform:
+      return ReadUniformValues<math::Vector4i>(registry, name, count);
+    case gfx::kUnsignedIntVector2Uniform:
+      return ReadUniformValues<math::Vector2ui>(registry, name, count);
+    case gfx::kUnsignedIntVector3Uniform:
+      return ReadUniformValues<math::Vector3ui>(registry, name, count);
+    case gfx::kUnsignedIntVector4Uniform:
+      return ReadUniformValues<math::Vector4ui>(registry, name, count);
+    case gfx::kMatrix2x2Uniform:
+      return ReadUniformValues<math::Matrix2f>(registry, name, count);
+    case gfx::kMatrix3x3Uniform:
+      return ReadUniformValues<math::Matrix3f>(registry, name, count);
+    case gfx::kMatrix4x4Uniform:
+      return ReadUniformValues<math::Matrix4f>(registry, name, count);
+  }
+  return gfx::Uniform();
+}
+
+template <typename T>
+const gfx::Uniform SceneReader::ReadUniformValues(
+    const gfx::ShaderInputRegistryPtr& registry, const std::string& name,
+    size_t count) {
+  if (!count) {
+    T value;
+    ReadValue(&value);
+    return is_valid_ ? registry->Create<gfx::Uniform>(name, value)
+                     : gfx::Uniform();
+  }
+  std::vector<T> values(count);
+  for (size_t i = 0; i < count; ++i)
+    ReadValue(&values[i]);
+  return is_valid_ ? registry->CreateArrayUniform(name, &values[0], count,
+                                                  allocator_)
+                   : gfx::Uniform();
+}
+
+template <typename T>
+const gfx::Attribute SceneReader::ReadAttributeValue(
+    const gfx::ShaderInputRegistryPtr& registry, const std::string& name) {
+  const T value = ReadValue<T>();
+  return is_valid_ ? registry->Create<gfx::Attribute>(name, value)
+                   : gfx::Attribute();
+}
+
+void SceneReader::ReadBytes(void* data, size_t size) {
+  if (!is_valid_ || size > records_end_ - position_) {
+    is_valid_ = false;
+    memset(data, 0, size);
+    return;
+  }
+  memcpy(data, data_ + position_, size);
+  position_ += size;
+}
+
+const std::string SceneReader::ReadString() {
+  const size_t length = ReadCount(1U);
+  if (!is_valid_)
+    return std::string();
+  const std::string s(data_ + position_, length);
+  position_ += length;
+  return s;
+}
+
+size_t SceneReader::ReadCount(size_t item_size) {
+  const size_t count = ReadUint32();
+  if (count > (records_end_ - position_) / item_size) {
+    is_valid_ = false;
+    return 0U;
+  }
+  return count;
+}
+
+template <typename T>
+void SceneReader::ReadRef(ObjectType type, base::SharedPtr<T>* ptr) {
+  const uint32 index = ReadUint32();
+  if (index == kNoObject || !is_valid_) {
+    ptr->Reset();
+  } else if (index >= objects_.size() || objects_[index].type != type) {
+    is_valid_ = false;
+    ptr->Reset();
+  } else {
+    ptr->Reset(static_cast<T*>(objects_[index].object.Get()));
+  }
+}
+
+const base::DataContainerPtr SceneReader::ReadPayload(size_t* size) {
+  const uint64 offset = ReadValue<uint64>();
+  const uint64 length = ReadValue<uint64>();
+  *size = static_cast<size_t>(length);
+  if (!is_valid_ || offset > payload_size_ || length > payload_size_ - offset) {
+    is_valid_ = false;
+    return base::DataContainerPtr();
+  }
+  if (!length)
+    return base::DataContainerPtr();
+  return create_container_(payload_start_ + static_cast<size_t>(offset),
+                           *size);
+}
+
+}  // anonymous namespace
+
+bool SaveScene(const gfx::NodePtr& root, std::ostream& out) {  // NOLINT
+  if (!root.Get()) {
+    LOG(ERROR) << "Cannot save a NULL scene.";
+    return false;
+  }
+  SceneWriter writer;
+  return writer.Write(root, out);
+}
+
+const gfx::NodePtr LoadSceneFromData(const void* data, size_t size,
+                                     const SceneLoadSpec& spec) {
+  const uint8* bytes = static_cast<const uint8*>(data);
+  SceneReader reader(
+      data, size, spec, [bytes, &spec](size_t offset, size_t length) {
+        return base::DataContainer::CreateAndCopy<uint8>(
+            bytes + offset, length, spec.is_wipeable, spec.allocator);
+      });
+  return reader.Read();
+}
+
+const gfx::NodePtr LoadSceneFromFile(const std::string& path,
+                                     const SceneLoadSpec& spec) {
+  base::DataContainer::MappedFilePtr file(new port::MemoryMappedFile(path));
+  if (!file->GetData()) {
+    LOG(ERROR) << "Unable to map scene file \"" << path << "\".";
+    return gfx::NodePtr();
+  }
+  SceneReader reader(
+      file->GetData(), file->GetLength(), spec,
+      [&file, &spec](size_t offset, size_t length) {
+        return base::DataContainer::CreateFromMappedFile(
+            file, offset, length, spec.is_wipeable, spec.allocator);
+      });
+  return reader.Read();
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,99 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_SCENEFILE_H_
+#define ION_GFXUTILS_SCENEFILE_H_
+
+// This file contains functions that save a scene graph to a compact binary
+// format and load it back, e.g., to cache a scene that is expensive to build
+// or to take a snapshot of it. The format stores the objects of the scene in
+// an order in which each object only refers to objects before it, followed by
+// the raw vertex, index and image data, so loading a scene needs no parsing
+// beyond recreating the objects. When a scene is loaded from a file, the
+// DataContainers of its BufferObjects and Images point directly into a memory
+// mapping of the file rather than holding copies of the data.
+//
+// Objects that are shared in the saved scene are also shared in the loaded
+// scene. The following objects and settings are saved:
+//  - Nodes, with their labels, enabled states, StateTables, ShaderPrograms,
+//    Uniforms, UniformBlocks, Shapes, children, bounds, LOD ranges and draw
+//    order flags.
+//  - Shapes, AttributeArrays, BufferObjects and IndexBuffers.
+//  - ShaderPrograms, with the sources of their vertex and fragment Shaders,
+//    and their ShaderInputRegistries with the names, types and doc strings of
+//    their specs. Uniforms and Attributes that use the global registry use it
+//    in the loaded scene as well. The combine and generate functions of specs
+//    in other registries cannot be saved; they must be set up again, e.g., by
+//    adding the specs to the registries of the loaded ShaderPrograms.
+//  - Textures and CubeMapTextures with their Samplers and dense or array
+//    Images. EGL images cannot be saved.
+// The data of BufferObjects and Images must still be present, so a scene with
+// wipeable data must be saved before it is rendered. Sub-data, sub-images and
+// other pending updates are not saved.
+//
+// The format is native-endian; it is meant for caching on the device that
+// saved the data.
+
+#include <iostream>  // NOLINT
+#include <string>
+
+#include "ion/base/allocator.h"
+#include "ion/gfx/node.h"
+
+namespace ion {
+namespace gfxutils {
+
+// This struct describes how a saved scene is loaded. Default values are listed
+// in parentheses in the member field comments.
+struct SceneLoadSpec {
+  SceneLoadSpec() : is_wipeable(false) {}
+  // The allocator used for the objects of the loaded scene and, when a scene
+  // is loaded from memory, for the copies of its data. (NULL, meaning the
+  // default allocator)
+  base::AllocatorPtr allocator;
+  // Whether the DataContainers of BufferObjects and Images are wipeable, i.e.,
+  // whether their data are released once they have been sent to OpenGL. The
+  // loaded scene cannot be saved again after it has been rendered if this is
+  // set. (false)
+  bool is_wipeable;
+};
+
+// Writes the scene rooted at |root| to |out|. Returns false if the scene
+// cannot be saved, e.g., because some of its data has been wiped or it
+// contains an EGL image. The data written to |out| is then incomplete.
+ION_API bool SaveScene(const gfx::NodePtr& root,
+                       std::ostream& out);  // NOLINT
+
+// Loads a scene from |size| bytes of in-memory |data| written by SaveScene(),
+// copying the vertex, index and image data into the new scene. Returns a NULL
+// Node if the data is not valid.
+ION_API const gfx::NodePtr LoadSceneFromData(const void* data, size_t size,
+                                             const SceneLoadSpec& spec);
+
+// Same as LoadSceneFromData(), but memory-maps the file at |path| instead of
+// reading it. The DataContainers of the BufferObjects, IndexBuffers and
+// Images of the scene point directly into the mapping, which stays alive until
+// they are all destroyed or wiped. Since the mapping is read-only, the data
+// must not be modified through the containers. Returns a NULL Node if the file
+// cannot be mapped or is not valid.
+ION_API const gfx::NodePtr LoadSceneFromFile(const std::string& path,
+                                             const SceneLoadSpec& spec);
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_SCENEFILE_H_
@@ -0,0 +1,572 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/sceneoptimizer.h"
+
+#include <cstring>  // For memcpy().
+#include <utility>
+
+#include "base/integral_types.h"
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/scopedallocation.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfx/uniformblock.h"
+#include "ion/math/matrix.h"
+#include "ion/math/matrixutils.h"
+#include "ion/math/transformutils.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using math::Matrix3f;
+using math::Matrix4f;
+
+// Returns a short-term Allocator for temporary data.
+static const base::AllocatorPtr& GetTemporaryAllocator() {
+  return base::AllocationManager::GetDefaultAllocatorForLifetime(
+      base::kShortTerm);
+}
+
+// Returns whether two UniformBlocks have the same name, enabled state and
+// Uniforms.
+static bool AreUniformBlocksEqual(const gfx::UniformBlock& block0,
+                                  const gfx::UniformBlock& block1) {
+  if (&block0 == &block1)
+    return true;
+  if (block0.IsEnabled() != block1.IsEnabled() ||
+      block0.GetBlockName() != block1.GetBlockName())
+    return false;
+  const base::AllocVector<gfx::Uniform>& uniforms0 = block0.GetUniforms();
+  const base::AllocVector<gfx::Uniform>& uniforms1 = block1.GetUniforms();
+  if (uniforms0.size() != uniforms1.size())
+    return false;
+  for (size_t i = 0; i < uniforms0.size(); ++i) {
+    if (!(uniforms0[i] == uniforms1[i]))
+      return false;
+  }
+  return true;
+}
+
+// Returns whether |node| has nothing that affects its Shapes or children
+// other than its bounds.
+static bool HasOnlyShapesAndChildren(const gfx::Node& node) {
+  return !node.GetStateTable().Get() && !node.GetShaderProgram().Get() &&
+         node.GetUniforms().empty() && node.GetUniformBlocks().empty() &&
+         !node.HasLodRange() && !node.IsDrawOrderPreserved() &&
+         node.GetLabel().empty();
+}
+
+// Returns whether drawing |node| has no effect. A StateTable may clear the
+// framebuffer even if there is nothing to draw, and a label may be used to
+// time the Node.
+static bool HasNoEffect(const gfx::Node& node) {
+  return !node.GetStateTable().Get() && node.GetShapes().empty() &&
+         node.GetChildren().empty() && node.GetLabel().empty();
+}
+
+// Returns the name of |input| in its registry.
+template <typename T>
+static const std::string& GetInputName(const T& input) {
+  return gfx::ShaderInputRegistry::GetSpec(input)->name;
+}
+
+//-----------------------------------------------------------------------------
+//
+// TransformBaker applies a transformation to the positions and normals of
+// Shapes, creating copies of the Shapes and their vertex buffers. Each Shape
+// and BufferObject is copied at most once.
+//
+//-----------------------------------------------------------------------------
+class TransformBaker {
+ public:
+  // The matrix must be affine and invertible.
+  explicit TransformBaker(const Matrix4f& matrix)
+      : matrix_(matrix),
+        normal_matrix_(
+            math::Transpose(math::Inverse(math::NonhomogeneousSubmatrixH(
+                matrix)))),
+        shapes_(GetTemporaryAllocator()),
+        buffers_(GetTemporaryAllocator()),
+        transformed_elements_(GetTemporaryAllocator()) {}
+
+  // Returns whether the positions and normals of |shape| can be transformed.
+  static bool CanTransform(const gfx::Shape& shape);
+
+  // Returns a copy of |shape| with transformed positions and normals, which
+  // must meet the requirements of CanTransform().
+  const gfx::ShapePtr Transform(const gfx::ShapePtr& shape);
+
+ private:
+  typedef std::pair<const gfx::BufferObject*, size_t> Element;
+
+  // Returns the copy of |buffer_object|, creating it if necessary.
+  const gfx::BufferObjectPtr& GetCopy(
+      const gfx::BufferObjectPtr& buffer_object);
+  // Transforms the positions or normals in the element of the copy of
+  // |buffer_object| at |spec_index|, unless that was already done.
+  void TransformElement(const gfx::BufferObjectPtr& buffer_object,
+                        size_t spec_index, bool is_normal);
+
+  const Matrix4f matrix_;
+  const Matrix3f normal_matrix_;
+  base::AllocUnorderedMap<const gfx::Shape*, gfx::ShapePtr> shapes_;
+  base::AllocUnorderedMap<const gfx::BufferObject*, gfx::BufferObjectPtr>
+      buffers_;
+  base::AllocVector<Element> transformed_elements_;
+};
+
+bool TransformBaker::CanTransform(const gfx::Shape& shape) {
+  const gfx::AttributeArrayPtr& attribute_array = shape.GetAttributeArray();
+  if (!attribute_array.Get())
+    return false;
+  bool has_positions = false;
+  const size_t attribute_count = attribute_array->GetAttributeCount();
+  for (size_t i = 0; i < attribute_count; ++i) {
+    const gfx::Attribute& attribute = attribute_array->GetAttribute(i);
+    if (!attribute.IsValid())
+      continue;
+    const std::string& name = GetInputName(attribute);
+    const bool is_position = name == "aVertex";
+    if (!is_position && name != "aNormal")
+      continue;
+    if (attribute.GetType() != gfx::kBufferObjectElementAttribute ||
+        attribute.GetDivisor())
+      return false;
+    const gfx::BufferObjectElement& element =
+        attribute.GetValue<gfx::BufferObjectElement>();
+    const gfx::BufferObject* buffer_object = element.buffer_object.Get();
+    if (!buffer_object)
+      return false;
+    const gfx::BufferObject::Spec& spec =
+        buffer_object->GetSpec(element.spec_index);
+    const base::DataContainerPtr& data = buffer_object->GetData();
+    if (spec.type != gfx::BufferObject::kFloat ||
+        (is_position ? spec.component_count < 3U
+                     : spec.component_count != 3U) ||
+        !data.Get() || !data->GetData())
+      return false;
+    has_positions = has_positions || is_position;
+  }
+  return has_positions;
+}
+
+const gfx::ShapePtr TransformBaker::Transform(const gfx::ShapePtr& shape) {
+  gfx::ShapePtr& copy = shapes_[shape.Get()];
+  if (copy.Get())
+    return copy;
+  DCHECK(CanTransform(*shape));
+
+  // Transform the elements first, so that all attributes that share a
+  // BufferObject with a transformed one use its copy.
+  const gfx::AttributeArray& attribute_array = *shape->GetAttributeArray();
+  const size_t attribute_count = attribute_array.GetAttributeCount();
+  for (size_t i = 0; i < attribute_count; ++i) {
+    const gfx::Attribute& attribute = attribute_array.GetAttribute(i);
+    if (!attribute.IsValid() ||
+        attribute.GetType() != gfx::kBufferObjectElementAttribute)
+      continue;
+    const std::string& name = GetInputName(attribute);
+    if (name == "aVertex" || name == "aNormal") {
+      const gfx::BufferObjectElement& element =
+          attribute.GetValue<gfx::BufferObjectElement>();
+      TransformElement(element.buffer_object, element.spec_index,
+                       name == "aNormal");
+    }
+  }
+
+  gfx::AttributeArrayPtr new_array(new gfx::AttributeArray);
+  for (size_t i = 0; i < attribute_count; ++i) {
+    gfx::Attribute attribute = attribute_array.GetAttribute(i);
+    if (!attribute.IsValid())
+      continue;
+    if (attribute.GetType() == gfx::kBufferObjectElementAttribute) {
+      const gfx::BufferObjectElement& element =
+          attribute.GetValue<gfx::BufferObjectElement>();
+      const auto it = buffers_.find(element.buffer_object.Get());
+      if (it != buffers_.end())
+        attribute.SetValue(
+            gfx::BufferObjectElement(it->second, element.spec_index));
+    }
+    const size_t index = new_array->AddAttribute(attribute);
+    if (attribute.GetType() == gfx::kBufferObjectElementAttribute)
+      new_array->EnableAttribute(index,
+                                 attribute_array.IsAttributeEnabled(i));
+  }
+
+  copy = new gfx::Shape;
+  copy->SetLabel(shape->GetLabel());
+  copy->SetPrimitiveType(shape->GetPrimitiveType());
+  copy->SetAttributeArray(new_array);
+  copy->SetIndexBuffer(shape->GetIndexBuffer());
+  copy->SetInstanceCount(shape->GetInstanceCount());
+  const size_t range_count = shape->GetVertexRangeCount();
+  for (size_t i = 0; i < range_count; ++i) {
+    const size_t index = copy->AddVertexRange(shape->GetVertexRange(i));
+    copy->EnableVertexRange(index, shape->IsVertexRangeEnabled(i));
+    copy->SetVertexRangeInstanceCount(index,
+                                      shape->GetVertexRangeInstanceCount(i));
+  }
+  return copy;
+}
+
+const gfx::BufferObjectPtr& TransformBaker::GetCopy(
+    const gfx::BufferObjectPtr& buffer_object) {
+  gfx::BufferObjectPtr& copy = buffers_[buffer_object.Get()];
+  if (!copy.Get()) {
+    copy = new gfx::BufferObject;
+    copy->SetLabel(buffer_object->GetLabel());
+    const size_t spec_count = buffer_object->GetSpecCount();
+    for (size_t i = 0; i < spec_count; ++i) {
+      const gfx::BufferObject::Spec& spec = buffer_object->GetSpec(i);
+      // Specs are unique, so they keep their indices.
+      copy->AddSpec(spec.type, spec.component_count, spec.byte_offset);
+    }
+    const base::DataContainerPtr& data = buffer_object->GetData();
+    const size_t size =
+        buffer_object->GetStructSize() * buffer_object->GetCount();
+    base::ScopedAllocation<uint8> sa(buffer_object->GetAllocator(), size);
+    memcpy(sa.Get(), data->GetData(), size);
+    copy->SetData(sa.TransferToDataContainer(data->IsWipeable()),
+                  buffer_object->GetStructSize(), buffer_object->GetCount(),
+                  buffer_object->GetUsageMode());
+  }
+  return copy;
+}
+
+void TransformBaker::TransformElement(
+    const gfx::BufferObjectPtr& buffer_object, size_t spec_index,
+    bool is_normal) {
+  // Several Shapes may share an element.
+  const Element element(buffer_object.Get(), spec_index);
+  for (const Element& transformed : transformed_elements_) {
+    if (transformed == element)
+      return;
+  }
+  transformed_elements_.push_back(element);
+
+  const gfx::BufferObjectPtr& copy = GetCopy(buffer_object);
+  const gfx::BufferObject::Spec& spec = copy->GetSpec(spec_index);
+  const size_t stride = copy->GetStructSize();
+  const size_t count = copy->GetCount();
+  uint8* data = copy->GetData()->GetMutableData<uint8>() + spec.byte_offset;
+  for (size_t i = 0; i < count; ++i, data += stride) {
+    float values[4];
+    memcpy(values, data, spec.component_count * sizeof(values[0]));
+    if (is_normal) {
+      const math::Vector3f normal =
+          normal_matrix_ * math::Vector3f(values[0], values[1], values[2]);
+      memcpy(values, normal.Data(), sizeof(normal));
+    } else {
+      // The translation of a 4-component position is scaled by its
+      // homogeneous coordinate, which affine transformations do not change.
+      const float w = spec.component_count == 4U ? values[3] : 1.f;
+      float position[3];
+      for (int row = 0; row < 3; ++row) {
+        position[row] = matrix_(row, 0) * values[0] +
+                        matrix_(row, 1) * values[1] +
+                        matrix_(row, 2) * values[2] + matrix_(row, 3) * w;
+      }
+      memcpy(values, position, sizeof(position));
+    }
+    memcpy(data, values, spec.component_count * sizeof(values[0]));
+  }
+}
+
+//-----------------------------------------------------------------------------
+//
+// SceneOptimizer builds the optimized copy of a scene.
+//
+//-----------------------------------------------------------------------------
+class SceneOptimizer {
+ public:
+  explicit SceneOptimizer(const SceneOptimizationSpec& spec)
+      : spec_(spec),
+        state_tables_(GetTemporaryAllocator()),
+        uniform_blocks_(GetTemporaryAllocator()),
+        inherited_uniforms_(GetTemporaryAllocator()),
+        shader_program_(NULL) {}
+
+  // Returns the optimized copy of |node|, which must be enabled. The Uniforms
+  // and ShaderProgram set by its ancestors must have been pushed.
+  const gfx::NodePtr OptimizeNode(const gfx::Node& node);
+
+ private:
+  // A Uniform that is in effect for the subgraph of a Node.
+  struct InheritedUniform {
+    InheritedUniform(const gfx::Uniform& uniform_in, bool is_known)
+        : registry(&uniform_in.GetRegistry()),
+          index(uniform_in.GetIndexInRegistry()),
+          uniform(is_known ? &uniform_in : NULL) {}
+    const gfx::ShaderInputRegistry* registry;
+    size_t index;
+    // The Uniform, or NULL if its value cannot be known, e.g., because it is
+    // set from a uniform buffer object.
+    const gfx::Uniform* uniform;
+  };
+
+  // Returns the StateTable that replaces |state_table|.
+  const gfx::StateTablePtr GetSharedStateTable(
+      const gfx::StateTablePtr& state_table);
+  // Returns the UniformBlock that replaces |block|.
+  const gfx::UniformBlockPtr GetSharedUniformBlock(
+      const gfx::UniformBlockPtr& block);
+  // Returns whether |uniform| sets the value it already has.
+  bool IsUniformRedundant(const gfx::Uniform& uniform) const;
+  // Records the Uniforms set by |node| for its subgraph.
+  void PushUniforms(const gfx::Node& node);
+  // Adds the optimized |child| to |parent|, collapsing it if possible.
+  void AddChild(const gfx::NodePtr& child, gfx::Node* parent) const;
+  // Applies the transformation set by |node| to the Shapes in its subgraph
+  // and removes it, if possible.
+  void BakeTransform(gfx::Node* node) const;
+
+  const SceneOptimizationSpec& spec_;
+  base::AllocVector<gfx::StateTablePtr> state_tables_;
+  base::AllocVector<gfx::UniformBlockPtr> uniform_blocks_;
+  base::AllocVector<InheritedUniform> inherited_uniforms_;
+  // The ShaderProgram in effect for the current Node.
+  gfx::ShaderProgram* shader_program_;
+};
+
+const gfx::NodePtr SceneOptimizer::OptimizeNode(const gfx::Node& node) {
+  DCHECK(node.IsEnabled());
+  gfx::NodePtr copy(new gfx::Node);
+  copy->SetLabel(node.GetLabel());
+  const gfx::StateTablePtr& state_table = node.GetStateTable();
+  if (state_table.Get())
+    copy->SetStateTable(spec_.share_state_tables
+                            ? GetSharedStateTable(state_table)
+                            : state_table);
+  gfx::ShaderProgram* saved_shader_program = shader_program_;
+  const gfx::ShaderProgramPtr& shader_program = node.GetShaderProgram();
+  if (shader_program.Get() &&
+      (!spec_.remove_redundant_settings ||
+       shader_program.Get() != shader_program_)) {
+    copy->SetShaderProgram(shader_program);
+    shader_program_ = shader_program.Get();
+  }
+  for (const gfx::Uniform& uniform : node.GetUniforms()) {
+    if (!spec_.remove_redundant_settings || !IsUniformRedundant(uniform))
+      copy->AddUniform(uniform);
+  }
+  for (const gfx::UniformBlockPtr& block : node.GetUniformBlocks())
+    copy->AddUniformBlock(spec_.share_uniform_blocks
+                              ? GetSharedUniformBlock(block)
+                              : block);
+  for (const gfx::ShapePtr& shape : node.GetShapes())
+    copy->AddShape(shape);
+  if (node.HasBounds())
+    copy->SetBounds(node.GetBounds());
+  if (node.HasLodRange())
+    copy->SetLodRange(node.GetLodRange());
+  copy->SetDrawOrderPreserved(node.IsDrawOrderPreserved());
+
+  const size_t inherited_count = inherited_uniforms_.size();
+  PushUniforms(node);
+  for (const gfx::NodePtr& child : node.GetChildren()) {
+    if (child->IsEnabled())
+      AddChild(OptimizeNode(*child), copy.Get());
+  }
+  inherited_uniforms_.erase(inherited_uniforms_.begin() + inherited_count,
+                            inherited_uniforms_.end());
+  shader_program_ = saved_shader_program;
+
+  if (spec_.bake_transforms)
+    BakeTransform(copy.Get());
+  return copy;
+}
+
+const gfx::StateTablePtr SceneOptimizer::GetSharedStateTable(
+    const gfx::StateTablePtr& state_table) {
+  for (const gfx::StateTablePtr& shared : state_tables_) {
+    if (gfx::StateTable::AreSetItemsSame(*shared, *state_table))
+      return shared;
+  }
+  state_tables_.push_back(state_table);
+  return state_table;
+}
+
+const gfx::UniformBlockPtr SceneOptimizer::GetSharedUniformBlock(
+    const gfx::UniformBlockPtr& block) {
+  for (const gfx::UniformBlockPtr& shared : uniform_blocks_) {
+    if (AreUniformBlocksEqual(*shared, *block))
+      return shared;
+  }
+  uniform_blocks_.push_back(block);
+  return block;
+}
+
+bool SceneOptimizer::IsUniformRedundant(const gfx::Uniform& uniform) const {
+  const gfx::ShaderInputRegistry::UniformSpec* spec =
+      gfx::ShaderInputRegistry::GetSpec(uniform);
+  if (spec->combine_function)
+    return false;
+  // The last Uniform pushed for the same input is the one in effect.
+  for (size_t i = inherited_uniforms_.size(); i > 0; --i) {
+    const InheritedUniform& inherited = inherited_uniforms_[i - 1];
+    if (inherited.registry == &uniform.GetRegistry() &&
+        inherited.index == uniform.GetIndexInRegistry())
+      return inherited.uniform && *inherited.uniform == uniform;
+  }
+  return false;
+}
+
+void SceneOptimizer::PushUniforms(const gfx::Node& node) {
+  // The Renderer pushes the Uniforms of a Node before those of its
+  // UniformBlocks. Blocks may be enabled later or be backed by buffers, which
+  // do not replace Uniforms, so their values are not known.
+  for (const gfx::Uniform& uniform : node.GetUniforms())
+    inherited_uniforms_.push_back(InheritedUniform(uniform, true));
+  for (const gfx::UniformBlockPtr& block : node.GetUniformBlocks()) {
+    const bool is_known =
+        block->IsEnabled() && block->GetBlockName().empty();
+    for (const gfx::Uniform& uniform : block->GetUniforms())
+      inherited_uniforms_.push_back(InheritedUniform(uniform, is_known));
+  }
+}
+
+void SceneOptimizer::AddChild(const gfx::NodePtr& child,
+                              gfx::Node* parent) const {
+  if (!spec_.collapse_nodes) {
+    parent->AddChild(child);
+    return;
+  }
+  if (HasNoEffect(*child))
+    return;
+  if (HasOnlyShapesAndChildren(*child)) {
+    // A Node that only groups other Nodes is replaced by them. If it has
+    // Shapes, they are drawn right after the parent's if there are no
+    // children before it, so they can join them. The parent's bounds must
+    // still contain all of its Shapes, or none of them if they are unknown.
+    const bool can_collapse =
+        child->GetShapes().empty()
+            ? !child->HasBounds()
+            : parent->GetChildren().empty() &&
+                  (parent->HasBounds() == child->HasBounds() ||
+                   (parent->GetShapes().empty() && !parent->HasBounds()));
+    if (can_collapse) {
+      if (child->HasBounds()) {
+        math::Range3f bounds = child->GetBounds();
+        if (parent->HasBounds())
+          bounds.ExtendByRange(parent->GetBounds());
+        parent->SetBounds(bounds);
+      }
+      for (const gfx::ShapePtr& shape : child->GetShapes())
+        parent->AddShape(shape);
+      for (const gfx::NodePtr& grandchild : child->GetChildren())
+        AddChild(grandchild, parent);
+      return;
+    }
+  }
+  parent->AddChild(child);
+}
+
+void SceneOptimizer::BakeTransform(gfx::Node* node) const {
+  // Find the transformation, which must be the only one in the subgraph.
+  const std::string& name = spec_.transform_uniform_name;
+  const base::AllocVector<gfx::Uniform>& uniforms = node->GetUniforms();
+  const size_t index = node->GetUniformIndex(name);
+  if (index == base::kInvalidIndex)
+    return;
+  const gfx::Uniform& uniform = uniforms[index];
+  const gfx::ShaderInputRegistry::UniformSpec* spec =
+      gfx::ShaderInputRegistry::GetSpec(uniform);
+  if (uniform.GetType() != gfx::kMatrix4x4Uniform || uniform.GetCount() ||
+      !spec->combine_function || spec->generate_function)
+    return;
+  const Matrix4f matrix = uniform.GetValue<Matrix4f>();
+  float determinant = 0.f;
+  math::InverseWithDeterminant(math::NonhomogeneousSubmatrixH(matrix),
+                               &determinant);
+  if (matrix(3, 0) != 0.f || matrix(3, 1) != 0.f || matrix(3, 2) != 0.f ||
+      matrix(3, 3) != 1.f || determinant == 0.f)
+    return;
+  for (size_t i = index + 1; i < uniforms.size(); ++i) {
+    if (GetInputName(uniforms[i]) == name)
+      return;
+  }
+
+  // Collect the Nodes of the subgraph, checking that none of them sets the
+  // transformation in a Uniform or UniformBlock, and that all Shapes can be
+  // transformed.
+  base::AllocVector<gfx::Node*> nodes(GetTemporaryAllocator());
+  nodes.push_back(node);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const gfx::Node& subgraph_node = *nodes[i];
+    if (i && subgraph_node.GetUniformIndex(name) != base::kInvalidIndex)
+      return;
+    for (const gfx::UniformBlockPtr& block :
+             subgraph_node.GetUniformBlocks()) {
+      if (block->GetUniformIndex(name) != base::kInvalidIndex)
+        return;
+    }
+    for (const gfx::ShapePtr& shape : subgraph_node.GetShapes()) {
+      if (!TransformBaker::CanTransform(*shape))
+        return;
+    }
+    for (const gfx::NodePtr& child : subgraph_node.GetChildren())
+      nodes.push_back(child.Get());
+  }
+
+  TransformBaker baker(matrix);
+  for (gfx::Node* subgraph_node : nodes) {
+    const size_t shape_count = subgraph_node->GetShapes().size();
+    for (size_t i = 0; i < shape_count; ++i)
+      subgraph_node->ReplaceShape(
+          i, baker.Transform(subgraph_node->GetShapes()[i]));
+  }
+  node->RemoveUniformByName(name);
+}
+
+}  // anonymous namespace
+
+const gfx::NodePtr OptimizeScene(const gfx::NodePtr& root,
+                                 const SceneOptimizationSpec& spec) {
+  if (!root.Get())
+    return gfx::NodePtr();
+  if (!root->IsEnabled()) {
+    // Nothing is drawn.
+    gfx::NodePtr empty(new gfx::Node);
+    empty->Enable(false);
+    return empty;
+  }
+  SceneOptimizer optimizer(spec);
+  gfx::NodePtr optimized = optimizer.OptimizeNode(*root);
+  // A root that only groups a single Node is replaced by it.
+  while (spec.collapse_nodes && HasOnlyShapesAndChildren(*optimized) &&
+         optimized->GetShapes().empty() && !optimized->HasBounds() &&
+         optimized->GetChildren().size() == 1U) {
+    const gfx::NodePtr child = optimized->GetChildren()[0];
+    optimized = child;
+  }
+  return optimized;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,94 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_SCENEOPTIMIZER_H_
+#define ION_GFXUTILS_SCENEOPTIMIZER_H_
+
+// This file contains a function that reduces the work the Renderer does to
+// traverse a scene, which is useful for scenes assembled from many small
+// components. The optimized scene is drawn exactly like the original one: it
+// shares the Shapes, StateTables, ShaderPrograms and UniformBlocks of the
+// original scene (except where noted below), but has fewer Nodes, fewer
+// Uniforms to push and pop, and fewer distinct StateTables, which also helps
+// the Renderer group draws when kSortDrawsByState is set.
+
+#include <string>
+
+#include "ion/gfx/node.h"
+
+namespace ion {
+namespace gfxutils {
+
+// This struct selects the optimizations done by OptimizeScene(). Default
+// values are listed in parentheses in the member field comments.
+struct SceneOptimizationSpec {
+  SceneOptimizationSpec()
+      : share_state_tables(true),
+        share_uniform_blocks(true),
+        remove_redundant_settings(true),
+        collapse_nodes(true),
+        bake_transforms(false),
+        transform_uniform_name("uModelviewMatrix") {}
+  // Whether Nodes with StateTables that make the same changes share a single
+  // StateTable. (true)
+  bool share_state_tables;
+  // Whether Nodes with equal UniformBlocks (the same name, enabled state and
+  // Uniforms, in the same order) share a single UniformBlock. (true)
+  bool share_uniform_blocks;
+  // Whether ShaderPrograms and Uniforms that set the value already set by an
+  // ancestor Node are removed. Uniforms that have a combine function in their
+  // registry are always kept. (true)
+  bool remove_redundant_settings;
+  // Whether Nodes that have no effect are removed, and Nodes that only
+  // contain Shapes and other Nodes are merged into their parent: the children
+  // of the Node are moved into the parent, as are its Shapes if the parent
+  // has no children before it. Labeled Nodes and Nodes with LOD ranges are
+  // always kept, and Shapes only join Shapes that also have bounds, or that
+  // also have none. (true)
+  bool collapse_nodes;
+  // Whether the transformation set by the Uniform named transform_uniform_name
+  // is applied to the "aVertex" and "aNormal" attributes of the Shapes below
+  // it, so that the Uniform can be removed. The Uniform must be a single
+  // invertible affine 4x4 matrix with a combine function that multiplies the
+  // inherited value by it, as for the global registry's "uModelviewMatrix",
+  // and no Node below it may set it. Every Shape below it must have a 3- or
+  // 4-component float "aVertex" attribute and may have a 3-component float
+  // "aNormal" attribute, whose data is still present; otherwise the Uniform is
+  // kept. Other attributes are assumed not to depend on the transformation.
+  // Transformed Shapes and their vertex buffers are copies; the original
+  // Shapes are not changed. The bounds of Nodes are unchanged, since they are
+  // already in the scene's coordinate system. (false)
+  bool bake_transforms;
+  // The name of the Uniform that bake_transforms applies. ("uModelviewMatrix")
+  std::string transform_uniform_name;
+};
+
+// Returns a new scene that draws the same as the scene rooted at |root| with
+// the optimizations selected by |spec|, or a NULL pointer if |root| is NULL.
+// All Nodes of the new scene are new; disabled Nodes and their subgraphs are
+// omitted, and a Node that appears more than once in the original scene is
+// copied each time. Since the new scene may replace StateTables and
+// UniformBlocks with equal ones from other Nodes, it should be built after
+// they are set up, and changes should be made to whichever instance the new
+// scene uses.
+ION_API const gfx::NodePtr OptimizeScene(const gfx::NodePtr& root,
+                                         const SceneOptimizationSpec& spec);
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_SCENEOPTIMIZER_H_
@@ -0,0 +1,276 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/scenesnapshot.h"
+
+#include <utility>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns the copy of source in the current copies, creating it with create()
+// or moving it from the previous copies if it is not there yet. Sets is_new
+// to whether the copy was not there yet and must therefore be updated.
+template <typename Map, typename Create>
+typename Map::mapped_type& FindCopy(const typename Map::key_type& source,
+                                    Map* current, Map* previous,
+                                    const Create& create, bool* is_new) {
+  typename Map::iterator it = current->find(source);
+  *is_new = it == current->end();
+  if (!*is_new)
+    return it->second;
+  typename Map::mapped_type& copy = (*current)[source];
+  typename Map::iterator previous_it = previous->find(source);
+  if (previous_it != previous->end())
+    copy = std::move(previous_it->second);
+  else
+    copy = create();
+  return copy;
+}
+
+// Makes the uniforms of a copied UniformHolder equal to those of its source.
+static void CopyUniforms(const gfx::UniformHolder& source,
+                         gfx::UniformHolder* copy) {
+  const base::AllocVector<gfx::Uniform>& uniforms = source.GetUniforms();
+  const size_t count = uniforms.size();
+  if (copy->GetUniforms().size() != count) {
+    copy->ClearUniforms();
+    for (size_t i = 0; i < count; ++i)
+      copy->AddUniform(uniforms[i]);
+  } else {
+    for (size_t i = 0; i < count; ++i)
+      copy->ReplaceUniform(i, uniforms[i]);
+  }
+}
+
+}  // anonymous namespace
+
+SceneSnapshot::Copies::Copies(const base::AllocatorPtr& allocator)
+    : nodes(allocator),
+      shapes(allocator),
+      state_tables(allocator),
+      uniform_blocks(allocator) {}
+
+void SceneSnapshot::Copies::Clear() {
+  nodes.clear();
+  shapes.clear();
+  state_tables.clear();
+  uniform_blocks.clear();
+  root.Reset();
+}
+
+SceneSnapshot::SceneSnapshot(const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      spare_(new Copies(allocator_)),
+      current_(NULL),
+      previous_(NULL),
+      drawn_index_(-1),
+      published_index_(-1),
+      capture_count_(0U) {
+  for (int i = 0; i < kSnapshotCount; ++i)
+    snapshots_[i].reset(new Copies(allocator_));
+}
+
+SceneSnapshot::~SceneSnapshot() {}
+
+void SceneSnapshot::Capture(const gfx::NodePtr& root) {
+  // Fill the snapshot that is neither drawn nor published. The render thread
+  // cannot switch to it until it is published below.
+  int index = 0;
+  {
+    base::LockGuard guard(&mutex_);
+    while (index == drawn_index_ || index == published_index_)
+      ++index;
+  }
+  DCHECK_LT(index, kSnapshotCount);
+
+  previous_ = snapshots_[index].get();
+  current_ = spare_.get();
+  if (root.Get())
+    current_->root = CopyNode(*root);
+  spare_.swap(snapshots_[index]);
+  // Release the copies of objects that are no longer in the scene.
+  previous_->Clear();
+  current_ = previous_ = NULL;
+
+  base::LockGuard guard(&mutex_);
+  published_index_ = index;
+  ++capture_count_;
+}
+
+const gfx::NodePtr SceneSnapshot::AcquireLatest() {
+  base::LockGuard guard(&mutex_);
+  drawn_index_ = published_index_;
+  return drawn_index_ < 0 ? gfx::NodePtr() : snapshots_[drawn_index_]->root;
+}
+
+const gfx::NodePtr& SceneSnapshot::CopyNode(const gfx::Node& node) {
+  bool is_new;
+  gfx::NodePtr& copy = FindCopy(
+      &node, &current_->nodes, &previous_->nodes,
+      [this]() { return gfx::NodePtr(new (allocator_) gfx::Node); }, &is_new);
+  if (!is_new)
+    return copy;
+  gfx::Node* n = copy.Get();
+
+  // Setters that notify are only called for actual changes, so that an
+  // unchanged scene produces no notifications.
+  if (n->GetLabel() != node.GetLabel())
+    n->SetLabel(node.GetLabel());
+  n->Enable(node.IsEnabled());
+  n->SetDrawOrderPreserved(node.IsDrawOrderPreserved());
+  n->SetRenderPass(node.GetRenderPass());
+  if (!node.HasBounds())
+    n->ClearBounds();
+  else if (!n->HasBounds() || n->GetBounds() != node.GetBounds())
+    n->SetBounds(node.GetBounds());
+  if (!node.HasLodRange())
+    n->ClearLodRange();
+  else if (!n->HasLodRange() || n->GetLodRange() != node.GetLodRange())
+    n->SetLodRange(node.GetLodRange());
+  if (n->GetShaderProgram() != node.GetShaderProgram())
+    n->SetShaderProgram(node.GetShaderProgram());
+
+  const gfx::StateTable* st = node.GetStateTable().Get();
+  const gfx::StateTablePtr& st_copy =
+      st ? CopyStateTable(*st) : gfx::StateTablePtr();
+  if (n->GetStateTable() != st_copy)
+    n->SetStateTable(st_copy);
+
+  const gfx::NodePtr& proxy = node.GetOcclusionProxy();
+  const gfx::NodePtr& proxy_copy =
+      proxy.Get() ? CopyNode(*proxy) : gfx::NodePtr();
+  if (n->GetOcclusionQuery() != node.GetOcclusionQuery() ||
+      n->GetOcclusionProxy() != proxy_copy)
+    n->SetOcclusionQuery(node.GetOcclusionQuery(), proxy_copy);
+
+  CopyUniforms(node, n);
+
+  const gfx::Node::UniformBlockVector& blocks = node.GetUniformBlocks();
+  const size_t block_count = blocks.size();
+  if (n->GetUniformBlocks().size() != block_count) {
+    n->ClearUniformBlocks();
+    for (size_t i = 0; i < block_count; ++i)
+      n->AddUniformBlock(CopyUniformBlock(*blocks[i]));
+  } else {
+    for (size_t i = 0; i < block_count; ++i) {
+      const gfx::UniformBlockPtr& block = CopyUniformBlock(*blocks[i]);
+      if (n->GetUniformBlocks()[i] != block)
+        n->ReplaceUniformBlock(i, block);
+    }
+  }
+
+  const gfx::Node::ShapeVector& shapes = node.GetShapes();
+  const size_t shape_count = shapes.size();
+  if (n->GetShapes().size() != shape_count) {
+    n->ClearShapes();
+    for (size_t i = 0; i < shape_count; ++i)
+      n->AddShape(CopyShape(*shapes[i]));
+  } else {
+    for (size_t i = 0; i < shape_count; ++i) {
+      const gfx::ShapePtr& shape = CopyShape(*shapes[i]);
+      if (n->GetShapes()[i] != shape)
+        n->ReplaceShape(i, shape);
+    }
+  }
+
+  const gfx::Node::NodeVector& children = node.GetChildren();
+  const size_t child_count = children.size();
+  if (n->GetChildren().size() != child_count) {
+    n->ClearChildren();
+    for (size_t i = 0; i < child_count; ++i)
+      n->AddChild(CopyNode(*children[i]));
+  } else {
+    for (size_t i = 0; i < child_count; ++i) {
+      const gfx::NodePtr& child = CopyNode(*children[i]);
+      if (n->GetChildren()[i] != child)
+        n->ReplaceChild(i, child);
+    }
+  }
+  return copy;
+}
+
+const gfx::ShapePtr& SceneSnapshot::CopyShape(const gfx::Shape& shape) {
+  bool is_new;
+  gfx::ShapePtr& copy = FindCopy(
+      &shape, &current_->shapes, &previous_->shapes,
+      [this]() { return gfx::ShapePtr(new (allocator_) gfx::Shape); },
+      &is_new);
+  if (!is_new)
+    return copy;
+  gfx::Shape* s = copy.Get();
+  if (s->GetLabel() != shape.GetLabel())
+    s->SetLabel(shape.GetLabel());
+  s->SetPrimitiveType(shape.GetPrimitiveType());
+  s->SetAttributeArray(shape.GetAttributeArray());
+  s->SetIndexBuffer(shape.GetIndexBuffer());
+  s->SetInstanceCount(shape.GetInstanceCount());
+  s->SetIndirectBuffer(shape.GetIndirectBuffer(), shape.GetIndirectOffset());
+  const size_t range_count = shape.GetVertexRangeCount();
+  if (s->GetVertexRangeCount() != range_count) {
+    s->ClearVertexRanges();
+    for (size_t i = 0; i < range_count; ++i)
+      s->AddVertexRange(shape.GetVertexRange(i));
+  }
+  for (size_t i = 0; i < range_count; ++i) {
+    s->SetVertexRange(i, shape.GetVertexRange(i));
+    s->EnableVertexRange(i, shape.IsVertexRangeEnabled(i));
+    s->SetVertexRangeInstanceCount(i, shape.GetVertexRangeInstanceCount(i));
+  }
+  return copy;
+}
+
+const gfx::StateTablePtr& SceneSnapshot::CopyStateTable(
+    const gfx::StateTable& table) {
+  bool is_new;
+  gfx::StateTablePtr& copy = FindCopy(
+      &table, &current_->state_tables, &previous_->state_tables,
+      [this]() { return gfx::StateTablePtr(new (allocator_) gfx::StateTable); },
+      &is_new);
+  if (is_new)
+    copy->CopyFrom(table);
+  return copy;
+}
+
+const gfx::UniformBlockPtr& SceneSnapshot::CopyUniformBlock(
+    const gfx::UniformBlock& block) {
+  bool is_new;
+  gfx::UniformBlockPtr& copy = FindCopy(
+      &block, &current_->uniform_blocks, &previous_->uniform_blocks,
+      [this]() {
+        return gfx::UniformBlockPtr(new (allocator_) gfx::UniformBlock);
+      },
+      &is_new);
+  if (is_new) {
+    gfx::UniformBlock* b = copy.Get();
+    if (b->GetLabel() != block.GetLabel())
+      b->SetLabel(block.GetLabel());
+    b->SetBlockName(block.GetBlockName());
+    b->Enable(block.IsEnabled());
+    CopyUniforms(block, b);
+  }
+  return copy;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,136 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_SCENESNAPSHOT_H_
+#define ION_GFXUTILS_SCENESNAPSHOT_H_
+
+#include <memory>
+
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/uniformblock.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace gfxutils {
+
+// SceneSnapshot lets an application thread modify a scene while a render
+// thread draws it, without holding a lock around the scene for the whole
+// frame. Nodes, Shapes, StateTables and UniformBlocks must not be modified
+// while a Renderer draws them, so instead of drawing the application's scene,
+// the render thread draws a snapshot of it that the application thread never
+// modifies.
+//
+// Capture() copies the scene into one of three snapshots, the one that is
+// neither being drawn nor waiting to be drawn, and publishes it.
+// AcquireLatest() switches the render thread to the most recently published
+// snapshot. Neither thread ever waits for the other, except for a brief lock
+// while switching snapshots.
+//
+// Each snapshot keeps its copies from the last time it was captured and only
+// updates them, so that capturing an unchanged scene allocates nothing and
+// does not invalidate anything the Renderer derives from the structure of
+// the snapshot, such as retained DrawLists. Objects that appear in several
+// places in the scene are copied once, so the snapshot has the same sharing.
+// The Uniforms of Nodes and UniformBlocks are copied by value.
+//
+// ShaderPrograms, AttributeArrays, BufferObjects, Textures and other objects
+// that the Renderer uploads to OpenGL are shared with the scene rather than
+// copied. Their contents must still only be changed while they are not being
+// drawn, or replaced with new objects, which the next Capture() picks up.
+//
+// Typical usage:
+//   SceneSnapshot snapshot(allocator);
+//   ...
+//   // Application thread, after each simulation step:
+//   snapshot.Capture(root);
+//   ...
+//   // Render thread, every frame:
+//   renderer->DrawScene(snapshot.AcquireLatest());
+class ION_API SceneSnapshot {
+ public:
+  // The passed allocator is used for all allocations; if it is NULL, the
+  // default allocator is used.
+  explicit SceneSnapshot(const base::AllocatorPtr& allocator);
+  ~SceneSnapshot();
+
+  // Copies the scene rooted at root into a snapshot that is not being drawn
+  // and publishes it. This must be called on the thread that modifies the
+  // scene, and not concurrently with itself.
+  void Capture(const gfx::NodePtr& root);
+
+  // Returns the root of the most recently published snapshot, or of the
+  // snapshot returned by the previous call if nothing has been published since.
+  // Returns a NULL pointer if nothing has been captured yet. The snapshot does
+  // not change until the next call, after which it may be overwritten, so the
+  // render thread must not keep references into it. This must be called on
+  // the thread that draws, and not concurrently with itself.
+  const gfx::NodePtr AcquireLatest();
+
+  // Returns the number of Captures() so far.
+  size_t GetCaptureCount() const { return capture_count_; }
+
+ private:
+  // The copies of one snapshot, keyed by the objects they were copied from.
+  struct Copies {
+    explicit Copies(const base::AllocatorPtr& allocator);
+    base::AllocUnorderedMap<const gfx::Node*, gfx::NodePtr> nodes;
+    base::AllocUnorderedMap<const gfx::Shape*, gfx::ShapePtr> shapes;
+    base::AllocUnorderedMap<const gfx::StateTable*, gfx::StateTablePtr>
+        state_tables;
+    base::AllocUnorderedMap<const gfx::UniformBlock*, gfx::UniformBlockPtr>
+        uniform_blocks;
+    gfx::NodePtr root;
+
+    void Clear();
+  };
+  static const int kSnapshotCount = 3;
+
+  // Each of these returns the copy of the passed object in current_, taking
+  // it from previous_ if it was copied in the last capture of the snapshot
+  // and creating it otherwise, and updates it to match the object.
+  const gfx::NodePtr& CopyNode(const gfx::Node& node);
+  const gfx::ShapePtr& CopyShape(const gfx::Shape& shape);
+  const gfx::StateTablePtr& CopyStateTable(const gfx::StateTable& table);
+  const gfx::UniformBlockPtr& CopyUniformBlock(const gfx::UniformBlock& block);
+
+  base::AllocatorPtr allocator_;
+  std::unique_ptr<Copies> snapshots_[kSnapshotCount];
+  // Empty Copies that the next capture fills, which keep their capacity.
+  std::unique_ptr<Copies> spare_;
+  // While capturing, the copies being made and those from the last capture
+  // of the same snapshot, which are reused and then discarded.
+  Copies* current_;
+  Copies* previous_;
+  // The snapshot being drawn and the most recently published one, which may
+  // be the same. Both are -1 until the first capture.
+  int drawn_index_;
+  int published_index_;
+  size_t capture_count_;
+  port::Mutex mutex_;
+
+  DISALLOW_COPY_AND_ASSIGN(SceneSnapshot);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_SCENESNAPSHOT_H_
@@ -17,9 +17,14 @@ limitations under the License.
 
 #include "ion/gfxutils/shadermanager.h"
 
+#include <functional>
+#include <string>
+
 #include "ion/base/allocatable.h"
 #include "ion/base/lockguards.h"
 #include "ion/base/stlalloc/allocmap.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
+#include "ion/base/weakreferent.h"
 #include "ion/gfx/resourcemanager.h"
 #include "ion/gfx/shaderinputregistry.h"
 #include "ion/gfx/shaderprogram.h"
@@ -39,6 +44,8 @@ using gfx::ShaderPtr;
 using gfx::ShaderProgram;
 using gfx::ShaderProgramPtr;
 
+typedef base::WeakReferentPtr<Shader> ShaderWeakPtr;
+
 }  // anonymous namespace
 
 
@@ -58,10 +65,26 @@ class ShaderManager::ShaderManagerData : public base::Allocatable {
   };
   typedef base::AllocMap<std::string, ProgramInfo> ProgramMap;
 
+  // The shader stages that are managed.
+  enum Stage {
+    kVertexStage,
+    kFragmentStage
+  };
+
   explicit ShaderManagerData(const base::Allocatable& owner)
-      : programs_(owner) {}
+      : programs_(owner),
+        vertex_shaders_(owner),
+        fragment_shaders_(owner) {}
   ~ShaderManagerData() override {}
 
+  // Returns a live Shader of the given stage whose source is |source|, or
+  // creates one with the passed label if there is none.
+  const ShaderPtr GetOrCreateShader(Stage stage, const std::string& source,
+                                    const std::string& label) {
+    LockGuard guard(&mutex_);
+    return GetOrCreateShaderLocked(stage, source, label);
+  }
+
   // Adds a ProgramInfo to the map of infos.
   void AddProgramInfo(const std::string& name, const ProgramInfo& info) {
     LockGuard guard(&mutex_);
@@ -115,10 +138,8 @@ class ShaderManager::ShaderManagerData : public base::Allocatable {
         const ProgramInfo& info = it->second;
         DCHECK(program.Get());
 
-        if (Shader* shader = program->GetVertexShader().Get())
-          shader->SetSource(info.vertex_source_composer->GetSource());
-        if (Shader* shader = program->GetFragmentShader().Get())
-          shader->SetSource(info.fragment_source_composer->GetSource());
+        UpdateShader(program, kVertexStage, info.vertex_source_composer);
+        UpdateShader(program, kFragmentStage, info.fragment_source_composer);
         ++it;
       }
     }
@@ -131,11 +152,9 @@ class ShaderManager::ShaderManagerData : public base::Allocatable {
       if (program.Get()) {
         const ProgramInfo& info = it->second;
         if (info.vertex_source_composer->DependsOn(dependency))
-          if (Shader* shader = program->GetVertexShader().Get())
-            shader->SetSource(info.vertex_source_composer->GetSource());
+          UpdateShader(program, kVertexStage, info.vertex_source_composer);
         if (info.fragment_source_composer->DependsOn(dependency))
-          if (Shader* shader = program->GetFragmentShader().Get())
-            shader->SetSource(info.fragment_source_composer->GetSource());
+          UpdateShader(program, kFragmentStage, info.fragment_source_composer);
         ++it;
       }
     }
@@ -169,10 +188,120 @@ class ShaderManager::ShaderManagerData : public base::Allocatable {
     return program;
   }
 
+  // Maps the hashes of shader sources to the live shaders that have them.
+  typedef base::AllocUnorderedMap<size_t, ShaderWeakPtr> ShaderMap;
+
+  ShaderMap* GetShaderMap(Stage stage) {
+    return stage == kVertexStage ? &vertex_shaders_ : &fragment_shaders_;
+  }
+
+  static const ShaderPtr GetShader(const ShaderProgramPtr& program,
+                                   Stage stage) {
+    return stage == kVertexStage ? program->GetVertexShader()
+                                 : program->GetFragmentShader();
+  }
+
+  static void SetShader(const ShaderProgramPtr& program, Stage stage,
+                        const ShaderPtr& shader) {
+    if (stage == kVertexStage)
+      program->SetVertexShader(shader);
+    else
+      program->SetFragmentShader(shader);
+  }
+
+  // Returns the live shader of |stage| that has |source|, if there is one.
+  const ShaderPtr FindShaderLocked(Stage stage, const std::string& source) {
+    ShaderMap* shaders = GetShaderMap(stage);
+    ShaderMap::iterator it = shaders->find(std::hash<std::string>()(source));
+    ShaderPtr shader;
+    if (it != shaders->end()) {
+      shader = it->second.Acquire();
+      if (!shader.Get())
+        shaders->erase(it);
+      else if (shader->GetSource() != source)
+        shader.Reset(NULL);
+    }
+    return shader;
+  }
+
+  // Makes |shader| the one that is found for its current source, unless a
+  // different live shader with the same source hash is already registered.
+  void AddShaderLocked(Stage stage, const ShaderPtr& shader) {
+    ShaderWeakPtr& entry =
+        (*GetShaderMap(stage))[std::hash<std::string>()(shader->GetSource())];
+    if (!entry.Acquire().Get())
+      entry = ShaderWeakPtr(shader);
+  }
+
+  // Removes |shader| from the map if it is registered for |source|.
+  void RemoveShaderLocked(Stage stage, const Shader* shader,
+                          const std::string& source) {
+    ShaderMap* shaders = GetShaderMap(stage);
+    ShaderMap::iterator it = shaders->find(std::hash<std::string>()(source));
+    if (it != shaders->end() && it->second.Acquire().Get() == shader)
+      shaders->erase(it);
+  }
+
+  const ShaderPtr GetOrCreateShaderLocked(Stage stage,
+                                          const std::string& source,
+                                          const std::string& label) {
+    ShaderPtr shader = FindShaderLocked(stage, source);
+    if (!shader.Get()) {
+      shader.Reset(new(GetAllocatorForLifetime(base::kMediumTerm))
+                   Shader(source));
+      shader->SetLabel(label);
+      AddShaderLocked(stage, shader);
+    }
+    return shader;
+  }
+
+  // Returns the number of live programs that use |shader| for |stage|.
+  size_t CountShaderUsersLocked(Stage stage, const Shader* shader) {
+    size_t count = 0;
+    for (ProgramMap::iterator it = programs_.begin(); it != programs_.end();
+         ++it) {
+      const ShaderProgramPtr program = it->second.program.Acquire();
+      if (program.Get() && GetShader(program, stage).Get() == shader)
+        ++count;
+    }
+    return count;
+  }
+
+  // Recomposes the source of the |stage| shader of |program|. Nothing is done
+  // if the composed source is unchanged, so that the shader is not recompiled.
+  // Otherwise the program switches to a live shader that already has the new
+  // source, if there is one. If not, the shader is updated in place when no
+  // other program uses it, or replaced with a new shader when it is shared.
+  void UpdateShader(const ShaderProgramPtr& program, Stage stage,
+                    const ShaderSourceComposerPtr& composer) {
+    const ShaderPtr shader = GetShader(program, stage);
+    if (!shader.Get())
+      return;
+    const std::string source = composer->GetSource();
+    if (source == shader->GetSource())
+      return;
+    ShaderPtr new_shader = FindShaderLocked(stage, source);
+    if (!new_shader.Get()) {
+      if (CountShaderUsersLocked(stage, shader.Get()) <= 1U) {
+        RemoveShaderLocked(stage, shader.Get(), shader->GetSource());
+        shader->SetSource(source);
+        AddShaderLocked(stage, shader);
+        return;
+      }
+      new_shader = GetOrCreateShaderLocked(stage, source, shader->GetLabel());
+    }
+    SetShader(program, stage, new_shader);
+  }
+
   // All shader programs registered with the manager.
   ProgramMap programs_;
 
-  // For locking access to programs_.
+  // The live shaders created by the manager, for sharing shaders that have
+  // identical sources between programs.
+  ShaderMap vertex_shaders_;
+  ShaderMap fragment_shaders_;
+
+  // For locking access to programs_ and the shader maps.
   port::Mutex mutex_;
 };
 
@@ -190,14 +319,12 @@ const ShaderProgramPtr ShaderManager::CreateShaderProgram(
                            ion::gfx::ShaderProgram(registry));
   ShaderManagerData::ProgramInfo info(program);
   program->SetLabel(name);
-  program->SetVertexShader(
-      ShaderPtr(new(GetAllocatorForLifetime(base::kMediumTerm))
-                Shader(vertex_source_composer->GetSource())));
-  program->GetVertexShader()->SetLabel(name + " vertex shader");
-  program->SetFragmentShader(
-      ShaderPtr(new(GetAllocatorForLifetime(base::kMediumTerm))
-                Shader(fragment_source_composer->GetSource())));
-  program->GetFragmentShader()->SetLabel(name + " fragment shader");
+  program->SetVertexShader(data_->GetOrCreateShader(
+      ShaderManagerData::kVertexStage, vertex_source_composer->GetSource(),
+      name + " vertex shader"));
+  program->SetFragmentShader(data_->GetOrCreateShader(
+      ShaderManagerData::kFragmentStage, fragment_source_composer->GetSource(),
+      name + " fragment shader"));
   info.vertex_source_composer = vertex_source_composer;
   info.fragment_source_composer = fragment_source_composer;
   data_->AddProgramInfo(name, info);
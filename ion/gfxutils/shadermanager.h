@@ -40,7 +40,10 @@ class ION_API ShaderManager : public base::Referent {
   ShaderManager();
 
   // Creates and returns a ShaderProgram with the passed name using the passed
-  // composers and registry.
+  // composers and registry. If a live program created by the manager already
+  // has a shader of the same stage with an identical composed source, the new
+  // program shares that Shader, so it is compiled only once. A shared Shader
+  // keeps the label of the program it was created for.
   const gfx::ShaderProgramPtr CreateShaderProgram(
       const std::string& name, const ion::gfx::ShaderInputRegistryPtr& registry,
       const ShaderSourceComposerPtr& vertex_source_composer,
@@ -62,7 +65,13 @@ class ION_API ShaderManager : public base::Referent {
       ShaderSourceComposerPtr* vertex_source_composer,
       ShaderSourceComposerPtr* fragment_source_composer);
 
-  // Reconstructs all shaders from their composers.
+  // Reconstructs all shaders from their composers. Shaders whose composed
+  // sources are unchanged are left alone and are not recompiled. A shader that
+  // is shared with other programs is replaced rather than modified, so the
+  // other programs are not affected. If the programs are drawn by a Renderer
+  // with Renderer::kCompileShadersAsynchronously set, their previous versions
+  // are drawn with until the new shaders have been compiled and linked, rather
+  // than stalling the frame that draws them.
   void RecreateAllShaderPrograms();
 
   // Reconstructs all shaders that depend on the named dependency. The passed
@@ -21,6 +21,7 @@ limitations under the License.
 #include <sstream>
 #include <stack>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "ion/base/allocatable.h"
@@ -46,6 +47,11 @@ static const std::string GetZipAssetFileData(const std::string& filename) {
   return base::IsInvalidReference(data) ? std::string() : data;
 }
 
+static void PrefetchZipAssetFiles(const std::vector<std::string>& filenames) {
+  base::ZipAssetManager::PrefetchFiles(
+      filenames, base::ZipAssetManager::PrefetchCallback());
+}
+
 }  // anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -69,7 +75,9 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
         source_saver_(source_saver),
         source_time_(source_time),
         insert_line_directives_(insert_line_directives),
-        used_files_(owner) {
+        used_files_(owner),
+        file_cache_(owner),
+        has_composed_source_(false) {
     const size_t pos = filename_.rfind('/');
     if (pos != std::string::npos) {
       search_path_ = filename_.substr(0, pos);
@@ -81,6 +89,10 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
     base_path_ = path;
   }
 
+  void SetSourcePrefetcher(const SourcePrefetcher& prefetcher) {
+    source_prefetcher_ = prefetcher;
+  }
+
   const std::vector<std::string> GetChangedDependencies() {
     std::vector<std::string> changed;
     for (FileInfoMap::iterator it = used_files_.begin();
@@ -96,11 +108,19 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
   }
 
   const std::string GetSource() {
+    // If none of the files used by the last composition has changed then
+    // neither has the composed source.
+    const bool files_changed = UpdateCachedFiles();
+    if (has_composed_source_ && !files_changed)
+      return composed_source_;
+
     // Stack of inputs to process to avoid recursion and keep all of the
     // intermediate data in one place.
     std::stack<InputInfo> stack;
     // Set of files that have been loaded in the current input stack frame.
     std::set<std::string> file_names;
+    // Set of all files that were requested while composing the source.
+    std::set<std::string> requested_files;
     // The actual lines of shader source code.
     std::vector<std::string> output_source;
 
@@ -119,7 +139,7 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
       InputInfo info = stack.top();
       stack.pop();
       // If the info has no lines then the file has not been loaded.
-      if (info.lines.size() == 0) {
+      if (info.lines == nullptr) {
         // Check for a recursive $input.
         if (file_names.count(info.name) != 0) {
           LOG(WARNING) << stack.top().name << ":" << (stack.top().line - 1U)
@@ -128,23 +148,18 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
           continue;
         }
 
-        // Load the source of the shader.
-        const std::string source = source_loader_(info.name);
+        // Get the source of the shader, which is only loaded if it is not
+        // already cached.
+        requested_files.insert(info.name);
+        const CachedFile& file = GetCachedFile(info.name);
         // If the source does not exist or is empty then there is nothing to do.
-        if (source.empty())
+        if (file.source.empty())
           continue;
-
-        // Lines are counted from 1, so prepend an empty line.
-        info.lines.push_back("");
-        const std::vector<std::string> lines =
-            base::SplitStringWithoutSkipping(source, "\n");
-        info.lines.insert(info.lines.end(), lines.begin(), lines.end());
+        info.lines = &file.lines;
 
         // Mark this file as used so it will not be recursively included.
         file_names.insert(info.name);
-        std::chrono::system_clock::time_point timestamp;
-        source_time_(info.name, &timestamp);
-        used_files_[info.name] = FileInfo(timestamp);
+        used_files_[info.name] = FileInfo(file.timestamp);
 
         // Add the file name to the list of inputs if it isn't there.
         if (file_to_id_.count(info.name) == 0) {
@@ -174,8 +189,20 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
       }
     }
 
+    // Drop cached files that are no longer used. Since all lines have been
+    // copied to the output, no InputInfo refers to them anymore.
+    for (FileCache::iterator it = file_cache_.begin();
+         it != file_cache_.end();) {
+      if (requested_files.count(it->first))
+        ++it;
+      else
+        it = file_cache_.erase(it);
+    }
+
     // Cat lines together with newlines.
-    return base::JoinStrings(output_source, "\n");
+    composed_source_ = base::JoinStrings(output_source, "\n");
+    has_composed_source_ = true;
+    return composed_source_;
   }
 
   // Returns the source of the passed filename, if is a dependency of the
@@ -195,6 +222,10 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
     if (DependsOn(dependency)) {
       const bool ret = source_saver_(dependency, source);
       source_time_(dependency, &used_files_[dependency].timestamp);
+      // Make sure the next composition sees the new source, even if the
+      // modification time of the dependency has not changed.
+      file_cache_.erase(dependency);
+      has_composed_source_ = false;
       return ret;
     } else {
       return false;
@@ -230,9 +261,10 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
   // Helper struct that contains $input information found during file parsing.
   struct InputInfo {
     explicit InputInfo(const std::string& file_name)
-        : name(file_name), lines(), id(-1), line(-1) {}
+        : name(file_name), lines(nullptr), id(-1), line(-1) {}
     std::string name;
-    std::vector<std::string> lines;
+    // The lines of the file, owned by the file cache.
+    const std::vector<std::string>* lines;
     int id;
     size_t line;
   };
@@ -245,10 +277,97 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
     std::chrono::system_clock::time_point timestamp;
   };
 
+  // Helper struct that contains the source of a loaded file, split into lines,
+  // and the modification time it had when it was loaded, if it is known.
+  struct CachedFile {
+    CachedFile() : has_timestamp(false) {}
+    std::string source;
+    // Lines are counted from 1, so the first line is always empty.
+    std::vector<std::string> lines;
+    std::chrono::system_clock::time_point timestamp;
+    bool has_timestamp;
+  };
+
   // Mappings to and from file names and ids.
   typedef base::AllocMap<std::string, unsigned int> FileToIdMap;
   typedef base::AllocMap<unsigned int, std::string> IdToFileMap;
   typedef base::AllocMap<std::string, FileInfo> FileInfoMap;
+  typedef base::AllocMap<std::string, CachedFile> FileCache;
+
+  // Brings |file| up to date with the source of |name| and returns whether the
+  // source changed. The cached source is trusted without loading the file if
+  // the modification time function reports the same time as when it was
+  // cached. Otherwise the file is loaded and compared with the cached source,
+  // which keeps sources whose times are not known (or that were changed
+  // without changing their time) correct.
+  bool UpdateCachedFile(const std::string& name, CachedFile* file) {
+    std::chrono::system_clock::time_point timestamp;
+    const bool has_timestamp = source_time_(name, &timestamp);
+    if (has_timestamp && file->has_timestamp && timestamp == file->timestamp)
+      return false;
+    file->has_timestamp = has_timestamp;
+    file->timestamp = timestamp;
+    std::string source = source_loader_(name);
+    if (!file->lines.empty() && source == file->source)
+      return false;
+    file->source.swap(source);
+    file->lines.assign(1U, std::string());
+    const std::vector<std::string> lines =
+        base::SplitStringWithoutSkipping(file->source, "\n");
+    file->lines.insert(file->lines.end(), lines.begin(), lines.end());
+    return true;
+  }
+
+  // Updates all cached files and returns whether any of them changed.
+  bool UpdateCachedFiles() {
+    bool changed = false;
+    for (FileCache::iterator it = file_cache_.begin(); it != file_cache_.end();
+         ++it) {
+      if (UpdateCachedFile(it->first, &it->second))
+        changed = true;
+    }
+    return changed;
+  }
+
+  // Returns the cached file for |name|, loading it if it is not yet cached.
+  // Files that are already cached have been updated by UpdateCachedFiles()
+  // before the composition started.
+  const CachedFile& GetCachedFile(const std::string& name) {
+    FileCache::iterator it = file_cache_.find(name);
+    if (it == file_cache_.end()) {
+      it = file_cache_.insert(std::make_pair(name, CachedFile())).first;
+      UpdateCachedFile(name, &it->second);
+      PrefetchInputs(it->second);
+    }
+    return it->second;
+  }
+
+  // Passes the files that |file| $inputs and that are not cached to the
+  // prefetcher, if there is one.
+  void PrefetchInputs(const CachedFile& file) {
+    if (!source_prefetcher_)
+      return;
+    std::vector<std::string> names;
+    for (const std::string& line : file.lines) {
+      const std::string trimmed = base::TrimStartAndEndWhitespace(line);
+      if (base::StartsWith(trimmed, "$input")) {
+        const std::string name = BuildFilename(GetInputName(trimmed));
+        if (!name.empty() && !file_cache_.count(name))
+          names.push_back(name);
+      }
+    }
+    if (!names.empty())
+      source_prefetcher_(names);
+  }
+
+  // Returns the file name of a trimmed $input directive. The file must be
+  // contained within double quotes, e.g. a standard C-like include statement
+  // of an ASCII filename.
+  static const std::string GetInputName(const std::string& trimmed) {
+    const size_t start_pos = trimmed.find("\"") + 1;
+    const size_t end_pos = trimmed.find_last_of("\"");
+    return trimmed.substr(start_pos, end_pos - start_pos);
+  }
 
   // Uses the base and search paths to construct a filename.
   const std::string BuildFilename(const std::string& filename) {
@@ -273,18 +392,12 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
   bool ParseInputLines(std::stack<InputInfo>* stack, InputInfo* info,
                        std::vector<std::string>* output_lines) {
     // Parse all lines of the $input.
-    for (; info->line < info->lines.size(); ++info->line) {
+    for (; info->line < info->lines->size(); ++info->line) {
       const std::string trimmed =
-          base::TrimStartAndEndWhitespace(info->lines[info->line]);
+          base::TrimStartAndEndWhitespace((*info->lines)[info->line]);
       if (base::StartsWith(trimmed, "$input")) {
-        // Get the file name to include and try to get its source. The file must
-        // be contained within double quotes, e.g. a standard C-like include
-        // statement of an ASCII filename.
-        const size_t start_pos = trimmed.find("\"") + 1;
-        const size_t end_pos = trimmed.find_last_of("\"");
-        const std::string input_file =
-            trimmed.substr(start_pos, end_pos - start_pos);
-        const InputInfo new_info(BuildFilename(input_file));
+        // Get the file name to include and try to get its source.
+        const InputInfo new_info(BuildFilename(GetInputName(trimmed)));
         if (new_info.name.empty()) {
           // We could not get the $input name, perhaps the file is missing a
           // closing ".
@@ -302,7 +415,7 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
         }
       } else {
         // No $input, so simply add this line to the source.
-        output_lines->push_back(info->lines[info->line]);
+        output_lines->push_back((*info->lines)[info->line]);
         if (insert_line_directives_) {
           // Add an extra #line directive in case an $input was wrapped in a
           // #define. GLSL compilers typically ignore #line directives enclosed
@@ -335,11 +448,18 @@ class IncludeComposer::IncludeComposerHelper : public base::Allocatable {
   SourceSaver source_saver_;
   // A function that returns the last time a dependency was modified.
   SourceModificationTime source_time_;
+  // An optional function that prefetches the files a loaded file $inputs.
+  SourcePrefetcher source_prefetcher_;
   // Whether to insert #line directives when an $input directive is found.
   bool insert_line_directives_;
   // The set of filenames that this shader depends on, and information about
   // them.
   FileInfoMap used_files_;
+  // The sources of all files requested by the last composition.
+  FileCache file_cache_;
+  // The result of the last composition, and whether there was one.
+  std::string composed_source_;
+  bool has_composed_source_;
 };
 
 //-----------------------------------------------------------------------------
@@ -369,6 +489,10 @@ void IncludeComposer::SetBasePath(const std::string& path) {
   helper_->SetBasePath(path);
 }
 
+void IncludeComposer::SetSourcePrefetcher(const SourcePrefetcher& prefetcher) {
+  helper_->SetSourcePrefetcher(prefetcher);
+}
+
 const std::vector<std::string> IncludeComposer::GetChangedDependencies() {
   return helper_->GetChangedDependencies();
 }
@@ -409,7 +533,10 @@ ZipAssetComposer::ZipAssetComposer(const std::string& filename,
     : IncludeComposer(filename, GetZipAssetFileData,
                       SetAndSaveZipAssetData,
                       base::ZipAssetManager::UpdateFileIfChanged,
-                      insert_line_directives) {}
+                      insert_line_directives) {
+  SetSourcePrefetcher(PrefetchZipAssetFiles);
+  PrefetchZipAssetFiles(std::vector<std::string>(1U, filename));
+}
 
 ZipAssetComposer::~ZipAssetComposer() {}
 
@@ -165,6 +165,10 @@ class ION_API IncludeComposer : public ShaderSourceComposer {
   typedef std::function<bool(const std::string& filename,
                              std::chrono::system_clock::time_point* timestamp)>
       SourceModificationTime;
+  // A function that starts loading the passed sources in the background, so
+  // that the SourceLoader returns them faster.
+  typedef std::function<void(const std::vector<std::string>& names)>
+      SourcePrefetcher;
 
   // The constructor requires a base filename that represents the top-level
   // file, functions for loading, saving, and seeing if sources have changed,
@@ -178,6 +182,9 @@ class ION_API IncludeComposer : public ShaderSourceComposer {
   // Sets a path that will be prepended to all files (including the top-level
   // filename) loaded by this composer.
   void SetBasePath(const std::string& path);
+  // Sets a function that is called with the files that a file $inputs when the
+  // file is loaded, before they are loaded in turn.
+  void SetSourcePrefetcher(const SourcePrefetcher& prefetcher);
 
   const std::string GetSource() override;
   bool DependsOn(const std::string& dependency) const override;
@@ -202,7 +209,9 @@ typedef base::ReferentPtr<IncludeComposer>::Type IncludeComposerPtr;
 //-----------------------------------------------------------------------------
 //
 // Loads a shader source from zip asset resources that may $input other zip
-// assets.
+// assets. The top-level file is prefetched when the composer is constructed,
+// and $input files are prefetched together when the file that $inputs them is
+// loaded, so that they are decompressed in parallel.
 //
 //-----------------------------------------------------------------------------
 class ION_API ZipAssetComposer : public IncludeComposer {
@@ -0,0 +1,322 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#include "ion/gfxutils/shadervariants.h"
+
+#include <set>
+#include <sstream>
+
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using base::LockGuard;
+using gfx::ShaderProgramPtr;
+
+// Composer that inserts #define directives into the source of another
+// composer, after its #version directive if it has one. All dependency
+// queries are forwarded to the other composer.
+class DefinesComposer : public ShaderSourceComposer {
+ public:
+  DefinesComposer(const ShaderSourceComposerPtr& composer,
+                  const std::string& defines)
+      : composer_(composer),
+        defines_(defines) {}
+
+  const std::string GetSource() override {
+    const std::string source = composer_->GetSource();
+    if (defines_.empty())
+      return source;
+
+    // Find the end of the #version line, if the first non-blank line is one.
+    size_t insert_pos = 0;
+    size_t line = 1U;
+    size_t pos = source.find_first_not_of(" \t\r\n");
+    if (pos != std::string::npos &&
+        source.compare(pos, 8, "#version") == 0) {
+      const size_t end_pos = source.find('\n', pos);
+      insert_pos = end_pos == std::string::npos ? source.length() : end_pos + 1;
+      for (size_t i = 0; i < insert_pos; ++i) {
+        if (source[i] == '\n')
+          ++line;
+      }
+    }
+
+    std::ostringstream str;
+    str << source.substr(0, insert_pos);
+    if (insert_pos && source[insert_pos - 1] != '\n')
+      str << "\n";
+    str << defines_ << "#line " << line << "\n" << source.substr(insert_pos);
+    return str.str();
+  }
+  bool DependsOn(const std::string& dependency) const override {
+    return composer_->DependsOn(dependency);
+  }
+  const std::string GetDependencySource(
+      const std::string& dependency) const override {
+    return composer_->GetDependencySource(dependency);
+  }
+  bool SetDependencySource(const std::string& dependency,
+                           const std::string& source) override {
+    return composer_->SetDependencySource(dependency, source);
+  }
+  const std::string GetDependencyName(unsigned int id) const override {
+    return composer_->GetDependencyName(id);
+  }
+  const std::vector<std::string> GetDependencyNames() const override {
+    return composer_->GetDependencyNames();
+  }
+  const std::vector<std::string> GetChangedDependencies() override {
+    return composer_->GetChangedDependencies();
+  }
+
+ protected:
+  // The destructor is protected since this is derived from base::Referent.
+  ~DefinesComposer() override {}
+
+ private:
+  ShaderSourceComposerPtr composer_;
+  std::string defines_;
+};
+
+// Returns the number of bits needed to store |value_count| distinct values.
+static uint32 GetBitCount(size_t value_count) {
+  uint32 bits = 1U;
+  while ((static_cast<size_t>(1) << bits) < value_count)
+    ++bits;
+  return bits;
+}
+
+}  // anonymous namespace
+
+ShaderVariants::ShaderVariants(
+    const ShaderManagerPtr& manager, const std::string& name,
+    const gfx::ShaderInputRegistryPtr& registry,
+    const ShaderSourceComposerPtr& vertex_source_composer,
+    const ShaderSourceComposerPtr& fragment_source_composer)
+    : manager_(manager),
+      name_(name),
+      registry_(registry),
+      vertex_source_composer_(vertex_source_composer),
+      fragment_source_composer_(fragment_source_composer),
+      features_(*this),
+      used_bits_(0U),
+      variants_(*this) {
+  DCHECK(manager_.Get());
+  DCHECK(vertex_source_composer_.Get());
+  DCHECK(fragment_source_composer_.Get());
+}
+
+ShaderVariants::~ShaderVariants() {}
+
+bool ShaderVariants::AddFeature(const std::string& name) {
+  return AddFeatureWithValues(name, std::vector<std::string>());
+}
+
+bool ShaderVariants::AddFeature(const std::string& name,
+                                const std::vector<std::string>& values) {
+  std::set<std::string> unique_values;
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (values[i].empty() || !unique_values.insert(values[i]).second) {
+      LOG(ERROR) << "Shader variants \"" << name_ << "\": feature \"" << name
+                 << "\" has an empty or duplicate value.";
+      return false;
+    }
+  }
+  if (values.size() < 2U) {
+    LOG(ERROR) << "Shader variants \"" << name_ << "\": feature \"" << name
+               << "\" needs at least two values.";
+    return false;
+  }
+  return AddFeatureWithValues(name, values);
+}
+
+bool ShaderVariants::AddFeatureWithValues(
+    const std::string& name, const std::vector<std::string>& values) {
+  LockGuard guard(&mutex_);
+  if (!variants_.empty()) {
+    LOG(ERROR) << "Shader variants \"" << name_ << "\": cannot add feature \""
+               << name << "\" after variants have been created.";
+    return false;
+  }
+  if (name.empty() || FindFeature(name)) {
+    LOG(ERROR) << "Shader variants \"" << name_ << "\": feature name \""
+               << name << "\" is empty or already used.";
+    return false;
+  }
+  const uint32 bits = GetBitCount(values.size());
+  if (used_bits_ + bits > 64U) {
+    LOG(ERROR) << "Shader variants \"" << name_ << "\": too many features to"
+               << " add \"" << name << "\".";
+    return false;
+  }
+
+  Feature feature;
+  feature.name = name;
+  feature.values = values;
+  feature.shift = used_bits_;
+  feature.mask = ((static_cast<Key>(1) << bits) - 1U) << used_bits_;
+  features_.push_back(feature);
+  used_bits_ += bits;
+  return true;
+}
+
+ShaderVariants::Key ShaderVariants::SetFeature(
+    Key key, const std::string& feature, bool enabled) const {
+  LockGuard guard(&mutex_);
+  const Feature* info = FindFeature(feature);
+  if (!info || !info->values.empty()) {
+    LOG(ERROR) << "Shader variants \"" << name_
+               << "\" have no boolean feature \"" << feature << "\".";
+    return key;
+  }
+  return enabled ? key | info->mask : key & ~info->mask;
+}
+
+ShaderVariants::Key ShaderVariants::SetFeature(
+    Key key, const std::string& feature, const std::string& value) const {
+  LockGuard guard(&mutex_);
+  const Feature* info = FindFeature(feature);
+  if (info) {
+    for (size_t i = 0; i < info->values.size(); ++i) {
+      if (info->values[i] == value)
+        return (key & ~info->mask) | (static_cast<Key>(i) << info->shift);
+    }
+  }
+  LOG(ERROR) << "Shader variants \"" << name_ << "\" have no feature \""
+             << feature << "\" with value \"" << value << "\".";
+  return key;
+}
+
+const std::string ShaderVariants::GetDefines(Key key) const {
+  LockGuard guard(&mutex_);
+  std::ostringstream str;
+  for (size_t i = 0; i < features_.size(); ++i) {
+    const Feature& feature = features_[i];
+    const Key value = (key & feature.mask) >> feature.shift;
+    if (feature.values.empty()) {
+      if (value)
+        str << "#define " << feature.name << " 1\n";
+    } else {
+      for (size_t j = 0; j < feature.values.size(); ++j)
+        str << "#define " << feature.name << "_" << feature.values[j] << " "
+            << j << "\n";
+      str << "#define " << feature.name << " " << value << "\n";
+    }
+  }
+  return str.str();
+}
+
+const ShaderProgramPtr ShaderVariants::GetShaderProgram(Key key) {
+  {
+    LockGuard guard(&mutex_);
+    VariantMap::const_iterator it = variants_.find(key);
+    if (it != variants_.end())
+      return it->second;
+    if (!IsValidKey(key)) {
+      LOG(ERROR) << "Shader variants \"" << name_ << "\": invalid key "
+                 << key << ".";
+      return ShaderProgramPtr();
+    }
+  }
+
+  // The composers are created outside of the lock since GetDefines() and
+  // GetVariantName() acquire it.
+  const std::string defines = GetDefines(key);
+  const std::string name = GetVariantName(key);
+  ShaderSourceComposerPtr vertex_composer(
+      new(GetAllocator()) DefinesComposer(vertex_source_composer_, defines));
+  ShaderSourceComposerPtr fragment_composer(
+      new(GetAllocator()) DefinesComposer(fragment_source_composer_, defines));
+
+  LockGuard guard(&mutex_);
+  // Another thread may have created the variant in the meantime.
+  ShaderProgramPtr& program = variants_[key];
+  if (!program.Get())
+    program = manager_->CreateShaderProgram(name, registry_, vertex_composer,
+                                            fragment_composer);
+  return program;
+}
+
+size_t ShaderVariants::GetVariantCount() const {
+  LockGuard guard(&mutex_);
+  return variants_.size();
+}
+
+size_t ShaderVariants::ReleaseUnusedVariants() {
+  LockGuard guard(&mutex_);
+  size_t count = 0;
+  for (VariantMap::iterator it = variants_.begin(); it != variants_.end();) {
+    if (it->second->GetRefCount() == 1) {
+      it = variants_.erase(it);
+      ++count;
+    } else {
+      ++it;
+    }
+  }
+  return count;
+}
+
+const ShaderVariants::Feature* ShaderVariants::FindFeature(
+    const std::string& name) const {
+  for (size_t i = 0; i < features_.size(); ++i) {
+    if (features_[i].name == name)
+      return &features_[i];
+  }
+  return NULL;
+}
+
+bool ShaderVariants::IsValidKey(Key key) const {
+  if (used_bits_ < 64U && (key >> used_bits_) != 0U)
+    return false;
+  for (size_t i = 0; i < features_.size(); ++i) {
+    const Feature& feature = features_[i];
+    if (!feature.values.empty() &&
+        ((key & feature.mask) >> feature.shift) >= feature.values.size())
+      return false;
+  }
+  return true;
+}
+
+const std::string ShaderVariants::GetVariantName(Key key) const {
+  LockGuard guard(&mutex_);
+  std::ostringstream str;
+  str << name_ << "[";
+  bool is_first = true;
+  for (size_t i = 0; i < features_.size(); ++i) {
+    const Feature& feature = features_[i];
+    const Key value = (key & feature.mask) >> feature.shift;
+    if (!value)
+      continue;
+    if (!is_first)
+      str << ",";
+    is_first = false;
+    str << feature.name;
+    if (!feature.values.empty())
+      str << "=" << feature.values[static_cast<size_t>(value)];
+  }
+  str << "]";
+  return str.str();
+}
+
+}  // namespace gfxutils
+}  // namespace ion
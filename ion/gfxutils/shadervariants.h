@@ -0,0 +1,163 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#ifndef ION_GFXUTILS_SHADERVARIANTS_H_
+#define ION_GFXUTILS_SHADERVARIANTS_H_
+
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/referent.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfxutils/shadermanager.h"
+#include "ion/gfxutils/shadersourcecomposer.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace gfxutils {
+
+// ShaderVariants creates the variants (permutations) of a shader program from
+// a single pair of vertex and fragment composers and a set of features. A
+// feature is either boolean, in which case enabled variants #define its name
+// as 1, or takes one of a list of values, in which case variants #define its
+// name as the index of the value, and <name>_<value> as the index of each
+// value, so that shaders can test, e.g., "#if LIGHTING == LIGHTING_PHONG".
+// The #defines are inserted after any #version directive, followed by a #line
+// directive so that line numbers are unchanged.
+//
+// A variant is identified by a Key that holds the values of all features;
+// features that are not set in a Key are disabled or have their first value.
+// Variant programs are only created the first time they are requested, and are
+// cached by their keys. They are created through the ShaderManager, so they
+// can be recreated like any other program, and their shaders are compiled (or
+// loaded from a program binary cache) by the Renderer when they are first
+// drawn. Variant programs are named "<name>[<features>]", where <features>
+// lists the enabled boolean features and "<feature>=<value>" for features that
+// do not have their first value.
+//
+// For example:
+//   ShaderVariantsPtr variants(new ShaderVariants(
+//       manager, "material", registry, vertex_composer, fragment_composer));
+//   variants->AddFeature("SKINNED");
+//   variants->AddFeature("LIGHTING", {"NONE", "LAMBERT", "PHONG"});
+//   ShaderVariants::Key key = variants->SetFeature(0, "SKINNED", true);
+//   key = variants->SetFeature(key, "LIGHTING", "PHONG");
+//   node->SetShaderProgram(variants->GetShaderProgram(key));
+class ION_API ShaderVariants : public base::Referent {
+ public:
+  // The features of a variant packed into an integer. Each feature uses as
+  // many bits as are needed to store its value.
+  typedef uint64 Key;
+
+  ShaderVariants(const ShaderManagerPtr& manager, const std::string& name,
+                 const gfx::ShaderInputRegistryPtr& registry,
+                 const ShaderSourceComposerPtr& vertex_source_composer,
+                 const ShaderSourceComposerPtr& fragment_source_composer);
+
+  // Adds a boolean feature. Returns false and logs an error if |name| is empty
+  // or already used, if there are not enough bits left in a Key, or if
+  // variants have already been created.
+  bool AddFeature(const std::string& name);
+  // Adds a feature that takes one of |values|, which must contain at least two
+  // distinct, non-empty names. Returns false and logs an error in the same
+  // cases as above or if |values| is invalid.
+  bool AddFeature(const std::string& name,
+                  const std::vector<std::string>& values);
+
+  // Returns |key| with the boolean feature |feature| enabled or disabled. Logs
+  // an error and returns |key| unchanged if there is no such boolean feature.
+  Key SetFeature(Key key, const std::string& feature, bool enabled) const;
+  // Returns |key| with |feature| set to |value|. Logs an error and returns
+  // |key| unchanged if there is no such feature or it has no such value.
+  Key SetFeature(Key key, const std::string& feature,
+                 const std::string& value) const;
+  // Keeps string literal values from being converted to bool.
+  Key SetFeature(Key key, const std::string& feature,
+                 const char* value) const {
+    return SetFeature(key, feature, std::string(value));
+  }
+
+  // Returns the #define directives for the variant identified by |key|.
+  const std::string GetDefines(Key key) const;
+
+  // Returns the program of the variant identified by |key|, creating it the
+  // first time it is requested. Returns a NULL pointer and logs an error if
+  // |key| contains invalid feature values.
+  const gfx::ShaderProgramPtr GetShaderProgram(Key key);
+
+  // Returns the number of variant programs that have been created and not
+  // released.
+  size_t GetVariantCount() const;
+
+  // Releases the cached programs that are not referenced anywhere else, e.g.,
+  // by Nodes, and returns how many were released. They are created again if
+  // they are requested later.
+  size_t ReleaseUnusedVariants();
+
+ private:
+  // Information about a single feature.
+  struct Feature {
+    std::string name;
+    // The values of the feature, or empty for boolean features.
+    std::vector<std::string> values;
+    // The position and mask of the bits holding the feature's value in a Key.
+    uint32 shift;
+    Key mask;
+  };
+  typedef base::AllocUnorderedMap<Key, gfx::ShaderProgramPtr> VariantMap;
+
+  // The destructor is private because this is derived from base::Referent.
+  ~ShaderVariants() override;
+
+  // Adds a feature with values that have already been checked. Boolean
+  // features have no values.
+  bool AddFeatureWithValues(const std::string& name,
+                            const std::vector<std::string>& values);
+  // Returns the feature called |name|, or NULL if there is none.
+  const Feature* FindFeature(const std::string& name) const;
+  // Returns whether all feature values in |key| are valid.
+  bool IsValidKey(Key key) const;
+  // Returns the program name of the variant identified by |key|.
+  const std::string GetVariantName(Key key) const;
+
+  ShaderManagerPtr manager_;
+  std::string name_;
+  gfx::ShaderInputRegistryPtr registry_;
+  ShaderSourceComposerPtr vertex_source_composer_;
+  ShaderSourceComposerPtr fragment_source_composer_;
+  base::AllocVector<Feature> features_;
+  // The number of Key bits used by the features.
+  uint32 used_bits_;
+  VariantMap variants_;
+  // Protects access to features_ and variants_.
+  mutable port::Mutex mutex_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShaderVariants);
+};
+
+typedef base::ReferentPtr<ShaderVariants>::Type ShaderVariantsPtr;
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_SHADERVARIANTS_H_
@@ -18,6 +18,14 @@ limitations under the License.
 #include "ion/gfxutils/shapeutils.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "base/integral_types.h"
 #include "ion/base/allocationmanager.h"
@@ -25,14 +33,19 @@ limitations under the License.
 #include "ion/base/invalid.h"
 #include "ion/base/logging.h"
 #include "ion/base/scopedallocation.h"
+#include "ion/base/stlalloc/allocunorderedmap.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/taskscheduler.h"
 #include "ion/base/zipassetmanager.h"
 #include "ion/gfx/attributearray.h"
 #include "ion/gfx/shaderinputregistry.h"
 #include "ion/gfxutils/buffertoattributebinder.h"
 #include "ion/math/angle.h"
+#include "ion/math/fastmath.h"
 #include "ion/math/matrixutils.h"
 #include "ion/math/range.h"
 #include "ion/math/vectorutils.h"
+#include "ion/port/memorymappedfile.h"
 #include "third_party/openctm/files/tools/3ds.h"
 #include "third_party/openctm/files/tools/dae.h"
 #include "third_party/openctm/files/tools/lwo.h"
@@ -90,6 +103,27 @@ struct VertexPTN {
   Vector3f normal;
 };
 
+// Compact versions of the above, used for ShapeSpec::kCompactVertices.
+struct CompactVertexP {
+  math::Vector4i16 position;
+};
+
+struct CompactVertexPT {
+  math::Vector4i16 position;
+  math::Vector2ui16 texture_coords;
+};
+
+struct CompactVertexPN {
+  math::Vector4i16 position;
+  math::Vector4i8 normal;
+};
+
+struct CompactVertexPTN {
+  math::Vector4i16 position;
+  math::Vector2ui16 texture_coords;
+  math::Vector4i8 normal;
+};
+
 //-----------------------------------------------------------------------------
 //
 // The templated CompactVertices function is used to convert an array of
@@ -134,6 +168,103 @@ void CompactVertices<VertexPN>(size_t count, const VertexPTN vertices_in[],
   }
 }
 
+//-----------------------------------------------------------------------------
+//
+// The templated QuantizeVertices function is used to convert an array of
+// vertices of type VertexPTN to one of the compact types. Positions are
+// multiplied by inverse_scale first.
+//
+//-----------------------------------------------------------------------------
+
+// Returns |value| clamped to [-1, 1] for signed T and [0, 1] for unsigned T as
+// a normalized fixed-point value.
+template <typename T>
+static T Normalize(float value) {
+  const float min_value = std::numeric_limits<T>::is_signed ? -1.f : 0.f;
+  const float clamped = std::min(1.f, std::max(min_value, value));
+  return static_cast<T>(std::floor(
+      clamped * static_cast<float>(std::numeric_limits<T>::max()) + 0.5f));
+}
+
+static const math::Vector4i16 QuantizePosition(const Point3f& position,
+                                               float inverse_scale) {
+  return math::Vector4i16(Normalize<int16>(position[0] * inverse_scale),
+                          Normalize<int16>(position[1] * inverse_scale),
+                          Normalize<int16>(position[2] * inverse_scale),
+                          std::numeric_limits<int16>::max());
+}
+
+static const math::Vector2ui16 QuantizeTexCoords(const Point2f& tex_coords) {
+  return math::Vector2ui16(Normalize<uint16>(tex_coords[0]),
+                           Normalize<uint16>(tex_coords[1]));
+}
+
+static const math::Vector4i8 QuantizeNormal(const Vector3f& normal) {
+  return math::Vector4i8(Normalize<int8>(normal[0]), Normalize<int8>(normal[1]),
+                         Normalize<int8>(normal[2]), 0);
+}
+
+template <typename VertexType>
+static void QuantizeVertices(size_t count, const VertexPTN vertices_in[],
+                             float inverse_scale, VertexType vertices_out[]) {
+#if !defined(ION_COVERAGE)  // COV_NF_START
+  DCHECK(false) << "Unspecialized QuantizeVertices called";
+#endif  // COV_NF_END
+}
+
+// Specialize for CompactVertexP.
+template <>
+void QuantizeVertices<CompactVertexP>(size_t count,
+                                      const VertexPTN vertices_in[],
+                                      float inverse_scale,
+                                      CompactVertexP vertices_out[]) {
+  for (size_t i = 0; i < count; ++i)
+    vertices_out[i].position =
+        QuantizePosition(vertices_in[i].position, inverse_scale);
+}
+
+// Specialize for CompactVertexPT.
+template <>
+void QuantizeVertices<CompactVertexPT>(size_t count,
+                                       const VertexPTN vertices_in[],
+                                       float inverse_scale,
+                                       CompactVertexPT vertices_out[]) {
+  for (size_t i = 0; i < count; ++i) {
+    vertices_out[i].position =
+        QuantizePosition(vertices_in[i].position, inverse_scale);
+    vertices_out[i].texture_coords =
+        QuantizeTexCoords(vertices_in[i].texture_coords);
+  }
+}
+
+// Specialize for CompactVertexPN.
+template <>
+void QuantizeVertices<CompactVertexPN>(size_t count,
+                                       const VertexPTN vertices_in[],
+                                       float inverse_scale,
+                                       CompactVertexPN vertices_out[]) {
+  for (size_t i = 0; i < count; ++i) {
+    vertices_out[i].position =
+        QuantizePosition(vertices_in[i].position, inverse_scale);
+    vertices_out[i].normal = QuantizeNormal(vertices_in[i].normal);
+  }
+}
+
+// Specialize for CompactVertexPTN.
+template <>
+void QuantizeVertices<CompactVertexPTN>(size_t count,
+                                        const VertexPTN vertices_in[],
+                                        float inverse_scale,
+                                        CompactVertexPTN vertices_out[]) {
+  for (size_t i = 0; i < count; ++i) {
+    vertices_out[i].position =
+        QuantizePosition(vertices_in[i].position, inverse_scale);
+    vertices_out[i].texture_coords =
+        QuantizeTexCoords(vertices_in[i].texture_coords);
+    vertices_out[i].normal = QuantizeNormal(vertices_in[i].normal);
+  }
+}
+
 //-----------------------------------------------------------------------------
 //
 // The templated BindVertices function uses a BufferToAttributeBinder for the
@@ -197,6 +328,58 @@ void BindVertices<VertexPTN>(const gfx::AttributeArrayPtr& attribute_array,
              attribute_array, buffer_object);
 }
 
+// Specialize for CompactVertexP.
+template <>
+void BindVertices<CompactVertexP>(
+    const gfx::AttributeArrayPtr& attribute_array,
+    const gfx::BufferObjectPtr& buffer_object) {
+  CompactVertexP v;
+  BufferToAttributeBinder<CompactVertexP>(v)
+      .BindAndNormalize(v.position, "aVertex")
+      .Apply(gfx::ShaderInputRegistry::GetGlobalRegistry(),
+             attribute_array, buffer_object);
+}
+
+// Specialize for CompactVertexPT.
+template <>
+void BindVertices<CompactVertexPT>(
+    const gfx::AttributeArrayPtr& attribute_array,
+    const gfx::BufferObjectPtr& buffer_object) {
+  CompactVertexPT v;
+  BufferToAttributeBinder<CompactVertexPT>(v)
+      .BindAndNormalize(v.position, "aVertex")
+      .BindAndNormalize(v.texture_coords, "aTexCoords")
+      .Apply(gfx::ShaderInputRegistry::GetGlobalRegistry(),
+             attribute_array, buffer_object);
+}
+
+// Specialize for CompactVertexPN.
+template <>
+void BindVertices<CompactVertexPN>(
+    const gfx::AttributeArrayPtr& attribute_array,
+    const gfx::BufferObjectPtr& buffer_object) {
+  CompactVertexPN v;
+  BufferToAttributeBinder<CompactVertexPN>(v)
+      .BindAndNormalize(v.position, "aVertex")
+      .BindAndNormalize(v.normal, "aNormal")
+      .Apply(gfx::ShaderInputRegistry::GetGlobalRegistry(),
+             attribute_array, buffer_object);
+}
+
+// Specialize for CompactVertexPTN.
+template <>
+void BindVertices<CompactVertexPTN>(
+    const gfx::AttributeArrayPtr& attribute_array,
+    const gfx::BufferObjectPtr& buffer_object) {
+  CompactVertexPTN v;
+  BufferToAttributeBinder<CompactVertexPTN>(v)
+      .BindAndNormalize(v.position, "aVertex")
+      .BindAndNormalize(v.texture_coords, "aTexCoords")
+      .BindAndNormalize(v.normal, "aNormal")
+      .Apply(gfx::ShaderInputRegistry::GetGlobalRegistry(),
+             attribute_array, buffer_object);
+}
+
 //-----------------------------------------------------------------------------
 //
 // Generic helper functions.
@@ -238,6 +421,17 @@ const base::DataContainerPtr CompactVerticesIntoDataContainer(
   return sa.TransferToDataContainer(is_wipeable);
 }
 
+// Same as CompactVerticesIntoDataContainer(), but quantizes the vertices into
+// one of the compact vertex types.
+template <typename VertexType>
+const base::DataContainerPtr QuantizeVerticesIntoDataContainer(
+    const base::AllocatorPtr& allocator, size_t count, bool is_wipeable,
+    float inverse_scale, const VertexPTN vertices[]) {
+  base::ScopedAllocation<VertexType> sa(allocator, count);
+  QuantizeVertices<VertexType>(count, vertices, inverse_scale, sa.Get());
+  return sa.TransferToDataContainer(is_wipeable);
+}
+
 // Returns true if data in a DataContainer should be wipeable, according to a
 // ShapeSpec.
 static bool IsWipeable(const ShapeSpec& spec) {
@@ -258,12 +452,31 @@ static bool HasNormals(const ShapeSpec& spec) {
 }
 
 // Builds and returns an AttributeArray with the given vertex BufferObject
-// bound to it. The vertex_type in the ShapeSpec is used to determine how to
-// bind the vertices. The Allocator in the spec is used for all allocations.
+// bound to it. The vertex_type and vertex_format in the ShapeSpec are used to
+// determine how to bind the vertices. The Allocator in the spec is used for
+// all allocations.
 static const gfx::AttributeArrayPtr BuildAttributeArray(
     const ShapeSpec& spec, const gfx::BufferObjectPtr& buffer_object) {
   gfx::AttributeArrayPtr attribute_array(
       new(spec.allocator) gfx::AttributeArray);
+  if (spec.vertex_format == ShapeSpec::kCompactVertices) {
+    switch (spec.vertex_type) {
+      case ShapeSpec::kPosition:
+        BindVertices<CompactVertexP>(attribute_array, buffer_object);
+        break;
+      case ShapeSpec::kPositionTexCoords:
+        BindVertices<CompactVertexPT>(attribute_array, buffer_object);
+        break;
+      case ShapeSpec::kPositionNormal:
+        BindVertices<CompactVertexPN>(attribute_array, buffer_object);
+        break;
+      case ShapeSpec::kPositionTexCoordsNormal:
+      default:
+        BindVertices<CompactVertexPTN>(attribute_array, buffer_object);
+        break;
+    }
+    return attribute_array;
+  }
   switch (spec.vertex_type) {
     case ShapeSpec::kPosition:
       BindVertices<VertexP>(attribute_array, buffer_object);
@@ -282,12 +495,52 @@ static const gfx::AttributeArrayPtr BuildAttributeArray(
   return attribute_array;
 }
 
+// Builds and returns a BufferObject holding compact vertices. This is used by
+// BuildBufferObject() for ShapeSpec::kCompactVertices.
+static const gfx::BufferObjectPtr BuildCompactBufferObject(
+    const ShapeSpec& spec, size_t vertex_count, const VertexPTN vertices[]) {
+  DCHECK_GT(spec.compact_position_scale, 0.f);
+  gfx::BufferObjectPtr buffer_object(new(spec.allocator) gfx::BufferObject);
+  const bool is_wipeable = IsWipeable(spec);
+  const float inverse_scale = 1.f / spec.compact_position_scale;
+  base::DataContainerPtr container;
+  size_t vertex_size;
+  switch (spec.vertex_type) {
+    case ShapeSpec::kPosition:
+      container = QuantizeVerticesIntoDataContainer<CompactVertexP>(
+          spec.allocator, vertex_count, is_wipeable, inverse_scale, vertices);
+      vertex_size = sizeof(CompactVertexP);
+      break;
+    case ShapeSpec::kPositionTexCoords:
+      container = QuantizeVerticesIntoDataContainer<CompactVertexPT>(
+          spec.allocator, vertex_count, is_wipeable, inverse_scale, vertices);
+      vertex_size = sizeof(CompactVertexPT);
+      break;
+    case ShapeSpec::kPositionNormal:
+      container = QuantizeVerticesIntoDataContainer<CompactVertexPN>(
+          spec.allocator, vertex_count, is_wipeable, inverse_scale, vertices);
+      vertex_size = sizeof(CompactVertexPN);
+      break;
+    case ShapeSpec::kPositionTexCoordsNormal:
+    default:
+      container = QuantizeVerticesIntoDataContainer<CompactVertexPTN>(
+          spec.allocator, vertex_count, is_wipeable, inverse_scale, vertices);
+      vertex_size = sizeof(CompactVertexPTN);
+      break;
+  }
+  buffer_object->SetData(container, vertex_size, vertex_count, spec.usage_mode);
+  return buffer_object;
+}
+
 // Builds and returns a BufferObject representing vertices. The vertices are
 // passed in as an array of full-component (VertexPTN) instances, but the
-// vertex_type in the ShapeSpec is used to determine the actual type in the
-// BufferObject. The Allocator in the spec is used for all allocations.
+// vertex_type and vertex_format in the ShapeSpec are used to determine the
+// actual type in the BufferObject. The Allocator in the spec is used for all
+// allocations.
 static const gfx::BufferObjectPtr BuildBufferObject(
     const ShapeSpec& spec, size_t vertex_count, const VertexPTN vertices[]) {
+  if (spec.vertex_format == ShapeSpec::kCompactVertices)
+    return BuildCompactBufferObject(spec, vertex_count, vertices);
   gfx::BufferObjectPtr buffer_object(new(spec.allocator) gfx::BufferObject);
   const bool is_wipeable = IsWipeable(spec);
   base::DataContainerPtr container;
@@ -504,8 +757,9 @@ static void GetPartialCirclePoints(size_t sector_count,
       (angle_end - angle_start) / static_cast<float>(sector_count);
   for (size_t i = 0; i < sector_count + 1; ++i) {
     const Anglef angle = angle_start + sector_angle * static_cast<float>(i);
-    const float radians = angle.Radians();
-    points[i].Set(cosf(radians), sinf(radians));
+    float sine, cosine;
+    math::SineAndCosine(angle, &sine, &cosine);
+    points[i].Set(cosine, sine);
   }
 }
 
@@ -587,7 +841,11 @@ static gfx::BufferObjectPtr BuildExternalBufferObject(
 // Builds and returns an IndexBuffer for an external format.
 static gfx::IndexBufferPtr BuildExternalIndexBuffer(
     const ExternalShapeSpec& spec, const Mesh& mesh) {
-  switch (spec.index_size) {
+  ExternalShapeSpec::IndexSize index_size = spec.index_size;
+  if (index_size == ExternalShapeSpec::kAutomatic)
+    index_size = mesh.mVertices.size() <= (1U << 16) ?
+        ExternalShapeSpec::k16Bit : ExternalShapeSpec::k32Bit;
+  switch (index_size) {
     case ExternalShapeSpec::IndexSize::k16Bit: {
       const size_t index_count = mesh.mIndices.size();
       base::AllocVector<uint16> indices(GetShortTermAllocator(spec.allocator),
@@ -618,6 +876,662 @@ static gfx::IndexBufferPtr BuildExternalIndexBuffer(
   }
 }
 
+//-----------------------------------------------------------------------------
+//
+// In-memory external format helper functions.
+//
+//-----------------------------------------------------------------------------
+
+// The smallest amount of OBJ data that is parsed as a separate chunk when a
+// TaskScheduler is used.
+static const size_t kMinObjChunkSize = 1U << 20;
+
+// Exact powers of ten representable as doubles, used for converting parsed
+// decimal numbers.
+static const double kPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+  1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Returns whether c separates tokens within a line.
+static bool IsLineSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+// A corner of an OBJ face, holding 1-based vertex, texture coordinate, and
+// normal indices, with 0 for missing indices.
+struct ObjFaceNode {
+  bool operator==(const ObjFaceNode& other) const {
+    return v == other.v && vt == other.vt && vn == other.vn;
+  }
+  uint32 v;
+  uint32 vt;
+  uint32 vn;
+};
+
+// A MeshTextParser reads whitespace-separated tokens from the lines of a range
+// of text, without copying it. Text following a '#' on a line is ignored. If
+// continued lines are allowed, a backslash at the end of a line joins it with
+// the next one, as in the OpenCTM OBJ importer.
+class MeshTextParser {
+ public:
+  MeshTextParser(const char* begin, const char* end, bool allow_continuation)
+      : pos_(begin), end_(end), allow_continuation_(allow_continuation) {}
+
+  bool AtEnd() const { return pos_ >= end_; }
+
+  // Returns whether there is another token on the current line, skipping to
+  // it if so.
+  bool HasToken() {
+    while (pos_ < end_) {
+      if (IsLineSpace(*pos_)) {
+        ++pos_;
+      } else if (const size_t length = GetContinuationLength(pos_)) {
+        pos_ += length;
+      } else {
+        return *pos_ != '\n' && *pos_ != '#';
+      }
+    }
+    return false;
+  }
+
+  // Moves to the start of the next line.
+  void NextLine() {
+    while (pos_ < end_) {
+      if (const size_t length = GetContinuationLength(pos_)) {
+        pos_ += length;
+      } else if (*pos_++ == '\n') {
+        break;
+      }
+    }
+  }
+
+  // Skips lines without tokens. Returns false if the end of the text is
+  // reached.
+  bool SkipEmptyLines() {
+    while (!HasToken()) {
+      if (AtEnd())
+        return false;
+      NextLine();
+    }
+    return true;
+  }
+
+  // Returns whether the current line starts with |keyword| followed by a space
+  // or tab, skipping past it if so.
+  bool ConsumeKeyword(const char* keyword) {
+    const char* p = pos_;
+    for (; *keyword; ++keyword, ++p) {
+      if (p == end_ || *p != *keyword)
+        return false;
+    }
+    if (p == end_ || (*p != ' ' && *p != '\t'))
+      return false;
+    pos_ = p;
+    return true;
+  }
+
+  // Returns whether the next token is |word|, skipping past it if so.
+  bool ConsumeWord(const char* word) {
+    if (!HasToken())
+      return false;
+    const char* p = pos_;
+    for (; *word; ++word, ++p) {
+      if (p == end_ || *p != *word)
+        return false;
+    }
+    if (!IsTokenEnd(p))
+      return false;
+    pos_ = p;
+    return true;
+  }
+
+  // Reads up to |count| numbers from the current line into |values|, leaving
+  // any values missing from the line unchanged. Returns false if a token is
+  // not a number.
+  bool ReadFloats(size_t count, float* values) {
+    for (size_t i = 0; i < count && HasToken(); ++i) {
+      if (!ReadFloat(&values[i]))
+        return false;
+    }
+    return true;
+  }
+
+  // Reads a decimal unsigned integer token. Returns false if there is none.
+  bool ReadUnsigned(uint32* value) {
+    if (!HasToken())
+      return false;
+    const char* p = pos_;
+    if (!ParseUnsigned(&p, value) || !IsTokenEnd(p))
+      return false;
+    pos_ = p;
+    return true;
+  }
+
+  // Reads an OBJ face element of up to three slash-separated indices into
+  // |node|. Returns a message if the element is not valid, or NULL.
+  const char* ReadFaceElement(ObjFaceNode* node) {
+    uint32 indices[3] = { 0U, 0U, 0U };
+    const char* p = pos_;
+    int part = 0;
+    while (!IsTokenEnd(p)) {
+      if (*p == '/') {
+        if (++part > 2)
+          return "Invalid face element (too many indices).";
+        ++p;
+      } else if (*p == '-') {
+        return "Negative vertex references in OBJ files are not supported.";
+      } else if (!ParseUnsigned(&p, &indices[part])) {
+        return "Invalid face element.";
+      } else if (indices[part] == 0U) {
+        return "Invalid index (zero) in OBJ file.";
+      }
+    }
+    node->v = indices[0];
+    node->vt = indices[1];
+    node->vn = indices[2];
+    pos_ = p;
+    return NULL;
+  }
+
+ private:
+  // Returns the number of characters in the backslash and line ending at p,
+  // or 0 if there is no continued line at p.
+  size_t GetContinuationLength(const char* p) const {
+    if (!allow_continuation_ || *p != '\\')
+      return 0U;
+    if (p + 1 < end_ && p[1] == '\n')
+      return 2U;
+    if (p + 2 < end_ && p[1] == '\r' && p[2] == '\n')
+      return 3U;
+    return 0U;
+  }
+
+  // Returns whether a token ends at p.
+  bool IsTokenEnd(const char* p) const {
+    return p == end_ || IsLineSpace(*p) || *p == '\n' || *p == '#' ||
+        GetContinuationLength(p);
+  }
+
+  // Parses the digits at |*p| as an unsigned integer, advancing |*p| past
+  // them. Returns false if there are no digits or the value overflows.
+  bool ParseUnsigned(const char** p, uint32* value) const {
+    const char* s = *p;
+    uint64 result = 0;
+    for (; s < end_ && IsDigit(*s); ++s) {
+      result = result * 10U + static_cast<uint64>(*s - '0');
+      if (result > 0xffffffffU)
+        return false;
+    }
+    if (s == *p)
+      return false;
+    *value = static_cast<uint32>(result);
+    *p = s;
+    return true;
+  }
+
+  // Reads a number token. Decimal numbers with at most 19 significant digits
+  // and a small exponent are converted directly, which is exact for all but a
+  // tiny fraction of values. Anything else is converted by strtod().
+  bool ReadFloat(float* value) {
+    const char* p = pos_;
+    const bool negative = p < end_ && *p == '-';
+    if (p < end_ && (*p == '-' || *p == '+'))
+      ++p;
+    uint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+    for (; p < end_ && IsDigit(*p); ++p) {
+      has_digits = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10U + static_cast<uint64>(*p - '0');
+        if (mantissa)
+          ++digits;
+      } else {
+        ++exponent;
+      }
+    }
+    if (p < end_ && *p == '.') {
+      for (++p; p < end_ && IsDigit(*p); ++p) {
+        has_digits = true;
+        if (digits < 19) {
+          mantissa = mantissa * 10U + static_cast<uint64>(*p - '0');
+          if (mantissa)
+            ++digits;
+          --exponent;
+        }
+      }
+    }
+    if (has_digits && p < end_ && (*p == 'e' || *p == 'E')) {
+      ++p;
+      const bool negative_exponent = p < end_ && *p == '-';
+      if (p < end_ && (*p == '-' || *p == '+'))
+        ++p;
+      int explicit_exponent = 0;
+      const char* exponent_start = p;
+      for (; p < end_ && IsDigit(*p); ++p) {
+        if (explicit_exponent < 10000)
+          explicit_exponent = explicit_exponent * 10 + (*p - '0');
+      }
+      if (p == exponent_start)
+        has_digits = false;
+      exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+    }
+    if (has_digits && IsTokenEnd(p) && exponent >= -22 && exponent <= 22 &&
+        mantissa < (1ULL << 53)) {
+      double result = static_cast<double>(mantissa);
+      result = exponent < 0 ? result / kPowersOfTen[-exponent]
+                            : result * kPowersOfTen[exponent];
+      *value = static_cast<float>(negative ? -result : result);
+      pos_ = p;
+      return true;
+    }
+    return ReadFloatSlowly(value);
+  }
+
+  // Converts the next token with strtod(), which needs a null-terminated
+  // copy.
+  bool ReadFloatSlowly(float* value) {
+    const char* p = pos_;
+    while (!IsTokenEnd(p))
+      ++p;
+    const size_t length = static_cast<size_t>(p - pos_);
+    char buffer[64];
+    if (length >= sizeof(buffer))
+      return false;
+    memcpy(buffer, pos_, length);
+    buffer[length] = '\0';
+    char* parsed_end;
+    const double result = strtod(buffer, &parsed_end);
+    if (parsed_end != buffer + length)
+      return false;
+    *value = static_cast<float>(result);
+    pos_ = p;
+    return true;
+  }
+
+  const char* pos_;
+  const char* end_;
+  const bool allow_continuation_;
+};
+
+struct ObjFaceNodeHash {
+  size_t operator()(const ObjFaceNode& node) const {
+    return static_cast<size_t>(
+        (node.v * 0x9e3779b1U) ^ (node.vt * 0x85ebca77U) ^
+        (node.vn * 0xc2b2ae3dU));
+  }
+};
+
+// The data parsed from a chunk of lines of an OBJ file.
+struct ObjChunk {
+  explicit ObjChunk(const base::AllocatorPtr& allocator)
+      : positions(allocator),
+        tex_coords(allocator),
+        normals(allocator),
+        nodes(allocator),
+        face_sizes(allocator),
+        error(NULL) {}
+  base::AllocVector<Vector3> positions;
+  base::AllocVector<Vector2> tex_coords;
+  base::AllocVector<Vector3> normals;
+  base::AllocVector<ObjFaceNode> nodes;
+  // The number of nodes of each face.
+  base::AllocVector<uint32> face_sizes;
+  // Set to a message if the chunk could not be parsed.
+  const char* error;
+};
+
+// Parses the OBJ lines in [begin, end) into |chunk|.
+static void ParseObjChunk(const char* begin, const char* end,
+                          ObjChunk* chunk) {
+  MeshTextParser parser(begin, end, true);
+  while (!parser.AtEnd()) {
+    float values[3] = { 0.f, 0.f, 0.f };
+    if (parser.ConsumeKeyword("v")) {
+      if (!parser.ReadFloats(3U, values))
+        chunk->error = "Invalid vertex position.";
+      chunk->positions.push_back(Vector3(values[0], values[1], values[2]));
+    } else if (parser.ConsumeKeyword("vt")) {
+      if (!parser.ReadFloats(2U, values))
+        chunk->error = "Invalid texture coordinates.";
+      chunk->tex_coords.push_back(Vector2(values[0], values[1]));
+    } else if (parser.ConsumeKeyword("vn")) {
+      if (!parser.ReadFloats(3U, values))
+        chunk->error = "Invalid vertex normal.";
+      chunk->normals.push_back(Vector3(values[0], values[1], values[2]));
+    } else if (parser.ConsumeKeyword("f")) {
+      uint32 count = 0;
+      ObjFaceNode node;
+      while (parser.HasToken()) {
+        if ((chunk->error = parser.ReadFaceElement(&node)) != NULL)
+          return;
+        chunk->nodes.push_back(node);
+        ++count;
+      }
+      chunk->face_sizes.push_back(count);
+    }
+    if (chunk->error)
+      return;
+    parser.NextLine();
+  }
+}
+
+// Returns the start of the first line that begins at or after |p|, ignoring
+// line endings that are escaped by a backslash.
+static const char* FindObjLineStart(const char* p, const char* begin,
+                                    const char* end) {
+  while (p < end) {
+    const char* line_end =
+        static_cast<const char*>(memchr(p, '\n', end - p));
+    if (!line_end)
+      return end;
+    const char* last = line_end - 1;
+    if (last >= begin && *last == '\r')
+      --last;
+    p = line_end + 1;
+    if (last < begin || *last != '\\')
+      break;
+  }
+  return p;
+}
+
+// Parses OBJ data into |mesh|, producing the same vertices and indices as
+// Import_OBJ(). Returns false if the data is not valid.
+static bool ParseObjData(const char* data, size_t size,
+                         const base::AllocatorPtr& allocator,
+                         base::TaskScheduler* scheduler, Mesh* mesh) {
+  // Split the data into chunks of whole lines.
+  const size_t chunk_count = scheduler ?
+      std::max(static_cast<size_t>(1U), size / kMinObjChunkSize) : 1U;
+  std::vector<const char*> starts(chunk_count + 1U, data + size);
+  starts[0] = data;
+  for (size_t i = 1; i < chunk_count; ++i)
+    starts[i] = FindObjLineStart(
+        std::max(starts[i - 1], data + size / chunk_count * i), data,
+        data + size);
+  std::vector<std::unique_ptr<ObjChunk>> chunks(chunk_count);
+  for (size_t i = 0; i < chunk_count; ++i)
+    chunks[i].reset(new ObjChunk(allocator));
+  const auto parse_chunks = [&starts, &chunks](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i)
+      ParseObjChunk(starts[i], starts[i + 1], chunks[i].get());
+  };
+  if (chunk_count > 1U)
+    scheduler->ParallelFor(0U, chunk_count, 1U, parse_chunks);
+  else
+    parse_chunks(0U, chunk_count);
+
+  // Gather the vertex data of all chunks.
+  base::AllocVector<Vector3> positions(allocator);
+  base::AllocVector<Vector2> tex_coords(allocator);
+  base::AllocVector<Vector3> normals(allocator);
+  size_t node_count = 0;
+  for (const auto& chunk : chunks) {
+    if (chunk->error) {
+      LOG(ERROR) << "Unable to parse OBJ data: " << chunk->error;
+      return false;
+    }
+    positions.insert(positions.end(), chunk->positions.begin(),
+                     chunk->positions.end());
+    tex_coords.insert(tex_coords.end(), chunk->tex_coords.begin(),
+                      chunk->tex_coords.end());
+    normals.insert(normals.end(), chunk->normals.begin(),
+                   chunk->normals.end());
+    node_count += chunk->nodes.size();
+  }
+
+  // Create a vertex for each distinct face node, in order of appearance, and
+  // triangulate the faces as fans.
+  base::AllocUnorderedMap<ObjFaceNode, uint32, ObjFaceNodeHash> vertex_map(
+      allocator);
+  vertex_map.reserve(std::min(node_count, positions.size() * 2U));
+  mesh->mVertices.reserve(positions.size());
+  if (!tex_coords.empty())
+    mesh->mTexCoords.reserve(positions.size());
+  if (!normals.empty())
+    mesh->mNormals.reserve(positions.size());
+  mesh->mIndices.reserve(node_count * 3U);
+  for (const auto& chunk : chunks) {
+    const ObjFaceNode* node = chunk->nodes.data();
+    for (const uint32 face_size : chunk->face_sizes) {
+      uint32 first = 0;
+      uint32 previous = 0;
+      for (uint32 i = 0; i < face_size; ++i, ++node) {
+        const uint32 next_index = static_cast<uint32>(mesh->mVertices.size());
+        const auto inserted = vertex_map.insert(std::make_pair(*node,
+                                                               next_index));
+        const uint32 index = inserted.first->second;
+        if (inserted.second) {
+          const uint32 v = node->v ? node->v - 1U : 0U;
+          const uint32 vt = node->vt ? node->vt - 1U : 0U;
+          const uint32 vn = node->vn ? node->vn - 1U : 0U;
+          if (v >= positions.size()) {
+            LOG(ERROR) << "Unable to parse OBJ data: Invalid vertex index.";
+            return false;
+          }
+          mesh->mVertices.push_back(positions[v]);
+          if (!tex_coords.empty()) {
+            if (vt >= tex_coords.size()) {
+              LOG(ERROR) << "Unable to parse OBJ data: Invalid texture"
+                         << " coordinate index.";
+              return false;
+            }
+            mesh->mTexCoords.push_back(tex_coords[vt]);
+          }
+          if (!normals.empty()) {
+            if (vn >= normals.size()) {
+              LOG(ERROR) << "Unable to parse OBJ data: Invalid vertex normal"
+                         << " index.";
+              return false;
+            }
+            mesh->mNormals.push_back(normals[vn]);
+          }
+        }
+        if (i == 0) {
+          first = index;
+        } else if (i >= 2) {
+          mesh->mIndices.push_back(first);
+          mesh->mIndices.push_back(previous);
+          mesh->mIndices.push_back(index);
+        }
+        previous = index;
+      }
+    }
+  }
+  return true;
+}
+
+// Parses OFF data into |mesh|, producing the same vertices and indices as
+// Import_OFF(). Unlike Import_OFF(), face indices are checked against the
+// vertex count. Returns false if the data is not valid.
+static bool ParseOffData(const char* data, size_t size, Mesh* mesh) {
+  MeshTextParser parser(data, data + size, false);
+  const char* error = NULL;
+  uint32 vertex_count = 0;
+  uint32 face_count = 0;
+  if (!parser.SkipEmptyLines() || !parser.ConsumeWord("OFF") ||
+      parser.HasToken()) {
+    error = "missing OFF signature";
+  } else {
+    parser.NextLine();
+    if (!parser.SkipEmptyLines() || !parser.ReadUnsigned(&vertex_count) ||
+        vertex_count < 1U)
+      error = "bad vertex count";
+    else if (!parser.ReadUnsigned(&face_count) || face_count < 1U)
+      error = "bad face count";
+  }
+  if (!error) {
+    mesh->mVertices.resize(vertex_count);
+    for (uint32 i = 0; i < vertex_count && !error; ++i) {
+      parser.NextLine();
+      float values[3] = { 0.f, 0.f, 0.f };
+      if (!parser.SkipEmptyLines() || !parser.ReadFloats(3U, values))
+        error = "bad vertex";
+      mesh->mVertices[i] = Vector3(values[0], values[1], values[2]);
+    }
+  }
+  for (uint32 i = 0; i < face_count && !error; ++i) {
+    parser.NextLine();
+    uint32 node_count;
+    if (!parser.SkipEmptyLines() || !parser.ReadUnsigned(&node_count)) {
+      error = "bad face";
+      break;
+    }
+    uint32 first = 0;
+    uint32 previous = 0;
+    for (uint32 j = 0; j < node_count; ++j) {
+      uint32 index;
+      if (!parser.ReadUnsigned(&index) || index >= vertex_count) {
+        error = "bad face index";
+        break;
+      }
+      if (j == 0) {
+        first = index;
+      } else if (j >= 2) {
+        mesh->mIndices.push_back(first);
+        mesh->mIndices.push_back(previous);
+        mesh->mIndices.push_back(index);
+      }
+      previous = index;
+    }
+  }
+  if (error) {
+    LOG(ERROR) << "Not a valid OFF format file (" << error << ").";
+    return false;
+  }
+  return true;
+}
+
+// The header of kIonMesh data. See SaveIonMesh() for the format.
+struct IonMeshHeader {
+  char magic[4];
+  uint32 version;
+  uint32 vertex_type;
+  uint32 vertex_format;
+  uint32 index_size;
+  uint32 vertex_count;
+  uint32 index_count;
+};
+
+static const char kIonMeshMagic[4] = { 'I', 'M', 'S', 'H' };
+static const uint32 kIonMeshVersion = 2U;
+
+// Returns the size of a vertex of the given type and format.
+static size_t GetVertexSize(ShapeSpec::VertexType vertex_type,
+                            ShapeSpec::VertexFormat vertex_format) {
+  if (vertex_format == ShapeSpec::kCompactVertices) {
+    switch (vertex_type) {
+      case ShapeSpec::kPosition:
+        return sizeof(CompactVertexP);
+      case ShapeSpec::kPositionTexCoords:
+        return sizeof(CompactVertexPT);
+      case ShapeSpec::kPositionNormal:
+        return sizeof(CompactVertexPN);
+      case ShapeSpec::kPositionTexCoordsNormal:
+      default:
+        return sizeof(CompactVertexPTN);
+    }
+  }
+  switch (vertex_type) {
+    case ShapeSpec::kPosition:
+      return sizeof(VertexP);
+    case ShapeSpec::kPositionTexCoords:
+      return sizeof(VertexPT);
+    case ShapeSpec::kPositionNormal:
+      return sizeof(VertexPN);
+    case ShapeSpec::kPositionTexCoordsNormal:
+    default:
+      return sizeof(VertexPTN);
+  }
+}
+
+// Returns the size of an index of the given size.
+static size_t GetIndexSize(ExternalShapeSpec::IndexSize index_size) {
+  return index_size == ExternalShapeSpec::k16Bit ? sizeof(uint16)
+                                                 : sizeof(uint32);
+}
+
+// Builds a Shape from kIonMesh |data|, calling |create_container| to create
+// the DataContainers for the vertex and index data at a byte offset and length
+// in the data. Returns a NULL Shape if the data is not valid.
+static const gfx::ShapePtr BuildIonMeshShape(
+    const ExternalShapeSpec& spec, const void* data, size_t size,
+    const std::function<base::DataContainerPtr(size_t offset, size_t length)>&
+        create_container) {
+  IonMeshHeader header;
+  if (size < sizeof(header)) {
+    LOG(ERROR) << "Ion mesh data is too short.";
+    return gfx::ShapePtr();
+  }
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kIonMeshMagic, sizeof(kIonMeshMagic)) != 0 ||
+      header.version != kIonMeshVersion ||
+      header.vertex_type > ShapeSpec::kPositionTexCoordsNormal ||
+      header.vertex_format > ShapeSpec::kCompactVertices ||
+      header.index_size > ExternalShapeSpec::k32Bit) {
+    LOG(ERROR) << "Invalid Ion mesh header.";
+    return gfx::ShapePtr();
+  }
+  ShapeSpec vertex_spec = spec;
+  vertex_spec.vertex_type =
+      static_cast<ShapeSpec::VertexType>(header.vertex_type);
+  vertex_spec.vertex_format =
+      static_cast<ShapeSpec::VertexFormat>(header.vertex_format);
+  const ExternalShapeSpec::IndexSize index_size =
+      static_cast<ExternalShapeSpec::IndexSize>(header.index_size);
+  const size_t vertex_size =
+      GetVertexSize(vertex_spec.vertex_type, vertex_spec.vertex_format);
+  const uint64 vertex_bytes =
+      static_cast<uint64>(header.vertex_count) * vertex_size;
+  const uint64 index_bytes =
+      static_cast<uint64>(header.index_count) * GetIndexSize(index_size);
+  if (!header.vertex_count || !header.index_count ||
+      header.index_count % 3U ||
+      sizeof(header) + vertex_bytes + index_bytes > size) {
+    LOG(ERROR) << "Invalid Ion mesh data size.";
+    return gfx::ShapePtr();
+  }
+
+  gfx::BufferObjectPtr buffer_object(new(spec.allocator) gfx::BufferObject);
+  buffer_object->SetData(
+      create_container(sizeof(header), static_cast<size_t>(vertex_bytes)),
+      vertex_size, header.vertex_count, spec.usage_mode);
+  gfx::IndexBufferPtr index_buffer(new(spec.allocator) gfx::IndexBuffer);
+  index_buffer->AddSpec(index_size == ExternalShapeSpec::k16Bit ?
+                        gfx::BufferObject::kUnsignedShort :
+                        gfx::BufferObject::kUnsignedInt, 1, 0);
+  index_buffer->SetData(
+      create_container(sizeof(header) + static_cast<size_t>(vertex_bytes),
+                       static_cast<size_t>(index_bytes)),
+      GetIndexSize(index_size), header.index_count, spec.usage_mode);
+
+  gfx::ShapePtr shape(new(spec.allocator) gfx::Shape);
+  shape->SetLabel("External geometry");
+  shape->SetPrimitiveType(gfx::Shape::kTriangles);
+  shape->SetAttributeArray(BuildAttributeArray(vertex_spec, buffer_object));
+  shape->SetIndexBuffer(index_buffer);
+  return shape;
+}
+
+// Builds a Shape from an external geometry model. Returns a NULL Shape if
+// there is nothing to return.
+static const gfx::ShapePtr BuildExternalShape(const ExternalShapeSpec& spec,
+                                              const Mesh& mesh) {
+  // If there are no vertices or indices then there is nothing to return.
+  if (mesh.mIndices.empty() || mesh.mVertices.empty())
+    return gfx::ShapePtr();
+
+  gfx::BufferObjectPtr buffer_object = BuildExternalBufferObject(spec, mesh);
+  gfx::ShapePtr shape(new(spec.allocator) gfx::Shape);
+  shape->SetLabel("External geometry");
+  shape->SetPrimitiveType(gfx::Shape::kTriangles);
+  shape->SetAttributeArray(BuildAttributeArray(spec, buffer_object));
+  shape->SetIndexBuffer(BuildExternalIndexBuffer(spec, mesh));
+  return shape;
+}
+
 //-----------------------------------------------------------------------------
 //
 // Rectangle Shape helper functions.
@@ -761,25 +1675,15 @@ static const EllipsoidData GetEllipsoidData(const EllipsoidSpec& spec) {
   return data;
 }
 
-// Builds and returns a BufferObject representing the vertices of a ellipsoid.
-static gfx::BufferObjectPtr BuildEllipsoidBufferObject(
-    const EllipsoidSpec& spec) {
-  // Use a short-term allocator for the local vectors.
-  const base::AllocatorPtr& allocator = GetShortTermAllocator(spec.allocator);
-
-  const EllipsoidData data = GetEllipsoidData(spec);
+// Sets the vertices of rings [first_ring, end_ring) of an ellipsoid, storing
+// the first vertex of first_ring in vertices[0]. ring_points holds the points
+// of a latitudinal ring of radius 1.
+static void GetEllipsoidVertices(const EllipsoidSpec& spec,
+                                 const EllipsoidData& data,
+                                 const Point2f ring_points[], size_t first_ring,
+                                 size_t end_ring, VertexPTN vertices[]) {
   const bool has_tex_coords = HasTextureCoordinates(spec);
   const bool has_normals = HasNormals(spec);
-  base::AllocVector<VertexPTN> vertices(allocator, data.vertex_count,
-                                        VertexPTN());
-
-  // Get the points for a latitudinal ring of radius 1.
-  base::AllocVector<Point2f> ring_points(allocator, data.vertices_per_ring,
-                                         Point2f::Zero());
-  GetPartialCirclePoints(data.sector_count,
-                         spec.longitude_start,
-                         spec.longitude_end,
-                         &ring_points[0]);
 
   // The circle has a radius of 1, and the default ellipsoid is a sphere of
   // radius 0.5 (for size 1x1x1). Create a scale that handles both the change
@@ -787,22 +1691,21 @@ static gfx::BufferObjectPtr BuildEllipsoidBufferObject(
   const Vector3f scale = 0.5f * spec.size;
   const Vector3f inv_scale = 1.0f / scale;
 
-  // Set up vertices. The first N (where N is sector_count + 1) vertices are at
-  // the northern most position (north pole when default lat long angles are
-  // used), the next N are the first ring below that, and so on, up to
-  // the last N at the southern most position (south pole when default lat long
-  // angles are used). There are band_count + 1 rings all together.
-  // The y coordinate is computed from the latitude angle, which goes from
-  // spec.latitude_end to spec.latitude_start.
+  // The first N (where N is sector_count + 1) vertices are at the northern
+  // most position (north pole when default lat long angles are used), the
+  // next N are the first ring below that, and so on, up to the last N at the
+  // southern most position (south pole when default lat long angles are
+  // used). There are band_count + 1 rings all together. The y coordinate is
+  // computed from the latitude angle, which goes from spec.latitude_end to
+  // spec.latitude_start.
   const Anglef delta_angle = (spec.latitude_end - spec.latitude_start)
       / static_cast<float>(data.band_count);
   size_t cur_vertex = 0;
-  for (size_t ring = 0; ring <= data.band_count; ++ring) {
+  for (size_t ring = first_ring; ring < end_ring; ++ring) {
     const Anglef latitude_angle = spec.latitude_end -
         delta_angle * static_cast<float>(ring);
-    const float ring_radius = cosf(latitude_angle.Radians());
-    const float sphere_y = sinf(latitude_angle.Radians());
-    Point3f pos;
+    float sphere_y, ring_radius;
+    math::SineAndCosine(latitude_angle, &sphere_y, &ring_radius);
     for (size_t s = 0; s <= data.sector_count; ++s) {
       VertexPTN& v = vertices[cur_vertex];
 
@@ -833,27 +1736,20 @@ static gfx::BufferObjectPtr BuildEllipsoidBufferObject(
       ++cur_vertex;
     }
   }
-  DCHECK_EQ(cur_vertex, data.vertex_count);
-
-  return BuildBufferObject(spec, vertices.size(), &vertices[0]);
+  DCHECK_EQ(cur_vertex, (end_ring - first_ring) * data.vertices_per_ring);
 }
 
-// Builds and returns an IndexBuffer representing the indices of a ellipsoid.
-static gfx::IndexBufferPtr BuildEllipsoidIndexBuffer(
-    const EllipsoidSpec& spec) {
-  const EllipsoidData data = GetEllipsoidData(spec);
-
-  // Each band uses 2 * sector_count triangles, so they each contain 6 *
-  // sector_count indices.
-  const size_t index_count = 6U * data.band_count * data.sector_count;
-  base::AllocVector<uint16> indices(GetShortTermAllocator(spec.allocator),
-                                    index_count, static_cast<uint16>(0));
-
+// Sets the indices of bands [first_band, end_band) of vertex rings that have
+// vertices_per_ring vertices each, starting at vertex 0, storing the first
+// index of first_band in indices[0]. Each band has 6 * sector_count indices.
+static void GetBandIndices(size_t vertices_per_ring, size_t sector_count,
+                           size_t first_band, size_t end_band,
+                           uint16 indices[]) {
   size_t cur_index = 0;
-  const uint16 ring_offset = static_cast<uint16>(data.vertices_per_ring);
-  for (uint16 band = 0; band < data.band_count; ++band) {
+  const uint16 ring_offset = static_cast<uint16>(vertices_per_ring);
+  for (size_t band = first_band; band < end_band; ++band) {
     const uint16 first_band_vertex = static_cast<uint16>(band * ring_offset);
-    for (uint16 s = 0; s < data.sector_count; ++s) {
+    for (uint16 s = 0; s < sector_count; ++s) {
       const uint16 v = static_cast<uint16>(first_band_vertex + s);
       indices[cur_index + 0] = v;
       indices[cur_index + 1] = static_cast<uint16>(v + ring_offset);
@@ -861,12 +1757,51 @@ static gfx::IndexBufferPtr BuildEllipsoidIndexBuffer(
       indices[cur_index + 3] = static_cast<uint16>(v + 1U);
       indices[cur_index + 4] = static_cast<uint16>(v + ring_offset);
       indices[cur_index + 5] = static_cast<uint16>(v + ring_offset + 1U);
-      DCHECK_LE(indices[cur_index + 5U], data.vertex_count);
       cur_index += 6U;
     }
   }
-  DCHECK_EQ(cur_index, index_count);
+}
+
+// Builds and returns a BufferObject representing the vertices of a ellipsoid.
+static gfx::BufferObjectPtr BuildEllipsoidBufferObject(
+    const EllipsoidSpec& spec) {
+  // Use a short-term allocator for the local vectors.
+  const base::AllocatorPtr& allocator = GetShortTermAllocator(spec.allocator);
+
+  const EllipsoidData data = GetEllipsoidData(spec);
+  base::AllocVector<VertexPTN> vertices(allocator, data.vertex_count,
+                                        VertexPTN());
+
+  // Get the points for a latitudinal ring of radius 1.
+  base::AllocVector<Point2f> ring_points(allocator, data.vertices_per_ring,
+                                         Point2f::Zero());
+  GetPartialCirclePoints(data.sector_count,
+                         spec.longitude_start,
+                         spec.longitude_end,
+                         &ring_points[0]);
+
+  GetEllipsoidVertices(spec, data, &ring_points[0], 0U, data.band_count + 1U,
+                       &vertices[0]);
+
+  return BuildBufferObject(spec, vertices.size(), &vertices[0]);
+}
+
+// Returns the number of indices of an ellipsoid.
+static size_t GetEllipsoidIndexCount(const EllipsoidData& data) {
+  // Each band uses 2 * sector_count triangles, so they each contain 6 *
+  // sector_count indices.
+  return 6U * data.band_count * data.sector_count;
+}
 
+// Builds and returns an IndexBuffer representing the indices of a ellipsoid.
+static gfx::IndexBufferPtr BuildEllipsoidIndexBuffer(
+    const EllipsoidSpec& spec) {
+  const EllipsoidData data = GetEllipsoidData(spec);
+  const size_t index_count = GetEllipsoidIndexCount(data);
+  base::AllocVector<uint16> indices(GetShortTermAllocator(spec.allocator),
+                                    index_count, static_cast<uint16>(0));
+  GetBandIndices(data.vertices_per_ring, data.sector_count, 0U,
+                 data.band_count, &indices[0]);
   return BuildIndexBuffer(spec, index_count, &indices[0]);
 }
 
@@ -1075,39 +2010,25 @@ static size_t AddCylinderCapIndices(
   return cur_index;
 }
 
-// Builds and returns a BufferObject representing the vertices of a cylinder.
-static gfx::BufferObjectPtr BuildCylinderBufferObject(
-    const CylinderSpec& spec) {
-  // Use a short-term allocator for the local vectors.
-  const base::AllocatorPtr& allocator = GetShortTermAllocator(spec.allocator);
-
-  const CylinderData data = GetCylinderData(spec);
+// Sets the vertices of shaft rings [first_ring, end_ring) of a cylinder,
+// storing the first vertex of first_ring in vertices[0]. Rings start at the
+// top and proceed to the bottom. ring_points holds the points of a ring of
+// radius 1, and shaft_normals the normals of the vertices in each ring.
+static void GetCylinderShaftVertices(const CylinderSpec& spec,
+                                     const CylinderData& data,
+                                     const Point2f ring_points[],
+                                     const Vector3f shaft_normals[],
+                                     size_t first_ring, size_t end_ring,
+                                     VertexPTN vertices[]) {
   const bool has_tex_coords = HasTextureCoordinates(spec);
   const bool has_normals = HasNormals(spec);
-  base::AllocVector<VertexPTN> vertices(allocator, data.vertex_count,
-                                        VertexPTN());
-
-  // Get the points for a latitudinal ring of radius 1.
-  base::AllocVector<Point2f> ring_points(allocator, data.vertices_per_ring,
-                                         Point2f::Zero());
-  GetCirclePoints(data.sector_count, &ring_points[0]);
-
-  // Compute the shaft normals as well, since they don't vary by height.
-  base::AllocVector<Vector3f> shaft_normals(allocator, data.vertices_per_ring,
-                                            Vector3f::Zero());
-  GetCylinderShaftNormals(data.vertices_per_ring, &ring_points[0],
-                          spec.top_radius, spec.bottom_radius, spec.height,
-                          &shaft_normals[0]);
-
-  // Store shaft vertices. Rings start at the top and proceed to the bottom.
-  const float delta_y = 1.f / static_cast<float>(data.shaft_band_count);
-  const float delta_radius = (spec.top_radius - spec.bottom_radius) /
-                             static_cast<float>(data.shaft_band_count);
-  float ring_y = .5f;
-  float ring_radius = spec.top_radius;
+  const float band_count = static_cast<float>(data.shaft_band_count);
   size_t cur_vertex = 0;
-  for (size_t ring = 0; ring <= data.shaft_band_count; ++ring) {
-    const float ring_t = ring_y + .5f;
+  for (size_t ring = first_ring; ring < end_ring; ++ring) {
+    const float ring_t = 1.f - static_cast<float>(ring) / band_count;
+    const float ring_y = ring_t - .5f;
+    const float ring_radius = spec.bottom_radius +
+        (spec.top_radius - spec.bottom_radius) * ring_t;
     // The circle in ring_points has a radius of 1; scale to the correct sizes.
     const Vector3f scale(ring_radius, spec.height, ring_radius);
     for (size_t s = 0; s <= data.sector_count; ++s) {
@@ -1128,9 +2049,36 @@ static gfx::BufferObjectPtr BuildCylinderBufferObject(
 
       ++cur_vertex;
     }
-    ring_y -= delta_y;
-    ring_radius -= delta_radius;
   }
+  DCHECK_EQ(cur_vertex, (end_ring - first_ring) * data.vertices_per_ring);
+}
+
+// Builds and returns a BufferObject representing the vertices of a cylinder.
+static gfx::BufferObjectPtr BuildCylinderBufferObject(
+    const CylinderSpec& spec) {
+  // Use a short-term allocator for the local vectors.
+  const base::AllocatorPtr& allocator = GetShortTermAllocator(spec.allocator);
+
+  const CylinderData data = GetCylinderData(spec);
+  base::AllocVector<VertexPTN> vertices(allocator, data.vertex_count,
+                                        VertexPTN());
+
+  // Get the points for a latitudinal ring of radius 1.
+  base::AllocVector<Point2f> ring_points(allocator, data.vertices_per_ring,
+                                         Point2f::Zero());
+  GetCirclePoints(data.sector_count, &ring_points[0]);
+
+  // Compute the shaft normals as well, since they don't vary by height.
+  base::AllocVector<Vector3f> shaft_normals(allocator, data.vertices_per_ring,
+                                            Vector3f::Zero());
+  GetCylinderShaftNormals(data.vertices_per_ring, &ring_points[0],
+                          spec.top_radius, spec.bottom_radius, spec.height,
+                          &shaft_normals[0]);
+
+  // Store shaft vertices.
+  GetCylinderShaftVertices(spec, data, &ring_points[0], &shaft_normals[0], 0U,
+                           data.shaft_band_count + 1U, &vertices[0]);
+  size_t cur_vertex = data.shaft_vertex_count;
 
   // Store cap vertices.
   if (data.add_top_cap)
@@ -1145,62 +2093,292 @@ static gfx::BufferObjectPtr BuildCylinderBufferObject(
   return BuildBufferObject(spec, vertices.size(), &vertices[0]);
 }
 
-// Builds and returns an IndexBuffer representing the indices of a cylinder.
-static gfx::IndexBufferPtr BuildCylinderIndexBuffer(
-    const CylinderSpec& spec) {
-  const CylinderData data = GetCylinderData(spec);
-
+// Returns the number of indices in the shaft of a cylinder.
+static size_t GetCylinderShaftIndexCount(const CylinderData& data) {
   // Each shaft band uses 2 * sector_count triangles, so they each contain 6 *
   // sector_count indices.
-  const size_t shaft_index_count =
-      6U * data.shaft_band_count * data.sector_count;
+  return 6U * data.shaft_band_count * data.sector_count;
+}
+
+// Returns the number of indices of a cylinder.
+static size_t GetCylinderIndexCount(const CylinderData& data) {
   // Each cap uses sector_count triangles (3 vertices) for the innermost band
   // and 2 * sector_count triangles (6 vertices) for every other band.
   const size_t cap_index_count =
       3U * data.sector_count +
       6U * data.sector_count * (data.cap_band_count - 1U);
-  const size_t index_count =
-      shaft_index_count + data.num_caps * cap_index_count;
-  base::AllocVector<uint16> indices(GetShortTermAllocator(spec.allocator),
-                                    index_count, static_cast<uint16>(0));
+  return GetCylinderShaftIndexCount(data) + data.num_caps * cap_index_count;
+}
 
+// Sets the indices of the caps of a cylinder, which follow the shaft indices.
+// Returns the number of indices that were set.
+static size_t GetCylinderCapIndices(const CylinderData& data,
+                                    uint16 indices[]) {
   size_t cur_index = 0;
-
-  // Add shaft indices.
-  const uint16 ring_offset = static_cast<uint16>(data.vertices_per_ring);
-  for (uint16 band = 0; band < data.shaft_band_count; ++band) {
-    const uint16 first_band_vertex = static_cast<uint16>(band * ring_offset);
-    for (uint16 s = 0; s < data.sector_count; ++s) {
-      const uint16 v = static_cast<uint16>(first_band_vertex + s);
-      indices[cur_index + 0] = v;
-      indices[cur_index + 1] = static_cast<uint16>(v + ring_offset);
-      indices[cur_index + 2] = static_cast<uint16>(v + 1U);
-      indices[cur_index + 3] = static_cast<uint16>(v + 1U);
-      indices[cur_index + 4] = static_cast<uint16>(v + ring_offset);
-      indices[cur_index + 5] = static_cast<uint16>(v + ring_offset + 1U);
-      DCHECK_LE(indices[cur_index + 5U], data.vertex_count);
-      cur_index += 6U;
-    }
-  }
-
-  // Add cap indices.
   size_t first_cap_vertex = data.shaft_vertex_count;
   if (data.add_top_cap) {
     cur_index += AddCylinderCapIndices(data, first_cap_vertex, false,
                                        &indices[cur_index]);
     first_cap_vertex += data.cap_vertex_count;
   }
-
   if (data.add_bottom_cap) {
     cur_index += AddCylinderCapIndices(data, first_cap_vertex, true,
                                        &indices[cur_index]);
-    first_cap_vertex += data.cap_vertex_count;
   }
+  return cur_index;
+}
+
+// Builds and returns an IndexBuffer representing the indices of a cylinder.
+static gfx::IndexBufferPtr BuildCylinderIndexBuffer(
+    const CylinderSpec& spec) {
+  const CylinderData data = GetCylinderData(spec);
+  const size_t index_count = GetCylinderIndexCount(data);
+  base::AllocVector<uint16> indices(GetShortTermAllocator(spec.allocator),
+                                    index_count, static_cast<uint16>(0));
+
+  // Add shaft indices, then cap indices.
+  GetBandIndices(data.vertices_per_ring, data.sector_count, 0U,
+                 data.shaft_band_count, &indices[0]);
+  size_t cur_index = GetCylinderShaftIndexCount(data);
+  cur_index += GetCylinderCapIndices(data, &indices[cur_index]);
   DCHECK_EQ(cur_index, index_count);
 
   return BuildIndexBuffer(spec, index_count, &indices[0]);
 }
 
+//-----------------------------------------------------------------------------
+//
+// Shape update helper types and functions.
+//
+//-----------------------------------------------------------------------------
+
+// Vertices and indices are only generated in parallel for shapes with at
+// least this many of them, since smaller shapes are generated faster on one
+// thread.
+static const size_t kMinParallelElementCount = 4096U;
+
+// The most vertices that are converted from VertexPTN at a time, which limits
+// the size of the temporary vertices.
+static const size_t kMaxConvertedVertexCount = 1024U;
+
+// Functions that store the vertices or indices of rows [first_row, end_row)
+// of a shape, starting at the first element of the passed array.
+typedef std::function<void(size_t first_row, size_t end_row,
+                           VertexPTN vertices[])> VertexRowFunction;
+typedef std::function<void(size_t first_row, size_t end_row,
+                           uint16 indices[])> IndexRowFunction;
+
+// Returns the BufferObject that holds the vertices of attribute_array if all
+// of its attributes are in that BufferObject and they match one of the
+// ShapeSpec vertex types, which is returned in vertex_type along with the
+// format in vertex_format. Returns a NULL pointer otherwise.
+static const gfx::BufferObjectPtr GetVertexBufferObject(
+    const gfx::AttributeArray& attribute_array,
+    ShapeSpec::VertexType* vertex_type,
+    ShapeSpec::VertexFormat* vertex_format) {
+  // The vertex type follows from the attributes, and the vertex format from
+  // the type of the positions.
+  gfx::BufferObjectPtr buffer_object;
+  bool has_positions = false;
+  bool has_texture_coords = false;
+  bool has_normals = false;
+  *vertex_format = ShapeSpec::kFloatVertices;
+  for (size_t i = 0; i < attribute_array.GetBufferAttributeCount(); ++i) {
+    const gfx::Attribute& attribute = attribute_array.GetBufferAttribute(i);
+    const gfx::BufferObjectElement& element =
+        attribute.GetValue<gfx::BufferObjectElement>();
+    if (!buffer_object.Get())
+      buffer_object = element.buffer_object;
+    else if (element.buffer_object != buffer_object)
+      return gfx::BufferObjectPtr();
+    const std::string& name = attribute.GetRegistry().GetSpec(attribute)->name;
+    if (name == "aVertex" && element.buffer_object.Get()) {
+      has_positions = true;
+      if (element.buffer_object->GetSpec(element.spec_index).type ==
+          gfx::BufferObject::kShort)
+        *vertex_format = ShapeSpec::kCompactVertices;
+    }
+    has_texture_coords = has_texture_coords || name == "aTexCoords";
+    has_normals = has_normals || name == "aNormal";
+  }
+  *vertex_type = has_texture_coords ?
+      (has_normals ? ShapeSpec::kPositionTexCoordsNormal :
+       ShapeSpec::kPositionTexCoords) :
+      (has_normals ? ShapeSpec::kPositionNormal : ShapeSpec::kPosition);
+  if (!buffer_object.Get() || !has_positions ||
+      buffer_object->GetStructSize() !=
+          GetVertexSize(*vertex_type, *vertex_format))
+    return gfx::BufferObjectPtr();
+  return buffer_object;
+}
+
+// Converts VertexPTN vertices to the vertex type and format in a ShapeSpec.
+static void ConvertVertices(const ShapeSpec& spec, size_t count,
+                            const VertexPTN vertices_in[],
+                            void* vertices_out) {
+  if (spec.vertex_format == ShapeSpec::kCompactVertices) {
+    const float inverse_scale = 1.f / spec.compact_position_scale;
+    switch (spec.vertex_type) {
+      case ShapeSpec::kPosition:
+        QuantizeVertices(count, vertices_in, inverse_scale,
+                         static_cast<CompactVertexP*>(vertices_out));
+        break;
+      case ShapeSpec::kPositionTexCoords:
+        QuantizeVertices(count, vertices_in, inverse_scale,
+                         static_cast<CompactVertexPT*>(vertices_out));
+        break;
+      case ShapeSpec::kPositionNormal:
+        QuantizeVertices(count, vertices_in, inverse_scale,
+                         static_cast<CompactVertexPN*>(vertices_out));
+        break;
+      case ShapeSpec::kPositionTexCoordsNormal:
+      default:
+        QuantizeVertices(count, vertices_in, inverse_scale,
+                         static_cast<CompactVertexPTN*>(vertices_out));
+        break;
+    }
+    return;
+  }
+  switch (spec.vertex_type) {
+    case ShapeSpec::kPosition:
+      CompactVertices(count, vertices_in, static_cast<VertexP*>(vertices_out));
+      break;
+    case ShapeSpec::kPositionTexCoords:
+      CompactVertices(count, vertices_in,
+                      static_cast<VertexPT*>(vertices_out));
+      break;
+    case ShapeSpec::kPositionNormal:
+      CompactVertices(count, vertices_in,
+                      static_cast<VertexPN*>(vertices_out));
+      break;
+    case ShapeSpec::kPositionTexCoordsNormal:
+    default:
+      memcpy(vertices_out, vertices_in, count * sizeof(vertices_in[0]));
+      break;
+  }
+}
+
+// Stores row_count rows of row_size vertices generated by func in
+// vertices_out, using the vertex type and format in the ShapeSpec. If
+// scheduler is not NULL and there are enough vertices, ranges of rows are
+// generated in parallel on its threads.
+static void GenerateVertexRows(const ShapeSpec& spec, size_t row_count,
+                               size_t row_size, const VertexRowFunction& func,
+                               base::TaskScheduler* scheduler,
+                               uint8* vertices_out) {
+  const size_t vertex_size =
+      GetVertexSize(spec.vertex_type, spec.vertex_format);
+  // Float vertices with all components are generated in place, while all
+  // others are generated a few rows at a time and converted.
+  const bool is_converted =
+      spec.vertex_format == ShapeSpec::kCompactVertices ||
+      spec.vertex_type != ShapeSpec::kPositionTexCoordsNormal;
+  const size_t rows_per_conversion =
+      std::max(static_cast<size_t>(1), kMaxConvertedVertexCount / row_size);
+  const base::AllocatorPtr& allocator = GetShortTermAllocator(spec.allocator);
+  const auto generate = [&](size_t first_row, size_t end_row) {
+    uint8* out = vertices_out + first_row * row_size * vertex_size;
+    if (!is_converted) {
+      func(first_row, end_row, reinterpret_cast<VertexPTN*>(out));
+      return;
+    }
+    base::AllocVector<VertexPTN> vertices(
+        allocator, std::min(end_row - first_row, rows_per_conversion) *
+        row_size, VertexPTN());
+    for (size_t row = first_row; row < end_row; row += rows_per_conversion) {
+      const size_t count = std::min(end_row - row, rows_per_conversion);
+      func(row, row + count, &vertices[0]);
+      ConvertVertices(spec, count * row_size, &vertices[0], out);
+      out += count * row_size * vertex_size;
+    }
+  };
+  if (scheduler && row_count * row_size >= kMinParallelElementCount)
+    scheduler->ParallelFor(0U, row_count, 0U, generate);
+  else
+    generate(0U, row_count);
+}
+
+// Stores row_count rows of row_size indices generated by func in indices_out,
+// in parallel on the threads of scheduler under the same conditions as
+// GenerateVertexRows().
+static void GenerateIndexRows(size_t row_count, size_t row_size,
+                              const IndexRowFunction& func,
+                              base::TaskScheduler* scheduler,
+                              uint16 indices_out[]) {
+  const auto generate = [&](size_t first_row, size_t end_row) {
+    func(first_row, end_row, &indices_out[first_row * row_size]);
+  };
+  if (scheduler && row_count * row_size >= kMinParallelElementCount)
+    scheduler->ParallelFor(0U, row_count, 0U, generate);
+  else
+    generate(0U, row_count);
+}
+
+// Returns a DataContainer that can hold size bytes of data for buffer_object,
+// which may be NULL. This is the DataContainer of buffer_object if its data
+// can be modified and is at least that large, or a new one otherwise.
+static const base::DataContainerPtr GetReusableDataContainer(
+    const ShapeSpec& spec, const gfx::BufferObject* buffer_object,
+    size_t size) {
+  if (buffer_object) {
+    const base::DataContainerPtr& container = buffer_object->GetData();
+    if (container.Get() && container->GetData() && !container->IsReadOnly() &&
+        buffer_object->GetStructSize() * buffer_object->GetCount() >= size)
+      return container;
+  }
+  return base::DataContainer::CreateAndCopy<uint8>(
+      NULL, size, IsWipeable(spec), spec.allocator);
+}
+
+// Stores vertex_count vertices and index_count 16-bit indices in shape, which
+// are generated by fill_vertices and fill_indices. The vertex type and format
+// in spec are used for the vertices. The AttributeArray, BufferObject and
+// IndexBuffer of shape, as well as their data, are reused if possible.
+static void UpdateShape(const ShapeSpec& spec, const char* label,
+                        size_t vertex_count,
+                        const std::function<void(uint8*)>& fill_vertices,
+                        size_t index_count,
+                        const std::function<void(uint16*)>& fill_indices,
+                        const gfx::ShapePtr& shape) {
+  shape->SetLabel(label);
+  shape->SetPrimitiveType(gfx::Shape::kTriangles);
+
+  gfx::BufferObjectPtr buffer_object;
+  if (const gfx::AttributeArray* attribute_array =
+          shape->GetAttributeArray().Get()) {
+    ShapeSpec::VertexType vertex_type;
+    ShapeSpec::VertexFormat vertex_format;
+    buffer_object =
+        GetVertexBufferObject(*attribute_array, &vertex_type, &vertex_format);
+    if (vertex_type != spec.vertex_type ||
+        vertex_format != spec.vertex_format)
+      buffer_object.Reset(NULL);
+  }
+  if (!buffer_object.Get()) {
+    buffer_object.Reset(new(spec.allocator) gfx::BufferObject);
+    shape->SetAttributeArray(BuildAttributeArray(spec, buffer_object));
+  }
+  const size_t vertex_size =
+      GetVertexSize(spec.vertex_type, spec.vertex_format);
+  const base::DataContainerPtr vertices = GetReusableDataContainer(
+      spec, buffer_object.Get(), vertex_count * vertex_size);
+  fill_vertices(vertices->GetMutableData<uint8>());
+  buffer_object->SetData(vertices, vertex_size, vertex_count, spec.usage_mode);
+
+  gfx::IndexBufferPtr index_buffer = shape->GetIndexBuffer();
+  if (!index_buffer.Get() || index_buffer->GetSpecCount() != 1U ||
+      index_buffer->GetSpec(0).type != gfx::BufferObject::kUnsignedShort) {
+    index_buffer.Reset(new(spec.allocator) gfx::IndexBuffer);
+    index_buffer->AddSpec(gfx::BufferObject::kUnsignedShort, 1, 0);
+    shape->SetIndexBuffer(index_buffer);
+  }
+  const base::DataContainerPtr indices = GetReusableDataContainer(
+      spec, index_buffer.Get(), index_count * sizeof(uint16));
+  fill_indices(indices->GetMutableData<uint16>());
+  index_buffer->SetData(indices, sizeof(uint16), index_count,
+                        spec.usage_mode);
+}
+
 }  // anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -1249,18 +2427,108 @@ const gfx::ShapePtr LoadExternalShape(const ExternalShapeSpec& spec,
                                       std::istream& in) {  // NOLINT
   Mesh mesh;
   LoadExternalShapeData(spec.format, in, &mesh);
+  return BuildExternalShape(spec, mesh);
+}
 
-  // If there are no vertices or indices then there is nothing to return.
-  if (mesh.mIndices.empty() || mesh.mVertices.empty())
+const gfx::ShapePtr LoadExternalShapeFromData(const ExternalShapeSpec& spec,
+                                              const void* data, size_t size,
+                                              base::TaskScheduler* scheduler) {
+  const char* text = static_cast<const char*>(data);
+  Mesh mesh;
+  switch (spec.format) {
+    case ExternalShapeSpec::kIonMesh: {
+      const bool is_wipeable = IsWipeable(spec);
+      return BuildIonMeshShape(
+          spec, data, size,
+          [text, is_wipeable, &spec](size_t offset, size_t length) {
+            return base::DataContainer::CreateAndCopy<uint8>(
+                reinterpret_cast<const uint8*>(text + offset), length,
+                is_wipeable, spec.allocator);
+          });
+    }
+    case ExternalShapeSpec::kObj:
+      if (!ParseObjData(text, size, GetShortTermAllocator(spec.allocator),
+                        scheduler, &mesh))
+        return gfx::ShapePtr();
+      break;
+    case ExternalShapeSpec::kOff:
+      if (!ParseOffData(text, size, &mesh))
+        return gfx::ShapePtr();
+      break;
+    default: {
+      std::istringstream in(std::string(text, size));
+      LoadExternalShapeData(spec.format, in, &mesh);
+      break;
+    }
+  }
+  return BuildExternalShape(spec, mesh);
+}
+
+const gfx::ShapePtr LoadExternalShapeFromFile(const ExternalShapeSpec& spec,
+                                              const std::string& path,
+                                              base::TaskScheduler* scheduler) {
+  base::DataContainer::MappedFilePtr file(new port::MemoryMappedFile(path));
+  if (!file->GetData()) {
+    LOG(ERROR) << "Unable to map external geometry file \"" << path << "\".";
     return gfx::ShapePtr();
+  }
+  if (spec.format == ExternalShapeSpec::kIonMesh) {
+    const bool is_wipeable = IsWipeable(spec);
+    return BuildIonMeshShape(
+        spec, file->GetData(), file->GetLength(),
+        [&file, is_wipeable, &spec](size_t offset, size_t length) {
+          return base::DataContainer::CreateFromMappedFile(
+              file, offset, length, is_wipeable, spec.allocator);
+        });
+  }
+  return LoadExternalShapeFromData(spec, file->GetData(), file->GetLength(),
+                                   scheduler);
+}
 
-  gfx::BufferObjectPtr buffer_object = BuildExternalBufferObject(spec, mesh);
-  gfx::ShapePtr shape(new(spec.allocator) gfx::Shape);
-  shape->SetLabel("External geometry");
-  shape->SetPrimitiveType(gfx::Shape::kTriangles);
-  shape->SetAttributeArray(BuildAttributeArray(spec, buffer_object));
-  shape->SetIndexBuffer(BuildExternalIndexBuffer(spec, mesh));
-  return shape;
+bool SaveIonMesh(const gfx::ShapePtr& shape, std::ostream& out) {  // NOLINT
+  if (!shape.Get() || shape->GetPrimitiveType() != gfx::Shape::kTriangles ||
+      !shape->GetAttributeArray().Get() || !shape->GetIndexBuffer().Get()) {
+    LOG(ERROR) << "Only indexed triangle Shapes can be saved as Ion meshes.";
+    return false;
+  }
+  const gfx::AttributeArrayPtr& attribute_array = shape->GetAttributeArray();
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  ShapeSpec::VertexType vertex_type;
+  ShapeSpec::VertexFormat vertex_format;
+  const gfx::BufferObjectPtr buffer_object =
+      GetVertexBufferObject(*attribute_array, &vertex_type, &vertex_format);
+
+  IonMeshHeader header;
+  memcpy(header.magic, kIonMeshMagic, sizeof(kIonMeshMagic));
+  header.version = kIonMeshVersion;
+  header.vertex_type = vertex_type;
+  header.vertex_format = vertex_format;
+  const gfx::BufferObject::Spec& index_spec = index_buffer->GetSpec(0);
+  header.index_size =
+      index_spec.type == gfx::BufferObject::kUnsignedShort ?
+      ExternalShapeSpec::k16Bit : ExternalShapeSpec::k32Bit;
+  if (!buffer_object.Get() ||
+      (index_spec.type != gfx::BufferObject::kUnsignedShort &&
+       index_spec.type != gfx::BufferObject::kUnsignedInt)) {
+    LOG(ERROR) << "Shape does not have the vertex or index types of an Ion"
+               << " mesh.";
+    return false;
+  }
+  const base::DataContainerPtr& vertices = buffer_object->GetData();
+  const base::DataContainerPtr& indices = index_buffer->GetData();
+  if (!vertices.Get() || !vertices->GetData() || !indices.Get() ||
+      !indices->GetData()) {
+    LOG(ERROR) << "Shape data is missing or has been wiped.";
+    return false;
+  }
+  header.vertex_count = static_cast<uint32>(buffer_object->GetCount());
+  header.index_count = static_cast<uint32>(index_buffer->GetCount());
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(vertices->GetData<char>(),
+            header.vertex_count * buffer_object->GetStructSize());
+  out.write(indices->GetData<char>(),
+            header.index_count * index_buffer->GetStructSize());
+  return static_cast<bool>(out);
 }
 
 const gfx::ShapePtr BuildRectangleShape(const RectangleSpec& spec) {
@@ -1303,6 +2571,40 @@ const gfx::ShapePtr BuildEllipsoidShape(const EllipsoidSpec& spec) {
   return shape;
 }
 
+void UpdateEllipsoidShape(const EllipsoidSpec& spec,
+                          base::TaskScheduler* scheduler,
+                          const gfx::ShapePtr& shape) {
+  DCHECK(shape.Get());
+  const EllipsoidData data = GetEllipsoidData(spec);
+  base::AllocVector<Point2f> ring_points(GetShortTermAllocator(spec.allocator),
+                                         data.vertices_per_ring,
+                                         Point2f::Zero());
+  GetPartialCirclePoints(data.sector_count, spec.longitude_start,
+                         spec.longitude_end, &ring_points[0]);
+  UpdateShape(
+      spec, "Ellipsoid", data.vertex_count,
+      [&](uint8* vertices) {
+        GenerateVertexRows(
+            spec, data.band_count + 1U, data.vertices_per_ring,
+            [&](size_t first_ring, size_t end_ring, VertexPTN ring_vertices[]) {
+              GetEllipsoidVertices(spec, data, &ring_points[0], first_ring,
+                                   end_ring, ring_vertices);
+            },
+            scheduler, vertices);
+      },
+      GetEllipsoidIndexCount(data),
+      [&](uint16* indices) {
+        GenerateIndexRows(
+            data.band_count, 6U * data.sector_count,
+            [&](size_t first_band, size_t end_band, uint16 band_indices[]) {
+              GetBandIndices(data.vertices_per_ring, data.sector_count,
+                             first_band, end_band, band_indices);
+            },
+            scheduler, indices);
+      },
+      shape);
+}
+
 const gfx::ShapePtr BuildCylinderShape(const CylinderSpec& spec) {
   gfx::ShapePtr shape(new(spec.allocator) gfx::Shape);
   shape->SetLabel("Cylinder");
@@ -1313,5 +2615,64 @@ const gfx::ShapePtr BuildCylinderShape(const CylinderSpec& spec) {
   return shape;
 }
 
+void UpdateCylinderShape(const CylinderSpec& spec,
+                         base::TaskScheduler* scheduler,
+                         const gfx::ShapePtr& shape) {
+  DCHECK(shape.Get());
+  const base::AllocatorPtr& allocator = GetShortTermAllocator(spec.allocator);
+  const CylinderData data = GetCylinderData(spec);
+  base::AllocVector<Point2f> ring_points(allocator, data.vertices_per_ring,
+                                         Point2f::Zero());
+  GetCirclePoints(data.sector_count, &ring_points[0]);
+  base::AllocVector<Vector3f> shaft_normals(allocator, data.vertices_per_ring,
+                                            Vector3f::Zero());
+  GetCylinderShaftNormals(data.vertices_per_ring, &ring_points[0],
+                          spec.top_radius, spec.bottom_radius, spec.height,
+                          &shaft_normals[0]);
+  const size_t vertex_size =
+      GetVertexSize(spec.vertex_type, spec.vertex_format);
+  const size_t shaft_index_count = GetCylinderShaftIndexCount(data);
+  UpdateShape(
+      spec, "Cylinder", data.vertex_count,
+      [&](uint8* vertices) {
+        GenerateVertexRows(
+            spec, data.shaft_band_count + 1U, data.vertices_per_ring,
+            [&](size_t first_ring, size_t end_ring, VertexPTN ring_vertices[]) {
+              GetCylinderShaftVertices(spec, data, &ring_points[0],
+                                       &shaft_normals[0], first_ring, end_ring,
+                                       ring_vertices);
+            },
+            scheduler, vertices);
+        // The caps are small enough to be generated on this thread, each as a
+        // single row.
+        uint8* cap_vertices = vertices + data.shaft_vertex_count * vertex_size;
+        for (int i = 0; i < 2; ++i) {
+          const bool is_top = i == 0;
+          if (!(is_top ? data.add_top_cap : data.add_bottom_cap))
+            continue;
+          GenerateVertexRows(
+              spec, 1U, data.cap_vertex_count,
+              [&](size_t, size_t, VertexPTN cap_vertices_ptn[]) {
+                AddCylinderCapVertices(spec, &ring_points[0], is_top,
+                                       cap_vertices_ptn);
+              },
+              NULL, cap_vertices);
+          cap_vertices += data.cap_vertex_count * vertex_size;
+        }
+      },
+      GetCylinderIndexCount(data),
+      [&](uint16* indices) {
+        GenerateIndexRows(
+            data.shaft_band_count, 6U * data.sector_count,
+            [&](size_t first_band, size_t end_band, uint16 band_indices[]) {
+              GetBandIndices(data.vertices_per_ring, data.sector_count,
+                             first_band, end_band, band_indices);
+            },
+            scheduler, indices);
+        GetCylinderCapIndices(data, &indices[shaft_index_count]);
+      },
+      shape);
+}
+
 }  // namespace gfxutils
 }  // namespace ion
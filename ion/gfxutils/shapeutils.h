@@ -23,6 +23,8 @@ limitations under the License.
 
 #include <functional>
 #include <istream>  // NOLINT
+#include <ostream>  // NOLINT
+#include <string>
 
 #include "ion/base/allocator.h"
 #include "ion/gfx/bufferobject.h"
@@ -33,6 +35,10 @@ limitations under the License.
 #include "ion/math/vector.h"
 
 namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
 namespace gfxutils {
 
 // This struct contains specifications common to all basic shapes. Default
@@ -47,10 +53,24 @@ struct ShapeSpec {
     kPositionNormal,           // Position and normal.
     kPositionTexCoordsNormal,  // Position, texture coordinates, and normal.
   };
+  // This enum specifies how the per-vertex attributes are stored. With
+  // kCompactVertices, "aVertex" holds four normalized shorts, which are the
+  // position divided by compact_position_scale with a w of 1, "aTexCoords"
+  // holds two normalized unsigned shorts, and "aNormal" holds four normalized
+  // bytes with a w of 0. This halves the size of the vertices. Shaders must
+  // scale positions back by compact_position_scale, e.g., with a uniform or as
+  // part of the model matrix. Positions beyond that scale and texture
+  // coordinates outside of [0, 1] are clamped.
+  enum VertexFormat {
+    kFloatVertices,    // 32-bit float components.
+    kCompactVertices,  // Normalized 8-bit and 16-bit components.
+  };
   ShapeSpec() : translation(math::Point3f::Zero()),
                 scale(1.f),
                 rotation(math::Matrix3f::Identity()),
                 vertex_type(kPositionTexCoordsNormal),
+                vertex_format(kFloatVertices),
+                compact_position_scale(1.f),
                 usage_mode(gfx::BufferObject::kStaticDraw) {}
   base::AllocatorPtr allocator;  // Used for all allocations (NULL).
   // The order of operations is: scale, then rotate, then translate.
@@ -58,6 +78,9 @@ struct ShapeSpec {
   float scale;                   // Scale factor (1).
   math::Matrix3f rotation;       // Rotation (Identity).
   VertexType vertex_type;        // Type of vertices (kPositionTexCoordsNormal).
+  VertexFormat vertex_format;    // Storage of attributes (kFloatVertices).
+  // The largest absolute position coordinate of kCompactVertices (1).
+  float compact_position_scale;
   // UsageMode for all created BufferObject instances. This also affects
   // whether data is considered wipeable. (gfx::BufferObject::kStaticDraw).
   gfx::BufferObject::UsageMode usage_mode;
@@ -94,13 +117,15 @@ struct ExternalShapeSpec : public ShapeSpec {
     kLwo,      // Lightwave Object format.
     kObj,      // Wavefront Object format.
     kOff,      // Geomview file format.
+    kIonMesh,  // Ion binary mesh format, see SaveIonMesh().
     kUnknown,  // Used as initial value in spec.
   };
   // The size of the vertex index data type. Some platforms (OpenGL ES2) don't
   // support 32-bit indices, resulting in an error when the shape is drawn.
   enum IndexSize {
-    k16Bit,  // 16-bit indices (unsigned short integer).
-    k32Bit,  // 32-bit indices (unsigned integer).
+    k16Bit,      // 16-bit indices (unsigned short integer).
+    k32Bit,      // 32-bit indices (unsigned integer).
+    kAutomatic,  // 16-bit indices if the vertex count allows, else 32-bit.
   };
   ExternalShapeSpec()
       : format(kUnknown), center_at_origin(true), index_size(k16Bit) {}
@@ -121,6 +146,46 @@ struct ExternalShapeSpec : public ShapeSpec {
 ION_API const gfx::ShapePtr LoadExternalShape(const ExternalShapeSpec& spec,
                                               std::istream& in);  // NOLINT
 
+// Same as LoadExternalShape(), but loads the Shape from |size| bytes of
+// in-memory |data|. kObj and kOff data are parsed directly from memory without
+// going through a stream, which is much faster for large models; the result
+// is the same as that of LoadExternalShape(). If |scheduler| is not NULL, kObj
+// data is split into chunks of lines that are parsed in parallel on its
+// threads. kIonMesh data is copied into the Shape without any parsing; see
+// SaveIonMesh(). Other formats are read through a stream over |data|.
+ION_API const gfx::ShapePtr LoadExternalShapeFromData(
+    const ExternalShapeSpec& spec, const void* data, size_t size,
+    base::TaskScheduler* scheduler);
+
+// Same as LoadExternalShapeFromData(), but memory-maps the file at |path|
+// instead of reading it. The vertex and index DataContainers of a kIonMesh
+// Shape point directly into the mapping, which stays alive until they are
+// destroyed or wiped. Returns a NULL Shape if the file cannot be mapped.
+ION_API const gfx::ShapePtr LoadExternalShapeFromFile(
+    const ExternalShapeSpec& spec, const std::string& path,
+    base::TaskScheduler* scheduler);
+
+// Writes |shape| to |out| in the kIonMesh format, which stores the vertex and
+// index data exactly as they are laid out in the Shape's BufferObject and
+// IndexBuffer, so that loading it needs no parsing. The Shape must have
+// triangle primitives, an IndexBuffer with 16- or 32-bit indices, and a single
+// vertex BufferObject with one of the vertex types of ShapeSpec, as created by
+// the functions in this file. Since the data must still be present, a Shape
+// with wipeable data must be saved before it is rendered. Loading the saved
+// Shape ignores the vertex_type, vertex_format, index_size, center_at_origin
+// and transform settings of the ExternalShapeSpec, since they were applied
+// when the Shape was built. In particular, compact positions are still
+// divided by the compact_position_scale the Shape was built with. Returns
+// false and writes nothing if the Shape is unsuitable.
+//
+// The format is a 28-byte header of seven native-endian 32-bit fields: the
+// magic number "IMSH", a version number, the ShapeSpec::VertexType, the
+// ShapeSpec::VertexFormat, the ExternalShapeSpec::IndexSize, the vertex count,
+// and the index count. The header is followed by the vertex data and then the
+// index data.
+ION_API bool SaveIonMesh(const gfx::ShapePtr& shape,
+                         std::ostream& out);  // NOLINT
+
 //-----------------------------------------------------------------------------
 //
 // Planar shape.
@@ -243,6 +308,19 @@ struct EllipsoidSpec : public ShapeSpec {
 // Builds and returns a Shape representing an axis-aligned ellipsoid.
 ION_API const gfx::ShapePtr BuildEllipsoidShape(const EllipsoidSpec& spec);
 
+// Same as BuildEllipsoidShape(), but stores the ellipsoid in an existing Shape
+// instead, for shapes that change often, e.g., every frame. If |shape| already
+// has vertices of the vertex type and format in |spec| and 16-bit indices,
+// such as from an earlier call, their AttributeArray, BufferObject and
+// IndexBuffer are reused, as is the memory of their DataContainers if it is
+// large enough. Otherwise they are replaced. Since wiped data cannot be
+// reused, |spec| should have a usage_mode other than kStaticDraw. If
+// |scheduler| is not NULL, the vertices and indices of large ellipsoids are
+// generated in parallel ranges of bands on its threads.
+ION_API void UpdateEllipsoidShape(const EllipsoidSpec& spec,
+                                  base::TaskScheduler* scheduler,
+                                  const gfx::ShapePtr& shape);
+
 //-----------------------------------------------------------------------------
 //
 // Cylinder.
@@ -287,6 +365,13 @@ struct CylinderSpec : public ShapeSpec {
 // Builds and returns a Shape representing an axis-aligned cylinder.
 ION_API const gfx::ShapePtr BuildCylinderShape(const CylinderSpec& spec);
 
+// Same as BuildCylinderShape(), but stores the cylinder in an existing Shape.
+// See UpdateEllipsoidShape() for how |shape| and |scheduler| are used; only
+// the shaft is generated in parallel.
+ION_API void UpdateCylinderShape(const CylinderSpec& spec,
+                                 base::TaskScheduler* scheduler,
+                                 const gfx::ShapePtr& shape);
+
 }  // namespace gfxutils
 }  // namespace ion
 
@@ -0,0 +1,248 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/attributelayout.h"
+
+#include <string.h>  // For memcmp().
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/math/vector.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+static const size_t kVertexCount = 4U;
+
+// Returns a BufferObject holding |count| copies of T starting at |values|.
+template <typename T>
+static const gfx::BufferObjectPtr BuildBufferObject(const T* values,
+                                                    size_t count) {
+  gfx::BufferObjectPtr buffer_object(new gfx::BufferObject);
+  buffer_object->SetData(base::DataContainer::CreateAndCopy<T>(
+                             values, count, true, base::AllocatorPtr()),
+                         sizeof(T), count, gfx::BufferObject::kStaticDraw);
+  return buffer_object;
+}
+
+// Returns the BufferObjectElement of the attribute at |index|.
+static const gfx::BufferObjectElement& GetElement(
+    const gfx::AttributeArrayPtr& attribute_array, size_t index) {
+  return attribute_array->GetAttribute(index)
+      .GetValue<gfx::BufferObjectElement>();
+}
+
+// Returns whether the attribute at |index| holds kVertexCount values of
+// |size| bytes equal to those at |expected|.
+static bool HasValues(const gfx::AttributeArrayPtr& attribute_array,
+                      size_t index, const void* expected, size_t size) {
+  const gfx::BufferObjectElement& element = GetElement(attribute_array, index);
+  const gfx::BufferObject& buffer_object = *element.buffer_object;
+  const gfx::BufferObject::Spec& spec =
+      buffer_object.GetSpec(element.spec_index);
+  const uint8* data =
+      buffer_object.GetData()->GetData<uint8>() + spec.byte_offset;
+  const uint8* expected_data = static_cast<const uint8*>(expected);
+  for (size_t i = 0; i < buffer_object.GetCount(); ++i) {
+    if (memcmp(data + i * buffer_object.GetStructSize(),
+               expected_data + i * size, size))
+      return false;
+  }
+  return buffer_object.GetCount() == kVertexCount;
+}
+
+// Test fixture that builds an AttributeArray with a separate BufferObject
+// for each of three per-vertex attributes, an instanced attribute, and a
+// simple attribute.
+class AttributeLayoutTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (size_t i = 0; i < kVertexCount; ++i) {
+      const float f = static_cast<float>(i);
+      const uint8 b = static_cast<uint8>(i);
+      const uint16 s = static_cast<uint16>(i);
+      positions_[i].Set(f, f + 0.5f, -f);
+      colors_[i].Set(b, static_cast<uint8>(b + 10U), static_cast<uint8>(255U));
+      tex_coords_[i].Set(s, static_cast<uint16>(1000U + s));
+    }
+    const float offsets[2] = { 1.f, 2.f };
+
+    gfx::ShaderInputRegistryPtr reg(new gfx::ShaderInputRegistry);
+    reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+        "aPosition", gfx::kBufferObjectElementAttribute, ""));
+    reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+        "aColor", gfx::kBufferObjectElementAttribute, ""));
+    reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+        "aTexCoords", gfx::kBufferObjectElementAttribute, ""));
+    reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+        "aOffset", gfx::kBufferObjectElementAttribute, ""));
+    reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+        "aScale", gfx::kFloatAttribute, ""));
+
+    positions_buffer_ = BuildBufferObject(positions_, kVertexCount);
+    offsets_buffer_ = BuildBufferObject(offsets, 2U);
+    const gfx::BufferObjectPtr colors_buffer =
+        BuildBufferObject(colors_, kVertexCount);
+    const gfx::BufferObjectPtr tex_coords_buffer =
+        BuildBufferObject(tex_coords_, kVertexCount);
+
+    attribute_array_ = new gfx::AttributeArray;
+    attribute_array_->AddAttribute(reg->Create<gfx::Attribute>(
+        "aPosition", gfx::BufferObjectElement(
+            positions_buffer_, positions_buffer_->AddSpec(
+                gfx::BufferObject::kFloat, 3, 0))));
+    gfx::Attribute color = reg->Create<gfx::Attribute>(
+        "aColor", gfx::BufferObjectElement(
+            colors_buffer, colors_buffer->AddSpec(
+                gfx::BufferObject::kUnsignedByte, 3, 0)));
+    color.SetFixedPointNormalized(true);
+    attribute_array_->AddAttribute(color);
+    attribute_array_->AddAttribute(reg->Create<gfx::Attribute>(
+        "aTexCoords", gfx::BufferObjectElement(
+            tex_coords_buffer, tex_coords_buffer->AddSpec(
+                gfx::BufferObject::kUnsignedShort, 2, 0))));
+    gfx::Attribute offset = reg->Create<gfx::Attribute>(
+        "aOffset", gfx::BufferObjectElement(
+            offsets_buffer_, offsets_buffer_->AddSpec(
+                gfx::BufferObject::kFloat, 1, 0)));
+    offset.SetDivisor(1U);
+    attribute_array_->AddAttribute(offset);
+    attribute_array_->AddAttribute(reg->Create<gfx::Attribute>("aScale", 2.f));
+    attribute_array_->EnableAttribute(2U, false);
+  }
+
+  // Checks that the attributes still hold their values and settings.
+  void CheckAttributes() {
+    EXPECT_TRUE(HasValues(attribute_array_, 0U, positions_,
+                          sizeof(positions_[0])));
+    EXPECT_TRUE(HasValues(attribute_array_, 1U, colors_, sizeof(colors_[0])));
+    EXPECT_TRUE(HasValues(attribute_array_, 2U, tex_coords_,
+                          sizeof(tex_coords_[0])));
+    EXPECT_TRUE(attribute_array_->GetAttribute(1U).IsFixedPointNormalized());
+    EXPECT_TRUE(attribute_array_->IsAttributeEnabled(0U));
+    EXPECT_FALSE(attribute_array_->IsAttributeEnabled(2U));
+    // The instanced and simple attributes are unchanged.
+    EXPECT_EQ(offsets_buffer_.Get(),
+              GetElement(attribute_array_, 3U).buffer_object.Get());
+    EXPECT_EQ(1U, attribute_array_->GetAttribute(3U).GetDivisor());
+    EXPECT_EQ(2.f, attribute_array_->GetAttribute(4U).GetValue<float>());
+  }
+
+  math::Point3f positions_[kVertexCount];
+  math::Vector3ui8 colors_[kVertexCount];
+  math::Vector2ui16 tex_coords_[kVertexCount];
+  gfx::BufferObjectPtr positions_buffer_;
+  gfx::BufferObjectPtr offsets_buffer_;
+  gfx::AttributeArrayPtr attribute_array_;
+};
+
+}  // anonymous namespace
+
+TEST_F(AttributeLayoutTest, InterleaveAttributes) {
+  base::LogChecker log_checker;
+  EXPECT_TRUE(InterleaveAttributes(attribute_array_));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  CheckAttributes();
+
+  // The three elements share one BufferObject, with the colors padded to 4
+  // bytes.
+  const gfx::BufferObjectPtr& buffer_object =
+      GetElement(attribute_array_, 0U).buffer_object;
+  EXPECT_NE(positions_buffer_.Get(), buffer_object.Get());
+  EXPECT_EQ(buffer_object.Get(),
+            GetElement(attribute_array_, 1U).buffer_object.Get());
+  EXPECT_EQ(buffer_object.Get(),
+            GetElement(attribute_array_, 2U).buffer_object.Get());
+  EXPECT_EQ(20U, buffer_object->GetStructSize());
+  EXPECT_EQ(kVertexCount, buffer_object->GetCount());
+  EXPECT_EQ(gfx::BufferObject::kStaticDraw, buffer_object->GetUsageMode());
+  EXPECT_TRUE(buffer_object->GetData()->IsWipeable());
+  ASSERT_EQ(3U, buffer_object->GetSpecCount());
+  EXPECT_EQ(0U, buffer_object->GetSpec(0U).byte_offset);
+  EXPECT_EQ(12U, buffer_object->GetSpec(1U).byte_offset);
+  EXPECT_EQ(16U, buffer_object->GetSpec(2U).byte_offset);
+  // The original BufferObjects are not changed.
+  EXPECT_EQ(sizeof(positions_[0]), positions_buffer_->GetStructSize());
+  EXPECT_EQ(1U, positions_buffer_->GetSpecCount());
+}
+
+TEST_F(AttributeLayoutTest, DeinterleaveAttributes) {
+  base::LogChecker log_checker;
+  // Tightly packed elements stay where they are, while the colors are moved
+  // to a BufferObject with a padded stride.
+  EXPECT_TRUE(DeinterleaveAttributes(attribute_array_));
+  CheckAttributes();
+  EXPECT_EQ(positions_buffer_.Get(),
+            GetElement(attribute_array_, 0U).buffer_object.Get());
+  EXPECT_EQ(4U,
+            GetElement(attribute_array_, 1U).buffer_object->GetStructSize());
+
+  // Interleaved elements are each moved to their own BufferObject.
+  EXPECT_TRUE(InterleaveAttributes(attribute_array_));
+  EXPECT_TRUE(DeinterleaveAttributes(attribute_array_));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+  CheckAttributes();
+  const size_t strides[3] = { 12U, 4U, 4U };
+  for (size_t i = 0; i < 3U; ++i) {
+    SCOPED_TRACE(::testing::Message() << "Attribute " << i);
+    const gfx::BufferObjectElement& element =
+        GetElement(attribute_array_, i);
+    EXPECT_EQ(strides[i], element.buffer_object->GetStructSize());
+    ASSERT_EQ(1U, element.buffer_object->GetSpecCount());
+    EXPECT_EQ(0U, element.buffer_object->GetSpec(0U).byte_offset);
+  }
+  EXPECT_NE(GetElement(attribute_array_, 1U).buffer_object.Get(),
+            GetElement(attribute_array_, 2U).buffer_object.Get());
+}
+
+TEST_F(AttributeLayoutTest, InvalidAttributeArrays) {
+  base::LogChecker log_checker;
+  EXPECT_FALSE(InterleaveAttributes(gfx::AttributeArrayPtr()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "AttributeArray is NULL"));
+  EXPECT_FALSE(DeinterleaveAttributes(gfx::AttributeArrayPtr()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "AttributeArray is NULL"));
+
+  gfx::AttributeArrayPtr simple_array(new gfx::AttributeArray);
+  simple_array->AddAttribute(attribute_array_->GetAttribute(4U));
+  EXPECT_FALSE(InterleaveAttributes(simple_array));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no per-vertex buffer"));
+
+  // BufferObjects with different counts cannot be interleaved.
+  const math::Point3f extra_positions[kVertexCount + 1U];
+  positions_buffer_->SetData(
+      base::DataContainer::CreateAndCopy<math::Point3f>(
+          extra_positions, kVertexCount + 1U, true, base::AllocatorPtr()),
+      sizeof(extra_positions[0]), kVertexCount + 1U,
+      gfx::BufferObject::kStaticDraw);
+  EXPECT_FALSE(InterleaveAttributes(attribute_array_));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must all have the same count"));
+  EXPECT_EQ(positions_buffer_.Get(),
+            GetElement(attribute_array_, 0U).buffer_object.Get());
+
+  positions_buffer_->GetData()->WipeData();
+  EXPECT_FALSE(InterleaveAttributes(attribute_array_));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must all have data"));
+  EXPECT_FALSE(DeinterleaveAttributes(attribute_array_));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must all have data"));
+}
+
+}  // namespace gfxutils
+}  // namespace ion
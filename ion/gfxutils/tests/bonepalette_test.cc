@@ -0,0 +1,312 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/bonepalette.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "ion/math/matrixutils.h"
+#include "ion/math/transformutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// A skeleton with a root bone and two bones chained to it.
+static const int kParents[] = { -1, 0, 1 };
+static const size_t kBoneCount = 3U;
+
+static const std::vector<math::Matrix4f> GetInverseBindMatrices() {
+  std::vector<math::Matrix4f> matrices;
+  for (size_t i = 0; i < kBoneCount; ++i) {
+    matrices.push_back(math::TranslationMatrix(
+        math::Vector3f(0.f, -static_cast<float>(i), 0.f)));
+  }
+  return matrices;
+}
+
+// Returns the local transforms of the bones of an instance, which vary with
+// the instance.
+static const std::vector<math::Matrix4f> GetLocalTransforms(size_t instance) {
+  std::vector<math::Matrix4f> matrices;
+  const float f = static_cast<float>(instance);
+  for (size_t i = 0; i < kBoneCount; ++i) {
+    matrices.push_back(
+        math::TranslationMatrix(math::Vector3f(f, i ? 1.f : 0.f, 0.f)) *
+        math::RotationMatrixAxisAngleH(
+            math::Vector3f::AxisZ(),
+            math::Anglef::FromDegrees(10.f * f + static_cast<float>(i))));
+  }
+  return matrices;
+}
+
+// Returns a row of the palette stored in a uniform array.
+static const math::Vector4f GetRow(const gfx::Uniform& uniform, size_t index) {
+  const math::VectorBase4f& v = uniform.GetValueAt<math::VectorBase4f>(index);
+  return math::Vector4f(v[0], v[1], v[2], v[3]);
+}
+
+// Returns a Shape drawing a triangle.
+static const gfx::ShapePtr CreateTriangle(
+    const gfx::ShaderInputRegistryPtr& reg) {
+  const math::Point3f vertices[3] = {
+      math::Point3f::Zero(), math::Point3f(1.f, 0.f, 0.f),
+      math::Point3f(0.f, 1.f, 0.f)};
+  gfx::BufferObjectPtr buffer(new gfx::BufferObject);
+  buffer->SetData(base::DataContainer::CreateAndCopy<math::Point3f>(
+                      vertices, 3U, false, buffer->GetAllocator()),
+                  sizeof(vertices[0]), 3U, gfx::BufferObject::kStaticDraw);
+  gfx::AttributeArrayPtr aa(new gfx::AttributeArray);
+  aa->AddAttribute(reg->Create<gfx::Attribute>(
+      "aVertex",
+      gfx::BufferObjectElement(
+          buffer, buffer->AddSpec(gfx::BufferObject::kFloat, 3, 0))));
+  gfx::ShapePtr shape(new gfx::Shape);
+  shape->SetAttributeArray(aa);
+  return shape;
+}
+
+static const gfx::ShaderInputRegistryPtr CreateRegistry() {
+  gfx::ShaderInputRegistryPtr reg(new gfx::ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  return reg;
+}
+
+}  // anonymous namespace
+
+TEST(BonePaletteTest, TextureStorage) {
+  base::LogChecker log_checker;
+  BonePalette palette(kBoneCount, 4U, BonePalette::kTextureStorage,
+                      CreateRegistry(), base::AllocatorPtr());
+  EXPECT_EQ(kBoneCount, palette.GetBoneCount());
+  EXPECT_EQ(4U, palette.GetInstanceCount());
+  EXPECT_EQ(BonePalette::kTextureStorage, palette.GetStorage());
+  EXPECT_FALSE(palette.GetUniformBlock().Get());
+  const gfx::TexturePtr& texture = palette.GetTexture();
+  ASSERT_TRUE(texture.Get());
+  ASSERT_TRUE(texture->GetImmutableImage().Get());
+  EXPECT_EQ(gfx::Image::kRgba32f, texture->GetImmutableImage()->GetFormat());
+  EXPECT_EQ(9U, texture->GetImmutableImage()->GetWidth());
+  EXPECT_EQ(4U, texture->GetImmutableImage()->GetHeight());
+  EXPECT_EQ(math::Matrix4f::Identity(), palette.GetBoneMatrix(3U, 2U));
+
+  // The first update uploads all instances.
+  palette.Update();
+  ASSERT_EQ(1U, texture->GetSubImages().size());
+  EXPECT_EQ(math::Point3ui::Zero(), texture->GetSubImages()[0].offset);
+  EXPECT_EQ(4U, texture->GetSubImages()[0].image->GetHeight());
+  texture->ClearSubImages();
+
+  // Only the range of changed instances is uploaded.
+  const math::Matrix4f m =
+      math::TranslationMatrix(math::Vector3f(1.f, 2.f, 3.f));
+  const std::vector<math::Matrix4f> matrices(kBoneCount, m);
+  palette.SetBoneMatrices(1U, matrices.data());
+  palette.SetBoneMatrices(2U, matrices.data());
+  EXPECT_EQ(m, palette.GetBoneMatrix(1U, 0U));
+  EXPECT_EQ(m, palette.GetBoneMatrix(2U, 2U));
+  EXPECT_EQ(math::Matrix4f::Identity(), palette.GetBoneMatrix(3U, 0U));
+  palette.Update();
+  ASSERT_EQ(1U, texture->GetSubImages().size());
+  const gfx::Texture::SubImage& sub_image = texture->GetSubImages()[0];
+  EXPECT_EQ(math::Point3ui(0U, 1U, 0U), sub_image.offset);
+  EXPECT_EQ(9U, sub_image.image->GetWidth());
+  EXPECT_EQ(2U, sub_image.image->GetHeight());
+  const float* data = sub_image.image->GetData()->GetData<float>();
+  // The top three rows of the first matrix.
+  EXPECT_EQ(1.f, data[0]);
+  EXPECT_EQ(1.f, data[3]);
+  EXPECT_EQ(2.f, data[7]);
+  EXPECT_EQ(3.f, data[11]);
+  texture->ClearSubImages();
+
+  // Nothing is uploaded without changes.
+  palette.Update();
+  EXPECT_TRUE(texture->GetSubImages().empty());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  palette.SetBoneMatrices(4U, matrices.data());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid instance"));
+  EXPECT_EQ(math::Matrix4f::Identity(), palette.GetBoneMatrix(4U, 0U));
+  EXPECT_EQ(math::Matrix4f::Identity(), palette.GetBoneMatrix(0U, 3U));
+}
+
+TEST(BonePaletteTest, SetPoses) {
+  base::LogChecker log_checker;
+  const size_t kInstanceCount = 6U;
+  BonePalette palette(kBoneCount, kInstanceCount, BonePalette::kTextureStorage,
+                      CreateRegistry(), base::AllocatorPtr());
+  std::vector<math::Matrix4f> locals;
+  for (size_t i = 0; i < kInstanceCount; ++i) {
+    const std::vector<math::Matrix4f> instance_locals = GetLocalTransforms(i);
+    locals.insert(locals.end(), instance_locals.begin(),
+                  instance_locals.end());
+  }
+
+  // A skeleton is needed.
+  palette.SetPoses(0U, kInstanceCount, locals.data(), NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "skeleton must be set"));
+  const std::vector<math::Matrix4f> inverse_binds = GetInverseBindMatrices();
+  const int kBadParents[] = { -1, 2, 0 };
+  palette.SetSkeleton(kBadParents, inverse_binds.data());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "parent of bone 1 must precede"));
+  palette.SetPoses(0U, kInstanceCount, locals.data(), NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "skeleton must be set"));
+
+  palette.SetSkeleton(kParents, inverse_binds.data());
+  palette.SetPoses(0U, kInstanceCount, locals.data(), NULL);
+  for (size_t i = 0; i < kInstanceCount; ++i) {
+    const math::Matrix4f* l = &locals[i * kBoneCount];
+    const math::Matrix4f expected[kBoneCount] = {
+        l[0] * inverse_binds[0],
+        l[0] * l[1] * inverse_binds[1],
+        l[0] * l[1] * l[2] * inverse_binds[2]};
+    for (size_t bone = 0; bone < kBoneCount; ++bone) {
+      EXPECT_TRUE(math::MatricesAlmostEqual(
+          expected[bone], palette.GetBoneMatrix(i, bone), 1e-5f))
+          << i << " " << bone;
+    }
+  }
+
+  // The instances can be split over threads, with the same results, and a
+  // range of instances can be posed.
+  BonePalette threaded(kBoneCount, kInstanceCount + 1U,
+                       BonePalette::kTextureStorage, CreateRegistry(),
+                       base::AllocatorPtr());
+  threaded.SetSkeleton(kParents, inverse_binds.data());
+  base::TaskScheduler scheduler("bones", 2U);
+  threaded.SetPoses(1U, kInstanceCount, locals.data(), &scheduler);
+  EXPECT_EQ(math::Matrix4f::Identity(), threaded.GetBoneMatrix(0U, 0U));
+  for (size_t i = 0; i < kInstanceCount; ++i) {
+    for (size_t bone = 0; bone < kBoneCount; ++bone) {
+      EXPECT_EQ(palette.GetBoneMatrix(i, bone),
+                threaded.GetBoneMatrix(i + 1U, bone));
+    }
+  }
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  threaded.SetPoses(2U, kInstanceCount, locals.data(), NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid instances 2 to 8"));
+}
+
+TEST(BonePaletteTest, UniformBufferStorage) {
+  base::LogChecker log_checker;
+  BonePalette palette(kBoneCount, 2U, BonePalette::kUniformBufferStorage,
+                      CreateRegistry(), base::AllocatorPtr());
+  EXPECT_FALSE(palette.GetTexture().Get());
+  const gfx::UniformBlockPtr& block = palette.GetUniformBlock();
+  ASSERT_TRUE(block.Get());
+  EXPECT_EQ("BonePalette", block->GetBlockName());
+  ASSERT_EQ(1U, block->GetUniforms().size());
+  const gfx::Uniform& uniform = block->GetUniforms()[0];
+  EXPECT_EQ(18U, uniform.GetCount());
+  EXPECT_EQ(math::Vector4f(1.f, 0.f, 0.f, 0.f),
+            GetRow(uniform, 15U));
+
+  const math::Matrix4f m = math::ScaleMatrixH(math::Vector3f(2.f, 3.f, 4.f));
+  const std::vector<math::Matrix4f> matrices(kBoneCount, m);
+  palette.SetBoneMatrices(1U, matrices.data());
+  const uint64 stamp = uniform.GetStamp();
+  palette.Update();
+  EXPECT_NE(stamp, uniform.GetStamp());
+  EXPECT_EQ(math::Vector4f(1.f, 0.f, 0.f, 0.f),
+            GetRow(uniform, 0U));
+  EXPECT_EQ(math::Vector4f(2.f, 0.f, 0.f, 0.f),
+            GetRow(uniform, 9U));
+  EXPECT_EQ(math::Vector4f(0.f, 0.f, 4.f, 0.f),
+            GetRow(uniform, 17U));
+
+  const std::string source = palette.GetShaderSource();
+  EXPECT_NE(std::string::npos, source.find("uniform BonePalette"));
+  EXPECT_NE(std::string::npos, source.find("vec4 uBonePalette[18];"));
+  EXPECT_NE(std::string::npos, source.find("mat4 GetSkinningMatrix("));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(BonePaletteTest, Draw) {
+  base::LogChecker log_checker;
+  std::unique_ptr<gfx::testing::MockVisual> visual(
+      new gfx::testing::MockVisual(64, 64));
+  gfx::testing::MockGraphicsManagerPtr gm(
+      new gfx::testing::MockGraphicsManager());
+  gfx::testing::TraceVerifier verifier(gm.Get());
+  gfx::RendererPtr renderer(new gfx::Renderer(gm));
+
+  // Draw several instances sharing one palette.
+  const gfx::ShaderInputRegistryPtr reg = CreateRegistry();
+  BonePalette palette(kBoneCount, 3U, BonePalette::kTextureStorage, reg,
+                      base::AllocatorPtr());
+  const std::string vertex_source = palette.GetShaderSource() +
+      "attribute vec3 aVertex;\n"
+      "void main() {\n"
+      "  gl_Position = GetBoneMatrix(0.0) * vec4(aVertex, 1.0);\n"
+      "}\n";
+  gfx::NodePtr root(new gfx::Node);
+  root->SetShaderProgram(gfx::ShaderProgram::BuildFromStrings(
+      "Skinned", reg, vertex_source, "void main() {}\n",
+      base::AllocatorPtr()));
+  palette.AddUniforms(root);
+  const gfx::ShapePtr shape = CreateTriangle(reg);
+  for (size_t i = 0; i < palette.GetInstanceCount(); ++i) {
+    gfx::NodePtr node(new gfx::Node);
+    node->AddUniform(palette.CreateInstanceUniform(i));
+    node->AddShape(shape);
+    root->AddChild(node);
+  }
+  palette.SetSkeleton(kParents, GetInverseBindMatrices().data());
+
+  verifier.Reset();
+  palette.Update();
+  renderer->DrawScene(root);
+  EXPECT_EQ(1U, verifier.GetCountOf("TexStorage2D"));
+  EXPECT_EQ(1U, verifier.GetCountOf("TexSubImage2D"));
+  EXPECT_EQ(3U, verifier.GetCountOf("DrawArrays"));
+
+  // Each frame uploads the changed instances at once.
+  for (int frame = 0; frame < 2; ++frame) {
+    std::vector<math::Matrix4f> locals;
+    for (size_t i = 0; i < palette.GetInstanceCount(); ++i) {
+      const std::vector<math::Matrix4f> instance_locals =
+          GetLocalTransforms(i + frame);
+      locals.insert(locals.end(), instance_locals.begin(),
+                    instance_locals.end());
+    }
+    verifier.Reset();
+    palette.SetPoses(0U, palette.GetInstanceCount(), locals.data(), NULL);
+    palette.Update();
+    renderer->DrawScene(root);
+    EXPECT_EQ(1U, verifier.GetCountOf("TexSubImage2D"));
+    EXPECT_EQ(0U, verifier.GetCountOf("TexStorage2D"));
+  }
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,209 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/environmentmap.h"
+
+#include <memory>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/sampler.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+using gfx::CubeMapTexture;
+using gfx::CubeMapTexturePtr;
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+// Returns a texture holding a width x height RGBA8888 image.
+static const gfx::TexturePtr CreateTexture(uint32 width, uint32 height) {
+  std::vector<uint8> pixels(width * height * 4U, 128U);
+  ImagePtr image(new Image);
+  image->Set(Image::kRgba8888, width, height,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &pixels[0], pixels.size(), false, base::AllocatorPtr()));
+  gfx::TexturePtr texture(new gfx::Texture);
+  texture->SetImage(0U, image);
+  texture->SetSampler(gfx::SamplerPtr(new gfx::Sampler));
+  return texture;
+}
+
+// Checks that cube_map has level_count levels of face_size faces in format.
+static void CheckCubeMap(const CubeMapTexturePtr& cube_map, uint32 face_size,
+                         size_t level_count, Image::Format format) {
+  ASSERT_TRUE(cube_map.Get());
+  for (int face = 0; face < 6; ++face) {
+    const CubeMapTexture::CubeFace cube_face =
+        static_cast<CubeMapTexture::CubeFace>(face);
+    ASSERT_EQ(level_count, cube_map->GetImageCount(cube_face));
+    for (size_t level = 0; level < level_count; ++level) {
+      const ImagePtr image = cube_map->GetImage(cube_face, level);
+      EXPECT_EQ(format, image->GetFormat());
+      EXPECT_EQ(face_size >> level, image->GetWidth());
+      EXPECT_EQ(face_size >> level, image->GetHeight());
+    }
+  }
+}
+
+class EnvironmentMapGeneratorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    visual_.reset(new gfx::testing::MockVisual(64, 64));
+    gm_.Reset(new gfx::testing::MockGraphicsManager());
+    verifier_.reset(new gfx::testing::TraceVerifier(gm_.Get()));
+    renderer_.Reset(new gfx::Renderer(gm_));
+  }
+
+  void TearDown() override {
+    renderer_.Reset(nullptr);
+    verifier_.reset();
+    gm_.Reset(nullptr);
+    visual_.reset();
+  }
+
+  std::unique_ptr<gfx::testing::MockVisual> visual_;
+  gfx::testing::MockGraphicsManagerPtr gm_;
+  std::unique_ptr<gfx::testing::TraceVerifier> verifier_;
+  gfx::RendererPtr renderer_;
+};
+
+}  // anonymous namespace
+
+TEST_F(EnvironmentMapGeneratorTest, ConvertEquirectangular) {
+  base::LogChecker log_checker;
+  EnvironmentMapGenerator generator((base::AllocatorPtr()));
+  const gfx::TexturePtr panorama = CreateTexture(32U, 16U);
+
+  // Each level of each face is drawn into the cube map.
+  verifier_->Reset();
+  CubeMapTexturePtr cube_map = generator.ConvertEquirectangular(
+      renderer_.Get(), panorama, 16U, 3U, Image::kRgba8888);
+  CheckCubeMap(cube_map, 16U, 3U, Image::kRgba8888);
+  EXPECT_EQ(2, cube_map->GetMaxLevel());
+  EXPECT_EQ(gfx::Sampler::kLinearMipmapLinear,
+            cube_map->GetSampler()->GetMinFilter());
+  EXPECT_EQ(18U, verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(18U, verifier_->GetCountOf("FramebufferTexture2D"));
+  // The program is linked again after binding its attribute locations.
+  EXPECT_EQ(2U, verifier_->GetCountOf("LinkProgram"));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+
+  // The level count is clamped to the full chain, which needs no max level.
+  cube_map = generator.ConvertEquirectangular(renderer_.Get(), panorama, 4U,
+                                              10U, Image::kRgba8888);
+  CheckCubeMap(cube_map, 4U, 3U, Image::kRgba8888);
+  EXPECT_EQ(1000, cube_map->GetMaxLevel());
+  cube_map = generator.ConvertEquirectangular(renderer_.Get(), panorama, 4U,
+                                              0U, Image::kRgba8888);
+  CheckCubeMap(cube_map, 4U, 1U, Image::kRgba8888);
+  EXPECT_EQ(gfx::Sampler::kLinear, cube_map->GetSampler()->GetMinFilter());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Invalid arguments are rejected.
+  EXPECT_FALSE(generator.ConvertEquirectangular(nullptr, panorama, 4U, 1U,
+                                                Image::kRgba8888).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "source texture"));
+  EXPECT_FALSE(generator.ConvertEquirectangular(renderer_.Get(), panorama, 0U,
+                                                1U, Image::kRgba8888).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must be positive"));
+  EXPECT_FALSE(generator.ConvertEquirectangular(renderer_.Get(), panorama, 4U,
+                                                1U, Image::kDxt1).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "not color renderable"));
+}
+
+TEST_F(EnvironmentMapGeneratorTest, Prefilter) {
+  base::LogChecker log_checker;
+  EnvironmentMapGenerator generator((base::AllocatorPtr()));
+  EXPECT_EQ(64U, generator.GetSampleCount());
+  generator.SetSampleCount(0U);
+  EXPECT_EQ(1U, generator.GetSampleCount());
+  generator.SetSampleCount(5000U);
+  EXPECT_EQ(EnvironmentMapGenerator::kMaxSampleCount,
+            generator.GetSampleCount());
+  generator.SetSampleCount(32U);
+
+  const CubeMapTexturePtr environment = generator.ConvertEquirectangular(
+      renderer_.Get(), CreateTexture(32U, 16U), 32U, 6U, Image::kRgba16fHalf);
+  CheckCubeMap(environment, 32U, 6U, Image::kRgba16fHalf);
+
+  verifier_->Reset();
+  const CubeMapTexturePtr specular = generator.Prefilter(
+      renderer_.Get(), environment, 16U, 4U, Image::kRgba16fHalf);
+  CheckCubeMap(specular, 16U, 4U, Image::kRgba16fHalf);
+  EXPECT_EQ(24U, verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(2U, verifier_->GetCountOf("LinkProgram"));
+  EXPECT_EQ(static_cast<GLenum>(GL_NO_ERROR), gm_->GetError());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // The environment must have images.
+  EXPECT_FALSE(generator.Prefilter(renderer_.Get(),
+                                   CubeMapTexturePtr(new CubeMapTexture), 16U,
+                                   4U, Image::kRgba16fHalf).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "has no images"));
+}
+
+TEST_F(EnvironmentMapGeneratorTest, IrradianceShAndReadback) {
+  base::LogChecker log_checker;
+  EnvironmentMapGenerator generator((base::AllocatorPtr()));
+  const CubeMapTexturePtr environment = generator.ConvertEquirectangular(
+      renderer_.Get(), CreateTexture(16U, 8U), 8U, 4U, Image::kRgba8888);
+
+  // The coefficients are drawn in a single pass and read back.
+  math::Vector3f coefficients[EnvironmentMapGenerator::kShCoefficientCount];
+  for (size_t i = 0; i < EnvironmentMapGenerator::kShCoefficientCount; ++i)
+    coefficients[i].Set(1.f, 1.f, 1.f);
+  verifier_->Reset();
+  EXPECT_TRUE(generator.ComputeIrradianceSh(renderer_.Get(), environment,
+                                            coefficients));
+  EXPECT_EQ(1U, verifier_->GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, verifier_->GetCountOf("ReadPixels"));
+  // The mock framebuffer reads as zeros.
+  EXPECT_EQ(math::Vector3f::Zero(), coefficients[0]);
+  EXPECT_FALSE(generator.ComputeIrradianceSh(renderer_.Get(),
+                                             CubeMapTexturePtr(),
+                                             coefficients));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "are required"));
+
+  // Every level of every face is read back in its format.
+  verifier_->Reset();
+  const std::vector<std::vector<ImagePtr>> faces =
+      generator.ReadCubeMap(renderer_.Get(), environment);
+  ASSERT_EQ(6U, faces.size());
+  for (size_t face = 0; face < 6U; ++face) {
+    ASSERT_EQ(4U, faces[face].size());
+    for (size_t level = 0; level < 4U; ++level) {
+      ASSERT_TRUE(faces[face][level].Get());
+      EXPECT_EQ(Image::kRgba8888, faces[face][level]->GetFormat());
+      EXPECT_EQ(8U >> level, faces[face][level]->GetWidth());
+      EXPECT_EQ(8U >> level, faces[face][level]->GetHeight());
+    }
+  }
+  EXPECT_EQ(24U, verifier_->GetCountOf("ReadPixels"));
+  EXPECT_TRUE(generator.ReadCubeMap(renderer_.Get(),
+                                    CubeMapTexturePtr()).empty());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,131 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/externaltexture.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+static const char* kVertexShader =
+    "attribute vec3 aVertex;\n"
+    "void main() { gl_Position = vec4(aVertex, 1.); }\n";
+static const char* kFragmentShader =
+    "uniform samplerExternalOES uCamera;\n"
+    "void main() { gl_FragColor = texture2D(uCamera, vec2(0.)); }\n";
+
+// Returns a Node drawing a single point with the texture of external.
+static gfx::NodePtr BuildNode(const ExternalTexture& external) {
+  gfx::ShaderInputRegistryPtr reg(new gfx::ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  gfx::NodePtr node(new gfx::Node);
+  node->SetShaderProgram(gfx::ShaderProgram::BuildFromStrings(
+      "External", reg, kVertexShader,
+      std::string(ExternalTexture::GetShaderExtension()) + kFragmentShader,
+      base::AllocatorPtr()));
+  node->AddUniform(reg->Create<gfx::Uniform>("uCamera",
+                                             external.GetTexture()));
+  gfx::ShapePtr shape(new gfx::Shape);
+  shape->SetPrimitiveType(gfx::Shape::kPoints);
+  node->AddShape(shape);
+  return node;
+}
+
+}  // anonymous namespace
+
+TEST(ExternalTextureTest, SetImage) {
+  base::LogChecker log_checker;
+  std::unique_ptr<gfx::testing::MockVisual> visual(
+      new gfx::testing::MockVisual(64, 64));
+  gfx::testing::MockGraphicsManagerPtr gm(
+      new gfx::testing::MockGraphicsManager());
+  gfx::testing::TraceVerifier verifier(gm.Get());
+  gfx::RendererPtr renderer(new gfx::Renderer(gm));
+
+  std::vector<void*> released;
+  const ExternalTexture::ReleaseCallback release = [&released](void* image) {
+    released.push_back(image);
+  };
+  static uint8 kImages[3] = {0x1, 0x2, 0x3};
+
+  {
+    ExternalTexture external(gm, base::AllocatorPtr());
+    EXPECT_EQ(NULL, external.GetImage());
+    const gfx::TexturePtr& texture = external.GetTexture();
+    ASSERT_TRUE(texture.Get());
+    EXPECT_EQ(gfx::Image::kExternalEgl, texture->GetImage(0U)->GetType());
+    EXPECT_EQ(gfx::Sampler::kClampToEdge, texture->GetSampler()->GetWrapS());
+    EXPECT_EQ(gfx::Sampler::kLinear, texture->GetSampler()->GetMinFilter());
+    gfx::NodePtr node = BuildNode(external);
+
+    // The first image is linked to the texture without a copy.
+    external.SetImage(&kImages[0], release);
+    EXPECT_EQ(&kImages[0], external.GetImage());
+    EXPECT_EQ(0U, external.GetPendingImageCount());
+    renderer->DrawScene(node);
+    EXPECT_EQ(1U, verifier.GetCountOf(
+                      "EGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES"));
+    EXPECT_EQ(0U, verifier.GetCountOf("TexImage2D"));
+    EXPECT_TRUE(released.empty());
+
+    // Replacing the image fences its last use and releases it once OpenGL
+    // has finished with it. The mock finishes immediately.
+    verifier.Reset();
+    external.SetImage(&kImages[1], release);
+    EXPECT_EQ(1U, verifier.GetCountOf("FenceSync"));
+    EXPECT_EQ(1U, verifier.GetCountOf("ClientWaitSync"));
+    EXPECT_EQ(1U, verifier.GetCountOf("DeleteSync"));
+    EXPECT_EQ(0U, external.GetPendingImageCount());
+    ASSERT_EQ(1U, released.size());
+    EXPECT_EQ(&kImages[0], released[0]);
+    renderer->DrawScene(node);
+    EXPECT_EQ(1U, verifier.GetCountOf(
+                      "EGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES"));
+
+    // Without sync objects OpenGL is finished before releasing.
+    gm->EnableFunctionGroup(gfx::GraphicsManager::kSync, false);
+    verifier.Reset();
+    external.SetImage(&kImages[2], release);
+    EXPECT_EQ(0U, verifier.GetCountOf("FenceSync"));
+    EXPECT_EQ(1U, verifier.GetCountOf("Finish"));
+    ASSERT_EQ(2U, released.size());
+    EXPECT_EQ(&kImages[1], released[1]);
+    gm->EnableFunctionGroup(gfx::GraphicsManager::kSync, true);
+  }
+  // The last image is released when the ExternalTexture is destroyed.
+  ASSERT_EQ(3U, released.size());
+  EXPECT_EQ(&kImages[2], released[2]);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -18,8 +18,14 @@ limitations under the License.
 #include "ion/gfxutils/frame.h"
 
 #include <functional>
+#include <memory>
+#include <vector>
 
 #include "ion/base/logchecker.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/profile/calltracemanager.h"
+#include "ion/profile/tracerecorder.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 namespace ion {
@@ -187,5 +193,101 @@ TEST(FrameTest, Callbacks) {
   EXPECT_EQ(3U, c2.GetCallCount());
 }
 
+TEST(FrameTest, Pacing) {
+  using gfx::testing::MockGraphicsManager;
+  std::unique_ptr<gfx::testing::MockVisual> visual(
+      new gfx::testing::MockVisual(64, 64));
+  base::ReferentPtr<MockGraphicsManager>::Type gm(new MockGraphicsManager);
+
+  // Callbacks see the slot of the current frame.
+  std::vector<size_t> slots;
+  FramePtr frame(new Frame);
+  frame->AddPreFrameCallback("slot", [&slots](const Frame& f) {
+    slots.push_back(f.GetFrameSlot());
+  });
+
+  // Without a limit there is only a single slot, and no fences are used.
+  frame->SetGraphicsManager(gm);
+  EXPECT_EQ(gm.Get(), frame->GetGraphicsManager().Get());
+  EXPECT_EQ(0U, frame->GetMaxFramesInFlight());
+  MockGraphicsManager::ResetCallCount();
+  frame->Begin();
+  frame->End();
+  EXPECT_EQ(0, MockGraphicsManager::GetCallCount());
+  EXPECT_EQ(0.0, frame->GetLastWaitTime());
+  EXPECT_LE(0.0, frame->GetLastFrameTime());
+
+  // With a limit, End() inserts a fence, and Begin() waits for the fence of
+  // the frame that last used the slot.
+  frame->SetMaxFramesInFlight(2U);
+  EXPECT_EQ(2U, frame->GetMaxFramesInFlight());
+  frame->ResetCounter();
+  slots.clear();
+  for (int i = 0; i < 5; ++i) {
+    MockGraphicsManager::ResetCallCount();
+    frame->Begin();
+    // There is no fence to wait for in the first two frames.
+    EXPECT_EQ(i < 2 ? 0 : 2, MockGraphicsManager::GetCallCount());
+    MockGraphicsManager::ResetCallCount();
+    frame->End();
+    EXPECT_EQ(1, MockGraphicsManager::GetCallCount());
+    EXPECT_LE(0.0, frame->GetLastWaitTime());
+  }
+  ASSERT_EQ(5U, slots.size());
+  for (size_t i = 0; i < slots.size(); ++i)
+    EXPECT_EQ(i % 2U, slots[i]);
+
+  // Changing the limit waits for, and deletes, the outstanding fences.
+  MockGraphicsManager::ResetCallCount();
+  frame->SetMaxFramesInFlight(3U);
+  EXPECT_EQ(4, MockGraphicsManager::GetCallCount());
+  MockGraphicsManager::ResetCallCount();
+  frame->Begin();
+  frame->End();
+  EXPECT_EQ(1, MockGraphicsManager::GetCallCount());
+
+  // Frames are not paced if sync objects are not supported, but still use
+  // the slots in turn.
+  gm->EnableFunctionGroup(gfx::GraphicsManager::kSync, false);
+  frame->SetGraphicsManager(gfx::GraphicsManagerPtr());
+  frame->ResetCounter();
+  frame->SetGraphicsManager(gm);
+  slots.clear();
+  MockGraphicsManager::ResetCallCount();
+  for (int i = 0; i < 4; ++i) {
+    frame->Begin();
+    frame->End();
+  }
+  EXPECT_EQ(0, MockGraphicsManager::GetCallCount());
+  ASSERT_EQ(4U, slots.size());
+  EXPECT_EQ(0U, slots[0]);
+  EXPECT_EQ(1U, slots[1]);
+  EXPECT_EQ(2U, slots[2]);
+  EXPECT_EQ(0U, slots[3]);
+  gm->EnableFunctionGroup(gfx::GraphicsManager::kSync, true);
+  frame.Reset();
+}
+
+TEST(FrameTest, TraceRecorder) {
+  profile::CallTraceManager manager;
+  profile::TraceRecorder* recorder = manager.GetTraceRecorder();
+  FramePtr frame(new Frame);
+  EXPECT_TRUE(frame->GetTraceRecorder() == NULL);
+  frame->SetTraceRecorder(recorder);
+  EXPECT_EQ(recorder, frame->GetTraceRecorder());
+  const size_t trace_count = recorder->GetNumTraces();
+  frame->Begin();
+  EXPECT_TRUE(recorder->IsInFrameScope());
+  frame->End();
+  EXPECT_FALSE(recorder->IsInFrameScope());
+  // A frame start and a frame end event.
+  EXPECT_EQ(trace_count + 2U, recorder->GetNumTraces());
+
+  frame->SetTraceRecorder(NULL);
+  frame->Begin();
+  frame->End();
+  EXPECT_EQ(trace_count + 2U, recorder->GetNumTraces());
+}
+
 }  // namespace gfxutils
 }  // namespace ion
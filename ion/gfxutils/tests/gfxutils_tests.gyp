@@ -23,12 +23,31 @@
       'target_name': 'iongfxutils_test',
       'includes': [ '../../dev/test_target.gypi' ],
       'sources' : [
+        'attributelayout_test.cc',
+        'bonepalette_test.cc',
         'buffertoattributebinder_test.cc',
+        'environmentmap_test.cc',
+        'externaltexture_test.cc',
         'frame_test.cc',
+        'idletaskscheduler_test.cc',
+        'meshoptimizer_test.cc',
+        'meshsimplifier_test.cc',
+        'pagedscene_test.cc',
+        'particlesimulator_test.cc',
+        'polygontriangulator_test.cc',
         'printer_test.cc',
+        'scenefile_test.cc',
+        'sceneoptimizer_test.cc',
+        'scenesnapshot_test.cc',
         'shadermanager_test.cc',
         'shadersourcecomposer_test.cc',
+        'shadervariants_test.cc',
         'shapeutils_test.cc',
+        'texturearraypacker_test.cc',
+        'texturefeedback_test.cc',
+        'transformhierarchy_test.cc',
+        'trianglepicker_test.cc',
+        'virtualtexture_test.cc',
       ],
       'dependencies' : [
         '<(ion_dir)/external/gtest.gyp:iongtest_safeallocs',
@@ -0,0 +1,157 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/idletaskscheduler.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/port/timer.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+TEST(IdleTaskSchedulerTest, RunTasksInOrder) {
+  IdleTaskScheduler idle((FramePtr()), base::AllocatorPtr());
+  EXPECT_DOUBLE_EQ(1.0 / 60.0, idle.GetFrameBudget());
+  EXPECT_DOUBLE_EQ(0.001, idle.GetReservedTime());
+  EXPECT_EQ(NULL, idle.GetTaskScheduler());
+  idle.SetFrameBudget(0.1);
+  idle.SetReservedTime(0.01);
+  EXPECT_DOUBLE_EQ(0.1, idle.GetFrameBudget());
+  EXPECT_DOUBLE_EQ(0.01, idle.GetReservedTime());
+
+  std::vector<int> order;
+  const auto add = [&](int id, int priority, double cost) {
+    idle.AddTask([&order, id]() { order.push_back(id); },
+                 IdleTaskScheduler::kRenderThread, priority, cost);
+  };
+  add(0, 0, 0.0);
+  add(1, 1, 0.0);
+  add(2, 0, 100.0);
+  add(3, 0, 0.0);
+  add(4, 2, 0.0);
+  // Empty tasks are ignored.
+  idle.AddTask(IdleTaskScheduler::Task(), IdleTaskScheduler::kRenderThread,
+               0, 0.0);
+  EXPECT_EQ(5U, idle.GetQueuedTaskCount(IdleTaskScheduler::kRenderThread));
+  EXPECT_EQ(0U, idle.GetQueuedTaskCount(IdleTaskScheduler::kWorkerThread));
+
+  // Nothing runs without slack.
+  EXPECT_EQ(0U, idle.RunTasks(0.0));
+  EXPECT_EQ(0U, idle.RunTasks(-1.0));
+  EXPECT_TRUE(order.empty());
+
+  // Tasks run by priority and then in order, skipping the expensive one.
+  EXPECT_EQ(4U, idle.RunTasks(1.0));
+  ASSERT_EQ(4U, order.size());
+  EXPECT_EQ(4, order[0]);
+  EXPECT_EQ(1, order[1]);
+  EXPECT_EQ(0, order[2]);
+  EXPECT_EQ(3, order[3]);
+  EXPECT_EQ(1U, idle.GetQueuedTaskCount(IdleTaskScheduler::kRenderThread));
+  EXPECT_EQ(1U, idle.RunTasks(1000.0));
+  EXPECT_EQ(2, order.back());
+
+  // Tasks may add tasks, which run once they fit.
+  idle.AddTask([&]() { add(5, 0, 0.0); }, IdleTaskScheduler::kRenderThread, 0,
+               0.0);
+  EXPECT_EQ(2U, idle.RunTasks(1.0));
+  EXPECT_EQ(5, order.back());
+
+  // Tasks stop running once the slack is used up.
+  for (int i = 0; i < 3; ++i) {
+    idle.AddTask([]() { port::Timer::SleepNMilliseconds(20U); },
+                 IdleTaskScheduler::kRenderThread, 0, 0.0);
+  }
+  EXPECT_EQ(1U, idle.RunTasks(0.01));
+  EXPECT_EQ(2U, idle.GetQueuedTaskCount(IdleTaskScheduler::kRenderThread));
+
+  // Without a TaskScheduler, worker tasks run on the calling thread.
+  idle.AddTask([&]() { order.push_back(6); },
+               IdleTaskScheduler::kWorkerThread, 0, 0.0);
+  EXPECT_EQ(1U, idle.GetQueuedTaskCount(IdleTaskScheduler::kWorkerThread));
+  EXPECT_EQ(3U, idle.RunTasks(1.0));
+  EXPECT_EQ(6, order.back());
+}
+
+TEST(IdleTaskSchedulerTest, WorkerTasks) {
+  base::TaskScheduler scheduler("idle", 2U);
+  std::atomic<int> run_count(0);
+  {
+    IdleTaskScheduler idle((FramePtr()), base::AllocatorPtr());
+    idle.SetTaskScheduler(&scheduler);
+    EXPECT_EQ(&scheduler, idle.GetTaskScheduler());
+    for (int i = 0; i < 5; ++i) {
+      idle.AddTask(
+          [&run_count]() {
+            port::Timer::SleepNMilliseconds(10U);
+            ++run_count;
+          },
+          IdleTaskScheduler::kWorkerThread, 0, 0.005);
+    }
+    // Worker tasks only start if they fit, one per thread.
+    EXPECT_EQ(0U, idle.RunTasks(0.001));
+    EXPECT_EQ(2U, idle.RunTasks(1.0));
+    EXPECT_EQ(3U, idle.GetQueuedTaskCount(IdleTaskScheduler::kWorkerThread));
+    EXPECT_LE(idle.GetRunningWorkerTaskCount(), 2U);
+    // Changing the scheduler waits for the running tasks.
+    idle.SetTaskScheduler(&scheduler);
+    EXPECT_EQ(0U, idle.GetRunningWorkerTaskCount());
+    EXPECT_EQ(2, run_count);
+    EXPECT_EQ(2U, idle.RunTasks(1.0));
+  }
+  // The destructor waits for the running tasks and discards queued ones.
+  EXPECT_EQ(4, run_count);
+}
+
+TEST(IdleTaskSchedulerTest, RunAtFrameEnd) {
+  base::LogChecker log_checker;
+  FramePtr frame(new Frame);
+  int run_count = 0;
+  {
+    IdleTaskScheduler idle(frame, base::AllocatorPtr());
+    idle.AddTask([&run_count]() { ++run_count; },
+                 IdleTaskScheduler::kRenderThread, 0, 0.0);
+    idle.AddTask([&run_count]() { ++run_count; },
+                 IdleTaskScheduler::kRenderThread, 0, 0.0);
+
+    // A frame that takes its whole budget leaves no slack.
+    idle.SetFrameBudget(0.005);
+    frame->Begin();
+    port::Timer::SleepNMilliseconds(10U);
+    frame->End();
+    EXPECT_GT(0.0, idle.GetLastSlack());
+    EXPECT_EQ(0, run_count);
+
+    idle.SetFrameBudget(10.0);
+    frame->Begin();
+    frame->End();
+    EXPECT_LT(9.0, idle.GetLastSlack());
+    EXPECT_EQ(2, run_count);
+  }
+  // The callbacks are removed with the scheduler.
+  frame->Begin();
+  frame->End();
+  EXPECT_FALSE(frame->RemovePostFrameCallback("IdleTaskScheduler"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,439 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/meshoptimizer.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns the vertex BufferObject of a Shape created by shapeutils.
+static const gfx::BufferObjectPtr& GetVertexBuffer(
+    const gfx::ShapePtr& shape) {
+  return shape->GetAttributeArray()->GetBufferAttribute(0)
+      .GetValue<gfx::BufferObjectElement>().buffer_object;
+}
+
+// Returns the index at position i of the passed IndexBuffer.
+static uint32 GetIndex(const gfx::IndexBufferPtr& index_buffer, size_t i) {
+  const void* data = index_buffer->GetData()->GetData();
+  switch (index_buffer->GetSpec(0).type) {
+    case gfx::BufferObject::kUnsignedByte:
+      return static_cast<const uint8*>(data)[i];
+    case gfx::BufferObject::kUnsignedShort:
+      return static_cast<const uint16*>(data)[i];
+    default:
+      return static_cast<const uint32*>(data)[i];
+  }
+}
+
+// Returns the triangles of a Shape created by shapeutils as strings of vertex
+// data, each rotated to start with its smallest vertex so that the winding is
+// kept, in sorted order. Two Shapes that draw the same triangles in any order
+// with any vertex numbering return the same triangles.
+static const std::vector<std::string> GetTriangles(const gfx::ShapePtr& shape) {
+  const gfx::BufferObjectPtr& buffer_object = GetVertexBuffer(shape);
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  const size_t size = buffer_object->GetStructSize();
+  const char* vertices = buffer_object->GetData()->GetData<char>();
+  std::vector<std::string> triangles;
+  for (size_t t = 0; t < index_buffer->GetCount() / 3U; ++t) {
+    std::string corners[3];
+    for (size_t i = 0; i < 3U; ++i)
+      corners[i].assign(vertices + GetIndex(index_buffer, t * 3U + i) * size,
+                        size);
+    const size_t first =
+        std::min_element(corners, corners + 3) - corners;
+    triangles.push_back(corners[first] + corners[(first + 1U) % 3U] +
+                        corners[(first + 2U) % 3U]);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+// Returns an ellipsoid with many bands and sectors.
+static const gfx::ShapePtr BuildLargeEllipsoid() {
+  EllipsoidSpec spec;
+  spec.band_count = 40;
+  spec.sector_count = 60;
+  return BuildEllipsoidShape(spec);
+}
+
+// Returns an IndexBuffer holding |indices| as type T.
+template <typename T>
+static const gfx::IndexBufferPtr BuildIndexBuffer(
+    gfx::BufferObject::ComponentType type, const std::vector<uint32>& indices) {
+  std::vector<T> typed_indices(indices.begin(), indices.end());
+  gfx::IndexBufferPtr index_buffer(new gfx::IndexBuffer);
+  index_buffer->AddSpec(type, 1, 0);
+  index_buffer->SetData(base::DataContainer::CreateAndCopy<T>(
+                            &typed_indices[0], typed_indices.size(), false,
+                            base::AllocatorPtr()),
+                        sizeof(T), typed_indices.size(),
+                        gfx::BufferObject::kStaticDraw);
+  return index_buffer;
+}
+
+// Returns a Shape that draws the triangles of the triangle strip |shape| as
+// separate triangles, without degenerate ones. |restart_index| ends a strip
+// if |use_restart| is set.
+static const gfx::ShapePtr ExpandTriangleStrip(const gfx::ShapePtr& shape,
+                                               bool use_restart,
+                                               uint32 restart_index) {
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  std::vector<uint32> triangles;
+  size_t start = 0;
+  for (size_t i = 0; i < index_buffer->GetCount(); ++i) {
+    if (use_restart && GetIndex(index_buffer, i) == restart_index) {
+      start = i + 1U;
+      continue;
+    }
+    if (i < start + 2U)
+      continue;
+    uint32 v[3] = { GetIndex(index_buffer, i - 2U),
+                    GetIndex(index_buffer, i - 1U),
+                    GetIndex(index_buffer, i) };
+    if ((i - start) % 2U)
+      std::swap(v[0], v[1]);
+    if (v[0] != v[1] && v[1] != v[2] && v[0] != v[2])
+      triangles.insert(triangles.end(), v, v + 3);
+  }
+  gfx::ShapePtr expanded(new gfx::Shape);
+  expanded->SetAttributeArray(shape->GetAttributeArray());
+  expanded->SetIndexBuffer(BuildIndexBuffer<uint32>(
+      gfx::BufferObject::kUnsignedInt, triangles));
+  return expanded;
+}
+
+// Returns a triangle Shape with |vertex_count| vertices at distinct positions
+// and unsigned int indices. Each triangle uses three consecutive vertices,
+// and a last triangle connects the first, middle, and last vertices.
+static const gfx::ShapePtr BuildLargeTriangleShape(size_t vertex_count) {
+  std::vector<math::Point3f> positions(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i)
+    positions[i].Set(static_cast<float>(i), 0.f, 1.f);
+  gfx::BufferObjectPtr buffer_object(new gfx::BufferObject);
+  buffer_object->SetData(base::DataContainer::CreateAndCopy<math::Point3f>(
+                             &positions[0], vertex_count, true,
+                             base::AllocatorPtr()),
+                         sizeof(positions[0]), vertex_count,
+                         gfx::BufferObject::kStaticDraw);
+  gfx::AttributeArrayPtr attribute_array(new gfx::AttributeArray);
+  attribute_array->AddAttribute(
+      gfx::ShaderInputRegistry::GetGlobalRegistry()->Create<gfx::Attribute>(
+          "aVertex", gfx::BufferObjectElement(
+              buffer_object, buffer_object->AddSpec(
+                  gfx::BufferObject::kFloat, 3, 0))));
+
+  std::vector<uint32> indices;
+  for (uint32 v = 0; v + 3U <= vertex_count; v += 3U) {
+    indices.push_back(v);
+    indices.push_back(v + 1U);
+    indices.push_back(v + 2U);
+  }
+  indices.push_back(0U);
+  indices.push_back(static_cast<uint32>(vertex_count / 2U));
+  indices.push_back(static_cast<uint32>(vertex_count - 1U));
+
+  gfx::ShapePtr shape(new gfx::Shape);
+  shape->SetLabel("Large");
+  shape->SetAttributeArray(attribute_array);
+  shape->SetIndexBuffer(
+      BuildIndexBuffer<uint32>(gfx::BufferObject::kUnsignedInt, indices));
+  return shape;
+}
+
+}  // anonymous namespace
+
+TEST(MeshOptimizerTest, ComputeAverageCacheMissRatio) {
+  static const uint16 kIndices[] = { 0, 1, 2, 0, 2, 3, 4, 0, 3 };
+  gfx::IndexBufferPtr index_buffer(new gfx::IndexBuffer);
+  index_buffer->AddSpec(gfx::BufferObject::kUnsignedShort, 1, 0);
+  index_buffer->SetData(base::DataContainer::CreateAndCopy<uint16>(
+                            kIndices, 9U, false, base::AllocatorPtr()),
+                        sizeof(kIndices[0]), 9U,
+                        gfx::BufferObject::kStaticDraw);
+  // 5 misses for 3 triangles.
+  EXPECT_EQ(5.f / 3.f, ComputeAverageCacheMissRatio(index_buffer, 16U));
+  // Vertex 0 is evicted by 2 and 3, vertex 2 by 4.
+  EXPECT_EQ(6.f / 3.f, ComputeAverageCacheMissRatio(index_buffer, 3U));
+  EXPECT_EQ(3.f, ComputeAverageCacheMissRatio(index_buffer, 0U));
+
+  EXPECT_EQ(0.f, ComputeAverageCacheMissRatio(gfx::IndexBufferPtr(), 16U));
+  EXPECT_EQ(0.f, ComputeAverageCacheMissRatio(
+                     gfx::IndexBufferPtr(new gfx::IndexBuffer), 16U));
+}
+
+TEST(MeshOptimizerTest, OptimizeMesh) {
+  base::LogChecker log_checker;
+  gfx::ShapePtr original = BuildLargeEllipsoid();
+  gfx::ShapePtr shape = BuildLargeEllipsoid();
+  const float original_acmr =
+      ComputeAverageCacheMissRatio(shape->GetIndexBuffer(), 16U);
+
+  // Reordering triangles alone only changes the IndexBuffer.
+  MeshOptimizationSpec spec;
+  spec.reorder_vertices = false;
+  spec.reduce_overdraw = false;
+  const base::DataContainerPtr vertex_data = GetVertexBuffer(shape)->GetData();
+  EXPECT_TRUE(OptimizeMesh(shape, spec));
+  EXPECT_EQ(vertex_data.Get(), GetVertexBuffer(shape)->GetData().Get());
+  const float tipsify_acmr =
+      ComputeAverageCacheMissRatio(shape->GetIndexBuffer(), 16U);
+  EXPECT_LT(tipsify_acmr, original_acmr * 0.8f);
+  EXPECT_GT(tipsify_acmr, 0.5f);
+  EXPECT_EQ(GetTriangles(original), GetTriangles(shape));
+
+  // The default spec also sorts clusters and reorders vertices, which must
+  // keep the cache efficiency and the wipeable settings.
+  shape = BuildLargeEllipsoid();
+  EXPECT_TRUE(OptimizeMesh(shape, MeshOptimizationSpec()));
+  EXPECT_LE(ComputeAverageCacheMissRatio(shape->GetIndexBuffer(), 16U),
+            tipsify_acmr * 1.05f);
+  EXPECT_EQ(GetTriangles(original), GetTriangles(shape));
+  EXPECT_TRUE(GetVertexBuffer(shape)->GetData()->IsWipeable());
+  EXPECT_TRUE(shape->GetIndexBuffer()->GetData()->IsWipeable());
+  EXPECT_EQ(GetVertexBuffer(original)->GetCount(),
+            GetVertexBuffer(shape)->GetCount());
+  // The vertices are in the order of first use.
+  uint32 next_vertex = 0;
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  for (size_t i = 0; i < index_buffer->GetCount(); ++i) {
+    const uint32 index = GetIndex(index_buffer, i);
+    EXPECT_LE(index, next_vertex);
+    if (index == next_vertex)
+      ++next_vertex;
+  }
+  EXPECT_EQ(GetVertexBuffer(shape)->GetCount(), next_vertex);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(MeshOptimizerTest, RemoveDuplicateVertices) {
+  // A box with only positions has 8 distinct corners, but is built with 4
+  // vertices per face.
+  BoxSpec box_spec;
+  box_spec.vertex_type = ShapeSpec::kPosition;
+  gfx::ShapePtr original = BuildBoxShape(box_spec);
+  gfx::ShapePtr shape = BuildBoxShape(box_spec);
+  EXPECT_EQ(24U, GetVertexBuffer(shape)->GetCount());
+
+  MeshOptimizationSpec spec;
+  spec.remove_duplicate_vertices = true;
+  spec.reorder_vertices = false;
+  EXPECT_TRUE(OptimizeMesh(shape, spec));
+  EXPECT_EQ(8U, GetVertexBuffer(shape)->GetCount());
+  EXPECT_EQ(36U, shape->GetIndexBuffer()->GetCount());
+  EXPECT_EQ(GetTriangles(original), GetTriangles(shape));
+
+  // With normals, no vertices are shared between faces.
+  box_spec.vertex_type = ShapeSpec::kPositionNormal;
+  shape = BuildBoxShape(box_spec);
+  spec.reorder_vertices = true;
+  EXPECT_TRUE(OptimizeMesh(shape, spec));
+  EXPECT_EQ(24U, GetVertexBuffer(shape)->GetCount());
+
+  // Byte indices are kept as bytes.
+  shape = BuildBoxShape(box_spec);
+  const gfx::IndexBufferPtr& index_buffer = shape->GetIndexBuffer();
+  std::vector<uint8> indices(index_buffer->GetCount());
+  for (size_t i = 0; i < indices.size(); ++i)
+    indices[i] = static_cast<uint8>(GetIndex(index_buffer, i));
+  gfx::IndexBufferPtr byte_index_buffer(new gfx::IndexBuffer);
+  byte_index_buffer->AddSpec(gfx::BufferObject::kUnsignedByte, 1, 0);
+  byte_index_buffer->SetData(base::DataContainer::CreateAndCopy<uint8>(
+                                 &indices[0], indices.size(), false,
+                                 base::AllocatorPtr()),
+                             1U, indices.size(),
+                             gfx::BufferObject::kStaticDraw);
+  shape->SetIndexBuffer(byte_index_buffer);
+  EXPECT_TRUE(OptimizeMesh(shape, spec));
+  EXPECT_EQ(gfx::BufferObject::kUnsignedByte,
+            shape->GetIndexBuffer()->GetSpec(0).type);
+  EXPECT_FALSE(shape->GetIndexBuffer()->GetData()->IsWipeable());
+  EXPECT_EQ(GetTriangles(original).size(), GetTriangles(shape).size());
+}
+
+TEST(MeshOptimizerTest, InvalidShapes) {
+  base::LogChecker log_checker;
+  MeshOptimizationSpec spec;
+  EXPECT_FALSE(OptimizeMesh(gfx::ShapePtr(), spec));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only indexed triangle"));
+
+  gfx::ShapePtr shape = BuildBoxShape(BoxSpec());
+  shape->SetPrimitiveType(gfx::Shape::kLines);
+  EXPECT_FALSE(OptimizeMesh(shape, spec));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only indexed triangle"));
+
+  shape = BuildBoxShape(BoxSpec());
+  shape->AddVertexRange(math::Range1i(0, 6));
+  EXPECT_FALSE(OptimizeMesh(shape, spec));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only indexed triangle"));
+
+  shape = BuildBoxShape(BoxSpec());
+  shape->GetIndexBuffer()->GetData()->WipeData();
+  EXPECT_FALSE(OptimizeMesh(shape, spec));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no triangle data"));
+
+  // Wiped vertices can only be a problem if vertices change.
+  shape = BuildBoxShape(BoxSpec());
+  GetVertexBuffer(shape)->GetData()->WipeData();
+  EXPECT_FALSE(OptimizeMesh(shape, spec));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must all have data"));
+  spec.reorder_vertices = false;
+  EXPECT_TRUE(OptimizeMesh(shape, spec));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(MeshOptimizerTest, CompactIndices) {
+  base::LogChecker log_checker;
+  // Indices that fit are narrowed to unsigned shorts.
+  gfx::ShapePtr shape = BuildLargeTriangleShape(300U);
+  gfx::ShapePtr original = BuildLargeTriangleShape(300U);
+  EXPECT_TRUE(CompactIndices(shape));
+  EXPECT_EQ(gfx::BufferObject::kUnsignedShort,
+            shape->GetIndexBuffer()->GetSpec(0).type);
+  EXPECT_EQ(sizeof(uint16), shape->GetIndexBuffer()->GetStructSize());
+  EXPECT_EQ(original->GetIndexBuffer()->GetCount(),
+            shape->GetIndexBuffer()->GetCount());
+  EXPECT_EQ(GetTriangles(original), GetTriangles(shape));
+
+  // Indices that need 32 bits are kept.
+  shape = BuildLargeTriangleShape(70000U);
+  const gfx::IndexBufferPtr index_buffer = shape->GetIndexBuffer();
+  EXPECT_TRUE(CompactIndices(shape));
+  EXPECT_EQ(index_buffer.Get(), shape->GetIndexBuffer().Get());
+  EXPECT_EQ(gfx::BufferObject::kUnsignedInt,
+            shape->GetIndexBuffer()->GetSpec(0).type);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  shape->SetIndexBuffer(gfx::IndexBufferPtr());
+  EXPECT_FALSE(CompactIndices(shape));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no IndexBuffer data"));
+}
+
+TEST(MeshOptimizerTest, SplitShapeForShortIndices) {
+  base::LogChecker log_checker;
+  // A Shape whose vertices fit is only compacted.
+  gfx::ShapePtr shape = BuildLargeTriangleShape(300U);
+  std::vector<gfx::ShapePtr> pieces = SplitShapeForShortIndices(shape);
+  ASSERT_EQ(1U, pieces.size());
+  EXPECT_EQ(shape.Get(), pieces[0].Get());
+  EXPECT_EQ(gfx::BufferObject::kUnsignedShort,
+            shape->GetIndexBuffer()->GetSpec(0).type);
+
+  // Larger Shapes are split into pieces with their own vertices.
+  shape = BuildLargeTriangleShape(70000U);
+  pieces = SplitShapeForShortIndices(shape);
+  ASSERT_EQ(2U, pieces.size());
+  std::vector<std::string> triangles;
+  size_t index_count = 0;
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    SCOPED_TRACE(::testing::Message() << "Piece " << i);
+    const gfx::ShapePtr& piece = pieces[i];
+    EXPECT_NE(shape.Get(), piece.Get());
+    EXPECT_EQ("Large", piece->GetLabel());
+    EXPECT_EQ(gfx::Shape::kTriangles, piece->GetPrimitiveType());
+    EXPECT_EQ(gfx::BufferObject::kUnsignedShort,
+              piece->GetIndexBuffer()->GetSpec(0).type);
+    EXPECT_LE(GetVertexBuffer(piece)->GetCount(), 65536U);
+    EXPECT_TRUE(GetVertexBuffer(piece)->GetData()->IsWipeable());
+    const std::vector<std::string> piece_triangles = GetTriangles(piece);
+    triangles.insert(triangles.end(), piece_triangles.begin(),
+                     piece_triangles.end());
+    index_count += piece->GetIndexBuffer()->GetCount();
+  }
+  // The first piece is full, and the triangles are all kept.
+  EXPECT_EQ(65535U, GetVertexBuffer(pieces[0])->GetCount());
+  EXPECT_EQ(shape->GetIndexBuffer()->GetCount(), index_count);
+  std::sort(triangles.begin(), triangles.end());
+  EXPECT_EQ(GetTriangles(shape), triangles);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  shape->SetPrimitiveType(gfx::Shape::kTriangleStrip);
+  EXPECT_TRUE(SplitShapeForShortIndices(shape).empty());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only point, line, and"));
+
+  shape = BuildLargeTriangleShape(70000U);
+  GetVertexBuffer(shape)->GetData()->WipeData();
+  EXPECT_TRUE(SplitShapeForShortIndices(shape).empty());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must all have data"));
+}
+
+TEST(MeshOptimizerTest, ConvertToTriangleStrip) {
+  base::LogChecker log_checker;
+  gfx::ShapePtr original = BuildLargeEllipsoid();
+  const size_t triangle_count = original->GetIndexBuffer()->GetCount() / 3U;
+
+  // Strips joined with degenerate triangles draw the same triangles with far
+  // fewer indices.
+  gfx::ShapePtr shape = BuildLargeEllipsoid();
+  EXPECT_TRUE(ConvertToTriangleStrip(shape, false));
+  EXPECT_EQ(gfx::Shape::kTriangleStrip, shape->GetPrimitiveType());
+  EXPECT_EQ(gfx::BufferObject::kUnsignedShort,
+            shape->GetIndexBuffer()->GetSpec(0).type);
+  EXPECT_LT(shape->GetIndexBuffer()->GetCount(), triangle_count * 3U / 2U);
+  EXPECT_EQ(GetTriangles(original),
+            GetTriangles(ExpandTriangleStrip(shape, false, 0U)));
+
+  // Strips separated by the restart index.
+  shape = BuildLargeEllipsoid();
+  EXPECT_TRUE(ConvertToTriangleStrip(shape, true));
+  EXPECT_EQ(gfx::BufferObject::kUnsignedShort,
+            shape->GetIndexBuffer()->GetSpec(0).type);
+  EXPECT_LT(shape->GetIndexBuffer()->GetCount(), triangle_count * 3U / 2U);
+  EXPECT_EQ(GetTriangles(original),
+            GetTriangles(ExpandTriangleStrip(shape, true, 0xffffU)));
+
+  // Byte indices are widened if a vertex uses the restart index.
+  std::vector<uint32> indices;
+  for (uint32 i = 0; i < 255U; ++i)
+    indices.push_back(i);
+  indices.push_back(0U);
+  indices.push_back(128U);
+  indices.push_back(255U);
+  gfx::ShapePtr strip_shape = BuildLargeTriangleShape(256U);
+  strip_shape->SetIndexBuffer(
+      BuildIndexBuffer<uint8>(gfx::BufferObject::kUnsignedByte, indices));
+  gfx::ShapePtr strip_original = BuildLargeTriangleShape(256U);
+  strip_original->SetIndexBuffer(strip_shape->GetIndexBuffer());
+  EXPECT_TRUE(ConvertToTriangleStrip(strip_shape, true));
+  EXPECT_EQ(gfx::BufferObject::kUnsignedShort,
+            strip_shape->GetIndexBuffer()->GetSpec(0).type);
+  EXPECT_EQ(GetTriangles(strip_original),
+            GetTriangles(ExpandTriangleStrip(strip_shape, true, 0xffffU)));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  shape->SetPrimitiveType(gfx::Shape::kTriangleStrip);
+  EXPECT_FALSE(ConvertToTriangleStrip(shape, false));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only indexed triangle"));
+}
+
+}  // namespace gfxutils
+}  // namespace ion
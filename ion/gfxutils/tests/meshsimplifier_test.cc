@@ -0,0 +1,207 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/meshsimplifier.h"
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns a flat square grid of |size| x |size| quads in OFF format.
+static const std::string BuildGridOff(int size) {
+  const int row = size + 1;
+  std::ostringstream out;
+  out << "OFF\n" << row * row << " " << 2 * size * size << " 0\n";
+  for (int y = 0; y < row; ++y) {
+    for (int x = 0; x < row; ++x)
+      out << x << " " << y << " 0\n";
+  }
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      const int v = y * row + x;
+      out << "3 " << v << " " << v + 1 << " " << v + row + 1 << "\n";
+      out << "3 " << v << " " << v + row + 1 << " " << v + row << "\n";
+    }
+  }
+  return out.str();
+}
+
+// Returns a Shape loaded from BuildGridOff().
+static const gfx::ShapePtr BuildGrid(int size) {
+  ExternalShapeSpec spec;
+  spec.format = ExternalShapeSpec::kOff;
+  const std::string off = BuildGridOff(size);
+  return LoadExternalShapeFromData(spec, off.data(), off.size(), nullptr);
+}
+
+// Returns an ellipsoid with many bands and sectors.
+static const gfx::ShapePtr BuildLargeEllipsoid() {
+  EllipsoidSpec spec;
+  spec.band_count = 40;
+  spec.sector_count = 60;
+  return BuildEllipsoidShape(spec);
+}
+
+}  // anonymous namespace
+
+TEST(MeshSimplifierTest, SimplifyFlatMesh) {
+  base::LogChecker log_checker;
+  gfx::ShapePtr shape = BuildGrid(16);
+  ASSERT_TRUE(shape.Get());
+  ASSERT_EQ(6U * 16U * 16U, shape->GetIndexBuffer()->GetCount());
+
+  // Collapses within the plane have no error, so a flat mesh can be reduced
+  // to its corners, which are never moved.
+  float error = -1.f;
+  gfx::IndexBufferPtr index_buffer = SimplifyMesh(shape, 0U, 0.f, &error);
+  ASSERT_TRUE(index_buffer.Get());
+  EXPECT_EQ(6U, index_buffer->GetCount());
+  EXPECT_EQ(0.f, error);
+  EXPECT_EQ(shape->GetIndexBuffer()->GetSpec(0).type,
+            index_buffer->GetSpec(0).type);
+  EXPECT_EQ(shape->GetIndexBuffer()->GetUsageMode(),
+            index_buffer->GetUsageMode());
+  // The original IndexBuffer is not changed.
+  EXPECT_EQ(6U * 16U * 16U, shape->GetIndexBuffer()->GetCount());
+
+  // Simplification stops at the target.
+  index_buffer = SimplifyMesh(shape, 300U, 0.f, nullptr);
+  ASSERT_TRUE(index_buffer.Get());
+  EXPECT_GE(300U, index_buffer->GetCount());
+  EXPECT_LT(200U, index_buffer->GetCount());
+  EXPECT_EQ(0U, index_buffer->GetCount() % 3U);
+
+  // A target above the index count keeps all triangles.
+  index_buffer = SimplifyMesh(shape, 10000U, 0.f, &error);
+  EXPECT_EQ(6U * 16U * 16U, index_buffer->GetCount());
+  EXPECT_EQ(0.f, error);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(MeshSimplifierTest, SimplifyCurvedMesh) {
+  base::LogChecker log_checker;
+  gfx::ShapePtr shape = BuildLargeEllipsoid();
+  const size_t index_count = shape->GetIndexBuffer()->GetCount();
+
+  // Without any error allowed, only the few collapses that keep the surface
+  // in place up to rounding are done.
+  float error = -1.f;
+  gfx::IndexBufferPtr index_buffer = SimplifyMesh(shape, 0U, 0.f, &error);
+  EXPECT_LT(index_count * 9U / 10U, index_buffer->GetCount());
+  EXPECT_EQ(0.f, error);
+
+  // The error grows as the mesh shrinks, but stays within the limit.
+  float small_error = 0.f;
+  gfx::IndexBufferPtr half = SimplifyMesh(shape, index_count / 2U, 0.1f,
+                                          &small_error);
+  EXPECT_GE(index_count / 2U, half->GetCount());
+  EXPECT_LT(0.f, small_error);
+  float large_error = 0.f;
+  gfx::IndexBufferPtr quarter = SimplifyMesh(shape, index_count / 4U, 0.1f,
+                                             &large_error);
+  EXPECT_GE(index_count / 4U, quarter->GetCount());
+  EXPECT_LE(small_error, large_error);
+  EXPECT_GE(0.1f, large_error);
+
+  // A tighter limit stops simplification early.
+  index_buffer = SimplifyMesh(shape, 0U, 0.01f, &error);
+  EXPECT_LT(quarter->GetCount(), index_buffer->GetCount());
+  EXPECT_GE(0.01f, error);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(MeshSimplifierTest, BuildLodNode) {
+  base::LogChecker log_checker;
+  gfx::ShapePtr shape = BuildLargeEllipsoid();
+  LodSpec spec;
+  spec.max_error = 0.2f;
+  gfx::NodePtr node = BuildLodNode(shape, spec);
+  ASSERT_TRUE(node.Get());
+  const gfx::Node::NodeVector& children = node->GetChildren();
+  ASSERT_EQ(4U, children.size());
+
+  // The first level is the original Shape, and each following one shares its
+  // vertices with about half as many triangles as the one before it.
+  EXPECT_EQ(shape, children[0]->GetShapes()[0]);
+  float max_size = std::numeric_limits<float>::infinity();
+  size_t index_count = 2U * shape->GetIndexBuffer()->GetCount();
+  for (size_t i = 0; i < children.size(); ++i) {
+    const gfx::NodePtr& child = children[i];
+    SCOPED_TRACE(i);
+    ASSERT_EQ(1U, child->GetShapes().size());
+    const gfx::ShapePtr& level = child->GetShapes()[0];
+    EXPECT_EQ(shape->GetAttributeArray(), level->GetAttributeArray());
+    EXPECT_GE(index_count / 2U, level->GetIndexBuffer()->GetCount());
+    index_count = level->GetIndexBuffer()->GetCount();
+    // The ranges cover all sizes without overlapping.
+    EXPECT_TRUE(child->HasBounds());
+    ASSERT_TRUE(child->HasLodRange());
+    EXPECT_EQ(max_size, child->GetLodRange().GetMaxPoint()[0]);
+    EXPECT_LT(child->GetLodRange().GetMinPoint()[0], max_size);
+    max_size = child->GetLodRange().GetMinPoint()[0];
+  }
+  EXPECT_EQ(0.f, max_size);
+
+  // Levels that cannot be simplified further within the error are omitted.
+  spec.level_count = 30U;
+  node = BuildLodNode(shape, spec);
+  ASSERT_LT(4U, node->GetChildren().size());
+  EXPECT_GT(30U, node->GetChildren().size());
+  EXPECT_EQ(0.f, node->GetChildren().back()->GetLodRange().GetMinPoint()[0]);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(MeshSimplifierTest, InvalidShapes) {
+  base::LogChecker log_checker;
+  EXPECT_FALSE(SimplifyMesh(gfx::ShapePtr(), 0U, 1.f, nullptr).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only indexed triangle"));
+  EXPECT_FALSE(BuildLodNode(gfx::ShapePtr(), LodSpec()).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only indexed triangle"));
+
+  gfx::ShapePtr shape = BuildBoxShape(BoxSpec());
+  shape->SetPrimitiveType(gfx::Shape::kLines);
+  EXPECT_FALSE(SimplifyMesh(shape, 0U, 1.f, nullptr).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only indexed triangle"));
+
+  shape = BuildBoxShape(BoxSpec());
+  shape->GetIndexBuffer()->GetData()->WipeData();
+  EXPECT_FALSE(SimplifyMesh(shape, 0U, 1.f, nullptr).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no triangle data"));
+
+  shape = BuildBoxShape(BoxSpec());
+  shape->GetAttributeArray()->GetBufferAttribute(0)
+      .GetValue<gfx::BufferObjectElement>().buffer_object->GetData()
+      ->WipeData();
+  EXPECT_FALSE(SimplifyMesh(shape, 0U, 1.f, nullptr).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "aVertex"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,218 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/pagedscene.h"
+
+#include <atomic>
+#include <limits>
+
+#include "ion/base/logchecker.h"
+#include "ion/port/timer.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using math::Point3f;
+using math::Range3f;
+
+// Returns a PagedNode of content_size bytes spanning a unit cube at x along
+// the X axis, whose loader returns a new Node labeled "Content", or NULL if
+// fail is set, and counts its calls in load_count.
+static const PagedNodePtr CreateNode(float x, size_t content_size, bool fail,
+                                     std::atomic<int>* load_count) {
+  return PagedNodePtr(new PagedNode(
+      [fail, load_count](const PagedNode& node) {
+        ++*load_count;
+        gfx::NodePtr content;
+        if (!fail) {
+          content = new gfx::Node;
+          content->SetLabel("Content");
+        }
+        return content;
+      },
+      Range3f(Point3f(x, 0.f, 0.f), Point3f(x + 1.f, 1.f, 1.f)),
+      content_size));
+}
+
+}  // anonymous namespace
+
+TEST(PagedSceneTest, AddAndRemoveNodes) {
+  base::LogChecker log_checker;
+  std::atomic<int> load_count(0);
+  PagedScene scene((base::AllocatorPtr()));
+  EXPECT_EQ(0U, scene.GetNodeCount());
+  EXPECT_EQ(std::numeric_limits<size_t>::max(), scene.GetMemoryBudget());
+  EXPECT_EQ(1U, scene.GetLoaderThreadCount());
+  EXPECT_EQ(4U, scene.GetMaxAttachesPerFrame());
+  EXPECT_EQ(4U, scene.GetMaxReleasesPerFrame());
+
+  scene.AddNode(PagedNodePtr());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "NULL PagedNode"));
+  PagedNodePtr node = CreateNode(0.f, 10U, false, &load_count);
+  EXPECT_EQ(PagedNode::kUnloaded, node->GetState());
+  EXPECT_EQ(0, node->GetPriority());
+  EXPECT_EQ(std::numeric_limits<float>::max(), node->GetMaxDistance());
+  EXPECT_EQ(10U, node->GetContentSize());
+  EXPECT_EQ(Point3f(1.f, 1.f, 1.f), node->GetPagingBounds().GetMaxPoint());
+  scene.AddNode(node);
+  EXPECT_EQ(1U, scene.GetNodeCount());
+  scene.AddNode(node);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "already added"));
+  PagedScene other_scene((base::AllocatorPtr()));
+  other_scene.AddNode(node);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "already added"));
+  other_scene.RemoveNode(node);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "was not added"));
+  EXPECT_EQ(1U, scene.GetNodeCount());
+
+  scene.RemoveNode(node);
+  EXPECT_EQ(0U, scene.GetNodeCount());
+  other_scene.AddNode(node);
+  EXPECT_EQ(1U, other_scene.GetNodeCount());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(PagedSceneTest, LoadAndUnloadSynchronously) {
+  base::LogChecker log_checker;
+  std::atomic<int> load_count(0);
+  PagedScene scene((base::AllocatorPtr()));
+  scene.SetLoaderThreadCount(0U);
+  scene.SetMaxAttachesPerFrame(2U);
+  scene.SetMaxReleasesPerFrame(1U);
+  scene.SetMemoryBudget(30U);
+  EXPECT_EQ(0U, scene.GetLoaderThreadCount());
+
+  // Five nodes along the X axis, of which the first three fit the budget.
+  PagedNodePtr nodes[5];
+  for (int i = 0; i < 5; ++i) {
+    nodes[i] = CreateNode(static_cast<float>(i) * 10.f, 10U, false,
+                          &load_count);
+    scene.AddNode(nodes[i]);
+  }
+  // Nodes of a higher priority are wanted first, whatever their distance.
+  nodes[4]->SetPriority(1);
+
+  // Two are attached per frame.
+  EXPECT_EQ(2U, scene.Update(Point3f(0.f, 0.f, 0.f)));
+  EXPECT_EQ(2, load_count);
+  EXPECT_EQ(PagedNode::kLoaded, nodes[4]->GetState());
+  EXPECT_EQ(PagedNode::kLoaded, nodes[0]->GetState());
+  EXPECT_EQ(PagedNode::kQueued, nodes[1]->GetState());
+  EXPECT_EQ(PagedNode::kUnloaded, nodes[2]->GetState());
+  EXPECT_EQ(1U, scene.GetPendingCount());
+  EXPECT_EQ(20U, scene.GetLoadedSize());
+  ASSERT_EQ(1U, nodes[0]->GetChildren().size());
+  EXPECT_EQ(nodes[0]->GetContent(), nodes[0]->GetChildren()[0]);
+  EXPECT_EQ("Content", nodes[0]->GetContent()->GetLabel());
+  EXPECT_FALSE(nodes[1]->GetContent().Get());
+
+  EXPECT_EQ(1U, scene.Update(Point3f(0.f, 0.f, 0.f)));
+  EXPECT_EQ(PagedNode::kLoaded, nodes[1]->GetState());
+  EXPECT_EQ(0U, scene.GetPendingCount());
+  EXPECT_EQ(30U, scene.GetLoadedSize());
+  EXPECT_EQ(0U, scene.Update(Point3f(0.f, 0.f, 0.f)));
+  EXPECT_EQ(3, load_count);
+
+  // Moving the viewer along the axis wants the far nodes instead. Removed
+  // content is released one subgraph per frame.
+  const gfx::NodePtr content0 = nodes[0]->GetContent();
+  EXPECT_EQ(2U, scene.Update(Point3f(45.f, 0.f, 0.f)));
+  EXPECT_EQ(PagedNode::kUnloaded, nodes[0]->GetState());
+  EXPECT_EQ(PagedNode::kUnloaded, nodes[1]->GetState());
+  EXPECT_EQ(PagedNode::kLoaded, nodes[2]->GetState());
+  EXPECT_EQ(PagedNode::kLoaded, nodes[3]->GetState());
+  EXPECT_EQ(PagedNode::kLoaded, nodes[4]->GetState());
+  EXPECT_TRUE(nodes[0]->GetChildren().empty());
+  EXPECT_FALSE(nodes[0]->GetContent().Get());
+  EXPECT_EQ(30U, scene.GetLoadedSize());
+  EXPECT_EQ(1U, scene.GetRemovedContentCount());
+  EXPECT_EQ(2, content0->GetRefCount());
+  EXPECT_EQ(0U, scene.Update(Point3f(45.f, 0.f, 0.f)));
+  EXPECT_EQ(0U, scene.GetRemovedContentCount());
+  EXPECT_EQ(1, content0->GetRefCount());
+
+  // Nodes beyond their maximum distance are not wanted, which leaves room in
+  // the budget for another.
+  nodes[4]->SetMaxDistance(5.f);
+  EXPECT_EQ(1U, scene.Update(Point3f(30.f, 0.f, 0.f)));
+  EXPECT_EQ(PagedNode::kUnloaded, nodes[4]->GetState());
+  EXPECT_EQ(PagedNode::kLoaded, nodes[1]->GetState());
+  EXPECT_EQ(0U, scene.GetRemovedContentCount());
+
+  // Removing a loaded node defers the release of its content.
+  scene.RemoveNode(nodes[3]);
+  EXPECT_EQ(PagedNode::kUnloaded, nodes[3]->GetState());
+  EXPECT_EQ(20U, scene.GetLoadedSize());
+  EXPECT_EQ(1U, scene.GetRemovedContentCount());
+  scene.ReleaseRemovedContent();
+  EXPECT_EQ(0U, scene.GetRemovedContentCount());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(PagedSceneTest, LoadFailure) {
+  base::LogChecker log_checker;
+  std::atomic<int> load_count(0);
+  PagedScene scene((base::AllocatorPtr()));
+  scene.SetLoaderThreadCount(0U);
+  PagedNodePtr node = CreateNode(0.f, 10U, true, &load_count);
+  scene.AddNode(node);
+  EXPECT_EQ(0U, scene.Update(Point3f(0.f, 0.f, 0.f)));
+  EXPECT_EQ(PagedNode::kFailed, node->GetState());
+  EXPECT_EQ(0U, scene.GetLoadedSize());
+  // Failed content is not requested again.
+  EXPECT_EQ(0U, scene.Update(Point3f(0.f, 0.f, 0.f)));
+  EXPECT_EQ(1, load_count);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(PagedSceneTest, LoadOnThreads) {
+  base::LogChecker log_checker;
+  std::atomic<int> load_count(0);
+  PagedScene scene((base::AllocatorPtr()));
+  scene.SetLoaderThreadCount(2U);
+  scene.SetMaxAttachesPerFrame(3U);
+  PagedNodePtr nodes[8];
+  for (int i = 0; i < 8; ++i) {
+    nodes[i] = CreateNode(static_cast<float>(i), 10U, false, &load_count);
+    scene.AddNode(nodes[i]);
+  }
+  size_t attached = 0U;
+  for (int i = 0; i < 1000 && attached < 8U; ++i) {
+    const size_t count = scene.Update(Point3f(0.f, 0.f, 0.f));
+    EXPECT_LE(count, 3U);
+    attached += count;
+    port::Timer::SleepNMilliseconds(1U);
+  }
+  EXPECT_EQ(8U, attached);
+  EXPECT_EQ(8, load_count);
+  EXPECT_EQ(80U, scene.GetLoadedSize());
+  EXPECT_EQ(0U, scene.GetPendingCount());
+  for (int i = 0; i < 8; ++i)
+    EXPECT_EQ(PagedNode::kLoaded, nodes[i]->GetState());
+
+  // Nothing fits in an empty budget.
+  scene.SetMemoryBudget(0U);
+  scene.Update(Point3f(0.f, 0.f, 0.f));
+  EXPECT_EQ(0U, scene.GetLoadedSize());
+  EXPECT_EQ(PagedNode::kUnloaded, nodes[0]->GetState());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
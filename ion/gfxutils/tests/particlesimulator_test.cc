@@ -0,0 +1,153 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/particlesimulator.h"
+
+#include <memory>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+static const char* kUpdateVertexShader =
+    "attribute vec3 aPosition;\n"
+    "attribute vec3 aVelocity;\n"
+    "varying vec3 vPosition;\n"
+    "varying vec3 vVelocity;\n";
+static const char* kUpdateFragmentShader = "void main() {}\n";
+
+// Returns a DataContainer holding the state of count particles of six floats
+// each.
+static const base::DataContainerPtr CreateParticles(size_t count) {
+  std::vector<float> values(count * 6U, 1.f);
+  return base::DataContainer::CreateAndCopy<float>(
+      &values[0], values.size(), false, base::AllocatorPtr());
+}
+
+}  // anonymous namespace
+
+TEST(ParticleSimulatorTest, AddMembersAndParticles) {
+  base::LogChecker log_checker;
+  gfx::ShaderProgramPtr program = gfx::ShaderProgram::BuildFromStrings(
+      "Update", gfx::ShaderInputRegistryPtr(new gfx::ShaderInputRegistry),
+      kUpdateVertexShader, kUpdateFragmentShader, base::AllocatorPtr());
+  ParticleSimulator simulator(program, base::AllocatorPtr());
+  EXPECT_EQ(0U, simulator.GetParticleSize());
+  EXPECT_EQ(0U, simulator.GetParticleCount());
+  EXPECT_EQ(program.Get(), simulator.GetUpdateNode()->GetShaderProgram().Get());
+  EXPECT_EQ(gfx::Shape::kPoints, simulator.GetShape()->GetPrimitiveType());
+
+  // Particles cannot be set without members.
+  simulator.SetParticles(CreateParticles(4U), 4U);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "members must be added"));
+  EXPECT_EQ(0U, simulator.GetParticleCount());
+
+  simulator.AddMember("aPosition", "vPosition", 3U);
+  simulator.AddMember("aVelocity", "vVelocity", 3U);
+  simulator.AddMember("aInvalid", "vInvalid", 5U);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "between 1 and 4 components"));
+  EXPECT_EQ(6U * sizeof(float), simulator.GetParticleSize());
+  ASSERT_EQ(2U, program->GetCapturedVaryings().size());
+  EXPECT_EQ("vPosition", program->GetCapturedVaryings()[0]);
+  EXPECT_EQ("vVelocity", program->GetCapturedVaryings()[1]);
+
+  simulator.SetParticles(base::DataContainerPtr(), 4U);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "without data"));
+
+  simulator.SetParticles(CreateParticles(4U), 4U);
+  EXPECT_EQ(4U, simulator.GetParticleCount());
+  const gfx::BufferObjectPtr& buffer = simulator.GetCurrentBuffer();
+  ASSERT_TRUE(buffer.Get());
+  EXPECT_EQ(4U, buffer->GetCount());
+  EXPECT_EQ(6U * sizeof(float), buffer->GetStructSize());
+  const gfx::AttributeArrayPtr& aa = simulator.GetShape()->GetAttributeArray();
+  ASSERT_TRUE(aa.Get());
+  ASSERT_EQ(2U, aa->GetBufferAttributeCount());
+  EXPECT_EQ(3U * sizeof(float),
+            buffer->GetSpec(aa->GetBufferAttribute(1U)
+                                .GetValue<gfx::BufferObjectElement>()
+                                .spec_index)
+                .byte_offset);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(ParticleSimulatorTest, Step) {
+  base::LogChecker log_checker;
+  std::unique_ptr<gfx::testing::MockVisual> visual(
+      new gfx::testing::MockVisual(64, 64));
+  gfx::testing::MockGraphicsManagerPtr gm(
+      new gfx::testing::MockGraphicsManager());
+  gfx::testing::TraceVerifier verifier(gm.Get());
+  gfx::RendererPtr renderer(new gfx::Renderer(gm));
+
+  gfx::ShaderProgramPtr program = gfx::ShaderProgram::BuildFromStrings(
+      "Update", gfx::ShaderInputRegistryPtr(new gfx::ShaderInputRegistry),
+      kUpdateVertexShader, kUpdateFragmentShader, base::AllocatorPtr());
+  ParticleSimulator simulator(program, base::AllocatorPtr());
+  simulator.AddMember("aPosition", "vPosition", 3U);
+  simulator.AddMember("aVelocity", "vVelocity", 3U);
+
+  // Nothing happens without particles.
+  simulator.Step(renderer.Get());
+  EXPECT_EQ(0U, verifier.GetCountOf("DrawArrays"));
+
+  simulator.SetParticles(CreateParticles(8U), 8U);
+  const gfx::BufferObjectPtr first = simulator.GetCurrentBuffer();
+  const gfx::AttributeArrayPtr first_array =
+      simulator.GetShape()->GetAttributeArray();
+
+  // Each step captures the new state into the other buffer and swaps them.
+  verifier.Reset();
+  simulator.Step(renderer.Get());
+  EXPECT_EQ(1U, verifier.GetCountOf("TransformFeedbackVaryings"));
+  EXPECT_EQ(1U, verifier.GetCountOf("Enable(GL_RASTERIZER_DISCARD"));
+  EXPECT_EQ(1U, verifier.GetCountOf("BeginTransformFeedback(GL_POINTS"));
+  EXPECT_EQ(1U, verifier.GetCountOf("DrawArrays(GL_POINTS, 0, 8"));
+  EXPECT_EQ(1U, verifier.GetCountOf("EndTransformFeedback"));
+  EXPECT_EQ(1U, verifier.GetCountOf("Disable(GL_RASTERIZER_DISCARD"));
+  EXPECT_NE(first.Get(), simulator.GetCurrentBuffer().Get());
+  EXPECT_NE(first_array.Get(), simulator.GetShape()->GetAttributeArray().Get());
+
+  verifier.Reset();
+  simulator.Step(renderer.Get());
+  EXPECT_EQ(0U, verifier.GetCountOf("TransformFeedbackVaryings"));
+  EXPECT_EQ(1U, verifier.GetCountOf("BeginTransformFeedback(GL_POINTS"));
+  EXPECT_EQ(1U, verifier.GetCountOf("EndTransformFeedback"));
+  EXPECT_EQ(first.Get(), simulator.GetCurrentBuffer().Get());
+  EXPECT_EQ(first_array.Get(), simulator.GetShape()->GetAttributeArray().Get());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Without transform feedback the state does not change.
+  gm->EnableFunctionGroup(gfx::GraphicsManager::kTransformFeedback, false);
+  verifier.Reset();
+  simulator.Step(renderer.Get());
+  EXPECT_EQ(0U, verifier.GetCountOf("DrawArrays"));
+  EXPECT_EQ(first.Get(), simulator.GetCurrentBuffer().Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "not supported"));
+}
+
+}  // namespace gfxutils
+}  // namespace ion
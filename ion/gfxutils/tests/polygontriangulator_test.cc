@@ -0,0 +1,286 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "ion/gfxutils/polygontriangulator.h"
+
+#include <cmath>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/math/vector.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using math::Point2f;
+
+// Returns a polygon for vertices and hole_starts.
+static const TriangulationPolygon MakePolygon(
+    const std::vector<Point2f>& vertices,
+    const std::vector<uint32>& hole_starts) {
+  TriangulationPolygon polygon;
+  polygon.vertices = vertices.empty() ? NULL : &vertices[0];
+  polygon.vertex_count = vertices.size();
+  polygon.hole_starts = hole_starts.empty() ? NULL : &hole_starts[0];
+  polygon.hole_count = hole_starts.size();
+  return polygon;
+}
+
+// Appends a regular polygon with count vertices to vertices, counterclockwise
+// unless clockwise is set.
+static void AddCircle(float cx, float cy, float radius, size_t count,
+                      bool clockwise, std::vector<Point2f>* vertices) {
+  const float kTwoPi = 6.2831853f;
+  for (size_t i = 0; i < count; ++i) {
+    const float angle = (clockwise ? -kTwoPi : kTwoPi) *
+                        static_cast<float>(i) / static_cast<float>(count);
+    vertices->push_back(
+        Point2f(cx + radius * std::cos(angle), cy + radius * std::sin(angle)));
+  }
+}
+
+// Returns the sum of the signed areas of the triangles in indices, which are
+// positive for counterclockwise triangles.
+template <typename T>
+static double ComputeArea(const Point2f* vertices, const T* indices,
+                          size_t index_count) {
+  double area = 0.0;
+  for (size_t i = 0; i < index_count; i += 3U) {
+    const Point2f& a = vertices[indices[i]];
+    const Point2f& b = vertices[indices[i + 1U]];
+    const Point2f& c = vertices[indices[i + 2U]];
+    area += 0.5 * ((b[0] - a[0]) * (c[1] - a[1]) -
+                   (c[0] - a[0]) * (b[1] - a[1]));
+  }
+  return area;
+}
+
+// Returns whether all triangles in indices are counterclockwise.
+static bool AllCounterclockwise(const std::vector<Point2f>& vertices,
+                                const std::vector<uint32>& indices) {
+  for (size_t i = 0; i < indices.size(); i += 3U) {
+    if (ComputeArea(&vertices[0], &indices[i], 3U) <= 0.0)
+      return false;
+  }
+  return true;
+}
+
+}  // anonymous namespace
+
+TEST(PolygonTriangulatorTest, TriangulateSimplePolygons) {
+  base::LogChecker log_checker;
+  std::vector<uint32> indices;
+
+  // Too few vertices.
+  std::vector<Point2f> vertices;
+  vertices.push_back(Point2f(0.f, 0.f));
+  vertices.push_back(Point2f(1.f, 0.f));
+  std::vector<uint32> no_holes;
+  EXPECT_EQ(0U, GetMaxTriangleCount(MakePolygon(vertices, no_holes)));
+  EXPECT_EQ(0U, TriangulatePolygon(MakePolygon(vertices, no_holes), &indices));
+  EXPECT_TRUE(indices.empty());
+
+  // A square, clockwise.
+  vertices.clear();
+  vertices.push_back(Point2f(0.f, 0.f));
+  vertices.push_back(Point2f(0.f, 1.f));
+  vertices.push_back(Point2f(1.f, 1.f));
+  vertices.push_back(Point2f(1.f, 0.f));
+  EXPECT_EQ(2U, GetMaxTriangleCount(MakePolygon(vertices, no_holes)));
+  EXPECT_EQ(2U, TriangulatePolygon(MakePolygon(vertices, no_holes), &indices));
+  ASSERT_EQ(6U, indices.size());
+  EXPECT_DOUBLE_EQ(1.0, ComputeArea(&vertices[0], &indices[0], 6U));
+  EXPECT_TRUE(AllCounterclockwise(vertices, indices));
+
+  // Triangles are appended. A concave "U" with 8 vertices.
+  vertices.clear();
+  vertices.push_back(Point2f(0.f, 0.f));
+  vertices.push_back(Point2f(3.f, 0.f));
+  vertices.push_back(Point2f(3.f, 3.f));
+  vertices.push_back(Point2f(2.f, 3.f));
+  vertices.push_back(Point2f(2.f, 1.f));
+  vertices.push_back(Point2f(1.f, 1.f));
+  vertices.push_back(Point2f(1.f, 3.f));
+  vertices.push_back(Point2f(0.f, 3.f));
+  EXPECT_EQ(6U, TriangulatePolygon(MakePolygon(vertices, no_holes), &indices));
+  ASSERT_EQ(24U, indices.size());
+  EXPECT_DOUBLE_EQ(7.0, ComputeArea(&vertices[0], &indices[6], 18U));
+
+  // Duplicate and collinear vertices are dropped.
+  indices.clear();
+  vertices.clear();
+  vertices.push_back(Point2f(0.f, 0.f));
+  vertices.push_back(Point2f(1.f, 0.f));
+  vertices.push_back(Point2f(1.f, 0.f));
+  vertices.push_back(Point2f(2.f, 0.f));
+  vertices.push_back(Point2f(2.f, 2.f));
+  vertices.push_back(Point2f(0.f, 2.f));
+  EXPECT_EQ(4U, GetMaxTriangleCount(MakePolygon(vertices, no_holes)));
+  EXPECT_EQ(2U, TriangulatePolygon(MakePolygon(vertices, no_holes), &indices));
+  EXPECT_DOUBLE_EQ(4.0, ComputeArea(&vertices[0], &indices[0], 6U));
+
+  // A large circle is triangulated with the Z-order curve.
+  indices.clear();
+  vertices.clear();
+  AddCircle(0.f, 0.f, 10.f, 500U, false, &vertices);
+  EXPECT_EQ(498U,
+            TriangulatePolygon(MakePolygon(vertices, no_holes), &indices));
+  EXPECT_TRUE(AllCounterclockwise(vertices, indices));
+  EXPECT_NEAR(100.0 * M_PI, ComputeArea(&vertices[0], &indices[0],
+                                        indices.size()), 0.1);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(PolygonTriangulatorTest, TriangulateHoles) {
+  base::LogChecker log_checker;
+  std::vector<uint32> indices;
+
+  // A square with a square hole of the same orientation.
+  std::vector<Point2f> vertices;
+  vertices.push_back(Point2f(0.f, 0.f));
+  vertices.push_back(Point2f(4.f, 0.f));
+  vertices.push_back(Point2f(4.f, 4.f));
+  vertices.push_back(Point2f(0.f, 4.f));
+  vertices.push_back(Point2f(1.f, 1.f));
+  vertices.push_back(Point2f(3.f, 1.f));
+  vertices.push_back(Point2f(3.f, 3.f));
+  vertices.push_back(Point2f(1.f, 3.f));
+  std::vector<uint32> hole_starts(1U, 4U);
+  EXPECT_EQ(8U, GetMaxTriangleCount(MakePolygon(vertices, hole_starts)));
+  EXPECT_EQ(8U,
+            TriangulatePolygon(MakePolygon(vertices, hole_starts), &indices));
+  EXPECT_DOUBLE_EQ(12.0,
+                   ComputeArea(&vertices[0], &indices[0], indices.size()));
+  EXPECT_TRUE(AllCounterclockwise(vertices, indices));
+
+  // A large circle with many circular holes.
+  indices.clear();
+  vertices.clear();
+  hole_starts.clear();
+  AddCircle(0.f, 0.f, 10.f, 200U, true, &vertices);
+  double expected_area = 100.0 * M_PI;
+  for (int i = 0; i < 4; ++i) {
+    hole_starts.push_back(static_cast<uint32>(vertices.size()));
+    AddCircle(-6.f + 4.f * static_cast<float>(i), 0.f, 1.f, 20U, i % 2 == 0,
+              &vertices);
+    expected_area -= M_PI;
+  }
+  const TriangulationPolygon polygon = MakePolygon(vertices, hole_starts);
+  EXPECT_EQ(286U, GetMaxTriangleCount(polygon));
+  EXPECT_EQ(286U, TriangulatePolygon(polygon, &indices));
+  EXPECT_TRUE(AllCounterclockwise(vertices, indices));
+  EXPECT_NEAR(expected_area,
+              ComputeArea(&vertices[0], &indices[0], indices.size()), 0.5);
+
+  // Invalid hole starts.
+  indices.clear();
+  hole_starts.push_back(1U);
+  EXPECT_EQ(0U,
+            TriangulatePolygon(MakePolygon(vertices, hole_starts), &indices));
+  EXPECT_TRUE(indices.empty());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "out of order or out of range"));
+}
+
+TEST(PolygonTriangulatorTest, TriangulatePolygons) {
+  base::LogChecker log_checker;
+  // Empty batches produce empty buffers.
+  std::vector<TriangulationPolygon> polygons;
+  TriangulatedPolygons result = TriangulatePolygons(
+      polygons, gfx::BufferObject::kStaticDraw, base::AllocatorPtr(), NULL);
+  ASSERT_TRUE(result.vertex_buffer.Get());
+  ASSERT_TRUE(result.index_buffer.Get());
+  EXPECT_EQ(0U, result.vertex_buffer->GetCount());
+  EXPECT_EQ(0U, result.index_buffer->GetCount());
+  EXPECT_TRUE(result.index_ranges.empty());
+
+  // A square with a duplicate vertex, a circle with a hole, and a polygon
+  // with an invalid hole.
+  std::vector<Point2f> square;
+  square.push_back(Point2f(0.f, 0.f));
+  square.push_back(Point2f(1.f, 0.f));
+  square.push_back(Point2f(1.f, 0.f));
+  square.push_back(Point2f(1.f, 1.f));
+  square.push_back(Point2f(0.f, 1.f));
+  std::vector<Point2f> circle;
+  AddCircle(0.f, 0.f, 2.f, 100U, false, &circle);
+  AddCircle(0.f, 0.f, 1.f, 30U, false, &circle);
+  const std::vector<uint32> circle_holes(1U, 100U);
+  const std::vector<uint32> invalid_holes(1U, 10U);
+  const std::vector<uint32> no_holes;
+  polygons.push_back(MakePolygon(square, no_holes));
+  polygons.push_back(MakePolygon(circle, circle_holes));
+  polygons.push_back(MakePolygon(square, invalid_holes));
+  std::vector<uint32> expected;
+  TriangulatePolygon(polygons[1], &expected);
+
+  base::TaskScheduler scheduler("triangulator", 3U);
+  for (int i = 0; i < 2; ++i) {
+    SCOPED_TRACE(i);
+    result = TriangulatePolygons(polygons, gfx::BufferObject::kDynamicDraw,
+                                 base::AllocatorPtr(), i ? &scheduler : NULL);
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "out of order"));
+    const gfx::BufferObjectPtr& vertex_buffer = result.vertex_buffer;
+    ASSERT_EQ(140U, vertex_buffer->GetCount());
+    EXPECT_EQ(sizeof(Point2f), vertex_buffer->GetStructSize());
+    EXPECT_EQ(gfx::BufferObject::kDynamicDraw, vertex_buffer->GetUsageMode());
+    const Point2f* vertices =
+        vertex_buffer->GetData()->GetData<Point2f>();
+    EXPECT_EQ(Point2f(1.f, 1.f), vertices[3]);
+    EXPECT_EQ(circle[7], vertices[12]);
+
+    const gfx::IndexBufferPtr& index_buffer = result.index_buffer;
+    EXPECT_EQ(gfx::BufferObject::kUnsignedShort,
+              index_buffer->GetSpec(0).type);
+    ASSERT_EQ(3U, result.index_ranges.size());
+    EXPECT_EQ(math::Range1i(0, 6), result.index_ranges[0]);
+    EXPECT_EQ(math::Range1i(6, 6 + static_cast<int>(expected.size())),
+              result.index_ranges[1]);
+    EXPECT_EQ(result.index_ranges[1].GetMaxPoint(),
+              result.index_ranges[2].GetMinPoint());
+    EXPECT_EQ(result.index_ranges[2].GetMaxPoint(),
+              result.index_ranges[2].GetMinPoint());
+    ASSERT_EQ(6U + expected.size(), index_buffer->GetCount());
+    const uint16* indices = index_buffer->GetData()->GetData<uint16>();
+    EXPECT_DOUBLE_EQ(1.0, ComputeArea(vertices, indices, 6U));
+    for (size_t j = 0; j < expected.size(); ++j)
+      EXPECT_EQ(expected[j] + 5U, indices[6U + j]);
+  }
+
+  // Unsigned int indices are used once the vertices do not fit in 16 bits.
+  std::vector<Point2f> large_circle;
+  AddCircle(0.f, 0.f, 100.f, 70000U, false, &large_circle);
+  polygons.resize(1U);
+  polygons.push_back(MakePolygon(large_circle, no_holes));
+  result = TriangulatePolygons(polygons, gfx::BufferObject::kStaticDraw,
+                               base::AllocatorPtr(), &scheduler);
+  EXPECT_EQ(70005U, result.vertex_buffer->GetCount());
+  EXPECT_EQ(gfx::BufferObject::kUnsignedInt,
+            result.index_buffer->GetSpec(0).type);
+  EXPECT_EQ(6U + 3U * 69998U, result.index_buffer->GetCount());
+  const uint32* indices = result.index_buffer->GetData()->GetData<uint32>();
+  EXPECT_NEAR(1.0 + 10000.0 * M_PI,
+              ComputeArea(result.vertex_buffer->GetData()->GetData<Point2f>(),
+                          indices, result.index_buffer->GetCount()),
+              1.0);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
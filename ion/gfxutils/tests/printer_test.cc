@@ -1585,7 +1585,7 @@ static const NodePtr BuildTestScene() {
   node_with_shapes->Enable(false);
 
   // Add an AttributeArray with one of each attribute type to the first Shape.
-  const base::AllocVector<ShapePtr>& shapes = node_with_shapes->GetShapes();
+  const gfx::Node::ShapeVector& shapes = node_with_shapes->GetShapes();
   shapes[0]->SetAttributeArray(CreateAttributeArray(reg_ptr));
 
   // Add one IndexBuffer of each type to the Shapes.
@@ -1720,6 +1720,7 @@ TEST(PrinterTest, Flags) {
   EXPECT_EQ(Printer::kText, printer.GetFormat());
   EXPECT_FALSE(printer.IsFullShapePrintingEnabled());
   EXPECT_TRUE(printer.IsAddressPrintingEnabled());
+  EXPECT_TRUE(printer.IsChildPrintingEnabled());
 
   // Check that the settings can be modified.
   printer.SetFormat(Printer::kHtml);
@@ -1734,6 +1735,10 @@ TEST(PrinterTest, Flags) {
   EXPECT_TRUE(printer.IsAddressPrintingEnabled());
   printer.EnableAddressPrinting(false);
   EXPECT_FALSE(printer.IsAddressPrintingEnabled());
+  printer.EnableChildPrinting(false);
+  EXPECT_FALSE(printer.IsChildPrintingEnabled());
+  printer.EnableChildPrinting(true);
+  EXPECT_TRUE(printer.IsChildPrintingEnabled());
 }
 
 TEST(PrinterTest, AddressPrinting) {
@@ -1906,5 +1911,29 @@ TEST(PrinterTest, PrintMultipleNodesAsHtml) {
   EXPECT_TRUE(base::testing::MultiLineStringsEqual(expected, out.str()));
 }
 
+TEST(PrinterTest, ChildPrinting) {
+  gfx::NodePtr parent(new gfx::Node);
+  gfx::NodePtr child(new gfx::Node);
+  parent->SetLabel("Parent");
+  child->SetLabel("Child");
+  parent->AddChild(child);
+  Printer printer;
+  printer.EnableAddressPrinting(false);
+
+  std::ostringstream out;
+  printer.PrintScene(parent, out);
+  EXPECT_NE(std::string::npos, out.str().find("Child"));
+
+  // Only the passed Node is printed without children.
+  printer.EnableChildPrinting(false);
+  out.str("");
+  printer.PrintScene(parent, out);
+  EXPECT_TRUE(base::testing::MultiLineStringsEqual(
+      "ION Node \"Parent\" {\n"
+      "  Enabled: true\n"
+      "}\n",
+      out.str()));
+}
+
 }  // namespace gfxutils
 }  // namespace ion
@@ -0,0 +1,333 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/scenefile.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/indexbuffer.h"
+#include "ion/gfx/sampler.h"
+#include "ion/gfx/shader.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/texture.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfx/uniformblock.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/transformutils.h"
+#include "ion/math/vector.h"
+#include "ion/port/fileutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using gfx::Node;
+using gfx::NodePtr;
+using gfx::ShaderInputRegistry;
+using gfx::ShaderInputRegistryPtr;
+using gfx::Uniform;
+using math::Matrix4f;
+using math::Vector4f;
+
+// Returns a scene that uses most of the objects and settings that can be
+// saved. The two children of the root share a Shape.
+static const NodePtr BuildTestScene() {
+  ShaderInputRegistryPtr registry(new ShaderInputRegistry);
+  registry->IncludeGlobalRegistry();
+  registry->Add(ShaderInputRegistry::UniformSpec(
+      "uWeights", gfx::kFloatUniform, "Blend weights"));
+  gfx::ShaderProgramPtr program(new gfx::ShaderProgram(registry));
+  program->SetLabel("Program");
+  program->SetVertexShader(gfx::ShaderPtr(new gfx::Shader("vertex source")));
+  program->SetFragmentShader(
+      gfx::ShaderPtr(new gfx::Shader("fragment source")));
+
+  gfx::StateTablePtr state_table(new gfx::StateTable);
+  state_table->Enable(gfx::StateTable::kBlend, true);
+  state_table->Enable(gfx::StateTable::kDepthTest, false);
+  state_table->SetClearColor(Vector4f(0.1f, 0.2f, 0.3f, 1.f));
+  state_table->SetViewport(math::Range2i::BuildWithSize(
+      math::Point2i(0, 0), math::Vector2i(64, 32)));
+  state_table->SetStencilFunctions(gfx::StateTable::kStencilLess, 2, 0xfU,
+                                   gfx::StateTable::kStencilNever, 3, 0xf0U);
+
+  static const uint8 kPixels[4 * 2 * 2] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+  gfx::ImagePtr image(new gfx::Image);
+  image->Set(gfx::Image::kRgba8888, 2U, 2U,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 kPixels, sizeof(kPixels), false, base::AllocatorPtr()));
+  gfx::SamplerPtr sampler(new gfx::Sampler);
+  sampler->SetMinFilter(gfx::Sampler::kNearest);
+  sampler->SetWrapS(gfx::Sampler::kClampToEdge);
+  gfx::TexturePtr texture(new gfx::Texture);
+  texture->SetLabel("Texture");
+  texture->SetSampler(sampler);
+  texture->SetImage(0U, image);
+
+  NodePtr root(new Node);
+  root->SetLabel("Root");
+  root->SetStateTable(state_table);
+  root->SetShaderProgram(program);
+  root->AddUniform(registry->Create<Uniform>("uTexture", texture));
+  static const float kWeights[3] = { 0.25f, 0.5f, 0.25f };
+  root->AddUniform(registry->CreateArrayUniform(
+      "uWeights", kWeights, 3U, base::AllocatorPtr()));
+  gfx::UniformBlockPtr block(new gfx::UniformBlock);
+  block->SetBlockName("Colors");
+  block->AddUniform(ShaderInputRegistry::GetGlobalRegistry()->Create<Uniform>(
+      "uBaseColor", Vector4f(1.f, 0.5f, 0.f, 1.f)));
+  root->AddUniformBlock(block);
+
+  const gfx::ShapePtr shape = BuildBoxShape(BoxSpec());
+  shape->AddVertexRange(math::Range1i(0, 6));
+  shape->EnableVertexRange(0U, false);
+  for (int i = 0; i < 2; ++i) {
+    NodePtr child(new Node);
+    child->AddShape(shape);
+    child->AddUniform(
+        ShaderInputRegistry::GetGlobalRegistry()->Create<Uniform>(
+            "uModelviewMatrix", math::TranslationMatrix(
+                math::Vector3f(static_cast<float>(i), 0.f, 0.f))));
+    root->AddChild(child);
+  }
+  root->GetChildren()[1]->Enable(false);
+  root->GetChildren()[1]->SetBounds(
+      math::Range3f(math::Point3f(-1.f, -1.f, -1.f),
+                    math::Point3f(1.f, 1.f, 1.f)));
+  root->GetChildren()[1]->SetLodRange(math::Range1f(2.f, 10.f));
+  return root;
+}
+
+// Returns the data of |root| saved by SaveScene().
+static const std::string SaveSceneToString(const NodePtr& root) {
+  std::ostringstream out;
+  EXPECT_TRUE(SaveScene(root, out));
+  return out.str();
+}
+
+// Checks that |loaded| matches the scene returned by BuildTestScene().
+static void CheckTestScene(const NodePtr& original, const NodePtr& loaded) {
+  ASSERT_TRUE(loaded.Get());
+  EXPECT_NE(original.Get(), loaded.Get());
+  EXPECT_EQ("Root", loaded->GetLabel());
+
+  // StateTable.
+  ASSERT_TRUE(loaded->GetStateTable().Get());
+  EXPECT_TRUE(gfx::StateTable::AreSetItemsSame(*original->GetStateTable(),
+                                               *loaded->GetStateTable()));
+
+  // ShaderProgram and its registry.
+  const gfx::ShaderProgramPtr& program = loaded->GetShaderProgram();
+  ASSERT_TRUE(program.Get());
+  EXPECT_EQ("Program", program->GetLabel());
+  EXPECT_EQ("vertex source", program->GetVertexShader()->GetSource());
+  EXPECT_EQ("fragment source", program->GetFragmentShader()->GetSource());
+  const ShaderInputRegistryPtr& registry = program->GetRegistry();
+  EXPECT_NE(original->GetShaderProgram()->GetRegistry().Get(),
+            registry.Get());
+  ASSERT_EQ(1U, registry->GetIncludes().size());
+  EXPECT_EQ(ShaderInputRegistry::GetGlobalRegistry(),
+            registry->GetIncludes()[0]);
+  const ShaderInputRegistry::UniformSpec* spec =
+      registry->Find<Uniform>("uWeights");
+  ASSERT_TRUE(spec);
+  EXPECT_EQ("Blend weights", spec->doc_string);
+
+  // Uniforms.
+  const base::AllocVector<Uniform>& uniforms = loaded->GetUniforms();
+  ASSERT_EQ(2U, uniforms.size());
+  EXPECT_EQ(registry.Get(), &uniforms[0].GetRegistry());
+  const gfx::TexturePtr& texture = uniforms[0].GetValue<gfx::TexturePtr>();
+  ASSERT_TRUE(texture.Get());
+  EXPECT_EQ("Texture", texture->GetLabel());
+  EXPECT_EQ(gfx::Sampler::kNearest, texture->GetSampler()->GetMinFilter());
+  EXPECT_EQ(gfx::Sampler::kClampToEdge, texture->GetSampler()->GetWrapS());
+  EXPECT_EQ(1U, texture->GetImageCount());
+  const gfx::ImagePtr& image = texture->GetImage(0U);
+  EXPECT_EQ(gfx::Image::kRgba8888, image->GetFormat());
+  EXPECT_EQ(2U, image->GetWidth());
+  EXPECT_EQ(2U, image->GetHeight());
+  EXPECT_EQ(0, memcmp(original->GetUniforms()[0].GetValue<gfx::TexturePtr>()
+                          ->GetImage(0U)->GetData()->GetData(),
+                      image->GetData()->GetData(), image->GetDataSize()));
+  ASSERT_EQ(3U, uniforms[1].GetCount());
+  EXPECT_EQ(0.5f, uniforms[1].GetValueAt<float>(1U));
+  ASSERT_EQ(1U, loaded->GetUniformBlocks().size());
+  const gfx::UniformBlock& block = *loaded->GetUniformBlocks()[0];
+  EXPECT_EQ("Colors", block.GetBlockName());
+  ASSERT_EQ(1U, block.GetUniforms().size());
+  EXPECT_EQ(ShaderInputRegistry::GetGlobalRegistry().Get(),
+            &block.GetUniforms()[0].GetRegistry());
+  EXPECT_TRUE(math::VectorBase4f::AreValuesEqual(
+      Vector4f(1.f, 0.5f, 0.f, 1.f),
+      block.GetUniforms()[0].GetValue<math::VectorBase4f>()));
+
+  // Children and their shared Shape.
+  ASSERT_EQ(2U, loaded->GetChildren().size());
+  const Node& child0 = *loaded->GetChildren()[0];
+  const Node& child1 = *loaded->GetChildren()[1];
+  EXPECT_TRUE(child0.IsEnabled());
+  EXPECT_FALSE(child0.HasBounds());
+  EXPECT_FALSE(child0.HasLodRange());
+  EXPECT_FALSE(child1.IsEnabled());
+  EXPECT_EQ(original->GetChildren()[1]->GetBounds(), child1.GetBounds());
+  EXPECT_EQ(math::Range1f(2.f, 10.f), child1.GetLodRange());
+  EXPECT_EQ(math::TranslationMatrix(math::Vector3f(1.f, 0.f, 0.f)),
+            child1.GetUniforms()[0].GetValue<Matrix4f>());
+  ASSERT_EQ(1U, child0.GetShapes().size());
+  ASSERT_EQ(1U, child1.GetShapes().size());
+  EXPECT_EQ(child0.GetShapes()[0], child1.GetShapes()[0]);
+
+  const gfx::Shape& original_shape =
+      *original->GetChildren()[0]->GetShapes()[0];
+  const gfx::Shape& shape = *child0.GetShapes()[0];
+  EXPECT_EQ(original_shape.GetLabel(), shape.GetLabel());
+  EXPECT_EQ(original_shape.GetPrimitiveType(), shape.GetPrimitiveType());
+  ASSERT_EQ(1U, shape.GetVertexRangeCount());
+  EXPECT_EQ(math::Range1i(0, 6), shape.GetVertexRange(0U));
+  EXPECT_FALSE(shape.IsVertexRangeEnabled(0U));
+  const gfx::AttributeArray& original_attributes =
+      *original_shape.GetAttributeArray();
+  const gfx::AttributeArray& attributes = *shape.GetAttributeArray();
+  ASSERT_EQ(original_attributes.GetAttributeCount(),
+            attributes.GetAttributeCount());
+  for (size_t i = 0; i < attributes.GetAttributeCount(); ++i) {
+    const gfx::Attribute& original_attribute =
+        original_attributes.GetAttribute(i);
+    const gfx::Attribute& attribute = attributes.GetAttribute(i);
+    EXPECT_EQ(ShaderInputRegistry::GetSpec(original_attribute)->name,
+              ShaderInputRegistry::GetSpec(attribute)->name);
+    EXPECT_EQ(original_attribute.GetType(), attribute.GetType());
+    EXPECT_EQ(original_attribute.IsFixedPointNormalized(),
+              attribute.IsFixedPointNormalized());
+  }
+  const gfx::BufferObjectPtr& original_vertices =
+      original_attributes.GetBufferAttribute(0U)
+          .GetValue<gfx::BufferObjectElement>().buffer_object;
+  const gfx::BufferObjectPtr& vertices =
+      attributes.GetBufferAttribute(0U)
+          .GetValue<gfx::BufferObjectElement>().buffer_object;
+  ASSERT_EQ(original_vertices->GetSpecCount(), vertices->GetSpecCount());
+  for (size_t i = 0; i < vertices->GetSpecCount(); ++i)
+    EXPECT_TRUE(original_vertices->GetSpec(i) == vertices->GetSpec(i));
+  ASSERT_EQ(original_vertices->GetCount(), vertices->GetCount());
+  ASSERT_EQ(original_vertices->GetStructSize(), vertices->GetStructSize());
+  EXPECT_EQ(0, memcmp(original_vertices->GetData()->GetData(),
+                      vertices->GetData()->GetData(),
+                      vertices->GetCount() * vertices->GetStructSize()));
+  const gfx::IndexBufferPtr& indices = shape.GetIndexBuffer();
+  ASSERT_TRUE(indices.Get());
+  ASSERT_EQ(original_shape.GetIndexBuffer()->GetCount(), indices->GetCount());
+  EXPECT_EQ(0, memcmp(original_shape.GetIndexBuffer()->GetData()->GetData(),
+                      indices->GetData()->GetData(),
+                      indices->GetCount() * indices->GetStructSize()));
+}
+
+}  // anonymous namespace
+
+TEST(SceneFileTest, SaveAndLoadFromData) {
+  base::LogChecker log_checker;
+  const NodePtr root = BuildTestScene();
+  const std::string data = SaveSceneToString(root);
+  EXPECT_EQ(std::string("ISCN"), data.substr(0, 4));
+  SceneLoadSpec spec;
+  const NodePtr loaded = LoadSceneFromData(data.data(), data.size(), spec);
+  CheckTestScene(root, loaded);
+  EXPECT_FALSE(loaded->GetChildren()[0]->GetShapes()[0]->GetIndexBuffer()
+               ->GetData()->IsReadOnly());
+
+  // Saving the loaded scene gives the same data.
+  EXPECT_EQ(data, SaveSceneToString(loaded));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(SceneFileTest, SaveAndLoadFromFile) {
+  base::LogChecker log_checker;
+  const NodePtr root = BuildTestScene();
+  const std::string data = SaveSceneToString(root);
+  const std::string filename = port::GetTemporaryFilename();
+  ASSERT_FALSE(filename.empty());
+  FILE* fp = port::OpenFile(filename, "wb");
+  ASSERT_TRUE(fp);
+  fwrite(data.data(), 1U, data.size(), fp);
+  fclose(fp);
+
+  // The data of the loaded scene is mapped from the file without copying.
+  SceneLoadSpec spec;
+  const NodePtr loaded = LoadSceneFromFile(filename, spec);
+  CheckTestScene(root, loaded);
+  const base::DataContainerPtr& indices =
+      loaded->GetChildren()[0]->GetShapes()[0]->GetIndexBuffer()->GetData();
+  EXPECT_TRUE(indices->IsReadOnly());
+  EXPECT_EQ(0U, reinterpret_cast<size_t>(indices->GetData()) % 16U);
+  port::RemoveFile(filename);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  EXPECT_FALSE(LoadSceneFromFile("/InvalidPath/DoesNotExist", spec).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Unable to map"));
+}
+
+TEST(SceneFileTest, InvalidScenes) {
+  base::LogChecker log_checker;
+  std::ostringstream out;
+  EXPECT_FALSE(SaveScene(NodePtr(), out));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "NULL scene"));
+
+  // Wiped data cannot be saved.
+  NodePtr root(new Node);
+  root->AddShape(BuildBoxShape(BoxSpec()));
+  root->GetShapes()[0]->GetIndexBuffer()->GetData()->WipeData();
+  EXPECT_FALSE(SaveScene(root, out));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "wiped"));
+
+  // Invalid data.
+  SceneLoadSpec spec;
+  EXPECT_FALSE(LoadSceneFromData("ISCN", 4U, spec).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "too short"));
+  std::string data = SaveSceneToString(BuildTestScene());
+  std::string bad_data = data;
+  bad_data[0] = 'X';
+  EXPECT_FALSE(LoadSceneFromData(bad_data.data(), bad_data.size(), spec).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Invalid scene header"));
+  EXPECT_FALSE(LoadSceneFromData(data.data(), data.size() - 1U, spec).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Invalid scene header"));
+
+  // The root must be a Node; the first object is the root's StateTable.
+  bad_data = data;
+  const uint32 bad_root = 0U;
+  memcpy(&bad_data[12], &bad_root, sizeof(bad_root));
+  EXPECT_FALSE(LoadSceneFromData(bad_data.data(), bad_data.size(), spec).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Invalid scene data"));
+}
+
+}  // namespace gfxutils
+}  // namespace ion
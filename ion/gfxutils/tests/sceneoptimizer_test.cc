@@ -0,0 +1,374 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/sceneoptimizer.h"
+
+#include <cstring>
+
+#include "ion/base/datacontainer.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfx/uniformblock.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/angle.h"
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/transformutils.h"
+#include "ion/math/vector.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using gfx::Node;
+using gfx::NodePtr;
+using gfx::ShaderInputRegistry;
+using gfx::Uniform;
+using math::Matrix4f;
+using math::Vector3f;
+using math::Vector4f;
+
+// Returns a Uniform from the global registry.
+template <typename T>
+static const Uniform CreateUniform(const std::string& name, const T& value) {
+  return ShaderInputRegistry::GetGlobalRegistry()->Create<Uniform>(name,
+                                                                   value);
+}
+
+// Returns a new StateTable that enables blending.
+static const gfx::StateTablePtr CreateBlendStateTable() {
+  gfx::StateTablePtr state_table(new gfx::StateTable);
+  state_table->Enable(gfx::StateTable::kBlend, true);
+  return state_table;
+}
+
+// Returns a new Node that contains a new rectangle Shape.
+static const NodePtr CreateShapeNode() {
+  NodePtr node(new Node);
+  node->AddShape(BuildRectangleShape(RectangleSpec()));
+  return node;
+}
+
+// Returns the 3 components of attribute |name| of vertex |v| of |shape|.
+static const Vector3f GetVertexValue(const gfx::ShapePtr& shape,
+                                     const std::string& name, size_t v) {
+  gfx::AttributeArray& attribute_array = *shape->GetAttributeArray();
+  const gfx::Attribute& attribute = attribute_array.GetAttribute(
+      attribute_array.GetAttributeIndexByName(name));
+  const gfx::BufferObjectElement& element =
+      attribute.GetValue<gfx::BufferObjectElement>();
+  const gfx::BufferObjectPtr& buffer_object = element.buffer_object;
+  const uint8* data = buffer_object->GetData()->GetData<uint8>() +
+                      v * buffer_object->GetStructSize() +
+                      buffer_object->GetSpec(element.spec_index).byte_offset;
+  Vector3f value;
+  memcpy(value.Data(), data, sizeof(value));
+  return value;
+}
+
+}  // anonymous namespace
+
+TEST(SceneOptimizerTest, NullAndDisabledRoots) {
+  SceneOptimizationSpec spec;
+  EXPECT_FALSE(OptimizeScene(NodePtr(), spec).Get());
+
+  NodePtr root = CreateShapeNode();
+  root->Enable(false);
+  NodePtr optimized = OptimizeScene(root, spec);
+  ASSERT_TRUE(optimized.Get());
+  EXPECT_NE(root.Get(), optimized.Get());
+  EXPECT_FALSE(optimized->IsEnabled());
+  EXPECT_TRUE(optimized->GetShapes().empty());
+}
+
+TEST(SceneOptimizerTest, ShareStateTablesAndUniformBlocks) {
+  NodePtr root(new Node);
+  for (int i = 0; i < 3; ++i) {
+    NodePtr node = CreateShapeNode();
+    node->SetStateTable(CreateBlendStateTable());
+    gfx::UniformBlockPtr block(new gfx::UniformBlock);
+    block->AddUniform(CreateUniform("uBaseColor", Vector4f(1.f, 0.f, 0.f,
+                                                           i ? 1.f : 0.f)));
+    node->AddUniformBlock(block);
+    root->AddChild(node);
+  }
+  root->GetChildren()[2]->GetStateTable()->SetLineWidth(2.f);
+
+  NodePtr optimized = OptimizeScene(root, SceneOptimizationSpec());
+  ASSERT_EQ(3U, optimized->GetChildren().size());
+  const Node& node0 = *optimized->GetChildren()[0];
+  const Node& node1 = *optimized->GetChildren()[1];
+  const Node& node2 = *optimized->GetChildren()[2];
+  // The first two StateTables are the same.
+  EXPECT_EQ(root->GetChildren()[0]->GetStateTable(), node0.GetStateTable());
+  EXPECT_EQ(node0.GetStateTable(), node1.GetStateTable());
+  EXPECT_EQ(root->GetChildren()[2]->GetStateTable(), node2.GetStateTable());
+  // The last two UniformBlocks are the same.
+  EXPECT_EQ(root->GetChildren()[0]->GetUniformBlocks()[0],
+            node0.GetUniformBlocks()[0]);
+  EXPECT_EQ(root->GetChildren()[1]->GetUniformBlocks()[0],
+            node1.GetUniformBlocks()[0]);
+  EXPECT_EQ(node1.GetUniformBlocks()[0], node2.GetUniformBlocks()[0]);
+  // The original is unchanged.
+  EXPECT_NE(root->GetChildren()[0]->GetStateTable(),
+            root->GetChildren()[1]->GetStateTable());
+
+  // Nothing is shared if sharing is disabled.
+  SceneOptimizationSpec spec;
+  spec.share_state_tables = false;
+  spec.share_uniform_blocks = false;
+  optimized = OptimizeScene(root, spec);
+  for (size_t i = 0; i < 3U; ++i) {
+    EXPECT_EQ(root->GetChildren()[i]->GetStateTable(),
+              optimized->GetChildren()[i]->GetStateTable());
+    EXPECT_EQ(root->GetChildren()[i]->GetUniformBlocks()[0],
+              optimized->GetChildren()[i]->GetUniformBlocks()[0]);
+  }
+}
+
+TEST(SceneOptimizerTest, RemoveRedundantSettings) {
+  gfx::ShaderProgramPtr program(
+      new gfx::ShaderProgram(ShaderInputRegistry::GetGlobalRegistry()));
+  const Matrix4f matrix = math::TranslationMatrix(Vector3f(1.f, 2.f, 3.f));
+  NodePtr root = CreateShapeNode();
+  root->SetShaderProgram(program);
+  root->AddUniform(CreateUniform("uBaseColor", Vector4f(1.f, 0.f, 0.f, 1.f)));
+  root->AddUniform(CreateUniform("uModelviewMatrix", matrix));
+  NodePtr child = CreateShapeNode();
+  child->SetShaderProgram(program);
+  child->AddUniform(CreateUniform("uBaseColor", Vector4f(1.f, 0.f, 0.f, 1.f)));
+  child->AddUniform(CreateUniform("uModelviewMatrix", matrix));
+  child->AddUniform(CreateUniform("uProjectionMatrix", matrix));
+  root->AddChild(child);
+  NodePtr grandchild = CreateShapeNode();
+  grandchild->AddUniform(
+      CreateUniform("uBaseColor", Vector4f(0.f, 1.f, 0.f, 1.f)));
+  child->AddChild(grandchild);
+  // A UniformBlock that may be buffer-backed hides the inherited value.
+  gfx::UniformBlockPtr block(new gfx::UniformBlock);
+  block->SetBlockName("Block");
+  block->AddUniform(CreateUniform("uProjectionMatrix", matrix));
+  grandchild->AddUniformBlock(block);
+  NodePtr great_grandchild = CreateShapeNode();
+  great_grandchild->AddUniform(CreateUniform("uProjectionMatrix", matrix));
+  grandchild->AddChild(great_grandchild);
+
+  NodePtr optimized = OptimizeScene(root, SceneOptimizationSpec());
+  EXPECT_EQ(program, optimized->GetShaderProgram());
+  EXPECT_EQ(2U, optimized->GetUniforms().size());
+  ASSERT_EQ(1U, optimized->GetChildren().size());
+  const NodePtr& optimized_child = optimized->GetChildren()[0];
+  EXPECT_FALSE(optimized_child->GetShaderProgram().Get());
+  // Uniforms with a combine function are kept.
+  ASSERT_EQ(2U, optimized_child->GetUniforms().size());
+  EXPECT_EQ("uModelviewMatrix",
+            optimized_child->GetUniforms()[0].GetRegistry().GetSpec(
+                optimized_child->GetUniforms()[0])->name);
+  ASSERT_EQ(1U, optimized_child->GetChildren().size());
+  const NodePtr& optimized_grandchild = optimized_child->GetChildren()[0];
+  EXPECT_EQ(1U, optimized_grandchild->GetUniforms().size());
+  ASSERT_EQ(1U, optimized_grandchild->GetChildren().size());
+  EXPECT_EQ(1U,
+            optimized_grandchild->GetChildren()[0]->GetUniforms().size());
+
+  SceneOptimizationSpec spec;
+  spec.remove_redundant_settings = false;
+  optimized = OptimizeScene(root, spec);
+  EXPECT_EQ(program, optimized->GetChildren()[0]->GetShaderProgram());
+  EXPECT_EQ(3U, optimized->GetChildren()[0]->GetUniforms().size());
+}
+
+TEST(SceneOptimizerTest, CollapseNodes) {
+  // root
+  //   group
+  //     leaf0 (shapes)
+  //     leaf1 (shapes)
+  //     state (state table, shapes)
+  //       empty (uniform only)
+  //     disabled (shapes)
+  //     labeled
+  //   leaf2 (shapes)
+  NodePtr root(new Node);
+  NodePtr group(new Node);
+  root->AddChild(group);
+  NodePtr leaf0 = CreateShapeNode();
+  NodePtr leaf1 = CreateShapeNode();
+  NodePtr state = CreateShapeNode();
+  state->SetStateTable(CreateBlendStateTable());
+  NodePtr empty(new Node);
+  empty->AddUniform(CreateUniform("uBaseColor", Vector4f(1.f, 1.f, 1.f, 1.f)));
+  state->AddChild(empty);
+  NodePtr disabled = CreateShapeNode();
+  disabled->Enable(false);
+  NodePtr labeled(new Node);
+  labeled->SetLabel("Timed");
+  group->AddChild(leaf0);
+  group->AddChild(leaf1);
+  group->AddChild(state);
+  group->AddChild(disabled);
+  group->AddChild(labeled);
+  NodePtr leaf2 = CreateShapeNode();
+  root->AddChild(leaf2);
+
+  // The Shapes of the first leaves move into the root, now that the group is
+  // gone; the last leaf is drawn after other Nodes, so it stays.
+  NodePtr optimized = OptimizeScene(root, SceneOptimizationSpec());
+  ASSERT_EQ(2U, optimized->GetShapes().size());
+  EXPECT_EQ(leaf0->GetShapes()[0], optimized->GetShapes()[0]);
+  EXPECT_EQ(leaf1->GetShapes()[0], optimized->GetShapes()[1]);
+  ASSERT_EQ(3U, optimized->GetChildren().size());
+  EXPECT_EQ(state->GetStateTable(),
+            optimized->GetChildren()[0]->GetStateTable());
+  EXPECT_TRUE(optimized->GetChildren()[0]->GetChildren().empty());
+  EXPECT_EQ("Timed", optimized->GetChildren()[1]->GetLabel());
+  EXPECT_EQ(leaf2->GetShapes()[0],
+            optimized->GetChildren()[2]->GetShapes()[0]);
+  // The original is unchanged.
+  EXPECT_EQ(2U, root->GetChildren().size());
+  EXPECT_EQ(5U, group->GetChildren().size());
+
+  // Shapes with bounds cannot join Shapes without them.
+  leaf1->SetBounds(math::Range3f(math::Point3f(0.f, 0.f, 0.f),
+                                 math::Point3f(1.f, 1.f, 1.f)));
+  optimized = OptimizeScene(root, SceneOptimizationSpec());
+  EXPECT_EQ(1U, optimized->GetShapes().size());
+  EXPECT_FALSE(optimized->HasBounds());
+  EXPECT_EQ(4U, optimized->GetChildren().size());
+  leaf0->SetBounds(math::Range3f(math::Point3f(-1.f, 0.f, 0.f),
+                                 math::Point3f(0.f, 1.f, 1.f)));
+  optimized = OptimizeScene(root, SceneOptimizationSpec());
+  EXPECT_EQ(2U, optimized->GetShapes().size());
+  EXPECT_TRUE(optimized->HasBounds());
+  EXPECT_EQ(math::Range3f(math::Point3f(-1.f, 0.f, 0.f),
+                          math::Point3f(1.f, 1.f, 1.f)),
+            optimized->GetBounds());
+
+  // A root with a single child is replaced by it.
+  NodePtr single(new Node);
+  single->AddChild(state);
+  optimized = OptimizeScene(single, SceneOptimizationSpec());
+  EXPECT_EQ(state->GetStateTable(), optimized->GetStateTable());
+
+  SceneOptimizationSpec spec;
+  spec.collapse_nodes = false;
+  optimized = OptimizeScene(root, spec);
+  EXPECT_TRUE(optimized->GetShapes().empty());
+  ASSERT_EQ(2U, optimized->GetChildren().size());
+  // Only the disabled Node is omitted.
+  EXPECT_EQ(4U, optimized->GetChildren()[0]->GetChildren().size());
+}
+
+TEST(SceneOptimizerTest, BakeTransforms) {
+  const Matrix4f matrix = math::TranslationMatrix(Vector3f(1.f, 2.f, 3.f)) *
+                          math::ScaleMatrixH(Vector3f(2.f, 1.f, 1.f));
+  NodePtr root(new Node);
+  root->AddUniform(CreateUniform("uProjectionMatrix", Matrix4f::Identity()));
+  NodePtr node = CreateShapeNode();
+  node->AddUniform(CreateUniform("uModelviewMatrix", matrix));
+  node->AddUniform(CreateUniform("uBaseColor", Vector4f(1.f, 1.f, 1.f, 1.f)));
+  // The child shares the Shape.
+  NodePtr child(new Node);
+  child->AddShape(node->GetShapes()[0]);
+  child->SetStateTable(CreateBlendStateTable());
+  node->AddChild(child);
+  root->AddChild(node);
+  const gfx::ShapePtr& shape = node->GetShapes()[0];
+
+  // Transforms are not baked by default.
+  NodePtr optimized = OptimizeScene(root, SceneOptimizationSpec());
+  EXPECT_EQ(2U, optimized->GetChildren()[0]->GetUniforms().size());
+
+  SceneOptimizationSpec spec;
+  spec.bake_transforms = true;
+  optimized = OptimizeScene(root, spec);
+  ASSERT_EQ(1U, optimized->GetChildren().size());
+  const NodePtr& baked = optimized->GetChildren()[0];
+  ASSERT_EQ(1U, baked->GetUniforms().size());
+  ASSERT_EQ(1U, baked->GetShapes().size());
+  const gfx::ShapePtr& baked_shape = baked->GetShapes()[0];
+  EXPECT_NE(shape, baked_shape);
+  EXPECT_EQ(baked_shape, baked->GetChildren()[0]->GetShapes()[0]);
+  EXPECT_EQ(shape->GetIndexBuffer(), baked_shape->GetIndexBuffer());
+  const size_t vertex_count = 4U;
+  for (size_t v = 0; v < vertex_count; ++v) {
+    const math::Point3f position =
+        math::Point3f::Zero() + GetVertexValue(shape, "aVertex", v);
+    EXPECT_EQ(matrix * position, math::Point3f::Zero() +
+                                     GetVertexValue(baked_shape, "aVertex", v));
+    EXPECT_EQ(GetVertexValue(shape, "aNormal", v),
+              GetVertexValue(baked_shape, "aNormal", v));
+    EXPECT_EQ(GetVertexValue(shape, "aTexCoords", v),
+              GetVertexValue(baked_shape, "aTexCoords", v));
+  }
+  // The texture coordinates share the buffer of the positions.
+  const gfx::AttributeArray& attribute_array =
+      *baked_shape->GetAttributeArray();
+  EXPECT_EQ(attribute_array.GetBufferAttribute(0)
+                .GetValue<gfx::BufferObjectElement>().buffer_object,
+            attribute_array.GetBufferAttribute(1)
+                .GetValue<gfx::BufferObjectElement>().buffer_object);
+
+  // Normals are transformed by the inverse transpose.
+  const Matrix4f rotation =
+      math::RotationMatrixAxisAngleH(Vector3f::AxisX(),
+                                     math::Anglef::FromDegrees(90.f));
+  node->ReplaceUniform(0, CreateUniform("uModelviewMatrix", rotation));
+  optimized = OptimizeScene(root, spec);
+  const gfx::ShapePtr& rotated_shape =
+      optimized->GetChildren()[0]->GetShapes()[0];
+  const Vector3f normal = GetVertexValue(rotated_shape, "aNormal", 0U);
+  EXPECT_NEAR(0.f, normal[0], 1e-6f);
+  EXPECT_NEAR(-1.f, normal[1], 1e-6f);
+  EXPECT_NEAR(0.f, normal[2], 1e-6f);
+
+  // Projections are not baked, and neither are transformations above them.
+  Matrix4f projection = matrix;
+  projection(3, 2) = 1.f;
+  child->AddUniform(CreateUniform("uModelviewMatrix", projection));
+  optimized = OptimizeScene(root, spec);
+  EXPECT_EQ(shape, optimized->GetChildren()[0]->GetShapes()[0]);
+  EXPECT_EQ(2U, optimized->GetChildren()[0]->GetUniforms().size());
+  EXPECT_EQ(1U,
+            optimized->GetChildren()[0]->GetChildren()[0]
+                ->GetUniforms().size());
+
+  // Nested transformations are both baked.
+  child->ReplaceUniform(0, CreateUniform("uModelviewMatrix", matrix));
+  optimized = OptimizeScene(root, spec);
+  const NodePtr& nested = optimized->GetChildren()[0];
+  EXPECT_EQ(1U, nested->GetUniforms().size());
+  EXPECT_TRUE(nested->GetChildren()[0]->GetUniforms().empty());
+  const math::Point3f position =
+      math::Point3f::Zero() + GetVertexValue(shape, "aVertex", 0U);
+  EXPECT_EQ(rotation * position,
+            math::Point3f::Zero() +
+                GetVertexValue(nested->GetShapes()[0], "aVertex", 0U));
+  EXPECT_EQ(rotation * (matrix * position),
+            math::Point3f::Zero() +
+                GetVertexValue(nested->GetChildren()[0]->GetShapes()[0],
+                               "aVertex", 0U));
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,154 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/scenesnapshot.h"
+
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/math/vector.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns a Node with a Uniform, a StateTable, and a Shape.
+static const gfx::NodePtr BuildNode(const gfx::ShaderInputRegistryPtr& reg,
+                                    float value) {
+  gfx::NodePtr node(new gfx::Node);
+  node->AddUniform(reg->Create<gfx::Uniform>("uBaseColor",
+                                             math::Vector4f(value, 0, 0, 1)));
+  gfx::StateTablePtr st(new gfx::StateTable);
+  st->Enable(gfx::StateTable::kDepthTest, true);
+  node->SetStateTable(st);
+  gfx::ShapePtr shape(new gfx::Shape);
+  shape->SetAttributeArray(gfx::AttributeArrayPtr(new gfx::AttributeArray));
+  shape->AddVertexRange(math::Range1i(0, 3));
+  node->AddShape(shape);
+  return node;
+}
+
+// Returns the value of the color Uniform of a Node built by BuildNode().
+static float GetValue(const gfx::NodePtr& node) {
+  return node->GetUniforms()[0].GetValue<math::VectorBase4f>()[0];
+}
+
+}  // anonymous namespace
+
+TEST(SceneSnapshotTest, CaptureAndAcquire) {
+  const gfx::ShaderInputRegistryPtr& reg =
+      gfx::ShaderInputRegistry::GetGlobalRegistry();
+  SceneSnapshot snapshot((base::AllocatorPtr()));
+  EXPECT_FALSE(snapshot.AcquireLatest().Get());
+  EXPECT_EQ(0U, snapshot.GetCaptureCount());
+
+  gfx::NodePtr root = BuildNode(reg, 1.f);
+  gfx::NodePtr child = BuildNode(reg, 2.f);
+  root->AddChild(child);
+  root->AddChild(child);
+  root->SetLabel("Root");
+  snapshot.Capture(root);
+  EXPECT_EQ(1U, snapshot.GetCaptureCount());
+
+  // The snapshot has the same structure and values as the scene, and shares
+  // objects that are uploaded to OpenGL.
+  gfx::NodePtr copy = snapshot.AcquireLatest();
+  ASSERT_TRUE(copy.Get());
+  EXPECT_NE(root.Get(), copy.Get());
+  EXPECT_EQ("Root", copy->GetLabel());
+  EXPECT_EQ(1.f, GetValue(copy));
+  ASSERT_EQ(2U, copy->GetChildren().size());
+  EXPECT_NE(child.Get(), copy->GetChildren()[0].Get());
+  EXPECT_EQ(copy->GetChildren()[0].Get(), copy->GetChildren()[1].Get());
+  EXPECT_EQ(2.f, GetValue(copy->GetChildren()[0]));
+  ASSERT_TRUE(copy->GetStateTable().Get());
+  EXPECT_NE(root->GetStateTable().Get(), copy->GetStateTable().Get());
+  EXPECT_TRUE(copy->GetStateTable()->IsEnabled(gfx::StateTable::kDepthTest));
+  ASSERT_EQ(1U, copy->GetShapes().size());
+  const gfx::ShapePtr& shape = copy->GetShapes()[0];
+  EXPECT_NE(root->GetShapes()[0].Get(), shape.Get());
+  EXPECT_EQ(root->GetShapes()[0]->GetAttributeArray().Get(),
+            shape->GetAttributeArray().Get());
+  ASSERT_EQ(1U, shape->GetVertexRangeCount());
+  EXPECT_EQ(math::Range1i(0, 3), shape->GetVertexRange(0));
+
+  // Changes to the scene do not affect the snapshot being drawn.
+  root->SetUniformValue(0U, math::Vector4f(3.f, 0, 0, 1));
+  root->GetShapes()[0]->SetVertexRange(0, math::Range1i(0, 6));
+  root->RemoveChildAt(1U);
+  EXPECT_EQ(1.f, GetValue(copy));
+  EXPECT_EQ(math::Range1i(0, 3), shape->GetVertexRange(0));
+  EXPECT_EQ(2U, copy->GetChildren().size());
+
+  // Until they are captured and the render thread acquires the snapshot.
+  snapshot.Capture(root);
+  EXPECT_EQ(1.f, GetValue(copy));
+  gfx::NodePtr copy2 = snapshot.AcquireLatest();
+  EXPECT_NE(copy.Get(), copy2.Get());
+  EXPECT_EQ(3.f, GetValue(copy2));
+  EXPECT_EQ(1U, copy2->GetChildren().size());
+  EXPECT_EQ(math::Range1i(0, 6), copy2->GetShapes()[0]->GetVertexRange(0));
+  EXPECT_EQ(1.f, GetValue(copy));
+  EXPECT_EQ(copy2.Get(), snapshot.AcquireLatest().Get());
+
+  // Capturing without a scene publishes an empty snapshot.
+  snapshot.Capture(gfx::NodePtr());
+  EXPECT_FALSE(snapshot.AcquireLatest().Get());
+}
+
+TEST(SceneSnapshotTest, SnapshotsAreReused) {
+  const gfx::ShaderInputRegistryPtr& reg =
+      gfx::ShaderInputRegistry::GetGlobalRegistry();
+  SceneSnapshot snapshot((base::AllocatorPtr()));
+  gfx::NodePtr root = BuildNode(reg, 1.f);
+  gfx::NodePtr child = BuildNode(reg, 2.f);
+  root->AddChild(child);
+
+  snapshot.Capture(root);
+  gfx::NodePtr first = snapshot.AcquireLatest();
+  gfx::Node* child_copy = first->GetChildren()[0].Get();
+
+  // While the first snapshot is drawn, captures skip it.
+  snapshot.Capture(root);
+  snapshot.Capture(root);
+  gfx::Node* third = snapshot.AcquireLatest().Get();
+  EXPECT_NE(first.Get(), third);
+  snapshot.Capture(root);
+  snapshot.Capture(root);
+  gfx::Node* second = snapshot.AcquireLatest().Get();
+  EXPECT_NE(first.Get(), second);
+  EXPECT_NE(third, second);
+
+  // Capturing into a snapshot again updates the same copies.
+  snapshot.Capture(root);
+  EXPECT_EQ(first.Get(), snapshot.AcquireLatest().Get());
+  EXPECT_EQ(child_copy, first->GetChildren()[0].Get());
+
+  // Copies of objects that were removed from the scene are released.
+  gfx::NodePtr child_copy_ptr(child_copy);
+  root->ClearChildren();
+  snapshot.Capture(root);
+  snapshot.AcquireLatest();
+  snapshot.Capture(root);
+  EXPECT_EQ(first.Get(), snapshot.AcquireLatest().Get());
+  EXPECT_TRUE(first->GetChildren().empty());
+  EXPECT_EQ(1, child_copy_ptr->GetRefCount());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -199,5 +199,58 @@ TEST_F(ShaderManagerTest, RecreateShaderProgramThatDependOn) {
   EXPECT_EQ("fragment2", program_->GetFragmentShader()->GetSource());
 }
 
+TEST_F(ShaderManagerTest, ShareShadersWithIdenticalSources) {
+  ComposerPtr vertex_composer(new Composer("vertex", "vertex"));
+  ComposerPtr fragment_composer(new Composer("fragment2", "fragment2"));
+  ShaderProgramPtr program = manager_->CreateShaderProgram(
+      "program2", registry_, vertex_composer, fragment_composer);
+  EXPECT_EQ(program_->GetVertexShader().Get(),
+            program->GetVertexShader().Get());
+  EXPECT_NE(program_->GetFragmentShader().Get(),
+            program->GetFragmentShader().Get());
+  EXPECT_EQ("program vertex shader", program->GetVertexShader()->GetLabel());
+  EXPECT_EQ("program2 fragment shader",
+            program->GetFragmentShader()->GetLabel());
+
+  // Unchanged sources keep their shaders.
+  gfx::ShaderPtr vertex_shader = program_->GetVertexShader();
+  gfx::ShaderPtr fragment_shader = program_->GetFragmentShader();
+  manager_->RecreateAllShaderPrograms();
+  EXPECT_EQ(vertex_shader.Get(), program_->GetVertexShader().Get());
+  EXPECT_EQ(vertex_shader.Get(), program->GetVertexShader().Get());
+  EXPECT_EQ(fragment_shader.Get(), program_->GetFragmentShader().Get());
+
+  // A shader that is not shared is updated in place.
+  fragment_composer_->SetSource("fragment3");
+  manager_->RecreateAllShaderPrograms();
+  EXPECT_EQ(fragment_shader.Get(), program_->GetFragmentShader().Get());
+  EXPECT_EQ("fragment3", fragment_shader->GetSource());
+  EXPECT_EQ("fragment2", program->GetFragmentShader()->GetSource());
+
+  // Changing a shared shader does not affect the other program.
+  vertex_composer_->SetSource("vertex2");
+  manager_->RecreateShaderProgramsThatDependOn("vertex");
+  EXPECT_EQ("vertex2", program_->GetVertexShader()->GetSource());
+  EXPECT_EQ("vertex", program->GetVertexShader()->GetSource());
+  EXPECT_NE(program_->GetVertexShader().Get(),
+            program->GetVertexShader().Get());
+  EXPECT_EQ(vertex_shader.Get(), program->GetVertexShader().Get());
+
+  // The programs share the shader again once their sources match.
+  vertex_composer->SetSource("vertex2");
+  manager_->RecreateAllShaderPrograms();
+  EXPECT_EQ(program_->GetVertexShader().Get(),
+            program->GetVertexShader().Get());
+  EXPECT_EQ("vertex", vertex_shader->GetSource());
+
+  // New programs share shaders with the updated sources.
+  ShaderProgramPtr program3 = manager_->CreateShaderProgram(
+      "program3", registry_, ComposerPtr(new Composer("vertex2", "vertex")),
+      ComposerPtr(new Composer("fragment3", "fragment")));
+  EXPECT_EQ(program_->GetVertexShader().Get(),
+            program3->GetVertexShader().Get());
+  EXPECT_EQ(fragment_shader.Get(), program3->GetFragmentShader().Get());
+}
+
 }  // namespace gfxutils
 }  // namespace ion
@@ -443,6 +443,77 @@ TEST_F(ShaderSourceComposerTest, IncludeComposerGetChangedDependencies) {
   EXPECT_EQ("source2", composer->GetDependencyName(3));
 }
 
+TEST_F(ShaderSourceComposerTest, IncludeComposerCachesSources) {
+  std::vector<std::string> loaded;
+  IncludeComposer::SourceLoader loader = [this, &loaded](
+      const std::string& name) {
+    loaded.push_back(name);
+    return holder_.GetSource(name);
+  };
+  ShaderSourceComposerPtr composer(new IncludeComposer(
+      "source1", loader,
+      bind(&ShaderSourceComposerTest::StringSourceSaver, this, _1, _2),
+      bind(&ShaderSourceComposerTest::StringSourceTime, this, _1, _2), false));
+  EXPECT_EQ("Source\nstring 1\nSource string 2", composer->GetSource());
+  EXPECT_EQ(2U, loaded.size());
+
+  // Nothing has changed, so nothing is loaded again.
+  loaded.clear();
+  EXPECT_EQ("Source\nstring 1\nSource string 2", composer->GetSource());
+  EXPECT_TRUE(loaded.empty());
+
+  // Only the changed file is loaded again.
+  holder_.SetSource("source2", "New source 2");
+  EXPECT_EQ("Source\nstring 1\nNew source 2", composer->GetSource());
+  EXPECT_EQ(1U, loaded.size());
+  EXPECT_EQ("source2", loaded[0]);
+
+  // Setting a dependency through the composer is picked up as well.
+  loaded.clear();
+  EXPECT_TRUE(composer->SetDependencySource("source1", "Source 1"));
+  EXPECT_EQ("Source 1", composer->GetSource());
+  EXPECT_EQ(1U, loaded.size());
+  EXPECT_EQ("source1", loaded[0]);
+
+  // Without modification times every file is loaded, and changes are found by
+  // comparing sources.
+  holder_.SetSource("source1", "Source\nstring 1\n$input \"source2\"");
+  composer.Reset(new IncludeComposer(
+      "source1", loader,
+      bind(&ShaderSourceComposerTest::StringSourceSaver, this, _1, _2),
+      [](const std::string& name,
+         std::chrono::system_clock::time_point* timestamp) { return false; },
+      false));
+  EXPECT_EQ("Source\nstring 1\nNew source 2", composer->GetSource());
+  loaded.clear();
+  EXPECT_EQ("Source\nstring 1\nNew source 2", composer->GetSource());
+  EXPECT_EQ(2U, loaded.size());
+  holder_.SetSource("source2", "Source string 2\n");
+  EXPECT_EQ("Source\nstring 1\nSource string 2", composer->GetSource());
+}
+
+TEST_F(ShaderSourceComposerTest, IncludeComposerPrefetchesInputs) {
+  std::vector<std::string> prefetched;
+  IncludeComposerPtr composer(new IncludeComposer(
+      "path/depth/source8",
+      bind(&ShaderSourceComposerTest::StringSourceLoader, this, _1),
+      bind(&ShaderSourceComposerTest::StringSourceSaver, this, _1, _2),
+      bind(&ShaderSourceComposerTest::StringSourceTime, this, _1, _2), false));
+  composer->SetSourcePrefetcher(
+      [&prefetched](const std::vector<std::string>& names) {
+        prefetched.insert(prefetched.end(), names.begin(), names.end());
+      });
+  EXPECT_EQ("Source string 8\nSource string 9", composer->GetSource());
+  // The $input of the top-level file is prefetched with its full path.
+  ASSERT_EQ(1U, prefetched.size());
+  EXPECT_EQ("path/depth/to/source9", prefetched[0]);
+
+  // Cached files are not prefetched again.
+  prefetched.clear();
+  EXPECT_EQ("Source string 8\nSource string 9", composer->GetSource());
+  EXPECT_TRUE(prefetched.empty());
+}
+
 TEST_F(ShaderSourceComposerTest, ZipAssetComposer) {
   ZipAssetComposerTest::RegisterAssets();
   std::vector<std::string> names;
@@ -0,0 +1,156 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+
+#include "ion/gfxutils/shadervariants.h"
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfxutils/shadermanager.h"
+#include "ion/gfxutils/shadersourcecomposer.h"
+
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+using gfx::ShaderInputRegistry;
+using gfx::ShaderInputRegistryPtr;
+using gfx::ShaderProgramPtr;
+
+class ShaderVariantsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    manager_.Reset(new ShaderManager());
+    vertex_composer_.Reset(
+        new StringComposer("vertex", "#version 100\nvertex\n"));
+    fragment_composer_.Reset(new StringComposer("fragment", "fragment\n"));
+    variants_.Reset(new ShaderVariants(
+        manager_, "material", ShaderInputRegistryPtr(new ShaderInputRegistry),
+        vertex_composer_, fragment_composer_));
+  }
+
+  ShaderManagerPtr manager_;
+  StringComposerPtr vertex_composer_;
+  StringComposerPtr fragment_composer_;
+  ShaderVariantsPtr variants_;
+};
+
+TEST_F(ShaderVariantsTest, Features) {
+  base::LogChecker log_checker;
+  std::vector<std::string> values;
+  values.push_back("NONE");
+  values.push_back("LAMBERT");
+  values.push_back("PHONG");
+  EXPECT_TRUE(variants_->AddFeature("SKINNED"));
+  EXPECT_TRUE(variants_->AddFeature("LIGHTING", values));
+  EXPECT_TRUE(variants_->AddFeature("FOG"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Invalid features.
+  EXPECT_FALSE(variants_->AddFeature(""));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "empty or already used"));
+  EXPECT_FALSE(variants_->AddFeature("FOG"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "empty or already used"));
+  EXPECT_FALSE(variants_->AddFeature("MODE", std::vector<std::string>(1, "A")));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "at least two values"));
+  EXPECT_FALSE(variants_->AddFeature("MODE", std::vector<std::string>(2, "A")));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "empty or duplicate value"));
+  for (int i = 0; i < 61; ++i)
+    variants_->AddFeature("BIT" + std::to_string(i));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "too many features"));
+
+  // Keys.
+  ShaderVariants::Key key = variants_->SetFeature(0, "FOG", true);
+  key = variants_->SetFeature(key, "LIGHTING", "PHONG");
+  EXPECT_EQ(key, variants_->SetFeature(key, "SKINNED", false));
+  EXPECT_EQ(key, variants_->SetFeature(key, "LIGHTING", true));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no boolean feature"));
+  EXPECT_EQ(key, variants_->SetFeature(key, "LIGHTING", "GOURAUD"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no feature \"LIGHTING\""));
+  EXPECT_EQ(key, variants_->SetFeature(key, "FOG", "ON"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no feature \"FOG\""));
+  EXPECT_EQ("#define LIGHTING_NONE 0\n"
+            "#define LIGHTING_LAMBERT 1\n"
+            "#define LIGHTING_PHONG 2\n"
+            "#define LIGHTING 2\n"
+            "#define FOG 1\n",
+            variants_->GetDefines(key));
+  EXPECT_EQ(variants_->SetFeature(0, "LIGHTING", "PHONG"),
+            variants_->SetFeature(key, "FOG", false));
+  EXPECT_EQ(0U, variants_->SetFeature(key, "LIGHTING", "NONE") &
+                variants_->SetFeature(0, "LIGHTING", "PHONG"));
+}
+
+TEST_F(ShaderVariantsTest, GetShaderProgram) {
+  base::LogChecker log_checker;
+  std::vector<std::string> values;
+  values.push_back("NONE");
+  values.push_back("LAMBERT");
+  values.push_back("PHONG");
+  EXPECT_TRUE(variants_->AddFeature("SKINNED"));
+  EXPECT_TRUE(variants_->AddFeature("LIGHTING", values));
+  EXPECT_EQ(0U, variants_->GetVariantCount());
+
+  const ShaderVariants::Key key = variants_->SetFeature(
+      variants_->SetFeature(0, "SKINNED", true), "LIGHTING", "LAMBERT");
+  ShaderProgramPtr program = variants_->GetShaderProgram(key);
+  ASSERT_TRUE(program.Get());
+  EXPECT_EQ(1U, variants_->GetVariantCount());
+  EXPECT_EQ("material[SKINNED,LIGHTING=LAMBERT]", program->GetLabel());
+  EXPECT_EQ(program.Get(),
+            manager_->GetShaderProgram(program->GetLabel()).Get());
+  const std::string defines = variants_->GetDefines(key);
+  EXPECT_EQ("#version 100\n" + defines + "#line 2\nvertex\n",
+            program->GetVertexShader()->GetSource());
+  EXPECT_EQ(defines + "#line 1\nfragment\n",
+            program->GetFragmentShader()->GetSource());
+
+  // Variants are cached.
+  EXPECT_EQ(program.Get(), variants_->GetShaderProgram(key).Get());
+  ShaderProgramPtr program2 = variants_->GetShaderProgram(0);
+  EXPECT_NE(program.Get(), program2.Get());
+  EXPECT_EQ("material[]", program2->GetLabel());
+  EXPECT_EQ(2U, variants_->GetVariantCount());
+
+  // Invalid keys and late features are rejected.
+  EXPECT_FALSE(variants_->GetShaderProgram(3U << 1).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid key"));
+  EXPECT_FALSE(variants_->GetShaderProgram(1U << 3).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid key"));
+  EXPECT_FALSE(variants_->AddFeature("FOG"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "after variants"));
+
+  // Variants are recreated through the manager.
+  vertex_composer_->SetDependencySource("vertex", "vertex2\n");
+  manager_->RecreateShaderProgramsThatDependOn("vertex");
+  EXPECT_EQ(defines + "#line 1\nvertex2\n",
+            program->GetVertexShader()->GetSource());
+
+  // Only unreferenced variants are released.
+  program2.Reset(NULL);
+  EXPECT_EQ(1U, variants_->ReleaseUnusedVariants());
+  EXPECT_EQ(1U, variants_->GetVariantCount());
+  EXPECT_EQ(program.Get(), variants_->GetShaderProgram(key).Get());
+  program.Reset(NULL);
+  EXPECT_EQ(1U, variants_->ReleaseUnusedVariants());
+  EXPECT_EQ(0U, variants_->GetVariantCount());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
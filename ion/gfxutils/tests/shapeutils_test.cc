@@ -17,12 +17,14 @@ limitations under the License.
 
 #include "ion/gfxutils/shapeutils.h"
 
+#include <cstring>
 #include <sstream>
 
 #include "base/integral_types.h"
 #include "ion/base/allocationmanager.h"
 #include "ion/base/invalid.h"
 #include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
 #include "ion/base/zipassetmanager.h"
 #include "ion/base/zipassetmanagermacros.h"
 #include "ion/gfx/attributearray.h"
@@ -32,6 +34,7 @@ limitations under the License.
 #include "ion/math/transformutils.h"
 #include "ion/math/vector.h"
 #include "ion/math/vectorutils.h"
+#include "ion/port/fileutils.h"
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -653,6 +656,63 @@ TEST(ShapeUtilsTest, VertexTypes) {
   // tested already.
 }
 
+TEST(ShapeUtilsTest, CompactVertexFormat) {
+  // Positions are divided by the scale, so the corners of the rectangle map to
+  // the limits of the normalized range.
+  RectangleSpec spec;
+  spec.vertex_format = ShapeSpec::kCompactVertices;
+  spec.compact_position_scale = 0.5f;
+
+  typedef BufferObjectValue<math::Vector4i16> CompactPosBov;
+  typedef BufferObjectValue<math::Vector2ui16> CompactTexBov;
+  typedef BufferObjectValue<math::Vector4i8> CompactNormBov;
+  std::vector<CompactPosBov> pos_bovs;
+  pos_bovs.push_back(CompactPosBov(0, math::Vector4i16(-32767, -32767, 0,
+                                                       32767)));
+  pos_bovs.push_back(CompactPosBov(2, math::Vector4i16(32767, 32767, 0,
+                                                       32767)));
+  std::vector<CompactTexBov> tex_bovs;
+  tex_bovs.push_back(CompactTexBov(0, math::Vector2ui16(0, 0)));
+  tex_bovs.push_back(CompactTexBov(2, math::Vector2ui16(65535, 65535)));
+  std::vector<CompactNormBov> norm_bovs;
+  norm_bovs.push_back(CompactNormBov(1, math::Vector4i8(0, 0, 127, 0)));
+
+  // Every vertex type is half the size of the float version, or less.
+  static const size_t kVertexSizes[] = { 8U, 12U, 12U, 16U };
+  for (int i = ShapeSpec::kPosition; i <= ShapeSpec::kPositionTexCoordsNormal;
+       ++i) {
+    SCOPED_TRACE(i);
+    spec.vertex_type = static_cast<ShapeSpec::VertexType>(i);
+    gfx::ShapePtr rect = BuildRectangleShape(spec);
+    const gfx::AttributeArrayPtr& aa = rect->GetAttributeArray();
+    ASSERT_FALSE(aa.Get() == NULL);
+    for (size_t j = 0; j < aa->GetBufferAttributeCount(); ++j)
+      EXPECT_TRUE(aa->GetBufferAttribute(j).IsFixedPointNormalized());
+    const gfx::BufferObjectPtr& bo = aa->GetBufferAttribute(0)
+        .GetValue<gfx::BufferObjectElement>().buffer_object;
+    EXPECT_EQ(kVertexSizes[i], bo->GetStructSize());
+    EXPECT_TRUE(TestBoe(aa, 0, 4U, gfx::BufferObject::kShort, 4U, pos_bovs));
+    size_t index = 1;
+    if (i == ShapeSpec::kPositionTexCoords ||
+        i == ShapeSpec::kPositionTexCoordsNormal) {
+      EXPECT_TRUE(TestBoe(aa, index++, 2U, gfx::BufferObject::kUnsignedShort,
+                          4U, tex_bovs));
+    }
+    if (i == ShapeSpec::kPositionNormal ||
+        i == ShapeSpec::kPositionTexCoordsNormal) {
+      EXPECT_TRUE(TestBoe(aa, index++, 4U, gfx::BufferObject::kByte, 4U,
+                          norm_bovs));
+    }
+    EXPECT_EQ(index, aa->GetBufferAttributeCount());
+  }
+
+  // Positions beyond the scale are clamped.
+  spec.vertex_type = ShapeSpec::kPosition;
+  spec.compact_position_scale = 0.25f;
+  EXPECT_TRUE(TestBoe(BuildRectangleShape(spec)->GetAttributeArray(), 0, 4U,
+                      gfx::BufferObject::kShort, 4U, pos_bovs));
+}
+
 TEST(ShapeUtilsTest, Box) {
   BoxSpec spec;
 
@@ -1163,6 +1223,31 @@ TEST(ShapeUtilsTest, ModifiedCylinder) {
   }
 }
 
+// Returns whether two external Shapes have the same vertex and index data.
+bool ExternalShapesMatch(const gfx::ShapePtr& a, const gfx::ShapePtr& b) {
+  if (!a.Get() || !b.Get())
+    return a.Get() == b.Get();
+  const gfx::BufferObjectPtr& a_vertices =
+      a->GetAttributeArray()->GetBufferAttribute(0).GetValue<
+          gfx::BufferObjectElement>().buffer_object;
+  const gfx::BufferObjectPtr& b_vertices =
+      b->GetAttributeArray()->GetBufferAttribute(0).GetValue<
+          gfx::BufferObjectElement>().buffer_object;
+  const gfx::IndexBufferPtr& a_indices = a->GetIndexBuffer();
+  const gfx::IndexBufferPtr& b_indices = b->GetIndexBuffer();
+  return a->GetAttributeArray()->GetBufferAttributeCount() ==
+      b->GetAttributeArray()->GetBufferAttributeCount() &&
+      a_vertices->GetStructSize() == b_vertices->GetStructSize() &&
+      a_vertices->GetCount() == b_vertices->GetCount() &&
+      memcmp(a_vertices->GetData()->GetData(),
+             b_vertices->GetData()->GetData(),
+             a_vertices->GetStructSize() * a_vertices->GetCount()) == 0 &&
+      a_indices->GetSpec(0).type == b_indices->GetSpec(0).type &&
+      a_indices->GetCount() == b_indices->GetCount() &&
+      memcmp(a_indices->GetData()->GetData(), b_indices->GetData()->GetData(),
+             a_indices->GetStructSize() * a_indices->GetCount()) == 0;
+}
+
 void VerifyExternalModelLoading(ExternalShapeSpec spec,
                                 const std::string& base_name,
                                 const std::vector<PosBov>& vertices,
@@ -1202,6 +1287,109 @@ void VerifyExternalModelLoading(ExternalShapeSpec spec,
   }
 }
 
+// Returns whether the vertex and index data of two shapes are identical.
+static ::testing::AssertionResult HaveSameData(const gfx::ShapePtr& expected,
+                                               const gfx::ShapePtr& actual) {
+  const gfx::BufferObjectPtr buffers[2][2] = {
+    { expected->GetAttributeArray()->GetBufferAttribute(0).GetValue<
+          gfx::BufferObjectElement>().buffer_object,
+      expected->GetIndexBuffer() },
+    { actual->GetAttributeArray()->GetBufferAttribute(0).GetValue<
+          gfx::BufferObjectElement>().buffer_object,
+      actual->GetIndexBuffer() }
+  };
+  if (expected->GetAttributeArray()->GetBufferAttributeCount() !=
+      actual->GetAttributeArray()->GetBufferAttributeCount())
+    return ::testing::AssertionFailure() << "Different attribute counts";
+  for (int i = 0; i < 2; ++i) {
+    const gfx::BufferObjectPtr& e = buffers[0][i];
+    const gfx::BufferObjectPtr& a = buffers[1][i];
+    if (e->GetStructSize() != a->GetStructSize() ||
+        e->GetCount() != a->GetCount())
+      return ::testing::AssertionFailure() << "Different sizes in buffer " << i;
+    if (memcmp(e->GetData()->GetData(), a->GetData()->GetData(),
+               e->GetStructSize() * e->GetCount()) != 0)
+      return ::testing::AssertionFailure() << "Different data in buffer " << i;
+  }
+  return ::testing::AssertionSuccess();
+}
+
+TEST(ShapeUtilsTest, UpdateShapes) {
+  base::TaskScheduler scheduler("shapeutils", 3U);
+  EllipsoidSpec ellipsoid_spec;
+  ellipsoid_spec.usage_mode = gfx::BufferObject::kDynamicDraw;
+  CylinderSpec cylinder_spec;
+  cylinder_spec.usage_mode = gfx::BufferObject::kDynamicDraw;
+  cylinder_spec.top_radius = .25f;
+  cylinder_spec.cap_band_count = 3U;
+  for (int format = 0; format < 2; ++format) {
+    for (int type = 0; type < 4; ++type) {
+      SCOPED_TRACE(::testing::Message() << "Format " << format << " type "
+                                        << type);
+      ellipsoid_spec.vertex_format =
+          static_cast<ShapeSpec::VertexFormat>(format);
+      ellipsoid_spec.vertex_type = static_cast<ShapeSpec::VertexType>(type);
+      cylinder_spec.vertex_format = ellipsoid_spec.vertex_format;
+      cylinder_spec.vertex_type = ellipsoid_spec.vertex_type;
+
+      // Small and large shapes are the same as when they are built, with or
+      // without a scheduler.
+      ellipsoid_spec.band_count = ellipsoid_spec.sector_count = 10U;
+      cylinder_spec.shaft_band_count = cylinder_spec.sector_count = 10U;
+      gfx::ShapePtr ellipsoid(new gfx::Shape);
+      UpdateEllipsoidShape(ellipsoid_spec, NULL, ellipsoid);
+      EXPECT_EQ("Ellipsoid", ellipsoid->GetLabel());
+      EXPECT_TRUE(HaveSameData(BuildEllipsoidShape(ellipsoid_spec),
+                               ellipsoid));
+      gfx::ShapePtr cylinder(new gfx::Shape);
+      UpdateCylinderShape(cylinder_spec, &scheduler, cylinder);
+      EXPECT_EQ("Cylinder", cylinder->GetLabel());
+      EXPECT_TRUE(HaveSameData(BuildCylinderShape(cylinder_spec), cylinder));
+
+      // Larger shapes reuse the AttributeArrays and BufferObjects.
+      const gfx::AttributeArray* attribute_array =
+          ellipsoid->GetAttributeArray().Get();
+      const gfx::IndexBuffer* index_buffer = ellipsoid->GetIndexBuffer().Get();
+      ellipsoid_spec.band_count = 60U;
+      ellipsoid_spec.sector_count = 100U;
+      UpdateEllipsoidShape(ellipsoid_spec, &scheduler, ellipsoid);
+      EXPECT_EQ(attribute_array, ellipsoid->GetAttributeArray().Get());
+      EXPECT_EQ(index_buffer, ellipsoid->GetIndexBuffer().Get());
+      EXPECT_TRUE(HaveSameData(BuildEllipsoidShape(ellipsoid_spec),
+                               ellipsoid));
+      cylinder_spec.shaft_band_count = 100U;
+      cylinder_spec.sector_count = 60U;
+      UpdateCylinderShape(cylinder_spec, &scheduler, cylinder);
+      EXPECT_TRUE(HaveSameData(BuildCylinderShape(cylinder_spec), cylinder));
+
+      // Smaller shapes also reuse the memory of the data.
+      const void* vertex_data =
+          ellipsoid->GetAttributeArray()->GetBufferAttribute(0).GetValue<
+              gfx::BufferObjectElement>().buffer_object->GetData()->GetData();
+      const void* index_data =
+          ellipsoid->GetIndexBuffer()->GetData()->GetData();
+      ellipsoid_spec.band_count = 50U;
+      UpdateEllipsoidShape(ellipsoid_spec, &scheduler, ellipsoid);
+      EXPECT_EQ(vertex_data,
+          ellipsoid->GetAttributeArray()->GetBufferAttribute(0).GetValue<
+              gfx::BufferObjectElement>().buffer_object->GetData()->GetData());
+      EXPECT_EQ(index_data, ellipsoid->GetIndexBuffer()->GetData()->GetData());
+      EXPECT_TRUE(HaveSameData(BuildEllipsoidShape(ellipsoid_spec),
+                               ellipsoid));
+    }
+  }
+
+  // Shapes with a different vertex type get new attributes.
+  gfx::ShapePtr shape = BuildBoxShape(BoxSpec());
+  const gfx::AttributeArray* attribute_array =
+      shape->GetAttributeArray().Get();
+  ellipsoid_spec.vertex_type = ShapeSpec::kPosition;
+  UpdateEllipsoidShape(ellipsoid_spec, NULL, shape);
+  EXPECT_NE(attribute_array, shape->GetAttributeArray().Get());
+  EXPECT_EQ(1U, shape->GetAttributeArray()->GetBufferAttributeCount());
+  EXPECT_TRUE(HaveSameData(BuildEllipsoidShape(ellipsoid_spec), shape));
+}
+
 TEST(ShapeUtilsTest, ExternalFormats) {
   ShapeUtilsTest::RegisterAssets();
 
@@ -1390,5 +1578,231 @@ TEST(ShapeUtilsTest, ExternalFormats) {
   EXPECT_TRUE(box.Get() == NULL);
 }
 
+TEST(ShapeUtilsTest, ExternalFormatsFromData) {
+  ShapeUtilsTest::RegisterAssets();
+  base::TaskScheduler scheduler("shapeutils", 3U);
+
+  static const char* kExtensions[] = {"3ds", "dae", "lwo", "obj", "off"};
+  for (int i = 0; i <= ExternalShapeSpec::kOff; ++i) {
+    const std::string asset_name = std::string("model.") + kExtensions[i];
+    SCOPED_TRACE("Testing asset " + asset_name);
+    const std::string& asset_data =
+        base::ZipAssetManager::GetFileData(asset_name);
+    ExternalShapeSpec spec;
+    spec.format = static_cast<ExternalShapeSpec::Format>(i);
+    spec.vertex_type = ShapeSpec::kPositionTexCoordsNormal;
+    std::istringstream in(asset_data);
+    gfx::ShapePtr expected = LoadExternalShape(spec, in);
+    ASSERT_TRUE(expected.Get() != NULL);
+    EXPECT_TRUE(ExternalShapesMatch(
+        expected, LoadExternalShapeFromData(spec, asset_data.data(),
+                                            asset_data.size(), NULL)));
+    EXPECT_TRUE(ExternalShapesMatch(
+        expected, LoadExternalShapeFromData(spec, asset_data.data(),
+                                            asset_data.size(), &scheduler)));
+  }
+
+  // A mesh with 32-bit indices.
+  ExternalShapeSpec spec;
+  spec.format = ExternalShapeSpec::kObj;
+  spec.index_size = ExternalShapeSpec::k32Bit;
+  const std::string& asset_data =
+      base::ZipAssetManager::GetFileData("model_with_32bit_indices.obj");
+  std::istringstream in(asset_data);
+  gfx::ShapePtr expected = LoadExternalShape(spec, in);
+  ASSERT_TRUE(expected.Get() != NULL);
+  EXPECT_TRUE(ExternalShapesMatch(
+      expected, LoadExternalShapeFromData(spec, asset_data.data(),
+                                          asset_data.size(), &scheduler)));
+}
+
+TEST(ShapeUtilsTest, LargeObjFromData) {
+  // Build an OBJ grid that is large enough to be split into several chunks,
+  // with comments, continued lines, and quads that have to be triangulated.
+  static const int kSize = 300;
+  std::ostringstream obj;
+  obj << "# A " << kSize << "x" << kSize << " grid.\n";
+  for (int y = 0; y <= kSize; ++y) {
+    const float fy = static_cast<float>(y);
+    for (int x = 0; x <= kSize; ++x) {
+      const float fx = static_cast<float>(x);
+      obj << "v " << fx * 0.125f << " " << fy * -0.03f << " 1.5e-2\n";
+      obj << "vt " << fx / static_cast<float>(kSize) << " \\\n"
+          << fy / static_cast<float>(kSize) << "\r\n";
+    }
+  }
+  obj << "vn 0 0 1\nvn 0 0.6 0.8\n";
+  for (int y = 0; y < kSize; ++y) {
+    for (int x = 0; x < kSize; ++x) {
+      const int i = y * (kSize + 1) + x + 1;
+      const int n = (x + y) % 2 + 1;
+      obj << "f " << i << "/" << i << "/" << n << " " << i + 1 << "/"
+          << i + 1 << "/" << n << " " << i + kSize + 2 << "/" << i + kSize + 2
+          << "/" << n << "\t" << i + kSize + 1 << "/" << i + kSize + 1 << "/"
+          << n << "\n";
+    }
+  }
+  const std::string data = obj.str();
+  EXPECT_LT(4U << 20, data.size());
+
+  ExternalShapeSpec spec;
+  spec.format = ExternalShapeSpec::kObj;
+  spec.index_size = ExternalShapeSpec::k32Bit;
+  std::istringstream in(data);
+  gfx::ShapePtr expected = LoadExternalShape(spec, in);
+  ASSERT_TRUE(expected.Get() != NULL);
+  EXPECT_EQ(static_cast<size_t>(kSize * kSize * 6),
+            expected->GetIndexBuffer()->GetCount());
+
+  base::TaskScheduler scheduler("shapeutils", 4U);
+  EXPECT_TRUE(ExternalShapesMatch(
+      expected,
+      LoadExternalShapeFromData(spec, data.data(), data.size(), NULL)));
+  EXPECT_TRUE(ExternalShapesMatch(
+      expected,
+      LoadExternalShapeFromData(spec, data.data(), data.size(), &scheduler)));
+}
+
+TEST(ShapeUtilsTest, ExternalFormatsFromDataErrors) {
+  base::LogChecker log_checker;
+  ExternalShapeSpec spec;
+  spec.format = ExternalShapeSpec::kObj;
+
+  const struct {
+    const char* data;
+    const char* message;
+  } kObjErrors[] = {
+    { "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 -1\n", "Negative vertex references" },
+    { "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n", "Invalid index (zero)" },
+    { "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n", "Invalid vertex index" },
+    { "v 0 0 0\nv 1 0 0\nv 0 1 0\nvt 0 0\nf 1/1 2/2 3/1\n",
+      "Invalid texture coordinate index" },
+    { "v 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nf 1//1 2//1 3//2\n",
+      "Invalid vertex normal index" },
+    { "v 0 zero 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n", "Invalid vertex position" },
+    { "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3a\n", "Invalid face element" },
+  };
+  for (const auto& error : kObjErrors) {
+    SCOPED_TRACE(error.data);
+    EXPECT_TRUE(LoadExternalShapeFromData(spec, error.data,
+                                          strlen(error.data), NULL).Get() ==
+                NULL);
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", error.message));
+  }
+
+  // Numbers that are not handled by the fast number parser.
+  static const char kObj[] =
+      "v 1.00000000000000000001 -2E+1 3e-30 # Comment.\n"
+      "v 1 0\nv +.5\nf 1 2 3\n";
+  gfx::ShapePtr shape =
+      LoadExternalShapeFromData(spec, kObj, strlen(kObj), NULL);
+  std::istringstream in(kObj);
+  EXPECT_TRUE(ExternalShapesMatch(LoadExternalShape(spec, in), shape));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  spec.format = ExternalShapeSpec::kOff;
+  const struct {
+    const char* data;
+    const char* message;
+  } kOffErrors[] = {
+    { "ON\n3 1 0\n", "missing OFF signature" },
+    { "OFF\n0 1 0\n", "bad vertex count" },
+    { "OFF\n3 0 0\n", "bad face count" },
+    { "OFF\n3 1 0\n0 0 0\n1 0 0\n", "bad vertex" },
+    { "OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n", "bad face" },
+    { "OFF\n3 1 0\n0 0 0\n1 0 0\n0 1 0\n3 0 1 3\n", "bad face index" },
+  };
+  for (const auto& error : kOffErrors) {
+    SCOPED_TRACE(error.data);
+    EXPECT_TRUE(LoadExternalShapeFromData(spec, error.data,
+                                          strlen(error.data), NULL).Get() ==
+                NULL);
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", error.message));
+  }
+
+  EXPECT_TRUE(LoadExternalShapeFromFile(spec, "/InvalidPath/DoesNotExist",
+                                        NULL).Get() == NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Unable to map"));
+}
+
+TEST(ShapeUtilsTest, IonMesh) {
+  base::LogChecker log_checker;
+  for (int i = 0; i <= 2 * ShapeSpec::kPositionTexCoordsNormal + 1; ++i) {
+    SCOPED_TRACE(i);
+    EllipsoidSpec spec;
+    spec.vertex_type = static_cast<ShapeSpec::VertexType>(i / 2);
+    spec.vertex_format = static_cast<ShapeSpec::VertexFormat>(i % 2);
+    gfx::ShapePtr ellipsoid = BuildEllipsoidShape(spec);
+    std::ostringstream out;
+    EXPECT_TRUE(SaveIonMesh(ellipsoid, out));
+    const std::string data = out.str();
+    EXPECT_EQ(std::string("IMSH"), data.substr(0, 4));
+
+    // The spec's vertex type and transform do not affect the loaded Shape.
+    ExternalShapeSpec external_spec;
+    external_spec.format = ExternalShapeSpec::kIonMesh;
+    external_spec.scale = 2.f;
+    external_spec.vertex_type = ShapeSpec::kPosition;
+    external_spec.vertex_format = ShapeSpec::kFloatVertices;
+    gfx::ShapePtr loaded = LoadExternalShapeFromData(
+        external_spec, data.data(), data.size(), NULL);
+    ASSERT_TRUE(loaded.Get() != NULL);
+    EXPECT_TRUE(ExternalShapesMatch(ellipsoid, loaded));
+    EXPECT_EQ(ellipsoid->GetAttributeArray()->GetAttributeCount(),
+              loaded->GetAttributeArray()->GetAttributeCount());
+    const gfx::Attribute& position =
+        loaded->GetAttributeArray()->GetBufferAttribute(0);
+    const gfx::BufferObjectElement& element =
+        position.GetValue<gfx::BufferObjectElement>();
+    EXPECT_EQ(i % 2 ? gfx::BufferObject::kShort : gfx::BufferObject::kFloat,
+              element.buffer_object->GetSpec(element.spec_index).type);
+    EXPECT_EQ(i % 2 == 1, position.IsFixedPointNormalized());
+    EXPECT_EQ(gfx::Shape::kTriangles, loaded->GetPrimitiveType());
+
+    // Loading the mesh from a file maps the data without copying it.
+    const std::string filename = port::GetTemporaryFilename();
+    ASSERT_FALSE(filename.empty());
+    FILE* fp = port::OpenFile(filename, "wb");
+    ASSERT_TRUE(fp);
+    fwrite(data.data(), 1U, data.size(), fp);
+    fclose(fp);
+    loaded = LoadExternalShapeFromFile(external_spec, filename, NULL);
+    ASSERT_TRUE(loaded.Get() != NULL);
+    EXPECT_TRUE(ExternalShapesMatch(ellipsoid, loaded));
+    EXPECT_TRUE(loaded->GetIndexBuffer()->GetData()->IsReadOnly());
+    port::RemoveFile(filename);
+  }
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Invalid data.
+  ExternalShapeSpec spec;
+  spec.format = ExternalShapeSpec::kIonMesh;
+  EXPECT_TRUE(LoadExternalShapeFromData(spec, "IMSH", 4U, NULL).Get() == NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "too short"));
+  std::ostringstream out;
+  EXPECT_TRUE(SaveIonMesh(BuildBoxShape(BoxSpec()), out));
+  std::string data = out.str();
+  EXPECT_TRUE(LoadExternalShapeFromData(spec, data.data(), data.size() - 1U,
+                                        NULL).Get() == NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Invalid Ion mesh data size"));
+  data[0] = 'X';
+  EXPECT_TRUE(LoadExternalShapeFromData(spec, data.data(), data.size(),
+                                        NULL).Get() == NULL);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Invalid Ion mesh header"));
+
+  // Shapes that cannot be saved.
+  EXPECT_FALSE(SaveIonMesh(gfx::ShapePtr(), out));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Only indexed triangle"));
+  gfx::ShapePtr lines = BuildBoxShape(BoxSpec());
+  lines->SetPrimitiveType(gfx::Shape::kLines);
+  EXPECT_FALSE(SaveIonMesh(lines, out));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Only indexed triangle"));
+  BoxSpec wiped_spec;
+  gfx::ShapePtr wiped = BuildBoxShape(wiped_spec);
+  wiped->GetIndexBuffer()->GetData()->WipeData();
+  EXPECT_FALSE(SaveIonMesh(wiped, out));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "has been wiped"));
+}
+
 }  // namespace gfxutils
 }  // namespace ion
@@ -0,0 +1,132 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/texturearraypacker.h"
+
+#include <vector>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns an image of the passed format and width, two pixels tall, whose
+// bytes are all |value|.
+static const gfx::ImagePtr CreateImage(gfx::Image::Format format,
+                                       uint32 width, uint8 value) {
+  const size_t size = gfx::Image::ComputeDataSize(format, width, 2U);
+  std::vector<uint8> pixels(size, value);
+  gfx::ImagePtr image(new gfx::Image);
+  image->Set(format, width, 2U,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &pixels[0], size, false, base::AllocatorPtr()));
+  return image;
+}
+
+}  // anonymous namespace
+
+TEST(TextureArrayPackerTest, AddImage) {
+  base::LogChecker log_checker;
+  TextureArrayPacker packer(base::AllocationManager::GetDefaultAllocator());
+  EXPECT_EQ(256U, packer.GetMaxLayers());
+  EXPECT_EQ(0U, packer.GetImageCount());
+
+  EXPECT_EQ(TextureArrayPacker::kInvalidIndex,
+            packer.AddImage(gfx::ImagePtr()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "cannot pack a NULL image"));
+
+  gfx::ImagePtr image(new gfx::Image);
+  EXPECT_EQ(TextureArrayPacker::kInvalidIndex, packer.AddImage(image));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "without data"));
+
+  image->SetArray(gfx::Image::kRgba8888, 2U, 2U, 2U,
+                  base::DataContainer::CreateOverAllocated<uint8>(
+                      32U, NULL, base::AllocatorPtr()));
+  EXPECT_EQ(TextureArrayPacker::kInvalidIndex, packer.AddImage(image));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only dense 2D images"));
+
+  EXPECT_EQ(0U, packer.AddImage(CreateImage(gfx::Image::kRgba8888, 2U, 1U)));
+  EXPECT_EQ(1U, packer.GetImageCount());
+  // The image has not been packed yet.
+  EXPECT_FALSE(packer.GetTexture(0U).Get());
+  EXPECT_EQ(0U, packer.GetLayer(0U));
+  EXPECT_FALSE(packer.GetTexture(1U).Get());
+
+  packer.SetMaxLayers(0U);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "at least 1"));
+  EXPECT_EQ(256U, packer.GetMaxLayers());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(TextureArrayPackerTest, Pack) {
+  TextureArrayPacker packer(base::AllocationManager::GetDefaultAllocator());
+  // Images 0, 2, and 3 are compatible; 1 has a different format and 4 a
+  // different size.
+  packer.AddImage(CreateImage(gfx::Image::kRgba8888, 2U, 10U));
+  packer.AddImage(CreateImage(gfx::Image::kRgb888, 2U, 11U));
+  packer.AddImage(CreateImage(gfx::Image::kRgba8888, 2U, 12U));
+  packer.AddImage(CreateImage(gfx::Image::kRgba8888, 2U, 13U));
+  packer.AddImage(CreateImage(gfx::Image::kRgba8888, 4U, 14U));
+  packer.Pack();
+
+  ASSERT_EQ(3U, packer.GetTextures().size());
+  const gfx::TexturePtr& rgba = packer.GetTextures()[0];
+  EXPECT_EQ(rgba, packer.GetTexture(0U));
+  EXPECT_EQ(rgba, packer.GetTexture(2U));
+  EXPECT_EQ(rgba, packer.GetTexture(3U));
+  EXPECT_EQ(packer.GetTextures()[1], packer.GetTexture(1U));
+  EXPECT_EQ(packer.GetTextures()[2], packer.GetTexture(4U));
+  EXPECT_EQ(0U, packer.GetLayer(0U));
+  EXPECT_EQ(0U, packer.GetLayer(1U));
+  EXPECT_EQ(1U, packer.GetLayer(2U));
+  EXPECT_EQ(2U, packer.GetLayer(3U));
+  EXPECT_EQ(0U, packer.GetLayer(4U));
+
+  // Check the packed image.
+  EXPECT_TRUE(rgba->GetSampler().Get());
+  const gfx::ImagePtr& image = rgba->GetImage(0U);
+  ASSERT_TRUE(image.Get());
+  EXPECT_EQ(gfx::Image::kArray, image->GetType());
+  EXPECT_EQ(gfx::Image::k3d, image->GetDimensions());
+  EXPECT_EQ(gfx::Image::kRgba8888, image->GetFormat());
+  EXPECT_EQ(2U, image->GetWidth());
+  EXPECT_EQ(2U, image->GetHeight());
+  EXPECT_EQ(3U, image->GetDepth());
+  const uint8* data = image->GetData()->GetData<uint8>();
+  EXPECT_EQ(10U, data[0]);
+  EXPECT_EQ(10U, data[15]);
+  EXPECT_EQ(12U, data[16]);
+  EXPECT_EQ(13U, data[47]);
+
+  // Limiting the number of layers splits the compatible images.
+  packer.SetMaxLayers(2U);
+  packer.Pack();
+  ASSERT_EQ(4U, packer.GetTextures().size());
+  EXPECT_EQ(packer.GetTexture(0U), packer.GetTexture(2U));
+  EXPECT_NE(packer.GetTexture(0U), packer.GetTexture(3U));
+  EXPECT_EQ(0U, packer.GetLayer(3U));
+  EXPECT_EQ(2U, packer.GetTexture(2U)->GetImage(0U)->GetDepth());
+  EXPECT_EQ(1U, packer.GetTexture(3U)->GetImage(0U)->GetDepth());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,299 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/texturefeedback.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/sampler.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "ion/gfx/texture.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/matrix.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+static const char kVertexShader[] =
+    "uniform mat4 uProjectionMatrix;\n"
+    "uniform mat4 uModelviewMatrix;\n"
+    "attribute vec3 aVertex;\n"
+    "attribute vec2 aTexCoords;\n"
+    "varying vec2 vTexCoords;\n"
+    "void main() {\n"
+    "  vTexCoords = aTexCoords;\n"
+    "  gl_Position = uProjectionMatrix * uModelviewMatrix *\n"
+    "      vec4(aVertex, 1.);\n"
+    "}\n";
+
+static const char kFragmentShader[] =
+    "#version 100\n"
+    "precision mediump float;\n"
+    "uniform sampler2D uColor;\n"
+    "uniform lowp sampler2D uDetail;\n"
+    "varying vec2 vTexCoords;\n"
+    "vec4 Sample(sampler2D s) { return texture2D(s, vTexCoords); }\n"
+    "void main(void) {\n"
+    "  gl_FragColor = texture2D(uColor, vTexCoords) +\n"
+    "      texture2D( uDetail , vTexCoords, 1.0) + Sample(uColor) +\n"
+    "      texture2DProj(uColor, vec3(vTexCoords, 1.0));\n"
+    "}\n";
+
+// Returns a texture with a size x size image.
+static const gfx::TexturePtr BuildTexture(uint32 size) {
+  gfx::ImagePtr image(new gfx::Image);
+  std::vector<uint8> pixels(size * size * 4U, 0U);
+  image->Set(gfx::Image::kRgba8888, size, size,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &pixels[0], pixels.size(), true, base::AllocatorPtr()));
+  gfx::TexturePtr texture(new gfx::Texture);
+  texture->SetImage(0U, image);
+  texture->SetSampler(gfx::SamplerPtr(new gfx::Sampler));
+  return texture;
+}
+
+// Returns a feedback image in which count pixels sampled sampler of node id
+// with a footprint of 2^-neg_log_footprint, and the rest sampled nothing.
+static const gfx::ImagePtr BuildFeedbackImage(uint32 id, uint8 sampler,
+                                              float neg_log_footprint,
+                                              size_t count) {
+  std::vector<uint8> pixels(16U * 4U, 0U);
+  for (size_t i = 0; i < count; ++i) {
+    pixels[i * 4U] = static_cast<uint8>(id & 0xff);
+    pixels[i * 4U + 1U] = static_cast<uint8>(id >> 8);
+    pixels[i * 4U + 2U] = sampler;
+    pixels[i * 4U + 3U] = static_cast<uint8>(neg_log_footprint * 16.f);
+  }
+  gfx::ImagePtr image(new gfx::Image);
+  image->Set(gfx::Image::kRgba8888, 4U, 4U,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &pixels[0], pixels.size(), true, base::AllocatorPtr()));
+  return image;
+}
+
+}  // anonymous namespace
+
+class TextureFeedbackTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    visual_.reset(new gfx::testing::MockVisual(64, 64));
+    gm_.Reset(new gfx::testing::MockGraphicsManager());
+    renderer_.Reset(new gfx::Renderer(gm_));
+
+    reg_.Reset(new gfx::ShaderInputRegistry);
+    reg_->IncludeGlobalRegistry();
+    reg_->Add(gfx::ShaderInputRegistry::UniformSpec(
+        "uColor", gfx::kTextureUniform, "Color"));
+    reg_->Add(gfx::ShaderInputRegistry::UniformSpec(
+        "uDetail", gfx::kTextureUniform, "Detail"));
+    program_ = gfx::ShaderProgram::BuildFromStrings(
+        "Textured", reg_, kVertexShader, kFragmentShader,
+        base::AllocatorPtr());
+  }
+
+  void TearDown() override {
+    renderer_.Reset(NULL);
+    gm_.Reset(NULL);
+    visual_.reset();
+  }
+
+  // Returns a scene whose root sets uColor and uDetail, with a child that
+  // overrides uColor and draws a textured rectangle.
+  const gfx::NodePtr BuildScene(const gfx::TexturePtr& color,
+                                const gfx::TexturePtr& detail,
+                                const gfx::TexturePtr& child_color) {
+    const gfx::ShaderInputRegistryPtr& global =
+        gfx::ShaderInputRegistry::GetGlobalRegistry();
+    gfx::NodePtr root(new gfx::Node);
+    root->SetShaderProgram(program_);
+    root->AddUniform(global->Create<gfx::Uniform>(
+        "uProjectionMatrix", math::Matrix4f::Identity()));
+    root->AddUniform(global->Create<gfx::Uniform>(
+        "uModelviewMatrix", math::Matrix4f::Identity()));
+    root->AddUniform(reg_->Create<gfx::Uniform>("uColor", color));
+    root->AddUniform(reg_->Create<gfx::Uniform>("uDetail", detail));
+    gfx::StateTablePtr state_table(new gfx::StateTable(64, 64));
+    state_table->SetViewport(0, 0, 64, 64);
+    state_table->Enable(gfx::StateTable::kBlend, true);
+    root->SetStateTable(state_table);
+
+    gfx::NodePtr child(new gfx::Node);
+    child->AddUniform(reg_->Create<gfx::Uniform>("uColor", child_color));
+    RectangleSpec spec;
+    spec.vertex_type = ShapeSpec::kPositionTexCoords;
+    child->AddShape(BuildRectangleShape(spec));
+    root->AddChild(child);
+    return root;
+  }
+
+  std::unique_ptr<gfx::testing::MockVisual> visual_;
+  gfx::testing::MockGraphicsManagerPtr gm_;
+  gfx::RendererPtr renderer_;
+  gfx::ShaderInputRegistryPtr reg_;
+  gfx::ShaderProgramPtr program_;
+};
+
+TEST_F(TextureFeedbackTest, Composer) {
+  base::LogChecker log_checker;
+  TextureFeedbackComposerPtr composer(new TextureFeedbackComposer(
+      ShaderSourceComposerPtr(new StringComposer("f", kFragmentShader))));
+  EXPECT_TRUE(composer->DependsOn("f"));
+  EXPECT_FALSE(composer->DependsOn("g"));
+  EXPECT_EQ(kFragmentShader, composer->GetDependencySource("f"));
+  EXPECT_TRUE(composer->GetSamplerNames().empty());
+
+  const std::string source = composer->GetSource();
+  // Function parameters are not uniforms.
+  ASSERT_EQ(2U, composer->GetSamplerNames().size());
+  EXPECT_EQ("uColor", composer->GetSamplerNames()[0]);
+  EXPECT_EQ("uDetail", composer->GetSamplerNames()[1]);
+
+  // Derivatives are enabled after the #version directive.
+  EXPECT_EQ(0U, source.find("#version 100\n#ifdef GL_ES\n"
+                            "#extension GL_OES_standard_derivatives"));
+  EXPECT_NE(std::string::npos, source.find("#endif\n#line 2\n"));
+  // The functions follow the last sampler.
+  const size_t functions_pos = source.find("#define ION_FEEDBACK_P");
+  EXPECT_LT(source.find("uniform lowp sampler2D uDetail;"), functions_pos);
+  EXPECT_NE(std::string::npos, source.find("}\n#line 4\n"));
+
+  // Only texture2D() calls on uniform samplers are replaced.
+  EXPECT_NE(std::string::npos,
+            source.find("gl_FragColor = ionFeedbackTexture2D(1.0, uColor, "
+                        "vTexCoords) +\n"
+                        "      ionFeedbackTexture2D(2.0, uDetail , "
+                        "vTexCoords, 1.0) + Sample(uColor) +\n"
+                        "      texture2DProj(uColor,"));
+  EXPECT_NE(std::string::npos, source.find("{ return texture2D(s, "));
+  EXPECT_NE(std::string::npos, source.find("void ionFeedbackMain(void) {"));
+  EXPECT_NE(std::string::npos,
+            source.find("  ionFeedbackMain();\n"
+                        "  gl_FragColor = ionFeedback;\n}\n"));
+
+  // Shaders without samplers only have their main() wrapped.
+  composer->SetDependencySource(
+      "f", "void main() { gl_FragColor = vec4(1.); }\n");
+  const std::string plain = composer->GetSource();
+  EXPECT_TRUE(composer->GetSamplerNames().empty());
+  EXPECT_EQ(0U, plain.find("#ifdef GL_ES\n"));
+  EXPECT_LT(plain.find("ionFeedbackRecord"),
+            plain.find("void ionFeedbackMain() {"));
+
+  composer->SetDependencySource("f", "void Main() {}\n");
+  EXPECT_EQ("void Main() {}\n", composer->GetSource());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "has no main()"));
+}
+
+TEST_F(TextureFeedbackTest, Capture) {
+  base::LogChecker log_checker;
+  TextureFeedback feedback((base::AllocatorPtr()));
+  EXPECT_EQ(128U, feedback.GetWidth());
+  feedback.SetSize(32U, 16U);
+  EXPECT_EQ(32U, feedback.GetWidth());
+  EXPECT_EQ(16U, feedback.GetHeight());
+
+  const gfx::ShaderProgramPtr instrumented =
+      feedback.GetFeedbackProgram(program_);
+  EXPECT_EQ(instrumented.Get(), feedback.GetFeedbackProgram(program_).Get());
+  EXPECT_EQ("Textured [texture feedback]", instrumented->GetLabel());
+  EXPECT_NE(std::string::npos,
+            instrumented->GetFragmentShader()->GetSource().find(
+                "ionFeedbackTexture2D(1.0, uColor"));
+  EXPECT_TRUE(instrumented->GetRegistry()->Contains(
+      TextureFeedbackComposer::kNodeIdUniformName));
+
+  gfx::TexturePtr color = BuildTexture(256U);
+  gfx::TexturePtr detail = BuildTexture(64U);
+  gfx::TexturePtr child_color = BuildTexture(1024U);
+  gfx::NodePtr scene = BuildScene(color, detail, child_color);
+
+  // The copy of the scene is drawn into the feedback framebuffer, without
+  // changing the scene or the bound framebuffer.
+  gfx::testing::TraceVerifier verifier(gm_.Get());
+  feedback.Capture(renderer_.Get(), scene);
+  EXPECT_EQ(1U, verifier.GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, verifier.GetCountOf("Viewport(0, 0, 32, 16)"));
+  EXPECT_EQ(0U, verifier.GetCountOf("Enable(GL_BLEND"));
+  EXPECT_FALSE(renderer_->GetCurrentFramebuffer().Get());
+  EXPECT_EQ(program_.Get(), scene->GetShaderProgram().Get());
+  EXPECT_EQ(4U, scene->GetUniforms().size());
+
+  // Nothing is sampled in the mock framebuffer.
+  renderer_->ProcessImageReadbacks(true);
+  EXPECT_EQ(1U, feedback.Update());
+  EXPECT_EQ(0U, feedback.Update());
+  EXPECT_EQ(1U, feedback.GetCaptureCount());
+  EXPECT_TRUE(feedback.GetSampledTextures().empty());
+
+  // The root node has id 1 and the child has id 2. A footprint of 2^-8 in a
+  // 1024 texture requests level 2.
+  feedback.AddFeedbackImage(BuildFeedbackImage(2U, 1U, 8.f, 5U));
+  const TextureFeedback::TextureUsage* usage =
+      feedback.GetUsage(child_color.Get());
+  ASSERT_TRUE(usage);
+  EXPECT_EQ(5U, usage->sample_count);
+  EXPECT_EQ(5U, usage->level_counts[2]);
+  EXPECT_EQ(2U, usage->finest_level);
+  EXPECT_EQ(2U, usage->capture);
+  EXPECT_FALSE(feedback.GetUsage(color.Get()));
+
+  // The child inherits uDetail. Footprints finer than a texel request level 0.
+  feedback.AddFeedbackImage(BuildFeedbackImage(2U, 2U, 8.f, 3U));
+  feedback.AddFeedbackImage(BuildFeedbackImage(1U, 1U, 7.5f, 2U));
+  usage = feedback.GetUsage(detail.Get());
+  ASSERT_TRUE(usage);
+  EXPECT_EQ(3U, usage->sample_count);
+  EXPECT_EQ(3U, usage->level_counts[0]);
+  usage = feedback.GetUsage(color.Get());
+  ASSERT_TRUE(usage);
+  EXPECT_EQ(2U, usage->sample_count);
+  EXPECT_EQ(0U, usage->finest_level);
+  EXPECT_EQ(3U, feedback.GetSampledTextures().size());
+  EXPECT_EQ(4U, feedback.GetCaptureCount());
+
+  // Unknown ids and samplers are ignored.
+  feedback.AddFeedbackImage(BuildFeedbackImage(3U, 1U, 0.f, 16U));
+  feedback.AddFeedbackImage(BuildFeedbackImage(2U, 3U, 0.f, 16U));
+  EXPECT_EQ(3U, feedback.GetSampledTextures().size());
+
+  gfx::ImagePtr wrong_format(new gfx::Image);
+  wrong_format->Set(gfx::Image::kRgb888, 1U, 1U, base::DataContainerPtr());
+  feedback.AddFeedbackImage(wrong_format);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "must be RGBA8888"));
+
+  feedback.Reset();
+  EXPECT_TRUE(feedback.GetSampledTextures().empty());
+  EXPECT_FALSE(feedback.GetUsage(color.Get()));
+  EXPECT_EQ(0U, feedback.GetCaptureCount());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
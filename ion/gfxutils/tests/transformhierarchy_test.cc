@@ -0,0 +1,168 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/transformhierarchy.h"
+
+#include <string>
+
+#include "ion/base/logchecker.h"
+#include "ion/gfx/uniform.h"
+#include "ion/math/matrixutils.h"
+#include "ion/math/transformutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+static const float kTolerance = 1e-5f;
+
+static const math::Matrix4f GetUniformMatrix(const gfx::UniformHolder& holder,
+                                             const std::string& name) {
+  const size_t index = holder.GetUniformIndex(name);
+  EXPECT_NE(base::kInvalidIndex, index);
+  return holder.GetUniforms()[index].GetValue<math::Matrix4f>();
+}
+
+}  // anonymous namespace
+
+TEST(TransformHierarchyTest, LocalTransforms) {
+  gfx::ShaderInputRegistryPtr reg(new gfx::ShaderInputRegistry);
+  TransformHierarchy hierarchy(reg, base::AllocatorPtr());
+  const size_t root = hierarchy.AddTransform(TransformHierarchy::kNoParent,
+                                             gfx::NodePtr(), "");
+  EXPECT_EQ(0U, root);
+  EXPECT_EQ(1U, hierarchy.GetCount());
+  EXPECT_EQ(TransformHierarchy::kNoParent, hierarchy.GetParent(root));
+  EXPECT_EQ(math::Vector3f::Zero(), hierarchy.GetTranslation(root));
+  EXPECT_EQ(math::Rotationf::Identity(), hierarchy.GetRotation(root));
+  EXPECT_EQ(math::Vector3f::Fill(1.f), hierarchy.GetScale(root));
+
+  const math::Vector3f translation(1.f, 2.f, 3.f);
+  const math::Rotationf rotation = math::Rotationf::FromAxisAndAngle(
+      math::Vector3f::AxisY(), math::Anglef::FromDegrees(30.f));
+  const math::Vector3f scale(2.f, 3.f, 4.f);
+  hierarchy.SetTranslation(root, translation);
+  hierarchy.SetRotation(root, rotation);
+  hierarchy.SetScale(root, scale);
+  EXPECT_EQ(translation, hierarchy.GetTranslation(root));
+  EXPECT_EQ(rotation, hierarchy.GetRotation(root));
+  EXPECT_EQ(scale, hierarchy.GetScale(root));
+  // Matrices are only computed by Update().
+  EXPECT_EQ(math::Matrix4f::Identity(), hierarchy.GetLocalMatrix(root));
+  EXPECT_EQ(1U, hierarchy.Update(NULL));
+  const math::Matrix4f expected = math::TranslationMatrix(translation) *
+                                  math::RotationMatrixH(rotation) *
+                                  math::ScaleMatrixH(scale);
+  EXPECT_TRUE(math::MatricesAlmostEqual(expected,
+                                        hierarchy.GetLocalMatrix(root),
+                                        kTolerance));
+  EXPECT_EQ(hierarchy.GetLocalMatrix(root), hierarchy.GetWorldMatrix(root));
+
+  // A local matrix replaces the components until they are set again.
+  const math::Matrix4f m = math::ScaleMatrixH(math::Vector3f::Fill(5.f));
+  hierarchy.SetLocalMatrix(root, m);
+  EXPECT_EQ(1U, hierarchy.Update(NULL));
+  EXPECT_EQ(m, hierarchy.GetWorldMatrix(root));
+  hierarchy.SetScale(root, scale);
+  EXPECT_EQ(1U, hierarchy.Update(NULL));
+  EXPECT_TRUE(math::MatricesAlmostEqual(expected,
+                                        hierarchy.GetWorldMatrix(root),
+                                        kTolerance));
+}
+
+TEST(TransformHierarchyTest, DirtyPropagation) {
+  base::LogChecker log_checker;
+  gfx::ShaderInputRegistryPtr reg(new gfx::ShaderInputRegistry);
+  TransformHierarchy hierarchy(reg, base::AllocatorPtr());
+  gfx::NodePtr nodes[4];
+  for (int i = 0; i < 4; ++i)
+    nodes[i] = new gfx::Node;
+  // A node that already has the Uniform keeps it.
+  nodes[1]->AddUniform(reg->Create<gfx::Uniform>("uOther", 1.f));
+  nodes[1]->AddUniform(
+      reg->Create<gfx::Uniform>("uModelMatrix", math::Matrix4f::Zero()));
+
+  // root -> arm -> hand, root -> head.
+  const size_t root = hierarchy.AddTransform(TransformHierarchy::kNoParent,
+                                             nodes[0], "uModelMatrix");
+  const size_t arm = hierarchy.AddTransform(root, nodes[1], "uModelMatrix");
+  const size_t hand = hierarchy.AddTransform(arm, nodes[2], "uModelMatrix");
+  const size_t head = hierarchy.AddTransform(root, nodes[3], "uModelMatrix");
+  EXPECT_EQ(2U, nodes[1]->GetUniforms().size());
+  EXPECT_EQ(1U, nodes[2]->GetUniforms().size());
+  EXPECT_EQ(arm, hierarchy.GetParent(hand));
+
+  // Everything is computed the first time.
+  EXPECT_EQ(4U, hierarchy.Update(NULL));
+  EXPECT_EQ(math::Matrix4f::Identity(),
+            GetUniformMatrix(*nodes[1], "uModelMatrix"));
+  EXPECT_EQ(0U, hierarchy.Update(NULL));
+
+  // Changing a transform updates it and its descendants only.
+  hierarchy.SetTranslation(arm, math::Vector3f(1.f, 0.f, 0.f));
+  hierarchy.SetTranslation(hand, math::Vector3f(0.f, 2.f, 0.f));
+  EXPECT_EQ(2U, hierarchy.Update(NULL));
+  EXPECT_EQ(math::TranslationMatrix(math::Vector3f(1.f, 2.f, 0.f)),
+            GetUniformMatrix(*nodes[2], "uModelMatrix"));
+  EXPECT_EQ(math::Matrix4f::Identity(),
+            GetUniformMatrix(*nodes[3], "uModelMatrix"));
+
+  // Changing the root updates everything.
+  hierarchy.SetScale(root, math::Vector3f::Fill(2.f));
+  EXPECT_EQ(4U, hierarchy.Update(NULL));
+  EXPECT_EQ(math::ScaleMatrixH(math::Vector3f::Fill(2.f)) *
+                math::TranslationMatrix(math::Vector3f(1.f, 2.f, 0.f)),
+            hierarchy.GetWorldMatrix(hand));
+  EXPECT_EQ(hierarchy.GetWorldMatrix(hand),
+            GetUniformMatrix(*nodes[2], "uModelMatrix"));
+  EXPECT_EQ(hierarchy.GetWorldMatrix(head),
+            GetUniformMatrix(*nodes[3], "uModelMatrix"));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  EXPECT_EQ(base::kInvalidIndex,
+            hierarchy.AddTransform(10U, nodes[0], "uModelMatrix"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid parent 10"));
+  EXPECT_EQ(4U, hierarchy.GetCount());
+}
+
+TEST(TransformHierarchyTest, UniformBlocks) {
+  gfx::ShaderInputRegistryPtr reg(new gfx::ShaderInputRegistry);
+  TransformHierarchy hierarchy(reg, base::AllocatorPtr());
+  gfx::UniformBlockPtr block(new gfx::UniformBlock);
+  const size_t root = hierarchy.AddTransform(
+      TransformHierarchy::kNoParent, gfx::UniformBlockPtr(), "");
+  const size_t child = hierarchy.AddTransform(root, block, "uModelMatrix");
+  hierarchy.SetTranslation(root, math::Vector3f(0.f, 0.f, 1.f));
+  hierarchy.SetRotation(child, math::Rotationf::FromAxisAndAngle(
+                                   math::Vector3f::AxisZ(),
+                                   math::Anglef::FromDegrees(90.f)));
+  EXPECT_EQ(2U, hierarchy.Update(NULL));
+  ASSERT_EQ(1U, block->GetUniforms().size());
+  EXPECT_EQ(hierarchy.GetWorldMatrix(child),
+            GetUniformMatrix(*block, "uModelMatrix"));
+  EXPECT_TRUE(math::MatricesAlmostEqual(
+      math::Matrix4f(0.f, -1.f, 0.f, 0.f,
+                     1.f, 0.f, 0.f, 0.f,
+                     0.f, 0.f, 1.f, 1.f,
+                     0.f, 0.f, 0.f, 1.f),
+      hierarchy.GetWorldMatrix(child), kTolerance));
+}
+
+}  // namespace gfxutils
+}  // namespace ion
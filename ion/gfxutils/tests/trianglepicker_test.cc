@@ -0,0 +1,191 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/trianglepicker.h"
+
+#include <cmath>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/invalid.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfxutils/buffertoattributebinder.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/intersectionutils.h"
+#include "ion/math/vectorutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+using math::Point3f;
+using math::Vector3f;
+
+namespace {
+
+// Returns a Shape without an IndexBuffer holding |count| positions.
+static const gfx::ShapePtr BuildUnindexedShape(const Point3f* positions,
+                                               size_t count) {
+  gfx::BufferObjectPtr buffer_object(new gfx::BufferObject);
+  buffer_object->SetData(
+      base::DataContainer::CreateAndCopy<Point3f>(
+          positions, count, false, buffer_object->GetAllocator()),
+      sizeof(positions[0]), count, gfx::BufferObject::kStaticDraw);
+  gfx::AttributeArrayPtr attribute_array(new gfx::AttributeArray);
+  Point3f v;
+  BufferToAttributeBinder<Point3f>(v)
+      .Bind(v, "aVertex")
+      .Apply(gfx::ShaderInputRegistry::GetGlobalRegistry(), attribute_array,
+             buffer_object);
+  gfx::ShapePtr shape(new gfx::Shape);
+  shape->SetPrimitiveType(gfx::Shape::kTriangles);
+  shape->SetAttributeArray(attribute_array);
+  return shape;
+}
+
+}  // anonymous namespace
+
+TEST(TrianglePickerTest, PickBox) {
+  BoxSpec spec;
+  spec.size.Set(2.f, 2.f, 2.f);
+  TrianglePicker picker;
+  ASSERT_TRUE(picker.SetShape(BuildBoxShape(spec), nullptr));
+  EXPECT_EQ(12U, picker.GetTriangleCount());
+
+  TrianglePicker::Hit hit;
+  EXPECT_TRUE(picker.Pick(Point3f(0.25f, 0.5f, 5.f), Vector3f(0.f, 0.f, -1.f),
+                          100.f, &hit));
+  EXPECT_FLOAT_EQ(4.f, hit.distance);
+  EXPECT_TRUE(math::PointsAlmostEqual(Point3f(0.25f, 0.5f, 1.f), hit.point,
+                                      1e-5f));
+  Point3f p0, p1, p2;
+  picker.GetTriangle(hit.triangle, &p0, &p1, &p2);
+  EXPECT_FLOAT_EQ(1.f, p0[2]);
+  EXPECT_FLOAT_EQ(1.f, p1[2]);
+  EXPECT_FLOAT_EQ(1.f, p2[2]);
+
+  // From inside, the back face is hit.
+  EXPECT_TRUE(picker.Pick(Point3f::Zero(), Vector3f(0.f, -2.f, 0.f), 100.f,
+                          &hit));
+  EXPECT_FLOAT_EQ(0.5f, hit.distance);
+  EXPECT_TRUE(math::PointsAlmostEqual(Point3f(0.f, -1.f, 0.f), hit.point,
+                                      1e-5f));
+
+  // Misses.
+  EXPECT_FALSE(picker.Pick(Point3f(0.f, 0.f, 5.f), Vector3f(0.f, 0.f, -1.f),
+                           3.f, &hit));
+  EXPECT_FALSE(picker.Pick(Point3f(2.f, 0.f, 5.f), Vector3f(0.f, 0.f, -1.f),
+                           100.f, &hit));
+  EXPECT_FALSE(picker.Pick(Point3f(0.f, 0.f, 5.f), Vector3f(0.f, 0.f, 1.f),
+                           100.f, nullptr));
+}
+
+TEST(TrianglePickerTest, PickEllipsoid) {
+  EllipsoidSpec spec;
+  spec.band_count = 30;
+  spec.sector_count = 40;
+  const gfx::ShapePtr shape = BuildEllipsoidShape(spec);
+  TrianglePicker picker;
+  ASSERT_TRUE(picker.SetShape(shape, nullptr));
+
+  // Every pick must find the same triangle as testing all of them.
+  for (int i = 0; i < 50; ++i) {
+    const float f = static_cast<float>(i);
+    const Point3f origin(2.f * std::sin(f), 1.5f * std::cos(0.7f * f),
+                         3.f + std::sin(1.3f * f));
+    const Vector3f direction = Point3f(0.1f * std::cos(f), 0.f, 0.f) - origin;
+    float expected_distance = 10.f;
+    size_t expected = base::kInvalidIndex;
+    for (size_t t = 0; t < picker.GetTriangleCount(); ++t) {
+      Point3f p0, p1, p2;
+      picker.GetTriangle(t, &p0, &p1, &p2);
+      if (math::IntersectRayAndTriangle(origin, direction, p0, p1, p2,
+                                        expected_distance, &expected_distance,
+                                        static_cast<float*>(nullptr),
+                                        static_cast<float*>(nullptr)))
+        expected = t;
+    }
+    ASSERT_NE(base::kInvalidIndex, expected);
+    TrianglePicker::Hit hit;
+    ASSERT_TRUE(picker.Pick(origin, direction, 10.f, &hit));
+    EXPECT_EQ(expected, hit.triangle);
+    EXPECT_FLOAT_EQ(expected_distance, hit.distance);
+  }
+}
+
+TEST(TrianglePickerTest, UnindexedAndRefit) {
+  Point3f positions[7] = {
+      Point3f(0.f, 0.f, 0.f), Point3f(1.f, 0.f, 0.f), Point3f(0.f, 1.f, 0.f),
+      Point3f(0.f, 0.f, -2.f), Point3f(1.f, 0.f, -2.f),
+      Point3f(0.f, 1.f, -2.f), Point3f(5.f, 5.f, 5.f)};
+  const gfx::ShapePtr shape = BuildUnindexedShape(positions, 7U);
+  TrianglePicker picker;
+  ASSERT_TRUE(picker.SetShape(shape, nullptr));
+  // The extra vertex is ignored.
+  EXPECT_EQ(2U, picker.GetTriangleCount());
+
+  TrianglePicker::Hit hit;
+  const Point3f origin(0.25f, 0.25f, 1.f);
+  const Vector3f direction(0.f, 0.f, -1.f);
+  ASSERT_TRUE(picker.Pick(origin, direction, 10.f, &hit));
+  EXPECT_EQ(0U, hit.triangle);
+  EXPECT_FLOAT_EQ(1.f, hit.distance);
+  EXPECT_FLOAT_EQ(0.25f, hit.u);
+  EXPECT_FLOAT_EQ(0.25f, hit.v);
+
+  // Move the first triangle out of the way and refit.
+  for (int i = 0; i < 3; ++i)
+    positions[i][0] += 10.f;
+  shape->GetAttributeArray()
+      ->GetBufferAttribute(0)
+      .GetValue<gfx::BufferObjectElement>()
+      .buffer_object->SetData(
+          base::DataContainer::CreateAndCopy<Point3f>(
+              positions, 7U, false, base::AllocatorPtr()),
+          sizeof(positions[0]), 7U, gfx::BufferObject::kStaticDraw);
+  ASSERT_TRUE(picker.Refit());
+  ASSERT_TRUE(picker.Pick(origin, direction, 10.f, &hit));
+  EXPECT_EQ(1U, hit.triangle);
+  EXPECT_FLOAT_EQ(3.f, hit.distance);
+}
+
+TEST(TrianglePickerTest, Errors) {
+  base::LogChecker log_checker;
+  TrianglePicker picker;
+  EXPECT_FALSE(picker.SetShape(gfx::ShapePtr(), nullptr));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only triangle Shapes"));
+  EXPECT_FALSE(picker.Refit());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "needs a Shape"));
+
+  BoxSpec spec;
+  gfx::ShapePtr shape = BuildBoxShape(spec);
+  shape->SetPrimitiveType(gfx::Shape::kLines);
+  EXPECT_FALSE(picker.SetShape(shape, nullptr));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "only triangle Shapes"));
+
+  shape = BuildBoxShape(spec);
+  shape->SetAttributeArray(gfx::AttributeArrayPtr(new gfx::AttributeArray));
+  EXPECT_FALSE(picker.SetShape(shape, nullptr));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "\"aVertex\" attribute"));
+  EXPECT_EQ(0U, picker.GetTriangleCount());
+  EXPECT_TRUE(picker.GetHierarchy().GetNodes().empty());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,347 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/virtualtexture.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "ion/gfx/texture.h"
+#include "ion/port/timer.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns a size x size RGBA8888 image.
+static const gfx::ImagePtr BuildImage(uint32 size) {
+  gfx::ImagePtr image(new gfx::Image);
+  std::vector<uint8> pixels(size * size * 4U, 0U);
+  image->Set(gfx::Image::kRgba8888, size, size,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &pixels[0], pixels.size(), true, base::AllocatorPtr()));
+  return image;
+}
+
+// Returns a 2x1 feedback image whose first pixel requests the tile at x, y
+// in level, and whose second pixel has no feedback.
+static const gfx::ImagePtr BuildFeedbackImage(uint32 level, uint32 x,
+                                              uint32 y) {
+  gfx::ImagePtr image = BuildImage(2U);
+  uint8* pixels = image->GetData()->GetMutableData<uint8>();
+  pixels[0] = static_cast<uint8>(x & 0xff);
+  pixels[1] = static_cast<uint8>(y & 0xff);
+  pixels[2] = static_cast<uint8>(level | ((x >> 8) << 4) | ((y >> 8) << 6));
+  pixels[3] = 255U;
+  return image;
+}
+
+// Returns the page table texel of the level 0 tile at x, y.
+static const uint8* GetPageTableTexel(const VirtualTexture& vt, uint32 x,
+                                      uint32 y) {
+  const gfx::ImagePtr& image = vt.GetPageTable()->GetImage(0U);
+  return &image->GetData()->GetData<uint8>()[(y * vt.GetTilesX() + x) * 4U];
+}
+
+// Loads tiles of a given size, recording which tiles were loaded. Tiles in
+// the level passed to FailLevel() fail to load.
+class Loader {
+ public:
+  explicit Loader(uint32 tile_size)
+      : tile_size_(tile_size), failed_level_(~0U), count_(0) {}
+
+  const VirtualTexture::TileLoader GetFunction() {
+    return [this](uint32 level, uint32 x, uint32 y) {
+      ++count_;
+      if (level == failed_level_)
+        return gfx::ImagePtr();
+      tiles_.push_back(std::to_string(level) + ":" + std::to_string(x) + "," +
+                       std::to_string(y));
+      return BuildImage(tile_size_);
+    };
+  }
+  void FailLevel(uint32 level) { failed_level_ = level; }
+  // Only safe to use with synchronous loading.
+  const std::vector<std::string>& GetTiles() const { return tiles_; }
+  int GetCount() const { return count_; }
+
+ private:
+  const uint32 tile_size_;
+  uint32 failed_level_;
+  std::vector<std::string> tiles_;
+  std::atomic<int> count_;
+};
+
+}  // anonymous namespace
+
+TEST(VirtualTextureTest, Layout) {
+  base::LogChecker log_checker;
+  Loader loader(4U);
+  VirtualTexture vt(4U, 8U, 2U, 4U, 2U, gfx::Image::kRgba8888,
+                    loader.GetFunction(), base::AllocatorPtr());
+  EXPECT_EQ(4U, vt.GetTileSize());
+  EXPECT_EQ(8U, vt.GetTilesX());
+  EXPECT_EQ(2U, vt.GetTilesY());
+  EXPECT_EQ(4U, vt.GetLevelCount());
+  EXPECT_EQ(1U, vt.GetLoaderThreadCount());
+  EXPECT_EQ(8U, vt.GetMaxUploadsPerFrame());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  const gfx::ImagePtr& page_image = vt.GetPageTable()->GetImage(0U);
+  ASSERT_TRUE(page_image.Get());
+  EXPECT_EQ(8U, page_image->GetWidth());
+  EXPECT_EQ(2U, page_image->GetHeight());
+  EXPECT_EQ(0U, GetPageTableTexel(vt, 0U, 0U)[3]);
+  const gfx::ImagePtr& cache_image = vt.GetCache()->GetImmutableImage();
+  ASSERT_TRUE(cache_image.Get());
+  EXPECT_EQ(16U, cache_image->GetWidth());
+  EXPECT_EQ(8U, cache_image->GetHeight());
+
+  EXPECT_NE(std::string::npos,
+            VirtualTexture::GetShaderSource().find(
+                "vec4 ionVirtualTexture2D(vec2 uv)"));
+  EXPECT_EQ(std::string::npos,
+            VirtualTexture::GetShaderSource().find("dFdx"));
+  EXPECT_NE(std::string::npos,
+            VirtualTexture::GetFeedbackShaderSource().find(
+                "vec4 ionVirtualTextureFeedback(vec2 uv)"));
+
+  const gfx::ShaderInputRegistryPtr& reg = vt.GetRegistry();
+  EXPECT_TRUE(reg->Contains(VirtualTexture::kPageTableUniformName));
+  EXPECT_TRUE(reg->Contains(VirtualTexture::kCacheUniformName));
+  EXPECT_TRUE(reg->Contains(VirtualTexture::kLayoutUniformName));
+  EXPECT_TRUE(reg->Contains(VirtualTexture::kTileSizeUniformName));
+  gfx::NodePtr node(new gfx::Node);
+  vt.AddUniformsToNode(node);
+  EXPECT_EQ(4U, node->GetUniforms().size());
+
+  // Tile counts are rounded up to powers of two, and cache sizes clamped.
+  VirtualTexture rounded(4U, 3U, 0U, 300U, 1U, gfx::Image::kRgba8888,
+                         loader.GetFunction(), base::AllocatorPtr());
+  const std::vector<std::string> messages = log_checker.GetAllMessages();
+  ASSERT_EQ(3U, messages.size());
+  EXPECT_NE(std::string::npos, messages[0].find("tiles_x of 3 is invalid"));
+  EXPECT_NE(std::string::npos, messages[1].find("tiles_y of 0 is invalid"));
+  EXPECT_NE(std::string::npos, messages[2].find("cache_columns of 300"));
+  EXPECT_EQ(4U, rounded.GetTilesX());
+  EXPECT_EQ(1U, rounded.GetTilesY());
+  EXPECT_EQ(3U, rounded.GetLevelCount());
+  EXPECT_EQ(VirtualTexture::kMaxCacheTiles * 4U,
+            rounded.GetCache()->GetImmutableImage()->GetWidth());
+}
+
+TEST(VirtualTextureTest, RequestsAndPageTable) {
+  base::LogChecker log_checker;
+  Loader loader(4U);
+  VirtualTexture vt(4U, 4U, 4U, 4U, 2U, gfx::Image::kRgba8888,
+                    loader.GetFunction(), base::AllocatorPtr());
+  vt.SetLoaderThreadCount(0U);
+
+  // The coarsest tile is requested up front and covers everything.
+  EXPECT_EQ(1U, vt.GetPendingTileCount());
+  EXPECT_EQ(1U, vt.Update());
+  ASSERT_EQ(1U, loader.GetTiles().size());
+  EXPECT_EQ("2:0,0", loader.GetTiles()[0]);
+  EXPECT_TRUE(vt.IsTileResident(2U, 0U, 0U));
+  EXPECT_EQ(1U, vt.GetResidentTileCount());
+  EXPECT_EQ(0U, vt.GetPendingTileCount());
+  for (uint32 y = 0; y < 4U; ++y) {
+    for (uint32 x = 0; x < 4U; ++x) {
+      const uint8* texel = GetPageTableTexel(vt, x, y);
+      EXPECT_EQ(0U, texel[0]);
+      EXPECT_EQ(0U, texel[1]);
+      EXPECT_EQ(2U, texel[2]);
+      EXPECT_EQ(255U, texel[3]);
+    }
+  }
+
+  // Feedback requests the tile and the coarser tiles covering it, which are
+  // loaded first.
+  vt.AddFeedbackImage(BuildFeedbackImage(0U, 3U, 2U));
+  EXPECT_EQ(2U, vt.GetPendingTileCount());
+  vt.SetMaxUploadsPerFrame(1U);
+  EXPECT_EQ(1U, vt.Update());
+  EXPECT_EQ("1:1,1", loader.GetTiles()[1]);
+  EXPECT_EQ(1U, vt.GetPendingTileCount());
+  EXPECT_EQ(1U, vt.Update());
+  EXPECT_EQ("0:3,2", loader.GetTiles()[2]);
+  EXPECT_EQ(0U, vt.Update());
+  EXPECT_EQ(3U, vt.GetResidentTileCount());
+
+  // Each level 0 tile maps to the finest resident tile covering it.
+  const uint8* texel = GetPageTableTexel(vt, 3U, 2U);
+  EXPECT_EQ(2U, texel[0]);
+  EXPECT_EQ(0U, texel[1]);
+  EXPECT_EQ(0U, texel[2]);
+  texel = GetPageTableTexel(vt, 2U, 3U);
+  EXPECT_EQ(1U, texel[0]);
+  EXPECT_EQ(0U, texel[1]);
+  EXPECT_EQ(1U, texel[2]);
+  texel = GetPageTableTexel(vt, 0U, 0U);
+  EXPECT_EQ(0U, texel[0]);
+  EXPECT_EQ(2U, texel[2]);
+
+  // Invalid requests are ignored.
+  vt.RequestTile(1U, 2U, 0U);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "does not exist"));
+  vt.AddFeedbackImage(BuildFeedbackImage(5U, 0U, 0U));
+  vt.AddFeedbackImage(BuildImage(1U));
+  EXPECT_EQ(0U, vt.GetPendingTileCount());
+  EXPECT_FALSE(vt.IsTileResident(0U, 2000U, 0U));
+
+  // Tiles that fail to load are not requested again.
+  loader.FailLevel(0U);
+  vt.RequestTile(0U, 0U, 0U);
+  EXPECT_EQ(0U, vt.Update());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "failed to load tile (0, 0"));
+  const int count = loader.GetCount();
+  vt.RequestTile(0U, 0U, 0U);
+  vt.Update();
+  EXPECT_EQ(count, loader.GetCount());
+  EXPECT_FALSE(vt.IsTileResident(0U, 0U, 0U));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(VirtualTextureTest, Eviction) {
+  base::LogChecker log_checker;
+  Loader loader(4U);
+  VirtualTexture vt(4U, 4U, 4U, 3U, 1U, gfx::Image::kRgba8888,
+                    loader.GetFunction(), base::AllocatorPtr());
+  vt.SetLoaderThreadCount(0U);
+  vt.Update();
+  vt.RequestTile(0U, 0U, 0U);
+  vt.RequestTile(0U, 1U, 0U);
+  EXPECT_EQ(2U, vt.Update());
+  EXPECT_EQ(3U, vt.GetResidentTileCount());
+
+  // The cache is full, so a new tile replaces the least recently requested
+  // one, but never the coarsest tile.
+  vt.RequestTile(0U, 1U, 0U);
+  vt.Update();
+  vt.RequestTile(0U, 2U, 0U);
+  EXPECT_EQ(1U, vt.Update());
+  EXPECT_TRUE(vt.IsTileResident(2U, 0U, 0U));
+  EXPECT_FALSE(vt.IsTileResident(0U, 0U, 0U));
+  EXPECT_TRUE(vt.IsTileResident(0U, 1U, 0U));
+  EXPECT_TRUE(vt.IsTileResident(0U, 2U, 0U));
+  EXPECT_EQ(3U, vt.GetResidentTileCount());
+  EXPECT_EQ(0U, GetPageTableTexel(vt, 0U, 0U)[0]);
+  EXPECT_EQ(2U, GetPageTableTexel(vt, 0U, 0U)[2]);
+  EXPECT_EQ(1U, GetPageTableTexel(vt, 2U, 0U)[0]);
+  EXPECT_EQ(0U, GetPageTableTexel(vt, 2U, 0U)[2]);
+
+  // Tiles needed by the same frame are not evicted for each other.
+  vt.RequestTile(0U, 1U, 0U);
+  vt.RequestTile(0U, 2U, 0U);
+  vt.RequestTile(0U, 3U, 0U);
+  EXPECT_EQ(0U, vt.Update());
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "cache is too small"));
+  EXPECT_FALSE(vt.IsTileResident(0U, 3U, 0U));
+  EXPECT_EQ(0U, vt.GetPendingTileCount());
+
+  // Requests that are not repeated are dropped before they are loaded.
+  vt.SetMaxUploadsPerFrame(0U);
+  vt.RequestTile(0U, 3U, 3U);
+  EXPECT_EQ(1U, vt.GetPendingTileCount());
+  for (int i = 0; i < 10; ++i)
+    vt.Update();
+  EXPECT_EQ(0U, vt.GetPendingTileCount());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(VirtualTextureTest, WrongTileSize) {
+  base::LogChecker log_checker;
+  Loader loader(8U);
+  VirtualTexture vt(4U, 2U, 2U, 2U, 2U, gfx::Image::kRgba8888,
+                    loader.GetFunction(), base::AllocatorPtr());
+  vt.SetLoaderThreadCount(0U);
+  EXPECT_EQ(0U, vt.Update());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "wrong size or format"));
+  EXPECT_EQ(0U, vt.GetResidentTileCount());
+}
+
+TEST(VirtualTextureTest, LoaderThreads) {
+  Loader loader(4U);
+  VirtualTexture vt(4U, 4U, 4U, 5U, 4U, gfx::Image::kRgba8888,
+                    loader.GetFunction(), base::AllocatorPtr());
+  vt.SetLoaderThreadCount(2U);
+  EXPECT_EQ(2U, vt.GetLoaderThreadCount());
+  for (int i = 0; i < 1000 && vt.GetResidentTileCount() < 17U; ++i) {
+    for (uint32 y = 0; y < 4U; ++y) {
+      for (uint32 x = 0; x < 4U; ++x)
+        vt.RequestTile(0U, x, y);
+    }
+    vt.Update();
+    port::Timer::SleepNMilliseconds(1);
+  }
+  EXPECT_EQ(17U, vt.GetResidentTileCount());
+  EXPECT_EQ(17, loader.GetCount());
+}
+
+TEST(VirtualTextureTest, Draw) {
+  base::LogChecker log_checker;
+  std::unique_ptr<gfx::testing::MockVisual> visual(
+      new gfx::testing::MockVisual(64, 64));
+  gfx::testing::MockGraphicsManagerPtr gm(
+      new gfx::testing::MockGraphicsManager());
+  gfx::RendererPtr renderer(new gfx::Renderer(gm));
+
+  Loader loader(4U);
+  VirtualTexture vt(4U, 4U, 4U, 4U, 2U, gfx::Image::kRgba8888,
+                    loader.GetFunction(), base::AllocatorPtr());
+  vt.SetLoaderThreadCount(0U);
+  vt.RequestTile(0U, 1U, 1U);
+  EXPECT_EQ(2U, vt.Update());
+
+  // Loaded tiles are copied into the cache when it is next drawn.
+  gfx::testing::TraceVerifier verifier(gm.Get());
+  renderer->CreateOrUpdateResource(vt.GetCache().Get());
+  EXPECT_EQ(1U, verifier.GetCountOf("TexStorage2D"));
+  EXPECT_EQ(2U, verifier.GetCountOf("TexSubImage2D"));
+  EXPECT_EQ(1U, verifier.GetCountOf("TexSubImage2D(GL_TEXTURE_2D, 0, 4, 0"));
+  EXPECT_TRUE(vt.GetCache()->GetSubImages().empty());
+
+  // The feedback pass is drawn into its own framebuffer and read back.
+  vt.SetFeedbackSize(16U, 8U);
+  gfx::NodePtr node(new gfx::Node);
+  vt.AddUniformsToNode(node);
+  verifier.Reset();
+  vt.CaptureFeedback(renderer.Get(), node);
+  EXPECT_EQ(1U, verifier.GetCountOf("ReadPixels(0, 0, 16, 8"));
+  EXPECT_EQ(1U, verifier.GetCountOf("ReadPixels"));
+  EXPECT_FALSE(renderer->GetCurrentFramebuffer().Get());
+  renderer->ProcessImageReadbacks(true);
+  EXPECT_EQ(0U, vt.Update());
+  EXPECT_EQ(0U, vt.GetPendingTileCount());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+}  // namespace gfxutils
+}  // namespace ion
@@ -0,0 +1,151 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/texturearraypacker.h"
+
+#include <string.h>  // For memcpy().
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/sampler.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+// Returns whether two images can share an array Texture.
+static bool AreImagesCompatible(const gfx::Image& a, const gfx::Image& b) {
+  return a.GetFormat() == b.GetFormat() && a.GetWidth() == b.GetWidth() &&
+         a.GetHeight() == b.GetHeight();
+}
+
+}  // anonymous namespace
+
+const size_t TextureArrayPacker::kInvalidIndex = static_cast<size_t>(-1);
+
+TextureArrayPacker::TextureArrayPacker(const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      max_layers_(256U),
+      entries_(allocator_),
+      textures_(allocator_) {}
+
+TextureArrayPacker::~TextureArrayPacker() {}
+
+void TextureArrayPacker::SetMaxLayers(uint32 max_layers) {
+  if (max_layers)
+    max_layers_ = max_layers;
+  else
+    LOG(ERROR) << "TextureArrayPacker: the maximum number of layers must be"
+               << " at least 1";
+}
+
+size_t TextureArrayPacker::AddImage(const gfx::ImagePtr& image) {
+  if (!image.Get()) {
+    LOG(ERROR) << "TextureArrayPacker: cannot pack a NULL image";
+    return kInvalidIndex;
+  }
+  if (image->GetType() != gfx::Image::kDense ||
+      image->GetDimensions() != gfx::Image::k2d) {
+    LOG(ERROR) << "TextureArrayPacker: only dense 2D images can be packed";
+    return kInvalidIndex;
+  }
+  if (!image->GetData().Get() || !image->GetData()->GetData()) {
+    LOG(ERROR) << "TextureArrayPacker: cannot pack an image without data";
+    return kInvalidIndex;
+  }
+
+  Entry entry;
+  entry.image = image;
+  entry.texture_index = kInvalidIndex;
+  entry.layer = 0U;
+  entries_.push_back(entry);
+  return entries_.size() - 1U;
+}
+
+void TextureArrayPacker::Pack() {
+  textures_.clear();
+  const size_t num_entries = entries_.size();
+  for (size_t i = 0; i < num_entries; ++i)
+    entries_[i].texture_index = kInvalidIndex;
+
+  // Gather the unpacked images compatible with each unpacked image in turn, in
+  // the order they were added, until the array is full.
+  base::AllocVector<size_t> entry_indices(allocator_);
+  for (size_t i = 0; i < num_entries; ++i) {
+    if (entries_[i].texture_index != kInvalidIndex)
+      continue;
+    entry_indices.clear();
+    const gfx::Image& first = *entries_[i].image;
+    for (size_t j = i; j < num_entries && entry_indices.size() < max_layers_;
+         ++j) {
+      if (entries_[j].texture_index == kInvalidIndex &&
+          AreImagesCompatible(first, *entries_[j].image))
+        entry_indices.push_back(j);
+    }
+    PackTexture(entry_indices);
+  }
+}
+
+void TextureArrayPacker::PackTexture(
+    const base::AllocVector<size_t>& entry_indices) {
+  DCHECK(!entry_indices.empty());
+  const gfx::Image& first = *entries_[entry_indices[0]].image;
+  const gfx::Image::Format format = first.GetFormat();
+  const uint32 width = first.GetWidth();
+  const uint32 height = first.GetHeight();
+  const size_t layer_size =
+      gfx::Image::ComputeDataSize(format, width, height);
+  const uint32 num_layers = static_cast<uint32>(entry_indices.size());
+
+  base::DataContainerPtr data = base::DataContainer::CreateOverAllocated<uint8>(
+      layer_size * num_layers, NULL, allocator_);
+  uint8* layers = data->GetMutableData<uint8>();
+  const size_t texture_index = textures_.size();
+  for (uint32 i = 0; i < num_layers; ++i) {
+    Entry& entry = entries_[entry_indices[i]];
+    memcpy(layers + layer_size * i, entry.image->GetData()->GetData(),
+           layer_size);
+    entry.texture_index = texture_index;
+    entry.layer = i;
+  }
+
+  gfx::ImagePtr image(new (allocator_) gfx::Image);
+  image->SetArray(format, width, height, num_layers, data);
+  gfx::TexturePtr texture(new (allocator_) gfx::Texture);
+  texture->SetImage(0U, image);
+  texture->SetSampler(gfx::SamplerPtr(new (allocator_) gfx::Sampler));
+  textures_.push_back(texture);
+}
+
+gfx::TexturePtr TextureArrayPacker::GetTexture(size_t index) const {
+  if (index >= entries_.size() ||
+      entries_[index].texture_index == kInvalidIndex)
+    return gfx::TexturePtr();
+  return textures_[entries_[index].texture_index];
+}
+
+uint32 TextureArrayPacker::GetLayer(size_t index) const {
+  if (index >= entries_.size() ||
+      entries_[index].texture_index == kInvalidIndex)
+    return 0U;
+  return entries_[index].layer;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
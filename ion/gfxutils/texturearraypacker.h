@@ -0,0 +1,113 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_TEXTUREARRAYPACKER_H_
+#define ION_GFXUTILS_TEXTUREARRAYPACKER_H_
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/texture.h"
+
+namespace ion {
+namespace gfxutils {
+
+// TextureArrayPacker packs dense 2D images that share a format and size into
+// the layers of 2D array Textures. A batch of Shapes that would otherwise each
+// bind their own Texture can then share a single sampler2DArray Uniform, set
+// once on a common ancestor Node, and select their image with a per-Shape
+// layer Uniform instead. Since the Renderer only rebinds image units when a
+// texture Uniform changes, drawing the batch requires no unit rebinding.
+//
+// Typical usage:
+//   TextureArrayPacker packer(allocator);
+//   const size_t index = packer.AddImage(image);
+//   ...
+//   packer.Pack();
+//   parent->AddUniform(reg->Create<Uniform>("uSampler",
+//                                           packer.GetTexture(index)));
+//   child->AddUniform(reg->Create<Uniform>(
+//       "uLayer", static_cast<float>(packer.GetLayer(index))));
+//
+// Images whose formats or sizes differ are packed into separate arrays. The
+// shaders using the packed Textures must declare them as sampler2DArray, which
+// requires GLSL ES 3.00 or desktop GLSL 1.30.
+class ION_API TextureArrayPacker {
+ public:
+  // Returned by AddImage() when the image cannot be packed.
+  static const size_t kInvalidIndex;
+
+  // The passed allocator is used for all allocations; if it is NULL, the
+  // default allocator is used.
+  explicit TextureArrayPacker(const base::AllocatorPtr& allocator);
+  ~TextureArrayPacker();
+
+  // Sets/returns the maximum number of layers in each packed Texture. This
+  // should not exceed the value of GL_MAX_ARRAY_TEXTURE_LAYERS, which is at
+  // least 256 in OpenGL ES 3.0. The default is 256.
+  void SetMaxLayers(uint32 max_layers);
+  uint32 GetMaxLayers() const { return max_layers_; }
+
+  // Adds an image to be packed by the next call to Pack(), returning its
+  // index. Only dense 2D images with data may be packed; if the image is NULL,
+  // has a different type or dimensionality, or its data has been wiped, this
+  // logs an error and returns kInvalidIndex.
+  size_t AddImage(const gfx::ImagePtr& image);
+  // Returns the number of images that have been added.
+  size_t GetImageCount() const { return entries_.size(); }
+
+  // Packs all added images into array Textures, replacing those created by
+  // any previous call. Each Texture has its own Sampler with default settings.
+  void Pack();
+
+  // Returns the array Textures created by the last call to Pack().
+  const base::AllocVector<gfx::TexturePtr>& GetTextures() const {
+    return textures_;
+  }
+  // Returns the array Texture holding the image at the passed index, or a NULL
+  // pointer if the index is invalid or the image has not been packed yet.
+  gfx::TexturePtr GetTexture(size_t index) const;
+  // Returns the layer of the image at the passed index within its Texture, or
+  // 0 if the index is invalid or the image has not been packed yet.
+  uint32 GetLayer(size_t index) const;
+
+ private:
+  struct Entry {
+    gfx::ImagePtr image;
+    // The Texture and layer the image was packed into, or kInvalidIndex.
+    size_t texture_index;
+    uint32 layer;
+  };
+
+  // Creates a Texture from the entries_ at the passed indices, which must all
+  // share a format and size.
+  void PackTexture(const base::AllocVector<size_t>& entry_indices);
+
+  base::AllocatorPtr allocator_;
+  uint32 max_layers_;
+  base::AllocVector<Entry> entries_;
+  base::AllocVector<gfx::TexturePtr> textures_;
+
+  DISALLOW_COPY_AND_ASSIGN(TextureArrayPacker);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_TEXTUREARRAYPACKER_H_
@@ -0,0 +1,580 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/texturefeedback.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/uniform.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using gfx::Node;
+using gfx::NodePtr;
+using gfx::ShaderInputRegistry;
+using gfx::ShaderInputRegistryPtr;
+using gfx::ShaderProgram;
+using gfx::ShaderProgramPtr;
+using gfx::StateTable;
+using gfx::StateTablePtr;
+using gfx::TexturePtr;
+using gfx::Uniform;
+
+// The largest node id that fits in the red and green channels.
+static const size_t kMaxNodeId = 0xffff;
+
+// Declarations and functions inserted after the sampler2D declarations. The
+// precision macro keeps the source valid whatever the default precision is.
+static const char kFeedbackFunctions[] =
+    "#if defined(GL_ES) && defined(GL_FRAGMENT_PRECISION_HIGH)\n"
+    "#define ION_FEEDBACK_P highp\n"
+    "#elif defined(GL_ES)\n"
+    "#define ION_FEEDBACK_P mediump\n"
+    "#else\n"
+    "#define ION_FEEDBACK_P\n"
+    "#endif\n"
+    "uniform ION_FEEDBACK_P vec2 uIonFeedbackNodeId;\n"
+    "ION_FEEDBACK_P vec4 ionFeedback;\n"
+    "void ionFeedbackRecord(ION_FEEDBACK_P float ion_index,\n"
+    "                       ION_FEEDBACK_P vec2 ion_uv) {\n"
+    "  ION_FEEDBACK_P vec2 ion_dx = abs(dFdx(ion_uv));\n"
+    "  ION_FEEDBACK_P vec2 ion_dy = abs(dFdy(ion_uv));\n"
+    "  ION_FEEDBACK_P float ion_footprint =\n"
+    "      max(max(ion_dx.x, ion_dx.y), max(ion_dy.x, ion_dy.y));\n"
+    "  ION_FEEDBACK_P float ion_level =\n"
+    "      clamp(-log2(max(ion_footprint, 1.0 / 65536.0)), 0.0, 15.9375);\n"
+    "  ionFeedback = vec4(uIonFeedbackNodeId, ion_index / 255.0,\n"
+    "                     ion_level * 16.0 / 255.0);\n"
+    "}\n"
+    "ION_FEEDBACK_P vec4 ionFeedbackTexture2D(\n"
+    "    ION_FEEDBACK_P float ion_index, sampler2D ion_sampler,\n"
+    "    ION_FEEDBACK_P vec2 ion_uv) {\n"
+    "  ionFeedbackRecord(ion_index, ion_uv);\n"
+    "  return texture2D(ion_sampler, ion_uv);\n"
+    "}\n"
+    "ION_FEEDBACK_P vec4 ionFeedbackTexture2D(\n"
+    "    ION_FEEDBACK_P float ion_index, sampler2D ion_sampler,\n"
+    "    ION_FEEDBACK_P vec2 ion_uv, ION_FEEDBACK_P float ion_bias) {\n"
+    "  ionFeedbackRecord(ion_index, ion_uv);\n"
+    "  return texture2D(ion_sampler, ion_uv, ion_bias);\n"
+    "}\n";
+
+// The main() function appended to instrumented shaders.
+static const char kFeedbackMain[] =
+    "\n"
+    "void main() {\n"
+    "  ionFeedback = vec4(uIonFeedbackNodeId, 0.0, 0.0);\n"
+    "  ionFeedbackMain();\n"
+    "  gl_FragColor = ionFeedback;\n"
+    "}\n";
+
+static bool IsIdentifierChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+// Returns the position of the next occurrence of word in source at or after
+// pos that is not part of a longer identifier, or npos.
+static size_t FindWord(const std::string& source, const std::string& word,
+                       size_t pos) {
+  while ((pos = source.find(word, pos)) != std::string::npos) {
+    const size_t end = pos + word.length();
+    if ((pos == 0 || !IsIdentifierChar(source[pos - 1])) &&
+        (end == source.length() || !IsIdentifierChar(source[end])))
+      return pos;
+    pos = end;
+  }
+  return std::string::npos;
+}
+
+static size_t SkipWhitespace(const std::string& source, size_t pos) {
+  const size_t end = source.find_first_not_of(" \t\r\n", pos);
+  return end == std::string::npos ? source.length() : end;
+}
+
+// Returns the identifier starting at pos, or an empty string.
+static const std::string GetIdentifier(const std::string& source, size_t pos) {
+  size_t end = pos;
+  while (end < source.length() && IsIdentifierChar(source[end]))
+    ++end;
+  return source.substr(pos, end - pos);
+}
+
+// Returns whether the text of a declaration before its type, ignoring
+// preprocessor and comment lines, declares a uniform.
+static bool IsUniformQualifier(const std::string& text) {
+  std::istringstream lines(text);
+  std::string line;
+  std::string tokens;
+  while (std::getline(lines, line)) {
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#' ||
+        line.compare(start, 2, "//") == 0)
+      continue;
+    tokens += " " + line;
+  }
+  std::istringstream words(tokens);
+  std::string word;
+  if (!(words >> word) || word != "uniform")
+    return false;
+  if (words >> word &&
+      word != "lowp" && word != "mediump" && word != "highp")
+    return false;
+  return !(words >> word);
+}
+
+// Replaces length characters of a shader source at pos with text.
+struct SourceEdit {
+  SourceEdit(size_t pos_in, size_t length_in, const std::string& text_in)
+      : pos(pos_in), length(length_in), text(text_in) {}
+  size_t pos;
+  size_t length;
+  std::string text;
+};
+
+// Returns the number of the line containing pos.
+static size_t GetLineNumber(const std::string& source, size_t pos) {
+  return 1U + std::count(source.begin(), source.begin() + pos, '\n');
+}
+
+// Returns the usage level for a pixel that requested the negated log2 of its
+// footprint in texture coordinates for a texture of the passed size.
+static size_t GetLevel(float neg_log_footprint, uint32 size) {
+  const float level =
+      std::log2(static_cast<float>(std::max(size, 1U))) - neg_log_footprint;
+  if (level <= 0.f)
+    return 0U;
+  return std::min(static_cast<size_t>(level),
+                  TextureFeedback::kMaxLevels - 1U);
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// TextureFeedbackComposer.
+//
+//-----------------------------------------------------------------------------
+
+const char TextureFeedbackComposer::kNodeIdUniformName[] =
+    "uIonFeedbackNodeId";
+
+TextureFeedbackComposer::TextureFeedbackComposer(
+    const ShaderSourceComposerPtr& composer)
+    : composer_(composer) {}
+
+TextureFeedbackComposer::~TextureFeedbackComposer() {}
+
+const std::string TextureFeedbackComposer::GetSource() {
+  const std::string source = composer_->GetSource();
+  sampler_names_.clear();
+
+  // Find the uniform sampler2D declarations, after the last of which the
+  // feedback functions are inserted.
+  size_t functions_pos = std::string::npos;
+  for (size_t pos = FindWord(source, "sampler2D", 0U);
+       pos != std::string::npos;
+       pos = FindWord(source, "sampler2D", pos + 1U)) {
+    const size_t statement_start = source.find_last_of(";{}", pos);
+    const size_t text_start =
+        statement_start == std::string::npos ? 0U : statement_start + 1U;
+    if (!IsUniformQualifier(source.substr(text_start, pos - text_start)))
+      continue;
+    const size_t name_pos = SkipWhitespace(source, pos + 9U);
+    const std::string name = GetIdentifier(source, name_pos);
+    const size_t end_pos = SkipWhitespace(source, name_pos + name.length());
+    if (name.empty() || end_pos >= source.length() || source[end_pos] != ';')
+      continue;
+    sampler_names_.push_back(name);
+    functions_pos = end_pos + 1U;
+  }
+
+  // Find the definition of main(), which is renamed.
+  size_t main_pos = std::string::npos;
+  for (size_t pos = FindWord(source, "main", 0U); pos != std::string::npos;
+       pos = FindWord(source, "main", pos + 1U)) {
+    const size_t paren_pos = SkipWhitespace(source, pos + 4U);
+    const size_t void_pos = source.rfind("void", pos);
+    if (paren_pos < source.length() && source[paren_pos] == '(' &&
+        void_pos != std::string::npos &&
+        SkipWhitespace(source, void_pos + 4U) == pos) {
+      main_pos = pos;
+      break;
+    }
+  }
+  if (main_pos == std::string::npos) {
+    LOG(ERROR) << "TextureFeedbackComposer: the shader has no main()";
+    return source;
+  }
+  // Without samplers, the functions only need to precede main().
+  if (functions_pos == std::string::npos)
+    functions_pos = source.rfind("void", main_pos);
+
+  // Enable derivatives after any #version directive.
+  size_t header_pos = 0U;
+  const size_t first_pos = SkipWhitespace(source, 0U);
+  if (source.compare(first_pos, 8, "#version") == 0) {
+    const size_t end_pos = source.find('\n', first_pos);
+    header_pos = end_pos == std::string::npos ? source.length() : end_pos + 1U;
+  }
+
+  // Collect the edits, in order, so that they can be applied in one pass.
+  std::vector<SourceEdit> edits;
+  std::ostringstream header;
+  if (header_pos && source[header_pos - 1U] != '\n')
+    header << "\n";
+  header << "#ifdef GL_ES\n"
+         << "#extension GL_OES_standard_derivatives : enable\n"
+         << "#endif\n"
+         << "#line " << GetLineNumber(source, header_pos) << "\n";
+  edits.push_back(SourceEdit(header_pos, 0U, header.str()));
+  std::ostringstream functions;
+  functions << "\n" << kFeedbackFunctions << "#line "
+            << GetLineNumber(source, functions_pos) << "\n";
+  edits.push_back(SourceEdit(functions_pos, 0U, functions.str()));
+  edits.push_back(SourceEdit(main_pos, 4U, "ionFeedbackMain"));
+
+  // Route texture2D() calls on the samplers through the feedback functions.
+  for (size_t pos = FindWord(source, "texture2D", header_pos);
+       pos != std::string::npos;
+       pos = FindWord(source, "texture2D", pos + 1U)) {
+    const size_t paren_pos = SkipWhitespace(source, pos + 9U);
+    if (paren_pos >= source.length() || source[paren_pos] != '(')
+      continue;
+    const size_t name_pos = SkipWhitespace(source, paren_pos + 1U);
+    const std::vector<std::string>::const_iterator it =
+        std::find(sampler_names_.begin(), sampler_names_.end(),
+                  GetIdentifier(source, name_pos));
+    if (it == sampler_names_.end())
+      continue;
+    std::ostringstream call;
+    call << "ionFeedbackTexture2D(" << (it - sampler_names_.begin() + 1)
+         << ".0, ";
+    edits.push_back(SourceEdit(pos, name_pos - pos, call.str()));
+  }
+  std::stable_sort(edits.begin(), edits.end(),
+                   [](const SourceEdit& a, const SourceEdit& b) {
+                     return a.pos < b.pos;
+                   });
+
+  std::ostringstream str;
+  size_t copied = 0U;
+  for (const SourceEdit& edit : edits) {
+    str << source.substr(copied, edit.pos - copied) << edit.text;
+    copied = edit.pos + edit.length;
+  }
+  str << source.substr(copied) << kFeedbackMain;
+  return str.str();
+}
+
+bool TextureFeedbackComposer::DependsOn(const std::string& dependency) const {
+  return composer_->DependsOn(dependency);
+}
+
+const std::string TextureFeedbackComposer::GetDependencySource(
+    const std::string& dependency) const {
+  return composer_->GetDependencySource(dependency);
+}
+
+bool TextureFeedbackComposer::SetDependencySource(
+    const std::string& dependency, const std::string& source) {
+  return composer_->SetDependencySource(dependency, source);
+}
+
+const std::string TextureFeedbackComposer::GetDependencyName(
+    unsigned int id) const {
+  return composer_->GetDependencyName(id);
+}
+
+const std::vector<std::string> TextureFeedbackComposer::GetDependencyNames()
+    const {
+  return composer_->GetDependencyNames();
+}
+
+const std::vector<std::string>
+TextureFeedbackComposer::GetChangedDependencies() {
+  return composer_->GetChangedDependencies();
+}
+
+//-----------------------------------------------------------------------------
+//
+// TextureFeedback.
+//
+//-----------------------------------------------------------------------------
+
+const size_t TextureFeedback::kMaxLevels;
+
+TextureFeedback::TextureFeedback(const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      fbo_(new (allocator_) gfx::FramebufferObject(128U, 128U)),
+      pending_(allocator_),
+      capture_count_(0U) {
+  fbo_->SetLabel("Texture feedback");
+  fbo_->SetColorAttachment(
+      0U, gfx::FramebufferObject::Attachment(gfx::Image::kRgba8888));
+  fbo_->SetDepthAttachment(
+      gfx::FramebufferObject::Attachment(gfx::Image::kRenderbufferDepth16));
+}
+
+TextureFeedback::~TextureFeedback() {}
+
+void TextureFeedback::SetSize(uint32 width, uint32 height) {
+  fbo_->Resize(std::max(width, 1U), std::max(height, 1U));
+}
+
+void TextureFeedback::Capture(gfx::Renderer* renderer, const NodePtr& node) {
+  if (!node.Get())
+    return;
+  const uint32 width = fbo_->GetWidth();
+  const uint32 height = fbo_->GetHeight();
+
+  // Id 0 means that no node was drawn.
+  NodeTextures textures(1U);
+  StateTablePtr state_table(new (allocator_) StateTable(width, height));
+  state_table->SetViewport(0, 0, width, height);
+  state_table->SetClearColor(math::Vector4f::Zero());
+  state_table->SetClearDepthValue(1.f);
+  state_table->Enable(StateTable::kBlend, false);
+  NodePtr root(new (allocator_) Node);
+  root->SetLabel("Texture feedback");
+  root->SetStateTable(state_table);
+  if (node->IsEnabled()) {
+    root->AddChild(CopyNode(*node, renderer->GetDefaultShaderProgram(),
+                            SamplerMap(), &textures));
+  }
+  if (textures.size() > kMaxNodeId + 1U) {
+    LOG_ONCE(WARNING) << "TextureFeedback: only the first " << kMaxNodeId
+                      << " nodes of a scene are measured";
+  }
+
+  const gfx::FramebufferObjectPtr previous_fbo =
+      renderer->GetCurrentFramebuffer();
+  renderer->BindFramebuffer(fbo_);
+  renderer->DrawScene(root);
+  PendingCapture capture;
+  capture.readback = renderer->ReadImageAsync(
+      math::Range2i::BuildWithSize(
+          math::Point2i(0, 0),
+          math::Vector2i(static_cast<int>(width), static_cast<int>(height))),
+      gfx::Image::kRgba8888, allocator_);
+  renderer->BindFramebuffer(previous_fbo);
+  capture.textures = textures;
+  last_textures_.swap(textures);
+  pending_.push_back(capture);
+}
+
+size_t TextureFeedback::Update() {
+  size_t count = 0U;
+  while (!pending_.empty() && pending_.front().readback->IsReady()) {
+    const gfx::ImagePtr& image = pending_.front().readback->GetImage();
+    if (image.Get())
+      AddImage(*image, pending_.front().textures);
+    pending_.erase(pending_.begin());
+    ++count;
+  }
+  return count;
+}
+
+void TextureFeedback::AddFeedbackImage(const gfx::ImagePtr& image) {
+  if (image.Get())
+    AddImage(*image, last_textures_);
+}
+
+const TextureFeedback::TextureUsage* TextureFeedback::GetUsage(
+    const gfx::Texture* texture) const {
+  const auto it = usage_.find(texture);
+  return it == usage_.end() ? nullptr : &it->second.usage;
+}
+
+const std::vector<TexturePtr> TextureFeedback::GetSampledTextures() const {
+  std::vector<TexturePtr> textures;
+  textures.reserve(usage_.size());
+  for (const auto& entry : usage_)
+    textures.push_back(entry.second.texture);
+  return textures;
+}
+
+void TextureFeedback::Reset() {
+  usage_.clear();
+  pending_.clear();
+  last_textures_.clear();
+  capture_count_ = 0U;
+}
+
+const TextureFeedback::FeedbackProgram& TextureFeedback::FindFeedbackProgram(
+    const ShaderProgramPtr& program) {
+  FeedbackProgram& feedback = programs_[program.Get()];
+  if (!feedback.program.Get()) {
+    const std::string& label = program->GetLabel();
+    const std::string vertex_source = program->GetVertexShader().Get()
+        ? program->GetVertexShader()->GetSource() : std::string();
+    const std::string fragment_source = program->GetFragmentShader().Get()
+        ? program->GetFragmentShader()->GetSource() : std::string();
+    feedback.source = program;
+    feedback.composer = new (allocator_) TextureFeedbackComposer(
+        ShaderSourceComposerPtr(new (allocator_) StringComposer(
+            label + " fragment shader", fragment_source)));
+    feedback.program = ShaderProgram::BuildFromStrings(
+        label + " [texture feedback]",
+        GetFeedbackRegistry(program->GetRegistry()), vertex_source,
+        feedback.composer->GetSource(), allocator_);
+  }
+  return feedback;
+}
+
+const ShaderInputRegistryPtr& TextureFeedback::GetFeedbackRegistry(
+    const ShaderInputRegistryPtr& registry) {
+  ShaderInputRegistryPtr& feedback = registries_[registry.Get()];
+  if (!feedback.Get()) {
+    feedback = new (allocator_) ShaderInputRegistry;
+    if (registry.Get())
+      feedback->Include(registry);
+    else
+      feedback->IncludeGlobalRegistry();
+    feedback->Add(ShaderInputRegistry::UniformSpec(
+        TextureFeedbackComposer::kNodeIdUniformName,
+        gfx::kFloatVector2Uniform,
+        "Id of the Node drawn for texture feedback"));
+  }
+  return feedback;
+}
+
+const NodePtr TextureFeedback::CopyNode(const Node& node,
+                                        const ShaderProgramPtr& program,
+                                        const SamplerMap& samplers,
+                                        NodeTextures* textures) {
+  NodePtr copy(new (allocator_) Node);
+  copy->SetLabel(node.GetLabel());
+  copy->SetRenderPass(node.GetRenderPass());
+  copy->SetDrawOrderPreserved(node.IsDrawOrderPreserved());
+  if (node.HasBounds())
+    copy->SetBounds(node.GetBounds());
+  if (node.HasLodRange())
+    copy->SetLodRange(node.GetLodRange());
+
+  if (const StateTable* st = node.GetStateTable().Get()) {
+    StateTablePtr state_table(new (allocator_) StateTable);
+    state_table->CopyFrom(*st);
+    if (st->IsCapabilitySet(StateTable::kBlend))
+      state_table->Enable(StateTable::kBlend, false);
+    if (st->IsValueSet(StateTable::kViewportValue))
+      state_table->SetViewport(0, 0, fbo_->GetWidth(), fbo_->GetHeight());
+    if (st->IsValueSet(StateTable::kClearColorValue))
+      state_table->SetClearColor(math::Vector4f::Zero());
+    copy->SetStateTable(state_table);
+  }
+
+  const ShaderProgramPtr& node_program =
+      node.GetShaderProgram().Get() ? node.GetShaderProgram() : program;
+  const FeedbackProgram& feedback = FindFeedbackProgram(node_program);
+  copy->SetShaderProgram(feedback.program);
+
+  // Track the textures that the samplers are set to.
+  SamplerMap node_samplers(samplers);
+  const auto add_uniform = [&copy, &node_samplers](const Uniform& uniform) {
+    if (uniform.GetType() == gfx::kTextureUniform && uniform.GetCount() == 0U) {
+      if (const ShaderInputRegistry::UniformSpec* spec =
+              ShaderInputRegistry::GetSpec(uniform))
+        node_samplers[spec->name] = uniform.GetValue<TexturePtr>();
+    }
+  };
+  for (const Uniform& uniform : node.GetUniforms()) {
+    copy->AddUniform(uniform);
+    add_uniform(uniform);
+  }
+  for (const gfx::UniformBlockPtr& block : node.GetUniformBlocks()) {
+    copy->AddUniformBlock(block);
+    if (block->IsEnabled()) {
+      for (const Uniform& uniform : block->GetUniforms())
+        add_uniform(uniform);
+    }
+  }
+
+  const size_t id = textures->size();
+  if (id <= kMaxNodeId) {
+    const std::vector<std::string>& names =
+        feedback.composer->GetSamplerNames();
+    std::vector<TexturePtr> node_textures(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      const SamplerMap::const_iterator it = node_samplers.find(names[i]);
+      if (it != node_samplers.end())
+        node_textures[i] = it->second;
+    }
+    textures->push_back(node_textures);
+    copy->AddUniform(feedback.program->GetRegistry()->Create<Uniform>(
+        TextureFeedbackComposer::kNodeIdUniformName,
+        math::Vector2f(static_cast<float>(id & 0xff) / 255.f,
+                       static_cast<float>(id >> 8) / 255.f)));
+  }
+
+  for (const gfx::ShapePtr& shape : node.GetShapes())
+    copy->AddShape(shape);
+  for (const NodePtr& child : node.GetChildren()) {
+    if (child.Get() && child->IsEnabled())
+      copy->AddChild(CopyNode(*child, node_program, node_samplers, textures));
+  }
+  return copy;
+}
+
+void TextureFeedback::AddImage(const gfx::Image& image,
+                               const NodeTextures& textures) {
+  if (image.GetFormat() != gfx::Image::kRgba8888 || !image.GetData().Get() ||
+      !image.GetData()->GetData()) {
+    LOG(ERROR) << "TextureFeedback: feedback images must be RGBA8888";
+    return;
+  }
+  ++capture_count_;
+  const uint8* pixels = image.GetData()->GetData<uint8>();
+  const size_t pixel_count =
+      static_cast<size_t>(image.GetWidth()) * image.GetHeight();
+  for (size_t i = 0; i < pixel_count; ++i) {
+    const uint8* pixel = &pixels[i * 4U];
+    const size_t id = pixel[0] | (static_cast<size_t>(pixel[1]) << 8);
+    const size_t sampler = pixel[2];
+    if (!sampler || id >= textures.size() ||
+        sampler > textures[id].size() || !textures[id][sampler - 1U].Get())
+      continue;
+    const TexturePtr& texture = textures[id][sampler - 1U];
+    UsageEntry& entry = usage_[texture.Get()];
+    entry.texture = texture;
+    uint32 size = 1U;
+    if (texture->HasImage(0U)) {
+      const gfx::ImagePtr& level0 = texture->GetImage(0U);
+      size = std::max(level0->GetWidth(), level0->GetHeight());
+    }
+    const size_t level =
+        GetLevel(static_cast<float>(pixel[3]) / 16.f, size);
+    TextureUsage& usage = entry.usage;
+    ++usage.sample_count;
+    ++usage.level_counts[level];
+    usage.finest_level = std::min(usage.finest_level, level);
+    usage.capture = capture_count_;
+  }
+}
+
+}  // namespace gfxutils
+}  // namespace ion
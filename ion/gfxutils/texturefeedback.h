@@ -0,0 +1,234 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_TEXTUREFEEDBACK_H_
+#define ION_GFXUTILS_TEXTUREFEEDBACK_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/framebufferobject.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/texture.h"
+#include "ion/gfxutils/shadersourcecomposer.h"
+
+namespace ion {
+namespace gfxutils {
+
+// TextureFeedbackComposer instruments the fragment shader source of another
+// composer so that it writes, instead of its color, which texture it sampled
+// last and roughly which mip level OpenGL chose for it. Each texture2D() call
+// on a uniform sampler2D is routed through a function that records the index
+// of the sampler (starting at 1, in the order the samplers are declared) and
+// the negated log2 of the screen-space derivatives of the texture coordinates,
+// and main() is renamed and wrapped by one that writes the recorded values to
+// gl_FragColor:
+//   red, green: the value of the vec2 kNodeIdUniformName uniform, which
+//       identifies the drawn Node.
+//   blue: the sampler index divided by 255, or 0 if nothing was sampled.
+//   alpha: -log2 of the texture coordinate footprint of the pixel, times 16
+//       and divided by 255. Subtracting it from log2 of the texture size gives
+//       the requested mip level.
+//
+// Only shaders that write gl_FragColor and sample with texture2D() are
+// supported, and each sampler2D uniform must be declared on its own.
+// Derivatives require GL_OES_standard_derivatives on OpenGL ES 2.0, which the
+// composer enables, and are undefined in non-uniform control flow. All
+// dependency queries are forwarded to the other composer.
+class ION_API TextureFeedbackComposer : public ShaderSourceComposer {
+ public:
+  // The name of the vec2 uniform holding the id of the drawn Node, encoded as
+  // two bytes divided by 255.
+  static const char kNodeIdUniformName[];
+
+  explicit TextureFeedbackComposer(const ShaderSourceComposerPtr& composer);
+
+  const std::string GetSource() override;
+  bool DependsOn(const std::string& dependency) const override;
+  const std::string GetDependencySource(
+      const std::string& dependency) const override;
+  bool SetDependencySource(const std::string& dependency,
+                           const std::string& source) override;
+  const std::string GetDependencyName(unsigned int id) const override;
+  const std::vector<std::string> GetDependencyNames() const override;
+  const std::vector<std::string> GetChangedDependencies() override;
+
+  // Returns the names of the sampler2D uniforms found by the last call to
+  // GetSource(), where the name of the sampler with index i is at i - 1.
+  const std::vector<std::string>& GetSamplerNames() const {
+    return sampler_names_;
+  }
+
+ protected:
+  // The destructor is protected since this is derived from base::Referent.
+  ~TextureFeedbackComposer() override;
+
+ private:
+  ShaderSourceComposerPtr composer_;
+  std::vector<std::string> sampler_names_;
+};
+typedef base::ReferentPtr<TextureFeedbackComposer>::Type
+    TextureFeedbackComposerPtr;
+
+// TextureFeedback measures which textures a scene actually samples, and at
+// which mip levels, to size texture memory and to decide which textures or
+// levels can be dropped when GPU memory is short. Each Capture() draws a copy
+// of a scene into a small framebuffer with shader programs instrumented by
+// TextureFeedbackComposer, and reads it back asynchronously. Update()
+// aggregates the captures whose pixels have arrived into a TextureUsage for
+// each sampled Texture.
+//
+// The copy shares the Shapes, Uniforms and UniformBlocks of the scene, so
+// Capture() can be called after drawing a frame without disturbing it; the
+// copied StateTables have blending disabled and their viewports replaced. Only
+// the last texture sampled by each pixel is counted, so the usage is a
+// heatmap of visible texture coverage rather than an exact count of samples.
+//
+// Typical usage, e.g., every few frames in a debug build:
+//   feedback.Capture(renderer.Get(), scene);
+//   ...
+//   feedback.Update();
+//   const TextureFeedback::TextureUsage* usage = feedback.GetUsage(texture);
+class ION_API TextureFeedback {
+ public:
+  // The maximum number of mip levels tracked.
+  static const size_t kMaxLevels = 16U;
+
+  // How a Texture was sampled by the captures since the last Reset().
+  struct TextureUsage {
+    TextureUsage() : sample_count(0U), finest_level(kMaxLevels), capture(0U) {
+      for (size_t i = 0; i < kMaxLevels; ++i)
+        level_counts[i] = 0U;
+    }
+    // The number of feedback pixels that sampled the texture.
+    uint64 sample_count;
+    // The finest (lowest) mip level requested, which is the most detailed
+    // level that needs to be resident.
+    size_t finest_level;
+    // The number of pixels that requested each mip level.
+    uint64 level_counts[kMaxLevels];
+    // The number of the last capture that sampled the texture.
+    uint64 capture;
+  };
+
+  // The passed allocator is used for all allocations; if it is NULL, the
+  // default allocator is used.
+  explicit TextureFeedback(const base::AllocatorPtr& allocator);
+  ~TextureFeedback();
+
+  // Sets the size of the feedback framebuffer, which defaults to 128x128.
+  // Smaller sizes are cheaper to draw and read, but miss small objects.
+  void SetSize(uint32 width, uint32 height);
+  uint32 GetWidth() const { return fbo_->GetWidth(); }
+  uint32 GetHeight() const { return fbo_->GetHeight(); }
+
+  // Draws a copy of node into the feedback framebuffer with instrumented
+  // programs, and starts reading it back. The framebuffer bound to renderer is
+  // restored afterwards.
+  void Capture(gfx::Renderer* renderer, const gfx::NodePtr& node);
+
+  // Aggregates the captures whose pixels have been read back, returning how
+  // many there were. Readbacks are delivered by Renderer::DrawScene() and
+  // Renderer::ProcessImageReadbacks().
+  size_t Update();
+
+  // Aggregates an RGBA8888 feedback image of the most recent Capture() that
+  // was read back by other means, e.g., with Renderer::ReadImage().
+  void AddFeedbackImage(const gfx::ImagePtr& image);
+
+  // Returns the usage of texture, or NULL if no capture has sampled it.
+  const TextureUsage* GetUsage(const gfx::Texture* texture) const;
+  // Returns the textures sampled by the captures so far.
+  const std::vector<gfx::TexturePtr> GetSampledTextures() const;
+  // Returns the number of captures that have been aggregated.
+  uint64 GetCaptureCount() const { return capture_count_; }
+  // Forgets all usage, and releases the references held to the textures.
+  void Reset();
+
+  // Returns the instrumented version of program, creating it the first time.
+  const gfx::ShaderProgramPtr GetFeedbackProgram(
+      const gfx::ShaderProgramPtr& program) {
+    return FindFeedbackProgram(program).program;
+  }
+
+ private:
+  // The textures sampled by each sampler of each node in a capture, indexed by
+  // node id and sampler index.
+  typedef std::vector<std::vector<gfx::TexturePtr>> NodeTextures;
+  // A capture whose pixels have not yet been aggregated.
+  struct PendingCapture {
+    gfx::Renderer::ImageReadbackPtr readback;
+    NodeTextures textures;
+  };
+  // An instrumented program, the composer holding the names of its samplers,
+  // and the program it was created from, which is kept alive so that its
+  // address is not reused.
+  struct FeedbackProgram {
+    gfx::ShaderProgramPtr source;
+    gfx::ShaderProgramPtr program;
+    TextureFeedbackComposerPtr composer;
+  };
+  struct UsageEntry {
+    gfx::TexturePtr texture;
+    TextureUsage usage;
+  };
+  // Maps a sampler name to the texture it is set to.
+  typedef std::unordered_map<std::string, gfx::TexturePtr> SamplerMap;
+
+  // Returns a copy of node for the feedback pass, adding the textures of the
+  // copy to textures. program is the program inherited by node, and samplers
+  // holds the inherited sampler values.
+  const gfx::NodePtr CopyNode(const gfx::Node& node,
+                              const gfx::ShaderProgramPtr& program,
+                              const SamplerMap& samplers,
+                              NodeTextures* textures);
+  // Returns the instrumented version of program, creating it the first time.
+  const FeedbackProgram& FindFeedbackProgram(
+      const gfx::ShaderProgramPtr& program);
+  // Returns the registry of the feedback programs of programs using registry.
+  const gfx::ShaderInputRegistryPtr& GetFeedbackRegistry(
+      const gfx::ShaderInputRegistryPtr& registry);
+  // Aggregates the pixels of image, with the textures of their nodes.
+  void AddImage(const gfx::Image& image, const NodeTextures& textures);
+
+  base::AllocatorPtr allocator_;
+  gfx::FramebufferObjectPtr fbo_;
+  std::unordered_map<const gfx::ShaderProgram*, FeedbackProgram> programs_;
+  std::unordered_map<const gfx::ShaderInputRegistry*,
+                     gfx::ShaderInputRegistryPtr> registries_;
+  base::AllocVector<PendingCapture> pending_;
+  // The textures of the most recent capture.
+  NodeTextures last_textures_;
+  std::unordered_map<const gfx::Texture*, UsageEntry> usage_;
+  uint64 capture_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(TextureFeedback);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_TEXTUREFEEDBACK_H_
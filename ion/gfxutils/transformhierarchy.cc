@@ -0,0 +1,198 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/transformhierarchy.h"
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/invalid.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/uniform.h"
+#include "ion/math/transformkernels.h"
+#include "ion/math/transformutils.h"
+
+namespace ion {
+namespace gfxutils {
+
+const size_t TransformHierarchy::kNoParent;
+
+TransformHierarchy::TransformHierarchy(
+    const gfx::ShaderInputRegistryPtr& registry,
+    const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      registry_(registry),
+      transforms_(allocator_),
+      levels_(allocator_),
+      batch_(allocator_),
+      parent_worlds_(allocator_),
+      locals_(allocator_),
+      changed_(allocator_) {
+  DCHECK(registry_.Get());
+}
+
+TransformHierarchy::~TransformHierarchy() {}
+
+size_t TransformHierarchy::AddTransform(size_t parent,
+                                        const gfx::NodePtr& node,
+                                        const std::string& uniform_name) {
+  return AddTransformInternal(parent, node, gfx::UniformBlockPtr(),
+                              uniform_name);
+}
+
+size_t TransformHierarchy::AddTransform(size_t parent,
+                                        const gfx::UniformBlockPtr& block,
+                                        const std::string& uniform_name) {
+  return AddTransformInternal(parent, gfx::NodePtr(), block, uniform_name);
+}
+
+size_t TransformHierarchy::AddTransformInternal(
+    size_t parent, const gfx::NodePtr& node, const gfx::UniformBlockPtr& block,
+    const std::string& uniform_name) {
+  if (parent != kNoParent && parent >= transforms_.size()) {
+    LOG(ERROR) << "TransformHierarchy: invalid parent " << parent;
+    return base::kInvalidIndex;
+  }
+  Transform transform;
+  transform.parent = parent;
+  transform.translation = math::Vector3f::Zero();
+  transform.rotation = math::Rotationf::Identity();
+  transform.scale = math::Vector3f::Fill(1.f);
+  transform.local = transform.world = math::Matrix4f::Identity();
+  transform.node = node;
+  transform.block = block;
+  transform.uniform_index = base::kInvalidIndex;
+  transform.is_local_dirty = false;
+  transform.is_world_dirty = true;
+  transform.is_world_changed = false;
+  if (gfx::UniformHolder* holder = GetHolder(transform)) {
+    transform.uniform_index = holder->GetUniformIndex(uniform_name);
+    if (transform.uniform_index == base::kInvalidIndex) {
+      transform.uniform_index = holder->AddUniform(
+          registry_->Create<gfx::Uniform>(uniform_name, transform.world));
+    }
+  }
+
+  // The depth of a transform is one more than its parent's.
+  size_t depth = 0U;
+  for (size_t i = parent; i != kNoParent; i = transforms_[i].parent)
+    ++depth;
+  if (depth >= levels_.size())
+    levels_.push_back(base::AllocVector<size_t>(allocator_));
+  levels_[depth].push_back(transforms_.size());
+  transforms_.push_back(transform);
+  return transforms_.size() - 1U;
+}
+
+void TransformHierarchy::SetTranslation(size_t index,
+                                        const math::Vector3f& translation) {
+  Transform& transform = GetMutable(index);
+  transform.translation = translation;
+  transform.is_local_dirty = true;
+}
+
+void TransformHierarchy::SetRotation(size_t index,
+                                     const math::Rotationf& rotation) {
+  Transform& transform = GetMutable(index);
+  transform.rotation = rotation;
+  transform.is_local_dirty = true;
+}
+
+void TransformHierarchy::SetScale(size_t index, const math::Vector3f& scale) {
+  Transform& transform = GetMutable(index);
+  transform.scale = scale;
+  transform.is_local_dirty = true;
+}
+
+void TransformHierarchy::SetLocalMatrix(size_t index,
+                                        const math::Matrix4f& matrix) {
+  Transform& transform = GetMutable(index);
+  transform.local = matrix;
+  transform.is_local_dirty = false;
+  transform.is_world_dirty = true;
+}
+
+size_t TransformHierarchy::Update(base::TaskScheduler* scheduler) {
+  changed_.clear();
+  const size_t num_levels = levels_.size();
+  for (size_t depth = 0; depth < num_levels; ++depth) {
+    // Find the transforms at this depth whose world matrices must be
+    // recomputed, which are those that changed and the children of those
+    // whose world matrices were just recomputed.
+    const base::AllocVector<size_t>& level = levels_[depth];
+    batch_.clear();
+    for (size_t i = 0; i < level.size(); ++i) {
+      Transform& transform = transforms_[level[i]];
+      if (transform.is_local_dirty) {
+        // Scale, then rotate, then translate.
+        math::Matrix4f& m = transform.local;
+        m = math::RotationMatrixH(transform.rotation);
+        for (int row = 0; row < 3; ++row) {
+          for (int col = 0; col < 3; ++col)
+            m(row, col) *= transform.scale[col];
+          m(row, 3) = transform.translation[row];
+        }
+        transform.is_local_dirty = false;
+        transform.is_world_dirty = true;
+      }
+      if (transform.is_world_dirty ||
+          (transform.parent != kNoParent &&
+           transforms_[transform.parent].is_world_changed))
+        batch_.push_back(level[i]);
+    }
+    const size_t count = batch_.size();
+    if (!count)
+      continue;
+
+    if (depth == 0U) {
+      for (size_t i = 0; i < count; ++i) {
+        Transform& transform = transforms_[batch_[i]];
+        transform.world = transform.local;
+      }
+    } else {
+      parent_worlds_.resize(count);
+      locals_.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        const Transform& transform = transforms_[batch_[i]];
+        parent_worlds_[i] = transforms_[transform.parent].world;
+        locals_[i] = transform.local;
+      }
+      math::MultiplyMatrices(parent_worlds_.data(), locals_.data(), count,
+                             parent_worlds_.data(), scheduler);
+      for (size_t i = 0; i < count; ++i)
+        transforms_[batch_[i]].world = parent_worlds_[i];
+    }
+    for (size_t i = 0; i < count; ++i) {
+      Transform& transform = transforms_[batch_[i]];
+      transform.is_world_dirty = false;
+      transform.is_world_changed = true;
+      if (gfx::UniformHolder* holder = GetHolder(transform))
+        holder->SetUniformValue(transform.uniform_index, transform.world);
+      changed_.push_back(batch_[i]);
+    }
+  }
+  for (size_t i = 0; i < changed_.size(); ++i)
+    transforms_[changed_[i]].is_world_changed = false;
+  return changed_.size();
+}
+
+gfx::UniformHolder* TransformHierarchy::GetHolder(const Transform& transform) {
+  if (transform.node.Get())
+    return transform.node.Get();
+  return transform.block.Get();
+}
+
+}  // namespace gfxutils
+}  // namespace ion
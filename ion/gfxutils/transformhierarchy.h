@@ -0,0 +1,180 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_TRANSFORMHIERARCHY_H_
+#define ION_GFXUTILS_TRANSFORMHIERARCHY_H_
+
+#include <string>
+
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/uniformblock.h"
+#include "ion/math/matrix.h"
+#include "ion/math/rotation.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
+namespace gfxutils {
+
+// TransformHierarchy maintains a hierarchy of transforms, each with a local
+// translation, rotation and scale relative to its parent, and caches their
+// world matrices, the products of the local matrices of a transform and all of
+// its ancestors. Each transform can write its world matrix into a matrix
+// Uniform of a Node or of a UniformBlock, so that applications do not need to
+// walk their scene and set model matrix Uniforms themselves.
+//
+// Changing a transform only marks it as dirty. Update(), which should be called
+// once per frame before drawing, recomputes the world matrices of the dirty
+// transforms and their descendants, and of no others. The transforms at each
+// depth of the hierarchy are multiplied by their parents' world matrices in a
+// single batch with the SIMD kernels in math/transformkernels.h.
+//
+// Typical usage:
+//   TransformHierarchy hierarchy(reg, allocator);
+//   const size_t body = hierarchy.AddTransform(
+//       TransformHierarchy::kNoParent, body_node, "uModelMatrix");
+//   const size_t arm = hierarchy.AddTransform(body, arm_node, "uModelMatrix");
+//   ...
+//   // Every frame:
+//   hierarchy.SetRotation(arm, arm_rotation);
+//   hierarchy.Update(NULL);
+//   renderer->DrawScene(root);
+class ION_API TransformHierarchy {
+ public:
+  // The parent of root transforms, which has the value of base::kInvalidIndex.
+  static const size_t kNoParent = static_cast<size_t>(-1);
+
+  // Uniforms added by AddTransform() are created in the passed registry. The
+  // passed allocator is used for all allocations; if it is NULL, the default
+  // allocator is used.
+  TransformHierarchy(const gfx::ShaderInputRegistryPtr& registry,
+                     const base::AllocatorPtr& allocator);
+  ~TransformHierarchy();
+
+  // Adds an identity transform as a child of the transform at index parent, or
+  // as a root if parent is kNoParent, and returns its index. The world matrix
+  // of the transform is written into the matrix Uniform named uniform_name of
+  // the passed Node or UniformBlock, which is added to it if it does not
+  // have it; the Uniform must not be removed. Either may be NULL if the
+  // transform only groups other transforms. Logs an error and returns
+  // base::kInvalidIndex if parent is invalid.
+  size_t AddTransform(size_t parent, const gfx::NodePtr& node,
+                      const std::string& uniform_name);
+  size_t AddTransform(size_t parent, const gfx::UniformBlockPtr& block,
+                      const std::string& uniform_name);
+
+  // Returns the number of transforms.
+  size_t GetCount() const { return transforms_.size(); }
+  // Returns the index of the parent of a transform, or kNoParent.
+  size_t GetParent(size_t index) const { return Get(index).parent; }
+
+  // Sets/returns the components of the local transform of a transform, which
+  // is applied in the order scale, rotation, translation.
+  void SetTranslation(size_t index, const math::Vector3f& translation);
+  const math::Vector3f& GetTranslation(size_t index) const {
+    return Get(index).translation;
+  }
+  void SetRotation(size_t index, const math::Rotationf& rotation);
+  const math::Rotationf& GetRotation(size_t index) const {
+    return Get(index).rotation;
+  }
+  void SetScale(size_t index, const math::Vector3f& scale);
+  const math::Vector3f& GetScale(size_t index) const {
+    return Get(index).scale;
+  }
+  // Sets the local matrix of a transform directly, replacing its translation,
+  // rotation and scale until one of them is set again.
+  void SetLocalMatrix(size_t index, const math::Matrix4f& matrix);
+
+  // Returns the local and world matrices of a transform as of the last call
+  // to Update().
+  const math::Matrix4f& GetLocalMatrix(size_t index) const {
+    return Get(index).local;
+  }
+  const math::Matrix4f& GetWorldMatrix(size_t index) const {
+    return Get(index).world;
+  }
+
+  // Recomputes the world matrices of the transforms that have changed since
+  // the last call and of their descendants, and writes them into their
+  // Uniforms. If scheduler is not NULL, large batches of transforms are split
+  // over its threads. Returns the number of world matrices recomputed.
+  size_t Update(base::TaskScheduler* scheduler);
+
+ private:
+  struct Transform {
+    size_t parent;
+    math::Vector3f translation;
+    math::Rotationf rotation;
+    math::Vector3f scale;
+    math::Matrix4f local;
+    math::Matrix4f world;
+    // The Uniform receiving the world matrix, if any.
+    gfx::NodePtr node;
+    gfx::UniformBlockPtr block;
+    size_t uniform_index;
+    // Whether the local matrix must be recomputed from the translation,
+    // rotation and scale, and whether the world matrix must be recomputed.
+    bool is_local_dirty;
+    bool is_world_dirty;
+    // Whether the world matrix was recomputed by the current Update().
+    bool is_world_changed;
+  };
+
+  const Transform& Get(size_t index) const {
+    DCHECK_LT(index, transforms_.size());
+    return transforms_[index];
+  }
+  Transform& GetMutable(size_t index) {
+    DCHECK_LT(index, transforms_.size());
+    return transforms_[index];
+  }
+
+  // Adds a transform whose world matrix is written into a Uniform of the
+  // passed Node or UniformBlock.
+  size_t AddTransformInternal(size_t parent, const gfx::NodePtr& node,
+                              const gfx::UniformBlockPtr& block,
+                              const std::string& uniform_name);
+  // Returns the Node or UniformBlock receiving the world matrix of a
+  // transform, or NULL.
+  static gfx::UniformHolder* GetHolder(const Transform& transform);
+
+  base::AllocatorPtr allocator_;
+  gfx::ShaderInputRegistryPtr registry_;
+  base::AllocVector<Transform> transforms_;
+  // The indices of the transforms at each depth of the hierarchy.
+  base::AllocVector<base::AllocVector<size_t> > levels_;
+  // Scratch arrays for the batches of each Update().
+  base::AllocVector<size_t> batch_;
+  base::AllocVector<math::Matrix4f> parent_worlds_;
+  base::AllocVector<math::Matrix4f> locals_;
+  base::AllocVector<size_t> changed_;
+
+  DISALLOW_COPY_AND_ASSIGN(TransformHierarchy);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_TRANSFORMHIERARCHY_H_
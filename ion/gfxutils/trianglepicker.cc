@@ -0,0 +1,211 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/trianglepicker.h"
+
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/invalid.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfxutils/meshoptimizer.h"
+#include "ion/math/intersectionutils.h"
+
+namespace ion {
+namespace gfxutils {
+
+namespace {
+
+using math::Point3f;
+using math::Range3f;
+using math::Vector3f;
+
+typedef base::AllocVector<Point3f> PositionVector;
+
+// Reads the positions of all vertices from the "aVertex" attribute of
+// |attribute_array|. Returns false if there is no such attribute with at
+// least 3 float components, or its BufferObject has no data.
+static bool GetPositions(const gfx::AttributeArrayPtr& attribute_array,
+                         PositionVector* positions) {
+  const size_t attribute_count = attribute_array->GetBufferAttributeCount();
+  for (size_t i = 0; i < attribute_count; ++i) {
+    const gfx::Attribute& attribute = attribute_array->GetBufferAttribute(i);
+    if (attribute.GetRegistry().GetSpec(attribute)->name != "aVertex")
+      continue;
+    const gfx::BufferObjectElement& element =
+        attribute.GetValue<gfx::BufferObjectElement>();
+    const gfx::BufferObjectPtr& buffer_object = element.buffer_object;
+    if (!buffer_object.Get())
+      return false;
+    const gfx::BufferObject::Spec& spec =
+        buffer_object->GetSpec(element.spec_index);
+    const base::DataContainerPtr& data_container = buffer_object->GetData();
+    if (spec.type != gfx::BufferObject::kFloat || spec.component_count < 3U ||
+        !data_container.Get() || !data_container->GetData())
+      return false;
+    const uint8* data = data_container->GetData<uint8>() + spec.byte_offset;
+    const size_t stride = buffer_object->GetStructSize();
+    const size_t vertex_count = buffer_object->GetCount();
+    positions->resize(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+      float xyz[3];
+      memcpy(xyz, data + v * stride, sizeof(xyz));
+      (*positions)[v].Set(xyz[0], xyz[1], xyz[2]);
+    }
+    return true;
+  }
+  return false;
+}
+
+}  // anonymous namespace
+
+TrianglePicker::TrianglePicker()
+    : indices_(*this),
+      positions_(*this),
+      triangle_bounds_(*this) {}
+
+TrianglePicker::~TrianglePicker() {}
+
+bool TrianglePicker::SetShape(const gfx::ShapePtr& shape,
+                              base::TaskScheduler* scheduler) {
+  shape_.Reset();
+  indices_.clear();
+  positions_.clear();
+  triangle_bounds_.clear();
+  hierarchy_.Clear();
+
+  if (!shape.Get() || shape->GetPrimitiveType() != gfx::Shape::kTriangles ||
+      shape->GetVertexRangeCount() || !shape->GetAttributeArray().Get()) {
+    LOG(ERROR) << "TrianglePicker: only triangle Shapes without vertex ranges"
+               << " can be picked";
+    return false;
+  }
+  if (const gfx::IndexBuffer* index_buffer = shape->GetIndexBuffer().Get()) {
+    const base::DataContainerPtr& index_data = index_buffer->GetData();
+    if (!index_data.Get() || !index_data->GetData()) {
+      LOG(ERROR) << "TrianglePicker: the IndexBuffer has no data";
+      return false;
+    }
+    if (!ReadIndexBuffer(*index_buffer, &indices_)) {
+      LOG(ERROR) << "TrianglePicker: unsupported index type";
+      return false;
+    }
+  }
+  shape_ = shape;
+  if (!ReadPositions()) {
+    shape_.Reset();
+    indices_.clear();
+    return false;
+  }
+  hierarchy_.Build(triangle_bounds_.data(), triangle_bounds_.size(),
+                   scheduler);
+  return true;
+}
+
+bool TrianglePicker::Refit() {
+  if (!shape_.Get()) {
+    LOG(ERROR) << "TrianglePicker: Refit() needs a Shape";
+    return false;
+  }
+  const size_t triangle_count = GetTriangleCount();
+  if (!ReadPositions() || GetTriangleCount() != triangle_count) {
+    indices_.clear();
+    triangle_bounds_.clear();
+    hierarchy_.Clear();
+    return false;
+  }
+  hierarchy_.Refit(triangle_bounds_.data(), triangle_bounds_.size());
+  return true;
+}
+
+bool TrianglePicker::ReadPositions() {
+  if (!GetPositions(shape_->GetAttributeArray(), &positions_)) {
+    LOG(ERROR) << "TrianglePicker: the Shape needs a 3-component float"
+               << " \"aVertex\" attribute with data";
+    return false;
+  }
+  // Shapes without an IndexBuffer draw their vertices in order.
+  if (!shape_->GetIndexBuffer().Get()) {
+    indices_.resize(positions_.size() - positions_.size() % 3U);
+    for (size_t i = 0; i < indices_.size(); ++i)
+      indices_[i] = static_cast<uint32>(i);
+  }
+  const size_t triangle_count = GetTriangleCount();
+  triangle_bounds_.resize(triangle_count);
+  for (size_t t = 0; t < triangle_count; ++t) {
+    Range3f& bounds = triangle_bounds_[t];
+    bounds.MakeEmpty();
+    for (size_t i = 3U * t; i < 3U * t + 3U; ++i) {
+      if (indices_[i] >= positions_.size()) {
+        LOG(ERROR) << "TrianglePicker: index " << indices_[i]
+                   << " is out of range for " << positions_.size()
+                   << " vertices";
+        return false;
+      }
+      bounds.ExtendByPoint(positions_[indices_[i]]);
+    }
+  }
+  return true;
+}
+
+void TrianglePicker::GetTriangle(size_t triangle, Point3f* p0, Point3f* p1,
+                                 Point3f* p2) const {
+  DCHECK_LT(triangle, GetTriangleCount());
+  *p0 = positions_[indices_[3U * triangle]];
+  *p1 = positions_[indices_[3U * triangle + 1U]];
+  *p2 = positions_[indices_[3U * triangle + 2U]];
+}
+
+bool TrianglePicker::Pick(const Point3f& origin, const Vector3f& direction,
+                          float max_distance, Hit* hit) const {
+  float u = 0.f;
+  float v = 0.f;
+  float distance = 0.f;
+  const size_t triangle = hierarchy_.IntersectRay(
+      origin, direction, max_distance,
+      [&](size_t t, float* closest) {
+        Point3f p0, p1, p2;
+        GetTriangle(t, &p0, &p1, &p2);
+        float t_u, t_v;
+        if (!math::IntersectRayAndTriangle(origin, direction, p0, p1, p2,
+                                           *closest, closest, &t_u, &t_v))
+          return false;
+        u = t_u;
+        v = t_v;
+        return true;
+      },
+      &distance);
+  if (triangle == base::kInvalidIndex)
+    return false;
+  if (hit) {
+    Point3f p0, p1, p2;
+    GetTriangle(triangle, &p0, &p1, &p2);
+    hit->triangle = triangle;
+    hit->distance = distance;
+    hit->u = u;
+    hit->v = v;
+    hit->point = p0 + u * (p1 - p0) + v * (p2 - p0);
+  }
+  return true;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
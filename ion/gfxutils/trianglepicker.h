@@ -0,0 +1,114 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_TRIANGLEPICKER_H_
+#define ION_GFXUTILS_TRIANGLEPICKER_H_
+
+#include "base/integral_types.h"
+#include "ion/base/allocatable.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/shape.h"
+#include "ion/math/boundingvolumehierarchy.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
+namespace gfxutils {
+
+// A TrianglePicker finds the triangles of a Shape that are hit by rays, e.g.,
+// to pick the point under the cursor, using a math::BoundingVolumeHierarchy
+// over the triangles. It reads the Shape's indices and the positions of its
+// "aVertex" attribute once, so the data of their BufferObjects must not have
+// been wiped. Positions are in the Shape's coordinate system; transform rays
+// into it to pick a Shape that is transformed by its Nodes.
+//
+// For animated geometry whose vertices move but whose triangles do not
+// change, call Refit() after the positions have been updated, which is much
+// cheaper than calling SetShape() again.
+class ION_API TrianglePicker : public base::Allocatable {
+ public:
+  // Describes where a ray hits a triangle.
+  struct Hit {
+    Hit() : triangle(0U), distance(0.f), u(0.f), v(0.f) {}
+    // The index of the triangle, i.e., its first vertex is the one at
+    // 3 * triangle in the index buffer or, for Shapes without one, in the
+    // vertex buffer.
+    size_t triangle;
+    // The distance to the hit point in multiples of the ray direction.
+    float distance;
+    // The hit point, p0 + u * (p1 - p0) + v * (p2 - p0) for the triangle's
+    // vertex positions p0, p1 and p2.
+    math::Point3f point;
+    float u;
+    float v;
+  };
+
+  TrianglePicker();
+  ~TrianglePicker() override;
+
+  // Reads the triangles of |shape| and builds the hierarchy over them, in
+  // parallel on the threads of |scheduler| if it is not NULL. The Shape must
+  // have kTriangles primitives, no vertex ranges, a 3-component float
+  // "aVertex" attribute whose data is still present and, if it has an
+  // IndexBuffer, unsigned byte, short, or int indices with data. Returns
+  // false, logs an error and removes all triangles if it does not. The
+  // picker keeps a reference to |shape| for Refit().
+  bool SetShape(const gfx::ShapePtr& shape, base::TaskScheduler* scheduler);
+
+  // Rereads the positions of the Shape passed to SetShape() and refits the
+  // hierarchy to them. Returns false and logs an error if the positions can no
+  // longer be read or there is no Shape.
+  bool Refit();
+
+  // Returns the number of triangles of the Shape.
+  size_t GetTriangleCount() const { return indices_.size() / 3U; }
+  // Returns the positions of the three vertices of a triangle.
+  void GetTriangle(size_t triangle, math::Point3f* p0, math::Point3f* p1,
+                   math::Point3f* p2) const;
+  // Returns the hierarchy, whose primitives are the triangles, e.g., to find
+  // the triangles in a frustum or range.
+  const math::BoundingVolumeHierarchy& GetHierarchy() const {
+    return hierarchy_;
+  }
+
+  // Finds the closest triangle hit from either side by the ray from |origin|
+  // along |direction| at a distance of at most |max_distance|, in multiples of
+  // |direction|, and returns true and fills in |hit| if there is one.
+  // Degenerate triangles are never hit.
+  bool Pick(const math::Point3f& origin, const math::Vector3f& direction,
+            float max_distance, Hit* hit) const;
+
+ private:
+  // Reads the positions of the Shape and computes the bounds of each
+  // triangle. Returns false if the positions cannot be read.
+  bool ReadPositions();
+
+  gfx::ShapePtr shape_;
+  base::AllocVector<uint32> indices_;
+  base::AllocVector<math::Point3f> positions_;
+  base::AllocVector<math::Range3f> triangle_bounds_;
+  math::BoundingVolumeHierarchy hierarchy_;
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_TRIANGLEPICKER_H_
@@ -0,0 +1,528 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/gfxutils/virtualtexture.h"
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/sampler.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/uniform.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace gfxutils {
+
+using gfx::Image;
+using gfx::ImagePtr;
+using gfx::NodePtr;
+using gfx::Sampler;
+using gfx::SamplerPtr;
+using gfx::ShaderInputRegistry;
+using gfx::Texture;
+
+namespace {
+
+// The number of calls to Update() within which a queued request must be
+// repeated to keep it queued.
+static const uint64 kRequestLifetime = 8U;
+
+static const char kUniformDeclarations[] =
+    "uniform sampler2D uIonVirtualPageTable;\n"
+    "uniform sampler2D uIonVirtualCache;\n"
+    "// x, y: level 0 tiles along each side. z, w: cache tiles along each\n"
+    "// side.\n"
+    "uniform vec4 uIonVirtualLayout;\n"
+    "// x: tile size in texels. y: the coarsest level.\n"
+    "uniform vec2 uIonVirtualTileSize;\n";
+
+static const char kSamplingFunction[] =
+    "vec4 ionVirtualTexture2D(vec2 uv) {\n"
+    "  vec4 entry =\n"
+    "      floor(texture2D(uIonVirtualPageTable, uv) * 255.0 + 0.5);\n"
+    "  vec2 tiles =\n"
+    "      max(floor(uIonVirtualLayout.xy / exp2(entry.b)), vec2(1.0));\n"
+    "  float inset = 0.5 / uIonVirtualTileSize.x;\n"
+    "  vec2 offset = clamp(fract(uv * tiles), vec2(inset),\n"
+    "                      vec2(1.0 - inset));\n"
+    "  return step(0.5, entry.a) * texture2D(\n"
+    "      uIonVirtualCache, (entry.rg + offset) / uIonVirtualLayout.zw);\n"
+    "}\n";
+
+// The tile position is encoded in red and green, with bits 8 and 9 of x and
+// y in bits 4-5 and 6-7 of blue, and the level in bits 0-3 of blue.
+static const char kFeedbackFunction[] =
+    "vec4 ionVirtualTextureFeedback(vec2 uv) {\n"
+    "  vec2 texels = uv * uIonVirtualLayout.xy * uIonVirtualTileSize.x;\n"
+    "  vec2 dx = dFdx(texels);\n"
+    "  vec2 dy = dFdy(texels);\n"
+    "  float footprint = max(max(dot(dx, dx), dot(dy, dy)), 1.0);\n"
+    "  float level =\n"
+    "      min(floor(0.5 * log2(footprint)), uIonVirtualTileSize.y);\n"
+    "  vec2 tiles =\n"
+    "      max(floor(uIonVirtualLayout.xy / exp2(level)), vec2(1.0));\n"
+    "  vec2 tile = clamp(floor(uv * tiles), vec2(0.0), tiles - 1.0);\n"
+    "  vec2 high = floor(tile / 256.0);\n"
+    "  return vec4(tile - high * 256.0,\n"
+    "              level + 16.0 * high.x + 64.0 * high.y, 255.0) / 255.0;\n"
+    "}\n";
+
+// Returns count rounded up to a power of two and clamped to [1, max_count],
+// logging an error if it changes.
+static uint32 ValidateTileCount(uint32 count, uint32 max_count,
+                                bool power_of_two, const char* what) {
+  uint32 valid = std::min(std::max(count, 1U), max_count);
+  if (power_of_two) {
+    uint32 rounded = 1U;
+    while (rounded < valid)
+      rounded <<= 1;
+    valid = rounded;
+  }
+  if (valid != count) {
+    LOG(ERROR) << "VirtualTexture: " << what << " of " << count
+               << " is invalid, using " << valid;
+  }
+  return valid;
+}
+
+// Returns the number of levels of a pyramid with count level 0 tiles along
+// its longer side.
+static uint32 CountLevels(uint32 count) {
+  uint32 levels = 1U;
+  while (count > 1U) {
+    count >>= 1;
+    ++levels;
+  }
+  return levels;
+}
+
+}  // anonymous namespace
+
+const char VirtualTexture::kPageTableUniformName[] = "uIonVirtualPageTable";
+const char VirtualTexture::kCacheUniformName[] = "uIonVirtualCache";
+const char VirtualTexture::kLayoutUniformName[] = "uIonVirtualLayout";
+const char VirtualTexture::kTileSizeUniformName[] = "uIonVirtualTileSize";
+const uint32 VirtualTexture::kMaxTiles;
+const uint32 VirtualTexture::kMaxCacheTiles;
+const uint32 VirtualTexture::kInvalidSlot;
+
+VirtualTexture::VirtualTexture(uint32 tile_size, uint32 tiles_x,
+                               uint32 tiles_y, uint32 cache_columns,
+                               uint32 cache_rows, Image::Format format,
+                               const TileLoader& loader,
+                               const base::AllocatorPtr& allocator)
+    : allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      tile_size_(std::max(tile_size, 1U)),
+      tiles_x_(ValidateTileCount(tiles_x, kMaxTiles, true, "tiles_x")),
+      tiles_y_(ValidateTileCount(tiles_y, kMaxTiles, true, "tiles_y")),
+      cache_columns_(ValidateTileCount(cache_columns, kMaxCacheTiles, false,
+                                       "cache_columns")),
+      cache_rows_(ValidateTileCount(cache_rows, kMaxCacheTiles, false,
+                                    "cache_rows")),
+      level_count_(CountLevels(std::max(tiles_x_, tiles_y_))),
+      loader_(loader),
+      registry_(new (allocator_) ShaderInputRegistry),
+      page_table_(new (allocator_) Texture),
+      cache_(new (allocator_) Texture),
+      fbo_(new (allocator_) gfx::FramebufferObject(128U, 128U)),
+      readbacks_(allocator_),
+      slots_(allocator_, cache_columns_ * cache_rows_, kInvalidSlot),
+      resident_count_(0U),
+      pending_count_(0U),
+      page_table_changed_(false),
+      update_count_(0U),
+      loader_thread_count_(1U),
+      max_uploads_per_frame_(8U),
+      queue_(allocator_),
+      loaded_(allocator_),
+      pool_(this) {
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kPageTableUniformName, gfx::kTextureUniform,
+      "Page table of a VirtualTexture"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kCacheUniformName, gfx::kTextureUniform,
+      "Tile cache of a VirtualTexture"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kLayoutUniformName, gfx::kFloatVector4Uniform,
+      "Level 0 and cache tile counts of a VirtualTexture"));
+  registry_->Add(ShaderInputRegistry::UniformSpec(
+      kTileSizeUniformName, gfx::kFloatVector2Uniform,
+      "Tile size and coarsest level of a VirtualTexture"));
+
+  // The page table is looked up per level 0 tile, so it must not be
+  // filtered.
+  SamplerPtr page_sampler(new (allocator_) Sampler);
+  page_sampler->SetLabel("Virtual texture page table");
+  page_sampler->SetMinFilter(Sampler::kNearest);
+  page_sampler->SetMagFilter(Sampler::kNearest);
+  page_sampler->SetWrapS(Sampler::kClampToEdge);
+  page_sampler->SetWrapT(Sampler::kClampToEdge);
+  page_table_->SetLabel("Virtual texture page table");
+  page_table_->SetSampler(page_sampler);
+  UpdatePageTable();
+
+  SamplerPtr cache_sampler(new (allocator_) Sampler);
+  cache_sampler->SetLabel("Virtual texture cache");
+  cache_sampler->SetMinFilter(Sampler::kLinear);
+  cache_sampler->SetMagFilter(Sampler::kLinear);
+  cache_sampler->SetWrapS(Sampler::kClampToEdge);
+  cache_sampler->SetWrapT(Sampler::kClampToEdge);
+  ImagePtr cache_image(new (allocator_) Image);
+  cache_image->Set(format, cache_columns_ * tile_size_,
+                   cache_rows_ * tile_size_, base::DataContainerPtr());
+  cache_->SetLabel("Virtual texture cache");
+  cache_->SetSampler(cache_sampler);
+  cache_->SetImmutableImage(cache_image, 1U);
+  cache_->SetPixelBufferStreamingEnabled(true);
+
+  fbo_->SetLabel("Virtual texture feedback");
+  fbo_->SetColorAttachment(
+      0U, gfx::FramebufferObject::Attachment(Image::kRgba8888));
+  fbo_->SetDepthAttachment(
+      gfx::FramebufferObject::Attachment(Image::kRenderbufferDepth16));
+
+  // The coarsest tile is the fallback for every other tile.
+  Request(GetKey(level_count_ - 1U, 0U, 0U));
+  pool_.ResizeThreadPool(loader_thread_count_);
+  pool_.Resume();
+}
+
+VirtualTexture::~VirtualTexture() {
+  pool_.Suspend();
+  pool_.ResizeThreadPool(0U);
+}
+
+const std::string VirtualTexture::GetShaderSource() {
+  return std::string(kUniformDeclarations) + kSamplingFunction;
+}
+
+const std::string VirtualTexture::GetFeedbackShaderSource() {
+  return std::string(kUniformDeclarations) + kFeedbackFunction;
+}
+
+void VirtualTexture::AddUniformsToNode(const NodePtr& node) const {
+  if (!node.Get())
+    return;
+  node->AddUniform(
+      registry_->Create<gfx::Uniform>(kPageTableUniformName, page_table_));
+  node->AddUniform(registry_->Create<gfx::Uniform>(kCacheUniformName, cache_));
+  node->AddUniform(registry_->Create<gfx::Uniform>(
+      kLayoutUniformName,
+      math::Vector4f(static_cast<float>(tiles_x_),
+                     static_cast<float>(tiles_y_),
+                     static_cast<float>(cache_columns_),
+                     static_cast<float>(cache_rows_))));
+  node->AddUniform(registry_->Create<gfx::Uniform>(
+      kTileSizeUniformName,
+      math::Vector2f(static_cast<float>(tile_size_),
+                     static_cast<float>(level_count_ - 1U))));
+}
+
+void VirtualTexture::SetLoaderThreadCount(size_t count) {
+  loader_thread_count_ = count;
+  pool_.ResizeThreadPool(count);
+  // Resizing may have consumed the signals for queued tiles.
+  size_t queued;
+  {
+    base::LockGuard guard(&mutex_);
+    queued = queue_.size();
+  }
+  for (size_t i = 0; i < queued; ++i)
+    pool_.GetWorkSemaphore()->Post();
+}
+
+void VirtualTexture::SetFeedbackSize(uint32 width, uint32 height) {
+  fbo_->Resize(std::max(width, 1U), std::max(height, 1U));
+}
+
+void VirtualTexture::CaptureFeedback(gfx::Renderer* renderer,
+                                     const NodePtr& node) {
+  if (!node.Get())
+    return;
+  const uint32 width = fbo_->GetWidth();
+  const uint32 height = fbo_->GetHeight();
+  gfx::StateTablePtr state_table(
+      new (allocator_) gfx::StateTable(width, height));
+  state_table->SetViewport(0, 0, width, height);
+  state_table->SetClearColor(math::Vector4f::Zero());
+  state_table->SetClearDepthValue(1.f);
+  state_table->Enable(gfx::StateTable::kBlend, false);
+  NodePtr root(new (allocator_) gfx::Node);
+  root->SetLabel("Virtual texture feedback");
+  root->SetStateTable(state_table);
+  root->AddChild(node);
+
+  const gfx::FramebufferObjectPtr previous_fbo =
+      renderer->GetCurrentFramebuffer();
+  renderer->BindFramebuffer(fbo_);
+  renderer->DrawScene(root);
+  readbacks_.push_back(renderer->ReadImageAsync(
+      math::Range2i::BuildWithSize(
+          math::Point2i(0, 0),
+          math::Vector2i(static_cast<int>(width), static_cast<int>(height))),
+      Image::kRgba8888, allocator_));
+  renderer->BindFramebuffer(previous_fbo);
+}
+
+void VirtualTexture::AddFeedbackImage(const ImagePtr& image) {
+  if (!image.Get() || !image->GetData().Get() ||
+      !image->GetData()->GetData())
+    return;
+  if (image->GetFormat() != Image::kRgba8888) {
+    LOG(ERROR) << "VirtualTexture: feedback images must be RGBA8888";
+    return;
+  }
+  const uint8* pixels = image->GetData()->GetData<uint8>();
+  const size_t count =
+      static_cast<size_t>(image->GetWidth()) * image->GetHeight();
+  uint32 last_key = kInvalidSlot;
+  for (size_t i = 0; i < count; ++i) {
+    const uint8* pixel = &pixels[i * 4U];
+    // Pixels without feedback are cleared to 0.
+    if (!pixel[3])
+      continue;
+    const uint32 level = pixel[2] & 0xf;
+    const uint32 x = pixel[0] | (((pixel[2] >> 4) & 0x3) << 8);
+    const uint32 y = pixel[1] | ((pixel[2] >> 6) << 8);
+    const uint32 key = GetKey(level, x, y);
+    // Neighboring pixels usually need the same tile.
+    if (key == last_key)
+      continue;
+    last_key = key;
+    if (level >= level_count_ || x >= GetLevelTiles(tiles_x_, level) ||
+        y >= GetLevelTiles(tiles_y_, level))
+      continue;
+    // Requesting the coarser tiles covering the tile as well gives it a
+    // closer fallback while it loads.
+    for (uint32 coarser = level; coarser < level_count_; ++coarser) {
+      const uint32 shift = coarser - level;
+      Request(GetKey(coarser, x >> shift, y >> shift));
+    }
+  }
+}
+
+void VirtualTexture::RequestTile(uint32 level, uint32 x, uint32 y) {
+  if (level >= level_count_ || x >= GetLevelTiles(tiles_x_, level) ||
+      y >= GetLevelTiles(tiles_y_, level)) {
+    LOG(ERROR) << "VirtualTexture: tile " << x << ", " << y << " in level "
+               << level << " does not exist";
+    return;
+  }
+  Request(GetKey(level, x, y));
+}
+
+size_t VirtualTexture::Update() {
+  while (!readbacks_.empty() && readbacks_.front()->IsReady()) {
+    AddFeedbackImage(readbacks_.front()->GetImage());
+    readbacks_.erase(readbacks_.begin());
+  }
+  DropStaleRequests();
+  if (!loader_thread_count_) {
+    for (size_t i = 0; i < max_uploads_per_frame_ && LoadTile(); ++i) {}
+  }
+
+  base::AllocVector<LoadedTile> loaded(allocator_);
+  {
+    base::LockGuard guard(&mutex_);
+    const size_t count = std::min(loaded_.size(), max_uploads_per_frame_);
+    loaded.assign(loaded_.begin(), loaded_.begin() + count);
+    loaded_.erase(loaded_.begin(), loaded_.begin() + count);
+  }
+  size_t uploaded = 0U;
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    if (UploadTile(loaded[i]))
+      ++uploaded;
+  }
+  if (page_table_changed_)
+    UpdatePageTable();
+  ++update_count_;
+  return uploaded;
+}
+
+bool VirtualTexture::IsTileResident(uint32 level, uint32 x, uint32 y) const {
+  if (level >= level_count_ || x >= kMaxTiles || y >= kMaxTiles)
+    return false;
+  const auto it = tiles_.find(GetKey(level, x, y));
+  return it != tiles_.end() && it->second.state == kResident;
+}
+
+void VirtualTexture::Request(uint32 key) {
+  const auto it = tiles_.find(key);
+  if (it != tiles_.end()) {
+    it->second.last_requested = update_count_;
+    return;
+  }
+  tiles_[key].last_requested = update_count_;
+  ++pending_count_;
+  {
+    base::LockGuard guard(&mutex_);
+    queue_.push_back(key);
+  }
+  pool_.GetWorkSemaphore()->Post();
+}
+
+void VirtualTexture::DropStaleRequests() {
+  const uint32 root = GetKey(level_count_ - 1U, 0U, 0U);
+  base::LockGuard guard(&mutex_);
+  size_t kept = 0U;
+  for (size_t i = 0; i < queue_.size(); ++i) {
+    const uint32 key = queue_[i];
+    const auto it = tiles_.find(key);
+    DCHECK(it != tiles_.end());
+    if (key != root &&
+        it->second.last_requested + kRequestLifetime < update_count_) {
+      tiles_.erase(it);
+      --pending_count_;
+    } else {
+      queue_[kept++] = key;
+    }
+  }
+  queue_.resize(kept);
+}
+
+bool VirtualTexture::LoadTile() {
+  uint32 key;
+  {
+    base::LockGuard guard(&mutex_);
+    if (queue_.empty())
+      return false;
+    // Coarser tiles are loaded first, since they are the fallbacks of finer
+    // ones.
+    size_t index = 0U;
+    for (size_t i = 1; i < queue_.size(); ++i) {
+      if (GetLevel(queue_[i]) > GetLevel(queue_[index]))
+        index = i;
+    }
+    key = queue_[index];
+    queue_.erase(queue_.begin() + index);
+  }
+  const ImagePtr image = loader_ ? loader_(GetLevel(key), GetX(key), GetY(key))
+                                 : ImagePtr();
+  base::LockGuard guard(&mutex_);
+  loaded_.push_back(LoadedTile(key, image));
+  return true;
+}
+
+bool VirtualTexture::UploadTile(const LoadedTile& loaded) {
+  const uint32 key = loaded.first;
+  const auto it = tiles_.find(key);
+  DCHECK(it != tiles_.end());
+  Tile& tile = it->second;
+  --pending_count_;
+  const Image* image = loaded.second.Get();
+  if (!image || image->GetWidth() != tile_size_ ||
+      image->GetHeight() != tile_size_ ||
+      image->GetFormat() != cache_->GetImmutableImage()->GetFormat()) {
+    LOG(ERROR) << "VirtualTexture: "
+               << (image ? "tile has the wrong size or format"
+                         : "failed to load tile")
+               << " (" << GetX(key) << ", " << GetY(key) << " in level "
+               << GetLevel(key) << ")";
+    // The tile is kept as failed so that it is not requested again.
+    tile.state = kFailed;
+    return false;
+  }
+
+  const uint32 slot = FindFreeSlot();
+  if (slot == kInvalidSlot) {
+    LOG_ONCE(WARNING) << "VirtualTexture: the cache is too small for the "
+                      << "tiles needed by a frame";
+    tiles_.erase(it);
+    return false;
+  }
+  if (slots_[slot] != kInvalidSlot) {
+    tiles_.erase(slots_[slot]);
+    --resident_count_;
+  }
+  slots_[slot] = key;
+  tile.state = kResident;
+  tile.slot = slot;
+  ++resident_count_;
+  cache_->SetSubImage(0U,
+                      math::Point2ui((slot % cache_columns_) * tile_size_,
+                                     (slot / cache_columns_) * tile_size_),
+                      loaded.second);
+  page_table_changed_ = true;
+  return true;
+}
+
+uint32 VirtualTexture::FindFreeSlot() {
+  const uint32 root = GetKey(level_count_ - 1U, 0U, 0U);
+  uint32 oldest_slot = kInvalidSlot;
+  uint64 oldest_request = update_count_;
+  for (uint32 i = 0; i < static_cast<uint32>(slots_.size()); ++i) {
+    const uint32 key = slots_[i];
+    if (key == kInvalidSlot)
+      return i;
+    // The coarsest tile is never evicted.
+    if (key == root)
+      continue;
+    const uint64 requested = tiles_[key].last_requested;
+    if (requested < oldest_request) {
+      oldest_request = requested;
+      oldest_slot = i;
+    }
+  }
+  return oldest_slot;
+}
+
+void VirtualTexture::UpdatePageTable() {
+  const size_t texel_count = static_cast<size_t>(tiles_x_) * tiles_y_;
+  std::vector<uint8> texels(texel_count * 4U, 0U);
+  // Coarser tiles are written first so that finer tiles replace them.
+  for (uint32 level = level_count_; level-- > 0U;) {
+    for (uint32 slot = 0; slot < static_cast<uint32>(slots_.size()); ++slot) {
+      const uint32 key = slots_[slot];
+      if (key == kInvalidSlot || GetLevel(key) != level)
+        continue;
+      const uint32 x_begin = GetX(key) << level;
+      const uint32 x_end = std::min((GetX(key) + 1U) << level, tiles_x_);
+      const uint32 y_begin = GetY(key) << level;
+      const uint32 y_end = std::min((GetY(key) + 1U) << level, tiles_y_);
+      for (uint32 y = y_begin; y < y_end; ++y) {
+        for (uint32 x = x_begin; x < x_end; ++x) {
+          uint8* texel = &texels[(y * tiles_x_ + x) * 4U];
+          texel[0] = static_cast<uint8>(slot % cache_columns_);
+          texel[1] = static_cast<uint8>(slot / cache_columns_);
+          texel[2] = static_cast<uint8>(level);
+          texel[3] = 255U;
+        }
+      }
+    }
+  }
+  ImagePtr image(new (allocator_) Image);
+  image->Set(Image::kRgba8888, tiles_x_, tiles_y_,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &texels[0], texels.size(), true, allocator_));
+  page_table_->SetImage(0U, image);
+  page_table_changed_ = false;
+}
+
+void VirtualTexture::DoWork() {
+  LoadTile();
+}
+
+const std::string& VirtualTexture::GetName() const {
+  static const std::string kName("Ion virtual texture loader");
+  return kName;
+}
+
+}  // namespace gfxutils
+}  // namespace ion
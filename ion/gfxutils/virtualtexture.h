@@ -0,0 +1,270 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_GFXUTILS_VIRTUALTEXTURE_H_
+#define ION_GFXUTILS_VIRTUALTEXTURE_H_
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/base/workerpool.h"
+#include "ion/gfx/framebufferobject.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/texture.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace gfxutils {
+
+// VirtualTexture renders imagery that is far larger than the GPU memory it
+// may use, such as terrain or satellite imagery, from a fixed budget. The
+// imagery is split into square tiles forming a mip pyramid: level 0 has
+// tiles_x by tiles_y tiles, and each coarser level halves both counts down to
+// a single tile. Only the tiles that are needed are kept in a physical cache
+// texture; a small page table texture maps each level 0 tile to the most
+// detailed resident tile covering it.
+//
+// Shaders sample the imagery with ionVirtualTexture2D() from
+// GetShaderSource(). To find the tiles that are needed, a feedback pass draws
+// the scene with shaders that write ionVirtualTextureFeedback() from
+// GetFeedbackShaderSource() to gl_FragColor. CaptureFeedback() draws that pass
+// into a small framebuffer and reads it back asynchronously, and Update()
+// turns the pixels into tile requests. Requested tiles are loaded by a
+// TileLoader on worker threads, coarsest levels first, and a limited number
+// of loaded tiles is copied into the cache by each Update(), evicting the
+// least recently requested tiles. The single tile of the coarsest level is
+// always resident, so something is drawn everywhere once it is loaded.
+//
+// Typical usage:
+//   VirtualTexture vt(128U, 256U, 256U, 16U, 16U, Image::kRgba8888, loader,
+//                     allocator);
+//   registry->Include(vt.GetRegistry());
+//   vt.AddUniformsToNode(scene);
+//   vt.AddUniformsToNode(feedback_scene);
+//   ...
+//   // Every frame:
+//   vt.Update();
+//   renderer->DrawScene(scene);
+//   vt.CaptureFeedback(renderer.Get(), feedback_scene);
+//
+// The page table resolves each level 0 tile to a single resident tile, so
+// the level drawn is the same across the area of a level 0 tile. Tiles have
+// no borders; ionVirtualTexture2D() clamps samples half a texel inside each
+// tile to keep linear filtering from reading its neighbors in the cache.
+// Since the uniform names are fixed, a shader can only use one
+// VirtualTexture.
+class ION_API VirtualTexture : private base::WorkerPool::Worker {
+ public:
+  // The names of the uniforms in GetRegistry().
+  static const char kPageTableUniformName[];
+  static const char kCacheUniformName[];
+  static const char kLayoutUniformName[];
+  static const char kTileSizeUniformName[];
+  // The maximum number of level 0 tiles along each side.
+  static const uint32 kMaxTiles = 1024U;
+  // The maximum number of tiles along each side of the cache.
+  static const uint32 kMaxCacheTiles = 256U;
+
+  // Returns the image of the tile at x, y in level. It is called on the
+  // loader threads, so it must be thread-safe. The image must be tile_size
+  // square and have the format of the cache; returning NULL means that the
+  // tile cannot be loaded, and it is not requested again.
+  typedef std::function<gfx::ImagePtr(uint32 level, uint32 x, uint32 y)>
+      TileLoader;
+
+  // Creates a virtual texture of tiles_x by tiles_y tiles of tile_size square
+  // texels at level 0, with a cache of cache_columns by cache_rows tiles of
+  // the passed format. Tile counts are rounded up to powers of two and
+  // clamped to kMaxTiles, and cache sizes are clamped to kMaxCacheTiles,
+  // logging an error if they change. The passed allocator is used for all
+  // allocations; if it is NULL, the default allocator is used.
+  VirtualTexture(uint32 tile_size, uint32 tiles_x, uint32 tiles_y,
+                 uint32 cache_columns, uint32 cache_rows,
+                 gfx::Image::Format format, const TileLoader& loader,
+                 const base::AllocatorPtr& allocator);
+  ~VirtualTexture() override;
+
+  uint32 GetTileSize() const { return tile_size_; }
+  uint32 GetTilesX() const { return tiles_x_; }
+  uint32 GetTilesY() const { return tiles_y_; }
+  // Returns the number of levels, including level 0.
+  uint32 GetLevelCount() const { return level_count_; }
+
+  // Returns GLSL declarations of the uniforms and a function
+  //   vec4 ionVirtualTexture2D(vec2 uv)
+  // that samples the virtual texture at uv, which must be in [0, 1]. It
+  // returns black where no tile is resident.
+  static const std::string GetShaderSource();
+  // Returns GLSL declarations of the uniforms and a function
+  //   vec4 ionVirtualTextureFeedback(vec2 uv)
+  // returning the encoded tile and level needed at uv, which must be written
+  // to gl_FragColor by the feedback pass. It uses derivatives, which require
+  // GL_OES_standard_derivatives on OpenGL ES 2.0; shaders must enable the
+  // extension themselves.
+  static const std::string GetFeedbackShaderSource();
+
+  // Returns a registry holding the uniforms used by the shader sources,
+  // which should be included in the registries of shaders using them.
+  const gfx::ShaderInputRegistryPtr& GetRegistry() const { return registry_; }
+  // Adds the uniforms used by the shader sources to node.
+  void AddUniformsToNode(const gfx::NodePtr& node) const;
+  // Returns the page table texture, which has an RGBA8888 texel for each
+  // level 0 tile holding the cache column and row of the resident tile, its
+  // level, and 255 in alpha if any tile is resident.
+  const gfx::TexturePtr& GetPageTable() const { return page_table_; }
+  // Returns the cache texture.
+  const gfx::TexturePtr& GetCache() const { return cache_; }
+
+  // Sets the number of threads that load tiles. The default is 1. With 0
+  // threads, tiles are loaded by Update() on the calling thread.
+  void SetLoaderThreadCount(size_t count);
+  size_t GetLoaderThreadCount() const { return loader_thread_count_; }
+  // Sets the maximum number of tiles copied into the cache by each
+  // Update(), which bounds the upload cost of a frame. The default is 8.
+  void SetMaxUploadsPerFrame(size_t count) { max_uploads_per_frame_ = count; }
+  size_t GetMaxUploadsPerFrame() const { return max_uploads_per_frame_; }
+
+  // Sets the size of the feedback framebuffer, which defaults to 128x128.
+  void SetFeedbackSize(uint32 width, uint32 height);
+  // Draws node, whose shaders should write ionVirtualTextureFeedback(), into
+  // the feedback framebuffer and starts reading it back. node should not
+  // change the viewport. The framebuffer bound to renderer is restored
+  // afterwards.
+  void CaptureFeedback(gfx::Renderer* renderer, const gfx::NodePtr& node);
+  // Requests the tiles in an RGBA8888 feedback image read back by other
+  // means, e.g., with Renderer::ReadImage().
+  void AddFeedbackImage(const gfx::ImagePtr& image);
+  // Requests the tile at x, y in level, e.g., to prefetch it. Requests that
+  // are not repeated within eight calls to Update() are dropped if their
+  // tiles have not started loading.
+  void RequestTile(uint32 level, uint32 x, uint32 y);
+
+  // Requests the tiles of the feedback read back so far, copies up to
+  // GetMaxUploadsPerFrame() loaded tiles into the cache, and updates the page
+  // table. This must be called on the thread that draws, once per frame.
+  // Returns the number of tiles copied into the cache.
+  size_t Update();
+
+  // Returns whether the tile at x, y in level is in the cache.
+  bool IsTileResident(uint32 level, uint32 x, uint32 y) const;
+  // Returns the number of tiles in the cache.
+  size_t GetResidentTileCount() const { return resident_count_; }
+  // Returns the number of requested tiles that are not yet in the cache.
+  size_t GetPendingTileCount() const { return pending_count_; }
+
+ private:
+  enum TileState {
+    kPending,
+    kResident,
+    kFailed
+  };
+  struct Tile {
+    Tile() : state(kPending), slot(0U), last_requested(0U) {}
+    TileState state;
+    // The cache slot of a resident tile.
+    uint32 slot;
+    // The number of the last Update() that the tile was requested for.
+    uint64 last_requested;
+  };
+  typedef std::pair<uint32, gfx::ImagePtr> LoadedTile;
+
+  // Tiles are identified by a key packing their level and position.
+  static uint32 GetKey(uint32 level, uint32 x, uint32 y) {
+    return (level << 20) | (y << 10) | x;
+  }
+  static uint32 GetLevel(uint32 key) { return key >> 20; }
+  static uint32 GetX(uint32 key) { return key & 0x3ff; }
+  static uint32 GetY(uint32 key) { return (key >> 10) & 0x3ff; }
+  // Returns the number of tiles along a side with count level 0 tiles at
+  // level.
+  static uint32 GetLevelTiles(uint32 count, uint32 level) {
+    return std::max(count >> level, 1U);
+  }
+
+  // Requests the tile with key.
+  void Request(uint32 key);
+  // Drops queued requests that were not repeated since the last Update().
+  void DropStaleRequests();
+  // Loads the coarsest queued tile, returning false if there is none.
+  bool LoadTile();
+  // Copies a loaded tile into the cache, returning whether it was copied.
+  bool UploadTile(const LoadedTile& loaded);
+  // Returns the least recently requested cache slot that may be reused, or
+  // kInvalidSlot if all slots were requested for this Update().
+  uint32 FindFreeSlot();
+  // Rebuilds the page table from the resident tiles.
+  void UpdatePageTable();
+
+  // WorkerPool::Worker implementation.
+  void DoWork() override;
+  const std::string& GetName() const override;
+
+  static const uint32 kInvalidSlot = 0xffffffffU;
+
+  base::AllocatorPtr allocator_;
+  const uint32 tile_size_;
+  const uint32 tiles_x_;
+  const uint32 tiles_y_;
+  const uint32 cache_columns_;
+  const uint32 cache_rows_;
+  const uint32 level_count_;
+  const TileLoader loader_;
+  gfx::ShaderInputRegistryPtr registry_;
+  gfx::TexturePtr page_table_;
+  gfx::TexturePtr cache_;
+  gfx::FramebufferObjectPtr fbo_;
+  base::AllocVector<gfx::Renderer::ImageReadbackPtr> readbacks_;
+
+  // The state of every requested tile, and the key of the tile in each cache
+  // slot, or kInvalidSlot. These are only used by the drawing thread.
+  std::unordered_map<uint32, Tile> tiles_;
+  base::AllocVector<uint32> slots_;
+  size_t resident_count_;
+  size_t pending_count_;
+  bool page_table_changed_;
+  // The number of calls to Update().
+  uint64 update_count_;
+  size_t loader_thread_count_;
+  size_t max_uploads_per_frame_;
+
+  // The keys of the tiles waiting to be loaded, and the tiles that have been
+  // loaded but not yet copied into the cache, protected by mutex_.
+  base::AllocVector<uint32> queue_;
+  base::AllocVector<LoadedTile> loaded_;
+  port::Mutex mutex_;
+  // This must be last so that its threads stop before anything else is
+  // destroyed.
+  base::WorkerPool pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(VirtualTexture);
+};
+
+}  // namespace gfxutils
+}  // namespace ion
+
+#endif  // ION_GFXUTILS_VIRTUALTEXTURE_H_
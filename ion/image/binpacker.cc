@@ -15,7 +15,7 @@ limitations under the License.
 
 */
 
-#include "ion/text/binpacker.h"
+#include "ion/image/binpacker.h"
 
 #include <algorithm>
 #include <limits>
@@ -24,7 +24,7 @@ limitations under the License.
 #include "ion/base/logging.h"
 
 namespace ion {
-namespace text {
+namespace image {
 
 using math::Vector2ui;
 
@@ -204,6 +204,8 @@ BinPacker& BinPacker::operator=(const BinPacker& from) {
   rectangles_ = from.rectangles_;
   if (from.skyline_.get())
     skyline_.reset(new Skyline(*from.skyline_));
+  else
+    skyline_.reset();
   num_rectangles_packed_ = from.num_rectangles_packed_;
   return *this;
 }
@@ -225,5 +227,5 @@ bool BinPacker::Pack(const Vector2ui& bin_size) {
   return num_rectangles_packed_ == rectangles_.size();
 }
 
-}  // namespace text
+}  // namespace image
 }  // namespace ion
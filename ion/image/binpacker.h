@@ -15,8 +15,8 @@ limitations under the License.
 
 */
 
-#ifndef ION_TEXT_BINPACKER_H_
-#define ION_TEXT_BINPACKER_H_
+#ifndef ION_IMAGE_BINPACKER_H_
+#define ION_IMAGE_BINPACKER_H_
 
 #include <memory>
 #include <vector>
@@ -25,7 +25,7 @@ limitations under the License.
 #include "ion/math/vector.h"
 
 namespace ion {
-namespace text {
+namespace image {
 
 // This class implements generic 2D bin-packing using a modified version of the
 // Skyline Bottom-Left algorithm available at:
@@ -83,7 +83,7 @@ class BinPacker {
   size_t num_rectangles_packed_;
 };
 
-}  // namespace text
+}  // namespace image
 }  // namespace ion
 
-#endif  // ION_TEXT_BINPACKER_H_
+#endif  // ION_IMAGE_BINPACKER_H_
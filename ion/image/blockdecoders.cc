@@ -0,0 +1,1057 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/blockdecoders.h"
+
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+#include <functional>
+
+#include "base/macros.h"  // For ARRAYSIZE().
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+// A function that decodes one block of compressed data into |pixels|, which
+// holds |block_width| rows of |block_height| RGBA pixels.
+typedef void (*BlockDecoder)(const uint8* block, uint32 block_width,
+                             uint32 block_height, uint8* pixels);
+
+static inline uint8 ClampToByte(int value) {
+  return static_cast<uint8>(std::min(255, std::max(0, value)));
+}
+
+static inline void SetPixel(uint8* pixel, int r, int g, int b, int a) {
+  pixel[0] = ClampToByte(r);
+  pixel[1] = ClampToByte(g);
+  pixel[2] = ClampToByte(b);
+  pixel[3] = ClampToByte(a);
+}
+
+//-----------------------------------------------------------------------------
+//
+// ETC2 and EAC.
+//
+// Blocks are 4x4 pixels. The 64-bit color and channel blocks are big-endian,
+// and their per-pixel indices are stored in column-major order.
+//
+//-----------------------------------------------------------------------------
+
+// Intensity modifiers of the individual and differential modes, for the
+// pixel indices 0 and 1; indices 2 and 3 use their negations.
+static const int kEtcModifiers[8][2] = {
+  { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+  { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+// Distances between the paint colors of the T and H modes.
+static const int kEtcDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+// Modifiers of the EAC alpha and 11-bit channel blocks.
+static const int kEacModifiers[16][8] = {
+  { -3, -6, -9, -15, 2, 5, 8, 14 },
+  { -3, -7, -10, -13, 2, 6, 9, 12 },
+  { -2, -5, -8, -13, 1, 4, 7, 12 },
+  { -2, -4, -6, -13, 1, 3, 5, 12 },
+  { -3, -6, -8, -12, 2, 5, 7, 11 },
+  { -3, -7, -9, -11, 2, 6, 8, 10 },
+  { -4, -7, -8, -11, 3, 6, 7, 10 },
+  { -3, -5, -8, -11, 2, 4, 7, 10 },
+  { -2, -6, -8, -10, 1, 5, 7, 9 },
+  { -2, -5, -8, -10, 1, 4, 7, 9 },
+  { -2, -4, -8, -10, 1, 3, 7, 9 },
+  { -2, -5, -7, -10, 1, 4, 6, 9 },
+  { -3, -4, -7, -10, 2, 3, 6, 9 },
+  { -1, -2, -3, -10, 0, 1, 2, 9 },
+  { -4, -6, -8, -9, 3, 5, 7, 8 },
+  { -3, -5, -7, -9, 2, 4, 6, 8 }
+};
+
+static inline int Extend4(int value) { return (value << 4) | value; }
+static inline int Extend5(int value) { return (value << 3) | (value >> 2); }
+static inline int Extend6(int value) { return (value << 2) | (value >> 4); }
+static inline int Extend7(int value) { return (value << 1) | (value >> 6); }
+
+// Sign-extends a 3-bit two's complement value.
+static inline int SignExtend3(int value) {
+  return (value & 4) ? value - 8 : value;
+}
+
+// Returns the 2-bit index of pixel (x, y) of a color block.
+static inline int GetEtcPixelIndex(uint32 indices, uint32 x, uint32 y) {
+  const uint32 bit = x * 4U + y;
+  return static_cast<int>((((indices >> (bit + 16U)) & 1U) << 1) |
+                          ((indices >> bit) & 1U));
+}
+
+// Decodes an ETC2 RGB color block, which may also be an ETC1 block. If
+// |punchthrough| is set the block is from a kEtc2Rgba1 image, where the bit
+// that selects the individual mode instead says whether the block is opaque.
+static void DecodeEtc2ColorBlock(const uint8* b, bool punchthrough,
+                                 uint8* pixels) {
+  const uint32 indices = (static_cast<uint32>(b[4]) << 24) |
+                         (static_cast<uint32>(b[5]) << 16) |
+                         (static_cast<uint32>(b[6]) << 8) | b[7];
+  const bool opaque = !punchthrough || (b[3] & 2);
+  const bool differential = punchthrough || (b[3] & 2);
+  int base[2][3];
+  if (!differential) {
+    base[0][0] = Extend4(b[0] >> 4);
+    base[1][0] = Extend4(b[0] & 0xF);
+    base[0][1] = Extend4(b[1] >> 4);
+    base[1][1] = Extend4(b[1] & 0xF);
+    base[0][2] = Extend4(b[2] >> 4);
+    base[1][2] = Extend4(b[2] & 0xF);
+  } else {
+    const int r = b[0] >> 3;
+    const int g = b[1] >> 3;
+    const int bl = b[2] >> 3;
+    const int r2 = r + SignExtend3(b[0] & 7);
+    const int g2 = g + SignExtend3(b[1] & 7);
+    const int b2 = bl + SignExtend3(b[2] & 7);
+    if (r2 < 0 || r2 > 31 || g2 < 0 || g2 > 31) {
+      // T and H modes: four paint colors derived from two 4-bit colors.
+      int c1[3];
+      int c2[3];
+      int paint[4][3];
+      if (r2 < 0 || r2 > 31) {
+        c1[0] = Extend4(((b[0] >> 1) & 0xC) | (b[0] & 3));
+        c1[1] = Extend4(b[1] >> 4);
+        c1[2] = Extend4(b[1] & 0xF);
+        c2[0] = Extend4(b[2] >> 4);
+        c2[1] = Extend4(b[2] & 0xF);
+        c2[2] = Extend4(b[3] >> 4);
+        const int d = kEtcDistances[((b[3] >> 1) & 6) | (b[3] & 1)];
+        for (int c = 0; c < 3; ++c) {
+          paint[0][c] = c1[c];
+          paint[1][c] = c2[c] + d;
+          paint[2][c] = c2[c];
+          paint[3][c] = c2[c] - d;
+        }
+      } else {
+        const int r1 = (b[0] >> 3) & 0xF;
+        const int g1 = ((b[0] & 7) << 1) | ((b[1] >> 4) & 1);
+        const int b1 = (b[1] & 8) | ((b[1] & 3) << 1) | (b[2] >> 7);
+        const int r22 = (b[2] >> 3) & 0xF;
+        const int g22 = ((b[2] & 7) << 1) | (b[3] >> 7);
+        const int b22 = (b[3] >> 3) & 0xF;
+        // The lowest bit of the distance index is implied by the order of
+        // the two colors.
+        const int order = ((r1 << 8) | (g1 << 4) | b1) >=
+                          ((r22 << 8) | (g22 << 4) | b22) ? 1 : 0;
+        const int d =
+            kEtcDistances[(b[3] & 4) | ((b[3] & 1) << 1) | order];
+        c1[0] = Extend4(r1);
+        c1[1] = Extend4(g1);
+        c1[2] = Extend4(b1);
+        c2[0] = Extend4(r22);
+        c2[1] = Extend4(g22);
+        c2[2] = Extend4(b22);
+        for (int c = 0; c < 3; ++c) {
+          paint[0][c] = c1[c] + d;
+          paint[1][c] = c1[c] - d;
+          paint[2][c] = c2[c] + d;
+          paint[3][c] = c2[c] - d;
+        }
+      }
+      for (uint32 y = 0; y < 4U; ++y) {
+        for (uint32 x = 0; x < 4U; ++x) {
+          const int index = GetEtcPixelIndex(indices, x, y);
+          uint8* pixel = pixels + (y * 4U + x) * 4U;
+          if (!opaque && index == 2)
+            SetPixel(pixel, 0, 0, 0, 0);
+          else
+            SetPixel(pixel, paint[index][0], paint[index][1], paint[index][2],
+                     255);
+        }
+      }
+      return;
+    }
+    if (b2 < 0 || b2 > 31) {
+      // Planar mode: the colors are interpolated from three 6-7-6 colors at
+      // the origin, the right and the bottom of the block.
+      const int ro = Extend6((b[0] >> 1) & 0x3F);
+      const int go = Extend7(((b[0] & 1) << 6) | ((b[1] >> 1) & 0x3F));
+      const int bo = Extend6(((b[1] & 1) << 5) | (((b[2] >> 3) & 3) << 3) |
+                             ((b[2] & 3) << 1) | (b[3] >> 7));
+      const int rh = Extend6((((b[3] >> 2) & 0x1F) << 1) | (b[3] & 1));
+      const int gh = Extend7(b[4] >> 1);
+      const int bh = Extend6(((b[4] & 1) << 5) | (b[5] >> 3));
+      const int rv = Extend6(((b[5] & 7) << 3) | (b[6] >> 5));
+      const int gv = Extend7(((b[6] & 0x1F) << 2) | (b[7] >> 6));
+      const int bv = Extend6(b[7] & 0x3F);
+      for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+          SetPixel(pixels + (y * 4 + x) * 4,
+                   (x * (rh - ro) + y * (rv - ro) + 4 * ro + 2) >> 2,
+                   (x * (gh - go) + y * (gv - go) + 4 * go + 2) >> 2,
+                   (x * (bh - bo) + y * (bv - bo) + 4 * bo + 2) >> 2, 255);
+        }
+      }
+      return;
+    }
+    base[0][0] = Extend5(r);
+    base[1][0] = Extend5(r2);
+    base[0][1] = Extend5(g);
+    base[1][1] = Extend5(g2);
+    base[0][2] = Extend5(bl);
+    base[1][2] = Extend5(b2);
+  }
+
+  // Individual and differential modes: two half blocks, side by side or, if
+  // the flip bit is set, one above the other.
+  const int tables[2] = { (b[3] >> 5) & 7, (b[3] >> 2) & 7 };
+  const bool flip = (b[3] & 1) != 0;
+  for (uint32 y = 0; y < 4U; ++y) {
+    for (uint32 x = 0; x < 4U; ++x) {
+      const int half = flip ? (y >= 2U) : (x >= 2U);
+      const int index = GetEtcPixelIndex(indices, x, y);
+      uint8* pixel = pixels + (y * 4U + x) * 4U;
+      int modifier = kEtcModifiers[tables[half]][index & 1];
+      if (index & 2)
+        modifier = -modifier;
+      if (!opaque) {
+        // Non-opaque punchthrough blocks have a transparent index, and no
+        // small modifiers.
+        if (index == 2) {
+          SetPixel(pixel, 0, 0, 0, 0);
+          continue;
+        }
+        if (index == 0)
+          modifier = 0;
+      }
+      SetPixel(pixel, base[half][0] + modifier, base[half][1] + modifier,
+               base[half][2] + modifier, 255);
+    }
+  }
+}
+
+// Decodes a 64-bit EAC block into 16 8-bit values in row-major order. Alpha
+// blocks of kEtc2Rgba images have 8-bit values; the channels of kEacR11 and
+// kEacRg11 images have 11 bits, which are rounded to 8.
+static void DecodeEacBlock(const uint8* b, bool eleven_bits, uint8* values,
+                           size_t stride) {
+  const int base = b[0];
+  const int multiplier = b[1] >> 4;
+  const int* modifiers = kEacModifiers[b[1] & 0xF];
+  const uint64 indices = (static_cast<uint64>(b[2]) << 40) |
+                         (static_cast<uint64>(b[3]) << 32) |
+                         (static_cast<uint64>(b[4]) << 24) |
+                         (static_cast<uint64>(b[5]) << 16) |
+                         (static_cast<uint64>(b[6]) << 8) | b[7];
+  for (int i = 0; i < 16; ++i) {
+    const int modifier =
+        modifiers[static_cast<int>((indices >> (45 - 3 * i)) & 7U)];
+    int value;
+    if (eleven_bits) {
+      value = base * 8 + 4 +
+              (multiplier ? modifier * multiplier * 8 : modifier);
+      value = std::min(2047, std::max(0, value));
+      value = (value * 255 + 1023) / 2047;
+    } else {
+      value = base + modifier * multiplier;
+    }
+    // Index i is pixel (i / 4, i % 4).
+    values[((i & 3) * 4 + (i >> 2)) * stride] = ClampToByte(value);
+  }
+}
+
+static void DecodeEtc2RgbBlock(const uint8* block, uint32 block_width,
+                               uint32 block_height, uint8* pixels) {
+  DecodeEtc2ColorBlock(block, false, pixels);
+}
+
+static void DecodeEtc2Rgba1Block(const uint8* block, uint32 block_width,
+                                 uint32 block_height, uint8* pixels) {
+  DecodeEtc2ColorBlock(block, true, pixels);
+}
+
+static void DecodeEtc2RgbaBlock(const uint8* block, uint32 block_width,
+                                uint32 block_height, uint8* pixels) {
+  DecodeEtc2ColorBlock(block + 8, false, pixels);
+  DecodeEacBlock(block, false, pixels + 3, 4U);
+}
+
+static void DecodeEacR11Block(const uint8* block, uint32 block_width,
+                              uint32 block_height, uint8* pixels) {
+  DecodeEacBlock(block, true, pixels, 4U);
+}
+
+static void DecodeEacRg11Block(const uint8* block, uint32 block_width,
+                               uint32 block_height, uint8* pixels) {
+  DecodeEacBlock(block, true, pixels, 4U);
+  DecodeEacBlock(block + 8, true, pixels + 1, 4U);
+}
+
+//-----------------------------------------------------------------------------
+//
+// ASTC.
+//
+// Blocks are 128 bits and cover between 4x4 and 12x12 pixels. Fields are read
+// from the least significant bit of the little-endian block upward, except
+// for the weights, which are stored bit-reversed from the top of the block.
+//
+//-----------------------------------------------------------------------------
+
+// How a range of values is stored in an integer sequence: each value has
+// |bits| low bits and, if |trits| or |quints| is set, a base-3 or base-5 high
+// digit packed together with those of its neighbors.
+struct IseRange {
+  int trits;
+  int quints;
+  int bits;
+};
+
+// The ranges that integer sequences can use, in increasing order.
+static const IseRange kIseRanges[] = {
+  { 0, 0, 1 }, { 1, 0, 0 }, { 0, 0, 2 }, { 0, 1, 0 }, { 1, 0, 1 },
+  { 0, 0, 3 }, { 0, 1, 1 }, { 1, 0, 2 }, { 0, 0, 4 }, { 0, 1, 2 },
+  { 1, 0, 3 }, { 0, 0, 5 }, { 0, 1, 3 }, { 1, 0, 4 }, { 0, 0, 6 },
+  { 0, 1, 4 }, { 1, 0, 5 }, { 0, 0, 7 }, { 0, 1, 5 }, { 1, 0, 6 },
+  { 0, 0, 8 }
+};
+// Color endpoints need at least the range with 6 values.
+static const int kMinColorRange = 4;
+
+// The number of ISE values stored for |count| values.
+static int GetIseBitCount(int count, const IseRange& range) {
+  return count * range.bits + (range.trits ? (8 * count + 4) / 5 : 0) +
+         (range.quints ? (7 * count + 2) / 3 : 0);
+}
+
+// Returns |count| bits of |data| starting at bit |pos|. Bits at or above
+// |end| read as 0.
+static uint32 ReadBits(const uint8* data, int pos, int count, int end) {
+  uint32 value = 0;
+  for (int i = 0; i < count && pos + i < end; ++i)
+    value |= static_cast<uint32>((data[(pos + i) >> 3] >> ((pos + i) & 7)) & 1)
+             << i;
+  return value;
+}
+
+// Decodes |count| values of an integer sequence stored in |range| at bit
+// |pos| of |data|, reading no bits at or above |end|.
+static void DecodeIntegerSequence(const uint8* data, int pos, int end,
+                                  int count, const IseRange& range,
+                                  int* values) {
+  const int bits = range.bits;
+  if (range.trits) {
+    static const int kTritBits[5] = { 2, 2, 1, 2, 1 };
+    for (int first = 0; first < count; first += 5) {
+      int low[5];
+      int t = 0;
+      int shift = 0;
+      for (int i = 0; i < 5; ++i) {
+        low[i] = static_cast<int>(ReadBits(data, pos, bits, end));
+        pos += bits;
+        t |= static_cast<int>(ReadBits(data, pos, kTritBits[i], end)) << shift;
+        pos += kTritBits[i];
+        shift += kTritBits[i];
+      }
+      int trits[5];
+      int c;
+      if (((t >> 2) & 7) == 7) {
+        c = (((t >> 5) & 7) << 2) | (t & 3);
+        trits[4] = 2;
+        trits[3] = 2;
+      } else {
+        c = t & 0x1F;
+        if (((t >> 5) & 3) == 3) {
+          trits[4] = 2;
+          trits[3] = (t >> 7) & 1;
+        } else {
+          trits[4] = (t >> 7) & 1;
+          trits[3] = (t >> 5) & 3;
+        }
+      }
+      if ((c & 3) == 3) {
+        trits[2] = 2;
+        trits[1] = (c >> 4) & 1;
+        trits[0] = (((c >> 3) & 1) << 1) | (((c >> 2) & 1) & ~(c >> 3) & 1);
+      } else if (((c >> 2) & 3) == 3) {
+        trits[2] = 2;
+        trits[1] = 2;
+        trits[0] = c & 3;
+      } else {
+        trits[2] = (c >> 4) & 1;
+        trits[1] = (c >> 2) & 3;
+        trits[0] = (((c >> 1) & 1) << 1) | ((c & 1) & ~(c >> 1) & 1);
+      }
+      for (int i = 0; i < 5 && first + i < count; ++i)
+        values[first + i] = (trits[i] << bits) | low[i];
+    }
+  } else if (range.quints) {
+    static const int kQuintBits[3] = { 3, 2, 2 };
+    for (int first = 0; first < count; first += 3) {
+      int low[3];
+      int q = 0;
+      int shift = 0;
+      for (int i = 0; i < 3; ++i) {
+        low[i] = static_cast<int>(ReadBits(data, pos, bits, end));
+        pos += bits;
+        q |= static_cast<int>(ReadBits(data, pos, kQuintBits[i], end))
+             << shift;
+        pos += kQuintBits[i];
+        shift += kQuintBits[i];
+      }
+      int quints[3];
+      if (((q >> 1) & 3) == 3 && ((q >> 5) & 3) == 0) {
+        const int q0 = q & 1;
+        quints[2] =
+            (q0 << 2) | ((((q >> 4) & 1) & ~q0 & 1) << 1) |
+            (((q >> 3) & 1) & ~q0 & 1);
+        quints[1] = 4;
+        quints[0] = 4;
+      } else {
+        int c;
+        if (((q >> 1) & 3) == 3) {
+          quints[2] = 4;
+          c = (((q >> 3) & 3) << 3) | ((~(q >> 5) & 3) << 1) | (q & 1);
+        } else {
+          quints[2] = (q >> 5) & 3;
+          c = q & 0x1F;
+        }
+        if ((c & 7) == 5) {
+          quints[1] = 4;
+          quints[0] = (c >> 3) & 3;
+        } else {
+          quints[1] = (c >> 3) & 3;
+          quints[0] = c & 7;
+        }
+      }
+      for (int i = 0; i < 3 && first + i < count; ++i)
+        values[first + i] = (quints[i] << bits) | low[i];
+    }
+  } else {
+    for (int i = 0; i < count; ++i) {
+      values[i] = static_cast<int>(ReadBits(data, pos, bits, end));
+      pos += bits;
+    }
+  }
+}
+
+// Replicates the |bits| low bits of |value| to fill |target_bits| bits.
+static int ReplicateBits(int value, int bits, int target_bits) {
+  int result = 0;
+  int filled = 0;
+  while (filled < target_bits) {
+    result = (result << bits) | value;
+    filled += bits;
+  }
+  return result >> (filled - target_bits);
+}
+
+// Unquantizes a color endpoint value to 8 bits.
+static int UnquantizeColor(int value, const IseRange& range) {
+  const int bits = range.bits;
+  if (!range.trits && !range.quints)
+    return ReplicateBits(value, bits, 8);
+  // The low bit of |value| is inverted into all bits of the result, and the
+  // others are spread over it.
+  const int a = (value & 1) ? 0x1FF : 0;
+  const int digit = value >> bits;
+  const int m = (value >> 1) & ((1 << (bits - 1)) - 1);
+  int b = 0;
+  int c = 0;
+  if (range.trits) {
+    switch (bits) {
+      case 1: c = 204; break;
+      case 2: b = (m << 8) | (m << 4) | (m << 2) | (m << 1); c = 93; break;
+      case 3: b = (m << 7) | (m << 2) | m; c = 44; break;
+      case 4: b = (m << 6) | m; c = 22; break;
+      case 5: b = (m << 5) | (m >> 2); c = 11; break;
+      default: b = (m << 4) | (m >> 4); c = 5; break;
+    }
+  } else {
+    switch (bits) {
+      case 1: c = 113; break;
+      case 2: b = (m << 8) | (m << 3) | (m << 2); c = 54; break;
+      case 3: b = (m << 7) | (m << 1) | (m >> 1); c = 26; break;
+      case 4: b = (m << 6) | (m >> 1); c = 13; break;
+      default: b = (m << 5) | (m >> 3); c = 6; break;
+    }
+  }
+  const int t = (digit * c + b) ^ a;
+  return (a & 0x80) | (t >> 2);
+}
+
+// Unquantizes a weight to the range [0, 64].
+static int UnquantizeWeight(int value, const IseRange& range) {
+  const int bits = range.bits;
+  int result;
+  if (!range.trits && !range.quints) {
+    result = ReplicateBits(value, bits, 6);
+  } else if (bits == 0) {
+    static const int kTrits[3] = { 0, 32, 63 };
+    static const int kQuints[5] = { 0, 16, 32, 47, 63 };
+    result = range.trits ? kTrits[value] : kQuints[value];
+  } else {
+    const int a = (value & 1) ? 0x7F : 0;
+    const int digit = value >> bits;
+    const int m = (value >> 1) & ((1 << (bits - 1)) - 1);
+    int b = 0;
+    int c;
+    if (range.trits) {
+      switch (bits) {
+        case 1: c = 50; break;
+        case 2: b = (m << 6) | (m << 2) | m; c = 23; break;
+        default: b = (m << 5) | m; c = 11; break;
+      }
+    } else {
+      switch (bits) {
+        case 1: c = 28; break;
+        default: b = (m << 6) | (m << 1); c = 13; break;
+      }
+    }
+    const int t = (digit * c + b) ^ a;
+    result = (a & 0x20) | (t >> 2);
+  }
+  return result > 32 ? result + 1 : result;
+}
+
+// Decodes the block mode at the bottom of a block. Returns false if the mode
+// is reserved.
+static bool DecodeBlockMode(uint32 mode, int* grid_width, int* grid_height,
+                            int* weight_range, bool* dual_plane) {
+  int r;
+  const int a = (mode >> 5) & 3;
+  int b = (mode >> 7) & 3;
+  bool high_precision = (mode >> 9) & 1;
+  *dual_plane = (mode >> 10) & 1;
+  if (mode & 3) {
+    r = static_cast<int>(((mode >> 4) & 1) | ((mode & 3) << 1));
+    switch ((mode >> 2) & 3) {
+      case 0: *grid_width = b + 4; *grid_height = a + 2; break;
+      case 1: *grid_width = b + 8; *grid_height = a + 2; break;
+      case 2: *grid_width = a + 2; *grid_height = b + 8; break;
+      default:
+        b &= 1;
+        if (mode & 0x100) {
+          *grid_width = b + 2;
+          *grid_height = a + 2;
+        } else {
+          *grid_width = a + 2;
+          *grid_height = b + 6;
+        }
+        break;
+    }
+  } else {
+    if ((mode & 0xF) == 0)
+      return false;
+    r = static_cast<int>(((mode >> 4) & 1) | (((mode >> 2) & 3) << 1));
+    switch ((mode >> 7) & 3) {
+      case 0: *grid_width = 12; *grid_height = a + 2; break;
+      case 1: *grid_width = a + 2; *grid_height = 12; break;
+      case 2:
+        *grid_width = a + 6;
+        *grid_height = static_cast<int>((mode >> 9) & 3) + 6;
+        high_precision = false;
+        *dual_plane = false;
+        break;
+      default:
+        if (a == 0) {
+          *grid_width = 6;
+          *grid_height = 10;
+        } else if (a == 1) {
+          *grid_width = 10;
+          *grid_height = 6;
+        } else {
+          return false;
+        }
+        break;
+    }
+  }
+  *weight_range = r - 2 + (high_precision ? 6 : 0);
+  return true;
+}
+
+// The hash that selects the partition of each pixel, from the ASTC
+// specification.
+static uint32 HashPartitionSeed(uint32 p) {
+  p ^= p >> 15;
+  p -= p << 17;
+  p += p << 7;
+  p += p << 4;
+  p ^= p >> 5;
+  p += p << 16;
+  p ^= p >> 7;
+  p ^= p >> 3;
+  p ^= p << 6;
+  p ^= p >> 17;
+  return p;
+}
+
+static int SelectPartition(int seed, int x, int y, int partition_count,
+                           bool small_block) {
+  if (small_block) {
+    x <<= 1;
+    y <<= 1;
+  }
+  seed += (partition_count - 1) * 1024;
+  const uint32 rnum = HashPartitionSeed(static_cast<uint32>(seed));
+  int seeds[8];
+  for (int i = 0; i < 8; ++i) {
+    seeds[i] = static_cast<int>((rnum >> (4 * i)) & 0xF);
+    seeds[i] *= seeds[i];
+  }
+  int sh1;
+  int sh2;
+  if (seed & 1) {
+    sh1 = (seed & 2) ? 4 : 5;
+    sh2 = partition_count == 3 ? 6 : 5;
+  } else {
+    sh1 = partition_count == 3 ? 6 : 5;
+    sh2 = (seed & 2) ? 4 : 5;
+  }
+  // The z terms of the specification vanish for 2D blocks.
+  int a = (seeds[0] >> sh1) * x + (seeds[1] >> sh2) * y +
+          static_cast<int>(rnum >> 14);
+  int b = (seeds[2] >> sh1) * x + (seeds[3] >> sh2) * y +
+          static_cast<int>(rnum >> 10);
+  int c = (seeds[4] >> sh1) * x + (seeds[5] >> sh2) * y +
+          static_cast<int>(rnum >> 6);
+  int d = (seeds[6] >> sh1) * x + (seeds[7] >> sh2) * y +
+          static_cast<int>(rnum >> 2);
+  a &= 0x3F;
+  b &= 0x3F;
+  c &= 0x3F;
+  d &= 0x3F;
+  if (partition_count < 4)
+    d = 0;
+  if (partition_count < 3)
+    c = 0;
+  if (a >= b && a >= c && a >= d)
+    return 0;
+  else if (b >= c && b >= d)
+    return 1;
+  else if (c >= d)
+    return 2;
+  return 3;
+}
+
+// Moves precision from |a| to |b| for the base+offset endpoint modes, leaving
+// |a| as a signed 6-bit offset.
+static inline void TransferBitSigned(int* a, int* b) {
+  *b = (*b >> 1) | (*a & 0x80);
+  *a = (*a >> 1) & 0x3F;
+  if (*a & 0x20)
+    *a -= 0x40;
+}
+
+static inline void SetEndpoint(int* e, int r, int g, int b, int a) {
+  e[0] = ClampToByte(r);
+  e[1] = ClampToByte(g);
+  e[2] = ClampToByte(b);
+  e[3] = ClampToByte(a);
+}
+
+// Sets an endpoint with blue contraction, which the RGB direct and
+// base+offset modes use to gain precision for colors with similar channels.
+static inline void SetBlueContractedEndpoint(int* e, int r, int g, int b,
+                                             int a) {
+  r = ClampToByte(r);
+  g = ClampToByte(g);
+  b = ClampToByte(b);
+  SetEndpoint(e, (r + b) >> 1, (g + b) >> 1, b, a);
+}
+
+// Computes the endpoints of an LDR color endpoint mode from its unquantized
+// values |v|. Returns false for HDR modes.
+static bool DecodeEndpoints(int mode, const int* v, int* e0, int* e1) {
+  int v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+  int v4 = v[4], v5 = v[5], v6 = v[6], v7 = v[7];
+  switch (mode) {
+    case 0:
+      SetEndpoint(e0, v0, v0, v0, 255);
+      SetEndpoint(e1, v1, v1, v1, 255);
+      return true;
+    case 1: {
+      const int l0 = (v0 >> 2) | (v1 & 0xC0);
+      const int l1 = std::min(255, l0 + (v1 & 0x3F));
+      SetEndpoint(e0, l0, l0, l0, 255);
+      SetEndpoint(e1, l1, l1, l1, 255);
+      return true;
+    }
+    case 4:
+      SetEndpoint(e0, v0, v0, v0, v2);
+      SetEndpoint(e1, v1, v1, v1, v3);
+      return true;
+    case 5:
+      TransferBitSigned(&v1, &v0);
+      TransferBitSigned(&v3, &v2);
+      SetEndpoint(e0, v0, v0, v0, v2);
+      SetEndpoint(e1, v0 + v1, v0 + v1, v0 + v1, v2 + v3);
+      return true;
+    case 6:
+      SetEndpoint(e0, (v0 * v3) >> 8, (v1 * v3) >> 8, (v2 * v3) >> 8, 255);
+      SetEndpoint(e1, v0, v1, v2, 255);
+      return true;
+    case 8:
+    case 12: {
+      const bool has_alpha = mode == 12;
+      const int a0 = has_alpha ? v6 : 255;
+      const int a1 = has_alpha ? v7 : 255;
+      if (v1 + v3 + v5 >= v0 + v2 + v4) {
+        SetEndpoint(e0, v0, v2, v4, a0);
+        SetEndpoint(e1, v1, v3, v5, a1);
+      } else {
+        SetBlueContractedEndpoint(e0, v1, v3, v5, a1);
+        SetBlueContractedEndpoint(e1, v0, v2, v4, a0);
+      }
+      return true;
+    }
+    case 9:
+    case 13: {
+      const bool has_alpha = mode == 13;
+      TransferBitSigned(&v1, &v0);
+      TransferBitSigned(&v3, &v2);
+      TransferBitSigned(&v5, &v4);
+      if (has_alpha) {
+        TransferBitSigned(&v7, &v6);
+      } else {
+        v6 = 255;
+        v7 = 0;
+      }
+      if (v1 + v3 + v5 >= 0) {
+        SetEndpoint(e0, v0, v2, v4, v6);
+        SetEndpoint(e1, v0 + v1, v2 + v3, v4 + v5, v6 + v7);
+      } else {
+        SetBlueContractedEndpoint(e0, v0 + v1, v2 + v3, v4 + v5, v6 + v7);
+        SetBlueContractedEndpoint(e1, v0, v2, v4, v6);
+      }
+      return true;
+    }
+    case 10:
+      SetEndpoint(e0, (v0 * v3) >> 8, (v1 * v3) >> 8, (v2 * v3) >> 8, v4);
+      SetEndpoint(e1, v0, v1, v2, v5);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Fills a block with the error color.
+static void SetAstcErrorBlock(uint32 block_width, uint32 block_height,
+                              uint8* pixels) {
+  for (uint32 i = 0; i < block_width * block_height; ++i)
+    SetPixel(pixels + i * 4U, 255, 0, 255, 255);
+}
+
+static void DecodeAstcBlock(const uint8* block, uint32 block_width,
+                            uint32 block_height, uint8* pixels) {
+  const uint32 mode = ReadBits(block, 0, 11, 128);
+  if ((mode & 0x1FF) == 0x1FC) {
+    // A void-extent block has a single 16-bit color. Bit 9 marks HDR colors.
+    if (mode & 0x200) {
+      SetAstcErrorBlock(block_width, block_height, pixels);
+      return;
+    }
+    for (uint32 i = 0; i < block_width * block_height; ++i) {
+      for (int c = 0; c < 4; ++c)
+        pixels[i * 4U + c] = block[9 + 2 * c];
+    }
+    return;
+  }
+
+  int grid_width;
+  int grid_height;
+  int weight_range;
+  bool dual_plane;
+  if (!DecodeBlockMode(mode, &grid_width, &grid_height, &weight_range,
+                       &dual_plane) ||
+      grid_width > static_cast<int>(block_width) ||
+      grid_height > static_cast<int>(block_height)) {
+    SetAstcErrorBlock(block_width, block_height, pixels);
+    return;
+  }
+  const int plane_count = dual_plane ? 2 : 1;
+  const int partition_count = static_cast<int>(ReadBits(block, 11, 2, 128)) + 1;
+  const int weight_count = grid_width * grid_height * plane_count;
+  const IseRange& weight_ise = kIseRanges[weight_range];
+  const int weight_bits = GetIseBitCount(weight_count, weight_ise);
+  if (weight_count > 64 || weight_bits < 24 || weight_bits > 96 ||
+      (dual_plane && partition_count == 4)) {
+    SetAstcErrorBlock(block_width, block_height, pixels);
+    return;
+  }
+
+  // Color endpoint modes.
+  int modes[4];
+  int seed = 0;
+  int color_start;
+  int below_weights = 128 - weight_bits;
+  if (partition_count == 1) {
+    modes[0] = static_cast<int>(ReadBits(block, 13, 4, 128));
+    color_start = 17;
+  } else {
+    seed = static_cast<int>(ReadBits(block, 13, 10, 128));
+    uint32 encoded = ReadBits(block, 23, 6, 128);
+    color_start = 29;
+    if ((encoded & 3) == 0) {
+      for (int i = 0; i < partition_count; ++i)
+        modes[i] = static_cast<int>(encoded >> 2);
+    } else {
+      // The modes of the partitions are in the same class or the next one.
+      // The bits that do not fit are stored just below the weights.
+      const int extra_bits = 3 * partition_count - 4;
+      below_weights -= extra_bits;
+      encoded |= ReadBits(block, below_weights, extra_bits, 128) << 6;
+      const int base_class = static_cast<int>(encoded & 3) - 1;
+      encoded >>= 2;
+      for (int i = 0; i < partition_count; ++i) {
+        modes[i] = ((static_cast<int>((encoded >> i) & 1) + base_class) << 2) |
+                   static_cast<int>(
+                       (encoded >> (partition_count + 2 * i)) & 3);
+      }
+    }
+  }
+  int plane2_component = -1;
+  if (dual_plane) {
+    below_weights -= 2;
+    plane2_component = static_cast<int>(ReadBits(block, below_weights, 2, 128));
+  }
+
+  // Color endpoint values use the largest range that fits the space left.
+  int color_count = 0;
+  for (int i = 0; i < partition_count; ++i)
+    color_count += ((modes[i] >> 2) + 1) * 2;
+  const int color_bits = below_weights - color_start;
+  int color_range = static_cast<int>(ARRAYSIZE(kIseRanges)) - 1;
+  while (color_range >= 0 &&
+         GetIseBitCount(color_count, kIseRanges[color_range]) > color_bits)
+    --color_range;
+  if (color_count > 18 || color_range < kMinColorRange) {
+    SetAstcErrorBlock(block_width, block_height, pixels);
+    return;
+  }
+  int colors[18];
+  DecodeIntegerSequence(block, color_start, below_weights, color_count,
+                        kIseRanges[color_range], colors);
+  for (int i = 0; i < color_count; ++i)
+    colors[i] = UnquantizeColor(colors[i], kIseRanges[color_range]);
+  int endpoints[4][2][4];
+  const int* values = colors;
+  for (int i = 0; i < partition_count; ++i) {
+    int mode_values[8] = { 0 };
+    const int count = ((modes[i] >> 2) + 1) * 2;
+    memcpy(mode_values, values, count * sizeof(int));
+    values += count;
+    if (!DecodeEndpoints(modes[i], mode_values, endpoints[i][0],
+                         endpoints[i][1])) {
+      SetAstcErrorBlock(block_width, block_height, pixels);
+      return;
+    }
+  }
+
+  // Weights, read from the bit-reversed block.
+  uint8 reversed[16] = { 0 };
+  for (int i = 0; i < 128; ++i) {
+    if (block[i >> 3] & (1 << (i & 7)))
+      reversed[(127 - i) >> 3] |= static_cast<uint8>(1 << ((127 - i) & 7));
+  }
+  int weights[64];
+  DecodeIntegerSequence(reversed, 0, weight_bits, weight_count, weight_ise,
+                        weights);
+  for (int i = 0; i < weight_count; ++i)
+    weights[i] = UnquantizeWeight(weights[i], weight_ise);
+
+  // Infill the weights of each pixel from the grid, and interpolate.
+  const int ds = (1024 + static_cast<int>(block_width) / 2) /
+                 (static_cast<int>(block_width) - 1);
+  const int dt = (1024 + static_cast<int>(block_height) / 2) /
+                 (static_cast<int>(block_height) - 1);
+  const bool small_block = block_width * block_height < 31U;
+  for (int y = 0; y < static_cast<int>(block_height); ++y) {
+    for (int x = 0; x < static_cast<int>(block_width); ++x) {
+      const int gs = (ds * x * (grid_width - 1) + 32) >> 6;
+      const int gt = (dt * y * (grid_height - 1) + 32) >> 6;
+      const int fs = gs & 0xF;
+      const int ft = gt & 0xF;
+      const int v0 = (gs >> 4) + (gt >> 4) * grid_width;
+      const int w11 = (fs * ft + 8) >> 4;
+      const int factors[4] = { 16 - fs - ft + w11, fs - w11, ft - w11, w11 };
+      const int offsets[4] = { 0, 1, grid_width, grid_width + 1 };
+      int pixel_weights[2] = { 0, 0 };
+      for (int p = 0; p < plane_count; ++p) {
+        int sum = 8;
+        for (int i = 0; i < 4; ++i) {
+          const int index = (v0 + offsets[i]) * plane_count + p;
+          if (factors[i] && index < weight_count)
+            sum += weights[index] * factors[i];
+        }
+        pixel_weights[p] = sum >> 4;
+      }
+      const int partition =
+          partition_count > 1
+              ? SelectPartition(seed, x, y, partition_count, small_block)
+              : 0;
+      uint8* pixel = pixels + (y * block_width + x) * 4U;
+      for (int c = 0; c < 4; ++c) {
+        const int w = pixel_weights[c == plane2_component ? 1 : 0];
+        const int c0 = endpoints[partition][0][c] * 257;
+        const int c1 = endpoints[partition][1][c] * 257;
+        pixel[c] = static_cast<uint8>(((c0 * (64 - w) + c1 * w + 32) >> 6) >> 8);
+      }
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Image decoding.
+//
+//-----------------------------------------------------------------------------
+
+// The size and decoder of the blocks of a format.
+struct BlockFormat {
+  Image::Format format;
+  uint32 block_width;
+  uint32 block_height;
+  size_t block_size;
+  BlockDecoder decoder;
+};
+
+static const BlockFormat kBlockFormats[] = {
+  { Image::kEtc2Rgb, 4U, 4U, 8U, DecodeEtc2RgbBlock },
+  { Image::kEtc2Rgba1, 4U, 4U, 8U, DecodeEtc2Rgba1Block },
+  { Image::kEtc2Rgba, 4U, 4U, 16U, DecodeEtc2RgbaBlock },
+  { Image::kEacR11, 4U, 4U, 8U, DecodeEacR11Block },
+  { Image::kEacRg11, 4U, 4U, 16U, DecodeEacRg11Block },
+  { Image::kAstc4x4Rgba, 4U, 4U, 16U, DecodeAstcBlock },
+  { Image::kAstc5x4Rgba, 5U, 4U, 16U, DecodeAstcBlock },
+  { Image::kAstc5x5Rgba, 5U, 5U, 16U, DecodeAstcBlock },
+  { Image::kAstc6x5Rgba, 6U, 5U, 16U, DecodeAstcBlock },
+  { Image::kAstc6x6Rgba, 6U, 6U, 16U, DecodeAstcBlock },
+  { Image::kAstc8x5Rgba, 8U, 5U, 16U, DecodeAstcBlock },
+  { Image::kAstc8x6Rgba, 8U, 6U, 16U, DecodeAstcBlock },
+  { Image::kAstc8x8Rgba, 8U, 8U, 16U, DecodeAstcBlock },
+  { Image::kAstc10x5Rgba, 10U, 5U, 16U, DecodeAstcBlock },
+  { Image::kAstc10x6Rgba, 10U, 6U, 16U, DecodeAstcBlock },
+  { Image::kAstc10x8Rgba, 10U, 8U, 16U, DecodeAstcBlock },
+  { Image::kAstc10x10Rgba, 10U, 10U, 16U, DecodeAstcBlock },
+  { Image::kAstc12x10Rgba, 12U, 10U, 16U, DecodeAstcBlock },
+  { Image::kAstc12x12Rgba, 12U, 12U, 16U, DecodeAstcBlock },
+};
+
+static const BlockFormat* FindBlockFormat(Image::Format format) {
+  for (size_t i = 0; i < ARRAYSIZE(kBlockFormats); ++i) {
+    if (kBlockFormats[i].format == format)
+      return &kBlockFormats[i];
+  }
+  return NULL;
+}
+
+}  // anonymous namespace
+
+bool IsBlockDecodingSupported(Image::Format format) {
+  return FindBlockFormat(format) != NULL;
+}
+
+Image::Format GetBlockDecodedFormat(Image::Format format) {
+  switch (format) {
+    case Image::kEtc2Rgb:
+      return Image::kRgb888;
+    case Image::kEacR11:
+      return Image::kR8;
+    case Image::kEacRg11:
+      return Image::kRg8;
+    default:
+      return IsBlockDecodingSupported(format) ? Image::kRgba8888 : format;
+  }
+}
+
+const ImagePtr DecodeCompressedImage(const ImagePtr& image, bool is_wipeable,
+                                     const base::AllocatorPtr& allocator) {
+  const BlockFormat* block_format =
+      image.Get() ? FindBlockFormat(image->GetFormat()) : NULL;
+  if (!block_format || !image->GetData().Get() ||
+      !image->GetData()->GetData())
+    return ImagePtr();
+
+  const uint32 width = image->GetWidth();
+  const uint32 height = image->GetHeight();
+  const uint32 depth = std::max(1U, image->GetDepth());
+  const Image::Format format = GetBlockDecodedFormat(image->GetFormat());
+  const size_t src_slice_size =
+      Image::ComputeDataSize(image->GetFormat(), width, height);
+  if (image->GetDataSize() < src_slice_size * depth) {
+    LOG(ERROR) << "Compressed image data is too small to decode";
+    return ImagePtr();
+  }
+
+  ImagePtr result(new(allocator) Image);
+  const base::AllocatorPtr& use_allocator = result->GetAllocator();
+  const size_t dst_slice_size = Image::ComputeDataSize(format, width, height);
+  uint8* buffer = reinterpret_cast<uint8*>(
+      use_allocator->AllocateMemory(dst_slice_size * depth));
+  base::DataContainerPtr container = base::DataContainer::Create<uint8>(
+      buffer,
+      std::bind(base::DataContainer::AllocatorDeleter, use_allocator,
+                std::placeholders::_1),
+      is_wipeable, use_allocator);
+  if (image->GetType() == Image::kArray) {
+    if (image->GetDimensions() == Image::k3d)
+      result->SetArray(format, width, height, depth, container);
+    else
+      result->SetArray(format, width, height, container);
+  } else if (image->GetDimensions() == Image::k3d) {
+    result->Set(format, width, height, depth, container);
+  } else {
+    result->Set(format, width, height, container);
+  }
+
+  const uint32 bw = block_format->block_width;
+  const uint32 bh = block_format->block_height;
+  const uint32 dst_components =
+      static_cast<uint32>(Image::GetNumComponentsForFormat(format));
+  const uint8* src = image->GetData()->GetData<uint8>();
+  uint8* dst = buffer;
+  uint8 pixels[12 * 12 * 4];
+  for (uint32 z = 0; z < depth; ++z) {
+    uint8* dst_slice = dst + z * dst_slice_size;
+    for (uint32 by = 0; by < height; by += bh) {
+      for (uint32 bx = 0; bx < width; bx += bw) {
+        block_format->decoder(src, bw, bh, pixels);
+        src += block_format->block_size;
+        // Copy the pixels that are inside the image.
+        const uint32 copy_width = std::min(bw, width - bx);
+        const uint32 copy_height = std::min(bh, height - by);
+        for (uint32 y = 0; y < copy_height; ++y) {
+          const uint8* pixel = pixels + y * bw * 4U;
+          uint8* out = dst_slice + ((by + y) * width + bx) * dst_components;
+          for (uint32 x = 0; x < copy_width; ++x) {
+            memcpy(out, pixel, dst_components);
+            pixel += 4;
+            out += dst_components;
+          }
+        }
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,58 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_BLOCKDECODERS_H_
+#define ION_IMAGE_BLOCKDECODERS_H_
+
+// This file contains software decoders for the ETC2, EAC and ASTC compressed
+// formats. They are meant for fallback paths, when the local OpenGL
+// implementation cannot upload these formats, and for tools that need to read
+// the pixels, so they favor simplicity over speed. Only the LDR profile of
+// ASTC is supported; blocks that use HDR endpoints, and blocks that are not
+// valid, decode to magenta as the ASTC specification requires. There are no
+// encoders for these formats in Ion.
+
+#include "ion/base/allocator.h"
+#include "ion/gfx/image.h"
+
+namespace ion {
+namespace image {
+
+// Returns whether DecodeCompressedImage() can decode images of the given
+// format: kEtc2Rgb, kEtc2Rgba1, kEtc2Rgba, kEacR11, kEacRg11 and all of the
+// ASTC formats.
+ION_API bool IsBlockDecodingSupported(gfx::Image::Format format);
+
+// Returns the format of the images that DecodeCompressedImage() returns for
+// images of |format|: kRgb888 for kEtc2Rgb, kR8 for kEacR11, kRg8 for
+// kEacRg11 and kRgba8888 for the other supported formats. The 11-bit EAC
+// channels are rounded to 8 bits. Returns |format| for unsupported formats.
+ION_API gfx::Image::Format GetBlockDecodedFormat(gfx::Image::Format format);
+
+// Returns an uncompressed copy of |image|, or a NULL pointer if it has no data
+// or its format is not supported. Each slice of 3D images and arrays is
+// decoded separately. The |is_wipeable| flag is passed to the DataContainer
+// for the new Image, which is allocated with |allocator|, or the default
+// allocator if it is NULL.
+ION_API const gfx::ImagePtr DecodeCompressedImage(
+    const gfx::ImagePtr& image, bool is_wipeable,
+    const base::AllocatorPtr& allocator);
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_BLOCKDECODERS_H_
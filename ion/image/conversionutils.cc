@@ -19,10 +19,23 @@ limitations under the License.
 
 #include "ion/base/logging.h"  // Ensures Ion logging code is used.
 
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
 #include "base/port.h"
 #include "ion/base/allocationmanager.h"
+#include "ion/base/arenaallocator.h"
 #include "ion/base/datacontainer.h"
-#include "ion/math/range.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/samplingallocationtracker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/image/blockdecoders.h"
+#include "ion/image/jpegencoder.h"
+#include "ion/image/pixelkernels.h"
+#include "ion/image/resampleutils.h"
 #include "third_party/image_compression/image_compression/public/compressed_image.h"
 #include "third_party/image_compression/image_compression/public/dxtc_compressor.h"
 #include "third_party/image_compression/image_compression/public/etc_compressor.h"
@@ -51,8 +64,6 @@ namespace image {
 
 using gfx::Image;
 using gfx::ImagePtr;
-using math::Point2f;
-using math::Range2f;
 
 namespace {
 
@@ -60,6 +71,13 @@ namespace {
 // ConvertFromExternalImageData() for detaied specs of this format.
 const size_t kIonRawImageHeaderSizeInBytes = 16;
 
+// DXTC and ETC compress each 4x4 block of pixels independently and store the
+// blocks in row order, so a strip of whole block rows compresses to a
+// contiguous part of the compressed image. This is the number of block rows in
+// each strip that is compressed in parallel.
+const uint32 kCompressionBlockSize = 4U;
+const uint32 kCompressionStripBlockRows = 16U;
+
 //-----------------------------------------------------------------------------
 //
 // Basic helper functions.
@@ -158,29 +176,110 @@ static const ImagePtr DecompressWithCompressor(
   return result_image;
 }
 
-// Compresses an image to the target_format.
-static const ImagePtr CompressImage(const Image& image,
-                                    Image::Format target_format,
-                                    bool is_wipeable,
-                                    const base::AllocatorPtr& allocator) {
+// Returns a new Compressor for the compressed target_format.
+static image_codec_compression::Compressor* NewCompressor(
+    Image::Format target_format) {
   if (target_format == Image::kEtc1) {
-    image_codec_compression::EtcCompressor compressor;
-    compressor.SetCompressionStrategy(
+    image_codec_compression::EtcCompressor* compressor =
+        new image_codec_compression::EtcCompressor;
+    compressor->SetCompressionStrategy(
         image_codec_compression::EtcCompressor::kHeuristic);
-    return CompressWithCompressor(image, target_format, &compressor,
-                                  is_wipeable, allocator);
+    return compressor;
   } else if (target_format == Image::kPvrtc1Rgba2) {
-    image_codec_compression::PvrtcCompressor compressor;
-    return CompressWithCompressor(image, target_format, &compressor,
-                                  is_wipeable, allocator);
+    return new image_codec_compression::PvrtcCompressor;
   } else {
     DCHECK(target_format == Image::kDxt1 || target_format == Image::kDxt5);
-    image_codec_compression::DxtcCompressor compressor;
-    return CompressWithCompressor(image, target_format, &compressor,
-                                  is_wipeable, allocator);
+    return new image_codec_compression::DxtcCompressor;
   }
 }
 
+// Compresses an image to the DXTC or ETC target_format by compressing strips
+// of block rows in parallel on the scheduler's threads and concatenating the
+// results. Returns a NULL Image if there are any problems.
+static const ImagePtr CompressInStrips(const Image& image,
+                                       Image::Format compressed_format,
+                                       bool is_wipeable,
+                                       const base::AllocatorPtr& allocator,
+                                       base::TaskScheduler* scheduler) {
+  using image_codec_compression::CompressedImage;
+  using image_codec_compression::Compressor;
+  const CompressedImage::Format format =
+      ImageHasAlpha(image) ? CompressedImage::kRGBA : CompressedImage::kRGB;
+  const uint32 width = image.GetWidth();
+  const uint32 height = image.GetHeight();
+  const size_t row_size =
+      Image::ComputeDataSize(image.GetFormat(), width, 1U);
+  const uint32 strip_height =
+      kCompressionStripBlockRows * kCompressionBlockSize;
+  const size_t strip_count = (height + strip_height - 1U) / strip_height;
+  const uint8* uncompressed_data =
+      reinterpret_cast<const uint8*>(image.GetData()->GetData());
+
+  // Each range of strips uses its own Compressor, since they are not
+  // thread-safe. A char vector is used since a bool vector cannot be written
+  // from multiple threads.
+  std::vector<CompressedImage> strips(strip_count);
+  std::vector<char> succeeded(strip_count, 0);
+  scheduler->ParallelFor(
+      0U, strip_count, 1U,
+      [&](size_t begin, size_t end) {
+        std::unique_ptr<Compressor> compressor(
+            NewCompressor(compressed_format));
+        for (size_t i = begin; i < end; ++i) {
+          const uint32 top = static_cast<uint32>(i) * strip_height;
+          const uint32 rows = std::min(strip_height, height - top);
+          succeeded[i] = compressor->Compress(
+              format, rows, width, 0, uncompressed_data + top * row_size,
+              &strips[i]);
+        }
+      });
+
+  size_t data_size = 0U;
+  uint32 compressed_height = 0U;
+  for (size_t i = 0; i < strip_count; ++i) {
+    if (!succeeded[i])
+      return ImagePtr();
+    data_size += strips[i].GetDataSize();
+    compressed_height += strips[i].GetMetadata().compressed_height;
+  }
+
+  // Stitch the strips together.
+  ImagePtr result(new(allocator) Image);
+  base::DataContainerPtr container = base::DataContainer::CreateAndCopy<uint8>(
+      NULL, data_size, is_wipeable, result->GetAllocator());
+  uint8* compressed_data = container->GetMutableData<uint8>();
+  for (size_t i = 0; i < strip_count; ++i) {
+    memcpy(compressed_data, strips[i].GetData(), strips[i].GetDataSize());
+    compressed_data += strips[i].GetDataSize();
+  }
+  result->Set(compressed_format, strips[0].GetMetadata().compressed_width,
+              compressed_height, container);
+  return result;
+}
+
+// Compresses an image to the target_format, in parallel strips if scheduler is
+// non-NULL and the format allows it.
+static const ImagePtr CompressImage(const Image& image,
+                                    Image::Format target_format,
+                                    bool is_wipeable,
+                                    const base::AllocatorPtr& allocator,
+                                    base::TaskScheduler* scheduler) {
+  // PVRTC interpolates the colors of neighboring blocks and stores the blocks
+  // of the whole image in Morton order, so strips cannot be compressed
+  // independently. Compressing tiles that overlap their neighbors by a block
+  // and interleaving the inner blocks of the results would work, but PVRTC
+  // images are small power-of-two squares in practice, so it is compressed on
+  // the calling thread.
+  if (scheduler && target_format != Image::kPvrtc1Rgba2 &&
+      image.GetHeight() > kCompressionStripBlockRows * kCompressionBlockSize)
+    return CompressInStrips(image, target_format, is_wipeable, allocator,
+                            scheduler);
+  std::unique_ptr<image_codec_compression::Compressor> compressor(
+      NewCompressor(target_format));
+  return CompressWithCompressor(image, target_format, compressor.get(),
+                                is_wipeable, allocator);
+}
+
 // Decompresses an image to the appropriate format.
 static const ImagePtr DecompressImage(const Image& image, bool is_wipeable,
                                       const base::AllocatorPtr& allocator) {
@@ -215,123 +314,148 @@ static bool PngHasTransparencyChunk(const uint8* png_data, size_t data_size) {
   return has_trns_chunk;
 }
 
-// Decodes |data| to an Image using lodepng. Supported formats: PNG. |data_size|
-// is the number of bytes in |data|. Returns NULL on failure.
-static const ImagePtr DataToImageLodePng(const void* data,
-                                         size_t data_size,
-                                         bool flip_vertically,
-                                         bool is_wipeable,
-                                         const base::AllocatorPtr& allocator) {
-  ImagePtr image;
-  uint32 width = 0, height = 0;
-  const uint8* data_in = static_cast<const uint8*>(data);
-  LodePNGState state;
-  lodepng_state_init(&state);
-  static const unsigned kLodePngSuccess = 0;
-  unsigned lodepng_error_code = lodepng_inspect(
-      &width, &height, &state, data_in, data_size);
-  if (lodepng_error_code != kLodePngSuccess) {
-    lodepng_state_cleanup(&state);
-    return image;
+// Pixels decoded from external image data, which may be owned by a decoder's
+// buffer or point into the encoded data.
+struct DecodedPixels {
+  DecodedPixels()
+      : pixels(NULL),
+        width(0U),
+        height(0U),
+        format(Image::kInvalid),
+        byte_swap_required(false),
+        owned_buffer(NULL),
+        free_buffer(NULL) {}
+  ~DecodedPixels() {
+    if (owned_buffer)
+      free_buffer(owned_buffer);
   }
-  uint8* data_out = NULL;
 
+  const uint8* pixels;
+  uint32 width;
+  uint32 height;
+  Image::Format format;
+  // Whether each pixel of the "ION raw" format needs its bytes swapped.
+  bool byte_swap_required;
+  void* owned_buffer;
+  void (*free_buffer)(void* buffer);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DecodedPixels);
+};
+
+// Returns the format that lodepng decodes to for the PNG |data|, whose header
+// it already read into |state|.
+static Image::Format GetLodePngFormat(const LodePNGState& state,
+                                      const uint8* data, size_t data_size,
+                                      LodePNGColorType* colortype_out) {
   LodePNGColorType colortype = state.info_png.color.colortype;
   if (colortype == LCT_PALETTE) {
-    colortype = PngHasTransparencyChunk(data_in, data_size) ?
+    colortype = PngHasTransparencyChunk(data, data_size) ?
         LCT_RGBA : LCT_RGB;
   } else if (colortype == LCT_GREY || colortype == LCT_RGB) {
     // Non-paletted images can also have a single transparent color defined via
     // tRNS chunk.
-    if (PngHasTransparencyChunk(data_in, data_size)) {
+    if (PngHasTransparencyChunk(data, data_size)) {
       colortype = (colortype == LCT_GREY) ? LCT_GREY_ALPHA : LCT_RGBA;
     }
   }
-  lodepng_error_code = lodepng_decode_memory(&data_out, &width, &height,
-                                             data_in, data_size, colortype, 8U);
-  lodepng_state_cleanup(&state);
-  if (lodepng_error_code == kLodePngSuccess) {
-    Image::Format format = Image::kRgba8888;
-    uint32 num_channels = 4U;
-    switch (colortype) {
-      case LCT_RGBA:
-        format = Image::kRgba8888;
-        num_channels = 4;
-        break;
-      case LCT_RGB:
-        format = Image::kRgb888;
-        num_channels = 3;
-        break;
-      case LCT_GREY_ALPHA:
-        format = Image::kLuminanceAlpha;
-        num_channels = 2;
-        break;
-      case LCT_GREY:
-        format = Image::kLuminance;
-        num_channels = 1;
-        break;
-      default:
-        DCHECK(false) << "Unexpected PNG color type";
-    }
-    image.Reset(new(allocator) Image);
-    image->Set(format, width, height,
-               base::DataContainer::CreateAndCopy<uint8>(
-                   data_out, width * height * num_channels, is_wipeable,
-                   image->GetAllocator()));
-    free(data_out);
-
-    if (flip_vertically) {
-      FlipImage(image);
-    }
+  *colortype_out = colortype;
+  switch (colortype) {
+    case LCT_RGBA:
+      return Image::kRgba8888;
+    case LCT_RGB:
+      return Image::kRgb888;
+    case LCT_GREY_ALPHA:
+      return Image::kLuminanceAlpha;
+    case LCT_GREY:
+      return Image::kLuminance;
+    default:
+      DCHECK(false) << "Unexpected PNG color type";
+      return Image::kRgba8888;
   }
-  return image;
 }
 
-// Decodes |data| to an Image using stblib. Supported formats: JPEG, PNG, TGA,
-// BMP, PSD, GIF, HDR, PIC. |data_size| is the number of bytes in |data|.
-// Returns NULL on failure.
-static const ImagePtr DataToImageStb(const void* data,
-                                     size_t data_size,
-                                     bool flip_vertically,
-                                     bool is_wipeable,
-                                     const base::AllocatorPtr& allocator) {
-  ImagePtr image;
-  int width, height, num_components;
-  if (stbi_uc* result_data = stbi_load_from_memory(
-          static_cast<const stbi_uc*>(data), static_cast<int>(data_size),
-          &width, &height, &num_components, 0)) {
-    // Handle Luminance, Luminance Alpha, RGB and RGBA results.
-    static Image::Format formats[4] = {
-      Image::kLuminance,
-      Image::kLuminanceAlpha,
-      Image::kRgb888,
-      Image::kRgba8888,
-    };
-    DCHECK_GE(num_components, 1) << "Unsupported component count in image.";
-    DCHECK_LE(num_components, 4) << "Unsupported component count in image.";
-    image.Reset(new(allocator) Image);
-    image->Set(formats[num_components - 1], width, height,
-               base::DataContainer::CreateAndCopy<uint8>(
-                   result_data, width * height * num_components, is_wipeable,
-                   image->GetAllocator()));
-    stbi_image_free(result_data);
+// Decodes |data| using lodepng. Supported formats: PNG. |data_size| is the
+// number of bytes in |data|. If |decoded| is NULL only the header is read.
+// Returns false on failure.
+static bool DecodeWithLodePng(const void* data, size_t data_size,
+                              DecodedPixels* decoded, uint32* width,
+                              uint32* height, Image::Format* format) {
+  const uint8* data_in = static_cast<const uint8*>(data);
+  LodePNGState state;
+  lodepng_state_init(&state);
+  static const unsigned kLodePngSuccess = 0;
+  unsigned lodepng_error_code = lodepng_inspect(
+      width, height, &state, data_in, data_size);
+  if (lodepng_error_code != kLodePngSuccess) {
+    lodepng_state_cleanup(&state);
+    return false;
   }
+  LodePNGColorType colortype;
+  *format = GetLodePngFormat(state, data_in, data_size, &colortype);
+  lodepng_state_cleanup(&state);
+  if (!decoded)
+    return true;
 
-  if (flip_vertically) {
-    FlipImage(image);
+  uint8* data_out = NULL;
+  lodepng_error_code = lodepng_decode_memory(&data_out, width, height,
+                                             data_in, data_size, colortype, 8U);
+  if (lodepng_error_code != kLodePngSuccess) {
+    free(data_out);
+    return false;
   }
-  return image;
+  decoded->pixels = data_out;
+  decoded->owned_buffer = data_out;
+  decoded->free_buffer = free;
+  return true;
 }
 
-// Decodes "ION raw" |data| to an Image (see conversionutils.h for format specs)
-// |data_size| is the number of bytes in |data|. Returns NULL on failure.
-static const ImagePtr DataToImageIonRaw(const void* data,
-                                        size_t data_size,
-                                        bool flip_vertically,
-                                        bool is_wipeable,
-                                        const base::AllocatorPtr& allocator) {
+// Decodes |data| using stblib. Supported formats: JPEG, PNG, TGA, BMP, PSD,
+// GIF, HDR, PIC. |data_size| is the number of bytes in |data|. If |decoded| is
+// NULL only the header is read. Returns false on failure.
+static bool DecodeWithStb(const void* data, size_t data_size,
+                          DecodedPixels* decoded, uint32* width,
+                          uint32* height, Image::Format* format) {
+  // Handle Luminance, Luminance Alpha, RGB and RGBA results.
+  static const Image::Format kFormats[4] = {
+    Image::kLuminance,
+    Image::kLuminanceAlpha,
+    Image::kRgb888,
+    Image::kRgba8888,
+  };
+  int w, h, num_components;
+  stbi_uc* result_data = NULL;
+  if (decoded) {
+    result_data = stbi_load_from_memory(
+        static_cast<const stbi_uc*>(data), static_cast<int>(data_size),
+        &w, &h, &num_components, 0);
+    if (!result_data)
+      return false;
+    decoded->pixels = result_data;
+    decoded->owned_buffer = result_data;
+    decoded->free_buffer = stbi_image_free;
+  } else if (!stbi_info_from_memory(static_cast<const stbi_uc*>(data),
+                                    static_cast<int>(data_size), &w, &h,
+                                    &num_components)) {
+    return false;
+  }
+  DCHECK_GE(num_components, 1) << "Unsupported component count in image.";
+  DCHECK_LE(num_components, 4) << "Unsupported component count in image.";
+  *width = static_cast<uint32>(w);
+  *height = static_cast<uint32>(h);
+  *format = kFormats[num_components - 1];
+  return true;
+}
+
+// Decodes "ION raw" |data| (see conversionutils.h for format specs). The
+// decoded pixels point into |data|. |data_size| is the number of bytes in
+// |data|. If |decoded| is NULL only the header is read. Returns false on
+// failure.
+static bool DecodeIonRaw(const void* data, size_t data_size,
+                         DecodedPixels* decoded, uint32* width,
+                         uint32* height, Image::Format* format) {
   if (!IsIonRawImageFormat(data, data_size)) {
-    return ImagePtr();  // NULL
+    return false;
   }
 
   const uint16* header_ui16 = static_cast<const uint16*>(data);
@@ -340,57 +464,220 @@ static const ImagePtr DataToImageIonRaw(const void* data,
   const bool byte_swap_required = (header_ui16[2] != 1);
   const uint16 format_indicator = byte_swap_required ?
       bswap_16(header_ui16[3]) : header_ui16[3];
-  const uint32 width = byte_swap_required ?
-      bswap_32(header_ui32[2]) : header_ui32[2];
-  const uint32 height = byte_swap_required ?
-      bswap_32(header_ui32[3]) : header_ui32[3];
-  const size_t num_pixels = width * height;
+  *width = byte_swap_required ? bswap_32(header_ui32[2]) : header_ui32[2];
+  *height = byte_swap_required ? bswap_32(header_ui32[3]) : header_ui32[3];
+  const size_t num_pixels = *width * *height;
 
-  Image::Format format;
   switch (format_indicator) {
-    case 0:  format = Image::kRgba8888; break;
-    case 1:  format = Image::kRgb565;   break;
-    case 2:  format = Image::kRgba4444; break;
-    case 3:  format = Image::kAlpha;    break;
-    default: return ImagePtr();  // NULL
+    case 0:  *format = Image::kRgba8888; break;
+    case 1:  *format = Image::kRgb565;   break;
+    case 2:  *format = Image::kRgba4444; break;
+    case 3:  *format = Image::kAlpha;    break;
+    default: return false;
   }
 
-  size_t num_bytes_per_pixel = Image::ComputeDataSize(format, 1, 1);
+  size_t num_bytes_per_pixel = Image::ComputeDataSize(*format, 1, 1);
   size_t payload_size_bytes = num_pixels * num_bytes_per_pixel;
   if (payload_size_bytes == 0 ||
       data_size - kIonRawImageHeaderSizeInBytes != payload_size_bytes) {
-    return ImagePtr();  // NULL
+    return false;
+  }
+  if (decoded) {
+    decoded->pixels = reinterpret_cast<const uint8*>(&header_ui32[4]);
+    decoded->byte_swap_required =
+        byte_swap_required && num_bytes_per_pixel > 1;
   }
+  return true;
+}
 
-  ImagePtr image;
-  image.Reset(new(allocator) Image);
-  const uint8* payload = reinterpret_cast<const uint8*>(&header_ui32[4]);
-  image->Set(format, width, height, base::DataContainer::CreateAndCopy<uint8>(
-      payload, payload_size_bytes, is_wipeable, image->GetAllocator()));
-
-  if (byte_swap_required && num_bytes_per_pixel > 1) {
-    uint8* mutable_payload = image->GetData()->GetMutableData<uint8>();
-    if (num_bytes_per_pixel == 4) {
-      uint32* mutable_payload_ui32 = reinterpret_cast<uint32*>(mutable_payload);
-      for (size_t i = 0; i < num_pixels; i++) {
-        mutable_payload_ui32[i] = bswap_32(mutable_payload_ui32[i]);
-      }
-    } else if (num_bytes_per_pixel == 2) {
-      uint16* mutable_payload_ui16 = reinterpret_cast<uint16*>(mutable_payload);
-      for (size_t i = 0; i < num_pixels; i++) {
-        mutable_payload_ui16[i] = bswap_16(mutable_payload_ui16[i]);
+// Decodes |data| with the first decoder that recognizes it. STB decodes png
+// too, but Lodepng can handle formats that STB doesn't, so we try decoding
+// with Lodepng first. If |decoded| is NULL only the header is read. Returns
+// false if no decoder succeeds.
+static bool DecodeExternalData(const void* data, size_t data_size,
+                               DecodedPixels* decoded, uint32* width,
+                               uint32* height, Image::Format* format) {
+  bool success =
+      DecodeWithLodePng(data, data_size, decoded, width, height, format) ||
+      DecodeWithStb(data, data_size, decoded, width, height, format) ||
+      DecodeIonRaw(data, data_size, decoded, width, height, format);
+  if (success && decoded) {
+    decoded->width = *width;
+    decoded->height = *height;
+    decoded->format = *format;
+  }
+  return success;
+}
+
+// Copies a row of |count| pixels of |bytes_per_pixel| bytes, reversing the
+// bytes of each pixel.
+static void CopyRowSwappingBytes(const uint8* src, size_t count,
+                                 size_t bytes_per_pixel, uint8* dst) {
+  if (bytes_per_pixel == 4U) {
+    const uint32* src_ui32 = reinterpret_cast<const uint32*>(src);
+    uint32* dst_ui32 = reinterpret_cast<uint32*>(dst);
+    for (size_t i = 0; i < count; ++i)
+      dst_ui32[i] = bswap_32(src_ui32[i]);
+  } else if (bytes_per_pixel == 2U) {
+    const uint16* src_ui16 = reinterpret_cast<const uint16*>(src);
+    uint16* dst_ui16 = reinterpret_cast<uint16*>(dst);
+    for (size_t i = 0; i < count; ++i)
+      dst_ui16[i] = bswap_16(src_ui16[i]);
+  } else {
+    DCHECK(false) << "Byte swap not supported yet for num_bytes_per_pixel = "
+                  << bytes_per_pixel;
+  }
+}
+
+// Returns whether rows of pixels in |source_format| can be converted to
+// |target_format| by ConvertRow().
+static bool IsRowConversionSupported(Image::Format source_format,
+                                     Image::Format target_format) {
+  if (source_format == target_format)
+    return true;
+  switch (source_format) {
+    case Image::kLuminance:
+    case Image::kLuminanceAlpha:
+    case Image::kRgb888:
+    case Image::kRgba8888:
+    case Image::kRgb565:
+    case Image::kRgba4444:
+      break;
+    default:
+      return false;
+  }
+  switch (target_format) {
+    case Image::kR8:
+    case Image::kRgb888:
+    case Image::kRgba8888:
+    case Image::kRgb565:
+    case Image::kRgba4444:
+    case Image::kRgba5551:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Converts a row of |count| pixels. The conversion must be supported by
+// IsRowConversionSupported() for different formats. Conversions that need an
+// intermediate RGBA8888 row use |rgba_row|, which must hold |count| pixels.
+static void ConvertRow(Image::Format source_format, const uint8* src,
+                       Image::Format target_format, uint8* dst, size_t count,
+                       uint8* rgba_row) {
+  if (source_format == target_format) {
+    memcpy(dst, src, Image::ComputeDataSize(source_format,
+                                            static_cast<uint32>(count), 1U));
+    return;
+  }
+  // Use direct kernels where there are some.
+  if (source_format == Image::kRgb888 && target_format == Image::kRgba8888) {
+    ConvertRgb888ToRgba8888(src, dst, count);
+    return;
+  } else if (source_format == Image::kRgb888 &&
+             target_format == Image::kR8) {
+    ConvertRgb888ToR8(src, dst, count);
+    return;
+  }
+
+  // Otherwise go through RGBA8888.
+  const uint8* rgba = rgba_row;
+  switch (source_format) {
+    case Image::kLuminance:
+    case Image::kLuminanceAlpha: {
+      const bool has_alpha = source_format == Image::kLuminanceAlpha;
+      for (size_t i = 0; i < count; ++i) {
+        const uint8 luminance = *src++;
+        rgba_row[4 * i] = rgba_row[4 * i + 1] = rgba_row[4 * i + 2] =
+            luminance;
+        rgba_row[4 * i + 3] = has_alpha ? *src++ : 255;
       }
-    } else {
-      DCHECK(false) << "Byte swap not supported yet for num_bytes_per_pixel = "
-                    << num_bytes_per_pixel;
+      break;
     }
+    case Image::kRgb888:
+      ConvertRgb888ToRgba8888(src, rgba_row, count);
+      break;
+    case Image::kRgba8888:
+      rgba = src;
+      break;
+    case Image::kRgb565:
+      ConvertRgb565ToRgba8888(reinterpret_cast<const uint16*>(src), rgba_row,
+                              count);
+      break;
+    case Image::kRgba4444:
+      ConvertRgba4444ToRgba8888(reinterpret_cast<const uint16*>(src),
+                                rgba_row, count);
+      break;
+    default:
+      DCHECK(false) << "Unsupported row conversion";
+      return;
   }
-
-  if (flip_vertically) {
-    FlipImage(image);
+  uint16* dst_ui16 = reinterpret_cast<uint16*>(dst);
+  switch (target_format) {
+    case Image::kR8:
+      ConvertRgba8888ToR8(rgba, dst, count);
+      break;
+    case Image::kRgb888:
+      ConvertRgba8888ToRgb888(rgba, dst, count);
+      break;
+    case Image::kRgba8888:
+      memcpy(dst, rgba, 4U * count);
+      break;
+    case Image::kRgb565:
+      ConvertRgba8888ToRgb565(rgba, dst_ui16, count);
+      break;
+    case Image::kRgba4444:
+      ConvertRgba8888ToRgba4444(rgba, dst_ui16, count);
+      break;
+    case Image::kRgba5551:
+      ConvertRgba8888ToRgba5551(rgba, dst_ui16, count);
+      break;
+    default:
+      DCHECK(false) << "Unsupported row conversion";
   }
+}
 
-  return image;
+// Writes the rows of |decoded| to |dst|, an image in |target_format| of the
+// same dimensions, swapping bytes, flipping and converting each row on the
+// way. |rows_ready| is called, if set, after each strip of rows is written.
+static void WriteDecodedRows(const DecodedPixels& decoded,
+                             bool flip_vertically, Image::Format target_format,
+                             uint8* dst,
+                             const DecodedRowsCallback& rows_ready) {
+  const uint32 width = decoded.width;
+  const uint32 height = decoded.height;
+  const size_t src_stride = Image::ComputeDataSize(decoded.format, width, 1U);
+  const size_t dst_stride = Image::ComputeDataSize(target_format, width, 1U);
+  const size_t src_pixel_size = Image::ComputeDataSize(decoded.format, 1U, 1U);
+  const bool is_copy = decoded.format == target_format;
+  // Rows only need a scratch copy when they must be both swapped and
+  // converted, or converted through RGBA8888.
+  std::vector<uint8> swapped_row(
+      decoded.byte_swap_required && !is_copy ? src_stride : 0U);
+  std::vector<uint8> rgba_row(is_copy ? 0U : 4U * width);
+  uint8* rgba = rgba_row.empty() ? NULL : &rgba_row[0];
+  const uint32 kRowsPerStrip = 64U;
+  for (uint32 strip = 0; strip < height; strip += kRowsPerStrip) {
+    const uint32 strip_end = std::min(height, strip + kRowsPerStrip);
+    for (uint32 row = strip; row < strip_end; ++row) {
+      const uint8* src = decoded.pixels + row * src_stride;
+      uint8* dst_row =
+          dst + (flip_vertically ? height - 1U - row : row) * dst_stride;
+      if (decoded.byte_swap_required) {
+        if (is_copy) {
+          CopyRowSwappingBytes(src, width, src_pixel_size, dst_row);
+          continue;
+        }
+        CopyRowSwappingBytes(src, width, src_pixel_size, &swapped_row[0]);
+        src = &swapped_row[0];
+      }
+      ConvertRow(decoded.format, src, target_format, dst_row, width, rgba);
+    }
+    if (rows_ready) {
+      const uint32 row_count = strip_end - strip;
+      rows_ready(flip_vertically ? height - strip_end : strip, row_count);
+    }
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -399,11 +686,6 @@ static const ImagePtr DataToImageIonRaw(const void* data,
 //
 //-----------------------------------------------------------------------------
 
-static uint8 MultiplyUint8ByFloat(const uint8 int_value,
-                                  const float float_value) {
-  return static_cast<uint8>(static_cast<float>(int_value) * float_value);
-}
-
 static const ImagePtr AllocImage(
     Image::Format format, uint32 width, uint32 height, bool is_wipeable,
     const base::AllocatorPtr& allocator) {
@@ -436,13 +718,11 @@ static const ImagePtr ExtractRedChannel(const Image& image,
       Image::kR8, width, height, is_wipeable, allocator);
   const uint8* src_data = image.GetData()->GetData<uint8>();
   uint8* dst_data = result->GetData()->GetMutableData<uint8>();
-  const size_t src_stride = Image::GetNumComponentsForFormat(image.GetFormat());
-  const uint8* src_end = src_data + image.GetDataSize();
-  while (src_data < src_end) {
-    *dst_data = src_data[0];
-    src_data += src_stride;
-    dst_data++;
-  }
+  const size_t num_pixels = static_cast<size_t>(width) * height;
+  if (image.GetFormat() == Image::kRgb888)
+    ConvertRgb888ToR8(src_data, dst_data, num_pixels);
+  else
+    ConvertRgba8888ToR8(src_data, dst_data, num_pixels);
   return result;
 }
 
@@ -483,17 +763,173 @@ static const ImagePtr LuminanceToRgb(const Image& image,
   return result;
 }
 
+// Returns whether pixels in |format| can be loaded into or stored from RGBA
+// float rows by LoadFloatRow() and StoreFloatRow().
+static bool IsFloatRowFormat(Image::Format format) {
+  switch (format) {
+    case Image::kRgb888:
+    case Image::kRgba8888:
+    case Image::kRgb32f:
+    case Image::kRgba32f:
+    case Image::kRgb16fHalf:
+    case Image::kRgba16fHalf:
+    case Image::kRgb10a2:
+    case Image::kRgb11f_11f_10f_Rev:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Returns whether |format| holds float or packed float pixels.
+static bool IsFloatFormat(Image::Format format) {
+  return IsFloatRowFormat(format) && format != Image::kRgb888 &&
+      format != Image::kRgba8888;
+}
+
+// Loads a row of |count| pixels in |format| into |rgba| as RGBA floats, with
+// an alpha of 1 for formats without alpha. |rgb| must hold 3 * |count| floats.
+static void LoadFloatRow(Image::Format format, const uint8* src, size_t count,
+                         float* rgba, float* rgb) {
+  const float* src_rgb = rgb;
+  switch (format) {
+    case Image::kRgb888:
+    case Image::kRgba8888: {
+      const size_t channels = format == Image::kRgb888 ? 3U : 4U;
+      for (size_t i = 0; i < count; ++i, src += channels) {
+        for (size_t c = 0; c < 4U; ++c) {
+          rgba[4U * i + c] =
+              c < channels ? static_cast<float>(src[c]) / 255.f : 1.f;
+        }
+      }
+      return;
+    }
+    case Image::kRgba32f:
+      memcpy(rgba, src, 4U * count * sizeof(float));
+      return;
+    case Image::kRgba16fHalf:
+      ConvertHalfToFloat(reinterpret_cast<const uint16*>(src), rgba,
+                         4U * count);
+      return;
+    case Image::kRgb10a2:
+      ConvertRgb10a2ToRgba32f(reinterpret_cast<const uint32*>(src), rgba,
+                              count);
+      return;
+    case Image::kRgb32f:
+      src_rgb = reinterpret_cast<const float*>(src);
+      break;
+    case Image::kRgb16fHalf:
+      ConvertHalfToFloat(reinterpret_cast<const uint16*>(src), rgb,
+                         3U * count);
+      break;
+    case Image::kRgb11f_11f_10f_Rev:
+      ConvertRgb11f11f10fToRgb32f(reinterpret_cast<const uint32*>(src), rgb,
+                                  count);
+      break;
+    default:
+      DCHECK(false) << "Unsupported float row format";
+      return;
+  }
+  for (size_t i = 0; i < count; ++i, src_rgb += 3) {
+    rgba[4U * i] = src_rgb[0];
+    rgba[4U * i + 1U] = src_rgb[1];
+    rgba[4U * i + 2U] = src_rgb[2];
+    rgba[4U * i + 3U] = 1.f;
+  }
+}
+
+// Stores a row of |count| RGBA float pixels in |format|, dropping alpha for
+// formats without it. |rgb| must hold 3 * |count| floats.
+static void StoreFloatRow(Image::Format format, const float* rgba,
+                          size_t count, uint8* dst, float* rgb) {
+  switch (format) {
+    case Image::kRgb888:
+    case Image::kRgba8888: {
+      const size_t channels = format == Image::kRgb888 ? 3U : 4U;
+      for (size_t i = 0; i < count; ++i, rgba += 4) {
+        for (size_t c = 0; c < channels; ++c) {
+          const float value = rgba[c] > 0.f ? std::min(rgba[c], 1.f) : 0.f;
+          *dst++ = static_cast<uint8>(value * 255.f + 0.5f);
+        }
+      }
+      return;
+    }
+    case Image::kRgba32f:
+      memcpy(dst, rgba, 4U * count * sizeof(float));
+      return;
+    case Image::kRgba16fHalf:
+      ConvertFloatToHalf(rgba, reinterpret_cast<uint16*>(dst), 4U * count);
+      return;
+    case Image::kRgb10a2:
+      ConvertRgba32fToRgb10a2(rgba, reinterpret_cast<uint32*>(dst), count);
+      return;
+    default:
+      break;
+  }
+  float* dst_rgb =
+      format == Image::kRgb32f ? reinterpret_cast<float*>(dst) : rgb;
+  for (size_t i = 0; i < count; ++i, rgba += 4) {
+    dst_rgb[3U * i] = rgba[0];
+    dst_rgb[3U * i + 1U] = rgba[1];
+    dst_rgb[3U * i + 2U] = rgba[2];
+  }
+  switch (format) {
+    case Image::kRgb32f:
+      break;
+    case Image::kRgb16fHalf:
+      ConvertFloatToHalf(rgb, reinterpret_cast<uint16*>(dst), 3U * count);
+      break;
+    case Image::kRgb11f_11f_10f_Rev:
+      ConvertRgb32fToRgb11f11f10f(rgb, reinterpret_cast<uint32*>(dst), count);
+      break;
+    default:
+      DCHECK(false) << "Unsupported float row format";
+  }
+}
+
+// Converts an image to or from one of the float formats supported by
+// IsFloatRowFormat(), a row at a time through RGBA floats.
+static const ImagePtr ConvertFloatImage(const Image& image,
+                                        Image::Format target_format,
+                                        bool is_wipeable,
+                                        const base::AllocatorPtr& allocator) {
+  const Image::Format source_format = image.GetFormat();
+  const uint32 width = image.GetWidth();
+  const uint32 height = image.GetHeight();
+  ImagePtr result =
+      AllocImage(target_format, width, height, is_wipeable, allocator);
+  const size_t src_stride = Image::ComputeDataSize(source_format, width, 1U);
+  const size_t dst_stride = Image::ComputeDataSize(target_format, width, 1U);
+  const uint8* src = image.GetData()->GetData<uint8>();
+  uint8* dst = result->GetData()->GetMutableData<uint8>();
+  std::vector<float> rgba_row(4U * width + 1U);
+  std::vector<float> rgb_row(3U * width + 1U);
+  for (uint32 y = 0; y < height; ++y) {
+    LoadFloatRow(source_format, src + y * src_stride, width, &rgba_row[0],
+                 &rgb_row[0]);
+    StoreFloatRow(target_format, &rgba_row[0], width, dst + y * dst_stride,
+                  &rgb_row[0]);
+  }
+  return result;
+}
+
 // Converts an Image to the target_format, returning a new ImagePtr. Returns a
 // NULL ImagePtr if anything goes wrong.
 static const ImagePtr ImageToImage(const Image& image,
                                    Image::Format target_format,
                                    bool is_wipeable,
                                    const base::AllocatorPtr& allocator,
-                                   const base::AllocatorPtr& temp_allocator) {
+                                   const base::AllocatorPtr& temp_allocator,
+                                   base::TaskScheduler* scheduler) {
   const Image::Format source_format = image.GetFormat();
 
   // TODO(user): Implement other conversions as required.
 
+  // Float images are converted through RGBA float rows.
+  if ((IsFloatFormat(source_format) || IsFloatFormat(target_format)) &&
+      IsFloatRowFormat(source_format) && IsFloatRowFormat(target_format))
+    return ConvertFloatImage(image, target_format, is_wipeable, allocator);
+
   ImagePtr result;
   switch (source_format) {
     case Image::kDxt1:
@@ -509,7 +945,8 @@ static const ImagePtr ImageToImage(const Image& image,
 
     case Image::kRgb888:
       if (target_format == Image::kDxt1 || target_format == Image::kEtc1) {
-        result = CompressImage(image, target_format, is_wipeable, allocator);
+        result = CompressImage(image, target_format, is_wipeable, allocator,
+                               scheduler);
       } else if (target_format == Image::kR8) {
         result = ExtractRedChannel(image, is_wipeable, allocator);
       }
@@ -518,7 +955,8 @@ static const ImagePtr ImageToImage(const Image& image,
     case Image::kRgba8888:
       if (target_format == Image::kDxt5 ||
           target_format == Image::kPvrtc1Rgba2) {
-        result = CompressImage(image, target_format, is_wipeable, allocator);
+        result = CompressImage(image, target_format, is_wipeable, allocator,
+                               scheduler);
       } else if (target_format == Image::kR8) {
         result = ExtractRedChannel(image, is_wipeable, allocator);
       }
@@ -568,13 +1006,44 @@ static const ImagePtr ImageToImage(const Image& image,
     if (source_format != canonical_format && canonical_format != target_format)
       result = ConvertImage(
           ImageToImage(image, canonical_format, is_wipeable,
-                       temp_allocator, temp_allocator),
-          target_format, is_wipeable, allocator, temp_allocator);
+                       temp_allocator, temp_allocator, scheduler),
+          target_format, is_wipeable, allocator, temp_allocator, scheduler);
   }
 
   return result;
 }
 
+// Decodes a request of ConvertFromExternalImageDataBatch(), converting rows
+// while writing them where possible, and otherwise through an intermediate
+// image allocated with |temporary_allocator|.
+static const ImagePtr DecodeRequest(
+    const ExternalImageDecodeRequest& request, bool is_wipeable,
+    const base::AllocatorPtr& allocator,
+    const base::AllocatorPtr& temporary_allocator) {
+  DecodedPixels decoded;
+  uint32 width, height;
+  Image::Format format;
+  if (!request.data || !request.data_size ||
+      !DecodeExternalData(request.data, request.data_size, &decoded, &width,
+                          &height, &format))
+    return ImagePtr();
+  const Image::Format target_format =
+      request.target_format == Image::kInvalid ? format
+                                               : request.target_format;
+  const bool is_direct = IsRowConversionSupported(format, target_format);
+  const ImagePtr image = AllocImage(
+      is_direct ? target_format : format, width, height,
+      is_direct ? is_wipeable : true,
+      is_direct ? allocator : temporary_allocator);
+  WriteDecodedRows(decoded, request.flip_vertically, image->GetFormat(),
+                   image->GetData()->GetMutableData<uint8>(),
+                   DecodedRowsCallback());
+  if (is_direct)
+    return image;
+  return ConvertImage(image, target_format, is_wipeable, allocator,
+                      temporary_allocator);
+}
+
 // Converts |data| encoded in a buffer to an Image. Supported formats: PNG
 // (using lodepng), JPEG, PNG, TGA, BMP, PSD, GIF, HDR, PIC (using stblib) and
 // "ION raw" format (see conversionutils.h for specs of "ION raw" format). This
@@ -584,22 +1053,18 @@ static const ImagePtr ImageToImage(const Image& image,
 static const ImagePtr DataToImage(const void* data, size_t data_size,
                                   bool flip_vertically, bool is_wipeable,
                                   const base::AllocatorPtr& allocator) {
-  // STB decodes png too, but Lodepng can handle formats that STB doesn't, so
-  // we try decoding with Lodepng first.
-  ImagePtr image = DataToImageLodePng(
-      data, data_size, flip_vertically, is_wipeable, allocator);
-  if (image.Get() != NULL) {
-    return image;
-  }
-
-  image = DataToImageStb(
-      data, data_size, flip_vertically, is_wipeable, allocator);
-  if (image.Get() != NULL) {
-    return image;
-  }
-
-  return DataToImageIonRaw(
-      data, data_size, flip_vertically, is_wipeable, allocator);
+  DecodedPixels decoded;
+  uint32 width, height;
+  Image::Format format;
+  if (!DecodeExternalData(data, data_size, &decoded, &width, &height,
+                          &format))
+    return ImagePtr();
+  // Copy the decoded rows straight into their flipped position.
+  ImagePtr image = AllocImage(format, width, height, is_wipeable, allocator);
+  WriteDecodedRows(decoded, flip_vertically, format,
+                   image->GetData()->GetMutableData<uint8>(),
+                   DecodedRowsCallback());
+  return image;
 }
 
 // Converts an Image to the external_format, returning a byte vector. Returns
@@ -609,8 +1074,10 @@ static const std::vector<uint8> ImageToData(
     bool flip_vertically) {
   std::vector<uint8> result;
 
-  // STBLIB supports writing to PNG, but not JPEG.
-  if (external_format == kPng) {
+  // STBLIB supports writing to PNG, but not JPEG, which has its own encoder.
+  if (external_format == kJpeg) {
+    result = EncodeJpeg(image, kDefaultJpegQuality, flip_vertically);
+  } else if (external_format == kPng) {
     uint8* image_data = nullptr;
     ImagePtr flipped_image;
 
@@ -684,208 +1151,6 @@ static const ImagePtr DownsampleWithCompressor(
   return result;
 }
 
-// Simple 2x downsampling with box filter.
-// The math here isn't correct for un-premultiplied alpha images, so you should
-// pass in premultiplied images if possible.  In particular fully opaque red
-// next to fully transparent green will yield a half-transparent amber pixel,
-// instead of half-transparent red.
-static const ImagePtr Downsample2xSimple8bpc(
-    const Image& image,
-    bool is_wipeable,
-    const base::AllocatorPtr& allocator) {
-  const uint32 num_channels =
-      Image::GetNumComponentsForFormat(image.GetFormat());
-  // Round up size on odd widths and heights.
-  const uint32 new_width = (image.GetWidth() + 1) >> 1;
-  const uint32 new_height = (image.GetHeight() + 1) >> 1;
-  ImagePtr result = AllocImage(
-      image.GetFormat(), new_width, new_height, is_wipeable, allocator);
-  const uint8* src_data = image.GetData()->GetData<uint8>();
-  uint8* dst_data = result->GetData()->GetMutableData<uint8>();
-  const size_t src_stride = image.GetWidth() * num_channels;
-  const size_t dst_stride = new_width * num_channels;
-  for (size_t src_row = 0, src_rows = image.GetHeight();
-       src_row < src_rows; src_row += 2) {
-    const size_t dst_row = src_row >> 1;
-    // Clamp src row to stay within image bounds.
-    const size_t next_row = (src_row == src_rows - 1) ? 0 : src_stride;
-    for (size_t src_col = 0, src_cols = image.GetWidth();
-         src_col < src_cols; src_col += 2) {
-      const uint8* src_pixel =
-          src_data + src_row * src_stride + src_col * num_channels;
-      const size_t dst_col = src_col >> 1;
-      uint8* dst_pixel =
-          dst_data + dst_row * dst_stride + dst_col * num_channels;
-      // Clamp src column to stay within image bounds.
-      const size_t next_col = (src_col == src_cols - 1) ? 0 : num_channels;
-      for (size_t chan = 0; chan < num_channels; ++chan) {
-        dst_pixel[chan] =
-            static_cast<uint8>((src_pixel[chan] +
-                src_pixel[chan + next_col] +
-                src_pixel[chan + next_row] +
-                src_pixel[chan + next_col + next_row] + 1) >> 2);
-      }
-    }
-  }
-  return result;
-}
-
-// Bilinearly interpolate an 8-bit-per-channel |image|.
-// Bilinear resizing is most useful for upsizing images as it only uses a
-// weighted average of the 4 closest pixel values, and has reasonable quality.
-static const gfx::ImagePtr ResizeBilinear8bpc(
-    const gfx::Image& image, uint32 out_width, uint32 out_height,
-    bool is_wipeable, const base::AllocatorPtr& allocator) {
-  ImagePtr result = AllocImage(
-      image.GetFormat(), out_width, out_height, is_wipeable, allocator);
-  const float xscale =
-      static_cast<float>(image.GetWidth()) / static_cast<float>(out_width);
-  const float yscale =
-      static_cast<float>(image.GetHeight()) / static_cast<float>(out_height);
-  const uint8* src_data = image.GetData()->GetData<uint8>();
-  uint8* dst_data = result->GetData()->GetMutableData<uint8>();
-  int num_channels = Image::GetNumComponentsForFormat(image.GetFormat());
-  const size_t src_stride = image.GetWidth() * num_channels;
-  const size_t dst_stride = out_width * num_channels;
-  const size_t max_src_x = static_cast<size_t>(image.GetWidth() - 1);
-  const size_t max_src_y = static_cast<size_t>(image.GetHeight() - 1);
-  // Note that pixel values should be treated as located at the center of each
-  // pixel. I.e., pixel (i,j)'s value is centered at (i+0.5,j+0.5) for the
-  // purposes of computing how close a sample location is to the source pixel.
-  for (uint32 dst_y = 0; dst_y < out_height; ++dst_y) {
-    for (uint32 dst_x = 0; dst_x < out_width; ++dst_x) {
-      uint8* dst_pixel = dst_data + dst_y * dst_stride + dst_x * num_channels;
-      float src_x = (static_cast<float>(dst_x) + 0.5f) * xscale;
-      float src_y = (static_cast<float>(dst_y) + 0.5f) * yscale;
-      // Compute fractional distances to the nearest pixel centers, which are
-      // also the interpolation weights.
-      float s1 = src_x + 0.5f - std::floor(src_x + 0.5f);
-      float s0 = 1.0f - s1;
-      float t1 = src_y + 0.5f - std::floor(src_y + 0.5f);
-      float t0 = 1.0f - t1;
-      // Clamp the source pixels inside the boundary.
-      size_t src_x0 =
-          static_cast<size_t>(std::max(0.f, std::floor(src_x - 0.5f)));
-      size_t src_y0 =
-          static_cast<size_t>(std::max(0.f, std::floor(src_y - 0.5f)));
-      size_t src_x1 = std::min(
-          max_src_x,
-          static_cast<size_t>(std::floor(src_x + 0.5f)));
-      size_t src_y1 = std::min(
-          max_src_y,
-          static_cast<size_t>(std::floor(src_y + 0.5f)));
-      const uint8* src_00 =
-          src_data + src_x0 * num_channels + src_y0 * src_stride;
-      const uint8* src_10 =
-          src_data + src_x1 * num_channels + src_y0 * src_stride;
-      const uint8* src_01 =
-          src_data + src_x0 * num_channels + src_y1 * src_stride;
-      const uint8* src_11 =
-          src_data + src_x1 * num_channels + src_y1 * src_stride;
-      for (int chan = 0; chan < num_channels; ++chan) {
-        dst_pixel[chan] = static_cast<uint8>(std::floor(
-            s0 * t0 * static_cast<float>(src_00[chan]) +
-            s1 * t0 * static_cast<float>(src_10[chan]) +
-            s0 * t1 * static_cast<float>(src_01[chan]) +
-            s1 * t1 * static_cast<float>(src_11[chan]) + 0.5f));
-      }
-    }
-  }
-  return result;
-}
-
-// Returns the rect resulting from the intersection of |src_rectf| and a
-// 1x1 rect with min point at (src_x, src_y).
-static Range2f GetPixelRectIntersection(
-    float src_x, float src_y, const Range2f& src_rectf) {
-  Point2f min_pt = src_rectf.GetMinPoint();
-  Point2f max_pt = src_rectf.GetMaxPoint();
-  min_pt[0] = std::max(src_x, min_pt[0]);
-  min_pt[1] = std::max(src_y, min_pt[1]);
-  max_pt[0] = std::min(src_x + 1.f, max_pt[0]);
-  max_pt[1] = std::min(src_y + 1.f, max_pt[1]);
-  return Range2f(min_pt, max_pt);
-}
-
-// Returns the area of the rectangle |rect|.
-static float GetRectArea(const Range2f& rect) {
-  math::Vector2f size = rect.GetSize();
-  return size[0] * size[1];
-}
-
-// Use a box filter to resize an 8-bit-per-channel |image|.
-// Box filtering is most useful for downsizing images.
-// It maps the square of the new pixel onto the source image and takes the
-// area-weighted average of contributions from each of the old source pixels.
-static const gfx::ImagePtr ResizeBoxFilter8bpc(
-    const gfx::Image& image, uint32 out_width, uint32 out_height,
-    bool is_wipeable, const base::AllocatorPtr& allocator) {
-  const int kMaxChannels = 4;
-  ImagePtr result;
-  const int num_channels = Image::GetNumComponentsForFormat(image.GetFormat());
-  DCHECK_LE(num_channels, kMaxChannels)
-      << "Unsupported number of channels for resize.";
-  result = AllocImage(
-      image.GetFormat(), out_width, out_height, is_wipeable, allocator);
-  Point2f rect_scale(
-      static_cast<float>(image.GetWidth()) / static_cast<float>(out_width),
-      static_cast<float>(image.GetHeight()) / static_cast<float>(out_height));
-  const uint8* src_data = image.GetData()->GetData<uint8>();
-  uint8* dst_data = result->GetData()->GetMutableData<uint8>();
-  const size_t src_stride = image.GetWidth() * num_channels;
-  const size_t dst_stride = out_width * num_channels;
-  float src_area = GetRectArea(Range2f(Point2f::Zero(), rect_scale));
-  for (uint32 dst_y = 0; dst_y < out_height; ++dst_y) {
-    for (uint32 dst_x = 0; dst_x < out_width; ++dst_x) {
-      // Compute the dst pixel's rectangle in the src image.
-      float dst_xf = static_cast<float>(dst_x);
-      float dst_yf = static_cast<float>(dst_y);
-      Range2f src_rectf = Range2f(
-          Point2f(dst_xf, dst_yf) * rect_scale,
-          Point2f(dst_xf + 1.f, dst_yf + 1.f) * rect_scale);
-      // Pixel coords of all the pixels in the src that touch |src_rect|.
-      Point2f src_min(
-          std::floor(src_rectf.GetMinPoint()[0]),
-          std::floor(src_rectf.GetMinPoint()[1]));
-      Point2f src_max(
-          std::ceil(src_rectf.GetMaxPoint()[0]),
-          std::ceil(src_rectf.GetMaxPoint()[1]));
-
-#if ION_DEBUG
-      float check_area_total = 0.f;
-#endif
-      float dst_value[kMaxChannels] = { 0.f };
-      for (float src_y = src_min[1]; src_y < src_max[1]; ++src_y) {
-        for (float src_x = src_min[0]; src_x < src_max[0]; ++src_x) {
-          // Intersect src pixel's region with full src_rect.
-          Range2f src_dest_intersect =
-              GetPixelRectIntersection(src_x, src_y, src_rectf);
-          float part_area = GetRectArea(src_dest_intersect);
-#if ION_DEBUG
-          check_area_total += part_area;
-#endif
-          size_t src_xi = static_cast<size_t>(src_x);
-          size_t src_yi = static_cast<size_t>(src_y);
-          const uint8* src_pixel =
-              src_data + src_yi * src_stride + src_xi * num_channels;
-          for (int chan = 0; chan < num_channels; ++chan) {
-            dst_value[chan] += part_area * static_cast<float>(src_pixel[chan]);
-          }
-        }
-      }
-#if ION_DEBUG
-      DCHECK_LT(std::abs(check_area_total - src_area), 1e-3);
-#endif
-      uint8* dst_pixel = dst_data + dst_y * dst_stride + dst_x * num_channels;
-      for (int chan = 0; chan < num_channels; ++chan) {
-        dst_pixel[chan] =
-            static_cast<uint8>(std::floor(dst_value[chan] / src_area + 0.5f));
-      }
-    }
-  }
-  return result;
-}
-
 }  // anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -898,8 +1163,18 @@ const ImagePtr ION_API ConvertImage(
     const ImagePtr& image, Image::Format target_format, bool is_wipeable,
     const base::AllocatorPtr& allocator,
     const base::AllocatorPtr& temporary_allocator) {
+  return ConvertImage(image, target_format, is_wipeable, allocator,
+                      temporary_allocator, NULL);
+}
+
+const ImagePtr ION_API ConvertImage(
+    const ImagePtr& image, Image::Format target_format, bool is_wipeable,
+    const base::AllocatorPtr& allocator,
+    const base::AllocatorPtr& temporary_allocator,
+    base::TaskScheduler* scheduler) {
   if (!ImageHasData(image))
     return ImagePtr();
+  base::SamplingAllocationTracker::ScopedTag tag("image");
 
   if (image->GetFormat() == target_format) {
     if (image->GetData()->IsWipeable() == is_wipeable) {
@@ -921,7 +1196,16 @@ const ImagePtr ION_API ConvertImage(
       base::AllocationManager::GetNonNullAllocator(allocator);
   const base::AllocatorPtr& temp_al =
       base::AllocationManager::GetNonNullAllocator(temporary_allocator);
-  return ImageToImage(*image, target_format, is_wipeable, al, temp_al);
+
+  // Formats that Ion can only decode are converted from their decoded format.
+  if (IsBlockDecodingSupported(image->GetFormat())) {
+    if (GetBlockDecodedFormat(image->GetFormat()) == target_format)
+      return DecodeCompressedImage(image, is_wipeable, al);
+    return ConvertImage(DecodeCompressedImage(image, is_wipeable, temp_al),
+                        target_format, is_wipeable, al, temp_al, scheduler);
+  }
+  return ImageToImage(*image, target_format, is_wipeable, al, temp_al,
+                      scheduler);
 }
 
 const ImagePtr ION_API ConvertFromExternalImageData(
@@ -929,6 +1213,7 @@ const ImagePtr ION_API ConvertFromExternalImageData(
     const base::AllocatorPtr& allocator) {
   if (!data || data_size == 0)
     return ImagePtr();
+  base::SamplingAllocationTracker::ScopedTag tag("image");
 
   // Convert the data to an Image and then convert to the correct target format.
   // We attempt to interpret the data in different formats, one after another,
@@ -938,6 +1223,60 @@ const ImagePtr ION_API ConvertFromExternalImageData(
   return DataToImage(data, data_size, flip_vertically, is_wipeable, al);
 }
 
+const std::vector<ImagePtr> ION_API ConvertFromExternalImageDataBatch(
+    const std::vector<ExternalImageDecodeRequest>& requests, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler,
+    const DecodedImageCallback& image_ready) {
+  std::vector<ImagePtr> images(requests.size());
+  base::SamplingAllocationTracker::ScopedTag tag("image");
+  const base::AllocatorPtr& al =
+      base::AllocationManager::GetNonNullAllocator(allocator);
+
+  // Only reading the headers is cheap, and sizes the arenas for the largest
+  // intermediate image.
+  size_t arena_size = 0U;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    const ExternalImageDecodeRequest& request = requests[i];
+    uint32 width, height;
+    Image::Format format;
+    if (request.data && request.data_size &&
+        DecodeExternalData(request.data, request.data_size, NULL, &width,
+                           &height, &format) &&
+        request.target_format != Image::kInvalid &&
+        !IsRowConversionSupported(format, request.target_format)) {
+      arena_size = std::max(arena_size,
+                            Image::ComputeDataSize(format, width, height));
+    }
+  }
+  // The arena also holds the Image and its DataContainer.
+  base::ArenaAllocatorPtr arena;
+  if (arena_size)
+    arena.Reset(new base::ArenaAllocator(arena_size + 4096U));
+
+  port::Mutex callback_mutex;
+  const auto decode = [&](size_t index) {
+    images[index] = DecodeRequest(requests[index], is_wipeable, al, arena);
+    // The intermediate image is gone, so the arena of this thread can be
+    // rewound for the next request.
+    if (arena.Get())
+      arena->EndFrame();
+    if (image_ready) {
+      base::LockGuard guard(&callback_mutex);
+      image_ready(index, images[index]);
+    }
+  };
+  if (scheduler) {
+    base::TaskScheduler::TaskGroup group;
+    for (size_t i = 0; i < requests.size(); ++i)
+      scheduler->Submit([&decode, i]() { decode(i); }, &group);
+    scheduler->Wait(&group);
+  } else {
+    for (size_t i = 0; i < requests.size(); ++i)
+      decode(i);
+  }
+  return images;
+}
+
 bool ION_API IsIonRawImageFormat(const void* data, size_t data_size) {
   const uint8* header_ui8 = static_cast<const uint8*>(data);
   return data_size >= kIonRawImageHeaderSizeInBytes &&
@@ -947,6 +1286,55 @@ bool ION_API IsIonRawImageFormat(const void* data, size_t data_size) {
        (header_ui8[4] == 0x01 && header_ui8[5] == 0x00)) /* Endianness cue */;
 }
 
+bool ION_API GetExternalImageDataInfo(
+    const void* data, size_t data_size, uint32* width, uint32* height,
+    Image::Format* format) {
+  if (!data || data_size == 0)
+    return false;
+  DCHECK(width);
+  DCHECK(height);
+  DCHECK(format);
+  return DecodeExternalData(data, data_size, NULL, width, height, format);
+}
+
+bool ION_API DecodeExternalImageData(
+    const void* data, size_t data_size, bool flip_vertically,
+    const ImagePtr& image, const DecodedRowsCallback& rows_ready) {
+  if (!data || data_size == 0 || !image.Get())
+    return false;
+  const Image::Format target_format = image->GetFormat();
+  if (!image->GetData().Get() ||
+      image->GetDataSize() != Image::ComputeDataSize(
+          target_format, image->GetWidth(), image->GetHeight())) {
+    LOG(ERROR) << "DecodeExternalImageData: target image has no data of the "
+               << "expected size.";
+    return false;
+  }
+  DecodedPixels decoded;
+  uint32 width, height;
+  Image::Format format;
+  if (!DecodeExternalData(data, data_size, &decoded, &width, &height,
+                          &format))
+    return false;
+  if (width != image->GetWidth() || height != image->GetHeight()) {
+    LOG(ERROR) << "DecodeExternalImageData: decoded size " << width << "x"
+               << height << " does not match the target image.";
+    return false;
+  }
+  if (!IsRowConversionSupported(format, target_format)) {
+    LOG(ERROR) << "DecodeExternalImageData: conversion from "
+               << Image::GetFormatString(format) << " to "
+               << Image::GetFormatString(target_format)
+               << " is not supported.";
+    return false;
+  }
+  uint8* dst = image->GetData()->GetMutableData<uint8>();
+  if (!dst)
+    return false;
+  WriteDecodedRows(decoded, flip_vertically, target_format, dst, rows_ready);
+  return true;
+}
+
 const std::vector<uint8> ION_API ConvertToExternalImageData(
     const ImagePtr& image, ExternalImageFormat external_format,
     bool flip_vertically) {
@@ -959,6 +1347,12 @@ const std::vector<uint8> ION_API ConvertToExternalImageData(
 const ImagePtr ION_API DownsampleImage2x(
     const ImagePtr& image, bool is_wipeable,
     const base::AllocatorPtr& allocator) {
+  return DownsampleImage2x(image, is_wipeable, allocator, NULL);
+}
+
+const ImagePtr ION_API DownsampleImage2x(
+    const ImagePtr& image, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler) {
   ImagePtr result;
   if (ImageHasData(image) &&
       image->GetWidth() > 1U && image->GetHeight() > 1U) {
@@ -971,8 +1365,8 @@ const ImagePtr ION_API DownsampleImage2x(
       image_codec_compression::DxtcCompressor compressor;
       result = DownsampleWithCompressor(
           *image, &compressor, is_wipeable, allocator);
-    } else if (Image::Is8BitPerChannelFormat(image->GetFormat())) {
-      result = Downsample2xSimple8bpc(*image, is_wipeable, allocator);
+    } else if (IsResamplingSupported(image->GetFormat())) {
+      result = HalveImage(image, is_wipeable, allocator, scheduler);
     } else {
       LOG(WARNING) << "Downsampling image format "
                    << Image::GetFormatString(image->GetFormat())
@@ -982,31 +1376,41 @@ const ImagePtr ION_API DownsampleImage2x(
   return result;
 }
 
+const std::vector<ImagePtr> ION_API GenerateMipmapChain(
+    const ImagePtr& image, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler) {
+  std::vector<ImagePtr> levels;
+  if (!ImageHasData(image))
+    return levels;
+  levels.push_back(image);
+  const bool is_resampled = IsResamplingSupported(image->GetFormat());
+  while (levels.back()->GetWidth() > 1U || levels.back()->GetHeight() > 1U) {
+    // Uncompressed levels keep halving down to 1x1, while compressed ones stop
+    // once DownsampleImage2x() can no longer handle them.
+    const ImagePtr next =
+        is_resampled
+            ? HalveImage(levels.back(), is_wipeable, allocator, scheduler)
+            : DownsampleImage2x(levels.back(), is_wipeable, allocator,
+                                scheduler);
+    if (!next.Get())
+      break;
+    levels.push_back(next);
+  }
+  return levels;
+}
+
 const gfx::ImagePtr ResizeImage(
     const gfx::ImagePtr& image, uint32 out_width, uint32 out_height,
     bool is_wipeable, const base::AllocatorPtr& allocator) {
-  ImagePtr result;
-  if (!ImageHasData(image)) {
-    return result;
-  }
-  if (!Image::Is8BitPerChannelFormat(image->GetFormat())) {
-    LOG(WARNING) << "Resizing image format "
-                 << Image::GetFormatString(image->GetFormat())
-                 << " not supported.";
-    return result;
-  }
-
-  uint32 image_width = image->GetWidth();
-  uint32 image_height = image->GetHeight();
-  if (out_width < image_width && out_height < image_height) {
-    result = ResizeBoxFilter8bpc(
-        *image, out_width, out_height, is_wipeable, allocator);
-  } else {
-    // For upscaling or mixed scale up / scale down, use bilinear interpolation
-    result = ResizeBilinear8bpc(
-        *image, out_width, out_height, is_wipeable, allocator);
-  }
-  return result;
+  if (!ImageHasData(image))
+    return ImagePtr();
+  // Use a box filter when shrinking and bilinear interpolation otherwise.
+  const ResampleFilter filter =
+      out_width < image->GetWidth() && out_height < image->GetHeight()
+          ? kBoxFilter
+          : kBilinearFilter;
+  return ResampleImage(image, out_width, out_height, filter, is_wipeable,
+                       allocator, NULL);
 }
 
 
@@ -1076,23 +1480,12 @@ ION_API void StraightAlphaFromPremultipliedAlpha(const gfx::ImagePtr& image) {
     return;
   }
 
-  const size_t byte_count = image->GetDataSize();
   base::DataContainerPtr data = image->GetData();
   uint8* image_bytes = data->GetMutableData<uint8>();
 
   switch (image->GetFormat()) {
     case gfx::Image::kRgba8888:
-      for (size_t i = 0; i < byte_count; i += 4) {
-        const uint8 alpha_byte = image_bytes[i + 3];
-        if (alpha_byte == 0)
-          continue;
-        const float inverse_alpha = 255.f / static_cast<float>(alpha_byte);
-        image_bytes[i] = MultiplyUint8ByFloat(image_bytes[i], inverse_alpha);
-        image_bytes[i + 1] =
-            MultiplyUint8ByFloat(image_bytes[i + 1], inverse_alpha);
-        image_bytes[i + 2] =
-            MultiplyUint8ByFloat(image_bytes[i + 2], inverse_alpha);
-      }
+      UnpremultiplyRgba8888Alpha(image_bytes, image->GetDataSize() / 4U);
       break;
     default:
       DLOG(WARNING) << "Converting premultiplied alpha to straight alpha from"
@@ -27,6 +27,7 @@ limitations under the License.
 //    RGBA-type format to an RGB-type format. An alpha channel containing all
 //    full-opacity values may be added to convert the other way.
 
+#include <functional>
 #include <vector>
 
 #include "base/integral_types.h"
@@ -34,11 +35,16 @@ limitations under the License.
 #include "ion/gfx/image.h"
 
 namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
 namespace image {
 
 // External image formats supported by ConvertToExternalImageData().
 enum ExternalImageFormat {
-  kPng
+  kPng,
+  kJpeg
 };
 
 // Converts an existing Image to the given target format and returns the
@@ -55,6 +61,17 @@ enum ExternalImageFormat {
 //   kR8 <- kDxt1
 //   kR8 <- kDxt5
 //   kR8 <- kEtc1
+//   kEtc2Rgb -> kRgb888
+//   kEtc2Rgba1, kEtc2Rgba and all ASTC formats -> kRgba8888
+//   kEacR11 -> kR8
+//   kEacRg11 -> kRg8
+//   kRgb888, kRgba8888, kRgb32f, kRgba32f, kRgb16fHalf, kRgba16fHalf, kRgb10a2
+//     and kRgb11f_11f_10f_Rev <-> each other, as long as one of the formats is
+//     a float format.
+//
+// The ETC2, EAC and ASTC formats can only be decoded, using the decoders in
+// blockdecoders.h. Their decoded images are then converted further if a
+// conversion from the decoded format to |target_format| is supported.
 //
 // Note also that kPvrtc1Rgba2 only supports power-of-two-sized square textures
 // at least 8x8 pixels in size.
@@ -63,7 +80,13 @@ enum ExternalImageFormat {
 // images can be used as luminance textures and use 1/4 the GPU memory of an
 // uncompressed monochrome Rgb image.
 //
-// Conversion between 3-component and 4-component formats is not yet supported.
+// The float conversions go through RGBA floats using the kernels in
+// pixelkernels.h. 8-bit values map to [0, 1], and values outside the range of
+// the target format are clamped; alpha is 1 when converting from a format
+// without it.
+//
+// Conversion between other 3-component and 4-component formats is not yet
+// supported.
 // The |is_wipeable| flag is passed to the DataContainer for the new Image.
 // |allocator| is used for the resulting image; if it is NULL, the default
 // allocator is used. |temporary_allocator| is used for internal allocations
@@ -74,6 +97,18 @@ ION_API const gfx::ImagePtr ConvertImage(
     const base::AllocatorPtr& allocator,
     const base::AllocatorPtr& temporary_allocator);
 
+// Same as above, but if |scheduler| is non-NULL, compression to kDxt1, kDxt5
+// and kEtc1 is split into strips of 4x4 blocks that are compressed in parallel
+// on the scheduler's threads. The result is identical to compressing the image
+// on the calling thread. PVRTC blocks depend on their neighbors and are always
+// compressed on the calling thread.
+ION_API const gfx::ImagePtr ConvertImage(
+    const gfx::ImagePtr& image, gfx::Image::Format target_format,
+    bool is_wipeable,
+    const base::AllocatorPtr& allocator,
+    const base::AllocatorPtr& temporary_allocator,
+    base::TaskScheduler* scheduler);
+
 // Converts external image |data| to an ImagePtr with data in canonical format.
 // |data_size| is the number of bytes in |data|. Input format is inferred
 // from |data|.
@@ -125,29 +160,124 @@ ION_API const gfx::ImagePtr ConvertFromExternalImageData(
 // Returns true if "Ion raw" format header is detected in |data|.
 ION_API bool IsIonRawImageFormat(const void* data, size_t data_size);
 
+// Reads only the header of external image |data| (in any format supported by
+// ConvertFromExternalImageData()) and returns the dimensions and format that
+// decoding it produces in |width|, |height| and |format|. Returns false if the
+// data is not recognized.
+ION_API bool GetExternalImageDataInfo(
+    const void* data, size_t data_size, uint32* width, uint32* height,
+    gfx::Image::Format* format);
+
+// Called by DecodeExternalImageData() each time rows [first_row, first_row +
+// row_count) of the target image have been written.
+typedef std::function<void(uint32 first_row, uint32 row_count)>
+    DecodedRowsCallback;
+
+// Decodes external image |data| straight into the data container of |image|,
+// which must already have the dimensions returned by
+// GetExternalImageDataInfo(). Flipping and conversion to the format of |image|
+// are done row by row while writing, so no intermediate Image is created. The
+// format of |image| may be the decoded format or, for 8-bit luminance, RGB
+// and RGBA data and 16-bit RGB565 and RGBA4444 data, one of kR8, kRgb888,
+// kRgba8888, kRgb565, kRgba4444 or kRgba5551. |rows_ready|, if set, is called
+// after each strip of rows is written, e.g., to upload it. Returns false if
+// the data cannot be decoded or converted to the format of |image|.
+ION_API bool DecodeExternalImageData(
+    const void* data, size_t data_size, bool flip_vertically,
+    const gfx::ImagePtr& image, const DecodedRowsCallback& rows_ready);
+
+// A piece of external image data to decode with
+// ConvertFromExternalImageDataBatch(), as for ConvertFromExternalImageData().
+// The decoded image is converted to |target_format| with ConvertImage(), or
+// kept in its decoded format if |target_format| is kInvalid.
+struct ExternalImageDecodeRequest {
+  ExternalImageDecodeRequest()
+      : data(NULL),
+        data_size(0U),
+        target_format(gfx::Image::kInvalid),
+        flip_vertically(false) {}
+  ExternalImageDecodeRequest(const void* data_in, size_t data_size_in,
+                             gfx::Image::Format target_format_in,
+                             bool flip_vertically_in)
+      : data(data_in),
+        data_size(data_size_in),
+        target_format(target_format_in),
+        flip_vertically(flip_vertically_in) {}
+
+  const void* data;
+  size_t data_size;
+  gfx::Image::Format target_format;
+  bool flip_vertically;
+};
+
+// Called by ConvertFromExternalImageDataBatch() with the index of each request
+// and its image, which is NULL if decoding or converting it failed.
+typedef std::function<void(size_t index, const gfx::ImagePtr& image)>
+    DecodedImageCallback;
+
+// Decodes, flips and converts each of |requests|, returning the resulting
+// images in the same order; failed requests have NULL images. If |scheduler|
+// is not NULL, the requests are decoded in parallel on its threads, and
+// otherwise on the calling thread. |image_ready|, if set, is called as soon as
+// each image is done, e.g., to start uploading it before the whole batch is
+// decoded; it may be called from any of the scheduler's threads, but never
+// concurrently. Conversions that the rows of the decoded image support (see
+// DecodeExternalImageData()) are done while writing the result, and others go
+// through an intermediate image in the decoded format that is allocated from
+// a per-thread arena (see base::ArenaAllocator) sized for the largest one, so
+// the threads do not contend for the heap. The |is_wipeable| flag and
+// |allocator| are used for the resulting images as for
+// ConvertFromExternalImageData().
+ION_API const std::vector<gfx::ImagePtr> ConvertFromExternalImageDataBatch(
+    const std::vector<ExternalImageDecodeRequest>& requests, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler,
+    const DecodedImageCallback& image_ready);
+
 // Converts an existing Image to data in |external_format|, returning a vector.
 // If |flip_vertically| is true, the resulting image is inverted in the Y
 // dimension. The vector will be empty if the conversion is not possible for any
-// reason. Note that converting to JPEG is not currently supported.
+// reason. JPEG data is written with kDefaultJpegQuality by EncodeJpeg(), which
+// also lists the formats it supports; use it directly to pick the quality.
 ION_API const std::vector<uint8> ConvertToExternalImageData(
     const gfx::ImagePtr& image, ExternalImageFormat external_format,
     bool flip_vertically);
 
-// Returns an image half the width and height of |image|. Currently only kDxt1,
-// kDxt5, kEtc1, and 8-bit-per-channel images are supported; other input formats
-// will return a NULL pointer. The |is_wipeable| flag is passed to the
-// DataContainer for the new Image. |allocator| is used for allocating the
-// resulting image, unless it is NULL, then the default C++ allocator will be
-// used.
+// Returns an image half the width and height of |image|, rounded up.
+// Currently only kDxt1, kDxt5, kEtc1, and images that ResampleImage() supports
+// are supported; other input formats will return a NULL pointer, as will
+// images with a width or height of 1. Since Ion cannot encode ETC2, EAC and
+// ASTC images, convert them to an uncompressed format before downsampling
+// them. The |is_wipeable| flag is passed to the DataContainer for the new
+// Image. |allocator| is used for allocating the resulting image, unless it is
+// NULL, then the default C++ allocator will be used. If |scheduler| is not
+// NULL, uncompressed images are downsampled on its threads.
 ION_API const gfx::ImagePtr DownsampleImage2x(
     const gfx::ImagePtr& image, bool is_wipeable,
     const base::AllocatorPtr& allocator);
+ION_API const gfx::ImagePtr DownsampleImage2x(
+    const gfx::ImagePtr& image, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler);
 
-// Returns a copy of |image| scaled to the specified dimensions. Currently only
-// 8-bit-per-channel formats work; other input formats will return a NULL
-// pointer. The |is_wipeable| flag is passed to the DataContainer for the new
-// Image. |allocator| is used for allocating the resulting image, unless it is
-// NULL, then the default C++ allocator will be used.
+// Returns the mipmap chain of |image|: the first entry is |image| itself, and
+// each following one is half the size of the one before it, down to 1x1. Each
+// level is downsampled from the previous one, in parallel on the threads of
+// |scheduler| if it is not NULL. Compressed images are supported as by
+// DownsampleImage2x(), and the chain stops at the last level that can be
+// downsampled. It is usually faster and more accurate to generate the chain of
+// an uncompressed image and then compress each level with ConvertImage(). The
+// vector is empty if |image| has no data. The other arguments are as for
+// DownsampleImage2x().
+ION_API const std::vector<gfx::ImagePtr> GenerateMipmapChain(
+    const gfx::ImagePtr& image, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler);
+
+// Returns a copy of |image| scaled to the specified dimensions, using a box
+// filter if both dimensions shrink and bilinear interpolation otherwise. Use
+// ResampleImage() to choose the filter. Only formats that ResampleImage()
+// supports work; other input formats will return a NULL pointer. The
+// |is_wipeable| flag is passed to the DataContainer for the new Image.
+// |allocator| is used for allocating the resulting image, unless it is NULL,
+// then the default C++ allocator will be used.
 ION_API const gfx::ImagePtr ResizeImage(
     const gfx::ImagePtr& image, uint32 out_width, uint32 out_height,
     bool is_wipeable, const base::AllocatorPtr& allocator);
@@ -161,7 +291,8 @@ ION_API void FlipImage(const gfx::ImagePtr& image);
 ION_API void FlipImageHorizontally(const gfx::ImagePtr& image);
 
 // Converts a "pre-multiplied alpha" RGBA image into a "straight alpha" RGBA
-// image.  RGB values are divided by alpha (except when alpha = 0).
+// image.  RGB values are divided by alpha (except when alpha = 0) and clamped
+// to 255.
 ION_API void StraightAlphaFromPremultipliedAlpha(const gfx::ImagePtr& image);
 
 }  // namespace image
@@ -29,12 +29,30 @@
       'target_name' : 'ionimage',
       'type': 'static_library',
       'sources' : [
+        'binpacker.cc',
+        'binpacker.h',
+        'blockdecoders.cc',
+        'blockdecoders.h',
         'conversionutils.cc',
         'conversionutils.h',
+        'imageatlas.cc',
+        'imageatlas.h',
+        'jpegencoder.cc',
+        'jpegencoder.h',
         'ninepatch.cc',
         'ninepatch.h',
+        'pixelkernels.cc',
+        'pixelkernels.h',
         'renderutils.cc',
         'renderutils.h',
+        'resampleutils.cc',
+        'resampleutils.h',
+        'texturecontainer.cc',
+        'texturecontainer.h',
+        'textureprocessor.cc',
+        'textureprocessor.h',
+        'texturetranscoder.cc',
+        'texturetranscoder.h',
       ],
       'dependencies': [
         '../external/imagecompression.gyp:ionimagecompression',
@@ -0,0 +1,272 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/imageatlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/invalid.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/sampler.h"
+
+namespace ion {
+namespace image {
+
+namespace {
+
+using gfx::Image;
+using gfx::ImagePtr;
+using gfx::Sampler;
+using gfx::SamplerPtr;
+using gfx::Texture;
+using gfx::TexturePtr;
+using math::Point2f;
+using math::Point2ui;
+using math::Range2f;
+using math::Range2ui;
+using math::Vector2ui;
+
+// Returns a copy of |image| surrounded by |padding| pixels that repeat its
+// edge pixels.
+static const ImagePtr CreatePaddedImage(const ImagePtr& image, uint32 padding,
+                                        const base::AllocatorPtr& allocator) {
+  const Image::Format format = image->GetFormat();
+  const size_t pixel_size = Image::ComputeDataSize(format, 1U, 1U);
+  const uint32 width = image->GetWidth();
+  const uint32 height = image->GetHeight();
+  const uint32 padded_width = width + 2U * padding;
+  const uint32 padded_height = height + 2U * padding;
+  const size_t row_size = pixel_size * width;
+  const size_t padded_row_size = pixel_size * padded_width;
+
+  std::vector<uint8> data(padded_row_size * padded_height);
+  const uint8* source = image->GetData()->GetData<uint8>();
+  for (uint32 y = 0; y < padded_height; ++y) {
+    const uint32 source_y =
+        std::min(height - 1U, y < padding ? 0U : y - padding);
+    const uint8* source_row = &source[source_y * row_size];
+    uint8* row = &data[y * padded_row_size];
+    for (uint32 x = 0; x < padding; ++x) {
+      memcpy(&row[x * pixel_size], source_row, pixel_size);
+      memcpy(&row[(padding + width + x) * pixel_size],
+             &source_row[row_size - pixel_size], pixel_size);
+    }
+    memcpy(&row[padding * pixel_size], source_row, row_size);
+  }
+
+  // The data is wipeable since the image is only used as a sub-image.
+  ImagePtr padded(new (allocator) Image);
+  padded->Set(format, padded_width, padded_height,
+              base::DataContainer::CreateAndCopy<uint8>(
+                  &data[0], data.size(), true, allocator));
+  return padded;
+}
+
+// Carves a rectangle of |size| out of the best fitting rectangle in |rects|,
+// the one with the least area, replacing it with the parts left to its right
+// and above it. Returns false if no rectangle is large enough.
+static bool TakeFreeRect(const Vector2ui& size,
+                         base::AllocVector<Range2ui>* rects,
+                         Point2ui* position) {
+  size_t best = rects->size();
+  uint64 best_area = 0U;
+  for (size_t i = 0; i < rects->size(); ++i) {
+    const Vector2ui rect_size = (*rects)[i].GetSize();
+    const uint64 area = static_cast<uint64>(rect_size[0]) * rect_size[1];
+    if (rect_size[0] >= size[0] && rect_size[1] >= size[1] &&
+        (best == rects->size() || area < best_area)) {
+      best = i;
+      best_area = area;
+    }
+  }
+  if (best == rects->size())
+    return false;
+
+  const Range2ui rect = (*rects)[best];
+  rects->erase(rects->begin() + best);
+  const Point2ui& min = rect.GetMinPoint();
+  const Point2ui& max = rect.GetMaxPoint();
+  *position = min;
+  if (min[0] + size[0] < max[0])
+    rects->push_back(Range2ui(Point2ui(min[0] + size[0], min[1]),
+                              Point2ui(max[0], min[1] + size[1])));
+  if (min[1] + size[1] < max[1])
+    rects->push_back(Range2ui(Point2ui(min[0], min[1] + size[1]), max));
+  return true;
+}
+
+}  // anonymous namespace
+
+ImageAtlas::ImageAtlas(const Vector2ui& page_size, Image::Format format,
+                       uint32 padding, bool mipmapped)
+    : page_size_(page_size),
+      format_(format),
+      padding_(padding),
+      mipmapped_(mipmapped),
+      entries_(*this),
+      pages_(*this) {
+  DCHECK(!Image::IsCompressedFormat(format));
+}
+
+ImageAtlas::~ImageAtlas() {}
+
+bool ImageAtlas::AddImage(uint64 id, const ImagePtr& image) {
+  if (HasImage(id)) {
+    LOG(ERROR) << "ImageAtlas already contains an image with ID " << id;
+    return false;
+  }
+  if (!image.Get() || !image->GetWidth() || !image->GetHeight() ||
+      !image->GetData().Get() || !image->GetData()->GetData()) {
+    LOG(ERROR) << "Cannot add an image without data to an ImageAtlas";
+    return false;
+  }
+  if (image->GetFormat() != format_) {
+    LOG(ERROR) << "Cannot add an image of format "
+               << Image::GetFormatString(image->GetFormat())
+               << " to an ImageAtlas of format "
+               << Image::GetFormatString(format_);
+    return false;
+  }
+  const Vector2ui size(image->GetWidth() + 2U * padding_,
+                       image->GetHeight() + 2U * padding_);
+  if (size[0] > page_size_[0] || size[1] > page_size_[1]) {
+    LOG(ERROR) << "A " << image->GetWidth() << "x" << image->GetHeight()
+               << " image with " << padding_ << " pixels of padding does not "
+               << "fit into a " << page_size_[0] << "x" << page_size_[1]
+               << " ImageAtlas page";
+    return false;
+  }
+
+  Point2ui position;
+  const size_t page = AllocateRect(id, size, &position);
+  Page& p = pages_[page];
+  ++p.image_count;
+  p.texture->SetSubImage(0U, position,
+                         CreatePaddedImage(image, padding_, GetAllocator()));
+
+  Entry entry;
+  entry.page = page;
+  entry.pixel_rect = Range2ui::BuildWithSize(
+      position + Vector2ui(padding_, padding_),
+      Vector2ui(image->GetWidth(), image->GetHeight()));
+  const Point2ui& min = entry.pixel_rect.GetMinPoint();
+  const Point2ui& max = entry.pixel_rect.GetMaxPoint();
+  const float inv_width = 1.f / static_cast<float>(page_size_[0]);
+  const float inv_height = 1.f / static_cast<float>(page_size_[1]);
+  entry.texture_rect.Set(
+      Point2f(static_cast<float>(min[0]) * inv_width,
+              static_cast<float>(min[1]) * inv_height),
+      Point2f(static_cast<float>(max[0]) * inv_width,
+              static_cast<float>(max[1]) * inv_height));
+  entries_[id] = entry;
+  return true;
+}
+
+bool ImageAtlas::RemoveImage(uint64 id) {
+  EntryMap::iterator it = entries_.find(id);
+  if (it == entries_.end())
+    return false;
+  const Entry& entry = it->second;
+  Page& page = pages_[entry.page];
+  DCHECK_GT(page.image_count, 0U);
+  if (--page.image_count) {
+    const Vector2ui padding(padding_, padding_);
+    page.free_rects.push_back(
+        Range2ui(entry.pixel_rect.GetMinPoint() - padding,
+                 entry.pixel_rect.GetMaxPoint() + padding));
+  } else {
+    // The whole page is free again.
+    page.packer = BinPacker();
+    page.free_rects.clear();
+  }
+  entries_.erase(it);
+  return true;
+}
+
+const ImageAtlas::Entry& ImageAtlas::GetEntry(uint64 id) const {
+  EntryMap::const_iterator it = entries_.find(id);
+  return it == entries_.end() ? base::InvalidReference<Entry>() : it->second;
+}
+
+const TexturePtr ImageAtlas::GetPageTexture(size_t page) const {
+  return page < pages_.size() ? pages_[page].texture : TexturePtr();
+}
+
+size_t ImageAtlas::AllocateRect(uint64 id, const Vector2ui& size,
+                                Point2ui* position) {
+  // Reusing freed space first keeps the packed parts of pages from growing.
+  const size_t count = pages_.size();
+  for (size_t i = 0; i < count; ++i) {
+    if (TakeFreeRect(size, &pages_[i].free_rects, position))
+      return i;
+  }
+  // Otherwise try to pack the image into each page with a copy of its
+  // BinPacker, so that a failed attempt leaves the page unchanged.
+  for (size_t i = 0; i < count; ++i) {
+    BinPacker packer(pages_[i].packer);
+    packer.AddRectangle(id, size);
+    if (packer.Pack(page_size_)) {
+      pages_[i].packer = packer;
+      *position = packer.GetRectangles().back().bottom_left;
+      return i;
+    }
+  }
+  // The image always fits into a new page.
+  Page page(GetAllocator());
+  page.texture = CreatePageTexture();
+  page.packer.AddRectangle(id, size);
+  const bool packed = page.packer.Pack(page_size_);
+  DCHECK(packed);
+  (void)packed;
+  *position = page.packer.GetRectangles().back().bottom_left;
+  pages_.push_back(page);
+  return count;
+}
+
+const TexturePtr ImageAtlas::CreatePageTexture() const {
+  const base::AllocatorPtr& allocator = GetAllocator();
+  SamplerPtr sampler(new (allocator) Sampler);
+  sampler->SetLabel("ImageAtlas Sampler");
+  sampler->SetMinFilter(mipmapped_ ? Sampler::kLinearMipmapLinear
+                                   : Sampler::kLinear);
+  sampler->SetMagFilter(Sampler::kLinear);
+  sampler->SetWrapS(Sampler::kClampToEdge);
+  sampler->SetWrapT(Sampler::kClampToEdge);
+  sampler->SetAutogenerateMipmapsEnabled(mipmapped_);
+
+  // The page starts out cleared. Its data is wipeable because images are
+  // only ever added as sub-images.
+  const size_t data_size =
+      Image::ComputeDataSize(format_, page_size_[0], page_size_[1]);
+  std::vector<uint8> data(data_size, 0U);
+  ImagePtr image(new (allocator) Image);
+  image->Set(format_, page_size_[0], page_size_[1],
+             base::DataContainer::CreateAndCopy<uint8>(&data[0], data_size,
+                                                       true, allocator));
+
+  TexturePtr texture(new (allocator) Texture);
+  texture->SetLabel("ImageAtlas page");
+  texture->SetImage(0U, image);
+  texture->SetSampler(sampler);
+  return texture;
+}
+
+}  // namespace image
+}  // namespace ion
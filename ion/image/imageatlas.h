@@ -0,0 +1,143 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_IMAGEATLAS_H_
+#define ION_IMAGE_IMAGEATLAS_H_
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/referent.h"
+#include "ion/base/stlalloc/allocmap.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/texture.h"
+#include "ion/image/binpacker.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace image {
+
+// An ImageAtlas packs many small Images, such as icons or sprites, into one or
+// more page Textures using a BinPacker, so that they can be drawn with few
+// texture binds. Images can be added and removed at any time; each added image
+// is uploaded as a sub-image of its page the next time the page is drawn, so
+// existing images are never moved and their texture coordinates stay valid
+// until they are removed.
+//
+// Each image is surrounded by |padding| pixels that repeat its edge pixels, so
+// that neither linear filtering nor the smaller mipmap levels of a page bleed
+// neighboring images into it. The space of a removed image is reused for later
+// images that fit into it, and a page is reset once all of its images have
+// been removed.
+//
+// All images must have the format of the atlas, which must not be compressed.
+class ION_API ImageAtlas : public base::Referent {
+ public:
+  // Where an image was placed in the atlas.
+  struct Entry {
+    Entry() : page(0U) {}
+    // The index of the page containing the image.
+    size_t page;
+    // The pixels of the image in the page, without padding.
+    math::Range2ui pixel_rect;
+    // The texture coordinates of the image in the page.
+    math::Range2f texture_rect;
+  };
+  // Maps image IDs to their Entries.
+  typedef base::AllocMap<uint64, Entry> EntryMap;
+
+  // Creates an atlas whose pages are |page_size| images of |format|, with
+  // |padding| pixels around each image. If |mipmapped| is true, the page
+  // Samplers use trilinear filtering and mipmaps are regenerated whenever
+  // images are added; otherwise they use linear filtering.
+  ImageAtlas(const math::Vector2ui& page_size, gfx::Image::Format format,
+             uint32 padding, bool mipmapped);
+
+  // Adds |image| with the client-chosen |id| to the atlas, creating a new page
+  // if it does not fit into any existing one. Returns false (and logs a
+  // message) if |id| is already in use, or if the image has no data, has the
+  // wrong format, or is too large for a page with its padding.
+  bool AddImage(uint64 id, const gfx::ImagePtr& image);
+
+  // Removes the image with |id| from the atlas, returning false if there is
+  // none. Its pixels remain in the page until they are reused.
+  bool RemoveImage(uint64 id);
+
+  // Returns whether the atlas contains an image with |id|.
+  bool HasImage(uint64 id) const { return entries_.count(id) != 0; }
+
+  // Returns the Entry of the image with |id|, or an InvalidReference if there
+  // is none.
+  const Entry& GetEntry(uint64 id) const;
+
+  // Returns the Entries of all images, which can be used to remap the texture
+  // coordinates of geometry drawing individual images to the atlas.
+  const EntryMap& GetEntries() const { return entries_; }
+
+  // Returns the number of pages, and the Texture of a page, which is NULL if
+  // |page| is out of range.
+  size_t GetPageCount() const { return pages_.size(); }
+  const gfx::TexturePtr GetPageTexture(size_t page) const;
+
+  const math::Vector2ui& GetPageSize() const { return page_size_; }
+  gfx::Image::Format GetFormat() const { return format_; }
+  uint32 GetPadding() const { return padding_; }
+
+ private:
+  // A page Texture with the packing state of its images.
+  struct Page {
+    explicit Page(const base::AllocatorPtr& allocator)
+        : free_rects(allocator), image_count(0U) {}
+    gfx::TexturePtr texture;
+    // Packs images into the parts of the page that have never been used.
+    BinPacker packer;
+    // Padded rectangles freed by RemoveImage() that can be reused.
+    base::AllocVector<math::Range2ui> free_rects;
+    // The number of images in the page.
+    size_t image_count;
+  };
+
+  // The destructor is private because all base::Referent classes must have
+  // protected or private destructors.
+  ~ImageAtlas() override;
+
+  // Finds room for a padded image of |size| with |id|, adding a page if
+  // necessary. Returns the index of the page and the position in it.
+  size_t AllocateRect(uint64 id, const math::Vector2ui& size,
+                      math::Point2ui* position);
+
+  // Returns a new page Texture.
+  const gfx::TexturePtr CreatePageTexture() const;
+
+  const math::Vector2ui page_size_;
+  const gfx::Image::Format format_;
+  const uint32 padding_;
+  const bool mipmapped_;
+  EntryMap entries_;
+  base::AllocVector<Page> pages_;
+
+  DISALLOW_COPY_AND_ASSIGN(ImageAtlas);
+};
+
+// Convenience typedef.
+typedef base::ReferentPtr<ImageAtlas>::Type ImageAtlasPtr;
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_IMAGEATLAS_H_
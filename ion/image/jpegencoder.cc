@@ -0,0 +1,398 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/jpegencoder.h"
+
+#include <string.h>  // For memset().
+
+#include <algorithm>
+#include <cmath>
+
+#include "base/macros.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+
+namespace {
+
+//-----------------------------------------------------------------------------
+//
+// Tables from Annex K of the JPEG standard.
+//
+//-----------------------------------------------------------------------------
+
+// The index in each 8x8 block, in row-major order, of each coefficient in the
+// zigzag order in which they are stored.
+static const uint8 kZigzag[64] = {
+    0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+   12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+   35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+   58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
+
+// Quantization tables for quality 50, in row-major order.
+static const uint8 kLuminanceQuantization[64] = {
+   16,  11,  10,  16,  24,  40,  51,  61,
+   12,  12,  14,  19,  26,  58,  60,  55,
+   14,  13,  16,  24,  40,  57,  69,  56,
+   14,  17,  22,  29,  51,  87,  80,  62,
+   18,  22,  37,  56,  68, 109, 103,  77,
+   24,  35,  55,  64,  81, 104, 113,  92,
+   49,  64,  78,  87, 103, 121, 120, 101,
+   72,  92,  95,  98, 112, 100, 103,  99 };
+static const uint8 kChrominanceQuantization[64] = {
+   17,  18,  24,  47,  99,  99,  99,  99,
+   18,  21,  26,  66,  99,  99,  99,  99,
+   24,  26,  56,  99,  99,  99,  99,  99,
+   47,  66,  99,  99,  99,  99,  99,  99,
+   99,  99,  99,  99,  99,  99,  99,  99,
+   99,  99,  99,  99,  99,  99,  99,  99,
+   99,  99,  99,  99,  99,  99,  99,  99,
+   99,  99,  99,  99,  99,  99,  99,  99 };
+
+// Huffman tables, as the number of codes of each length from 1 to 16 followed
+// by the coded values.
+static const uint8 kLuminanceDcBits[16] = {
+    0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8 kChrominanceDcBits[16] = {
+    0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+static const uint8 kDcValues[12] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+static const uint8 kLuminanceAcBits[16] = {
+    0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+static const uint8 kLuminanceAcValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+    0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa };
+static const uint8 kChrominanceAcBits[16] = {
+    0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+static const uint8 kChrominanceAcValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+    0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+    0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+    0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+    0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa };
+
+//-----------------------------------------------------------------------------
+//
+// Encoder state.
+//
+//-----------------------------------------------------------------------------
+
+// The code and length of each value of a Huffman table.
+struct HuffmanTable {
+  HuffmanTable(const uint8* bits, const uint8* values) {
+    memset(codes, 0, sizeof(codes));
+    memset(lengths, 0, sizeof(lengths));
+    uint16 code = 0;
+    int index = 0;
+    for (int length = 1; length <= 16; ++length) {
+      for (int i = 0; i < bits[length - 1]; ++i, ++index) {
+        codes[values[index]] = code++;
+        lengths[values[index]] = static_cast<uint8>(length);
+      }
+      code = static_cast<uint16>(code << 1);
+    }
+  }
+  uint16 codes[256];
+  uint8 lengths[256];
+};
+
+// Writes the entropy-coded segment, stuffing a zero byte after each 0xff.
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8>* out)
+      : out_(out), buffer_(0), count_(0) {}
+
+  void Write(uint32 bits, int length) {
+    DCHECK_LE(length, 16);
+    buffer_ = (buffer_ << length) | (bits & ((1U << length) - 1U));
+    count_ += length;
+    while (count_ >= 8) {
+      count_ -= 8;
+      const uint8 byte = static_cast<uint8>(buffer_ >> count_);
+      out_->push_back(byte);
+      if (byte == 0xff)
+        out_->push_back(0);
+    }
+  }
+
+  // Pads the last byte with one bits.
+  void Flush() {
+    if (count_)
+      Write(0x7f, 8 - count_);
+  }
+
+ private:
+  std::vector<uint8>* out_;
+  uint32 buffer_;
+  int count_;
+};
+
+// Returns the number of bits needed for the magnitude of |value|.
+static int GetBitLength(int value) {
+  int magnitude = value < 0 ? -value : value;
+  int length = 0;
+  while (magnitude) {
+    ++length;
+    magnitude >>= 1;
+  }
+  return length;
+}
+
+// Returns the table for the quality 50 |base| scaled to |quality| the way the
+// IJG library does, in zigzag order.
+static void ScaleQuantization(const uint8* base, int quality, uint8* table) {
+  const int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+  for (int i = 0; i < 64; ++i) {
+    const int value = (base[kZigzag[i]] * scale + 50) / 100;
+    table[i] = static_cast<uint8>(std::min(255, std::max(1, value)));
+  }
+}
+
+// Encodes the 8x8 |block| of level shifted samples with forward DCT
+// |transform|, quantizing with |quantization| and updating the predicted DC
+// value |dc|.
+static void EncodeBlock(const float* block, const float transform[8][8],
+                        const uint8* quantization, const HuffmanTable& dc_table,
+                        const HuffmanTable& ac_table, int* dc,
+                        BitWriter* writer) {
+  // Transform the rows, then the columns.
+  float rows[64];
+  for (int y = 0; y < 8; ++y) {
+    for (int u = 0; u < 8; ++u) {
+      float sum = 0.f;
+      for (int x = 0; x < 8; ++x)
+        sum += transform[u][x] * block[y * 8 + x];
+      rows[y * 8 + u] = sum;
+    }
+  }
+  int coefficients[64];
+  for (int i = 0; i < 64; ++i) {
+    const int u = kZigzag[i] & 7;
+    const int v = kZigzag[i] >> 3;
+    float sum = 0.f;
+    for (int y = 0; y < 8; ++y)
+      sum += transform[v][y] * rows[y * 8 + u];
+    coefficients[i] = static_cast<int>(std::floor(
+        sum / static_cast<float>(quantization[i]) + 0.5f));
+  }
+
+  // Values are written as their bit length category followed by the low bits
+  // of the value, minus one if it is negative.
+  const int diff = coefficients[0] - *dc;
+  *dc = coefficients[0];
+  int length = GetBitLength(diff);
+  writer->Write(dc_table.codes[length], dc_table.lengths[length]);
+  if (length)
+    writer->Write(static_cast<uint32>(diff < 0 ? diff - 1 : diff), length);
+
+  int run = 0;
+  for (int i = 1; i < 64; ++i) {
+    const int value = coefficients[i];
+    if (!value) {
+      ++run;
+      continue;
+    }
+    // Each run of 16 zeros is written as 0xf0.
+    while (run >= 16) {
+      writer->Write(ac_table.codes[0xf0], ac_table.lengths[0xf0]);
+      run -= 16;
+    }
+    length = GetBitLength(value);
+    const int symbol = (run << 4) | length;
+    writer->Write(ac_table.codes[symbol], ac_table.lengths[symbol]);
+    writer->Write(static_cast<uint32>(value < 0 ? value - 1 : value), length);
+    run = 0;
+  }
+  // The end of block code stands for the trailing zeros.
+  if (run)
+    writer->Write(ac_table.codes[0], ac_table.lengths[0]);
+}
+
+static void WriteUint16(uint32 value, std::vector<uint8>* out) {
+  out->push_back(static_cast<uint8>(value >> 8));
+  out->push_back(static_cast<uint8>(value));
+}
+
+static void WriteHuffmanTable(uint8 id, const uint8* bits, const uint8* values,
+                              std::vector<uint8>* out) {
+  out->push_back(id);
+  out->insert(out->end(), bits, bits + 16);
+  int count = 0;
+  for (int i = 0; i < 16; ++i)
+    count += bits[i];
+  out->insert(out->end(), values, values + count);
+}
+
+}  // anonymous namespace
+
+bool IsJpegEncodingSupported(Image::Format format) {
+  return format == Image::kR8 || format == Image::kLuminance ||
+         format == Image::kLuminanceAlpha || format == Image::kRgb888 ||
+         format == Image::kRgba8888;
+}
+
+const std::vector<uint8> EncodeJpeg(const Image& image, int quality,
+                                    bool flip_vertically) {
+  std::vector<uint8> out;
+  const Image::Format format = image.GetFormat();
+  const uint32 width = image.GetWidth();
+  const uint32 height = image.GetHeight();
+  if (!IsJpegEncodingSupported(format) || !image.GetData().Get() ||
+      !image.GetData()->GetData() || !width || !height)
+    return out;
+  if (width > 0xffff || height > 0xffff) {
+    LOG(WARNING) << "Images larger than 65535 pixels cannot be encoded as JPEG";
+    return out;
+  }
+  quality = std::min(100, std::max(1, quality));
+
+  const int stride = static_cast<int>(Image::GetNumComponentsForFormat(format));
+  const bool is_color = stride >= 3;
+  const int component_count = is_color ? 3 : 1;
+  const uint8* pixels = image.GetData()->GetData<uint8>();
+
+  uint8 quantization[2][64];
+  ScaleQuantization(kLuminanceQuantization, quality, quantization[0]);
+  ScaleQuantization(kChrominanceQuantization, quality, quantization[1]);
+
+  // Headers.
+  static const uint8 kJfifHeader[] = {
+      0xff, 0xd8, 0xff, 0xe0, 0, 16, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0,
+      1, 0, 0 };
+  out.insert(out.end(), kJfifHeader, kJfifHeader + ARRAYSIZE(kJfifHeader));
+  out.push_back(0xff);
+  out.push_back(0xdb);
+  const int table_count = is_color ? 2 : 1;
+  WriteUint16(2 + 65 * table_count, &out);
+  for (int i = 0; i < table_count; ++i) {
+    out.push_back(static_cast<uint8>(i));
+    out.insert(out.end(), quantization[i], quantization[i] + 64);
+  }
+  out.push_back(0xff);
+  out.push_back(0xc0);
+  WriteUint16(8 + 3 * component_count, &out);
+  out.push_back(8);
+  WriteUint16(height, &out);
+  WriteUint16(width, &out);
+  out.push_back(static_cast<uint8>(component_count));
+  for (int i = 0; i < component_count; ++i) {
+    out.push_back(static_cast<uint8>(i + 1));
+    out.push_back(0x11);
+    out.push_back(i ? 1 : 0);
+  }
+  out.push_back(0xff);
+  out.push_back(0xc4);
+  WriteUint16(2 + (17 + 12 + 17 + 162) * table_count, &out);
+  WriteHuffmanTable(0x00, kLuminanceDcBits, kDcValues, &out);
+  WriteHuffmanTable(0x10, kLuminanceAcBits, kLuminanceAcValues, &out);
+  if (is_color) {
+    WriteHuffmanTable(0x01, kChrominanceDcBits, kDcValues, &out);
+    WriteHuffmanTable(0x11, kChrominanceAcBits, kChrominanceAcValues, &out);
+  }
+  out.push_back(0xff);
+  out.push_back(0xda);
+  WriteUint16(6 + 2 * component_count, &out);
+  out.push_back(static_cast<uint8>(component_count));
+  for (int i = 0; i < component_count; ++i) {
+    out.push_back(static_cast<uint8>(i + 1));
+    out.push_back(i ? 0x11 : 0x00);
+  }
+  out.push_back(0);
+  out.push_back(63);
+  out.push_back(0);
+
+  // The DCT basis, scaled so that it is orthonormal.
+  float transform[8][8];
+  for (int u = 0; u < 8; ++u) {
+    const float scale = u ? 0.5f : 0.5f / std::sqrt(2.f);
+    for (int x = 0; x < 8; ++x)
+      transform[u][x] = scale * std::cos(static_cast<float>(M_PI) *
+                                         static_cast<float>((2 * x + 1) * u) /
+                                         16.f);
+  }
+  const HuffmanTable luminance_dc(kLuminanceDcBits, kDcValues);
+  const HuffmanTable luminance_ac(kLuminanceAcBits, kLuminanceAcValues);
+  const HuffmanTable chrominance_dc(kChrominanceDcBits, kDcValues);
+  const HuffmanTable chrominance_ac(kChrominanceAcBits, kChrominanceAcValues);
+
+  // Blocks that extend past the image repeat its last row and column.
+  BitWriter writer(&out);
+  int dc[3] = { 0, 0, 0 };
+  float blocks[3][64];
+  const size_t row_size = width * stride;
+  for (uint32 block_y = 0; block_y < height; block_y += 8) {
+    for (uint32 block_x = 0; block_x < width; block_x += 8) {
+      for (uint32 y = 0; y < 8; ++y) {
+        const uint32 image_y = std::min(block_y + y, height - 1U);
+        const uint8* row =
+            pixels +
+            (flip_vertically ? height - 1U - image_y : image_y) * row_size;
+        for (uint32 x = 0; x < 8; ++x) {
+          const uint8* pixel = row + std::min(block_x + x, width - 1U) * stride;
+          const int i = y * 8 + x;
+          if (is_color) {
+            const float r = pixel[0];
+            const float g = pixel[1];
+            const float b = pixel[2];
+            blocks[0][i] = 0.299f * r + 0.587f * g + 0.114f * b - 128.f;
+            blocks[1][i] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+            blocks[2][i] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+          } else {
+            blocks[0][i] = static_cast<float>(pixel[0]) - 128.f;
+          }
+        }
+      }
+      EncodeBlock(blocks[0], transform, quantization[0], luminance_dc,
+                  luminance_ac, &dc[0], &writer);
+      for (int c = 1; c < component_count; ++c)
+        EncodeBlock(blocks[c], transform, quantization[1], chrominance_dc,
+                    chrominance_ac, &dc[c], &writer);
+    }
+  }
+  writer.Flush();
+  out.push_back(0xff);
+  out.push_back(0xd9);
+  return out;
+}
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,53 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_JPEGENCODER_H_
+#define ION_IMAGE_JPEGENCODER_H_
+
+// This file contains a baseline JPEG encoder, which writes JFIF files using
+// the example quantization and Huffman tables of the JPEG standard. Color
+// images are written as full-resolution YCbCr, and single-channel images as
+// grayscale. It is meant for previews and screenshots, where encoding speed
+// matters more than file size.
+
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/gfx/image.h"
+
+namespace ion {
+namespace image {
+
+// The quality used for JPEG data when none is specified.
+static const int kDefaultJpegQuality = 90;
+
+// Returns whether images in the given format can be encoded as JPEG. These are
+// the 8-bit formats kR8, kLuminance, kLuminanceAlpha, kRgb888 and kRgba8888;
+// alpha channels are dropped.
+ION_API bool IsJpegEncodingSupported(gfx::Image::Format format);
+
+// Encodes |image| as a JPEG file with the given |quality|, which is clamped to
+// [1, 100]. If |flip_vertically| is true, the rows are written bottom to top.
+// Returns an empty vector if the image has no data or its format is not
+// supported.
+ION_API const std::vector<uint8> EncodeJpeg(const gfx::Image& image,
+                                            int quality, bool flip_vertically);
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_JPEGENCODER_H_
@@ -22,7 +22,12 @@ limitations under the License.
 #include "base/integral_types.h"
 #include "ion/base/allocationmanager.h"
 #include "ion/base/datacontainer.h"
+#include "ion/base/lockguards.h"
 #include "ion/base/logging.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfxutils/buffertoattributebinder.h"
 
 namespace ion {
 namespace image {
@@ -34,6 +39,7 @@ using base::DataContainerPtr;
 using gfx::Image;
 using gfx::ImagePtr;
 using math::Point2f;
+using math::Point3f;
 using math::Point2ui;
 using math::Range1ui;
 using math::Range2f;
@@ -46,6 +52,12 @@ typedef base::AllocMap<uint32, uint32> RegionMap;
 // The value of a marked pixel.
 static const uint32 kMarked = 0xff000000;
 
+// A vertex of the Shape returned by NinePatch::BuildShape().
+struct Vertex {
+  Point3f position;
+  Point2f texture_coords;
+};
+
 // Reads the stretch regions from a ninepatch image and adds a set of regions to
 // the passed map.
 static void ReadStretchRegions(const ImagePtr& image, RegionMap* regions,
@@ -201,7 +213,11 @@ struct NinePatch::Region {
 };
 
 NinePatch::NinePatch(const ImagePtr& image)
-    : regions_h_(*this), regions_v_(*this), wipeable_(true) {
+    : regions_h_(*this),
+      regions_v_(*this),
+      wipeable_(true),
+      image_cache_(*this),
+      cache_capacity_(0U) {
   if (image.Get() && image->GetWidth() && image->GetHeight() &&
       image->GetFormat() == Image::kRgba8888 && image->GetData().Get() &&
       image->GetData()->GetData()) {
@@ -218,6 +234,121 @@ NinePatch::~NinePatch() {}
 
 const ImagePtr NinePatch::BuildImage(uint32 width, uint32 height,
                                      const base::AllocatorPtr& alloc) const {
+  base::LockGuard guard(&cache_mutex_);
+  if (!cache_capacity_)
+    return CreateImage(width, height, alloc);
+
+  const Vector2ui size(width, height);
+  for (size_t i = 0; i < image_cache_.size(); ++i) {
+    if (image_cache_[i].size != size)
+      continue;
+    const ImagePtr image = image_cache_[i].image;
+    image_cache_.erase(image_cache_.begin() + i);
+    // A wiped image has no data to give to another Texture, so rebuild it.
+    if (image->GetData()->GetData()) {
+      CachedImage entry = { size, image };
+      image_cache_.insert(image_cache_.begin(), entry);
+      return image;
+    }
+    break;
+  }
+  CachedImage entry = { size, CreateImage(width, height, alloc) };
+  image_cache_.insert(image_cache_.begin(), entry);
+  if (image_cache_.size() > cache_capacity_)
+    image_cache_.resize(cache_capacity_);
+  return entry.image;
+}
+
+const gfx::ShapePtr NinePatch::BuildShape(
+    uint32 width, uint32 height, const base::AllocatorPtr& alloc) const {
+  if (!image_.Get())
+    return gfx::ShapePtr();
+  const Vector2ui min_size = GetMinimumSize();
+  const base::AllocVector<Region> regions = GetRegionsForSize(
+      std::max(min_size[0], width), std::max(min_size[1], height));
+  // Each region is a quad with its own vertices, so that the texture
+  // coordinates of neighboring regions can differ; the index type limits the
+  // number of quads.
+  const size_t count = regions.size();
+  if (!count || count * 4U > 0x10000U)
+    return gfx::ShapePtr();
+
+  base::AllocatorPtr allocator =
+      base::AllocationManager::GetNonNullAllocator(alloc);
+  const Vector2f inv_source_size(
+      1.f / static_cast<float>(image_->GetWidth()),
+      1.f / static_cast<float>(image_->GetHeight()));
+  base::AllocVector<Vertex> vertices(allocator);
+  base::AllocVector<uint16> indices(allocator);
+  vertices.reserve(count * 4U);
+  indices.reserve(count * 6U);
+  for (size_t i = 0; i < count; ++i) {
+    const Range2ui& source = regions[i].source;
+    const Range2f& dest = regions[i].dest;
+    const uint16 first = static_cast<uint16>(vertices.size());
+    for (int corner = 0; corner < 4; ++corner) {
+      // The corners are visited counter-clockwise from the minimum point.
+      const int x = (corner == 1 || corner == 2) ? 1 : 0;
+      const int y = corner >= 2 ? 1 : 0;
+      Vertex v;
+      v.position.Set(
+          x ? dest.GetMaxPoint()[0] : dest.GetMinPoint()[0],
+          y ? dest.GetMaxPoint()[1] : dest.GetMinPoint()[1], 0.f);
+      v.texture_coords.Set(
+          static_cast<float>(x ? source.GetMaxPoint()[0]
+                               : source.GetMinPoint()[0]) * inv_source_size[0],
+          static_cast<float>(y ? source.GetMaxPoint()[1]
+                               : source.GetMinPoint()[1]) * inv_source_size[1]);
+      vertices.push_back(v);
+    }
+    static const uint16 kQuadIndices[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int j = 0; j < 6; ++j)
+      indices.push_back(static_cast<uint16>(first + kQuadIndices[j]));
+  }
+
+  gfx::BufferObjectPtr buffer_object(new (allocator) gfx::BufferObject);
+  buffer_object->SetData(
+      DataContainer::CreateAndCopy<Vertex>(&vertices[0], vertices.size(),
+                                           wipeable_, allocator),
+      sizeof(Vertex), vertices.size(), gfx::BufferObject::kStaticDraw);
+  gfx::AttributeArrayPtr attribute_array(new (allocator) gfx::AttributeArray);
+  Vertex v;
+  gfxutils::BufferToAttributeBinder<Vertex>(v)
+      .Bind(v.position, "aVertex")
+      .Bind(v.texture_coords, "aTexCoords")
+      .Apply(gfx::ShaderInputRegistry::GetGlobalRegistry(), attribute_array,
+             buffer_object);
+
+  gfx::IndexBufferPtr index_buffer(new (allocator) gfx::IndexBuffer);
+  index_buffer->AddSpec(gfx::BufferObject::kUnsignedShort, 1, 0);
+  index_buffer->SetData(
+      DataContainer::CreateAndCopy<uint16>(&indices[0], indices.size(),
+                                           wipeable_, allocator),
+      sizeof(uint16), indices.size(), gfx::BufferObject::kStaticDraw);
+
+  gfx::ShapePtr shape(new (allocator) gfx::Shape);
+  shape->SetLabel("NinePatch");
+  shape->SetPrimitiveType(gfx::Shape::kTriangles);
+  shape->SetAttributeArray(attribute_array);
+  shape->SetIndexBuffer(index_buffer);
+  return shape;
+}
+
+void NinePatch::SetBuildWipeable(bool wipeable) {
+  base::LockGuard guard(&cache_mutex_);
+  wipeable_ = wipeable;
+  image_cache_.clear();
+}
+
+void NinePatch::SetImageCacheCapacity(size_t capacity) {
+  base::LockGuard guard(&cache_mutex_);
+  cache_capacity_ = capacity;
+  if (image_cache_.size() > capacity)
+    image_cache_.resize(capacity);
+}
+
+const ImagePtr NinePatch::CreateImage(uint32 width, uint32 height,
+                                      const base::AllocatorPtr& alloc) const {
   base::AllocatorPtr allocator =
       base::AllocationManager::GetNonNullAllocator(alloc);
 
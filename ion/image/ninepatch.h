@@ -24,8 +24,10 @@ limitations under the License.
 #include "ion/base/stlalloc/allocvector.h"
 #include "ion/external/gtest/gunit_prod.h"
 #include "ion/gfx/image.h"
+#include "ion/gfx/shape.h"
 #include "ion/math/range.h"
 #include "ion/math/vector.h"
+#include "ion/port/mutex.h"
 
 namespace ion {
 namespace image {
@@ -53,14 +55,42 @@ class ION_API NinePatch : public base::Referent {
   // image will be the minimum size instead. If the nine-patch has no stretch
   // regions along one or both dimensions, the returned image will be padded
   // with transparent pixels along the bottom and/or right edges.
+  //
+  // If the image cache is enabled (see SetImageCacheCapacity()), an image
+  // built earlier at the same size is returned instead of a new one as long
+  // as its data has not been wiped, so callers must not modify it. A cached
+  // image keeps the Allocator it was first built with.
   const gfx::ImagePtr BuildImage(uint32 width, uint32 height,
                                  const base::AllocatorPtr& alloc) const;
 
+  // Returns a Shape that draws this nine-patch at the given size when it is
+  // textured with the source image, so that the stretching is done by the GPU
+  // rather than by BuildImage(). The Shape has one quad (two triangles) per
+  // region, with "aVertex" positions in the pixel coordinates of the image
+  // BuildImage() would return, i.e., x in [0, width] and y in [0, height]
+  // where y = 0 is the first row of the source image, and "aTexCoords" that
+  // address the matching pixels of the source image. Sample the source with
+  // nearest filtering to match BuildImage() exactly. The size is clamped to
+  // the minimum size. Returns a NULL pointer if the source image was invalid
+  // or has no stretch regions. All objects are allocated with |alloc|, or the
+  // default allocator if it is NULL, and the vertex and index data are
+  // wipeable if SetBuildWipeable() was passed true.
+  const gfx::ShapePtr BuildShape(uint32 width, uint32 height,
+                                 const base::AllocatorPtr& alloc) const;
+
   // Sets whether images returned by BuildImage() are wipeable (see
   // base::DataContainer) or not. An image is wipeable if its data is deleted
   // after it is uploaded to OpenGL. Changing this option affects all future
-  // images built by this. By default, all built images are wipeable.
-  void SetBuildWipeable(bool wipable) { wipeable_ = wipable; }
+  // images built by this and clears the image cache. By default, all built
+  // images are wipeable.
+  void SetBuildWipeable(bool wipable);
+
+  // Sets the maximum number of images that BuildImage() keeps, keyed by size,
+  // so that UIs that animate between a few sizes do not build the same images
+  // repeatedly. When the cache is full the least recently returned image is
+  // dropped. A capacity of 0, the default, disables the cache.
+  void SetImageCacheCapacity(size_t capacity);
+  size_t GetImageCacheCapacity() const { return cache_capacity_; }
 
   // Returns the minimum size at which this nine-patch can be drawn, i.e., the
   // size at which all stretch regions are removed.
@@ -81,10 +111,20 @@ class ION_API NinePatch : public base::Referent {
   // Helper struct for tracking stretchable regions of the image.
   struct Region;
 
+  // An image in the image cache and the size it was built at.
+  struct CachedImage {
+    math::Vector2ui size;
+    gfx::ImagePtr image;
+  };
+
   // The destructor is private because all base::Referent classes must have
   // protected or private destructors.
   ~NinePatch() override;
 
+  // Builds a new image for BuildImage(), bypassing the image cache.
+  const gfx::ImagePtr CreateImage(uint32 width, uint32 height,
+                                  const base::AllocatorPtr& alloc) const;
+
   // Returns a vector of Regions that map source image areas to destination
   // image areas.
   const base::AllocVector<Region> GetRegionsForSize(uint32 width,
@@ -99,6 +139,11 @@ class ION_API NinePatch : public base::Referent {
   gfx::ImagePtr image_;
   // Whether to set created images as wipeable (defaults to true).
   bool wipeable_;
+  // Built images, most recently returned first, and the maximum number kept.
+  mutable base::AllocVector<CachedImage> image_cache_;
+  size_t cache_capacity_;
+  // Protects |image_cache_|, since BuildImage() is const.
+  mutable port::Mutex cache_mutex_;
 
   FRIEND_TEST(NinePatch, StretchRegions);
   FRIEND_TEST(NinePatch, PaddingBox);
@@ -0,0 +1,1109 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/pixelkernels.h"
+
+#include <string.h>  // For memcpy().
+
+#include <algorithm>
+#include <cmath>
+
+#include "ion/port/atomic.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  if defined(__F16C__)
+#    include <immintrin.h>
+#  endif
+#  define ION_PIXEL_KERNELS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define ION_PIXEL_KERNELS_NEON 1
+#endif
+
+namespace ion {
+namespace image {
+
+namespace {
+
+static std::atomic<bool> s_simd_enabled(true);
+
+//-----------------------------------------------------------------------------
+//
+// Reference implementations.
+//
+//-----------------------------------------------------------------------------
+
+// Returns t / 255, rounded down, for t <= 65152. The SIMD versions use the
+// same shifts, which are exact in that range.
+static inline uint32 Div255(uint32 t) {
+  return (t + 1U + (t >> 8)) >> 8;
+}
+
+// Quantizes an 8-bit channel to the range [0, max], rounding to the nearest
+// value.
+static inline uint32 Quantize(uint32 value, uint32 max) {
+  return Div255(value * max + 127U);
+}
+
+// Expand 5-, 6- and 4-bit channels to 8 bits by replicating their high bits.
+static inline uint8 Expand5(uint32 value) {
+  return static_cast<uint8>((value << 3) | (value >> 2));
+}
+static inline uint8 Expand6(uint32 value) {
+  return static_cast<uint8>((value << 2) | (value >> 4));
+}
+static inline uint8 Expand4(uint32 value) {
+  return static_cast<uint8>((value << 4) | value);
+}
+
+static void RefRgb888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i)
+    dst[i] = src[3 * i];
+}
+
+static void RefRgba8888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i)
+    dst[i] = src[4 * i];
+}
+
+static void RefRgba8888ToRgb888(const uint8* src, uint8* dst,
+                                size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, src += 4, dst += 3) {
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+  }
+}
+
+static void RefRgb888ToRgba8888(const uint8* src, uint8* dst,
+                                size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, src += 3, dst += 4) {
+    dst[0] = src[0];
+    dst[1] = src[1];
+    dst[2] = src[2];
+    dst[3] = 255;
+  }
+}
+
+static void RefRgba8888ToRgb565(const uint8* src, uint16* dst,
+                                size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, src += 4) {
+    dst[i] = static_cast<uint16>((Quantize(src[0], 31U) << 11) |
+                                 (Quantize(src[1], 63U) << 5) |
+                                 Quantize(src[2], 31U));
+  }
+}
+
+static void RefRgba8888ToRgba4444(const uint8* src, uint16* dst,
+                                  size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, src += 4) {
+    dst[i] = static_cast<uint16>((Quantize(src[0], 15U) << 12) |
+                                 (Quantize(src[1], 15U) << 8) |
+                                 (Quantize(src[2], 15U) << 4) |
+                                 Quantize(src[3], 15U));
+  }
+}
+
+static void RefRgba8888ToRgba5551(const uint8* src, uint16* dst,
+                                  size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, src += 4) {
+    dst[i] = static_cast<uint16>((Quantize(src[0], 31U) << 11) |
+                                 (Quantize(src[1], 31U) << 6) |
+                                 (Quantize(src[2], 31U) << 1) |
+                                 Quantize(src[3], 1U));
+  }
+}
+
+static void RefRgb565ToRgba8888(const uint16* src, uint8* dst,
+                                size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, dst += 4) {
+    const uint32 pixel = src[i];
+    dst[0] = Expand5(pixel >> 11);
+    dst[1] = Expand6((pixel >> 5) & 0x3f);
+    dst[2] = Expand5(pixel & 0x1f);
+    dst[3] = 255;
+  }
+}
+
+static void RefRgba4444ToRgba8888(const uint16* src, uint8* dst,
+                                  size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, dst += 4) {
+    const uint32 pixel = src[i];
+    dst[0] = Expand4(pixel >> 12);
+    dst[1] = Expand4((pixel >> 8) & 0xf);
+    dst[2] = Expand4((pixel >> 4) & 0xf);
+    dst[3] = Expand4(pixel & 0xf);
+  }
+}
+
+static void RefRgba5551ToRgba8888(const uint16* src, uint8* dst,
+                                  size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, dst += 4) {
+    const uint32 pixel = src[i];
+    dst[0] = Expand5(pixel >> 11);
+    dst[1] = Expand5((pixel >> 6) & 0x1f);
+    dst[2] = Expand5((pixel >> 1) & 0x1f);
+    dst[3] = (pixel & 1U) ? 255 : 0;
+  }
+}
+
+static void RefPremultiplyRgba8888(uint8* pixels, size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, pixels += 4) {
+    const uint32 alpha = pixels[3];
+    pixels[0] = static_cast<uint8>(Div255(pixels[0] * alpha + 127U));
+    pixels[1] = static_cast<uint8>(Div255(pixels[1] * alpha + 127U));
+    pixels[2] = static_cast<uint8>(Div255(pixels[2] * alpha + 127U));
+  }
+}
+
+static void RefUnpremultiplyRgba8888(uint8* pixels, size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, pixels += 4) {
+    const uint8 alpha = pixels[3];
+    if (alpha == 0)
+      continue;
+    const float inverse_alpha = 255.f / static_cast<float>(alpha);
+    for (int c = 0; c < 3; ++c) {
+      pixels[c] = static_cast<uint8>(std::min(
+          static_cast<float>(pixels[c]) * inverse_alpha, 255.f));
+    }
+  }
+}
+
+// Converts a float to a half float. See ConvertFloatToHalf().
+static inline uint16 FloatToHalf(float value) {
+  uint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint32 sign = (bits >> 16) & 0x8000U;
+  bits &= 0x7fffffffU;
+  uint32 half;
+  if (bits > 0x7f800000U) {
+    half = 0x7e00U;
+  } else if (bits >= ((127U + 16U) << 23)) {
+    // Too large, which includes infinity.
+    half = 0x7c00U;
+  } else if (bits < ((127U - 14U) << 23)) {
+    // Zero or denormal. Adding a magic value aligns the 10 mantissa bits at
+    // the bottom of the float, and float addition rounds ties to even.
+    static const uint32 kMagic = ((127U - 15U) + (23U - 10U) + 1U) << 23;
+    float magic;
+    memcpy(&magic, &kMagic, sizeof(magic));
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(magnitude));
+    magnitude += magic;
+    memcpy(&half, &magnitude, sizeof(half));
+    half -= kMagic;
+  } else {
+    // Rebias the exponent and round the mantissa to 10 bits, which may carry
+    // into the exponent, up to infinity.
+    const uint32 odd = (bits >> 13) & 1U;
+    half = (bits + (static_cast<uint32>(15 - 127) << 23) + 0xfffU + odd) >> 13;
+  }
+  return static_cast<uint16>(sign | half);
+}
+
+// Converts a half float to a float, which is exact.
+static inline float HalfToFloat(uint16 half) {
+  // Shifting the exponent and mantissa into place and scaling by 2^112
+  // rebiases the exponent, and also normalizes denormals.
+  static const uint32 kScale = (254U - 15U) << 23;
+  const uint32 exponent_mantissa = half & 0x7fffU;
+  const uint32 shifted = exponent_mantissa << 13;
+  float scale;
+  memcpy(&scale, &kScale, sizeof(scale));
+  float value;
+  memcpy(&value, &shifted, sizeof(value));
+  value *= scale;
+  uint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if (exponent_mantissa >= 0x7c00U)
+    bits |= 0x7f800000U;
+  bits |= static_cast<uint32>(half & 0x8000U) << 16;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Converts a float to an unsigned float with a 5-bit exponent and
+// |mantissa_bits| bits of mantissa, as used by packed R11F_G11F_B10F data.
+static inline uint32 FloatToSmallFloat(float value, uint32 mantissa_bits) {
+  const uint32 shift = 23U - mantissa_bits;
+  const uint32 max_finite = (0x1fU << mantissa_bits) - 1U;
+  uint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if ((bits & 0x7fffffffU) > 0x7f800000U)
+    return (0x1fU << mantissa_bits) | (1U << (mantissa_bits - 1U));  // NaN.
+  if (bits & 0x80000000U)
+    return 0U;
+  if (bits == 0x7f800000U)
+    return 0x1fU << mantissa_bits;
+  uint32 small;
+  if (bits >= ((127U + 16U) << 23)) {
+    small = max_finite;
+  } else if (bits < ((127U - 14U) << 23)) {
+    // Zero or denormal, rounded as in FloatToHalf().
+    const uint32 magic_bits = ((127U - 15U) + shift + 1U) << 23;
+    float magic;
+    memcpy(&magic, &magic_bits, sizeof(magic));
+    value += magic;
+    memcpy(&small, &value, sizeof(small));
+    small -= magic_bits;
+  } else {
+    const uint32 odd = (bits >> shift) & 1U;
+    small = (bits + (static_cast<uint32>(15 - 127) << 23) +
+             ((1U << (shift - 1U)) - 1U) + odd) >> shift;
+  }
+  return std::min(small, max_finite);
+}
+
+// Converts an unsigned float with a 5-bit exponent and |mantissa_bits| bits
+// of mantissa to a float, which is exact.
+static inline float SmallFloatToFloat(uint32 small, uint32 mantissa_bits) {
+  const uint32 exponent = (small >> mantissa_bits) & 0x1fU;
+  const uint32 mantissa = small & ((1U << mantissa_bits) - 1U);
+  if (exponent == 0U) {
+    return std::ldexp(static_cast<float>(mantissa),
+                      -14 - static_cast<int>(mantissa_bits));
+  }
+  const uint32 bits = (exponent == 0x1fU ? 0x7f800000U
+                                         : (exponent + 112U) << 23) |
+                      (mantissa << (23U - mantissa_bits));
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Quantizes a normalized float to the range [0, max], rounding to the nearest
+// value. NaNs become 0.
+static inline uint32 QuantizeFloat(float value, float max) {
+  const float clamped = value > 0.f ? std::min(value, 1.f) : 0.f;
+  return static_cast<uint32>(clamped * max + 0.5f);
+}
+
+static void RefFloatToHalf(const float* src, uint16* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = FloatToHalf(src[i]);
+}
+
+static void RefHalfToFloat(const uint16* src, float* dst, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = HalfToFloat(src[i]);
+}
+
+static void RefRgb32fToRgb11f11f10f(const float* src, uint32* dst,
+                                    size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, src += 3) {
+    dst[i] = FloatToSmallFloat(src[0], 6U) |
+             (FloatToSmallFloat(src[1], 6U) << 11) |
+             (FloatToSmallFloat(src[2], 5U) << 22);
+  }
+}
+
+static void RefRgb11f11f10fToRgb32f(const uint32* src, float* dst,
+                                    size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, dst += 3) {
+    const uint32 pixel = src[i];
+    dst[0] = SmallFloatToFloat(pixel & 0x7ffU, 6U);
+    dst[1] = SmallFloatToFloat((pixel >> 11) & 0x7ffU, 6U);
+    dst[2] = SmallFloatToFloat(pixel >> 22, 5U);
+  }
+}
+
+static void RefRgba32fToRgb10a2(const float* src, uint32* dst,
+                                size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, src += 4) {
+    dst[i] = QuantizeFloat(src[0], 1023.f) |
+             (QuantizeFloat(src[1], 1023.f) << 10) |
+             (QuantizeFloat(src[2], 1023.f) << 20) |
+             (QuantizeFloat(src[3], 3.f) << 30);
+  }
+}
+
+static void RefRgb10a2ToRgba32f(const uint32* src, float* dst,
+                                size_t num_pixels) {
+  for (size_t i = 0; i < num_pixels; ++i, dst += 4) {
+    const uint32 pixel = src[i];
+    dst[0] = static_cast<float>(pixel & 0x3ffU) / 1023.f;
+    dst[1] = static_cast<float>((pixel >> 10) & 0x3ffU) / 1023.f;
+    dst[2] = static_cast<float>((pixel >> 20) & 0x3ffU) / 1023.f;
+    dst[3] = static_cast<float>(pixel >> 30) / 3.f;
+  }
+}
+
+#if ION_PIXEL_KERNELS_SSE2
+
+//-----------------------------------------------------------------------------
+//
+// SSE2 implementations. These work on 4 pixels at a time, held in the 32-bit
+// lanes of a register with red in the low byte. SSE2 cannot shuffle bytes, so
+// 3-byte pixels are moved into lanes with whole-register byte shifts.
+//
+//-----------------------------------------------------------------------------
+
+// Loads 4 RGB pixels into the lanes of a register. The high byte of each lane
+// is undefined. Reads 16 bytes.
+static inline __m128i LoadRgb4(const uint8* src) {
+  const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+  const __m128i t0 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+  const __m128i t1 =
+      _mm_unpacklo_epi32(_mm_srli_si128(v, 6), _mm_srli_si128(v, 9));
+  return _mm_unpacklo_epi64(t0, t1);
+}
+
+// Stores the low 3 bytes of each lane as 4 RGB pixels. Writes 12 bytes.
+static inline void StoreRgb4(__m128i v, uint8* dst) {
+  const __m128i lane = _mm_set_epi32(0, 0, 0, 0x00ffffff);
+  const __m128i packed = _mm_or_si128(
+      _mm_or_si128(_mm_and_si128(v, lane),
+                   _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(lane, 4)),
+                                  1)),
+      _mm_or_si128(
+          _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(lane, 8)), 2),
+          _mm_srli_si128(_mm_and_si128(v, _mm_slli_si128(lane, 12)), 3)));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), packed);
+  const int32 last = _mm_cvtsi128_si32(_mm_srli_si128(packed, 8));
+  memcpy(dst + 8, &last, 4);
+}
+
+// Returns the byte of each lane at the given shift as a 32-bit value.
+static inline __m128i Channel(__m128i v, int shift) {
+  return _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(shift)),
+                       _mm_set1_epi32(0xff));
+}
+
+// Packs the 8-bit values in the lanes of 4 registers into 16 bytes.
+static inline __m128i PackBytes(__m128i v0, __m128i v1, __m128i v2,
+                                __m128i v3) {
+  return _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+}
+
+// Packs the 16-bit values in the lanes of 2 registers into 8 16-bit values.
+// The values are biased to avoid the signed saturation of _mm_packs_epi32().
+static inline __m128i PackShorts(__m128i v0, __m128i v1) {
+  const __m128i bias = _mm_set1_epi32(0x8000);
+  return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(v0, bias),
+                                       _mm_sub_epi32(v1, bias)),
+                       _mm_set1_epi16(static_cast<int16>(0x8000)));
+}
+
+// Div255() for each 16-bit value.
+static inline __m128i Div255Epu16(__m128i t) {
+  return _mm_srli_epi16(
+      _mm_add_epi16(_mm_add_epi16(t, _mm_set1_epi16(1)), _mm_srli_epi16(t, 8)),
+      8);
+}
+
+// Quantize() for each 16-bit value.
+static inline __m128i QuantizeEpu16(__m128i value, int16 max) {
+  return Div255Epu16(_mm_add_epi16(_mm_mullo_epi16(value, _mm_set1_epi16(max)),
+                                   _mm_set1_epi16(127)));
+}
+
+// Packs 4 RGBA pixels into the low 16 bits of each lane with the given
+// channel sizes.
+static inline __m128i PackLanes(__m128i v, int16 red_max, int red_shift,
+                                int16 green_max, int green_shift,
+                                int16 blue_max, int blue_shift, int16 alpha_max,
+                                int alpha_shift) {
+  __m128i packed = _mm_or_si128(
+      _mm_sll_epi32(QuantizeEpu16(Channel(v, 0), red_max),
+                    _mm_cvtsi32_si128(red_shift)),
+      _mm_or_si128(_mm_sll_epi32(QuantizeEpu16(Channel(v, 8), green_max),
+                                 _mm_cvtsi32_si128(green_shift)),
+                   _mm_sll_epi32(QuantizeEpu16(Channel(v, 16), blue_max),
+                                 _mm_cvtsi32_si128(blue_shift))));
+  if (alpha_max) {
+    packed = _mm_or_si128(
+        packed, _mm_sll_epi32(QuantizeEpu16(Channel(v, 24), alpha_max),
+                              _mm_cvtsi32_si128(alpha_shift)));
+  }
+  return packed;
+}
+
+// Assembles RGBA pixels from 8-bit channels in 32-bit lanes.
+static inline __m128i MakeRgba(__m128i r, __m128i g, __m128i b, __m128i a) {
+  return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                      _mm_or_si128(_mm_slli_epi32(b, 16),
+                                   _mm_slli_epi32(a, 24)));
+}
+
+static inline __m128i LoadRgba4(const uint8* src) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+static inline void StoreRgba4(__m128i v, uint8* dst) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+}
+
+static void SimdRgb888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  size_t i = 0;
+  // The last load reads 4 bytes past the 48 that are used.
+  for (; i + 18U <= num_pixels; i += 16U) {
+    const uint8* s = src + 3 * i;
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i),
+        PackBytes(Channel(LoadRgb4(s), 0), Channel(LoadRgb4(s + 12), 0),
+                  Channel(LoadRgb4(s + 24), 0), Channel(LoadRgb4(s + 36), 0)));
+  }
+  RefRgb888ToR8(src + 3 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 16U <= num_pixels; i += 16U) {
+    const uint8* s = src + 4 * i;
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i),
+        PackBytes(Channel(LoadRgba4(s), 0), Channel(LoadRgba4(s + 16), 0),
+                  Channel(LoadRgba4(s + 32), 0),
+                  Channel(LoadRgba4(s + 48), 0)));
+  }
+  RefRgba8888ToR8(src + 4 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgb888(const uint8* src, uint8* dst,
+                                 size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 4U <= num_pixels; i += 4U)
+    StoreRgb4(LoadRgba4(src + 4 * i), dst + 3 * i);
+  RefRgba8888ToRgb888(src + 4 * i, dst + 3 * i, num_pixels - i);
+}
+
+static void SimdRgb888ToRgba8888(const uint8* src, uint8* dst,
+                                 size_t num_pixels) {
+  const __m128i alpha = _mm_set1_epi32(static_cast<int32>(0xff000000));
+  size_t i = 0;
+  // The load reads 4 bytes past the 12 that are used.
+  for (; i + 6U <= num_pixels; i += 4U)
+    StoreRgba4(_mm_or_si128(LoadRgb4(src + 3 * i), alpha), dst + 4 * i);
+  RefRgb888ToRgba8888(src + 3 * i, dst + 4 * i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgb565(const uint8* src, uint16* dst,
+                                 size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint8* s = src + 4 * i;
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i),
+        PackShorts(PackLanes(LoadRgba4(s), 31, 11, 63, 5, 31, 0, 0, 0),
+                   PackLanes(LoadRgba4(s + 16), 31, 11, 63, 5, 31, 0, 0, 0)));
+  }
+  RefRgba8888ToRgb565(src + 4 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgba4444(const uint8* src, uint16* dst,
+                                   size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint8* s = src + 4 * i;
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i),
+        PackShorts(
+            PackLanes(LoadRgba4(s), 15, 12, 15, 8, 15, 4, 15, 0),
+            PackLanes(LoadRgba4(s + 16), 15, 12, 15, 8, 15, 4, 15, 0)));
+  }
+  RefRgba8888ToRgba4444(src + 4 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgba5551(const uint8* src, uint16* dst,
+                                   size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint8* s = src + 4 * i;
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(dst + i),
+        PackShorts(PackLanes(LoadRgba4(s), 31, 11, 31, 6, 31, 1, 1, 0),
+                   PackLanes(LoadRgba4(s + 16), 31, 11, 31, 6, 31, 1, 1, 0)));
+  }
+  RefRgba8888ToRgba5551(src + 4 * i, dst + i, num_pixels - i);
+}
+
+// Returns the bits of each lane at the given shift.
+static inline __m128i Bits(__m128i v, int shift, int32 mask) {
+  return _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(shift)),
+                       _mm_set1_epi32(mask));
+}
+
+static inline __m128i Expand5Epi32(__m128i v) {
+  return _mm_or_si128(_mm_slli_epi32(v, 3), _mm_srli_epi32(v, 2));
+}
+static inline __m128i Expand6Epi32(__m128i v) {
+  return _mm_or_si128(_mm_slli_epi32(v, 2), _mm_srli_epi32(v, 4));
+}
+static inline __m128i Expand4Epi32(__m128i v) {
+  return _mm_or_si128(_mm_slli_epi32(v, 4), v);
+}
+
+// Calls unpack for the lanes of 8 16-bit pixels and stores the results.
+template <typename Unpack>
+static void UnpackPixels(const uint16* src, uint8* dst, size_t count,
+                         Unpack unpack) {
+  for (size_t i = 0; i < count; i += 8U) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    const __m128i zero = _mm_setzero_si128();
+    StoreRgba4(unpack(_mm_unpacklo_epi16(v, zero)), dst + 4 * i);
+    StoreRgba4(unpack(_mm_unpackhi_epi16(v, zero)), dst + 4 * i + 16);
+  }
+}
+
+static inline __m128i Unpack565(__m128i v) {
+  return MakeRgba(Expand5Epi32(Bits(v, 11, 0x1f)),
+                  Expand6Epi32(Bits(v, 5, 0x3f)),
+                  Expand5Epi32(Bits(v, 0, 0x1f)), _mm_set1_epi32(0xff));
+}
+
+static inline __m128i Unpack4444(__m128i v) {
+  return MakeRgba(
+      Expand4Epi32(Bits(v, 12, 0xf)), Expand4Epi32(Bits(v, 8, 0xf)),
+      Expand4Epi32(Bits(v, 4, 0xf)), Expand4Epi32(Bits(v, 0, 0xf)));
+}
+
+static inline __m128i Unpack5551(__m128i v) {
+  return MakeRgba(Expand5Epi32(Bits(v, 11, 0x1f)),
+                  Expand5Epi32(Bits(v, 6, 0x1f)),
+                  Expand5Epi32(Bits(v, 1, 0x1f)),
+                  _mm_sub_epi32(_mm_setzero_si128(), Bits(v, 0, 1)));
+}
+
+static void SimdRgb565ToRgba8888(const uint16* src, uint8* dst,
+                                 size_t num_pixels) {
+  const size_t count = num_pixels & ~static_cast<size_t>(7);
+  UnpackPixels(src, dst, count, Unpack565);
+  RefRgb565ToRgba8888(src + count, dst + 4 * count, num_pixels - count);
+}
+
+static void SimdRgba4444ToRgba8888(const uint16* src, uint8* dst,
+                                   size_t num_pixels) {
+  const size_t count = num_pixels & ~static_cast<size_t>(7);
+  UnpackPixels(src, dst, count, Unpack4444);
+  RefRgba4444ToRgba8888(src + count, dst + 4 * count, num_pixels - count);
+}
+
+static void SimdRgba5551ToRgba8888(const uint16* src, uint8* dst,
+                                   size_t num_pixels) {
+  const size_t count = num_pixels & ~static_cast<size_t>(7);
+  UnpackPixels(src, dst, count, Unpack5551);
+  RefRgba5551ToRgba8888(src + count, dst + 4 * count, num_pixels - count);
+}
+
+static void SimdPremultiplyRgba8888(uint8* pixels, size_t num_pixels) {
+  const __m128i bias = _mm_set1_epi16(127);
+  size_t i = 0;
+  for (; i + 4U <= num_pixels; i += 4U) {
+    uint8* p = pixels + 4 * i;
+    const __m128i v = LoadRgba4(p);
+    const __m128i a = Channel(v, 24);
+    // The high 16 bits of each lane are 0, and stay 0 through Div255Epu16().
+    StoreRgba4(
+        MakeRgba(
+            Div255Epu16(_mm_add_epi16(_mm_mullo_epi16(Channel(v, 0), a), bias)),
+            Div255Epu16(_mm_add_epi16(_mm_mullo_epi16(Channel(v, 8), a), bias)),
+            Div255Epu16(
+                _mm_add_epi16(_mm_mullo_epi16(Channel(v, 16), a), bias)),
+            a),
+        p);
+  }
+  RefPremultiplyRgba8888(pixels + 4 * i, num_pixels - i);
+}
+
+static void SimdUnpremultiplyRgba8888(uint8* pixels, size_t num_pixels) {
+  const __m128 max = _mm_set1_ps(255.f);
+  const __m128 one = _mm_set1_ps(1.f);
+  size_t i = 0;
+  for (; i + 4U <= num_pixels; i += 4U) {
+    uint8* p = pixels + 4 * i;
+    const __m128i v = LoadRgba4(p);
+    const __m128i a = Channel(v, 24);
+    const __m128 a_float = _mm_cvtepi32_ps(a);
+    // Pixels with zero alpha are divided by 1 instead, which leaves them
+    // unchanged.
+    const __m128 is_zero = _mm_cmpeq_ps(a_float, _mm_setzero_ps());
+    const __m128 inverse_alpha =
+        _mm_or_ps(_mm_and_ps(is_zero, one),
+                  _mm_andnot_ps(is_zero, _mm_div_ps(max, a_float)));
+    __m128i c[3];
+    for (int j = 0; j < 3; ++j) {
+      c[j] = _mm_cvttps_epi32(_mm_min_ps(
+          _mm_mul_ps(_mm_cvtepi32_ps(Channel(v, 8 * j)), inverse_alpha),
+          max));
+    }
+    StoreRgba4(MakeRgba(c[0], c[1], c[2], a), p);
+  }
+  RefUnpremultiplyRgba8888(pixels + 4 * i, num_pixels - i);
+}
+
+#if defined(__F16C__)
+// F16C converts 8 values at a time in hardware.
+static void SimdFloatToHalf(const float* src, uint16* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8U <= count; i += 8U) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                     _MM_FROUND_TO_NEAREST_INT));
+  }
+  RefFloatToHalf(src + i, dst + i, count - i);
+}
+
+static void SimdHalfToFloat(const uint16* src, float* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8U <= count; i += 8U) {
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(
+                                  reinterpret_cast<const __m128i*>(src + i))));
+  }
+  RefHalfToFloat(src + i, dst + i, count - i);
+}
+#else
+// Converts 4 floats to half floats in the low 16 bits of each lane, as
+// FloatToHalf() does.
+static inline __m128i FloatToHalf4(__m128 f) {
+  const __m128 sign = _mm_and_ps(f, _mm_set1_ps(-0.f));
+  const __m128i bits = _mm_castps_si128(_mm_xor_ps(f, sign));
+  const __m128i is_regular =
+      _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), bits);
+  const __m128i is_nan = _mm_cmpgt_epi32(bits, _mm_set1_epi32(0x7f800000));
+  const __m128i special = _mm_or_si128(
+      _mm_set1_epi32(0x7c00), _mm_and_si128(is_nan, _mm_set1_epi32(0x200)));
+
+  // Denormal results.
+  const __m128i magic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+  const __m128i denormal = _mm_sub_epi32(
+      _mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(bits),
+                                  _mm_castsi128_ps(magic))),
+      magic);
+  const __m128i is_denormal =
+      _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), bits);
+
+  // Normal results. The odd bit of the rounded mantissa is shifted to the
+  // sign bit to make a mask of -1 for odd mantissas.
+  const __m128i odd = _mm_srai_epi32(_mm_slli_epi32(bits, 31 - 13), 31);
+  const __m128i normal = _mm_srli_epi32(
+      _mm_sub_epi32(_mm_add_epi32(bits, _mm_set1_epi32(
+                                            ((15 - 127) << 23) + 0xfff)),
+                    odd),
+      13);
+
+  const __m128i finite = _mm_or_si128(_mm_and_si128(is_denormal, denormal),
+                                      _mm_andnot_si128(is_denormal, normal));
+  const __m128i half = _mm_or_si128(_mm_and_si128(is_regular, finite),
+                                    _mm_andnot_si128(is_regular, special));
+  // Shifting the sign arithmetically fills the high 16 bits of negative lanes
+  // with ones, so that packing with signed saturation keeps the low 16 bits.
+  return _mm_or_si128(half, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+// Converts the half floats in the low 16 bits of each lane to floats, as
+// HalfToFloat() does.
+static inline __m128 HalfToFloat4(__m128i h) {
+  const __m128i exponent_mantissa = _mm_and_si128(h, _mm_set1_epi32(0x7fff));
+  const __m128i sign = _mm_slli_epi32(_mm_xor_si128(h, exponent_mantissa), 16);
+  const __m128 scaled =
+      _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponent_mantissa, 13)),
+                 _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+  const __m128i is_special =
+      _mm_cmpgt_epi32(exponent_mantissa, _mm_set1_epi32(0x7bff));
+  const __m128i special_exponent =
+      _mm_and_si128(is_special, _mm_set1_epi32(0x7f800000));
+  return _mm_or_ps(scaled,
+                   _mm_castsi128_ps(_mm_or_si128(sign, special_exponent)));
+}
+
+static void SimdFloatToHalf(const float* src, uint16* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 8U <= count; i += 8U) {
+    const __m128i h0 = FloatToHalf4(_mm_loadu_ps(src + i));
+    const __m128i h1 = FloatToHalf4(_mm_loadu_ps(src + i + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+                     _mm_packs_epi32(h0, h1));
+  }
+  RefFloatToHalf(src + i, dst + i, count - i);
+}
+
+static void SimdHalfToFloat(const uint16* src, float* dst, size_t count) {
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 8U <= count; i += 8U) {
+    const __m128i h =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_ps(dst + i, HalfToFloat4(_mm_unpacklo_epi16(h, zero)));
+    _mm_storeu_ps(dst + i + 4, HalfToFloat4(_mm_unpackhi_epi16(h, zero)));
+  }
+  RefHalfToFloat(src + i, dst + i, count - i);
+}
+#endif
+
+#elif ION_PIXEL_KERNELS_NEON
+
+//-----------------------------------------------------------------------------
+//
+// NEON implementations. These use the interleaving loads and stores to work on
+// one register per channel.
+//
+//-----------------------------------------------------------------------------
+
+// Quantize() for each 8-bit value, returning 16-bit values.
+static inline uint16x8_t QuantizeU8(uint8x8_t value, uint8 max) {
+  const uint16x8_t t = vmlal_u8(vdupq_n_u16(127), value, vdup_n_u8(max));
+  return vshrq_n_u16(vaddq_u16(vaddq_u16(t, vdupq_n_u16(1)),
+                               vshrq_n_u16(t, 8)), 8);
+}
+
+static inline uint8x8_t Expand5U16(uint16x8_t v) {
+  return vmovn_u16(vorrq_u16(vshlq_n_u16(v, 3), vshrq_n_u16(v, 2)));
+}
+static inline uint8x8_t Expand6U16(uint16x8_t v) {
+  return vmovn_u16(vorrq_u16(vshlq_n_u16(v, 2), vshrq_n_u16(v, 4)));
+}
+static inline uint8x8_t Expand4U16(uint16x8_t v) {
+  return vmovn_u16(vorrq_u16(vshlq_n_u16(v, 4), v));
+}
+
+static void SimdRgb888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 16U <= num_pixels; i += 16U)
+    vst1q_u8(dst + i, vld3q_u8(src + 3 * i).val[0]);
+  RefRgb888ToR8(src + 3 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 16U <= num_pixels; i += 16U)
+    vst1q_u8(dst + i, vld4q_u8(src + 4 * i).val[0]);
+  RefRgba8888ToR8(src + 4 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgb888(const uint8* src, uint8* dst,
+                                 size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 16U <= num_pixels; i += 16U) {
+    const uint8x16x4_t v = vld4q_u8(src + 4 * i);
+    uint8x16x3_t rgb;
+    rgb.val[0] = v.val[0];
+    rgb.val[1] = v.val[1];
+    rgb.val[2] = v.val[2];
+    vst3q_u8(dst + 3 * i, rgb);
+  }
+  RefRgba8888ToRgb888(src + 4 * i, dst + 3 * i, num_pixels - i);
+}
+
+static void SimdRgb888ToRgba8888(const uint8* src, uint8* dst,
+                                 size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 16U <= num_pixels; i += 16U) {
+    const uint8x16x3_t v = vld3q_u8(src + 3 * i);
+    uint8x16x4_t rgba;
+    rgba.val[0] = v.val[0];
+    rgba.val[1] = v.val[1];
+    rgba.val[2] = v.val[2];
+    rgba.val[3] = vdupq_n_u8(255);
+    vst4q_u8(dst + 4 * i, rgba);
+  }
+  RefRgb888ToRgba8888(src + 3 * i, dst + 4 * i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgb565(const uint8* src, uint16* dst,
+                                 size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint8x8x4_t v = vld4_u8(src + 4 * i);
+    vst1q_u16(dst + i,
+              vorrq_u16(vshlq_n_u16(QuantizeU8(v.val[0], 31), 11),
+                        vorrq_u16(vshlq_n_u16(QuantizeU8(v.val[1], 63), 5),
+                                  QuantizeU8(v.val[2], 31))));
+  }
+  RefRgba8888ToRgb565(src + 4 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgba4444(const uint8* src, uint16* dst,
+                                   size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint8x8x4_t v = vld4_u8(src + 4 * i);
+    vst1q_u16(dst + i,
+              vorrq_u16(vorrq_u16(vshlq_n_u16(QuantizeU8(v.val[0], 15), 12),
+                                  vshlq_n_u16(QuantizeU8(v.val[1], 15), 8)),
+                        vorrq_u16(vshlq_n_u16(QuantizeU8(v.val[2], 15), 4),
+                                  QuantizeU8(v.val[3], 15))));
+  }
+  RefRgba8888ToRgba4444(src + 4 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgba8888ToRgba5551(const uint8* src, uint16* dst,
+                                   size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint8x8x4_t v = vld4_u8(src + 4 * i);
+    vst1q_u16(dst + i,
+              vorrq_u16(vorrq_u16(vshlq_n_u16(QuantizeU8(v.val[0], 31), 11),
+                                  vshlq_n_u16(QuantizeU8(v.val[1], 31), 6)),
+                        vorrq_u16(vshlq_n_u16(QuantizeU8(v.val[2], 31), 1),
+                                  QuantizeU8(v.val[3], 1))));
+  }
+  RefRgba8888ToRgba5551(src + 4 * i, dst + i, num_pixels - i);
+}
+
+static void SimdRgb565ToRgba8888(const uint16* src, uint8* dst,
+                                 size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint16x8_t v = vld1q_u16(src + i);
+    uint8x8x4_t rgba;
+    rgba.val[0] = Expand5U16(vshrq_n_u16(v, 11));
+    rgba.val[1] = Expand6U16(vandq_u16(vshrq_n_u16(v, 5), vdupq_n_u16(0x3f)));
+    rgba.val[2] = Expand5U16(vandq_u16(v, vdupq_n_u16(0x1f)));
+    rgba.val[3] = vdup_n_u8(255);
+    vst4_u8(dst + 4 * i, rgba);
+  }
+  RefRgb565ToRgba8888(src + i, dst + 4 * i, num_pixels - i);
+}
+
+static void SimdRgba4444ToRgba8888(const uint16* src, uint8* dst,
+                                   size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint16x8_t v = vld1q_u16(src + i);
+    const uint16x8_t mask = vdupq_n_u16(0xf);
+    uint8x8x4_t rgba;
+    rgba.val[0] = Expand4U16(vshrq_n_u16(v, 12));
+    rgba.val[1] = Expand4U16(vandq_u16(vshrq_n_u16(v, 8), mask));
+    rgba.val[2] = Expand4U16(vandq_u16(vshrq_n_u16(v, 4), mask));
+    rgba.val[3] = Expand4U16(vandq_u16(v, mask));
+    vst4_u8(dst + 4 * i, rgba);
+  }
+  RefRgba4444ToRgba8888(src + i, dst + 4 * i, num_pixels - i);
+}
+
+static void SimdRgba5551ToRgba8888(const uint16* src, uint8* dst,
+                                   size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    const uint16x8_t v = vld1q_u16(src + i);
+    const uint16x8_t mask = vdupq_n_u16(0x1f);
+    uint8x8x4_t rgba;
+    rgba.val[0] = Expand5U16(vshrq_n_u16(v, 11));
+    rgba.val[1] = Expand5U16(vandq_u16(vshrq_n_u16(v, 6), mask));
+    rgba.val[2] = Expand5U16(vandq_u16(vshrq_n_u16(v, 1), mask));
+    rgba.val[3] =
+        vmovn_u16(vmulq_n_u16(vandq_u16(v, vdupq_n_u16(1)), 255));
+    vst4_u8(dst + 4 * i, rgba);
+  }
+  RefRgba5551ToRgba8888(src + i, dst + 4 * i, num_pixels - i);
+}
+
+static void SimdPremultiplyRgba8888(uint8* pixels, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    uint8* p = pixels + 4 * i;
+    uint8x8x4_t v = vld4_u8(p);
+    for (int c = 0; c < 3; ++c) {
+      const uint16x8_t t = vmlal_u8(vdupq_n_u16(127), v.val[c], v.val[3]);
+      v.val[c] = vmovn_u16(vshrq_n_u16(
+          vaddq_u16(vaddq_u16(t, vdupq_n_u16(1)), vshrq_n_u16(t, 8)), 8));
+    }
+    vst4_u8(p, v);
+  }
+  RefPremultiplyRgba8888(pixels + 4 * i, num_pixels - i);
+}
+
+#if defined(__aarch64__)
+// Unpremultiplies 4 channel values given the inverse alpha of their pixels.
+static inline uint32x4_t UnpremultiplyU32(uint32x4_t c,
+                                          float32x4_t inverse_alpha) {
+  return vcvtq_u32_f32(vminq_f32(
+      vmulq_f32(vcvtq_f32_u32(c), inverse_alpha), vdupq_n_f32(255.f)));
+}
+
+static void SimdUnpremultiplyRgba8888(uint8* pixels, size_t num_pixels) {
+  size_t i = 0;
+  for (; i + 8U <= num_pixels; i += 8U) {
+    uint8* p = pixels + 4 * i;
+    uint8x8x4_t v = vld4_u8(p);
+    const uint16x8_t a = vmovl_u8(v.val[3]);
+    float32x4_t inverse_alpha[2];
+    for (int h = 0; h < 2; ++h) {
+      const float32x4_t a_float = vcvtq_f32_u32(
+          vmovl_u16(h ? vget_high_u16(a) : vget_low_u16(a)));
+      // Pixels with zero alpha are divided by 1 instead, which leaves them
+      // unchanged.
+      inverse_alpha[h] = vbslq_f32(vceqq_f32(a_float, vdupq_n_f32(0.f)),
+                                   vdupq_n_f32(1.f),
+                                   vdivq_f32(vdupq_n_f32(255.f), a_float));
+    }
+    for (int c = 0; c < 3; ++c) {
+      const uint16x8_t value = vmovl_u8(v.val[c]);
+      v.val[c] = vmovn_u16(vcombine_u16(
+          vmovn_u32(UnpremultiplyU32(vmovl_u16(vget_low_u16(value)),
+                                     inverse_alpha[0])),
+          vmovn_u32(UnpremultiplyU32(vmovl_u16(vget_high_u16(value)),
+                                     inverse_alpha[1]))));
+    }
+    vst4_u8(p, v);
+  }
+  RefUnpremultiplyRgba8888(pixels + 4 * i, num_pixels - i);
+}
+#else
+// 32-bit ARM has no exact vector division, so the reference is used.
+static void SimdUnpremultiplyRgba8888(uint8* pixels, size_t num_pixels) {
+  RefUnpremultiplyRgba8888(pixels, num_pixels);
+}
+#endif
+
+#if defined(__aarch64__)
+// AArch64 converts 4 values at a time in hardware.
+static void SimdFloatToHalf(const float* src, uint16* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 4U <= count; i += 4U)
+    vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+  RefFloatToHalf(src + i, dst + i, count - i);
+}
+
+static void SimdHalfToFloat(const uint16* src, float* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 4U <= count; i += 4U)
+    vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+  RefHalfToFloat(src + i, dst + i, count - i);
+}
+#else
+// 32-bit ARM does not always have half float conversions, so the reference
+// is used.
+static void SimdFloatToHalf(const float* src, uint16* dst, size_t count) {
+  RefFloatToHalf(src, dst, count);
+}
+
+static void SimdHalfToFloat(const uint16* src, float* dst, size_t count) {
+  RefHalfToFloat(src, dst, count);
+}
+#endif
+
+#endif
+
+#if ION_PIXEL_KERNELS_SSE2 || ION_PIXEL_KERNELS_NEON
+#  define ION_PIXEL_KERNEL(name, args) \
+  if (s_simd_enabled.load(std::memory_order_relaxed)) \
+    Simd##name args; \
+  else \
+    Ref##name args
+#else
+#  define ION_PIXEL_KERNEL(name, args) Ref##name args
+#endif
+
+}  // anonymous namespace
+
+bool IsPixelKernelSimdAvailable() {
+#if ION_PIXEL_KERNELS_SSE2 || ION_PIXEL_KERNELS_NEON
+  return true;
+#else
+  return false;
+#endif
+}
+
+void SetPixelKernelSimdEnabled(bool enabled) {
+  s_simd_enabled = enabled;
+}
+
+bool IsPixelKernelSimdEnabled() {
+  return IsPixelKernelSimdAvailable() && s_simd_enabled;
+}
+
+void ConvertRgb888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgb888ToR8, (src, dst, num_pixels));
+}
+
+void ConvertRgba8888ToR8(const uint8* src, uint8* dst, size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgba8888ToR8, (src, dst, num_pixels));
+}
+
+void ConvertRgba8888ToRgb888(const uint8* src, uint8* dst,
+                             size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgba8888ToRgb888, (src, dst, num_pixels));
+}
+
+void ConvertRgb888ToRgba8888(const uint8* src, uint8* dst,
+                             size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgb888ToRgba8888, (src, dst, num_pixels));
+}
+
+void ConvertRgba8888ToRgb565(const uint8* src, uint16* dst,
+                             size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgba8888ToRgb565, (src, dst, num_pixels));
+}
+
+void ConvertRgba8888ToRgba4444(const uint8* src, uint16* dst,
+                               size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgba8888ToRgba4444, (src, dst, num_pixels));
+}
+
+void ConvertRgba8888ToRgba5551(const uint8* src, uint16* dst,
+                               size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgba8888ToRgba5551, (src, dst, num_pixels));
+}
+
+void ConvertRgb565ToRgba8888(const uint16* src, uint8* dst,
+                             size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgb565ToRgba8888, (src, dst, num_pixels));
+}
+
+void ConvertRgba4444ToRgba8888(const uint16* src, uint8* dst,
+                               size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgba4444ToRgba8888, (src, dst, num_pixels));
+}
+
+void ConvertRgba5551ToRgba8888(const uint16* src, uint8* dst,
+                               size_t num_pixels) {
+  ION_PIXEL_KERNEL(Rgba5551ToRgba8888, (src, dst, num_pixels));
+}
+
+void PremultiplyRgba8888Alpha(uint8* pixels, size_t num_pixels) {
+  ION_PIXEL_KERNEL(PremultiplyRgba8888, (pixels, num_pixels));
+}
+
+void UnpremultiplyRgba8888Alpha(uint8* pixels, size_t num_pixels) {
+  ION_PIXEL_KERNEL(UnpremultiplyRgba8888, (pixels, num_pixels));
+}
+
+void ConvertFloatToHalf(const float* src, uint16* dst, size_t count) {
+  ION_PIXEL_KERNEL(FloatToHalf, (src, dst, count));
+}
+
+void ConvertHalfToFloat(const uint16* src, float* dst, size_t count) {
+  ION_PIXEL_KERNEL(HalfToFloat, (src, dst, count));
+}
+
+void ConvertRgb32fToRgb11f11f10f(const float* src, uint32* dst,
+                                 size_t num_pixels) {
+  RefRgb32fToRgb11f11f10f(src, dst, num_pixels);
+}
+
+void ConvertRgb11f11f10fToRgb32f(const uint32* src, float* dst,
+                                 size_t num_pixels) {
+  RefRgb11f11f10fToRgb32f(src, dst, num_pixels);
+}
+
+void ConvertRgba32fToRgb10a2(const float* src, uint32* dst,
+                             size_t num_pixels) {
+  RefRgba32fToRgb10a2(src, dst, num_pixels);
+}
+
+void ConvertRgb10a2ToRgba32f(const uint32* src, float* dst,
+                             size_t num_pixels) {
+  RefRgb10a2ToRgba32f(src, dst, num_pixels);
+}
+
+#undef ION_PIXEL_KERNEL
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,127 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_PIXELKERNELS_H_
+#define ION_IMAGE_PIXELKERNELS_H_
+
+// This file contains kernels that convert runs of tightly packed pixels
+// between formats. Each kernel has a portable reference implementation and,
+// where the platform supports it, an SSE2 or NEON implementation that produces
+// identical results. The SIMD implementations are used by default; they can be
+// disabled at runtime, for example to compare performance or results.
+//
+// 8-bit channels are quantized to fewer bits with rounding, and expanded back
+// by replicating their high bits, so that a round trip through a packed format
+// is lossless for values that fit it. Packed 16-bit pixels are in native byte
+// order with red in the most significant bits, as OpenGL expects for
+// GL_UNSIGNED_SHORT_5_6_5, GL_UNSIGNED_SHORT_4_4_4_4 and
+// GL_UNSIGNED_SHORT_5_5_5_1 data.
+//
+// Float kernels convert runs of channel values or pixels to and from half
+// floats and the packed formats of GL_UNSIGNED_INT_10F_11F_11F_REV and
+// GL_UNSIGNED_INT_2_10_10_10_REV data. The half float kernels use F16C or
+// NEON conversion instructions where they are compiled in, and SSE2 integer
+// math otherwise; these give the same results as the reference except for
+// the payloads of NaNs. The packed float kernels have only reference
+// implementations.
+//
+// Unless noted otherwise, src and dst must not overlap.
+
+#include <stddef.h>
+
+#include "base/integral_types.h"
+
+namespace ion {
+namespace image {
+
+// Returns whether SIMD kernels are compiled in for this platform.
+ION_API bool IsPixelKernelSimdAvailable();
+// Enables or disables the SIMD kernels, if they are available. They are
+// enabled by default. This is not synchronized with concurrent conversions.
+ION_API void SetPixelKernelSimdEnabled(bool enabled);
+// Returns whether the SIMD kernels are available and enabled.
+ION_API bool IsPixelKernelSimdEnabled();
+
+// Copies the red channel of each pixel to an 8-bit pixel.
+ION_API void ConvertRgb888ToR8(const uint8* src, uint8* dst,
+                               size_t num_pixels);
+ION_API void ConvertRgba8888ToR8(const uint8* src, uint8* dst,
+                                 size_t num_pixels);
+
+// Drops the alpha channel of each pixel.
+ION_API void ConvertRgba8888ToRgb888(const uint8* src, uint8* dst,
+                                     size_t num_pixels);
+// Adds a fully opaque alpha channel to each pixel.
+ION_API void ConvertRgb888ToRgba8888(const uint8* src, uint8* dst,
+                                     size_t num_pixels);
+
+// Packs each pixel into 16 bits. The alpha channel is dropped by
+// ConvertRgba8888ToRgb565(), and becomes a single bit that is set for
+// alpha >= 128 in ConvertRgba8888ToRgba5551().
+ION_API void ConvertRgba8888ToRgb565(const uint8* src, uint16* dst,
+                                     size_t num_pixels);
+ION_API void ConvertRgba8888ToRgba4444(const uint8* src, uint16* dst,
+                                       size_t num_pixels);
+ION_API void ConvertRgba8888ToRgba5551(const uint8* src, uint16* dst,
+                                       size_t num_pixels);
+
+// Unpacks 16-bit pixels. Pixels without alpha become fully opaque.
+ION_API void ConvertRgb565ToRgba8888(const uint16* src, uint8* dst,
+                                     size_t num_pixels);
+ION_API void ConvertRgba4444ToRgba8888(const uint16* src, uint8* dst,
+                                       size_t num_pixels);
+ION_API void ConvertRgba5551ToRgba8888(const uint16* src, uint8* dst,
+                                       size_t num_pixels);
+
+// Multiplies the color channels of each RGBA8888 pixel by its alpha, in place,
+// rounding to the nearest value.
+ION_API void PremultiplyRgba8888Alpha(uint8* pixels, size_t num_pixels);
+// Divides the color channels of each RGBA8888 pixel by its alpha, in place,
+// truncating and clamping to 255. Pixels with zero alpha are left unchanged.
+ION_API void UnpremultiplyRgba8888Alpha(uint8* pixels, size_t num_pixels);
+
+// Converts |count| floats to half floats, rounding to the nearest value with
+// ties to even. Values too large for a half float become infinity, and NaNs
+// stay NaNs.
+ION_API void ConvertFloatToHalf(const float* src, uint16* dst, size_t count);
+// Converts |count| half floats to floats, which is exact.
+ION_API void ConvertHalfToFloat(const uint16* src, float* dst, size_t count);
+
+// Packs RGB float pixels into 32 bits, as unsigned floats with 5 exponent bits
+// and 6 mantissa bits for red and green and 5 for blue, with red in the least
+// significant bits. Values are rounded to the nearest value with ties to even;
+// negative values become 0 and values too large become the largest finite
+// value.
+ION_API void ConvertRgb32fToRgb11f11f10f(const float* src, uint32* dst,
+                                         size_t num_pixels);
+// Unpacks pixels packed by ConvertRgb32fToRgb11f11f10f(), which is exact.
+ION_API void ConvertRgb11f11f10fToRgb32f(const uint32* src, float* dst,
+                                         size_t num_pixels);
+
+// Packs RGBA float pixels into 32 bits, with 10 bits for each color and 2 for
+// alpha, and red in the least significant bits. Values are clamped to [0, 1]
+// and rounded to the nearest value.
+ION_API void ConvertRgba32fToRgb10a2(const float* src, uint32* dst,
+                                     size_t num_pixels);
+// Unpacks pixels packed by ConvertRgba32fToRgb10a2() to values in [0, 1].
+ION_API void ConvertRgb10a2ToRgba32f(const uint32* src, float* dst,
+                                     size_t num_pixels);
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_PIXELKERNELS_H_
@@ -0,0 +1,622 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/resampleutils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/logging.h"
+#include "ion/base/samplingallocationtracker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/image/pixelkernels.h"
+#include "ion/math/utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define ION_RESAMPLE_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define ION_RESAMPLE_NEON 1
+#endif
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+//-----------------------------------------------------------------------------
+//
+// Channel types.
+//
+//-----------------------------------------------------------------------------
+
+// The types of channel that can be resampled.
+enum ChannelType {
+  kUnsupportedChannels,
+  kUint8Channels,
+  kUint16Channels,
+  kHalfChannels,
+  kFloatChannels,
+  // Pixels packed into 32 bits, which are resampled as floats.
+  kPackedFloatChannels,
+};
+
+// A half float channel, which is distinct from uint16 for templates.
+struct Half {
+  uint16 bits;
+};
+
+static ChannelType GetChannelType(Image::Format format) {
+  switch (format) {
+    case Image::kR16ui:
+    case Image::kRg16ui:
+    case Image::kRgb16ui:
+    case Image::kRgba16ui:
+      return kUint16Channels;
+    case Image::kR16fHalf:
+    case Image::kRg16fHalf:
+    case Image::kRgb16fHalf:
+    case Image::kRgba16fHalf:
+      return kHalfChannels;
+    case Image::kRgbaFloat:
+    case Image::kR16fFloat:
+    case Image::kRg16fFloat:
+    case Image::kRgb16fFloat:
+    case Image::kRgba16fFloat:
+    case Image::kR32f:
+    case Image::kRg32f:
+    case Image::kRgb32f:
+    case Image::kRgba32f:
+      return kFloatChannels;
+    case Image::kRgb10a2:
+    case Image::kRgb11f_11f_10f_Rev:
+      return kPackedFloatChannels;
+    default:
+      return !Image::IsCompressedFormat(format) &&
+                     Image::Is8BitPerChannelFormat(format)
+                 ? kUint8Channels
+                 : kUnsupportedChannels;
+  }
+}
+
+static float HalfToFloat(Half half) {
+  float value;
+  ConvertHalfToFloat(&half.bits, &value, 1U);
+  return value;
+}
+
+// Converts a float to the nearest half float, rounding ties to even.
+static Half FloatToHalf(float value) {
+  Half half;
+  ConvertFloatToHalf(&value, &half.bits, 1U);
+  return half;
+}
+
+// Conversions between channel values and floats, and the average used when
+// halving images.
+template <typename T> struct ChannelTraits;
+
+template <> struct ChannelTraits<uint8> {
+  static float ToFloat(uint8 value) { return static_cast<float>(value); }
+  static uint8 FromFloat(float value) {
+    return static_cast<uint8>(math::Clamp(value, 0.f, 255.f) + 0.5f);
+  }
+  static uint8 Average(uint8 a, uint8 b, uint8 c, uint8 d) {
+    return static_cast<uint8>((a + b + c + d + 1) >> 2);
+  }
+};
+
+template <> struct ChannelTraits<uint16> {
+  static float ToFloat(uint16 value) { return static_cast<float>(value); }
+  static uint16 FromFloat(float value) {
+    return static_cast<uint16>(math::Clamp(value, 0.f, 65535.f) + 0.5f);
+  }
+  static uint16 Average(uint16 a, uint16 b, uint16 c, uint16 d) {
+    return static_cast<uint16>((a + b + c + d + 1) >> 2);
+  }
+};
+
+template <> struct ChannelTraits<Half> {
+  static float ToFloat(Half value) { return HalfToFloat(value); }
+  static Half FromFloat(float value) { return FloatToHalf(value); }
+  static Half Average(Half a, Half b, Half c, Half d) {
+    return FloatToHalf((HalfToFloat(a) + HalfToFloat(b) + HalfToFloat(c) +
+                        HalfToFloat(d)) * 0.25f);
+  }
+};
+
+template <> struct ChannelTraits<float> {
+  static float ToFloat(float value) { return value; }
+  static float FromFloat(float value) { return value; }
+  static float Average(float a, float b, float c, float d) {
+    return (a + b + c + d) * 0.25f;
+  }
+};
+
+//-----------------------------------------------------------------------------
+//
+// Filters.
+//
+//-----------------------------------------------------------------------------
+
+// Returns the radius of the filter in source pixels when not shrinking.
+static float GetFilterRadius(ResampleFilter filter) {
+  switch (filter) {
+    case kBilinearFilter:
+      return 1.f;
+    case kMitchellFilter:
+      return 2.f;
+    case kLanczos3Filter:
+      return 3.f;
+    case kBoxFilter:
+    default:
+      return 0.5f;
+  }
+}
+
+// Returns the unnormalized weight of a sample at distance x from the center
+// of the filter, for filters other than kBoxFilter.
+static float EvaluateFilter(ResampleFilter filter, float x) {
+  x = std::abs(x);
+  switch (filter) {
+    case kBilinearFilter:
+      return std::max(1.f - x, 0.f);
+    case kMitchellFilter: {
+      // The cubic for B = C = 1/3, with its coefficients multiplied out.
+      if (x < 1.f)
+        return ((7.f * x - 12.f) * x * x + 16.f / 3.f) / 6.f;
+      if (x < 2.f)
+        return (((-7.f / 3.f * x + 12.f) * x - 20.f) * x + 32.f / 3.f) / 6.f;
+      return 0.f;
+    }
+    case kLanczos3Filter: {
+      if (x < 1e-6f)
+        return 1.f;
+      if (x >= 3.f)
+        return 0.f;
+      const float pi_x = static_cast<float>(M_PI) * x;
+      return 3.f * std::sin(pi_x) * std::sin(pi_x / 3.f) / (pi_x * pi_x);
+    }
+    case kBoxFilter:
+    default:
+      return x <= 0.5f ? 1.f : 0.f;
+  }
+}
+
+// The weights of the source pixels that contribute to each output pixel along
+// one axis. Each output pixel uses |taps| consecutive source pixels starting
+// at its entry in |starts|.
+struct FilterTable {
+  size_t taps;
+  std::vector<size_t> starts;
+  std::vector<float> weights;
+};
+
+// Drops taps that have zero weight for every output pixel. Rounding up the
+// filter footprint usually adds one, and it would double the work of an
+// unscaled axis.
+static void TrimFilterTable(size_t in_size, FilterTable* table) {
+  const size_t taps = table->taps;
+  const size_t count = table->starts.size();
+  std::vector<size_t> offsets(count, 0U);
+  size_t trimmed_taps = 1U;
+  for (size_t x = 0; x < count; ++x) {
+    const float* weights = &table->weights[x * taps];
+    size_t first = taps;
+    size_t last = 0U;
+    for (size_t t = 0; t < taps; ++t) {
+      if (weights[t] != 0.f) {
+        first = std::min(first, t);
+        last = t;
+      }
+    }
+    if (first < taps) {
+      offsets[x] = first;
+      trimmed_taps = std::max(trimmed_taps, last - first + 1U);
+    }
+  }
+  if (trimmed_taps == taps)
+    return;
+  std::vector<float> trimmed(count * trimmed_taps, 0.f);
+  for (size_t x = 0; x < count; ++x) {
+    size_t offset = offsets[x];
+    size_t start = table->starts[x] + offset;
+    // Keep the window inside the source, which only adds leading zero weights.
+    if (start + trimmed_taps > in_size) {
+      const size_t shift = start + trimmed_taps - in_size;
+      start -= shift;
+      offset -= shift;
+    }
+    for (size_t t = 0; t < trimmed_taps && offset + t < taps; ++t)
+      trimmed[x * trimmed_taps + t] = table->weights[x * taps + offset + t];
+    table->starts[x] = start;
+  }
+  table->taps = trimmed_taps;
+  table->weights.swap(trimmed);
+}
+
+static void BuildFilterTable(ResampleFilter filter, size_t in_size,
+                             size_t out_size, FilterTable* table) {
+  const float scale =
+      static_cast<float>(in_size) / static_cast<float>(out_size);
+  // Widen the filter when shrinking so that every source pixel contributes.
+  const float support = std::max(scale, 1.f);
+  const float radius = GetFilterRadius(filter) * support;
+  const size_t taps = std::min(
+      in_size, static_cast<size_t>(std::ceil(2.f * radius)) + 1U);
+  table->taps = taps;
+  table->starts.resize(out_size);
+  table->weights.assign(out_size * taps, 0.f);
+  for (size_t x = 0; x < out_size; ++x) {
+    // Source pixel j covers [j, j + 1), so its center is at j + 0.5.
+    const float center = (static_cast<float>(x) + 0.5f) * scale;
+    const int first = static_cast<int>(std::floor(center - radius));
+    const int last = static_cast<int>(std::ceil(center + radius));
+    const size_t start = std::min(static_cast<size_t>(std::max(first, 0)),
+                                  in_size - taps);
+    float* weights = &table->weights[x * taps];
+    float total = 0.f;
+    for (int j = first; j < last; ++j) {
+      const float pixel = static_cast<float>(j);
+      float weight;
+      if (filter == kBoxFilter) {
+        // Use the part of the pixel that the box covers.
+        weight = std::max(std::min(pixel + 1.f, center + radius) -
+                          std::max(pixel, center - radius), 0.f);
+      } else {
+        weight = EvaluateFilter(filter, (pixel + 0.5f - center) / support);
+      }
+      // Samples outside the image repeat the edge pixels.
+      const size_t index = static_cast<size_t>(
+          math::Clamp(j, 0, static_cast<int>(in_size) - 1));
+      DCHECK_LT(index - start, taps);
+      weights[index - start] += weight;
+      total += weight;
+    }
+    if (total != 0.f) {
+      for (size_t t = 0; t < taps; ++t)
+        weights[t] /= total;
+    }
+    table->starts[x] = start;
+  }
+  TrimFilterTable(in_size, table);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Row passes.
+//
+//-----------------------------------------------------------------------------
+
+template <typename T>
+static void LoadRow(const T* src, size_t count, float* dst) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = ChannelTraits<T>::ToFloat(src[i]);
+}
+
+template <typename T>
+static void StoreRow(const float* src, size_t count, T* dst) {
+  for (size_t i = 0; i < count; ++i)
+    dst[i] = ChannelTraits<T>::FromFloat(src[i]);
+}
+
+// Half float rows are converted by the pixel kernels.
+template <>
+void LoadRow(const Half* src, size_t count, float* dst) {
+  ConvertHalfToFloat(&src->bits, dst, count);
+}
+
+template <>
+void StoreRow(const float* src, size_t count, Half* dst) {
+  ConvertFloatToHalf(src, &dst->bits, count);
+}
+
+// Filters a row of pixels with |channels| channels horizontally.
+static void FilterRow(const FilterTable& table, const float* src,
+                      size_t channels, float* dst) {
+  const size_t taps = table.taps;
+  const size_t count = table.starts.size();
+  const float* weights = &table.weights[0];
+#if ION_RESAMPLE_SSE2 || ION_RESAMPLE_NEON
+  // Four channel pixels fit exactly in a register.
+  if (channels == 4U) {
+    for (size_t x = 0; x < count; ++x, weights += taps) {
+      const float* pixel = src + 4U * table.starts[x];
+#  if ION_RESAMPLE_SSE2
+      __m128 sum = _mm_setzero_ps();
+      for (size_t t = 0; t < taps; ++t) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]),
+                                         _mm_loadu_ps(pixel + 4U * t)));
+      }
+      _mm_storeu_ps(dst + 4U * x, sum);
+#  else
+      float32x4_t sum = vdupq_n_f32(0.f);
+      for (size_t t = 0; t < taps; ++t)
+        sum = vmlaq_n_f32(sum, vld1q_f32(pixel + 4U * t), weights[t]);
+      vst1q_f32(dst + 4U * x, sum);
+#  endif
+    }
+    return;
+  }
+#endif
+  for (size_t x = 0; x < count; ++x, weights += taps) {
+    const float* pixel = src + channels * table.starts[x];
+    float sum[4] = { 0.f, 0.f, 0.f, 0.f };
+    for (size_t t = 0; t < taps; ++t, pixel += channels) {
+      for (size_t c = 0; c < channels; ++c)
+        sum[c] += weights[t] * pixel[c];
+    }
+    for (size_t c = 0; c < channels; ++c)
+      dst[channels * x + c] = sum[c];
+  }
+}
+
+// Adds |weight| times each value in |src| to the corresponding one in |dst|.
+static void AccumulateRow(const float* src, float weight, size_t count,
+                          float* dst) {
+  size_t i = 0;
+#if ION_RESAMPLE_SSE2
+  const __m128 weights = _mm_set1_ps(weight);
+  for (; i + 4U <= count; i += 4U) {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+                                      _mm_mul_ps(weights,
+                                                 _mm_loadu_ps(src + i))));
+  }
+#elif ION_RESAMPLE_NEON
+  for (; i + 4U <= count; i += 4U)
+    vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i),
+                                   weight));
+#endif
+  for (; i < count; ++i)
+    dst[i] += weight * src[i];
+}
+
+//-----------------------------------------------------------------------------
+//
+// Resampling.
+//
+//-----------------------------------------------------------------------------
+
+// Calls func for ranges of [0, count), in parallel if there is a scheduler.
+static void ForEachRange(base::TaskScheduler* scheduler, size_t count,
+                         const base::TaskScheduler::RangeFunction& func) {
+  if (scheduler)
+    scheduler->ParallelFor(0U, count, 0U, func);
+  else
+    func(0U, count);
+}
+
+static const ImagePtr AllocImage(Image::Format format, uint32 width,
+                                 uint32 height, bool is_wipeable,
+                                 const base::AllocatorPtr& allocator) {
+  ImagePtr result(new(allocator) Image);
+  result->Set(format, width, height,
+              base::DataContainer::CreateAndCopy<uint8>(
+                  NULL, Image::ComputeDataSize(format, width, height),
+                  is_wipeable, result->GetAllocator()));
+  return result;
+}
+
+template <typename T>
+static void Resample(const Image& image, ResampleFilter filter,
+                     base::TaskScheduler* scheduler, Image* result) {
+  const size_t channels = Image::GetNumComponentsForFormat(image.GetFormat());
+  const size_t in_height = image.GetHeight();
+  const size_t out_height = result->GetHeight();
+  const size_t in_row_size = image.GetWidth() * channels;
+  const size_t out_row_size = result->GetWidth() * channels;
+  FilterTable x_table;
+  FilterTable y_table;
+  BuildFilterTable(filter, image.GetWidth(), result->GetWidth(), &x_table);
+  BuildFilterTable(filter, in_height, out_height, &y_table);
+  const T* src = image.GetData()->GetData<T>();
+  T* dst = result->GetData()->GetMutableData<T>();
+
+  // Filter each source row horizontally.
+  std::vector<float> filtered(in_height * out_row_size);
+  ForEachRange(scheduler, in_height, [&](size_t begin, size_t end) {
+    std::vector<float> row(in_row_size);
+    for (size_t y = begin; y < end; ++y) {
+      LoadRow(src + y * in_row_size, in_row_size, &row[0]);
+      FilterRow(x_table, &row[0], channels, &filtered[y * out_row_size]);
+    }
+  });
+
+  // Combine the filtered rows vertically.
+  ForEachRange(scheduler, out_height, [&](size_t begin, size_t end) {
+    std::vector<float> row(out_row_size);
+    for (size_t y = begin; y < end; ++y) {
+      std::fill(row.begin(), row.end(), 0.f);
+      const float* weights = &y_table.weights[y * y_table.taps];
+      const float* rows = &filtered[y_table.starts[y] * out_row_size];
+      for (size_t t = 0; t < y_table.taps; ++t) {
+        if (weights[t] != 0.f)
+          AccumulateRow(rows + t * out_row_size, weights[t], out_row_size,
+                        &row[0]);
+      }
+      StoreRow(&row[0], out_row_size, dst + y * out_row_size);
+    }
+  });
+}
+
+template <typename T>
+static void Halve(const Image& image, base::TaskScheduler* scheduler,
+                  Image* result) {
+  const size_t channels = Image::GetNumComponentsForFormat(image.GetFormat());
+  const size_t src_width = image.GetWidth();
+  const size_t src_height = image.GetHeight();
+  const size_t src_stride = src_width * channels;
+  const size_t dst_stride = result->GetWidth() * channels;
+  const T* src = image.GetData()->GetData<T>();
+  T* dst = result->GetData()->GetMutableData<T>();
+  ForEachRange(scheduler, result->GetHeight(), [&](size_t begin, size_t end) {
+    for (size_t dst_y = begin; dst_y < end; ++dst_y) {
+      const size_t src_y = dst_y * 2U;
+      // Repeat the last row and column of odd sized images.
+      const size_t next_row = src_y + 1U < src_height ? src_stride : 0U;
+      const T* src_row = src + src_y * src_stride;
+      T* dst_row = dst + dst_y * dst_stride;
+      for (size_t src_x = 0; src_x < src_width; src_x += 2U) {
+        const T* p = src_row + src_x * channels;
+        const size_t next_col = src_x + 1U < src_width ? channels : 0U;
+        for (size_t c = 0; c < channels; ++c) {
+          *dst_row++ = ChannelTraits<T>::Average(
+              p[c], p[c + next_col], p[c + next_row],
+              p[c + next_col + next_row]);
+        }
+      }
+    }
+  });
+}
+
+// Returns an image holding the pixels of a packed float image unpacked to
+// floats, allocated with the default allocator.
+static const ImagePtr UnpackImage(const Image& image) {
+  const bool has_alpha = image.GetFormat() == Image::kRgb10a2;
+  const uint32 width = image.GetWidth();
+  const uint32 height = image.GetHeight();
+  const ImagePtr result =
+      AllocImage(has_alpha ? Image::kRgba32f : Image::kRgb32f, width, height,
+                 true, base::AllocatorPtr());
+  const uint32* src = image.GetData()->GetData<uint32>();
+  float* dst = result->GetData()->GetMutableData<float>();
+  const size_t num_pixels = static_cast<size_t>(width) * height;
+  if (has_alpha)
+    ConvertRgb10a2ToRgba32f(src, dst, num_pixels);
+  else
+    ConvertRgb11f11f10fToRgb32f(src, dst, num_pixels);
+  return result;
+}
+
+// Packs the pixels of an image unpacked by UnpackImage() into |result|.
+static void PackImage(const Image& image, Image* result) {
+  const float* src = image.GetData()->GetData<float>();
+  uint32* dst = result->GetData()->GetMutableData<uint32>();
+  const size_t num_pixels =
+      static_cast<size_t>(image.GetWidth()) * image.GetHeight();
+  if (result->GetFormat() == Image::kRgb10a2)
+    ConvertRgba32fToRgb10a2(src, dst, num_pixels);
+  else
+    ConvertRgb32fToRgb11f11f10f(src, dst, num_pixels);
+}
+
+static bool HasData(const ImagePtr& image) {
+  return image.Get() && image->GetData().Get() && image->GetData()->GetData();
+}
+
+}  // anonymous namespace
+
+bool IsResamplingSupported(Image::Format format) {
+  return GetChannelType(format) != kUnsupportedChannels;
+}
+
+const ImagePtr ResampleImage(const ImagePtr& image, uint32 out_width,
+                             uint32 out_height, ResampleFilter filter,
+                             bool is_wipeable,
+                             const base::AllocatorPtr& allocator,
+                             base::TaskScheduler* scheduler) {
+  ImagePtr result;
+  if (!HasData(image) || out_width == 0U || out_height == 0U)
+    return result;
+  const ChannelType type = GetChannelType(image->GetFormat());
+  if (type == kUnsupportedChannels) {
+    LOG(WARNING) << "Resizing image format "
+                 << Image::GetFormatString(image->GetFormat())
+                 << " not supported.";
+    return result;
+  }
+  base::SamplingAllocationTracker::ScopedTag tag("image");
+  result = AllocImage(image->GetFormat(), out_width, out_height, is_wipeable,
+                      allocator);
+  switch (type) {
+    case kUint8Channels:
+      Resample<uint8>(*image, filter, scheduler, result.Get());
+      break;
+    case kUint16Channels:
+      Resample<uint16>(*image, filter, scheduler, result.Get());
+      break;
+    case kHalfChannels:
+      Resample<Half>(*image, filter, scheduler, result.Get());
+      break;
+    case kPackedFloatChannels: {
+      const ImagePtr unpacked = UnpackImage(*image);
+      const ImagePtr resampled =
+          AllocImage(unpacked->GetFormat(), out_width, out_height, true,
+                     base::AllocatorPtr());
+      Resample<float>(*unpacked, filter, scheduler, resampled.Get());
+      PackImage(*resampled, result.Get());
+      break;
+    }
+    case kFloatChannels:
+    default:
+      Resample<float>(*image, filter, scheduler, result.Get());
+      break;
+  }
+  return result;
+}
+
+const ImagePtr HalveImage(const ImagePtr& image, bool is_wipeable,
+                          const base::AllocatorPtr& allocator,
+                          base::TaskScheduler* scheduler) {
+  ImagePtr result;
+  if (!HasData(image))
+    return result;
+  const ChannelType type = GetChannelType(image->GetFormat());
+  if (type == kUnsupportedChannels) {
+    LOG(WARNING) << "Downsampling image format "
+                 << Image::GetFormatString(image->GetFormat())
+                 << " not supported.";
+    return result;
+  }
+  base::SamplingAllocationTracker::ScopedTag tag("image");
+  result = AllocImage(image->GetFormat(), (image->GetWidth() + 1U) >> 1,
+                      (image->GetHeight() + 1U) >> 1, is_wipeable, allocator);
+  switch (type) {
+    case kUint8Channels:
+      Halve<uint8>(*image, scheduler, result.Get());
+      break;
+    case kUint16Channels:
+      Halve<uint16>(*image, scheduler, result.Get());
+      break;
+    case kHalfChannels:
+      Halve<Half>(*image, scheduler, result.Get());
+      break;
+    case kPackedFloatChannels: {
+      const ImagePtr unpacked = UnpackImage(*image);
+      const ImagePtr halved =
+          AllocImage(unpacked->GetFormat(), result->GetWidth(),
+                     result->GetHeight(), true, base::AllocatorPtr());
+      Halve<float>(*unpacked, scheduler, halved.Get());
+      PackImage(*halved, result.Get());
+      break;
+    }
+    case kFloatChannels:
+    default:
+      Halve<float>(*image, scheduler, result.Get());
+      break;
+  }
+  return result;
+}
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,89 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_RESAMPLEUTILS_H_
+#define ION_IMAGE_RESAMPLEUTILS_H_
+
+// This file contains functions that resample uncompressed images. They work
+// on images with 8-bit or 16-bit unsigned integer channels, on half and 32-bit
+// float images, and on kRgb10a2 and kRgb11f_11f_10f_Rev images, which are
+// unpacked to floats and packed again afterwards. Resampling is separable:
+// each source row is filtered horizontally using a precomputed table of filter
+// weights, and the filtered rows are then combined vertically, so the cost per
+// output pixel grows with the filter width rather than with its area. Edge
+// pixels are repeated to fill the filter footprint outside the image.
+//
+// Integer, half float and packed channels are filtered in 32-bit float. The
+// math does not account for straight alpha, so premultiplied images give
+// better results where opacity changes.
+
+#include "base/integral_types.h"
+#include "ion/base/allocator.h"
+#include "ion/gfx/image.h"
+
+namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
+namespace image {
+
+// The filters that can be used to compute resampled pixels. When an image is
+// shrunk along an axis the filter is widened by the same factor, so that all
+// source pixels contribute to the result.
+enum ResampleFilter {
+  // Averages the source pixels covered by each output pixel, weighted by the
+  // covered area. This is fast and works well for shrinking images.
+  kBoxFilter,
+  // Interpolates linearly between the nearest source pixels. This works well
+  // for enlarging images.
+  kBilinearFilter,
+  // The Mitchell-Netravali cubic filter with B = C = 1/3, which is sharper
+  // than kBilinearFilter with little ringing.
+  kMitchellFilter,
+  // A sinc filter windowed to 3 lobes. This is the sharpest filter, but may
+  // ring near hard edges.
+  kLanczos3Filter,
+};
+
+// Returns whether images of the given format can be resampled.
+ION_API bool IsResamplingSupported(gfx::Image::Format format);
+
+// Returns a copy of |image| resampled to the specified dimensions using
+// |filter|, or a NULL pointer if the image has no data, its format is not
+// supported, or either dimension is 0. The |is_wipeable| flag is passed to the
+// DataContainer for the new Image, which is allocated with |allocator|, or the
+// default allocator if it is NULL. If |scheduler| is not NULL, rows are
+// filtered in parallel on its threads.
+ION_API const gfx::ImagePtr ResampleImage(
+    const gfx::ImagePtr& image, uint32 out_width, uint32 out_height,
+    ResampleFilter filter, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler);
+
+// Returns an image half the width and height of |image|, rounded up, where
+// each pixel is the average of a 2x2 block of source pixels. The last row and
+// column are repeated for odd sizes. Returns a NULL pointer if the image has
+// no data or its format is not supported. The other arguments are as for
+// ResampleImage().
+ION_API const gfx::ImagePtr HalveImage(
+    const gfx::ImagePtr& image, bool is_wipeable,
+    const base::AllocatorPtr& allocator, base::TaskScheduler* scheduler);
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_RESAMPLEUTILS_H_
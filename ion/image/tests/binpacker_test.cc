@@ -15,13 +15,13 @@ limitations under the License.
 
 */
 
-#include "ion/text/binpacker.h"
+#include "ion/image/binpacker.h"
 
 #include "ion/math/vector.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 namespace ion {
-namespace text {
+namespace image {
 
 TEST(BinPackerTest, OneBin) {
   BinPacker bp;
@@ -255,7 +255,14 @@ TEST(BinPackerTest, CopyAndAssign) {
     EXPECT_EQ(math::Vector2ui(8, 2), rects[3].size);
     EXPECT_EQ(math::Point2ui(0, 10), rects[3].bottom_left);
   }
+
+  // Assigning an unpacked BinPacker discards the packed state.
+  bp = BinPacker();
+  bp.AddRectangle(4, math::Vector2ui(20, 12));
+  EXPECT_TRUE(bp.Pack(math::Vector2ui(20, 12)));
+  ASSERT_EQ(1U, bp.GetRectangles().size());
+  EXPECT_EQ(math::Point2ui(0, 0), bp.GetRectangles()[0].bottom_left);
 }
 
-}  // namespace text
+}  // namespace image
 }  // namespace ion
@@ -0,0 +1,360 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/blockdecoders.h"
+
+#include <string.h>  // For memcpy().
+
+#include <vector>
+
+#include "ion/base/datacontainer.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+// Returns an image of the given format and size holding a copy of |blocks|,
+// which is repeated to fill the image.
+static const ImagePtr CreateImage(Image::Format format, uint32 width,
+                                  uint32 height,
+                                  const std::vector<uint8>& blocks) {
+  const size_t size = Image::ComputeDataSize(format, width, height);
+  std::vector<uint8> data(size);
+  for (size_t i = 0; i < size; ++i)
+    data[i] = blocks[i % blocks.size()];
+  ImagePtr image(new Image);
+  image->Set(format, width, height,
+             base::DataContainer::CreateAndCopy<uint8>(&data[0], size, false,
+                                                       image->GetAllocator()));
+  return image;
+}
+
+// Decodes a single block of |format| whose pixels are |width| x |height|.
+static const std::vector<uint8> DecodeBlock(Image::Format format, uint32 width,
+                                            uint32 height,
+                                            const std::vector<uint8>& block) {
+  const ImagePtr decoded = DecodeCompressedImage(
+      CreateImage(format, width, height, block), false, base::AllocatorPtr());
+  EXPECT_TRUE(decoded.Get());
+  if (!decoded.Get())
+    return std::vector<uint8>();
+  EXPECT_EQ(GetBlockDecodedFormat(format), decoded->GetFormat());
+  const uint8* data = decoded->GetData()->GetData<uint8>();
+  return std::vector<uint8>(data, data + decoded->GetDataSize());
+}
+
+static const std::vector<uint8> MakeBlock(const uint8* bytes, size_t count) {
+  return std::vector<uint8>(bytes, bytes + count);
+}
+
+// Returns pixel (x, y) of 4x4 decoded RGBA or RGB pixels.
+static const std::vector<uint8> GetPixel(const std::vector<uint8>& pixels,
+                                         int components, int x, int y) {
+  const size_t offset = (y * 4 + x) * components;
+  return std::vector<uint8>(pixels.begin() + offset,
+                            pixels.begin() + offset + components);
+}
+
+static const std::vector<uint8> Rgba(uint8 r, uint8 g, uint8 b, uint8 a) {
+  const uint8 values[] = { r, g, b, a };
+  return std::vector<uint8>(values, values + 4);
+}
+
+static const std::vector<uint8> Rgb(uint8 r, uint8 g, uint8 b) {
+  const uint8 values[] = { r, g, b };
+  return std::vector<uint8>(values, values + 3);
+}
+
+// Sets |count| bits of an ASTC block starting at bit |pos| to |value|. If
+// |reversed| is set the bits are counted down from the top of the block, as
+// for weights.
+static void SetAstcBits(std::vector<uint8>* block, int pos, int count,
+                        uint32 value, bool reversed) {
+  for (int i = 0; i < count; ++i) {
+    const int bit = reversed ? 127 - (pos + i) : pos + i;
+    if ((value >> i) & 1)
+      (*block)[bit >> 3] |= static_cast<uint8>(1 << (bit & 7));
+  }
+}
+
+}  // anonymous namespace
+
+TEST(BlockDecoders, SupportedFormats) {
+  EXPECT_TRUE(IsBlockDecodingSupported(Image::kEtc2Rgb));
+  EXPECT_TRUE(IsBlockDecodingSupported(Image::kEtc2Rgba1));
+  EXPECT_TRUE(IsBlockDecodingSupported(Image::kEtc2Rgba));
+  EXPECT_TRUE(IsBlockDecodingSupported(Image::kEacR11));
+  EXPECT_TRUE(IsBlockDecodingSupported(Image::kEacRg11));
+  EXPECT_TRUE(IsBlockDecodingSupported(Image::kAstc4x4Rgba));
+  EXPECT_TRUE(IsBlockDecodingSupported(Image::kAstc12x12Rgba));
+  EXPECT_FALSE(IsBlockDecodingSupported(Image::kDxt1));
+  EXPECT_FALSE(IsBlockDecodingSupported(Image::kEtc1));
+  EXPECT_FALSE(IsBlockDecodingSupported(Image::kRgba8888));
+
+  EXPECT_EQ(Image::kRgb888, GetBlockDecodedFormat(Image::kEtc2Rgb));
+  EXPECT_EQ(Image::kRgba8888, GetBlockDecodedFormat(Image::kEtc2Rgba1));
+  EXPECT_EQ(Image::kRgba8888, GetBlockDecodedFormat(Image::kEtc2Rgba));
+  EXPECT_EQ(Image::kR8, GetBlockDecodedFormat(Image::kEacR11));
+  EXPECT_EQ(Image::kRg8, GetBlockDecodedFormat(Image::kEacRg11));
+  EXPECT_EQ(Image::kRgba8888, GetBlockDecodedFormat(Image::kAstc8x6Rgba));
+  EXPECT_EQ(Image::kDxt1, GetBlockDecodedFormat(Image::kDxt1));
+
+  // Images without data or with unsupported formats are not decoded.
+  base::AllocatorPtr al;
+  EXPECT_FALSE(DecodeCompressedImage(ImagePtr(), false, al).Get());
+  ImagePtr image(new Image);
+  image->Set(Image::kEtc2Rgb, 4U, 4U, base::DataContainerPtr());
+  EXPECT_FALSE(DecodeCompressedImage(image, false, al).Get());
+  std::vector<uint8> block(8U, 0);
+  EXPECT_FALSE(DecodeCompressedImage(CreateImage(Image::kDxt1, 4U, 4U, block),
+                                     false, al).Get());
+}
+
+TEST(BlockDecoders, Etc2Modes) {
+  // Individual mode, with a red left half and a black right half. All pixels
+  // use the small positive modifier of table 0.
+  {
+    const uint8 kBlock[] = { 0xF0, 0x00, 0x00, 0x00, 0, 0, 0, 0 };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgb, 4U, 4U, MakeBlock(kBlock, 8U));
+    ASSERT_EQ(48U, pixels.size());
+    EXPECT_EQ(Rgb(255, 2, 2), GetPixel(pixels, 3, 0, 0));
+    EXPECT_EQ(Rgb(255, 2, 2), GetPixel(pixels, 3, 1, 3));
+    EXPECT_EQ(Rgb(2, 2, 2), GetPixel(pixels, 3, 2, 0));
+    EXPECT_EQ(Rgb(2, 2, 2), GetPixel(pixels, 3, 3, 3));
+  }
+
+  // Differential mode with flipped halves: red is 16 in the top half and 17
+  // in the bottom one, as 5-bit values. All pixels use the large negative
+  // modifier.
+  {
+    const uint8 kBlock[] = { 0x81, 0x00, 0x00, 0x03, 0xFF, 0xFF, 0xFF, 0xFF };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgb, 4U, 4U, MakeBlock(kBlock, 8U));
+    ASSERT_EQ(48U, pixels.size());
+    EXPECT_EQ(Rgb(124, 0, 0), GetPixel(pixels, 3, 3, 1));
+    EXPECT_EQ(Rgb(132, 0, 0), GetPixel(pixels, 3, 0, 2));
+  }
+
+  // T mode, selected by red overflowing. Pixels (1, 0), (0, 1) and (1, 1) use
+  // paint colors 1, 2 and 3; the others use color 0.
+  {
+    const uint8 kBlock[] = { 0xF9, 0x00, 0xF0, 0x02, 0x00, 0x22, 0x00, 0x30 };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgb, 4U, 4U, MakeBlock(kBlock, 8U));
+    ASSERT_EQ(48U, pixels.size());
+    EXPECT_EQ(Rgb(221, 0, 0), GetPixel(pixels, 3, 0, 0));
+    EXPECT_EQ(Rgb(255, 3, 3), GetPixel(pixels, 3, 1, 0));
+    EXPECT_EQ(Rgb(255, 0, 0), GetPixel(pixels, 3, 0, 1));
+    EXPECT_EQ(Rgb(252, 0, 0), GetPixel(pixels, 3, 1, 1));
+    EXPECT_EQ(Rgb(221, 0, 0), GetPixel(pixels, 3, 3, 3));
+  }
+
+  // H mode, selected by green overflowing. All pixels use paint color 0.
+  {
+    const uint8 kBlock[] = { 0x00, 0xF9, 0x00, 0x02, 0, 0, 0, 0 };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgb, 4U, 4U, MakeBlock(kBlock, 8U));
+    ASSERT_EQ(48U, pixels.size());
+    EXPECT_EQ(Rgb(6, 23, 176), GetPixel(pixels, 3, 0, 0));
+    EXPECT_EQ(Rgb(6, 23, 176), GetPixel(pixels, 3, 3, 2));
+  }
+
+  // Planar mode, selected by blue overflowing. Blue fades from the origin
+  // color to black at the right and bottom edges.
+  {
+    const uint8 kBlock[] = { 0x00, 0x00, 0xF9, 0x02, 0, 0, 0, 0 };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgb, 4U, 4U, MakeBlock(kBlock, 8U));
+    ASSERT_EQ(48U, pixels.size());
+    EXPECT_EQ(Rgb(0, 0, 105), GetPixel(pixels, 3, 0, 0));
+    EXPECT_EQ(Rgb(0, 0, 79), GetPixel(pixels, 3, 1, 0));
+    EXPECT_EQ(Rgb(0, 0, 53), GetPixel(pixels, 3, 1, 1));
+    EXPECT_EQ(Rgb(0, 0, 0), GetPixel(pixels, 3, 3, 3));
+  }
+}
+
+TEST(BlockDecoders, Etc2Alpha) {
+  // A non-opaque punchthrough block: pixel (0, 0) is transparent, (1, 0) has
+  // no modifier and (2, 0) has the large positive one.
+  {
+    const uint8 kBlock[] = { 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00 };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgba1, 4U, 4U, MakeBlock(kBlock, 8U));
+    ASSERT_EQ(64U, pixels.size());
+    EXPECT_EQ(Rgba(0, 0, 0, 0), GetPixel(pixels, 4, 0, 0));
+    EXPECT_EQ(Rgba(132, 0, 0, 255), GetPixel(pixels, 4, 1, 0));
+    EXPECT_EQ(Rgba(140, 8, 8, 255), GetPixel(pixels, 4, 2, 0));
+  }
+
+  // The same block with the opaque bit set is decoded as ETC2 RGB.
+  {
+    const uint8 kBlock[] = { 0x80, 0x00, 0x00, 0x02, 0x00, 0x01, 0x01, 0x00 };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgba1, 4U, 4U, MakeBlock(kBlock, 8U));
+    ASSERT_EQ(64U, pixels.size());
+    EXPECT_EQ(Rgba(130, 0, 0, 255), GetPixel(pixels, 4, 0, 0));
+    EXPECT_EQ(Rgba(134, 2, 2, 255), GetPixel(pixels, 4, 1, 0));
+  }
+
+  // An EAC alpha block with base 128 and multiplier 1 followed by the
+  // individual mode color block above. Pixel (0, 0) uses the modifier +9, and
+  // the others -1.
+  {
+    const uint8 kBlock[] = { 0x80, 0x1D, 0xE0, 0x00, 0x00, 0x00, 0x00, 0x00,
+                             0xF0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEtc2Rgba, 4U, 4U, MakeBlock(kBlock, 16U));
+    ASSERT_EQ(64U, pixels.size());
+    EXPECT_EQ(Rgba(255, 2, 2, 137), GetPixel(pixels, 4, 0, 0));
+    EXPECT_EQ(Rgba(255, 2, 2, 127), GetPixel(pixels, 4, 0, 1));
+    EXPECT_EQ(Rgba(2, 2, 2, 127), GetPixel(pixels, 4, 3, 3));
+  }
+}
+
+TEST(BlockDecoders, Eac11) {
+  // Base 100 with multiplier 0, so every pixel is 100 * 8 + 4 plus the
+  // modifier of index 4 of table 13, which is 0.
+  static const uint8 kRed[] = { 100, 0x0D, 0x92, 0x49, 0x24, 0x92, 0x49, 0x24 };
+  // Base 255 with multiplier 15 and the modifier +14, clamped to 2047. Pixel
+  // (0, 0) uses index 0, which subtracts 3 * 15 * 8.
+  static const uint8 kGreen[] = { 255, 0xF0, 0x1F, 0xFF, 0xFF, 0xFF, 0xFF,
+                                  0xFF };
+  {
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEacR11, 4U, 4U, MakeBlock(kRed, 8U));
+    ASSERT_EQ(16U, pixels.size());
+    for (size_t i = 0; i < pixels.size(); ++i)
+      EXPECT_EQ(100U, pixels[i]);
+  }
+  {
+    std::vector<uint8> block = MakeBlock(kRed, 8U);
+    block.insert(block.end(), kGreen, kGreen + 8);
+    const std::vector<uint8> pixels =
+        DecodeBlock(Image::kEacRg11, 4U, 4U, block);
+    ASSERT_EQ(32U, pixels.size());
+    EXPECT_EQ(100U, pixels[0]);
+    // (2044 - 360) * 255 / 2047, rounded.
+    EXPECT_EQ(210U, pixels[1]);
+    EXPECT_EQ(100U, pixels[30]);
+    EXPECT_EQ(255U, pixels[31]);
+  }
+}
+
+TEST(BlockDecoders, PartialBlocksAndSlices) {
+  // A 6x5 image has 2x2 blocks; each has the colors of its column.
+  static const uint8 kRedBlock[] = { 0xF0, 0x00, 0x00, 0x00, 0, 0, 0, 0 };
+  static const uint8 kBlackBlock[] = { 0x00, 0x00, 0x00, 0x00, 0, 0, 0, 0 };
+  std::vector<uint8> blocks = MakeBlock(kRedBlock, 8U);
+  blocks.insert(blocks.end(), kBlackBlock, kBlackBlock + 8);
+  const ImagePtr image = CreateImage(Image::kEtc2Rgb, 6U, 5U, blocks);
+  const ImagePtr decoded =
+      DecodeCompressedImage(image, true, base::AllocatorPtr());
+  ASSERT_TRUE(decoded.Get());
+  EXPECT_EQ(Image::kRgb888, decoded->GetFormat());
+  EXPECT_EQ(6U, decoded->GetWidth());
+  EXPECT_EQ(5U, decoded->GetHeight());
+  EXPECT_TRUE(decoded->GetData()->IsWipeable());
+  const uint8* pixels = decoded->GetData()->GetData<uint8>();
+  // Pixel (2, 4) is in the red block, and (5, 4) in the black one.
+  EXPECT_EQ(2U, pixels[(4 * 6 + 2) * 3]);
+  EXPECT_EQ(2U, pixels[(4 * 6 + 5) * 3]);
+  EXPECT_EQ(255U, pixels[(4 * 6 + 0) * 3]);
+
+  // Each slice of a 3D image is decoded.
+  ImagePtr volume(new Image);
+  std::vector<uint8> slices = MakeBlock(kRedBlock, 8U);
+  slices.insert(slices.end(), kBlackBlock, kBlackBlock + 8);
+  volume->Set(Image::kEtc2Rgb, 4U, 4U, 2U,
+              base::DataContainer::CreateAndCopy<uint8>(
+                  &slices[0], slices.size(), false, volume->GetAllocator()));
+  const ImagePtr decoded_volume =
+      DecodeCompressedImage(volume, false, base::AllocatorPtr());
+  ASSERT_TRUE(decoded_volume.Get());
+  EXPECT_EQ(Image::k3d, decoded_volume->GetDimensions());
+  EXPECT_EQ(2U, decoded_volume->GetDepth());
+  const uint8* voxels = decoded_volume->GetData()->GetData<uint8>();
+  EXPECT_EQ(255U, voxels[0]);
+  EXPECT_EQ(2U, voxels[48]);
+}
+
+TEST(BlockDecoders, AstcVoidExtent) {
+  std::vector<uint8> block(16U, 0);
+  // Void-extent mode with all extent coordinates set, and a 16-bit color.
+  SetAstcBits(&block, 0, 12, 0xDFC, false);
+  SetAstcBits(&block, 12, 52, 0, false);
+  for (int i = 12; i < 64; ++i)
+    SetAstcBits(&block, i, 1, 1U, false);
+  SetAstcBits(&block, 64, 16, 0xFF00, false);
+  SetAstcBits(&block, 80, 16, 0x8000, false);
+  SetAstcBits(&block, 96, 16, 0x4000, false);
+  SetAstcBits(&block, 112, 16, 0xFFFF, false);
+  std::vector<uint8> pixels = DecodeBlock(Image::kAstc4x4Rgba, 4U, 4U, block);
+  ASSERT_EQ(64U, pixels.size());
+  EXPECT_EQ(Rgba(255, 128, 64, 255), GetPixel(pixels, 4, 0, 0));
+  EXPECT_EQ(Rgba(255, 128, 64, 255), GetPixel(pixels, 4, 3, 3));
+
+  // HDR void-extent blocks decode to the error color.
+  SetAstcBits(&block, 9, 1, 1U, false);
+  pixels = DecodeBlock(Image::kAstc4x4Rgba, 4U, 4U, block);
+  ASSERT_EQ(64U, pixels.size());
+  EXPECT_EQ(Rgba(255, 0, 255, 255), GetPixel(pixels, 4, 2, 1));
+
+  // So do reserved block modes.
+  pixels = DecodeBlock(Image::kAstc4x4Rgba, 4U, 4U,
+                       std::vector<uint8>(16U, 0));
+  ASSERT_EQ(64U, pixels.size());
+  EXPECT_EQ(Rgba(255, 0, 255, 255), GetPixel(pixels, 4, 0, 0));
+}
+
+TEST(BlockDecoders, AstcLuminanceBlock) {
+  // A 4x4 weight grid with 2-bit weights, one partition and the direct
+  // luminance endpoint mode, with endpoints 0 and 255 stored in 8 bits.
+  std::vector<uint8> block(16U, 0);
+  SetAstcBits(&block, 0, 11, 0x42, false);
+  SetAstcBits(&block, 13, 4, 0U, false);
+  SetAstcBits(&block, 17, 8, 0U, false);
+  SetAstcBits(&block, 25, 8, 255U, false);
+  // The first three pixels use weights 0, 1 and 2, which become 0, 21 and 43
+  // out of 64; the others use the second endpoint.
+  for (int i = 0; i < 16; ++i)
+    SetAstcBits(&block, 2 * i, 2, i < 3 ? static_cast<uint32>(i) : 3U, true);
+  const std::vector<uint8> pixels =
+      DecodeBlock(Image::kAstc4x4Rgba, 4U, 4U, block);
+  ASSERT_EQ(64U, pixels.size());
+  EXPECT_EQ(Rgba(0, 0, 0, 255), GetPixel(pixels, 4, 0, 0));
+  EXPECT_EQ(Rgba(84, 84, 84, 255), GetPixel(pixels, 4, 1, 0));
+  EXPECT_EQ(Rgba(171, 171, 171, 255), GetPixel(pixels, 4, 2, 0));
+  EXPECT_EQ(Rgba(255, 255, 255, 255), GetPixel(pixels, 4, 3, 0));
+  EXPECT_EQ(Rgba(255, 255, 255, 255), GetPixel(pixels, 4, 3, 3));
+
+  // The same block in a 6x6 image with 8x8 blocks is cropped.
+  const ImagePtr decoded = DecodeCompressedImage(
+      CreateImage(Image::kAstc8x8Rgba, 6U, 6U, block), false,
+      base::AllocatorPtr());
+  ASSERT_TRUE(decoded.Get());
+  EXPECT_EQ(6U * 6U * 4U, decoded->GetDataSize());
+  EXPECT_EQ(0U, decoded->GetData()->GetData<uint8>()[0]);
+}
+
+}  // namespace image
+}  // namespace ion
@@ -26,6 +26,9 @@ limitations under the License.
 #include "base/macros.h"  // For ARRAYSIZE().
 #include "ion/base/datacontainer.h"
 #include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/image/pixelkernels.h"
+#include "ion/image/resampleutils.h"
 #include "ion/image/tests/image_bytes.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -86,6 +89,62 @@ static bool ConversionIsSupported(Image::Format from, Image::Format to) {
     support_matrix[Image::kLuminance][Image::kRgba8888] = true;
     support_matrix[Image::kLuminanceAlpha][Image::kRgb888] = true;
     support_matrix[Image::kLuminanceAlpha][Image::kRgba8888] = true;
+
+    // ETC2, EAC and ASTC images are decoded and then converted further.
+    support_matrix[Image::kEtc2Rgb][Image::kRgb888] = true;
+    support_matrix[Image::kEtc2Rgb][Image::kDxt1] = true;
+    support_matrix[Image::kEtc2Rgb][Image::kEtc1] = true;
+    support_matrix[Image::kEtc2Rgb][Image::kR8] = true;
+    support_matrix[Image::kEacR11][Image::kR8] = true;
+    support_matrix[Image::kEacRg11][Image::kRg8] = true;
+    static const Image::Format kRgbaDecodedFormats[] = {
+        Image::kEtc2Rgba1, Image::kEtc2Rgba, Image::kAstc4x4Rgba,
+        Image::kAstc5x4Rgba, Image::kAstc5x5Rgba, Image::kAstc6x5Rgba,
+        Image::kAstc6x6Rgba, Image::kAstc8x5Rgba, Image::kAstc8x6Rgba,
+        Image::kAstc8x8Rgba, Image::kAstc10x5Rgba, Image::kAstc10x6Rgba,
+        Image::kAstc10x8Rgba, Image::kAstc10x10Rgba, Image::kAstc12x10Rgba,
+        Image::kAstc12x12Rgba };
+    for (size_t i = 0; i < ARRAYSIZE(kRgbaDecodedFormats); ++i) {
+      const Image::Format format = kRgbaDecodedFormats[i];
+      support_matrix[format][Image::kRgba8888] = true;
+      support_matrix[format][Image::kDxt5] = true;
+      support_matrix[format][Image::kPvrtc1Rgba2] = true;
+      support_matrix[format][Image::kR8] = true;
+    }
+
+    // Float formats convert to and from each other and 8-bit RGB(A), which
+    // then convert further.
+    static const Image::Format kFloatRowFormats[] = {
+        Image::kRgb888, Image::kRgba8888, Image::kRgb32f, Image::kRgba32f,
+        Image::kRgb16fHalf, Image::kRgba16fHalf, Image::kRgb10a2,
+        Image::kRgb11f_11f_10f_Rev };
+    for (size_t i = 2; i < ARRAYSIZE(kFloatRowFormats); ++i) {
+      const Image::Format format = kFloatRowFormats[i];
+      const Image::Format canonical =
+          Image::GetNumComponentsForFormat(format) == 3U ? Image::kRgb888
+                                                         : Image::kRgba8888;
+      for (size_t j = 0; j < ARRAYSIZE(kFloatRowFormats); ++j) {
+        support_matrix[format][kFloatRowFormats[j]] = true;
+        support_matrix[kFloatRowFormats[j]][format] = true;
+      }
+      for (int to = 0; to < kNumImageFormats; ++to) {
+        if (support_matrix[canonical][to])
+          support_matrix[format][to] = true;
+      }
+      // Formats that are converted to 8-bit RGB(A) first also convert to
+      // floats.
+      for (int from = 0; from < kNumImageFormats; ++from) {
+        const Image::Format from_format = static_cast<Image::Format>(from);
+        if (from_format == Image::kRgb888 || from_format == Image::kRgba8888)
+          continue;
+        const size_t channels = Image::GetNumComponentsForFormat(from_format);
+        const Image::Format from_canonical =
+            channels == 3U ? Image::kRgb888 : Image::kRgba8888;
+        if ((channels == 3U || channels == 4U) &&
+            support_matrix[from][from_canonical])
+          support_matrix[from][format] = true;
+      }
+    }
   }
 
   return support_matrix[from][to];
@@ -496,6 +555,52 @@ TEST(ConversionUtils, ImageToImage) {
   }
 }
 
+TEST(ConversionUtils, FloatFormats) {
+  base::AllocatorPtr al;
+  static const float kRgba[] = {
+    0.f, 0.5f, 1.f, 0.25f,
+    2.f, -1.f, 0.125f, 1.f,
+  };
+  ImagePtr image(new Image);
+  image->Set(Image::kRgba32f, 2, 1,
+             base::DataContainer::CreateAndCopy<float>(
+                 kRgba, ARRAYSIZE(kRgba), false, image->GetAllocator()));
+
+  // Half floats keep these values exactly.
+  ImagePtr half = ConvertImage(image, Image::kRgba16fHalf, false, al, al);
+  ASSERT_TRUE(half.Get());
+  const uint16* halves = half->GetData()->GetData<uint16>();
+  EXPECT_EQ(0x3800, halves[1]);
+  EXPECT_EQ(0xbc00, halves[5]);
+  ImagePtr round_trip = ConvertImage(half, Image::kRgba32f, false, al, al);
+  ASSERT_TRUE(round_trip.Get());
+  EXPECT_EQ(0, memcmp(kRgba, round_trip->GetData()->GetData(),
+                      sizeof(kRgba)));
+
+  // Packed floats drop alpha and clamp negative values.
+  ImagePtr packed =
+      ConvertImage(image, Image::kRgb11f_11f_10f_Rev, false, al, al);
+  ASSERT_TRUE(packed.Get());
+  ImagePtr rgb = ConvertImage(packed, Image::kRgb32f, false, al, al);
+  ASSERT_TRUE(rgb.Get());
+  static const float kRgb[] = { 0.f, 0.5f, 1.f, 2.f, 0.f, 0.125f };
+  EXPECT_EQ(0, memcmp(kRgb, rgb->GetData()->GetData(), sizeof(kRgb)));
+
+  // 8-bit formats are clamped to [0, 1].
+  ImagePtr bytes = ConvertImage(image, Image::kRgba8888, false, al, al);
+  ASSERT_TRUE(bytes.Get());
+  static const uint8 kBytes[] = { 0, 128, 255, 64, 255, 0, 32, 255 };
+  EXPECT_EQ(0, memcmp(kBytes, bytes->GetData()->GetData(), sizeof(kBytes)));
+  ImagePtr floats = ConvertImage(bytes, Image::kRgb32f, false, al, al);
+  ASSERT_TRUE(floats.Get());
+  EXPECT_EQ(1.f, floats->GetData()->GetData<float>()[2]);
+
+  ImagePtr rgb10a2 = ConvertImage(image, Image::kRgb10a2, false, al, al);
+  ASSERT_TRUE(rgb10a2.Get());
+  EXPECT_EQ(0x3ffU | (0x80U << 20) | (3U << 30),
+            rgb10a2->GetData()->GetData<uint32>()[1]);
+}
+
 TEST(ConversionUtils, ExtractRedChannel) {
   base::AllocatorPtr al;  // NULL pointer means use default allocator.
   bool is_wipeable = true;
@@ -706,6 +811,48 @@ TEST(ConversionUtils, CompressAndDecompressRGBA) {
   EXPECT_FALSE(image->GetData()->IsWipeable());
 }
 
+TEST(ConversionUtils, CompressInParallel) {
+  base::AllocatorPtr al;
+  base::TaskScheduler scheduler("compression", 2U);
+
+  // The height is not a multiple of the strip height, so the last strip is
+  // shorter than the others, and the width is not a multiple of the block
+  // size. The pattern has a prime length so that no two strips have the same
+  // pixels, and strips in the wrong order would be detected.
+  std::vector<uint8> pattern(251U);
+  for (size_t i = 0; i < pattern.size(); ++i)
+    pattern[i] = static_cast<uint8>(i * 7U);
+  static const Image::Format kFormats[][2] = {
+    { Image::kRgb888, Image::kDxt1 },
+    { Image::kRgb888, Image::kEtc1 },
+    { Image::kRgba8888, Image::kDxt5 },
+  };
+  for (size_t i = 0; i < ARRAYSIZE(kFormats); ++i) {
+    SCOPED_TRACE(Image::GetFormatString(kFormats[i][1]));
+    ImagePtr image =
+        CreateImageWithPattern(kFormats[i][0], 13U, 200U, pattern);
+    ImagePtr serial = ConvertImage(image, kFormats[i][1], false, al, al);
+    ImagePtr parallel =
+        ConvertImage(image, kFormats[i][1], false, al, al, &scheduler);
+    ASSERT_FALSE(serial.Get() == NULL);
+    ASSERT_FALSE(parallel.Get() == NULL);
+    EXPECT_EQ(kFormats[i][1], parallel->GetFormat());
+    EXPECT_EQ(serial->GetWidth(), parallel->GetWidth());
+    EXPECT_EQ(serial->GetHeight(), parallel->GetHeight());
+    ASSERT_EQ(serial->GetDataSize(), parallel->GetDataSize());
+    EXPECT_EQ(0, memcmp(serial->GetData()->GetData(),
+                        parallel->GetData()->GetData(),
+                        serial->GetDataSize()));
+  }
+
+  // PVRTC is compressed on the calling thread.
+  ImagePtr image = CreateImage(Image::kRgba8888, 128U, 128U);
+  ImagePtr pvrtc = ConvertImage(image, Image::kPvrtc1Rgba2, false, al, al,
+                                &scheduler);
+  ASSERT_FALSE(pvrtc.Get() == NULL);
+  EXPECT_EQ(Image::kPvrtc1Rgba2, pvrtc->GetFormat());
+}
+
 // PVRTC can only be compressed, not decompressed.
 TEST(ConversionUtils, CompressPvrtc1Rgba2) {
   base::AllocatorPtr al;  // NULL pointer means use default allocator.
@@ -980,13 +1127,177 @@ TEST(ConversionUtils, InferFormat) {
   EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
+TEST(ConversionUtils, DecodeExternalImageData) {
+  base::LogChecker log_checker;
+  uint32 width = 0U, height = 0U;
+  Image::Format format = Image::kInvalid;
+  const std::vector<uint8> png_data = Create8x8PngRgbData();
+  EXPECT_TRUE(GetExternalImageDataInfo(&png_data[0], png_data.size(), &width,
+                                       &height, &format));
+  EXPECT_EQ(8U, width);
+  EXPECT_EQ(8U, height);
+  EXPECT_EQ(Image::kRgb888, format);
+  const std::vector<uint8> raw_data = CreateRgb565IonRaw3x3BigEndianData();
+  EXPECT_TRUE(GetExternalImageDataInfo(&raw_data[0], raw_data.size(), &width,
+                                       &height, &format));
+  EXPECT_EQ(3U, width);
+  EXPECT_EQ(3U, height);
+  EXPECT_EQ(Image::kRgb565, format);
+  const std::vector<uint8> bad_data = CreateUnknownIonRawData();
+  EXPECT_FALSE(GetExternalImageDataInfo(&bad_data[0], bad_data.size(), &width,
+                                        &height, &format));
+
+  // Decoding into an image of the decoded format matches
+  // ConvertFromExternalImageData(), with and without flipping.
+  ImagePtr expected = ConvertFromExternalImageData(
+      &png_data[0], png_data.size(), false, false, base::AllocatorPtr());
+  ASSERT_FALSE(expected.Get() == NULL);
+  ImagePtr image = CreateImage(Image::kRgb888, 8U, 8U);
+  std::vector<uint32> rows_ready(8U, 0U);
+  EXPECT_TRUE(DecodeExternalImageData(
+      &png_data[0], png_data.size(), false, image,
+      [&rows_ready](uint32 first_row, uint32 row_count) {
+        for (uint32 row = first_row; row < first_row + row_count; ++row)
+          ++rows_ready[row];
+      }));
+  EXPECT_TRUE(ImageMatchesBytes(*image, expected->GetData()->GetData<uint8>(),
+                                expected->GetDataSize()));
+  // Each row is reported exactly once.
+  EXPECT_EQ(std::vector<uint32>(8U, 1U), rows_ready);
+  EXPECT_TRUE(DecodeExternalImageData(&png_data[0], png_data.size(), true,
+                                      image, DecodedRowsCallback()));
+  CompareFlipped(*expected, *image);
+
+  // Decoding into another format matches converting the decoded image.
+  const ImagePtr expected_red =
+      ConvertImage(expected, Image::kR8, false, base::AllocatorPtr(),
+                   base::AllocatorPtr());
+  ASSERT_FALSE(expected_red.Get() == NULL);
+  image = CreateImage(Image::kR8, 8U, 8U);
+  EXPECT_TRUE(DecodeExternalImageData(&png_data[0], png_data.size(), false,
+                                      image, DecodedRowsCallback()));
+  EXPECT_TRUE(ImageMatchesBytes(*image,
+                                expected_red->GetData()->GetData<uint8>(),
+                                expected_red->GetDataSize()));
+  std::vector<uint8> expected_bytes(8U * 8U * 4U);
+  ConvertRgb888ToRgba8888(expected->GetData()->GetData<uint8>(),
+                          &expected_bytes[0], 8U * 8U);
+  image = CreateImage(Image::kRgba8888, 8U, 8U);
+  EXPECT_TRUE(DecodeExternalImageData(&png_data[0], png_data.size(), false,
+                                      image, DecodedRowsCallback()));
+  EXPECT_TRUE(ImageMatchesBytes(*image, &expected_bytes[0],
+                                expected_bytes.size()));
+
+  // Byte-swapped "ION raw" data is swapped while writing.
+  image = CreateImage(Image::kRgb565, 3U, 3U);
+  EXPECT_TRUE(DecodeExternalImageData(&raw_data[0], raw_data.size(), false,
+                                      image, DecodedRowsCallback()));
+  EXPECT_TRUE(ImageMatchesBytes(
+      *image, testing::kExpectedRgb565IonRaw3x3ImageBytes,
+      testing::kExpectedRgb565IonRaw3x3ImageSizeInBytes));
+  ImagePtr rgba = CreateImage(Image::kRgba8888, 3U, 3U);
+  EXPECT_TRUE(DecodeExternalImageData(&raw_data[0], raw_data.size(), true,
+                                      rgba, DecodedRowsCallback()));
+  expected_bytes.resize(3U * 3U * 4U);
+  ConvertRgb565ToRgba8888(image->GetData()->GetData<uint16>(),
+                          &expected_bytes[0], 3U * 3U);
+  ImagePtr unflipped = CreateImageWithPattern(
+      Image::kRgba8888, 3U, 3U, expected_bytes);
+  CompareFlipped(*unflipped, *rgba);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // The target must have the decoded size and a supported format.
+  image = CreateImage(Image::kRgb888, 4U, 4U);
+  EXPECT_FALSE(DecodeExternalImageData(&png_data[0], png_data.size(), false,
+                                       image, DecodedRowsCallback()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "does not match"));
+  image = CreateImage(Image::kRgba16fHalf, 8U, 8U);
+  EXPECT_FALSE(DecodeExternalImageData(&png_data[0], png_data.size(), false,
+                                       image, DecodedRowsCallback()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "not supported"));
+  image = CreateImage(Image::kRgba8888, 3U, 3U);
+  EXPECT_FALSE(DecodeExternalImageData(&bad_data[0], bad_data.size(), false,
+                                       image, DecodedRowsCallback()));
+  EXPECT_FALSE(DecodeExternalImageData(NULL, 0U, false, image,
+                                       DecodedRowsCallback()));
+  EXPECT_FALSE(DecodeExternalImageData(&png_data[0], png_data.size(), false,
+                                       ImagePtr(), DecodedRowsCallback()));
+}
+
+TEST(ConversionUtils, ConvertFromExternalImageDataBatch) {
+  base::AllocatorPtr al;
+  const std::vector<uint8> png_data = Create8x8PngRgbData();
+  const std::vector<uint8> raw_data = CreateRgb565IonRaw3x3BigEndianData();
+  const std::vector<uint8> bad_data = CreateUnknownIonRawData();
+  std::vector<ExternalImageDecodeRequest> requests;
+  // Kept in the decoded format.
+  requests.push_back(ExternalImageDecodeRequest(
+      &png_data[0], png_data.size(), Image::kInvalid, false));
+  // Converted while writing rows.
+  requests.push_back(ExternalImageDecodeRequest(
+      &png_data[0], png_data.size(), Image::kRgba8888, true));
+  // Converted through an intermediate image.
+  requests.push_back(ExternalImageDecodeRequest(
+      &png_data[0], png_data.size(), Image::kDxt1, false));
+  requests.push_back(ExternalImageDecodeRequest(
+      &raw_data[0], raw_data.size(), Image::kInvalid, false));
+  requests.push_back(ExternalImageDecodeRequest(
+      &bad_data[0], bad_data.size(), Image::kInvalid, false));
+  requests.push_back(ExternalImageDecodeRequest());
+
+  const ImagePtr rgb = ConvertFromExternalImageData(
+      &png_data[0], png_data.size(), false, false, al);
+  const ImagePtr flipped_rgba = ConvertImage(
+      ConvertFromExternalImageData(&png_data[0], png_data.size(), true, false,
+                                   al),
+      Image::kRgba8888, false, al, al);
+  const ImagePtr dxt1 = ConvertImage(rgb, Image::kDxt1, false, al, al);
+  const ImagePtr rgb565 = ConvertFromExternalImageData(
+      &raw_data[0], raw_data.size(), false, false, al);
+
+  base::TaskScheduler scheduler("decode", 3U);
+  for (int parallel = 0; parallel < 2; ++parallel) {
+    SCOPED_TRACE(parallel);
+    std::vector<int> ready(requests.size(), 0);
+    const std::vector<ImagePtr> images = ConvertFromExternalImageDataBatch(
+        requests, true, al, parallel ? &scheduler : NULL,
+        [&ready](size_t index, const ImagePtr& image) {
+          ++ready[index];
+        });
+    // Each image is reported exactly once.
+    EXPECT_EQ(std::vector<int>(requests.size(), 1), ready);
+    ASSERT_EQ(requests.size(), images.size());
+    ASSERT_TRUE(images[0].Get());
+    EXPECT_TRUE(images[0]->GetData()->IsWipeable());
+    EXPECT_TRUE(ImageMatchesBytes(*images[0], rgb->GetData()->GetData<uint8>(),
+                                  rgb->GetDataSize()));
+    ASSERT_TRUE(images[1].Get());
+    EXPECT_TRUE(ImageMatchesBytes(*images[1],
+                                  flipped_rgba->GetData()->GetData<uint8>(),
+                                  flipped_rgba->GetDataSize()));
+    ASSERT_TRUE(images[2].Get());
+    EXPECT_EQ(Image::kDxt1, images[2]->GetFormat());
+    EXPECT_TRUE(images[2]->GetData()->IsWipeable());
+    EXPECT_TRUE(ImageMatchesBytes(*images[2],
+                                  dxt1->GetData()->GetData<uint8>(),
+                                  dxt1->GetDataSize()));
+    ASSERT_TRUE(images[3].Get());
+    EXPECT_TRUE(ImageMatchesBytes(*images[3],
+                                  rgb565->GetData()->GetData<uint8>(),
+                                  rgb565->GetDataSize()));
+    EXPECT_FALSE(images[4].Get());
+    EXPECT_FALSE(images[5].Get());
+  }
+}
+
 TEST(ConversionUtils, DownsampleImage2x) {
   base::AllocatorPtr al;  // NULL pointer means use default allocator.
   base::LogChecker logchecker;
 
   Image::Format test_formats[] =
       { Image::kDxt1, Image::kEtc1, Image::kDxt5, Image::kRgba8888,
-        Image::kRgb888, Image::kLuminanceAlpha, Image::kLuminance };
+        Image::kRgb888, Image::kLuminanceAlpha, Image::kLuminance,
+        Image::kRg16ui, Image::kRgba16fHalf, Image::kR32f };
 
   bool is_wipeable = true;
   for (unsigned int i = 0U; i < ARRAYSIZE(test_formats); ++i) {
@@ -1285,16 +1596,60 @@ TEST(ConversionUtils, ResizeImageDouble) {
 }
 
 TEST(ConversionUtils, ResizeImageUnsupported) {
-  // Non-8bpc images aren't supported, and resizing should return NULL.
+  // Packed images aren't supported, and resizing should return NULL.
   base::AllocatorPtr al;  // NULL pointer means use default allocator.
+  ImagePtr packed_image = CreateImage(Image::kRgb565, 5, 5);
+  EXPECT_TRUE(ResizeImage(packed_image, 5, 5, false, al).Get() == NULL);
+  EXPECT_TRUE(ResizeImage(packed_image, 5, 10, false, al).Get() == NULL);
+  EXPECT_TRUE(ResizeImage(packed_image, 10, 5, false, al).Get() == NULL);
+  EXPECT_TRUE(ResizeImage(packed_image, 10, 10, false, al).Get() == NULL);
+  EXPECT_TRUE(ResizeImage(packed_image, 2, 5, false, al).Get() == NULL);
+  EXPECT_TRUE(ResizeImage(packed_image, 5, 2, false, al).Get() == NULL);
+  EXPECT_TRUE(ResizeImage(packed_image, 2, 2, false, al).Get() == NULL);
+
+  // Float images are resized.
   ImagePtr float_image = CreateImage(Image::kRg16fFloat, 5, 5);
-  EXPECT_TRUE(ResizeImage(float_image, 5, 5, false, al).Get() == NULL);
-  EXPECT_TRUE(ResizeImage(float_image, 5, 10, false, al).Get() == NULL);
-  EXPECT_TRUE(ResizeImage(float_image, 10, 5, false, al).Get() == NULL);
-  EXPECT_TRUE(ResizeImage(float_image, 10, 10, false, al).Get() == NULL);
-  EXPECT_TRUE(ResizeImage(float_image, 2, 5, false, al).Get() == NULL);
-  EXPECT_TRUE(ResizeImage(float_image, 5, 2, false, al).Get() == NULL);
-  EXPECT_TRUE(ResizeImage(float_image, 2, 2, false, al).Get() == NULL);
+  ImagePtr resized = ResizeImage(float_image, 2, 3, false, al);
+  ASSERT_TRUE(resized.Get() != NULL);
+  EXPECT_EQ(Image::kRg16fFloat, resized->GetFormat());
+  EXPECT_EQ(2U, resized->GetWidth());
+  EXPECT_EQ(3U, resized->GetHeight());
+}
+
+TEST(ConversionUtils, GenerateMipmapChain) {
+  base::AllocatorPtr al;  // NULL pointer means use default allocator.
+  EXPECT_TRUE(GenerateMipmapChain(ImagePtr(), false, al, NULL).empty());
+
+  base::TaskScheduler scheduler("mipmaps", 2U);
+  ImagePtr image = CreateImage(Image::kRgba8888, 16, 4);
+  std::vector<ImagePtr> levels =
+      GenerateMipmapChain(image, true, al, &scheduler);
+  // Levels shrink to 1x1, keeping a dimension of 1 once it is reached.
+  static const uint32 kSizes[][2] = {
+    { 16, 4 }, { 8, 2 }, { 4, 1 }, { 2, 1 }, { 1, 1 }
+  };
+  ASSERT_EQ(ARRAYSIZE(kSizes), levels.size());
+  EXPECT_EQ(image.Get(), levels[0].Get());
+  for (size_t i = 1; i < levels.size(); ++i) {
+    EXPECT_EQ(Image::kRgba8888, levels[i]->GetFormat());
+    EXPECT_EQ(kSizes[i][0], levels[i]->GetWidth());
+    EXPECT_EQ(kSizes[i][1], levels[i]->GetHeight());
+    EXPECT_TRUE(levels[i]->GetData()->IsWipeable());
+    // Each level matches halving the previous one without threads.
+    ImagePtr expected = HalveImage(levels[i - 1], false, al, NULL);
+    EXPECT_TRUE(ImageMatchesBytes(*levels[i],
+                                  expected->GetData()->GetData<uint8>(),
+                                  expected->GetDataSize()));
+  }
+
+  // Compressed chains stop when the image can no longer be downsampled.
+  levels = GenerateMipmapChain(CreateImage(Image::kDxt1, 16, 8), false, al,
+                               NULL);
+  ASSERT_LE(2U, levels.size());
+  for (size_t i = 1; i < levels.size(); ++i) {
+    EXPECT_EQ(Image::kDxt1, levels[i]->GetFormat());
+    EXPECT_EQ(levels[i - 1]->GetWidth() / 2U, levels[i]->GetWidth());
+  }
 }
 
 TEST(ConversionUtils, FlipImage) {
@@ -23,9 +23,18 @@
       'target_name': 'ionimage_test',
       'includes': [ '../../dev/test_target.gypi' ],
       'sources' : [
+        'binpacker_test.cc',
+        'blockdecoders_test.cc',
         'conversionutils_test.cc',
+        'imageatlas_test.cc',
+        'jpegencoder_test.cc',
         'ninepatch_test.cc',
+        'pixelkernels_test.cc',
         'renderutils_test.cc',
+        'resampleutils_test.cc',
+        'texturecontainer_test.cc',
+        'textureprocessor_test.cc',
+        'texturetranscoder_test.cc',
       ],
       'dependencies' : [
         'image_tests_assets',
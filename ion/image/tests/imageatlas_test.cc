@@ -0,0 +1,174 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/imageatlas.h"
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/invalid.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/sampler.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+namespace {
+
+using gfx::Image;
+using gfx::ImagePtr;
+using gfx::Sampler;
+using gfx::TexturePtr;
+using math::Point2f;
+using math::Point2ui;
+using math::Range2f;
+using math::Range2ui;
+using math::Vector2ui;
+
+// Returns a kLuminance image whose pixels are x + 10 * y + |base|.
+static const ImagePtr CreateImage(uint32 width, uint32 height, uint8 base) {
+  std::vector<uint8> data(width * height);
+  for (uint32 y = 0; y < height; ++y)
+    for (uint32 x = 0; x < width; ++x)
+      data[y * width + x] = static_cast<uint8>(base + x + 10U * y);
+  ImagePtr image(new Image);
+  image->Set(Image::kLuminance, width, height,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &data[0], data.size(), false, base::AllocatorPtr()));
+  return image;
+}
+
+// Returns the pixel at |x|, |y| of a kLuminance image.
+static uint8 GetPixel(const ImagePtr& image, uint32 x, uint32 y) {
+  return image->GetData()->GetData<uint8>()[y * image->GetWidth() + x];
+}
+
+}  // anonymous namespace
+
+TEST(ImageAtlasTest, InvalidImages) {
+  base::LogChecker log_checker;
+  ImageAtlasPtr atlas(
+      new ImageAtlas(Vector2ui(16U, 16U), Image::kLuminance, 1U, false));
+  EXPECT_EQ(Vector2ui(16U, 16U), atlas->GetPageSize());
+  EXPECT_EQ(Image::kLuminance, atlas->GetFormat());
+  EXPECT_EQ(1U, atlas->GetPadding());
+
+  EXPECT_FALSE(atlas->AddImage(0U, ImagePtr()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "without data"));
+  ImagePtr rgb(new Image);
+  std::vector<uint8> data(12U);
+  rgb->Set(Image::kRgb888, 2U, 2U,
+           base::DataContainer::CreateAndCopy<uint8>(&data[0], data.size(),
+                                                     false,
+                                                     base::AllocatorPtr()));
+  EXPECT_FALSE(atlas->AddImage(0U, rgb));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "of format"));
+  // The padding makes this too large.
+  EXPECT_FALSE(atlas->AddImage(0U, CreateImage(15U, 4U, 0U)));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "does not fit"));
+  EXPECT_EQ(0U, atlas->GetPageCount());
+
+  EXPECT_TRUE(atlas->AddImage(0U, CreateImage(14U, 4U, 0U)));
+  EXPECT_FALSE(atlas->AddImage(0U, CreateImage(2U, 2U, 0U)));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "already contains"));
+  EXPECT_FALSE(atlas->RemoveImage(1U));
+  EXPECT_TRUE(base::IsInvalidReference(atlas->GetEntry(1U)));
+  EXPECT_FALSE(atlas->GetPageTexture(1U).Get());
+}
+
+TEST(ImageAtlasTest, AddImages) {
+  ImageAtlasPtr atlas(
+      new ImageAtlas(Vector2ui(16U, 16U), Image::kLuminance, 1U, false));
+  EXPECT_TRUE(atlas->AddImage(7U, CreateImage(4U, 2U, 100U)));
+  ASSERT_EQ(1U, atlas->GetPageCount());
+  const TexturePtr page = atlas->GetPageTexture(0U);
+  ASSERT_TRUE(page.Get());
+  EXPECT_EQ(16U, page->GetImage(0U)->GetWidth());
+  EXPECT_EQ(Image::kLuminance, page->GetImage(0U)->GetFormat());
+  EXPECT_EQ(Sampler::kLinear, page->GetSampler()->GetMinFilter());
+  EXPECT_TRUE(atlas->HasImage(7U));
+
+  // The image is placed inside its padding.
+  const ImageAtlas::Entry& entry = atlas->GetEntry(7U);
+  EXPECT_EQ(0U, entry.page);
+  EXPECT_EQ(Range2ui(Point2ui(1U, 1U), Point2ui(5U, 3U)), entry.pixel_rect);
+  EXPECT_EQ(Range2f(Point2f(1.f / 16.f, 1.f / 16.f),
+                    Point2f(5.f / 16.f, 3.f / 16.f)),
+            entry.texture_rect);
+
+  // The sub-image repeats the edge pixels of the image.
+  ASSERT_EQ(1U, page->GetSubImages().size());
+  const ImagePtr& padded = page->GetSubImages()[0].image;
+  EXPECT_EQ(Point2ui(0U, 0U), Point2ui(page->GetSubImages()[0].offset[0],
+                                       page->GetSubImages()[0].offset[1]));
+  ASSERT_EQ(6U, padded->GetWidth());
+  ASSERT_EQ(4U, padded->GetHeight());
+  EXPECT_EQ(100U, GetPixel(padded, 0U, 0U));
+  EXPECT_EQ(100U, GetPixel(padded, 1U, 1U));
+  EXPECT_EQ(102U, GetPixel(padded, 3U, 1U));
+  EXPECT_EQ(103U, GetPixel(padded, 5U, 0U));
+  EXPECT_EQ(113U, GetPixel(padded, 5U, 3U));
+  EXPECT_EQ(110U, GetPixel(padded, 0U, 2U));
+
+  // Further images are packed next to the first one, and a new page is added
+  // when they do not fit.
+  EXPECT_TRUE(atlas->AddImage(8U, CreateImage(8U, 8U, 0U)));
+  EXPECT_EQ(1U, atlas->GetPageCount());
+  EXPECT_EQ(0U, atlas->GetEntry(8U).page);
+  EXPECT_FALSE(atlas->GetEntry(8U).pixel_rect.IntersectsRange(
+      atlas->GetEntry(7U).pixel_rect));
+  EXPECT_TRUE(atlas->AddImage(9U, CreateImage(14U, 14U, 0U)));
+  EXPECT_EQ(2U, atlas->GetPageCount());
+  EXPECT_EQ(1U, atlas->GetEntry(9U).page);
+  EXPECT_EQ(3U, atlas->GetEntries().size());
+}
+
+TEST(ImageAtlasTest, RemoveImages) {
+  ImageAtlasPtr atlas(
+      new ImageAtlas(Vector2ui(16U, 16U), Image::kLuminance, 0U, true));
+  EXPECT_TRUE(atlas->AddImage(0U, CreateImage(16U, 8U, 0U)));
+  EXPECT_TRUE(atlas->AddImage(1U, CreateImage(16U, 8U, 0U)));
+  EXPECT_EQ(1U, atlas->GetPageCount());
+  const TexturePtr page = atlas->GetPageTexture(0U);
+  EXPECT_EQ(Sampler::kLinearMipmapLinear, page->GetSampler()->GetMinFilter());
+  EXPECT_TRUE(page->GetSampler()->IsAutogenerateMipmapsEnabled());
+  const Range2ui first_rect = atlas->GetEntry(0U).pixel_rect;
+
+  // The space of a removed image is reused without adding a page, and can be
+  // split between smaller images.
+  EXPECT_TRUE(atlas->RemoveImage(0U));
+  EXPECT_FALSE(atlas->HasImage(0U));
+  EXPECT_TRUE(atlas->AddImage(2U, CreateImage(8U, 8U, 0U)));
+  EXPECT_TRUE(atlas->AddImage(3U, CreateImage(8U, 8U, 0U)));
+  EXPECT_EQ(1U, atlas->GetPageCount());
+  EXPECT_EQ(first_rect.GetMinPoint(),
+            atlas->GetEntry(2U).pixel_rect.GetMinPoint());
+  EXPECT_EQ(first_rect.GetMinPoint() + Vector2ui(8U, 0U),
+            atlas->GetEntry(3U).pixel_rect.GetMinPoint());
+  // The first page is now full.
+  EXPECT_TRUE(atlas->AddImage(4U, CreateImage(1U, 1U, 0U)));
+  EXPECT_EQ(1U, atlas->GetEntry(4U).page);
+
+  // Emptying a page makes all of it available again.
+  EXPECT_TRUE(atlas->RemoveImage(1U));
+  EXPECT_TRUE(atlas->RemoveImage(2U));
+  EXPECT_TRUE(atlas->RemoveImage(3U));
+  EXPECT_TRUE(atlas->AddImage(5U, CreateImage(16U, 16U, 0U)));
+  EXPECT_EQ(0U, atlas->GetEntry(5U).page);
+}
+
+}  // namespace image
+}  // namespace ion
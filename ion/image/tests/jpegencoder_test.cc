@@ -0,0 +1,165 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/jpegencoder.h"
+
+#include <stdlib.h>  // For abs().
+
+#include <algorithm>
+#include <vector>
+
+#include "base/macros.h"
+#include "ion/base/datacontainer.h"
+#include "ion/image/conversionutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+// Returns an image whose channels have smooth gradients, so that they survive
+// JPEG compression closely. If |top_half_dark| is set, the top rows are black.
+static const ImagePtr CreateGradientImage(Image::Format format, uint32 width,
+                                          uint32 height, bool top_half_dark) {
+  const uint32 components = Image::GetNumComponentsForFormat(format);
+  std::vector<uint8> data(width * height * components);
+  for (uint32 y = 0; y < height; ++y) {
+    for (uint32 x = 0; x < width; ++x) {
+      for (uint32 c = 0; c < components; ++c) {
+        const uint32 value = top_half_dark && y < height / 2U
+                                 ? 0U
+                                 : 64U + (x * 64U) / width + c * 32U;
+        data[(y * width + x) * components + c] = static_cast<uint8>(value);
+      }
+    }
+  }
+  ImagePtr image(new Image);
+  image->Set(format, width, height,
+             base::DataContainer::CreateAndCopy<uint8>(&data[0], data.size(),
+                                                       false,
+                                                       image->GetAllocator()));
+  return image;
+}
+
+// Returns the largest difference between channel |channel| of |expected| and
+// the first channel of |decoded|, which must have the same size.
+static int GetMaxError(const Image& expected, uint32 channel,
+                       const Image& decoded) {
+  const uint32 expected_stride =
+      Image::GetNumComponentsForFormat(expected.GetFormat());
+  const uint32 decoded_stride =
+      Image::GetNumComponentsForFormat(decoded.GetFormat());
+  const uint8* expected_data = expected.GetData()->GetData<uint8>();
+  const uint8* decoded_data = decoded.GetData()->GetData<uint8>();
+  const uint32 count = expected.GetWidth() * expected.GetHeight();
+  int max_error = 0;
+  for (uint32 i = 0; i < count; ++i) {
+    max_error = std::max(
+        max_error, abs(static_cast<int>(expected_data[i * expected_stride +
+                                                      channel]) -
+                       static_cast<int>(decoded_data[i * decoded_stride])));
+  }
+  return max_error;
+}
+
+}  // anonymous namespace
+
+TEST(JpegEncoder, UnsupportedImages) {
+  EXPECT_TRUE(IsJpegEncodingSupported(Image::kR8));
+  EXPECT_TRUE(IsJpegEncodingSupported(Image::kLuminance));
+  EXPECT_TRUE(IsJpegEncodingSupported(Image::kLuminanceAlpha));
+  EXPECT_TRUE(IsJpegEncodingSupported(Image::kRgb888));
+  EXPECT_TRUE(IsJpegEncodingSupported(Image::kRgba8888));
+  EXPECT_FALSE(IsJpegEncodingSupported(Image::kRgb565));
+  EXPECT_FALSE(IsJpegEncodingSupported(Image::kRgba32f));
+  EXPECT_FALSE(IsJpegEncodingSupported(Image::kDxt1));
+
+  // An image without data.
+  ImagePtr empty(new Image);
+  empty->Set(Image::kRgb888, 8U, 8U, base::DataContainerPtr());
+  EXPECT_TRUE(EncodeJpeg(*empty, kDefaultJpegQuality, false).empty());
+  // An unsupported format.
+  const std::vector<uint8> bytes(8U * 8U * 2U, 0);
+  ImagePtr rgb565(new Image);
+  rgb565->Set(Image::kRgb565, 8U, 8U,
+              base::DataContainer::CreateAndCopy<uint8>(
+                  &bytes[0], bytes.size(), false, rgb565->GetAllocator()));
+  EXPECT_TRUE(EncodeJpeg(*rgb565, kDefaultJpegQuality, false).empty());
+  EXPECT_TRUE(ConvertToExternalImageData(ImagePtr(), kJpeg, false).empty());
+}
+
+TEST(JpegEncoder, FileStructure) {
+  const ImagePtr image = CreateGradientImage(Image::kRgb888, 19U, 11U, false);
+  const std::vector<uint8> jpeg = EncodeJpeg(*image, kDefaultJpegQuality,
+                                             false);
+  ASSERT_GT(jpeg.size(), 4U);
+  // SOI and JFIF APP0 markers, then EOI at the end.
+  EXPECT_EQ(0xff, jpeg[0]);
+  EXPECT_EQ(0xd8, jpeg[1]);
+  EXPECT_EQ(0xff, jpeg[2]);
+  EXPECT_EQ(0xe0, jpeg[3]);
+  EXPECT_EQ('J', jpeg[6]);
+  EXPECT_EQ(0xff, jpeg[jpeg.size() - 2U]);
+  EXPECT_EQ(0xd9, jpeg[jpeg.size() - 1U]);
+  EXPECT_EQ(jpeg, ConvertToExternalImageData(image, kJpeg, false));
+
+  // Lower qualities give smaller files, and the quality is clamped.
+  const std::vector<uint8> low = EncodeJpeg(*image, 10, false);
+  EXPECT_LT(low.size(), jpeg.size());
+  EXPECT_EQ(EncodeJpeg(*image, 1, false), EncodeJpeg(*image, -5, false));
+  EXPECT_EQ(EncodeJpeg(*image, 100, false), EncodeJpeg(*image, 500, false));
+
+  // Grayscale files are smaller, since they only have one component.
+  const ImagePtr gray = CreateGradientImage(Image::kR8, 19U, 11U, false);
+  EXPECT_LT(EncodeJpeg(*gray, kDefaultJpegQuality, false).size(), jpeg.size());
+}
+
+TEST(JpegEncoder, RoundTrip) {
+  static const Image::Format kFormats[] = {
+      Image::kR8, Image::kLuminanceAlpha, Image::kRgb888, Image::kRgba8888 };
+  for (size_t i = 0; i < ARRAYSIZE(kFormats); ++i) {
+    SCOPED_TRACE(Image::GetFormatString(kFormats[i]));
+    // Use a size that is not a multiple of the block size.
+    const ImagePtr image = CreateGradientImage(kFormats[i], 21U, 13U, true);
+    const std::vector<uint8> jpeg = EncodeJpeg(*image, 95, false);
+    ASSERT_FALSE(jpeg.empty());
+    const ImagePtr decoded = ConvertFromExternalImageData(
+        &jpeg[0], jpeg.size(), false, false, base::AllocatorPtr());
+    ASSERT_TRUE(decoded.Get());
+    EXPECT_EQ(21U, decoded->GetWidth());
+    EXPECT_EQ(13U, decoded->GetHeight());
+    const bool is_color = Image::GetNumComponentsForFormat(kFormats[i]) >= 3;
+    EXPECT_EQ(is_color ? Image::kRgb888 : Image::kLuminance,
+              decoded->GetFormat());
+    // Compare the first channel, allowing for ringing at the dark edge.
+    EXPECT_LE(GetMaxError(*image, 0U, *decoded), 24);
+
+    // Flipping moves the dark rows to the bottom.
+    const std::vector<uint8> flipped = EncodeJpeg(*image, 95, true);
+    const ImagePtr decoded_flipped = ConvertFromExternalImageData(
+        &flipped[0], flipped.size(), true, false, base::AllocatorPtr());
+    ASSERT_TRUE(decoded_flipped.Get());
+    EXPECT_LE(GetMaxError(*image, 0U, *decoded_flipped), 24);
+  }
+}
+
+}  // namespace image
+}  // namespace ion
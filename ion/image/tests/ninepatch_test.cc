@@ -24,6 +24,9 @@ limitations under the License.
 #include "ion/base/invalid.h"
 #include "ion/base/zipassetmanager.h"
 #include "ion/base/zipassetmanagermacros.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/shape.h"
 #include "ion/image/conversionutils.h"
 #include "ion/math/range.h"
 #include "ion/math/vector.h"
@@ -943,5 +946,123 @@ TEST(NinePatch, ExpectedContents) {
   }
 }
 
+TEST(NinePatch, ImageCache) {
+  ImagePtr image = CreateImage(5, 5);
+  FillImage(image, kEmpty);
+  SetPixel(image, 0, 2, kBlack);
+  SetPixel(image, 2, 0, kBlack);
+  SetPixel(image, 2, 2, kGreen);
+  NinePatchPtr nine_patch(new NinePatch(image));
+  EXPECT_EQ(0U, nine_patch->GetImageCacheCapacity());
+
+  // Without a cache every call builds a new image.
+  ImagePtr first = nine_patch->BuildImage(8, 8, AllocatorPtr());
+  EXPECT_NE(first.Get(), nine_patch->BuildImage(8, 8, AllocatorPtr()).Get());
+
+  nine_patch->SetImageCacheCapacity(2U);
+  EXPECT_EQ(2U, nine_patch->GetImageCacheCapacity());
+  first = nine_patch->BuildImage(8, 8, AllocatorPtr());
+  EXPECT_EQ(first.Get(), nine_patch->BuildImage(8, 8, AllocatorPtr()).Get());
+  EXPECT_PRED_FORMAT2(AssertColorsEqual, kGreen, GetPixel(first, 4, 4));
+  const ImagePtr second = nine_patch->BuildImage(8, 4, AllocatorPtr());
+  EXPECT_NE(first.Get(), second.Get());
+  EXPECT_EQ(8U, second->GetWidth());
+  EXPECT_EQ(4U, second->GetHeight());
+
+  // Using the 8x8 image makes the 8x4 one the least recently used, so it is
+  // dropped for a third size.
+  EXPECT_EQ(first.Get(), nine_patch->BuildImage(8, 8, AllocatorPtr()).Get());
+  nine_patch->BuildImage(16, 16, AllocatorPtr());
+  EXPECT_EQ(first.Get(), nine_patch->BuildImage(8, 8, AllocatorPtr()).Get());
+  EXPECT_NE(second.Get(), nine_patch->BuildImage(8, 4, AllocatorPtr()).Get());
+
+  // A wiped image is rebuilt.
+  first->GetData()->WipeData();
+  const ImagePtr rebuilt = nine_patch->BuildImage(8, 8, AllocatorPtr());
+  EXPECT_NE(first.Get(), rebuilt.Get());
+  EXPECT_PRED_FORMAT2(AssertColorsEqual, kGreen, GetPixel(rebuilt, 4, 4));
+
+  // Changing wipeability clears the cache.
+  nine_patch->SetBuildWipeable(false);
+  const ImagePtr unwipeable = nine_patch->BuildImage(8, 8, AllocatorPtr());
+  EXPECT_NE(rebuilt.Get(), unwipeable.Get());
+  EXPECT_FALSE(unwipeable->GetData()->IsWipeable());
+
+  // Disabling the cache drops all images.
+  nine_patch->SetImageCacheCapacity(0U);
+  EXPECT_NE(unwipeable.Get(),
+            nine_patch->BuildImage(8, 8, AllocatorPtr()).Get());
+}
+
+TEST(NinePatch, BuildShape) {
+  ImagePtr image = CreateImage(5, 5);
+  FillImage(image, kEmpty);
+  // There is no geometry without a source or without stretch regions.
+  EXPECT_FALSE(NinePatchPtr(new NinePatch(ImagePtr()))
+                   ->BuildShape(8, 8, AllocatorPtr()).Get());
+  EXPECT_FALSE(NinePatchPtr(new NinePatch(image))
+                   ->BuildShape(8, 8, AllocatorPtr()).Get());
+
+  SetPixel(image, 0, 2, kBlack);
+  SetPixel(image, 2, 0, kBlack);
+  NinePatchPtr nine_patch(new NinePatch(image));
+  nine_patch->SetBuildWipeable(false);
+  const gfx::ShapePtr shape = nine_patch->BuildShape(9, 6, AllocatorPtr());
+  ASSERT_TRUE(shape.Get());
+  EXPECT_EQ(gfx::Shape::kTriangles, shape->GetPrimitiveType());
+  ASSERT_TRUE(shape->GetAttributeArray().Get());
+  EXPECT_EQ(2U, shape->GetAttributeArray()->GetBufferAttributeCount());
+
+  // There are 9 regions with a quad each.
+  const gfx::IndexBufferPtr& indices = shape->GetIndexBuffer();
+  ASSERT_TRUE(indices.Get());
+  EXPECT_EQ(54U, indices->GetCount());
+  const uint16* index_data = indices->GetData()->GetData<uint16>();
+  EXPECT_EQ(0U, index_data[0]);
+  EXPECT_EQ(2U, index_data[2]);
+  EXPECT_EQ(35U, index_data[53]);
+
+  const gfx::BufferObjectElement& boe =
+      shape->GetAttributeArray()->GetBufferAttribute(0)
+          .GetValue<gfx::BufferObjectElement>();
+  ASSERT_EQ(36U, boe.buffer_object->GetCount());
+  ASSERT_EQ(5U * sizeof(float), boe.buffer_object->GetStructSize());
+  // Each vertex is a 3D position followed by texture coordinates.
+  const float* v = boe.buffer_object->GetData()->GetData<float>();
+  // The top left corner is not stretched.
+  EXPECT_EQ(0.f, v[0]);
+  EXPECT_EQ(0.f, v[1]);
+  EXPECT_FLOAT_EQ(0.2f, v[3]);
+  EXPECT_FLOAT_EQ(0.2f, v[4]);
+  EXPECT_EQ(1.f, v[10]);
+  EXPECT_EQ(1.f, v[11]);
+  EXPECT_FLOAT_EQ(0.4f, v[13]);
+  EXPECT_FLOAT_EQ(0.4f, v[14]);
+  // The center covers everything but the corners.
+  const float* center = &v[4 * 4 * 5];
+  EXPECT_EQ(1.f, center[0]);
+  EXPECT_EQ(1.f, center[1]);
+  EXPECT_FLOAT_EQ(0.4f, center[3]);
+  EXPECT_FLOAT_EQ(0.4f, center[4]);
+  EXPECT_EQ(8.f, center[10]);
+  EXPECT_EQ(5.f, center[11]);
+  EXPECT_FLOAT_EQ(0.6f, center[13]);
+  EXPECT_FLOAT_EQ(0.6f, center[14]);
+  // The last quad ends at the bottom right corner.
+  EXPECT_EQ(9.f, v[34 * 5 + 0]);
+  EXPECT_EQ(6.f, v[34 * 5 + 1]);
+  EXPECT_FLOAT_EQ(0.8f, v[34 * 5 + 3]);
+  EXPECT_FLOAT_EQ(0.8f, v[34 * 5 + 4]);
+
+  // Sizes below the minimum are clamped.
+  const gfx::ShapePtr small = nine_patch->BuildShape(0, 0, AllocatorPtr());
+  const gfx::BufferObjectElement& small_boe =
+      small->GetAttributeArray()->GetBufferAttribute(0)
+          .GetValue<gfx::BufferObjectElement>();
+  const float* small_v = small_boe.buffer_object->GetData()->GetData<float>();
+  EXPECT_EQ(2.f, small_v[34 * 5 + 0]);
+  EXPECT_EQ(2.f, small_v[34 * 5 + 1]);
+}
+
 }  // namespace image
 }  // namespace ion
@@ -0,0 +1,371 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/pixelkernels.h"
+
+#include <stdlib.h>
+#include <string.h>  // For memcmp().
+
+#include <limits>
+#include <vector>
+
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+namespace {
+
+// The largest number of pixels converted by the tests, which covers several
+// iterations of each SIMD loop as well as every possible tail.
+static const size_t kMaxPixels = 67U;
+
+// Restores the SIMD setting when it goes out of scope.
+class ScopedSimdEnabled {
+ public:
+  explicit ScopedSimdEnabled(bool enabled)
+      : was_enabled_(IsPixelKernelSimdEnabled()) {
+    SetPixelKernelSimdEnabled(enabled);
+  }
+  ~ScopedSimdEnabled() { SetPixelKernelSimdEnabled(was_enabled_); }
+
+ private:
+  const bool was_enabled_;
+};
+
+template <typename T>
+static std::vector<T> RandomValues(size_t count) {
+  std::vector<T> values(count);
+  for (size_t i = 0; i < count; ++i)
+    values[i] = static_cast<T>(rand());
+  return values;
+}
+
+// Converts random pixels of every count up to kMaxPixels with and without the
+// SIMD kernels and checks that the results match. The destination is padded
+// to check that the kernels do not write past its end.
+template <typename Src, typename Dst>
+static void CheckKernel(void (*kernel)(const Src*, Dst*, size_t),
+                        size_t src_channels, size_t dst_channels) {
+  srand(1);
+  for (size_t count = 0; count <= kMaxPixels; ++count) {
+    SCOPED_TRACE(count);
+    const std::vector<Src> src = RandomValues<Src>(count * src_channels);
+    std::vector<Dst> expected(count * dst_channels + 1U, 0x5a);
+    std::vector<Dst> actual(expected);
+    const Src* src_data = src.empty() ? NULL : &src[0];
+    {
+      ScopedSimdEnabled simd(false);
+      kernel(src_data, &expected[0], count);
+    }
+    {
+      ScopedSimdEnabled simd(true);
+      kernel(src_data, &actual[0], count);
+    }
+    EXPECT_EQ(expected, actual);
+  }
+}
+
+// Returns the bits of a float.
+static uint32 FloatBits(float value) {
+  uint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Converts every half float to a float and back and checks that the results
+// match with and without the SIMD kernels, and that each value survives the
+// round trip, except that NaNs only need to stay NaNs.
+static void CheckHalfRoundTrip() {
+  std::vector<uint16> all(0x10000);
+  for (size_t i = 0; i < all.size(); ++i)
+    all[i] = static_cast<uint16>(i);
+  std::vector<float> expected(all.size());
+  std::vector<float> actual(all.size());
+  std::vector<uint16> round_trip(all.size());
+  {
+    ScopedSimdEnabled simd(false);
+    ConvertHalfToFloat(&all[0], &expected[0], all.size());
+  }
+  ConvertHalfToFloat(&all[0], &actual[0], all.size());
+  ConvertFloatToHalf(&actual[0], &round_trip[0], all.size());
+  for (size_t i = 0; i < all.size(); ++i) {
+    SCOPED_TRACE(i);
+    const bool is_nan = (all[i] & 0x7fff) > 0x7c00;
+    if (is_nan) {
+      EXPECT_NE(expected[i], expected[i]);
+      EXPECT_NE(actual[i], actual[i]);
+      EXPECT_GT(round_trip[i] & 0x7fff, 0x7c00);
+    } else {
+      EXPECT_EQ(FloatBits(expected[i]), FloatBits(actual[i]));
+      EXPECT_EQ(all[i], round_trip[i]);
+    }
+  }
+}
+
+static void CheckInPlaceKernel(void (*kernel)(uint8*, size_t)) {
+  srand(2);
+  for (size_t count = 0; count <= kMaxPixels; ++count) {
+    SCOPED_TRACE(count);
+    std::vector<uint8> expected = RandomValues<uint8>(count * 4U + 1U);
+    // Make sure the extremes of alpha are covered.
+    if (count > 1U) {
+      expected[3] = 0;
+      expected[7] = 255;
+    }
+    std::vector<uint8> actual(expected);
+    {
+      ScopedSimdEnabled simd(false);
+      kernel(&expected[0], count);
+    }
+    {
+      ScopedSimdEnabled simd(true);
+      kernel(&actual[0], count);
+    }
+    EXPECT_EQ(expected, actual);
+  }
+}
+
+}  // anonymous namespace
+
+TEST(PixelKernelsTest, EnableSimd) {
+  EXPECT_EQ(IsPixelKernelSimdAvailable(), IsPixelKernelSimdEnabled());
+  {
+    ScopedSimdEnabled simd(false);
+    EXPECT_FALSE(IsPixelKernelSimdEnabled());
+  }
+  EXPECT_EQ(IsPixelKernelSimdAvailable(), IsPixelKernelSimdEnabled());
+}
+
+TEST(PixelKernelsTest, SimdMatchesReference) {
+  CheckKernel(ConvertRgb888ToR8, 3U, 1U);
+  CheckKernel(ConvertRgba8888ToR8, 4U, 1U);
+  CheckKernel(ConvertRgba8888ToRgb888, 4U, 3U);
+  CheckKernel(ConvertRgb888ToRgba8888, 3U, 4U);
+  CheckKernel(ConvertRgba8888ToRgb565, 4U, 1U);
+  CheckKernel(ConvertRgba8888ToRgba4444, 4U, 1U);
+  CheckKernel(ConvertRgba8888ToRgba5551, 4U, 1U);
+  CheckKernel(ConvertRgb565ToRgba8888, 1U, 4U);
+  CheckKernel(ConvertRgba4444ToRgba8888, 1U, 4U);
+  CheckKernel(ConvertRgba5551ToRgba8888, 1U, 4U);
+  CheckInPlaceKernel(PremultiplyRgba8888Alpha);
+  CheckInPlaceKernel(UnpremultiplyRgba8888Alpha);
+}
+
+TEST(PixelKernelsTest, HalfFloatConversions) {
+  {
+    ScopedSimdEnabled simd(false);
+    CheckHalfRoundTrip();
+  }
+  CheckHalfRoundTrip();
+
+  // 2049 and 2051 are halfway between halves and round to even.
+  static const float kFloats[] = {
+    0.f, -0.f, 1.f, -2.f, 65504.f, 65520.f, 1e10f, -1e10f, 2049.f, 2051.f,
+    5.96046448e-8f, 2.98023224e-8f, 4.47034836e-8f, 1e-10f, 6.10351562e-5f,
+  };
+  static const uint16 kHalves[] = {
+    0x0000, 0x8000, 0x3c00, 0xc000, 0x7bff, 0x7c00, 0x7c00, 0xfc00, 0x6800,
+    0x6802, 0x0001, 0x0000, 0x0001, 0x0000, 0x0400,
+  };
+  static const size_t kCount = sizeof(kFloats) / sizeof(kFloats[0]);
+  for (int enabled = 0; enabled < 2; ++enabled) {
+    ScopedSimdEnabled simd(enabled != 0);
+    // Repeat the values so that the SIMD loops are used.
+    std::vector<float> floats;
+    for (int i = 0; i < 4; ++i)
+      floats.insert(floats.end(), kFloats, kFloats + kCount);
+    floats.push_back(std::numeric_limits<float>::infinity());
+    floats.push_back(std::numeric_limits<float>::quiet_NaN());
+    std::vector<uint16> halves(floats.size());
+    ConvertFloatToHalf(&floats[0], &halves[0], floats.size());
+    for (size_t i = 0; i < kCount * 4U; ++i)
+      EXPECT_EQ(kHalves[i % kCount], halves[i]) << i;
+    EXPECT_EQ(0x7c00, halves[kCount * 4U]);
+    EXPECT_GT(halves[kCount * 4U + 1U] & 0x7fff, 0x7c00);
+  }
+
+  // The kernels handle every count.
+  for (size_t count = 0; count <= kMaxPixels; ++count) {
+    std::vector<float> floats(count + 1U, 0.5f);
+    std::vector<uint16> halves(count + 1U, 0x5a5a);
+    ConvertFloatToHalf(&floats[0], &halves[0], count);
+    EXPECT_EQ(std::vector<uint16>(count, 0x3800),
+              std::vector<uint16>(halves.begin(), halves.end() - 1));
+    EXPECT_EQ(0x5a5a, halves.back());
+    std::vector<float> round_trip(count + 1U, 2.f);
+    ConvertHalfToFloat(&halves[0], &round_trip[0], count);
+    EXPECT_EQ(2.f, round_trip.back());
+    round_trip.pop_back();
+    floats.pop_back();
+    EXPECT_EQ(floats, round_trip);
+  }
+}
+
+TEST(PixelKernelsTest, PackedFloatConversions) {
+  static const float kRgb[] = {
+    1.f, 0.5f, 2.f,
+    -1.f, 1e10f, 65024.f,
+    std::numeric_limits<float>::infinity(), 0.f, 1.f / 64.f,
+  };
+  uint32 packed[3];
+  ConvertRgb32fToRgb11f11f10f(kRgb, packed, 3U);
+  EXPECT_EQ(0x3c0U | (0x380U << 11) | (0x200U << 22), packed[0]);
+  // Negative values become 0 and values too large are clamped.
+  EXPECT_EQ((0x7bfU << 11) | (0x3dfU << 22), packed[1]);
+  EXPECT_EQ(0x7c0U | (0x120U << 22), packed[2]);
+
+  float rgb[9];
+  ConvertRgb11f11f10fToRgb32f(packed, rgb, 3U);
+  EXPECT_EQ(1.f, rgb[0]);
+  EXPECT_EQ(0.5f, rgb[1]);
+  EXPECT_EQ(2.f, rgb[2]);
+  EXPECT_EQ(0.f, rgb[3]);
+  EXPECT_EQ(65024.f, rgb[4]);
+  EXPECT_EQ(64512.f, rgb[5]);
+  EXPECT_EQ(std::numeric_limits<float>::infinity(), rgb[6]);
+  EXPECT_EQ(0.f, rgb[7]);
+  EXPECT_EQ(1.f / 64.f, rgb[8]);
+
+  // NaNs stay NaNs.
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float kNans[] = { nan, nan, nan };
+  ConvertRgb32fToRgb11f11f10f(kNans, packed, 1U);
+  ConvertRgb11f11f10fToRgb32f(packed, rgb, 1U);
+  EXPECT_NE(rgb[0], rgb[0]);
+  EXPECT_NE(rgb[1], rgb[1]);
+  EXPECT_NE(rgb[2], rgb[2]);
+
+  // Every finite value survives a round trip, including denormals.
+  for (uint32 i = 0; i < 0x7c0U; ++i) {
+    const uint32 value = i | (i << 11) | ((i >> 1) << 22);
+    ConvertRgb11f11f10fToRgb32f(&value, rgb, 1U);
+    ConvertRgb32fToRgb11f11f10f(rgb, packed, 1U);
+    EXPECT_EQ(value, packed[0]);
+  }
+
+  static const float kRgba[] = {
+    1.f, 0.f, 0.5f, 1.f,
+    2.f, -1.f, 0.25f, 0.4f,
+  };
+  ConvertRgba32fToRgb10a2(kRgba, packed, 2U);
+  EXPECT_EQ(0x3ffU | (0x200U << 20) | (3U << 30), packed[0]);
+  EXPECT_EQ(0x3ffU | (0x100U << 20) | (1U << 30), packed[1]);
+  float rgba[8];
+  ConvertRgb10a2ToRgba32f(packed, rgba, 2U);
+  EXPECT_EQ(1.f, rgba[0]);
+  EXPECT_EQ(0.f, rgba[1]);
+  EXPECT_NEAR(0.5f, rgba[2], 1.f / 2046.f);
+  EXPECT_EQ(1.f, rgba[3]);
+  EXPECT_NEAR(0.25f, rgba[6], 1.f / 2046.f);
+  EXPECT_NEAR(1.f / 3.f, rgba[7], 1e-6f);
+}
+
+TEST(PixelKernelsTest, ChannelConversions) {
+  static const uint8 kRgba[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  static const uint8 kRgb[] = { 1, 2, 3, 5, 6, 7 };
+  uint8 rgb[6];
+  ConvertRgba8888ToRgb888(kRgba, rgb, 2U);
+  EXPECT_EQ(0, memcmp(kRgb, rgb, sizeof(rgb)));
+
+  uint8 rgba[8];
+  ConvertRgb888ToRgba8888(kRgb, rgba, 2U);
+  static const uint8 kOpaque[] = { 1, 2, 3, 255, 5, 6, 7, 255 };
+  EXPECT_EQ(0, memcmp(kOpaque, rgba, sizeof(rgba)));
+
+  uint8 red[2];
+  ConvertRgb888ToR8(kRgb, red, 2U);
+  EXPECT_EQ(1, red[0]);
+  EXPECT_EQ(5, red[1]);
+  ConvertRgba8888ToR8(kRgba, red, 2U);
+  EXPECT_EQ(1, red[0]);
+  EXPECT_EQ(5, red[1]);
+}
+
+TEST(PixelKernelsTest, PackedConversions) {
+  static const uint8 kRgba[] = {
+    255, 0, 0, 255,
+    0, 255, 0, 128,
+    0, 0, 255, 127,
+    128, 128, 128, 0,
+  };
+  uint16 packed[4];
+  ConvertRgba8888ToRgb565(kRgba, packed, 4U);
+  EXPECT_EQ(0xf800, packed[0]);
+  EXPECT_EQ(0x07e0, packed[1]);
+  EXPECT_EQ(0x001f, packed[2]);
+  EXPECT_EQ(0x8410, packed[3]);
+  ConvertRgba8888ToRgba4444(kRgba, packed, 4U);
+  EXPECT_EQ(0xf00f, packed[0]);
+  EXPECT_EQ(0x0f08, packed[1]);
+  EXPECT_EQ(0x00f7, packed[2]);
+  EXPECT_EQ(0x8880, packed[3]);
+  ConvertRgba8888ToRgba5551(kRgba, packed, 4U);
+  EXPECT_EQ(0xf801, packed[0]);
+  EXPECT_EQ(0x07c1, packed[1]);
+  EXPECT_EQ(0x003e, packed[2]);
+  EXPECT_EQ(0x8420, packed[3]);
+
+  // Every 16-bit value survives a round trip through RGBA8888.
+  std::vector<uint16> all(0x10000);
+  for (size_t i = 0; i < all.size(); ++i)
+    all[i] = static_cast<uint16>(i);
+  std::vector<uint8> rgba(all.size() * 4U);
+  std::vector<uint16> round_trip(all.size());
+  ConvertRgba4444ToRgba8888(&all[0], &rgba[0], all.size());
+  ConvertRgba8888ToRgba4444(&rgba[0], &round_trip[0], all.size());
+  EXPECT_EQ(all, round_trip);
+  ConvertRgba5551ToRgba8888(&all[0], &rgba[0], all.size());
+  ConvertRgba8888ToRgba5551(&rgba[0], &round_trip[0], all.size());
+  EXPECT_EQ(all, round_trip);
+  ConvertRgb565ToRgba8888(&all[0], &rgba[0], all.size());
+  ConvertRgba8888ToRgb565(&rgba[0], &round_trip[0], all.size());
+  EXPECT_EQ(all, round_trip);
+}
+
+TEST(PixelKernelsTest, Premultiply) {
+  uint8 pixels[] = {
+    255, 128, 0, 128,
+    10, 20, 30, 0,
+    200, 100, 50, 255,
+  };
+  PremultiplyRgba8888Alpha(pixels, 3U);
+  static const uint8 kPremultiplied[] = {
+    128, 64, 0, 128,
+    0, 0, 0, 0,
+    200, 100, 50, 255,
+  };
+  EXPECT_EQ(0, memcmp(kPremultiplied, pixels, sizeof(pixels)));
+
+  // Zero alpha pixels keep their color, and colors brighter than their alpha
+  // are clamped.
+  uint8 premultiplied[] = {
+    128, 64, 0, 128,
+    10, 20, 30, 0,
+    200, 100, 50, 128,
+  };
+  UnpremultiplyRgba8888Alpha(premultiplied, 3U);
+  static const uint8 kStraight[] = {
+    255, 127, 0, 128,
+    10, 20, 30, 0,
+    255, 199, 99, 128,
+  };
+  EXPECT_EQ(0, memcmp(kStraight, premultiplied, sizeof(premultiplied)));
+}
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,314 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/resampleutils.h"
+
+#include <string.h>  // For memcmp().
+
+#include <vector>
+
+#include "base/macros.h"  // For ARRAYSIZE().
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+static const ResampleFilter kFilters[] = {
+  kBoxFilter, kBilinearFilter, kMitchellFilter, kLanczos3Filter
+};
+
+// Creates an image of the given format and size holding a copy of values,
+// which is repeated to fill the image.
+template <typename T>
+static const ImagePtr CreateImage(Image::Format format, uint32 width,
+                                  uint32 height,
+                                  const std::vector<T>& values) {
+  const size_t count =
+      Image::ComputeDataSize(format, width, height) / sizeof(T);
+  std::vector<T> data(count);
+  for (size_t i = 0; i < count; ++i)
+    data[i] = values[i % values.size()];
+  ImagePtr image(new Image);
+  image->Set(format, width, height,
+             base::DataContainer::CreateAndCopy<T>(&data[0], count, false,
+                                                   image->GetAllocator()));
+  return image;
+}
+
+template <typename T>
+static const std::vector<T> GetValues(const ImagePtr& image) {
+  const T* data = image->GetData()->GetData<T>();
+  return std::vector<T>(data, data + image->GetDataSize() / sizeof(T));
+}
+
+static bool ImagesAreEqual(const ImagePtr& a, const ImagePtr& b) {
+  return a->GetFormat() == b->GetFormat() &&
+      a->GetWidth() == b->GetWidth() && a->GetHeight() == b->GetHeight() &&
+      memcmp(a->GetData()->GetData(), b->GetData()->GetData(),
+             a->GetDataSize()) == 0;
+}
+
+}  // anonymous namespace
+
+TEST(ResampleUtils, Unsupported) {
+  base::LogChecker log_checker;
+  base::AllocatorPtr al;
+  EXPECT_TRUE(ResampleImage(ImagePtr(), 2, 2, kBoxFilter, false, al,
+                            NULL).Get() == NULL);
+  EXPECT_TRUE(HalveImage(ImagePtr(), false, al, NULL).Get() == NULL);
+
+  const ImagePtr image =
+      CreateImage(Image::kRgba8888, 4, 4, std::vector<uint8>(1, 0));
+  EXPECT_TRUE(ResampleImage(image, 0, 2, kBoxFilter, false, al,
+                            NULL).Get() == NULL);
+  EXPECT_TRUE(ResampleImage(image, 2, 0, kBoxFilter, false, al,
+                            NULL).Get() == NULL);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  EXPECT_TRUE(IsResamplingSupported(Image::kRgba8888));
+  EXPECT_TRUE(IsResamplingSupported(Image::kRg16ui));
+  EXPECT_TRUE(IsResamplingSupported(Image::kRgba16fHalf));
+  EXPECT_TRUE(IsResamplingSupported(Image::kR32f));
+  EXPECT_TRUE(IsResamplingSupported(Image::kRgb10a2));
+  EXPECT_TRUE(IsResamplingSupported(Image::kRgb11f_11f_10f_Rev));
+  EXPECT_FALSE(IsResamplingSupported(Image::kRgb565));
+  EXPECT_FALSE(IsResamplingSupported(Image::kRgba16i));
+  EXPECT_FALSE(IsResamplingSupported(Image::kDxt1));
+  const ImagePtr packed =
+      CreateImage(Image::kRgb565, 4, 4, std::vector<uint16>(1, 0));
+  EXPECT_TRUE(ResampleImage(packed, 2, 2, kBoxFilter, false, al,
+                            NULL).Get() == NULL);
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "not supported"));
+  EXPECT_TRUE(HalveImage(packed, false, al, NULL).Get() == NULL);
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "not supported"));
+}
+
+TEST(ResampleUtils, SameSize) {
+  base::AllocatorPtr al;
+  std::vector<uint8> bytes;
+  for (int i = 0; i < 97; ++i)
+    bytes.push_back(static_cast<uint8>(i * 37));
+  // Box and bilinear filtering leave an image of the same size unchanged.
+  for (int filter = 0; filter < 2; ++filter) {
+    SCOPED_TRACE(filter);
+    const ImagePtr image = CreateImage(Image::kRgba8888, 13, 7, bytes);
+    const ImagePtr result = ResampleImage(
+        image, 13, 7, kFilters[filter], true, al, NULL);
+    ASSERT_TRUE(result.Get());
+    EXPECT_TRUE(result->GetData()->IsWipeable());
+    EXPECT_TRUE(ImagesAreEqual(image, result));
+
+    const ImagePtr gray = CreateImage(Image::kLuminance, 13, 7, bytes);
+    EXPECT_TRUE(ImagesAreEqual(gray, ResampleImage(gray, 13, 7,
+                                                   kFilters[filter], false,
+                                                   al, NULL)));
+  }
+
+  // Every finite half float survives the conversion to float and back. Negative
+  // zero is left out, since summing weighted samples turns it into zero.
+  std::vector<uint16> halves;
+  for (uint32 i = 0; i < 0x10000; ++i) {
+    if ((i & 0x7c00) != 0x7c00)
+      halves.push_back(i == 0x8000 ? 0 : static_cast<uint16>(i));
+  }
+  const ImagePtr half_image = CreateImage(
+      Image::kRgba16fHalf, 4, static_cast<uint32>(halves.size() / 16U),
+      halves);
+  EXPECT_EQ(halves, GetValues<uint16>(ResampleImage(
+      half_image, half_image->GetWidth(), half_image->GetHeight(), kBoxFilter,
+      false, al, NULL)));
+}
+
+TEST(ResampleUtils, ConstantImages) {
+  base::AllocatorPtr al;
+  static const uint32 kSizes[][2] = {
+    { 1, 1 }, { 3, 2 }, { 8, 8 }, { 17, 5 }, { 40, 33 }
+  };
+  // Each filter is normalized, so constant images stay constant whatever the
+  // sizes.
+  for (size_t f = 0; f < ARRAYSIZE(kFilters); ++f) {
+    for (size_t in = 0; in < ARRAYSIZE(kSizes); ++in) {
+      for (size_t out = 0; out < ARRAYSIZE(kSizes); ++out) {
+        SCOPED_TRACE(::testing::Message() << f << " " << in << " " << out);
+        const uint32 in_width = kSizes[in][0];
+        const uint32 in_height = kSizes[in][1];
+        const uint32 out_width = kSizes[out][0];
+        const uint32 out_height = kSizes[out][1];
+        const ImagePtr rgb = ResampleImage(
+            CreateImage(Image::kRgb888, in_width, in_height,
+                        std::vector<uint8>(1, 77)),
+            out_width, out_height, kFilters[f], false, al, NULL);
+        ASSERT_TRUE(rgb.Get());
+        EXPECT_EQ(Image::kRgb888, rgb->GetFormat());
+        EXPECT_EQ(out_width, rgb->GetWidth());
+        EXPECT_EQ(out_height, rgb->GetHeight());
+        EXPECT_EQ(std::vector<uint8>(out_width * out_height * 3U, 77),
+                  GetValues<uint8>(rgb));
+
+        const ImagePtr shorts = ResampleImage(
+            CreateImage(Image::kRg16ui, in_width, in_height,
+                        std::vector<uint16>(1, 60000)),
+            out_width, out_height, kFilters[f], false, al, NULL);
+        EXPECT_EQ(std::vector<uint16>(out_width * out_height * 2U, 60000),
+                  GetValues<uint16>(shorts));
+
+        const std::vector<float> floats = GetValues<float>(ResampleImage(
+            CreateImage(Image::kRgba32f, in_width, in_height,
+                        std::vector<float>(1, 0.3f)),
+            out_width, out_height, kFilters[f], false, al, NULL));
+        ASSERT_EQ(out_width * out_height * 4U, floats.size());
+        for (size_t i = 0; i < floats.size(); ++i)
+          EXPECT_NEAR(0.3f, floats[i], 1e-5f);
+      }
+    }
+  }
+}
+
+TEST(ResampleUtils, Filters) {
+  base::AllocatorPtr al;
+  // A single bright column in a 4x1 image.
+  std::vector<float> column(4, 0.f);
+  column[1] = 1.f;
+  const ImagePtr image = CreateImage(Image::kR32f, 4, 1, column);
+
+  // Halving the width with a box averages pairs of pixels.
+  std::vector<float> values = GetValues<float>(
+      ResampleImage(image, 2, 1, kBoxFilter, false, al, NULL));
+  ASSERT_EQ(2U, values.size());
+  EXPECT_FLOAT_EQ(0.5f, values[0]);
+  EXPECT_FLOAT_EQ(0.f, values[1]);
+
+  // Doubling the width with bilinear filtering interpolates between pixel
+  // centers.
+  values = GetValues<float>(
+      ResampleImage(image, 8, 1, kBilinearFilter, false, al, NULL));
+  ASSERT_EQ(8U, values.size());
+  static const float kBilinear[] = {
+    0.f, 0.25f, 0.75f, 0.75f, 0.25f, 0.f, 0.f, 0.f
+  };
+  for (size_t i = 0; i < values.size(); ++i)
+    EXPECT_FLOAT_EQ(kBilinear[i], values[i]) << i;
+
+  // The cubic filters have negative lobes next to the peak, which are clamped
+  // for integer formats.
+  for (size_t f = 2; f < ARRAYSIZE(kFilters); ++f) {
+    values = GetValues<float>(
+        ResampleImage(image, 8, 1, kFilters[f], false, al, NULL));
+    ASSERT_EQ(8U, values.size());
+    EXPECT_LT(values[0], 0.f) << f;
+    EXPECT_LT(values[5], 0.f) << f;
+    EXPECT_FLOAT_EQ(values[2], values[3]) << f;
+    EXPECT_GT(values[2], 0.75f) << f;
+
+    std::vector<uint8> bytes(4, 0);
+    bytes[1] = 255;
+    const std::vector<uint8> clamped = GetValues<uint8>(ResampleImage(
+        CreateImage(Image::kR8, 4, 1, bytes), 8, 1, kFilters[f], false, al,
+        NULL));
+    EXPECT_EQ(0, clamped[0]) << f;
+    EXPECT_EQ(0, clamped[5]) << f;
+    EXPECT_LT(191, clamped[2]) << f;
+  }
+}
+
+TEST(ResampleUtils, HalveImage) {
+  base::AllocatorPtr al;
+  static const uint8 kBytes[] = {
+    0, 10, 20,
+    30, 40, 50,
+  };
+  const ImagePtr result = HalveImage(
+      CreateImage(Image::kLuminance, 3, 2,
+                  std::vector<uint8>(kBytes, kBytes + ARRAYSIZE(kBytes))),
+      true, al, NULL);
+  ASSERT_TRUE(result.Get());
+  EXPECT_EQ(2U, result->GetWidth());
+  EXPECT_EQ(1U, result->GetHeight());
+  EXPECT_TRUE(result->GetData()->IsWipeable());
+  // The last column is repeated.
+  static const uint8 kExpected[] = { 20, 35 };
+  EXPECT_EQ(std::vector<uint8>(kExpected, kExpected + 2),
+            GetValues<uint8>(result));
+
+  std::vector<float> floats;
+  floats.push_back(1.f);
+  floats.push_back(2.f);
+  floats.push_back(4.f);
+  floats.push_back(8.f);
+  const std::vector<float> halved = GetValues<float>(HalveImage(
+      CreateImage(Image::kR32f, 2, 2, floats), false, al, NULL));
+  ASSERT_EQ(1U, halved.size());
+  EXPECT_FLOAT_EQ(3.75f, halved[0]);
+
+  // 1.0 and 3.0 in half float average to 2.0.
+  std::vector<uint16> halves;
+  halves.push_back(0x3c00);
+  halves.push_back(0x4200);
+  const std::vector<uint16> halved_halves = GetValues<uint16>(HalveImage(
+      CreateImage(Image::kR16fHalf, 2, 2, halves), false, al, NULL));
+  ASSERT_EQ(1U, halved_halves.size());
+  EXPECT_EQ(0x4000, halved_halves[0]);
+}
+
+TEST(ResampleUtils, PackedFloatImages) {
+  base::AllocatorPtr al;
+  // Red is 1.0 and 3.0 in alternate pixels, green 0.5 and blue 2.0.
+  std::vector<uint32> rgb;
+  rgb.push_back(0x3c0U | (0x380U << 11) | (0x200U << 22));
+  rgb.push_back(0x420U | (0x380U << 11) | (0x200U << 22));
+  const std::vector<uint32> halved = GetValues<uint32>(HalveImage(
+      CreateImage(Image::kRgb11f_11f_10f_Rev, 2, 2, rgb), false, al, NULL));
+  ASSERT_EQ(1U, halved.size());
+  EXPECT_EQ(0x400U | (0x380U << 11) | (0x200U << 22), halved[0]);
+
+  // A constant image stays constant.
+  std::vector<uint32> rgba(1, 0x3ffU | (0x200U << 10) | (1U << 30));
+  const ImagePtr resized =
+      ResampleImage(CreateImage(Image::kRgb10a2, 5, 3, rgba), 7, 2,
+                    kMitchellFilter, false, al, NULL);
+  ASSERT_TRUE(resized.Get());
+  EXPECT_EQ(Image::kRgb10a2, resized->GetFormat());
+  EXPECT_EQ(std::vector<uint32>(14, rgba[0]), GetValues<uint32>(resized));
+}
+
+TEST(ResampleUtils, Parallel) {
+  base::AllocatorPtr al;
+  base::TaskScheduler scheduler("resample", 3U);
+  std::vector<uint8> bytes;
+  for (int i = 0; i < 251; ++i)
+    bytes.push_back(static_cast<uint8>(i * 91));
+  const ImagePtr image = CreateImage(Image::kRgba8888, 61, 45, bytes);
+  // Splitting the rows between threads does not change the result.
+  for (size_t f = 0; f < ARRAYSIZE(kFilters); ++f) {
+    EXPECT_TRUE(ImagesAreEqual(
+        ResampleImage(image, 23, 90, kFilters[f], false, al, NULL),
+        ResampleImage(image, 23, 90, kFilters[f], false, al, &scheduler)));
+  }
+  EXPECT_TRUE(ImagesAreEqual(HalveImage(image, false, al, NULL),
+                             HalveImage(image, false, al, &scheduler)));
+}
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,550 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/texturecontainer.h"
+
+#include <stdio.h>
+#include <string.h>  // For memcmp().
+
+#include <string>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/port/fileutils.h"
+#include "ion/port/memorymappedfile.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+using gfx::CubeMapTexture;
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+// Appends values to a container file in little-endian order.
+class ContainerWriter {
+ public:
+  void Append32(uint32 value) {
+    for (int i = 0; i < 4; ++i)
+      bytes_.push_back(static_cast<uint8>(value >> (8 * i)));
+  }
+  void Append64(uint64 value) {
+    Append32(static_cast<uint32>(value));
+    Append32(static_cast<uint32>(value >> 32));
+  }
+  void AppendBytes(const uint8* data, size_t count) {
+    bytes_.insert(bytes_.end(), data, data + count);
+  }
+  // Appends |count| bytes with values starting at |first|.
+  void AppendImage(size_t count, uint8 first) {
+    for (size_t i = 0; i < count; ++i)
+      bytes_.push_back(static_cast<uint8>(first + i));
+  }
+  void Pad(size_t alignment) {
+    while (bytes_.size() % alignment)
+      bytes_.push_back(0U);
+  }
+  void Set32(size_t offset, uint32 value) {
+    for (int i = 0; i < 4; ++i)
+      bytes_[offset + i] = static_cast<uint8>(value >> (8 * i));
+  }
+  size_t GetSize() const { return bytes_.size(); }
+  const std::vector<uint8>& GetBytes() const { return bytes_; }
+
+ private:
+  std::vector<uint8> bytes_;
+};
+
+static const uint8 kKtxIdentifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const uint8 kKtx2Identifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+// GL values used in KTX headers.
+static const uint32 kGlRed = 0x1903U;
+static const uint32 kGlR8 = 0x8229U;
+static const uint32 kGlRgba = 0x1908U;
+static const uint32 kGlUnsignedByte = 0x1401U;
+static const uint32 kGlCompressedRgbDxt1 = 0x83F0U;
+
+// Returns a KTX file of a |width|x|height| image in |format| with
+// |level_count| levels and |face_count| faces. Level l of face f is filled
+// with bytes starting at 16 * f + l.
+static const std::vector<uint8> CreateKtx(
+    uint32 gl_internal_format, uint32 gl_format, uint32 gl_type,
+    Image::Format format, uint32 width, uint32 height, uint32 face_count,
+    uint32 level_count) {
+  ContainerWriter writer;
+  writer.AppendBytes(kKtxIdentifier, sizeof(kKtxIdentifier));
+  writer.Append32(0x04030201U);
+  writer.Append32(gl_type);
+  writer.Append32(gl_type ? 1U : 0U);
+  writer.Append32(gl_format);
+  writer.Append32(gl_internal_format);
+  writer.Append32(gl_format);
+  writer.Append32(width);
+  writer.Append32(height);
+  writer.Append32(0U);
+  writer.Append32(0U);
+  writer.Append32(face_count);
+  writer.Append32(level_count);
+  // Add some key/value data, which is skipped.
+  writer.Append32(8U);
+  writer.Append32(4U);
+  writer.Append32(0x00626100U);
+  for (uint32 level = 0; level < level_count; ++level) {
+    const size_t size = Image::ComputeDataSize(
+        format, std::max(width >> level, 1U), std::max(height >> level, 1U));
+    writer.Append32(static_cast<uint32>(size));
+    for (uint32 face = 0; face < face_count; ++face) {
+      writer.AppendImage(size, static_cast<uint8>(16U * face + level));
+      writer.Pad(4U);
+    }
+  }
+  return writer.GetBytes();
+}
+
+// Returns a KTX2 file like CreateKtx().
+static const std::vector<uint8> CreateKtx2(
+    uint32 vk_format, Image::Format format, uint32 width, uint32 height,
+    uint32 face_count, uint32 level_count) {
+  ContainerWriter writer;
+  writer.AppendBytes(kKtx2Identifier, sizeof(kKtx2Identifier));
+  writer.Append32(vk_format);
+  writer.Append32(1U);
+  writer.Append32(width);
+  writer.Append32(height);
+  writer.Append32(0U);
+  writer.Append32(0U);
+  writer.Append32(face_count);
+  writer.Append32(level_count);
+  writer.Append32(0U);
+  // The data format descriptor and key/value data are not used.
+  for (int i = 0; i < 4; ++i)
+    writer.Append32(0U);
+  writer.Append64(0U);
+  writer.Append64(0U);
+  const size_t index = writer.GetSize();
+  for (uint32 level = 0; level < level_count; ++level) {
+    writer.Append64(0U);
+    writer.Append64(0U);
+    writer.Append64(0U);
+  }
+  // Levels are stored from smallest to largest.
+  for (uint32 level = level_count; level-- > 0;) {
+    writer.Pad(8U);
+    const size_t size = Image::ComputeDataSize(
+        format, std::max(width >> level, 1U), std::max(height >> level, 1U));
+    const size_t entry = index + level * 24U;
+    writer.Set32(entry, static_cast<uint32>(writer.GetSize()));
+    writer.Set32(entry + 8U, static_cast<uint32>(size * face_count));
+    writer.Set32(entry + 16U, static_cast<uint32>(size * face_count));
+    for (uint32 face = 0; face < face_count; ++face)
+      writer.AppendImage(size, static_cast<uint8>(16U * face + level));
+  }
+  return writer.GetBytes();
+}
+
+// Returns a DDS file like CreateKtx(). If |dxgi_format| is non-zero a DX10
+// header is written, otherwise the file uses the DXT1 FourCC.
+static const std::vector<uint8> CreateDds(
+    uint32 dxgi_format, Image::Format format, uint32 width, uint32 height,
+    uint32 face_count, uint32 level_count) {
+  ContainerWriter writer;
+  writer.Append32(0x20534444U);
+  writer.Append32(124U);
+  writer.Append32(0x1007U | 0x20000U);
+  writer.Append32(height);
+  writer.Append32(width);
+  writer.Append32(0U);
+  writer.Append32(0U);
+  writer.Append32(level_count);
+  for (int i = 0; i < 11; ++i)
+    writer.Append32(0U);
+  // The pixel format.
+  writer.Append32(32U);
+  writer.Append32(0x4U);
+  writer.Append32(dxgi_format ? 0x30315844U : 0x31545844U);
+  for (int i = 0; i < 5; ++i)
+    writer.Append32(0U);
+  writer.Append32(0x1000U);
+  writer.Append32(face_count == 6U && !dxgi_format ? 0xFE00U : 0U);
+  for (int i = 0; i < 3; ++i)
+    writer.Append32(0U);
+  if (dxgi_format) {
+    writer.Append32(dxgi_format);
+    writer.Append32(3U);
+    writer.Append32(face_count == 6U ? 0x4U : 0U);
+    writer.Append32(1U);
+    writer.Append32(0U);
+  }
+  for (uint32 face = 0; face < face_count; ++face) {
+    for (uint32 level = 0; level < level_count; ++level) {
+      const size_t size = Image::ComputeDataSize(
+          format, std::max(width >> level, 1U), std::max(height >> level, 1U));
+      writer.AppendImage(size, static_cast<uint8>(16U * face + level));
+    }
+  }
+  return writer.GetBytes();
+}
+
+// Checks that |images| has the expected formats and sizes, and that level l of
+// the face stored in file position f starts with 16 * f + l.
+static void CheckImages(const TextureContainerImages& images,
+                        Image::Format format, uint32 width, uint32 height,
+                        uint32 face_count, uint32 level_count) {
+  static const CubeMapTexture::CubeFace kFileFaces[6] = {
+    CubeMapTexture::kPositiveX, CubeMapTexture::kNegativeX,
+    CubeMapTexture::kPositiveY, CubeMapTexture::kNegativeY,
+    CubeMapTexture::kPositiveZ, CubeMapTexture::kNegativeZ,
+  };
+  ASSERT_EQ(face_count, images.faces.size());
+  EXPECT_EQ(face_count == 6U, images.IsCubeMap());
+  for (uint32 file_face = 0; file_face < face_count; ++file_face) {
+    const std::vector<ImagePtr>& levels =
+        images.faces[face_count == 6U ? kFileFaces[file_face] : 0U];
+    ASSERT_EQ(level_count, levels.size());
+    for (uint32 level = 0; level < level_count; ++level) {
+      SCOPED_TRACE(::testing::Message() << "face " << file_face << " level "
+                                        << level);
+      const Image& image = *levels[level];
+      EXPECT_EQ(format, image.GetFormat());
+      EXPECT_EQ(std::max(width >> level, 1U), image.GetWidth());
+      EXPECT_EQ(std::max(height >> level, 1U), image.GetHeight());
+      ASSERT_TRUE(image.GetData()->GetData());
+      const uint8* data = image.GetData()->GetData<uint8>();
+      EXPECT_EQ(16U * file_face + level, data[0]);
+      EXPECT_EQ(static_cast<uint8>(16U * file_face + level +
+                                   image.GetDataSize() - 1U),
+                data[image.GetDataSize() - 1U]);
+    }
+  }
+}
+
+}  // anonymous namespace
+
+TEST(TextureContainer, Ktx) {
+  base::LogChecker log_checker;
+  TextureContainerImages images;
+  const std::vector<uint8> dxt = CreateKtx(kGlCompressedRgbDxt1, 0U, 0U,
+                                           Image::kDxt1, 16U, 8U, 1U, 5U);
+  EXPECT_TRUE(IsTextureContainerData(&dxt[0], dxt.size()));
+  EXPECT_TRUE(ReadTextureContainer(&dxt[0], dxt.size(), true,
+                                   base::AllocatorPtr(), &images));
+  CheckImages(images, Image::kDxt1, 16U, 8U, 1U, 5U);
+  EXPECT_TRUE(images.faces[0][0]->GetData()->IsWipeable());
+
+  // Uncompressed data is matched by its GL internal format and type.
+  const std::vector<uint8> rgba = CreateKtx(
+      kGlRgba, kGlRgba, kGlUnsignedByte, Image::kRgba8888, 4U, 4U, 6U, 2U);
+  EXPECT_TRUE(ReadTextureContainer(&rgba[0], rgba.size(), false,
+                                   base::AllocatorPtr(), &images));
+  CheckImages(images, Image::kRgba8888, 4U, 4U, 6U, 2U);
+  EXPECT_FALSE(images.faces[0][0]->GetData()->IsWipeable());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // RGB rows that are padded to 4 bytes cannot be used as they are.
+  const std::vector<uint8> rgb = CreateKtx(
+      0x1907U, 0x1907U, kGlUnsignedByte, Image::kRgb888, 3U, 3U, 1U, 1U);
+  std::vector<uint8> padded = rgb;
+  padded[72U] = 36U;
+  EXPECT_FALSE(ReadTextureContainer(&padded[0], padded.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "padded rows"));
+  EXPECT_TRUE(images.faces.empty());
+
+  // Truncated files fail.
+  EXPECT_FALSE(ReadTextureContainer(&dxt[0], dxt.size() - 1U, false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "truncated"));
+
+  // Array textures are not supported.
+  std::vector<uint8> array = dxt;
+  array[48U] = 2U;
+  EXPECT_FALSE(ReadTextureContainer(&array[0], array.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "array"));
+
+  // Nor are unknown formats.
+  const std::vector<uint8> unknown = CreateKtx(0x1234U, 0U, 0U, Image::kDxt1,
+                                               4U, 4U, 1U, 1U);
+  EXPECT_FALSE(ReadTextureContainer(&unknown[0], unknown.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "unsupported format"));
+}
+
+TEST(TextureContainer, WriteKtx) {
+  base::LogChecker log_checker;
+  TextureContainerImages images;
+  const std::vector<uint8> rgba = CreateKtx(
+      kGlRgba, kGlRgba, kGlUnsignedByte, Image::kRgba8888, 4U, 4U, 6U, 3U);
+  ASSERT_TRUE(ReadTextureContainer(&rgba[0], rgba.size(), false,
+                                   base::AllocatorPtr(), &images));
+
+  // Writing and reading a cube map restores the faces in the same order.
+  const std::vector<uint8> written = WriteKtxContainer(images);
+  ASSERT_FALSE(written.empty());
+  TextureContainerImages read;
+  EXPECT_TRUE(ReadTextureContainer(&written[0], written.size(), false,
+                                   base::AllocatorPtr(), &read));
+  CheckImages(read, Image::kRgba8888, 4U, 4U, 6U, 3U);
+
+  // Compressed 2D textures round trip as well.
+  const std::vector<uint8> dxt = CreateKtx(kGlCompressedRgbDxt1, 0U, 0U,
+                                           Image::kDxt1, 16U, 8U, 1U, 5U);
+  ASSERT_TRUE(ReadTextureContainer(&dxt[0], dxt.size(), false,
+                                   base::AllocatorPtr(), &images));
+  const std::vector<uint8> written_dxt = WriteKtxContainer(images);
+  ASSERT_FALSE(written_dxt.empty());
+  EXPECT_TRUE(ReadTextureContainer(&written_dxt[0], written_dxt.size(), false,
+                                   base::AllocatorPtr(), &read));
+  CheckImages(read, Image::kDxt1, 16U, 8U, 1U, 5U);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Invalid images are not written.
+  TextureContainerImages invalid;
+  EXPECT_TRUE(WriteKtxContainer(invalid).empty());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "face count"));
+  invalid = images;
+  invalid.faces[0].pop_back();
+  invalid.faces[0].push_back(invalid.faces[0][0]);
+  EXPECT_TRUE(WriteKtxContainer(invalid).empty());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "level 4 must be a 1x1"));
+  invalid.faces[0].resize(1U);
+  invalid.faces[0][0].Reset(new Image);
+  invalid.faces[0][0]->Set(Image::kRgb888, 3U, 3U, base::DataContainerPtr());
+  EXPECT_TRUE(WriteKtxContainer(invalid).empty());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "has no data"));
+  std::vector<uint8> rgb(27U, 0U);
+  invalid.faces[0][0]->Set(Image::kRgb888, 3U, 3U,
+                           base::DataContainer::CreateAndCopy<uint8>(
+                               &rgb[0], rgb.size(), false,
+                               base::AllocatorPtr()));
+  EXPECT_TRUE(WriteKtxContainer(invalid).empty());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "padded rows"));
+}
+
+TEST(TextureContainer, Ktx2) {
+  base::LogChecker log_checker;
+  TextureContainerImages images;
+  const std::vector<uint8> dxt5 =
+      CreateKtx2(137U, Image::kDxt5, 8U, 8U, 1U, 4U);
+  EXPECT_TRUE(IsTextureContainerData(&dxt5[0], dxt5.size()));
+  EXPECT_TRUE(ReadTextureContainer(&dxt5[0], dxt5.size(), false,
+                                   base::AllocatorPtr(), &images));
+  CheckImages(images, Image::kDxt5, 8U, 8U, 1U, 4U);
+
+  const std::vector<uint8> cube =
+      CreateKtx2(37U, Image::kRgba8888, 2U, 2U, 6U, 2U);
+  EXPECT_TRUE(ReadTextureContainer(&cube[0], cube.size(), false,
+                                   base::AllocatorPtr(), &images));
+  CheckImages(images, Image::kRgba8888, 2U, 2U, 6U, 2U);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Supercompressed data is not supported.
+  std::vector<uint8> zstd = dxt5;
+  zstd[44U] = 2U;
+  EXPECT_FALSE(ReadTextureContainer(&zstd[0], zstd.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "supercompression"));
+
+  // More levels than the size allows are invalid.
+  std::vector<uint8> levels = dxt5;
+  levels[40U] = 5U;
+  EXPECT_FALSE(ReadTextureContainer(&levels[0], levels.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "level count"));
+
+  EXPECT_FALSE(ReadTextureContainer(&dxt5[0], dxt5.size() - 1U, false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "truncated"));
+}
+
+TEST(TextureContainer, Dds) {
+  base::LogChecker log_checker;
+  TextureContainerImages images;
+  const std::vector<uint8> dxt1 = CreateDds(0U, Image::kDxt1, 8U, 4U, 1U, 4U);
+  EXPECT_TRUE(IsTextureContainerData(&dxt1[0], dxt1.size()));
+  EXPECT_TRUE(ReadTextureContainer(&dxt1[0], dxt1.size(), false,
+                                   base::AllocatorPtr(), &images));
+  CheckImages(images, Image::kDxt1, 8U, 4U, 1U, 4U);
+
+  const std::vector<uint8> cube = CreateDds(0U, Image::kDxt1, 4U, 4U, 6U, 3U);
+  EXPECT_TRUE(ReadTextureContainer(&cube[0], cube.size(), false,
+                                   base::AllocatorPtr(), &images));
+  CheckImages(images, Image::kDxt1, 4U, 4U, 6U, 3U);
+
+  // DX10 headers.
+  const std::vector<uint8> dx10 =
+      CreateDds(77U, Image::kDxt5, 4U, 8U, 6U, 2U);
+  EXPECT_TRUE(ReadTextureContainer(&dx10[0], dx10.size(), false,
+                                   base::AllocatorPtr(), &images));
+  CheckImages(images, Image::kDxt5, 4U, 8U, 6U, 2U);
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Cube maps must have all faces.
+  std::vector<uint8> faces = cube;
+  faces[113U] = 0x7EU;
+  EXPECT_FALSE(ReadTextureContainer(&faces[0], faces.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "all six faces"));
+
+  EXPECT_FALSE(ReadTextureContainer(&dxt1[0], dxt1.size() - 1U, false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "truncated"));
+
+  // Unknown data is rejected.
+  const uint8 kGarbage[16] = { 1U, 2U, 3U };
+  EXPECT_FALSE(IsTextureContainerData(kGarbage, sizeof(kGarbage)));
+  EXPECT_FALSE(IsTextureContainerData(NULL, 0U));
+  EXPECT_FALSE(ReadTextureContainer(kGarbage, sizeof(kGarbage), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Unknown"));
+}
+
+TEST(TextureContainer, OverflowingSize) {
+  base::LogChecker log_checker;
+  TextureContainerImages images;
+  // A 65536x65536 R8 image has 2^32 bytes, which wraps to 0 in 32 bits, so
+  // these files have headers claiming empty images.
+  const std::vector<uint8> ktx = CreateKtx(
+      kGlR8, kGlRed, kGlUnsignedByte, Image::kR8, 65536U, 65536U, 1U, 1U);
+  EXPECT_FALSE(ReadTextureContainer(&ktx[0], ktx.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "bytes instead of"));
+  EXPECT_TRUE(images.faces.empty());
+
+  const std::vector<uint8> ktx2 =
+      CreateKtx2(9U, Image::kR8, 65536U, 65536U, 1U, 1U);
+  EXPECT_FALSE(ReadTextureContainer(&ktx2[0], ktx2.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "bytes instead of"));
+  EXPECT_TRUE(images.faces.empty());
+
+  const std::vector<uint8> dds =
+      CreateDds(61U, Image::kR8, 65536U, 65536U, 1U, 1U);
+  EXPECT_FALSE(ReadTextureContainer(&dds[0], dds.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "truncated"));
+  EXPECT_TRUE(images.faces.empty());
+
+  // Compressed sizes must not wrap either.
+  const std::vector<uint8> dxt5 =
+      CreateDds(77U, Image::kDxt5, 65536U, 65536U, 1U, 1U);
+  EXPECT_FALSE(ReadTextureContainer(&dxt5[0], dxt5.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "truncated"));
+
+  // Larger dimensions are rejected outright.
+  const std::vector<uint8> huge =
+      CreateKtx2(9U, Image::kR8, 0x80000000U, 2U, 1U, 1U);
+  EXPECT_FALSE(ReadTextureContainer(&huge[0], huge.size(), false,
+                                    base::AllocatorPtr(), &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "invalid size"));
+}
+
+TEST(TextureContainer, MappedFile) {
+  base::LogChecker log_checker;
+  const std::vector<uint8> ktx = CreateKtx(kGlCompressedRgbDxt1, 0U, 0U,
+                                           Image::kDxt1, 8U, 8U, 1U, 4U);
+  const std::string filename = port::GetTemporaryFilename();
+  ASSERT_FALSE(filename.empty());
+  FILE* fp = port::OpenFile(filename, "wb");
+  ASSERT_TRUE(fp);
+  fwrite(&ktx[0], 1U, ktx.size(), fp);
+  fclose(fp);
+
+  TextureContainerImages images;
+  {
+    base::DataContainer::MappedFilePtr file(
+        new port::MemoryMappedFile(filename));
+    ASSERT_TRUE(file->GetData());
+    EXPECT_TRUE(ReadTextureContainer(file, false, base::AllocatorPtr(),
+                                     &images));
+    CheckImages(images, Image::kDxt1, 8U, 8U, 1U, 4U);
+    // The images point into the mapping, which they keep alive.
+    const uint8* mapped = static_cast<const uint8*>(file->GetData());
+    for (size_t level = 0; level < 4U; ++level) {
+      const uint8* data = images.faces[0][level]->GetData()->GetData<uint8>();
+      EXPECT_LE(mapped, data);
+      EXPECT_GE(mapped + file->GetLength(), data);
+      EXPECT_TRUE(images.faces[0][level]->GetData()->IsReadOnly());
+    }
+    EXPECT_EQ(5, file.use_count());
+  }
+  CheckImages(images, Image::kDxt1, 8U, 8U, 1U, 4U);
+  images.faces.clear();
+
+  base::DataContainer::MappedFilePtr missing(
+      new port::MemoryMappedFile("/InvalidPath/DoesNotExist"));
+  EXPECT_FALSE(ReadTextureContainer(missing, false, base::AllocatorPtr(),
+                                    &images));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "unmapped"));
+  port::RemoveFile(filename);
+}
+
+TEST(TextureContainer, CreateTextures) {
+  TextureContainerImages images;
+  // A complete chain.
+  const std::vector<uint8> full = CreateKtx(kGlCompressedRgbDxt1, 0U, 0U,
+                                            Image::kDxt1, 8U, 4U, 1U, 4U);
+  ASSERT_TRUE(ReadTextureContainer(&full[0], full.size(), false,
+                                   base::AllocatorPtr(), &images));
+  gfx::TexturePtr texture =
+      CreateTextureFromContainer(images, base::AllocatorPtr());
+  ASSERT_TRUE(texture.Get());
+  EXPECT_EQ(4U, texture->GetImageCount());
+  for (size_t level = 0; level < 4U; ++level)
+    EXPECT_EQ(images.faces[0][level], texture->GetImage(level));
+  EXPECT_EQ(1000, texture->GetMaxLevel());
+  EXPECT_FALSE(
+      CreateCubeMapTextureFromContainer(images, base::AllocatorPtr()).Get());
+
+  // A partial chain sets the maximum level.
+  const std::vector<uint8> partial = CreateKtx(kGlCompressedRgbDxt1, 0U, 0U,
+                                               Image::kDxt1, 8U, 4U, 1U, 2U);
+  ASSERT_TRUE(ReadTextureContainer(&partial[0], partial.size(), false,
+                                   base::AllocatorPtr(), &images));
+  texture = CreateTextureFromContainer(images, base::AllocatorPtr());
+  ASSERT_TRUE(texture.Get());
+  EXPECT_EQ(1, texture->GetMaxLevel());
+
+  const std::vector<uint8> cube = CreateDds(0U, Image::kDxt1, 4U, 4U, 6U, 2U);
+  ASSERT_TRUE(ReadTextureContainer(&cube[0], cube.size(), false,
+                                   base::AllocatorPtr(), &images));
+  EXPECT_FALSE(CreateTextureFromContainer(images, base::AllocatorPtr()).Get());
+  gfx::CubeMapTexturePtr cube_map =
+      CreateCubeMapTextureFromContainer(images, base::AllocatorPtr());
+  ASSERT_TRUE(cube_map.Get());
+  for (int face = 0; face < 6; ++face) {
+    const CubeMapTexture::CubeFace cube_face =
+        static_cast<CubeMapTexture::CubeFace>(face);
+    EXPECT_EQ(2U, cube_map->GetImageCount(cube_face));
+    EXPECT_EQ(images.faces[face][1], cube_map->GetImage(cube_face, 1U));
+  }
+  EXPECT_EQ(1, cube_map->GetMaxLevel());
+
+  images.faces.clear();
+  EXPECT_FALSE(CreateTextureFromContainer(images, base::AllocatorPtr()).Get());
+}
+
+}  // namespace image
+}  // namespace ion
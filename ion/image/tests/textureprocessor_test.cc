@@ -0,0 +1,211 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/textureprocessor.h"
+
+#include <memory>
+
+#include "base/integral_types.h"
+#include "ion/base/logchecker.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/traceverifier.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::TexturePtr;
+using gfx::testing::MockGraphicsManager;
+using gfx::testing::MockVisual;
+
+//-----------------------------------------------------------------------------
+//
+// Test harness that sets up a MockGraphicsManager, Renderer, TraceVerifier and
+// TextureProcessor for convenience.
+//
+//-----------------------------------------------------------------------------
+
+class TextureProcessorTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    visual_.reset(new MockVisual(64, 64));
+    mgm_.Reset(new MockGraphicsManager());
+    renderer_.Reset(new gfx::Renderer(mgm_));
+    processor_.Reset(new TextureProcessor(renderer_));
+    tv_.reset(new gfx::testing::TraceVerifier(mgm_.Get()));
+    input_ = TextureProcessor::CreateTargetTexture(32U, 32U,
+                                                   Image::kRgba8888, al_);
+
+    // Start with a clear call count.
+    MockGraphicsManager::ResetCallCount();
+  }
+
+  void TearDown() override {
+    tv_.reset();
+    input_.Reset(NULL);
+    processor_.Reset(NULL);
+    renderer_.Reset(NULL);
+    mgm_.Reset(NULL);
+    visual_.reset();
+  }
+
+  std::unique_ptr<MockVisual> visual_;
+  gfx::testing::MockGraphicsManagerPtr mgm_;
+  gfx::RendererPtr renderer_;
+  TextureProcessorPtr processor_;
+  std::unique_ptr<gfx::testing::TraceVerifier> tv_;
+  TexturePtr input_;
+  base::AllocatorPtr al_;
+};
+
+TEST_F(TextureProcessorTest, CreateTargetTexture) {
+  TexturePtr texture =
+      TextureProcessor::CreateTargetTexture(16U, 8U, Image::kRgb888, al_);
+  ASSERT_TRUE(texture.Get());
+  ASSERT_TRUE(texture->HasImage(0U));
+  EXPECT_EQ(16U, texture->GetImage(0U)->GetWidth());
+  EXPECT_EQ(8U, texture->GetImage(0U)->GetHeight());
+  EXPECT_EQ(Image::kRgb888, texture->GetImage(0U)->GetFormat());
+  EXPECT_FALSE(texture->GetImage(0U)->GetData().Get());
+  ASSERT_TRUE(texture->GetSampler().Get());
+  EXPECT_EQ(gfx::Sampler::kLinear, texture->GetSampler()->GetMinFilter());
+  EXPECT_EQ(gfx::Sampler::kClampToEdge, texture->GetSampler()->GetWrapS());
+}
+
+TEST_F(TextureProcessorTest, InvalidTextures) {
+  base::LogChecker log_checker;
+  TexturePtr output =
+      TextureProcessor::CreateTargetTexture(8U, 8U, Image::kRgba8888, al_);
+  // Inputs and outputs without images do nothing.
+  EXPECT_FALSE(processor_->Resize(TexturePtr(), output));
+  EXPECT_FALSE(processor_->Premultiply(TexturePtr(), output));
+  EXPECT_FALSE(processor_->Blur(TexturePtr(), 1.f, output));
+  EXPECT_FALSE(processor_->Resize(input_, TexturePtr()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no image at level 0"));
+  EXPECT_FALSE(processor_->Swizzle(input_, TextureProcessor::kRed,
+                                   TextureProcessor::kGreen,
+                                   TextureProcessor::kBlue,
+                                   TextureProcessor::kAlpha, TexturePtr()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no image at level 0"));
+  EXPECT_FALSE(processor_->GenerateMipmaps(TexturePtr()));
+  EXPECT_FALSE(
+      processor_->ReadImageAsync(TexturePtr(), Image::kRgba8888, al_).Get());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "no image at level 0"));
+  EXPECT_EQ(0, MockGraphicsManager::GetCallCount());
+}
+
+// These tests rely on trace streams, which are disabled in production builds.
+#if !ION_PRODUCTION
+
+TEST_F(TextureProcessorTest, Resize) {
+  TexturePtr output =
+      TextureProcessor::CreateTargetTexture(8U, 4U, Image::kRgba8888, al_);
+  EXPECT_TRUE(processor_->Resize(input_, output));
+
+  // The output is attached to a framebuffer, which is unbound afterwards.
+  EXPECT_EQ(2U, tv_->GetCountOf("BindFramebuffer"));
+  EXPECT_TRUE(tv_->VerifyCallAt(tv_->GetNthIndexOf(1U, "BindFramebuffer"))
+              .HasArg(2, "0x0"));
+  EXPECT_EQ(1U, tv_->GetCountOf("FramebufferTexture2D"));
+  EXPECT_EQ(1U, tv_->GetCountOf("Viewport"));
+  EXPECT_TRUE(tv_->VerifyCallAt(tv_->GetNthIndexOf(0U, "Viewport"))
+              .HasArg(3, "8")
+              .HasArg(4, "4"));
+  EXPECT_EQ(2U, tv_->GetCountOf("CreateShader"));
+  EXPECT_EQ(1U, tv_->GetCountOf("DrawElements"));
+  // Shrinking 32x32 to 8x4 uses 4x4 taps.
+  EXPECT_TRUE(tv_->VerifyCallAt(tv_->GetNthIndexOf(0U, "Uniform1iv"))
+              .HasArg(3, "[4]"));
+  EXPECT_EQ(0U, tv_->GetCountOf("ReadPixels"));
+
+  // Resizing again reuses the program and framebuffer.
+  tv_->Reset();
+  EXPECT_TRUE(processor_->Resize(input_, output));
+  EXPECT_EQ(0U, tv_->GetCountOf("CreateShader"));
+  EXPECT_EQ(0U, tv_->GetCountOf("GenFramebuffers"));
+  EXPECT_EQ(1U, tv_->GetCountOf("DrawElements"));
+}
+
+TEST_F(TextureProcessorTest, PremultiplyAndSwizzle) {
+  TexturePtr output =
+      TextureProcessor::CreateTargetTexture(32U, 32U, Image::kRgba8888, al_);
+  EXPECT_TRUE(processor_->Premultiply(input_, output));
+  EXPECT_EQ(1U, tv_->GetCountOf("DrawElements"));
+
+  tv_->Reset();
+  EXPECT_TRUE(processor_->Swizzle(input_, TextureProcessor::kBlue,
+                                  TextureProcessor::kGreen,
+                                  TextureProcessor::kRed,
+                                  TextureProcessor::kOne, output));
+  EXPECT_EQ(2U, tv_->GetCountOf("CreateShader"));
+  EXPECT_EQ(1U, tv_->GetCountOf("DrawElements"));
+  // The swizzle matrix is transposed for OpenGL; its first column selects
+  // blue, and alpha comes from the offset.
+  EXPECT_TRUE(tv_->VerifyCallAt(tv_->GetNthIndexOf(0U, "UniformMatrix4fv"))
+              .HasArg(3, "GL_FALSE"));
+  EXPECT_EQ(1U, tv_->GetCountOf("Uniform4fv"));
+}
+
+TEST_F(TextureProcessorTest, Blur) {
+  TexturePtr output =
+      TextureProcessor::CreateTargetTexture(32U, 32U, Image::kRgba8888, al_);
+  EXPECT_TRUE(processor_->Blur(input_, 2.f, output));
+  // One pass into a transient framebuffer, and one into the output.
+  EXPECT_EQ(2U, tv_->GetCountOf("DrawElements"));
+  EXPECT_EQ(1U, renderer_->GetTransientFramebufferCount());
+  // Three standard deviations are covered.
+  EXPECT_TRUE(tv_->VerifyCallAt(tv_->GetNthIndexOf(0U, "Uniform1iv"))
+              .HasArg(3, "[6]"));
+}
+
+TEST_F(TextureProcessorTest, GenerateMipmaps) {
+  EXPECT_TRUE(processor_->GenerateMipmaps(input_));
+  // A 32x32 texture has 5 more levels, each rendered from the one above.
+  ASSERT_EQ(6U, input_->GetImageCount());
+  EXPECT_EQ(1U, input_->GetImage(5U)->GetWidth());
+  EXPECT_EQ(4U, input_->GetImage(3U)->GetHeight());
+  EXPECT_EQ(5U, tv_->GetCountOf("DrawElements"));
+  EXPECT_EQ(5U, tv_->GetCountOf("FramebufferTexture2D"));
+  // The base and max levels are restored afterwards.
+  EXPECT_EQ(0, input_->GetBaseLevel());
+  EXPECT_EQ(1000, input_->GetMaxLevel());
+
+  // ES 2.0 cannot restrict sampling to one level.
+  base::LogChecker log_checker;
+  mgm_->SetVersionString("OpenGL ES 2.0");
+  EXPECT_FALSE(processor_->GenerateMipmaps(input_));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "base and max levels"));
+}
+
+TEST_F(TextureProcessorTest, ReadImageAsync) {
+  gfx::Renderer::ImageReadbackPtr readback =
+      processor_->ReadImageAsync(input_, Image::kRgba8888, al_);
+  ASSERT_TRUE(readback.Get());
+  renderer_->ProcessImageReadbacks(true);
+  EXPECT_TRUE(readback->IsReady());
+  ASSERT_TRUE(readback->GetImage().Get());
+  EXPECT_EQ(32U, readback->GetImage()->GetWidth());
+  EXPECT_EQ(1U, tv_->GetCountOf("ReadPixels"));
+}
+
+#endif  // !ION_PRODUCTION
+
+}  // namespace image
+}  // namespace ion
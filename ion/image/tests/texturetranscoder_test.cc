@@ -0,0 +1,220 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/texturetranscoder.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfx/tests/mockvisual.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::ImagePtr;
+using gfx::testing::MockGraphicsManager;
+using gfx::testing::MockGraphicsManagerPtr;
+using gfx::testing::MockVisual;
+
+namespace {
+
+// Storage that keeps entries in memory.
+class MemoryStorage : public gfx::ProgramBinaryCache::Storage {
+ public:
+  bool Read(const std::string& key, std::string* data) override {
+    std::map<std::string, std::string>::const_iterator it = entries_.find(key);
+    if (it == entries_.end())
+      return false;
+    *data = it->second;
+    return true;
+  }
+  void Write(const std::string& key, const std::string& data) override {
+    entries_[key] = data;
+  }
+
+  std::map<std::string, std::string> entries_;
+
+ protected:
+  ~MemoryStorage() override {}
+};
+
+// Returns a size x size image in |format|, which must be kRgb888 or
+// kRgba8888, whose pixels have alpha |alpha|.
+static const ImagePtr CreateImage(Image::Format format, uint32 size,
+                                  uint8 alpha) {
+  const size_t pixel_size = format == Image::kRgba8888 ? 4U : 3U;
+  std::vector<uint8> pixels(size * size * pixel_size);
+  for (size_t i = 0; i < pixels.size(); ++i)
+    pixels[i] = (i + 1U) % pixel_size ? static_cast<uint8>(i) : alpha;
+  ImagePtr image(new Image);
+  image->Set(format, size, size,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &pixels[0], pixels.size(), false, base::AllocatorPtr()));
+  return image;
+}
+
+}  // anonymous namespace
+
+class TextureTranscoderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    visual_.reset(new MockVisual(64, 64));
+    gm_.Reset(new MockGraphicsManager());
+    storage_.Reset(new MemoryStorage);
+  }
+
+  void TearDown() override {
+    storage_.Reset(NULL);
+    gm_.Reset(NULL);
+    visual_.reset();
+  }
+
+  std::unique_ptr<MockVisual> visual_;
+  MockGraphicsManagerPtr gm_;
+  base::ReferentPtr<MemoryStorage>::Type storage_;
+};
+
+TEST_F(TextureTranscoderTest, SelectFormat) {
+  TextureTranscoderPtr transcoder(new TextureTranscoder(
+      gm_, gfx::ProgramBinaryCache::StoragePtr(), NULL, base::AllocatorPtr()));
+
+  // DXT is preferred when it is supported.
+  EXPECT_EQ(Image::kDxt5, transcoder->SelectFormat(true, 16U, 16U));
+  EXPECT_EQ(Image::kDxt1, transcoder->SelectFormat(false, 16U, 16U));
+
+  gm_->SetExtensionsString(
+      "GL_OES_compressed_ETC1_RGB8_texture GL_IMG_texture_compression_pvrtc");
+  EXPECT_EQ(Image::kPvrtc1Rgba2, transcoder->SelectFormat(true, 16U, 16U));
+  EXPECT_EQ(Image::kEtc1, transcoder->SelectFormat(false, 16U, 16U));
+
+  // PVRTC needs square power-of-two images.
+  gm_->SetExtensionsString("GL_IMG_texture_compression_pvrtc");
+  EXPECT_EQ(Image::kPvrtc1Rgba2, transcoder->SelectFormat(false, 16U, 16U));
+  EXPECT_EQ(Image::kRgb888, transcoder->SelectFormat(false, 16U, 32U));
+  EXPECT_EQ(Image::kRgb888, transcoder->SelectFormat(false, 12U, 12U));
+  EXPECT_EQ(Image::kRgba8888, transcoder->SelectFormat(true, 4U, 4U));
+
+  gm_->SetExtensionsString("");
+  EXPECT_EQ(Image::kRgba8888, transcoder->SelectFormat(true, 16U, 16U));
+  EXPECT_EQ(Image::kRgb888, transcoder->SelectFormat(false, 16U, 16U));
+}
+
+TEST_F(TextureTranscoderTest, TranscodeAndCache) {
+  base::LogChecker log_checker;
+  TextureTranscoderPtr transcoder(
+      new TextureTranscoder(gm_, storage_, NULL, base::AllocatorPtr()));
+
+  // Images with alpha use DXT5, and opaque ones DXT1 even if they have an
+  // alpha channel.
+  ImagePtr result = transcoder->Transcode(
+      "translucent", CreateImage(Image::kRgba8888, 16U, 128U));
+  ASSERT_TRUE(result.Get());
+  EXPECT_EQ(Image::kDxt5, result->GetFormat());
+  result = transcoder->Transcode("opaque",
+                                 CreateImage(Image::kRgba8888, 16U, 255U));
+  ASSERT_TRUE(result.Get());
+  EXPECT_EQ(Image::kDxt1, result->GetFormat());
+  EXPECT_EQ(16U, result->GetWidth());
+  EXPECT_EQ(16U, result->GetHeight());
+  EXPECT_EQ(2U, transcoder->GetConvertedCount());
+  EXPECT_EQ(0U, transcoder->GetCacheHitCount());
+  EXPECT_EQ(2U, storage_->entries_.size());
+
+  // A new transcoder reads the cached images.
+  transcoder.Reset(
+      new TextureTranscoder(gm_, storage_, NULL, base::AllocatorPtr()));
+  result = transcoder->Transcode("opaque",
+                                 CreateImage(Image::kRgba8888, 16U, 255U));
+  ASSERT_TRUE(result.Get());
+  EXPECT_EQ(Image::kDxt1, result->GetFormat());
+  EXPECT_EQ(16U, result->GetWidth());
+  EXPECT_EQ(0U, transcoder->GetConvertedCount());
+  EXPECT_EQ(1U, transcoder->GetCacheHitCount());
+
+  // Another format is cached separately.
+  gm_->SetExtensionsString("GL_OES_compressed_ETC1_RGB8_texture");
+  result = transcoder->Transcode("opaque",
+                                 CreateImage(Image::kRgba8888, 16U, 255U));
+  ASSERT_TRUE(result.Get());
+  EXPECT_EQ(Image::kEtc1, result->GetFormat());
+  EXPECT_EQ(1U, transcoder->GetConvertedCount());
+  EXPECT_EQ(3U, storage_->entries_.size());
+
+  // Supported compressed images are returned as they are.
+  EXPECT_EQ(result.Get(), transcoder->Transcode("etc1", result).Get());
+
+  // Without a supported compressed format, alpha is only dropped, and
+  // nothing is cached.
+  gm_->SetExtensionsString("");
+  result = transcoder->Transcode("uncompressed",
+                                 CreateImage(Image::kRgba8888, 16U, 255U));
+  ASSERT_TRUE(result.Get());
+  EXPECT_EQ(Image::kRgb888, result->GetFormat());
+  ImagePtr source = CreateImage(Image::kRgb888, 16U, 255U);
+  EXPECT_EQ(source.Get(), transcoder->Transcode("rgb", source).Get());
+  EXPECT_EQ(3U, storage_->entries_.size());
+
+  // Invalid images are returned unchanged.
+  EXPECT_FALSE(transcoder->Transcode("null", ImagePtr()).Get());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST_F(TextureTranscoderTest, TranscodeAsync) {
+  base::TaskScheduler scheduler("transcode", 2U);
+  TextureTranscoderPtr transcoder(
+      new TextureTranscoder(gm_, storage_, &scheduler, base::AllocatorPtr()));
+
+  std::vector<ImagePtr> results(4U);
+  for (size_t i = 0; i < results.size(); ++i) {
+    ImagePtr* result = &results[i];
+    transcoder->TranscodeAsync(
+        i % 2U ? "opaque" : "translucent",
+        CreateImage(Image::kRgba8888, 8U, i % 2U ? 255U : 0U),
+        [result](const ImagePtr& image) { *result = image; });
+  }
+  transcoder->Wait();
+  for (size_t i = 0; i < results.size(); ++i) {
+    SCOPED_TRACE(i);
+    ASSERT_TRUE(results[i].Get());
+    EXPECT_EQ(i % 2U ? Image::kDxt1 : Image::kDxt5, results[i]->GetFormat());
+  }
+  EXPECT_EQ(4U, transcoder->GetConvertedCount() +
+                    transcoder->GetCacheHitCount());
+  EXPECT_EQ(2U, storage_->entries_.size());
+
+  // Without a scheduler the callback is called right away.
+  transcoder.Reset(
+      new TextureTranscoder(gm_, storage_, NULL, base::AllocatorPtr()));
+  ImagePtr result;
+  transcoder->TranscodeAsync(
+      "opaque", CreateImage(Image::kRgba8888, 8U, 255U),
+      [&result](const ImagePtr& image) { result = image; });
+  ASSERT_TRUE(result.Get());
+  EXPECT_EQ(Image::kDxt1, result->GetFormat());
+  EXPECT_EQ(1U, transcoder->GetCacheHitCount());
+}
+
+}  // namespace image
+}  // namespace ion
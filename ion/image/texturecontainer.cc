@@ -0,0 +1,773 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/texturecontainer.h"
+
+#include <string.h>  // For memcmp() and memcpy().
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "base/macros.h"  // For ARRAYSIZE().
+#include "base/port.h"
+#include "ion/base/logging.h"
+#include "ion/port/memorymappedfile.h"
+#include "ion/portgfx/glheaders.h"
+
+namespace ion {
+namespace image {
+
+using gfx::CubeMapTexture;
+using gfx::CubeMapTexturePtr;
+using gfx::Image;
+using gfx::ImagePtr;
+using gfx::Texture;
+using gfx::TexturePtr;
+
+namespace {
+
+//-----------------------------------------------------------------------------
+//
+// Container constants.
+//
+//-----------------------------------------------------------------------------
+
+static const uint8 kKtxIdentifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const uint8 kKtx2Identifier[12] = {
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+static const uint32 kKtxEndianness = 0x04030201U;
+static const size_t kKtxHeaderSize = 64U;
+static const size_t kKtx2HeaderSize = 80U;
+static const size_t kKtx2LevelIndexEntrySize = 24U;
+// The largest width or height accepted from a container, which is beyond what
+// any GL implementation supports.
+static const uint32 kMaxDimension = 1U << 16;
+
+static const uint32 kDdsMagic = 0x20534444U;  // "DDS ".
+static const uint32 kDdsHeaderSize = 124U;
+static const size_t kDdsDataOffset = 4U + kDdsHeaderSize;
+static const size_t kDdsDx10HeaderSize = 20U;
+static const uint32 kDdsMipmapCountFlag = 0x20000U;
+static const uint32 kDdsPixelFormatAlpha = 0x2U;
+static const uint32 kDdsPixelFormatAlphaPixels = 0x1U;
+static const uint32 kDdsPixelFormatFourCc = 0x4U;
+static const uint32 kDdsPixelFormatRgb = 0x40U;
+static const uint32 kDdsPixelFormatLuminance = 0x20000U;
+static const uint32 kDdsCaps2CubeMap = 0x200U;
+static const uint32 kDdsCaps2AllFaces = 0xFC00U;
+static const uint32 kDdsCaps2Volume = 0x200000U;
+static const uint32 kDdsFourCcDxt1 = 0x31545844U;  // "DXT1".
+static const uint32 kDdsFourCcDxt5 = 0x35545844U;  // "DXT5".
+static const uint32 kDdsFourCcDx10 = 0x30315844U;  // "DX10".
+static const uint32 kDx10Texture2d = 3U;
+static const uint32 kDx10TextureCube = 0x4U;
+
+// The faces of a cube map in the order they are stored in KTX and DDS files.
+static const CubeMapTexture::CubeFace kFileFaceOrder[6] = {
+  CubeMapTexture::kPositiveX, CubeMapTexture::kNegativeX,
+  CubeMapTexture::kPositiveY, CubeMapTexture::kNegativeY,
+  CubeMapTexture::kPositiveZ, CubeMapTexture::kNegativeZ,
+};
+
+// Maps a format code used by a container to an Image format.
+struct FormatMapping {
+  uint32 code;
+  Image::Format format;
+};
+
+// Vulkan formats used by KTX2.
+static const FormatMapping kVkFormats[] = {
+  { 9U, Image::kR8 },               // VK_FORMAT_R8_UNORM
+  { 16U, Image::kRg8 },             // VK_FORMAT_R8G8_UNORM
+  { 23U, Image::kRgb888 },          // VK_FORMAT_R8G8B8_UNORM
+  { 29U, Image::kSrgb8 },           // VK_FORMAT_R8G8B8_SRGB
+  { 37U, Image::kRgba8888 },        // VK_FORMAT_R8G8B8A8_UNORM
+  { 43U, Image::kSrgba8 },          // VK_FORMAT_R8G8B8A8_SRGB
+  { 97U, Image::kRgba16fHalf },     // VK_FORMAT_R16G16B16A16_SFLOAT
+  { 109U, Image::kRgba32f },        // VK_FORMAT_R32G32B32A32_SFLOAT
+  { 131U, Image::kDxt1 },           // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+  { 133U, Image::kDxt1Rgba },       // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+  { 137U, Image::kDxt5 },           // VK_FORMAT_BC3_UNORM_BLOCK
+  // KTX2 has no ETC1 format; ETC1 data is stored as ETC2, which is a superset.
+  { 147U, Image::kEtc1 },           // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+  { 1000054000U, Image::kPvrtc1Rgba2 },  // VK_FORMAT_PVRTC1_2BPP_UNORM_IMG
+  { 1000054001U, Image::kPvrtc1Rgba4 },  // VK_FORMAT_PVRTC1_4BPP_UNORM_IMG
+};
+
+// DXGI formats used by DDS files with a DX10 header.
+static const FormatMapping kDxgiFormats[] = {
+  { 2U, Image::kRgba32f },          // DXGI_FORMAT_R32G32B32A32_FLOAT
+  { 10U, Image::kRgba16fHalf },     // DXGI_FORMAT_R16G16B16A16_FLOAT
+  { 28U, Image::kRgba8888 },        // DXGI_FORMAT_R8G8B8A8_UNORM
+  { 29U, Image::kSrgba8 },          // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+  { 41U, Image::kR32f },            // DXGI_FORMAT_R32_FLOAT
+  { 61U, Image::kR8 },              // DXGI_FORMAT_R8_UNORM
+  { 71U, Image::kDxt1 },            // DXGI_FORMAT_BC1_UNORM
+  { 77U, Image::kDxt5 },            // DXGI_FORMAT_BC3_UNORM
+};
+
+//-----------------------------------------------------------------------------
+//
+// Helper functions.
+//
+//-----------------------------------------------------------------------------
+
+// The location of the images of a texture within a container.
+struct ContainerLayout {
+  ContainerLayout()
+      : format(Image::kInvalid),
+        width(0U),
+        height(0U),
+        face_count(1U),
+        level_count(1U) {}
+
+  Image::Format format;
+  uint32 width;
+  uint32 height;
+  uint32 face_count;
+  uint32 level_count;
+  // The offset and size in bytes of each image, indexed by face * level_count
+  // + level, with faces in file order.
+  std::vector<std::pair<size_t, size_t> > ranges;
+};
+
+// Creates the DataContainer for the |length| bytes at |offset| of a container.
+typedef std::function<base::DataContainerPtr(size_t offset, size_t length)>
+    ContainerDataFactory;
+
+static uint32 ReadUint32(const uint8* data, size_t offset, bool swap) {
+  uint32 value;
+  memcpy(&value, data + offset, sizeof(value));
+  return swap ? bswap_32(value) : value;
+}
+
+static uint64 ReadUint64(const uint8* data, size_t offset) {
+  uint64 value;
+  memcpy(&value, data + offset, sizeof(value));
+  return value;
+}
+
+// Returns whether [offset, offset + length) lies within |size| bytes.
+static bool IsRangeInside(uint64 offset, uint64 length, size_t size) {
+  return offset <= size && length <= size - offset;
+}
+
+static Image::Format FindFormat(const FormatMapping* mappings, size_t count,
+                                uint32 code) {
+  for (size_t i = 0; i < count; ++i) {
+    if (mappings[i].code == code)
+      return mappings[i].format;
+  }
+  return Image::kInvalid;
+}
+
+// Returns the Image format with the GL formats used by a KTX file. Compressed
+// formats only have an internal format, since their GL type and format are 0.
+static Image::Format FindGlFormat(uint32 gl_internal_format, uint32 gl_format,
+                                  uint32 gl_type) {
+  const bool is_compressed = gl_type == 0U;
+  for (uint32 i = 0; i < Image::kNumFormats; ++i) {
+    const Image::Format format = static_cast<Image::Format>(i);
+    if (Image::IsCompressedFormat(format) != is_compressed)
+      continue;
+    const Image::PixelFormat& pf = Image::GetPixelFormat(format);
+    if (pf.internal_format == gl_internal_format &&
+        (is_compressed || (pf.format == gl_format && pf.type == gl_type)))
+      return format;
+  }
+  return Image::kInvalid;
+}
+
+// Returns the size of mipmap |level| of a texture whose base level is |size|.
+static uint32 GetLevelSize(uint32 size, uint32 level) {
+  return std::max(size >> level, 1U);
+}
+
+// Returns the number of bytes of mipmap |level| of |layout|. Since
+// Image::ComputeDataSize() computes in 32 bits, which a malformed header could
+// wrap, this adds up the sizes of strips of rows small enough not to. The strip
+// height is a multiple of every block height, so no block straddles two strips.
+static uint64 GetLevelDataSize(const ContainerLayout& layout, uint32 level) {
+  static const uint32 kStripHeight = 120U;
+  const uint32 width = GetLevelSize(layout.width, level);
+  const uint32 height = GetLevelSize(layout.height, level);
+  const uint64 strip_size =
+      Image::ComputeDataSize(layout.format, width, kStripHeight);
+  return (height / kStripHeight) * strip_size +
+         Image::ComputeDataSize(layout.format, width, height % kStripHeight);
+}
+
+// Checks the dimensions shared by all containers.
+static bool ValidateLayout(const char* container, ContainerLayout* layout) {
+  if (layout->format == Image::kInvalid) {
+    LOG(ERROR) << container << ": unsupported format.";
+    return false;
+  }
+  if (layout->width == 0U || layout->height == 0U ||
+      layout->width > kMaxDimension || layout->height > kMaxDimension) {
+    LOG(ERROR) << container << ": invalid size " << layout->width << "x"
+               << layout->height << ".";
+    return false;
+  }
+  if (layout->face_count != 1U && layout->face_count != 6U) {
+    LOG(ERROR) << container << ": unsupported face count "
+               << layout->face_count << ".";
+    return false;
+  }
+  // Ignore levels past 1x1.
+  uint32 max_levels = 1U;
+  while ((std::max(layout->width, layout->height) >> max_levels) != 0U)
+    ++max_levels;
+  if (layout->level_count == 0U || layout->level_count > max_levels) {
+    LOG(ERROR) << container << ": invalid mipmap level count "
+               << layout->level_count << ".";
+    return false;
+  }
+  return true;
+}
+
+// Fills |layout| from a KTX file.
+static bool ParseKtx(const uint8* data, size_t data_size,
+                     ContainerLayout* layout) {
+  if (data_size < kKtxHeaderSize) {
+    LOG(ERROR) << "KTX: truncated header.";
+    return false;
+  }
+  const uint32 endianness = ReadUint32(data, 12U, false);
+  const bool swap = endianness != kKtxEndianness;
+  if (swap && bswap_32(endianness) != kKtxEndianness) {
+    LOG(ERROR) << "KTX: invalid endianness.";
+    return false;
+  }
+  const uint32 gl_type = ReadUint32(data, 16U, swap);
+  const uint32 gl_type_size = ReadUint32(data, 20U, swap);
+  const uint32 gl_format = ReadUint32(data, 24U, swap);
+  const uint32 gl_internal_format = ReadUint32(data, 28U, swap);
+  const uint32 depth = ReadUint32(data, 44U, swap);
+  const uint32 array_elements = ReadUint32(data, 48U, swap);
+  const uint32 key_value_size = ReadUint32(data, 60U, swap);
+  layout->format = FindGlFormat(gl_internal_format, gl_format, gl_type);
+  layout->width = ReadUint32(data, 36U, swap);
+  // 1D textures have a height of 0.
+  layout->height = std::max(ReadUint32(data, 40U, swap), 1U);
+  layout->face_count = ReadUint32(data, 52U, swap);
+  // A level count of 0 asks the loader to generate mipmaps.
+  layout->level_count = std::max(ReadUint32(data, 56U, swap), 1U);
+  if (depth != 0U || array_elements != 0U) {
+    LOG(ERROR) << "KTX: array and 3D textures are not supported.";
+    return false;
+  }
+  if (swap && gl_type_size > 1U) {
+    LOG(ERROR) << "KTX: data of the wrong endianness is not supported.";
+    return false;
+  }
+  if (!ValidateLayout("KTX", layout))
+    return false;
+
+  // Each level is preceded by its size, and each face is padded to 4 bytes.
+  uint64 offset = kKtxHeaderSize + static_cast<uint64>(key_value_size);
+  layout->ranges.resize(layout->face_count * layout->level_count);
+  for (uint32 level = 0; level < layout->level_count; ++level) {
+    if (!IsRangeInside(offset, 4U, data_size)) {
+      LOG(ERROR) << "KTX: truncated data.";
+      return false;
+    }
+    const uint32 image_size =
+        ReadUint32(data, static_cast<size_t>(offset), swap);
+    offset += 4U;
+    const uint64 level_size = GetLevelDataSize(*layout, level);
+    if (image_size != level_size) {
+      LOG(ERROR) << "KTX: level " << level << " has " << image_size
+                 << " bytes instead of " << level_size
+                 << "; padded rows are not supported.";
+      return false;
+    }
+    for (uint32 face = 0; face < layout->face_count; ++face) {
+      if (!IsRangeInside(offset, level_size, data_size)) {
+        LOG(ERROR) << "KTX: truncated data.";
+        return false;
+      }
+      layout->ranges[face * layout->level_count + level] =
+          std::make_pair(static_cast<size_t>(offset),
+                         static_cast<size_t>(level_size));
+      offset += (level_size + 3U) & ~static_cast<uint64>(3U);
+    }
+  }
+  return true;
+}
+
+// Fills |layout| from a KTX2 file.
+static bool ParseKtx2(const uint8* data, size_t data_size,
+                      ContainerLayout* layout) {
+  if (data_size < kKtx2HeaderSize) {
+    LOG(ERROR) << "KTX2: truncated header.";
+    return false;
+  }
+  const uint32 vk_format = ReadUint32(data, 12U, false);
+  const uint32 depth = ReadUint32(data, 28U, false);
+  const uint32 layers = ReadUint32(data, 32U, false);
+  const uint32 supercompression = ReadUint32(data, 44U, false);
+  layout->format = FindFormat(kVkFormats, ARRAYSIZE(kVkFormats), vk_format);
+  layout->width = ReadUint32(data, 20U, false);
+  layout->height = std::max(ReadUint32(data, 24U, false), 1U);
+  layout->face_count = ReadUint32(data, 36U, false);
+  layout->level_count = std::max(ReadUint32(data, 40U, false), 1U);
+  if (depth != 0U || layers != 0U) {
+    LOG(ERROR) << "KTX2: array and 3D textures are not supported.";
+    return false;
+  }
+  if (supercompression != 0U) {
+    LOG(ERROR) << "KTX2: supercompression scheme " << supercompression
+               << " is not supported.";
+    return false;
+  }
+  if (!ValidateLayout("KTX2", layout))
+    return false;
+  if (!IsRangeInside(kKtx2HeaderSize,
+                     layout->level_count * kKtx2LevelIndexEntrySize,
+                     data_size)) {
+    LOG(ERROR) << "KTX2: truncated level index.";
+    return false;
+  }
+
+  // The level index holds the offset and size of each level, whose faces are
+  // stored one after another.
+  layout->ranges.resize(layout->face_count * layout->level_count);
+  for (uint32 level = 0; level < layout->level_count; ++level) {
+    const size_t entry = kKtx2HeaderSize + level * kKtx2LevelIndexEntrySize;
+    const uint64 offset = ReadUint64(data, entry);
+    const uint64 length = ReadUint64(data, entry + 8U);
+    const uint64 level_size = GetLevelDataSize(*layout, level);
+    if (length != level_size * layout->face_count) {
+      LOG(ERROR) << "KTX2: level " << level << " has " << length
+                 << " bytes instead of " << level_size * layout->face_count
+                 << ".";
+      return false;
+    }
+    if (!IsRangeInside(offset, length, data_size)) {
+      LOG(ERROR) << "KTX2: truncated data.";
+      return false;
+    }
+    for (uint32 face = 0; face < layout->face_count; ++face) {
+      layout->ranges[face * layout->level_count + level] = std::make_pair(
+          static_cast<size_t>(offset + face * level_size),
+          static_cast<size_t>(level_size));
+    }
+  }
+  return true;
+}
+
+// Returns the format of a DDS file with a legacy pixel format.
+static Image::Format GetDdsFormat(const uint8* data) {
+  const uint32 flags = ReadUint32(data, 80U, false);
+  const uint32 bit_count = ReadUint32(data, 88U, false);
+  const uint32 red_mask = ReadUint32(data, 92U, false);
+  const uint32 green_mask = ReadUint32(data, 96U, false);
+  const uint32 blue_mask = ReadUint32(data, 100U, false);
+  const uint32 alpha_mask = ReadUint32(data, 104U, false);
+  if (flags & kDdsPixelFormatFourCc) {
+    const uint32 four_cc = ReadUint32(data, 84U, false);
+    if (four_cc == kDdsFourCcDxt1) {
+      return (flags & kDdsPixelFormatAlphaPixels) ? Image::kDxt1Rgba
+                                                  : Image::kDxt1;
+    } else if (four_cc == kDdsFourCcDxt5) {
+      return Image::kDxt5;
+    }
+  } else if (flags & kDdsPixelFormatRgb) {
+    // Only RGB(A) byte order is supported, not BGR(A).
+    if (red_mask == 0xffU && green_mask == 0xff00U &&
+        blue_mask == 0xff0000U) {
+      if (bit_count == 32U && alpha_mask == 0xff000000U &&
+          (flags & kDdsPixelFormatAlphaPixels))
+        return Image::kRgba8888;
+      else if (bit_count == 24U)
+        return Image::kRgb888;
+    }
+  } else if (flags & kDdsPixelFormatLuminance) {
+    if (bit_count == 8U)
+      return Image::kLuminance;
+  } else if (flags & kDdsPixelFormatAlpha) {
+    if (bit_count == 8U)
+      return Image::kAlpha;
+  }
+  return Image::kInvalid;
+}
+
+// Fills |layout| from a DDS file.
+static bool ParseDds(const uint8* data, size_t data_size,
+                     ContainerLayout* layout) {
+  if (data_size < kDdsDataOffset ||
+      ReadUint32(data, 4U, false) != kDdsHeaderSize) {
+    LOG(ERROR) << "DDS: truncated or invalid header.";
+    return false;
+  }
+  const uint32 flags = ReadUint32(data, 8U, false);
+  const uint32 caps2 = ReadUint32(data, 112U, false);
+  layout->height = ReadUint32(data, 12U, false);
+  layout->width = ReadUint32(data, 16U, false);
+  layout->level_count = (flags & kDdsMipmapCountFlag) ?
+      std::max(ReadUint32(data, 28U, false), 1U) : 1U;
+  if (caps2 & kDdsCaps2Volume) {
+    LOG(ERROR) << "DDS: 3D textures are not supported.";
+    return false;
+  }
+  bool is_cube_map = (caps2 & kDdsCaps2CubeMap) != 0U;
+  if (is_cube_map && (caps2 & kDdsCaps2AllFaces) != kDdsCaps2AllFaces) {
+    LOG(ERROR) << "DDS: cube maps must have all six faces.";
+    return false;
+  }
+
+  size_t offset = kDdsDataOffset;
+  if ((ReadUint32(data, 80U, false) & kDdsPixelFormatFourCc) &&
+      ReadUint32(data, 84U, false) == kDdsFourCcDx10) {
+    if (data_size < kDdsDataOffset + kDdsDx10HeaderSize) {
+      LOG(ERROR) << "DDS: truncated DX10 header.";
+      return false;
+    }
+    const uint32 dxgi_format = ReadUint32(data, offset, false);
+    const uint32 dimension = ReadUint32(data, offset + 4U, false);
+    const uint32 misc_flags = ReadUint32(data, offset + 8U, false);
+    const uint32 array_size = ReadUint32(data, offset + 12U, false);
+    if (dimension != kDx10Texture2d || array_size > 1U) {
+      LOG(ERROR) << "DDS: only 2D and cube map textures are supported.";
+      return false;
+    }
+    is_cube_map = (misc_flags & kDx10TextureCube) != 0U;
+    layout->format =
+        FindFormat(kDxgiFormats, ARRAYSIZE(kDxgiFormats), dxgi_format);
+    offset += kDdsDx10HeaderSize;
+  } else {
+    layout->format = GetDdsFormat(data);
+  }
+  layout->face_count = is_cube_map ? 6U : 1U;
+  if (!ValidateLayout("DDS", layout))
+    return false;
+
+  // Each face is stored with all of its levels.
+  layout->ranges.resize(layout->face_count * layout->level_count);
+  for (uint32 face = 0; face < layout->face_count; ++face) {
+    for (uint32 level = 0; level < layout->level_count; ++level) {
+      const uint64 level_size = GetLevelDataSize(*layout, level);
+      if (!IsRangeInside(offset, level_size, data_size)) {
+        LOG(ERROR) << "DDS: truncated data.";
+        return false;
+      }
+      const size_t size = static_cast<size_t>(level_size);
+      layout->ranges[face * layout->level_count + level] =
+          std::make_pair(offset, size);
+      offset += size;
+    }
+  }
+  return true;
+}
+
+// Parses the container in |data| and creates its images using |factory|.
+static bool ReadContainer(const uint8* data, size_t data_size,
+                          const ContainerDataFactory& factory,
+                          const base::AllocatorPtr& allocator,
+                          TextureContainerImages* images) {
+  DCHECK(images);
+  images->faces.clear();
+  if (!data || data_size < sizeof(kKtxIdentifier)) {
+    LOG(ERROR) << "Texture container data is too small.";
+    return false;
+  }
+  ContainerLayout layout;
+  bool parsed;
+  if (memcmp(data, kKtxIdentifier, sizeof(kKtxIdentifier)) == 0) {
+    parsed = ParseKtx(data, data_size, &layout);
+  } else if (memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0) {
+    parsed = ParseKtx2(data, data_size, &layout);
+  } else if (ReadUint32(data, 0U, false) == kDdsMagic) {
+    parsed = ParseDds(data, data_size, &layout);
+  } else {
+    LOG(ERROR) << "Unknown texture container format.";
+    return false;
+  }
+  if (!parsed)
+    return false;
+
+  images->faces.resize(layout.face_count);
+  for (uint32 file_face = 0; file_face < layout.face_count; ++file_face) {
+    std::vector<ImagePtr>& levels = images->faces[
+        layout.face_count == 6U ? kFileFaceOrder[file_face] : 0U];
+    levels.resize(layout.level_count);
+    for (uint32 level = 0; level < layout.level_count; ++level) {
+      const std::pair<size_t, size_t>& range =
+          layout.ranges[file_face * layout.level_count + level];
+      base::DataContainerPtr container = factory(range.first, range.second);
+      if (!container.Get()) {
+        images->faces.clear();
+        return false;
+      }
+      levels[level].Reset(new(allocator) Image);
+      levels[level]->Set(layout.format, GetLevelSize(layout.width, level),
+                         GetLevelSize(layout.height, level), container);
+    }
+  }
+  return true;
+}
+
+// Returns the size in bytes of the values of |gl_type| that are swapped when
+// the endianness of a KTX file differs from that of the platform.
+static uint32 GetGlTypeSize(uint32 gl_type) {
+  switch (gl_type) {
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+      return 2U;
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_10F_11F_11F_REV:
+    case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+      return 4U;
+    default:
+      return 1U;
+  }
+}
+
+// Returns the unsized GL format of the components of |format|, which KTX
+// stores as the base internal format.
+static uint32 GetGlBaseInternalFormat(Image::Format format) {
+  if (!Image::IsCompressedFormat(format))
+    return Image::GetPixelFormat(format).format;
+  switch (Image::GetNumComponentsForFormat(format)) {
+    case 1:
+      return GL_RED;
+    case 2:
+      return GL_RG;
+    case 3:
+      return GL_RGB;
+    default:
+      return GL_RGBA;
+  }
+}
+
+static void AppendUint32(uint32 value, std::vector<uint8>* data) {
+  const uint8* bytes = reinterpret_cast<const uint8*>(&value);
+  data->insert(data->end(), bytes, bytes + sizeof(value));
+}
+
+// Checks that |images| can be written to a KTX file, and returns their layout
+// in |layout|, without ranges.
+static bool ValidateImagesForKtx(const TextureContainerImages& images,
+                                 ContainerLayout* layout) {
+  if (images.faces.size() != 1U && images.faces.size() != 6U) {
+    LOG(ERROR) << "KTX: unsupported face count " << images.faces.size()
+               << ".";
+    return false;
+  }
+  const std::vector<ImagePtr>& base_levels = images.faces[0];
+  if (base_levels.empty() || !base_levels[0].Get()) {
+    LOG(ERROR) << "KTX: no images to write.";
+    return false;
+  }
+  layout->format = base_levels[0]->GetFormat();
+  layout->width = base_levels[0]->GetWidth();
+  layout->height = base_levels[0]->GetHeight();
+  layout->face_count = static_cast<uint32>(images.faces.size());
+  layout->level_count = static_cast<uint32>(base_levels.size());
+  if (!ValidateLayout("KTX", layout))
+    return false;
+  const Image::PixelFormat& pf = Image::GetPixelFormat(layout->format);
+  if (pf.internal_format == 0U || layout->format == Image::kEglImage) {
+    LOG(ERROR) << "KTX: format "
+               << Image::GetFormatString(layout->format)
+               << " has no GL internal format.";
+    return false;
+  }
+  const bool is_compressed = Image::IsCompressedFormat(layout->format);
+  for (uint32 face = 0; face < layout->face_count; ++face) {
+    const std::vector<ImagePtr>& levels = images.faces[face];
+    if (levels.size() != layout->level_count) {
+      LOG(ERROR) << "KTX: all faces must have the same number of levels.";
+      return false;
+    }
+    for (uint32 level = 0; level < layout->level_count; ++level) {
+      const Image* image = levels[level].Get();
+      const uint32 width = GetLevelSize(layout->width, level);
+      const uint32 height = GetLevelSize(layout->height, level);
+      if (!image || image->GetFormat() != layout->format ||
+          image->GetWidth() != width || image->GetHeight() != height) {
+        LOG(ERROR) << "KTX: face " << face << " level " << level
+                   << " must be a " << width << "x" << height << " "
+                   << Image::GetFormatString(layout->format) << " image.";
+        return false;
+      }
+      if (!image->GetData().Get() || !image->GetData()->GetData() ||
+          image->GetDataSize() != GetLevelDataSize(*layout, level)) {
+        LOG(ERROR) << "KTX: face " << face << " level " << level
+                   << " has no data.";
+        return false;
+      }
+      if (!is_compressed &&
+          Image::ComputeDataSize(layout->format, width, 1U) % 4U != 0U) {
+        LOG(ERROR) << "KTX: level " << level
+                   << " needs padded rows, which are not supported.";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Returns the maximum mipmap level to set on a texture whose base image has
+// |image| and that holds |level_count| levels, or -1 if the chain is complete.
+static int GetMaxLevel(const Image& image, size_t level_count) {
+  const uint32 size = std::max(image.GetWidth(), image.GetHeight());
+  return (size >> (level_count - 1U)) > 1U ?
+      static_cast<int>(level_count) - 1 : -1;
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// Public functions.
+//
+//-----------------------------------------------------------------------------
+
+bool IsTextureContainerData(const void* data, size_t data_size) {
+  const uint8* bytes = static_cast<const uint8*>(data);
+  if (!bytes || data_size < sizeof(kKtxIdentifier))
+    return false;
+  return memcmp(bytes, kKtxIdentifier, sizeof(kKtxIdentifier)) == 0 ||
+      memcmp(bytes, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0 ||
+      ReadUint32(bytes, 0U, false) == kDdsMagic;
+}
+
+bool ReadTextureContainer(const void* data, size_t data_size, bool is_wipeable,
+                          const base::AllocatorPtr& allocator,
+                          TextureContainerImages* images) {
+  const uint8* bytes = static_cast<const uint8*>(data);
+  return ReadContainer(
+      bytes, data_size,
+      [bytes, is_wipeable, &allocator](size_t offset, size_t length) {
+        return base::DataContainer::CreateAndCopy<uint8>(
+            bytes + offset, length, is_wipeable, allocator);
+      },
+      allocator, images);
+}
+
+bool ReadTextureContainer(const base::DataContainer::MappedFilePtr& file,
+                          bool is_wipeable,
+                          const base::AllocatorPtr& allocator,
+                          TextureContainerImages* images) {
+  if (!file || !file->GetData()) {
+    LOG(ERROR) << "Unable to read a texture container from an unmapped file.";
+    images->faces.clear();
+    return false;
+  }
+  return ReadContainer(
+      static_cast<const uint8*>(file->GetData()), file->GetLength(),
+      [&file, is_wipeable, &allocator](size_t offset, size_t length) {
+        return base::DataContainer::CreateFromMappedFile(
+            file, offset, length, is_wipeable, allocator);
+      },
+      allocator, images);
+}
+
+const std::vector<uint8> WriteKtxContainer(
+    const TextureContainerImages& images) {
+  std::vector<uint8> data;
+  ContainerLayout layout;
+  if (!ValidateImagesForKtx(images, &layout))
+    return data;
+
+  const Image::PixelFormat& pf = Image::GetPixelFormat(layout.format);
+  const bool is_compressed = Image::IsCompressedFormat(layout.format);
+  const uint32 gl_type = is_compressed ? 0U : pf.type;
+  data.insert(data.end(), kKtxIdentifier,
+              kKtxIdentifier + sizeof(kKtxIdentifier));
+  AppendUint32(kKtxEndianness, &data);
+  AppendUint32(gl_type, &data);
+  AppendUint32(is_compressed ? 1U : GetGlTypeSize(gl_type), &data);
+  AppendUint32(is_compressed ? 0U : pf.format, &data);
+  AppendUint32(pf.internal_format, &data);
+  AppendUint32(GetGlBaseInternalFormat(layout.format), &data);
+  AppendUint32(layout.width, &data);
+  AppendUint32(layout.height, &data);
+  AppendUint32(0U, &data);  // Depth.
+  AppendUint32(0U, &data);  // Array elements.
+  AppendUint32(layout.face_count, &data);
+  AppendUint32(layout.level_count, &data);
+  AppendUint32(0U, &data);  // Key/value data size.
+  DCHECK_EQ(kKtxHeaderSize, data.size());
+
+  // Each level is preceded by the size of one face, and each face is padded
+  // to 4 bytes.
+  for (uint32 level = 0; level < layout.level_count; ++level) {
+    const size_t level_size = GetLevelDataSize(layout, level);
+    AppendUint32(static_cast<uint32>(level_size), &data);
+    for (uint32 file_face = 0; file_face < layout.face_count; ++file_face) {
+      const Image& image = *images.faces[
+          layout.face_count == 6U ? kFileFaceOrder[file_face] : 0U][level];
+      const uint8* bytes = image.GetData()->GetData<uint8>();
+      data.insert(data.end(), bytes, bytes + level_size);
+      data.resize((data.size() + 3U) & ~static_cast<size_t>(3U), 0U);
+    }
+  }
+  return data;
+}
+
+const TexturePtr CreateTextureFromContainer(
+    const TextureContainerImages& images, const base::AllocatorPtr& allocator) {
+  TexturePtr texture;
+  if (images.faces.size() != 1U || images.faces[0].empty())
+    return texture;
+  const std::vector<ImagePtr>& levels = images.faces[0];
+  texture.Reset(new(allocator) Texture);
+  for (size_t level = 0; level < levels.size(); ++level)
+    texture->SetImage(level, levels[level]);
+  const int max_level = GetMaxLevel(*levels[0], levels.size());
+  if (max_level >= 0)
+    texture->SetMaxLevel(max_level);
+  return texture;
+}
+
+const CubeMapTexturePtr CreateCubeMapTextureFromContainer(
+    const TextureContainerImages& images, const base::AllocatorPtr& allocator) {
+  CubeMapTexturePtr texture;
+  if (!images.IsCubeMap() || images.faces[0].empty())
+    return texture;
+  texture.Reset(new(allocator) CubeMapTexture);
+  for (size_t face = 0; face < 6U; ++face) {
+    const std::vector<ImagePtr>& levels = images.faces[face];
+    for (size_t level = 0; level < levels.size(); ++level) {
+      texture->SetImage(static_cast<CubeMapTexture::CubeFace>(face), level,
+                        levels[level]);
+    }
+  }
+  const int max_level =
+      GetMaxLevel(*images.faces[0][0], images.faces[0].size());
+  if (max_level >= 0)
+    texture->SetMaxLevel(max_level);
+  return texture;
+}
+
+}  // namespace image
+}  // namespace ion
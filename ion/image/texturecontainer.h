@@ -0,0 +1,106 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_TEXTURECONTAINER_H_
+#define ION_IMAGE_TEXTURECONTAINER_H_
+
+// This file contains functions that read texture container files, which hold
+// the images of a texture, usually precompressed, with all of their mipmap
+// levels and cube map faces. The images can be uploaded as they are, so
+// shipped assets need no compression or conversion at load time. The
+// supported containers are:
+//  - KTX (version 1.1), for any format in gfx::Image that has a GL internal
+//    format. Uncompressed rows must not need padding to 4 bytes.
+//  - KTX2, without supercompression, for 8-bit R, RG, RGB and RGBA, half and
+//    float RGBA, BC1 (DXT1), BC3 (DXT5), ETC2 RGB (as kEtc1) and PVRTC1.
+//  - DDS, with either the legacy or the DX10 header, for DXT1, DXT5, 8-bit
+//    RGB(A), luminance and alpha, and a few DXGI formats.
+// KTX files can also be written, e.g., to cache textures generated at
+// runtime. Array and 3D textures are not supported. The images are stored in
+// the row order of the file, which for all of these containers is top row
+// first, so texture coordinates must be flipped vertically compared to images
+// decoded with ConvertFromExternalImageData(..., true, ...).
+
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/allocator.h"
+#include "ion/base/datacontainer.h"
+#include "ion/gfx/cubemaptexture.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/texture.h"
+
+namespace ion {
+namespace image {
+
+// The images read from a texture container.
+struct ION_API TextureContainerImages {
+  // Returns whether the container holds the six faces of a cube map.
+  bool IsCubeMap() const { return faces.size() == 6U; }
+
+  // The images of each face, indexed by mipmap level. There is a single face
+  // for a 2D texture, and six faces in gfx::CubeMapTexture::CubeFace order for
+  // a cube map.
+  std::vector<std::vector<gfx::ImagePtr> > faces;
+};
+
+// Returns true if |data| starts with the header of a supported texture
+// container.
+ION_API bool IsTextureContainerData(const void* data, size_t data_size);
+
+// Reads the texture container in |data| and returns its images in |images|.
+// The data of each image is copied into a DataContainer allocated from
+// |allocator|, which is wipeable if |is_wipeable| is set. Returns false, and
+// logs an error, if the container is invalid or its format is not supported.
+ION_API bool ReadTextureContainer(const void* data, size_t data_size,
+                                  bool is_wipeable,
+                                  const base::AllocatorPtr& allocator,
+                                  TextureContainerImages* images);
+
+// Same as above, but the data of each image points into the mapped |file|
+// without copying. The DataContainers keep the mapping alive until they are
+// destroyed, or wiped if |is_wipeable| is set.
+ION_API bool ReadTextureContainer(
+    const base::DataContainer::MappedFilePtr& file, bool is_wipeable,
+    const base::AllocatorPtr& allocator, TextureContainerImages* images);
+
+// Returns a KTX (version 1.1) file that holds |images|. Every face must have
+// the same number of levels, each an image with data of half the size of the
+// previous level, and all images must have the same format, which must have a
+// GL internal format. Uncompressed rows must not need padding to 4 bytes, as
+// when reading. Returns an empty vector, and logs an error, if any of this
+// does not hold.
+ION_API const std::vector<uint8> WriteKtxContainer(
+    const TextureContainerImages& images);
+
+// Returns a Texture that holds the mipmap levels of 2D |images|, or a NULL
+// pointer if |images| is empty or a cube map. If the mipmap chain stops short
+// of 1x1 the maximum level of the texture is set to the last level that is
+// present, so that it stays complete with mipmapped filtering.
+ION_API const gfx::TexturePtr CreateTextureFromContainer(
+    const TextureContainerImages& images, const base::AllocatorPtr& allocator);
+
+// Returns a CubeMapTexture that holds the faces and mipmap levels of cube map
+// |images|, or a NULL pointer if |images| is not a cube map. The maximum level
+// is set as in CreateTextureFromContainer().
+ION_API const gfx::CubeMapTexturePtr CreateCubeMapTextureFromContainer(
+    const TextureContainerImages& images, const base::AllocatorPtr& allocator);
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_TEXTURECONTAINER_H_
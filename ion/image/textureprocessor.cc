@@ -0,0 +1,451 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/textureprocessor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/sampler.h"
+#include "ion/gfx/shaderprogram.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/statetable.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfxutils/shapeutils.h"
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace image {
+
+using gfx::FramebufferObject;
+using gfx::FramebufferObjectPtr;
+using gfx::Image;
+using gfx::ImagePtr;
+using gfx::NodePtr;
+using gfx::TexturePtr;
+
+namespace {
+
+//-----------------------------------------------------------------------------
+//
+// Shader strings.
+//
+//-----------------------------------------------------------------------------
+
+static const char kVertexShaderString[] =
+    "attribute vec3 aVertex;\n"
+    "attribute vec2 aTexCoords;\n"
+    "varying vec2 vTextureCoords;\n"
+    "\n"
+    "void main(void) {\n"
+    "  vTextureCoords = aTexCoords;\n"
+    "  gl_Position = vec4(aVertex, 1.);\n"
+    "}\n";
+
+#define ION_FRAGMENT_SHADER_HEADER          \
+  "#ifdef GL_ES\n"                          \
+  "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"     \
+  "precision highp float;\n"                \
+  "#else\n"                                 \
+  "precision mediump float;\n"              \
+  "#endif\n"                                \
+  "#endif\n"                                \
+  "\n"                                      \
+  "uniform sampler2D uTexture;\n"           \
+  "varying vec2 vTextureCoords;\n"          \
+  "\n"
+
+// Averages uTaps x uTaps bilinear samples spread over uFootprint, the size of
+// an output pixel in texture coordinates.
+static const char kResizeFragmentShaderString[] =
+    ION_FRAGMENT_SHADER_HEADER
+    "uniform vec2 uFootprint;\n"
+    "uniform int uTaps;\n"
+    "\n"
+    "void main(void) {\n"
+    "  vec4 sum = vec4(0.);\n"
+    "  float taps = float(uTaps);\n"
+    "  for (int y = 0; y < 8; ++y) {\n"
+    "    if (y >= uTaps) break;\n"
+    "    for (int x = 0; x < 8; ++x) {\n"
+    "      if (x >= uTaps) break;\n"
+    "      vec2 offset = (vec2(float(x), float(y)) + .5) / taps - .5;\n"
+    "      sum += texture2D(uTexture, vTextureCoords + offset * uFootprint);\n"
+    "    }\n"
+    "  }\n"
+    "  gl_FragColor = sum / (taps * taps);\n"
+    "}\n";
+
+static const char kPremultiplyFragmentShaderString[] =
+    ION_FRAGMENT_SHADER_HEADER
+    "void main(void) {\n"
+    "  vec4 color = texture2D(uTexture, vTextureCoords);\n"
+    "  gl_FragColor = vec4(color.rgb * color.a, color.a);\n"
+    "}\n";
+
+// Each row of uSwizzle selects an input channel, and uSwizzleOffset supplies
+// the constant channels.
+static const char kSwizzleFragmentShaderString[] =
+    ION_FRAGMENT_SHADER_HEADER
+    "uniform mat4 uSwizzle;\n"
+    "uniform vec4 uSwizzleOffset;\n"
+    "\n"
+    "void main(void) {\n"
+    "  gl_FragColor =\n"
+    "      uSwizzle * texture2D(uTexture, vTextureCoords) + uSwizzleOffset;\n"
+    "}\n";
+
+// Sums uRadius taps on each side along uStep, one texel in texture
+// coordinates, weighted by a Gaussian of standard deviation uSigma texels.
+static const char kBlurFragmentShaderString[] =
+    ION_FRAGMENT_SHADER_HEADER
+    "uniform vec2 uStep;\n"
+    "uniform float uSigma;\n"
+    "uniform int uRadius;\n"
+    "\n"
+    "void main(void) {\n"
+    "  vec4 sum = texture2D(uTexture, vTextureCoords);\n"
+    "  float total = 1.;\n"
+    "  float scale = -.5 / (uSigma * uSigma);\n"
+    "  for (int i = 1; i <= 16; ++i) {\n"
+    "    if (i > uRadius) break;\n"
+    "    float x = float(i);\n"
+    "    float weight = exp(x * x * scale);\n"
+    "    sum += weight * (texture2D(uTexture, vTextureCoords + x * uStep) +\n"
+    "                     texture2D(uTexture, vTextureCoords - x * uStep));\n"
+    "    total += 2. * weight;\n"
+    "  }\n"
+    "  gl_FragColor = sum / total;\n"
+    "}\n";
+
+#undef ION_FRAGMENT_SHADER_HEADER
+
+//-----------------------------------------------------------------------------
+//
+// Helper functions.
+//
+//-----------------------------------------------------------------------------
+
+// Returns the image at |level| of |texture|, or a NULL pointer.
+static const ImagePtr GetLevelImage(const TexturePtr& texture, size_t level) {
+  return texture.Get() && texture->HasImage(level) ? texture->GetImage(level)
+                                                   : ImagePtr();
+}
+
+// Returns the row of a swizzle matrix that selects |channel|, and sets
+// |offset| to the constant to add.
+static const math::Vector4f GetSwizzleRow(TextureProcessor::Channel channel,
+                                          float* offset) {
+  math::Vector4f row = math::Vector4f::Zero();
+  *offset = channel == TextureProcessor::kOne ? 1.f : 0.f;
+  if (channel <= TextureProcessor::kAlpha)
+    row[channel] = 1.f;
+  return row;
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// TextureProcessor functions.
+//
+//-----------------------------------------------------------------------------
+
+TextureProcessor::TextureProcessor(const gfx::RendererPtr& renderer)
+    : renderer_(renderer) {
+  DCHECK(renderer_.Get());
+}
+
+TextureProcessor::~TextureProcessor() {}
+
+const TexturePtr TextureProcessor::CreateTargetTexture(
+    uint32 width, uint32 height, Image::Format format,
+    const base::AllocatorPtr& allocator) {
+  const base::AllocatorPtr& al =
+      base::AllocationManager::GetNonNullAllocator(allocator);
+  ImagePtr image(new (al) Image);
+  image->Set(format, width, height, base::DataContainerPtr());
+  gfx::SamplerPtr sampler(new (al) gfx::Sampler);
+  sampler->SetMinFilter(gfx::Sampler::kLinear);
+  sampler->SetMagFilter(gfx::Sampler::kLinear);
+  sampler->SetWrapS(gfx::Sampler::kClampToEdge);
+  sampler->SetWrapT(gfx::Sampler::kClampToEdge);
+  TexturePtr texture(new (al) gfx::Texture);
+  texture->SetImage(0U, image);
+  texture->SetSampler(sampler);
+  return texture;
+}
+
+bool TextureProcessor::Resize(const TexturePtr& input,
+                              const TexturePtr& output) {
+  const ImagePtr input_image = GetLevelImage(input, 0U);
+  if (!input_image.Get() || !AttachOutput(output, 0U))
+    return false;
+  RenderResizePass(input, input_image->GetWidth(), input_image->GetHeight(),
+                   fbo_->GetWidth(), fbo_->GetHeight());
+  return true;
+}
+
+bool TextureProcessor::Premultiply(const TexturePtr& input,
+                                   const TexturePtr& output) {
+  if (!GetLevelImage(input, 0U).Get() || !AttachOutput(output, 0U))
+    return false;
+  RenderPass(GetPassNode(kPremultiplyPass), input, fbo_);
+  return true;
+}
+
+bool TextureProcessor::Swizzle(const TexturePtr& input, Channel red,
+                               Channel green, Channel blue, Channel alpha,
+                               const TexturePtr& output) {
+  if (!GetLevelImage(input, 0U).Get() || !AttachOutput(output, 0U))
+    return false;
+  math::Vector4f offset;
+  const math::Vector4f r = GetSwizzleRow(red, &offset[0]);
+  const math::Vector4f g = GetSwizzleRow(green, &offset[1]);
+  const math::Vector4f b = GetSwizzleRow(blue, &offset[2]);
+  const math::Vector4f a = GetSwizzleRow(alpha, &offset[3]);
+  const math::Matrix4f swizzle(r[0], r[1], r[2], r[3],
+                               g[0], g[1], g[2], g[3],
+                               b[0], b[1], b[2], b[3],
+                               a[0], a[1], a[2], a[3]);
+  const NodePtr& node = GetPassNode(kSwizzlePass);
+  node->SetUniformByName("uSwizzle", swizzle);
+  node->SetUniformByName("uSwizzleOffset", offset);
+  RenderPass(node, input, fbo_);
+  return true;
+}
+
+bool TextureProcessor::Blur(const TexturePtr& input, float sigma,
+                            const TexturePtr& output) {
+  const ImagePtr output_image = GetLevelImage(output, 0U);
+  if (!GetLevelImage(input, 0U).Get() || !output_image.Get())
+    return false;
+  const uint32 width = output_image->GetWidth();
+  const uint32 height = output_image->GetHeight();
+  const int radius =
+      sigma > 0.f ? std::min(16, static_cast<int>(std::ceil(3.f * sigma))) : 0;
+  const NodePtr& node = GetPassNode(kBlurPass);
+  node->SetUniformByName("uSigma", std::max(sigma, 1e-3f));
+  node->SetUniformByName("uRadius", radius);
+
+  // Blur horizontally into a transient framebuffer of the output's size.
+  const FramebufferObjectPtr intermediate =
+      renderer_->AcquireTransientFramebuffer(
+          width, height, output_image->GetFormat(), Image::kInvalid, 0U);
+  const TexturePtr intermediate_texture =
+      intermediate->GetColorAttachment(0U).GetTexture();
+  if (!intermediate_texture.Get())
+    return false;
+  node->SetUniformByName("uStep",
+                         math::Vector2f(1.f / static_cast<float>(width), 0.f));
+  RenderPass(node, input, intermediate);
+
+  // Then vertically into the output.
+  if (!AttachOutput(output, 0U))
+    return false;
+  node->SetUniformByName("uStep",
+                         math::Vector2f(0.f, 1.f / static_cast<float>(height)));
+  RenderPass(node, intermediate_texture, fbo_);
+  return true;
+}
+
+bool TextureProcessor::GenerateMipmaps(const TexturePtr& texture) {
+  const ImagePtr image0 = GetLevelImage(texture, 0U);
+  if (!image0.Get())
+    return false;
+  const gfx::GraphicsManagerPtr& gm = renderer_->GetGraphicsManager();
+  if (gm->GetGlVersion() <= 20) {
+    LOG(WARNING) << "Rendering mipmaps requires texture base and max levels, "
+                 << "which this OpenGL does not support.";
+    return false;
+  }
+
+  const int base_level = texture->GetBaseLevel();
+  const int max_level = texture->GetMaxLevel();
+  uint32 width = image0->GetWidth();
+  uint32 height = image0->GetHeight();
+  for (size_t level = 1U; width > 1U || height > 1U; ++level) {
+    const uint32 input_width = width;
+    const uint32 input_height = height;
+    width = std::max(1U, width / 2U);
+    height = std::max(1U, height / 2U);
+    const ImagePtr image = GetLevelImage(texture, level);
+    if (!image.Get() || image->GetWidth() != width ||
+        image->GetHeight() != height) {
+      ImagePtr level_image(new (texture->GetAllocator()) Image);
+      level_image->Set(image0->GetFormat(), width, height,
+                       base::DataContainerPtr());
+      texture->SetImage(level, level_image);
+    }
+    // Only sample the level above the one being rendered.
+    texture->SetBaseLevel(static_cast<int>(level) - 1);
+    texture->SetMaxLevel(static_cast<int>(level) - 1);
+    if (!AttachOutput(texture, level))
+      break;
+    RenderResizePass(texture, input_width, input_height, width, height);
+  }
+  texture->SetBaseLevel(base_level);
+  texture->SetMaxLevel(max_level);
+  return true;
+}
+
+const gfx::Renderer::ImageReadbackPtr TextureProcessor::ReadImageAsync(
+    const TexturePtr& texture, Image::Format format,
+    const base::AllocatorPtr& allocator) {
+  gfx::Renderer::ImageReadbackPtr readback;
+  if (AttachOutput(texture, 0U)) {
+    const FramebufferObjectPtr previous = renderer_->GetCurrentFramebuffer();
+    renderer_->BindFramebuffer(fbo_);
+    readback = renderer_->ReadImageAsync(
+        math::Range2i::BuildWithSize(
+            math::Point2i::Zero(),
+            math::Vector2i(fbo_->GetWidth(), fbo_->GetHeight())),
+        format, allocator);
+    renderer_->BindFramebuffer(previous);
+  }
+  return readback;
+}
+
+const NodePtr& TextureProcessor::GetPassNode(PassType type) {
+  NodePtr& node = nodes_[type];
+  if (node.Get())
+    return node;
+
+  const base::AllocatorPtr& al = GetAllocator();
+  if (!registry_.Get()) {
+    registry_.Reset(new (al) gfx::ShaderInputRegistry);
+    registry_->IncludeGlobalRegistry();
+    typedef gfx::ShaderInputRegistry::UniformSpec Spec;
+    registry_->Add(Spec("uTexture", gfx::kTextureUniform, "Input texture"));
+    registry_->Add(Spec("uFootprint", gfx::kFloatVector2Uniform,
+                        "Size of an output pixel in the input"));
+    registry_->Add(Spec("uTaps", gfx::kIntUniform, "Taps per axis"));
+    registry_->Add(Spec("uSwizzle", gfx::kMatrix4x4Uniform,
+                        "Input channel of each output channel"));
+    registry_->Add(Spec("uSwizzleOffset", gfx::kFloatVector4Uniform,
+                        "Constant output channels"));
+    registry_->Add(Spec("uStep", gfx::kFloatVector2Uniform,
+                        "Blur direction, one texel long"));
+    registry_->Add(Spec("uSigma", gfx::kFloatUniform,
+                        "Blur standard deviation"));
+    registry_->Add(Spec("uRadius", gfx::kIntUniform, "Blur taps per side"));
+  }
+
+  node.Reset(new (al) gfx::Node);
+  node->SetStateTable(gfx::StateTablePtr(new (al) gfx::StateTable));
+  gfxutils::RectangleSpec rect_spec;
+  rect_spec.allocator = al;
+  rect_spec.size.Set(2.f, 2.f);  // -1 to +1.
+  rect_spec.vertex_type = gfxutils::ShapeSpec::kPositionTexCoords;
+  node->AddShape(gfxutils::BuildRectangleShape(rect_spec));
+
+  static const char* kFragmentShaders[kNumPassTypes] = {
+      kResizeFragmentShaderString, kPremultiplyFragmentShaderString,
+      kSwizzleFragmentShaderString, kBlurFragmentShaderString };
+  static const char* kLabels[kNumPassTypes] = {
+      "Ion TextureProcessor resize", "Ion TextureProcessor premultiply",
+      "Ion TextureProcessor swizzle", "Ion TextureProcessor blur" };
+  node->SetLabel(kLabels[type]);
+  node->SetShaderProgram(gfx::ShaderProgram::BuildFromStrings(
+      kLabels[type], registry_, kVertexShaderString, kFragmentShaders[type],
+      al));
+  node->AddUniform(registry_->Create<gfx::Uniform>("uTexture", TexturePtr()));
+  switch (type) {
+    case kResizePass:
+      node->AddUniform(registry_->Create<gfx::Uniform>(
+          "uFootprint", math::Vector2f::Zero()));
+      node->AddUniform(registry_->Create<gfx::Uniform>("uTaps", 1));
+      break;
+    case kSwizzlePass:
+      node->AddUniform(registry_->Create<gfx::Uniform>(
+          "uSwizzle", math::Matrix4f::Identity()));
+      node->AddUniform(registry_->Create<gfx::Uniform>(
+          "uSwizzleOffset", math::Vector4f::Zero()));
+      break;
+    case kBlurPass:
+      node->AddUniform(registry_->Create<gfx::Uniform>(
+          "uStep", math::Vector2f::Zero()));
+      node->AddUniform(registry_->Create<gfx::Uniform>("uSigma", 1.f));
+      node->AddUniform(registry_->Create<gfx::Uniform>("uRadius", 0));
+      break;
+    default:
+      break;
+  }
+  return node;
+}
+
+bool TextureProcessor::AttachOutput(const TexturePtr& output, size_t level) {
+  const ImagePtr image = GetLevelImage(output, level);
+  if (!image.Get()) {
+    LOG(ERROR) << "TextureProcessor output texture has no image at level "
+               << level << ".";
+    return false;
+  }
+  if (!fbo_.Get()) {
+    fbo_.Reset(new (GetAllocator())
+                   FramebufferObject(image->GetWidth(), image->GetHeight()));
+    fbo_->SetLabel("Ion TextureProcessor");
+  } else if (fbo_->GetWidth() != image->GetWidth() ||
+             fbo_->GetHeight() != image->GetHeight()) {
+    fbo_->Resize(image->GetWidth(), image->GetHeight());
+  }
+  const FramebufferObject::Attachment& current = fbo_->GetColorAttachment(0U);
+  if (current.GetTexture().Get() != output.Get() ||
+      current.GetMipLevel() != level)
+    fbo_->SetColorAttachment(0U, FramebufferObject::Attachment(output, level));
+  return true;
+}
+
+void TextureProcessor::RenderPass(const NodePtr& node, const TexturePtr& input,
+                                  const FramebufferObjectPtr& fbo) {
+  const math::Vector2i size(static_cast<int>(fbo->GetWidth()),
+                            static_cast<int>(fbo->GetHeight()));
+  node->GetStateTable()->SetViewport(
+      math::Range2i::BuildWithSize(math::Point2i::Zero(), size));
+  node->SetUniformByName("uTexture", input);
+
+  const FramebufferObjectPtr previous = renderer_->GetCurrentFramebuffer();
+  renderer_->BindFramebuffer(fbo);
+  renderer_->DrawScene(node);
+  renderer_->BindFramebuffer(previous);
+}
+
+void TextureProcessor::RenderResizePass(const TexturePtr& input,
+                                        uint32 input_width,
+                                        uint32 input_height, uint32 width,
+                                        uint32 height) {
+  // Each bilinear tap averages two texels along each axis.
+  const float scale = std::max(
+      static_cast<float>(input_width) / static_cast<float>(width),
+      static_cast<float>(input_height) / static_cast<float>(height));
+  const int taps =
+      std::min(8, std::max(1, static_cast<int>(std::ceil(scale / 2.f))));
+  const NodePtr& node = GetPassNode(kResizePass);
+  node->SetUniformByName(
+      "uFootprint", math::Vector2f(1.f / static_cast<float>(width),
+                                   1.f / static_cast<float>(height)));
+  node->SetUniformByName("uTaps", taps);
+  RenderPass(node, input, fbo_);
+}
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,156 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_TEXTUREPROCESSOR_H_
+#define ION_IMAGE_TEXTUREPROCESSOR_H_
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/referent.h"
+#include "ion/gfx/framebufferobject.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/texture.h"
+
+namespace ion {
+namespace image {
+
+// A TextureProcessor runs image operations as fragment shader passes with a
+// Renderer, reading from one Texture and rendering into another, so that
+// images produced each frame (e.g., camera frames) can be processed without
+// leaving the GPU. Pixels only come back to the CPU through ReadImageAsync().
+//
+// The output of each operation is level 0 of a Texture whose Image sets the
+// size and format of the result; CreateTargetTexture() makes a suitable one,
+// which can be reused for every frame. The input and output of an operation
+// must be different Textures. Inputs are sampled through their own
+// Samplers, which should use linear filtering. The shader programs and the
+// framebuffer used to render are created once and reused by later calls.
+// A TextureProcessor must only be used on the thread that renders with its
+// Renderer, and changes the bound framebuffer only for the duration of a call.
+//
+// For example:
+//   TextureProcessorPtr processor(new TextureProcessor(renderer));
+//   TexturePtr small = TextureProcessor::CreateTargetTexture(
+//       320U, 240U, Image::kRgba8888, allocator);
+//   processor->Resize(camera_texture, small);
+//   processor->Swizzle(small, TextureProcessor::kBlue,
+//                      TextureProcessor::kGreen, TextureProcessor::kRed,
+//                      TextureProcessor::kOne, small_bgr);
+//   readback = processor->ReadImageAsync(small_bgr, Image::kRgba8888, al);
+class ION_API TextureProcessor : public base::Referent {
+ public:
+  // The sources of the channels of a Swizzle() output.
+  enum Channel {
+    kRed,
+    kGreen,
+    kBlue,
+    kAlpha,
+    kZero,
+    kOne,
+  };
+
+  explicit TextureProcessor(const gfx::RendererPtr& renderer);
+
+  // Returns a Texture with a width x height image of the passed format but no
+  // data, set up to be rendered into by this and sampled with linear
+  // filtering and clamped coordinates.
+  static const gfx::TexturePtr CreateTargetTexture(
+      uint32 width, uint32 height, gfx::Image::Format format,
+      const base::AllocatorPtr& allocator);
+
+  // Resamples |input| to the size of |output|. Each output pixel averages its
+  // footprint in |input| with up to 8x8 bilinear taps, so shrinking by large
+  // factors does not alias.
+  bool Resize(const gfx::TexturePtr& input, const gfx::TexturePtr& output);
+
+  // Writes |input| to |output| with its color channels multiplied by alpha.
+  bool Premultiply(const gfx::TexturePtr& input, const gfx::TexturePtr& output);
+
+  // Writes |input| to |output| with each channel taken from the passed source,
+  // e.g., kBlue, kGreen, kRed, kAlpha converts between RGBA and BGRA.
+  bool Swizzle(const gfx::TexturePtr& input, Channel red, Channel green,
+               Channel blue, Channel alpha, const gfx::TexturePtr& output);
+
+  // Writes |input| blurred with a Gaussian of standard deviation |sigma|
+  // output pixels to |output|, in a horizontal and a vertical pass. Up to 16
+  // taps are used on each side. This also smooths signed distance fields. The
+  // intermediate pass renders into a framebuffer from
+  // Renderer::AcquireTransientFramebuffer(). A non-positive |sigma| copies.
+  bool Blur(const gfx::TexturePtr& input, float sigma,
+            const gfx::TexturePtr& output);
+
+  // Renders each mipmap level of |texture| from the one above it, adding
+  // images for the levels that are missing, so that a rendered texture can be
+  // mipmapped without a round trip through the CPU. This requires OpenGL to
+  // support texture base and max levels (ES 3.0 or desktop OpenGL); otherwise
+  // it logs a warning and returns false.
+  bool GenerateMipmaps(const gfx::TexturePtr& texture);
+
+  // Starts reading level 0 of |texture| into an Image of |format| created with
+  // |allocator|, using Renderer::ReadImageAsync(). Returns a NULL pointer if
+  // the texture has no image.
+  const gfx::Renderer::ImageReadbackPtr ReadImageAsync(
+      const gfx::TexturePtr& texture, gfx::Image::Format format,
+      const base::AllocatorPtr& allocator);
+
+ protected:
+  // The destructor is protected because all base::Referent classes must have
+  // protected or private destructors.
+  ~TextureProcessor() override;
+
+ private:
+  // The operations that have their own shader program.
+  enum PassType {
+    kResizePass,
+    kPremultiplyPass,
+    kSwizzlePass,
+    kBlurPass,
+    kNumPassTypes
+  };
+
+  // Returns the Node that renders passes of |type|, building it if needed.
+  const gfx::NodePtr& GetPassNode(PassType type);
+  // Attaches |level| of |output| to the processor's framebuffer, returning
+  // false if that level has no image.
+  bool AttachOutput(const gfx::TexturePtr& output, size_t level);
+  // Renders |node| with |input| as its texture into |fbo|.
+  void RenderPass(const gfx::NodePtr& node, const gfx::TexturePtr& input,
+                  const gfx::FramebufferObjectPtr& fbo);
+  // Sets up and renders a resize pass from |input| into the framebuffer,
+  // which is |width| x |height|.
+  void RenderResizePass(const gfx::TexturePtr& input, uint32 input_width,
+                        uint32 input_height, uint32 width, uint32 height);
+
+  gfx::RendererPtr renderer_;
+  gfx::ShaderInputRegistryPtr registry_;
+  gfx::NodePtr nodes_[kNumPassTypes];
+  // Framebuffer whose color attachment is the current output.
+  gfx::FramebufferObjectPtr fbo_;
+
+  DISALLOW_COPY_AND_ASSIGN(TextureProcessor);
+};
+
+typedef base::ReferentPtr<TextureProcessor>::Type TextureProcessorPtr;
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_TEXTUREPROCESSOR_H_
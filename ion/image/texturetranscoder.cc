@@ -0,0 +1,272 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/image/texturetranscoder.h"
+
+#include <vector>
+
+#include "ion/base/allocationmanager.h"
+#include "ion/base/datacontainer.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/image/conversionutils.h"
+#include "ion/image/texturecontainer.h"
+
+namespace ion {
+namespace image {
+
+using gfx::Image;
+using gfx::ImagePtr;
+
+namespace {
+
+// FNV-1a parameters for storage keys.
+static const uint64 kHashSeed = 14695981039346656037ULL;
+static const uint64 kHashPrime = 1099511628211ULL;
+
+// Returns whether |value| is a power of two.
+static bool IsPowerOfTwo(uint32 value) {
+  return value && !(value & (value - 1U));
+}
+
+// Returns whether every pixel of a kRgba8888 image is opaque.
+static bool IsOpaque(const Image& image) {
+  const uint8* pixels = image.GetData()->GetData<uint8>();
+  const size_t count =
+      static_cast<size_t>(image.GetWidth()) * image.GetHeight();
+  for (size_t i = 0; i < count; ++i) {
+    if (pixels[4U * i + 3U] != 255U)
+      return false;
+  }
+  return true;
+}
+
+// Returns a copy of a kRgb888 or kRgba8888 image in the other of these
+// formats, dropping alpha or making it opaque.
+static const ImagePtr ChangeAlpha(const Image& image,
+                                  const base::AllocatorPtr& allocator) {
+  const bool add_alpha = image.GetFormat() == Image::kRgb888;
+  const size_t src_size = add_alpha ? 3U : 4U;
+  const size_t dst_size = add_alpha ? 4U : 3U;
+  const size_t count =
+      static_cast<size_t>(image.GetWidth()) * image.GetHeight();
+  base::DataContainerPtr data = base::DataContainer::CreateOverAllocated<uint8>(
+      count * dst_size, NULL, allocator);
+  const uint8* src = image.GetData()->GetData<uint8>();
+  uint8* dst = data->GetMutableData<uint8>();
+  for (size_t i = 0; i < count; ++i) {
+    dst[dst_size * i] = src[src_size * i];
+    dst[dst_size * i + 1U] = src[src_size * i + 1U];
+    dst[dst_size * i + 2U] = src[src_size * i + 2U];
+    if (add_alpha)
+      dst[dst_size * i + 3U] = 255U;
+  }
+  ImagePtr result(new (allocator) Image);
+  result->Set(add_alpha ? Image::kRgba8888 : Image::kRgb888, image.GetWidth(),
+              image.GetHeight(), data);
+  return result;
+}
+
+}  // anonymous namespace
+
+TextureTranscoder::TextureTranscoder(
+    const gfx::GraphicsManagerPtr& gm,
+    const gfx::ProgramBinaryCache::StoragePtr& storage,
+    base::TaskScheduler* scheduler, const base::AllocatorPtr& allocator)
+    : gm_(gm),
+      storage_(storage),
+      scheduler_(scheduler),
+      allocator_(base::AllocationManager::GetNonNullAllocator(allocator)),
+      cache_hit_count_(0U),
+      converted_count_(0U) {
+  DCHECK(gm_.Get());
+}
+
+TextureTranscoder::~TextureTranscoder() { Wait(); }
+
+Image::Format TextureTranscoder::SelectFormat(bool has_alpha, uint32 width,
+                                              uint32 height) const {
+  // PVRTC1 textures must be square with power-of-two sides, and the
+  // compressor needs at least two blocks in each direction.
+  const bool can_use_pvrtc =
+      width == height && width >= 8U && IsPowerOfTwo(width);
+  if (has_alpha) {
+    if (IsFormatSupported(Image::kDxt5))
+      return Image::kDxt5;
+    if (can_use_pvrtc && IsFormatSupported(Image::kPvrtc1Rgba2))
+      return Image::kPvrtc1Rgba2;
+    return Image::kRgba8888;
+  }
+  if (IsFormatSupported(Image::kDxt1))
+    return Image::kDxt1;
+  if (IsFormatSupported(Image::kEtc1))
+    return Image::kEtc1;
+  if (can_use_pvrtc && IsFormatSupported(Image::kPvrtc1Rgba2))
+    return Image::kPvrtc1Rgba2;
+  return Image::kRgb888;
+}
+
+const ImagePtr TextureTranscoder::Transcode(const std::string& key,
+                                            const ImagePtr& image) {
+  if (!image.Get() || !image->GetData().Get() ||
+      !image->GetData()->GetData() || image->GetDimensions() != Image::k2d)
+    return image;
+  // Compressed images that can be used as they are need no work.
+  if (image->IsCompressed() && IsFormatSupported(image->GetFormat()))
+    return image;
+
+  // Bring the source to 8-bit RGB(A), which the compressors read, decoding
+  // it if it is in another format.
+  ImagePtr source = image;
+  const Image::Format format = image->GetFormat();
+  if (format != Image::kRgb888 && format != Image::kRgba8888) {
+    const bool has_alpha = Image::GetNumComponentsForFormat(format) % 2 == 0;
+    source = ConvertImage(image, has_alpha ? Image::kRgba8888 : Image::kRgb888,
+                          true, allocator_, allocator_);
+    if (!source.Get()) {
+      LOG(WARNING) << "TextureTranscoder: unable to convert '" << key
+                   << "' from " << Image::GetFormatString(format);
+      return image;
+    }
+  }
+  const bool has_alpha =
+      source->GetFormat() == Image::kRgba8888 && !IsOpaque(*source);
+  const Image::Format target_format =
+      SelectFormat(has_alpha, source->GetWidth(), source->GetHeight());
+  if (target_format == format)
+    return image;
+  // Uncompressed results are cheap to make and no smaller than the source.
+  if (!Image::IsCompressedFormat(target_format))
+    return ConvertToFormat(source, target_format);
+
+  const std::string storage_key = GetStorageKey(key, target_format);
+  if (storage_.Get()) {
+    const ImagePtr cached = ReadCachedImage(storage_key, target_format);
+    if (cached.Get()) {
+      base::LockGuard guard(&mutex_);
+      ++cache_hit_count_;
+      return cached;
+    }
+  }
+
+  const ImagePtr result = ConvertToFormat(source, target_format);
+  if (!result.Get()) {
+    LOG(WARNING) << "TextureTranscoder: unable to transcode '" << key
+                 << "' to " << Image::GetFormatString(target_format);
+    return image;
+  }
+  {
+    base::LockGuard guard(&mutex_);
+    ++converted_count_;
+  }
+  if (storage_.Get()) {
+    TextureContainerImages images;
+    images.faces.resize(1U);
+    images.faces[0].push_back(result);
+    const std::vector<uint8> data = WriteKtxContainer(images);
+    if (!data.empty()) {
+      storage_->Write(storage_key,
+                      std::string(reinterpret_cast<const char*>(&data[0]),
+                                  data.size()));
+    }
+  }
+  return result;
+}
+
+void TextureTranscoder::TranscodeAsync(const std::string& key,
+                                       const ImagePtr& image,
+                                       const ImageCallback& callback) {
+  if (!scheduler_) {
+    const ImagePtr result = Transcode(key, image);
+    if (callback)
+      callback(result);
+    return;
+  }
+  scheduler_->Submit([this, key, image, callback]() {
+    const ImagePtr result = Transcode(key, image);
+    if (callback)
+      callback(result);
+  }, &pending_);
+}
+
+void TextureTranscoder::Wait() {
+  if (scheduler_)
+    scheduler_->Wait(&pending_);
+}
+
+size_t TextureTranscoder::GetCacheHitCount() const {
+  base::LockGuard guard(&mutex_);
+  return cache_hit_count_;
+}
+
+size_t TextureTranscoder::GetConvertedCount() const {
+  base::LockGuard guard(&mutex_);
+  return converted_count_;
+}
+
+const std::string TextureTranscoder::GetStorageKey(const std::string& key,
+                                                   Image::Format format) {
+  // The key is a hexadecimal hash, so that it can name a file.
+  uint64 hash = kHashSeed;
+  const std::string name = key + '\0' + Image::GetFormatString(format);
+  for (size_t i = 0; i < name.length(); ++i)
+    hash = (hash ^ static_cast<uint8>(name[i])) * kHashPrime;
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string storage_key = "texture_";
+  storage_key.resize(storage_key.length() + 16U, '0');
+  for (size_t i = storage_key.length(); i > 8U; --i, hash >>= 4)
+    storage_key[i - 1U] = kHexDigits[hash & 0xfU];
+  return storage_key;
+}
+
+bool TextureTranscoder::IsFormatSupported(Image::Format format) const {
+  return gm_->IsCompressedTextureFormatSupported(
+      Image::GetPixelFormat(format).internal_format);
+}
+
+const ImagePtr TextureTranscoder::ReadCachedImage(
+    const std::string& storage_key, Image::Format format) const {
+  std::string data;
+  if (!storage_->Read(storage_key, &data) || data.empty())
+    return ImagePtr();
+  TextureContainerImages images;
+  if (!ReadTextureContainer(data.data(), data.size(), true, allocator_,
+                            &images) ||
+      images.faces.size() != 1U || images.faces[0].empty() ||
+      images.faces[0][0]->GetFormat() != format)
+    return ImagePtr();
+  return images.faces[0][0];
+}
+
+const ImagePtr TextureTranscoder::ConvertToFormat(const ImagePtr& image,
+                                                  Image::Format format) const {
+  // The compressors read kRgb888 for kDxt1 and kEtc1, and kRgba8888 for the
+  // others, and the alpha of an opaque image may have been ignored.
+  const bool needs_alpha = format == Image::kDxt5 ||
+                           format == Image::kPvrtc1Rgba2 ||
+                           format == Image::kRgba8888;
+  ImagePtr source = image;
+  if (needs_alpha != (image->GetFormat() == Image::kRgba8888))
+    source = ChangeAlpha(*image, allocator_);
+  if (source->GetFormat() == format)
+    return source;
+  return ConvertImage(source, format, true, allocator_, allocator_,
+                      scheduler_);
+}
+
+}  // namespace image
+}  // namespace ion
@@ -0,0 +1,141 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_IMAGE_TEXTURETRANSCODER_H_
+#define ION_IMAGE_TEXTURETRANSCODER_H_
+
+#include <functional>
+#include <string>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/allocator.h"
+#include "ion/base/referent.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/image.h"
+#include "ion/gfx/programbinarycache.h"
+#include "ion/port/mutex.h"
+
+namespace ion {
+namespace image {
+
+// A TextureTranscoder converts source images to the most compact texture
+// format that the OpenGL implementation of a GraphicsManager supports, so that
+// applications do not need to choose between kDxt*, kEtc1 and kPvrtc1* for
+// each platform, or fall back to uncompressed formats. Compressing images is
+// slow, so the results are cached as KTX files in a storage, for example a
+// ProgramBinaryCache::FileStorage in a directory for each device, and later
+// requests for the same source and format read the cached image instead.
+//
+// The format is chosen by SelectFormat() from those that ConvertImage() can
+// compress to. Images in other compressed formats that can be decoded, such
+// as ETC2 or ASTC from a KTX2 file, are decoded first. Supercompressed
+// (e.g., Basis Universal) data is not supported; such sources must be
+// decoded by the application.
+//
+// Typical usage:
+//   TextureTranscoderPtr transcoder(new TextureTranscoder(
+//       gm, storage, &scheduler, allocator));
+//   transcoder->TranscodeAsync("textures/map.png@3", image,
+//       [texture](const gfx::ImagePtr& result) {
+//         texture->SetImage(0U, result);
+//       });
+class ION_API TextureTranscoder : public base::Referent {
+ public:
+  // Called with the transcoded image, or the source image if it could not be
+  // transcoded.
+  typedef std::function<void(const gfx::ImagePtr& image)> ImageCallback;
+
+  // Creates a transcoder that chooses formats supported by |gm|. Transcoded
+  // images are cached in |storage| if it is not NULL, and TranscodeAsync()
+  // runs on |scheduler|'s threads if it is not NULL. The images are allocated
+  // with |allocator|, or the default allocator if it is NULL.
+  TextureTranscoder(const gfx::GraphicsManagerPtr& gm,
+                    const gfx::ProgramBinaryCache::StoragePtr& storage,
+                    base::TaskScheduler* scheduler,
+                    const base::AllocatorPtr& allocator);
+
+  // Returns the format that a width x height image with or without alpha is
+  // transcoded to: kDxt5 or kPvrtc1Rgba2 for images with alpha, kDxt1, kEtc1
+  // or kPvrtc1Rgba2 for those without, in that order of preference, or
+  // kRgba8888 or kRgb888 if none of them is supported. PVRTC is only chosen
+  // for square power-of-two images at least 8 pixels wide.
+  gfx::Image::Format SelectFormat(bool has_alpha, uint32 width,
+                                  uint32 height) const;
+
+  // Returns |image| transcoded to the format chosen by SelectFormat(), reading
+  // it from the storage if it was cached with the same |key|, which must
+  // identify the contents of the source, e.g., an asset path and version.
+  // Images that are already compressed in a supported format are returned
+  // as they are, as is the source if it cannot be converted.
+  const gfx::ImagePtr Transcode(const std::string& key,
+                                const gfx::ImagePtr& image);
+
+  // Transcodes |image| like Transcode() on the scheduler, calling |callback|
+  // with the result from the thread that transcoded it. Without a scheduler,
+  // this transcodes on the calling thread.
+  void TranscodeAsync(const std::string& key, const gfx::ImagePtr& image,
+                      const ImageCallback& callback);
+
+  // Waits until all images passed to TranscodeAsync() have been transcoded.
+  void Wait();
+
+  // Returns the number of images that were read from the storage and that
+  // were converted, respectively.
+  size_t GetCacheHitCount() const;
+  size_t GetConvertedCount() const;
+
+ protected:
+  // The destructor is protected because all base::Referent classes must have
+  // protected or private destructors. It waits for pending transcodes.
+  ~TextureTranscoder() override;
+
+ private:
+  // Returns the storage key of |key| transcoded to |format|.
+  static const std::string GetStorageKey(const std::string& key,
+                                         gfx::Image::Format format);
+  // Returns whether the OpenGL implementation supports |format|.
+  bool IsFormatSupported(gfx::Image::Format format) const;
+  // Reads the image cached under |storage_key|, returning NULL if there is
+  // none or it does not have |format|.
+  const gfx::ImagePtr ReadCachedImage(const std::string& storage_key,
+                                      gfx::Image::Format format) const;
+  // Converts |image| to |format|, returning NULL if it cannot be converted.
+  const gfx::ImagePtr ConvertToFormat(const gfx::ImagePtr& image,
+                                      gfx::Image::Format format) const;
+
+  gfx::GraphicsManagerPtr gm_;
+  gfx::ProgramBinaryCache::StoragePtr storage_;
+  base::TaskScheduler* scheduler_;
+  base::AllocatorPtr allocator_;
+  // The transcodes started by TranscodeAsync().
+  base::TaskScheduler::TaskGroup pending_;
+  // Protects the counts.
+  mutable port::Mutex mutex_;
+  size_t cache_hit_count_;
+  size_t converted_count_;
+
+  DISALLOW_COPY_AND_ASSIGN(TextureTranscoder);
+};
+
+typedef base::ReferentPtr<TextureTranscoder>::Type TextureTranscoderPtr;
+
+}  // namespace image
+}  // namespace ion
+
+#endif  // ION_IMAGE_TEXTURETRANSCODER_H_
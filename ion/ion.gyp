@@ -13,7 +13,8 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 #
-# Declares demos, all_public_libraries and all_tests aggregate targets.
+# Declares demos, all_public_libraries, all_benchmarks and all_tests aggregate
+# targets.
 #
 # The targets in this file are here just to serve as groupings, so that "all of
 # Ion" can be built by pointing gyp to this file. Do NOT depend on the targets
@@ -70,6 +71,13 @@
         'text/text.gyp:iontext',
       ],
     },
+    {
+      'target_name': 'all_benchmarks',
+      'type': 'none',
+      'dependencies' : [
+        'gfx/tests/gfx_tests.gyp:iongfx_benchmark',
+      ],
+    },
     {
       'target_name': 'all_tests',
       'type': 'none',
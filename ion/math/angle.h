@@ -28,37 +28,40 @@ namespace ion {
 namespace math {
 
 // A simple class to represent angles. The fundamental angular unit is radians,
-// with conversion provided to and from degrees.
+// with conversion provided to and from degrees. Construction, conversion and
+// arithmetic are constexpr, so constant angles need no static initializers.
 template <typename T>
 class Angle {
  public:
   // The default constructor creates an angle of 0 (in any unit).
-  Angle() : radians_(0) {}
+  constexpr Angle() : radians_(0) {}
 
   // Copy constructor from an instance of any value type that is compatible (via
   // static_cast) with this instance's type.
   template <typename U>
-  explicit Angle(const Angle<U> other)
+  constexpr explicit Angle(const Angle<U> other)
       : radians_(static_cast<T>(other.Radians())) {}
 
   // Create a angle from radians (no conversion).
-  static Angle FromRadians(const T& angle) {
+  static constexpr Angle FromRadians(const T& angle) {
     return Angle(angle);
   }
 
   // Create a angle from degrees (requires conversion).
-  static Angle FromDegrees(const T& angle) {
+  static constexpr Angle FromDegrees(const T& angle) {
     return Angle(DegreesToRadians(angle));
   }
 
   // Get the angle in degrees or radians.
-  T Radians() const { return radians_; }
-  T Degrees() const {  return RadiansToDegrees(radians_); }
+  constexpr T Radians() const { return radians_; }
+  constexpr T Degrees() const { return RadiansToDegrees(radians_); }
 
   // TODO(user): add "wrap around 2_pi" functions?
 
   // Unary negation operator.
-  const Angle operator-() const { return Angle::FromRadians(-radians_); }
+  constexpr const Angle operator-() const {
+    return Angle::FromRadians(-radians_);
+  }
 
   // Self-modifying operators.
   void operator+=(const Angle& a) { radians_ += a.radians_; }
@@ -67,57 +70,53 @@ class Angle {
   void operator/=(T s) { radians_ /= s; }
 
   // Binary operators.
-  friend const Angle operator+(const Angle& a0, const Angle& a1) {
+  friend constexpr const Angle operator+(const Angle& a0, const Angle& a1) {
     return FromRadians(a0.radians_ + a1.radians_);
   }
-  friend const Angle operator-(const Angle& a0, const Angle& a1) {
+  friend constexpr const Angle operator-(const Angle& a0, const Angle& a1) {
     return FromRadians(a0.radians_ - a1.radians_);
   }
-  friend const Angle operator*(const Angle& a, T s) {
+  friend constexpr const Angle operator*(const Angle& a, T s) {
     return FromRadians(a.radians_ * s);
   }
-  friend const Angle operator*(T s, const Angle& a) {
+  friend constexpr const Angle operator*(T s, const Angle& a) {
     return FromRadians(s * a.radians_);
   }
-  friend const Angle operator/(const Angle& a, T s) {
+  friend constexpr const Angle operator/(const Angle& a, T s) {
     return FromRadians(a.radians_ / s);
   }
 
   // Exact equality and inequality comparisons.
-  friend bool operator==(const Angle& a0, const Angle& a1) {
+  friend constexpr bool operator==(const Angle& a0, const Angle& a1) {
     return a0.radians_ == a1.radians_;
   }
-  friend bool operator!=(const Angle& a0, const Angle& a1) {
+  friend constexpr bool operator!=(const Angle& a0, const Angle& a1) {
     return a0.radians_ != a1.radians_;
   }
 
   // Comparisons.
-  friend bool operator<(const Angle& a0, const Angle& a1) {
+  friend constexpr bool operator<(const Angle& a0, const Angle& a1) {
     return a0.radians_ < a1.radians_;
   }
-  friend bool operator>(const Angle& a0, const Angle& a1) {
+  friend constexpr bool operator>(const Angle& a0, const Angle& a1) {
     return a0.radians_ > a1.radians_;
   }
-  friend bool operator<=(const Angle& a0, const Angle& a1) {
+  friend constexpr bool operator<=(const Angle& a0, const Angle& a1) {
     return a0.radians_ <= a1.radians_;
   }
-  friend bool operator>=(const Angle& a0, const Angle& a1) {
+  friend constexpr bool operator>=(const Angle& a0, const Angle& a1) {
     return a0.radians_ >= a1.radians_;
   }
 
  private:
-  explicit Angle(const T angle_rad) {
-    radians_ = angle_rad;
-  }
+  constexpr explicit Angle(const T angle_rad) : radians_(angle_rad) {}
 
-  static T RadiansToDegrees(const T& radians) {
-    static const T kRadToDeg = 180 / static_cast<T>(M_PI);
-    return radians * kRadToDeg;
+  static constexpr T RadiansToDegrees(const T& radians) {
+    return radians * (180 / static_cast<T>(M_PI));
   }
 
-  static T DegreesToRadians(const T& degrees) {
-    static const T kDegToRad = static_cast<T>(M_PI) / 180;
-    return degrees * kDegToRad;
+  static constexpr T DegreesToRadians(const T& degrees) {
+    return degrees * (static_cast<T>(M_PI) / 180);
   }
 
   T radians_;
@@ -0,0 +1,420 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/boundingvolumehierarchy.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "ion/base/invalid.h"
+#include "ion/base/logging.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/math/intersectionutils.h"
+
+namespace ion {
+namespace math {
+
+namespace {
+
+// The number of bins that primitive centers are sorted into along each axis
+// to find the best split.
+static const int kBinCount = 16;
+
+// Nodes with more primitives than this are always split, even if the SAH
+// prefers to keep them as a leaf.
+static const size_t kMaxLeafSize = 8U;
+
+// The estimated cost of visiting an interior node relative to the cost of
+// testing a primitive.
+static const float kTraversalCost = 1.f;
+
+// Subtrees with fewer primitives than this are built on one thread, since
+// building them in parallel would cost more than it saves.
+static const size_t kMinParallelCount = 4096U;
+
+// Returns half the surface area of a range, which is all the SAH needs.
+static float GetHalfArea(const Range3f& range) {
+  if (range.IsEmpty())
+    return 0.f;
+  const Vector3f size = range.GetSize();
+  return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+// The primitives whose centers fall into one bin, and their bounds.
+struct Bin {
+  Bin() : count(0U) {}
+  Range3f bounds;
+  size_t count;
+};
+
+// Returns the bin that |value| falls into when [min, min + kBinCount / scale)
+// is divided into kBinCount bins.
+static int GetBin(float value, float min, float scale) {
+  const int bin = static_cast<int>((value - min) * scale);
+  return std::min(std::max(bin, 0), kBinCount - 1);
+}
+
+}  // anonymous namespace
+
+// The inputs of Build() shared by all subtrees.
+struct BoundingVolumeHierarchy::BuildState {
+  BuildState(const Allocatable& owner, const Range3f* bounds_in,
+             base::TaskScheduler* scheduler_in)
+      : bounds(bounds_in), centers(owner), scheduler(scheduler_in) {}
+  const Range3f* bounds;
+  base::AllocVector<Point3f> centers;
+  base::TaskScheduler* scheduler;
+};
+
+BoundingVolumeHierarchy::BoundingVolumeHierarchy()
+    : nodes_(*this),
+      indices_(*this),
+      leaf_bounds_(*this),
+      primitive_count_(0U) {}
+
+BoundingVolumeHierarchy::~BoundingVolumeHierarchy() {}
+
+void BoundingVolumeHierarchy::Clear() {
+  nodes_.clear();
+  indices_.clear();
+  leaf_bounds_.clear();
+  primitive_count_ = 0U;
+}
+
+void BoundingVolumeHierarchy::Build(const Range3f* bounds, size_t count,
+                                    base::TaskScheduler* scheduler) {
+  Clear();
+  DCHECK(count == 0U || bounds);
+  DCHECK_LE(count, static_cast<size_t>(std::numeric_limits<uint32>::max()));
+  primitive_count_ = count;
+
+  BuildState state(*this, bounds, scheduler);
+  state.centers.resize(count);
+  Range3f all_bounds;
+  Range3f center_bounds;
+  indices_.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    if (bounds[i].IsEmpty())
+      continue;
+    state.centers[i] = bounds[i].GetCenter();
+    indices_.push_back(static_cast<uint32>(i));
+    all_bounds.ExtendByRange(bounds[i]);
+    center_bounds.ExtendByPoint(state.centers[i]);
+  }
+  if (indices_.empty())
+    return;
+
+  // A binary tree with n leaves has 2n - 1 nodes, and there is at least one
+  // primitive per leaf.
+  nodes_.reserve(2U * indices_.size());
+  BuildSubtree(&state, 0U, indices_.size(), all_bounds, center_bounds, &nodes_);
+
+  leaf_bounds_.resize(indices_.size());
+  for (size_t i = 0; i < indices_.size(); ++i)
+    leaf_bounds_[i] = bounds[indices_[i]];
+}
+
+void BoundingVolumeHierarchy::BuildSubtree(
+    BuildState* state, size_t begin, size_t end, const Range3f& bounds,
+    const Range3f& center_bounds, base::AllocVector<Node>* nodes) {
+  const size_t node_index = nodes->size();
+  Node node;
+  node.bounds = bounds;
+  node.offset = static_cast<uint32>(begin);
+  node.primitive_count = static_cast<uint32>(end - begin);
+  nodes->push_back(node);
+
+  const size_t count = end - begin;
+  if (count == 1U)
+    return;
+
+  // Find the cheapest split between two bins along any axis.
+  int best_axis = -1;
+  int best_bin = 0;
+  float best_cost = std::numeric_limits<float>::max();
+  const Point3f& center_min = center_bounds.GetMinPoint();
+  const Vector3f center_size = center_bounds.GetSize();
+  for (int axis = 0; axis < 3; ++axis) {
+    if (center_size[axis] <= 0.f)
+      continue;
+    const float scale = static_cast<float>(kBinCount) / center_size[axis];
+    Bin bins[kBinCount];
+    for (size_t i = begin; i < end; ++i) {
+      const uint32 index = indices_[i];
+      Bin& bin = bins[GetBin(state->centers[index][axis], center_min[axis],
+                             scale)];
+      ++bin.count;
+      bin.bounds.ExtendByRange(state->bounds[index]);
+    }
+    // Sweep from the left to get the area and count left of each split, then
+    // from the right to evaluate each split.
+    float left_area[kBinCount - 1];
+    size_t left_count[kBinCount - 1];
+    Range3f left_bounds;
+    size_t left_total = 0U;
+    for (int b = 0; b < kBinCount - 1; ++b) {
+      left_bounds.ExtendByRange(bins[b].bounds);
+      left_total += bins[b].count;
+      left_area[b] = GetHalfArea(left_bounds);
+      left_count[b] = left_total;
+    }
+    Range3f right_bounds;
+    size_t right_total = 0U;
+    for (int b = kBinCount - 1; b > 0; --b) {
+      right_bounds.ExtendByRange(bins[b].bounds);
+      right_total += bins[b].count;
+      // Bin b is the first bin right of the split.
+      if (left_count[b - 1] == 0U || right_total == 0U)
+        continue;
+      const float cost =
+          left_area[b - 1] * static_cast<float>(left_count[b - 1]) +
+          GetHalfArea(right_bounds) * static_cast<float>(right_total);
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_bin = b;
+      }
+    }
+  }
+
+  size_t mid = begin;
+  if (best_axis >= 0) {
+    // Compare the SAH cost of splitting with that of a leaf, in units of
+    // primitive tests.
+    const float area = GetHalfArea(bounds);
+    const bool split =
+        count > kMaxLeafSize ||
+        (area > 0.f &&
+         kTraversalCost + best_cost / area < static_cast<float>(count));
+    if (!split)
+      return;
+    const float scale =
+        static_cast<float>(kBinCount) / center_size[best_axis];
+    const float min = center_min[best_axis];
+    const int axis = best_axis;
+    const int first_right_bin = best_bin;
+    mid = std::partition(
+        indices_.begin() + begin, indices_.begin() + end,
+        [state, axis, min, scale, first_right_bin](uint32 index) {
+          return GetBin(state->centers[index][axis], min, scale) <
+                 first_right_bin;
+        }) - indices_.begin();
+  } else if (count > kMaxLeafSize) {
+    // All centers are equal, so split in the middle.
+    mid = begin + count / 2U;
+  } else {
+    return;
+  }
+  DCHECK_GT(mid, begin);
+  DCHECK_LT(mid, end);
+
+  Range3f child_bounds[2];
+  Range3f child_center_bounds[2];
+  for (size_t i = begin; i < end; ++i) {
+    const int child = i < mid ? 0 : 1;
+    child_bounds[child].ExtendByRange(state->bounds[indices_[i]]);
+    child_center_bounds[child].ExtendByPoint(state->centers[indices_[i]]);
+  }
+
+  (*nodes)[node_index].primitive_count = 0U;
+  if (state->scheduler && count >= kMinParallelCount) {
+    // Build the first child on another thread. Both children write to
+    // disjoint ranges of indices_, and the nodes are concatenated in the same
+    // order as if they had been built one after the other.
+    base::AllocVector<Node> first_nodes(*this);
+    base::AllocVector<Node> second_nodes(*this);
+    base::TaskScheduler::TaskGroup group;
+    state->scheduler->Submit([&]() {
+      BuildSubtree(state, begin, mid, child_bounds[0], child_center_bounds[0],
+                   &first_nodes);
+    }, &group);
+    BuildSubtree(state, mid, end, child_bounds[1], child_center_bounds[1],
+                 &second_nodes);
+    state->scheduler->Wait(&group);
+    (*nodes)[node_index].offset = static_cast<uint32>(1U + first_nodes.size());
+    nodes->insert(nodes->end(), first_nodes.begin(), first_nodes.end());
+    nodes->insert(nodes->end(), second_nodes.begin(), second_nodes.end());
+  } else {
+    BuildSubtree(state, begin, mid, child_bounds[0], child_center_bounds[0],
+                 nodes);
+    (*nodes)[node_index].offset =
+        static_cast<uint32>(nodes->size() - node_index);
+    BuildSubtree(state, mid, end, child_bounds[1], child_center_bounds[1],
+                 nodes);
+  }
+}
+
+void BoundingVolumeHierarchy::Refit(const Range3f* bounds, size_t count) {
+  if (count != primitive_count_) {
+    LOG(ERROR) << "BoundingVolumeHierarchy::Refit: the tree was built for "
+               << primitive_count_ << " primitives, not " << count;
+    return;
+  }
+  for (size_t i = 0; i < indices_.size(); ++i)
+    leaf_bounds_[i] = bounds[indices_[i]];
+  // Children follow their parents, so walking backwards updates them first.
+  for (size_t i = nodes_.size(); i-- > 0U;) {
+    Node& node = nodes_[i];
+    Range3f node_bounds;
+    if (node.primitive_count) {
+      for (uint32 p = 0; p < node.primitive_count; ++p)
+        node_bounds.ExtendByRange(leaf_bounds_[node.offset + p]);
+    } else {
+      node_bounds = nodes_[i + 1U].bounds;
+      node_bounds.ExtendByRange(nodes_[i + node.offset].bounds);
+    }
+    node.bounds = node_bounds;
+  }
+}
+
+size_t BoundingVolumeHierarchy::IntersectRay(
+    const Point3f& origin, const Vector3f& direction, float max_distance,
+    const RayIntersector& intersector, float* distance) const {
+  size_t closest = base::kInvalidIndex;
+  if (nodes_.empty())
+    return closest;
+  const float kInfinity = std::numeric_limits<float>::infinity();
+  Vector3f inverse_direction;
+  for (int i = 0; i < 3; ++i) {
+    inverse_direction[i] = direction[i] == 0.f ? kInfinity
+                                               : 1.f / direction[i];
+  }
+
+  float closest_distance = max_distance;
+  float entry;
+  if (!IntersectRayAndRange(origin, inverse_direction, nodes_[0].bounds,
+                            closest_distance, &entry))
+    return closest;
+
+  // Nodes still to visit, with the distance at which the ray enters them.
+  base::InlinedAllocVector<std::pair<uint32, float>, 64> stack(*this);
+  stack.push_back(std::make_pair(0U, entry));
+  while (!stack.empty()) {
+    const std::pair<uint32, float> top = stack.back();
+    stack.pop_back();
+    if (top.second > closest_distance)
+      continue;
+    const Node& node = nodes_[top.first];
+    if (node.primitive_count) {
+      for (uint32 i = node.offset; i < node.offset + node.primitive_count;
+           ++i) {
+        if (!IntersectRayAndRange(origin, inverse_direction, leaf_bounds_[i],
+                                  closest_distance, &entry))
+          continue;
+        float hit_distance = closest_distance;
+        if (intersector(indices_[i], &hit_distance) &&
+            hit_distance <= closest_distance) {
+          closest = indices_[i];
+          closest_distance = hit_distance;
+        }
+      }
+    } else {
+      const uint32 children[2] = {top.first + 1U, top.first + node.offset};
+      float entries[2];
+      bool hits[2];
+      for (int c = 0; c < 2; ++c) {
+        hits[c] = IntersectRayAndRange(origin, inverse_direction,
+                                       nodes_[children[c]].bounds,
+                                       closest_distance, &entries[c]);
+      }
+      // Push the farther child first so that the nearer one is visited next.
+      const int near = hits[0] && hits[1] && entries[1] < entries[0] ? 1 : 0;
+      const int far = 1 - near;
+      if (hits[far])
+        stack.push_back(std::make_pair(children[far], entries[far]));
+      if (hits[near])
+        stack.push_back(std::make_pair(children[near], entries[near]));
+    }
+  }
+  if (distance && closest != base::kInvalidIndex)
+    *distance = closest_distance;
+  return closest;
+}
+
+void BoundingVolumeHierarchy::FindInFrustum(
+    const Frustumf& frustum, const PrimitiveVisitor& visitor) const {
+  if (nodes_.empty())
+    return;
+  base::InlinedAllocVector<uint32, 64> stack(*this);
+  stack.push_back(0U);
+  while (!stack.empty()) {
+    const uint32 node_index = stack.back();
+    stack.pop_back();
+    const Node& node = nodes_[node_index];
+    const FrustumTestResult result = TestRange(frustum, node.bounds);
+    if (result == kOutsideFrustum)
+      continue;
+    if (result == kInsideFrustum) {
+      VisitSubtree(node_index, visitor);
+    } else if (node.primitive_count) {
+      for (uint32 i = node.offset; i < node.offset + node.primitive_count;
+           ++i) {
+        if (TestRange(frustum, leaf_bounds_[i]) != kOutsideFrustum)
+          visitor(indices_[i]);
+      }
+    } else {
+      stack.push_back(node_index + node.offset);
+      stack.push_back(node_index + 1U);
+    }
+  }
+}
+
+void BoundingVolumeHierarchy::FindInRange(
+    const Range3f& range, const PrimitiveVisitor& visitor) const {
+  if (nodes_.empty() || range.IsEmpty())
+    return;
+  base::InlinedAllocVector<uint32, 64> stack(*this);
+  stack.push_back(0U);
+  while (!stack.empty()) {
+    const uint32 node_index = stack.back();
+    stack.pop_back();
+    const Node& node = nodes_[node_index];
+    if (!range.IntersectsRange(node.bounds))
+      continue;
+    if (range.ContainsRange(node.bounds)) {
+      VisitSubtree(node_index, visitor);
+    } else if (node.primitive_count) {
+      for (uint32 i = node.offset; i < node.offset + node.primitive_count;
+           ++i) {
+        if (range.IntersectsRange(leaf_bounds_[i]))
+          visitor(indices_[i]);
+      }
+    } else {
+      stack.push_back(node_index + node.offset);
+      stack.push_back(node_index + 1U);
+    }
+  }
+}
+
+void BoundingVolumeHierarchy::VisitSubtree(
+    size_t node_index, const PrimitiveVisitor& visitor) const {
+  // The leaves of a subtree hold a contiguous run of indices_, which starts at
+  // its leftmost leaf and ends at its rightmost one.
+  size_t first = node_index;
+  while (!nodes_[first].primitive_count)
+    ++first;
+  size_t last = node_index;
+  while (!nodes_[last].primitive_count)
+    last += nodes_[last].offset;
+  const size_t end = nodes_[last].offset + nodes_[last].primitive_count;
+  for (size_t i = nodes_[first].offset; i < end; ++i)
+    visitor(indices_[i]);
+}
+
+}  // namespace math
+}  // namespace ion
@@ -0,0 +1,150 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_BOUNDINGVOLUMEHIERARCHY_H_
+#define ION_MATH_BOUNDINGVOLUMEHIERARCHY_H_
+
+#include <functional>
+
+#include "base/integral_types.h"
+#include "ion/base/allocatable.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/math/frustum.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
+namespace math {
+
+// A BoundingVolumeHierarchy is a binary tree of axis-aligned boxes over a set
+// of primitives, each of which is known only by its index and its bounds. It
+// answers ray, frustum and range queries by visiting only the primitives whose
+// bounds may be involved, which makes, for example, picking triangles in a
+// large mesh take microseconds instead of a loop over all of them.
+//
+// The tree is built top-down, splitting each node where the surface area
+// heuristic (SAH) estimates the cheapest traversal, evaluated over a fixed
+// number of bins of primitive centers along each axis. It is stored as an
+// array of nodes in depth-first order, so that the first child of a node
+// directly follows it in memory.
+//
+// When primitives move but keep their index, Refit() updates the bounds of
+// the nodes without rebuilding the tree. This is much faster than Build(), but
+// queries get slower if the primitives move far from where they were when the
+// tree was built.
+class ION_API BoundingVolumeHierarchy : public base::Allocatable {
+ public:
+  // A node of the tree. Interior nodes have a primitive_count of 0; their
+  // first child is the next node in the array and their second child is
+  // |offset| nodes after them. Leaves hold the primitive_count primitives
+  // whose indices start at GetPrimitiveIndices()[offset].
+  struct Node {
+    Range3f bounds;
+    uint32 offset;
+    uint32 primitive_count;
+  };
+
+  // Called by IntersectRay() for each primitive whose bounds are hit by the
+  // ray closer than the closest hit so far, which is passed in |distance|.
+  // The function should return true and set |distance| if the primitive is hit
+  // closer than that.
+  typedef std::function<bool(size_t primitive, float* distance)>
+      RayIntersector;
+  // Called by the other queries for each primitive they find.
+  typedef std::function<void(size_t primitive)> PrimitiveVisitor;
+
+  BoundingVolumeHierarchy();
+  ~BoundingVolumeHierarchy() override;
+
+  // Builds the tree over |count| primitives, where bounds[i] holds the bounds
+  // of primitive i. Primitives with empty bounds are never found by queries.
+  // If |scheduler| is not NULL, large subtrees are built in parallel on its
+  // threads, which gives the same tree as building them on the calling thread.
+  void Build(const Range3f* bounds, size_t count,
+             base::TaskScheduler* scheduler);
+
+  // Replaces the bounds of the primitives the tree was built for with
+  // |bounds| and updates the bounds of all nodes accordingly. |count| must be
+  // the count passed to Build(); otherwise this logs an error and does
+  // nothing. Primitives that had empty bounds when the tree was built are
+  // still never found.
+  void Refit(const Range3f* bounds, size_t count);
+
+  // Removes all nodes and primitives.
+  void Clear();
+
+  // Returns the number of primitives passed to Build().
+  size_t GetPrimitiveCount() const { return primitive_count_; }
+  // Returns the nodes of the tree. The first node is the root, whose bounds
+  // contain all primitives. There are no nodes if there are no primitives with
+  // non-empty bounds.
+  const base::AllocVector<Node>& GetNodes() const { return nodes_; }
+  // Returns the indices of the primitives in the order of the leaves.
+  const base::AllocVector<uint32>& GetPrimitiveIndices() const {
+    return indices_;
+  }
+
+  // Finds the closest primitive hit by the ray from |origin| along
+  // |direction| at a distance of at most |max_distance|, in multiples of
+  // |direction|. Nodes are visited front to back and skipped once they are
+  // farther away than the closest hit so far. |intersector| decides whether
+  // and where each candidate primitive is hit. Returns the index of the
+  // closest primitive hit and sets |distance|, if it is not NULL, to its
+  // distance, or returns base::kInvalidIndex if nothing is hit.
+  size_t IntersectRay(const Point3f& origin, const Vector3f& direction,
+                      float max_distance, const RayIntersector& intersector,
+                      float* distance) const;
+
+  // Calls |visitor| for every primitive whose bounds are not outside
+  // |frustum|, as decided by TestRange() in intersectionutils.h. Primitives
+  // in subtrees that are completely inside the frustum are visited without
+  // testing them.
+  void FindInFrustum(const Frustumf& frustum,
+                     const PrimitiveVisitor& visitor) const;
+
+  // Calls |visitor| for every primitive whose bounds intersect or touch
+  // |range|.
+  void FindInRange(const Range3f& range,
+                   const PrimitiveVisitor& visitor) const;
+
+ private:
+  struct BuildState;
+
+  // Builds the subtree for indices_[begin, end), whose bounds and centroid
+  // bounds are given, and appends its nodes to |nodes|.
+  void BuildSubtree(BuildState* state, size_t begin, size_t end,
+                    const Range3f& bounds, const Range3f& centroid_bounds,
+                    base::AllocVector<Node>* nodes);
+  // Calls |visitor| for all primitives below the node with the given index.
+  void VisitSubtree(size_t node_index, const PrimitiveVisitor& visitor) const;
+
+  base::AllocVector<Node> nodes_;
+  base::AllocVector<uint32> indices_;
+  // The bounds of the primitives in the same order as indices_, so that the
+  // primitives of a leaf can be tested without looking up their bounds.
+  base::AllocVector<Range3f> leaf_bounds_;
+  size_t primitive_count_;
+};
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_BOUNDINGVOLUMEHIERARCHY_H_
@@ -0,0 +1,197 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/fastmath.h"
+
+#if !defined(ION_MATH_NO_SIMD)
+#  if defined(__SSE2__) || defined(_M_X64)
+#    include <emmintrin.h>
+#    define ION_FAST_MATH_SSE2 1
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define ION_FAST_MATH_NEON 1
+#  endif
+#endif
+
+namespace ion {
+namespace math {
+
+namespace {
+
+#if defined(ION_FAST_MATH_SSE2)
+
+// These evaluate the same expressions as the scalar functions in fastmath.h
+// on 4 values at a time. They return false if any value is out of range, in
+// which case the caller falls back to the scalar functions.
+static bool SinesAndCosines4(const float* radians, float* sines,
+                             float* cosines) {
+  const __m128 x = _mm_loadu_ps(radians);
+  const __m128 sign_mask = _mm_set1_ps(-0.f);
+  const __m128 abs_x = _mm_andnot_ps(sign_mask, x);
+  if (_mm_movemask_ps(_mm_cmple_ps(abs_x, _mm_set1_ps(kMaxFastRadians))) !=
+      0xf)
+    return false;
+
+  const __m128 half = _mm_or_ps(_mm_and_ps(x, sign_mask), _mm_set1_ps(0.5f));
+  const __m128i quadrant = _mm_cvttps_epi32(
+      _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(internal::kTwoOverPi)), half));
+  const __m128 q = _mm_cvtepi32_ps(quadrant);
+  __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(internal::kHalfPiHigh)));
+  r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(internal::kHalfPiMid)));
+  r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(internal::kHalfPiLow)));
+  const __m128 r2 = _mm_mul_ps(r, r);
+
+  __m128 s = _mm_add_ps(_mm_set1_ps(8.3321608736e-3f),
+                        _mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)));
+  s = _mm_add_ps(_mm_set1_ps(-1.6666654611e-1f), _mm_mul_ps(r2, s));
+  s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+
+  __m128 c = _mm_add_ps(_mm_set1_ps(-1.388731625493765e-3f),
+                        _mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)));
+  c = _mm_add_ps(_mm_set1_ps(4.166664568298827e-2f), _mm_mul_ps(r2, c));
+  c = _mm_add_ps(
+      _mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)),
+      _mm_mul_ps(_mm_mul_ps(r2, r2), c));
+
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128 swap = _mm_castsi128_ps(
+      _mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+  __m128 sine = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+  __m128 cosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+  // Bit 1 of the quadrant, shifted to the sign bit.
+  const __m128i two = _mm_set1_epi32(2);
+  sine = _mm_xor_ps(sine, _mm_castsi128_ps(_mm_slli_epi32(
+                              _mm_and_si128(quadrant, two), 30)));
+  cosine = _mm_xor_ps(cosine, _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_and_si128(_mm_add_epi32(quadrant, one), two), 30)));
+  _mm_storeu_ps(sines, sine);
+  _mm_storeu_ps(cosines, cosine);
+  return true;
+}
+
+static void InverseSqrts4(const float* values, float* result) {
+  const __m128 x = _mm_loadu_ps(values);
+  const __m128i bits = _mm_sub_epi32(_mm_set1_epi32(0x5f375a86),
+                                     _mm_srli_epi32(_mm_castps_si128(x), 1));
+  __m128 y = _mm_castsi128_ps(bits);
+  const __m128 half_x = _mm_mul_ps(_mm_set1_ps(0.5f), x);
+  const __m128 three_halves = _mm_set1_ps(1.5f);
+  for (int i = 0; i < 3; ++i) {
+    y = _mm_mul_ps(
+        y, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(half_x, y), y)));
+  }
+  _mm_storeu_ps(result, y);
+}
+
+#elif defined(ION_FAST_MATH_NEON)
+
+static bool SinesAndCosines4(const float* radians, float* sines,
+                             float* cosines) {
+  const float32x4_t x = vld1q_f32(radians);
+  const uint32x4_t in_range =
+      vcleq_f32(vabsq_f32(x), vdupq_n_f32(kMaxFastRadians));
+  const uint32x2_t folded =
+      vand_u32(vget_low_u32(in_range), vget_high_u32(in_range));
+  if ((vget_lane_u32(folded, 0) & vget_lane_u32(folded, 1)) != 0xffffffffU)
+    return false;
+
+  const uint32x4_t sign_mask = vdupq_n_u32(0x80000000U);
+  const float32x4_t half = vreinterpretq_f32_u32(
+      vorrq_u32(vandq_u32(vreinterpretq_u32_f32(x), sign_mask),
+                vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+  const int32x4_t quadrant = vcvtq_s32_f32(
+      vaddq_f32(vmulq_f32(x, vdupq_n_f32(internal::kTwoOverPi)), half));
+  const float32x4_t q = vcvtq_f32_s32(quadrant);
+  float32x4_t r = vsubq_f32(x, vmulq_f32(q, vdupq_n_f32(
+                                              internal::kHalfPiHigh)));
+  r = vsubq_f32(r, vmulq_f32(q, vdupq_n_f32(internal::kHalfPiMid)));
+  r = vsubq_f32(r, vmulq_f32(q, vdupq_n_f32(internal::kHalfPiLow)));
+  const float32x4_t r2 = vmulq_f32(r, r);
+
+  float32x4_t s = vaddq_f32(vdupq_n_f32(8.3321608736e-3f),
+                            vmulq_f32(r2, vdupq_n_f32(-1.9515295891e-4f)));
+  s = vaddq_f32(vdupq_n_f32(-1.6666654611e-1f), vmulq_f32(r2, s));
+  s = vaddq_f32(r, vmulq_f32(vmulq_f32(r, r2), s));
+
+  float32x4_t c =
+      vaddq_f32(vdupq_n_f32(-1.388731625493765e-3f),
+                vmulq_f32(r2, vdupq_n_f32(2.443315711809948e-5f)));
+  c = vaddq_f32(vdupq_n_f32(4.166664568298827e-2f), vmulq_f32(r2, c));
+  c = vaddq_f32(vsubq_f32(vdupq_n_f32(1.f), vmulq_f32(vdupq_n_f32(0.5f), r2)),
+                vmulq_f32(vmulq_f32(r2, r2), c));
+
+  const int32x4_t one = vdupq_n_s32(1);
+  const int32x4_t two = vdupq_n_s32(2);
+  const uint32x4_t swap = vceqq_s32(vandq_s32(quadrant, one), one);
+  const uint32x4_t sine_sign =
+      vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(quadrant, two)), 30);
+  const uint32x4_t cosine_sign = vshlq_n_u32(
+      vreinterpretq_u32_s32(vandq_s32(vaddq_s32(quadrant, one), two)), 30);
+  const float32x4_t sine = vbslq_f32(swap, c, s);
+  const float32x4_t cosine = vbslq_f32(swap, s, c);
+  vst1q_f32(sines, vreinterpretq_f32_u32(
+                       veorq_u32(vreinterpretq_u32_f32(sine), sine_sign)));
+  vst1q_f32(cosines, vreinterpretq_f32_u32(veorq_u32(
+                         vreinterpretq_u32_f32(cosine), cosine_sign)));
+  return true;
+}
+
+static void InverseSqrts4(const float* values, float* result) {
+  const float32x4_t x = vld1q_f32(values);
+  const uint32x4_t bits = vsubq_u32(
+      vdupq_n_u32(0x5f375a86U), vshrq_n_u32(vreinterpretq_u32_f32(x), 1));
+  float32x4_t y = vreinterpretq_f32_u32(bits);
+  const float32x4_t half_x = vmulq_f32(vdupq_n_f32(0.5f), x);
+  const float32x4_t three_halves = vdupq_n_f32(1.5f);
+  for (int i = 0; i < 3; ++i) {
+    y = vmulq_f32(
+        y, vsubq_f32(three_halves, vmulq_f32(vmulq_f32(half_x, y), y)));
+  }
+  vst1q_f32(result, y);
+}
+
+#endif
+
+}  // anonymous namespace
+
+void FastSinesAndCosines(const float* radians, size_t count, float* sines,
+                         float* cosines) {
+  size_t i = 0;
+#if defined(ION_FAST_MATH_SSE2) || defined(ION_FAST_MATH_NEON)
+  for (; i + 4U <= count; i += 4U) {
+    if (!SinesAndCosines4(radians + i, sines + i, cosines + i)) {
+      for (size_t j = i; j < i + 4U; ++j)
+        FastSineAndCosine(radians[j], &sines[j], &cosines[j]);
+    }
+  }
+#endif
+  for (; i < count; ++i)
+    FastSineAndCosine(radians[i], &sines[i], &cosines[i]);
+}
+
+void FastInverseSqrts(const float* values, size_t count, float* result) {
+  size_t i = 0;
+#if defined(ION_FAST_MATH_SSE2) || defined(ION_FAST_MATH_NEON)
+  for (; i + 4U <= count; i += 4U)
+    InverseSqrts4(values + i, result + i);
+#endif
+  for (; i < count; ++i)
+    result[i] = FastInverseSqrt(values[i]);
+}
+
+}  // namespace math
+}  // namespace ion
@@ -0,0 +1,217 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_FASTMATH_H_
+#define ION_MATH_FASTMATH_H_
+
+// This file contains fast approximations of trigonometric functions and
+// reciprocal square roots for single-precision floats, accurate enough for
+// generating and transforming geometry but cheaper than the C library
+// functions used by utils.h and angleutils.h. The error bounds below hold for
+// all finite inputs in the stated ranges; they are absolute for angles and
+// relative for reciprocal square roots.
+//
+//   FastSineAndCosine()  |radians| <= kMaxFastRadians  error < 1e-7
+//   FastArcTangent2()    finite inputs                 error < 4e-7 radians
+//   FastInverseSqrt()    positive normal floats        error < 2e-7
+//
+// The array versions compute the same values as the scalar ones, using SSE
+// or NEON where available.
+//
+// SineAndCosine() and InverseSqrt() use the fast versions for floats if
+// ION_MATH_USE_FAST_MATH is defined when building Ion, and the C library
+// otherwise; code that generates geometry, such as Rotation and the shape
+// builders in gfxutils/shapeutils.h, calls them.
+
+#include <stddef.h>
+#include <string.h>  // For memcpy().
+
+#include <cmath>
+
+#include "base/integral_types.h"
+#include "ion/math/angle.h"
+#include "ion/math/utils.h"
+
+namespace ion {
+namespace math {
+
+// FastSineAndCosine() reduces angles by multiples of pi/2 with a constant
+// whose products with the multiples are exact up to this magnitude. Larger
+// angles, infinities and NaNs are passed to the C library instead.
+static const float kMaxFastRadians = 8192.f;
+
+namespace internal {
+
+// The minimax polynomials for the sine and cosine of |x| in [-pi/4, pi/4],
+// where |x2| is x * x (coefficients from Cephes).
+inline float SinePolynomial(float x, float x2) {
+  return x + x * x2 * (-1.6666654611e-1f +
+                       x2 * (8.3321608736e-3f + x2 * -1.9515295891e-4f));
+}
+inline float CosinePolynomial(float x2) {
+  return 1.f - 0.5f * x2 +
+         x2 * x2 * (4.166664568298827e-2f +
+                    x2 * (-1.388731625493765e-3f + x2 * 2.443315711809948e-5f));
+}
+
+// The polynomial for the arc tangent of |z| in [0, 1], where |z2| is z * z
+// (Abramowitz and Stegun 4.4.49, with an error below 2e-8).
+inline float ArcTangentPolynomial(float z, float z2) {
+  return z * (1.f + z2 * (-0.3333314528f + z2 * (0.1999355085f +
+         z2 * (-0.1420889944f + z2 * (0.1065626393f + z2 * (-0.0752896400f +
+         z2 * (0.0429096138f + z2 * (-0.0161657367f +
+         z2 * 0.0028662257f))))))));
+}
+
+// pi/2 split into three floats whose sum is pi/2 to about 1e-15. The first
+// two have few enough significant bits that their products with the
+// quadrant numbers of angles up to kMaxFastRadians are exact.
+static const float kHalfPiHigh = 1.5703125f;
+static const float kHalfPiMid = 4.837512969970703125e-4f;
+static const float kHalfPiLow = 7.54978995489188216e-8f;
+static const float kTwoOverPi = 0.636619772367581343f;
+
+}  // namespace internal
+
+// Sets |sine| and |cosine| to approximations of the sine and cosine of
+// |radians|.
+inline void FastSineAndCosine(float radians, float* sine, float* cosine) {
+  if (!(Abs(radians) <= kMaxFastRadians)) {
+    *sine = sinf(radians);
+    *cosine = cosf(radians);
+    return;
+  }
+  // Find the nearest multiple of pi/2 and the remainder in [-pi/4, pi/4].
+  const int quadrant = static_cast<int>(
+      radians * internal::kTwoOverPi + (radians < 0.f ? -0.5f : 0.5f));
+  const float q = static_cast<float>(quadrant);
+  const float x = ((radians - q * internal::kHalfPiHigh) -
+                   q * internal::kHalfPiMid) - q * internal::kHalfPiLow;
+  const float x2 = x * x;
+  const float s = internal::SinePolynomial(x, x2);
+  const float c = internal::CosinePolynomial(x2);
+  const bool swap = (quadrant & 1) != 0;
+  *sine = swap ? c : s;
+  *cosine = swap ? s : c;
+  if (quadrant & 2)
+    *sine = -*sine;
+  if ((quadrant + 1) & 2)
+    *cosine = -*cosine;
+}
+
+// Returns an approximation of the sine of |radians|.
+inline float FastSine(float radians) {
+  float s, c;
+  FastSineAndCosine(radians, &s, &c);
+  return s;
+}
+
+// Returns an approximation of the cosine of |radians|.
+inline float FastCosine(float radians) {
+  float s, c;
+  FastSineAndCosine(radians, &s, &c);
+  return c;
+}
+
+// Returns an approximation of the four-quadrant arc tangent of y / x in
+// radians, in [-pi, pi]. Unlike atan2(), this returns 0 if both |y| and |x|
+// are zeros of either sign, and does not handle infinities.
+inline float FastArcTangent2(float y, float x) {
+  const float ax = Abs(x);
+  const float ay = Abs(y);
+  const bool steep = ay > ax;
+  const float num = steep ? ax : ay;
+  const float den = steep ? ay : ax;
+  if (den == 0.f)
+    return 0.f;
+  const float z = num / den;
+  float a = internal::ArcTangentPolynomial(z, z * z);
+  if (steep)
+    a = static_cast<float>(M_PI_2) - a;
+  if (x < 0.f)
+    a = static_cast<float>(M_PI) - a;
+  return y < 0.f ? -a : a;
+}
+
+// Returns an approximation of 1 / sqrt(x) for positive |x|, using an
+// estimate from the float representation of |x| refined with three Newton
+// steps.
+inline float FastInverseSqrt(float x) {
+  uint32 bits;
+  memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5f375a86U - (bits >> 1);
+  float y;
+  memcpy(&y, &bits, sizeof(y));
+  const float half_x = 0.5f * x;
+  y = y * (1.5f - half_x * y * y);
+  y = y * (1.5f - half_x * y * y);
+  y = y * (1.5f - half_x * y * y);
+  return y;
+}
+
+// Sets sines[i] and cosines[i] to FastSineAndCosine(radians[i]) for i in
+// [0, count).
+ION_API void FastSinesAndCosines(const float* radians, size_t count,
+                                 float* sines, float* cosines);
+
+// Sets result[i] to FastInverseSqrt(values[i]) for i in [0, count). |result|
+// may be |values|.
+ION_API void FastInverseSqrts(const float* values, size_t count,
+                              float* result);
+
+// Sets |sine| and |cosine| to the sine and cosine of |radians|, using
+// FastSineAndCosine() for floats if ION_MATH_USE_FAST_MATH is defined.
+template <typename T>
+inline void SineAndCosine(T radians, T* sine, T* cosine) {
+  *sine = Sine(radians);
+  *cosine = Cosine(radians);
+}
+template <>
+inline void SineAndCosine(float radians, float* sine, float* cosine) {
+#if defined(ION_MATH_USE_FAST_MATH)
+  FastSineAndCosine(radians, sine, cosine);
+#else
+  *sine = sinf(radians);
+  *cosine = cosf(radians);
+#endif
+}
+
+// Angle version of SineAndCosine().
+template <typename T>
+inline void SineAndCosine(const Angle<T>& angle, T* sine, T* cosine) {
+  SineAndCosine(angle.Radians(), sine, cosine);
+}
+
+// Returns 1 / sqrt(x), using FastInverseSqrt() for floats if
+// ION_MATH_USE_FAST_MATH is defined.
+template <typename T>
+inline T InverseSqrt(T x) {
+  return static_cast<T>(1) / Sqrt(x);
+}
+template <>
+inline float InverseSqrt(float x) {
+#if defined(ION_MATH_USE_FAST_MATH)
+  return FastInverseSqrt(x);
+#else
+  return 1.f / sqrtf(x);
+#endif
+}
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_FASTMATH_H_
@@ -0,0 +1,131 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_FRUSTUM_H_
+#define ION_MATH_FRUSTUM_H_
+
+#include <ostream>  // NOLINT
+
+#include "ion/base/logging.h"
+#include "ion/math/matrix.h"
+#include "ion/math/plane.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace math {
+
+// A Frustum is the convex volume bounded by six planes whose normals point
+// inwards, so that a point is inside the Frustum if its signed distance from
+// every plane is non-negative. The planes are normalized, so signed distances
+// are true distances and can be compared with sphere radii.
+template <typename T>
+class Frustum {
+ public:
+  typedef Plane<T> PlaneType;
+
+  enum PlaneIndex {
+    kLeft,
+    kRight,
+    kBottom,
+    kTop,
+    kNear,
+    kFar,
+    kNumPlanes
+  };
+
+  // The default constructor creates a Frustum whose planes all have a zero
+  // normal, so it contains every point.
+  Frustum() {}
+
+  // Constructs the Frustum of the clip volume of |m|, which is usually a
+  // projection matrix times a view matrix, or times a model-view matrix to
+  // get the frustum in model coordinates. The clip volume is the set of
+  // points p with -w <= x, y, z <= w, where (x, y, z, w) = m * (p, 1), as in
+  // OpenGL. Each plane is a sum or difference of the fourth row of |m| and
+  // one of the other rows (Gribb and Hartmann's method), so extraction only
+  // adds and subtracts contiguous rows.
+  explicit Frustum(const Matrix<4, T>& m) { SetFromMatrix(m); }
+
+  // Sets the planes from the clip volume of |m| as described above.
+  void SetFromMatrix(const Matrix<4, T>& m) {
+    for (int axis = 0; axis < 3; ++axis) {
+      Vector<4, T> lower, upper;
+      for (int col = 0; col < 4; ++col) {
+        lower[col] = m(3, col) + m(axis, col);
+        upper[col] = m(3, col) - m(axis, col);
+      }
+      planes_[2 * axis] = PlaneType(lower);
+      planes_[2 * axis].Normalize();
+      planes_[2 * axis + 1] = PlaneType(upper);
+      planes_[2 * axis + 1].Normalize();
+    }
+  }
+
+  const PlaneType& GetPlane(PlaneIndex index) const {
+    DCHECK(index >= kLeft && index < kNumPlanes);
+    return planes_[index];
+  }
+  // Sets one of the planes. Planes are expected to be normalized.
+  void SetPlane(PlaneIndex index, const PlaneType& plane) {
+    DCHECK(index >= kLeft && index < kNumPlanes);
+    planes_[index] = plane;
+  }
+
+  // Returns whether |point| is inside the Frustum or on its boundary.
+  bool ContainsPoint(const Point<3, T>& point) const {
+    for (int i = 0; i < kNumPlanes; ++i) {
+      if (planes_[i].GetSignedDistance(point) < static_cast<T>(0))
+        return false;
+    }
+    return true;
+  }
+
+  // Exact equality and inequality comparisons.
+  friend bool operator==(const Frustum& f0, const Frustum& f1) {
+    for (int i = 0; i < kNumPlanes; ++i) {
+      if (f0.planes_[i] != f1.planes_[i])
+        return false;
+    }
+    return true;
+  }
+  friend bool operator!=(const Frustum& f0, const Frustum& f1) {
+    return !(f0 == f1);
+  }
+
+ private:
+  PlaneType planes_[kNumPlanes];
+};
+
+// Prints a Frustum to a stream.
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const Frustum<T>& f) {
+  out << "FRUSTUM[";
+  for (int i = 0; i < Frustum<T>::kNumPlanes; ++i) {
+    out << f.GetPlane(static_cast<typename Frustum<T>::PlaneIndex>(i));
+    if (i < Frustum<T>::kNumPlanes - 1)
+      out << ", ";
+  }
+  return out << "]";
+}
+
+typedef Frustum<float> Frustumf;
+typedef Frustum<double> Frustumd;
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_FRUSTUM_H_
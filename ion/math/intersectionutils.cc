@@ -0,0 +1,199 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/intersectionutils.h"
+
+#include <string.h>  // For memset().
+
+#include "ion/base/logging.h"
+
+#if defined(ION_MATH_SSE) || defined(ION_MATH_NEON)
+#  define ION_INTERSECTION_SIMD 1
+#endif
+
+namespace ion {
+namespace math {
+
+namespace {
+
+// Clears the first (count + 31) / 32 words of |bits|.
+static void ClearBits(size_t count, uint32* bits) {
+  memset(bits, 0, ((count + 31U) / 32U) * sizeof(*bits));
+}
+
+static void SetBit(size_t index, uint32* bits) {
+  bits[index / 32U] |= 1U << (index % 32U);
+}
+
+#if defined(ION_INTERSECTION_SIMD)
+
+#  if defined(ION_MATH_SSE)
+typedef __m128 Float4;
+static inline Float4 Splat(float f) { return _mm_set1_ps(f); }
+static inline Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+static inline Float4 Add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+static inline Float4 Mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+// Returns whether a < -b in any lane of either pair of arguments.
+static inline bool AnyBelowNegative(Float4 a0, Float4 b0, Float4 a1,
+                                    Float4 b1) {
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 below = _mm_or_ps(_mm_cmplt_ps(a0, _mm_sub_ps(zero, b0)),
+                                 _mm_cmplt_ps(a1, _mm_sub_ps(zero, b1)));
+  return _mm_movemask_ps(below) != 0;
+}
+#  else
+typedef float32x4_t Float4;
+static inline Float4 Splat(float f) { return vdupq_n_f32(f); }
+static inline Float4 Load(const float* p) { return vld1q_f32(p); }
+static inline Float4 Add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+static inline Float4 Mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+static inline bool AnyBelowNegative(Float4 a0, Float4 b0, Float4 a1,
+                                    Float4 b1) {
+  const uint32x4_t below = vorrq_u32(vcltq_f32(a0, vnegq_f32(b0)),
+                                     vcltq_f32(a1, vnegq_f32(b1)));
+  const uint32x2_t halves = vorr_u32(vget_low_u32(below),
+                                     vget_high_u32(below));
+  return (vget_lane_u32(halves, 0) | vget_lane_u32(halves, 1)) != 0U;
+}
+#  endif
+
+// The planes of a Frustum in structure of arrays form, so that four planes
+// can be tested at once. The six planes are padded to eight with planes that
+// have a zero normal and a positive offset, which no volume is outside of.
+class FrustumPlanes {
+ public:
+  explicit FrustumPlanes(const Frustum<float>& frustum) {
+    for (int i = 0; i < 8; ++i) {
+      if (i < Frustum<float>::kNumPlanes) {
+        const Planef& plane = frustum.GetPlane(
+            static_cast<Frustum<float>::PlaneIndex>(i));
+        const Vector3f& n = plane.GetNormal();
+        for (int j = 0; j < 3; ++j) {
+          normals_[j][i] = n[j];
+          abs_normals_[j][i] = Abs(n[j]);
+        }
+        offsets_[i] = plane.GetOffset();
+      } else {
+        for (int j = 0; j < 3; ++j)
+          normals_[j][i] = abs_normals_[j][i] = 0.f;
+        offsets_[i] = 1.f;
+      }
+    }
+  }
+
+  // Returns whether a volume centered at |center| is outside any plane, where
+  // radius_func(group) returns how far the volume extends along the normals
+  // of the four planes starting at 4 * group.
+  template <typename RadiusFunc>
+  bool IsOutside(const Point3f& center, const RadiusFunc& radius_func) const {
+    const Float4 x = Splat(center[0]);
+    const Float4 y = Splat(center[1]);
+    const Float4 z = Splat(center[2]);
+    Float4 distance[2];
+    Float4 radius[2];
+    for (int g = 0; g < 2; ++g) {
+      // This evaluates Dot(normal, center) + offset in the same order as
+      // Plane::GetSignedDistance().
+      distance[g] = Add(Add(Add(Mul(Load(&normals_[0][4 * g]), x),
+                                Mul(Load(&normals_[1][4 * g]), y)),
+                            Mul(Load(&normals_[2][4 * g]), z)),
+                        Load(&offsets_[4 * g]));
+      radius[g] = radius_func(g);
+    }
+    return AnyBelowNegative(distance[0], radius[0], distance[1], radius[1]);
+  }
+
+  // Returns, for four planes starting at 4 * group, the sum of the absolute
+  // values of the normal components scaled by |half_size|.
+  Float4 GetBoxRadius(int group, const Float4 half_size[3]) const {
+    const int i = 4 * group;
+    return Add(Add(Mul(Load(&abs_normals_[0][i]), half_size[0]),
+                   Mul(Load(&abs_normals_[1][i]), half_size[1])),
+               Mul(Load(&abs_normals_[2][i]), half_size[2]));
+  }
+
+ private:
+  float normals_[3][8];
+  float abs_normals_[3][8];
+  float offsets_[8];
+};
+
+#endif  // ION_INTERSECTION_SIMD
+
+}  // anonymous namespace
+
+size_t TestRangesAgainstFrustum(const Frustum<float>& frustum,
+                                const Range3f* ranges, size_t count,
+                                uint32* visible_bits) {
+  DCHECK(count == 0U || (ranges && visible_bits));
+  ClearBits(count, visible_bits);
+  size_t visible_count = 0;
+#if defined(ION_INTERSECTION_SIMD)
+  const FrustumPlanes planes(frustum);
+#endif
+  for (size_t i = 0; i < count; ++i) {
+    const Range3f& range = ranges[i];
+#if defined(ION_INTERSECTION_SIMD)
+    if (range.IsEmpty())
+      continue;
+    const Vector3f size = range.GetSize() / 2.f;
+    const Float4 half_size[3] = { Splat(size[0]), Splat(size[1]),
+                                  Splat(size[2]) };
+    if (planes.IsOutside(range.GetCenter(), [&](int group) {
+          return planes.GetBoxRadius(group, half_size);
+        }))
+      continue;
+#else
+    if (TestRange(frustum, range) == kOutsideFrustum)
+      continue;
+#endif
+    SetBit(i, visible_bits);
+    ++visible_count;
+  }
+  return visible_count;
+}
+
+size_t TestSpheresAgainstFrustum(const Frustum<float>& frustum,
+                                 const Sphere<float>* spheres, size_t count,
+                                 uint32* visible_bits) {
+  DCHECK(count == 0U || (spheres && visible_bits));
+  ClearBits(count, visible_bits);
+  size_t visible_count = 0;
+#if defined(ION_INTERSECTION_SIMD)
+  const FrustumPlanes planes(frustum);
+#endif
+  for (size_t i = 0; i < count; ++i) {
+    const Spheref& sphere = spheres[i];
+#if defined(ION_INTERSECTION_SIMD)
+    if (sphere.IsEmpty())
+      continue;
+    const Float4 radius = Splat(sphere.GetRadius());
+    if (planes.IsOutside(sphere.GetCenter(),
+                         [radius](int) { return radius; }))
+      continue;
+#else
+    if (TestSphere(frustum, sphere) == kOutsideFrustum)
+      continue;
+#endif
+    SetBit(i, visible_bits);
+    ++visible_count;
+  }
+  return visible_count;
+}
+
+}  // namespace math
+}  // namespace ion
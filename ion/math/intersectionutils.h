@@ -0,0 +1,235 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_INTERSECTIONUTILS_H_
+#define ION_MATH_INTERSECTIONUTILS_H_
+
+// This file contains functions that test bounding volumes against frustums,
+// rays and each other, for culling and picking. The frustum tests are
+// conservative: a volume that is outside the frustum but intersects the
+// planes of two of its sides, near an edge or corner, is reported as
+// intersecting it, never the other way around.
+
+#include <stddef.h>
+
+#include <algorithm>
+
+#include "base/integral_types.h"
+#include "ion/math/frustum.h"
+#include "ion/math/orientedbox.h"
+#include "ion/math/plane.h"
+#include "ion/math/range.h"
+#include "ion/math/sphere.h"
+#include "ion/math/utils.h"
+#include "ion/math/vector.h"
+#include "ion/math/vectorutils.h"
+
+namespace ion {
+namespace math {
+
+// The result of testing a volume against a Frustum.
+enum FrustumTestResult {
+  kOutsideFrustum,
+  kIntersectsFrustum,
+  kInsideFrustum
+};
+
+namespace internal {
+
+// Returns the result of testing a volume against |frustum|, where the volume
+// extends |radius_func(plane)| on both sides of |center| along the normal of
+// each plane.
+template <typename T, typename RadiusFunc>
+FrustumTestResult TestCenterAndRadius(const Frustum<T>& frustum,
+                                      const Point<3, T>& center,
+                                      const RadiusFunc& radius_func) {
+  FrustumTestResult result = kInsideFrustum;
+  for (int i = 0; i < Frustum<T>::kNumPlanes; ++i) {
+    const Plane<T>& plane =
+        frustum.GetPlane(static_cast<typename Frustum<T>::PlaneIndex>(i));
+    const T distance = plane.GetSignedDistance(center);
+    const T radius = radius_func(plane);
+    if (distance < -radius)
+      return kOutsideFrustum;
+    if (distance < radius)
+      result = kIntersectsFrustum;
+  }
+  return result;
+}
+
+}  // namespace internal
+
+// Tests an axis-aligned box against |frustum|. An empty Range is outside.
+template <typename T>
+FrustumTestResult TestRange(const Frustum<T>& frustum,
+                            const Range<3, T>& range) {
+  if (range.IsEmpty())
+    return kOutsideFrustum;
+  const Vector<3, T> half_size = range.GetSize() / static_cast<T>(2);
+  return internal::TestCenterAndRadius(
+      frustum, range.GetCenter(), [&half_size](const Plane<T>& plane) {
+        const Vector<3, T>& n = plane.GetNormal();
+        return Abs(n[0]) * half_size[0] + Abs(n[1]) * half_size[1] +
+               Abs(n[2]) * half_size[2];
+      });
+}
+
+// Tests a Sphere against |frustum|. An empty Sphere is outside.
+template <typename T>
+FrustumTestResult TestSphere(const Frustum<T>& frustum,
+                             const Sphere<T>& sphere) {
+  if (sphere.IsEmpty())
+    return kOutsideFrustum;
+  const T radius = sphere.GetRadius();
+  return internal::TestCenterAndRadius(
+      frustum, sphere.GetCenter(),
+      [radius](const Plane<T>&) { return radius; });
+}
+
+// Tests an OrientedBox against |frustum|. An empty box is outside.
+template <typename T>
+FrustumTestResult TestOrientedBox(const Frustum<T>& frustum,
+                                  const OrientedBox<T>& box) {
+  if (box.IsEmpty())
+    return kOutsideFrustum;
+  return internal::TestCenterAndRadius(
+      frustum, box.GetCenter(), [&box](const Plane<T>& plane) {
+        const Vector<3, T>& half_size = box.GetHalfSize();
+        return Abs(Dot(plane.GetNormal(), box.GetAxis(0))) * half_size[0] +
+               Abs(Dot(plane.GetNormal(), box.GetAxis(1))) * half_size[1] +
+               Abs(Dot(plane.GetNormal(), box.GetAxis(2))) * half_size[2];
+      });
+}
+
+// Returns whether two spheres intersect or touch. Empty spheres intersect
+// nothing.
+template <typename T>
+bool SpheresIntersect(const Sphere<T>& s0, const Sphere<T>& s1) {
+  if (s0.IsEmpty() || s1.IsEmpty())
+    return false;
+  const T radii = s0.GetRadius() + s1.GetRadius();
+  return DistanceSquared(s0.GetCenter(), s1.GetCenter()) <= radii * radii;
+}
+
+// Returns whether a sphere and an axis-aligned box intersect or touch. Empty
+// volumes intersect nothing.
+template <typename T>
+bool SphereIntersectsRange(const Sphere<T>& sphere, const Range<3, T>& range) {
+  if (sphere.IsEmpty() || range.IsEmpty())
+    return false;
+  // Find the point in the box closest to the center of the sphere.
+  const Point<3, T>& center = sphere.GetCenter();
+  Point<3, T> closest;
+  for (int i = 0; i < 3; ++i) {
+    closest[i] = Clamp(center[i], range.GetMinPoint()[i],
+                       range.GetMaxPoint()[i]);
+  }
+  return DistanceSquared(center, closest) <=
+         sphere.GetRadius() * sphere.GetRadius();
+}
+
+// Returns whether the ray from |origin| along a direction whose component-wise
+// reciprocal is |inverse_direction| hits |range| at a distance in [0,
+// max_distance], measured in multiples of the direction. If so, and
+// |distance| is not NULL, it is set to the distance at which the ray enters
+// the range, or 0 if |origin| is inside it. Passing the reciprocal lets
+// callers that test many ranges with one ray compute it once; zero direction
+// components have infinite reciprocals.
+template <typename T>
+bool IntersectRayAndRange(const Point<3, T>& origin,
+                          const Vector<3, T>& inverse_direction,
+                          const Range<3, T>& range, T max_distance,
+                          T* distance) {
+  if (range.IsEmpty())
+    return false;
+  T t_min = static_cast<T>(0);
+  T t_max = max_distance;
+  for (int i = 0; i < 3; ++i) {
+    T t0 = (range.GetMinPoint()[i] - origin[i]) * inverse_direction[i];
+    T t1 = (range.GetMaxPoint()[i] - origin[i]) * inverse_direction[i];
+    if (t0 > t1)
+      std::swap(t0, t1);
+    // These comparisons ignore the NaNs that result from a zero direction
+    // component when the origin is on one of the slab planes.
+    if (t0 > t_min)
+      t_min = t0;
+    if (t1 < t_max)
+      t_max = t1;
+    if (t_min > t_max)
+      return false;
+  }
+  if (distance)
+    *distance = t_min;
+  return true;
+}
+
+// Returns whether the ray from |origin| along |direction| hits the triangle
+// (p0, p1, p2) from either side at a distance in [0, max_distance], measured
+// in multiples of |direction| (the Moller-Trumbore algorithm). If so, the
+// distance and the barycentric coordinates of the hit point with respect to
+// p1 and p2 are returned in the non-NULL output arguments. Degenerate
+// triangles and rays parallel to the triangle are never hit.
+template <typename T>
+bool IntersectRayAndTriangle(const Point<3, T>& origin,
+                             const Vector<3, T>& direction,
+                             const Point<3, T>& p0, const Point<3, T>& p1,
+                             const Point<3, T>& p2, T max_distance,
+                             T* distance, T* u, T* v) {
+  const Vector<3, T> edge1 = p1 - p0;
+  const Vector<3, T> edge2 = p2 - p0;
+  const Vector<3, T> p = Cross(direction, edge2);
+  const T determinant = Dot(edge1, p);
+  if (determinant == static_cast<T>(0))
+    return false;
+  const T inverse_determinant = static_cast<T>(1) / determinant;
+  const Vector<3, T> s = origin - p0;
+  const T b1 = Dot(s, p) * inverse_determinant;
+  if (b1 < static_cast<T>(0) || b1 > static_cast<T>(1))
+    return false;
+  const Vector<3, T> q = Cross(s, edge1);
+  const T b2 = Dot(direction, q) * inverse_determinant;
+  if (b2 < static_cast<T>(0) || b1 + b2 > static_cast<T>(1))
+    return false;
+  const T t = Dot(edge2, q) * inverse_determinant;
+  if (t < static_cast<T>(0) || t > max_distance)
+    return false;
+  if (distance)
+    *distance = t;
+  if (u)
+    *u = b1;
+  if (v)
+    *v = b2;
+  return true;
+}
+
+// Tests |count| ranges or spheres against |frustum|, and sets bit (i % 32) of
+// visible_bits[i / 32] if volume i is not outside it, clearing the other bits.
+// |visible_bits| must hold (count + 31) / 32 words. Returns the number of
+// volumes that are not outside. The results are the same as from testing each
+// volume with TestRange() or TestSphere(), but several planes are tested at
+// once using SSE or NEON where the platform supports it.
+ION_API size_t TestRangesAgainstFrustum(const Frustum<float>& frustum,
+                                        const Range3f* ranges, size_t count,
+                                        uint32* visible_bits);
+ION_API size_t TestSpheresAgainstFrustum(const Frustum<float>& frustum,
+                                         const Sphere<float>* spheres,
+                                         size_t count, uint32* visible_bits);
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_INTERSECTIONUTILS_H_
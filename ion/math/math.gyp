@@ -31,14 +31,26 @@
       'sources' : [
         'angle.h',
         'angleutils.h',
+        'boundingvolumehierarchy.cc',
+        'boundingvolumehierarchy.h',
+        'fastmath.cc',
+        'fastmath.h',
         'fieldofview.h',
+        'frustum.h',
+        'intersectionutils.cc',
+        'intersectionutils.h',
         'matrix.h',
         'matrixutils.cc',
         'matrixutils.h',
+        'orientedbox.h',
+        'plane.h',
         'range.h',
         'rangeutils.h',
         'rotation.cc',
         'rotation.h',
+        'sphere.h',
+        'transformkernels.cc',
+        'transformkernels.h',
         'transformutils.cc',
         'transformutils.h',
         'utils.h',
@@ -26,11 +26,29 @@ limitations under the License.
 #include "ion/base/static_assert.h"
 #include "ion/base/stringutils.h"
 
+// 4x4 float matrix products, matrix-vector products, transposes and inverses
+// use SSE or NEON when the target supports them. The matrix storage is the
+// same either way, and unaligned loads are used, so matrices can still be
+// passed anywhere a plain array of 16 floats is expected, such as uniform
+// uploads. Define ION_MATH_NO_SIMD to always use the generic code.
+#if !defined(ION_MATH_NO_SIMD)
+#  if defined(__SSE__) || defined(_M_X64) || \
+      (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#    include <xmmintrin.h>
+#    define ION_MATH_SSE 1
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define ION_MATH_NEON 1
+#  endif
+#endif
+
 namespace ion {
 namespace math {
 
 // The Matrix class defines a square N-dimensional matrix. Elements are stored
-// in row-major order.
+// in row-major order. The constructors that take element values and Zero()
+// and Identity() are constexpr, so constant matrices can be built at compile
+// time.
 template <int Dimension, typename T>
 class Matrix {
  public:
@@ -39,17 +57,17 @@ class Matrix {
   typedef T ValueType;
 
   // The default constructor zero-initializes all elements.
-  Matrix() : elem_() {}
+  constexpr Matrix() : elem_() {}
 
   // Dimension-specific constructors that are passed individual element values.
-  Matrix(T m00, T m01, T m10, T m11);  // Only when Dimension == 2.
-  Matrix(T m00, T m01, T m02,          // Only when Dimension == 3.
-         T m10, T m11, T m12,
-         T m20, T m21, T m22);
-  Matrix(T m00, T m01, T m02, T m03,   // Only when Dimension == 4.
-         T m10, T m11, T m12, T m13,
-         T m20, T m21, T m22, T m23,
-         T m30, T m31, T m32, T m33);
+  constexpr Matrix(T m00, T m01, T m10, T m11);  // Only when Dimension == 2.
+  constexpr Matrix(T m00, T m01, T m02,          // Only when Dimension == 3.
+                   T m10, T m11, T m12,
+                   T m20, T m21, T m22);
+  constexpr Matrix(T m00, T m01, T m02, T m03,   // Only when Dimension == 4.
+                   T m10, T m11, T m12, T m13,
+                   T m20, T m21, T m22, T m23,
+                   T m30, T m31, T m32, T m33);
 
   // Constructor that reads elements from a linear array of the correct size.
   explicit Matrix(const T array[Dimension * Dimension]);
@@ -59,10 +77,12 @@ class Matrix {
   template <typename U> explicit Matrix(const Matrix<Dimension, U>& other);
 
   // Returns a Matrix containing all zeroes.
-  static Matrix Zero();
+  static constexpr Matrix Zero() { return Matrix(); }
 
   // Returns an identity Matrix.
-  static Matrix Identity();
+  static constexpr Matrix Identity() {
+    return StaticHelper<Dimension, T>::Identity();
+  }
 
   // Mutable element accessors.
   T& operator()(int row, int col) {
@@ -141,6 +161,10 @@ class Matrix {
   static Matrix Product(const Matrix& m0, const Matrix& m1);
   static bool AreEqual(const Matrix& m0, const Matrix& m1);
 
+  // Helper struct to implement Identity() for each Dimension. It is a struct
+  // to allow partial template specialization.
+  template <int Dim, typename U> struct StaticHelper;
+
   T elem_[Dimension][Dimension];
 };
 
@@ -185,52 +209,29 @@ std::istream& operator>>(std::istream& in, Matrix<Dimension, T>& m) {
 //------------------------------------------------------------------------------
 
 template <int Dimension, typename T>
-Matrix<Dimension, T>::Matrix(T m00, T m01, T m10, T m11) {
+constexpr Matrix<Dimension, T>::Matrix(T m00, T m01, T m10, T m11)
+    : elem_{{m00, m01}, {m10, m11}} {
   ION_STATIC_ASSERT(Dimension == 2, "Bad Dimension in Matrix constructor");
-  elem_[0][0] = m00;
-  elem_[0][1] = m01;
-  elem_[1][0] = m10;
-  elem_[1][1] = m11;
 }
 
 template <int Dimension, typename T>
-Matrix<Dimension, T>::Matrix(T m00, T m01, T m02,
-                             T m10, T m11, T m12,
-                             T m20, T m21, T m22) {
+constexpr Matrix<Dimension, T>::Matrix(T m00, T m01, T m02,
+                                       T m10, T m11, T m12,
+                                       T m20, T m21, T m22)
+    : elem_{{m00, m01, m02}, {m10, m11, m12}, {m20, m21, m22}} {
   ION_STATIC_ASSERT(Dimension == 3, "Bad Dimension in Matrix constructor");
-  elem_[0][0] = m00;
-  elem_[0][1] = m01;
-  elem_[0][2] = m02;
-  elem_[1][0] = m10;
-  elem_[1][1] = m11;
-  elem_[1][2] = m12;
-  elem_[2][0] = m20;
-  elem_[2][1] = m21;
-  elem_[2][2] = m22;
 }
 
 template <int Dimension, typename T>
-Matrix<Dimension, T>::Matrix(T m00, T m01, T m02, T m03,
-                             T m10, T m11, T m12, T m13,
-                             T m20, T m21, T m22, T m23,
-                             T m30, T m31, T m32, T m33) {
+constexpr Matrix<Dimension, T>::Matrix(T m00, T m01, T m02, T m03,
+                                       T m10, T m11, T m12, T m13,
+                                       T m20, T m21, T m22, T m23,
+                                       T m30, T m31, T m32, T m33)
+    : elem_{{m00, m01, m02, m03},
+            {m10, m11, m12, m13},
+            {m20, m21, m22, m23},
+            {m30, m31, m32, m33}} {
   ION_STATIC_ASSERT(Dimension == 4, "Bad Dimension in Matrix constructor");
-  elem_[0][0] = m00;
-  elem_[0][1] = m01;
-  elem_[0][2] = m02;
-  elem_[0][3] = m03;
-  elem_[1][0] = m10;
-  elem_[1][1] = m11;
-  elem_[1][2] = m12;
-  elem_[1][3] = m13;
-  elem_[2][0] = m20;
-  elem_[2][1] = m21;
-  elem_[2][2] = m22;
-  elem_[2][3] = m23;
-  elem_[3][0] = m30;
-  elem_[3][1] = m31;
-  elem_[3][2] = m32;
-  elem_[3][3] = m33;
 }
 
 template <int Dimension, typename T>
@@ -260,27 +261,50 @@ Matrix<Dimension, T>::Matrix(const Matrix<Dimension, U>& other) {
   }
 }
 
+// The generic Identity() is built at run time; the specializations for the
+// dimensions that have element constructors are constexpr.
 template <int Dimension, typename T>
-Matrix<Dimension, T> Matrix<Dimension, T>::Zero() {
-  Matrix result;
-  for (int row = 0; row < Dimension; ++row) {
-    for (int col = 0; col < Dimension; ++col)
-      result.elem_[row][col] = static_cast<T>(0);
+template <int Dim, typename U>
+struct Matrix<Dimension, T>::StaticHelper {
+  static Matrix Identity() {
+    Matrix result;
+    for (int i = 0; i < Dimension; ++i)
+      result.elem_[i][i] = static_cast<T>(1);
+    return result;
   }
-  return result;
-}
+};
 
 template <int Dimension, typename T>
-Matrix<Dimension, T> Matrix<Dimension, T>::Identity() {
-  Matrix result;
-  for (int row = 0; row < Dimension; ++row) {
-    for (int col = 0; col < Dimension; ++col) {
-      result.elem_[row][col] =
-          row == col ? static_cast<T>(1) : static_cast<T>(0);
-    }
+template <typename U>
+struct Matrix<Dimension, T>::StaticHelper<2, U> {
+  static constexpr Matrix Identity() {
+    return Matrix(static_cast<U>(1), static_cast<U>(0),
+                  static_cast<U>(0), static_cast<U>(1));
   }
-  return result;
-}
+};
+
+template <int Dimension, typename T>
+template <typename U>
+struct Matrix<Dimension, T>::StaticHelper<3, U> {
+  static constexpr Matrix Identity() {
+    return Matrix(static_cast<U>(1), static_cast<U>(0), static_cast<U>(0),
+                  static_cast<U>(0), static_cast<U>(1), static_cast<U>(0),
+                  static_cast<U>(0), static_cast<U>(0), static_cast<U>(1));
+  }
+};
+
+template <int Dimension, typename T>
+template <typename U>
+struct Matrix<Dimension, T>::StaticHelper<4, U> {
+  static constexpr Matrix Identity() {
+    return Matrix(static_cast<U>(1), static_cast<U>(0), static_cast<U>(0),
+                  static_cast<U>(0), static_cast<U>(0), static_cast<U>(1),
+                  static_cast<U>(0), static_cast<U>(0), static_cast<U>(0),
+                  static_cast<U>(0), static_cast<U>(1), static_cast<U>(0),
+                  static_cast<U>(0), static_cast<U>(0), static_cast<U>(0),
+                  static_cast<U>(1));
+  }
+};
 
 template <int Dimension, typename T>
 void Matrix<Dimension, T>::MultiplyScalar(T s) {
@@ -345,6 +369,45 @@ Matrix<Dimension, T> Matrix<Dimension, T>::Product(const Matrix& m0,
   return result;
 }
 
+#if defined(ION_MATH_SSE) || defined(ION_MATH_NEON)
+// Each row of the result is a sum of the rows of |m1| scaled by the elements
+// of the same row of |m0|, accumulated in the same order as in the generic
+// version.
+template <>
+inline Matrix<4, float> Matrix<4, float>::Product(const Matrix& m0,
+                                                  const Matrix& m1) {
+  Matrix result;
+#  if defined(ION_MATH_SSE)
+  const __m128 r0 = _mm_loadu_ps(m1.elem_[0]);
+  const __m128 r1 = _mm_loadu_ps(m1.elem_[1]);
+  const __m128 r2 = _mm_loadu_ps(m1.elem_[2]);
+  const __m128 r3 = _mm_loadu_ps(m1.elem_[3]);
+  for (int row = 0; row < 4; ++row) {
+    const float* a = m0.elem_[row];
+    __m128 sum = _mm_mul_ps(_mm_set1_ps(a[0]), r0);
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a[1]), r1));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a[2]), r2));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a[3]), r3));
+    _mm_storeu_ps(result.elem_[row], sum);
+  }
+#  else
+  const float32x4_t r0 = vld1q_f32(m1.elem_[0]);
+  const float32x4_t r1 = vld1q_f32(m1.elem_[1]);
+  const float32x4_t r2 = vld1q_f32(m1.elem_[2]);
+  const float32x4_t r3 = vld1q_f32(m1.elem_[3]);
+  for (int row = 0; row < 4; ++row) {
+    const float* a = m0.elem_[row];
+    float32x4_t sum = vmulq_n_f32(r0, a[0]);
+    sum = vaddq_f32(sum, vmulq_n_f32(r1, a[1]));
+    sum = vaddq_f32(sum, vmulq_n_f32(r2, a[2]));
+    sum = vaddq_f32(sum, vmulq_n_f32(r3, a[3]));
+    vst1q_f32(result.elem_[row], sum);
+  }
+#  endif
+  return result;
+}
+#endif
+
 template <int Dimension, typename T>
 bool Matrix<Dimension, T>::AreEqual(const Matrix& m0, const Matrix& m1) {
   for (int row = 0; row < Dimension; ++row) {
@@ -149,55 +149,202 @@ Matrix<3, T> Adjugate3(const Matrix<3, T>& m, T* determinant) {
   return Transpose(cofactor_matrix);
 }
 
+// Computes the 2x2 sub-determinants of the upper two rows (|s|) and the lower
+// two rows (|c|) of a 4x4 matrix, which are shared by all the elements of its
+// adjugate.
+//
+// This approach is explained in David Eberly's Geometric Tools book,
+// excerpted here:
+//   http://www.geometrictools.com/Documentation/LaplaceExpansionTheorem.pdf
+template <typename T>
+void SubDeterminants4(const Matrix<4, T>& m, T s[6], T c[6]) {
+  s[0] = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
+  s[1] = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
+  s[2] = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
+
+  s[3] = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
+  s[4] = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
+  s[5] = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
+
+  c[0] = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
+  c[1] = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
+  c[2] = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
+
+  c[3] = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
+  c[4] = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
+  c[5] = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
+}
+
+template <typename T>
+T Determinant4(const T s[6], const T c[6]) {
+  return s[0] * c[5] - s[1] * c[4] + s[2] * c[3] +
+         s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+}
+
 template <typename T>
 Matrix<4, T> Adjugate4(const Matrix<4, T>& m, T* determinant) {
   // For 4x4 do not compute the adjugate as the transpose of the cofactor
   // matrix, because this results in extra work. Several calculations can be
   // shared across the sub-determinants.
-  //
-  // This approach is explained in David Eberly's Geometric Tools book,
-  // excerpted here:
-  //   http://www.geometrictools.com/Documentation/LaplaceExpansionTheorem.pdf
-  const T s0 = m(0, 0) * m(1, 1) - m(1, 0) * m(0, 1);
-  const T s1 = m(0, 0) * m(1, 2) - m(1, 0) * m(0, 2);
-  const T s2 = m(0, 0) * m(1, 3) - m(1, 0) * m(0, 3);
-
-  const T s3 = m(0, 1) * m(1, 2) - m(1, 1) * m(0, 2);
-  const T s4 = m(0, 1) * m(1, 3) - m(1, 1) * m(0, 3);
-  const T s5 = m(0, 2) * m(1, 3) - m(1, 2) * m(0, 3);
-
-  const T c0 = m(2, 0) * m(3, 1) - m(3, 0) * m(2, 1);
-  const T c1 = m(2, 0) * m(3, 2) - m(3, 0) * m(2, 2);
-  const T c2 = m(2, 0) * m(3, 3) - m(3, 0) * m(2, 3);
-
-  const T c3 = m(2, 1) * m(3, 2) - m(3, 1) * m(2, 2);
-  const T c4 = m(2, 1) * m(3, 3) - m(3, 1) * m(2, 3);
-  const T c5 = m(2, 2) * m(3, 3) - m(3, 2) * m(2, 3);
-
+  T s[6];
+  T c[6];
+  SubDeterminants4(m, s, c);
   if (determinant)
-    *determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    *determinant = Determinant4(s, c);
 
   return Matrix<4, T>(
-      m(1, 1) * c5 - m(1, 2) * c4 + m(1, 3) * c3,
-      -m(0, 1) * c5 + m(0, 2) * c4 - m(0, 3) * c3,
-      m(3, 1) * s5 - m(3, 2) * s4 + m(3, 3) * s3,
-      -m(2, 1) * s5 + m(2, 2) * s4 - m(2, 3) * s3,
-
-      -m(1, 0) * c5 + m(1, 2) * c2 - m(1, 3) * c1,
-      m(0, 0) * c5 - m(0, 2) * c2 + m(0, 3) * c1,
-      -m(3, 0) * s5 + m(3, 2) * s2 - m(3, 3) * s1,
-      m(2, 0) * s5 - m(2, 2) * s2 + m(2, 3) * s1,
-
-      m(1, 0) * c4 - m(1, 1) * c2 + m(1, 3) * c0,
-      -m(0, 0) * c4 + m(0, 1) * c2 - m(0, 3) * c0,
-      m(3, 0) * s4 - m(3, 1) * s2 + m(3, 3) * s0,
-      -m(2, 0) * s4 + m(2, 1) * s2 - m(2, 3) * s0,
-
-      -m(1, 0) * c3 + m(1, 1) * c1 - m(1, 2) * c0,
-      m(0, 0) * c3 - m(0, 1) * c1 + m(0, 2) * c0,
-      -m(3, 0) * s3 + m(3, 1) * s1 - m(3, 2) * s0,
-      m(2, 0) * s3 - m(2, 1) * s1 + m(2, 2) * s0);
+      m(1, 1) * c[5] - m(1, 2) * c[4] + m(1, 3) * c[3],
+      -m(0, 1) * c[5] + m(0, 2) * c[4] - m(0, 3) * c[3],
+      m(3, 1) * s[5] - m(3, 2) * s[4] + m(3, 3) * s[3],
+      -m(2, 1) * s[5] + m(2, 2) * s[4] - m(2, 3) * s[3],
+
+      -m(1, 0) * c[5] + m(1, 2) * c[2] - m(1, 3) * c[1],
+      m(0, 0) * c[5] - m(0, 2) * c[2] + m(0, 3) * c[1],
+      -m(3, 0) * s[5] + m(3, 2) * s[2] - m(3, 3) * s[1],
+      m(2, 0) * s[5] - m(2, 2) * s[2] + m(2, 3) * s[1],
+
+      m(1, 0) * c[4] - m(1, 1) * c[2] + m(1, 3) * c[0],
+      -m(0, 0) * c[4] + m(0, 1) * c[2] - m(0, 3) * c[0],
+      m(3, 0) * s[4] - m(3, 1) * s[2] + m(3, 3) * s[0],
+      -m(2, 0) * s[4] + m(2, 1) * s[2] - m(2, 3) * s[0],
+
+      -m(1, 0) * c[3] + m(1, 1) * c[1] - m(1, 2) * c[0],
+      m(0, 0) * c[3] - m(0, 1) * c[1] + m(0, 2) * c[0],
+      -m(3, 0) * s[3] + m(3, 1) * s[1] - m(3, 2) * s[0],
+      m(2, 0) * s[3] - m(2, 1) * s[1] + m(2, 2) * s[0]);
+}
+
+template <int Dimension, typename T>
+Matrix<Dimension, T> InverseN(const Matrix<Dimension, T>& m, T* determinant) {
+  // The inverse is the adjugate divided by the determinant.
+  T det;
+  Matrix<Dimension, T> adjugate = AdjugateWithDeterminant(m, &det);
+  if (determinant)
+    *determinant = det;
+  if (det == static_cast<T>(0))
+    return Matrix<Dimension, T>::Zero();
+  else
+    return adjugate * (static_cast<T>(1) / det);
+}
+
+#if defined(ION_MATH_SSE) || defined(ION_MATH_NEON)
+
+//-----------------------------------------------------------------------------
+// SIMD versions of the 4x4 float adjugate and inverse. They are overloads
+// rather than specializations so that the generic templates above are still
+// used for all other matrices.
+// -----------------------------------------------------------------------------
+
+#  if defined(ION_MATH_SSE)
+typedef __m128 Float4;
+static inline Float4 Mul4(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+static inline Float4 Add4(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+static inline Float4 Sub4(Float4 a, Float4 b) { return _mm_sub_ps(a, b); }
+// Returns (lo, lo, hi, hi).
+static inline Float4 Pairs4(float lo, float hi) {
+  return _mm_setr_ps(lo, lo, hi, hi);
 }
+#  else
+typedef float32x4_t Float4;
+static inline Float4 Mul4(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+static inline Float4 Add4(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+static inline Float4 Sub4(Float4 a, Float4 b) { return vsubq_f32(a, b); }
+static inline Float4 Pairs4(float lo, float hi) {
+  return vcombine_f32(vdup_n_f32(lo), vdup_n_f32(hi));
+}
+#  endif
+
+// Computes the rows of the adjugate of |m| exactly as Adjugate4() does, and
+// returns the determinant of |m|. Lane k of row r of the adjugate combines
+// elements of row 1, 0, 3 or 2 of |m| with the |c| or |s| sub-determinants,
+// and every other lane is negated, so each row is three products of a
+// column of |m| with those lanes swapped and a pair of sub-determinants.
+static float AdjugateRows4f(const Matrix<4, float>& m, Float4 rows[4]) {
+  float s[6];
+  float c[6];
+  SubDeterminants4(m, s, c);
+
+#  if defined(ION_MATH_SSE)
+  __m128 x0 = _mm_loadu_ps(m[0]);
+  __m128 x1 = _mm_loadu_ps(m[1]);
+  __m128 x2 = _mm_loadu_ps(m[2]);
+  __m128 x3 = _mm_loadu_ps(m[3]);
+  _MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+  x0 = _mm_shuffle_ps(x0, x0, _MM_SHUFFLE(2, 3, 0, 1));
+  x1 = _mm_shuffle_ps(x1, x1, _MM_SHUFFLE(2, 3, 0, 1));
+  x2 = _mm_shuffle_ps(x2, x2, _MM_SHUFFLE(2, 3, 0, 1));
+  x3 = _mm_shuffle_ps(x3, x3, _MM_SHUFFLE(2, 3, 0, 1));
+  const __m128 signs = _mm_setr_ps(1.f, -1.f, 1.f, -1.f);
+#  else
+  const float32x4x4_t columns = vld4q_f32(m.Data());
+  const float32x4_t x0 = vrev64q_f32(columns.val[0]);
+  const float32x4_t x1 = vrev64q_f32(columns.val[1]);
+  const float32x4_t x2 = vrev64q_f32(columns.val[2]);
+  const float32x4_t x3 = vrev64q_f32(columns.val[3]);
+  static const float kSigns[4] = { 1.f, -1.f, 1.f, -1.f };
+  const float32x4_t signs = vld1q_f32(kSigns);
+#  endif
+
+  const Float4 k0 = Pairs4(c[0], s[0]);
+  const Float4 k1 = Pairs4(c[1], s[1]);
+  const Float4 k2 = Pairs4(c[2], s[2]);
+  const Float4 k3 = Pairs4(c[3], s[3]);
+  const Float4 k4 = Pairs4(c[4], s[4]);
+  const Float4 k5 = Pairs4(c[5], s[5]);
+
+  // The odd lanes are negated after summing rather than by negating the
+  // first product, as Adjugate4() does, which gives the same result.
+  rows[0] = Mul4(signs,
+                 Add4(Sub4(Mul4(x1, k5), Mul4(x2, k4)), Mul4(x3, k3)));
+  rows[1] = Mul4(signs,
+                 Sub4(Sub4(Mul4(x2, k2), Mul4(x0, k5)), Mul4(x3, k1)));
+  rows[2] = Mul4(signs,
+                 Add4(Sub4(Mul4(x0, k4), Mul4(x1, k2)), Mul4(x3, k0)));
+  rows[3] = Mul4(signs,
+                 Sub4(Sub4(Mul4(x1, k1), Mul4(x0, k3)), Mul4(x2, k0)));
+  return Determinant4(s, c);
+}
+
+static void StoreRows4f(const Float4 rows[4], Matrix<4, float>* m) {
+  for (int row = 0; row < 4; ++row) {
+#  if defined(ION_MATH_SSE)
+    _mm_storeu_ps((*m)[row], rows[row]);
+#  else
+    vst1q_f32((*m)[row], rows[row]);
+#  endif
+  }
+}
+
+Matrix<4, float> Adjugate4(const Matrix<4, float>& m, float* determinant) {
+  Float4 rows[4];
+  const float det = AdjugateRows4f(m, rows);
+  if (determinant)
+    *determinant = det;
+  Matrix<4, float> result;
+  StoreRows4f(rows, &result);
+  return result;
+}
+
+Matrix<4, float> InverseN(const Matrix<4, float>& m, float* determinant) {
+  Float4 rows[4];
+  const float det = AdjugateRows4f(m, rows);
+  if (determinant)
+    *determinant = det;
+  if (det == 0.f)
+    return Matrix<4, float>::Zero();
+#  if defined(ION_MATH_SSE)
+  const Float4 scale = _mm_set1_ps(1.f / det);
+#  else
+  const Float4 scale = vdupq_n_f32(1.f / det);
+#  endif
+  for (int row = 0; row < 4; ++row)
+    rows[row] = Mul4(rows[row], scale);
+  Matrix<4, float> result;
+  StoreRows4f(rows, &result);
+  return result;
+}
+
+#endif  // ION_MATH_SSE || ION_MATH_NEON
 
 }  // anonymous namespace
 
@@ -232,15 +379,7 @@ Matrix<Dimension, T> AdjugateWithDeterminant(
 template <int Dimension, typename T>
 Matrix<Dimension, T> InverseWithDeterminant(
     const Matrix<Dimension, T>& m, T* determinant) {
-  // The inverse is the adjugate divided by the determinant.
-  T det;
-  Matrix<Dimension, T> adjugate = AdjugateWithDeterminant(m, &det);
-  if (determinant)
-    *determinant = det;
-  if (det == static_cast<T>(0))
-    return Matrix<Dimension, T>::Zero();
-  else
-    return adjugate * (static_cast<T>(1) / det);
+  return InverseN(m, determinant);
 }
 
 template <int Dimension, typename T>
@@ -50,6 +50,51 @@ VectorType MultiplyMatrixAndVector(const Matrix<Dimension, T>& m,
   return result;
 }
 
+#if defined(ION_MATH_SSE) || defined(ION_MATH_NEON)
+// Stores the product of a 4x4 float matrix and the column vector |v| in
+// |result|. The result is a sum of the columns of |m| scaled by the elements
+// of |v|, accumulated in the same order as in the generic version.
+inline void MultiplyMatrix4fAndVector(const Matrix<4, float>& m,
+                                      const float* v, float* result) {
+#  if defined(ION_MATH_SSE)
+  __m128 c0 = _mm_loadu_ps(m[0]);
+  __m128 c1 = _mm_loadu_ps(m[1]);
+  __m128 c2 = _mm_loadu_ps(m[2]);
+  __m128 c3 = _mm_loadu_ps(m[3]);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  __m128 sum = _mm_mul_ps(c0, _mm_set1_ps(v[0]));
+  sum = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_set1_ps(v[1])));
+  sum = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_set1_ps(v[2])));
+  sum = _mm_add_ps(sum, _mm_mul_ps(c3, _mm_set1_ps(v[3])));
+  _mm_storeu_ps(result, sum);
+#  else
+  // De-interleaving the rows yields the columns.
+  const float32x4x4_t c = vld4q_f32(m.Data());
+  float32x4_t sum = vmulq_n_f32(c.val[0], v[0]);
+  sum = vaddq_f32(sum, vmulq_n_f32(c.val[1], v[1]));
+  sum = vaddq_f32(sum, vmulq_n_f32(c.val[2], v[2]));
+  sum = vaddq_f32(sum, vmulq_n_f32(c.val[3], v[3]));
+  vst1q_f32(result, sum);
+#  endif
+}
+
+template <>
+inline Vector<4, float> MultiplyMatrixAndVector(const Matrix<4, float>& m,
+                                                const Vector<4, float>& v) {
+  Vector<4, float> result;
+  MultiplyMatrix4fAndVector(m, v.Data(), result.Data());
+  return result;
+}
+
+template <>
+inline Point<4, float> MultiplyMatrixAndVector(const Matrix<4, float>& m,
+                                               const Point<4, float>& p) {
+  Point<4, float> result;
+  MultiplyMatrix4fAndVector(m, p.Data(), result.Data());
+  return result;
+}
+#endif
+
 }  // namespace internal
 
 //-----------------------------------------------------------------------------
@@ -67,6 +112,31 @@ Matrix<Dimension, T> Transpose(const Matrix<Dimension, T>& m) {
   return result;
 }
 
+#if defined(ION_MATH_SSE) || defined(ION_MATH_NEON)
+template <>
+inline Matrix<4, float> Transpose(const Matrix<4, float>& m) {
+  Matrix<4, float> result;
+#  if defined(ION_MATH_SSE)
+  __m128 r0 = _mm_loadu_ps(m[0]);
+  __m128 r1 = _mm_loadu_ps(m[1]);
+  __m128 r2 = _mm_loadu_ps(m[2]);
+  __m128 r3 = _mm_loadu_ps(m[3]);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(result[0], r0);
+  _mm_storeu_ps(result[1], r1);
+  _mm_storeu_ps(result[2], r2);
+  _mm_storeu_ps(result[3], r3);
+#  else
+  const float32x4x4_t c = vld4q_f32(m.Data());
+  vst1q_f32(result[0], c.val[0]);
+  vst1q_f32(result[1], c.val[1]);
+  vst1q_f32(result[2], c.val[2]);
+  vst1q_f32(result[3], c.val[3]);
+#  endif
+  return result;
+}
+#endif
+
 // Multiplies a Matrix and a column Vector of the same Dimension to produce
 // another column Vector.
 template <int Dimension, typename T>
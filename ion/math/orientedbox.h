@@ -0,0 +1,151 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_ORIENTEDBOX_H_
+#define ION_MATH_ORIENTEDBOX_H_
+
+#include <ostream>  // NOLINT
+
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+#include "ion/math/vectorutils.h"
+
+namespace ion {
+namespace math {
+
+// An OrientedBox is a box with a center, three axes and a half size along
+// each axis. The box holds the points center + sum(t[i] * axis[i]) with
+// |t[i]| <= half_size[i]. The axes are the columns of a 3x3 matrix and are
+// normally orthonormal, but they do not need to be: a box transformed by a
+// shearing matrix is still represented exactly, and the frustum tests in
+// intersectionutils.h remain correct for it.
+template <typename T>
+class OrientedBox {
+ public:
+  typedef Point<3, T> PointType;
+  typedef Vector<3, T> VectorType;
+  typedef Matrix<3, T> AxesType;
+
+  // The default constructor creates an empty box at the origin, aligned with
+  // the coordinate axes.
+  OrientedBox()
+      : center_(PointType::Zero()),
+        axes_(AxesType::Identity()),
+        half_size_(VectorType::Fill(static_cast<T>(-1))) {}
+
+  OrientedBox(const PointType& center, const AxesType& axes,
+              const VectorType& half_size)
+      : center_(center), axes_(axes), half_size_(half_size) {}
+
+  // Returns the box that |range| is transformed to by the affine matrix |m|.
+  // The axes are the normalized columns of the upper 3x3 of |m|, and any scale
+  // is moved into the half size. Columns with zero length are replaced by the
+  // corresponding coordinate axis, with a half size of 0. An empty range gives
+  // an empty box.
+  static OrientedBox FromRange(const Range<3, T>& range,
+                               const Matrix<4, T>& m) {
+    if (range.IsEmpty())
+      return OrientedBox();
+    const PointType center = range.GetCenter();
+    const VectorType size = range.GetSize();
+    PointType transformed_center;
+    AxesType axes;
+    VectorType half_size;
+    for (int row = 0; row < 3; ++row) {
+      transformed_center[row] = m(row, 0) * center[0] +
+          m(row, 1) * center[1] + m(row, 2) * center[2] + m(row, 3);
+    }
+    for (int col = 0; col < 3; ++col) {
+      VectorType axis(m(0, col), m(1, col), m(2, col));
+      const T length = Length(axis);
+      if (length == static_cast<T>(0)) {
+        axis = VectorType::Zero();
+        axis[col] = static_cast<T>(1);
+      } else {
+        axis /= length;
+      }
+      for (int row = 0; row < 3; ++row)
+        axes(row, col) = axis[row];
+      half_size[col] = length * size[col] / static_cast<T>(2);
+    }
+    return OrientedBox(transformed_center, axes, half_size);
+  }
+
+  const PointType& GetCenter() const { return center_; }
+  const AxesType& GetAxes() const { return axes_; }
+  const VectorType& GetHalfSize() const { return half_size_; }
+  void SetCenter(const PointType& center) { center_ = center; }
+  void SetAxes(const AxesType& axes) { axes_ = axes; }
+  void SetHalfSize(const VectorType& half_size) { half_size_ = half_size; }
+
+  // Returns the axis with the given index, which must be 0, 1 or 2.
+  const VectorType GetAxis(int index) const {
+    return VectorType(axes_(0, index), axes_(1, index), axes_(2, index));
+  }
+
+  // Returns whether the box contains no points, which is the case if any half
+  // size is negative.
+  bool IsEmpty() const {
+    return half_size_[0] < static_cast<T>(0) ||
+           half_size_[1] < static_cast<T>(0) ||
+           half_size_[2] < static_cast<T>(0);
+  }
+
+  // Returns whether |point| is inside the box or on its surface. This
+  // requires the axes to be orthonormal.
+  bool ContainsPoint(const PointType& point) const {
+    if (IsEmpty())
+      return false;
+    const VectorType offset = point - center_;
+    for (int i = 0; i < 3; ++i) {
+      const T t = Dot(offset, GetAxis(i));
+      if (t > half_size_[i] || t < -half_size_[i])
+        return false;
+    }
+    return true;
+  }
+
+  // Exact equality and inequality comparisons.
+  friend bool operator==(const OrientedBox& b0, const OrientedBox& b1) {
+    return b0.center_ == b1.center_ && b0.axes_ == b1.axes_ &&
+           b0.half_size_ == b1.half_size_;
+  }
+  friend bool operator!=(const OrientedBox& b0, const OrientedBox& b1) {
+    return !(b0 == b1);
+  }
+
+ private:
+  PointType center_;
+  AxesType axes_;
+  VectorType half_size_;
+};
+
+// Prints an OrientedBox to a stream.
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const OrientedBox<T>& b) {
+  return out << "OBOX[" << b.GetCenter() << ", " << b.GetAxes() << ", "
+             << b.GetHalfSize() << "]";
+}
+
+typedef OrientedBox<float> OrientedBoxf;
+typedef OrientedBox<double> OrientedBoxd;
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_ORIENTEDBOX_H_
@@ -0,0 +1,107 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_PLANE_H_
+#define ION_MATH_PLANE_H_
+
+#include <ostream>  // NOLINT
+
+#include "ion/math/vector.h"
+#include "ion/math/vectorutils.h"
+
+namespace ion {
+namespace math {
+
+// A Plane holds the points p for which Dot(normal, p) + offset is 0, where p
+// is treated as a vector from the origin. Points on the side the normal
+// points to have a positive signed distance. The normal does not have to be
+// unit length, but the signed distance is scaled by its length if it is not.
+template <typename T>
+class Plane {
+ public:
+  typedef Vector<3, T> VectorType;
+  typedef Point<3, T> PointType;
+
+  // The default constructor creates a plane with a zero normal, for which the
+  // signed distance of any point is 0.
+  Plane() : normal_(VectorType::Zero()), offset_(static_cast<T>(0)) {}
+
+  // Constructs a Plane from its normal and offset.
+  Plane(const VectorType& normal, T offset)
+      : normal_(normal), offset_(offset) {}
+
+  // Constructs a Plane from the coefficients (a, b, c, d) of the plane
+  // equation ax + by + cz + d = 0.
+  explicit Plane(const Vector<4, T>& coefficients)
+      : normal_(coefficients[0], coefficients[1], coefficients[2]),
+        offset_(coefficients[3]) {}
+
+  // Returns the Plane that contains |point| and has the given normal.
+  static Plane FromPointAndNormal(const PointType& point,
+                                  const VectorType& normal) {
+    return Plane(normal, -Dot(normal, point - PointType::Zero()));
+  }
+
+  const VectorType& GetNormal() const { return normal_; }
+  T GetOffset() const { return offset_; }
+  void Set(const VectorType& normal, T offset) {
+    normal_ = normal;
+    offset_ = offset;
+  }
+
+  // Returns the signed distance of |point| from the plane.
+  T GetSignedDistance(const PointType& point) const {
+    return Dot(normal_, point - PointType::Zero()) + offset_;
+  }
+
+  // Scales the normal to unit length, and the offset by the same factor, so
+  // that signed distances are true distances. Planes with a zero normal are
+  // left unchanged.
+  void Normalize() {
+    const T length = Length(normal_);
+    if (length != static_cast<T>(0)) {
+      normal_ /= length;
+      offset_ /= length;
+    }
+  }
+
+  // Exact equality and inequality comparisons.
+  friend bool operator==(const Plane& p0, const Plane& p1) {
+    return p0.normal_ == p1.normal_ && p0.offset_ == p1.offset_;
+  }
+  friend bool operator!=(const Plane& p0, const Plane& p1) {
+    return !(p0 == p1);
+  }
+
+ private:
+  VectorType normal_;
+  T offset_;
+};
+
+// Prints a Plane to a stream.
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const Plane<T>& p) {
+  return out << "PLANE[" << p.GetNormal() << ", " << p.GetOffset() << "]";
+}
+
+typedef Plane<float> Planef;
+typedef Plane<double> Planed;
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_PLANE_H_
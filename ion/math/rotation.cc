@@ -23,6 +23,7 @@ limitations under the License.
 
 #include "ion/base/logging.h"
 #include "ion/math/angleutils.h"
+#include "ion/math/fastmath.h"
 #include "ion/math/utils.h"
 #include "ion/math/vectorutils.h"
 
@@ -40,9 +41,9 @@ void Rotation<T>::SetAxisAndAngle(const VectorType& axis,
   if (!Normalize(&unit_axis)) {
     *this = Identity();
   } else {
-    AngleType a = angle / 2;
-    const T s = static_cast<T>(Sine(a));
-    SetQuaternion(QuaternionType(unit_axis * s, static_cast<T>(Cosine(a))));
+    T s, c;
+    SineAndCosine(angle / 2, &s, &c);
+    SetQuaternion(QuaternionType(unit_axis * s, c));
   }
 }
 
@@ -104,7 +105,7 @@ void Rotation<T>::GetAxisAndAngle(VectorType* axis, AngleType* angle) const {
   } else {
     DCHECK_NE(quat_[3], static_cast<T>(1));
     *angle = 2 * ArcCosine(quat_[3]);
-    const T s = static_cast<T>(1) / Sqrt(static_cast<T>(1) - Square(quat_[3]));
+    const T s = InverseSqrt(static_cast<T>(1) - Square(quat_[3]));
     *axis = VectorType(quat_[0], quat_[1], quat_[2]) * s;
   }
 }
@@ -200,7 +201,9 @@ Rotation<T> Rotation<T>::Slerp(const Rotation& r0,
     const QuaternionType q2 = Normalized(q1 - q0 * dot);
 
     // q0 and q2 now form an orthonormal basis; interpolate using it.
-    q_result = q0 * Cosine(theta) + q2 * Sine(theta);
+    T s, c;
+    SineAndCosine(theta, &s, &c);
+    q_result = q0 * c + q2 * s;
   }
   Rotation<T> result;
   result.SetQuaternion(q_result);
@@ -0,0 +1,92 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_SPHERE_H_
+#define ION_MATH_SPHERE_H_
+
+#include <ostream>  // NOLINT
+
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+#include "ion/math/vectorutils.h"
+
+namespace ion {
+namespace math {
+
+// A Sphere is a center point and a radius. A Sphere with a negative radius is
+// empty and contains no points, while one with radius 0 contains its center.
+template <typename T>
+class Sphere {
+ public:
+  typedef Point<3, T> PointType;
+
+  // The default constructor creates an empty Sphere at the origin.
+  Sphere() : center_(PointType::Zero()), radius_(static_cast<T>(-1)) {}
+
+  Sphere(const PointType& center, T radius)
+      : center_(center), radius_(radius) {}
+
+  // Returns the smallest Sphere that contains |range|, or an empty Sphere if
+  // |range| is empty.
+  static Sphere FromRange(const Range<3, T>& range) {
+    if (range.IsEmpty())
+      return Sphere();
+    return Sphere(range.GetCenter(),
+                  Length(range.GetMaxPoint() - range.GetMinPoint()) /
+                      static_cast<T>(2));
+  }
+
+  const PointType& GetCenter() const { return center_; }
+  T GetRadius() const { return radius_; }
+  void SetCenter(const PointType& center) { center_ = center; }
+  void SetRadius(T radius) { radius_ = radius; }
+
+  // Returns whether the Sphere contains no points.
+  bool IsEmpty() const { return radius_ < static_cast<T>(0); }
+
+  // Returns whether |point| is inside the Sphere or on its surface.
+  bool ContainsPoint(const PointType& point) const {
+    return !IsEmpty() &&
+           DistanceSquared(center_, point) <= radius_ * radius_;
+  }
+
+  // Exact equality and inequality comparisons.
+  friend bool operator==(const Sphere& s0, const Sphere& s1) {
+    return s0.center_ == s1.center_ && s0.radius_ == s1.radius_;
+  }
+  friend bool operator!=(const Sphere& s0, const Sphere& s1) {
+    return !(s0 == s1);
+  }
+
+ private:
+  PointType center_;
+  T radius_;
+};
+
+// Prints a Sphere to a stream.
+template <typename T>
+std::ostream& operator<<(std::ostream& out, const Sphere<T>& s) {
+  return out << "SPHERE[" << s.GetCenter() << ", " << s.GetRadius() << "]";
+}
+
+typedef Sphere<float> Spheref;
+typedef Sphere<double> Sphered;
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_SPHERE_H_
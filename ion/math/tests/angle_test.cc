@@ -93,6 +93,17 @@ TEST(Angle, BinaryOperators) {
   EXPECT_EQ(2.0, (a1 / 2.0).Radians());
 }
 
+TEST(Angle, Constexpr) {
+  static constexpr Anglef kFov = Anglef::FromDegrees(45.f);
+  static constexpr Angled kHalfTurn = Angled::FromRadians(M_PI);
+  static_assert(kFov * 2.f > kFov, "Angle operators must be constexpr");
+  static_assert(-kHalfTurn + kHalfTurn == Angled(),
+                "Angle operators must be constexpr");
+  static_assert(Angled(kFov) < kHalfTurn, "Angle conversion must be constexpr");
+  EXPECT_EQ(Anglef::FromDegrees(45.f), kFov);
+  EXPECT_NEAR(180.0, kHalfTurn.Degrees(), 1e-12);
+}
+
 TEST(Angle, Streaming) {
   std::ostringstream out1;
   out1 << Angled::FromDegrees(23.5);
@@ -0,0 +1,294 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/boundingvolumehierarchy.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ion/base/invalid.h"
+#include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/math/intersectionutils.h"
+#include "ion/math/transformutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+namespace {
+
+// Returns the bounds of a grid of nx * ny * nz unit cubes, 2 units apart, with
+// the cube at (0, 0, 0) having its minimum point at the origin.
+static const std::vector<Range3f> BuildGrid(int nx, int ny, int nz) {
+  std::vector<Range3f> bounds;
+  for (int z = 0; z < nz; ++z) {
+    for (int y = 0; y < ny; ++y) {
+      for (int x = 0; x < nx; ++x) {
+        const Point3f min(2.f * static_cast<float>(x),
+                          2.f * static_cast<float>(y),
+                          2.f * static_cast<float>(z));
+        bounds.push_back(Range3f(min, min + Vector3f(1.f, 1.f, 1.f)));
+      }
+    }
+  }
+  return bounds;
+}
+
+// Returns the sorted primitives found by testing every bound with |pred|.
+template <typename Pred>
+static const std::vector<size_t> FindAll(const std::vector<Range3f>& bounds,
+                                         const Pred& pred) {
+  std::vector<size_t> found;
+  for (size_t i = 0; i < bounds.size(); ++i) {
+    if (pred(bounds[i]))
+      found.push_back(i);
+  }
+  return found;
+}
+
+// Returns a visitor that appends primitives to |found|.
+static const BoundingVolumeHierarchy::PrimitiveVisitor Collect(
+    std::vector<size_t>* found) {
+  return [found](size_t primitive) { found->push_back(primitive); };
+}
+
+// Returns an intersector that hits the bounds of each primitive.
+static const BoundingVolumeHierarchy::RayIntersector HitBounds(
+    const std::vector<Range3f>& bounds, const Point3f& origin,
+    const Vector3f& direction) {
+  Vector3f inverse_direction;
+  for (int i = 0; i < 3; ++i)
+    inverse_direction[i] = 1.f / direction[i];
+  return [&bounds, origin, inverse_direction](size_t primitive,
+                                              float* distance) {
+    return IntersectRayAndRange(origin, inverse_direction, bounds[primitive],
+                                *distance, distance);
+  };
+}
+
+// Checks the structure of |bvh| and that each leaf contains its primitives.
+static void CheckTree(const BoundingVolumeHierarchy& bvh,
+                      const std::vector<Range3f>& bounds) {
+  const auto& nodes = bvh.GetNodes();
+  const auto& indices = bvh.GetPrimitiveIndices();
+  std::vector<int> seen(bounds.size(), 0);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const BoundingVolumeHierarchy::Node& node = nodes[i];
+    if (node.primitive_count) {
+      for (uint32 p = 0; p < node.primitive_count; ++p) {
+        const uint32 index = indices[node.offset + p];
+        EXPECT_TRUE(node.bounds.ContainsRange(bounds[index]));
+        ++seen[index];
+      }
+    } else {
+      ASSERT_LT(i + node.offset, nodes.size());
+      EXPECT_GT(node.offset, 1U);
+      EXPECT_TRUE(node.bounds.ContainsRange(nodes[i + 1].bounds));
+      EXPECT_TRUE(node.bounds.ContainsRange(nodes[i + node.offset].bounds));
+    }
+  }
+  for (size_t i = 0; i < bounds.size(); ++i)
+    EXPECT_EQ(bounds[i].IsEmpty() ? 0 : 1, seen[i]) << "primitive " << i;
+}
+
+}  // anonymous namespace
+
+TEST(BoundingVolumeHierarchy, Empty) {
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(nullptr, 0U, nullptr);
+  EXPECT_EQ(0U, bvh.GetPrimitiveCount());
+  EXPECT_TRUE(bvh.GetNodes().empty());
+  std::vector<size_t> found;
+  bvh.FindInRange(Range3f(Point3f::Zero(), Point3f(1.f, 1.f, 1.f)),
+                  Collect(&found));
+  EXPECT_TRUE(found.empty());
+  EXPECT_EQ(base::kInvalidIndex,
+            bvh.IntersectRay(Point3f::Zero(), Vector3f::AxisX(), 10.f,
+                             [](size_t, float*) { return true; }, nullptr));
+
+  // Primitives with empty bounds are left out.
+  const std::vector<Range3f> bounds(3U);
+  bvh.Build(bounds.data(), bounds.size(), nullptr);
+  EXPECT_EQ(3U, bvh.GetPrimitiveCount());
+  EXPECT_TRUE(bvh.GetNodes().empty());
+  EXPECT_TRUE(bvh.GetPrimitiveIndices().empty());
+}
+
+TEST(BoundingVolumeHierarchy, Build) {
+  std::vector<Range3f> bounds = BuildGrid(10, 10, 10);
+  bounds[17] = Range3f();
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(bounds.data(), bounds.size(), nullptr);
+  EXPECT_EQ(1000U, bvh.GetPrimitiveCount());
+  EXPECT_EQ(999U, bvh.GetPrimitiveIndices().size());
+  EXPECT_EQ(Range3f(Point3f::Zero(), Point3f(19.f, 19.f, 19.f)),
+            bvh.GetNodes()[0].bounds);
+  CheckTree(bvh, bounds);
+  // The SAH should separate the cubes.
+  for (const BoundingVolumeHierarchy::Node& node : bvh.GetNodes())
+    EXPECT_LE(node.primitive_count, 2U);
+
+  // Identical primitives are still split into small leaves.
+  const std::vector<Range3f> same(
+      100U, Range3f(Point3f::Zero(), Point3f(1.f, 1.f, 1.f)));
+  bvh.Build(same.data(), same.size(), nullptr);
+  CheckTree(bvh, same);
+  for (const BoundingVolumeHierarchy::Node& node : bvh.GetNodes())
+    EXPECT_LE(node.primitive_count, 8U);
+
+  bvh.Clear();
+  EXPECT_EQ(0U, bvh.GetPrimitiveCount());
+  EXPECT_TRUE(bvh.GetNodes().empty());
+}
+
+TEST(BoundingVolumeHierarchy, Parallel) {
+  const std::vector<Range3f> bounds = BuildGrid(40, 20, 20);
+  BoundingVolumeHierarchy serial;
+  serial.Build(bounds.data(), bounds.size(), nullptr);
+  base::TaskScheduler scheduler("bvh", 3U);
+  BoundingVolumeHierarchy parallel;
+  parallel.Build(bounds.data(), bounds.size(), &scheduler);
+  CheckTree(parallel, bounds);
+
+  // Both trees must be identical.
+  ASSERT_EQ(serial.GetNodes().size(), parallel.GetNodes().size());
+  for (size_t i = 0; i < serial.GetNodes().size(); ++i) {
+    EXPECT_EQ(serial.GetNodes()[i].bounds, parallel.GetNodes()[i].bounds);
+    EXPECT_EQ(serial.GetNodes()[i].offset, parallel.GetNodes()[i].offset);
+    EXPECT_EQ(serial.GetNodes()[i].primitive_count,
+              parallel.GetNodes()[i].primitive_count);
+  }
+  EXPECT_TRUE(std::equal(serial.GetPrimitiveIndices().begin(),
+                         serial.GetPrimitiveIndices().end(),
+                         parallel.GetPrimitiveIndices().begin()));
+}
+
+TEST(BoundingVolumeHierarchy, IntersectRay) {
+  const std::vector<Range3f> bounds = BuildGrid(8, 8, 8);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(bounds.data(), bounds.size(), nullptr);
+
+  // A ray along +z through the cubes at x = 3, y = 5 hits the one at z = 0
+  // first.
+  Point3f origin(6.5f, 10.5f, -4.f);
+  Vector3f direction(0.f, 0.f, 2.f);
+  float distance = -1.f;
+  int tested = 0;
+  const BoundingVolumeHierarchy::RayIntersector hit_bounds =
+      HitBounds(bounds, origin, direction);
+  size_t hit = bvh.IntersectRay(origin, direction, 100.f,
+                                [&](size_t primitive, float* d) {
+                                  ++tested;
+                                  return hit_bounds(primitive, d);
+                                },
+                                &distance);
+  EXPECT_EQ(5U * 8U + 3U, hit);
+  EXPECT_FLOAT_EQ(2.f, distance);
+  // Front-to-back traversal skips most of the column.
+  EXPECT_LT(tested, 8);
+
+  // The same ray backwards hits the cube at z = 7.
+  origin.Set(6.5f, 10.5f, 20.f);
+  direction.Set(0.f, 0.f, -1.f);
+  hit = bvh.IntersectRay(origin, direction, 100.f,
+                         HitBounds(bounds, origin, direction), &distance);
+  EXPECT_EQ(7U * 64U + 5U * 8U + 3U, hit);
+  EXPECT_FLOAT_EQ(5.f, distance);
+
+  // Nothing is hit if |max_distance| is too small, or between the cubes.
+  EXPECT_EQ(base::kInvalidIndex,
+            bvh.IntersectRay(origin, direction, 4.f,
+                             HitBounds(bounds, origin, direction), nullptr));
+  origin.Set(7.5f, 10.5f, 20.f);
+  EXPECT_EQ(base::kInvalidIndex,
+            bvh.IntersectRay(origin, direction, 100.f,
+                             HitBounds(bounds, origin, direction), nullptr));
+
+  // A diagonal ray must find the same cube as testing all of them.
+  origin.Set(-1.f, -2.f, -3.f);
+  direction.Set(1.f, 1.1f, 1.2f);
+  const BoundingVolumeHierarchy::RayIntersector all =
+      HitBounds(bounds, origin, direction);
+  size_t expected = base::kInvalidIndex;
+  float expected_distance = 1000.f;
+  for (size_t i = 0; i < bounds.size(); ++i) {
+    if (all(i, &expected_distance))
+      expected = i;
+  }
+  ASSERT_NE(base::kInvalidIndex, expected);
+  EXPECT_EQ(expected, bvh.IntersectRay(origin, direction, 1000.f, all,
+                                       &distance));
+  EXPECT_FLOAT_EQ(expected_distance, distance);
+}
+
+TEST(BoundingVolumeHierarchy, FindInRangeAndFrustum) {
+  const std::vector<Range3f> bounds = BuildGrid(10, 10, 10);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(bounds.data(), bounds.size(), nullptr);
+
+  const Range3f range(Point3f(2.5f, 3.f, -1.f), Point3f(9.f, 6.5f, 4.5f));
+  std::vector<size_t> found;
+  bvh.FindInRange(range, Collect(&found));
+  std::sort(found.begin(), found.end());
+  EXPECT_EQ(FindAll(bounds, [&range](const Range3f& r) {
+              return range.IntersectsRange(r);
+            }), found);
+  EXPECT_FALSE(found.empty());
+
+  // A frustum looking down -z from above the middle of the grid.
+  const Frustumf frustum(
+      PerspectiveMatrixFromView(Anglef::FromDegrees(30.f), 1.f, 1.f, 100.f) *
+      LookAtMatrixFromCenter(Point3f(9.5f, 9.5f, 40.f),
+                             Point3f(9.5f, 9.5f, 0.f), Vector3f::AxisY()));
+  found.clear();
+  bvh.FindInFrustum(frustum, Collect(&found));
+  std::sort(found.begin(), found.end());
+  const std::vector<size_t> expected =
+      FindAll(bounds, [&frustum](const Range3f& r) {
+        return TestRange(frustum, r) != kOutsideFrustum;
+      });
+  EXPECT_EQ(expected, found);
+  EXPECT_FALSE(found.empty());
+  EXPECT_LT(found.size(), bounds.size());
+}
+
+TEST(BoundingVolumeHierarchy, Refit) {
+  std::vector<Range3f> bounds = BuildGrid(6, 6, 6);
+  BoundingVolumeHierarchy bvh;
+  bvh.Build(bounds.data(), bounds.size(), nullptr);
+
+  // Move everything up by 100.
+  for (Range3f& r : bounds) {
+    r.Set(r.GetMinPoint() + Vector3f(0.f, 100.f, 0.f),
+          r.GetMaxPoint() + Vector3f(0.f, 100.f, 0.f));
+  }
+  bvh.Refit(bounds.data(), bounds.size());
+  CheckTree(bvh, bounds);
+  EXPECT_EQ(Range3f(Point3f(0.f, 100.f, 0.f), Point3f(11.f, 111.f, 11.f)),
+            bvh.GetNodes()[0].bounds);
+  std::vector<size_t> found;
+  bvh.FindInRange(bounds[42], Collect(&found));
+  EXPECT_EQ(std::vector<size_t>(1U, 42U), found);
+
+  base::LogChecker log_checker;
+  bvh.Refit(bounds.data(), 3U);
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "built for 216 primitives"));
+}
+
+}  // namespace math
+}  // namespace ion
@@ -0,0 +1,152 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/fastmath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+TEST(FastMath, SineAndCosine) {
+  double max_error = 0.0;
+  for (int i = -200000; i <= 200000; ++i) {
+    const float radians = static_cast<float>(i) * (kMaxFastRadians / 200000.f);
+    float s, c;
+    FastSineAndCosine(radians, &s, &c);
+    max_error = std::max(max_error,
+                         std::abs(s - std::sin(static_cast<double>(radians))));
+    max_error = std::max(max_error,
+                         std::abs(c - std::cos(static_cast<double>(radians))));
+    EXPECT_EQ(s, FastSine(radians));
+    EXPECT_EQ(c, FastCosine(radians));
+  }
+  EXPECT_LT(max_error, 1e-7);
+
+  // Exact values at multiples of pi/2.
+  float s, c;
+  FastSineAndCosine(0.f, &s, &c);
+  EXPECT_EQ(0.f, s);
+  EXPECT_EQ(1.f, c);
+  FastSineAndCosine(static_cast<float>(M_PI_2), &s, &c);
+  EXPECT_EQ(1.f, s);
+  EXPECT_NEAR(0.f, c, 1e-7f);
+  FastSineAndCosine(static_cast<float>(-M_PI), &s, &c);
+  EXPECT_NEAR(0.f, s, 1e-7f);
+  EXPECT_EQ(-1.f, c);
+
+  // Values out of range use the C library.
+  FastSineAndCosine(1e6f, &s, &c);
+  EXPECT_EQ(sinf(1e6f), s);
+  EXPECT_EQ(cosf(1e6f), c);
+  FastSineAndCosine(std::numeric_limits<float>::quiet_NaN(), &s, &c);
+  EXPECT_TRUE(std::isnan(s));
+  EXPECT_TRUE(std::isnan(c));
+}
+
+TEST(FastMath, ArcTangent2) {
+  double max_error = 0.0;
+  for (int i = -300; i <= 300; ++i) {
+    for (int j = -300; j <= 300; ++j) {
+      const float y = static_cast<float>(i) * 0.37f;
+      const float x = static_cast<float>(j) * 0.29f;
+      if (x == 0.f && y == 0.f)
+        continue;
+      max_error = std::max(
+          max_error, std::abs(FastArcTangent2(y, x) -
+                              std::atan2(static_cast<double>(y),
+                                         static_cast<double>(x))));
+    }
+  }
+  EXPECT_LT(max_error, 4e-7);
+  EXPECT_EQ(0.f, FastArcTangent2(0.f, 0.f));
+  EXPECT_EQ(0.f, FastArcTangent2(0.f, 2.f));
+  EXPECT_FLOAT_EQ(static_cast<float>(M_PI), FastArcTangent2(0.f, -2.f));
+  EXPECT_FLOAT_EQ(static_cast<float>(-M_PI_2), FastArcTangent2(-3.f, 0.f));
+}
+
+TEST(FastMath, InverseSqrt) {
+  double max_error = 0.0;
+  for (int e = -100; e <= 100; ++e) {
+    for (int i = 0; i < 1000; ++i) {
+      const float x =
+          std::ldexp(1.f + static_cast<float>(i) / 1000.f, e);
+      max_error = std::max(
+          max_error,
+          std::abs(FastInverseSqrt(x) * std::sqrt(static_cast<double>(x)) -
+                   1.0));
+    }
+  }
+  EXPECT_LT(max_error, 2e-7);
+  EXPECT_FLOAT_EQ(0.5f, FastInverseSqrt(4.f));
+}
+
+TEST(FastMath, Arrays) {
+  // The array versions must match the scalar ones exactly, including the
+  // values that do not fill a SIMD register and those out of range.
+  const size_t kCount = 103U;
+  std::vector<float> radians(kCount);
+  std::vector<float> values(kCount);
+  for (size_t i = 0; i < kCount; ++i) {
+    radians[i] = (static_cast<float>(i) - 50.f) * 0.731f;
+    values[i] = static_cast<float>(i) * 0.37f + 0.01f;
+  }
+  radians[5] = 1e6f;
+  std::vector<float> sines(kCount);
+  std::vector<float> cosines(kCount);
+  FastSinesAndCosines(radians.data(), kCount, sines.data(), cosines.data());
+  std::vector<float> inverse_sqrts(kCount);
+  FastInverseSqrts(values.data(), kCount, inverse_sqrts.data());
+  for (size_t i = 0; i < kCount; ++i) {
+    float s, c;
+    FastSineAndCosine(radians[i], &s, &c);
+    EXPECT_EQ(s, sines[i]) << i;
+    EXPECT_EQ(c, cosines[i]) << i;
+    EXPECT_EQ(FastInverseSqrt(values[i]), inverse_sqrts[i]) << i;
+  }
+
+  // The result may be the input.
+  FastInverseSqrts(values.data(), kCount, values.data());
+  EXPECT_EQ(inverse_sqrts, values);
+}
+
+TEST(FastMath, Switchable) {
+  float s, c;
+  SineAndCosine(Anglef::FromDegrees(30.f), &s, &c);
+  EXPECT_NEAR(0.5f, s, 1e-7f);
+  EXPECT_NEAR(std::sqrt(3.f) / 2.f, c, 1e-7f);
+  // Doubles always use the C library.
+  const Angled angle = Angled::FromDegrees(30.0);
+  double sd, cd;
+  SineAndCosine(angle, &sd, &cd);
+  EXPECT_EQ(std::sin(angle.Radians()), sd);
+  EXPECT_EQ(std::cos(angle.Radians()), cd);
+  EXPECT_NEAR(0.25f, InverseSqrt(16.f), 1e-7f);
+  EXPECT_EQ(0.25, InverseSqrt(16.0));
+#if !defined(ION_MATH_USE_FAST_MATH)
+  EXPECT_EQ(sinf(0.3f), (SineAndCosine(0.3f, &s, &c), s));
+  EXPECT_EQ(1.f / sqrtf(3.f), InverseSqrt(3.f));
+#endif
+}
+
+}  // namespace math
+}  // namespace ion
@@ -0,0 +1,116 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/frustum.h"
+
+#include <sstream>
+
+#include "ion/math/transformutils.h"
+#include "ion/math/vectorutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+namespace {
+
+// Returns whether two planes are within a tolerance of each other.
+static bool PlanesAlmostEqual(const Planef& p0, const Planef& p1) {
+  static const float kTolerance = 1e-5f;
+  return VectorsAlmostEqual(p0.GetNormal(), p1.GetNormal(), kTolerance) &&
+         Abs(p0.GetOffset() - p1.GetOffset()) <= kTolerance;
+}
+
+}  // anonymous namespace
+
+TEST(Frustum, Orthographic) {
+  // The box [-1, 3] x [-2, 2] x [-10, -1] in eye coordinates.
+  const Frustumf f(OrthographicMatrixFromFrustum(-1.f, 3.f, -2.f, 2.f, 1.f,
+                                                 10.f));
+  EXPECT_PRED2(PlanesAlmostEqual, Planef(Vector3f(1.f, 0.f, 0.f), 1.f),
+               f.GetPlane(Frustumf::kLeft));
+  EXPECT_PRED2(PlanesAlmostEqual, Planef(Vector3f(-1.f, 0.f, 0.f), 3.f),
+               f.GetPlane(Frustumf::kRight));
+  EXPECT_PRED2(PlanesAlmostEqual, Planef(Vector3f(0.f, 1.f, 0.f), 2.f),
+               f.GetPlane(Frustumf::kBottom));
+  EXPECT_PRED2(PlanesAlmostEqual, Planef(Vector3f(0.f, -1.f, 0.f), 2.f),
+               f.GetPlane(Frustumf::kTop));
+  EXPECT_PRED2(PlanesAlmostEqual, Planef(Vector3f(0.f, 0.f, -1.f), -1.f),
+               f.GetPlane(Frustumf::kNear));
+  EXPECT_PRED2(PlanesAlmostEqual, Planef(Vector3f(0.f, 0.f, 1.f), 10.f),
+               f.GetPlane(Frustumf::kFar));
+
+  EXPECT_TRUE(f.ContainsPoint(Point3f(0.f, 0.f, -5.f)));
+  EXPECT_TRUE(f.ContainsPoint(Point3f(2.9f, -1.9f, -9.9f)));
+  EXPECT_FALSE(f.ContainsPoint(Point3f(-1.1f, 0.f, -5.f)));
+  EXPECT_FALSE(f.ContainsPoint(Point3f(0.f, 2.1f, -5.f)));
+  EXPECT_FALSE(f.ContainsPoint(Point3f(0.f, 0.f, -0.9f)));
+  EXPECT_FALSE(f.ContainsPoint(Point3f(0.f, 0.f, -10.1f)));
+}
+
+TEST(Frustum, PerspectiveAndView) {
+  const Matrix4f proj = PerspectiveMatrixFromView(Anglef::FromDegrees(90.f),
+                                                  1.f, 1.f, 100.f);
+  // Look down the +x axis from (5, 0, 0).
+  const Matrix4f view = LookAtMatrixFromCenter(
+      Point3f(5.f, 0.f, 0.f), Point3f(6.f, 0.f, 0.f), Vector3f::AxisY());
+  const Frustumf f(proj * view);
+  // The planes are normalized.
+  for (int i = 0; i < Frustumf::kNumPlanes; ++i) {
+    EXPECT_NEAR(1.f, Length(f.GetPlane(
+        static_cast<Frustumf::PlaneIndex>(i)).GetNormal()), 1e-5f);
+  }
+  EXPECT_PRED2(PlanesAlmostEqual, Planef(Vector3f(1.f, 0.f, 0.f), -6.f),
+               f.GetPlane(Frustumf::kNear));
+  EXPECT_NEAR(95.f, f.GetPlane(Frustumf::kFar).GetSignedDistance(
+      Point3f(10.f, 0.f, 0.f)), 1e-3f);
+  // A 90 degree field of view gives 45 degree side planes.
+  EXPECT_NEAR(0.f, f.GetPlane(Frustumf::kTop).GetSignedDistance(
+      Point3f(15.f, 10.f, 0.f)), 1e-4f);
+
+  EXPECT_TRUE(f.ContainsPoint(Point3f(50.f, 10.f, -10.f)));
+  EXPECT_FALSE(f.ContainsPoint(Point3f(50.f, 50.f, 0.f)));
+  EXPECT_FALSE(f.ContainsPoint(Point3f(0.f, 0.f, 0.f)));
+  EXPECT_FALSE(f.ContainsPoint(Point3f(200.f, 0.f, 0.f)));
+}
+
+TEST(Frustum, SetPlaneAndCompare) {
+  Frustumd f;
+  // The default frustum contains everything.
+  EXPECT_TRUE(f.ContainsPoint(Point3d(1e10, -1e10, 3.0)));
+  const Frustumd copy = f;
+  EXPECT_EQ(copy, f);
+  f.SetPlane(Frustumd::kNear, Planed(Vector3d(0.0, 0.0, -1.0), -1.0));
+  EXPECT_NE(copy, f);
+  EXPECT_EQ(Planed(Vector3d(0.0, 0.0, -1.0), -1.0),
+            f.GetPlane(Frustumd::kNear));
+  EXPECT_FALSE(f.ContainsPoint(Point3d(0.0, 0.0, 0.0)));
+  EXPECT_TRUE(f.ContainsPoint(Point3d(0.0, 0.0, -2.0)));
+}
+
+TEST(Frustum, Print) {
+  Frustumf f;
+  f.SetPlane(Frustumf::kFar, Planef(Vector3f(0.f, 0.f, 1.f), 2.f));
+  std::ostringstream out;
+  out << f;
+  EXPECT_EQ("FRUSTUM[PLANE[V[0, 0, 0], 0], PLANE[V[0, 0, 0], 0], "
+            "PLANE[V[0, 0, 0], 0], PLANE[V[0, 0, 0], 0], "
+            "PLANE[V[0, 0, 0], 0], PLANE[V[0, 0, 1], 2]]", out.str());
+}
+
+}  // namespace math
+}  // namespace ion
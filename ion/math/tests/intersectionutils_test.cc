@@ -0,0 +1,194 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/intersectionutils.h"
+
+#include <vector>
+
+#include "ion/math/matrixutils.h"
+#include "ion/math/transformutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+namespace {
+
+// Returns the frustum of the box [-1, 3] x [-2, 2] x [-10, -1].
+static const Frustumf GetBoxFrustum() {
+  return Frustumf(OrthographicMatrixFromFrustum(-1.f, 3.f, -2.f, 2.f, 1.f,
+                                                10.f));
+}
+
+// Returns a perspective frustum looking down -z from the origin.
+static const Frustumf GetPerspectiveFrustum() {
+  return Frustumf(PerspectiveMatrixFromView(Anglef::FromDegrees(60.f), 1.5f,
+                                            0.5f, 50.f));
+}
+
+}  // anonymous namespace
+
+TEST(IntersectionUtils, TestRange) {
+  const Frustumf f = GetBoxFrustum();
+  EXPECT_EQ(kOutsideFrustum, TestRange(f, Range3f()));
+  EXPECT_EQ(kInsideFrustum,
+            TestRange(f, Range3f(Point3f(0.f, -1.f, -5.f),
+                                 Point3f(1.f, 1.f, -3.f))));
+  EXPECT_EQ(kIntersectsFrustum,
+            TestRange(f, Range3f(Point3f(2.f, -1.f, -5.f),
+                                 Point3f(4.f, 1.f, -3.f))));
+  EXPECT_EQ(kIntersectsFrustum,
+            TestRange(f, Range3f(Point3f(-5.f, -5.f, -20.f),
+                                 Point3f(5.f, 5.f, 0.f))));
+  EXPECT_EQ(kOutsideFrustum,
+            TestRange(f, Range3f(Point3f(3.5f, -1.f, -5.f),
+                                 Point3f(4.f, 1.f, -3.f))));
+  EXPECT_EQ(kOutsideFrustum,
+            TestRange(f, Range3f(Point3f(0.f, 0.f, 1.f),
+                                 Point3f(1.f, 1.f, 2.f))));
+}
+
+TEST(IntersectionUtils, TestSphere) {
+  const Frustumf f = GetBoxFrustum();
+  EXPECT_EQ(kOutsideFrustum, TestSphere(f, Spheref()));
+  EXPECT_EQ(kInsideFrustum,
+            TestSphere(f, Spheref(Point3f(1.f, 0.f, -5.f), 1.f)));
+  EXPECT_EQ(kIntersectsFrustum,
+            TestSphere(f, Spheref(Point3f(1.f, 0.f, -5.f), 2.5f)));
+  EXPECT_EQ(kIntersectsFrustum,
+            TestSphere(f, Spheref(Point3f(1.f, 0.f, 0.f), 2.f)));
+  EXPECT_EQ(kOutsideFrustum,
+            TestSphere(f, Spheref(Point3f(1.f, 0.f, 0.f), 0.5f)));
+  EXPECT_EQ(kOutsideFrustum,
+            TestSphere(f, Spheref(Point3f(-3.f, 0.f, -5.f), 1.9f)));
+}
+
+TEST(IntersectionUtils, TestOrientedBox) {
+  EXPECT_EQ(kOutsideFrustum, TestOrientedBox(GetBoxFrustum(), OrientedBoxf()));
+  // Rotate the box frustum by 45 degrees around z. A long, flat box that is
+  // rotated with it fits inside, but its axis-aligned bounds do not.
+  const Matrix4f rotation =
+      RotationMatrixAxisAngleH(Vector3f::AxisZ(), Anglef::FromDegrees(45.f));
+  const Frustumf f(OrthographicMatrixFromFrustum(-1.f, 3.f, -2.f, 2.f, 1.f,
+                                                 10.f) * Inverse(rotation));
+  const Range3f range(Point3f(-1.95f, -0.1f, -1.f),
+                      Point3f(1.95f, 0.1f, 1.f));
+  const Matrix4f m = rotation * TranslationMatrix(Vector3f(1.f, 0.f, -5.f));
+  EXPECT_EQ(kInsideFrustum,
+            TestOrientedBox(f, OrientedBoxf::FromRange(range, m)));
+  Range3f bounds;
+  for (int corner = 0; corner < 8; ++corner) {
+    bounds.ExtendByPoint(m * Point3f(
+        (corner & 1) ? range.GetMaxPoint()[0] : range.GetMinPoint()[0],
+        (corner & 2) ? range.GetMaxPoint()[1] : range.GetMinPoint()[1],
+        (corner & 4) ? range.GetMaxPoint()[2] : range.GetMinPoint()[2]));
+  }
+  EXPECT_EQ(kIntersectsFrustum, TestRange(f, bounds));
+
+  // Moving the box along its length makes it stick out of the frustum, and
+  // then moves it out completely.
+  EXPECT_EQ(kIntersectsFrustum, TestOrientedBox(f, OrientedBoxf::FromRange(
+      range, rotation * TranslationMatrix(Vector3f(2.f, 0.f, -5.f)))));
+  EXPECT_EQ(kOutsideFrustum, TestOrientedBox(f, OrientedBoxf::FromRange(
+      range, rotation * TranslationMatrix(Vector3f(6.f, 0.f, -5.f)))));
+}
+
+TEST(IntersectionUtils, SpheresAndRanges) {
+  const Spheref s(Point3f(0.f, 0.f, 0.f), 1.f);
+  EXPECT_TRUE(SpheresIntersect(s, Spheref(Point3f(1.5f, 0.f, 0.f), 1.f)));
+  EXPECT_TRUE(SpheresIntersect(s, Spheref(Point3f(0.f, 2.f, 0.f), 1.f)));
+  EXPECT_FALSE(SpheresIntersect(s, Spheref(Point3f(0.f, 2.1f, 0.f), 1.f)));
+  EXPECT_FALSE(SpheresIntersect(s, Spheref()));
+  EXPECT_FALSE(SpheresIntersect(Spheref(), s));
+
+  EXPECT_TRUE(SphereIntersectsRange(
+      s, Range3f(Point3f(-0.5f, -0.5f, -0.5f), Point3f(0.5f, 0.5f, 0.5f))));
+  EXPECT_TRUE(SphereIntersectsRange(
+      s, Range3f(Point3f(0.5f, -4.f, -4.f), Point3f(4.f, 4.f, 4.f))));
+  // The corner of the box is sqrt(3) * 0.7 > 1 away from the center.
+  EXPECT_FALSE(SphereIntersectsRange(
+      s, Range3f(Point3f(0.7f, 0.7f, 0.7f), Point3f(4.f, 4.f, 4.f))));
+  EXPECT_FALSE(SphereIntersectsRange(s, Range3f()));
+  EXPECT_FALSE(SphereIntersectsRange(
+      Spheref(), Range3f(Point3f::Zero(), Point3f::Zero())));
+}
+
+TEST(IntersectionUtils, TestRangesAgainstFrustum) {
+  const Frustumf f = GetPerspectiveFrustum();
+  // A grid of boxes of varying sizes, some of which are empty.
+  std::vector<Range3f> ranges;
+  std::vector<Spheref> spheres;
+  for (int z = 0; z < 12; ++z) {
+    for (int y = -4; y <= 4; ++y) {
+      for (int x = -4; x <= 4; ++x) {
+        const Point3f center(static_cast<float>(x) * 4.f,
+                             static_cast<float>(y) * 3.f,
+                             -4.5f * static_cast<float>(z) + 2.f);
+        const float size = 0.25f * static_cast<float>((x + y + z) & 7);
+        if ((x + 2 * y + z) % 11 == 0) {
+          ranges.push_back(Range3f());
+          spheres.push_back(Spheref());
+        } else {
+          ranges.push_back(Range3f(center - Vector3f::Fill(size),
+                                   center + Vector3f::Fill(size)));
+          spheres.push_back(Spheref(center, size));
+        }
+      }
+    }
+  }
+  const size_t count = ranges.size();
+  ASSERT_NE(0U, count % 32U);
+
+  // The bits match the results of testing the volumes one at a time.
+  std::vector<uint32> bits((count + 31U) / 32U, 0xffffffffU);
+  size_t expected_count = 0;
+  size_t outside_count = 0;
+  EXPECT_NE(0U, TestRangesAgainstFrustum(f, ranges.data(), count,
+                                         bits.data()));
+  for (size_t i = 0; i < count; ++i) {
+    const bool visible = TestRange(f, ranges[i]) != kOutsideFrustum;
+    EXPECT_EQ(visible, (bits[i / 32U] & (1U << (i % 32U))) != 0U) << i;
+    if (visible)
+      ++expected_count;
+    else
+      ++outside_count;
+  }
+  EXPECT_EQ(expected_count,
+            TestRangesAgainstFrustum(f, ranges.data(), count, bits.data()));
+  EXPECT_NE(0U, outside_count);
+  // Bits past the last volume are cleared.
+  EXPECT_EQ(0U, bits.back() >> (count % 32U));
+
+  expected_count = 0;
+  EXPECT_NE(0U, TestSpheresAgainstFrustum(f, spheres.data(), count,
+                                          bits.data()));
+  for (size_t i = 0; i < count; ++i) {
+    const bool visible = TestSphere(f, spheres[i]) != kOutsideFrustum;
+    EXPECT_EQ(visible, (bits[i / 32U] & (1U << (i % 32U))) != 0U) << i;
+    if (visible)
+      ++expected_count;
+  }
+  EXPECT_EQ(expected_count,
+            TestSpheresAgainstFrustum(f, spheres.data(), count, bits.data()));
+
+  // Nothing is written for no volumes.
+  EXPECT_EQ(0U, TestRangesAgainstFrustum(f, NULL, 0U, NULL));
+  EXPECT_EQ(0U, TestSpheresAgainstFrustum(f, NULL, 0U, NULL));
+}
+
+}  // namespace math
+}  // namespace ion
@@ -25,12 +25,20 @@
       'sources' : [
         'angle_test.cc',
         'angleutils_test.cc',
+        'boundingvolumehierarchy_test.cc',
+        'fastmath_test.cc',
         'fieldofview_test.cc',
+        'frustum_test.cc',
+        'intersectionutils_test.cc',
         'matrix_test.cc',
         'matrixutils_test.cc',
+        'orientedbox_test.cc',
+        'plane_test.cc',
         'range_test.cc',
         'rangeutils_test.cc',
         'rotation_test.cc',
+        'sphere_test.cc',
+        'transformkernels_test.cc',
         'transformutils_test.cc',
         'utils_test.cc',
         'vector_test.cc',
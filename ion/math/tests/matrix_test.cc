@@ -227,6 +227,21 @@ TEST(Matrix, Identity) {
                      0.0, 0.0, 0.0, 1.0), Matrix4d::Identity());
 }
 
+TEST(Matrix, Constexpr) {
+  // These are initialized at compile time, or the build fails.
+  static constexpr Matrix4f kIdentity = Matrix4f::Identity();
+  static constexpr Matrix3d kZero = Matrix3d::Zero();
+  static constexpr Matrix2f kRotation(0.f, -1.f,
+                                      1.f, 0.f);
+  EXPECT_EQ(Matrix4f::Identity(), kIdentity);
+  EXPECT_EQ(Matrix3d::Zero(), kZero);
+  EXPECT_EQ(-1.f, kRotation(0, 1));
+  EXPECT_EQ(1.f, kRotation(1, 0));
+
+  // Dimensions without element constructors still have an identity.
+  EXPECT_EQ(1, (Matrix<1, int>::Identity()(0, 0)));
+}
+
 TEST(Matrix, Data) {
   Matrix2f m2f(4.0, -5.0, 6.0, -7.0);
   EXPECT_EQ(4.0, m2f.Data()[0]);
@@ -198,6 +198,59 @@ TEST(MatrixUtils, Inverse) {
   }
 }
 
+TEST(MatrixUtils, Matrix4fMatchesMatrix4d) {
+  // Matrix4f operations may use SIMD instructions, while Matrix4d always uses
+  // the generic code. Check that both compute the same thing for a matrix
+  // with distinct elements in every position.
+  const Matrix4d m0(1.0, 4.0, -1.0, 0.5,
+                    2.0, 3.0, 5.0, -2.0,
+                    0.25, 3.0, 1.0, 6.0,
+                    3.0, -7.0, 2.0, 1.0);
+  const Matrix4d m1(-2.0, 0.5, 8.0, 1.0,
+                    4.0, 1.5, -3.0, 2.0,
+                    7.0, -1.0, 0.75, 9.0,
+                    -6.0, 2.5, 1.25, -4.0);
+  const Matrix4f f0(m0);
+  const Matrix4f f1(m1);
+  const float kTolerance = 1e-4f;
+
+  EXPECT_PRED3((MatricesAlmostEqual<4, float>),
+               Matrix4f(m0 * m1), f0 * f1, kTolerance);
+  Matrix4f product = f1;
+  product *= f0;
+  EXPECT_PRED3((MatricesAlmostEqual<4, float>),
+               Matrix4f(m1 * m0), product, kTolerance);
+  EXPECT_EQ(Matrix4f(Transpose(m0)), Transpose(f0));
+
+  const Vector4d v(1.5, -2.0, 3.0, 0.5);
+  EXPECT_PRED3((VectorsAlmostEqual<4, float>),
+               Vector4f(m0 * v), f0 * Vector4f(v), kTolerance);
+  const Point4d p(-1.0, 2.5, 4.0, 1.0);
+  EXPECT_PRED3((PointsAlmostEqual<4, float>),
+               Point4f(m0 * p), f0 * Point4f(p), kTolerance);
+
+  double det_d;
+  float det_f;
+  EXPECT_PRED3((MatricesAlmostEqual<4, float>),
+               Matrix4f(AdjugateWithDeterminant(m0, &det_d)),
+               AdjugateWithDeterminant(f0, &det_f), kTolerance);
+  EXPECT_NEAR(det_d, det_f, kTolerance);
+  EXPECT_PRED3((MatricesAlmostEqual<4, float>),
+               Matrix4f(InverseWithDeterminant(m1, &det_d)),
+               InverseWithDeterminant(f1, &det_f), kTolerance);
+  EXPECT_NEAR(det_d, det_f, kTolerance);
+  EXPECT_PRED3((MatricesAlmostEqual<4, float>),
+               Matrix4f::Identity(), f0 * Inverse(f0), kTolerance);
+
+  // A singular matrix has a zero inverse.
+  const Matrix4f singular(1.f, 2.f, 3.f, 4.f,
+                          2.f, 4.f, 6.f, 8.f,
+                          0.f, 1.f, 0.f, 1.f,
+                          5.f, 6.f, 7.f, 8.f);
+  EXPECT_EQ(Matrix4f::Zero(), InverseWithDeterminant(singular, &det_f));
+  EXPECT_EQ(0.f, det_f);
+}
+
 TEST(MatrixUtils, MatricesAlmostEqual) {
   EXPECT_TRUE(MatricesAlmostEqual(Matrix2f(1.0f, 2.0f, 3.0f, -4.0f),
                                   Matrix2f(1.0f, 2.0f, 3.0f, -4.0f), 0.0f));
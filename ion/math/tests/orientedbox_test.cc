@@ -0,0 +1,122 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/orientedbox.h"
+
+#include <sstream>
+
+#include "ion/math/matrixutils.h"
+#include "ion/math/tests/testutils.h"
+#include "ion/math/transformutils.h"
+#include "ion/math/vectorutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+TEST(OrientedBox, Construct) {
+  const OrientedBoxf empty;
+  EXPECT_TRUE(empty.IsEmpty());
+  EXPECT_FALSE(empty.ContainsPoint(Point3f::Zero()));
+  EXPECT_EQ(Matrix3f::Identity(), empty.GetAxes());
+
+  const Matrix3f axes(0.f, -1.f, 0.f,
+                      1.f, 0.f, 0.f,
+                      0.f, 0.f, 1.f);
+  OrientedBoxf box(Point3f(1.f, 2.f, 3.f), axes, Vector3f(1.f, 2.f, 3.f));
+  EXPECT_FALSE(box.IsEmpty());
+  EXPECT_EQ(Point3f(1.f, 2.f, 3.f), box.GetCenter());
+  EXPECT_EQ(axes, box.GetAxes());
+  EXPECT_EQ(Vector3f(1.f, 2.f, 3.f), box.GetHalfSize());
+  EXPECT_EQ(Vector3f(0.f, 1.f, 0.f), box.GetAxis(0));
+  EXPECT_EQ(Vector3f(-1.f, 0.f, 0.f), box.GetAxis(1));
+  EXPECT_EQ(Vector3f(0.f, 0.f, 1.f), box.GetAxis(2));
+  EXPECT_NE(empty, box);
+
+  const OrientedBoxf copy = box;
+  box.SetCenter(Point3f::Zero());
+  box.SetAxes(Matrix3f::Identity());
+  box.SetHalfSize(Vector3f(1.f, 1.f, 0.f));
+  EXPECT_NE(copy, box);
+  EXPECT_EQ(OrientedBoxf(Point3f::Zero(), Matrix3f::Identity(),
+                         Vector3f(1.f, 1.f, 0.f)), box);
+  EXPECT_FALSE(box.IsEmpty());
+}
+
+TEST(OrientedBox, ContainsPoint) {
+  // A box rotated by 90 degrees around z, so that its first axis is y.
+  const OrientedBoxd box(Point3d(1.0, 2.0, 3.0),
+                         Matrix3d(0.0, -1.0, 0.0,
+                                  1.0, 0.0, 0.0,
+                                  0.0, 0.0, 1.0),
+                         Vector3d(1.0, 2.0, 3.0));
+  EXPECT_TRUE(box.ContainsPoint(Point3d(1.0, 2.0, 3.0)));
+  EXPECT_TRUE(box.ContainsPoint(Point3d(1.0, 3.0, 3.0)));
+  EXPECT_TRUE(box.ContainsPoint(Point3d(-1.0, 2.0, 6.0)));
+  EXPECT_FALSE(box.ContainsPoint(Point3d(1.0, 3.5, 3.0)));
+  EXPECT_FALSE(box.ContainsPoint(Point3d(3.5, 2.0, 3.0)));
+  EXPECT_FALSE(box.ContainsPoint(Point3d(1.0, 2.0, -0.5)));
+}
+
+TEST(OrientedBox, FromRange) {
+  EXPECT_TRUE(
+      OrientedBoxf::FromRange(Range3f(), Matrix4f::Identity()).IsEmpty());
+
+  const Range3f range(Point3f(-1.f, 0.f, 2.f), Point3f(1.f, 4.f, 8.f));
+  EXPECT_EQ(OrientedBoxf(Point3f(0.f, 2.f, 5.f), Matrix3f::Identity(),
+                         Vector3f(1.f, 2.f, 3.f)),
+            OrientedBoxf::FromRange(range, Matrix4f::Identity()));
+
+  // The scale moves into the half size, and the rotation into the axes.
+  const Matrix4f m =
+      TranslationMatrix(Vector3f(10.f, 0.f, 0.f)) *
+      RotationMatrixAxisAngleH(Vector3f::AxisZ(), Anglef::FromDegrees(90.f)) *
+      ScaleMatrixH(Vector3f(2.f, 3.f, 0.5f));
+  const OrientedBoxf box = OrientedBoxf::FromRange(range, m);
+  EXPECT_PRED3((PointsAlmostEqual<3, float>), m * range.GetCenter(),
+               box.GetCenter(), 1e-5f);
+  EXPECT_PRED3((VectorsAlmostEqual<3, float>), Vector3f(0.f, 1.f, 0.f),
+               box.GetAxis(0), 1e-5f);
+  EXPECT_PRED3((VectorsAlmostEqual<3, float>), Vector3f(-1.f, 0.f, 0.f),
+               box.GetAxis(1), 1e-5f);
+  EXPECT_PRED3((VectorsAlmostEqual<3, float>), Vector3f(0.f, 0.f, 1.f),
+               box.GetAxis(2), 1e-5f);
+  EXPECT_PRED3((VectorsAlmostEqual<3, float>), Vector3f(2.f, 6.f, 1.5f),
+               box.GetHalfSize(), 1e-5f);
+  // The transformed corners are on the surface of the box.
+  EXPECT_TRUE(box.ContainsPoint(m * Point3f(-0.999f, 0.001f, 2.001f)));
+  EXPECT_TRUE(box.ContainsPoint(m * Point3f(0.999f, 3.999f, 7.999f)));
+  EXPECT_FALSE(box.ContainsPoint(m * Point3f(1.001f, 2.f, 5.f)));
+
+  // A zero scale collapses an axis.
+  const OrientedBoxf flat = OrientedBoxf::FromRange(
+      range, ScaleMatrixH(Vector3f(1.f, 0.f, 1.f)));
+  EXPECT_EQ(Vector3f::AxisY(), flat.GetAxis(1));
+  EXPECT_EQ(Vector3f(1.f, 0.f, 3.f), flat.GetHalfSize());
+  EXPECT_FALSE(flat.IsEmpty());
+}
+
+TEST(OrientedBox, Print) {
+  std::ostringstream out;
+  out << OrientedBoxf(Point3f(1.f, 2.f, 3.f), Matrix3f::Identity(),
+                      Vector3f(4.f, 5.f, 6.f));
+  EXPECT_EQ("OBOX[P[1, 2, 3], M[1, 0, 0 ; 0, 1, 0 ; 0, 0, 1], V[4, 5, 6]]",
+            out.str());
+}
+
+}  // namespace math
+}  // namespace ion
@@ -0,0 +1,75 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/plane.h"
+
+#include <sstream>
+
+#include "ion/math/vector.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+TEST(Plane, Construct) {
+  const Planef empty;
+  EXPECT_EQ(Vector3f::Zero(), empty.GetNormal());
+  EXPECT_EQ(0.f, empty.GetOffset());
+  EXPECT_EQ(0.f, empty.GetSignedDistance(Point3f(1.f, 2.f, 3.f)));
+
+  const Planef p(Vector3f(0.f, 2.f, 0.f), -4.f);
+  EXPECT_EQ(Vector3f(0.f, 2.f, 0.f), p.GetNormal());
+  EXPECT_EQ(-4.f, p.GetOffset());
+  EXPECT_EQ(p, Planef(Vector4f(0.f, 2.f, 0.f, -4.f)));
+  EXPECT_NE(p, Planef(Vector4f(0.f, 2.f, 0.f, 4.f)));
+  EXPECT_NE(p, empty);
+
+  Planef q;
+  q.Set(Vector3f(0.f, 2.f, 0.f), -4.f);
+  EXPECT_EQ(p, q);
+
+  // The plane y = 2 with a normal pointing down.
+  EXPECT_EQ(Planef(Vector3f(0.f, -1.f, 0.f), 2.f),
+            Planef::FromPointAndNormal(Point3f(5.f, 2.f, 7.f),
+                                       Vector3f(0.f, -1.f, 0.f)));
+}
+
+TEST(Plane, SignedDistanceAndNormalize) {
+  Planed p(Vector3d(0.0, 0.0, 2.0), -2.0);
+  // Distances are scaled by the length of the normal.
+  EXPECT_EQ(0.0, p.GetSignedDistance(Point3d(3.0, 4.0, 1.0)));
+  EXPECT_EQ(4.0, p.GetSignedDistance(Point3d(3.0, 4.0, 3.0)));
+  EXPECT_EQ(-2.0, p.GetSignedDistance(Point3d(3.0, 4.0, 0.0)));
+
+  p.Normalize();
+  EXPECT_EQ(Planed(Vector3d(0.0, 0.0, 1.0), -1.0), p);
+  EXPECT_EQ(2.0, p.GetSignedDistance(Point3d(3.0, 4.0, 3.0)));
+
+  // A zero normal is left alone.
+  Planed zero(Vector3d::Zero(), 3.0);
+  zero.Normalize();
+  EXPECT_EQ(Planed(Vector3d::Zero(), 3.0), zero);
+}
+
+TEST(Plane, Print) {
+  std::ostringstream out;
+  out << Planef(Vector3f(1.f, 0.f, 0.f), 2.f);
+  EXPECT_EQ("PLANE[V[1, 0, 0], 2]", out.str());
+}
+
+}  // namespace math
+}  // namespace ion
@@ -0,0 +1,75 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/sphere.h"
+
+#include <sstream>
+
+#include "ion/math/range.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+TEST(Sphere, Construct) {
+  const Spheref empty;
+  EXPECT_TRUE(empty.IsEmpty());
+  EXPECT_EQ(Point3f::Zero(), empty.GetCenter());
+  EXPECT_FALSE(empty.ContainsPoint(Point3f::Zero()));
+
+  Spheref s(Point3f(1.f, 2.f, 3.f), 2.f);
+  EXPECT_FALSE(s.IsEmpty());
+  EXPECT_EQ(Point3f(1.f, 2.f, 3.f), s.GetCenter());
+  EXPECT_EQ(2.f, s.GetRadius());
+  EXPECT_NE(empty, s);
+
+  s.SetCenter(Point3f(0.f, 1.f, 0.f));
+  s.SetRadius(0.f);
+  EXPECT_EQ(Spheref(Point3f(0.f, 1.f, 0.f), 0.f), s);
+  // A sphere of radius 0 contains its center.
+  EXPECT_FALSE(s.IsEmpty());
+  EXPECT_TRUE(s.ContainsPoint(Point3f(0.f, 1.f, 0.f)));
+}
+
+TEST(Sphere, ContainsPoint) {
+  const Sphered s(Point3d(1.0, 1.0, 1.0), 2.0);
+  EXPECT_TRUE(s.ContainsPoint(Point3d(1.0, 1.0, 1.0)));
+  EXPECT_TRUE(s.ContainsPoint(Point3d(3.0, 1.0, 1.0)));
+  EXPECT_TRUE(s.ContainsPoint(Point3d(2.0, 2.0, 2.0)));
+  EXPECT_FALSE(s.ContainsPoint(Point3d(3.0, 2.0, 1.0)));
+  EXPECT_FALSE(s.ContainsPoint(Point3d(-1.5, 1.0, 1.0)));
+}
+
+TEST(Sphere, FromRange) {
+  EXPECT_TRUE(Spheref::FromRange(Range3f()).IsEmpty());
+  EXPECT_EQ(Spheref(Point3f(1.f, 2.f, 3.f), 0.f),
+            Spheref::FromRange(Range3f(Point3f(1.f, 2.f, 3.f),
+                                       Point3f(1.f, 2.f, 3.f))));
+  // The sphere passes through the corners of the box.
+  EXPECT_EQ(Spheref(Point3f(2.f, 3.f, 6.f), 7.f),
+            Spheref::FromRange(Range3f(Point3f(0.f, 0.f, 0.f),
+                                       Point3f(4.f, 6.f, 12.f))));
+}
+
+TEST(Sphere, Print) {
+  std::ostringstream out;
+  out << Spheref(Point3f(1.f, 2.f, 3.f), 4.f);
+  EXPECT_EQ("SPHERE[P[1, 2, 3], 4]", out.str());
+}
+
+}  // namespace math
+}  // namespace ion
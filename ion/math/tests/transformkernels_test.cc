@@ -0,0 +1,287 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/transformkernels.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ion/base/taskscheduler.h"
+#include "ion/math/matrixutils.h"
+#include "ion/math/rangeutils.h"
+#include "ion/math/transformutils.h"
+#include "ion/math/vectorutils.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace math {
+
+namespace {
+
+static const float kTolerance = 1e-4f;
+
+// An affine transformation with rotation, non-uniform scale and translation.
+static const Matrix4f GetAffineMatrix() {
+  return TranslationMatrix(Vector3f(1.f, -2.f, 3.f)) *
+         RotationMatrixAxisAngleH(Normalized(Vector3f(1.f, 2.f, 3.f)),
+                                  Anglef::FromDegrees(30.f)) *
+         ScaleMatrixH(Vector3f(2.f, 0.5f, 1.5f));
+}
+
+static const Matrix4f GetProjectionMatrix() {
+  return PerspectiveMatrixFromView(Anglef::FromDegrees(60.f), 1.5f, 0.1f,
+                                   100.f) * GetAffineMatrix();
+}
+
+// Returns count points with varying coordinates. The z coordinates are
+// negative so that they are in front of the camera of GetProjectionMatrix().
+static const std::vector<Point3f> GetPoints(size_t count) {
+  std::vector<Point3f> points(count);
+  for (size_t i = 0; i < count; ++i) {
+    const float f = static_cast<float>(i);
+    points[i].Set(0.25f * f - 3.f, 4.f - 0.5f * f, -1.f - 0.125f * f);
+  }
+  return points;
+}
+
+// Stores the coordinates of |points| in |x|, |y| and |z| and returns arrays
+// that refer to them.
+static const CoordinateArrays3f ToArrays(const std::vector<Point3f>& points,
+                                         std::vector<float>* x,
+                                         std::vector<float>* y,
+                                         std::vector<float>* z) {
+  x->resize(points.size());
+  y->resize(points.size());
+  z->resize(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    (*x)[i] = points[i][0];
+    (*y)[i] = points[i][1];
+    (*z)[i] = points[i][2];
+  }
+  return CoordinateArrays3f(x->data(), y->data(), z->data());
+}
+
+// Projection divides by homogeneous coordinates that may be small, so the
+// error is relative to the size of the result.
+static bool ProjectedPointsAlmostEqual(const Point3f& p0, const Point3f& p1) {
+  const float size = std::max(1.f, Length(p0 - Point3f::Zero()));
+  return PointsAlmostEqual(p0, p1, kTolerance * 0.1f * size);
+}
+
+}  // anonymous namespace
+
+TEST(TransformKernels, TransformPoints) {
+  const Matrix4f m = GetAffineMatrix();
+  // Use a count that is not a multiple of 4 to test the remainder.
+  const std::vector<Point3f> points = GetPoints(23U);
+  std::vector<Point3f> result(points.size());
+  TransformPoints(m, points.data(), points.size(), result.data(), NULL);
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_PRED3((PointsAlmostEqual<3, float>), m * points[i], result[i],
+                 kTolerance) << i;
+  }
+
+  // In place.
+  std::vector<Point3f> in_place = points;
+  TransformPoints(m, in_place.data(), in_place.size(), in_place.data(), NULL);
+  EXPECT_EQ(result, in_place);
+
+  // Coordinate arrays.
+  std::vector<float> x, y, z;
+  const CoordinateArrays3f arrays = ToArrays(points, &x, &y, &z);
+  TransformPoints(m, arrays, points.size(), arrays, NULL);
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_PRED3((PointsAlmostEqual<3, float>), m * points[i],
+                 Point3f(x[i], y[i], z[i]), kTolerance) << i;
+  }
+
+  // Nothing happens for an empty array.
+  TransformPoints(m, NULL, 0U, NULL, NULL);
+}
+
+TEST(TransformKernels, TransformVectors) {
+  const Matrix4f m = GetAffineMatrix();
+  const std::vector<Point3f> points = GetPoints(15U);
+  std::vector<Vector3f> vectors(points.size());
+  for (size_t i = 0; i < points.size(); ++i)
+    vectors[i] = points[i] - Point3f::Zero();
+  std::vector<Vector3f> result(vectors.size());
+  TransformVectors(m, vectors.data(), vectors.size(), result.data(), NULL);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    EXPECT_PRED3((VectorsAlmostEqual<3, float>), m * vectors[i], result[i],
+                 kTolerance) << i;
+  }
+
+  std::vector<float> x, y, z;
+  const CoordinateArrays3f arrays = ToArrays(points, &x, &y, &z);
+  TransformVectors(m, arrays, points.size(), arrays, NULL);
+  for (size_t i = 0; i < vectors.size(); ++i) {
+    EXPECT_PRED3((VectorsAlmostEqual<3, float>), m * vectors[i],
+                 Vector3f(x[i], y[i], z[i]), kTolerance) << i;
+  }
+}
+
+TEST(TransformKernels, Strided) {
+  // Transform the positions and normals of interleaved vertices in place.
+  struct Vertex {
+    Point3f position;
+    float u;
+    Vector3f normal;
+  };
+  const Matrix4f m = GetAffineMatrix();
+  const std::vector<Point3f> points = GetPoints(9U);
+  std::vector<Vertex> vertices(points.size());
+  for (size_t i = 0; i < points.size(); ++i) {
+    vertices[i].position = points[i];
+    vertices[i].u = static_cast<float>(i);
+    vertices[i].normal = Normalized(points[i] - Point3f(0.f, 0.f, 1.f));
+  }
+  const std::vector<Vertex> original = vertices;
+  TransformPoints(m, &vertices[0].position, sizeof(Vertex), vertices.size(),
+                  &vertices[0].position, sizeof(Vertex), NULL);
+  TransformVectors(m, &vertices[0].normal, sizeof(Vertex), vertices.size(),
+                   &vertices[0].normal, sizeof(Vertex), NULL);
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    EXPECT_PRED3((PointsAlmostEqual<3, float>), m * original[i].position,
+                 vertices[i].position, kTolerance) << i;
+    EXPECT_PRED3((VectorsAlmostEqual<3, float>), m * original[i].normal,
+                 vertices[i].normal, kTolerance) << i;
+    // The other members are untouched.
+    EXPECT_EQ(original[i].u, vertices[i].u);
+  }
+
+  // The result can be another array with a different stride.
+  std::vector<Point3f> positions(points.size());
+  TransformPoints(m, &original[0].position, sizeof(Vertex), original.size(),
+                  positions.data(), sizeof(Point3f), NULL);
+  for (size_t i = 0; i < vertices.size(); ++i)
+    EXPECT_EQ(vertices[i].position, positions[i]);
+}
+
+TEST(TransformKernels, ProjectPoints) {
+  const Matrix4f m = GetProjectionMatrix();
+  const std::vector<Point3f> points = GetPoints(19U);
+  std::vector<Point3f> result(points.size());
+  ProjectPoints(m, points.data(), points.size(), result.data(), NULL);
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_PRED2(ProjectedPointsAlmostEqual, ProjectPoint(m, points[i]),
+                 result[i]) << i;
+  }
+
+  std::vector<float> x, y, z;
+  const CoordinateArrays3f arrays = ToArrays(points, &x, &y, &z);
+  ProjectPoints(m, arrays, points.size(), arrays, NULL);
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_PRED2(ProjectedPointsAlmostEqual, ProjectPoint(m, points[i]),
+                 Point3f(x[i], y[i], z[i])) << i;
+  }
+
+  // Points with a zero homogeneous coordinate are not divided.
+  const Matrix4f flat(1.f, 0.f, 0.f, 1.f,
+                      0.f, 2.f, 0.f, 2.f,
+                      0.f, 0.f, 3.f, 3.f,
+                      0.f, 0.f, 0.f, 0.f);
+  ProjectPoints(flat, points.data(), points.size(), result.data(), NULL);
+  for (size_t i = 0; i < points.size(); ++i)
+    EXPECT_EQ(ProjectPoint(flat, points[i]), result[i]) << i;
+}
+
+TEST(TransformKernels, TransformRanges) {
+  const Matrix4f m = GetAffineMatrix();
+  const std::vector<Point3f> points = GetPoints(8U);
+  std::vector<Range3f> ranges;
+  for (size_t i = 0; i + 1U < points.size(); ++i) {
+    Range3f range;
+    range.ExtendByPoint(points[i]);
+    range.ExtendByPoint(points[i + 1U] + Vector3f(1.f, 2.f, 3.f));
+    ranges.push_back(range);
+  }
+  ranges.push_back(Range3f());
+  std::vector<Range3f> result(ranges.size());
+  TransformRanges(m, ranges.data(), ranges.size(), result.data(), NULL);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    if (ranges[i].IsEmpty()) {
+      EXPECT_TRUE(result[i].IsEmpty());
+      continue;
+    }
+    // The result is the bounds of the transformed corners.
+    Range3f expected;
+    const Point3f& min = ranges[i].GetMinPoint();
+    const Point3f& max = ranges[i].GetMaxPoint();
+    for (int corner = 0; corner < 8; ++corner) {
+      expected.ExtendByPoint(m * Point3f((corner & 1) ? max[0] : min[0],
+                                         (corner & 2) ? max[1] : min[1],
+                                         (corner & 4) ? max[2] : min[2]));
+    }
+    EXPECT_PRED3((RangesAlmostEqual<3, float>), expected, result[i],
+                 kTolerance) << i;
+  }
+}
+
+TEST(TransformKernels, MultiplyMatrices) {
+  std::vector<Matrix4f> a(5U, GetProjectionMatrix());
+  std::vector<Matrix4f> b(5U, GetAffineMatrix());
+  for (size_t i = 0; i < a.size(); ++i) {
+    const float f = static_cast<float>(i);
+    a[i] = a[i] * TranslationMatrix(Vector3f(f, -f, 2.f * f));
+    b[i] = ScaleMatrixH(Vector3f(1.f + f, 2.f, 0.5f)) * b[i];
+  }
+  std::vector<Matrix4f> result(a.size());
+  MultiplyMatrices(a.data(), b.data(), a.size(), result.data(), NULL);
+  for (size_t i = 0; i < a.size(); ++i) {
+    EXPECT_PRED3((MatricesAlmostEqual<4, float>), a[i] * b[i], result[i],
+                 kTolerance) << i;
+  }
+
+  // In place, into either operand.
+  std::vector<Matrix4f> in_place = a;
+  MultiplyMatrices(in_place.data(), b.data(), a.size(), in_place.data(), NULL);
+  EXPECT_EQ(result, in_place);
+  in_place = b;
+  MultiplyMatrices(a.data(), in_place.data(), a.size(), in_place.data(), NULL);
+  EXPECT_EQ(result, in_place);
+
+  MultiplyMatrices(NULL, NULL, 0U, NULL, NULL);
+}
+
+TEST(TransformKernels, Parallel) {
+  // Arrays this large are split over the threads of the scheduler, which must
+  // give the same results as transforming them on the calling thread.
+  base::TaskScheduler scheduler("transforms", 3U);
+  const Matrix4f m = GetProjectionMatrix();
+  const std::vector<Point3f> points = GetPoints(10001U);
+  std::vector<Point3f> expected(points.size());
+  std::vector<Point3f> result(points.size());
+  TransformPoints(m, points.data(), points.size(), expected.data(), NULL);
+  TransformPoints(m, points.data(), points.size(), result.data(), &scheduler);
+  EXPECT_EQ(expected, result);
+  ProjectPoints(m, points.data(), points.size(), expected.data(), NULL);
+  ProjectPoints(m, points.data(), points.size(), result.data(), &scheduler);
+  EXPECT_EQ(expected, result);
+
+  std::vector<float> x, y, z;
+  const CoordinateArrays3f arrays = ToArrays(points, &x, &y, &z);
+  TransformPoints(m, arrays, points.size(), arrays, &scheduler);
+  TransformPoints(m, points.data(), points.size(), expected.data(), NULL);
+  for (size_t i = 0; i < points.size(); ++i) {
+    EXPECT_PRED3((PointsAlmostEqual<3, float>), expected[i],
+                 Point3f(x[i], y[i], z[i]), kTolerance) << i;
+  }
+}
+
+}  // namespace math
+}  // namespace ion
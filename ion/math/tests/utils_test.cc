@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/math/utils.h"
 
+#include <algorithm>
+
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
 TEST(Utils, Abs) {
@@ -320,3 +322,25 @@ TEST(Utils, IsPowerOfTwo) {
     EXPECT_FALSE(IsPowerOfTwo(p2 + 1));
   }
 }
+
+TEST(Utils, Constexpr) {
+  using ion::math::Abs;
+  using ion::math::Clamp;
+  using ion::math::IsPowerOfTwo;
+  using ion::math::Lerp;
+  using ion::math::Square;
+
+  static_assert(Abs(-3) == 3, "Abs() must be constexpr");
+  static_assert(Square(-3) == 9, "Square() must be constexpr");
+  static_assert(Clamp(5, 0, 3) == 3, "Clamp() must be constexpr");
+  static_assert(Clamp(-5, 0, 3) == 0, "Clamp() must be constexpr");
+  static_assert(Clamp(2, 0, 3) == 2, "Clamp() must be constexpr");
+  static_assert(Lerp(2.0, 4.0, 0.5) == 3.0, "Lerp() must be constexpr");
+  static_assert(IsPowerOfTwo(64) && !IsPowerOfTwo(65),
+                "IsPowerOfTwo() must be constexpr");
+
+  // Clamp() matches std::min() and std::max() when the range is inverted.
+  EXPECT_EQ(std::min(std::max(5, 3), 0), Clamp(5, 3, 0));
+  EXPECT_EQ(std::min(std::max(-5, 3), 0), Clamp(-5, 3, 0));
+  EXPECT_EQ(std::min(std::max(1, 3), 0), Clamp(1, 3, 0));
+}
@@ -294,6 +294,20 @@ TEST(Vector, VectorAxes) {
   EXPECT_EQ(Vector4d(0., 0., 0., 1.), Vector4d::AxisW());
 }
 
+TEST(Vector, Constexpr) {
+  // These are initialized at compile time, or the build fails.
+  static constexpr Point2f kCorners[2] = { Point2f(-1.f, 2.f),
+                                           Point2f::Fill(3.f) };
+  static constexpr Vector3d kAxis = Vector3d::AxisZ();
+  static constexpr Vector4i kZero = Vector4i::Zero();
+  static constexpr Vector4f kFill = Vector4f::Fill(0.5f);
+  EXPECT_EQ(Point2f(-1.f, 2.f), kCorners[0]);
+  EXPECT_EQ(Point2f(3.f, 3.f), kCorners[1]);
+  EXPECT_EQ(Vector3d(0., 0., 1.), kAxis);
+  EXPECT_EQ(Vector4i(0, 0, 0, 0), kZero);
+  EXPECT_EQ(Vector4f(0.5f, 0.5f, 0.5f, 0.5f), kFill);
+}
+
 TEST(Vector, VectorSet) {
   Vector1i v1i = Vector1i::Zero();
   v1i.Set(2);
@@ -0,0 +1,452 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/math/transformkernels.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include "base/integral_types.h"
+#include "ion/base/logging.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/math/transformutils.h"
+
+#if defined(ION_MATH_SSE) || defined(ION_MATH_NEON)
+#  define ION_TRANSFORM_SIMD 1
+#endif
+
+namespace ion {
+namespace math {
+
+namespace {
+
+// Arrays with fewer elements than this are not split over threads, since
+// scheduling them would cost more than transforming them.
+static const size_t kMinParallelCount = 4096U;
+
+// Calls func for ranges of [0, count), in parallel if there is a scheduler and
+// count is large enough.
+static void ForEachRange(base::TaskScheduler* scheduler, size_t count,
+                         const base::TaskScheduler::RangeFunction& func) {
+  if (scheduler && count >= kMinParallelCount)
+    scheduler->ParallelFor(0U, count, 0U, func);
+  else if (count)
+    func(0U, count);
+}
+
+// Returns the element |index| of an array whose elements are |stride| bytes
+// apart.
+template <typename T>
+static T* GetElement(T* array, size_t stride, size_t index) {
+  typedef typename std::conditional<std::is_const<T>::value, const uint8,
+                                    uint8>::type Byte;
+  return reinterpret_cast<T*>(reinterpret_cast<Byte*>(array) + index * stride);
+}
+
+//-----------------------------------------------------------------------------
+//
+// Scalar kernels. These evaluate the same expressions as the operators in
+// transformutils.h, and handle the elements that do not fill a SIMD register.
+//
+//-----------------------------------------------------------------------------
+
+// Transforms the point or vector (x, y, z), including the translation of |m|
+// if kIsPoint is true.
+template <bool kIsPoint>
+static void TransformScalar(const Matrix4f& m, float x, float y, float z,
+                            float* out_x, float* out_y, float* out_z) {
+  float r[3];
+  for (int row = 0; row < 3; ++row) {
+    r[row] = m(row, 0) * x + m(row, 1) * y + m(row, 2) * z;
+    if (kIsPoint)
+      r[row] += m(row, 3);
+  }
+  *out_x = r[0];
+  *out_y = r[1];
+  *out_z = r[2];
+}
+
+static void ProjectScalar(const Matrix4f& m, float x, float y, float z,
+                          float* out_x, float* out_y, float* out_z) {
+  const Point3f r = ProjectPoint(m, Point3f(x, y, z));
+  *out_x = r[0];
+  *out_y = r[1];
+  *out_z = r[2];
+}
+
+#if !defined(ION_TRANSFORM_SIMD)
+// Transforms the corners of the box [min, max] and stores their bounds in
+// [out_min, out_max]. For each row, the smaller and larger of the two
+// products for each coordinate are accumulated separately (Arvo's method).
+static void TransformRangeScalar(const Matrix4f& m, const float* min,
+                                 const float* max, float* out_min,
+                                 float* out_max) {
+  for (int row = 0; row < 3; ++row) {
+    float lo = m(row, 3);
+    float hi = m(row, 3);
+    for (int col = 0; col < 3; ++col) {
+      const float a = m(row, col) * min[col];
+      const float b = m(row, col) * max[col];
+      lo += std::min(a, b);
+      hi += std::max(a, b);
+    }
+    out_min[row] = lo;
+    out_max[row] = hi;
+  }
+}
+#endif
+
+//-----------------------------------------------------------------------------
+//
+// SIMD helpers. A Float4 holds one float per row of the matrix for the array
+// of structures kernels, and one float per element for the structure of
+// arrays kernels.
+//
+//-----------------------------------------------------------------------------
+
+#if defined(ION_TRANSFORM_SIMD)
+#  if defined(ION_MATH_SSE)
+typedef __m128 Float4;
+static inline Float4 Splat(float f) { return _mm_set1_ps(f); }
+static inline Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+static inline void Store(float* p, Float4 v) { _mm_storeu_ps(p, v); }
+static inline Float4 Add(Float4 a, Float4 b) { return _mm_add_ps(a, b); }
+static inline Float4 Mul(Float4 a, Float4 b) { return _mm_mul_ps(a, b); }
+static inline Float4 Min(Float4 a, Float4 b) { return _mm_min_ps(a, b); }
+static inline Float4 Max(Float4 a, Float4 b) { return _mm_max_ps(a, b); }
+// Returns a / b in the lanes where b is not 0, and a in the others.
+static inline Float4 DivNonZero(Float4 a, Float4 b) {
+  const __m128 non_zero = _mm_cmpneq_ps(b, _mm_setzero_ps());
+  return _mm_or_ps(_mm_and_ps(non_zero, _mm_div_ps(a, b)),
+                   _mm_andnot_ps(non_zero, a));
+}
+// Returns lane 3 of v in all lanes.
+static inline Float4 SplatW(Float4 v) {
+  return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+}
+// Stores the first three lanes of v, without touching p[3].
+static inline void Store3(float* p, Float4 v) {
+  _mm_storel_pi(reinterpret_cast<__m64*>(p), v);
+  _mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+}
+// Returns the columns of m.
+static inline void LoadColumns(const Matrix4f& m, Float4 c[4]) {
+  c[0] = _mm_loadu_ps(m[0]);
+  c[1] = _mm_loadu_ps(m[1]);
+  c[2] = _mm_loadu_ps(m[2]);
+  c[3] = _mm_loadu_ps(m[3]);
+  _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]);
+}
+#  else
+typedef float32x4_t Float4;
+static inline Float4 Splat(float f) { return vdupq_n_f32(f); }
+static inline Float4 Load(const float* p) { return vld1q_f32(p); }
+static inline void Store(float* p, Float4 v) { vst1q_f32(p, v); }
+static inline Float4 Add(Float4 a, Float4 b) { return vaddq_f32(a, b); }
+static inline Float4 Mul(Float4 a, Float4 b) { return vmulq_f32(a, b); }
+static inline Float4 Div(Float4 a, Float4 b) {
+#    if defined(__aarch64__)
+  return vdivq_f32(a, b);
+#    else
+  // ARMv7 has no vector division, so refine the reciprocal estimate of b with
+  // two Newton-Raphson steps.
+  float32x4_t r = vrecpeq_f32(b);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  r = vmulq_f32(vrecpsq_f32(b, r), r);
+  return vmulq_f32(a, r);
+#    endif
+}
+static inline Float4 Min(Float4 a, Float4 b) { return vminq_f32(a, b); }
+static inline Float4 Max(Float4 a, Float4 b) { return vmaxq_f32(a, b); }
+static inline Float4 DivNonZero(Float4 a, Float4 b) {
+  const uint32x4_t zero = vceqq_f32(b, vdupq_n_f32(0.f));
+  return vbslq_f32(zero, a, Div(a, b));
+}
+static inline Float4 SplatW(Float4 v) {
+  return vdupq_lane_f32(vget_high_f32(v), 1);
+}
+static inline void Store3(float* p, Float4 v) {
+  vst1_f32(p, vget_low_f32(v));
+  vst1q_lane_f32(p + 2, v, 2);
+}
+static inline void LoadColumns(const Matrix4f& m, Float4 c[4]) {
+  const float32x4x4_t columns = vld4q_f32(m.Data());
+  c[0] = columns.val[0];
+  c[1] = columns.val[1];
+  c[2] = columns.val[2];
+  c[3] = columns.val[3];
+}
+#  endif
+
+// Returns c[0] * x + c[1] * y + c[2] * z, plus c[3] if kIsPoint is true.
+template <bool kIsPoint>
+static inline Float4 Combine(const Float4 c[4], Float4 x, Float4 y, Float4 z) {
+  const Float4 sum = Add(Add(Mul(c[0], x), Mul(c[1], y)), Mul(c[2], z));
+  return kIsPoint ? Add(sum, c[3]) : sum;
+}
+#endif  // ION_TRANSFORM_SIMD
+
+//-----------------------------------------------------------------------------
+//
+// Kernels for the index range [begin, end).
+//
+//-----------------------------------------------------------------------------
+
+template <bool kIsPoint, typename VectorType>
+static void TransformStrided(const Matrix4f& m, const VectorType* in,
+                             size_t stride, VectorType* out,
+                             size_t out_stride, size_t begin, size_t end) {
+#if defined(ION_TRANSFORM_SIMD)
+  // Each element is transformed as one column vector, with one row per lane.
+  Float4 c[4];
+  LoadColumns(m, c);
+  for (size_t i = begin; i < end; ++i) {
+    const float* p = GetElement(in, stride, i)->Data();
+    Store3(GetElement(out, out_stride, i)->Data(),
+           Combine<kIsPoint>(c, Splat(p[0]), Splat(p[1]), Splat(p[2])));
+  }
+#else
+  for (size_t i = begin; i < end; ++i) {
+    const float* p = GetElement(in, stride, i)->Data();
+    float* r = GetElement(out, out_stride, i)->Data();
+    TransformScalar<kIsPoint>(m, p[0], p[1], p[2], &r[0], &r[1], &r[2]);
+  }
+#endif
+}
+
+template <bool kIsPoint>
+static void TransformArrays(const Matrix4f& m, const CoordinateArrays3f& in,
+                            const CoordinateArrays3f& out, size_t begin,
+                            size_t end) {
+  size_t i = begin;
+#if defined(ION_TRANSFORM_SIMD)
+  // Four elements are transformed at a time, with one element per lane.
+  Float4 r0[4], r1[4], r2[4];
+  for (int col = 0; col < 4; ++col) {
+    r0[col] = Splat(m(0, col));
+    r1[col] = Splat(m(1, col));
+    r2[col] = Splat(m(2, col));
+  }
+  for (; i + 4U <= end; i += 4U) {
+    const Float4 x = Load(in.x + i);
+    const Float4 y = Load(in.y + i);
+    const Float4 z = Load(in.z + i);
+    Store(out.x + i, Combine<kIsPoint>(r0, x, y, z));
+    Store(out.y + i, Combine<kIsPoint>(r1, x, y, z));
+    Store(out.z + i, Combine<kIsPoint>(r2, x, y, z));
+  }
+#endif
+  for (; i < end; ++i) {
+    TransformScalar<kIsPoint>(m, in.x[i], in.y[i], in.z[i], &out.x[i],
+                              &out.y[i], &out.z[i]);
+  }
+}
+
+static void ProjectContiguous(const Matrix4f& m, const Point3f* in,
+                              Point3f* out, size_t begin, size_t end) {
+#if defined(ION_TRANSFORM_SIMD)
+  Float4 c[4];
+  LoadColumns(m, c);
+  for (size_t i = begin; i < end; ++i) {
+    const float* p = in[i].Data();
+    const Float4 v =
+        Combine<true>(c, Splat(p[0]), Splat(p[1]), Splat(p[2]));
+    Store3(out[i].Data(), DivNonZero(v, SplatW(v)));
+  }
+#else
+  for (size_t i = begin; i < end; ++i) {
+    const float* p = in[i].Data();
+    float* r = out[i].Data();
+    ProjectScalar(m, p[0], p[1], p[2], &r[0], &r[1], &r[2]);
+  }
+#endif
+}
+
+static void ProjectArrays(const Matrix4f& m, const CoordinateArrays3f& in,
+                          const CoordinateArrays3f& out, size_t begin,
+                          size_t end) {
+  size_t i = begin;
+#if defined(ION_TRANSFORM_SIMD)
+  Float4 r[4][4];
+  for (int row = 0; row < 4; ++row) {
+    for (int col = 0; col < 4; ++col)
+      r[row][col] = Splat(m(row, col));
+  }
+  for (; i + 4U <= end; i += 4U) {
+    const Float4 x = Load(in.x + i);
+    const Float4 y = Load(in.y + i);
+    const Float4 z = Load(in.z + i);
+    const Float4 w = Combine<true>(r[3], x, y, z);
+    Store(out.x + i, DivNonZero(Combine<true>(r[0], x, y, z), w));
+    Store(out.y + i, DivNonZero(Combine<true>(r[1], x, y, z), w));
+    Store(out.z + i, DivNonZero(Combine<true>(r[2], x, y, z), w));
+  }
+#endif
+  for (; i < end; ++i) {
+    ProjectScalar(m, in.x[i], in.y[i], in.z[i], &out.x[i], &out.y[i],
+                  &out.z[i]);
+  }
+}
+
+static void TransformRangesContiguous(const Matrix4f& m, const Range3f* in,
+                                      Range3f* out, size_t begin, size_t end) {
+#if defined(ION_TRANSFORM_SIMD)
+  Float4 c[4];
+  LoadColumns(m, c);
+#endif
+  for (size_t i = begin; i < end; ++i) {
+    if (in[i].IsEmpty()) {
+      out[i].MakeEmpty();
+      continue;
+    }
+    const float* min = in[i].GetMinPoint().Data();
+    const float* max = in[i].GetMaxPoint().Data();
+    Point3f out_min;
+    Point3f out_max;
+#if defined(ION_TRANSFORM_SIMD)
+    Float4 lo = c[3];
+    Float4 hi = c[3];
+    for (int col = 0; col < 3; ++col) {
+      const Float4 a = Mul(c[col], Splat(min[col]));
+      const Float4 b = Mul(c[col], Splat(max[col]));
+      lo = Add(lo, Min(a, b));
+      hi = Add(hi, Max(a, b));
+    }
+    Store3(out_min.Data(), lo);
+    Store3(out_max.Data(), hi);
+#else
+    TransformRangeScalar(m, min, max, out_min.Data(), out_max.Data());
+#endif
+    out[i].Set(out_min, out_max);
+  }
+}
+
+static void MultiplyContiguous(const Matrix4f* a, const Matrix4f* b,
+                               Matrix4f* out, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; ++i) {
+#if defined(ION_TRANSFORM_SIMD)
+    // Each row of the product is a combination of the rows of b[i] weighted by
+    // the elements of the same row of a[i]. All of the inputs are read before
+    // the product is stored so that out may be a or b.
+    const Float4 c[4] = { Load(b[i][0]), Load(b[i][1]), Load(b[i][2]),
+                          Load(b[i][3]) };
+    const Matrix4f& m = a[i];
+    Float4 r[4];
+    for (int row = 0; row < 4; ++row) {
+      r[row] = Add(Combine<false>(c, Splat(m(row, 0)), Splat(m(row, 1)),
+                                  Splat(m(row, 2))),
+                   Mul(c[3], Splat(m(row, 3))));
+    }
+    for (int row = 0; row < 4; ++row)
+      Store(out[i][row], r[row]);
+#else
+    out[i] = a[i] * b[i];
+#endif
+  }
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// Public functions.
+//
+//-----------------------------------------------------------------------------
+
+void TransformPoints(const Matrix4f& m, const Point3f* points, size_t count,
+                     Point3f* result, base::TaskScheduler* scheduler) {
+  TransformPoints(m, points, sizeof(Point3f), count, result, sizeof(Point3f),
+                  scheduler);
+}
+
+void TransformPoints(const Matrix4f& m, const Point3f* points, size_t stride,
+                     size_t count, Point3f* result, size_t result_stride,
+                     base::TaskScheduler* scheduler) {
+  DCHECK(count == 0U || (points && result));
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    TransformStrided<true>(m, points, stride, result, result_stride, begin,
+                           end);
+  });
+}
+
+void TransformPoints(const Matrix4f& m, const CoordinateArrays3f& points,
+                     size_t count, const CoordinateArrays3f& result,
+                     base::TaskScheduler* scheduler) {
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    TransformArrays<true>(m, points, result, begin, end);
+  });
+}
+
+void TransformVectors(const Matrix4f& m, const Vector3f* vectors,
+                      size_t count, Vector3f* result,
+                      base::TaskScheduler* scheduler) {
+  TransformVectors(m, vectors, sizeof(Vector3f), count, result,
+                   sizeof(Vector3f), scheduler);
+}
+
+void TransformVectors(const Matrix4f& m, const Vector3f* vectors,
+                      size_t stride, size_t count, Vector3f* result,
+                      size_t result_stride, base::TaskScheduler* scheduler) {
+  DCHECK(count == 0U || (vectors && result));
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    TransformStrided<false>(m, vectors, stride, result, result_stride, begin,
+                            end);
+  });
+}
+
+void TransformVectors(const Matrix4f& m, const CoordinateArrays3f& vectors,
+                      size_t count, const CoordinateArrays3f& result,
+                      base::TaskScheduler* scheduler) {
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    TransformArrays<false>(m, vectors, result, begin, end);
+  });
+}
+
+void ProjectPoints(const Matrix4f& m, const Point3f* points, size_t count,
+                   Point3f* result, base::TaskScheduler* scheduler) {
+  DCHECK(count == 0U || (points && result));
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    ProjectContiguous(m, points, result, begin, end);
+  });
+}
+
+void ProjectPoints(const Matrix4f& m, const CoordinateArrays3f& points,
+                   size_t count, const CoordinateArrays3f& result,
+                   base::TaskScheduler* scheduler) {
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    ProjectArrays(m, points, result, begin, end);
+  });
+}
+
+void TransformRanges(const Matrix4f& m, const Range3f* ranges, size_t count,
+                     Range3f* result, base::TaskScheduler* scheduler) {
+  DCHECK(count == 0U || (ranges && result));
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    TransformRangesContiguous(m, ranges, result, begin, end);
+  });
+}
+
+void MultiplyMatrices(const Matrix4f* a, const Matrix4f* b, size_t count,
+                      Matrix4f* result, base::TaskScheduler* scheduler) {
+  DCHECK(count == 0U || (a && b && result));
+  ForEachRange(scheduler, count, [&](size_t begin, size_t end) {
+    MultiplyContiguous(a, b, result, begin, end);
+  });
+}
+
+}  // namespace math
+}  // namespace ion
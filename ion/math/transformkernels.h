@@ -0,0 +1,118 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_MATH_TRANSFORMKERNELS_H_
+#define ION_MATH_TRANSFORMKERNELS_H_
+
+// This file contains kernels that transform arrays of 3D points, vectors and
+// ranges by a 4x4 matrix, and that multiply arrays of matrices. They compute
+// the same values as calling the operators and functions in transformutils.h
+// on each element, but process the elements in bulk, using SSE or NEON where
+// the platform supports it, and optionally split the work over the threads of
+// a TaskScheduler.
+//
+// Arrays are either arrays of structures, with a byte stride between
+// consecutive elements so that, for example, the positions in an interleaved
+// vertex buffer can be transformed in place, or structures of arrays, with one
+// array per coordinate. The result may be the input array itself but must not
+// otherwise overlap it.
+
+#include <stddef.h>
+
+#include "ion/math/matrix.h"
+#include "ion/math/range.h"
+#include "ion/math/vector.h"
+
+namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
+namespace math {
+
+// The x, y and z coordinates of an array of points or vectors, stored in
+// three separate arrays of the same length.
+struct CoordinateArrays3f {
+  CoordinateArrays3f() : x(NULL), y(NULL), z(NULL) {}
+  CoordinateArrays3f(float* x_in, float* y_in, float* z_in)
+      : x(x_in), y(y_in), z(z_in) {}
+  float* x;
+  float* y;
+  float* z;
+};
+
+// Sets result[i] to m * points[i] for i in [0, count), where the points have
+// an implicit homogeneous coordinate of 1, as operator*() does. If |scheduler|
+// is not NULL, large arrays are processed in parallel on its threads.
+ION_API void TransformPoints(const Matrix4f& m, const Point3f* points,
+                             size_t count, Point3f* result,
+                             base::TaskScheduler* scheduler);
+// Same as above, but the elements of |points| and |result| are |stride| and
+// |result_stride| bytes apart.
+ION_API void TransformPoints(const Matrix4f& m, const Point3f* points,
+                             size_t stride, size_t count, Point3f* result,
+                             size_t result_stride,
+                             base::TaskScheduler* scheduler);
+// Same as above, for coordinate arrays.
+ION_API void TransformPoints(const Matrix4f& m,
+                             const CoordinateArrays3f& points, size_t count,
+                             const CoordinateArrays3f& result,
+                             base::TaskScheduler* scheduler);
+
+// Sets result[i] to m * vectors[i], ignoring the translation of |m|, as
+// operator*() does. The arguments are as for TransformPoints().
+ION_API void TransformVectors(const Matrix4f& m, const Vector3f* vectors,
+                              size_t count, Vector3f* result,
+                              base::TaskScheduler* scheduler);
+ION_API void TransformVectors(const Matrix4f& m, const Vector3f* vectors,
+                              size_t stride, size_t count, Vector3f* result,
+                              size_t result_stride,
+                              base::TaskScheduler* scheduler);
+ION_API void TransformVectors(const Matrix4f& m,
+                              const CoordinateArrays3f& vectors, size_t count,
+                              const CoordinateArrays3f& result,
+                              base::TaskScheduler* scheduler);
+
+// Sets result[i] to ProjectPoint(m, points[i]), dividing by the homogeneous
+// coordinate unless it is 0. The arguments are as for TransformPoints().
+ION_API void ProjectPoints(const Matrix4f& m, const Point3f* points,
+                           size_t count, Point3f* result,
+                           base::TaskScheduler* scheduler);
+ION_API void ProjectPoints(const Matrix4f& m,
+                           const CoordinateArrays3f& points, size_t count,
+                           const CoordinateArrays3f& result,
+                           base::TaskScheduler* scheduler);
+
+// Sets result[i] to the smallest range that contains ranges[i] transformed by
+// |m|, which is assumed to be affine. Empty ranges stay empty. This is what is
+// needed to update axis-aligned bounding boxes. The arguments are as for
+// TransformPoints().
+ION_API void TransformRanges(const Matrix4f& m, const Range3f* ranges,
+                             size_t count, Range3f* result,
+                             base::TaskScheduler* scheduler);
+
+// Sets result[i] to a[i] * b[i] for i in [0, count). |result| may be |a| or
+// |b|. This is what is needed to concatenate the transforms of many objects or
+// bones at once. The scheduler is used as for TransformPoints().
+ION_API void MultiplyMatrices(const Matrix4f* a, const Matrix4f* b,
+                              size_t count, Matrix4f* result,
+                              base::TaskScheduler* scheduler);
+
+}  // namespace math
+}  // namespace ion
+
+#endif  // ION_MATH_TRANSFORMKERNELS_H_
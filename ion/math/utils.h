@@ -19,7 +19,8 @@ limitations under the License.
 #define ION_MATH_UTILS_H_
 
 // This file contains math utility functions that are not associated with any
-// particular class.
+// particular class. Abs(), Square(), Clamp(), Lerp() and IsPowerOfTwo() are
+// constexpr, so they can be used to compute constants at compile time.
 
 #include <algorithm>
 #include <cmath>
@@ -31,13 +32,13 @@ namespace math {
 
 // Returns the absolute value of a number in a type-safe way.
 template <typename T>
-inline const T Abs(const T& val) {
+inline constexpr const T Abs(const T& val) {
   return val >= static_cast<T>(0) ? val : -val;
 }
 
 // Squares a value.
 template <typename T>
-inline const T Square(const T& val) {
+inline constexpr const T Square(const T& val) {
   return val * val;
 }
 
@@ -191,21 +192,25 @@ inline int64 Log2(int64 n) {
 }
 
 // Clamps a value to lie between a minimum and maximum, inclusive. This is
-// supported for any type for which std::min() and std::max() are implemented.
+// supported for any type for which operator<() is implemented, and gives the
+// same result as std::min(std::max(val, min_val), max_val), which is not
+// constexpr in C++11.
 template <typename T>
-inline const T Clamp(const T& val, const T& min_val, const T& max_val) {
-  return std::min(std::max(val, min_val), max_val);
+inline constexpr const T Clamp(const T& val, const T& min_val,
+                               const T& max_val) {
+  return val < min_val ? (max_val < min_val ? max_val : min_val)
+                       : (max_val < val ? max_val : val);
 }
 
 // Linearly interpolates between two values. T must have multiplication and
 // addition operators defined. Performs extrapolation for t outside [0, 1].
 template<typename T, typename U>
-inline const U Lerp(const U& begin, const U& end, const T& t) {
+inline constexpr const U Lerp(const U& begin, const U& end, const T& t) {
   return static_cast<U>(begin + t * (end - begin));
 }
 
 // Returns true if a value is a power of two.
-inline bool IsPowerOfTwo(int value) {
+inline constexpr bool IsPowerOfTwo(int value) {
   return (value != 0) && ((value & (value - 1)) == 0);
 }
 
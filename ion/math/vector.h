@@ -23,6 +23,12 @@ limitations under the License.
 // class in this file is templatized on dimension (number of elements) and
 // scalar value type.
 //
+// The constructors that take element values and the Zero(), Fill() and Axis?()
+// functions are constexpr, so constant Vectors and Points, including arrays
+// of them, can be initialized at compile time, e.g.:
+//   static constexpr Point2f kCorners[2] = { Point2f(0.f, 0.f),
+//                                            Point2f(1.f, 1.f) };
+//
 
 #include "base/integral_types.h"
 #include "ion/base/logging.h"
@@ -105,12 +111,12 @@ class VectorBase {
 
  protected:
   // The default constructor zero-initializes all elements.
-  VectorBase() : elem_() {}
+  constexpr VectorBase() : elem_() {}
 
-  explicit VectorBase(T e0);           // Only when Dimension == 1.
-  VectorBase(T e0, T e1);              // Only when Dimension == 2.
-  VectorBase(T e0, T e1, T e2);        // Only when Dimension == 3.
-  VectorBase(T e0, T e1, T e2, T e3);  // Only when Dimension == 4.
+  constexpr explicit VectorBase(T e0);           // Only when Dimension == 1.
+  constexpr VectorBase(T e0, T e1);              // Only when Dimension == 2.
+  constexpr VectorBase(T e0, T e1, T e2);        // Only when Dimension == 3.
+  constexpr VectorBase(T e0, T e1, T e2, T e3);  // Only when Dimension == 4.
 
   // Constructor for an instance of dimension N from an instance of dimension
   // N-1 and a scalar of the correct type. This is defined only when Dimension
@@ -122,10 +128,12 @@ class VectorBase {
   template <typename U> explicit VectorBase(const VectorBase<Dimension, U>& v);
 
   // Returns an instance containing all zeroes.
-  static const VectorBase Zero();
+  static constexpr const VectorBase Zero() { return VectorBase(); }
 
   // Returns an instance with all elements set to the given value.
-  static const VectorBase Fill(T value);
+  static constexpr const VectorBase Fill(T value) {
+    return StaticHelper<Dimension, T>::template Fill<VectorBase>(value);
+  }
 
   //
   // Derived classes use these protected functions to implement type-safe
@@ -176,13 +184,13 @@ template <int Dimension, typename T>
 class Vector : public VectorBase<Dimension, T> {
  public:
   // The default constructor zero-initializes all elements.
-  Vector() : BaseType() {}
+  constexpr Vector() : BaseType() {}
 
   // Dimension-specific constructors that are passed individual element values.
-  explicit Vector(T e0) : BaseType(e0) {}
-  Vector(T e0, T e1) : BaseType(e0, e1) {}
-  Vector(T e0, T e1, T e2) : BaseType(e0, e1, e2) {}
-  Vector(T e0, T e1, T e2, T e3) : BaseType(e0, e1, e2, e3) {}
+  constexpr explicit Vector(T e0) : BaseType(e0) {}
+  constexpr Vector(T e0, T e1) : BaseType(e0, e1) {}
+  constexpr Vector(T e0, T e1, T e2) : BaseType(e0, e1, e2) {}
+  constexpr Vector(T e0, T e1, T e2, T e3) : BaseType(e0, e1, e2, e3) {}
 
   // Constructor for a Vector of dimension N from a Vector of dimension N-1 and
   // a scalar of the correct type, assuming N is at least 2.
@@ -194,19 +202,21 @@ class Vector : public VectorBase<Dimension, T> {
       : BaseType(v) {}
 
   // Returns a Vector containing all zeroes.
-  static const Vector Zero() { return ToVector(BaseType::Zero()); }
+  static constexpr const Vector Zero() { return Vector(); }
 
   // Returns a Vector with all elements set to the given value.
-  static const Vector Fill(T value) { return ToVector(BaseType::Fill(value)); }
+  static constexpr const Vector Fill(T value) {
+    return Helper::template Fill<Vector>(value);
+  }
 
   // Returns a Vector representing the X axis.
-  static const Vector AxisX();
+  static constexpr const Vector AxisX() { return Helper::AxisX(); }
   // Returns a Vector representing the Y axis if it exists.
-  static const Vector AxisY();
+  static constexpr const Vector AxisY() { return Helper::AxisY(); }
   // Returns a Vector representing the Z axis if it exists.
-  static const Vector AxisZ();
+  static constexpr const Vector AxisZ() { return Helper::AxisZ(); }
   // Returns a Vector representing the W axis if it exists.
-  static const Vector AxisW();
+  static constexpr const Vector AxisW() { return Helper::AxisW(); }
 
   // Self-modifying operators.
   void operator+=(const Vector& v) { BaseType::Add(v); }
@@ -255,6 +265,8 @@ class Vector : public VectorBase<Dimension, T> {
  private:
   // Type this is derived from.
   typedef VectorBase<Dimension, T> BaseType;
+  // Implements the static functions for this Dimension.
+  typedef typename BaseType::template StaticHelper<Dimension, T> Helper;
 
   // Converts a VectorBase of the correct type to a Vector.
   static const Vector ToVector(const BaseType& b) {
@@ -293,13 +305,13 @@ class Point : public VectorBase<Dimension, T> {
   typedef Vector<Dimension, T> VectorType;
 
   // The default constructor zero-intializes all elements.
-  Point() : BaseType() {}
+  constexpr Point() : BaseType() {}
 
   // Dimension-specific constructors that are passed individual element values.
-  explicit Point(T e0) : BaseType(e0) {}
-  Point(T e0, T e1) : BaseType(e0, e1) {}
-  Point(T e0, T e1, T e2) : BaseType(e0, e1, e2) {}
-  Point(T e0, T e1, T e2, T e3) : BaseType(e0, e1, e2, e3) {}
+  constexpr explicit Point(T e0) : BaseType(e0) {}
+  constexpr Point(T e0, T e1) : BaseType(e0, e1) {}
+  constexpr Point(T e0, T e1, T e2) : BaseType(e0, e1, e2) {}
+  constexpr Point(T e0, T e1, T e2, T e3) : BaseType(e0, e1, e2, e3) {}
 
   // Constructor for a Point of dimension N from a Point of dimension N-1 and
   // a scalar of the correct type, assuming N is at least 2.
@@ -311,10 +323,13 @@ class Point : public VectorBase<Dimension, T> {
       : BaseType(p) {}
 
   // Returns a Point containing all zeroes.
-  static const Point Zero() { return ToPoint(BaseType::Zero()); }
+  static constexpr const Point Zero() { return Point(); }
 
   // Returns a Point with all elements set to the given value.
-  static const Point Fill(T value) { return ToPoint(BaseType::Fill(value)); }
+  static constexpr const Point Fill(T value) {
+    return BaseType::template StaticHelper<Dimension, T>::template Fill<Point>(
+        value);
+  }
 
   // Self-modifying operators.
   void operator+=(const Point& v) { BaseType::Add(v); }
@@ -408,33 +423,25 @@ std::istream& operator>>(std::istream& in, Point<Dimension, T>& v) {
 //------------------------------------------------------------------------------
 
 template <int Dimension, typename T>
-VectorBase<Dimension, T>::VectorBase(T e0) {
+constexpr VectorBase<Dimension, T>::VectorBase(T e0) : elem_{e0} {
   ION_STATIC_ASSERT(Dimension == 1, "Bad Dimension in VectorBase constructor");
-  elem_[0] = e0;
 }
 
 template <int Dimension, typename T>
-VectorBase<Dimension, T>::VectorBase(T e0, T e1) {
+constexpr VectorBase<Dimension, T>::VectorBase(T e0, T e1) : elem_{e0, e1} {
   ION_STATIC_ASSERT(Dimension == 2, "Bad Dimension in VectorBase constructor");
-  elem_[0] = e0;
-  elem_[1] = e1;
 }
 
 template <int Dimension, typename T>
-VectorBase<Dimension, T>::VectorBase(T e0, T e1, T e2) {
+constexpr VectorBase<Dimension, T>::VectorBase(T e0, T e1, T e2)
+    : elem_{e0, e1, e2} {
   ION_STATIC_ASSERT(Dimension == 3, "Bad Dimension in VectorBase constructor");
-  elem_[0] = e0;
-  elem_[1] = e1;
-  elem_[2] = e2;
 }
 
 template <int Dimension, typename T>
-VectorBase<Dimension, T>::VectorBase(T e0, T e1, T e2, T e3) {
+constexpr VectorBase<Dimension, T>::VectorBase(T e0, T e1, T e2, T e3)
+    : elem_{e0, e1, e2, e3} {
   ION_STATIC_ASSERT(Dimension == 4, "Bad Dimension in VectorBase constructor");
-  elem_[0] = e0;
-  elem_[1] = e1;
-  elem_[2] = e2;
-  elem_[3] = e3;
 }
 
 template <int Dimension, typename T>
@@ -482,48 +489,51 @@ void VectorBase<Dimension, T>::Set(T e0, T e1, T e2, T e3) {
   elem_[3] = e3;
 }
 
-// Specializations to help with static functions.
+// Specializations to help with static functions. The Fill() functions are
+// templatized on the returned type so that Vectors and Points can be filled
+// without converting from VectorBase, which would not be constexpr.
 template <int Dimension, typename T>
 template <typename U>
 struct VectorBase<Dimension, T>::StaticHelper<1, U> {
   typedef math::Vector<1, U> Vector;
-  typedef math::VectorBase<1, U> VectorBase;
-  static const Vector AxisX() {
+  static constexpr const Vector AxisX() {
     return Vector(static_cast<U>(1));
   }
-  static const VectorBase Fill(U value) { return VectorBase(value); }
+  template <typename V> static constexpr const V Fill(U value) {
+    return V(value);
+  }
 };
 
 template <int Dimension, typename T>
 template <typename U>
 struct VectorBase<Dimension, T>::StaticHelper<2, U> {
   typedef math::Vector<2, U> Vector;
-  typedef math::VectorBase<2, U> VectorBase;
-  static const Vector AxisX() {
+  static constexpr const Vector AxisX() {
     return Vector(static_cast<U>(1), static_cast<U>(0));
   }
-  static const Vector AxisY() {
+  static constexpr const Vector AxisY() {
     return Vector(static_cast<U>(0), static_cast<U>(1));
   }
-  static const VectorBase Fill(U value) { return VectorBase(value, value); }
+  template <typename V> static constexpr const V Fill(U value) {
+    return V(value, value);
+  }
 };
 
 template <int Dimension, typename T>
 template <typename U>
 struct VectorBase<Dimension, T>::StaticHelper<3, U> {
   typedef math::Vector<3, U> Vector;
-  typedef math::VectorBase<3, U> VectorBase;
-  static const Vector AxisX() {
+  static constexpr const Vector AxisX() {
     return Vector(static_cast<U>(1), static_cast<U>(0), static_cast<U>(0));
   }
-  static const Vector AxisY() {
+  static constexpr const Vector AxisY() {
     return Vector(static_cast<U>(0), static_cast<U>(1), static_cast<U>(0));
   }
-  static const Vector AxisZ() {
+  static constexpr const Vector AxisZ() {
     return Vector(static_cast<U>(0), static_cast<U>(0), static_cast<U>(1));
   }
-  static const VectorBase Fill(U value) {
-    return VectorBase(value, value, value);
+  template <typename V> static constexpr const V Fill(U value) {
+    return V(value, value, value);
   }
 };
 
@@ -531,69 +541,27 @@ template <int Dimension, typename T>
 template <typename U>
 struct VectorBase<Dimension, T>::StaticHelper<4, U> {
   typedef math::Vector<4, U> Vector;
-  typedef math::VectorBase<4, U> VectorBase;
-  static const Vector AxisX() {
+  static constexpr const Vector AxisX() {
     return Vector(static_cast<U>(1), static_cast<U>(0), static_cast<U>(0),
                   static_cast<U>(0));
   }
-  static const Vector AxisY() {
+  static constexpr const Vector AxisY() {
     return Vector(static_cast<U>(0), static_cast<U>(1), static_cast<U>(0),
                   static_cast<U>(0));
   }
-  static const Vector AxisZ() {
+  static constexpr const Vector AxisZ() {
     return Vector(static_cast<U>(0), static_cast<U>(0), static_cast<U>(1),
                   static_cast<U>(0));
   }
-  static const Vector AxisW() {
+  static constexpr const Vector AxisW() {
     return Vector(static_cast<U>(0), static_cast<U>(0), static_cast<U>(0),
                   static_cast<U>(1));
   }
-  static const VectorBase Fill(U value) {
-    return VectorBase(value, value, value, value);
+  template <typename V> static constexpr const V Fill(U value) {
+    return V(value, value, value, value);
   }
 };
 
-// Zero, Fill, and the Vector::Axis? functions use the above static methods.
-template <int Dimension, typename T>
-const VectorBase<Dimension, T> VectorBase<Dimension, T>::Zero() {
-  static VectorBase<Dimension, T> v =
-      StaticHelper<Dimension, T>::Fill(static_cast<T>(0));
-  return v;
-}
-
-template <int Dimension, typename T>
-const VectorBase<Dimension, T> VectorBase<Dimension, T>::Fill(T value) {
-  return StaticHelper<Dimension, T>::Fill(value);
-}
-
-template <int Dimension, typename T>
-const Vector<Dimension, T> Vector<Dimension, T>::AxisX() {
-  static const Vector<Dimension, T> v =
-      BaseType::template StaticHelper<Dimension, T>::AxisX();
-  return v;
-}
-
-template <int Dimension, typename T>
-const Vector<Dimension, T> Vector<Dimension, T>::AxisY() {
-  static const Vector<Dimension, T> v =
-      BaseType::template StaticHelper<Dimension, T>::AxisY();
-  return v;
-}
-
-template <int Dimension, typename T>
-const Vector<Dimension, T> Vector<Dimension, T>::AxisZ() {
-  static const Vector<Dimension, T> v =
-      BaseType::template StaticHelper<Dimension, T>::AxisZ();
-  return v;
-}
-
-template <int Dimension, typename T>
-const Vector<Dimension, T> Vector<Dimension, T>::AxisW() {
-  static const Vector<Dimension, T> v =
-      BaseType::template StaticHelper<Dimension, T>::AxisW();
-  return v;
-}
-
 template <int Dimension, typename T>
 void VectorBase<Dimension, T>::Add(const VectorBase& v) {
   for (int i = 0; i < Dimension; ++i)
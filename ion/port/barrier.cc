@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/port/barrier.h"
 
+#include "ion/port/threadutils.h"
+
 #if defined(ION_PLATFORM_WINDOWS)
 #  include <assert.h>  // For checking return values since port has no logging.
 #  include <algorithm>  // for swap
@@ -27,8 +29,9 @@ namespace port {
 
 //-----------------------------------------------------------------------------
 //
-// Linux and QNX are the only platforms that support barriers in pthreads. Both
-// the windows and non-Linux/QNX implementations below may seem rather complex.
+// Linux and QNX are the only platforms that support barriers in pthreads, and
+// Linux and Android use futexes instead. The Windows and pthreads condition
+// variable implementations below may seem rather complex.
 // This is because they guard against two potential errors:
 //   - Deadlock between a wait and a broadcast/set event, ensuring that all
 //     threads have entered the wait branch before the broadcast.
@@ -107,7 +110,54 @@ void Barrier::WaitInternal(int32 increment, int32 limit, HANDLE turnstile) {
   }
 }
 
-#elif defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_QNX)
+#elif ION_PORT_HAS_FUTEX
+//-----------------------------------------------------------------------------
+//
+// Futex version.
+//
+// Waiting threads sleep on a generation counter, which the last thread to
+// arrive increments before waking them all. Since the counter is read before
+// arriving, a thread cannot miss the increment of its own round, and the wait
+// count is reset before the increment so the next round can start at once.
+//
+//-----------------------------------------------------------------------------
+
+Barrier::Barrier(uint32 thread_count)
+    : thread_count_(static_cast<int32>(thread_count)),
+      wait_count_(0),
+      generation_(0),
+      waiting_count_(0),
+      is_valid_(thread_count_ > 0) {}
+
+Barrier::~Barrier() {
+  // Block until no thread is in the Wait() method, since woken threads still
+  // read |generation_|.
+  while (waiting_count_ != 0) {}
+}
+
+void Barrier::Wait() {
+  if (IsValid() && thread_count_ > 1) {
+    ++waiting_count_;
+    const int32 generation = generation_.load(std::memory_order_acquire);
+    if (wait_count_.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+        thread_count_) {
+      // Last thread is in.  Start the next round and release the others.
+      wait_count_.store(0, std::memory_order_relaxed);
+      generation_.fetch_add(1, std::memory_order_release);
+      futex::Wake(&generation_, thread_count_ - 1);
+    } else {
+      // Spin briefly in case the other threads are about to arrive.
+      for (int i = 0; i < futex::GetSpinCount() &&
+           generation_.load(std::memory_order_acquire) == generation; ++i)
+        PauseCpu();
+      while (generation_.load(std::memory_order_acquire) == generation)
+        futex::Wait(&generation_, generation, NULL);
+    }
+    --waiting_count_;
+  }
+}
+
+#elif defined(ION_PLATFORM_QNX)
 //-----------------------------------------------------------------------------
 //
 // Barrier pthreads version.
@@ -140,8 +190,8 @@ void Barrier::Wait() {
 //
 // Non-barrier pthreads version.
 //
-// Pthread barriers are an optional part of the Posix spec, and Mac, iOS, and
-// Android do not support them, so this version is used on those platforms.
+// Pthread barriers are an optional part of the Posix spec, and Mac and iOS do
+// not support them, so this version is used on those platforms.
 //
 //-----------------------------------------------------------------------------
 
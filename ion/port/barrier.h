@@ -27,6 +27,7 @@ limitations under the License.
 #include "base/integral_types.h"
 #include "base/macros.h"
 #include "ion/port/atomic.h"
+#include "ion/port/futex.h"
 
 namespace ion {
 namespace port {
@@ -60,8 +61,16 @@ class Barrier {
   std::atomic<int32> wait_count_;
   HANDLE turnstile1_;
   HANDLE turnstile2_;
-#elif defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_QNX)
-  // Linux and QNX are the only platforms that support barriers in pthreads.
+#elif ION_PORT_HAS_FUTEX
+  const int32 thread_count_;
+  // The number of threads that have arrived in the current round.
+  std::atomic<int32> wait_count_;
+  // Incremented when the last thread arrives, which releases the others.
+  std::atomic<int32> generation_;
+  // The number of threads in Wait(), so that the destructor can wait for them.
+  std::atomic<int32> waiting_count_;
+#elif defined(ION_PLATFORM_QNX)
+  // QNX is the only other platform that supports barriers in pthreads.
   pthread_barrier_t barrier_;
   // pthread_barrier_wait() modifies state after unblocking, so we need a bit
   // more synchronization to make sure we don't destroy the barrier too soon.
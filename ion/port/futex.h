@@ -0,0 +1,81 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_PORT_FUTEX_H_
+#define ION_PORT_FUTEX_H_
+
+// This file contains the internal helpers that Semaphore, Barrier, and
+// base::SpinMutex use to block on Linux and Android, where futexes let a thread
+// sleep until the value of an atomic integer changes without holding any kernel
+// object. Uncontended operations then never leave user space.
+
+#if defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID)
+#  define ION_PORT_HAS_FUTEX 1
+#else
+#  define ION_PORT_HAS_FUTEX 0
+#endif
+
+#if ION_PORT_HAS_FUTEX
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include "base/integral_types.h"
+
+namespace ion {
+namespace port {
+namespace futex {
+
+static_assert(sizeof(std::atomic<int32>) == sizeof(int32),
+              "Futexes require lock-free 32-bit atomics");
+
+// Returns the number of times a waiter checks the value before sleeping.
+// Waking a sleeping thread takes several microseconds, so spinning briefly pays
+// off when the waiter is woken soon after it starts waiting. On a single CPU
+// spinning only delays the thread that would wake the waiter, so it is
+// disabled.
+inline int GetSpinCount() {
+  static const int kSpinCount = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 100 : 0;
+  return kSpinCount;
+}
+
+// Blocks the calling thread while |value| equals |expected|, or until the
+// relative |timeout| expires if it is non-NULL. This may return spuriously,
+// so callers must check the value again.
+inline void Wait(std::atomic<int32>* value, int32 expected,
+                 const timespec* timeout) {
+  syscall(SYS_futex, reinterpret_cast<int32*>(value), FUTEX_WAIT_PRIVATE,
+          expected, timeout, NULL, 0);
+}
+
+// Wakes up to |count| threads blocked in Wait() on |value|.
+inline void Wake(std::atomic<int32>* value, int32 count) {
+  syscall(SYS_futex, reinterpret_cast<int32*>(value), FUTEX_WAKE_PRIVATE,
+          count, NULL, NULL, 0);
+}
+
+}  // namespace futex
+}  // namespace port
+}  // namespace ion
+
+#endif  // ION_PORT_HAS_FUTEX
+
+#endif  // ION_PORT_FUTEX_H_
@@ -46,4 +46,25 @@ limitations under the License.
 #define ION_PRETTY_FUNCTION __PRETTY_FUNCTION__
 #endif
 
+// ION_HAS_NATIVE_THREAD_LOCAL is 1 if the toolchain supports C++11 thread_local
+// variables, which are much cheaper to access than thread-local storage keys,
+// and 0 otherwise. Defining ION_NO_NATIVE_THREAD_LOCAL forces it to 0.
+#if defined(ION_NO_NATIVE_THREAD_LOCAL) || defined(ION_PLATFORM_NACL) || \
+    defined(ION_PLATFORM_ASMJS)
+#define ION_HAS_NATIVE_THREAD_LOCAL 0
+#elif defined(__clang__)
+#if __has_feature(cxx_thread_local)
+#define ION_HAS_NATIVE_THREAD_LOCAL 1
+#else
+#define ION_HAS_NATIVE_THREAD_LOCAL 0
+#endif
+#elif defined(_MSC_VER)
+#define ION_HAS_NATIVE_THREAD_LOCAL (_MSC_VER >= 1900)
+#elif defined(__GNUC__)
+#define ION_HAS_NATIVE_THREAD_LOCAL \
+  (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#else
+#define ION_HAS_NATIVE_THREAD_LOCAL 0
+#endif
+
 #endif  // ION_PORT_MACROS_H_
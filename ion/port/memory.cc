@@ -19,6 +19,8 @@ limitations under the License.
 
 #if defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID) || \
     defined(ION_PLATFORM_GENERIC_ARM)
+#include <sys/mman.h>
+#include <unistd.h>
 #include <fstream>  // NOLINT(readability/streams)
 #include <sstream>
 #endif
@@ -28,6 +30,7 @@ limitations under the License.
 #include <sys/errno.h>
 #include <sys/sysctl.h>
 #include <sys/types.h>
+#include <unistd.h>
 #endif
 
 #if defined(ION_PLATFORM_WINDOWS)
@@ -118,5 +121,58 @@ uint64 GetSystemMemorySize() {
 #endif
 }
 
+size_t GetPageSize() {
+#if defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID) || \
+    defined(ION_PLATFORM_GENERIC_ARM) || defined(ION_PLATFORM_MAC) || \
+    defined(ION_PLATFORM_IOS)
+  static const size_t kPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  return kPageSize;
+#elif defined(ION_PLATFORM_WINDOWS)
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  return system_info.dwPageSize;
+#else
+  return 4096U;
+#endif
+}
+
+size_t GetHugePageSize() {
+#if (defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID)) && \
+    defined(MADV_HUGEPAGE)
+  // The file only exists if the kernel supports transparent huge pages.
+  static const size_t kHugePageSize = [] {
+    std::ifstream size_file(
+        "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+    size_t size = 0U;
+    if (!(size_file >> size))
+      size = 0U;
+    return size;
+  }();
+  return kHugePageSize;
+#else
+  return 0U;
+#endif
+}
+
+bool AdviseHugePages(void* p, size_t size) {
+#if (defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID)) && \
+    defined(MADV_HUGEPAGE)
+  if (!GetHugePageSize())
+    return false;
+  // madvise() only accepts page-aligned ranges, so round inward to the whole
+  // pages within the memory.
+  const size_t page_size = GetPageSize();
+  const size_t begin = reinterpret_cast<size_t>(p);
+  const size_t aligned_begin = (begin + page_size - 1U) & ~(page_size - 1U);
+  const size_t aligned_end = (begin + size) & ~(page_size - 1U);
+  if (aligned_end <= aligned_begin)
+    return false;
+  return madvise(reinterpret_cast<void*>(aligned_begin),
+                 aligned_end - aligned_begin, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif
+}
+
 }  // namespace port
 }  // namespace ion
@@ -18,6 +18,8 @@ limitations under the License.
 #ifndef ION_PORT_MEMORY_H_
 #define ION_PORT_MEMORY_H_
 
+#include <stddef.h>
+
 #include "base/integral_types.h"
 
 namespace ion {
@@ -29,6 +31,18 @@ ION_API uint64 GetProcessResidentMemorySize();
 // Return the hardware RAM size in bytes.
 ION_API uint64 GetSystemMemorySize();
 
+// Return the size of a virtual memory page in bytes.
+ION_API size_t GetPageSize();
+
+// Return the size of a transparent huge page in bytes, or 0 if the platform
+// does not support them.
+ION_API size_t GetHugePageSize();
+
+// Advise the OS to back the whole pages within size bytes at p with huge pages
+// when it can. Return whether the advice was accepted; this is always false if
+// GetHugePageSize() returns 0.
+ION_API bool AdviseHugePages(void* p, size_t size);
+
 }  // namespace port
 }  // namespace ion
 
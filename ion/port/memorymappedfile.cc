@@ -17,8 +17,12 @@ limitations under the License.
 
 #include "ion/port/memorymappedfile.h"
 
+#include <string.h>
+
 // Exclude tricky-to-implement platforms until we need them.
 #if defined(ION_PLATFORM_WINDOWS)
+#include <windows.h>
+
 #include "ion/port/fileutils.h"
 #include "ion/port/string.h"
 #elif !defined(ION_PLATFORM_NACL)
@@ -33,62 +37,255 @@ limitations under the License.
 namespace ion {
 namespace port {
 
+namespace {
+
+// Returns the granularity of mapping offsets.
+static uint64 GetMappingGranularity() {
+#if defined(ION_PLATFORM_WINDOWS)
+  SYSTEM_INFO info;
+  ::GetSystemInfo(&info);
+  return info.dwAllocationGranularity;
+#elif defined(POSIX_LIKE_ENOUGH)
+  return static_cast<uint64>(sysconf(_SC_PAGESIZE));
+#else
+  return 1U;
+#endif
+}
+
+}  // anonymous namespace
+
 MemoryMappedFile::MemoryMappedFile(const std::string& path)
-    : data_(NULL), length_(0) {
+    : MemoryMappedFile(path, kReadOnly, 0U, 0U) {}
+
+MemoryMappedFile::MemoryMappedFile(const std::string& path, Mode mode,
+                                   uint64 offset, size_t length)
+    : data_(NULL),
+      length_(0),
+      mapping_base_(NULL),
+      mapping_length_(0),
+      offset_(offset),
+      mode_(mode),
 #if defined(ION_PLATFORM_WINDOWS)
+      file_(INVALID_HANDLE_VALUE),
+      mapping_(NULL) {
   const std::wstring wide = Utf8ToWide(path);
-  HANDLE handle = ::CreateFileW(wide.c_str(), GENERIC_READ,
-                                FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
-                                OPEN_EXISTING, 0, NULL);
-  if (handle != INVALID_HANDLE_VALUE) {
-    mapping_ = ::CreateFileMapping(handle, NULL, PAGE_READONLY, 0, 0, NULL);
-    if (mapping_) {
-      data_ = ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
-      LARGE_INTEGER size;
-      if (::GetFileSizeEx(handle, &size)) {
-        length_ = static_cast<size_t>(size.QuadPart);
-      } else {
-        ::UnmapViewOfFile(data_);
-        data_ = NULL;
-      }
-    }
-    ::CloseHandle(handle);
+  file_ = ::CreateFileW(
+      wide.c_str(),
+      mode == kReadOnly ? GENERIC_READ : GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+      mode == kCreate ? CREATE_ALWAYS : OPEN_EXISTING, 0, NULL);
+  if (file_ == INVALID_HANDLE_VALUE)
+    return;
+  LARGE_INTEGER size;
+  if (!::GetFileSizeEx(file_, &size)) {
+    Close();
+    return;
   }
+  const uint64 file_size = static_cast<uint64>(size.QuadPart);
 #elif defined(POSIX_LIKE_ENOUGH)
-  struct stat path_stat = {0};
-  if (stat(path.c_str(), &path_stat))
-    return;
-  length_ = static_cast<size_t>(path_stat.st_size);
-  int fd = open(path.c_str(), O_RDONLY);
-  if (fd < 0)
+      fd_(-1) {
+  const int flags = mode == kReadOnly ? O_RDONLY :
+      mode == kReadWrite ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC;
+  fd_ = open(path.c_str(), flags, 0644);
+  if (fd_ < 0)
     return;
-  data_ = mmap(NULL, length_, PROT_READ, MAP_PRIVATE, fd, 0);
-  if (data_ == MAP_FAILED || close(fd)) {
-    data_ = NULL;
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat)) {
+    Close();
     return;
   }
+  const uint64 file_size = static_cast<uint64>(file_stat.st_size);
+#else
+      fd_(-1) {
+  const uint64 file_size = 0U;
 #endif
+
+  if (length == 0U && file_size > offset)
+    length = static_cast<size_t>(file_size - offset);
+  if (offset + length > file_size) {
+    // Read-only mappings cannot extend the file.
+    if (mode == kReadOnly || !Resize(length))
+      Close();
+  } else if (!Map(length)) {
+    Close();
+  }
+  // Read-only mappings do not need the file once they are mapped.
+  if (mode == kReadOnly)
+    Close();
 }
 
 MemoryMappedFile::~MemoryMappedFile() {
+  Unmap();
+  Close();
+}
+
+bool MemoryMappedFile::Map(size_t length) {
+  if (length == 0U)
+    return true;
+#if !defined(ION_PLATFORM_WINDOWS) && !defined(POSIX_LIKE_ENOUGH)
+  return false;
+#else
+  const uint64 granularity = GetMappingGranularity();
+  const uint64 mapping_offset = offset_ - offset_ % granularity;
+  const size_t delta = static_cast<size_t>(offset_ - mapping_offset);
+  const size_t mapping_length = length + delta;
+#if defined(ION_PLATFORM_WINDOWS)
+  mapping_ = ::CreateFileMapping(
+      file_, NULL, mode_ == kReadOnly ? PAGE_READONLY : PAGE_READWRITE, 0, 0,
+      NULL);
+  if (!mapping_)
+    return false;
+  void* base = ::MapViewOfFile(
+      mapping_, mode_ == kReadOnly ? FILE_MAP_READ : FILE_MAP_WRITE,
+      static_cast<DWORD>(mapping_offset >> 32),
+      static_cast<DWORD>(mapping_offset & 0xffffffffU), mapping_length);
+  if (!base) {
+    ::CloseHandle(mapping_);
+    mapping_ = NULL;
+    return false;
+  }
+#elif defined(POSIX_LIKE_ENOUGH)
+  void* base = mmap(NULL, mapping_length,
+                    mode_ == kReadOnly ? PROT_READ : PROT_READ | PROT_WRITE,
+                    mode_ == kReadOnly ? MAP_PRIVATE : MAP_SHARED, fd_,
+                    static_cast<off_t>(mapping_offset));
+  if (base == MAP_FAILED)
+    return false;
+#endif
+  mapping_base_ = base;
+  mapping_length_ = mapping_length;
+  data_ = static_cast<char*>(base) + delta;
+  length_ = length;
+  return true;
+#endif
+}
+
+void MemoryMappedFile::Unmap() {
 #if defined(ION_PLATFORM_WINDOWS)
-  if (data_)
-    ::UnmapViewOfFile(data_);
+  if (mapping_base_)
+    ::UnmapViewOfFile(mapping_base_);
   if (mapping_)
     ::CloseHandle(mapping_);
+  mapping_ = NULL;
 #elif defined(POSIX_LIKE_ENOUGH)
-  if (data_)
-    munmap(data_, length_);
+  if (mapping_base_)
+    munmap(mapping_base_, mapping_length_);
 #endif  // POSIX_LIKE_ENOUGH
+  data_ = NULL;
+  length_ = 0U;
+  mapping_base_ = NULL;
+  mapping_length_ = 0U;
+}
+
+void MemoryMappedFile::Close() {
+#if defined(ION_PLATFORM_WINDOWS)
+  if (file_ != INVALID_HANDLE_VALUE)
+    ::CloseHandle(file_);
+  file_ = INVALID_HANDLE_VALUE;
+#elif defined(POSIX_LIKE_ENOUGH)
+  if (fd_ >= 0)
+    close(fd_);
+  fd_ = -1;
+#endif
 }
 
 const void* MemoryMappedFile::GetData() const {
   return data_;
 }
 
+void* MemoryMappedFile::GetMutableData() const {
+  return mode_ == kReadOnly ? NULL : data_;
+}
+
 size_t MemoryMappedFile::GetLength() const {
   return length_;
 }
 
+bool MemoryMappedFile::Advise(Advice advice, size_t offset, size_t length) {
+  if (!data_ || offset >= length_)
+    return false;
+  if (length == 0U || length > length_ - offset)
+    length = length_ - offset;
+#if defined(POSIX_LIKE_ENOUGH) && !defined(ION_PLATFORM_ASMJS)
+  int posix_advice;
+  switch (advice) {
+    case kNormal: posix_advice = MADV_NORMAL; break;
+    case kSequential: posix_advice = MADV_SEQUENTIAL; break;
+    case kRandom: posix_advice = MADV_RANDOM; break;
+    case kWillNeed: posix_advice = MADV_WILLNEED; break;
+    case kDontNeed:
+      // MADV_DONTNEED discards changes to private mappings, so only advise
+      // shared ones.
+      if (mode_ == kReadOnly)
+        return false;
+      posix_advice = MADV_DONTNEED;
+      break;
+    case kHugePages:
+#if defined(MADV_HUGEPAGE)
+      posix_advice = MADV_HUGEPAGE;
+      break;
+#else
+      return false;
+#endif
+    default:
+      return false;
+  }
+  // The advised range must start at a page boundary.
+  char* start = static_cast<char*>(data_) + offset;
+  const size_t misalignment = static_cast<size_t>(
+      (start - static_cast<char*>(mapping_base_)) % GetMappingGranularity());
+  return madvise(start - misalignment, length + misalignment,
+                 posix_advice) == 0;
+#else
+  (void)advice;
+  return false;
+#endif
+}
+
+bool MemoryMappedFile::Resize(size_t length) {
+  if (mode_ == kReadOnly)
+    return false;
+  Unmap();
+  const uint64 file_size = offset_ + length;
+#if defined(ION_PLATFORM_WINDOWS)
+  LARGE_INTEGER size;
+  size.QuadPart = static_cast<LONGLONG>(file_size);
+  if (file_ == INVALID_HANDLE_VALUE ||
+      !::SetFilePointerEx(file_, size, NULL, FILE_BEGIN) ||
+      !::SetEndOfFile(file_))
+    return false;
+#elif defined(POSIX_LIKE_ENOUGH)
+  if (fd_ < 0 || ftruncate(fd_, static_cast<off_t>(file_size)))
+    return false;
+#else
+  (void)file_size;
+#endif
+  return Map(length);
+}
+
+bool MemoryMappedFile::Append(const void* data, size_t size) {
+  const size_t old_length = length_;
+  if (!Resize(old_length + size))
+    return false;
+  if (size)
+    memcpy(static_cast<char*>(data_) + old_length, data, size);
+  return true;
+}
+
+bool MemoryMappedFile::Flush() {
+  if (mode_ == kReadOnly)
+    return false;
+  if (!mapping_base_)
+    return true;
+#if defined(ION_PLATFORM_WINDOWS)
+  return ::FlushViewOfFile(mapping_base_, mapping_length_) &&
+      ::FlushFileBuffers(file_);
+#elif defined(POSIX_LIKE_ENOUGH)
+  return msync(mapping_base_, mapping_length_, MS_SYNC) == 0;
+#else
+  return false;
+#endif
+}
+
 }  // namespace port
 }  // namespace ion
@@ -18,6 +18,9 @@ limitations under the License.
 #ifndef ION_PORT_MEMORYMAPPEDFILE_H_
 #define ION_PORT_MEMORYMAPPEDFILE_H_
 
+#include <string>
+
+#include "base/integral_types.h"
 #include "base/macros.h"
 
 #if defined(ION_PLATFORM_WINDOWS)
@@ -27,26 +30,108 @@ limitations under the License.
 namespace ion {
 namespace port {
 
-// Read-only in-memory view of an entire file on disk.
+// In-memory view of a file on disk, or of a range of it. Views are read-only
+// unless they are created with a writable mode, in which case writes to the
+// memory are written back to the file.
 class ION_API MemoryMappedFile {
  public:
-  // Maps the file at |path|.  In case of error GetData() will be NULL.
-  // Mappings start at offset 0, extend the length of the file, and are
-  // read-only.
+  // How the file is opened and mapped.
+  enum Mode {
+    // Maps an existing file for reading.
+    kReadOnly,
+    // Maps an existing file for reading and writing. The file is extended if
+    // it ends before the mapped range does.
+    kReadWrite,
+    // Creates the file, or truncates an existing one, and maps it for reading
+    // and writing. The file is extended to the end of the mapped range.
+    kCreate,
+  };
+
+  // Hints about how the mapped memory will be accessed; see Advise().
+  enum Advice {
+    kNormal,
+    // The memory will be read sequentially, so the OS may read ahead
+    // aggressively and drop pages soon after they are read.
+    kSequential,
+    // The memory will be read in random order, so reading ahead is wasteful.
+    kRandom,
+    // The memory will be needed soon, so the OS should start reading it in.
+    kWillNeed,
+    // The memory will not be needed soon, so the OS may drop its pages.
+    kDontNeed,
+    // The memory should be backed by huge pages where the OS supports it for
+    // the file's filesystem.
+    kHugePages,
+  };
+
+  // Maps the entire file at |path| for reading. In case of error GetData()
+  // will be NULL.
   explicit MemoryMappedFile(const std::string& path);
+  // Maps |length| bytes of the file at |path| starting at |offset| using
+  // |mode|. A |length| of 0 maps the rest of an existing file. In case of error
+  // GetData() will be NULL, as it is for an empty range.
+  MemoryMappedFile(const std::string& path, Mode mode, uint64 offset,
+                   size_t length);
   ~MemoryMappedFile();
 
   // Returns a pointer to the head of the mapped region.
   const void* GetData() const;
 
+  // Returns a writable pointer to the head of the mapped region, or NULL if
+  // the mapping is read-only.
+  void* GetMutableData() const;
+
   // Returns the length of the mapped region.
   size_t GetLength() const;
 
+  // Returns the offset in the file of the mapped region.
+  uint64 GetOffset() const { return offset_; }
+
+  // Returns the mode the file was mapped with.
+  Mode GetMode() const { return mode_; }
+
+  // Passes |advice| about |length| bytes of the mapped region starting at
+  // |offset| to the OS, where a |length| of 0 means the rest of the region.
+  // Returns false if the OS does not support the advice or rejects it. Advice
+  // never changes the contents of the memory.
+  bool Advise(Advice advice, size_t offset, size_t length);
+
+  // Changes the length of a writable mapping to |length|, resizing the file to
+  // end with it. This may move the mapping, so pointers returned by GetData()
+  // and GetMutableData() are invalidated. Returns false if the mapping is
+  // read-only or resizing fails, in which case the mapping is unmapped.
+  bool Resize(size_t length);
+
+  // Extends a writable mapping and the file by |size| bytes and copies |data|
+  // into the new bytes. This calls Resize(), so appending many small pieces is
+  // slow; Resize() with room to spare first when the final size is known.
+  bool Append(const void* data, size_t size);
+
+  // Writes modified memory of a writable mapping back to the file, and waits
+  // for the write to finish. Returns false on error.
+  bool Flush();
+
  private:
+  // Maps |length| bytes of the open file starting at offset_, and returns
+  // whether that succeeded. An empty range is not mapped.
+  bool Map(size_t length);
+  // Unmaps the region, if it is mapped.
+  void Unmap();
+  // Closes the file, if it is open.
+  void Close();
+
   void* data_;  // Beginning of the mapped region.
   size_t length_;  // Length of the mapped region.
+  // The mapping itself, which begins at a page boundary at or before data_.
+  void* mapping_base_;
+  size_t mapping_length_;
+  const uint64 offset_;
+  const Mode mode_;
 #if defined(ION_PLATFORM_WINDOWS)
+  HANDLE file_;
   HANDLE mapping_;
+#else
+  int fd_;
 #endif
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(MemoryMappedFile);
@@ -39,6 +39,7 @@
         'environment.h',
         'fileutils.cc',
         'fileutils.h',
+        'futex.h',
         'logging.cc',
         'logging.h',
         'macros.h',
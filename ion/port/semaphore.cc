@@ -42,6 +42,9 @@ Semaphore::Semaphore() {
   value_.store(0);
 #elif defined(ION_PLATFORM_ASMJS)
   value_ = 0;
+#elif ION_PORT_HAS_FUTEX
+  value_.store(0);
+  waiter_count_.store(0);
 #else
   sem_init(&semaphore_, 0, 0);
 #endif
@@ -65,6 +68,9 @@ Semaphore::Semaphore(uint32 initial_value) {
   // assert() on invalid calls (a Wait() will never succeed if it cannot
   // succeed immediately).
   value_ = initial_value;
+#elif ION_PORT_HAS_FUTEX
+  value_.store(static_cast<int32>(initial_value));
+  waiter_count_.store(0);
 #else
   sem_init(&semaphore_, 0, initial_value);
 #endif
@@ -75,7 +81,7 @@ Semaphore::~Semaphore() {
   // Nothing to be done; ARC automatically releases semaphore_.
 #elif defined(ION_PLATFORM_WINDOWS)
   CloseHandle(semaphore_);
-#elif defined(ION_PLATFORM_ASMJS)
+#elif defined(ION_PLATFORM_ASMJS) || ION_PORT_HAS_FUTEX
   // Nothing to do.
 #else
   sem_destroy(&semaphore_);
@@ -99,6 +105,13 @@ bool Semaphore::Post() {
 #elif defined(ION_PLATFORM_ASMJS)
   ++value_;
   return true;
+#elif ION_PORT_HAS_FUTEX
+  // Both this and WaitUntil() change one counter before reading the other, so
+  // either a waiter sees the post or this sees the waiter.
+  value_.fetch_add(1, std::memory_order_seq_cst);
+  if (waiter_count_.load(std::memory_order_seq_cst) > 0)
+    futex::Wake(&value_, 1);
+  return true;
 #else
   return sem_post(&semaphore_) == 0;
 #endif
@@ -135,6 +148,17 @@ bool Semaphore::TryWait() {
   } else {
     return false;
   }
+#elif ION_PORT_HAS_FUTEX
+  int32 val = value_.load(std::memory_order_acquire);
+  while (val > 0) {
+    // |val| is updated if another thread changed the value.
+    if (value_.compare_exchange_weak(val, val - 1,
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+      return true;
+    }
+  }
+  return false;
 #else
   return sem_trywait(&semaphore_) == 0;
 #endif
@@ -170,6 +194,20 @@ bool Semaphore::TimedWaitMs(int64 timeout_in_ms) {
 #elif defined(ION_PLATFORM_ASMJS)
   // Waiting doesn't make sense in asmjs (no threads) so just do a TryWait.
   return TryWait();
+#elif ION_PORT_HAS_FUTEX
+  static const int64 kMsecPerSec = 1000;
+  static const int64 kNsecPerMsec = 1000000;
+  static const int64 kNsecPerSec = 1000000000;
+  // Use the monotonic clock so that changes of the system time do not affect
+  // the timeout.
+  timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  const int64 nsec =
+      deadline.tv_nsec + (timeout_in_ms % kMsecPerSec) * kNsecPerMsec;
+  deadline.tv_sec += static_cast<time_t>(timeout_in_ms / kMsecPerSec +
+                                         nsec / kNsecPerSec);
+  deadline.tv_nsec = static_cast<long>(nsec % kNsecPerSec);  // NOLINT
+  return WaitUntil(&deadline);
 #else
   static const int64 kMsecToNsec = 1000000;
   static const int64 kNsecPerSec = 1000000000;
@@ -241,9 +279,47 @@ bool Semaphore::Wait() {
         "Semaphore::Wait cannot block on a platform without threads.");
     return false;
   }
+#elif ION_PORT_HAS_FUTEX
+  return WaitUntil(NULL);
 #else
   return sem_wait(&semaphore_) == 0;
 #endif
 }
+
+#if ION_PORT_HAS_FUTEX
+bool Semaphore::WaitUntil(const timespec* deadline) {
+  // Spin briefly in case a post is imminent.
+  for (int i = 0; i < futex::GetSpinCount(); ++i) {
+    if (TryWait())
+      return true;
+    PauseCpu();
+  }
+
+  static const int64 kNsecPerSec = 1000000000;
+  while (!TryWait()) {
+    timespec timeout;
+    timespec* timeout_ptr = NULL;
+    if (deadline) {
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      const int64 remaining_ns =
+          static_cast<int64>(deadline->tv_sec - now.tv_sec) * kNsecPerSec +
+          (deadline->tv_nsec - now.tv_nsec);
+      if (remaining_ns <= 0)
+        return false;
+      timeout.tv_sec = static_cast<time_t>(remaining_ns / kNsecPerSec);
+      timeout.tv_nsec = static_cast<long>(remaining_ns % kNsecPerSec);  // NOLINT
+      timeout_ptr = &timeout;
+    }
+    // Sleep only if the value is still zero once this is counted as a waiter;
+    // the futex rechecks the value atomically before sleeping.
+    waiter_count_.fetch_add(1, std::memory_order_seq_cst);
+    if (value_.load(std::memory_order_seq_cst) == 0)
+      futex::Wait(&value_, 0, timeout_ptr);
+    waiter_count_.fetch_sub(1, std::memory_order_seq_cst);
+  }
+  return true;
+}
+#endif
 }  // namespace port
 }  // namespace ion
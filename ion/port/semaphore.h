@@ -23,12 +23,15 @@ limitations under the License.
 #elif defined(ION_PLATFORM_WINDOWS)
 #include <windows.h>
 #include <atomic>
+#elif defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID)
+#include <atomic>
 #else
 #include <semaphore.h>
 #endif
 
 #include "base/integral_types.h"
 #include "base/macros.h"
+#include "ion/port/futex.h"
 
 namespace ion {
 namespace port {
@@ -37,6 +40,11 @@ namespace port {
 // a call to Wait(), and are woken when another thread calls Post() on the same
 // Semaphore. If multiple threads are Wait()ing, then a call to Post() will wake
 // only one thread.
+//
+// On Linux and Android the semaphore is a pair of atomic counters, and threads
+// only enter the kernel through a futex when they actually have to sleep or be
+// woken. Waiting threads spin briefly before sleeping, so handing work to a
+// thread that has just gone idle does not pay for a full sleep and wakeup.
 class ION_API Semaphore {
  public:
   // Initializes a semaphore with an internal value of zero.
@@ -69,6 +77,17 @@ class ION_API Semaphore {
   std::atomic<int> value_;
 #elif defined(ION_PLATFORM_ASMJS)
   int value_;
+#elif ION_PORT_HAS_FUTEX
+  // Blocks until |value_| is non-zero or the deadline on the monotonic clock
+  // passes, if |deadline| is non-NULL. Returns whether the semaphore was
+  // acquired.
+  bool WaitUntil(const timespec* deadline);
+
+  // The number of posts that have not been consumed by waits.
+  std::atomic<int32> value_;
+  // The number of threads that are sleeping or about to sleep in WaitUntil(),
+  // so that Post() only makes a system call when someone needs waking.
+  std::atomic<int32> waiter_count_;
 #else
   sem_t semaphore_;
 #endif
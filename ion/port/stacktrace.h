@@ -33,6 +33,10 @@ namespace port {
 class ION_API StackTrace {
  public:
   StackTrace();
+  // Wraps addresses captured elsewhere, e.g., by a sampling profiler, so that
+  // they can be symbolicated later in the same process.
+  explicit StackTrace(const std::vector<void*>& addresses)
+      : addresses_(addresses) {}
   ~StackTrace() {}
   // Returns the stack as a vector of addresses.
   const std::vector<void*>& GetAddresses() const { return addresses_; }
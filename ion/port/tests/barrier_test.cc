@@ -87,6 +87,39 @@ TEST(Barrier, MultiThreads) {
   JoinThread(t5);
   JoinThread(t6);
 }
+
+// Callback function for the many rounds test. This passes through the barrier
+// |rounds| times, incrementing the counter before each Wait().
+static bool RoundsCallback(Barrier* barrier, int rounds) {
+  for (int i = 0; i < rounds; ++i) {
+    ++count;
+    barrier->Wait();
+  }
+  return true;
+}
+
+TEST(Barrier, ManyRounds) {
+  // Reusing the barrier immediately must not let a fast thread pass through
+  // the next round before the others have left the current one.
+  static const int kRounds = 2000;
+  count = 0;
+  Barrier barrier(4);
+  ThreadStdFunc func(std::bind(RoundsCallback, &barrier, kRounds));
+  ThreadId tids[3];
+  for (int i = 0; i < 3; ++i)
+    tids[i] = SpawnThreadStd(&func);
+  for (int i = 0; i < kRounds; ++i) {
+    ++count;
+    barrier.Wait();
+    // All threads have incremented the counter for this round, and none can
+    // increment it for the next round until this thread waits again.
+    EXPECT_LE(4 * (i + 1), count);
+    EXPECT_GE(4 * (i + 1) + 3, count);
+  }
+  for (int i = 0; i < 3; ++i)
+    JoinThread(tids[i]);
+  EXPECT_EQ(4 * kRounds, count);
+}
 #endif  // !ION_PLATFORM_ASMJS
 
 }  // namespace port
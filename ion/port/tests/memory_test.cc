@@ -61,3 +61,32 @@ TEST(Memory, ProcessMemory) {
   EXPECT_EQ(0U, process_memory);
 #endif
 }
+
+TEST(Memory, PageSize) {
+  const size_t page_size = ion::port::GetPageSize();
+  EXPECT_GE(page_size, 4096U);
+  EXPECT_EQ(0U, page_size & (page_size - 1U));
+  const size_t huge_page_size = ion::port::GetHugePageSize();
+  if (huge_page_size) {
+    EXPECT_EQ(0U, huge_page_size % page_size);
+  }
+}
+
+TEST(Memory, AdviseHugePages) {
+  const size_t huge_page_size = ion::port::GetHugePageSize();
+  if (!huge_page_size) {
+    uint8 byte;
+    EXPECT_FALSE(ion::port::AdviseHugePages(&byte, 1U));
+    return;
+  }
+  // A range without a whole page is rejected.
+  const size_t size = 2U * huge_page_size;
+  uint8* const memory = static_cast<uint8*>(malloc(size));
+  EXPECT_FALSE(ion::port::AdviseHugePages(memory, 1U));
+  // Whether the kernel accepts the advice depends on its configuration, but
+  // the memory must stay usable either way.
+  ion::port::AdviseHugePages(memory, size);
+  memset(memory, 1, size);
+  EXPECT_EQ(1U, memory[size - 1U]);
+  free(memory);
+}
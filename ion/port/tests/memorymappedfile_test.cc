@@ -17,6 +17,10 @@ limitations under the License.
 
 #include "ion/port/memorymappedfile.h"
 
+#include <string.h>
+
+#include <string>
+
 #include "ion/base/logging.h"
 #include "ion/port/fileutils.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
@@ -51,6 +55,103 @@ TEST(MemoryMappedFile, Map) {
   CHECK(RemoveFile(filename));
 }
 
+TEST(MemoryMappedFile, MapRange) {
+  const std::string filename = GetTemporaryFilename();
+  std::string contents;
+  for (int i = 0; i < 20000; ++i)
+    contents.push_back(static_cast<char>('a' + i % 26));
+  FILE* file = OpenFile(filename, "wb");
+  ASSERT_TRUE(file);
+  ASSERT_EQ(contents.size(),
+            fwrite(contents.data(), 1U, contents.size(), file));
+  ASSERT_EQ(0, fclose(file));
+  {
+    // The offset does not need to be aligned to a page.
+    MemoryMappedFile mapped(filename, MemoryMappedFile::kReadOnly, 5001U, 100U);
+    ASSERT_TRUE(mapped.GetData());
+    EXPECT_EQ(100U, mapped.GetLength());
+    EXPECT_EQ(5001U, mapped.GetOffset());
+    EXPECT_TRUE(mapped.GetMutableData() == NULL);
+    EXPECT_EQ(contents.substr(5001U, 100U),
+              std::string(static_cast<const char*>(mapped.GetData()),
+                          mapped.GetLength()));
+
+    // Advice is only a hint, but it must not change the contents.
+    mapped.Advise(MemoryMappedFile::kWillNeed, 0U, 0U);
+    mapped.Advise(MemoryMappedFile::kSequential, 10U, 50U);
+    mapped.Advise(MemoryMappedFile::kHugePages, 0U, 0U);
+    EXPECT_FALSE(mapped.Advise(MemoryMappedFile::kNormal, 100U, 0U));
+    EXPECT_EQ(contents.substr(5001U, 100U),
+              std::string(static_cast<const char*>(mapped.GetData()),
+                          mapped.GetLength()));
+
+    // A length of 0 maps the rest of the file.
+    MemoryMappedFile rest(filename, MemoryMappedFile::kReadOnly, 19000U, 0U);
+    EXPECT_EQ(1000U, rest.GetLength());
+
+    // Read-only ranges cannot extend past the end of the file.
+    MemoryMappedFile past_end(filename, MemoryMappedFile::kReadOnly, 19000U,
+                              2000U);
+    EXPECT_TRUE(past_end.GetData() == NULL);
+    EXPECT_EQ(0U, past_end.GetLength());
+
+    // Read-only mappings cannot be written or resized.
+    EXPECT_FALSE(mapped.Resize(200U));
+    EXPECT_FALSE(mapped.Flush());
+  }
+  CHECK(RemoveFile(filename));
+}
+
+// Shared writable mappings are not supported by asm.js' in-memory filesystem.
+#if !defined(ION_PLATFORM_ASMJS)
+TEST(MemoryMappedFile, WriteAndAppend) {
+  const std::string filename = GetTemporaryFilename();
+  const std::string hello = "Hello";
+  const std::string world = ", world!";
+  {
+    MemoryMappedFile mapped(filename, MemoryMappedFile::kCreate, 0U,
+                            hello.size());
+    ASSERT_TRUE(mapped.GetMutableData());
+    EXPECT_EQ(mapped.GetData(), mapped.GetMutableData());
+    EXPECT_EQ(hello.size(), mapped.GetLength());
+    memcpy(mapped.GetMutableData(), hello.data(), hello.size());
+    EXPECT_TRUE(mapped.Append(world.data(), world.size()));
+    EXPECT_EQ(hello.size() + world.size(), mapped.GetLength());
+    EXPECT_TRUE(mapped.Flush());
+  }
+  {
+    MemoryMappedFile mapped(filename);
+    EXPECT_EQ(hello + world,
+              std::string(static_cast<const char*>(mapped.GetData()),
+                          mapped.GetLength()));
+  }
+  {
+    // Writable mappings of existing files extend them to cover the range.
+    MemoryMappedFile mapped(filename, MemoryMappedFile::kReadWrite, 7U, 10U);
+    ASSERT_TRUE(mapped.GetMutableData());
+    EXPECT_EQ(10U, mapped.GetLength());
+    static_cast<char*>(mapped.GetMutableData())[0] = 'W';
+    EXPECT_TRUE(mapped.Resize(6U));
+    EXPECT_EQ(6U, mapped.GetLength());
+  }
+  {
+    MemoryMappedFile mapped(filename);
+    EXPECT_EQ("Hello, World!",
+              std::string(static_cast<const char*>(mapped.GetData()),
+                          mapped.GetLength()));
+  }
+  {
+    // An empty created file can grow by appending.
+    MemoryMappedFile mapped(filename, MemoryMappedFile::kCreate, 0U, 0U);
+    EXPECT_TRUE(mapped.GetData() == NULL);
+    EXPECT_TRUE(mapped.Append(hello.data(), hello.size()));
+    EXPECT_EQ(hello, std::string(static_cast<const char*>(mapped.GetData()),
+                                 mapped.GetLength()));
+  }
+  CHECK(RemoveFile(filename));
+}
+#endif  // !ION_PLATFORM_ASMJS
+
 #endif  // !WINDOWS && !NACL
 
 }  // namespace port
@@ -17,6 +17,9 @@ limitations under the License.
 
 #include "ion/port/semaphore.h"
 
+#include <functional>
+
+#include "ion/port/threadutils.h"
 #include "ion/port/timer.h"
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
@@ -72,4 +75,38 @@ TEST(Semaphore, InitialValue) {
   EXPECT_TRUE(semaphore3.Wait());
 }
 
-// TODO(user): Add better tests when we have threads.
+#if !defined(ION_PLATFORM_ASMJS)
+// Waits on |ping| and posts |pong| |count| times.
+static bool PingPong(ion::port::Semaphore* ping, ion::port::Semaphore* pong,
+                     int count) {
+  for (int i = 0; i < count; ++i) {
+    ping->Wait();
+    pong->Post();
+  }
+  return true;
+}
+
+TEST(Semaphore, WakeLatency) {
+  // Bounce a post between two threads, which measures the time it takes to
+  // wake a waiting thread.
+  static const int kRoundTrips = 10000;
+  ion::port::Semaphore ping;
+  ion::port::Semaphore pong;
+  ion::port::ThreadStdFunc func(
+      std::bind(PingPong, &ping, &pong, kRoundTrips));
+  const ion::port::ThreadId tid = ion::port::SpawnThreadStd(&func);
+
+  ion::port::Timer timer;
+  for (int i = 0; i < kRoundTrips; ++i) {
+    EXPECT_TRUE(ping.Post());
+    EXPECT_TRUE(pong.Wait());
+  }
+  const double round_trip_us = timer.GetInS() * 1.e6 / kRoundTrips;
+  ion::port::JoinThread(tid);
+  RecordProperty("RoundTripUs", static_cast<int>(round_trip_us));
+
+  // Nothing is left over.
+  EXPECT_FALSE(ping.TryWait());
+  EXPECT_FALSE(pong.TryWait());
+}
+#endif  // !ION_PLATFORM_ASMJS
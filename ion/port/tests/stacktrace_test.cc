@@ -124,6 +124,14 @@ TEST(StackTrace, Recursion) {
   Recursive(stack.size(), 0);
 }
 
+TEST(StackTrace, FromAddresses) {
+  ion::port::StackTrace captured;
+  ion::port::StackTrace stack_trace(captured.GetAddresses());
+  EXPECT_EQ(captured.GetAddresses(), stack_trace.GetAddresses());
+  EXPECT_EQ(captured.GetSymbols(), stack_trace.GetSymbols());
+  EXPECT_EQ(captured.GetSymbolString(), stack_trace.GetSymbolString());
+}
+
 #undef ION_TEST_STACKTRACE
 
 #endif  // ION_DEBUG
@@ -61,6 +61,28 @@ static bool FuncWithIntArg(int arg) {
   return true;
 }
 
+// Tests scheduling options, which only apply to the calling thread.
+static bool SchedulingFunc() {
+#if defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID) || \
+    defined(ION_PLATFORM_IOS) || defined(ION_PLATFORM_MAC) || \
+    defined(ION_PLATFORM_WINDOWS)
+  // Lowering the priority does not require privileges.
+  EXPECT_TRUE(SetThreadSchedulingPriority(kThreadPriorityLow));
+  ThreadOptions options;
+  options.priority = kThreadPriorityBackground;
+  options.core_type = kEfficiencyCores;
+  EXPECT_TRUE(SetThreadOptions(options));
+#else
+  EXPECT_FALSE(SetThreadSchedulingPriority(kThreadPriorityLow));
+  EXPECT_FALSE(SetThreadCpuAffinity(1U));
+#endif
+  // Options left at their defaults are not applied.
+  EXPECT_TRUE(SetThreadOptions(ThreadOptions()));
+
+  s_spawned_id = GetCurrentThreadId();
+  return true;
+}
+
 // Tests thread-local storage. It is passed the key created for the
 // thread-local storage of the calling thread.
 static bool LocalStorageFunc(const ThreadLocalStorageKey& key) {
@@ -144,6 +166,20 @@ TEST(ThreadUtils, StdFunc) {
   s_spawned_id = kInvalidThreadId;
 }
 
+TEST(ThreadUtils, Scheduling) {
+  EXPECT_EQ(0U, GetCoreTypeMask(kAnyCores));
+  // Performance and efficiency cores are either both known or both unknown.
+  const uint64 performance_mask = GetCoreTypeMask(kPerformanceCores);
+  const uint64 efficiency_mask = GetCoreTypeMask(kEfficiencyCores);
+  EXPECT_EQ(0U, performance_mask & efficiency_mask);
+  EXPECT_EQ(performance_mask == 0U, efficiency_mask == 0U);
+
+  ThreadId id = SpawnThread(SchedulingFunc);
+  EXPECT_NE(kInvalidThreadId, id);
+  JoinThread(id);
+  s_spawned_id = kInvalidThreadId;
+}
+
 TEST(ThreadUtils, LocalStorage) {
   int storage;
 
@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "ion/port/threadutils.h"
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>  // NOLINT
 #include <iostream>  // NOLINT
 
@@ -28,6 +30,19 @@ limitations under the License.
 #  define API_DECL
 #endif
 
+#if defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_ANDROID)
+#  include <sys/resource.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  define CPU_SCHEDULING_SUPPORTED 1
+#else
+#  define CPU_SCHEDULING_SUPPORTED 0
+#endif
+
+#if defined(ION_PLATFORM_IOS) || defined(ION_PLATFORM_MAC)
+#  include <pthread/qos.h>
+#endif
+
 #if defined(ION_PLATFORM_ASMJS) || defined(ION_PLATFORM_NACL)
 # define THREAD_NAMING_SUPPORTED 0
 #else
@@ -168,6 +183,32 @@ static void CreateThreadStd(const ThreadStdFunc* func, void* arg,
 
 #endif
 
+#if CPU_SCHEDULING_SUPPORTED
+
+// Returns the number of CPUs that can be represented in a CPU mask.
+static int GetMaskableCpuCount() {
+  const long count = sysconf(_SC_NPROCESSORS_CONF);  // NOLINT
+  return count > 0 ? static_cast<int>(std::min(count, 64L)) : 0;
+}
+
+// Returns the maximum frequency of the passed CPU in kHz, or 0 if it is not
+// known.
+static uint64 GetCpuMaxFrequency(int cpu) {
+  char path[96];
+  snprintf(path, sizeof(path),
+           "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+  uint64 frequency = 0U;
+  if (FILE* file = fopen(path, "r")) {
+    unsigned long long value = 0U;  // NOLINT
+    if (fscanf(file, "%llu", &value) == 1)
+      frequency = value;
+    fclose(file);
+  }
+  return frequency;
+}
+
+#endif
+
 }  // anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -214,6 +255,60 @@ void SetMainThreadId(ThreadId id) {
   InitMainThreadId(id);
 }
 
+bool SetThreadOptions(const ThreadOptions& options) {
+  bool success = true;
+  ThreadPriority priority = options.priority;
+#if defined(ION_PLATFORM_IOS) || defined(ION_PLATFORM_MAC)
+  // The scheduler picks cores based on the quality of service class.
+  if (priority == kThreadPriorityNormal) {
+    if (options.core_type == kPerformanceCores)
+      priority = kThreadPriorityHigh;
+    else if (options.core_type == kEfficiencyCores)
+      priority = kThreadPriorityLow;
+  }
+#endif
+  if (priority != kThreadPriorityNormal)
+    success = SetThreadSchedulingPriority(priority) && success;
+
+  uint64 mask = options.affinity_mask;
+  if (!mask && options.core_type != kAnyCores)
+    mask = GetCoreTypeMask(options.core_type);
+  if (mask)
+    success = SetThreadCpuAffinity(mask) && success;
+  return success;
+}
+
+uint64 GetCoreTypeMask(CoreType type) {
+#if CPU_SCHEDULING_SUPPORTED
+  if (type == kAnyCores)
+    return 0U;
+  const int cpu_count = GetMaskableCpuCount();
+  uint64 frequencies[64];
+  uint64 min_frequency = 0U;
+  uint64 max_frequency = 0U;
+  for (int i = 0; i < cpu_count; ++i) {
+    frequencies[i] = GetCpuMaxFrequency(i);
+    if (!frequencies[i])
+      return 0U;
+    min_frequency = i ? std::min(min_frequency, frequencies[i]) :
+        frequencies[i];
+    max_frequency = std::max(max_frequency, frequencies[i]);
+  }
+  if (min_frequency == max_frequency)
+    return 0U;
+  // Processors may have more than two kinds of cores, so only the slowest ones
+  // are considered efficiency cores.
+  uint64 mask = 0U;
+  for (int i = 0; i < cpu_count; ++i) {
+    if ((frequencies[i] == min_frequency) == (type == kEfficiencyCores))
+      mask |= static_cast<uint64>(1) << i;
+  }
+  return mask;
+#else
+  return 0U;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 //
 // Windows-specific public functions.
@@ -261,6 +356,30 @@ void YieldThread() {
   ::SwitchToThread();
 }
 
+bool SetThreadCpuAffinity(uint64 mask) {
+  if (::SetThreadAffinityMask(::GetCurrentThread(),
+                              static_cast<DWORD_PTR>(mask)))
+    return true;
+  std::cerr << "***ION error: Unable to set thread affinity: "
+            << GetLastError() << "\n";
+  return false;
+}
+
+bool SetThreadSchedulingPriority(ThreadPriority priority) {
+  static const int kPriorities[] = {
+    THREAD_PRIORITY_LOWEST,
+    THREAD_PRIORITY_BELOW_NORMAL,
+    THREAD_PRIORITY_NORMAL,
+    THREAD_PRIORITY_ABOVE_NORMAL,
+    THREAD_PRIORITY_TIME_CRITICAL,
+  };
+  if (::SetThreadPriority(::GetCurrentThread(), kPriorities[priority]))
+    return true;
+  std::cerr << "***ION error: Unable to set thread priority: "
+            << GetLastError() << "\n";
+  return false;
+}
+
 ThreadId GetCurrentThreadId() {
   return ::GetCurrentThreadId();
 }
@@ -348,6 +467,64 @@ void YieldThread() {
   CheckPthreadSuccess("Yielding thread", sched_yield());
 }
 
+bool SetThreadCpuAffinity(uint64 mask) {
+#if CPU_SCHEDULING_SUPPORTED
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int i = 0; i < 64; ++i) {
+    if (mask & (static_cast<uint64>(1) << i))
+      CPU_SET(i, &cpus);
+  }
+  // A pid of 0 means the calling thread.
+  return CheckPthreadSuccess(
+      "Setting thread affinity",
+      sched_setaffinity(0, sizeof(cpus), &cpus) ? errno : 0);
+#else
+  return false;
+#endif
+}
+
+bool SetThreadSchedulingPriority(ThreadPriority priority) {
+#if defined(ION_PLATFORM_IOS) || defined(ION_PLATFORM_MAC)
+  static const qos_class_t kQosClasses[] = {
+    QOS_CLASS_BACKGROUND,
+    QOS_CLASS_UTILITY,
+    QOS_CLASS_DEFAULT,
+    QOS_CLASS_USER_INITIATED,
+    QOS_CLASS_USER_INTERACTIVE,
+  };
+  return CheckPthreadSuccess(
+      "Setting thread QoS class",
+      ::pthread_set_qos_class_self_np(kQosClasses[priority], 0));
+#elif CPU_SCHEDULING_SUPPORTED
+  sched_param param;
+  memset(&param, 0, sizeof(param));
+  if (priority == kThreadPriorityRealtime) {
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    return CheckPthreadSuccess(
+        "Setting thread scheduling policy",
+        ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param));
+  }
+  // Drop a real-time policy set by an earlier call.
+  int policy = SCHED_OTHER;
+  sched_param current_param;
+  if (!::pthread_getschedparam(::pthread_self(), &policy, &current_param) &&
+      policy != SCHED_OTHER &&
+      !CheckPthreadSuccess(
+          "Setting thread scheduling policy",
+          ::pthread_setschedparam(::pthread_self(), SCHED_OTHER, &param)))
+    return false;
+  // On Linux nice levels apply to individual threads.
+  static const int kNiceLevels[] = { 10, 5, 0, -5 };
+  const id_t thread_id = static_cast<id_t>(syscall(SYS_gettid));
+  return CheckPthreadSuccess(
+      "Setting thread nice level",
+      setpriority(PRIO_PROCESS, thread_id, kNiceLevels[priority]) ? errno : 0);
+#else
+  return false;
+#endif
+}
+
 ThreadId GetCurrentThreadId() {
   return ::pthread_self();
 }
@@ -383,6 +560,7 @@ bool DeleteThreadLocalStorageKey(ThreadLocalStorageKey key) {
 #endif
 
 #undef API_DECL
+#undef CPU_SCHEDULING_SUPPORTED
 #undef THREAD_NAMING_SUPPORTED
 
 }  // namespace port
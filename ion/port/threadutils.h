@@ -27,6 +27,8 @@ limitations under the License.
 #include <functional>
 #include <string>
 
+#include "base/integral_types.h"
+
 namespace ion {
 namespace port {
 
@@ -70,6 +72,40 @@ static const ThreadId kInvalidThreadId = static_cast<ThreadId>(-1);
 static const ThreadLocalStorageKey kInvalidThreadLocalStorageKey =
     static_cast<ThreadLocalStorageKey>(-1);
 
+// Scheduling priorities of threads, from lowest to highest. These map to nice
+// levels on Linux and Android, to quality of service classes on Apple
+// platforms, and to thread priorities on Windows. kThreadPriorityRealtime uses
+// the SCHED_FIFO policy with pthreads, which usually requires privileges.
+enum ThreadPriority {
+  kThreadPriorityBackground,
+  kThreadPriorityLow,
+  kThreadPriorityNormal,
+  kThreadPriorityHigh,
+  kThreadPriorityRealtime,
+};
+
+// Kinds of CPU cores a thread can be restricted to on processors with cores of
+// different performance, such as ARM big.LITTLE designs.
+enum CoreType {
+  kAnyCores,
+  kPerformanceCores,
+  kEfficiencyCores,
+};
+
+// Scheduling options for a thread, applied with SetThreadOptions().
+struct ThreadOptions {
+  ThreadOptions()
+      : priority(kThreadPriorityNormal),
+        affinity_mask(0U),
+        core_type(kAnyCores) {}
+  ThreadPriority priority;
+  // The CPUs the thread may run on, one bit per CPU index. 0 does not restrict
+  // the thread.
+  uint64 affinity_mask;
+  // Restricts the thread to the passed kind of cores if |affinity_mask| is 0.
+  CoreType core_type;
+};
+
 //-----------------------------------------------------------------------------
 //
 // Thread lifetime functions.
@@ -91,6 +127,19 @@ ION_API bool JoinThread(ThreadId id);
 // waiting to execute.
 ION_API void YieldThread();
 
+// Hints to the CPU that the calling thread is busy-waiting, which saves power
+// and frees resources for a sibling hardware thread. Unlike YieldThread(), this
+// does not give up the CPU.
+inline void PauseCpu() {
+#if defined(ION_PLATFORM_WINDOWS)
+  YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__("pause");
+#elif defined(__aarch64__) || (defined(__ARM_ARCH) && __ARM_ARCH >= 7)
+  __asm__ __volatile__("yield");
+#endif
+}
+
 //-----------------------------------------------------------------------------
 //
 // Thread naming functions.
@@ -111,6 +160,34 @@ ION_API size_t GetMaxThreadNameLength();
 // it.
 ION_API bool SetThreadName(const std::string& name);
 
+//-----------------------------------------------------------------------------
+//
+// Thread scheduling functions. These all apply to the current thread, and
+// return false if the platform does not support them or if an error occurs.
+//
+//-----------------------------------------------------------------------------
+
+// Restricts the current thread to the CPUs whose bits are set in |mask|. This
+// is supported on Linux, Android and Windows.
+ION_API bool SetThreadCpuAffinity(uint64 mask);
+
+// Sets the scheduling priority of the current thread. This is not supported on
+// NaCl, asm.js and QNX.
+ION_API bool SetThreadSchedulingPriority(ThreadPriority priority);
+
+// Returns a mask of the CPUs of the passed type, or 0 if the types of CPUs
+// cannot be told apart, as when all cores are the same. Cores are classified
+// by their maximum frequencies, which are only available on Linux and Android.
+// kAnyCores returns 0.
+ION_API uint64 GetCoreTypeMask(CoreType type);
+
+// Applies all of the passed options to the current thread. Options that are
+// left at their defaults are not applied. On Apple platforms, where threads
+// cannot be pinned, a core type is applied by raising or lowering the quality
+// of service class if the priority is kThreadPriorityNormal. Returns false if
+// any option could not be applied.
+ION_API bool SetThreadOptions(const ThreadOptions& options);
+
 //-----------------------------------------------------------------------------
 //
 // Thread ID functions.
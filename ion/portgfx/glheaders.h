@@ -96,6 +96,11 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #      undef NOGDI  // Need to get wgl functions from windows.h.
 #    endif
 #    include <windows.h>  // NOLINT
+// windows.h defines MemoryBarrier() as a macro, which would clash with the
+// GraphicsManager wrapper of glMemoryBarrier().
+#    if defined(MemoryBarrier)
+#      undef MemoryBarrier
+#    endif
 #  endif
 #  if !defined(GL_GLEXT_PROTOTYPES)
 #    define GL_GLEXT_PROTOTYPES  // For glGetString() to be defined.
@@ -134,15 +139,30 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 
 // These constants are not always defined in OpenGL header files.
 
+#ifndef GL_ACTIVE_RESOURCES
+#  define GL_ACTIVE_RESOURCES 0x92F5
+#endif
 #ifndef GL_ALIASED_POINT_SIZE_RANGE
 #  define GL_ALIASED_POINT_SIZE_RANGE 0x846D
 #endif
+#ifndef GL_ALL_BARRIER_BITS
+#  define GL_ALL_BARRIER_BITS 0xFFFFFFFF
+#endif
 #ifndef GL_ALPHA_BITS
 #  define GL_ALPHA_BITS 0x0D55
 #endif
 #ifndef GL_ALREADY_SIGNALED
 #  define GL_ALREADY_SIGNALED 0x911A
 #endif
+#ifndef GL_ANY_SAMPLES_PASSED
+#  define GL_ANY_SAMPLES_PASSED 0x8C2F
+#endif
+#ifndef GL_ANY_SAMPLES_PASSED_CONSERVATIVE
+#  define GL_ANY_SAMPLES_PASSED_CONSERVATIVE 0x8D6A
+#endif
+#ifndef GL_ARRAY_SIZE
+#  define GL_ARRAY_SIZE 0x92FB
+#endif
 #ifndef GL_BACK
 #  define GL_BACK 0x0405
 #endif
@@ -161,15 +181,36 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_BUFFER_MAP_POINTER
 #define GL_BUFFER_MAP_POINTER 0x88BD
 #endif
+#ifndef GL_BUFFER_IMMUTABLE_STORAGE
+#  define GL_BUFFER_IMMUTABLE_STORAGE 0x821F
+#endif
 #ifndef GL_BUFFER_OBJECT
 #  define GL_BUFFER_OBJECT 0x9151
 #endif
+#ifndef GL_BUFFER_STORAGE_FLAGS
+#  define GL_BUFFER_STORAGE_FLAGS 0x8220
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#  define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_CLIENT_STORAGE_BIT
+#  define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+#ifndef GL_COLOR
+#  define GL_COLOR 0x1800
+#endif
 #ifndef GL_COLOR_ATTACHMENT0
 #  define GL_COLOR_ATTACHMENT0 0x8CE0
 #endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#  define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
 #ifndef GL_COMPARE_REF_TO_TEXTURE
 #  define GL_COMPARE_REF_TO_TEXTURE 0x884E
 #endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#  define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 #ifndef GL_COMPRESSED_R11_EAC
 #  define GL_COMPRESSED_R11_EAC 0x9270
 #endif
@@ -191,6 +232,48 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG
 #define GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG 0x8C00
 #endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_4x4_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_5x4_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_5x4_KHR 0x93B1
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_5x5_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_5x5_KHR 0x93B2
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_6x5_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_6x5_KHR 0x93B3
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_6x6_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_6x6_KHR 0x93B4
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_8x5_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_8x5_KHR 0x93B5
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_8x6_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_8x6_KHR 0x93B6
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_8x8_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_8x8_KHR 0x93B7
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_10x5_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_10x5_KHR 0x93B8
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_10x6_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_10x6_KHR 0x93B9
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_10x8_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_10x8_KHR 0x93BA
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_10x10_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_10x10_KHR 0x93BB
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_12x10_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_12x10_KHR 0x93BC
+#endif
+#ifndef GL_COMPRESSED_RGBA_ASTC_12x12_KHR
+#  define GL_COMPRESSED_RGBA_ASTC_12x12_KHR 0x93BD
+#endif
 #ifndef GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG
 #define GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG 0x8C03
 #endif
@@ -224,6 +307,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2
 #  define GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9277
 #endif
+#ifndef GL_COMPUTE_SHADER
+#  define GL_COMPUTE_SHADER 0x91B9
+#endif
 #ifndef GL_CONDITION_SATISFED
 #  define GL_CONDITION_SATISFIED 0x911C
 #endif
@@ -299,6 +385,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR
 #  define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
 #endif
+#ifndef GL_DEPTH
+#  define GL_DEPTH 0x1801
+#endif
 #ifndef GL_DEPTH_ATTACHMENT
 #  define GL_DEPTH_ATTACHMENT 0x8D00
 #endif
@@ -323,15 +412,27 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_DEPTH_STENCIL
 #  define GL_DEPTH_STENCIL 0x84F9
 #endif
+#ifndef GL_DISPATCH_INDIRECT_BUFFER
+#  define GL_DISPATCH_INDIRECT_BUFFER 0x90EE
+#endif
 #ifndef GL_DRAW_BUFFER
 #  define GL_DRAW_BUFFER 0x0C01
 #endif
+#ifndef GL_DYNAMIC_STORAGE_BIT
+#  define GL_DYNAMIC_STORAGE_BIT 0x0100
+#endif
 #ifndef GL_DRAW_FRAMEBUFFER
 #  define GL_DRAW_FRAMEBUFFER 0x8CA9
 #endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#  define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
 #ifndef GL_DRAW_FRAMEBUFFER_BINDING
 #  define GL_DRAW_FRAMEBUFFER_BINDING 0x8CA6
 #endif
+#ifndef GL_ELEMENT_ARRAY_BARRIER_BIT
+#  define GL_ELEMENT_ARRAY_BARRIER_BIT 0x00000002
+#endif
 #ifndef GL_ETC1_RGB8_OES
 #  define GL_ETC1_RGB8_OES 0x8D64
 #endif
@@ -353,12 +454,24 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LAYER
 #  define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LAYER 0x8CD4
 #endif
+#ifndef GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_BASE_VIEW_INDEX_OVR
+#  define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_BASE_VIEW_INDEX_OVR 0x9632
+#endif
 #ifndef GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL
 #  define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL 0x8CD2
 #endif
 #ifndef GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_CUBE_MAP_FACE
 #  define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_CUBE_MAP_FACE 0x8CD3
 #endif
+#ifndef GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR
+#  define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_NUM_VIEWS_OVR 0x9630
+#endif
+#ifndef GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_SAMPLES_EXT
+#  define GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_SAMPLES_EXT 0x8D6C
+#endif
+#ifndef GL_FRAMEBUFFER_BARRIER_BIT
+#  define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+#endif
 #ifndef GL_FRAMEBUFFER_BINDING
 #  define GL_FRAMEBUFFER_BINDING 0x8CA6
 #endif
@@ -395,6 +508,12 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_GPU_DISJOINT_EXT
 #  define GL_GPU_DISJOINT_EXT 0x8FBB
 #endif
+#ifndef GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+#  define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX
+#  define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#endif
 #ifndef GL_GREEN
 #  define GL_GREEN 0x1904
 #endif
@@ -440,12 +559,18 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_INTERLEAVED_ATTRIBS
 #define GL_INTERLEAVED_ATTRIBS 0x8C8C
 #endif
+#ifndef GL_INVALID_INDEX
+#  define GL_INVALID_INDEX 0xFFFFFFFFu
+#endif
 #ifndef GL_INVALID_FRAMEBUFFER_OPERATION
 #  define GL_INVALID_FRAMEBUFFER_OPERATION 0x0506
 #endif
 #ifndef GL_LEFT
 #  define GL_LEFT 0x0406
 #endif
+#ifndef GL_LOCATION
+#  define GL_LOCATION 0x930E
+#endif
 #ifndef GL_LOW_FLOAT
 #  define GL_LOW_FLOAT 0x8DF0
 #endif
@@ -458,6 +583,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_LUMINANCE_ALPHA
 #  define GL_LUMINANCE_ALPHA 0x190A
 #endif
+#ifndef GL_MAP_COHERENT_BIT
+#  define GL_MAP_COHERENT_BIT 0x0080
+#endif
 #ifndef GL_MAP_FLUSH_EXPLICIT_BIT
 #  define GL_MAP_FLUSH_EXPLICIT_BIT 0x0010
 #endif
@@ -467,6 +595,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_MAP_INVALIDATE_RANGE_BIT
 #  define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
 #endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#  define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
 #ifndef GL_MAP_READ_BIT
 #  define GL_MAP_READ_BIT 0x0001
 #endif
@@ -494,6 +625,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_MAX_FRAGMENT_UNIFORM_VECTORS
 #  define GL_MAX_FRAGMENT_UNIFORM_VECTORS 0x8DFD
 #endif
+#ifndef GL_MAX_NAME_LENGTH
+#  define GL_MAX_NAME_LENGTH 0x92F6
+#endif
 #ifndef GL_MAX_RENDERBUFFER_SIZE
 #  define GL_MAX_RENDERBUFFER_SIZE 0x84E8
 #endif
@@ -506,6 +640,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_MAX_SERVER_WAIT_TIMEOUT
 #  define GL_MAX_SERVER_WAIT_TIMEOUT 0x9111
 #endif
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#  define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
 #ifndef GL_MAX_TEXTURE_BUFFER_SIZE
 #  define GL_MAX_TEXTURE_BUFFER_SIZE 0x8C2B
 #endif
@@ -524,6 +661,12 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS
 #define GL_MAX_TRANSFORM_FEEDBACK_SEPARATE_COMPONENTS 0x8C80
 #endif
+#ifndef GL_MAX_UNIFORM_BLOCK_SIZE
+#  define GL_MAX_UNIFORM_BLOCK_SIZE 0x8A30
+#endif
+#ifndef GL_MAX_UNIFORM_BUFFER_BINDINGS
+#  define GL_MAX_UNIFORM_BUFFER_BINDINGS 0x8A2F
+#endif
 #ifndef GL_MAX_VARYING_VECTORS
 #  define GL_MAX_VARYING_VECTORS 0x8DFC
 #endif
@@ -533,6 +676,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_MAX_VERTEX_UNIFORM_VECTORS
 #  define GL_MAX_VERTEX_UNIFORM_VECTORS 0x8DFB
 #endif
+#ifndef GL_MAX_VIEWS_OVR
+#  define GL_MAX_VIEWS_OVR 0x9631
+#endif
 #ifndef GL_MEDIUM_FLOAT
 #  define GL_MEDIUM_FLOAT 0x8DF1
 #endif
@@ -545,6 +691,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_NUM_EXTENSIONS
 #  define GL_NUM_EXTENSIONS 0x821D
 #endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#  define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
 #ifndef GL_NUM_SHADER_BINARY_FORMATS
 #  define GL_NUM_SHADER_BINARY_FORMATS 0x8DF9
 #endif
@@ -581,6 +730,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_PALETTE8_RGBA8_OES
 #  define GL_PALETTE8_RGBA8_OES 0x8B96
 #endif
+#ifndef GL_PIXEL_BUFFER_BARRIER_BIT
+#  define GL_PIXEL_BUFFER_BARRIER_BIT 0x00000080
+#endif
 #ifndef GL_PIXEL_PACK_BUFFER
 #  define GL_PIXEL_PACK_BUFFER 0x88EB
 #endif
@@ -605,6 +757,15 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_PRIMITIVES_GENERATED
 #define GL_PRIMITIVES_GENERATED 0x8C87
 #endif
+#ifndef GL_PROGRAM_BINARY_FORMATS
+#  define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#  define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#  define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
 #ifndef GL_PROGRAM_OBJECT
 #  define GL_PROGRAM_OBJECT 0x8B40
 #endif
@@ -623,6 +784,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_QUERY_COUNTER_BITS_EXT
 #  define GL_QUERY_COUNTER_BITS_EXT 0x8864
 #endif
+#ifndef GL_QUERY_NO_WAIT
+#  define GL_QUERY_NO_WAIT 0x8E14
+#endif
 #ifndef GL_QUERY_OBJECT
 #  define GL_QUERY_OBJECT 0x9153
 #endif
@@ -632,6 +796,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_QUERY_RESULT_EXT
 #  define GL_QUERY_RESULT_EXT 0x8866
 #endif
+#ifndef GL_QUERY_WAIT
+#  define GL_QUERY_WAIT 0x8E13
+#endif
 #ifndef GL_R11F_G11F_B10F
 #  define GL_R11F_G11F_B10F 0x8C3A
 #endif
@@ -842,6 +1009,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_RIGHT
 #  define GL_RIGHT 0x0407
 #endif
+#ifndef GL_SAMPLES_PASSED
+#  define GL_SAMPLES_PASSED 0x8914
+#endif
 #ifndef GL_SAMPLE_POSITION
 #  define GL_SAMPLE_POSITION 0x8E50
 #endif
@@ -905,9 +1075,18 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_SHADER_COMPILER
 #  define GL_SHADER_COMPILER 0x8DFA
 #endif
+#ifndef GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+#  define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#endif
 #ifndef GL_SHADER_OBJECT
 #  define GL_SHADER_OBJECT 0x8B48
 #endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#  define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#  define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
 #ifndef GL_SIGNALED
 #  define GL_SIGNALED 0x9119
 #endif
@@ -932,6 +1111,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_STENCIL_INDEX8
 #  define GL_STENCIL_INDEX8 0x8D48
 #endif
+#ifndef GL_STREAM_READ
+#  define GL_STREAM_READ 0x88E1
+#endif
 #ifndef GL_SYNC_CONDITION
 #  define GL_SYNC_CONDITION 0x9113
 #endif
@@ -1013,9 +1195,15 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_TEXTURE_EXTERNAL_OES
 #  define GL_TEXTURE_EXTERNAL_OES 0x8D65
 #endif
+#ifndef GL_TEXTURE_FETCH_BARRIER_BIT
+#  define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#endif
 #ifndef GL_TEXTURE_FIXED_SAMPLE_LOCATIONS
 #  define GL_TEXTURE_FIXED_SAMPLE_LOCATIONS 0x9107
 #endif
+#ifndef GL_TEXTURE_FREE_MEMORY_ATI
+#  define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#endif
 #ifndef GL_TEXTURE_IMMUTABLE_FORMAT
 #  define GL_TEXTURE_IMMUTABLE_FORMAT 0x912F
 #endif
@@ -1046,6 +1234,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_TEXTURE_SWIZZLE_A
 #  define GL_TEXTURE_SWIZZLE_A 0x8E45
 #endif
+#ifndef GL_TEXTURE_UPDATE_BARRIER_BIT
+#  define GL_TEXTURE_UPDATE_BARRIER_BIT 0x00000100
+#endif
 #ifndef GL_TEXTURE_WRAP_R
 #  define GL_TEXTURE_WRAP_R 0x8072
 #endif
@@ -1103,6 +1294,33 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_TRANSFORM_FEEDBACK_VARYING_MAX_LENGTH
 #define GL_TRANSFORM_FEEDBACK_VARYING_MAX_LENGTH 0x8C76
 #endif
+#ifndef GL_TYPE
+#  define GL_TYPE 0x92FA
+#endif
+#ifndef GL_UNIFORM
+#  define GL_UNIFORM 0x92E1
+#endif
+#ifndef GL_UNIFORM_BARRIER_BIT
+#  define GL_UNIFORM_BARRIER_BIT 0x00000004
+#endif
+#ifndef GL_UNIFORM_BLOCK_BINDING
+#  define GL_UNIFORM_BLOCK_BINDING 0x8A3F
+#endif
+#ifndef GL_UNIFORM_BLOCK_DATA_SIZE
+#  define GL_UNIFORM_BLOCK_DATA_SIZE 0x8A40
+#endif
+#ifndef GL_UNIFORM_BLOCK_NAME_LENGTH
+#  define GL_UNIFORM_BLOCK_NAME_LENGTH 0x8A41
+#endif
+#ifndef GL_UNIFORM_BUFFER
+#  define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_UNIFORM_BUFFER_BINDING
+#  define GL_UNIFORM_BUFFER_BINDING 0x8A28
+#endif
+#ifndef GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+#  define GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT 0x8A34
+#endif
 #ifndef GL_UNSIGNALED
 #  define GL_UNSIGNALED 0x9118
 #endif
@@ -1154,6 +1372,9 @@ typedef void (GL_APIENTRY *GLDEBUGPROC)(GLenum source, GLenum type, GLuint id,
 #ifndef GL_VERTEX_ARRAY_OBJECT
 #  define GL_VERTEX_ARRAY_OBJECT 0x9154
 #endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#  define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
 #ifndef GL_VERTEX_ATTRIB_ARRAY_DIVISOR
 #  define GL_VERTEX_ATTRIB_ARRAY_DIVISOR 0x88fe
 #endif
@@ -17,13 +17,18 @@ limitations under the License.
 
 #include "ion/profile/calltracemanager.h"
 
+#include <algorithm>
+#include <deque>
 #include <fstream>  // NOLINT
 
 #include "ion/analytics/benchmark.h"
 #include "ion/analytics/benchmarkutils.h"
 #include "ion/base/serialize.h"
 #include "ion/base/stringutils.h"
+#include "ion/base/threadspawner.h"
+#include "ion/port/semaphore.h"
 #include "ion/port/threadutils.h"
+#include "ion/profile/timelineindex.h"
 #include "ion/profile/timelinenode.h"
 #include "ion/profile/timelinethread.h"
 #include "ion/profile/tracerecorder.h"
@@ -211,8 +216,302 @@ struct EventBuffer : public Part {
   std::string buffer;
 };
 
+// A custom scope event id and name.
+typedef std::pair<uint32, const char*> ScopeEventDefinition;
+
+// Bits of CallTraceManager::stream_zone_states_.
+static const uint8 kStreamZoneCreated = 0x1;
+static const uint8 kStreamZoneDiscontinuity = 0x2;
+
+// Appends the WTF magic numbers and a chunk holding the file header to output.
+static void AppendFileHeader(uint32 chunk_id, std::string* output) {
+  static const uint32 magic_number = 0xdeadbeef;
+  static const uint32 wtf_version = 0xe8214400;
+  static const uint32 format_version = 10;
+
+  base::AppendBytes(output, magic_number);
+  base::AppendBytes(output, wtf_version);
+  base::AppendBytes(output, format_version);
+
+  // Create the file header
+  Json::Value flags(Json::arrayValue);
+  flags.append("has_high_resolution_times");
+
+  // TODO(user): Add a customized icon for ion. This needs to be a link to
+  // publicly available icon image.
+  Json::Value icon(Json::objectValue);
+  icon["uri"] = "https://maps.gstatic.com/favicon3.ico";
+
+  // TODO(user): Add user agent information, including device, platform,
+  // type, and value information.
+  Json::Value agent(Json::objectValue);
+  agent["device"] = "Ion";
+  agent["platform"] = "SomePlatform";
+  agent["platformVersion"] = "";
+  agent["type"] = "";
+  agent["value"] = "";
+
+  Json::Value context(Json::objectValue);
+  context["args"] = Json::Value(Json::arrayValue);
+  context["contextType"] = "script";
+  context["icon"] = icon;
+  context["taskId"] = "";
+  context["title"] = "Ion";
+  // TODO(user): Add actual URI info to log where the trace was collected.
+  context["userAgent"] = agent;
+
+  Json::Value json;
+  json["type"] = "file_header";
+  json["flags"] = flags;
+  // TODO(user): Add real timebase, units in microseconds.
+  json["timebase"] = 1412611454780.701;
+  json["contextInfo"] = context;
+
+  Json::FastWriter json_writer;
+  std::string json_string = json_writer.write(json);
+  StringTable file_header_table(false);
+  file_header_table.AddString(json_string);
+
+  Chunk file_header;
+  file_header.AddPart(0x10000, &file_header_table);
+  file_header.AppendToString(chunk_id, 0x1, output);
+}
+
+// Appends a chunk defining the passed custom scope events to output. The
+// built-in WTF events are defined first if include_builtins is true.
+static void AppendEventDefinitions(
+    uint32 chunk_id, bool include_builtins,
+    const std::vector<ScopeEventDefinition>& scope_events,
+    std::string* output) {
+  StringTable def_table;
+  if (include_builtins) {
+    def_table.AddString(
+        "wtf.event#define\n"
+        "uint16 wireId, uint16 eventClass, uint32 flags, ascii name, "
+        "ascii args\n"
+        "wtf.trace#discontinuity\n"
+        "wtf.zone#create\n"
+        "uint16 zoneId, ascii name, ascii type, ascii location\n"
+        "wtf.zone#delete\n"
+        "uint16 zoneId\n"
+        "wtf.zone#set\n"
+        "uint16 zoneId\n"
+        "wtf.scope#enter\n"
+        "ascii name\n"
+        "wtf.scope#enterTracing\n"
+        "wtf.scope#leave\n"
+        "wtf.scope#appendData\n"
+        "ascii name, any value\n"
+        "wtf.trace#mark\n"
+        "ascii name, any value\n"
+        "wtf.trace#timeStamp\n"
+        "ascii name, any value\n"
+        "wtf.timeRange#begin\n"
+        "uint32 id, ascii name, any value\n"
+        "wtf.timeRange#end\n"
+        "uint32 id\n"
+        "wtf.timing#frameStart\n"
+        "uint32 number\n"
+        "wtf.timing#frameEnd\n"
+        "uint32 number\n"
+        "wtf.scope#appendData_url_utf8\n"
+        "utf8 url\n"
+        "wtf.scope#appendData_readyState_int32\n"
+        "int32 readyState");
+  }
+
+  // This offset is used to index into strings defining custom scope events.
+  const uint32 event_string_offset = def_table.GetTableSize();
+  for (size_t i = 0; i < scope_events.size(); ++i)
+    def_table.AddString(scope_events[i].second);
+
+  // Note: these are the built-in WTF events that are being defined below.
+  // wireId (1)    wtf.event#define (uint16 wireId, uint16 eventClass,
+  //                                 uint32 flags, ascii name, ascii args)
+  // wireId (2)    wtf.trace#discontinuity ()
+  // wireId (3)    wtf.zone#create (uint16 zoneId, ascii name, ascii type,
+  //                                ascii location)
+  // wireId (4)    wtf.zone#delete (uint16 zoneId)
+  // wireId (5)    wtf.zone#set (uint16 zoneId)
+  // wireId (6)    wtf.scope#enter (ascii name)
+  // wireId (7)    wtf.scope#enterTracing ()
+  // wireId (8)    wtf.scope#leave ()
+  // wireId (9)    wtf.scope#appendData (ascii name, any value)
+  // wireId (10)   wtf.trace#mark (ascii name, any value)
+  // wireId (11)   wtf.trace#timeStamp (ascii name, any value)
+  // wireId (12)   wtf.timeRange#begin (uint32 id, ascii name, any value)
+  // wireId (13)   wtf.timeRange#end (uint32 id)
+  // wireId (14)   wtf.timing#frameStart (uint32 number)
+  // wireId (15)   wtf.timing#frameEnd (uint32 number)
+  // wireId (16)   wtf.scope#appendData_url_utf8 (utf8 url)
+  // wireId (17)   wtf.scope#appendData_readyState_int32 (int32 readyState)
+
+  EventBuffer def_events;
+  {
+    std::string* event_buffer = &def_events.buffer;
+    if (include_builtins) {
+      uint32 builtin[] = {
+          1, 0, 1, 0, 40, 0, 1,
+          1, 0, 2, 0, 32, 2, 0xffffffff,
+          1, 0, 3, 0, 40, 3, 4,
+          1, 0, 4, 0, 40, 5, 6,
+          1, 0, 5, 0, 40, 7, 8,
+          1, 0, 6, 1, 32, 9, 10,
+          1, 0, 7, 1, 44, 11, 0xffffffff,
+          1, 0, 8, 0, 40, 12, 0xffffffff,
+          1, 0, 9, 0, 56, 13, 14,
+          1, 0, 10, 0, 40, 15, 16,
+          1, 0, 11, 0, 32, 17, 18,
+          1, 0, 12, 0, 40, 19, 20,
+          1, 0, 13, 0, 40, 21, 22,
+          1, 0, 14, 0, 8, 23, 24,
+          1, 0, 15, 0, 8, 25, 26,
+          1, 0, 16, 0, 24, 27, 28,
+          1, 0, 17, 0, 24, 29, 30
+      };
+      base::AppendBytes(event_buffer, builtin);
+    }
+
+    // Define each scope event
+    {
+      uint32 temp;
+      for (size_t i = 0; i < scope_events.size(); ++i) {
+        temp = CallTraceManager::kDefineEvent;
+        base::AppendBytes(event_buffer, temp);  // wtf.event#define
+        temp = 0;
+        base::AppendBytes(event_buffer, temp);  // timestamp
+        temp = scope_events[i].first;
+        base::AppendBytes(event_buffer, temp);  // wireId
+        temp = 1;
+        base::AppendBytes(event_buffer, temp);  // eventClass (scope)
+        temp = 0;
+        base::AppendBytes(event_buffer, temp);  // flags (unused)
+        temp = event_string_offset + static_cast<uint32>(i);
+        base::AppendBytes(event_buffer, temp);  // name
+        temp = -1;
+        base::AppendBytes(event_buffer, temp);  // args (none)
+      }
+    }
+  }
+
+  Chunk events_defined;
+  events_defined.AddPart(0x30000, &def_table);
+  events_defined.AddPart(0x20002, &def_events);
+  events_defined.AppendToString(chunk_id, 0x2, output);
+}
+
+// Appends an event creating the zone for a thread to event_buffer. The zone
+// name is name_index in the string table, which must hold "script" and
+// "Some_Location" at indices 0 and 1.
+static void AppendCreateZoneEvent(uint32 zone_id, uint32 name_index,
+                                  std::string* event_buffer) {
+  uint32 temp = CallTraceManager::kCreateZoneEvent;
+  base::AppendBytes(event_buffer, temp);
+  temp = 0;
+  base::AppendBytes(event_buffer, temp);  // timestamp
+  temp = zone_id;
+  base::AppendBytes(event_buffer, temp);  // Zone id
+  temp = name_index;
+  base::AppendBytes(event_buffer, temp);  // Zone name
+  temp = 0;
+  base::AppendBytes(event_buffer, temp);  // Zone type
+  temp = 1;
+  base::AppendBytes(event_buffer, temp);  // Zone location
+}
+
+// Appends an event making zone_id the zone of the events that follow to
+// event_buffer.
+static void AppendSetZoneEvent(uint32 zone_id, std::string* event_buffer) {
+  uint32 temp = CallTraceManager::kSetZoneEvent;
+  base::AppendBytes(event_buffer, temp);
+  temp = 0;
+  base::AppendBytes(event_buffer, temp);  // timestamp
+  temp = zone_id;
+  base::AppendBytes(event_buffer, temp);  // Zone id
+}
+
 }  // namespace
 
+//-----------------------------------------------------------------------------
+//
+// CallTraceManager::StreamWriter.
+//
+//-----------------------------------------------------------------------------
+
+class CallTraceManager::StreamWriter {
+ public:
+  StreamWriter(const StreamFunction& func, size_t max_queued_bytes)
+      : func_(func),
+        max_queued_bytes_(max_queued_bytes),
+        queued_bytes_(0U),
+        done_(false),
+        thread_(new base::ThreadSpawner(
+            "TraceStreamWriter", std::bind(&StreamWriter::ThreadLoop, this))) {}
+
+  // Passes everything that is still queued to the function before returning.
+  ~StreamWriter() {
+    {
+      base::LockGuard lock(&mutex_);
+      done_ = true;
+    }
+    sema_.Post();
+    thread_.reset();
+  }
+
+  // Queues data for the function. Returns false without queuing it if that
+  // would exceed the maximum number of queued bytes, unless force is true.
+  bool Write(const std::string& data, bool force) {
+    {
+      base::LockGuard lock(&mutex_);
+      if (!force && queued_bytes_ + data.length() > max_queued_bytes_)
+        return false;
+      queue_.push_back(data);
+      queued_bytes_ += data.length();
+    }
+    sema_.Post();
+    return true;
+  }
+
+ private:
+  bool ThreadLoop() {
+    while (true) {
+      sema_.Wait();
+      // Write everything that is queued, outside the lock.
+      while (true) {
+        std::string data;
+        {
+          base::LockGuard lock(&mutex_);
+          if (queue_.empty()) {
+            if (done_)
+              return true;
+            break;
+          }
+          data.swap(queue_.front());
+          queue_.pop_front();
+          queued_bytes_ -= data.length();
+        }
+        func_(data);
+      }
+    }
+  }
+
+  const StreamFunction func_;
+  const size_t max_queued_bytes_;
+  port::Mutex mutex_;
+  port::Semaphore sema_;
+  std::deque<std::string> queue_;
+  size_t queued_bytes_;
+  bool done_;
+  // This is last so that the thread starts after everything else exists.
+  std::unique_ptr<base::ThreadSpawner> thread_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// CallTraceManager.
+//
+//-----------------------------------------------------------------------------
+
 ScopedTracer::ScopedTracer(TraceRecorder* recorder, int id)
     : recorder_(recorder) {
   DCHECK(recorder_ && id);
@@ -240,8 +539,15 @@ CallTraceManager::CallTraceManager()
       named_trace_recorders_(GetAllocator()),
       recorder_list_(GetAllocator()),
       buffer_size_(0),
+      timebase_(port::Timer::Clock::now()),
+      time_function_(NULL),
       scope_event_map_(GetAllocator()),
-      reverse_scope_event_map_(GetAllocator()) {
+      reverse_scope_event_map_(GetAllocator()),
+      streaming_(false),
+      next_stream_chunk_id_(1U),
+      streamed_scope_event_count_(0U),
+      stream_zone_states_(GetAllocator()),
+      dropped_stream_chunks_(0U) {
 }
 
 CallTraceManager::CallTraceManager(size_t buffer_size)
@@ -249,11 +555,19 @@ CallTraceManager::CallTraceManager(size_t buffer_size)
       named_trace_recorders_(GetAllocator()),
       recorder_list_(GetAllocator()),
       buffer_size_(buffer_size),
+      timebase_(port::Timer::Clock::now()),
+      time_function_(NULL),
       scope_event_map_(GetAllocator()),
-      reverse_scope_event_map_(GetAllocator()) {
+      reverse_scope_event_map_(GetAllocator()),
+      streaming_(false),
+      next_stream_chunk_id_(1U),
+      streamed_scope_event_count_(0U),
+      stream_zone_states_(GetAllocator()),
+      dropped_stream_chunks_(0U) {
 }
 
 CallTraceManager::~CallTraceManager() {
+  StopStreaming();
   base::LockGuard lock(&mutex_);
 
   if (!timeline_metrics_.empty()) {
@@ -268,15 +582,10 @@ CallTraceManager::~CallTraceManager() {
   }
 }
 
-TraceRecorder* CallTraceManager::GetTraceRecorder() {
-  void* ptr = port::GetThreadLocalStorage(trace_recorder_.GetKey());
-  if (ptr) {
-    return *static_cast<TraceRecorder**>(ptr);
-  } else {
-    TraceRecorder** recorder = trace_recorder_.Get();
-    *recorder = AllocateTraceRecorder();
-    return *recorder;
-  }
+TraceRecorder* CallTraceManager::CreateThreadTraceRecorder() {
+  TraceRecorder** recorder = trace_recorder_.Get();
+  *recorder = AllocateTraceRecorder();
+  return *recorder;
 }
 
 TraceRecorder* CallTraceManager::GetNamedTraceRecorder(
@@ -385,175 +694,15 @@ CallTraceManager::EventArgType CallTraceManager::GetArgType(
 
 std::string CallTraceManager::SnapshotCallTraces() const {
   std::string output;
+  AppendFileHeader(2, &output);
 
-  static const uint32 magic_number = 0xdeadbeef;
-  static const uint32 wtf_version = 0xe8214400;
-  static const uint32 format_version = 10;
-
-  base::AppendBytes(&output, magic_number);
-  base::AppendBytes(&output, wtf_version);
-  base::AppendBytes(&output, format_version);
-
-  // Create the file header
-  Json::Value flags(Json::arrayValue);
-  flags.append("has_high_resolution_times");
-
-  // TODO(user): Add a customized icon for ion. This needs to be a link to
-  // publicly available icon image.
-  Json::Value icon(Json::objectValue);
-  icon["uri"] = "https://maps.gstatic.com/favicon3.ico";
-
-  // TODO(user): Add user agent information, including device, platform,
-  // type, and value information.
-  Json::Value agent(Json::objectValue);
-  agent["device"] = "Ion";
-  agent["platform"] = "SomePlatform";
-  agent["platformVersion"] = "";
-  agent["type"] = "";
-  agent["value"] = "";
-
-  Json::Value context(Json::objectValue);
-  context["args"] = Json::Value(Json::arrayValue);
-  context["contextType"] = "script";
-  context["icon"] = icon;
-  context["taskId"] = "";
-  context["title"] = "Ion";
-  // TODO(user): Add actual URI info to log where the trace was collected.
-  context["userAgent"] = agent;
-
-  Json::Value json;
-  json["type"] = "file_header";
-  json["flags"] = flags;
-  // TODO(user): Add real timebase, units in microseconds.
-  json["timebase"] = 1412611454780.701;
-  json["contextInfo"] = context;
-
-  Json::FastWriter json_writer;
-  std::string json_string = json_writer.write(json);
-  StringTable file_header_table(false);
-  file_header_table.AddString(json_string);
-
-  Chunk file_header;
-  file_header.AddPart(0x10000, &file_header_table);
-  file_header.AppendToString(2, 0x1, &output);
-
-
-  StringTable def_table;
-  def_table.AddString(
-      "wtf.event#define\n"
-      "uint16 wireId, uint16 eventClass, uint32 flags, ascii name, ascii args\n"
-      "wtf.trace#discontinuity\n"
-      "wtf.zone#create\n"
-      "uint16 zoneId, ascii name, ascii type, ascii location\n"
-      "wtf.zone#delete\n"
-      "uint16 zoneId\n"
-      "wtf.zone#set\n"
-      "uint16 zoneId\n"
-      "wtf.scope#enter\n"
-      "ascii name\n"
-      "wtf.scope#enterTracing\n"
-      "wtf.scope#leave\n"
-      "wtf.scope#appendData\n"
-      "ascii name, any value\n"
-      "wtf.trace#mark\n"
-      "ascii name, any value\n"
-      "wtf.trace#timeStamp\n"
-      "ascii name, any value\n"
-      "wtf.timeRange#begin\n"
-      "uint32 id, ascii name, any value\n"
-      "wtf.timeRange#end\n"
-      "uint32 id\n"
-      "wtf.timing#frameStart\n"
-      "uint32 number\n"
-      "wtf.timing#frameEnd\n"
-      "uint32 number\n"
-      "wtf.scope#appendData_url_utf8\n"
-      "utf8 url\n"
-      "wtf.scope#appendData_readyState_int32\n"
-      "int32 readyState");
-
-  // This offset is used to index into strings defining custom scope events.
-  const uint32 event_string_offset = def_table.GetTableSize();
+  std::vector<ScopeEventDefinition> scope_events;
   for (ScopeEventMap::const_iterator it = scope_event_map_.begin();
        it != scope_event_map_.end(); ++it) {
-    def_table.AddString(reinterpret_cast<const char*>(it->first));
-  }
-
-  // Note: these are the built-in WTF events that are being defined below.
-  // wireId (1)    wtf.event#define (uint16 wireId, uint16 eventClass,
-  //                                 uint32 flags, ascii name, ascii args)
-  // wireId (2)    wtf.trace#discontinuity ()
-  // wireId (3)    wtf.zone#create (uint16 zoneId, ascii name, ascii type,
-  //                                ascii location)
-  // wireId (4)    wtf.zone#delete (uint16 zoneId)
-  // wireId (5)    wtf.zone#set (uint16 zoneId)
-  // wireId (6)    wtf.scope#enter (ascii name)
-  // wireId (7)    wtf.scope#enterTracing ()
-  // wireId (8)    wtf.scope#leave ()
-  // wireId (9)    wtf.scope#appendData (ascii name, any value)
-  // wireId (10)   wtf.trace#mark (ascii name, any value)
-  // wireId (11)   wtf.trace#timeStamp (ascii name, any value)
-  // wireId (12)   wtf.timeRange#begin (uint32 id, ascii name, any value)
-  // wireId (13)   wtf.timeRange#end (uint32 id)
-  // wireId (14)   wtf.timing#frameStart (uint32 number)
-  // wireId (15)   wtf.timing#frameEnd (uint32 number)
-  // wireId (16)   wtf.scope#appendData_url_utf8 (utf8 url)
-  // wireId (17)   wtf.scope#appendData_readyState_int32 (int32 readyState)
-
-  EventBuffer def_events;
-  {
-    std::string* event_buffer = &def_events.buffer;
-    uint32 builtin[] = {
-        1, 0, 1, 0, 40, 0, 1,
-        1, 0, 2, 0, 32, 2, 0xffffffff,
-        1, 0, 3, 0, 40, 3, 4,
-        1, 0, 4, 0, 40, 5, 6,
-        1, 0, 5, 0, 40, 7, 8,
-        1, 0, 6, 1, 32, 9, 10,
-        1, 0, 7, 1, 44, 11, 0xffffffff,
-        1, 0, 8, 0, 40, 12, 0xffffffff,
-        1, 0, 9, 0, 56, 13, 14,
-        1, 0, 10, 0, 40, 15, 16,
-        1, 0, 11, 0, 32, 17, 18,
-        1, 0, 12, 0, 40, 19, 20,
-        1, 0, 13, 0, 40, 21, 22,
-        1, 0, 14, 0, 8, 23, 24,
-        1, 0, 15, 0, 8, 25, 26,
-        1, 0, 16, 0, 24, 27, 28,
-        1, 0, 17, 0, 24, 29, 30
-    };
-    base::AppendBytes(event_buffer, builtin);
-
-    // Define each scope event
-    {
-      int event_counter = 0;
-      uint32 temp;
-      for (ScopeEventMap::const_iterator it = scope_event_map_.begin();
-           it != scope_event_map_.end(); ++it) {
-        temp = kDefineEvent;
-        base::AppendBytes(event_buffer, temp);  // wtf.event#define
-        temp = 0;
-        base::AppendBytes(event_buffer, temp);  // timestamp
-        temp = it->second;
-        base::AppendBytes(event_buffer, temp);  // wireId
-        temp = 1;
-        base::AppendBytes(event_buffer, temp);  // eventClass (scope)
-        temp = 0;
-        base::AppendBytes(event_buffer, temp);  // flags (unused)
-        temp = event_string_offset + event_counter;
-        base::AppendBytes(event_buffer, temp);  // name
-        temp = -1;
-        base::AppendBytes(event_buffer, temp);  // args (none)
-        event_counter++;
-      }
-    }
+    scope_events.push_back(ScopeEventDefinition(
+        it->second, reinterpret_cast<const char*>(it->first)));
   }
-
-  Chunk events_defined;
-  events_defined.AddPart(0x30000, &def_table);
-  events_defined.AddPart(0x20002, &def_events);
-  events_defined.AppendToString(3, 0x2, &output);
-
+  AppendEventDefinitions(3, true, scope_events, &output);
 
   const int num_trace_threads = static_cast<int>(recorder_list_.size());
   StringTable table;
@@ -569,36 +718,15 @@ std::string CallTraceManager::SnapshotCallTraces() const {
   {
     std::string* event_buffer = &events.buffer;
     for (int chunk_i = 0; chunk_i < num_trace_threads; ++chunk_i) {
-      const int zone_id = chunk_i + 1;
-      uint32 temp;
-
       // Create a new zone
-      temp = kCreateZoneEvent;
-      base::AppendBytes(event_buffer, temp);
-      temp = 0;
-      base::AppendBytes(event_buffer, temp);  // timestamp
-      temp = zone_id;
-      base::AppendBytes(event_buffer, temp);  // Zone id
-      temp = 2 + chunk_i;
-      base::AppendBytes(event_buffer, temp);  // Zone name
-      temp = 0;
-      base::AppendBytes(event_buffer, temp);  // Zone type
-      temp = 1;
-      base::AppendBytes(event_buffer, temp);  // Zone location
+      AppendCreateZoneEvent(chunk_i + 1, 2 + chunk_i, event_buffer);
     }
 
     for (int chunk_i = 0; chunk_i < num_trace_threads; ++chunk_i) {
       TraceRecorder* rec = recorder_list_[chunk_i];
-      const int zone_id = chunk_i + 1;
-      uint32 temp;
 
       // Set the zone id
-      temp = kSetZoneEvent;
-      base::AppendBytes(event_buffer, temp);
-      temp = 0;
-      base::AppendBytes(event_buffer, temp);  // timestamp
-      temp = zone_id;
-      base::AppendBytes(event_buffer, temp);  // Zone id
+      AppendSetZoneEvent(chunk_i + 1, event_buffer);
 
       // Define each trace event
       rec->DumpTrace(event_buffer, table.GetTableSize());
@@ -631,6 +759,185 @@ void CallTraceManager::WriteFile(const std::string& filename) const {
   }
 }
 
+std::string CallTraceManager::SnapshotChromeTrace() const {
+  static const uint32 kProcessId = 1U;
+  Json::Value events(Json::arrayValue);
+  Json::Value process_name(Json::objectValue);
+  process_name["name"] = "process_name";
+  process_name["ph"] = "M";
+  process_name["pid"] = kProcessId;
+  process_name["args"]["name"] = "Ion";
+  events.append(process_name);
+
+  const uint32 num_trace_threads = static_cast<uint32>(recorder_list_.size());
+  for (uint32 i = 0; i < num_trace_threads; ++i) {
+    const TraceRecorder* rec = recorder_list_[i];
+    // Thread ids only need to be unique within the trace, so use the same ids
+    // as the zones of a WTF snapshot.
+    const uint32 tid = i + 1U;
+    Json::Value thread_name(Json::objectValue);
+    thread_name["name"] = "thread_name";
+    thread_name["ph"] = "M";
+    thread_name["pid"] = kProcessId;
+    thread_name["tid"] = tid;
+    thread_name["args"]["name"] = rec->GetThreadName();
+    events.append(thread_name);
+    rec->AppendChromeTraceEvents(kProcessId, tid, &events);
+  }
+
+  Json::Value json(Json::objectValue);
+  json["traceEvents"] = events;
+  json["displayTimeUnit"] = "ms";
+  Json::FastWriter json_writer;
+  return json_writer.write(json);
+}
+
+void CallTraceManager::WriteChromeTraceFile(
+    const std::string& filename) const {
+  if (!filename.empty()) {
+    LOG(INFO) << "Writing current Chrome traces to: " << filename;
+    std::ofstream filestream(
+        filename.c_str(), std::ios::out | std::ios::binary);
+    if (filestream.good()) {
+      filestream << SnapshotChromeTrace();
+      filestream.close();
+    } else {
+      LOG(WARNING) << "Failed to open " << filename
+                   << " for writing Chrome traces.";
+    }
+  }
+}
+
+bool CallTraceManager::StartStreaming(const StreamFunction& func,
+                                      size_t max_queued_bytes) {
+  DCHECK(func);
+  base::LockGuard lock(&mutex_);
+  if (stream_writer_) {
+    LOG(WARNING) << "WTF traces are already being streamed.";
+    return false;
+  }
+  stream_writer_.reset(new StreamWriter(func, max_queued_bytes));
+  next_stream_chunk_id_ = 1U;
+  streamed_scope_event_count_ = 0U;
+  stream_zone_states_.assign(recorder_list_.size(), 0U);
+
+  // Custom scope events are defined as they show up in the stream.
+  std::string header;
+  AppendFileHeader(next_stream_chunk_id_++, &header);
+  AppendEventDefinitions(next_stream_chunk_id_++, true,
+                         std::vector<ScopeEventDefinition>(), &header);
+  stream_writer_->Write(header, true);
+  streaming_ = true;
+  return true;
+}
+
+bool CallTraceManager::StartStreamingToFile(const std::string& filename,
+                                            size_t max_queued_bytes) {
+  // Check first to avoid truncating the file.
+  if (IsStreaming()) {
+    LOG(WARNING) << "WTF traces are already being streamed.";
+    return false;
+  }
+  std::shared_ptr<std::ofstream> filestream(new std::ofstream(
+      filename.c_str(), std::ios::out | std::ios::binary));
+  if (!filestream->good()) {
+    LOG(WARNING) << "Failed to open " << filename
+                 << " for streaming WTF traces.";
+    return false;
+  }
+  LOG(INFO) << "Streaming WTF traces to: " << filename;
+  return StartStreaming([filestream](const std::string& data) {
+    filestream->write(data.c_str(), data.length());
+    filestream->flush();
+  }, max_queued_bytes);
+}
+
+void CallTraceManager::StopStreaming() {
+  TraceList recorders(GetAllocator());
+  {
+    base::LockGuard lock(&mutex_);
+    if (!stream_writer_)
+      return;
+    recorders = recorder_list_;
+  }
+  for (size_t i = 0; i < recorders.size(); ++i)
+    recorders[i]->FlushToStream();
+
+  std::unique_ptr<StreamWriter> writer;
+  {
+    base::LockGuard lock(&mutex_);
+    streaming_ = false;
+    writer.swap(stream_writer_);
+  }
+  // Destroying the writer waits until all queued data is written.
+  writer.reset();
+}
+
+bool CallTraceManager::StreamTraceRecorder(const TraceRecorder& recorder) {
+  base::LockGuard lock(&mutex_);
+  if (!stream_writer_)
+    return false;
+
+  const size_t index = static_cast<size_t>(
+      std::find(recorder_list_.begin(), recorder_list_.end(), &recorder) -
+      recorder_list_.begin());
+  DCHECK_LT(index, recorder_list_.size());
+  if (index >= stream_zone_states_.size())
+    stream_zone_states_.resize(recorder_list_.size(), 0U);
+  uint8* zone_state = &stream_zone_states_[index];
+  const uint32 zone_id = static_cast<uint32>(index + 1U);
+  uint32 chunk_id = next_stream_chunk_id_;
+
+  // Define the scope events that are new since the last chunk.
+  std::string data;
+  const size_t scope_event_count = GetNumScopeEvents();
+  if (scope_event_count > streamed_scope_event_count_) {
+    std::vector<ScopeEventDefinition> scope_events;
+    for (size_t i = streamed_scope_event_count_; i < scope_event_count; ++i) {
+      const uint32 event_id = static_cast<uint32>(kCustomScopeEvent + i);
+      scope_events.push_back(ScopeEventDefinition(
+          event_id, reverse_scope_event_map_.at(event_id)));
+    }
+    AppendEventDefinitions(chunk_id++, false, scope_events, &data);
+  }
+
+  StringTable table;
+  table.AddString("script");
+  table.AddString("Some_Location");
+  EventBuffer events;
+  {
+    std::string* event_buffer = &events.buffer;
+    if (!(*zone_state & kStreamZoneCreated)) {
+      table.AddString("Thread_" + base::ValueToString(zone_id));
+      AppendCreateZoneEvent(zone_id, 2U, event_buffer);
+    }
+    AppendSetZoneEvent(zone_id, event_buffer);
+    if (*zone_state & kStreamZoneDiscontinuity) {
+      uint32 temp = kDiscontinuityEvent;
+      base::AppendBytes(event_buffer, temp);
+      temp = GetTimeInUs();
+      base::AppendBytes(event_buffer, temp);  // timestamp
+    }
+    recorder.DumpTrace(event_buffer, table.GetTableSize());
+    recorder.DumpStrings(table.GetMutableTable());
+  }
+  Chunk trace;
+  trace.AddPart(0x30000, &table);
+  trace.AddPart(0x20002, &events);
+  trace.AppendToString(chunk_id++, 0x2, &data);
+
+  // Only consider the zone and scope events defined if the chunk was queued.
+  if (stream_writer_->Write(data, false)) {
+    next_stream_chunk_id_ = chunk_id;
+    streamed_scope_event_count_ = scope_event_count;
+    *zone_state = kStreamZoneCreated;
+  } else {
+    *zone_state |= kStreamZoneDiscontinuity;
+    ++dropped_stream_chunks_;
+  }
+  return true;
+}
+
 Timeline CallTraceManager::BuildTimeline() const {
   std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
   for (const auto recorder : recorder_list_) {
@@ -646,8 +953,9 @@ Timeline CallTraceManager::BuildTimeline() const {
 analytics::Benchmark CallTraceManager::RunTimelineMetrics() const {
   analytics::Benchmark benchmark;
   Timeline timeline = BuildTimeline();
+  const TimelineIndex index(timeline);
   for (const auto& metric : timeline_metrics_)
-    metric->Run(timeline, &benchmark);
+    metric->RunOnIndex(index, &benchmark);
   return benchmark;
 }
 
@@ -18,8 +18,11 @@ limitations under the License.
 #ifndef ION_PROFILE_CALLTRACEMANAGER_H_
 #define ION_PROFILE_CALLTRACEMANAGER_H_
 
+#include <atomic>
 #include <chrono>  // NOLINT
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "ion/analytics/benchmark.h"
@@ -29,6 +32,7 @@ limitations under the License.
 #include "ion/base/stlalloc/allocvector.h"
 #include "ion/base/threadlocalobject.h"
 #include "ion/port/mutex.h"
+#include "ion/port/threadutils.h"
 #include "ion/port/timer.h"
 #include "ion/profile/timeline.h"
 #include "ion/profile/timelinemetric.h"
@@ -54,6 +58,8 @@ class CallTraceManager : public base::Allocatable {
   enum BuiltinEventType {
     // The event for defining new WTF events, both custom and built-in events.
     kDefineEvent = 1,
+    // Marks events missing from the trace.
+    kDiscontinuityEvent = 2,
 
     // Events for managing zones.
     kCreateZoneEvent = 3,
@@ -104,6 +110,9 @@ class CallTraceManager : public base::Allocatable {
   // List of TraceRecorders, one created for each thread of execution.
   typedef base::AllocVector<TraceRecorder*> TraceList;
 
+  // Function that receives consecutive pieces of a streamed .wtf-trace.
+  typedef std::function<void(const std::string& data)> StreamFunction;
+
   CallTraceManager();
 
   // Construct using the specified trace capacity in bytes.
@@ -111,8 +120,14 @@ class CallTraceManager : public base::Allocatable {
 
   ~CallTraceManager() override;
 
-  // Gets the TraceRecorder instance specific to the current thread.
-  TraceRecorder* GetTraceRecorder();
+  // Gets the TraceRecorder instance specific to the current thread. This is
+  // inline since every traced scope calls it; only the first call on each
+  // thread creates the recorder.
+  TraceRecorder* GetTraceRecorder() {
+    if (void* ptr = port::GetThreadLocalStorage(trace_recorder_.GetKey()))
+      return *static_cast<TraceRecorder**>(ptr);
+    return CreateThreadTraceRecorder();
+  }
 
   // Gets the TraceRecorder instance specific to the current thread of the
   // given name. These are used for non-CPU-thread tracing such as for GPU
@@ -144,11 +159,15 @@ class CallTraceManager : public base::Allocatable {
 
   // Returns the time in microseconds, relative to the timebase. The timebase
   // is the time when this CallTraceManager instance was created, expressed
-  // in microseconds since the epoch.
-  virtual uint32 GetTimeInUs() const {
+  // in microseconds since the epoch. Every event reads the time, so this reads
+  // the clock inline rather than through a virtual call, unless a time
+  // function has been set.
+  uint32 GetTimeInUs() const {
+    if (time_function_)
+      return time_function_(this);
     return static_cast<uint32>(
-        std::chrono::duration_cast<std::chrono::microseconds>(timer_.Get())
-            .count());
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            port::Timer::Clock::now() - timebase_).count());
   }
 
   // Returns the time in nanoseconds, relative to the timebase. The timebase
@@ -156,14 +175,56 @@ class CallTraceManager : public base::Allocatable {
   // in nanoseconds since the epoch.
   uint64 GetTimeInNs() const {
     return static_cast<uint64>(
-        std::chrono::duration_cast<std::chrono::nanoseconds>(timer_.Get())
-            .count());
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            port::Timer::Clock::now() - timebase_).count());
   }
 
   // Writes the current WTF trace to a file, which usually ends in the
   // extension ".wtf-trace".
   void WriteFile(const std::string& filename) const;
 
+  // Returns a snapshot of traces as a JSON string in the Chrome Trace Event
+  // Format, which chrome://tracing and the Perfetto UI can load. Each
+  // TraceRecorder becomes a thread, named after its thread name.
+  std::string SnapshotChromeTrace() const;
+
+  // Writes the current traces to a file in the Chrome trace event format,
+  // which usually ends in the extension ".json".
+  void WriteChromeTraceFile(const std::string& filename) const;
+
+  // Starts streaming traces to func, which is called on a background thread
+  // with consecutive pieces of a .wtf-trace. Each TraceRecorder sends its
+  // events to the stream whenever its buffer fills up instead of overwriting
+  // the oldest ones, so construct the manager with a small buffer size to
+  // keep memory use low. At most max_queued_bytes of trace data wait to be
+  // passed to func; chunks that do not fit are dropped, and the next events of
+  // the thread that dropped them start with a discontinuity. Returns false if
+  // the manager is already streaming.
+  bool StartStreaming(const StreamFunction& func, size_t max_queued_bytes);
+
+  // Calls StartStreaming() with a function that appends to the named file,
+  // usually ending in ".wtf-trace". Returns false if the file cannot be opened
+  // or the manager is already streaming.
+  bool StartStreamingToFile(const std::string& filename,
+                            size_t max_queued_bytes);
+
+  // Sends the remaining events of all recorders to the stream, then stops
+  // streaming once all queued data has been passed to the stream function. As
+  // with SnapshotCallTraces(), other threads should not be recording traces
+  // while this is called.
+  void StopStreaming();
+
+  // Returns whether StartStreaming() has been called without StopStreaming().
+  bool IsStreaming() const { return streaming_; }
+
+  // Returns the number of chunks dropped because the stream queue was full.
+  size_t GetDroppedStreamChunkCount() const { return dropped_stream_chunks_; }
+
+  // Queues a chunk with the events of recorder for the stream, returning false
+  // if the manager is not streaming. This is called by
+  // TraceRecorder::FlushToStream(), which then empties the recorder.
+  bool StreamTraceRecorder(const TraceRecorder& recorder);
+
   // Convert the current WTF trace into a timeline.
   Timeline BuildTimeline() const;
 
@@ -176,7 +237,19 @@ class CallTraceManager : public base::Allocatable {
   // object containing the collected statistics.
   analytics::Benchmark RunTimelineMetrics() const;
 
+ protected:
+  // A function that returns the time in microseconds for the manager.
+  typedef uint32 (*TimeFunction)(const CallTraceManager* manager);
+
+  // Makes GetTimeInUs() return the result of func instead of reading the
+  // clock, e.g., to provide deterministic timestamps in tests. Passing NULL
+  // restores the clock.
+  void SetTimeFunction(TimeFunction func) { time_function_ = func; }
+
  private:
+  // Passes streamed trace data to a StreamFunction on a background thread.
+  class StreamWriter;
+
   // Array of TraceRecorder pointers that will be stored per thread.
   struct NamedTraceRecorderArray {
     NamedTraceRecorderArray() {
@@ -192,6 +265,10 @@ class CallTraceManager : public base::Allocatable {
   // Allocate a trace recorder and add it to recorder_list_.
   TraceRecorder* AllocateTraceRecorder();
 
+  // Allocates the trace recorder of the current thread, the slow path of
+  // GetTraceRecorder().
+  TraceRecorder* CreateThreadTraceRecorder();
+
   // Protect state with a mutex!
   port::Mutex mutex_;
 
@@ -208,8 +285,12 @@ class CallTraceManager : public base::Allocatable {
   // recorder). If zero, creates recorders with a predefined default capacity.
   size_t buffer_size_;
 
-  // Provides accurate timing.
-  port::Timer timer_;
+  // The time at which the manager was created, which timestamps are relative
+  // to.
+  const port::Timer::Clock::time_point timebase_;
+
+  // Overrides GetTimeInUs() if non-NULL.
+  TimeFunction time_function_;
 
   // Map of custom scope events (literal strings to uint32 ids).
   ScopeEventMap scope_event_map_;
@@ -217,6 +298,17 @@ class CallTraceManager : public base::Allocatable {
   // Reverse map of custom scope events (uint32 ids to literal strings).
   ReverseScopeEventMap reverse_scope_event_map_;
 
+  // Writer for the stream, or NULL if the manager is not streaming.
+  std::unique_ptr<StreamWriter> stream_writer_;
+  std::atomic<bool> streaming_;
+  // The id of the next chunk in the stream.
+  uint32 next_stream_chunk_id_;
+  // The number of custom scope events that have been defined in the stream.
+  size_t streamed_scope_event_count_;
+  // Per-recorder stream state, indexed like recorder_list_.
+  base::AllocVector<uint8> stream_zone_states_;
+  std::atomic<size_t> dropped_stream_chunks_;
+
   // The timeline metrics that have been registerd. These metrics will be run
   // when RunTimelineMetrics gets called.
   std::vector<std::unique_ptr<TimelineMetric>> timeline_metrics_;
@@ -37,11 +37,17 @@
         'calltracemanager.h',
         'profiling.cc',
         'profiling.h',
+        'samplingprofiler.cc',
+        'samplingprofiler.h',
+        'standardmetrics.cc',
+        'standardmetrics.h',
         'timeline.cc',
         'timeline.h',
         'timelineevent.cc',
         'timelineevent.h',
         'timelineframe.h',
+        'timelineindex.cc',
+        'timelineindex.h',
         'timelinemetric.h',
         'timelinenode.cc',
         'timelinenode.h',
@@ -49,6 +55,7 @@
         'timelinescope.h',
         'timelinesearch.h',
         'timelinethread.h',
+        'timelinetimestamp.h',
         'tracerecorder.cc',
         'tracerecorder.h',
         'vsyncprofiler.cc',
@@ -17,6 +17,12 @@ limitations under the License.
 
 #include "ion/profile/profiling.h"
 
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ion/base/spinmutex.h"
 #include "ion/base/staticsafedeclare.h"
 
 namespace ion {
@@ -27,5 +33,29 @@ CallTraceManager* GetCallTraceManager() {
   return manager;
 }
 
+void RecordSpinMutexContention() {
+  const base::SpinMutex::ContentionStatistics stats =
+      base::SpinMutex::GetContentionStatistics();
+  base::SpinMutex::ResetContentionStatistics();
+  std::ostringstream value;
+  value << "{ \"acquisitions\": " << stats.acquisition_count
+        << ", \"spins\": " << stats.spin_count
+        << ", \"waits\": " << stats.wait_count << " }";
+  GetCallTraceManager()->GetTraceRecorder()->CreateTimeStamp(
+      "SpinMutexContention", value.str().c_str());
+}
+
+void RecordStaticInitializations() {
+  const std::vector<std::pair<std::string, uint64_t>> times =
+      base::StaticDeleterDeleter::GetInstance()->GetConstructionTimes();
+  TraceRecorder* recorder = GetCallTraceManager()->GetTraceRecorder();
+  for (size_t i = 0; i < times.size(); ++i) {
+    std::ostringstream value;
+    value << "{ \"type\": \"" << times[i].first << "\", \"index\": " << i
+          << ", \"construction_us\": " << times[i].second << " }";
+    recorder->CreateTimeStamp("StaticInitialization", value.str().c_str());
+  }
+}
+
 }  // namespace profile
 }  // namespace ion
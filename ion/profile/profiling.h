@@ -31,6 +31,19 @@ namespace profile {
 // Get the global, static instance of CallTraceManager.
 ION_API CallTraceManager* GetCallTraceManager();
 
+// Records the base::SpinMutex contention statistics counted since the last
+// call as a time stamp event in the calling thread's trace, then resets them.
+// Statistics must be enabled with
+// base::SpinMutex::EnableContentionStatistics() for the counts to be nonzero.
+ION_API void RecordSpinMutexContention();
+
+// Records the statics constructed with the ION_DECLARE_SAFE_STATIC_* macros so
+// far as time stamp events in the calling thread's trace, one per static in
+// construction order, each with the type name and construction time in
+// microseconds. This shows which singletons are built during startup and what
+// they cost; see base::StaticPrewarmer for moving that cost to another thread.
+ION_API void RecordStaticInitializations();
+
 }  // namespace profile
 }  // namespace ion
 
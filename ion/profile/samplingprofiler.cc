@@ -0,0 +1,340 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/profile/samplingprofiler.h"
+
+#if !ION_PRODUCTION && \
+    (defined(ION_PLATFORM_LINUX) || defined(ION_PLATFORM_MAC))
+#  define ION_SAMPLINGPROFILER_SUPPORTED
+#  include <errno.h>
+#  include <execinfo.h>
+#  include <pthread.h>
+#  include <signal.h>
+#endif
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <sstream>
+
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/profile/tracerecorder.h"
+#include "third_party/jsoncpp/include/json/json.h"
+
+namespace ion {
+namespace profile {
+
+const char SamplingProfiler::kSampleEventName[] = "CpuSample";
+const size_t SamplingProfiler::kMaxStackDepth;
+const size_t SamplingProfiler::kInvalidIndex;
+
+// The samples of a registered thread are kept in a ring buffer written only by
+// the signal handler interrupting the thread and read only by the thread
+// itself, so the counts only need to be atomic.
+struct SamplingProfiler::ThreadSamples {
+  ThreadSamples(CallTraceManager* manager_in, size_t max_depth_in,
+                size_t capacity_in, std::atomic<size_t>* dropped_in)
+      : thread_id(port::GetCurrentThreadId()),
+        manager(manager_in),
+        max_depth(max_depth_in),
+        capacity(capacity_in),
+        addresses(max_depth_in * capacity_in),
+        times(capacity_in),
+        depths(capacity_in),
+        write_count(0U),
+        read_count(0U),
+        dropped(dropped_in) {}
+
+  const port::ThreadId thread_id;
+  CallTraceManager* manager;
+  const size_t max_depth;
+  const size_t capacity;
+  // The addresses, time and depth of each sample.
+  std::vector<void*> addresses;
+  std::vector<uint32> times;
+  std::vector<uint32> depths;
+  // The number of samples written and read since registration.
+  std::atomic<size_t> write_count;
+  std::atomic<size_t> read_count;
+  std::atomic<size_t>* dropped;
+};
+
+namespace {
+
+// The running profiler, since the signal handler is shared by the process.
+static std::atomic<SamplingProfiler*> s_running_profiler(nullptr);
+// The ThreadSamples of the thread being interrupted, which its signal handler
+// takes and sets to NULL, and whether the handler has finished with it.
+static std::atomic<void*> s_target(nullptr);
+static std::atomic<bool> s_captured(false);
+
+// How long to wait for a thread to take a signal, e.g., because it is blocking
+// SIGPROF, before skipping it.
+static const int kSignalTimeoutMs = 10;
+
+#if defined(ION_SAMPLINGPROFILER_SUPPORTED)
+// The frames of the signal handler and the signal trampoline.
+static const int kSkippedFrames = 2;
+
+// The action replaced by the running profiler.
+static struct sigaction s_previous_action;
+#endif
+
+}  // anonymous namespace
+
+SamplingProfiler::SamplingProfiler(CallTraceManager* manager)
+    : manager_(manager),
+      frequency_(100U),
+      max_stack_depth_(32U),
+      buffer_capacity_(256U),
+      dropped_samples_(0U),
+      stopping_(false) {
+  DCHECK(manager_);
+}
+
+SamplingProfiler::~SamplingProfiler() {
+  Stop();
+  DCHECK(threads_.empty());
+}
+
+bool SamplingProfiler::IsSupported() {
+#if defined(ION_SAMPLINGPROFILER_SUPPORTED)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void SamplingProfiler::SetFrequency(uint32 hz) {
+  frequency_ = std::min(std::max(hz, 1U), 1000U);
+}
+
+void SamplingProfiler::SetMaxStackDepth(size_t depth) {
+  max_stack_depth_ = std::min(std::max(depth, size_t{1U}), kMaxStackDepth);
+}
+
+void SamplingProfiler::SetBufferCapacity(size_t sample_count) {
+  buffer_capacity_ = std::max(sample_count, size_t{1U});
+}
+
+bool SamplingProfiler::Start() {
+  if (IsRunning())
+    return true;
+#if defined(ION_SAMPLINGPROFILER_SUPPORTED)
+  SamplingProfiler* expected = nullptr;
+  if (!s_running_profiler.compare_exchange_strong(expected, this)) {
+    LOG(ERROR) << "SamplingProfiler: another profiler is already running";
+    return false;
+  }
+  // The first call to backtrace() may load libraries and allocate, which must
+  // not happen in the signal handler.
+  void* frame;
+  backtrace(&frame, 1);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = &SamplingProfiler::HandleSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, &s_previous_action);
+
+  stopping_ = false;
+  thread_.reset(new base::ThreadSpawner(
+      "SamplingProfiler", std::bind(&SamplingProfiler::ThreadLoop, this)));
+  return true;
+#else
+  LOG(ERROR) << "SamplingProfiler: sampling is not supported on this platform";
+  return false;
+#endif
+}
+
+void SamplingProfiler::Stop() {
+  if (!IsRunning())
+    return;
+  stopping_ = true;
+  stop_sema_.Post();
+  thread_.reset();
+  // Consume the post if the thread stopped without waiting for it.
+  stop_sema_.TryWait();
+#if defined(ION_SAMPLINGPROFILER_SUPPORTED)
+  sigaction(SIGPROF, &s_previous_action, nullptr);
+#endif
+  s_running_profiler = nullptr;
+}
+
+void SamplingProfiler::RegisterCurrentThread() {
+  base::LockGuard lock(&mutex_);
+  if (FindCurrentThread() != kInvalidIndex)
+    return;
+  threads_.push_back(std::unique_ptr<ThreadSamples>(new ThreadSamples(
+      manager_, max_stack_depth_, buffer_capacity_, &dropped_samples_)));
+}
+
+void SamplingProfiler::UnregisterCurrentThread() {
+  std::unique_ptr<ThreadSamples> samples;
+  {
+    base::LockGuard lock(&mutex_);
+    const size_t index = FindCurrentThread();
+    if (index == kInvalidIndex)
+      return;
+    // The thread cannot be sampled once the lock is released.
+    samples = std::move(threads_[index]);
+    threads_.erase(threads_.begin() + index);
+  }
+  RecordSamples(samples.get());
+}
+
+size_t SamplingProfiler::RecordSamples() {
+  ThreadSamples* samples = nullptr;
+  {
+    base::LockGuard lock(&mutex_);
+    const size_t index = FindCurrentThread();
+    if (index != kInvalidIndex)
+      samples = threads_[index].get();
+  }
+  if (!samples) {
+    LOG(ERROR) << "SamplingProfiler: RecordSamples() called on a thread that"
+               << " is not registered";
+    return 0U;
+  }
+  // Only this thread can unregister the buffer, so it remains valid.
+  return RecordSamples(samples);
+}
+
+std::vector<void*> SamplingProfiler::GetSampleAddresses(
+    const std::string& value) {
+  std::vector<void*> addresses;
+  Json::Value root;
+  Json::Reader reader;
+  if (!reader.parse(value, root, false) || !root.isObject() ||
+      !root["stack"].isArray())
+    return addresses;
+  const Json::Value& stack = root["stack"];
+  for (Json::ArrayIndex i = 0; i < stack.size(); ++i) {
+    const std::string address =
+        stack[i].isString() ? stack[i].asString() : std::string();
+    char* end = nullptr;
+    const uint64 bits = std::strtoull(address.c_str(), &end, 16);
+    if (address.compare(0, 2, "0x") != 0 || *end != '\0')
+      return std::vector<void*>();
+    addresses.push_back(
+        reinterpret_cast<void*>(static_cast<uintptr_t>(bits)));
+  }
+  return addresses;
+}
+
+bool SamplingProfiler::ThreadLoop() {
+  while (!stopping_) {
+    {
+      base::LockGuard lock(&mutex_);
+      for (size_t i = 0; i < threads_.size(); ++i)
+        SampleThread(threads_[i].get());
+    }
+    stop_sema_.TimedWaitMs(std::max(1000 / static_cast<int>(frequency_), 1));
+  }
+  return true;
+}
+
+void SamplingProfiler::SampleThread(ThreadSamples* samples) {
+#if defined(ION_SAMPLINGPROFILER_SUPPORTED)
+  s_captured = false;
+  s_target = static_cast<void*>(samples);
+  if (pthread_kill(samples->thread_id, SIGPROF) != 0) {
+    s_target = nullptr;
+    return;
+  }
+  const port::Timer::Clock::time_point deadline =
+      port::Timer::Clock::now() + std::chrono::milliseconds(kSignalTimeoutMs);
+  while (!s_captured) {
+    if (port::Timer::Clock::now() > deadline &&
+        s_target.exchange(nullptr) == static_cast<void*>(samples)) {
+      // The signal was not delivered in time, and now will be ignored.
+      return;
+    }
+    port::YieldThread();
+  }
+#endif
+}
+
+size_t SamplingProfiler::FindCurrentThread() const {
+  const port::ThreadId thread_id = port::GetCurrentThreadId();
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    if (threads_[i]->thread_id == thread_id)
+      return i;
+  }
+  return kInvalidIndex;
+}
+
+size_t SamplingProfiler::RecordSamples(ThreadSamples* samples) {
+  const size_t end = samples->write_count.load(std::memory_order_acquire);
+  const size_t begin = samples->read_count.load(std::memory_order_relaxed);
+  TraceRecorder* recorder = manager_->GetTraceRecorder();
+  for (size_t i = begin; i != end; ++i) {
+    const size_t slot = i % samples->capacity;
+    void* const* addresses = &samples->addresses[slot * samples->max_depth];
+    std::ostringstream value;
+    value << "{\"stack\":[" << std::hex;
+    for (uint32 j = 0; j < samples->depths[slot]; ++j) {
+      value << (j ? ",\"0x" : "\"0x")
+            << reinterpret_cast<uintptr_t>(addresses[j]) << "\"";
+    }
+    value << "]}";
+    recorder->CreateTimeStampAtTime(samples->times[slot], kSampleEventName,
+                                    value.str().c_str());
+  }
+  samples->read_count.store(end, std::memory_order_release);
+  return end - begin;
+}
+
+void SamplingProfiler::HandleSignal(int signal_number) {
+#if defined(ION_SAMPLINGPROFILER_SUPPORTED)
+  // Ignore signals that arrive too late, after another thread became the
+  // target.
+  void* target = s_target.load();
+  ThreadSamples* samples = static_cast<ThreadSamples*>(target);
+  if (!samples || samples->thread_id != port::GetCurrentThreadId() ||
+      !s_target.compare_exchange_strong(target, nullptr))
+    return;
+  const int saved_errno = errno;
+  const size_t write_count =
+      samples->write_count.load(std::memory_order_relaxed);
+  if (write_count - samples->read_count.load(std::memory_order_acquire) >=
+      samples->capacity) {
+    ++*samples->dropped;
+  } else {
+    void* frames[kMaxStackDepth + kSkippedFrames];
+    const int frame_count = backtrace(
+        frames, static_cast<int>(samples->max_depth) + kSkippedFrames);
+    const size_t depth = static_cast<size_t>(
+        std::max(frame_count - kSkippedFrames, 0));
+    const size_t slot = write_count % samples->capacity;
+    std::copy(frames + kSkippedFrames, frames + kSkippedFrames + depth,
+              &samples->addresses[slot * samples->max_depth]);
+    samples->depths[slot] = static_cast<uint32>(depth);
+    samples->times[slot] = samples->manager->GetTimeInUs();
+    samples->write_count.store(write_count + 1U, std::memory_order_release);
+  }
+  errno = saved_errno;
+  s_captured = true;
+#endif
+}
+
+}  // namespace profile
+}  // namespace ion
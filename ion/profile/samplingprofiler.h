@@ -0,0 +1,169 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_PROFILE_SAMPLINGPROFILER_H_
+#define ION_PROFILE_SAMPLINGPROFILER_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/base/threadspawner.h"
+#include "ion/port/mutex.h"
+#include "ion/port/semaphore.h"
+#include "ion/port/threadutils.h"
+#include "ion/profile/calltracemanager.h"
+
+namespace ion {
+namespace profile {
+
+// SamplingProfiler periodically captures the call stacks of registered threads,
+// which makes code without ION_PROFILE_* scopes visible in traces. A background
+// thread interrupts each registered thread in turn with SIGPROF at the
+// configured frequency, and the signal handler copies the raw return addresses
+// of the interrupted stack into a fixed-size buffer belonging to that thread.
+// Nothing is allocated, locked or symbolicated while a thread is interrupted.
+//
+// Since a TraceRecorder must only be written by its own thread, each registered
+// thread moves its pending samples into its TraceRecorder by calling
+// RecordSamples(), e.g., once per frame. Each sample becomes a time stamp event
+// named kSampleEventName whose JSON value holds the addresses of the stack,
+// innermost first, as hexadecimal strings:
+//   {"stack":["0x4005d0","0x400712"]}
+// The samples are therefore exported with the scopes of the same thread, in
+// both .wtf-trace and Chrome trace files, and line up with them in time. They
+// can be symbolicated afterwards in the same process by passing the result of
+// GetSampleAddresses() to a port::StackTrace.
+//
+// The overhead is bounded by the frequency, the maximum stack depth, and the
+// number of samples buffered for each thread between calls to RecordSamples();
+// samples that do not fit are dropped and counted.
+//
+// Sampling is only supported on Linux and Mac in non-production builds, since
+// it relies on signals and backtrace(). Only one SamplingProfiler can run at a
+// time, since the signal handler is shared by the process.
+//
+// Typical usage:
+//   SamplingProfiler sampler(GetCallTraceManager());
+//   sampler.SetFrequency(250);
+//   sampler.Start();
+//   // On each thread to sample:
+//   sampler.RegisterCurrentThread();
+//   while (...) {
+//     ...
+//     sampler.RecordSamples();
+//   }
+//   sampler.UnregisterCurrentThread();
+class ION_API SamplingProfiler {
+ public:
+  // The name of the time stamp events that hold samples.
+  static const char kSampleEventName[];
+
+  explicit SamplingProfiler(CallTraceManager* manager);
+  // Stops sampling. All threads must have been unregistered.
+  ~SamplingProfiler();
+
+  // Returns whether sampling is supported on this platform.
+  static bool IsSupported();
+
+  // Sets the number of times per second that each registered thread is
+  // sampled. The frequency is clamped to [1, 1000], and defaults to 100. It can
+  // be changed while sampling.
+  void SetFrequency(uint32 hz);
+  uint32 GetFrequency() const { return frequency_; }
+
+  // Sets the maximum number of addresses stored for each sample, clamped to
+  // [1, kMaxStackDepth]; deeper stacks lose their outermost frames. Sets the
+  // number of samples buffered for each thread between calls to
+  // RecordSamples(). These only affect threads registered afterwards, and
+  // default to 32 and 256.
+  void SetMaxStackDepth(size_t depth);
+  size_t GetMaxStackDepth() const { return max_stack_depth_; }
+  void SetBufferCapacity(size_t sample_count);
+  size_t GetBufferCapacity() const { return buffer_capacity_; }
+
+  // Starts and stops sampling. Start() returns false and logs an error if
+  // sampling is not supported or another SamplingProfiler is running.
+  bool Start();
+  void Stop();
+  bool IsRunning() const { return thread_.get() != nullptr; }
+
+  // Registers or unregisters the calling thread for sampling. Unregistering
+  // first records the pending samples of the thread.
+  void RegisterCurrentThread();
+  void UnregisterCurrentThread();
+
+  // Moves the pending samples of the calling thread, which must be registered,
+  // into its TraceRecorder and returns how many were recorded.
+  size_t RecordSamples();
+
+  // Returns the total number of samples dropped because the buffer of their
+  // thread was full.
+  size_t GetDroppedSampleCount() const { return dropped_samples_; }
+
+  // Returns the addresses stored in the value of a sample event, or an empty
+  // vector if value is not a valid sample.
+  static std::vector<void*> GetSampleAddresses(const std::string& value);
+
+  // The maximum stack depth of a sample.
+  static const size_t kMaxStackDepth = 128U;
+
+ private:
+  // The sample buffer of a registered thread.
+  struct ThreadSamples;
+
+  // Samples each registered thread at the configured frequency until stopped.
+  bool ThreadLoop();
+  // Interrupts the thread owning samples and waits until its stack has been
+  // captured.
+  void SampleThread(ThreadSamples* samples);
+  // Returns the index of the registered buffer of the calling thread, or
+  // kInvalidIndex.
+  size_t FindCurrentThread() const;
+  // Records the pending samples of samples into the calling thread's
+  // TraceRecorder.
+  size_t RecordSamples(ThreadSamples* samples);
+  // The SIGPROF handler.
+  static void HandleSignal(int signal);
+
+  static const size_t kInvalidIndex = static_cast<size_t>(-1);
+
+  CallTraceManager* manager_;
+  std::atomic<uint32> frequency_;
+  size_t max_stack_depth_;
+  size_t buffer_capacity_;
+  std::atomic<size_t> dropped_samples_;
+
+  // Protects threads_, and is held while a thread is being sampled.
+  port::Mutex mutex_;
+  std::vector<std::unique_ptr<ThreadSamples>> threads_;
+
+  // Signaled to stop sampling early.
+  port::Semaphore stop_sema_;
+  std::atomic<bool> stopping_;
+  std::unique_ptr<base::ThreadSpawner> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(SamplingProfiler);
+};
+
+}  // namespace profile
+}  // namespace ion
+
+#endif  // ION_PROFILE_SAMPLINGPROFILER_H_
@@ -0,0 +1,297 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/profile/standardmetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ion/base/logging.h"
+#include "ion/profile/calltracemanager.h"
+#include "ion/profile/timelinenode.h"
+#include "ion/profile/timelinesearch.h"
+
+namespace ion {
+namespace profile {
+
+namespace {
+
+typedef analytics::Benchmark::Descriptor Descriptor;
+
+// The name of the thread holding the VSyncProfiler's time stamps, as set by
+// CallTraceManager::GetNamedTraceRecorder().
+static const char kVSyncThreadName[] = "VSync";
+
+// Returns the thread node that node belongs to, or NULL if there is none.
+static const TimelineNode* GetThreadOf(const TimelineNode* node) {
+  while (node && node->GetType() != TimelineNode::Type::kThread)
+    node = node->GetParent();
+  return node;
+}
+
+// Returns the nearest-rank percentile of sorted_values, which must not be
+// empty.
+static double GetPercentile(const std::vector<double>& sorted_values,
+                            double percentile) {
+  DCHECK(!sorted_values.empty());
+  const size_t rank = static_cast<size_t>(
+      std::ceil(percentile * 0.01 * static_cast<double>(sorted_values.size())));
+  return sorted_values[std::max(rank, static_cast<size_t>(1U)) - 1U];
+}
+
+// Adds an accumulated variable with the passed values to benchmark.
+static void AddAccumulatedValues(const Descriptor& descriptor,
+                                 const std::vector<double>& values,
+                                 analytics::Benchmark* benchmark) {
+  analytics::Benchmark::VariableAccumulator accumulator(descriptor);
+  for (size_t i = 0; i < values.size(); ++i)
+    accumulator.AddSample(values[i]);
+  benchmark->AddAccumulatedVariable(accumulator.Get());
+}
+
+// Returns the durations of all frames in the indexed timeline, in
+// milliseconds.
+static std::vector<double> GetFrameTimesMs(const TimelineIndex& index) {
+  std::vector<double> frame_times;
+  TimelineSearch frames(index, TimelineNode::Type::kFrame);
+  for (const TimelineNode* frame : frames)
+    frame_times.push_back(frame->GetDurationMs());
+  return frame_times;
+}
+
+}  // anonymous namespace
+
+const uint32 JankMetric::kDefaultVSyncIntervalUs;
+
+void FrameTimeMetric::Run(const Timeline& timeline,
+                          analytics::Benchmark* benchmark) const {
+  RunOnIndex(TimelineIndex(timeline), benchmark);
+}
+
+void FrameTimeMetric::RunOnIndex(const TimelineIndex& index,
+                                 analytics::Benchmark* benchmark) const {
+  DCHECK(benchmark);
+  std::vector<double> frame_times = GetFrameTimesMs(index);
+  if (frame_times.empty())
+    return;
+  static const char kGroup[] = "FrameTimeMetric";
+  AddAccumulatedValues(
+      Descriptor("frame_time", kGroup, "Frame duration", "ms"), frame_times,
+      benchmark);
+
+  std::sort(frame_times.begin(), frame_times.end());
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("frame_time_p50", kGroup, "Median frame duration", "ms"),
+      GetPercentile(frame_times, 50.0)));
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("frame_time_p90", kGroup, "90th percentile frame duration",
+                 "ms"),
+      GetPercentile(frame_times, 90.0)));
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("frame_time_p99", kGroup, "99th percentile frame duration",
+                 "ms"),
+      GetPercentile(frame_times, 99.0)));
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("frame_time_max", kGroup, "Longest frame duration", "ms"),
+      frame_times.back()));
+}
+
+void JankMetric::Run(const Timeline& timeline,
+                     analytics::Benchmark* benchmark) const {
+  RunOnIndex(TimelineIndex(timeline), benchmark);
+}
+
+void JankMetric::RunOnIndex(const TimelineIndex& index,
+                            analytics::Benchmark* benchmark) const {
+  DCHECK(benchmark);
+  TimelineSearch frames(index, TimelineNode::Type::kFrame);
+  if (frames.empty())
+    return;
+
+  // Use the median VSync interval, so that a few late VSync events do not
+  // skew it.
+  std::vector<uint32> intervals;
+  uint32 previous_vsync = 0U;
+  bool has_previous = false;
+  TimelineSearch stamps(index, TimelineNode::Type::kTimeStamp);
+  for (const TimelineNode* stamp : stamps) {
+    const TimelineNode* thread = GetThreadOf(stamp);
+    if (!thread || thread->GetName() != kVSyncThreadName)
+      continue;
+    if (has_previous && stamp->GetBegin() > previous_vsync)
+      intervals.push_back(stamp->GetBegin() - previous_vsync);
+    previous_vsync = stamp->GetBegin();
+    has_previous = true;
+  }
+  uint32 interval = default_vsync_interval_us_;
+  if (!intervals.empty()) {
+    std::nth_element(intervals.begin(),
+                     intervals.begin() + intervals.size() / 2,
+                     intervals.end());
+    interval = intervals[intervals.size() / 2];
+  }
+  DCHECK_GT(interval, 0U);
+
+  size_t frame_count = 0;
+  size_t jank_count = 0;
+  size_t missed_vsyncs = 0;
+  for (const TimelineNode* frame : frames) {
+    ++frame_count;
+    if (frame->GetDuration() > interval) {
+      ++jank_count;
+      // A frame that takes n intervals keeps n - 1 VSyncs from showing a new
+      // frame.
+      missed_vsyncs += (frame->GetDuration() + interval - 1U) / interval - 1U;
+    }
+  }
+
+  static const char kGroup[] = "JankMetric";
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("vsync_interval", kGroup, "Interval between VSync events",
+                 "ms"),
+      interval * 0.001));
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("jank_count", kGroup,
+                 "Frames longer than one VSync interval", "frames"),
+      static_cast<double>(jank_count)));
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("jank_percentage", kGroup,
+                 "Percentage of frames longer than one VSync interval", "%"),
+      100.0 * static_cast<double>(jank_count) /
+          static_cast<double>(frame_count)));
+  benchmark->AddConstant(analytics::Benchmark::Constant(
+      Descriptor("missed_vsyncs", kGroup,
+                 "VSyncs that did not show a new frame", "vsyncs"),
+      static_cast<double>(missed_vsyncs)));
+}
+
+void ScopeTimeMetric::Run(const Timeline& timeline,
+                          analytics::Benchmark* benchmark) const {
+  RunOnIndex(TimelineIndex(timeline), benchmark);
+}
+
+void ScopeTimeMetric::RunOnIndex(const TimelineIndex& index,
+                                 analytics::Benchmark* benchmark) const {
+  DCHECK(benchmark);
+  // Use an ordered map so that the variables are added in a stable order.
+  typedef std::pair<std::vector<double>, std::vector<double>> Times;
+  std::map<std::string, Times> scope_times;
+  TimelineSearch scopes(index, TimelineNode::Type::kScope);
+  for (const TimelineNode* scope : scopes) {
+    uint32 child_time = 0U;
+    for (const auto& child : scope->GetChildren())
+      child_time += child->GetDuration();
+    Times& times = scope_times[scope->GetName()];
+    times.first.push_back(scope->GetDurationMs());
+    // Children of an unterminated scope may outlast it.
+    times.second.push_back(
+        child_time < scope->GetDuration()
+            ? (scope->GetDuration() - child_time) * 0.001 : 0.0);
+  }
+
+  static const char kGroup[] = "ScopeTimeMetric";
+  for (const auto& entry : scope_times) {
+    AddAccumulatedValues(
+        Descriptor(entry.first + ".inclusive", kGroup,
+                   "Duration of " + entry.first + " including nested events",
+                   "ms"),
+        entry.second.first, benchmark);
+    AddAccumulatedValues(
+        Descriptor(entry.first + ".self", kGroup,
+                   "Duration of " + entry.first + " excluding nested events",
+                   "ms"),
+        entry.second.second, benchmark);
+  }
+}
+
+void GpuCpuOverlapMetric::Run(const Timeline& timeline,
+                              analytics::Benchmark* benchmark) const {
+  RunOnIndex(TimelineIndex(timeline), benchmark);
+}
+
+void GpuCpuOverlapMetric::RunOnIndex(const TimelineIndex& index,
+                                     analytics::Benchmark* benchmark) const {
+  DCHECK(benchmark);
+  // GPU work is the top-level scopes of the GPU threads, which do not overlap
+  // since nested ones are children.
+  const std::vector<const TimelineNode*>& threads = index.GetThreads();
+  std::vector<bool> is_gpu_thread(threads.size(), false);
+  bool has_gpu_work = false;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    if (threads[i]->GetName() != gpu_thread_name_)
+      continue;
+    is_gpu_thread[i] = true;
+    for (const auto& child : threads[i]->GetChildren()) {
+      if (child->GetType() == TimelineNode::Type::kScope)
+        has_gpu_work = true;
+    }
+  }
+  if (!has_gpu_work)
+    return;
+
+  std::vector<double> overlaps;
+  TimelineIndex::Indices overlapping;
+  TimelineSearch frames(index, TimelineNode::Type::kFrame);
+  for (const TimelineNode* frame : frames) {
+    const TimelineNode* thread = GetThreadOf(frame);
+    if ((thread && thread->GetName() == gpu_thread_name_) ||
+        frame->GetDuration() == 0U)
+      continue;
+    uint32 busy = 0U;
+    index.FindNodesOverlapping(frame->GetBegin(), frame->GetEnd(),
+                               &overlapping);
+    for (size_t i = 0; i < overlapping.size(); ++i) {
+      const uint32 node = overlapping[i];
+      const uint32 thread_index = index.GetThreadIndex(node);
+      if (thread_index == TimelineIndex::kInvalidIndex ||
+          !is_gpu_thread[thread_index] || index.GetDepth(node) != 1U ||
+          index.GetType(node) != TimelineNode::Type::kScope)
+        continue;
+      const uint32 begin = std::max(index.GetBegin(node), frame->GetBegin());
+      const uint32 end = std::min(index.GetEnd(node), frame->GetEnd());
+      if (end > begin)
+        busy += end - begin;
+    }
+    overlaps.push_back(100.0 * busy / frame->GetDuration());
+  }
+  if (overlaps.empty())
+    return;
+  AddAccumulatedValues(
+      Descriptor("gpu_frame_overlap", "GpuCpuOverlapMetric",
+                 "Percentage of each CPU frame during which the GPU was busy",
+                 "%"),
+      overlaps, benchmark);
+}
+
+void RegisterStandardTimelineMetrics(CallTraceManager* manager) {
+  DCHECK(manager);
+  manager->RegisterTimelineMetric(
+      std::unique_ptr<TimelineMetric>(new FrameTimeMetric));
+  manager->RegisterTimelineMetric(
+      std::unique_ptr<TimelineMetric>(new JankMetric));
+  manager->RegisterTimelineMetric(
+      std::unique_ptr<TimelineMetric>(new ScopeTimeMetric));
+  manager->RegisterTimelineMetric(
+      std::unique_ptr<TimelineMetric>(new GpuCpuOverlapMetric));
+}
+
+}  // namespace profile
+}  // namespace ion
@@ -0,0 +1,106 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_PROFILE_STANDARDMETRICS_H_
+#define ION_PROFILE_STANDARDMETRICS_H_
+
+#include <string>
+
+#include "base/integral_types.h"
+#include "ion/analytics/benchmark.h"
+#include "ion/profile/timeline.h"
+#include "ion/profile/timelineindex.h"
+#include "ion/profile/timelinemetric.h"
+
+namespace ion {
+namespace profile {
+
+class CallTraceManager;
+
+// This file contains the timeline metrics that ship with Ion. Each adds its
+// results to the Benchmark in the group named after the metric, so that perf
+// tests can compare them across runs. Times are reported in milliseconds.
+// Their searches use a TimelineIndex; Run() builds one for the timeline.
+
+// Reports the distribution of frame durations: the frame time as an
+// accumulated variable, and its 50th, 90th and 99th percentiles and maximum as
+// constants. Frames on all threads are included.
+class FrameTimeMetric : public TimelineMetric {
+ public:
+  void Run(const Timeline& timeline,
+           analytics::Benchmark* benchmark) const override;
+  void RunOnIndex(const TimelineIndex& index,
+                  analytics::Benchmark* benchmark) const override;
+};
+
+// Counts janky frames, i.e., frames that take longer than one VSync interval.
+// The interval is the median time between the time stamps recorded by the
+// VSyncProfiler, or default_vsync_interval_us if fewer than two were recorded.
+class JankMetric : public TimelineMetric {
+ public:
+  // The interval of a 60 Hz display.
+  static const uint32 kDefaultVSyncIntervalUs = 16667U;
+
+  JankMetric() : default_vsync_interval_us_(kDefaultVSyncIntervalUs) {}
+  explicit JankMetric(uint32 default_vsync_interval_us)
+      : default_vsync_interval_us_(default_vsync_interval_us) {}
+
+  void Run(const Timeline& timeline,
+           analytics::Benchmark* benchmark) const override;
+  void RunOnIndex(const TimelineIndex& index,
+                  analytics::Benchmark* benchmark) const override;
+
+ private:
+  const uint32 default_vsync_interval_us_;
+};
+
+// Reports the inclusive and self time of each scope name as accumulated
+// variables with ids "<name>.inclusive" and "<name>.self". The self time of a
+// scope excludes the time spent in its child events.
+class ScopeTimeMetric : public TimelineMetric {
+ public:
+  void Run(const Timeline& timeline,
+           analytics::Benchmark* benchmark) const override;
+  void RunOnIndex(const TimelineIndex& index,
+                  analytics::Benchmark* benchmark) const override;
+};
+
+// Reports how much of each CPU frame the GPU was busy for, as a percentage of
+// the frame's duration. GPU work is the top-level scopes recorded by the
+// GpuProfiler on the thread named gpu_thread_name.
+class GpuCpuOverlapMetric : public TimelineMetric {
+ public:
+  GpuCpuOverlapMetric() : gpu_thread_name_("GPU") {}
+  explicit GpuCpuOverlapMetric(const std::string& gpu_thread_name)
+      : gpu_thread_name_(gpu_thread_name) {}
+
+  void Run(const Timeline& timeline,
+           analytics::Benchmark* benchmark) const override;
+  void RunOnIndex(const TimelineIndex& index,
+                  analytics::Benchmark* benchmark) const override;
+
+ private:
+  const std::string gpu_thread_name_;
+};
+
+// Registers an instance of each of the above metrics with manager.
+ION_API void RegisterStandardTimelineMetrics(CallTraceManager* manager);
+
+}  // namespace profile
+}  // namespace ion
+
+#endif  // ION_PROFILE_STANDARDMETRICS_H_
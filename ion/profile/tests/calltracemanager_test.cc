@@ -17,14 +17,18 @@ limitations under the License.
 
 #include "ion/profile/calltracemanager.h"
 
+#include <algorithm>
+#include <chrono>  // NOLINT
 #include <fstream>  // NOLINT
 #include <functional>
 #include <limits>
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "ion/analytics/benchmark.h"
+#include "ion/base/logchecker.h"
 #include "ion/base/serialize.h"
 #include "ion/base/stringutils.h"
 #include "ion/base/threadspawner.h"
@@ -33,6 +37,7 @@ limitations under the License.
 #include "ion/gfxprofile/gpuprofiler.h"
 #include "ion/port/atomic.h"
 #include "ion/port/fileutils.h"
+#include "ion/port/semaphore.h"
 #include "ion/port/threadutils.h"
 #include "ion/port/timer.h"
 #include "ion/profile/timeline.h"
@@ -304,7 +309,11 @@ std::ostream& operator<<(std::ostream& os, const Chunk& chunk) {
 class TraceReader {
  public:
   explicit TraceReader(const std::string& data)
-      : data_source_(data), read_offset_(0) {}
+      : data_source_(data), read_offset_(0), streamed_(false) {}
+
+  // A streamed trace has any number of chunks, and scopes may span chunks.
+  TraceReader(const std::string& data, bool streamed)
+      : data_source_(data), read_offset_(0), streamed_(streamed) {}
 
   // The main function for performing the binary trace file parsing.
   void Parse() {
@@ -328,6 +337,7 @@ class TraceReader {
 
     // Read each chunk one by one.
     ChunkHeader chunk_header;
+    int stream_nesting_count = 0;
     while (ReadPossible()) {
       Read(&chunk_header, sizeof(chunk_header));
       size_t data_offset = sizeof(chunk_header);
@@ -426,7 +436,9 @@ class TraceReader {
           uint32 event_byte_offset = 0;
           uint32 wire_id;
           uint32 time_value;
-          int scope_nesting_count = 0;
+          int chunk_nesting_count = 0;
+          int& scope_nesting_count =
+              streamed_ ? stream_nesting_count : chunk_nesting_count;
 
           do {
             wire_id = *reinterpret_cast<uint32*>(&data[event_byte_offset + 0]);
@@ -469,7 +481,7 @@ class TraceReader {
           } while (event_byte_offset < data.size());
 
           // Check that the scope nesting has been terminated.
-          EXPECT_EQ(0, scope_nesting_count);
+          EXPECT_EQ(0, chunk_nesting_count);
 
           parts.push_back(eb);
         }
@@ -486,6 +498,10 @@ class TraceReader {
       chunks_.push_back(new_chunk);
     }
 
+    if (streamed_) {
+      EXPECT_EQ(0, stream_nesting_count);
+      return;
+    }
     // In the current file format there should be exactly three chunks, one for
     // the file header, one for defining the events, and lastly for the event
     // buffer.
@@ -502,6 +518,29 @@ class TraceReader {
     return static_cast<const EventBuffer&>(*chunks_.back().parts.back()).events;
   }
 
+  // Returns the events of all chunks, except for event definitions.
+  const std::vector<Event> GetAllEvents() {
+    if (chunks_.empty()) {
+      Parse();
+    }
+    std::vector<Event> events;
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+      for (size_t j = 0; j < chunks_[i].parts.size(); ++j) {
+        if (chunks_[i].parts[j]->header.type != 0x20002) {
+          continue;
+        }
+        const EventBuffer& eb =
+            static_cast<const EventBuffer&>(*chunks_[i].parts[j]);
+        for (size_t k = 0; k < eb.events.size(); ++k) {
+          if (eb.events[k].name != "wtf.event#define") {
+            events.push_back(eb.events[k]);
+          }
+        }
+      }
+    }
+    return events;
+  }
+
   const std::vector<Chunk>& GetChunks() const { return chunks_; }
 
  private:
@@ -535,6 +574,8 @@ class TraceReader {
   size_t read_offset_;
   // Parsed data stored as chunks.
   std::vector<Chunk> chunks_;
+  // Whether the trace was streamed.
+  const bool streamed_;
 };
 
 // Utility function to print out a human-readable version of the trace.
@@ -547,8 +588,12 @@ std::ostream& operator<<(std::ostream& os, const TraceReader& trace) {
 
 class CallTraceManagerWithMockTimer : public CallTraceManager {
  public:
-  CallTraceManagerWithMockTimer() : time_in_us_(0U) {}
-  uint32 GetTimeInUs() const override { return time_in_us_.load(); }
+  CallTraceManagerWithMockTimer() : time_in_us_(0U) {
+    SetTimeFunction([](const CallTraceManager* manager) {
+      return static_cast<const CallTraceManagerWithMockTimer*>(manager)
+          ->time_in_us_.load();
+    });
+  }
   void AdvanceTimer(const uint32 microseconds) { time_in_us_ += microseconds; }
 
  private:
@@ -713,6 +758,23 @@ static void CheckTimelineThread(
   }
 }
 
+TEST_F(CallTraceTest, RealTimer) {
+  // Without a time function, the manager reads the clock.
+  CallTraceManager manager;
+  const uint32 begin_us = manager.GetTimeInUs();
+  const uint64 begin_ns = manager.GetTimeInNs();
+  port::Timer::SleepNMilliseconds(2U);
+  EXPECT_LE(begin_us + 2000U, manager.GetTimeInUs());
+  EXPECT_LE(begin_ns + 2000000U, manager.GetTimeInNs());
+
+  // The mock timer only moves when advanced.
+  const uint32 mock_us = call_trace_manager_->GetTimeInUs();
+  port::Timer::SleepNMilliseconds(2U);
+  EXPECT_EQ(mock_us, call_trace_manager_->GetTimeInUs());
+  call_trace_manager_->AdvanceTimer(10U);
+  EXPECT_EQ(mock_us + 10U, call_trace_manager_->GetTimeInUs());
+}
+
 TEST_F(CallTraceTest, DefaultBufferSize) {
   size_t initial_default = TraceRecorder::GetDefaultBufferSize();
   EXPECT_NE(555U, initial_default);
@@ -766,6 +828,68 @@ TEST_F(CallTraceTest, BasicGpuRecordEnabled) {
   EXPECT_EQ(4U, GetGpuTraceRecorder()->GetNumTraces());
 }
 
+TEST_F(CallTraceTest, AddNodeGpuTimes) {
+  gfx::Renderer::NodeGpuTimes times;
+  times.frame = 1U;
+  const char* kPaths[] = { "map", "map/roads", "map/labels", "overlay" };
+  const size_t kDepths[] = { 0U, 1U, 1U, 0U };
+  for (size_t i = 0; i < arraysize(kPaths); ++i) {
+    gfx::Renderer::NodeGpuTimes::Scope scope;
+    scope.path = kPaths[i];
+    scope.depth = kDepths[i];
+    scope.begin_ns = 1000U * i;
+    scope.end_ns = 1000U * i + 500U;
+    times.scopes.push_back(scope);
+  }
+
+  // Nothing is added unless GPU tracing is enabled.
+  EXPECT_TRUE(AllowGpuTracing());
+  GetGpuProfiler()->AddNodeGpuTimes(times);
+  EXPECT_EQ(0U, GetGpuTraceRecorder()->GetNumTraces());
+
+  // Each scope is entered, annotated with its path, and left.
+  EnableGpuTracing();
+  GetGpuProfiler()->AddNodeGpuTimes(times);
+  EXPECT_EQ(12U, GetGpuTraceRecorder()->GetNumTraces());
+  EXPECT_EQ(1U, GetNumScopeEvents());
+  std::vector<std::string> strings;
+  GetGpuTraceRecorder()->DumpStrings(&strings);
+  EXPECT_NE(strings.end(),
+            std::find(strings.begin(), strings.end(), "\"map/labels\""));
+}
+
+TEST_F(CallTraceTest, AddNodeCpuTimes) {
+  gfx::Renderer::NodeCpuTimes times;
+  times.frame = 1U;
+  const char* kPaths[] = { "map", "map/roads", "map/labels", "overlay" };
+  const size_t kDepths[] = { 0U, 1U, 1U, 0U };
+  const uint64 now_ns = static_cast<uint64>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          port::Timer::Clock::now().time_since_epoch()).count());
+  for (size_t i = 0; i < arraysize(kPaths); ++i) {
+    gfx::Renderer::NodeCpuTimes::Scope scope;
+    scope.path = kPaths[i];
+    scope.depth = kDepths[i];
+    scope.begin_ns = now_ns + 1000U * i;
+    scope.end_ns = now_ns + 1000U * i + 500U;
+    scope.counts.draws = i + 1U;
+    times.scopes.push_back(scope);
+  }
+
+  // Each scope is entered, annotated with its path and counts, and left on
+  // the calling thread, without GPU tracing.
+  GetGpuProfiler()->AddNodeCpuTimes(times);
+  EXPECT_EQ(28U, GetTraceRecorder()->GetNumTraces());
+  EXPECT_EQ(0U, GetGpuTraceRecorder()->GetNumTraces());
+  EXPECT_EQ(1U, GetNumScopeEvents());
+  std::vector<std::string> strings;
+  GetTraceRecorder()->DumpStrings(&strings);
+  EXPECT_NE(strings.end(),
+            std::find(strings.begin(), strings.end(), "\"map/labels\""));
+  EXPECT_NE(strings.end(),
+            std::find(strings.begin(), strings.end(), "resource_updates"));
+}
+
 TEST_F(CallTraceTest, BasicGpuRecordDisallowed) {
   EnableGpuTracing();
   {
@@ -1609,6 +1733,140 @@ TEST_F(CallTraceTest, WriteFile) {
 
 #endif  // !defined(ION_PLATFORM_NACL) && !defined(ION_PLATFORM_IOS)
 
+#if !defined(ION_PLATFORM_ASMJS)  // ASMJS does not support threads.
+TEST_F(CallTraceTest, StreamTraces) {
+  // Use a buffer that fills up several times.
+  const size_t initial_default = TraceRecorder::GetDefaultBufferSize();
+  TraceRecorder::SetDefaultBufferSize(256U);
+  CallTraceManagerWithMockTimer manager;
+  TraceRecorder* recorder = manager.GetTraceRecorder();
+  TraceRecorder::SetDefaultBufferSize(initial_default);
+
+  std::string output;
+  EXPECT_FALSE(manager.IsStreaming());
+  EXPECT_TRUE(manager.StartStreaming(
+      [&output](const std::string& data) { output += data; }, 1024U * 1024U));
+  EXPECT_TRUE(manager.IsStreaming());
+  {
+    base::LogChecker log_checker;
+    EXPECT_FALSE(manager.StartStreaming(
+        [](const std::string& data) {}, 1024U * 1024U));
+    EXPECT_TRUE(log_checker.HasMessage("WARNING", "already being streamed"));
+  }
+
+  const uint32 kNumIterations = 100;
+  for (uint32 i = 0; i < kNumIterations; ++i) {
+    manager.AdvanceTimer(2000U);
+    ScopedTracer scope(recorder, manager.GetScopeEnterEvent("Outer scope"));
+    manager.AdvanceTimer(1000U);
+    // Define a new event part way through the stream.
+    if (i >= kNumIterations / 2) {
+      ScopedTracer inner(recorder, manager.GetScopeEnterEvent("Inner scope"));
+      manager.AdvanceTimer(1000U);
+    }
+  }
+  // Nothing was overwritten, and only what has not been streamed yet is
+  // still in the buffer.
+  EXPECT_LT(recorder->GetNumTraces(), 64U);
+  manager.StopStreaming();
+  EXPECT_FALSE(manager.IsStreaming());
+  EXPECT_EQ(0U, manager.GetDroppedStreamChunkCount());
+
+  TraceReader reader(output, true);
+  const std::vector<Event> events = reader.GetAllEvents();
+  EXPECT_LT(3U, reader.GetChunks().size());
+  size_t outer_count = 0;
+  size_t inner_count = 0;
+  size_t zone_create_count = 0;
+  uint32 last_outer_time = 0;
+  for (size_t i = 0; i < events.size(); ++i) {
+    if (events[i].name == "Outer scope") {
+      // Events stay in order across chunks.
+      if (outer_count) {
+        EXPECT_LT(last_outer_time, events[i].time_value);
+      }
+      last_outer_time = events[i].time_value;
+      ++outer_count;
+    } else if (events[i].name == "Inner scope") {
+      ++inner_count;
+    } else if (events[i].name == "wtf.zone#create") {
+      ++zone_create_count;
+    }
+  }
+  EXPECT_EQ(kNumIterations, outer_count);
+  EXPECT_EQ(kNumIterations / 2, inner_count);
+  EXPECT_EQ(1U, zone_create_count);
+}
+
+TEST_F(CallTraceTest, StreamTracesDropsChunks) {
+  const size_t initial_default = TraceRecorder::GetDefaultBufferSize();
+  TraceRecorder::SetDefaultBufferSize(256U);
+  CallTraceManagerWithMockTimer manager;
+  TraceRecorder* recorder = manager.GetTraceRecorder();
+  TraceRecorder::SetDefaultBufferSize(initial_default);
+
+  // Block the stream until everything has been recorded, so that only a few
+  // chunks fit in the queue.
+  port::Semaphore release;
+  std::string output;
+  EXPECT_TRUE(manager.StartStreaming([&output, &release](
+      const std::string& data) {
+    release.Wait();
+    release.Post();
+    output += data;
+  }, 1024U));
+  for (uint32 i = 0; i < 1000U; ++i) {
+    manager.AdvanceTimer(1000U);
+    ScopedTracer scope(recorder, manager.GetScopeEnterEvent("Scope"));
+  }
+  EXPECT_LT(0U, manager.GetDroppedStreamChunkCount());
+  release.Post();
+  manager.StopStreaming();
+
+  // The stream still starts with the WTF header.
+  ASSERT_LE(12U, output.length());
+  uint32 magic_number;
+  memcpy(&magic_number, output.data(), sizeof(magic_number));
+  EXPECT_EQ(0xdeadbeef, magic_number);
+}
+
+#if !defined(ION_PLATFORM_NACL) && !defined(ION_PLATFORM_IOS)
+TEST_F(CallTraceTest, StreamTracesToFile) {
+  const size_t initial_default = TraceRecorder::GetDefaultBufferSize();
+  TraceRecorder::SetDefaultBufferSize(256U);
+  CallTraceManagerWithMockTimer manager;
+  TraceRecorder* recorder = manager.GetTraceRecorder();
+  TraceRecorder::SetDefaultBufferSize(initial_default);
+
+  const std::string output_file = port::GetTemporaryFilename();
+  EXPECT_TRUE(manager.StartStreamingToFile(output_file, 1024U * 1024U));
+  for (uint32 i = 0; i < 50U; ++i) {
+    manager.AdvanceTimer(1000U);
+    ScopedTracer scope(recorder, manager.GetScopeEnterEvent("File scope"));
+  }
+  manager.StopStreaming();
+
+  std::string output;
+  EXPECT_TRUE(port::ReadDataFromFile(output_file, &output));
+  port::RemoveFile(output_file);
+  TraceReader reader(output, true);
+  const std::vector<Event> events = reader.GetAllEvents();
+  size_t scope_count = 0;
+  for (size_t i = 0; i < events.size(); ++i) {
+    if (events[i].name == "File scope")
+      ++scope_count;
+  }
+  EXPECT_EQ(50U, scope_count);
+
+  // A file that cannot be opened is an error.
+  base::LogChecker log_checker;
+  EXPECT_FALSE(manager.StartStreamingToFile("/no/such/dir/trace", 1024U));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "Failed to open"));
+  EXPECT_FALSE(manager.IsStreaming());
+}
+#endif  // !defined(ION_PLATFORM_NACL) && !defined(ION_PLATFORM_IOS)
+#endif  // !defined(ION_PLATFORM_ASMJS)
+
 TEST_F(CallTraceTest, RunTimelineMetrics) {
   call_trace_manager_->RegisterTimelineMetric(
       std::unique_ptr<TimelineMetric>(new FakeTimelineMetric("metric_a", 1.0)));
@@ -1839,5 +2097,110 @@ TEST_F(CallTraceTest, VSyncProfilerTest) {
   }
 }
 
+TEST_F(CallTraceTest, TimelineTimeStamps) {
+  VSyncProfiler vsync_profiler(call_trace_manager_.get());
+  vsync_profiler.RecordVSyncEvent(1000U, 0U);
+  vsync_profiler.RecordVSyncEvent(17000U, 1U);
+  call_trace_manager_->AdvanceTimer(2000U);
+  {
+    ScopedTracer scope(GetTraceRecorder(),
+                       call_trace_manager_->GetScopeEnterEvent("Scope"));
+    call_trace_manager_->AdvanceTimer(1000U);
+    GetTraceRecorder()->CreateTimeStamp("Marker", "{\"id\":5}");
+    call_trace_manager_->AdvanceTimer(1000U);
+  }
+
+  Timeline timeline = call_trace_manager_->BuildTimeline();
+  TimelineSearch stamps(timeline, TimelineNode::Type::kTimeStamp);
+  std::vector<const TimelineNode*> nodes;
+  for (const TimelineNode* node : stamps)
+    nodes.push_back(node);
+  ASSERT_EQ(3U, nodes.size());
+  EXPECT_EQ("VSync0", nodes[0]->GetName());
+  EXPECT_EQ(1000U, nodes[0]->GetBegin());
+  EXPECT_EQ(0U, nodes[0]->GetDuration());
+  EXPECT_EQ("VSync1", nodes[1]->GetName());
+  EXPECT_EQ(17000U, nodes[1]->GetBegin());
+  // Time stamps are children of the enclosing scope.
+  EXPECT_EQ("Marker", nodes[2]->GetName());
+  EXPECT_EQ(3000U, nodes[2]->GetBegin());
+  EXPECT_EQ("Scope", nodes[2]->GetParent()->GetName());
+  EXPECT_EQ(5, static_cast<const TimelineEvent*>(nodes[2])
+                   ->GetArgs()["id"].asInt());
+  // The scope still ends after the time stamp.
+  EXPECT_EQ(4000U, nodes[2]->GetParent()->GetEnd());
+}
+
+TEST_F(CallTraceTest, SnapshotChromeTrace) {
+  TraceRecorder* recorder = GetTraceRecorder();
+  recorder->SetThreadName("Main");
+  call_trace_manager_->AdvanceTimer(1000U);
+  recorder->EnterFrame(7U);
+  {
+    ScopedTracer scope(recorder,
+                       call_trace_manager_->GetScopeEnterEvent("Draw"));
+    recorder->AnnotateCurrentScope("count", "3");
+    recorder->AnnotateCurrentScope("label", "not json");
+    call_trace_manager_->AdvanceTimer(500U);
+    recorder->EnterTimeRange(42U, "Upload", "{\"bytes\":16}");
+    call_trace_manager_->AdvanceTimer(500U);
+  }
+  recorder->LeaveTimeRange(42U);
+  recorder->LeaveFrame();
+  VSyncProfiler vsync_profiler(call_trace_manager_.get());
+  vsync_profiler.RecordVSyncEvent(4000U, 0U);
+
+  Json::Value json;
+  Json::Reader json_reader;
+  ASSERT_TRUE(json_reader.parse(call_trace_manager_->SnapshotChromeTrace(),
+                                json));
+  EXPECT_EQ("ms", json["displayTimeUnit"].asString());
+  const Json::Value& events = json["traceEvents"];
+  // The process name, then each thread's name and events.
+  ASSERT_EQ(10U, events.size());
+  EXPECT_EQ("process_name", events[0]["name"].asString());
+  EXPECT_EQ("M", events[0]["ph"].asString());
+  EXPECT_EQ("Ion", events[0]["args"]["name"].asString());
+
+  EXPECT_EQ("thread_name", events[1]["name"].asString());
+  EXPECT_EQ("Main", events[1]["args"]["name"].asString());
+  EXPECT_EQ(1U, events[1]["tid"].asUInt());
+
+  EXPECT_EQ("Frame_7", events[2]["name"].asString());
+  EXPECT_EQ("B", events[2]["ph"].asString());
+  EXPECT_EQ(1000U, events[2]["ts"].asUInt());
+  EXPECT_EQ(7U, events[2]["args"]["frame_number"].asUInt());
+
+  EXPECT_EQ("Draw", events[3]["name"].asString());
+  EXPECT_EQ("B", events[3]["ph"].asString());
+  EXPECT_EQ(1U, events[3]["pid"].asUInt());
+  EXPECT_EQ(1U, events[3]["tid"].asUInt());
+  // Annotations are added to the scope's args.
+  EXPECT_EQ(3, events[3]["args"]["count"].asInt());
+  EXPECT_EQ("not json", events[3]["args"]["label"].asString());
+
+  EXPECT_EQ("Upload", events[4]["name"].asString());
+  EXPECT_EQ("b", events[4]["ph"].asString());
+  EXPECT_EQ(42U, events[4]["id"].asUInt());
+  EXPECT_EQ(1500U, events[4]["ts"].asUInt());
+  EXPECT_EQ(16, events[4]["args"]["bytes"].asInt());
+
+  EXPECT_EQ("E", events[5]["ph"].asString());
+  EXPECT_EQ(2000U, events[5]["ts"].asUInt());
+  // Time ranges need not nest within scopes.
+  EXPECT_EQ("Upload", events[6]["name"].asString());
+  EXPECT_EQ("e", events[6]["ph"].asString());
+  EXPECT_EQ(42U, events[6]["id"].asUInt());
+  EXPECT_EQ("E", events[7]["ph"].asString());
+
+  // VSync events have their own thread.
+  EXPECT_EQ("thread_name", events[8]["name"].asString());
+  EXPECT_EQ(2U, events[8]["tid"].asUInt());
+  EXPECT_EQ("VSync0", events[9]["name"].asString());
+  EXPECT_EQ("i", events[9]["ph"].asString());
+  EXPECT_EQ(4000U, events[9]["ts"].asUInt());
+  EXPECT_EQ(2U, events[9]["tid"].asUInt());
+}
+
 }  // namespace profile
 }  // namespace ion
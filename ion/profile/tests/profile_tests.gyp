@@ -24,6 +24,9 @@
       'includes': [ '../../dev/test_target.gypi' ],
       'sources' : [
         'calltracemanager_test.cc',
+        'samplingprofiler_test.cc',
+        'standardmetrics_test.cc',
+        'timelineindex_test.cc',
         'timelinesearch_test.cc',
         'timeline_test.cc',
       ],
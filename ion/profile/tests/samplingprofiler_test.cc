@@ -0,0 +1,180 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/profile/samplingprofiler.h"
+
+#include <chrono>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "ion/base/logchecker.h"
+#include "ion/port/stacktrace.h"
+#include "ion/profile/calltracemanager.h"
+#include "ion/profile/timeline.h"
+#include "ion/profile/timelinesearch.h"
+#include "ion/profile/timelinetimestamp.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+#include "third_party/jsoncpp/include/json/json.h"
+
+namespace ion {
+namespace profile {
+
+namespace {
+
+// Keeps the CPU busy for the passed number of milliseconds, recording the
+// samples taken meanwhile.
+static size_t BusyLoop(SamplingProfiler* profiler, int ms) {
+  const auto end =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+  size_t count = 0;
+  volatile double sum = 0.0;
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 0; i < 10000; ++i)
+      sum = sum + i * 0.5;
+    count += profiler->RecordSamples();
+  }
+  return count;
+}
+
+}  // anonymous namespace
+
+TEST(SamplingProfiler, Settings) {
+  CallTraceManager manager;
+  SamplingProfiler profiler(&manager);
+  EXPECT_EQ(100U, profiler.GetFrequency());
+  EXPECT_EQ(32U, profiler.GetMaxStackDepth());
+  EXPECT_EQ(256U, profiler.GetBufferCapacity());
+  EXPECT_FALSE(profiler.IsRunning());
+
+  profiler.SetFrequency(0U);
+  EXPECT_EQ(1U, profiler.GetFrequency());
+  profiler.SetFrequency(5000U);
+  EXPECT_EQ(1000U, profiler.GetFrequency());
+  profiler.SetFrequency(250U);
+  EXPECT_EQ(250U, profiler.GetFrequency());
+
+  profiler.SetMaxStackDepth(0U);
+  EXPECT_EQ(1U, profiler.GetMaxStackDepth());
+  profiler.SetMaxStackDepth(1000U);
+  EXPECT_EQ(SamplingProfiler::kMaxStackDepth, profiler.GetMaxStackDepth());
+  profiler.SetBufferCapacity(0U);
+  EXPECT_EQ(1U, profiler.GetBufferCapacity());
+  profiler.SetBufferCapacity(16U);
+  EXPECT_EQ(16U, profiler.GetBufferCapacity());
+}
+
+TEST(SamplingProfiler, GetSampleAddresses) {
+  std::vector<void*> addresses =
+      SamplingProfiler::GetSampleAddresses("{\"stack\":[\"0x10\",\"0xff0\"]}");
+  ASSERT_EQ(2U, addresses.size());
+  EXPECT_EQ(reinterpret_cast<void*>(0x10), addresses[0]);
+  EXPECT_EQ(reinterpret_cast<void*>(0xff0), addresses[1]);
+
+  EXPECT_TRUE(SamplingProfiler::GetSampleAddresses("{\"stack\":[]}").empty());
+  EXPECT_TRUE(SamplingProfiler::GetSampleAddresses("").empty());
+  EXPECT_TRUE(SamplingProfiler::GetSampleAddresses("[\"0x10\"]").empty());
+  EXPECT_TRUE(
+      SamplingProfiler::GetSampleAddresses("{\"stack\":[\"10\"]}").empty());
+  EXPECT_TRUE(
+      SamplingProfiler::GetSampleAddresses("{\"stack\":[\"0x1g\"]}").empty());
+  EXPECT_TRUE(
+      SamplingProfiler::GetSampleAddresses("{\"stack\":[16]}").empty());
+}
+
+TEST(SamplingProfiler, Sampling) {
+  base::LogChecker log_checker;
+  CallTraceManager manager;
+  SamplingProfiler profiler(&manager);
+  profiler.SetFrequency(1000U);
+
+  // Samples can only be recorded on registered threads.
+  EXPECT_EQ(0U, profiler.RecordSamples());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "not registered"));
+
+  if (!SamplingProfiler::IsSupported()) {
+    EXPECT_FALSE(profiler.Start());
+    EXPECT_TRUE(log_checker.HasMessage("ERROR", "not supported"));
+    return;
+  }
+
+  profiler.RegisterCurrentThread();
+  ASSERT_TRUE(profiler.Start());
+  EXPECT_TRUE(profiler.IsRunning());
+  EXPECT_TRUE(profiler.Start());
+
+  // Only one profiler can run at a time.
+  SamplingProfiler other(&manager);
+  EXPECT_FALSE(other.Start());
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "already running"));
+
+  size_t count = BusyLoop(&profiler, 200);
+  profiler.Stop();
+  EXPECT_FALSE(profiler.IsRunning());
+  profiler.UnregisterCurrentThread();
+  EXPECT_GT(count, 0U);
+  EXPECT_EQ(0U, profiler.GetDroppedSampleCount());
+
+  // The samples are time stamps with the addresses of the sampled stacks.
+  Timeline timeline = manager.BuildTimeline();
+  size_t sample_count = 0;
+  for (const TimelineNode* node : TimelineSearch(
+           timeline, TimelineNode::Type::kTimeStamp,
+           SamplingProfiler::kSampleEventName)) {
+    const TimelineTimeStamp* stamp =
+        static_cast<const TimelineTimeStamp*>(node);
+    const std::vector<void*> addresses = SamplingProfiler::GetSampleAddresses(
+        Json::FastWriter().write(stamp->GetArgs()));
+    EXPECT_FALSE(addresses.empty());
+    EXPECT_LE(addresses.size(), profiler.GetMaxStackDepth());
+    port::StackTrace stack_trace(addresses);
+    EXPECT_EQ(addresses.size(), stack_trace.GetSymbols().size());
+    ++sample_count;
+  }
+  EXPECT_EQ(count, sample_count);
+  EXPECT_TRUE(manager.SnapshotChromeTrace().find(
+      SamplingProfiler::kSampleEventName) != std::string::npos);
+
+  // The other profiler can run now.
+  EXPECT_TRUE(other.Start());
+  other.Stop();
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(SamplingProfiler, DroppedSamples) {
+  if (!SamplingProfiler::IsSupported())
+    return;
+  CallTraceManager manager;
+  SamplingProfiler profiler(&manager);
+  profiler.SetFrequency(1000U);
+  profiler.SetBufferCapacity(2U);
+  profiler.RegisterCurrentThread();
+  ASSERT_TRUE(profiler.Start());
+
+  // Samples are dropped while they are not recorded.
+  const auto end =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+  volatile double sum = 0.0;
+  while (std::chrono::steady_clock::now() < end)
+    sum = sum + 0.5;
+  profiler.Stop();
+  EXPECT_GT(profiler.GetDroppedSampleCount(), 0U);
+  EXPECT_EQ(2U, profiler.RecordSamples());
+  profiler.UnregisterCurrentThread();
+}
+
+}  // namespace profile
+}  // namespace ion
@@ -0,0 +1,235 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/profile/standardmetrics.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/profile/calltracemanager.h"
+#include "ion/profile/timeline.h"
+#include "ion/profile/timelineframe.h"
+#include "ion/profile/timelinenode.h"
+#include "ion/profile/timelinescope.h"
+#include "ion/profile/timelinethread.h"
+#include "ion/profile/timelinetimestamp.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+#include "third_party/jsoncpp/include/json/value.h"
+
+namespace ion {
+namespace profile {
+
+namespace {
+
+typedef analytics::Benchmark Benchmark;
+
+TimelineNode* AddThread(const std::string& name, TimelineNode* root) {
+  TimelineThread* thread = new TimelineThread(name, port::GetCurrentThreadId());
+  root->AddChild(std::unique_ptr<TimelineNode>(thread));
+  return thread;
+}
+
+TimelineNode* AddFrame(uint32 begin, uint32 end, uint32 number,
+                       TimelineNode* parent) {
+  TimelineFrame* frame =
+      new TimelineFrame("Frame", begin, end - begin, Json::nullValue, number);
+  parent->AddChild(std::unique_ptr<TimelineNode>(frame));
+  return frame;
+}
+
+TimelineNode* AddScope(uint32 begin, uint32 end, const std::string& name,
+                       TimelineNode* parent) {
+  TimelineScope* scope =
+      new TimelineScope(name, begin, end - begin, Json::nullValue);
+  parent->AddChild(std::unique_ptr<TimelineNode>(scope));
+  return scope;
+}
+
+void AddTimeStamp(uint32 time, const std::string& name, TimelineNode* parent) {
+  parent->AddChild(std::unique_ptr<TimelineNode>(
+      new TimelineTimeStamp(name, time, Json::nullValue)));
+}
+
+// Returns the constant with the passed id, failing if there is none.
+double GetConstant(const Benchmark& benchmark, const std::string& id) {
+  for (const auto& constant : benchmark.GetConstants()) {
+    if (constant.descriptor.id == id)
+      return constant.value;
+  }
+  ADD_FAILURE() << "No constant " << id;
+  return 0.0;
+}
+
+// Returns the accumulated variable with the passed id, failing if there is
+// none.
+const Benchmark::AccumulatedVariable* GetVariable(const Benchmark& benchmark,
+                                                  const std::string& id) {
+  for (const auto& variable : benchmark.GetAccumulatedVariables()) {
+    if (variable.descriptor.id == id)
+      return &variable;
+  }
+  ADD_FAILURE() << "No variable " << id;
+  return nullptr;
+}
+
+}  // anonymous namespace
+
+TEST(StandardMetrics, FrameTime) {
+  std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
+  TimelineNode* main = AddThread("Main", root.get());
+  // Frames of 1, 2, ..., 100 ms.
+  uint32 time = 0U;
+  for (uint32 i = 1; i <= 100U; ++i) {
+    AddFrame(time, time + i * 1000U, i, main);
+    time += i * 1000U;
+  }
+  Timeline timeline(std::move(root));
+
+  Benchmark benchmark;
+  FrameTimeMetric().Run(timeline, &benchmark);
+  EXPECT_EQ(50.0, GetConstant(benchmark, "frame_time_p50"));
+  EXPECT_EQ(90.0, GetConstant(benchmark, "frame_time_p90"));
+  EXPECT_EQ(99.0, GetConstant(benchmark, "frame_time_p99"));
+  EXPECT_EQ(100.0, GetConstant(benchmark, "frame_time_max"));
+  const Benchmark::AccumulatedVariable* frame_time =
+      GetVariable(benchmark, "frame_time");
+  ASSERT_TRUE(frame_time);
+  EXPECT_EQ(100U, frame_time->samples);
+  EXPECT_EQ(1.0, frame_time->minimum);
+  EXPECT_DOUBLE_EQ(50.5, frame_time->mean);
+  EXPECT_EQ("FrameTimeMetric", frame_time->descriptor.group);
+
+  // Nothing is reported without frames.
+  Benchmark empty;
+  FrameTimeMetric().Run(Timeline(), &empty);
+  EXPECT_TRUE(empty.GetConstants().empty());
+  EXPECT_TRUE(empty.GetAccumulatedVariables().empty());
+}
+
+TEST(StandardMetrics, Jank) {
+  std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
+  TimelineNode* main = AddThread("Main", root.get());
+  TimelineNode* vsync = AddThread("VSync", root.get());
+  // VSyncs every 10 ms, with one late one that the median ignores.
+  for (uint32 i = 0; i < 10U; ++i)
+    AddTimeStamp(i * 10000U + (i == 5U ? 3000U : 0U), "VSync", vsync);
+  // Time stamps on other threads are not VSyncs.
+  AddTimeStamp(500U, "Other", main);
+  AddFrame(0U, 8000U, 1U, main);
+  AddFrame(10000U, 25000U, 2U, main);
+  AddFrame(30000U, 61000U, 3U, main);
+  AddFrame(70000U, 80000U, 4U, main);
+  Timeline timeline(std::move(root));
+
+  Benchmark benchmark;
+  JankMetric().Run(timeline, &benchmark);
+  EXPECT_EQ(10.0, GetConstant(benchmark, "vsync_interval"));
+  EXPECT_EQ(2.0, GetConstant(benchmark, "jank_count"));
+  EXPECT_EQ(50.0, GetConstant(benchmark, "jank_percentage"));
+  // The second frame misses one VSync and the third misses three.
+  EXPECT_EQ(4.0, GetConstant(benchmark, "missed_vsyncs"));
+
+  // Without VSync events the default interval is used.
+  std::unique_ptr<TimelineNode> root2(new TimelineNode("root"));
+  TimelineNode* main2 = AddThread("Main", root2.get());
+  AddFrame(0U, 16000U, 1U, main2);
+  AddFrame(16000U, 34000U, 2U, main2);
+  Timeline timeline2(std::move(root2));
+  Benchmark benchmark2;
+  JankMetric().Run(timeline2, &benchmark2);
+  EXPECT_EQ(JankMetric::kDefaultVSyncIntervalUs * 0.001,
+            GetConstant(benchmark2, "vsync_interval"));
+  EXPECT_EQ(1.0, GetConstant(benchmark2, "jank_count"));
+  Benchmark benchmark3;
+  JankMetric(20000U).Run(timeline2, &benchmark3);
+  EXPECT_EQ(0.0, GetConstant(benchmark3, "jank_count"));
+}
+
+TEST(StandardMetrics, ScopeTime) {
+  std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
+  TimelineNode* main = AddThread("Main", root.get());
+  TimelineNode* frame = AddFrame(0U, 20000U, 1U, main);
+  TimelineNode* draw = AddScope(1000U, 11000U, "Draw", frame);
+  AddScope(2000U, 4000U, "Upload", draw);
+  AddScope(5000U, 6000U, "Upload", draw);
+  AddScope(12000U, 14000U, "Draw", frame);
+  Timeline timeline(std::move(root));
+
+  Benchmark benchmark;
+  ScopeTimeMetric().Run(timeline, &benchmark);
+  ASSERT_EQ(4U, benchmark.GetAccumulatedVariables().size());
+  // Scopes are reported in name order.
+  EXPECT_EQ("Draw.inclusive",
+            benchmark.GetAccumulatedVariables()[0].descriptor.id);
+  const Benchmark::AccumulatedVariable* inclusive =
+      GetVariable(benchmark, "Draw.inclusive");
+  ASSERT_TRUE(inclusive);
+  EXPECT_EQ(2U, inclusive->samples);
+  EXPECT_EQ(2.0, inclusive->minimum);
+  EXPECT_EQ(10.0, inclusive->maximum);
+  const Benchmark::AccumulatedVariable* self =
+      GetVariable(benchmark, "Draw.self");
+  ASSERT_TRUE(self);
+  EXPECT_EQ(2.0, self->minimum);
+  EXPECT_EQ(7.0, self->maximum);
+  const Benchmark::AccumulatedVariable* upload =
+      GetVariable(benchmark, "Upload.self");
+  ASSERT_TRUE(upload);
+  EXPECT_EQ(2U, upload->samples);
+  EXPECT_DOUBLE_EQ(1.5, upload->mean);
+}
+
+TEST(StandardMetrics, GpuCpuOverlap) {
+  std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
+  TimelineNode* main = AddThread("Main", root.get());
+  TimelineNode* gpu = AddThread("GPU", root.get());
+  AddFrame(0U, 10000U, 1U, main);
+  AddFrame(10000U, 20000U, 2U, main);
+  // The GPU is busy for half of the first frame and all of the second.
+  TimelineNode* gpu_scope = AddScope(5000U, 9000U, "GpuDraw", gpu);
+  // Nested scopes are not counted twice.
+  AddScope(6000U, 7000U, "GpuInner", gpu_scope);
+  AddScope(9000U, 21000U, "GpuDraw", gpu);
+  Timeline timeline(std::move(root));
+
+  Benchmark benchmark;
+  GpuCpuOverlapMetric().Run(timeline, &benchmark);
+  const Benchmark::AccumulatedVariable* overlap =
+      GetVariable(benchmark, "gpu_frame_overlap");
+  ASSERT_TRUE(overlap);
+  EXPECT_EQ(2U, overlap->samples);
+  EXPECT_EQ(50.0, overlap->minimum);
+  EXPECT_EQ(100.0, overlap->maximum);
+
+  // Nothing is reported without a GPU thread.
+  Benchmark other;
+  GpuCpuOverlapMetric("Other GPU").Run(timeline, &other);
+  EXPECT_TRUE(other.GetAccumulatedVariables().empty());
+}
+
+TEST(StandardMetrics, Register) {
+  CallTraceManager manager;
+  RegisterStandardTimelineMetrics(&manager);
+  // No events means no results, but all metrics run.
+  const Benchmark benchmark = manager.RunTimelineMetrics();
+  EXPECT_TRUE(benchmark.GetConstants().empty());
+  EXPECT_TRUE(benchmark.GetAccumulatedVariables().empty());
+}
+
+}  // namespace profile
+}  // namespace ion
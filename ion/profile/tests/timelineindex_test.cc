@@ -0,0 +1,172 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/profile/timelineindex.h"
+
+#include <memory>
+#include <string>
+
+#include "ion/profile/timeline.h"
+#include "ion/profile/timelinenode.h"
+#include "ion/profile/timelinescope.h"
+#include "ion/profile/timelinethread.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+#include "third_party/jsoncpp/include/json/value.h"
+
+static TimelineScope* AddScope(const uint32 start, const uint32 end,
+                               const char* name, TimelineNode* parent) {
+  TimelineScope* scope =
+      new TimelineScope(name, start, end - start, Json::nullValue);
+  parent->AddChild(std::unique_ptr<TimelineScope>(scope));
+  return scope;
+}
+
+static TimelineThread* AddThread(const char* name, TimelineNode* parent) {
+  TimelineThread* thread = new TimelineThread(name, ion::port::ThreadId());
+  parent->AddChild(std::unique_ptr<TimelineThread>(thread));
+  return thread;
+}
+
+TEST(TimelineIndex, EmptyTimeline) {
+  Timeline timeline;
+  TimelineIndex index(timeline);
+  EXPECT_EQ(&timeline, &index.GetTimeline());
+  EXPECT_EQ(0U, index.GetNodeCount());
+  EXPECT_TRUE(index.GetThreads().empty());
+  EXPECT_EQ(TimelineIndex::kInvalidIndex, index.FindNameId("root"));
+  EXPECT_TRUE(index.GetNodesOfType(TimelineNode::Type::kScope).empty());
+  TimelineIndex::Indices indices(1U, 0U);
+  index.FindNodesInRange(0U, 100U, &indices);
+  EXPECT_TRUE(indices.empty());
+  index.FindNodesOverlapping(0U, 100U, &indices);
+  EXPECT_TRUE(indices.empty());
+}
+
+TEST(TimelineIndex, Columns) {
+  // 0         1         2
+  // 0123456789012345678901234
+  // Thread "Main"
+  //  [     X     ]
+  //   [Y]    [Y]
+  // Thread "Other"
+  //      [  Z  ]
+  //        [Y]
+  std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
+  TimelineThread* main = AddThread("Main", root.get());
+  TimelineScope* x = AddScope(1, 13, "X", main);
+  TimelineScope* y0 = AddScope(2, 5, "Y", x);
+  TimelineScope* y1 = AddScope(9, 12, "Y", x);
+  TimelineThread* other = AddThread("Other", root.get());
+  TimelineScope* z = AddScope(6, 12, "Z", other);
+  TimelineScope* y2 = AddScope(8, 11, "Y", z);
+  Timeline timeline((std::move(root)));
+  TimelineIndex index(timeline);
+
+  // The nodes are in timeline order.
+  ASSERT_EQ(7U, index.GetNodeCount());
+  size_t i = 0;
+  for (const TimelineNode* node : timeline) {
+    EXPECT_EQ(node, index.GetNode(i));
+    EXPECT_EQ(node->GetBegin(), index.GetBegin(i));
+    EXPECT_EQ(node->GetEnd(), index.GetEnd(i));
+    EXPECT_EQ(node->GetType(), index.GetType(i));
+    EXPECT_EQ(node->GetName(), index.GetName(index.GetNameId(i)));
+    ++i;
+  }
+  EXPECT_EQ(0U, index.GetDepth(0));
+  EXPECT_EQ(1U, index.GetDepth(1));
+  EXPECT_EQ(2U, index.GetDepth(2));
+  EXPECT_EQ(2U, index.GetDepth(6));
+
+  ASSERT_EQ(2U, index.GetThreads().size());
+  EXPECT_EQ(main, index.GetThreads()[0]);
+  EXPECT_EQ(other, index.GetThreads()[1]);
+  EXPECT_EQ(0U, index.GetThreadIndex(3));
+  EXPECT_EQ(1U, index.GetThreadIndex(6));
+
+  const uint32 y_id = index.FindNameId("Y");
+  ASSERT_NE(TimelineIndex::kInvalidIndex, y_id);
+  EXPECT_EQ("Y", index.GetName(y_id));
+  ASSERT_EQ(3U, index.GetNodesWithName(y_id).size());
+  EXPECT_EQ(y0, index.GetNode(index.GetNodesWithName(y_id)[0]));
+  EXPECT_EQ(y1, index.GetNode(index.GetNodesWithName(y_id)[1]));
+  EXPECT_EQ(y2, index.GetNode(index.GetNodesWithName(y_id)[2]));
+  EXPECT_EQ(TimelineIndex::kInvalidIndex, index.FindNameId("W"));
+  EXPECT_EQ(5U, index.GetNodesOfType(TimelineNode::Type::kScope).size());
+  EXPECT_EQ(2U, index.GetNodesOfType(TimelineNode::Type::kThread).size());
+
+  TimelineIndex::Indices indices;
+  index.FindNodesInRange(6U, 12U, &indices);
+  ASSERT_EQ(3U, indices.size());
+  EXPECT_EQ(y1, index.GetNode(indices[0]));
+  EXPECT_EQ(z, index.GetNode(indices[1]));
+  EXPECT_EQ(y2, index.GetNode(indices[2]));
+
+  // Threads span the whole timeline.
+  index.FindNodesOverlapping(5U, 6U, &indices);
+  ASSERT_EQ(5U, indices.size());
+  EXPECT_EQ(main, index.GetNode(indices[0]));
+  EXPECT_EQ(x, index.GetNode(indices[1]));
+  EXPECT_EQ(y0, index.GetNode(indices[2]));
+  EXPECT_EQ(other, index.GetNode(indices[3]));
+  EXPECT_EQ(z, index.GetNode(indices[4]));
+}
+
+TEST(TimelineIndex, LargeTimeline) {
+  // Build a timeline with many nested scopes on a few threads, and check the
+  // time queries against a linear search.
+  std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
+  uint32 seed = 1U;
+  for (int t = 0; t < 3; ++t) {
+    TimelineThread* thread = AddThread("Thread", root.get());
+    uint32 time = static_cast<uint32>(t) * 7U;
+    for (int i = 0; i < 200; ++i) {
+      seed = seed * 1103515245U + 12345U;
+      const uint32 length = 10U + (seed >> 16) % 50U;
+      TimelineScope* scope = AddScope(time, time + length, "Outer", thread);
+      AddScope(time + 1U, time + length / 2U, "Inner", scope);
+      AddScope(time + length / 2U, time + length - 1U, "Inner", scope);
+      time += length + (seed >> 24) % 5U;
+    }
+  }
+  Timeline timeline((std::move(root)));
+  TimelineIndex index(timeline);
+  EXPECT_EQ(3U + 3U * 600U, index.GetNodeCount());
+
+  TimelineIndex::Indices indices;
+  TimelineIndex::Indices expected;
+  for (uint32 begin = 0U; begin < 12000U; begin += 997U) {
+    for (uint32 length = 0U; length < 300U; length += 73U) {
+      const uint32 end = begin + length;
+      expected.clear();
+      for (uint32 i = 0; i < index.GetNodeCount(); ++i) {
+        if (index.GetBegin(i) >= begin && index.GetEnd(i) <= end)
+          expected.push_back(i);
+      }
+      index.FindNodesInRange(begin, end, &indices);
+      EXPECT_EQ(expected, indices);
+
+      expected.clear();
+      for (uint32 i = 0; i < index.GetNodeCount(); ++i) {
+        if (index.GetBegin(i) <= end && index.GetEnd(i) >= begin)
+          expected.push_back(i);
+      }
+      index.FindNodesOverlapping(begin, end, &indices);
+      EXPECT_EQ(expected, indices);
+    }
+  }
+}
@@ -17,8 +17,10 @@ limitations under the License.
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "ion/profile/timeline.h"
+#include "ion/profile/timelineindex.h"
 #include "ion/profile/timelinenode.h"
 #include "ion/profile/timelinerange.h"
 #include "ion/profile/timelinescope.h"
@@ -51,6 +53,15 @@ static TimelineScope* AddScope(const uint32 start, const uint32 end,
   return scope;
 }
 
+// Returns the nodes found by search, in order.
+static std::vector<const TimelineNode*> GetResults(
+    const TimelineSearch& search) {
+  std::vector<const TimelineNode*> results;
+  for (const TimelineNode* node : search)
+    results.push_back(node);
+  return results;
+}
+
 TEST(TimelineSearch, EmptyTimeline) {
   Timeline timeline;
   TimelineSearch search(timeline, TimelineNode::Type::kScope,
@@ -140,3 +151,46 @@ TEST(TimelineSearch, FindInComplexTimeline) {
   ++iter_named_scopes_in_range;
   EXPECT_EQ(iter_named_scopes_in_range, search_named_scopes_in_range.end());
 }
+
+TEST(TimelineSearch, IndexedSearchesMatch) {
+  std::unique_ptr<TimelineNode> root(new TimelineNode("root"));
+  TimelineRange* r0 = AddRange(0, 29, "R0", root.get());
+  TimelineScope* x1 = AddScope(1, 14, "X1", r0);
+  AddScope(2, 5, "X2", x1);
+  AddScope(7, 7, "A", x1);
+  AddScope(9, 12, "X3", x1);
+  TimelineScope* x4 = AddScope(16, 26, "X4", r0);
+  AddScope(18, 18, "A", x4);
+  AddRange(20, 24, "A", x4);
+  AddScope(28, 28, "A", r0);
+  AddScope(31, 31, "A", root.get());
+  Timeline timeline((std::move(root)));
+  TimelineIndex index(timeline);
+
+  const TimelineNode::Type types[] = {TimelineNode::Type::kScope,
+                                      TimelineNode::Type::kRange,
+                                      TimelineNode::Type::kFrame};
+  for (TimelineNode::Type type : types) {
+    EXPECT_EQ(GetResults(TimelineSearch(timeline, type)),
+              GetResults(TimelineSearch(index, type)));
+    EXPECT_EQ(GetResults(TimelineSearch(timeline, type, std::string("A"))),
+              GetResults(TimelineSearch(index, type, std::string("A"))));
+    EXPECT_EQ(
+        GetResults(TimelineSearch(timeline, type, std::string("None"))),
+        GetResults(TimelineSearch(index, type, std::string("None"))));
+    for (uint32 begin = 0; begin < 32U; begin += 3U) {
+      for (uint32 end = begin; end < 32U; end += 5U) {
+        EXPECT_EQ(GetResults(TimelineSearch(timeline, type, begin, end)),
+                  GetResults(TimelineSearch(index, type, begin, end)));
+        EXPECT_EQ(GetResults(TimelineSearch(timeline, type, std::string("A"),
+                                            begin, end)),
+                  GetResults(TimelineSearch(index, type, std::string("A"),
+                                            begin, end)));
+      }
+    }
+  }
+  TimelineSearch scopes(index, TimelineNode::Type::kScope, std::string("A"));
+  EXPECT_FALSE(scopes.empty());
+  EXPECT_EQ(4U, GetResults(scopes).size());
+  EXPECT_TRUE(TimelineSearch(index, TimelineNode::Type::kFrame).empty());
+}
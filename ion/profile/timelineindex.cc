@@ -0,0 +1,152 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/profile/timelineindex.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "ion/base/logging.h"
+
+// The number of TimelineNode::Type values.
+static const size_t kTypeCount =
+    static_cast<size_t>(TimelineNode::Type::kTimeStamp) + 1U;
+
+const uint32 TimelineIndex::kInvalidIndex = 0xffffffff;
+
+TimelineIndex::TimelineIndex(const Timeline& timeline)
+    : timeline_(timeline), nodes_by_type_(kTypeCount) {
+  // Visit the nodes in pre-order with an explicit stack, which is what the
+  // Timeline iterator does, but without searching for each node in its parent
+  // when back-tracking.
+  struct Entry {
+    const TimelineNode* node;
+    uint32 depth;
+    uint32 thread_index;
+  };
+  std::vector<Entry> stack;
+  const TimelineNode::Children& top_level = timeline_.GetRoot()->GetChildren();
+  for (auto it = top_level.rbegin(); it != top_level.rend(); ++it) {
+    Entry entry = { it->get(), 0U, kInvalidIndex };
+    stack.push_back(entry);
+  }
+  while (!stack.empty()) {
+    Entry entry = stack.back();
+    stack.pop_back();
+    const TimelineNode* node = entry.node;
+    if (entry.depth == 0U && node->GetType() == TimelineNode::Type::kThread) {
+      entry.thread_index = static_cast<uint32>(threads_.size());
+      threads_.push_back(node);
+    }
+
+    uint32 name_id;
+    auto found = name_ids_by_name_.find(node->GetName());
+    if (found == name_ids_by_name_.end()) {
+      name_id = static_cast<uint32>(names_.size());
+      name_ids_by_name_[node->GetName()] = name_id;
+      names_.push_back(node->GetName());
+      nodes_by_name_.push_back(Indices());
+    } else {
+      name_id = found->second;
+    }
+
+    const uint32 index = static_cast<uint32>(nodes_.size());
+    nodes_.push_back(node);
+    begins_.push_back(node->GetBegin());
+    ends_.push_back(node->GetEnd());
+    name_ids_.push_back(name_id);
+    types_.push_back(node->GetType());
+    depths_.push_back(entry.depth);
+    thread_indices_.push_back(entry.thread_index);
+    nodes_by_name_[name_id].push_back(index);
+    nodes_by_type_[static_cast<size_t>(node->GetType())].push_back(index);
+
+    const TimelineNode::Children& children = node->GetChildren();
+    for (auto it = children.rbegin(); it != children.rend(); ++it) {
+      Entry child = { it->get(), entry.depth + 1U, entry.thread_index };
+      stack.push_back(child);
+    }
+  }
+
+  // Sort by begin timestamp, keeping timeline order for equal timestamps.
+  by_begin_.resize(nodes_.size());
+  for (size_t i = 0; i < by_begin_.size(); ++i)
+    by_begin_[i] = static_cast<uint32>(i);
+  std::stable_sort(by_begin_.begin(), by_begin_.end(),
+                   [this](uint32 a, uint32 b) {
+                     return begins_[a] < begins_[b];
+                   });
+  max_ends_.resize(by_begin_.size());
+  BuildIntervalTree(0U, by_begin_.size());
+}
+
+TimelineIndex::~TimelineIndex() {}
+
+uint32 TimelineIndex::FindNameId(const std::string& name) const {
+  auto found = name_ids_by_name_.find(name);
+  return found == name_ids_by_name_.end() ? kInvalidIndex : found->second;
+}
+
+void TimelineIndex::FindNodesInRange(uint32 begin, uint32 end,
+                                     Indices* indices) const {
+  DCHECK(indices);
+  indices->clear();
+  auto it = std::lower_bound(
+      by_begin_.begin(), by_begin_.end(), begin,
+      [this](uint32 index, uint32 value) { return begins_[index] < value; });
+  for (; it != by_begin_.end() && begins_[*it] <= end; ++it) {
+    if (ends_[*it] <= end)
+      indices->push_back(*it);
+  }
+  std::sort(indices->begin(), indices->end());
+}
+
+void TimelineIndex::FindNodesOverlapping(uint32 begin, uint32 end,
+                                         Indices* indices) const {
+  DCHECK(indices);
+  indices->clear();
+  FindOverlapping(0U, by_begin_.size(), begin, end, indices);
+  std::sort(indices->begin(), indices->end());
+}
+
+uint32 TimelineIndex::BuildIntervalTree(size_t lo, size_t hi) {
+  if (lo >= hi)
+    return 0U;
+  const size_t mid = (lo + hi) / 2U;
+  max_ends_[mid] = std::max(ends_[by_begin_[mid]],
+                            std::max(BuildIntervalTree(lo, mid),
+                                     BuildIntervalTree(mid + 1U, hi)));
+  return max_ends_[mid];
+}
+
+void TimelineIndex::FindOverlapping(size_t lo, size_t hi, uint32 begin,
+                                    uint32 end, Indices* indices) const {
+  if (lo >= hi)
+    return;
+  const size_t mid = (lo + hi) / 2U;
+  // Nothing in the subtree ends late enough.
+  if (max_ends_[mid] < begin)
+    return;
+  FindOverlapping(lo, mid, begin, end, indices);
+  // The node at mid and everything after it begin too late.
+  const uint32 index = by_begin_[mid];
+  if (begins_[index] > end)
+    return;
+  if (ends_[index] >= begin)
+    indices->push_back(index);
+  FindOverlapping(mid + 1U, hi, begin, end, indices);
+}
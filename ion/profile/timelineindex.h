@@ -0,0 +1,135 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_PROFILE_TIMELINEINDEX_H_
+#define ION_PROFILE_TIMELINEINDEX_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "base/macros.h"
+#include "ion/profile/timeline.h"
+#include "ion/profile/timelinenode.h"
+
+// A TimelineIndex stores the nodes of a Timeline in columns (one array each
+// for begin and end timestamps, name ids, threads, depths and types) and
+// indexes them by name, type and time, so that searches over captures with
+// millions of events do not have to walk the whole Timeline. Nodes are
+// numbered in the order the Timeline iterates over them, skipping the root,
+// and all queries return node indices in that order.
+//
+// The index refers to the Timeline's nodes, so the Timeline must outlive it
+// and must not change while it exists.
+//
+// Example usage:
+//   TimelineIndex index(timeline);
+//   TimelineSearch search(index, TimelineNode::Type::kScope, "Draw");
+//   for (const TimelineNode* scope : search) { ... }
+class TimelineIndex {
+ public:
+  typedef std::vector<uint32> Indices;
+
+  // Returned by FindNameId() for names not in the Timeline, and stored as the
+  // thread index of nodes that are not in a thread.
+  static const uint32 kInvalidIndex;
+
+  explicit TimelineIndex(const Timeline& timeline);
+  ~TimelineIndex();
+
+  const Timeline& GetTimeline() const { return timeline_; }
+
+  // Returns the number of indexed nodes.
+  size_t GetNodeCount() const { return nodes_.size(); }
+
+  // Column accessors for the node with index |i|.
+  const TimelineNode* GetNode(size_t i) const { return nodes_[i]; }
+  uint32 GetBegin(size_t i) const { return begins_[i]; }
+  uint32 GetEnd(size_t i) const { return ends_[i]; }
+  uint32 GetNameId(size_t i) const { return name_ids_[i]; }
+  TimelineNode::Type GetType(size_t i) const { return types_[i]; }
+  // Returns the depth of the node below the root; threads have depth 0.
+  uint32 GetDepth(size_t i) const { return depths_[i]; }
+  // Returns the index into GetThreads() of the thread containing the node, or
+  // kInvalidIndex if it is not in a thread.
+  uint32 GetThreadIndex(size_t i) const { return thread_indices_[i]; }
+
+  // Returns the thread nodes, which are children of the root.
+  const std::vector<const TimelineNode*>& GetThreads() const {
+    return threads_;
+  }
+
+  // Returns the id of |name|, or kInvalidIndex if no node has that name.
+  uint32 FindNameId(const std::string& name) const;
+  // Returns the name with id |name_id|.
+  const std::string& GetName(uint32 name_id) const { return names_[name_id]; }
+
+  // Returns the indices of all nodes with the name with id |name_id|.
+  const Indices& GetNodesWithName(uint32 name_id) const {
+    return nodes_by_name_[name_id];
+  }
+  // Returns the indices of all nodes of |type|.
+  const Indices& GetNodesOfType(TimelineNode::Type type) const {
+    return nodes_by_type_[static_cast<size_t>(type)];
+  }
+
+  // Sets |indices| to the nodes that begin and end in [begin, end]. This only
+  // visits nodes that begin in the range.
+  void FindNodesInRange(uint32 begin, uint32 end, Indices* indices) const;
+  // Sets |indices| to the nodes that overlap [begin, end], i.e., that begin no
+  // later than |end| and end no earlier than |begin|. This uses an interval
+  // tree, so it takes O(log n + k) time for k results.
+  void FindNodesOverlapping(uint32 begin, uint32 end, Indices* indices) const;
+
+ private:
+  // Computes the maximum end of the nodes in the subtree of the implicit
+  // interval tree over by_begin_[lo, hi), storing it at the subtree's root.
+  uint32 BuildIntervalTree(size_t lo, size_t hi);
+  // Adds the nodes in the subtree over by_begin_[lo, hi) that overlap
+  // [begin, end] to indices.
+  void FindOverlapping(size_t lo, size_t hi, uint32 begin, uint32 end,
+                       Indices* indices) const;
+
+  const Timeline& timeline_;
+
+  // Columns.
+  std::vector<const TimelineNode*> nodes_;
+  std::vector<uint32> begins_;
+  std::vector<uint32> ends_;
+  std::vector<uint32> name_ids_;
+  std::vector<TimelineNode::Type> types_;
+  std::vector<uint32> depths_;
+  std::vector<uint32> thread_indices_;
+  std::vector<const TimelineNode*> threads_;
+
+  // Name and type indexes.
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, uint32> name_ids_by_name_;
+  std::vector<Indices> nodes_by_name_;
+  std::vector<Indices> nodes_by_type_;
+
+  // Node indices sorted by begin timestamp. This is also an implicit balanced
+  // binary tree: the root of the subtree over [lo, hi) is at (lo + hi) / 2, and
+  // max_ends_ holds the maximum end of each subtree at its root.
+  Indices by_begin_;
+  std::vector<uint32> max_ends_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimelineIndex);
+};
+
+#endif  // ION_PROFILE_TIMELINEINDEX_H_
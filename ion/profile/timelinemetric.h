@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "ion/analytics/benchmark.h"
 #include "ion/profile/timeline.h"
+#include "ion/profile/timelineindex.h"
 
 namespace ion {
 namespace profile {
@@ -33,6 +34,14 @@ class TimelineMetric {
   // Run the metric on the |timeline| and add results to |benchmark|.
   virtual void Run(const Timeline& timeline,
                    analytics::Benchmark* benchmark) const = 0;
+  // Run the metric on the timeline indexed by |index|. The CallTraceManager
+  // indexes the timeline once and calls this for every metric, so metrics that
+  // search large timelines should override it to search the index instead. The
+  // default calls Run() on the indexed timeline.
+  virtual void RunOnIndex(const TimelineIndex& index,
+                          analytics::Benchmark* benchmark) const {
+    Run(index.GetTimeline(), benchmark);
+  }
 };
 
 }  // namespace profile
@@ -28,7 +28,15 @@ limitations under the License.
 class TimelineNode {
  public:
   typedef std::vector<std::unique_ptr<TimelineNode>> Children;
-  enum class Type : char { kNode, kEvent, kThread, kFrame, kScope, kRange };
+  enum class Type : char {
+    kNode,
+    kEvent,
+    kThread,
+    kFrame,
+    kScope,
+    kRange,
+    kTimeStamp
+  };
 
   explicit TimelineNode(const std::string& name);
   TimelineNode(const std::string& name, const uint32 begin,
@@ -19,10 +19,12 @@ limitations under the License.
 #define ION_PROFILE_TIMELINESEARCH_H_
 
 #include <string>
+#include <vector>
 
 #include "ion/port/threadutils.h"
 #include "ion/profile/timeline.h"
 #include "ion/profile/timelineevent.h"
+#include "ion/profile/timelineindex.h"
 #include "ion/profile/timelinenode.h"
 #include "ion/profile/timelinethread.h"
 
@@ -32,6 +34,11 @@ typedef std::function<bool(const TimelineNode*)> Predicate;
 // arbitray order (actually the order in which their TraceRecorders were
 // created). Nodes under a thread are visited in order of increasing begin
 // timestamps.
+//
+// Searches by type, name or time range can also use a TimelineIndex, which
+// finds the matching nodes up front without walking the whole Timeline. This
+// is much faster for large captures, especially when several searches are
+// run on the same Timeline. The nodes are visited in the same order.
 class TimelineSearch {
  public:
   // Searches nodes by type.
@@ -53,16 +60,28 @@ class TimelineSearch {
   // Searches by arbitrary predicate.
   TimelineSearch(const Timeline& timeline, const Predicate& predicate);
 
+  // Indexed versions of the searches by type, name and time range above.
+  TimelineSearch(const TimelineIndex& index, TimelineNode::Type node_type);
+  TimelineSearch(const TimelineIndex& index, TimelineNode::Type node_type,
+                 const std::string& node_name);
+  TimelineSearch(const TimelineIndex& index, TimelineNode::Type node_type,
+                 uint32 begin, uint32 end);
+  TimelineSearch(const TimelineIndex& index, TimelineNode::Type node_type,
+                 const std::string& node_name, uint32 begin, uint32 end);
+
   class const_iterator {
    public:
     const_iterator(Timeline::const_iterator iter, const TimelineSearch* search);
-    const TimelineNode* operator*() const { return *iter_; }
+    const_iterator(size_t result_index, const TimelineSearch* search);
+    const TimelineNode* operator*() const;
     const_iterator operator++();
     bool operator==(const const_iterator& other) const;
     bool operator!=(const const_iterator& other) const;
 
    private:
     Timeline::const_iterator iter_;
+    // The position in the results of an indexed search.
+    size_t result_index_;
     const TimelineSearch* search_results_;
   };
 
@@ -73,12 +92,32 @@ class TimelineSearch {
   const_iterator end() const;
 
  private:
+  static Predicate TypePredicate(TimelineNode::Type node_type);
+  static Predicate NamePredicate(TimelineNode::Type node_type,
+                                 const std::string& node_name);
+  static Predicate RangePredicate(TimelineNode::Type node_type, uint32 begin,
+                                  uint32 end);
+  static Predicate NameAndRangePredicate(TimelineNode::Type node_type,
+                                         const std::string& node_name,
+                                         uint32 begin, uint32 end);
+
+  // Stores the nodes of an indexed search, which are the candidates found by
+  // the index that match the predicate.
+  void AddResults(const TimelineIndex& index,
+                  const TimelineIndex::Indices& candidates);
+
   const Timeline& timeline_;
   Predicate predicate_;
+  bool is_indexed_;
+  std::vector<const TimelineNode*> results_;
 };
 
 inline TimelineSearch::const_iterator TimelineSearch::const_iterator::
 operator++() {
+  if (search_results_->is_indexed_) {
+    ++result_index_;
+    return *this;
+  }
   do {
     ++iter_;
   } while (iter_ != search_results_->timeline().end() &&
@@ -88,11 +127,24 @@ operator++() {
 
 inline TimelineSearch::const_iterator::const_iterator(
     Timeline::const_iterator iter, const TimelineSearch* search_results)
-    : iter_(iter), search_results_(search_results) {}
+    : iter_(iter), result_index_(0U), search_results_(search_results) {}
+
+inline TimelineSearch::const_iterator::const_iterator(
+    size_t result_index, const TimelineSearch* search_results)
+    : iter_(search_results->timeline().end()),
+      result_index_(result_index),
+      search_results_(search_results) {}
+
+inline const TimelineNode* TimelineSearch::const_iterator::operator*() const {
+  return search_results_->is_indexed_
+             ? search_results_->results_[result_index_]
+             : *iter_;
+}
 
 inline bool TimelineSearch::const_iterator::operator==(
     const const_iterator& other) const {
-  return (iter_ == other.iter_) && (search_results_ == other.search_results_);
+  return (iter_ == other.iter_) && (result_index_ == other.result_index_) &&
+         (search_results_ == other.search_results_);
 }
 
 inline bool TimelineSearch::const_iterator::operator!=(
@@ -100,39 +152,63 @@ inline bool TimelineSearch::const_iterator::operator!=(
   return !(*this == other);
 }
 
+inline Predicate TimelineSearch::TypePredicate(TimelineNode::Type node_type) {
+  return [node_type](const TimelineNode* node) {
+    return node->GetType() == node_type;
+  };
+}
+
+inline Predicate TimelineSearch::NamePredicate(TimelineNode::Type node_type,
+                                               const std::string& node_name) {
+  return [node_type, node_name](const TimelineNode* node) {
+    return node->GetType() == node_type && node->GetName() == node_name;
+  };
+}
+
+inline Predicate TimelineSearch::RangePredicate(TimelineNode::Type node_type,
+                                                uint32 begin, uint32 end) {
+  return [node_type, begin, end](const TimelineNode* node) {
+    return node->GetType() == node_type && node->GetBegin() >= begin &&
+           node->GetEnd() <= end;
+  };
+}
+
+inline Predicate TimelineSearch::NameAndRangePredicate(
+    TimelineNode::Type node_type, const std::string& node_name, uint32 begin,
+    uint32 end) {
+  return [node_type, node_name, begin, end](const TimelineNode* node) {
+    return node->GetType() == node_type && node->GetName() == node_name &&
+           node->GetBegin() >= begin && node->GetEnd() <= end;
+  };
+}
+
 inline TimelineSearch::TimelineSearch(const Timeline& timeline,
                                       TimelineNode::Type node_type)
     : timeline_(timeline),
-      predicate_([node_type](const TimelineNode* node) {
-        return node->GetType() == node_type;
-      }) {}
+      predicate_(TypePredicate(node_type)),
+      is_indexed_(false) {}
 
 inline TimelineSearch::TimelineSearch(const Timeline& timeline,
                                       TimelineNode::Type node_type,
                                       const std::string& node_name)
     : timeline_(timeline),
-      predicate_([node_type, node_name](const TimelineNode* node) {
-        return node->GetType() == node_type && node->GetName() == node_name;
-      }) {}
+      predicate_(NamePredicate(node_type, node_name)),
+      is_indexed_(false) {}
 
 inline TimelineSearch::TimelineSearch(const Timeline& timeline,
                                       TimelineNode::Type node_type,
                                       uint32 begin, uint32 end)
     : timeline_(timeline),
-      predicate_([node_type, begin, end](const TimelineNode* node) {
-        return node->GetType() == node_type && node->GetBegin() >= begin &&
-               node->GetEnd() <= end;
-      }) {}
+      predicate_(RangePredicate(node_type, begin, end)),
+      is_indexed_(false) {}
 
 inline TimelineSearch::TimelineSearch(const Timeline& timeline,
                                       TimelineNode::Type node_type,
                                       const std::string& node_name,
                                       uint32 begin, uint32 end)
     : timeline_(timeline),
-      predicate_([node_type, node_name, begin, end](const TimelineNode* node) {
-        return node->GetType() == node_type && node->GetName() == node_name &&
-               node->GetBegin() >= begin && node->GetEnd() <= end;
-      }) {}
+      predicate_(NameAndRangePredicate(node_type, node_name, begin, end)),
+      is_indexed_(false) {}
 
 inline TimelineSearch::TimelineSearch(const Timeline& timeline,
                                       const ion::port::ThreadId& thread_id)
@@ -141,13 +217,67 @@ inline TimelineSearch::TimelineSearch(const Timeline& timeline,
         if (node->GetType() != TimelineNode::Type::kThread) return false;
         const TimelineThread* thread = static_cast<const TimelineThread*>(node);
         return thread->GetThreadId() == thread_id;
-      }) {}
+      }),
+      is_indexed_(false) {}
 
 inline TimelineSearch::TimelineSearch(const Timeline& timeline,
                                       const Predicate& predicate)
-    : timeline_(timeline), predicate_(predicate) {}
+    : timeline_(timeline), predicate_(predicate), is_indexed_(false) {}
+
+inline TimelineSearch::TimelineSearch(const TimelineIndex& index,
+                                      TimelineNode::Type node_type)
+    : timeline_(index.GetTimeline()),
+      predicate_(TypePredicate(node_type)),
+      is_indexed_(true) {
+  AddResults(index, index.GetNodesOfType(node_type));
+}
+
+inline TimelineSearch::TimelineSearch(const TimelineIndex& index,
+                                      TimelineNode::Type node_type,
+                                      const std::string& node_name)
+    : timeline_(index.GetTimeline()),
+      predicate_(NamePredicate(node_type, node_name)),
+      is_indexed_(true) {
+  const uint32 name_id = index.FindNameId(node_name);
+  if (name_id != TimelineIndex::kInvalidIndex)
+    AddResults(index, index.GetNodesWithName(name_id));
+}
+
+inline TimelineSearch::TimelineSearch(const TimelineIndex& index,
+                                      TimelineNode::Type node_type,
+                                      uint32 begin, uint32 end)
+    : timeline_(index.GetTimeline()),
+      predicate_(RangePredicate(node_type, begin, end)),
+      is_indexed_(true) {
+  TimelineIndex::Indices candidates;
+  index.FindNodesInRange(begin, end, &candidates);
+  AddResults(index, candidates);
+}
+
+inline TimelineSearch::TimelineSearch(const TimelineIndex& index,
+                                      TimelineNode::Type node_type,
+                                      const std::string& node_name,
+                                      uint32 begin, uint32 end)
+    : timeline_(index.GetTimeline()),
+      predicate_(NameAndRangePredicate(node_type, node_name, begin, end)),
+      is_indexed_(true) {
+  const uint32 name_id = index.FindNameId(node_name);
+  if (name_id != TimelineIndex::kInvalidIndex)
+    AddResults(index, index.GetNodesWithName(name_id));
+}
+
+inline void TimelineSearch::AddResults(
+    const TimelineIndex& index, const TimelineIndex::Indices& candidates) {
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    const TimelineNode* node = index.GetNode(candidates[i]);
+    if (predicate_(node))
+      results_.push_back(node);
+  }
+}
 
 inline TimelineSearch::const_iterator TimelineSearch::begin() const {
+  if (is_indexed_)
+    return const_iterator(0U, this);
   auto iter = timeline_.begin();
   while (iter != timeline_.end() && !predicate_(*iter)) {
     ++iter;
@@ -156,6 +286,8 @@ inline TimelineSearch::const_iterator TimelineSearch::begin() const {
 }
 
 inline TimelineSearch::const_iterator TimelineSearch::end() const {
+  if (is_indexed_)
+    return const_iterator(results_.size(), this);
   return const_iterator(timeline_.end(), this);
 }
 
@@ -19,6 +19,7 @@ limitations under the License.
 #include <memory>
 #include <stack>
 #include <string>
+#include <unordered_map>
 
 #include "ion/profile/tracerecorder.h"
 
@@ -31,6 +32,7 @@ limitations under the License.
 #include "ion/profile/timelinenode.h"
 #include "ion/profile/timelinerange.h"
 #include "ion/profile/timelinescope.h"
+#include "ion/profile/timelinetimestamp.h"
 #include "third_party/jsoncpp/include/json/json.h"
 
 namespace ion {
@@ -97,6 +99,7 @@ void TraceRecorder::LeaveScope() {
 }
 
 void TraceRecorder::EnterScopeAtTime(uint32 timestamp, int event_id) {
+  ReserveItems(2U);
   trace_buffer_.AddItem(event_id);
   trace_buffer_.AddItem(timestamp);
   ++scope_level_;
@@ -115,6 +118,7 @@ void TraceRecorder::AnnotateCurrentScopeAtTime(uint32 timestamp,
   uint32 name_index = GetStringIndex(TrimEndWhitespace(name));
   uint32 value_index = GetStringIndex(TrimEndWhitespace(value));
 
+  ReserveItems(4U);
   trace_buffer_.AddItem(CallTraceManager::kScopeAppendDataEvent);
   trace_buffer_.AddItem(timestamp);
   trace_buffer_.AddItem(name_index);
@@ -122,6 +126,8 @@ void TraceRecorder::AnnotateCurrentScopeAtTime(uint32 timestamp,
 }
 
 void TraceRecorder::LeaveScopeAtTime(uint32 timestamp) {
+  // Leave room for the empty scope marker.
+  ReserveItems(3U);
   trace_buffer_.AddItem(CallTraceManager::kScopeLeaveEvent);
   trace_buffer_.AddItem(timestamp);
   DCHECK_GT(scope_level_, 0);
@@ -135,6 +141,7 @@ void TraceRecorder::EnterFrame(uint32 frame_number) {
   if (frame_level_ == 0) {
     // Only record the frame for the outer-most EnterFrame() call.
     current_frame_number_ = frame_number;
+    ReserveItems(3U);
     trace_buffer_.AddItem(CallTraceManager::kFrameStartEvent);
     trace_buffer_.AddItem(manager_->GetTimeInUs());
     trace_buffer_.AddItem(frame_number);
@@ -151,6 +158,7 @@ void TraceRecorder::LeaveFrame() {
   --frame_level_;
   // Only record the frame for the outer-most LeaveFrame() call.
   if (frame_level_ == 0) {
+    ReserveItems(3U);
     trace_buffer_.AddItem(CallTraceManager::kFrameEndEvent);
     trace_buffer_.AddItem(manager_->GetTimeInUs());
     trace_buffer_.AddItem(current_frame_number_);
@@ -167,6 +175,7 @@ void TraceRecorder::EnterTimeRange(
     value_index = GetStringIndex(TrimEndWhitespace(value));
   }
 
+  ReserveItems(5U);
   trace_buffer_.AddItem(CallTraceManager::kTimeRangeStartEvent);
   trace_buffer_.AddItem(manager_->GetTimeInUs());
   trace_buffer_.AddItem(unique_id);
@@ -183,6 +192,7 @@ uint32 TraceRecorder::EnterTimeRange(const char* name, const char* value) {
     value_index = GetStringIndex(TrimEndWhitespace(value));
   }
 
+  ReserveItems(5U);
   trace_buffer_.AddItem(CallTraceManager::kTimeRangeStartEvent);
   trace_buffer_.AddItem(manager_->GetTimeInUs());
   // In this case, the index of the name inside the string_buffer_ serves as a
@@ -196,6 +206,7 @@ uint32 TraceRecorder::EnterTimeRange(const char* name, const char* value) {
 }
 
 void TraceRecorder::LeaveTimeRange(uint32 id) {
+  ReserveItems(3U);
   trace_buffer_.AddItem(CallTraceManager::kTimeRangeEndEvent);
   trace_buffer_.AddItem(manager_->GetTimeInUs());
   trace_buffer_.AddItem(id);
@@ -215,12 +226,22 @@ void TraceRecorder::CreateTimeStampAtTime(
     value_index = GetStringIndex(TrimEndWhitespace(value));
   }
 
+  ReserveItems(4U);
   trace_buffer_.AddItem(CallTraceManager::kTimeStampEvent);
   trace_buffer_.AddItem(timestamp);
   trace_buffer_.AddItem(name_index);
   trace_buffer_.AddItem(value_index);
 }
 
+void TraceRecorder::FlushToStream() {
+  if (manager_->StreamTraceRecorder(*this)) {
+    trace_buffer_.Clear();
+    // DumpTrace() starts at the first empty scope marker, so add one to keep
+    // the events that follow even if they are inside a scope.
+    trace_buffer_.AddItem(kEmptyScopeMarker);
+  }
+}
+
 size_t TraceRecorder::GetNumTraces() const {
   size_t index = 0;
   // Advance until the first empty scope marker.
@@ -243,6 +264,12 @@ size_t TraceRecorder::GetNumTraces() const {
   return length;
 }
 
+void TraceRecorder::ReserveItems(size_t count) {
+  if (manager_->IsStreaming() &&
+      trace_buffer_.GetSize() + count > trace_buffer_.GetCapacity())
+    FlushToStream();
+}
+
 uint32 TraceRecorder::GetStringIndex(const std::string& str) {
   // Attempt to insert this string with a new index. If the insert fails,
   // return the preexisting index for this string.
@@ -336,6 +363,11 @@ std::unique_ptr<TimelineEvent> TraceRecorder::GetTimelineEvent(
     event_name = manager_->GetScopeEnterEventName(wire_id);
     return std::unique_ptr<TimelineEvent>(
         new TimelineScope(event_name, timestamp, 0, args));
+  } else if (wire_id == CallTraceManager::kTimeStampEvent) {
+    event_name = GetStringArg(index, 0, inverse_string_buffer);
+    json_reader.parse(GetStringArg(index, 1, inverse_string_buffer), args);
+    return std::unique_ptr<TimelineEvent>(
+        new TimelineTimeStamp(event_name, timestamp, args));
   } else {
     CHECK(false) << "Event type not supported by timeline exporter!";
     return std::unique_ptr<TimelineEvent>(
@@ -401,6 +433,9 @@ void TraceRecorder::AddTraceToTimelineNode(TimelineNode* root) const {
       // children.
       parent_candidate = timeline_event.get();
       parent->AddChild(std::move(timeline_event));
+    } else if (wire_id == CallTraceManager::kTimeStampEvent) {
+      // Time stamps have no duration, so they never become parents.
+      parent->AddChild(GetTimelineEvent(index, inverse_string_buffer));
     } else if (wire_id == CallTraceManager::kTimeRangeEndEvent ||
                wire_id == CallTraceManager::kFrameEndEvent ||
                wire_id == CallTraceManager::kScopeLeaveEvent) {
@@ -424,6 +459,125 @@ void TraceRecorder::AddTraceToTimelineNode(TimelineNode* root) const {
   }
 }
 
+void TraceRecorder::AppendChromeTraceEvents(uint32 pid, uint32 tid,
+                                            Json::Value* events) const {
+  CHECK(events);
+  Json::Reader json_reader;
+  IndexToStringMap inverse_string_buffer;
+  for (auto it = string_buffer_.begin(); it != string_buffer_.end(); ++it) {
+    inverse_string_buffer[it->second] = it->first;
+  }
+  // Parses a value string as JSON, keeping it as a plain string if it is not
+  // JSON.
+  auto parse_value = [&json_reader](const std::string& value) {
+    Json::Value parsed;
+    if (!json_reader.parse(value, parsed, false))
+      parsed = value;
+    return parsed;
+  };
+  // Event args must be an object, so other values are stored under "value".
+  auto parse_args = [&parse_value](const std::string& value,
+                                   Json::Value* args) {
+    if (value.empty())
+      return;
+    const Json::Value parsed = parse_value(value);
+    if (parsed.isObject())
+      *args = parsed;
+    else
+      (*args)["value"] = parsed;
+  };
+
+  // Indices in events of the open scope and frame events, which receive the
+  // data appended to the current scope.
+  std::stack<Json::ArrayIndex> open_events;
+  // The names of the open time ranges, which their end events repeat.
+  std::unordered_map<uint32, std::string> open_ranges;
+
+  // Advance until the first empty scope marker.
+  size_t index = 0;
+  while (index < trace_buffer_.GetSize() &&
+         trace_buffer_.GetItem(index) != kEmptyScopeMarker) {
+    ++index;
+  }
+
+  while (index < trace_buffer_.GetSize()) {
+    const uint32 wire_id = trace_buffer_.GetItem(index);
+    if (wire_id == kEmptyScopeMarker) {
+      ++index;
+      continue;
+    }
+
+    Json::Value event(Json::objectValue);
+    event["pid"] = pid;
+    event["tid"] = tid;
+    event["ts"] = trace_buffer_.GetItem(index + 1);
+    if (wire_id >= CallTraceManager::kCustomScopeEvent) {
+      event["name"] = manager_->GetScopeEnterEventName(wire_id);
+      event["cat"] = "scope";
+      event["ph"] = "B";
+      open_events.push(events->size());
+    } else if (wire_id == CallTraceManager::kFrameStartEvent) {
+      const uint32 frame_number = trace_buffer_.GetItem(index + 2);
+      event["name"] = std::string("Frame_") + ValueToString(frame_number);
+      event["cat"] = "frame";
+      event["ph"] = "B";
+      event["args"]["frame_number"] = frame_number;
+      open_events.push(events->size());
+    } else if (wire_id == CallTraceManager::kScopeLeaveEvent ||
+               wire_id == CallTraceManager::kFrameEndEvent) {
+      event["ph"] = "E";
+      if (!open_events.empty())
+        open_events.pop();
+    } else if (wire_id == CallTraceManager::kScopeAppendDataEvent) {
+      if (!open_events.empty()) {
+        Json::Value& args = (*events)[open_events.top()]["args"];
+        const std::string arg_name =
+            GetStringArg(index, 0, inverse_string_buffer);
+        args[arg_name] =
+            parse_value(GetStringArg(index, 1, inverse_string_buffer));
+      }
+      event = Json::nullValue;
+    } else if (wire_id == CallTraceManager::kTimeRangeStartEvent) {
+      const uint32 id = trace_buffer_.GetItem(index + 2);
+      const std::string name = GetStringArg(index, 1, inverse_string_buffer);
+      open_ranges[id] = name;
+      event["name"] = name;
+      event["cat"] = "range";
+      event["ph"] = "b";
+      event["id"] = id;
+      parse_args(GetStringArg(index, 2, inverse_string_buffer),
+                 &event["args"]);
+    } else if (wire_id == CallTraceManager::kTimeRangeEndEvent) {
+      const uint32 id = trace_buffer_.GetItem(index + 2);
+      auto it = open_ranges.find(id);
+      if (it != open_ranges.end()) {
+        event["name"] = it->second;
+        event["cat"] = "range";
+        event["ph"] = "e";
+        event["id"] = id;
+        open_ranges.erase(it);
+      } else {
+        // The start of the range has been overwritten.
+        event = Json::nullValue;
+      }
+    } else if (wire_id == CallTraceManager::kTimeStampEvent) {
+      event["name"] = GetStringArg(index, 0, inverse_string_buffer);
+      event["cat"] = "timestamp";
+      event["ph"] = "i";
+      event["s"] = "t";
+      parse_args(GetStringArg(index, 1, inverse_string_buffer),
+                 &event["args"]);
+    } else {
+      event = Json::nullValue;
+    }
+    if (!event.isNull())
+      events->append(event);
+
+    const int num_args = CallTraceManager::GetNumArgsForEvent(wire_id);
+    index += num_args + 2;
+  }
+}
+
 uint32 TraceRecorder::GetCurrentFrameNumber() const {
   if (!IsInFrameScope()) {
     LOG_ONCE(WARNING) << "GetCurrentFrameNumber() should not be called outside "
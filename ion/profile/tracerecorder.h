@@ -120,6 +120,13 @@ class TraceRecorder : public ion::base::Allocatable {
   void CreateTimeStampAtTime(
       uint32 timestamp, const char* name, const char* value);
 
+  // If the CallTraceManager is streaming (see
+  // CallTraceManager::StartStreaming()), sends the recorded events to the
+  // stream and empties the buffer. This happens automatically whenever the
+  // buffer fills up while streaming, and must only be called from the thread
+  // that records into this instance.
+  void FlushToStream();
+
   // Returns the total number of recorded trace events.
   // Note: this is SLOW, it goes through a linear scan of the trace buffer.
   size_t GetNumTraces() const;
@@ -143,6 +150,13 @@ class TraceRecorder : public ion::base::Allocatable {
   // Adds all events in the trace as a sub-tree under the passed in root node.
   void AddTraceToTimelineNode(TimelineNode* root) const;
 
+  // Appends all events in the trace to events, a JSON array, as Chrome trace
+  // events with the passed process and thread ids. Scopes and frames become
+  // duration events, time ranges become async events, and time stamps become
+  // instant events.
+  void AppendChromeTraceEvents(uint32 pid, uint32 tid,
+                               Json::Value* events) const;
+
   // Returns the frame number of the current frame scope, or 0 (and a warning
   // message) if TraceRecorder is not in a frame scope.
   uint32 GetCurrentFrameNumber() const;
@@ -157,6 +171,11 @@ class TraceRecorder : public ion::base::Allocatable {
   // to false.
   static bool s_reserve_buffer_;
 
+  // Flushes the buffer to the stream if it is streaming and there is no room
+  // for count more items, so that events are never overwritten while
+  // streaming.
+  void ReserveItems(size_t count);
+
   // Returns an index to use for this string, and records it in the
   // string_buffer_ if necessary.
   uint32 GetStringIndex(const std::string& str);
@@ -0,0 +1,47 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if !ION_PRODUCTION
+
+#include "ion/remote/allocationhandler.h"
+
+namespace ion {
+namespace remote {
+
+AllocationHandler::AllocationHandler(
+    const base::SamplingAllocationTrackerPtr& tracker)
+    : HttpServer::RequestHandler("/ion/allocations"),
+      tracker_(tracker) {
+  DCHECK(tracker_.Get());
+}
+
+AllocationHandler::~AllocationHandler() {}
+
+const std::string AllocationHandler::HandleRequest(
+    const std::string& path, const HttpServer::QueryMap& args,
+    std::string* content_type) {
+  if (path.empty() || path == "snapshot") {
+    *content_type = "application/json";
+    return tracker_->GetSnapshotJson(args.find("stacks") != args.end());
+  }
+  return std::string();
+}
+
+}  // namespace remote
+}  // namespace ion
+
+#endif
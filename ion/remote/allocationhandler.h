@@ -0,0 +1,52 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_REMOTE_ALLOCATIONHANDLER_H_
+#define ION_REMOTE_ALLOCATIONHANDLER_H_
+
+#include <string>
+
+#include "ion/base/samplingallocationtracker.h"
+#include "ion/remote/httpserver.h"
+
+namespace ion {
+namespace remote {
+
+// AllocationHandler serves snapshots of a SamplingAllocationTracker, which
+// allows memory growth to be watched while an application runs.
+//
+// /   or /snapshot      - Gets the JSON snapshot of the tracker (see
+//                             SamplingAllocationTracker::GetSnapshotJson())
+// /snapshot?stacks      - Also includes the sampled call stacks
+class ION_API AllocationHandler : public HttpServer::RequestHandler {
+ public:
+  explicit AllocationHandler(
+      const base::SamplingAllocationTrackerPtr& tracker);
+  ~AllocationHandler() override;
+
+  const std::string HandleRequest(const std::string& path,
+                                  const HttpServer::QueryMap& args,
+                                  std::string* content_type) override;
+
+ private:
+  base::SamplingAllocationTrackerPtr tracker_;
+};
+
+}  // namespace remote
+}  // namespace ion
+
+#endif  // ION_REMOTE_ALLOCATIONHANDLER_H_
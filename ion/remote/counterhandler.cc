@@ -0,0 +1,376 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if !ION_PRODUCTION
+
+#include "ion/remote/counterhandler.h"
+
+#include <string.h>  // For memcpy().
+
+#include <functional>
+#include <sstream>
+
+#include "ion/base/invalid.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/logging.h"
+#include "ion/base/stringutils.h"
+#include "ion/base/zipassetmanager.h"
+#include "ion/base/zipassetmanagermacros.h"
+
+ION_REGISTER_ASSETS(IonRemoteCountersRoot);
+
+namespace ion {
+namespace remote {
+
+namespace {
+
+// Stores |value| in the 4 bytes at |data| in little-endian order.
+static void EncodeUint32(uint32 value, uint8* data) {
+  for (int i = 0; i < 4; ++i)
+    data[i] = static_cast<uint8>(value >> (8 * i));
+}
+
+// Stores |value| in the 8 bytes at |data| as a little-endian IEEE double.
+static void EncodeDouble(double value, uint8* data) {
+  uint64 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; ++i)
+    data[i] = static_cast<uint8>(bits >> (8 * i));
+}
+
+// Returns the amount a cumulative counter increased by from |begin| to |end|.
+// If the counter was reset in between then |end| is returned.
+template <typename T>
+static double GetIncrease(T begin, T end) {
+  return static_cast<double>(end >= begin ? end - begin : end);
+}
+
+// Returns the frame interval passed in a websocket query or message, which
+// is at least 1.
+static uint32 ParseFrameInterval(const std::string& str) {
+  const int32 interval = base::StringToInt32(str);
+  return interval > 1 ? static_cast<uint32>(interval) : 1U;
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// CounterWebsocket sends the encoded counters to a client.
+//
+//-----------------------------------------------------------------------------
+
+class CounterHandler::CounterWebsocket : public HttpServer::Websocket {
+ public:
+  CounterWebsocket(CounterHandler* handler, uint32 frame_interval)
+      : handler_(handler),
+        frame_interval_(frame_interval),
+        frames_since_send_(0U),
+        is_ready_(false),
+        is_closed_(false) {}
+
+  ~CounterWebsocket() override {
+    // The connection may have been dropped before it was ready.
+    handler_->RemoveClient(this);
+  }
+
+  void ConnectionReady() override {
+    base::LockGuard lock(&mutex_);
+    is_ready_ = true;
+  }
+
+  void ConnectionClosed() override {
+    {
+      // Wait for any frame being sent to finish, since data cannot be sent
+      // after this returns.
+      base::LockGuard lock(&mutex_);
+      is_closed_ = true;
+    }
+    handler_->RemoveClient(this);
+  }
+
+  int ReceiveData(char* data, size_t data_len, bool is_binary) override {
+    // An empty message closes the connection.
+    if (!data_len)
+      return 0;
+    if (!is_binary) {
+      base::LockGuard lock(&mutex_);
+      frame_interval_ = ParseFrameInterval(std::string(data, data_len));
+      frames_since_send_ = 0U;
+    }
+    return 1;
+  }
+
+  // Sends |data| if the client is due another frame.
+  void SendFrame(const uint8* data, size_t data_len) {
+    base::LockGuard lock(&mutex_);
+    if (is_ready_ && !is_closed_ && ++frames_since_send_ >= frame_interval_) {
+      frames_since_send_ = 0U;
+      SendData(reinterpret_cast<const char*>(data), data_len, true);
+    }
+  }
+
+ private:
+  // The handler is kept alive for as long as the connection.
+  CounterHandlerPtr handler_;
+  uint32 frame_interval_;
+  uint32 frames_since_send_;
+  bool is_ready_;
+  bool is_closed_;
+  // Guards the members above, and ensures that no data is sent after the
+  // connection has closed.
+  port::Mutex mutex_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// CounterHandler functions.
+//
+//-----------------------------------------------------------------------------
+
+const uint32 CounterHandler::kFrameVersion;
+const size_t CounterHandler::kFrameSize;
+
+CounterHandler::CounterHandler(const gfxutils::FramePtr& frame,
+                               const gfx::RendererPtr& renderer)
+    : HttpServer::RequestHandler("/ion/counters"),
+      frame_(frame),
+      renderer_(renderer),
+      tracker_(renderer->GetAllocator().Get() ?
+               renderer->GetAllocator()->GetTracker() :
+               base::AllocationTrackerPtr()),
+      client_count_(0U),
+      is_streaming_(false),
+      prev_call_statistics_enabled_(false),
+      has_begin_totals_(false),
+      has_previous_frame_(false) {
+  using std::bind;
+  using std::placeholders::_1;
+
+  IonRemoteCountersRoot::RegisterAssetsOnce();
+  memset(frame_data_, 0, sizeof(frame_data_));
+
+  // Install frame callbacks to do the work.
+  if (frame_.Get()) {
+    frame_->AddPreFrameCallback("CounterHandler",
+                                bind(&CounterHandler::BeginFrame, this, _1));
+    frame_->AddPostFrameCallback("CounterHandler",
+                                 bind(&CounterHandler::EndFrame, this, _1));
+  }
+}
+
+CounterHandler::~CounterHandler() {
+  DCHECK(clients_.empty());
+  if (frame_.Get()) {
+    frame_->RemovePreFrameCallback("CounterHandler");
+    frame_->RemovePostFrameCallback("CounterHandler");
+  }
+  if (is_streaming_) {
+    renderer_->GetGraphicsManager()->EnableCallStatistics(
+        prev_call_statistics_enabled_);
+  }
+}
+
+const char* CounterHandler::GetCounterName(int counter) {
+  static const char* kGpuMemoryNames[gfx::Renderer::kNumResourceTypes] = {
+    "gpu_memory_attribute_arrays",          // Renderer::kAttributeArray,
+    "gpu_memory_buffer_objects",            // Renderer::kBufferObject,
+    "gpu_memory_framebuffer_objects",       // Renderer::kFramebufferObject,
+    "gpu_memory_samplers",                  // Renderer::kSampler,
+    "gpu_memory_shader_input_registries",   // Renderer::kShaderInputRegistry,
+    "gpu_memory_shader_programs",           // Renderer::kShaderProgram,
+    "gpu_memory_shaders",                   // Renderer::kShader,
+    "gpu_memory_textures",                  // Renderer::kTexture,
+  };
+  if (counter >= kGpuMemory && counter < kAllocationCount)
+    return kGpuMemoryNames[counter - kGpuMemory];
+  switch (counter) {
+    case kFrameNumber: return "frame_number";
+    case kFrameTime: return "frame_time_ms";
+    case kFrameInterval: return "frame_interval_ms";
+    case kCallCount: return "call_count";
+    case kDrawCallCount: return "draw_call_count";
+    case kPrimitiveCount: return "primitive_count";
+    case kSentUniformCount: return "sent_uniform_count";
+    case kBufferUploadBytes: return "buffer_upload_bytes";
+    case kTextureUploadBytes: return "texture_upload_bytes";
+    case kAllocationCount: return "allocation_count";
+    case kDeallocationCount: return "deallocation_count";
+    case kAllocatedBytes: return "allocated_bytes";
+    case kActiveAllocationCount: return "active_allocation_count";
+    case kActiveAllocationBytes: return "active_allocation_bytes";
+    default:
+      DCHECK(false) << "Invalid counter " << counter;
+      return "";
+  }
+}
+
+const std::string CounterHandler::HandleRequest(
+    const std::string& path_in, const HttpServer::QueryMap& args,
+    std::string* content_type) {
+  const std::string path = path_in.empty() ? "index.html" : path_in;
+
+  if (path == "names") {
+    *content_type = "application/json";
+    std::ostringstream str;
+    str << "[";
+    for (int i = 0; i < kNumCounters; ++i)
+      str << (i ? ", \"" : "\"") << GetCounterName(i) << "\"";
+    str << "]\n";
+    return str.str();
+  } else {
+    const std::string& data =
+        base::ZipAssetManager::GetFileData("ion/counters/" + path);
+    if (!base::IsInvalidReference(data)) {
+      // Ensure the content type is set if the dashboard HTML is requested.
+      if (base::EndsWith(path, "html"))
+        *content_type = "text/html";
+      return data;
+    }
+  }
+  return std::string();
+}
+
+const HttpServer::WebsocketPtr CounterHandler::ConnectWebsocket(
+    const std::string& path, const HttpServer::QueryMap& args) {
+  if (path != "stream")
+    return HttpServer::RequestHandler::ConnectWebsocket(path, args);
+  const HttpServer::QueryMap::const_iterator it = args.find("frames");
+  CounterWebsocket* client = new CounterWebsocket(
+      this, it == args.end() ? 1U : ParseFrameInterval(it->second));
+  AddClient(client);
+  return HttpServer::WebsocketPtr(client);
+}
+
+void CounterHandler::AddClient(CounterWebsocket* client) {
+  base::LockGuard lock(&clients_mutex_);
+  clients_.push_back(client);
+  client_count_ = clients_.size();
+}
+
+void CounterHandler::RemoveClient(CounterWebsocket* client) {
+  base::LockGuard lock(&clients_mutex_);
+  for (size_t i = 0; i < clients_.size(); ++i) {
+    if (clients_[i] == client) {
+      clients_.erase(clients_.begin() + i);
+      break;
+    }
+  }
+  client_count_ = clients_.size();
+}
+
+void CounterHandler::GetTotals(Totals* totals) {
+  totals->call_statistics =
+      renderer_->GetGraphicsManager()->GetCallStatistics();
+  totals->sent_uniform_count = renderer_->GetSentUniformCount();
+  if (base::AllocationTracker* tracker = tracker_.Get()) {
+    totals->allocation_count = tracker->GetAllocationCount();
+    totals->deallocation_count = tracker->GetDeallocationCount();
+    totals->allocated_bytes = tracker->GetAllocatedBytesCount();
+  }
+}
+
+void CounterHandler::BeginFrame(const gfxutils::Frame& frame) {
+  const gfx::GraphicsManagerPtr& gm = renderer_->GetGraphicsManager();
+  // Call statistics are only gathered while there are clients.
+  const bool has_clients = client_count_.load() > 0U;
+  if (has_clients && !is_streaming_) {
+    prev_call_statistics_enabled_ = gm->IsCallStatisticsEnabled();
+    gm->EnableCallStatistics(true);
+    has_previous_frame_ = false;
+  } else if (!has_clients && is_streaming_) {
+    gm->EnableCallStatistics(prev_call_statistics_enabled_);
+  }
+  is_streaming_ = has_clients;
+  has_begin_totals_ = is_streaming_;
+  if (is_streaming_) {
+    GetTotals(&begin_totals_);
+    frame_timer_.Reset();
+  }
+}
+
+void CounterHandler::EndFrame(const gfxutils::Frame& frame) {
+  if (!has_begin_totals_)
+    return;
+  has_begin_totals_ = false;
+  EncodeFrame(frame);
+  base::LockGuard lock(&clients_mutex_);
+  const size_t count = clients_.size();
+  for (size_t i = 0; i < count; ++i)
+    clients_[i]->SendFrame(frame_data_, kFrameSize);
+}
+
+void CounterHandler::EncodeFrame(const gfxutils::Frame& frame) {
+  const double frame_time = frame_timer_.GetInMs();
+  const double frame_interval =
+      has_previous_frame_ ? interval_timer_.GetInMs() : 0.0;
+  interval_timer_.Reset();
+  has_previous_frame_ = true;
+
+  Totals end_totals;
+  GetTotals(&end_totals);
+  const gfx::GraphicsManager::CallStatistics& begin_stats =
+      begin_totals_.call_statistics;
+  const gfx::GraphicsManager::CallStatistics& end_stats =
+      end_totals.call_statistics;
+
+  double values[kNumCounters];
+  values[kFrameNumber] = static_cast<double>(frame.GetCounter());
+  values[kFrameTime] = frame_time;
+  values[kFrameInterval] = frame_interval;
+  values[kCallCount] =
+      GetIncrease(begin_stats.call_count, end_stats.call_count);
+  values[kDrawCallCount] =
+      GetIncrease(begin_stats.draw_call_count, end_stats.draw_call_count);
+  values[kPrimitiveCount] =
+      GetIncrease(begin_stats.primitive_count, end_stats.primitive_count);
+  values[kSentUniformCount] = GetIncrease(begin_totals_.sent_uniform_count,
+                                          end_totals.sent_uniform_count);
+  values[kBufferUploadBytes] = GetIncrease(begin_stats.buffer_upload_bytes,
+                                           end_stats.buffer_upload_bytes);
+  values[kTextureUploadBytes] = GetIncrease(begin_stats.texture_upload_bytes,
+                                            end_stats.texture_upload_bytes);
+  for (int i = 0; i < gfx::Renderer::kNumResourceTypes; ++i) {
+    values[kGpuMemory + i] = static_cast<double>(renderer_->GetGpuMemoryUsage(
+        static_cast<gfx::Renderer::ResourceType>(i)));
+  }
+  values[kAllocationCount] = GetIncrease(begin_totals_.allocation_count,
+                                         end_totals.allocation_count);
+  values[kDeallocationCount] = GetIncrease(begin_totals_.deallocation_count,
+                                           end_totals.deallocation_count);
+  values[kAllocatedBytes] = GetIncrease(begin_totals_.allocated_bytes,
+                                        end_totals.allocated_bytes);
+  if (base::AllocationTracker* tracker = tracker_.Get()) {
+    values[kActiveAllocationCount] =
+        static_cast<double>(tracker->GetActiveAllocationCount());
+    values[kActiveAllocationBytes] =
+        static_cast<double>(tracker->GetActiveAllocationBytesCount());
+  } else {
+    values[kActiveAllocationCount] = 0.0;
+    values[kActiveAllocationBytes] = 0.0;
+  }
+
+  EncodeUint32(kFrameVersion, frame_data_);
+  EncodeUint32(static_cast<uint32>(kNumCounters), frame_data_ + 4);
+  for (int i = 0; i < kNumCounters; ++i)
+    EncodeDouble(values[i], frame_data_ + 8 + 8 * i);
+}
+
+}  // namespace remote
+}  // namespace ion
+
+#endif
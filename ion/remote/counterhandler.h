@@ -0,0 +1,178 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_REMOTE_COUNTERHANDLER_H_
+#define ION_REMOTE_COUNTERHANDLER_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/allocationtracker.h"
+#include "ion/gfx/graphicsmanager.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfxutils/frame.h"
+#include "ion/port/mutex.h"
+#include "ion/port/timer.h"
+#include "ion/remote/httpserver.h"
+
+namespace ion {
+namespace remote {
+
+// CounterHandler streams performance counters of each rendered frame to
+// websocket clients, which lets an application be watched live without
+// polling. Each client receives a binary frame every N rendered frames, where
+// N is set with the "frames" query argument when connecting (default 1), and
+// may be changed later by sending N in a text message. An empty text message
+// closes the connection.
+//
+// /   or /index.html        - Live counter dashboard
+// /names                    - Returns a JSON array of the counter names, in
+//                             the order they are sent
+// /stream                   - Websocket that streams the counters
+//
+// Each binary frame is little-endian, and contains a uint32 version (currently
+// 1), a uint32 counter count, and then the value of each counter as a float64.
+// Counters measured over a frame are computed from the differences between
+// the values at its beginning and end, so the handler does not reset any
+// statistics that other code may be gathering. While clients are connected
+// the handler enables call statistics in the GraphicsManager, and restores the
+// previous setting after the last one disconnects. Sending the counters does
+// not allocate memory.
+class ION_API CounterHandler : public HttpServer::RequestHandler {
+ public:
+  // The counters that are sent, in order.
+  enum Counter {
+    kFrameNumber,            // The counter of the Frame.
+    kFrameTime,              // Milliseconds between Begin() and End().
+    kFrameInterval,          // Milliseconds since the previous End().
+    kCallCount,              // OpenGL calls made during the frame.
+    kDrawCallCount,          // Draw calls made during the frame.
+    kPrimitiveCount,         // Primitives drawn during the frame.
+    kSentUniformCount,       // Uniform values sent during the frame.
+    kBufferUploadBytes,      // Bytes uploaded to buffers during the frame.
+    kTextureUploadBytes,     // Bytes uploaded to textures during the frame.
+    kGpuMemory,              // Bytes of GPU memory used by each
+                             // Renderer::ResourceType at the end of the frame.
+    kAllocationCount = kGpuMemory + gfx::Renderer::kNumResourceTypes,
+                             // Allocations made during the frame.
+    kDeallocationCount,      // Deallocations made during the frame.
+    kAllocatedBytes,         // Bytes allocated during the frame.
+    kActiveAllocationCount,  // Live allocations at the end of the frame.
+    kActiveAllocationBytes,  // Live allocated bytes at the end of the frame.
+    kNumCounters
+  };
+
+  // The version stored in each frame.
+  static const uint32 kFrameVersion = 1U;
+  // The size in bytes of each binary frame.
+  static const size_t kFrameSize = 8U + 8U * kNumCounters;
+
+  // The constructor is passed the Frame that tells the handler when frames
+  // begin and end, and the Renderer whose counters are sent. The allocation
+  // counters are read from the AllocationTracker of the Renderer's allocator,
+  // and are 0 if it does not have one.
+  CounterHandler(const gfxutils::FramePtr& frame,
+                 const gfx::RendererPtr& renderer);
+
+  ~CounterHandler() override;
+
+  // Sets the AllocationTracker that the allocation counters are read from.
+  // This should be called before frames are rendered. A NULL tracker sends
+  // zero allocation counters.
+  void SetAllocationTracker(const base::AllocationTrackerPtr& tracker) {
+    tracker_ = tracker;
+  }
+  const base::AllocationTrackerPtr& GetAllocationTracker() const {
+    return tracker_;
+  }
+
+  // Returns the name of a counter, as returned by /names.
+  static const char* GetCounterName(int counter);
+
+  // Returns the number of connected websocket clients.
+  size_t GetClientCount() const { return client_count_.load(); }
+
+  const std::string HandleRequest(const std::string& path,
+                                  const HttpServer::QueryMap& args,
+                                  std::string* content_type) override;
+
+  const HttpServer::WebsocketPtr ConnectWebsocket(
+      const std::string& path, const HttpServer::QueryMap& args) override;
+
+ private:
+  class CounterWebsocket;
+
+  // The values of the cumulative counters at the beginning of a frame.
+  struct Totals {
+    Totals()
+        : sent_uniform_count(0U),
+          allocation_count(0U),
+          deallocation_count(0U),
+          allocated_bytes(0U) {}
+    gfx::GraphicsManager::CallStatistics call_statistics;
+    size_t sent_uniform_count;
+    size_t allocation_count;
+    size_t deallocation_count;
+    size_t allocated_bytes;
+  };
+
+  // Frame callbacks.
+  void BeginFrame(const gfxutils::Frame& frame);
+  void EndFrame(const gfxutils::Frame& frame);
+
+  // Reads the current values of the cumulative counters into |totals|.
+  void GetTotals(Totals* totals);
+  // Fills in frame_data_ with the counters of the frame that just ended.
+  void EncodeFrame(const gfxutils::Frame& frame);
+
+  // Adds or removes a websocket that frames are sent to.
+  void AddClient(CounterWebsocket* client);
+  void RemoveClient(CounterWebsocket* client);
+
+  gfxutils::FramePtr frame_;
+  gfx::RendererPtr renderer_;
+  base::AllocationTrackerPtr tracker_;
+
+  // Connected clients, guarded by clients_mutex_. These are not owned; each
+  // removes itself when its connection closes.
+  std::vector<CounterWebsocket*> clients_;
+  port::Mutex clients_mutex_;
+  std::atomic<size_t> client_count_;
+
+  // Whether call statistics are enabled by the handler, and whether they were
+  // enabled before that. These are only used on the rendering thread.
+  bool is_streaming_;
+  bool prev_call_statistics_enabled_;
+  // Whether BeginFrame() ran while streaming, so that EndFrame() has totals to
+  // compute differences from.
+  bool has_begin_totals_;
+  Totals begin_totals_;
+  // Times the current frame and the interval between frames.
+  port::Timer frame_timer_;
+  port::Timer interval_timer_;
+  bool has_previous_frame_;
+  // The encoded counters of the last frame.
+  uint8 frame_data_[kFrameSize];
+};
+typedef base::ReferentPtr<CounterHandler>::Type CounterHandlerPtr;
+
+}  // namespace remote
+}  // namespace ion
+
+#endif  // ION_REMOTE_COUNTERHANDLER_H_
@@ -37,11 +37,20 @@ static std::string BuildRangeRequestHeader(int64 start, int64 end) {
   return headers.str();
 }
 
+// Returns request headers with the passed names and values.
+static std::string BuildRequestHeaders(
+    const std::map<std::string, std::string>& header_map) {
+  std::stringstream headers;
+  for (std::map<std::string, std::string>::const_iterator it =
+           header_map.begin(); it != header_map.end(); ++it)
+    headers << it->first << ": " << it->second << "\r\n";
+  return headers.str();
+}
+
 static std::string BuildUploadHeaders(const std::string& data) {
   std::stringstream headers;
   headers << "Content-Type: text/plain\r\n";
-  headers << "Content-Length: " << data.size() << "\r\n\r\n";
-  headers << data;
+  headers << "Content-Length: " << data.size() << "\r\n";
   return headers.str();
 }
 
@@ -62,9 +71,9 @@ static std::string BuildUri(const HttpClient::Url& url) {
   return uri;
 }
 
-static const HttpClient::Response SendRequest(const HttpClient::Url& url,
-                                              const char* method,
-                                              const std::string& headers) {
+static const HttpClient::Response SendRequest(
+    const HttpClient::Url& url, const char* method, const std::string& headers,
+    const std::string& body = std::string()) {
   HttpClient::Response response;
   response.url = url;
   if (url.IsValid()) {
@@ -73,6 +82,9 @@ static const HttpClient::Response SendRequest(const HttpClient::Url& url,
     std::ostringstream header_str;
     header_str << headers;
     header_str << "Host: " + url.hostname << "\r\n";
+    // Each request uses its own connection, so let the server close it.
+    if (headers.find("Connection:") == std::string::npos)
+      header_str << "Connection: close\r\n";
     const std::string header_string = header_str.str();
 
     // Have mongoose connect to the server.
@@ -81,10 +93,11 @@ static const HttpClient::Response SendRequest(const HttpClient::Url& url,
                                                 url.is_https ? 1 : 0,
                                                 error,
                                                 kErrorStringLength,
-                                                "%s %s HTTP/1.1\r\n%s\r\n",
+                                                "%s %s HTTP/1.1\r\n%s\r\n%s",
                                                 method,
                                                 BuildUri(url).c_str(),
-                                                header_string.c_str())) {
+                                                header_string.c_str(),
+                                                body.c_str())) {
       // Copy response info into a Response struct.
       mg_request_info* info = mg_get_request_info(connection);
       // Mongoose places the returned status code as a string in the uri.
@@ -227,18 +240,24 @@ const HttpClient::Response HttpClient::GetRange(
   return SendRequest(Url(url), "GET", BuildRangeRequestHeader(start, end));
 }
 
+const HttpClient::Response HttpClient::GetWithHeaders(
+    const std::string& url,
+    const std::map<std::string, std::string>& headers) const {
+  return SendRequest(Url(url), "GET", BuildRequestHeaders(headers));
+}
+
 const HttpClient::Response HttpClient::Head(const std::string& url) const {
   return SendRequest(Url(url), "HEAD", "");
 }
 
 const HttpClient::Response HttpClient::Post(const std::string& url,
                                             const std::string& data) {
-  return SendRequest(Url(url), "POST", BuildUploadHeaders(data));
+  return SendRequest(Url(url), "POST", BuildUploadHeaders(data), data);
 }
 
 const HttpClient::Response HttpClient::Put(const std::string& url,
                                            const std::string& data) {
-  return SendRequest(Url(url), "PUT", BuildUploadHeaders(data));
+  return SendRequest(Url(url), "PUT", BuildUploadHeaders(data), data);
 }
 
 }  // namespace remote
@@ -80,6 +80,12 @@ class HttpClient {
   // response.
   virtual const Response GetRange(const std::string& url, int64 start,
                                   int64 end) const;
+  // Sends a GET request for a URL with the passed additional headers, for
+  // example headers["Accept-Encoding"] = "gzip", and returns the remote host's
+  // response. The data is returned as received, even if it is compressed.
+  virtual const Response GetWithHeaders(
+      const std::string& url,
+      const std::map<std::string, std::string>& headers) const;
   // Sends a HEAD request for a URL and returns the remote host's response.
   virtual const Response Head(const std::string& url) const;
   // POSTs data to URL and returns the remote host's response.
@@ -22,15 +22,19 @@ limitations under the License.
 #include <stdio.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
+#include <iomanip>
 #include <sstream>
 
 #include "ion/base/lockguards.h"
 #include "ion/base/logging.h"
+#include "ion/base/samplingallocationtracker.h"
 #include "ion/base/scopedallocation.h"
 #include "ion/base/stringutils.h"
 
 #include "third_party/mongoose/mongoose.h"
+#include "third_party/zlib/src/zlib.h"
 
 #endif  // !ION_PRODUCTION
 
@@ -46,6 +50,7 @@ class HttpServer::WebsocketHelper {
       : connection_(conn), ready_(false), binary_(false) {
   }
   ~WebsocketHelper() {
+    websocket_->ConnectionClosed();
     websocket_->helper_ = NULL;
   }
 
@@ -210,8 +215,28 @@ void HttpServer::WebsocketHelper::SendData(
   mg_write(connection_, data, data_len);
 }
 
+// Compresses response data on behalf of an HttpServer, using the server's cache
+// of previously compressed data.
+class HttpServer::ResponseEncoder {
+ public:
+  // Returns |data| compressed with |encoding|, which must be "gzip" or
+  // "deflate". |etag| is the ETag of |data|. Returns an empty string if the
+  // data cannot be compressed.
+  static const std::string Encode(HttpServer* server,
+                                  const std::string& encoding,
+                                  const std::string& etag,
+                                  const std::string& data);
+};
+
 namespace {
 
+// Responses smaller than this are not worth compressing.
+static const size_t kMinCompressedSize = 256U;
+// The maximum total size of the compressed data cached by a server.
+static const size_t kMaxEncodedDataSize = 8U * 1024U * 1024U;
+// The maximum number of responses a server remembers having compressed once.
+static const size_t kMaxEncodedKeys = 1024U;
+
 // Pipe all mongoose log messages through Ion's logging. Mongoose only emits
 // messages when an error occurs.
 static int LogCallback(const mg_connection*, const char* message) {
@@ -249,6 +274,48 @@ static HttpServer::QueryMap BuildQueryMap(const char* query_string) {
   return args;
 }
 
+// Returns whether the connection stays open for further requests after the
+// current response, following the rules that Mongoose uses when keep-alive is
+// enabled: HTTP/1.1 clients keep connections alive unless they ask to close
+// them, while others must ask to keep them alive. Requests with a body of
+// unknown length always close the connection.
+static bool IsKeepAliveConnection(mg_connection* connection) {
+  const mg_request_info* info = mg_get_request_info(connection);
+  const std::string method(info->request_method);
+  if ((method == "POST" || method == "PUT") &&
+      !mg_get_header(connection, "Content-Length"))
+    return false;
+  if (const char* header = mg_get_header(connection, "Connection"))
+    return base::CompareCaseInsensitive(header, "keep-alive") == 0;
+  return info->http_version && strcmp(info->http_version, "1.1") == 0;
+}
+
+// Returns the Connection header for the response to the current request.
+static const std::string GetConnectionHeader(mg_connection* connection) {
+  return IsKeepAliveConnection(connection) ? "Connection: keep-alive\r\n"
+                                           : "Connection: close\r\n";
+}
+
+// Reads the body of a POST request on the passed connection and returns it if
+// it holds form data, which is encoded like a query string. Reading the body
+// also lets the connection be reused for the next request.
+static const std::string ReadFormData(mg_connection* connection) {
+  std::string body;
+  // Without a length, the body extends to the end of the connection.
+  if (!mg_get_header(connection, "Content-Length"))
+    return body;
+  char buffer[4096];
+  int count = 0;
+  while ((count = mg_read(connection, buffer, sizeof(buffer))) > 0)
+    body.append(buffer, static_cast<size_t>(count));
+  const char* content_type = mg_get_header(connection, "Content-Type");
+  if (content_type &&
+      !base::StartsWithCaseInsensitive(content_type,
+                                       "application/x-www-form-urlencoded"))
+    body.clear();
+  return body;
+}
+
 // Return a path relative to the handler's base path.  Strips any leading or
 // trailing '/' to produce a relative path that does not end in '/'.
 static const std::string MakeRelativePath(
@@ -329,6 +396,7 @@ static const std::string GetFileData(const std::string& path,
   const HttpServer::QueryMap args = BuildQueryMap(query_string);
 
   // Call the handler, stripping out the handler's base path.
+  base::SamplingAllocationTracker::ScopedTag tag("remote");
   std::string response = handler->HandleRequest(
       MakeRelativePath(handler, path), args, content_type);
 
@@ -464,7 +532,7 @@ static void SendStatusCode(mg_connection* connection, const std::string& status,
   std::stringstream header_stream;
   header_stream << "HTTP/1.1 " << status << "\r\n"
                 << "Content-Length: " << text.length() << "\r\n"
-                << "Connection: close\r\n\r\n" << text;
+                << GetConnectionHeader(connection) << "\r\n" << text;
   const std::string headers = header_stream.str();
   mg_printf(connection, "%s", headers.c_str());
 }
@@ -506,11 +574,137 @@ static bool ParseRangeRequest(const char* range_header,
   return valid_request;
 }
 
-// Sends the passed file data across the passed connection.
+// Returns |data| compressed in the gzip format if |gzip| is set, or the zlib
+// format used by the HTTP deflate encoding otherwise. Returns an empty string
+// if compression fails.
+static const std::string CompressData(const std::string& data, bool gzip) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Adding 16 to the window bits makes zlib write a gzip wrapper.
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                   gzip ? MAX_WBITS + 16 : MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK)
+    return std::string();
+  std::string compressed(
+      deflateBound(&stream, static_cast<uLong>(data.length())), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.length());
+  stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+  stream.avail_out = static_cast<uInt>(compressed.length());
+  const int result = deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END ? compressed : std::string();
+}
+
+// Returns a strong ETag for |data|, without the enclosing quotes.
+static const std::string ComputeETag(const std::string& data) {
+  const Bytef* bytes = reinterpret_cast<const Bytef*>(data.data());
+  const uInt length = static_cast<uInt>(data.length());
+  std::ostringstream str;
+  str << std::hex << std::setfill('0') << std::setw(8)
+      << crc32(0L, bytes, length) << std::setw(8) << adler32(1L, bytes, length)
+      << "-" << data.length();
+  return str.str();
+}
+
+// Returns the items of a comma-separated header value, such as that of an
+// Accept-Encoding or If-None-Match header, without surrounding whitespace.
+static const std::vector<std::string> SplitHeaderList(const char* header) {
+  std::vector<std::string> items = base::SplitString(header, ",");
+  for (size_t i = 0; i < items.size(); ++i)
+    items[i] = base::TrimStartAndEndWhitespace(items[i]);
+  return items;
+}
+
+// Returns whether an If-None-Match header matches |etag| or the ETag of one of
+// its encoded representations.
+static bool MatchesETag(const char* if_none_match, const std::string& etag) {
+  const std::vector<std::string> tags = SplitHeaderList(if_none_match);
+  for (size_t i = 0; i < tags.size(); ++i) {
+    // If-None-Match uses the weak comparison, which ignores the W/ prefix.
+    std::string tag = tags[i];
+    base::RemovePrefix("W/", &tag);
+    if (tag == "*" || tag == "\"" + etag + "\"" ||
+        tag == "\"" + etag + "-gzip\"" || tag == "\"" + etag + "-deflate\"")
+      return true;
+  }
+  return false;
+}
+
+// Returns the encoding to compress a response with given the value of the
+// request's Accept-Encoding header, or an empty string if the client does not
+// accept compressed data. gzip is preferred over deflate.
+static const std::string ChooseEncoding(const char* accept_encoding) {
+  bool accepts_gzip = false;
+  bool accepts_deflate = false;
+  if (accept_encoding) {
+    const std::vector<std::string> codings = SplitHeaderList(accept_encoding);
+    for (size_t i = 0; i < codings.size(); ++i) {
+      const std::vector<std::string> params =
+          base::SplitString(codings[i], ";");
+      if (params.empty())
+        continue;
+      // A quality value of 0 means the coding is not acceptable.
+      bool acceptable = true;
+      for (size_t j = 1; j < params.size(); ++j) {
+        const std::string param = base::TrimStartAndEndWhitespace(params[j]);
+        if (base::StartsWith(param, "q="))
+          acceptable = strtod(param.c_str() + 2, NULL) > 0.0;
+      }
+      const std::string coding = base::TrimStartAndEndWhitespace(params[0]);
+      if (coding == "gzip" || coding == "*")
+        accepts_gzip = acceptable;
+      else if (coding == "deflate")
+        accepts_deflate = acceptable;
+    }
+  }
+  if (accepts_gzip)
+    return "gzip";
+  else if (accepts_deflate)
+    return "deflate";
+  return std::string();
+}
+
+// Returns whether responses of the passed content type benefit from
+// compression.
+static bool IsCompressibleType(const std::string& content_type) {
+  const std::string type = content_type.substr(0, content_type.find(';'));
+  return base::StartsWith(type, "text/") ||
+         type == "application/javascript" ||
+         type == "application/x-javascript" ||
+         type == "application/json" || type == "application/xml" ||
+         type == "image/svg+xml";
+}
+
+// Sends a 304 Not Modified status for a response with the passed ETag.
+static void SendNotModified(mg_connection* connection,
+                            const std::string& etag) {
+  std::stringstream header_stream;
+  header_stream << "HTTP/1.1 304 Not Modified\r\n"
+                << "ETag: \"" << etag << "\"\r\n"
+                << "Cache-Control: no-cache\r\n"
+                << GetConnectionHeader(connection) << "\r\n";
+  const std::string headers = header_stream.str();
+  mg_printf(connection, "%s", headers.c_str());
+}
+
+// Sends the passed file data across the passed connection. The data is
+// compressed if the server and client allow it, and a 304 Not Modified status
+// is sent instead if the client already has it.
 static void SendFileData(mg_connection* connection,
+                         HttpServer* server,
                          const std::string& method,  // GET, HEAD, or POST.
                          const std::string& content_type,
                          const std::string& data) {
+  const std::string etag = ComputeETag(data);
+  if (const char* header = mg_get_header(connection, "If-None-Match")) {
+    if (MatchesETag(header, etag)) {
+      SendNotModified(connection, etag);
+      return;
+    }
+  }
+
   // We have data to return, so the status is ok.
   std::string status("200 OK");
   // If the client asked for a certain range then extract the range and
@@ -524,12 +718,36 @@ static void SendFileData(mg_connection* connection,
     if (ParseRangeRequest(header, range_end, &range_start, &range_end, &range))
       status = "206 Partial Content";
 
+  // Compress the data if the client accepts it, unless it only asked for part
+  // of it. Encoded representations get their own ETags.
+  const std::string* body = &data;
+  std::string encoded;
+  std::string body_etag = etag;
+  std::string encoding_headers;
+  if (server->IsCompressionEnabled() && IsCompressibleType(content_type) &&
+      data.length() >= kMinCompressedSize) {
+    encoding_headers = "Vary: Accept-Encoding\r\n";
+    const std::string encoding =
+        ChooseEncoding(mg_get_header(connection, "Accept-Encoding"));
+    if (range.empty() && !encoding.empty()) {
+      encoded =
+          HttpServer::ResponseEncoder::Encode(server, encoding, etag, data);
+      if (!encoded.empty() && encoded.length() < data.length()) {
+        body = &encoded;
+        body_etag += "-" + encoding;
+        encoding_headers += "Content-Encoding: " + encoding + "\r\n";
+      }
+    }
+  }
+
   // Create the headers that describe the file data.
   std::stringstream header_stream;
   header_stream << "HTTP/1.1 " << status << "\r\n"
                 << "Content-Type: " << content_type << "\r\n"
-                << "Content-Length: " << data.length() << "\r\n"
-                << "Connection: close\r\n"
+                << "Content-Length: " << body->length() << "\r\n"
+                << GetConnectionHeader(connection)
+                << "ETag: \"" << body_etag << "\"\r\n"
+                << "Cache-Control: no-cache\r\n" << encoding_headers
                 << "Accept-Ranges: bytes\r\n" << range << "\r\n";
 
   // Write headers to the connection.
@@ -537,8 +755,10 @@ static void SendFileData(mg_connection* connection,
   mg_printf(connection, "%s", headers.c_str());
   // Servicing a HEAD request requires only headers, not a body.
   if (method != "HEAD") {
-    const size_t size = static_cast<size_t>(range_end - range_start + 1);
-    mg_write(connection, &data[static_cast<size_t>(range_start)], size);
+    const size_t size = range.empty()
+        ? body->length()
+        : static_cast<size_t>(range_end - range_start + 1);
+    mg_write(connection, &(*body)[static_cast<size_t>(range_start)], size);
   }
 }
 
@@ -563,9 +783,16 @@ static int BeginRequestCallback(mg_connection* connection) {
     DCHECK(server);
     // Get a default content type based on the requested path.
     std::string content_type = mg_get_builtin_mime_type(info->uri);
+    // Form data posted in the body is passed to handlers like query arguments.
+    std::string query_string = info->query_string ? info->query_string : "";
+    if (method == "POST") {
+      const std::string form_data = ReadFormData(connection);
+      if (!form_data.empty())
+        query_string += (query_string.empty() ? "" : "&") + form_data;
+    }
     // Try to get data for the requested path.
     const std::string data =
-        GetFileData(info->uri, info->query_string, server->GetHeaderHtml(),
+        GetFileData(info->uri, query_string.c_str(), server->GetHeaderHtml(),
                     server->GetFooterHtml(), server->GetHandlers(),
                     &content_type, server->EmbedLocalSourcedFiles());
 
@@ -573,7 +800,7 @@ static int BeginRequestCallback(mg_connection* connection) {
       SendStatusCode(connection, "404 Not Found",
                      "Error 404: Not Found\nThe requested file was not found.");
     } else {
-      SendFileData(connection, method, content_type, data);
+      SendFileData(connection, server, method, content_type, data);
     }
     return 1;
   } else {
@@ -649,15 +876,69 @@ static int WebsocketData(mg_connection* connection, int bits,
   return result;
 }
 
+// Mongoose "end_request" callback function.  Called when a request has been
+// handled, including when a websocket connection ends without a close
+// frame, e.g., because the client went away.  Any websocket still registered
+// for the connection is removed, since the connection may be reused.
+static void EndRequest(const mg_connection* connection, int reply_status_code) {
+  mg_connection* unconst_connection = const_cast<mg_connection*>(connection);
+  const mg_request_info* info = mg_get_request_info(unconst_connection);
+  // The server is stored in the user_data field since it was passed to
+  // mg_start().
+  HttpServer* server = reinterpret_cast<HttpServer*>(info->user_data);
+  HttpServer::WebsocketHelper* helper =
+      HttpServer::WebsocketHelper::FindWebsocket(server, unconst_connection);
+  if (helper) {
+    helper->Unregister(server);
+    delete helper;
+  }
+}
+
 }  // anonymous namespace
 
+const std::string HttpServer::ResponseEncoder::Encode(
+    HttpServer* server, const std::string& encoding, const std::string& etag,
+    const std::string& data) {
+  const std::string key = encoding + ":" + etag;
+  {
+    base::LockGuard lock(&server->encoded_data_mutex_);
+    std::map<std::string, std::string>::const_iterator it =
+        server->encoded_data_.find(key);
+    if (it != server->encoded_data_.end())
+      return it->second;
+  }
+
+  const std::string encoded = CompressData(data, encoding == "gzip");
+  if (!encoded.empty()) {
+    base::LockGuard lock(&server->encoded_data_mutex_);
+    // Only cache data the second time it is compressed, so that responses that
+    // change on every request do not push static ones out of the cache.
+    if (server->encoded_keys_.erase(key)) {
+      if (server->encoded_data_size_ + encoded.length() > kMaxEncodedDataSize) {
+        server->encoded_data_.clear();
+        server->encoded_data_size_ = 0U;
+      }
+      if (encoded.length() <= kMaxEncodedDataSize &&
+          server->encoded_data_.insert(std::make_pair(key, encoded)).second)
+        server->encoded_data_size_ += encoded.length();
+    } else {
+      if (server->encoded_keys_.size() >= kMaxEncodedKeys)
+        server->encoded_keys_.clear();
+      server->encoded_keys_.insert(key);
+    }
+  }
+  return encoded;
+}
+
 HttpServer::RequestHandler::RequestHandler(const std::string& base_path)
     : base_path_(base_path) {}
 
 HttpServer::RequestHandler::~RequestHandler() {}
 
 HttpServer::HttpServer(int port, int num_threads)
-    : context_(NULL),
+    : encoded_data_size_(0U),
+      compression_enabled_(true),
+      context_(NULL),
       embed_local_sourced_files_(false) {
   if (port) {
     std::stringstream int_to_string;
@@ -672,6 +953,7 @@ HttpServer::HttpServer(int port, int num_threads)
     mg_callbacks callbacks;
     const char* options[] = { "listening_ports", port_cstr.c_str(),
                               "num_threads", num_threads_cstr.c_str(),
+                              "enable_keep_alive", "yes",
                               NULL };
 
     memset(&callbacks, 0, sizeof(callbacks));
@@ -680,6 +962,7 @@ HttpServer::HttpServer(int port, int num_threads)
     callbacks.websocket_connect = WebsocketConnect;
     callbacks.websocket_ready = WebsocketReady;
     callbacks.websocket_data = WebsocketData;
+    callbacks.end_request = EndRequest;
     // Store this server in the user_data field.
     context_ = mg_start(&callbacks, this, options);
   }
@@ -693,7 +976,13 @@ HttpServer::~HttpServer() {
 }
 
 const std::string HttpServer::GetUriData(const std::string& uri) const {
-  std::string content_type = mg_get_builtin_mime_type(uri.c_str());
+  std::string content_type;
+  return GetUriData(uri, &content_type);
+}
+
+const std::string HttpServer::GetUriData(const std::string& uri,
+                                         std::string* content_type) const {
+  *content_type = mg_get_builtin_mime_type(uri.c_str());
 
   // Query arguments occur after the first '?'.
   const size_t query_pos = uri.find('?');
@@ -704,7 +993,7 @@ const std::string HttpServer::GetUriData(const std::string& uri) const {
   // Since paths must be absolute, prepend a '/' if it is missing.
   return GetFileData(base::StartsWith(path, "/") ? path : '/' + path,
                      query_string.c_str(), header_, footer_, GetHandlers(),
-                     &content_type, embed_local_sourced_files_);
+                     content_type, embed_local_sourced_files_);
 }
 
 bool HttpServer::IsRunning() const {
@@ -770,7 +1059,9 @@ size_t HttpServer::WebsocketCount() {
 #else
 
 HttpServer::HttpServer(int port, int num_threads)
-    : context_(NULL),
+    : encoded_data_size_(0U),
+      compression_enabled_(true),
+      context_(NULL),
       embed_local_sourced_files_(false) {}
 
 HttpServer::~HttpServer() {}
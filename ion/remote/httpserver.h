@@ -19,6 +19,7 @@ limitations under the License.
 #define ION_REMOTE_HTTPSERVER_H_
 
 #include <map>
+#include <set>
 #include <string>
 
 #include "ion/base/referent.h"
@@ -37,6 +38,10 @@ class ION_API HttpServer {
   // Opaque helper to avoid exposing implementation details (i.e. Mongoose).
   class WebsocketHelper;
   typedef std::map<void*, WebsocketHelper*> WebsocketMap;
+  // Opaque helper that compresses response data. Responses that are sent more
+  // than once with the same data, such as the static assets of handlers, are
+  // only compressed the first time.
+  class ResponseEncoder;
 
   // Represents the server side of a connected Websocket.  Subclasses override
   // ReceiveData() to customize how to react to incoming messages.  Subclasses
@@ -50,6 +55,12 @@ class ION_API HttpServer {
     // Override to take some action when the connection is first established.
     virtual void ConnectionReady() {}
 
+    // Override to take some action when the connection is closed, either by
+    // a ReceiveData() result or because the client went away. SendData() must
+    // not be called once this returns, so subclasses that send data from
+    // other threads should stop doing so here.
+    virtual void ConnectionClosed() {}
+
     // All subclasses must implement this to respond to incoming messages.
     virtual int ReceiveData(char* data, size_t data_len, bool is_binary) = 0;
 
@@ -119,12 +130,22 @@ class ION_API HttpServer {
   // threads. Passing a negative port is an error, but passing port 0 will be
   // silently ignored (the server will not be reachable over a network interface
   // but there will be no reported startup errors).
+  //
+  // Connections from HTTP/1.1 clients are kept alive after each response unless
+  // the client asks to close them, and requests pipelined on a connection are
+  // answered in order. Each open connection holds one of the threads until it
+  // is closed or idles for longer than the request timeout, so servers should
+  // have a few more threads than the connections their clients keep open. The
+  // form data of POST requests is passed to handlers with the query arguments.
   HttpServer(int port, int num_threads);
   virtual ~HttpServer();
 
   // Returns the data of the requested URI, or returns an empty string if it
-  // does not exist.
+  // does not exist. The second version also returns the content type of the
+  // data.
   const std::string GetUriData(const std::string& uri) const;
+  const std::string GetUriData(const std::string& uri,
+                               std::string* content_type) const;
 
   // Returns whether the server is running.
   bool IsRunning() const;
@@ -158,6 +179,14 @@ class ION_API HttpServer {
   void SetFooterHtml(const std::string& str) { footer_ = str; }
   void SetHeaderHtml(const std::string& str) { header_ = str; }
 
+  // Gets/sets whether text responses such as HTML, CSS, JavaScript and JSON
+  // are sent gzip or deflate-encoded to clients that accept it. This is
+  // enabled by default. Every response has a strong ETag computed from its
+  // data, so clients that revalidate a response they already have receive a
+  // 304 Not Modified status instead of the data.
+  bool IsCompressionEnabled() const { return compression_enabled_; }
+  void SetCompressionEnabled(bool enabled) { compression_enabled_ = enabled; }
+
  private:
   // These methods and fields are all concerned with keeping track of active
   // websocket connections.  None of this would be necessary if Mongoose's
@@ -170,6 +199,16 @@ class ION_API HttpServer {
   WebsocketMap websockets_;
   port::Mutex websocket_mutex_;
 
+  friend class ResponseEncoder;
+  // Compressed response data, keyed by encoding and ETag.
+  std::map<std::string, std::string> encoded_data_;
+  // The total size of the data in encoded_data_.
+  size_t encoded_data_size_;
+  // The keys of responses that have been compressed once but are not cached.
+  std::set<std::string> encoded_keys_;
+  port::Mutex encoded_data_mutex_;
+  bool compression_enabled_;
+
   mg_context* context_;
   // Registered request handlers. Guarded under a mutex so that RequestHandler
   // objects may be added/removed while requests are being serviced on other
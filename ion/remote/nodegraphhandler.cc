@@ -24,6 +24,8 @@ limitations under the License.
 #include <sstream>
 
 #include "ion/base/invalid.h"
+#include "ion/base/lockguards.h"
+#include "ion/base/notifier.h"
 #include "ion/base/serialize.h"
 #include "ion/base/stringutils.h"
 #include "ion/base/zipassetmanager.h"
@@ -35,16 +37,93 @@ ION_REGISTER_ASSETS(IonRemoteNodeGraphRoot);
 namespace ion {
 namespace remote {
 
+namespace {
+
+// Escapes ", \, and \n.
+static const std::string EscapeJson(const std::string& str) {
+  std::string ret = base::ReplaceString(str, "\\", "\\\\");
+  ret = base::ReplaceString(ret, "\"", "\\\"");
+  ret = base::EscapeNewlines(ret);
+  return ret;
+}
+
+// Appends a JSON array of the keys in |ids| whose versions are greater than
+// |since|.
+static void AppendIdsSince(const std::map<uint64, uint64>& ids, uint64 since,
+                           std::ostream& str) {  // NOLINT
+  str << "[";
+  bool is_first = true;
+  for (std::map<uint64, uint64>::const_iterator it = ids.begin();
+       it != ids.end(); ++it) {
+    if (it->second > since) {
+      str << (is_first ? "" : ", ") << it->first;
+      is_first = false;
+    }
+  }
+  str << "]";
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// ChangeReceiver forwards the notifications of Nodes to the handler.
+//
+//-----------------------------------------------------------------------------
+
+class NodeGraphHandler::ChangeReceiver : public base::Notifier {
+ public:
+  explicit ChangeReceiver(NodeGraphHandler* handler) : handler_(handler) {}
+
+  // Stops forwarding notifications, since the handler is going away.
+  void Detach() {
+    base::LockGuard lock(&mutex_);
+    handler_ = NULL;
+  }
+
+  void OnNotify(const base::Notifier* notifier) override {
+    base::LockGuard lock(&mutex_);
+    if (handler_)
+      handler_->RecordChange(dynamic_cast<const gfx::Node*>(notifier));
+  }
+
+ private:
+  ~ChangeReceiver() override {}
+
+  NodeGraphHandler* handler_;
+  port::Mutex mutex_;
+};
+
+//-----------------------------------------------------------------------------
+//
+// NodeGraphHandler functions.
+//
+//-----------------------------------------------------------------------------
+
 NodeGraphHandler::NodeGraphHandler()
-    : HttpServer::RequestHandler("/ion/nodegraph") {
+    : HttpServer::RequestHandler("/ion/nodegraph"),
+      roots_version_(0U),
+      version_(0U),
+      next_id_(1U),
+      receiver_(new ChangeReceiver(this)) {
   IonRemoteNodeGraphRoot::RegisterAssetsOnce();
 }
 
-NodeGraphHandler::~NodeGraphHandler() {}
+NodeGraphHandler::~NodeGraphHandler() {
+  receiver_->Detach();
+  for (std::map<const gfx::Node*, NodeEntry>::iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    gfx::NodePtr node = it->second.node.Acquire();
+    if (node.Get())
+      node->RemoveReceiver(receiver_.Get());
+  }
+}
 
 void NodeGraphHandler::AddNode(const gfx::NodePtr& node) {
-  if (node.Get() && !IsNodeTracked(node))
+  if (node.Get() && !IsNodeTracked(node)) {
     nodes_.push_back(node);
+    RecordChange(NULL);
+  }
 }
 
 bool NodeGraphHandler::RemoveNode(const gfx::NodePtr& node) {
@@ -53,6 +132,7 @@ bool NodeGraphHandler::RemoveNode(const gfx::NodePtr& node) {
         std::find(nodes_.begin(), nodes_.end(), node);
     if (it != nodes_.end()) {
       nodes_.erase(it);
+      RecordChange(NULL);
       return true;
     }
   }
@@ -72,6 +152,28 @@ const std::string NodeGraphHandler::HandleRequest(
     gfxutils::Printer printer;
     SetUpPrinter(args, &printer);
     return GetPrintString(&printer);
+  } else if (path == "nodes") {
+    *content_type = "application/json";
+    return GetNodesJson();
+  } else if (path == "children") {
+    const gfx::NodePtr node = FindNode(args);
+    if (node.Get()) {
+      *content_type = "application/json";
+      return GetChildrenJson(node);
+    }
+  } else if (path == "node") {
+    const gfx::NodePtr node = FindNode(args);
+    if (node.Get()) {
+      gfxutils::Printer printer;
+      SetUpPrinter(args, &printer);
+      printer.EnableChildPrinting(false);
+      std::ostringstream s;
+      printer.PrintScene(node, s);
+      return s.str();
+    }
+  } else if (path == "changes") {
+    *content_type = "application/json";
+    return GetChangesJson(args);
   } else {
     const std::string& data =
         base::ZipAssetManager::GetFileData("ion/nodegraph/" + path);
@@ -130,6 +232,137 @@ const std::string NodeGraphHandler::GetPrintString(gfxutils::Printer* printer) {
   return s.str();
 }
 
+uint64 NodeGraphHandler::GetNodeId(const gfx::NodePtr& node) {
+  base::LockGuard lock(&mutex_);
+  return GetNodeIdLocked(node);
+}
+
+uint64 NodeGraphHandler::GetVersion() const {
+  base::LockGuard lock(&mutex_);
+  return version_;
+}
+
+uint64 NodeGraphHandler::GetNodeIdLocked(const gfx::NodePtr& node) {
+  if (!node.Get())
+    return 0U;
+  NodeEntry& entry = entries_[node.Get()];
+  if (entry.id && entry.node.Acquire().Get() == node.Get())
+    return entry.id;
+  // The address was used by a Node that has been destroyed.
+  if (entry.id) {
+    nodes_by_id_.erase(entry.id);
+    changed_ids_.erase(entry.id);
+    removed_ids_[entry.id] = ++version_;
+  }
+  entry.id = next_id_++;
+  entry.node = NodeWeakPtr(node);
+  nodes_by_id_[entry.id] = node.Get();
+  node->AddReceiver(receiver_.Get());
+  return entry.id;
+}
+
+const gfx::NodePtr NodeGraphHandler::FindNode(
+    const HttpServer::QueryMap& args) {
+  HttpServer::QueryMap::const_iterator it = args.find("id");
+  if (it == args.end())
+    return gfx::NodePtr();
+  uint64 id = 0U;
+  std::istringstream in(it->second);
+  if (!(in >> id))
+    return gfx::NodePtr();
+
+  base::LockGuard lock(&mutex_);
+  std::map<uint64, const gfx::Node*>::const_iterator node_it =
+      nodes_by_id_.find(id);
+  if (node_it == nodes_by_id_.end())
+    return gfx::NodePtr();
+  return entries_[node_it->second].node.Acquire();
+}
+
+void NodeGraphHandler::AppendNodeSummaryLocked(const gfx::NodePtr& node,
+                                               std::ostream& str) {  // NOLINT
+  str << "{ \"id\": " << GetNodeIdLocked(node)
+      << ", \"label\": \"" << EscapeJson(node->GetLabel())
+      << "\", \"enabled\": " << (node->IsEnabled() ? "true" : "false")
+      << ", \"children\": " << node->GetChildren().size()
+      << ", \"shapes\": " << node->GetShapes().size()
+      << ", \"uniforms\": " << node->GetUniforms().size() << " }";
+}
+
+const std::string NodeGraphHandler::GetNodesJson() {
+  std::ostringstream str;
+  base::LockGuard lock(&mutex_);
+  str << "{ \"version\": " << version_ << ", \"nodes\": [";
+  for (size_t i = 0; i < nodes_.size(); ++i) {
+    str << (i ? ",\n  " : "\n  ");
+    AppendNodeSummaryLocked(nodes_[i], str);
+  }
+  str << (nodes_.empty() ? "] }\n" : "\n] }\n");
+  return str.str();
+}
+
+const std::string NodeGraphHandler::GetChildrenJson(const gfx::NodePtr& node) {
+  std::ostringstream str;
+  base::LockGuard lock(&mutex_);
+  const gfx::Node::NodeVector& children = node->GetChildren();
+  str << "{ \"version\": " << version_ << ", \"id\": "
+      << GetNodeIdLocked(node) << ", \"children\": [";
+  for (size_t i = 0; i < children.size(); ++i) {
+    str << (i ? ",\n  " : "\n  ");
+    AppendNodeSummaryLocked(children[i], str);
+  }
+  str << (children.empty() ? "] }\n" : "\n] }\n");
+  return str.str();
+}
+
+const std::string NodeGraphHandler::GetChangesJson(
+    const HttpServer::QueryMap& args) {
+  uint64 since = 0U;
+  HttpServer::QueryMap::const_iterator it = args.find("since");
+  if (it != args.end()) {
+    std::istringstream in(it->second);
+    in >> since;
+  }
+
+  std::ostringstream str;
+  base::LockGuard lock(&mutex_);
+  // Nodes do not send notifications when they are destroyed, so look for
+  // them here.
+  for (std::map<const gfx::Node*, NodeEntry>::iterator entry_it =
+           entries_.begin(); entry_it != entries_.end();) {
+    if (entry_it->second.node.Acquire().Get()) {
+      ++entry_it;
+    } else {
+      const uint64 id = entry_it->second.id;
+      nodes_by_id_.erase(id);
+      changed_ids_.erase(id);
+      removed_ids_[id] = ++version_;
+      entries_.erase(entry_it++);
+    }
+  }
+
+  str << "{ \"version\": " << version_ << ", \"nodes_changed\": "
+      << (roots_version_ > since ? "true" : "false") << ", \"changed\": ";
+  AppendIdsSince(changed_ids_, since, str);
+  str << ", \"removed\": ";
+  AppendIdsSince(removed_ids_, since, str);
+  str << " }\n";
+  return str.str();
+}
+
+void NodeGraphHandler::RecordChange(const gfx::Node* node) {
+  base::LockGuard lock(&mutex_);
+  ++version_;
+  if (!node) {
+    roots_version_ = version_;
+    return;
+  }
+  std::map<const gfx::Node*, NodeEntry>::const_iterator it =
+      entries_.find(node);
+  if (it != entries_.end())
+    changed_ids_[it->second.id] = version_;
+}
+
 }  // namespace remote
 }  // namespace ion
 
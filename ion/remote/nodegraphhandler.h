@@ -18,12 +18,16 @@ limitations under the License.
 #ifndef ION_REMOTE_NODEGRAPHHANDLER_H_
 #define ION_REMOTE_NODEGRAPHHANDLER_H_
 
+#include <map>
 #include <string>
 #include <vector>
 
+#include "base/integral_types.h"
+#include "ion/base/weakreferent.h"
 #include "ion/gfx/node.h"
 #include "ion/gfxutils/frame.h"
 #include "ion/gfxutils/printer.h"
+#include "ion/port/mutex.h"
 #include "ion/remote/httpserver.h"
 
 namespace ion {
@@ -34,6 +38,25 @@ namespace remote {
 //
 // /   or /index.html  - Display interface
 // /update             - Updates graphs for all currently-tracked nodes.
+//
+// Printing a large scene in full is slow, so the handler also serves it
+// incrementally. Each Node returned by these requests is given an ID that
+// stays the same for as long as the Node exists, and the handler receives
+// its change notifications (see gfx::Node).
+//
+// /nodes              - Returns JSON summaries of the tracked nodes.
+// /children?id=N      - Returns JSON summaries of the children of node N.
+// /node?id=N          - Prints node N without its children, using the same
+//                       options as /update.
+// /changes?since=V    - Returns the IDs of nodes whose subgraph changed and of
+//                       nodes that were destroyed after version V, and whether
+//                       the tracked nodes changed.
+//
+// Each JSON response contains the current "version", which is incremented by
+// every change; passing it to /changes returns only later changes. A summary
+// looks like:
+//   { "id": 3, "label": "Root", "enabled": true, "children": 2,
+//     "shapes": 1, "uniforms": 4 }
 class ION_API NodeGraphHandler : public HttpServer::RequestHandler {
  public:
   NodeGraphHandler();
@@ -58,11 +81,22 @@ class ION_API NodeGraphHandler : public HttpServer::RequestHandler {
   // Returns the number of nodes being tracked. (Useful for testing.)
   size_t GetTrackedNodeCount() const { return nodes_.size(); }
 
+  // Returns the ID of |node| in the incremental protocol, assigning one if it
+  // does not have one yet, or 0 if |node| is NULL.
+  uint64 GetNodeId(const gfx::NodePtr& node);
+
+  // Returns the current version of the incremental protocol.
+  uint64 GetVersion() const;
+
   const std::string HandleRequest(const std::string& path,
                                   const HttpServer::QueryMap& args,
                                   std::string* content_type) override;
 
  private:
+  // Receives the notifications of Nodes that have an ID.
+  class ChangeReceiver;
+  typedef base::WeakReferentPtr<gfx::Node> NodeWeakPtr;
+
   // Sets up a gfxutils::Printer from options in the QueryMap.
   void SetUpPrinter(const HttpServer::QueryMap& args,
                     gfxutils::Printer* printer);
@@ -70,10 +104,49 @@ class ION_API NodeGraphHandler : public HttpServer::RequestHandler {
   // Uses a gfxutils::Printer to generate the response data string.
   const std::string GetPrintString(gfxutils::Printer* printer);
 
+  // Returns the Node with the ID passed in the "id" query argument, or NULL if
+  // there is no such Node.
+  const gfx::NodePtr FindNode(const HttpServer::QueryMap& args);
+  // Returns the responses of the incremental protocol.
+  const std::string GetNodesJson();
+  const std::string GetChildrenJson(const gfx::NodePtr& node);
+  const std::string GetChangesJson(const HttpServer::QueryMap& args);
+  // Appends the JSON summary of |node| to |str|. Must be called with mutex_
+  // locked.
+  void AppendNodeSummaryLocked(const gfx::NodePtr& node,
+                               std::ostream& str);  // NOLINT
+  // Same as GetNodeId(), but must be called with mutex_ locked.
+  uint64 GetNodeIdLocked(const gfx::NodePtr& node);
+  // Records a change to the subgraph of |node|, or to the tracked nodes if
+  // it is NULL.
+  void RecordChange(const gfx::Node* node);
+
   // Nodes to print.
   std::vector<gfx::NodePtr> nodes_;
   // Optional Frame used to access frame counter.
   gfxutils::FramePtr frame_;
+
+  // An ID and a weak reference, which detects whether the address of a Node
+  // has been reused.
+  struct NodeEntry {
+    NodeEntry() : id(0U) {}
+    uint64 id;
+    NodeWeakPtr node;
+  };
+  // The IDs of the nodes that have been returned, by address and by ID.
+  std::map<const gfx::Node*, NodeEntry> entries_;
+  std::map<uint64, const gfx::Node*> nodes_by_id_;
+  // The version of the last change recorded for each ID, and of the nodes
+  // that were found to be destroyed.
+  std::map<uint64, uint64> changed_ids_;
+  std::map<uint64, uint64> removed_ids_;
+  // The version of the last change to the tracked nodes.
+  uint64 roots_version_;
+  uint64 version_;
+  uint64 next_id_;
+  base::ReferentPtr<ChangeReceiver>::Type receiver_;
+  // Guards all of the incremental protocol state.
+  mutable port::Mutex mutex_;
 };
 typedef base::ReferentPtr<NodeGraphHandler>::Type NodeGraphHandlerPtr;
 
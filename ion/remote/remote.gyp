@@ -47,6 +47,7 @@
 
       'sources': [
         'res/calltrace.iad',
+        'res/counters.iad',
         'res/nodegraph.iad',
         'res/resources.iad',
         'res/root.iad',
@@ -79,8 +80,12 @@
       'target_name' : 'ionremote',
 
       'sources': [
+        'allocationhandler.cc',
+        'allocationhandler.h',
         'calltracehandler.cc',
         'calltracehandler.h',
+        'counterhandler.cc',
+        'counterhandler.h',
         'httpserver.cc',
         'httpserver.h',
         'nodegraphhandler.cc',
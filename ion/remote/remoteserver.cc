@@ -19,13 +19,19 @@ limitations under the License.
 
 #if !ION_PRODUCTION
 
+#include <iomanip>
+#include <sstream>
+#include <string>
+
 #include "ion/base/invalid.h"
 #include "ion/base/logging.h"
 #include "ion/base/once.h"
+#include "ion/base/serialize.h"
 #include "ion/base/stringutils.h"
 #include "ion/base/zipassetmanager.h"
 #include "ion/base/zipassetmanagermacros.h"
 #include "ion/remote/calltracehandler.h"
+#include "ion/remote/counterhandler.h"
 #include "ion/remote/nodegraphhandler.h"
 #include "ion/remote/resourcehandler.h"
 #include "ion/remote/settinghandler.h"
@@ -44,7 +50,10 @@ namespace {
 
 #if !ION_PRODUCTION
 
-static const int kRemoteThreads = 8;
+// Connections are kept alive between requests, and each open connection holds
+// a thread until it closes or times out, so there are enough threads for the
+// connections that a few browser tabs keep open.
+static const int kRemoteThreads = 16;
 static const char kRootPage[] =
     "<!DOCTYPE html>"
     "<html>\n"
@@ -77,6 +86,92 @@ class IonRootHandler : public HttpServer::RequestHandler {
   }
 };
 
+// Escapes a string for use in JSON, including control characters.
+static const std::string EscapeJson(const std::string& str) {
+  std::ostringstream escaped;
+  for (size_t i = 0; i < str.length(); ++i) {
+    const char c = str[i];
+    if (c == '"' || c == '\\') {
+      escaped << '\\' << c;
+    } else if (c == '\n') {
+      escaped << "\\n";
+    } else if (c == '\r') {
+      escaped << "\\r";
+    } else if (c == '\t') {
+      escaped << "\\t";
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped << "\\u00" << std::hex << std::setw(2) << std::setfill('0')
+              << static_cast<int>(c) << std::dec;
+    } else {
+      escaped << c;
+    }
+  }
+  return escaped.str();
+}
+
+// Returns whether data of the passed content type can be sent as a JSON string
+// rather than being Base64-encoded.
+static bool IsTextType(const std::string& content_type) {
+  const std::string type = content_type.substr(0, content_type.find(';'));
+  return base::StartsWith(type, "text/") ||
+         type == "application/javascript" ||
+         type == "application/x-javascript" ||
+         type == "application/json" || type == "application/xml" ||
+         type == "image/svg+xml";
+}
+
+// Answers several requests to other handlers of the server in a single round
+// trip. The URIs to request are passed in query or form arguments named by
+// their indices, starting at 0, e.g., /ion/batch?0=<uri>&1=<uri>, with each
+// URI URL-encoded. The response is a JSON array with an object for each
+// request in order:
+//   { "uri": <uri>, "status": 200 or 404, "content_type": <type>,
+//     "encoding": "text" or "base64", "data": <data> }
+// Binary data is Base64-encoded.
+class BatchHandler : public HttpServer::RequestHandler {
+ public:
+  explicit BatchHandler(const HttpServer* server)
+      : RequestHandler("/ion/batch"), server_(server) {}
+  ~BatchHandler() override {}
+
+  const std::string HandleRequest(const std::string& path_in,
+                                  const HttpServer::QueryMap& args,
+                                  std::string* content_type) override {
+    if (!path_in.empty())
+      return std::string();
+    *content_type = "application/json";
+    std::ostringstream str;
+    str << "[";
+    for (size_t i = 0;; ++i) {
+      const HttpServer::QueryMap::const_iterator it =
+          args.find(base::ValueToString(i));
+      if (it == args.end())
+        break;
+      const std::string& uri = it->second;
+      std::string data;
+      std::string type;
+      // Batches may not contain other batches.
+      if (!base::StartsWith(base::StartsWith(uri, "/") ? uri : '/' + uri,
+                            GetBasePath()))
+        data = server_->GetUriData(uri, &type);
+      const bool is_text = IsTextType(type);
+      str << (i ? ",\n" : "\n") << "  {\"uri\": \"" << EscapeJson(uri)
+          << "\", \"status\": " << (data.empty() ? 404 : 200)
+          << ", \"content_type\": \"" << EscapeJson(type)
+          << "\", \"encoding\": \"" << (is_text ? "text" : "base64")
+          << "\", \"data\": \""
+          << (is_text ? EscapeJson(data) : base::MimeBase64EncodeString(data))
+          << "\"}";
+    }
+    str << (args.count("0") ? "\n]\n" : "]\n");
+    return str.str();
+  }
+
+ private:
+  // The server owns this handler, so it outlives it.
+  const HttpServer* server_;
+};
+
 // Override / to redirect to /ion so that when clients connect to the root they
 // will not get a 404.
 class RootHandler : public HttpServer::RequestHandler {
@@ -130,6 +225,9 @@ RemoteServer::RemoteServer(
   RegisterHandler(
       HttpServer::RequestHandlerPtr(
           new CallTraceHandler()));
+  RegisterHandler(
+      HttpServer::RequestHandlerPtr(
+          new CounterHandler(frame, renderer)));
   RegisterHandler(
       HttpServer::RequestHandlerPtr(
           new ResourceHandler(renderer)));
@@ -156,6 +254,7 @@ void RemoteServer::Init(int port) {
       "<span><a href=\"/ion/shaders/shader_editor\">Shader editor</a></span>\n"
       "<span><a href=\"/ion/nodegraph\">Node graph display</a></span>\n"
       "<span><a href=\"/ion/tracing\">OpenGL tracing</a></span>\n"
+      "<span><a href=\"/ion/counters\">Performance counters</a></span>\n"
       "<span><a href=\"/ion/profile\">Run-time profile "
       "diagram</a></span></div>\n";
 
@@ -169,6 +268,8 @@ void RemoteServer::Init(int port) {
         HttpServer::RequestHandlerPtr(new(base::kLongTerm) RootHandler));
     RegisterHandler(
         HttpServer::RequestHandlerPtr(new(base::kLongTerm) IonRootHandler));
+    RegisterHandler(
+        HttpServer::RequestHandlerPtr(new(base::kLongTerm) BatchHandler(this)));
   }
 #endif
 }
@@ -0,0 +1,139 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+// The number of frames that the statistics and graph are computed over.
+var kHistoryLength = 120;
+
+// The counter names, in the order they are sent, and the recent values of
+// each counter.
+var counterNames = [];
+var history = [];
+var socket = null;
+
+// Returns a value formatted for display.
+function formatValue(value) {
+  return Math.round(value) == value ? value.toString() : value.toFixed(3);
+}
+
+// Creates a row in the counter table for each counter.
+function createRows() {
+  var body = $('#counters tbody');
+  body.empty();
+  history = [];
+  for (var i = 0; i < counterNames.length; ++i) {
+    history.push([]);
+    body.append('<tr><td>' + counterNames[i] + '</td><td></td><td></td>' +
+                '<td></td><td></td></tr>');
+  }
+}
+
+// Draws the recent frame times and intervals.
+function drawGraph() {
+  var canvas = document.getElementById('frame_time_graph');
+  var context = canvas.getContext('2d');
+  context.clearRect(0, 0, canvas.width, canvas.height);
+  var series = [[counterNames.indexOf('frame_interval_ms'), '#aaa'],
+                [counterNames.indexOf('frame_time_ms'), '#00f']];
+  // Scale the graph so that at least 33 ms is visible.
+  var max = 33.0;
+  for (var s = 0; s < series.length; ++s) {
+    var values = history[series[s][0]] || [];
+    for (var i = 0; i < values.length; ++i)
+      max = Math.max(max, values[i]);
+  }
+  var step = canvas.width / (kHistoryLength - 1);
+  for (var s = 0; s < series.length; ++s) {
+    var values = history[series[s][0]] || [];
+    context.strokeStyle = series[s][1];
+    context.beginPath();
+    for (var i = 0; i < values.length; ++i) {
+      var y = canvas.height * (1.0 - values[i] / max);
+      if (i == 0)
+        context.moveTo(i * step, y);
+      else
+        context.lineTo(i * step, y);
+    }
+    context.stroke();
+  }
+}
+
+// Decodes a binary frame of counters and updates the display.
+function receiveFrame(event) {
+  var view = new DataView(event.data);
+  var count = Math.min(view.getUint32(4, true), counterNames.length);
+  var rows = $('#counters tbody tr');
+  for (var i = 0; i < count; ++i) {
+    var values = history[i];
+    values.push(view.getFloat64(8 + 8 * i, true));
+    if (values.length > kHistoryLength)
+      values.shift();
+    var min = values[0];
+    var max = values[0];
+    var sum = 0.0;
+    for (var j = 0; j < values.length; ++j) {
+      min = Math.min(min, values[j]);
+      max = Math.max(max, values[j]);
+      sum += values[j];
+    }
+    var cells = rows.eq(i).children();
+    cells.eq(1).text(formatValue(values[values.length - 1]));
+    cells.eq(2).text(formatValue(min));
+    cells.eq(3).text(formatValue(sum / values.length));
+    cells.eq(4).text(formatValue(max));
+  }
+  drawGraph();
+}
+
+// Returns the number of frames between updates entered by the user.
+function getFrameInterval() {
+  return Math.max(1, parseInt($('#frames').val()) || 1);
+}
+
+// Opens or closes the websocket connection.
+function toggleConnection() {
+  if (socket) {
+    socket.close();
+    return;
+  }
+  socket = new WebSocket('ws://' + window.location.host +
+                         '/ion/counters/stream?frames=' + getFrameInterval());
+  socket.binaryType = 'arraybuffer';
+  socket.onopen = function() {
+    $('#status').text('Connected');
+    $('#connect').text('Disconnect');
+    createRows();
+  };
+  socket.onclose = function() {
+    socket = null;
+    $('#status').text('Disconnected');
+    $('#connect').text('Connect');
+  };
+  socket.onmessage = receiveFrame;
+}
+
+jQuery(document).ready(function() {
+  getUri({
+    url: '/ion/counters/names',
+    success: function(text) {
+      counterNames = JSON.parse(text);
+      createRows();
+    }});
+  $('#connect').click(toggleConnection);
+  $('#frames').change(function() {
+    if (socket && socket.readyState == WebSocket.OPEN)
+      socket.send(getFrameInterval().toString());
+  });
+});
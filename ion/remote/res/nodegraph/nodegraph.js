@@ -15,6 +15,156 @@ limitations under the License.
 
 */
 
+// State of the incremental browser: the protocol version that the displayed
+// tree is up to date with, the selected node, and the timer that polls for
+// changes.
+var browserVersion = 0;
+var selectedNodeId = 0;
+var changeTimer = null;
+
+// Returns the query arguments for printing, shared by /update and /node.
+function getPrintOptions() {
+  return {
+    format: $('#format').val(),
+    enable_address_printing:
+        $('#address_printing').hasClass('button_toggled'),
+    enable_full_shape_printing:
+        $('#full_shape_printing').hasClass('button_toggled')
+  };
+}
+
+// Returns a list item for a node summary returned by the server.
+function createNodeItem(summary) {
+  var item = $('<li></li>').attr('data-id', summary.id);
+  var toggle = $('<span class="browser_toggle"></span>');
+  if (summary.children > 0)
+    toggle.text('+').click(function() { toggleNode(item); });
+  var label = $('<span class="browser_label"></span>')
+      .text(summary.label || 'Node ' + summary.id)
+      .click(function() { selectNode(summary.id); });
+  if (summary.id == selectedNodeId)
+    label.addClass('selected');
+  var info = $('<span class="browser_info"></span>').text(
+      ' ' + (summary.enabled ? '' : 'disabled, ') + summary.children +
+      ' children, ' + summary.shapes + ' shapes, ' + summary.uniforms +
+      ' uniforms');
+  item.append(toggle, label, info);
+  return item;
+}
+
+// Replaces the child list of |item| with the node's current children.
+function loadChildren(item) {
+  getUri({
+    url: '/ion/nodegraph/children',
+    data: { id: item.attr('data-id') },
+    success: function(text) {
+      var response = JSON.parse(text);
+      var list = $('<ul></ul>');
+      for (var i = 0; i < response.children.length; ++i)
+        list.append(createNodeItem(response.children[i]));
+      item.children('ul').remove();
+      item.append(list);
+      item.children('.browser_toggle').text('-');
+    }});
+}
+
+// Expands or collapses a node.
+function toggleNode(item) {
+  if (item.children('ul').length) {
+    item.children('ul').remove();
+    item.children('.browser_toggle').text('+');
+  } else {
+    loadChildren(item);
+  }
+}
+
+// Shows the contents of a node.
+function selectNode(id) {
+  selectedNodeId = id;
+  $('.browser_label').removeClass('selected');
+  $('li[data-id="' + id + '"] > .browser_label').addClass('selected');
+  var options = getPrintOptions();
+  options.id = id;
+  getUri({
+    url: '/ion/nodegraph/node',
+    data: options,
+    success: function(text) {
+      var details = $('#node_details');
+      if (options.format == 'HTML')
+        details.html('<div class="tree">' + text + '</div>');
+      else
+        details.html($('<pre></pre>').text(text));
+    }});
+}
+
+// Loads the tracked nodes, keeping which of them are expanded.
+function loadRoots() {
+  getUri({
+    url: '/ion/nodegraph/nodes',
+    success: function(text) {
+      var response = JSON.parse(text);
+      var tree = $('#browser_tree');
+      var expanded = {};
+      tree.children('li').each(function() {
+        if ($(this).children('ul').length)
+          expanded[$(this).attr('data-id')] = $(this).children('ul');
+      });
+      tree.empty();
+      for (var i = 0; i < response.nodes.length; ++i) {
+        var item = createNodeItem(response.nodes[i]);
+        var list = expanded[response.nodes[i].id];
+        if (list) {
+          item.append(list);
+          item.children('.browser_toggle').text('-');
+        }
+        tree.append(item);
+      }
+      browserVersion = Math.max(browserVersion, response.version);
+    }});
+}
+
+// Updates the parts of the displayed tree that changed on the server.
+function pollChanges() {
+  getUri({
+    url: '/ion/nodegraph/changes',
+    data: { since: browserVersion },
+    success: function(text) {
+      var response = JSON.parse(text);
+      browserVersion = response.version;
+      for (var i = 0; i < response.removed.length; ++i)
+        $('li[data-id="' + response.removed[i] + '"]').remove();
+      if (response.nodes_changed)
+        loadRoots();
+      for (var i = 0; i < response.changed.length; ++i) {
+        var id = response.changed[i];
+        // Only expanded nodes need their children reloaded.
+        $('li[data-id="' + id + '"]').each(function() {
+          if ($(this).children('ul').length)
+            loadChildren($(this));
+        });
+        if (id == selectedNodeId)
+          selectNode(id);
+      }
+    }});
+}
+
+function startBrowsing() {
+  $('#nodes').html('');
+  $('#browser').show();
+  browserVersion = 0;
+  loadRoots();
+  if (!changeTimer)
+    changeTimer = setInterval(pollChanges, 1000);
+}
+
+function stopBrowsing() {
+  if (changeTimer) {
+    clearInterval(changeTimer);
+    changeTimer = null;
+  }
+  $('#browser').hide();
+}
+
 jQuery(document).ready(function() {
   $('#address_printing').click(function() {
     var button = $('#address_printing');
@@ -36,16 +186,13 @@ jQuery(document).ready(function() {
     }
   });
 
+  $('#browse').click(startBrowsing);
+
   $('#update').click(function() {
+    stopBrowsing();
     getUri({
       url: '/ion/nodegraph/update',
-      data: {
-        format: $('#format').val(),
-        enable_address_printing:
-            $('#address_printing').hasClass('button_toggled'),
-        enable_full_shape_printing:
-            $('#full_shape_printing').hasClass('button_toggled')
-      },
+      data: getPrintOptions(),
       success: function(text) {
         var nodes = $('#nodes');
         nodes.html(text);
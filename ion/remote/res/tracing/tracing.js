@@ -30,6 +30,25 @@ jQuery(document).ready(function() {
         trace.html(text);
       }});
   });
+  $('#call_statistics_next_frame').click(function() {
+    getUri({
+      url: '/ion/tracing/call_statistics_next_frame',
+      success: function(text) {
+        var stats = JSON.parse(text);
+        var html = '<span class="trace_header">OpenGL call statistics at ' +
+            'frame ' + stats.frame + '</span><br><br>\n<table>\n';
+        var keys = ['call_count', 'draw_call_count', 'primitive_count',
+                    'buffer_upload_bytes', 'texture_upload_bytes'];
+        for (var i = 0; i < keys.length; ++i)
+          html += '<tr><td>' + keys[i] + '</td><td>' + stats[keys[i]] +
+              '</td></tr>\n';
+        for (var name in stats.functions)
+          html += '<tr><td><span class="trace_function">' + name +
+              '</span></td><td>' + stats.functions[name] + '</td></tr>\n';
+        html += '</table>\n';
+        $('#trace').html(html);
+      }});
+  });
   $('#clear').click(function() {
     getUri({url: '/ion/tracing/clear',
       success: function(text) {
@@ -19,12 +19,16 @@ limitations under the License.
 
 #include "ion/remote/resourcehandler.h"
 
+#include <algorithm>
+#include <deque>
+#include <map>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include "ion/base/allocator.h"
 #include "ion/base/invalid.h"
+#include "ion/base/lockguards.h"
 #include "ion/base/stringutils.h"
 #include "ion/base/zipassetmanager.h"
 #include "ion/base/zipassetmanagermacros.h"
@@ -33,7 +37,10 @@ limitations under the License.
 #include "ion/gfx/tracinghelper.h"
 #include "ion/gfxutils/resourcecallback.h"
 #include "ion/image/conversionutils.h"
+#include "ion/image/jpegencoder.h"
 #include "ion/image/renderutils.h"
+#include "ion/image/resampleutils.h"
+#include "ion/port/mutex.h"
 
 ION_REGISTER_ASSETS(IonRemoteResourcesRoot);
 
@@ -107,6 +114,57 @@ class Indent {
   const size_t spaces_;
 };
 
+// Options for encoding texture images, parsed from texture_data query args.
+struct PreviewOptions {
+  PreviewOptions()
+      : max_size(0U),
+        format(image::kPng),
+        quality(image::kDefaultJpegQuality) {}
+  // The largest width or height of the image, or 0 for the texture's size.
+  uint32 max_size;
+  image::ExternalImageFormat format;
+  // The quality of JPEG images.
+  int quality;
+};
+
+static const PreviewOptions GetPreviewOptions(
+    const HttpServer::QueryMap& args) {
+  PreviewOptions options;
+  HttpServer::QueryMap::const_iterator it = args.find("size");
+  if (it != args.end())
+    options.max_size =
+        static_cast<uint32>(std::max(0, base::StringToInt32(it->second)));
+  it = args.find("format");
+  if (it != args.end() && (it->second == "jpeg" || it->second == "jpg"))
+    options.format = image::kJpeg;
+  it = args.find("quality");
+  if (it != args.end())
+    options.quality = base::StringToInt32(it->second);
+  return options;
+}
+
+// Returns the size of a preview of a |width| x |height| image whose larger
+// dimension is at most |max_size|, keeping the aspect ratio. A |max_size| of 0
+// means no limit.
+static void GetPreviewSize(uint32 width, uint32 height, uint32 max_size,
+                           uint32* preview_width, uint32* preview_height) {
+  *preview_width = width;
+  *preview_height = height;
+  if (max_size && (width > max_size || height > max_size)) {
+    if (width >= height) {
+      *preview_width = max_size;
+      *preview_height = std::max(
+          1U, static_cast<uint32>((static_cast<uint64>(height) * max_size +
+                                   width / 2U) / width));
+    } else {
+      *preview_height = max_size;
+      *preview_width = std::max(
+          1U, static_cast<uint32>((static_cast<uint64>(width) * max_size +
+                                   height / 2U) / height));
+    }
+  }
+}
+
 // Escapes ", \, and \n.
 static const std::string EscapeJson(const std::string& str) {
   std::string ret = base::ReplaceString(str, "\\", "\\\\");
@@ -119,7 +177,9 @@ static const std::string EscapeJson(const std::string& str) {
 //
 // Helper class derived from TextureImageCallback that first renders textures
 // into images so that the images show up correctly regardless of whether the
-// textures' images had data wiped.
+// textures' images had data wiped. When waiting for the Renderer, the faces of
+// a CubeMapTexture are rendered one per processing of info requests, so that
+// a single request does not stall a frame for six renders and read backs.
 //
 //-----------------------------------------------------------------------------
 
@@ -127,9 +187,16 @@ class RenderTextureCallback : public TextureImageCallback {
  public:
   typedef base::ReferentPtr<RenderTextureCallback>::Type RefPtr;
 
-  RenderTextureCallback(const RendererPtr& renderer, bool do_wait)
+  // Images are rendered at most |max_size| pixels wide and high, unless it is
+  // 0. |id| is the OpenGL ID of the requested texture.
+  RenderTextureCallback(const RendererPtr& renderer, GLuint id,
+                        uint32 max_size, bool do_wait)
       : TextureImageCallback(do_wait),
-        renderer_(renderer) {}
+        renderer_(renderer),
+        id_(id),
+        max_size_(max_size),
+        spread_faces_(do_wait),
+        next_face_(0) {}
 
   // Renders texture images and then calls the version in the base class.
   void Callback(const std::vector<TextureImageInfo>& data);
@@ -143,9 +210,22 @@ class RenderTextureCallback : public TextureImageCallback {
   void RenderTextureImage(const RendererPtr& renderer, TextureImageInfo* info);
   void RenderCubeMapTextureImages(const RendererPtr& renderer,
                                   TextureImageInfo* info);
+  // Renders the face |face| of the CubeMapTexture in |info|, replacing its
+  // image.
+  void RenderCubeMapTextureFaceImage(const RendererPtr& renderer, int face,
+                                     TextureImageInfo* info);
 
   // Renderer used to render images.
   const RendererPtr& renderer_;
+  // The OpenGL ID of the texture.
+  const GLuint id_;
+  // The largest dimension of rendered images.
+  const uint32 max_size_;
+  // Whether cube map faces are rendered in separate calls to Callback().
+  const bool spread_faces_;
+  // The cube map being rendered face by face, and the next face to render.
+  TextureImageInfo cube_map_info_;
+  int next_face_;
 };
 
 void RenderTextureCallback::Callback(
@@ -159,6 +239,28 @@ void RenderTextureCallback::Callback(
       renderer_->GetFlags().test(Renderer::kProcessInfoRequests);
   renderer_->ClearFlag(Renderer::kProcessInfoRequests);
 
+  // Continue rendering a cube map one face at a time. The data passed to
+  // later calls is ignored, since the texture is already held.
+  if (next_face_ == 0 && spread_faces_ && data.size() == 1U &&
+      data[0].texture.Get() &&
+      data[0].texture->GetTextureType() == TextureBase::kCubeMapTexture)
+    cube_map_info_ = data[0];
+  if (cube_map_info_.texture.Get()) {
+    RenderCubeMapTextureFaceImage(renderer_, next_face_++, &cube_map_info_);
+    if (flag_was_set)
+      renderer_->SetFlag(Renderer::kProcessInfoRequests);
+    if (next_face_ < 6) {
+      // Requests made from a callback are processed the next time requests
+      // are, which is usually the next frame.
+      renderer_->GetResourceManager()->RequestTextureImage(
+          id_, std::bind(&RenderTextureCallback::Callback, this, _1));
+    } else {
+      TextureImageCallback::Callback(
+          std::vector<TextureImageInfo>(1U, cube_map_info_));
+    }
+    return;
+  }
+
   // If any of the returned images is missing data, render it into an image.
   std::vector<TextureImageInfo> new_data = data;
   const size_t data_count = new_data.size();
@@ -190,8 +292,12 @@ void RenderTextureCallback::RenderTextureImage(
     TexturePtr tex(static_cast<Texture*>(info->texture.Get()));
     const base::AllocatorPtr& sta =
         tex->GetAllocator()->GetAllocatorForLifetime(base::kShortTerm);
-    ImagePtr output_image = image::RenderTextureImage(
-        tex, input_image->GetWidth(), input_image->GetHeight(), renderer, sta);
+    // Rendering straight to the preview size also keeps the read back small.
+    uint32 width, height;
+    GetPreviewSize(input_image->GetWidth(), input_image->GetHeight(),
+                   max_size_, &width, &height);
+    ImagePtr output_image =
+        image::RenderTextureImage(tex, width, height, renderer, sta);
     if (output_image.Get())
       info->images[0] = output_image;
   }
@@ -199,24 +305,30 @@ void RenderTextureCallback::RenderTextureImage(
 
 void RenderTextureCallback::RenderCubeMapTextureImages(
     const RendererPtr& renderer, TextureImageInfo* info) {
+  for (int i = 0; i < 6; ++i)
+    RenderCubeMapTextureFaceImage(renderer, i, info);
+}
+
+void RenderTextureCallback::RenderCubeMapTextureFaceImage(
+    const RendererPtr& renderer, int face, TextureImageInfo* info) {
   DCHECK(info);
   DCHECK_EQ(info->texture->GetTextureType(), TextureBase::kCubeMapTexture);
   DCHECK_EQ(info->images.size(), 6U);
+  DCHECK_LE(0, face);
+  DCHECK_GT(6, face);
 
   CubeMapTexturePtr tex(static_cast<CubeMapTexture*>(info->texture.Get()));
   const base::AllocatorPtr& sta =
       tex->GetAllocator()->GetAllocatorForLifetime(base::kShortTerm);
-  for (int i = 0; i < 6; ++i) {
-    const ImagePtr& input_image = info->images[i];
-    const CubeMapTexture::CubeFace face =
-        static_cast<CubeMapTexture::CubeFace>(i);
-    ImagePtr output_image =
-        image::RenderCubeMapTextureFaceImage(
-            tex, face, input_image->GetWidth(), input_image->GetHeight(),
-            renderer, sta);
-    if (output_image.Get())
-      info->images[i] = output_image;
-  }
+  const ImagePtr& input_image = info->images[face];
+  uint32 width, height;
+  GetPreviewSize(input_image->GetWidth(), input_image->GetHeight(), max_size_,
+                 &width, &height);
+  ImagePtr output_image = image::RenderCubeMapTextureFaceImage(
+      tex, static_cast<CubeMapTexture::CubeFace>(face), width, height,
+      renderer, sta);
+  if (output_image.Get())
+    info->images[face] = output_image;
 }
 
 //-----------------------------------------------------------------------------
@@ -848,18 +960,40 @@ static void WriteFaceIntoCubeMap(uint32 x_offset,
   }
 }
 
-// Returns a string that contains PNG data for the ID passed as a query arg.
-static const std::string GetTextureData(const RendererPtr& renderer,
-                                        const HttpServer::QueryMap& args,
-                                        bool wait_for_completion) {
-  std::string data;
+// Returns |image| shrunk on the CPU if its larger dimension exceeds
+// |max_size|, which happens if it could not be rendered at the preview size.
+static const ImagePtr ShrinkToPreviewSize(const ImagePtr& image,
+                                          uint32 max_size) {
+  uint32 width, height;
+  GetPreviewSize(image->GetWidth(), image->GetHeight(), max_size, &width,
+                 &height);
+  if ((width == image->GetWidth() && height == image->GetHeight()) ||
+      !image::IsResamplingSupported(image->GetFormat()))
+    return image;
+  const ImagePtr shrunk = image::ResampleImage(
+      image, width, height, image::kBoxFilter, false,
+      image->GetAllocator()->GetAllocatorForLifetime(base::kShortTerm), NULL);
+  return shrunk.Get() ? shrunk : image;
+}
+
+// Returns an image of the texture whose ID is passed as a query arg, or a NULL
+// pointer if there is no such texture. Cube maps are returned as a vertical
+// cross of their faces. Images are at most |max_size| pixels wide and high,
+// unless it is 0. |flip_vertically| is set if the image must be flipped to
+// counteract OpenGL rendering.
+static const ImagePtr GetTextureImage(const RendererPtr& renderer,
+                                      const HttpServer::QueryMap& args,
+                                      uint32 max_size,
+                                      bool wait_for_completion,
+                                      bool* flip_vertically) {
+  ImagePtr result;
   HttpServer::QueryMap::const_iterator id_it = args.find("id");
   if (id_it != args.end()) {
     if (GLuint id = static_cast<GLuint>(base::StringToInt32(id_it->second))) {
       // Request the info.
       ResourceManager* manager = renderer->GetResourceManager();
-      RenderTextureCallback::RefPtr callback(
-          new RenderTextureCallback(renderer, wait_for_completion));
+      RenderTextureCallback::RefPtr callback(new RenderTextureCallback(
+          renderer, id, max_size, wait_for_completion));
       manager->RequestTextureImage(
           id, std::bind(&RenderTextureCallback::Callback, callback.Get(), _1));
       if (!wait_for_completion)
@@ -872,20 +1006,19 @@ static const std::string GetTextureData(const RendererPtr& renderer,
       // There should only be one info, and it contains the texture image.
       if (infos.size() && infos[0].images.size()) {
         if (infos[0].images.size() == 1U) {
-          // Convert the image to png. Flip Y to counteract OpenGL rendering.
-          const std::vector<uint8> png_data = image::ConvertToExternalImageData(
-              infos[0].images[0], image::kPng, true);
-          data = base::MimeBase64EncodeString(
-              std::string(png_data.begin(), png_data.end()));
+          // Flip Y to counteract OpenGL rendering.
+          result = ShrinkToPreviewSize(infos[0].images[0], max_size);
+          *flip_vertically = true;
         } else {
           // Make a vertical cube map cross image.
           DCHECK_EQ(6U, infos[0].images.size());
+          ImagePtr faces[6];
           uint32 face_width = 0;
           uint32 face_height = 0;
           for (int i = 0; i < 6; ++i) {
-            face_width = std::max(face_width, infos[0].images[0]->GetWidth());
-            face_height =
-                std::max(face_height, infos[0].images[0]->GetHeight());
+            faces[i] = ShrinkToPreviewSize(infos[0].images[i], max_size);
+            face_width = std::max(face_width, faces[i]->GetWidth());
+            face_height = std::max(face_height, faces[i]->GetHeight());
           }
 
           // Allocate the data.
@@ -908,32 +1041,115 @@ static const std::string GetTextureData(const RendererPtr& renderer,
           //     ----
           //     |-Z|
           //     ----
-          WriteFaceIntoCubeMap(face_width, 0U, infos[0].images[4], cubemap);
-          WriteFaceIntoCubeMap(0U, face_height, infos[0].images[0], cubemap);
-          WriteFaceIntoCubeMap(
-              face_width, face_height, infos[0].images[5], cubemap);
-          WriteFaceIntoCubeMap(
-              face_width * 2U, face_height, infos[0].images[3], cubemap);
+          WriteFaceIntoCubeMap(face_width, 0U, faces[4], cubemap);
+          WriteFaceIntoCubeMap(0U, face_height, faces[0], cubemap);
+          WriteFaceIntoCubeMap(face_width, face_height, faces[5], cubemap);
           WriteFaceIntoCubeMap(
-              face_width, face_height * 2U, infos[0].images[1], cubemap);
-          WriteFaceIntoCubeMap(
-              face_width, face_height * 3U, infos[0].images[2], cubemap);
-
-          // Send the image back.
-          const std::vector<uint8> png_data =
-              image::ConvertToExternalImageData(cubemap, image::kPng, false);
-          data = base::MimeBase64EncodeString(
-              std::string(png_data.begin(), png_data.end()));
+              face_width * 2U, face_height, faces[3], cubemap);
+          WriteFaceIntoCubeMap(face_width, face_height * 2U, faces[1], cubemap);
+          WriteFaceIntoCubeMap(face_width, face_height * 3U, faces[2], cubemap);
+          result = cubemap;
+          *flip_vertically = false;
         }
       }
     }
   }
 
-  return data;
+  return result;
+}
+
+// Returns a hash of the contents of |image| and the way it is encoded.
+static uint64 GetPreviewKey(const Image& image, const PreviewOptions& options,
+                            bool flip_vertically) {
+  // FNV-1a.
+  uint64 hash = 14695981039346656037ULL;
+  const uint64 kPrime = 1099511628211ULL;
+  const uint32 header[] = {
+      image.GetWidth(), image.GetHeight(),
+      static_cast<uint32>(image.GetFormat()),
+      static_cast<uint32>(options.format),
+      static_cast<uint32>(options.quality), flip_vertically ? 1U : 0U };
+  const uint8* bytes = reinterpret_cast<const uint8*>(header);
+  for (size_t i = 0; i < sizeof(header); ++i)
+    hash = (hash ^ bytes[i]) * kPrime;
+  bytes = image.GetData()->GetData<uint8>();
+  const size_t size = image.GetDataSize();
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ bytes[i]) * kPrime;
+  return hash;
 }
 
 }  // anonymous namespace
 
+//-----------------------------------------------------------------------------
+//
+// ResourceHandler::PreviewCache class.
+//
+//-----------------------------------------------------------------------------
+
+// Caches the Base64-encoded data of recently requested texture images by their
+// contents. The oldest entries are evicted once the cached data exceeds a
+// fixed size. Images are encoded outside of the lock, so concurrent requests
+// for different textures do not wait on each other.
+class ResourceHandler::PreviewCache {
+ public:
+  PreviewCache() : cached_bytes_(0U) {}
+
+  // Returns |image| encoded as described by |options|, either from the cache
+  // or by encoding and caching it.
+  const std::string GetEncodedImage(const ImagePtr& image,
+                                    const PreviewOptions& options,
+                                    bool flip_vertically);
+
+ private:
+  // The most data kept in the cache, in bytes.
+  static const size_t kMaxCachedBytes = 16U * 1024U * 1024U;
+
+  port::Mutex mutex_;
+  std::map<uint64, std::string> entries_;
+  // Keys of |entries_|, oldest first.
+  std::deque<uint64> keys_;
+  size_t cached_bytes_;
+};
+
+const std::string ResourceHandler::PreviewCache::GetEncodedImage(
+    const ImagePtr& image, const PreviewOptions& options,
+    bool flip_vertically) {
+  if (!image.Get() || !image->GetData().Get() || !image->GetData()->GetData())
+    return std::string();
+  const uint64 key = GetPreviewKey(*image, options, flip_vertically);
+  {
+    base::LockGuard lock(&mutex_);
+    std::map<uint64, std::string>::const_iterator it = entries_.find(key);
+    if (it != entries_.end())
+      return it->second;
+  }
+
+  const std::vector<uint8> encoded =
+      options.format == image::kJpeg
+          ? image::EncodeJpeg(*image, options.quality, flip_vertically)
+          : image::ConvertToExternalImageData(image, options.format,
+                                              flip_vertically);
+  const std::string data = base::MimeBase64EncodeString(
+      std::string(encoded.begin(), encoded.end()));
+  if (data.empty() || data.size() > kMaxCachedBytes)
+    return data;
+
+  base::LockGuard lock(&mutex_);
+  if (entries_.insert(std::make_pair(key, data)).second) {
+    keys_.push_back(key);
+    cached_bytes_ += data.size();
+    while (cached_bytes_ > kMaxCachedBytes) {
+      std::map<uint64, std::string>::iterator oldest =
+          entries_.find(keys_.front());
+      cached_bytes_ -= oldest->second.size();
+      entries_.erase(oldest);
+      keys_.pop_front();
+    }
+  }
+  return data;
+}
+
 //-----------------------------------------------------------------------------
 //
 // ResourceHandler functions.
@@ -942,7 +1158,8 @@ static const std::string GetTextureData(const RendererPtr& renderer,
 
 ResourceHandler::ResourceHandler(const gfx::RendererPtr& renderer)
     : HttpServer::RequestHandler("/ion/resources"),
-      renderer_(renderer) {
+      renderer_(renderer),
+      preview_cache_(new PreviewCache) {
   IonRemoteResourcesRoot::RegisterAssetsOnce();
 }
 
@@ -959,9 +1176,13 @@ const std::string ResourceHandler::HandleRequest(
     *content_type = "application/json";
     return GetResourceList(renderer_, args);
   } else if (path == "texture_data") {
-    *content_type = "image/png";
-    return GetTextureData(
-        renderer_, args, args.find("nonblocking") == args.end());
+    const PreviewOptions options = GetPreviewOptions(args);
+    *content_type = options.format == image::kJpeg ? "image/jpeg" : "image/png";
+    bool flip_vertically = false;
+    const ImagePtr image = GetTextureImage(
+        renderer_, args, options.max_size,
+        args.find("nonblocking") == args.end(), &flip_vertically);
+    return preview_cache_->GetEncodedImage(image, options, flip_vertically);
   } else {
     const std::string& data = base::ZipAssetManager::GetFileData(
         "ion/resources/" + path);
@@ -18,6 +18,7 @@ limitations under the License.
 #ifndef ION_REMOTE_RESOURCEHANDLER_H_
 #define ION_REMOTE_RESOURCEHANDLER_H_
 
+#include <memory>
 #include <string>
 
 #include "ion/gfx/renderer.h"
@@ -33,7 +34,12 @@ namespace remote {
 //                       - Gets a JSON struct representing all of the GL
 //                             resources of the queried types
 // /texture_data&id=#    - Gets a PNG image of the texture with the passed
-//                             OpenGL texture ID
+//                             OpenGL texture ID. Optional args are size=#,
+//                             which renders a preview whose larger dimension
+//                             is at most # pixels, format=jpeg to get a JPEG
+//                             image instead, and quality=# for the JPEG
+//                             quality. Recently encoded images are cached by
+//                             their contents.
 class ION_API ResourceHandler : public HttpServer::RequestHandler {
  public:
   explicit ResourceHandler(const gfx::RendererPtr& renderer);
@@ -44,7 +50,12 @@ class ION_API ResourceHandler : public HttpServer::RequestHandler {
                                   std::string* content_type) override;
 
  private:
+  class PreviewCache;
+
   gfx::RendererPtr renderer_;
+  // Encoded texture images, so that refreshing the resource inspector does not
+  // re-encode textures that have not changed.
+  std::unique_ptr<PreviewCache> preview_cache_;
 };
 
 }  // namespace remote
@@ -0,0 +1,89 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if !ION_PRODUCTION
+
+#include "ion/remote/allocationhandler.h"
+
+#include <string>
+
+#include "ion/base/allocator.h"
+#include "ion/remote/tests/httpservertest.h"
+
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace remote {
+
+namespace {
+
+// A derived Allocator class used only to create dummy instances.
+class DummyAllocator : public base::Allocator {
+ public:
+  void* Allocate(size_t size) override { return NULL; }
+  void Deallocate(void* p) override {}
+};
+
+}  // anonymous namespace
+
+class AllocationHandlerTest : public RemoteServerTest {
+ protected:
+  void SetUp() override {
+    RemoteServerTest::SetUp();
+    server_->SetHeaderHtml("");
+    server_->SetFooterHtml("");
+    tracker_.Reset(new base::SamplingAllocationTracker(0U));
+    server_->RegisterHandler(
+        HttpServer::RequestHandlerPtr(new AllocationHandler(tracker_)));
+  }
+
+  base::SamplingAllocationTrackerPtr tracker_;
+};
+
+TEST_F(AllocationHandlerTest, ServeSnapshot) {
+  GetUri("/ion/allocations/does/not/exist");
+  Verify404(__LINE__);
+
+  base::AllocatorPtr allocator(new DummyAllocator);
+  {
+    base::SamplingAllocationTracker::ScopedTag tag("remote");
+    tracker_->TrackAllocation(*allocator, 32U,
+                              reinterpret_cast<const void*>(0x100));
+  }
+
+  GetUri("/ion/allocations/snapshot");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ(tracker_->GetSnapshotJson(false), response_.data);
+  EXPECT_NE(std::string::npos, response_.data.find("\"tag\": \"remote\""));
+  EXPECT_EQ(std::string::npos, response_.data.find("\"stack\": "));
+
+  GetUri("/ion/allocations/snapshot?stacks");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_NE(std::string::npos, response_.data.find("\"stack\": "));
+
+  GetUri("/ion/allocations/");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ(0U, response_.data.find("{ \"sample_interval\": 0"));
+
+  tracker_->TrackDeallocation(*allocator,
+                              reinterpret_cast<const void*>(0x100));
+}
+
+}  // namespace remote
+}  // namespace ion
+
+#endif
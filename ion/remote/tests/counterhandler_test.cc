@@ -0,0 +1,238 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#if !ION_PRODUCTION
+
+#include "ion/remote/counterhandler.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ion/base/fullallocationtracker.h"
+#include "ion/base/invalid.h"
+#include "ion/base/tests/testallocator.h"
+#include "ion/base/zipassetmanager.h"
+#include "ion/gfx/renderer.h"
+#include "ion/gfx/tests/mockgraphicsmanager.h"
+#include "ion/gfxutils/frame.h"
+#include "ion/port/timer.h"
+#include "ion/remote/tests/httpservertest.h"
+
+#include "third_party/easywsclient/easywsclient.hpp"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace remote {
+
+namespace {
+
+typedef easywsclient::WebSocket ClientSocket;
+
+// Returns the little-endian 32-bit integer at |offset| in |data|.
+static uint32 DecodeUint32(const std::string& data, size_t offset) {
+  uint32 value = 0U;
+  for (int i = 3; i >= 0; --i)
+    value = (value << 8) | static_cast<uint8>(data[offset + i]);
+  return value;
+}
+
+// Returns counter |counter| of a frame sent by the handler.
+static double DecodeCounter(const std::string& data, int counter) {
+  uint64 bits = 0U;
+  for (int i = 7; i >= 0; --i)
+    bits = (bits << 8) | static_cast<uint8>(data[8 + 8 * counter + i]);
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void ReceiveMessage(const std::string& msg,
+                           std::vector<std::string>* messages) {
+  messages->push_back(msg);
+}
+
+}  // anonymous namespace
+
+class CounterHandlerTest : public RemoteServerTest {
+ protected:
+  void SetUp() override {
+    RemoteServerTest::SetUp();
+    server_->SetHeaderHtml("");
+    server_->SetFooterHtml("");
+
+    frame_ = new gfxutils::Frame();
+    mock_visual_.reset(new gfx::testing::MockVisual(500, 400));
+    mgm_ = new gfx::testing::MockGraphicsManager();
+    renderer_ = new gfx::Renderer(mgm_);
+    tracker_ = new base::FullAllocationTracker();
+    allocator_ = new base::testing::TestAllocator();
+    allocator_->SetTracker(tracker_);
+
+    handler_ = new CounterHandler(frame_, renderer_);
+    handler_->SetAllocationTracker(tracker_);
+    server_->RegisterHandler(handler_);
+
+    // Make some calls in each frame. This callback is invoked after the
+    // handler's, since callbacks are called in alphabetical order.
+    frame_->AddPreFrameCallback(
+        "zCounterHandlerTest", [this](const gfxutils::Frame&) {
+          mgm_->DrawArrays(GL_TRIANGLES, 0, 6);
+          mgm_->DrawArrays(GL_TRIANGLES, 0, 3);
+          allocator_->DeallocateMemory(allocator_->AllocateMemory(16U));
+        });
+  }
+
+  void TearDown() override {
+    frame_->RemovePreFrameCallback("zCounterHandlerTest");
+    handler_.Reset(NULL);
+    RemoteServerTest::TearDown();
+    renderer_.Reset(NULL);
+    mgm_.Reset(NULL);
+    mock_visual_.reset();
+  }
+
+  // Renders frames until at least |count| messages have been received on
+  // |socket| or a few seconds have passed.
+  void ReceiveMessages(ClientSocket* socket, size_t count,
+                       std::vector<std::string>* messages) {
+    port::Timer timer;
+    while (messages->size() < count && timer.GetInS() < 5.0) {
+      frame_->Begin();
+      frame_->End();
+      socket->poll(10);
+      socket->dispatch(std::bind(ReceiveMessage, std::placeholders::_1,
+                                 messages));
+    }
+    ASSERT_LE(count, messages->size());
+  }
+
+  gfxutils::FramePtr frame_;
+  std::unique_ptr<gfx::testing::MockVisual> mock_visual_;
+  gfx::testing::MockGraphicsManagerPtr mgm_;
+  gfx::RendererPtr renderer_;
+  base::AllocationTrackerPtr tracker_;
+  base::AllocatorPtr allocator_;
+  CounterHandlerPtr handler_;
+};
+
+TEST_F(CounterHandlerTest, ServeCounterNames) {
+  GetUri("/ion/counters/does/not/exist");
+  Verify404(__LINE__);
+
+  GetUri("/ion/counters/index.html");
+  const std::string& index =
+      base::ZipAssetManager::GetFileData("ion/counters/index.html");
+  EXPECT_FALSE(base::IsInvalidReference(index));
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ(index, response_.data);
+
+  GetUri("/ion/counters/names");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ(0U, response_.data.find("[\"frame_number\", \"frame_time_ms\", "));
+  EXPECT_NE(std::string::npos,
+            response_.data.find("\"gpu_memory_textures\", "
+                                "\"allocation_count\""));
+  EXPECT_NE(std::string::npos,
+            response_.data.find(", \"active_allocation_bytes\"]\n"));
+
+  // Every counter has a distinct name.
+  for (int i = 0; i < CounterHandler::kNumCounters; ++i) {
+    EXPECT_STRNE("", CounterHandler::GetCounterName(i));
+    for (int j = 0; j < i; ++j) {
+      EXPECT_STRNE(CounterHandler::GetCounterName(i),
+                   CounterHandler::GetCounterName(j));
+    }
+  }
+}
+
+#if !(defined(ION_PLATFORM_ASMJS) || defined(ION_PLATFORM_NACL))
+TEST_F(CounterHandlerTest, StreamCounters) {
+  ClientSocket::setMessageStream(NULL);
+  const std::string base("ws://" + localhost_ + "/ion/counters/");
+  // Only the stream path accepts connections.
+  EXPECT_TRUE(ClientSocket::from_url(base + "unknown") == NULL);
+
+  // Frames are not counted without clients.
+  frame_->Begin();
+  frame_->End();
+  EXPECT_FALSE(mgm_->IsCallStatisticsEnabled());
+
+  std::unique_ptr<ClientSocket> socket(
+      ClientSocket::from_url(base + "stream?frames=2"));
+  ASSERT_TRUE(socket.get() != NULL);
+  EXPECT_EQ(1U, handler_->GetClientCount());
+
+  std::vector<std::string> messages;
+  ReceiveMessages(socket.get(), 2U, &messages);
+  EXPECT_TRUE(mgm_->IsCallStatisticsEnabled());
+  for (size_t i = 0; i < messages.size(); ++i) {
+    const std::string& msg = messages[i];
+    ASSERT_EQ(CounterHandler::kFrameSize, msg.size());
+    EXPECT_EQ(CounterHandler::kFrameVersion, DecodeUint32(msg, 0));
+    EXPECT_EQ(static_cast<uint32>(CounterHandler::kNumCounters),
+              DecodeUint32(msg, 4));
+    EXPECT_GE(DecodeCounter(msg, CounterHandler::kFrameTime), 0.0);
+    EXPECT_EQ(2.0, DecodeCounter(msg, CounterHandler::kCallCount));
+    EXPECT_EQ(2.0, DecodeCounter(msg, CounterHandler::kDrawCallCount));
+    EXPECT_EQ(3.0, DecodeCounter(msg, CounterHandler::kPrimitiveCount));
+    EXPECT_EQ(0.0, DecodeCounter(msg, CounterHandler::kSentUniformCount));
+    EXPECT_EQ(0.0, DecodeCounter(msg, CounterHandler::kBufferUploadBytes));
+    EXPECT_EQ(1.0, DecodeCounter(msg, CounterHandler::kAllocationCount));
+    EXPECT_EQ(1.0, DecodeCounter(msg, CounterHandler::kDeallocationCount));
+    EXPECT_EQ(16.0, DecodeCounter(msg, CounterHandler::kAllocatedBytes));
+    EXPECT_EQ(0.0,
+              DecodeCounter(msg, CounterHandler::kActiveAllocationCount));
+  }
+  // Every other frame is sent.
+  EXPECT_EQ(DecodeCounter(messages[0], CounterHandler::kFrameNumber) + 2.0,
+            DecodeCounter(messages[1], CounterHandler::kFrameNumber));
+  EXPECT_GT(DecodeCounter(messages[1], CounterHandler::kFrameInterval), 0.0);
+
+  // Ask for every frame.
+  socket->send("1");
+  messages.clear();
+  ReceiveMessages(socket.get(), 4U, &messages);
+  const size_t last = messages.size() - 1U;
+  EXPECT_EQ(DecodeCounter(messages[last - 1U], CounterHandler::kFrameNumber) +
+                1.0,
+            DecodeCounter(messages[last], CounterHandler::kFrameNumber));
+
+  // An empty message closes the connection.
+  socket->send("");
+  port::Timer timer;
+  while (socket->getReadyState() != ClientSocket::CLOSED &&
+         timer.GetInS() < 5.0)
+    socket->poll(10);
+  EXPECT_EQ(ClientSocket::CLOSED, socket->getReadyState());
+  while (handler_->GetClientCount() && timer.GetInS() < 5.0)
+    port::Timer::SleepNMilliseconds(1);
+  EXPECT_EQ(0U, handler_->GetClientCount());
+
+  // The call statistics setting is restored by the next frame.
+  frame_->Begin();
+  frame_->End();
+  EXPECT_FALSE(mgm_->IsCallStatisticsEnabled());
+  ClientSocket::setMessageStream(stderr);
+}
+#endif
+
+}  // namespace remote
+}  // namespace ion
+
+#endif
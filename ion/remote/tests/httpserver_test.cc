@@ -19,6 +19,7 @@ limitations under the License.
 
 #include "ion/remote/httpserver.h"
 
+#include <cstring>
 #include <sstream>
 
 #include "ion/base/logchecker.h"
@@ -28,6 +29,7 @@ limitations under the License.
 #include "ion/remote/tests/httpservertest.h"
 
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
+#include "third_party/zlib/src/zlib.h"
 
 // Resources for tests.
 ION_REGISTER_ASSETS(IonTestRemoteRoot);
@@ -172,6 +174,29 @@ class EmbedHandler : public HttpServer::RequestHandler {
   }
 };
 
+// Returns gzip or zlib-format |data| uncompressed, or an empty string if it is
+// not valid.
+static const std::string Uncompress(const std::string& data) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Adding 32 to the window bits makes zlib detect the format.
+  if (inflateInit2(&stream, MAX_WBITS + 32) != Z_OK)
+    return std::string();
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.length());
+  std::string uncompressed;
+  int result = Z_OK;
+  while (result == Z_OK) {
+    char buffer[1024];
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    result = inflate(&stream, Z_NO_FLUSH);
+    uncompressed.append(buffer, sizeof(buffer) - stream.avail_out);
+  }
+  inflateEnd(&stream);
+  return result == Z_STREAM_END ? uncompressed : std::string();
+}
+
 }  // anonymous namespace
 
 TEST_F(HttpServerTest, FailedServer) {
@@ -324,6 +349,94 @@ TEST_F(HttpServerTest, RequestHandlers) {
   EXPECT_EQ("to/a/dir", server_->GetUriData("path/to/a/dir"));
 }
 
+TEST_F(HttpServerTest, CompressionAndCaching) {
+#if !defined(ION_PLATFORM_ASMJS) && !defined(ION_PLATFORM_NACL)
+  EXPECT_TRUE(IonTestRemoteRoot::RegisterAssets());
+  server_->RegisterHandler(RequestHandlerPtr(new IndexHandler("/")));
+  server_->RegisterHandler(
+      RequestHandlerPtr(new TextHandler("/test/path/to/file.txt")));
+  const std::string& index = base::ZipAssetManager::GetFileData("index.html");
+  EXPECT_TRUE(server_->IsCompressionEnabled());
+
+  // Responses are not compressed unless the client accepts it.
+  GetUri("/index.html");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ(index, response_.data);
+  EXPECT_EQ(0U, response_.headers.count("Content-Encoding"));
+  EXPECT_EQ("Accept-Encoding", response_.headers["Vary"]);
+  EXPECT_EQ("no-cache", response_.headers["Cache-Control"]);
+  const std::string etag = response_.headers["ETag"];
+  EXPECT_TRUE(base::StartsWith(etag, "\""));
+  EXPECT_TRUE(base::EndsWith(etag, "\""));
+  GetUri("/index.html");
+  EXPECT_EQ(etag, response_.headers["ETag"]);
+
+  // Compressed data is cached after it is sent the first time.
+  std::map<std::string, std::string> headers;
+  headers["Accept-Encoding"] = "gzip, deflate";
+  std::string gzip_etag;
+  for (int i = 0; i < 3; ++i) {
+    SCOPED_TRACE(::testing::Message() << "Request " << i);
+    response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+    EXPECT_EQ(200, response_.status);
+    EXPECT_EQ("gzip", response_.headers["Content-Encoding"]);
+    EXPECT_LT(response_.data.length(), index.length());
+    EXPECT_EQ(base::ValueToString(response_.data.length()),
+              response_.headers["Content-Length"]);
+    EXPECT_EQ(index, Uncompress(response_.data));
+    EXPECT_NE(etag, response_.headers["ETag"]);
+    if (i) {
+      EXPECT_EQ(gzip_etag, response_.headers["ETag"]);
+    }
+    gzip_etag = response_.headers["ETag"];
+  }
+
+  headers["Accept-Encoding"] = "gzip;q=0, deflate";
+  response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+  EXPECT_EQ("deflate", response_.headers["Content-Encoding"]);
+  EXPECT_EQ(index, Uncompress(response_.data));
+  EXPECT_NE(gzip_etag, response_.headers["ETag"]);
+
+  headers["Accept-Encoding"] = "identity";
+  response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+  EXPECT_EQ(0U, response_.headers.count("Content-Encoding"));
+  EXPECT_EQ(index, response_.data);
+
+  // Small responses are not compressed.
+  headers["Accept-Encoding"] = "gzip";
+  response_ =
+      client_.GetWithHeaders(localhost_ + "/test/path/to/file.txt", headers);
+  EXPECT_EQ(0U, response_.headers.count("Content-Encoding"));
+  EXPECT_EQ(0U, response_.headers.count("Vary"));
+  EXPECT_EQ("text", response_.data);
+
+  server_->SetCompressionEnabled(false);
+  EXPECT_FALSE(server_->IsCompressionEnabled());
+  response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+  EXPECT_EQ(0U, response_.headers.count("Content-Encoding"));
+  EXPECT_EQ(etag, response_.headers["ETag"]);
+  EXPECT_EQ(index, response_.data);
+  server_->SetCompressionEnabled(true);
+
+  // Clients that have the data get a 304 status without it, whichever
+  // representation they have.
+  headers.clear();
+  headers["If-None-Match"] = etag;
+  response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+  EXPECT_EQ(304, response_.status);
+  EXPECT_TRUE(response_.data.empty());
+  EXPECT_EQ(etag, response_.headers["ETag"]);
+  headers["If-None-Match"] = "\"abc\", W/" + gzip_etag;
+  response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+  EXPECT_EQ(304, response_.status);
+  EXPECT_TRUE(response_.data.empty());
+  headers["If-None-Match"] = "\"abc\"";
+  response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ(index, response_.data);
+#endif
+}
+
 TEST_F(HttpServerTest, QueryArgs) {
   server_->RegisterHandler(
       RequestHandlerPtr(new QueryArgsHandler("/query.html")));
@@ -346,6 +459,36 @@ TEST_F(HttpServerTest, QueryArgs) {
             server_->GetUriData("/query.html?var&var2=value"));
 }
 
+TEST_F(HttpServerTest, KeepAlive) {
+#if !defined(ION_PLATFORM_ASMJS) && !defined(ION_PLATFORM_NACL)
+  server_->RegisterHandler(
+      RequestHandlerPtr(new QueryArgsHandler("/query.html")));
+
+  // HttpClient asks the server to close its connections.
+  GetUri("/query.html?arg1=1");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ("close", response_.headers["Connection"]);
+
+  // Clients can ask to keep connections alive, including for 404 responses.
+  std::map<std::string, std::string> headers;
+  headers["Connection"] = "keep-alive";
+  response_ =
+      client_.GetWithHeaders(localhost_ + "/query.html?arg1=1", headers);
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ("?&arg1=1", response_.data);
+  EXPECT_EQ("keep-alive", response_.headers["Connection"]);
+  response_ = client_.GetWithHeaders(localhost_ + "/index.html", headers);
+  EXPECT_EQ(404, response_.status);
+  EXPECT_EQ("keep-alive", response_.headers["Connection"]);
+
+  // The body of a POST is consumed, but only form data is passed to the
+  // handler.
+  response_ = client_.Post(localhost_ + "/query.html?arg1=1", "arg2=2");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ("?&arg1=1", response_.data);
+#endif
+}
+
 TEST_F(HttpServerTest, HeaderAndFooter) {
   server_->RegisterHandler(
       RequestHandlerPtr(new HeaderFooterHandler("/hf/")));
@@ -269,6 +269,138 @@ TEST_F(NodeGraphHandlerTest, ServeNodeGraph) {
       response_.data));
 }
 
+TEST(NodeGraphHandler, NodeIds) {
+  NodeGraphHandlerPtr ngh(new NodeGraphHandler);
+  EXPECT_EQ(0U, ngh->GetNodeId(gfx::NodePtr()));
+
+  gfx::NodePtr node1(new gfx::Node);
+  gfx::NodePtr node2(new gfx::Node);
+  const uint64 id1 = ngh->GetNodeId(node1);
+  const uint64 id2 = ngh->GetNodeId(node2);
+  EXPECT_NE(0U, id1);
+  EXPECT_NE(0U, id2);
+  EXPECT_NE(id1, id2);
+  // IDs are stable.
+  EXPECT_EQ(id1, ngh->GetNodeId(node1));
+  EXPECT_EQ(id2, ngh->GetNodeId(node2));
+
+  // Structural changes to Nodes with IDs increment the version.
+  const uint64 version = ngh->GetVersion();
+  node1->AddChild(gfx::NodePtr(new gfx::Node));
+  EXPECT_LT(version, ngh->GetVersion());
+
+  // The handler stops listening for changes when it is destroyed.
+  EXPECT_EQ(1U, node1->GetReceiverCount());
+  ngh.Reset(NULL);
+  EXPECT_EQ(0U, node1->GetReceiverCount());
+}
+
+TEST_F(NodeGraphHandlerTest, ServeIncrementally) {
+  gfx::NodePtr root(new gfx::Node);
+  root->SetLabel("Root \"1\"");
+  gfx::NodePtr child1(new gfx::Node);
+  child1->SetLabel("Child1");
+  gfx::NodePtr child2(new gfx::Node);
+  child2->SetLabel("Child2");
+  child2->Enable(false);
+  gfx::ShaderInputRegistryPtr reg;
+  gfx::NodePtr grandchild(BuildNodeWithShape(&reg));
+  root->AddChild(child1);
+  root->AddChild(child2);
+  child1->AddChild(grandchild);
+
+  GetUri("/ion/nodegraph/nodes");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ("{ \"version\": 0, \"nodes\": [] }\n", response_.data);
+
+  ngh_->AddNode(root);
+  const uint64 root_id = ngh_->GetNodeId(root);
+  GetUri("/ion/nodegraph/nodes");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_TRUE(base::testing::MultiLineStringsEqual(
+      "{ \"version\": 1, \"nodes\": [\n"
+      "  { \"id\": " + base::ValueToString(root_id) +
+      ", \"label\": \"Root \\\"1\\\"\", \"enabled\": true, \"children\": 2, "
+      "\"shapes\": 0, \"uniforms\": 0 }\n"
+      "] }\n",
+      response_.data));
+
+  // Children are only returned when requested.
+  GetUri("/ion/nodegraph/children?id=" + base::ValueToString(root_id));
+  EXPECT_EQ(200, response_.status);
+  const uint64 child1_id = ngh_->GetNodeId(child1);
+  const uint64 child2_id = ngh_->GetNodeId(child2);
+  EXPECT_TRUE(base::testing::MultiLineStringsEqual(
+      "{ \"version\": 1, \"id\": " + base::ValueToString(root_id) +
+      ", \"children\": [\n"
+      "  { \"id\": " + base::ValueToString(child1_id) +
+      ", \"label\": \"Child1\", \"enabled\": true, \"children\": 1, "
+      "\"shapes\": 0, \"uniforms\": 0 },\n"
+      "  { \"id\": " + base::ValueToString(child2_id) +
+      ", \"label\": \"Child2\", \"enabled\": false, \"children\": 0, "
+      "\"shapes\": 0, \"uniforms\": 0 }\n"
+      "] }\n",
+      response_.data));
+
+  // Unknown IDs are not served.
+  GetUri("/ion/nodegraph/children?id=1000");
+  Verify404(__LINE__);
+  GetUri("/ion/nodegraph/children?id=abc");
+  Verify404(__LINE__);
+  GetUri("/ion/nodegraph/node");
+  Verify404(__LINE__);
+
+  // A single Node is printed without its children.
+  GetUri("/ion/nodegraph/node?id=" + base::ValueToString(root_id));
+  EXPECT_EQ(200, response_.status);
+  EXPECT_TRUE(base::testing::MultiLineStringsEqual(
+      "ION Node \"Root \"1\"\" {\n"
+      "  Enabled: true\n"
+      "}\n",
+      response_.data));
+
+  // Nothing has changed since the last version.
+  GetUri("/ion/nodegraph/changes?since=1");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ("{ \"version\": 1, \"nodes_changed\": false, \"changed\": [], "
+            "\"removed\": [] }\n", response_.data);
+  GetUri("/ion/nodegraph/changes");
+  EXPECT_EQ("{ \"version\": 1, \"nodes_changed\": true, \"changed\": [], "
+            "\"removed\": [] }\n", response_.data);
+
+  // A change to a child is reported for it and its ancestors with IDs.
+  child2->AddShape(gfx::ShapePtr(new gfx::Shape));
+  const uint64 version = ngh_->GetVersion();
+  EXPECT_LT(1U, version);
+  GetUri("/ion/nodegraph/changes?since=1");
+  EXPECT_EQ("{ \"version\": " + base::ValueToString(version) +
+            ", \"nodes_changed\": false, \"changed\": [" +
+            base::ValueToString(root_id) + ", " +
+            base::ValueToString(child2_id) + "], \"removed\": [] }\n",
+            response_.data);
+
+  // Destroyed Nodes are reported as removed.
+  root->RemoveChild(child2);
+  child2.Reset(NULL);
+  GetUri("/ion/nodegraph/changes?since=" + base::ValueToString(version));
+  const uint64 removed_version = ngh_->GetVersion();
+  EXPECT_EQ("{ \"version\": " + base::ValueToString(removed_version) +
+            ", \"nodes_changed\": false, \"changed\": [" +
+            base::ValueToString(root_id) + "], \"removed\": [" +
+            base::ValueToString(child2_id) + "] }\n",
+            response_.data);
+  GetUri("/ion/nodegraph/children?id=" + base::ValueToString(child2_id));
+  Verify404(__LINE__);
+
+  // Removing a tracked node changes the tracked nodes.
+  ngh_->RemoveNode(root);
+  GetUri("/ion/nodegraph/changes?since=" +
+         base::ValueToString(removed_version));
+  EXPECT_EQ("{ \"version\": " + base::ValueToString(removed_version + 1U) +
+            ", \"nodes_changed\": true, \"changed\": [], \"removed\": [] }\n",
+            response_.data);
+}
+
 }  // namespace remote
 }  // namespace ion
 
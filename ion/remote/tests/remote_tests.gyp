@@ -50,7 +50,9 @@
       ],  # conditions
 
       'sources' : [
+        'allocationhandler_test.cc',
         'calltracehandler_test.cc',
+        'counterhandler_test.cc',
         'httpserver_test.cc',
         'nodegraphhandler_test.cc',
         'remoteserver_test.cc',
@@ -64,6 +66,7 @@
         ':ionremote_test_assets',
         '<(ion_dir)/base/base.gyp:ionbase',
         '<(ion_dir)/external/external.gyp:ioneasywsclient',
+        '<(ion_dir)/external/external.gyp:ionzlib',
         '<(ion_dir)/external/gtest.gyp:iongtest_safeallocs',
         '<(ion_dir)/gfx/gfx.gyp:iongfx_for_tests',
         '<(ion_dir)/gfxutils/gfxutils.gyp:iongfxutils_for_tests',
@@ -84,6 +84,37 @@ TEST_F(RemoteServerTest, ServeRoot) {
             response_.data.find("window.location = \"/ion/settings"));
 }
 
+TEST_F(RemoteServerTest, BatchRequests) {
+  GetUri("/ion/batch");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_EQ("[]\n", response_.data);
+
+  // Each request is answered in order, and batches are not nested.
+  GetUri("/ion/batch?0=%2Fion%2Findex.html&1=%2Fion%2Fdoes%2Fnot%2Fexist"
+         "&2=%2Fion%2Fbatch&3=ion%2Fcss%2Fstyle.css");
+  EXPECT_EQ(200, response_.status);
+  const std::string& data = response_.data;
+  const size_t first = data.find("{\"uri\": \"/ion/index.html\", "
+                                 "\"status\": 200");
+  const size_t second = data.find("{\"uri\": \"/ion/does/not/exist\", "
+                                  "\"status\": 404");
+  const size_t third = data.find("{\"uri\": \"/ion/batch\", "
+                                 "\"status\": 404");
+  const size_t fourth = data.find("{\"uri\": \"ion/css/style.css\", "
+                                  "\"status\": 200, "
+                                  "\"content_type\": \"text/css\", "
+                                  "\"encoding\": \"text\"");
+  EXPECT_NE(std::string::npos, first);
+  EXPECT_LT(first, second);
+  EXPECT_LT(second, third);
+  EXPECT_LT(third, fourth);
+  EXPECT_NE(std::string::npos, fourth);
+  // Quotes in the data are escaped.
+  EXPECT_NE(std::string::npos,
+            data.find("window.location = \\\"/ion/settings"));
+  EXPECT_TRUE(base::EndsWith(data, "}\n]\n"));
+}
+
 #if !(defined(ION_PLATFORM_ASMJS) || defined(ION_PLATFORM_NACL))
 TEST_F(RemoteServerTest, SucceedServer) {
   visual_.reset(new gfx::testing::MockVisual(64, 64));
@@ -99,6 +130,7 @@ TEST_F(RemoteServerTest, SucceedServer) {
   const HttpServer::HandlerMap handler_map = server->GetHandlers();
   EXPECT_NE(handler_map.end(), handler_map.find("/ion/nodegraph"));
   EXPECT_NE(handler_map.end(), handler_map.find("/ion/calltrace"));
+  EXPECT_NE(handler_map.end(), handler_map.find("/ion/counters"));
   EXPECT_NE(handler_map.end(), handler_map.find("/ion/resources"));
   EXPECT_NE(handler_map.end(), handler_map.find("/ion/settings"));
   EXPECT_NE(handler_map.end(), handler_map.find("/ion/shaders"));
@@ -1648,6 +1648,19 @@ static const std::string GetTestCubeMapImagePng() {
       std::string(png_data.begin(), png_data.end()));
 }
 
+// Returns the Base64-encoded |format| representation of a blank RGB image.
+static const std::string GetBlankImageData(uint32 width, uint32 height,
+                                           image::ExternalImageFormat format) {
+  const std::vector<uint8> pixels(width * height * 3U, 0);
+  ImagePtr image(new Image);
+  image->Set(Image::kRgb888, width, height,
+             base::DataContainer::CreateAndCopy<uint8>(
+                 &pixels[0], pixels.size(), false, image->GetAllocator()));
+  const std::vector<uint8> data =
+      image::ConvertToExternalImageData(image, format, false);
+  return base::MimeBase64EncodeString(std::string(data.begin(), data.end()));
+}
+
 //-----------------------------------------------------------------------------
 //
 // ResourceHandlerTest chassis.
@@ -1887,6 +1900,23 @@ TEST_F(ResourceHandlerTest, GetTextureData) {
   DrawScene(root);
   GetUri("/ion/resources/texture_data?nonblocking&id=1");
   EXPECT_EQ(GetTestCubeMapImagePng(), response_.data);
+
+  // Previews are rendered at the requested size, and may be JPEG images.
+  DrawScene(root);
+  GetUri("/ion/resources/texture_data?nonblocking&id=2&size=1");
+  EXPECT_EQ(GetBlankImageData(1U, 1U, image::kPng), response_.data);
+  DrawScene(root);
+  GetUri("/ion/resources/texture_data?nonblocking&id=1&size=1");
+  EXPECT_EQ(GetBlankImageData(3U, 4U, image::kPng), response_.data);
+  DrawScene(root);
+  GetUri("/ion/resources/texture_data?nonblocking&id=2&format=jpeg");
+  EXPECT_EQ(GetBlankImageData(2U, 2U, image::kJpeg), response_.data);
+
+  // A size larger than the texture has no effect. The unchanged texture is
+  // served from the cache.
+  DrawScene(root);
+  GetUri("/ion/resources/texture_data?nonblocking&id=2&size=64");
+  EXPECT_EQ(GetTestImagePng(), response_.data);
 }
 
 }  // namespace remote
@@ -53,9 +53,10 @@ class TracingHandlerTest : public RemoteServerTest {
     mgm_ = new gfx::testing::MockGraphicsManager();
     renderer_ = new gfx::Renderer(mgm_);
 
-    // Set a tracing stream to test save/restore.
-    mgm_->SetTracingStream(&test_ostream_);
-    EXPECT_EQ(&test_ostream_, mgm_->GetTracingStream());
+    // Set a BinaryTrace to test save/restore.
+    test_trace_ = new gfx::BinaryTrace;
+    mgm_->SetBinaryTrace(test_trace_);
+    EXPECT_EQ(test_trace_.Get(), mgm_->GetBinaryTrace().Get());
 
     // Create and register a TracingHandler.
     TracingHandler* th = new TracingHandler(frame_, renderer_);
@@ -66,8 +67,8 @@ class TracingHandlerTest : public RemoteServerTest {
     test_handler->SetPostHandler(
         std::bind(&TracingHandlerTest::MockVisualTearDown, this));
     server_->RegisterHandler(HttpServer::RequestHandlerPtr(test_handler));
-    tracing_stream_ = th->GetTracingStream();
-    EXPECT_FALSE(tracing_stream_ == NULL);
+    tracing_trace_ = th->GetBinaryTrace();
+    EXPECT_FALSE(tracing_trace_ == NULL);
 
     // Add a pre-frame callback that will get invoked after the
     // TracingHandler's. This allows the test to make calls to the
@@ -81,9 +82,9 @@ class TracingHandlerTest : public RemoteServerTest {
   void TearDown() override {
     RemoteServerTest::TearDown();
     // The TracingHandler should have been deleted, restoring the previous
-    // tracing stream. And nothing should have been written to the stream.
-    EXPECT_EQ(&test_ostream_, mgm_->GetTracingStream());
-    EXPECT_TRUE(test_ostream_.str().empty());
+    // BinaryTrace. And nothing should have been recorded in the trace.
+    EXPECT_EQ(test_trace_.Get(), mgm_->GetBinaryTrace().Get());
+    EXPECT_EQ(0U, test_trace_->GetRecordCount());
 
     // Make sure objects are destroyed properly.
     renderer_ = NULL;
@@ -109,16 +110,17 @@ class TracingHandlerTest : public RemoteServerTest {
   }
 
   void MakeOpenGLCalls(const gfxutils::Frame&) {
-    // Make the calls only if requested and the TracingHandler's stream is
+    // Make the calls only if requested and the TracingHandler's trace is
     // active.
-    if (make_opengl_calls_ && mgm_->GetTracingStream() != &test_ostream_) {
+    if (make_opengl_calls_ &&
+        mgm_->GetBinaryTrace().Get() != test_trace_.Get()) {
       base::LogChecker log_checker;
       mgm_->EnableErrorChecking(true);
       // Simulate labels and indentation.
-      ASSERT_FALSE(mgm_->GetTracingStream() == NULL);
-      (*tracing_stream_) << ">Top level label:\n";
+      ASSERT_FALSE(mgm_->GetBinaryTrace().Get() == NULL);
+      tracing_trace_->RecordText(">Top level label:\n");
       mgm_->Clear(GL_COLOR_BUFFER_BIT);
-      (*tracing_stream_) << "-->Nested label\n";
+      tracing_trace_->RecordText("-->Nested label\n");
       mgm_->SetTracingPrefix("  ");
       uniform_storage[0] = 3.0f;
       uniform_storage[1] = 4.0f;
@@ -143,8 +145,8 @@ class TracingHandlerTest : public RemoteServerTest {
   gfxutils::FramePtr frame_;
   gfx::testing::MockGraphicsManagerPtr mgm_;
   gfx::RendererPtr renderer_;
-  std::ostream* tracing_stream_;
-  std::ostringstream test_ostream_;
+  gfx::BinaryTrace* tracing_trace_;
+  gfx::BinaryTracePtr test_trace_;
   // When true, this actually makes some OpenGL calls in MakeOpenGLCalls().
   bool make_opengl_calls_;
 
@@ -280,6 +282,77 @@ TEST_F(TracingHandlerTest, DeleteResources) {
 #endif
 }
 
+TEST_F(TracingHandlerTest, CallStatistics) {
+#if !ION_PRODUCTION
+  // Draw during frames in which statistics are collected.
+  frame_->AddPreFrameCallback(
+      "zzCallStatistics", [this](const gfxutils::Frame&) {
+        if (mgm_->IsCallStatisticsEnabled()) {
+          // Keep the calls out of the saved trace.
+          mgm_->SetBinaryTrace(gfx::BinaryTracePtr());
+          mgm_->DrawArrays(GL_TRIANGLES, 0, 6);
+          mgm_->DrawArrays(GL_TRIANGLES, 0, 3);
+          mgm_->SetErrorCode(GL_NO_ERROR);
+          mgm_->SetBinaryTrace(test_trace_);
+        }
+      });
+  frame_->Begin();
+  frame_->End();
+
+  GetUri("/ion/tracing/call_statistics_next_frame?nonblocking");
+  EXPECT_EQ(200, response_.status);
+  EXPECT_TRUE(base::testing::MultiLineStringsEqual(
+      "{\n"
+      "  \"frame\": 1,\n"
+      "  \"call_count\": 2,\n"
+      "  \"draw_call_count\": 2,\n"
+      "  \"primitive_count\": 3,\n"
+      "  \"buffer_upload_bytes\": 0,\n"
+      "  \"texture_upload_bytes\": 0,\n"
+      "  \"functions\": {\n"
+      "    \"DrawArrays\": 2\n"
+      "  }\n"
+      "}\n",
+      response_.data));
+  // Statistics are only collected for the requested frame.
+  EXPECT_FALSE(mgm_->IsCallStatisticsEnabled());
+  frame_->RemovePreFrameCallback("zzCallStatistics");
+
+  MockVisualRestore();
+#endif
+}
+
+TEST_F(TracingHandlerTest, CaptureNextFrame) {
+#if !ION_PRODUCTION
+  // Draw during frames that are captured.
+  frame_->AddPreFrameCallback(
+      "zzCaptureNextFrame", [this](const gfxutils::Frame&) {
+        if (mgm_->GetFrameCapture().Get())
+          mgm_->DrawArrays(GL_TRIANGLES, 0, 6);
+      });
+  // Keep the calls that restore the OpenGL state out of the saved trace.
+  mgm_->SetBinaryTrace(gfx::BinaryTracePtr());
+  GetUri("/ion/tracing/capture_next_frame?nonblocking");
+  mgm_->SetBinaryTrace(test_trace_);
+  EXPECT_EQ(200, response_.status);
+  // The capture is only installed for the requested frame.
+  EXPECT_FALSE(mgm_->GetFrameCapture().Get());
+
+  gfx::FrameCapturePtr capture(new gfx::FrameCapture);
+  EXPECT_TRUE(capture->Deserialize(response_.data));
+  const std::vector<gfx::FrameCapture::Call>& calls = capture->GetCalls();
+  // Any calls that set the OpenGL state come before the draw.
+  ASSERT_FALSE(calls.empty());
+  EXPECT_EQ("DrawArrays", calls.back().name);
+  ASSERT_EQ(3U, calls.back().args.size());
+  EXPECT_EQ(static_cast<uint64>(GL_TRIANGLES), calls.back().args[0].value);
+  EXPECT_EQ(6U, calls.back().args[2].value);
+  frame_->RemovePreFrameCallback("zzCaptureNextFrame");
+
+  MockVisualRestore();
+#endif
+}
+
 }  // namespace remote
 }  // namespace ion
 
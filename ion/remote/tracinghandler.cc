@@ -19,6 +19,8 @@ limitations under the License.
 
 #include "ion/remote/tracinghandler.h"
 
+#include <map>
+#include <sstream>
 #include <vector>
 
 #include "ion/base/invalid.h"
@@ -294,8 +296,12 @@ TracingHandler::TracingHandler(const gfxutils::FramePtr& frame,
     : HttpServer::RequestHandler("/ion/tracing"),
       frame_(frame),
       renderer_(renderer),
-      prev_stream_(renderer_->GetGraphicsManager()->GetTracingStream()),
+      prev_binary_trace_(renderer_->GetGraphicsManager()->GetBinaryTrace()),
+      binary_trace_(new gfx::BinaryTrace),
       state_(kInactive),
+      collection_(kTrace),
+      keep_resources_for_capture_(false),
+      prev_call_statistics_enabled_(false),
       frame_counter_(0) {
   using std::bind;
   using std::placeholders::_1;
@@ -318,8 +324,8 @@ TracingHandler::~TracingHandler() {
     frame_->RemovePostFrameCallback("TracingHandler");
   }
 
-  // Restore the previous stream.
-  renderer_->GetGraphicsManager()->SetTracingStream(prev_stream_);
+  // Restore the previous trace.
+  renderer_->GetGraphicsManager()->SetBinaryTrace(prev_binary_trace_);
 }
 
 const std::string TracingHandler::HandleRequest(
@@ -336,6 +342,13 @@ const std::string TracingHandler::HandleRequest(
     // rendered.
     TraceNextFrame(args.find("nonblocking") == args.end());
     return html_string_;
+  } else if (path == "call_statistics_next_frame") {
+    *content_type = "application/json";
+    return GetNextFrameCallStatistics(args.find("nonblocking") == args.end());
+  } else if (path == "capture_next_frame") {
+    *content_type = "application/octet-stream";
+    return CaptureNextFrame(args.find("nonblocking") == args.end(),
+                            args.find("keep_resources") != args.end());
   } else if (path == "clear") {
     html_string_.clear();
     return "clear";
@@ -354,20 +367,69 @@ const std::string TracingHandler::HandleRequest(
 
 void TracingHandler::TraceNextFrame(bool block_until_frame_rendered) {
   if (frame_.Get()) {
-    // Set the state so that tracing occurs during the next frame.
-    state_ = kWaitingForBeginFrame;
-    // If not blocking, just call Begin() and End() explicitly.
-    if (!block_until_frame_rendered) {
-      frame_->Begin();
-      frame_->End();
-    }
-    semaphore_.Wait();
-    DCHECK_EQ(state_, kInactive);
-    // Add HTML to the string and clear the tracing stream.
+    collection_ = kTrace;
+    WaitForNextFrame(block_until_frame_rendered);
+    // Add HTML to the string and clear the trace.
     TracingHtmlHelper helper;
-    helper.AddHtml(frame_counter_, tracing_stream_.str(), &html_string_);
-    tracing_stream_.str("");
+    helper.AddHtml(frame_counter_, binary_trace_->Format(), &html_string_);
+    binary_trace_->Clear();
+  }
+}
+
+const std::string TracingHandler::GetNextFrameCallStatistics(
+    bool block_until_frame_rendered) {
+  if (!frame_.Get())
+    return std::string();
+  collection_ = kCallStatistics;
+  WaitForNextFrame(block_until_frame_rendered);
+  collection_ = kTrace;
+
+  const gfx::GraphicsManagerPtr& gm = renderer_->GetGraphicsManager();
+  const gfx::GraphicsManager::CallStatistics stats = gm->GetCallStatistics();
+  const std::map<std::string, uint64> counts = gm->GetFunctionCallCounts();
+  std::ostringstream str;
+  str << "{\n";
+  str << "  \"frame\": " << frame_counter_ << ",\n";
+  str << "  \"call_count\": " << stats.call_count << ",\n";
+  str << "  \"draw_call_count\": " << stats.draw_call_count << ",\n";
+  str << "  \"primitive_count\": " << stats.primitive_count << ",\n";
+  str << "  \"buffer_upload_bytes\": " << stats.buffer_upload_bytes << ",\n";
+  str << "  \"texture_upload_bytes\": " << stats.texture_upload_bytes
+      << ",\n";
+  str << "  \"functions\": {";
+  for (std::map<std::string, uint64>::const_iterator it = counts.begin();
+       it != counts.end(); ++it) {
+    str << (it == counts.begin() ? "\n" : ",\n") << "    \"" << it->first
+        << "\": " << it->second;
   }
+  str << (counts.empty() ? "}\n" : "\n  }\n") << "}\n";
+  return str.str();
+}
+
+const std::string TracingHandler::CaptureNextFrame(
+    bool block_until_frame_rendered, bool keep_resources) {
+  if (!frame_.Get())
+    return std::string();
+  collection_ = kFrameCapture;
+  keep_resources_for_capture_ = keep_resources;
+  frame_capture_.Reset(new gfx::FrameCapture);
+  WaitForNextFrame(block_until_frame_rendered);
+  collection_ = kTrace;
+  const std::string capture = frame_capture_->Serialize();
+  frame_capture_.Reset();
+  return capture;
+}
+
+void TracingHandler::WaitForNextFrame(bool block_until_frame_rendered) {
+  // Set the state so that the work occurs during the next frame.
+  state_ = kWaitingForBeginFrame;
+  // If not blocking, just call Begin() and End() explicitly.
+  if (!block_until_frame_rendered) {
+    frame_->Begin();
+    frame_->End();
+  }
+  semaphore_.Wait();
+  DCHECK_EQ(state_, kInactive);
 }
 
 void TracingHandler::BeginFrame(const gfxutils::Frame& frame) {
@@ -383,14 +445,46 @@ void TracingHandler::BeginFrame(const gfxutils::Frame& frame) {
       resources_to_delete_.clear();
     }
     frame_counter_ = frame.GetCounter();
-    renderer_->GetGraphicsManager()->SetTracingStream(&tracing_stream_);
+    const gfx::GraphicsManagerPtr& gm = renderer_->GetGraphicsManager();
+    if (collection_ == kCallStatistics) {
+      prev_call_statistics_enabled_ = gm->IsCallStatisticsEnabled();
+      gm->ResetCallStatistics();
+      gm->EnableCallStatistics(true);
+    } else if (collection_ == kFrameCapture) {
+      // Release resources before capturing so that the capture creates every
+      // object that the frame uses.
+      if (!keep_resources_for_capture_)
+        renderer_->ClearAllResources();
+      gm->SetFrameCapture(frame_capture_);
+      // Start the capture with the calls that set the current OpenGL state, by
+      // making the Renderer believe that OpenGL is in its default state and
+      // then restoring the current state. The clear values are left out so
+      // that this does not clear the framebuffer.
+      gfx::StateTablePtr current_state(new gfx::StateTable);
+      current_state->CopyFrom(renderer_->GetStateTable());
+      current_state->ResetValue(gfx::StateTable::kClearColorValue);
+      current_state->ResetValue(gfx::StateTable::kClearDepthValue);
+      current_state->ResetValue(gfx::StateTable::kClearStencilValue);
+      renderer_->ClearCachedBindings();
+      renderer_->UpdateStateFromStateTable(
+          gfx::StateTablePtr(new gfx::StateTable));
+      renderer_->ProcessStateTable(current_state);
+    } else {
+      gm->SetBinaryTrace(binary_trace_);
+    }
     state_ = kWaitingForEndFrame;
   }
 }
 
 void TracingHandler::EndFrame(const gfxutils::Frame& frame) {
   if (state_ == kWaitingForEndFrame) {
-    renderer_->GetGraphicsManager()->SetTracingStream(prev_stream_);
+    const gfx::GraphicsManagerPtr& gm = renderer_->GetGraphicsManager();
+    if (collection_ == kCallStatistics)
+      gm->EnableCallStatistics(prev_call_statistics_enabled_);
+    else if (collection_ == kFrameCapture)
+      gm->SetFrameCapture(gfx::FrameCapturePtr());
+    else
+      gm->SetBinaryTrace(prev_binary_trace_);
     state_ = kInactive;
     // Clear the semaphore so HandleRequest() can proceed.
     semaphore_.Post();
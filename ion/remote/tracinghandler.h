@@ -19,10 +19,10 @@ limitations under the License.
 #define ION_REMOTE_TRACINGHANDLER_H_
 
 #include <functional>
-#include <sstream>
 #include <string>
 
 #include "base/integral_types.h"
+#include "ion/gfx/binarytrace.h"
 #include "ion/gfx/renderer.h"
 #include "ion/gfxutils/frame.h"
 #include "ion/port/semaphore.h"
@@ -40,6 +40,14 @@ namespace remote {
 // /clear                    - Clears the current trace string, returns "clear".
 // /trace_next_frame         - Returns a string containing the OpenGL trace,
 //                             first appending the trace of the next frame.
+// /call_statistics_next_frame
+//                           - Returns a JSON object with the GraphicsManager
+//                             call statistics of the next frame.
+// /capture_next_frame       - Returns a binary gfx::FrameCapture of the next
+//                             frame, which can be replayed offline. All
+//                             renderer resources are released first so that
+//                             their creation is captured, unless the
+//                             "keep_resources" argument is passed.
 class ION_API TracingHandler : public HttpServer::RequestHandler {
  public:
   // The constructor is passed a Frame instance that allows the handler to know
@@ -62,38 +70,66 @@ class ION_API TracingHandler : public HttpServer::RequestHandler {
     kWaitingForEndFrame,    // Waiting for EndFrame() to be called.
   };
 
+  // This enum indicates what is collected from the next frame.
+  enum Collection {
+    kTrace,           // A trace of the OpenGL calls.
+    kCallStatistics,  // The GraphicsManager call statistics.
+    kFrameCapture,    // A FrameCapture of the OpenGL calls.
+  };
+
   // Traces the next frame.
   void TraceNextFrame(bool block_until_frame_rendered);
+  // Collects call statistics for the next frame and returns them as JSON.
+  const std::string GetNextFrameCallStatistics(
+      bool block_until_frame_rendered);
+  // Captures the OpenGL calls of the next frame and returns them serialized.
+  const std::string CaptureNextFrame(bool block_until_frame_rendered,
+                                     bool keep_resources);
+  // Waits for the next frame to be rendered, in which BeginFrame() and
+  // EndFrame() do the work.
+  void WaitForNextFrame(bool block_until_frame_rendered);
 
   // Frame callbacks.
   void BeginFrame(const gfxutils::Frame& frame);
   void EndFrame(const gfxutils::Frame& frame);
 
-  // Returns the stream that the TracingHandler installs in the GraphicsManager
-  // to capture the OpenGL trace. This is used for testing.
-  std::ostream* GetTracingStream() { return &tracing_stream_; }
+  // Returns the BinaryTrace that the TracingHandler installs in the
+  // GraphicsManager to record the OpenGL trace. This is used for testing.
+  gfx::BinaryTrace* GetBinaryTrace() { return binary_trace_.Get(); }
 
   // Frame passed to constructor.
   gfxutils::FramePtr frame_;
   // Renderer passed to constructor.
   gfx::RendererPtr renderer_;
-  // Saves the previous ostream from the GraphicsManager so it can be restored.
-  std::ostream* prev_stream_;
-  // Stream used to get tracing data in GraphicsManager.
-  std::ostringstream tracing_stream_;
+  // Saves the previous BinaryTrace from the GraphicsManager so it can be
+  // restored.
+  gfx::BinaryTracePtr prev_binary_trace_;
+  // Records the OpenGL calls of a traced frame, which are only formatted once
+  // the frame is done.
+  gfx::BinaryTracePtr binary_trace_;
   // String containing the HTML to display.
   std::string html_string_;
   // For blocking until end of frame.
   port::Semaphore semaphore_;
   // Current state of tracing.
   State state_;
+  // What the next frame collects.
+  Collection collection_;
+  // Whether renderer resources are kept rather than released before a frame
+  // is captured.
+  bool keep_resources_for_capture_;
+  // Records the calls of a captured frame.
+  gfx::FrameCapturePtr frame_capture_;
+  // Whether call statistics were enabled in the GraphicsManager before they
+  // were collected, so that the setting can be restored.
+  bool prev_call_statistics_enabled_;
   // Stores the frame counter when the last trace was added.
   uint64 frame_counter_;
   // String containing the names of renderer resources to delete before the
   // next frame (may be empty).
   std::string resources_to_delete_;
 
-  // Allow the tests to access GetTracingStream().
+  // Allow the tests to access GetBinaryTrace().
   friend class TracingHandlerTest;
 };
 
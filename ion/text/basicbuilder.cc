@@ -70,7 +70,13 @@ static const char* kFragmentShaderSource =
     "uniform vec4 uTextColor;\n"
     "\n"
     "void main(void) {\n"
+    "#ifdef ION_MULTI_CHANNEL_SDF\n"
+    "  vec3 msdf = texture2D(uSdfSampler, texture_coords).rgb;\n"
+    "  float dist = max(min(msdf.r, msdf.g),\n"
+    "      min(max(msdf.r, msdf.g), msdf.b));\n"
+    "#else\n"
     "  float dist = texture2D(uSdfSampler, texture_coords).r;\n"
+    "#endif\n"
     "  float s = uSdfPadding == 0. ? 0.2 : 0.2 / uSdfPadding;\n"
     "  float d = 1.0 - smoothstep(-s, s, dist - 0.5);\n"
     "  if (dist > 0.5 + s)\n"
@@ -0,0 +1,378 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/text/batchbuilder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ion/base/invalid.h"
+#include "ion/base/logging.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/texture.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfxutils/buffertoattributebinder.h"
+#include "ion/math/range.h"
+#include "ion/math/transformutils.h"
+#include "ion/text/font.h"
+#include "ion/text/fontimage.h"
+
+namespace ion {
+namespace text {
+
+namespace {
+
+//-----------------------------------------------------------------------------
+//
+// Shader source strings.
+//
+//-----------------------------------------------------------------------------
+
+static const char* kVertexShaderSource =
+    "uniform mat4 uProjectionMatrix;\n"
+    "uniform mat4 uModelviewMatrix;\n"
+    "attribute vec3 aVertex;\n"
+    "attribute vec2 aTexCoords;\n"
+    "attribute vec4 aColor;\n"
+    "varying vec2 texture_coords;\n"
+    "varying vec4 text_color;\n"
+    "\n"
+    "void main(void) {\n"
+    "  texture_coords = aTexCoords;\n"
+    "  text_color = aColor;\n"
+    "  gl_Position = uProjectionMatrix * uModelviewMatrix * vec4(aVertex, 1);\n"
+    "}\n";
+
+static const char* kFragmentShaderSource =
+    "#ifdef GL_ES\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#endif\n"
+    "\n"
+    "varying vec2 texture_coords;\n"
+    "varying vec4 text_color;\n"
+    "uniform sampler2D uSdfSampler;\n"
+    "uniform float uSdfPadding;\n"
+    "\n"
+    "void main(void) {\n"
+    "#ifdef ION_MULTI_CHANNEL_SDF\n"
+    "  vec3 msdf = texture2D(uSdfSampler, texture_coords).rgb;\n"
+    "  float dist = max(min(msdf.r, msdf.g),\n"
+    "      min(max(msdf.r, msdf.g), msdf.b));\n"
+    "#else\n"
+    "  float dist = texture2D(uSdfSampler, texture_coords).r;\n"
+    "#endif\n"
+    "  float s = uSdfPadding == 0. ? 0.2 : 0.2 / uSdfPadding;\n"
+    "  float d = 1.0 - smoothstep(-s, s, dist - 0.5);\n"
+    "  if (dist > 0.5 + s)\n"
+    "    discard;\n"
+    "  gl_FragColor = d * text_color;\n"
+    "}\n";
+
+// Returns the number of glyph slots that a label needs.
+static size_t GetSlotCount(const Layout& layout, size_t capacity) {
+  return std::max(layout.GetGlyphCount(), capacity);
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// BatchBuilder functions.
+//
+//-----------------------------------------------------------------------------
+
+BatchBuilder::BatchBuilder(const FontImagePtr& font_image,
+                           const gfxutils::ShaderManagerPtr& shader_manager,
+                           const base::AllocatorPtr& allocator)
+    : Builder(font_image, shader_manager, allocator),
+      labels_(GetAllocator()),
+      vertices_(NULL),
+      needs_rebuild_(true) {}
+
+BatchBuilder::~BatchBuilder() {}
+
+size_t BatchBuilder::AddLabel(const Layout& layout,
+                              const math::Matrix4f& transform,
+                              const math::Vector4f& color,
+                              size_t capacity) {
+  labels_.push_back(Label(layout, transform, color, capacity));
+  needs_rebuild_ = true;
+  return labels_.size() - 1U;
+}
+
+void BatchBuilder::ClearLabels() {
+  labels_.clear();
+  needs_rebuild_ = true;
+}
+
+bool BatchBuilder::SetLabelLayout(size_t index, const Layout& layout) {
+  if (index >= labels_.size())
+    return false;
+  labels_[index].layout = layout;
+  UpdateLabelInPlace(index, true);
+  return true;
+}
+
+bool BatchBuilder::SetLabelTransform(size_t index,
+                                     const math::Matrix4f& transform) {
+  if (index >= labels_.size())
+    return false;
+  labels_[index].transform = transform;
+  UpdateLabelInPlace(index, false);
+  return true;
+}
+
+bool BatchBuilder::SetLabelColor(size_t index,
+                                 const math::Vector4f& color) {
+  if (index >= labels_.size())
+    return false;
+  labels_[index].color = color;
+  UpdateLabelInPlace(index, false);
+  return true;
+}
+
+size_t BatchBuilder::GetLabelFirstVertex(size_t index) const {
+  return index < labels_.size() ? 4U * labels_[index].first_glyph : 0U;
+}
+
+size_t BatchBuilder::GetLabelVertexCount(size_t index) const {
+  return index < labels_.size() ? 4U * labels_[index].built_capacity : 0U;
+}
+
+bool BatchBuilder::BuildBatch(gfx::BufferObject::UsageMode usage_mode) {
+  vertex_container_.Reset();
+  vertices_ = NULL;
+
+  // Empty glyph slots are filled with degenerate quads of any glyph that is
+  // in the batch, so that they do not add glyphs to the FontImage.
+  GlyphIndex filler_glyph = 0;
+  size_t slot_count = 0;
+  for (auto it = labels_.begin(); it != labels_.end(); ++it) {
+    if (!filler_glyph && it->layout.GetGlyphCount())
+      filler_glyph = it->layout.GetGlyph(0).glyph_index;
+    slot_count += GetSlotCount(it->layout, it->capacity);
+  }
+  if (!filler_glyph)
+    return false;
+
+  // Store the transformed glyphs of all labels in a single Layout.
+  batch_layout_ = Layout();
+  batch_layout_.Reserve(slot_count);
+  for (auto it = labels_.begin(); it != labels_.end(); ++it) {
+    Label& label = *it;
+    label.first_glyph = batch_layout_.GetGlyphCount();
+    label.built_capacity = GetSlotCount(label.layout, label.capacity);
+    const size_t glyph_count = label.layout.GetGlyphCount();
+    const math::Point3f origin = label.transform * math::Point3f::Zero();
+    for (size_t i = 0; i < label.built_capacity; ++i) {
+      Layout::Glyph glyph;
+      if (i < glyph_count) {
+        glyph = label.layout.GetGlyph(i);
+        for (int j = 0; j < 4; ++j)
+          glyph.quad.points[j] = label.transform * glyph.quad.points[j];
+      } else {
+        glyph.glyph_index = filler_glyph;
+        glyph.quad = Layout::Quad(origin, origin, origin, origin);
+      }
+      batch_layout_.AddGlyph(glyph);
+    }
+  }
+
+  if (!Build(batch_layout_, usage_mode))
+    return false;
+  needs_rebuild_ = false;
+
+  // Keep a pointer to the vertex data if it can be updated in place.
+  if (usage_mode != gfx::BufferObject::kStaticDraw) {
+    const gfx::AttributeArrayPtr& attr_array =
+        GetNode()->GetShapes()[0]->GetAttributeArray();
+    const gfx::Attribute& attr = attr_array->GetBufferAttribute(0);
+    const gfx::BufferObjectPtr& bo =
+        attr.GetValue<gfx::BufferObjectElement>().buffer_object;
+    vertex_container_ = bo->GetData();
+    if (vertex_container_.Get())
+      vertices_ = vertex_container_->GetMutableData<Vertex>();
+  }
+  return true;
+}
+
+const gfx::ShaderInputRegistryPtr BatchBuilder::GetShaderInputRegistry() {
+  gfx::ShaderInputRegistryPtr reg(new(GetAllocator()) gfx::ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(gfx::ShaderInputRegistry::UniformSpec(
+      "uSdfPadding", gfx::kFloatUniform, "SDF padding amount"));
+  reg->Add(gfx::ShaderInputRegistry::UniformSpec(
+      "uSdfSampler", gfx::kTextureUniform, "SDF font texture sampler"));
+  return reg;
+}
+
+void BatchBuilder::GetShaderStrings(std::string* id_string,
+                                    std::string* vertex_source,
+                                    std::string* fragment_source) {
+  *id_string = "Batch Text Shader";
+  *vertex_source = kVertexShaderSource;
+  *fragment_source = kFragmentShaderSource;
+}
+
+void BatchBuilder::UpdateUniforms(const gfx::ShaderInputRegistryPtr& registry,
+                                  gfx::Node* node) {
+  const Font* font = GetFont().Get();
+  const float sdf_padding =
+      font ? static_cast<float>(font->GetSdfPadding()) : 0.f;
+  // Add uniforms if not already there.
+  if (node->GetUniforms().size() < 2U)
+    node->ClearUniforms();
+  if (node->GetUniforms().empty()) {
+    node->AddUniform(registry->Create<gfx::Uniform>(
+        "uSdfPadding", sdf_padding));
+    node->AddUniform(registry->Create<gfx::Uniform>(
+        "uSdfSampler", GetFontImageTexture()));
+  } else {
+    node->SetUniformValue<float>(0U, sdf_padding);
+    UpdateFontImageTextureUniform(1U, node);
+  }
+}
+
+void BatchBuilder::BindAttributes(const gfx::AttributeArrayPtr& attr_array,
+                                  const gfx::BufferObjectPtr& buffer_object) {
+  Vertex v;
+  gfxutils::BufferToAttributeBinder<Vertex>(v)
+      .Bind(v.position, "aVertex")
+      .Bind(v.texture_coords, "aTexCoords")
+      .Bind(v.color, "aColor")
+      .Apply(gfx::ShaderInputRegistry::GetGlobalRegistry(), attr_array,
+             buffer_object);
+}
+
+base::AllocVector<char> BatchBuilder::BuildVertexData(const Layout& layout,
+                                                      size_t* vertex_size,
+                                                      size_t* num_vertices) {
+  // There are 4 vertices per glyph.
+  const size_t num_glyphs = layout.GetGlyphCount();
+  *num_vertices = 4 * num_glyphs;
+  *vertex_size = sizeof(Vertex);
+  base::AllocVector<char> vertex_data(
+      GetAllocator()->GetAllocatorForLifetime(base::kShortTerm));
+  vertex_data.resize(sizeof(Vertex) * (*num_vertices));
+  Vertex* vertices = reinterpret_cast<Vertex*>(&vertex_data[0]);
+  math::Point3f positions[4];
+  math::Point2f texture_coords[4];
+
+  // A Layout passed directly to Build() is treated as a single white label.
+  const math::Vector4f white(1.f, 1.f, 1.f, 1.f);
+  const bool is_batch = &layout == &batch_layout_;
+  size_t label_index = 0;
+  for (size_t i = 0; i < num_glyphs; ++i) {
+    if (is_batch) {
+      while (i >= labels_[label_index].first_glyph +
+                      labels_[label_index].built_capacity)
+        ++label_index;
+    }
+    const math::Vector4f& color =
+        is_batch ? labels_[label_index].color : white;
+    StoreGlyphVertices(layout, i, positions, texture_coords);
+    for (int j = 0; j < 4; ++j)
+      vertices[4 * i + j] = Vertex(positions[j], texture_coords[j], color);
+  }
+  return vertex_data;
+}
+
+void BatchBuilder::StoreLabelVertices(const Label& label,
+                                      const FontImage::ImageData* image_data,
+                                      Vertex* vertices) {
+  const size_t glyph_count = label.layout.GetGlyphCount();
+  const math::Point3f origin = label.transform * math::Point3f::Zero();
+  math::Point2f texture_coords[4];
+  for (size_t i = 0; i < label.built_capacity; ++i) {
+    Vertex* quad = &vertices[4 * i];
+    const bool has_glyph = i < glyph_count;
+    if (image_data) {
+      if (has_glyph)
+        GetGlyphTextureCoords(*image_data, label.layout.GetGlyph(i).glyph_index,
+                              texture_coords);
+      for (int j = 0; j < 4; ++j)
+        quad[j].texture_coords =
+            has_glyph ? texture_coords[j] : math::Point2f::Zero();
+    }
+    for (int j = 0; j < 4; ++j) {
+      quad[j].position =
+          has_glyph ? label.transform * label.layout.GetGlyph(i).quad.points[j]
+                    : origin;
+      quad[j].color = label.color;
+    }
+  }
+}
+
+bool BatchBuilder::UpdateLabelInPlace(size_t index,
+                                      bool update_texture_coords) {
+  Label& label = labels_[index];
+  if (needs_rebuild_ || !vertices_ ||
+      label.layout.GetGlyphCount() > label.built_capacity) {
+    needs_rebuild_ = true;
+    return false;
+  }
+
+  // New glyphs must be in the image that the Node already uses.
+  const FontImage::ImageData* image_data = NULL;
+  if (update_texture_coords && label.layout.GetGlyphCount()) {
+    GlyphSet glyph_set(GetAllocator()->GetAllocatorForLifetime(
+        base::kShortTerm));
+    label.layout.GetGlyphSet(&glyph_set);
+    const FontImage::ImageData& data =
+        GetFontImage()->FindImageData(glyph_set);
+    const gfx::TexturePtr& texture =
+        GetNode()->GetUniforms()[1].GetValue<gfx::TexturePtr>();
+    if (base::IsInvalidReference(data) ||
+        data.texture.Get() != texture.Get()) {
+      needs_rebuild_ = true;
+      return false;
+    }
+    image_data = &data;
+  }
+
+  if (!label.built_capacity)
+    return true;
+  Vertex* vertices = &vertices_[4U * label.first_glyph];
+  StoreLabelVertices(label, image_data, vertices);
+
+  // Upload only the label's range of the buffer.
+  const gfx::AttributeArrayPtr& attr_array =
+      GetNode()->GetShapes()[0]->GetAttributeArray();
+  const gfx::BufferObjectPtr& bo = attr_array->GetBufferAttribute(0)
+      .GetValue<gfx::BufferObjectElement>().buffer_object;
+  const size_t offset = 4U * label.first_glyph * sizeof(Vertex);
+  const size_t size = 4U * label.built_capacity * sizeof(Vertex);
+  bo->SetSubData(
+      math::Range1ui(static_cast<uint32>(offset),
+                     static_cast<uint32>(offset + size)),
+      base::DataContainer::CreateAndCopy<char>(
+          reinterpret_cast<const char*>(vertices), size, true,
+          GetAllocator()));
+  return true;
+}
+
+}  // namespace text
+}  // namespace ion
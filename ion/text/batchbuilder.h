@@ -0,0 +1,177 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_TEXT_BATCHBUILDER_H_
+#define ION_TEXT_BATCHBUILDER_H_
+
+#include "ion/base/datacontainer.h"
+#include "ion/base/stlalloc/allocvector.h"
+#include "ion/math/matrix.h"
+#include "ion/math/vector.h"
+#include "ion/text/builder.h"
+#include "ion/text/layout.h"
+
+namespace ion {
+namespace text {
+
+// BatchBuilder is a derived Builder class that builds any number of text
+// labels that share a FontImage into a single Node with one Shape, so that all
+// of them are drawn with one draw call from one vertex buffer and one index
+// buffer. Each label has a Layout, a transform that is applied to its glyph
+// quads, and a color.
+//
+// Each label occupies a fixed range of the vertex buffer, which is large
+// enough for the label's capacity. After BuildBatch() has been called with a
+// usage mode other than kStaticDraw, changes to a single label are written to
+// its range of the buffer and uploaded as sub-data, without touching the other
+// labels. Changes that do not fit in place (adding a label, a Layout with
+// more glyphs than the label's capacity, or glyphs that are not in the image
+// used by the batch) take effect at the next call to BuildBatch().
+//
+// The Node contains the following uniforms:
+//   uSdfPadding       [float, derived from Font]
+//     Number of pixels used to pad SDF images.
+//   uSdfSampler       [sampler2D, derived from FontImage]
+//     Sampler for the SDF texture.
+// The color of each label is stored in the aColor vertex attribute.
+class ION_API BatchBuilder : public Builder {
+ public:
+  BatchBuilder(const FontImagePtr& font_image,
+               const gfxutils::ShaderManagerPtr& shader_manager,
+               const base::AllocatorPtr& allocator);
+
+  // Adds a label and returns its index. The label reserves room in the vertex
+  // buffer for the larger of capacity and the number of glyphs in layout.
+  size_t AddLabel(const Layout& layout, const math::Matrix4f& transform,
+                  const math::Vector4f& color, size_t capacity);
+
+  // Returns the number of labels.
+  size_t GetLabelCount() const { return labels_.size(); }
+
+  // Removes all labels.
+  void ClearLabels();
+
+  // Each of these modifies the indexed label, updating its vertices in place
+  // if possible. They return false if the index is out of range.
+  bool SetLabelLayout(size_t index, const Layout& layout);
+  bool SetLabelTransform(size_t index, const math::Matrix4f& transform);
+  bool SetLabelColor(size_t index, const math::Vector4f& color);
+
+  // Returns the index of the first vertex of the indexed label and the number
+  // of vertices it occupies, as of the last call to BuildBatch(). Both are 0
+  // if the index is out of range or the label has not been built.
+  size_t GetLabelFirstVertex(size_t index) const;
+  size_t GetLabelVertexCount(size_t index) const;
+
+  // Returns true if there are changes that require a call to BuildBatch().
+  bool NeedsRebuild() const { return needs_rebuild_; }
+
+  // Builds all labels into the Node returned by GetNode(). The usage_mode is
+  // passed to the buffer objects as in Builder::Build(); use kDynamicDraw or
+  // kStreamDraw to allow labels to be updated in place. Returns false if
+  // there are no glyphs in any label or if the glyphs cannot all be found in
+  // a single image of the FontImage.
+  bool BuildBatch(gfx::BufferObject::UsageMode usage_mode);
+
+ protected:
+  // The destructor is protected because all base::Referent classes must have
+  // protected or private destructors.
+  ~BatchBuilder() override;
+
+  // Required Builder functions.
+  const gfx::ShaderInputRegistryPtr GetShaderInputRegistry() override;
+  void GetShaderStrings(std::string* id_string,
+                        std::string* vertex_source,
+                        std::string* fragment_source) override;
+  void UpdateUniforms(const gfx::ShaderInputRegistryPtr& registry,
+                      gfx::Node* node) override;
+  void BindAttributes(const gfx::AttributeArrayPtr& attr_array,
+                      const gfx::BufferObjectPtr& buffer_object) override;
+  base::AllocVector<char> BuildVertexData(const Layout& layout,
+                                          size_t* vertex_size,
+                                          size_t* num_vertices) override;
+
+ private:
+  // A Vertex in the AttributeArray for the text.
+  struct Vertex {
+    Vertex() {}
+    Vertex(const math::Point3f& position_in,
+           const math::Point2f& texture_coords_in,
+           const math::Vector4f& color_in)
+        : position(position_in),
+          texture_coords(texture_coords_in),
+          color(color_in) {}
+    math::Point3f position;
+    math::Point2f texture_coords;
+    math::Vector4f color;
+  };
+
+  // A label added with AddLabel().
+  struct Label {
+    Label(const Layout& layout_in, const math::Matrix4f& transform_in,
+          const math::Vector4f& color_in, size_t capacity_in)
+        : layout(layout_in),
+          transform(transform_in),
+          color(color_in),
+          capacity(capacity_in),
+          first_glyph(0),
+          built_capacity(0) {}
+    Layout layout;
+    math::Matrix4f transform;
+    math::Vector4f color;
+    // Number of glyphs to reserve room for.
+    size_t capacity;
+    // Index of the first glyph slot and number of slots in the built buffer.
+    size_t first_glyph;
+    size_t built_capacity;
+  };
+
+  // Writes the vertices of all glyph slots of a label to vertices, which has
+  // room for the label's built capacity. Glyph slots past the end of the
+  // label's Layout hold degenerate quads. If image_data is NULL, the texture
+  // coordinates already in vertices are kept.
+  static void StoreLabelVertices(const Label& label,
+                                 const FontImage::ImageData* image_data,
+                                 Vertex* vertices);
+
+  // Rewrites the vertices of the indexed label in the built vertex buffer and
+  // uploads them as sub-data. If update_texture_coords is true, the texture
+  // coordinates are updated too, which requires all of the label's glyphs to
+  // be in the image the batch was built with. Returns false and marks the
+  // batch as needing a rebuild if that is not possible.
+  bool UpdateLabelInPlace(size_t index, bool update_texture_coords);
+
+  // Labels in the order they were added.
+  base::AllocVector<Label> labels_;
+  // The Layout passed to Builder::Build() by BuildBatch(). Each label has as
+  // many glyphs in it as its capacity.
+  Layout batch_layout_;
+  // The vertex data of the built BufferObject, which is written in place when
+  // a label changes. This is NULL if the data may not be modified.
+  base::DataContainerPtr vertex_container_;
+  Vertex* vertices_;
+  // Whether BuildBatch() needs to be called for changes to take effect.
+  bool needs_rebuild_;
+};
+
+// Convenience typedef for shared pointer to a BatchBuilder.
+typedef base::ReferentPtr<BatchBuilder>::Type BatchBuilderPtr;
+
+}  // namespace text
+}  // namespace ion
+
+#endif  // ION_TEXT_BATCHBUILDER_H_
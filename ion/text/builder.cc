@@ -21,6 +21,7 @@ limitations under the License.
 #include "ion/base/datacontainer.h"
 #include "ion/base/invalid.h"
 #include "ion/base/logging.h"
+#include "ion/base/samplingallocationtracker.h"
 #include "ion/gfx/indexbuffer.h"
 #include "ion/gfx/statetable.h"
 #include "ion/gfx/texture.h"
@@ -66,8 +67,39 @@ static const gfx::StateTablePtr BuildStateTable(
   return state_table;
 }
 
+// Stores the indices of the 2 triangles of each of num_glyphs quads in an
+// IndexBuffer with the given index type.
+template <typename IndexType>
+static void StoreIndices(size_t num_glyphs,
+                         gfx::BufferObject::UsageMode usage_mode,
+                         gfx::BufferObject::ComponentType component_type,
+                         const base::AllocatorPtr& allocator,
+                         gfx::IndexBuffer* index_buffer) {
+  base::AllocVector<IndexType> indices(
+      allocator->GetAllocatorForLifetime(base::kShortTerm));
+  indices.reserve(6 * num_glyphs);  // 2 triangles per glyph.
+
+  for (size_t i = 0; i < num_glyphs; ++i) {
+    indices.push_back(static_cast<IndexType>(4 * i + 0));
+    indices.push_back(static_cast<IndexType>(4 * i + 1));
+    indices.push_back(static_cast<IndexType>(4 * i + 2));
+    indices.push_back(static_cast<IndexType>(4 * i + 0));
+    indices.push_back(static_cast<IndexType>(4 * i + 2));
+    indices.push_back(static_cast<IndexType>(4 * i + 3));
+  }
+
+  base::DataContainerPtr container =
+      base::DataContainer::CreateAndCopy<IndexType>(
+          &indices[0], indices.size(),
+          usage_mode == gfx::BufferObject::kStaticDraw, allocator);
+  index_buffer->AddSpec(component_type, 1, 0);
+  index_buffer->SetData(container, sizeof(indices[0]), indices.size(),
+                        usage_mode);
+}
+
 // Creates and returns an IndexBuffer representing the indices of triangles
-// representing text. The IndexBuffer will contain unsigned short indices. The
+// representing text. The IndexBuffer will contain unsigned short indices, or
+// unsigned int indices if there are too many vertices for unsigned shorts. The
 // buffer data will be marked as wipeable if the usage_mode is
 // gfx::BufferObject::kStaticDraw. The allocator is used for the resulting
 // buffer; if it is NULL, the default short-term allocator is used.
@@ -78,39 +110,28 @@ static const gfx::IndexBufferPtr BuildIndexBuffer(
       base::AllocationManager::GetNonNullAllocator(allocator);
 
   const size_t num_glyphs = layout.GetGlyphCount();
-  base::AllocVector<uint16> indices(
-      al->GetAllocatorForLifetime(base::kShortTerm));
-  indices.reserve(6 * num_glyphs);  // 2 triangles per glyph.
-
-  for (size_t i = 0; i < num_glyphs; ++i) {
-    indices.push_back(static_cast<uint16>(4 * i + 0));
-    indices.push_back(static_cast<uint16>(4 * i + 1));
-    indices.push_back(static_cast<uint16>(4 * i + 2));
-    indices.push_back(static_cast<uint16>(4 * i + 0));
-    indices.push_back(static_cast<uint16>(4 * i + 2));
-    indices.push_back(static_cast<uint16>(4 * i + 3));
-  }
-
   gfx::IndexBufferPtr index_buffer(new(al) gfx::IndexBuffer);
-  base::DataContainerPtr container =
-      base::DataContainer::CreateAndCopy<uint16>(
-          &indices[0], indices.size(),
-          usage_mode == gfx::BufferObject::kStaticDraw, al);
-  index_buffer->AddSpec(gfx::BufferObject::kUnsignedShort, 1, 0);
-  index_buffer->SetData(container, sizeof(indices[0]), indices.size(),
-                        usage_mode);
+  if (4 * num_glyphs <= (1U << 16))
+    StoreIndices<uint16>(num_glyphs, usage_mode,
+                         gfx::BufferObject::kUnsignedShort, al,
+                         index_buffer.Get());
+  else
+    StoreIndices<uint32>(num_glyphs, usage_mode,
+                         gfx::BufferObject::kUnsignedInt, al,
+                         index_buffer.Get());
   return index_buffer;
 }
 
-static const gfx::BufferObjectPtr GetBufferObject(
+// Returns the BufferObject bound to the AttributeArray, if any. The pointer is
+// borrowed from the AttributeArray, which avoids a reference count update.
+static gfx::BufferObject* GetBufferObject(
     const gfx::AttributeArray& attr_array) {
-  gfx::BufferObjectPtr bo;
   if (attr_array.GetBufferAttributeCount() >= 1U) {
     const gfx::Attribute& attr = attr_array.GetBufferAttribute(0);
     DCHECK_EQ(attr.GetType(), gfx::kBufferObjectElementAttribute);
-    bo = attr.GetValue<gfx::BufferObjectElement>().buffer_object;
+    return attr.GetValue<gfx::BufferObjectElement>().buffer_object.Get();
   }
-  return bo;
+  return NULL;
 }
 
 static bool CanBufferObjectBeReused(const gfx::BufferObject& bo,
@@ -146,6 +167,7 @@ bool Builder::Build(const Layout& layout,
   // If the FontImage was not created or the Layout is empty, just return false.
   if (!font_image_.Get() || !layout.GetGlyphCount())
     return false;
+  base::SamplingAllocationTracker::ScopedTag tag("text");
 
   // Determine the FontImage::ImageData instance that contains all the
   // necessary glyphs. If successful, cache a pointer to it during
@@ -193,6 +215,14 @@ const gfx::ShaderProgramPtr Builder::BuildShaderProgram() {
   std::string fragment_source;
   GetShaderStrings(&id_string, &vertex_source, &fragment_source);
 
+  // The fragment shader takes the median of the channels of a multi-channel
+  // SDF image (see Font::SetMultiChannelSdf()), which needs its own program.
+  const FontPtr font = GetFont();
+  if (font.Get() && font->GetMultiChannelSdf()) {
+    id_string += " (MSDF)";
+    fragment_source = "#define ION_MULTI_CHANNEL_SDF\n" + fragment_source;
+  }
+
   gfx::ShaderProgramPtr program;
   if (shader_manager_.Get()) {
     // If there is a ShaderManager, use it to compose the program.
@@ -245,15 +275,24 @@ void Builder::StoreGlyphVertices(const Layout& layout, size_t glyph_index,
   const Layout::Glyph& glyph = layout.GetGlyph(glyph_index);
   DCHECK(!base::IsInvalidReference(glyph));
 
-  math::Range2f texcoord_rect;
   DCHECK(image_data_);
-  if (FontImage::GetTextureCoords(*image_data_, glyph.glyph_index,
-                                  &texcoord_rect)) {
+  if (GetGlyphTextureCoords(*image_data_, glyph.glyph_index, texture_coords)) {
     for (int i = 0; i < 4; ++i) {
       positions[i] = glyph.quad.points[i];
       text_extents_.ExtendByPoint(positions[i]);
     }
+  } else {
+    // Use empty rectangles for glyphs that are not available in the font.
+    for (int i = 0; i < 4; ++i)
+      positions[i] = math::Point3f::Zero();
+  }
+}
 
+bool Builder::GetGlyphTextureCoords(const FontImage::ImageData& image_data,
+                                    GlyphIndex glyph_index,
+                                    math::Point2f texture_coords[4]) {
+  math::Range2f texcoord_rect;
+  if (FontImage::GetTextureCoords(image_data, glyph_index, &texcoord_rect)) {
     const float u_min = texcoord_rect.GetMinPoint()[0];
     const float u_max = texcoord_rect.GetMaxPoint()[0];
     // Invert v because OpenGL flips images vertically.
@@ -263,13 +302,11 @@ void Builder::StoreGlyphVertices(const Layout& layout, size_t glyph_index,
     texture_coords[1].Set(u_max, v_min);
     texture_coords[2].Set(u_max, v_max);
     texture_coords[3].Set(u_min, v_max);
-  } else {
-    // Use empty rectangles for glyphs that are not available in the font.
-    for (int i = 0; i < 4; ++i) {
-      positions[i] = math::Point3f::Zero();
-      texture_coords[i] = math::Point2f::Zero();
-    }
+    return true;
   }
+  for (int i = 0; i < 4; ++i)
+    texture_coords[i] = math::Point2f::Zero();
+  return false;
 }
 
 bool Builder::UpdateAttributeArray(
@@ -289,11 +326,13 @@ bool Builder::UpdateAttributeArray(
 
   // Access the BufferObject from the AttributeArray. If there isn't one,
   // create one.
-  gfx::BufferObjectPtr bo = GetBufferObject(*attr_array);
+  gfx::BufferObject* bo = GetBufferObject(*attr_array);
+  gfx::BufferObjectPtr new_bo;
   bool reuse_buffer = false;
-  if (!bo.Get()) {
+  if (!bo) {
     // If there isn't a BufferObject, create one.
-    bo = new (allocator) gfx::BufferObject;
+    new_bo = new (allocator) gfx::BufferObject;
+    bo = new_bo.Get();
   } else {
     // If there is one, see if it can be reused.  This requires the same number
     // of vertices, a valid DataContainer, and a UsageMode that allows updates.
@@ -316,7 +355,7 @@ bool Builder::UpdateAttributeArray(
 
     // Bind the BufferObject to the AttributeArray if it was just created.
     if (!attr_array->GetBufferAttributeCount()) {
-      BindAttributes(attr_array, bo);
+      BindAttributes(attr_array, new_bo);
     }
   }
   return reuse_buffer;
@@ -337,7 +376,12 @@ void Builder::UpdateShape(
   // IndexBuffer in the Shape is ok to use as is.
   const bool buffer_reused =
       UpdateAttributeArray(layout, usage_mode, shape->GetAttributeArray());
-  if (!shape->GetIndexBuffer().Get() || !buffer_reused) {
+  UpdateIndexBuffer(layout, buffer_reused, shape);
+}
+
+void Builder::UpdateIndexBuffer(const Layout& layout, bool vertices_reused,
+                                gfx::Shape* shape) {
+  if (!shape->GetIndexBuffer().Get() || !vertices_reused) {
     shape->SetIndexBuffer(BuildIndexBuffer(
         layout, gfx::BufferObject::kStaticDraw, allocator_));
   }
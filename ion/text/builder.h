@@ -102,7 +102,10 @@ class ION_API Builder : public base::Referent {
   // Returns the ShaderInputRegistry for the Builder's shaders.
   virtual const gfx::ShaderInputRegistryPtr GetShaderInputRegistry() = 0;
 
-  // Returns the strings needed for shader definition.
+  // Returns the strings needed for shader definition. If the font has
+  // multi-channel SDF images, ION_MULTI_CHANNEL_SDF is defined at the top of
+  // the fragment shader, which should then sample the median of the RGB
+  // channels of the SDF texture instead of the red channel.
   virtual void GetShaderStrings(std::string* id_string,
                                 std::string* vertex_source,
                                 std::string* fragment_source) = 0;
@@ -122,6 +125,17 @@ class ION_API Builder : public base::Referent {
                                                   size_t* vertex_size,
                                                   size_t* num_vertices) = 0;
 
+  //----------------------------------------------------------------------------
+  // Functions that derived classes may override.
+
+  // Sets up the IndexBuffer of the Shape after its vertex data has been
+  // updated for the Layout. |vertices_reused| is true if the vertex
+  // BufferObject was reused, in which case the current IndexBuffer, if any,
+  // still matches it. The default implementation builds 2 triangles for every
+  // 4 vertices.
+  virtual void UpdateIndexBuffer(const Layout& layout, bool vertices_reused,
+                                 gfx::Shape* shape);
+
   //----------------------------------------------------------------------------
   // Convenience functions for derived classes.
 
@@ -146,6 +160,13 @@ class ION_API Builder : public base::Referent {
                           math::Point3f positions[4],
                           math::Point2f texture_coords[4]);
 
+  // Fills in the texture_coords for the 4 vertices of a glyph quad from the
+  // glyph's rectangle in an ImageData. Returns false and sets them all to zero
+  // if the glyph is not in the ImageData.
+  static bool GetGlyphTextureCoords(const FontImage::ImageData& image_data,
+                                    GlyphIndex glyph_index,
+                                    math::Point2f texture_coords[4]);
+
  private:
   // Builds and returns a ShaderProgram, calling virtual functions to set up
   // the various parts.
@@ -19,11 +19,14 @@ limitations under the License.
 
 #include <cctype>
 #include <limits>
+#include <vector>
 
 #include "ion/base/invalid.h"
 #include "ion/base/lockguards.h"
 #include "ion/base/logging.h"
+#include "ion/base/taskscheduler.h"
 #include "ion/math/rangeutils.h"
+#include "ion/math/utils.h"
 #include "ion/math/vector.h"
 #include "ion/text/layout.h"
 #include "ion/text/sdfutils.h"
@@ -32,17 +35,24 @@ namespace ion {
 namespace text {
 
 Font::GlyphGrid::GlyphGrid(size_t width, size_t height)
-  : pixels(width, height), is_sdf(false) {}
+  : pixels(width, height), is_sdf(false), is_quantized(false) {}
 
 bool Font::GlyphGrid::IsZeroSize() const {
-  return pixels.GetWidth() * pixels.GetHeight() == 0;
+  return GetWidth() * GetHeight() == 0;
 }
 
 Font::Font(const std::string& name, size_t size_in_pixels, size_t sdf_padding)
     : size_in_pixels_(size_in_pixels),
       name_(name),
       sdf_padding_(sdf_padding),
-      glyph_grid_map_(*this) {}
+      sdf_scheduler_(NULL),
+      quantize_grids_(false),
+      multi_channel_sdf_(false) {
+  glyph_map_shards_.reserve(kGlyphMapShardCount);
+  for (size_t i = 0; i < kGlyphMapShardCount; ++i)
+    glyph_map_shards_.push_back(
+        std::unique_ptr<GlyphMapShard>(new GlyphMapShard(*this)));
+}
 
 Font::~Font() {}
 
@@ -53,21 +63,21 @@ const Font::GlyphGrid& Font::GetGlyphGrid(GlyphIndex glyph_index) const {
 }
 
 Font::GlyphGrid* Font::GetMutableGlyphGrid(GlyphIndex glyph_index) const {
-  base::LockGuard guard(&mutex_);
-  return GetMutableGlyphGridLocked(glyph_index);
-}
-
-Font::GlyphGrid* Font::GetMutableGlyphGridLocked(GlyphIndex glyph_index) const {
-  DCHECK(mutex_.IsLocked());
   if (!glyph_index) {
     return NULL;
   }
-  const auto& it = glyph_grid_map_.find(glyph_index);
-  if (it == glyph_grid_map_.end()) {
+  GlyphMapShard& shard = GetGlyphMapShard(glyph_index);
+  base::LockGuard guard(&shard.mutex);
+  const auto& it = shard.glyphs.find(glyph_index);
+  if (it == shard.glyphs.end()) {
     GlyphGrid glyph;
     if (LoadGlyphGrid(glyph_index, &glyph)) {
-      glyph_grid_map_[glyph_index] = glyph;
-      return &glyph_grid_map_[glyph_index];
+      QuantizeCoverage(&glyph);
+      // Entries of the map never move, so the pointer remains valid after the
+      // lock is released.
+      GlyphGrid& added = shard.glyphs[glyph_index];
+      added = glyph;
+      return &added;
     }
     return NULL;
   }
@@ -78,12 +88,20 @@ bool Font::LoadGlyphGrid(GlyphIndex glyph_index, GlyphGrid* glyph_data) const {
   return false;
 }
 
+bool Font::LoadGlyphOutline(GlyphIndex glyph_index,
+                            GlyphOutline* outline) const {
+  return false;
+}
+
 const Font::GlyphGrid& Font::AddGlyph(GlyphIndex glyph_index,
                                       const GlyphGrid& glyph) const {
   if (base::IsInvalidReference(glyph))
     return glyph;
-  base::LockGuard guard(&mutex_);
-  return glyph_grid_map_[glyph_index] = glyph;
+  GlyphMapShard& shard = GetGlyphMapShard(glyph_index);
+  base::LockGuard guard(&shard.mutex);
+  GlyphGrid& added = shard.glyphs[glyph_index] = glyph;
+  QuantizeCoverage(&added);
+  return added;
 }
 
 void Font::SetFontMetrics(const FontMetrics& metrics) {
@@ -95,18 +113,79 @@ void Font::SetFontMetrics(const FontMetrics& metrics) {
 void Font::CacheSdfGrids(const GlyphSet& glyph_set) {
   // This has to be implemented as a FontImage member function because
   // Font::CacheSdfGrid() is protected and FontImage is a friend.
-  const size_t sdf_padding = GetSdfPadding();
-  for (auto it = glyph_set.cbegin(); it != glyph_set.cend(); ++it) {
-    GlyphGrid* glyph_grid = GetMutableGlyphGrid(*it);
-    DCHECK(!base::IsInvalidReference(glyph_grid));
-    // Make sure the glyph's grid stores SDF values.
-    if (!glyph_grid->is_sdf) {
-      CacheSdfGrid(*it, ComputeSdfGrid(glyph_grid->pixels, sdf_padding));
-      DCHECK(glyph_grid->is_sdf);
+  if (!sdf_scheduler_) {
+    for (auto it = glyph_set.cbegin(); it != glyph_set.cend(); ++it) {
+      GlyphGrid* glyph_grid = GetMutableGlyphGrid(*it);
+      DCHECK(!base::IsInvalidReference(glyph_grid));
+      // Make sure the glyph's grid stores SDF values.
+      if (multi_channel_sdf_ && !glyph_grid->HasMultiChannelSdf())
+        ComputeGlyphMsdf(*it, *glyph_grid, &glyph_grid->msdf_pixels);
+      if (!glyph_grid->is_sdf) {
+        CacheSdfGrid(*it, ComputeGlyphSdf(*glyph_grid));
+        DCHECK(glyph_grid->is_sdf);
+      }
+    }
+    return;
+  }
+
+  // Load the glyphs and compute the SDF grids of those that need them in
+  // parallel, then cache the grids. Loading is thread-safe, GlyphGrids are not
+  // moved by loading other glyphs, and ComputeSdfGrid() only reads them.
+  const std::vector<GlyphIndex> indices(glyph_set.cbegin(), glyph_set.cend());
+  std::vector<base::Array2<double> > sdf_grids(indices.size());
+  std::vector<base::Array2<math::Vector3ui8> > msdf_grids(indices.size());
+  std::vector<uint8> computed(indices.size(), 0U);
+  std::vector<uint8> msdf_computed(indices.size(), 0U);
+  sdf_scheduler_->ParallelFor(
+      0U, indices.size(), 0U,
+      [this, &indices, &sdf_grids, &msdf_grids, &computed, &msdf_computed](
+          size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+          const GlyphGrid* glyph_grid = GetMutableGlyphGrid(indices[i]);
+          DCHECK(!base::IsInvalidReference(glyph_grid));
+          if (!glyph_grid)
+            continue;
+          if (multi_channel_sdf_ && !glyph_grid->HasMultiChannelSdf())
+            msdf_computed[i] = ComputeGlyphMsdf(indices[i], *glyph_grid,
+                                                &msdf_grids[i]);
+          if (!glyph_grid->is_sdf) {
+            sdf_grids[i] = ComputeGlyphSdf(*glyph_grid);
+            computed[i] = 1U;
+          }
+        }
+      });
+  for (size_t i = 0; i < indices.size(); ++i) {
+    if (msdf_computed[i])
+      GetMutableGlyphGrid(indices[i])->msdf_pixels = msdf_grids[i];
+    if (computed[i])
+      CacheSdfGrid(indices[i], sdf_grids[i]);
+  }
+}
+
+void Font::GetSdfGlyphs(GlyphSet* glyph_set) const {
+  for (size_t i = 0; i < kGlyphMapShardCount; ++i) {
+    GlyphMapShard& shard = *glyph_map_shards_[i];
+    base::LockGuard guard(&shard.mutex);
+    for (auto it = shard.glyphs.cbegin(); it != shard.glyphs.cend(); ++it) {
+      if (it->second.is_sdf)
+        glyph_set->insert(it->first);
     }
   }
 }
 
+bool Font::AddSdfGrid(GlyphIndex glyph_index,
+                      const base::Array2<double>& sdf_pixels) {
+  if (!glyph_index)
+    return false;
+  GlyphMapShard& shard = GetGlyphMapShard(glyph_index);
+  base::LockGuard guard(&shard.mutex);
+  GlyphGrid& grid = shard.glyphs[glyph_index];
+  if (grid.is_sdf)
+    return false;
+  StoreSdfPixels(sdf_pixels, &grid);
+  return true;
+}
+
 bool Font::CacheSdfGrid(GlyphIndex glyph_index,
                         const base::Array2<double>& sdf_pixels) {
   GlyphGrid* grid = GetMutableGlyphGrid(glyph_index);
@@ -115,17 +194,99 @@ bool Font::CacheSdfGrid(GlyphIndex glyph_index,
   } else if (grid->is_sdf) {
     LOG(ERROR) << "Grid is already an SDF grid";
   } else {
-    grid->pixels = sdf_pixels;
-    grid->is_sdf = true;
+    StoreSdfPixels(sdf_pixels, grid);
     return true;
   }
   return false;
 }
 
+void Font::QuantizeCoverage(GlyphGrid* grid) const {
+  if (!quantize_grids_ || grid->is_quantized || grid->is_sdf)
+    return;
+  const size_t width = grid->pixels.GetWidth();
+  const size_t height = grid->pixels.GetHeight();
+  grid->quantized_pixels = base::Array2<uint8>(width, height);
+  if (const size_t count = width * height) {
+    const double* pixels = &grid->pixels.Get(0, 0);
+    uint8* quantized = grid->quantized_pixels.GetMutable(0, 0);
+    for (size_t i = 0; i < count; ++i)
+      quantized[i] = static_cast<uint8>(
+          math::Clamp(pixels[i], 0.0, 1.0) * 255.0 + 0.5);
+  }
+  grid->pixels = base::Array2<double>();
+  grid->is_quantized = true;
+}
+
+void Font::StoreSdfPixels(const base::Array2<double>& sdf_pixels,
+                          GlyphGrid* grid) const {
+  grid->is_sdf = true;
+  if (!quantize_grids_) {
+    grid->pixels = sdf_pixels;
+    grid->quantized_pixels = base::Array2<uint8>();
+    grid->is_quantized = false;
+    return;
+  }
+  const size_t width = sdf_pixels.GetWidth();
+  const size_t height = sdf_pixels.GetHeight();
+  grid->quantized_pixels = base::Array2<uint8>(width, height);
+  if (const size_t count = width * height) {
+    const double* pixels = &sdf_pixels.Get(0, 0);
+    uint8* quantized = grid->quantized_pixels.GetMutable(0, 0);
+    for (size_t i = 0; i < count; ++i)
+      quantized[i] = QuantizeSdfValue(pixels[i], sdf_padding_);
+  }
+  grid->pixels = base::Array2<double>();
+  grid->is_quantized = true;
+}
+
+const base::Array2<double> Font::ComputeGlyphSdf(const GlyphGrid& grid) const {
+  DCHECK(!grid.is_sdf);
+  if (!grid.is_quantized)
+    return ComputeSdfGrid(grid.pixels, sdf_padding_);
+
+  // Convert the coverage values back to doubles only while the SDF grid is
+  // computed.
+  const size_t width = grid.quantized_pixels.GetWidth();
+  const size_t height = grid.quantized_pixels.GetHeight();
+  base::Array2<double> coverage(width, height);
+  if (const size_t count = width * height) {
+    const uint8* quantized = &grid.quantized_pixels.Get(0, 0);
+    double* pixels = coverage.GetMutable(0, 0);
+    for (size_t i = 0; i < count; ++i)
+      pixels[i] = static_cast<double>(quantized[i]) / 255.0;
+  }
+  return ComputeSdfGrid(coverage, sdf_padding_);
+}
+
+bool Font::ComputeGlyphMsdf(GlyphIndex glyph_index, const GlyphGrid& grid,
+                            base::Array2<math::Vector3ui8>* msdf_pixels) const {
+  // The outline is in the coordinates of the unpadded coverage grid.
+  const size_t padding = grid.is_sdf ? 2U * sdf_padding_ : 0U;
+  if (grid.GetWidth() < padding || grid.GetHeight() < padding)
+    return false;
+  GlyphOutline outline;
+  if (!LoadGlyphOutline(glyph_index, &outline))
+    return false;
+  const base::Array2<math::Vector3d> msdf =
+      ComputeMsdfGrid(outline, grid.GetWidth() - padding,
+                      grid.GetHeight() - padding, sdf_padding_);
+  const size_t width = msdf.GetWidth();
+  const size_t height = msdf.GetHeight();
+  *msdf_pixels = base::Array2<math::Vector3ui8>(width, height);
+  if (const size_t count = width * height) {
+    const math::Vector3d* distances = &msdf.Get(0, 0);
+    math::Vector3ui8* quantized = msdf_pixels->GetMutable(0, 0);
+    for (size_t i = 0; i < count; ++i) {
+      for (int c = 0; c < 3; ++c)
+        quantized[i][c] = QuantizeSdfValue(distances[i][c], sdf_padding_);
+    }
+  }
+  return true;
+}
+
 void Font::FilterGlyphs(GlyphSet* glyph_set) {
-  base::LockGuard guard(&mutex_);
   for (auto it = glyph_set->begin(); it != glyph_set->end();) {
-    GlyphGrid* glyph = GetMutableGlyphGridLocked(*it);
+    const GlyphGrid* glyph = GetMutableGlyphGrid(*it);
     if (!glyph || glyph->IsZeroSize()) {
       glyph_set->erase(it++);
     } else {
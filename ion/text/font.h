@@ -18,7 +18,9 @@ limitations under the License.
 #ifndef ION_TEXT_FONT_H_
 #define ION_TEXT_FONT_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "ion/base/allocator.h"
 #include "ion/base/array2.h"
@@ -26,9 +28,15 @@ limitations under the License.
 #include "ion/base/referent.h"
 #include "ion/base/stlalloc/allocmap.h"
 #include "ion/math/vector.h"
+#include "ion/port/mutex.h"
 #include "ion/text/layout.h"
+#include "ion/text/sdfutils.h"
 
 namespace ion {
+namespace base {
+class TaskScheduler;
+}  // namespace base
+
 namespace text {
 
 // Typedef for a Unicode index of a character.
@@ -46,19 +54,44 @@ class ION_API Font : public base::Referent {
   // pixel coverage in the range (0,1). This is used internally to create
   // signed-distance field images for a font.
   struct GlyphGrid {
-    GlyphGrid() : pixels(), is_sdf(false) {}
+    GlyphGrid() : pixels(), is_sdf(false), is_quantized(false) {}
     GlyphGrid(size_t width, size_t height);
 
-    // TODO(user): Try making this a smaller type than double.
+    // The values of the grid, unless it is quantized.
     base::Array2<double> pixels;
 
+    // The values of the grid if it is quantized, in which case pixels is
+    // empty. Coverage values are scaled to [0,255], and SDF values are
+    // quantized by QuantizeSdfValue() with the SDF padding of the font. See
+    // Font::SetQuantizeGrids().
+    base::Array2<uint8> quantized_pixels;
+
+    // The multi-channel SDF values of the glyph, quantized like
+    // quantized_pixels, if the font computes them and the glyph has an
+    // outline; empty otherwise. See Font::SetMultiChannelSdf().
+    base::Array2<math::Vector3ui8> msdf_pixels;
+
+    // Returns the size of the grid, however it is stored.
+    size_t GetWidth() const {
+      return is_quantized ? quantized_pixels.GetWidth() : pixels.GetWidth();
+    }
+    size_t GetHeight() const {
+      return is_quantized ? quantized_pixels.GetHeight() : pixels.GetHeight();
+    }
+
     // Returns true if glyph x- *or* y-size is zero.
     bool IsZeroSize() const;
 
+    // Returns true if the grid has multi-channel SDF values.
+    bool HasMultiChannelSdf() const { return msdf_pixels.GetWidth() != 0U; }
+
     // When a Font is set up for rendering, the pixels are replaced with a
     // signed-distance field (SDF). This flag is set to true if the grid has
     // SDF data (vs. the original rendered data).
     bool is_sdf;
+
+    // Whether the values are stored in quantized_pixels rather than pixels.
+    bool is_quantized;
   };
 
   // This struct represents the cumulative metrics for the font.
@@ -120,9 +153,53 @@ class ION_API Font : public base::Referent {
   // Makes sure that the GlyphData for each glyph in glyph_set has an SDF grid
   // cached inside the font. This assumes that the requested glyphs are
   // available in the font. There is no real need to call this outside of Ion's
-  // internal code.
+  // internal code. If an SDF task scheduler is set, the glyphs are loaded and
+  // their SDF grids computed in parallel on its threads.
   void CacheSdfGrids(const GlyphSet& glyph_set);
 
+  // Adds the glyphs that have an SDF grid cached inside the font to
+  // |glyph_set|.
+  void GetSdfGlyphs(GlyphSet* glyph_set) const;
+
+  // Stores a previously computed SDF grid for a glyph, e.g., one read from a
+  // glyph cache (see glyphcache.h), so that the glyph does not have to be
+  // loaded or have its SDF grid computed again. The grid must have been
+  // computed for this font. Returns false without changing anything if the
+  // glyph already has an SDF grid or the index is 0.
+  bool AddSdfGrid(GlyphIndex glyph_index,
+                  const base::Array2<double>& sdf_pixels);
+
+  // Sets whether the font stores its glyph grids quantized to 8 bits (see
+  // GlyphGrid::quantized_pixels), which uses an eighth of the memory of
+  // doubles. The quantized SDF values are the ones that FontImage stores, so
+  // this does not change the font images. Only glyphs that are loaded or get
+  // SDF grids afterwards are quantized, so this should be set before the font
+  // is used. The default is false.
+  void SetQuantizeGrids(bool quantize) { quantize_grids_ = quantize; }
+  bool GetQuantizeGrids() const { return quantize_grids_; }
+
+  // Sets the TaskScheduler used by CacheSdfGrids(), which must outlive this
+  // font or be reset to NULL, the default, which computes all grids on the
+  // calling thread. Computing grids in parallel mostly helps fonts with many
+  // glyphs, such as CJK fonts.
+  void SetSdfTaskScheduler(base::TaskScheduler* scheduler) {
+    sdf_scheduler_ = scheduler;
+  }
+  base::TaskScheduler* GetSdfTaskScheduler() const { return sdf_scheduler_; }
+
+  // Sets whether CacheSdfGrids() also computes multi-channel SDF grids (see
+  // ComputeMsdfGrid()) from the outlines of the glyphs, which FontImage then
+  // stores in RGB images instead of single-channel SDF images. Text builders
+  // reconstruct the distance from the median of the channels, which keeps
+  // corners sharp at much smaller glyph sizes, so a smaller font size can be
+  // used for the same quality. Glyphs without outlines, such as those of
+  // bitmap fonts, store their single-channel SDF in all channels. This should
+  // be set before the font is used. The default is false.
+  void SetMultiChannelSdf(bool multi_channel) {
+    multi_channel_sdf_ = multi_channel;
+  }
+  bool GetMultiChannelSdf() const { return multi_channel_sdf_; }
+
   // Causes this font to use the font |fallback| as a fallback if a requested
   // glyph is not found. This is useful in internationalization cases, as few
   // fonts contain glyphs for enough unicode codepoints to satisfy most
@@ -143,15 +220,21 @@ class ION_API Font : public base::Referent {
   // Non-const version of GetGlyphGrid.
   GlyphGrid* GetMutableGlyphGrid(GlyphIndex glyph_index) const;
 
-  // Prelocked version of GetMutableGlyphGrid.
-  GlyphGrid* GetMutableGlyphGridLocked(GlyphIndex glyph_index) const;
-
   // Called by GetGlyphGrid() for missing glyphs. Child classes that load glyphs
   // on-demand should override this method to load the result into
-  // glyph_grid. Returns true if a glyph was loaded.
+  // glyph_grid. Returns true if a glyph was loaded. This may be called from
+  // several threads at once for different glyphs.
   virtual bool LoadGlyphGrid(GlyphIndex glyph_index,
                              GlyphGrid* glyph_grid) const;
 
+  // Called by CacheSdfGrids() to get the outline of a glyph for its
+  // multi-channel SDF grid, in the coordinates of its GlyphGrid (see
+  // OutlineContour). Child classes that can provide outlines should override
+  // this method; the default returns false, as it should when the glyph has no
+  // outline. This may be called from several threads at once.
+  virtual bool LoadGlyphOutline(GlyphIndex glyph_index,
+                                GlyphOutline* outline) const;
+
   // Adds a GlyphGrid to the GlyphMap.
   const GlyphGrid& AddGlyph(GlyphIndex glyph_index,
                             const GlyphGrid& glyph) const;
@@ -169,17 +252,57 @@ class ION_API Font : public base::Referent {
   const size_t size_in_pixels_;
 
  private:
+  // The number of shards that the glyph grids are split into.
+  static const size_t kGlyphMapShardCount = 16;
+
+  // The glyph grids are split by glyph index into shards, each with its own
+  // lock, so that threads looking up or loading different glyphs rarely wait
+  // for each other.
+  struct GlyphMapShard {
+    explicit GlyphMapShard(const base::Allocatable& owner) : glyphs(owner) {}
+    // Grid for each glyph in the shard, keyed by glyph index.
+    GlyphMap glyphs;
+    // Protects glyphs.
+    port::Mutex mutex;
+  };
+
+  // Quantizes the coverage values of a grid that is not an SDF grid, if the
+  // font quantizes its grids.
+  void QuantizeCoverage(GlyphGrid* grid) const;
+
+  // Stores SDF values in a grid, quantizing them if the font quantizes its
+  // grids.
+  void StoreSdfPixels(const base::Array2<double>& sdf_pixels,
+                      GlyphGrid* grid) const;
+
+  // Returns the SDF grid computed from the coverage values of a grid.
+  const base::Array2<double> ComputeGlyphSdf(const GlyphGrid& grid) const;
+
+  // Computes the quantized multi-channel SDF grid of a glyph from its outline.
+  // Returns false if the glyph has no outline.
+  bool ComputeGlyphMsdf(GlyphIndex glyph_index, const GlyphGrid& grid,
+                        base::Array2<math::Vector3ui8>* msdf_pixels) const;
+
+  // Returns the shard that stores the grid of a glyph.
+  GlyphMapShard& GetGlyphMapShard(GlyphIndex glyph_index) const {
+    return *glyph_map_shards_[glyph_index % kGlyphMapShardCount];
+  }
+
   // Name of the font.
   const std::string name_;
   // Padding (in pixels) on each edge of each SDF glyph.
   const size_t sdf_padding_;
   // Metrics for the entire font.
   FontMetrics font_metrics_;
-  // Grid for each glyph in the font, keyed by glyph index. Mutable to
-  // support on-demand glyph loading from GetGlyphGrid() const method.
-  mutable GlyphMap glyph_grid_map_;
-  // Protect glyph_grid_map_. Mutable to allow locking from const methods.
-  mutable port::Mutex mutex_;
+  // Grids for the glyphs in the font. The shards are mutable to support
+  // on-demand glyph loading and locking from const methods.
+  std::vector<std::unique_ptr<GlyphMapShard> > glyph_map_shards_;
+  // Computes SDF grids in CacheSdfGrids() if not NULL.
+  base::TaskScheduler* sdf_scheduler_;
+  // Whether grids are stored quantized to 8 bits.
+  bool quantize_grids_;
+  // Whether CacheSdfGrids() computes multi-channel SDF grids.
+  bool multi_channel_sdf_;
 
   DISALLOW_IMPLICIT_CONSTRUCTORS(Font);
 };
@@ -17,7 +17,10 @@ limitations under the License.
 
 #include "ion/text/fontimage.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iterator>
+#include <utility>
 #include <vector>
 
 #include "base/integral_types.h"
@@ -28,10 +31,10 @@ limitations under the License.
 #include "ion/base/serialize.h"
 #include "ion/base/staticsafedeclare.h"
 #include "ion/gfx/sampler.h"
+#include "ion/image/binpacker.h"
 #include "ion/image/conversionutils.h"
 #include "ion/math/utils.h"
 #include "ion/math/vector.h"
-#include "ion/text/binpacker.h"
 #include "ion/text/font.h"
 #include "ion/text/sdfutils.h"
 
@@ -46,6 +49,7 @@ using gfx::Sampler;
 using gfx::SamplerPtr;
 using gfx::Texture;
 using gfx::TexturePtr;
+using image::BinPacker;
 using math::Point2f;
 using math::Point2ui;
 using math::Range2f;
@@ -58,14 +62,14 @@ using math::Vector2ui;
 //
 //-----------------------------------------------------------------------------
 
-// An SdfGrid is a 2D array of doubles representing a signed-distance field.
-typedef base::Array2<double> SdfGrid;
+// An SdfGrid is a glyph grid holding a signed-distance field, as doubles or
+// already quantized.
+typedef Font::GlyphGrid SdfGrid;
 
-// An SdfGridMap maps a GlyphIndex (font specific index) to an SdfGrid
-// representing the glyph. The SdfGrid is a copy of the SDF grid in
-// the Font so that the FontImage can normalize the copy (based on the full
-// FontImage) without affecting the Font's version.
-typedef base::AllocMap<GlyphIndex, SdfGrid> SdfGridMap;
+// An SdfGridMap maps a GlyphIndex (font specific index) to the SdfGrid
+// representing the glyph, which is cached in the Font. The grids are
+// quantized straight into images, so they are not copied.
+typedef base::AllocMap<GlyphIndex, const SdfGrid*> SdfGridMap;
 
 // Convenience typedef for a TexRectMap.
 typedef FontImage::ImageData::TexRectMap TexRectMap;
@@ -76,7 +80,8 @@ struct ImageDataWrapper  {
   explicit ImageDataWrapper(const base::AllocatorPtr& allocator)
       : image_data(allocator),
         packed_area(0),
-        used_area_fraction(0.f) {}
+        used_area_fraction(0.f),
+        last_use(allocator) {}
 
   // The wrapped ImageData instance.
   FontImage::ImageData image_data;
@@ -89,6 +94,9 @@ struct ImageDataWrapper  {
 
   // Fraction of area used.
   float used_area_fraction;
+
+  // Use serial of the last FindImageData() call that found each glyph.
+  base::AllocMap<GlyphIndex, uint64> last_use;
 };
 
 // This struct wraps the Texture and sub-image data it needs for deferred
@@ -120,8 +128,8 @@ static const SdfGridMap BuildSdfGridMap(const Font& font,
   for (auto it = glyph_set.begin(); it != glyph_set.end(); ++it) {
     const Font::GlyphGrid& glyph_grid = font.GetGlyphGrid(*it);
     DCHECK(!base::IsInvalidReference(glyph_grid));
-    // Copy the grid so it can be normalized without affecting the Font.
-    grid_map[*it] = glyph_grid.pixels;
+    DCHECK(glyph_grid.is_sdf);
+    grid_map[*it] = &glyph_grid;
   }
   return grid_map;
 }
@@ -130,7 +138,7 @@ static const SdfGridMap BuildSdfGridMap(const Font& font,
 // grids with 0 area.
 static void AddGridsToBinPacker(const SdfGridMap& grids, BinPacker* packer) {
   for (SdfGridMap::const_iterator it = grids.begin(); it != grids.end(); ++it) {
-    const SdfGrid& grid = it->second;
+    const SdfGrid& grid = *it->second;
     const uint32 width = static_cast<uint32>(grid.GetWidth());
     const uint32 height = static_cast<uint32>(grid.GetHeight());
     if (width * height)
@@ -142,89 +150,19 @@ static void AddGridsToBinPacker(const SdfGridMap& grids, BinPacker* packer) {
 static size_t ComputeTotalGridArea(const SdfGridMap& grids) {
   size_t area = 0;
   for (SdfGridMap::const_iterator it = grids.begin(); it != grids.end(); ++it) {
-    const SdfGrid& grid = it->second;
+    const SdfGrid& grid = *it->second;
     area += grid.GetWidth() * grid.GetHeight();
   }
   return area;
 }
 
-// Inserts a single SdfGrid into a composite SdfGrid.
-static void InsertGrid(const SdfGrid& grid, const Point2ui& bottom_left,
-                       SdfGrid* composite_grid) {
-  DCHECK_LE(bottom_left[0] + grid.GetWidth(), composite_grid->GetWidth());
-  DCHECK_LE(bottom_left[1] + grid.GetHeight(), composite_grid->GetHeight());
-
-  const size_t width = grid.GetWidth();
-  const size_t height = grid.GetHeight();
-  for (size_t y = 0; y < height; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      composite_grid->Set(x + bottom_left[0], y + bottom_left[1],
-                          grid.Get(x, y));
-    }
-  }
-}
-
-// Scales each value in an SdfGrid by a constant factor, clamps the result to
-// [-1,1], and then transforms it into [0,1].
-static void NormalizeGrid(const double scale_factor, SdfGrid* grid) {
-  const size_t width = grid->GetWidth();
-  const size_t height = grid->GetHeight();
-
-  for (size_t y = 0; y < height; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      // Scale.
-      const double d = scale_factor * grid->Get(x, y);
-      // Clamp to [-1,1], and transform to [0,1].
-      grid->Set(x, y, (math::Clamp(d, -1.0, 1.0) + 1.0) * 0.5);
-    }
-  }
-}
-
-// Calls NormalizeGrid() to normalize all of the grids in the passed map. The
-// padding is used to calculate the scale (see NormalizeGrid(), above).
-static void NormalizeGridsInMap(size_t sdf_padding, SdfGridMap* grids) {
-  const float scale_factor =
-      sdf_padding ? 1.0f / static_cast<float>(sdf_padding) : 1.0f;
-  for (SdfGridMap::iterator it = grids->begin(); it != grids->end(); ++it)
-    NormalizeGrid(scale_factor, &it->second);
-}
-
-// Creates an SdfGrid of a given size, adds a collection of SdfGrids to it
-// using the BinPacker for placement, normalizes it based on a padding value,
-// and returns it.
-static const SdfGrid CreatePackedGrid(
-    const SdfGridMap& grids, const BinPacker& bin_packer,
-    uint32 width, uint32 height, size_t sdf_padding) {
-  // Use a large value for the initial values of the packed grid so background
-  // pixels correspond to the maximum SDF distance.
-  const double initial_value = static_cast<double>(width + height);
-  SdfGrid packed_grid(width, height, initial_value);
-
-  const std::vector<BinPacker::Rectangle>& rects = bin_packer.GetRectangles();
-  const size_t count = rects.size();
-  for (size_t i = 0; i < count; ++i) {
-    const BinPacker::Rectangle& rect = rects[i];
-    SdfGridMap::const_iterator it =
-        grids.find(static_cast<GlyphIndex>(rect.id));
-    DCHECK(it != grids.end());
-    InsertGrid(it->second, rect.bottom_left, &packed_grid);
-  }
-
-  const float scale_factor =
-      sdf_padding ? 1.0f / static_cast<float>(sdf_padding) : 1.0f;
-  NormalizeGrid(scale_factor, &packed_grid);
-  return packed_grid;
-}
-
 // Repeatedly tries to use a BinPacker to fit a collection of SdfGrids into a
-// single packed SdfGrid with power-of-2 dimensions and the specified SDF
-// padding, doubling the width or height as necessary to make them fit. If
-// successful, the BinPacker's rectangles are updated with the grid locations
-// and the resulting SdfGrid is returned. Otherwise, an empty SdfGrid is
+// single image with power-of-2 dimensions, doubling the width or height as
+// necessary to make them fit. If successful, the BinPacker's rectangles are
+// updated with the grid locations, the size is returned in |size|, and true is
 // returned.
-static const SdfGrid PackIntoMinimalGrid(
-    const SdfGridMap& grids, size_t max_image_size, size_t sdf_padding,
-    BinPacker* bin_packer) {
+static bool PackIntoMinimalSize(const SdfGridMap& grids, size_t max_image_size,
+                                BinPacker* bin_packer, Vector2ui* size) {
   // Compute the total area of the grids to aid with packing.
   const size_t total_area = ComputeTotalGridArea(grids);
   DCHECK_GT(total_area, 0U);
@@ -232,7 +170,7 @@ static const SdfGrid PackIntoMinimalGrid(
   // If the total area is greater than the maximum allowable area, there is no
   // way packing will be successful.
   if (total_area > math::Square(max_image_size))
-    return SdfGrid();
+    return false;
 
   // Start with a reasonable power-of-2 size for the final grid and increase if
   // necessary until everything fits.
@@ -251,11 +189,10 @@ static const SdfGrid PackIntoMinimalGrid(
       image_height *= 2;
     double_the_width = !double_the_width;
     if (image_width > max_image_size || image_height > max_image_size)
-      return SdfGrid();
+      return false;
   }
-
-  return CreatePackedGrid(grids, *bin_packer, image_width, image_height,
-                          sdf_padding);
+  size->Set(image_width, image_height);
+  return true;
 }
 
 // Allocates and returns a pointer to a SamplerPtr to use for all FontImage
@@ -285,43 +222,113 @@ static TexturePtr CreateTexture(const base::AllocatorPtr& allocator) {
   return texture;
 }
 
-// Allocates and returns a 1-channel 8-bit luminance image of the given size,
-// using the allocator. The image data is left uninitialized.
-static ImagePtr CreateImage(size_t width, size_t height,
-                            const base::AllocatorPtr& allocator) {
+// Returns the format of the images that store the SDF grids of a font: RGB
+// for multi-channel SDF grids, and luminance otherwise.
+static Image::Format GetSdfImageFormat(const Font& font) {
+  return font.GetMultiChannelSdf() ? Image::kRgb8 : Image::kLuminance;
+}
+
+// Allocates and returns an 8-bit luminance or RGB image of the given size,
+// using the allocator. All channels of all pixels are set to |value|.
+static ImagePtr CreateImage(Image::Format format, size_t width, size_t height,
+                            uint8 value, const base::AllocatorPtr& allocator) {
+  DCHECK(format == Image::kLuminance || format == Image::kRgb8);
   // Create a uint8 buffer of the correct size.
-  std::vector<uint8> data_buf(width * height);
+  const size_t channels = format == Image::kRgb8 ? 3U : 1U;
+  std::vector<uint8> data_buf(width * height * channels, value);
 
   // Store the data in the Image. The data is wipeable because any future
   // updates to the FontImage, which only happen if it is dynamic, will be done
   // via sub-images.
   ImagePtr image(new(allocator) Image);
-  image->Set(Image::kLuminance,
-             static_cast<uint32>(width), static_cast<uint32>(height),
+  image->Set(format, static_cast<uint32>(width), static_cast<uint32>(height),
              base::DataContainer::CreateAndCopy<uint8>(
                  &data_buf[0], data_buf.size(), true, allocator));
   return image;
 }
 
-// Stores data for a 1-channel 8-bit luminance image from an SdfGrid. This
-// assumes the Image has been set up correctly for the grid.
-static void StoreGridInImage(const SdfGrid& grid, const ImagePtr& image) {
+// Stores the signed distances of an SdfGrid in an 8-bit luminance or RGB image,
+// with the bottom left corner of the grid at |bottom_left|. Distances stored
+// as doubles are quantized with the SDF padding (see QuantizeSdfValue()), and
+// quantized grids are copied. An RGB image stores the multi-channel SDF values
+// of the grid if it has them, or its single-channel values in each channel.
+static void StoreGridInImage(const SdfGrid& grid, const Point2ui& bottom_left,
+                             size_t sdf_padding, const ImagePtr& image) {
   const size_t width = grid.GetWidth();
   const size_t height = grid.GetHeight();
+  if (!width || !height)
+    return;
 
   // Access the data buffer in the Image.
+  const size_t image_width = image->GetWidth();
   DCHECK(image->GetData().Get());
-  DCHECK_EQ(image->GetDataSize(), width * height);
+  DCHECK_LE(bottom_left[0] + width, image_width);
+  DCHECK_LE(bottom_left[1] + height, image->GetHeight());
   uint8* data = image->GetData()->GetMutableData<uint8>();
   DCHECK(data);
 
-  // Copy the grid data.
-  for (size_t y = 0; y < height; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      const double d = grid.Get(x, y);
-      data[y * width + x] = static_cast<uint8>(d * 255.0);
+  if (image->GetFormat() == Image::kRgb8) {
+    const bool has_msdf = grid.HasMultiChannelSdf();
+    DCHECK(!has_msdf || (grid.msdf_pixels.GetWidth() == width &&
+                         grid.msdf_pixels.GetHeight() == height));
+    for (size_t y = 0; y < height; ++y) {
+      uint8* row =
+          &data[3U * ((bottom_left[1] + y) * image_width + bottom_left[0])];
+      for (size_t x = 0; x < width; ++x) {
+        uint8* pixel = &row[3U * x];
+        if (has_msdf) {
+          const math::Vector3ui8& values = grid.msdf_pixels.Get(x, y);
+          pixel[0] = values[0];
+          pixel[1] = values[1];
+          pixel[2] = values[2];
+        } else {
+          pixel[0] = pixel[1] = pixel[2] =
+              grid.is_quantized
+                  ? grid.quantized_pixels.Get(x, y)
+                  : QuantizeSdfValue(grid.pixels.Get(x, y), sdf_padding);
+        }
+      }
     }
+    return;
+  }
+
+  if (grid.is_quantized) {
+    const uint8* values = &grid.quantized_pixels.Get(0, 0);
+    for (size_t y = 0; y < height; ++y)
+      memcpy(&data[(bottom_left[1] + y) * image_width + bottom_left[0]],
+             &values[y * width], width);
+    return;
   }
+
+  // Quantize the grid data.
+  const double* distances = &grid.pixels.Get(0, 0);
+  for (size_t y = 0; y < height; ++y) {
+    uint8* row = &data[(bottom_left[1] + y) * image_width + bottom_left[0]];
+    for (size_t x = 0; x < width; ++x)
+      row[x] = QuantizeSdfValue(distances[y * width + x], sdf_padding);
+  }
+}
+
+// Creates an image of a given size in the SDF image format of a font, stores a
+// collection of its SdfGrids in it using the BinPacker for placement, and
+// returns it. Pixels that are not covered by any grid are at the maximum SDF
+// distance.
+static const ImagePtr CreatePackedImage(
+    const SdfGridMap& grids, const BinPacker& bin_packer, uint32 width,
+    uint32 height, const Font& font, const base::AllocatorPtr& allocator) {
+  const size_t sdf_padding = font.GetSdfPadding();
+  ImagePtr image =
+      CreateImage(GetSdfImageFormat(font), width, height, 255U, allocator);
+  const std::vector<BinPacker::Rectangle>& rects = bin_packer.GetRectangles();
+  const size_t count = rects.size();
+  for (size_t i = 0; i < count; ++i) {
+    const BinPacker::Rectangle& rect = rects[i];
+    SdfGridMap::const_iterator it =
+        grids.find(static_cast<GlyphIndex>(rect.id));
+    DCHECK(it != grids.end());
+    StoreGridInImage(*it->second, rect.bottom_left, sdf_padding, image);
+  }
+  return image;
 }
 
 // Returns a Range2f representing the rectangle of texture coordinates for a
@@ -360,54 +367,209 @@ static const TexRectMap ComputeTextureRectangleMap(
 // SdfGrids in grid_map and the packing information in bin_packer.
 static void UpdateImageData(
     const SdfGridMap& grid_map, const BinPacker& bin_packer, uint32 image_size,
-    size_t sdf_padding, FontImage::ImageData* image_data,
+    const Font& font, FontImage::ImageData* image_data,
     const base::AllocatorPtr& allocator) {
-  const SdfGrid packed_grid = CreatePackedGrid(
-      grid_map, bin_packer, image_size, image_size, sdf_padding);
-  DCHECK(packed_grid.GetSize());
-
-  // Create an Image if there isn't already one in the ImageData's Texture.
-  if (!image_data->texture->HasImage(0U))
-    image_data->texture->SetImage(
-        0U, CreateImage(packed_grid.GetWidth(), packed_grid.GetHeight(),
-                        allocator));
+  DCHECK(!image_data->texture->HasImage(0U));
+  image_data->texture->SetImage(
+      0U, CreatePackedImage(grid_map, bin_packer, image_size, image_size,
+                            font, allocator));
   const ImagePtr& image = image_data->texture->GetImage(0U);
 
-  // Store the SDF data from the packed grid into the Image.
-  StoreGridInImage(packed_grid, image);
-
   // Compute per-glyph texture coordinate rectangles.
   image_data->texture_rectangle_map =
       ComputeTextureRectangleMap(*image, bin_packer);
 }
 
+// Packs the SdfGrids in grid_map, which holds the glyphs in glyph_set, into a
+// new image for the ImageData of a wrapper that does not have an image yet,
+// and updates the wrapper's GlyphSet and area values. Returns false if the
+// grids do not fit in an image of the given size.
+static bool PackImageData(const SdfGridMap& grid_map, const GlyphSet& glyph_set,
+                          uint32 image_size, const Font& font,
+                          const base::AllocatorPtr& allocator,
+                          ImageDataWrapper* wrapper) {
+  AddGridsToBinPacker(grid_map, &wrapper->bin_packer);
+  if (!wrapper->bin_packer.Pack(Vector2ui(image_size, image_size)))
+    return false;
+  UpdateImageData(grid_map, wrapper->bin_packer, image_size, font,
+                  &wrapper->image_data, allocator);
+
+  // Fill in the GlyphSet.
+  wrapper->image_data.glyph_set = glyph_set;
+
+  // Update the area values.
+  wrapper->packed_area = ComputeTotalGridArea(grid_map);
+  wrapper->used_area_fraction =
+      static_cast<float>(wrapper->packed_area) /
+      static_cast<float>(math::Square(image_size));
+  return true;
+}
+
+// Returns whether the rectangle with corner |min1| and size |size1| overlaps
+// the one with corner |min0| and size |size0|.
+static bool RectanglesOverlap(const Point2ui& min0, const Vector2ui& size0,
+                              const Point2ui& min1, const Vector2ui& size1) {
+  return min0[0] < min1[0] + size1[0] && min1[0] < min0[0] + size0[0] &&
+         min0[1] < min1[1] + size1[1] && min1[1] < min0[1] + size0[1];
+}
+
+// Returns whether the rectangle with corner |min1| and size |size1| lies
+// entirely within the one with corner |min0| and size |size0|.
+static bool RectangleContains(const Point2ui& min0, const Vector2ui& size0,
+                              const Point2ui& min1, const Vector2ui& size1) {
+  return min1[0] >= min0[0] && min1[0] + size1[0] <= min0[0] + size0[0] &&
+         min1[1] >= min0[1] && min1[1] + size1[1] <= min0[1] + size0[1];
+}
+
+// Returns the 2D corner and size of the texture region that a DeferredUpdate
+// writes.
+static const Point2ui GetUpdateCorner(const DeferredUpdate& update) {
+  return Point2ui(update.offset[0], update.offset[1]);
+}
+static const Vector2ui GetUpdateSize(const DeferredUpdate& update) {
+  return Vector2ui(update.image->GetWidth(), update.image->GetHeight());
+}
+
+// Orders DeferredUpdates by row, then by column, so that glyphs that the
+// BinPacker placed next to each other end up adjacent.
+static bool CompareUpdateCorners(const DeferredUpdate& a,
+                                 const DeferredUpdate& b) {
+  return a.offset[1] < b.offset[1] ||
+         (a.offset[1] == b.offset[1] && a.offset[0] < b.offset[0]);
+}
+
+// Merges nearby DeferredUpdates, which must all be for level 0 of the same
+// Texture, so that adding several glyphs uploads a few larger regions instead
+// of one tiny region per glyph. |rects| are all of the glyph rectangles packed
+// into the Texture. Updates are merged while the merged region is no more than
+// twice the area of the updates it replaces and overlaps no glyph rectangle
+// other than those written by the merged updates, since the pixels of any
+// other glyph are not available here. Uncovered pixels in a merged region are
+// set to the maximum SDF distance, as in CreatePackedImage(). The allocator is
+// used for merged Images.
+static void CoalesceSubImages(const std::vector<BinPacker::Rectangle>& rects,
+                              const base::AllocatorPtr& alloc,
+                              base::AllocVector<DeferredUpdate>* updates) {
+  const size_t count = updates->size();
+  if (count < 2U)
+    return;
+  std::sort(updates->begin(), updates->end(), CompareUpdateCorners);
+
+  base::AllocVector<DeferredUpdate> merged(alloc);
+  size_t first = 0;
+  while (first < count) {
+    // Extend the run [first, last) while the merged region stays compact.
+    const DeferredUpdate& first_update = (*updates)[first];
+    Point2ui min_corner = GetUpdateCorner(first_update);
+    Point2ui max_corner = min_corner + GetUpdateSize(first_update);
+    size_t member_area =
+        first_update.image->GetWidth() * first_update.image->GetHeight();
+    size_t last = first + 1;
+    for (; last < count; ++last) {
+      const DeferredUpdate& update = (*updates)[last];
+      const Point2ui corner = GetUpdateCorner(update);
+      const Vector2ui size = GetUpdateSize(update);
+      const Point2ui new_min(std::min(min_corner[0], corner[0]),
+                             std::min(min_corner[1], corner[1]));
+      const Point2ui new_max(std::max(max_corner[0], corner[0] + size[0]),
+                             std::max(max_corner[1], corner[1] + size[1]));
+      const Vector2ui new_size = new_max - new_min;
+      const size_t new_area = member_area + size[0] * size[1];
+      if (new_size[0] * new_size[1] > 2U * new_area)
+        break;
+
+      // Every glyph that the merged region overlaps must be written by one of
+      // the merged updates.
+      bool overlaps_other = false;
+      for (size_t i = 0; i < rects.size() && !overlaps_other; ++i) {
+        const BinPacker::Rectangle& rect = rects[i];
+        if (!rect.size[0] || !rect.size[1] ||
+            !RectanglesOverlap(new_min, new_size, rect.bottom_left, rect.size))
+          continue;
+        overlaps_other = true;
+        for (size_t j = first; j <= last; ++j) {
+          if (RectangleContains(GetUpdateCorner((*updates)[j]),
+                                GetUpdateSize((*updates)[j]),
+                                rect.bottom_left, rect.size)) {
+            overlaps_other = false;
+            break;
+          }
+        }
+      }
+      if (overlaps_other)
+        break;
+
+      min_corner = new_min;
+      max_corner = new_max;
+      member_area = new_area;
+    }
+
+    if (last == first + 1) {
+      merged.push_back(first_update);
+    } else {
+      // Copy the rows of each merged update into a single Image.
+      const Vector2ui size = max_corner - min_corner;
+      const Image::Format format = first_update.image->GetFormat();
+      const size_t channels = format == Image::kRgb8 ? 3U : 1U;
+      ImagePtr image = CreateImage(format, size[0], size[1], 255U, alloc);
+      uint8* data = image->GetData()->GetMutableData<uint8>();
+      for (size_t i = first; i < last; ++i) {
+        const DeferredUpdate& update = (*updates)[i];
+        DCHECK_EQ(format, update.image->GetFormat());
+        const uint32 width = update.image->GetWidth();
+        const uint32 height = update.image->GetHeight();
+        const uint8* rows = update.image->GetData()->GetData<uint8>();
+        const Vector2ui corner = GetUpdateCorner(update) - min_corner;
+        for (uint32 y = 0; y < height; ++y)
+          memcpy(&data[channels * ((corner[1] + y) * size[0] + corner[0])],
+                 &rows[channels * y * width], channels * width);
+      }
+      merged.push_back(DeferredUpdate(first_update.texture, first_update.level,
+                                      min_corner, image));
+    }
+    first = last;
+  }
+  updates->swap(merged);
+}
+
 // If updates is NULL, then adds SubImages to the passed texture for all of the
 // passed grids using the Rectangles from bin_packer. If updates is non-NULL,
 // then adds DeferredUpdates to the passed vector for all of the passed grids
-// using the Rectangles from bin_packer. The allocator is used to allocate the
-// Image data for each SubImage.
+// using the Rectangles from bin_packer. Nearby glyphs are merged into a single
+// SubImage by CoalesceSubImages(). The allocator is used to allocate the Image
+// data for each SubImage, which is in the SDF image format of the font that
+// the grids belong to.
 static void StoreSubImages(const SdfGridMap& grids, const BinPacker& bin_packer,
-                           const base::AllocatorPtr& alloc,
+                           const Font& font, const base::AllocatorPtr& alloc,
                            const TexturePtr& texture,
                            base::AllocVector<DeferredUpdate>* updates) {
   const std::vector<BinPacker::Rectangle>& rects = bin_packer.GetRectangles();
   const size_t count = rects.size();
+  base::AllocVector<DeferredUpdate> new_updates(alloc);
   for (size_t i = 0; i < count; ++i) {
     const BinPacker::Rectangle& rect = rects[i];
     const auto& it = grids.find(static_cast<GlyphIndex>(rect.id));
     // We only want the glyphs that are in the set of grids being added to the
     // image.
     if (it != grids.end()) {
-      const SdfGrid& grid = it->second;
-      ImagePtr image = CreateImage(grid.GetWidth(), grid.GetHeight(), alloc);
-      StoreGridInImage(grid, image);
-      if (updates)
-        updates->push_back(
-            DeferredUpdate(texture, 0U, rect.bottom_left, image));
-      else
-        texture->SetSubImage(0U, rect.bottom_left, image);
+      const SdfGrid& grid = *it->second;
+      ImagePtr image = CreateImage(GetSdfImageFormat(font), grid.GetWidth(),
+                                   grid.GetHeight(), 255U, alloc);
+      StoreGridInImage(grid, Point2ui::Zero(), font.GetSdfPadding(), image);
+      new_updates.push_back(
+          DeferredUpdate(texture, 0U, rect.bottom_left, image));
     }
   }
+  CoalesceSubImages(rects, alloc, &new_updates);
+
+  const size_t new_count = new_updates.size();
+  for (size_t i = 0; i < new_count; ++i) {
+    const DeferredUpdate& update = new_updates[i];
+    if (updates)
+      updates->push_back(update);
+    else
+      texture->SetSubImage(update.level, update.offset, update.image);
+  }
 }
 
 // Populates |*diff| with elements in |lhs| not in |rhs|.
@@ -508,17 +670,15 @@ const FontImage::ImageData StaticFontImage::InitImageData(
   BinPacker bin_packer;
   AddGridsToBinPacker(grid_map, &bin_packer);
 
-  // Try to pack them into a minimum-sized SdfGrid.
-  const SdfGrid packed_grid = PackIntoMinimalGrid(
-      grid_map, GetMaxImageSize(), font->GetSdfPadding(), &bin_packer);
-
-  // If successful, store the results in the ImageData.
-  if (packed_grid.GetSize()) {
-    // Create an Image from the packed grid.
+  // Try to pack them into a minimum-sized image.
+  Vector2ui image_size;
+  if (PackIntoMinimalSize(grid_map, GetMaxImageSize(), &bin_packer,
+                          &image_size)) {
+    // Quantize the grids into a packed Image and store it in the ImageData.
     ImagePtr image =
-        CreateImage(packed_grid.GetWidth(), packed_grid.GetHeight(), allocator);
+        CreatePackedImage(grid_map, bin_packer, image_size[0], image_size[1],
+                          *font, allocator);
     image_data.texture->SetImage(0U, image);
-    StoreGridInImage(packed_grid, image);
 
     // Compute per-glyph texture coordinate rectangles.
     image_data.texture_rectangle_map =
@@ -537,7 +697,10 @@ const FontImage::ImageData StaticFontImage::InitImageData(
 
 class DynamicFontImage::Helper : public Allocatable {
  public:
-  Helper() : image_data_wrappers_(*this), deferred_updates_(*this) {}
+  Helper()
+      : image_data_wrappers_(*this),
+        deferred_updates_(*this),
+        deferred_rectangles_(*this) {}
 
   // Returns the vector of ImageDataWrappers.
   base::AllocVector<ImageDataWrapper>& GetImageDataWrappers() {
@@ -549,12 +712,34 @@ class DynamicFontImage::Helper : public Allocatable {
     return deferred_updates_;
   }
 
+  // Removes all DeferredUpdates for a Texture.
+  void RemoveDeferredUpdates(const Texture* texture) {
+    deferred_updates_.erase(
+        std::remove_if(deferred_updates_.begin(), deferred_updates_.end(),
+                       [texture](const DeferredUpdate& update) {
+                         return update.texture.Get() == texture;
+                       }),
+        deferred_updates_.end());
+    deferred_rectangles_.erase(texture);
+  }
+
+  // Returns the glyph rectangles packed into each Texture that has
+  // DeferredUpdates, as of the last update.
+  base::AllocMap<const Texture*, std::vector<BinPacker::Rectangle>>&
+  GetDeferredRectangles() {
+    return deferred_rectangles_;
+  }
+
  private:
   // Vector of ImageDataWrapper instances.
   base::AllocVector<ImageDataWrapper> image_data_wrappers_;
 
   // Vector of DeferredUpdate instances.
   base::AllocVector<DeferredUpdate> deferred_updates_;
+
+  // Packed rectangles used to coalesce the DeferredUpdates of each Texture.
+  base::AllocMap<const Texture*, std::vector<BinPacker::Rectangle>>
+      deferred_rectangles_;
 };
 
 //-----------------------------------------------------------------------------
@@ -566,7 +751,9 @@ class DynamicFontImage::Helper : public Allocatable {
 DynamicFontImage::DynamicFontImage(const FontPtr& font, size_t image_size)
     : FontImage(kDynamic, font, image_size),
       helper_(new(GetAllocator()) Helper()),
-      updates_deferred_(false) {}
+      updates_deferred_(false),
+      max_atlas_memory_(0),
+      use_serial_(0) {}
 
 DynamicFontImage::~DynamicFontImage() {}
 
@@ -587,17 +774,74 @@ float DynamicFontImage::GetImageDataUsedAreaFraction(size_t index) const {
   return index < wrappers.size() ? wrappers[index].used_area_fraction : 0.f;
 }
 
+size_t DynamicFontImage::GetAtlasMemory() const {
+  return GetImageDataCount() * math::Square(GetMaxImageSize());
+}
+
+size_t DynamicFontImage::EvictUnusedGlyphs(uint64 serial) {
+  base::AllocVector<ImageDataWrapper>& wrappers =
+      helper_->GetImageDataWrappers();
+  const base::AllocatorPtr& sta =
+      GetAllocator()->GetAllocatorForLifetime(base::kShortTerm);
+  size_t evicted_count = 0;
+  for (size_t i = 0; i < wrappers.size();) {
+    ImageDataWrapper& wrapper = wrappers[i];
+    const GlyphSet& glyph_set = wrapper.image_data.glyph_set;
+    GlyphSet kept_glyph_set(sta);
+    for (auto it = glyph_set.begin(); it != glyph_set.end(); ++it) {
+      const auto& use_it = wrapper.last_use.find(*it);
+      if (use_it != wrapper.last_use.end() && use_it->second > serial)
+        kept_glyph_set.insert(*it);
+    }
+    const size_t evicted = glyph_set.size() - kept_glyph_set.size();
+    if (kept_glyph_set.empty()) {
+      // Remove the ImageData entirely.
+      DiscardDeferredUpdates(wrapper.image_data.texture.Get());
+      wrappers.erase(wrappers.begin() + i);
+      evicted_count += evicted;
+      continue;
+    }
+    if (evicted && RepackImageData(i, kept_glyph_set))
+      evicted_count += evicted;
+    ++i;
+  }
+  return evicted_count;
+}
+
 void DynamicFontImage::ProcessDeferredUpdates() {
   if (updates_deferred_) {
     base::AllocVector<DeferredUpdate>& updates = helper_->GetDeferredUpdates();
-    base::ReadLock lock(&update_lock_);
-    base::ReadGuard guard(&lock);
+    base::AllocMap<const Texture*, std::vector<BinPacker::Rectangle>>& rects =
+        helper_->GetDeferredRectangles();
+    base::WriteLock lock(&update_lock_);
+    base::WriteGuard guard(&lock);
+
+    // Updates queued by separate FindImageData() calls may be next to each
+    // other, so coalesce all of the updates for each Texture before setting
+    // them.
+    const base::AllocatorPtr& sta =
+        GetAllocator()->GetAllocatorForLifetime(base::kShortTerm);
+    base::AllocMap<const Texture*, base::AllocVector<DeferredUpdate>>
+        texture_updates(sta);
     const size_t count = updates.size();
     for (size_t i = 0; i < count; ++i) {
       const DeferredUpdate& di = updates[i];
-      di.texture->SetSubImage(di.level, di.offset, di.image);
+      auto it = texture_updates.find(di.texture.Get());
+      if (it == texture_updates.end())
+        it = texture_updates.insert(std::make_pair(
+            di.texture.Get(), base::AllocVector<DeferredUpdate>(sta))).first;
+      it->second.push_back(di);
+    }
+    for (auto it = texture_updates.begin(); it != texture_updates.end(); ++it) {
+      base::AllocVector<DeferredUpdate>& group = it->second;
+      CoalesceSubImages(rects[it->first], sta, &group);
+      for (size_t i = 0; i < group.size(); ++i) {
+        const DeferredUpdate& di = group[i];
+        di.texture->SetSubImage(di.level, di.offset, di.image);
+      }
     }
     updates.clear();
+    rects.clear();
   }
 }
 
@@ -636,10 +880,24 @@ size_t DynamicFontImage::FindImageDataIndex(
     index = FindImageDataThatFits(glyph_set);
   }
 
-  // If that didn't work, try to create a new ImageData. If this doesn't work,
-  // we're out of luck.
+  // If that didn't work, try to create a new ImageData, or to make room in an
+  // existing one if a new one would exceed the memory budget. If this doesn't
+  // work, we're out of luck.
   if (index == base::kInvalidIndex) {
-    index = AddImageData(glyph_set);
+    if (max_atlas_memory_ && GetImageDataCount() &&
+        GetAtlasMemory() + math::Square(GetMaxImageSize()) > max_atlas_memory_)
+      index = EvictGlyphsToFit(glyph_set);
+    else
+      index = AddImageData(glyph_set);
+  }
+
+  // Stamp the glyphs as used.
+  if (index != base::kInvalidIndex) {
+    ++use_serial_;
+    base::AllocMap<GlyphIndex, uint64>& last_use =
+        helper_->GetImageDataWrappers()[index].last_use;
+    for (auto it = glyph_set.begin(); it != glyph_set.end(); ++it)
+      last_use[*it] = use_serial_;
   }
 
   return index;
@@ -694,7 +952,7 @@ size_t DynamicFontImage::FindImageDataThatFits(const GlyphSet& glyph_set) {
     GlyphSet missing_glyph_set(GetAllocator());
     SetDifference(glyph_set, image_data.glyph_set, &missing_glyph_set);
     DCHECK(!missing_glyph_set.empty());
-    SdfGridMap missing_grid_map = BuildSdfGridMap(font, missing_glyph_set, sta);
+    const SdfGridMap missing_grid_map = BuildSdfGridMap(font, missing_glyph_set, sta);
 
     // Skip this ImageData if the added glyph area will exceed what remains in
     // the image.
@@ -716,17 +974,17 @@ size_t DynamicFontImage::FindImageDataThatFits(const GlyphSet& glyph_set) {
       // Save the BinPacker.
       wrapper.bin_packer = test_bin_packer;
 
-      // Normalize the grids before creating sub-images.
-      NormalizeGridsInMap(font.GetSdfPadding(), &missing_grid_map);
       // Generate sub images for the new glyphs added to the grid.
       if (updates_deferred_) {
         base::WriteLock lock(&update_lock_);
         base::WriteGuard guard(&lock);
-        StoreSubImages(missing_grid_map, test_bin_packer, sta,
+        StoreSubImages(missing_grid_map, test_bin_packer, font, sta,
                        wrapper.image_data.texture,
                        &helper_->GetDeferredUpdates());
+        helper_->GetDeferredRectangles()[wrapper.image_data.texture.Get()] =
+            test_bin_packer.GetRectangles();
       } else {
-        StoreSubImages(missing_grid_map, test_bin_packer, sta,
+        StoreSubImages(missing_grid_map, test_bin_packer, font, sta,
                        wrapper.image_data.texture, NULL);
       }
       // Compute per-glyph texture coordinate rectangles.
@@ -764,34 +1022,107 @@ size_t DynamicFontImage::AddImageData(const GlyphSet& glyph_set) {
                                    "_" + base::ValueToString(index);
   image_data.texture->SetLabel(texture_name);
 
-  // Store SdfGrids in a map for all glyphs.
+  // Store SdfGrids in a map for all glyphs, and try to pack them into an image
+  // of the proper size.
   const SdfGridMap grid_map = BuildSdfGridMap(font, glyph_set, sta);
+  const uint32 image_size = static_cast<uint32>(GetMaxImageSize());
+  if (PackImageData(grid_map, glyph_set, image_size, font, sta, &wrapper))
+    return index;
 
-  // Add the grids to the BinPacker.
-  AddGridsToBinPacker(grid_map, &wrapper.bin_packer);
+  // The grids didn't fit, so remove the wrapper.
+  wrappers.pop_back();
+  return base::kInvalidIndex;
+}
 
-  // Try to pack them into an SdfGrid of the proper size.
-  const uint32 image_size = static_cast<uint32>(GetMaxImageSize());
-  if (wrapper.bin_packer.Pack(Vector2ui(image_size, image_size))) {
-    DCHECK(!wrapper.image_data.texture->HasImage(0U));
-    UpdateImageData(grid_map, wrapper.bin_packer, image_size,
-                    font.GetSdfPadding(), &wrapper.image_data, sta);
+size_t DynamicFontImage::EvictGlyphsToFit(const GlyphSet& glyph_set) {
+  DCHECK(GetFont().Get());
+  const Font& font = *GetFont();
+  const base::AllocatorPtr& sta =
+      GetAllocator()->GetAllocatorForLifetime(base::kShortTerm);
+  const size_t max_area = math::Square(GetMaxImageSize());
+  const base::AllocVector<ImageDataWrapper>& wrappers =
+      helper_->GetImageDataWrappers();
 
-    // Fill in the GlyphSet.
-    image_data.glyph_set = glyph_set;
+  // Try the ImageData instances from the least to the most recently used.
+  std::vector<std::pair<uint64, size_t>> wrapper_order;
+  for (size_t i = 0; i < wrappers.size(); ++i) {
+    uint64 last_use = 0;
+    for (const auto& use : wrappers[i].last_use)
+      last_use = std::max(last_use, use.second);
+    wrapper_order.push_back(std::make_pair(last_use, i));
+  }
+  std::sort(wrapper_order.begin(), wrapper_order.end());
+
+  for (size_t i = 0; i < wrapper_order.size(); ++i) {
+    const size_t index = wrapper_order[i].second;
+    const ImageDataWrapper& wrapper = wrappers[index];
+
+    // Order the glyphs that may be evicted from the least recently used.
+    std::vector<std::pair<uint64, GlyphIndex>> candidates;
+    const GlyphSet& old_glyph_set = wrapper.image_data.glyph_set;
+    for (auto it = old_glyph_set.begin(); it != old_glyph_set.end(); ++it) {
+      if (!glyph_set.count(*it)) {
+        const auto& use_it = wrapper.last_use.find(*it);
+        candidates.push_back(std::make_pair(
+            use_it == wrapper.last_use.end() ? 0 : use_it->second, *it));
+      }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    // Evict glyphs until the rest fit along with the new ones.
+    GlyphSet kept_glyph_set(sta, old_glyph_set);
+    kept_glyph_set.insert(glyph_set.begin(), glyph_set.end());
+    const SdfGridMap grid_map = BuildSdfGridMap(font, kept_glyph_set, sta);
+    size_t area = ComputeTotalGridArea(grid_map);
+    for (size_t evicted = 0;; ++evicted) {
+      if (area <= max_area && RepackImageData(index, kept_glyph_set))
+        return index;
+      if (evicted == candidates.size())
+        break;
+      const GlyphIndex glyph = candidates[evicted].second;
+      const SdfGrid& grid = *grid_map.find(glyph)->second;
+      area -= grid.GetWidth() * grid.GetHeight();
+      kept_glyph_set.erase(glyph);
+    }
+  }
+  return base::kInvalidIndex;
+}
 
-    // Update the area values.
-    wrapper.packed_area = ComputeTotalGridArea(grid_map);
-    wrapper.used_area_fraction =
-        static_cast<float>(wrapper.packed_area) /
-        static_cast<float>(math::Square(image_size));
+bool DynamicFontImage::RepackImageData(size_t index,
+                                       const GlyphSet& glyph_set) {
+  const base::AllocatorPtr& allocator = GetAllocator();
+  const base::AllocatorPtr& sta =
+      allocator->GetAllocatorForLifetime(base::kShortTerm);
+  DCHECK(GetFont().Get());
+  const Font& font = *GetFont();
+  ImageDataWrapper& wrapper = helper_->GetImageDataWrappers()[index];
 
-    return index;
+  // Pack the glyphs into a new Texture, so that shapes built with the old one
+  // still have valid texture coordinates.
+  ImageDataWrapper repacked(allocator);
+  repacked.image_data.texture->SetLabel(wrapper.image_data.texture->GetLabel());
+  const SdfGridMap grid_map = BuildSdfGridMap(font, glyph_set, sta);
+  const uint32 image_size = static_cast<uint32>(GetMaxImageSize());
+  if (!PackImageData(grid_map, glyph_set, image_size, font, sta, &repacked))
+    return false;
+
+  // Keep the use serials of the remaining glyphs.
+  for (auto it = glyph_set.begin(); it != glyph_set.end(); ++it) {
+    const auto& use_it = wrapper.last_use.find(*it);
+    if (use_it != wrapper.last_use.end())
+      repacked.last_use[*it] = use_it->second;
   }
 
-  // The grids didn't fit, so remove the wrapper.
-  wrappers.pop_back();
-  return base::kInvalidIndex;
+  // The new image already contains all of the glyphs.
+  DiscardDeferredUpdates(wrapper.image_data.texture.Get());
+  wrapper = repacked;
+  return true;
+}
+
+void DynamicFontImage::DiscardDeferredUpdates(const gfx::Texture* texture) {
+  base::WriteLock lock(&update_lock_);
+  base::WriteGuard guard(&lock);
+  helper_->RemoveDeferredUpdates(texture);
 }
 
 }  // namespace text
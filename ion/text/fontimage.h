@@ -22,6 +22,7 @@ limitations under the License.
 #include <memory>
 #include <vector>
 
+#include "base/integral_types.h"
 #include "ion/base/allocator.h"
 #include "ion/base/invalid.h"
 #include "ion/base/readwritelock.h"
@@ -37,8 +38,6 @@ limitations under the License.
 namespace ion {
 namespace text {
 
-class BinPacker;
-
 //-----------------------------------------------------------------------------
 //
 // A FontImage contains image and texture coordinate information used to render
@@ -86,7 +85,7 @@ class FontImage : public base::Referent {
   const FontPtr& GetFont() { return font_; }
 
   // Returns the maximum image size passed to the constructor.
-  size_t GetMaxImageSize() { return max_image_size_; }
+  size_t GetMaxImageSize() const { return max_image_size_; }
 
   // Returns a reference to an ImageData instance that best contains the
   // requested glyphs.  Derived classes may return invalid references
@@ -189,7 +188,19 @@ typedef base::ReferentPtr<StaticFontImage>::Type StaticFontImagePtr;
 // existing ImageData or adding a new one.
 //
 // New glyphs are added to an image only in empty space so that texture
-// coordinate rectangles for previously-added glyphs remain valid.
+// coordinate rectangles for previously-added glyphs remain valid. Only the
+// regions holding new glyphs are uploaded, as Texture sub-images. Glyphs that
+// are packed next to each other share a sub-image, including glyphs added by
+// separate calls when updates are deferred.
+//
+// Each call to FindImageData() stamps the glyphs it finds with a new use
+// serial. The glyphs that were least recently used can be evicted, either
+// explicitly with EvictUnusedGlyphs() or automatically when adding an
+// ImageData would exceed the budget set with SetMaxAtlasMemory(). The
+// surviving glyphs of an ImageData are then repacked into a new Texture, which
+// changes their texture coordinates. Shapes built earlier keep the old Texture
+// and so still render correctly; rebuild them to pick up the new one and
+// release the old image.
 //
 // Since updates require adding sub-images to Textures, calling FindImageData*()
 // while the DynamicFontImage's texture is being rendered in another thread can
@@ -223,17 +234,42 @@ class DynamicFontImage : public FontImage {
   // Returns whether updates are deferred.
   bool AreUpdatesDeferred() const { return updates_deferred_; }
 
-  // Updates internal texture data with any deferred updates. The caller must
+  // Updates internal texture data with any deferred updates, merging the
+  // updates for nearby glyphs into larger sub-images. The caller must
   // ensure that the DynamicFontImage's Textures are not being rendered when
   // this is called.
   void ProcessDeferredUpdates();
 
+  // Sets the maximum number of bytes used by the images of all ImageData
+  // instances. When there is no room for new glyphs in any ImageData and
+  // adding another one would exceed this, the least recently used glyphs of
+  // an ImageData are evicted instead and the rest are repacked to make room.
+  // The first ImageData is always allowed. The default of 0 means that there
+  // is no limit.
+  void SetMaxAtlasMemory(size_t bytes) { max_atlas_memory_ = bytes; }
+  size_t GetMaxAtlasMemory() const { return max_atlas_memory_; }
+
+  // Returns the number of bytes used by the images of all ImageData
+  // instances.
+  size_t GetAtlasMemory() const;
+
+  // Returns the use serial that the last call to FindImageData() stamped the
+  // glyphs it found with.
+  uint64 GetUseSerial() const { return use_serial_; }
+
+  // Evicts all glyphs that have not been found by FindImageData() since
+  // GetUseSerial() returned serial, and repacks the remaining glyphs of each
+  // changed ImageData into a new Texture. ImageData instances left without
+  // glyphs are removed. Returns the number of glyphs evicted.
+  size_t EvictUnusedGlyphs(uint64 serial);
+
   // Implements this function to find an existing ImageData that already
   // contains all of the glyphs (present in the Font) in glyph_set. If there is
   // no such ImageData, it then tries to add the necessary glyphs to an existing
   // ImageData instance. If that doesn't work, it tries to add them all to a new
-  // ImageData instance. If none of these is successful (or if there were no
-  // valid glyphs to add), this returns an invalid reference.
+  // ImageData instance, or to evict glyphs from an existing one if that would
+  // exceed the maximum atlas memory. If none of these is successful (or if
+  // there were no valid glyphs to add), this returns an invalid reference.
   const ImageData& FindImageData(const GlyphSet& glyph_set) override;
 
   // This is the same as FindImageData(), but instead returns the index of the
@@ -266,11 +302,30 @@ class DynamicFontImage : public FontImage {
   // Returns kInvalidIndex if there is no way to fit them in a single image.
   size_t AddImageData(const GlyphSet& glyph_set);
 
+  // Evicts the least recently used glyphs from an ImageData until the glyphs
+  // in glyph_set can be repacked into it along with the remaining glyphs, and
+  // returns its index. Returns kInvalidIndex if there is no such ImageData.
+  size_t EvictGlyphsToFit(const GlyphSet& glyph_set);
+
+  // Replaces the indexed ImageData with one that has exactly the glyphs in
+  // glyph_set packed into a new Texture. Returns false, leaving the ImageData
+  // unchanged, if the glyphs do not fit.
+  bool RepackImageData(size_t index, const GlyphSet& glyph_set);
+
+  // Discards any deferred updates to a Texture that is being replaced.
+  void DiscardDeferredUpdates(const gfx::Texture* texture);
+
   std::unique_ptr<Helper> helper_;
 
   // Whether updates are deferred or immediate.
   bool updates_deferred_;
 
+  // Maximum number of bytes for all ImageData images, or 0 for no limit.
+  size_t max_atlas_memory_;
+
+  // Serial of the last call to FindImageData().
+  uint64 use_serial_;
+
   // Protects access to deferred updates.
   base::ReadWriteLock update_lock_;
 };
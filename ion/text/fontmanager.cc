@@ -19,7 +19,9 @@ limitations under the License.
 
 #include <sstream>
 
+#include "ion/base/lockguards.h"
 #include "ion/base/zipassetmanager.h"
+#include "ion/text/glyphcache.h"
 #if defined(ION_PLATFORM_MAC) || defined(ION_PLATFORM_IOS)
 #include "ion/text/coretextfont.h"
 #else
@@ -29,15 +31,47 @@ limitations under the License.
 namespace ion {
 namespace text {
 
+namespace {
+
+// Returns -1, 0 or 1 as |a| is less than, equal to, or greater than |b|.
+template <typename T>
+static int Compare(const T& a, const T& b) {
+  return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+// Orders LayoutOptions by all of their fields.
+static int CompareLayoutOptions(const LayoutOptions& a,
+                                const LayoutOptions& b) {
+  int c;
+  for (int i = 0; i < 2; ++i) {
+    if ((c = Compare(a.target_point[i], b.target_point[i])) != 0) return c;
+    if ((c = Compare(a.target_size[i], b.target_size[i])) != 0) return c;
+  }
+  if ((c = Compare(a.horizontal_alignment, b.horizontal_alignment)) != 0)
+    return c;
+  if ((c = Compare(a.vertical_alignment, b.vertical_alignment)) != 0)
+    return c;
+  return Compare(a.line_spacing, b.line_spacing);
+}
+
+}  // anonymous namespace
+
 //-----------------------------------------------------------------------------
 //
 // FontManager functions.
 //
 //-----------------------------------------------------------------------------
 
+const size_t FontManager::kDefaultLayoutCacheCapacity;
+
 FontManager::FontManager()
     : font_map_(*this),
-      font_image_map_(*this) {}
+      font_image_map_(*this),
+      mapped_file_map_(*this),
+      layout_map_(*this),
+      layout_use_map_(*this),
+      layout_cache_capacity_(kDefaultLayoutCacheCapacity),
+      layout_use_serial_(0) {}
 
 FontManager::~FontManager() {}
 
@@ -83,6 +117,39 @@ const FontPtr FontManager::AddFontFromZipasset(const std::string& font_name,
   return AddFont(font_name, size_in_pixels, sdf_padding, &data[0], data.size());
 }
 
+const FontPtr FontManager::AddFontFromFile(const std::string& font_name,
+                                           const std::string& path,
+                                           size_t size_in_pixels,
+                                           size_t sdf_padding) {
+  ion::text::FontPtr font = FindFont(font_name, size_in_pixels, sdf_padding);
+  if (font.Get())
+    return font;
+
+  // Map the file, unless a font of another size already did.
+  std::shared_ptr<port::MemoryMappedFile>& file = mapped_file_map_[path];
+  if (!file) {
+    file.reset(new port::MemoryMappedFile(path));
+    if (!file->GetData()) {
+      LOG(ERROR) << "Unable to map file \"" << path << "\" for font \""
+                 << font_name << "\".";
+      mapped_file_map_.erase(path);
+      return font;
+    }
+  }
+  return AddFont(font_name, size_in_pixels, sdf_padding, file->GetData(),
+                 file->GetLength());
+}
+
+base::ZipAssetManager::PrefetchPtr FontManager::PrefetchZipassets(
+    const std::vector<std::string>& zipasset_names) {
+  std::vector<std::string> filenames;
+  filenames.reserve(zipasset_names.size());
+  for (const std::string& name : zipasset_names)
+    filenames.push_back(name + ".ttf");
+  return base::ZipAssetManager::PrefetchFiles(
+      filenames, base::ZipAssetManager::PrefetchCallback());
+}
+
 const FontPtr FontManager::FindFont(
     const std::string& name, size_t size_in_pixels, size_t sdf_padding) const {
   const std::string key = BuildFontKey(name, size_in_pixels, sdf_padding);
@@ -90,6 +157,105 @@ const FontPtr FontManager::FindFont(
   return it == font_map_.end() ? FontPtr() : it->second;
 }
 
+bool FontManager::SaveGlyphCache(const FontPtr& font,
+                                 const std::string& path) const {
+  return font.Get() && ion::text::SaveGlyphCache(*font, path);
+}
+
+size_t FontManager::LoadGlyphCache(const FontPtr& font,
+                                   const std::string& path) {
+  return font.Get() ? ion::text::LoadGlyphCache(path, font.Get()) : 0U;
+}
+
+const CachedLayoutPtr FontManager::GetCachedLayout(
+    const FontPtr& font, const std::string& text,
+    const LayoutOptions& options) {
+  if (!font.Get())
+    return CachedLayoutPtr();
+
+  const LayoutKey key(font.Get(), text, options);
+  {
+    base::LockGuard guard(&layout_mutex_);
+    LayoutMap::iterator it = layout_map_.find(key);
+    if (it != layout_map_.end()) {
+      // Move the entry to the end of the use order.
+      LayoutEntry& entry = it->second;
+      layout_use_map_.erase(entry.last_use);
+      entry.last_use = ++layout_use_serial_;
+      layout_use_map_.insert(std::make_pair(entry.last_use, key));
+      ++layout_stats_.hits;
+      return entry.layout;
+    }
+    ++layout_stats_.misses;
+  }
+
+  // Build the Layout without holding the lock, since that may be slow.
+  CachedLayoutPtr layout(new Layout(font->BuildLayout(text, options)));
+
+  base::LockGuard guard(&layout_mutex_);
+  if (!layout_cache_capacity_)
+    return layout;
+  LayoutEntry& entry = layout_map_[key];
+  if (entry.layout) {
+    // Another thread added the same Layout while this one was building it.
+    return entry.layout;
+  }
+  entry.font = font;
+  entry.layout = layout;
+  entry.last_use = ++layout_use_serial_;
+  layout_use_map_.insert(std::make_pair(entry.last_use, key));
+  EvictLayouts(layout_cache_capacity_);
+  return layout;
+}
+
+void FontManager::SetLayoutCacheCapacity(size_t capacity) {
+  base::LockGuard guard(&layout_mutex_);
+  layout_cache_capacity_ = capacity;
+  EvictLayouts(capacity);
+}
+
+size_t FontManager::GetLayoutCacheCapacity() const {
+  base::LockGuard guard(&layout_mutex_);
+  return layout_cache_capacity_;
+}
+
+void FontManager::ClearLayoutCache() {
+  base::LockGuard guard(&layout_mutex_);
+  layout_map_.clear();
+  layout_use_map_.clear();
+}
+
+const FontManager::LayoutCacheStats FontManager::GetLayoutCacheStats() const {
+  base::LockGuard guard(&layout_mutex_);
+  LayoutCacheStats stats = layout_stats_;
+  stats.size = layout_map_.size();
+  return stats;
+}
+
+void FontManager::ResetLayoutCacheStats() {
+  base::LockGuard guard(&layout_mutex_);
+  layout_stats_ = LayoutCacheStats();
+}
+
+void FontManager::EvictLayouts(size_t capacity) {
+  while (layout_map_.size() > capacity) {
+    LayoutUseMap::iterator oldest = layout_use_map_.begin();
+    DCHECK(oldest != layout_use_map_.end());
+    layout_map_.erase(oldest->second);
+    layout_use_map_.erase(oldest);
+    ++layout_stats_.evictions;
+  }
+}
+
+bool FontManager::LayoutKey::operator<(const LayoutKey& other) const {
+  if (font != other.font)
+    return font < other.font;
+  const int c = text.compare(other.text);
+  if (c != 0)
+    return c < 0;
+  return CompareLayoutOptions(options, other.options) < 0;
+}
+
 const std::string FontManager::BuildFontKey(
     const std::string& name, size_t size_in_pixels, size_t sdf_padding) {
   std::ostringstream s;
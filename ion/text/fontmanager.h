@@ -18,18 +18,27 @@ limitations under the License.
 #ifndef ION_TEXT_FONTMANAGER_H_
 #define ION_TEXT_FONTMANAGER_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "base/integral_types.h"
 #include "ion/base/referent.h"
 #include "ion/base/stlalloc/allocmap.h"
+#include "ion/base/zipassetmanager.h"
 #include "ion/external/gtest/gunit_prod.h"  // For FRIEND_TEST().
+#include "ion/port/memorymappedfile.h"
+#include "ion/port/mutex.h"
 #include "ion/text/font.h"
 #include "ion/text/fontimage.h"
+#include "ion/text/layout.h"
 
 namespace ion {
 namespace text {
 
+// Shared pointer to an immutable Layout returned by the layout cache.
+typedef std::shared_ptr<const Layout> CachedLayoutPtr;
+
 // The FontManager provides the main interface for fonts used to create text
 // strings to render. It also provides a way to cache FontImage instances for
 // reuse.
@@ -52,12 +61,31 @@ class ION_API FontManager : public base::Referent {
 
   // Constructs and adds a font with name |font_name| from the zipasset with
   // name |zipasset_name|. If a font with the given specs already exists, just
-  // returns the already existing font.
+  // returns the already existing font. Fonts from the same zipasset share its
+  // data, whatever their sizes.
   const FontPtr AddFontFromZipasset(const std::string& font_name,
                                     const std::string& zipasset_name,
                                     size_t size_in_pixels,
                                     size_t sdf_padding);
 
+  // Constructs and adds a font with name |font_name| from the font file at
+  // |path|, which is memory-mapped rather than read, so that only the parts
+  // of it that are used occupy memory. The file is mapped once and stays
+  // mapped until the FontManager is destroyed, so fonts built from it must not
+  // outlive the manager; fonts of the same file at several sizes share its
+  // data. If a font with the given specs already exists, just returns the
+  // already existing font. Logs an error and returns NULL if the file cannot
+  // be mapped.
+  const FontPtr AddFontFromFile(const std::string& font_name,
+                                const std::string& path, size_t size_in_pixels,
+                                size_t sdf_padding);
+
+  // Starts decompressing the font data in the zipassets with the passed names
+  // on worker threads, so that later calls to AddFontFromZipasset() for them
+  // do not wait for decompression. The returned Prefetch can be waited on.
+  static base::ZipAssetManager::PrefetchPtr PrefetchZipassets(
+      const std::vector<std::string>& zipasset_names);
+
   // Returns the Font associated with the given name and size. This will return
   // a NULL pointer unless the font was previously added with AddFont().
   const FontPtr FindFont(const std::string& name, size_t size_in_pixels,
@@ -92,6 +120,60 @@ class ION_API FontManager : public base::Referent {
     return GetCachedFontImage(BuildFontKeyFromFont(*font));
   }
 
+  // Saves the SDF grids cached in |font| to a glyph cache file at |path| (see
+  // glyphcache.h), so that later runs can load them with LoadGlyphCache()
+  // instead of rasterizing the glyphs again. Returns false on error or if the
+  // font is NULL.
+  bool SaveGlyphCache(const FontPtr& font, const std::string& path) const;
+
+  // Loads the SDF grids in the glyph cache file at |path| into |font|, which
+  // may be a font in the manager. Returns the number of glyphs loaded, which
+  // is 0 if the font is NULL or the file is missing, invalid, or was saved for
+  // another font.
+  size_t LoadGlyphCache(const FontPtr& font, const std::string& path);
+
+  // Statistics about the layout cache; see GetLayoutCacheStats().
+  struct LayoutCacheStats {
+    LayoutCacheStats() : hits(0), misses(0), evictions(0), size(0) {}
+    // Number of GetCachedLayout() calls that returned a cached Layout.
+    uint64 hits;
+    // Number of GetCachedLayout() calls that had to build a Layout.
+    uint64 misses;
+    // Number of Layouts removed to stay within the capacity.
+    uint64 evictions;
+    // Number of Layouts currently in the cache.
+    size_t size;
+  };
+
+  // Returns the Layout that |font| builds for |text| and |options|. Layouts
+  // are cached by font, text and options, so strings that recur every frame
+  // are only shaped and broken into lines once. When the cache holds more than
+  // GetLayoutCacheCapacity() Layouts, the least recently used one is removed.
+  // The returned Layout is shared and immutable; it stays valid after being
+  // removed from the cache. Returns a NULL pointer if |font| is NULL. This is
+  // thread-safe.
+  const CachedLayoutPtr GetCachedLayout(const FontPtr& font,
+                                        const std::string& text,
+                                        const LayoutOptions& options);
+
+  // Sets the maximum number of Layouts in the layout cache, removing the least
+  // recently used ones if there are more. A capacity of 0 disables caching.
+  // The default is kDefaultLayoutCacheCapacity.
+  void SetLayoutCacheCapacity(size_t capacity);
+  size_t GetLayoutCacheCapacity() const;
+
+  // Removes all Layouts from the layout cache, for example after the glyphs
+  // of a cached font change. This does not reset the statistics.
+  void ClearLayoutCache();
+
+  // Returns the hit, miss and eviction counts of the layout cache since the
+  // last ResetLayoutCacheStats(), and the current number of cached Layouts.
+  const LayoutCacheStats GetLayoutCacheStats() const;
+  void ResetLayoutCacheStats();
+
+  // The default capacity of the layout cache.
+  static const size_t kDefaultLayoutCacheCapacity = 256U;
+
  protected:
   // The destructor is protected because all base::Referent classes must have
   // protected or private destructors.
@@ -100,6 +182,36 @@ class ION_API FontManager : public base::Referent {
  private:
   typedef base::AllocMap<std::string, FontPtr> FontMap;
   typedef base::AllocMap<std::string, FontImagePtr> FontImageMap;
+  typedef base::AllocMap<std::string,
+                         std::shared_ptr<port::MemoryMappedFile>>
+      MappedFileMap;
+
+  // Identifies a cached Layout. The Font is compared by address; the cache
+  // entry holds a reference to it so that the address cannot be reused.
+  struct LayoutKey {
+    LayoutKey(const Font* font_in, const std::string& text_in,
+              const LayoutOptions& options_in)
+        : font(font_in), text(text_in), options(options_in) {}
+    bool operator<(const LayoutKey& other) const;
+    const Font* font;
+    std::string text;
+    LayoutOptions options;
+  };
+
+  // A cached Layout and the serial number of its most recent use.
+  struct LayoutEntry {
+    LayoutEntry() : last_use(0) {}
+    FontPtr font;
+    CachedLayoutPtr layout;
+    uint64 last_use;
+  };
+  typedef base::AllocMap<LayoutKey, LayoutEntry> LayoutMap;
+  // Maps the last use serial of each entry to its key, oldest first.
+  typedef base::AllocMap<uint64, LayoutKey> LayoutUseMap;
+
+  // Removes least recently used Layouts until there are at most |capacity|.
+  // The mutex must be locked.
+  void EvictLayouts(size_t capacity);
 
   // Constructs a string key from a Font for use in the Font map.
   static const std::string BuildFontKeyFromFont(const Font& font) {
@@ -116,6 +228,17 @@ class ION_API FontManager : public base::Referent {
   FontMap font_map_;
   // Maps a user-supplied string key to a FontImage instance.
   FontImageMap font_image_map_;
+  // Maps the path of a font file to its mapping.
+  MappedFileMap mapped_file_map_;
+
+  // The layout cache, its use order, and the statistics, all protected by
+  // |layout_mutex_|.
+  LayoutMap layout_map_;
+  LayoutUseMap layout_use_map_;
+  size_t layout_cache_capacity_;
+  uint64 layout_use_serial_;
+  LayoutCacheStats layout_stats_;
+  mutable port::Mutex layout_mutex_;
 
   // Allow tests to access private functions.
   FRIEND_TEST(FontManagerTest, BuildFontKey);
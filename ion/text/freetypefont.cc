@@ -21,6 +21,8 @@ limitations under the License.
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 #include FT_MODULE_H
+#include FT_OUTLINE_H
+#include FT_SIZES_H
 #include FT_SYSTEM_H
 #include FT_TRUETYPE_TABLES_H
 
@@ -31,6 +33,7 @@ limitations under the License.
 #include <unordered_map>
 #include <vector>
 
+#include "base/macros.h"
 #include "ion/base/allocator.h"
 #include "ion/base/datacontainer.h"
 #include "ion/base/lockguards.h"
@@ -65,6 +68,33 @@ static bool IsSizeValid(const Vector2f& target_size) {
   return width >= 0.0f && height >= 0.0f && (width > 0.0f || height > 0.0f);
 }
 
+// Sets the size of the glyphs in a face to the size closest to size_in_pixels.
+static void SetFaceSize(FT_Face face, size_t size_in_pixels) {
+  // C.f. the "Global glyph metrics" section of
+  // http://www.freetype.org/freetype2/docs/tutorial/step2.html
+  if (FT_IS_SCALABLE(face)) {
+    FT_Set_Pixel_Sizes(face, static_cast<FT_UInt>(size_in_pixels),
+                       static_cast<FT_UInt>(size_in_pixels));
+  } else {  // Must be fixed size (bitmap) font.
+    DCHECK(face->num_fixed_sizes);
+    int closest_face = 0;  // Index of bitmap-strike closest to size_in_pixels.
+    size_t closest_size = 0xFFFFFFFF;
+    for (int i = 0; i < face->num_fixed_sizes; ++i) {
+      FT_Select_Size(face, i);
+      const size_t size_difference =
+          abs(static_cast<int>(face->size->metrics.y_ppem) -
+              static_cast<int>(size_in_pixels));
+      if (size_difference < closest_size) {
+        closest_size = size_difference;
+        closest_face = i;
+      }
+    }
+    FT_Select_Size(face, closest_face);
+  }
+}
+
+class FreeTypeFace;
+
 //-----------------------------------------------------------------------------
 //
 // Each FreeTypeManager encapsulates a FT_Library instance, which uses the
@@ -116,10 +146,38 @@ class FreeTypeManager {
   // Loads a glyph for a specific FT_Face font. Returns false on error.
   bool LoadGlyph(FT_Face face, uint32 glyph_index);
 
+  // Loads the outline of a glyph for a specific FT_Face font in the
+  // coordinates of its rendered grid. Returns false on error or if the glyph
+  // has no outline.
+  bool LoadGlyphOutline(FT_Face face, uint32 glyph_index,
+                        GlyphOutline* outline);
+
   // Frees up the memory used by a Font.
   void FreeFont(FT_Face face);
 
+  // Returns the FreeTypeFace for FreeType data, which is shared by all callers
+  // passing the same data. The face is created if no caller holds it. Returns
+  // NULL on error; simulate_library_failure is as for InitFont().
+  std::shared_ptr<FreeTypeFace> AcquireFace(const void* data, size_t data_size,
+                                            bool simulate_library_failure);
+
+  // Creates an FT_Size for face with glyphs of the size closest to
+  // size_in_pixels, and makes it the active size. The face must be locked.
+  FT_Size NewSize(FT_Face face, size_t size_in_pixels);
+
+  // Frees an FT_Size returned by NewSize(). The face must be locked.
+  void FreeSize(FT_Size size);
+
  private:
+  friend class FreeTypeFace;
+
+  // As InitFont(), but assumes mutex_ has been locked.
+  FT_Face InitFontLocked(const void* data, size_t data_size,
+                         bool simulate_library_failure);
+
+  // Called by the destructor of a FreeTypeFace to free its FT_Face.
+  void ReleaseFace(FreeTypeFace* face);
+
   // FreeType memory management functions. The FreeTypeManager instance is
   // passed as the "user" pointer in the FT_Memory structure.
   static void* Allocate(FT_Memory mem, long size);  // NOLINT
@@ -143,10 +201,44 @@ class FreeTypeManager {
   FT_MemoryRec_ ft_mem_;
   // The shared FT_Library instance.
   FT_Library ft_lib_;
-  // Protects shared access to the Allocator and FT_Library.
+  // The faces shared by fonts, keyed by their data.
+  std::unordered_map<const void*, std::weak_ptr<FreeTypeFace>> faces_;
+  // Protects shared access to the Allocator, FT_Library and faces.
   port::Mutex mutex_;
 };
 
+//-----------------------------------------------------------------------------
+//
+// A FreeTypeFace is an FT_Face shared by all fonts created from the same data,
+// whatever their sizes, so that the data is parsed and its tables are loaded
+// once. Each font selects its size by activating its own FT_Size. Since an
+// FT_Face may only be used by one thread at a time, all use of it, including
+// activating a size, must happen with the mutex locked.
+//
+//-----------------------------------------------------------------------------
+
+class FreeTypeFace {
+ public:
+  FreeTypeFace(FreeTypeManager* manager, FT_Face face, const void* data,
+               size_t data_size)
+      : manager_(manager), face_(face), data_(data), data_size_(data_size) {}
+  ~FreeTypeFace() { manager_->ReleaseFace(this); }
+
+  FT_Face GetFace() const { return face_; }
+  const void* GetData() const { return data_; }
+  size_t GetDataSize() const { return data_size_; }
+  port::Mutex* GetMutex() { return &mutex_; }
+
+ private:
+  FreeTypeManager* manager_;
+  FT_Face face_;
+  const void* data_;
+  const size_t data_size_;
+  port::Mutex mutex_;
+
+  DISALLOW_COPY_AND_ASSIGN(FreeTypeFace);
+};
+
 FreeTypeManager::FreeTypeManager(const base::AllocatorPtr& allocator)
     : allocator_(allocator), ft_lib_(NULL) {
   ft_mem_.user = this;
@@ -166,8 +258,13 @@ FreeTypeManager::~FreeTypeManager() {
 
 FT_Face FreeTypeManager::InitFont(const void* data, size_t data_size,
                                   bool simulate_library_failure) {
-  FT_Face face = NULL;
   base::LockGuard guard(&mutex_);
+  return InitFontLocked(data, data_size, simulate_library_failure);
+}
+
+FT_Face FreeTypeManager::InitFontLocked(const void* data, size_t data_size,
+                                        bool simulate_library_failure) {
+  FT_Face face = NULL;
   if (FT_Library lib = simulate_library_failure ? NULL : ft_lib_) {
     if (!FT_New_Memory_Face(lib, reinterpret_cast<const FT_Byte*>(data),
                             static_cast<FT_Long>(data_size), 0, &face)) {
@@ -189,6 +286,52 @@ void FreeTypeManager::FreeFont(FT_Face face) {
   }
 }
 
+std::shared_ptr<FreeTypeFace> FreeTypeManager::AcquireFace(
+    const void* data, size_t data_size, bool simulate_library_failure) {
+  base::LockGuard guard(&mutex_);
+  if (!simulate_library_failure && data) {
+    auto it = faces_.find(data);
+    if (it != faces_.end()) {
+      std::shared_ptr<FreeTypeFace> face = it->second.lock();
+      if (face && face->GetDataSize() == data_size)
+        return face;
+    }
+  }
+  FT_Face ft_face = InitFontLocked(data, data_size, simulate_library_failure);
+  if (!ft_face)
+    return std::shared_ptr<FreeTypeFace>();
+  std::shared_ptr<FreeTypeFace> face(
+      new FreeTypeFace(this, ft_face, data, data_size));
+  faces_[data] = face;
+  return face;
+}
+
+void FreeTypeManager::ReleaseFace(FreeTypeFace* face) {
+  base::LockGuard guard(&mutex_);
+  // Another face may have replaced this one for the same data.
+  auto it = faces_.find(face->GetData());
+  if (it != faces_.end() && it->second.expired())
+    faces_.erase(it);
+  FT_Done_Face(face->GetFace());
+}
+
+FT_Size FreeTypeManager::NewSize(FT_Face face, size_t size_in_pixels) {
+  base::LockGuard guard(&mutex_);
+  FT_Size size = NULL;
+  if (FT_New_Size(face, &size))
+    return NULL;
+  FT_Activate_Size(size);
+  SetFaceSize(face, size_in_pixels);
+  return size;
+}
+
+void FreeTypeManager::FreeSize(FT_Size size) {
+  if (size) {
+    base::LockGuard guard(&mutex_);
+    FT_Done_Size(size);
+  }
+}
+
 bool FreeTypeManager::LoadGlyph(FT_Face face, uint32 glyph_index) {
   base::LockGuard guard(&mutex_);
   const FT_Error result = FT_Load_Glyph(face, glyph_index, FT_LOAD_RENDER);
@@ -267,6 +410,156 @@ static const Font::GlyphGrid GlyphToGrid(const FT_GlyphSlot& glyph) {
   return grid;
 }
 
+// The number of segments that approximate each curve of a glyph outline.
+static const int kOutlineCurveSegments = 8;
+
+// Receives the contours of a glyph from FT_Outline_Decompose().
+struct OutlineDecomposer {
+  GlyphOutline* outline;
+  math::Point2d last;
+};
+
+// Converts a FreeType 26.6 fixed-point position to a point in pixels.
+static const math::Point2d ToOutlinePoint(const FT_Vector* v) {
+  return math::Point2d(ToPixels(v->x), ToPixels(v->y));
+}
+
+// Adds a point to the current contour of a decomposed outline.
+static void AddOutlinePoint(OutlineDecomposer* decomposer,
+                            const math::Point2d& point, bool is_smooth) {
+  OutlineContour& contour = decomposer->outline->back();
+  contour.points.push_back(point);
+  contour.is_smooth.push_back(is_smooth);
+  decomposer->last = point;
+}
+
+static int OutlineMoveTo(const FT_Vector* to, void* user) {
+  OutlineDecomposer* decomposer = static_cast<OutlineDecomposer*>(user);
+  decomposer->outline->push_back(OutlineContour());
+  AddOutlinePoint(decomposer, ToOutlinePoint(to), false);
+  return 0;
+}
+
+static int OutlineLineTo(const FT_Vector* to, void* user) {
+  AddOutlinePoint(static_cast<OutlineDecomposer*>(user), ToOutlinePoint(to),
+                  false);
+  return 0;
+}
+
+static int OutlineConicTo(const FT_Vector* control, const FT_Vector* to,
+                          void* user) {
+  OutlineDecomposer* decomposer = static_cast<OutlineDecomposer*>(user);
+  const math::Point2d p0 = decomposer->last;
+  const math::Point2d p1 = ToOutlinePoint(control);
+  const math::Point2d p2 = ToOutlinePoint(to);
+  for (int i = 1; i <= kOutlineCurveSegments; ++i) {
+    const double t = static_cast<double>(i) / kOutlineCurveSegments;
+    const double u = 1.0 - t;
+    AddOutlinePoint(decomposer,
+                    math::Point2d(u * u * p0[0] + 2.0 * u * t * p1[0] +
+                                      t * t * p2[0],
+                                  u * u * p0[1] + 2.0 * u * t * p1[1] +
+                                      t * t * p2[1]),
+                    i < kOutlineCurveSegments);
+  }
+  return 0;
+}
+
+static int OutlineCubicTo(const FT_Vector* control1,
+                          const FT_Vector* control2, const FT_Vector* to,
+                          void* user) {
+  OutlineDecomposer* decomposer = static_cast<OutlineDecomposer*>(user);
+  const math::Point2d p0 = decomposer->last;
+  const math::Point2d p1 = ToOutlinePoint(control1);
+  const math::Point2d p2 = ToOutlinePoint(control2);
+  const math::Point2d p3 = ToOutlinePoint(to);
+  for (int i = 1; i <= kOutlineCurveSegments; ++i) {
+    const double t = static_cast<double>(i) / kOutlineCurveSegments;
+    const double u = 1.0 - t;
+    const double w0 = u * u * u;
+    const double w1 = 3.0 * u * u * t;
+    const double w2 = 3.0 * u * t * t;
+    const double w3 = t * t * t;
+    AddOutlinePoint(decomposer,
+                    math::Point2d(w0 * p0[0] + w1 * p1[0] + w2 * p2[0] +
+                                      w3 * p3[0],
+                                  w0 * p0[1] + w1 * p1[1] + w2 * p2[1] +
+                                      w3 * p3[1]),
+                    i < kOutlineCurveSegments);
+  }
+  return 0;
+}
+
+bool FreeTypeManager::LoadGlyphOutline(FT_Face face, uint32 glyph_index,
+                                       GlyphOutline* outline) {
+  base::LockGuard guard(&mutex_);
+  if (FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT) ||
+      face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+    return false;
+
+  FT_Outline_Funcs funcs;
+  funcs.move_to = OutlineMoveTo;
+  funcs.line_to = OutlineLineTo;
+  funcs.conic_to = OutlineConicTo;
+  funcs.cubic_to = OutlineCubicTo;
+  funcs.shift = 0;
+  funcs.delta = 0;
+  OutlineDecomposer decomposer;
+  decomposer.outline = outline;
+  outline->clear();
+  if (FT_Outline_Decompose(&face->glyph->outline, &funcs, &decomposer))
+    return false;
+
+  // Rendering places the outline in the grid, so that the outline can be
+  // moved to the grid's coordinates, which have y pointing down.
+  if (FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL))
+    return false;
+  const double left = static_cast<double>(face->glyph->bitmap_left);
+  const double top = static_cast<double>(face->glyph->bitmap_top);
+  for (size_t i = 0; i < outline->size(); ++i) {
+    std::vector<math::Point2d>& points = (*outline)[i].points;
+    for (size_t j = 0; j < points.size(); ++j)
+      points[j].Set(points[j][0] - left, top - points[j][1]);
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+//
+// A GlyphRasterizer renders glyph grids with its own FT_Library and FT_Face.
+// Since neither may be used by more than one thread at a time, this allows
+// several threads to render the glyphs of the same font at once.
+//
+//-----------------------------------------------------------------------------
+
+class GlyphRasterizer {
+ public:
+  // Creates a face from FreeType font data, which must outlive the instance,
+  // with glyphs of the given size.
+  GlyphRasterizer(const base::AllocatorPtr& allocator, const void* data,
+                  size_t data_size, size_t size_in_pixels)
+      : manager_(allocator), face_(manager_.InitFont(data, data_size, false)) {
+    if (face_) SetFaceSize(face_, size_in_pixels);
+  }
+  ~GlyphRasterizer() { manager_.FreeFont(face_); }
+
+  // Returns whether the face could be created.
+  bool IsValid() const { return face_ != NULL; }
+
+  // Renders the glyph with FreeType index glyph_id into glyph_grid. Returns
+  // false on error.
+  bool RasterizeGlyph(uint32 glyph_id, Font::GlyphGrid* glyph_grid) {
+    DCHECK(face_);
+    if (!manager_.LoadGlyph(face_, glyph_id)) return false;
+    *glyph_grid = GlyphToGrid(face_->glyph);
+    return true;
+  }
+
+ private:
+  FreeTypeManager manager_;
+  FT_Face face_;
+};
+
 // In order to avoid GlyphIndex collision between the main face and the fallback
 // faces, we pack the FreeType glyph index and a face id into a uint64, with the
 // face id in the high order 32 bits, and the glyph index in the low order 32
@@ -287,6 +580,13 @@ static GlyphIndex BuildGlyphIndex(uint32 glyph, uint32 face) {
   return static_cast<GlyphIndex>(glyph) | (static_cast<GlyphIndex>(face) << 32);
 }
 
+// Returns the hash of a character pair, used to find it in the precomputed
+// kerning table.
+static size_t HashCharPair(CharIndex char_index0, CharIndex char_index1) {
+  const uint64 key = (static_cast<uint64>(char_index0) << 32) | char_index1;
+  return static_cast<size_t>((key * 0x9e3779b97f4a7c15ULL) >> 32);
+}
+
 }  // anonymous namespace
 
 //-----------------------------------------------------------------------------
@@ -324,7 +624,12 @@ class FreeTypeFont::Helper
         font_tables_(allocator_),
 #endif  // ION_USE_ICU
         ft_face_(NULL),
-        manager_(FreeTypeManager::GetManagerForAllocator(allocator_)) {
+        ft_size_(NULL),
+        data_(NULL),
+        data_size_(0U),
+        manager_(FreeTypeManager::GetManagerForAllocator(allocator_)),
+        shaped_runs_(allocator_, ShapedRunCache::kDefaultCapacity),
+        precomputed_first_char_(0U) {
   }
   ~Helper() { FreeFont(); }
 
@@ -340,6 +645,11 @@ class FreeTypeFont::Helper
   bool LoadGlyph(GlyphIndex glyph_index, GlyphMetaData* glyph_meta,
                  Font::GlyphGrid* glyph_grid) const;
 
+  // Loads the outline of a glyph in the coordinates of its grid, using the
+  // fallback faces as LoadGlyph() does. Returns false if the glyph has no
+  // outline.
+  bool LoadGlyphOutline(GlyphIndex glyph_index, GlyphOutline* outline) const;
+
   // Returns a FontMetrics for this font.
   const FontMetrics GetFontMetrics() const;
 
@@ -362,6 +672,14 @@ class FreeTypeFont::Helper
   // fallbacks, not just glyph loading.
   void AddFallbackFace(const std::weak_ptr<Helper>& fallback);
 
+  // Returns the cache of lines shaped for complex text layout.
+  ShapedRunCache* GetShapedRunCache() { return &shaped_runs_; }
+
+  // Builds the flat tables used by GetDefaultGlyphForChar(),
+  // GetGlyphMetaData() and GetKerning() for the characters from |first| to
+  // |last|, extended to cover any previously precomputed range.
+  bool PrecomputeCharRange(CharIndex first, CharIndex last);
+
 #ifdef ION_USE_ICU
   // icu::LEFontInstance implementation.
   const void* getFontTable(LETag tableTag, size_t& length) const override;
@@ -380,8 +698,8 @@ class FreeTypeFont::Helper
 #endif
 
  private:
-  // Queries the owning font size, and correctly set the FreeType font size or
-  // scale based upon that.
+  // Makes the size of the owning font the active size of the shared face,
+  // which must be locked.
   void SetFontSizeLocked() const;
 
   // Queries for the FreeType glyph index assosiated with |char_index| in the
@@ -400,6 +718,39 @@ class FreeTypeFont::Helper
   const math::Vector2f GetKerningLocked(CharIndex char_index0,
                                         CharIndex char_index1) const;
 
+  // As GetKerningLocked, but assumes that the shared face has been locked and
+  // its size activated.
+  const math::Vector2f GetKerningFaceLocked(CharIndex char_index0,
+                                            CharIndex char_index1) const;
+
+  // Returns the FreeType glyph index of |char_index| in ft_face_ if it is in
+  // the precomputed range, or 0 if it is not or ft_face_ has no glyph for it.
+  uint32 GetPrecomputedGlyphId(CharIndex char_index) const {
+    const CharIndex offset = char_index - precomputed_first_char_;
+    return offset < precomputed_glyph_ids_.size()
+               ? precomputed_glyph_ids_[offset]
+               : 0U;
+  }
+
+  // Returns the kerning of a pair of characters that both have precomputed
+  // glyphs.
+  const math::Vector2f GetPrecomputedKerning(CharIndex char_index0,
+                                             CharIndex char_index1) const;
+
+  // Renders the grid of a glyph. Unlike LoadGlyph(), this uses another face if
+  // the main face is in use, so several threads can render glyphs at once.
+  // Uses the fallback faces as LoadGlyph() does.
+  bool RasterizeGlyph(GlyphIndex glyph_index,
+                      Font::GlyphGrid* glyph_grid) const;
+
+  // As LoadGlyphOutline, but does not fallback on failure.
+  bool LoadGlyphOutlineNoFallback(GlyphIndex glyph_index,
+                                  GlyphOutline* outline) const;
+
+  // As RasterizeGlyph, but does not fallback on failure.
+  bool RasterizeGlyphNoFallback(GlyphIndex glyph_index,
+                                Font::GlyphGrid* glyph_grid) const;
+
   // As LoadGlyph above, but assumes mutex_ has been locked.
   bool LoadGlyphLocked(GlyphIndex glyph_index, GlyphMetaData* glyph_meta,
                        Font::GlyphGrid* glyph_grid) const;
@@ -409,6 +760,11 @@ class FreeTypeFont::Helper
                                  GlyphMetaData* glyph_meta,
                                  Font::GlyphGrid* glyph_grid) const;
 
+  // As LoadGlyphLockedNoFallback, but assumes that the shared face has been
+  // locked rather than mutex_.
+  bool LoadGlyphFaceLocked(GlyphIndex glyph_index, GlyphMetaData* glyph_meta,
+                           Font::GlyphGrid* glyph_grid) const;
+
   // Convenience typedef for the map storing GlyphData instances.
   typedef base::AllocMap<GlyphIndex, GlyphMetaData> GlyphMetaDataMap;
 
@@ -425,30 +781,149 @@ class FreeTypeFont::Helper
   mutable base::AllocMap<LETag, std::pair<base::DataContainerPtr, size_t>>
       font_tables_;
 #endif
+  // The face shared with other fonts created from the same data, and the size
+  // of this font's glyphs in it.
+  std::shared_ptr<FreeTypeFace> face_;
   FT_Face ft_face_;
+  FT_Size ft_size_;
+  // The font data passed to Init(), used to create the rasterizers.
+  const void* data_;
+  size_t data_size_;
   std::vector<std::weak_ptr<Helper>> fallback_helpers_;
   FreeTypeManager* manager_;
   mutable port::Mutex mutex_;
+  // Rasterizers that are not in use by any thread, and a mutex protecting them.
+  mutable std::vector<std::unique_ptr<GlyphRasterizer>> rasterizers_;
+  mutable port::Mutex rasterizer_mutex_;
+  // Lines shaped by ICU, so that recurring lines are only shaped once.
+  ShapedRunCache shaped_runs_;
+
+  // A pair of characters with non-zero kerning in the precomputed table.
+  struct KerningPair {
+    CharIndex char_index0;
+    CharIndex char_index1;
+    math::Vector2f kerning;
+  };
+  // The precomputed tables, which are read without locking. The glyph index
+  // in ft_face_ of each character in the range starting at
+  // precomputed_first_char_, the metadata of each of these glyphs indexed by
+  // glyph index, pointing into glyph_metadata_map_, and an open-addressed
+  // hash table, with a power-of-two size, of the pairs of these characters
+  // that have kerning. Empty slots have a zero char_index0.
+  CharIndex precomputed_first_char_;
+  std::vector<uint32> precomputed_glyph_ids_;
+  std::vector<const GlyphMetaData*> precomputed_metadata_;
+  std::vector<KerningPair> precomputed_kerning_;
 };
 
 bool FreeTypeFont::Helper::Init(const void* data, size_t data_size,
                                 bool simulate_library_failure) {
   DCHECK(!ft_face_);
   base::LockGuard guard(&mutex_);
-  ft_face_ = manager_->InitFont(data, data_size, simulate_library_failure);
-  if (!ft_face_) {
+  face_ = manager_->AcquireFace(data, data_size, simulate_library_failure);
+  if (!face_) {
     LOG(ERROR) << "Could not read the FreeType font data.";
+    return false;
+  }
+  base::LockGuard face_guard(face_->GetMutex());
+  ft_size_ =
+      manager_->NewSize(face_->GetFace(), owning_font_->GetSizeInPixels());
+  if (!ft_size_) {
+    LOG(ERROR) << "Could not create the FreeType font size.";
+    return false;
   }
-  return ft_face_;
+  ft_face_ = face_->GetFace();
+  data_ = data;
+  data_size_ = data_size;
+  return true;
 }
 
 bool FreeTypeFont::Helper::LoadGlyph(GlyphIndex glyph_index,
                                      GlyphMetaData* glyph_meta,
                                      Font::GlyphGrid* glyph_grid) const {
+  // Rendering just the grid does not need the main face.
+  if (glyph_grid && !glyph_meta)
+    return RasterizeGlyph(glyph_index, glyph_grid);
   base::LockGuard guard(&mutex_);
   return LoadGlyphLocked(glyph_index, glyph_meta, glyph_grid);
 }
 
+bool FreeTypeFont::Helper::RasterizeGlyph(GlyphIndex glyph_index,
+                                          Font::GlyphGrid* glyph_grid) const {
+  const uint32 face_id = GlyphIndexToFaceId(glyph_index);
+  if (face_id == 0)
+    return RasterizeGlyphNoFallback(glyph_index, glyph_grid);
+  std::shared_ptr<Helper> helper;
+  {
+    base::LockGuard guard(&mutex_);
+    helper = fallback_helpers_[face_id - 1].lock();
+  }
+  return helper && helper->RasterizeGlyphNoFallback(glyph_index, glyph_grid);
+}
+
+bool FreeTypeFont::Helper::RasterizeGlyphNoFallback(
+    GlyphIndex glyph_index, Font::GlyphGrid* glyph_grid) const {
+  if (!ft_face_)
+    return false;
+  // Use the shared face if no other thread is using it.
+  {
+    base::TryLockGuard guard(face_->GetMutex());
+    if (guard.IsLocked())
+      return LoadGlyphFaceLocked(glyph_index, NULL, glyph_grid);
+  }
+
+  // Otherwise use an idle rasterizer, creating one if all of them are busy, so
+  // that there are at most as many as threads that load glyphs at once.
+  if (!data_) {
+    base::LockGuard guard(face_->GetMutex());
+    return LoadGlyphFaceLocked(glyph_index, NULL, glyph_grid);
+  }
+  std::unique_ptr<GlyphRasterizer> rasterizer;
+  {
+    base::LockGuard guard(&rasterizer_mutex_);
+    if (!rasterizers_.empty()) {
+      rasterizer = std::move(rasterizers_.back());
+      rasterizers_.pop_back();
+    }
+  }
+  if (!rasterizer) {
+    rasterizer.reset(new GlyphRasterizer(allocator_, data_, data_size_,
+                                         owning_font_->GetSizeInPixels()));
+    if (!rasterizer->IsValid()) {
+      base::LockGuard guard(face_->GetMutex());
+      return LoadGlyphFaceLocked(glyph_index, NULL, glyph_grid);
+    }
+  }
+  const bool loaded =
+      rasterizer->RasterizeGlyph(GlyphIndexToGlyphId(glyph_index), glyph_grid);
+  base::LockGuard guard(&rasterizer_mutex_);
+  rasterizers_.push_back(std::move(rasterizer));
+  return loaded;
+}
+
+bool FreeTypeFont::Helper::LoadGlyphOutline(GlyphIndex glyph_index,
+                                            GlyphOutline* outline) const {
+  const uint32 face_id = GlyphIndexToFaceId(glyph_index);
+  if (face_id == 0)
+    return LoadGlyphOutlineNoFallback(glyph_index, outline);
+  std::shared_ptr<Helper> helper;
+  {
+    base::LockGuard guard(&mutex_);
+    helper = fallback_helpers_[face_id - 1].lock();
+  }
+  return helper && helper->LoadGlyphOutlineNoFallback(glyph_index, outline);
+}
+
+bool FreeTypeFont::Helper::LoadGlyphOutlineNoFallback(
+    GlyphIndex glyph_index, GlyphOutline* outline) const {
+  if (!ft_face_)
+    return false;
+  base::LockGuard guard(face_->GetMutex());
+  SetFontSizeLocked();
+  return manager_->LoadGlyphOutline(
+      ft_face_, GlyphIndexToGlyphId(glyph_index), outline);
+}
+
 bool FreeTypeFont::Helper::LoadGlyphLocked(GlyphIndex glyph_index,
                                            GlyphMetaData* glyph_meta,
                                            Font::GlyphGrid* glyph_grid) const {
@@ -469,6 +944,15 @@ bool FreeTypeFont::Helper::LoadGlyphLocked(GlyphIndex glyph_index,
 bool FreeTypeFont::Helper::LoadGlyphLockedNoFallback(
     GlyphIndex glyph_index, GlyphMetaData* glyph_meta,
     Font::GlyphGrid* glyph_grid) const {
+  if (!ft_face_)
+    return false;
+  base::LockGuard guard(face_->GetMutex());
+  return LoadGlyphFaceLocked(glyph_index, glyph_meta, glyph_grid);
+}
+
+bool FreeTypeFont::Helper::LoadGlyphFaceLocked(
+    GlyphIndex glyph_index, GlyphMetaData* glyph_meta,
+    Font::GlyphGrid* glyph_grid) const {
   DCHECK(ft_face_);
 
   // Indicate the proper size for the glyphs.
@@ -491,41 +975,23 @@ bool FreeTypeFont::Helper::LoadGlyphLockedNoFallback(
 }
 
 void FreeTypeFont::Helper::SetFontSizeLocked() const {
-  // C.f. the "Global glyph metrics" section of
-  // http://www.freetype.org/freetype2/docs/tutorial/step2.html
-  const size_t size_in_pixels = owning_font_->GetSizeInPixels();
-  if (FT_IS_SCALABLE(ft_face_)) {
-    FT_Set_Pixel_Sizes(ft_face_, static_cast<FT_UInt>(size_in_pixels),
-                       static_cast<FT_UInt>(size_in_pixels));
-  } else {  // Must be fixed size (bitmap) font.
-    DCHECK(ft_face_->num_fixed_sizes);
-    int closest_face = 0;  // Index of bitmap-strike closest to size_in_pixels.
-    size_t closest_size = 0xFFFFFFFF;
-    for (int i = 0; i < ft_face_->num_fixed_sizes; ++i) {
-      FT_Select_Size(ft_face_, i);
-      const size_t size_difference =
-          abs(static_cast<int>(ft_face_->size->metrics.y_ppem) -
-              static_cast<int>(size_in_pixels));
-      if (size_difference < closest_size) {
-        closest_size = size_difference;
-        closest_face = i;
-      }
-    }
-    FT_Select_Size(ft_face_, closest_face);
-  }
+  // Activating a size is much cheaper than setting it.
+  if (ft_face_->size != ft_size_)
+    FT_Activate_Size(ft_size_);
 }
 
 const Font::FontMetrics FreeTypeFont::Helper::GetFontMetrics() const {
-  base::LockGuard guard(&mutex_);
   FontMetrics metrics;
-  SetFontSizeLocked();
+  // The metrics of a size do not change, so the face need not be locked.
   metrics.line_advance_height =
-      static_cast<float>(ft_face_->size->metrics.height / 64);
+      static_cast<float>(ft_size_->metrics.height / 64);
   return metrics;
 }
 
 const math::Vector2f FreeTypeFont::Helper::GetKerning(
     CharIndex char_index0, CharIndex char_index1) const {
+  if (GetPrecomputedGlyphId(char_index0) && GetPrecomputedGlyphId(char_index1))
+    return GetPrecomputedKerning(char_index0, char_index1);
   math::Vector2f retval = math::Vector2f::Zero();
   if (GetKerningNoFallback(char_index0, char_index1, &retval)) {
     return retval;
@@ -561,9 +1027,19 @@ bool FreeTypeFont::Helper::GetKerningNoFallback(CharIndex char_index0,
 
 const math::Vector2f FreeTypeFont::Helper::GetKerningLocked(
     CharIndex char_index0, CharIndex char_index1) const {
+  if (!ft_face_)
+    return math::Vector2f::Zero();
+  // Kerning is scaled by the active size.
+  base::LockGuard guard(face_->GetMutex());
+  SetFontSizeLocked();
+  return GetKerningFaceLocked(char_index0, char_index1);
+}
+
+const math::Vector2f FreeTypeFont::Helper::GetKerningFaceLocked(
+    CharIndex char_index0, CharIndex char_index1) const {
   math::Vector2f kerning(0.f, 0.f);
   FT_Vector ft_kerning;
-  if (ft_face_ && FT_HAS_KERNING(ft_face_) &&
+  if (FT_HAS_KERNING(ft_face_) &&
       !FT_Get_Kerning(ft_face_, static_cast<FT_UInt>(char_index0),
                       static_cast<FT_UInt>(char_index1), FT_KERNING_DEFAULT,
                       &ft_kerning)) {
@@ -574,12 +1050,127 @@ const math::Vector2f FreeTypeFont::Helper::GetKerningLocked(
 }
 
 uint32 FreeTypeFont::Helper::GetGlyphForChar(CharIndex char_index) const {
-  base::LockGuard guard(&mutex_);
+  if (!ft_face_)
+    return 0U;
+  base::LockGuard guard(face_->GetMutex());
   return FT_Get_Char_Index(ft_face_, char_index);
 }
 
+const math::Vector2f FreeTypeFont::Helper::GetPrecomputedKerning(
+    CharIndex char_index0, CharIndex char_index1) const {
+  if (!precomputed_kerning_.empty()) {
+    const size_t mask = precomputed_kerning_.size() - 1U;
+    for (size_t i = HashCharPair(char_index0, char_index1) & mask;;
+         i = (i + 1U) & mask) {
+      const KerningPair& pair = precomputed_kerning_[i];
+      if (!pair.char_index0)
+        break;
+      if (pair.char_index0 == char_index0 && pair.char_index1 == char_index1)
+        return pair.kerning;
+    }
+  }
+  return math::Vector2f::Zero();
+}
+
+bool FreeTypeFont::Helper::PrecomputeCharRange(CharIndex first,
+                                               CharIndex last) {
+  if (!ft_face_)
+    return false;
+  if (!first || first > last) {
+    LOG(ERROR) << "Cannot precompute characters " << first << " to " << last
+               << " of font '" << owning_font_->GetName()
+               << "'; the range must be non-empty and start from 1";
+    return false;
+  }
+  if (!precomputed_glyph_ids_.empty()) {
+    first = std::min(first, precomputed_first_char_);
+    last = std::max(last, static_cast<CharIndex>(
+                              precomputed_first_char_ +
+                              precomputed_glyph_ids_.size() - 1U));
+  }
+  if (last - first >= FreeTypeFont::kMaxPrecomputedChars) {
+    LOG(ERROR) << "Cannot precompute characters " << first << " to " << last
+               << " of font '" << owning_font_->GetName() << "'; at most "
+               << FreeTypeFont::kMaxPrecomputedChars
+               << " characters can be precomputed";
+    return false;
+  }
+
+  // Look up the glyphs of all characters at once.
+  const size_t char_count = last - first + 1U;
+  std::vector<uint32> glyph_ids(char_count, 0U);
+  uint32 max_glyph_id = 0U;
+  {
+    base::LockGuard guard(face_->GetMutex());
+    for (size_t i = 0; i < char_count; ++i) {
+      glyph_ids[i] =
+          FT_Get_Char_Index(ft_face_, static_cast<CharIndex>(first + i));
+      max_glyph_id = std::max(max_glyph_id, glyph_ids[i]);
+    }
+  }
+
+  // Glyph metadata is kept in the map, so the table only points to it.
+  std::vector<const GlyphMetaData*> metadata(max_glyph_id + 1U, NULL);
+  for (size_t i = 0; i < char_count; ++i) {
+    if (glyph_ids[i] && !metadata[glyph_ids[i]]) {
+      const GlyphMetaData& meta =
+          GetGlyphMetaData(BuildGlyphIndex(glyph_ids[i], 0));
+      if (!base::IsInvalidReference(meta))
+        metadata[glyph_ids[i]] = &meta;
+    }
+  }
+
+  // Store only the pairs with kerning, in a table at most half full.
+  std::vector<KerningPair> pairs;
+  if (FT_HAS_KERNING(ft_face_)) {
+    base::LockGuard guard(face_->GetMutex());
+    SetFontSizeLocked();
+    for (size_t i = 0; i < char_count; ++i) {
+      if (!glyph_ids[i])
+        continue;
+      for (size_t j = 0; j < char_count; ++j) {
+        if (!glyph_ids[j])
+          continue;
+        KerningPair pair;
+        pair.char_index0 = static_cast<CharIndex>(first + i);
+        pair.char_index1 = static_cast<CharIndex>(first + j);
+        pair.kerning = GetKerningFaceLocked(pair.char_index0,
+                                            pair.char_index1);
+        if (pair.kerning != math::Vector2f::Zero())
+          pairs.push_back(pair);
+      }
+    }
+  }
+  std::vector<KerningPair> kerning;
+  if (!pairs.empty()) {
+    size_t table_size = 2U;
+    while (table_size < 2U * pairs.size())
+      table_size <<= 1;
+    KerningPair empty;
+    empty.char_index0 = empty.char_index1 = 0U;
+    empty.kerning = math::Vector2f::Zero();
+    kerning.resize(table_size, empty);
+    const size_t mask = table_size - 1U;
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      size_t slot = HashCharPair(pairs[i].char_index0, pairs[i].char_index1);
+      while (kerning[slot & mask].char_index0)
+        ++slot;
+      kerning[slot & mask] = pairs[i];
+    }
+  }
+
+  base::LockGuard guard(&mutex_);
+  precomputed_first_char_ = first;
+  precomputed_glyph_ids_.swap(glyph_ids);
+  precomputed_metadata_.swap(metadata);
+  precomputed_kerning_.swap(kerning);
+  return true;
+}
+
 GlyphIndex FreeTypeFont::Helper::GetDefaultGlyphForChar(
     CharIndex char_index) const {
+  if (const uint32 precomputed_idx = GetPrecomputedGlyphId(char_index))
+    return BuildGlyphIndex(precomputed_idx, 0);
   uint32 idx = GetGlyphForChar(char_index);
   if (idx != 0) {
     return BuildGlyphIndex(idx, 0);
@@ -599,6 +1190,12 @@ GlyphIndex FreeTypeFont::Helper::GetDefaultGlyphForChar(
 
 const FreeTypeFont::Helper::GlyphMetaData&
 FreeTypeFont::Helper::GetGlyphMetaData(GlyphIndex glyph_index) const {
+  if (GlyphIndexToFaceId(glyph_index) == 0) {
+    const uint32 glyph_id = GlyphIndexToGlyphId(glyph_index);
+    if (glyph_id < precomputed_metadata_.size() &&
+        precomputed_metadata_[glyph_id])
+      return *precomputed_metadata_[glyph_id];
+  }
   base::LockGuard guard(&mutex_);
   if (!glyph_index) {
     return base::InvalidReference<GlyphMetaData>();
@@ -615,11 +1212,21 @@ FreeTypeFont::Helper::GetGlyphMetaData(GlyphIndex glyph_index) const {
 }
 
 void FreeTypeFont::Helper::FreeFont() {
+  {
+    base::LockGuard guard(&rasterizer_mutex_);
+    rasterizers_.clear();
+  }
   base::LockGuard guard(&mutex_);
   if (ft_face_) {
-    manager_->FreeFont(ft_face_);
+    {
+      base::LockGuard face_guard(face_->GetMutex());
+      manager_->FreeSize(ft_size_);
+    }
+    ft_size_ = NULL;
     ft_face_ = NULL;
   }
+  // The face is freed when no other font shares it.
+  face_.reset();
 }
 
 void FreeTypeFont::Helper::AddFallbackFace(
@@ -637,6 +1244,7 @@ const void* FreeTypeFont::Helper::getFontTable(LETag tableTag,
                                                size_t& length) const {
   auto it = font_tables_.find(tableTag);
   if (it == font_tables_.end()) {
+    base::LockGuard guard(face_->GetMutex());
     FT_ULong table_size = 0;
     FT_Error error =
         FT_Load_Sfnt_Table(ft_face_, tableTag, 0, NULL, &table_size);
@@ -667,7 +1275,7 @@ le_int32 FreeTypeFont::Helper::getUnitsPerEM() const {
 }
 
 LEGlyphID FreeTypeFont::Helper::mapCharToGlyph(LEUnicode32 ch) const {
-  return FT_Get_Char_Index(ft_face_, ch);
+  return GetGlyphForChar(ch);
 }
 
 static void SetLEPointToZero(LEPoint* point) {
@@ -702,41 +1310,41 @@ le_bool FreeTypeFont::Helper::getGlyphPoint(LEGlyphID glyph,
 }
 
 float FreeTypeFont::Helper::getXPixelsPerEm() const {
-  return ft_face_->size->metrics.x_ppem;
+  return ft_size_->metrics.x_ppem;
 }
 
 float FreeTypeFont::Helper::getYPixelsPerEm() const {
-  return ft_face_->size->metrics.y_ppem;
+  return ft_size_->metrics.y_ppem;
 }
 
 float FreeTypeFont::Helper::getScaleFactorX() const {
   // FreeType stores the x_scale as a 16.16 fixed point value
   static const float k16_16ToFloat = 1.0f / 65536.0f;
-  return static_cast<float>(ft_face_->size->metrics.x_scale) * k16_16ToFloat;
+  return static_cast<float>(ft_size_->metrics.x_scale) * k16_16ToFloat;
 }
 
 float FreeTypeFont::Helper::getScaleFactorY() const {
   // FreeType stores the y_scale as a 16.16 fixed point value
   static const float k16_16ToFloat = 1.0f / 65536.0f;
-  return static_cast<float>(ft_face_->size->metrics.y_scale) * k16_16ToFloat;
+  return static_cast<float>(ft_size_->metrics.y_scale) * k16_16ToFloat;
 }
 
 le_int32 FreeTypeFont::Helper::getAscent() const {
   return static_cast<le_int32>(
       FT_MulFix(ft_face_->ascender,
-                static_cast<FT_Int32>(ft_face_->size->metrics.y_scale)) /
+                static_cast<FT_Int32>(ft_size_->metrics.y_scale)) /
       64);
 }
 
 le_int32 FreeTypeFont::Helper::getDescent() const {
   return -static_cast<le_int32>(
-      FT_MulFix(ft_face_->descender, ft_face_->size->metrics.y_scale) / 64);
+      FT_MulFix(ft_face_->descender, ft_size_->metrics.y_scale) / 64);
 }
 
 le_int32 FreeTypeFont::Helper::getLeading() const {
   return static_cast<le_int32>(
       FT_MulFix(ft_face_->height,
-                static_cast<FT_Int32>(ft_face_->size->metrics.y_scale)) /
+                static_cast<FT_Int32>(ft_size_->metrics.y_scale)) /
       64);
 }
 #endif  // ION_USE_ICU
@@ -747,6 +1355,8 @@ le_int32 FreeTypeFont::Helper::getLeading() const {
 //
 //-----------------------------------------------------------------------------
 
+const size_t FreeTypeFont::kMaxPrecomputedChars;
+
 FreeTypeFont::FreeTypeFont(const std::string& name, size_t size_in_pixels,
                            size_t sdf_padding, const void* data,
                            size_t data_size)
@@ -771,6 +1381,15 @@ bool FreeTypeFont::LoadGlyphGrid(GlyphIndex glyph_index,
   return helper_->LoadGlyph(glyph_index, NULL, glyph_grid);
 }
 
+bool FreeTypeFont::LoadGlyphOutline(GlyphIndex glyph_index,
+                                    GlyphOutline* outline) const {
+  return helper_->LoadGlyphOutline(glyph_index, outline);
+}
+
+bool FreeTypeFont::PrecomputeCharRange(CharIndex first, CharIndex last) {
+  return helper_->PrecomputeCharRange(first, last);
+}
+
 const math::Vector2f FreeTypeFont::GetKerning(CharIndex char_index0,
                                               CharIndex char_index1) const {
   return helper_->GetKerning(char_index0, char_index1);
@@ -801,7 +1420,8 @@ const Layout FreeTypeFont::BuildLayout(const std::string& text,
   icu::LEFontInstance* icu_font = NULL;
 #endif  // ION_USE_ICU
 
-  return LayOutText(*this, icu_font, lines, transform_data);
+  return LayOutText(*this, icu_font, helper_->GetShapedRunCache(), lines,
+                    transform_data);
 }
 
 void FreeTypeFont::AddFallbackFont(const FontPtr& fallback) {
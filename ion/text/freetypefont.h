@@ -56,7 +56,10 @@ class ION_API FreeTypeFont : public Font {
   // Constructs an instance using the given name. The supplied font data may be
   // in any format that FreeType2's FT_New_Memory_Face() can handle. The data
   // must not be deallocated before destruction of the FreeTypeFont. The font
-  // size will be as close as possible to the specified size.
+  // size will be as close as possible to the specified size. FreeTypeFonts
+  // constructed from the same data, for example the same font at several
+  // sizes, share the parsed FreeType face, which saves much memory for large
+  // fonts; each selects its own size in it.
   FreeTypeFont(const std::string& name, size_t size_in_pixels,
                size_t sdf_padding, const void* data, size_t data_size);
 
@@ -69,6 +72,26 @@ class ION_API FreeTypeFont : public Font {
   const math::Vector2f GetKerning(CharIndex char_index0,
                                   CharIndex char_index1) const;
 
+  // The maximum number of characters passed to PrecomputeCharRange().
+  static const size_t kMaxPrecomputedChars = 1024U;
+
+  // Precomputes the glyphs, GlyphMetrics and kerning of the characters from
+  // |first| to |last| into flat tables, so that GetDefaultGlyphForChar(),
+  // GetGlyphMetrics() and GetKerning() look them up without locking, map
+  // lookups, or FreeType calls, which makes laying out long strings much
+  // faster. The glyphs of frequently used ranges, such as ASCII or Latin-1
+  // (0x20 to 0xff), or of the range of characters an application has laid out
+  // so far, can be precomputed once for each font. Calling this again extends
+  // the range to include both ranges. Characters that are not in the font
+  // itself, for example those drawn with a fallback font, are not
+  // precomputed. Building the kerning table calls FreeType for every pair of
+  // characters, so this should not be called for large ranges or from a
+  // thread that must not stall. It also must not be called while other
+  // threads use the font. Returns false and logs an error if |first| is 0,
+  // the range is empty, or the extended range has more than
+  // kMaxPrecomputedChars characters.
+  bool PrecomputeCharRange(CharIndex first, CharIndex last);
+
   // Font overrides.
   GlyphIndex GetDefaultGlyphForChar(CharIndex char_index) const override;
   const Layout BuildLayout(const std::string& text,
@@ -90,6 +113,11 @@ class ION_API FreeTypeFont : public Font {
   bool LoadGlyphGrid(GlyphIndex glyph_index,
                      GlyphGrid* glyph_grid) const override;
 
+  // Override Font::LoadGlyphOutline to provide outlines for multi-channel SDF
+  // grids.
+  bool LoadGlyphOutline(GlyphIndex glyph_index,
+                        GlyphOutline* outline) const override;
+
  private:
   // Helper class that does most of the work, hiding the implementation.
   class Helper;
@@ -24,6 +24,7 @@ limitations under the License.
 #include <vector>
 
 #include "ion/base/invalid.h"
+#include "ion/base/lockguards.h"
 #include "ion/base/stlalloc/allocvector.h"
 #include "ion/base/stringutils.h"
 #include "ion/base/utf8iterator.h"
@@ -75,10 +76,11 @@ static float ComputeLineWidth(const FreeTypeFont& font,
   // of the next glyph, but the text width ends at the previous x_max.
   float x_min = 0.0f;
   float x_max = 0.0f;
-  base::Utf8Iterator it(line);
+  std::vector<CharIndex> chars;
+  const bool is_valid = base::Utf8Iterator::Decode(line, &chars);
   CharIndex prev_c = 0;
-  CharIndex c;
-  while ((c = it.Next()) != base::Utf8Iterator::kInvalidCharIndex) {
+  for (size_t i = 0; i < chars.size(); ++i) {
+    const CharIndex c = chars[i];
     const GlyphIndex g = font.GetDefaultGlyphForChar(c);
     const FreeTypeFont::GlyphMetrics& glyph_metrics = font.GetGlyphMetrics(g);
     if (base::IsInvalidReference(glyph_metrics)) {
@@ -94,7 +96,7 @@ static float ComputeLineWidth(const FreeTypeFont& font,
     }
     prev_c = c;
   }
-  return it.GetState() == base::Utf8Iterator::kEndOfString ? x_max : 0.f;
+  return is_valid ? x_max : 0.f;
 }
 
 const TextSize ComputeTextSize(const FreeTypeFont& font,
@@ -113,10 +115,10 @@ const TextSize ComputeTextSize(const FreeTypeFont& font,
   // font).  First compute how far above the first line's baseline the tallest
   // glyph in the line extends.
   float first_line_above_baseline = 0.f;
-  CharIndex c;
-  base::Utf8Iterator fit(lines.front());
-  while ((c = fit.Next()) != base::Utf8Iterator::kInvalidCharIndex) {
-    const GlyphIndex g = font.GetDefaultGlyphForChar(c);
+  std::vector<CharIndex> chars;
+  base::Utf8Iterator::Decode(lines.front(), &chars);
+  for (size_t i = 0; i < chars.size(); ++i) {
+    const GlyphIndex g = font.GetDefaultGlyphForChar(chars[i]);
     const FreeTypeFont::GlyphMetrics& metrics = font.GetGlyphMetrics(g);
     if (!base::IsInvalidReference(metrics)) {
       first_line_above_baseline = std::max(
@@ -128,9 +130,9 @@ const TextSize ComputeTextSize(const FreeTypeFont& font,
   // Second, compute how far below the last line's baseline the lowest glyph in
   // the line extends.
   float last_line_below_baseline = 0.f;
-  base::Utf8Iterator bit(lines.back());
-  while ((c = bit.Next()) != base::Utf8Iterator::kInvalidCharIndex) {
-    const GlyphIndex g = font.GetDefaultGlyphForChar(c);
+  base::Utf8Iterator::Decode(lines.back(), &chars);
+  for (size_t i = 0; i < chars.size(); ++i) {
+    const GlyphIndex g = font.GetDefaultGlyphForChar(chars[i]);
     const FreeTypeFont::GlyphMetrics& metrics = font.GetGlyphMetrics(g);
     if (!base::IsInvalidReference(metrics)) {
       last_line_below_baseline = std::max(
@@ -382,34 +384,15 @@ static bool InitializeIcu() {
   return icu_initialized;
 }
 
-// Get the glyph index and position offsets for a single glyph from a laid-out
-// VisualRun.
-static void GetGlyphFromRun(const iculx::ParagraphLayout::VisualRun& run,
-                            int which_glyph_in_run, int32* glyph_index,
-                            float* glyph_x, float* glyph_y) {
-  *glyph_index = run.getGlyphs()[which_glyph_in_run];
-  *glyph_x = run.getPositions()[which_glyph_in_run * 2];
-  *glyph_y = -run.getPositions()[which_glyph_in_run * 2 + 1];
-}
-
-// Helper for laying out |text| into |layout| using ICU and |font|.  Returns
-// the total X advance used or 0 in case of error.
-static float IcuLayoutEngineLayoutLine(
-    const FreeTypeFont& font,
-    icu::LEFontInstance* icu_font,
-    const std::string& text,
-    size_t line_index,
-    const FreeTypeFontTransformData& transform_data,
-    Layout* layout) {
-  if (!InitializeIcu() || !icu_font) {
-    return 0.0f;
-  }
-
+// Shapes |text| with ICU and |icu_font|, storing the glyphs of the resulting
+// single line in |run|. Returns false on error.
+static bool ShapeLine(icu::LEFontInstance* icu_font, const std::string& text,
+                      ShapedRun* run) {
   // Convert the string to UTF-16.
   icu::UnicodeString chars = icu::UnicodeString::fromUTF8(text);
   if (chars.isEmpty()) {
     DLOG(ERROR) << "Empty text for layout, or corrupt utf8? [" << text << "]";
-    return 0.0f;
+    return false;
   }
 
   // Generate a ParagraphLayout from the text.
@@ -422,7 +405,7 @@ static float IcuLayoutEngineLayoutLine(
       UBIDI_DEFAULT_LTR, false /* is_vertical */, status));
   if (status != LE_NO_ERROR) {
     DLOG(ERROR) << "new ParagraphLayout error: " << status;
-    return 0.0f;
+    return false;
   }
 
   // Retrieve the glyphs from the layout, passing 0 to nextLine because we want
@@ -430,59 +413,86 @@ static float IcuLayoutEngineLayoutLine(
   icu_layout->reflow();
   std::unique_ptr<iculx::ParagraphLayout::Line> line(icu_layout->nextLine(0));
   if (!line.get()) {
-    return 0.0f;
+    return false;
   }
 
+  // The last real glyph determines the total advance.
   enum { kImpossibleGlyphIndex = -1 };
-  int32 glyph_index = kImpossibleGlyphIndex;
-  float glyph_x = -1;
-  float glyph_y = -1;
-
-  if (layout != NULL) {  // Caller wants all the glyph descriptors
-    layout->Reserve(chars.length());
-    for (int i = 0; i < line->countRuns(); ++i) {
-      const iculx::ParagraphLayout::VisualRun *run = line->getVisualRun(i);
-      for (int j = 0; j < run->getGlyphCount(); ++j) {
-        GetGlyphFromRun(*run, j, &glyph_index, &glyph_x, &glyph_y);
-        if (glyph_index == 0 || glyph_index >= 0xffff)
-          continue;
-        const FreeTypeFont::GlyphMetrics& metrics =
-            font.GetGlyphMetrics(glyph_index);
-        if (base::IsInvalidReference(metrics))
-          continue;
-        glyph_x += metrics.bitmap_offset[0];
-        glyph_y += transform_data.line_y_offset_in_pixels *
-            static_cast<float>(line_index) +
-            (metrics.bitmap_offset[1] - metrics.size[1]);
-        AddGlyphToLayout(glyph_index, line_index, Point2f(glyph_x, glyph_y),
-                         metrics, transform_data,
-                         font.GetSdfPadding(), layout);
-      }
-    }
-  } else {
-    // Just find the final glyph to determine total advance
-    for (int i = line->countRuns() - 1;
-         i >= 0 && glyph_index == kImpossibleGlyphIndex; --i) {
-      const iculx::ParagraphLayout::VisualRun *run = line->getVisualRun(i);
-      for (int j = run->getGlyphCount() - 1; j >= 0; --j) {
-        if (run->getGlyphs()[j] < 0xffff) {
-          GetGlyphFromRun(*run, j, &glyph_index, &glyph_x, &glyph_y);
-          break;
-        }
+  int32 last_glyph_index = kImpossibleGlyphIndex;
+  float last_glyph_x = 0.0f;
+  run->glyphs.reserve(chars.length());
+  for (int i = 0; i < line->countRuns(); ++i) {
+    const iculx::ParagraphLayout::VisualRun *visual_run = line->getVisualRun(i);
+    const LEGlyphID* glyphs = visual_run->getGlyphs();
+    const float* positions = visual_run->getPositions();
+    for (int j = 0; j < visual_run->getGlyphCount(); ++j) {
+      const int32 glyph_index = glyphs[j];
+      if (glyph_index >= 0xffff)
+        continue;
+      last_glyph_index = glyph_index;
+      last_glyph_x = positions[j * 2];
+      if (glyph_index != 0) {
+        run->glyphs.push_back(ShapedRun::Glyph(
+            glyph_index, Point2f(positions[j * 2], -positions[j * 2 + 1])));
       }
     }
   }
-
-  if (glyph_index == kImpossibleGlyphIndex) {
-    return 0.0f;
+  if (last_glyph_index == kImpossibleGlyphIndex) {
+    return false;
   }
 
   // Compute the total advance ourselves since ICU is known to lie.
   LEPoint advance_p;
-  runs.getFont(runs.getCount() - 1)->getGlyphAdvance(glyph_index, advance_p);
-  float final_advance = advance_p.fX;
-  float final_position = glyph_x;
-  return final_advance + final_position;
+  icu_font->getGlyphAdvance(last_glyph_index, advance_p);
+  run->advance = advance_p.fX + last_glyph_x;
+  return true;
+}
+
+// Helper for laying out |text| into |layout| using ICU and |font|. The shaped
+// glyphs are taken from |shaped_runs| if possible, and otherwise are added to
+// it. Returns the total X advance used or 0 in case of error.
+static float IcuLayoutEngineLayoutLine(
+    const FreeTypeFont& font,
+    icu::LEFontInstance* icu_font,
+    ShapedRunCache* shaped_runs,
+    const std::string& text,
+    size_t line_index,
+    const FreeTypeFontTransformData& transform_data,
+    Layout* layout) {
+  if (!InitializeIcu() || !icu_font) {
+    return 0.0f;
+  }
+
+  ShapedRunPtr run;
+  if (shaped_runs)
+    run = shaped_runs->Find(text);
+  if (!run) {
+    std::shared_ptr<ShapedRun> new_run(new ShapedRun);
+    if (!ShapeLine(icu_font, text, new_run.get()))
+      return 0.0f;
+    run = new_run;
+    if (shaped_runs)
+      shaped_runs->Add(text, run);
+  }
+
+  if (layout != NULL) {  // Caller wants all the glyph descriptors
+    layout->Reserve(run->glyphs.size());
+    for (const ShapedRun::Glyph& glyph : run->glyphs) {
+      const FreeTypeFont::GlyphMetrics& metrics =
+          font.GetGlyphMetrics(glyph.glyph_index);
+      if (base::IsInvalidReference(metrics))
+        continue;
+      const float glyph_x = glyph.position[0] + metrics.bitmap_offset[0];
+      const float glyph_y = glyph.position[1] +
+          transform_data.line_y_offset_in_pixels *
+          static_cast<float>(line_index) +
+          (metrics.bitmap_offset[1] - metrics.size[1]);
+      AddGlyphToLayout(glyph.glyph_index, line_index,
+                       Point2f(glyph_x, glyph_y), metrics, transform_data,
+                       font.GetSdfPadding(), layout);
+    }
+  }
+  return run->advance;
 }
 
 // Return true if no character in |text| is in a script that requires complex
@@ -507,10 +517,10 @@ static bool IsInFastUnicodeRange(const std::string& text) {
 
   const CharIndex* begin = g_fast_unicode_ranges;
   const CharIndex* end = begin + arraysize(g_fast_unicode_ranges);
-  base::Utf8Iterator it(text);
-  CharIndex c;
-  while ((c = it.Next()) != base::Utf8Iterator::kInvalidCharIndex) {
-    const CharIndex* search = std::upper_bound(begin, end, c);
+  std::vector<CharIndex> chars;
+  base::Utf8Iterator::Decode(text, &chars);
+  for (size_t i = 0; i < chars.size(); ++i) {
+    const CharIndex* search = std::upper_bound(begin, end, chars[i]);
     // If the upper_bound points to a range start, that means that the
     // character is >= the prior range end, but < the range start, and
     // thus is out of range.  Range starts are at even positions in the table.
@@ -527,6 +537,7 @@ static bool IsInFastUnicodeRange(const std::string& text) { return true; }
 static float IcuLayoutEngineLayoutLine(
     const Font& font,
     icu::LEFontInstance* icu_font,
+    ShapedRunCache* shaped_runs,
     const std::string& text,
     size_t line_index,
     const FreeTypeFontTransformData& transform_data,
@@ -544,10 +555,11 @@ static void SimpleLayOutLine(
     const FreeTypeFontTransformData& transform_data,
     Layout* layout) {
   float x_min = 0.0f;
-  base::Utf8Iterator it(line);
+  std::vector<CharIndex> chars;
+  base::Utf8Iterator::Decode(line, &chars);
   CharIndex prev_c = 0;
-  CharIndex c;
-  while ((c = it.Next()) != base::Utf8Iterator::kInvalidCharIndex) {
+  for (size_t i = 0; i < chars.size(); ++i) {
+    const CharIndex c = chars[i];
     const GlyphIndex g = font.GetDefaultGlyphForChar(c);
     const FreeTypeFont::GlyphMetrics& glyph_metrics = font.GetGlyphMetrics(g);
     if (base::IsInvalidReference(glyph_metrics)) {
@@ -573,9 +585,66 @@ static void SimpleLayOutLine(
   }
 }
 
+//-----------------------------------------------------------------------------
+//
+// ShapedRunCache functions.
+//
+//-----------------------------------------------------------------------------
+
+const size_t ShapedRunCache::kDefaultCapacity;
+
+ShapedRunCache::ShapedRunCache(const base::AllocatorPtr& allocator,
+                               size_t capacity)
+    : runs_(allocator),
+      use_order_(allocator),
+      capacity_(capacity),
+      use_serial_(0) {}
+
+const ShapedRunPtr ShapedRunCache::Find(const std::string& text) {
+  base::LockGuard guard(&mutex_);
+  auto it = runs_.find(text);
+  if (it == runs_.end())
+    return ShapedRunPtr();
+  Touch(text, &it->second);
+  return it->second.run;
+}
+
+void ShapedRunCache::Add(const std::string& text, const ShapedRunPtr& run) {
+  if (!capacity_)
+    return;
+  base::LockGuard guard(&mutex_);
+  Entry& entry = runs_[text];
+  entry.run = run;
+  Touch(text, &entry);
+  while (runs_.size() > capacity_) {
+    auto oldest = use_order_.begin();
+    runs_.erase(oldest->second);
+    use_order_.erase(oldest);
+  }
+}
+
+void ShapedRunCache::Clear() {
+  base::LockGuard guard(&mutex_);
+  runs_.clear();
+  use_order_.clear();
+}
+
+size_t ShapedRunCache::GetSize() const {
+  base::LockGuard guard(&mutex_);
+  return runs_.size();
+}
+
+void ShapedRunCache::Touch(const std::string& text, Entry* entry) {
+  if (entry->last_use)
+    use_order_.erase(entry->last_use);
+  entry->last_use = ++use_serial_;
+  use_order_[entry->last_use] = text;
+}
+
 // Returns a Layout populated by glyphs representing |lines| of text.
 const Layout LayOutText(const FreeTypeFont& font,
                         icu::LEFontInstance* icu_font,
+                        ShapedRunCache* shaped_runs,
                         const Lines& lines,
                         const FreeTypeFontTransformData& transform_data) {
   const size_t num_lines = lines.size();
@@ -584,8 +653,8 @@ const Layout LayOutText(const FreeTypeFont& font,
                               -transform_data.line_y_offset_in_pixels);
   for (size_t i = 0; i < num_lines; ++i) {
     if (icu_font && !IsInFastUnicodeRange(lines[i])) {
-      IcuLayoutEngineLayoutLine(
-          font, icu_font, lines[i], i, transform_data, &layout);
+      IcuLayoutEngineLayoutLine(font, icu_font, shaped_runs, lines[i], i,
+                                transform_data, &layout);
     } else {
       SimpleLayOutLine(font, lines[i], i, transform_data, &layout);
     }
@@ -23,10 +23,15 @@ limitations under the License.
 // These should only be used from within the FreeTypeFont implementation.
 //
 
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "base/integral_types.h"
+#include "ion/base/allocator.h"
+#include "ion/base/stlalloc/allocmap.h"
 #include "ion/math/vector.h"
+#include "ion/port/mutex.h"
 #include "ion/text/layout.h"
 
 namespace icu {
@@ -67,6 +72,68 @@ struct FreeTypeFontTransformData {
 // Lines of text from a single string (usually split on '\n').
 typedef std::vector<std::string> Lines;
 
+// A line of text shaped by the complex text layout engine. Shaping depends
+// only on the text and the font, so a ShapedRun can be reused for every Layout
+// of the same line with the same font, whatever the LayoutOptions.
+struct ShapedRun {
+  // A shaped glyph and its pen position in pixels relative to the start of the
+  // line, with y up.
+  struct Glyph {
+    Glyph(GlyphIndex glyph_index_in, const math::Point2f& position_in)
+        : glyph_index(glyph_index_in), position(position_in) {}
+    GlyphIndex glyph_index;
+    math::Point2f position;
+  };
+
+  ShapedRun() : advance(0.0f) {}
+
+  // The glyphs in visual order.
+  std::vector<Glyph> glyphs;
+  // Total advance of the line in pixels.
+  float advance;
+};
+typedef std::shared_ptr<const ShapedRun> ShapedRunPtr;
+
+// A thread-safe cache of the ShapedRuns of one font, keyed by the UTF-8 text
+// of the line. The script and direction of a run are derived from its text, so
+// the text is a complete key. When the cache is full, the least recently used
+// run is removed.
+class ShapedRunCache {
+ public:
+  ShapedRunCache(const base::AllocatorPtr& allocator, size_t capacity);
+
+  // Returns the cached run for |text|, or a NULL pointer.
+  const ShapedRunPtr Find(const std::string& text);
+  // Caches |run| for |text|, replacing any run already cached for it.
+  void Add(const std::string& text, const ShapedRunPtr& run);
+  // Removes all runs.
+  void Clear();
+
+  size_t GetSize() const;
+  size_t GetCapacity() const { return capacity_; }
+
+  // The default capacity used by FreeTypeFont.
+  static const size_t kDefaultCapacity = 512U;
+
+ private:
+  // A cached run and the serial number of its most recent use.
+  struct Entry {
+    Entry() : last_use(0) {}
+    ShapedRunPtr run;
+    uint64 last_use;
+  };
+
+  // Marks |entry| as the most recently used. The mutex must be locked.
+  void Touch(const std::string& text, Entry* entry);
+
+  base::AllocMap<std::string, Entry> runs_;
+  // Maps the last use serial of each run to its text, oldest first.
+  base::AllocMap<uint64, std::string> use_order_;
+  const size_t capacity_;
+  uint64 use_serial_;
+  mutable port::Mutex mutex_;
+};
+
 // Computes the size of text and returns it as a TextSize instance. Widths
 // include spaces at the ends of the text lines, if any.
 //
@@ -86,9 +153,13 @@ const TextSize ComputeTextSize(const FreeTypeFont& font,
 const FreeTypeFontTransformData ComputeTransformData(
     const Font& font, const LayoutOptions& options, const TextSize& text_size);
 
-// Returns a Layout populated by glyphs representing |lines| of text.
+// Returns a Layout populated by glyphs representing |lines| of text. Lines
+// that need complex text layout are shaped with |icu_font| unless their
+// ShapedRun is in |shaped_runs|, which is updated with newly shaped lines.
+// |shaped_runs| may be NULL.
 const Layout LayOutText(const FreeTypeFont& font,
                         icu::LEFontInstance* icu_font,
+                        ShapedRunCache* shaped_runs,
                         const Lines& lines,
                         const FreeTypeFontTransformData& transform_data);
 
@@ -0,0 +1,206 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/text/glyphcache.h"
+
+#include <stdio.h>
+
+#include <cstring>
+#include <vector>
+
+#include "base/integral_types.h"
+#include "ion/base/logging.h"
+#include "ion/port/fileutils.h"
+#include "ion/port/memorymappedfile.h"
+#include "ion/text/sdfutils.h"
+
+namespace ion {
+namespace text {
+
+namespace {
+
+// A glyph cache file starts with a GlyphCacheHeader, followed by the name of
+// the font padded with zeros to a multiple of 8 bytes, a GlyphCacheEntry for
+// each glyph, and then the SDF values of each glyph in order, as rows of
+// 32-bit floats. All values are stored in the byte order of the machine that
+// wrote the file, and files written with another byte order are ignored.
+static const char kGlyphCacheMagic[8] = {'I', 'o', 'n', 'G', 'l', 'y', 'p',
+                                         'h'};
+static const uint32 kByteOrderMark = 0x01020304U;
+
+struct GlyphCacheHeader {
+  char magic[8];
+  uint32 version;
+  uint32 byte_order;
+  uint32 size_in_pixels;
+  uint32 sdf_padding;
+  uint32 name_length;
+  uint32 glyph_count;
+};
+
+struct GlyphCacheEntry {
+  uint64 glyph_index;
+  uint32 width;
+  uint32 height;
+};
+
+// Returns the size of a font name in the file, including its padding.
+static size_t GetPaddedNameSize(size_t name_length) {
+  return (name_length + 7U) & ~static_cast<size_t>(7U);
+}
+
+// Writes count items to a file, returning false on error.
+template <typename T>
+static bool WriteItems(const T* items, size_t count, FILE* file) {
+  return !count || fwrite(items, sizeof(T), count, file) == count;
+}
+
+}  // anonymous namespace
+
+bool SaveGlyphCache(const Font& font, const std::string& path) {
+  GlyphSet glyphs(font.GetAllocator());
+  font.GetSdfGlyphs(&glyphs);
+
+  // Gather the entries and the grids, converting the values to float. The SDF
+  // values are computed in float, so this does not lose precision.
+  const std::string& name = font.GetName();
+  std::vector<GlyphCacheEntry> entries;
+  std::vector<float> values;
+  entries.reserve(glyphs.size());
+  for (GlyphSet::const_iterator it = glyphs.begin(); it != glyphs.end(); ++it) {
+    const Font::GlyphGrid& grid = font.GetGlyphGrid(*it);
+    DCHECK(!base::IsInvalidReference(grid));
+    GlyphCacheEntry entry;
+    entry.glyph_index = *it;
+    entry.width = static_cast<uint32>(grid.GetWidth());
+    entry.height = static_cast<uint32>(grid.GetHeight());
+    entries.push_back(entry);
+    const size_t count = static_cast<size_t>(entry.width) * entry.height;
+    if (!count)
+      continue;
+    if (grid.is_quantized) {
+      // Quantized values are stored as the distances that quantize to them.
+      const uint8* quantized = &grid.quantized_pixels.Get(0, 0);
+      for (size_t i = 0; i < count; ++i)
+        values.push_back(static_cast<float>(
+            DequantizeSdfValue(quantized[i], font.GetSdfPadding())));
+    } else {
+      const double* pixels = &grid.pixels.Get(0, 0);
+      for (size_t i = 0; i < count; ++i)
+        values.push_back(static_cast<float>(pixels[i]));
+    }
+  }
+
+  GlyphCacheHeader header;
+  memcpy(header.magic, kGlyphCacheMagic, sizeof(header.magic));
+  header.version = kGlyphCacheVersion;
+  header.byte_order = kByteOrderMark;
+  header.size_in_pixels = static_cast<uint32>(font.GetSizeInPixels());
+  header.sdf_padding = static_cast<uint32>(font.GetSdfPadding());
+  header.name_length = static_cast<uint32>(name.length());
+  header.glyph_count = static_cast<uint32>(entries.size());
+  std::vector<char> padded_name(GetPaddedNameSize(name.length()), 0);
+  memcpy(padded_name.data(), name.data(), name.length());
+
+  FILE* file = port::OpenFile(path, "wb");
+  if (!file) {
+    LOG(ERROR) << "Unable to open glyph cache file \"" << path
+               << "\" for writing.";
+    return false;
+  }
+  const bool written =
+      WriteItems(&header, 1U, file) &&
+      WriteItems(padded_name.data(), padded_name.size(), file) &&
+      WriteItems(entries.data(), entries.size(), file) &&
+      WriteItems(values.data(), values.size(), file);
+  const bool closed = fclose(file) == 0;
+  if (!written || !closed) {
+    LOG(ERROR) << "Unable to write glyph cache file \"" << path << "\".";
+    port::RemoveFile(path);
+    return false;
+  }
+  return true;
+}
+
+size_t LoadGlyphCache(const std::string& path, Font* font) {
+  DCHECK(font);
+  port::MemoryMappedFile file(path);
+  const uint8* data = static_cast<const uint8*>(file.GetData());
+  const size_t length = file.GetLength();
+  if (!data || length < sizeof(GlyphCacheHeader))
+    return 0U;
+
+  // Check that the file is valid and matches the font.
+  GlyphCacheHeader header;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, kGlyphCacheMagic, sizeof(header.magic)) ||
+      header.version != kGlyphCacheVersion ||
+      header.byte_order != kByteOrderMark) {
+    LOG(WARNING) << "Ignoring glyph cache file \"" << path
+                 << "\" with an unsupported version.";
+    return 0U;
+  }
+  const std::string& name = font->GetName();
+  const size_t name_size = GetPaddedNameSize(header.name_length);
+  size_t offset = sizeof(header);
+  if (header.size_in_pixels != font->GetSizeInPixels() ||
+      header.sdf_padding != font->GetSdfPadding() ||
+      header.name_length != name.length() || name_size > length - offset ||
+      memcmp(data + offset, name.data(), name.length()))
+    return 0U;
+  offset += name_size;
+
+  // Read the entries, checking that the grids fit in the file.
+  const size_t glyph_count = header.glyph_count;
+  if (glyph_count > (length - offset) / sizeof(GlyphCacheEntry)) {
+    LOG(ERROR) << "Glyph cache file \"" << path << "\" is truncated.";
+    return 0U;
+  }
+  std::vector<GlyphCacheEntry> entries(glyph_count);
+  if (glyph_count)
+    memcpy(entries.data(), data + offset, glyph_count * sizeof(entries[0]));
+  offset += glyph_count * sizeof(GlyphCacheEntry);
+  size_t value_count = 0U;
+  for (size_t i = 0; i < glyph_count; ++i)
+    value_count += static_cast<size_t>(entries[i].width) * entries[i].height;
+  if (value_count > (length - offset) / sizeof(float)) {
+    LOG(ERROR) << "Glyph cache file \"" << path << "\" is truncated.";
+    return 0U;
+  }
+
+  size_t added_count = 0U;
+  for (size_t i = 0; i < glyph_count; ++i) {
+    const GlyphCacheEntry& entry = entries[i];
+    base::Array2<double> grid(entry.width, entry.height);
+    const size_t count = grid.GetSize();
+    if (count) {
+      double* pixels = grid.GetMutable(0, 0);
+      for (size_t j = 0; j < count; ++j) {
+        float value;
+        memcpy(&value, data + offset + j * sizeof(value), sizeof(value));
+        pixels[j] = value;
+      }
+    }
+    offset += count * sizeof(float);
+    if (font->AddSdfGrid(static_cast<GlyphIndex>(entry.glyph_index), grid))
+      ++added_count;
+  }
+  return added_count;
+}
+
+}  // namespace text
+}  // namespace ion
@@ -0,0 +1,54 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_TEXT_GLYPHCACHE_H_
+#define ION_TEXT_GLYPHCACHE_H_
+
+// This file contains functions that save the SDF grids cached in a Font to a
+// binary file and load them back into a Font, so that an application does not
+// have to rasterize its glyphs and compute their SDF grids again each time it
+// starts. The file is read through a memory mapping. Its header stores a
+// version number and the name, size and SDF padding of the font, and files
+// that do not match the Font they are loaded into are ignored.
+
+#include <string>
+
+#include "base/integral_types.h"
+#include "ion/text/font.h"
+
+namespace ion {
+namespace text {
+
+// The version of the glyph cache file format. Files with other versions are
+// ignored.
+static const uint32 kGlyphCacheVersion = 1U;
+
+// Writes the SDF grids that |font| has cached (see Font::CacheSdfGrids()) to
+// the file at |path|, replacing it. Returns false if the file cannot be
+// written.
+ION_API bool SaveGlyphCache(const Font& font, const std::string& path);
+
+// Adds the SDF grids stored in the glyph cache file at |path| to |font| for the
+// glyphs that do not have one yet. Returns the number of grids added, which is
+// 0 if the file does not exist, is invalid, or was written for a Font with a
+// different name, size or SDF padding.
+ION_API size_t LoadGlyphCache(const std::string& path, Font* font);
+
+}  // namespace text
+}  // namespace ion
+
+#endif  // ION_TEXT_GLYPHCACHE_H_
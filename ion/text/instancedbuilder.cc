@@ -0,0 +1,302 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/text/instancedbuilder.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "ion/base/logging.h"
+#include "ion/gfx/attribute.h"
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/indexbuffer.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shaderinputregistry.h"
+#include "ion/gfx/shape.h"
+#include "ion/gfx/uniform.h"
+#include "ion/gfxutils/buffertoattributebinder.h"
+#include "ion/math/range.h"
+#include "ion/text/font.h"
+#include "ion/text/layout.h"
+
+namespace ion {
+namespace text {
+
+namespace {
+
+//-----------------------------------------------------------------------------
+//
+// Shader source strings.
+//
+//-----------------------------------------------------------------------------
+
+static const char* kVertexShaderSource =
+    "uniform mat4 uProjectionMatrix;\n"
+    "uniform mat4 uModelviewMatrix;\n"
+    "attribute vec2 aCorner;\n"
+    "attribute vec3 aPosition;\n"
+    "attribute vec2 aSize;\n"
+    "attribute vec4 aTextureRect;\n"
+    "attribute vec4 aColor;\n"
+    "varying vec2 texture_coords;\n"
+    "varying vec4 text_color;\n"
+    "\n"
+    "void main(void) {\n"
+    "  texture_coords = mix(aTextureRect.xy, aTextureRect.zw, aCorner);\n"
+    "  text_color = aColor;\n"
+    "  vec3 vertex = aPosition + vec3(aCorner * aSize, 0.);\n"
+    "  gl_Position = uProjectionMatrix * uModelviewMatrix * vec4(vertex, 1);\n"
+    "}\n";
+
+static const char* kFragmentShaderSource =
+    "#ifdef GL_ES\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#endif\n"
+    "\n"
+    "varying vec2 texture_coords;\n"
+    "varying vec4 text_color;\n"
+    "uniform sampler2D uSdfSampler;\n"
+    "uniform float uSdfPadding;\n"
+    "\n"
+    "void main(void) {\n"
+    "#ifdef ION_MULTI_CHANNEL_SDF\n"
+    "  vec3 msdf = texture2D(uSdfSampler, texture_coords).rgb;\n"
+    "  float dist = max(min(msdf.r, msdf.g),\n"
+    "      min(max(msdf.r, msdf.g), msdf.b));\n"
+    "#else\n"
+    "  float dist = texture2D(uSdfSampler, texture_coords).r;\n"
+    "#endif\n"
+    "  float s = uSdfPadding == 0. ? 0.2 : 0.2 / uSdfPadding;\n"
+    "  float d = 1.0 - smoothstep(-s, s, dist - 0.5);\n"
+    "  if (dist > 0.5 + s)\n"
+    "    discard;\n"
+    "  gl_FragColor = d * text_color;\n"
+    "}\n";
+
+// The corners of the shared quad, in the order of Layout::Quad points.
+static const math::Point2f kCorners[4] = {
+    math::Point2f(0.f, 0.f), math::Point2f(1.f, 0.f),
+    math::Point2f(1.f, 1.f), math::Point2f(0.f, 1.f)};
+
+// Returns a normalized value in [0, 1] as a fixed-point integer.
+template <typename T>
+static T Normalize(float value) {
+  static const float kMax = static_cast<float>(std::numeric_limits<T>::max());
+  return static_cast<T>(std::min(std::max(value, 0.f), 1.f) * kMax + 0.5f);
+}
+
+// Returns a color as normalized unsigned bytes.
+static const math::Vector4ui8 NormalizeColor(const math::Vector4f& color) {
+  return math::Vector4ui8(Normalize<uint8>(color[0]), Normalize<uint8>(color[1]),
+                          Normalize<uint8>(color[2]),
+                          Normalize<uint8>(color[3]));
+}
+
+}  // anonymous namespace
+
+//-----------------------------------------------------------------------------
+//
+// InstancedBuilder functions.
+//
+//-----------------------------------------------------------------------------
+
+InstancedBuilder::InstancedBuilder(
+    const FontImagePtr& font_image,
+    const gfxutils::ShaderManagerPtr& shader_manager,
+    const base::AllocatorPtr& allocator)
+    : Builder(font_image, shader_manager, allocator),
+      color_(1.f, 1.f, 1.f, 1.f),
+      glyph_count_(0),
+      instances_(NULL) {}
+
+InstancedBuilder::~InstancedBuilder() {}
+
+bool InstancedBuilder::SetGlyphPosition(size_t index,
+                                        const math::Point3f& position) {
+  if (!instances_ || index >= glyph_count_)
+    return false;
+  instances_[index].position = position;
+  UploadInstance(index);
+  return true;
+}
+
+bool InstancedBuilder::SetGlyphColor(size_t index,
+                                     const math::Vector4f& color) {
+  if (!instances_ || index >= glyph_count_)
+    return false;
+  instances_[index].color = NormalizeColor(color);
+  UploadInstance(index);
+  return true;
+}
+
+void InstancedBuilder::UploadInstance(size_t index) {
+  const gfx::AttributeArrayPtr& attr_array =
+      GetNode()->GetShapes()[0]->GetAttributeArray();
+  const gfx::BufferObjectPtr& bo = attr_array->GetBufferAttribute(0)
+      .GetValue<gfx::BufferObjectElement>().buffer_object;
+  const size_t offset = index * sizeof(Instance);
+  bo->SetSubData(
+      math::Range1ui(static_cast<uint32>(offset),
+                     static_cast<uint32>(offset + sizeof(Instance))),
+      base::DataContainer::CreateAndCopy<char>(
+          reinterpret_cast<const char*>(&instances_[index]), sizeof(Instance),
+          true, GetAllocator()));
+}
+
+const gfx::ShaderInputRegistryPtr InstancedBuilder::GetShaderInputRegistry() {
+  gfx::ShaderInputRegistryPtr reg(new(GetAllocator()) gfx::ShaderInputRegistry);
+  reg->IncludeGlobalRegistry();
+  reg->Add(gfx::ShaderInputRegistry::UniformSpec(
+      "uSdfPadding", gfx::kFloatUniform, "SDF padding amount"));
+  reg->Add(gfx::ShaderInputRegistry::UniformSpec(
+      "uSdfSampler", gfx::kTextureUniform, "SDF font texture sampler"));
+  reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+      "aCorner", gfx::kBufferObjectElementAttribute,
+      "Corner of the glyph quad"));
+  reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+      "aPosition", gfx::kBufferObjectElementAttribute,
+      "Lower-left corner of the glyph"));
+  reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+      "aSize", gfx::kBufferObjectElementAttribute, "Size of the glyph"));
+  reg->Add(gfx::ShaderInputRegistry::AttributeSpec(
+      "aTextureRect", gfx::kBufferObjectElementAttribute,
+      "Texture coordinates of the glyph corners"));
+  return reg;
+}
+
+void InstancedBuilder::GetShaderStrings(std::string* id_string,
+                                        std::string* vertex_source,
+                                        std::string* fragment_source) {
+  *id_string = "Instanced Text Shader";
+  *vertex_source = kVertexShaderSource;
+  *fragment_source = kFragmentShaderSource;
+}
+
+void InstancedBuilder::UpdateUniforms(
+    const gfx::ShaderInputRegistryPtr& registry, gfx::Node* node) {
+  const Font* font = GetFont().Get();
+  const float sdf_padding =
+      font ? static_cast<float>(font->GetSdfPadding()) : 0.f;
+  // Add uniforms if not already there.
+  if (node->GetUniforms().size() < 2U)
+    node->ClearUniforms();
+  if (node->GetUniforms().empty()) {
+    node->AddUniform(registry->Create<gfx::Uniform>(
+        "uSdfPadding", sdf_padding));
+    node->AddUniform(registry->Create<gfx::Uniform>(
+        "uSdfSampler", GetFontImageTexture()));
+  } else {
+    node->SetUniformValue<float>(0U, sdf_padding);
+    UpdateFontImageTextureUniform(1U, node);
+  }
+}
+
+void InstancedBuilder::BindAttributes(
+    const gfx::AttributeArrayPtr& attr_array,
+    const gfx::BufferObjectPtr& buffer_object) {
+  // The instance buffer must be bound first, since Builder reuses the first
+  // buffer of the AttributeArray for new vertex data.
+  const gfx::ShaderInputRegistryPtr& registry =
+      GetNode()->GetShaderProgram()->GetRegistry();
+  Instance instance;
+  gfxutils::BufferToAttributeBinder<Instance>(instance)
+      .Bind(instance.position, "aPosition", 1U)
+      .Bind(instance.size, "aSize", 1U)
+      .BindAndNormalize(instance.texture_rect, "aTextureRect", 1U)
+      .BindAndNormalize(instance.color, "aColor", 1U)
+      .Apply(registry, attr_array, buffer_object);
+
+  // The shared quad never changes.
+  gfx::BufferObjectPtr corner_bo(new(GetAllocator()) gfx::BufferObject);
+  corner_bo->SetData(
+      base::DataContainer::CreateAndCopy<math::Point2f>(
+          kCorners, 4U, true, GetAllocator()),
+      sizeof(kCorners[0]), 4U, gfx::BufferObject::kStaticDraw);
+  math::Point2f corner;
+  gfxutils::BufferToAttributeBinder<math::Point2f>(corner)
+      .Bind(corner, "aCorner")
+      .Apply(registry, attr_array, corner_bo);
+}
+
+base::AllocVector<char> InstancedBuilder::BuildVertexData(
+    const Layout& layout, size_t* vertex_size, size_t* num_vertices) {
+  // There is one Instance per glyph.
+  const size_t num_glyphs = layout.GetGlyphCount();
+  *num_vertices = num_glyphs;
+  *vertex_size = sizeof(Instance);
+  base::AllocVector<char> vertex_data(
+      GetAllocator()->GetAllocatorForLifetime(base::kShortTerm));
+  vertex_data.resize(sizeof(Instance) * num_glyphs);
+  Instance* instances = reinterpret_cast<Instance*>(&vertex_data[0]);
+  const math::Vector4ui8 color = NormalizeColor(color_);
+  math::Point3f positions[4];
+  math::Point2f texture_coords[4];
+  for (size_t i = 0; i < num_glyphs; ++i) {
+    StoreGlyphVertices(layout, i, positions, texture_coords);
+    Instance& instance = instances[i];
+    instance.position = positions[0];
+    const math::Vector3f diagonal = positions[2] - positions[0];
+    instance.size.Set(diagonal[0], diagonal[1]);
+    instance.texture_rect.Set(Normalize<uint16>(texture_coords[0][0]),
+                              Normalize<uint16>(texture_coords[0][1]),
+                              Normalize<uint16>(texture_coords[2][0]),
+                              Normalize<uint16>(texture_coords[2][1]));
+    instance.color = color;
+  }
+  return vertex_data;
+}
+
+void InstancedBuilder::UpdateIndexBuffer(const Layout& layout,
+                                         bool vertices_reused,
+                                         gfx::Shape* shape) {
+  // All glyphs share the 2 triangles of one quad.
+  if (!shape->GetIndexBuffer().Get()) {
+    static const uint16 kIndices[6] = {0, 1, 2, 0, 2, 3};
+    gfx::IndexBufferPtr index_buffer(new(GetAllocator()) gfx::IndexBuffer);
+    index_buffer->AddSpec(gfx::BufferObject::kUnsignedShort, 1, 0);
+    index_buffer->SetData(
+        base::DataContainer::CreateAndCopy<uint16>(kIndices, 6U, true,
+                                                   GetAllocator()),
+        sizeof(kIndices[0]), 6U, gfx::BufferObject::kStaticDraw);
+    shape->SetIndexBuffer(index_buffer);
+  }
+  glyph_count_ = layout.GetGlyphCount();
+  shape->SetInstanceCount(static_cast<int>(glyph_count_));
+
+  // Keep a pointer to the instance data if it can be updated in place. This
+  // is called before the data is uploaded, so the notification caused by
+  // GetMutableData() costs nothing extra.
+  instance_container_.Reset();
+  instances_ = NULL;
+  const gfx::Attribute& attr =
+      shape->GetAttributeArray()->GetBufferAttribute(0);
+  const gfx::BufferObjectPtr& bo =
+      attr.GetValue<gfx::BufferObjectElement>().buffer_object;
+  if (bo->GetUsageMode() != gfx::BufferObject::kStaticDraw) {
+    instance_container_ = bo->GetData();
+    if (instance_container_.Get())
+      instances_ = instance_container_->GetMutableData<Instance>();
+  }
+}
+
+}  // namespace text
+}  // namespace ion
@@ -0,0 +1,126 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef ION_TEXT_INSTANCEDBUILDER_H_
+#define ION_TEXT_INSTANCEDBUILDER_H_
+
+#include "ion/base/datacontainer.h"
+#include "ion/math/vector.h"
+#include "ion/text/builder.h"
+
+namespace ion {
+namespace text {
+
+// InstancedBuilder is a derived Builder class that draws every glyph of a
+// Layout as an instance of a single shared quad. Instead of 4 vertices per
+// glyph, the vertex buffer holds one compact record per glyph with the
+// position and size of its quad, its rectangle in the FontImage texture, and
+// its color; the vertex shader expands each record into a quad. This stores
+// less than half as much data per glyph as BasicBuilder, and lets single
+// glyphs be moved or recolored by updating their records in place.
+//
+// Glyph quads must be rectangles parallel to the XY-plane, as built by
+// Font::BuildLayout(); use a transform in the scene to place text elsewhere.
+// Other quads are drawn as the rectangle spanned by their lower-left and
+// upper-right points. The Shape needs instanced drawing
+// (GraphicsManager::kInstancedDrawing); without it only the first glyph is
+// drawn.
+//
+// The Node contains the following uniforms:
+//   uSdfPadding       [float, derived from Font]
+//     Number of pixels used to pad SDF images.
+//   uSdfSampler       [sampler2D, derived from FontImage]
+//     Sampler for the SDF texture.
+// The color of each glyph is stored in its aColor instance attribute.
+class ION_API InstancedBuilder : public Builder {
+ public:
+  InstancedBuilder(const FontImagePtr& font_image,
+                   const gfxutils::ShaderManagerPtr& shader_manager,
+                   const base::AllocatorPtr& allocator);
+
+  // Sets/returns the color given to all glyphs by subsequent calls to Build().
+  // The default is opaque white. Components are clamped to [0, 1].
+  void SetColor(const math::Vector4f& color) { color_ = color; }
+  const math::Vector4f& GetColor() const { return color_; }
+
+  // Returns the number of glyph instances built by the last call to Build().
+  size_t GetGlyphCount() const { return glyph_count_; }
+
+  // Each of these modifies the indexed glyph from the last call to Build() in
+  // place, uploading only its record. SetGlyphPosition() moves the lower-left
+  // corner of the glyph's quad. They return false if the index is out of range
+  // or if the last call to Build() used kStaticDraw, since static data may be
+  // wiped after it is uploaded.
+  bool SetGlyphPosition(size_t index, const math::Point3f& position);
+  bool SetGlyphColor(size_t index, const math::Vector4f& color);
+
+ protected:
+  // The destructor is protected because all base::Referent classes must have
+  // protected or private destructors.
+  ~InstancedBuilder() override;
+
+  // Required Builder functions.
+  const gfx::ShaderInputRegistryPtr GetShaderInputRegistry() override;
+  void GetShaderStrings(std::string* id_string,
+                        std::string* vertex_source,
+                        std::string* fragment_source) override;
+  void UpdateUniforms(const gfx::ShaderInputRegistryPtr& registry,
+                      gfx::Node* node) override;
+  void BindAttributes(const gfx::AttributeArrayPtr& attr_array,
+                      const gfx::BufferObjectPtr& buffer_object) override;
+  base::AllocVector<char> BuildVertexData(const Layout& layout,
+                                          size_t* vertex_size,
+                                          size_t* num_vertices) override;
+
+  // Draws the shared quad once per glyph record.
+  void UpdateIndexBuffer(const Layout& layout, bool vertices_reused,
+                         gfx::Shape* shape) override;
+
+ private:
+  // The record stored for each glyph.
+  struct Instance {
+    // Lower-left corner of the glyph quad.
+    math::Point3f position;
+    // Width and height of the glyph quad.
+    math::Vector2f size;
+    // Normalized texture coordinates of the lower-left and upper-right
+    // corners of the quad: (u0, v0, u1, v1).
+    math::Vector4ui16 texture_rect;
+    // Normalized color.
+    math::Vector4ui8 color;
+  };
+
+  // Uploads the indexed Instance from instances_ as sub-data.
+  void UploadInstance(size_t index);
+
+  // Color for glyphs built by Build().
+  math::Vector4f color_;
+  // Number of glyphs built by the last call to Build().
+  size_t glyph_count_;
+  // The data of the instance buffer and a pointer to its Instances, if they
+  // can be updated in place.
+  base::DataContainerPtr instance_container_;
+  Instance* instances_;
+};
+
+// Convenience typedef for shared pointer to an InstancedBuilder.
+typedef base::ReferentPtr<InstancedBuilder>::Type InstancedBuilderPtr;
+
+}  // namespace text
+}  // namespace ion
+
+#endif  // ION_TEXT_INSTANCEDBUILDER_H_
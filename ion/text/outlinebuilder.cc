@@ -108,7 +108,13 @@ static const char* kFragmentShaderSource =
     "\n"
     "  // Get the signed distance from the edge in font pixels, centered at\n"
     "  // 0, then convert to screen pixels.\n"
+    "#ifdef ION_MULTI_CHANNEL_SDF\n"
+    "  vec3 msdf = texture2D(uSdfSampler, vTexCoords).rgb;\n"
+    "  float sdf = max(min(msdf.r, msdf.g),\n"
+    "      min(max(msdf.r, msdf.g), msdf.b));\n"
+    "#else\n"
     "  float sdf = texture2D(uSdfSampler, vTexCoords).r;\n"
+    "#endif\n"
     "  float dist = uSdfPadding * 2.0 * (sdf - 0.5);\n"
     "  float pixel_scale = mix(vFontPixelSize.x, vFontPixelSize.y, 0.5);\n"
     "  dist *= pixel_scale;\n"
@@ -156,8 +162,8 @@ static const math::Vector3f ComputeFontPixelVec(
   const Font::GlyphGrid& grid = font.GetGlyphGrid(glyph.glyph_index);
   math::Vector3f vec(math::Vector3f::Zero());
   if (!base::IsInvalidReference(grid)) {
-    const size_t width = grid.pixels.GetWidth();
-    const size_t height = grid.pixels.GetHeight();
+    const size_t width = grid.GetWidth();
+    const size_t height = grid.GetHeight();
     if (width && height) {
       const float inv_width = 1.0f / static_cast<float>(width);
       const float inv_height = 1.0f / static_cast<float>(height);
@@ -17,9 +17,12 @@ limitations under the License.
 
 #include "ion/text/sdfutils.h"
 
-#include "ion/base/logging.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 #include "ion/math/utils.h"
-#include "ion/math/vector.h"
 #include "ion/math/vectorutils.h"
 
 namespace ion {
@@ -28,8 +31,6 @@ namespace text {
 namespace {
 
 using base::Array2;
-using math::Vector2d;
-using math::Vector2i;
 
 // Convenience typedef for a Grid, which is a 2D array of doubles, typically
 // pixel values or signed distances.
@@ -37,378 +38,378 @@ typedef Array2<double> Grid;
 
 //-----------------------------------------------------------------------------
 //
-// The DistanceComputer class implements the main functions to compute signed
-// distance fields.
+// The DistanceTransform class computes exact Euclidean distance transforms
+// with the separable algorithm described in "Distance Transforms of Sampled
+// Functions" by Felzenszwalb and Huttenlocher. A 2D transform is a 1D
+// transform of each row followed by a 1D transform of each column of the
+// result, so the cost is linear in the number of pixels. Each 1D transform
+// computes the lower envelope of the parabolas rooted at the samples.
 //
-// This code is an implementation of the algorithm described at
-// <http://contourtextures.wikidot.com>. The advantage of this algorithm over
-// other SDF generators is that it uses an antialiased rendered font instead of
-// a bitmapped font. A bitmapped font would have to be rendered at much higher
-// resolution to achieve the same quality as provided here.
+// The rows are transformed into a transposed buffer so that the columns can
+// also be transformed as contiguous rows, and all values are floats.
 //
 //-----------------------------------------------------------------------------
 
-class DistanceComputer {
+class DistanceTransform {
  public:
-  DistanceComputer() {}
-  ~DistanceComputer() {}
+  DistanceTransform(size_t width, size_t height)
+      : width_(width),
+        height_(height),
+        transposed_(width * height),
+        envelope_(std::max(width, height)),
+        boundaries_(std::max(width, height) + 1U),
+        row_(std::max(width, height)) {}
+
+  // Replaces the squared distances in |grid|, which has the size passed to
+  // the constructor, with the squared distance from each pixel to the pixel
+  // that minimizes the squared distance between them plus the input value of
+  // that pixel. Pixels at kLargeDistance are thus treated as being outside the
+  // shape, those at 0 as being inside it, and those in between as being
+  // offset from an edge.
+  void Transform(float* grid) {
+    // Transform the rows, writing them as columns of |transposed_|.
+    for (size_t y = 0; y < height_; ++y) {
+      Transform1d(&grid[y * width_], width_);
+      for (size_t x = 0; x < width_; ++x)
+        transposed_[x * height_ + y] = row_[x];
+    }
+    // Transform the columns, writing them back into |grid|.
+    for (size_t x = 0; x < width_; ++x) {
+      Transform1d(&transposed_[x * height_], height_);
+      for (size_t y = 0; y < height_; ++y)
+        grid[y * width_ + x] = row_[y];
+    }
+  }
 
-  // Computes and returns a Grid containing signed distances for a Grid
-  // representing a grayscale image.  Each pixel's value ("signed distance") is
-  // the distance from the center of that pixel to the nearest boundary/edge,
-  // signed so that pixels inside the boundary are negative and those outside
-  // the boundary are positive.
-  const Grid Compute(const Grid& image);
+  // Represents a large squared distance, i.e., a pixel outside the shape.
+  static const float kLargeDistance;
 
  private:
-  // This struct is used to pass most of the current data to the main
-  // computation functions.
-  struct Data {
-    Data(const Grid& image_in, const Array2<Vector2d>& gradients_in)
-        : image(image_in),
-          gradients(gradients_in),
-          cur_pixel(0, 0),
-          any_distance_changed(false) {}
-
-    // Convenience access functions.
-    void SetCurDistance(double dist) {
-      distances.Set(cur_pixel[0], cur_pixel[1], dist);
-    }
-    double GetCurDistance() const {
-      return distances.Get(cur_pixel[0], cur_pixel[1]);
-    }
-    void SetCurDistanceToEdge(const Vector2i& dist) {
-      distances_to_edges.Set(cur_pixel[0], cur_pixel[1], dist);
+  // Computes the 1D transform of the |n| values in |f| into |row_|.
+  void Transform1d(const float* f, size_t n) {
+    const float kInfinity = std::numeric_limits<float>::infinity();
+    // Find the parabolas that form the lower envelope, and where each one
+    // starts.
+    size_t k = 0;
+    envelope_[0] = 0;
+    boundaries_[0] = -kInfinity;
+    boundaries_[1] = kInfinity;
+    for (size_t q = 1; q < n; ++q) {
+      const float fq = f[q] + static_cast<float>(q * q);
+      // Drop the parabolas that the new one hides. The first boundary is
+      // -infinity, so at least one parabola always remains.
+      float s;
+      while (true) {
+        const size_t r = envelope_[k];
+        s = (fq - f[r] - static_cast<float>(r * r)) /
+            static_cast<float>(2U * (q - r));
+        if (s > boundaries_[k])
+          break;
+        --k;
+      }
+      ++k;
+      envelope_[k] = q;
+      boundaries_[k] = s;
+      boundaries_[k + 1] = kInfinity;
     }
-    const Vector2i& GetDistanceToEdge(const Vector2i& pixel) const {
-      return distances_to_edges.Get(pixel[0], pixel[1]);
+    // Evaluate the envelope at each sample.
+    k = 0;
+    for (size_t q = 0; q < n; ++q) {
+      while (boundaries_[k + 1] < static_cast<float>(q))
+        ++k;
+      const size_t r = envelope_[k];
+      const float d = static_cast<float>(q) - static_cast<float>(r);
+      row_[q] = d * d + f[r];
     }
+  }
 
-    // The original monochrome image data, as doubles (0 - 1).
-    const Grid& image;
-    // Local gradients in X and Y.
-    const Array2<Vector2d>& gradients;
-    // Current pixel distances in X and Y to edges.
-    Array2<Vector2i> distances_to_edges;
-    // Final distance values.
-    Grid distances;
-    // Indices of the current pixel being operated on.
-    Vector2i cur_pixel;
-    // This is set to true when a value in the distances grid is modified.
-    bool any_distance_changed;
-  };
-
-  // Computes the local gradients of an image in the X and Y dimensions and
-  // returns them as an Array2<Vector2d>.
-  static const Array2<Vector2d> ComputeGradients(const Grid& image);
-
-  // Applies a 3x3 filter kernel to an image pixel to get the gradients.
-  static const Vector2d FilterPixel(const Grid& image, size_t x, size_t y);
-
-  // Creates and initializes a grid containing the distances.
-  static const Grid InitializeDistanceGrid(
-      const Grid& image, const Array2<Vector2d>& gradients);
-
-  // Approximates the distance to an image edge from a pixel using the pixel
-  // value and the local gradient.
-  static double ApproximateDistanceToEdge(double value,
-                                          const Vector2d& gradient);
-
-  // Computes and returns the distances.
-  static void ComputeDistances(Data* data);
-
-  // Computes the distance from data->cur_pixel to an edge pixel based on the
-  // information at the pixel at (data->cur_pixel + offset). If the new
-  // distance is smaller than the current distance (dist), this modifies dist
-  // and sets data->any_distance_changed to true.
-  static void UpdateDistance(Data* data, const Vector2i& offset, double* dist);
-
-  // Computes the new distance from a pixel to an edge pixel based on previous
-  // information.
-  static double ComputeDistanceToEdge(Data* data, const Vector2i& pixel,
-                                      const Vector2d& vec_to_edge_pixel);
-
-  // Represents a large distance during computation.
-  static const double kLargeDistance;
+  const size_t width_;
+  const size_t height_;
+  std::vector<float> transposed_;
+  // The samples whose parabolas form the lower envelope.
+  std::vector<size_t> envelope_;
+  // Where each parabola of the envelope starts and ends.
+  std::vector<float> boundaries_;
+  // The output of Transform1d().
+  std::vector<float> row_;
 };
 
-const double DistanceComputer::kLargeDistance = 1e6;
-
-const Grid DistanceComputer::Compute(const Grid& image) {
-  // Compute the local gradients in both dimensions.
-  const Array2<Vector2d> gradients = ComputeGradients(image);
-
-  // Store everything in a struct to pass to the main computation function.
-  Data data(image, gradients);
-  data.distances_to_edges =
-      Array2<Vector2i>(image.GetWidth(), image.GetHeight(), Vector2i::Zero());
-  data.distances = InitializeDistanceGrid(image, gradients);
-  ComputeDistances(&data);
+const float DistanceTransform::kLargeDistance = 1e20f;
 
-  return data.distances;
-}
-
-const Array2<Vector2d> DistanceComputer::ComputeGradients(const Grid& image) {
-  const size_t h = image.GetHeight();
-  const size_t w = image.GetWidth();
-
-  Array2<Vector2d> gradients(w, h, Vector2d::Zero());
-
-  // This computes the local gradients at pixels near black/white boundaries in
-  // the image using convolution filters. The gradient is not needed at other
-  // pixels, where it's mostly zero anyway.
-
-  // The 3x3 kernel does not work at the edges, so skip those pixels.
-  // TODO(user): Use a subset of the filter kernels for edge pixels.
-  for (size_t y = 1; y < h - 1; ++y) {
-    for (size_t x = 1; x < w - 1; ++x) {
-      const double value = image.Get(x, y);
-      // If the pixel is fully on or off, leave the gradient as (0,0).
-      // Otherwise, compute it.
-      if (value > 0.0 && value < 1.0)
-        gradients.Set(x, y, FilterPixel(image, x, y));
-    }
-  }
-  return gradients;
-}
+//-----------------------------------------------------------------------------
+//
+// Helper functions.
+//
+//-----------------------------------------------------------------------------
 
-const Vector2d DistanceComputer::FilterPixel(const Grid& image,
-                                             size_t x, size_t y) {
-  // 3x3 filter kernel. The X gradient uses the array as is and the Y gradient
-  // uses the transpose.
-  static const double kSqrt2 = sqrt(2.0);
-  static const double kFilter[3][3] = {
-    { -1.0,    0.0, 1.0    },
-    { -kSqrt2, 0.0, kSqrt2 },
-    { -1.0,    0.0, 1.0    },
-  };
-
-  Vector2d filtered(0.0, 0.0);
-  for (int i = 0; i < 3; ++i) {
-    for (int j = 0; j < 3; ++j) {
-      const double val = image.Get(x + j - 1, y + i - 1);
-      filtered[0] += kFilter[i][j] * val;
-      filtered[1] += kFilter[j][i] * val;
+// Builds and returns a signed distance field grid for an input grid containing
+// antialiased pixel values, padded by |padding| pixels of background.
+static const Grid BuildSdfGrid(const Grid& grid, size_t padding) {
+  const size_t width = grid.GetWidth() + 2U * padding;
+  const size_t height = grid.GetHeight() + 2U * padding;
+  Grid sdf(width, height);
+  if (!grid.GetWidth() || !grid.GetHeight())
+    return sdf;
+
+  // Seed the squared distances to the background (outside) and to the
+  // foreground (inside) of the image. A fully covered pixel is inside, an
+  // empty one is outside, and the coverage of a partially covered pixel
+  // approximates how far its center is from the edge.
+  const float kLarge = DistanceTransform::kLargeDistance;
+  const size_t size = width * height;
+  std::vector<float> outside(size, kLarge);
+  std::vector<float> inside(size, 0.f);
+  const double* pixels = &grid.Get(0, 0);
+  for (size_t y = 0; y < grid.GetHeight(); ++y) {
+    const double* row = &pixels[y * grid.GetWidth()];
+    const size_t offset = (y + padding) * width + padding;
+    for (size_t x = 0; x < grid.GetWidth(); ++x) {
+      const float value = static_cast<float>(row[x]);
+      float& out = outside[offset + x];
+      float& in = inside[offset + x];
+      if (value >= 1.f) {
+        out = 0.f;
+        in = kLarge;
+      } else if (value > 0.f) {
+        const float out_dist = std::max(0.f, 0.5f - value);
+        const float in_dist = std::max(0.f, value - 0.5f);
+        out = out_dist * out_dist;
+        in = in_dist * in_dist;
+      }
     }
   }
-  return math::Normalized(filtered);
-}
 
-const Grid DistanceComputer::InitializeDistanceGrid(
-    const Grid& image, const Array2<Vector2d>& gradients) {
-  const size_t h = image.GetHeight();
-  const size_t w = image.GetWidth();
-  Grid distances(w, h);
-  for (size_t y = 0; y < h; ++y) {
-    for (size_t x = 0; x < w; ++x) {
-      const double v = image.Get(x, y);
-      const double dist = v <= 0.0 ? kLargeDistance :
-                          v >= 1.0 ? 0.0 :
-                          ApproximateDistanceToEdge(v, gradients.Get(x, y));
-      distances.Set(x, y, dist);
-    }
-  }
-  return distances;
+  // Compute the distances to the foreground and background. The difference is
+  // the signed distance.
+  DistanceTransform transform(width, height);
+  transform.Transform(&outside[0]);
+  transform.Transform(&inside[0]);
+  double* distances = sdf.GetMutable(0, 0);
+  for (size_t i = 0; i < size; ++i)
+    distances[i] = static_cast<double>(std::sqrt(outside[i]) -
+                                       std::sqrt(inside[i]));
+  return sdf;
 }
 
-double DistanceComputer::ApproximateDistanceToEdge(
-    double value, const Vector2d& gradient) {
-  if (gradient[0] == 0.0 || gradient[1] == 0.0) {
-    // Approximate the gradient linearly using the middle of the range.
-    return 0.5 - value;
-  } else {
-    // Since the gradients are symmetric with respect to both sign and X/Y
-    // transposition, do the work in the first octant (positive gradients, x
-    // gradient >= y gradient) for simplicity.
-    Vector2d g = math::Normalized(Vector2d(math::Abs(gradient[0]),
-                                           math::Abs(gradient[1])));
-    if (g[0] < g[1])
-      std::swap(g[0], g[1]);
-    const float gradient_value = static_cast<float>(0.5 * g[1] / g[0]);
-    double dist;
-    if (value < gradient_value) {
-      // 0 <= value < gradient_value.
-      dist = 0.5 * (g[0] + g[1]) - sqrt(2.0 * g[0] * g[1] * value);
-    } else if (value < 1.0 - gradient_value) {
-      // gradient_value <= value <= 1 - gradient_value.
-      dist = (0.5 - value) * g[0];
-    } else {
-      // 1 - gradient_value < value <= 1.
-      dist = -0.5 * (g[0] + g[1]) + sqrt(2.0 * g[0] * g[1] * (1.0 - value));
-    }
-    return dist;
-  }
-}
+//-----------------------------------------------------------------------------
+//
+// Multi-channel SDF helpers.
+//
+//-----------------------------------------------------------------------------
 
-void DistanceComputer::ComputeDistances(Data* data) {
-  const int height = static_cast<int>(data->image.GetHeight());
-  const int width = static_cast<int>(data->image.GetWidth());
-
-  // Keep processing while distances are being modified.
-  do {
-    data->any_distance_changed = false;
-
-    // Propagate from top down, starting with the second row.
-    for (int y = 1; y < height; ++y) {
-      data->cur_pixel[1] = y;
-
-      // Propagate distances to the right.
-      for (int x = 0; x < width; ++x) {
-        data->cur_pixel[0] = x;
-        double dist = data->GetCurDistance();
-        if (dist > 0.0) {
-          UpdateDistance(data, Vector2i(0, -1), &dist);
-          if (x > 0) {
-            UpdateDistance(data, Vector2i(-1, 0), &dist);
-            UpdateDistance(data, Vector2i(-1, -1), &dist);
-          }
-          if (x < width - 1) {
-            UpdateDistance(data, Vector2i(1, -1), &dist);
-          }
-        }
-      }
+// Channel masks for the colors of outline edges in an MSDF. Each channel of
+// the grid holds the distance to the edges whose color includes it.
+enum EdgeColor {
+  kRed = 1,
+  kGreen = 2,
+  kBlue = 4,
+  kYellow = kRed | kGreen,
+  kMagenta = kRed | kBlue,
+  kCyan = kGreen | kBlue,
+  kWhite = kRed | kGreen | kBlue,
+};
 
-      // Propagate distances to the left (skip the rightmost pixel).
-      for (int x = width - 2; x >= 0; --x) {
-        data->cur_pixel[0] = x;
-        double dist = data->GetCurDistance();
-        if (dist > 0.0) {
-          UpdateDistance(data, Vector2i(1, 0), &dist);
-        }
-      }
-    }
+// The sine of the smallest angle between two segments that makes a corner.
+static const double kCornerSine = 0.14;
+
+// A straight segment of an outline contour.
+struct MsdfSegment {
+  math::Point2d start;
+  math::Point2d end;
+  int color;
+  // Whether the segment is at the start or end of an edge. The distance
+  // beyond such an end is measured to the line through the segment, which
+  // keeps corners sharp.
+  bool starts_edge;
+  bool ends_edge;
+};
 
-    // Propagate from bottom up, starting with the second row from the bottom.
-    for (int y = height - 2; y >= 0; --y) {
-      data->cur_pixel[1] = y;
-
-      // Propagate distances to the left.
-      for (int x = width - 1; x >= 0; --x) {
-        data->cur_pixel[0] = x;
-        double dist = data->GetCurDistance();
-        if (dist > 0.0) {
-          UpdateDistance(data, Vector2i(0, 1), &dist);
-          if (x > 0) {
-            UpdateDistance(data, Vector2i(-1, 1), &dist);
-          }
-          if (x < width - 1) {
-            UpdateDistance(data, Vector2i(1, 0), &dist);
-            UpdateDistance(data, Vector2i(1, 1), &dist);
-          }
-        }
-      }
+// The nearest segment found for a channel of an MSDF texel.
+struct MsdfCandidate {
+  MsdfCandidate()
+      : distance(std::numeric_limits<double>::max()),
+        orthogonality(0.0),
+        signed_distance(0.0) {}
+  double distance;
+  double orthogonality;
+  double signed_distance;
+};
 
-      // Propagate distances to the right (skip the leftmost pixel).
-      for (int x = 1; x < width; ++x) {
-        data->cur_pixel[0] = x;
-        double dist = data->GetCurDistance();
-        if (dist > 0.0) {
-          UpdateDistance(data, Vector2i(-1, 0), &dist);
-        }
-      }
-    }
-  } while (data->any_distance_changed);
+static double Cross(const math::Vector2d& a, const math::Vector2d& b) {
+  return a[0] * b[1] - a[1] * b[0];
+}
 
-  // Don't return negative distances.
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      data->distances.Set(x, y, std::max(0.0, data->distances.Get(x, y)));
+// Appends the segments of a contour to segments, colored so that the two
+// edges meeting at each corner share exactly one channel.
+static void AddContourSegments(const OutlineContour& contour,
+                               std::vector<MsdfSegment>* segments) {
+  // Drop repeated points, which make segments of zero length.
+  std::vector<math::Point2d> points;
+  std::vector<bool> is_smooth;
+  for (size_t i = 0; i < contour.points.size(); ++i) {
+    if (points.empty() || contour.points[i] != points.back()) {
+      points.push_back(contour.points[i]);
+      is_smooth.push_back(i < contour.is_smooth.size() &&
+                          contour.is_smooth[i]);
     }
   }
-}
-
-void DistanceComputer::UpdateDistance(Data* data, const Vector2i& offset,
-                                      double* dist) {
-  const Vector2i test_pixel = data->cur_pixel + offset;
-  const Vector2i& xy_dist = data->GetDistanceToEdge(test_pixel);
-  const Vector2i edge_pixel = test_pixel - xy_dist;
-  const Vector2i new_xy_dist = xy_dist - offset;
-  const double new_dist = ComputeDistanceToEdge(data, edge_pixel,
-                                                Vector2d(new_xy_dist));
-  static const double kEpsilon = 1e-3;
-  if (new_dist < *dist - kEpsilon) {
-    data->SetCurDistance(new_dist);
-    data->SetCurDistanceToEdge(new_xy_dist);
-    *dist = new_dist;
-    data->any_distance_changed = true;
+  while (points.size() > 1U && points.back() == points.front()) {
+    points.pop_back();
+    is_smooth.pop_back();
+  }
+  const size_t count = points.size();
+  if (count < 2U)
+    return;
+
+  // Segment i goes from point i to point i + 1; find the points where two
+  // segments meet at a corner.
+  std::vector<size_t> corners;
+  for (size_t i = 0; i < count; ++i) {
+    if (is_smooth[i])
+      continue;
+    const math::Vector2d in =
+        math::Normalized(points[i] - points[(i + count - 1U) % count]);
+    const math::Vector2d out = math::Normalized(points[(i + 1U) % count] -
+                                                points[i]);
+    if (math::Dot(in, out) <= 0.0 || std::abs(Cross(in, out)) > kCornerSine)
+      corners.push_back(i);
   }
-}
-
-double DistanceComputer::ComputeDistanceToEdge(
-    Data* data, const Vector2i& pixel, const Vector2d& vec_to_edge_pixel) {
-  // Clamp the pixel value to [0,1].
-  const double value = math::Clamp(data->image.Get(pixel[0], pixel[1]),
-                                   0.0, 1.0);
-
-  // If the pixel value is negative or 0, return kLargeDistance so that
-  // processing will continue.
-  if (value == 0.0)
-    return kLargeDistance;
-
-  // Use the length of the vector to the edge pixel to estimate the real
-  // distance to the edge.
-  const double length = math::Length(vec_to_edge_pixel);
-  const double dist =
-      length > 0.0 ?
-      // Estimate based on direction to edge (accurate for large vectors).
-      ApproximateDistanceToEdge(value, vec_to_edge_pixel) :
-      // Estimate based on local gradient only.
-      ApproximateDistanceToEdge(value, data->gradients.Get(pixel[0], pixel[1]));
-
-  return length + dist;
-}
-
-//-----------------------------------------------------------------------------
-//
-// Helper functions.
-//
-//-----------------------------------------------------------------------------
 
-// Pads a grid on all 4 sides, setting all new elements to 0.
-static const Grid PadGrid(const Grid& grid, size_t padding) {
-  const size_t width = grid.GetWidth();
-  const size_t height = grid.GetHeight();
-  Grid padded_grid(width + 2 * padding, height + 2 * padding, 0.0);
-  for (size_t y = 0; y < height ; ++y) {
-    for (size_t x = 0; x < width; ++x) {
-      padded_grid.Set(padding + x, padding + y, grid.Get(x, y));
+  // Assign a color to each segment, starting at the first corner.
+  std::vector<int> colors(count, kWhite);
+  std::vector<bool> starts_edge(count, false);
+  const size_t first = corners.empty() ? 0U : corners[0];
+  if (corners.size() == 1U && count >= 3U) {
+    // A single corner, as in a teardrop, would leave one edge for all
+    // channels, so split the contour into three edges.
+    static const int kTeardropColors[3] = { kMagenta, kWhite, kYellow };
+    for (size_t i = 0; i < count; ++i) {
+      const size_t third = std::min<size_t>(2U, 3U * i / count);
+      colors[(first + i) % count] = kTeardropColors[third];
+      starts_edge[(first + i) % count] =
+          i == 0 || third != std::min<size_t>(2U, 3U * (i - 1U) / count);
+    }
+  } else if (corners.size() >= 2U) {
+    // Cycle through colors that each share one channel with the next. The
+    // last edge must also differ from the first.
+    static const int kColors[3] = { kCyan, kMagenta, kYellow };
+    const size_t edge_count = corners.size();
+    size_t edge = 0;
+    for (size_t i = 0; i < count; ++i) {
+      const size_t index = (first + i) % count;
+      if (edge + 1U < edge_count && index == corners[edge + 1U])
+        ++edge;
+      int color = kColors[edge % 3U];
+      if (edge == edge_count - 1U && edge % 3U == 0U)
+        color = kColors[1];
+      colors[index] = color;
+      starts_edge[index] = index == corners[edge];
     }
   }
-  return padded_grid;
+
+  for (size_t i = 0; i < count; ++i) {
+    MsdfSegment segment;
+    segment.start = points[i];
+    segment.end = points[(i + 1U) % count];
+    segment.color = colors[i];
+    segment.starts_edge = starts_edge[i];
+    segment.ends_edge = starts_edge[(i + 1U) % count];
+    segments->push_back(segment);
+  }
 }
 
-// Returns the inverse of a Grid by subtracting each value from 1.0.
-static const Grid InvertGrid(const Grid& grid) {
-  const size_t w = grid.GetWidth();
-  const size_t h = grid.GetHeight();
-  Grid inverted(w, h);
-  for (size_t y = 0; y < h; ++y) {
-    for (size_t x = 0; x < w; ++x) {
-      inverted.Set(x, y, 1.0 - grid.Get(x, y));
-    }
+// Returns whether point p is inside the outline made of segments according to
+// the nonzero winding rule.
+static bool IsInside(const std::vector<MsdfSegment>& segments,
+                     const math::Point2d& p) {
+  int winding = 0;
+  for (size_t i = 0; i < segments.size(); ++i) {
+    const math::Point2d& a = segments[i].start;
+    const math::Point2d& b = segments[i].end;
+    const double side = Cross(b - a, p - a);
+    if (a[1] <= p[1] && b[1] > p[1] && side > 0.0)
+      ++winding;
+    else if (b[1] <= p[1] && a[1] > p[1] && side < 0.0)
+      --winding;
   }
-  return inverted;
+  return winding != 0;
 }
 
-// Builds and returns a signed distance field grid for an input grid containing
-// antialiased pixel values.
-static const Grid BuildSdfGrid(const Grid& grid) {
-  const size_t height = grid.GetHeight();
-  const size_t width = grid.GetWidth();
-  Grid sdf(width, height);
-  if (height > 0 && width > 0) {
-    // Compute the distances to the background edges (original grid) and the
-    // foreground edges (inverse grid). The difference is the signed distance.
-    DistanceComputer dc;
-    const Grid bg_distances = dc.Compute(grid);
-    const Grid fg_distances = dc.Compute(InvertGrid(grid));
-    for (size_t y = 0; y < height; ++y) {
-      for (size_t x = 0; x < width; ++x) {
-        sdf.Set(x, y, bg_distances.Get(x, y) - fg_distances.Get(x, y));
+// Builds and returns an MSDF grid for an outline. See ComputeMsdfGrid().
+static const Array2<math::Vector3d> BuildMsdfGrid(const GlyphOutline& outline,
+                                                  size_t width, size_t height,
+                                                  size_t padding) {
+  const size_t grid_width = width + 2U * padding;
+  const size_t grid_height = height + 2U * padding;
+  const double kLarge = static_cast<double>(DistanceTransform::kLargeDistance);
+  Array2<math::Vector3d> msdf(grid_width, grid_height,
+                              math::Vector3d(kLarge, kLarge, kLarge));
+
+  std::vector<MsdfSegment> segments;
+  for (size_t i = 0; i < outline.size(); ++i)
+    AddContourSegments(outline[i], &segments);
+
+  // The side of the segments that is filled depends on the orientation of the
+  // outline, which differs between font formats, so use the sign of its area.
+  double area = 0.0;
+  for (size_t i = 0; i < segments.size(); ++i)
+    area += Cross(segments[i].start - math::Point2d::Zero(),
+                  segments[i].end - math::Point2d::Zero());
+  if (area == 0.0)
+    return msdf;
+  const double orientation = area > 0.0 ? 1.0 : -1.0;
+
+  const double offset = 0.5 - static_cast<double>(padding);
+  for (size_t y = 0; y < grid_height; ++y) {
+    for (size_t x = 0; x < grid_width; ++x) {
+      const math::Point2d p(static_cast<double>(x) + offset,
+                            static_cast<double>(y) + offset);
+      MsdfCandidate channels[3];
+      double nearest = kLarge;
+      for (size_t i = 0; i < segments.size(); ++i) {
+        const MsdfSegment& s = segments[i];
+        const math::Vector2d ab = s.end - s.start;
+        const math::Vector2d ap = p - s.start;
+        const double length = math::Length(ab);
+        const double t = math::Dot(ap, ab) / (length * length);
+        const double clamped = math::Clamp(t, 0.0, 1.0);
+        const double distance = math::Length(ap - clamped * ab);
+        // The filled side has a negative distance.
+        const double perpendicular = -orientation * Cross(ab, ap) / length;
+        const double orthogonality =
+            t == clamped || distance == 0.0
+                ? 1.0 : std::abs(perpendicular) / distance;
+        nearest = std::min(nearest, distance);
+
+        const double kEpsilon = 1e-9;
+        for (int c = 0; c < 3; ++c) {
+          MsdfCandidate& channel = channels[c];
+          if (!(s.color & (1 << c)) ||
+              distance > channel.distance + kEpsilon ||
+              (distance > channel.distance - kEpsilon &&
+               orthogonality <= channel.orthogonality))
+            continue;
+          channel.distance = distance;
+          channel.orthogonality = orthogonality;
+          if ((t < 0.0 && s.starts_edge) || (t > 1.0 && s.ends_edge))
+            channel.signed_distance = perpendicular;
+          else
+            channel.signed_distance =
+                perpendicular < 0.0 ? -distance : distance;
+        }
       }
+
+      math::Vector3d& texel = *msdf.GetMutable(x, y);
+      for (int c = 0; c < 3; ++c)
+        texel[c] = channels[c].signed_distance;
+      // Fix texels whose median is on the wrong side of the outline, which
+      // happens where edges of one channel are far from the others.
+      const double distance = IsInside(segments, p) ? -nearest : nearest;
+      if ((GetMsdfMedian(texel) < 0.0) != (distance < 0.0))
+        texel.Set(distance, distance, distance);
     }
   }
-  return sdf;
+  return msdf;
 }
 
 }  // anonymous namespace
@@ -420,7 +421,25 @@ static const Grid BuildSdfGrid(const Grid& grid) {
 //-----------------------------------------------------------------------------
 
 const Grid ComputeSdfGrid(const Grid& image_grid, size_t padding) {
-  return BuildSdfGrid(PadGrid(image_grid, padding));
+  return BuildSdfGrid(image_grid, padding);
+}
+
+const Array2<math::Vector3d> ComputeMsdfGrid(const GlyphOutline& outline,
+                                             size_t width, size_t height,
+                                             size_t padding) {
+  return BuildMsdfGrid(outline, width, height, padding);
+}
+
+uint8 QuantizeSdfValue(double distance, size_t padding) {
+  const double scale =
+      padding ? 1.0 / static_cast<double>(padding) : 1.0;
+  const double value = (math::Clamp(distance * scale, -1.0, 1.0) + 1.0) * 0.5;
+  return static_cast<uint8>(value * 255.0);
+}
+
+double DequantizeSdfValue(uint8 value, size_t padding) {
+  const double scale = padding ? static_cast<double>(padding) : 1.0;
+  return ((static_cast<double>(value) + 0.5) / 127.5 - 1.0) * scale;
 }
 
 }  // namespace text
@@ -23,7 +23,12 @@ limitations under the License.
 // signed distance field (SDF) grids.
 //
 
+#include <algorithm>
+#include <vector>
+
+#include "base/integral_types.h"
 #include "ion/base/array2.h"
+#include "ion/math/vector.h"
 
 namespace ion {
 namespace text {
@@ -39,9 +44,59 @@ namespace text {
 // outside the foreground of the input image and negative inside it.  Output
 // elements have grid-distance as their units, so are bounded in absolute value
 // by sqrt(height^2+width^2) (after padding).
+//
+// The distances are computed with an exact Euclidean distance transform in
+// single precision, in time linear in the number of output elements. This
+// function may be called on multiple threads at once.
 const base::Array2<double> ComputeSdfGrid(
     const base::Array2<double>& image_grid, size_t padding);
 
+// A closed contour of a glyph outline, approximated by a polygon. Curves of the
+// outline are approximated by several points, which are marked as smooth so
+// that they are never treated as corners; only the points at the ends of the
+// outline's segments can be corners. Points are in pixels of the glyph grid,
+// with x increasing to the right and y increasing downward from the top left
+// corner of the grid, so that pixel (x, y) covers [x, x + 1] x [y, y + 1].
+struct OutlineContour {
+  std::vector<math::Point2d> points;
+  std::vector<bool> is_smooth;
+};
+typedef std::vector<OutlineContour> GlyphOutline;
+
+// Creates a multi-channel signed distance field (MSDF) grid for a glyph of
+// width x height pixels from its outline, padded as ComputeSdfGrid() pads, so
+// that the grid has the same size as the SDF grid of the glyph. Each channel
+// holds the signed distance to a subset of the edges between the corners of
+// the outline, chosen so that two edges meeting at a corner share only one
+// channel. The median of the three channels is then the signed distance
+// except near corners, where it stays sharp even when the grid is sampled
+// with bilinear filtering; a single-channel SDF rounds corners unless the grid
+// is large. Distances have the same sign and units as those of
+// ComputeSdfGrid(); the fill is determined by the nonzero winding rule. Texels
+// whose median has the wrong sign are set to the plain signed distance in all
+// channels.
+const base::Array2<math::Vector3d> ComputeMsdfGrid(const GlyphOutline& outline,
+                                                   size_t width, size_t height,
+                                                   size_t padding);
+
+// Returns the median of the channels of a multi-channel signed distance.
+inline double GetMsdfMedian(const math::Vector3d& distances) {
+  const double a = distances[0];
+  const double b = distances[1];
+  const double c = distances[2];
+  return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// Quantizes a signed distance returned by ComputeSdfGrid() for 8-bit storage,
+// e.g., in a font texture. The distance is divided by padding, clamped to
+// [-1,1], and mapped to [0,255], so edges are near 128 and 255 is padding or
+// more pixels outside the image.
+uint8 QuantizeSdfValue(double distance, size_t padding);
+
+// Returns the signed distance in the middle of the range of distances that
+// QuantizeSdfValue() maps to value, so that quantizing it again returns value.
+double DequantizeSdfValue(uint8 value, size_t padding);
+
 }  // namespace text
 }  // namespace ion
 
@@ -0,0 +1,228 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/text/batchbuilder.h"
+
+#include <string>
+
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/indexbuffer.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shape.h"
+#include "ion/math/transformutils.h"
+#include "ion/math/vector.h"
+#include "ion/text/layout.h"
+#include "ion/text/tests/buildertestbase.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace text {
+
+namespace {
+
+// The vertex layout of a BatchBuilder.
+struct BatchVertex {
+  math::Point3f position;
+  math::Point2f texture_coords;
+  math::Vector4f color;
+};
+
+// Returns the BufferObject holding the vertices of a built Node.
+static gfx::BufferObject* GetVertexBuffer(const gfx::NodePtr& node) {
+  const gfx::AttributeArrayPtr& attr_array =
+      node->GetShapes()[0]->GetAttributeArray();
+  return attr_array->GetBufferAttribute(0)
+      .GetValue<gfx::BufferObjectElement>().buffer_object.Get();
+}
+
+// Returns the indexed vertex of a built Node.
+static const BatchVertex& GetVertex(const gfx::NodePtr& node, size_t index) {
+  return GetVertexBuffer(node)->GetData()->GetData<BatchVertex>()[index];
+}
+
+}  // anonymous namespace
+
+class BatchBuilderTest : public testing::BuilderTestBase<BatchBuilder> {
+ protected:
+  const std::string GetShaderIdString() const override {
+    return std::string("  Shader ID: \"Batch Text Shader\"\n");
+  }
+  const std::string GetUniformString() const override { return std::string(); }
+};
+
+TEST_F(BatchBuilderTest, BuildBatch) {
+  BatchBuilder* bb = GetBuilder();
+  EXPECT_EQ(0U, bb->GetLabelCount());
+  EXPECT_TRUE(bb->NeedsRebuild());
+
+  // There is nothing to build without glyphs.
+  EXPECT_FALSE(bb->BuildBatch(gfx::BufferObject::kStreamDraw));
+  EXPECT_EQ(0U, bb->AddLabel(Layout(), math::Matrix4f::Identity(),
+                             math::Vector4f(1.f, 1.f, 1.f, 1.f), 2U));
+  EXPECT_FALSE(bb->BuildBatch(gfx::BufferObject::kStreamDraw));
+  bb->ClearLabels();
+
+  const Layout layout = BuildLayout("bg");
+  const math::Vector4f red(1.f, 0.f, 0.f, 1.f);
+  const math::Vector4f blue(0.f, 0.f, 1.f, 1.f);
+  const math::Matrix4f translation =
+      math::TranslationMatrix(math::Vector3f(100.f, 0.f, 0.f));
+  EXPECT_EQ(0U, bb->AddLabel(layout, math::Matrix4f::Identity(), red, 3U));
+  EXPECT_EQ(1U, bb->AddLabel(layout, translation, blue, 0U));
+  EXPECT_EQ(2U, bb->GetLabelCount());
+  EXPECT_TRUE(bb->BuildBatch(gfx::BufferObject::kStreamDraw));
+  EXPECT_FALSE(bb->NeedsRebuild());
+
+  // Both labels are in a single Shape.
+  gfx::NodePtr node = bb->GetNode();
+  ASSERT_TRUE(node.Get());
+  EXPECT_EQ(1U, node->GetShapes().size());
+  EXPECT_EQ(2U, node->GetUniforms().size());
+  EXPECT_EQ(20U, GetVertexBuffer(node)->GetCount());
+  const gfx::IndexBufferPtr& indices = node->GetShapes()[0]->GetIndexBuffer();
+  EXPECT_EQ(30U, indices->GetCount());
+  EXPECT_EQ(gfx::BufferObject::kUnsignedShort, indices->GetSpec(0).type);
+
+  // The first label reserves 3 glyphs.
+  EXPECT_EQ(0U, bb->GetLabelFirstVertex(0));
+  EXPECT_EQ(12U, bb->GetLabelVertexCount(0));
+  EXPECT_EQ(12U, bb->GetLabelFirstVertex(1));
+  EXPECT_EQ(8U, bb->GetLabelVertexCount(1));
+  EXPECT_EQ(0U, bb->GetLabelFirstVertex(2));
+  EXPECT_EQ(0U, bb->GetLabelVertexCount(2));
+
+  // Check the vertices of the first glyph of each label.
+  for (int i = 0; i < 4; ++i) {
+    const math::Point3f& point = layout.GetGlyph(0).quad.points[i];
+    const BatchVertex& v0 = GetVertex(node, i);
+    EXPECT_EQ(point, v0.position);
+    EXPECT_EQ(red, v0.color);
+    const BatchVertex& v1 = GetVertex(node, 12 + i);
+    EXPECT_EQ(point + math::Vector3f(100.f, 0.f, 0.f), v1.position);
+    EXPECT_EQ(blue, v1.color);
+    EXPECT_EQ(v0.texture_coords, v1.texture_coords);
+  }
+  // The unused glyph of the first label is degenerate.
+  for (int i = 0; i < 4; ++i)
+    EXPECT_EQ(math::Point3f::Zero(), GetVertex(node, 8 + i).position);
+}
+
+TEST_F(BatchBuilderTest, UpdateLabelsInPlace) {
+  BatchBuilder* bb = GetBuilder();
+  const math::Vector4f red(1.f, 0.f, 0.f, 1.f);
+  const math::Vector4f green(0.f, 1.f, 0.f, 1.f);
+  const math::Matrix4f translation =
+      math::TranslationMatrix(math::Vector3f(0.f, 50.f, 0.f));
+
+  // Labels can be changed before building.
+  EXPECT_FALSE(bb->SetLabelColor(0U, red));
+  bb->AddLabel(BuildLayout("bg"), math::Matrix4f::Identity(), red, 3U);
+  bb->AddLabel(BuildLayout("g"), math::Matrix4f::Identity(), red, 0U);
+  EXPECT_TRUE(bb->SetLabelColor(1U, green));
+  EXPECT_TRUE(bb->NeedsRebuild());
+  EXPECT_TRUE(bb->BuildBatch(gfx::BufferObject::kDynamicDraw));
+  gfx::NodePtr node = bb->GetNode();
+  gfx::BufferObject* bo = GetVertexBuffer(node);
+  EXPECT_EQ(green, GetVertex(node, 12).color);
+  EXPECT_TRUE(bo->GetSubData().empty());
+
+  // Changes to a label only upload its vertices.
+  EXPECT_TRUE(bb->SetLabelColor(1U, red));
+  EXPECT_FALSE(bb->NeedsRebuild());
+  ASSERT_EQ(1U, bo->GetSubData().size());
+  EXPECT_EQ(12U * sizeof(BatchVertex), bo->GetSubData()[0].range.GetMinPoint());
+  EXPECT_EQ(4U * sizeof(BatchVertex), bo->GetSubData()[0].range.GetSize());
+  EXPECT_EQ(red, GetVertex(node, 12).color);
+  EXPECT_EQ(red, bo->GetSubData()[0].data->GetData<BatchVertex>()[0].color);
+
+  const math::Point2f texture_coords = GetVertex(node, 12).texture_coords;
+  EXPECT_TRUE(bb->SetLabelTransform(1U, translation));
+  EXPECT_FALSE(bb->NeedsRebuild());
+  EXPECT_EQ(2U, bo->GetSubData().size());
+  EXPECT_EQ(BuildLayout("g").GetGlyph(0).quad.points[0] +
+                math::Vector3f(0.f, 50.f, 0.f),
+            GetVertex(node, 12).position);
+  EXPECT_EQ(texture_coords, GetVertex(node, 12).texture_coords);
+
+  // A Layout with up to the capacity of glyphs is written in place.
+  EXPECT_TRUE(bb->SetLabelLayout(0U, BuildLayout("gbg")));
+  EXPECT_FALSE(bb->NeedsRebuild());
+  EXPECT_EQ(3U, bo->GetSubData().size());
+  EXPECT_EQ(0U, bo->GetSubData()[2].range.GetMinPoint());
+  EXPECT_EQ(12U * sizeof(BatchVertex), bo->GetSubData()[2].range.GetSize());
+  EXPECT_EQ(texture_coords, GetVertex(node, 0).texture_coords);
+  EXPECT_EQ(texture_coords, GetVertex(node, 8).texture_coords);
+
+  // The node is unchanged by in-place updates.
+  EXPECT_EQ(node.Get(), bb->GetNode().Get());
+  EXPECT_EQ(bo, GetVertexBuffer(bb->GetNode()));
+
+  // A longer Layout requires a rebuild.
+  EXPECT_TRUE(bb->SetLabelLayout(0U, BuildLayout("gbgb")));
+  EXPECT_TRUE(bb->NeedsRebuild());
+  EXPECT_TRUE(bb->SetLabelColor(1U, green));
+  EXPECT_EQ(3U, bo->GetSubData().size());
+  EXPECT_TRUE(bb->BuildBatch(gfx::BufferObject::kDynamicDraw));
+  EXPECT_FALSE(bb->NeedsRebuild());
+  EXPECT_EQ(16U, bb->GetLabelVertexCount(0));
+  EXPECT_EQ(green, GetVertex(bb->GetNode(), 16).color);
+
+  // So does adding a label.
+  bb->AddLabel(BuildLayout("b"), math::Matrix4f::Identity(), red, 0U);
+  EXPECT_TRUE(bb->NeedsRebuild());
+}
+
+TEST_F(BatchBuilderTest, StaticDrawRequiresRebuild) {
+  BatchBuilder* bb = GetBuilder();
+  const math::Vector4f red(1.f, 0.f, 0.f, 1.f);
+  bb->AddLabel(BuildLayout("bg"), math::Matrix4f::Identity(), red, 0U);
+  EXPECT_TRUE(bb->BuildBatch(gfx::BufferObject::kStaticDraw));
+  EXPECT_FALSE(bb->NeedsRebuild());
+  EXPECT_TRUE(bb->SetLabelColor(0U, red));
+  EXPECT_TRUE(bb->NeedsRebuild());
+  EXPECT_TRUE(GetVertexBuffer(bb->GetNode())->GetSubData().empty());
+}
+
+TEST_F(BatchBuilderTest, ManyLabels) {
+  // Enough glyphs for more vertices than an unsigned short index can address.
+  BatchBuilder* bb = GetBuilder();
+  const Layout layout = BuildLayout("bg");
+  static const size_t kLabelCount = 9000U;
+  for (size_t i = 0; i < kLabelCount; ++i) {
+    bb->AddLabel(
+        layout,
+        math::TranslationMatrix(math::Vector3f(0.f, static_cast<float>(i), 0.f)),
+        math::Vector4f(1.f, 1.f, 1.f, 1.f), 0U);
+  }
+  EXPECT_TRUE(bb->BuildBatch(gfx::BufferObject::kStreamDraw));
+  gfx::NodePtr node = bb->GetNode();
+  EXPECT_EQ(1U, node->GetShapes().size());
+  EXPECT_EQ(8U * kLabelCount, GetVertexBuffer(node)->GetCount());
+  const gfx::IndexBufferPtr& indices = node->GetShapes()[0]->GetIndexBuffer();
+  EXPECT_EQ(gfx::BufferObject::kUnsignedInt, indices->GetSpec(0).type);
+  EXPECT_EQ(12U * kLabelCount, indices->GetCount());
+  EXPECT_EQ(static_cast<uint32>(8U * kLabelCount - 1U),
+            indices->GetData()->GetData<uint32>()[12U * kLabelCount - 1U]);
+}
+
+TEST_F(BatchBuilderTest, DynamicFontSubImages) {
+  EXPECT_TRUE(TestDynamicFontSubImages());
+}
+
+}  // namespace text
+}  // namespace ion
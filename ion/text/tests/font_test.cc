@@ -17,10 +17,14 @@ limitations under the License.
 
 #include "ion/text/font.h"
 
+#include <atomic>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
 #include "ion/base/invalid.h"
 #include "ion/base/logchecker.h"
+#include "ion/base/taskscheduler.h"
+#include "ion/text/sdfutils.h"
 #include "ion/text/tests/mockfont.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -72,6 +76,26 @@ class TestFont : public Font {
 };
 typedef base::ReferentPtr<TestFont>::Type TestFontPtr;
 
+// This derived Font class loads glyphs on demand, counting the loads.
+class LoadingFont : public TestFont {
+ public:
+  LoadingFont() : TestFont("loading", 16U, 2U), load_count_(0) {}
+
+  int GetLoadCount() const { return load_count_; }
+
+ protected:
+  bool LoadGlyphGrid(GlyphIndex glyph_index,
+                     GlyphGrid* glyph_grid) const override {
+    ++load_count_;
+    glyph_grid->pixels =
+        base::Array2<double>(static_cast<size_t>(glyph_index), 4U, 0.5);
+    return true;
+  }
+
+ private:
+  mutable std::atomic<int> load_count_;
+};
+
 }  // anonymous namespace
 
 TEST(FontTest, Font) {
@@ -141,5 +165,131 @@ TEST(FontTest, AddGlyphsForAsciiCharacterRange) {
   EXPECT_TRUE(glyphs.count(font->GetDefaultGlyphForChar('g')));
 }
 
+TEST(FontTest, QuantizeGrids) {
+  TestFontPtr font(new TestFont("quantized", 16U, 3U));
+  TestFontPtr reference(new TestFont("reference", 16U, 3U));
+  EXPECT_FALSE(font->GetQuantizeGrids());
+  font->SetQuantizeGrids(true);
+  EXPECT_TRUE(font->GetQuantizeGrids());
+
+  // Coverage values are quantized when the glyph is added.
+  base::Array2<double> pixels(9U, 7U, 0.0);
+  for (size_t y = 1; y < 6; ++y)
+    for (size_t x = 2; x < 7; ++x)
+      pixels.Set(x, y, static_cast<double>(x * 40 + y) / 255.0);
+  font->AddGlyphGrid('a', pixels);
+  reference->AddGlyphGrid('a', pixels);
+  const Font::GlyphGrid& grid = font->GetGlyphGridForChar('a');
+  EXPECT_TRUE(grid.is_quantized);
+  EXPECT_FALSE(grid.is_sdf);
+  EXPECT_EQ(0U, grid.pixels.GetSize());
+  EXPECT_EQ(9U, grid.GetWidth());
+  EXPECT_EQ(7U, grid.GetHeight());
+  EXPECT_FALSE(grid.IsZeroSize());
+  EXPECT_EQ(0U, grid.quantized_pixels.Get(0, 0));
+  EXPECT_EQ(82U, grid.quantized_pixels.Get(2, 2));
+  EXPECT_EQ(245U, grid.quantized_pixels.Get(6, 5));
+
+  // SDF grids are quantized the way FontImage quantizes them, from the same
+  // distances as for unquantized grids.
+  GlyphSet glyphs(base::AllocatorPtr(NULL));
+  glyphs.insert(font->GetDefaultGlyphForChar('a'));
+  font->CacheSdfGrids(glyphs);
+  reference->CacheSdfGrids(glyphs);
+  const Font::GlyphGrid& sdf = font->GetGlyphGridForChar('a');
+  const Font::GlyphGrid& expected = reference->GetGlyphGridForChar('a');
+  EXPECT_TRUE(sdf.is_sdf);
+  EXPECT_TRUE(sdf.is_quantized);
+  EXPECT_FALSE(expected.is_quantized);
+  ASSERT_EQ(expected.GetWidth(), sdf.GetWidth());
+  ASSERT_EQ(expected.GetHeight(), sdf.GetHeight());
+  EXPECT_EQ(15U, sdf.GetWidth());
+  for (size_t y = 0; y < sdf.GetHeight(); ++y) {
+    for (size_t x = 0; x < sdf.GetWidth(); ++x)
+      EXPECT_EQ(QuantizeSdfValue(expected.pixels.Get(x, y), 3U),
+                sdf.quantized_pixels.Get(x, y));
+  }
+
+  // Grids added with AddSdfGrid() are quantized too.
+  EXPECT_TRUE(font->AddSdfGrid(100U, expected.pixels));
+  EXPECT_TRUE(font->GetGlyphGrid(100U).is_quantized);
+  EXPECT_EQ(sdf.quantized_pixels.Get(7, 3),
+            font->GetGlyphGrid(100U).quantized_pixels.Get(7, 3));
+}
+
+TEST(FontTest, ConcurrentGlyphLoading) {
+  base::ReferentPtr<LoadingFont>::Type font(new LoadingFont);
+
+  // Each glyph must be loaded once, however many threads request it.
+  static const GlyphIndex kGlyphCount = 40U;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(std::thread([font]() {
+      for (GlyphIndex g = 1; g <= kGlyphCount; ++g) {
+        const Font::GlyphGrid& grid = font->GetGlyphGrid(g);
+        EXPECT_FALSE(base::IsInvalidReference(grid));
+        EXPECT_EQ(static_cast<size_t>(g), grid.pixels.GetWidth());
+      }
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+  EXPECT_EQ(static_cast<int>(kGlyphCount), font->GetLoadCount());
+
+  // Glyphs are looked up, filtered and cached across all shards.
+  GlyphSet glyphs(base::AllocatorPtr(NULL));
+  for (GlyphIndex g = 0; g <= kGlyphCount; ++g)
+    glyphs.insert(g);
+  font->FilterGlyphs(&glyphs);
+  EXPECT_EQ(static_cast<size_t>(kGlyphCount), glyphs.size());
+  EXPECT_EQ(0U, glyphs.count(0U));
+  base::TaskScheduler scheduler("sdf", 2U);
+  font->SetSdfTaskScheduler(&scheduler);
+  font->CacheSdfGrids(glyphs);
+  for (GlyphIndex g = 1; g <= kGlyphCount; ++g)
+    EXPECT_TRUE(font->GetGlyphGrid(g).is_sdf);
+  EXPECT_EQ(static_cast<int>(kGlyphCount), font->GetLoadCount());
+}
+
+TEST(FontTest, CacheSdfGridsInParallel) {
+  TestFontPtr font(new TestFont("parallel", 16U, 2U));
+  base::TaskScheduler scheduler("sdf", 3U);
+  EXPECT_TRUE(font->GetSdfTaskScheduler() == NULL);
+  font->SetSdfTaskScheduler(&scheduler);
+  EXPECT_EQ(&scheduler, font->GetSdfTaskScheduler());
+
+  // Add glyphs with a filled square of a different size in each.
+  GlyphSet glyphs(base::AllocatorPtr(NULL));
+  std::vector<base::Array2<double> > pixels;
+  for (CharIndex c = 0; c < 10; ++c) {
+    base::Array2<double> grid(16U, 10U, 0.0);
+    for (size_t y = 2; y < 4 + c / 2; ++y)
+      for (size_t x = 3; x < 5 + c; ++x)
+        grid.Set(x, y, 1.0);
+    font->AddGlyphGrid(c, grid);
+    pixels.push_back(grid);
+    glyphs.insert(font->GetDefaultGlyphForChar(c));
+  }
+  font->CacheSdfGrids(glyphs);
+
+  // The cached grids must match the ones computed on this thread.
+  for (CharIndex c = 0; c < 10; ++c) {
+    const Font::GlyphGrid& grid = font->GetGlyphGridForChar(c);
+    ASSERT_FALSE(base::IsInvalidReference(grid));
+    EXPECT_TRUE(grid.is_sdf);
+    const base::Array2<double> expected = ComputeSdfGrid(pixels[c], 2U);
+    ASSERT_EQ(expected.GetWidth(), grid.pixels.GetWidth());
+    ASSERT_EQ(expected.GetHeight(), grid.pixels.GetHeight());
+    for (size_t y = 0; y < expected.GetHeight(); ++y)
+      for (size_t x = 0; x < expected.GetWidth(); ++x)
+        EXPECT_EQ(expected.Get(x, y), grid.pixels.Get(x, y));
+  }
+
+  // Grids that are already cached are left alone.
+  font->CacheSdfGrids(glyphs);
+  font->SetSdfTaskScheduler(NULL);
+  EXPECT_TRUE(font->GetSdfTaskScheduler() == NULL);
+}
+
 }  // namespace text
 }  // namespace ion
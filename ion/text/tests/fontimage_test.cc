@@ -17,11 +17,13 @@ limitations under the License.
 
 #include "ion/text/fontimage.h"
 
+#include <cstring>
 #include <vector>
 
 #include "ion/base/invalid.h"
 #include "ion/math/range.h"
 #include "ion/math/rangeutils.h"
+#include "ion/text/sdfutils.h"
 #include "ion/text/tests/mockfont.h"
 #include "ion/text/tests/testfont.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
@@ -153,6 +155,79 @@ TEST(FontImageTest, StaticFontImageFits) {
       base::InvalidReference<FontImage::ImageData>(), glyph_A, &rect));
 }
 
+TEST(FontImageTest, StaticFontImageQuantizedGrids) {
+  // A font that quantizes its grids must produce the same image.
+  FontPtr font(new testing::MockFont(32U, 8U));
+  FontPtr quantized_font(new testing::MockFont(32U, 8U));
+  quantized_font->SetQuantizeGrids(true);
+  GlyphSet glyph_set(base::AllocatorPtr(NULL));
+  font->AddGlyphsForAsciiCharacterRange(1, 127, &glyph_set);
+  font->FilterGlyphs(&glyph_set);
+  StaticFontImagePtr sfi(new StaticFontImage(font, 512U, glyph_set));
+  StaticFontImagePtr quantized_sfi(
+      new StaticFontImage(quantized_font, 512U, glyph_set));
+  EXPECT_TRUE(quantized_font->GetGlyphGrid(*glyph_set.begin()).is_quantized);
+
+  const gfx::ImagePtr& image = sfi->GetImageData().texture->GetImage(0U);
+  const gfx::ImagePtr& quantized_image =
+      quantized_sfi->GetImageData().texture->GetImage(0U);
+  ASSERT_TRUE(image.Get());
+  ASSERT_TRUE(quantized_image.Get());
+  ASSERT_EQ(image->GetWidth(), quantized_image->GetWidth());
+  ASSERT_EQ(image->GetHeight(), quantized_image->GetHeight());
+  EXPECT_EQ(0, memcmp(image->GetData()->GetData(),
+                      quantized_image->GetData()->GetData(),
+                      image->GetDataSize()));
+}
+
+TEST(FontImageTest, StaticFontImageMultiChannelSdf) {
+  // A multi-channel SDF font has an RGB image. Glyphs without outlines store
+  // their single-channel SDF values in each channel.
+  FontPtr font(new testing::MockFont(32U, 8U));
+  FontPtr msdf_font(new testing::MockFont(32U, 8U));
+  msdf_font->SetMultiChannelSdf(true);
+  GlyphSet glyph_set(base::AllocatorPtr(NULL));
+  font->AddGlyphsForAsciiCharacterRange(1, 127, &glyph_set);
+  font->FilterGlyphs(&glyph_set);
+  StaticFontImagePtr sfi(new StaticFontImage(font, 512U, glyph_set));
+  StaticFontImagePtr msdf_sfi(new StaticFontImage(msdf_font, 512U, glyph_set));
+
+  const gfx::ImagePtr& image = sfi->GetImageData().texture->GetImage(0U);
+  const gfx::ImagePtr& msdf_image =
+      msdf_sfi->GetImageData().texture->GetImage(0U);
+  ASSERT_TRUE(image.Get());
+  ASSERT_TRUE(msdf_image.Get());
+  EXPECT_EQ(gfx::Image::kLuminance, image->GetFormat());
+  EXPECT_EQ(gfx::Image::kRgb8, msdf_image->GetFormat());
+  ASSERT_EQ(image->GetWidth(), msdf_image->GetWidth());
+  ASSERT_EQ(image->GetHeight(), msdf_image->GetHeight());
+  const uint8* values = image->GetData()->GetData<uint8>();
+  const uint8* msdf_values = msdf_image->GetData()->GetData<uint8>();
+  size_t mismatches = 0;
+  for (size_t i = 0; i < image->GetWidth() * image->GetHeight(); ++i) {
+    for (size_t c = 0; c < 3U; ++c) {
+      if (msdf_values[3U * i + c] != values[i])
+        ++mismatches;
+    }
+  }
+  EXPECT_EQ(0U, mismatches);
+
+  // Glyphs added to a dynamic image are uploaded as RGB sub-images.
+  DynamicFontImagePtr dfi(new DynamicFontImage(msdf_font, 256U));
+  glyph_set.clear();
+  glyph_set.insert(msdf_font->GetDefaultGlyphForChar('.'));
+  EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_set)));
+  glyph_set.clear();
+  glyph_set.insert(msdf_font->GetDefaultGlyphForChar('A'));
+  glyph_set.insert(msdf_font->GetDefaultGlyphForChar('b'));
+  const FontImage::ImageData& data = dfi->FindImageData(glyph_set);
+  ASSERT_FALSE(base::IsInvalidReference(data));
+  EXPECT_EQ(gfx::Image::kRgb8, data.texture->GetImage(0U)->GetFormat());
+  ASSERT_EQ(1U, data.texture->GetSubImages().size());
+  EXPECT_EQ(gfx::Image::kRgb8,
+            data.texture->GetSubImages()[0].image->GetFormat());
+}
+
 TEST(FontImageTest, StaticFontImageFitsWithDoubling) {
   // This test requires the StaticFontImage size to be doubled in both
   // dimensions to make the glyphs fit.
@@ -442,7 +517,8 @@ TEST(FontImageTest, DynamicFontImageAdding) {
     EXPECT_NEAR(0.322f, dfi->GetImageDataUsedAreaFraction(1), 1e-3f);
   }
 
-  // Adding just a few glyphs should add more sub-images, one per glyph.
+  // Adding just a few glyphs should add another sub-image. The glyphs are
+  // packed next to each other, so they share a single sub-image.
   glyph_set.clear();
   AddCharacterRange('Q', 'R', font, &glyph_set);
   {
@@ -451,8 +527,8 @@ TEST(FontImageTest, DynamicFontImageAdding) {
     EXPECT_EQ(2U, dfi->GetImageDataCount());
     EXPECT_EQ(4U, dfi->GetImageData(0).glyph_set.size());
     EXPECT_EQ(4U, dfi->GetImageData(1).glyph_set.size());
-    // New sub-images were added for the two glyphs.
-    EXPECT_EQ(3U, data.texture->GetSubImages().size());
+    // A single new sub-image was added for the two glyphs.
+    EXPECT_EQ(2U, data.texture->GetSubImages().size());
   }
 }
 
@@ -553,17 +629,213 @@ TEST(FontImageTest, DynamicFontImageDeferredUpdates) {
     EXPECT_EQ(1U, data.texture->GetSubImages().size());
   }
 
-  // Adding just a few glyphs should add more sub-images, one per glyph.
+  // Adding just a few glyphs should add another sub-image, shared by the
+  // glyphs since they are packed next to each other.
   glyph_set.clear();
   AddCharacterRange('Q', 'R', font, &glyph_set);
   {
     const FontImage::ImageData& data = dfi->FindImageData(glyph_set);
     EXPECT_FALSE(base::IsInvalidReference(data));
-    // New sub-images were added for the two glyphs.
     EXPECT_EQ(1U, data.texture->GetSubImages().size());
     dfi->ProcessDeferredUpdates();
-    EXPECT_EQ(3U, data.texture->GetSubImages().size());
+    EXPECT_EQ(2U, data.texture->GetSubImages().size());
+  }
+}
+
+
+// Returns the number of glyphs in |glyph_set| whose pixels in the sub-images
+// of |data| all match their quantized SdfGrids in |font|. Each glyph must lie
+// within a single sub-image.
+static size_t CountGlyphsInSubImages(const FontImage::ImageData& data,
+                                     const FontPtr& font,
+                                     const GlyphSet& glyph_set,
+                                     uint32 image_size) {
+  const auto& sub_images = data.texture->GetSubImages();
+  size_t count = 0;
+  for (auto git = glyph_set.begin(); git != glyph_set.end(); ++git) {
+    math::Range2f rect;
+    if (!FontImage::GetTextureCoords(data, *git, &rect))
+      continue;
+    const Font::GlyphGrid& grid = font->GetGlyphGrid(*git);
+    const float size = static_cast<float>(image_size);
+    const uint32 x0 = static_cast<uint32>(rect.GetMinPoint()[0] * size);
+    const uint32 y0 = static_cast<uint32>(rect.GetMinPoint()[1] * size);
+    const uint32 x1 = static_cast<uint32>(rect.GetMaxPoint()[0] * size);
+    const uint32 y1 = static_cast<uint32>(rect.GetMaxPoint()[1] * size);
+    for (size_t i = 0; i < sub_images.size(); ++i) {
+      const gfx::Texture::SubImage& sub_image = sub_images[i];
+      const uint32 width = sub_image.image->GetWidth();
+      if (x0 < sub_image.offset[0] || y0 < sub_image.offset[1] ||
+          x1 > sub_image.offset[0] + width ||
+          y1 > sub_image.offset[1] + sub_image.image->GetHeight())
+        continue;
+      const uint8* pixels = sub_image.image->GetData()->GetData<uint8>();
+      bool matches = true;
+      for (uint32 y = y0; y < y1; ++y) {
+        for (uint32 x = x0; x < x1; ++x) {
+          const uint32 index = (y - sub_image.offset[1]) * width +
+                               (x - sub_image.offset[0]);
+          const double distance = grid.pixels.Get(x - x0, y - y0);
+          matches = matches && pixels[index] ==
+                                   QuantizeSdfValue(distance,
+                                                    font->GetSdfPadding());
+        }
+      }
+      if (matches)
+        ++count;
+      break;
+    }
+  }
+  return count;
+}
+
+TEST(FontImageTest, DynamicFontImageCoalescedSubImages) {
+  static const size_t kFontSize = 32U;
+  static const size_t kSdfPadding = 4U;
+  static const uint32 kImageSize = 256U;
+  FontPtr font(new testing::MockFont(kFontSize, kSdfPadding));
+
+  // Create the ImageData with a single glyph.
+  DynamicFontImagePtr dfi(new DynamicFontImage(font, kImageSize));
+  GlyphSet glyph_set(base::AllocatorPtr(NULL));
+  glyph_set.insert(font->GetDefaultGlyphForChar('.'));
+  EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_set)));
+
+  // Adding several glyphs at once packs them next to each other, so they
+  // should be uploaded in fewer sub-images than glyphs.
+  glyph_set.clear();
+  glyph_set.insert(font->GetDefaultGlyphForChar('A'));
+  glyph_set.insert(font->GetDefaultGlyphForChar('b'));
+  glyph_set.insert(font->GetDefaultGlyphForChar('g'));
+  {
+    const FontImage::ImageData& data = dfi->FindImageData(glyph_set);
+    EXPECT_FALSE(base::IsInvalidReference(data));
+    EXPECT_EQ(1U, dfi->GetImageDataCount());
+    EXPECT_EQ(1U, data.texture->GetSubImages().size());
+    EXPECT_EQ(3U, CountGlyphsInSubImages(data, font, glyph_set, kImageSize));
+  }
+
+  // Deferred updates from separate calls are coalesced when they are
+  // processed.
+  dfi = new DynamicFontImage(font, kImageSize);
+  dfi->EnableDeferredUpdates(true);
+  glyph_set.clear();
+  glyph_set.insert(font->GetDefaultGlyphForChar('.'));
+  EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_set)));
+  GlyphSet all_glyphs(base::AllocatorPtr(NULL));
+  const CharIndex chars[] = { 'A', 'b', 'g' };
+  for (size_t i = 0; i < arraysize(chars); ++i) {
+    glyph_set.clear();
+    glyph_set.insert(font->GetDefaultGlyphForChar(chars[i]));
+    all_glyphs.insert(font->GetDefaultGlyphForChar(chars[i]));
+    EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_set)));
   }
+  {
+    const FontImage::ImageData& data = dfi->GetImageData(0);
+    EXPECT_TRUE(data.texture->GetSubImages().empty());
+    dfi->ProcessDeferredUpdates();
+    EXPECT_EQ(1U, data.texture->GetSubImages().size());
+    EXPECT_EQ(3U,
+              CountGlyphsInSubImages(data, font, all_glyphs, kImageSize));
+  }
+}
+
+
+TEST(FontImageTest, DynamicFontImageEviction) {
+  static const size_t kFontSize = 32U;
+  static const size_t kSdfPadding = 4U;
+  static const size_t kImageSize = 128U;
+  FontPtr font(new testing::MockFont(kFontSize, kSdfPadding));
+  const GlyphIndex glyph_A = font->GetDefaultGlyphForChar('A');
+  const GlyphIndex glyph_b = font->GetDefaultGlyphForChar('b');
+  const GlyphIndex glyph_hash = font->GetDefaultGlyphForChar('#');
+
+  // The last GlyphSet does not fit in the same image as the first two.
+  std::vector<GlyphSet> glyph_sets(3U, GlyphSet(base::AllocatorPtr(NULL)));
+  glyph_sets[0].insert(glyph_A);
+  glyph_sets[1].insert(glyph_b);
+  glyph_sets[2].insert(glyph_hash);
+
+  // Without a budget, a second ImageData is added.
+  {
+    DynamicFontImagePtr dfi(new DynamicFontImage(font, kImageSize));
+    EXPECT_EQ(0U, dfi->GetMaxAtlasMemory());
+    EXPECT_EQ(0U, dfi->GetUseSerial());
+    for (size_t i = 0; i < glyph_sets.size(); ++i)
+      EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_sets[i])));
+    EXPECT_EQ(3U, dfi->GetUseSerial());
+    EXPECT_EQ(2U, dfi->GetImageDataCount());
+    EXPECT_EQ(2U * kImageSize * kImageSize, dfi->GetAtlasMemory());
+  }
+
+  // With a budget of one image, the least recently used glyph is evicted
+  // instead.
+  DynamicFontImagePtr dfi(new DynamicFontImage(font, kImageSize));
+  dfi->SetMaxAtlasMemory(kImageSize * kImageSize);
+  EXPECT_EQ(kImageSize * kImageSize, dfi->GetMaxAtlasMemory());
+  for (size_t i = 0; i < 2U; ++i)
+    EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_sets[i])));
+  const gfx::TexturePtr old_texture = dfi->GetImageData(0).texture;
+  {
+    const FontImage::ImageData& data = dfi->FindImageData(glyph_sets[2]);
+    EXPECT_FALSE(base::IsInvalidReference(data));
+    EXPECT_EQ(1U, dfi->GetImageDataCount());
+    EXPECT_EQ(kImageSize * kImageSize, dfi->GetAtlasMemory());
+    EXPECT_FALSE(FontImage::HasGlyph(data, glyph_A));
+    EXPECT_TRUE(FontImage::HasGlyph(data, glyph_b));
+    EXPECT_TRUE(FontImage::HasGlyph(data, glyph_hash));
+    EXPECT_EQ(2U, data.texture_rectangle_map.size());
+
+    // The glyphs were repacked into a new Texture. The old one is unchanged,
+    // so shapes built with it still render correctly.
+    EXPECT_NE(old_texture.Get(), data.texture.Get());
+    EXPECT_TRUE(data.texture->GetSubImages().empty());
+    EXPECT_EQ(1U, old_texture->GetSubImages().size());
+    EXPECT_EQ(old_texture->GetLabel(), data.texture->GetLabel());
+  }
+
+  // Evict the glyphs that are not used after the serial.
+  const uint64 serial = dfi->GetUseSerial();
+  EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_sets[1])));
+  EXPECT_EQ(1U, dfi->EvictUnusedGlyphs(serial));
+  {
+    const FontImage::ImageData& data = dfi->GetImageData(0);
+    EXPECT_EQ(1U, dfi->GetImageDataCount());
+    EXPECT_EQ(1U, data.glyph_set.size());
+    EXPECT_TRUE(FontImage::HasGlyph(data, glyph_b));
+    EXPECT_EQ(1U, data.texture_rectangle_map.size());
+  }
+  EXPECT_EQ(0U, dfi->EvictUnusedGlyphs(serial));
+
+  // Evicting the remaining glyph removes the ImageData.
+  EXPECT_EQ(1U, dfi->EvictUnusedGlyphs(dfi->GetUseSerial()));
+  EXPECT_EQ(0U, dfi->GetImageDataCount());
+  EXPECT_EQ(0U, dfi->GetAtlasMemory());
+}
+
+TEST(FontImageTest, DynamicFontImageEvictionDiscardsDeferredUpdates) {
+  static const size_t kFontSize = 32U;
+  static const size_t kSdfPadding = 4U;
+  static const size_t kImageSize = 128U;
+  FontPtr font(new testing::MockFont(kFontSize, kSdfPadding));
+  DynamicFontImagePtr dfi(new DynamicFontImage(font, kImageSize));
+  dfi->EnableDeferredUpdates(true);
+
+  GlyphSet glyph_set(base::AllocatorPtr(NULL));
+  glyph_set.insert(font->GetDefaultGlyphForChar('A'));
+  EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_set)));
+  const uint64 serial = dfi->GetUseSerial();
+  glyph_set.clear();
+  glyph_set.insert(font->GetDefaultGlyphForChar('b'));
+  EXPECT_FALSE(base::IsInvalidReference(dfi->FindImageData(glyph_set)));
+  const gfx::TexturePtr old_texture = dfi->GetImageData(0).texture;
+
+  // The update that adds 'b' is no longer needed after repacking.
+  EXPECT_EQ(1U, dfi->EvictUnusedGlyphs(serial));
+  dfi->ProcessDeferredUpdates();
+  EXPECT_TRUE(old_texture->GetSubImages().empty());
+  EXPECT_TRUE(dfi->GetImageData(0).texture->GetSubImages().empty());
+  EXPECT_TRUE(FontImage::HasAllGlyphs(dfi->GetImageData(0), glyph_set));
 }
 
 }  // namespace text
@@ -21,6 +21,7 @@ limitations under the License.
 #include "ion/math/range.h"
 #include "ion/math/rangeutils.h"
 #include "ion/math/vectorutils.h"
+#include "ion/port/fileutils.h"
 #include "ion/text/fonts/roboto_regular.h"
 #include "ion/text/tests/mockfont.h"
 #include "ion/text/tests/mockfontimage.h"
@@ -110,6 +111,38 @@ TEST(FontManagerTest, AddFontFromZipasset) {
       "ERROR", "Unable to read data for font \"roboto_bar\"."));
 }
 
+TEST(FontManagerTest, AddFontFromFile) {
+  base::LogChecker logchecker;
+  const std::string path = port::GetTemporaryFilename();
+  const std::string& font_data = testing::GetTestFontData();
+  FILE* f = port::OpenFile(path, "wb");
+  ASSERT_TRUE(f != NULL);
+  fwrite(&font_data[0], 1, font_data.size(), f);
+  fclose(f);
+
+  {
+    FontManagerPtr fm(new FontManager);
+    FontPtr font = fm->AddFontFromFile("Test", path, 32U, 4U);
+    EXPECT_FALSE(font.Get() == NULL);
+    EXPECT_EQ(font, fm->AddFontFromFile("Test", path, 32U, 4U));
+    EXPECT_EQ(font, fm->FindFont("Test", 32U, 4U));
+
+    // A font of another size uses the same mapping.
+    FontPtr font2 = fm->AddFontFromFile("Test", path, 64U, 4U);
+    ASSERT_FALSE(font2.Get() == NULL);
+    EXPECT_NE(font, font2);
+    EXPECT_LT(font->GetFontMetrics().line_advance_height,
+              font2->GetFontMetrics().line_advance_height);
+    EXPECT_FALSE(logchecker.HasAnyMessages());
+
+    // A missing file results in an error message.
+    EXPECT_TRUE(fm->AddFontFromFile("Missing", path + "_missing", 32U, 4U)
+                    .Get() == NULL);
+    EXPECT_TRUE(logchecker.HasMessage("ERROR", "Unable to map file"));
+  }
+  port::RemoveFile(path);
+}
+
 TEST(FontManagerTest, BuildFontKey) {
   EXPECT_EQ("TestFont/32/4", FontManager::BuildFontKey("TestFont", 32U, 4U));
   EXPECT_EQ("Some Name With Spaces/64/0",
@@ -151,5 +184,102 @@ TEST(FontManagerTest, CacheFontImage) {
   EXPECT_EQ(font_image, f);
 }
 
+TEST(FontManagerTest, GetCachedLayout) {
+  base::LogChecker logchecker;
+  FontManagerPtr fm(new FontManager);
+  FontPtr font = testing::BuildTestFreeTypeFont("Test", 32U, 4U);
+  EXPECT_EQ(FontManager::kDefaultLayoutCacheCapacity,
+            fm->GetLayoutCacheCapacity());
+
+  // A NULL font has no Layout.
+  LayoutOptions options;
+  EXPECT_FALSE(fm->GetCachedLayout(FontPtr(), "abc", options));
+  EXPECT_EQ(0U, fm->GetLayoutCacheStats().misses);
+
+  // The first request builds the Layout, later ones share it.
+  CachedLayoutPtr layout = fm->GetCachedLayout(font, "abc", options);
+  ASSERT_TRUE(layout);
+  EXPECT_EQ(3U, layout->GetGlyphCount());
+  const Layout expected = font->BuildLayout("abc", options);
+  for (size_t i = 0; i < 3U; ++i) {
+    EXPECT_EQ(expected.GetGlyph(i).glyph_index,
+              layout->GetGlyph(i).glyph_index);
+  }
+  EXPECT_EQ(layout, fm->GetCachedLayout(font, "abc", options));
+  EXPECT_EQ(layout, fm->GetCachedLayout(font, "abc", options));
+  FontManager::LayoutCacheStats stats = fm->GetLayoutCacheStats();
+  EXPECT_EQ(2U, stats.hits);
+  EXPECT_EQ(1U, stats.misses);
+  EXPECT_EQ(0U, stats.evictions);
+  EXPECT_EQ(1U, stats.size);
+
+  // Any difference in the font, text or options is a different Layout.
+  FontPtr font2 = testing::BuildTestFreeTypeFont("Test", 16U, 4U);
+  EXPECT_NE(layout, fm->GetCachedLayout(font2, "abc", options));
+  EXPECT_NE(layout, fm->GetCachedLayout(font, "abd", options));
+  LayoutOptions options2;
+  options2.target_point.Set(0.0f, 1.0f);
+  EXPECT_NE(layout, fm->GetCachedLayout(font, "abc", options2));
+  options2 = LayoutOptions();
+  options2.horizontal_alignment = kAlignRight;
+  EXPECT_NE(layout, fm->GetCachedLayout(font, "abc", options2));
+  options2 = LayoutOptions();
+  options2.line_spacing = 2.0f;
+  EXPECT_NE(layout, fm->GetCachedLayout(font, "abc", options2));
+  stats = fm->GetLayoutCacheStats();
+  EXPECT_EQ(2U, stats.hits);
+  EXPECT_EQ(6U, stats.misses);
+  EXPECT_EQ(6U, stats.size);
+
+  fm->ResetLayoutCacheStats();
+  stats = fm->GetLayoutCacheStats();
+  EXPECT_EQ(0U, stats.hits);
+  EXPECT_EQ(0U, stats.misses);
+  EXPECT_EQ(6U, stats.size);
+
+  // Clearing the cache does not affect Layouts in use.
+  fm->ClearLayoutCache();
+  EXPECT_EQ(0U, fm->GetLayoutCacheStats().size);
+  EXPECT_EQ(3U, layout->GetGlyphCount());
+  EXPECT_NE(layout, fm->GetCachedLayout(font, "abc", options));
+}
+
+TEST(FontManagerTest, LayoutCacheEviction) {
+  base::LogChecker logchecker;
+  FontManagerPtr fm(new FontManager);
+  FontPtr font = testing::BuildTestFreeTypeFont("Test", 32U, 4U);
+  const LayoutOptions options;
+
+  fm->SetLayoutCacheCapacity(2U);
+  EXPECT_EQ(2U, fm->GetLayoutCacheCapacity());
+  CachedLayoutPtr a = fm->GetCachedLayout(font, "a", options);
+  CachedLayoutPtr b = fm->GetCachedLayout(font, "b", options);
+  // Using "a" makes "b" the least recently used Layout.
+  EXPECT_EQ(a, fm->GetCachedLayout(font, "a", options));
+  CachedLayoutPtr c = fm->GetCachedLayout(font, "c", options);
+  FontManager::LayoutCacheStats stats = fm->GetLayoutCacheStats();
+  EXPECT_EQ(1U, stats.evictions);
+  EXPECT_EQ(2U, stats.size);
+  EXPECT_EQ(a, fm->GetCachedLayout(font, "a", options));
+  EXPECT_EQ(c, fm->GetCachedLayout(font, "c", options));
+  EXPECT_NE(b, fm->GetCachedLayout(font, "b", options));
+  EXPECT_EQ(2U, fm->GetLayoutCacheStats().evictions);
+
+  // Shrinking the cache evicts the oldest Layouts.
+  fm->SetLayoutCacheCapacity(1U);
+  stats = fm->GetLayoutCacheStats();
+  EXPECT_EQ(3U, stats.evictions);
+  EXPECT_EQ(1U, stats.size);
+
+  // A capacity of 0 disables caching.
+  fm->SetLayoutCacheCapacity(0U);
+  EXPECT_EQ(0U, fm->GetLayoutCacheStats().size);
+  a = fm->GetCachedLayout(font, "a", options);
+  ASSERT_TRUE(a);
+  EXPECT_EQ(1U, a->GetGlyphCount());
+  EXPECT_NE(a, fm->GetCachedLayout(font, "a", options));
+  EXPECT_EQ(0U, fm->GetLayoutCacheStats().size);
+}
+
 }  // namespace text
 }  // namespace ion
@@ -17,11 +17,15 @@ limitations under the License.
 
 #include "ion/text/freetypefont.h"
 
+#include <cmath>
+
 #include "base/integral_types.h"
 #include "ion/base/invalid.h"
 #include "ion/base/logchecker.h"
 #include "ion/base/tests/testallocator.h"
 #include "ion/math/vector.h"
+#include "ion/text/freetypefontutils.h"
+#include "ion/text/sdfutils.h"
 #include "ion/text/tests/testfont.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -215,5 +219,223 @@ TEST(FreeTypeFontTest, FontsWithDifferentAllocators) {
   EXPECT_FALSE(log_checker.HasAnyMessages());
 }
 
+TEST(FreeTypeFontTest, SharedFace) {
+  base::LogChecker log_checker;
+  base::testing::TestAllocatorPtr alloc(new base::testing::TestAllocator);
+  base::AllocationTrackerPtr tracker = alloc->GetTracker();
+  // The FreeType library for the allocator stays allocated.
+  BuildFontWithAllocator("Test", 32U, 4U, alloc);
+  const size_t library_bytes = tracker->GetActiveAllocationBytesCount();
+
+  // A font of another size from the same data shares the face, so it needs
+  // much less memory than the first.
+  FreeTypeFontPtr font32 = BuildFontWithAllocator("Test", 32U, 4U, alloc);
+  const size_t face_bytes =
+      tracker->GetActiveAllocationBytesCount() - library_bytes;
+  FreeTypeFontPtr font64 = BuildFontWithAllocator("Test", 64U, 4U, alloc);
+  const size_t size_bytes =
+      tracker->GetActiveAllocationBytesCount() - library_bytes - face_bytes;
+  EXPECT_LT(0U, size_bytes);
+  EXPECT_LT(size_bytes * 4U, face_bytes);
+
+  // Each font still uses its own size, however the face is used.
+  const std::string data_copy = testing::GetTestFontData();
+  FreeTypeFontPtr unshared64(new FreeTypeFont(
+      "Test", 64U, 4U, &data_copy[0], data_copy.size()));
+  FreeTypeFontPtr unshared32(new FreeTypeFont(
+      "Test", 32U, 4U, &data_copy[0], data_copy.size()));
+  EXPECT_EQ(unshared32->GetFontMetrics().line_advance_height,
+            font32->GetFontMetrics().line_advance_height);
+  EXPECT_EQ(unshared64->GetFontMetrics().line_advance_height,
+            font64->GetFontMetrics().line_advance_height);
+  for (int i = 0; i < 2; ++i) {
+    const FreeTypeFont::GlyphMetrics& metrics32 =
+        font32->GetGlyphMetrics(font32->GetDefaultGlyphForChar('A' + i));
+    const FreeTypeFont::GlyphMetrics& metrics64 =
+        font64->GetGlyphMetrics(font64->GetDefaultGlyphForChar('A' + i));
+    const FreeTypeFont::GlyphMetrics& expected32 = unshared32->GetGlyphMetrics(
+        unshared32->GetDefaultGlyphForChar('A' + i));
+    const FreeTypeFont::GlyphMetrics& expected64 = unshared64->GetGlyphMetrics(
+        unshared64->GetDefaultGlyphForChar('A' + i));
+    EXPECT_EQ(expected32.size, metrics32.size);
+    EXPECT_EQ(expected32.advance, metrics32.advance);
+    EXPECT_EQ(expected64.size, metrics64.size);
+    EXPECT_EQ(expected64.advance, metrics64.advance);
+    EXPECT_LT(metrics32.size[0], metrics64.size[0]);
+  }
+  EXPECT_EQ(unshared32->GetKerning('I', 'X'), font32->GetKerning('I', 'X'));
+  EXPECT_EQ(unshared64->GetKerning('I', 'X'), font64->GetKerning('I', 'X'));
+
+  // The face outlives the font that created it, and is freed with the last.
+  font32.Reset();
+  EXPECT_LT(library_bytes + size_bytes,
+            tracker->GetActiveAllocationBytesCount());
+  EXPECT_FALSE(base::IsInvalidReference(
+      font64->GetGlyphGrid(font64->GetDefaultGlyphForChar('M'))));
+  font64.Reset();
+  EXPECT_EQ(library_bytes, tracker->GetActiveAllocationBytesCount());
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(FreeTypeFontTest, PrecomputeCharRange) {
+  base::LogChecker log_checker;
+  FreeTypeFontPtr font = BuildFont("Test", 32U, 4U);
+  FreeTypeFontPtr reference = BuildFont("Reference", 32U, 4U);
+
+  EXPECT_TRUE(font->PrecomputeCharRange('A', 'Z'));
+  // Extending the range keeps the characters already precomputed.
+  EXPECT_TRUE(font->PrecomputeCharRange(0x20, 0x7e));
+  EXPECT_TRUE(font->PrecomputeCharRange(0xa0, 0xff));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // The precomputed tables give the same results as FreeType, including for
+  // characters outside the range and those the font has no glyph for.
+  for (CharIndex c = 0x1; c <= 0x17f; ++c) {
+    SCOPED_TRACE(c);
+    const GlyphIndex glyph = font->GetDefaultGlyphForChar(c);
+    EXPECT_EQ(reference->GetDefaultGlyphForChar(c), glyph);
+    const FreeTypeFont::GlyphMetrics& metrics = font->GetGlyphMetrics(glyph);
+    const FreeTypeFont::GlyphMetrics& expected =
+        reference->GetGlyphMetrics(glyph);
+    ASSERT_EQ(base::IsInvalidReference(expected),
+              base::IsInvalidReference(metrics));
+    if (!base::IsInvalidReference(expected)) {
+      EXPECT_EQ(expected.size, metrics.size);
+      EXPECT_EQ(expected.bitmap_offset, metrics.bitmap_offset);
+      EXPECT_EQ(expected.advance, metrics.advance);
+    }
+  }
+  size_t kerned_count = 0U;
+  for (CharIndex c0 = 0x20; c0 <= 0xff; ++c0) {
+    for (CharIndex c1 = 0x20; c1 <= 0xff; ++c1) {
+      const math::Vector2f kerning = font->GetKerning(c0, c1);
+      EXPECT_EQ(reference->GetKerning(c0, c1), kerning);
+      if (kerning != math::Vector2f::Zero())
+        ++kerned_count;
+    }
+  }
+  EXPECT_LT(0U, kerned_count);
+  EXPECT_EQ(math::Vector2f(-1.f, 0.f), font->GetKerning('I', 'X'));
+  EXPECT_EQ(math::Vector2f(1.f, 0.f), font->GetKerning('M', 'M'));
+  EXPECT_EQ(reference->GetDefaultGlyphForChar(kPileOfPoo),
+            font->GetDefaultGlyphForChar(kPileOfPoo));
+
+  // Layouts do not change.
+  LayoutOptions options;
+  options.target_size.Set(0.f, 1.f);
+  const std::string text("The quick brown fox jumps over the lazy dog");
+  const Layout layout = font->BuildLayout(text, options);
+  const Layout expected_layout = reference->BuildLayout(text, options);
+  ASSERT_EQ(expected_layout.GetGlyphCount(), layout.GetGlyphCount());
+  for (size_t i = 0; i < layout.GetGlyphCount(); ++i) {
+    EXPECT_EQ(expected_layout.GetGlyph(i).glyph_index,
+              layout.GetGlyph(i).glyph_index);
+    EXPECT_EQ(expected_layout.GetGlyph(i).bounds, layout.GetGlyph(i).bounds);
+  }
+
+  // Invalid ranges.
+  EXPECT_FALSE(font->PrecomputeCharRange(0, 0x20));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Cannot precompute"));
+  EXPECT_FALSE(font->PrecomputeCharRange(0x30, 0x20));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Cannot precompute"));
+  // The extended range would be too large.
+  EXPECT_FALSE(font->PrecomputeCharRange(0x500, 0x510));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Cannot precompute"));
+  EXPECT_EQ(math::Vector2f(-1.f, 0.f), font->GetKerning('I', 'X'));
+
+  // Nothing is precomputed for a font that failed to load.
+  FreeTypeFontPtr failed(new FontWithLibraryFailure);
+  log_checker.ClearLog();
+  EXPECT_FALSE(failed->PrecomputeCharRange(0x20, 0x7e));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+}
+
+TEST(FreeTypeFontTest, MultiChannelSdf) {
+  FreeTypeFontPtr font = BuildFont("Test", 32U, 4U);
+  EXPECT_FALSE(font->GetMultiChannelSdf());
+  font->SetMultiChannelSdf(true);
+  EXPECT_TRUE(font->GetMultiChannelSdf());
+  const GlyphIndex glyph = font->GetDefaultGlyphForChar('A');
+  GlyphSet glyph_set(base::AllocatorPtr(NULL));
+  glyph_set.insert(glyph);
+  font->CacheSdfGrids(glyph_set);
+
+  // The multi-channel grid has the size of the SDF grid, and agrees with it
+  // on which side of the outline nearly all pixels are. They differ only on
+  // pixels that the coverage grid puts right at the edge.
+  const Font::GlyphGrid& grid = font->GetGlyphGrid(glyph);
+  ASSERT_TRUE(grid.is_sdf);
+  ASSERT_TRUE(grid.HasMultiChannelSdf());
+  EXPECT_EQ(grid.GetWidth(), grid.msdf_pixels.GetWidth());
+  EXPECT_EQ(grid.GetHeight(), grid.msdf_pixels.GetHeight());
+  size_t inside = 0;
+  size_t mismatches = 0;
+  for (size_t y = 0; y < grid.GetHeight(); ++y) {
+    for (size_t x = 0; x < grid.GetWidth(); ++x) {
+      const math::Vector3ui8& values = grid.msdf_pixels.Get(x, y);
+      const double median = GetMsdfMedian(
+          math::Vector3d(DequantizeSdfValue(values[0], 4U),
+                         DequantizeSdfValue(values[1], 4U),
+                         DequantizeSdfValue(values[2], 4U)));
+      const double distance = grid.pixels.Get(x, y);
+      if (median < 0.0)
+        ++inside;
+      if (std::abs(distance) > 0.75 && (median < 0.0) != (distance < 0.0))
+        ++mismatches;
+    }
+  }
+  EXPECT_LT(0U, inside);
+  EXPECT_EQ(0U, mismatches);
+
+  // Glyphs without an outline have no multi-channel grid.
+  FreeTypeFontPtr plain_font = BuildFont("Plain", 32U, 4U);
+  plain_font->CacheSdfGrids(glyph_set);
+  EXPECT_FALSE(plain_font->GetGlyphGrid(glyph).HasMultiChannelSdf());
+}
+
+TEST(FreeTypeFontTest, ShapedRunCache) {
+  ShapedRunCache cache(base::AllocatorPtr(), 2U);
+  EXPECT_EQ(2U, cache.GetCapacity());
+  EXPECT_EQ(0U, cache.GetSize());
+  EXPECT_FALSE(cache.Find("a"));
+
+  std::shared_ptr<ShapedRun> run(new ShapedRun);
+  run->glyphs.push_back(ShapedRun::Glyph(12U, math::Point2f(1.0f, 2.0f)));
+  run->advance = 8.0f;
+  const ShapedRunPtr a(run);
+  const ShapedRunPtr b(new ShapedRun);
+  const ShapedRunPtr c(new ShapedRun);
+  cache.Add("a", a);
+  cache.Add("b", b);
+  EXPECT_EQ(2U, cache.GetSize());
+  EXPECT_EQ(a, cache.Find("a"));
+  EXPECT_EQ(b, cache.Find("b"));
+  EXPECT_EQ(1U, cache.Find("a")->glyphs.size());
+  EXPECT_EQ(8.0f, cache.Find("a")->advance);
+
+  // "b" is the least recently used run, so adding "c" removes it.
+  cache.Add("c", c);
+  EXPECT_EQ(2U, cache.GetSize());
+  EXPECT_EQ(a, cache.Find("a"));
+  EXPECT_FALSE(cache.Find("b"));
+  EXPECT_EQ(c, cache.Find("c"));
+
+  // Replacing a run does not grow the cache.
+  cache.Add("a", b);
+  EXPECT_EQ(2U, cache.GetSize());
+  EXPECT_EQ(b, cache.Find("a"));
+  EXPECT_EQ(c, cache.Find("c"));
+
+  cache.Clear();
+  EXPECT_EQ(0U, cache.GetSize());
+  EXPECT_FALSE(cache.Find("a"));
+
+  // A cache with no capacity holds nothing.
+  ShapedRunCache empty_cache(base::AllocatorPtr(), 0U);
+  empty_cache.Add("a", a);
+  EXPECT_EQ(0U, empty_cache.GetSize());
+  EXPECT_FALSE(empty_cache.Find("a"));
+}
+
 }  // namespace text
 }  // namespace ion
@@ -0,0 +1,169 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/text/glyphcache.h"
+
+#include <stdio.h>
+
+#include <string>
+
+#include "ion/base/logchecker.h"
+#include "ion/port/fileutils.h"
+#include "ion/text/fontmanager.h"
+#include "ion/text/tests/mockfont.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace text {
+
+namespace {
+
+// Returns the set of glyphs in a MockFont that have a nonzero size.
+static const GlyphSet GetMockGlyphs(Font* font) {
+  GlyphSet glyphs(base::AllocatorPtr(NULL));
+  font->AddGlyphsForAsciiCharacterRange(1, 127, &glyphs);
+  font->FilterGlyphs(&glyphs);
+  return glyphs;
+}
+
+}  // anonymous namespace
+
+TEST(GlyphCacheTest, SaveAndLoad) {
+  const std::string path = port::GetTemporaryFilename();
+  FontPtr font(new testing::MockFont(32U, 4U));
+  const GlyphSet glyphs = GetMockGlyphs(font.Get());
+  ASSERT_EQ(5U, glyphs.size());
+  font->CacheSdfGrids(glyphs);
+  EXPECT_TRUE(SaveGlyphCache(*font, path));
+
+  // Load the cache into a new font; only the glyphs without SDF grids get one.
+  FontPtr loaded(new testing::MockFont(32U, 4U));
+  GlyphSet some_glyphs(base::AllocatorPtr(NULL));
+  some_glyphs.insert(*glyphs.begin());
+  loaded->CacheSdfGrids(some_glyphs);
+  EXPECT_EQ(4U, LoadGlyphCache(path, loaded.Get()));
+  GlyphSet sdf_glyphs(base::AllocatorPtr(NULL));
+  loaded->GetSdfGlyphs(&sdf_glyphs);
+  EXPECT_TRUE(sdf_glyphs == glyphs);
+  for (GlyphSet::const_iterator it = glyphs.begin(); it != glyphs.end(); ++it) {
+    const Font::GlyphGrid& expected = font->GetGlyphGrid(*it);
+    const Font::GlyphGrid& grid = loaded->GetGlyphGrid(*it);
+    EXPECT_TRUE(grid.is_sdf);
+    ASSERT_EQ(expected.pixels.GetWidth(), grid.pixels.GetWidth());
+    ASSERT_EQ(expected.pixels.GetHeight(), grid.pixels.GetHeight());
+    for (size_t y = 0; y < grid.pixels.GetHeight(); ++y) {
+      for (size_t x = 0; x < grid.pixels.GetWidth(); ++x)
+        EXPECT_EQ(expected.pixels.Get(x, y), grid.pixels.Get(x, y));
+    }
+  }
+
+  // Loading again adds nothing.
+  EXPECT_EQ(0U, LoadGlyphCache(path, loaded.Get()));
+
+  // The manager functions do the same.
+  FontManagerPtr manager(new FontManager);
+  FontPtr managed(new testing::MockFont(32U, 4U));
+  EXPECT_FALSE(manager->SaveGlyphCache(FontPtr(), path));
+  EXPECT_EQ(0U, manager->LoadGlyphCache(FontPtr(), path));
+  EXPECT_EQ(5U, manager->LoadGlyphCache(managed, path));
+  EXPECT_TRUE(manager->SaveGlyphCache(managed, path));
+  EXPECT_EQ(5U, manager->LoadGlyphCache(FontPtr(new testing::MockFont(32U, 4U)),
+                                        path));
+
+  EXPECT_TRUE(port::RemoveFile(path));
+}
+
+TEST(GlyphCacheTest, QuantizedGrids) {
+  // Quantized grids are saved as distances that quantize to the same values.
+  const std::string path = port::GetTemporaryFilename();
+  FontPtr font(new testing::MockFont(32U, 4U));
+  font->SetQuantizeGrids(true);
+  const GlyphSet glyphs = GetMockGlyphs(font.Get());
+  font->CacheSdfGrids(glyphs);
+  ASSERT_TRUE(SaveGlyphCache(*font, path));
+  FontPtr loaded(new testing::MockFont(32U, 4U));
+  loaded->SetQuantizeGrids(true);
+  EXPECT_EQ(glyphs.size(), LoadGlyphCache(path, loaded.Get()));
+  for (GlyphSet::const_iterator it = glyphs.begin(); it != glyphs.end(); ++it) {
+    const Font::GlyphGrid& expected = font->GetGlyphGrid(*it);
+    const Font::GlyphGrid& grid = loaded->GetGlyphGrid(*it);
+    EXPECT_TRUE(grid.is_quantized);
+    ASSERT_EQ(expected.GetWidth(), grid.GetWidth());
+    ASSERT_EQ(expected.GetHeight(), grid.GetHeight());
+    for (size_t y = 0; y < grid.GetHeight(); ++y) {
+      for (size_t x = 0; x < grid.GetWidth(); ++x)
+        EXPECT_EQ(expected.quantized_pixels.Get(x, y),
+                  grid.quantized_pixels.Get(x, y));
+    }
+  }
+  EXPECT_TRUE(port::RemoveFile(path));
+}
+
+TEST(GlyphCacheTest, Mismatches) {
+  base::LogChecker log_checker;
+  const std::string path = port::GetTemporaryFilename();
+  FontPtr font(new testing::MockFont(32U, 4U));
+  font->CacheSdfGrids(GetMockGlyphs(font.Get()));
+  ASSERT_TRUE(SaveGlyphCache(*font, path));
+
+  // A missing file or the wrong font is ignored.
+  FontPtr other(new testing::MockFont(32U, 4U));
+  EXPECT_EQ(0U, LoadGlyphCache(path + "_missing", other.Get()));
+  EXPECT_EQ(0U,
+            LoadGlyphCache(path, FontPtr(new testing::MockFont(16U, 4U)).Get()));
+  EXPECT_EQ(0U,
+            LoadGlyphCache(path, FontPtr(new testing::MockFont(32U, 2U)).Get()));
+  EXPECT_FALSE(log_checker.HasAnyMessages());
+
+  // Read the file back to make damaged copies.
+  std::string data;
+  ASSERT_TRUE(port::ReadDataFromFile(path, &data));
+  const auto write_file = [&path](const std::string& contents) {
+    FILE* file = port::OpenFile(path, "wb");
+    ASSERT_TRUE(file != NULL);
+    fwrite(contents.data(), 1U, contents.size(), file);
+    fclose(file);
+  };
+
+  // A different version.
+  std::string damaged = data;
+  damaged[8] = static_cast<char>(damaged[8] + 1);
+  write_file(damaged);
+  EXPECT_EQ(0U, LoadGlyphCache(path, other.Get()));
+  EXPECT_TRUE(log_checker.HasMessage("WARNING", "unsupported version"));
+
+  // A truncated file.
+  write_file(data.substr(0, data.size() - 4U));
+  EXPECT_EQ(0U, LoadGlyphCache(path, other.Get()));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "is truncated"));
+  write_file(data.substr(0, 20U));
+  EXPECT_EQ(0U, LoadGlyphCache(path, other.Get()));
+
+  // Nothing was added by any of these.
+  GlyphSet sdf_glyphs(base::AllocatorPtr(NULL));
+  other->GetSdfGlyphs(&sdf_glyphs);
+  EXPECT_TRUE(sdf_glyphs.empty());
+
+  // A path that cannot be written.
+  EXPECT_FALSE(SaveGlyphCache(*font, path + "/not/a/directory/glyphs"));
+  EXPECT_TRUE(log_checker.HasMessage("ERROR", "Unable to open"));
+
+  EXPECT_TRUE(port::RemoveFile(path));
+}
+
+}  // namespace text
+}  // namespace ion
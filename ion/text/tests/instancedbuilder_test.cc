@@ -0,0 +1,191 @@
+/**
+Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS-IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "ion/text/instancedbuilder.h"
+
+#include <string>
+
+#include "ion/gfx/attributearray.h"
+#include "ion/gfx/bufferobject.h"
+#include "ion/gfx/indexbuffer.h"
+#include "ion/gfx/node.h"
+#include "ion/gfx/shape.h"
+#include "ion/math/vector.h"
+#include "ion/text/layout.h"
+#include "ion/text/tests/buildertestbase.h"
+#include "third_party/googletest/googletest/include/gtest/gtest.h"
+
+namespace ion {
+namespace text {
+
+namespace {
+
+// The record stored by an InstancedBuilder for each glyph.
+struct GlyphInstance {
+  math::Point3f position;
+  math::Vector2f size;
+  math::Vector4ui16 texture_rect;
+  math::Vector4ui8 color;
+};
+
+// Returns the indexed buffer bound to the AttributeArray of a built Node.
+static gfx::BufferObject* GetBuffer(const gfx::NodePtr& node, size_t index) {
+  const gfx::AttributeArrayPtr& attr_array =
+      node->GetShapes()[0]->GetAttributeArray();
+  return attr_array->GetBufferAttribute(index)
+      .GetValue<gfx::BufferObjectElement>().buffer_object.Get();
+}
+
+// Returns the indexed glyph record of a built Node.
+static const GlyphInstance& GetInstance(const gfx::NodePtr& node,
+                                        size_t index) {
+  return GetBuffer(node, 0)->GetData()->GetData<GlyphInstance>()[index];
+}
+
+}  // anonymous namespace
+
+class InstancedBuilderTest : public testing::BuilderTestBase<InstancedBuilder> {
+ protected:
+  const std::string GetShaderIdString() const override {
+    return std::string("  Shader ID: \"Instanced Text Shader\"\n");
+  }
+  const std::string GetUniformString() const override { return std::string(); }
+};
+
+TEST_F(InstancedBuilderTest, Build) {
+  InstancedBuilder* ib = GetBuilder();
+  EXPECT_EQ(math::Vector4f(1.f, 1.f, 1.f, 1.f), ib->GetColor());
+  EXPECT_EQ(0U, ib->GetGlyphCount());
+  EXPECT_FALSE(ib->Build(Layout(), gfx::BufferObject::kStreamDraw));
+
+  ib->SetColor(math::Vector4f(1.f, 0.f, 0.5f, 2.f));
+  const Layout layout = BuildLayout("bg");
+  EXPECT_TRUE(ib->Build(layout, gfx::BufferObject::kStreamDraw));
+  EXPECT_EQ(2U, ib->GetGlyphCount());
+
+  // The glyphs are instances of one quad.
+  gfx::NodePtr node = ib->GetNode();
+  ASSERT_TRUE(node.Get());
+  ASSERT_EQ(1U, node->GetShapes().size());
+  const gfx::ShapePtr& shape = node->GetShapes()[0];
+  EXPECT_EQ(gfx::Shape::kTriangles, shape->GetPrimitiveType());
+  EXPECT_EQ(2, shape->GetInstanceCount());
+  EXPECT_EQ(6U, shape->GetIndexBuffer()->GetCount());
+  EXPECT_EQ(5U, shape->GetAttributeArray()->GetBufferAttributeCount());
+  EXPECT_EQ(2U, GetBuffer(node, 0)->GetCount());
+  EXPECT_EQ(sizeof(GlyphInstance), GetBuffer(node, 0)->GetStructSize());
+  EXPECT_EQ(4U, GetBuffer(node, 4)->GetCount());
+  for (size_t i = 0; i < 4U; ++i) {
+    EXPECT_EQ(1U, shape->GetAttributeArray()->GetBufferAttribute(i)
+                      .GetDivisor());
+  }
+  EXPECT_EQ(0U, shape->GetAttributeArray()->GetBufferAttribute(4)
+                    .GetDivisor());
+
+  for (size_t i = 0; i < 2U; ++i) {
+    const Layout::Quad& quad = layout.GetGlyph(i).quad;
+    const GlyphInstance& instance = GetInstance(node, i);
+    EXPECT_EQ(quad.points[0], instance.position);
+    EXPECT_EQ(math::Vector2f(quad.points[2][0] - quad.points[0][0],
+                             quad.points[2][1] - quad.points[0][1]),
+              instance.size);
+    EXPECT_EQ(math::Vector4ui8(255, 0, 128, 255), instance.color);
+  }
+  EXPECT_FALSE(ib->GetExtents().IsEmpty());
+
+  // Rebuilding a Layout with the same number of glyphs reuses the buffers.
+  gfx::BufferObject* bo = GetBuffer(node, 0);
+  const gfx::IndexBufferPtr indices = shape->GetIndexBuffer();
+  EXPECT_TRUE(ib->Build(BuildLayout("gb"), gfx::BufferObject::kStreamDraw));
+  EXPECT_EQ(bo, GetBuffer(node, 0));
+  EXPECT_EQ(indices.Get(), shape->GetIndexBuffer().Get());
+
+  // A longer Layout only changes the instance count.
+  EXPECT_TRUE(ib->Build(BuildLayout("bgb"), gfx::BufferObject::kStreamDraw));
+  EXPECT_EQ(3, shape->GetInstanceCount());
+  EXPECT_EQ(3U, GetBuffer(node, 0)->GetCount());
+  EXPECT_EQ(indices.Get(), shape->GetIndexBuffer().Get());
+}
+
+TEST_F(InstancedBuilderTest, TextureRectangles) {
+  // The MockFontImage does not use normalized texture coordinates, so use a
+  // DynamicFontImage.
+  InstancedBuilderPtr ib(new InstancedBuilder(BuildDynamicFontImage(),
+                                              gfxutils::ShaderManagerPtr(),
+                                              base::AllocatorPtr()));
+  const Layout layout = BuildLayout("bg");
+  EXPECT_TRUE(ib->Build(layout, gfx::BufferObject::kStreamDraw));
+  GlyphSet glyph_set(base::AllocatorPtr(NULL));
+  layout.GetGlyphSet(&glyph_set);
+  const FontImage::ImageData& image_data =
+      ib->GetFontImage()->FindImageData(glyph_set);
+  for (size_t i = 0; i < 2U; ++i) {
+    const GlyphInstance& instance = GetInstance(ib->GetNode(), i);
+    math::Range2f rect;
+    EXPECT_TRUE(FontImage::GetTextureCoords(
+        image_data, layout.GetGlyph(i).glyph_index, &rect));
+    // The rectangle is flipped vertically.
+    static const float kScale = 1.f / 65535.f;
+    EXPECT_NEAR(rect.GetMinPoint()[0], instance.texture_rect[0] * kScale,
+                kScale);
+    EXPECT_NEAR(rect.GetMaxPoint()[1], instance.texture_rect[1] * kScale,
+                kScale);
+    EXPECT_NEAR(rect.GetMaxPoint()[0], instance.texture_rect[2] * kScale,
+                kScale);
+    EXPECT_NEAR(rect.GetMinPoint()[1], instance.texture_rect[3] * kScale,
+                kScale);
+  }
+}
+
+TEST_F(InstancedBuilderTest, UpdateGlyphsInPlace) {
+  InstancedBuilder* ib = GetBuilder();
+  EXPECT_FALSE(ib->SetGlyphColor(0U, math::Vector4f(0.f, 0.f, 0.f, 1.f)));
+  EXPECT_TRUE(ib->Build(BuildLayout("bg"), gfx::BufferObject::kDynamicDraw));
+  gfx::NodePtr node = ib->GetNode();
+  gfx::BufferObject* bo = GetBuffer(node, 0);
+  EXPECT_TRUE(bo->GetSubData().empty());
+
+  // Each change uploads only the record of the glyph.
+  const math::Point3f position(10.f, 20.f, 30.f);
+  EXPECT_TRUE(ib->SetGlyphPosition(1U, position));
+  ASSERT_EQ(1U, bo->GetSubData().size());
+  EXPECT_EQ(sizeof(GlyphInstance), bo->GetSubData()[0].range.GetMinPoint());
+  EXPECT_EQ(sizeof(GlyphInstance), bo->GetSubData()[0].range.GetSize());
+  EXPECT_EQ(position, GetInstance(node, 1).position);
+  EXPECT_EQ(position,
+            bo->GetSubData()[0].data->GetData<GlyphInstance>()->position);
+
+  EXPECT_TRUE(ib->SetGlyphColor(0U, math::Vector4f(0.f, 1.f, 0.f, 1.f)));
+  ASSERT_EQ(2U, bo->GetSubData().size());
+  EXPECT_EQ(0U, bo->GetSubData()[1].range.GetMinPoint());
+  EXPECT_EQ(math::Vector4ui8(0, 255, 0, 255), GetInstance(node, 0).color);
+  EXPECT_FALSE(ib->SetGlyphColor(2U, math::Vector4f(0.f, 1.f, 0.f, 1.f)));
+  EXPECT_FALSE(ib->SetGlyphPosition(2U, position));
+  EXPECT_EQ(2U, bo->GetSubData().size());
+
+  // Static data cannot be changed in place.
+  EXPECT_TRUE(ib->Build(BuildLayout("bgb"), gfx::BufferObject::kStaticDraw));
+  EXPECT_FALSE(ib->SetGlyphPosition(0U, position));
+  EXPECT_FALSE(ib->SetGlyphColor(0U, math::Vector4f(0.f, 1.f, 0.f, 1.f)));
+}
+
+TEST_F(InstancedBuilderTest, DynamicFontSubImages) {
+  EXPECT_TRUE(TestDynamicFontSubImages());
+}
+
+}  // namespace text
+}  // namespace ion
@@ -17,6 +17,9 @@ limitations under the License.
 
 #include "ion/text/sdfutils.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include "ion/base/array2.h"
 #include "third_party/googletest/googletest/include/gtest/gtest.h"
 
@@ -50,18 +53,18 @@ TEST(SdfutilsTest, ComputeSdfGrid) {
   EXPECT_EQ(kSdfHeight, sdf.GetHeight());
 
   static const double kExpectedSdfValues[kSdfWidth * kSdfHeight] = {
-    3.87, 3.09, 2.51, 2.30, 2.10, 2.33, 2.90, 3.69,
-    3.22, 2.51, 1.67, 1.30, 1.10, 1.49, 2.33, 2.99,
-    2.62, 1.81, 1.30, 0.26, 0.10, 1.10, 1.57, 2.41,
-    2.40, 1.40, 0.39, 0.16, 0.00, 0.16, 1.15, 1.97,
-    2.20, 1.20, 0.20, -0.10, -1.00, -0.30, 0.70, 1.70,
-    2.40, 1.40, 0.39, 0.16, 0.00, 0.16, 1.15, 1.97,
-    2.62, 1.81, 1.30, 0.26, 0.10, 1.10, 1.57, 2.41,
-    3.22, 2.51, 1.67, 1.30, 1.10, 1.49, 2.33, 2.99,
-    3.87, 3.09, 2.51, 2.30, 2.10, 2.33, 2.90, 3.69,
+    3.618, 2.844, 2.256, 2.022, 2.002, 2.238, 2.830, 3.607,
+    2.857, 2.256, 1.446, 1.044, 1.005, 1.418, 2.238, 2.835,
+    2.272, 1.470, 1.044, 0.300, 0.100, 1.005, 1.428, 2.245,
+    2.040, 1.077, 0.400, 0.200, 0.000, 0.200, 1.020, 2.010,
+    2.010, 1.020, 0.200, -0.100, -1.000, -0.300, 1.000, 2.000,
+    2.040, 1.077, 0.400, 0.200, 0.000, 0.200, 1.020, 2.010,
+    2.272, 1.470, 1.044, 0.300, 0.100, 1.005, 1.428, 2.245,
+    2.857, 2.256, 1.446, 1.044, 1.005, 1.418, 2.238, 2.835,
+    3.618, 2.844, 2.256, 2.022, 2.002, 2.238, 2.830, 3.607,
   };
-  // 2-decimal tolerance.
-  static const double kTolerance = 5.e-3;
+  // 3-decimal tolerance.
+  static const double kTolerance = 5.e-4;
   for (size_t y = 0; y < kSdfHeight; ++y) {
     for (size_t x = 0; x < kSdfWidth; ++x) {
       SCOPED_TRACE(::testing::Message() << "x = " << x << ", y = " << y);
@@ -71,5 +74,138 @@ TEST(SdfutilsTest, ComputeSdfGrid) {
   }
 }
 
+TEST(SdfutilsTest, ExactDistances) {
+  // For a binary image, the distances are the exact Euclidean distances
+  // between pixel centers, to the nearest foreground pixel outside it and to
+  // the nearest background pixel inside it.
+  static const size_t kWidth = 13U;
+  static const size_t kHeight = 9U;
+  static const size_t kPadding = 3U;
+  base::Array2<double> image(kWidth, kHeight, 0.0);
+  for (size_t y = 2; y < 6; ++y)
+    for (size_t x = 3; x < 11; ++x)
+      image.Set(x, y, 1.0);
+  image.Set(1, 7, 1.0);
+  image.Set(6, 3, 0.0);
+
+  const base::Array2<double> sdf = ComputeSdfGrid(image, kPadding);
+  ASSERT_EQ(kWidth + 2U * kPadding, sdf.GetWidth());
+  ASSERT_EQ(kHeight + 2U * kPadding, sdf.GetHeight());
+  for (size_t y = 0; y < sdf.GetHeight(); ++y) {
+    for (size_t x = 0; x < sdf.GetWidth(); ++x) {
+      const bool is_inside =
+          x >= kPadding && y >= kPadding && x < kWidth + kPadding &&
+          y < kHeight + kPadding &&
+          image.Get(x - kPadding, y - kPadding) == 1.0;
+      double nearest = 1e6;
+      for (size_t j = 0; j < sdf.GetHeight(); ++j) {
+        for (size_t i = 0; i < sdf.GetWidth(); ++i) {
+          const bool other_is_inside =
+              i >= kPadding && j >= kPadding && i < kWidth + kPadding &&
+              j < kHeight + kPadding &&
+              image.Get(i - kPadding, j - kPadding) == 1.0;
+          if (other_is_inside != is_inside) {
+            const double dx = static_cast<double>(i) - static_cast<double>(x);
+            const double dy = static_cast<double>(j) - static_cast<double>(y);
+            nearest = std::min(nearest, std::sqrt(dx * dx + dy * dy));
+          }
+        }
+      }
+      SCOPED_TRACE(::testing::Message() << "x = " << x << ", y = " << y);
+      EXPECT_NEAR(is_inside ? -nearest : nearest, sdf.Get(x, y), 1e-4);
+    }
+  }
+
+  // An empty image only has padding.
+  const base::Array2<double> empty =
+      ComputeSdfGrid(base::Array2<double>(), kPadding);
+  EXPECT_EQ(2U * kPadding, empty.GetWidth());
+  EXPECT_EQ(2U * kPadding, empty.GetHeight());
+}
+
+// Returns a square contour with corners at (min, min) and (max, max), which
+// goes clockwise on the screen unless reversed.
+static const OutlineContour BuildSquare(double min, double max,
+                                        bool reversed) {
+  OutlineContour contour;
+  contour.points.push_back(math::Point2d(min, min));
+  contour.points.push_back(math::Point2d(max, min));
+  contour.points.push_back(math::Point2d(max, max));
+  contour.points.push_back(math::Point2d(min, max));
+  if (reversed)
+    std::reverse(contour.points.begin(), contour.points.end());
+  contour.is_smooth.resize(4U, false);
+  return contour;
+}
+
+TEST(SdfutilsTest, ComputeMsdfGrid) {
+  // A square covering pixels 2 through 5 of an 8x8 glyph, padded by 2.
+  static const size_t kPadding = 2U;
+  for (int reversed = 0; reversed < 2; ++reversed) {
+    SCOPED_TRACE(reversed);
+    GlyphOutline outline(1U, BuildSquare(2.0, 6.0, reversed != 0));
+    const base::Array2<math::Vector3d> msdf =
+        ComputeMsdfGrid(outline, 8U, 8U, kPadding);
+    EXPECT_EQ(12U, msdf.GetWidth());
+    EXPECT_EQ(12U, msdf.GetHeight());
+
+    // Grid element (x, y) is sampled at (x - 1.5, y - 1.5). The median is
+    // negative inside and positive outside.
+    EXPECT_NEAR(-1.5, GetMsdfMedian(msdf.Get(5U, 5U)), 1e-6);
+    EXPECT_NEAR(-0.5, GetMsdfMedian(msdf.Get(4U, 6U)), 1e-6);
+    EXPECT_NEAR(0.5, GetMsdfMedian(msdf.Get(3U, 6U)), 1e-6);
+    EXPECT_NEAR(0.5, GetMsdfMedian(msdf.Get(6U, 8U)), 1e-6);
+
+    // Outside a corner, a single-channel SDF holds the distance to the
+    // corner, which rounds it, while the median holds the distance to the
+    // nearest of the lines through its edges.
+    EXPECT_NEAR(0.5, GetMsdfMedian(msdf.Get(3U, 3U)), 1e-6);
+    EXPECT_NEAR(1.5, GetMsdfMedian(msdf.Get(2U, 3U)), 1e-6);
+    EXPECT_NEAR(3.5, GetMsdfMedian(msdf.Get(0U, 0U)), 1e-6);
+    EXPECT_NEAR(2.5, GetMsdfMedian(msdf.Get(10U, 10U)), 1e-6);
+  }
+
+  // A hole, which has the opposite orientation, is outside.
+  GlyphOutline ring;
+  ring.push_back(BuildSquare(0.0, 8.0, false));
+  ring.push_back(BuildSquare(3.0, 5.0, true));
+  const base::Array2<math::Vector3d> msdf =
+      ComputeMsdfGrid(ring, 8U, 8U, kPadding);
+  EXPECT_NEAR(0.5, GetMsdfMedian(msdf.Get(5U, 5U)), 1e-6);
+  EXPECT_NEAR(-0.5, GetMsdfMedian(msdf.Get(4U, 4U)), 1e-6);
+  EXPECT_NEAR(-0.5, GetMsdfMedian(msdf.Get(2U, 2U)), 1e-6);
+  EXPECT_NEAR(1.5, GetMsdfMedian(msdf.Get(0U, 0U)), 1e-6);
+
+  // An empty outline is far outside everywhere.
+  const base::Array2<math::Vector3d> empty =
+      ComputeMsdfGrid(GlyphOutline(), 2U, 2U, kPadding);
+  EXPECT_EQ(6U, empty.GetWidth());
+  EXPECT_LT(1000.0, GetMsdfMedian(empty.Get(3U, 3U)));
+}
+
+TEST(SdfutilsTest, QuantizeSdfValue) {
+  EXPECT_EQ(0U, QuantizeSdfValue(-4.0, 4U));
+  EXPECT_EQ(0U, QuantizeSdfValue(-10.0, 4U));
+  EXPECT_EQ(127U, QuantizeSdfValue(0.0, 4U));
+  EXPECT_EQ(191U, QuantizeSdfValue(2.0, 4U));
+  EXPECT_EQ(255U, QuantizeSdfValue(4.0, 4U));
+  EXPECT_EQ(255U, QuantizeSdfValue(10.0, 4U));
+  // A padding of 0 does not scale the distance.
+  EXPECT_EQ(191U, QuantizeSdfValue(0.5, 0U));
+}
+
+TEST(SdfutilsTest, DequantizeSdfValue) {
+  EXPECT_NEAR(-4.0, DequantizeSdfValue(0U, 4U), 0.02);
+  EXPECT_NEAR(0.0, DequantizeSdfValue(127U, 4U), 0.02);
+  EXPECT_NEAR(4.0, DequantizeSdfValue(255U, 4U), 0.02);
+  // Quantizing a dequantized value returns it.
+  for (size_t padding = 0; padding < 20U; ++padding) {
+    for (uint32 value = 0; value < 256U; ++value) {
+      const uint8 v = static_cast<uint8>(value);
+      EXPECT_EQ(v, QuantizeSdfValue(DequantizeSdfValue(v, padding), padding));
+    }
+  }
+}
+
 }  // namespace text
 }  // namespace ion
@@ -27,12 +27,14 @@
       ],
       'sources' : [
         'basicbuilder_test.cc',
-        'binpacker_test.cc',
+        'batchbuilder_test.cc',
         'font_test.cc',
         'fontimage_test.cc',
         'fontmacros_test.cc',
         'fontmanager_test.cc',
         'freetypefont_test.cc',
+        'glyphcache_test.cc',
+        'instancedbuilder_test.cc',
         'layout_test.cc',
         'outlinebuilder_test.cc',
         'platformfont_test.cc',
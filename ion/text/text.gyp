@@ -32,8 +32,8 @@
       'sources': [
         'basicbuilder.cc',
         'basicbuilder.h',
-        'binpacker.cc',
-        'binpacker.h',
+        'batchbuilder.cc',
+        'batchbuilder.h',
         'builder.cc',
         'builder.h',
         'font.cc',
@@ -43,6 +43,10 @@
         'fontmacros.h',
         'fontmanager.cc',
         'fontmanager.h',
+        'glyphcache.cc',
+        'glyphcache.h',
+        'instancedbuilder.cc',
+        'instancedbuilder.h',
         'layout.cc',
         'layout.h',
         'outlinebuilder.cc',
@@ -296,7 +296,9 @@ class _RealWebSocket : public easywsclient::WebSocket
 
             // We got a whole message, now do something with it:
             if (false) { }
-            else if (ws.opcode == TEXT_FRAME && ws.fin) {
+            // Google change: also dispatch binary frames, as strings of bytes.
+            else if ((ws.opcode == TEXT_FRAME || ws.opcode == BINARY_FRAME) &&
+                     ws.fin) {
                 if (ws.mask) { for (size_t i = 0; i != ws.N; ++i) { rxbuf[i+ws.header_size] ^= ws.masking_key[i&0x3]; } }
                 std::string data(rxbuf.begin()+ws.header_size, rxbuf.begin()+ws.header_size+(size_t)ws.N);
                 callable((const std::string) data);